@@ -0,0 +1,306 @@
+
+'''
+License:
+  "NASA Open Source Agreement 1.3"
+
+Description:
+  This module implements Python bindings of the libespa_formatter shared
+  library, which opens ESPA products and reads their bands.
+
+Notes:
+  The metadata comes from the metadata the library parsed when the product
+  was opened, so the XML isn't parsed again in Python.
+
+  The plain raw binary bands are returned as read-only numpy arrays over the
+  mapped band files, so nothing is copied; the pages are read from the file
+  as they are touched.  The constant, block-compressed, and remote bands
+  can't be mapped, so they are read into new arrays.
+
+  The product stays open until it is closed and every array of its bands is
+  gone, so the arrays never outlive the mapped files.
+
+  The library is found as libespa_formatter.so.1 through the library path,
+  unless ESPA_FORMATTER_LIB names it.
+
+History:
+  Created Oct/2026 by the ESPA team, USGS/EROS
+'''
+
+import os
+import json
+import ctypes
+
+import numpy
+
+
+'''
+Numpy data types of the Espa_formatter_data_type_t values.
+'''
+__DATA_TYPES__ = [numpy.int8, numpy.uint8, numpy.int16, numpy.uint16,
+                  numpy.int32, numpy.uint32, numpy.float32, numpy.float64]
+
+
+ESPA_FORMATTER_NAME_SIZE = 256
+
+
+class Espa_formatter_band_info(ctypes.Structure):
+    '''
+    Description:
+      Mirrors Espa_formatter_band_info_t of espa_formatter.h
+    '''
+    _fields_ = [('name', ctypes.c_char * ESPA_FORMATTER_NAME_SIZE),
+                ('product', ctypes.c_char * ESPA_FORMATTER_NAME_SIZE),
+                ('category', ctypes.c_char * ESPA_FORMATTER_NAME_SIZE),
+                ('data_units', ctypes.c_char * ESPA_FORMATTER_NAME_SIZE),
+                ('data_type', ctypes.c_int),
+                ('pixel_bytes', ctypes.c_int),
+                ('nlines', ctypes.c_int),
+                ('nsamps', ctypes.c_int),
+                ('pixel_size', ctypes.c_double * 2),
+                ('fill_value', ctypes.c_long),
+                ('has_fill_value', ctypes.c_int),
+                ('scale_factor', ctypes.c_double),
+                ('add_offset', ctypes.c_double)]
+# END Espa_formatter_band_info
+
+
+class EspaFormatterError(Exception):
+    '''
+    Description:
+      Raised when a call of the library fails, with the errors of the call
+    '''
+    pass
+# END EspaFormatterError
+
+
+'''
+The global variable that is the loaded library.  Only loaded when the first
+product is opened.
+'''
+__LIBRARY__ = None
+
+
+def load_library():
+    '''
+    Description:
+      Loads the library and declares the functions used here
+
+    Returns:
+      The loaded library
+    '''
+    global __LIBRARY__
+
+    if __LIBRARY__ is not None:
+        return __LIBRARY__
+
+    lib = ctypes.CDLL(os.environ.get('ESPA_FORMATTER_LIB',
+                                     'libespa_formatter.so.1'))
+
+    product_p = ctypes.c_void_p
+    lib.espa_formatter_init.restype = ctypes.c_int
+    lib.espa_formatter_last_error.restype = ctypes.c_char_p
+    lib.espa_formatter_open.argtypes = [ctypes.c_char_p,
+                                        ctypes.POINTER(product_p)]
+    lib.espa_formatter_close.argtypes = [product_p]
+    lib.espa_formatter_close.restype = None
+    lib.espa_formatter_nbands.argtypes = [product_p]
+    lib.espa_formatter_find_band.argtypes = [product_p, ctypes.c_char_p]
+    lib.espa_formatter_band_info.argtypes = [
+        product_p, ctypes.c_int, ctypes.POINTER(Espa_formatter_band_info)]
+    lib.espa_formatter_read_window.argtypes = [
+        product_p, ctypes.c_int, ctypes.c_int, ctypes.c_int, ctypes.c_int,
+        ctypes.c_int, ctypes.c_void_p]
+    lib.espa_formatter_map_band.argtypes = [
+        product_p, ctypes.c_int, ctypes.POINTER(ctypes.c_void_p),
+        ctypes.POINTER(ctypes.c_size_t)]
+    lib.espa_formatter_metadata_json.argtypes = [product_p]
+    lib.espa_formatter_metadata_json.restype = ctypes.c_void_p
+    lib.espa_formatter_free.argtypes = [ctypes.c_void_p]
+    lib.espa_formatter_free.restype = None
+
+    if lib.espa_formatter_init() != 0:
+        raise EspaFormatterError(lib.espa_formatter_last_error().decode())
+
+    __LIBRARY__ = lib
+    return lib
+# END load_library
+
+
+class _ProductHandle(object):
+    '''
+    Description:
+      Owns an open product of the library, and closes it when the last
+      reference is gone
+
+    Notes:
+      Every array over a mapped band holds a reference to the handle, so
+      the product isn't closed (and the bands aren't unmapped) while the
+      arrays are in use.
+    '''
+    def __init__(self, lib, xml_file):
+        self.lib = lib
+        self.product = ctypes.c_void_p()
+        if lib.espa_formatter_open(xml_file.encode(),
+                                   ctypes.byref(self.product)) != 0:
+            raise EspaFormatterError(lib.espa_formatter_last_error().decode())
+
+    def __del__(self):
+        if self.product:
+            self.lib.espa_formatter_close(self.product)
+            self.product = ctypes.c_void_p()
+# END _ProductHandle
+
+
+class Product(object):
+    '''
+    Description:
+      ESPA product opened from its XML metadata
+
+    Notes:
+      Usable as a context manager; leaving the context only drops the
+      reference of the product, so the arrays of its bands stay valid.
+    '''
+    def __init__(self, xml_file):
+        self._lib = load_library()
+        self._handle = _ProductHandle(self._lib, xml_file)
+        self._metadata = None
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, exc_type, exc_value, traceback):
+        self.close()
+        return False
+
+    def close(self):
+        '''
+        Description:
+          Drops the reference of the product to its handle, which is closed
+          once no array of its bands is left
+        '''
+        self._handle = None
+    # END close
+
+    def _raise_error(self):
+        raise EspaFormatterError(
+            self._lib.espa_formatter_last_error().decode())
+
+    def _product(self):
+        if self._handle is None:
+            raise EspaFormatterError('The product is closed')
+        return self._handle.product
+
+    @property
+    def metadata(self):
+        '''
+        Description:
+          Returns the metadata as a dictionary, with the global metadata in
+          'global' and the list of the band metadata in 'bands'
+
+        Notes:
+          Missing values are the fill values of the metadata (ex. -3333 and
+          'undefined'), as they are stored.
+        '''
+        if self._metadata is None:
+            ptr = self._lib.espa_formatter_metadata_json(self._product())
+            if not ptr:
+                self._raise_error()
+            try:
+                self._metadata = json.loads(
+                    ctypes.string_at(ptr).decode('utf-8', 'replace'))
+            finally:
+                self._lib.espa_formatter_free(ptr)
+
+        return self._metadata
+    # END metadata
+
+    @property
+    def band_names(self):
+        '''
+        Description:
+          Returns the names of the bands, in the order of their indexes
+        '''
+        return [band['name'] for band in self.metadata['bands']]
+    # END band_names
+
+    def band_index(self, band):
+        '''
+        Description:
+          Returns the index of a band given by its name or index
+        '''
+        if isinstance(band, int):
+            return band
+
+        index = self._lib.espa_formatter_find_band(self._product(),
+                                                   band.encode())
+        if index < 0:
+            raise KeyError(band)
+
+        return index
+    # END band_index
+
+    def band_info(self, band):
+        '''
+        Description:
+          Returns the Espa_formatter_band_info of a band
+        '''
+        info = Espa_formatter_band_info()
+        if self._lib.espa_formatter_band_info(
+                self._product(), self.band_index(band),
+                ctypes.byref(info)) != 0:
+            self._raise_error()
+
+        return info
+    # END band_info
+
+    def band(self, band):
+        '''
+        Description:
+          Returns all the pixels of a band as a read-only array of nlines by
+          nsamps
+
+        Notes:
+          Plain raw binary bands are not copied; the array is over the
+          mapped band file.  The other bands are read into a new array.
+        '''
+        index = self.band_index(band)
+        info = self.band_info(index)
+        dtype = __DATA_TYPES__[info.data_type]
+
+        data = ctypes.c_void_p()
+        nbytes = ctypes.c_size_t()
+        if self._lib.espa_formatter_map_band(
+                self._product(), index, ctypes.byref(data),
+                ctypes.byref(nbytes)) != 0:
+            array = self.read_window(index, 0, info.nlines, 0, info.nsamps)
+            array.flags.writeable = False
+            return array
+
+        # The ctypes buffer holds a reference to the handle, so the product
+        # stays open as long as the array (which holds the buffer) does
+        buf = (ctypes.c_char * nbytes.value).from_address(data.value)
+        buf._espa_handle = self._handle
+        array = numpy.frombuffer(buf, dtype=dtype).reshape(info.nlines,
+                                                           info.nsamps)
+        array.flags.writeable = False
+        return array
+    # END band
+
+    def read_window(self, band, line0, nlines, samp0, nsamps):
+        '''
+        Description:
+          Reads a window of lines and samples of a band into a new array of
+          nlines by nsamps
+        '''
+        index = self.band_index(band)
+        info = self.band_info(index)
+        array = numpy.empty((nlines, nsamps),
+                            dtype=__DATA_TYPES__[info.data_type])
+        if self._lib.espa_formatter_read_window(
+                self._product(), index, line0, nlines, samp0, nsamps,
+                array.ctypes.data) != 0:
+            self._raise_error()
+
+        return array
+    # END read_window
+# END Product
@@ -0,0 +1,2571 @@
+/*****************************************************************************
+FILE: espa_formatter.c
+
+PURPOSE: Contains the functions of the API of the libespa_formatter shared
+library (see espa_formatter.h).
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The library functions report their errors through error_handler, so
+     each API function captures the errors of its thread (see
+     capture_errors) in the buffer returned by espa_formatter_last_error.
+  2. The converters of the Level-1 products are declared here rather than
+     through their headers, so this file doesn't depend on the TIFF and HDF
+     headers (as in espa_export_fanout.h).
+  3. The metadata is written as JSON from tables of the fields of the
+     metadata structures, as in espa_meta_query.
+  4. The jobs (see espa_formatter_convert_async) wait in a queue of the
+     library, and only the job at the front is handed to the task pool, so
+     the queued jobs don't hold threads of the pool while the conversion or
+     export before them runs.
+*****************************************************************************/
+#include <limits.h>
+#include <math.h>
+#include <stddef.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
+#include "error_handler.h"
+#include "espa_task_pool.h"
+#include "espa_metadata.h"
+#include "parse_metadata.h"
+#include "raw_binary_io.h"
+#include "espa_band_stack.h"
+#include "espa_export_fanout.h"
+#include "espa_formatter.h"
+
+/* Defines */
+#define FORMATTER_ERROR_SIZE 4096  /* size of the error messages of a call */
+#define FORMATTER_MAX_SINKS 3      /* maximum number of export formats */
+
+/* Product opened from its XML metadata */
+struct Espa_formatter_product
+{
+    char xml_file[STR_SIZE];     /* absolute name of the XML metadata file */
+    Espa_internal_meta_t metadata;  /* metadata of the product, with the
+                                    absolute names of the band files */
+    int *fds;                    /* file descriptor of each band; -1 if not
+                                    opened yet */
+    Raw_binary_map_t *maps;      /* mapped view of each band; data is NULL
+                                    if not mapped yet */
+    pthread_mutex_t mutex;       /* guards opening and mapping the band
+                                    files */
+};
+
+/* Kinds of jobs */
+typedef enum
+{
+    JOB_CONVERT, JOB_EXPORT
+} Job_type_t;
+
+/* Conversion or export run in the background */
+struct Espa_formatter_job
+{
+    Job_type_t type;             /* kind of job */
+    Espa_formatter_source_t source;  /* type of the Level-1 product of a
+                                    conversion */
+    char input_file[STR_SIZE];   /* absolute name of the Level-1 product of
+                                    a conversion */
+    char xml_file[STR_SIZE];     /* absolute name of the XML metadata file
+                                    written by a conversion or exported */
+    char out_files[FORMATTER_MAX_SINKS][STR_SIZE];  /* absolute names of the
+                                    GeoTIFF, NetCDF, and HDF-EOS outputs of
+                                    an export; empty to skip the format */
+    Espa_formatter_job_callback_t callback;  /* completion callback; NULL if
+                                    none */
+    void *user_data;             /* passed to the callback */
+    Espa_formatter_job_state_t state;  /* state of the job; guarded by
+                                    job_mutex */
+    bool queued;                 /* is the job in the queue of jobs?
+                                    guarded by job_mutex */
+    int cancelled;               /* was the job cancelled? (atomic) */
+    int progress_done;           /* steps done so far (atomic) */
+    int progress_total;          /* number of steps of the job (atomic) */
+    int fd;                      /* eventfd signaled once the job is done */
+    int refs;                    /* references to the job, by the caller
+                                    and by the thread running it (atomic) */
+    char errors[FORMATTER_ERROR_SIZE];  /* errors of the job */
+    struct Espa_formatter_job *next;  /* next job in the queue of jobs */
+};
+
+/* Export sink passing the calls on to the sink of a format, for the
+   progress and cancellation of an export job */
+typedef struct
+{
+    Espa_export_sink_t sink;     /* sink the calls are passed on to */
+    Espa_formatter_job_t *job;   /* job of the export */
+} Job_sink_t;
+
+/* Types of the metadata fields written as JSON */
+typedef enum
+{
+    FIELD_STRING, FIELD_INT, FIELD_LONG, FIELD_FLOAT, FIELD_DOUBLE,
+    FIELD_DATA_TYPE, FIELD_RESAMPLE
+} Field_type_t;
+
+/* Metadata field written as JSON */
+typedef struct
+{
+    const char *name;         /* name of the field in the JSON */
+    Field_type_t type;        /* type of the field */
+    size_t offset;            /* offset of the field in its structure */
+    int count;                /* number of values in the field */
+} Meta_field_t;
+
+#define GLOBAL_FIELD(name, type, count) \
+    {#name, type, offsetof (Espa_global_meta_t, name), count}
+#define PROJ_FIELD(name, type, count) \
+    {#name, type, offsetof (Espa_proj_meta_t, name), count}
+#define BAND_FIELD(name, type, count) \
+    {#name, type, offsetof (Espa_band_meta_t, name), count}
+
+static const Meta_field_t global_fields[] =
+{
+    GLOBAL_FIELD (data_provider, FIELD_STRING, 1),
+    GLOBAL_FIELD (satellite, FIELD_STRING, 1),
+    GLOBAL_FIELD (instrument, FIELD_STRING, 1),
+    GLOBAL_FIELD (acquisition_date, FIELD_STRING, 1),
+    GLOBAL_FIELD (ul_corner, FIELD_DOUBLE, 2),
+    GLOBAL_FIELD (lr_corner, FIELD_DOUBLE, 2),
+    GLOBAL_FIELD (bounding_coords, FIELD_DOUBLE, 4),
+    GLOBAL_FIELD (footprint, FIELD_STRING, 1),
+    GLOBAL_FIELD (wrs_system, FIELD_INT, 1),
+    GLOBAL_FIELD (wrs_path, FIELD_INT, 1),
+    GLOBAL_FIELD (wrs_row, FIELD_INT, 1),
+    GLOBAL_FIELD (scene_center_time, FIELD_STRING, 1),
+    GLOBAL_FIELD (product_id, FIELD_STRING, 1),
+    GLOBAL_FIELD (lpgs_metadata_file, FIELD_STRING, 1),
+    GLOBAL_FIELD (orientation_angle, FIELD_FLOAT, 1),
+    GLOBAL_FIELD (solar_zenith, FIELD_FLOAT, 1),
+    GLOBAL_FIELD (solar_azimuth, FIELD_FLOAT, 1),
+    GLOBAL_FIELD (solar_units, FIELD_STRING, 1),
+    GLOBAL_FIELD (earth_sun_dist, FIELD_FLOAT, 1),
+    GLOBAL_FIELD (level1_production_date, FIELD_STRING, 1),
+    GLOBAL_FIELD (htile, FIELD_INT, 1),
+    GLOBAL_FIELD (vtile, FIELD_INT, 1),
+    GLOBAL_FIELD (view_zenith, FIELD_FLOAT, 1),
+    GLOBAL_FIELD (view_azimuth, FIELD_FLOAT, 1),
+    GLOBAL_FIELD (view_units, FIELD_STRING, 1),
+};
+
+static const Meta_field_t proj_fields[] =
+{
+    PROJ_FIELD (proj_type, FIELD_INT, 1),
+    PROJ_FIELD (datum_type, FIELD_INT, 1),
+    PROJ_FIELD (units, FIELD_STRING, 1),
+    PROJ_FIELD (ul_corner, FIELD_DOUBLE, 2),
+    PROJ_FIELD (lr_corner, FIELD_DOUBLE, 2),
+    PROJ_FIELD (grid_origin, FIELD_STRING, 1),
+    PROJ_FIELD (utm_zone, FIELD_INT, 1),
+    PROJ_FIELD (longitude_pole, FIELD_DOUBLE, 1),
+    PROJ_FIELD (latitude_true_scale, FIELD_DOUBLE, 1),
+    PROJ_FIELD (false_easting, FIELD_DOUBLE, 1),
+    PROJ_FIELD (false_northing, FIELD_DOUBLE, 1),
+    PROJ_FIELD (standard_parallel1, FIELD_DOUBLE, 1),
+    PROJ_FIELD (standard_parallel2, FIELD_DOUBLE, 1),
+    PROJ_FIELD (central_meridian, FIELD_DOUBLE, 1),
+    PROJ_FIELD (origin_latitude, FIELD_DOUBLE, 1),
+    PROJ_FIELD (sphere_radius, FIELD_DOUBLE, 1),
+};
+
+static const Meta_field_t band_fields[] =
+{
+    BAND_FIELD (product, FIELD_STRING, 1),
+    BAND_FIELD (source, FIELD_STRING, 1),
+    BAND_FIELD (name, FIELD_STRING, 1),
+    BAND_FIELD (category, FIELD_STRING, 1),
+    BAND_FIELD (data_type, FIELD_DATA_TYPE, 1),
+    BAND_FIELD (nlines, FIELD_INT, 1),
+    BAND_FIELD (nsamps, FIELD_INT, 1),
+    BAND_FIELD (fill_value, FIELD_LONG, 1),
+    BAND_FIELD (saturate_value, FIELD_INT, 1),
+    BAND_FIELD (scale_factor, FIELD_FLOAT, 1),
+    BAND_FIELD (add_offset, FIELD_FLOAT, 1),
+    BAND_FIELD (constant_value, FIELD_DOUBLE, 1),
+    BAND_FIELD (footprint_file, FIELD_STRING, 1),
+    BAND_FIELD (overview_file, FIELD_STRING, 1),
+    BAND_FIELD (overview_levels, FIELD_INT, 1),
+    BAND_FIELD (encoding, FIELD_STRING, 1),
+    BAND_FIELD (tile_size, FIELD_INT, 1),
+    BAND_FIELD (file_offset, FIELD_LONG, 1),
+    BAND_FIELD (checksum, FIELD_STRING, 1),
+    BAND_FIELD (resample_method, FIELD_RESAMPLE, 1),
+    BAND_FIELD (short_name, FIELD_STRING, 1),
+    BAND_FIELD (long_name, FIELD_STRING, 1),
+    BAND_FIELD (file_name, FIELD_STRING, 1),
+    BAND_FIELD (pixel_size, FIELD_DOUBLE, 2),
+    BAND_FIELD (pixel_units, FIELD_STRING, 1),
+    BAND_FIELD (data_units, FIELD_STRING, 1),
+    BAND_FIELD (valid_range, FIELD_DOUBLE, 2),
+    BAND_FIELD (stats.valid_count, FIELD_LONG, 1),
+    BAND_FIELD (stats.min, FIELD_DOUBLE, 1),
+    BAND_FIELD (stats.max, FIELD_DOUBLE, 1),
+    BAND_FIELD (stats.mean, FIELD_DOUBLE, 1),
+    BAND_FIELD (stats.stddev, FIELD_DOUBLE, 1),
+    BAND_FIELD (rad_gain, FIELD_DOUBLE, 1),
+    BAND_FIELD (rad_bias, FIELD_DOUBLE, 1),
+    BAND_FIELD (refl_gain, FIELD_DOUBLE, 1),
+    BAND_FIELD (refl_bias, FIELD_DOUBLE, 1),
+    BAND_FIELD (k1_const, FIELD_DOUBLE, 1),
+    BAND_FIELD (k2_const, FIELD_DOUBLE, 1),
+    BAND_FIELD (qa_desc, FIELD_STRING, 1),
+    BAND_FIELD (app_version, FIELD_STRING, 1),
+    BAND_FIELD (l1_filename, FIELD_STRING, 1),
+    BAND_FIELD (production_date, FIELD_STRING, 1),
+};
+
+/* Converters of the Level-1 products; see convert_lpgs_to_espa.h and
+   convert_modis_to_espa.h */
+int convert_lpgs_to_espa (char *lpgs_mtl_file, char *espa_xml_file,
+    bool del_src, bool browse);
+int convert_lpgs_archive_to_espa (char *archive_file, char *espa_xml_file,
+    bool del_src, bool browse);
+int convert_modis_to_espa (char *modis_hdf_file, char *espa_xml_file,
+    bool del_src, bool browse);
+
+static pthread_once_t formatter_once = PTHREAD_ONCE_INIT;
+static int formatter_status = ERROR;  /* status of the initialization */
+static char formatter_init_error[FORMATTER_ERROR_SIZE];  /* errors of the
+                                    initialization */
+static pthread_mutex_t engine_mutex = PTHREAD_MUTEX_INITIALIZER;  /* allows
+                                    one conversion or export at a time */
+static __thread char last_error[FORMATTER_ERROR_SIZE];  /* errors of the
+                                    last call of the thread */
+static pthread_mutex_t job_mutex = PTHREAD_MUTEX_INITIALIZER;  /* guards the
+                                    queue of jobs and their states */
+static pthread_cond_t job_cond = PTHREAD_COND_INITIALIZER;  /* signaled
+                                    when a job is done */
+static Espa_formatter_job_t *job_head = NULL;  /* first job of the queue */
+static Espa_formatter_job_t *job_tail = NULL;  /* last job of the queue */
+static bool job_running = false;  /* was a job handed to the task pool? */
+static Espa_task_group_t job_group = {0, SUCCESS};  /* group of the jobs
+                                    handed to the task pool; never waited
+                                    for */
+
+
+/******************************************************************************
+MODULE:  init_formatter
+
+PURPOSE:  Initializes libxml2 and compiles the ESPA schema, once for the
+process.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. Run through pthread_once, so the status and errors are kept for the
+     later callers.
+******************************************************************************/
+static void init_formatter (void)
+{
+    char FUNC_NAME[] = "init_formatter";   /* function name */
+    char errmsg[STR_SIZE];                 /* error message */
+
+    capture_errors (formatter_init_error, sizeof (formatter_init_error));
+    init_espa_xml ();
+    if (get_espa_schema () == NULL)
+    {
+        sprintf (errmsg, "Loading the ESPA schema");
+        error_handler (true, FUNC_NAME, errmsg);
+        formatter_status = ERROR;
+    }
+    else
+        formatter_status = SUCCESS;
+    capture_errors (NULL, 0);
+}
+
+
+/******************************************************************************
+MODULE:  begin_call
+
+PURPOSE:  Starts capturing the errors of an API call in the calling thread,
+initializing the library first if needed.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           The library couldn't be initialized
+SUCCESS         The library is ready
+
+NOTES:
+  1. end_call must be called once the call is done, even if this failed.
+******************************************************************************/
+static int begin_call (void)
+{
+    pthread_once (&formatter_once, init_formatter);
+    capture_errors (last_error, sizeof (last_error));
+    if (formatter_status != SUCCESS)
+    {
+        snprintf (last_error, sizeof (last_error), "%s",
+            formatter_init_error);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  end_call
+
+PURPOSE:  Stops capturing the errors of an API call.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ESPA_FORMATTER_ERROR    The call failed
+ESPA_FORMATTER_SUCCESS  The call succeeded
+
+NOTES:
+******************************************************************************/
+static int end_call
+(
+    int status           /* I: status of the call */
+)
+{
+    capture_errors (NULL, 0);
+    if (status != SUCCESS)
+        return (ESPA_FORMATTER_ERROR);
+
+    last_error[0] = '\0';
+    return (ESPA_FORMATTER_SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  absolute_path
+
+PURPOSE:  Makes a filename absolute, relative to a directory.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           The absolute name doesn't fit
+SUCCESS         abs_path holds the absolute name
+
+NOTES:
+  1. Absolute names and URLs (ex. s3://bucket/band.img) are copied as they
+     are.
+******************************************************************************/
+static int absolute_path
+(
+    const char *dir,     /* I: directory path is relative to, with no
+                               trailing slash */
+    const char *path,    /* I: filename */
+    char *abs_path       /* O: absolute filename; STR_SIZE characters */
+)
+{
+    char FUNC_NAME[] = "absolute_path";   /* function name */
+    char errmsg[STR_SIZE];  /* error message */
+    int count;              /* number of chars copied in snprintf */
+
+    if (path[0] == '/' || strstr (path, "://") != NULL)
+        count = snprintf (abs_path, STR_SIZE, "%s", path);
+    else
+        count = snprintf (abs_path, STR_SIZE, "%s/%s", dir, path);
+    if (count < 0 || count >= STR_SIZE)
+    {
+        sprintf (errmsg, "Overflow of the absolute name of %.200s", path);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  absolute_cwd_path
+
+PURPOSE:  Makes a filename absolute, relative to the working directory.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error getting the working directory, or the name doesn't
+                fit
+SUCCESS         abs_path holds the absolute name
+
+NOTES:
+******************************************************************************/
+static int absolute_cwd_path
+(
+    const char *path,    /* I: filename */
+    char *abs_path       /* O: absolute filename; STR_SIZE characters */
+)
+{
+    char FUNC_NAME[] = "absolute_cwd_path";   /* function name */
+    char errmsg[STR_SIZE];  /* error message */
+    char cwd[PATH_MAX];     /* working directory */
+
+    if (getcwd (cwd, sizeof (cwd)) == NULL)
+    {
+        sprintf (errmsg, "Getting the working directory");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (absolute_path (cwd, path, abs_path));
+}
+
+
+/******************************************************************************
+MODULE:  resolve_band_files
+
+PURPOSE:  Makes the names of the band files (and footprint indexes and
+overviews) of the metadata absolute, relative to the directory of the XML file.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           A name doesn't fit
+SUCCESS         The names are absolute
+
+NOTES:
+  1. The XML metadata holds the band files without their path, since they
+     are next to the XML file.
+******************************************************************************/
+static int resolve_band_files
+(
+    const char *xml_file,           /* I: absolute name of the XML file */
+    Espa_internal_meta_t *metadata  /* I/O: metadata of the product */
+)
+{
+    char xml_dir[STR_SIZE];   /* directory of the XML file */
+    char abs_path[STR_SIZE];  /* absolute name of the current file */
+    char *cptr = NULL;        /* last slash of the XML file */
+    int i;                    /* looping variable for the bands */
+    Espa_band_meta_t *bmeta = NULL;   /* metadata of the current band */
+
+    strcpy (xml_dir, xml_file);
+    cptr = strrchr (xml_dir, '/');
+    if (cptr != NULL)
+        *cptr = '\0';
+
+    for (i = 0; i < metadata->nbands; i++)
+    {
+        bmeta = &metadata->band[i];
+        if (!is_constant_band (bmeta))
+        {
+            if (absolute_path (xml_dir, bmeta->file_name, abs_path)
+                != SUCCESS)
+                return (ERROR);
+            strcpy (bmeta->file_name, abs_path);
+        }
+        if (strcmp (bmeta->footprint_file, ESPA_STRING_META_FILL))
+        {
+            if (absolute_path (xml_dir, bmeta->footprint_file, abs_path)
+                != SUCCESS)
+                return (ERROR);
+            strcpy (bmeta->footprint_file, abs_path);
+        }
+        if (strcmp (bmeta->overview_file, ESPA_STRING_META_FILL))
+        {
+            if (absolute_path (xml_dir, bmeta->overview_file, abs_path)
+                != SUCCESS)
+                return (ERROR);
+            strcpy (bmeta->overview_file, abs_path);
+        }
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  espa_formatter_init
+
+PURPOSE:  Initializes the library.
+
+RETURN VALUE:
+Type = int
+Value                   Description
+-----                   -----------
+ESPA_FORMATTER_ERROR    Error initializing the library (ex. the ESPA schema
+                        wasn't found)
+ESPA_FORMATTER_SUCCESS  The library is ready
+
+NOTES:
+  1. The other functions initialize the library as well, but calling this
+     first reports a missing schema before any product is opened.
+  2. libxml2 is initialized here; the caller shouldn't clean it up while
+     the library is in use.
+******************************************************************************/
+int espa_formatter_init (void)
+{
+    return (end_call (begin_call ()));
+}
+
+
+/******************************************************************************
+MODULE:  espa_formatter_version
+
+PURPOSE:  Returns the version of the ESPA libraries the library was built
+from.
+
+RETURN VALUE:
+Type = const char *
+Value           Description
+-----           -----------
+version         ESPA_COMMON_VERSION
+
+NOTES:
+******************************************************************************/
+const char *espa_formatter_version (void)
+{
+    return (ESPA_COMMON_VERSION);
+}
+
+
+/******************************************************************************
+MODULE:  espa_formatter_last_error
+
+PURPOSE:  Returns the error messages of the last failed call of the calling
+thread.
+
+RETURN VALUE:
+Type = const char *
+Value           Description
+-----           -----------
+messages        One "module: message" per line, the first being where the
+                error happened; empty if the last call succeeded
+
+NOTES:
+  1. The messages are kept until the next call of the thread.
+******************************************************************************/
+const char *espa_formatter_last_error (void)
+{
+    return (last_error);
+}
+
+
+/******************************************************************************
+MODULE:  open_product
+
+PURPOSE:  Validates and parses the XML metadata of a product into a new
+product handle.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error opening the product
+SUCCESS         The product is open
+
+NOTES:
+******************************************************************************/
+static int open_product
+(
+    const char *xml_file,    /* I: XML metadata file of the ESPA product */
+    Espa_formatter_product_t **product  /* O: handle of the product */
+)
+{
+    char FUNC_NAME[] = "open_product";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    int i;                    /* looping variable for the bands */
+    Espa_formatter_product_t *prod = NULL;  /* product being opened */
+
+    prod = calloc (1, sizeof (Espa_formatter_product_t));
+    if (prod == NULL)
+    {
+        sprintf (errmsg, "Allocating the product handle");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    init_metadata_struct (&prod->metadata);
+
+    if (absolute_cwd_path (xml_file, prod->xml_file) != SUCCESS ||
+        validate_and_parse_metadata (prod->xml_file, &prod->metadata)
+        != SUCCESS ||
+        resolve_band_files (prod->xml_file, &prod->metadata) != SUCCESS)
+    {
+        sprintf (errmsg, "Opening the product %.200s", xml_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        free_metadata (&prod->metadata);
+        free (prod);
+        return (ERROR);
+    }
+
+    prod->fds = malloc ((prod->metadata.nbands + 1) * sizeof (int));
+    prod->maps = calloc (prod->metadata.nbands + 1,
+        sizeof (Raw_binary_map_t));
+    if (prod->fds == NULL || prod->maps == NULL)
+    {
+        sprintf (errmsg, "Allocating the band files of %.200s", xml_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        free (prod->fds);
+        free (prod->maps);
+        free_metadata (&prod->metadata);
+        free (prod);
+        return (ERROR);
+    }
+    for (i = 0; i < prod->metadata.nbands; i++)
+        prod->fds[i] = -1;
+    pthread_mutex_init (&prod->mutex, NULL);
+
+    *product = prod;
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  espa_formatter_open
+
+PURPOSE:  Opens an ESPA product from its XML metadata.
+
+RETURN VALUE:
+Type = int
+Value                   Description
+-----                   -----------
+ESPA_FORMATTER_ERROR    Error opening the product; *product is NULL
+ESPA_FORMATTER_SUCCESS  The product is open
+
+NOTES:
+  1. The metadata is validated against the ESPA schema.  The band files are
+     opened when they are first read.
+******************************************************************************/
+int espa_formatter_open
+(
+    const char *xml_file,    /* I: XML metadata file of the ESPA product */
+    Espa_formatter_product_t **product  /* O: handle of the product; free
+                                    with espa_formatter_close */
+)
+{
+    int status;               /* status of the call */
+
+    *product = NULL;
+    status = begin_call ();
+    if (status == SUCCESS)
+        status = open_product (xml_file, product);
+
+    return (end_call (status));
+}
+
+
+/******************************************************************************
+MODULE:  espa_formatter_close
+
+PURPOSE:  Closes a product and frees its handle.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. The product mustn't be in use by another thread.
+  2. The mapped views of the bands (see espa_formatter_map_band) are
+     unmapped, so they mustn't be used after the product is closed.
+******************************************************************************/
+void espa_formatter_close
+(
+    Espa_formatter_product_t *product   /* I: product to be closed; may be
+                                    NULL */
+)
+{
+    int i;                    /* looping variable for the bands */
+
+    if (product == NULL)
+        return;
+
+    for (i = 0; i < product->metadata.nbands; i++)
+    {
+        if (product->fds[i] >= 0)
+            close_raw_binary_fd (product->fds[i]);
+        if (product->maps[i].data != NULL)
+            unmap_raw_binary (&product->maps[i]);
+    }
+    free (product->fds);
+    free (product->maps);
+    pthread_mutex_destroy (&product->mutex);
+    free_metadata (&product->metadata);
+    free (product);
+}
+
+
+/******************************************************************************
+MODULE:  espa_formatter_nbands
+
+PURPOSE:  Returns the number of bands of a product.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+n               Number of bands
+
+NOTES:
+******************************************************************************/
+int espa_formatter_nbands
+(
+    const Espa_formatter_product_t *product  /* I: product */
+)
+{
+    return (product->metadata.nbands);
+}
+
+
+/******************************************************************************
+MODULE:  espa_formatter_find_band
+
+PURPOSE:  Finds a band of a product by its name.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+-1              The product has no band of that name
+n               0-based index of the band
+
+NOTES:
+******************************************************************************/
+int espa_formatter_find_band
+(
+    const Espa_formatter_product_t *product, /* I: product */
+    const char *band_name    /* I: name of the band */
+)
+{
+    int i;                    /* looping variable for the bands */
+
+    for (i = 0; i < product->metadata.nbands; i++)
+    {
+        if (!strcmp (product->metadata.band[i].name, band_name))
+            return (i);
+    }
+
+    return (-1);
+}
+
+
+/******************************************************************************
+MODULE:  get_band
+
+PURPOSE:  Returns the metadata of a band of a product, checking the index.
+
+RETURN VALUE:
+Type = const Espa_band_meta_t *
+Value           Description
+-----           -----------
+NULL            The index is out of range
+band            Metadata of the band
+
+NOTES:
+******************************************************************************/
+static const Espa_band_meta_t *get_band
+(
+    const Espa_formatter_product_t *product, /* I: product */
+    int band                 /* I: 0-based index of the band */
+)
+{
+    char FUNC_NAME[] = "get_band";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+
+    if (band < 0 || band >= product->metadata.nbands)
+    {
+        sprintf (errmsg, "Band %d is out of range; the product has %d bands",
+            band, product->metadata.nbands);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (NULL);
+    }
+
+    return (&product->metadata.band[band]);
+}
+
+
+/******************************************************************************
+MODULE:  espa_formatter_band_info
+
+PURPOSE:  Returns the information about a band of a product.
+
+RETURN VALUE:
+Type = int
+Value                   Description
+-----                   -----------
+ESPA_FORMATTER_ERROR    The index is out of range
+ESPA_FORMATTER_SUCCESS  info holds the information about the band
+
+NOTES:
+******************************************************************************/
+int espa_formatter_band_info
+(
+    const Espa_formatter_product_t *product, /* I: product */
+    int band,                /* I: 0-based index of the band */
+    Espa_formatter_band_info_t *info  /* O: information about the band */
+)
+{
+    int status;               /* status of the call */
+    const Espa_band_meta_t *bmeta = NULL;   /* metadata of the band */
+
+    status = begin_call ();
+    if (status == SUCCESS)
+    {
+        bmeta = get_band (product, band);
+        if (bmeta == NULL)
+            status = ERROR;
+    }
+    if (status != SUCCESS)
+        return (end_call (status));
+
+    memset (info, 0, sizeof (Espa_formatter_band_info_t));
+    snprintf (info->name, sizeof (info->name), "%s", bmeta->name);
+    snprintf (info->product, sizeof (info->product), "%s", bmeta->product);
+    snprintf (info->category, sizeof (info->category), "%s",
+        bmeta->category);
+    snprintf (info->data_units, sizeof (info->data_units), "%s",
+        bmeta->data_units);
+
+    /* The data types are listed in the same order as Espa_data_type */
+    info->data_type = (Espa_formatter_data_type_t) bmeta->data_type;
+    info->pixel_bytes = espa_data_type_size (bmeta->data_type);
+    info->nlines = bmeta->nlines;
+    info->nsamps = bmeta->nsamps;
+    info->pixel_size[0] = bmeta->pixel_size[0];
+    info->pixel_size[1] = bmeta->pixel_size[1];
+    info->has_fill_value = (bmeta->fill_value != ESPA_INT_META_FILL);
+    info->fill_value = bmeta->fill_value;
+    info->scale_factor = (fabs (bmeta->scale_factor - ESPA_FLOAT_META_FILL)
+        < ESPA_EPSILON) ? 1.0 : bmeta->scale_factor;
+    info->add_offset = (fabs (bmeta->add_offset - ESPA_FLOAT_META_FILL)
+        < ESPA_EPSILON) ? 0.0 : bmeta->add_offset;
+
+    return (end_call (SUCCESS));
+}
+
+
+/******************************************************************************
+MODULE:  read_window
+
+PURPOSE:  Reads a window of a band of a product, opening the band file the
+first time it is read.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error reading the window
+SUCCESS         buf holds the window
+
+NOTES:
+  1. Only opening the band file is done under the lock of the product; the
+     reads are positional, so the windows of a band are read at the same
+     time by multiple threads.
+******************************************************************************/
+static int read_window
+(
+    Espa_formatter_product_t *product, /* I: product */
+    int band,                /* I: 0-based index of the band */
+    int line0,               /* I: 0-based first line of the window */
+    int nlines,              /* I: number of lines in the window */
+    int samp0,               /* I: 0-based first sample of the window */
+    int nsamps,              /* I: number of samples in the window */
+    void *buf                /* O: pixels of the window */
+)
+{
+    char FUNC_NAME[] = "read_window";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    double pixel[1];          /* value of a constant band; aligned for any
+                                 data type */
+    int size;                 /* number of bytes per pixel */
+    int fd;                   /* band file */
+    Espa_band_meta_t *bmeta = NULL;   /* metadata of the band */
+
+    if (get_band (product, band) == NULL)
+        return (ERROR);
+    bmeta = &product->metadata.band[band];
+
+    if (line0 < 0 || samp0 < 0 || nlines < 1 || nsamps < 1 ||
+        line0 + nlines > bmeta->nlines || samp0 + nsamps > bmeta->nsamps)
+    {
+        sprintf (errmsg, "Window of lines %d-%d and samples %d-%d is outside "
+            "band %s (%d lines, %d samples)", line0, line0 + nlines - 1,
+            samp0, samp0 + nsamps - 1, bmeta->name, bmeta->nlines,
+            bmeta->nsamps);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    size = espa_data_type_size (bmeta->data_type);
+    if (size <= 0)
+    {
+        sprintf (errmsg, "Unsupported data type of band %s", bmeta->name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Constant bands have no file */
+    if (is_constant_band (bmeta))
+    {
+        if (espa_constant_pixel (bmeta, pixel) != SUCCESS)
+        {
+            sprintf (errmsg, "Getting the value of constant band %s",
+                bmeta->name);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+        read_raw_binary_constant (nlines, nsamps, size, pixel, buf);
+        return (SUCCESS);
+    }
+
+    pthread_mutex_lock (&product->mutex);
+    if (product->fds[band] < 0)
+        product->fds[band] = open_raw_binary_band_fd (bmeta->file_name,
+            bmeta->file_offset, false);
+    fd = product->fds[band];
+    pthread_mutex_unlock (&product->mutex);
+    if (fd < 0)
+    {
+        sprintf (errmsg, "Opening band %s: %.200s", bmeta->name,
+            bmeta->file_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    if (read_raw_binary_window (fd, bmeta->nsamps, line0, nlines, samp0,
+        nsamps, size, buf) != SUCCESS)
+    {
+        sprintf (errmsg, "Reading lines %d-%d of band %s", line0,
+            line0 + nlines - 1, bmeta->name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  espa_formatter_read_window
+
+PURPOSE:  Reads a window of lines and samples of a band of a product.
+
+RETURN VALUE:
+Type = int
+Value                   Description
+-----                   -----------
+ESPA_FORMATTER_ERROR    Error reading the window, or the window is outside
+                        the band
+ESPA_FORMATTER_SUCCESS  buf holds the window
+
+NOTES:
+  1. The block-compressed, stacked, and constant bands are read the same way
+     as the plain raw binary bands.
+******************************************************************************/
+int espa_formatter_read_window
+(
+    Espa_formatter_product_t *product, /* I: product */
+    int band,                /* I: 0-based index of the band */
+    int line0,               /* I: 0-based first line of the window */
+    int nlines,              /* I: number of lines in the window */
+    int samp0,               /* I: 0-based first sample of the window */
+    int nsamps,              /* I: number of samples in the window */
+    void *buf                /* O: nlines * nsamps pixels of the window, in
+                                   the native byte order; at least
+                                   nlines * nsamps * pixel_bytes bytes */
+)
+{
+    int status;               /* status of the call */
+
+    status = begin_call ();
+    if (status == SUCCESS)
+        status = read_window (product, band, line0, nlines, samp0, nsamps,
+            buf);
+
+    return (end_call (status));
+}
+
+
+/******************************************************************************
+MODULE:  map_band
+
+PURPOSE:  Maps a band of a product read-only, the first time it is asked
+for.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           The band can't be mapped
+SUCCESS         *data points to the mapped band
+
+NOTES:
+  1. Only plain raw binary bands in local files can be mapped, since the
+     pixels of the other bands aren't stored as they are read.
+******************************************************************************/
+static int map_band
+(
+    Espa_formatter_product_t *product, /* I: product */
+    int band,                /* I: 0-based index of the band */
+    const void **data,       /* O: first pixel of the band */
+    size_t *nbytes           /* O: number of bytes in the band */
+)
+{
+    char FUNC_NAME[] = "map_band";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    int size;                 /* number of bytes per pixel */
+    int status = SUCCESS;     /* status of mapping the band */
+    Espa_band_meta_t *bmeta = NULL;   /* metadata of the band */
+    Raw_binary_map_t *rb_map = NULL;  /* mapped view of the band */
+
+    if (get_band (product, band) == NULL)
+        return (ERROR);
+    bmeta = &product->metadata.band[band];
+
+    if (is_constant_band (bmeta))
+    {
+        sprintf (errmsg, "Constant band %s has no file to be mapped",
+            bmeta->name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    if (strcmp (bmeta->encoding, ESPA_STRING_META_FILL))
+    {
+        sprintf (errmsg, "Band %s is %s encoded and can't be mapped",
+            bmeta->name, bmeta->encoding);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    if (strstr (bmeta->file_name, "://") != NULL)
+    {
+        sprintf (errmsg, "Band %s is a remote file and can't be mapped",
+            bmeta->name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    size = espa_data_type_size (bmeta->data_type);
+    if (size <= 0)
+    {
+        sprintf (errmsg, "Unsupported data type of band %s", bmeta->name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    rb_map = &product->maps[band];
+    pthread_mutex_lock (&product->mutex);
+    if (rb_map->data == NULL)
+        status = map_raw_binary_band (bmeta->file_name, bmeta->file_offset,
+            bmeta->nlines, bmeta->nsamps, size, false, RB_ADVISE_NORMAL,
+            rb_map);
+    pthread_mutex_unlock (&product->mutex);
+    if (status != SUCCESS)
+    {
+        sprintf (errmsg, "Mapping band %s: %.200s", bmeta->name,
+            bmeta->file_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    *data = rb_map->data;
+    *nbytes = rb_map->nbytes;
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  espa_formatter_map_band
+
+PURPOSE:  Returns a read-only view of all the pixels of a band of a product,
+mapped from its file.
+
+RETURN VALUE:
+Type = int
+Value                   Description
+-----                   -----------
+ESPA_FORMATTER_ERROR    The band can't be mapped (ex. it is constant or
+                        block-compressed); read it with
+                        espa_formatter_read_window instead
+ESPA_FORMATTER_SUCCESS  *data points to the first pixel of the band
+
+NOTES:
+  1. The band is mapped the first time it is asked for and stays mapped
+     until the product is closed; later calls return the same view.  The
+     pages are read from the file as they are touched, and nothing is
+     copied.
+  2. The view holds nlines * nsamps pixels in line order and native byte
+     order, and may be read by any number of threads.
+******************************************************************************/
+int espa_formatter_map_band
+(
+    Espa_formatter_product_t *product, /* I: product */
+    int band,                /* I: 0-based index of the band */
+    const void **data,       /* O: first pixel of the band; valid until the
+                                   product is closed */
+    size_t *nbytes           /* O: number of bytes in the band */
+)
+{
+    int status;               /* status of the call */
+
+    *data = NULL;
+    *nbytes = 0;
+    status = begin_call ();
+    if (status == SUCCESS)
+        status = map_band (product, band, data, nbytes);
+
+    return (end_call (status));
+}
+
+
+/******************************************************************************
+MODULE:  write_json_string
+
+PURPOSE:  Writes a string as a quoted JSON string.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+static void write_json_string
+(
+    FILE *out,                /* I: output stream */
+    const char *str           /* I: string to be written */
+)
+{
+    const char *ptr;          /* current character of the string */
+
+    fputc ('"', out);
+    for (ptr = str; *ptr; ptr++)
+    {
+        if (*ptr == '"' || *ptr == '\\')
+            fprintf (out, "\\%c", *ptr);
+        else if ((unsigned char) *ptr < 0x20)
+            fprintf (out, "\\u%04x", (unsigned char) *ptr);
+        else
+            fputc (*ptr, out);
+    }
+    fputc ('"', out);
+}
+
+
+/******************************************************************************
+MODULE:  write_json_fields
+
+PURPOSE:  Writes the fields of a metadata structure as the members of a JSON
+object.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. Fields with more than one value are written as JSON arrays.
+  2. The values are written as they are stored, so missing values are the
+     fill values of the metadata (ex. -3333 and "undefined").
+******************************************************************************/
+static void write_json_fields
+(
+    FILE *out,                /* I: output stream */
+    const Meta_field_t *fields,  /* I: fields to be written */
+    int nfields,              /* I: number of fields */
+    const void *base          /* I: structure holding the fields */
+)
+{
+    static const char *data_types[] = {"INT8", "UINT8", "INT16", "UINT16",
+        "INT32", "UINT32", "FLOAT32", "FLOAT64"};
+    static const char *resample_types[] = {"cubic convolution",
+        "nearest neighbor", "bilinear", "none"};
+    const char *ptr;          /* current field */
+    int value;                /* enumerated value */
+    int i, j;                 /* looping variables */
+
+    for (i = 0; i < nfields; i++)
+    {
+        ptr = (const char *) base + fields[i].offset;
+        fprintf (out, "%s\"%s\": ", i > 0 ? ", " : "", fields[i].name);
+        if (fields[i].count > 1)
+            fputc ('[', out);
+        for (j = 0; j < fields[i].count; j++)
+        {
+            if (j > 0)
+                fputs (", ", out);
+            switch (fields[i].type)
+            {
+                case FIELD_STRING:
+                    write_json_string (out, ptr);
+                    break;
+                case FIELD_INT:
+                    fprintf (out, "%d", ((const int *) ptr)[j]);
+                    break;
+                case FIELD_LONG:
+                    fprintf (out, "%ld", ((const long *) ptr)[j]);
+                    break;
+                case FIELD_FLOAT:
+                    fprintf (out, "%.7g", ((const float *) ptr)[j]);
+                    break;
+                case FIELD_DOUBLE:
+                    fprintf (out, "%.15g", ((const double *) ptr)[j]);
+                    break;
+                case FIELD_DATA_TYPE:
+                    value = *(const enum Espa_data_type *) ptr;
+                    write_json_string (out, value >= 0 &&
+                        value <= ESPA_FLOAT64 ? data_types[value] :
+                        ESPA_STRING_META_FILL);
+                    break;
+                case FIELD_RESAMPLE:
+                    value = *(const enum Espa_resampling_type *) ptr;
+                    write_json_string (out, value >= 0 &&
+                        value <= ESPA_NONE ? resample_types[value] :
+                        ESPA_STRING_META_FILL);
+                    break;
+            }
+        }
+        if (fields[i].count > 1)
+            fputc (']', out);
+    }
+}
+
+
+/******************************************************************************
+MODULE:  write_json_band
+
+PURPOSE:  Writes the metadata of a band as a JSON object.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. The bit descriptions are written as an array indexed by the bit
+     number, and the classes and cover types as arrays of objects.
+******************************************************************************/
+static void write_json_band
+(
+    FILE *out,                /* I: output stream */
+    const Espa_band_meta_t *bmeta  /* I: metadata of the band */
+)
+{
+    int i;                    /* looping variable */
+
+    fputc ('{', out);
+    write_json_fields (out, band_fields,
+        sizeof (band_fields) / sizeof (band_fields[0]), bmeta);
+
+    fputs (", \"bitmap_description\": [", out);
+    for (i = 0; i < bmeta->nbits; i++)
+    {
+        if (i > 0)
+            fputs (", ", out);
+        write_json_string (out, bmeta->bitmap_description[i]);
+    }
+
+    fputs ("], \"class_values\": [", out);
+    for (i = 0; i < bmeta->nclass; i++)
+    {
+#ifdef ESPA_USE_CPP_CLASS_VAL
+        fprintf (out, "%s{\"class\": %d, \"description\": ", i > 0 ? ", " : "",
+            bmeta->class_values[i].espa_class);
+#else
+        fprintf (out, "%s{\"class\": %d, \"description\": ", i > 0 ? ", " : "",
+            bmeta->class_values[i].class);
+#endif
+        write_json_string (out, bmeta->class_values[i].description);
+        fputc ('}', out);
+    }
+
+    fputs ("], \"percent_cover\": [", out);
+    for (i = 0; i < bmeta->ncover; i++)
+    {
+        fprintf (out, "%s{\"percent\": %.7g, \"description\": ",
+            i > 0 ? ", " : "", bmeta->percent_cover[i].percent);
+        write_json_string (out, bmeta->percent_cover[i].description);
+        fputc ('}', out);
+    }
+    fputs ("]}", out);
+}
+
+
+/******************************************************************************
+MODULE:  espa_formatter_metadata_json
+
+PURPOSE:  Returns the metadata of a product as JSON.
+
+RETURN VALUE:
+Type = char *
+Value           Description
+-----           -----------
+NULL            Error allocating the JSON
+json            JSON of the metadata; free with espa_formatter_free
+
+NOTES:
+  1. The JSON is written from the metadata parsed when the product was
+     opened, so the XML isn't parsed again.  It is an object with the
+     members xml_file, namespace, global (with the projection in proj_info),
+     and bands, which is an array of the band objects in the order of the
+     band indexes.  The band file names are absolute.
+  2. The values are written as they are stored, so missing values are the
+     fill values of the metadata (ex. -3333 and "undefined").
+******************************************************************************/
+char *espa_formatter_metadata_json
+(
+    const Espa_formatter_product_t *product  /* I: product */
+)
+{
+    char FUNC_NAME[] = "espa_formatter_metadata_json"; /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    char *json = NULL;        /* JSON of the metadata */
+    size_t json_size;         /* length of the JSON */
+    int write_error;          /* did writing the JSON fail? */
+    int i;                    /* looping variable for the bands */
+    FILE *out = NULL;         /* stream writing the JSON */
+    const Espa_internal_meta_t *metadata = &product->metadata;
+                              /* metadata of the product */
+
+    if (begin_call () != SUCCESS)
+    {
+        end_call (ERROR);
+        return (NULL);
+    }
+
+    out = open_memstream (&json, &json_size);
+    if (out == NULL)
+    {
+        sprintf (errmsg, "Allocating the JSON of the metadata");
+        error_handler (true, FUNC_NAME, errmsg);
+        end_call (ERROR);
+        return (NULL);
+    }
+
+    fputs ("{\"xml_file\": ", out);
+    write_json_string (out, product->xml_file);
+    fputs (", \"namespace\": ", out);
+    write_json_string (out, metadata->meta_namespace);
+    fputs (", \"global\": {", out);
+    write_json_fields (out, global_fields,
+        sizeof (global_fields) / sizeof (global_fields[0]),
+        &metadata->global);
+    fputs (", \"proj_info\": {", out);
+    write_json_fields (out, proj_fields,
+        sizeof (proj_fields) / sizeof (proj_fields[0]),
+        &metadata->global.proj_info);
+    fputs ("}}, \"bands\": [", out);
+    for (i = 0; i < metadata->nbands; i++)
+    {
+        if (i > 0)
+            fputs (", ", out);
+        write_json_band (out, &metadata->band[i]);
+    }
+    fputs ("]}", out);
+
+    write_error = ferror (out);
+    if (fclose (out) != 0 || write_error)
+    {
+        sprintf (errmsg, "Writing the JSON of the metadata");
+        error_handler (true, FUNC_NAME, errmsg);
+        free (json);
+        end_call (ERROR);
+        return (NULL);
+    }
+
+    end_call (SUCCESS);
+    return (json);
+}
+
+
+/******************************************************************************
+MODULE:  espa_formatter_free
+
+PURPOSE:  Frees the memory returned by the library.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. Callers which don't share the C library of the library (ex. Python
+     through ctypes) must free the memory here rather than with free.
+******************************************************************************/
+void espa_formatter_free
+(
+    void *ptr                /* I: memory to be freed; may be NULL */
+)
+{
+    free (ptr);
+}
+
+
+/******************************************************************************
+MODULE:  convert_product
+
+PURPOSE:  Converts a Level-1 product to the ESPA internal format, from the
+directory of the Level-1 product.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error converting the product
+SUCCESS         Successfully converted the product
+
+NOTES:
+  1. Must be called with the engine lock held.
+  2. The converters find the files of the Level-1 product (ex. the GeoTIFF
+     bands listed in the MTL file) relative to the working directory, so the
+     working directory is changed to the directory of the input while the
+     conversion runs, and then restored.
+******************************************************************************/
+static int convert_product
+(
+    Espa_formatter_source_t source,  /* I: type of the Level-1 product */
+    const char *input_file,  /* I: MTL, bundle, or HDF file of the product */
+    const char *xml_file     /* I: XML metadata file to be written */
+)
+{
+    char FUNC_NAME[] = "convert_product";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    char in_file[STR_SIZE];   /* absolute name of the input */
+    char out_file[STR_SIZE];  /* absolute name of the XML file */
+    char in_dir[STR_SIZE];    /* directory of the input */
+    char *cptr = NULL;        /* last slash of the input */
+    int cwd_fd;               /* working directory of the caller */
+    int status;               /* status of the conversion */
+
+    if (absolute_cwd_path (input_file, in_file) != SUCCESS ||
+        absolute_cwd_path (xml_file, out_file) != SUCCESS)
+        return (ERROR);
+    strcpy (in_dir, in_file);
+    cptr = strrchr (in_dir, '/');
+    if (cptr != NULL)
+        *(cptr == in_dir ? cptr + 1 : cptr) = '\0';
+
+    cwd_fd = open (".", O_RDONLY | O_DIRECTORY);
+    if (cwd_fd < 0 || chdir (in_dir) != 0)
+    {
+        sprintf (errmsg, "Changing to the directory of %.200s", in_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        if (cwd_fd >= 0)
+            close (cwd_fd);
+        return (ERROR);
+    }
+
+    switch (source)
+    {
+        case ESPA_FORMATTER_LPGS:
+            status = convert_lpgs_to_espa (in_file, out_file, false, false);
+            break;
+        case ESPA_FORMATTER_LPGS_BUNDLE:
+            status = convert_lpgs_archive_to_espa (in_file, out_file, false,
+                false);
+            break;
+        case ESPA_FORMATTER_MODIS:
+            status = convert_modis_to_espa (in_file, out_file, false, false);
+            break;
+        default:
+            sprintf (errmsg, "Unknown type %d of Level-1 product", source);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+            break;
+    }
+
+    if (fchdir (cwd_fd) != 0)
+    {
+        sprintf (errmsg, "Restoring the working directory");
+        error_handler (true, FUNC_NAME, errmsg);
+        status = ERROR;
+    }
+    close (cwd_fd);
+
+    if (status != SUCCESS)
+    {
+        sprintf (errmsg, "Converting %.200s", in_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  espa_formatter_convert
+
+PURPOSE:  Converts a Level-1 product to the ESPA internal format.
+
+RETURN VALUE:
+Type = int
+Value                   Description
+-----                   -----------
+ESPA_FORMATTER_ERROR    Error converting the product
+ESPA_FORMATTER_SUCCESS  Successfully converted the product; open it with
+                        espa_formatter_open
+
+NOTES:
+  1. The conversions and exports of the process run one at a time.
+  2. The working directory of the process is the directory of the input
+     while the conversion runs (see convert_product), so the other threads
+     of the caller shouldn't use relative filenames in the meantime.  The
+     reads of the open products aren't affected.
+  3. The Level-1 files are kept.
+******************************************************************************/
+int espa_formatter_convert
+(
+    Espa_formatter_source_t source,  /* I: type of the Level-1 product */
+    const char *input_file,  /* I: MTL, bundle, or HDF file of the product */
+    const char *xml_file     /* I: XML metadata file of the ESPA product to
+                                   be written; the bands are written
+                                   alongside it */
+)
+{
+    int status;               /* status of the call */
+
+    status = begin_call ();
+    if (status == SUCCESS)
+    {
+        pthread_mutex_lock (&engine_mutex);
+        status = convert_product (source, input_file, xml_file);
+        pthread_mutex_unlock (&engine_mutex);
+    }
+
+    return (end_call (status));
+}
+
+
+/******************************************************************************
+MODULE:  job_needs_band
+
+PURPOSE:  Records the band being read as the progress of an export job, and
+asks the sink of the format whether it writes the band.
+
+RETURN VALUE:
+Type = bool
+Value           Description
+-----           -----------
+false           The sink doesn't write the band
+true            The sink writes the band
+
+NOTES:
+  1. Called from the thread running the job, before each band is read.
+******************************************************************************/
+static bool job_needs_band
+(
+    void *state,                        /* I: sink of the job */
+    Espa_internal_meta_t *xml_metadata, /* I: XML metadata structure */
+    int band                            /* I: index of the band */
+)
+{
+    Job_sink_t *job_sink = state;       /* sink of the job */
+
+    __atomic_store_n (&job_sink->job->progress_done, band, __ATOMIC_RELEASE);
+    if (job_sink->sink.needs_band == NULL)
+        return (true);
+    return (job_sink->sink.needs_band (job_sink->sink.state, xml_metadata,
+        band));
+}
+
+
+/******************************************************************************
+MODULE:  job_begin_band
+
+PURPOSE:  Passes the start of a band on to the sink of the format.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           The job was cancelled, or the sink failed
+SUCCESS         The band was started
+
+NOTES:
+******************************************************************************/
+static int job_begin_band
+(
+    void *state,                        /* I/O: sink of the job */
+    Espa_internal_meta_t *xml_metadata, /* I: XML metadata structure */
+    int band                            /* I: index of the band */
+)
+{
+    Job_sink_t *job_sink = state;       /* sink of the job */
+
+    if (__atomic_load_n (&job_sink->job->cancelled, __ATOMIC_ACQUIRE))
+        return (ERROR);
+    return (job_sink->sink.begin_band (job_sink->sink.state, xml_metadata,
+        band));
+}
+
+
+/******************************************************************************
+MODULE:  job_write_block
+
+PURPOSE:  Passes a block of lines on to the sink of the format.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           The job was cancelled, or the sink failed
+SUCCESS         The block was written
+
+NOTES:
+  1. Failing once the job is cancelled stops the fan-out from reading any
+     more blocks, so a cancelled export stops within a block of lines.
+******************************************************************************/
+static int job_write_block
+(
+    void *state,                        /* I/O: sink of the job */
+    Espa_internal_meta_t *xml_metadata, /* I: XML metadata structure */
+    int band,                           /* I: index of the band */
+    Espa_band_block_t *block            /* I: block of lines */
+)
+{
+    Job_sink_t *job_sink = state;       /* sink of the job */
+
+    if (__atomic_load_n (&job_sink->job->cancelled, __ATOMIC_ACQUIRE))
+        return (ERROR);
+    return (job_sink->sink.write_block (job_sink->sink.state, xml_metadata,
+        band, block));
+}
+
+
+/******************************************************************************
+MODULE:  job_end_band
+
+PURPOSE:  Passes the end of a band on to the sink of the format.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           The sink failed
+SUCCESS         The band was completed
+
+NOTES:
+******************************************************************************/
+static int job_end_band
+(
+    void *state,                        /* I/O: sink of the job */
+    Espa_internal_meta_t *xml_metadata, /* I: XML metadata structure */
+    int band                            /* I: index of the band */
+)
+{
+    Job_sink_t *job_sink = state;       /* sink of the job */
+
+    return (job_sink->sink.end_band (job_sink->sink.state, xml_metadata,
+        band));
+}
+
+
+/******************************************************************************
+MODULE:  job_finish
+
+PURPOSE:  Passes the completion of the product on to the sink of the format.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           The sink failed
+SUCCESS         The product was completed
+
+NOTES:
+******************************************************************************/
+static int job_finish
+(
+    void *state,                        /* I: sink of the job */
+    Espa_internal_meta_t *xml_metadata, /* I: XML metadata structure */
+    bool complete      /* I: were all the bands written by every sink? */
+)
+{
+    Job_sink_t *job_sink = state;       /* sink of the job */
+
+    return (job_sink->sink.finish (job_sink->sink.state, xml_metadata,
+        complete));
+}
+
+
+/******************************************************************************
+MODULE:  init_job_sinks
+
+PURPOSE:  Wraps the sinks of the formats of an export job, so the job
+reports its progress and stops once it is cancelled.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. The progress of the job is the number of bands read so far.
+******************************************************************************/
+static void init_job_sinks
+(
+    Espa_formatter_job_t *job,  /* I/O: job of the export */
+    int nbands,                 /* I: number of bands of the product */
+    int nsinks,                 /* I: number of sinks */
+    Job_sink_t *job_sinks,      /* O: sinks of the job; nsinks of them */
+    Espa_export_sink_t *sinks   /* I/O: sinks of the formats, replaced by
+                                        the sinks passing the calls on to
+                                        them */
+)
+{
+    int i;                      /* looping variable for the sinks */
+
+    __atomic_store_n (&job->progress_total, nbands, __ATOMIC_RELEASE);
+    for (i = 0; i < nsinks; i++)
+    {
+        job_sinks[i].sink = sinks[i];
+        job_sinks[i].job = job;
+        sinks[i].state = &job_sinks[i];
+        sinks[i].needs_band = job_needs_band;
+        sinks[i].begin_band = job_begin_band;
+        sinks[i].write_block = job_write_block;
+        sinks[i].end_band = job_end_band;
+        sinks[i].finish = job_finish;
+    }
+}
+
+
+/******************************************************************************
+MODULE:  export_product
+
+PURPOSE:  Exports a product to the requested formats in one pass over the
+bands.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error exporting the product
+SUCCESS         Successfully exported the product
+
+NOTES:
+  1. Must be called with the engine lock held.
+  2. The export sinks may change the metadata they are given, so the
+     product's own metadata is left alone and the XML file is parsed again
+     for the export.
+  3. For a job, the sinks are wrapped (see init_job_sinks) to report the
+     progress of the job and to stop the export once it is cancelled.
+******************************************************************************/
+static int export_product
+(
+    const char *xml_file,    /* I: absolute name of the XML metadata file of
+                                   the product */
+    const char *gtif_file,   /* I: base name of the GeoTIFF bands; NULL to
+                                   skip */
+    const char *netcdf_file, /* I: NetCDF file; NULL to skip */
+    const char *hdf_file,    /* I: HDF-EOS file; NULL to skip */
+    Espa_formatter_job_t *job  /* I/O: job of the export; NULL if not run
+                                   as a job */
+)
+{
+    char FUNC_NAME[] = "export_product";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    char out_file[STR_SIZE];  /* absolute name of the current output */
+    int nsinks = 0;           /* number of export sinks */
+    int status = SUCCESS;     /* status of the export */
+    int i;                    /* looping variable for the sinks */
+    Espa_export_sink_t sinks[FORMATTER_MAX_SINKS];  /* export sinks */
+    Job_sink_t job_sinks[FORMATTER_MAX_SINKS];  /* sinks of a job, passing
+                                   the calls on to sinks */
+    Espa_internal_meta_t xml_metadata;  /* metadata of the export */
+
+    if (gtif_file == NULL && netcdf_file == NULL && hdf_file == NULL)
+    {
+        sprintf (errmsg, "No export format was requested");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    init_metadata_struct (&xml_metadata);
+    if (parse_metadata ((char *) xml_file, &xml_metadata) != SUCCESS
+        || resolve_band_files (xml_file, &xml_metadata) != SUCCESS)
+    {
+        sprintf (errmsg, "Reading the metadata of %.200s", xml_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        free_metadata (&xml_metadata);
+        return (ERROR);
+    }
+
+    /* Set up the sink of each requested format */
+    if (gtif_file != NULL)
+    {
+        if (absolute_cwd_path (gtif_file, out_file) == SUCCESS &&
+            init_gtif_export_sink (out_file, &xml_metadata,
+            RB_PREFETCH_DEFAULT_LINES, &sinks[nsinks]) == SUCCESS)
+            nsinks++;
+        else
+            status = ERROR;
+    }
+    if (status == SUCCESS && netcdf_file != NULL)
+    {
+        if (absolute_cwd_path (netcdf_file, out_file) == SUCCESS &&
+            init_netcdf_export_sink (out_file, &xml_metadata, false,
+            RB_PREFETCH_DEFAULT_LINES, &sinks[nsinks]) == SUCCESS)
+            nsinks++;
+        else
+            status = ERROR;
+    }
+    if (status == SUCCESS && hdf_file != NULL)
+    {
+        if (absolute_cwd_path (hdf_file, out_file) == SUCCESS &&
+            init_hdf_export_sink (out_file, &xml_metadata, &sinks[nsinks])
+            == SUCCESS)
+            nsinks++;
+        else
+            status = ERROR;
+    }
+    if (status != SUCCESS)
+    {
+        sprintf (errmsg, "Setting up the export formats");
+        error_handler (true, FUNC_NAME, errmsg);
+        for (i = 0; i < nsinks; i++)
+            sinks[i].finish (sinks[i].state, &xml_metadata, false);
+        free_metadata (&xml_metadata);
+        return (ERROR);
+    }
+
+    if (job != NULL)
+        init_job_sinks (job, xml_metadata.nbands, nsinks, job_sinks, sinks);
+
+    /* Each block of the bands is read once for all the formats */
+    if (export_espa_fanout (&xml_metadata, nsinks, sinks,
+        RB_PREFETCH_DEFAULT_LINES, DEFAULT_EXPORT_QUEUE_BLOCKS) != SUCCESS)
+    {
+        if (job != NULL &&
+            __atomic_load_n (&job->cancelled, __ATOMIC_ACQUIRE))
+            sprintf (errmsg, "Export of %.200s was cancelled", xml_file);
+        else
+            sprintf (errmsg, "Exporting %.200s", xml_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        status = ERROR;
+    }
+
+    free_metadata (&xml_metadata);
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  espa_formatter_export
+
+PURPOSE:  Exports a product to GeoTIFF, NetCDF, and/or HDF-EOS.
+
+RETURN VALUE:
+Type = int
+Value                   Description
+-----                   -----------
+ESPA_FORMATTER_ERROR    Error exporting the product
+ESPA_FORMATTER_SUCCESS  Successfully exported the product
+
+NOTES:
+  1. The products are the same as those of convert_espa_to_formats (and of
+     convert_espa_to_gtif, convert_espa_to_netcdf, and convert_espa_to_hdf
+     with their default options).
+  2. The conversions and exports of the process run one at a time.  The
+     windows of the product can be read while it is exported.
+  3. The errors of the threads writing the formats are printed rather than
+     captured; the captured errors say which step failed.
+******************************************************************************/
+int espa_formatter_export
+(
+    const Espa_formatter_product_t *product, /* I: product */
+    const char *gtif_file,   /* I: base name of the GeoTIFF bands; NULL to
+                                   skip the GeoTIFF export */
+    const char *netcdf_file, /* I: NetCDF file; NULL to skip it */
+    const char *hdf_file     /* I: HDF-EOS file; NULL to skip it */
+)
+{
+    int status;               /* status of the call */
+
+    status = begin_call ();
+    if (status == SUCCESS)
+    {
+        pthread_mutex_lock (&engine_mutex);
+        status = export_product (product->xml_file, gtif_file, netcdf_file,
+            hdf_file, NULL);
+        pthread_mutex_unlock (&engine_mutex);
+    }
+
+    return (end_call (status));
+}
+
+
+/******************************************************************************
+MODULE:  new_job
+
+PURPOSE:  Allocates a job, with its file descriptor.
+
+RETURN VALUE:
+Type = Espa_formatter_job_t *
+Value           Description
+-----           -----------
+NULL            Error allocating the job
+job             New job, not submitted yet
+
+NOTES:
+  1. The job has two references, one for the caller and one for the thread
+     running it, so the caller may free it before it is done.
+******************************************************************************/
+static Espa_formatter_job_t *new_job
+(
+    Job_type_t type,          /* I: kind of job */
+    Espa_formatter_job_callback_t callback,  /* I: completion callback; may
+                                    be NULL */
+    void *user_data           /* I: passed to the callback */
+)
+{
+    char FUNC_NAME[] = "new_job";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    Espa_formatter_job_t *job = NULL;  /* new job */
+
+    job = calloc (1, sizeof (Espa_formatter_job_t));
+    if (job == NULL)
+    {
+        sprintf (errmsg, "Allocating the job");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (NULL);
+    }
+
+    job->fd = eventfd (0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (job->fd < 0)
+    {
+        sprintf (errmsg, "Creating the file descriptor of the job");
+        error_handler (true, FUNC_NAME, errmsg);
+        free (job);
+        return (NULL);
+    }
+
+    job->type = type;
+    job->callback = callback;
+    job->user_data = user_data;
+    job->state = ESPA_FORMATTER_JOB_QUEUED;
+    job->progress_total = 1;
+    job->refs = 2;
+    return (job);
+}
+
+
+/******************************************************************************
+MODULE:  release_job
+
+PURPOSE:  Drops a reference to a job, freeing it with the last one.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+static void release_job
+(
+    Espa_formatter_job_t *job  /* I: job */
+)
+{
+    if (__atomic_sub_fetch (&job->refs, 1, __ATOMIC_ACQ_REL) > 0)
+        return;
+
+    close (job->fd);
+    free (job);
+}
+
+
+/******************************************************************************
+MODULE:  finish_job
+
+PURPOSE:  Sets the final state of a job, and tells the caller that it is
+done.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. The waiters are woken, the file descriptor of the job becomes
+     readable, and then the callback is called.  The reference of the
+     thread running the job is dropped last, so the callback may free the
+     job.
+******************************************************************************/
+static void finish_job
+(
+    Espa_formatter_job_t *job,  /* I/O: job which is done */
+    Espa_formatter_job_state_t state  /* I: final state of the job */
+)
+{
+    if (state == ESPA_FORMATTER_JOB_SUCCEEDED)
+        __atomic_store_n (&job->progress_done,
+            __atomic_load_n (&job->progress_total, __ATOMIC_ACQUIRE),
+            __ATOMIC_RELEASE);
+
+    pthread_mutex_lock (&job_mutex);
+    job->state = state;
+    pthread_cond_broadcast (&job_cond);
+    pthread_mutex_unlock (&job_mutex);
+
+    eventfd_write (job->fd, 1);
+    if (job->callback != NULL)
+        job->callback (job, state, job->user_data);
+    release_job (job);
+}
+
+
+/******************************************************************************
+MODULE:  take_next_job
+
+PURPOSE:  Takes the job at the front of the queue, or marks that no job is
+running if the queue is empty.
+
+RETURN VALUE:
+Type = Espa_formatter_job_t *
+Value           Description
+-----           -----------
+NULL            The queue is empty
+job             Job to be handed to the task pool
+
+NOTES:
+******************************************************************************/
+static Espa_formatter_job_t *take_next_job (void)
+{
+    Espa_formatter_job_t *job = NULL;  /* job at the front of the queue */
+
+    pthread_mutex_lock (&job_mutex);
+    job = job_head;
+    if (job != NULL)
+    {
+        job_head = job->next;
+        if (job_head == NULL)
+            job_tail = NULL;
+        job->next = NULL;
+        job->queued = false;
+    }
+    else
+        job_running = false;
+    pthread_mutex_unlock (&job_mutex);
+
+    return (job);
+}
+
+
+/******************************************************************************
+MODULE:  run_job
+
+PURPOSE:  Runs a job on a thread of the task pool, and then hands the next
+job of the queue to the pool.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+SUCCESS         Always; the status is kept in the job
+
+NOTES:
+  1. The errors of the job are captured in the job rather than in the
+     thread which submitted it.
+  2. The job takes the engine lock, so it also waits for the conversions
+     and exports called directly (ex. espa_formatter_convert).  A job
+     cancelled while waiting for the lock isn't started.
+******************************************************************************/
+static int run_job
+(
+    void *arg                 /* I/O: job to be run */
+)
+{
+    char FUNC_NAME[] = "run_job";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    Espa_formatter_job_t *job = arg;  /* job to be run */
+    Espa_formatter_job_t *next = NULL;  /* next job of the queue */
+    Espa_formatter_job_state_t state;  /* final state of the job */
+    bool cancelled;           /* was the job cancelled before it started? */
+    int status;               /* status of the job */
+    int i;                    /* looping variable for the outputs */
+    const char *out_files[FORMATTER_MAX_SINKS];  /* outputs of an export;
+                                    NULL to skip the format */
+
+    capture_errors (job->errors, sizeof (job->errors));
+    pthread_mutex_lock (&engine_mutex);
+
+    pthread_mutex_lock (&job_mutex);
+    cancelled = __atomic_load_n (&job->cancelled, __ATOMIC_ACQUIRE);
+    if (!cancelled)
+        job->state = ESPA_FORMATTER_JOB_RUNNING;
+    pthread_mutex_unlock (&job_mutex);
+
+    if (cancelled)
+    {
+        sprintf (errmsg, "The job was cancelled before it started");
+        error_handler (true, FUNC_NAME, errmsg);
+        status = ERROR;
+    }
+    else if (job->type == JOB_CONVERT)
+        status = convert_product (job->source, job->input_file,
+            job->xml_file);
+    else
+    {
+        for (i = 0; i < FORMATTER_MAX_SINKS; i++)
+            out_files[i] = (job->out_files[i][0] != '\0') ?
+                job->out_files[i] : NULL;
+        status = export_product (job->xml_file, out_files[0], out_files[1],
+            out_files[2], job);
+    }
+
+    pthread_mutex_unlock (&engine_mutex);
+    capture_errors (NULL, 0);
+
+    if (status == SUCCESS)
+        state = ESPA_FORMATTER_JOB_SUCCEEDED;
+    else if (__atomic_load_n (&job->cancelled, __ATOMIC_ACQUIRE))
+        state = ESPA_FORMATTER_JOB_CANCELLED;
+    else
+        state = ESPA_FORMATTER_JOB_FAILED;
+    finish_job (job, state);
+
+    next = take_next_job ();
+    if (next != NULL)
+        espa_task_group_run (&job_group, run_job, next);
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  submit_job
+
+PURPOSE:  Adds a job to the queue of jobs, handing it to the task pool right
+away if no job is running.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. With a single thread in the task pool, a job which isn't queued is run
+     in the calling thread before this returns.
+******************************************************************************/
+static void submit_job
+(
+    Espa_formatter_job_t *job  /* I/O: job to be run */
+)
+{
+    bool queued = true;       /* was the job queued behind others? */
+
+    pthread_mutex_lock (&job_mutex);
+    if (job_running)
+    {
+        if (job_tail != NULL)
+            job_tail->next = job;
+        else
+            job_head = job;
+        job_tail = job;
+        job->queued = true;
+    }
+    else
+    {
+        job_running = true;
+        queued = false;
+    }
+    pthread_mutex_unlock (&job_mutex);
+
+    if (!queued)
+        espa_task_group_run (&job_group, run_job, job);
+}
+
+
+/******************************************************************************
+MODULE:  espa_formatter_convert_async
+
+PURPOSE:  Submits the conversion of a Level-1 product to the ESPA internal
+format as a job.
+
+RETURN VALUE:
+Type = int
+Value                   Description
+-----                   -----------
+ESPA_FORMATTER_ERROR    Error submitting the job
+ESPA_FORMATTER_SUCCESS  The job was submitted; job is its handle
+
+NOTES:
+  1. The conversion is the same as that of espa_formatter_convert, and runs
+     after the jobs submitted before it.  The filenames are made absolute
+     when the job is submitted.
+  2. A conversion which has started can't be cancelled.
+  3. The callback may be called before this returns (ex. with a single
+     thread in the task pool), but job is set before it is.
+******************************************************************************/
+int espa_formatter_convert_async
+(
+    Espa_formatter_source_t source,  /* I: type of the Level-1 product */
+    const char *input_file,  /* I: MTL, bundle, or HDF file of the product */
+    const char *xml_file,    /* I: XML metadata file of the ESPA product to
+                                   be written */
+    Espa_formatter_job_callback_t callback,  /* I: completion callback; may
+                                   be NULL */
+    void *user_data,         /* I: passed to the callback */
+    Espa_formatter_job_t **job  /* O: handle of the job; free with
+                                   espa_formatter_job_free */
+)
+{
+    Espa_formatter_job_t *new = NULL;  /* job being submitted */
+    int status;               /* status of the call */
+
+    *job = NULL;
+    status = begin_call ();
+    if (status == SUCCESS)
+    {
+        new = new_job (JOB_CONVERT, callback, user_data);
+        if (new == NULL)
+            status = ERROR;
+    }
+    if (status == SUCCESS)
+    {
+        new->source = source;
+        if (absolute_cwd_path (input_file, new->input_file) != SUCCESS ||
+            absolute_cwd_path (xml_file, new->xml_file) != SUCCESS)
+        {
+            close (new->fd);
+            free (new);
+            status = ERROR;
+        }
+    }
+    if (status == SUCCESS)
+    {
+        *job = new;
+        submit_job (new);
+    }
+
+    return (end_call (status));
+}
+
+
+/******************************************************************************
+MODULE:  espa_formatter_export_async
+
+PURPOSE:  Submits the export of a product to GeoTIFF, NetCDF, and/or
+HDF-EOS as a job.
+
+RETURN VALUE:
+Type = int
+Value                   Description
+-----                   -----------
+ESPA_FORMATTER_ERROR    Error submitting the job
+ESPA_FORMATTER_SUCCESS  The job was submitted; job is its handle
+
+NOTES:
+  1. The export is the same as that of espa_formatter_export, and runs
+     after the jobs submitted before it.  The job reads the product from
+     its XML file, so the product may be closed once the job is submitted.
+  2. The progress of the job is the fraction of the bands read so far, and
+     a cancelled export stops within a block of lines.
+******************************************************************************/
+int espa_formatter_export_async
+(
+    const Espa_formatter_product_t *product, /* I: product */
+    const char *gtif_file,   /* I: base name of the GeoTIFF bands; NULL to
+                                   skip the GeoTIFF export */
+    const char *netcdf_file, /* I: NetCDF file; NULL to skip it */
+    const char *hdf_file,    /* I: HDF-EOS file; NULL to skip it */
+    Espa_formatter_job_callback_t callback,  /* I: completion callback; may
+                                   be NULL */
+    void *user_data,         /* I: passed to the callback */
+    Espa_formatter_job_t **job  /* O: handle of the job; free with
+                                   espa_formatter_job_free */
+)
+{
+    char FUNC_NAME[] = "espa_formatter_export_async";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    Espa_formatter_job_t *new = NULL;  /* job being submitted */
+    int status;               /* status of the call */
+    int i;                    /* looping variable for the outputs */
+    const char *out_files[FORMATTER_MAX_SINKS];  /* requested outputs */
+
+    *job = NULL;
+    out_files[0] = gtif_file;
+    out_files[1] = netcdf_file;
+    out_files[2] = hdf_file;
+
+    status = begin_call ();
+    if (status == SUCCESS && gtif_file == NULL && netcdf_file == NULL &&
+        hdf_file == NULL)
+    {
+        sprintf (errmsg, "No export format was requested");
+        error_handler (true, FUNC_NAME, errmsg);
+        status = ERROR;
+    }
+    if (status == SUCCESS)
+    {
+        new = new_job (JOB_EXPORT, callback, user_data);
+        if (new == NULL)
+            status = ERROR;
+    }
+    if (status == SUCCESS)
+    {
+        strcpy (new->xml_file, product->xml_file);
+        for (i = 0; i < FORMATTER_MAX_SINKS && status == SUCCESS; i++)
+        {
+            if (out_files[i] != NULL &&
+                absolute_cwd_path (out_files[i], new->out_files[i])
+                != SUCCESS)
+                status = ERROR;
+        }
+        if (status != SUCCESS)
+        {
+            close (new->fd);
+            free (new);
+        }
+    }
+    if (status == SUCCESS)
+    {
+        *job = new;
+        submit_job (new);
+    }
+
+    return (end_call (status));
+}
+
+
+/******************************************************************************
+MODULE:  espa_formatter_job_state
+
+PURPOSE:  Returns the state of a job.
+
+RETURN VALUE:
+Type = Espa_formatter_job_state_t
+Value                   Description
+-----                   -----------
+state                   Current state of the job
+
+NOTES:
+******************************************************************************/
+Espa_formatter_job_state_t espa_formatter_job_state
+(
+    const Espa_formatter_job_t *job  /* I: job */
+)
+{
+    Espa_formatter_job_state_t state;  /* state of the job */
+
+    pthread_mutex_lock (&job_mutex);
+    state = job->state;
+    pthread_mutex_unlock (&job_mutex);
+
+    return (state);
+}
+
+
+/******************************************************************************
+MODULE:  espa_formatter_job_progress
+
+PURPOSE:  Returns the progress of a job.
+
+RETURN VALUE:
+Type = double
+Value                   Description
+-----                   -----------
+progress                Fraction of the job done so far, from 0 to 1
+
+NOTES:
+  1. An export progresses band by band.  The converters don't report their
+     progress, so a conversion goes from 0 to 1 once it succeeds.
+******************************************************************************/
+double espa_formatter_job_progress
+(
+    const Espa_formatter_job_t *job  /* I: job */
+)
+{
+    int done;                 /* steps done */
+    int total;                /* number of steps */
+
+    done = __atomic_load_n (&job->progress_done, __ATOMIC_ACQUIRE);
+    total = __atomic_load_n (&job->progress_total, __ATOMIC_ACQUIRE);
+    if (total <= 0 || done <= 0)
+        return (0.0);
+    if (done >= total)
+        return (1.0);
+
+    return ((double) done / total);
+}
+
+
+/******************************************************************************
+MODULE:  espa_formatter_job_fd
+
+PURPOSE:  Returns the file descriptor of a job, which becomes readable once
+the job is done.
+
+RETURN VALUE:
+Type = int
+Value                   Description
+-----                   -----------
+fd                      File descriptor of the job
+
+NOTES:
+  1. The file descriptor can be watched with poll, select, or epoll, and
+     stays readable until the job is freed, which closes it.  It must not
+     be read or closed by the caller.
+******************************************************************************/
+int espa_formatter_job_fd
+(
+    const Espa_formatter_job_t *job  /* I: job */
+)
+{
+    return (job->fd);
+}
+
+
+/******************************************************************************
+MODULE:  espa_formatter_job_wait
+
+PURPOSE:  Waits for a job to be done.
+
+RETURN VALUE:
+Type = int
+Value                   Description
+-----                   -----------
+ESPA_FORMATTER_ERROR    The job failed or was cancelled; the errors of the
+                        job are given by espa_formatter_last_error
+ESPA_FORMATTER_SUCCESS  The job succeeded
+
+NOTES:
+  1. Must not be called from a completion callback.
+******************************************************************************/
+int espa_formatter_job_wait
+(
+    Espa_formatter_job_t *job  /* I: job to be waited for */
+)
+{
+    Espa_formatter_job_state_t state;  /* final state of the job */
+    int status;               /* status of the call */
+
+    status = begin_call ();
+    if (status == SUCCESS)
+    {
+        pthread_mutex_lock (&job_mutex);
+        while (job->state == ESPA_FORMATTER_JOB_QUEUED ||
+               job->state == ESPA_FORMATTER_JOB_RUNNING)
+            pthread_cond_wait (&job_cond, &job_mutex);
+        state = job->state;
+        pthread_mutex_unlock (&job_mutex);
+
+        if (state != ESPA_FORMATTER_JOB_SUCCEEDED)
+        {
+            snprintf (last_error, sizeof (last_error), "%s", job->errors);
+            status = ERROR;
+        }
+    }
+
+    return (end_call (status));
+}
+
+
+/******************************************************************************
+MODULE:  espa_formatter_job_cancel
+
+PURPOSE:  Cancels a job.
+
+RETURN VALUE:
+Type = int
+Value                   Description
+-----                   -----------
+ESPA_FORMATTER_ERROR    The job is already done, or is a conversion which
+                        has started
+ESPA_FORMATTER_SUCCESS  The job will end as cancelled
+
+NOTES:
+  1. A queued job is done (and its callback called) before this returns.
+     A running export stops within a block of lines, and the outputs it
+     has started are left incomplete.
+******************************************************************************/
+int espa_formatter_job_cancel
+(
+    Espa_formatter_job_t *job  /* I: job to be cancelled */
+)
+{
+    char FUNC_NAME[] = "espa_formatter_job_cancel";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    Espa_formatter_job_t *prev = NULL;  /* job before it in the queue */
+    bool dequeued = false;    /* was the job taken out of the queue? */
+    int status;               /* status of the call */
+
+    status = begin_call ();
+    if (status != SUCCESS)
+        return (end_call (status));
+
+    pthread_mutex_lock (&job_mutex);
+    if (job->queued)
+    {
+        /* Take the job out of the queue */
+        if (job_head == job)
+            job_head = job->next;
+        else
+        {
+            for (prev = job_head; prev->next != job; prev = prev->next)
+                ;
+            prev->next = job->next;
+        }
+        if (job_tail == job)
+            job_tail = prev;
+        job->next = NULL;
+        job->queued = false;
+        dequeued = true;
+        __atomic_store_n (&job->cancelled, 1, __ATOMIC_RELEASE);
+    }
+    else if (job->state == ESPA_FORMATTER_JOB_QUEUED ||
+        (job->state == ESPA_FORMATTER_JOB_RUNNING && job->type == JOB_EXPORT))
+        __atomic_store_n (&job->cancelled, 1, __ATOMIC_RELEASE);
+    else
+    {
+        if (job->state == ESPA_FORMATTER_JOB_RUNNING)
+            sprintf (errmsg, "A running conversion can't be cancelled");
+        else
+            sprintf (errmsg, "The job is already done");
+        status = ERROR;
+    }
+    pthread_mutex_unlock (&job_mutex);
+
+    if (status != SUCCESS)
+        error_handler (true, FUNC_NAME, errmsg);
+    if (dequeued)
+    {
+        snprintf (job->errors, sizeof (job->errors),
+            "%s: The job was cancelled before it started", FUNC_NAME);
+        finish_job (job, ESPA_FORMATTER_JOB_CANCELLED);
+    }
+
+    return (end_call (status));
+}
+
+
+/******************************************************************************
+MODULE:  espa_formatter_job_error
+
+PURPOSE:  Returns the errors of a job.
+
+RETURN VALUE:
+Type = const char *
+Value                   Description
+-----                   -----------
+errors                  Errors of the job, one per line; empty if the job
+                        hasn't failed.  Valid until the job is freed.
+
+NOTES:
+******************************************************************************/
+const char *espa_formatter_job_error
+(
+    const Espa_formatter_job_t *job  /* I: job */
+)
+{
+    Espa_formatter_job_state_t state;  /* state of the job */
+
+    state = espa_formatter_job_state (job);
+    if (state == ESPA_FORMATTER_JOB_QUEUED ||
+        state == ESPA_FORMATTER_JOB_RUNNING)
+        return ("");
+
+    return (job->errors);
+}
+
+
+/******************************************************************************
+MODULE:  espa_formatter_job_free
+
+PURPOSE:  Frees the handle of a job.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. A job which isn't done yet keeps running, and is freed once it is
+     done; its callback is still called.
+******************************************************************************/
+void espa_formatter_job_free
+(
+    Espa_formatter_job_t *job  /* I: job to be freed; may be NULL */
+)
+{
+    if (job != NULL)
+        release_job (job);
+}
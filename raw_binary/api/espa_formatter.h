@@ -0,0 +1,293 @@
+/*****************************************************************************
+FILE: espa_formatter.h
+
+PURPOSE: Contains defines, structures, and prototypes for the API of the
+libespa_formatter shared library, which opens ESPA products, reads windows
+of their bands, converts Level-1 products to the ESPA internal format, and
+exports ESPA products, all within the calling process.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. This is the only header of the library, and it doesn't depend on any of
+     the other ESPA headers or on libxml2, so the layouts of the internal
+     structures can change without breaking the callers.  A product is an
+     opaque handle, and only the functions declared here are exported from
+     the library.  ESPA_FORMATTER_API_VERSION is raised when a function is
+     added; existing functions and the fields of the structures here don't
+     change.
+  2. Every function returning int returns ESPA_FORMATTER_SUCCESS or
+     ESPA_FORMATTER_ERROR (or a count or index, as documented).  On an error,
+     espa_formatter_last_error gives the messages of the error in the
+     calling thread; they aren't printed.
+  3. The functions may be called from any number of threads once
+     espa_formatter_init has returned.  Each product handle holds all of its
+     own state, and opening products and reading windows (even of the same
+     handle) run at the same time in different threads.  Converting and
+     exporting rely on HDF4, HDF5, and GCTP, which aren't re-entrant, so
+     only one conversion or export runs at a time within the process; the
+     others wait for it.
+  4. The band files are found relative to the directory of the XML file, so
+     the working directory of the process doesn't matter and is never
+     changed.
+  5. The plain raw binary bands can be mapped (espa_formatter_map_band),
+     which gives a view of the pixels of the whole band without copying
+     them, ex. for the buffers of the Python bindings in
+     py_modules/espa_formatter.py.  The memory returned by the library
+     (ex. espa_formatter_metadata_json) is freed with espa_formatter_free.
+  6. The conversions and exports can also be submitted as jobs
+     (espa_formatter_convert_async and espa_formatter_export_async), which
+     return right away with a job handle, so one thread can drive any number
+     of jobs.  The jobs run on the threads of the shared task pool, one at a
+     time as in note 3, in the order they were submitted.  The caller learns
+     that a job is done from its completion callback, from its file
+     descriptor becoming readable (ex. with poll or epoll), or by polling
+     or waiting for it, and may cancel it.
+*****************************************************************************/
+
+#ifndef ESPA_FORMATTER_H
+#define ESPA_FORMATTER_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Defines */
+#define ESPA_FORMATTER_API_VERSION 3  /* version of the functions and
+                                         structures of this header */
+#define ESPA_FORMATTER_SUCCESS 0      /* the function succeeded */
+#define ESPA_FORMATTER_ERROR -1       /* the function failed; see
+                                         espa_formatter_last_error */
+#define ESPA_FORMATTER_NAME_SIZE 256  /* size of the names in the band
+                                         information */
+
+/* Product opened from its XML metadata; the layout is private */
+typedef struct Espa_formatter_product Espa_formatter_product_t;
+
+/* Conversion or export submitted to run in the background; the layout is
+   private */
+typedef struct Espa_formatter_job Espa_formatter_job_t;
+
+/* Data types of the band pixels */
+typedef enum {
+    ESPA_FORMATTER_INT8,
+    ESPA_FORMATTER_UINT8,
+    ESPA_FORMATTER_INT16,
+    ESPA_FORMATTER_UINT16,
+    ESPA_FORMATTER_INT32,
+    ESPA_FORMATTER_UINT32,
+    ESPA_FORMATTER_FLOAT32,
+    ESPA_FORMATTER_FLOAT64
+} Espa_formatter_data_type_t;
+
+/* Level-1 products which can be converted to the ESPA internal format */
+typedef enum {
+    ESPA_FORMATTER_LPGS,         /* Landsat product; the input is its MTL
+                                    file, with the GeoTIFF bands alongside */
+    ESPA_FORMATTER_LPGS_BUNDLE,  /* Landsat bundle (.tar or .tar.gz); needs a
+                                    library built with ENABLE_LIBARCHIVE */
+    ESPA_FORMATTER_MODIS         /* MODIS product; the input is its HDF
+                                    file */
+} Espa_formatter_source_t;
+
+/* States of a job */
+typedef enum {
+    ESPA_FORMATTER_JOB_QUEUED,     /* waiting for the jobs before it */
+    ESPA_FORMATTER_JOB_RUNNING,    /* running */
+    ESPA_FORMATTER_JOB_SUCCEEDED,  /* done; the job succeeded */
+    ESPA_FORMATTER_JOB_FAILED,     /* done; see espa_formatter_job_error */
+    ESPA_FORMATTER_JOB_CANCELLED   /* done; cancelled before it completed */
+} Espa_formatter_job_state_t;
+
+/* Completion callback of a job, called once when the job is done.  It is
+   called from the thread which ran the job (or from the thread cancelling
+   a queued job), so it should be short and must not wait for other jobs;
+   it may free the job. */
+typedef void (*Espa_formatter_job_callback_t)
+(
+    Espa_formatter_job_t *job,         /* I: job which is done */
+    Espa_formatter_job_state_t state,  /* I: final state of the job */
+    void *user_data                    /* I: user data given with the job */
+);
+
+/* Information about a band */
+typedef struct
+{
+    char name[ESPA_FORMATTER_NAME_SIZE];     /* band name (ex. sr_band1) */
+    char product[ESPA_FORMATTER_NAME_SIZE];  /* product type of the band */
+    char category[ESPA_FORMATTER_NAME_SIZE]; /* category (image, qa, ...) */
+    char data_units[ESPA_FORMATTER_NAME_SIZE]; /* units of the pixels */
+    Espa_formatter_data_type_t data_type;    /* data type of the pixels */
+    int pixel_bytes;             /* number of bytes per pixel */
+    int nlines;                  /* number of lines in the band */
+    int nsamps;                  /* number of samples in the band */
+    double pixel_size[2];        /* pixel size x, y */
+    long fill_value;             /* fill value; see has_fill_value */
+    int has_fill_value;          /* does the band have a fill value? */
+    double scale_factor;         /* scale factor of the pixels; 1 if none */
+    double add_offset;           /* offset of the pixels; 0 if none */
+} Espa_formatter_band_info_t;
+
+/* Prototypes */
+int espa_formatter_init (void);
+
+const char *espa_formatter_version (void);
+
+const char *espa_formatter_last_error (void);
+
+int espa_formatter_open
+(
+    const char *xml_file,    /* I: XML metadata file of the ESPA product */
+    Espa_formatter_product_t **product  /* O: handle of the product; free
+                                    with espa_formatter_close */
+);
+
+void espa_formatter_close
+(
+    Espa_formatter_product_t *product   /* I: product to be closed; may be
+                                    NULL */
+);
+
+int espa_formatter_nbands
+(
+    const Espa_formatter_product_t *product  /* I: product */
+);
+
+int espa_formatter_find_band
+(
+    const Espa_formatter_product_t *product, /* I: product */
+    const char *band_name    /* I: name of the band */
+);
+
+int espa_formatter_band_info
+(
+    const Espa_formatter_product_t *product, /* I: product */
+    int band,                /* I: 0-based index of the band */
+    Espa_formatter_band_info_t *info  /* O: information about the band */
+);
+
+int espa_formatter_read_window
+(
+    Espa_formatter_product_t *product, /* I: product */
+    int band,                /* I: 0-based index of the band */
+    int line0,               /* I: 0-based first line of the window */
+    int nlines,              /* I: number of lines in the window */
+    int samp0,               /* I: 0-based first sample of the window */
+    int nsamps,              /* I: number of samples in the window */
+    void *buf                /* O: nlines * nsamps pixels of the window, in
+                                   the native byte order; at least
+                                   nlines * nsamps * pixel_bytes bytes */
+);
+
+int espa_formatter_map_band
+(
+    Espa_formatter_product_t *product, /* I: product */
+    int band,                /* I: 0-based index of the band */
+    const void **data,       /* O: first pixel of the band, in the native
+                                   byte order; valid until the product is
+                                   closed */
+    size_t *nbytes           /* O: number of bytes in the band */
+);
+
+char *espa_formatter_metadata_json
+(
+    const Espa_formatter_product_t *product  /* I: product */
+);
+
+void espa_formatter_free
+(
+    void *ptr                /* I: memory returned by the library; may be
+                                   NULL */
+);
+
+int espa_formatter_convert
+(
+    Espa_formatter_source_t source,  /* I: type of the Level-1 product */
+    const char *input_file,  /* I: MTL, bundle, or HDF file of the product */
+    const char *xml_file     /* I: XML metadata file of the ESPA product to
+                                   be written; the bands are written
+                                   alongside it */
+);
+
+int espa_formatter_export
+(
+    const Espa_formatter_product_t *product, /* I: product */
+    const char *gtif_file,   /* I: base name of the GeoTIFF bands; NULL to
+                                   skip the GeoTIFF export */
+    const char *netcdf_file, /* I: NetCDF file; NULL to skip it */
+    const char *hdf_file     /* I: HDF-EOS file; NULL to skip it */
+);
+
+int espa_formatter_convert_async
+(
+    Espa_formatter_source_t source,  /* I: type of the Level-1 product */
+    const char *input_file,  /* I: MTL, bundle, or HDF file of the product */
+    const char *xml_file,    /* I: XML metadata file of the ESPA product to
+                                   be written */
+    Espa_formatter_job_callback_t callback,  /* I: completion callback; may
+                                   be NULL */
+    void *user_data,         /* I: passed to the callback */
+    Espa_formatter_job_t **job  /* O: handle of the job; free with
+                                   espa_formatter_job_free */
+);
+
+int espa_formatter_export_async
+(
+    const Espa_formatter_product_t *product, /* I: product; may be closed
+                                   once the job is submitted */
+    const char *gtif_file,   /* I: base name of the GeoTIFF bands; NULL to
+                                   skip the GeoTIFF export */
+    const char *netcdf_file, /* I: NetCDF file; NULL to skip it */
+    const char *hdf_file,    /* I: HDF-EOS file; NULL to skip it */
+    Espa_formatter_job_callback_t callback,  /* I: completion callback; may
+                                   be NULL */
+    void *user_data,         /* I: passed to the callback */
+    Espa_formatter_job_t **job  /* O: handle of the job; free with
+                                   espa_formatter_job_free */
+);
+
+Espa_formatter_job_state_t espa_formatter_job_state
+(
+    const Espa_formatter_job_t *job  /* I: job */
+);
+
+double espa_formatter_job_progress
+(
+    const Espa_formatter_job_t *job  /* I: job */
+);
+
+int espa_formatter_job_fd
+(
+    const Espa_formatter_job_t *job  /* I: job */
+);
+
+int espa_formatter_job_wait
+(
+    Espa_formatter_job_t *job  /* I: job to be waited for */
+);
+
+int espa_formatter_job_cancel
+(
+    Espa_formatter_job_t *job  /* I: job to be cancelled */
+);
+
+const char *espa_formatter_job_error
+(
+    const Espa_formatter_job_t *job  /* I: job */
+);
+
+void espa_formatter_job_free
+(
+    Espa_formatter_job_t *job  /* I: job to be freed; may be NULL */
+);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -14,9 +14,18 @@ Date         Programmer       Reason
 12/12/2013   Gail Schmidt     Original development
 
 NOTES:
+  1. The messages are written through espa_log_write, so they go through the
+     background thread of the log when it is used (see espa_log.h).
 *****************************************************************************/
 
+#include <string.h>
 #include "error_handler.h"
+#include "espa_log.h"
+
+/* Buffer the error messages of the thread are captured in; NULL if they are
+   printed */
+static __thread char *capture_buf = NULL;
+static __thread size_t capture_size = 0;
 
 /******************************************************************************
 MODULE:  error_handler
@@ -32,6 +41,12 @@ Date         Programmer       Reason
 12/12/2013   Gail Schmidt     Original development
 
 NOTES:
+  1. While the thread captures its errors (see capture_errors), the errors
+     are appended to the capture buffer instead, and the warnings are
+     dropped.
+  2. Warnings below the level of the log (ESPA_LOG_LEVEL_ENV) are dropped.
+     Errors are flushed before returning, so they are out before the caller
+     gives up.
 ******************************************************************************/
 void error_handler
 (
@@ -41,8 +56,60 @@ void error_handler
                             ending EOL */
 )
 {
+    size_t len;       /* length of the messages already captured */
+    char text[STR_SIZE + 256];  /* formatted message */
+
+    if (capture_buf != NULL)
+    {
+        if (!error_flag)
+            return;
+        len = strlen (capture_buf);
+        if (len + 1 < capture_size)
+            snprintf (capture_buf + len, capture_size - len, "%s%s: %s",
+                len > 0 ? "\n" : "", module, errmsg);
+        return;
+    }
+
     if (error_flag)
-        printf ("Error: %s : %s\n\n", module, errmsg);
-    else
-        printf ("Warning: %s : %s\n", module, errmsg);
+    {
+        snprintf (text, sizeof (text), "Error: %s : %s\n\n", module, errmsg);
+        espa_log_write (stdout, text);
+        espa_log_flush ();
+    }
+    else if (espa_log_enabled (ESPA_LOG_WARN))
+    {
+        snprintf (text, sizeof (text), "Warning: %s : %s\n", module, errmsg);
+        espa_log_write (stdout, text);
+    }
+}
+
+
+/******************************************************************************
+MODULE:  capture_errors
+
+PURPOSE:  Starts or stops capturing the error messages of the calling thread
+in a buffer.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. The buffer is emptied when the capture starts.  Each error is appended
+     on its own line as "module: message", so the first line is the error
+     where it happened and the later ones are the callers which failed
+     because of it.  Errors which don't fit are dropped.
+  2. Only the calling thread is affected; the errors of the threads it starts
+     are still printed.
+******************************************************************************/
+void capture_errors
+(
+    char *buf,        /* I: buffer the error messages of the calling thread
+                            are appended to; NULL to print them again */
+    size_t size       /* I: size of buf */
+)
+{
+    capture_buf = (size > 0) ? buf : NULL;
+    capture_size = size;
+    if (capture_buf != NULL)
+        capture_buf[0] = '\0';
 }
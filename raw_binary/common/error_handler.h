@@ -9,6 +9,9 @@ at the USGS EROS
 LICENSE TYPE:  NASA Open Source Agreement Version 1.3
 
 NOTES:
+  1. A thread can capture its error messages in a buffer rather than having
+     them printed (see capture_errors), for callers which report the errors
+     themselves (ex. the shared library API in espa_formatter.h).
 *****************************************************************************/
 
 #ifndef ERROR_HANDLER_H_
@@ -28,4 +31,11 @@ void error_handler
                             ending EOL */
 );
 
+void capture_errors
+(
+    char *buf,        /* I: buffer the error messages of the calling thread
+                            are appended to; NULL to print them again */
+    size_t size       /* I: size of buf */
+);
+
 #endif
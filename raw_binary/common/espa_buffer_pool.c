@@ -0,0 +1,431 @@
+/*****************************************************************************
+FILE: espa_buffer_pool.c
+
+PURPOSE: Contains functions for the pool of aligned image buffers shared by
+the converters.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The pool is a small fixed table of the buffers it has handed out, each
+     either in use or idle.  A request is given the smallest idle buffer
+     which holds it, as long as that buffer is no more than
+     ESPA_BUFFER_MAX_WASTE times the size asked for, so a small request
+     doesn't tie up a large band buffer.
+  2. When the table is full, a new buffer takes the slot of an idle buffer,
+     which is freed.  If every buffer is in use the new buffer isn't
+     tracked, and is freed when it is given back.
+  3. The sizes are rounded up (to ESPA_BUFFER_ALIGN, or to
+     ESPA_BUFFER_HUGE_SIZE for the large buffers), so the buffers of bands
+     of about the same size are interchangeable.
+*****************************************************************************/
+
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <strings.h>
+#include "espa_trace.h"
+#include "espa_task_pool.h"
+#include "espa_buffer_pool.h"
+
+/* Defines */
+#define ESPA_BUFFER_MAX_WASTE 2   /* largest ratio of the size of a reused
+                                     buffer to the size asked for */
+
+/* Buffer handed out by the pool */
+typedef struct
+{
+    void *ptr;                   /* the buffer; NULL if the slot is free */
+    size_t size;                 /* number of bytes in the buffer */
+    int node;                    /* NUMA node the buffer was placed on; -1
+                                    if not placed */
+    bool in_use;                 /* is the buffer handed out? */
+} Espa_buffer_t;
+
+static Espa_buffer_t buffers[ESPA_BUFFER_POOL_SIZE];  /* buffers of the
+                                    pool */
+static char pool_lock = 0;       /* spin lock for the buffers */
+static int numa_state = -1;      /* -1 not yet checked, 0 off, 1 on */
+
+/******************************************************************************
+MODULE: pool_lock_acquire
+
+PURPOSE: Acquires the spin lock for the buffers.
+
+RETURN VALUE:
+Type = N/A
+
+NOTES:
+*****************************************************************************/
+static void pool_lock_acquire (void)
+{
+    while (__atomic_test_and_set (&pool_lock, __ATOMIC_ACQUIRE))
+        ;
+}
+
+
+/******************************************************************************
+MODULE: pool_lock_release
+
+PURPOSE: Releases the spin lock for the buffers.
+
+RETURN VALUE:
+Type = N/A
+
+NOTES:
+*****************************************************************************/
+static void pool_lock_release (void)
+{
+    __atomic_clear (&pool_lock, __ATOMIC_RELEASE);
+}
+
+
+/******************************************************************************
+MODULE: numa_enabled
+
+PURPOSE: Checks whether the buffers are placed on the NUMA node of the
+thread which asks for them.
+
+RETURN VALUE:
+Type = bool
+Value        Description
+-----        -----------
+true         The buffers are placed on the node of the asking thread
+false        The buffers are placed wherever they are first touched
+
+NOTES:
+  1. The environment variable is only checked on the first call.
+*****************************************************************************/
+static bool numa_enabled (void)
+{
+    char *env = NULL;            /* value of the environment variable */
+    int state;                   /* current state of the placement */
+
+    state = __atomic_load_n (&numa_state, __ATOMIC_ACQUIRE);
+    if (state >= 0)
+        return state == 1;
+
+    env = getenv (ESPA_BUFFER_NUMA_ENV);
+    state = env != NULL && (!strcasecmp (env, "yes") || !strcmp (env, "1"));
+    __atomic_store_n (&numa_state, state, __ATOMIC_RELEASE);
+
+    return state == 1;
+}
+
+
+/******************************************************************************
+MODULE: current_node
+
+PURPOSE: Returns the NUMA node of the calling thread.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+-1           The placement is off, or the node couldn't be determined
+>= 0         NUMA node the calling thread is running on
+
+NOTES:
+  1. With the NUMA placement of the task pool on, its threads stay on their
+     nodes, so the node is taken from the pool.
+*****************************************************************************/
+static int current_node (void)
+{
+    unsigned cpu;                /* CPU the thread is running on */
+    unsigned node;               /* NUMA node of the CPU */
+
+    if (espa_task_pool_numa ())
+        return espa_task_pool_node ();
+    if (!numa_enabled ())
+        return -1;
+
+#ifdef SYS_getcpu
+    if (syscall (SYS_getcpu, &cpu, &node, NULL) == 0)
+        return (int) node;
+#endif
+
+    return -1;
+}
+
+
+/******************************************************************************
+MODULE: round_size
+
+PURPOSE: Rounds a requested size up to the size of the buffer allocated for
+it.
+
+RETURN VALUE:
+Type = size_t
+Value        Description
+-----        -----------
+size         Number of bytes to allocate
+
+NOTES:
+*****************************************************************************/
+static size_t round_size
+(
+    size_t size          /* I: number of bytes needed */
+)
+{
+    size_t unit;         /* unit the size is rounded up to */
+
+    unit = size >= ESPA_BUFFER_HUGE_SIZE ? ESPA_BUFFER_HUGE_SIZE
+        : ESPA_BUFFER_ALIGN;
+    if (size == 0)
+        size = 1;
+
+    return (size + unit - 1) / unit * unit;
+}
+
+
+/******************************************************************************
+MODULE: alloc_buffer
+
+PURPOSE: Allocates a new aligned buffer, advising huge pages for the large
+buffers and placing it on the NUMA node of the calling thread when asked.
+
+RETURN VALUE:
+Type = void *
+Value        Description
+-----        -----------
+NULL         Error allocating the buffer
+buffer       Allocated buffer
+
+NOTES:
+  1. The placement relies on the first touch policy of Linux: each page is
+     written from the calling thread before the buffer is handed out, so it
+     is backed by memory of the node the thread is running on.
+*****************************************************************************/
+static void *alloc_buffer
+(
+    size_t size,         /* I: number of bytes to allocate (rounded) */
+    int node             /* I: NUMA node of the calling thread; -1 if the
+                               buffer isn't placed */
+)
+{
+    void *buf = NULL;            /* allocated buffer */
+    size_t alignment;            /* alignment of the buffer */
+    size_t page;                 /* size of a page */
+    size_t i;                    /* looping variable for the pages */
+
+    alignment = size >= ESPA_BUFFER_HUGE_SIZE ? ESPA_BUFFER_HUGE_SIZE
+        : ESPA_BUFFER_ALIGN;
+    if (espa_trace_posix_memalign (&buf, alignment, size) != 0)
+        return NULL;
+
+#ifdef MADV_HUGEPAGE
+    /* Only a hint; the buffer works the same without huge pages */
+    if (size >= ESPA_BUFFER_HUGE_SIZE)
+        madvise (buf, size, MADV_HUGEPAGE);
+#endif
+
+    if (node >= 0)
+    {
+        page = sysconf (_SC_PAGESIZE);
+        for (i = 0; i < size; i += page)
+            ((volatile char *) buf)[i] = 0;
+    }
+
+    return buf;
+}
+
+
+/******************************************************************************
+MODULE: espa_buffer_get
+
+PURPOSE: Gets an aligned buffer of at least the requested size, reusing an
+idle buffer of the pool when one fits.
+
+RETURN VALUE:
+Type = void *
+Value        Description
+-----        -----------
+NULL         Error allocating the buffer
+buffer       Buffer to be given back with espa_buffer_put
+
+NOTES:
+  1. The errors aren't reported here, so the caller reports them with the
+     sizes of the data the buffer was for, as for the other allocations.
+*****************************************************************************/
+void *espa_buffer_get
+(
+    size_t size          /* I: number of bytes needed */
+)
+{
+    void *buf = NULL;            /* buffer handed out */
+    void *evicted = NULL;        /* idle buffer freed to make room */
+    size_t alloc_size;           /* number of bytes allocated */
+    int node;                    /* NUMA node of the calling thread */
+    int best = -1;               /* smallest idle buffer which fits */
+    int slot = -1;               /* slot for a new buffer */
+    int i;                       /* looping variable for the buffers */
+
+    alloc_size = round_size (size);
+    node = current_node ();
+
+    /* Reuse the smallest idle buffer which fits */
+    pool_lock_acquire ();
+    for (i = 0; i < ESPA_BUFFER_POOL_SIZE; i++)
+    {
+        if (buffers[i].ptr == NULL || buffers[i].in_use ||
+            buffers[i].size < alloc_size ||
+            buffers[i].size / ESPA_BUFFER_MAX_WASTE > alloc_size ||
+            buffers[i].node != node)
+            continue;
+        if (best < 0 || buffers[i].size < buffers[best].size)
+            best = i;
+    }
+    if (best >= 0)
+    {
+        buffers[best].in_use = true;
+        buf = buffers[best].ptr;
+    }
+    pool_lock_release ();
+    if (buf != NULL)
+        return buf;
+
+    /* Allocate a new buffer, releasing the idle buffers to stay within the
+       memory budget if need be */
+    buf = alloc_buffer (alloc_size, node);
+    if (buf == NULL)
+    {
+        espa_buffer_pool_trim ();
+        buf = alloc_buffer (alloc_size, node);
+        if (buf == NULL)
+            return NULL;
+    }
+
+    /* Track it in a free slot, or in place of an idle buffer */
+    pool_lock_acquire ();
+    for (i = 0; i < ESPA_BUFFER_POOL_SIZE; i++)
+    {
+        if (buffers[i].ptr == NULL)
+        {
+            slot = i;
+            break;
+        }
+        if (slot < 0 && !buffers[i].in_use)
+            slot = i;
+    }
+    if (slot >= 0)
+    {
+        evicted = buffers[slot].ptr;
+        buffers[slot].ptr = buf;
+        buffers[slot].size = alloc_size;
+        buffers[slot].node = node;
+        buffers[slot].in_use = true;
+    }
+    pool_lock_release ();
+    espa_trace_free (evicted);
+
+    return buf;
+}
+
+
+/******************************************************************************
+MODULE: espa_buffer_get_zeroed
+
+PURPOSE: Gets an aligned buffer of at least the requested size, with the
+requested bytes cleared.
+
+RETURN VALUE:
+Type = void *
+Value        Description
+-----        -----------
+NULL         Error allocating the buffer
+buffer       Buffer to be given back with espa_buffer_put
+
+NOTES:
+*****************************************************************************/
+void *espa_buffer_get_zeroed
+(
+    size_t size          /* I: number of bytes needed */
+)
+{
+    void *buf = NULL;            /* buffer handed out */
+
+    buf = espa_buffer_get (size);
+    if (buf != NULL)
+        memset (buf, 0, size);
+
+    return buf;
+}
+
+
+/******************************************************************************
+MODULE: espa_buffer_put
+
+PURPOSE: Gives a buffer back to the pool, to be reused.
+
+RETURN VALUE:
+Type = N/A
+
+NOTES:
+  1. A buffer which the pool wasn't tracking is freed.
+*****************************************************************************/
+void espa_buffer_put
+(
+    void *buf            /* I: buffer from espa_buffer_get to be given back
+                               to the pool; may be NULL */
+)
+{
+    bool tracked = false;        /* was the buffer tracked by the pool? */
+    int i;                       /* looping variable for the buffers */
+
+    if (buf == NULL)
+        return;
+
+    pool_lock_acquire ();
+    for (i = 0; i < ESPA_BUFFER_POOL_SIZE; i++)
+    {
+        if (buffers[i].ptr == buf)
+        {
+            buffers[i].in_use = false;
+            tracked = true;
+            break;
+        }
+    }
+    pool_lock_release ();
+
+    if (!tracked)
+        espa_trace_free (buf);
+}
+
+
+/******************************************************************************
+MODULE: espa_buffer_pool_trim
+
+PURPOSE: Frees the idle buffers of the pool.
+
+RETURN VALUE:
+Type = N/A
+
+NOTES:
+  1. The buffers in use are kept, and are reused once they are given back.
+*****************************************************************************/
+void espa_buffer_pool_trim (void)
+{
+    void *idle[ESPA_BUFFER_POOL_SIZE];  /* idle buffers to be freed */
+    int nidle = 0;               /* number of idle buffers */
+    int i;                       /* looping variable for the buffers */
+
+    pool_lock_acquire ();
+    for (i = 0; i < ESPA_BUFFER_POOL_SIZE; i++)
+    {
+        if (buffers[i].ptr != NULL && !buffers[i].in_use)
+        {
+            idle[nidle++] = buffers[i].ptr;
+            buffers[i].ptr = NULL;
+        }
+    }
+    pool_lock_release ();
+
+    /* Free them outside the lock, since freeing takes the lock of the
+       accounting */
+    for (i = 0; i < nidle; i++)
+        espa_trace_free (idle[i]);
+}
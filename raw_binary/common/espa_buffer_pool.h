@@ -0,0 +1,72 @@
+/*****************************************************************************
+FILE: espa_buffer_pool.h
+
+PURPOSE: Contains defines and prototypes for the pool of aligned image
+buffers shared by the converters, so the band and block buffers of one band
+are reused by the next rather than being allocated (and faulted in) again.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. espa_buffer_get returns a buffer of at least the requested size,
+     aligned to ESPA_BUFFER_ALIGN bytes, which is given back to the pool
+     with espa_buffer_put.  The contents of a reused buffer are whatever its
+     last user left in it; espa_buffer_get_zeroed clears them.
+  2. The buffers are allocated with espa_trace_posix_memalign, so they are
+     accounted for and held to the memory budget (see espa_trace.h) while
+     they are in the pool as well.  An allocation which would exceed the
+     budget releases the idle buffers of the pool and tries again.
+  3. Buffers of ESPA_BUFFER_HUGE_SIZE bytes or more are aligned to and
+     rounded up to that size, and the kernel is advised to back them with
+     transparent huge pages, which cuts the TLB misses of streaming through
+     a band.
+  4. Setting ESPA_BUFFER_NUMA_ENV to yes (or 1) places each new buffer on
+     the NUMA node of the thread which asked for it, by touching its pages
+     from that thread (the first touch policy of Linux), and only reuses the
+     idle buffers placed on the node of the asking thread.  The NUMA
+     placement of the task pool (see espa_task_pool.h) does the same.
+  5. The pool is guarded by a spin lock built on the compiler atomics, as
+     in the trace, so it may be used from threaded code without requiring
+     the tools to link with the pthread library.
+*****************************************************************************/
+
+#ifndef ESPA_BUFFER_POOL_H
+#define ESPA_BUFFER_POOL_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+
+/* Defines */
+#define ESPA_BUFFER_NUMA_ENV "ESPA_BUFFER_NUMA"  /* places the buffers on the
+                                         NUMA node of the asking thread */
+#define ESPA_BUFFER_ALIGN 64          /* alignment of the buffers (bytes) */
+#define ESPA_BUFFER_HUGE_SIZE (2 * 1024 * 1024)  /* size of a huge page;
+                                         buffers at least this large are
+                                         backed by huge pages */
+#define ESPA_BUFFER_POOL_SIZE 64      /* most buffers tracked by the pool */
+
+/* Prototypes */
+void *espa_buffer_get
+(
+    size_t size          /* I: number of bytes needed */
+);
+
+void *espa_buffer_get_zeroed
+(
+    size_t size          /* I: number of bytes needed */
+);
+
+void espa_buffer_put
+(
+    void *buf            /* I: buffer from espa_buffer_get to be given back
+                               to the pool; may be NULL */
+);
+
+void espa_buffer_pool_trim (void);
+
+#endif
@@ -0,0 +1,187 @@
+/*****************************************************************************
+FILE: espa_cpu_dispatch.c
+
+PURPOSE: Contains functions for detecting the vector instruction sets of the
+CPU (see espa_cpu_dispatch.h).
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The features are detected on the first call and kept.  The detection
+     has the same result in every thread, so threads racing on the first
+     call only store the same value.
+  2. The tables of the kernels are filled by initializers run when the
+     program is loaded, before main and before the constructors of other
+     objects are guaranteed to have run, so the CPU model of the compiler
+     runtime is initialized here before it is queried.
+*****************************************************************************/
+
+#include <string.h>
+#include "espa_cpu_dispatch.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define ESPA_CPU_X86
+#endif
+
+/* Instruction sets allowed by each value of ESPA_SIMD_ENV */
+typedef struct
+{
+    const char *name;         /* value of the environment variable */
+    int features;             /* instruction sets which may be used */
+} Simd_limit_t;
+
+static const Simd_limit_t simd_limits[] =
+{
+    {"scalar", 0},
+    {"sse2", ESPA_CPU_SSE2},
+    {"avx2", ESPA_CPU_SSE2 | ESPA_CPU_SSE42 | ESPA_CPU_AVX2},
+    {"avx512bw", ESPA_CPU_SSE2 | ESPA_CPU_SSE42 | ESPA_CPU_AVX2 |
+        ESPA_CPU_AVX512BW},
+    {"neon", ESPA_CPU_NEON}
+};
+
+static int cpu_features = -1; /* detected instruction sets; -1 until they
+                                 are detected */
+
+
+/******************************************************************************
+MODULE:  detect_cpu_features
+
+PURPOSE:  Detects the instruction sets of the CPU, limited by ESPA_SIMD_ENV.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+n               ESPA_CPU_* bits of the instruction sets to be used
+
+NOTES:
+  1. AVX-512BW is only used along with AVX2, which every CPU with AVX-512BW
+     has, since its kernels leave the remainder to the narrower kernels.
+  2. NEON is part of every AArch64 CPU, and a 32-bit ARM build with NEON
+     enabled already requires it.
+******************************************************************************/
+static int detect_cpu_features (void)
+{
+    char FUNC_NAME[] = "detect_cpu_features";  /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    char *env = NULL;         /* value of the environment variable */
+    int features = 0;         /* detected instruction sets */
+    int i;                    /* looping variable for the limits */
+    int nlimits = sizeof (simd_limits) / sizeof (simd_limits[0]);
+                              /* number of values of the variable */
+
+#if defined(ESPA_CPU_X86)
+    __builtin_cpu_init ();
+    if (__builtin_cpu_supports ("sse2"))
+        features |= ESPA_CPU_SSE2;
+    if (__builtin_cpu_supports ("sse4.2"))
+        features |= ESPA_CPU_SSE42;
+    if (__builtin_cpu_supports ("avx2"))
+        features |= ESPA_CPU_AVX2;
+    if ((features & ESPA_CPU_AVX2) && __builtin_cpu_supports ("avx512bw"))
+        features |= ESPA_CPU_AVX512BW;
+#elif defined(__aarch64__) || defined(__ARM_NEON)
+    features |= ESPA_CPU_NEON;
+#endif
+
+    env = getenv (ESPA_SIMD_ENV);
+    if (env == NULL || *env == '\0')
+        return (features);
+
+    for (i = 0; i < nlimits; i++)
+    {
+        if (!strcmp (env, simd_limits[i].name))
+            return (features & simd_limits[i].features);
+    }
+
+    sprintf (errmsg, "Invalid %s value %.100s; using every instruction set "
+        "of the CPU", ESPA_SIMD_ENV, env);
+    error_handler (false, FUNC_NAME, errmsg);
+    return (features);
+}
+
+
+/******************************************************************************
+MODULE:  espa_cpu_features
+
+PURPOSE:  Returns the vector instruction sets the SIMD kernels may use.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+n               ESPA_CPU_* bits of the instruction sets to be used
+
+NOTES:
+******************************************************************************/
+int espa_cpu_features (void)
+{
+    int features;             /* instruction sets to be used */
+
+    features = __atomic_load_n (&cpu_features, __ATOMIC_ACQUIRE);
+    if (features < 0)
+    {
+        features = detect_cpu_features ();
+        __atomic_store_n (&cpu_features, features, __ATOMIC_RELEASE);
+    }
+
+    return (features);
+}
+
+
+/******************************************************************************
+MODULE:  espa_cpu_supports
+
+PURPOSE:  Tells whether the SIMD kernels may use an instruction set.
+
+RETURN VALUE:
+Type = bool
+Value           Description
+-----           -----------
+true            The CPU supports the instruction set and it isn't ruled out
+                by ESPA_SIMD_ENV
+false           Otherwise
+
+NOTES:
+******************************************************************************/
+bool espa_cpu_supports
+(
+    int feature          /* I: ESPA_CPU_* instruction set */
+)
+{
+    return ((espa_cpu_features () & feature) == feature);
+}
+
+
+/******************************************************************************
+MODULE:  espa_cpu_simd_name
+
+PURPOSE:  Returns the name of the widest instruction set the SIMD kernels
+use, for the logs and the benchmarks.
+
+RETURN VALUE:
+Type = const char *
+Value           Description
+-----           -----------
+name            scalar, sse2, avx2, avx512bw, or neon
+
+NOTES:
+******************************************************************************/
+const char *espa_cpu_simd_name (void)
+{
+    int features = espa_cpu_features ();  /* instruction sets to be used */
+
+    if (features & ESPA_CPU_AVX512BW)
+        return ("avx512bw");
+    if (features & ESPA_CPU_AVX2)
+        return ("avx2");
+    if (features & ESPA_CPU_SSE2)
+        return ("sse2");
+    if (features & ESPA_CPU_NEON)
+        return ("neon");
+    return ("scalar");
+}
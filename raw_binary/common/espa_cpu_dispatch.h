@@ -0,0 +1,56 @@
+/*****************************************************************************
+FILE: espa_cpu_dispatch.h
+
+PURPOSE: Contains defines and prototypes for the detection of the vector
+instruction sets of the CPU, which the SIMD kernels of the libraries use to
+fill their tables of kernels once, so one binary runs the best kernels of
+every node it is deployed to.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The libraries are built for the baseline instruction set (SSE2 on
+     x86-64, NEON on AArch64).  The wider kernels are compiled with target
+     attributes and only put in a table when the CPU supports them.
+  2. Each module with SIMD kernels keeps a table of pointers to the kernels,
+     filled by an initializer run when the program (or shared library) is
+     loaded, so the kernels are called without checking the CPU again.
+  3. ESPA_SIMD_ENV limits the instruction sets used (scalar, sse2, avx2,
+     avx512bw, or neon), ex. to compare the kernels or to rule out a kernel
+     on a node; SSE4.2 is used along with AVX2.  It can only remove
+     instruction sets the CPU supports, and is read once, when the first
+     table is filled.
+*****************************************************************************/
+
+#ifndef ESPA_CPU_DISPATCH_H
+#define ESPA_CPU_DISPATCH_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include "error_handler.h"
+
+/* Defines */
+#define ESPA_SIMD_ENV "ESPA_SIMD"  /* widest instruction set to be used */
+
+/* Instruction sets of the SIMD kernels, as bits of espa_cpu_features */
+#define ESPA_CPU_SSE2     0x01     /* x86 SSE2 */
+#define ESPA_CPU_AVX2     0x02     /* x86 AVX2 */
+#define ESPA_CPU_AVX512BW 0x04     /* x86 AVX-512 byte and word */
+#define ESPA_CPU_NEON     0x08     /* ARM NEON (Advanced SIMD) */
+#define ESPA_CPU_SSE42    0x10     /* x86 SSE4.2 (CRC32C instruction) */
+
+/* Prototypes */
+int espa_cpu_features (void);
+
+bool espa_cpu_supports
+(
+    int feature          /* I: ESPA_CPU_* instruction set */
+);
+
+const char *espa_cpu_simd_name (void);
+
+#endif
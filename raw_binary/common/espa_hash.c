@@ -0,0 +1,123 @@
+/*****************************************************************************
+FILE: espa_hash.c
+
+PURPOSE: Contains functions for computing the FNV-1a hash of bytes and
+strings.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+*****************************************************************************/
+
+#include "espa_hash.h"
+
+/* Defines */
+#define ESPA_FNV1A_PRIME 1099511628211ULL   /* 64-bit FNV-1a prime */
+#define ESPA_FNV1A_BASIS_32 2166136261u     /* 32-bit FNV-1a offset basis */
+#define ESPA_FNV1A_PRIME_32 16777619u       /* 32-bit FNV-1a prime */
+
+
+/******************************************************************************
+MODULE:  espa_hash_fnv1a
+
+PURPOSE: Computes the 64-bit FNV-1a hash of a run of bytes, continuing the
+hash of the bytes before them.
+
+RETURN VALUE:
+Type = uint64_t
+Value           Description
+-----           -----------
+hash            64-bit FNV-1a hash of the bytes
+
+NOTES:
+  1. A run hashed in pieces, each continuing the hash of the one before,
+     hashes the same as when it is hashed at once.
+******************************************************************************/
+uint64_t espa_hash_fnv1a
+(
+    const void *data,         /* I: bytes to be hashed */
+    size_t len,               /* I: number of bytes */
+    uint64_t hash             /* I: hash of the bytes before these;
+                                    ESPA_FNV1A_BASIS to start */
+)
+{
+    const unsigned char *ptr = data;  /* next byte to be hashed */
+    size_t i;                 /* looping variable */
+
+    for (i = 0; i < len; i++)
+    {
+        hash ^= ptr[i];
+        hash *= ESPA_FNV1A_PRIME;
+    }
+
+    return (hash);
+}
+
+
+/******************************************************************************
+MODULE:  espa_hash_fnv1a_string
+
+PURPOSE: Computes the 64-bit FNV-1a hash of a string.
+
+RETURN VALUE:
+Type = uint64_t
+Value           Description
+-----           -----------
+hash            64-bit FNV-1a hash of the string, without its terminator
+
+NOTES:
+******************************************************************************/
+uint64_t espa_hash_fnv1a_string
+(
+    const char *str           /* I: string to be hashed */
+)
+{
+    const unsigned char *ptr = (const unsigned char *) str;  /* next
+                                 character to be hashed */
+    uint64_t hash = ESPA_FNV1A_BASIS;  /* hash of the string */
+
+    for (; *ptr != '\0'; ptr++)
+    {
+        hash ^= *ptr;
+        hash *= ESPA_FNV1A_PRIME;
+    }
+
+    return (hash);
+}
+
+
+/******************************************************************************
+MODULE:  espa_hash_fnv1a_32
+
+PURPOSE: Computes the 32-bit FNV-1a hash of a string.
+
+RETURN VALUE:
+Type = uint32_t
+Value           Description
+-----           -----------
+hash            32-bit FNV-1a hash of the string, without its terminator
+
+NOTES:
+  1. The perfect hash of the metadata element names (see meta_element.c) is
+     built on this hash.
+******************************************************************************/
+uint32_t espa_hash_fnv1a_32
+(
+    const char *str           /* I: string to be hashed */
+)
+{
+    const unsigned char *ptr = (const unsigned char *) str;  /* next
+                                 character to be hashed */
+    uint32_t hash = ESPA_FNV1A_BASIS_32;  /* hash of the string */
+
+    for (; *ptr != '\0'; ptr++)
+    {
+        hash ^= *ptr;
+        hash *= ESPA_FNV1A_PRIME_32;
+    }
+
+    return (hash);
+}
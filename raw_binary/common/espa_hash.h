@@ -0,0 +1,47 @@
+/*****************************************************************************
+FILE: espa_hash.h
+
+PURPOSE: Contains defines and prototypes for the FNV-1a hash shared by the
+metadata caches, the band index, the land/water mask cache, and the records
+of the incremental outputs.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The hashes name files and fill the caches written to disk, so they must
+     not change from one release to the next.
+*****************************************************************************/
+
+#ifndef ESPA_HASH_H
+#define ESPA_HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Defines */
+#define ESPA_FNV1A_BASIS 14695981039346656037ULL  /* 64-bit FNV-1a offset
+                                                     basis */
+
+/* Prototypes */
+uint64_t espa_hash_fnv1a
+(
+    const void *data,         /* I: bytes to be hashed */
+    size_t len,               /* I: number of bytes */
+    uint64_t hash             /* I: hash of the bytes before these;
+                                    ESPA_FNV1A_BASIS to start */
+);
+
+uint64_t espa_hash_fnv1a_string
+(
+    const char *str           /* I: string to be hashed */
+);
+
+uint32_t espa_hash_fnv1a_32
+(
+    const char *str           /* I: string to be hashed */
+);
+
+#endif
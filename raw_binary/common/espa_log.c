@@ -0,0 +1,587 @@
+/*****************************************************************************
+FILE: espa_log.c
+
+PURPOSE: Contains functions for the output of the log messages (see
+espa_log.h).
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The ring is a bounded queue of slots with a sequence number each.  A
+     writer claims a position by raising the head with a compare and swap,
+     copies its message into the slot, and publishes it by setting the
+     sequence of the slot; the background thread writes the slots from the
+     tail in order and frees them by moving the sequence a lap ahead.  The
+     writers take no lock unless the background thread is asleep.
+  2. The functions here don't report their problems through error_handler,
+     which writes through them.
+*****************************************************************************/
+
+#include <string.h>
+#include <strings.h>
+#include <stdarg.h>
+#ifdef _OPENMP
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#endif
+#include "espa_common.h"
+#include "espa_log.h"
+
+/* Defines */
+#define LOG_SLOTS 256             /* number of messages the ring holds */
+#define LOG_SLOT_SIZE 1024        /* longest message held in a slot,
+                                     including the ending NULL; longer ones
+                                     are written by the calling thread */
+#define LOG_IDLE_WAIT_MS 100      /* longest the background thread sleeps
+                                     before looking at the ring again */
+
+/* Level of the messages for each value of ESPA_LOG_LEVEL_ENV */
+typedef struct
+{
+    const char *name;             /* value of the environment variable */
+    int level;                    /* ESPA_LOG_* level */
+} Log_level_name_t;
+
+static const Log_level_name_t log_level_names[] =
+{
+    {"debug", ESPA_LOG_DEBUG},
+    {"info", ESPA_LOG_INFO},
+    {"warn", ESPA_LOG_WARN},
+    {"error", ESPA_LOG_ERROR}
+};
+
+static int log_level = -1;        /* lowest level written; -1 until it is
+                                     read */
+
+#ifdef _OPENMP
+/* Slot of the ring */
+typedef struct
+{
+    unsigned long seq;            /* position the slot is free for, or that
+                                     position plus one once its message is
+                                     published */
+    FILE *fp;                     /* file the message is written to */
+    char text[LOG_SLOT_SIZE];     /* message */
+} Log_slot_t;
+
+/* States of the background thread */
+#define LOG_THREAD_IDLE 0         /* not started */
+#define LOG_THREAD_RUNNING 1      /* writing the ring */
+#define LOG_THREAD_STOPPED 2      /* stopped when the program exits */
+
+static Log_slot_t log_ring[LOG_SLOTS];
+static unsigned long log_head = 0;  /* next position claimed by the writers */
+static unsigned long log_tail = 0;  /* next position written by the
+                                       background thread */
+static unsigned long log_done = 0;  /* positions written and flushed */
+static bool log_async = false;    /* are the messages queued in the ring? */
+static bool log_sleeping = false; /* is the background thread asleep? */
+static bool log_stop = false;     /* is the background thread to stop? */
+static bool log_atexit = false;   /* is stop_log_thread registered? */
+static int log_state = LOG_THREAD_IDLE;  /* state of the background
+                                            thread */
+static pthread_t log_thread;      /* background thread */
+static pthread_once_t log_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t log_mutex = PTHREAD_MUTEX_INITIALIZER;  /* guards the
+                                     state, log_done, and the sleep */
+static pthread_cond_t log_wake = PTHREAD_COND_INITIALIZER;  /* signaled when
+                                     the background thread is needed */
+static pthread_cond_t log_flushed = PTHREAD_COND_INITIALIZER;  /* signaled
+                                     when log_done or the state change */
+#endif
+
+
+/******************************************************************************
+MODULE:  read_log_level
+
+PURPOSE:  Reads the lowest level of the messages written from
+ESPA_LOG_LEVEL_ENV.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+n               ESPA_LOG_* level
+
+NOTES:
+  1. An invalid value is reported with printf, since error_handler is
+     waiting for the level.
+******************************************************************************/
+static int read_log_level (void)
+{
+    char *env = NULL;         /* value of the environment variable */
+    int i;                    /* looping variable for the names */
+    int nnames = sizeof (log_level_names) / sizeof (log_level_names[0]);
+                              /* number of values of the variable */
+
+    env = getenv (ESPA_LOG_LEVEL_ENV);
+    if (env == NULL || *env == '\0')
+        return (ESPA_LOG_INFO);
+
+    for (i = 0; i < nnames; i++)
+    {
+        if (!strcasecmp (env, log_level_names[i].name))
+            return (log_level_names[i].level);
+    }
+
+    printf ("Warning: read_log_level : Invalid %s value %.100s; using info\n",
+        ESPA_LOG_LEVEL_ENV, env);
+    return (ESPA_LOG_INFO);
+}
+
+
+/******************************************************************************
+MODULE:  espa_log_enabled
+
+PURPOSE:  Tells whether the messages of a level are written, so they are
+only formatted when they are.
+
+RETURN VALUE:
+Type = bool
+Value           Description
+-----           -----------
+true            The messages of the level are written
+false           The messages of the level are dropped
+
+NOTES:
+******************************************************************************/
+bool espa_log_enabled
+(
+    int level            /* I: ESPA_LOG_* level of the message */
+)
+{
+    int lowest;               /* lowest level written */
+
+    if (level >= ESPA_LOG_ERROR)
+        return (true);
+
+    lowest = __atomic_load_n (&log_level, __ATOMIC_ACQUIRE);
+    if (lowest < 0)
+    {
+        lowest = read_log_level ();
+        __atomic_store_n (&log_level, lowest, __ATOMIC_RELEASE);
+    }
+
+    return (level >= lowest);
+}
+
+
+#ifdef _OPENMP
+/******************************************************************************
+MODULE:  write_log_slots
+
+PURPOSE:  Writes the published messages of the ring, from the tail, and frees
+their slots.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. Only called by the background thread, or once it has stopped.  The file
+     is flushed when the messages change files and once the ring is empty.
+******************************************************************************/
+static void write_log_slots (void)
+{
+    Log_slot_t *slot = NULL;  /* slot at the tail */
+    FILE *last_fp = NULL;     /* file of the last message written */
+
+    while (1)
+    {
+        slot = &log_ring[log_tail % LOG_SLOTS];
+        if (__atomic_load_n (&slot->seq, __ATOMIC_ACQUIRE) != log_tail + 1)
+            break;
+
+        if (last_fp != NULL && slot->fp != last_fp)
+            fflush (last_fp);
+        fputs (slot->text, slot->fp);
+        last_fp = slot->fp;
+        __atomic_store_n (&slot->seq, log_tail + LOG_SLOTS,
+            __ATOMIC_RELEASE);
+        log_tail++;
+    }
+
+    if (last_fp != NULL)
+        fflush (last_fp);
+}
+
+
+/******************************************************************************
+MODULE:  run_log_thread
+
+PURPOSE:  Background thread writing the ring until the program exits.
+
+RETURN VALUE:
+Type = void *
+Value           Description
+-----           -----------
+NULL            Always
+
+NOTES:
+  1. The thread sleeps once the ring is empty, and is woken by the writers
+     which find it asleep.  The sleep is bounded, so a wake up lost to a
+     writer publishing while the thread goes to sleep only delays the
+     messages.
+******************************************************************************/
+static void *run_log_thread
+(
+    void *arg                 /* I: not used */
+)
+{
+    Log_slot_t *slot = NULL;  /* slot at the tail */
+    struct timespec deadline; /* end of the sleep */
+
+    while (1)
+    {
+        write_log_slots ();
+
+        pthread_mutex_lock (&log_mutex);
+        log_done = log_tail;
+        pthread_cond_broadcast (&log_flushed);
+        if (log_stop)
+        {
+            pthread_mutex_unlock (&log_mutex);
+            break;
+        }
+
+        __atomic_store_n (&log_sleeping, true, __ATOMIC_SEQ_CST);
+        slot = &log_ring[log_tail % LOG_SLOTS];
+        if (__atomic_load_n (&slot->seq, __ATOMIC_SEQ_CST) != log_tail + 1)
+        {
+            clock_gettime (CLOCK_REALTIME, &deadline);
+            deadline.tv_nsec += LOG_IDLE_WAIT_MS * 1000000L;
+            if (deadline.tv_nsec >= 1000000000L)
+            {
+                deadline.tv_sec++;
+                deadline.tv_nsec -= 1000000000L;
+            }
+            pthread_cond_timedwait (&log_wake, &log_mutex, &deadline);
+        }
+        __atomic_store_n (&log_sleeping, false, __ATOMIC_SEQ_CST);
+        pthread_mutex_unlock (&log_mutex);
+    }
+
+    return (NULL);
+}
+
+
+/******************************************************************************
+MODULE:  wake_log_thread
+
+PURPOSE:  Wakes the background thread.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+static void wake_log_thread (void)
+{
+    pthread_mutex_lock (&log_mutex);
+    pthread_cond_signal (&log_wake);
+    pthread_mutex_unlock (&log_mutex);
+}
+
+
+/******************************************************************************
+MODULE:  stop_log_thread
+
+PURPOSE:  Writes the rest of the ring and stops the background thread when
+the program exits.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. Registered with atexit.  The messages logged after it are written by
+     the calling thread.
+******************************************************************************/
+static void stop_log_thread (void)
+{
+    if (__atomic_load_n (&log_state, __ATOMIC_ACQUIRE) != LOG_THREAD_RUNNING)
+        return;
+
+    __atomic_store_n (&log_async, false, __ATOMIC_RELEASE);
+    pthread_mutex_lock (&log_mutex);
+    log_stop = true;
+    pthread_cond_signal (&log_wake);
+    pthread_mutex_unlock (&log_mutex);
+    pthread_join (log_thread, NULL);
+
+    /* Write the messages published after the thread last looked */
+    write_log_slots ();
+
+    pthread_mutex_lock (&log_mutex);
+    log_done = log_tail;
+    __atomic_store_n (&log_state, LOG_THREAD_STOPPED, __ATOMIC_RELEASE);
+    pthread_cond_broadcast (&log_flushed);
+    pthread_mutex_unlock (&log_mutex);
+}
+
+
+/******************************************************************************
+MODULE:  start_log_thread
+
+PURPOSE:  Starts the background thread on the first message queued.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. If the thread can't be started the messages are written by the calling
+     threads.
+******************************************************************************/
+static void start_log_thread (void)
+{
+    pthread_mutex_lock (&log_mutex);
+    if (__atomic_load_n (&log_state, __ATOMIC_ACQUIRE) == LOG_THREAD_IDLE)
+    {
+        if (pthread_create (&log_thread, NULL, run_log_thread, NULL) != 0)
+            __atomic_store_n (&log_async, false, __ATOMIC_RELEASE);
+        else
+        {
+            __atomic_store_n (&log_state, LOG_THREAD_RUNNING,
+                __ATOMIC_RELEASE);
+            if (!log_atexit && atexit (stop_log_thread) == 0)
+                log_atexit = true;
+        }
+    }
+    pthread_mutex_unlock (&log_mutex);
+}
+
+
+/******************************************************************************
+MODULE:  reset_log_after_fork
+
+PURPOSE:  Resets the ring in a child process, which has none of the threads
+of its parent.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. Registered with pthread_atfork, after the ring is flushed in the parent.
+     The background thread is started again when the child first logs.
+******************************************************************************/
+static void reset_log_after_fork (void)
+{
+    int i;                    /* looping variable for the slots */
+
+    pthread_mutex_init (&log_mutex, NULL);
+    pthread_cond_init (&log_wake, NULL);
+    pthread_cond_init (&log_flushed, NULL);
+    for (i = 0; i < LOG_SLOTS; i++)
+        log_ring[i].seq = i;
+    log_head = 0;
+    log_tail = 0;
+    log_done = 0;
+    log_sleeping = false;
+    log_stop = false;
+    if (log_state == LOG_THREAD_RUNNING)
+        log_state = LOG_THREAD_IDLE;
+}
+
+
+/******************************************************************************
+MODULE:  init_log
+
+PURPOSE:  Initializes the ring and reads ESPA_LOG_ASYNC_ENV, once for the
+process.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+static void init_log (void)
+{
+    char *env = NULL;         /* value of the environment variable */
+    int i;                    /* looping variable for the slots */
+
+    for (i = 0; i < LOG_SLOTS; i++)
+        log_ring[i].seq = i;
+
+    env = getenv (ESPA_LOG_ASYNC_ENV);
+    if (env != NULL && (!strcasecmp (env, "yes") || !strcmp (env, "1")))
+        __atomic_store_n (&log_async, true, __ATOMIC_RELEASE);
+
+    pthread_atfork (espa_log_flush, NULL, reset_log_after_fork);
+}
+
+
+/******************************************************************************
+MODULE:  queue_log_message
+
+PURPOSE:  Copies a message into the next slot of the ring.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           The ring is no longer used; the message isn't queued
+SUCCESS         The message is queued
+
+NOTES:
+  1. When the ring is full the writer wakes the background thread and
+     yields until a slot is freed.
+******************************************************************************/
+static int queue_log_message
+(
+    FILE *fp,            /* I: file the message is written to */
+    const char *text,    /* I: formatted message */
+    size_t len           /* I: length of the message */
+)
+{
+    Log_slot_t *slot = NULL;  /* slot claimed */
+    unsigned long pos;        /* position claimed */
+    unsigned long seq;        /* sequence of the slot */
+    long diff;                /* sequence of the slot less the position */
+
+    pos = __atomic_load_n (&log_head, __ATOMIC_RELAXED);
+    while (1)
+    {
+        slot = &log_ring[pos % LOG_SLOTS];
+        seq = __atomic_load_n (&slot->seq, __ATOMIC_ACQUIRE);
+        diff = (long) (seq - pos);
+        if (diff == 0)
+        {
+            if (__atomic_compare_exchange_n (&log_head, &pos, pos + 1, true,
+                __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+                break;
+        }
+        else if (diff < 0)
+        {
+            /* The ring is full */
+            if (!__atomic_load_n (&log_async, __ATOMIC_ACQUIRE))
+                return (ERROR);
+            wake_log_thread ();
+            sched_yield ();
+            pos = __atomic_load_n (&log_head, __ATOMIC_RELAXED);
+        }
+        else
+            pos = __atomic_load_n (&log_head, __ATOMIC_RELAXED);
+    }
+
+    slot->fp = fp;
+    memcpy (slot->text, text, len + 1);
+    __atomic_store_n (&slot->seq, pos + 1, __ATOMIC_SEQ_CST);
+
+    if (__atomic_load_n (&log_sleeping, __ATOMIC_SEQ_CST))
+        wake_log_thread ();
+
+    return (SUCCESS);
+}
+#endif
+
+
+/******************************************************************************
+MODULE:  espa_log_write
+
+PURPOSE:  Writes a formatted message, from the background thread in the
+asynchronous mode.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. Messages too long for a slot are written by the calling thread once the
+     ring is flushed, so they stay in order.
+******************************************************************************/
+void espa_log_write
+(
+    FILE *fp,            /* I: file the message is written to */
+    const char *text     /* I: formatted message, with its ending EOL */
+)
+{
+#ifdef _OPENMP
+    size_t len;               /* length of the message */
+
+    pthread_once (&log_once, init_log);
+    if (__atomic_load_n (&log_async, __ATOMIC_ACQUIRE))
+    {
+        len = strlen (text);
+        if (len < LOG_SLOT_SIZE)
+        {
+            if (__atomic_load_n (&log_state, __ATOMIC_ACQUIRE) ==
+                LOG_THREAD_IDLE)
+                start_log_thread ();
+            if (__atomic_load_n (&log_async, __ATOMIC_ACQUIRE) &&
+                queue_log_message (fp, text, len) == SUCCESS)
+                return;
+        }
+        espa_log_flush ();
+    }
+#endif
+
+    fputs (text, fp);
+}
+
+
+/******************************************************************************
+MODULE:  espa_log_printf
+
+PURPOSE:  Formats and writes a message to stdout, if its level is written.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. The message is cut to the size of a slot, keeping its ending EOL.
+******************************************************************************/
+void espa_log_printf
+(
+    int level,           /* I: ESPA_LOG_* level of the message */
+    const char *format,  /* I: format of the message, with its ending EOL */
+    ...                  /* I: values of the format */
+)
+{
+    char text[LOG_SLOT_SIZE]; /* formatted message */
+    va_list ap;               /* values of the format */
+    int len;                  /* length of the formatted message */
+
+    if (!espa_log_enabled (level))
+        return;
+
+    va_start (ap, format);
+    len = vsnprintf (text, sizeof (text), format, ap);
+    va_end (ap);
+    if (len < 0)
+        return;
+    if (len >= (int) sizeof (text))
+        text[sizeof (text) - 2] = '\n';
+
+    espa_log_write (stdout, text);
+}
+
+
+/******************************************************************************
+MODULE:  espa_log_flush
+
+PURPOSE:  Waits until the messages queued so far are written.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. Returns at once when the messages aren't queued.
+******************************************************************************/
+void espa_log_flush (void)
+{
+#ifdef _OPENMP
+    unsigned long target;     /* position the ring is written up to */
+
+    if (__atomic_load_n (&log_state, __ATOMIC_ACQUIRE) != LOG_THREAD_RUNNING)
+        return;
+
+    target = __atomic_load_n (&log_head, __ATOMIC_ACQUIRE);
+    pthread_mutex_lock (&log_mutex);
+    pthread_cond_signal (&log_wake);
+    while (log_done < target &&
+        __atomic_load_n (&log_state, __ATOMIC_ACQUIRE) == LOG_THREAD_RUNNING)
+        pthread_cond_wait (&log_flushed, &log_mutex);
+    pthread_mutex_unlock (&log_mutex);
+#endif
+}
@@ -0,0 +1,70 @@
+/*****************************************************************************
+FILE: espa_log.h
+
+PURPOSE: Contains defines and prototypes for the output of the log messages
+of error_handler, ias_logging, and the progress messages of the converters,
+which can be handed to a background thread so the threads writing them
+don't wait on the output.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. ESPA_LOG_LEVEL_ENV sets the lowest level of the messages written
+     (debug, info, warn, or error; info if it isn't set).  The level is
+     checked before a message is formatted, so the messages filtered out
+     cost no formatting.  Errors are always written.
+  2. When ESPA_LOG_ASYNC_ENV is set to yes (and threading is compiled in,
+     ENABLE_THREADING), the messages are copied into a ring of slots and
+     written by a background thread.  The threads only wait on the output
+     when the ring is full.  Otherwise the messages are written by the
+     calling thread, as before.
+  3. The messages of one thread are written in the order they were logged,
+     but in the asynchronous mode they may come after output the program
+     writes to the same file directly (ex. printf).  Errors are flushed
+     before error_handler returns, and the ring is flushed when the program
+     exits, forks, or changes the target of ias_logging.
+*****************************************************************************/
+
+#ifndef ESPA_LOG_H
+#define ESPA_LOG_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+
+/* Defines */
+#define ESPA_LOG_LEVEL_ENV "ESPA_LOG_LEVEL"  /* lowest level written */
+#define ESPA_LOG_ASYNC_ENV "ESPA_LOG_ASYNC"  /* yes to write the messages
+                                                from a background thread */
+
+/* Levels of the log messages, lowest first */
+#define ESPA_LOG_DEBUG 0
+#define ESPA_LOG_INFO  1
+#define ESPA_LOG_WARN  2
+#define ESPA_LOG_ERROR 3
+
+/* Prototypes */
+bool espa_log_enabled
+(
+    int level            /* I: ESPA_LOG_* level of the message */
+);
+
+void espa_log_write
+(
+    FILE *fp,            /* I: file the message is written to */
+    const char *text     /* I: formatted message, with its ending EOL */
+);
+
+void espa_log_printf
+(
+    int level,           /* I: ESPA_LOG_* level of the message */
+    const char *format,  /* I: format of the message, with its ending EOL */
+    ...                  /* I: values of the format */
+) __attribute__ ((format (printf, 2, 3)));
+
+void espa_log_flush (void);
+
+#endif
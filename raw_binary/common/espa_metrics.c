@@ -0,0 +1,378 @@
+/*****************************************************************************
+FILE: espa_metrics.c
+
+PURPOSE: Contains functions for recording the job metrics of the formatter
+worker in shared memory and writing them in the Prometheus text exposition
+format.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The metrics are updated with atomic operations, since any number of
+     jobs record into them at once.  A scrape may see a job's count before
+     its latency; the next scrape is consistent.
+  2. The latencies are kept in microseconds so they can be summed
+     atomically.
+*****************************************************************************/
+
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include "espa_common.h"
+#include "error_handler.h"
+#include "espa_metrics.h"
+
+/* Metrics of a tool */
+typedef struct
+{
+    uint64_t jobs[2];            /* jobs which failed and succeeded */
+    uint64_t buckets[ESPA_METRICS_NBUCKETS+1];  /* jobs in each latency
+                                    bucket, the last unbounded */
+    uint64_t latency_usec;       /* total latency (microseconds) */
+    uint64_t bytes_read;         /* bytes read by the jobs */
+    uint64_t bytes_written;      /* bytes written by the jobs */
+    uint64_t peak_rss_kb;        /* largest peak RSS of the jobs (KB) */
+    uint64_t cache[ESPA_METRICS_NCACHES][2];  /* misses and hits of each
+                                    cache */
+} Espa_metrics_tool_t;
+
+/* Metrics shared by the worker and its jobs */
+typedef struct
+{
+    uint64_t running;            /* jobs running */
+    uint64_t queued;             /* jobs waiting for a slot */
+    uint64_t slots;              /* jobs run at a time */
+    int ntools;                  /* number of tools */
+    Espa_metrics_tool_t tool[];  /* metrics of each tool */
+} Espa_metrics_t;
+
+static Espa_metrics_t *metrics = NULL;  /* shared metrics; NULL if off */
+static int current_tool = -1;    /* tool run by this process; -1 if none */
+
+/* Names of the caches in the metrics */
+static const char *cache_names[ESPA_METRICS_NCACHES] =
+    {"schema", "polygon", "projection", "metadata", "band"};
+
+/******************************************************************************
+MODULE: espa_metrics_share
+
+PURPOSE: Turns on the metrics, in memory shared with the processes forked
+from this one afterwards.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        The shared memory couldn't be mapped
+SUCCESS      The metrics are on
+
+NOTES:
+*****************************************************************************/
+int espa_metrics_share
+(
+    int ntools                   /* I: number of tools run as jobs */
+)
+{
+    char FUNC_NAME[] = "espa_metrics_share";   /* function name */
+    size_t size;                 /* size of the metrics (bytes) */
+    void *map = NULL;            /* shared memory */
+
+    size = sizeof (Espa_metrics_t) + ntools * sizeof (Espa_metrics_tool_t);
+    map = mmap (NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS,
+        -1, 0);
+    if (map == MAP_FAILED)
+    {
+        error_handler (true, FUNC_NAME, "Mapping the shared memory of the "
+            "metrics");
+        return (ERROR);
+    }
+
+    /* The mapping is zero filled */
+    metrics = map;
+    metrics->ntools = ntools;
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE: espa_metrics_set_tool
+
+PURPOSE: Sets the tool whose cache events are recorded by this process.
+
+RETURN VALUE:
+Type = N/A
+
+NOTES:
+  1. This is called in the process running the tool, after it is forked.
+*****************************************************************************/
+void espa_metrics_set_tool
+(
+    int tool                     /* I: index of the tool run by this
+                                       process */
+)
+{
+    current_tool = tool;
+}
+
+
+/******************************************************************************
+MODULE: espa_metrics_cache
+
+PURPOSE: Counts a hit or a miss of one of the caches, for the tool run by
+this process.
+
+RETURN VALUE:
+Type = N/A
+
+NOTES:
+*****************************************************************************/
+void espa_metrics_cache
+(
+    Espa_metrics_cache_t cache,  /* I: cache which was looked in */
+    bool hit                     /* I: was the entry found? */
+)
+{
+    if (metrics == NULL || current_tool < 0 ||
+        current_tool >= metrics->ntools)
+        return;
+
+    __atomic_fetch_add (&metrics->tool[current_tool].cache[cache][hit], 1,
+        __ATOMIC_RELAXED);
+}
+
+
+/******************************************************************************
+MODULE: espa_metrics_job_done
+
+PURPOSE: Records a finished job: its outcome, latency, bytes read and
+written, and peak memory.
+
+RETURN VALUE:
+Type = N/A
+
+NOTES:
+*****************************************************************************/
+void espa_metrics_job_done
+(
+    int tool,                    /* I: index of the tool of the job */
+    bool ok,                     /* I: did the tool succeed? */
+    double seconds,              /* I: wall-clock seconds of the job */
+    uint64_t bytes_read,         /* I: bytes read by the tool */
+    uint64_t bytes_written,      /* I: bytes written by the tool */
+    long peak_rss_kb             /* I: peak resident set size of the tool
+                                       (KB) */
+)
+{
+    static const double bounds[ESPA_METRICS_NBUCKETS] =
+        ESPA_METRICS_BUCKETS;    /* upper bounds of the latency buckets */
+    int i;                       /* looping variable for the buckets */
+    uint64_t peak;               /* largest peak RSS recorded so far */
+    Espa_metrics_tool_t *tm = NULL;  /* metrics of the tool */
+
+    if (metrics == NULL || tool < 0 || tool >= metrics->ntools)
+        return;
+    tm = &metrics->tool[tool];
+
+    for (i = 0; i < ESPA_METRICS_NBUCKETS; i++)
+    {
+        if (seconds <= bounds[i])
+            break;
+    }
+    __atomic_fetch_add (&tm->jobs[ok], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add (&tm->buckets[i], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add (&tm->latency_usec, (uint64_t) (seconds * 1.0e6),
+        __ATOMIC_RELAXED);
+    __atomic_fetch_add (&tm->bytes_read, bytes_read, __ATOMIC_RELAXED);
+    __atomic_fetch_add (&tm->bytes_written, bytes_written, __ATOMIC_RELAXED);
+
+    /* Keep the largest peak of the jobs */
+    peak = __atomic_load_n (&tm->peak_rss_kb, __ATOMIC_RELAXED);
+    while (peak_rss_kb > 0 && (uint64_t) peak_rss_kb > peak &&
+        !__atomic_compare_exchange_n (&tm->peak_rss_kb, &peak, peak_rss_kb,
+        false, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        ;
+}
+
+
+/******************************************************************************
+MODULE: espa_metrics_set_queue
+
+PURPOSE: Records the depth of the job queue.
+
+RETURN VALUE:
+Type = N/A
+
+NOTES:
+*****************************************************************************/
+void espa_metrics_set_queue
+(
+    int running,                 /* I: number of jobs running */
+    int queued,                  /* I: number of jobs waiting for a slot */
+    int slots                    /* I: number of jobs run at a time */
+)
+{
+    if (metrics == NULL)
+        return;
+
+    __atomic_store_n (&metrics->running, running, __ATOMIC_RELAXED);
+    __atomic_store_n (&metrics->queued, queued, __ATOMIC_RELAXED);
+    __atomic_store_n (&metrics->slots, slots, __ATOMIC_RELAXED);
+}
+
+
+/******************************************************************************
+MODULE: espa_metrics_write
+
+PURPOSE: Writes the metrics in the Prometheus text exposition format.
+
+RETURN VALUE:
+Type = N/A
+
+NOTES:
+  1. Only the tools which have run a job are written, so the output doesn't
+     grow with the tools which are never used.
+  2. The peak memory of the worker itself is its own resident set size.
+*****************************************************************************/
+void espa_metrics_write
+(
+    FILE *fptr,                  /* I: file to write to */
+    const char *const *tool_names  /* I: name of each tool */
+)
+{
+    static const double bounds[ESPA_METRICS_NBUCKETS] =
+        ESPA_METRICS_BUCKETS;    /* upper bounds of the latency buckets */
+    int t;                       /* looping variable for the tools */
+    int i;                       /* looping variable for the buckets and
+                                    caches */
+    int ok;                      /* looping variable for the outcomes */
+    int hit;                     /* looping variable for misses and hits */
+    uint64_t njobs;              /* jobs of a tool */
+    uint64_t count;              /* cumulative count of a bucket */
+    Espa_metrics_tool_t tm;      /* snapshot of the metrics of a tool */
+    struct rusage usage;         /* resource usage of the worker */
+
+    if (metrics == NULL)
+        return;
+
+    fprintf (fptr, "# HELP espa_worker_jobs_total Jobs run, by tool and "
+        "outcome.\n# TYPE espa_worker_jobs_total counter\n");
+    for (t = 0; t < metrics->ntools; t++)
+    {
+        for (ok = 1; ok >= 0; ok--)
+        {
+            njobs = __atomic_load_n (&metrics->tool[t].jobs[ok],
+                __ATOMIC_RELAXED);
+            if (njobs > 0)
+                fprintf (fptr, "espa_worker_jobs_total{tool=\"%s\","
+                    "status=\"%s\"} %llu\n", tool_names[t],
+                    ok ? "ok" : "failed", (unsigned long long) njobs);
+        }
+    }
+
+    fprintf (fptr, "# HELP espa_worker_job_duration_seconds Wall time of "
+        "the jobs, by tool.\n"
+        "# TYPE espa_worker_job_duration_seconds histogram\n");
+    for (t = 0; t < metrics->ntools; t++)
+    {
+        memcpy (&tm, &metrics->tool[t], sizeof (tm));
+        if (tm.jobs[0] + tm.jobs[1] == 0)
+            continue;
+        count = 0;
+        for (i = 0; i <= ESPA_METRICS_NBUCKETS; i++)
+        {
+            count += tm.buckets[i];
+            if (i < ESPA_METRICS_NBUCKETS)
+                fprintf (fptr, "espa_worker_job_duration_seconds_bucket"
+                    "{tool=\"%s\",le=\"%g\"} %llu\n", tool_names[t],
+                    bounds[i], (unsigned long long) count);
+            else
+                fprintf (fptr, "espa_worker_job_duration_seconds_bucket"
+                    "{tool=\"%s\",le=\"+Inf\"} %llu\n", tool_names[t],
+                    (unsigned long long) count);
+        }
+        fprintf (fptr, "espa_worker_job_duration_seconds_sum{tool=\"%s\"} "
+            "%.6f\n", tool_names[t], tm.latency_usec * 1.0e-6);
+        fprintf (fptr, "espa_worker_job_duration_seconds_count{tool=\"%s\"} "
+            "%llu\n", tool_names[t], (unsigned long long) count);
+    }
+
+    fprintf (fptr, "# HELP espa_worker_read_bytes_total Bytes read by the "
+        "jobs, by tool.\n# TYPE espa_worker_read_bytes_total counter\n");
+    for (t = 0; t < metrics->ntools; t++)
+    {
+        memcpy (&tm, &metrics->tool[t], sizeof (tm));
+        if (tm.jobs[0] + tm.jobs[1] > 0)
+            fprintf (fptr, "espa_worker_read_bytes_total{tool=\"%s\"} "
+                "%llu\n", tool_names[t],
+                (unsigned long long) tm.bytes_read);
+    }
+    fprintf (fptr, "# HELP espa_worker_written_bytes_total Bytes written by "
+        "the jobs, by tool.\n"
+        "# TYPE espa_worker_written_bytes_total counter\n");
+    for (t = 0; t < metrics->ntools; t++)
+    {
+        memcpy (&tm, &metrics->tool[t], sizeof (tm));
+        if (tm.jobs[0] + tm.jobs[1] > 0)
+            fprintf (fptr, "espa_worker_written_bytes_total{tool=\"%s\"} "
+                "%llu\n", tool_names[t],
+                (unsigned long long) tm.bytes_written);
+    }
+
+    fprintf (fptr, "# HELP espa_worker_job_peak_rss_bytes Largest peak "
+        "resident set size of the jobs, by tool.\n"
+        "# TYPE espa_worker_job_peak_rss_bytes gauge\n");
+    for (t = 0; t < metrics->ntools; t++)
+    {
+        memcpy (&tm, &metrics->tool[t], sizeof (tm));
+        if (tm.jobs[0] + tm.jobs[1] > 0)
+            fprintf (fptr, "espa_worker_job_peak_rss_bytes{tool=\"%s\"} "
+                "%llu\n", tool_names[t],
+                (unsigned long long) tm.peak_rss_kb * 1024);
+    }
+
+    for (hit = 1; hit >= 0; hit--)
+    {
+        fprintf (fptr, "# HELP espa_worker_cache_%s_total Cache %s, by tool "
+            "and cache.\n# TYPE espa_worker_cache_%s_total counter\n",
+            hit ? "hits" : "misses", hit ? "hits" : "misses",
+            hit ? "hits" : "misses");
+        for (t = 0; t < metrics->ntools; t++)
+        {
+            memcpy (&tm, &metrics->tool[t], sizeof (tm));
+            if (tm.jobs[0] + tm.jobs[1] == 0)
+                continue;
+            for (i = 0; i < ESPA_METRICS_NCACHES; i++)
+                fprintf (fptr, "espa_worker_cache_%s_total{tool=\"%s\","
+                    "cache=\"%s\"} %llu\n", hit ? "hits" : "misses",
+                    tool_names[t], cache_names[i],
+                    (unsigned long long) tm.cache[i][hit]);
+        }
+    }
+
+    fprintf (fptr, "# HELP espa_worker_jobs_running Jobs running.\n"
+        "# TYPE espa_worker_jobs_running gauge\n"
+        "espa_worker_jobs_running %llu\n",
+        (unsigned long long) __atomic_load_n (&metrics->running,
+        __ATOMIC_RELAXED));
+    fprintf (fptr, "# HELP espa_worker_jobs_queued Jobs waiting for a "
+        "slot.\n# TYPE espa_worker_jobs_queued gauge\n"
+        "espa_worker_jobs_queued %llu\n",
+        (unsigned long long) __atomic_load_n (&metrics->queued,
+        __ATOMIC_RELAXED));
+    fprintf (fptr, "# HELP espa_worker_job_slots Jobs run at a time.\n"
+        "# TYPE espa_worker_job_slots gauge\n"
+        "espa_worker_job_slots %llu\n",
+        (unsigned long long) __atomic_load_n (&metrics->slots,
+        __ATOMIC_RELAXED));
+
+    if (getrusage (RUSAGE_SELF, &usage) == 0)
+        fprintf (fptr, "# HELP espa_worker_peak_rss_bytes Peak resident set "
+            "size of the worker.\n"
+            "# TYPE espa_worker_peak_rss_bytes gauge\n"
+            "espa_worker_peak_rss_bytes %llu\n",
+            (unsigned long long) usage.ru_maxrss * 1024);
+}
@@ -0,0 +1,91 @@
+/*****************************************************************************
+FILE: espa_metrics.h
+
+PURPOSE: Contains defines and prototypes for the job metrics of the formatter
+worker (see espa_formatter_worker): job counts and latencies, bytes read and
+written, and peak memory for each tool, the hits and misses of the caches the
+tools share, and the depth of the job queue, written in the Prometheus text
+exposition format.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The metrics are kept in memory shared by the worker and the processes
+     it forks, so the jobs and tools record into them directly.  The worker
+     sets them up with espa_metrics_share before forking any job.
+  2. Until they are shared (ex. when a tool is run on its own) the metrics
+     are off, and each routine only pays for a single check of a pointer.
+  3. The cache events of a tool are recorded against the tool set by
+     espa_metrics_set_tool in its process; events outside a job are dropped.
+*****************************************************************************/
+
+#ifndef ESPA_METRICS_H
+#define ESPA_METRICS_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Defines */
+#define ESPA_METRICS_NBUCKETS 12   /* number of bounded latency buckets */
+#define ESPA_METRICS_BUCKETS \
+    {0.1, 0.5, 1.0, 2.5, 5.0, 10.0, 30.0, 60.0, 120.0, 300.0, 600.0, \
+     1800.0}                       /* upper bounds of the latency buckets
+                                      (seconds) */
+
+/* Caches whose hits and misses are counted */
+typedef enum {
+    ESPA_METRICS_SCHEMA,           /* compiled ESPA schema */
+    ESPA_METRICS_POLYGON,          /* land mass polygons kept open */
+    ESPA_METRICS_PROJECTION,       /* projection transformations */
+    ESPA_METRICS_METADATA,         /* binary metadata sidecar */
+    ESPA_METRICS_BAND,             /* blocks of the band cache */
+    ESPA_METRICS_NCACHES
+} Espa_metrics_cache_t;
+
+/* Prototypes */
+int espa_metrics_share
+(
+    int ntools                   /* I: number of tools run as jobs */
+);
+
+void espa_metrics_set_tool
+(
+    int tool                     /* I: index of the tool run by this
+                                       process */
+);
+
+void espa_metrics_cache
+(
+    Espa_metrics_cache_t cache,  /* I: cache which was looked in */
+    bool hit                     /* I: was the entry found? */
+);
+
+void espa_metrics_job_done
+(
+    int tool,                    /* I: index of the tool of the job */
+    bool ok,                     /* I: did the tool succeed? */
+    double seconds,              /* I: wall-clock seconds of the job */
+    uint64_t bytes_read,         /* I: bytes read by the tool */
+    uint64_t bytes_written,      /* I: bytes written by the tool */
+    long peak_rss_kb             /* I: peak resident set size of the tool
+                                       (KB) */
+);
+
+void espa_metrics_set_queue
+(
+    int running,                 /* I: number of jobs running */
+    int queued,                  /* I: number of jobs waiting for a slot */
+    int slots                    /* I: number of jobs run at a time */
+);
+
+void espa_metrics_write
+(
+    FILE *fptr,                  /* I: file to write to */
+    const char *const *tool_names  /* I: name of each tool */
+);
+
+#endif
@@ -0,0 +1,200 @@
+/*****************************************************************************
+FILE: espa_mpi.c
+
+PURPOSE: Contains functions for running the heavy operations of one large
+product across the ranks of an MPI job (see espa_mpi.h).
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. All the ranks use MPI_COMM_WORLD.
+*****************************************************************************/
+
+#ifdef HAVE_MPI
+#include <mpi.h>
+#endif
+#include "espa_mpi.h"
+
+static int mpi_rank = 0;         /* rank of the process */
+static int mpi_size = 1;         /* number of ranks */
+static bool mpi_started = false; /* was MPI initialized by espa_mpi_init? */
+
+/******************************************************************************
+MODULE:  espa_mpi_init
+
+PURPOSE:  Initializes MPI and looks up the rank of the process and the
+number of ranks.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error initializing MPI
+SUCCESS         MPI is initialized, or isn't compiled in
+
+NOTES:
+  1. Called once, at the start of main, before the arguments are read.
+******************************************************************************/
+int espa_mpi_init
+(
+    int *argc,           /* I/O: number of command-line arguments */
+    char ***argv         /* I/O: command-line arguments; the arguments of
+                               MPI are removed */
+)
+{
+#ifdef HAVE_MPI
+    char FUNC_NAME[] = "espa_mpi_init";  /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    int provided;             /* thread support provided by MPI */
+
+    if (MPI_Init_thread (argc, argv, MPI_THREAD_FUNNELED, &provided)
+        != MPI_SUCCESS)
+    {
+        sprintf (errmsg, "Initializing MPI");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    mpi_started = true;
+    MPI_Comm_rank (MPI_COMM_WORLD, &mpi_rank);
+    MPI_Comm_size (MPI_COMM_WORLD, &mpi_size);
+#endif
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  espa_mpi_finalize
+
+PURPOSE:  Shuts down MPI, if espa_mpi_init started it.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. Every rank calls it before exiting, whatever its status.
+******************************************************************************/
+void espa_mpi_finalize (void)
+{
+#ifdef HAVE_MPI
+    if (mpi_started)
+        MPI_Finalize ();
+#endif
+    mpi_started = false;
+    mpi_rank = 0;
+    mpi_size = 1;
+}
+
+
+/******************************************************************************
+MODULE:  espa_mpi_rank
+
+PURPOSE:  Returns the rank of the process.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+n               0-based rank of the process; 0 without MPI
+
+NOTES:
+******************************************************************************/
+int espa_mpi_rank (void)
+{
+    return (mpi_rank);
+}
+
+
+/******************************************************************************
+MODULE:  espa_mpi_size
+
+PURPOSE:  Returns the number of ranks.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+n               Number of ranks; 1 without MPI
+
+NOTES:
+******************************************************************************/
+int espa_mpi_size (void)
+{
+    return (mpi_size);
+}
+
+
+/******************************************************************************
+MODULE:  espa_mpi_split
+
+PURPOSE:  Splits the tiles (or stripes) of an output grid into a contiguous
+range for each rank, and returns the range of the calling rank.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. The ranges differ in size by at most one tile, with the larger ranges
+     on the lower ranks.
+******************************************************************************/
+void espa_mpi_split
+(
+    int n,               /* I: number of tiles (or stripes) to be split */
+    int *first,          /* O: first tile of the calling rank */
+    int *count           /* O: number of tiles of the calling rank; 0 if it
+                               has none */
+)
+{
+    int base;            /* number of tiles of every rank */
+    int extra;           /* number of ranks with one more tile */
+
+    if (n < 0)
+        n = 0;
+    base = n / mpi_size;
+    extra = n % mpi_size;
+
+    *count = base + (mpi_rank < extra ? 1 : 0);
+    *first = mpi_rank * base + (mpi_rank < extra ? mpi_rank : extra);
+}
+
+
+/******************************************************************************
+MODULE:  espa_mpi_agree
+
+PURPOSE:  Combines the status of a step over all the ranks.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           The step failed on at least one rank
+SUCCESS         The step succeeded on every rank
+
+NOTES:
+  1. A collective call: every rank calls it, in the same order, so it also
+     keeps the ranks in step.
+******************************************************************************/
+int espa_mpi_agree
+(
+    int status           /* I: status of the step on the calling rank */
+)
+{
+#ifdef HAVE_MPI
+    int local;           /* status of the calling rank */
+    int global;          /* status of all the ranks */
+
+    if (mpi_size > 1)
+    {
+        local = (status == SUCCESS) ? SUCCESS : ERROR;
+        if (MPI_Allreduce (&local, &global, 1, MPI_INT, MPI_MIN,
+            MPI_COMM_WORLD) != MPI_SUCCESS)
+            return (ERROR);
+        return (global);
+    }
+#endif
+
+    return (status == SUCCESS ? SUCCESS : ERROR);
+}
@@ -0,0 +1,69 @@
+/*****************************************************************************
+FILE: espa_mpi.h
+
+PURPOSE: Contains defines and prototypes for running the heavy operations of
+one large product (ex. a continental mosaic) across the ranks of an MPI job,
+each rank working on its own part of the output grid.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. MPI is only compiled in when the libraries are built with HAVE_MPI (see
+     ENABLE_MPI in make.config).  Otherwise, and when the tool isn't started
+     by mpirun, there is a single rank and every function here is trivial,
+     so the callers run the same code either way.
+  2. The output grid is split into contiguous ranges of tiles (or stripes),
+     one range per rank, with espa_mpi_split.  Each rank writes its range
+     of the output file in place, so the ranks need a shared file system.
+  3. The ranks agree on the status of each step with espa_mpi_agree, so an
+     error on any rank fails the step on every rank and none of them is
+     left waiting in a later collective call.
+  4. The rank ESPA_MPI_ROOT validates the input metadata, and does the
+     serial work of the product: the files written whole (ex. the XML and
+     ENVI headers) and the checksums and statistics of the bands.
+  5. Each rank runs its own task pool, so MPI is initialized with the
+     threads funneled through the thread which called espa_mpi_init.
+*****************************************************************************/
+
+#ifndef ESPA_MPI_H
+#define ESPA_MPI_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include "error_handler.h"
+
+/* Defines */
+#define ESPA_MPI_ROOT 0          /* rank doing the serial work */
+
+/* Prototypes */
+int espa_mpi_init
+(
+    int *argc,           /* I/O: number of command-line arguments */
+    char ***argv         /* I/O: command-line arguments; the arguments of
+                               MPI are removed */
+);
+
+void espa_mpi_finalize (void);
+
+int espa_mpi_rank (void);
+
+int espa_mpi_size (void);
+
+void espa_mpi_split
+(
+    int n,               /* I: number of tiles (or stripes) to be split */
+    int *first,          /* O: first tile of the calling rank */
+    int *count           /* O: number of tiles of the calling rank; 0 if it
+                               has none */
+);
+
+int espa_mpi_agree
+(
+    int status           /* I: status of the step on the calling rank */
+);
+
+#endif
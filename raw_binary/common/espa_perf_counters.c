@@ -0,0 +1,278 @@
+/*****************************************************************************
+FILE: espa_perf_counters.c
+
+PURPOSE: Contains functions for reading the hardware performance counters
+through perf_event_open and writing them, with the metrics derived from
+them, as JSON.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. Each counter is opened on its own rather than as a group, since a
+     group can't be read at once when it is inherited, and so a counter the
+     processor lacks doesn't keep the others from being counted.
+  2. The kernel is counted along with the user code when the system allows
+     it, so the copies of the reads and writes are included; otherwise only
+     the user code is counted.
+*****************************************************************************/
+
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include "espa_common.h"
+#include "espa_perf_counters.h"
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+/* Names of the counters in the JSON */
+static const char *perf_names[ESPA_PERF_NCOUNTERS] =
+    {"cycles", "instructions", "llc_misses"};
+
+/******************************************************************************
+MODULE: espa_perf_open
+
+PURPOSE: Opens the hardware counters of the calling thread, counting from
+when they are opened.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        None of the counters could be opened
+SUCCESS      At least one of the counters was opened
+
+NOTES:
+  1. No error message is written, since the counters are optional; the
+     caller decides whether to warn.
+*****************************************************************************/
+int espa_perf_open
+(
+    Espa_perf_counters_t *perf,  /* O: counters of the calling thread */
+    bool inherit                 /* I: also count the threads and processes
+                                       it creates? */
+)
+{
+    int i;                       /* looping variable for the counters */
+    int status = ERROR;          /* return status */
+#ifdef __linux__
+    static const unsigned long long configs[ESPA_PERF_NCOUNTERS] =
+        {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+         PERF_COUNT_HW_CACHE_MISSES};   /* hardware event of each counter */
+    struct perf_event_attr attr; /* attributes of the counter */
+#endif
+
+    for (i = 0; i < ESPA_PERF_NCOUNTERS; i++)
+        perf->fd[i] = -1;
+
+#ifdef __linux__
+    for (i = 0; i < ESPA_PERF_NCOUNTERS; i++)
+    {
+        memset (&attr, 0, sizeof (attr));
+        attr.size = sizeof (attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = configs[i];
+        attr.inherit = inherit;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED |
+            PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+        perf->fd[i] = syscall (SYS_perf_event_open, &attr, 0, -1, -1, 0);
+        if (perf->fd[i] < 0 && (errno == EACCES || errno == EPERM))
+        {
+            /* Only the user code may be counted */
+            attr.exclude_kernel = 1;
+            perf->fd[i] = syscall (SYS_perf_event_open, &attr, 0, -1, -1, 0);
+        }
+        if (perf->fd[i] < 0)
+            perf->fd[i] = -1;
+        else
+            status = SUCCESS;
+    }
+#endif
+
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE: espa_perf_read
+
+PURPOSE: Reads the current values of the counters.
+
+RETURN VALUE:
+Type = N/A
+
+NOTES:
+  1. A counter which isn't counted, or has never been on the hardware, is
+     read as negative.
+*****************************************************************************/
+void espa_perf_read
+(
+    Espa_perf_counters_t *perf,  /* I: counters */
+    Espa_perf_values_t *values   /* O: current values of the counters */
+)
+{
+    int i;                       /* looping variable for the counters */
+    unsigned long long buf[3];   /* value, time enabled, and time running */
+
+    for (i = 0; i < ESPA_PERF_NCOUNTERS; i++)
+    {
+        values->count[i] = -1.0;
+        if (perf->fd[i] < 0 ||
+            read (perf->fd[i], buf, sizeof (buf)) != sizeof (buf) ||
+            buf[2] == 0)
+            continue;
+
+        values->count[i] = (double) buf[0];
+        if (buf[2] < buf[1])
+            values->count[i] *= (double) buf[1] / buf[2];
+    }
+}
+
+
+/******************************************************************************
+MODULE: espa_perf_delta
+
+PURPOSE: Determines the counts between two reads of the counters.
+
+RETURN VALUE:
+Type = N/A
+
+NOTES:
+*****************************************************************************/
+void espa_perf_delta
+(
+    const Espa_perf_values_t *start,  /* I: values at the start */
+    const Espa_perf_values_t *end,    /* I: values at the end */
+    Espa_perf_values_t *delta         /* O: counts between the two */
+)
+{
+    int i;                       /* looping variable for the counters */
+
+    for (i = 0; i < ESPA_PERF_NCOUNTERS; i++)
+    {
+        delta->count[i] = -1.0;
+        if (start->count[i] >= 0.0 && end->count[i] >= start->count[i])
+            delta->count[i] = end->count[i] - start->count[i];
+    }
+}
+
+
+/******************************************************************************
+MODULE: espa_perf_mem_bytes
+
+PURPOSE: Estimates the bytes read from memory from the last level cache
+misses.
+
+RETURN VALUE:
+Type = double
+Value        Description
+-----        -----------
+< 0          The cache misses aren't counted
+>= 0         Bytes read from memory
+
+NOTES:
+*****************************************************************************/
+double espa_perf_mem_bytes
+(
+    const Espa_perf_values_t *values  /* I: counts */
+)
+{
+    static long line_size = 0;   /* cache line size (bytes) */
+
+    if (values->count[ESPA_PERF_LLC_MISSES] < 0.0)
+        return (-1.0);
+
+    if (line_size <= 0)
+    {
+#ifdef _SC_LEVEL3_CACHE_LINESIZE
+        line_size = sysconf (_SC_LEVEL3_CACHE_LINESIZE);
+#endif
+        if (line_size <= 0)
+            line_size = ESPA_PERF_LINE_SIZE;
+    }
+    return (values->count[ESPA_PERF_LLC_MISSES] * line_size);
+}
+
+
+/******************************************************************************
+MODULE: espa_perf_write_json
+
+PURPOSE: Writes the counts, the instructions per cycle, and the bytes and
+bandwidth from memory as members of a JSON object, each preceded by a comma.
+
+RETURN VALUE:
+Type = N/A
+
+NOTES:
+  1. The members which can't be determined are written as null, so every
+     object has the same members.
+*****************************************************************************/
+void espa_perf_write_json
+(
+    FILE *fptr,                       /* I: file to write to */
+    const Espa_perf_values_t *values, /* I: counts */
+    double seconds                    /* I: wall-clock seconds of the counts,
+                                            for the bandwidth */
+)
+{
+    int i;                       /* looping variable for the counters */
+    double cycles = values->count[ESPA_PERF_CYCLES];  /* cycles */
+    double instructions = values->count[ESPA_PERF_INSTRUCTIONS];
+                                 /* instructions */
+    double mem_bytes = espa_perf_mem_bytes (values);  /* bytes from memory */
+
+    for (i = 0; i < ESPA_PERF_NCOUNTERS; i++)
+    {
+        if (values->count[i] >= 0.0)
+            fprintf (fptr, ", \"%s\": %.0f", perf_names[i], values->count[i]);
+        else
+            fprintf (fptr, ", \"%s\": null", perf_names[i]);
+    }
+
+    if (cycles > 0.0 && instructions >= 0.0)
+        fprintf (fptr, ", \"ipc\": %.3f", instructions / cycles);
+    else
+        fprintf (fptr, ", \"ipc\": null");
+
+    if (mem_bytes >= 0.0)
+        fprintf (fptr, ", \"mem_mb\": %.3f", mem_bytes / (1024.0 * 1024.0));
+    else
+        fprintf (fptr, ", \"mem_mb\": null");
+    if (mem_bytes >= 0.0 && seconds > 0.0)
+        fprintf (fptr, ", \"mem_gb_per_second\": %.3f",
+            mem_bytes / seconds * 1.0e-9);
+    else
+        fprintf (fptr, ", \"mem_gb_per_second\": null");
+}
+
+
+/******************************************************************************
+MODULE: espa_perf_close
+
+PURPOSE: Closes the counters.
+
+RETURN VALUE:
+Type = N/A
+
+NOTES:
+*****************************************************************************/
+void espa_perf_close
+(
+    Espa_perf_counters_t *perf   /* I/O: counters to be closed */
+)
+{
+    int i;                       /* looping variable for the counters */
+
+    for (i = 0; i < ESPA_PERF_NCOUNTERS; i++)
+    {
+        if (perf->fd[i] >= 0)
+            close (perf->fd[i]);
+        perf->fd[i] = -1;
+    }
+}
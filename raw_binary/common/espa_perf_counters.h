@@ -0,0 +1,105 @@
+/*****************************************************************************
+FILE: espa_perf_counters.h
+
+PURPOSE: Contains defines and prototypes for the hardware performance
+counters (cycles, instructions, and last level cache misses) read through
+perf_event_open, from which the instructions per cycle and the bandwidth
+from memory are derived, so it can be told whether a kernel is bound by the
+processor or by memory.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The counters are only available on Linux, and only where the kernel
+     allows them (see /proc/sys/kernel/perf_event_paranoid).  Where a
+     counter can't be opened it is reported as not counted, and the callers
+     carry on without it.
+  2. The counters count the calling thread.  Counters opened to be
+     inherited also count the threads and processes it creates afterwards;
+     the counts of the processes are added once they exit.
+  3. The counts are scaled for any time the kernel multiplexed the counter
+     off the hardware.
+  4. The bytes from memory are estimated as the last level cache misses
+     times the cache line size, so they leave out prefetched lines and
+     write-backs.
+  5. Setting ESPA_PERF_ENV along with the timing trace (see espa_trace.h)
+     adds the counters of each span to the trace.
+*****************************************************************************/
+
+#ifndef ESPA_PERF_COUNTERS_H
+#define ESPA_PERF_COUNTERS_H
+
+#include <stdio.h>
+#include <stdbool.h>
+
+/* Defines */
+#define ESPA_PERF_ENV "ESPA_PERF_COUNTERS"  /* adds the counters of each span
+                                               to the timing trace */
+#define ESPA_PERF_LINE_SIZE 64   /* cache line size when the system doesn't
+                                    report it (bytes) */
+
+/* Hardware counters */
+typedef enum {
+    ESPA_PERF_CYCLES,            /* processor cycles */
+    ESPA_PERF_INSTRUCTIONS,      /* instructions retired */
+    ESPA_PERF_LLC_MISSES,        /* last level cache misses */
+    ESPA_PERF_NCOUNTERS
+} Espa_perf_counter_t;
+
+/* Open counters */
+typedef struct
+{
+    int fd[ESPA_PERF_NCOUNTERS]; /* file descriptor of each counter; -1 if
+                                    it isn't counted */
+} Espa_perf_counters_t;
+
+/* Values of the counters */
+typedef struct
+{
+    double count[ESPA_PERF_NCOUNTERS];  /* count of each counter; negative if
+                                           it isn't counted */
+} Espa_perf_values_t;
+
+/* Prototypes */
+int espa_perf_open
+(
+    Espa_perf_counters_t *perf,  /* O: counters of the calling thread */
+    bool inherit                 /* I: also count the threads and processes
+                                       it creates? */
+);
+
+void espa_perf_read
+(
+    Espa_perf_counters_t *perf,  /* I: counters */
+    Espa_perf_values_t *values   /* O: current values of the counters */
+);
+
+void espa_perf_delta
+(
+    const Espa_perf_values_t *start,  /* I: values at the start */
+    const Espa_perf_values_t *end,    /* I: values at the end */
+    Espa_perf_values_t *delta         /* O: counts between the two */
+);
+
+double espa_perf_mem_bytes
+(
+    const Espa_perf_values_t *values  /* I: counts */
+);
+
+void espa_perf_write_json
+(
+    FILE *fptr,                       /* I: file to write to */
+    const Espa_perf_values_t *values, /* I: counts */
+    double seconds                    /* I: wall-clock seconds of the counts,
+                                            for the bandwidth */
+);
+
+void espa_perf_close
+(
+    Espa_perf_counters_t *perf   /* I/O: counters to be closed */
+);
+
+#endif
@@ -0,0 +1,1285 @@
+/*****************************************************************************
+FILE: espa_task_pool.c
+
+PURPOSE: Contains functions for the shared task pool (see espa_task_pool.h).
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. A parallel loop is run as a task for each worker besides the submitting
+     thread.  The workers claim the iterations one at a time from a shared
+     counter, so a worker which joins the loop late (or never) only means
+     the others run more of the iterations.
+  2. Each queue is guarded by its own mutex.  The pool mutex only guards the
+     counters of the groups and the epoch, which is raised whenever a task is
+     queued or finished so the idle threads know to look again.
+  3. The NUMA nodes and their processors are read from sysfs the first time
+     the placement is used, numbering the nodes from 0 until one is
+     missing.  With fewer than two nodes there is nothing to place, and the
+     pool runs as without the placement.
+*****************************************************************************/
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE     /* for pthread_setaffinity_np */
+#endif
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#ifdef _OPENMP
+#include <sched.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+#endif
+#include "espa_task_pool.h"
+
+/* Defines */
+#define POOL_QUEUE_GROW 16        /* number of tasks added to a queue each
+                                     time it is grown */
+
+/* Parallel loop */
+typedef struct
+{
+    int n;                        /* number of iterations */
+    Espa_loop_func_t func;        /* function run for each iteration */
+    Espa_loop_report_t report;    /* function run for each finished
+                                     iteration, in order; NULL if none */
+    void *arg;                    /* argument of func and report */
+    int next;                     /* next iteration to be claimed */
+    int nranges;                  /* number of ranges of the iterations, one
+                                     for each NUMA node; 0 if they aren't
+                                     split */
+    int range_next[ESPA_TASK_POOL_MAX_NODES];  /* next iteration to be
+                                     claimed in each range */
+    int range_end[ESPA_TASK_POOL_MAX_NODES];  /* one past the last
+                                     iteration of each range */
+    int nworkers;                 /* number of workers which joined */
+    int stop;                     /* set once an iteration or report failed,
+                                     so no more iterations are claimed */
+    int status;                   /* status of the loop */
+    char *done;                   /* state of each iteration for the reports:
+                                     0 running, 1 succeeded, 2 failed; NULL
+                                     if there is no report */
+    int next_report;              /* next iteration to be reported */
+    bool reporting;               /* are the iterations still reported? */
+#ifdef _OPENMP
+    pthread_mutex_t mutex;        /* guards the reports */
+#endif
+} Pool_loop_t;
+
+static int pool_cap = 0;          /* cap on the number of threads; 0 until
+                                     it is read */
+static int pool_numa = -1;        /* NUMA placement: -1 until it is read, 0
+                                     off, 1 on */
+
+#ifdef _OPENMP
+/* Task queued in the pool */
+typedef struct
+{
+    Espa_task_func_t func;        /* task to be run */
+    void *arg;                    /* argument of the task */
+    Espa_task_group_t *group;     /* group of the task */
+} Pool_task_t;
+
+/* Queue of the tasks submitted by a thread */
+typedef struct
+{
+    pthread_mutex_t mutex;        /* guards the queue */
+    Pool_task_t *tasks;           /* tasks; the queued ones are from head to
+                                     tail - 1 */
+    int head;                     /* first queued task */
+    int tail;                     /* one past the last queued task */
+    int size;                     /* number of tasks allocated */
+} Pool_queue_t;
+
+static pthread_once_t pool_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t pool_mutex = PTHREAD_MUTEX_INITIALIZER;  /* guards
+                                     the groups and the epoch */
+static pthread_cond_t pool_cond = PTHREAD_COND_INITIALIZER;  /* signaled
+                                     when the epoch is raised */
+static unsigned long pool_epoch = 0;  /* raised when a task is queued or
+                                     finished */
+static int pool_nstarted = 0;     /* number of threads started */
+static Pool_queue_t pool_queues[ESPA_TASK_POOL_MAX_THREADS];  /* queue 0 is
+                                     for the threads outside the pool, and
+                                     queue i for thread i of the pool */
+static __thread int pool_self = 0;  /* queue of the calling thread */
+static pthread_once_t numa_once = PTHREAD_ONCE_INIT;
+static int pool_nnodes = 0;       /* number of NUMA nodes; 0 if there are
+                                     fewer than two */
+static cpu_set_t pool_node_cpus[ESPA_TASK_POOL_MAX_NODES];  /* processors
+                                     of each NUMA node */
+static __thread int pool_node = -1;  /* NUMA node the calling thread is
+                                     bound to; -1 if not bound */
+
+
+/******************************************************************************
+MODULE:  read_pool_cap
+
+PURPOSE:  Reads the cap on the number of threads from the environment.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+n               Cap on the number of threads
+
+NOTES:
+  1. Without ESPA_THREADS_ENV, the cap is the number of online processors.
+******************************************************************************/
+static int read_pool_cap (void)
+{
+    char FUNC_NAME[] = "read_pool_cap";  /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    char *env = NULL;         /* value of the environment variable */
+    char *end = NULL;         /* end of the number */
+    long nthreads = -1;       /* cap from the environment */
+
+    env = getenv (ESPA_THREADS_ENV);
+    if (env != NULL)
+    {
+        nthreads = strtol (env, &end, 10);
+        if (end == env || *end != '\0' || nthreads < 1)
+        {
+            sprintf (errmsg, "Invalid %s value %.100s; using the number of "
+                "processors", ESPA_THREADS_ENV, env);
+            error_handler (false, FUNC_NAME, errmsg);
+            nthreads = -1;
+        }
+    }
+    if (nthreads < 1)
+        nthreads = sysconf (_SC_NPROCESSORS_ONLN);
+    if (nthreads < 1)
+        nthreads = 1;
+    if (nthreads > ESPA_TASK_POOL_MAX_THREADS)
+        nthreads = ESPA_TASK_POOL_MAX_THREADS;
+
+    return ((int) nthreads);
+}
+
+
+/******************************************************************************
+MODULE:  read_pool_numa
+
+PURPOSE:  Reads whether the NUMA placement is on from the environment.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+0               The placement is off
+1               The placement is on
+
+NOTES:
+******************************************************************************/
+static int read_pool_numa (void)
+{
+    char *env = NULL;         /* value of the environment variable */
+
+    env = getenv (ESPA_NUMA_ENV);
+    if (env != NULL && (!strcasecmp (env, "yes") || !strcmp (env, "1")))
+        return (1);
+
+    return (0);
+}
+
+
+/******************************************************************************
+MODULE:  read_numa_nodes
+
+PURPOSE:  Reads the processors of each NUMA node from sysfs, once for the
+process.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. The processors of a node are listed as ranges (ex. 0-15,32-47).
+******************************************************************************/
+static void read_numa_nodes (void)
+{
+    char path[STR_SIZE];      /* sysfs file of the processors of a node */
+    char list[STR_SIZE];      /* list of the processors of a node */
+    char *cur = NULL;         /* current range of the list */
+    char *end = NULL;         /* end of a number of the range */
+    long first;               /* first processor of the range */
+    long last;                /* last processor of the range */
+    long cpu;                 /* looping variable for the processors */
+    int nnodes;               /* number of nodes read */
+    FILE *fp = NULL;          /* sysfs file */
+
+    for (nnodes = 0; nnodes < ESPA_TASK_POOL_MAX_NODES; nnodes++)
+    {
+        snprintf (path, sizeof (path),
+            "/sys/devices/system/node/node%d/cpulist", nnodes);
+        fp = fopen (path, "r");
+        if (fp == NULL)
+            break;
+        if (fgets (list, sizeof (list), fp) == NULL)
+            list[0] = '\0';
+        fclose (fp);
+
+        CPU_ZERO (&pool_node_cpus[nnodes]);
+        cur = list;
+        while (*cur >= '0' && *cur <= '9')
+        {
+            first = strtol (cur, &end, 10);
+            last = first;
+            if (*end == '-')
+                last = strtol (end + 1, &end, 10);
+            for (cpu = first; cpu <= last && cpu < CPU_SETSIZE; cpu++)
+                CPU_SET (cpu, &pool_node_cpus[nnodes]);
+            cur = (*end == ',') ? end + 1 : end;
+        }
+
+        /* A node without processors (ex. memory only) can't run threads */
+        if (CPU_COUNT (&pool_node_cpus[nnodes]) == 0)
+            break;
+    }
+
+    if (nnodes < 2)
+        nnodes = 0;
+    __atomic_store_n (&pool_nnodes, nnodes, __ATOMIC_RELEASE);
+}
+
+
+/******************************************************************************
+MODULE:  numa_nodes
+
+PURPOSE:  Returns the number of NUMA nodes the pool places its threads and
+loops on.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+0               The placement is off, or there is a single node
+n               Number of NUMA nodes
+
+NOTES:
+******************************************************************************/
+static int numa_nodes (void)
+{
+    if (__atomic_load_n (&pool_numa, __ATOMIC_ACQUIRE) != 1)
+        return (0);
+
+    pthread_once (&numa_once, read_numa_nodes);
+    return (__atomic_load_n (&pool_nnodes, __ATOMIC_ACQUIRE));
+}
+
+
+/******************************************************************************
+MODULE:  bind_thread
+
+PURPOSE:  Binds a thread of the pool to the processors of its NUMA node, the
+first time it runs with the placement on.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. Thread i of the pool is on node i modulo the number of nodes, so the
+     threads are spread evenly over the nodes.  If the binding fails, the
+     thread still counts as on its node for the stealing and the loops.
+******************************************************************************/
+static void bind_thread (void)
+{
+    int nnodes;               /* number of NUMA nodes */
+
+    if (pool_node >= 0)
+        return;
+    nnodes = numa_nodes ();
+    if (nnodes == 0)
+        return;
+
+    pool_node = pool_self % nnodes;
+    pthread_setaffinity_np (pthread_self (), sizeof (cpu_set_t),
+        &pool_node_cpus[pool_node]);
+}
+
+
+/******************************************************************************
+MODULE:  thread_node
+
+PURPOSE:  Returns the NUMA node of the calling thread.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+-1              The placement is off
+n               NUMA node of the calling thread
+
+NOTES:
+  1. A thread outside the pool isn't bound, so it is on the node of the
+     processor it is running on at the time.
+******************************************************************************/
+static int thread_node (void)
+{
+    unsigned cpu;             /* processor the thread is running on */
+    unsigned node = 0;        /* NUMA node of the processor */
+    int nnodes;               /* number of NUMA nodes */
+
+    if (pool_node >= 0)
+        return (pool_node);
+    nnodes = numa_nodes ();
+    if (nnodes == 0)
+        return (-1);
+
+#ifdef SYS_getcpu
+    if (syscall (SYS_getcpu, &cpu, &node, NULL) != 0)
+        node = 0;
+#endif
+    if (node >= (unsigned) nnodes)
+        node = 0;
+
+    return ((int) node);
+}
+
+
+/******************************************************************************
+MODULE:  reset_pool_after_fork
+
+PURPOSE:  Resets the pool in a child process, which has none of the threads
+of its parent.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. Registered with pthread_atfork.  The threads are started again when the
+     pool is first used in the child.
+******************************************************************************/
+static void reset_pool_after_fork (void)
+{
+    int i;                    /* looping variable for the queues */
+
+    pthread_mutex_init (&pool_mutex, NULL);
+    pthread_cond_init (&pool_cond, NULL);
+    pool_nstarted = 0;
+    for (i = 0; i < ESPA_TASK_POOL_MAX_THREADS; i++)
+    {
+        pthread_mutex_init (&pool_queues[i].mutex, NULL);
+        pool_queues[i].head = 0;
+        pool_queues[i].tail = 0;
+    }
+}
+
+
+/******************************************************************************
+MODULE:  init_pool
+
+PURPOSE:  Initializes the queues and reads the cap on the number of threads,
+once for the process.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+static void init_pool (void)
+{
+    int i;                    /* looping variable for the queues */
+
+    for (i = 0; i < ESPA_TASK_POOL_MAX_THREADS; i++)
+        pthread_mutex_init (&pool_queues[i].mutex, NULL);
+    if (__atomic_load_n (&pool_cap, __ATOMIC_ACQUIRE) == 0)
+        __atomic_store_n (&pool_cap, read_pool_cap (), __ATOMIC_RELEASE);
+    if (__atomic_load_n (&pool_numa, __ATOMIC_ACQUIRE) < 0)
+        __atomic_store_n (&pool_numa, read_pool_numa (), __ATOMIC_RELEASE);
+    pthread_atfork (NULL, NULL, reset_pool_after_fork);
+}
+
+
+/******************************************************************************
+MODULE:  push_task
+
+PURPOSE:  Queues a task on the back of the queue of the calling thread.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error growing the queue
+SUCCESS         The task is queued
+
+NOTES:
+******************************************************************************/
+static int push_task
+(
+    const Pool_task_t *task   /* I: task to be queued */
+)
+{
+    Pool_queue_t *queue = &pool_queues[pool_self];  /* queue of the thread */
+    Pool_task_t *tasks = NULL;   /* grown tasks */
+
+    pthread_mutex_lock (&queue->mutex);
+    if (queue->tail == queue->size)
+    {
+        /* Move the queued tasks to the front before growing the queue */
+        if (queue->head > 0)
+        {
+            memmove (queue->tasks, queue->tasks + queue->head,
+                (queue->tail - queue->head) * sizeof (Pool_task_t));
+            queue->tail -= queue->head;
+            queue->head = 0;
+        }
+        if (queue->tail == queue->size)
+        {
+            tasks = realloc (queue->tasks, (queue->size + POOL_QUEUE_GROW) *
+                sizeof (Pool_task_t));
+            if (tasks == NULL)
+            {
+                pthread_mutex_unlock (&queue->mutex);
+                return (ERROR);
+            }
+            queue->tasks = tasks;
+            queue->size += POOL_QUEUE_GROW;
+        }
+    }
+    queue->tasks[queue->tail++] = *task;
+    pthread_mutex_unlock (&queue->mutex);
+
+    pthread_mutex_lock (&pool_mutex);
+    pool_epoch++;
+    pthread_cond_broadcast (&pool_cond);
+    pthread_mutex_unlock (&pool_mutex);
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  pop_task
+
+PURPOSE:  Takes a task from the back (the owner) or the front (a thief) of a
+queue.
+
+RETURN VALUE:
+Type = bool
+Value           Description
+-----           -----------
+false           The queue is empty
+true            task holds the task taken from the queue
+
+NOTES:
+******************************************************************************/
+static bool pop_task
+(
+    Pool_queue_t *queue,      /* I/O: queue to take the task from */
+    bool back,                /* I: take the last task rather than the
+                                    first? */
+    Pool_task_t *task         /* O: task taken from the queue */
+)
+{
+    bool found = false;       /* was a task taken? */
+
+    pthread_mutex_lock (&queue->mutex);
+    if (queue->head < queue->tail)
+    {
+        if (back)
+            *task = queue->tasks[--queue->tail];
+        else
+            *task = queue->tasks[queue->head++];
+        if (queue->head == queue->tail)
+        {
+            queue->head = 0;
+            queue->tail = 0;
+        }
+        found = true;
+    }
+    pthread_mutex_unlock (&queue->mutex);
+
+    return (found);
+}
+
+
+/******************************************************************************
+MODULE:  take_task
+
+PURPOSE:  Takes a task for the calling thread to run, from its own queue
+first and otherwise stolen from the other queues.
+
+RETURN VALUE:
+Type = bool
+Value           Description
+-----           -----------
+false           Every queue is empty
+true            task holds the task to be run
+
+NOTES:
+  1. With the NUMA placement on, the queues of the threads on the node of
+     the calling thread are stolen from first, so the tasks (and the memory
+     they touch) stay on the node they were submitted on while its threads
+     keep up.
+******************************************************************************/
+static bool take_task
+(
+    Pool_task_t *task         /* O: task to be run */
+)
+{
+    int nqueues;              /* number of queues in use */
+    int nnodes;               /* number of NUMA nodes; 0 if not placed */
+    int node;                 /* NUMA node of the calling thread */
+    int queue;                /* queue to steal from */
+    int pass;                 /* 0 for the queues on the node of the
+                                 thread, 1 for the others */
+    bool on_node;             /* is the queue on the node of the thread? */
+    int i;                    /* looping variable for the queues */
+
+    if (pop_task (&pool_queues[pool_self], true, task))
+        return (true);
+
+    nqueues = __atomic_load_n (&pool_nstarted, __ATOMIC_ACQUIRE) + 1;
+    nnodes = numa_nodes ();
+    node = thread_node ();
+    for (pass = (nnodes > 0) ? 0 : 1; pass < 2; pass++)
+    {
+        for (i = 1; i < nqueues; i++)
+        {
+            /* Queue 0 (the threads outside the pool) is on no node */
+            queue = (pool_self + i) % nqueues;
+            on_node = nnodes > 0 && queue > 0 && queue % nnodes == node;
+            if (nnodes > 0 && on_node != (pass == 0))
+                continue;
+            if (pop_task (&pool_queues[queue], false, task))
+                return (true);
+        }
+    }
+
+    return (false);
+}
+
+
+/******************************************************************************
+MODULE:  run_task
+
+PURPOSE:  Runs a task and marks it finished in its group.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+static void run_task
+(
+    const Pool_task_t *task   /* I: task to be run */
+)
+{
+    int status;               /* status of the task */
+
+    status = task->func (task->arg);
+
+    pthread_mutex_lock (&pool_mutex);
+    if (status != SUCCESS)
+        task->group->status = ERROR;
+    task->group->pending--;
+    pool_epoch++;
+    pthread_cond_broadcast (&pool_cond);
+    pthread_mutex_unlock (&pool_mutex);
+}
+
+
+/******************************************************************************
+MODULE:  pool_thread
+
+PURPOSE:  Runs the tasks of the pool, sleeping while there are none.
+
+RETURN VALUE:
+Type = void *
+Value           Description
+-----           -----------
+NULL            Never returns
+
+NOTES:
+  1. The threads past the cap (after the cap is lowered) stay idle.
+******************************************************************************/
+static void *pool_thread
+(
+    void *arg                 /* I: index of the thread in the pool */
+)
+{
+    unsigned long epoch;      /* epoch before looking for a task */
+    Pool_task_t task;         /* task to be run */
+
+    pool_self = (int) (long) arg;
+    while (1)
+    {
+        bind_thread ();
+
+        pthread_mutex_lock (&pool_mutex);
+        epoch = pool_epoch;
+        pthread_mutex_unlock (&pool_mutex);
+
+        if (pool_self < __atomic_load_n (&pool_cap, __ATOMIC_ACQUIRE) &&
+            take_task (&task))
+        {
+            run_task (&task);
+            continue;
+        }
+
+        pthread_mutex_lock (&pool_mutex);
+        while (pool_epoch == epoch)
+            pthread_cond_wait (&pool_cond, &pool_mutex);
+        pthread_mutex_unlock (&pool_mutex);
+    }
+
+    return (NULL);
+}
+
+
+/******************************************************************************
+MODULE:  start_threads
+
+PURPOSE:  Starts the threads of the pool, up to one less than the cap.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. If a thread can't be started, the pool runs with the threads it has.
+******************************************************************************/
+static void start_threads (void)
+{
+    int nthreads;             /* number of threads to be started */
+    pthread_t thread;         /* started thread */
+    pthread_attr_t attr;      /* attributes of the threads */
+
+    nthreads = __atomic_load_n (&pool_cap, __ATOMIC_ACQUIRE) - 1;
+    if (__atomic_load_n (&pool_nstarted, __ATOMIC_ACQUIRE) >= nthreads)
+        return;
+
+    pthread_attr_init (&attr);
+    pthread_attr_setdetachstate (&attr, PTHREAD_CREATE_DETACHED);
+    pthread_mutex_lock (&pool_mutex);
+    while (pool_nstarted < nthreads)
+    {
+        if (pthread_create (&thread, &attr, pool_thread,
+            (void *) (long) (pool_nstarted + 1)) != 0)
+            break;
+        __atomic_store_n (&pool_nstarted, pool_nstarted + 1,
+            __ATOMIC_RELEASE);
+    }
+    pthread_mutex_unlock (&pool_mutex);
+    pthread_attr_destroy (&attr);
+}
+#endif
+
+
+/******************************************************************************
+MODULE:  espa_task_pool_threads
+
+PURPOSE:  Returns the cap on the number of threads.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+n               Cap on the number of threads, including the calling thread;
+                1 if threading isn't compiled in
+
+NOTES:
+******************************************************************************/
+int espa_task_pool_threads (void)
+{
+#ifdef _OPENMP
+    pthread_once (&pool_once, init_pool);
+    return (__atomic_load_n (&pool_cap, __ATOMIC_ACQUIRE));
+#else
+    return (1);
+#endif
+}
+
+
+/******************************************************************************
+MODULE:  espa_task_pool_set_threads
+
+PURPOSE:  Sets the cap on the number of threads, overriding ESPA_THREADS_ENV.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. The cap may be changed at any time; it applies to the loops started
+     afterwards.  Lowering it leaves the extra threads idle.
+******************************************************************************/
+void espa_task_pool_set_threads
+(
+    int nthreads         /* I: cap on the number of threads; values below 1
+                               use a single thread */
+)
+{
+    if (nthreads < 1)
+        nthreads = 1;
+    if (nthreads > ESPA_TASK_POOL_MAX_THREADS)
+        nthreads = ESPA_TASK_POOL_MAX_THREADS;
+
+    __atomic_store_n (&pool_cap, nthreads, __ATOMIC_RELEASE);
+#ifdef _OPENMP
+    pthread_once (&pool_once, init_pool);
+#endif
+}
+
+
+/******************************************************************************
+MODULE:  espa_task_pool_set_numa
+
+PURPOSE:  Turns the NUMA placement on or off, overriding ESPA_NUMA_ENV.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. It applies to the loops started afterwards.  The threads of the pool
+     are bound to their nodes the next time they look for work; turning the
+     placement off leaves them bound.
+******************************************************************************/
+void espa_task_pool_set_numa
+(
+    bool numa            /* I: place the threads and loops on the NUMA
+                               nodes? */
+)
+{
+    __atomic_store_n (&pool_numa, numa ? 1 : 0, __ATOMIC_RELEASE);
+#ifdef _OPENMP
+    pthread_once (&pool_once, init_pool);
+#endif
+}
+
+
+/******************************************************************************
+MODULE:  espa_task_pool_numa
+
+PURPOSE:  Returns whether the threads and loops are placed on the NUMA
+nodes.
+
+RETURN VALUE:
+Type = bool
+Value           Description
+-----           -----------
+false           The placement is off, there is a single node, or threading
+                isn't compiled in
+true            The threads and loops are placed on the NUMA nodes
+
+NOTES:
+******************************************************************************/
+bool espa_task_pool_numa (void)
+{
+#ifdef _OPENMP
+    pthread_once (&pool_once, init_pool);
+    return (numa_nodes () > 0);
+#else
+    return (false);
+#endif
+}
+
+
+/******************************************************************************
+MODULE:  espa_task_pool_node
+
+PURPOSE:  Returns the NUMA node of the calling thread.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+-1              The placement is off
+n               NUMA node of the calling thread
+
+NOTES:
+  1. The threads of the pool stay on their node; any other thread is on the
+     node of the processor it is running on at the time.
+******************************************************************************/
+int espa_task_pool_node (void)
+{
+#ifdef _OPENMP
+    pthread_once (&pool_once, init_pool);
+    return (thread_node ());
+#else
+    return (-1);
+#endif
+}
+
+
+/******************************************************************************
+MODULE:  espa_task_group_init
+
+PURPOSE:  Initializes an empty group of tasks.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+void espa_task_group_init
+(
+    Espa_task_group_t *group /* O: empty group of tasks */
+)
+{
+    group->pending = 0;
+    group->status = SUCCESS;
+}
+
+
+/******************************************************************************
+MODULE:  espa_task_group_run
+
+PURPOSE:  Submits a task to the pool as part of a group.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. The task is run right away in the calling thread when the pool has a
+     single thread (or the task can't be queued).
+  2. The status of the task is kept in the group (see
+     espa_task_group_status and espa_task_group_wait).
+******************************************************************************/
+void espa_task_group_run
+(
+    Espa_task_group_t *group, /* I/O: group of the task */
+    Espa_task_func_t func,    /* I: task to be run */
+    void *arg                 /* I/O: argument of the task; must stay valid
+                                      until the group is waited for */
+)
+{
+#ifdef _OPENMP
+    Pool_task_t task;         /* task to be queued */
+
+    if (espa_task_pool_threads () > 1)
+    {
+        start_threads ();
+        task.func = func;
+        task.arg = arg;
+        task.group = group;
+
+        pthread_mutex_lock (&pool_mutex);
+        group->pending++;
+        pthread_mutex_unlock (&pool_mutex);
+        if (push_task (&task) == SUCCESS)
+            return;
+
+        pthread_mutex_lock (&pool_mutex);
+        group->pending--;
+        pthread_mutex_unlock (&pool_mutex);
+    }
+#endif
+
+    if (func (arg) != SUCCESS)
+        __atomic_store_n (&group->status, ERROR, __ATOMIC_RELEASE);
+}
+
+
+/******************************************************************************
+MODULE:  espa_task_group_status
+
+PURPOSE:  Returns the status of the tasks of a group which have finished so
+far.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           A task of the group failed
+SUCCESS         No task of the group has failed yet
+
+NOTES:
+  1. Lets the thread submitting the tasks stop submitting once one failed.
+******************************************************************************/
+int espa_task_group_status
+(
+    Espa_task_group_t *group  /* I: group of tasks */
+)
+{
+    return (__atomic_load_n (&group->status, __ATOMIC_ACQUIRE));
+}
+
+
+/******************************************************************************
+MODULE:  espa_task_group_wait
+
+PURPOSE:  Waits for the tasks of a group to finish, running the queued tasks
+in the meantime.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           A task of the group failed
+SUCCESS         Every task of the group succeeded
+
+NOTES:
+  1. The group may be used again afterwards.
+******************************************************************************/
+int espa_task_group_wait
+(
+    Espa_task_group_t *group  /* I/O: group of tasks to be waited for */
+)
+{
+#ifdef _OPENMP
+    unsigned long epoch;      /* epoch before looking for a task */
+    int pending;              /* number of unfinished tasks of the group */
+    Pool_task_t task;         /* task to be run */
+
+    while (1)
+    {
+        pthread_mutex_lock (&pool_mutex);
+        epoch = pool_epoch;
+        pending = group->pending;
+        pthread_mutex_unlock (&pool_mutex);
+        if (pending == 0)
+            break;
+
+        if (take_task (&task))
+        {
+            run_task (&task);
+            continue;
+        }
+
+        pthread_mutex_lock (&pool_mutex);
+        while (pool_epoch == epoch && group->pending > 0)
+            pthread_cond_wait (&pool_cond, &pool_mutex);
+        pthread_mutex_unlock (&pool_mutex);
+    }
+#endif
+
+    return (espa_task_group_status (group));
+}
+
+
+/******************************************************************************
+MODULE:  finish_iteration
+
+PURPOSE:  Records the status of a finished iteration of a loop, and reports
+the finished iterations which are next in order.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. The reports are made by whichever worker finishes the iteration which
+     is next in order, one at a time.  Once a report fails, no more
+     iterations are claimed or reported.
+******************************************************************************/
+static void finish_iteration
+(
+    Pool_loop_t *loop,        /* I/O: loop of the iteration */
+    int index,                /* I: index of the iteration */
+    int status                /* I: status of the iteration */
+)
+{
+    if (status != SUCCESS)
+    {
+        __atomic_store_n (&loop->status, ERROR, __ATOMIC_RELEASE);
+        __atomic_store_n (&loop->stop, 1, __ATOMIC_RELEASE);
+    }
+    if (loop->report == NULL)
+        return;
+
+#ifdef _OPENMP
+    pthread_mutex_lock (&loop->mutex);
+#endif
+    loop->done[index] = (status == SUCCESS) ? 1 : 2;
+    while (loop->next_report < loop->n && loop->done[loop->next_report] != 0)
+    {
+        if (loop->reporting && loop->report (loop->arg, loop->next_report,
+            loop->done[loop->next_report] == 1 ? SUCCESS : ERROR) != SUCCESS)
+        {
+            loop->reporting = false;
+            __atomic_store_n (&loop->status, ERROR, __ATOMIC_RELEASE);
+            __atomic_store_n (&loop->stop, 1, __ATOMIC_RELEASE);
+        }
+        loop->next_report++;
+    }
+#ifdef _OPENMP
+    pthread_mutex_unlock (&loop->mutex);
+#endif
+}
+
+
+/******************************************************************************
+MODULE:  claim_iteration
+
+PURPOSE:  Claims the next iteration of a loop for a worker, from the range
+of its NUMA node first when the iterations are split.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+-1              Every iteration is claimed
+index           Index of the claimed iteration
+
+NOTES:
+******************************************************************************/
+static int claim_iteration
+(
+    Pool_loop_t *loop,        /* I/O: loop of the iteration */
+    int node                  /* I: NUMA node of the worker; -1 if none */
+)
+{
+    int index;                /* claimed iteration */
+    int range;                /* range to claim from */
+    int i;                    /* looping variable for the ranges */
+
+    if (loop->nranges == 0)
+    {
+        index = __atomic_fetch_add (&loop->next, 1, __ATOMIC_ACQ_REL);
+        return (index < loop->n ? index : -1);
+    }
+
+    for (i = 0; i < loop->nranges; i++)
+    {
+        range = ((node < 0 ? 0 : node) + i) % loop->nranges;
+        index = __atomic_fetch_add (&loop->range_next[range], 1,
+            __ATOMIC_ACQ_REL);
+        if (index < loop->range_end[range])
+            return (index);
+    }
+
+    return (-1);
+}
+
+
+/******************************************************************************
+MODULE:  run_loop
+
+PURPOSE:  Joins a loop as a worker, running iterations until they are all
+claimed.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+SUCCESS         Always; the status of the iterations is kept in the loop
+
+NOTES:
+******************************************************************************/
+static int run_loop
+(
+    void *arg                 /* I/O: loop to be joined */
+)
+{
+    Pool_loop_t *loop = arg;  /* loop to be joined */
+    int index;                /* claimed iteration */
+    int worker = -1;          /* index of the worker; -1 until an iteration
+                                 is claimed */
+    int node = -1;            /* NUMA node of the worker; -1 if the
+                                 iterations aren't split */
+
+#ifdef _OPENMP
+    if (loop->nranges > 0)
+        node = thread_node ();
+#endif
+
+    while (!__atomic_load_n (&loop->stop, __ATOMIC_ACQUIRE))
+    {
+        index = claim_iteration (loop, node);
+        if (index < 0)
+            break;
+        if (worker < 0)
+            worker = __atomic_fetch_add (&loop->nworkers, 1,
+                __ATOMIC_ACQ_REL);
+
+        finish_iteration (loop, index, loop->func (loop->arg, index,
+            worker));
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  espa_parallel_for_workers
+
+PURPOSE:  Returns the number of workers a parallel loop will have.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+n               Number of workers; the worker indexes given to the
+                iterations are less than this
+
+NOTES:
+  1. For allocating the buffers of each worker before the loop.
+******************************************************************************/
+int espa_parallel_for_workers
+(
+    int n,               /* I: number of iterations of the loop */
+    int max_workers      /* I: most workers for the loop; 0 for the cap */
+)
+{
+    int nworkers;        /* number of workers */
+
+    nworkers = espa_task_pool_threads ();
+    if (max_workers > 0 && max_workers < nworkers)
+        nworkers = max_workers;
+    if (nworkers > n)
+        nworkers = n;
+    if (nworkers < 1)
+        nworkers = 1;
+
+    return (nworkers);
+}
+
+
+/******************************************************************************
+MODULE:  run_parallel_loop
+
+PURPOSE:  Runs a parallel loop, with or without the ordered reports.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           An iteration or report failed
+SUCCESS         Every iteration and report succeeded
+
+NOTES:
+******************************************************************************/
+static int run_parallel_loop
+(
+    int n,               /* I: number of iterations of the loop */
+    int max_workers,     /* I: most workers for the loop; 0 for the cap */
+    Espa_loop_func_t func,   /* I: function run for each iteration */
+    Espa_loop_report_t report, /* I: function run for each finished
+                                     iteration in order; NULL if none */
+    void *arg            /* I/O: argument of func and report */
+)
+{
+    char FUNC_NAME[] = "run_parallel_loop";  /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    int nworkers;             /* number of workers of the loop */
+#ifdef _OPENMP
+    int nnodes;               /* number of NUMA nodes; 0 if not placed */
+#endif
+    int i;                    /* looping variable for the workers */
+    Pool_loop_t loop;         /* the loop */
+    Espa_task_group_t group;  /* tasks of the workers */
+
+    if (n <= 0)
+        return (SUCCESS);
+    nworkers = espa_parallel_for_workers (n, max_workers);
+
+    memset (&loop, 0, sizeof (loop));
+    loop.n = n;
+    loop.func = func;
+    loop.report = report;
+    loop.arg = arg;
+    loop.status = SUCCESS;
+    loop.reporting = true;
+    if (report != NULL)
+    {
+        loop.done = calloc (n, sizeof (char));
+        if (loop.done == NULL)
+        {
+            sprintf (errmsg, "Allocating the states of %d iterations", n);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+    }
+#ifdef _OPENMP
+    pthread_mutex_init (&loop.mutex, NULL);
+
+    /* Split the iterations into a contiguous range for each NUMA node.  The
+       ordered loops are claimed in order, so the reports don't wait on a
+       range of another node. */
+    nnodes = numa_nodes ();
+    if (report == NULL && nworkers > 1 && nnodes > 0)
+    {
+        loop.nranges = (nnodes < n) ? nnodes : n;
+        for (i = 0; i < loop.nranges; i++)
+        {
+            loop.range_next[i] = (int) ((long) n * i / loop.nranges);
+            loop.range_end[i] = (int) ((long) n * (i + 1) / loop.nranges);
+        }
+    }
+#endif
+
+    /* The calling thread is one of the workers */
+    espa_task_group_init (&group);
+    for (i = 1; i < nworkers; i++)
+        espa_task_group_run (&group, run_loop, &loop);
+    run_loop (&loop);
+    espa_task_group_wait (&group);
+
+#ifdef _OPENMP
+    pthread_mutex_destroy (&loop.mutex);
+#endif
+    free (loop.done);
+
+    return (loop.status);
+}
+
+
+/******************************************************************************
+MODULE:  espa_parallel_for
+
+PURPOSE:  Runs the iterations of a loop across the threads of the pool.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           An iteration failed
+SUCCESS         Every iteration succeeded
+
+NOTES:
+  1. The iterations are claimed one at a time, in order, by the workers of
+     the loop.  Once an iteration fails, the iterations which haven't been
+     claimed are skipped.  With the NUMA placement on, the iterations are
+     split into a contiguous range for each node, claimed in order by the
+     workers of that node first.
+  2. The calling thread is one of the workers, and the loop may be run from
+     within an iteration of another loop.
+******************************************************************************/
+int espa_parallel_for
+(
+    int n,               /* I: number of iterations of the loop */
+    int max_workers,     /* I: most workers for the loop; 0 for the cap */
+    Espa_loop_func_t func,   /* I: function run for each iteration */
+    void *arg            /* I/O: argument of func */
+)
+{
+    return (run_parallel_loop (n, max_workers, func, NULL, arg));
+}
+
+
+/******************************************************************************
+MODULE:  espa_parallel_for_ordered
+
+PURPOSE:  Runs the iterations of a loop across the threads of the pool, and
+reports each finished iteration in the order of the iterations.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           An iteration or report failed
+SUCCESS         Every iteration and report succeeded
+
+NOTES:
+  1. The report of an iteration is run, one at a time, as soon as it and
+     every iteration before it have finished.  It is given the status of the
+     iteration, so the progress, the errors, and the removal of the source
+     files are reported in order as in the OpenMP ordered construct.
+  2. Once an iteration fails, the iterations which haven't been claimed are
+     skipped; the iterations before it are still reported.  Once a report
+     fails, the later iterations aren't reported.
+******************************************************************************/
+int espa_parallel_for_ordered
+(
+    int n,               /* I: number of iterations of the loop */
+    int max_workers,     /* I: most workers for the loop; 0 for the cap */
+    Espa_loop_func_t func,   /* I: function run for each iteration */
+    Espa_loop_report_t report, /* I: function run for each finished
+                                     iteration, in the order of the
+                                     iterations */
+    void *arg            /* I/O: argument of func and report */
+)
+{
+    return (run_parallel_loop (n, max_workers, func, report, arg));
+}
@@ -0,0 +1,162 @@
+/*****************************************************************************
+FILE: espa_task_pool.h
+
+PURPOSE: Contains defines, structures, and prototypes for the shared task
+pool, which runs the parallel loops and tasks of all the libraries on one
+set of threads, so nested parallel work never runs more threads than the
+global cap.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The cap on the number of threads is taken from ESPA_THREADS_ENV, and is
+     the number of online processors if it isn't set.  The tools with a
+     thread count option set it with espa_task_pool_set_threads.  The thread
+     which submits the work counts as one of the threads, so the pool starts
+     one thread less than the cap.
+  2. Each thread of the pool has its own queue of tasks.  The tasks a thread
+     submits go on the back of its own queue and it runs them from the back,
+     while idle threads steal from the front of the queues of the others.
+     The tasks submitted by threads outside the pool share one queue.
+  3. A thread waiting for its tasks (espa_task_group_wait) runs the queued
+     tasks rather than blocking, so a loop within a loop (ex. the tiles of a
+     COG band within the loop over the bands) spreads over the threads which
+     are idle instead of starting more threads.
+  4. The threads are only started when threading is compiled in
+     (ENABLE_THREADING); otherwise the loops and tasks run in the calling
+     thread, in order.  The critical sections and atomics of the libraries
+     are OpenMP pragmas, which hold for the threads of the pool as well.
+  5. A child process started with fork has none of the threads of its
+     parent, so the pool of the child starts its own threads when it is
+     first used.
+  6. The errors of the work run by the pool are reported by the thread
+     which ran it, so they aren't captured by capture_errors in the
+     submitting thread.
+  7. On a multi-socket node, setting ESPA_NUMA_ENV to yes (or 1), or
+     calling espa_task_pool_set_numa, binds each thread of the pool to the
+     processors of one NUMA node, spreading the threads over the nodes.  An
+     idle thread steals from the threads of its own node first, and
+     espa_parallel_for splits the iterations into a contiguous range for
+     each node, which the threads of that node work through before helping
+     the others, so whole bands (or runs of blocks) stay on one socket.
+     The buffer pool places the buffers on the node of the thread asking
+     for them while it is on (see espa_buffer_pool.h).
+*****************************************************************************/
+
+#ifndef ESPA_TASK_POOL_H
+#define ESPA_TASK_POOL_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include "error_handler.h"
+
+/* Defines */
+#define ESPA_THREADS_ENV "ESPA_THREADS"  /* cap on the number of threads */
+#define ESPA_TASK_POOL_MAX_THREADS 256   /* largest cap allowed */
+#define ESPA_NUMA_ENV "ESPA_NUMA"        /* turns on the NUMA placement */
+#define ESPA_TASK_POOL_MAX_NODES 16      /* most NUMA nodes placed on */
+
+/* Task run by the pool; returns SUCCESS or ERROR */
+typedef int (*Espa_task_func_t)
+(
+    void *arg            /* I/O: argument given when the task was submitted */
+);
+
+/* Iteration of a parallel loop; returns SUCCESS or ERROR */
+typedef int (*Espa_loop_func_t)
+(
+    void *arg,           /* I/O: argument given to the loop */
+    int index,           /* I: 0-based index of the iteration */
+    int worker           /* I: 0-based index of the worker running the
+                               iteration, less than the number of workers
+                               of the loop; for buffers of each worker */
+);
+
+/* Report of an iteration of an ordered parallel loop; returns SUCCESS or
+   ERROR */
+typedef int (*Espa_loop_report_t)
+(
+    void *arg,           /* I/O: argument given to the loop */
+    int index,           /* I: 0-based index of the iteration */
+    int status           /* I: status returned by the iteration */
+);
+
+/* Group of tasks which are waited for together */
+typedef struct
+{
+    int pending;         /* number of tasks submitted but not finished */
+    int status;          /* ERROR once a task of the group failed */
+} Espa_task_group_t;
+
+/* Prototypes */
+int espa_task_pool_threads (void);
+
+void espa_task_pool_set_threads
+(
+    int nthreads         /* I: cap on the number of threads; values below 1
+                               use a single thread */
+);
+
+void espa_task_pool_set_numa
+(
+    bool numa            /* I: place the threads and loops on the NUMA
+                               nodes? */
+);
+
+bool espa_task_pool_numa (void);
+
+int espa_task_pool_node (void);
+
+int espa_parallel_for_workers
+(
+    int n,               /* I: number of iterations of the loop */
+    int max_workers      /* I: most workers for the loop; 0 for the cap */
+);
+
+int espa_parallel_for
+(
+    int n,               /* I: number of iterations of the loop */
+    int max_workers,     /* I: most workers for the loop; 0 for the cap */
+    Espa_loop_func_t func,   /* I: function run for each iteration */
+    void *arg            /* I/O: argument of func */
+);
+
+int espa_parallel_for_ordered
+(
+    int n,               /* I: number of iterations of the loop */
+    int max_workers,     /* I: most workers for the loop; 0 for the cap */
+    Espa_loop_func_t func,   /* I: function run for each iteration */
+    Espa_loop_report_t report, /* I: function run for each finished
+                                     iteration, in the order of the
+                                     iterations */
+    void *arg            /* I/O: argument of func and report */
+);
+
+void espa_task_group_init
+(
+    Espa_task_group_t *group /* O: empty group of tasks */
+);
+
+void espa_task_group_run
+(
+    Espa_task_group_t *group, /* I/O: group of the task */
+    Espa_task_func_t func,    /* I: task to be run */
+    void *arg                 /* I/O: argument of the task; must stay valid
+                                      until the group is waited for */
+);
+
+int espa_task_group_status
+(
+    Espa_task_group_t *group  /* I: group of tasks */
+);
+
+int espa_task_group_wait
+(
+    Espa_task_group_t *group  /* I/O: group of tasks to be waited for */
+);
+
+#endif
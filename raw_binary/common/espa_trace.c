@@ -0,0 +1,997 @@
+/*****************************************************************************
+FILE: espa_trace.c
+
+PURPOSE: Contains functions for the optional timing trace and allocation
+accounting.  Each ended span is appended to a table of complete events,
+which an exit handler writes out in the Chrome trace event format.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The table is guarded by a spin lock built on the compiler atomics, as
+     in the I/O accounting, so the spans may be ended from threaded code
+     without requiring the tools to link with the pthread library.
+  2. The times are written in microseconds from when the trace was turned
+     on, with the thread id of the Linux thread which ended the span.
+  3. Each open span holds a slot with the peak of the allocated bytes, which
+     every accounted allocation raises.  There are only as many open spans
+     as the nesting of the spans times the number of threads, so the slots
+     are a small fixed table; spans beyond it are reported without a peak.
+  4. The hardware counters are kept per thread, since a span begins and
+     ends on the same thread, and they count only that thread.
+*****************************************************************************/
+
+#include <time.h>
+#include <errno.h>
+#include <unistd.h>
+#include <malloc.h>
+#include <sys/syscall.h>
+#include "error_handler.h"
+#include "espa_trace.h"
+
+/* Defines */
+#define ESPA_TRACE_DETAIL_SIZE 128  /* size of the copied detail */
+#define ESPA_TRACE_GROW 1024        /* number of events added to the table
+                                       each time it is grown */
+#define ESPA_TRACE_MAX_OPEN 256     /* number of slots for the open spans */
+#define ESPA_TRACE_MB (1024.0 * 1024.0)  /* bytes per megabyte */
+
+/* Complete event for an ended span */
+typedef struct
+{
+    const char *name;            /* name of the span */
+    char detail[ESPA_TRACE_DETAIL_SIZE];  /* detail of the span */
+    double start;                /* start of the span (seconds) */
+    double duration;             /* duration of the span (seconds) */
+    long tid;                    /* thread which ended the span */
+    long long mem_start;         /* bytes allocated when the span began */
+    long long mem_peak;          /* peak bytes allocated during the span;
+                                    -1 if not tracked */
+    long long mem_end;           /* bytes allocated when the span ended */
+    Espa_perf_values_t perf;     /* hardware counts of the span; negative
+                                    if not counted */
+} Espa_trace_event_t;
+
+static int trace_state = -1;     /* -1 not yet checked, 0 off, 1 on */
+static char *trace_dest = NULL;  /* file for the trace; NULL for stderr */
+static char trace_lock = 0;      /* spin lock for the table */
+static double trace_origin = 0.0;  /* time the trace was turned on */
+static Espa_trace_event_t *events = NULL;  /* ended spans */
+static long nevents = 0;         /* number of events in use */
+static long max_events = 0;      /* number of events allocated */
+static int mem_state = -1;       /* accounting: -1 not yet checked, 0 off,
+                                    1 on */
+static long long mem_budget = 0; /* memory budget (bytes); 0 if none */
+static bool mem_budget_set = false;  /* was the budget taken from the
+                                    environment or set by the caller? */
+static long long mem_current = 0;  /* bytes currently allocated */
+static long long mem_peak = 0;   /* peak bytes allocated */
+static long mem_nrefused = 0;    /* number of allocations refused for going
+                                    over the budget */
+static long long slot_peak[ESPA_TRACE_MAX_OPEN];  /* peak bytes of the open
+                                    span in each slot */
+static bool slot_used[ESPA_TRACE_MAX_OPEN];  /* is the slot in use? */
+static int nslots = 0;           /* one past the highest slot in use */
+static int perf_state = -1;      /* hardware counters: -1 not yet checked,
+                                    0 off, 1 on */
+static __thread int thread_perf_state = 0;  /* counters of the thread: 0 not
+                                    yet opened, 1 open, -1 unavailable */
+static __thread Espa_perf_counters_t thread_perf;  /* counters of the
+                                    thread */
+
+/******************************************************************************
+MODULE: trace_lock_acquire
+
+PURPOSE: Acquires the spin lock for the table.
+
+RETURN VALUE:
+Type = N/A
+
+NOTES:
+*****************************************************************************/
+static void trace_lock_acquire (void)
+{
+    while (__atomic_test_and_set (&trace_lock, __ATOMIC_ACQUIRE))
+        ;
+}
+
+
+/******************************************************************************
+MODULE: trace_lock_release
+
+PURPOSE: Releases the spin lock for the table.
+
+RETURN VALUE:
+Type = N/A
+
+NOTES:
+*****************************************************************************/
+static void trace_lock_release (void)
+{
+    __atomic_clear (&trace_lock, __ATOMIC_RELEASE);
+}
+
+
+/******************************************************************************
+MODULE: trace_clock
+
+PURPOSE: Returns the current wall clock time.
+
+RETURN VALUE:
+Type = double
+Value        Description
+-----        -----------
+t            Monotonic time in seconds
+
+NOTES:
+*****************************************************************************/
+static double trace_clock (void)
+{
+    struct timespec ts;          /* current time */
+
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+/******************************************************************************
+MODULE: write_json_string
+
+PURPOSE: Writes a string to the trace as a quoted JSON string.
+
+RETURN VALUE:
+Type = N/A
+
+NOTES:
+*****************************************************************************/
+static void write_json_string
+(
+    FILE *fptr,          /* I: trace file */
+    const char *str      /* I: string to be written */
+)
+{
+    const unsigned char *c;      /* current character */
+
+    fputc ('"', fptr);
+    for (c = (const unsigned char *) str; *c != '\0'; c++)
+    {
+        if (*c == '"' || *c == '\\')
+            fprintf (fptr, "\\%c", *c);
+        else if (*c < 0x20)
+            fprintf (fptr, "\\u%04x", *c);
+        else
+            fputc (*c, fptr);
+    }
+    fputc ('"', fptr);
+}
+
+
+/******************************************************************************
+MODULE: write_trace
+
+PURPOSE: Exit handler which writes the recorded spans as a Chrome trace.
+
+RETURN VALUE:
+Type = N/A
+
+NOTES:
+  1. Spans which haven't ended at exit aren't written.
+*****************************************************************************/
+static void write_trace (void)
+{
+    FILE *fptr = stderr;         /* trace file */
+    Espa_trace_event_t *e;       /* current event */
+    long i;                      /* looping variable for the events */
+    long pid = (long) getpid (); /* process id for the events */
+
+    if (trace_dest != NULL)
+    {
+        fptr = fopen (trace_dest, "w");
+        if (fptr == NULL)
+        {
+            fprintf (stderr, "Warning: unable to write the timing trace to "
+                "%s\n", trace_dest);
+            return;
+        }
+    }
+
+    trace_lock_acquire ();
+    fprintf (fptr, "{\"displayTimeUnit\": \"ms\", \"memory\": "
+        "{\"peak_mb\": %.3f, \"budget_mb\": %.3f, \"refused\": %ld}, "
+        "\"traceEvents\": [", mem_peak / ESPA_TRACE_MB,
+        mem_budget / ESPA_TRACE_MB, mem_nrefused);
+    for (i = 0; i < nevents; i++)
+    {
+        e = &events[i];
+        fprintf (fptr, "%s\n  {\"name\": \"%s\", \"cat\": \"espa\", "
+            "\"ph\": \"X\", \"pid\": %ld, \"tid\": %ld, \"ts\": %.3f, "
+            "\"dur\": %.3f, \"args\": {", i == 0 ? "" : ",", e->name, pid,
+            e->tid, (e->start - trace_origin) * 1e6, e->duration * 1e6);
+        if (e->detail[0] != '\0')
+        {
+            fprintf (fptr, "\"detail\": ");
+            write_json_string (fptr, e->detail);
+            fprintf (fptr, ", ");
+        }
+        fprintf (fptr, "\"mem_start_mb\": %.3f, ",
+            e->mem_start / ESPA_TRACE_MB);
+        if (e->mem_peak >= 0)
+            fprintf (fptr, "\"mem_peak_mb\": %.3f, ",
+                e->mem_peak / ESPA_TRACE_MB);
+        fprintf (fptr, "\"mem_end_mb\": %.3f", e->mem_end / ESPA_TRACE_MB);
+        if (perf_state == 1)
+            espa_perf_write_json (fptr, &e->perf, e->duration);
+        fprintf (fptr, "}},");
+
+        /* Sample the allocated bytes at the end of the span */
+        fprintf (fptr, "\n  {\"name\": \"allocated\", \"cat\": \"espa\", "
+            "\"ph\": \"C\", \"pid\": %ld, \"ts\": %.3f, \"args\": "
+            "{\"MB\": %.3f}}", pid,
+            (e->start + e->duration - trace_origin) * 1e6,
+            e->mem_end / ESPA_TRACE_MB);
+    }
+    fprintf (fptr, "\n]}\n");
+    trace_lock_release ();
+
+    if (fptr != stderr)
+        fclose (fptr);
+}
+
+
+/******************************************************************************
+MODULE: espa_trace_enabled
+
+PURPOSE: Determines whether the timing trace has been turned on, and
+registers the exit handler the first time it is.
+
+RETURN VALUE:
+Type = bool
+Value        Description
+-----        -----------
+true         The trace is on
+false        The trace is off
+
+NOTES:
+  1. The environment variable is only checked on the first call.
+*****************************************************************************/
+bool espa_trace_enabled (void)
+{
+    char *env = NULL;            /* value of the environment variable */
+    int state;                   /* current state of the trace */
+
+    state = __atomic_load_n (&trace_state, __ATOMIC_ACQUIRE);
+    if (state >= 0)
+        return state == 1;
+
+    trace_lock_acquire ();
+    if (trace_state < 0)
+    {
+        env = getenv (ESPA_TRACE_ENV);
+        if (env == NULL || *env == '\0' || !strcmp (env, "no") ||
+            !strcmp (env, "0"))
+            __atomic_store_n (&trace_state, 0, __ATOMIC_RELEASE);
+        else
+        {
+            if (strcmp (env, "yes") && strcmp (env, "1"))
+                trace_dest = strdup (env);
+            trace_origin = trace_clock ();
+            if (atexit (write_trace) == 0)
+                __atomic_store_n (&trace_state, 1, __ATOMIC_RELEASE);
+            else
+                __atomic_store_n (&trace_state, 0, __ATOMIC_RELEASE);
+        }
+    }
+    trace_lock_release ();
+
+    return trace_state == 1;
+}
+
+
+/******************************************************************************
+MODULE: read_thread_perf
+
+PURPOSE: Reads the hardware counters of the calling thread, opening them
+the first time, when ESPA_PERF_ENV is set.
+
+RETURN VALUE:
+Type = N/A
+
+NOTES:
+  1. The environment variable is only checked on the first call.  A warning
+     is written once if the counters can't be opened.
+*****************************************************************************/
+static void read_thread_perf
+(
+    Espa_perf_values_t *values   /* O: counters of the thread; negative if
+                                       not counted */
+)
+{
+    char *env = NULL;            /* value of the environment variable */
+    int i;                       /* looping variable for the counters */
+    int state;                   /* state of the counters */
+    static int warned = 0;       /* has the warning been written? */
+
+    for (i = 0; i < ESPA_PERF_NCOUNTERS; i++)
+        values->count[i] = -1.0;
+
+    state = __atomic_load_n (&perf_state, __ATOMIC_ACQUIRE);
+    if (state < 0)
+    {
+        env = getenv (ESPA_PERF_ENV);
+        state = (env != NULL && *env != '\0' && strcmp (env, "no") &&
+            strcmp (env, "0")) ? 1 : 0;
+        __atomic_store_n (&perf_state, state, __ATOMIC_RELEASE);
+    }
+    if (state == 0 || thread_perf_state < 0)
+        return;
+
+    if (thread_perf_state == 0)
+    {
+        thread_perf_state = 1;
+        if (espa_perf_open (&thread_perf, false) != SUCCESS)
+        {
+            thread_perf_state = -1;
+            if (!__atomic_exchange_n (&warned, 1, __ATOMIC_ACQ_REL))
+                fprintf (stderr, "Warning: the hardware counters are not "
+                    "available; the spans are traced without them\n");
+            return;
+        }
+    }
+    espa_perf_read (&thread_perf, values);
+}
+
+
+/******************************************************************************
+MODULE: espa_trace_begin
+
+PURPOSE: Begins timing a span.
+
+RETURN VALUE:
+Type = Espa_trace_span_t
+Value        Description
+-----        -----------
+span         Span to be passed to espa_trace_end; it isn't timed when the
+             trace is off
+
+NOTES:
+*****************************************************************************/
+Espa_trace_span_t espa_trace_begin
+(
+    const char *name,    /* I: name of the span (string constant) */
+    const char *detail   /* I: detail of the span; NULL if none */
+)
+{
+    Espa_trace_span_t span;      /* span being timed */
+    int i;                       /* looping variable for the slots */
+
+    span.name = name;
+    span.detail = detail;
+    span.start = -1.0;
+    span.mem_start = 0;
+    span.slot = -1;
+    for (i = 0; i < ESPA_PERF_NCOUNTERS; i++)
+        span.perf_start.count[i] = -1.0;
+    if (!espa_trace_enabled ())
+        return span;
+
+    /* Take a slot for the peak of the allocated bytes */
+    trace_lock_acquire ();
+    for (i = 0; i < ESPA_TRACE_MAX_OPEN; i++)
+    {
+        if (!slot_used[i])
+        {
+            slot_used[i] = true;
+            slot_peak[i] = mem_current;
+            if (i >= nslots)
+                nslots = i + 1;
+            span.slot = i;
+            break;
+        }
+    }
+    span.mem_start = mem_current;
+    trace_lock_release ();
+
+    read_thread_perf (&span.perf_start);
+    span.start = trace_clock ();
+    return span;
+}
+
+
+/******************************************************************************
+MODULE: espa_trace_end
+
+PURPOSE: Ends a span and records it in the trace.
+
+RETURN VALUE:
+Type = N/A
+
+NOTES:
+  1. The span is silently dropped if the table can't be grown, since the
+     trace must never cause the tool itself to fail.
+  2. Ending a span which was never timed, or has already ended, does
+     nothing, so ESPA_TRACE_SCOPE spans may also be ended early.
+*****************************************************************************/
+void espa_trace_end
+(
+    Espa_trace_span_t *span  /* I/O: span to be ended; it is marked as ended
+                                     so it isn't recorded twice */
+)
+{
+    double end;                  /* end of the span */
+    void *ptr = NULL;            /* reallocated table */
+    Espa_trace_event_t *e;       /* event for the span */
+    Espa_perf_values_t perf_end; /* counters of the thread at the end */
+
+    if (span->start < 0.0)
+        return;
+
+    end = trace_clock ();
+    read_thread_perf (&perf_end);
+    trace_lock_acquire ();
+    if (span->slot >= 0)
+    {
+        slot_used[span->slot] = false;
+        while (nslots > 0 && !slot_used[nslots - 1])
+            nslots--;
+    }
+    if (nevents == max_events)
+    {
+        ptr = realloc (events, (max_events + ESPA_TRACE_GROW) *
+            sizeof (Espa_trace_event_t));
+        if (ptr == NULL)
+        {
+            trace_lock_release ();
+            span->start = -1.0;
+            return;
+        }
+        events = ptr;
+        max_events += ESPA_TRACE_GROW;
+    }
+
+    e = &events[nevents++];
+    e->name = span->name;
+    e->detail[0] = '\0';
+    if (span->detail != NULL)
+        snprintf (e->detail, sizeof (e->detail), "%s", span->detail);
+    e->start = span->start;
+    e->duration = end - span->start;
+    e->tid = syscall (SYS_gettid);
+    e->mem_start = span->mem_start;
+    e->mem_end = mem_current;
+    e->mem_peak = -1;
+    if (span->slot >= 0)
+        e->mem_peak = slot_peak[span->slot];
+    espa_perf_delta (&span->perf_start, &perf_end, &e->perf);
+    trace_lock_release ();
+
+    span->start = -1.0;
+}
+
+
+/******************************************************************************
+MODULE: read_mem_budget
+
+PURPOSE: Takes the memory budget from ESPA_MEM_BUDGET_ENV, unless it was
+already taken or set by espa_mem_set_budget_mb.
+
+RETURN VALUE:
+Type = N/A
+
+NOTES:
+  1. The trace lock must be held.  An invalid budget is ignored with a
+     warning.
+*****************************************************************************/
+static void read_mem_budget (void)
+{
+    char FUNC_NAME[] = "read_mem_budget";  /* function name */
+    char errmsg[STR_SIZE];       /* error message */
+    char *env = NULL;            /* value of the environment variable */
+    char *end = NULL;            /* end of the budget in env */
+    double budget_mb;            /* memory budget (MB) */
+
+    if (mem_budget_set)
+        return;
+    mem_budget_set = true;
+
+    env = getenv (ESPA_MEM_BUDGET_ENV);
+    if (env != NULL && *env != '\0')
+    {
+        budget_mb = strtod (env, &end);
+        if (*end == '\0' && budget_mb > 0.0)
+            mem_budget = budget_mb * ESPA_TRACE_MB;
+        else
+        {
+            snprintf (errmsg, sizeof (errmsg), "Invalid %s: %s; no memory "
+                "budget is used", ESPA_MEM_BUDGET_ENV, env);
+            error_handler (false, FUNC_NAME, errmsg);
+        }
+    }
+}
+
+
+/******************************************************************************
+MODULE: espa_trace_mem_enabled
+
+PURPOSE: Determines whether the allocation accounting is on, which it is
+while the trace is on or a memory budget is set.
+
+RETURN VALUE:
+Type = bool
+Value        Description
+-----        -----------
+true         The allocations are accounted for
+false        The allocations aren't accounted for
+
+NOTES:
+  1. The state is settled on the first call, which is the first allocation
+     of the wrappers.
+*****************************************************************************/
+static bool espa_trace_mem_enabled (void)
+{
+    int state;                   /* current state of the accounting */
+
+    state = __atomic_load_n (&mem_state, __ATOMIC_ACQUIRE);
+    if (state >= 0)
+        return state == 1;
+
+    trace_lock_acquire ();
+    read_mem_budget ();
+    trace_lock_release ();
+
+    /* The trace takes the lock itself the first time it is checked */
+    state = mem_budget > 0 || espa_trace_enabled ();
+    __atomic_store_n (&mem_state, state, __ATOMIC_RELEASE);
+
+    return state == 1;
+}
+
+
+/******************************************************************************
+MODULE: account_mem
+
+PURPOSE: Adds an allocation to (or removes a free from) the bytes allocated,
+raising the peaks of the process and of the open spans.
+
+RETURN VALUE:
+Type = N/A
+
+NOTES:
+  1. The trace lock must be held.
+*****************************************************************************/
+static void account_mem
+(
+    long long nbytes     /* I: bytes allocated; negative for bytes freed */
+)
+{
+    int i;                       /* looping variable for the slots */
+
+    mem_current += nbytes;
+    if (nbytes <= 0)
+        return;
+
+    if (mem_current > mem_peak)
+        mem_peak = mem_current;
+    for (i = 0; i < nslots; i++)
+    {
+        if (slot_used[i] && mem_current > slot_peak[i])
+            slot_peak[i] = mem_current;
+    }
+}
+
+
+/******************************************************************************
+MODULE: within_mem_budget
+
+PURPOSE: Determines whether an allocation fits in the memory budget, and
+reports it if it doesn't.
+
+RETURN VALUE:
+Type = bool
+Value        Description
+-----        -----------
+true         The allocation fits (or there is no budget)
+false        The allocation would go over the budget
+
+NOTES:
+  1. The check is a hint rather than a reservation: threads allocating at
+     the same time may together go slightly over the budget.
+*****************************************************************************/
+static bool within_mem_budget
+(
+    long long nbytes     /* I: bytes to be allocated */
+)
+{
+    char FUNC_NAME[] = "within_mem_budget";  /* function name */
+    char errmsg[STR_SIZE];       /* error message */
+    long long current;           /* bytes currently allocated */
+
+    if (mem_budget <= 0 || nbytes <= 0)
+        return true;
+
+    trace_lock_acquire ();
+    current = mem_current;
+    if (current + nbytes <= mem_budget)
+    {
+        trace_lock_release ();
+        return true;
+    }
+    mem_nrefused++;
+    trace_lock_release ();
+
+    snprintf (errmsg, sizeof (errmsg), "Allocating %.1f MB would exceed the "
+        "memory budget of %.1f MB (%.1f MB allocated)", nbytes / ESPA_TRACE_MB,
+        mem_budget / ESPA_TRACE_MB, current / ESPA_TRACE_MB);
+    error_handler (true, FUNC_NAME, errmsg);
+    return false;
+}
+
+
+/******************************************************************************
+MODULE: espa_trace_malloc
+
+PURPOSE: Allocates memory, accounting for it when the accounting is on.
+
+RETURN VALUE:
+Type = void *
+Value        Description
+-----        -----------
+NULL         Error allocating the memory, or it would exceed the budget
+non-NULL     Allocated memory, to be released with espa_trace_free
+
+NOTES:
+*****************************************************************************/
+void *espa_trace_malloc
+(
+    size_t size          /* I: number of bytes to allocate */
+)
+{
+    void *ptr = NULL;            /* allocated memory */
+
+    if (!espa_trace_mem_enabled ())
+        return malloc (size);
+
+    if (!within_mem_budget (size))
+        return NULL;
+    ptr = malloc (size);
+    if (ptr != NULL)
+    {
+        trace_lock_acquire ();
+        account_mem (malloc_usable_size (ptr));
+        trace_lock_release ();
+    }
+
+    return ptr;
+}
+
+
+/******************************************************************************
+MODULE: espa_trace_calloc
+
+PURPOSE: Allocates zeroed memory, accounting for it when the accounting is
+on.
+
+RETURN VALUE:
+Type = void *
+Value        Description
+-----        -----------
+NULL         Error allocating the memory, or it would exceed the budget
+non-NULL     Allocated memory, to be released with espa_trace_free
+
+NOTES:
+*****************************************************************************/
+void *espa_trace_calloc
+(
+    size_t nmemb,        /* I: number of elements to allocate */
+    size_t size          /* I: size of each element */
+)
+{
+    void *ptr = NULL;            /* allocated memory */
+
+    if (!espa_trace_mem_enabled ())
+        return calloc (nmemb, size);
+
+    if (size != 0 && nmemb > (size_t) -1 / size)
+        return NULL;
+    if (!within_mem_budget (nmemb * size))
+        return NULL;
+    ptr = calloc (nmemb, size);
+    if (ptr != NULL)
+    {
+        trace_lock_acquire ();
+        account_mem (malloc_usable_size (ptr));
+        trace_lock_release ();
+    }
+
+    return ptr;
+}
+
+
+/******************************************************************************
+MODULE: espa_trace_realloc
+
+PURPOSE: Resizes memory, accounting for the change when the accounting is
+on.
+
+RETURN VALUE:
+Type = void *
+Value        Description
+-----        -----------
+NULL         Error resizing the memory, or it would exceed the budget; ptr
+             is left as it was
+non-NULL     Resized memory, to be released with espa_trace_free
+
+NOTES:
+*****************************************************************************/
+void *espa_trace_realloc
+(
+    void *ptr,           /* I: memory to be resized; NULL to allocate */
+    size_t size          /* I: new number of bytes */
+)
+{
+    void *new_ptr = NULL;        /* resized memory */
+    long long old_size;          /* usable bytes of ptr */
+
+    if (!espa_trace_mem_enabled ())
+        return realloc (ptr, size);
+
+    old_size = ptr == NULL ? 0 : malloc_usable_size (ptr);
+    if (!within_mem_budget ((long long) size - old_size))
+        return NULL;
+    new_ptr = realloc (ptr, size);
+    if (new_ptr != NULL || size == 0)
+    {
+        trace_lock_acquire ();
+        account_mem ((new_ptr == NULL ? 0 : (long long)
+            malloc_usable_size (new_ptr)) - old_size);
+        trace_lock_release ();
+    }
+
+    return new_ptr;
+}
+
+
+/******************************************************************************
+MODULE: espa_trace_posix_memalign
+
+PURPOSE: Allocates aligned memory, accounting for it when the accounting is
+on.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+0            Successful allocation, to be released with espa_trace_free
+non-zero     Error allocating the memory (ENOMEM if it would exceed the
+             budget)
+
+NOTES:
+*****************************************************************************/
+int espa_trace_posix_memalign
+(
+    void **ptr,          /* O: allocated memory */
+    size_t alignment,    /* I: alignment of the memory (power of two) */
+    size_t size          /* I: number of bytes to allocate */
+)
+{
+    int status;                  /* return status of posix_memalign */
+
+    if (!espa_trace_mem_enabled ())
+        return posix_memalign (ptr, alignment, size);
+
+    if (!within_mem_budget (size))
+        return ENOMEM;
+    status = posix_memalign (ptr, alignment, size);
+    if (status == 0)
+    {
+        trace_lock_acquire ();
+        account_mem (malloc_usable_size (*ptr));
+        trace_lock_release ();
+    }
+
+    return status;
+}
+
+
+/******************************************************************************
+MODULE: espa_trace_free
+
+PURPOSE: Frees memory from the accounted allocations.
+
+RETURN VALUE:
+Type = N/A
+
+NOTES:
+  1. Whether the accounting is on is settled by the first call to any of the
+     wrappers, so the bytes removed here were always added when the memory
+     was allocated.
+*****************************************************************************/
+void espa_trace_free
+(
+    void *ptr            /* I: memory to be freed; may be NULL */
+)
+{
+    if (ptr == NULL)
+        return;
+
+    if (espa_trace_mem_enabled ())
+    {
+        trace_lock_acquire ();
+        account_mem (-(long long) malloc_usable_size (ptr));
+        trace_lock_release ();
+    }
+    free (ptr);
+}
+
+
+/******************************************************************************
+MODULE: espa_mem_set_budget_mb
+
+PURPOSE: Sets the memory budget of the accounted allocations, overriding
+ESPA_MEM_BUDGET_ENV.
+
+RETURN VALUE:
+Type = N/A
+
+NOTES:
+  1. Call it before the first accounted allocation.  A budget set once the
+     accounting was found to be off (the first allocation was made without
+     a budget or the trace) still sizes the blocks, caches, and threads, but
+     doesn't limit the allocations, since the bytes allocated until then
+     weren't counted.
+*****************************************************************************/
+void espa_mem_set_budget_mb
+(
+    double budget_mb     /* I: memory budget (MB); 0 for none */
+)
+{
+    char FUNC_NAME[] = "espa_mem_set_budget_mb";  /* function name */
+    int state;                   /* state of the accounting */
+
+    trace_lock_acquire ();
+    mem_budget_set = true;
+    mem_budget = budget_mb > 0.0 ? budget_mb * ESPA_TRACE_MB : 0;
+    state = mem_state;
+    trace_lock_release ();
+
+    if (state == 0 && budget_mb > 0.0)
+        error_handler (false, FUNC_NAME, "The memory budget was set after "
+            "the first allocation, so it sizes the work but doesn't limit "
+            "the allocations");
+}
+
+
+/******************************************************************************
+MODULE: espa_mem_budget
+
+PURPOSE: Returns the memory budget of the accounted allocations.
+
+RETURN VALUE:
+Type = long long
+Value        Description
+-----        -----------
+0            There is no budget
+> 0          Memory budget (bytes)
+
+NOTES:
+*****************************************************************************/
+long long espa_mem_budget (void)
+{
+    long long budget;            /* memory budget (bytes) */
+
+    trace_lock_acquire ();
+    read_mem_budget ();
+    budget = mem_budget;
+    trace_lock_release ();
+
+    return budget;
+}
+
+
+/******************************************************************************
+MODULE: espa_mem_available
+
+PURPOSE: Returns the bytes which may still be allocated within the memory
+budget.
+
+RETURN VALUE:
+Type = long long
+Value        Description
+-----        -----------
+-1           There is no budget
+>= 0         Bytes left in the budget
+
+NOTES:
+*****************************************************************************/
+long long espa_mem_available (void)
+{
+    long long available;         /* bytes left in the budget */
+
+    if (espa_mem_budget () <= 0)
+        return -1;
+
+    trace_lock_acquire ();
+    available = mem_budget - mem_current;
+    trace_lock_release ();
+
+    return available > 0 ? available : 0;
+}
+
+
+/******************************************************************************
+MODULE: espa_mem_fit_count
+
+PURPOSE: Determines how many units of work (ex. the lines of a block, or the
+threads of a loop) fit in the memory budget.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+>= multiple  Number of units, a multiple of multiple no larger than count
+             (unless count is smaller than multiple)
+
+NOTES:
+  1. The units may take ESPA_MEM_WORK_SHARE of the bytes left in the budget,
+     leaving the rest for the allocations which aren't sized by it.
+  2. Without a budget, count is returned as it is.  At least multiple units
+     are returned, even if they don't fit; the allocation of their buffers
+     then reports the error.
+*****************************************************************************/
+int espa_mem_fit_count
+(
+    size_t unit_bytes,   /* I: bytes taken by each unit (ex. a line of the
+                               blocks, or the buffers of a thread) */
+    int count,           /* I: number of units wanted */
+    int multiple         /* I: the count is kept a multiple of this, and no
+                               smaller than it (ex. the lines of a chunk) */
+)
+{
+    long long available;         /* bytes left in the budget */
+    long long fit;               /* number of units which fit */
+
+    available = espa_mem_available ();
+    if (available < 0 || unit_bytes == 0 || count <= multiple)
+        return count;
+    if (multiple < 1)
+        multiple = 1;
+
+    fit = (long long) (available * ESPA_MEM_WORK_SHARE) / unit_bytes;
+    if (fit >= count)
+        return count;
+    fit = fit / multiple * multiple;
+
+    return fit > multiple ? (int) fit : multiple;
+}
+
+
+/******************************************************************************
+MODULE: espa_mem_cache_bytes
+
+PURPOSE: Caps the size of a cache at its share of the memory budget.
+
+RETURN VALUE:
+Type = size_t
+Value        Description
+-----        -----------
+cache_bytes  There is no budget, or the cache fits in its share
+other        ESPA_MEM_CACHE_SHARE of the budget
+
+NOTES:
+*****************************************************************************/
+size_t espa_mem_cache_bytes
+(
+    size_t cache_bytes   /* I: bytes the cache is configured to hold */
+)
+{
+    long long budget = espa_mem_budget ();  /* memory budget (bytes) */
+    size_t share;                /* bytes of the budget for the cache */
+
+    if (budget <= 0)
+        return cache_bytes;
+
+    share = (size_t) (budget * ESPA_MEM_CACHE_SHARE);
+    return cache_bytes < share ? cache_bytes : share;
+}
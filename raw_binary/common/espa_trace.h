@@ -0,0 +1,167 @@
+/*****************************************************************************
+FILE: espa_trace.h
+
+PURPOSE: Contains defines and prototypes for the optional timing trace,
+which records the wall time of the hot paths of the tools (metadata parsing
+and validation, the reads, conversions, and writes of each band, and the
+stages of the land/water mask) as spans and writes them out as a Chrome
+trace when the process exits, along with the allocation accounting of the
+image buffers.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The trace is turned on by setting ESPA_TRACE_ENV.  A value of yes (or
+     1) writes the trace to stderr; any other value is taken as the name of
+     the file to write the trace to.  The trace is in the Chrome trace event
+     format, which can be loaded into chrome://tracing or Perfetto, and is
+     plain JSON otherwise.
+  2. When the trace is off, beginning and ending a span only pays for a
+     single check of a cached flag.
+  3. ESPA_TRACE_SCOPE times the rest of the enclosing block, ending the span
+     however the block is left, including the early returns on errors.  It
+     relies on the cleanup attribute of gcc (and clang).  Spans which don't
+     line up with a block are timed with espa_trace_begin and
+     espa_trace_end.
+  4. The name of a span must be a string constant, since only the pointer is
+     kept.  The detail (ex. the band name) is copied when the span ends.
+  5. The image buffers of the libraries are allocated with espa_trace_malloc,
+     espa_trace_calloc, espa_trace_realloc, and espa_trace_posix_memalign,
+     and released with espa_trace_free.  While the trace is on (or a memory
+     budget is set), they account for the bytes allocated, and each span
+     reports the bytes allocated when it began and ended and the peak while
+     it was open.  The trace also has a counter of the allocated bytes over
+     time.
+  6. Setting ESPA_MEM_BUDGET_ENV to a number of megabytes (or calling
+     espa_mem_set_budget_mb) sets a memory budget for the accounted
+     allocations.  An allocation which would take them over the budget fails
+     as though the memory were exhausted, so the tool reports the error
+     rather than running past its budget.
+  7. The budget also sizes the work: espa_mem_fit_count gives the number of
+     lines per block (or of threads) whose buffers fit in
+     ESPA_MEM_WORK_SHARE of the memory left, and espa_mem_cache_bytes caps
+     each cache (the band cache, the remote reader, the NetCDF chunk cache)
+     at ESPA_MEM_CACHE_SHARE of the budget.  The band stack, the exporters,
+     and the VIIRS converter shrink their blocks and threads to fit, so a
+     job packed with a small budget runs slower rather than failing.
+  8. The bytes are taken from malloc_usable_size, so a buffer from the
+     wrappers which is released with a plain free can only leave the count
+     high; it never corrupts the heap.
+  9. Setting ESPA_PERF_ENV (see espa_perf_counters.h) as well adds the
+     hardware counters of the thread of each span to the trace, with its
+     instructions per cycle and bandwidth from memory.  The counters of each
+     thread are opened with its first span and left open.
+*****************************************************************************/
+
+#ifndef ESPA_TRACE_H
+#define ESPA_TRACE_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include "espa_perf_counters.h"
+
+/* Defines */
+#define ESPA_TRACE_ENV "ESPA_TRACE"   /* turns on the timing trace and names
+                                         where the trace is written */
+#define ESPA_MEM_BUDGET_ENV "ESPA_MEM_BUDGET_MB"  /* memory budget of the
+                                         accounted allocations (MB) */
+#define ESPA_MEM_WORK_SHARE 0.5       /* share of the memory left which the
+                                         blocks of a loop may take */
+#define ESPA_MEM_CACHE_SHARE 0.25     /* share of the budget which each cache
+                                         may take */
+
+/* Span being timed */
+typedef struct
+{
+    const char *name;            /* name of the span (string constant) */
+    const char *detail;          /* detail of the span, ex. the band or
+                                    file name; NULL if none */
+    double start;                /* start of the span (seconds); negative if
+                                    the trace is off or the span ended */
+    long long mem_start;         /* bytes allocated when the span began */
+    int slot;                    /* slot tracking the peak bytes of the
+                                    span; -1 if none */
+    Espa_perf_values_t perf_start;  /* hardware counters of the thread when
+                                    the span began; negative if not
+                                    counted */
+} Espa_trace_span_t;
+
+/* Times the rest of the enclosing block as the span named name.  Use it as
+   the last declaration of the block. */
+#define ESPA_TRACE_SCOPE(span, name, detail) \
+    Espa_trace_span_t span __attribute__ ((cleanup (espa_trace_end))) = \
+        espa_trace_begin (name, detail)
+
+/* Prototypes */
+bool espa_trace_enabled (void);
+
+Espa_trace_span_t espa_trace_begin
+(
+    const char *name,    /* I: name of the span (string constant) */
+    const char *detail   /* I: detail of the span; NULL if none */
+);
+
+void espa_trace_end
+(
+    Espa_trace_span_t *span  /* I/O: span to be ended; it is marked as ended
+                                     so it isn't recorded twice */
+);
+
+void *espa_trace_malloc
+(
+    size_t size          /* I: number of bytes to allocate */
+);
+
+void *espa_trace_calloc
+(
+    size_t nmemb,        /* I: number of elements to allocate */
+    size_t size          /* I: size of each element */
+);
+
+void *espa_trace_realloc
+(
+    void *ptr,           /* I: memory to be resized; NULL to allocate */
+    size_t size          /* I: new number of bytes */
+);
+
+int espa_trace_posix_memalign
+(
+    void **ptr,          /* O: allocated memory */
+    size_t alignment,    /* I: alignment of the memory (power of two) */
+    size_t size          /* I: number of bytes to allocate */
+);
+
+void espa_trace_free
+(
+    void *ptr            /* I: memory to be freed; may be NULL */
+);
+
+void espa_mem_set_budget_mb
+(
+    double budget_mb     /* I: memory budget (MB); 0 for none */
+);
+
+long long espa_mem_budget (void);
+
+long long espa_mem_available (void);
+
+int espa_mem_fit_count
+(
+    size_t unit_bytes,   /* I: bytes taken by each unit (ex. a line of the
+                               blocks, or the buffers of a thread) */
+    int count,           /* I: number of units wanted */
+    int multiple         /* I: the count is kept a multiple of this, and no
+                               smaller than it (ex. the lines of a chunk) */
+);
+
+size_t espa_mem_cache_bytes
+(
+    size_t cache_bytes   /* I: bytes the cache is configured to hold */
+);
+
+#endif
@@ -0,0 +1,501 @@
+/*****************************************************************************
+FILE: convert_envi_to_espa.c
+
+PURPOSE: Contains functions for ingesting an ENVI file into the ESPA internal
+format, mapping its bands directly where its layout allows, and writing the
+XML file for the product.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+*****************************************************************************/
+#include <ctype.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "convert_envi_to_espa.h"
+#include "convert_raw_binary_bip_to_espa.h"
+#include "espa_geoloc.h"
+
+/* ENVI byte order of this machine; 0 - Intel, 1 - network (IEEE) */
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define ENVI_HOST_BYTE_ORDER 1
+#else
+#define ENVI_HOST_BYTE_ORDER 0
+#endif
+
+
+/******************************************************************************
+MODULE:  envi_header_name
+
+PURPOSE: Finds the ENVI header of an ENVI image file.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           The header filename doesn't fit
+SUCCESS         Successfully found the header filename
+
+NOTES:
+  1. ENVI names the header by replacing the extension of the image with .hdr
+     (image.hdr) or by appending .hdr (image.img.hdr).  The first which
+     exists is used; if neither does, the replaced name is returned.
+******************************************************************************/
+int envi_header_name
+(
+    char *envi_file,       /* I: ENVI image filename */
+    char *hdr_file         /* O: ENVI header filename (STR_SIZE
+                                 characters) */
+)
+{
+    char FUNC_NAME[] = "envi_header_name";  /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    char *cptr = NULL;        /* pointer to the extension of the image */
+    char *slash = NULL;       /* pointer to the last directory separator */
+    int len;                  /* length of the image name to be kept */
+    int count;                /* number of chars copied in snprintf */
+
+    /* Appended */
+    count = snprintf (hdr_file, STR_SIZE, "%s.hdr", envi_file);
+    if (count < 0 || count >= STR_SIZE)
+    {
+        sprintf (errmsg, "Overflow of the header filename for %s",
+            envi_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    if (access (hdr_file, F_OK) == 0)
+        return (SUCCESS);
+
+    /* Replaced */
+    len = strlen (envi_file);
+    cptr = strrchr (envi_file, '.');
+    slash = strrchr (envi_file, '/');
+    if (cptr != NULL && (slash == NULL || cptr > slash))
+        len = cptr - envi_file;
+    snprintf (hdr_file, STR_SIZE, "%.*s.hdr", len, envi_file);
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  set_envi_projection
+
+PURPOSE: Sets the projection of the ESPA global metadata from the map info of
+the ENVI header.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. The projection parameters are laid out as in create_envi_struct.  The
+     corners are those of the outer edges of the image (UL grid origin).
+******************************************************************************/
+static void set_envi_projection
+(
+    Envi_header_t *hdr,         /* I: ENVI header information */
+    Espa_global_meta_t *gmeta   /* I/O: global metadata */
+)
+{
+    Espa_proj_meta_t *proj_info = &gmeta->proj_info;  /* projection info */
+
+    proj_info->proj_type = hdr->proj_type;
+    proj_info->datum_type = hdr->datum_type;
+    strcpy (proj_info->units, hdr->proj_type == GCTP_GEO_PROJ ? "degrees" :
+        "meters");
+    strcpy (proj_info->grid_origin, "UL");
+    proj_info->ul_corner[0] = hdr->ul_corner[0];
+    proj_info->ul_corner[1] = hdr->ul_corner[1];
+    proj_info->lr_corner[0] = hdr->ul_corner[0] +
+        hdr->nsamps * hdr->pixel_size[0];
+    proj_info->lr_corner[1] = hdr->ul_corner[1] -
+        hdr->nlines * hdr->pixel_size[1];
+
+    switch (hdr->proj_type)
+    {
+        case GCTP_UTM_PROJ:
+            proj_info->utm_zone = hdr->utm_zone;
+            break;
+
+        case GCTP_ALBERS_PROJ:
+            proj_info->standard_parallel1 = hdr->proj_parms[2];
+            proj_info->standard_parallel2 = hdr->proj_parms[3];
+            proj_info->central_meridian = hdr->proj_parms[4];
+            proj_info->origin_latitude = hdr->proj_parms[5];
+            proj_info->false_easting = hdr->proj_parms[6];
+            proj_info->false_northing = hdr->proj_parms[7];
+            break;
+
+        case GCTP_PS_PROJ:
+            proj_info->longitude_pole = hdr->proj_parms[4];
+            proj_info->latitude_true_scale = hdr->proj_parms[5];
+            proj_info->false_easting = hdr->proj_parms[6];
+            proj_info->false_northing = hdr->proj_parms[7];
+            break;
+
+        case GCTP_SIN_PROJ:
+            proj_info->sphere_radius = hdr->proj_parms[0];
+            proj_info->central_meridian = hdr->proj_parms[4];
+            proj_info->false_easting = hdr->proj_parms[6];
+            proj_info->false_northing = hdr->proj_parms[7];
+            break;
+    }
+
+    gmeta->orientation_angle = 0.0;
+}
+
+
+/******************************************************************************
+MODULE:  set_envi_bands
+
+PURPOSE: Sets the band metadata of the ESPA product from the ENVI header.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error setting the band metadata
+SUCCESS         Successfully set the band metadata
+
+NOTES:
+  1. Each band is named for its ENVI band name, with the characters other
+     than letters, digits, - and _ replaced by _, or band<n> if it has
+     none.  The ENVI band name is kept as the long name.
+  2. The file names are left to the caller.
+******************************************************************************/
+static int set_envi_bands
+(
+    Envi_header_t *hdr,         /* I: ENVI header information */
+    char *production_date,      /* I: production date of the bands */
+    Espa_internal_meta_t *xml_metadata  /* I/O: metadata with the bands
+                                                allocated */
+)
+{
+    char FUNC_NAME[] = "set_envi_bands";  /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    char *cptr = NULL;        /* pointer into the band name */
+    int i;                    /* looping variable for the bands */
+    int count;                /* number of chars copied in snprintf */
+    enum Espa_data_type data_type;  /* ESPA data type of the bands */
+    Espa_band_meta_t *bmeta;  /* metadata of the current band */
+
+    if (envi_to_espa_data_type (hdr->data_type, &data_type) != SUCCESS)
+    {
+        sprintf (errmsg, "Unsupported ENVI data type: %d", hdr->data_type);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    for (i = 0; i < xml_metadata->nbands; i++)
+    {
+        bmeta = &xml_metadata->band[i];
+        strcpy (bmeta->product, "envi");
+        strcpy (bmeta->short_name, "ENVI");
+        strcpy (bmeta->category, "image");
+        bmeta->data_type = data_type;
+        bmeta->nlines = hdr->nlines;
+        bmeta->nsamps = hdr->nsamps;
+        bmeta->fill_value = hdr->data_ignore_value;
+        bmeta->pixel_size[0] = hdr->pixel_size[0];
+        bmeta->pixel_size[1] = hdr->pixel_size[1];
+        strcpy (bmeta->pixel_units, hdr->proj_type == GCTP_GEO_PROJ ?
+            "degrees" : "meters");
+        bmeta->resample_method = ESPA_NN;
+
+        if (i < MAX_ENVI_BANDS && hdr->band_names[i][0] != '\0')
+        {
+            count = snprintf (bmeta->long_name, sizeof (bmeta->long_name),
+                "%s", hdr->band_names[i]);
+            snprintf (bmeta->name, sizeof (bmeta->name), "%s",
+                hdr->band_names[i]);
+            for (cptr = bmeta->name; *cptr != '\0'; cptr++)
+                if (!isalnum ((unsigned char) *cptr) && *cptr != '-' &&
+                    *cptr != '_')
+                    *cptr = '_';
+        }
+        else
+        {
+            count = snprintf (bmeta->long_name, sizeof (bmeta->long_name),
+                "band %d", i + 1);
+            snprintf (bmeta->name, sizeof (bmeta->name), "band%d", i + 1);
+        }
+        if (count < 0 || count >= sizeof (bmeta->long_name))
+        {
+            sprintf (errmsg, "Overflow of bmeta->long_name string");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+
+        count = snprintf (bmeta->app_version, sizeof (bmeta->app_version),
+            "convert_envi_to_espa_%s", ESPA_COMMON_VERSION);
+        if (count < 0 || count >= sizeof (bmeta->app_version))
+        {
+            sprintf (errmsg, "Overflow of bmeta->app_version string");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+        snprintf (bmeta->production_date, sizeof (bmeta->production_date),
+            "%s", production_date);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  set_envi_bounds
+
+PURPOSE: Sets the geographic corners and bounding coordinates of the ESPA
+product from its projection.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error computing the corners or bounds
+SUCCESS         Successfully set the corners and bounds
+
+NOTES:
+  1. Follows the bounds of the subset in espa_spatial_subset.
+******************************************************************************/
+static int set_envi_bounds
+(
+    Espa_internal_meta_t *xml_metadata  /* I/O: metadata of the product */
+)
+{
+    char FUNC_NAME[] = "set_envi_bounds";  /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    Espa_global_meta_t *gmeta = &xml_metadata->global;  /* global metadata */
+    Space_def_t geoloc_def;   /* grid of the product */
+    Geoloc_t *geoloc_map = NULL;  /* geolocation mapping information */
+    Geo_bounds_t bounds;      /* geographic bounds of the product */
+
+    if (!get_corner_coords (xml_metadata, gmeta->ul_corner, gmeta->lr_corner))
+    {
+        sprintf (errmsg, "Computing the geographic corners of the product");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    if (!get_geoloc_info (xml_metadata, &geoloc_def))
+    {
+        sprintf (errmsg, "Copying the geolocation information from the XML "
+            "metadata structure.");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    geoloc_map = setup_mapping (&geoloc_def);
+    if (geoloc_map == NULL)
+    {
+        sprintf (errmsg, "Setting up the geolocation mapping structure.");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    if (!compute_bounds (geoloc_map, geoloc_def.img_size.l,
+        geoloc_def.img_size.s, &bounds))
+    {
+        sprintf (errmsg, "Computing the bounding coordinates of the product");
+        error_handler (true, FUNC_NAME, errmsg);
+        free (geoloc_map);
+        return (ERROR);
+    }
+    gmeta->bounding_coords[ESPA_WEST] = bounds.min_lon;
+    gmeta->bounding_coords[ESPA_EAST] = bounds.max_lon;
+    gmeta->bounding_coords[ESPA_NORTH] = bounds.max_lat;
+    gmeta->bounding_coords[ESPA_SOUTH] = bounds.min_lat;
+
+    free (geoloc_map);
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  convert_envi_to_espa
+
+PURPOSE: Ingests an ENVI file into the ESPA internal format and writes the
+XML file for the product.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error ingesting the ENVI file
+SUCCESS         Successfully ingested the ENVI file
+
+NOTES:
+  1. The ENVI file is mapped when it is band sequential (or holds a single
+     band) in the byte order of this machine, unless copy_bands or pack is
+     set.
+     The bands then all name the ENVI file, each at its offset, and get no
+     ENVI header of their own since the ENVI file already has one.  The
+     file is named as given, so it should be given relative to the
+     directory of the XML file.
+  2. Otherwise the bands are written alongside the XML file, named for it
+     and the band, each with an ENVI header (see split_raw_binary_bands).
+  3. The header must have map info of a supported projection, since every
+     ESPA product is in a map projection.
+******************************************************************************/
+int convert_envi_to_espa
+(
+    char *envi_file,       /* I: input ENVI image filename */
+    char *template_xml,    /* I: ESPA XML metadata with the global metadata
+                                 of the product; NULL for none */
+    char *espa_xml_file,   /* I: output ESPA XML metadata filename */
+    char *production_date, /* I: production date of the bands */
+    bool copy_bands,       /* I: write each band to its own file even if
+                                 the ENVI file can be mapped? */
+    const Espa_pack_params_t *pack, /* I: packing of the float bands; NULL
+                                 to ingest them as floats */
+    bool del_src           /* I: should the ENVI file and its header be
+                                 removed once the bands are written?  Not
+                                 used for a mapped file. */
+)
+{
+    char FUNC_NAME[] = "convert_envi_to_espa";  /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    char hdr_file[STR_SIZE];  /* ENVI header filename */
+    int i;                    /* looping variable for the bands */
+    int count;                /* number of chars copied in snprintf */
+    int size;                 /* number of bytes per pixel */
+    int status = SUCCESS;     /* return status */
+    bool swap;                /* are the values in the other byte order? */
+    off_t band_bytes;         /* number of bytes in each band */
+    struct stat st;           /* status of the ENVI file */
+    Espa_interleave_t layout; /* layout of the bands in the ENVI file */
+    Envi_header_t *hdr = NULL;  /* ENVI header information */
+    Espa_internal_meta_t tmp_metadata;  /* metadata of the template */
+    Espa_internal_meta_t xml_metadata;  /* metadata of the product */
+
+    init_metadata_struct (&xml_metadata);
+
+    /* Read the ENVI header.  The structure is large, so it is allocated. */
+    hdr = malloc (sizeof (Envi_header_t));
+    if (hdr == NULL)
+    {
+        sprintf (errmsg, "Allocating the ENVI header structure");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    if (envi_header_name (envi_file, hdr_file) != SUCCESS ||
+        read_envi_hdr (hdr_file, hdr) != SUCCESS)
+    {  /* Error messages already written */
+        free (hdr);
+        return (ERROR);
+    }
+    if (!hdr->map_info)
+    {
+        sprintf (errmsg, "%s has no map info of a supported projection",
+            hdr_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        free (hdr);
+        return (ERROR);
+    }
+    if (!strcmp (hdr->interleave, "BIL"))
+        layout = ESPA_BIL_INTERLEAVE;
+    else if (!strcmp (hdr->interleave, "BIP"))
+        layout = ESPA_BIP_INTERLEAVE;
+    else
+        layout = ESPA_BSQ_INTERLEAVE;
+    if (hdr->nbands == 1)
+        layout = ESPA_BSQ_INTERLEAVE;
+
+    /* Take the global metadata from the template, if any */
+    if (template_xml != NULL)
+    {
+        init_metadata_struct (&tmp_metadata);
+        if (validate_and_parse_metadata (template_xml, &tmp_metadata)
+            != SUCCESS)
+        {  /* Error messages already written */
+            free (hdr);
+            return (ERROR);
+        }
+        xml_metadata.global = tmp_metadata.global;
+        free_metadata (&tmp_metadata);
+    }
+    else if (hdr->sensor_type[0] != '\0' &&
+        strcasecmp (hdr->sensor_type, "Unknown"))
+        snprintf (xml_metadata.global.instrument,
+            sizeof (xml_metadata.global.instrument), "%s", hdr->sensor_type);
+    set_envi_projection (hdr, &xml_metadata.global);
+
+    /* Set up the bands */
+    if (allocate_band_metadata (&xml_metadata, hdr->nbands) != SUCCESS)
+    {  /* Error messages already written */
+        free (hdr);
+        return (ERROR);
+    }
+    if (set_envi_bands (hdr, production_date, &xml_metadata) != SUCCESS ||
+        set_envi_bounds (&xml_metadata) != SUCCESS)
+    {  /* Error messages already written */
+        status = ERROR;
+        goto done;
+    }
+
+    /* Make sure the ENVI file holds the bands */
+    size = espa_data_type_size (xml_metadata.band[0].data_type);
+    band_bytes = (off_t) hdr->nlines * hdr->nsamps * size;
+    if (stat (envi_file, &st) != 0 ||
+        st.st_size < hdr->header_offset + band_bytes * hdr->nbands)
+    {
+        sprintf (errmsg, "%s is smaller than the %d bands of %d lines and "
+            "%d samples described by %s", envi_file, hdr->nbands,
+            hdr->nlines, hdr->nsamps, hdr_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        status = ERROR;
+        goto done;
+    }
+    swap = size > 1 && hdr->byte_order != ENVI_HOST_BYTE_ORDER;
+
+    if (copy_bands || pack != NULL || swap || layout != ESPA_BSQ_INTERLEAVE)
+    {
+        /* Write the bands to their own files */
+        printf ("Splitting %s into ESPA bands%s ...\n", envi_file,
+            swap ? ", swapping the bytes" : "");
+        status = split_raw_binary_bands (envi_file, hdr->header_offset,
+            swap, layout, &xml_metadata, espa_xml_file, pack, del_src);
+        goto done;
+    }
+
+    /* Map the bands onto the ENVI file */
+    printf ("Mapping the %d bands of %s as ESPA bands ...\n", hdr->nbands,
+        envi_file);
+    if (del_src)
+    {
+        sprintf (errmsg, "The bands of %s are mapped rather than copied, so "
+            "it is not removed", envi_file);
+        error_handler (false, FUNC_NAME, errmsg);
+    }
+    for (i = 0; i < xml_metadata.nbands; i++)
+    {
+        count = snprintf (xml_metadata.band[i].file_name,
+            sizeof (xml_metadata.band[i].file_name), "%s", envi_file);
+        if (count < 0 || count >= sizeof (xml_metadata.band[i].file_name))
+        {
+            sprintf (errmsg, "Overflow of file_name string");
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+            goto done;
+        }
+        xml_metadata.band[i].file_offset = hdr->header_offset +
+            band_bytes * i;
+    }
+
+    if (write_metadata (&xml_metadata, espa_xml_file) != SUCCESS)
+    {
+        sprintf (errmsg, "Error writing the XML for the ESPA product: %s",
+            espa_xml_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        status = ERROR;
+    }
+
+done:
+    free_metadata (&xml_metadata);
+    free (hdr);
+    return (status);
+}
@@ -0,0 +1,65 @@
+/*****************************************************************************
+FILE: convert_envi_to_espa.h
+
+PURPOSE: Contains prototypes for ingesting an ENVI file (raw binary image
+data with an ENVI .hdr header) into the ESPA internal format.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The header is read natively (see read_envi_hdr), so ENVI inputs don't
+     need to go through gdal_translate.
+  2. A file already laid out as ESPA bands (band sequential, or a single
+     band, in the byte order of this machine) is mapped directly: each ESPA
+     band points to its band in the ENVI file (see espa_file_stack.h), and
+     no pixels are copied.  Other files are split into one file per band,
+     with the bytes swapped and the bands de-interleaved by the vectorized
+     kernels (see split_raw_binary_bands).
+  3. The ENVI header only describes the image, so the global metadata of
+     the product (satellite, instrument, dates) may be taken from a
+     template ESPA XML file.  The projection, corners, and bounding
+     coordinates always come from the map info of the header.
+  4. Float bands may be packed into 16-bit integers as they are ingested
+     (see espa_cf_packing.h), in which case the bands are always copied.
+*****************************************************************************/
+
+#ifndef CONVERT_ENVI_TO_ESPA_H
+#define CONVERT_ENVI_TO_ESPA_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include "error_handler.h"
+#include "espa_metadata.h"
+#include "envi_header.h"
+#include "convert_raw_binary_bip_to_espa.h"
+
+/* Prototypes */
+int envi_header_name
+(
+    char *envi_file,       /* I: ENVI image filename */
+    char *hdr_file         /* O: ENVI header filename (STR_SIZE
+                                 characters) */
+);
+
+int convert_envi_to_espa
+(
+    char *envi_file,       /* I: input ENVI image filename */
+    char *template_xml,    /* I: ESPA XML metadata with the global metadata
+                                 of the product; NULL for none */
+    char *espa_xml_file,   /* I: output ESPA XML metadata filename */
+    char *production_date, /* I: production date of the bands */
+    bool copy_bands,       /* I: write each band to its own file even if
+                                 the ENVI file can be mapped? */
+    const Espa_pack_params_t *pack, /* I: packing of the float bands; NULL
+                                 to ingest them as floats */
+    bool del_src           /* I: should the ENVI file and its header be
+                                 removed once the bands are written?  Not
+                                 used for a mapped file. */
+);
+
+#endif
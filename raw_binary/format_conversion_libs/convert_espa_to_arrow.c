@@ -0,0 +1,1898 @@
+/*****************************************************************************
+FILE: convert_espa_to_arrow.c
+
+PURPOSE: Contains functions for creating an Apache Arrow IPC file (Feather
+version 2) from the ESPA raw binary bands, with a tensor column per band, for
+the data loaders of machine learning pipelines.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The XML metadata format read via this library follows the ESPA internal
+     metadata format found in ESPA Raw Binary Format v1.0.doc.  The schema for
+     the ESPA internal metadata format is available at
+     http://espa.cr.usgs.gov/schema/espa_internal_metadata_v1_0.xsd.
+  2. The file follows the Arrow IPC file format (version 5 of the metadata):
+     the ARROW1 magic, the schema message, a record batch message per block
+     of lines, the end of stream marker, and the footer locating the
+     batches.  The messages are flatbuffers, which are built here since the
+     metadata is small and fixed in form.
+  3. A band is a column of fixed-size lists of its pixels (a line, or a chip
+     of chip size lines by chip size samples), tagged as the
+     arrow.fixed_shape_tensor extension type.  The band attributes use the
+     names written by convert_espa_to_netcdf, and are the custom metadata of
+     the column.  The global attributes are the custom metadata of the
+     schema.
+  4. The rows also hold their position in the bands: the 0-based line for
+     lines, and the 0-based line and sample of the upper left pixel for
+     chips.
+  5. Only the bands on the grid of the first band are written, since every
+     row must hold the same pixels of each band (see espa_band_grids.h).
+  6. Lines of the bands are written straight from the blocks read by the
+     band stack, without copying them.
+*****************************************************************************/
+
+#include <unistd.h>
+#include <errno.h>
+#include <math.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include "convert_espa_to_arrow.h"
+#include "espa_trace.h"
+#include "espa_task_pool.h"
+#include "espa_cf_packing.h"
+#include "espa_band_grids.h"
+
+/* Version of the metadata (MetadataVersion V5) */
+#define ARROW_METADATA_V5 4
+
+/* Types of the message headers (MessageHeader union) */
+#define ARROW_HEADER_SCHEMA 1
+#define ARROW_HEADER_RECORD_BATCH 3
+
+/* Types of the fields (Type union) */
+#define ARROW_TYPE_INT 2
+#define ARROW_TYPE_FLOATING_POINT 3
+#define ARROW_TYPE_FIXED_SIZE_LIST 16
+
+/* Precisions of the floating point types */
+#define ARROW_PRECISION_SINGLE 1
+#define ARROW_PRECISION_DOUBLE 2
+
+/* Marker preceding each message, and the length of the magic at the start
+   of the file, padded to 8 bytes */
+#define ARROW_CONTINUATION 0xFFFFFFFF
+#define ARROW_MAGIC "ARROW1"
+#define ARROW_MAGIC_PADDED 8
+
+/* Most fields of a table built here (Field has the most) */
+#define ARROW_FB_MAX_FIELDS 8
+
+/* Flatbuffer, built back to front so the tables can refer to the strings,
+   vectors, and tables built before them */
+typedef struct
+{
+    unsigned char *buf;  /* bytes of the buffer; the flatbuffer is the last
+                            len bytes */
+    size_t size;         /* number of bytes allocated for buf */
+    size_t len;          /* number of bytes of the flatbuffer so far */
+    size_t min_align;    /* largest alignment of the values */
+    size_t fields[ARROW_FB_MAX_FIELDS];  /* len after each field of the
+                            current table; 0 for the fields not set */
+    int nfields;         /* number of fields of the current table */
+    size_t table_start;  /* len at the start of the current table */
+    bool failed;         /* did growing the buffer fail? */
+} Arrow_fb_t;
+
+/* Offsets of the tables of a vector, grown as they are built */
+typedef struct
+{
+    uint32_t *off;       /* offset of each table */
+    int n;               /* number of tables */
+    int size;            /* number of offsets allocated */
+    bool failed;         /* did growing the offsets fail? */
+} Arrow_offsets_t;
+
+/* Bands of the file, and the shape of its rows */
+typedef struct
+{
+    Espa_internal_meta_t *xml_metadata;  /* metadata of the product */
+    Arrow_options_t *options;  /* layout and batching of the rows */
+    int nbands;          /* number of bands in the file */
+    int *band_index;     /* index in the metadata of each band */
+    Espa_band_meta_t *vmeta;   /* metadata of the column of each band */
+    bool *unpack;        /* are the physical values of each band written? */
+    int nlines;          /* number of lines of the bands */
+    int nsamps;          /* number of samples of the bands */
+    int row_lines;       /* number of lines of a row */
+    int row_samps;       /* number of samples of a row */
+    int npos;            /* number of position columns (line, sample) */
+} Arrow_product_t;
+
+/* Values of a column for a record batch */
+typedef struct
+{
+    const void *data;    /* values of the column */
+    size_t nbytes;       /* number of bytes of the values */
+} Arrow_column_t;
+
+/* Arrow IPC file being written */
+typedef struct
+{
+    int fd;              /* file descriptor of the file */
+    off_t offset;        /* number of bytes written so far */
+    int nbatches;        /* number of record batches written */
+    int max_batches;     /* number of record batches allocated in blocks */
+    uint64_t *blocks;    /* offset, metadata length, and body length of each
+                            record batch, as the Block structs of the
+                            footer */
+} Arrow_file_t;
+
+/* Block of lines whose bands are cut into chips in parallel */
+typedef struct
+{
+    Arrow_product_t *prod;     /* bands of the file */
+    Espa_band_block_t *block;  /* block of lines of the bands */
+    void **values;       /* physical values of each band, or NULL for the
+                            pixels of the block */
+    void **chips;        /* chips of each band */
+} Arrow_chip_block_t;
+
+
+/******************************************************************************
+MODULE:  arrow_fb_reserve
+
+PURPOSE: Makes room for more bytes at the front of a flatbuffer.
+
+RETURN VALUE: None
+
+NOTES:
+  1. A failure to grow the buffer is recorded in fb->failed and checked
+     once the flatbuffer is finished.
+******************************************************************************/
+static void arrow_fb_reserve
+(
+    Arrow_fb_t *fb,      /* I/O: flatbuffer */
+    size_t n             /* I: number of bytes needed */
+)
+{
+    size_t size;         /* new number of bytes for the buffer */
+    unsigned char *buf;  /* grown buffer */
+
+    if (fb->failed || fb->size - fb->len >= n)
+        return;
+
+    size = fb->size * 2;
+    if (size < fb->len + n)
+        size = fb->len + n;
+    if (size < 1024)
+        size = 1024;
+    buf = malloc (size);
+    if (buf == NULL)
+    {
+        fb->failed = true;
+        return;
+    }
+    if (fb->len > 0)
+        memcpy (buf + size - fb->len, fb->buf + fb->size - fb->len, fb->len);
+    free (fb->buf);
+    fb->buf = buf;
+    fb->size = size;
+}
+
+
+/******************************************************************************
+MODULE:  arrow_fb_push
+
+PURPOSE: Adds bytes to the front of a flatbuffer.
+
+RETURN VALUE: None
+
+NOTES:
+  1. A NULL data adds zeros.
+******************************************************************************/
+static void arrow_fb_push
+(
+    Arrow_fb_t *fb,      /* I/O: flatbuffer */
+    const void *data,    /* I: bytes to be added; NULL for zeros */
+    size_t n             /* I: number of bytes */
+)
+{
+    arrow_fb_reserve (fb, n);
+    if (fb->failed)
+        return;
+    fb->len += n;
+    if (data == NULL)
+        memset (fb->buf + fb->size - fb->len, 0, n);
+    else
+        memcpy (fb->buf + fb->size - fb->len, data, n);
+}
+
+
+/******************************************************************************
+MODULE:  arrow_fb_push_le
+
+PURPOSE: Adds an integer to the front of a flatbuffer, in little endian byte
+order as flatbuffers are.
+
+RETURN VALUE: None
+
+NOTES:
+******************************************************************************/
+static void arrow_fb_push_le
+(
+    Arrow_fb_t *fb,      /* I/O: flatbuffer */
+    uint64_t value,      /* I: value to be added */
+    int nbytes           /* I: number of bytes of the value (1, 2, 4, or 8) */
+)
+{
+    unsigned char bytes[8];   /* bytes of the value */
+    int i;                    /* looping variable for the bytes */
+
+    for (i = 0; i < nbytes; i++)
+        bytes[i] = (value >> (8 * i)) & 0xff;
+    arrow_fb_push (fb, bytes, nbytes);
+}
+
+
+/******************************************************************************
+MODULE:  arrow_fb_align
+
+PURPOSE: Pads the front of a flatbuffer so the bytes added next end on the
+alignment.
+
+RETURN VALUE: None
+
+NOTES:
+  1. The alignment is counted from the end of the flatbuffer, which
+     arrow_fb_finish pads to the largest alignment used.
+******************************************************************************/
+static void arrow_fb_align
+(
+    Arrow_fb_t *fb,      /* I/O: flatbuffer */
+    size_t n,            /* I: number of bytes to be added next */
+    size_t align         /* I: alignment of those bytes */
+)
+{
+    if (align > fb->min_align)
+        fb->min_align = align;
+    arrow_fb_push (fb, NULL, (align - (fb->len + n) % align) % align);
+}
+
+
+/******************************************************************************
+MODULE:  arrow_fb_offset
+
+PURPOSE: Adds a reference to a string, vector, or table built earlier to the
+front of a flatbuffer.
+
+RETURN VALUE: None
+
+NOTES:
+******************************************************************************/
+static void arrow_fb_offset
+(
+    Arrow_fb_t *fb,      /* I/O: flatbuffer */
+    uint32_t off         /* I: offset of the string, vector, or table */
+)
+{
+    arrow_fb_align (fb, 4, 4);
+    arrow_fb_push_le (fb, fb->len + 4 - off, 4);
+}
+
+
+/******************************************************************************
+MODULE:  arrow_fb_string
+
+PURPOSE: Adds a string to a flatbuffer.
+
+RETURN VALUE:
+Type = uint32_t
+Value           Description
+-----           -----------
+n               Offset of the string
+
+NOTES:
+******************************************************************************/
+static uint32_t arrow_fb_string
+(
+    Arrow_fb_t *fb,      /* I/O: flatbuffer */
+    const char *str      /* I: string to be added */
+)
+{
+    size_t n = strlen (str);  /* number of characters of the string */
+
+    arrow_fb_align (fb, n + 1, 4);
+    arrow_fb_push (fb, str, n + 1);
+    arrow_fb_push_le (fb, n, 4);
+    return (fb->len);
+}
+
+
+/******************************************************************************
+MODULE:  arrow_fb_offset_vector
+
+PURPOSE: Adds a vector of tables built earlier to a flatbuffer.
+
+RETURN VALUE:
+Type = uint32_t
+Value           Description
+-----           -----------
+n               Offset of the vector
+
+NOTES:
+******************************************************************************/
+static uint32_t arrow_fb_offset_vector
+(
+    Arrow_fb_t *fb,      /* I/O: flatbuffer */
+    const uint32_t *off, /* I: offset of each table; may be NULL if n is 0 */
+    int n                /* I: number of tables */
+)
+{
+    int i;               /* looping variable for the tables */
+
+    arrow_fb_align (fb, (size_t) n * 4, 4);
+    for (i = n - 1; i >= 0; i--)
+        arrow_fb_offset (fb, off[i]);
+    arrow_fb_push_le (fb, n, 4);
+    return (fb->len);
+}
+
+
+/******************************************************************************
+MODULE:  arrow_fb_struct_vector
+
+PURPOSE: Adds a vector of structs made of 8-byte words (FieldNode, Buffer,
+and Block) to a flatbuffer.
+
+RETURN VALUE:
+Type = uint32_t
+Value           Description
+-----           -----------
+n               Offset of the vector
+
+NOTES:
+  1. The int field of a Block is followed by 4 bytes of padding, so it is
+     written as an 8-byte word as well.
+******************************************************************************/
+static uint32_t arrow_fb_struct_vector
+(
+    Arrow_fb_t *fb,      /* I/O: flatbuffer */
+    const uint64_t *words,  /* I: words of each struct */
+    int n,               /* I: number of structs */
+    int nwords           /* I: number of words of a struct */
+)
+{
+    long i;              /* looping variable for the words */
+
+    arrow_fb_align (fb, (size_t) n * nwords * 8, 8);
+    for (i = (long) n * nwords - 1; i >= 0; i--)
+        arrow_fb_push_le (fb, words[i], 8);
+    arrow_fb_push_le (fb, n, 4);
+    return (fb->len);
+}
+
+
+/******************************************************************************
+MODULE:  arrow_fb_start
+
+PURPOSE: Starts a table of a flatbuffer.  Its fields are added with
+arrow_fb_add_scalar and arrow_fb_add_offset, and it is finished with
+arrow_fb_end.
+
+RETURN VALUE: None
+
+NOTES:
+  1. Strings, vectors, and other tables can't be built while a table is
+     being built.
+******************************************************************************/
+static void arrow_fb_start
+(
+    Arrow_fb_t *fb       /* I/O: flatbuffer */
+)
+{
+    memset (fb->fields, 0, sizeof (fb->fields));
+    fb->nfields = 0;
+    fb->table_start = fb->len;
+}
+
+
+/******************************************************************************
+MODULE:  arrow_fb_add_scalar
+
+PURPOSE: Adds a scalar field to the current table of a flatbuffer.
+
+RETURN VALUE: None
+
+NOTES:
+******************************************************************************/
+static void arrow_fb_add_scalar
+(
+    Arrow_fb_t *fb,      /* I/O: flatbuffer */
+    int id,              /* I: 0-based field of the table */
+    uint64_t value,      /* I: value of the field */
+    int nbytes           /* I: number of bytes of the field */
+)
+{
+    arrow_fb_align (fb, nbytes, nbytes);
+    arrow_fb_push_le (fb, value, nbytes);
+    fb->fields[id] = fb->len;
+    if (id >= fb->nfields)
+        fb->nfields = id + 1;
+}
+
+
+/******************************************************************************
+MODULE:  arrow_fb_add_offset
+
+PURPOSE: Adds a string, vector, or table field to the current table of a
+flatbuffer.
+
+RETURN VALUE: None
+
+NOTES:
+******************************************************************************/
+static void arrow_fb_add_offset
+(
+    Arrow_fb_t *fb,      /* I/O: flatbuffer */
+    int id,              /* I: 0-based field of the table */
+    uint32_t off         /* I: offset of the string, vector, or table */
+)
+{
+    arrow_fb_offset (fb, off);
+    fb->fields[id] = fb->len;
+    if (id >= fb->nfields)
+        fb->nfields = id + 1;
+}
+
+
+/******************************************************************************
+MODULE:  arrow_fb_end
+
+PURPOSE: Finishes the current table of a flatbuffer, adding its vtable in
+front of it.
+
+RETURN VALUE:
+Type = uint32_t
+Value           Description
+-----           -----------
+n               Offset of the table
+
+NOTES:
+  1. Each table has its own vtable; they aren't shared.
+******************************************************************************/
+static uint32_t arrow_fb_end
+(
+    Arrow_fb_t *fb       /* I/O: flatbuffer */
+)
+{
+    size_t table;        /* len at the start of the table */
+    size_t vtable;       /* len at the start of the vtable */
+    uint32_t soffset;    /* offset from the vtable to the table */
+    int i;               /* looping variable for the fields */
+
+    /* Placeholder for the offset of the vtable */
+    arrow_fb_align (fb, 4, 4);
+    arrow_fb_push_le (fb, 0, 4);
+    table = fb->len;
+
+    for (i = fb->nfields - 1; i >= 0; i--)
+        arrow_fb_push_le (fb, fb->fields[i] == 0 ? 0 : table - fb->fields[i],
+            2);
+    arrow_fb_push_le (fb, table - fb->table_start, 2);
+    arrow_fb_push_le (fb, 4 + 2 * fb->nfields, 2);
+    vtable = fb->len;
+
+    if (!fb->failed)
+    {
+        soffset = vtable - table;
+        for (i = 0; i < 4; i++)
+            fb->buf[fb->size - table + i] = (soffset >> (8 * i)) & 0xff;
+    }
+    return (table);
+}
+
+
+/******************************************************************************
+MODULE:  arrow_fb_finish
+
+PURPOSE: Finishes a flatbuffer with the offset of its root table.
+
+RETURN VALUE:
+Type = const unsigned char *
+Value           Description
+-----           -----------
+NULL            Error growing the flatbuffer
+non-NULL        Start of the flatbuffer, which is fb->len bytes
+
+NOTES:
+******************************************************************************/
+static const unsigned char *arrow_fb_finish
+(
+    Arrow_fb_t *fb,      /* I/O: flatbuffer */
+    uint32_t root        /* I: offset of the root table */
+)
+{
+    arrow_fb_align (fb, 4, fb->min_align);
+    arrow_fb_offset (fb, root);
+    if (fb->failed)
+        return (NULL);
+    return (fb->buf + fb->size - fb->len);
+}
+
+
+/******************************************************************************
+MODULE:  arrow_fb_reset
+
+PURPOSE: Empties a flatbuffer, keeping its buffer for the next one.
+
+RETURN VALUE: None
+
+NOTES:
+******************************************************************************/
+static void arrow_fb_reset
+(
+    Arrow_fb_t *fb       /* I/O: flatbuffer */
+)
+{
+    fb->len = 0;
+    fb->min_align = 1;
+    fb->nfields = 0;
+}
+
+
+/******************************************************************************
+MODULE:  arrow_offsets_add
+
+PURPOSE: Adds the offset of a table to a vector of tables being gathered.
+
+RETURN VALUE: None
+
+NOTES:
+  1. A failure to grow the offsets is recorded in offsets->failed.
+******************************************************************************/
+static void arrow_offsets_add
+(
+    Arrow_offsets_t *offsets,  /* I/O: offsets of the tables */
+    uint32_t off               /* I: offset of the table */
+)
+{
+    uint32_t *grown;     /* grown offsets */
+    int size;            /* new number of offsets */
+
+    if (offsets->failed)
+        return;
+    if (offsets->n == offsets->size)
+    {
+        size = offsets->size == 0 ? 32 : offsets->size * 2;
+        grown = realloc (offsets->off, size * sizeof (uint32_t));
+        if (grown == NULL)
+        {
+            offsets->failed = true;
+            return;
+        }
+        offsets->off = grown;
+        offsets->size = size;
+    }
+    offsets->off[offsets->n++] = off;
+}
+
+
+/******************************************************************************
+MODULE:  arrow_kv_printf
+
+PURPOSE: Adds a KeyValue table of custom metadata, with a formatted value.
+
+RETURN VALUE: None
+
+NOTES:
+******************************************************************************/
+static void arrow_kv_printf
+(
+    Arrow_fb_t *fb,            /* I/O: flatbuffer */
+    Arrow_offsets_t *kvs,      /* I/O: KeyValue tables of the metadata */
+    const char *key,           /* I: key of the metadata */
+    const char *format,        /* I: printf format of the value */
+    ...                        /* I: values of the format */
+)
+{
+    va_list ap;                /* values of the format */
+    char value[STR_SIZE];      /* value of the metadata */
+    uint32_t key_off;          /* offset of the key */
+    uint32_t value_off;        /* offset of the value */
+
+    va_start (ap, format);
+    vsnprintf (value, sizeof (value), format, ap);
+    va_end (ap);
+
+    key_off = arrow_fb_string (fb, key);
+    value_off = arrow_fb_string (fb, value);
+    arrow_fb_start (fb);
+    arrow_fb_add_offset (fb, 0, key_off);
+    arrow_fb_add_offset (fb, 1, value_off);
+    arrow_offsets_add (kvs, arrow_fb_end (fb));
+}
+
+
+/******************************************************************************
+MODULE:  arrow_kv_text
+
+PURPOSE: Adds a KeyValue table of custom metadata, unless the string isn't
+defined in the metadata.
+
+RETURN VALUE: None
+
+NOTES:
+******************************************************************************/
+static void arrow_kv_text
+(
+    Arrow_fb_t *fb,            /* I/O: flatbuffer */
+    Arrow_offsets_t *kvs,      /* I/O: KeyValue tables of the metadata */
+    const char *key,           /* I: key of the metadata */
+    const char *value          /* I: value of the metadata */
+)
+{
+    if (value[0] == '\0' || !strcmp (value, ESPA_STRING_META_FILL))
+        return;
+    arrow_kv_printf (fb, kvs, key, "%s", value);
+}
+
+
+/******************************************************************************
+MODULE:  arrow_value_type
+
+PURPOSE: Adds the Int or FloatingPoint table of the type of the pixels of a
+band.
+
+RETURN VALUE:
+Type = uint32_t
+Value           Description
+-----           -----------
+n               Offset of the type table
+
+NOTES:
+  1. The data type must be supported (see arrow_type_supported).
+******************************************************************************/
+static uint32_t arrow_value_type
+(
+    Arrow_fb_t *fb,            /* I/O: flatbuffer */
+    enum Espa_data_type data_type,  /* I: ESPA data type of the pixels */
+    int *type_type             /* O: type of the table in the Type union */
+)
+{
+    arrow_fb_start (fb);
+    switch (data_type)
+    {
+        case ESPA_FLOAT32:
+        case ESPA_FLOAT64:
+            *type_type = ARROW_TYPE_FLOATING_POINT;
+            arrow_fb_add_scalar (fb, 0, data_type == ESPA_FLOAT32 ?
+                ARROW_PRECISION_SINGLE : ARROW_PRECISION_DOUBLE, 2);
+            break;
+
+        default:
+            *type_type = ARROW_TYPE_INT;
+            arrow_fb_add_scalar (fb, 0, 8 * espa_data_type_size (data_type),
+                4);
+            arrow_fb_add_scalar (fb, 1, data_type == ESPA_INT8 ||
+                data_type == ESPA_INT16 || data_type == ESPA_INT32, 1);
+            break;
+    }
+    return (arrow_fb_end (fb));
+}
+
+
+/******************************************************************************
+MODULE:  arrow_type_supported
+
+PURPOSE: Determines whether the pixels of a data type can be written.
+
+RETURN VALUE:
+Type = bool
+Value           Description
+-----           -----------
+true            The data type is supported
+false           The data type isn't supported
+
+NOTES:
+******************************************************************************/
+static bool arrow_type_supported
+(
+    enum Espa_data_type data_type  /* I: ESPA data type */
+)
+{
+    switch (data_type)
+    {
+        case ESPA_INT8:
+        case ESPA_UINT8:
+        case ESPA_INT16:
+        case ESPA_UINT16:
+        case ESPA_INT32:
+        case ESPA_UINT32:
+        case ESPA_FLOAT32:
+        case ESPA_FLOAT64:
+            return (true);
+        default:
+            return (false);
+    }
+}
+
+
+/******************************************************************************
+MODULE:  arrow_position_field
+
+PURPOSE: Adds the Field table of a position column of the rows.
+
+RETURN VALUE:
+Type = uint32_t
+Value           Description
+-----           -----------
+n               Offset of the Field table
+
+NOTES:
+******************************************************************************/
+static uint32_t arrow_position_field
+(
+    Arrow_fb_t *fb,            /* I/O: flatbuffer */
+    const char *name           /* I: name of the column */
+)
+{
+    uint32_t name_off;         /* offset of the name */
+    uint32_t type_off;         /* offset of the type */
+    uint32_t children_off;     /* offset of the children */
+    int type_type;             /* type of the type table */
+
+    name_off = arrow_fb_string (fb, name);
+    type_off = arrow_value_type (fb, ESPA_INT32, &type_type);
+    children_off = arrow_fb_offset_vector (fb, NULL, 0);
+
+    arrow_fb_start (fb);
+    arrow_fb_add_offset (fb, 0, name_off);
+    arrow_fb_add_scalar (fb, 1, false, 1);
+    arrow_fb_add_scalar (fb, 2, type_type, 1);
+    arrow_fb_add_offset (fb, 3, type_off);
+    arrow_fb_add_offset (fb, 5, children_off);
+    return (arrow_fb_end (fb));
+}
+
+
+/******************************************************************************
+MODULE:  arrow_band_field
+
+PURPOSE: Adds the Field table of the column of a band, a fixed-size list of
+its pixels tagged as a fixed shape tensor, with the band attributes as its
+custom metadata.
+
+RETURN VALUE:
+Type = uint32_t
+Value           Description
+-----           -----------
+n               Offset of the Field table
+
+NOTES:
+******************************************************************************/
+static uint32_t arrow_band_field
+(
+    Arrow_fb_t *fb,            /* I/O: flatbuffer */
+    Arrow_offsets_t *kvs,      /* I/O: KeyValue tables; emptied here */
+    Arrow_product_t *prod,     /* I: bands of the file */
+    int band                   /* I: band of the file */
+)
+{
+    Espa_band_meta_t *vmeta = &prod->vmeta[band];  /* band metadata */
+    uint32_t name_off;         /* offset of the name */
+    uint32_t type_off;         /* offset of the type */
+    uint32_t item_off;         /* offset of the field of the items */
+    uint32_t children_off;     /* offset of the children */
+    uint32_t meta_off;         /* offset of the custom metadata */
+    int type_type;             /* type of the type table */
+
+    /* Items of the list, the pixels */
+    name_off = arrow_fb_string (fb, "item");
+    type_off = arrow_value_type (fb, vmeta->data_type, &type_type);
+    children_off = arrow_fb_offset_vector (fb, NULL, 0);
+    arrow_fb_start (fb);
+    arrow_fb_add_offset (fb, 0, name_off);
+    arrow_fb_add_scalar (fb, 1, false, 1);
+    arrow_fb_add_scalar (fb, 2, type_type, 1);
+    arrow_fb_add_offset (fb, 3, type_off);
+    arrow_fb_add_offset (fb, 5, children_off);
+    item_off = arrow_fb_end (fb);
+
+    /* Extension type and band attributes */
+    kvs->n = 0;
+    arrow_kv_printf (fb, kvs, "ARROW:extension:name",
+        "arrow.fixed_shape_tensor");
+    if (prod->row_lines == 1)
+        arrow_kv_printf (fb, kvs, "ARROW:extension:metadata",
+            "{\"shape\":[%d],\"dim_names\":[\"x\"]}", prod->row_samps);
+    else
+        arrow_kv_printf (fb, kvs, "ARROW:extension:metadata",
+            "{\"shape\":[%d,%d],\"dim_names\":[\"y\",\"x\"]}",
+            prod->row_lines, prod->row_samps);
+    arrow_kv_text (fb, kvs, "long_name", vmeta->long_name);
+    arrow_kv_text (fb, kvs, "units", vmeta->data_units);
+    arrow_kv_text (fb, kvs, "product", vmeta->product);
+    arrow_kv_text (fb, kvs, "source", vmeta->source);
+    arrow_kv_text (fb, kvs, "category", vmeta->category);
+    if (vmeta->fill_value != ESPA_INT_META_FILL)
+        arrow_kv_printf (fb, kvs, "_FillValue", "%ld", vmeta->fill_value);
+    if (fabs (vmeta->valid_range[0] - ESPA_FLOAT_META_FILL) > ESPA_EPSILON &&
+        fabs (vmeta->valid_range[1] - ESPA_FLOAT_META_FILL) > ESPA_EPSILON)
+        arrow_kv_printf (fb, kvs, "valid_range", "[%.15g, %.15g]",
+            vmeta->valid_range[0], vmeta->valid_range[1]);
+    if (vmeta->saturate_value != ESPA_INT_META_FILL)
+        arrow_kv_printf (fb, kvs, "_SaturateValue", "%d",
+            vmeta->saturate_value);
+    if (fabs (vmeta->scale_factor - ESPA_FLOAT_META_FILL) > ESPA_EPSILON)
+        arrow_kv_printf (fb, kvs, "scale_factor", "%.9g",
+            vmeta->scale_factor);
+    if (fabs (vmeta->add_offset - ESPA_FLOAT_META_FILL) > ESPA_EPSILON)
+        arrow_kv_printf (fb, kvs, "add_offset", "%.9g", vmeta->add_offset);
+    arrow_kv_printf (fb, kvs, "pixel_size", "[%.15g, %.15g]",
+        vmeta->pixel_size[0], vmeta->pixel_size[1]);
+    arrow_kv_text (fb, kvs, "pixel_units", vmeta->pixel_units);
+    arrow_kv_text (fb, kvs, "app_version", vmeta->app_version);
+    arrow_kv_text (fb, kvs, "production_date", vmeta->production_date);
+    meta_off = arrow_fb_offset_vector (fb, kvs->off, kvs->n);
+
+    /* Fixed-size list of the pixels of a row */
+    name_off = arrow_fb_string (fb, vmeta->name);
+    arrow_fb_start (fb);
+    arrow_fb_add_scalar (fb, 0, prod->row_lines * prod->row_samps, 4);
+    type_off = arrow_fb_end (fb);
+    children_off = arrow_fb_offset_vector (fb, &item_off, 1);
+    arrow_fb_start (fb);
+    arrow_fb_add_offset (fb, 0, name_off);
+    arrow_fb_add_scalar (fb, 1, false, 1);
+    arrow_fb_add_scalar (fb, 2, ARROW_TYPE_FIXED_SIZE_LIST, 1);
+    arrow_fb_add_offset (fb, 3, type_off);
+    arrow_fb_add_offset (fb, 5, children_off);
+    arrow_fb_add_offset (fb, 6, meta_off);
+    return (arrow_fb_end (fb));
+}
+
+
+/******************************************************************************
+MODULE:  arrow_schema
+
+PURPOSE: Adds the Schema table of the file, with the global attributes as its
+custom metadata.
+
+RETURN VALUE:
+Type = uint32_t
+Value           Description
+-----           -----------
+n               Offset of the Schema table
+
+NOTES:
+  1. The schema is in the schema message and again in the footer, so it is
+     built for each.
+  2. A failure to gather the tables is recorded in fb->failed.
+******************************************************************************/
+static uint32_t arrow_schema
+(
+    Arrow_fb_t *fb,            /* I/O: flatbuffer */
+    Arrow_product_t *prod      /* I: bands of the file */
+)
+{
+    Espa_global_meta_t *gmeta = &prod->xml_metadata->global;
+                               /* global metadata */
+    Espa_proj_meta_t *proj = &gmeta->proj_info;
+                               /* projection information */
+    Arrow_offsets_t fields = {NULL, 0, 0, false};  /* Field tables */
+    Arrow_offsets_t kvs = {NULL, 0, 0, false};     /* KeyValue tables */
+    uint32_t fields_off;       /* offset of the fields */
+    uint32_t meta_off;         /* offset of the custom metadata */
+    int i;                     /* looping variable for the bands */
+
+    arrow_offsets_add (&fields, arrow_position_field (fb, "line"));
+    if (prod->npos > 1)
+        arrow_offsets_add (&fields, arrow_position_field (fb, "sample"));
+    for (i = 0; i < prod->nbands; i++)
+        arrow_offsets_add (&fields, arrow_band_field (fb, &kvs, prod, i));
+    fields_off = arrow_fb_offset_vector (fb, fields.off, fields.n);
+
+    kvs.n = 0;
+    arrow_kv_printf (fb, &kvs, "layout", "%s",
+        prod->row_lines == 1 ? "lines" : "chips");
+    arrow_kv_printf (fb, &kvs, "nlines", "%d", prod->nlines);
+    arrow_kv_printf (fb, &kvs, "nsamps", "%d", prod->nsamps);
+    if (prod->row_lines > 1)
+        arrow_kv_printf (fb, &kvs, "chip_size", "%d", prod->row_lines);
+    arrow_kv_text (fb, &kvs, "DataProvider", gmeta->data_provider);
+    arrow_kv_text (fb, &kvs, "Satellite", gmeta->satellite);
+    arrow_kv_text (fb, &kvs, "Instrument", gmeta->instrument);
+    arrow_kv_text (fb, &kvs, "AcquisitionDate", gmeta->acquisition_date);
+    arrow_kv_text (fb, &kvs, "SceneCenterTime", gmeta->scene_center_time);
+    arrow_kv_text (fb, &kvs, "ProductID", gmeta->product_id);
+    if (fabs (gmeta->solar_zenith - ESPA_FLOAT_META_FILL) > ESPA_EPSILON)
+        arrow_kv_printf (fb, &kvs, "SolarZenith", "%.9g",
+            gmeta->solar_zenith);
+    if (fabs (gmeta->solar_azimuth - ESPA_FLOAT_META_FILL) > ESPA_EPSILON)
+        arrow_kv_printf (fb, &kvs, "SolarAzimuth", "%.9g",
+            gmeta->solar_azimuth);
+    if (gmeta->wrs_path != ESPA_INT_META_FILL)
+        arrow_kv_printf (fb, &kvs, "WRS_Path", "%d", gmeta->wrs_path);
+    if (gmeta->wrs_row != ESPA_INT_META_FILL)
+        arrow_kv_printf (fb, &kvs, "WRS_Row", "%d", gmeta->wrs_row);
+    arrow_kv_printf (fb, &kvs, "ProjectionType", "%d", proj->proj_type);
+    arrow_kv_printf (fb, &kvs, "DatumType", "%d", proj->datum_type);
+    arrow_kv_printf (fb, &kvs, "UpperLeftProjectionCorner",
+        "[%.15g, %.15g]", proj->ul_corner[0], proj->ul_corner[1]);
+    arrow_kv_printf (fb, &kvs, "LowerRightProjectionCorner",
+        "[%.15g, %.15g]", proj->lr_corner[0], proj->lr_corner[1]);
+    arrow_kv_text (fb, &kvs, "ProjectionUnits", proj->units);
+    arrow_kv_text (fb, &kvs, "GridOrigin", proj->grid_origin);
+    if (proj->utm_zone != ESPA_INT_META_FILL)
+        arrow_kv_printf (fb, &kvs, "UTMZone", "%d", proj->utm_zone);
+    meta_off = arrow_fb_offset_vector (fb, kvs.off, kvs.n);
+
+    if (fields.failed || kvs.failed)
+        fb->failed = true;
+    free (fields.off);
+    free (kvs.off);
+
+    arrow_fb_start (fb);
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    arrow_fb_add_scalar (fb, 0, 1, 2);
+#else
+    arrow_fb_add_scalar (fb, 0, 0, 2);
+#endif
+    arrow_fb_add_offset (fb, 1, fields_off);
+    arrow_fb_add_offset (fb, 2, meta_off);
+    return (arrow_fb_end (fb));
+}
+
+
+/******************************************************************************
+MODULE:  arrow_message
+
+PURPOSE: Adds the Message table of a message and finishes the flatbuffer.
+
+RETURN VALUE:
+Type = const unsigned char *
+Value           Description
+-----           -----------
+NULL            Error growing the flatbuffer
+non-NULL        Start of the flatbuffer, which is fb->len bytes
+
+NOTES:
+******************************************************************************/
+static const unsigned char *arrow_message
+(
+    Arrow_fb_t *fb,            /* I/O: flatbuffer */
+    int header_type,           /* I: type of the header table */
+    uint32_t header_off,       /* I: offset of the header table */
+    size_t body_len            /* I: number of bytes of the body */
+)
+{
+    arrow_fb_start (fb);
+    arrow_fb_add_scalar (fb, 3, body_len, 8);
+    arrow_fb_add_offset (fb, 2, header_off);
+    arrow_fb_add_scalar (fb, 0, ARROW_METADATA_V5, 2);
+    arrow_fb_add_scalar (fb, 1, header_type, 1);
+    return (arrow_fb_finish (fb, arrow_fb_end (fb)));
+}
+
+
+/******************************************************************************
+MODULE:  write_arrow_bytes
+
+PURPOSE: Writes bytes at the end of the Arrow file.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the bytes
+SUCCESS         Successfully wrote the bytes
+
+NOTES:
+  1. Padding is skipped over rather than written; it reads as zeros.
+******************************************************************************/
+static int write_arrow_bytes
+(
+    Arrow_file_t *afile,       /* I/O: Arrow file */
+    const void *data,          /* I: bytes to be written */
+    size_t nbytes,             /* I: number of bytes */
+    size_t padded              /* I: number of bytes taken in the file, at
+                                     least nbytes */
+)
+{
+    if (nbytes > 0 && pio_raw_binary (afile->fd, true, (void *) data,
+        nbytes, afile->offset) != SUCCESS)
+        return (ERROR);
+    afile->offset += padded;
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  write_arrow_message
+
+PURPOSE: Writes the metadata of a message, preceded by the continuation
+marker and its length, and padded so the body of the message starts on
+ARROW_ALIGNMENT bytes.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the message
+SUCCESS         Successfully wrote the message
+
+NOTES:
+******************************************************************************/
+static int write_arrow_message
+(
+    Arrow_file_t *afile,       /* I/O: Arrow file */
+    const unsigned char *meta, /* I: flatbuffer of the message */
+    size_t meta_len,           /* I: number of bytes of the flatbuffer */
+    size_t *block_len          /* O: number of bytes of the metadata of the
+                                     message, with the prefix and padding */
+)
+{
+    unsigned char prefix[8];   /* continuation marker and length */
+    size_t padded;             /* length of the padded flatbuffer */
+    int i;                     /* looping variable for the bytes */
+
+    padded = (afile->offset + 8 + meta_len + ARROW_ALIGNMENT - 1)
+        / ARROW_ALIGNMENT * ARROW_ALIGNMENT - afile->offset - 8;
+    for (i = 0; i < 4; i++)
+    {
+        prefix[i] = (ARROW_CONTINUATION >> (8 * i)) & 0xff;
+        prefix[4 + i] = (padded >> (8 * i)) & 0xff;
+    }
+    if (write_arrow_bytes (afile, prefix, 8, 8) != SUCCESS ||
+        write_arrow_bytes (afile, meta, meta_len, padded) != SUCCESS)
+        return (ERROR);
+    *block_len = 8 + padded;
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  write_arrow_batch
+
+PURPOSE: Writes a record batch of rows to the Arrow file.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the record batch
+SUCCESS         Successfully wrote the record batch
+
+NOTES:
+  1. The columns have no nulls, so their validity buffers are empty.
+  2. Each buffer of the body starts on ARROW_ALIGNMENT bytes.
+******************************************************************************/
+static int write_arrow_batch
+(
+    Arrow_file_t *afile,       /* I/O: Arrow file */
+    Arrow_fb_t *fb,            /* I/O: flatbuffer for the message */
+    Arrow_product_t *prod,     /* I: bands of the file */
+    int nrows,                 /* I: number of rows of the batch */
+    const Arrow_column_t *cols /* I: values of each column, the position
+                                     columns then the bands */
+)
+{
+    int ncols = prod->npos + prod->nbands;  /* number of columns */
+    int nnodes = 0;            /* number of field nodes */
+    int nbufs = 0;             /* number of buffers */
+    int i;                     /* looping variable for the columns */
+    uint64_t *nodes = NULL;    /* length and null count of each node */
+    uint64_t *bufs = NULL;     /* offset and length of each buffer */
+    uint64_t *blocks = NULL;   /* grown record batch blocks */
+    size_t body_len = 0;       /* number of bytes of the body */
+    size_t padded;             /* number of bytes of a padded buffer */
+    size_t block_len;          /* number of bytes of the metadata */
+    uint32_t nodes_off;        /* offset of the nodes */
+    uint32_t bufs_off;         /* offset of the buffers */
+    uint32_t batch_off;        /* offset of the RecordBatch table */
+    const unsigned char *meta; /* flatbuffer of the message */
+    off_t offset;              /* offset of the message in the file */
+    int status = ERROR;        /* return status */
+
+    nodes = malloc ((size_t) 2 * ncols * 2 * sizeof (uint64_t));
+    bufs = malloc ((size_t) 3 * ncols * 2 * sizeof (uint64_t));
+    if (nodes == NULL || bufs == NULL)
+        goto cleanup;
+
+    for (i = 0; i < ncols; i++)
+    {
+        nodes[2 * nnodes] = nrows;
+        nodes[2 * nnodes++ + 1] = 0;
+        bufs[2 * nbufs] = body_len;
+        bufs[2 * nbufs++ + 1] = 0;
+        if (i >= prod->npos)
+        {
+            /* Pixels of the lists */
+            nodes[2 * nnodes] = (uint64_t) nrows * prod->row_lines
+                * prod->row_samps;
+            nodes[2 * nnodes++ + 1] = 0;
+            bufs[2 * nbufs] = body_len;
+            bufs[2 * nbufs++ + 1] = 0;
+        }
+        bufs[2 * nbufs] = body_len;
+        bufs[2 * nbufs++ + 1] = cols[i].nbytes;
+        body_len += (cols[i].nbytes + ARROW_ALIGNMENT - 1) / ARROW_ALIGNMENT
+            * ARROW_ALIGNMENT;
+    }
+
+    arrow_fb_reset (fb);
+    nodes_off = arrow_fb_struct_vector (fb, nodes, nnodes, 2);
+    bufs_off = arrow_fb_struct_vector (fb, bufs, nbufs, 2);
+    arrow_fb_start (fb);
+    arrow_fb_add_scalar (fb, 0, nrows, 8);
+    arrow_fb_add_offset (fb, 1, nodes_off);
+    arrow_fb_add_offset (fb, 2, bufs_off);
+    batch_off = arrow_fb_end (fb);
+    meta = arrow_message (fb, ARROW_HEADER_RECORD_BATCH, batch_off,
+        body_len);
+    if (meta == NULL)
+        goto cleanup;
+
+    offset = afile->offset;
+    if (write_arrow_message (afile, meta, fb->len, &block_len) != SUCCESS)
+        goto cleanup;
+    for (i = 0; i < ncols; i++)
+    {
+        padded = (cols[i].nbytes + ARROW_ALIGNMENT - 1) / ARROW_ALIGNMENT
+            * ARROW_ALIGNMENT;
+        if (write_arrow_bytes (afile, cols[i].data, cols[i].nbytes, padded)
+            != SUCCESS)
+            goto cleanup;
+    }
+
+    /* Block of the footer */
+    if (afile->nbatches == afile->max_batches)
+    {
+        afile->max_batches = afile->max_batches == 0 ? 64
+            : afile->max_batches * 2;
+        blocks = realloc (afile->blocks, (size_t) afile->max_batches * 3
+            * sizeof (uint64_t));
+        if (blocks == NULL)
+            goto cleanup;
+        afile->blocks = blocks;
+    }
+    afile->blocks[3 * afile->nbatches] = offset;
+    afile->blocks[3 * afile->nbatches + 1] = block_len;
+    afile->blocks[3 * afile->nbatches + 2] = body_len;
+    afile->nbatches++;
+    status = SUCCESS;
+
+cleanup:
+    free (nodes);
+    free (bufs);
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  write_arrow_footer
+
+PURPOSE: Writes the end of stream marker, the footer, and the closing magic
+of the Arrow file.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the footer
+SUCCESS         Successfully wrote the footer
+
+NOTES:
+******************************************************************************/
+static int write_arrow_footer
+(
+    Arrow_file_t *afile,       /* I/O: Arrow file */
+    Arrow_fb_t *fb,            /* I/O: flatbuffer for the footer */
+    Arrow_product_t *prod      /* I: bands of the file */
+)
+{
+    unsigned char tail[8 + ARROW_MAGIC_PADDED];  /* end of stream marker,
+                                  or footer length and closing magic */
+    uint32_t schema_off;       /* offset of the schema */
+    uint32_t dicts_off;        /* offset of the dictionary blocks */
+    uint32_t batches_off;      /* offset of the record batch blocks */
+    const unsigned char *meta; /* flatbuffer of the footer */
+    int i;                     /* looping variable for the bytes */
+
+    memset (tail, 0, sizeof (tail));
+    for (i = 0; i < 4; i++)
+        tail[i] = (ARROW_CONTINUATION >> (8 * i)) & 0xff;
+    if (write_arrow_bytes (afile, tail, 8, 8) != SUCCESS)
+        return (ERROR);
+
+    arrow_fb_reset (fb);
+    schema_off = arrow_schema (fb, prod);
+    dicts_off = arrow_fb_struct_vector (fb, NULL, 0, 3);
+    batches_off = arrow_fb_struct_vector (fb, afile->blocks, afile->nbatches,
+        3);
+    arrow_fb_start (fb);
+    arrow_fb_add_offset (fb, 1, schema_off);
+    arrow_fb_add_offset (fb, 2, dicts_off);
+    arrow_fb_add_offset (fb, 3, batches_off);
+    arrow_fb_add_scalar (fb, 0, ARROW_METADATA_V5, 2);
+    meta = arrow_fb_finish (fb, arrow_fb_end (fb));
+    if (meta == NULL)
+        return (ERROR);
+
+    for (i = 0; i < 4; i++)
+        tail[i] = (fb->len >> (8 * i)) & 0xff;
+    memcpy (&tail[4], ARROW_MAGIC, strlen (ARROW_MAGIC));
+    if (write_arrow_bytes (afile, meta, fb->len, fb->len) != SUCCESS ||
+        write_arrow_bytes (afile, tail, 4 + strlen (ARROW_MAGIC),
+        4 + strlen (ARROW_MAGIC)) != SUCCESS)
+        return (ERROR);
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  arrow_fill_pixel
+
+PURPOSE: Determines the pixel which pads the chips of a band beyond its
+edges.
+
+RETURN VALUE: None
+
+NOTES:
+  1. The pad is the fill value of the band, NaN for float bands without
+     one (including the physical values), or 0.
+******************************************************************************/
+static void arrow_fill_pixel
+(
+    Espa_band_meta_t *vmeta,   /* I: metadata of the column of the band */
+    void *pixel                /* O: pad pixel; 8 bytes */
+)
+{
+    double value = 0.0;        /* value of the pad pixel */
+
+    if (vmeta->fill_value != ESPA_INT_META_FILL)
+        value = vmeta->fill_value;
+    else if (vmeta->data_type == ESPA_FLOAT32 ||
+        vmeta->data_type == ESPA_FLOAT64)
+        value = NAN;
+
+    switch (vmeta->data_type)
+    {
+        case ESPA_INT8: *(int8_t *) pixel = value; break;
+        case ESPA_UINT8: *(uint8_t *) pixel = value; break;
+        case ESPA_INT16: *(int16_t *) pixel = value; break;
+        case ESPA_UINT16: *(uint16_t *) pixel = value; break;
+        case ESPA_INT32: *(int32_t *) pixel = value; break;
+        case ESPA_UINT32: *(uint32_t *) pixel = value; break;
+        case ESPA_FLOAT32: *(float *) pixel = value; break;
+        default: *(double *) pixel = value; break;
+    }
+}
+
+
+/******************************************************************************
+MODULE:  cut_arrow_band_chips
+
+PURPOSE: Cuts a block of lines of a band into its row of chips, padding the
+chips beyond the edges of the band.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+SUCCESS         Successfully cut the chips
+
+NOTES:
+  1. Run by espa_parallel_for for each band of the block.
+******************************************************************************/
+static int cut_arrow_band_chips
+(
+    void *arg,                 /* I/O: block of lines of the bands */
+    int band,                  /* I: band of the file */
+    int worker                 /* I: worker cutting the chips */
+)
+{
+    Arrow_chip_block_t *blk = arg;  /* block of lines of the bands */
+    Arrow_product_t *prod = blk->prod;  /* bands of the file */
+    int chip = prod->row_lines;     /* number of lines and samples of a
+                                       chip */
+    int ncols;                 /* number of chips across the band */
+    int nrows;                 /* number of rows of chips in the block */
+    int row;                   /* looping variable for the rows of chips */
+    int col;                   /* looping variable for the chips across */
+    int line;                  /* looping variable for the chip lines */
+    int samp;                  /* looping variable for the pad samples */
+    int width;                 /* number of samples of a chip in the band */
+    int src_line;              /* line of the chip in the block */
+    int size;                  /* number of bytes per pixel */
+    unsigned char pixel[8];    /* pad pixel */
+    const unsigned char *src;  /* lines of the band */
+    unsigned char *dst;        /* current chip line */
+
+    size = espa_data_type_size (prod->vmeta[band].data_type);
+    arrow_fill_pixel (&prod->vmeta[band], pixel);
+    ncols = (prod->nsamps + chip - 1) / chip;
+    nrows = (blk->block->nlines + chip - 1) / chip;
+    src = blk->values[band] != NULL ? blk->values[band]
+        : blk->block->band_buf[band];
+    dst = blk->chips[band];
+
+    for (row = 0; row < nrows; row++)
+    {
+        for (col = 0; col < ncols; col++)
+        {
+            width = prod->nsamps - col * chip;
+            if (width > chip)
+                width = chip;
+            for (line = 0; line < chip; line++)
+            {
+                src_line = row * chip + line;
+                if (src_line < blk->block->nlines)
+                {
+                    memcpy (dst, src + ((size_t) src_line * prod->nsamps
+                        + (size_t) col * chip) * size, (size_t) width
+                        * size);
+                    samp = width;
+                }
+                else
+                    samp = 0;
+                for ( ; samp < chip; samp++)
+                    memcpy (dst + (size_t) samp * size, pixel, size);
+                dst += (size_t) chip * size;
+            }
+        }
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  write_arrow_bands
+
+PURPOSE: Writes the record batches of the bands to the Arrow file, a block of
+lines at a time.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error reading the bands or writing the record batches
+SUCCESS         Successfully wrote the record batches
+
+NOTES:
+  1. For lines, the pixels of the block read by the band stack are the
+     buffers of the batch as they are; only the physical values are
+     computed.  For chips, the bands of the block are cut into chips in
+     parallel.
+******************************************************************************/
+static int write_arrow_bands
+(
+    Arrow_file_t *afile,       /* I/O: Arrow file */
+    Arrow_fb_t *fb,            /* I/O: flatbuffer for the messages */
+    Arrow_product_t *prod      /* I: bands of the file */
+)
+{
+    char FUNC_NAME[] = "write_arrow_bands";  /* function name */
+    char errmsg[STR_SIZE];     /* error message */
+    int block_lines;           /* number of lines per block */
+    int chip = prod->row_lines;  /* number of lines of a row */
+    int ncols;                 /* number of rows across the band */
+    int max_rows;              /* most rows of a batch */
+    int nrows;                 /* number of rows of the current batch */
+    int size;                  /* number of bytes per pixel */
+    int i;                     /* looping variable for the bands and rows */
+    int32_t *pos[2] = {NULL, NULL};  /* position columns of the rows */
+    void **values = NULL;      /* physical values of each band */
+    void **chips = NULL;       /* chips of each band */
+    Arrow_column_t *cols = NULL;   /* values of each column of the batch */
+    Arrow_chip_block_t blk;    /* block whose bands are cut into chips */
+    Espa_band_stack_t *stack = NULL;  /* reader of the bands */
+    Espa_band_block_t *block = NULL;  /* current block of lines */
+    int status = ERROR;        /* return status */
+
+    /* Blocks of whole rows */
+    block_lines = prod->options->batch_lines / chip * chip;
+    if (block_lines < chip)
+        block_lines = chip;
+    if (block_lines > prod->nlines)
+        block_lines = prod->nlines;
+    ncols = (prod->nsamps + prod->row_samps - 1) / prod->row_samps;
+    max_rows = (block_lines + chip - 1) / chip * ncols;
+
+    stack = open_band_stack (prod->xml_metadata, prod->nbands,
+        prod->band_index, block_lines, 0);
+    if (stack == NULL)
+    {
+        sprintf (errmsg, "Opening the band stack");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    pos[0] = malloc (max_rows * sizeof (int32_t));
+    pos[1] = malloc (max_rows * sizeof (int32_t));
+    values = calloc (prod->nbands, sizeof (void *));
+    chips = calloc (prod->nbands, sizeof (void *));
+    cols = calloc (prod->npos + prod->nbands, sizeof (Arrow_column_t));
+    if (pos[0] == NULL || pos[1] == NULL || values == NULL || chips == NULL
+        || cols == NULL)
+    {
+        sprintf (errmsg, "Allocating memory for the columns");
+        error_handler (true, FUNC_NAME, errmsg);
+        goto cleanup;
+    }
+    for (i = 0; i < prod->nbands; i++)
+    {
+        size = espa_data_type_size (prod->vmeta[i].data_type);
+        if (prod->unpack[i])
+            values[i] = espa_buffer_get ((size_t) block_lines * prod->nsamps
+                * sizeof (float));
+        if (chip > 1)
+            chips[i] = espa_buffer_get ((size_t) max_rows * chip * chip
+                * size);
+        if ((prod->unpack[i] && values[i] == NULL) ||
+            (chip > 1 && chips[i] == NULL))
+        {
+            sprintf (errmsg, "Allocating memory for the pixels of band: %s",
+                prod->vmeta[i].name);
+            error_handler (true, FUNC_NAME, errmsg);
+            goto cleanup;
+        }
+    }
+
+    blk.prod = prod;
+    blk.values = values;
+    blk.chips = chips;
+    while (1)
+    {
+        if (get_band_stack_block (stack, &block) != SUCCESS)
+        {
+            sprintf (errmsg, "Reading image data from the raw binary files");
+            error_handler (true, FUNC_NAME, errmsg);
+            goto cleanup;
+        }
+        if (block == NULL)
+            break;
+
+        /* Positions of the rows */
+        nrows = (block->nlines + chip - 1) / chip * ncols;
+        for (i = 0; i < nrows; i++)
+        {
+            pos[0][i] = block->line0 + i / ncols * chip;
+            pos[1][i] = i % ncols * prod->row_samps;
+        }
+        cols[0].data = pos[0];
+        cols[0].nbytes = (size_t) nrows * sizeof (int32_t);
+        if (prod->npos > 1)
+        {
+            cols[1].data = pos[1];
+            cols[1].nbytes = (size_t) nrows * sizeof (int32_t);
+        }
+
+        /* Physical values of the packed bands */
+        for (i = 0; i < prod->nbands; i++)
+        {
+            if (prod->unpack[i])
+                espa_cf_unpack (&prod->xml_metadata->band[
+                    prod->band_index[i]], block->band_buf[i],
+                    (long) block->nlines * prod->nsamps, values[i]);
+        }
+
+        /* Pixels of the bands */
+        if (chip > 1)
+        {
+            blk.block = block;
+            espa_parallel_for (prod->nbands, 0, cut_arrow_band_chips, &blk);
+        }
+        for (i = 0; i < prod->nbands; i++)
+        {
+            size = espa_data_type_size (prod->vmeta[i].data_type);
+            cols[prod->npos + i].nbytes = (size_t) nrows * prod->row_lines
+                * prod->row_samps * size;
+            if (chip > 1)
+                cols[prod->npos + i].data = chips[i];
+            else if (prod->unpack[i])
+                cols[prod->npos + i].data = values[i];
+            else
+                cols[prod->npos + i].data = block->band_buf[i];
+        }
+
+        if (write_arrow_batch (afile, fb, prod, nrows, cols) != SUCCESS)
+        {
+            sprintf (errmsg, "Writing the record batch of lines %d to %d",
+                block->line0, block->line0 + block->nlines - 1);
+            error_handler (true, FUNC_NAME, errmsg);
+            goto cleanup;
+        }
+    }
+    status = SUCCESS;
+
+cleanup:
+    close_band_stack (stack);
+    if (values != NULL)
+    {
+        for (i = 0; i < prod->nbands; i++)
+            espa_buffer_put (values[i]);
+    }
+    if (chips != NULL)
+    {
+        for (i = 0; i < prod->nbands; i++)
+            espa_buffer_put (chips[i]);
+    }
+    free (values);
+    free (chips);
+    free (cols);
+    free (pos[0]);
+    free (pos[1]);
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  select_arrow_bands
+
+PURPOSE: Selects the bands on the grid of the first band, and determines the
+metadata of their columns and the shape of the rows.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error selecting the bands
+SUCCESS         Successfully selected the bands
+
+NOTES:
+  1. The bands on the other grids are reported and skipped.
+  2. The copies of the band metadata share its allocated fields, so they
+     must not be freed.
+******************************************************************************/
+static int select_arrow_bands
+(
+    Espa_internal_meta_t *xml_metadata, /* I: XML metadata structure */
+    Arrow_options_t *options,  /* I: layout and batching of the rows */
+    Arrow_product_t *prod      /* O: bands of the file; the arrays are
+                                     freed by the caller */
+)
+{
+    char FUNC_NAME[] = "select_arrow_bands";  /* function name */
+    char errmsg[STR_SIZE];     /* error message */
+    int i;                     /* looping variable for the bands */
+    Espa_band_meta_t *bmeta = NULL;  /* metadata of the current band */
+    Espa_band_grids_t grids;   /* grids of the bands */
+
+    prod->xml_metadata = xml_metadata;
+    prod->options = options;
+    prod->nbands = 0;
+    prod->band_index = malloc (xml_metadata->nbands * sizeof (int));
+    prod->vmeta = malloc (xml_metadata->nbands * sizeof (Espa_band_meta_t));
+    prod->unpack = malloc (xml_metadata->nbands * sizeof (bool));
+    if (prod->band_index == NULL || prod->vmeta == NULL ||
+        prod->unpack == NULL)
+    {
+        sprintf (errmsg, "Allocating memory for the bands");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    if (get_espa_band_grids (xml_metadata, &grids) != SUCCESS)
+    {
+        sprintf (errmsg, "Determining the grids of the bands");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    for (i = 0; i < xml_metadata->nbands; i++)
+    {
+        bmeta = &xml_metadata->band[i];
+        if (grids.band_grid[i] != 0)
+        {
+            sprintf (errmsg, "Skipping band %s, which isn't on the grid of "
+                "band %s", bmeta->name, xml_metadata->band[0].name);
+            error_handler (false, FUNC_NAME, errmsg);
+            continue;
+        }
+        if (!arrow_type_supported (bmeta->data_type))
+        {
+            sprintf (errmsg, "Unsupported data type for band: %s",
+                bmeta->name);
+            error_handler (true, FUNC_NAME, errmsg);
+            free_espa_band_grids (&grids);
+            return (ERROR);
+        }
+
+        prod->band_index[prod->nbands] = i;
+        prod->vmeta[prod->nbands] = *bmeta;
+        prod->unpack[prod->nbands] = options->physical_units &&
+            espa_cf_is_packed (bmeta);
+        if (prod->unpack[prod->nbands])
+            espa_cf_physical_meta (&prod->vmeta[prod->nbands]);
+        prod->nbands++;
+    }
+    free_espa_band_grids (&grids);
+
+    prod->nlines = xml_metadata->band[0].nlines;
+    prod->nsamps = xml_metadata->band[0].nsamps;
+    if (options->layout == ARROW_LAYOUT_CHIPS)
+    {
+        prod->row_lines = options->chip_size;
+        prod->row_samps = options->chip_size;
+        prod->npos = 2;
+    }
+    else
+    {
+        prod->row_lines = 1;
+        prod->row_samps = prod->nsamps;
+        prod->npos = 1;
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  remove_arrow_band_source
+
+PURPOSE: Removes the raw binary image and ENVI header files of a band.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error removing the files
+SUCCESS         Successfully removed the files
+
+NOTES:
+******************************************************************************/
+static int remove_arrow_band_source
+(
+    Espa_band_meta_t *bmeta   /* I: metadata of the band */
+)
+{
+    char FUNC_NAME[] = "remove_arrow_band_source";  /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    char hdr_file[STR_SIZE];  /* ENVI header file */
+    char *cptr = NULL;        /* pointer to the file extension */
+    int count;                /* number of chars copied in snprintf */
+
+    /* .img file */
+    printf ("  Removing %s\n", bmeta->file_name);
+    if (unlink (bmeta->file_name) != 0)
+    {
+        sprintf (errmsg, "Deleting source file: %s", bmeta->file_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* .hdr file */
+    count = snprintf (hdr_file, sizeof (hdr_file), "%s", bmeta->file_name);
+    if (count < 0 || count >= sizeof (hdr_file))
+    {
+        sprintf (errmsg, "Overflow of hdr_file string");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    cptr = strrchr (hdr_file, '.');
+    strcpy (cptr, ".hdr");
+    printf ("  Removing %s\n", hdr_file);
+    if (unlink (hdr_file) != 0)
+    {
+        sprintf (errmsg, "Deleting source file: %s", hdr_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  parse_arrow_layout
+
+PURPOSE: Converts the name of a layout to the rows of the record batches.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Unknown layout
+SUCCESS         Successfully converted the name
+******************************************************************************/
+int parse_arrow_layout
+(
+    char *name,                    /* I: name of the layout (lines or
+                                         chips) */
+    Arrow_layout_t *layout         /* O: rows of the record batches */
+)
+{
+    char FUNC_NAME[] = "parse_arrow_layout";  /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+
+    if (!strcmp (name, "lines"))
+        *layout = ARROW_LAYOUT_LINES;
+    else if (!strcmp (name, "chips"))
+        *layout = ARROW_LAYOUT_CHIPS;
+    else
+    {
+        snprintf (errmsg, sizeof (errmsg), "Unknown layout %s.  Valid "
+            "layouts are lines and chips.", name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  convert_espa_to_arrow
+
+PURPOSE: Converts the internal ESPA raw binary file to an Arrow IPC file,
+with a tensor column per band.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error converting to Arrow
+SUCCESS         Successfully converted to Arrow
+
+NOTES:
+  1. The bands are streamed from the raw binary files a record batch at a
+     time, so the memory used doesn't depend on the size of the bands.
+  2. An existing file of the same name is overwritten.
+  3. With physical units, the packed bands are written as float32 physical
+     values with NaN fill (see espa_cf_packing.h), and their metadata
+     describes the physical values.
+******************************************************************************/
+int convert_espa_to_arrow
+(
+    char *espa_xml_file,   /* I: input ESPA XML metadata filename */
+    char *arrow_file,      /* I: output Arrow IPC filename */
+    bool del_src,          /* I: should the source files be removed after
+                                 conversion? */
+    Arrow_options_t *options  /* I: layout and batching of the rows */
+)
+{
+    char FUNC_NAME[] = "convert_espa_to_arrow";  /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    unsigned char magic[ARROW_MAGIC_PADDED];  /* opening magic */
+    int i;                      /* looping variable for each band */
+    size_t block_len;           /* number of bytes of the schema message */
+    const unsigned char *meta;  /* flatbuffer of the schema message */
+    Espa_internal_meta_t xml_metadata;  /* XML metadata structure to be
+                                   populated by reading the input XML metadata
+                                   file */
+    Arrow_product_t prod;       /* bands of the file */
+    Arrow_file_t afile = {-1, 0, 0, 0, NULL};  /* Arrow file */
+    Arrow_fb_t fb;              /* flatbuffer of the messages */
+    int status = ERROR;         /* return status */
+
+    if (options->batch_lines < 1 ||
+        (options->layout == ARROW_LAYOUT_CHIPS && options->chip_size < 1))
+    {
+        sprintf (errmsg, "Invalid rows: %d lines per batch, chips of %d",
+            options->batch_lines, options->chip_size);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    memset (&prod, 0, sizeof (prod));
+    memset (&fb, 0, sizeof (fb));
+    arrow_fb_reset (&fb);
+
+    /* Initialize the metadata structure */
+    init_metadata_struct (&xml_metadata);
+
+    /* Validate the metadata file and parse it into our internal metadata
+       structure, reading the file only once; also allocates space as needed
+       for various pointers in the global and band metadata */
+    if (validate_and_parse_metadata (espa_xml_file, &xml_metadata) != SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+
+    if (select_arrow_bands (&xml_metadata, options, &prod) != SUCCESS)
+        goto cleanup;
+
+    afile.fd = open (arrow_file, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (afile.fd == -1)
+    {
+        sprintf (errmsg, "Creating the Arrow file: %s", arrow_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        goto cleanup;
+    }
+
+    /* Opening magic and schema */
+    memset (magic, 0, sizeof (magic));
+    memcpy (magic, ARROW_MAGIC, strlen (ARROW_MAGIC));
+    meta = arrow_message (&fb, ARROW_HEADER_SCHEMA, arrow_schema (&fb,
+        &prod), 0);
+    if (meta == NULL)
+    {
+        sprintf (errmsg, "Allocating memory for the schema");
+        error_handler (true, FUNC_NAME, errmsg);
+        goto cleanup;
+    }
+    if (write_arrow_bytes (&afile, magic, sizeof (magic), sizeof (magic))
+        != SUCCESS || write_arrow_message (&afile, meta, fb.len, &block_len)
+        != SUCCESS)
+    {
+        sprintf (errmsg, "Writing the schema to the Arrow file: %s",
+            arrow_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        goto cleanup;
+    }
+
+    /* Record batches of the bands, then the footer locating them */
+    for (i = 0; i < prod.nbands; i++)
+        printf ("Band %s\n", prod.vmeta[i].name);
+    if (write_arrow_bands (&afile, &fb, &prod) != SUCCESS)
+        goto cleanup;
+    if (write_arrow_footer (&afile, &fb, &prod) != SUCCESS)
+    {
+        sprintf (errmsg, "Writing the footer to the Arrow file: %s",
+            arrow_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        goto cleanup;
+    }
+    if (close (afile.fd) != 0)
+    {
+        afile.fd = -1;
+        sprintf (errmsg, "Closing the Arrow file: %s", arrow_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        goto cleanup;
+    }
+    afile.fd = -1;
+
+    /* Remove the source files if specified, unless bands were skipped.
+       Constant bands have none, and a stack of bands is removed with its
+       last band. */
+    if (del_src && prod.nbands < xml_metadata.nbands)
+    {
+        sprintf (errmsg, "Keeping the source files, since not every band "
+            "was written");
+        error_handler (false, FUNC_NAME, errmsg);
+    }
+    else if (del_src)
+    {
+        for (i = 0; i < xml_metadata.nbands; i++)
+        {
+            if (is_constant_band (&xml_metadata.band[i]) ||
+                is_shared_band_file (&xml_metadata, i, true))
+                continue;
+            if (remove_arrow_band_source (&xml_metadata.band[i]) != SUCCESS)
+            {
+                sprintf (errmsg, "Removing the source files of band: %s",
+                    xml_metadata.band[i].name);
+                error_handler (true, FUNC_NAME, errmsg);
+                goto cleanup;
+            }
+        }
+
+        printf ("  Removing %s\n", espa_xml_file);
+        if (unlink (espa_xml_file) != 0)
+        {
+            sprintf (errmsg, "Deleting source file: %s", espa_xml_file);
+            error_handler (true, FUNC_NAME, errmsg);
+            goto cleanup;
+        }
+    }
+    status = SUCCESS;
+
+cleanup:
+    if (afile.fd != -1)
+        close (afile.fd);
+    free (afile.blocks);
+    free (fb.buf);
+    free (prod.band_index);
+    free (prod.vmeta);
+    free (prod.unpack);
+    free_metadata (&xml_metadata);
+    return (status);
+}
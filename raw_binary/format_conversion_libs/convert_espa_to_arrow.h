@@ -0,0 +1,82 @@
+/*****************************************************************************
+FILE: convert_espa_to_arrow.h
+
+PURPOSE: Contains defines and prototypes to read the ESPA XML metadata file
+and imagery, and convert from raw binary to an Apache Arrow IPC file (also
+known as Feather version 2), for the data loaders of machine learning
+pipelines.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. Each band is a column of fixed-size lists of its pixels, tagged as the
+     arrow.fixed_shape_tensor extension type, so readers see a tensor per
+     row.  A row is either a line of the bands or a square chip of them.
+  2. The buffers are uncompressed, in the byte order of the host, and
+     aligned to ARROW_ALIGNMENT bytes, so readers can memory-map the file and
+     use the pixels without copying them.
+*****************************************************************************/
+
+#ifndef CONVERT_ESPA_TO_ARROW_H
+#define CONVERT_ESPA_TO_ARROW_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "error_handler.h"
+#include "espa_metadata.h"
+#include "parse_metadata.h"
+#include "raw_binary_io.h"
+#include "espa_band_stack.h"
+#include "espa_buffer_pool.h"
+
+/* Rows of the record batches */
+typedef enum {
+    ARROW_LAYOUT_LINES,  /* a row per line; each band holds the samples of
+                            the line */
+    ARROW_LAYOUT_CHIPS   /* a row per square chip; each band holds the chip
+                            lines by chip samples, padded with fill at the
+                            right and bottom edges */
+} Arrow_layout_t;
+
+/* Default rows of the record batches */
+#define DEFAULT_ARROW_BATCH_LINES 512
+#define DEFAULT_ARROW_CHIP_SIZE 256
+
+/* Alignment of the buffers in the file, as recommended by the Arrow format
+   for SIMD access */
+#define ARROW_ALIGNMENT 64
+
+/* Layout and batching of the rows */
+typedef struct
+{
+    Arrow_layout_t layout; /* rows of the record batches */
+    int batch_lines;     /* number of lines per record batch; rounded down
+                            to whole chips (at least one) for chips */
+    int chip_size;       /* number of lines and samples of a chip */
+    bool physical_units; /* write the packed bands as the float32 physical
+                            values of their scale_factor and add_offset
+                            (see espa_cf_packing.h)? */
+} Arrow_options_t;
+
+/* Prototypes */
+int parse_arrow_layout
+(
+    char *name,                    /* I: name of the layout (lines or
+                                         chips) */
+    Arrow_layout_t *layout         /* O: rows of the record batches */
+);
+
+int convert_espa_to_arrow
+(
+    char *espa_xml_file,   /* I: input ESPA XML metadata filename */
+    char *arrow_file,      /* I: output Arrow IPC filename */
+    bool del_src,          /* I: should the source files be removed after
+                                 conversion? */
+    Arrow_options_t *options  /* I: layout and batching of the rows */
+);
+
+#endif
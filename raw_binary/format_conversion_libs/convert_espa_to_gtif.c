@@ -17,173 +17,553 @@ NOTES:
 *****************************************************************************/
 #include <unistd.h>
 #include "convert_espa_to_gtif.h"
+#include "espa_trace.h"
+#include "espa_log.h"
+#include "espa_task_pool.h"
 
 /******************************************************************************
-MODULE:  convert_espa_to_gtif
+MODULE:  write_gtif_world_file
 
-PURPOSE: Converts the internal ESPA raw binary file to GeoTIFF file format.
+PURPOSE: Writes the ESRI world file of a GeoTIFF band.
 
 RETURN VALUE:
 Type = int
 Value           Description
 -----           -----------
-ERROR           Error converting to GeoTIFF
-SUCCESS         Successfully converted to GeoTIFF
+ERROR           Error writing the world file
+SUCCESS         Successfully wrote the world file
 
 NOTES:
-  1. The GDAL tools will be used for converting the raw binary (ENVI format)
-     files to GeoTIFF.
-  2. An associated .tfw (ESRI world file) will be generated for each GeoTIFF
-     file.
+  1. The world file has the name of the GeoTIFF with the .tif replaced by
+     .tfw.
 ******************************************************************************/
-int convert_espa_to_gtif
+static int write_gtif_world_file
 (
-    char *espa_xml_file,   /* I: input ESPA XML metadata filename */
-    char *gtif_file,       /* I: base output GeoTIFF filename */
-    bool del_src           /* I: should the source files be removed after
-                                 conversion? */
+    Espa_internal_meta_t *xml_metadata, /* I: XML metadata structure */
+    int band,                           /* I: index of the band */
+    char *gtif_band                     /* I: name of the GeoTIFF file */
 )
 {
-    char FUNC_NAME[] = "convert_espa_to_gtif";  /* function name */
+    char FUNC_NAME[] = "write_gtif_world_file";  /* function name */
     char errmsg[STR_SIZE];      /* error message */
-    char gdal_cmd[STR_SIZE];    /* command string for GDAL call */
-    char gtif_band[STR_SIZE];   /* name of the GeoTIFF file for this band */
-    char hdr_file[STR_SIZE];    /* name of the header file for this band */
-    char xml_file[STR_SIZE];    /* new XML file for the GeoTIFF product */
-    char tmpfile[STR_SIZE];     /* filename of file.tif.aux.xml */
-    char *cptr = NULL;          /* pointer to empty space in the band name */
-    int i;                      /* looping variable for each band */
+    char tfw_file[STR_SIZE];    /* name of the world file for this band */
+    char *cptr = NULL;          /* pointer to the file extension */
     int count;                  /* number of chars copied in snprintf */
-    int status = SUCCESS;       /* status for multi-threaded area */
-    Espa_internal_meta_t xml_metadata;  /* XML metadata structure to be
-                                   populated by reading the XML metadata file */
+    Espa_band_meta_t *bmeta = &xml_metadata->band[band];  /* band metadata */
 
-    /* Validate the input metadata file */
-    if (validate_xml_file (espa_xml_file) != SUCCESS)
-    {  /* Error messages already written */
+    count = snprintf (tfw_file, sizeof (tfw_file), "%s", gtif_band);
+    cptr = strrchr (tfw_file, '.');
+    if (count < 0 || count >= sizeof (tfw_file) || cptr == NULL)
+    {
+        sprintf (errmsg, "Unable to determine the world filename of %s",
+            gtif_band);
+        error_handler (true, FUNC_NAME, errmsg);
         return (ERROR);
     }
+    strcpy (cptr, ".tfw");
 
-    /* Initialize the metadata structure */
-    init_metadata_struct (&xml_metadata);
-
-    /* Parse the metadata file into our internal metadata structure; also
-       allocates space as needed for various pointers in the global and band
-       metadata */
-    if (parse_metadata (espa_xml_file, &xml_metadata) != SUCCESS)
-    {  /* Error messages already written */
+    if (write_tiff_world_file (tfw_file, bmeta,
+        &xml_metadata->global.proj_info) != SUCCESS)
+    {
+        sprintf (errmsg, "Writing the world file: %s", tfw_file);
+        error_handler (true, FUNC_NAME, errmsg);
         return (ERROR);
     }
 
-    /* Loop through the bands in the XML file and convert them to GeoTIFF.
-       The filenames will have the GeoTIFF base name followed by _ and the
-       band name of each band in the XML file.  Blank spaced in the band name
-       will be replaced with underscores. */
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  gtif_band_name
+
+PURPOSE: Determines the name of the GeoTIFF file of a band.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           The name doesn't fit in STR_SIZE characters
+SUCCESS         Successfully determined the name
+
+NOTES:
+  1. The name is the GeoTIFF base name followed by _ and the band name, with
+     any blank spaces replaced by underscores.
+******************************************************************************/
+static int gtif_band_name
+(
+    char *gtif_file,        /* I: base output GeoTIFF filename */
+    char *band_name,        /* I: name of the band */
+    char *gtif_band         /* O: name of the GeoTIFF file of the band; at
+                                  least STR_SIZE characters */
+)
+{
+    char *cptr = NULL;      /* pointer to empty space in the band name */
+    int count;              /* number of chars copied in snprintf */
+
+    count = snprintf (gtif_band, STR_SIZE, "%s_%s.tif", gtif_file,
+        band_name);
+    if (count < 0 || count >= STR_SIZE)
+        return (ERROR);
+
+    /* Loop through this filename and replace any occurances of blank
+       spaces with underscores */
+    while ((cptr = strchr (gtif_band, ' ')) != NULL)
+        *cptr = '_';
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  open_gtif_band
+
+PURPOSE: Creates the GeoTIFF file of a band and sets up its tags for the band
+to be written as uncompressed strips.
+
+RETURN VALUE:
+Type = TIFF *
+Value           Description
+-----           -----------
+NULL            Error creating the GeoTIFF or setting its tags
+non-NULL        GeoTIFF file pointer, to be closed with close_tiff
+
+NOTES:
+  1. The Tiff library registers its tag extensions on the first open, so the
+     opens are serialized.
+  2. The nodata tag is written if the fill value of the band is defined.
+******************************************************************************/
+static TIFF *open_gtif_band
+(
+    Espa_internal_meta_t *xml_metadata, /* I: XML metadata structure */
+    int band,                           /* I: index of the band */
+    char *gtif_band,                    /* I: name of the GeoTIFF file */
+    int strip_lines                     /* I: number of lines per strip */
+)
+{
+    char FUNC_NAME[] = "open_gtif_band";  /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    int status = SUCCESS;       /* status of setting the tags */
+    Espa_band_meta_t *bmeta = &xml_metadata->band[band];  /* band metadata */
+    TIFF *tiff = NULL;          /* GeoTIFF file pointer */
+
 #ifdef _OPENMP
-    #pragma omp parallel for private (i, count, gtif_band, cptr, gdal_cmd, errmsg, tmpfile, hdr_file)
+    #pragma omp critical (gtif_open)
 #endif
-    for (i = 0; i < xml_metadata.nbands; i++)
     {
-        /* Determine the output GeoTIFF band name */
-        count = snprintf (gtif_band, sizeof (gtif_band), "%s_%s.tif",
-            gtif_file, xml_metadata.band[i].name);
-        if (count < 0 || count >= sizeof (gtif_band))
+        tiff = open_tiff (gtif_band, "w");
+        if (tiff != NULL)
         {
-            sprintf (errmsg, "Overflow of gtif_file string");
-            error_handler (true, FUNC_NAME, errmsg);
-            status = ERROR;
+            set_tiff_strip_tags (tiff, bmeta->data_type, bmeta->nlines,
+                bmeta->nsamps, strip_lines, COMPRESSION_NONE,
+                PREDICTOR_NONE);
+            if (set_geotiff_tags (tiff, bmeta, &xml_metadata->global.proj_info)
+                != SUCCESS)
+                status = ERROR;
+            else if ((int) bmeta->fill_value != (int) ESPA_INT_META_FILL &&
+                set_tiff_nodata (tiff, bmeta->fill_value) != SUCCESS)
+                status = ERROR;
         }
+    }
+    if (tiff == NULL || status != SUCCESS)
+    {
+        sprintf (errmsg, "Creating the GeoTIFF file: %s", gtif_band);
+        error_handler (true, FUNC_NAME, errmsg);
+        if (tiff != NULL)
+            close_tiff (tiff);
+        return (NULL);
+    }
 
-        /* Loop through this filename and replace any occurances of blank
-           spaces with underscores */
-        while ((cptr = strchr (gtif_band, ' ')) != NULL)
-            *cptr = '_';
+    return (tiff);
+}
 
-        /* Convert the files */
-        printf ("Converting %s to %s\n", xml_metadata.band[i].file_name,
-            gtif_band);
 
-        /* Check if the fill value is defined */
-        if ((int) xml_metadata.band[i].fill_value == (int) ESPA_INT_META_FILL)
+/******************************************************************************
+MODULE:  write_gtif_band
+
+PURPOSE: Streams a raw binary band into a GeoTIFF file, along with its ESRI
+world file.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error reading the band or writing the GeoTIFF
+SUCCESS         Successfully wrote the GeoTIFF and its world file
+
+NOTES:
+  1. The band is read ahead one block of lines at a time, so only a few
+     blocks of the band are resident at any time.  Each block is written as
+     one strip of the GeoTIFF.  Constant bands are
+     synthesized by the band stack, so they don't need a raw binary file.
+  2. A Cloud-Optimized GeoTIFF is written by write_cog_band, which
+     compresses its tiles across the threads.
+  3. A band which is removed once it is converted to a striped GeoTIFF is
+     dropped from the page cache as it is read (see drop_band_stack_pages).
+******************************************************************************/
+static int write_gtif_band
+(
+    Espa_internal_meta_t *xml_metadata, /* I: XML metadata structure */
+    int band,                           /* I: index of the band */
+    char *gtif_band,                    /* I: name of the GeoTIFF file */
+    bool cog,                           /* I: write a Cloud-Optimized
+                                              GeoTIFF? */
+    Cog_compression_t compression,      /* I: compression of the COG tiles */
+    bool del_src                        /* I: is the band removed once it is
+                                              converted? */
+)
+{
+    char FUNC_NAME[] = "write_gtif_band";  /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    int status = SUCCESS;       /* return status */
+    Espa_band_meta_t *bmeta = &xml_metadata->band[band];  /* band metadata */
+    Espa_band_stack_t *stack = NULL;    /* band stack for reading the band */
+    Espa_band_block_t *block = NULL;    /* current block of lines */
+    TIFF *tiff = NULL;          /* GeoTIFF file pointer */
+    Espa_trace_span_t write_span;       /* timing of the current write */
+    ESPA_TRACE_SCOPE (trace, "export_band", bmeta->name);  /* timing */
+
+    if (cog)
+    {
+        if (write_cog_band (gtif_band, xml_metadata, band, compression)
+            != SUCCESS)
         {
-            /* Fill value is not defined so don't write the nodata tag */
-            count = snprintf (gdal_cmd, sizeof (gdal_cmd),
-                "gdal_translate -of Gtiff -co \"TFW=YES\" -q %s %s",
-                xml_metadata.band[i].file_name, gtif_band);
+            sprintf (errmsg, "Writing the COG file: %s", gtif_band);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
         }
-        else
+        return (write_gtif_world_file (xml_metadata, band, gtif_band));
+    }
+
+    /* Read ahead the band */
+    stack = open_band_stack (xml_metadata, 1, &band,
+        RB_PREFETCH_DEFAULT_LINES, 0);
+    if (stack == NULL)
+    {
+        sprintf (errmsg, "Opening the input raw binary file: %s",
+            bmeta->file_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    if (del_src)
+        drop_band_stack_pages (stack);
+
+    /* Open the GeoTIFF, with a strip for each block */
+    tiff = open_gtif_band (xml_metadata, band, gtif_band,
+        RB_PREFETCH_DEFAULT_LINES);
+    if (tiff == NULL)
+    {
+        sprintf (errmsg, "Setting up the GeoTIFF file: %s", gtif_band);
+        error_handler (true, FUNC_NAME, errmsg);
+        close_band_stack (stack);
+        return (ERROR);
+    }
+
+    while (1)
+    {
+        if (get_band_stack_block (stack, &block) != SUCCESS)
         {
-            /* Fill value is defined so use the nodata tag */
-            count = snprintf (gdal_cmd, sizeof (gdal_cmd),
-             "gdal_translate -of Gtiff -a_nodata %ld -co \"TFW=YES\" -q %s %s",
-                xml_metadata.band[i].fill_value, xml_metadata.band[i].file_name,
-                gtif_band);
+            sprintf (errmsg, "Reading image data from the raw binary file");
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+            break;
         }
-        if (count < 0 || count >= sizeof (gdal_cmd))
+        if (block == NULL)
+            break;   /* all lines have been written */
+
+        write_span = espa_trace_begin ("write_block", bmeta->name);
+        status = write_tiff_lines (tiff, bmeta->data_type, block->line0,
+            block->nlines, block->nsamps, block->band_buf[0]);
+        espa_trace_end (&write_span);
+        if (status != SUCCESS)
         {
-            sprintf (errmsg, "Overflow of gdal_cmd string");
+            sprintf (errmsg, "Writing lines %d-%d to the GeoTIFF file: %s",
+                block->line0, block->line0 + block->nlines - 1, gtif_band);
             error_handler (true, FUNC_NAME, errmsg);
             status = ERROR;
+            break;
+        }
+    }
+
+    close_tiff (tiff);
+    close_band_stack (stack);
+    if (status != SUCCESS)
+        return (ERROR);
+
+    return (write_gtif_world_file (xml_metadata, band, gtif_band));
+}
+
+
+/******************************************************************************
+MODULE:  gtif_inputs_key
+
+PURPOSE: Builds the key of the inputs of the GeoTIFF of a band, for an
+incremental export (see espa_incremental.h).
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error building the key
+SUCCESS         Successfully built the key
+
+NOTES:
+  1. The GeoTIFF holds the pixels of the band, tagged with its grid and fill
+     value, so its key doesn't include any of the other metadata.
+******************************************************************************/
+static int gtif_inputs_key
+(
+    Espa_internal_meta_t *xml_metadata, /* I/O: XML metadata structure */
+    int band,                           /* I: index of the band */
+    bool cog,                           /* I: is a Cloud-Optimized GeoTIFF
+                                              written? */
+    Cog_compression_t compression,      /* I: compression of the COG tiles */
+    int strip_lines,                    /* I: number of lines per strip of
+                                              a plain GeoTIFF */
+    Espa_inputs_key_t *key              /* O: key of the inputs; empty on
+                                              input */
+)
+{
+    int status;                 /* status of adding the format */
+
+    if (cog)
+        status = add_espa_inputs_key (key, "format gtif cog compression %d",
+            compression);
+    else
+        status = add_espa_inputs_key (key, "format gtif strips %d",
+            strip_lines);
+    if (status != SUCCESS ||
+        add_espa_grid_inputs (key, &xml_metadata->global) != SUCCESS ||
+        add_espa_band_inputs (key, xml_metadata, band) != SUCCESS)
+        return (ERROR);
+
+    return (SUCCESS);
+}
+
+
+/* Bands being converted, shared by the iterations of the loop over the
+   bands */
+typedef struct
+{
+    Espa_internal_meta_t *xml_metadata; /* XML metadata structure */
+    char *gtif_file;                    /* base output GeoTIFF filename */
+    bool del_src;                       /* remove the source files? */
+    bool cog;                           /* write Cloud-Optimized GeoTIFFs? */
+    Cog_compression_t compression;      /* compression of the COG tiles */
+    bool incremental;                   /* keep the GeoTIFFs whose inputs
+                                           are unchanged? */
+} Gtif_convert_t;
+
+
+/******************************************************************************
+MODULE:  convert_gtif_loop_band
+
+PURPOSE: Converts a band to GeoTIFF, as an iteration of the loop over the
+bands, and removes its source files if specified.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error converting the band or removing its source files
+SUCCESS         Successfully converted the band
+
+NOTES:
+  1. The file name of the band in the metadata is replaced by the name of
+     its GeoTIFF.
+  2. When exporting incrementally, a GeoTIFF whose inputs are unchanged is
+     kept; only its world file is written again.
+******************************************************************************/
+static int convert_gtif_loop_band
+(
+    void *arg,             /* I/O: bands being converted */
+    int i,                 /* I: index of the band */
+    int worker             /* I: index of the worker (unused) */
+)
+{
+    char FUNC_NAME[] = "convert_espa_to_gtif";  /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    char gtif_band[STR_SIZE];   /* name of the GeoTIFF file for this band */
+    char hdr_file[STR_SIZE];    /* name of the header file for this band */
+    char *cptr = NULL;          /* pointer to empty space in the band name */
+    int count;                  /* number of chars copied in snprintf */
+    int status = SUCCESS;       /* status of the band */
+    bool constant;              /* is the current band a constant band? */
+    bool current = false;       /* is the GeoTIFF of an earlier run kept? */
+    Espa_inputs_key_t key;      /* key of the inputs of the GeoTIFF */
+    Gtif_convert_t *convert = arg;      /* bands being converted */
+    Espa_internal_meta_t *xml_metadata = convert->xml_metadata;
+                                /* XML metadata structure */
+
+    /* Determine the output GeoTIFF band name */
+    if (gtif_band_name (convert->gtif_file, xml_metadata->band[i].name,
+        gtif_band) != SUCCESS)
+    {
+        sprintf (errmsg, "Overflow of gtif_file string");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Keep the GeoTIFF of an earlier run if its inputs are unchanged */
+    init_espa_inputs_key (&key);
+    if (convert->incremental)
+    {
+        if (gtif_inputs_key (xml_metadata, i, convert->cog,
+            convert->compression, RB_PREFETCH_DEFAULT_LINES, &key)
+            != SUCCESS)
+        {
+            sprintf (errmsg, "Determining the inputs of band %s",
+                xml_metadata->band[i].name);
+            error_handler (true, FUNC_NAME, errmsg);
+            free_espa_inputs_key (&key);
+            return (ERROR);
+        }
+        current = espa_output_is_current (gtif_band, &key);
+        if (!current && invalidate_espa_output (gtif_band) != SUCCESS)
+        {  /* Error messages already written */
+            free_espa_inputs_key (&key);
+            return (ERROR);
         }
+    }
 
-        if (system (gdal_cmd) == -1)
+    /* Convert the band */
+    constant = is_constant_band (&xml_metadata->band[i]);
+    if (current)
+    {
+        espa_log_printf (ESPA_LOG_INFO, "Keeping %s, whose inputs are "
+            "unchanged\n", gtif_band);
+        status = write_gtif_world_file (xml_metadata, i, gtif_band);
+    }
+    else
+    {
+        espa_log_printf (ESPA_LOG_INFO, "Converting %s to %s\n", constant ?
+            "constant band" : xml_metadata->band[i].file_name, gtif_band);
+        if (write_gtif_band (xml_metadata, i, gtif_band, convert->cog,
+            convert->compression, convert->del_src) != SUCCESS)
         {
-            sprintf (errmsg, "Running gdal_translate: %s", gdal_cmd);
+            sprintf (errmsg, "Converting band %s",
+                xml_metadata->band[i].name);
             error_handler (true, FUNC_NAME, errmsg);
             status = ERROR;
         }
+        else if (convert->incremental &&
+            record_espa_output_inputs (gtif_band, &key) != SUCCESS)
+            status = ERROR;   /* Error messages already written */
+    }
+    free_espa_inputs_key (&key);
 
-        /* Remove the {gtif_name}.tif.aux.xml file since it's not needed and
-           clutters the results.  Don't worry about testing the unlink
-           results.  If it doesn't unlink it's not fatal. */
-        count = snprintf (tmpfile, sizeof (tmpfile), "%s.aux.xml", gtif_band);
-        if (count < 0 || count >= sizeof (tmpfile))
+    /* Remove the source file if specified.  Constant bands have no source
+       file, and a stack of bands is removed with its last band. */
+    if (convert->del_src && !constant && status != ERROR &&
+        !is_shared_band_file (xml_metadata, i, true))
+    {
+        /* .img file */
+        printf ("  Removing %s\n", xml_metadata->band[i].file_name);
+        if (unlink (xml_metadata->band[i].file_name) != 0)
         {
-            sprintf (errmsg, "Overflow of tmpfile string");
+            sprintf (errmsg, "Deleting source file: %s",
+                xml_metadata->band[i].file_name);
             error_handler (true, FUNC_NAME, errmsg);
             status = ERROR;
         }
-        unlink (tmpfile);
 
-        /* Remove the source file if specified */
-        if (del_src && status != ERROR)
+        /* .hdr file */
+        count = snprintf (hdr_file, sizeof (hdr_file), "%s",
+            xml_metadata->band[i].file_name);
+        if (count < 0 || count >= sizeof (hdr_file))
         {
-            /* .img file */
-            printf ("  Removing %s\n", xml_metadata.band[i].file_name);
-            if (unlink (xml_metadata.band[i].file_name) != 0)
-            {
-                sprintf (errmsg, "Deleting source file: %s",
-                    xml_metadata.band[i].file_name);
-                error_handler (true, FUNC_NAME, errmsg);
-                status = ERROR;
-            }
-
-            /* .hdr file */
-            count = snprintf (hdr_file, sizeof (hdr_file), "%s",
-                xml_metadata.band[i].file_name);
-            if (count < 0 || count >= sizeof (hdr_file))
-            {
-                sprintf (errmsg, "Overflow of hdr_file string");
-                error_handler (true, FUNC_NAME, errmsg);
-                status = ERROR;
-            }
+            sprintf (errmsg, "Overflow of hdr_file string");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
 
-            cptr = strrchr (hdr_file, '.');
-            strcpy (cptr, ".hdr");
-            printf ("  Removing %s\n", hdr_file);
-            if (unlink (hdr_file) != 0)
-            {
-                sprintf (errmsg, "Deleting source file: %s", hdr_file);
-                error_handler (true, FUNC_NAME, errmsg);
-                status = ERROR;
-            }
+        cptr = strrchr (hdr_file, '.');
+        strcpy (cptr, ".hdr");
+        printf ("  Removing %s\n", hdr_file);
+        if (unlink (hdr_file) != 0)
+        {
+            sprintf (errmsg, "Deleting source file: %s", hdr_file);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
         }
+    }
+
+    /* Update the XML file to use the new GeoTIFF band name */
+    strcpy (xml_metadata->band[i].file_name, gtif_band);
+    xml_metadata->band[i].constant_value = ESPA_FLOAT_META_FILL;
+
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  convert_espa_to_gtif
+
+PURPOSE: Converts the internal ESPA raw binary file to GeoTIFF file format.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error converting to GeoTIFF
+SUCCESS         Successfully converted to GeoTIFF
+
+NOTES:
+  1. The raw binary bands are streamed into the GeoTIFF files in-process, one
+     block of lines at a time.
+  2. An associated .tfw (ESRI world file) will be generated for each GeoTIFF
+     file.
+  3. Constant bands have no raw binary file; their pixels are synthesized as
+     the GeoTIFF is written.  The GeoTIFF holds the pixels, so the band is no
+     longer constant in the GeoTIFF XML file.
+  4. The bands are converted in parallel on the task pool (see
+     espa_task_pool.h).  The tiles of the COG bands are compressed in
+     parallel within each band, on the same threads.
+  5. If ESPA_INCREMENTAL_ENV is set, the GeoTIFF of a band is only written
+     when its inputs have changed since it was last written (see
+     espa_incremental.h).
+******************************************************************************/
+int convert_espa_to_gtif
+(
+    char *espa_xml_file,   /* I: input ESPA XML metadata filename */
+    char *gtif_file,       /* I: base output GeoTIFF filename */
+    bool del_src,          /* I: should the source files be removed after
+                                 conversion? */
+    bool cog,              /* I: should Cloud-Optimized GeoTIFFs be written? */
+    Cog_compression_t compression  /* I: compression of the COG tiles */
+)
+{
+    char FUNC_NAME[] = "convert_espa_to_gtif";  /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    char xml_file[STR_SIZE];    /* new XML file for the GeoTIFF product */
+    int count;                  /* number of chars copied in snprintf */
+    Gtif_convert_t convert;     /* bands being converted */
+    Espa_internal_meta_t xml_metadata;  /* XML metadata structure to be
+                                   populated by reading the XML metadata file */
 
-        /* Update the XML file to use the new GeoTIFF band name */
-        strcpy (xml_metadata.band[i].file_name, gtif_band);
+    /* Initialize the metadata structure */
+    init_metadata_struct (&xml_metadata);
+
+    /* Validate the metadata file and parse it into our internal metadata
+       structure, reading the file only once; also allocates space as needed
+       for various pointers in the global and band metadata */
+    if (validate_and_parse_metadata (espa_xml_file, &xml_metadata) != SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
     }
 
-    if (status == ERROR)
+    /* Loop through the bands in the XML file and convert them to GeoTIFF.
+       The filenames will have the GeoTIFF base name followed by _ and the
+       band name of each band in the XML file.  Blank spaced in the band name
+       will be replaced with underscores. */
+    convert.xml_metadata = &xml_metadata;
+    convert.gtif_file = gtif_file;
+    convert.del_src = del_src;
+    convert.cog = cog;
+    convert.compression = compression;
+    convert.incremental = use_espa_incremental ();
+    if (espa_parallel_for (xml_metadata.nbands, 0, convert_gtif_loop_band,
+        &convert) != SUCCESS)
         return (ERROR);
 
     /* Remove the source XML if specified */
@@ -223,3 +603,392 @@ int convert_espa_to_gtif
     return (SUCCESS);
 }
 
+
+
+/* State of the GeoTIFF export sink */
+typedef struct
+{
+    char gtif_file[STR_SIZE];       /* base output GeoTIFF filename */
+    char (*gtif_band)[STR_SIZE];    /* GeoTIFF file of each band */
+    int strip_lines;                /* number of lines per strip */
+    TIFF *tiff;                     /* GeoTIFF of the current band */
+    Espa_inputs_key_t *key;         /* key of the inputs of each band when
+                                       exporting incrementally; NULL
+                                       otherwise */
+    bool *current;                  /* is the GeoTIFF of each band kept from
+                                       an earlier run? */
+} Gtif_export_t;
+
+
+/******************************************************************************
+MODULE:  gtif_export_needs_band
+
+PURPOSE: Determines whether the GeoTIFF of a band is written by the export
+fan-out, rather than kept from an earlier run.
+
+RETURN VALUE:
+Type = bool
+Value           Description
+-----           -----------
+true            The GeoTIFF is written
+false           The GeoTIFF is kept
+
+NOTES:
+******************************************************************************/
+static bool gtif_export_needs_band
+(
+    void *state,                        /* I: state of the sink */
+    Espa_internal_meta_t *xml_metadata, /* I: XML metadata structure */
+    int band                            /* I: index of the band */
+)
+{
+    Gtif_export_t *gtif = state;        /* state of the sink */
+
+    return (gtif->current == NULL || !gtif->current[band]);
+}
+
+
+/******************************************************************************
+MODULE:  free_gtif_export
+
+PURPOSE: Frees the state of the GeoTIFF export sink.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+static void free_gtif_export
+(
+    Gtif_export_t *gtif,                /* I: state of the sink */
+    int nbands                          /* I: number of bands */
+)
+{
+    int i;                      /* looping variable for each band */
+
+    if (gtif->key != NULL)
+    {
+        for (i = 0; i < nbands; i++)
+            free_espa_inputs_key (&gtif->key[i]);
+        free (gtif->key);
+    }
+    free (gtif->current);
+    free (gtif->gtif_band);
+    free (gtif);
+}
+
+
+/******************************************************************************
+MODULE:  begin_gtif_export_band
+
+PURPOSE: Creates the GeoTIFF file of a band fed by the export fan-out.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error creating the GeoTIFF
+SUCCESS         Successfully created the GeoTIFF
+
+NOTES:
+******************************************************************************/
+static int begin_gtif_export_band
+(
+    void *state,                        /* I/O: state of the sink */
+    Espa_internal_meta_t *xml_metadata, /* I: XML metadata structure */
+    int band                            /* I: index of the band */
+)
+{
+    Gtif_export_t *gtif = state;        /* state of the sink */
+
+    if (gtif->key != NULL &&
+        invalidate_espa_output (gtif->gtif_band[band]) != SUCCESS)
+        return (ERROR);
+
+    espa_log_printf (ESPA_LOG_INFO, "Converting %s to %s\n",
+        is_constant_band (&xml_metadata->band[band]) ? "constant band" :
+        xml_metadata->band[band].file_name, gtif->gtif_band[band]);
+    gtif->tiff = open_gtif_band (xml_metadata, band, gtif->gtif_band[band],
+        gtif->strip_lines);
+    if (gtif->tiff == NULL)
+        return (ERROR);
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  write_gtif_export_block
+
+PURPOSE: Writes a block of lines fed by the export fan-out as a strip of the
+GeoTIFF of the band.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the lines
+SUCCESS         Successfully wrote the lines
+
+NOTES:
+******************************************************************************/
+static int write_gtif_export_block
+(
+    void *state,                        /* I/O: state of the sink */
+    Espa_internal_meta_t *xml_metadata, /* I: XML metadata structure */
+    int band,                           /* I: index of the band */
+    Espa_band_block_t *block            /* I: block of lines */
+)
+{
+    Gtif_export_t *gtif = state;        /* state of the sink */
+
+    return (write_tiff_lines (gtif->tiff, xml_metadata->band[band].data_type,
+        block->line0, block->nlines, block->nsamps, block->band_buf[0]));
+}
+
+
+/******************************************************************************
+MODULE:  end_gtif_export_band
+
+PURPOSE: Closes the GeoTIFF of a band fed by the export fan-out and writes its
+world file, and the record of its inputs when exporting incrementally.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the world file or the record
+SUCCESS         Successfully completed the GeoTIFF
+
+NOTES:
+******************************************************************************/
+static int end_gtif_export_band
+(
+    void *state,                        /* I/O: state of the sink */
+    Espa_internal_meta_t *xml_metadata, /* I: XML metadata structure */
+    int band                            /* I: index of the band */
+)
+{
+    Gtif_export_t *gtif = state;        /* state of the sink */
+
+    close_tiff (gtif->tiff);
+    gtif->tiff = NULL;
+    if (write_gtif_world_file (xml_metadata, band, gtif->gtif_band[band])
+        != SUCCESS)
+        return (ERROR);
+
+    if (gtif->key != NULL && record_espa_output_inputs
+        (gtif->gtif_band[band], &gtif->key[band]) != SUCCESS)
+        return (ERROR);
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  finish_gtif_export
+
+PURPOSE: Writes the XML file of the GeoTIFF product once all the bands have
+been exported, and frees the state of the sink.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the XML file
+SUCCESS         Successfully completed the GeoTIFF product
+
+NOTES:
+  1. The world files of the GeoTIFFs kept from an earlier run are written
+     again along with the XML file.
+******************************************************************************/
+static int finish_gtif_export
+(
+    void *state,                        /* I: state of the sink */
+    Espa_internal_meta_t *xml_metadata, /* I: XML metadata structure */
+    bool complete                       /* I: were all the bands exported? */
+)
+{
+    char FUNC_NAME[] = "finish_gtif_export";  /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    char xml_file[STR_SIZE];    /* new XML file for the GeoTIFF product */
+    int count;                  /* number of chars copied in snprintf */
+    int i;                      /* looping variable for each band */
+    int status = SUCCESS;       /* return status */
+    Gtif_export_t *gtif = state;  /* state of the sink */
+
+    if (gtif->tiff != NULL)
+        close_tiff (gtif->tiff);
+
+    for (i = 0; complete && gtif->current != NULL &&
+        i < xml_metadata->nbands; i++)
+    {
+        if (gtif->current[i] && write_gtif_world_file (xml_metadata, i,
+            gtif->gtif_band[i]) != SUCCESS)
+            status = ERROR;
+    }
+
+    if (complete && status == SUCCESS)
+    {
+        count = snprintf (xml_file, sizeof (xml_file), "%s_gtif.xml",
+            gtif->gtif_file);
+        if (count < 0 || count >= sizeof (xml_file))
+        {
+            sprintf (errmsg, "Overflow of xml_file string");
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+        }
+        else if (write_export_metadata (xml_metadata, gtif->gtif_band,
+            xml_file) != SUCCESS)
+        {
+            sprintf (errmsg, "Error writing updated XML for the GeoTIFF "
+                "product: %s", xml_file);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+        }
+    }
+
+    free_gtif_export (gtif, xml_metadata->nbands);
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  init_gtif_export_sink
+
+PURPOSE: Sets up an export sink which writes the GeoTIFF product from the
+blocks fed by the export fan-out (see export_espa_fanout).
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error setting up the sink
+SUCCESS         Successfully set up the sink
+
+NOTES:
+  1. The GeoTIFF files and the XML file are named as by convert_espa_to_gtif.
+  2. Each block is written as one strip, so the fan-out must use the same
+     number of lines per block as specified here.
+  3. Cloud-Optimized GeoTIFFs are not supported, since their overviews need
+     the entire band (see write_cog_band).
+  4. If ESPA_INCREMENTAL_ENV is set, the bands whose GeoTIFFs are current
+     are skipped by the fan-out (see espa_incremental.h).
+******************************************************************************/
+int init_gtif_export_sink
+(
+    char *gtif_file,       /* I: base output GeoTIFF filename */
+    Espa_internal_meta_t *xml_metadata, /* I: XML metadata structure */
+    int block_lines,       /* I: number of lines per block of the fan-out */
+    Espa_export_sink_t *sink  /* O: GeoTIFF export sink */
+)
+{
+    char FUNC_NAME[] = "init_gtif_export_sink";  /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    int i;                      /* looping variable for each band */
+    Gtif_export_t *gtif = NULL; /* state of the sink */
+
+    gtif = calloc (1, sizeof (Gtif_export_t));
+    if (gtif != NULL)
+        gtif->gtif_band = calloc (xml_metadata->nbands, STR_SIZE);
+    if (gtif == NULL || gtif->gtif_band == NULL)
+    {
+        sprintf (errmsg, "Allocating the GeoTIFF export sink");
+        error_handler (true, FUNC_NAME, errmsg);
+        free (gtif);
+        return (ERROR);
+    }
+
+    if (strlen (gtif_file) >= sizeof (gtif->gtif_file))
+    {
+        sprintf (errmsg, "Overflow of gtif_file string");
+        error_handler (true, FUNC_NAME, errmsg);
+        free (gtif->gtif_band);
+        free (gtif);
+        return (ERROR);
+    }
+    strcpy (gtif->gtif_file, gtif_file);
+
+    for (i = 0; i < xml_metadata->nbands; i++)
+    {
+        if (gtif_band_name (gtif_file, xml_metadata->band[i].name,
+            gtif->gtif_band[i]) != SUCCESS)
+        {
+            sprintf (errmsg, "Overflow of gtif_file string");
+            error_handler (true, FUNC_NAME, errmsg);
+            free (gtif->gtif_band);
+            free (gtif);
+            return (ERROR);
+        }
+    }
+    gtif->strip_lines = block_lines;
+
+    /* Find the GeoTIFFs which can be kept from an earlier run */
+    if (use_espa_incremental ())
+    {
+        gtif->key = calloc (xml_metadata->nbands, sizeof (Espa_inputs_key_t));
+        gtif->current = calloc (xml_metadata->nbands, sizeof (bool));
+        if (gtif->key == NULL || gtif->current == NULL)
+        {
+            sprintf (errmsg, "Allocating the inputs of the GeoTIFF bands");
+            error_handler (true, FUNC_NAME, errmsg);
+            free_gtif_export (gtif, 0);
+            return (ERROR);
+        }
+
+        for (i = 0; i < xml_metadata->nbands; i++)
+        {
+            if (gtif_inputs_key (xml_metadata, i, false, COG_COMPRESS_NONE,
+                block_lines, &gtif->key[i]) != SUCCESS)
+            {
+                sprintf (errmsg, "Determining the inputs of band %s",
+                    xml_metadata->band[i].name);
+                error_handler (true, FUNC_NAME, errmsg);
+                free_gtif_export (gtif, xml_metadata->nbands);
+                return (ERROR);
+            }
+            gtif->current[i] = espa_output_is_current (gtif->gtif_band[i],
+                &gtif->key[i]);
+            if (gtif->current[i])
+                espa_log_printf (ESPA_LOG_INFO, "Keeping %s, whose inputs "
+                    "are unchanged\n", gtif->gtif_band[i]);
+        }
+    }
+
+    strcpy (sink->name, "GeoTIFF");
+    sink->state = gtif;
+    sink->needs_band = gtif_export_needs_band;
+    sink->begin_band = begin_gtif_export_band;
+    sink->write_block = write_gtif_export_block;
+    sink->end_band = end_gtif_export_band;
+    sink->finish = finish_gtif_export;
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  gtif_export_entry
+
+PURPOSE: Entry point of the GeoTIFF format in the export registry (see
+espa_export_registry.h), which sets up its export sink.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error setting up the sink
+SUCCESS         Successfully set up the sink
+
+NOTES:
+******************************************************************************/
+int gtif_export_entry
+(
+    char *out_file,        /* I: base output GeoTIFF filename */
+    Espa_internal_meta_t *xml_metadata, /* I: XML metadata structure */
+    const Espa_export_options_t *options,  /* I: export options */
+    Espa_export_sink_t *sink  /* O: GeoTIFF export sink */
+)
+{
+    return (init_gtif_export_sink (out_file, xml_metadata,
+        options->block_lines, sink));
+}
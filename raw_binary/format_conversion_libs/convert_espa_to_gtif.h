@@ -22,6 +22,12 @@ NOTES:
 #include "espa_metadata.h"
 #include "parse_metadata.h"
 #include "write_metadata.h"
+#include "envi_header.h"
+#include "espa_band_stack.h"
+#include "tiff_io.h"
+#include "tiff_cog.h"
+#include "espa_export_registry.h"
+#include "espa_incremental.h"
 
 /* Defines */
 
@@ -30,8 +36,10 @@ int convert_espa_to_gtif
 (
     char *espa_xml_file,   /* I: input ESPA XML metadata filename */
     char *gtif_file,       /* I: base output GeoTIFF filename */
-    bool del_src           /* I: should the source files be removed after
+    bool del_src,          /* I: should the source files be removed after
                                  conversion? */
+    bool cog,              /* I: should Cloud-Optimized GeoTIFFs be written? */
+    Cog_compression_t compression  /* I: compression of the COG tiles */
 );
 
 #endif
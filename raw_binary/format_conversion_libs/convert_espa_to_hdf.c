@@ -15,12 +15,25 @@ NOTES:
      metadata format found in ESPA Raw Binary Format v1.0.doc.  The schema for
      the ESPA internal metadata format is available at
      http://espa.cr.usgs.gov/schema/espa_internal_metadata_v1_0.xsd.
+  2. The bands can instead be written into internal SDSs of deflate or szip
+     compressed chunks, for a smaller product in a single file.
 *****************************************************************************/
 
 #include <unistd.h>
+#include <errno.h>
 #include <math.h>
+#include <sys/stat.h>
 #include "HE2_config.h"
 #include "convert_espa_to_hdf.h"
+#include "espa_trace.h"
+#include "espa_log.h"
+#include "espa_task_pool.h"
+#include "espa_buffer_pool.h"
+#include "raw_binary_advise.h"
+#include "espa_shm.h"
+
+/* Maximum number of values in a numeric attribute (ex. valid_range) */
+#define MAX_ATTR_VALUES 2
 
 #define OUTPUT_PROVIDER ("DataProvider")
 #define OUTPUT_SAT ("Satellite")
@@ -82,7 +95,7 @@ int write_global_attributes
     char errmsg[STR_SIZE];        /* error message */
     char hdf_version[] = H4_VERSION;  /* version for HDF4 */
     char hdfeos_version[] = PACKAGE_VERSION;  /* version for HDFEOS */
-    double dval[MAX_TOTAL_BANDS]; /* attribute values to be written */
+    double dval[MAX_ATTR_VALUES]; /* attribute values to be written */
     Espa_hdf_attr_t attr;         /* attribute fields */
     Espa_global_meta_t *gmeta = &xml_metadata->global;
                                   /* pointer to global metadata structure */
@@ -348,7 +361,7 @@ int write_sds_attributes
     char message[5000];         /* description of QA bits or classes */
     int i;                      /* looping variable for each SDS */
     int count;                  /* number of chars copied in snprintf */
-    double dval[MAX_TOTAL_BANDS];/* attribute values to be written */
+    double dval[MAX_ATTR_VALUES];/* attribute values to be written */
     Espa_hdf_attr_t attr;       /* attribute fields */
 
     /* Write the band-related attributes to the SDS.  Some are required and
@@ -563,432 +576,1249 @@ int write_sds_attributes
 
 
 /******************************************************************************
-MODULE:  create_hdf_metadata
+MODULE:  write_hdf_external_band
 
-PURPOSE: Create the HDF metadata file, using info from the XML file, which will
-point to the existing raw binary bands as external SDSs.
+PURPOSE: Streams the raw binary band to the big endian external file used by
+its SDS, byte-swapping one block of lines at a time.
 
 RETURN VALUE:
 Type = int
 Value           Description
 -----           -----------
-ERROR           Error creating the HDF file
-SUCCESS         Successfully created the HDF file
+ERROR           Error reading the band or writing the external file
+SUCCESS         Successfully wrote the external file
 
 NOTES:
-  1. The ESPA products are 2D thus only 2D products are supported.
-  2. XDim, YDim will refer to the x,y dimension size in the first SDS.  From
-     there, different x,y dimensions will contain the pixel size at the end of
-     XDim, YDim.  Example: XDim_15, YDim_15.  For Geographic projections, the
-     name will be based on the count of grids instead of the pixel size.
+  1. It's assumed we are running on Linux, thus the raw binary bands are
+     little endian.  HDF uses big endian for the external SDS data.
+  2. Only a few blocks of the band are resident at any time, rather than the
+     entire band.
+  3. The native (little endian) value of the last pixel is returned so the
+     caller can write it through HDF, which registers the full extent of the
+     data already in the external file.
+  4. The bands are pipelined: once the last block of this band is in hand,
+     the band stack of the next band to be streamed is opened, so its blocks are read ahead
+     while the last block and the coalescing buffer of this band are written
+     and the caller sets up the SDS.  The next band stack is handed back to
+     the caller for the next call.  At most the blocks of two band stacks
+     are resident.
+  5. The checksum is of the big endian pixels, so it is the checksum of the
+     external file, for the journal of the conversion (see espa_journal.h).
 ******************************************************************************/
-int create_hdf_metadata
+int write_hdf_external_band
 (
-    char *hdf_file,                     /* I: output HDF filename */
     Espa_internal_meta_t *xml_metadata, /* I: XML metadata structure */
-    bool del_src           /* I: should the source files be removed after
-                                 conversion? */
+    int band,              /* I: index of the band in the metadata */
+    int next_band,         /* I: index of the next band to be streamed; -1
+                                 if this is the last one */
+    int nbytes,            /* I: number of bytes per pixel */
+    char *bendian_file,    /* I: name of the big endian external file */
+    void *last_pix,        /* O: native value of the last pixel in the band;
+                                 at least nbytes */
+    char *checksum,        /* O: checksum of the external file (see
+                                 raw_binary_checksum.h); at least
+                                 RB_CHECKSUM_LEN bytes */
+    Espa_band_stack_t **stack  /* I/O: on input, the band stack of this band
+                                 or NULL to open it here; on output, the band
+                                 stack of next_band or NULL if this is the
+                                 last band (or on error) */
 )
 {
-    char FUNC_NAME[] = "create_hdf_metadata";  /* function name */
+    char FUNC_NAME[] = "write_hdf_external_band";  /* function name */
     char errmsg[STR_SIZE];        /* error message */
-    char bendian_file[STR_SIZE];  /* name of output big endian img file */
-    char dim_name[2][STR_SIZE];   /* array of dimension names */
-    char hdr_file[STR_SIZE];      /* ENVI header file */
-    char *cptr = NULL;            /* pointer to the file extension */
-    int i;                        /* looping variable for each SDS */
-    int nbytes;                   /* number of bytes in the data type */
-    int nlines;                   /* number of lines in the band */
-    int nsamps;                   /* number of samples in the band */
-    int dim;                      /* looping variable for dimensions */
-    int count;                    /* number of chars copied in snprintf */
-    int ngrids;                   /* current number of grids in the product;
-                                     different grids are written for different
-                                     resolutions (1-based) */
-    int mycount;                  /* integer value to use in the name of the
-                                     2nd, 3rd, etc. grid dimensions */
-    int32 hdf_id;                 /* HDF file ID */
-    int32 sds_id;                 /* ID for each SDS */
-    int32 dim_id;                 /* ID for current dimension in SDS */
-    int32 data_type;              /* data type for HDF file */
-    int32 rank = 2;               /* rank of the SDS; set for 2D products */
-    int32 dims[2];                /* array for dimension sizes; only 2D prods */
-    int32 start[2];               /* starting location to write the HDF data */
-    int32 edge[2];                /* number of values to write the HDF data */
-    FILE *fp_rb = NULL;           /* file pointer for the raw binary file */
-    void *file_buf = NULL;        /* pointer to correct input file buffer */
-
-    /* Open the HDF file for creation (overwriting if it exists) */
-    hdf_id = SDstart (hdf_file, DFACC_CREATE);
-    if (hdf_id == HDF_ERROR)
+    int status;                   /* return status */
+    size_t nvals;                 /* number of values in the current block */
+    Espa_band_meta_t *bmeta = &xml_metadata->band[band];  /* band metadata */
+    Espa_band_stack_t *band_stack = *stack; /* band stack for reading the
+                                               band */
+    Espa_band_stack_t *next_stack = NULL;   /* band stack of the next band */
+    Espa_band_block_t *block = NULL;    /* current block of lines */
+    Raw_binary_writer_t *writer = NULL; /* writer for the external file */
+    Espa_trace_span_t span;             /* timing of the current swap or
+                                           write */
+    ESPA_TRACE_SCOPE (trace, "export_band", bmeta->name);  /* timing */
+
+    /* Read ahead the band and write the external file in large writes */
+    *stack = NULL;
+    if (band_stack == NULL)
+        band_stack = open_band_stack (xml_metadata, 1, &band,
+            espa_band_stack_lines (xml_metadata, 1, &band,
+            RB_PREFETCH_DEFAULT_LINES, 1), 0);
+    if (band_stack == NULL)
     {
-        sprintf (errmsg, "Creating the HDF file: %s", hdf_file);
+        sprintf (errmsg, "Opening the input raw binary file: %s",
+            bmeta->file_name);
         error_handler (true, FUNC_NAME, errmsg);
         return (ERROR);
     }
 
-    /* Loop through the bands in the XML file and set each band as an
-       external SDS in this HDF file */
-    ngrids = 1;
-    for (i = 0; i < xml_metadata->nbands; i++)
+    writer = open_raw_binary_writer (bendian_file, (size_t) bmeta->nlines *
+        bmeta->nsamps * nbytes, 0);
+    if (writer == NULL)
     {
-        /* Provide the status of processing */
-        printf ("Processing SDS: %s\n", xml_metadata->band[i].name);
+        sprintf (errmsg, "Opening the big endian file: %s", bendian_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        close_band_stack (band_stack);
+        return (ERROR);
+    }
 
-        /* Open the file for this band of data to allow for reading */
-        fp_rb = open_raw_binary (xml_metadata->band[i].file_name, "rb");
-        if (fp_rb == NULL)
+    while (1)
+    {
+        if (get_band_stack_block (band_stack, &block) != SUCCESS)
         {
-            sprintf (errmsg, "Opening the input raw binary file: %s",
-                xml_metadata->band[i].file_name);
+            sprintf (errmsg, "Reading image data from the raw binary file");
             error_handler (true, FUNC_NAME, errmsg);
+            close_raw_binary_writer (writer);
+            close_band_stack (band_stack);
+            if (next_stack != NULL)
+                close_band_stack (next_stack);
             return (ERROR);
         }
+        if (block == NULL)
+            break;   /* all lines have been written */
 
-        /* Define the dimensions for this band */
-        nlines = xml_metadata->band[i].nlines;
-        nsamps = xml_metadata->band[i].nsamps;
-        dims[0] = nlines;
-        dims[1] = nsamps;
-
-        /* Determine the HDF data type */
-        switch (xml_metadata->band[i].data_type)
+        /* Hang on to the last pixel before it is swapped, and start reading
+           ahead the next band */
+        nvals = (size_t) block->nlines * block->nsamps;
+        if (block->line0 + block->nlines == bmeta->nlines)
         {
-            case (ESPA_INT8):
-                data_type = DFNT_INT8;
-                nbytes = 1;
-                break;
-            case (ESPA_UINT8):
-                data_type = DFNT_UINT8;
-                nbytes = 1;
-                break;
-            case (ESPA_INT16):
-                data_type = DFNT_INT16;
-                nbytes = 2;
-                break;
-            case (ESPA_UINT16):
-                data_type = DFNT_UINT16;
-                nbytes = 2;
-                break;
-            case (ESPA_INT32):
-                data_type = DFNT_INT32;
-                nbytes = 4;
-                break;
-            case (ESPA_UINT32):
-                data_type = DFNT_UINT32;
-                nbytes = 4;
-                break;
-            case (ESPA_FLOAT32):
-                data_type = DFNT_FLOAT32;
-                nbytes = 4;
-                break;
-            case (ESPA_FLOAT64):
-                data_type = DFNT_FLOAT64;
-                nbytes = 8;
-                break;
-            default:
-                sprintf (errmsg, "Unsupported ESPA data type.");
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
+            memcpy (last_pix, (char *) block->band_buf[0] +
+                (nvals - 1) * nbytes, nbytes);
+            if (next_band >= 0 && next_stack == NULL)
+            {
+                next_stack = open_band_stack (xml_metadata, 1, &next_band,
+                    espa_band_stack_lines (xml_metadata, 1, &next_band,
+                    RB_PREFETCH_DEFAULT_LINES, 1), 0);
+                if (next_stack == NULL)
+                {
+                    sprintf (errmsg, "Opening the input raw binary file: %s",
+                        xml_metadata->band[next_band].file_name);
+                    error_handler (true, FUNC_NAME, errmsg);
+                    close_raw_binary_writer (writer);
+                    close_band_stack (band_stack);
+                    return (ERROR);
+                }
+            }
         }
 
-        /* Allocate memory for the file buffer */
-        file_buf = calloc (nlines * nsamps, nbytes);
-        if (file_buf == NULL)
+        /* Swap the block in place and write it out */
+        span = espa_trace_begin ("convert_block", bmeta->name);
+        status = swap_raw_binary_bytes (block->band_buf[0],
+            block->band_buf[0], nvals, nbytes);
+        espa_trace_end (&span);
+        if (status == SUCCESS)
         {
-            sprintf (errmsg, "Error allocating memory for the file buffer.");
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
+            span = espa_trace_begin ("write_block", bmeta->name);
+            status = append_raw_binary_writer (writer, block->nlines,
+                block->nsamps, nbytes, block->band_buf[0]);
+            espa_trace_end (&span);
         }
-
-        /* Read the data from the raw binary file */
-        if (read_raw_binary (fp_rb, nlines, nsamps, nbytes, file_buf) !=
-            SUCCESS)
+        if (status != SUCCESS)
         {
-            sprintf (errmsg, "Reading image data from the raw binary file");
+            sprintf (errmsg, "Writing lines %d-%d to the big endian file: %s",
+                block->line0, block->line0 + block->nlines - 1, bendian_file);
             error_handler (true, FUNC_NAME, errmsg);
+            close_raw_binary_writer (writer);
+            close_band_stack (band_stack);
+            if (next_stack != NULL)
+                close_band_stack (next_stack);
             return (ERROR);
         }
+    }
 
-        /* Close the raw binary file */
-        close_raw_binary (fp_rb);
-
-        /* Find the location of the file extension, then modify the filename
-           a bit to depict the big endian version of the imagery needed for
-           the HDF files.  (It's assumed we are running on Linux, thus the
-           current output files will be little endian.  HDF uses big endian
-           for their byte order.) */
-        count = snprintf (bendian_file, sizeof (bendian_file), "%s",
-            xml_metadata->band[i].file_name);
-        if (count < 0 || count >= sizeof (bendian_file))
-        {
-            sprintf (errmsg, "Overflow of bendian_file string");
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
+    close_band_stack (band_stack);
+    get_raw_binary_writer_checksum (writer, checksum);
+    if (close_raw_binary_writer (writer) != SUCCESS)
+    {
+        sprintf (errmsg, "Closing the big endian file: %s", bendian_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        if (next_stack != NULL)
+            close_band_stack (next_stack);
+        return (ERROR);
+    }
 
-        cptr = strrchr (bendian_file, '.');
-        if (cptr != NULL)
-            *cptr = '\0';
-        strcpy (cptr, "_hdf.img");
+    *stack = next_stack;
+    return (SUCCESS);
+}
 
-        /* Select/create the SDS index for the current band */
-        sds_id = SDcreate (hdf_id, xml_metadata->band[i].name, data_type,
-            rank, dims);
-        if (sds_id == HDF_ERROR)
-        {
-            sprintf (errmsg, "Creating SDS in the HDF file: %d.", i);
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
 
-        /* Set the dimension name for each dimension in this SDS.  The default
-           is to use YDim, XDim for the first band or for any bands
-           matching the resolution of the first band */
-        if (i == 0 ||
-            ((xml_metadata->band[i].pixel_size[0] ==
-             xml_metadata->band[0].pixel_size[0]) &&
-            (xml_metadata->band[i].pixel_size[1] ==
-             xml_metadata->band[0].pixel_size[1])))
-        {  /* first band or resolution matching the first band */
-            strcpy (dim_name[0], "YDim");
-            strcpy (dim_name[1], "XDim");
-        }
-        else
-        {  /* create new dimension name for this resolution */
-            /* Use the pixel size for non-geographic projections otherwise
-               use the grid count */
-            ngrids++;
-            if (xml_metadata->global.proj_info.proj_type == GCTP_GEO)
-                mycount = ngrids;
-            else
-                mycount = (int) xml_metadata->band[i].pixel_size[1]; /* Y dim */
-
-            count = snprintf (dim_name[0], sizeof (dim_name[0]), "YDim_%d",
-                mycount);  /* Y dim */
-            if (count < 0 || count >= sizeof (dim_name[0]))
-            {
-                sprintf (errmsg, "Overflow of dim_name[0] string");
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
-            }
+/******************************************************************************
+MODULE:  is_linked_hdf_band
 
-            if (xml_metadata->global.proj_info.proj_type == GCTP_GEO)
-                mycount = ngrids;
-            else
-                mycount = (int) xml_metadata->band[i].pixel_size[0]; /* X dim */
+PURPOSE: Determines if the raw binary band is used as-is as the external file
+of its SDS, rather than streamed out to a big endian copy.
 
-            count = snprintf (dim_name[1], sizeof (dim_name[1]), "XDim_%d",
-                mycount);  /* X dim */
-            if (count < 0 || count >= sizeof (dim_name[1]))
-            {
-                sprintf (errmsg, "Overflow of dim_name[1] string");
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
-            }
-        }
+RETURN VALUE:
+Type = bool
+Value           Description
+-----           -----------
+true            The band is linked as-is
+false           The band is copied to a big endian file
 
-        /* Write the dimension names to the HDF file */
-        for (dim = 0; dim < rank; dim++)
-        {
-            dim_id = SDgetdimid (sds_id, dim);
-            if (dim_id == HDF_ERROR) 
-            {
-                sprintf (errmsg, "Getting dimension id for dimension %d and "
-                    "SDS %d.", dim, i);
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
-            }
+NOTES:
+  1. Constant bands have no raw binary file, so they are always copied.
+  2. Encoded bands (see raw_binary_blocks.h) are always copied, since HDF
+     would read the compressed blocks of their files as pixels.
+  3. Tiled bands are always copied, since HDF expects the lines of an
+     external file in order rather than tile by tile.
+  4. Bands in shared memory (see espa_shm.h) are always copied, since the
+     HDF file can't name their segments, which are removed once the bands
+     are persisted.
+******************************************************************************/
+static bool is_linked_hdf_band
+(
+    Espa_band_meta_t *bmeta,   /* I: band metadata */
+    bool link_src              /* I: link the raw binary bands as-is? */
+)
+{
+    if (!link_src || is_constant_band (bmeta))
+        return (false);
 
-            if (SDsetdimname (dim_id, dim_name[dim]) == HDF_ERROR)
-            {
-                sprintf (errmsg, "Setting dimension name (%s) for dimension "
-                    "%d and SDS %d.", dim_name[dim], dim, i);
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
-            }
-        }
+    if (strcmp (bmeta->encoding, ESPA_STRING_META_FILL) &&
+        strcmp (bmeta->encoding, RB_ENCODING_RAW_NAME))
+        return (false);
 
-        /* Identify the external dataset for this SDS, starting at byte
-           location 0 since these are raw binary files without any headers */
-        if (SDsetexternalfile (sds_id, bendian_file, 0 /* offset */) ==
-            HDF_ERROR)
-        {
-            sprintf (errmsg, "Setting the external dataset for this SDS (%d): "
-                "%s.", i, bendian_file);
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
+    if (bmeta->tile_size > 0)
+        return (false);
 
-        /* Write the new big endian data to the SDS.  Start writing at the
-           beginning of the SDS, write every element, and write all the
-           elements in both dimensions. */
-        start[0] = start[1] = 0;
-        edge[0] = dims[0];
-        edge[1] = dims[1];
-        if (SDwritedata (sds_id, start, NULL, edge, file_buf) == HDF_ERROR)
-        {
-            sprintf (errmsg, "Writing the external dataset for this SDS (%d): "
-                "%s.", i, bendian_file);
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
+    if (is_espa_shm_name (bmeta->file_name))
+        return (false);
 
-        /* Write the SDS-level metadata */
-        if (write_sds_attributes (sds_id, &xml_metadata->band[i]) != SUCCESS)
-        {
-            sprintf (errmsg, "Writing band attributes for this SDS (%d).", i);
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
+    return (true);
+}
 
-        /* Terminate access to the data set and SD interface */
-        SDendaccess (sds_id);
 
-        /* Free the file buffer */
-        free (file_buf);
-        file_buf = NULL;
+/******************************************************************************
+MODULE:  is_internal_hdf_sds
 
-        /* Remove the source files if specified */
-        if (del_src)
-        {
-            /* .img file */
-            printf ("  Removing %s\n", xml_metadata->band[i].file_name);
-            if (unlink (xml_metadata->band[i].file_name) != 0)
-            {
-                sprintf (errmsg, "Deleting source file: %s",
-                    xml_metadata->band[i].file_name);
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
-            }
+PURPOSE: Determines if the SDSs hold the pixels of the bands internally, as
+compressed chunks, rather than pointing at external files.
 
-            /* .hdr file */
-            count = snprintf (hdr_file, sizeof (hdr_file), "%s",
-                xml_metadata->band[i].file_name);
-            if (count < 0 || count >= sizeof (hdr_file))
-            {
-                sprintf (errmsg, "Overflow of hdr_file string");
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
-            }
+RETURN VALUE:
+Type = bool
+Value           Description
+-----           -----------
+true            The SDSs are internal and compressed
+false           The SDSs are external and uncompressed
 
-            cptr = strrchr (hdr_file, '.');
-            strcpy (cptr, ".hdr");
-            printf ("  Removing %s\n", hdr_file);
-            if (unlink (hdr_file) != 0)
-            {
-                sprintf (errmsg, "Deleting source file: %s", hdr_file);
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
-            }
-        }
-    }
+NOTES:
+******************************************************************************/
+static bool is_internal_hdf_sds
+(
+    Hdf_options_t *options     /* I: storage of the SDSs; NULL for external
+                                     SDSs */
+)
+{
+    return (options != NULL && options->compressor != HDF_COMPRESS_NONE);
+}
 
-    /* Write the global metadata */
-    if (write_global_attributes (hdf_id, xml_metadata) != SUCCESS)
-    {
-        sprintf (errmsg, "Writing global attributes for this HDF file.");
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
-    }
 
-    /* Terminate access to the HDF file */
-    SDend (hdf_id);
+/******************************************************************************
+MODULE:  hdf_chunk_shape
 
-    /* Write HDF-EOS attributes and metadata */
-    if (write_hdf_eos_attr (hdf_file, xml_metadata) != SUCCESS)
-    {
-        sprintf (errmsg, "Writing HDF-EOS attributes for this HDF file.");
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
-    }
+PURPOSE: Determines the number of lines and samples in a chunk of the
+internal SDS of a band, limited to the size of the band.
 
-    /* Successful conversion */
-    return (SUCCESS);
+RETURN VALUE: None
+
+NOTES:
+******************************************************************************/
+static void hdf_chunk_shape
+(
+    Espa_band_meta_t *bmeta,   /* I: metadata of the band */
+    Hdf_options_t *options,    /* I: chunking and compression of the SDSs */
+    int32 chunks[2]            /* O: number of lines and samples in a chunk */
+)
+{
+    chunks[0] = options->chunk_lines;
+    if (chunks[0] > bmeta->nlines)
+        chunks[0] = bmeta->nlines;
+    chunks[1] = options->chunk_samps;
+    if (chunks[1] == 0 || chunks[1] > bmeta->nsamps)
+        chunks[1] = bmeta->nsamps;
 }
 
 
+/* Block of lines whose chunks are copied out in parallel and written in
+   order */
+typedef struct
+{
+    int32 sds_id;               /* SDS of the band */
+    const char *name;           /* name of the band */
+    const unsigned char *lines; /* block of lines of the band */
+    int line0;                  /* first line of the block in the band */
+    int nlines;                 /* number of lines in the block */
+    int nsamps;                 /* number of samples per line */
+    int ncols;                  /* number of chunks across the band */
+    int nbytes;                 /* number of bytes in the data type */
+    const int32 *chunks;        /* number of lines and samples in a chunk */
+    size_t chunk_size;          /* number of bytes in a chunk */
+    unsigned char *chunk_buf;   /* each chunk of the block */
+} Hdf_chunk_block_t;
+
+
 /******************************************************************************
-MODULE:  convert_espa_to_hdf
+MODULE:  copy_hdf_block_chunk
 
-PURPOSE: Converts the internal ESPA raw binary file to HDF4 file format.
+PURPOSE: Copies one chunk out of a block of lines, as an iteration of the
+ordered parallel loop over the chunks of the block.
 
 RETURN VALUE:
 Type = int
 Value           Description
 -----           -----------
-ERROR           Error converting to HDF
-SUCCESS         Successfully converted to HDF
+SUCCESS         Always
 
 NOTES:
-  1. The ESPA raw binary band files will be used, as-is, and linked to as
-     external SDSs from the HDF file.
-  2. An ENVI header file will be written for the HDF files which contain
-     SDSs of the same resolution (i.e. not a multi-resolution product).
+  1. The part of an edge chunk outside the band is zero.
 ******************************************************************************/
-int convert_espa_to_hdf
+static int copy_hdf_block_chunk
 (
-    char *espa_xml_file,   /* I: input ESPA XML metadata filename */
-    char *hdf_file,        /* I: output HDF filename */
-    bool del_src           /* I: should the source files be removed after
-                                 conversion? */
+    void *arg,                  /* I/O: block of lines of the band */
+    int chunk,                  /* I: index of the chunk in the block */
+    int worker                  /* I: worker copying the chunk */
 )
 {
-    char FUNC_NAME[] = "convert_espa_to_hdf";  /* function name */
-    char errmsg[STR_SIZE];   /* error message */
-    char hdr_file[STR_SIZE]; /* ENVI header file */
-    char xml_file[STR_SIZE]; /* new XML file for the HDF product */
-    char bendian_file[STR_SIZE];  /* name of output big endian img file */
-    char *cptr = NULL;       /* pointer to empty space in the band name */
+    Hdf_chunk_block_t *blk = arg;  /* block of lines of the band */
+    int line;                   /* looping variable for the lines */
+    int row;                    /* row of the chunk in the block */
+    int rows;                   /* number of lines of the chunk in the band */
+    int samp0;                  /* first sample of the chunk */
+    int width;                  /* number of samples of the chunk in the
+                                   band */
+    const unsigned char *src;   /* first line of the chunk in the block */
+    unsigned char *dest;        /* chunk */
+
+    row = chunk / blk->ncols;
+    rows = blk->nlines - row * blk->chunks[0];
+    if (rows > blk->chunks[0])
+        rows = blk->chunks[0];
+    samp0 = (chunk % blk->ncols) * blk->chunks[1];
+    width = blk->nsamps - samp0;
+    if (width > blk->chunks[1])
+        width = blk->chunks[1];
+
+    dest = blk->chunk_buf + chunk * blk->chunk_size;
+    if (rows < blk->chunks[0] || width < blk->chunks[1])
+        memset (dest, 0, blk->chunk_size);
+    src = blk->lines + ((size_t) row * blk->chunks[0] * blk->nsamps + samp0)
+        * blk->nbytes;
+    for (line = 0; line < rows; line++)
+        memcpy (dest + (size_t) line * blk->chunks[1] * blk->nbytes,
+            src + (size_t) line * blk->nsamps * blk->nbytes,
+            (size_t) width * blk->nbytes);
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  write_hdf_block_chunk
+
+PURPOSE: Writes one chunk of a block of lines to the SDS of the band, which
+compresses it, as the report of the ordered parallel loop over the chunks of
+the block.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the chunk
+SUCCESS         Successfully wrote the chunk
+
+NOTES:
+  1. The reports are run one at a time, so only one thread is in HDF at a
+     time.
+******************************************************************************/
+static int write_hdf_block_chunk
+(
+    void *arg,                  /* I/O: block of lines of the band */
+    int chunk,                  /* I: index of the chunk in the block */
+    int status                  /* I: status of copying the chunk */
+)
+{
+    char FUNC_NAME[] = "write_hdf_block_chunk";  /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    Hdf_chunk_block_t *blk = arg;  /* block of lines of the band */
+    int32 origin[2];            /* row and column of the chunk in the SDS */
+
+    if (status != SUCCESS)
+        return (ERROR);
+
+    origin[0] = blk->line0 / blk->chunks[0] + chunk / blk->ncols;
+    origin[1] = chunk % blk->ncols;
+    if (SDwritechunk (blk->sds_id, origin, blk->chunk_buf + chunk *
+        blk->chunk_size) == HDF_ERROR)
+    {
+        sprintf (errmsg, "Writing chunk %d.%d of the SDS of band %s",
+            (int) origin[0], (int) origin[1], blk->name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  write_hdf_internal_sds
+
+PURPOSE: Chunks and compresses the internal SDS of a band, and writes the
+pixels of the band into it.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the SDS
+SUCCESS         Successfully wrote the SDS
+
+NOTES:
+  1. The band is read ahead by the band stack, one row of chunks per thread
+     of the task pool at a time.  The chunks of those rows are copied out in
+     parallel on the pool, and each is handed to SDwritechunk in order as
+     soon as it and the ones before it are ready.
+  2. HDF4 compresses the chunks itself within SDwritechunk.  Its interfaces
+     aren't thread-safe and don't take chunks compressed elsewhere, so the
+     chunks are compressed one at a time, overlapped with the copying of the
+     following chunks and the reading of the next block.
+  3. The SDS is created little endian (DFNT_LITEND), so HDF compresses the
+     pixels as they are read rather than converting them first.
+******************************************************************************/
+static int write_hdf_internal_sds
+(
+    int32 sds_id,               /* I: SDS of the band */
+    Espa_internal_meta_t *xml_metadata, /* I: XML metadata structure */
+    int band,                   /* I: index of the band in the metadata */
+    int nbytes,                 /* I: number of bytes per pixel */
+    Hdf_options_t *options      /* I: chunking and compression of the SDSs */
+)
+{
+    char FUNC_NAME[] = "write_hdf_internal_sds";  /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    int nthreads;               /* number of threads copying chunks */
+    int nrows;                  /* most rows of chunks in a block */
+    int nchunks;                /* number of chunks in the current block */
+    int block_lines;            /* number of lines in a full block */
+    int32 chunks[2];            /* number of lines and samples in a chunk */
+    unsigned char *chunk_buf = NULL;  /* chunks of the current block */
+    HDF_CHUNK_DEF chunk_def;    /* chunking and compression of the SDS */
+    Hdf_chunk_block_t blk;      /* block whose chunks are written */
+    Espa_band_meta_t *bmeta = &xml_metadata->band[band]; /* band metadata */
+    Espa_band_stack_t *stack = NULL; /* reader of the band */
+    Espa_band_block_t *block = NULL; /* current block of lines */
+    int status = ERROR;         /* return status */
+    ESPA_TRACE_SCOPE (trace, "export_band", bmeta->name);  /* timing */
+
+    /* Chunk and compress the SDS */
+    hdf_chunk_shape (bmeta, options, chunks);
+    memset (&chunk_def, 0, sizeof (chunk_def));
+    chunk_def.comp.chunk_lengths[0] = chunks[0];
+    chunk_def.comp.chunk_lengths[1] = chunks[1];
+    if (options->compressor == HDF_COMPRESS_SZIP)
+    {
+        chunk_def.comp.comp_type = COMP_CODE_SZIP;
+        chunk_def.comp.cinfo.szip.options_mask = SZ_NN_OPTION_MASK;
+        chunk_def.comp.cinfo.szip.pixels_per_block =
+            HDF_SZIP_PIXELS_PER_BLOCK;
+    }
+    else
+    {
+        chunk_def.comp.comp_type = COMP_CODE_DEFLATE;
+        chunk_def.comp.cinfo.deflate.level = options->level != 0 ?
+            options->level : DEFAULT_HDF_DEFLATE_LEVEL;
+    }
+    if (SDsetchunk (sds_id, chunk_def, HDF_CHUNK | HDF_COMP) == HDF_ERROR)
+    {
+        sprintf (errmsg, "Chunking and compressing the SDS of band %s",
+            bmeta->name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    nthreads = espa_task_pool_threads ();
+    blk.ncols = (bmeta->nsamps + chunks[1] - 1) / chunks[1];
+    block_lines = espa_band_stack_lines (xml_metadata, 1, &band,
+        chunks[0] * nthreads, chunks[0]);
+    if (block_lines > bmeta->nlines)
+        block_lines = bmeta->nlines;
+    nrows = (block_lines + chunks[0] - 1) / chunks[0];
+    blk.chunk_size = (size_t) chunks[0] * chunks[1] * nbytes;
+
+    stack = open_band_stack (xml_metadata, 1, &band, block_lines, 0);
+    chunk_buf = espa_buffer_get ((size_t) nrows * blk.ncols *
+        blk.chunk_size);
+    if (stack == NULL)
+    {
+        sprintf (errmsg, "Opening the input raw binary file: %s",
+            bmeta->file_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        goto cleanup;
+    }
+    if (chunk_buf == NULL)
+    {
+        sprintf (errmsg, "Allocating the chunks of band %s", bmeta->name);
+        error_handler (true, FUNC_NAME, errmsg);
+        goto cleanup;
+    }
+
+    blk.sds_id = sds_id;
+    blk.name = bmeta->name;
+    blk.nsamps = bmeta->nsamps;
+    blk.nbytes = nbytes;
+    blk.chunks = chunks;
+    blk.chunk_buf = chunk_buf;
+    while (1)
+    {
+        if (get_band_stack_block (stack, &block) != SUCCESS)
+        {
+            sprintf (errmsg, "Reading image data from the raw binary file");
+            error_handler (true, FUNC_NAME, errmsg);
+            goto cleanup;
+        }
+        if (block == NULL)
+            break;   /* all lines have been written */
+        blk.lines = block->band_buf[0];
+        blk.line0 = block->line0;
+        blk.nlines = block->nlines;
+
+        /* Each chunk of the block has its own buffer, since a worker may
+           copy another chunk before the one it copied is written */
+        nchunks = (block->nlines + chunks[0] - 1) / chunks[0] * blk.ncols;
+        if (espa_parallel_for_ordered (nchunks, nthreads,
+            copy_hdf_block_chunk, write_hdf_block_chunk, &blk) != SUCCESS)
+        {
+            sprintf (errmsg, "Writing lines %d-%d to the SDS of band %s",
+                block->line0, block->line0 + block->nlines - 1, bmeta->name);
+            error_handler (true, FUNC_NAME, errmsg);
+            goto cleanup;
+        }
+    }
+    status = SUCCESS;
+
+cleanup:
+    close_band_stack (stack);
+    espa_buffer_put (chunk_buf);
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  next_hdf_stream_band
+
+PURPOSE: Finds the next band after the specified band which is streamed out
+to a big endian file.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+-1              None of the following bands are streamed
+>= 0            Index of the next streamed band
+
+NOTES:
+  1. Bands completed by an interrupted run are not streamed again.
+******************************************************************************/
+static int next_hdf_stream_band
+(
+    Espa_internal_meta_t *xml_metadata, /* I: XML metadata structure */
+    int band,                  /* I: index of the current band */
+    bool link_src,             /* I: link the raw binary bands as-is? */
+    const bool *done           /* I: was each band completed by an
+                                     interrupted run?  NULL if none were */
+)
+{
+    int i;                     /* looping variable for the bands */
+
+    for (i = band + 1; i < xml_metadata->nbands; i++)
+        if (!is_linked_hdf_band (&xml_metadata->band[i], link_src) &&
+            (done == NULL || !done[i]))
+            return (i);
+
+    return (-1);
+}
+
+
+/******************************************************************************
+MODULE:  read_hdf_last_pixel
+
+PURPOSE: Reads the last pixel of a band from its raw binary file or its big
+endian external file.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error reading the pixel
+SUCCESS         Successfully read the pixel
+
+NOTES:
+  1. A linked band is not streamed, so its last pixel is read on its own for
+     the caller to write through HDF (see write_hdf_external_band).  So is
+     the last pixel of a band completed by an interrupted run, from its big
+     endian file.
+******************************************************************************/
+static int read_hdf_last_pixel
+(
+    Espa_band_meta_t *bmeta,   /* I: band metadata */
+    char *file_name,           /* I: raw binary file of the band, or its big
+                                     endian external file */
+    long file_offset,          /* I: byte offset of the band in file_name */
+    bool big_endian,           /* I: is file_name the big endian file? */
+    int nbytes,                /* I: number of bytes per pixel */
+    void *last_pix             /* O: native value of the last pixel in the
+                                     band; at least nbytes */
+)
+{
+    char FUNC_NAME[] = "read_hdf_last_pixel";  /* function name */
+    char errmsg[STR_SIZE];     /* error message */
+    int fd;                    /* file descriptor of the band */
+    int status;                /* return status */
+
+    fd = open_raw_binary_band_fd (file_name, file_offset, false);
+    if (fd < 0)
+    {
+        sprintf (errmsg, "Opening the raw binary file: %s", file_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    status = read_raw_binary_window (fd, bmeta->nsamps, bmeta->nlines - 1, 1,
+        bmeta->nsamps - 1, 1, nbytes, last_pix);
+    close_raw_binary_fd (fd);
+    if (status == SUCCESS && big_endian)
+        status = swap_raw_binary_bytes (last_pix, last_pix, 1, nbytes);
+    if (status != SUCCESS)
+    {
+        sprintf (errmsg, "Reading the last pixel of the raw binary file: %s",
+            file_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  hdf_external_name
+
+PURPOSE: Determines the name of the external file of the SDS of a band.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           The name doesn't fit in STR_SIZE characters
+SUCCESS         Successfully determined the name
+
+NOTES:
+  1. A linked band uses its raw binary file.  Otherwise the file extension of
+     the raw binary file is replaced by _hdf.img for the big endian copy.
+  2. The big endian copy of a band in shared memory is written to disk,
+     under the name of the band without its ESPA_SHM_PREFIX.
+******************************************************************************/
+static int hdf_external_name
+(
+    Espa_band_meta_t *bmeta,   /* I: band metadata */
+    bool linked,               /* I: is the band linked as-is? */
+    char *bendian_file         /* O: name of the external file; at least
+                                     STR_SIZE characters */
+)
+{
+    char *cptr = NULL;         /* pointer to the file extension */
+    const char *file_name = bmeta->file_name;  /* name of the raw binary
+                                                  file */
+    int count;                 /* number of chars copied in snprintf */
+
+    if (!linked && is_espa_shm_name (file_name))
+        file_name += strlen (ESPA_SHM_PREFIX);
+
+    count = snprintf (bendian_file, STR_SIZE, "%s", file_name);
+    if (count < 0 || count >= STR_SIZE)
+        return (ERROR);
+    if (linked)
+        return (SUCCESS);
+
+    cptr = strrchr (bendian_file, '.');
+    if (cptr == NULL)
+        cptr = bendian_file + count;
+    if (cptr - bendian_file + strlen ("_hdf.img") >= STR_SIZE)
+        return (ERROR);
+    strcpy (cptr, "_hdf.img");
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  find_hdf_journaled_bands
+
+PURPOSE: Finds the bands whose big endian files were completed by an
+interrupted run, according to the journal of the conversion.
+
+RETURN VALUE:
+Type = bool *
+Value           Description
+-----           -----------
+NULL            Error allocating memory
+non-NULL        Whether each band was completed; to be freed by the caller
+
+NOTES:
+  1. A band counts as completed only if its big endian file still has the
+     size and checksum recorded in the journal (see espa_journal.h).  Linked
+     bands have no big endian file, so they are never completed.
+******************************************************************************/
+static bool *find_hdf_journaled_bands
+(
+    Espa_journal_t *journal,            /* I: journal of the conversion */
+    Espa_internal_meta_t *xml_metadata, /* I: XML metadata structure */
+    bool link_src          /* I: link the raw binary bands as-is? */
+)
+{
+    char FUNC_NAME[] = "find_hdf_journaled_bands";  /* function name */
+    char errmsg[STR_SIZE];        /* error message */
+    char bendian_file[STR_SIZE];  /* name of the big endian img file */
+    int i;                        /* looping variable for each band */
+    bool *done = NULL;            /* was each band completed? */
+    const Espa_journal_entry_t *entry = NULL;  /* journal of the band */
+
+    done = calloc (xml_metadata->nbands, sizeof (bool));
+    if (done == NULL)
+    {
+        sprintf (errmsg, "Allocating memory for the completed bands");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (NULL);
+    }
+
+    for (i = 0; i < xml_metadata->nbands; i++)
+    {
+        if (is_linked_hdf_band (&xml_metadata->band[i], link_src) ||
+            hdf_external_name (&xml_metadata->band[i], false, bendian_file)
+            != SUCCESS)
+            continue;
+
+        entry = find_espa_journal_entry (journal, xml_metadata->band[i].name,
+            xml_metadata->band[i].checksum);
+        done[i] = entry != NULL && !strcmp (entry->output, bendian_file) &&
+            verify_espa_journal_file (entry);
+    }
+
+    return (done);
+}
+
+
+/******************************************************************************
+MODULE:  hdf_sds_dim_names
+
+PURPOSE: Determines the names of the dimensions of the SDS of a band, from
+the grid of the band.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error determining the grids or the names
+SUCCESS         Successfully named the dimensions
+
+NOTES:
+  1. The first grid uses YDim, XDim and the others append their suffix (ex.
+     YDim_20, XDim_20), matching the grids of write_hdf_eos_attr.
+******************************************************************************/
+static int hdf_sds_dim_names
+(
+    Espa_internal_meta_t *xml_metadata, /* I: XML metadata structure */
+    int band,                      /* I: band of the SDS */
+    char dim_name[2][STR_SIZE]     /* O: names of the Y and X dimensions */
+)
+{
+    char FUNC_NAME[] = "hdf_sds_dim_names";  /* function name */
+    char errmsg[STR_SIZE];        /* error message */
+    int status;                   /* return status */
+    Espa_band_grids_t grids;      /* grids of the bands */
+
+    if (get_espa_band_grids (xml_metadata, &grids) != SUCCESS)
+    {
+        sprintf (errmsg, "Grouping the bands into grids");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    status = espa_grid_name (&grids, grids.band_grid[band], "YDim",
+        dim_name[0], STR_SIZE);
+    if (status == SUCCESS)
+        status = espa_grid_name (&grids, grids.band_grid[band], "XDim",
+            dim_name[1], STR_SIZE);
+    free_espa_band_grids (&grids);
+
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  create_hdf_sds_file
+
+PURPOSE: Create the HDF metadata file, using info from the XML file, which will
+point to the existing raw binary bands as external SDSs.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error creating the HDF file
+SUCCESS         Successfully created the HDF file
+
+NOTES:
+  1. The ESPA products are 2D thus only 2D products are supported.
+  2. XDim, YDim will refer to the x,y dimension size in the first SDS.  From
+     there, different x,y dimensions will contain the pixel size at the end of
+     XDim, YDim.  Example: XDim_15, YDim_15.  For Geographic projections, the
+     name will be based on the count of grids instead of the pixel size.
+  3. The big endian external files are streamed out by
+     write_hdf_external_band rather than converted by HDF from a copy of the
+     entire band.  The reading of each band overlaps the writing of the
+     previous band.
+  4. If link_src is specified, the SDSs of the raw binary bands use a little
+     endian number type (DFNT_LITEND) and point at the raw binary files
+     as-is, so no pixels are copied.  Those source files are kept even if
+     del_src is specified.  Constant bands are still streamed out.
+  5. If streamed_last_pix is specified, the big endian external files of
+     all the bands were already streamed out (i.e. by the export fan-out),
+     and only the HDF file is created.
+  6. If a journal is specified, each big endian file streamed out is
+     recorded in it, and the bands marked as done were completed by an
+     interrupted run, so they aren't streamed again (see espa_journal.h).
+  7. If the options ask for compression, the SDSs are internal instead, and
+     the bands are written into them as chunks HDF compresses (see
+     write_hdf_internal_sds).  No big endian files are written, so there is
+     nothing to link, stream ahead, journal, or resume.
+     Their source files may already have been removed.
+  8. The finished HDF file is dropped from the page cache (see
+     raw_binary_advise.h).
+******************************************************************************/
+static int create_hdf_sds_file
+(
+    char *hdf_file,                     /* I: output HDF filename */
+    Espa_internal_meta_t *xml_metadata, /* I: XML metadata structure */
+    bool del_src,          /* I: should the source files be removed after
+                                 conversion? */
+    bool link_src,         /* I: should the raw binary bands be linked as-is
+                                 as little endian external SDSs? */
+    double *streamed_last_pix, /* I: native value of the last pixel of each
+                                 band already streamed out; NULL to stream
+                                 the bands here */
+    Espa_journal_t *journal,   /* I: journal of the conversion; NULL if
+                                 none */
+    const bool *done,      /* I: was each band completed by an interrupted
+                                 run?  NULL if none were */
+    Hdf_options_t *options /* I: storage, chunking, and compression of the
+                                 SDSs; NULL for uncompressed external
+                                 SDSs */
+)
+{
+    char FUNC_NAME[] = "create_hdf_sds_file";  /* function name */
+    char errmsg[STR_SIZE];        /* error message */
+    char bendian_file[STR_SIZE];  /* name of the external file of the SDS;
+                                     the big endian img file unless linked */
+    char dim_name[2][STR_SIZE];   /* array of dimension names */
+    char hdr_file[STR_SIZE];      /* ENVI header file */
+    char checksum[RB_CHECKSUM_LEN];  /* checksum of the big endian file */
+    char *cptr = NULL;            /* pointer to the file extension */
+    int i;                        /* looping variable for each SDS */
+    int nbytes;                   /* number of bytes in the data type */
+    int nlines;                   /* number of lines in the band */
+    int nsamps;                   /* number of samples in the band */
+    int dim;                      /* looping variable for dimensions */
+    int count;                    /* number of chars copied in snprintf */
+    bool linked;                  /* is the band linked as-is? */
+    bool resumed;                 /* was the band completed by an
+                                     interrupted run? */
+    bool internal;                /* are the SDSs internal and
+                                     compressed? */
+    int32 hdf_id;                 /* HDF file ID */
+    int32 sds_id;                 /* ID for each SDS */
+    int32 dim_id;                 /* ID for current dimension in SDS */
+    int32 data_type;              /* data type for HDF file */
+    int32 rank = 2;               /* rank of the SDS; set for 2D products */
+    int32 dims[2];                /* array for dimension sizes; only 2D prods */
+    int32 start[2];               /* starting location to write the HDF data */
+    int32 edge[2];                /* number of values to write the HDF data */
+    double last_pix;              /* native value of the last pixel in the
+                                     band (sized for the largest type) */
+    Espa_band_stack_t *stack = NULL;  /* band stack of the next band to be
+                                     written, already reading ahead */
+
+    /* Open the HDF file for creation (overwriting if it exists) */
+    hdf_id = SDstart (hdf_file, DFACC_CREATE);
+    if (hdf_id == HDF_ERROR)
+    {
+        sprintf (errmsg, "Creating the HDF file: %s", hdf_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* The external SDS data is written directly (see
+       write_hdf_external_band), and the internal SDSs are written whole
+       chunks at a time, so HDF must not fill the SDSs */
+    internal = is_internal_hdf_sds (options);
+    if (SDsetfillmode (hdf_id, SD_NOFILL) == HDF_ERROR)
+    {
+        sprintf (errmsg, "Turning off fill mode for the HDF file: %s",
+            hdf_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Loop through the bands in the XML file and set each band as an
+       external SDS in this HDF file */
+    for (i = 0; i < xml_metadata->nbands; i++)
+    {
+        /* Provide the status of processing */
+        espa_log_printf (ESPA_LOG_INFO, "Processing SDS: %s\n",
+            xml_metadata->band[i].name);
+
+        /* Define the dimensions for this band */
+        nlines = xml_metadata->band[i].nlines;
+        nsamps = xml_metadata->band[i].nsamps;
+        dims[0] = nlines;
+        dims[1] = nsamps;
+
+        /* Determine the HDF data type */
+        switch (xml_metadata->band[i].data_type)
+        {
+            case (ESPA_INT8):
+                data_type = DFNT_INT8;
+                nbytes = 1;
+                break;
+            case (ESPA_UINT8):
+                data_type = DFNT_UINT8;
+                nbytes = 1;
+                break;
+            case (ESPA_INT16):
+                data_type = DFNT_INT16;
+                nbytes = 2;
+                break;
+            case (ESPA_UINT16):
+                data_type = DFNT_UINT16;
+                nbytes = 2;
+                break;
+            case (ESPA_INT32):
+                data_type = DFNT_INT32;
+                nbytes = 4;
+                break;
+            case (ESPA_UINT32):
+                data_type = DFNT_UINT32;
+                nbytes = 4;
+                break;
+            case (ESPA_FLOAT32):
+                data_type = DFNT_FLOAT32;
+                nbytes = 4;
+                break;
+            case (ESPA_FLOAT64):
+                data_type = DFNT_FLOAT64;
+                nbytes = 8;
+                break;
+            default:
+                sprintf (errmsg, "Unsupported ESPA data type.");
+                error_handler (true, FUNC_NAME, errmsg);
+                close_band_stack (stack);
+                return (ERROR);
+        }
+
+        /* A linked band keeps its little endian raw binary file, and the
+           internal SDSs take the little endian pixels as they are read */
+        linked = is_linked_hdf_band (&xml_metadata->band[i], link_src);
+        if (linked || internal)
+            data_type |= DFNT_LITEND;
+        resumed = done != NULL && done[i];
+
+        /* The external file is the raw binary file of a linked band, or
+           the big endian version of the imagery needed for the HDF files.
+           (It's assumed we are running on Linux, thus the current output
+           files will be little endian.  HDF uses big endian for their byte
+           order.) */
+        if (hdf_external_name (&xml_metadata->band[i], linked, bendian_file)
+            != SUCCESS)
+        {
+            sprintf (errmsg, "Overflow of bendian_file string");
+            error_handler (true, FUNC_NAME, errmsg);
+            close_band_stack (stack);
+            return (ERROR);
+        }
+
+        if (linked)
+        {
+            /* Only the last pixel is needed from the band */
+            if (read_hdf_last_pixel (&xml_metadata->band[i],
+                xml_metadata->band[i].file_name,
+                xml_metadata->band[i].file_offset, false, nbytes, &last_pix)
+                != SUCCESS)
+            {
+                sprintf (errmsg, "Linking the raw binary file: %s",
+                    bendian_file);
+                error_handler (true, FUNC_NAME, errmsg);
+                close_band_stack (stack);
+                return (ERROR);
+            }
+        }
+        else if (streamed_last_pix != NULL)
+        {
+            /* The band was already streamed out to the big endian file.  The
+               pixel is raw bytes, so it is copied rather than assigned. */
+            memcpy (&last_pix, &streamed_last_pix[i], sizeof (last_pix));
+        }
+        else if (resumed)
+        {
+            /* The big endian file was completed by an interrupted run, so
+               only its last pixel is needed */
+            printf ("  Keeping completed band %s\n", bendian_file);
+            if (read_hdf_last_pixel (&xml_metadata->band[i], bendian_file, 0,
+                true, nbytes, &last_pix) != SUCCESS)
+            {
+                sprintf (errmsg, "Resuming the big endian file: %s",
+                    bendian_file);
+                error_handler (true, FUNC_NAME, errmsg);
+                close_band_stack (stack);
+                return (ERROR);
+            }
+        }
+        else if (!internal)
+        {
+            /* Stream the band out to the big endian file, and record it as
+               completed */
+            if (write_hdf_external_band (xml_metadata, i,
+                next_hdf_stream_band (xml_metadata, i, link_src, done),
+                nbytes, bendian_file, &last_pix, checksum, &stack) != SUCCESS
+                || record_espa_journal_entry (journal,
+                xml_metadata->band[i].name, xml_metadata->band[i].checksum,
+                bendian_file, (long long) nlines * nsamps * nbytes, checksum)
+                != SUCCESS)
+            {
+                sprintf (errmsg, "Writing the big endian file: %s",
+                    bendian_file);
+                error_handler (true, FUNC_NAME, errmsg);
+                close_band_stack (stack);
+                return (ERROR);
+            }
+        }
+
+        /* Select/create the SDS index for the current band */
+        sds_id = SDcreate (hdf_id, xml_metadata->band[i].name, data_type,
+            rank, dims);
+        if (sds_id == HDF_ERROR)
+        {
+            sprintf (errmsg, "Creating SDS in the HDF file: %d.", i);
+            error_handler (true, FUNC_NAME, errmsg);
+            close_band_stack (stack);
+            return (ERROR);
+        }
+
+        /* Set the dimension name for each dimension in this SDS, for the
+           grid of the band */
+        if (hdf_sds_dim_names (xml_metadata, i, dim_name) != SUCCESS)
+        {
+            sprintf (errmsg, "Naming the dimensions of SDS %d", i);
+            error_handler (true, FUNC_NAME, errmsg);
+            close_band_stack (stack);
+            return (ERROR);
+        }
+
+        /* Write the dimension names to the HDF file */
+        for (dim = 0; dim < rank; dim++)
+        {
+            dim_id = SDgetdimid (sds_id, dim);
+            if (dim_id == HDF_ERROR) 
+            {
+                sprintf (errmsg, "Getting dimension id for dimension %d and "
+                    "SDS %d.", dim, i);
+                error_handler (true, FUNC_NAME, errmsg);
+                close_band_stack (stack);
+                return (ERROR);
+            }
+
+            if (SDsetdimname (dim_id, dim_name[dim]) == HDF_ERROR)
+            {
+                sprintf (errmsg, "Setting dimension name (%s) for dimension "
+                    "%d and SDS %d.", dim_name[dim], dim, i);
+                error_handler (true, FUNC_NAME, errmsg);
+                close_band_stack (stack);
+                return (ERROR);
+            }
+        }
+
+        if (internal)
+        {
+            /* Write the band into the chunks of the internal SDS */
+            if (write_hdf_internal_sds (sds_id, xml_metadata, i, nbytes,
+                options) != SUCCESS)
+            {
+                sprintf (errmsg, "Writing the internal dataset for this SDS "
+                    "(%d).", i);
+                error_handler (true, FUNC_NAME, errmsg);
+                close_band_stack (stack);
+                return (ERROR);
+            }
+        }
+        else
+        {
+            /* Identify the external dataset for this SDS.  The raw binary
+               files have no headers, so the data starts at byte location 0
+               unless a linked band is in a stack of bands. */
+            if (SDsetexternalfile (sds_id, bendian_file,
+                linked ? xml_metadata->band[i].file_offset : 0) == HDF_ERROR)
+            {
+                sprintf (errmsg, "Setting the external dataset for this SDS "
+                    "(%d): %s.", i, bendian_file);
+                error_handler (true, FUNC_NAME, errmsg);
+                close_band_stack (stack);
+                return (ERROR);
+            }
+
+            /* The big endian data is already in the external file.  Write
+               the last pixel through HDF so the SDS covers all of the data;
+               fill mode is off, so nothing ahead of it is overwritten. */
+            start[0] = dims[0] - 1;
+            start[1] = dims[1] - 1;
+            edge[0] = edge[1] = 1;
+            if (SDwritedata (sds_id, start, NULL, edge, &last_pix)
+                == HDF_ERROR)
+            {
+                sprintf (errmsg, "Writing the external dataset for this SDS "
+                    "(%d): %s.", i, bendian_file);
+                error_handler (true, FUNC_NAME, errmsg);
+                close_band_stack (stack);
+                return (ERROR);
+            }
+        }
+
+        /* Write the SDS-level metadata */
+        if (write_sds_attributes (sds_id, &xml_metadata->band[i]) != SUCCESS)
+        {
+            sprintf (errmsg, "Writing band attributes for this SDS (%d).", i);
+            error_handler (true, FUNC_NAME, errmsg);
+            close_band_stack (stack);
+            return (ERROR);
+        }
+
+        /* Terminate access to the data set and SD interface */
+        SDendaccess (sds_id);
+
+        /* Remove the source files if specified.  Constant bands have
+           none, linked bands are the data of the SDS, and a stack of bands
+           is removed with its last band.  The run which completed a resumed
+           band may already have removed them. */
+        if (del_src && !linked && !is_constant_band (&xml_metadata->band[i])
+            && !is_shared_band_file (xml_metadata, i, true))
+        {
+            /* .img file */
+            printf ("  Removing %s\n", xml_metadata->band[i].file_name);
+            if (unlink (xml_metadata->band[i].file_name) != 0 &&
+                !(resumed && errno == ENOENT))
+            {
+                sprintf (errmsg, "Deleting source file: %s",
+                    xml_metadata->band[i].file_name);
+                error_handler (true, FUNC_NAME, errmsg);
+                close_band_stack (stack);
+                return (ERROR);
+            }
+
+            /* .hdr file */
+            count = snprintf (hdr_file, sizeof (hdr_file), "%s",
+                xml_metadata->band[i].file_name);
+            if (count < 0 || count >= sizeof (hdr_file))
+            {
+                sprintf (errmsg, "Overflow of hdr_file string");
+                error_handler (true, FUNC_NAME, errmsg);
+                close_band_stack (stack);
+                return (ERROR);
+            }
+
+            cptr = strrchr (hdr_file, '.');
+            strcpy (cptr, ".hdr");
+            printf ("  Removing %s\n", hdr_file);
+            if (unlink (hdr_file) != 0 && !(resumed && errno == ENOENT))
+            {
+                sprintf (errmsg, "Deleting source file: %s", hdr_file);
+                error_handler (true, FUNC_NAME, errmsg);
+                close_band_stack (stack);
+                return (ERROR);
+            }
+        }
+    }
+
+    /* Write the global metadata */
+    if (write_global_attributes (hdf_id, xml_metadata) != SUCCESS)
+    {
+        sprintf (errmsg, "Writing global attributes for this HDF file.");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Terminate access to the HDF file */
+    SDend (hdf_id);
+
+    /* Write HDF-EOS attributes and metadata */
+    if (write_hdf_eos_attr (hdf_file, xml_metadata) != SUCCESS)
+    {
+        sprintf (errmsg, "Writing HDF-EOS attributes for this HDF file.");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* The product isn't read again by this job, so it needn't evict the
+       data of other jobs from the page cache */
+    release_raw_binary_file (hdf_file, true);
+
+    /* Successful conversion */
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  write_hdf_envi_hdr
+
+PURPOSE: Writes the ENVI header of the HDF product.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the ENVI header
+SUCCESS         Successfully wrote the ENVI header, or there is none
+
+NOTES:
+  1. An ENVI header is only written for an HDF file which contains SDSs of
+     the same resolution (i.e. not a multi-resolution product).
+******************************************************************************/
+static int write_hdf_envi_hdr
+(
+    char *hdf_file,                     /* I: output HDF filename */
+    Espa_internal_meta_t *xml_metadata  /* I: XML metadata structure */
+)
+{
+    char FUNC_NAME[] = "write_hdf_envi_hdr";  /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    char hdr_file[STR_SIZE]; /* ENVI header file */
     int i;                   /* looping variable */
     int count;               /* number of chars copied in snprintf */
     bool multires;           /* is this a multi-resolution product */
-    Espa_internal_meta_t xml_metadata;  /* XML metadata structure to be
-                                populated by reading the MTL metadata file */
+    Espa_band_grids_t grids; /* grids of the bands */
     Envi_header_t envi_hdr;  /* output ENVI header information */
 
-    /* Validate the input metadata file */
-    if (validate_xml_file (espa_xml_file) != SUCCESS)
-    {  /* Error messages already written */
-        return (ERROR);
-    }
-
-    /* Initialize the metadata structure */
-    init_metadata_struct (&xml_metadata);
-
-    /* Parse the metadata file into our internal metadata structure; also
-       allocates space as needed for various pointers in the global and band
-       metadata */
-    if (parse_metadata (espa_xml_file, &xml_metadata) != SUCCESS)
-    {  /* Error messages already written */
-        return (ERROR);
-    }
-
-    /* Create the HDF file for the HDF metadata from the XML metadata.  This
-       also creates the big endian files for the HDF file. */
-    if (create_hdf_metadata (hdf_file, &xml_metadata, del_src) != SUCCESS)
-    {
-        sprintf (errmsg, "Creating the HDF metadata file (%s) which links to "
-            "the raw binary bands as external SDSs.", hdf_file);
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
-    }
-
     /* If this is not a multi-resolution product, then write out the ENVI
        header for the HDF product */
-    multires = false;
-    for (i = 0; i < xml_metadata.nbands; i++)
+    if (get_espa_band_grids (xml_metadata, &grids) != SUCCESS)
     {
-        if ((xml_metadata.band[i].pixel_size[0] !=
-             xml_metadata.band[0].pixel_size[0]) ||
-            (xml_metadata.band[i].pixel_size[1] !=
-             xml_metadata.band[0].pixel_size[1]))
-            multires = true;
+        sprintf (errmsg, "Grouping the bands of %s into grids", hdf_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
     }
+    multires = grids.ngrids > 1;
+    free_espa_band_grids (&grids);
     if (!multires)
     {
         /* Create the ENVI structure using the first band */
-        if (create_envi_struct (&xml_metadata.band[0], &xml_metadata.global,
+        if (create_envi_struct (&xml_metadata->band[0], &xml_metadata->global,
             &envi_hdr) != SUCCESS)
         {
             sprintf (errmsg, "Creating the ENVI header for %s", hdf_file);
@@ -998,7 +1828,7 @@ int convert_espa_to_hdf
 
         /* Make sure the number of bands being written doesn't exceed the
            maximum defined ENVI header bands */
-        if (xml_metadata.nbands > MAX_ENVI_BANDS)
+        if (xml_metadata->nbands > MAX_ENVI_BANDS)
         {
             sprintf (errmsg, "Number of bands being written exceeds the "
                 "predefined maximum of bands in envi_header.h: %d",
@@ -1009,7 +1839,7 @@ int convert_espa_to_hdf
 
         /* Update a few of the parameters in the header file since this is
            a multiband product */
-        envi_hdr.nbands = xml_metadata.nbands;
+        envi_hdr.nbands = xml_metadata->nbands;
         count = snprintf (envi_hdr.file_type, sizeof (envi_hdr.file_type), "%s",
             "HDF scientific data");
         if (count < 0 || count >= sizeof (envi_hdr.file_type))
@@ -1018,11 +1848,11 @@ int convert_espa_to_hdf
             error_handler (true, FUNC_NAME, errmsg);
             return (ERROR);
         }
-        for (i = 0; i < xml_metadata.nbands; i++)
+        for (i = 0; i < xml_metadata->nbands; i++)
         {
             count = snprintf (envi_hdr.band_names[i],
                 sizeof (envi_hdr.band_names[i]), "%s",
-                xml_metadata.band[i].long_name);
+                xml_metadata->band[i].long_name);
             if (count < 0 || count >= sizeof (envi_hdr.band_names[i]))
             {
                 sprintf (errmsg, "Overflow of envi_hdr.band_names[i] string");
@@ -1030,32 +1860,476 @@ int convert_espa_to_hdf
                 return (ERROR);
             }
         }
-
-        /* Write the ENVI header for the HDF file */
-        count = snprintf (hdr_file, sizeof (hdr_file), "%s.hdr", hdf_file);
-        if (count < 0 || count >= sizeof (hdr_file))
+
+        /* Write the ENVI header for the HDF file */
+        count = snprintf (hdr_file, sizeof (hdr_file), "%s.hdr", hdf_file);
+        if (count < 0 || count >= sizeof (hdr_file))
+        {
+            sprintf (errmsg, "Overflow of hdr_file string");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+
+        if (write_envi_hdr (hdr_file, &envi_hdr) != SUCCESS)
+        {
+            sprintf (errmsg, "Writing the ENVI header: %s", hdr_file);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+    }
+    else
+    {
+        sprintf (errmsg, "Multiresolution image and therefore no ENVI "
+            "header file has been written for the HDF file.");
+        error_handler (false, FUNC_NAME, errmsg);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  hdf_xml_name
+
+PURPOSE: Determines the name of the XML file of the HDF product.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           The name doesn't fit in STR_SIZE characters
+SUCCESS         Successfully determined the name
+
+NOTES:
+  1. The file extension of the HDF file, if any, is replaced by _hdf.xml.
+******************************************************************************/
+static int hdf_xml_name
+(
+    char *hdf_file,        /* I: output HDF filename */
+    char *xml_file         /* O: XML filename; at least STR_SIZE characters */
+)
+{
+    char *cptr = NULL;     /* pointer to the file extension */
+    int count;             /* number of chars copied in snprintf */
+
+    count = snprintf (xml_file, STR_SIZE, "%s", hdf_file);
+    if (count < 0 || count >= STR_SIZE)
+        return (ERROR);
+
+    cptr = strrchr (xml_file, '.');
+    if (cptr != NULL)
+    {
+        /* File extension found.  Replace it with the new extension */
+        *cptr = '\0';
+        strcpy (cptr, "_hdf.xml");
+    }
+    else if (count + strlen ("_hdf.xml") < STR_SIZE)
+    {
+        /* No file extension found.  Just append the new extension */
+        strcat (xml_file, "_hdf.xml");
+    }
+    else
+        return (ERROR);
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  hdf_inputs_key
+
+PURPOSE: Builds the key of the inputs of the HDF product, for an incremental
+export (see espa_incremental.h).
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error building the key
+SUCCESS         Successfully built the key
+
+NOTES:
+  1. The HDF file carries the metadata as attributes, so the whole XML
+     metadata is part of its key along with the pixels of every band.  The
+     bands are added first, since the checksums of the bands which have none
+     are recorded in the metadata.
+  2. The chunking and compression are only part of the key of internal
+     SDSs, so the key of external SDSs is the same as before they existed.
+******************************************************************************/
+static int hdf_inputs_key
+(
+    Espa_internal_meta_t *xml_metadata, /* I/O: XML metadata structure */
+    bool link_src,         /* I: are the raw binary bands linked as-is? */
+    Hdf_options_t *options,   /* I: storage of the SDSs; NULL for external
+                                 SDSs */
+    Espa_inputs_key_t *key /* O: key of the inputs; empty on input */
+)
+{
+    int i;                 /* looping variable for the bands */
+
+    if (add_espa_inputs_key (key, "format hdf link %d", link_src)
+        != SUCCESS)
+        return (ERROR);
+    if (is_internal_hdf_sds (options) &&
+        add_espa_inputs_key (key, "compress %d level %d chunks %d %d",
+        options->compressor, options->level, options->chunk_lines,
+        options->chunk_samps) != SUCCESS)
+        return (ERROR);
+
+    for (i = 0; i < xml_metadata->nbands; i++)
+    {
+        if (add_espa_band_inputs (key, xml_metadata, i) != SUCCESS)
+            return (ERROR);
+    }
+
+    return (add_espa_metadata_inputs (key, xml_metadata));
+}
+
+
+/******************************************************************************
+MODULE:  hdf_product_is_current
+
+PURPOSE: Determines whether the HDF product of an earlier run can be kept.
+
+RETURN VALUE:
+Type = bool
+Value           Description
+-----           -----------
+true            The HDF file is current and all its external files are
+                complete
+false           The HDF product needs to be written
+
+NOTES:
+  1. The external files are recorded along with the HDF file, so they are
+     only checked for their size.  Internal SDSs have none.
+******************************************************************************/
+static bool hdf_product_is_current
+(
+    char *hdf_file,                     /* I: output HDF filename */
+    Espa_internal_meta_t *xml_metadata, /* I: XML metadata structure */
+    bool link_src,         /* I: are the raw binary bands linked as-is? */
+    Hdf_options_t *options,   /* I: storage of the SDSs; NULL for external
+                                 SDSs */
+    Espa_inputs_key_t *key /* I: key of the inputs of the HDF product */
+)
+{
+    char bendian_file[STR_SIZE];  /* name of the external file */
+    int i;                 /* looping variable for the bands */
+    Espa_band_meta_t *bmeta;   /* metadata of the current band */
+    struct stat statbuf;   /* status of the external file */
+
+    if (!espa_output_is_current (hdf_file, key))
+        return (false);
+    if (is_internal_hdf_sds (options))
+        return (true);
+
+    for (i = 0; i < xml_metadata->nbands; i++)
+    {
+        bmeta = &xml_metadata->band[i];
+        if (is_linked_hdf_band (bmeta, link_src))
+            continue;
+        if (hdf_external_name (bmeta, false, bendian_file) != SUCCESS ||
+            stat (bendian_file, &statbuf) == -1 ||
+            statbuf.st_size != (off_t) bmeta->nlines * bmeta->nsamps *
+            espa_data_type_size (bmeta->data_type))
+            return (false);
+    }
+
+    return (true);
+}
+
+
+/******************************************************************************
+MODULE:  parse_hdf_compressor
+
+PURPOSE: Converts the name of a compressor to the compressor of the chunks of
+the SDSs.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Unknown compressor, or the HDF library can't encode szip
+SUCCESS         Successfully converted the name
+
+NOTES:
+  1. The szip encoder is optional in the HDF library, and many builds only
+     have the decoder, so it is checked for here.
+******************************************************************************/
+int parse_hdf_compressor
+(
+    char *name,                    /* I: name of the compressor (none,
+                                         deflate, or szip) */
+    Hdf_compressor_t *compressor   /* O: compressor of the chunks */
+)
+{
+    char FUNC_NAME[] = "parse_hdf_compressor";  /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    uint32 config = 0;          /* configuration of the szip coder */
+
+    if (!strcmp (name, "none"))
+        *compressor = HDF_COMPRESS_NONE;
+    else if (!strcmp (name, "deflate"))
+        *compressor = HDF_COMPRESS_DEFLATE;
+    else if (!strcmp (name, "szip"))
+    {
+        if (HCget_config_info (COMP_CODE_SZIP, &config) == HDF_ERROR ||
+            !(config & COMP_ENCODER_ENABLED))
+        {
+            sprintf (errmsg, "szip compression isn't available; the HDF "
+                "library has no szip encoder");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+        *compressor = HDF_COMPRESS_SZIP;
+    }
+    else
+    {
+        snprintf (errmsg, sizeof (errmsg), "Unknown compressor %s.  Valid "
+            "compressors are none, deflate, and szip.", name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  create_hdf_metadata
+
+PURPOSE: Create the HDF metadata file, using info from the XML file, which will
+point to the existing raw binary bands as external SDSs.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error creating the HDF file
+SUCCESS         Successfully created the HDF file
+
+NOTES:
+  1. See create_hdf_sds_file.  The bands are streamed out to their external
+     files as the HDF file is created.
+******************************************************************************/
+int create_hdf_metadata
+(
+    char *hdf_file,                     /* I: output HDF filename */
+    Espa_internal_meta_t *xml_metadata, /* I: XML metadata structure */
+    bool del_src,          /* I: should the source files be removed after
+                                 conversion? */
+    bool link_src          /* I: should the raw binary bands be linked as-is
+                                 as little endian external SDSs? */
+)
+{
+    return (create_hdf_sds_file (hdf_file, xml_metadata, del_src, link_src,
+        NULL, NULL, NULL, NULL));
+}
+
+
+/******************************************************************************
+MODULE:  convert_espa_to_hdf
+
+PURPOSE: Converts the internal ESPA raw binary file to HDF4 file format.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error converting to HDF
+SUCCESS         Successfully converted to HDF
+
+NOTES:
+  1. The ESPA raw binary band files are streamed to big endian files, which
+     are linked to as external SDSs from the HDF file.  If link_src is
+     specified, the raw binary band files are linked to as-is instead.
+  2. An ENVI header file will be written for the HDF files which contain
+     SDSs of the same resolution (i.e. not a multi-resolution product).
+  3. Each big endian file is recorded in a journal next to the XML file as
+     it is completed.  If the conversion is interrupted, running it again
+     keeps the big endian files which are still intact rather than
+     streaming those bands out again.  The journal is removed once the
+     conversion succeeds.
+  4. If ESPA_INCREMENTAL_ENV is set, the HDF file and its external files are
+     only written when their inputs have changed since they were last
+     written (see espa_incremental.h).  Otherwise only the ENVI header and
+     the XML file are written again.
+  5. If the options ask for compression, the bands are written into
+     internal SDSs of compressed chunks instead of external files, and the
+     bands of the XML file of the HDF product name the HDF file itself.
+     There are no big endian files to journal, so an interrupted conversion
+     is started over.  The raw binary bands can't be linked as-is.
+******************************************************************************/
+int convert_espa_to_hdf
+(
+    char *espa_xml_file,   /* I: input ESPA XML metadata filename */
+    char *hdf_file,        /* I: output HDF filename */
+    bool del_src,          /* I: should the source files be removed after
+                                 conversion? */
+    bool link_src,         /* I: should the raw binary bands be linked as-is
+                                 as little endian external SDSs? */
+    Hdf_options_t *options /* I: storage, chunking, and compression of the
+                                 SDSs; NULL for uncompressed external
+                                 SDSs */
+)
+{
+    char FUNC_NAME[] = "convert_espa_to_hdf";  /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    char xml_file[STR_SIZE]; /* new XML file for the HDF product */
+    char bendian_file[STR_SIZE];  /* name of output big endian img file */
+    int i;                   /* looping variable */
+    int status;              /* return status */
+    bool *done = NULL;       /* was each band completed by an interrupted
+                                run? */
+    bool incremental;        /* keep the HDF product if its inputs are
+                                unchanged? */
+    bool current = false;    /* is the HDF product of an earlier run kept? */
+    bool xml_removed = false;  /* was the source XML file removed? */
+    bool internal;           /* are the SDSs internal and compressed? */
+    Espa_inputs_key_t key;   /* key of the inputs of the HDF product */
+    Espa_journal_t *journal = NULL;  /* journal of the conversion */
+    Espa_internal_meta_t xml_metadata;  /* XML metadata structure to be
+                                populated by reading the MTL metadata file */
+
+    /* Only uncompressed external SDSs can point at the raw binary bands */
+    internal = is_internal_hdf_sds (options);
+    if (internal && link_src)
+    {
+        sprintf (errmsg, "The raw binary bands can't be linked as-is into "
+            "compressed SDSs");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    if (strlen (hdf_file) >= STR_SIZE)
+    {
+        sprintf (errmsg, "Overflow of hdf_file string");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Initialize the metadata structure */
+    init_metadata_struct (&xml_metadata);
+
+    /* Validate the metadata file and parse it into our internal metadata
+       structure, reading the file only once; also allocates space as needed
+       for various pointers in the global and band metadata */
+    if (validate_and_parse_metadata (espa_xml_file, &xml_metadata) != SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+
+    /* Keep the HDF product of an earlier run if its inputs are unchanged */
+    init_espa_inputs_key (&key);
+    incremental = use_espa_incremental ();
+    if (incremental)
+    {
+        if (hdf_inputs_key (&xml_metadata, link_src, options, &key)
+            != SUCCESS)
+        {
+            sprintf (errmsg, "Determining the inputs of the HDF file %s",
+                hdf_file);
+            error_handler (true, FUNC_NAME, errmsg);
+            free_espa_inputs_key (&key);
+            return (ERROR);
+        }
+        current = hdf_product_is_current (hdf_file, &xml_metadata, link_src,
+            options, &key);
+        if (!current && invalidate_espa_output (hdf_file) != SUCCESS)
+        {  /* Error messages already written */
+            free_espa_inputs_key (&key);
+            return (ERROR);
+        }
+    }
+
+    if (current)
+    {
+        printf ("Keeping %s, whose inputs are unchanged\n", hdf_file);
+
+        /* Remove the source files if specified, as create_hdf_sds_file
+           would have.  Linked bands are the data of the SDSs. */
+        if (del_src && !link_src)
+        {
+            if (remove_export_source (&xml_metadata, espa_xml_file)
+                != SUCCESS)
+            {  /* Error messages already written */
+                free_espa_inputs_key (&key);
+                return (ERROR);
+            }
+            xml_removed = true;
+        }
+    }
+    else if (internal)
+    {
+        /* Create the HDF file and write the bands into its SDSs */
+        if (create_hdf_sds_file (hdf_file, &xml_metadata, del_src, false,
+            NULL, NULL, NULL, options) != SUCCESS)
         {
-            sprintf (errmsg, "Overflow of hdr_file string");
+            sprintf (errmsg, "Creating the HDF file (%s) with the bands as "
+                "compressed internal SDSs.", hdf_file);
             error_handler (true, FUNC_NAME, errmsg);
+            free_espa_inputs_key (&key);
+            return (ERROR);
+        }
+    }
+    else
+    {
+        /* Pick up the bands completed by an interrupted run, if any */
+        journal = open_espa_journal (espa_xml_file, "hdf");
+        if (journal == NULL)
+        {  /* Error messages already written */
+            free_espa_inputs_key (&key);
+            return (ERROR);
+        }
+        done = find_hdf_journaled_bands (journal, &xml_metadata, link_src);
+        if (done == NULL)
+        {  /* Error messages already written */
+            close_espa_journal (journal);
+            free_espa_inputs_key (&key);
             return (ERROR);
         }
 
-        if (write_envi_hdr (hdr_file, &envi_hdr) != SUCCESS)
+        /* Create the HDF file for the HDF metadata from the XML metadata.
+           This also creates the big endian files for the HDF file. */
+        status = create_hdf_sds_file (hdf_file, &xml_metadata, del_src,
+            link_src, NULL, journal, done, NULL);
+        free (done);
+        if (status != SUCCESS)
         {
-            sprintf (errmsg, "Writing the ENVI header: %s", hdr_file);
+            sprintf (errmsg, "Creating the HDF metadata file (%s) which "
+                "links to the raw binary bands as external SDSs.", hdf_file);
             error_handler (true, FUNC_NAME, errmsg);
+            close_espa_journal (journal);
+            free_espa_inputs_key (&key);
             return (ERROR);
         }
     }
-    else
-    {
-        sprintf (errmsg, "Multiresolution image and therefore no ENVI "
-            "header file has been written for the HDF file.");
-        error_handler (false, FUNC_NAME, errmsg);
+
+    /* Write the ENVI header for the HDF product */
+    if (write_hdf_envi_hdr (hdf_file, &xml_metadata) != SUCCESS)
+    {  /* Error messages already written */
+        close_espa_journal (journal);
+        free_espa_inputs_key (&key);
+        return (ERROR);
+    }
+
+    /* All the bands are in place, so the journal is no longer needed */
+    if (remove_espa_journal (journal) != SUCCESS)
+    {  /* Error messages already written */
+        free_espa_inputs_key (&key);
+        return (ERROR);
     }
 
+    /* Record the inputs the HDF product was written from */
+    if (incremental && !current &&
+        record_espa_output_inputs (hdf_file, &key) != SUCCESS)
+    {  /* Error messages already written */
+        free_espa_inputs_key (&key);
+        return (ERROR);
+    }
+    free_espa_inputs_key (&key);
+
     /* Remove the source files if specified */
-    if (del_src)
+    if (del_src && !xml_removed)
     {
         /* XML file */
         printf ("  Removing %s\n", espa_xml_file);
@@ -1068,49 +2342,39 @@ int convert_espa_to_hdf
     }
 
     /* Loop through the bands and modify the band names to match the new
-       (external) raw binary filenames in the HDF product */
+       (external) raw binary filenames in the HDF product, or the HDF file
+       for internal SDSs */
     for (i = 0; i < xml_metadata.nbands; i++)
     {
-        count = snprintf (bendian_file, sizeof (bendian_file), "%s",
-            xml_metadata.band[i].file_name);
-        if (count < 0 || count >= sizeof (bendian_file))
+        /* Linked bands keep their raw binary file */
+        if (is_linked_hdf_band (&xml_metadata.band[i], link_src))
+            continue;
+
+        if (internal)
+            strcpy (bendian_file, hdf_file);
+        else if (hdf_external_name (&xml_metadata.band[i], false,
+            bendian_file) != SUCCESS)
         {
             sprintf (errmsg, "Overflow of bendian_file string");
             error_handler (true, FUNC_NAME, errmsg);
             return (ERROR);
         }
 
-        cptr = strrchr (bendian_file, '.');
-        if (cptr != NULL)
-            *cptr = '\0';
-        strcpy (cptr, "_hdf.img");
-
-        /* Update the XML file to use the new band names */
+        /* Update the XML file to use the new band names.  The external
+           files hold the pixels of every band, including the constant
+           bands. */
         strcpy (xml_metadata.band[i].file_name, bendian_file);
+        xml_metadata.band[i].constant_value = ESPA_FLOAT_META_FILL;
     }
 
     /* Create the XML file for the HDF product */
-    count = snprintf (xml_file, sizeof (xml_file), "%s", hdf_file);
-    if (count < 0 || count >= sizeof (xml_file))
+    if (hdf_xml_name (hdf_file, xml_file) != SUCCESS)
     {
         sprintf (errmsg, "Overflow of xml_file string");
         error_handler (true, FUNC_NAME, errmsg);
         return (ERROR);
     }
 
-    cptr = strrchr (xml_file, '.');
-    if (cptr != NULL)
-    {
-        /* File extension found.  Replace it with the new extension */
-        *cptr = '\0';
-        strcpy (cptr, "_hdf.xml");
-    }
-    else
-    {
-        /* No file extension found.  Just append the new extension */
-        strcat (xml_file, "_hdf.xml");
-    }
-
     /* Write the new XML file containing the new band names */
     if (write_metadata (&xml_metadata, xml_file) != SUCCESS)
     {
@@ -1127,3 +2391,426 @@ int convert_espa_to_hdf
     return (SUCCESS);
 }
 
+
+
+/* State of the HDF export sink */
+typedef struct
+{
+    char hdf_file[STR_SIZE];        /* output HDF filename */
+    char (*bendian_file)[STR_SIZE]; /* big endian external file of each
+                                       band */
+    double *last_pix;               /* native value of the last pixel of each
+                                       band (sized for the largest type) */
+    void *swap_buf;                 /* byte-swapped copy of the block */
+    size_t swap_bytes;              /* size of the swap buffer */
+    Raw_binary_writer_t *writer;    /* writer of the external file of the
+                                       current band */
+    Espa_inputs_key_t key;          /* key of the inputs of the HDF product
+                                       when exporting incrementally; empty
+                                       otherwise */
+    bool current;                   /* is the HDF product kept from an
+                                       earlier run? */
+} Hdf_export_t;
+
+
+/******************************************************************************
+MODULE:  hdf_export_needs_band
+
+PURPOSE: Determines whether the bands are written by the export fan-out,
+rather than the HDF product being kept from an earlier run.
+
+RETURN VALUE:
+Type = bool
+Value           Description
+-----           -----------
+true            The band is written
+false           The HDF product is kept
+
+NOTES:
+******************************************************************************/
+static bool hdf_export_needs_band
+(
+    void *state,                        /* I: state of the sink */
+    Espa_internal_meta_t *xml_metadata, /* I: XML metadata structure */
+    int band                            /* I: index of the band */
+)
+{
+    Hdf_export_t *hdf = state;          /* state of the sink */
+
+    return (!hdf->current);
+}
+
+
+/******************************************************************************
+MODULE:  begin_hdf_export_band
+
+PURPOSE: Creates the big endian external file of a band fed by the export
+fan-out.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error creating the external file
+SUCCESS         Successfully created the external file
+
+NOTES:
+******************************************************************************/
+static int begin_hdf_export_band
+(
+    void *state,                        /* I/O: state of the sink */
+    Espa_internal_meta_t *xml_metadata, /* I: XML metadata structure */
+    int band                            /* I: index of the band */
+)
+{
+    char FUNC_NAME[] = "begin_hdf_export_band";  /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    Hdf_export_t *hdf = state;  /* state of the sink */
+    Espa_band_meta_t *bmeta = &xml_metadata->band[band];  /* band metadata */
+
+    espa_log_printf (ESPA_LOG_INFO, "Processing SDS: %s\n", bmeta->name);
+    hdf->writer = open_raw_binary_writer (hdf->bendian_file[band],
+        (size_t) bmeta->nlines * bmeta->nsamps *
+        espa_data_type_size (bmeta->data_type), 0);
+    if (hdf->writer == NULL)
+    {
+        sprintf (errmsg, "Opening the big endian file: %s",
+            hdf->bendian_file[band]);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  write_hdf_export_block
+
+PURPOSE: Byte-swaps a block of lines fed by the export fan-out and appends it
+to the big endian external file of the band.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the lines
+SUCCESS         Successfully wrote the lines
+
+NOTES:
+  1. The block is shared with the other sinks, so it is swapped into a
+     buffer of the sink rather than in place.
+  2. The native value of the last pixel of the band is kept for the SDS (see
+     write_hdf_external_band).
+******************************************************************************/
+static int write_hdf_export_block
+(
+    void *state,                        /* I/O: state of the sink */
+    Espa_internal_meta_t *xml_metadata, /* I: XML metadata structure */
+    int band,                           /* I: index of the band */
+    Espa_band_block_t *block            /* I: block of lines */
+)
+{
+    char FUNC_NAME[] = "write_hdf_export_block";  /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    int nbytes;                 /* number of bytes per pixel */
+    size_t nvals;               /* number of values in the block */
+    void *buf = NULL;           /* grown swap buffer */
+    Hdf_export_t *hdf = state;  /* state of the sink */
+    Espa_band_meta_t *bmeta = &xml_metadata->band[band];  /* band metadata */
+
+    nbytes = espa_data_type_size (bmeta->data_type);
+    nvals = (size_t) block->nlines * block->nsamps;
+    if (nvals * nbytes > hdf->swap_bytes)
+    {
+        buf = espa_trace_realloc (hdf->swap_buf, nvals * nbytes);
+        if (buf == NULL)
+        {
+            sprintf (errmsg, "Allocating the byte-swapped block");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+        hdf->swap_buf = buf;
+        hdf->swap_bytes = nvals * nbytes;
+    }
+
+    if (block->line0 + block->nlines == bmeta->nlines)
+        memcpy (&hdf->last_pix[band], (char *) block->band_buf[0] +
+            (nvals - 1) * nbytes, nbytes);
+
+    if (swap_raw_binary_bytes (block->band_buf[0], hdf->swap_buf, nvals,
+        nbytes) != SUCCESS ||
+        append_raw_binary_writer (hdf->writer, block->nlines, block->nsamps,
+        nbytes, hdf->swap_buf) != SUCCESS)
+    {
+        sprintf (errmsg, "Writing lines %d-%d to the big endian file: %s",
+            block->line0, block->line0 + block->nlines - 1,
+            hdf->bendian_file[band]);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  end_hdf_export_band
+
+PURPOSE: Closes the big endian external file of a band fed by the export
+fan-out.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error flushing the external file
+SUCCESS         Successfully completed the external file
+
+NOTES:
+******************************************************************************/
+static int end_hdf_export_band
+(
+    void *state,                        /* I/O: state of the sink */
+    Espa_internal_meta_t *xml_metadata, /* I: XML metadata structure */
+    int band                            /* I: index of the band */
+)
+{
+    char FUNC_NAME[] = "end_hdf_export_band";  /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    Hdf_export_t *hdf = state;  /* state of the sink */
+    int status;                 /* return status */
+
+    status = close_raw_binary_writer (hdf->writer);
+    hdf->writer = NULL;
+    if (status != SUCCESS)
+    {
+        sprintf (errmsg, "Closing the big endian file: %s",
+            hdf->bendian_file[band]);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  finish_hdf_export
+
+PURPOSE: Creates the HDF file, its ENVI header, and the XML file of the HDF
+product once the external files of all the bands have been exported, and
+frees the state of the sink.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error creating the HDF product
+SUCCESS         Successfully completed the HDF product
+
+NOTES:
+******************************************************************************/
+static int finish_hdf_export
+(
+    void *state,                        /* I: state of the sink */
+    Espa_internal_meta_t *xml_metadata, /* I: XML metadata structure */
+    bool complete                       /* I: were all the bands exported? */
+)
+{
+    char FUNC_NAME[] = "finish_hdf_export";  /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    char xml_file[STR_SIZE];    /* new XML file for the HDF product */
+    int status = SUCCESS;       /* return status */
+    Hdf_export_t *hdf = state;  /* state of the sink */
+
+    if (hdf->writer != NULL)
+        close_raw_binary_writer (hdf->writer);
+
+    if (complete)
+    {
+        if (!hdf->current && create_hdf_sds_file (hdf->hdf_file,
+            xml_metadata, false, false, hdf->last_pix, NULL, NULL, NULL)
+            != SUCCESS)
+        {
+            sprintf (errmsg, "Creating the HDF metadata file (%s) which "
+                "links to the exported bands as external SDSs.",
+                hdf->hdf_file);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+        }
+        else if (write_hdf_envi_hdr (hdf->hdf_file, xml_metadata) != SUCCESS)
+            status = ERROR;
+        else if (hdf_xml_name (hdf->hdf_file, xml_file) != SUCCESS)
+        {
+            sprintf (errmsg, "Overflow of xml_file string");
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+        }
+        else if (write_export_metadata (xml_metadata, hdf->bendian_file,
+            xml_file) != SUCCESS)
+        {
+            sprintf (errmsg, "Error writing updated XML for the HDF product: "
+                "%s", xml_file);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+        }
+        else if (!hdf->current && hdf->key.len > 0 &&
+            record_espa_output_inputs (hdf->hdf_file, &hdf->key) != SUCCESS)
+            status = ERROR;   /* Error messages already written */
+    }
+
+    free_espa_inputs_key (&hdf->key);
+    free (hdf->bendian_file);
+    free (hdf->last_pix);
+    espa_trace_free (hdf->swap_buf);
+    free (hdf);
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  init_hdf_export_sink
+
+PURPOSE: Sets up an export sink which writes the HDF product from the blocks
+fed by the export fan-out (see export_espa_fanout).
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error setting up the sink
+SUCCESS         Successfully set up the sink
+
+NOTES:
+  1. Every band is streamed out to its big endian external file, as by
+     convert_espa_to_hdf without link_src.  Linking the raw binary bands
+     as-is doesn't read their pixels, so it gains nothing from the fan-out.
+  2. The HDF file itself is created once all the bands have been exported.
+  3. If ESPA_INCREMENTAL_ENV is set and the HDF product is current (see
+     espa_incremental.h), the product is kept and the sink needs none of the
+     bands.
+******************************************************************************/
+int init_hdf_export_sink
+(
+    char *hdf_file,        /* I: output HDF filename */
+    Espa_internal_meta_t *xml_metadata, /* I: XML metadata structure */
+    Espa_export_sink_t *sink  /* O: HDF export sink */
+)
+{
+    char FUNC_NAME[] = "init_hdf_export_sink";  /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    int i;                      /* looping variable for each band */
+    int status = SUCCESS;       /* status of finding the inputs */
+    Hdf_export_t *hdf = NULL;   /* state of the sink */
+
+    if (strlen (hdf_file) >= STR_SIZE)
+    {
+        sprintf (errmsg, "Overflow of hdf_file string");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    hdf = calloc (1, sizeof (Hdf_export_t));
+    if (hdf != NULL)
+    {
+        hdf->bendian_file = calloc (xml_metadata->nbands, STR_SIZE);
+        hdf->last_pix = calloc (xml_metadata->nbands, sizeof (double));
+    }
+    if (hdf == NULL || hdf->bendian_file == NULL || hdf->last_pix == NULL)
+    {
+        sprintf (errmsg, "Allocating the HDF export sink");
+        error_handler (true, FUNC_NAME, errmsg);
+        if (hdf != NULL)
+        {
+            free (hdf->bendian_file);
+            free (hdf->last_pix);
+            free (hdf);
+        }
+        return (ERROR);
+    }
+    strcpy (hdf->hdf_file, hdf_file);
+
+    for (i = 0; i < xml_metadata->nbands; i++)
+    {
+        if (hdf_external_name (&xml_metadata->band[i], false,
+            hdf->bendian_file[i]) != SUCCESS)
+        {
+            sprintf (errmsg, "Overflow of bendian_file string");
+            error_handler (true, FUNC_NAME, errmsg);
+            free (hdf->bendian_file);
+            free (hdf->last_pix);
+            free (hdf);
+            return (ERROR);
+        }
+    }
+
+    /* Keep the HDF product of an earlier run if its inputs are unchanged */
+    init_espa_inputs_key (&hdf->key);
+    if (use_espa_incremental ())
+    {
+        if (hdf_inputs_key (xml_metadata, false, NULL, &hdf->key)
+            != SUCCESS)
+        {
+            sprintf (errmsg, "Determining the inputs of the HDF file %s",
+                hdf_file);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+        }
+        else
+        {
+            hdf->current = hdf_product_is_current (hdf_file, xml_metadata,
+                false, NULL, &hdf->key);
+            if (hdf->current)
+                printf ("Keeping %s, whose inputs are unchanged\n",
+                    hdf_file);
+            else if (invalidate_espa_output (hdf_file) != SUCCESS)
+                status = ERROR;   /* Error messages already written */
+        }
+        if (status != SUCCESS)
+        {
+            free_espa_inputs_key (&hdf->key);
+            free (hdf->bendian_file);
+            free (hdf->last_pix);
+            free (hdf);
+            return (ERROR);
+        }
+    }
+
+    strcpy (sink->name, "HDF");
+    sink->state = hdf;
+    sink->needs_band = hdf_export_needs_band;
+    sink->begin_band = begin_hdf_export_band;
+    sink->write_block = write_hdf_export_block;
+    sink->end_band = end_hdf_export_band;
+    sink->finish = finish_hdf_export;
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  hdf_export_entry
+
+PURPOSE: Entry point of the HDF format in the export registry (see
+espa_export_registry.h), which sets up its export sink.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error setting up the sink
+SUCCESS         Successfully set up the sink
+
+NOTES:
+  1. The HDF sink doesn't depend on the size of the blocks of the fan-out.
+******************************************************************************/
+int hdf_export_entry
+(
+    char *out_file,        /* I: output HDF filename */
+    Espa_internal_meta_t *xml_metadata, /* I: XML metadata structure */
+    const Espa_export_options_t *options,  /* I: export options */
+    Espa_export_sink_t *sink  /* O: HDF export sink */
+)
+{
+    return (init_hdf_export_sink (out_file, xml_metadata, sink));
+}
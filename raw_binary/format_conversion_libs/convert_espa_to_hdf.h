@@ -28,10 +28,40 @@ NOTES:
 #include "espa_hdf_eos.h"
 #include "envi_header.h"
 #include "raw_binary_io.h"
+#include "raw_binary_swap.h"
+#include "raw_binary_writer.h"
+#include "espa_band_stack.h"
+#include "espa_export_registry.h"
+#include "espa_journal.h"
+#include "espa_incremental.h"
 
 /* Defines */
 #define HDF_ERROR -1
 
+/* Storage of the SDSs */
+typedef enum {
+    HDF_COMPRESS_NONE,    /* uncompressed external SDSs (the default) */
+    HDF_COMPRESS_DEFLATE, /* internal SDSs of deflate compressed chunks */
+    HDF_COMPRESS_SZIP     /* internal SDSs of szip compressed chunks; only
+                             when the HDF library has the szip encoder */
+} Hdf_compressor_t;
+
+/* Default chunk shape and compression of the internal SDSs */
+#define DEFAULT_HDF_CHUNK_LINES 512
+#define DEFAULT_HDF_CHUNK_SAMPS 512
+#define DEFAULT_HDF_DEFLATE_LEVEL 4
+#define HDF_SZIP_PIXELS_PER_BLOCK 16
+
+/* Storage, chunking, and compression of the SDSs */
+typedef struct
+{
+    Hdf_compressor_t compressor;  /* compressor of the chunks; none for
+                                     external SDSs */
+    int chunk_lines;     /* number of lines per chunk */
+    int chunk_samps;     /* number of samples per chunk; 0 for full lines */
+    int level;           /* deflate level (1-9); 0 for the default */
+} Hdf_options_t;
+
 /* Prototypes */
 int write_global_attributes
 (
@@ -45,20 +75,53 @@ int write_sds_attributes
     Espa_band_meta_t *bmeta   /* I: pointer to band metadata structure */
 );
 
+int write_hdf_external_band
+(
+    Espa_internal_meta_t *xml_metadata, /* I: XML metadata structure */
+    int band,              /* I: index of the band in the metadata */
+    int next_band,         /* I: index of the next band to be streamed; -1
+                                 if this is the last one */
+    int nbytes,            /* I: number of bytes per pixel */
+    char *bendian_file,    /* I: name of the big endian external file */
+    void *last_pix,        /* O: native value of the last pixel in the band;
+                                 at least nbytes */
+    char *checksum,        /* O: checksum of the external file (see
+                                 raw_binary_checksum.h); at least
+                                 RB_CHECKSUM_LEN bytes */
+    Espa_band_stack_t **stack  /* I/O: on input, the band stack of this band
+                                 or NULL to open it here; on output, the band
+                                 stack of next_band or NULL if this is the
+                                 last band (or on error) */
+);
+
+int parse_hdf_compressor
+(
+    char *name,                    /* I: name of the compressor (none,
+                                         deflate, or szip) */
+    Hdf_compressor_t *compressor   /* O: compressor of the chunks */
+);
+
 int create_hdf_metadata
 (
     char *hdf_file,                     /* I: output HDF filename */
     Espa_internal_meta_t *xml_metadata, /* I: XML metadata structure */
-    bool del_src           /* I: should the source files be removed after
+    bool del_src,          /* I: should the source files be removed after
                                  conversion? */
+    bool link_src          /* I: should the raw binary bands be linked as-is
+                                 as little endian external SDSs? */
 );
 
 int convert_espa_to_hdf
 (
     char *espa_xml_file,   /* I: input ESPA XML metadata filename */
     char *hdf_file,        /* I: output HDF filename */
-    bool del_src           /* I: should the source files be removed after
+    bool del_src,          /* I: should the source files be removed after
                                  conversion? */
+    bool link_src,         /* I: should the raw binary bands be linked as-is
+                                 as little endian external SDSs? */
+    Hdf_options_t *options /* I: storage, chunking, and compression of the
+                                 SDSs; NULL for uncompressed external
+                                 SDSs */
 );
 
 #endif
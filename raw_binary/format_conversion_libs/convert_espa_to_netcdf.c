@@ -16,10 +16,26 @@ NOTES:
 *****************************************************************************/
 
 #include <unistd.h>
+#include <errno.h>
 #include <math.h>
+#include <zlib.h>
+#include <hdf5.h>
+#if !H5_VERSION_GE(1, 10, 3)
+#include <hdf5_hl.h>
+#define H5Dwrite_chunk H5DOwrite_chunk
+#define H5Dread_chunk H5DOread_chunk
+#endif
 #include "convert_espa_to_netcdf.h"
+#include "espa_trace.h"
+#include "espa_log.h"
+#include "espa_task_pool.h"
+#include "espa_cf_packing.h"
+#include "raw_binary_advise.h"
 #include "gctp_defines.h"
 
+/* Maximum number of values in a numeric attribute (ex. valid_range) */
+#define MAX_ATTR_VALUES 2
+
 #define OUTPUT_PROVIDER ("DataProvider")
 #define OUTPUT_SAT ("Satellite")
 #define OUTPUT_INST ("Instrument")
@@ -82,15 +98,15 @@ int write_band_attributes
     char message[5000];         /* description of QA bits or classes */
     int i;                      /* looping variable for each SDS */
     int count;                  /* number of chars copied in snprintf */
-    signed char byte_dval[MAX_TOTAL_BANDS];/* attribute values to be written */
-    unsigned char ubyte_dval[MAX_TOTAL_BANDS];/* attribute values to be 
+    signed char byte_dval[MAX_ATTR_VALUES];/* attribute values to be written */
+    unsigned char ubyte_dval[MAX_ATTR_VALUES];/* attribute values to be 
                                    written */
-    float float_dval[MAX_TOTAL_BANDS];/* attribute values to be written */
-    double double_dval[MAX_TOTAL_BANDS];/* attribute values to be written */
-    int int_dval[MAX_TOTAL_BANDS];/* attribute values to be written */
-    unsigned int uint_dval[MAX_TOTAL_BANDS];/* attribute values to be written */
-    short short_dval[MAX_TOTAL_BANDS];/* attribute values to be written */
-    unsigned short ushort_dval[MAX_TOTAL_BANDS];/* attribute values to be 
+    float float_dval[MAX_ATTR_VALUES];/* attribute values to be written */
+    double double_dval[MAX_ATTR_VALUES];/* attribute values to be written */
+    int int_dval[MAX_ATTR_VALUES];/* attribute values to be written */
+    unsigned int uint_dval[MAX_ATTR_VALUES];/* attribute values to be written */
+    short short_dval[MAX_ATTR_VALUES];/* attribute values to be written */
+    unsigned short ushort_dval[MAX_ATTR_VALUES];/* attribute values to be 
                                    written */
     int retval = 0;             /* function call return value */
 
@@ -347,7 +363,7 @@ int write_band_attributes
 }
 
 /******************************************************************************
-MODULE:  write_global_attributes
+MODULE:  write_netcdf_global_attributes
 
 PURPOSE: Write the global attributes (metadata) for the NetCDF file, using the
 metadata from the XML file.
@@ -361,13 +377,13 @@ SUCCESS         Successfully wrote the global attributes
 
 NOTES:
 ******************************************************************************/
-int write_global_attributes
+int write_netcdf_global_attributes
 (
     int ncid,                /* I: NetCDF file ID to write attributes */
     Espa_internal_meta_t *xml_metadata  /* I: pointer to metadata structure */
 )
 {
-    char FUNC_NAME[] = "write_global_attributes";  /* function name */
+    char FUNC_NAME[] = "write_netcdf_global_attributes";  /* function name */
     char errmsg[STR_SIZE];        /* error message */
     const char *netcdf_version;   /* NetCDF library version */
     int retval = 0;               /* function call return value */
@@ -588,392 +604,1584 @@ int write_global_attributes
 }
 
 /******************************************************************************
-MODULE:  create_netCDF_metadata
+MODULE:  put_netcdf_constant_band
 
-PURPOSE: Create the NetCDF metadata file using info from the XML file.  The 
-file will also include the existing raw binary bands.
+PURPOSE: Writes the pixels of a constant band to its NetCDF variable,
+synthesizing one block of lines at a time.
 
 RETURN VALUE:
 Type = int
 Value           Description
 -----           -----------
-ERROR           Error creating the NetCDF file
-SUCCESS         Successfully created the NetCDF file
+ERROR           Error writing the band variable
+SUCCESS         Successfully wrote the band variable
 
 NOTES:
-  1. The ESPA products are 2D thus only 2D products are supported.
-  2. XDim, YDim will refer to the x,y dimension size for the first band.  From
-     there, different x,y dimensions will contain the pixel size at the end of
-     XDim, YDim.  Example: XDim_15, YDim_15.  For Geographic projections, the
-     name will be based on the count of grids instead of the pixel size.
+  1. Every block of lines is the same, so a single block is synthesized and
+     written to each block of lines of the variable in turn.
 ******************************************************************************/
-int create_netcdf_metadata
+static int put_netcdf_constant_band
 (
-    char *netcdf_file,     /* I: output NetCDF filename */
-    Espa_internal_meta_t *xml_metadata, /* I: XML metadata structure */
-    bool del_src,          /* I: should the source files be removed after
-                                 conversion? */
-    bool no_compression    /* I: use compression for the NetCDF output file? */
+    int ncid,                 /* I: NetCDF file ID */
+    int band_varid,           /* I: variable ID of the band */
+    Espa_band_meta_t *bmeta,  /* I: metadata of the constant band */
+    int nbytes                /* I: number of bytes in the data type */
 )
 {
-    char FUNC_NAME[] = "create_netcdf_metadata";  /* function name */
-    char errmsg[STR_SIZE];   /* error message */
-    char dim_name[2][STR_SIZE];   /* array of dimension names */
-    char hdr_file[STR_SIZE];      /* ENVI header file */
-    char *cptr = NULL;            /* pointer to the file extension */
-    int i;                        /* looping variable for each band */
-    int nbytes;                   /* number of bytes in the data type */
-    int nlines;                   /* number of lines in the band */
-    int nsamps;                   /* number of samples in the band */
-    int count;                    /* number of chars copied in snprintf */
-    int ngrids;                   /* current number of grids in the product;
-                                     different grids are written for different
-                                     resolutions (1-based) */
-    int mycount;                  /* integer value to use in the name of the
-                                     2nd, 3rd, etc. grid dimensions */
-    int data_type;                /* data type for NetCDF file */
-    int rank = 2;                 /* rank of the band; set for 2D products */
-    int x_dimid;                  /* x-dimension ID */
-    int y_dimid;                  /* y-dimension ID */
-    int x_varid;                  /* x coordinate variable ID */
-    int y_varid;                  /* y coordinate variable ID */
-    int dimids[2];                /* array for the dimension IDs */
-    float *xdims = NULL;          /* coordinate values for the x-dimension */
-    float *ydims = NULL;          /* coordinate values for the y-dimension */
-    int x;                        /* loop index */
-    int y;                        /* loop index */
-    FILE *fp_rb = NULL;           /* file pointer for the raw binary file */
-    void *file_buf = NULL;        /* pointer to correct input file buffer */
-    int ncid;                     /* NetCDF file ID */
-    int band_varid;               /* Variable ID for band */
-    int retval = 0;               /* function call return value */
-
-    /* Create the NetCDF file.  The NC_NETCDF4 parameter tells NetCDF to create
-       a file in NetCDF-4/HDF5 standard. NC_CLOBBER tells NetCDF to overwrite
-       this file, if it already exists. */ 
-    retval = nc_create (netcdf_file, NC_NETCDF4|NC_CLOBBER, &ncid);
-    if (retval)
+    char FUNC_NAME[] = "put_netcdf_constant_band";  /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    int line;                 /* first line of the current block */
+    int block_lines;          /* number of lines in a full block */
+    int retval;               /* function call return value */
+    size_t start[2];          /* first line and sample of the block */
+    size_t edges[2];          /* number of lines and samples in the block */
+    double pixel;             /* storage for the pixel value */
+    void *buf = NULL;         /* block of lines of the band */
+    Espa_trace_span_t write_span;  /* timing of the current write */
+    ESPA_TRACE_SCOPE (trace, "export_band", bmeta->name);  /* timing */
+
+    if (espa_constant_pixel (bmeta, &pixel) != SUCCESS)
     {
-        netCDF_ERR (retval);
-        sprintf (errmsg, "Error creating NetCDF file %s\n", netcdf_file);
+        sprintf (errmsg, "Converting the constant value of band %s",
+            bmeta->name);
         error_handler (true, FUNC_NAME, errmsg);
         return (ERROR);
     }
 
-    /* Write the global metadata */
-    if (write_global_attributes (ncid, xml_metadata) != SUCCESS)
+    block_lines = RB_PREFETCH_DEFAULT_LINES;
+    if (block_lines > bmeta->nlines)
+        block_lines = bmeta->nlines;
+    buf = espa_buffer_get ((size_t) block_lines * bmeta->nsamps * nbytes);
+    if (buf == NULL)
     {
-        sprintf (errmsg, "Writing global attributes for this NetCDF file.");
+        sprintf (errmsg, "Error allocating memory for the file buffer.");
         error_handler (true, FUNC_NAME, errmsg);
         return (ERROR);
     }
+    read_raw_binary_constant (block_lines, bmeta->nsamps, nbytes, &pixel,
+        buf);
 
-    /* Loop through the bands in the XML file and put each band in the NetCDF 
-       file */
-    ngrids = 1;
-    for (i = 0; i < xml_metadata->nbands; i++)
+    start[1] = 0;
+    edges[1] = bmeta->nsamps;
+    for (line = 0; line < bmeta->nlines; line += block_lines)
     {
-        /* Provide the status of processing */
-        printf ("Processing band: %s\n", xml_metadata->band[i].name);
-
-        /* Open the file for this band of data to allow for reading */
-        fp_rb = open_raw_binary (xml_metadata->band[i].file_name, "rb");
-        if (fp_rb == NULL)
+        start[0] = line;
+        edges[0] = block_lines;
+        if (line + block_lines > bmeta->nlines)
+            edges[0] = bmeta->nlines - line;
+        write_span = espa_trace_begin ("write_block", bmeta->name);
+        retval = nc_put_vara (ncid, band_varid, start, edges, buf);
+        espa_trace_end (&write_span);
+        if (retval)
         {
-            sprintf (errmsg, "Opening the input raw binary file: %s",
-                xml_metadata->band[i].file_name);
+            netCDF_ERR (retval);
+            sprintf (errmsg, "Error writing %s data to variable",
+                bmeta->name);
             error_handler (true, FUNC_NAME, errmsg);
+            espa_buffer_put (buf);
             return (ERROR);
         }
+    }
 
-        /* Define the dimensions for this band */
-        nlines = xml_metadata->band[i].nlines;
-        nsamps = xml_metadata->band[i].nsamps;
+    espa_buffer_put (buf);
+    return (SUCCESS);
+}
 
-        /* Determine the NetCDF data type */
-        switch (xml_metadata->band[i].data_type)
-        {
-            case (ESPA_INT8):
-                data_type = NC_BYTE;
-                nbytes = 1;
-                break;
-            case (ESPA_UINT8):
-                data_type = NC_UBYTE;
-                nbytes = 1;
-                break;
-            case (ESPA_INT16):
-                data_type = NC_SHORT;
-                nbytes = 2;
-                break;
-            case (ESPA_UINT16):
-                data_type = NC_USHORT;
-                nbytes = 2;
-                break;
-            case (ESPA_INT32):
-                data_type = NC_INT;
-                nbytes = 4;
-                break;
-            case (ESPA_UINT32):
-                data_type = NC_UINT;
-                nbytes = 4;
-                break;
-            case (ESPA_FLOAT32):
-                data_type = NC_FLOAT;
-                nbytes = 4;
-                break;
-            case (ESPA_FLOAT64):
-                data_type = NC_DOUBLE;
-                nbytes = 8;
-                break;
-            default:
-                sprintf (errmsg, "Unsupported ESPA data type.");
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
-        }
 
-        /* Allocate memory for the file buffer */
-        file_buf = calloc (nlines * nsamps, nbytes);
-        if (file_buf == NULL)
-        {
-            sprintf (errmsg, "Error allocating memory for the file buffer.");
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
+/******************************************************************************
+MODULE:  netcdf_chunk_shape
 
-        /* Read the data from the raw binary file */
-        if (read_raw_binary (fp_rb, nlines, nsamps, nbytes, file_buf) !=
-            SUCCESS)
-        {
-            sprintf (errmsg, "Reading image data from the raw binary file");
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
+PURPOSE: Determines the number of lines and samples in a chunk of a band
+variable, limiting the requested chunk dimensions to those of the band.
 
-        /* Close the raw binary file */
-        close_raw_binary (fp_rb);
-
-        /* Set the dimension names for this band.  The default is to use YDim,
-           XDim for the first band or for any bands matching the resolution of
-           the first band */
-        if (i == 0 ||
-            ((xml_metadata->band[i].pixel_size[0] ==
-             xml_metadata->band[0].pixel_size[0]) &&
-            (xml_metadata->band[i].pixel_size[1] ==
-             xml_metadata->band[0].pixel_size[1])))
-        {  /* first band or resolution matching the first band */
-            count = snprintf (dim_name[0], sizeof(dim_name[0]), "YDim_%s", 
-                xml_metadata->band[i].name);
-            if (count < 0 || count >= sizeof (dim_name[0]))
-            {
-                sprintf (errmsg, "Overflow of dim_name[0] string");
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
-            }
-            count = snprintf (dim_name[1], sizeof(dim_name[1]), "XDim_%s", 
-                xml_metadata->band[i].name);
-            if (count < 0 || count >= sizeof (dim_name[1]))
-            {
-                sprintf (errmsg, "Overflow of dim_name[1] string");
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
-            }
-        }
-        else
-        {  /* create new dimension name for this resolution */
-            /* Use the pixel size for non-geographic projections otherwise
-               use the grid count */
-            ngrids++;
-            if (xml_metadata->global.proj_info.proj_type == GCTP_GEO_PROJ)
-                mycount = ngrids;
-            else
-                mycount = (int) xml_metadata->band[i].pixel_size[1]; /* Y dim */
-
-            count = snprintf (dim_name[0], sizeof (dim_name[0]), 
-                "YDim_%s_%d", xml_metadata->band[i].name, mycount);  /* Y dim */
-            if (count < 0 || count >= sizeof (dim_name[0]))
-            {
-                sprintf (errmsg, "Overflow of dim_name[0] string");
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
-            }
+RETURN VALUE:
+Type = None
 
-            if (xml_metadata->global.proj_info.proj_type == GCTP_GEO_PROJ)
-                mycount = ngrids;
-            else
-                mycount = (int) xml_metadata->band[i].pixel_size[0]; /* X dim */
+NOTES:
+******************************************************************************/
+static void netcdf_chunk_shape
+(
+    Espa_band_meta_t *bmeta,     /* I: metadata of the band */
+    Netcdf_chunking_t *chunking, /* I: chunking of the band variables */
+    size_t chunks[2]             /* O: number of lines and samples in a
+                                       chunk */
+)
+{
+    chunks[0] = chunking->chunk_lines;
+    if (chunks[0] > (size_t) bmeta->nlines)
+        chunks[0] = bmeta->nlines;
+    chunks[1] = chunking->chunk_samps;
+    if (chunks[1] == 0 || chunks[1] > (size_t) bmeta->nsamps)
+        chunks[1] = bmeta->nsamps;
+}
 
-            count = snprintf (dim_name[1], sizeof (dim_name[1]),
-                "XDim_%s_%d", xml_metadata->band[i].name, mycount);  /* X dim */
-            if (count < 0 || count >= sizeof (dim_name[1]))
-            {
-                sprintf (errmsg, "Overflow of dim_name[1] string");
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
-            }
-        }
 
-        /* Define the dimensions for the band. */
-        if ((retval = nc_def_dim (ncid, dim_name[1], nsamps, &x_dimid)))
-        {
-            netCDF_ERR (retval);
-            sprintf (errmsg, "Error creating the x dimension of size %d", 
-                nsamps);
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
-        if ((retval = nc_def_dim (ncid, dim_name[0], nlines, &y_dimid)))
-        {
-            netCDF_ERR (retval);
-            sprintf (errmsg, "Error creating the y dimension of size %d", 
-                nlines);
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
+/******************************************************************************
+MODULE:  netcdf_band_meta
 
-        /* Define the x coordinate variable and attributes */
-        if ((retval = nc_def_var (ncid, dim_name[1], NC_FLOAT, 1, &x_dimid,
-             &x_varid)))
-        {
-            netCDF_ERR (retval);
-            sprintf (errmsg, "Error defining variable: %s", dim_name[1]);
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
+PURPOSE: Determines the metadata of a band as it is written to its variable.
 
-        /* Set up data compression if it was specified */
-        if (!no_compression)
-        {
-            /* Specify compression for this variable */
-            if ((retval = nc_def_var_deflate (ncid, x_varid, SHUFFLE, DEFLATE,
-                 DEFLATE_LEVEL)))
-            {
-                netCDF_ERR (retval);
-                sprintf (errmsg, "Error specifying the compression for "
-                    "variable: %s", dim_name[1]);
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
-            }
+RETURN VALUE:
+Type = bool
+Value           Description
+-----           -----------
+true            The physical values of the packed band are written
+false           The pixels of the band are written as they are
 
-            /* Increase the chunk cache size */
-            if ((retval = nc_set_var_chunk_cache (ncid, x_varid, CACHE_SIZE,
-                 CACHE_NELEMS, CACHE_PREEMPTION)))
-            {
-                netCDF_ERR (retval);
-                sprintf (errmsg, "Error specifying the chunk cache size for "
-                    "variable: %s", dim_name[1]);
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
-            }
-        }
+NOTES:
+  1. The copy shares the allocated fields of the band metadata, so it must
+     not be freed.
+******************************************************************************/
+static bool netcdf_band_meta
+(
+    Espa_band_meta_t *bmeta,     /* I: metadata of the band */
+    Netcdf_chunking_t *chunking, /* I: chunking of the band variables */
+    Espa_band_meta_t *vmeta      /* O: metadata of the band variable */
+)
+{
+    *vmeta = *bmeta;
+    if (!chunking->physical_units || !espa_cf_is_packed (bmeta))
+        return (false);
 
-        /* Define the y coordinate variable and attributes */
-        if ((retval = nc_def_var (ncid, dim_name[0], NC_FLOAT, 1, &y_dimid,
-             &y_varid)))
-        {
-            netCDF_ERR (retval);
-            sprintf (errmsg, "Error defining variable: %s", dim_name[0]);
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
+    espa_cf_physical_meta (vmeta);
+    return (true);
+}
 
-        /* Set up data compression if it was specified */
-        if (!no_compression)
-        {
-            /* Specify compression for this variable */
-            if ((retval = nc_def_var_deflate (ncid, y_varid, SHUFFLE, DEFLATE,
-                 DEFLATE_LEVEL)))
-            {
-                netCDF_ERR (retval);
-                sprintf (errmsg, "Error specifying the compression for "
-                    "variable: %s", dim_name[0]);
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
-            }
 
-            /* Increase the chunk cache size */
-            if ((retval = nc_set_var_chunk_cache (ncid, y_varid, CACHE_SIZE,
-                 CACHE_NELEMS, CACHE_PREEMPTION)))
-            {
-                netCDF_ERR (retval);
-                sprintf (errmsg, "Error specifying the chunk cache size for "
-                    "variable: %s", dim_name[0]);
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
-            }
-        }
+/* Significant digits kept of the float bands without a packed precision,
+   by a word of their data_units */
+static const struct
+{
+    const char *units;           /* word of the data_units */
+    int digits;                  /* significant digits kept */
+} netcdf_units_digits[] =
+{
+    {"reflectance", 4},
+    {"index", 4},
+    {"radiance", 5},
+    {"temperature", 5},
+    {"kelvin", 5},
+    {"meters", 5},
+    {"degrees", 6}
+};
 
-        /* Define the band variable */
-        dimids[0] = y_dimid;   /* lines */
-        dimids[1] = x_dimid;   /* samples */
-        if ((retval = nc_def_var (ncid, xml_metadata->band[i].name, data_type,
-            rank, dimids, &band_varid)))
-        {
-            netCDF_ERR (retval);
-            sprintf (errmsg, "Error defining band variable: %s", 
-                xml_metadata->band[i].name);
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
 
-        /* Specify compression for the primary variable */
-        if (!no_compression)
-        {
-            if ((retval = nc_def_var_deflate (ncid, band_varid, SHUFFLE,
-                 DEFLATE, DEFLATE_LEVEL)))
-            {
-                netCDF_ERR (retval);
-                sprintf (errmsg, "Error specifying the compression for "
-                    "variable: %s", xml_metadata->band[i].name);
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
-            }
+/******************************************************************************
+MODULE:  netcdf_significant_digits
 
-            /* Increase the chunk cache size */
-            if ((retval = nc_set_var_chunk_cache (ncid, band_varid, CACHE_SIZE,
-                 CACHE_NELEMS, CACHE_PREEMPTION)))
-            {
-                netCDF_ERR (retval);
-                sprintf (errmsg, "Error specifying the chunk cache size for "
-                    "variable: %s", xml_metadata->band[i].name);
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
-            }
-        }
+PURPOSE: Determines the number of significant digits kept of a band
+variable when it is quantized.
 
-        /* End define mode. This tells NetCDF we are done defining metadata
-           and are moving to writing the data. */
-        if ((retval = nc_enddef (ncid)))
-        {
-            netCDF_ERR (retval);
-            sprintf (errmsg, "Error ending the define mode.");
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+0               The variable isn't quantized
+> 0             Number of significant digits kept
 
-        /* Allocate space for the x coordinate variable */
-        xdims = (float *) calloc (nsamps, sizeof (float));
-        if (xdims == NULL)
-        {
-            sprintf (errmsg, "Error allocating %d floats for xdims", nsamps);
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
+NOTES:
+  1. Only float variables are quantized.  The digits given for every band
+     are used if there are any.
+  2. The physical values of a packed band keep enough digits to tell apart
+     the steps of its scale factor over its valid range, so no more is lost
+     than the packing already lost.
+  3. Otherwise the digits follow the data_units of the band (see
+     netcdf_units_digits), and the bands whose units aren't known are not
+     quantized.
+******************************************************************************/
+static int netcdf_significant_digits
+(
+    Espa_band_meta_t *bmeta,     /* I: metadata of the band */
+    Espa_band_meta_t *vmeta,     /* I: metadata of the band variable */
+    Netcdf_chunking_t *chunking  /* I: chunking of the band variables */
+)
+{
+    int i;                       /* looping variable for the units */
+    int digits = 0;              /* significant digits kept */
+    int max_digits;              /* most digits of the data type */
+    double step;                 /* step of the packed values */
+    double largest;              /* largest magnitude of the valid range */
+
+    if (chunking->quantize == NETCDF_QUANTIZE_NONE)
+        return (0);
+    if (vmeta->data_type == ESPA_FLOAT32)
+        max_digits = NETCDF_MAX_FLOAT_DIGITS;
+    else if (vmeta->data_type == ESPA_FLOAT64)
+        max_digits = NETCDF_MAX_DOUBLE_DIGITS;
+    else
+        return (0);
 
-        /* Create the x grid locations for the coordinate variables */
-        for (x = 0; x < nsamps; x++)
+    if (chunking->significant_digits > 0)
+        digits = chunking->significant_digits;
+    else if (vmeta->data_type != bmeta->data_type &&
+        fabs (vmeta->valid_range[0] - ESPA_FLOAT_META_FILL) > ESPA_EPSILON &&
+        fabs (vmeta->valid_range[1] - ESPA_FLOAT_META_FILL) > ESPA_EPSILON)
+    {
+        step = 1.0;
+        if (fabs (bmeta->scale_factor - ESPA_FLOAT_META_FILL) > ESPA_EPSILON
+            && bmeta->scale_factor != 0.0)
+            step = fabs (bmeta->scale_factor);
+        largest = fmax (fabs (vmeta->valid_range[0]),
+            fabs (vmeta->valid_range[1]));
+        if (largest > step)
+            digits = (int) ceil (log10 (largest / step)) + 1;
+        else
+            digits = 1;
+    }
+    else
+    {
+        for (i = 0; i < (int) (sizeof (netcdf_units_digits) /
+            sizeof (netcdf_units_digits[0])); i++)
         {
-            xdims[x] = xml_metadata->global.proj_info.ul_corner[0] 
-                + xml_metadata->band[i].pixel_size[0] * x;
+            if (strstr (bmeta->data_units, netcdf_units_digits[i].units))
+            {
+                digits = netcdf_units_digits[i].digits;
+                break;
+            }
         }
+    }
 
-        /* Write the x coordinate variables */
-        if ((retval = nc_put_var_float (ncid, x_varid, xdims)))
-        {
-            netCDF_ERR (retval);
-            sprintf (errmsg, "Error writing x coordinate data to variable");
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
+    if (digits > max_digits)
+        digits = max_digits;
+    return (digits);
+}
+
+
+/******************************************************************************
+MODULE:  netcdf_quantize_fill
+
+PURPOSE: Determines the fill value of a float band variable, which is left
+as it is by the quantization.
+
+RETURN VALUE:
+Type = double
+Value           Description
+-----           -----------
+n               _FillValue of the variable, or the NetCDF default fill
+
+NOTES:
+******************************************************************************/
+static double netcdf_quantize_fill
+(
+    Espa_band_meta_t *vmeta      /* I: metadata of the band variable */
+)
+{
+    if (vmeta->fill_value != ESPA_INT_META_FILL)
+    {
+        if (vmeta->data_type == ESPA_FLOAT32)
+            return ((float) vmeta->fill_value);
+        return (vmeta->fill_value);
+    }
+    if (vmeta->data_type == ESPA_FLOAT32)
+        return (NC_FILL_FLOAT);
+    return (NC_FILL_DOUBLE);
+}
+
+
+/******************************************************************************
+MODULE:  quantize_netcdf_values
+
+PURPOSE: Quantizes float values in place, keeping the specified number of
+significant digits, as the quantization of NetCDF does when the values are
+written through it.
+
+RETURN VALUE: None
+
+NOTES:
+  1. BitGroom keeps the bits needed for the digits, and alternately clears
+     and sets the rest so the errors cancel out on average.  The values
+     whose sample is even are cleared and the odd ones set, so the result
+     doesn't depend on how the band is cut into chunks.  Zero is never set.
+  2. Granular BitRound keeps the bits needed for the digits of each value on
+     its own, and rounds the rest.
+  3. The fill value, NaN, and infinity are left as they are.
+******************************************************************************/
+static void quantize_netcdf_values
+(
+    void *values,            /* I/O: values of a line of the band */
+    int nvals,               /* I: number of values */
+    int nbytes,              /* I: number of bytes per value (4 or 8) */
+    int samp0,               /* I: sample of the first value */
+    Netcdf_quantize_t quantize,  /* I: quantization of the values */
+    int digits,              /* I: significant digits kept */
+    double fill              /* I: fill value of the values */
+)
+{
+    int i;                   /* looping variable for the values */
+    int mant_bits;           /* number of explicit mantissa bits */
+    int keep_bits;           /* number of mantissa bits kept */
+    int zero_bits;           /* number of mantissa bits quantized */
+    int exponent;            /* binary exponent of the value */
+    int value_digits;        /* decimal digits left of the point */
+    int power;               /* binary power of the last digit kept */
+    double bits_per_digit = M_LN10 / M_LN2;  /* bits of a decimal digit */
+    double value;            /* current value */
+    double mantissa;         /* binary mantissa of the value */
+    uint64_t bits;           /* bits of the current value */
+    uint64_t mask;           /* mask of the bits kept */
+
+    mant_bits = nbytes == 4 ? 23 : 52;
+    keep_bits = (int) ceil (digits * bits_per_digit) + 1;
+    if (nbytes == 8)
+        keep_bits++;
+
+    for (i = 0; i < nvals; i++)
+    {
+        if (nbytes == 4)
+        {
+            value = ((float *) values)[i];
+            bits = ((uint32_t *) values)[i];
+        }
+        else
+        {
+            value = ((double *) values)[i];
+            bits = ((uint64_t *) values)[i];
+        }
+        if (value == fill || !isfinite (value) || value == 0.0)
+            continue;
+
+        if (quantize == NETCDF_QUANTIZE_GRANULARBR)
+        {
+            /* Bits needed for the digits of this value */
+            mantissa = fabs (frexp (value, &exponent));
+            value_digits = (int) floor (exponent / bits_per_digit
+                + log10 (mantissa)) + 1;
+            power = (int) floor (bits_per_digit * (value_digits - digits));
+            keep_bits = abs ((int) floor (exponent - bits_per_digit
+                * log10 (mantissa)) - power) - 1;
+        }
+        zero_bits = mant_bits - keep_bits;
+        if (zero_bits <= 0)
+            continue;
+        if (zero_bits > mant_bits)
+            zero_bits = mant_bits;
+        mask = ~(uint64_t) 0 << zero_bits;
+
+        if (quantize == NETCDF_QUANTIZE_GRANULARBR)
+            bits = (bits + ((uint64_t) 1 << (zero_bits - 1))) & mask;
+        else if ((samp0 + i) % 2 == 0)
+            bits &= mask;
+        else
+            bits |= ~mask;
+
+        if (nbytes == 4)
+            ((uint32_t *) values)[i] = (uint32_t) bits;
+        else
+            ((uint64_t *) values)[i] = bits;
+    }
+}
+
+
+/******************************************************************************
+MODULE:  set_netcdf_band_quantize
+
+PURPOSE: Sets the quantization of a float band variable.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error setting the quantization of the band variable
+SUCCESS         Successfully set the quantization, or the variable isn't
+                quantized
+
+NOTES:
+  1. NetCDF quantizes the values written through it and records the
+     significant digits in an attribute of the variable.  The chunks
+     compressed in parallel are quantized by quantize_netcdf_values.
+******************************************************************************/
+static int set_netcdf_band_quantize
+(
+    int ncid,                 /* I: NetCDF file ID */
+    int band_varid,           /* I: variable ID of the band */
+    Espa_band_meta_t *bmeta,  /* I: metadata of the band */
+    Espa_band_meta_t *vmeta,  /* I: metadata of the band variable */
+    Netcdf_chunking_t *chunking  /* I: chunking of the band variables */
+)
+{
+    char FUNC_NAME[] = "set_netcdf_band_quantize";  /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    int digits;               /* significant digits kept */
+#ifdef NC_QUANTIZE_BITGROOM
+    int retval;               /* function call return value */
+#endif
+
+    digits = netcdf_significant_digits (bmeta, vmeta, chunking);
+    if (digits == 0)
+        return (SUCCESS);
+
+#ifdef NC_QUANTIZE_BITGROOM
+    if ((retval = nc_def_var_quantize (ncid, band_varid,
+        chunking->quantize == NETCDF_QUANTIZE_GRANULARBR ?
+        NC_QUANTIZE_GRANULARBR : NC_QUANTIZE_BITGROOM, digits)))
+    {
+        netCDF_ERR (retval);
+        sprintf (errmsg, "Error specifying the quantization for variable: "
+            "%s", bmeta->name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+#else
+    sprintf (errmsg, "Quantizing variable %s needs netCDF-C 4.9.0 or later",
+        bmeta->name);
+    error_handler (true, FUNC_NAME, errmsg);
+    return (ERROR);
+#endif
+
+    printf ("  Quantizing %s to %d significant digits\n", bmeta->name,
+        digits);
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  set_netcdf_band_chunking
+
+PURPOSE: Sets the chunk shape and the chunk cache size of a band variable.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error setting the chunking of the band variable
+SUCCESS         Successfully set the chunking of the band variable
+
+NOTES:
+  1. NetCDF keeps the chunk cache of each variable until the file is closed,
+     so the cache budget is divided evenly among the band variables.  A
+     variable's share is raised if needed to hold one row of chunks, so
+     writing a block of lines never evicts a partly written chunk.
+******************************************************************************/
+static int set_netcdf_band_chunking
+(
+    int ncid,                 /* I: NetCDF file ID */
+    int band_varid,           /* I: variable ID of the band */
+    Espa_band_meta_t *bmeta,  /* I: metadata of the band */
+    int nbytes,               /* I: number of bytes in the data type */
+    int nvars,                /* I: number of band variables in the file */
+    Netcdf_chunking_t *chunking  /* I: chunking of the band variables */
+)
+{
+    char FUNC_NAME[] = "set_netcdf_band_chunking";  /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    int retval;               /* function call return value */
+    size_t chunks[2];         /* number of lines and samples in a chunk */
+    size_t row_size;          /* number of bytes in a row of chunks */
+    size_t cache_size;        /* chunk cache size of the variable */
+
+    netcdf_chunk_shape (bmeta, chunking, chunks);
+
+    if ((retval = nc_def_var_chunking (ncid, band_varid, NC_CHUNKED, chunks)))
+    {
+        netCDF_ERR (retval);
+        sprintf (errmsg, "Error specifying the chunk shape for variable: %s",
+            bmeta->name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    row_size = chunks[0] * chunks[1] * nbytes
+        * ((bmeta->nsamps + chunks[1] - 1) / chunks[1]);
+    cache_size = espa_mem_cache_bytes ((size_t) chunking->cache_mb * 1024
+        * 1024) / nvars;
+    if (cache_size < row_size)
+        cache_size = row_size;
+
+    if ((retval = nc_set_var_chunk_cache (ncid, band_varid, cache_size,
+         CACHE_NELEMS, CACHE_PREEMPTION)))
+    {
+        netCDF_ERR (retval);
+        sprintf (errmsg, "Error specifying the chunk cache size for "
+            "variable: %s", bmeta->name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  set_netcdf_coord_chunking
+
+PURPOSE: Stores a 1D coordinate variable as a single chunk with a chunk cache
+just large enough to hold it.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error setting the chunking of the coordinate variable
+SUCCESS         Successfully set the chunking of the coordinate variable
+
+NOTES:
+******************************************************************************/
+static int set_netcdf_coord_chunking
+(
+    int ncid,                 /* I: NetCDF file ID */
+    int varid,                /* I: variable ID of the coordinate variable */
+    char *name,               /* I: name of the coordinate variable */
+    int nvalues               /* I: number of values in the variable */
+)
+{
+    char FUNC_NAME[] = "set_netcdf_coord_chunking";  /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    int retval;               /* function call return value */
+    size_t chunk = nvalues;   /* number of values in the chunk */
+
+    if ((retval = nc_def_var_chunking (ncid, varid, NC_CHUNKED, &chunk)))
+    {
+        netCDF_ERR (retval);
+        sprintf (errmsg, "Error specifying the chunk shape for variable: %s",
+            name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    if ((retval = nc_set_var_chunk_cache (ncid, varid, chunk * sizeof (float),
+         CACHE_NELEMS, CACHE_PREEMPTION)))
+    {
+        netCDF_ERR (retval);
+        sprintf (errmsg, "Error specifying the chunk cache size for "
+            "variable: %s", name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  put_netcdf_band
+
+PURPOSE: Writes a band variable from the raw binary file of the band, a block
+of lines at a time.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the band variable
+SUCCESS         Successfully wrote the band variable
+
+NOTES:
+  1. The blocks are read ahead by the band stack while the previous block is
+     written.
+  2. For chunked (compressed) variables, the number of lines in a block is a
+     multiple of the number of lines in a chunk, so each block completes its
+     rows of chunks.
+******************************************************************************/
+static int put_netcdf_band
+(
+    int ncid,                 /* I: NetCDF file ID */
+    int band_varid,           /* I: variable ID of the band */
+    Espa_internal_meta_t *xml_metadata, /* I: XML metadata structure */
+    int band,                 /* I: index of the band in the metadata */
+    bool no_compression,      /* I: is the variable stored contiguously? */
+    Netcdf_chunking_t *chunking  /* I: chunking of the band variables */
+)
+{
+    char FUNC_NAME[] = "put_netcdf_band";  /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    int block_lines;          /* number of lines in a full block */
+    int retval;               /* function call return value */
+    size_t chunks[2];         /* number of lines and samples in a chunk */
+    size_t start[2];          /* first line and sample of the block */
+    size_t edges[2];          /* number of lines and samples in the block */
+    void *buf = NULL;         /* pixels of the block written */
+    float *physical = NULL;   /* physical values of the block; NULL if the
+                                 pixels are written as they are */
+    Espa_band_meta_t *bmeta = &xml_metadata->band[band]; /* band metadata */
+    Espa_band_meta_t vmeta;   /* metadata of the band variable */
+    Espa_band_stack_t *stack = NULL;  /* reader of the band */
+    Espa_band_block_t *block = NULL;  /* current block of lines */
+    Espa_trace_span_t write_span;     /* timing of the current write */
+    ESPA_TRACE_SCOPE (trace, "export_band", bmeta->name);  /* timing */
+
+    block_lines = RB_PREFETCH_DEFAULT_LINES;
+    if (!no_compression)
+    {
+        netcdf_chunk_shape (bmeta, chunking, chunks);
+        block_lines = (block_lines + chunks[0] - 1) / chunks[0] * chunks[0];
+        block_lines = espa_band_stack_lines (xml_metadata, 1, &band,
+            block_lines, chunks[0]);
+    }
+    else
+        block_lines = espa_band_stack_lines (xml_metadata, 1, &band,
+            block_lines, 1);
+
+    if (netcdf_band_meta (bmeta, chunking, &vmeta))
+    {
+        physical = espa_buffer_get ((size_t) block_lines * bmeta->nsamps
+            * sizeof (float));
+        if (physical == NULL)
+        {
+            sprintf (errmsg, "Error allocating memory for the physical "
+                "values.");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+    }
+
+    stack = open_band_stack (xml_metadata, 1, &band, block_lines, 0);
+    if (stack == NULL)
+    {
+        sprintf (errmsg, "Opening the band stack for band %s", bmeta->name);
+        error_handler (true, FUNC_NAME, errmsg);
+        espa_buffer_put (physical);
+        return (ERROR);
+    }
+
+    start[1] = 0;
+    edges[1] = bmeta->nsamps;
+    while (1)
+    {
+        if (get_band_stack_block (stack, &block) != SUCCESS)
+        {
+            sprintf (errmsg, "Reading image data from the raw binary file");
+            error_handler (true, FUNC_NAME, errmsg);
+            close_band_stack (stack);
+            espa_buffer_put (physical);
+            return (ERROR);
+        }
+        if (block == NULL)
+            break;
+
+        buf = block->band_buf[0];
+        if (physical != NULL)
+        {
+            espa_cf_unpack (bmeta, buf, (long) block->nlines * bmeta->nsamps,
+                physical);
+            buf = physical;
+        }
+
+        start[0] = block->line0;
+        edges[0] = block->nlines;
+        write_span = espa_trace_begin ("write_block", bmeta->name);
+        retval = nc_put_vara (ncid, band_varid, start, edges, buf);
+        espa_trace_end (&write_span);
+        if (retval)
+        {
+            netCDF_ERR (retval);
+            sprintf (errmsg, "Error writing %s data to variable",
+                bmeta->name);
+            error_handler (true, FUNC_NAME, errmsg);
+            close_band_stack (stack);
+            espa_buffer_put (physical);
+            return (ERROR);
+        }
+    }
+
+    close_band_stack (stack);
+    espa_buffer_put (physical);
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  compress_netcdf_chunk
+
+PURPOSE: Copies a chunk out of a block of lines, shuffles its bytes, and
+deflates it, exactly as the shuffle and deflate filters of the band variable
+would.
+
+RETURN VALUE:
+Type = size_t
+Value           Description
+-----           -----------
+0               Error compressing the chunk
+> 0             Number of bytes in the compressed chunk
+
+NOTES:
+  1. The part of an edge chunk outside the band is zero.
+******************************************************************************/
+static size_t compress_netcdf_chunk
+(
+    const unsigned char *lines, /* I: block of full lines holding the chunk */
+    int nlines,              /* I: number of lines of the chunk in the band */
+    int nsamps,              /* I: number of samples per line in lines */
+    int samp0,               /* I: 0-based first sample of the chunk */
+    const size_t chunks[2],  /* I: number of lines and samples in a chunk */
+    int nbytes,              /* I: number of bytes in the data type */
+    unsigned char *shuf_buf, /* I: storage for the shuffled chunk */
+    unsigned char *out_buf,  /* O: compressed chunk */
+    size_t out_size          /* I: number of bytes available in out_buf */
+)
+{
+    int line;                /* looping variable for the lines */
+    int samp;                /* looping variable for the samples */
+    int byte;                /* looping variable for the bytes of a sample */
+    int width;               /* number of samples of the chunk in the band */
+    size_t nelems = chunks[0] * chunks[1];  /* number of values in a chunk */
+    const unsigned char *src;   /* current sample of the block */
+    unsigned char *dest;        /* current value of the shuffled chunk */
+    uLongf out_len = out_size;  /* number of bytes in the compressed chunk */
+
+    width = nsamps - samp0;
+    if (width > (int) chunks[1])
+        width = chunks[1];
+
+    /* Byte j of value i goes to j * nelems + i, which is the transposition
+       done by the HDF5 shuffle filter */
+    memset (shuf_buf, 0, nelems * nbytes);
+    for (line = 0; line < nlines; line++)
+    {
+        src = lines + ((size_t) line * nsamps + samp0) * nbytes;
+        dest = shuf_buf + (size_t) line * chunks[1];
+        for (samp = 0; samp < width; samp++)
+            for (byte = 0; byte < nbytes; byte++)
+                dest[byte * nelems + samp] = *src++;
+    }
+
+    if (compress2 (out_buf, &out_len, shuf_buf, nelems * nbytes,
+        DEFLATE_LEVEL) != Z_OK)
+        return 0;
+    return out_len;
+}
+
+
+/* Block of lines whose chunks are compressed in parallel */
+typedef struct
+{
+    unsigned char *lines;       /* block of lines of the band; quantized in
+                                   place */
+    int nlines;                 /* number of lines in the block */
+    int nsamps;                 /* number of samples per line */
+    int ncols;                  /* number of chunks across the band */
+    int nbytes;                 /* number of bytes in the data type */
+    const size_t *chunks;       /* number of lines and samples in a chunk */
+    size_t chunk_size;          /* number of bytes in an uncompressed chunk */
+    unsigned char *shuf_buf;    /* shuffled chunk of each worker */
+    unsigned char *out_buf;     /* compressed chunks of the block */
+    size_t out_size;            /* largest number of bytes of a compressed
+                                   chunk */
+    size_t *out_len;            /* number of bytes of each compressed chunk */
+    Netcdf_quantize_t quantize; /* quantization of the values */
+    int digits;                 /* significant digits kept; 0 if the values
+                                   aren't quantized */
+    double fill;                /* fill value, which isn't quantized */
+} Netcdf_chunk_block_t;
+
+
+/******************************************************************************
+MODULE:  compress_netcdf_block_chunk
+
+PURPOSE: Compresses one chunk of a block of lines, as an iteration of the
+parallel loop over the chunks of the block.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+SUCCESS         Always; a chunk which couldn't be compressed has a length
+                of 0
+
+NOTES:
+  1. The values of a quantized band are quantized in place first, as NetCDF
+     would have before its filters.  The chunks cover separate parts of the
+     block, so they are quantized in parallel as well.
+******************************************************************************/
+static int compress_netcdf_block_chunk
+(
+    void *arg,                  /* I/O: block of lines of the band */
+    int chunk,                  /* I: index of the chunk in the block */
+    int worker                  /* I: worker compressing the chunk */
+)
+{
+    Netcdf_chunk_block_t *blk = arg;  /* block of lines of the band */
+    int line;                   /* looping variable for the lines */
+    int row;                    /* row of the chunk in the block */
+    int rows;                   /* number of lines of the chunk in the band */
+    int samp0;                  /* first sample of the chunk */
+    int width;                  /* number of samples of the chunk in the
+                                   band */
+
+    row = chunk / blk->ncols;
+    rows = blk->nlines - row * blk->chunks[0];
+    if (rows > (int) blk->chunks[0])
+        rows = blk->chunks[0];
+
+    if (blk->digits > 0)
+    {
+        samp0 = (chunk % blk->ncols) * blk->chunks[1];
+        width = blk->nsamps - samp0;
+        if (width > (int) blk->chunks[1])
+            width = blk->chunks[1];
+        for (line = 0; line < rows; line++)
+            quantize_netcdf_values (blk->lines + (((size_t) row
+                * blk->chunks[0] + line) * blk->nsamps + samp0)
+                * blk->nbytes, width, blk->nbytes, samp0, blk->quantize,
+                blk->digits, blk->fill);
+    }
+    blk->out_len[chunk] = compress_netcdf_chunk (blk->lines
+        + (size_t) row * blk->chunks[0] * blk->nsamps * blk->nbytes, rows,
+        blk->nsamps, (chunk % blk->ncols) * blk->chunks[1], blk->chunks,
+        blk->nbytes, blk->shuf_buf + worker * blk->chunk_size,
+        blk->out_buf + chunk * blk->out_size, blk->out_size);
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  write_netcdf_direct_band
+
+PURPOSE: Compresses the chunks of a band in parallel and writes them directly
+to the HDF5 dataset of the band variable, bypassing the single threaded HDF5
+filter pipeline.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the band
+SUCCESS         Successfully wrote the band
+
+NOTES:
+  1. The band variable must already be defined with the shuffle and deflate
+     filters and the chunk shape from netcdf_chunk_shape.  Chunks written
+     this way are byte for byte those the filters would have written, so
+     standard NetCDF4 readers see no difference.
+  2. The band is read ahead by the band stack, one row of chunks per thread
+     of the task pool at a time.  The chunks of those rows are compressed in
+     parallel on the pool, then written in order.
+  3. The size and checksum are of the compressed chunks, in the order they
+     are written, for the journal of the conversion (see
+     verify_netcdf_direct_band).
+******************************************************************************/
+static int write_netcdf_direct_band
+(
+    hid_t file_id,              /* I: HDF5 ID of the NetCDF file */
+    Espa_internal_meta_t *xml_metadata, /* I: XML metadata structure */
+    int band,                   /* I: index of the band in the metadata */
+    Netcdf_chunking_t *chunking, /* I: chunking of the band variables */
+    long long *size,            /* O: number of bytes of the compressed
+                                      chunks */
+    char *checksum              /* O: checksum of the compressed chunks; at
+                                      least RB_CHECKSUM_LEN bytes */
+)
+{
+    char FUNC_NAME[] = "write_netcdf_direct_band";  /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    int nthreads;               /* number of threads compressing chunks */
+    int ncols;                  /* number of chunks across the band */
+    int nchunks;                /* number of chunks in the current block */
+    int chunk;                  /* looping variable for the chunks */
+    int block_lines;            /* number of lines in a full block */
+    int nbytes;                 /* number of bytes in the data type */
+    size_t chunks[2];           /* number of lines and samples in a chunk */
+    size_t chunk_size;          /* number of bytes in an uncompressed chunk */
+    size_t out_size;            /* largest number of bytes of a compressed
+                                   chunk */
+    size_t *out_len = NULL;     /* number of bytes of each compressed chunk;
+                                   0 if it couldn't be compressed */
+    hsize_t offset[2];          /* first line and sample of the chunk */
+    hid_t dset_id;              /* HDF5 dataset of the band variable */
+    unsigned char *shuf_buf = NULL;  /* shuffled chunk of each thread */
+    unsigned char *out_buf = NULL;   /* compressed chunks of the block */
+    float *physical = NULL;     /* physical values of the block; NULL if the
+                                   pixels are written as they are */
+    Netcdf_chunk_block_t blk;   /* block whose chunks are compressed */
+    Espa_band_meta_t *bmeta = &xml_metadata->band[band]; /* band metadata */
+    Espa_band_meta_t vmeta;     /* metadata of the band variable */
+    Espa_band_stack_t *stack = NULL; /* reader of the band */
+    Espa_band_block_t *block = NULL; /* current block of lines */
+    int status = ERROR;         /* return status */
+    Rb_checksum_t sum;          /* checksum of the compressed chunks */
+    Espa_trace_span_t span;     /* timing of the current compression or
+                                   write */
+    ESPA_TRACE_SCOPE (trace, "export_band", bmeta->name);  /* timing */
+
+    *size = 0;
+    init_raw_binary_checksum (&sum);
+    nthreads = espa_task_pool_threads ();
+    netcdf_band_meta (bmeta, chunking, &vmeta);
+    nbytes = espa_data_type_size (vmeta.data_type);
+    netcdf_chunk_shape (bmeta, chunking, chunks);
+    ncols = (bmeta->nsamps + chunks[1] - 1) / chunks[1];
+    block_lines = espa_band_stack_lines (xml_metadata, 1, &band,
+        chunks[0] * nthreads, chunks[0]);
+    if (block_lines > bmeta->nlines)
+        block_lines = bmeta->nlines;
+    nchunks = (block_lines + chunks[0] - 1) / chunks[0] * ncols;
+    chunk_size = chunks[0] * chunks[1] * nbytes;
+    out_size = compressBound (chunk_size);
+
+    dset_id = H5Dopen2 (file_id, bmeta->name, H5P_DEFAULT);
+    if (dset_id < 0)
+    {
+        sprintf (errmsg, "Opening the HDF5 dataset of variable: %s",
+            bmeta->name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    stack = open_band_stack (xml_metadata, 1, &band, block_lines, 0);
+    shuf_buf = espa_buffer_get ((size_t) nthreads * chunk_size);
+    out_buf = espa_buffer_get ((size_t) nchunks * out_size);
+    out_len = malloc (nchunks * sizeof (size_t));
+    if (vmeta.data_type != bmeta->data_type)
+        physical = espa_buffer_get ((size_t) block_lines * bmeta->nsamps
+            * sizeof (float));
+    if (stack == NULL)
+    {
+        sprintf (errmsg, "Opening the band stack for band %s", bmeta->name);
+        error_handler (true, FUNC_NAME, errmsg);
+        goto cleanup;
+    }
+    if (shuf_buf == NULL || out_buf == NULL || out_len == NULL ||
+        (physical == NULL && vmeta.data_type != bmeta->data_type))
+    {
+        sprintf (errmsg, "Error allocating memory for the chunk buffers.");
+        error_handler (true, FUNC_NAME, errmsg);
+        goto cleanup;
+    }
+
+    blk.nsamps = bmeta->nsamps;
+    blk.ncols = ncols;
+    blk.nbytes = nbytes;
+    blk.chunks = chunks;
+    blk.chunk_size = chunk_size;
+    blk.shuf_buf = shuf_buf;
+    blk.out_buf = out_buf;
+    blk.out_size = out_size;
+    blk.out_len = out_len;
+    blk.quantize = chunking->quantize;
+    blk.digits = netcdf_significant_digits (bmeta, &vmeta, chunking);
+    blk.fill = netcdf_quantize_fill (&vmeta);
+    while (1)
+    {
+        if (get_band_stack_block (stack, &block) != SUCCESS)
+        {
+            sprintf (errmsg, "Reading image data from the raw binary file");
+            error_handler (true, FUNC_NAME, errmsg);
+            goto cleanup;
+        }
+        if (block == NULL)
+            break;
+        blk.lines = block->band_buf[0];
+        blk.nlines = block->nlines;
+        if (physical != NULL)
+        {
+            espa_cf_unpack (bmeta, block->band_buf[0], (long) block->nlines
+                * bmeta->nsamps, physical);
+            blk.lines = (unsigned char *) physical;
+        }
+
+        /* The workers of the loop never outnumber the threads of the pool,
+           so each has its own shuffle buffer */
+        nchunks = (block->nlines + chunks[0] - 1) / chunks[0] * ncols;
+        span = espa_trace_begin ("convert_block", bmeta->name);
+        espa_parallel_for (nchunks, nthreads, compress_netcdf_block_chunk,
+            &blk);
+        espa_trace_end (&span);
+
+        /* Write the chunks in order */
+        span = espa_trace_begin ("write_block", bmeta->name);
+        for (chunk = 0; chunk < nchunks; chunk++)
+        {
+            offset[0] = block->line0 + (chunk / ncols) * chunks[0];
+            offset[1] = (chunk % ncols) * chunks[1];
+            if (out_len[chunk] == 0)
+            {
+                sprintf (errmsg, "Compressing the chunk at line %d sample "
+                    "%d of variable: %s", (int) offset[0], (int) offset[1],
+                    bmeta->name);
+                error_handler (true, FUNC_NAME, errmsg);
+                goto cleanup;
+            }
+
+            if (H5Dwrite_chunk (dset_id, H5P_DEFAULT, 0, offset,
+                out_len[chunk], out_buf + chunk * out_size) < 0)
+            {
+                sprintf (errmsg, "Writing the chunk at line %d sample %d of "
+                    "variable: %s", (int) offset[0], (int) offset[1],
+                    bmeta->name);
+                error_handler (true, FUNC_NAME, errmsg);
+                goto cleanup;
+            }
+            update_raw_binary_checksum (&sum, out_buf + chunk * out_size,
+                out_len[chunk]);
+            *size += out_len[chunk];
+        }
+        espa_trace_end (&span);
+    }
+    format_raw_binary_checksum (&sum, checksum);
+    status = SUCCESS;
+
+cleanup:
+    close_band_stack (stack);
+    espa_buffer_put (shuf_buf);
+    espa_buffer_put (out_buf);
+    espa_buffer_put (physical);
+    free (out_len);
+    if (H5Dclose (dset_id) < 0 && status == SUCCESS)
+    {
+        sprintf (errmsg, "Closing the HDF5 dataset of variable: %s",
+            bmeta->name);
+        error_handler (true, FUNC_NAME, errmsg);
+        status = ERROR;
+    }
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  verify_netcdf_direct_band
+
+PURPOSE: Verifies the chunks of a band variable are those recorded in the
+journal of the conversion when the band was written.
+
+RETURN VALUE:
+Type = bool
+Value           Description
+-----           -----------
+true            The chunks have the recorded size and checksum
+false           A chunk is missing or can't be read, or the chunks differ
+                from what was recorded
+
+NOTES:
+  1. The compressed chunks are read back as stored, in the order they were
+     written by write_netcdf_direct_band, without decompressing them.
+******************************************************************************/
+static bool verify_netcdf_direct_band
+(
+    hid_t file_id,              /* I: HDF5 ID of the NetCDF file */
+    Espa_band_meta_t *bmeta,    /* I: metadata of the band */
+    Netcdf_chunking_t *chunking, /* I: chunking of the band variables */
+    const Espa_journal_entry_t *entry /* I: journal of the band */
+)
+{
+    int row;                    /* looping variable for the rows of chunks */
+    int col;                    /* looping variable for the chunks of a row */
+    int nrows;                  /* number of chunks down the band */
+    int ncols;                  /* number of chunks across the band */
+    bool same = true;           /* are the chunks as recorded? */
+    size_t chunks[2];           /* number of lines and samples in a chunk */
+    long long size = 0;         /* number of bytes of the chunks */
+    uint32_t filters;           /* filters skipped for the chunk */
+    hsize_t offset[2];          /* first line and sample of the chunk */
+    hsize_t nbytes;             /* number of bytes of the chunk */
+    hsize_t max_bytes;          /* largest number of bytes of a chunk */
+    hid_t dset_id;              /* HDF5 dataset of the band variable */
+    unsigned char *buf = NULL;  /* compressed chunk */
+    Rb_checksum_t sum;          /* checksum of the compressed chunks */
+    Espa_band_meta_t vmeta;     /* metadata of the band variable */
+
+    netcdf_chunk_shape (bmeta, chunking, chunks);
+    netcdf_band_meta (bmeta, chunking, &vmeta);
+    nrows = (bmeta->nlines + chunks[0] - 1) / chunks[0];
+    ncols = (bmeta->nsamps + chunks[1] - 1) / chunks[1];
+    max_bytes = compressBound (chunks[0] * chunks[1] *
+        espa_data_type_size (vmeta.data_type));
+
+    dset_id = H5Dopen2 (file_id, bmeta->name, H5P_DEFAULT);
+    if (dset_id < 0)
+        return (false);
+    buf = malloc (max_bytes);
+    if (buf == NULL)
+    {
+        H5Dclose (dset_id);
+        return (false);
+    }
+
+    init_raw_binary_checksum (&sum);
+    for (row = 0; row < nrows && same; row++)
+    {
+        for (col = 0; col < ncols && same; col++)
+        {
+            offset[0] = (hsize_t) row * chunks[0];
+            offset[1] = (hsize_t) col * chunks[1];
+            if (H5Dget_chunk_storage_size (dset_id, offset, &nbytes) < 0 ||
+                nbytes == 0 || nbytes > max_bytes ||
+                H5Dread_chunk (dset_id, H5P_DEFAULT, offset, &filters, buf)
+                < 0)
+            {
+                same = false;
+                break;
+            }
+            update_raw_binary_checksum (&sum, buf, nbytes);
+            size += nbytes;
+        }
+    }
+
+    free (buf);
+    H5Dclose (dset_id);
+    return (same && size == entry->size &&
+        match_raw_binary_checksum (&sum, entry->checksum));
+}
+
+
+/******************************************************************************
+MODULE:  remove_netcdf_band_source
+
+PURPOSE: Removes the raw binary image and ENVI header files of a band.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error removing the files
+SUCCESS         Successfully removed the files
+
+NOTES:
+******************************************************************************/
+static int remove_netcdf_band_source
+(
+    Espa_band_meta_t *bmeta,  /* I: metadata of the band */
+    bool missing_ok           /* I: may the files have been removed already
+                                    (i.e. by an interrupted run)? */
+)
+{
+    char FUNC_NAME[] = "remove_netcdf_band_source";  /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    char hdr_file[STR_SIZE];  /* ENVI header file */
+    char *cptr = NULL;        /* pointer to the file extension */
+    int count;                /* number of chars copied in snprintf */
+
+    /* .img file */
+    printf ("  Removing %s\n", bmeta->file_name);
+    if (unlink (bmeta->file_name) != 0 && !(missing_ok && errno == ENOENT))
+    {
+        sprintf (errmsg, "Deleting source file: %s", bmeta->file_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* .hdr file */
+    count = snprintf (hdr_file, sizeof (hdr_file), "%s", bmeta->file_name);
+    if (count < 0 || count >= sizeof (hdr_file))
+    {
+        sprintf (errmsg, "Overflow of hdr_file string");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    cptr = strrchr (hdr_file, '.');
+    strcpy (cptr, ".hdr");
+    printf ("  Removing %s\n", hdr_file);
+    if (unlink (hdr_file) != 0 && !(missing_ok && errno == ENOENT))
+    {
+        sprintf (errmsg, "Deleting source file: %s", hdr_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  write_netcdf_direct_bands
+
+PURPOSE: Writes the non-constant bands of a closed NetCDF file with
+write_netcdf_direct_band, removing their source files if specified.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the bands
+SUCCESS         Successfully wrote the bands
+
+NOTES:
+  1. If a journal is specified, the file is flushed after each band and the
+     band is recorded in the journal.  The bands recorded by an interrupted
+     run whose chunks are still intact are not written again (see
+     verify_netcdf_direct_band).
+******************************************************************************/
+static int write_netcdf_direct_bands
+(
+    char *netcdf_file,          /* I: NetCDF filename */
+    Espa_internal_meta_t *xml_metadata, /* I: XML metadata structure */
+    bool del_src,               /* I: should the source files be removed? */
+    Netcdf_chunking_t *chunking, /* I: chunking of the band variables */
+    Espa_journal_t *journal     /* I: journal of the conversion; NULL if
+                                      none */
+)
+{
+    char FUNC_NAME[] = "write_netcdf_direct_bands";  /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    char checksum[RB_CHECKSUM_LEN];  /* checksum of the compressed chunks */
+    int i;                      /* looping variable for each band */
+    int status = SUCCESS;       /* return status */
+    long long size;             /* number of bytes of the compressed chunks */
+    bool resumed;               /* was the band completed by an interrupted
+                                   run? */
+    hid_t file_id;              /* HDF5 ID of the NetCDF file */
+    Espa_band_meta_t *bmeta = NULL;  /* metadata of the current band */
+    const Espa_journal_entry_t *entry = NULL;  /* journal of the band */
+
+    file_id = H5Fopen (netcdf_file, H5F_ACC_RDWR, H5P_DEFAULT);
+    if (file_id < 0)
+    {
+        sprintf (errmsg, "Opening NetCDF file %s with HDF5", netcdf_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    for (i = 0; i < xml_metadata->nbands && status == SUCCESS; i++)
+    {
+        bmeta = &xml_metadata->band[i];
+        if (is_constant_band (bmeta))
+            continue;
+
+        entry = find_espa_journal_entry (journal, bmeta->name,
+            bmeta->checksum);
+        resumed = entry != NULL && !strcmp (entry->output, netcdf_file) &&
+            verify_netcdf_direct_band (file_id, bmeta, chunking, entry);
+        if (resumed)
+            printf ("Keeping completed band: %s\n", bmeta->name);
+        else
+        {
+            printf ("Compressing band: %s\n", bmeta->name);
+            status = write_netcdf_direct_band (file_id, xml_metadata, i,
+                chunking, &size, checksum);
+
+            /* Flush the band to the file before it is recorded */
+            if (status == SUCCESS && journal != NULL)
+            {
+                if (H5Fflush (file_id, H5F_SCOPE_GLOBAL) < 0)
+                {
+                    sprintf (errmsg, "Flushing NetCDF file %s with HDF5",
+                        netcdf_file);
+                    error_handler (true, FUNC_NAME, errmsg);
+                    status = ERROR;
+                }
+                else
+                    status = record_espa_journal_entry (journal, bmeta->name,
+                        bmeta->checksum, netcdf_file, size, checksum);
+            }
+        }
+
+        if (status == SUCCESS && del_src &&
+            !is_shared_band_file (xml_metadata, i, true))
+            status = remove_netcdf_band_source (bmeta, resumed);
+    }
+
+    if (H5Fclose (file_id) < 0 && status == SUCCESS)
+    {
+        sprintf (errmsg, "Closing NetCDF file %s with HDF5", netcdf_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        status = ERROR;
+    }
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  define_netcdf_band
+
+PURPOSE: Defines the dimensions, coordinate variables, and variable of a band
+in the NetCDF file, and writes the coordinates and the attributes of the band.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error defining the band
+SUCCESS         Successfully defined the band
+
+NOTES:
+  1. The dimensions are named as described in create_netcdf_metadata.
+  2. The band variable is ready to be written on return.
+******************************************************************************/
+static int define_netcdf_band
+(
+    int ncid,                 /* I: NetCDF file ID */
+    Espa_internal_meta_t *xml_metadata, /* I: XML metadata structure */
+    int band,                 /* I: index of the band in the metadata */
+    bool no_compression,      /* I: use compression for the NetCDF output
+                                    file? */
+    Netcdf_chunking_t *chunking,  /* I: chunking of the band variables */
+    int *band_varid,          /* O: variable ID of the band */
+    int *nbytes               /* O: number of bytes in the data type */
+)
+{
+    char FUNC_NAME[] = "define_netcdf_band";  /* function name */
+    char errmsg[STR_SIZE];        /* error message */
+    char dim_name[2][STR_SIZE];   /* array of dimension names */
+    int nlines;                   /* number of lines in the band */
+    int nsamps;                   /* number of samples in the band */
+    int status;                   /* return status */
+    int data_type;                /* data type for NetCDF file */
+    int rank = 2;                 /* rank of the band; set for 2D products */
+    int x_dimid;                  /* x-dimension ID */
+    int y_dimid;                  /* y-dimension ID */
+    int x_varid;                  /* x coordinate variable ID */
+    int y_varid;                  /* y coordinate variable ID */
+    int dimids[2];                /* array for the dimension IDs */
+    float *xdims = NULL;          /* coordinate values for the x-dimension */
+    float *ydims = NULL;          /* coordinate values for the y-dimension */
+    int x;                        /* loop index */
+    int y;                        /* loop index */
+    int retval = 0;               /* function call return value */
+    double ul_corner[2];          /* x, y of the UL pixel of the band */
+    bool new_grid;                /* is the band the first of its grid? */
+    Espa_band_grids_t grids;      /* grids of the bands */
+    Espa_band_meta_t vmeta;       /* metadata of the band variable */
+
+    /* Define the dimensions for this band */
+    nlines = xml_metadata->band[band].nlines;
+    nsamps = xml_metadata->band[band].nsamps;
+
+    /* Determine the NetCDF data type, which is float for the physical
+       values of a packed band */
+    netcdf_band_meta (&xml_metadata->band[band], chunking, &vmeta);
+    switch (vmeta.data_type)
+    {
+        case (ESPA_INT8):
+            data_type = NC_BYTE;
+            *nbytes = 1;
+            break;
+        case (ESPA_UINT8):
+            data_type = NC_UBYTE;
+            *nbytes = 1;
+            break;
+        case (ESPA_INT16):
+            data_type = NC_SHORT;
+            *nbytes = 2;
+            break;
+        case (ESPA_UINT16):
+            data_type = NC_USHORT;
+            *nbytes = 2;
+            break;
+        case (ESPA_INT32):
+            data_type = NC_INT;
+            *nbytes = 4;
+            break;
+        case (ESPA_UINT32):
+            data_type = NC_UINT;
+            *nbytes = 4;
+            break;
+        case (ESPA_FLOAT32):
+            data_type = NC_FLOAT;
+            *nbytes = 4;
+            break;
+        case (ESPA_FLOAT64):
+            data_type = NC_DOUBLE;
+            *nbytes = 8;
+            break;
+        default:
+            sprintf (errmsg, "Unsupported ESPA data type.");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+    }
+
+    /* Name the dimensions after the grid of the band, so the bands of a grid
+       share its dimensions and coordinate variables */
+    if (get_espa_band_grids (xml_metadata, &grids) != SUCCESS)
+    {
+        sprintf (errmsg, "Grouping the bands into grids");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    status = espa_grid_name (&grids, grids.band_grid[band], "YDim",
+        dim_name[0], sizeof (dim_name[0]));
+    if (status == SUCCESS)
+        status = espa_grid_name (&grids, grids.band_grid[band], "XDim",
+            dim_name[1], sizeof (dim_name[1]));
+    free_espa_band_grids (&grids);
+    if (status != SUCCESS)
+    {
+        sprintf (errmsg, "Naming the dimensions of band %s",
+            xml_metadata->band[band].name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Reuse the dimensions if an earlier band of the grid defined them */
+    new_grid = nc_inq_dimid (ncid, dim_name[1], &x_dimid) != NC_NOERR;
+    if (!new_grid && (retval = nc_inq_dimid (ncid, dim_name[0], &y_dimid)))
+    {
+        netCDF_ERR (retval);
+        sprintf (errmsg, "Error finding the y dimension %s", dim_name[0]);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    if (new_grid)
+    {
+        /* Define the dimensions of the grid of the band. */
+        if ((retval = nc_def_dim (ncid, dim_name[1], nsamps, &x_dimid)))
+        {
+            netCDF_ERR (retval);
+            sprintf (errmsg, "Error creating the x dimension of size %d", 
+                nsamps);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+        if ((retval = nc_def_dim (ncid, dim_name[0], nlines, &y_dimid)))
+        {
+            netCDF_ERR (retval);
+            sprintf (errmsg, "Error creating the y dimension of size %d", 
+                nlines);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+
+        /* Define the x coordinate variable and attributes */
+        if ((retval = nc_def_var (ncid, dim_name[1], NC_FLOAT, 1, &x_dimid,
+             &x_varid)))
+        {
+            netCDF_ERR (retval);
+            sprintf (errmsg, "Error defining variable: %s", dim_name[1]);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+
+        /* Set up data compression if it was specified */
+        if (!no_compression)
+        {
+            /* Specify compression for this variable */
+            if ((retval = nc_def_var_deflate (ncid, x_varid, SHUFFLE, DEFLATE,
+                 DEFLATE_LEVEL)))
+            {
+                netCDF_ERR (retval);
+                sprintf (errmsg, "Error specifying the compression for "
+                    "variable: %s", dim_name[1]);
+                error_handler (true, FUNC_NAME, errmsg);
+                return (ERROR);
+            }
+
+            /* Store the coordinates as a single chunk */
+            if (set_netcdf_coord_chunking (ncid, x_varid, dim_name[1],
+                nsamps) != SUCCESS)
+            {
+                sprintf (errmsg, "Setting the chunking for variable: %s",
+                    dim_name[1]);
+                error_handler (true, FUNC_NAME, errmsg);
+                return (ERROR);
+            }
+        }
+
+        /* Define the y coordinate variable and attributes */
+        if ((retval = nc_def_var (ncid, dim_name[0], NC_FLOAT, 1, &y_dimid,
+             &y_varid)))
+        {
+            netCDF_ERR (retval);
+            sprintf (errmsg, "Error defining variable: %s", dim_name[0]);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+
+        /* Set up data compression if it was specified */
+        if (!no_compression)
+        {
+            /* Specify compression for this variable */
+            if ((retval = nc_def_var_deflate (ncid, y_varid, SHUFFLE, DEFLATE,
+                 DEFLATE_LEVEL)))
+            {
+                netCDF_ERR (retval);
+                sprintf (errmsg, "Error specifying the compression for "
+                    "variable: %s", dim_name[0]);
+                error_handler (true, FUNC_NAME, errmsg);
+                return (ERROR);
+            }
+
+            /* Store the coordinates as a single chunk */
+            if (set_netcdf_coord_chunking (ncid, y_varid, dim_name[0],
+                nlines) != SUCCESS)
+            {
+                sprintf (errmsg, "Setting the chunking for variable: %s",
+                    dim_name[0]);
+                error_handler (true, FUNC_NAME, errmsg);
+                return (ERROR);
+            }
+        }
+    }
+
+    /* Define the band variable */
+    dimids[0] = y_dimid;   /* lines */
+    dimids[1] = x_dimid;   /* samples */
+    if ((retval = nc_def_var (ncid, xml_metadata->band[band].name, data_type,
+        rank, dimids, band_varid)))
+    {
+        netCDF_ERR (retval);
+        sprintf (errmsg, "Error defining band variable: %s", 
+            xml_metadata->band[band].name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Specify compression for the primary variable */
+    if (!no_compression)
+    {
+        if ((retval = nc_def_var_deflate (ncid, *band_varid, SHUFFLE,
+             DEFLATE, DEFLATE_LEVEL)))
+        {
+            netCDF_ERR (retval);
+            sprintf (errmsg, "Error specifying the compression for "
+                "variable: %s", xml_metadata->band[band].name);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+
+        /* Set the chunk shape and this variable's share of the chunk
+           cache */
+        if (set_netcdf_band_chunking (ncid, *band_varid, &vmeta, *nbytes,
+            xml_metadata->nbands, chunking) != SUCCESS)
+        {
+            sprintf (errmsg, "Setting the chunking for variable: %s",
+                xml_metadata->band[band].name);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+
+        /* Quantize the float values, if specified, so they compress
+           better */
+        if (set_netcdf_band_quantize (ncid, *band_varid,
+            &xml_metadata->band[band], &vmeta, chunking) != SUCCESS)
+        {
+            sprintf (errmsg, "Setting the quantization for variable: %s",
+                xml_metadata->band[band].name);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+    }
+
+    /* End define mode. This tells NetCDF we are done defining metadata
+       and are moving to writing the data. */
+    if ((retval = nc_enddef (ncid)))
+    {
+        netCDF_ERR (retval);
+        sprintf (errmsg, "Error ending the define mode.");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Write the coordinates of a new grid */
+    if (new_grid)
+    {
+        /* Find the UL pixel of the band, which differs from the UL corner
+           of the product on the grids other than the reference band's */
+        get_espa_grid_ul (xml_metadata, band, ul_corner);
+
+        /* Allocate space for the x coordinate variable */
+        xdims = (float *) calloc (nsamps, sizeof (float));
+        if (xdims == NULL)
+        {
+            sprintf (errmsg, "Error allocating %d floats for xdims", nsamps);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+
+        /* Create the x grid locations for the coordinate variables */
+        for (x = 0; x < nsamps; x++)
+        {
+            xdims[x] = ul_corner[0]
+                + xml_metadata->band[band].pixel_size[0] * x;
+        }
+
+        /* Write the x coordinate variables */
+        if ((retval = nc_put_var_float (ncid, x_varid, xdims)))
+        {
+            netCDF_ERR (retval);
+            sprintf (errmsg, "Error writing x coordinate data to variable");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
 
         /* Free the x coordinate variables */
         free (xdims);
@@ -991,8 +2199,8 @@ int create_netcdf_metadata
         /* Create the y grid locations for the coordinate variables */
         for (y = 0; y < nlines; y++)
         {
-            ydims[y] = xml_metadata->global.proj_info.ul_corner[1] 
-                - xml_metadata->band[i].pixel_size[1] * y;
+            ydims[y] = ul_corner[1]
+                - xml_metadata->band[band].pixel_size[1] * y;
         }
 
         /* Write the y coordinate variables */
@@ -1007,82 +2215,435 @@ int create_netcdf_metadata
         /* Free the y coordinate variables */
         free (ydims);
         ydims = NULL;
+    }
+
+    /* Write the band metadata.  This must happen before the band data is
+       written since the fill value must be written before the band data. */
+    if (write_band_attributes (ncid, &vmeta, *band_varid, data_type)
+        != SUCCESS)
+    {
+        sprintf (errmsg, "Writing %s attributes for this NetCDF file.",
+            xml_metadata->band[band].name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  define_netcdf_file
+
+PURPOSE: Create the NetCDF metadata file using info from the XML file.  The 
+file will also include the existing raw binary bands, except those left for
+write_netcdf_direct_bands.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error creating the NetCDF file
+SUCCESS         Successfully created the NetCDF file
+
+NOTES:
+  1. The ESPA products are 2D thus only 2D products are supported.
+  2. The bands are grouped into grids by get_espa_band_grids, and the bands
+     of a grid share its dimensions and coordinate variables.  XDim, YDim
+     refer to the grid of the first band; the other grids append the pixel
+     size to XDim, YDim (ex. XDim_15, YDim_15), or the count of the grids for
+     Geographic projections.  The coordinates are the UL pixel of each band
+     (see get_espa_grid_ul) stepped by its own pixel size.
+  3. Constant bands have no raw binary file.  Their pixels are synthesized
+     by put_netcdf_constant_band as they are written.  The other bands are
+     streamed a block of lines at a time by put_netcdf_band, so the memory
+     used doesn't depend on the size of the bands.
+  4. When compression is used, the band variables are chunked as specified
+     and share the chunk cache budget; see set_netcdf_band_chunking.
+     Uncompressed variables are stored contiguously and use no chunk cache.
+  5. With parallel compression, only the constant bands are written through
+     NetCDF.  The other band variables are left empty until the file is
+     closed, then written by write_netcdf_direct_bands.
+******************************************************************************/
+static int define_netcdf_file
+(
+    char *netcdf_file,     /* I: output NetCDF filename */
+    Espa_internal_meta_t *xml_metadata, /* I: XML metadata structure */
+    bool del_src,          /* I: should the source files be removed after
+                                 conversion? */
+    bool no_compression,   /* I: use compression for the NetCDF output file? */
+    Netcdf_chunking_t *chunking  /* I: chunking of the band variables */
+)
+{
+    char FUNC_NAME[] = "define_netcdf_file";  /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    int i;                        /* looping variable for each band */
+    int nbytes;                   /* number of bytes in the data type */
+    int ncid;                     /* NetCDF file ID */
+    int band_varid;               /* Variable ID for band */
+    int retval = 0;               /* function call return value */
+    bool constant;                /* is the current band a constant band? */
+    bool direct;                  /* are the chunks of the bands compressed
+                                     in parallel and written directly? */
+    bool deferred;                /* is the current band written after the
+                                     file is closed? */
+    Espa_band_meta_t vmeta;       /* metadata of the band variable */
+
+    /* Create the NetCDF file.  The NC_NETCDF4 parameter tells NetCDF to create
+       a file in NetCDF-4/HDF5 standard. NC_CLOBBER tells NetCDF to overwrite
+       this file, if it already exists. */ 
+    retval = nc_create (netcdf_file, NC_NETCDF4|NC_CLOBBER, &ncid);
+    if (retval)
+    {
+        netCDF_ERR (retval);
+        sprintf (errmsg, "Error creating NetCDF file %s\n", netcdf_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Write the global metadata */
+    if (write_netcdf_global_attributes (ncid, xml_metadata) != SUCCESS)
+    {
+        sprintf (errmsg, "Writing global attributes for this NetCDF file.");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Bands with parallel compression are written directly to their HDF5
+       datasets once the file is closed */
+    direct = !no_compression && chunking->parallel_compression;
+
+    /* Loop through the bands in the XML file and put each band in the NetCDF 
+       file */
+    for (i = 0; i < xml_metadata->nbands; i++)
+    {
+        /* Provide the status of processing */
+        espa_log_printf (ESPA_LOG_INFO, "Processing band: %s\n",
+            xml_metadata->band[i].name);
 
-        /* Write the band metadata.  This must happen before the band data is
-           written since the fill value must be written before the band data. */
-        if (write_band_attributes (ncid, &xml_metadata->band[i], band_varid,
-            data_type) != SUCCESS)
+        /* Constant bands have no file */
+        constant = is_constant_band (&xml_metadata->band[i]);
+        deferred = !constant && direct;
+
+        /* Define the variables of the band, and write its coordinates and
+           attributes */
+        if (define_netcdf_band (ncid, xml_metadata, i, no_compression,
+            chunking, &band_varid, &nbytes) != SUCCESS)
         {
-            sprintf (errmsg, "Writing %s attributes for this NetCDF file.",
+            sprintf (errmsg, "Defining band variable: %s",
                 xml_metadata->band[i].name);
             error_handler (true, FUNC_NAME, errmsg);
             return (ERROR);
         }
 
         /* Write the band variable */
-        if ((retval = nc_put_var (ncid, band_varid, file_buf)))
+        if (constant)
+        {
+            netcdf_band_meta (&xml_metadata->band[i], chunking, &vmeta);
+            if (put_netcdf_constant_band (ncid, band_varid, &vmeta, nbytes)
+                != SUCCESS)
+            {
+                sprintf (errmsg, "Error writing %s data to variable",
+                    xml_metadata->band[i].name);
+                error_handler (true, FUNC_NAME, errmsg);
+                return (ERROR);
+            }
+        }
+        else if (!deferred && put_netcdf_band (ncid, band_varid,
+            xml_metadata, i, no_compression, chunking) != SUCCESS)
         {
-            netCDF_ERR (retval);
             sprintf (errmsg, "Error writing %s data to variable",
                 xml_metadata->band[i].name);
             error_handler (true, FUNC_NAME, errmsg);
             return (ERROR);
         }
 
-        /* Free the file buffer. */
-        free (file_buf);
-        file_buf = NULL;
-
-        /* Remove the source files if specified */
-        if (del_src)
+        /* Remove the source files if specified; a stack of bands is removed
+           with its last band */
+        if (del_src && !constant && !deferred &&
+            !is_shared_band_file (xml_metadata, i, true))
         {
-            /* .img file */
-            printf ("  Removing %s\n", xml_metadata->band[i].file_name);
-            if (unlink (xml_metadata->band[i].file_name) != 0)
+            if (remove_netcdf_band_source (&xml_metadata->band[i], false)
+                != SUCCESS)
             {
-                sprintf (errmsg, "Deleting source file: %s",
-                    xml_metadata->band[i].file_name);
+                sprintf (errmsg, "Removing the source files of band %s",
+                    xml_metadata->band[i].name);
                 error_handler (true, FUNC_NAME, errmsg);
                 return (ERROR);
             }
+        }
+    }
 
-            /* .hdr file */
-            count = snprintf (hdr_file, sizeof (hdr_file), "%s",
-                xml_metadata->band[i].file_name);
-            if (count < 0 || count >= sizeof (hdr_file))
-            {
-                sprintf (errmsg, "Overflow of hdr_file string");
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
-            }
+    /* Close the NetCDF file. This frees up any internal NetCDF resources
+       associated with the file and flushes any buffers. */
+    retval = nc_close (ncid);
+    if (retval)
+    {
+        netCDF_ERR (retval);
+        sprintf (errmsg, "Error closing NetCDF file %s\n", netcdf_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
 
-            cptr = strrchr (hdr_file, '.');
-            strcpy (cptr, ".hdr");
-            printf ("  Removing %s\n", hdr_file);
-            if (unlink (hdr_file) != 0)
-            {
-                sprintf (errmsg, "Deleting source file: %s", hdr_file);
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
-            }
-        }
+    /* Successful conversion */
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  create_netcdf_file
+
+PURPOSE: Creates the NetCDF file with define_netcdf_file, then writes the
+bands with parallel compression with write_netcdf_direct_bands.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error creating the NetCDF file
+SUCCESS         Successfully created the NetCDF file
+
+NOTES:
+  1. The journal is only used with parallel compression, where the file is
+     complete once defined except for the bands written directly.  If the
+     journal has bands recorded by an interrupted run and the NetCDF file is
+     still there, the file isn't defined again, and only the bands whose
+     chunks aren't intact are written.  Otherwise the journal is started
+     over.
+  2. The finished file is dropped from the page cache (see
+     raw_binary_advise.h).
+******************************************************************************/
+static int create_netcdf_file
+(
+    char *netcdf_file,     /* I: output NetCDF filename */
+    Espa_internal_meta_t *xml_metadata, /* I: XML metadata structure */
+    bool del_src,          /* I: should the source files be removed after
+                                 conversion? */
+    bool no_compression,   /* I: use compression for the NetCDF output file? */
+    Netcdf_chunking_t *chunking, /* I: chunking of the band variables */
+    Espa_journal_t *journal      /* I: journal of the conversion; NULL if
+                                       none */
+)
+{
+    char FUNC_NAME[] = "create_netcdf_file";  /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    bool direct;             /* are the chunks of the bands compressed in
+                                parallel and written directly? */
+    bool resume;             /* is the file of an interrupted run kept? */
+
+    direct = !no_compression && chunking->parallel_compression;
+    if (!direct)
+        journal = NULL;
+    resume = journal != NULL && journal->nentries > 0 &&
+        H5Fis_hdf5 (netcdf_file) > 0;
+
+    if (resume)
+        printf ("Resuming NetCDF file %s\n", netcdf_file);
+    else if (reset_espa_journal (journal) != SUCCESS ||
+        define_netcdf_file (netcdf_file, xml_metadata, del_src,
+        no_compression, chunking) != SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+
+    /* Write the deferred bands */
+    if (direct && write_netcdf_direct_bands (netcdf_file, xml_metadata,
+        del_src, chunking, journal) != SUCCESS)
+    {
+        sprintf (errmsg, "Writing the compressed chunks of the bands to "
+            "NetCDF file %s", netcdf_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* The product isn't read again by this job, so it needn't evict the
+       data of other jobs from the page cache */
+    release_raw_binary_file (netcdf_file, true);
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  create_netcdf_metadata
+
+PURPOSE: Create the NetCDF metadata file using info from the XML file.  The 
+file will also include the existing raw binary bands.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error creating the NetCDF file
+SUCCESS         Successfully created the NetCDF file
+
+NOTES:
+  1. See define_netcdf_file.  No journal is kept.
+******************************************************************************/
+int create_netcdf_metadata
+(
+    char *netcdf_file,     /* I: output NetCDF filename */
+    Espa_internal_meta_t *xml_metadata, /* I: XML metadata structure */
+    bool del_src,          /* I: should the source files be removed after
+                                 conversion? */
+    bool no_compression,   /* I: use compression for the NetCDF output file? */
+    Netcdf_chunking_t *chunking  /* I: chunking of the band variables */
+)
+{
+    return (create_netcdf_file (netcdf_file, xml_metadata, del_src,
+        no_compression, chunking, NULL));
+}
+
+/******************************************************************************
+MODULE:  netcdf_xml_name
+
+PURPOSE: Determines the name of the XML file of the NetCDF product.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           The name doesn't fit in STR_SIZE characters
+SUCCESS         Successfully determined the name
+
+NOTES:
+  1. The file extension of the NetCDF file, if any, is replaced by _nc.xml.
+******************************************************************************/
+static int netcdf_xml_name
+(
+    char *netcdf_file,     /* I: output NetCDF filename */
+    char *xml_file         /* O: XML filename; at least STR_SIZE characters */
+)
+{
+    char *cptr = NULL;     /* pointer to the file extension */
+    int count;             /* number of chars copied in snprintf */
+
+    count = snprintf (xml_file, STR_SIZE, "%s", netcdf_file);
+    if (count < 0 || count >= STR_SIZE)
+        return (ERROR);
+
+    cptr = strrchr (xml_file, '.');
+    if (cptr != NULL)
+    {
+        /* File extension found.  Replace it with the new extension */
+        *cptr = '\0';
+        strcpy (cptr, "_nc.xml");
+    }
+    else if (count + strlen ("_nc.xml") < STR_SIZE)
+    {
+        /* No file extension found.  Just append the new extension */
+        strcat (xml_file, "_nc.xml");
+    }
+    else
+        return (ERROR);
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  netcdf_inputs_key
+
+PURPOSE: Builds the key of the inputs of the NetCDF file, for an incremental
+export (see espa_incremental.h).
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error building the key
+SUCCESS         Successfully built the key
+
+NOTES:
+  1. The NetCDF file carries the metadata as attributes, so the whole XML
+     metadata is part of its key along with the pixels of every band.  The
+     bands are added first, since the checksums of the bands which have none
+     are recorded in the metadata.
+******************************************************************************/
+static int netcdf_inputs_key
+(
+    Espa_internal_meta_t *xml_metadata, /* I/O: XML metadata structure */
+    bool no_compression,   /* I: use compression for the NetCDF output file? */
+    Netcdf_chunking_t *chunking,  /* I: chunking of the band variables */
+    Espa_inputs_key_t *key /* O: key of the inputs; empty on input */
+)
+{
+    int i;                   /* looping variable for the bands */
+
+    if (add_espa_inputs_key (key, "format netcdf compression %d chunks %d %d "
+        "parallel %d physical %d", !no_compression, chunking->chunk_lines,
+        chunking->chunk_samps, chunking->parallel_compression,
+        chunking->physical_units) != SUCCESS)
+        return (ERROR);
+    if (chunking->quantize != NETCDF_QUANTIZE_NONE &&
+        add_espa_inputs_key (key, "quantize %d digits %d",
+        chunking->quantize, chunking->significant_digits) != SUCCESS)
+        return (ERROR);
+
+    for (i = 0; i < xml_metadata->nbands; i++)
+    {
+        if (add_espa_band_inputs (key, xml_metadata, i) != SUCCESS)
+            return (ERROR);
     }
 
-    /* Close the NetCDF file. This frees up any internal NetCDF resources
-       associated with the file and flushes any buffers. */
-    retval = nc_close (ncid);
-    if (retval)
+    return (add_espa_metadata_inputs (key, xml_metadata));
+}
+
+
+/******************************************************************************
+MODULE:  parse_netcdf_quantize
+
+PURPOSE: Converts the name of a quantization to the quantization of the float
+bands.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Unknown quantization, or the NetCDF library can't quantize
+SUCCESS         Successfully converted the name
+
+NOTES:
+  1. Quantization came with NetCDF 4.8.1, so it is checked for here.
+******************************************************************************/
+int parse_netcdf_quantize
+(
+    char *name,                    /* I: name of the quantization (none,
+                                         bitgroom, or granularbr) */
+    Netcdf_quantize_t *quantize    /* O: quantization of the float bands */
+)
+{
+    char FUNC_NAME[] = "parse_netcdf_quantize";  /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+
+    if (!strcmp (name, "none"))
     {
-        netCDF_ERR (retval);
-        sprintf (errmsg, "Error closing NetCDF file %s\n", netcdf_file);
+        *quantize = NETCDF_QUANTIZE_NONE;
+        return (SUCCESS);
+    }
+    else if (!strcmp (name, "bitgroom"))
+        *quantize = NETCDF_QUANTIZE_BITGROOM;
+    else if (!strcmp (name, "granularbr"))
+        *quantize = NETCDF_QUANTIZE_GRANULARBR;
+    else
+    {
+        snprintf (errmsg, sizeof (errmsg), "Unknown quantization %s.  Valid "
+            "quantizations are none, bitgroom, and granularbr.", name);
         error_handler (true, FUNC_NAME, errmsg);
         return (ERROR);
     }
 
-    /* Successful conversion */
+#ifndef NC_QUANTIZE_BITGROOM
+    sprintf (errmsg, "Quantization isn't available; the NetCDF library is "
+        "older than 4.8.1");
+    error_handler (true, FUNC_NAME, errmsg);
+    return (ERROR);
+#else
     return (SUCCESS);
+#endif
 }
 
+
 /******************************************************************************
 MODULE:  convert_espa_to_netcdf
 
@@ -1100,6 +2661,18 @@ NOTES:
      rather than being external files. 
   2. No ENVI header file will be created. 
   3. Compression will be used.
+  4. With parallel compression, each band is recorded in a journal next to
+     the XML file as it is written.  If the conversion is interrupted,
+     running it again keeps the NetCDF file and the bands whose chunks are
+     still intact (see create_netcdf_file).  The journal is removed once the
+     conversion succeeds.
+  5. If ESPA_INCREMENTAL_ENV is set, the NetCDF file is only written when its
+     inputs have changed since it was last written (see
+     espa_incremental.h).  Otherwise only its XML file is written again.
+  6. With physical units, the packed bands are written as float32 physical
+     values with NaN fill (see espa_cf_packing.h), unpacked a block at a
+     time as they are streamed, and their metadata in the XML file describes
+     the physical values.
 ******************************************************************************/
 int convert_espa_to_netcdf
 (
@@ -1107,44 +2680,115 @@ int convert_espa_to_netcdf
     char *netcdf_file,     /* I: output NetCDF filename */
     bool del_src,          /* I: should the source files be removed after
                                  conversion? */
-    bool no_compression    /* I: use compression for the NetCDF output file? */
+    bool no_compression,   /* I: use compression for the NetCDF output file? */
+    Netcdf_chunking_t *chunking  /* I: chunking of the band variables */
 )
 {
     char FUNC_NAME[] = "convert_espa_to_netcdf";  /* function name */
     char errmsg[STR_SIZE];   /* error message */
     char xml_file[STR_SIZE]; /* new XML file for the NetCDF product */
-    char *cptr = NULL;       /* pointer to empty space in the band name */
     int i;                   /* band looping variable */
-    int count;               /* number of chars copied in snprintf */
+    bool incremental;        /* keep the NetCDF file if its inputs are
+                                unchanged? */
+    bool current = false;    /* is the NetCDF file of an earlier run kept? */
+    Espa_inputs_key_t key;   /* key of the inputs of the NetCDF file */
+    Espa_journal_t *journal = NULL;  /* journal of the conversion */
     Espa_internal_meta_t xml_metadata;  /* XML metadata structure to be
                                 populated by reading the MTL metadata file */
 
-    /* Validate the input metadata file */
-    if (validate_xml_file (espa_xml_file) != SUCCESS)
-    {  /* Error messages already written */
-        return (ERROR);
-    }
-
     /* Initialize the metadata structure */
     init_metadata_struct (&xml_metadata);
 
-    /* Parse the metadata file into our internal metadata structure; also
-       allocates space as needed for various pointers in the global and band
-       metadata */
-    if (parse_metadata (espa_xml_file, &xml_metadata) != SUCCESS)
+    /* Validate the metadata file and parse it into our internal metadata
+       structure, reading the file only once; also allocates space as needed
+       for various pointers in the global and band metadata */
+    if (validate_and_parse_metadata (espa_xml_file, &xml_metadata) != SUCCESS)
     {  /* Error messages already written */
         return (ERROR);
     }
 
-    /* Create the NetCDF file for the NetCDF metadata from the XML metadata. */
-    if (create_netcdf_metadata (netcdf_file, &xml_metadata, del_src, 
-        no_compression) != SUCCESS)
+    /* Keep the NetCDF file of an earlier run if its inputs are unchanged */
+    init_espa_inputs_key (&key);
+    incremental = use_espa_incremental ();
+    if (incremental)
     {
-        sprintf (errmsg, "Creating the NetCDF metadata file (%s) which "
-            "includes the raw binary bands.", netcdf_file);
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
+        if (netcdf_inputs_key (&xml_metadata, no_compression, chunking, &key)
+            != SUCCESS)
+        {
+            sprintf (errmsg, "Determining the inputs of the NetCDF file %s",
+                netcdf_file);
+            error_handler (true, FUNC_NAME, errmsg);
+            free_espa_inputs_key (&key);
+            return (ERROR);
+        }
+        current = espa_output_is_current (netcdf_file, &key);
+        if (!current && invalidate_espa_output (netcdf_file) != SUCCESS)
+        {  /* Error messages already written */
+            free_espa_inputs_key (&key);
+            return (ERROR);
+        }
+    }
+
+    if (current)
+    {
+        printf ("Keeping %s, whose inputs are unchanged\n", netcdf_file);
+
+        /* Remove the source files of the bands if specified */
+        for (i = 0; del_src && i < xml_metadata.nbands; i++)
+        {
+            if (is_constant_band (&xml_metadata.band[i]) ||
+                is_shared_band_file (&xml_metadata, i, true))
+                continue;
+            if (remove_netcdf_band_source (&xml_metadata.band[i], false)
+                != SUCCESS)
+            {  /* Error messages already written */
+                free_espa_inputs_key (&key);
+                return (ERROR);
+            }
+        }
     }
+    else
+    {
+        /* Pick up the bands completed by an interrupted run, if any */
+        if (!no_compression && chunking->parallel_compression)
+        {
+            journal = open_espa_journal (espa_xml_file, "nc");
+            if (journal == NULL)
+            {  /* Error messages already written */
+                free_espa_inputs_key (&key);
+                return (ERROR);
+            }
+        }
+
+        /* Create the NetCDF file for the NetCDF metadata from the XML
+           metadata. */
+        if (create_netcdf_file (netcdf_file, &xml_metadata, del_src,
+            no_compression, chunking, journal) != SUCCESS)
+        {
+            sprintf (errmsg, "Creating the NetCDF metadata file (%s) which "
+                "includes the raw binary bands.", netcdf_file);
+            error_handler (true, FUNC_NAME, errmsg);
+            close_espa_journal (journal);
+            free_espa_inputs_key (&key);
+            return (ERROR);
+        }
+
+        /* All the bands are in place, so the journal is no longer needed */
+        if (remove_espa_journal (journal) != SUCCESS)
+        {  /* Error messages already written */
+            free_espa_inputs_key (&key);
+            return (ERROR);
+        }
+
+        /* Record the inputs the NetCDF file was written from */
+        if (incremental && record_espa_output_inputs (netcdf_file, &key)
+            != SUCCESS)
+        {  /* Error messages already written */
+            free_espa_inputs_key (&key);
+            return (ERROR);
+        }
+    }
+    free_espa_inputs_key (&key);
 
     /* Remove the source files if specified */
     if (del_src)
@@ -1160,32 +2804,25 @@ int convert_espa_to_netcdf
     }
 
     /* Loop through the bands and modify the band names to be those of the
-       overall netCDF product */
+       overall netCDF product, which holds the pixels of every band, as they
+       were written */
     for (i = 0; i < xml_metadata.nbands; i++)
+    {
+        if (chunking->physical_units &&
+            espa_cf_is_packed (&xml_metadata.band[i]))
+            espa_cf_physical_meta (&xml_metadata.band[i]);
         strcpy (xml_metadata.band[i].file_name, netcdf_file);
+        xml_metadata.band[i].constant_value = ESPA_FLOAT_META_FILL;
+    }
 
     /* Create the XML file for the NetCDF product */
-    count = snprintf (xml_file, sizeof (xml_file), "%s", netcdf_file);
-    if (count < 0 || count >= sizeof (xml_file))
+    if (netcdf_xml_name (netcdf_file, xml_file) != SUCCESS)
     {
         sprintf (errmsg, "Overflow of xml_file string");
         error_handler (true, FUNC_NAME, errmsg);
         return (ERROR);
     }
 
-    cptr = strrchr (xml_file, '.');
-    if (cptr != NULL)
-    {
-        /* File extension found.  Replace it with the new extension */
-        *cptr = '\0';
-        strcpy (cptr, "_nc.xml");
-    }
-    else
-    {
-        /* File extension found.  Replace it with the new extension */
-        strcat (xml_file, "_nc.xml");
-    }
-
     /* Write the new XML file containing the new band names */
     if (write_metadata (&xml_metadata, xml_file) != SUCCESS)
     {
@@ -1202,3 +2839,396 @@ int convert_espa_to_netcdf
     return (SUCCESS);
 }
 
+
+
+/* State of the NetCDF export sink */
+typedef struct
+{
+    char netcdf_file[STR_SIZE];     /* output NetCDF filename */
+    int ncid;                       /* NetCDF file ID; -1 once closed */
+    int band_varid;                 /* variable ID of the current band */
+    bool no_compression;            /* are the band variables stored
+                                       contiguously? */
+    Netcdf_chunking_t chunking;     /* chunking of the band variables */
+    Espa_inputs_key_t key;          /* key of the inputs of the NetCDF file
+                                       when exporting incrementally; empty
+                                       otherwise */
+    bool current;                   /* is the NetCDF file kept from an
+                                       earlier run? */
+} Netcdf_export_t;
+
+
+/******************************************************************************
+MODULE:  netcdf_export_needs_band
+
+PURPOSE: Determines whether the bands are written by the export fan-out,
+rather than the NetCDF file being kept from an earlier run.
+
+RETURN VALUE:
+Type = bool
+Value           Description
+-----           -----------
+true            The band is written
+false           The NetCDF file is kept
+
+NOTES:
+******************************************************************************/
+static bool netcdf_export_needs_band
+(
+    void *state,                        /* I: state of the sink */
+    Espa_internal_meta_t *xml_metadata, /* I: XML metadata structure */
+    int band                            /* I: index of the band */
+)
+{
+    Netcdf_export_t *netcdf = state;    /* state of the sink */
+
+    return (!netcdf->current);
+}
+
+
+/******************************************************************************
+MODULE:  begin_netcdf_export_band
+
+PURPOSE: Defines the variable of a band fed by the export fan-out.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error defining the band
+SUCCESS         Successfully defined the band
+
+NOTES:
+******************************************************************************/
+static int begin_netcdf_export_band
+(
+    void *state,                        /* I/O: state of the sink */
+    Espa_internal_meta_t *xml_metadata, /* I: XML metadata structure */
+    int band                            /* I: index of the band */
+)
+{
+    Netcdf_export_t *netcdf = state;    /* state of the sink */
+    int nbytes;                         /* number of bytes in the data type */
+
+    espa_log_printf (ESPA_LOG_INFO, "Processing band: %s\n",
+        xml_metadata->band[band].name);
+    return (define_netcdf_band (netcdf->ncid, xml_metadata, band,
+        netcdf->no_compression, &netcdf->chunking, &netcdf->band_varid,
+        &nbytes));
+}
+
+
+/******************************************************************************
+MODULE:  write_netcdf_export_block
+
+PURPOSE: Writes a block of lines fed by the export fan-out to the variable of
+the band.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the lines
+SUCCESS         Successfully wrote the lines
+
+NOTES:
+******************************************************************************/
+static int write_netcdf_export_block
+(
+    void *state,                        /* I/O: state of the sink */
+    Espa_internal_meta_t *xml_metadata, /* I: XML metadata structure */
+    int band,                           /* I: index of the band */
+    Espa_band_block_t *block            /* I: block of lines */
+)
+{
+    char FUNC_NAME[] = "write_netcdf_export_block";  /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    int retval;               /* function call return value */
+    size_t start[2];          /* first line and sample of the block */
+    size_t edges[2];          /* number of lines and samples in the block */
+    Netcdf_export_t *netcdf = state;    /* state of the sink */
+
+    start[0] = block->line0;
+    start[1] = 0;
+    edges[0] = block->nlines;
+    edges[1] = block->nsamps;
+    if ((retval = nc_put_vara (netcdf->ncid, netcdf->band_varid, start,
+        edges, block->band_buf[0])))
+    {
+        netCDF_ERR (retval);
+        sprintf (errmsg, "Error writing %s data to variable",
+            xml_metadata->band[band].name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  end_netcdf_export_band
+
+PURPOSE: Completes a band fed by the export fan-out.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+SUCCESS         Always
+
+NOTES:
+  1. The variable is complete once its last block is written.
+******************************************************************************/
+static int end_netcdf_export_band
+(
+    void *state,                        /* I/O: state of the sink */
+    Espa_internal_meta_t *xml_metadata, /* I: XML metadata structure */
+    int band                            /* I: index of the band */
+)
+{
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  finish_netcdf_export
+
+PURPOSE: Closes the NetCDF file and writes the XML file of the NetCDF product
+once all the bands have been exported, and frees the state of the sink.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error closing the NetCDF file or writing the XML file
+SUCCESS         Successfully completed the NetCDF product
+
+NOTES:
+******************************************************************************/
+static int finish_netcdf_export
+(
+    void *state,                        /* I: state of the sink */
+    Espa_internal_meta_t *xml_metadata, /* I: XML metadata structure */
+    bool complete                       /* I: were all the bands exported? */
+)
+{
+    char FUNC_NAME[] = "finish_netcdf_export";  /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    char xml_file[STR_SIZE];    /* new XML file for the NetCDF product */
+    char (*file_names)[STR_SIZE] = NULL;  /* output file of each band */
+    int i;                      /* looping variable for each band */
+    int retval;                 /* function call return value */
+    int status = SUCCESS;       /* return status */
+    Netcdf_export_t *netcdf = state;  /* state of the sink */
+
+    /* Close the NetCDF file, flushing the chunks of the band variables */
+    if (!netcdf->current)
+    {
+        retval = nc_close (netcdf->ncid);
+        if (retval)
+        {
+            netCDF_ERR (retval);
+            sprintf (errmsg, "Error closing NetCDF file %s",
+                netcdf->netcdf_file);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+        }
+    }
+
+    /* Record the inputs the NetCDF file was written from */
+    if (complete && status == SUCCESS && !netcdf->current &&
+        netcdf->key.len > 0 && record_espa_output_inputs
+        (netcdf->netcdf_file, &netcdf->key) != SUCCESS)
+        status = ERROR;   /* Error messages already written */
+
+    /* The NetCDF file holds the pixels of every band */
+    if (complete && status == SUCCESS)
+    {
+        file_names = calloc (xml_metadata->nbands, STR_SIZE);
+        if (file_names == NULL)
+        {
+            sprintf (errmsg, "Allocating the band file names");
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+        }
+        else if (netcdf_xml_name (netcdf->netcdf_file, xml_file) != SUCCESS)
+        {
+            sprintf (errmsg, "Overflow of xml_file string");
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+        }
+        else
+        {
+            for (i = 0; i < xml_metadata->nbands; i++)
+                strcpy (file_names[i], netcdf->netcdf_file);
+            if (write_export_metadata (xml_metadata, file_names, xml_file)
+                != SUCCESS)
+            {
+                sprintf (errmsg, "Error writing updated XML for the NetCDF "
+                    "product: %s", xml_file);
+                error_handler (true, FUNC_NAME, errmsg);
+                status = ERROR;
+            }
+        }
+        free (file_names);
+    }
+
+    free_espa_inputs_key (&netcdf->key);
+    free (netcdf);
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  init_netcdf_export_sink
+
+PURPOSE: Creates the NetCDF file and sets up an export sink which writes the
+band variables from the blocks fed by the export fan-out (see
+export_espa_fanout).
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error creating the NetCDF file or setting up the sink
+SUCCESS         Successfully set up the sink
+
+NOTES:
+  1. The variables and the XML file are as written by convert_espa_to_netcdf.
+  2. The chunks are compressed by the NetCDF filters in the thread of the
+     sink, while the other sinks run alongside.
+  3. Compressed band variables are chunked as blocks of full width lines,
+     matching the blocks of the fan-out, so each block completes its row of
+     chunks.  The variables share the default chunk cache budget.
+  4. If ESPA_INCREMENTAL_ENV is set and the NetCDF file is current (see
+     espa_incremental.h), the file is kept and the sink needs none of the
+     bands.
+******************************************************************************/
+int init_netcdf_export_sink
+(
+    char *netcdf_file,     /* I: output NetCDF filename */
+    Espa_internal_meta_t *xml_metadata, /* I: XML metadata structure */
+    bool no_compression,   /* I: use compression for the NetCDF output file? */
+    int block_lines,       /* I: number of lines per block of the fan-out */
+    Espa_export_sink_t *sink  /* O: NetCDF export sink */
+)
+{
+    char FUNC_NAME[] = "init_netcdf_export_sink";  /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    int retval;                 /* function call return value */
+    Netcdf_export_t *netcdf = NULL;  /* state of the sink */
+
+    if (strlen (netcdf_file) >= STR_SIZE)
+    {
+        sprintf (errmsg, "Overflow of netcdf_file string");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    netcdf = calloc (1, sizeof (Netcdf_export_t));
+    if (netcdf == NULL)
+    {
+        sprintf (errmsg, "Allocating the NetCDF export sink");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    strcpy (netcdf->netcdf_file, netcdf_file);
+    netcdf->no_compression = no_compression;
+    netcdf->chunking.chunk_lines = block_lines;
+    netcdf->chunking.chunk_samps = DEFAULT_CHUNK_SAMPS;
+    netcdf->chunking.cache_mb = DEFAULT_CACHE_MB;
+    netcdf->chunking.parallel_compression = false;
+    init_espa_inputs_key (&netcdf->key);
+
+    /* Keep the NetCDF file of an earlier run if its inputs are unchanged */
+    if (use_espa_incremental ())
+    {
+        if (netcdf_inputs_key (xml_metadata, no_compression,
+            &netcdf->chunking, &netcdf->key) != SUCCESS)
+        {
+            sprintf (errmsg, "Determining the inputs of the NetCDF file %s",
+                netcdf_file);
+            error_handler (true, FUNC_NAME, errmsg);
+            free_espa_inputs_key (&netcdf->key);
+            free (netcdf);
+            return (ERROR);
+        }
+        netcdf->current = espa_output_is_current (netcdf_file, &netcdf->key);
+        if (netcdf->current)
+            printf ("Keeping %s, whose inputs are unchanged\n", netcdf_file);
+        else if (invalidate_espa_output (netcdf_file) != SUCCESS)
+        {  /* Error messages already written */
+            free_espa_inputs_key (&netcdf->key);
+            free (netcdf);
+            return (ERROR);
+        }
+    }
+
+    /* Create the NetCDF file and write the global metadata */
+    netcdf->ncid = -1;
+    if (!netcdf->current)
+    {
+        retval = nc_create (netcdf_file, NC_NETCDF4|NC_CLOBBER,
+            &netcdf->ncid);
+        if (retval)
+        {
+            netCDF_ERR (retval);
+            sprintf (errmsg, "Error creating NetCDF file %s", netcdf_file);
+            error_handler (true, FUNC_NAME, errmsg);
+            free_espa_inputs_key (&netcdf->key);
+            free (netcdf);
+            return (ERROR);
+        }
+
+        if (write_netcdf_global_attributes (netcdf->ncid, xml_metadata)
+            != SUCCESS)
+        {
+            sprintf (errmsg, "Writing global attributes for this NetCDF "
+                "file.");
+            error_handler (true, FUNC_NAME, errmsg);
+            nc_close (netcdf->ncid);
+            free_espa_inputs_key (&netcdf->key);
+            free (netcdf);
+            return (ERROR);
+        }
+    }
+
+    strcpy (sink->name, "NetCDF");
+    sink->state = netcdf;
+    sink->needs_band = netcdf_export_needs_band;
+    sink->begin_band = begin_netcdf_export_band;
+    sink->write_block = write_netcdf_export_block;
+    sink->end_band = end_netcdf_export_band;
+    sink->finish = finish_netcdf_export;
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  netcdf_export_entry
+
+PURPOSE: Entry point of the NetCDF format in the export registry (see
+espa_export_registry.h), which creates the NetCDF file and sets up its
+export sink.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error setting up the sink
+SUCCESS         Successfully set up the sink
+
+NOTES:
+******************************************************************************/
+int netcdf_export_entry
+(
+    char *out_file,        /* I: output NetCDF filename */
+    Espa_internal_meta_t *xml_metadata, /* I: XML metadata structure */
+    const Espa_export_options_t *options,  /* I: export options */
+    Espa_export_sink_t *sink  /* O: NetCDF export sink */
+)
+{
+    return (init_netcdf_export_sink (out_file, xml_metadata,
+        options->no_compression, options->block_lines, sink));
+}
@@ -24,6 +24,12 @@ NOTES:
 #include "parse_metadata.h"
 #include "write_metadata.h"
 #include "raw_binary_io.h"
+#include "espa_band_stack.h"
+#include "espa_buffer_pool.h"
+#include "espa_export_registry.h"
+#include "espa_journal.h"
+#include "espa_incremental.h"
+#include "espa_band_grids.h"
 
 /* Define the compression parameters - use data shuffling (NC_SUFFLE),
    turn on compression, and use a mid-level compression */
@@ -31,12 +37,48 @@ NOTES:
 #define DEFLATE 1
 #define DEFLATE_LEVEL 4
 
-/* Chunking cache parameters - cache size of 1 GB. Number of cache elements
- *    should be over 1000 and a prime number. */
-#define CACHE_SIZE 1000000000
+/* Chunking parameters - by default the band variables are chunked as blocks
+   of full width lines, matching the blocks the bands are read and written
+   in, and all the band variables share a chunk cache budget of 256 MB.
+   Number of cache elements should be over 1000 and a prime number. */
+#define DEFAULT_CHUNK_LINES RB_PREFETCH_DEFAULT_LINES
+#define DEFAULT_CHUNK_SAMPS 0
+#define DEFAULT_CACHE_MB 256
 #define CACHE_NELEMS 1009
 #define CACHE_PREEMPTION 0.75
 
+/* Lossy quantization of the float band variables, which keeps a number of
+   significant digits so the shuffle and deflate filters compress them much
+   better; needs netCDF-C 4.9.0 or later */
+typedef enum {
+    NETCDF_QUANTIZE_NONE,       /* values are kept as they are */
+    NETCDF_QUANTIZE_BITGROOM,   /* BitGroom */
+    NETCDF_QUANTIZE_GRANULARBR  /* Granular BitRound */
+} Netcdf_quantize_t;
+
+/* Most significant digits kept of float32 and float64 values */
+#define NETCDF_MAX_FLOAT_DIGITS 7
+#define NETCDF_MAX_DOUBLE_DIGITS 15
+
+/* Chunk shape and chunk cache budget of the band variables */
+typedef struct
+{
+    int chunk_lines;     /* number of lines per chunk */
+    int chunk_samps;     /* number of samples per chunk; 0 for full lines */
+    int cache_mb;        /* total chunk cache, in MB, shared by all the band
+                            variables */
+    bool parallel_compression;  /* compress the chunks of the band variables
+                            in parallel and write them directly to the
+                            HDF5 datasets? */
+    bool physical_units; /* write the packed bands as the float32 physical
+                            values of their scale_factor and add_offset
+                            (see espa_cf_packing.h)? */
+    Netcdf_quantize_t quantize;  /* quantization of the float band
+                            variables; only with compression */
+    int significant_digits;  /* significant digits kept of every float
+                            band; 0 to derive them for each band */
+} Netcdf_chunking_t;
+
 /* Handle netCDF errors by printing an error message */
 #define netCDF_ERR(e) {printf("netCDF error: %s\n", nc_strerror(e));}
 
@@ -45,7 +87,14 @@ NOTES:
 #define YDIM_NAME "y"
 
 /* Prototypes */
-int write_global_attributes
+int parse_netcdf_quantize
+(
+    char *name,                    /* I: name of the quantization (none,
+                                         bitgroom, or granularbr) */
+    Netcdf_quantize_t *quantize    /* O: quantization of the float bands */
+);
+
+int write_netcdf_global_attributes
 (
     int ncid,                /* I: netCDF file ID to write attributes */
     Espa_internal_meta_t *xml_metadata  /* I: pointer to metadata structure */
@@ -57,7 +106,8 @@ int create_netcdf_metadata
     Espa_internal_meta_t *xml_metadata, /* I: XML metadata structure */
     bool del_src,          /* I: should the source files be removed after
                                  conversion? */
-    bool no_compression    /* I: use compression for the NetCDF output file? */
+    bool no_compression,   /* I: use compression for the NetCDF output file? */
+    Netcdf_chunking_t *chunking  /* I: chunking of the band variables */
 );
 
 int convert_espa_to_netcdf
@@ -66,7 +116,8 @@ int convert_espa_to_netcdf
     char *netcdf_file,     /* I: output netCDF filename */
     bool del_src,          /* I: should the source files be removed after
                                  conversion? */
-    bool no_compression    /* I: use compression for the NetCDF output file? */
+    bool no_compression,   /* I: use compression for the NetCDF output file? */
+    Netcdf_chunking_t *chunking  /* I: chunking of the band variables */
 );
 
 #endif
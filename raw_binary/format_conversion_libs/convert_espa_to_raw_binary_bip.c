@@ -1,8 +1,10 @@
 /*****************************************************************************
 FILE: convert_espa_to_raw_binary_bip.c
   
-PURPOSE: Contains functions for creating the raw binary band interleave by
-pixel (BIP) product and adding bands for this product to the output XML file.
+PURPOSE: Contains functions for creating a single multi-band raw binary
+product, with the bands in the band sequential (BSQ), band interleave by line
+(BIL), band interleave by pixel (BIP), or tiled BIP layout, and adding bands
+for this product to the output XML file.
 
 PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
 at the USGS EROS
@@ -14,114 +16,394 @@ NOTES:
      metadata format found in ESPA Raw Binary Format v1.0.doc.  The schema for
      the ESPA internal metadata format is available at
      http://espa.cr.usgs.gov/schema/espa_internal_metadata_v1_0.xsd.
+  2. Every layout streams blocks of lines from the band stack.  Each layout
+     only supplies the function which arranges a block of lines of the bands
+     into the output file, so a new layout is one more entry in the layout
+     table.
 *****************************************************************************/
 #include <unistd.h>
 #include "convert_espa_to_raw_binary_bip.h"
+#include "espa_trace.h"
+
+/* State of the conversion handed to the block writer of the layout */
+typedef struct
+{
+    Raw_binary_writer_t *writer; /* coalescing writer for the output file */
+    int nbands;          /* number of bands in the current pass */
+    int nbytes;          /* number of bytes per value */
+    int tile_size;       /* number of lines and samples per tile */
+    void **band_block;   /* current block of each band in the pass */
+    void **tile_band;    /* first value of the current tile line for each
+                            band in the pass */
+    void *out_buf;       /* arranged output for the current block */
+} Interleave_state_t;
+
+/* Layout of the bands in the output file */
+typedef struct
+{
+    Espa_interleave_t layout;  /* layout of the bands */
+    char *name;                /* name of the layout, also used for the
+                                  output XML filename */
+    char *envi_interleave;     /* ENVI interleave of the output file */
+    bool band_passes;          /* is each band streamed in its own pass,
+                                  rather than all the bands at once? */
+    bool tiled;                /* is the file written as tiles of
+                                  tile_size lines and samples? */
+    int (*write_block) (Interleave_state_t *state, Espa_band_block_t *block);
+                               /* writes a block of lines of the bands */
+} Interleave_layout_t;
+
+static int write_bsq_block (Interleave_state_t *state,
+    Espa_band_block_t *block);
+static int write_bil_block (Interleave_state_t *state,
+    Espa_band_block_t *block);
+static int write_bip_block (Interleave_state_t *state,
+    Espa_band_block_t *block);
+static int write_tiled_bip_block (Interleave_state_t *state,
+    Espa_band_block_t *block);
+
+static Interleave_layout_t interleave_layouts[] =
+{
+    {ESPA_BSQ_INTERLEAVE, "bsq", "BSQ", true, false, write_bsq_block},
+    {ESPA_BIL_INTERLEAVE, "bil", "BIL", false, false, write_bil_block},
+    {ESPA_BIP_INTERLEAVE, "bip", "BIP", false, false, write_bip_block},
+    {ESPA_TILED_BIP_INTERLEAVE, "tiled_bip", "BIP", false, true,
+        write_tiled_bip_block}
+};
+
+#define NUM_INTERLEAVE_LAYOUTS \
+    (sizeof (interleave_layouts) / sizeof (interleave_layouts[0]))
+
+/* Conversion of the bands to a single raw binary file, fed a block of lines
+   at a time */
+struct Espa_interleave_writer
+{
+    Espa_internal_meta_t *xml_metadata; /* metadata of the input bands */
+    Interleave_layout_t *lay;  /* layout of the output file */
+    char *out_file;            /* output raw binary filename */
+    int tile_size;             /* number of lines and samples per tile */
+    int ntiles_across;         /* number of tiles across the image */
+    int ntiles_down;           /* number of tiles down the image */
+    int npasses;               /* number of passes through the bands */
+    int block_lines;           /* most lines per block */
+    size_t block_vals;         /* number of values per band in a full block
+                                  of lines */
+    void *file_buf;            /* input buffer, used for the QA bands which
+                                  need conversion */
+    Espa_pixel_convert_t *convert; /* kernel converting each QA band to the
+                                  output data type; NULL for the bands used
+                                  directly */
+    Interleave_state_t state;  /* state handed to the block writer */
+};
+
+
 
 /******************************************************************************
-MODULE:  convert_espa_to_raw_binary_bip
+MODULE:  write_bsq_block
 
-PURPOSE: Converts the internal ESPA raw binary file to a raw binary band
-interleave by pixel format.
+PURPOSE: Writes a block of lines of the single band in the current pass, as
+band sequential output is each band in turn.
 
 RETURN VALUE:
 Type = int
 Value           Description
 -----           -----------
-ERROR           Error converting to BIP
-SUCCESS         Successfully converted to BIP
+ERROR           Error writing the block
+SUCCESS         Successfully wrote the block
+******************************************************************************/
+static int write_bsq_block
+(
+    Interleave_state_t *state,  /* I: state of the conversion */
+    Espa_band_block_t *block    /* I: block of lines to be written */
+)
+{
+    return append_raw_binary_writer (state->writer, block->nlines,
+        block->line_stride, state->nbytes, state->band_block[0]);
+}
+
+
+/******************************************************************************
+MODULE:  write_bil_block
+
+PURPOSE: Writes a block of lines with each line of every band in turn before
+the next line.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the block
+SUCCESS         Successfully wrote the block
+******************************************************************************/
+static int write_bil_block
+(
+    Interleave_state_t *state,  /* I: state of the conversion */
+    Espa_band_block_t *block    /* I: block of lines to be written */
+)
+{
+    int i;               /* looping variable for the bands */
+    int l;               /* looping variable for the lines */
+    size_t line_bytes = (size_t) block->line_stride * state->nbytes;
+                         /* number of bytes in a line of one band */
+
+    for (l = 0; l < block->nlines; l++)
+        for (i = 0; i < state->nbands; i++)
+            memcpy ((char *) state->out_buf +
+                ((size_t) l * state->nbands + i) * line_bytes,
+                (char *) state->band_block[i] + l * line_bytes, line_bytes);
+
+    return append_raw_binary_writer (state->writer, block->nlines,
+        block->line_stride * state->nbands, state->nbytes, state->out_buf);
+}
+
+
+/******************************************************************************
+MODULE:  write_bip_block
+
+PURPOSE: Writes a block of lines with the values of every band together for
+each pixel.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error interleaving or writing the block
+SUCCESS         Successfully wrote the block
+******************************************************************************/
+static int write_bip_block
+(
+    Interleave_state_t *state,  /* I: state of the conversion */
+    Espa_band_block_t *block    /* I: block of lines to be written */
+)
+{
+    if (interleave_raw_binary_bands (state->band_block, state->nbands,
+        (size_t) block->nlines * block->line_stride, state->nbytes,
+        state->out_buf) != SUCCESS)
+        return (ERROR);
+
+    return append_raw_binary_writer (state->writer, block->nlines,
+        block->line_stride * state->nbands, state->nbytes, state->out_buf);
+}
+
+
+/******************************************************************************
+MODULE:  write_tiled_bip_block
+
+PURPOSE: Writes a row of tiles, each tile holding tile_size lines of
+tile_size pixels with the values of every band together for each pixel.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error interleaving or writing the row of tiles
+SUCCESS         Successfully wrote the row of tiles
 
 NOTES:
-  1. The bands in the XML file will be written, in order, to the BIP file.
-     These bands must be of the same datatype and same size, otherwise this
-     function will exit with an error.
-  2. If the data types are not the same, the convert_qa flag will allow the
-     user to specify that the QA bands (uint8) should be included in the output
-     BIP product however the QA bands will be converted to the same data type
-     as the first band in the XML file.
+  1. The block holds the tile_size lines of the row of tiles, or fewer for
+     the last row.  The tiles past the right and bottom edges of the image
+     are padded with zeros, so every tile is the same size and tile t of the
+     file starts at t * tile_size * tile_size * nbands values.
 ******************************************************************************/
-int convert_espa_to_raw_binary_bip
+static int write_tiled_bip_block
 (
-    char *espa_xml_file,   /* I: input ESPA XML metadata filename */
-    char *bip_file,        /* I: output BIP filename */
-    bool convert_qa,       /* I: should the QA bands (uint8) be converted to
+    Interleave_state_t *state,  /* I: state of the conversion */
+    Espa_band_block_t *block    /* I: block of lines to be written */
+)
+{
+    int i;               /* looping variable for the bands */
+    int l;               /* looping variable for the lines of the tile */
+    int t;               /* looping variable for the tiles across */
+    int ntiles;          /* number of tiles across the image */
+    int width;           /* number of image samples in the current tile */
+    size_t pix_bytes;    /* number of bytes per output pixel */
+    size_t tile_bytes;   /* number of bytes per output tile */
+    char *tile;          /* first byte of the current output tile */
+
+    ntiles = (block->nsamps + state->tile_size - 1) / state->tile_size;
+    pix_bytes = (size_t) state->nbands * state->nbytes;
+    tile_bytes = (size_t) state->tile_size * state->tile_size * pix_bytes;
+
+    for (t = 0; t < ntiles; t++)
+    {
+        tile = (char *) state->out_buf + t * tile_bytes;
+        width = block->nsamps - t * state->tile_size;
+        if (width > state->tile_size)
+            width = state->tile_size;
+
+        for (l = 0; l < block->nlines; l++)
+        {
+            for (i = 0; i < state->nbands; i++)
+                state->tile_band[i] = (char *) state->band_block[i] +
+                    ((size_t) l * block->line_stride + t * state->tile_size) *
+                    state->nbytes;
+
+            if (interleave_raw_binary_bands (state->tile_band, state->nbands,
+                width, state->nbytes, tile + l * state->tile_size * pix_bytes)
+                != SUCCESS)
+                return (ERROR);
+
+            /* Pad the samples past the right edge of the image */
+            if (width < state->tile_size)
+                memset (tile + (l * state->tile_size + width) * pix_bytes, 0,
+                    (state->tile_size - width) * pix_bytes);
+        }
+
+        /* Pad the lines past the bottom edge of the image */
+        if (block->nlines < state->tile_size)
+            memset (tile + block->nlines * state->tile_size * pix_bytes, 0,
+                (state->tile_size - block->nlines) * state->tile_size *
+                pix_bytes);
+    }
+
+    return append_raw_binary_writer (state->writer, ntiles * state->tile_size,
+        state->tile_size * state->nbands, state->nbytes, state->out_buf);
+}
+
+
+/******************************************************************************
+MODULE:  parse_espa_interleave
+
+PURPOSE: Converts the name of a layout to the layout of the bands.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Unknown layout
+SUCCESS         Successfully converted the name
+******************************************************************************/
+int parse_espa_interleave
+(
+    char *name,                /* I: name of the layout (bsq, bil, bip, or
+                                     tiled_bip) */
+    Espa_interleave_t *layout  /* O: layout of the bands */
+)
+{
+    char FUNC_NAME[] = "parse_espa_interleave"; /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    int i;                      /* looping variable for the layouts */
+
+    for (i = 0; i < NUM_INTERLEAVE_LAYOUTS; i++)
+    {
+        if (!strcmp (name, interleave_layouts[i].name))
+        {
+            *layout = interleave_layouts[i].layout;
+            return (SUCCESS);
+        }
+    }
+
+    snprintf (errmsg, sizeof (errmsg), "Unknown interleave %s.  Valid "
+        "interleaves are bsq, bil, bip, and tiled_bip.", name);
+    error_handler (true, FUNC_NAME, errmsg);
+    return (ERROR);
+}
+
+
+/******************************************************************************
+MODULE:  free_espa_interleave
+
+PURPOSE: Frees the buffers of a conversion to one raw binary file, and the
+conversion.
+
+RETURN VALUE:
+Type = None
+******************************************************************************/
+static void free_espa_interleave
+(
+    Espa_interleave_writer_t *conv  /* I: conversion to be freed */
+)
+{
+    free (conv->state.band_block);
+    free (conv->state.tile_band);
+    free (conv->convert);
+    if (conv->state.out_buf != NULL)
+        espa_buffer_put (conv->state.out_buf);
+    if (conv->file_buf != NULL)
+        espa_buffer_put (conv->file_buf);
+    free (conv->out_file);
+    free (conv);
+}
+
+
+/******************************************************************************
+MODULE:  open_espa_interleave
+
+PURPOSE: Starts converting the internal ESPA raw binary bands described by
+the metadata to a single raw binary file with the bands in the specified
+layout, for the blocks of lines handed to write_espa_interleave_block by a
+traversal of the bands.
+
+RETURN VALUE:
+Type = Espa_interleave_writer_t *
+Value           Description
+-----           -----------
+NULL            Error starting the conversion
+non-NULL        Conversion of the bands
+
+NOTES:
+  1. All the bands must have the same data type and size, other than the QA
+     bands which are converted when convert_qa is set.
+  2. The blocks may hold up to block_lines lines.  The tiled BIP layout
+     always takes blocks of tile_size lines (see get_espa_interleave_lines).
+******************************************************************************/
+Espa_interleave_writer_t *open_espa_interleave
+(
+    Espa_internal_meta_t *xml_metadata, /* I: metadata of the input ESPA
+                                 bands */
+    char *out_file,        /* I: output raw binary filename */
+    Espa_interleave_t layout, /* I: layout of the bands in out_file */
+    int tile_size,         /* I: number of lines and samples in each tile;
+                                 only used for the tiled BIP layout */
+    int block_lines,       /* I: most lines in a block; use
+                                 RB_PREFETCH_DEFAULT_LINES if not known */
+    bool convert_qa        /* I: should the QA bands (uint8) be converted to
                                  the data type of band 1 (if QA bands are of
                                  a different data type)? */
-    bool del_src           /* I: should the source files be removed after
-                                 conversion? */
 )
 {
-    char FUNC_NAME[] = "convert_espa_to_raw_binary_bip";  /* function name */
+    char FUNC_NAME[] = "open_espa_interleave";  /* function name */
     char errmsg[STR_SIZE];      /* error message */
-    char hdr_file[STR_SIZE];    /* name of the header file for this band */
-    char xml_file[STR_SIZE];    /* new XML file for the BIP product */
-    char envi_file[STR_SIZE];   /* name of the output ENVI header file */
-    char *cptr = NULL;          /* pointer to empty space in the band name */
     int i;                      /* looping variable for each band */
-    int l;                      /* looping variable for each line */
-    int s;                      /* looping variable for each sample */
     int nbytes;                 /* number of bytes per pixel in the data type */
-    int nbytes_line;            /* number of bytes per line in the data type */
-    int count;                  /* number of chars copied in snprintf */
-    int curr_pix;               /* index for current pixel for QA conversion */
-    int curr_ipix;              /* index for current input pixel */
-    int curr_opix;              /* index for current output pixel */
-    int number_elements;        /* number of elements per line for all bands */
-    void *file_buf = NULL;      /* pointer to correct input file buffer */
-    uint8 *tmp_buf_u8 = NULL;   /* buffer for uint8 QA data to be read */
-    uint8 *file_buf_u8 = NULL;  /* buffer for uint8 data to be read */
-    int16 *file_buf_i16 = NULL; /* buffer for int16 data to be read */
-    uint16 *file_buf_u16 = NULL;/* buffer for uint16 data to be read */
-    void *ofile_buf = NULL;     /* pointer to correct output file buffer */
-    uint8 *ofile_buf_u8 = NULL; /* buffer for output uint8 data to be written */
-    int16 *ofile_buf_i16 = NULL;/* buffer for output int16 data to be written */
-    uint16 *ofile_buf_u16 = NULL;/* buffer for output uint16 data to be
-                                    written */
-    FILE **fp_rb = NULL;        /* array of file pointers for the input raw
-                                   binary files */
-    FILE *fp_bip = NULL;        /* file pointer for the BIP raw binary file */
-    Espa_internal_meta_t xml_metadata;  /* XML metadata structure to be
-                                   populated by reading the input XML metadata
-                                   file */
+    size_t out_vals;            /* number of output values per band in a
+                                   full block of lines */
+    size_t file_bytes;          /* number of bytes in the output file */
     Espa_band_meta_t *bmeta=NULL; /* pointer to the array of bands metadata */
-    Espa_global_meta_t *gmeta=NULL; /* pointer to the global metadata
-                                   structure */
-    Envi_header_t envi_hdr;     /* output ENVI header information */
+    Interleave_layout_t *lay = NULL; /* layout of the output file */
+    Espa_interleave_writer_t *conv = NULL;  /* conversion of the bands */
 
-    /* Validate the input metadata file */
-    if (validate_xml_file (espa_xml_file) != SUCCESS)
-    {  /* Error messages already written */
-        return (ERROR);
-    }
+    bmeta = xml_metadata->band;
 
-    /* Initialize the metadata structure */
-    init_metadata_struct (&xml_metadata);
-
-    /* Parse the metadata file into our internal metadata structure; also
-       allocates space as needed for various pointers in the global and band
-       metadata */
-    if (parse_metadata (espa_xml_file, &xml_metadata) != SUCCESS)
-    {  /* Error messages already written */
-        return (ERROR);
+    for (i = 0; i < NUM_INTERLEAVE_LAYOUTS; i++)
+        if (interleave_layouts[i].layout == layout)
+            lay = &interleave_layouts[i];
+    if (lay == NULL)
+    {
+        sprintf (errmsg, "Unknown interleave layout: %d", (int) layout);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (NULL);
     }
-    bmeta = xml_metadata.band;
-    gmeta = &xml_metadata.global;
-    printf ("convert_espa_to_raw_binary_bip processing %d bands ...\n",
-        xml_metadata.nbands);
-
-    /* Allocate file pointers for each band */
-    fp_rb = calloc (xml_metadata.nbands, sizeof (FILE *));
-    if (fp_rb == NULL)
+    if (lay->tiled && tile_size <= 0)
     {
-        sprintf (errmsg, "Allocating file pointers for all %d bands.",
-            xml_metadata.nbands);
+        sprintf (errmsg, "Tile size must be positive: %d", tile_size);
         error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
+        return (NULL);
+    }
+    if (xml_metadata->nbands > MAX_ENVI_BANDS)
+    {
+        sprintf (errmsg, "Only %d bands can be described in the ENVI header, "
+            "but there are %d bands", MAX_ENVI_BANDS, xml_metadata->nbands);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (NULL);
     }
 
+    printf ("convert_espa_to_raw_binary_%s processing %d bands ...\n",
+        lay->name, xml_metadata->nbands);
+
     /* Loop through the bands in the XML file and verify they are all of the
        same data type and the same size */
-    for (i = 1; i < xml_metadata.nbands; i++)
+    for (i = 1; i < xml_metadata->nbands; i++)
     {
         if (bmeta[i].data_type != bmeta[0].data_type)
         {
@@ -137,60 +419,36 @@ int convert_espa_to_raw_binary_bip
             {
                 sprintf (errmsg, "Data type for band %d (%s) in the XML file "
                     "does not match that of the first band.  All bands must "
-                    "have the same data type to be written to BIP raw binary. "
+                    "have the same data type to be written to %s raw binary. "
                     "Otherwise convert_qa can be specified to convert the QA "
-                    "bands (UINT8).", i+1, bmeta[i].name);
+                    "bands (UINT8).", i+1, bmeta[i].name,
+                    lay->envi_interleave);
                 error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
+                return (NULL);
             }
         }
         else if (bmeta[i].nlines != bmeta[0].nlines)
         {
             sprintf (errmsg, "Number of lines for band %d (%s) in the XML file "
                 "does not match that of the first band.  All bands must be of "
-                "the same image size to be written to BIP raw binary.", i+1,
-                bmeta[i].name);
+                "the same image size to be written to %s raw binary.", i+1,
+                bmeta[i].name, lay->envi_interleave);
             error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
+            return (NULL);
         }
         else if (bmeta[i].nsamps != bmeta[0].nsamps)
         {
             sprintf (errmsg, "Number of samples for band %d (%s) in the XML "
                 "file does not match that of the first band.  All bands must "
-                "be of the same image size to be written to BIP raw binary.",
-                i+1, bmeta[i].name);
+                "be of the same image size to be written to %s raw binary.",
+                i+1, bmeta[i].name, lay->envi_interleave);
             error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
-    }
-
-    /* Loop through the bands in the XML file and open each band file for
-       reading */
-    for (i = 0; i < xml_metadata.nbands; i++)
-    {
-        /* Open the file for this band of data to allow for reading */
-        fp_rb[i] = open_raw_binary (bmeta[i].file_name, "rb");
-        if (fp_rb[i] == NULL)
-        {
-            sprintf (errmsg, "Opening the input raw binary file: %s",
-                bmeta[i].file_name);
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
+            return (NULL);
         }
     }
 
-    /* Open the output BIP file to allow for writing */
-    fp_bip = open_raw_binary (bip_file, "wb");
-    if (fp_bip == NULL)
-    {
-        sprintf (errmsg, "Opening the output raw binary BIP file: %s",
-            bip_file);
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
-    }
-
-    /* Allocate memory for a single line of the image and all the bands, based
-       on the input data type of the first band */
+    /* Determine the size of the output values, based on the input data type
+       of the first band */
     switch (bmeta[0].data_type)
     {
         case ESPA_UINT8:
@@ -206,175 +464,316 @@ int convert_espa_to_raw_binary_bip
             sprintf (errmsg, "Unsupported data type.  Currently only uint8, "
                 "int16, and uint16 are supported.");
             error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
+            return (NULL);
     }
 
-    /* Input data */
-    file_buf = calloc (bmeta[0].nsamps * xml_metadata.nbands, nbytes);
-    if (file_buf == NULL)
+    conv = calloc (1, sizeof (Espa_interleave_writer_t));
+    if (conv == NULL || (conv->out_file = strdup (out_file)) == NULL)
     {
-        sprintf (errmsg, "Allocating memory for a line of %d-byte data "
-            "containing %d samples for all %d bands.", nbytes, bmeta[0].nsamps,
-            xml_metadata.nbands);
+        sprintf (errmsg, "Allocating the conversion to %s", out_file);
         error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
+        free (conv);
+        return (NULL);
     }
+    conv->xml_metadata = xml_metadata;
+    conv->lay = lay;
 
-    /* Output data */
-    ofile_buf = calloc (bmeta[0].nsamps * xml_metadata.nbands, nbytes);
-    if (ofile_buf == NULL)
+    /* Pick the kernel converting each QA band, so the conversion is chosen
+       once per band rather than for every block */
+    conv->convert = calloc (xml_metadata->nbands,
+        sizeof (Espa_pixel_convert_t));
+    if (conv->convert == NULL)
     {
-        sprintf (errmsg, "Allocating memory for a line of %d-byte data "
-            "containing %d samples for all %d bands.", nbytes, bmeta[0].nsamps,
-            xml_metadata.nbands);
+        sprintf (errmsg, "Allocating the conversion kernels for all %d "
+            "bands.", xml_metadata->nbands);
         error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
+        free_espa_interleave (conv);
+        return (NULL);
+    }
+    for (i = 1; i < xml_metadata->nbands; i++)
+    {
+        if (bmeta[i].data_type != bmeta[0].data_type)
+            conv->convert[i] = espa_pixel_converter (bmeta[i].data_type,
+                bmeta[0].data_type);
     }
 
-    /* Assign the datatype-specific pointer to the void pointer to be used
-       in the data conversion later for QA pixels */
-    switch (bmeta[0].data_type)
+    /* Layouts with a pass per band stream one band at a time, the others
+       stream all the bands at once.  The tiled layout streams a row of tiles
+       at a time. */
+    conv->state.nbands = lay->band_passes ? 1 : xml_metadata->nbands;
+    conv->npasses = lay->band_passes ? xml_metadata->nbands : 1;
+    conv->state.nbytes = nbytes;
+    conv->state.tile_size = tile_size;
+    conv->tile_size = tile_size;
+    conv->block_lines = block_lines > 0 ? block_lines :
+        RB_PREFETCH_DEFAULT_LINES;
+    conv->block_vals = (size_t) conv->block_lines * bmeta[0].nsamps;
+    out_vals = conv->block_vals;
+    file_bytes = (size_t) bmeta[0].nlines * bmeta[0].nsamps *
+        xml_metadata->nbands * nbytes;
+    if (lay->tiled)
     {
-        case ESPA_UINT8:
-            file_buf_u8 = file_buf;
-            ofile_buf_u8 = ofile_buf;
-            break;
-        case ESPA_INT16:
-            file_buf_i16 = file_buf;
-            ofile_buf_i16 = ofile_buf;
-            break;
-        case ESPA_UINT16:
-            file_buf_u16 = file_buf;
-            ofile_buf_u16 = ofile_buf;
-            break;
-        default:
-            sprintf (errmsg, "Unsupported data type.  Currently only uint8, "
-                "int16, and uint16 are supported.");
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
+        conv->ntiles_across = (bmeta[0].nsamps + tile_size - 1) / tile_size;
+        conv->ntiles_down = (bmeta[0].nlines + tile_size - 1) / tile_size;
+        conv->block_lines = tile_size;
+        conv->block_vals = (size_t) conv->block_lines * bmeta[0].nsamps;
+        out_vals = (size_t) conv->ntiles_across * tile_size * tile_size;
+        file_bytes = (size_t) conv->ntiles_down * out_vals *
+            xml_metadata->nbands * nbytes;
     }
 
-    /* The QA bands will be converted so allocate space for a temporary UINT8
-       input array */
-    if (convert_qa)
+    /* Allocate the block pointers for each band in the pass */
+    conv->state.band_block = calloc (conv->state.nbands, sizeof (void *));
+    conv->state.tile_band = calloc (conv->state.nbands, sizeof (void *));
+    if (conv->state.band_block == NULL || conv->state.tile_band == NULL)
     {
-        tmp_buf_u8 = calloc (bmeta[0].nsamps, sizeof (uint8));
-        if (tmp_buf_u8 == NULL)
-        {
-            sprintf (errmsg, "Allocating memory for a line of QA data "
-                "containing %d samples.", bmeta[0].nsamps);
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
+        sprintf (errmsg, "Allocating block pointers for all %d bands.",
+            conv->state.nbands);
+        error_handler (true, FUNC_NAME, errmsg);
+        free_espa_interleave (conv);
+        return (NULL);
     }
 
-    /* Loop through the lines in the input raw binary file.  Read each line
-       for each band, put into the output BIP buffer, and write to the output
-       file. */
-    nbytes_line = nbytes * bmeta[0].nsamps;
-    for (l = 0; l < bmeta[0].nlines; l++)
+    /* Input data, only used for the QA bands which are converted to the
+       output data type.  All other bands are used directly from the
+       blocks. */
+    conv->file_buf = espa_buffer_get_zeroed (conv->block_vals *
+        conv->state.nbands * nbytes);
+    if (conv->file_buf == NULL)
     {
-        if (l % 100 == 0)
-            printf ("Line %d\n", l);
+        sprintf (errmsg, "Allocating memory for a block of %d-byte data "
+            "containing %d lines of %d samples for all %d bands.", nbytes,
+            conv->block_lines, bmeta[0].nsamps, conv->state.nbands);
+        error_handler (true, FUNC_NAME, errmsg);
+        free_espa_interleave (conv);
+        return (NULL);
+    }
 
-        for (i = 0; i < xml_metadata.nbands; i++)
-        {
-            /* Check to make sure the current band data type is the same as 
-               the output data type, otherwise this is a QA band that will
-               get converted to the output data type */
-            if ((bmeta[0].data_type != bmeta[i].data_type) &&
-                (bmeta[i].data_type == ESPA_UINT8) && convert_qa)
-            {
-                /* Read the current line from the raw binary file into the
-                   temporary UINT8 buffer */
-                if (read_raw_binary (fp_rb[i], 1, bmeta[0].nsamps,
-                    sizeof (uint8), tmp_buf_u8) != SUCCESS)
-                {
-                    sprintf (errmsg, "Reading QA data from the raw binary "
-                        "file for line %d and band %d", l, i);
-                    error_handler (true, FUNC_NAME, errmsg);
-                    return (ERROR);
-                }
-
-                /* Convert the data and write it to the output buffer */
-                if (bmeta[0].data_type == ESPA_INT16)
-                {
-                    curr_pix = i * bmeta[0].nsamps;
-                    for (s = 0; s < bmeta[0].nsamps; s++, curr_pix++)
-                        file_buf_i16[curr_pix] = (int16) tmp_buf_u8[s];
-                }
-                else if (bmeta[0].data_type == ESPA_UINT16)
-                {
-                    curr_pix = i * bmeta[0].nsamps;
-                    for (s = 0; s < bmeta[0].nsamps; s++, curr_pix++)
-                        file_buf_u16[curr_pix] = (uint16) tmp_buf_u8[s];
-                }
-            }
-            else
-            {
-                /* Read the current line from the raw binary file */
-                if (read_raw_binary (fp_rb[i], 1, bmeta[0].nsamps, nbytes,
-                    file_buf + (i*nbytes_line)) != SUCCESS)
-                {
-                    sprintf (errmsg, "Reading image data from the raw binary "
-                        "file for line %d and band %d", l, i);
-                    error_handler (true, FUNC_NAME, errmsg);
-                    return (ERROR);
-                }
-            }
-        }  /* end for i */
+    /* Output data */
+    conv->state.out_buf = espa_buffer_get_zeroed (out_vals *
+        conv->state.nbands * nbytes);
+    if (conv->state.out_buf == NULL)
+    {
+        sprintf (errmsg, "Allocating memory for a block of %d-byte data "
+            "containing %d lines of %d samples for all %d bands.", nbytes,
+            conv->block_lines, bmeta[0].nsamps, conv->state.nbands);
+        error_handler (true, FUNC_NAME, errmsg);
+        free_espa_interleave (conv);
+        return (NULL);
+    }
+
+    /* Open the output file for writing.  The lines are gathered into large
+       writes and the full size of the file is preallocated. */
+    conv->state.writer = open_raw_binary_writer (out_file, file_bytes, 0);
+    if (conv->state.writer == NULL)
+    {
+        sprintf (errmsg, "Opening the output raw binary %s file: %s",
+            lay->envi_interleave, out_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        free_espa_interleave (conv);
+        return (NULL);
+    }
+
+    return (conv);
+}
+
+
+/******************************************************************************
+MODULE:  get_espa_interleave_lines
+
+PURPOSE: Gets the most lines in a block handed to write_espa_interleave_block.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+n               Number of lines per block; the tiled BIP layout needs every
+                block but the last to be this many lines
+******************************************************************************/
+int get_espa_interleave_lines
+(
+    Espa_interleave_writer_t *conv  /* I: conversion of the bands */
+)
+{
+    return conv->block_lines;
+}
+
+
+/******************************************************************************
+MODULE:  write_interleave_pass_block
+
+PURPOSE: Converts the QA bands of a block of lines of the bands in a pass,
+and hands the block to the layout to be arranged and written to the output
+file.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the block
+SUCCESS         Successfully wrote the block
+******************************************************************************/
+static int write_interleave_pass_block
+(
+    Espa_interleave_writer_t *conv, /* I: conversion of the bands */
+    int pass,                  /* I: pass through the bands */
+    Espa_band_block_t *block   /* I: block of lines of the bands in the
+                                     pass */
+)
+{
+    char FUNC_NAME[] = "write_interleave_pass_block";  /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    int i;                      /* looping variable for each band */
+    int l;                      /* looping variable for each line */
+    int band;                   /* index of the current band */
+    int status;                 /* return status of the block writer */
+    size_t nvals;               /* number of values per band in the current
+                                   block of lines */
+    Interleave_layout_t *lay = conv->lay;  /* layout of the output file */
+    Interleave_state_t *state = &conv->state;  /* state handed to the block
+                                   writer */
+    Espa_trace_span_t span;     /* timing of the current conversion or
+                                   write */
+
+    if (block->nlines > conv->block_lines)
+    {
+        sprintf (errmsg, "Lines %d-%d are more than the %d lines of a block",
+            block->line0, block->line0 + block->nlines - 1,
+            conv->block_lines);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
 
-        /* Loop through the samples and put each band for each pixel into the
-           output buffer */
-        for (s = 0; s < bmeta[0].nsamps; s++)
+    for (l = (block->line0 + 99) / 100 * 100;
+         l < block->line0 + block->nlines; l += 100)
+        printf ("Line %d\n", l);
+
+    nvals = (size_t) block->nlines * block->line_stride;
+    span = espa_trace_begin ("convert_block", lay->band_passes ?
+        conv->xml_metadata->band[pass].name : NULL);
+    for (i = 0; i < state->nbands; i++)
+    {
+        /* QA bands of a different data type are converted to the output
+           data type */
+        band = lay->band_passes ? pass : i;
+        if (conv->convert[band] != NULL)
         {
-            curr_opix = s * xml_metadata.nbands;
-            for (i = 0; i < xml_metadata.nbands; i++, curr_opix++)
-            {
-                curr_ipix = i * bmeta[0].nsamps + s;
-                if (bmeta[0].data_type == ESPA_UINT8)
-                {
-                    ofile_buf_u8[curr_opix] = file_buf_u8[curr_ipix];
-                }
-                else if (bmeta[0].data_type == ESPA_INT16)
-                {
-                    ofile_buf_i16[curr_opix] = file_buf_i16[curr_ipix];
-                }
-                else if (bmeta[0].data_type == ESPA_UINT16)
-                {
-                    ofile_buf_u16[curr_opix] = file_buf_u16[curr_ipix];
-                }
-            }
+            /* Convert the QA block into this band's portion of the input
+               buffer */
+            state->band_block[i] = (char *) conv->file_buf +
+                i * conv->block_vals * state->nbytes;
+            (*conv->convert[band]) (block->band_buf[i], nvals,
+                state->band_block[i]);
         }
-
-        /* Write the current line of data containing all the bands to the
-           output file */
-        number_elements = bmeta[0].nsamps * xml_metadata.nbands;
-        if (fwrite (ofile_buf, nbytes, number_elements, fp_bip) !=
-            number_elements)
+        else
         {
-            sprintf (errmsg, "Writing data to the BIP raw binary file for "
-                "line %d", l);
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
+            /* Use the block directly from the band stack */
+            state->band_block[i] = block->band_buf[i];
         }
-    }  /* end for l */
+    }  /* end for i */
+    espa_trace_end (&span);
 
-    /* Close the raw binary files */
-    for (i = 0; i < xml_metadata.nbands; i++)
-        close_raw_binary (fp_rb[i]);
-    close_raw_binary (fp_bip);
+    /* Arrange the block in the output layout and write it */
+    span = espa_trace_begin ("write_block", lay->band_passes ?
+        conv->xml_metadata->band[pass].name : NULL);
+    status = (*lay->write_block) (state, block);
+    espa_trace_end (&span);
+    if (status != SUCCESS)
+    {
+        sprintf (errmsg, "Writing data to the %s raw binary file for the "
+            "block of lines starting at line %d", lay->envi_interleave,
+            block->line0);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
 
-    /* Free the memory */
-    free (tmp_buf_u8);
-    free (file_buf_u8);
-    free (file_buf_i16);
-    free (file_buf_u16);
-    free (ofile_buf_u8);
-    free (ofile_buf_i16);
-    free (ofile_buf_u16);
-
-    /* Create the ENVI header file for this BIP product */
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  write_espa_interleave_block
+
+PURPOSE: Arranges a block of lines of all the bands in the output layout and
+writes it to the output file.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the block
+SUCCESS         Successfully wrote the block
+
+NOTES:
+  1. The block holds every band of the metadata, in order, as full width
+     lines.  The blocks are handed over in line order.
+  2. The BSQ layout is written a band at a time, so it can't take blocks of
+     all the bands; it is only written by
+     convert_espa_meta_to_raw_binary_interleave.
+******************************************************************************/
+int write_espa_interleave_block
+(
+    Espa_interleave_writer_t *conv, /* I: conversion of the bands */
+    Espa_band_block_t *block   /* I: block of lines of all the bands */
+)
+{
+    char FUNC_NAME[] = "write_espa_interleave_block";  /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+
+    if (conv->lay->band_passes)
+    {
+        sprintf (errmsg, "The %s layout is written a band at a time",
+            conv->lay->name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return write_interleave_pass_block (conv, 0, block);
+}
+
+
+/******************************************************************************
+MODULE:  finish_espa_interleave
+
+PURPOSE: Writes the ENVI header and the XML file of the output product, and
+removes the source files if specified.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error finishing the product
+SUCCESS         Successfully finished the product
+******************************************************************************/
+static int finish_espa_interleave
+(
+    Espa_interleave_writer_t *conv, /* I: conversion of the bands */
+    char *espa_xml_file,   /* I: input ESPA XML metadata filename, or NULL */
+    bool del_src           /* I: should the source files be removed after
+                                 conversion? */
+)
+{
+    char FUNC_NAME[] = "finish_espa_interleave";  /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    char hdr_file[STR_SIZE];    /* name of the header file for this band */
+    char xml_file[STR_SIZE];    /* new XML file for the output product */
+    char envi_file[STR_SIZE];   /* name of the output ENVI header file */
+    char *cptr = NULL;          /* pointer to empty space in the band name */
+    char *out_file = conv->out_file;  /* output raw binary filename */
+    int i;                      /* looping variable for each band */
+    int count;                  /* number of chars copied in snprintf */
+    int tile_size = conv->tile_size;  /* number of lines and samples in each
+                                   tile */
+    Espa_internal_meta_t *xml_metadata = conv->xml_metadata;  /* metadata of
+                                   the input bands */
+    Espa_band_meta_t *bmeta = xml_metadata->band;  /* array of band
+                                   metadata */
+    Espa_global_meta_t *gmeta = &xml_metadata->global;  /* global
+                                   metadata */
+    Interleave_layout_t *lay = conv->lay;  /* layout of the output file */
+    Envi_header_t envi_hdr;     /* output ENVI header information */
+
+    /* Create the ENVI header file for this product */
     if (create_envi_struct (&bmeta[0], gmeta, &envi_hdr) != SUCCESS)
     {
         sprintf (errmsg, "Creating the ENVI header structure for this file.");
@@ -383,11 +782,11 @@ int convert_espa_to_raw_binary_bip
     }
 
     /* Update the ENVI header (created by default for a single BSQ band) to
-       represent that this product is a multi-band, BIP file */
-    envi_hdr.nbands = xml_metadata.nbands;
+       represent that this product is a multi-band file in this layout */
+    envi_hdr.nbands = xml_metadata->nbands;
 
     count = snprintf (envi_hdr.interleave, sizeof (envi_hdr.interleave), "%s",
-        "BIP");
+        lay->envi_interleave);
     if (count < 0 || count >= sizeof (envi_hdr.interleave))
     {
         sprintf (errmsg, "Overflow of envi_hdr.interleave");
@@ -395,11 +794,31 @@ int convert_espa_to_raw_binary_bip
         return (ERROR);
     }
 
-    for (i = 0; i < xml_metadata.nbands; i++)
+    if (lay->tiled)
+    {
+        envi_hdr.nsamps = tile_size;
+        envi_hdr.nlines = conv->ntiles_across * conv->ntiles_down *
+            tile_size;
+        envi_hdr.map_info = false;
+        count = snprintf (envi_hdr.description,
+            sizeof (envi_hdr.description), "ESPA-generated tiled BIP file; "
+            "%d by %d tiles of %d lines by %d samples, in row order, from an "
+            "image of %d lines by %d samples, padded with zeros",
+            conv->ntiles_down, conv->ntiles_across, tile_size, tile_size,
+            bmeta[0].nlines, bmeta[0].nsamps);
+        if (count < 0 || count >= sizeof (envi_hdr.description))
+        {
+            sprintf (errmsg, "Overflow of envi_hdr.description");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+    }
+
+    for (i = 0; i < xml_metadata->nbands; i++)
     {
         count = snprintf (envi_hdr.band_names[i],
             sizeof (envi_hdr.band_names[i]), "%s", bmeta[i].name);
-        if (count < 0 || count >= sizeof (envi_hdr.band_names))
+        if (count < 0 || count >= sizeof (envi_hdr.band_names[i]))
         {
             sprintf (errmsg, "Overflow of envi_hdr.band_names");
             error_handler (true, FUNC_NAME, errmsg);
@@ -408,14 +827,17 @@ int convert_espa_to_raw_binary_bip
     }
 
     /* Write the ENVI header */
-    count = snprintf (envi_file, sizeof (envi_file), "%s", bip_file);
+    count = snprintf (envi_file, sizeof (envi_file), "%s", out_file);
     if (count < 0 || count >= sizeof (envi_file))
     {
         sprintf (errmsg, "Overflow of envi_file string");
         error_handler (true, FUNC_NAME, errmsg);
         return (ERROR);
     }
-    cptr = strchr (envi_file, '.');
+    /* Only the name of the file is searched, since the directories (or the
+       bucket of a URL) may have dots */
+    cptr = strrchr (envi_file, '/');
+    cptr = strchr (cptr != NULL ? cptr : envi_file, '.');
     if (cptr != NULL)
     {
         /* File extension found.  Replace it with the new extension */
@@ -438,21 +860,25 @@ int convert_espa_to_raw_binary_bip
     /* Remove the source files if specified */
     if (del_src)
     {
-        /* Remove the image and header files for each band */
-        for (i = 0; i < xml_metadata.nbands; i++)
+        /* Remove the image and header files for each band.  Constant bands
+           have none, and a stack of bands is removed with its last band. */
+        for (i = 0; i < xml_metadata->nbands; i++)
         {
-            printf ("  Removing %s\n", xml_metadata.band[i].file_name);
-            if (unlink (xml_metadata.band[i].file_name) != 0)
+            if (is_constant_band (&xml_metadata->band[i]) ||
+                is_shared_band_file (xml_metadata, i, true))
+                continue;
+            printf ("  Removing %s\n", xml_metadata->band[i].file_name);
+            if (unlink (xml_metadata->band[i].file_name) != 0)
             {
                 sprintf (errmsg, "Deleting source file: %s",
-                    xml_metadata.band[i].file_name);
+                    xml_metadata->band[i].file_name);
                 error_handler (true, FUNC_NAME, errmsg);
                 return (ERROR);
             }
 
             /* .hdr file */
             count = snprintf (hdr_file, sizeof (hdr_file), "%s",
-                xml_metadata.band[i].file_name);
+                xml_metadata->band[i].file_name);
             if (count < 0 || count >= sizeof (hdr_file))
             {
                 sprintf (errmsg, "Overflow of hdr_file string");
@@ -471,33 +897,38 @@ int convert_espa_to_raw_binary_bip
             }
         }
 
-        /* Remove the source XML */
-        printf ("  Removing %s\n", espa_xml_file);
-        if (unlink (espa_xml_file) != 0)
+        /* Remove the source XML, if there is one */
+        if (espa_xml_file != NULL)
         {
-            sprintf (errmsg, "Deleting source file: %s", espa_xml_file);
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
+            printf ("  Removing %s\n", espa_xml_file);
+            if (unlink (espa_xml_file) != 0)
+            {
+                sprintf (errmsg, "Deleting source file: %s", espa_xml_file);
+                error_handler (true, FUNC_NAME, errmsg);
+                return (ERROR);
+            }
         }
     }
 
     /* Use the input XML file structure for the output XML file since it's the
        same except for the band filenames.  Loop through the bands in the XML
-       file and change the filenames to be the single output BIP filename. */
-    for (i = 0; i < xml_metadata.nbands; i++)
+       file and change the filenames to be the single output filename. */
+    for (i = 0; i < xml_metadata->nbands; i++)
     {
         count = snprintf (bmeta[i].file_name, sizeof (bmeta[i].file_name), "%s",
-            bip_file);
+            out_file);
         if (count < 0 || count >= sizeof (bmeta[i].file_name))
         {
             sprintf (errmsg, "Overflow of bmeta.file_name string");
             error_handler (true, FUNC_NAME, errmsg);
             return (ERROR);
         }
+        bmeta[i].constant_value = ESPA_FLOAT_META_FILL;
     }
 
-    /* Create the XML file for the BIP product */
-    count = snprintf (xml_file, sizeof (xml_file), "%s", bip_file);
+    /* Create the XML file for the product, named for the layout (i.e.
+       _bip.xml for BIP) */
+    count = snprintf (xml_file, sizeof (xml_file), "%s", out_file);
     if (count < 0 || count >= sizeof (xml_file))
     {
         sprintf (errmsg, "Overflow of xml_file string");
@@ -509,27 +940,340 @@ int convert_espa_to_raw_binary_bip
     {
         /* File extension found.  Replace it with the new extension */
         *cptr = '\0';
-        strcpy (cptr, "_bip.xml");
     }
     else
+        cptr = xml_file + strlen (xml_file);
+    count = snprintf (cptr, sizeof (xml_file) - (cptr - xml_file), "_%s.xml",
+        lay->name);
+    if (count < 0 || count >= sizeof (xml_file) - (cptr - xml_file))
     {
-        /* No file extension found.  Just append the new extension */
-        strcat (xml_file, "_bip.xml");
+        sprintf (errmsg, "Overflow of xml_file string");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
     }
 
     /* Write the new XML file */
-    if (write_metadata (&xml_metadata, xml_file) != SUCCESS)
+    if (write_metadata (xml_metadata, xml_file) != SUCCESS)
     {
-        sprintf (errmsg, "Error writing updated XML for the GeoTIFF product: "
-            "%s", xml_file);
+        sprintf (errmsg, "Error writing updated XML for the %s product: "
+            "%s", lay->envi_interleave, xml_file);
         error_handler (true, FUNC_NAME, errmsg);
         return (ERROR);
     }
 
-    /* Free the metadata structure */
+    /* Successful finish */
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  close_espa_interleave
+
+PURPOSE: Finishes the conversion once all the blocks have been written,
+writing the ENVI header and the XML file of the output product, and frees
+the conversion.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error finishing the conversion
+SUCCESS         Successfully finished the conversion, or it was only closed
+
+NOTES:
+  1. The band filenames in the metadata are changed to the output filename,
+     to describe the output product.
+  2. espa_xml_file is only used for removing the source XML file when del_src
+     is set, and may be NULL if there is none.
+  3. The tiled BIP file is described in the ENVI header as an image
+     tile_size samples wide with the tiles stacked one after another, which
+     has no single map location, so the map info is left out and the tiling
+     is given in the description.
+  4. With finish false, as when the traversal failed, the output file is
+     only closed.
+******************************************************************************/
+int close_espa_interleave
+(
+    Espa_interleave_writer_t *conv, /* I: conversion of the bands; freed on
+                                 return */
+    bool finish,           /* I: were all the blocks written, so the product
+                                 is to be finished? */
+    char *espa_xml_file,   /* I: input ESPA XML metadata filename, or NULL */
+    bool del_src           /* I: should the source files be removed after
+                                 conversion? */
+)
+{
+    char FUNC_NAME[] = "close_espa_interleave";  /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    int status;                 /* return status */
+
+    if (conv == NULL)
+        return (SUCCESS);
+
+    /* Close the output file */
+    status = close_raw_binary_writer (conv->state.writer);
+    if (status != SUCCESS)
+    {
+        sprintf (errmsg, "Closing the %s raw binary file: %s",
+            conv->lay->envi_interleave, conv->out_file);
+        error_handler (true, FUNC_NAME, errmsg);
+    }
+    else if (finish)
+        status = finish_espa_interleave (conv, espa_xml_file, del_src);
+
+    /* Free the memory */
+    free_espa_interleave (conv);
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  convert_espa_meta_to_raw_binary_interleave
+
+PURPOSE: Converts the internal ESPA raw binary bands described by the metadata
+to a single raw binary file with the bands in the specified layout.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error converting the bands
+SUCCESS         Successfully converted the bands
+
+NOTES:
+  1. See convert_espa_to_raw_binary_interleave.  The metadata is used as is,
+     so a caller which already holds it doesn't need to write and parse the
+     XML file again.
+  2. The band filenames in xml_metadata are changed to the output filename,
+     to describe the output product.
+  3. espa_xml_file is only used for removing the source XML file when del_src
+     is set, and may be NULL if there is none.
+  4. The bands are traversed by the band stack and each block is handed to
+     the conversion (see open_espa_interleave), in a pass per band for the
+     BSQ layout.  A caller with other steps to run on the same blocks (ex.
+     process_level1) drives the conversion itself.
+******************************************************************************/
+int convert_espa_meta_to_raw_binary_interleave
+(
+    Espa_internal_meta_t *xml_metadata, /* I/O: metadata of the input ESPA
+                                 bands */
+    char *espa_xml_file,   /* I: input ESPA XML metadata filename, or NULL */
+    char *out_file,        /* I: output raw binary filename */
+    Espa_interleave_t layout, /* I: layout of the bands in out_file */
+    int tile_size,         /* I: number of lines and samples in each tile;
+                                 only used for the tiled BIP layout */
+    bool convert_qa,       /* I: should the QA bands (uint8) be converted to
+                                 the data type of band 1 (if QA bands are of
+                                 a different data type)? */
+    bool del_src           /* I: should the source files be removed after
+                                 conversion? */
+)
+{
+    char FUNC_NAME[] = "convert_espa_meta_to_raw_binary_interleave";
+                                /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    int pass;                   /* looping variable for the passes */
+    int pass_index;             /* index of the band streamed in this pass,
+                                   for layouts with a pass per band */
+    int status = SUCCESS;       /* return status */
+    Espa_band_stack_t *stack = NULL; /* band stack which reads ahead the
+                                   lines of the input bands of the pass */
+    Espa_band_block_t *block = NULL; /* current block of lines */
+    Espa_band_meta_t *bmeta = xml_metadata->band;  /* array of band
+                                   metadata */
+    Espa_interleave_writer_t *conv = NULL;  /* conversion of the bands */
+    Espa_trace_span_t pass_span;  /* timing of the current pass */
+
+    conv = open_espa_interleave (xml_metadata, out_file, layout, tile_size,
+        RB_PREFETCH_DEFAULT_LINES, convert_qa);
+    if (conv == NULL)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+
+    for (pass = 0; pass < conv->npasses && status == SUCCESS; pass++)
+    {
+        /* Set up the band stack for the bands in this pass, which reads
+           ahead blocks of lines for the bands.  The bands are used directly
+           from the blocks, so there is no need for a separate input copy of
+           each line. */
+        pass_index = pass;
+        pass_span = espa_trace_begin ("export_band", conv->lay->band_passes ?
+            bmeta[pass].name : NULL);
+        if (conv->lay->band_passes)
+        {
+            printf ("Band %s\n", bmeta[pass].name);
+            stack = open_band_stack (xml_metadata, 1, &pass_index,
+                conv->block_lines, 0);
+        }
+        else
+            stack = open_band_stack (xml_metadata, xml_metadata->nbands,
+                NULL, conv->block_lines, 0);
+        if (stack == NULL)
+        {
+            sprintf (errmsg, "Opening the band stack for the input raw "
+                "binary bands");
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+            break;
+        }
+
+        /* Loop through the blocks of lines in the input raw binary files.
+           Grab each block for each band and hand it to the layout to be
+           arranged and written to the output file. */
+        while (1)
+        {
+            if (get_band_stack_block (stack, &block) != SUCCESS)
+            {
+                sprintf (errmsg, "Reading the next block of lines");
+                error_handler (true, FUNC_NAME, errmsg);
+                status = ERROR;
+                break;
+            }
+            if (block == NULL)
+                break;
+
+            if (write_interleave_pass_block (conv, pass, block) != SUCCESS)
+            {  /* Error messages already written */
+                status = ERROR;
+                break;
+            }
+        }  /* end while */
+
+        close_band_stack (stack);
+        espa_trace_end (&pass_span);
+    }  /* end for pass */
+
+    /* Write the ENVI header and XML file of the product */
+    if (close_espa_interleave (conv, status == SUCCESS, espa_xml_file,
+        del_src) != SUCCESS)
+        status = ERROR;
+
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  convert_espa_to_raw_binary_interleave
+
+PURPOSE: Converts the internal ESPA raw binary file to a single raw binary
+file with the bands in the specified layout.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error converting the bands
+SUCCESS         Successfully converted the bands
+
+NOTES:
+  1. The bands in the XML file will be written, in order, to the output file.
+     These bands must be of the same datatype and same size, otherwise this
+     function will exit with an error.
+  2. If the data types are not the same, the convert_qa flag will allow the
+     user to specify that the QA bands (uint8) should be included in the output
+     product however the QA bands will be converted to the same data type
+     as the first band in the XML file.
+******************************************************************************/
+int convert_espa_to_raw_binary_interleave
+(
+    char *espa_xml_file,   /* I: input ESPA XML metadata filename */
+    char *out_file,        /* I: output raw binary filename */
+    Espa_interleave_t layout, /* I: layout of the bands in out_file */
+    int tile_size,         /* I: number of lines and samples in each tile;
+                                 only used for the tiled BIP layout */
+    bool convert_qa,       /* I: should the QA bands (uint8) be converted to
+                                 the data type of band 1 (if QA bands are of
+                                 a different data type)? */
+    bool del_src           /* I: should the source files be removed after
+                                 conversion? */
+)
+{
+    int status;                     /* return status of the conversion */
+    Espa_internal_meta_t xml_metadata;  /* XML metadata structure to be
+                                   populated by reading the input XML metadata
+                                   file */
+
+    /* Initialize the metadata structure */
+    init_metadata_struct (&xml_metadata);
+
+    /* Validate the metadata file and parse it into our internal metadata
+       structure, reading the file only once; also allocates space as needed
+       for various pointers in the global and band metadata */
+    if (validate_and_parse_metadata (espa_xml_file, &xml_metadata) != SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+
+    /* Convert the bands and free the metadata structure */
+    status = convert_espa_meta_to_raw_binary_interleave (&xml_metadata,
+        espa_xml_file, out_file, layout, tile_size, convert_qa, del_src);
     free_metadata (&xml_metadata);
+    return (status);
+}
 
-    /* Successful conversion */
-    return (SUCCESS);
+
+/******************************************************************************
+MODULE:  convert_espa_meta_to_raw_binary_bip
+
+PURPOSE: Converts the internal ESPA raw binary bands described by the metadata
+to a raw binary band interleave by pixel format.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error converting to BIP
+SUCCESS         Successfully converted to BIP
+
+NOTES:
+  1. See convert_espa_meta_to_raw_binary_interleave.
+******************************************************************************/
+int convert_espa_meta_to_raw_binary_bip
+(
+    Espa_internal_meta_t *xml_metadata, /* I/O: metadata of the input ESPA
+                                 bands */
+    char *espa_xml_file,   /* I: input ESPA XML metadata filename, or NULL */
+    char *bip_file,        /* I: output BIP filename */
+    bool convert_qa,       /* I: should the QA bands (uint8) be converted to
+                                 the data type of band 1 (if QA bands are of
+                                 a different data type)? */
+    bool del_src           /* I: should the source files be removed after
+                                 conversion? */
+)
+{
+    return convert_espa_meta_to_raw_binary_interleave (xml_metadata,
+        espa_xml_file, bip_file, ESPA_BIP_INTERLEAVE, 0, convert_qa, del_src);
 }
 
+
+/******************************************************************************
+MODULE:  convert_espa_to_raw_binary_bip
+
+PURPOSE: Converts the internal ESPA raw binary file to a raw binary band
+interleave by pixel format.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error converting to BIP
+SUCCESS         Successfully converted to BIP
+
+NOTES:
+  1. See convert_espa_to_raw_binary_interleave.
+******************************************************************************/
+int convert_espa_to_raw_binary_bip
+(
+    char *espa_xml_file,   /* I: input ESPA XML metadata filename */
+    char *bip_file,        /* I: output BIP filename */
+    bool convert_qa,       /* I: should the QA bands (uint8) be converted to
+                                 the data type of band 1 (if QA bands are of
+                                 a different data type)? */
+    bool del_src           /* I: should the source files be removed after
+                                 conversion? */
+)
+{
+    return convert_espa_to_raw_binary_interleave (espa_xml_file, bip_file,
+        ESPA_BIP_INTERLEAVE, 0, convert_qa, del_src);
+}
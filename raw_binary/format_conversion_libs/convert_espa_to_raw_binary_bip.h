@@ -2,7 +2,8 @@
 FILE: convert_espa_to_raw_binary_bip.h
   
 PURPOSE: Contains defines and prototypes to read the ESPA XML metadata file
-and imagery, and convert from raw binary to raw binary BIP file format.
+and imagery, and convert from raw binary to a single multi-band raw binary
+file in one of the BSQ, BIL, BIP, or tiled BIP layouts.
 
 PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
 at the USGS EROS
@@ -24,11 +25,119 @@ NOTES:
 #include "parse_metadata.h"
 #include "write_metadata.h"
 #include "raw_binary_io.h"
+#include "espa_band_stack.h"
+#include "espa_buffer_pool.h"
+#include "raw_binary_writer.h"
+#include "raw_binary_interleave.h"
+#include "espa_pixel_convert.h"
 #include "envi_header.h"
 
 /* Defines */
+/* Layouts of the bands in the output raw binary file */
+typedef enum {
+    ESPA_BSQ_INTERLEAVE,       /* band sequential; each band in turn */
+    ESPA_BIL_INTERLEAVE,       /* band interleaved by line */
+    ESPA_BIP_INTERLEAVE,       /* band interleaved by pixel */
+    ESPA_TILED_BIP_INTERLEAVE  /* square tiles of pixels in row order, each
+                                  tile band interleaved by pixel */
+} Espa_interleave_t;
+
+/* Default number of lines and samples in each tile of the tiled BIP
+   layout */
+#define DEFAULT_INTERLEAVE_TILE_SIZE 256
+
+/* Conversion of the bands to a single raw binary file, fed a block of lines
+   at a time */
+typedef struct Espa_interleave_writer Espa_interleave_writer_t;
 
 /* Prototypes */
+int parse_espa_interleave
+(
+    char *name,                /* I: name of the layout (bsq, bil, bip, or
+                                     tiled_bip) */
+    Espa_interleave_t *layout  /* O: layout of the bands */
+);
+
+Espa_interleave_writer_t *open_espa_interleave
+(
+    Espa_internal_meta_t *xml_metadata, /* I: metadata of the input ESPA
+                                 bands */
+    char *out_file,        /* I: output raw binary filename */
+    Espa_interleave_t layout, /* I: layout of the bands in out_file */
+    int tile_size,         /* I: number of lines and samples in each tile;
+                                 only used for the tiled BIP layout */
+    int block_lines,       /* I: most lines in a block; use
+                                 RB_PREFETCH_DEFAULT_LINES if not known */
+    bool convert_qa        /* I: should the QA bands (uint8) be converted to
+                                 the data type of band 1 (if QA bands are of
+                                 a different data type)? */
+);
+
+int get_espa_interleave_lines
+(
+    Espa_interleave_writer_t *conv  /* I: conversion of the bands */
+);
+
+int write_espa_interleave_block
+(
+    Espa_interleave_writer_t *conv, /* I: conversion of the bands */
+    Espa_band_block_t *block   /* I: block of lines of all the bands */
+);
+
+int close_espa_interleave
+(
+    Espa_interleave_writer_t *conv, /* I: conversion of the bands; freed on
+                                 return */
+    bool finish,           /* I: were all the blocks written, so the product
+                                 is to be finished? */
+    char *espa_xml_file,   /* I: input ESPA XML metadata filename, or NULL */
+    bool del_src           /* I: should the source files be removed after
+                                 conversion? */
+);
+
+int convert_espa_meta_to_raw_binary_interleave
+(
+    Espa_internal_meta_t *xml_metadata, /* I/O: metadata of the input ESPA
+                                 bands */
+    char *espa_xml_file,   /* I: input ESPA XML metadata filename, or NULL */
+    char *out_file,        /* I: output raw binary filename */
+    Espa_interleave_t layout, /* I: layout of the bands in out_file */
+    int tile_size,         /* I: number of lines and samples in each tile;
+                                 only used for the tiled BIP layout */
+    bool convert_qa,       /* I: should the QA bands (uint8) be converted to
+                                 the data type of band 1 (if QA bands are of
+                                 a different data type)? */
+    bool del_src           /* I: should the source files be removed after
+                                 conversion? */
+);
+
+int convert_espa_to_raw_binary_interleave
+(
+    char *espa_xml_file,   /* I: input ESPA XML metadata filename */
+    char *out_file,        /* I: output raw binary filename */
+    Espa_interleave_t layout, /* I: layout of the bands in out_file */
+    int tile_size,         /* I: number of lines and samples in each tile;
+                                 only used for the tiled BIP layout */
+    bool convert_qa,       /* I: should the QA bands (uint8) be converted to
+                                 the data type of band 1 (if QA bands are of
+                                 a different data type)? */
+    bool del_src           /* I: should the source files be removed after
+                                 conversion? */
+);
+
+int convert_espa_meta_to_raw_binary_bip
+(
+    Espa_internal_meta_t *xml_metadata, /* I/O: metadata of the input ESPA
+                                 bands */
+    char *espa_xml_file,   /* I: input ESPA XML metadata filename, or NULL */
+    char *bip_file,        /* I: output BIP filename */
+    bool convert_qa,       /* I: should the QA bands (uint8) be converted to
+                                 the data type of band 1 (if QA bands are of
+                                 a different data type)? */
+    bool del_src           /* I: should the source files be removed after
+                                 conversion? */
+);
+
 int convert_espa_to_raw_binary_bip
 (
     char *espa_xml_file,   /* I: input ESPA XML metadata filename */
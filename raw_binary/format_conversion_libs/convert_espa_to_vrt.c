@@ -0,0 +1,679 @@
+/*****************************************************************************
+FILE: convert_espa_to_vrt.c
+
+PURPOSE: Contains functions for writing a GDAL virtual raster (VRT) over the
+ESPA raw binary bands, so GDAL readers use the bands in place without any of
+the pixels being copied.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The XML metadata format read via this library follows the ESPA internal
+     metadata format found in ESPA Raw Binary Format v1.0.doc.  The schema for
+     the ESPA internal metadata format is available at
+     http://espa.cr.usgs.gov/schema/espa_internal_metadata_v1_0.xsd.
+  2. Each band is a VRTRawRasterBand reading its raw binary file (at its
+     offset in a stacked file; see espa_file_stack.h) as little endian BSQ.
+     The fill value, scale factor, add offset, and data units of the band
+     become its NoDataValue, Scale, Offset, and UnitType, and its name its
+     Description.
+  3. A VRT has a single grid, so the bands on other grids than the first
+     (see espa_band_grids.h) are written to a VRT per grid, named with the
+     grid appended to the name of the VRT (ex. out_20.vrt for out.vrt).
+  4. The constant bands, which have no file, and the encoded or tiled bands,
+     which GDAL can't read as raw binary, are left out with a warning.
+  5. The band files are named relative to the VRT when the VRT is written to
+     the directory of the XML file, so the product can be moved with its
+     VRT, and by their absolute paths otherwise.
+*****************************************************************************/
+
+#include <limits.h>
+#include <math.h>
+#include <strings.h>
+#include <libgen.h>
+#include "convert_espa_to_vrt.h"
+#include "espa_remote.h"
+#include "espa_shm.h"
+
+/* Size of the PROJ definition of the projection */
+#define VRT_SRS_SIZE 512
+
+
+/******************************************************************************
+MODULE:  vrt_data_type
+
+PURPOSE: Returns the GDAL data type of an ESPA data type.
+
+RETURN VALUE:
+Type = const char *
+Value           Description
+-----           -----------
+NULL            Data type not supported by GDAL
+type            Name of the GDAL data type
+******************************************************************************/
+static const char *vrt_data_type
+(
+    enum Espa_data_type data_type  /* I: ESPA data type */
+)
+{
+    switch (data_type)
+    {
+        case ESPA_INT8: return "Int8";
+        case ESPA_UINT8: return "Byte";
+        case ESPA_INT16: return "Int16";
+        case ESPA_UINT16: return "UInt16";
+        case ESPA_INT32: return "Int32";
+        case ESPA_UINT32: return "UInt32";
+        case ESPA_FLOAT32: return "Float32";
+        case ESPA_FLOAT64: return "Float64";
+    }
+
+    return NULL;
+}
+
+
+/******************************************************************************
+MODULE:  vrt_data_size
+
+PURPOSE: Returns the number of bytes in a pixel of an ESPA data type.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+n               Number of bytes per pixel
+******************************************************************************/
+static int vrt_data_size
+(
+    enum Espa_data_type data_type  /* I: ESPA data type */
+)
+{
+    switch (data_type)
+    {
+        case ESPA_INT8:
+        case ESPA_UINT8: return 1;
+        case ESPA_INT16:
+        case ESPA_UINT16: return 2;
+        case ESPA_INT32:
+        case ESPA_UINT32:
+        case ESPA_FLOAT32: return 4;
+        case ESPA_FLOAT64: return 8;
+    }
+
+    return 0;
+}
+
+
+/******************************************************************************
+MODULE:  vrt_text
+
+PURPOSE: Writes a string as XML text, escaping the markup characters.
+
+RETURN VALUE: None
+******************************************************************************/
+static void vrt_text
+(
+    FILE *fp,              /* I: VRT file */
+    const char *text       /* I: string to be written */
+)
+{
+    const char *c;         /* current character of text */
+
+    for (c = text; *c != '\0'; c++)
+    {
+        switch (*c)
+        {
+            case '&': fputs ("&amp;", fp); break;
+            case '<': fputs ("&lt;", fp); break;
+            case '>': fputs ("&gt;", fp); break;
+            case '"': fputs ("&quot;", fp); break;
+            default: fputc (*c, fp); break;
+        }
+    }
+}
+
+
+/******************************************************************************
+MODULE:  vrt_text_item
+
+PURPOSE: Writes a metadata item of a band, unless the string isn't defined
+in the metadata.
+
+RETURN VALUE: None
+******************************************************************************/
+static void vrt_text_item
+(
+    FILE *fp,              /* I: VRT file */
+    const char *key,       /* I: name of the metadata item */
+    const char *value      /* I: value of the item */
+)
+{
+    if (value[0] == '\0' || !strcmp (value, ESPA_STRING_META_FILL))
+        return;
+
+    fprintf (fp, "      <MDI key=\"%s\">", key);
+    vrt_text (fp, value);
+    fprintf (fp, "</MDI>\n");
+}
+
+
+/******************************************************************************
+MODULE:  vrt_datum
+
+PURPOSE: Returns the PROJ definition of the datum of the projection.
+
+RETURN VALUE:
+Type = const char *
+Value           Description
+-----           -----------
+NULL            Datum not supported
+datum           PROJ parameters of the datum
+******************************************************************************/
+static const char *vrt_datum
+(
+    int datum_type         /* I: datum type (see ESPA_* in gctp_defines.h) */
+)
+{
+    switch (datum_type)
+    {
+        case ESPA_WGS84: return "+datum=WGS84";
+        case ESPA_NAD83: return "+datum=NAD83";
+        case ESPA_NAD27: return "+datum=NAD27";
+    }
+
+    return NULL;
+}
+
+
+/******************************************************************************
+MODULE:  vrt_srs
+
+PURPOSE: Determines the PROJ definition of the projection of the product.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Projection or datum not supported
+SUCCESS         Successfully determined the projection
+
+NOTES:
+  1. The projections and datums are those supported by the GeoTIFF export
+     (see set_geotiff_tags).  The sinusoidal projection is on the sphere of
+     its radius, as for the MODIS products.
+******************************************************************************/
+static int vrt_srs
+(
+    const Espa_proj_meta_t *proj_info,  /* I: projection of the product */
+    char srs[VRT_SRS_SIZE]              /* O: PROJ definition */
+)
+{
+    char FUNC_NAME[] = "vrt_srs";  /* function name */
+    char errmsg[STR_SIZE];         /* error message */
+    const char *datum = vrt_datum (proj_info->datum_type);
+                                   /* PROJ parameters of the datum */
+
+    if (proj_info->proj_type != GCTP_SIN_PROJ && datum == NULL)
+    {
+        sprintf (errmsg, "Unsupported datum %d", proj_info->datum_type);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    switch (proj_info->proj_type)
+    {
+        case GCTP_GEO_PROJ:
+            snprintf (srs, VRT_SRS_SIZE, "+proj=longlat %s +no_defs", datum);
+            break;
+
+        case GCTP_UTM_PROJ:
+            snprintf (srs, VRT_SRS_SIZE, "+proj=utm +zone=%d%s %s +units=m "
+                "+no_defs", abs (proj_info->utm_zone),
+                proj_info->utm_zone < 0 ? " +south" : "", datum);
+            break;
+
+        case GCTP_ALBERS_PROJ:
+            snprintf (srs, VRT_SRS_SIZE, "+proj=aea +lat_1=%.15g "
+                "+lat_2=%.15g +lat_0=%.15g +lon_0=%.15g +x_0=%.15g "
+                "+y_0=%.15g %s +units=m +no_defs",
+                proj_info->standard_parallel1, proj_info->standard_parallel2,
+                proj_info->origin_latitude, proj_info->central_meridian,
+                proj_info->false_easting, proj_info->false_northing, datum);
+            break;
+
+        case GCTP_PS_PROJ:
+            snprintf (srs, VRT_SRS_SIZE, "+proj=stere +lat_0=%d "
+                "+lat_ts=%.15g +lon_0=%.15g +k=1 +x_0=%.15g +y_0=%.15g %s "
+                "+units=m +no_defs",
+                proj_info->latitude_true_scale < 0.0 ? -90 : 90,
+                proj_info->latitude_true_scale, proj_info->longitude_pole,
+                proj_info->false_easting, proj_info->false_northing, datum);
+            break;
+
+        case GCTP_SIN_PROJ:
+            snprintf (srs, VRT_SRS_SIZE, "+proj=sinu +lon_0=%.15g "
+                "+x_0=%.15g +y_0=%.15g +R=%.15g +units=m +no_defs",
+                proj_info->central_meridian, proj_info->false_easting,
+                proj_info->false_northing, proj_info->sphere_radius);
+            break;
+
+        default:
+            sprintf (errmsg, "Unsupported projection type %d.",
+                proj_info->proj_type);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  vrt_band_supported
+
+PURPOSE: Determines if a band can be read by GDAL as raw binary, warning
+about the bands which can't.
+
+RETURN VALUE:
+Type = bool
+Value           Description
+-----           -----------
+true            The band is a raw binary file GDAL can read in place
+false           The band is left out of the VRT
+
+NOTES:
+  1. Bands in shared memory (see espa_shm.h) are left out, since GDAL can't
+     open their shm: names and their segments are removed once the bands
+     are persisted.  Run espa_persist_bands before writing the VRT to keep
+     them.
+******************************************************************************/
+static bool vrt_band_supported
+(
+    const Espa_band_meta_t *bmeta  /* I: metadata of the band */
+)
+{
+    char FUNC_NAME[] = "vrt_band_supported";  /* function name */
+    char errmsg[STR_SIZE];         /* error message */
+
+    if (is_constant_band (bmeta))
+        snprintf (errmsg, sizeof (errmsg), "Band %s is a constant band with "
+            "no file, so it is left out of the VRT", bmeta->name);
+    else if (strcmp (bmeta->encoding, ESPA_STRING_META_FILL) ||
+        bmeta->tile_size > 0)
+        snprintf (errmsg, sizeof (errmsg), "Band %s is encoded or tiled, so "
+            "it is left out of the VRT", bmeta->name);
+    else if (is_espa_shm_name (bmeta->file_name))
+        snprintf (errmsg, sizeof (errmsg), "Band %s is in shared memory, so "
+            "it is left out of the VRT", bmeta->name);
+    else
+        return (true);
+
+    error_handler (false, FUNC_NAME, errmsg);
+    return (false);
+}
+
+
+/******************************************************************************
+MODULE:  vrt_source_dir
+
+PURPOSE: Determines how the VRT names the band files, relative to the VRT
+when it is in the directory of the XML file, otherwise by the absolute path
+of that directory.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error resolving the directories
+SUCCESS         Successfully determined the directory of the band files
+******************************************************************************/
+static int vrt_source_dir
+(
+    char *espa_xml_file,   /* I: input ESPA XML metadata filename */
+    char *vrt_file,        /* I: output VRT filename */
+    char source_dir[PATH_MAX],  /* O: directory of the band files, ending
+                                      with a '/'; empty when relative */
+    bool *relative         /* O: are the band files relative to the VRT? */
+)
+{
+    char FUNC_NAME[] = "vrt_source_dir";  /* function name */
+    char errmsg[STR_SIZE];         /* error message */
+    char path[PATH_MAX];           /* copy of a filename for dirname */
+    char vrt_dir[PATH_MAX];        /* absolute directory of the VRT */
+
+    snprintf (path, sizeof (path), "%s", espa_xml_file);
+    if (realpath (dirname (path), source_dir) == NULL)
+    {
+        snprintf (errmsg, sizeof (errmsg), "Resolving the directory of %s",
+            espa_xml_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    snprintf (path, sizeof (path), "%s", vrt_file);
+    if (realpath (dirname (path), vrt_dir) == NULL)
+    {
+        snprintf (errmsg, sizeof (errmsg), "Resolving the directory of %s",
+            vrt_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    *relative = !strcmp (source_dir, vrt_dir);
+    if (*relative)
+        source_dir[0] = '\0';
+    else if (strlen (source_dir) + 2 > PATH_MAX)
+    {
+        sprintf (errmsg, "Overflow of source_dir string");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    else if (strcmp (source_dir, "/"))
+        strcat (source_dir, "/");
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  write_vrt_band
+
+PURPOSE: Writes the VRTRawRasterBand of a band.
+
+RETURN VALUE: None
+******************************************************************************/
+static void write_vrt_band
+(
+    FILE *fp,              /* I: VRT file */
+    const Espa_band_meta_t *bmeta,  /* I: metadata of the band */
+    int band_num,          /* I: 1-based number of the band in the VRT */
+    const char *source_dir,  /* I: directory of the band files */
+    bool relative          /* I: are the band files relative to the VRT? */
+)
+{
+    int size = vrt_data_size (bmeta->data_type);  /* bytes per pixel */
+
+    fprintf (fp, "  <VRTRasterBand dataType=\"%s\" band=\"%d\" "
+        "subClass=\"VRTRawRasterBand\">\n", vrt_data_type (bmeta->data_type),
+        band_num);
+
+    fprintf (fp, "    <Description>");
+    vrt_text (fp, bmeta->name);
+    fprintf (fp, "</Description>\n");
+
+    fprintf (fp, "    <Metadata>\n");
+    vrt_text_item (fp, "long_name", bmeta->long_name);
+    vrt_text_item (fp, "product", bmeta->product);
+    vrt_text_item (fp, "source", bmeta->source);
+    vrt_text_item (fp, "category", bmeta->category);
+    fprintf (fp, "    </Metadata>\n");
+
+    if (bmeta->fill_value != ESPA_INT_META_FILL)
+        fprintf (fp, "    <NoDataValue>%ld</NoDataValue>\n",
+            bmeta->fill_value);
+    if (bmeta->data_units[0] != '\0' &&
+        strcmp (bmeta->data_units, ESPA_STRING_META_FILL))
+    {
+        fprintf (fp, "    <UnitType>");
+        vrt_text (fp, bmeta->data_units);
+        fprintf (fp, "</UnitType>\n");
+    }
+    if (fabs (bmeta->add_offset - ESPA_FLOAT_META_FILL) > ESPA_EPSILON)
+        fprintf (fp, "    <Offset>%.9g</Offset>\n", bmeta->add_offset);
+    if (fabs (bmeta->scale_factor - ESPA_FLOAT_META_FILL) > ESPA_EPSILON)
+        fprintf (fp, "    <Scale>%.9g</Scale>\n", bmeta->scale_factor);
+
+    fprintf (fp, "    <SourceFilename relativeToVRT=\"%d\">", relative);
+    vrt_text (fp, source_dir);
+    vrt_text (fp, bmeta->file_name);
+    fprintf (fp, "</SourceFilename>\n");
+    fprintf (fp, "    <ImageOffset>%ld</ImageOffset>\n", bmeta->file_offset);
+    fprintf (fp, "    <PixelOffset>%d</PixelOffset>\n", size);
+    fprintf (fp, "    <LineOffset>%ld</LineOffset>\n",
+        (long) bmeta->nsamps * size);
+    fprintf (fp, "    <ByteOrder>LSB</ByteOrder>\n");
+    fprintf (fp, "  </VRTRasterBand>\n");
+}
+
+
+/******************************************************************************
+MODULE:  write_vrt_grid
+
+PURPOSE: Writes the VRT of the bands of a grid.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the VRT
+SUCCESS         Successfully wrote the VRT
+******************************************************************************/
+static int write_vrt_grid
+(
+    char *vrt_file,        /* I: VRT filename of the grid */
+    Espa_internal_meta_t *xml_metadata, /* I: XML metadata structure */
+    const Espa_band_grids_t *grids,     /* I: grids of the bands */
+    int igrid,             /* I: 0-based grid */
+    const bool *supported, /* I: can GDAL read each band in place? */
+    const char *srs,       /* I: PROJ definition of the projection */
+    const char *source_dir,  /* I: directory of the band files */
+    bool relative          /* I: are the band files relative to the VRT? */
+)
+{
+    char FUNC_NAME[] = "write_vrt_grid";  /* function name */
+    char errmsg[STR_SIZE];         /* error message */
+    int i;                         /* looping variable for each band */
+    int band_num = 0;              /* number of bands written */
+    double ul_corner[2];           /* x, y of the UL edge of the grid */
+    double lr_corner[2];           /* x, y of the LR edge of the grid */
+    Espa_band_meta_t *gmeta = &xml_metadata->band[grids->grid_band[igrid]];
+                                   /* metadata of the first band of the
+                                      grid */
+    FILE *fp = NULL;               /* VRT file */
+
+    fp = fopen (vrt_file, "w");
+    if (fp == NULL)
+    {
+        snprintf (errmsg, sizeof (errmsg), "Opening the VRT file: %s",
+            vrt_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    get_espa_grid_extent (xml_metadata, grids->grid_band[igrid], ul_corner,
+        lr_corner);
+    fprintf (fp, "<VRTDataset rasterXSize=\"%d\" rasterYSize=\"%d\">\n",
+        gmeta->nsamps, gmeta->nlines);
+    fprintf (fp, "  <SRS>%s</SRS>\n", srs);
+    fprintf (fp, "  <GeoTransform>%.15g, %.15g, 0, %.15g, 0, %.15g"
+        "</GeoTransform>\n", ul_corner[0], gmeta->pixel_size[0],
+        ul_corner[1], -gmeta->pixel_size[1]);
+
+    for (i = 0; i < xml_metadata->nbands; i++)
+    {
+        if (grids->band_grid[i] != igrid || !supported[i])
+            continue;
+        write_vrt_band (fp, &xml_metadata->band[i], ++band_num, source_dir,
+            relative);
+    }
+
+    fprintf (fp, "</VRTDataset>\n");
+    if (ferror (fp) | fclose (fp))
+    {
+        snprintf (errmsg, sizeof (errmsg), "Writing the VRT file: %s",
+            vrt_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    printf ("VRT %s: %d bands\n", vrt_file, band_num);
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  convert_espa_to_vrt
+
+PURPOSE: Writes a GDAL VRT over the internal ESPA raw binary bands, with a
+VRTRawRasterBand per band, so GDAL reads the bands in place.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the VRT
+SUCCESS         Successfully wrote the VRT
+
+NOTES:
+  1. No pixels are read or written; the VRT refers to the band files, which
+     need to stay where they are.
+  2. The bands GDAL can't read in place are left out (see the notes at the
+     top of this file).  It is an error if that leaves no bands.
+  3. The XML file needs to be local, since the VRT names the band files by
+     their paths.
+******************************************************************************/
+int convert_espa_to_vrt
+(
+    char *espa_xml_file,   /* I: input ESPA XML metadata filename */
+    char *vrt_file         /* I: output VRT filename; the bands on other
+                                 grids than the first are written to VRTs
+                                 named with the grid appended */
+)
+{
+    char FUNC_NAME[] = "convert_espa_to_vrt";  /* function name */
+    char errmsg[STR_SIZE];         /* error message */
+    char srs[VRT_SRS_SIZE];        /* PROJ definition of the projection */
+    char source_dir[PATH_MAX];     /* directory of the band files */
+    char base[STR_SIZE];           /* VRT filename without the .vrt */
+    char grid_base[STR_SIZE];      /* base with the grid appended */
+    char grid_file[STR_SIZE];      /* VRT filename of a grid */
+    int i;                         /* looping variable for each band */
+    int g;                         /* looping variable for each grid */
+    int nvrt = 0;                  /* number of VRTs written */
+    int nsupported;                /* number of bands of a grid GDAL can
+                                      read in place */
+    int count;                     /* number of chars copied in snprintf */
+    size_t len;                    /* length of the VRT filename */
+    bool relative;                 /* are the band files relative to the
+                                      VRT? */
+    Espa_internal_meta_t xml_metadata;  /* XML metadata structure to be
+                                   populated by reading the input XML metadata
+                                   file */
+    Espa_band_grids_t grids = {0, NULL, NULL, NULL};  /* grids of the
+                                   bands */
+    bool *supported = NULL;        /* can GDAL read each band in place? */
+    int status = ERROR;            /* return status */
+
+    if (is_remote_file (espa_xml_file))
+    {
+        snprintf (errmsg, sizeof (errmsg), "The XML file needs to be local "
+            "to write a VRT over its bands: %s", espa_xml_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Initialize the metadata structure */
+    init_metadata_struct (&xml_metadata);
+
+    /* Validate the metadata file and parse it into our internal metadata
+       structure, reading the file only once; also allocates space as needed
+       for various pointers in the global and band metadata */
+    if (validate_and_parse_metadata (espa_xml_file, &xml_metadata) != SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+
+    for (i = 0; i < xml_metadata.nbands; i++)
+    {
+        if (vrt_data_type (xml_metadata.band[i].data_type) == NULL)
+        {
+            sprintf (errmsg, "Unsupported data type for band: %s",
+                xml_metadata.band[i].name);
+            error_handler (true, FUNC_NAME, errmsg);
+            goto cleanup;
+        }
+    }
+
+    if (vrt_srs (&xml_metadata.global.proj_info, srs) != SUCCESS)
+        goto cleanup;
+    if (vrt_source_dir (espa_xml_file, vrt_file, source_dir, &relative)
+        != SUCCESS)
+        goto cleanup;
+
+    supported = malloc (xml_metadata.nbands * sizeof (bool));
+    if (supported == NULL)
+    {
+        sprintf (errmsg, "Allocating the supported bands");
+        error_handler (true, FUNC_NAME, errmsg);
+        goto cleanup;
+    }
+    for (i = 0; i < xml_metadata.nbands; i++)
+        supported[i] = vrt_band_supported (&xml_metadata.band[i]);
+    if (get_espa_band_grids (&xml_metadata, &grids) != SUCCESS)
+        goto cleanup;
+
+    /* Strip the .vrt of the VRT filename, which the other grids are
+       appended to */
+    count = snprintf (base, sizeof (base), "%s", vrt_file);
+    if (count < 0 || count >= sizeof (base))
+    {
+        sprintf (errmsg, "Overflow of base string");
+        error_handler (true, FUNC_NAME, errmsg);
+        goto cleanup;
+    }
+    len = strlen (base);
+    if (len > 4 && !strcasecmp (&base[len-4], ".vrt"))
+        base[len-4] = '\0';
+
+    for (g = 0; g < grids.ngrids; g++)
+    {
+        /* A grid without any band GDAL can read in place gets no VRT */
+        nsupported = 0;
+        for (i = 0; i < xml_metadata.nbands; i++)
+        {
+            if (grids.band_grid[i] == g && supported[i])
+                nsupported++;
+        }
+        if (nsupported == 0)
+            continue;
+
+        if (nvrt == 0)
+            count = snprintf (grid_file, sizeof (grid_file), "%s", vrt_file);
+        else
+        {
+            if (espa_grid_name (&grids, g, base, grid_base,
+                sizeof (grid_base)) != SUCCESS)
+                goto cleanup;
+            count = snprintf (grid_file, sizeof (grid_file), "%s.vrt",
+                grid_base);
+        }
+        if (count < 0 || count >= sizeof (grid_file))
+        {
+            sprintf (errmsg, "Overflow of grid_file string");
+            error_handler (true, FUNC_NAME, errmsg);
+            goto cleanup;
+        }
+
+        if (write_vrt_grid (grid_file, &xml_metadata, &grids, g, supported,
+            srs, source_dir, relative) != SUCCESS)
+            goto cleanup;
+        nvrt++;
+    }
+
+    if (nvrt == 0)
+    {
+        sprintf (errmsg, "None of the bands can be read in place by GDAL");
+        error_handler (true, FUNC_NAME, errmsg);
+        goto cleanup;
+    }
+    status = SUCCESS;
+
+cleanup:
+    free_espa_band_grids (&grids);
+    free (supported);
+    free_metadata (&xml_metadata);
+    return (status);
+}
@@ -0,0 +1,36 @@
+/*****************************************************************************
+FILE: convert_espa_to_vrt.h
+
+PURPOSE: Contains defines and prototypes to read the ESPA XML metadata file
+and write a GDAL virtual raster (VRT) describing the raw binary bands in
+place.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+*****************************************************************************/
+
+#ifndef CONVERT_ESPA_TO_VRT_H
+#define CONVERT_ESPA_TO_VRT_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "error_handler.h"
+#include "espa_metadata.h"
+#include "parse_metadata.h"
+#include "espa_band_grids.h"
+
+/* Prototypes */
+int convert_espa_to_vrt
+(
+    char *espa_xml_file,   /* I: input ESPA XML metadata filename */
+    char *vrt_file         /* I: output VRT filename; the bands on other
+                                 grids than the first are written to VRTs
+                                 named with the grid appended */
+);
+
+#endif
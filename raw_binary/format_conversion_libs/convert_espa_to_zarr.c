@@ -0,0 +1,2799 @@
+/*****************************************************************************
+FILE: convert_espa_to_zarr.c
+
+PURPOSE: Contains functions for creating a Zarr (version 2) store from the
+ESPA raw binary bands, with one chunked and compressed array per band and
+the metadata consolidated for cloud readers.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The XML metadata format read via this library follows the ESPA internal
+     metadata format found in ESPA Raw Binary Format v1.0.doc.  The schema for
+     the ESPA internal metadata format is available at
+     http://espa.cr.usgs.gov/schema/espa_internal_metadata_v1_0.xsd.
+  2. The store is a directory holding the .zgroup and .zattrs of the group,
+     a directory per band with its .zarray, .zattrs, and chunk files named
+     line.sample (in chunks), and the consolidated .zmetadata, which holds
+     every other metadata document so a reader needs a single request.
+  3. The global and band attributes use the names written by
+     convert_espa_to_netcdf.  The dimensions of each band are given in
+     _ARRAY_DIMENSIONS, as xarray expects.
+  4. A datacube store holds the bands of many products on the same grid as
+     (time, y, x) arrays, chunked along time as well, with a time array
+     giving the acquisition time of each date.
+  5. A set of references (convert_espa_to_zarr_refs) describes the same
+     store over the band files as they are, plain, tiled, or block
+     compressed, so nothing is converted.
+*****************************************************************************/
+
+#include <unistd.h>
+#include <errno.h>
+#include <limits.h>
+#include <math.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <sys/stat.h>
+#include <zlib.h>
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+#include "convert_espa_to_zarr.h"
+#include "espa_trace.h"
+#include "espa_task_pool.h"
+#include "espa_cf_packing.h"
+#include "espa_stac.h"
+#include "espa_remote.h"
+#include "raw_binary_blocks.h"
+#include "espa_shm.h"
+
+/* JSON text of a Zarr metadata document, grown as it is written */
+typedef struct
+{
+    char *text;          /* JSON text, nul terminated */
+    size_t len;          /* number of characters in text */
+    size_t size;         /* number of bytes allocated for text */
+    bool failed;         /* did growing the text fail? */
+} Zarr_json_t;
+
+
+/******************************************************************************
+MODULE:  zarr_json_printf
+
+PURPOSE: Appends formatted text to a JSON document.
+
+RETURN VALUE: None
+
+NOTES:
+  1. A failure to grow the document is recorded in json->failed and checked
+     once the document is complete.
+******************************************************************************/
+static void zarr_json_printf
+(
+    Zarr_json_t *json,   /* I/O: JSON document */
+    const char *format,  /* I: printf format of the text */
+    ...                  /* I: values of the format */
+)
+{
+    va_list ap;          /* values of the format */
+    int count;           /* number of characters of the text */
+    size_t size;         /* new number of bytes for the document */
+    char *text;          /* grown document */
+
+    while (!json->failed)
+    {
+        va_start (ap, format);
+        count = vsnprintf (json->size == 0 ? NULL : json->text + json->len,
+            json->size - json->len, format, ap);
+        va_end (ap);
+        if (count < 0)
+        {
+            json->failed = true;
+            return;
+        }
+        if (json->len + count < json->size)
+        {
+            json->len += count;
+            return;
+        }
+
+        size = 2 * (json->len + count + 1);
+        text = realloc (json->text, size);
+        if (text == NULL)
+        {
+            json->failed = true;
+            return;
+        }
+        json->text = text;
+        json->size = size;
+    }
+}
+
+
+/******************************************************************************
+MODULE:  zarr_json_string
+
+PURPOSE: Appends a quoted JSON string to a JSON document, escaping the
+quotes, backslashes, and control characters.
+
+RETURN VALUE: None
+
+NOTES:
+******************************************************************************/
+static void zarr_json_string
+(
+    Zarr_json_t *json,   /* I/O: JSON document */
+    const char *str      /* I: string to be appended */
+)
+{
+    const unsigned char *c;   /* current character of the string */
+
+    zarr_json_printf (json, "\"");
+    for (c = (const unsigned char *) str; *c != '\0'; c++)
+    {
+        if (*c == '"' || *c == '\\')
+            zarr_json_printf (json, "\\%c", *c);
+        else if (*c < 0x20)
+            zarr_json_printf (json, "\\u%04x", *c);
+        else
+            zarr_json_printf (json, "%c", *c);
+    }
+    zarr_json_printf (json, "\"");
+}
+
+
+/******************************************************************************
+MODULE:  zarr_json_text_attr
+
+PURPOSE: Appends a string attribute to a JSON object of attributes, unless
+the string isn't defined in the metadata.
+
+RETURN VALUE: None
+
+NOTES:
+  1. Every attribute is preceded by a comma, so the object must already hold
+     at least one member.
+******************************************************************************/
+static void zarr_json_text_attr
+(
+    Zarr_json_t *json,   /* I/O: JSON document */
+    const char *name,    /* I: name of the attribute */
+    const char *value    /* I: value of the attribute */
+)
+{
+    if (value[0] == '\0' || !strcmp (value, ESPA_STRING_META_FILL))
+        return;
+
+    zarr_json_printf (json, ", ");
+    zarr_json_string (json, name);
+    zarr_json_printf (json, ": ");
+    zarr_json_string (json, value);
+}
+
+
+/******************************************************************************
+MODULE:  zarr_dtype
+
+PURPOSE: Returns the Zarr (NumPy) data type of an ESPA data type, in little
+endian byte order.
+
+RETURN VALUE:
+Type = const char *
+Value           Description
+-----           -----------
+NULL            Unsupported data type
+non-NULL        Zarr data type
+******************************************************************************/
+static const char *zarr_dtype
+(
+    enum Espa_data_type data_type  /* I: ESPA data type */
+)
+{
+    switch (data_type)
+    {
+        case ESPA_INT8: return ("|i1");
+        case ESPA_UINT8: return ("|u1");
+        case ESPA_INT16: return ("<i2");
+        case ESPA_UINT16: return ("<u2");
+        case ESPA_INT32: return ("<i4");
+        case ESPA_UINT32: return ("<u4");
+        case ESPA_FLOAT32: return ("<f4");
+        case ESPA_FLOAT64: return ("<f8");
+        default: return (NULL);
+    }
+}
+
+
+/******************************************************************************
+MODULE:  zarr_level
+
+PURPOSE: Returns the compression level of the chunks.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+n               Compression level; the default of the compressor unless one
+                was specified
+******************************************************************************/
+static int zarr_level
+(
+    Zarr_options_t *options  /* I: chunking and compression of the bands */
+)
+{
+    if (options->level != 0)
+        return (options->level);
+    if (options->compressor == ZARR_COMPRESS_ZSTD)
+        return (DEFAULT_ZARR_ZSTD_LEVEL);
+    return (DEFAULT_ZARR_ZLIB_LEVEL);
+}
+
+
+/******************************************************************************
+MODULE:  zarr_chunk_shape
+
+PURPOSE: Determines the number of lines and samples in a chunk of a band,
+limited to the size of the band.
+
+RETURN VALUE: None
+
+NOTES:
+******************************************************************************/
+static void zarr_chunk_shape
+(
+    Espa_band_meta_t *bmeta,   /* I: metadata of the band */
+    Zarr_options_t *options,   /* I: chunking and compression of the bands */
+    int chunks[2]              /* O: number of lines and samples in a chunk */
+)
+{
+    chunks[0] = options->chunk_lines;
+    if (chunks[0] > bmeta->nlines)
+        chunks[0] = bmeta->nlines;
+    chunks[1] = options->chunk_samps;
+    if (chunks[1] == 0 || chunks[1] > bmeta->nsamps)
+        chunks[1] = bmeta->nsamps;
+}
+
+
+/******************************************************************************
+MODULE:  zarr_band_meta
+
+PURPOSE: Determines the metadata of a band as it is written to its array.
+
+RETURN VALUE:
+Type = bool
+Value           Description
+-----           -----------
+true            The physical values of the packed band are written
+false           The pixels of the band are written as they are
+
+NOTES:
+  1. The copy shares the allocated fields of the band metadata, so it must
+     not be freed.
+******************************************************************************/
+static bool zarr_band_meta
+(
+    Espa_band_meta_t *bmeta,   /* I: metadata of the band */
+    Zarr_options_t *options,   /* I: chunking and compression of the bands */
+    Espa_band_meta_t *vmeta    /* O: metadata of the band array */
+)
+{
+    *vmeta = *bmeta;
+    if (!options->physical_units || !espa_cf_is_packed (bmeta))
+        return (false);
+
+    espa_cf_physical_meta (vmeta);
+    return (true);
+}
+
+
+/******************************************************************************
+MODULE:  zarr_array_json
+
+PURPOSE: Writes the .zarray document of a band, describing its shape,
+chunks, data type, and compression.  The array of a datacube band has a
+leading time dimension.
+
+RETURN VALUE: None
+
+NOTES:
+  1. Multi-byte values are shuffled before they are compressed, using the
+     numcodecs shuffle filter, which groups the same byte of every value.
+  2. With physical units, float32 arrays without a fill value are filled
+     with NaN.
+******************************************************************************/
+static void zarr_array_json
+(
+    Zarr_json_t *json,         /* I/O: JSON document */
+    Espa_band_meta_t *bmeta,   /* I: metadata of the band */
+    int ntimes,                /* I: number of dates of the datacube; 0 for
+                                     a band without a time dimension */
+    int time_chunk,            /* I: number of dates per chunk */
+    Zarr_options_t *options    /* I: chunking and compression of the bands */
+)
+{
+    int chunks[2];             /* number of lines and samples in a chunk */
+    int nbytes;                /* number of bytes in the data type */
+
+    nbytes = espa_data_type_size (bmeta->data_type);
+    zarr_chunk_shape (bmeta, options, chunks);
+
+    zarr_json_printf (json, "{\"zarr_format\": 2, \"shape\": [");
+    if (ntimes > 0)
+        zarr_json_printf (json, "%d, ", ntimes);
+    zarr_json_printf (json, "%d, %d], \"chunks\": [", bmeta->nlines,
+        bmeta->nsamps);
+    if (ntimes > 0)
+        zarr_json_printf (json, "%d, ", time_chunk);
+    zarr_json_printf (json, "%d, %d], \"dtype\": \"%s\", \"order\": \"C\", "
+        "\"dimension_separator\": \".\", \"compressor\": ", chunks[0],
+        chunks[1], zarr_dtype (bmeta->data_type));
+    if (options->compressor == ZARR_COMPRESS_ZLIB)
+        zarr_json_printf (json, "{\"id\": \"zlib\", \"level\": %d}",
+            zarr_level (options));
+    else if (options->compressor == ZARR_COMPRESS_ZSTD)
+        zarr_json_printf (json, "{\"id\": \"zstd\", \"level\": %d}",
+            zarr_level (options));
+    else
+        zarr_json_printf (json, "null");
+
+    if (options->compressor != ZARR_COMPRESS_NONE && nbytes > 1)
+        zarr_json_printf (json, ", \"filters\": [{\"id\": \"shuffle\", "
+            "\"elementsize\": %d}]", nbytes);
+    else
+        zarr_json_printf (json, ", \"filters\": null");
+
+    if (bmeta->fill_value != ESPA_INT_META_FILL)
+        zarr_json_printf (json, ", \"fill_value\": %ld}", bmeta->fill_value);
+    else if (options->physical_units && bmeta->data_type == ESPA_FLOAT32)
+        zarr_json_printf (json, ", \"fill_value\": \"NaN\"}");
+    else
+        zarr_json_printf (json, ", \"fill_value\": null}");
+}
+
+
+/******************************************************************************
+MODULE:  zarr_band_attrs_json
+
+PURPOSE: Writes the .zattrs document of a band, holding its dimensions and
+the band metadata.
+
+RETURN VALUE: None
+
+NOTES:
+  1. Bands the size of the first band use the y and x dimensions.  Bands of
+     other sizes get dimensions named for their size, so bands of the same
+     size share dimensions.
+  2. Datacube bands lead with the time dimension.
+******************************************************************************/
+static void zarr_band_attrs_json
+(
+    Zarr_json_t *json,         /* I/O: JSON document */
+    Espa_band_meta_t *bmeta,   /* I: metadata of the band */
+    Espa_band_meta_t *bmeta0,  /* I: metadata of the first band */
+    bool cube                  /* I: is the band an array of a datacube? */
+)
+{
+    int i;                     /* looping variable for the bits and classes */
+    char value[STR_SIZE];      /* bit number or class value */
+
+    zarr_json_printf (json, "{\"_ARRAY_DIMENSIONS\": [");
+    if (cube)
+        zarr_json_printf (json, "\"time\", ");
+    if (bmeta->nlines == bmeta0->nlines && bmeta->nsamps == bmeta0->nsamps)
+        zarr_json_printf (json, "\"y\", \"x\"]");
+    else
+        zarr_json_printf (json, "\"y_%d\", \"x_%d\"]", bmeta->nlines,
+            bmeta->nsamps);
+
+    zarr_json_text_attr (json, "long_name", bmeta->long_name);
+    zarr_json_text_attr (json, "units", bmeta->data_units);
+    zarr_json_text_attr (json, "product", bmeta->product);
+    zarr_json_text_attr (json, "source", bmeta->source);
+    zarr_json_text_attr (json, "category", bmeta->category);
+
+    if (fabs (bmeta->valid_range[0] - ESPA_FLOAT_META_FILL) > ESPA_EPSILON &&
+        fabs (bmeta->valid_range[1] - ESPA_FLOAT_META_FILL) > ESPA_EPSILON)
+        zarr_json_printf (json, ", \"valid_range\": [%.15g, %.15g]",
+            bmeta->valid_range[0], bmeta->valid_range[1]);
+    if (bmeta->saturate_value != ESPA_INT_META_FILL)
+        zarr_json_printf (json, ", \"_SaturateValue\": %d",
+            bmeta->saturate_value);
+    if (fabs (bmeta->scale_factor - ESPA_FLOAT_META_FILL) > ESPA_EPSILON)
+        zarr_json_printf (json, ", \"scale_factor\": %.9g",
+            bmeta->scale_factor);
+    if (fabs (bmeta->add_offset - ESPA_FLOAT_META_FILL) > ESPA_EPSILON)
+        zarr_json_printf (json, ", \"add_offset\": %.9g", bmeta->add_offset);
+    zarr_json_printf (json, ", \"pixel_size\": [%.15g, %.15g]",
+        bmeta->pixel_size[0], bmeta->pixel_size[1]);
+    zarr_json_text_attr (json, "pixel_units", bmeta->pixel_units);
+
+    if (bmeta->nbits != ESPA_INT_META_FILL && bmeta->nbits > 0)
+    {
+        zarr_json_printf (json, ", \"Bitmap description\": {");
+        for (i = 0; i < bmeta->nbits; i++)
+        {
+            snprintf (value, sizeof (value), "%d", i);
+            if (i > 0)
+                zarr_json_printf (json, ", ");
+            zarr_json_string (json, value);
+            zarr_json_printf (json, ": ");
+            zarr_json_string (json, bmeta->bitmap_description[i]);
+        }
+        zarr_json_printf (json, "}");
+    }
+
+    if (bmeta->nclass != ESPA_INT_META_FILL && bmeta->nclass > 0)
+    {
+        zarr_json_printf (json, ", \"Class description\": {");
+        for (i = 0; i < bmeta->nclass; i++)
+        {
+#ifdef ESPA_USE_CPP_CLASS_VAL
+            snprintf (value, sizeof (value), "%d",
+                bmeta->class_values[i].espa_class);
+#else
+            snprintf (value, sizeof (value), "%d",
+                bmeta->class_values[i].class);
+#endif
+            if (i > 0)
+                zarr_json_printf (json, ", ");
+            zarr_json_string (json, value);
+            zarr_json_printf (json, ": ");
+            zarr_json_string (json, bmeta->class_values[i].description);
+        }
+        zarr_json_printf (json, "}");
+    }
+
+    zarr_json_text_attr (json, "app_version", bmeta->app_version);
+    zarr_json_text_attr (json, "production_date", bmeta->production_date);
+    zarr_json_printf (json, "}");
+}
+
+
+/******************************************************************************
+MODULE:  zarr_grid_attrs_json
+
+PURPOSE: Writes the corners and projection of the grid of a product to the
+global attributes.
+
+RETURN VALUE: None
+
+NOTES:
+******************************************************************************/
+static void zarr_grid_attrs_json
+(
+    Zarr_json_t *json,                 /* I/O: JSON document */
+    Espa_global_meta_t *gmeta          /* I: global metadata of the
+                                             product */
+)
+{
+    Espa_proj_meta_t *proj = &gmeta->proj_info;
+                                       /* projection information */
+
+    zarr_json_printf (json, ", \"UpperLeftCornerLatLong\": [%.15g, %.15g], "
+        "\"LowerRightCornerLatLong\": [%.15g, %.15g], "
+        "\"WestBoundingCoordinate\": %.15g, "
+        "\"EastBoundingCoordinate\": %.15g, "
+        "\"NorthBoundingCoordinate\": %.15g, "
+        "\"SouthBoundingCoordinate\": %.15g", gmeta->ul_corner[0],
+        gmeta->ul_corner[1], gmeta->lr_corner[0], gmeta->lr_corner[1],
+        gmeta->bounding_coords[ESPA_WEST], gmeta->bounding_coords[ESPA_EAST],
+        gmeta->bounding_coords[ESPA_NORTH],
+        gmeta->bounding_coords[ESPA_SOUTH]);
+
+    zarr_json_printf (json, ", \"ProjectionType\": %d, \"DatumType\": %d, "
+        "\"UpperLeftProjectionCorner\": [%.15g, %.15g], "
+        "\"LowerRightProjectionCorner\": [%.15g, %.15g]", proj->proj_type,
+        proj->datum_type, proj->ul_corner[0], proj->ul_corner[1],
+        proj->lr_corner[0], proj->lr_corner[1]);
+    zarr_json_text_attr (json, "ProjectionUnits", proj->units);
+    zarr_json_text_attr (json, "GridOrigin", proj->grid_origin);
+    if (proj->utm_zone != ESPA_INT_META_FILL)
+        zarr_json_printf (json, ", \"UTMZone\": %d", proj->utm_zone);
+}
+
+
+/******************************************************************************
+MODULE:  zarr_global_attrs_json
+
+PURPOSE: Writes the .zattrs document of the group, holding the global
+metadata.
+
+RETURN VALUE: None
+
+NOTES:
+******************************************************************************/
+static void zarr_global_attrs_json
+(
+    Zarr_json_t *json,                 /* I/O: JSON document */
+    Espa_internal_meta_t *xml_metadata /* I: metadata of the product */
+)
+{
+    Espa_global_meta_t *gmeta = &xml_metadata->global;
+                                       /* global metadata */
+
+    zarr_json_printf (json, "{\"Conventions\": \"CF-1.6\"");
+    zarr_json_text_attr (json, "DataProvider", gmeta->data_provider);
+    zarr_json_text_attr (json, "Satellite", gmeta->satellite);
+    zarr_json_text_attr (json, "Instrument", gmeta->instrument);
+    zarr_json_text_attr (json, "AcquisitionDate", gmeta->acquisition_date);
+    zarr_json_text_attr (json, "SceneCenterTime", gmeta->scene_center_time);
+    zarr_json_text_attr (json, "Level1ProductionDate",
+        gmeta->level1_production_date);
+    zarr_json_text_attr (json, "LPGSMetadataFile", gmeta->lpgs_metadata_file);
+    zarr_json_text_attr (json, "ProductID", gmeta->product_id);
+
+    if (fabs (gmeta->solar_zenith - ESPA_FLOAT_META_FILL) > ESPA_EPSILON)
+        zarr_json_printf (json, ", \"SolarZenith\": %.9g",
+            gmeta->solar_zenith);
+    if (fabs (gmeta->solar_azimuth - ESPA_FLOAT_META_FILL) > ESPA_EPSILON)
+        zarr_json_printf (json, ", \"SolarAzimuth\": %.9g",
+            gmeta->solar_azimuth);
+    if (fabs (gmeta->earth_sun_dist - ESPA_FLOAT_META_FILL) > ESPA_EPSILON)
+        zarr_json_printf (json, ", \"EarthSunDist\": %.9g",
+            gmeta->earth_sun_dist);
+    if (gmeta->wrs_path != ESPA_INT_META_FILL)
+        zarr_json_printf (json, ", \"WRS_Path\": %d", gmeta->wrs_path);
+    if (gmeta->wrs_row != ESPA_INT_META_FILL)
+        zarr_json_printf (json, ", \"WRS_Row\": %d", gmeta->wrs_row);
+    zarr_grid_attrs_json (json, gmeta);
+
+    /* Use the production date from the first band */
+    zarr_json_text_attr (json, "ProductionDate",
+        xml_metadata->band[0].production_date);
+    zarr_json_printf (json, "}");
+}
+
+
+/******************************************************************************
+MODULE:  write_zarr_file
+
+PURPOSE: Writes a buffer to a file of the store.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the file
+SUCCESS         Successfully wrote the file
+
+NOTES:
+  1. No error message is written, so the function can be called from
+     multiple threads; the caller reports the error.
+******************************************************************************/
+static int write_zarr_file
+(
+    const char *path,    /* I: name of the file */
+    const void *buf,     /* I: contents of the file */
+    size_t len           /* I: number of bytes in buf */
+)
+{
+    FILE *fp = NULL;     /* file being written */
+    int status = SUCCESS;   /* return status */
+
+    fp = fopen (path, "wb");
+    if (fp == NULL)
+        return (ERROR);
+    if (len > 0 && fwrite (buf, 1, len, fp) != len)
+        status = ERROR;
+    if (fclose (fp) != 0)
+        status = ERROR;
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  put_zarr_document
+
+PURPOSE: Writes a metadata document to its file in the store and adds it to
+the consolidated metadata.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the document
+SUCCESS         Successfully wrote the document
+
+NOTES:
+******************************************************************************/
+static int put_zarr_document
+(
+    char *zarr_dir,            /* I: Zarr store directory */
+    char *key,                 /* I: name of the document in the store */
+    Zarr_json_t *doc,          /* I: JSON document */
+    Zarr_json_t *consolidated  /* I/O: consolidated metadata */
+)
+{
+    char FUNC_NAME[] = "put_zarr_document";  /* function name */
+    char errmsg[STR_SIZE];     /* error message */
+    char path[STR_SIZE];       /* name of the document file */
+    int count;                 /* number of chars copied in snprintf */
+
+    if (doc->failed)
+    {
+        sprintf (errmsg, "Allocating memory for the metadata document %s",
+            key);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    count = snprintf (path, sizeof (path), "%s/%s", zarr_dir, key);
+    if (count < 0 || count >= sizeof (path))
+    {
+        sprintf (errmsg, "Overflow of path string");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    if (write_zarr_file (path, doc->text, doc->len) != SUCCESS)
+    {
+        sprintf (errmsg, "Writing the metadata document: %s", path);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Documents follow the opening of the consolidated metadata object,
+       separated by commas */
+    if (!consolidated->failed &&
+        consolidated->text[consolidated->len - 1] != '{')
+        zarr_json_printf (consolidated, ", ");
+    zarr_json_string (consolidated, key);
+    zarr_json_printf (consolidated, ": %s", doc->text);
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  make_zarr_dir
+
+PURPOSE: Creates a directory of the store, if it doesn't already exist.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error creating the directory
+SUCCESS         Successfully created the directory, or it already existed
+
+NOTES:
+******************************************************************************/
+static int make_zarr_dir
+(
+    char *dir            /* I: name of the directory */
+)
+{
+    char FUNC_NAME[] = "make_zarr_dir";  /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+
+    if (mkdir (dir, 0755) != 0 && errno != EEXIST)
+    {
+        sprintf (errmsg, "Creating the Zarr directory: %s", dir);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  compress_zarr_chunk
+
+PURPOSE: Copies a chunk out of a block of lines (one block per date for a
+datacube), shuffles its bytes, and compresses it, as the filters and
+compressor in the .zarray of the band describe.
+
+RETURN VALUE:
+Type = size_t
+Value           Description
+-----           -----------
+0               Error compressing the chunk
+> 0             Number of bytes in the compressed chunk
+
+NOTES:
+  1. The part of an edge chunk outside the band (or after the last date) is
+     zero.  Zarr readers ignore it.
+  2. Uncompressed chunks are copied to out_buf as is.
+******************************************************************************/
+static size_t compress_zarr_chunk
+(
+    const unsigned char *const *lines, /* I: block of full lines holding the
+                                   chunk, for each date of the chunk */
+    int ntimes,              /* I: number of dates of the chunk in the cube;
+                                   1 for a band */
+    int chunk_times,         /* I: number of dates in a chunk; 1 for a
+                                   band */
+    int nlines,              /* I: number of lines of the chunk in the band */
+    int nsamps,              /* I: number of samples per line in lines */
+    int samp0,               /* I: 0-based first sample of the chunk */
+    const int chunks[2],     /* I: number of lines and samples in a chunk */
+    int nbytes,              /* I: number of bytes in the data type */
+    Zarr_options_t *options, /* I: chunking and compression of the bands */
+    unsigned char *shuf_buf, /* I: storage for the shuffled chunk */
+    unsigned char *out_buf,  /* O: compressed chunk */
+    size_t out_size          /* I: number of bytes available in out_buf */
+)
+{
+    int time;                /* looping variable for the dates */
+    int line;                /* looping variable for the lines */
+    int samp;                /* looping variable for the samples */
+    int byte;                /* looping variable for the bytes of a sample */
+    int width;               /* number of samples of the chunk in the band */
+    bool shuffle;            /* are the bytes of the values shuffled? */
+    size_t nelems = (size_t) chunk_times * chunks[0] * chunks[1];
+                             /* number of values in a chunk */
+    size_t first;            /* first value of the current chunk line */
+    const unsigned char *src;   /* current sample of the block */
+    unsigned char *dest;        /* current value of the chunk */
+    unsigned char *chunk_buf;   /* chunk ready to be compressed */
+    uLongf out_len = out_size;  /* number of bytes in the compressed chunk */
+
+    width = nsamps - samp0;
+    if (width > chunks[1])
+        width = chunks[1];
+    chunk_buf = options->compressor == ZARR_COMPRESS_NONE ? out_buf
+        : shuf_buf;
+    shuffle = options->compressor != ZARR_COMPRESS_NONE && nbytes > 1;
+
+    /* Byte j of value i goes to j * nelems + i when shuffling, which is the
+       transposition done by the numcodecs shuffle filter */
+    memset (chunk_buf, 0, nelems * nbytes);
+    for (time = 0; time < ntimes; time++)
+    {
+        for (line = 0; line < nlines; line++)
+        {
+            src = lines[time] + ((size_t) line * nsamps + samp0) * nbytes;
+            first = ((size_t) time * chunks[0] + line) * chunks[1];
+            if (!shuffle)
+            {
+                memcpy (chunk_buf + first * nbytes, src, (size_t) width
+                    * nbytes);
+                continue;
+            }
+            dest = chunk_buf + first;
+            for (samp = 0; samp < width; samp++)
+                for (byte = 0; byte < nbytes; byte++)
+                    dest[byte * nelems + samp] = *src++;
+        }
+    }
+
+    switch (options->compressor)
+    {
+        case ZARR_COMPRESS_ZLIB:
+            if (compress2 (out_buf, &out_len, shuf_buf, nelems * nbytes,
+                zarr_level (options)) != Z_OK)
+                return 0;
+            return out_len;
+#ifdef HAVE_ZSTD
+        case ZARR_COMPRESS_ZSTD:
+            out_len = ZSTD_compress (out_buf, out_size, shuf_buf,
+                nelems * nbytes, zarr_level (options));
+            if (ZSTD_isError (out_len))
+                return 0;
+            return out_len;
+#endif
+        case ZARR_COMPRESS_NONE:
+            return nelems * nbytes;
+        default:
+            return 0;
+    }
+}
+
+
+/* Block of lines whose chunks are compressed and written in parallel */
+typedef struct
+{
+    const char *band_dir;       /* directory of the band in the store */
+    const unsigned char **lines; /* block of lines of the band, for each
+                                   date of the chunks */
+    int ntimes;                 /* number of dates of the chunks in the
+                                   cube; 1 for a band */
+    int chunk_times;            /* number of dates in a chunk; 1 for a
+                                   band */
+    int time_chunk;             /* index of the chunks along the time
+                                   dimension; -1 for a band, which has
+                                   none */
+    int line0;                  /* first line of the block in the band */
+    int nlines;                 /* number of lines in the block */
+    int nsamps;                 /* number of samples per line */
+    int ncols;                  /* number of chunks across the band */
+    int nbytes;                 /* number of bytes in the data type */
+    const int *chunks;          /* number of lines and samples in a chunk */
+    Zarr_options_t *options;    /* chunking and compression of the bands */
+    size_t chunk_size;          /* number of bytes in an uncompressed chunk */
+    unsigned char *shuf_buf;    /* shuffled chunk of each worker */
+    unsigned char *out_buf;     /* compressed chunk of each worker */
+    size_t out_size;            /* largest number of bytes of a compressed
+                                   chunk */
+    int *chunk_status;          /* status of writing each chunk */
+} Zarr_chunk_block_t;
+
+
+/******************************************************************************
+MODULE:  write_zarr_block_chunk
+
+PURPOSE: Compresses one chunk of a block of lines and writes it to its file,
+as an iteration of the parallel loop over the chunks of the block.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+SUCCESS         Always; the status of the chunk is kept in chunk_status
+
+NOTES:
+******************************************************************************/
+static int write_zarr_block_chunk
+(
+    void *arg,                  /* I/O: block of lines of the band */
+    int chunk,                  /* I: index of the chunk in the block */
+    int worker                  /* I: worker writing the chunk */
+)
+{
+    Zarr_chunk_block_t *blk = arg;  /* block of lines of the band */
+    char path[STR_SIZE];        /* name of the chunk file */
+    int row;                    /* row of the chunk in the block */
+    int rows;                   /* number of lines of the chunk in the band */
+    int time;                   /* looping variable for the dates */
+    int count;                  /* number of chars copied in snprintf */
+    size_t len;                 /* number of bytes of the compressed chunk */
+    unsigned char *out_buf;     /* compressed chunk of the worker */
+    const unsigned char *lines[ZARR_MAX_CUBE_TIME_CHUNK];  /* first line of
+                                   the chunk for each date */
+
+    row = chunk / blk->ncols;
+    rows = blk->nlines - row * blk->chunks[0];
+    if (rows > blk->chunks[0])
+        rows = blk->chunks[0];
+    out_buf = blk->out_buf + worker * blk->out_size;
+    for (time = 0; time < blk->ntimes; time++)
+        lines[time] = blk->lines[time] + (size_t) row * blk->chunks[0]
+            * blk->nsamps * blk->nbytes;
+    len = compress_zarr_chunk (lines, blk->ntimes, blk->chunk_times, rows,
+        blk->nsamps, (chunk % blk->ncols) * blk->chunks[1], blk->chunks,
+        blk->nbytes, blk->options, blk->shuf_buf + worker * blk->chunk_size,
+        out_buf, blk->out_size);
+
+    blk->chunk_status[chunk] = ERROR;
+    if (blk->time_chunk < 0)
+        count = snprintf (path, sizeof (path), "%s/%d.%d", blk->band_dir,
+            blk->line0 / blk->chunks[0] + row, chunk % blk->ncols);
+    else
+        count = snprintf (path, sizeof (path), "%s/%d.%d.%d", blk->band_dir,
+            blk->time_chunk, blk->line0 / blk->chunks[0] + row,
+            chunk % blk->ncols);
+    if (len > 0 && count < (int) sizeof (path))
+        blk->chunk_status[chunk] = write_zarr_file (path, out_buf, len);
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  write_zarr_band
+
+PURPOSE: Compresses the chunks of a band in parallel and writes each to its
+file in the directory of the band.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the band
+SUCCESS         Successfully wrote the band
+
+NOTES:
+  1. The band is read ahead by the band stack, one row of chunks per thread
+     of the task pool at a time.  The chunks of those rows are compressed and
+     written in parallel on the pool, since every chunk is its own file.
+  2. With physical units, the blocks of a packed band are unpacked to their
+     physical values before their chunks are compressed.
+******************************************************************************/
+static int write_zarr_band
+(
+    char *band_dir,             /* I: directory of the band in the store */
+    Espa_internal_meta_t *xml_metadata, /* I: XML metadata structure */
+    int band,                   /* I: index of the band in the metadata */
+    Zarr_options_t *options     /* I: chunking and compression of the bands */
+)
+{
+    char FUNC_NAME[] = "write_zarr_band";  /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    int nthreads;               /* number of threads compressing chunks */
+    int ncols;                  /* number of chunks across the band */
+    int nchunks;                /* number of chunks in the current block */
+    int chunk;                  /* looping variable for the chunks */
+    int block_lines;            /* number of lines in a full block */
+    int nbytes;                 /* number of bytes in the data type */
+    int chunks[2];              /* number of lines and samples in a chunk */
+    size_t chunk_size;          /* number of bytes in an uncompressed chunk */
+    size_t out_size;            /* largest number of bytes of a compressed
+                                   chunk */
+    int *chunk_status = NULL;   /* status of writing each chunk */
+    unsigned char *shuf_buf = NULL;  /* shuffled chunk of each thread */
+    unsigned char *out_buf = NULL;   /* compressed chunk of each thread */
+    float *physical = NULL;     /* physical values of the block; NULL if the
+                                   pixels are written as they are */
+    bool unpack;                /* are the physical values written? */
+    const unsigned char *lines; /* block of lines written */
+    Zarr_chunk_block_t blk;     /* block whose chunks are written */
+    Espa_band_meta_t *bmeta = &xml_metadata->band[band]; /* band metadata */
+    Espa_band_meta_t vmeta;     /* metadata of the band array */
+    Espa_band_stack_t *stack = NULL; /* reader of the band */
+    Espa_band_block_t *block = NULL; /* current block of lines */
+    int status = ERROR;         /* return status */
+
+    nthreads = espa_task_pool_threads ();
+    unpack = zarr_band_meta (bmeta, options, &vmeta);
+    nbytes = espa_data_type_size (vmeta.data_type);
+    zarr_chunk_shape (bmeta, options, chunks);
+    ncols = (bmeta->nsamps + chunks[1] - 1) / chunks[1];
+    block_lines = espa_band_stack_lines (xml_metadata, 1, &band,
+        chunks[0] * nthreads, chunks[0]);
+    if (block_lines > bmeta->nlines)
+        block_lines = bmeta->nlines;
+    nchunks = (block_lines + chunks[0] - 1) / chunks[0] * ncols;
+    chunk_size = (size_t) chunks[0] * chunks[1] * nbytes;
+    out_size = chunk_size;
+    if (options->compressor == ZARR_COMPRESS_ZLIB)
+        out_size = compressBound (chunk_size);
+#ifdef HAVE_ZSTD
+    if (options->compressor == ZARR_COMPRESS_ZSTD)
+        out_size = ZSTD_compressBound (chunk_size);
+#endif
+
+    stack = open_band_stack (xml_metadata, 1, &band, block_lines, 0);
+    shuf_buf = espa_buffer_get ((size_t) nthreads * chunk_size);
+    out_buf = espa_buffer_get ((size_t) nthreads * out_size);
+    chunk_status = malloc (nchunks * sizeof (int));
+    if (unpack)
+        physical = espa_buffer_get ((size_t) block_lines * bmeta->nsamps
+            * sizeof (float));
+    if (stack == NULL)
+    {
+        sprintf (errmsg, "Opening the band stack for band %s", bmeta->name);
+        error_handler (true, FUNC_NAME, errmsg);
+        goto cleanup;
+    }
+    if (shuf_buf == NULL || out_buf == NULL || chunk_status == NULL ||
+        (unpack && physical == NULL))
+    {
+        sprintf (errmsg, "Error allocating memory for the chunk buffers.");
+        error_handler (true, FUNC_NAME, errmsg);
+        goto cleanup;
+    }
+
+    blk.band_dir = band_dir;
+    blk.lines = &lines;
+    blk.ntimes = 1;
+    blk.chunk_times = 1;
+    blk.time_chunk = -1;
+    blk.nsamps = bmeta->nsamps;
+    blk.ncols = ncols;
+    blk.nbytes = nbytes;
+    blk.chunks = chunks;
+    blk.options = options;
+    blk.chunk_size = chunk_size;
+    blk.shuf_buf = shuf_buf;
+    blk.out_buf = out_buf;
+    blk.out_size = out_size;
+    blk.chunk_status = chunk_status;
+    while (1)
+    {
+        if (get_band_stack_block (stack, &block) != SUCCESS)
+        {
+            sprintf (errmsg, "Reading image data from the raw binary file");
+            error_handler (true, FUNC_NAME, errmsg);
+            goto cleanup;
+        }
+        if (block == NULL)
+            break;
+        lines = block->band_buf[0];
+        blk.line0 = block->line0;
+        blk.nlines = block->nlines;
+        if (unpack)
+        {
+            espa_cf_unpack (bmeta, block->band_buf[0], (long) block->nlines
+                * bmeta->nsamps, physical);
+            lines = (const unsigned char *) physical;
+        }
+
+        /* The workers of the loop never outnumber the threads of the pool,
+           so each has its own buffers */
+        nchunks = (block->nlines + chunks[0] - 1) / chunks[0] * ncols;
+        espa_parallel_for (nchunks, nthreads, write_zarr_block_chunk, &blk);
+
+        for (chunk = 0; chunk < nchunks; chunk++)
+        {
+            if (chunk_status[chunk] != SUCCESS)
+            {
+                sprintf (errmsg, "Compressing and writing chunk %d.%d of "
+                    "band: %s", block->line0 / chunks[0] + chunk / ncols,
+                    chunk % ncols, bmeta->name);
+                error_handler (true, FUNC_NAME, errmsg);
+                goto cleanup;
+            }
+        }
+    }
+    status = SUCCESS;
+
+cleanup:
+    close_band_stack (stack);
+    espa_buffer_put (shuf_buf);
+    espa_buffer_put (out_buf);
+    espa_buffer_put (physical);
+    free (chunk_status);
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  remove_zarr_band_source
+
+PURPOSE: Removes the raw binary image and ENVI header files of a band.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error removing the files
+SUCCESS         Successfully removed the files
+
+NOTES:
+******************************************************************************/
+static int remove_zarr_band_source
+(
+    Espa_band_meta_t *bmeta   /* I: metadata of the band */
+)
+{
+    char FUNC_NAME[] = "remove_zarr_band_source";  /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    char hdr_file[STR_SIZE];  /* ENVI header file */
+    char *cptr = NULL;        /* pointer to the file extension */
+    int count;                /* number of chars copied in snprintf */
+
+    /* .img file */
+    printf ("  Removing %s\n", bmeta->file_name);
+    if (unlink (bmeta->file_name) != 0)
+    {
+        sprintf (errmsg, "Deleting source file: %s", bmeta->file_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* .hdr file */
+    count = snprintf (hdr_file, sizeof (hdr_file), "%s", bmeta->file_name);
+    if (count < 0 || count >= sizeof (hdr_file))
+    {
+        sprintf (errmsg, "Overflow of hdr_file string");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    cptr = strrchr (hdr_file, '.');
+    strcpy (cptr, ".hdr");
+    printf ("  Removing %s\n", hdr_file);
+    if (unlink (hdr_file) != 0)
+    {
+        sprintf (errmsg, "Deleting source file: %s", hdr_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  parse_zarr_compressor
+
+PURPOSE: Converts the name of a compressor to the compressor of the chunks.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Unknown compressor, or zstd isn't available
+SUCCESS         Successfully converted the name
+******************************************************************************/
+int parse_zarr_compressor
+(
+    char *name,                    /* I: name of the compressor (none, zlib,
+                                         or zstd) */
+    Zarr_compressor_t *compressor  /* O: compressor of the chunks */
+)
+{
+    char FUNC_NAME[] = "parse_zarr_compressor";  /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+
+    if (!strcmp (name, "none"))
+        *compressor = ZARR_COMPRESS_NONE;
+    else if (!strcmp (name, "zlib"))
+        *compressor = ZARR_COMPRESS_ZLIB;
+    else if (!strcmp (name, "zstd"))
+    {
+#ifdef HAVE_ZSTD
+        *compressor = ZARR_COMPRESS_ZSTD;
+#else
+        sprintf (errmsg, "zstd compression isn't available; rebuild with "
+            "ENABLE_ZSTD=yes");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+#endif
+    }
+    else
+    {
+        snprintf (errmsg, sizeof (errmsg), "Unknown compressor %s.  Valid "
+            "compressors are none, zlib, and zstd.", name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  convert_espa_to_zarr
+
+PURPOSE: Converts the internal ESPA raw binary file to a Zarr store, with a
+chunked and compressed array per band.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error converting to Zarr
+SUCCESS         Successfully converted to Zarr
+
+NOTES:
+  1. The bands are streamed from the raw binary files a block of chunk rows
+     at a time, so the memory used doesn't depend on the size of the bands.
+  2. Existing files of the same names in the store are overwritten.
+  3. With physical units, the packed bands are written as float32 physical
+     values with NaN fill (see espa_cf_packing.h), and their attributes
+     describe the physical values.
+******************************************************************************/
+int convert_espa_to_zarr
+(
+    char *espa_xml_file,   /* I: input ESPA XML metadata filename */
+    char *zarr_dir,        /* I: output Zarr store directory */
+    bool del_src,          /* I: should the source files be removed after
+                                 conversion? */
+    Zarr_options_t *options  /* I: chunking and compression of the bands */
+)
+{
+    char FUNC_NAME[] = "convert_espa_to_zarr";  /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    char key[STR_SIZE];         /* name of a document in the store */
+    char band_dir[STR_SIZE];    /* directory of the band in the store */
+    int i;                      /* looping variable for each band */
+    int count;                  /* number of chars copied in snprintf */
+    Espa_internal_meta_t xml_metadata;  /* XML metadata structure to be
+                                   populated by reading the input XML metadata
+                                   file */
+    Espa_band_meta_t *bmeta = NULL;  /* metadata of the current band */
+    Espa_band_meta_t vmeta;     /* metadata of the array of the band */
+    Zarr_json_t doc = {NULL, 0, 0, false};  /* current metadata document */
+    Zarr_json_t consolidated = {NULL, 0, 0, false};  /* consolidated
+                                   metadata */
+    int status = ERROR;         /* return status */
+
+    if (options->chunk_lines <= 0 || options->chunk_samps < 0)
+    {
+        sprintf (errmsg, "Invalid chunk shape: %d lines by %d samples",
+            options->chunk_lines, options->chunk_samps);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Initialize the metadata structure */
+    init_metadata_struct (&xml_metadata);
+
+    /* Validate the metadata file and parse it into our internal metadata
+       structure, reading the file only once; also allocates space as needed
+       for various pointers in the global and band metadata */
+    if (validate_and_parse_metadata (espa_xml_file, &xml_metadata) != SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+
+    for (i = 0; i < xml_metadata.nbands; i++)
+    {
+        if (zarr_dtype (xml_metadata.band[i].data_type) == NULL)
+        {
+            sprintf (errmsg, "Unsupported data type for band: %s",
+                xml_metadata.band[i].name);
+            error_handler (true, FUNC_NAME, errmsg);
+            goto cleanup;
+        }
+    }
+
+    if (make_zarr_dir (zarr_dir) != SUCCESS)
+        goto cleanup;
+
+    /* Group and global metadata */
+    zarr_json_printf (&consolidated, "{\"zarr_format_consolidated\": 1, "
+        "\"metadata\": {");
+    zarr_json_printf (&doc, "{\"zarr_format\": 2}");
+    if (put_zarr_document (zarr_dir, ".zgroup", &doc, &consolidated)
+        != SUCCESS)
+        goto cleanup;
+    doc.len = 0;
+    zarr_global_attrs_json (&doc, &xml_metadata);
+    if (put_zarr_document (zarr_dir, ".zattrs", &doc, &consolidated)
+        != SUCCESS)
+        goto cleanup;
+
+    /* Loop through the bands, writing the metadata and then the chunks of
+       each band */
+    for (i = 0; i < xml_metadata.nbands; i++)
+    {
+        bmeta = &xml_metadata.band[i];
+        printf ("Band %s\n", bmeta->name);
+
+        count = snprintf (band_dir, sizeof (band_dir), "%s/%s", zarr_dir,
+            bmeta->name);
+        if (count < 0 || count >= sizeof (band_dir))
+        {
+            sprintf (errmsg, "Overflow of band_dir string");
+            error_handler (true, FUNC_NAME, errmsg);
+            goto cleanup;
+        }
+        if (make_zarr_dir (band_dir) != SUCCESS)
+            goto cleanup;
+
+        count = snprintf (key, sizeof (key), "%s/.zarray", bmeta->name);
+        if (count < 0 || count >= sizeof (key))
+        {
+            sprintf (errmsg, "Overflow of key string");
+            error_handler (true, FUNC_NAME, errmsg);
+            goto cleanup;
+        }
+        doc.len = 0;
+        zarr_band_meta (bmeta, options, &vmeta);
+        zarr_array_json (&doc, &vmeta, 0, 1, options);
+        if (put_zarr_document (zarr_dir, key, &doc, &consolidated)
+            != SUCCESS)
+            goto cleanup;
+
+        snprintf (key, sizeof (key), "%s/.zattrs", bmeta->name);
+        doc.len = 0;
+        zarr_band_attrs_json (&doc, &vmeta, &xml_metadata.band[0], false);
+        if (put_zarr_document (zarr_dir, key, &doc, &consolidated)
+            != SUCCESS)
+            goto cleanup;
+
+        if (write_zarr_band (band_dir, &xml_metadata, i, options) != SUCCESS)
+        {
+            sprintf (errmsg, "Writing the chunks of band: %s", bmeta->name);
+            error_handler (true, FUNC_NAME, errmsg);
+            goto cleanup;
+        }
+    }
+
+    /* Write the consolidated metadata last, so a store with it is
+       complete */
+    zarr_json_printf (&consolidated, "}}");
+    if (consolidated.failed)
+    {
+        sprintf (errmsg, "Allocating memory for the consolidated metadata");
+        error_handler (true, FUNC_NAME, errmsg);
+        goto cleanup;
+    }
+    count = snprintf (key, sizeof (key), "%s/.zmetadata", zarr_dir);
+    if (count < 0 || count >= sizeof (key))
+    {
+        sprintf (errmsg, "Overflow of key string");
+        error_handler (true, FUNC_NAME, errmsg);
+        goto cleanup;
+    }
+    if (write_zarr_file (key, consolidated.text, consolidated.len) != SUCCESS)
+    {
+        sprintf (errmsg, "Writing the consolidated metadata: %s", key);
+        error_handler (true, FUNC_NAME, errmsg);
+        goto cleanup;
+    }
+
+    /* Remove the source files if specified.  Constant bands have none, and
+       a stack of bands is removed with its last band. */
+    if (del_src)
+    {
+        for (i = 0; i < xml_metadata.nbands; i++)
+        {
+            if (is_constant_band (&xml_metadata.band[i]) ||
+                is_shared_band_file (&xml_metadata, i, true))
+                continue;
+            if (remove_zarr_band_source (&xml_metadata.band[i]) != SUCCESS)
+            {
+                sprintf (errmsg, "Removing the source files of band: %s",
+                    xml_metadata.band[i].name);
+                error_handler (true, FUNC_NAME, errmsg);
+                goto cleanup;
+            }
+        }
+
+        printf ("  Removing %s\n", espa_xml_file);
+        if (unlink (espa_xml_file) != 0)
+        {
+            sprintf (errmsg, "Deleting source file: %s", espa_xml_file);
+            error_handler (true, FUNC_NAME, errmsg);
+            goto cleanup;
+        }
+    }
+    status = SUCCESS;
+
+cleanup:
+    free (doc.text);
+    free (consolidated.text);
+    free_metadata (&xml_metadata);
+    return (status);
+}
+
+
+/* Date of a datacube: a product and its acquisition time */
+typedef struct
+{
+    long long seconds;   /* acquisition time, in seconds since 1970-01-01
+                            00:00:00 UTC */
+    int file;            /* index of the product in the XML files */
+} Zarr_cube_date_t;
+
+
+/******************************************************************************
+MODULE:  zarr_product_time
+
+PURPOSE: Determines the acquisition time of a product, in seconds since
+1970-01-01 00:00:00 UTC, from its acquisition date and scene center time.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           The acquisition date or scene center time is not valid
+SUCCESS         Successfully determined the acquisition time
+
+NOTES:
+  1. Products without a scene center time are taken as acquired at
+     midnight.  The fractional seconds of the scene center time are
+     dropped.
+******************************************************************************/
+static int zarr_product_time
+(
+    Espa_global_meta_t *gmeta,   /* I: global metadata of the product */
+    long long *seconds           /* O: acquisition time */
+)
+{
+    int year;                    /* year of the acquisition date */
+    int month;                   /* month of the acquisition date */
+    int day;                     /* day of the acquisition date */
+    int hour = 0;                /* hour of the scene center time */
+    int minute = 0;              /* minute of the scene center time */
+    double second = 0.0;         /* second of the scene center time */
+    long long era;               /* 400 year era of the date */
+    int yoe;                     /* year of the era */
+    int doe;                     /* day of the era */
+    char extra;                  /* character following the date */
+
+    if (sscanf (gmeta->acquisition_date, "%d-%d-%d%c", &year, &month, &day,
+        &extra) != 3 || month < 1 || month > 12 || day < 1 || day > 31)
+        return (ERROR);
+    if (gmeta->scene_center_time[0] != '\0' &&
+        strcmp (gmeta->scene_center_time, ESPA_STRING_META_FILL) != 0 &&
+        (sscanf (gmeta->scene_center_time, "%d:%d:%lf", &hour, &minute,
+        &second) != 3 || hour < 0 || hour > 23 || minute < 0 || minute > 59 ||
+        second < 0.0 || second >= 61.0))
+        return (ERROR);
+
+    /* Days since 1970-01-01 of the proleptic Gregorian calendar, counting
+       the years from March so the leap day ends the year */
+    if (month <= 2)
+        year--;
+    era = (year >= 0 ? year : year - 399) / 400;
+    yoe = year - era * 400;
+    doe = yoe * 365 + yoe / 4 - yoe / 100
+        + (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+    *seconds = ((era * 146097 + doe - 719468) * 24 + hour) * 3600LL
+        + minute * 60 + (int) second;
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  compare_zarr_cube_dates
+
+PURPOSE: Orders the dates of a datacube by their acquisition time, for
+qsort.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+< 0             The first date is earlier
+0               The dates are at the same time
+> 0             The first date is later
+
+NOTES:
+******************************************************************************/
+static int compare_zarr_cube_dates
+(
+    const void *a,       /* I: first date */
+    const void *b        /* I: second date */
+)
+{
+    const Zarr_cube_date_t *date_a = a;  /* first date */
+    const Zarr_cube_date_t *date_b = b;  /* second date */
+
+    if (date_a->seconds != date_b->seconds)
+        return (date_a->seconds < date_b->seconds ? -1 : 1);
+    return (date_a->file - date_b->file);
+}
+
+
+/******************************************************************************
+MODULE:  zarr_same_grid
+
+PURPOSE: Determines whether two products are on the same grid, with the
+same projection and projection corners.
+
+RETURN VALUE:
+Type = bool
+Value           Description
+-----           -----------
+true            The grids are the same
+false           The grids differ
+
+NOTES:
+******************************************************************************/
+static bool zarr_same_grid
+(
+    Espa_proj_meta_t *proj0,   /* I: projection of the first product */
+    Espa_proj_meta_t *proj     /* I: projection of the other product */
+)
+{
+    int i;                     /* looping variable for the values */
+    double values0[13];        /* corners and parameters of proj0 */
+    double values[13];         /* corners and parameters of proj */
+
+    if (proj->proj_type != proj0->proj_type ||
+        proj->datum_type != proj0->datum_type ||
+        proj->utm_zone != proj0->utm_zone ||
+        strcmp (proj->units, proj0->units) != 0 ||
+        strcmp (proj->grid_origin, proj0->grid_origin) != 0)
+        return (false);
+
+    values0[0] = proj0->ul_corner[0];
+    values0[1] = proj0->ul_corner[1];
+    values0[2] = proj0->lr_corner[0];
+    values0[3] = proj0->lr_corner[1];
+    values0[4] = proj0->longitude_pole;
+    values0[5] = proj0->latitude_true_scale;
+    values0[6] = proj0->false_easting;
+    values0[7] = proj0->false_northing;
+    values0[8] = proj0->standard_parallel1;
+    values0[9] = proj0->standard_parallel2;
+    values0[10] = proj0->central_meridian;
+    values0[11] = proj0->origin_latitude;
+    values0[12] = proj0->sphere_radius;
+    values[0] = proj->ul_corner[0];
+    values[1] = proj->ul_corner[1];
+    values[2] = proj->lr_corner[0];
+    values[3] = proj->lr_corner[1];
+    values[4] = proj->longitude_pole;
+    values[5] = proj->latitude_true_scale;
+    values[6] = proj->false_easting;
+    values[7] = proj->false_northing;
+    values[8] = proj->standard_parallel1;
+    values[9] = proj->standard_parallel2;
+    values[10] = proj->central_meridian;
+    values[11] = proj->origin_latitude;
+    values[12] = proj->sphere_radius;
+    for (i = 0; i < 13; i++)
+    {
+        if (fabs (values[i] - values0[i]) > ESPA_EPSILON)
+            return (false);
+    }
+    return (true);
+}
+
+
+/******************************************************************************
+MODULE:  zarr_same_band
+
+PURPOSE: Determines whether a band of a product can be stacked in time with
+the band of the same name of the first product, having the same size, data
+type, pixel size, and packing.
+
+RETURN VALUE:
+Type = bool
+Value           Description
+-----           -----------
+true            The bands can be stacked
+false           The bands differ
+
+NOTES:
+******************************************************************************/
+static bool zarr_same_band
+(
+    Espa_band_meta_t *bmeta0,  /* I: metadata of the band of the first
+                                     product */
+    Espa_band_meta_t *bmeta    /* I: metadata of the band of the other
+                                     product */
+)
+{
+    return (bmeta->nlines == bmeta0->nlines &&
+        bmeta->nsamps == bmeta0->nsamps &&
+        bmeta->data_type == bmeta0->data_type &&
+        bmeta->fill_value == bmeta0->fill_value &&
+        fabs (bmeta->pixel_size[0] - bmeta0->pixel_size[0]) <= ESPA_EPSILON &&
+        fabs (bmeta->pixel_size[1] - bmeta0->pixel_size[1]) <= ESPA_EPSILON &&
+        fabs (bmeta->scale_factor - bmeta0->scale_factor) <= ESPA_EPSILON &&
+        fabs (bmeta->add_offset - bmeta0->add_offset) <= ESPA_EPSILON);
+}
+
+
+/******************************************************************************
+MODULE:  zarr_json_date_list
+
+PURPOSE: Writes a global attribute listing a text field of the global
+metadata of each date of a datacube, in time order.
+
+RETURN VALUE: None
+
+NOTES:
+******************************************************************************/
+static void zarr_json_date_list
+(
+    Zarr_json_t *json,            /* I/O: JSON document */
+    const char *name,             /* I: name of the attribute */
+    Espa_internal_meta_t *metas,  /* I: metadata of each product */
+    Zarr_cube_date_t *dates,      /* I: dates of the datacube */
+    int ntimes,                   /* I: number of dates */
+    size_t field                  /* I: offset of the text field in the
+                                        global metadata */
+)
+{
+    int t;                        /* looping variable for the dates */
+
+    zarr_json_printf (json, ", ");
+    zarr_json_string (json, name);
+    zarr_json_printf (json, ": [");
+    for (t = 0; t < ntimes; t++)
+    {
+        if (t > 0)
+            zarr_json_printf (json, ", ");
+        zarr_json_string (json, (char *) &metas[dates[t].file].global
+            + field);
+    }
+    zarr_json_printf (json, "]");
+}
+
+
+/******************************************************************************
+MODULE:  zarr_cube_attrs_json
+
+PURPOSE: Writes the .zattrs document of the group of a datacube, holding the
+grid of the products and the products of each date.
+
+RETURN VALUE: None
+
+NOTES:
+******************************************************************************/
+static void zarr_cube_attrs_json
+(
+    Zarr_json_t *json,            /* I/O: JSON document */
+    Espa_internal_meta_t *metas,  /* I: metadata of each product */
+    Zarr_cube_date_t *dates,      /* I: dates of the datacube */
+    int ntimes                    /* I: number of dates */
+)
+{
+    Espa_global_meta_t *gmeta = &metas[dates[0].file].global;
+                                  /* global metadata of the first date */
+
+    zarr_json_printf (json, "{\"Conventions\": \"CF-1.6\"");
+    zarr_json_text_attr (json, "DataProvider", gmeta->data_provider);
+    if (gmeta->wrs_path != ESPA_INT_META_FILL)
+        zarr_json_printf (json, ", \"WRS_Path\": %d", gmeta->wrs_path);
+    if (gmeta->wrs_row != ESPA_INT_META_FILL)
+        zarr_json_printf (json, ", \"WRS_Row\": %d", gmeta->wrs_row);
+    zarr_grid_attrs_json (json, gmeta);
+
+    zarr_json_text_attr (json, "TimeCoverageStart",
+        gmeta->acquisition_date);
+    zarr_json_text_attr (json, "TimeCoverageEnd",
+        metas[dates[ntimes - 1].file].global.acquisition_date);
+    zarr_json_date_list (json, "ProductID", metas, dates, ntimes,
+        offsetof (Espa_global_meta_t, product_id));
+    zarr_json_date_list (json, "Satellite", metas, dates, ntimes,
+        offsetof (Espa_global_meta_t, satellite));
+    zarr_json_date_list (json, "Instrument", metas, dates, ntimes,
+        offsetof (Espa_global_meta_t, instrument));
+    zarr_json_date_list (json, "AcquisitionDate", metas, dates, ntimes,
+        offsetof (Espa_global_meta_t, acquisition_date));
+    zarr_json_printf (json, "}");
+}
+
+
+/******************************************************************************
+MODULE:  write_zarr_time
+
+PURPOSE: Writes the time array of a datacube, holding the acquisition time
+of each date as a CF time coordinate.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the time array
+SUCCESS         Successfully wrote the time array
+
+NOTES:
+  1. The times are a single uncompressed chunk of little endian int64
+     seconds.
+******************************************************************************/
+static int write_zarr_time
+(
+    char *zarr_dir,            /* I: Zarr store directory */
+    Zarr_cube_date_t *dates,   /* I: dates of the datacube */
+    int ntimes,                /* I: number of dates */
+    Zarr_json_t *consolidated  /* I/O: consolidated metadata */
+)
+{
+    char FUNC_NAME[] = "write_zarr_time";  /* function name */
+    char errmsg[STR_SIZE];     /* error message */
+    char path[STR_SIZE];       /* name of the time directory and chunk */
+    int t;                     /* looping variable for the dates */
+    int count;                 /* number of chars copied in snprintf */
+    long long *times = NULL;   /* acquisition time of each date */
+    Zarr_json_t doc = {NULL, 0, 0, false};  /* current metadata document */
+    int status = ERROR;        /* return status */
+
+    count = snprintf (path, sizeof (path), "%s/time", zarr_dir);
+    if (count < 0 || count >= sizeof (path) - 2)
+    {
+        sprintf (errmsg, "Overflow of path string");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    if (make_zarr_dir (path) != SUCCESS)
+        return (ERROR);
+
+    zarr_json_printf (&doc, "{\"zarr_format\": 2, \"shape\": [%d], "
+        "\"chunks\": [%d], \"dtype\": \"<i8\", \"order\": \"C\", "
+        "\"dimension_separator\": \".\", \"compressor\": null, "
+        "\"filters\": null, \"fill_value\": null}", ntimes, ntimes);
+    if (put_zarr_document (zarr_dir, "time/.zarray", &doc, consolidated)
+        != SUCCESS)
+        goto cleanup;
+
+    doc.len = 0;
+    zarr_json_printf (&doc, "{\"_ARRAY_DIMENSIONS\": [\"time\"], "
+        "\"standard_name\": \"time\", \"long_name\": \"acquisition time\", "
+        "\"units\": \"seconds since 1970-01-01 00:00:00\", "
+        "\"calendar\": \"standard\", \"axis\": \"T\"}");
+    if (put_zarr_document (zarr_dir, "time/.zattrs", &doc, consolidated)
+        != SUCCESS)
+        goto cleanup;
+
+    times = malloc (ntimes * sizeof (long long));
+    if (times == NULL)
+    {
+        sprintf (errmsg, "Error allocating memory for the times.");
+        error_handler (true, FUNC_NAME, errmsg);
+        goto cleanup;
+    }
+    for (t = 0; t < ntimes; t++)
+        times[t] = dates[t].seconds;
+    strcat (path, "/0");
+    if (write_zarr_file (path, times, ntimes * sizeof (long long))
+        != SUCCESS)
+    {
+        sprintf (errmsg, "Writing the time chunk: %s", path);
+        error_handler (true, FUNC_NAME, errmsg);
+        goto cleanup;
+    }
+    status = SUCCESS;
+
+cleanup:
+    free (times);
+    free (doc.text);
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  write_zarr_cube_band
+
+PURPOSE: Writes the chunks of a band of a datacube, reading the band of each
+date of a chunk in parallel.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the chunks
+SUCCESS         Successfully wrote the chunks
+
+NOTES:
+  1. A band stack is open for each date of the current time chunk, so the
+     bands of those dates are read ahead at the same time.  The blocks hold
+     enough chunk rows for a chunk per thread, so the memory used is about
+     time_chunk dates of those rows.
+  2. The chunks of a block are compressed and written by the threads of the
+     task pool.
+******************************************************************************/
+static int write_zarr_cube_band
+(
+    char *band_dir,                /* I: directory of the band in the store */
+    Espa_internal_meta_t *metas,   /* I: metadata of each product */
+    Zarr_cube_date_t *dates,       /* I: dates of the datacube */
+    int ntimes,                    /* I: number of dates */
+    int *band_index,               /* I: index of the band in the metadata of
+                                         each product */
+    int time_chunk,                /* I: number of dates per chunk */
+    Zarr_options_t *options        /* I: chunking and compression of the
+                                         bands */
+)
+{
+    char FUNC_NAME[] = "write_zarr_cube_band";  /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    int nthreads;               /* number of threads of the task pool */
+    int ncols;                  /* number of chunks across the band */
+    int rows;                   /* number of chunk rows per block */
+    int block_lines;            /* number of lines in a full block */
+    int nchunks;                /* number of chunks in a block */
+    int chunk;                  /* looping variable for the chunks */
+    int nbytes;                 /* number of bytes in the data type */
+    int chunks[2];              /* number of lines and samples in a chunk */
+    int tc;                     /* looping variable for the time chunks */
+    int t;                      /* looping variable for the dates of the
+                                   time chunk */
+    int ntc = 0;                /* number of dates of the time chunk */
+    int file;                   /* product of the current date */
+    size_t block_size;          /* number of values in a full block */
+    size_t chunk_size;          /* number of bytes in an uncompressed chunk */
+    size_t out_size;            /* largest number of bytes of a compressed
+                                   chunk */
+    int *chunk_status = NULL;   /* status of writing each chunk */
+    unsigned char *shuf_buf = NULL;  /* shuffled chunk of each thread */
+    unsigned char *out_buf = NULL;   /* compressed chunk of each thread */
+    float *physical = NULL;     /* physical values of the block of each date;
+                                   NULL if the pixels are written as they
+                                   are */
+    bool unpack;                /* are the physical values written? */
+    const unsigned char *lines[ZARR_MAX_CUBE_TIME_CHUNK];  /* block of lines
+                                   of each date */
+    Espa_band_stack_t *stacks[ZARR_MAX_CUBE_TIME_CHUNK];  /* reader of the
+                                   band of each date */
+    Zarr_chunk_block_t blk;     /* block whose chunks are written */
+    Espa_band_meta_t *bmeta;    /* metadata of the band of the first date */
+    Espa_band_meta_t *tmeta;    /* metadata of the band of a date */
+    Espa_band_meta_t vmeta;     /* metadata of the band array */
+    Espa_band_block_t *block = NULL; /* current block of lines of a date */
+    int status = ERROR;         /* return status */
+
+    for (t = 0; t < time_chunk; t++)
+        stacks[t] = NULL;
+
+    bmeta = &metas[dates[0].file].band[band_index[dates[0].file]];
+    nthreads = espa_task_pool_threads ();
+    unpack = zarr_band_meta (bmeta, options, &vmeta);
+    nbytes = espa_data_type_size (vmeta.data_type);
+    zarr_chunk_shape (bmeta, options, chunks);
+    ncols = (bmeta->nsamps + chunks[1] - 1) / chunks[1];
+    rows = (nthreads + ncols - 1) / ncols;
+    block_lines = chunks[0] * rows;
+    if (block_lines > bmeta->nlines)
+        block_lines = bmeta->nlines;
+    block_size = (size_t) block_lines * bmeta->nsamps;
+    nchunks = (block_lines + chunks[0] - 1) / chunks[0] * ncols;
+    chunk_size = (size_t) time_chunk * chunks[0] * chunks[1] * nbytes;
+    out_size = chunk_size;
+    if (options->compressor == ZARR_COMPRESS_ZLIB)
+        out_size = compressBound (chunk_size);
+#ifdef HAVE_ZSTD
+    if (options->compressor == ZARR_COMPRESS_ZSTD)
+        out_size = ZSTD_compressBound (chunk_size);
+#endif
+
+    shuf_buf = espa_buffer_get ((size_t) nthreads * chunk_size);
+    out_buf = espa_buffer_get ((size_t) nthreads * out_size);
+    chunk_status = malloc (nchunks * sizeof (int));
+    if (unpack)
+        physical = espa_buffer_get ((size_t) time_chunk * block_size
+            * sizeof (float));
+    if (shuf_buf == NULL || out_buf == NULL || chunk_status == NULL ||
+        (unpack && physical == NULL))
+    {
+        sprintf (errmsg, "Error allocating memory for the chunk buffers.");
+        error_handler (true, FUNC_NAME, errmsg);
+        goto cleanup;
+    }
+
+    blk.band_dir = band_dir;
+    blk.lines = lines;
+    blk.chunk_times = time_chunk;
+    blk.nsamps = bmeta->nsamps;
+    blk.ncols = ncols;
+    blk.nbytes = nbytes;
+    blk.chunks = chunks;
+    blk.options = options;
+    blk.chunk_size = chunk_size;
+    blk.shuf_buf = shuf_buf;
+    blk.out_buf = out_buf;
+    blk.out_size = out_size;
+    blk.chunk_status = chunk_status;
+    for (tc = 0; tc * time_chunk < ntimes; tc++)
+    {
+        /* Open the band of each date of the time chunk; each stack reads
+           ahead in the background */
+        ntc = ntimes - tc * time_chunk;
+        if (ntc > time_chunk)
+            ntc = time_chunk;
+        for (t = 0; t < ntc; t++)
+        {
+            file = dates[tc * time_chunk + t].file;
+            stacks[t] = open_band_stack (&metas[file], 1, &band_index[file],
+                block_lines, 0);
+            if (stacks[t] == NULL)
+            {
+                sprintf (errmsg, "Opening the band stack for band %s of "
+                    "product %s", bmeta->name,
+                    metas[file].global.product_id);
+                error_handler (true, FUNC_NAME, errmsg);
+                goto cleanup;
+            }
+
+            /* The metadata of the products isn't written back */
+            skip_band_stack_stats (stacks[t]);
+        }
+
+        blk.ntimes = ntc;
+        blk.time_chunk = tc;
+        while (1)
+        {
+            for (t = 0; t < ntc; t++)
+            {
+                if (get_band_stack_block (stacks[t], &block) != SUCCESS)
+                {
+                    sprintf (errmsg, "Reading image data from the raw "
+                        "binary file");
+                    error_handler (true, FUNC_NAME, errmsg);
+                    goto cleanup;
+                }
+                if (block == NULL)
+                    break;
+
+                /* The bands of all the dates have the same size, so their
+                   blocks are of the same lines */
+                lines[t] = block->band_buf[0];
+                blk.line0 = block->line0;
+                blk.nlines = block->nlines;
+                if (unpack)
+                {
+                    file = dates[tc * time_chunk + t].file;
+                    tmeta = &metas[file].band[band_index[file]];
+                    espa_cf_unpack (tmeta, block->band_buf[0],
+                        (long) block->nlines * bmeta->nsamps,
+                        physical + t * block_size);
+                    lines[t] = (const unsigned char *)
+                        (physical + t * block_size);
+                }
+            }
+            if (block == NULL)
+                break;
+
+            /* The workers of the loop never outnumber the threads of the
+               pool, so each has its own buffers */
+            nchunks = (blk.nlines + chunks[0] - 1) / chunks[0] * ncols;
+            espa_parallel_for (nchunks, nthreads, write_zarr_block_chunk,
+                &blk);
+
+            for (chunk = 0; chunk < nchunks; chunk++)
+            {
+                if (chunk_status[chunk] != SUCCESS)
+                {
+                    sprintf (errmsg, "Compressing and writing chunk "
+                        "%d.%d.%d of band: %s", tc,
+                        blk.line0 / chunks[0] + chunk / ncols,
+                        chunk % ncols, bmeta->name);
+                    error_handler (true, FUNC_NAME, errmsg);
+                    goto cleanup;
+                }
+            }
+        }
+
+        for (t = 0; t < ntc; t++)
+        {
+            close_band_stack (stacks[t]);
+            stacks[t] = NULL;
+        }
+    }
+    status = SUCCESS;
+
+cleanup:
+    for (t = 0; t < time_chunk; t++)
+        close_band_stack (stacks[t]);
+    espa_buffer_put (shuf_buf);
+    espa_buffer_put (out_buf);
+    espa_buffer_put (physical);
+    free (chunk_status);
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  convert_espa_to_zarr_cube
+
+PURPOSE: Stacks the internal ESPA raw binary products on the same grid into
+a Zarr datacube, with a chunked and compressed (time, y, x) array per band.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error building the datacube
+SUCCESS         Successfully built the datacube
+
+NOTES:
+  1. Every product must be on the grid of the first, with the same
+     projection and corners, and have each band of the first, with the same
+     size, data type, and packing.  Products are ordered by their
+     acquisition time, which no two may share.
+  2. The date bands (data units of date; see generate_date_bands) are
+     constant over each product, so they are folded into the time array
+     rather than written.
+  3. The global attributes describe the grid, and list the product ID,
+     satellite, instrument, and acquisition date of each date.  The band
+     attributes are those of the first date.
+  4. Existing files of the same names in the store are overwritten.
+******************************************************************************/
+int convert_espa_to_zarr_cube
+(
+    char **espa_xml_files, /* I: input ESPA XML metadata filenames, of
+                                 products on the same grid */
+    int nfiles,            /* I: number of XML metadata files */
+    char *zarr_dir,        /* I: output Zarr store directory */
+    int time_chunk,        /* I: number of dates per chunk */
+    Zarr_options_t *options  /* I: chunking and compression of the bands */
+)
+{
+    char FUNC_NAME[] = "convert_espa_to_zarr_cube";  /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    char key[STR_SIZE];         /* name of a document in the store */
+    char band_dir[STR_SIZE];    /* directory of the band in the store */
+    int i;                      /* looping variable for the products */
+    int b;                      /* looping variable for the bands */
+    int t;                      /* looping variable for the dates */
+    int j;                      /* looping variable for the bands of a
+                                   product */
+    int count;                  /* number of chars copied in snprintf */
+    int nparsed = 0;            /* number of products parsed */
+    int nbands = 0;             /* number of bands of the datacube */
+    Espa_internal_meta_t *metas = NULL;  /* metadata of each product */
+    Espa_internal_meta_t *meta0 = NULL;  /* metadata of the first date */
+    Espa_internal_meta_t *meta = NULL;   /* metadata of a later date */
+    Zarr_cube_date_t *dates = NULL;  /* dates of the datacube */
+    int *cube_bands = NULL;     /* index in the first date of each band of
+                                   the datacube */
+    int *band_index = NULL;     /* index of each band of the datacube in
+                                   each product, by band then product */
+    Espa_band_meta_t *bmeta = NULL;  /* metadata of the current band */
+    Espa_band_meta_t vmeta;     /* metadata of the array of the band */
+    Zarr_json_t doc = {NULL, 0, 0, false};  /* current metadata document */
+    Zarr_json_t consolidated = {NULL, 0, 0, false};  /* consolidated
+                                   metadata */
+    int status = ERROR;         /* return status */
+
+    if (options->chunk_lines <= 0 || options->chunk_samps < 0)
+    {
+        sprintf (errmsg, "Invalid chunk shape: %d lines by %d samples",
+            options->chunk_lines, options->chunk_samps);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    if (time_chunk < 1 || time_chunk > ZARR_MAX_CUBE_TIME_CHUNK)
+    {
+        sprintf (errmsg, "Invalid number of dates per chunk: %d (1 to %d)",
+            time_chunk, ZARR_MAX_CUBE_TIME_CHUNK);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    if (nfiles < 1)
+    {
+        sprintf (errmsg, "No products to build the datacube from");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    if (time_chunk > nfiles)
+        time_chunk = nfiles;
+
+    metas = malloc (nfiles * sizeof (Espa_internal_meta_t));
+    dates = malloc (nfiles * sizeof (Zarr_cube_date_t));
+    if (metas == NULL || dates == NULL)
+    {
+        sprintf (errmsg, "Error allocating memory for the metadata of the "
+            "products.");
+        error_handler (true, FUNC_NAME, errmsg);
+        goto cleanup;
+    }
+
+    /* Parse the metadata of each product and determine its date */
+    for (i = 0; i < nfiles; i++)
+    {
+        init_metadata_struct (&metas[i]);
+        if (validate_and_parse_metadata (espa_xml_files[i], &metas[i])
+            != SUCCESS)
+        {  /* Error messages already written */
+            goto cleanup;
+        }
+        nparsed++;
+
+        dates[i].file = i;
+        if (zarr_product_time (&metas[i].global, &dates[i].seconds)
+            != SUCCESS)
+        {
+            sprintf (errmsg, "Invalid acquisition date %s or scene center "
+                "time %s of %s", metas[i].global.acquisition_date,
+                metas[i].global.scene_center_time, espa_xml_files[i]);
+            error_handler (true, FUNC_NAME, errmsg);
+            goto cleanup;
+        }
+    }
+
+    qsort (dates, nfiles, sizeof (Zarr_cube_date_t),
+        compare_zarr_cube_dates);
+    for (t = 1; t < nfiles; t++)
+    {
+        if (dates[t].seconds == dates[t-1].seconds)
+        {
+            sprintf (errmsg, "Products %s and %s have the same acquisition "
+                "time", espa_xml_files[dates[t-1].file],
+                espa_xml_files[dates[t].file]);
+            error_handler (true, FUNC_NAME, errmsg);
+            goto cleanup;
+        }
+    }
+    meta0 = &metas[dates[0].file];
+
+    /* The bands of the datacube are the bands of the first date, other
+       than its date bands */
+    cube_bands = malloc (meta0->nbands * sizeof (int));
+    band_index = malloc ((size_t) meta0->nbands * nfiles * sizeof (int));
+    if (cube_bands == NULL || band_index == NULL)
+    {
+        sprintf (errmsg, "Error allocating memory for the band indices.");
+        error_handler (true, FUNC_NAME, errmsg);
+        goto cleanup;
+    }
+    for (j = 0; j < meta0->nbands; j++)
+    {
+        if (!strcmp (meta0->band[j].data_units, "date"))
+            continue;
+        if (zarr_dtype (meta0->band[j].data_type) == NULL)
+        {
+            sprintf (errmsg, "Unsupported data type for band: %s",
+                meta0->band[j].name);
+            error_handler (true, FUNC_NAME, errmsg);
+            goto cleanup;
+        }
+        cube_bands[nbands++] = j;
+    }
+    if (nbands == 0)
+    {
+        sprintf (errmsg, "No bands other than the date bands in %s",
+            espa_xml_files[dates[0].file]);
+        error_handler (true, FUNC_NAME, errmsg);
+        goto cleanup;
+    }
+
+    /* Verify each product is aligned with the first date, and find its
+       bands of the datacube */
+    for (t = 0; t < nfiles; t++)
+    {
+        i = dates[t].file;
+        meta = &metas[i];
+        if (!zarr_same_grid (&meta0->global.proj_info,
+            &meta->global.proj_info))
+        {
+            sprintf (errmsg, "Product %s is not on the grid of %s",
+                espa_xml_files[i], espa_xml_files[dates[0].file]);
+            error_handler (true, FUNC_NAME, errmsg);
+            goto cleanup;
+        }
+
+        for (b = 0; b < nbands; b++)
+        {
+            bmeta = &meta0->band[cube_bands[b]];
+            j = espa_find_band (meta, bmeta->name);
+            if (j < 0)
+            {
+                sprintf (errmsg, "Band %s is missing from %s", bmeta->name,
+                    espa_xml_files[i]);
+                error_handler (true, FUNC_NAME, errmsg);
+                goto cleanup;
+            }
+            if (!zarr_same_band (bmeta, &meta->band[j]))
+            {
+                sprintf (errmsg, "Band %s of %s differs in size, data type, "
+                    "pixel size, or packing from the band of %s",
+                    bmeta->name, espa_xml_files[i],
+                    espa_xml_files[dates[0].file]);
+                error_handler (true, FUNC_NAME, errmsg);
+                goto cleanup;
+            }
+            band_index[b * nfiles + i] = j;
+        }
+    }
+
+    if (make_zarr_dir (zarr_dir) != SUCCESS)
+        goto cleanup;
+
+    /* Group, global metadata, and the time coordinate */
+    zarr_json_printf (&consolidated, "{\"zarr_format_consolidated\": 1, "
+        "\"metadata\": {");
+    zarr_json_printf (&doc, "{\"zarr_format\": 2}");
+    if (put_zarr_document (zarr_dir, ".zgroup", &doc, &consolidated)
+        != SUCCESS)
+        goto cleanup;
+    doc.len = 0;
+    zarr_cube_attrs_json (&doc, metas, dates, nfiles);
+    if (put_zarr_document (zarr_dir, ".zattrs", &doc, &consolidated)
+        != SUCCESS)
+        goto cleanup;
+    if (write_zarr_time (zarr_dir, dates, nfiles, &consolidated) != SUCCESS)
+        goto cleanup;
+
+    /* Loop through the bands, writing the metadata and then the chunks of
+       each band */
+    for (b = 0; b < nbands; b++)
+    {
+        bmeta = &meta0->band[cube_bands[b]];
+        printf ("Band %s\n", bmeta->name);
+
+        count = snprintf (band_dir, sizeof (band_dir), "%s/%s", zarr_dir,
+            bmeta->name);
+        if (count < 0 || count >= sizeof (band_dir))
+        {
+            sprintf (errmsg, "Overflow of band_dir string");
+            error_handler (true, FUNC_NAME, errmsg);
+            goto cleanup;
+        }
+        if (make_zarr_dir (band_dir) != SUCCESS)
+            goto cleanup;
+
+        count = snprintf (key, sizeof (key), "%s/.zarray", bmeta->name);
+        if (count < 0 || count >= sizeof (key))
+        {
+            sprintf (errmsg, "Overflow of key string");
+            error_handler (true, FUNC_NAME, errmsg);
+            goto cleanup;
+        }
+        doc.len = 0;
+        zarr_band_meta (bmeta, options, &vmeta);
+        zarr_array_json (&doc, &vmeta, nfiles, time_chunk, options);
+        if (put_zarr_document (zarr_dir, key, &doc, &consolidated)
+            != SUCCESS)
+            goto cleanup;
+
+        snprintf (key, sizeof (key), "%s/.zattrs", bmeta->name);
+        doc.len = 0;
+        zarr_band_attrs_json (&doc, &vmeta, &meta0->band[cube_bands[0]],
+            true);
+        if (put_zarr_document (zarr_dir, key, &doc, &consolidated)
+            != SUCCESS)
+            goto cleanup;
+
+        if (write_zarr_cube_band (band_dir, metas, dates, nfiles,
+            &band_index[b * nfiles], time_chunk, options) != SUCCESS)
+        {
+            sprintf (errmsg, "Writing the chunks of band: %s", bmeta->name);
+            error_handler (true, FUNC_NAME, errmsg);
+            goto cleanup;
+        }
+    }
+
+    /* Write the consolidated metadata last, so a store with it is
+       complete */
+    zarr_json_printf (&consolidated, "}}");
+    if (consolidated.failed)
+    {
+        sprintf (errmsg, "Allocating memory for the consolidated metadata");
+        error_handler (true, FUNC_NAME, errmsg);
+        goto cleanup;
+    }
+    count = snprintf (key, sizeof (key), "%s/.zmetadata", zarr_dir);
+    if (count < 0 || count >= sizeof (key))
+    {
+        sprintf (errmsg, "Overflow of key string");
+        error_handler (true, FUNC_NAME, errmsg);
+        goto cleanup;
+    }
+    if (write_zarr_file (key, consolidated.text, consolidated.len) != SUCCESS)
+    {
+        sprintf (errmsg, "Writing the consolidated metadata: %s", key);
+        error_handler (true, FUNC_NAME, errmsg);
+        goto cleanup;
+    }
+    status = SUCCESS;
+
+cleanup:
+    free (doc.text);
+    free (consolidated.text);
+    for (i = 0; i < nparsed; i++)
+        free_metadata (&metas[i]);
+    free (metas);
+    free (dates);
+    free (cube_bands);
+    free (band_index);
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  zarr_json_base64
+
+PURPOSE: Appends bytes to a JSON document as base64 text.
+
+RETURN VALUE: None
+******************************************************************************/
+static void zarr_json_base64
+(
+    Zarr_json_t *json,   /* I/O: JSON document */
+    const unsigned char *buf,  /* I: bytes to be appended */
+    size_t nbytes        /* I: number of bytes in buf */
+)
+{
+    static const char digits[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+        "abcdefghijklmnopqrstuvwxyz0123456789+/";  /* base64 digits */
+    size_t i;            /* looping variable for each group of bytes */
+    unsigned long group; /* 24 bits of a group of three bytes */
+
+    for (i = 0; i < nbytes; i += 3)
+    {
+        group = (unsigned long) buf[i] << 16;
+        if (i + 1 < nbytes)
+            group |= (unsigned long) buf[i+1] << 8;
+        if (i + 2 < nbytes)
+            group |= buf[i+2];
+        zarr_json_printf (json, "%c%c%c%c", digits[(group >> 18) & 0x3f],
+            digits[(group >> 12) & 0x3f],
+            i + 1 < nbytes ? digits[(group >> 6) & 0x3f] : '=',
+            i + 2 < nbytes ? digits[group & 0x3f] : '=');
+    }
+}
+
+
+/******************************************************************************
+MODULE:  zarr_refs_document
+
+PURPOSE: Adds a metadata document to a set of references, as the JSON text
+of the document.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error allocating the document
+SUCCESS         Successfully added the document
+******************************************************************************/
+static int zarr_refs_document
+(
+    Zarr_json_t *refs,   /* I/O: references */
+    const char *key,     /* I: name of the document in the store */
+    Zarr_json_t *doc     /* I: JSON document */
+)
+{
+    char FUNC_NAME[] = "zarr_refs_document";  /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+
+    if (doc->failed)
+    {
+        sprintf (errmsg, "Allocating memory for the metadata document %s",
+            key);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Documents follow the opening of the refs object, separated by
+       commas */
+    if (!refs->failed && refs->text[refs->len - 1] != '{')
+        zarr_json_printf (refs, ",");
+    zarr_json_printf (refs, "\n  ");
+    zarr_json_string (refs, key);
+    zarr_json_printf (refs, ": ");
+    zarr_json_string (refs, doc->text);
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  zarr_refs_chunk_lines
+
+PURPOSE: Determines the number of lines in the chunks of a plain raw binary
+band: the most lines which divide the band evenly and fit in
+ZARR_REFS_CHUNK_BYTES.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+n               Number of lines per chunk
+
+NOTES:
+  1. A chunk of a Zarr array without a compressor has to hold the full
+     chunk, so the chunks divide the band evenly rather than leaving a
+     shorter last chunk, which would read past the band.
+******************************************************************************/
+static int zarr_refs_chunk_lines
+(
+    Espa_band_meta_t *bmeta    /* I: metadata of the band */
+)
+{
+    size_t line_bytes;         /* number of bytes in a line */
+    int chunk_lines;           /* number of lines per chunk */
+
+    line_bytes = (size_t) bmeta->nsamps *
+        espa_data_type_size (bmeta->data_type);
+    chunk_lines = ZARR_REFS_CHUNK_BYTES / line_bytes;
+    if (chunk_lines > bmeta->nlines)
+        chunk_lines = bmeta->nlines;
+    while (chunk_lines > 1 && bmeta->nlines % chunk_lines != 0)
+        chunk_lines--;
+    if (chunk_lines < 1)
+        chunk_lines = 1;
+    return (chunk_lines);
+}
+
+
+/******************************************************************************
+MODULE:  zarr_refs_array_json
+
+PURPOSE: Writes the .zarray document of a band of a set of references,
+describing the chunks as they are laid out in the band file.
+
+RETURN VALUE: None
+******************************************************************************/
+static void zarr_refs_array_json
+(
+    Zarr_json_t *json,         /* I/O: JSON document */
+    Espa_band_meta_t *bmeta,   /* I: metadata of the band */
+    int chunk_lines,           /* I: number of lines per chunk */
+    int chunk_samps,           /* I: number of samples per chunk */
+    Raw_binary_encoding_t encoding  /* I: encoding of the band file */
+)
+{
+    zarr_json_printf (json, "{\"zarr_format\": 2, \"shape\": [%d, %d], "
+        "\"chunks\": [%d, %d], \"dtype\": \"%s\", \"order\": \"C\", "
+        "\"dimension_separator\": \".\", \"compressor\": ", bmeta->nlines,
+        bmeta->nsamps, chunk_lines, chunk_samps,
+        zarr_dtype (bmeta->data_type));
+    if (encoding == RB_ENCODING_ZLIB_BLOCKS)
+        zarr_json_printf (json, "{\"id\": \"zlib\", \"level\": %d}",
+            RB_BLOCKS_ZLIB_LEVEL);
+    else if (encoding == RB_ENCODING_ZSTD_BLOCKS)
+        zarr_json_printf (json, "{\"id\": \"zstd\", \"level\": %d}",
+            RB_BLOCKS_ZSTD_LEVEL);
+    else
+        zarr_json_printf (json, "null");
+
+    if (bmeta->fill_value != ESPA_INT_META_FILL)
+        zarr_json_printf (json, ", \"filters\": null, \"fill_value\": %ld}",
+            bmeta->fill_value);
+    else
+        zarr_json_printf (json, ", \"filters\": null, \"fill_value\": null}");
+}
+
+
+/******************************************************************************
+MODULE:  zarr_refs_last_block
+
+PURPOSE: Adds the last block of a block-compressed band, which holds fewer
+lines than the others, to a set of references, padded to a full block and
+compressed again, as inline base64 data.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error reading or compressing the block
+SUCCESS         Successfully added the block
+
+NOTES:
+  1. Zarr expects every chunk to hold the full chunk shape, so the shorter
+     last block can't be referenced in place.
+******************************************************************************/
+static int zarr_refs_last_block
+(
+    Zarr_json_t *refs,         /* I/O: references */
+    int fd,                    /* I: file descriptor of the band file */
+    Espa_band_meta_t *bmeta,   /* I: metadata of the band */
+    Rb_blocks_header_t *hdr    /* I: header of the band file */
+)
+{
+    char FUNC_NAME[] = "zarr_refs_last_block";  /* function name */
+    char errmsg[STR_SIZE];     /* error message */
+    int block = hdr->nblocks - 1;  /* last block */
+    int line0 = block * hdr->block_lines;  /* first line of the block */
+    size_t block_bytes;        /* number of bytes in a full block */
+    size_t comp_bytes;         /* number of bytes in the compressed block */
+    uLongf dest_len;           /* number of bytes compressed by zlib */
+    char *lines = NULL;        /* lines of the block, padded */
+    char *comp = NULL;         /* compressed block */
+    int status = ERROR;        /* return status */
+
+    block_bytes = (size_t) hdr->block_lines * hdr->nsamps * hdr->size;
+    comp_bytes = compressBound (block_bytes);
+#ifdef HAVE_ZSTD
+    if (ZSTD_compressBound (block_bytes) > comp_bytes)
+        comp_bytes = ZSTD_compressBound (block_bytes);
+#endif
+    lines = calloc (block_bytes, 1);
+    comp = malloc (comp_bytes);
+    if (lines == NULL || comp == NULL)
+    {
+        sprintf (errmsg, "Allocating the last block of band %s",
+            bmeta->name);
+        error_handler (true, FUNC_NAME, errmsg);
+        goto cleanup;
+    }
+
+    if (read_raw_binary_window (fd, bmeta->nsamps, line0,
+        bmeta->nlines - line0, 0, bmeta->nsamps, hdr->size, lines)
+        != SUCCESS)
+    {
+        sprintf (errmsg, "Reading the last block of band %s", bmeta->name);
+        error_handler (true, FUNC_NAME, errmsg);
+        goto cleanup;
+    }
+
+    if (hdr->encoding == RB_ENCODING_ZLIB_BLOCKS)
+    {
+        dest_len = comp_bytes;
+        if (compress2 ((Bytef *) comp, &dest_len, (const Bytef *) lines,
+            block_bytes, RB_BLOCKS_ZLIB_LEVEL) != Z_OK)
+            dest_len = 0;
+        comp_bytes = dest_len;
+    }
+#ifdef HAVE_ZSTD
+    else
+    {
+        comp_bytes = ZSTD_compress (comp, comp_bytes, lines, block_bytes,
+            RB_BLOCKS_ZSTD_LEVEL);
+        if (ZSTD_isError (comp_bytes))
+            comp_bytes = 0;
+    }
+#else
+    else
+        comp_bytes = 0;
+#endif
+    if (comp_bytes == 0)
+    {
+        sprintf (errmsg, "Compressing the last block of band %s",
+            bmeta->name);
+        error_handler (true, FUNC_NAME, errmsg);
+        goto cleanup;
+    }
+
+    zarr_json_printf (refs, ",\n  \"%s/%d.0\": \"base64:", bmeta->name,
+        block);
+    zarr_json_base64 (refs, (unsigned char *) comp, comp_bytes);
+    zarr_json_printf (refs, "\"");
+    status = SUCCESS;
+
+cleanup:
+    free (lines);
+    free (comp);
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  zarr_refs_band
+
+PURPOSE: Adds the .zarray and .zattrs documents of a band, and the byte
+ranges of its chunks, to a set of references.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error reading the layout of the band file
+SUCCESS         Successfully added the band
+
+NOTES:
+  1. A plain raw binary band is referenced in chunks of whole lines (see
+     zarr_refs_chunk_lines), at the offset of the band in its file.
+  2. A tiled band is referenced a tile at a time, since the tiles are padded
+     to the full tile past the edges of the band, as Zarr chunks are.
+  3. A block-compressed band is referenced a block at a time, through the
+     index of the blocks, with the compressor of its encoding.
+  4. Bit-packed and run-length encoded blocks have no Zarr codec, so those
+     bands can't be referenced.
+******************************************************************************/
+static int zarr_refs_band
+(
+    Zarr_json_t *refs,         /* I/O: references */
+    char *espa_xml_file,       /* I: input ESPA XML metadata filename */
+    Espa_internal_meta_t *xml_metadata, /* I: XML metadata structure */
+    int band,                  /* I: band to be added */
+    char *href                 /* I: URL of the band file */
+)
+{
+    char FUNC_NAME[] = "zarr_refs_band";  /* function name */
+    char errmsg[STR_SIZE];     /* error message */
+    char key[STR_SIZE];        /* name of a document in the store */
+    char path[PATH_MAX];       /* local name of the band file */
+    Espa_band_meta_t *bmeta = &xml_metadata->band[band];
+                               /* metadata of the band */
+    Raw_binary_blocks_t *blocks = NULL;  /* reader of an encoded band */
+    Rb_blocks_header_t *hdr = NULL;  /* header of an encoded band */
+    Raw_binary_encoding_t encoding = RB_ENCODING_RAW;  /* encoding of the
+                                  band file */
+    Zarr_json_t doc = {NULL, 0, 0, false};  /* current metadata document */
+    int size;                  /* number of bytes per pixel */
+    int chunk_lines;           /* number of lines per chunk */
+    int chunk_samps;           /* number of samples per chunk */
+    int nchunks;               /* number of chunks (or tiles) */
+    int ntiles_across;         /* number of tiles across a row of tiles */
+    int c;                     /* looping variable for the chunks */
+    int fd = -1;               /* file descriptor of an encoded band */
+    off_t offset;              /* file offset of a chunk */
+    size_t nbytes;             /* number of bytes in a chunk */
+    int status = ERROR;        /* return status */
+
+    size = espa_data_type_size (bmeta->data_type);
+    chunk_samps = bmeta->nsamps;
+
+    /* The layout of an encoded band is in the header of its file */
+    if ((strcmp (bmeta->encoding, ESPA_STRING_META_FILL) &&
+        strcmp (bmeta->encoding, RB_ENCODING_RAW_NAME)) ||
+        bmeta->tile_size > 0)
+    {
+        if (espa_product_href (espa_xml_file, NULL, NULL, bmeta->file_name,
+            path, sizeof (path)) != SUCCESS)
+            goto cleanup;
+        fd = open_raw_binary_fd (path, false);
+        if (fd < 0)
+        {
+            snprintf (errmsg, sizeof (errmsg), "Opening the band file: %s",
+                path);
+            error_handler (true, FUNC_NAME, errmsg);
+            goto cleanup;
+        }
+        blocks = get_raw_binary_blocks (fd);
+        if (blocks != NULL)
+        {
+            hdr = &blocks->header;
+            encoding = hdr->encoding;
+            if (hdr->nlines != bmeta->nlines || hdr->nsamps != bmeta->nsamps
+                || hdr->size != size)
+            {
+                snprintf (errmsg, sizeof (errmsg), "The header of %s doesn't "
+                    "match the metadata of band %s", path, bmeta->name);
+                error_handler (true, FUNC_NAME, errmsg);
+                goto cleanup;
+            }
+            if (encoding == RB_ENCODING_BITPACKED_BLOCKS ||
+                encoding == RB_ENCODING_RLE_BLOCKS)
+            {
+                snprintf (errmsg, sizeof (errmsg), "Band %s is %s encoded, "
+                    "which Zarr can't decode, so it can't be referenced",
+                    bmeta->name, raw_binary_encoding_name (encoding));
+                error_handler (true, FUNC_NAME, errmsg);
+                goto cleanup;
+            }
+        }
+    }
+
+    if (encoding == RB_ENCODING_RAW)
+        chunk_lines = zarr_refs_chunk_lines (bmeta);
+    else if (encoding == RB_ENCODING_RAW_TILES)
+        chunk_lines = chunk_samps = hdr->block_lines;
+    else
+        chunk_lines = hdr->block_lines;
+
+    /* Metadata documents of the band */
+    snprintf (key, sizeof (key), "%s/.zarray", bmeta->name);
+    zarr_refs_array_json (&doc, bmeta, chunk_lines, chunk_samps, encoding);
+    if (zarr_refs_document (refs, key, &doc) != SUCCESS)
+        goto cleanup;
+    snprintf (key, sizeof (key), "%s/.zattrs", bmeta->name);
+    doc.len = 0;
+    zarr_band_attrs_json (&doc, bmeta, &xml_metadata->band[0], false);
+    if (zarr_refs_document (refs, key, &doc) != SUCCESS)
+        goto cleanup;
+
+    /* Byte ranges of the chunks */
+    if (encoding == RB_ENCODING_RAW)
+    {
+        nbytes = (size_t) chunk_lines * chunk_samps * size;
+        nchunks = bmeta->nlines / chunk_lines;
+        for (c = 0; c < nchunks; c++)
+        {
+            offset = bmeta->file_offset + (off_t) c * nbytes;
+            zarr_json_printf (refs, ",\n  \"%s/%d.0\": [", bmeta->name, c);
+            zarr_json_string (refs, href);
+            zarr_json_printf (refs, ", %lld, %zu]", (long long) offset,
+                nbytes);
+        }
+    }
+    else if (encoding == RB_ENCODING_RAW_TILES)
+    {
+        nbytes = (size_t) chunk_lines * chunk_samps * size;
+        ntiles_across = (bmeta->nsamps + chunk_samps - 1) / chunk_samps;
+        for (c = 0; c < hdr->nblocks; c++)
+        {
+            offset = hdr->index_offset + (off_t) c * nbytes;
+            zarr_json_printf (refs, ",\n  \"%s/%d.%d\": [", bmeta->name,
+                c / ntiles_across, c % ntiles_across);
+            zarr_json_string (refs, href);
+            zarr_json_printf (refs, ", %lld, %zu]", (long long) offset,
+                nbytes);
+        }
+    }
+    else
+    {
+        /* A shorter last block is inlined, padded to a full block */
+        nchunks = hdr->nblocks;
+        if (bmeta->nlines % chunk_lines != 0)
+            nchunks--;
+        for (c = 0; c < nchunks; c++)
+        {
+            zarr_json_printf (refs, ",\n  \"%s/%d.0\": [", bmeta->name, c);
+            zarr_json_string (refs, href);
+            zarr_json_printf (refs, ", %llu, %llu]",
+                (unsigned long long) blocks->index[c].offset,
+                (unsigned long long) blocks->index[c].nbytes);
+        }
+        if (nchunks < hdr->nblocks &&
+            zarr_refs_last_block (refs, fd, bmeta, hdr) != SUCCESS)
+            goto cleanup;
+    }
+    status = SUCCESS;
+
+cleanup:
+    free (doc.text);
+    if (fd >= 0)
+        close_raw_binary_fd (fd);
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  convert_espa_to_zarr_refs
+
+PURPOSE: Writes a set of references describing the ESPA raw binary bands as
+a Zarr store, so cloud readers fetch windows of the bands with byte range
+requests, without any of the bands being converted.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the references
+SUCCESS         Successfully wrote the references
+
+NOTES:
+  1. The references follow the kerchunk (fsspec reference filesystem)
+     version 1 format: each metadata document of the store is given as its
+     JSON text, and each chunk as the URL, offset, and length of its bytes.
+     The store has the metadata documents of convert_espa_to_zarr.
+  2. The bands are named by their URL under href_base, or by the absolute
+     path of the band files when no base URL is given.
+  3. Constant bands have no file, so they are left out with a warning.
+     So are bands in shared memory (see espa_shm.h), whose shm: names
+     aren't URLs and whose segments are removed once the bands are
+     persisted; run espa_persist_bands first to reference them.
+  4. The byte order of the bands is taken to be little endian, as the
+     platforms ESPA runs on write them.
+******************************************************************************/
+int convert_espa_to_zarr_refs
+(
+    char *espa_xml_file,   /* I: input ESPA XML metadata filename */
+    char *refs_file,       /* I: output references (JSON) filename */
+    char *href_base        /* I: base URL the band files are served from;
+                                 NULL for their local paths */
+)
+{
+    char FUNC_NAME[] = "convert_espa_to_zarr_refs";  /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    char href[PATH_MAX];        /* URL of the band file */
+    int i;                      /* looping variable for each band */
+    Espa_internal_meta_t xml_metadata;  /* XML metadata structure to be
+                                   populated by reading the input XML metadata
+                                   file */
+    Zarr_json_t doc = {NULL, 0, 0, false};  /* current metadata document */
+    Zarr_json_t refs = {NULL, 0, 0, false};  /* references */
+    int status = ERROR;         /* return status */
+
+    if (is_remote_file (espa_xml_file))
+    {
+        snprintf (errmsg, sizeof (errmsg), "The XML file needs to be local "
+            "to write references to its bands: %s", espa_xml_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Initialize the metadata structure */
+    init_metadata_struct (&xml_metadata);
+
+    /* Validate the metadata file and parse it into our internal metadata
+       structure, reading the file only once; also allocates space as needed
+       for various pointers in the global and band metadata */
+    if (validate_and_parse_metadata (espa_xml_file, &xml_metadata) != SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+
+    for (i = 0; i < xml_metadata.nbands; i++)
+    {
+        if (zarr_dtype (xml_metadata.band[i].data_type) == NULL)
+        {
+            sprintf (errmsg, "Unsupported data type for band: %s",
+                xml_metadata.band[i].name);
+            error_handler (true, FUNC_NAME, errmsg);
+            goto cleanup;
+        }
+    }
+
+    /* Group and global metadata */
+    zarr_json_printf (&refs, "{\"version\": 1, \"refs\": {");
+    zarr_json_printf (&doc, "{\"zarr_format\": 2}");
+    if (zarr_refs_document (&refs, ".zgroup", &doc) != SUCCESS)
+        goto cleanup;
+    doc.len = 0;
+    zarr_global_attrs_json (&doc, &xml_metadata);
+    if (zarr_refs_document (&refs, ".zattrs", &doc) != SUCCESS)
+        goto cleanup;
+
+    for (i = 0; i < xml_metadata.nbands; i++)
+    {
+        if (is_constant_band (&xml_metadata.band[i]))
+        {
+            snprintf (errmsg, sizeof (errmsg), "Band %s is a constant band "
+                "with no file, so it has no references",
+                xml_metadata.band[i].name);
+            error_handler (false, FUNC_NAME, errmsg);
+            continue;
+        }
+        if (is_espa_shm_name (xml_metadata.band[i].file_name))
+        {
+            snprintf (errmsg, sizeof (errmsg), "Band %s is in shared "
+                "memory, so it has no references", xml_metadata.band[i].name);
+            error_handler (false, FUNC_NAME, errmsg);
+            continue;
+        }
+
+        if (espa_product_href (espa_xml_file, NULL, href_base,
+            xml_metadata.band[i].file_name, href, sizeof (href)) != SUCCESS)
+            goto cleanup;
+        if (zarr_refs_band (&refs, espa_xml_file, &xml_metadata, i, href)
+            != SUCCESS)
+            goto cleanup;
+    }
+
+    zarr_json_printf (&refs, "\n}}\n");
+    if (refs.failed)
+    {
+        sprintf (errmsg, "Allocating memory for the references");
+        error_handler (true, FUNC_NAME, errmsg);
+        goto cleanup;
+    }
+    if (write_zarr_file (refs_file, refs.text, refs.len) != SUCCESS)
+    {
+        snprintf (errmsg, sizeof (errmsg), "Writing the references: %s",
+            refs_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        goto cleanup;
+    }
+    status = SUCCESS;
+
+cleanup:
+    free (doc.text);
+    free (refs.text);
+    free_metadata (&xml_metadata);
+    return (status);
+}
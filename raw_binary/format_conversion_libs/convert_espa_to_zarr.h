@@ -0,0 +1,106 @@
+/*****************************************************************************
+FILE: convert_espa_to_zarr.h
+
+PURPOSE: Contains defines and prototypes to read the ESPA XML metadata file
+and imagery, and convert from raw binary to a Zarr (version 2) store.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+*****************************************************************************/
+
+#ifndef CONVERT_ESPA_TO_ZARR_H
+#define CONVERT_ESPA_TO_ZARR_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "error_handler.h"
+#include "espa_metadata.h"
+#include "parse_metadata.h"
+#include "raw_binary_io.h"
+#include "espa_band_stack.h"
+#include "espa_buffer_pool.h"
+
+/* Compressors of the chunks, named as the numcodecs codecs Zarr readers
+   use to decompress them */
+typedef enum {
+    ZARR_COMPRESS_NONE,  /* chunks are stored as is */
+    ZARR_COMPRESS_ZLIB,  /* shuffled and zlib compressed */
+    ZARR_COMPRESS_ZSTD   /* shuffled and zstd compressed; only available
+                            when built with HAVE_ZSTD */
+} Zarr_compressor_t;
+
+/* Default chunk shape and compression.  zstd is used when it is available,
+   otherwise zlib. */
+#define DEFAULT_ZARR_CHUNK_LINES 512
+#define DEFAULT_ZARR_CHUNK_SAMPS 512
+#ifdef HAVE_ZSTD
+#define DEFAULT_ZARR_COMPRESSOR ZARR_COMPRESS_ZSTD
+#else
+#define DEFAULT_ZARR_COMPRESSOR ZARR_COMPRESS_ZLIB
+#endif
+#define DEFAULT_ZARR_ZLIB_LEVEL 4
+#define DEFAULT_ZARR_ZSTD_LEVEL 3
+
+/* Default and largest number of dates in a chunk of a datacube.  The bands
+   of the dates of a chunk are read at the same time. */
+#define DEFAULT_ZARR_CUBE_TIME_CHUNK 16
+#define ZARR_MAX_CUBE_TIME_CHUNK 64
+
+/* Most bytes in a chunk of whole lines of a plain raw binary band described
+   by a set of references */
+#define ZARR_REFS_CHUNK_BYTES (8 * 1024 * 1024)
+
+/* Chunking and compression of the band arrays */
+typedef struct
+{
+    int chunk_lines;     /* number of lines per chunk */
+    int chunk_samps;     /* number of samples per chunk; 0 for full lines */
+    Zarr_compressor_t compressor;  /* compressor of the chunks */
+    int level;           /* compression level; 0 for the default of the
+                            compressor */
+    bool physical_units; /* write the packed bands as the float32 physical
+                            values of their scale_factor and add_offset
+                            (see espa_cf_packing.h)? */
+} Zarr_options_t;
+
+/* Prototypes */
+int parse_zarr_compressor
+(
+    char *name,                    /* I: name of the compressor (none, zlib,
+                                         or zstd) */
+    Zarr_compressor_t *compressor  /* O: compressor of the chunks */
+);
+
+int convert_espa_to_zarr
+(
+    char *espa_xml_file,   /* I: input ESPA XML metadata filename */
+    char *zarr_dir,        /* I: output Zarr store directory */
+    bool del_src,          /* I: should the source files be removed after
+                                 conversion? */
+    Zarr_options_t *options  /* I: chunking and compression of the bands */
+);
+
+int convert_espa_to_zarr_cube
+(
+    char **espa_xml_files, /* I: input ESPA XML metadata filenames, of
+                                 products on the same grid */
+    int nfiles,            /* I: number of XML metadata files */
+    char *zarr_dir,        /* I: output Zarr store directory */
+    int time_chunk,        /* I: number of dates per chunk */
+    Zarr_options_t *options  /* I: chunking and compression of the bands */
+);
+
+int convert_espa_to_zarr_refs
+(
+    char *espa_xml_file,   /* I: input ESPA XML metadata filename */
+    char *refs_file,       /* I: output references (JSON) filename */
+    char *href_base        /* I: base URL the band files are served from;
+                                 NULL for their local paths */
+);
+
+#endif
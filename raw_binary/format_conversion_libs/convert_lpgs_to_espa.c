@@ -17,13 +17,19 @@ NOTES:
 *****************************************************************************/
 #include <unistd.h>
 #include <math.h>
+#ifdef HAVE_LIBARCHIVE
+#include <archive.h>
+#include <archive_entry.h>
+#endif
 #include "convert_lpgs_to_espa.h"
+#include "espa_remote.h"
+#include "espa_task_pool.h"
 
 /******************************************************************************
-MODULE:  read_lpgs_mtl
+MODULE:  parse_lpgs_mtl
 
-PURPOSE: Read the LPGS MTL metadata file and populate the ESPA internal
-metadata structure
+PURPOSE: Parse the opened LPGS MTL metadata file and populate the ESPA
+internal metadata structure
 
 RETURN VALUE:
 Type = int
@@ -38,19 +44,20 @@ NOTES:
    parsed and written to our XML metadata file, if they exist.
 2. When processing OLI_TIRS stack the 11 image bands first, then add the
    QA band to the list.
+3. The MTL file is rewound, so it needs to be seekable (a file in memory
+   opened with fmemopen is).  The caller closes it.
 ******************************************************************************/
-int read_lpgs_mtl
+static int parse_lpgs_mtl
 (
-    char *mtl_file,                  /* I: name of the MTL metadata file to
-                                           be read */
+    FILE *mtl_fptr,                  /* I: opened MTL metadata file */
+    char *mtl_file,                  /* I: name of the MTL metadata file */
     Espa_internal_meta_t *metadata,  /* I/O: input metadata structure to be
                                            populated from the MTL file */
-    int *nlpgs_bands,                /* O: number of bands in LPGS product */
-    char lpgs_bands[][STR_SIZE]      /* O: array containing the filenames of
-                                           the LPGS bands */
+    Espa_name_list_t *lpgs_bands     /* O: list of the filenames of the LPGS
+                                           bands; free with free_name_list */
 )
 {
-    char FUNC_NAME[] = "read_lpgs_mtl";  /* function name */
+    char FUNC_NAME[] = "parse_lpgs_mtl";  /* function name */
     char errmsg[STR_SIZE];    /* error message */
     char category[MAX_LPGS_BANDS][STR_SIZE]; /* band category - qa, image */
     char band_num[MAX_LPGS_BANDS][STR_SIZE]; /* band number for band name */
@@ -67,7 +74,6 @@ int read_lpgs_mtl
                                  K1/K2 constants available in the MTL file? */
     bool thermal[MAX_LPGS_BANDS]; /* is this band a thermal band? */
     bool all_bands_read = false;  /* all filenames been read from MTL file? */
-    FILE *mtl_fptr=NULL;      /* file pointer to the MTL metadata file */
     Espa_global_meta_t *gmeta = &metadata->global;  /* pointer to the global
                                                        metadata structure */
     Espa_band_meta_t *bmeta;  /* pointer to the array of bands metadata */
@@ -100,19 +106,12 @@ int read_lpgs_mtl
     char buffer[STR_SIZE] = "\0";          /* line buffer from MTL file */
     char *label = NULL;                    /* label value in the line */
     char *tokenptr = NULL;                 /* pointer to process each line */
+    char *saveptr = NULL;                  /* position of strtok_r in the
+                                              line */
     char *seperator = "=\" \t";            /* separator string */
     float fnum;                            /* temporary variable for floating
                                               point numbers */
 
-    /* Open the metadata MTL file with read privelages */
-    mtl_fptr = fopen (mtl_file, "r");
-    if (mtl_fptr == NULL)
-    {
-        sprintf (errmsg, "Opening %s for read access.", mtl_file);
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
-    }
-
     /* The sensor ID is needed for parsing the rest of the MTL.  It needs to
        be read since it falls after many of the other tokens in the MTL. */
     while (fgets (buffer, STR_SIZE, mtl_fptr) != NULL)
@@ -122,12 +121,12 @@ int read_lpgs_mtl
             buffer[strlen(buffer)-1] = '\0';
 
         /* Get string token */
-        tokenptr = strtok (buffer, seperator);
+        tokenptr = strtok_r (buffer, seperator, &saveptr);
         label = tokenptr;
 
         if (tokenptr != NULL)
         {
-            tokenptr = strtok (NULL, seperator);
+            tokenptr = strtok_r (NULL, seperator, &saveptr);
 
             if (!strcmp (label, "SENSOR_ID"))
             {
@@ -167,12 +166,12 @@ int read_lpgs_mtl
             buffer[strlen(buffer)-1] = '\0';
 
         /* Get string token */
-        tokenptr = strtok (buffer, seperator);
+        tokenptr = strtok_r (buffer, seperator, &saveptr);
         label = tokenptr;
  
         if (tokenptr != NULL)
         {
-            tokenptr = strtok (NULL, seperator);
+            tokenptr = strtok_r (NULL, seperator, &saveptr);
 
             /* Process each token */
             if (!strcmp (label, "PROCESSING_SOFTWARE_VERSION"))
@@ -1064,15 +1063,13 @@ int read_lpgs_mtl
     bmeta = metadata->band;
 
     /* Fill in the band-related metadata for each of the bands */
-    *nlpgs_bands = metadata->nbands;
+    init_name_list (lpgs_bands);
     for (i = 0; i < metadata->nbands; i++)
     {
         /* Handle the general metadata for each band */
-        count = snprintf (lpgs_bands[i], sizeof (lpgs_bands[i]), "%s",
-            band_fname[i]);
-        if (count < 0 || count >= sizeof (lpgs_bands[i]))
+        if (add_name_to_list (lpgs_bands, band_fname[i]) != SUCCESS)
         {
-            sprintf (errmsg, "Overflow of lpgs_bands[i] string");
+            sprintf (errmsg, "Adding the filename of band %d", i);
             error_handler (true, FUNC_NAME, errmsg);
             return (ERROR);
         }
@@ -1458,9 +1455,6 @@ int read_lpgs_mtl
         }
     }
 
-    /* Close the metadata file */
-    fclose (mtl_fptr);
-
     /* Get geolocation information from the XML file to prepare for computing
        the bounding coordinates */
     if (!get_geoloc_info (metadata, &geoloc_def))
@@ -1508,174 +1502,1473 @@ int read_lpgs_mtl
 
 
 /******************************************************************************
-MODULE:  convert_gtif_to_img
+MODULE:  read_lpgs_remote_mtl
 
-PURPOSE: Convert the LPGS Cloud Optimized GeoTIFF band to ESPA raw binary
-(.img) file and writes the associated ENVI header for each band.
+PURPOSE: Read a remote LPGS MTL metadata file and populate the ESPA internal
+metadata structure
 
 RETURN VALUE:
 Type = int
 Value           Description
 -----           -----------
-ERROR           Error converting the GeoTIFF file
-SUCCESS         Successfully converterd GeoTIFF to raw binary
+ERROR           Error reading the metadata file
+SUCCESS         Successfully populated the ESPA metadata structure
 
 NOTES:
-  1. The GDAL tools will be used for converting the Cloud Optimized GeoTIFF
-     to raw binary (ENVI format).
-  2. An associated .tfw (ESRI world file) will be generated for each GeoTIFF
-     file.
+  1. The MTL file is read into memory, and the filenames of the bands are
+     prefixed with the remote directory of the MTL file, so the bands are
+     read with range requests as they are converted.
 ******************************************************************************/
-int convert_gtif_to_img
+static int read_lpgs_remote_mtl
 (
-    char *gtif_file,           /* I: name of input GeoTIFF file for this band */
-    Espa_band_meta_t *bmeta,   /* I: pointer to band metadata for this band */
-    Espa_global_meta_t *gmeta  /* I: pointer to global metadata */
+    char *mtl_file,                  /* I: URL of the MTL metadata file */
+    Espa_internal_meta_t *metadata,  /* I/O: input metadata structure to be
+                                           populated from the MTL file */
+    Espa_name_list_t *lpgs_bands     /* O: list of the filenames of the LPGS
+                                           bands; free with free_name_list */
 )
 {
-    char FUNC_NAME[] = "convert_gtif_to_img";  /* function name */
+    char FUNC_NAME[] = "read_lpgs_remote_mtl";  /* function name */
     char errmsg[STR_SIZE];    /* error message */
-    char gdal_cmd[STR_SIZE];  /* command string for GDAL call */
-    char tmpfile[STR_SIZE];   /* filename of file.img.aux.xml */
+    char band_name[STR_SIZE]; /* filename of the band in the MTL file */
+    char *mtl_buf = NULL;     /* contents of the MTL file */
+    char *base = NULL;        /* name of the MTL file without its directory */
+    size_t mtl_bytes;         /* number of bytes in the MTL file */
+    int dir_len;              /* length of the directory, with its slash */
+    int i;                    /* looping variable for the bands */
     int count;                /* number of chars copied in snprintf */
+    int status;               /* status of parsing the MTL file */
+    FILE *mtl_fptr = NULL;    /* file pointer to the MTL file in memory */
 
-    /* Check if the fill value is defined */
-    if ((int) bmeta->fill_value == (int) ESPA_INT_META_FILL)
+    if (read_remote_file_all (mtl_file, &mtl_buf, &mtl_bytes) != SUCCESS)
     {
-        /* Fill value is not defined so don't write the nodata tag */
-        count = snprintf (gdal_cmd, sizeof (gdal_cmd),
-            "gdal_translate -of Envi -q %s %s", gtif_file, bmeta->file_name);
+        sprintf (errmsg, "Reading the remote MTL file %s", mtl_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
     }
-    else
+    mtl_fptr = fmemopen (mtl_buf, mtl_bytes, "r");
+    if (mtl_fptr == NULL)
+    {
+        sprintf (errmsg, "Opening the MTL file %s in memory", mtl_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        free (mtl_buf);
+        return (ERROR);
+    }
+
+    base = strrchr (mtl_file, '/') + 1;
+    dir_len = base - mtl_file;
+    status = parse_lpgs_mtl (mtl_fptr, base, metadata, lpgs_bands);
+    fclose (mtl_fptr);
+    free (mtl_buf);
+    if (status != SUCCESS)
+        return (ERROR);
+
+    /* The bands are next to the MTL file */
+    for (i = 0; i < lpgs_bands->nnames; i++)
+    {
+        strcpy (band_name, lpgs_bands->names[i]);
+        count = snprintf (lpgs_bands->names[i], STR_SIZE, "%.*s%s", dir_len,
+            mtl_file, band_name);
+        if (count < 0 || count >= STR_SIZE)
+        {
+            sprintf (errmsg, "Overflow of the URL of band %s", band_name);
+            error_handler (true, FUNC_NAME, errmsg);
+            free_name_list (lpgs_bands);
+            return (ERROR);
+        }
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  read_lpgs_mtl
+
+PURPOSE: Read the LPGS MTL metadata file and populate the ESPA internal
+metadata structure
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error reading the metadata file
+SUCCESS         Successfully populated the ESPA metadata structure
+
+NOTES:
+  1. See parse_lpgs_mtl.
+  2. The MTL file may be a remote file, named by an http://, https://, or
+     s3:// URL (see espa_remote.h).  The bands are then read from the same
+     remote directory as the MTL file, and the LPGS metadata file recorded
+     in the XML is the name of the MTL file without its directory.
+******************************************************************************/
+int read_lpgs_mtl
+(
+    char *mtl_file,                  /* I: name of the MTL metadata file to
+                                           be read */
+    Espa_internal_meta_t *metadata,  /* I/O: input metadata structure to be
+                                           populated from the MTL file */
+    Espa_name_list_t *lpgs_bands     /* O: list of the filenames of the LPGS
+                                           bands; free with free_name_list */
+)
+{
+    char FUNC_NAME[] = "read_lpgs_mtl";  /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    int status;               /* status of parsing the MTL file */
+    FILE *mtl_fptr = NULL;    /* file pointer to the MTL metadata file */
+
+    if (is_remote_file (mtl_file))
+        return (read_lpgs_remote_mtl (mtl_file, metadata, lpgs_bands));
+
+    /* Open the metadata MTL file with read privelages */
+    mtl_fptr = fopen (mtl_file, "r");
+    if (mtl_fptr == NULL)
+    {
+        sprintf (errmsg, "Opening %s for read access.", mtl_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    status = parse_lpgs_mtl (mtl_fptr, mtl_file, metadata, lpgs_bands);
+
+    /* Close the metadata file */
+    fclose (mtl_fptr);
+
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  write_gtif_envi_hdr
+
+PURPOSE: Writes the ENVI header of the raw binary file converted from an LPGS
+GeoTIFF band.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the ENVI header
+SUCCESS         Successfully wrote the ENVI header
+
+NOTES:
+  1. The ENVI header gets a data ignore value only if the fill value of the
+     band is defined, as was done with the nodata value of gdal_translate.
+******************************************************************************/
+static int write_gtif_envi_hdr
+(
+    Espa_band_meta_t *bmeta,   /* I: pointer to band metadata for this band */
+    Espa_global_meta_t *gmeta  /* I: pointer to global metadata */
+)
+{
+    char FUNC_NAME[] = "write_gtif_envi_hdr";  /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    char envi_file[STR_SIZE]; /* name of the output ENVI header file */
+    char *cptr = NULL;        /* pointer to the file extension */
+    int count;                /* number of chars copied in snprintf */
+    Envi_header_t envi_hdr;   /* output ENVI header information */
+
+    /* Create the ENVI header file for this band */
+    if (create_envi_struct (bmeta, gmeta, &envi_hdr) != SUCCESS)
     {
-        /* Fill value is defined so use the nodata tag */
-        count = snprintf (gdal_cmd, sizeof (gdal_cmd),
-         "gdal_translate -of Envi -a_nodata %ld -q %s %s",
-            bmeta->fill_value, gtif_file, bmeta->file_name);
+        sprintf (errmsg, "Creating the ENVI header structure for this "
+            "file: %s", bmeta->file_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
     }
-    if (count < 0 || count >= sizeof (gdal_cmd))
+
+    /* Write the ENVI header */
+    count = snprintf (envi_file, sizeof (envi_file), "%s", bmeta->file_name);
+    if (count < 0 || count >= sizeof (envi_file))
     {
-        sprintf (errmsg, "Overflow of gdal_cmd string");
+        sprintf (errmsg, "Overflow of envi_file string");
         error_handler (true, FUNC_NAME, errmsg);
         return (ERROR);
     }
- 
-    if (system (gdal_cmd) == -1)
+    cptr = strrchr (envi_file, '.');
+    if (cptr == NULL)
     {
-        sprintf (errmsg, "Running gdal_translate: %s", gdal_cmd);
+        sprintf (errmsg, "No file extension on the raw binary file: %s",
+            bmeta->file_name);
         error_handler (true, FUNC_NAME, errmsg);
         return (ERROR);
     }
- 
-    /* Remove the {gtif_name}.tif.aux.xml file since it's not needed and
-       clutters the results.  Don't worry about testing the unlink
-       results.  If it doesn't unlink it's not fatal. */
-    count = snprintf (tmpfile, sizeof (tmpfile), "%s.aux.xml",
-        bmeta->file_name);
-    if (count < 0 || count >= sizeof (tmpfile))
+    strcpy (cptr, ".hdr");
+
+    if (write_envi_hdr (envi_file, &envi_hdr) != SUCCESS)
     {
-        sprintf (errmsg, "Overflow of tmpfile string");
+        sprintf (errmsg, "Writing the ENVI header file: %s.", envi_file);
         error_handler (true, FUNC_NAME, errmsg);
         return (ERROR);
     }
-    unlink (tmpfile);
 
-    /* Successful conversion */
     return (SUCCESS);
 }
 
 
 /******************************************************************************
-MODULE:  convert_lpgs_to_espa
+MODULE:  convert_tiff_band
 
-PURPOSE: Converts the input LPGS GeoTIFF files (and associated MTL file) to
-the ESPA internal raw binary file format (and associated XML file).
+PURPOSE: Convert the opened LPGS GeoTIFF band to ESPA raw binary (.img) file
+and writes the associated ENVI header for the band.
 
 RETURN VALUE:
 Type = int
 Value           Description
 -----           -----------
 ERROR           Error converting the GeoTIFF file
-SUCCESS         Successfully converted GeoTIFF to raw binary
+SUCCESS         Successfully converterd GeoTIFF to raw binary
 
 NOTES:
-  1. The LPGS GeoTIFF band files will be deciphered from the LPGS MTL file.
-  2. The ESPA raw binary band files will be generated from the ESPA XML
-     filename.
+  1. The GeoTIFF is read in place with libtiff, a block of whole strips or
+     tile rows at a time, and the lines are appended to the raw binary file
+     through the coalescing writer.
+  2. Uncompressed GeoTIFFs whose strips already hold the pixels as a raw
+     binary band (see get_tiff_payload) are copied without decoding the
+     strips; with copy_raw_binary_range from the GeoTIFF file, or straight
+     from tiff_buf for a GeoTIFF held in memory.  The strips of a remote
+     GeoTIFF are read through libtiff either way.  So are the strips of a
+     band in the browse, since its pixels are added to the browse as they
+     are written.
+  3. The GeoTIFF is closed before returning.
 ******************************************************************************/
-int convert_lpgs_to_espa
+static int convert_tiff_band
 (
-    char *lpgs_mtl_file,   /* I: input LPGS MTL metadata filename */
-    char *espa_xml_file,   /* I: output ESPA XML metadata filename */
-    bool del_src           /* I: should the source .tif files be removed after
-                                 conversion? */
+    TIFF *tiff,                /* I: opened GeoTIFF file for this band */
+    char *gtif_file,           /* I: name of the GeoTIFF file */
+    char *tiff_buf,            /* I: bytes of the GeoTIFF file if it is held
+                                     in memory; NULL if it is on disk */
+    Espa_band_meta_t *bmeta,   /* I: pointer to band metadata for this band */
+    Espa_global_meta_t *gmeta, /* I: pointer to global metadata */
+    Espa_browse_t *browse,     /* I/O: browse the band is added to; NULL if
+                                     none */
+    int channel                /* I: channel of the band in the browse; -1 if
+                                     the band isn't in it */
 )
 {
-    char FUNC_NAME[] = "convert_lpgs_to_espa";  /* function name */
-    char errmsg[STR_SIZE];   /* error message */
-    Espa_internal_meta_t xml_metadata;  /* XML metadata structure to be
-                                populated by reading the MTL metadata file */
-    int i;                   /* looping variable */
-    int nlpgs_bands;         /* number of bands in the LPGS product */
-    char lpgs_bands[MAX_LPGS_BANDS][STR_SIZE];  /* array containing the file
-                                names of the LPGS bands */
-
-    /* Initialize the metadata structure */
-    init_metadata_struct (&xml_metadata);
-
-    /* Read the LPGS MTL file and populate our internal ESPA metadata
-       structure */
-    if (read_lpgs_mtl (lpgs_mtl_file, &xml_metadata, &nlpgs_bands,
-        lpgs_bands) != SUCCESS)
+    char FUNC_NAME[] = "convert_tiff_band";  /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    int nbytes;               /* number of bytes per pixel */
+    int status = SUCCESS;     /* status of the conversion */
+    off_t offset;             /* file offset of the GeoTIFF pixels */
+    size_t band_bytes;        /* number of bytes in the band */
+    bool payload;             /* are the pixels stored as a raw binary band? */
+    Tiff_block_reader_t *reader = NULL;  /* reader of the GeoTIFF lines */
+    Tiff_block_t *block = NULL;          /* current block of lines */
+    Raw_binary_writer_t *writer = NULL;  /* writer of the raw binary file */
+
+    nbytes = espa_data_type_size (bmeta->data_type);
+    if (nbytes <= 0)
     {
-        sprintf (errmsg, "Reading the LPGS MTL file: %s", lpgs_mtl_file);
+        sprintf (errmsg, "Unsupported data type %d for band %s",
+            bmeta->data_type, bmeta->name);
         error_handler (true, FUNC_NAME, errmsg);
+        close_tiff (tiff);
         return (ERROR);
     }
+    band_bytes = (size_t) bmeta->nlines * bmeta->nsamps * nbytes;
 
-    /* Write the metadata from our internal metadata structure to the output
-       XML filename */
-    if (write_metadata (&xml_metadata, espa_xml_file) != SUCCESS)
-    {  /* Error messages already written */
+    /* Set up the reading of the GeoTIFF lines */
+    reader = open_tiff_block_reader (tiff, bmeta->data_type,
+        RB_PREFETCH_DEFAULT_LINES);
+    if (reader == NULL)
+    {
+        sprintf (errmsg, "Setting up the reading of the GeoTIFF file: %s",
+            gtif_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        close_tiff (tiff);
         return (ERROR);
     }
-
-    /* Validate the input metadata file */
-    if (validate_xml_file (espa_xml_file) != SUCCESS)
-    {  /* Error messages already written */
+    if (reader->layout.nlines != bmeta->nlines ||
+        reader->layout.nsamps != bmeta->nsamps ||
+        reader->layout.size != nbytes)
+    {
+        sprintf (errmsg, "GeoTIFF file %s is %d lines x %d samples of %d "
+            "bytes, but the band is %d lines x %d samples of %d bytes",
+            gtif_file, reader->layout.nlines, reader->layout.nsamps,
+            reader->layout.size, bmeta->nlines, bmeta->nsamps, nbytes);
+        error_handler (true, FUNC_NAME, errmsg);
+        close_tiff_block_reader (reader);
+        close_tiff (tiff);
         return (ERROR);
     }
 
-    /* Convert each of the LPGS GeoTIFF files to raw binary */
-    for (i = 0; i < nlpgs_bands; i++)
+    /* If the pixels are already stored as a raw binary band, copy them
+       without decoding the strips */
+    payload = get_tiff_payload (tiff, &reader->layout, &offset) &&
+        (tiff_buf != NULL || (!is_remote_file (gtif_file) && channel < 0));
+    if (payload && tiff_buf == NULL)
     {
-        printf ("  Band %d: %s to %s\n", i, lpgs_bands[i],
-            xml_metadata.band[i].file_name);
-        if (convert_gtif_to_img (lpgs_bands[i], &xml_metadata.band[i],
-            &xml_metadata.global) != SUCCESS)
+        close_tiff_block_reader (reader);
+        close_tiff (tiff);
+        if (copy_raw_binary_range (gtif_file, offset, band_bytes,
+            bmeta->file_name) != SUCCESS)
         {
-            sprintf (errmsg, "Converting band %d: %s", i, lpgs_bands[i]);
+            sprintf (errmsg, "Copying the pixels of the GeoTIFF file: %s",
+                gtif_file);
             error_handler (true, FUNC_NAME, errmsg);
             return (ERROR);
         }
+        return (write_gtif_envi_hdr (bmeta, gmeta));
+    }
+
+    /* Copy the lines to the raw binary file */
+    writer = open_raw_binary_writer (bmeta->file_name, band_bytes, 0);
+    if (writer == NULL)
+    {
+        sprintf (errmsg, "Opening the raw binary file: %s", bmeta->file_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        close_tiff_block_reader (reader);
+        close_tiff (tiff);
+        return (ERROR);
+    }
+    if (start_raw_binary_writer_stats (writer, bmeta) != SUCCESS ||
+        start_raw_binary_writer_sparse (writer, bmeta, RB_SPARSE_FROM_ENV)
+        != SUCCESS)
+    {
+        sprintf (errmsg, "Starting the statistics or fill regions of band %s",
+            bmeta->name);
+        error_handler (true, FUNC_NAME, errmsg);
+        close_raw_binary_writer (writer);
+        close_tiff_block_reader (reader);
+        close_tiff (tiff);
+        return (ERROR);
+    }
+    if (channel >= 0)
+        start_raw_binary_writer_browse (writer, browse, channel);
 
-        /* Remove the source file if specified */
-        if (del_src)
+    if (payload)
+    {
+        /* The pixels in memory are the raw binary band already */
+        if (append_raw_binary_writer (writer, bmeta->nlines, bmeta->nsamps,
+            nbytes, tiff_buf + offset) != SUCCESS)
+        {
+            sprintf (errmsg, "Writing the raw binary file: %s",
+                bmeta->file_name);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+        }
+    }
+    else
+    {
+        while (1)
         {
-            printf ("  Removing %s\n", lpgs_bands[i]);
-            if (unlink (lpgs_bands[i]) != 0)
+            if (get_tiff_block (reader, &block) != SUCCESS)
             {
-                sprintf (errmsg, "Deleting source file: %s", lpgs_bands[i]);
+                sprintf (errmsg, "Reading the GeoTIFF file: %s", gtif_file);
                 error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
+                status = ERROR;
+                break;
+            }
+            if (block == NULL)
+                break;   /* all lines have been copied */
+
+            if (append_raw_binary_writer (writer, block->nlines,
+                block->nsamps, nbytes, block->buf) != SUCCESS)
+            {
+                sprintf (errmsg, "Writing lines %d-%d to the raw binary "
+                    "file: %s", block->line0,
+                    block->line0 + block->nlines - 1, bmeta->file_name);
+                error_handler (true, FUNC_NAME, errmsg);
+                status = ERROR;
+                break;
             }
         }
     }
 
-    /* Free the metadata structure */
-    free_metadata (&xml_metadata);
+    close_tiff_block_reader (reader);
+    close_tiff (tiff);
+    if (status == SUCCESS)
+    {
+        get_raw_binary_writer_checksum (writer, bmeta->checksum);
+        get_raw_binary_writer_stats (writer, &bmeta->stats);
+    }
+    if (close_raw_binary_writer (writer) != SUCCESS)
+    {
+        sprintf (errmsg, "Closing the raw binary file: %s", bmeta->file_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        status = ERROR;
+    }
+    if (status != SUCCESS)
+        return (ERROR);
 
-    /* Successful conversion */
-    return (SUCCESS);
+    return (write_gtif_envi_hdr (bmeta, gmeta));
+}
+
+
+/******************************************************************************
+MODULE:  convert_gtif_to_img
+
+PURPOSE: Convert the LPGS Cloud Optimized GeoTIFF band to ESPA raw binary
+(.img) file and writes the associated ENVI header for each band.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error converting the GeoTIFF file
+SUCCESS         Successfully converterd GeoTIFF to raw binary
+
+NOTES:
+  1. See convert_tiff_band.
+  2. The Tiff library registers its tag extensions on the first open, so the
+     opens are serialized with those of the other bands.
+******************************************************************************/
+int convert_gtif_to_img
+(
+    char *gtif_file,           /* I: name of input GeoTIFF file for this band */
+    Espa_band_meta_t *bmeta,   /* I: pointer to band metadata for this band */
+    Espa_global_meta_t *gmeta, /* I: pointer to global metadata */
+    Espa_browse_t *browse,     /* I/O: browse the band is added to; NULL if
+                                     none */
+    int channel                /* I: channel of the band in the browse; -1 if
+                                     the band isn't in it */
+)
+{
+    char FUNC_NAME[] = "convert_gtif_to_img";  /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    TIFF *tiff = NULL;        /* input GeoTIFF file */
+
+    /* Open the GeoTIFF */
+#ifdef _OPENMP
+    #pragma omp critical (gtif_open)
+#endif
+    tiff = open_tiff (gtif_file, "r");
+    if (tiff == NULL)
+    {
+        sprintf (errmsg, "Opening the GeoTIFF file: %s", gtif_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (convert_tiff_band (tiff, gtif_file, NULL, bmeta, gmeta, browse,
+        channel));
+}
+
+
+/******************************************************************************
+MODULE:  convert_gtif_buffer_to_img
+
+PURPOSE: Convert the LPGS GeoTIFF band held in memory (such as one read out
+of a Landsat bundle) to ESPA raw binary (.img) file and writes the associated
+ENVI header for the band.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error converting the GeoTIFF file
+SUCCESS         Successfully converterd GeoTIFF to raw binary
+
+NOTES:
+  1. See convert_tiff_band.  The GeoTIFF is decoded from the buffer in place
+     (see open_tiff_buffer), which the caller frees afterwards.
+******************************************************************************/
+int convert_gtif_buffer_to_img
+(
+    char *gtif_file,           /* I: name of the GeoTIFF file, for messages */
+    char *tiff_buf,            /* I: bytes of the GeoTIFF file */
+    size_t tiff_bytes,         /* I: number of bytes in tiff_buf */
+    Espa_band_meta_t *bmeta,   /* I: pointer to band metadata for this band */
+    Espa_global_meta_t *gmeta, /* I: pointer to global metadata */
+    Espa_browse_t *browse,     /* I/O: browse the band is added to; NULL if
+                                     none */
+    int channel                /* I: channel of the band in the browse; -1 if
+                                     the band isn't in it */
+)
+{
+    char FUNC_NAME[] = "convert_gtif_buffer_to_img";  /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    TIFF *tiff = NULL;        /* input GeoTIFF file */
+
+    /* Open the GeoTIFF */
+#ifdef _OPENMP
+    #pragma omp critical (gtif_open)
+#endif
+    tiff = open_tiff_buffer (gtif_file, tiff_buf, tiff_bytes);
+    if (tiff == NULL)
+    {
+        sprintf (errmsg, "Opening the GeoTIFF file from memory: %s",
+            gtif_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (convert_tiff_band (tiff, gtif_file, tiff_buf, bmeta, gmeta,
+        browse, channel));
 }
 
+
+/******************************************************************************
+MODULE:  lpgs_ingest_threads
+
+PURPOSE: Returns the number of bands to be converted at the same time.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+n               Number of threads for the band conversions
+
+NOTES:
+  1. Each conversion streams one GeoTIFF in and one raw binary file out, so
+     the number of conversions in flight is limited to
+     LPGS_DEFAULT_INGEST_THREADS (or LPGS_INGEST_THREADS_ENV) rather than the
+     number of processors, to keep the storage from seeking between too many
+     files.  It is never more than the threads of the task pool or the
+     bands.
+******************************************************************************/
+static int lpgs_ingest_threads
+(
+    int nbands              /* I: number of bands to be converted */
+)
+{
+    int nthreads;           /* number of threads */
+    char *env = NULL;       /* value of the environment variable */
+
+    env = getenv (LPGS_INGEST_THREADS_ENV);
+    nthreads = env != NULL ? atoi (env) : LPGS_DEFAULT_INGEST_THREADS;
+    if (nthreads > espa_task_pool_threads ())
+        nthreads = espa_task_pool_threads ();
+    if (nthreads > nbands)
+        nthreads = nbands;
+    if (nthreads < 1)
+        nthreads = 1;
+
+    return (nthreads);
+}
+
+
+/* LPGS bands converted in parallel */
+typedef struct
+{
+    Espa_internal_meta_t *xml_metadata; /* metadata of the ESPA bands */
+    char (*band_fname)[STR_SIZE];       /* filenames of the LPGS bands */
+    bool del_src;           /* should the source .tif files be removed after
+                               conversion? */
+    Espa_browse_t *browse;  /* browse the bands are added to; NULL if none */
+} Lpgs_bands_t;
+
+
+/******************************************************************************
+MODULE:  convert_lpgs_band
+
+PURPOSE: Converts one LPGS GeoTIFF band file to raw binary, as an iteration of
+the parallel loop over the bands.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error converting the GeoTIFF file
+SUCCESS         Successfully converted the GeoTIFF file to raw binary
+
+NOTES:
+  1. The band is reported by report_lpgs_band.
+******************************************************************************/
+static int convert_lpgs_band
+(
+    void *arg,              /* I/O: bands being converted */
+    int i,                  /* I: index of the band */
+    int worker              /* I: worker converting the band (unused) */
+)
+{
+    Lpgs_bands_t *bands = arg;  /* bands being converted */
+
+    return (convert_gtif_to_img (bands->band_fname[i],
+        &bands->xml_metadata->band[i], &bands->xml_metadata->global,
+        bands->browse, espa_browse_channel (bands->browse, i)));
+}
+
+
+/******************************************************************************
+MODULE:  report_lpgs_band
+
+PURPOSE: Reports a converted band and removes its source file, in band order.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           The band failed or its source file couldn't be removed
+SUCCESS         Successfully reported the band
+
+NOTES:
+******************************************************************************/
+static int report_lpgs_band
+(
+    void *arg,              /* I/O: bands being converted */
+    int i,                  /* I: index of the band */
+    int band_status         /* I: status of converting the band */
+)
+{
+    char FUNC_NAME[] = "convert_lpgs_bands";  /* function name */
+    char errmsg[STR_SIZE];  /* error message */
+    Lpgs_bands_t *bands = arg;  /* bands being converted */
+    char (*band_fname)[STR_SIZE] = bands->band_fname;  /* array of the
+                                                          filenames */
+
+    printf ("  Band %d: %s to %s\n", i, band_fname[i],
+        bands->xml_metadata->band[i].file_name);
+    if (band_status != SUCCESS)
+    {
+        sprintf (errmsg, "Converting band %d: %s", i, band_fname[i]);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    if (bands->del_src)
+    {
+        printf ("  Removing %s\n", band_fname[i]);
+        if (unlink (band_fname[i]) != 0)
+        {
+            sprintf (errmsg, "Deleting source file: %s", band_fname[i]);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  convert_lpgs_bands
+
+PURPOSE: Converts each of the LPGS GeoTIFF band files to the ESPA internal raw
+binary file of its band in the metadata.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error converting the GeoTIFF files
+SUCCESS         Successfully converted the GeoTIFF files to raw binary
+
+NOTES:
+  1. The LPGS bands are in the order of the bands in the metadata, as read by
+     read_lpgs_mtl.
+  2. The bands are independent, so they are converted in parallel (see
+     lpgs_ingest_threads).  The progress, the removal of the source files,
+     and the errors are reported in band order, as each band completes.
+  3. Once a band fails, the bands which haven't started are skipped and the
+     first failed band is reported.
+******************************************************************************/
+static int convert_lpgs_bands
+(
+    Espa_internal_meta_t *xml_metadata, /* I: metadata of the ESPA bands */
+    Espa_name_list_t *lpgs_bands,       /* I: list of the filenames of the
+                                              LPGS bands */
+    bool del_src,          /* I: should the source .tif files be removed after
+                                 conversion? */
+    Espa_browse_t *browse  /* I/O: browse the bands are added to; NULL if
+                                 none */
+)
+{
+    char FUNC_NAME[] = "convert_lpgs_bands";  /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    int nthreads;            /* number of bands converted at the same time */
+    Lpgs_bands_t bands;      /* bands being converted */
+    char (*band_fname)[STR_SIZE] = lpgs_bands->names;  /* array of the
+                                                          filenames */
+
+    /* Remote source files can't be removed */
+    if (del_src && lpgs_bands->nnames > 0 &&
+        is_remote_file (band_fname[0]))
+    {
+        sprintf (errmsg, "Removing the source files isn't supported for "
+            "remote files: %s", band_fname[0]);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    nthreads = lpgs_ingest_threads (lpgs_bands->nnames);
+    if (nthreads > 1)
+        printf ("  Converting %d bands at a time\n", nthreads);
+
+    bands.xml_metadata = xml_metadata;
+    bands.band_fname = band_fname;
+    bands.del_src = del_src;
+    bands.browse = browse;
+    return (espa_parallel_for_ordered (lpgs_bands->nnames, nthreads,
+        convert_lpgs_band, report_lpgs_band, &bands));
+}
+
+
+/******************************************************************************
+MODULE:  finish_lpgs_xml
+
+PURPOSE: Writes the XML metadata file again once the bands have been
+converted, and writes the browse.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the XML file or the browse
+SUCCESS         Successfully wrote the XML file and the browse
+
+NOTES:
+  1. The XML file now has the checksum and statistics of each band, which
+     were computed as the bands were converted.  The browse is stretched
+     with those statistics (see write_espa_browse).
+******************************************************************************/
+static int finish_lpgs_xml
+(
+    Espa_internal_meta_t *xml_metadata, /* I: metadata of the converted
+                                              bands */
+    char *espa_xml_file,   /* I: output ESPA XML metadata filename */
+    Espa_browse_t *browse  /* I: browse with the bands added; NULL if none */
+)
+{
+    if (write_metadata (xml_metadata, espa_xml_file) != SUCCESS)
+        return (ERROR);   /* Error messages already written */
+
+    if (browse != NULL)
+    {
+        if (write_espa_browse (browse, xml_metadata, espa_xml_file)
+            != SUCCESS)
+            return (ERROR);   /* Error messages already written */
+        printf ("  Browse of bands %s, %s, %s written\n",
+            xml_metadata->band[browse->channel[0].band].name,
+            xml_metadata->band[browse->channel[1].band].name,
+            xml_metadata->band[browse->channel[2].band].name);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  convert_lpgs_to_espa
+
+PURPOSE: Converts the input LPGS GeoTIFF files (and associated MTL file) to
+the ESPA internal raw binary file format (and associated XML file).
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error converting the GeoTIFF file
+SUCCESS         Successfully converted GeoTIFF to raw binary
+
+NOTES:
+  1. The LPGS GeoTIFF band files will be deciphered from the LPGS MTL file.
+  2. The ESPA raw binary band files will be generated from the ESPA XML
+     filename.
+  3. The XML file is written before the bands are converted, so a failed
+     conversion leaves the metadata behind, and again afterwards with the
+     checksums and statistics computed as the bands were converted (see
+     finish_lpgs_xml).
+******************************************************************************/
+int convert_lpgs_to_espa
+(
+    char *lpgs_mtl_file,   /* I: input LPGS MTL metadata filename */
+    char *espa_xml_file,   /* I: output ESPA XML metadata filename */
+    bool del_src,          /* I: should the source .tif files be removed after
+                                 conversion? */
+    bool browse            /* I: should the browse be built as the bands are
+                                 converted? */
+)
+{
+    char FUNC_NAME[] = "convert_lpgs_to_espa";  /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    Espa_internal_meta_t xml_metadata;  /* XML metadata structure to be
+                                populated by reading the MTL metadata file */
+    Espa_name_list_t lpgs_bands;  /* list of the filenames of the LPGS bands */
+    Espa_browse_t *browse_image = NULL;  /* browse being built; NULL if
+                                            none */
+
+    /* Initialize the metadata structure and the band list */
+    init_metadata_struct (&xml_metadata);
+    init_name_list (&lpgs_bands);
+
+    /* Read the LPGS MTL file and populate our internal ESPA metadata
+       structure */
+    if (read_lpgs_mtl (lpgs_mtl_file, &xml_metadata, &lpgs_bands) != SUCCESS)
+    {
+        sprintf (errmsg, "Reading the LPGS MTL file: %s", lpgs_mtl_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        free_name_list (&lpgs_bands);
+        return (ERROR);
+    }
+
+    /* Write the metadata from our internal metadata structure to the output
+       XML filename */
+    if (write_metadata (&xml_metadata, espa_xml_file) != SUCCESS)
+    {  /* Error messages already written */
+        free_name_list (&lpgs_bands);
+        return (ERROR);
+    }
+
+    /* Validate the input metadata file */
+    if (validate_xml_file (espa_xml_file) != SUCCESS)
+    {  /* Error messages already written */
+        free_name_list (&lpgs_bands);
+        return (ERROR);
+    }
+
+    /* Choose the bands of the browse */
+    if (browse)
+    {
+        browse_image = open_espa_browse (&xml_metadata, 0);
+        if (browse_image == NULL)
+        {  /* Error messages already written */
+            free_name_list (&lpgs_bands);
+            return (ERROR);
+        }
+    }
+
+    /* Convert each of the LPGS GeoTIFF files to raw binary */
+    if (convert_lpgs_bands (&xml_metadata, &lpgs_bands, del_src,
+        browse_image) != SUCCESS)
+    {  /* Error messages already written */
+        close_espa_browse (browse_image);
+        free_name_list (&lpgs_bands);
+        return (ERROR);
+    }
+
+    /* Record what was computed as the bands were converted */
+    if (finish_lpgs_xml (&xml_metadata, espa_xml_file, browse_image)
+        != SUCCESS)
+    {  /* Error messages already written */
+        close_espa_browse (browse_image);
+        free_name_list (&lpgs_bands);
+        return (ERROR);
+    }
+
+    /* Free the browse, the metadata structure, and the band list */
+    close_espa_browse (browse_image);
+    free_metadata (&xml_metadata);
+    free_name_list (&lpgs_bands);
+
+    /* Successful conversion */
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  convert_lpgs_to_espa_metadata
+
+PURPOSE: Converts the input LPGS GeoTIFF files (and associated MTL file) to
+the ESPA internal raw binary file format, leaving the ESPA metadata in memory
+rather than writing the XML file.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error converting the GeoTIFF file
+SUCCESS         Successfully converted GeoTIFF to raw binary
+
+NOTES:
+  1. Used by callers which process the bands further before writing the XML
+     file once.  The caller is responsible for validating the metadata when
+     it is written (validate_xml_file) and for freeing it (free_metadata).
+  2. xml_metadata needs to be initialized by init_metadata_struct.
+******************************************************************************/
+int convert_lpgs_to_espa_metadata
+(
+    char *lpgs_mtl_file,   /* I: input LPGS MTL metadata filename */
+    bool del_src,          /* I: should the source .tif files be removed after
+                                 conversion? */
+    Espa_internal_meta_t *xml_metadata  /* O: ESPA metadata of the converted
+                                 bands */
+)
+{
+    char FUNC_NAME[] = "convert_lpgs_to_espa_metadata";  /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    Espa_name_list_t lpgs_bands;  /* list of the filenames of the LPGS bands */
+
+    /* Read the LPGS MTL file and populate our internal ESPA metadata
+       structure */
+    init_name_list (&lpgs_bands);
+    if (read_lpgs_mtl (lpgs_mtl_file, xml_metadata, &lpgs_bands) != SUCCESS)
+    {
+        sprintf (errmsg, "Reading the LPGS MTL file: %s", lpgs_mtl_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        free_name_list (&lpgs_bands);
+        return (ERROR);
+    }
+
+    /* Convert each of the LPGS GeoTIFF files to raw binary */
+    if (convert_lpgs_bands (xml_metadata, &lpgs_bands, del_src, NULL)
+        != SUCCESS)
+    {  /* Error messages already written */
+        free_name_list (&lpgs_bands);
+        return (ERROR);
+    }
+
+    /* Free the band list */
+    free_name_list (&lpgs_bands);
+
+    /* Successful conversion */
+    return (SUCCESS);
+}
+
+
+#ifdef HAVE_LIBARCHIVE
+/******************************************************************************
+MODULE:  open_lpgs_archive
+
+PURPOSE: Opens the Landsat bundle (.tar, .tar.gz, ...) for reading its files
+in order.
+
+RETURN VALUE:
+Type = struct archive *
+Value           Description
+-----           -----------
+NULL            Error opening the bundle
+non-NULL        Opened bundle; free with archive_read_free
+
+NOTES:
+  1. The compression of the bundle is recognized by libarchive.
+******************************************************************************/
+static struct archive *open_lpgs_archive
+(
+    char *archive_file     /* I: name of the Landsat bundle */
+)
+{
+    char FUNC_NAME[] = "open_lpgs_archive";  /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    struct archive *arch = NULL;  /* opened bundle */
+
+    arch = archive_read_new ();
+    if (arch == NULL)
+    {
+        sprintf (errmsg, "Allocating the reader of the bundle: %s",
+            archive_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (NULL);
+    }
+    archive_read_support_filter_all (arch);
+    archive_read_support_format_tar (arch);
+    if (archive_read_open_filename (arch, archive_file,
+        LPGS_ARCHIVE_BLOCK_BYTES) != ARCHIVE_OK)
+    {
+        snprintf (errmsg, sizeof (errmsg), "Opening the bundle %s: %s",
+            archive_file, archive_error_string (arch));
+        error_handler (true, FUNC_NAME, errmsg);
+        archive_read_free (arch);
+        return (NULL);
+    }
+
+    return (arch);
+}
+
+
+/******************************************************************************
+MODULE:  read_lpgs_archive_entry
+
+PURPOSE: Reads the file of the current entry of the Landsat bundle into
+memory.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error reading the file
+SUCCESS         Successfully read the file
+
+NOTES:
+  1. The buffer is allocated here and needs to be freed by the caller.
+******************************************************************************/
+static int read_lpgs_archive_entry
+(
+    struct archive *arch,          /* I: bundle positioned at the entry */
+    struct archive_entry *entry,   /* I: current entry of the bundle */
+    char **buf,                    /* O: bytes of the file */
+    size_t *nbytes                 /* O: number of bytes in the file */
+)
+{
+    char FUNC_NAME[] = "read_lpgs_archive_entry";  /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    size_t nread = 0;        /* number of bytes read so far */
+    la_ssize_t count;        /* number of bytes read by the current call */
+
+    *nbytes = (size_t) archive_entry_size (entry);
+    *buf = malloc (*nbytes + 1);
+    if (*buf == NULL)
+    {
+        snprintf (errmsg, sizeof (errmsg), "Allocating %zu bytes for %s",
+            *nbytes, archive_entry_pathname (entry));
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    while (nread < *nbytes)
+    {
+        count = archive_read_data (arch, *buf + nread, *nbytes - nread);
+        if (count <= 0)
+        {
+            snprintf (errmsg, sizeof (errmsg), "Reading %s from the bundle: "
+                "%s", archive_entry_pathname (entry),
+                count < 0 ? archive_error_string (arch) : "truncated");
+            error_handler (true, FUNC_NAME, errmsg);
+            free (*buf);
+            *buf = NULL;
+            return (ERROR);
+        }
+        nread += count;
+    }
+    (*buf)[*nbytes] = '\0';
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  lpgs_entry_name
+
+PURPOSE: Returns the name of the file of the entry of the Landsat bundle,
+without the directories.
+
+RETURN VALUE:
+Type = const char *
+Value           Description
+-----           -----------
+NULL            The entry isn't a regular file
+non-NULL        Name of the file
+
+NOTES:
+******************************************************************************/
+static const char *lpgs_entry_name
+(
+    struct archive_entry *entry    /* I: current entry of the bundle */
+)
+{
+    const char *name = NULL;       /* path of the entry */
+    const char *cptr = NULL;       /* last directory separator */
+
+    if (archive_entry_filetype (entry) != AE_IFREG)
+        return (NULL);
+    name = archive_entry_pathname (entry);
+    if (name == NULL)
+        return (NULL);
+    cptr = strrchr (name, '/');
+    return (cptr != NULL ? cptr + 1 : name);
+}
+
+
+/******************************************************************************
+MODULE:  read_lpgs_archive_mtl
+
+PURPOSE: Reads the LPGS MTL metadata file out of the Landsat bundle and
+populates the ESPA internal metadata structure.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error reading the metadata file
+SUCCESS         Successfully populated the ESPA metadata structure
+
+NOTES:
+  1. The MTL file is the *_MTL.txt file of the bundle.  It is parsed from
+     memory, so it isn't extracted.
+  2. The bundle is only read up to the MTL file.
+******************************************************************************/
+static int read_lpgs_archive_mtl
+(
+    char *archive_file,              /* I: name of the Landsat bundle */
+    Espa_internal_meta_t *metadata,  /* I/O: metadata structure to be
+                                           populated from the MTL file */
+    Espa_name_list_t *lpgs_bands     /* O: list of the filenames of the LPGS
+                                           bands; free with free_name_list */
+)
+{
+    char FUNC_NAME[] = "read_lpgs_archive_mtl";  /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    char mtl_name[STR_SIZE]; /* name of the MTL file */
+    char *mtl_buf = NULL;    /* bytes of the MTL file */
+    const char *name = NULL; /* name of the file of the current entry */
+    size_t mtl_bytes = 0;    /* number of bytes in the MTL file */
+    size_t len;              /* length of the name */
+    int count;               /* number of chars copied in snprintf */
+    int status;              /* status of reading the bundle */
+    FILE *mtl_fptr = NULL;   /* MTL file in memory */
+    struct archive *arch = NULL;         /* opened bundle */
+    struct archive_entry *entry = NULL;  /* current entry of the bundle */
+
+    arch = open_lpgs_archive (archive_file);
+    if (arch == NULL)
+        return (ERROR);
+
+    /* Find the MTL file and read it into memory */
+    while ((status = archive_read_next_header (arch, &entry)) == ARCHIVE_OK
+        || status == ARCHIVE_WARN)
+    {
+        name = lpgs_entry_name (entry);
+        if (name == NULL)
+            continue;
+        len = strlen (name);
+        if (len < strlen (LPGS_MTL_SUFFIX) ||
+            strcmp (name + len - strlen (LPGS_MTL_SUFFIX), LPGS_MTL_SUFFIX))
+            continue;
+
+        count = snprintf (mtl_name, sizeof (mtl_name), "%s", name);
+        if (count < 0 || count >= sizeof (mtl_name))
+        {
+            sprintf (errmsg, "Overflow of mtl_name string");
+            error_handler (true, FUNC_NAME, errmsg);
+            archive_read_free (arch);
+            return (ERROR);
+        }
+        if (read_lpgs_archive_entry (arch, entry, &mtl_buf, &mtl_bytes)
+            != SUCCESS)
+        {
+            archive_read_free (arch);
+            return (ERROR);
+        }
+        break;
+    }
+    archive_read_free (arch);
+    if (mtl_buf == NULL)
+    {
+        sprintf (errmsg, "No %s file in the bundle: %s", LPGS_MTL_SUFFIX,
+            archive_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Parse the MTL file from memory */
+    mtl_fptr = fmemopen (mtl_buf, mtl_bytes, "r");
+    if (mtl_fptr == NULL)
+    {
+        sprintf (errmsg, "Opening %s in memory", mtl_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        free (mtl_buf);
+        return (ERROR);
+    }
+    status = parse_lpgs_mtl (mtl_fptr, mtl_name, metadata, lpgs_bands);
+    fclose (mtl_fptr);
+    free (mtl_buf);
+
+    return (status);
+}
+
+
+/* LPGS band of the bundle held in memory until it is decoded */
+typedef struct
+{
+    Espa_internal_meta_t *xml_metadata; /* metadata of the ESPA bands */
+    char *band_fname;       /* filename of the LPGS band */
+    int band;               /* index of the band */
+    char *tiff_buf;         /* bytes of the GeoTIFF */
+    size_t tiff_bytes;      /* number of bytes in the GeoTIFF */
+    Espa_browse_t *browse;  /* browse the bands are added to; NULL if none */
+} Lpgs_archive_band_t;
+
+
+/******************************************************************************
+MODULE:  convert_lpgs_archive_band
+
+PURPOSE: Decodes one LPGS GeoTIFF band read from the bundle to raw binary, as
+a task of the task pool, and frees its bytes.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error converting the GeoTIFF
+SUCCESS         Successfully converted the GeoTIFF to raw binary
+
+NOTES:
+******************************************************************************/
+static int convert_lpgs_archive_band
+(
+    void *arg               /* I/O: band to be decoded */
+)
+{
+    char FUNC_NAME[] = "convert_lpgs_archive_bands";  /* function name */
+    char errmsg[STR_SIZE];  /* error message */
+    Lpgs_archive_band_t *band = arg;  /* band to be decoded */
+    int status = SUCCESS;   /* return status */
+
+    printf ("  Band %d: %s to %s\n", band->band, band->band_fname,
+        band->xml_metadata->band[band->band].file_name);
+    if (convert_gtif_buffer_to_img (band->band_fname, band->tiff_buf,
+        band->tiff_bytes, &band->xml_metadata->band[band->band],
+        &band->xml_metadata->global, band->browse,
+        espa_browse_channel (band->browse, band->band)) != SUCCESS)
+    {
+        sprintf (errmsg, "Converting band %d: %s", band->band,
+            band->band_fname);
+        error_handler (true, FUNC_NAME, errmsg);
+        status = ERROR;
+    }
+    free (band->tiff_buf);
+    band->tiff_buf = NULL;
+
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  convert_lpgs_archive_bands
+
+PURPOSE: Converts each of the LPGS GeoTIFF bands in the Landsat bundle to the
+ESPA internal raw binary file of its band in the metadata.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error converting the GeoTIFF files
+SUCCESS         Successfully converted the GeoTIFF files to raw binary
+
+NOTES:
+  1. The bundle is read once, in order.  Each GeoTIFF band is read into
+     memory and decoded from there (see convert_gtif_buffer_to_img), so the
+     raw binary file is the only file written.
+  2. The bands are decoded in tasks of the task pool while the next bands
+     are read from the bundle, with up to lpgs_ingest_threads bands in
+     memory at a time.
+  3. Once a band fails, the rest of the bands are skipped.
+******************************************************************************/
+static int convert_lpgs_archive_bands
+(
+    char *archive_file,                 /* I: name of the Landsat bundle */
+    Espa_internal_meta_t *xml_metadata, /* I: metadata of the ESPA bands */
+    Espa_name_list_t *lpgs_bands,       /* I: list of the filenames of the
+                                              LPGS bands */
+    Espa_browse_t *browse               /* I/O: browse the bands are added
+                                              to; NULL if none */
+)
+{
+    char FUNC_NAME[] = "convert_lpgs_archive_bands";  /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    char *tiff_buf = NULL;   /* bytes of the current GeoTIFF */
+    const char *name = NULL; /* name of the file of the current entry */
+    size_t tiff_bytes;       /* number of bytes in the current GeoTIFF */
+    int i;                   /* looping variable */
+    int nthreads;            /* number of bands in memory at the same time */
+    int ninflight = 0;       /* number of bands being converted */
+    int arch_status;         /* status of reading the bundle */
+    int status = SUCCESS;    /* status of all the bands */
+    bool found[MAX_LPGS_BANDS];  /* has the band been found in the bundle? */
+    Lpgs_archive_band_t bands[MAX_LPGS_BANDS];  /* bands being decoded */
+    Espa_task_group_t group; /* tasks decoding the bands */
+    struct archive *arch = NULL;         /* opened bundle */
+    struct archive_entry *entry = NULL;  /* current entry of the bundle */
+    char (*band_fname)[STR_SIZE] = lpgs_bands->names;  /* array of the
+                                                          filenames */
+
+    for (i = 0; i < lpgs_bands->nnames; i++)
+        found[i] = false;
+
+    arch = open_lpgs_archive (archive_file);
+    if (arch == NULL)
+        return (ERROR);
+
+    nthreads = lpgs_ingest_threads (lpgs_bands->nnames);
+    if (nthreads > 1)
+        printf ("  Converting %d bands at a time\n", nthreads);
+
+    espa_task_group_init (&group);
+    while (espa_task_group_status (&group) == SUCCESS)
+    {
+        arch_status = archive_read_next_header (arch, &entry);
+        if (arch_status == ARCHIVE_EOF)
+            break;
+        if (arch_status != ARCHIVE_OK && arch_status != ARCHIVE_WARN)
+        {
+            snprintf (errmsg, sizeof (errmsg), "Reading the bundle %s: %s",
+                archive_file, archive_error_string (arch));
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+            break;
+        }
+
+        /* Skip the files which aren't LPGS bands; libarchive skips their
+           data on the next header */
+        name = lpgs_entry_name (entry);
+        if (name == NULL)
+            continue;
+        for (i = 0; i < lpgs_bands->nnames; i++)
+            if (!found[i] && !strcmp (name, band_fname[i]))
+                break;
+        if (i == lpgs_bands->nnames)
+            continue;
+        found[i] = true;
+
+        if (read_lpgs_archive_entry (arch, entry, &tiff_buf, &tiff_bytes)
+            != SUCCESS)
+        {
+            status = ERROR;
+            break;
+        }
+
+        /* Decode the band while the next bands are read */
+        bands[i].xml_metadata = xml_metadata;
+        bands[i].band_fname = band_fname[i];
+        bands[i].band = i;
+        bands[i].tiff_buf = tiff_buf;
+        bands[i].tiff_bytes = tiff_bytes;
+        bands[i].browse = browse;
+        espa_task_group_run (&group, convert_lpgs_archive_band, &bands[i]);
+
+        /* Limit the number of bands held in memory */
+        ninflight++;
+        if (ninflight == nthreads)
+        {
+            espa_task_group_wait (&group);
+            ninflight = 0;
+        }
+    }
+    if (espa_task_group_wait (&group) != SUCCESS)
+        status = ERROR;
+    archive_read_free (arch);
+    if (status != SUCCESS)
+        return (ERROR);
+
+    /* Make sure every band was in the bundle */
+    for (i = 0; i < lpgs_bands->nnames; i++)
+    {
+        if (!found[i])
+        {
+            sprintf (errmsg, "Band file %s is not in the bundle: %s",
+                band_fname[i], archive_file);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+    }
+
+    return (SUCCESS);
+}
+#endif
+
+
+/******************************************************************************
+MODULE:  convert_lpgs_archive_to_espa
+
+PURPOSE: Converts the LPGS GeoTIFF files (and associated MTL file) of a
+Landsat bundle (.tar or compressed .tar, such as .tar.gz) to the ESPA internal
+raw binary file format (and associated XML file), without extracting the
+bundle.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error converting the bundle
+SUCCESS         Successfully converted the bundle to raw binary
+
+NOTES:
+  1. Requires the library to be built with ENABLE_LIBARCHIVE=yes (which
+     defines HAVE_LIBARCHIVE).
+  2. The MTL file is read out of the bundle first, then the bundle is read
+     again for the bands (see convert_lpgs_archive_bands).  The first read
+     stops at the MTL file, which is skipped over quickly in an uncompressed
+     bundle.
+  3. The ESPA raw binary band files will be generated from the ESPA XML
+     filename.
+  4. As with convert_lpgs_to_espa, the XML file is written again once the
+     bands are converted.
+******************************************************************************/
+int convert_lpgs_archive_to_espa
+(
+    char *archive_file,    /* I: input Landsat bundle filename */
+    char *espa_xml_file,   /* I: output ESPA XML metadata filename */
+    bool del_src,          /* I: should the bundle be removed after
+                                 conversion? */
+    bool browse            /* I: should the browse be built as the bands are
+                                 converted? */
+)
+{
+    char FUNC_NAME[] = "convert_lpgs_archive_to_espa";  /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+#ifdef HAVE_LIBARCHIVE
+    Espa_internal_meta_t xml_metadata;  /* XML metadata structure to be
+                                populated by reading the MTL metadata file */
+    Espa_name_list_t lpgs_bands;  /* list of the filenames of the LPGS bands */
+    Espa_browse_t *browse_image = NULL;  /* browse being built; NULL if
+                                            none */
+
+    /* Initialize the metadata structure and the band list */
+    init_metadata_struct (&xml_metadata);
+    init_name_list (&lpgs_bands);
+
+    /* Read the LPGS MTL file out of the bundle and populate our internal
+       ESPA metadata structure */
+    if (read_lpgs_archive_mtl (archive_file, &xml_metadata, &lpgs_bands)
+        != SUCCESS)
+    {
+        sprintf (errmsg, "Reading the LPGS MTL file of the bundle: %s",
+            archive_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        free_name_list (&lpgs_bands);
+        return (ERROR);
+    }
+
+    /* Write the metadata from our internal metadata structure to the output
+       XML filename */
+    if (write_metadata (&xml_metadata, espa_xml_file) != SUCCESS)
+    {  /* Error messages already written */
+        free_name_list (&lpgs_bands);
+        return (ERROR);
+    }
+
+    /* Validate the input metadata file */
+    if (validate_xml_file (espa_xml_file) != SUCCESS)
+    {  /* Error messages already written */
+        free_name_list (&lpgs_bands);
+        return (ERROR);
+    }
+
+    /* Choose the bands of the browse */
+    if (browse)
+    {
+        browse_image = open_espa_browse (&xml_metadata, 0);
+        if (browse_image == NULL)
+        {  /* Error messages already written */
+            free_name_list (&lpgs_bands);
+            return (ERROR);
+        }
+    }
+
+    /* Convert each of the LPGS GeoTIFF bands of the bundle to raw binary */
+    if (convert_lpgs_archive_bands (archive_file, &xml_metadata, &lpgs_bands,
+        browse_image) != SUCCESS)
+    {  /* Error messages already written */
+        close_espa_browse (browse_image);
+        free_name_list (&lpgs_bands);
+        return (ERROR);
+    }
+
+    /* Record what was computed as the bands were converted */
+    if (finish_lpgs_xml (&xml_metadata, espa_xml_file, browse_image)
+        != SUCCESS)
+    {  /* Error messages already written */
+        close_espa_browse (browse_image);
+        free_name_list (&lpgs_bands);
+        return (ERROR);
+    }
+    close_espa_browse (browse_image);
+
+    /* Remove the bundle if specified */
+    if (del_src)
+    {
+        printf ("  Removing %s\n", archive_file);
+        if (unlink (archive_file) != 0)
+        {
+            sprintf (errmsg, "Deleting source file: %s", archive_file);
+            error_handler (true, FUNC_NAME, errmsg);
+            free_name_list (&lpgs_bands);
+            return (ERROR);
+        }
+    }
+
+    /* Free the metadata structure and the band list */
+    free_metadata (&xml_metadata);
+    free_name_list (&lpgs_bands);
+
+    /* Successful conversion */
+    return (SUCCESS);
+#else
+    sprintf (errmsg, "Reading the bundle %s requires the library to be built "
+        "with ENABLE_LIBARCHIVE=yes", archive_file);
+    error_handler (true, FUNC_NAME, errmsg);
+    return (ERROR);
+#endif
+}
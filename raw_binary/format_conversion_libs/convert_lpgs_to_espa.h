@@ -24,8 +24,12 @@ NOTES:
 #include "espa_metadata.h"
 #include "espa_geoloc.h"
 #include "raw_binary_io.h"
+#include "raw_binary_writer.h"
+#include "espa_band_stack.h"
+#include "tiff_io.h"
 #include "write_metadata.h"
 #include "envi_header.h"
+#include "espa_browse.h"
 
 /* Defines */
 /* Maximum number of LPGS bands in a file; OLI/TIRS products have the most
@@ -33,6 +37,16 @@ NOTES:
    9 bands; also need to support the 4 angle bands and the RADSAT band. */
 #define MAX_LPGS_BANDS 17
 
+/* Number of bands converted at the same time, unless overridden by the
+   environment variable */
+#define LPGS_INGEST_THREADS_ENV "ESPA_INGEST_THREADS"
+#define LPGS_DEFAULT_INGEST_THREADS 4
+
+/* Suffix of the MTL file in a Landsat bundle, and the size of the blocks the
+   bundle is read in */
+#define LPGS_MTL_SUFFIX "_MTL.txt"
+#define LPGS_ARCHIVE_BLOCK_BYTES 1048576
+
 /* Prototypes */
 int read_lpgs_mtl
 (
@@ -40,24 +54,61 @@ int read_lpgs_mtl
                                            be read */
     Espa_internal_meta_t *metadata,  /* I/O: input metadata structure to be
                                            populated from the MTL file */
-    int *nlpgs_bands,                /* O: number of bands in LPGS product */
-    char lpgs_bands[][STR_SIZE]      /* O: array containing the filenames of
-                                           the LPGS bands */
+    Espa_name_list_t *lpgs_bands     /* O: list of the filenames of the LPGS
+                                           bands; free with free_name_list */
 );
 
 int convert_gtif_to_img
 (
     char *gtif_file,           /* I: name of the input GeoTIFF file */
     Espa_band_meta_t *bmeta,   /* I: pointer to band metadata for this band */
-    Espa_global_meta_t *gmeta  /* I: pointer to global metadata */
+    Espa_global_meta_t *gmeta, /* I: pointer to global metadata */
+    Espa_browse_t *browse,     /* I/O: browse the band is added to; NULL if
+                                     none */
+    int channel                /* I: channel of the band in the browse; -1 if
+                                     the band isn't in it */
+);
+
+int convert_gtif_buffer_to_img
+(
+    char *gtif_file,           /* I: name of the GeoTIFF file, for messages */
+    char *tiff_buf,            /* I: bytes of the GeoTIFF file */
+    size_t tiff_bytes,         /* I: number of bytes in tiff_buf */
+    Espa_band_meta_t *bmeta,   /* I: pointer to band metadata for this band */
+    Espa_global_meta_t *gmeta, /* I: pointer to global metadata */
+    Espa_browse_t *browse,     /* I/O: browse the band is added to; NULL if
+                                     none */
+    int channel                /* I: channel of the band in the browse; -1 if
+                                     the band isn't in it */
 );
 
 int convert_lpgs_to_espa
 (
     char *lpgs_mtl_file,   /* I: input LPGS MTL metadata filename */
     char *espa_xml_file,   /* I: output ESPA XML metadata filename */
-    bool del_src           /* I: should the source .tif files be removed after
+    bool del_src,          /* I: should the source .tif files be removed after
+                                 conversion? */
+    bool browse            /* I: should the browse be built as the bands are
+                                 converted? */
+);
+
+int convert_lpgs_to_espa_metadata
+(
+    char *lpgs_mtl_file,   /* I: input LPGS MTL metadata filename */
+    bool del_src,          /* I: should the source .tif files be removed after
+                                 conversion? */
+    Espa_internal_meta_t *xml_metadata  /* O: ESPA metadata of the converted
+                                 bands */
+);
+
+int convert_lpgs_archive_to_espa
+(
+    char *archive_file,    /* I: input Landsat bundle filename */
+    char *espa_xml_file,   /* I: output ESPA XML metadata filename */
+    bool del_src,          /* I: should the bundle be removed after
                                  conversion? */
+    bool browse            /* I: should the browse be built as the bands are
+                                 converted? */
 );
 
 #endif
@@ -19,7 +19,9 @@ NOTES:
 #include <math.h>
 #include <ctype.h>
 #include "convert_modis_to_espa.h"
+#include "espa_hdf_eos.h"
 #include "doy_to_month_day.h"
+#include "espa_trace.h"
 
 
 /******************************************************************************
@@ -478,207 +480,95 @@ int get_sds_values
 
 
 /******************************************************************************
-MODULE:  read_core_metadata
+MODULE:  copy_odl_value
 
-PURPOSE: Reads the core metadata, searching for the desired fields.
+PURPOSE: Copies the value of a field of the ECS metadata, if it is there.
 
 RETURN VALUE:
 Type = int
 Value           Description
 -----           -----------
-ERROR           Error reading the core metadata
-SUCCESS         Successfully read the core metadata
+ERROR           The value doesn't fit
+SUCCESS         The value was copied, or the field isn't in the metadata
 
 NOTES:
+  1. The value of a field is the VALUE of the OBJECT named for the field.
+     A field which isn't in the metadata leaves the string as it was.
 ******************************************************************************/
-int read_core_metadata
+static int copy_odl_value
 (
-    int32 sd_id,              /* I: file ID for the HDF file */
-    char prod_date_time[],    /* O: production date/time */
-    char pge_version[]        /* O: PGE version */
+    const Espa_odl_t *odl,    /* I: parsed metadata */
+    const char *field,        /* I: name of the field */
+    char *str                 /* O: value of the field (STR_SIZE) */
 )
 {
-    char FUNC_NAME[] = "read_core_metadata";  /* function name */
+    char FUNC_NAME[] = "copy_odl_value";  /* function name */
     char errmsg[STR_SIZE];      /* error message */
-    char attr_name[STR_SIZE];   /* attribute name */
-    char attrname[STR_SIZE];    /* holds the file_name string */
-    char *file_data = NULL;     /* character string used for reading the
-                                   CoreMetadata */
-    char *file_data_ptr = NULL; /* pointer to file_data for scanning */
-    int j;                  /* looping variable */
-    int count;              /* number of chars copied in snprintf */
-    int32 attr_indx = -1;   /* index for the current attribute */
-    int32 data_type;        /* attribute's data type */
-    int32 n_values;         /* number of vals of the attribute */
-    int32 status;           /* return status */
-    bool prod_date_found;   /* production date/time has been found */
-    bool pge_version_found; /* PGE version has been found */
-    int num_chars;          /* number of characters read in the line */
-    char token_buffer[STR_SIZE]; /* holds the current token */
-
-    /* Look for the CoreMetadata in the HDF file */
-    attr_indx = SDfindattr (sd_id, "CoreMetadata");
-
-    /* Only proceed if the attribute was found */
-    if (attr_indx == -1)
-    {
-        /* If not found then try concatenating sequence numbers */
-        for (j = 0; j <= 9; j++)
-        {
-            sprintf (attrname, "CoreMetadata.%d", j);
-            attr_indx = SDfindattr (sd_id, attrname);
-            if (attr_indx != -1)
-                break;
-        }
+    const char *value = NULL;   /* value of the field */
+    int count;                  /* number of chars copied in snprintf */
 
-        if (attr_indx == -1)
-        {
-            sprintf (errmsg, "Unable to locate CoreMetadata for reading");
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
-    }
-
-    /* Get size of HDF file attribute */
-    status = SDattrinfo (sd_id, attr_indx, attr_name, &data_type, &n_values);
-    if (status == -1)
-    {
-        sprintf (errmsg, "Unable to get the size of CoreMetadata attribute");
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
-    }
+    value = espa_odl_find (odl, field, "VALUE");
+    if (value == NULL)
+        return (SUCCESS);
 
-    /* Attempt to allocate memory for HDF file attribute contents (add one
-       character for the end of string character) */
-    file_data = calloc (n_values+1, sizeof (char));
-    if (file_data == NULL)
+    count = snprintf (str, STR_SIZE, "%s", value);
+    if (count < 0 || count >= STR_SIZE)
     {
-        sprintf (errmsg, "Unable to allocate %d bytes for %s", n_values,
-            attr_name);
+        sprintf (errmsg, "Overflow of the %s string", field);
         error_handler (true, FUNC_NAME, errmsg);
         return (ERROR);
     }
 
-    /* Read attribute from the HDF file */
-    status = SDreadattr (sd_id, attr_indx, file_data);
-    if (status == -1 || !strcmp (file_data, ""))
-    {
-        free (file_data);
-        sprintf (errmsg, "Unable to read the CoreMetadata HDF attributes");
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
-    }
-
-    /* Walk through the file_data string one token at a time looking for the
-       production date and PGE version */
-    prod_date_found = false;
-    pge_version_found = false;
-    file_data_ptr = file_data;
-    status = ERROR;
-    while (sscanf (file_data_ptr, "%s%n", token_buffer, &num_chars) != EOF)
-    {
-        /* If this token is END, then we are done with the metadata */
-        if (!strcmp (token_buffer, "END"))
-            break;
-
-        /* If the tokens have already been found, don't waste time with the
-           rest of the metadata */
-        if (prod_date_found && pge_version_found)
-            break;
-
-        /* Increment the file_data_ptr pointer to point to the next token */
-        file_data_ptr += num_chars;
-
-        /* Look for the PRODUCTIONDATETIME token */
-        if (!strcmp (token_buffer, "PRODUCTIONDATETIME") && !prod_date_found)
-        {
-            /* Read the next three tokens, this should be the
-               NUM_VAL = ... line */
-            sscanf (file_data_ptr, "%s%n", token_buffer, &num_chars);
-            file_data_ptr += num_chars;
-
-            sscanf (file_data_ptr, "%s%n", token_buffer, &num_chars);
-            file_data_ptr += num_chars;
-
-            sscanf (file_data_ptr, "%s%n", token_buffer, &num_chars);
-            file_data_ptr += num_chars;
-
-            /* Read the next three tokens, this should be the
-               VALUE = ... line */
-            sscanf (file_data_ptr, "%s%n", token_buffer, &num_chars);
-            file_data_ptr += num_chars;
-
-            sscanf (file_data_ptr, "%s%n", token_buffer, &num_chars);
-            file_data_ptr += num_chars;
-
-            sscanf (file_data_ptr, "%s%n", token_buffer, &num_chars);
-            file_data_ptr += num_chars;
-
-            /* Store the value token (without the surrounding ""s) */
-            count = snprintf (prod_date_time, STR_SIZE, "%s", &token_buffer[1]);
-            if (count < 0 || count >= STR_SIZE)
-            {
-                sprintf (errmsg, "Overflow of prod_date_time string");
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
-            }
-            prod_date_time[strlen(prod_date_time)-1] = '\0';
-
-            /* Production date/time was found */
-            prod_date_found = true;
-        }
-
-        /* Look for the PGEVERSION token */
-        if (!strcmp (token_buffer, "PGEVERSION") && !pge_version_found)
-        {
-            /* Read the next three tokens, this should be the
-               NUM_VAL = ... line */
-            sscanf (file_data_ptr, "%s%n", token_buffer, &num_chars);
-            file_data_ptr += num_chars;
-
-            sscanf (file_data_ptr, "%s%n", token_buffer, &num_chars);
-            file_data_ptr += num_chars;
+    return (SUCCESS);
+}
 
-            sscanf (file_data_ptr, "%s%n", token_buffer, &num_chars);
-            file_data_ptr += num_chars;
 
-            /* Read the next three tokens, this should be the
-               VALUE = ... line */
-            sscanf (file_data_ptr, "%s%n", token_buffer, &num_chars);
-            file_data_ptr += num_chars;
+/******************************************************************************
+MODULE:  read_core_metadata
 
-            sscanf (file_data_ptr, "%s%n", token_buffer, &num_chars);
-            file_data_ptr += num_chars;
+PURPOSE: Reads the core metadata, looking up the desired fields.
 
-            sscanf (file_data_ptr, "%s%n", token_buffer, &num_chars);
-            file_data_ptr += num_chars;
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error reading the core metadata
+SUCCESS         Successfully read the core metadata
 
-            /* Store the value token (without the surrounding ""s) */
-            count = snprintf (pge_version, STR_SIZE, "%s", &token_buffer[1]);
-            if (count < 0 || count >= STR_SIZE)
-            {
-                sprintf (errmsg, "Overflow of pge_version string");
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
-            }
-            pge_version[strlen(pge_version)-1] = '\0';
+NOTES:
+  1. The CoreMetadata is read and parsed once (see read_hdf_eos_odl), and
+     the fields are looked up in its index.
+******************************************************************************/
+int read_core_metadata
+(
+    int32 sd_id,              /* I: file ID for the HDF file */
+    char prod_date_time[],    /* O: production date/time */
+    char pge_version[]        /* O: PGE version */
+)
+{
+    int status;                 /* return status */
+    Espa_odl_t odl;             /* parsed CoreMetadata */
 
-            /* PGE version was found */
-            pge_version_found = true;
-        }
-    }  /* end while */
+    /* Read and parse the CoreMetadata */
+    if (read_hdf_eos_odl (sd_id, "CoreMetadata", &odl) != SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
 
-    /* Free dynamically allocated memory */
-    free (file_data);
+    /* Look up the production date/time and the PGE version */
+    status = copy_odl_value (&odl, "PRODUCTIONDATETIME", prod_date_time);
+    if (status == SUCCESS)
+        status = copy_odl_value (&odl, "PGEVERSION", pge_version);
 
-    return (SUCCESS);
+    espa_odl_free (&odl);
+    return (status);
 }
 
 
 /******************************************************************************
 MODULE:  read_archive_metadata
 
-PURPOSE: Reads the archive metadata, searching for the desired fields.
+PURPOSE: Reads the archive metadata, looking up the desired fields.
 
 RETURN VALUE:
 Type = int
@@ -688,6 +578,9 @@ ERROR           Error reading the archive metadata
 SUCCESS         Successfully read the archive metadata
 
 NOTES:
+  1. The ArchiveMetadata is read and parsed once (see read_hdf_eos_odl), and
+     the bounding coordinates are looked up in its index.  A coordinate
+     which isn't in the metadata is left as it was.
 ******************************************************************************/
 int read_archive_metadata
 (
@@ -695,237 +588,30 @@ int read_archive_metadata
     double *bound_coords      /* O: bounding coordinates */
 )
 {
-    char FUNC_NAME[] = "read_archive_metadata";  /* function name */
-    char errmsg[STR_SIZE];      /* error message */
-    char attr_name[STR_SIZE];   /* attribute name */
-    char attrname[STR_SIZE];    /* holds the file_name string */
-    char *file_data = NULL;     /* character string used for reading the
-                                   ArchiveMetadata */
-    char *file_data_ptr = NULL; /* pointer to file_data for scanning */
-    int j;                  /* looping variable */
-    int32 attr_indx = -1;   /* index for the current attribute */
-    int32 data_type;        /* attribute's data type */
-    int32 n_values;         /* number of vals of the attribute */
-    int32 status;           /* return status */
-    bool north_bound_found; /* north bounding rectangle coord been found? */
-    bool south_bound_found; /* south bounding rectangle coord been found? */
-    bool east_bound_found;  /* east bounding rectangle coord been found? */
-    bool west_bound_found;  /* west bounding rectangle coord been found? */
-    int num_chars;          /* number of characters read in the line */
-    char token_buffer[STR_SIZE]; /* holds the current token */
-
-    /* Look for the ArchiveMetadata in the HDF file */
-    attr_indx = SDfindattr (sd_id, "ArchiveMetadata");
-
-    /* Only proceed if the attribute was found */
-    if (attr_indx == -1)
-    {
-        /* If not found then try concatenating sequence numbers */
-        for (j = 0; j <= 9; j++)
-        {
-            sprintf (attrname, "ArchiveMetadata.%d", j);
-            attr_indx = SDfindattr (sd_id, attrname);
-            if (attr_indx != -1)
-                break;
-        }
-
-        if (attr_indx == -1)
-        {
-            sprintf (errmsg, "Unable to locate ArchiveMetadata for reading");
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
-    }
-
-    /* Get size of HDF file attribute */
-    status = SDattrinfo (sd_id, attr_indx, attr_name, &data_type, &n_values);
-    if (status == -1)
-    {
-        sprintf (errmsg, "Unable to get the size of ArchiveMetadata attribute");
-        error_handler (true, FUNC_NAME, errmsg);
+    static const char *fields[] = {"WESTBOUNDINGCOORDINATE",
+        "EASTBOUNDINGCOORDINATE", "NORTHBOUNDINGCOORDINATE",
+        "SOUTHBOUNDINGCOORDINATE"};  /* fields of the bounding coords */
+    static const int coords[] = {ESPA_WEST, ESPA_EAST, ESPA_NORTH,
+        ESPA_SOUTH};            /* bounding coord of each field */
+    int i;                      /* looping variable for the coords */
+    const char *value = NULL;   /* value of a field */
+    Espa_odl_t odl;             /* parsed ArchiveMetadata */
+
+    /* Read and parse the ArchiveMetadata */
+    if (read_hdf_eos_odl (sd_id, "ArchiveMetadata", &odl) != SUCCESS)
+    {  /* Error messages already written */
         return (ERROR);
     }
 
-    /* Attempt to allocate memory for HDF file attribute contents (add one
-       character for the end of string character) */
-    file_data = calloc (n_values+1, sizeof (char));
-    if (file_data == NULL)
+    /* Look up the bounding coordinates */
+    for (i = 0; i < 4; i++)
     {
-        sprintf (errmsg, "Unable to allocate %d bytes for %s", n_values,
-            attr_name);
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
+        value = espa_odl_find (&odl, fields[i], "VALUE");
+        if (value != NULL)
+            bound_coords[coords[i]] = atof (value);
     }
 
-    /* Read attribute from the HDF file */
-    status = SDreadattr (sd_id, attr_indx, file_data);
-    if (status == -1 || !strcmp (file_data, ""))
-    {
-        free (file_data);
-        sprintf (errmsg, "Unable to read the ArchiveMetadata HDF attributes");
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
-    }
-
-    /* Walk through the file_data string one token at a time looking for the
-       bounding coordinates */
-    north_bound_found = false;
-    south_bound_found = false;
-    east_bound_found = false;
-    west_bound_found = false;
-    file_data_ptr = file_data;
-    status = ERROR;
-    while (sscanf (file_data_ptr, "%s%n", token_buffer, &num_chars) != EOF)
-    {
-        /* If this token is END, then we are done with the metadata */
-        if (!strcmp (token_buffer, "END"))
-            break;
-
-        /* If all the bounding coords have been found, don't waste time with
-           the rest of the metadata */
-        if (north_bound_found && south_bound_found && east_bound_found &&
-            west_bound_found)
-            break;
-
-        /* Increment the file_data_ptr pointer to point to the next token */
-        file_data_ptr += num_chars;
-
-        /* Look for the NORTHBOUNDINGCOORDINATE token */
-        if (!strcmp (token_buffer, "NORTHBOUNDINGCOORDINATE") &&
-            !north_bound_found)
-        {
-            /* Read the next three tokens, this should be the
-               NUM_VAL = ... line */
-            sscanf (file_data_ptr, "%s%n", token_buffer, &num_chars);
-            file_data_ptr += num_chars;
-
-            sscanf (file_data_ptr, "%s%n", token_buffer, &num_chars);
-            file_data_ptr += num_chars;
-
-            sscanf (file_data_ptr, "%s%n", token_buffer, &num_chars);
-            file_data_ptr += num_chars;
-
-            /* Read the next three tokens, this should be the
-               VALUE = ... line */
-            sscanf (file_data_ptr, "%s%n", token_buffer, &num_chars);
-            file_data_ptr += num_chars;
-
-            sscanf (file_data_ptr, "%s%n", token_buffer, &num_chars);
-            file_data_ptr += num_chars;
-
-            sscanf (file_data_ptr, "%s%n", token_buffer, &num_chars);
-            file_data_ptr += num_chars;
-
-            /* Store the value of the bounding coordinate */
-            bound_coords[ESPA_NORTH] = atof (token_buffer);
-            north_bound_found = true;
-            continue;  /* don't waste time looking for the other
-                          bounding rectangles with this token */
-        }
-
-        /* Look for the SOUTHBOUNDINGCOORDINATE token */
-        if (!strcmp (token_buffer, "SOUTHBOUNDINGCOORDINATE") &&
-            !south_bound_found)
-        {
-            /* Read the next three tokens, this should be the
-               NUM_VAL = ... line */
-            sscanf (file_data_ptr, "%s%n", token_buffer, &num_chars);
-            file_data_ptr += num_chars;
-
-            sscanf (file_data_ptr, "%s%n", token_buffer, &num_chars);
-            file_data_ptr += num_chars;
-
-            sscanf (file_data_ptr, "%s%n", token_buffer, &num_chars);
-            file_data_ptr += num_chars;
-
-            /* Read the next three tokens, this should be the
-               VALUE = ... line */
-            sscanf (file_data_ptr, "%s%n", token_buffer, &num_chars);
-            file_data_ptr += num_chars;
-
-            sscanf (file_data_ptr, "%s%n", token_buffer, &num_chars);
-            file_data_ptr += num_chars;
-
-            sscanf (file_data_ptr, "%s%n", token_buffer, &num_chars);
-            file_data_ptr += num_chars;
-
-            /* Store the value of the bounding coordinate */
-            bound_coords[ESPA_SOUTH] = atof (token_buffer);
-            south_bound_found = true;
-            continue;  /* don't waste time looking for the other
-                          bounding rectangles with this token */
-        }
-
-        /* Look for the EASTBOUNDINGCOORDINATE token */
-        if (!strcmp (token_buffer, "EASTBOUNDINGCOORDINATE") &&
-            !east_bound_found)
-        {
-            /* Read the next three tokens, this should be the
-               NUM_VAL = ... line */
-            sscanf (file_data_ptr, "%s%n", token_buffer, &num_chars);
-            file_data_ptr += num_chars;
-
-            sscanf (file_data_ptr, "%s%n", token_buffer, &num_chars);
-            file_data_ptr += num_chars;
-
-            sscanf (file_data_ptr, "%s%n", token_buffer, &num_chars);
-            file_data_ptr += num_chars;
-
-            /* Read the next three tokens, this should be the
-               VALUE = ... line */
-            sscanf (file_data_ptr, "%s%n", token_buffer, &num_chars);
-            file_data_ptr += num_chars;
-
-            sscanf (file_data_ptr, "%s%n", token_buffer, &num_chars);
-            file_data_ptr += num_chars;
-
-            sscanf (file_data_ptr, "%s%n", token_buffer, &num_chars);
-            file_data_ptr += num_chars;
-
-            /* Store the value of the bounding coordinate */
-            bound_coords[ESPA_EAST] = atof (token_buffer);
-            east_bound_found = true;
-            continue;  /* don't waste time looking for the other
-                          bounding rectangles with this token */
-        }
-
-        /* Look for the WESTBOUNDINGCOORDINATE token */
-        if (!strcmp (token_buffer, "WESTBOUNDINGCOORDINATE") &&
-            !west_bound_found)
-        {
-            /* Read the next three tokens, this should be the
-               NUM_VAL = ... line */
-            sscanf (file_data_ptr, "%s%n", token_buffer, &num_chars);
-            file_data_ptr += num_chars;
-
-            sscanf (file_data_ptr, "%s%n", token_buffer, &num_chars);
-            file_data_ptr += num_chars;
-
-            sscanf (file_data_ptr, "%s%n", token_buffer, &num_chars);
-            file_data_ptr += num_chars;
-
-            /* Read the next three tokens, this should be the
-               VALUE = ... line */
-            sscanf (file_data_ptr, "%s%n", token_buffer, &num_chars);
-            file_data_ptr += num_chars;
-
-            sscanf (file_data_ptr, "%s%n", token_buffer, &num_chars);
-            file_data_ptr += num_chars;
-
-            sscanf (file_data_ptr, "%s%n", token_buffer, &num_chars);
-            file_data_ptr += num_chars;
-
-            /* Store the value of the bounding coordinate */
-            bound_coords[ESPA_WEST] = atof (token_buffer);
-            west_bound_found = true;
-            continue;  /* don't waste time looking for the other
-                          bounding rectangles with this token */
-        }
-    }  /* end while */
-
-    /* Free dynamically allocated memory */
-    free (file_data);
-
+    espa_odl_free (&odl);
     return (SUCCESS);
 }
 
@@ -1021,10 +707,6 @@ int read_modis_hdf
     double maxvalue[MAX_MODIS_BANDS];  /* maximum band value for current SDS */
     double fillvalue[MAX_MODIS_BANDS]; /* fill value for current SDS */
 
-    Img_coord_float_t img;        /* image coordinates for current pixel */
-    Geo_coord_t geo;              /* geodetic coordinates (note radians) */
-    Space_def_t geoloc_def;       /* geolocation space information */
-    Geoloc_t *geoloc_map = NULL;  /* geolocation mapping information */
     Espa_global_meta_t *gmeta = &metadata->global;  /* pointer to the global
                                                        metadata structure */
     Espa_band_meta_t *bmeta;      /* pointer to the array of bands metadata */
@@ -1628,149 +1310,275 @@ int read_modis_hdf
     /* Set the orientation angle to 0.0 */
     gmeta->orientation_angle = 0.0;
 
-    /* Get geolocation information from the XML file (using the first band) to
-       prepare for computing the bounding coordinates */
-    if (!get_geoloc_info (metadata, &geoloc_def))
+    /* Get the geographic coords for the UL and LR corners (using the first
+       band), which are the same for every granule of the tile */
+    if (!get_corner_coords (metadata, gmeta->ul_corner, gmeta->lr_corner))
     {
-        sprintf (errmsg, "Copying the geolocation information from the XML "
-            "metadata structure.");
+        sprintf (errmsg, "Computing the UL and LR corners");
         error_handler (true, FUNC_NAME, errmsg);
         return (ERROR);
     }
 
-    /* Setup the mapping structure */
-    geoloc_map = setup_mapping (&geoloc_def);
-    if (geoloc_map == NULL)
+    /* Successful read */
+    return (SUCCESS);
+}
+
+
+/* Block of lines of an SDS, read from the HDF file and waiting to be written
+   to the raw binary file */
+typedef struct
+{
+    int band;                  /* index of the band in the XML metadata */
+    int line0;                 /* 0-based starting line of the block */
+    int nlines;                /* number of lines in the block */
+    int nbytes;                /* number of bytes per pixel */
+    void *buf;                 /* nlines * nsamps * nbytes of pixels */
+} Sds_block_t;
+
+/* Queue of the blocks between the HDF reader and the raw binary writer */
+typedef struct
+{
+    Espa_internal_meta_t *xml_metadata; /* XML metadata structure */
+    Espa_browse_t *browse;     /* browse the bands are added to; NULL if
+                                  none */
+    Sds_block_t block[MODIS_SDS_QUEUE_BLOCKS]; /* ring of blocks */
+    int nblocks;               /* number of blocks in the ring, which fit in
+                                  the memory budget */
+    int head;                  /* next block to be written */
+    int count;                 /* number of blocks queued */
+    bool done;                 /* has the reader queued all the blocks? */
+    bool failed;               /* has the writer failed? */
+    pthread_mutex_t mutex;     /* protects the queue */
+    pthread_cond_t cond;       /* signals changes in the queue */
+} Sds_queue_t;
+
+
+/******************************************************************************
+MODULE:  write_sds_envi_hdr
+
+PURPOSE: Writes the ENVI header file for a band converted from a MODIS SDS.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the ENVI header
+SUCCESS         Successfully wrote the ENVI header
+
+NOTES:
+******************************************************************************/
+static int write_sds_envi_hdr
+(
+    Espa_band_meta_t *bmeta,     /* I: metadata of the band */
+    Espa_global_meta_t *gmeta    /* I: global metadata */
+)
+{
+    char FUNC_NAME[] = "write_sds_envi_hdr";  /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    char *cptr = NULL;        /* pointer to the file extension */
+    char envi_file[STR_SIZE]; /* name of the output ENVI header file */
+    int count;                /* number of chars copied in snprintf */
+    Envi_header_t envi_hdr;   /* output ENVI header information */
+
+    /* Create the ENVI header file this band */
+    if (create_envi_struct (bmeta, gmeta, &envi_hdr) != SUCCESS)
     {
-        sprintf (errmsg, "Setting up the geolocation mapping structure.");
+        sprintf (errmsg, "Creating the ENVI header structure for this "
+            "file: %s", bmeta->file_name);
         error_handler (true, FUNC_NAME, errmsg);
         return (ERROR);
     }
 
-    /* Get the geographic coords for the UL corner */
-    img.l = 0.0;
-    img.s = 0.0;
-    img.is_fill = false;
-    if (!from_space (geoloc_map, &img, &geo))
+    /* Write the ENVI header */
+    count = snprintf (envi_file, sizeof (envi_file), "%s", bmeta->file_name);
+    if (count < 0 || count >= sizeof (envi_file))
     {
-        sprintf (errmsg, "Mapping UL corner to lat/long");
+        sprintf (errmsg, "Overflow of envi_file string");
         error_handler (true, FUNC_NAME, errmsg);
         return (ERROR);
     }
-    gmeta->ul_corner[0] = geo.lat * DEG;
-    gmeta->ul_corner[1] = geo.lon * DEG;
-
-    /* Get the geographic coords for the LR corner */
-    img.l = bmeta[0].nlines-1;
-    img.s = bmeta[0].nsamps-1;
-    img.is_fill = false;
-    if (!from_space (geoloc_map, &img, &geo))
+    cptr = strrchr (envi_file, '.');
+    strcpy (cptr, ".hdr");
+
+    if (write_envi_hdr (envi_file, &envi_hdr) != SUCCESS)
     {
-        sprintf (errmsg, "Mapping UL corner to lat/long");
+        sprintf (errmsg, "Writing the ENVI header file: %s.", envi_file);
         error_handler (true, FUNC_NAME, errmsg);
         return (ERROR);
     }
-    gmeta->lr_corner[0] = geo.lat * DEG;
-    gmeta->lr_corner[1] = geo.lon * DEG;
-
-    /* Free the geolocation structure */
-    free (geoloc_map);
 
-    /* Successful read */
     return (SUCCESS);
 }
 
 
 /******************************************************************************
-MODULE:  convert_hdf_to_img
+MODULE:  sds_writer_thread
 
-PURPOSE: Convert the MODIS HDF SDS to an ESPA raw binary (.img) file and writes
-the associated ENVI header for each band.
+PURPOSE: Thread which writes the queued SDS blocks to the raw binary files,
+while the HDF file is being read by the caller.
 
 RETURN VALUE:
-Type = int
-Value           Description
------           -----------
-ERROR           Error converting the MODIS SDS
-SUCCESS         Successfully converted MODIS SDS to raw binary
+Type = void *
+Value        Description
+-----        -----------
+NULL         Always
 
 NOTES:
+  1. The raw binary file of a band is opened with its first block, and closed
+     and given its ENVI header with its last block.
+  2. Once the writer fails, the remaining blocks are dropped so the reader
+     isn't blocked; the reader stops once it sees the failure.
 ******************************************************************************/
-int convert_hdf_to_img
+static void *sds_writer_thread
 (
-    char *modis_hdf_name,      /* I: name of MODIS file to be processed */
-    Espa_internal_meta_t *xml_metadata /* I: metadata structure for HDF file */
+    void *arg                  /* I: queue of the SDS blocks */
 )
 {
-    char FUNC_NAME[] = "convert_hdf_to_img";  /* function name */
-    char errmsg[STR_SIZE];    /* error message */
-    char *cptr = NULL;        /* pointer to the file extension */
-    char *img_file = NULL;    /* name of the output raw binary file */
-    char envi_file[STR_SIZE]; /* name of the output ENVI header file */
-    int i;                    /* looping variable for bands in XML file */
-    int nbytes;               /* number of bytes in the data type */
-    int count;                /* number of chars copied in snprintf */
-    int32 sd_id;              /* file ID for the HDF file */
-    int32 sds_id;             /* SDS ID in the HDF file */
-    int32 sds_index;          /* index of current SDS name */
-    int32 start[2];           /* starting point to read SDS data */
-    int32 edges[2];           /* number of values to read in SDS data */
-    int32 status;             /* return status of the HDF function */
-    void *file_buf = NULL;    /* pointer to correct input file buffer */
-    FILE *fp_rb = NULL;       /* file pointer for the raw binary file */
-    Envi_header_t envi_hdr;   /* output ENVI header information */
+    char FUNC_NAME[] = "sds_writer_thread";  /* function name */
+    char errmsg[STR_SIZE];     /* error message */
+    Sds_queue_t *queue = arg;  /* queue of the SDS blocks */
+    Espa_internal_meta_t *xml_metadata = queue->xml_metadata;
     Espa_band_meta_t *bmeta = NULL;  /* pointer to band metadata */
-    Espa_global_meta_t *gmeta = &xml_metadata->global;  /* global metadata */
-
-    /* Open as HDF file for reading */
-    sd_id = SDstart (modis_hdf_name, DFACC_RDONLY);
-    if (sd_id < 0)
-    {
-        sprintf (errmsg, "Unable to open %s for reading as SDS",
-            modis_hdf_name);
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
-    }
+    Sds_block_t *blk = NULL;   /* current block */
+    Raw_binary_writer_t *writer = NULL;  /* writer of the current band */
+    int channel;               /* channel of the band in the browse */
+    bool failed = false;       /* has writing failed? */
 
-    /* Loop through the bands in the metadata file and convert each on to
-       the ESPA format */
-    for (i = 0; i < xml_metadata->nbands; i++)
+    while (1)
     {
-        /* Set up the band metadata pointer */
-        bmeta = &xml_metadata->band[i];
+        /* Wait for the next block, or the end of the blocks */
+        pthread_mutex_lock (&queue->mutex);
+        while (queue->count == 0 && !queue->done)
+            pthread_cond_wait (&queue->cond, &queue->mutex);
+        if (queue->count == 0)
+        {
+            pthread_mutex_unlock (&queue->mutex);
+            break;
+        }
+        blk = &queue->block[queue->head];
+        pthread_mutex_unlock (&queue->mutex);
 
-        /* Find the SDS name */
-        sds_index = SDnametoindex (sd_id, bmeta->name);
-        if (sds_index == -1)
+        /* The block is only touched by this thread until it's released */
+        bmeta = &xml_metadata->band[blk->band];
+        if (!failed && blk->line0 == 0)
         {
-            sprintf (errmsg, "Unable to find %s in the HDF file", bmeta->name);
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
+            writer = open_raw_binary_writer (bmeta->file_name,
+                (size_t) bmeta->nlines * bmeta->nsamps * blk->nbytes, 0);
+            if (writer == NULL)
+            {
+                sprintf (errmsg, "Opening the raw binary file: %s",
+                    bmeta->file_name);
+                error_handler (true, FUNC_NAME, errmsg);
+                failed = true;
+            }
+            else if (start_raw_binary_writer_stats (writer, bmeta)
+                != SUCCESS)
+            {
+                sprintf (errmsg, "Starting the statistics of band %s",
+                    bmeta->name);
+                error_handler (true, FUNC_NAME, errmsg);
+                failed = true;
+            }
+            else
+            {
+                channel = espa_browse_channel (queue->browse, blk->band);
+                if (channel >= 0)
+                    start_raw_binary_writer_browse (writer, queue->browse,
+                        channel);
+            }
         }
-        printf ("  SDS %d: %s -- index: %d\n", i, bmeta->name, sds_index);
 
-        /* Open the current band as an SDS */
-        sds_id = SDselect (sd_id, sds_index);
-        if (sds_id < 0)
+        if (!failed && append_raw_binary_writer (writer, blk->nlines,
+            bmeta->nsamps, blk->nbytes, blk->buf) != SUCCESS)
         {
-            sprintf (errmsg, "Unable to access %s for reading", bmeta->name);
+            sprintf (errmsg, "Writing image to the raw binary file: %s",
+                bmeta->file_name);
             error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
+            failed = true;
         }
 
-        /* Open the raw binary file for writing */
-        img_file = bmeta->file_name;
-        fp_rb = open_raw_binary (img_file, "wb");
-        if (fp_rb == NULL)
+        if (!failed && blk->line0 + blk->nlines == bmeta->nlines)
         {
-            sprintf (errmsg, "Opening the output raw binary file: %s",
-                img_file);
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
+            get_raw_binary_writer_checksum (writer, bmeta->checksum);
+            get_raw_binary_writer_stats (writer, &bmeta->stats);
+            if (close_raw_binary_writer (writer) != SUCCESS)
+            {
+                sprintf (errmsg, "Closing the raw binary file: %s",
+                    bmeta->file_name);
+                error_handler (true, FUNC_NAME, errmsg);
+                failed = true;
+            }
+            writer = NULL;
+
+            if (!failed && write_sds_envi_hdr (bmeta, &xml_metadata->global)
+                != SUCCESS)
+            {  /* Error messages already written */
+                failed = true;
+            }
         }
 
-        /* Allocate memory for the entire image, based on the input data type.
-           Since HDF reading works off of a void pointer and the raw binary
+        /* Release the block */
+        pthread_mutex_lock (&queue->mutex);
+        queue->head = (queue->head + 1) % queue->nblocks;
+        queue->count--;
+        if (failed)
+            queue->failed = true;
+        pthread_cond_broadcast (&queue->cond);
+        pthread_mutex_unlock (&queue->mutex);
+    }
+
+    /* Close the band left open by a failure */
+    if (writer != NULL)
+        close_raw_binary_writer (writer);
+
+    return (NULL);
+}
+
+
+/******************************************************************************
+MODULE:  read_sds_blocks
+
+PURPOSE: Reads the SDSs of the bands in blocks of lines and queues the blocks
+for the writer thread.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error reading the SDSs, or the writer failed
+SUCCESS         Successfully read and queued all the SDSs
+
+NOTES:
+  1. HDF4 isn't thread safe, so all the HDF calls are made from this thread.
+******************************************************************************/
+static int read_sds_blocks
+(
+    int32 sd_id,               /* I: file ID for the HDF file */
+    Sds_queue_t *queue         /* I/O: queue of the SDS blocks */
+)
+{
+    char FUNC_NAME[] = "read_sds_blocks";  /* function name */
+    char errmsg[STR_SIZE];     /* error message */
+    int i;                     /* looping variable for bands in XML file */
+    int line;                  /* looping variable for the blocks of lines */
+    int nbytes;                /* number of bytes in the data type */
+    int32 sds_id;              /* SDS ID in the HDF file */
+    int32 sds_index;           /* index of current SDS name */
+    int32 start[2];            /* starting point to read SDS data */
+    int32 edges[2];            /* number of values to read in SDS data */
+    int32 status;              /* return status of the HDF function */
+    bool failed = false;       /* has the writer failed? */
+    Sds_block_t *blk = NULL;   /* block being read */
+    Espa_internal_meta_t *xml_metadata = queue->xml_metadata;
+    Espa_band_meta_t *bmeta = NULL;  /* pointer to band metadata */
+
+    /* Loop through the bands in the metadata file and read each one */
+    for (i = 0; i < xml_metadata->nbands && !failed; i++)
+    {
+        /* Set up the band metadata pointer */
+        bmeta = &xml_metadata->band[i];
+
+        /* Since HDF reading works off of a void pointer and the raw binary
            write works off of a void pointer, there's no need to use a data
            type specific pointer for reading/writing memory.  Just make sure
            there are enough bytes for reading the data, based on the data
@@ -1794,40 +1602,69 @@ int convert_hdf_to_img
             return (ERROR);
         }
 
-        file_buf = calloc (bmeta->nlines * bmeta->nsamps, nbytes);
-        if (file_buf == NULL)
+        /* Find the SDS name */
+        sds_index = SDnametoindex (sd_id, bmeta->name);
+        if (sds_index == -1)
         {
-            sprintf (errmsg, "Allocating memory for the image data containing "
-                "%d lines x %d samples.", bmeta->nlines, bmeta->nsamps);
+            sprintf (errmsg, "Unable to find %s in the HDF file", bmeta->name);
             error_handler (true, FUNC_NAME, errmsg);
             return (ERROR);
         }
+        printf ("  SDS %d: %s -- index: %d\n", i, bmeta->name, sds_index);
 
-        /* Read the entire tile */
-        start[0] = 0;
-        start[1] = 0;
-        edges[0] = bmeta->nlines;
-        edges[1] = bmeta->nsamps;
-        status = SDreaddata (sds_id, start, NULL, edges, file_buf);
-        if (status == -1)
+        /* Open the current band as an SDS */
+        sds_id = SDselect (sd_id, sds_index);
+        if (sds_id < 0)
         {
-            sprintf (errmsg, "Reading data from the SDS: %s", bmeta->name);
+            sprintf (errmsg, "Unable to access %s for reading", bmeta->name);
             error_handler (true, FUNC_NAME, errmsg);
             return (ERROR);
         }
 
-        /* Write entire image to the raw binary file */
-        if (write_raw_binary (fp_rb, bmeta->nlines, bmeta->nsamps, nbytes,
-            file_buf) != SUCCESS)
+        /* Read the SDS a block of lines at a time */
+        for (line = 0; line < bmeta->nlines; line += MODIS_SDS_BLOCK_LINES)
         {
-            sprintf (errmsg, "Writing image to the raw binary file: %s",
-                img_file);
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
+            /* Wait for a free block.  Only the writer touches the queued
+               blocks, so the free block is filled without the lock. */
+            pthread_mutex_lock (&queue->mutex);
+            while (queue->count == queue->nblocks && !queue->failed)
+                pthread_cond_wait (&queue->cond, &queue->mutex);
+            failed = queue->failed;
+            blk = &queue->block[(queue->head + queue->count) %
+                queue->nblocks];
+            pthread_mutex_unlock (&queue->mutex);
+            if (failed)
+                break;
+
+            blk->band = i;
+            blk->line0 = line;
+            blk->nlines = bmeta->nlines - line;
+            if (blk->nlines > MODIS_SDS_BLOCK_LINES)
+                blk->nlines = MODIS_SDS_BLOCK_LINES;
+            blk->nbytes = nbytes;
+
+            start[0] = line;
+            start[1] = 0;
+            edges[0] = blk->nlines;
+            edges[1] = bmeta->nsamps;
+            status = SDreaddata (sds_id, start, NULL, edges, blk->buf);
+            if (status == -1)
+            {
+                sprintf (errmsg, "Reading lines %d to %d from the SDS: %s",
+                    line, line + blk->nlines - 1, bmeta->name);
+                error_handler (true, FUNC_NAME, errmsg);
+                SDendaccess (sds_id);
+                return (ERROR);
+            }
+
+            /* Queue the block for the writer */
+            pthread_mutex_lock (&queue->mutex);
+            queue->count++;
+            pthread_cond_broadcast (&queue->cond);
+            pthread_mutex_unlock (&queue->mutex);
         }
 
-        /* Close the HDF SDS and raw binary file */
-        close_raw_binary (fp_rb);
+        /* Close the HDF SDS */
         status = SDendaccess (sds_id);
         if (status == -1)
         {
@@ -1835,37 +1672,132 @@ int convert_hdf_to_img
             error_handler (true, FUNC_NAME, errmsg);
             return (ERROR);
         }
+    }  /* end for */
 
-        /* Free the memory */
-        free (file_buf);
+    if (failed)
+    {
+        sprintf (errmsg, "Writing the raw binary files failed");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
 
-        /* Create the ENVI header file this band */
-        if (create_envi_struct (bmeta, gmeta, &envi_hdr) != SUCCESS)
-        {
-            sprintf (errmsg, "Creating the ENVI header structure for this "
-                "file: %s", bmeta->file_name);
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
+    return (SUCCESS);
+}
 
-        /* Write the ENVI header */
-        count = snprintf (envi_file, sizeof (envi_file), "%s", img_file);
-        if (count < 0 || count >= sizeof (envi_file))
-        {
-            sprintf (errmsg, "Overflow of envi_file string");
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
-        cptr = strrchr (envi_file, '.');
-        strcpy (cptr, ".hdr");
 
-        if (write_envi_hdr (envi_file, &envi_hdr) != SUCCESS)
+/******************************************************************************
+MODULE:  convert_hdf_to_img
+
+PURPOSE: Convert the MODIS HDF SDS to an ESPA raw binary (.img) file and writes
+the associated ENVI header for each band.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error converting the MODIS SDS
+SUCCESS         Successfully converted MODIS SDS to raw binary
+
+NOTES:
+  1. The SDSs are read in blocks of MODIS_SDS_BLOCK_LINES lines, so only
+     MODIS_SDS_QUEUE_BLOCKS blocks are held in memory no matter the size of
+     the bands.  With a memory budget, fewer blocks are queued if they don't
+     all fit (see espa_mem_fit_count).
+  2. HDF4 isn't thread safe, so the SDSs can't be read in parallel.  Instead
+     the reading of the HDF file is pipelined with the writing of the raw
+     binary files, which is done by a separate thread.
+******************************************************************************/
+int convert_hdf_to_img
+(
+    char *modis_hdf_name,      /* I: name of MODIS file to be processed */
+    Espa_internal_meta_t *xml_metadata, /* I: metadata structure for HDF
+                                               file */
+    Espa_browse_t *browse      /* I/O: browse the bands are added to; NULL if
+                                     none */
+)
+{
+    char FUNC_NAME[] = "convert_hdf_to_img";  /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    int i;                    /* looping variable */
+    int retval;               /* return status */
+    int32 sd_id;              /* file ID for the HDF file */
+    int32 status;             /* return status of the HDF function */
+    size_t line_bytes = 0;    /* largest number of bytes in a line */
+    size_t nbytes;            /* number of bytes in a line of the band */
+    pthread_t writer;         /* writer thread */
+    Sds_queue_t queue;        /* queue between the reader and the writer */
+    Espa_band_meta_t *bmeta = NULL;  /* pointer to band metadata */
+
+    /* Size the blocks for the widest band; float64 is the largest data
+       type */
+    for (i = 0; i < xml_metadata->nbands; i++)
+    {
+        bmeta = &xml_metadata->band[i];
+        nbytes = (size_t) bmeta->nsamps * sizeof (float64);
+        if (nbytes > line_bytes)
+            line_bytes = nbytes;
+    }
+
+    /* Allocate the blocks of the queue */
+    memset (&queue, 0, sizeof (queue));
+    queue.xml_metadata = xml_metadata;
+    queue.browse = browse;
+    queue.nblocks = espa_mem_fit_count (line_bytes * MODIS_SDS_BLOCK_LINES,
+        MODIS_SDS_QUEUE_BLOCKS, 1);
+    for (i = 0; i < queue.nblocks; i++)
+    {
+        queue.block[i].buf = alloc_raw_binary_buf (line_bytes *
+            MODIS_SDS_BLOCK_LINES);
+        if (queue.block[i].buf == NULL)
         {
-            sprintf (errmsg, "Writing the ENVI header file: %s.", envi_file);
+            sprintf (errmsg, "Allocating memory for %d lines of the SDS "
+                "data", MODIS_SDS_BLOCK_LINES);
             error_handler (true, FUNC_NAME, errmsg);
+            for (i--; i >= 0; i--)
+                espa_trace_free (queue.block[i].buf);
             return (ERROR);
         }
-    }  /* end for */
+    }
+
+    /* Open as HDF file for reading */
+    sd_id = SDstart (modis_hdf_name, DFACC_RDONLY);
+    if (sd_id < 0)
+    {
+        sprintf (errmsg, "Unable to open %s for reading as SDS",
+            modis_hdf_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        for (i = 0; i < queue.nblocks; i++)
+            espa_trace_free (queue.block[i].buf);
+        return (ERROR);
+    }
+
+    /* Start the writer and read the SDSs */
+    pthread_mutex_init (&queue.mutex, NULL);
+    pthread_cond_init (&queue.cond, NULL);
+    if (pthread_create (&writer, NULL, sds_writer_thread, &queue) != 0)
+    {
+        sprintf (errmsg, "Starting the raw binary writer thread");
+        error_handler (true, FUNC_NAME, errmsg);
+        retval = ERROR;
+    }
+    else
+    {
+        retval = read_sds_blocks (sd_id, &queue);
+
+        /* Let the writer drain the queue and wait for it */
+        pthread_mutex_lock (&queue.mutex);
+        queue.done = true;
+        pthread_cond_broadcast (&queue.cond);
+        pthread_mutex_unlock (&queue.mutex);
+        pthread_join (writer, NULL);
+        if (queue.failed)
+            retval = ERROR;
+    }
+
+    pthread_cond_destroy (&queue.cond);
+    pthread_mutex_destroy (&queue.mutex);
+    for (i = 0; i < queue.nblocks; i++)
+        espa_trace_free (queue.block[i].buf);
 
     /* Close the HDF file */
     status = SDend (sd_id);
@@ -1877,7 +1809,7 @@ int convert_hdf_to_img
     }
 
     /* Successful conversion */
-    return (SUCCESS);
+    return (retval);
 }
 
 
@@ -1897,13 +1829,17 @@ SUCCESS         Successfully converted MODIS to ESPA format
 NOTES:
   1. The ESPA raw binary band files will be generated from the ESPA XML
      filename.
+  2. The XML file is written again once the bands are converted, with the
+     checksums and statistics computed as they were converted.
 ******************************************************************************/
 int convert_modis_to_espa
 (
     char *modis_hdf_file,  /* I: input MODIS HDF filename */
     char *espa_xml_file,   /* I: output ESPA XML metadata filename */
-    bool del_src           /* I: should the source .tif files be removed after
+    bool del_src,          /* I: should the source .tif files be removed after
                                  conversion? */
+    bool browse            /* I: should the browse be built as the bands are
+                                 converted? */
 )
 {
     char FUNC_NAME[] = "convert_modis_to_espa";  /* function name */
@@ -1912,6 +1848,8 @@ int convert_modis_to_espa
     int count;               /* number of chars copied in snprintf */
     Espa_internal_meta_t xml_metadata;  /* XML metadata structure to be
                                 populated by reading the MTL metadata file */
+    Espa_browse_t *browse_image = NULL;  /* browse being built; NULL if
+                                            none */
 
     /* Initialize the metadata structure */
     init_metadata_struct (&xml_metadata);
@@ -1953,14 +1891,44 @@ int convert_modis_to_espa
         return (ERROR);
     }
 
+    /* Choose the bands of the browse */
+    if (browse)
+    {
+        browse_image = open_espa_browse (&xml_metadata, 0);
+        if (browse_image == NULL)
+        {  /* Error messages already written */
+            return (ERROR);
+        }
+    }
+
     /* Convert each of the MODIS HDF bands/SDSs to raw binary */
-    if (convert_hdf_to_img (modis_hdf_file, &xml_metadata) != SUCCESS)
+    if (convert_hdf_to_img (modis_hdf_file, &xml_metadata, browse_image)
+        != SUCCESS)
     {
         sprintf (errmsg, "Converting %s to ESPA", modis_hdf_file);
         error_handler (true, FUNC_NAME, errmsg);
+        close_espa_browse (browse_image);
         return (ERROR);
     }
 
+    /* Write the metadata again with the checksums and statistics of the
+       bands, and the browse stretched with those statistics */
+    if (write_metadata (&xml_metadata, espa_xml_file) != SUCCESS)
+    {  /* Error messages already written */
+        close_espa_browse (browse_image);
+        return (ERROR);
+    }
+    if (browse_image != NULL)
+    {
+        if (write_espa_browse (browse_image, &xml_metadata, espa_xml_file)
+            != SUCCESS)
+        {  /* Error messages already written */
+            close_espa_browse (browse_image);
+            return (ERROR);
+        }
+        close_espa_browse (browse_image);
+    }
+
     /* Remove the source file if specified */
     if (del_src)
     {
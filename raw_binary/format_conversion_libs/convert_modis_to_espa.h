@@ -18,6 +18,7 @@ NOTES:
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <pthread.h>
 #include <hdf.h>
 #include <mfhdf.h>
 #include <HdfEosDef.h>
@@ -25,8 +26,10 @@ NOTES:
 #include "espa_metadata.h"
 #include "espa_geoloc.h"
 #include "raw_binary_io.h"
+#include "raw_binary_writer.h"
 #include "write_metadata.h"
 #include "envi_header.h"
+#include "espa_browse.h"
 
 /* Defines */
 /* maximum number of MODIS bands/SDSs in a file */
@@ -46,6 +49,13 @@ NOTES:
 #define START_HTILE 18
 #define START_VTILE 21
 
+/* number of lines of an SDS read at a time */
+#define MODIS_SDS_BLOCK_LINES 64
+
+/* number of blocks of SDS lines held between the reading of the HDF file
+   and the writing of the raw binary files */
+#define MODIS_SDS_QUEUE_BLOCKS 4
+
 /* Prototypes */
 int read_modis_hdf
 (
@@ -57,15 +67,20 @@ int read_modis_hdf
 int convert_hdf_to_img
 (
     char *modis_hdf_name,      /* I: name of MODIS file to be processed */
-    Espa_internal_meta_t *xml_metadata /* I: metadata structure for HDF file */
+    Espa_internal_meta_t *xml_metadata, /* I: metadata structure for HDF
+                                               file */
+    Espa_browse_t *browse      /* I/O: browse the bands are added to; NULL if
+                                     none */
 );
 
 int convert_modis_to_espa
 (
     char *modis_hdf_file,  /* I: input MODIS HDF filename */
     char *espa_xml_file,   /* I: output ESPA XML metadata filename */
-    bool del_src           /* I: should the source .tif files be removed after
+    bool del_src,          /* I: should the source .tif files be removed after
                                  conversion? */
+    bool browse            /* I: should the browse be built as the bands are
+                                 converted? */
 );
 
 #endif
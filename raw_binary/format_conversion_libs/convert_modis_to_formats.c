@@ -0,0 +1,331 @@
+/*****************************************************************************
+FILE: convert_modis_to_formats.c
+
+PURPOSE: Contains functions for converting the MODIS HDF-EOS products
+straight to the export formats, streaming the SDSs through the export
+fan-out without the intermediate ESPA raw binary product.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The GeoTIFF sink writes striped GeoTIFFs.  Cloud-Optimized GeoTIFFs
+     need the whole band for their overviews, so they are still made from
+     the raw binary product (see convert_espa_to_gtif).
+*****************************************************************************/
+
+#include <unistd.h>
+#include "convert_modis_to_formats.h"
+
+/* Maximum number of sinks: raw binary, GeoTIFF, and NetCDF */
+#define MAX_MODIS_SINKS 3
+
+/* Reader of the SDSs of the granule, for the export fan-out */
+typedef struct
+{
+    int32 sd_id;           /* file ID for the HDF file */
+    int32 sds_id;          /* SDS of the band being read; -1 if none */
+    int band;              /* index of the band being read; -1 if none */
+} Sds_reader_t;
+
+
+/******************************************************************************
+MODULE:  end_sds_reader_band
+
+PURPOSE: Ends the access to the SDS of the band being read, if any.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error ending the access to the SDS
+SUCCESS         Successfully ended the access
+
+NOTES:
+******************************************************************************/
+static int end_sds_reader_band
+(
+    Sds_reader_t *sds,     /* I/O: reader of the SDSs */
+    Espa_internal_meta_t *xml_metadata  /* I: XML metadata structure */
+)
+{
+    char FUNC_NAME[] = "end_sds_reader_band";  /* function name */
+    char errmsg[STR_SIZE];     /* error message */
+    int32 status;              /* return status of the HDF function */
+
+    if (sds->sds_id == -1)
+        return (SUCCESS);
+
+    status = SDendaccess (sds->sds_id);
+    sds->sds_id = -1;
+    if (status == -1)
+    {
+        sprintf (errmsg, "Ending access to SDS: %s",
+            xml_metadata->band[sds->band].name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  read_sds_lines
+
+PURPOSE: Reads a block of lines of the SDS of a band, for the export fan-out
+(see Espa_export_reader_t).
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error reading the SDS
+SUCCESS         Successfully read the lines
+
+NOTES:
+  1. The SDS of a band is selected with its first block and its access is
+     ended once the next band is read.
+  2. The fan-out calls this from the caller's thread, so all the HDF calls
+     are made from one thread.
+******************************************************************************/
+static int read_sds_lines
+(
+    void *state,               /* I/O: reader of the SDSs */
+    Espa_internal_meta_t *xml_metadata, /* I: XML metadata structure */
+    int band,                  /* I: index of the band */
+    int line0,                 /* I: first line of the block */
+    int nlines,                /* I: number of lines */
+    void *buf                  /* O: lines of the SDS */
+)
+{
+    char FUNC_NAME[] = "read_sds_lines";  /* function name */
+    char errmsg[STR_SIZE];     /* error message */
+    int32 sds_index;           /* index of current SDS name */
+    int32 start[2];            /* starting point to read SDS data */
+    int32 edges[2];            /* number of values to read in SDS data */
+    Sds_reader_t *sds = state; /* reader of the SDSs */
+    Espa_band_meta_t *bmeta = &xml_metadata->band[band];
+
+    if (band != sds->band)
+    {
+        if (end_sds_reader_band (sds, xml_metadata) != SUCCESS)
+            return (ERROR);
+        sds->band = band;
+
+        /* Find the SDS name and open the band as an SDS */
+        sds_index = SDnametoindex (sds->sd_id, bmeta->name);
+        if (sds_index == -1)
+        {
+            sprintf (errmsg, "Unable to find %s in the HDF file", bmeta->name);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+        printf ("  SDS %d: %s -- index: %d\n", band, bmeta->name, sds_index);
+
+        sds->sds_id = SDselect (sds->sd_id, sds_index);
+        if (sds->sds_id < 0)
+        {
+            sds->sds_id = -1;
+            sprintf (errmsg, "Unable to access %s for reading", bmeta->name);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+    }
+
+    start[0] = line0;
+    start[1] = 0;
+    edges[0] = nlines;
+    edges[1] = bmeta->nsamps;
+    if (SDreaddata (sds->sds_id, start, NULL, edges, buf) == -1)
+    {
+        sprintf (errmsg, "Reading lines %d to %d from the SDS: %s", line0,
+            line0 + nlines - 1, bmeta->name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  convert_modis_to_formats
+
+PURPOSE: Converts the input MODIS HDF file straight to the requested export
+formats, and to the ESPA internal raw binary format if asked for.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error converting the MODIS file
+SUCCESS         Successfully converted the MODIS file
+
+NOTES:
+  1. The product ID is pulled from the HDF filename, as by
+     convert_modis_to_espa.
+  2. Each SDS is read once, in blocks of MODIS_SDS_BLOCK_LINES lines, and
+     each block is written by each format in its own thread.
+  3. If asked for, the raw binary product is written by its own sink, with
+     the checksums and statistics of the bands computed as they are
+     written.  The XML files of the export formats then carry them too.
+  4. The source file is only removed once every format has been written.
+******************************************************************************/
+int convert_modis_to_formats
+(
+    char *modis_hdf_file,  /* I: input MODIS HDF filename */
+    char *gtif_file,       /* I: base output GeoTIFF filename; NULL if
+                                 none */
+    char *netcdf_file,     /* I: output NetCDF filename; NULL if none */
+    char *espa_xml_file,   /* I: output ESPA XML metadata filename, whose
+                                 raw binary bands are written too; NULL if
+                                 none */
+    bool no_compression,   /* I: should the NetCDF file be uncompressed? */
+    bool del_src,          /* I: should the source HDF file be removed after
+                                 conversion? */
+    int queue_blocks       /* I: number of blocks in flight between the
+                                 reading of the SDSs and the formats */
+)
+{
+    char FUNC_NAME[] = "convert_modis_to_formats";  /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    char *cptr = NULL;       /* pointer to .hdf extention in the filename */
+    int count;               /* number of chars copied in snprintf */
+    int i;                   /* looping variable for the sinks */
+    int nsinks = 0;          /* number of export sinks */
+    int status = SUCCESS;    /* return status */
+    const char *formats[MAX_MODIS_SINKS - 1] = {"gtif", "netcdf"};
+                             /* export formats, in the registry */
+    char *outfiles[MAX_MODIS_SINKS - 1];  /* output of each format; NULL if
+                                not requested */
+    Sds_reader_t sds;        /* reader of the SDSs */
+    Espa_export_reader_t reader;  /* reader of the bands for the fan-out */
+    Espa_export_options_t options;  /* options of the export formats */
+    Espa_export_sink_t sinks[MAX_MODIS_SINKS];  /* export sinks */
+    Espa_internal_meta_t xml_metadata;  /* XML metadata structure populated
+                                from the MODIS file */
+
+    if (gtif_file == NULL && netcdf_file == NULL && espa_xml_file == NULL)
+    {
+        sprintf (errmsg, "At least one output is required");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Read the MODIS HDF file and populate our internal ESPA metadata
+       structure */
+    init_metadata_struct (&xml_metadata);
+    if (read_modis_hdf (modis_hdf_file, &xml_metadata) != SUCCESS)
+    {
+        sprintf (errmsg, "Reading the MODIS HDF file: %s", modis_hdf_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Add the product ID which is pulled from the MODIS HDF filename
+       ({product_id}.hdf) */
+    count = snprintf (xml_metadata.global.product_id,
+        sizeof (xml_metadata.global.product_id), "%s", modis_hdf_file);
+    if (count < 0 || count >= sizeof (xml_metadata.global.product_id))
+    {
+        sprintf (errmsg, "Overflow of xml_metadata.global.product_id string");
+        error_handler (true, FUNC_NAME, errmsg);
+        free_metadata (&xml_metadata);
+        return (ERROR);
+    }
+    cptr = strrchr (xml_metadata.global.product_id, '.');
+    if (cptr != NULL)
+        *cptr = '\0';
+
+    /* Set up the raw binary sink first, so its checksums and statistics are
+       in the XML files of the formats, then the sink of each format */
+    if (espa_xml_file != NULL)
+    {
+        if (init_raw_binary_export_sink (espa_xml_file, &xml_metadata,
+            &sinks[nsinks]) == SUCCESS)
+            nsinks++;
+        else
+            status = ERROR;
+    }
+    outfiles[0] = gtif_file;
+    outfiles[1] = netcdf_file;
+    options.block_lines = MODIS_SDS_BLOCK_LINES;
+    options.no_compression = no_compression;
+    for (i = 0; status == SUCCESS && i < MAX_MODIS_SINKS - 1; i++)
+    {
+        if (outfiles[i] == NULL)
+            continue;
+        if (init_export_sink (formats[i], outfiles[i], &xml_metadata,
+            &options, &sinks[nsinks]) == SUCCESS)
+            nsinks++;
+        else
+            status = ERROR;
+    }
+    if (status != SUCCESS)
+    {
+        sprintf (errmsg, "Setting up the export formats");
+        error_handler (true, FUNC_NAME, errmsg);
+        for (i = 0; i < nsinks; i++)
+            sinks[i].finish (sinks[i].state, &xml_metadata, false);
+        free_metadata (&xml_metadata);
+        return (ERROR);
+    }
+
+    /* Open as HDF file for reading */
+    sds.sd_id = SDstart (modis_hdf_file, DFACC_RDONLY);
+    sds.sds_id = -1;
+    sds.band = -1;
+    if (sds.sd_id < 0)
+    {
+        sprintf (errmsg, "Unable to open %s for reading as SDS",
+            modis_hdf_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        for (i = 0; i < nsinks; i++)
+            sinks[i].finish (sinks[i].state, &xml_metadata, false);
+        free_metadata (&xml_metadata);
+        return (ERROR);
+    }
+
+    /* Stream the SDSs to all the formats */
+    reader.state = &sds;
+    reader.read_lines = read_sds_lines;
+    if (export_espa_fanout_reader (&xml_metadata, &reader, nsinks, sinks,
+        MODIS_SDS_BLOCK_LINES, queue_blocks) != SUCCESS)
+    {
+        sprintf (errmsg, "Converting %s to the export formats",
+            modis_hdf_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        status = ERROR;
+    }
+
+    /* Close the HDF file */
+    if (end_sds_reader_band (&sds, &xml_metadata) != SUCCESS)
+        status = ERROR;
+    if (SDend (sds.sd_id) == -1)
+    {
+        sprintf (errmsg, "Ending access to HDF file: %s", modis_hdf_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        status = ERROR;
+    }
+    free_metadata (&xml_metadata);
+    if (status != SUCCESS)
+        return (ERROR);
+
+    /* Remove the source file if specified */
+    if (del_src)
+    {
+        printf ("  Removing %s\n", modis_hdf_file);
+        if (unlink (modis_hdf_file) != 0)
+        {
+            sprintf (errmsg, "Deleting source file: %s", modis_hdf_file);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+    }
+
+    /* Successful conversion */
+    return (SUCCESS);
+}
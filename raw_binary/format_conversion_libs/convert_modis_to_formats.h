@@ -0,0 +1,47 @@
+/*****************************************************************************
+FILE: convert_modis_to_formats.h
+
+PURPOSE: Contains defines and prototypes to convert the MODIS HDF-EOS
+products straight to the export formats (GeoTIFF and NetCDF), without the
+intermediate ESPA raw binary product.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The metadata is built from the granule as by convert_modis_to_espa, and
+     the SDSs are read in blocks of lines and fed to the export sinks by the
+     export fan-out (see espa_export_fanout.h).  The raw binary bands and
+     the XML file are only written if asked for.
+  2. The formats are set up through the export registry, so this file
+     doesn't include the NetCDF headers, which clash with HDF4.
+  3. HDF4 isn't thread safe, so the HDF export format, whose sink would run
+     in its own thread while the SDSs are read, isn't supported.
+*****************************************************************************/
+
+#ifndef CONVERT_MODIS_TO_FORMATS_H
+#define CONVERT_MODIS_TO_FORMATS_H
+
+#include "convert_modis_to_espa.h"
+#include "espa_export_registry.h"
+
+/* Prototypes */
+int convert_modis_to_formats
+(
+    char *modis_hdf_file,  /* I: input MODIS HDF filename */
+    char *gtif_file,       /* I: base output GeoTIFF filename; NULL if
+                                 none */
+    char *netcdf_file,     /* I: output NetCDF filename; NULL if none */
+    char *espa_xml_file,   /* I: output ESPA XML metadata filename, whose
+                                 raw binary bands are written too; NULL if
+                                 none */
+    bool no_compression,   /* I: should the NetCDF file be uncompressed? */
+    bool del_src,          /* I: should the source HDF file be removed after
+                                 conversion? */
+    int queue_blocks       /* I: number of blocks in flight between the
+                                 reading of the SDSs and the formats */
+);
+
+#endif
@@ -0,0 +1,827 @@
+/*****************************************************************************
+FILE: convert_raw_binary_bip_to_espa.c
+
+PURPOSE: Contains functions for splitting a single multi-band raw binary
+file, with the bands in the band sequential (BSQ), band interleave by line
+(BIL), or band interleave by pixel (BIP) layout, into the ESPA raw binary
+bands and writing the XML file for this product.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The multi-band file is read a block of lines at a time.  BIP blocks are
+     split into the bands with the transposes of the interleave stage (see
+     raw_binary_interleave.h), spread over the lines of the block, and the
+     bands of the block are then written at the same time, each through its
+     own coalescing writer.
+  2. Packed float bands are converted to 32-bit floats if needed, have
+     their fill pixels set to NaN, and are packed (see espa_cf_pack) as
+     each block is written.
+*****************************************************************************/
+#include <unistd.h>
+#include <math.h>
+#include <sys/stat.h>
+#include "convert_raw_binary_bip_to_espa.h"
+#include "raw_binary_swap.h"
+#include "espa_task_pool.h"
+#include "espa_trace.h"
+
+/* State of the split handed to the line and band tasks */
+typedef struct
+{
+    Espa_interleave_t layout;  /* layout of the bands in the input file */
+    int fd;                    /* input multi-band file */
+    int nbands;                /* number of bands */
+    int nlines;                /* number of lines in each band */
+    int nsamps;                /* number of samples in each band */
+    int size;                  /* number of bytes per value in the input
+                                  file */
+    off_t header_offset;       /* number of bytes before the first band in
+                                  the input file */
+    bool swap;                 /* are the values of the input file in the
+                                  other byte order? */
+    int line0;                 /* first line of the current block */
+    int block_lines;           /* number of lines in the current block */
+    void *in_buf;              /* current block of the input file; not used
+                                  for BSQ */
+    void **band_buf;           /* current block of each band, in the data
+                                  type of the input file */
+    void **out_buf;            /* current block of each band converted to
+                                  its own data type; NULL for the bands
+                                  written directly from band_buf */
+    float **phys_buf;          /* current block of each packed band
+                                  converted to 32-bit floats; NULL for the
+                                  bands not packed or already in floats */
+    void **line_band;          /* band pointers of the line being split by
+                                  each worker, nbands for each worker */
+    Espa_pixel_convert_t *convert; /* kernel converting each band from the
+                                  data type of the input file to its own,
+                                  or to 32-bit floats for a packed band;
+                                  NULL for the bands of that data type */
+    bool *packed;              /* is each band packed? */
+    long *phys_fill;           /* fill value of each packed band before it
+                                  was packed; ESPA_INT_META_FILL if none */
+    Espa_band_meta_t *bmeta;   /* metadata of the output bands */
+    Raw_binary_writer_t **writers; /* writer of each output band */
+} Split_state_t;
+
+
+/******************************************************************************
+MODULE:  split_bip_line
+
+PURPOSE: Splits a line of the current BIP block into the blocks of the bands.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error splitting the line
+SUCCESS         Successfully split the line
+
+NOTES:
+******************************************************************************/
+static int split_bip_line
+(
+    void *arg,              /* I/O: state of the split */
+    int line,               /* I: line within the current block */
+    int worker              /* I: worker splitting the line */
+)
+{
+    Split_state_t *state = arg;  /* state of the split */
+    void **line_band = &state->line_band[(size_t) worker * state->nbands];
+                                 /* band pointers of this worker */
+    size_t offset;               /* byte offset of the line in each band */
+    int i;                       /* looping variable for the bands */
+
+    offset = (size_t) line * state->nsamps * state->size;
+    for (i = 0; i < state->nbands; i++)
+        line_band[i] = (char *) state->band_buf[i] + offset;
+
+    return (deinterleave_raw_binary_bands ((char *) state->in_buf +
+        offset * state->nbands, state->nbands, state->nsamps, state->size,
+        line_band));
+}
+
+
+/******************************************************************************
+MODULE:  write_band_block
+
+PURPOSE: Gathers the current block of lines of a band, converts it to the
+data type of the band if needed, and appends it to the output band.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error reading or writing the block
+SUCCESS         Successfully wrote the block
+
+NOTES:
+  1. BIP blocks have already been split into the bands.  BIL blocks are
+     copied a line at a time from the input block, and BSQ blocks are read
+     straight from the band in the input file.
+  2. Values in the other byte order are swapped before they are converted
+     or written.
+  3. Packed bands are packed from their 32-bit floats, which are converted
+     in place when the input file holds them.
+******************************************************************************/
+static int write_band_block
+(
+    void *arg,              /* I/O: state of the split */
+    int i,                  /* I: index of the band */
+    int worker              /* I: worker writing the band (unused) */
+)
+{
+    char FUNC_NAME[] = "write_band_block";   /* function name */
+    char errmsg[STR_SIZE];       /* error message */
+    Split_state_t *state = arg;  /* state of the split */
+    Espa_band_meta_t *bmeta = &state->bmeta[i];  /* metadata of the band */
+    size_t line_bytes;           /* number of bytes in a line of a band */
+    off_t offset;                /* byte offset of the block in the file */
+    int l;                       /* looping variable for the lines */
+    size_t p;                    /* looping variable for the pixels */
+    size_t npix;                 /* number of pixels in the block */
+    float *phys = NULL;          /* physical values of a packed band */
+    void *out = state->band_buf[i];  /* block written to the band */
+
+    line_bytes = (size_t) state->nsamps * state->size;
+    if (state->layout == ESPA_BSQ_INTERLEAVE)
+    {
+        offset = state->header_offset +
+            ((off_t) i * state->nlines + state->line0) * line_bytes;
+        if (pio_raw_binary (state->fd, false, state->band_buf[i],
+            line_bytes * state->block_lines, offset) != SUCCESS)
+        {
+            sprintf (errmsg, "Reading lines %d-%d of band %s from the BSQ "
+                "file", state->line0, state->line0 + state->block_lines - 1,
+                bmeta->name);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+    }
+    else if (state->layout == ESPA_BIL_INTERLEAVE)
+    {
+        for (l = 0; l < state->block_lines; l++)
+            memcpy ((char *) state->band_buf[i] + l * line_bytes,
+                (char *) state->in_buf + ((size_t) l * state->nbands + i) *
+                line_bytes, line_bytes);
+    }
+
+    /* Values in the other byte order are swapped in place */
+    if (state->swap && swap_raw_binary_bytes (state->band_buf[i],
+        state->band_buf[i], (size_t) state->block_lines * state->nsamps,
+        state->size) != SUCCESS)
+    {
+        sprintf (errmsg, "Swapping the bytes of lines %d-%d of band %s",
+            state->line0, state->line0 + state->block_lines - 1,
+            bmeta->name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Packed bands are packed from their physical values, with the fill
+       pixels set to NaN so they are packed as the packed fill value */
+    npix = (size_t) state->block_lines * state->nsamps;
+    if (state->packed[i])
+    {
+        phys = state->band_buf[i];
+        if (state->convert[i] != NULL)
+        {
+            (*state->convert[i]) (state->band_buf[i], npix,
+                state->phys_buf[i]);
+            phys = state->phys_buf[i];
+        }
+        if (state->phys_fill[i] != ESPA_INT_META_FILL)
+        {
+            for (p = 0; p < npix; p++)
+                if (phys[p] == (float) state->phys_fill[i])
+                    phys[p] = NAN;
+        }
+        espa_cf_pack (bmeta, phys, npix, state->out_buf[i]);
+        out = state->out_buf[i];
+    }
+
+    /* Bands stored in the data type of the input file are converted back to
+       their own data type */
+    else if (state->convert[i] != NULL)
+    {
+        (*state->convert[i]) (state->band_buf[i], npix, state->out_buf[i]);
+        out = state->out_buf[i];
+    }
+
+    if (append_raw_binary_writer (state->writers[i], state->block_lines,
+        state->nsamps, espa_data_type_size (bmeta->data_type), out)
+        != SUCCESS)
+    {
+        sprintf (errmsg, "Writing lines %d-%d of %s", state->line0,
+            state->line0 + state->block_lines - 1, bmeta->file_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  parse_espa_pack_params
+
+PURPOSE: Parses the packing of the float bands from a command-line argument.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           The argument isn't a valid packing
+SUCCESS         Successfully parsed the packing
+
+NOTES:
+  1. The argument is scale,offset with an optional ,int16 or ,uint16 for
+     the packed data type (default int16), ex. 0.0001,0 or 0.01,-100,uint16.
+******************************************************************************/
+int parse_espa_pack_params
+(
+    const char *arg,           /* I: scale,offset[,int16|uint16] */
+    Espa_pack_params_t *pack   /* O: packing of the float bands */
+)
+{
+    char FUNC_NAME[] = "parse_espa_pack_params";  /* function name */
+    char errmsg[STR_SIZE];     /* error message */
+    const char *type = NULL;   /* packed data type, after the offset */
+    int nchars = -1;           /* number of chars in scale,offset */
+    bool valid = true;         /* is the packing valid? */
+
+    if (sscanf (arg, "%f,%f%n", &pack->scale_factor, &pack->add_offset,
+        &nchars) != 2 || nchars < 0)
+        valid = false;
+    else
+    {
+        type = arg + nchars;
+        if (*type == '\0' || !strcmp (type, ",int16"))
+            pack->data_type = ESPA_INT16;
+        else if (!strcmp (type, ",uint16"))
+            pack->data_type = ESPA_UINT16;
+        else
+            valid = false;
+    }
+    if (!valid || pack->scale_factor == 0.0 ||
+        !isfinite (pack->scale_factor) || !isfinite (pack->add_offset))
+    {
+        sprintf (errmsg, "Invalid packing %s; expected scale,offset with a "
+            "nonzero scale and an optional ,int16 or ,uint16", arg);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  split_raw_binary_bands
+
+PURPOSE: Splits a single multi-band raw binary file with the bands in the
+specified layout into the internal ESPA raw binary bands, and writes the
+XML file for the bands.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error converting the file
+SUCCESS         Successfully converted the file
+
+NOTES:
+  1. The bands of the metadata must all be of the same size, and src_file
+     must hold exactly those bands after its header.  The bands are taken
+     to be in the data type of the first band in src_file, and the bands of
+     another data type are converted back to it (see
+     convert_raw_binary_bip_to_espa.h).
+  2. The output bands are named for the output XML file and the band
+     (<espa_xml_file base>_<band name>.img), and get their checksum and
+     statistics from the split.  The file names, checksums, and statistics
+     are updated in the metadata.
+  3. Values in the other byte order are swapped as each block of the bands
+     is written (see raw_binary_swap.h).
+  4. The tiled BIP layout isn't supported.
+  5. With pack, the FLOAT32 and FLOAT64 bands are written as packed integers
+     (see espa_cf_packed_meta).  Their pixels equal to their fill value are
+     packed as the packed fill value.
+******************************************************************************/
+int split_raw_binary_bands
+(
+    char *src_file,        /* I: input multi-band raw binary filename */
+    off_t header_offset,   /* I: number of bytes before the first band in
+                                 src_file */
+    bool swap,             /* I: are the values in src_file in the other
+                                 byte order? */
+    Espa_interleave_t layout, /* I: layout of the bands in src_file (bsq,
+                                 bil, or bip) */
+    Espa_internal_meta_t *xml_metadata, /* I/O: metadata of the bands in
+                                 src_file, in order */
+    char *espa_xml_file,   /* I: output ESPA XML metadata filename; the
+                                 bands are written alongside it */
+    const Espa_pack_params_t *pack, /* I: packing of the float bands; NULL
+                                 to write them as floats */
+    bool del_src           /* I: should src_file and its ENVI header be
+                                 removed after conversion? */
+)
+{
+    char FUNC_NAME[] = "split_raw_binary_bands";  /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    char out_base[STR_SIZE];    /* base name of the output bands */
+    char envi_file[STR_SIZE];   /* name of the ENVI header file */
+    char *cptr = NULL;          /* pointer to the file extension */
+    int i;                      /* looping variable for each band */
+    int l;                      /* looping variable for each line */
+    int nworkers;               /* number of workers splitting the lines */
+    int count;                  /* number of chars copied in snprintf */
+    int status = SUCCESS;       /* return status */
+    size_t block_vals;          /* number of values per band in a full block
+                                   of lines */
+    off_t file_bytes;           /* number of bytes expected in src_file */
+    struct stat st;             /* status of src_file */
+    enum Espa_data_type file_type;  /* data type of the values in
+                                   src_file */
+    Espa_band_meta_t *bmeta = xml_metadata->band;  /* metadata of the
+                                   bands */
+    Split_state_t state;        /* state handed to the line and band tasks */
+    Envi_header_t envi_hdr;     /* output ENVI header information */
+    Espa_trace_span_t span;     /* timing of the current block */
+
+    memset (&state, 0, sizeof (state));
+    state.fd = -1;
+    state.layout = layout;
+    state.header_offset = header_offset;
+    state.swap = swap;
+    if (layout != ESPA_BSQ_INTERLEAVE && layout != ESPA_BIL_INTERLEAVE &&
+        layout != ESPA_BIP_INTERLEAVE)
+    {
+        sprintf (errmsg, "Only the bsq, bil, and bip layouts can be "
+            "converted to ESPA bands");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    state.bmeta = bmeta;
+    state.nbands = xml_metadata->nbands;
+    if (state.nbands < 1)
+    {
+        sprintf (errmsg, "There are no bands to split from %s", src_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    state.nlines = bmeta[0].nlines;
+    state.nsamps = bmeta[0].nsamps;
+    file_type = bmeta[0].data_type;
+    state.size = espa_data_type_size (file_type);
+
+    count = snprintf (out_base, sizeof (out_base), "%s", espa_xml_file);
+    if (count < 0 || count >= sizeof (out_base))
+    {
+        sprintf (errmsg, "Overflow of out_base string");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    cptr = strrchr (out_base, '.');
+    if (cptr != NULL && !strcmp (cptr, ".xml"))
+        *cptr = '\0';
+
+    printf ("convert_raw_binary_%s_to_espa processing %d bands ...\n",
+        layout == ESPA_BSQ_INTERLEAVE ? "bsq" :
+        layout == ESPA_BIL_INTERLEAVE ? "bil" : "bip", state.nbands);
+
+    /* Verify the bands are all of the same size, and pick the kernel
+       converting each band stored in another data type back to its own, or
+       each packed band to floats */
+    state.convert = calloc (state.nbands, sizeof (Espa_pixel_convert_t));
+    state.packed = calloc (state.nbands, sizeof (bool));
+    state.phys_fill = calloc (state.nbands, sizeof (long));
+    state.band_buf = calloc (state.nbands, sizeof (void *));
+    state.out_buf = calloc (state.nbands, sizeof (void *));
+    state.phys_buf = calloc (state.nbands, sizeof (float *));
+    state.writers = calloc (state.nbands, sizeof (Raw_binary_writer_t *));
+    if (state.convert == NULL || state.packed == NULL ||
+        state.phys_fill == NULL || state.band_buf == NULL ||
+        state.out_buf == NULL || state.phys_buf == NULL ||
+        state.writers == NULL)
+    {
+        sprintf (errmsg, "Allocating the state of all %d bands.",
+            state.nbands);
+        error_handler (true, FUNC_NAME, errmsg);
+        status = ERROR;
+        goto done;
+    }
+    if (state.size <= 0)
+    {
+        sprintf (errmsg, "Unsupported data type of band %s", bmeta[0].name);
+        error_handler (true, FUNC_NAME, errmsg);
+        status = ERROR;
+        goto done;
+    }
+    for (i = 0; i < state.nbands; i++)
+    {
+        if (bmeta[i].nlines != state.nlines ||
+            bmeta[i].nsamps != state.nsamps)
+        {
+            sprintf (errmsg, "Size of band %d (%s) does not "
+                "match that of the first band.  All bands of a multi-band "
+                "file are of the same image size.", i+1, bmeta[i].name);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+            goto done;
+        }
+        if (pack != NULL && (bmeta[i].data_type == ESPA_FLOAT32 ||
+            bmeta[i].data_type == ESPA_FLOAT64))
+        {
+            if (file_type != ESPA_FLOAT32)
+            {
+                state.convert[i] = espa_pixel_converter (file_type,
+                    ESPA_FLOAT32);
+                if (state.convert[i] == NULL)
+                {
+                    sprintf (errmsg, "Unsupported data type of band %s",
+                        bmeta[i].name);
+                    error_handler (true, FUNC_NAME, errmsg);
+                    status = ERROR;
+                    goto done;
+                }
+            }
+            state.packed[i] = true;
+            state.phys_fill[i] = bmeta[i].fill_value;
+            espa_cf_packed_meta (&bmeta[i], pack->data_type,
+                pack->scale_factor, pack->add_offset);
+            printf ("Band %s will be packed.\n", bmeta[i].name);
+        }
+        else if (bmeta[i].data_type != file_type)
+        {
+            state.convert[i] = espa_pixel_converter (file_type,
+                bmeta[i].data_type);
+            if (state.convert[i] == NULL)
+            {
+                sprintf (errmsg, "Unsupported data type of band %s",
+                    bmeta[i].name);
+                error_handler (true, FUNC_NAME, errmsg);
+                status = ERROR;
+                goto done;
+            }
+            printf ("Band %s will be converted to its own data type.\n",
+                bmeta[i].name);
+        }
+    }
+
+    /* The input file must hold exactly the bands after its header */
+    state.fd = open_raw_binary_fd (src_file, false);
+    if (state.fd < 0)
+    {
+        sprintf (errmsg, "Opening the input raw binary file: %s", src_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        status = ERROR;
+        goto done;
+    }
+    file_bytes = header_offset + (off_t) state.nlines * state.nsamps *
+        state.nbands * state.size;
+    if (fstat (state.fd, &st) != 0 || st.st_size != file_bytes)
+    {
+        sprintf (errmsg, "Size of %s does not match the %d bands of %d lines "
+            "and %d samples of %d-byte values", src_file,
+            state.nbands, state.nlines, state.nsamps, state.size);
+        error_handler (true, FUNC_NAME, errmsg);
+        status = ERROR;
+        goto done;
+    }
+
+    /* Allocate the blocks.  BSQ blocks are read straight into the bands. */
+    block_vals = (size_t) RB_PREFETCH_DEFAULT_LINES * state.nsamps;
+    if (layout != ESPA_BSQ_INTERLEAVE)
+    {
+        state.in_buf = espa_buffer_get (block_vals * state.nbands *
+            state.size);
+        if (state.in_buf == NULL)
+        {
+            sprintf (errmsg, "Allocating memory for a block of %d lines of "
+                "%d samples for all %d bands.", RB_PREFETCH_DEFAULT_LINES,
+                state.nsamps, state.nbands);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+            goto done;
+        }
+    }
+    for (i = 0; i < state.nbands; i++)
+    {
+        state.band_buf[i] = espa_buffer_get (block_vals * state.size);
+        if (state.convert[i] != NULL || state.packed[i])
+            state.out_buf[i] = espa_buffer_get (block_vals *
+                espa_data_type_size (bmeta[i].data_type));
+        if (state.convert[i] != NULL && state.packed[i])
+            state.phys_buf[i] = espa_buffer_get (block_vals *
+                sizeof (float));
+        if (state.band_buf[i] == NULL ||
+            ((state.convert[i] != NULL || state.packed[i]) &&
+            state.out_buf[i] == NULL) ||
+            (state.convert[i] != NULL && state.packed[i] &&
+            state.phys_buf[i] == NULL))
+        {
+            sprintf (errmsg, "Allocating memory for a block of %d lines of "
+                "%d samples for band %s.", RB_PREFETCH_DEFAULT_LINES,
+                state.nsamps, bmeta[i].name);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+            goto done;
+        }
+    }
+    nworkers = espa_parallel_for_workers (RB_PREFETCH_DEFAULT_LINES, 0);
+    state.line_band = calloc ((size_t) nworkers * state.nbands,
+        sizeof (void *));
+    if (state.line_band == NULL)
+    {
+        sprintf (errmsg, "Allocating the line pointers of all %d bands.",
+            state.nbands);
+        error_handler (true, FUNC_NAME, errmsg);
+        status = ERROR;
+        goto done;
+    }
+
+    /* Point the bands to the output files, and open a writer for each band.
+       The full size of each band is preallocated. */
+    for (i = 0; i < state.nbands; i++)
+    {
+        count = snprintf (bmeta[i].file_name, sizeof (bmeta[i].file_name),
+            "%s_%s.img", out_base, bmeta[i].name);
+        if (count < 0 || count >= sizeof (bmeta[i].file_name))
+        {
+            sprintf (errmsg, "Overflow of file_name string");
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+            goto done;
+        }
+        if (!strcmp (bmeta[i].file_name, src_file))
+        {
+            sprintf (errmsg, "The output band %s would overwrite the input "
+                "file", bmeta[i].file_name);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+            goto done;
+        }
+        strcpy (bmeta[i].encoding, ESPA_STRING_META_FILL);
+        bmeta[i].tile_size = 0;
+        bmeta[i].file_offset = 0;
+        strcpy (bmeta[i].overview_file, ESPA_STRING_META_FILL);
+        bmeta[i].overview_levels = 0;
+        bmeta[i].constant_value = ESPA_FLOAT_META_FILL;
+
+        state.writers[i] = open_raw_binary_writer (bmeta[i].file_name,
+            (size_t) state.nlines * state.nsamps *
+            espa_data_type_size (bmeta[i].data_type), 0);
+        if (state.writers[i] == NULL ||
+            start_raw_binary_writer_stats (state.writers[i], &bmeta[i])
+            != SUCCESS)
+        {
+            sprintf (errmsg, "Opening the output band %s",
+                bmeta[i].file_name);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+            goto done;
+        }
+    }
+
+    /* Loop through the blocks of lines in the input file.  Split each block
+       into the bands and write the bands at the same time. */
+    for (state.line0 = 0; state.line0 < state.nlines;
+         state.line0 += RB_PREFETCH_DEFAULT_LINES)
+    {
+        state.block_lines = state.nlines - state.line0;
+        if (state.block_lines > RB_PREFETCH_DEFAULT_LINES)
+            state.block_lines = RB_PREFETCH_DEFAULT_LINES;
+        for (l = (state.line0 + 99) / 100 * 100;
+             l < state.line0 + state.block_lines; l += 100)
+            printf ("Line %d\n", l);
+
+        span = espa_trace_begin ("split_block", NULL);
+        if (layout != ESPA_BSQ_INTERLEAVE)
+        {
+            /* The lines of a BIP or BIL block are contiguous in the file */
+            if (pio_raw_binary (state.fd, false, state.in_buf,
+                (size_t) state.block_lines * state.nsamps * state.nbands *
+                state.size, header_offset + (off_t) state.line0 *
+                state.nsamps * state.nbands * state.size) != SUCCESS)
+            {
+                sprintf (errmsg, "Reading lines %d-%d of %s", state.line0,
+                    state.line0 + state.block_lines - 1, src_file);
+                error_handler (true, FUNC_NAME, errmsg);
+                status = ERROR;
+                goto done;
+            }
+        }
+        if (layout == ESPA_BIP_INTERLEAVE &&
+            espa_parallel_for (state.block_lines, nworkers, split_bip_line,
+            &state) != SUCCESS)
+        {
+            sprintf (errmsg, "Splitting lines %d-%d of %s", state.line0,
+                state.line0 + state.block_lines - 1, src_file);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+            goto done;
+        }
+        espa_trace_end (&span);
+
+        span = espa_trace_begin ("write_block", NULL);
+        status = espa_parallel_for (state.nbands, 0, write_band_block,
+            &state);
+        espa_trace_end (&span);
+        if (status != SUCCESS)
+        {  /* Error messages already written */
+            goto done;
+        }
+    }
+
+    /* Close the output bands with their checksums and statistics */
+    for (i = 0; i < state.nbands; i++)
+    {
+        get_raw_binary_writer_checksum (state.writers[i], bmeta[i].checksum);
+        get_raw_binary_writer_stats (state.writers[i], &bmeta[i].stats);
+        status = close_raw_binary_writer (state.writers[i]);
+        state.writers[i] = NULL;
+        if (status != SUCCESS)
+        {
+            sprintf (errmsg, "Closing the output band %s",
+                bmeta[i].file_name);
+            error_handler (true, FUNC_NAME, errmsg);
+            goto done;
+        }
+    }
+
+    /* Create the ENVI header file for each band */
+    for (i = 0; i < state.nbands; i++)
+    {
+        if (create_envi_struct (&bmeta[i], &xml_metadata->global, &envi_hdr)
+            != SUCCESS)
+        {
+            sprintf (errmsg, "Creating the ENVI header structure for this "
+                "file: %s", bmeta[i].file_name);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+            goto done;
+        }
+
+        strcpy (envi_file, bmeta[i].file_name);
+        cptr = strrchr (envi_file, '.');
+        strcpy (cptr, ".hdr");
+        if (write_envi_hdr (envi_file, &envi_hdr) != SUCCESS)
+        {
+            sprintf (errmsg, "Writing the ENVI header file: %s.", envi_file);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+            goto done;
+        }
+    }
+
+    /* Write the new XML file */
+    if (write_metadata (xml_metadata, espa_xml_file) != SUCCESS)
+    {
+        sprintf (errmsg, "Error writing the XML for the ESPA product: %s",
+            espa_xml_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        status = ERROR;
+        goto done;
+    }
+
+    /* Remove the source file and its header if specified */
+    if (del_src)
+    {
+        close_raw_binary_fd (state.fd);
+        state.fd = -1;
+        printf ("  Removing %s\n", src_file);
+        if (unlink (src_file) != 0)
+        {
+            sprintf (errmsg, "Deleting source file: %s", src_file);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+            goto done;
+        }
+
+        strcpy (envi_file, src_file);
+        cptr = strrchr (envi_file, '.');
+        if (cptr != NULL && strchr (cptr, '/') == NULL)
+            strcpy (cptr, ".hdr");
+        else
+            strcat (envi_file, ".hdr");
+        if (access (envi_file, F_OK) == 0)
+        {
+            printf ("  Removing %s\n", envi_file);
+            if (unlink (envi_file) != 0)
+            {
+                sprintf (errmsg, "Deleting source file: %s", envi_file);
+                error_handler (true, FUNC_NAME, errmsg);
+                status = ERROR;
+                goto done;
+            }
+        }
+    }
+
+done:
+    if (state.fd >= 0)
+        close_raw_binary_fd (state.fd);
+    for (i = 0; i < state.nbands; i++)
+    {
+        if (state.writers != NULL && state.writers[i] != NULL)
+            close_raw_binary_writer (state.writers[i]);
+        if (state.band_buf != NULL && state.band_buf[i] != NULL)
+            espa_buffer_put (state.band_buf[i]);
+        if (state.out_buf != NULL && state.out_buf[i] != NULL)
+            espa_buffer_put (state.out_buf[i]);
+        if (state.phys_buf != NULL && state.phys_buf[i] != NULL)
+            espa_buffer_put (state.phys_buf[i]);
+    }
+    if (state.in_buf != NULL)
+        espa_buffer_put (state.in_buf);
+    free (state.line_band);
+    free (state.writers);
+    free (state.phys_buf);
+    free (state.out_buf);
+    free (state.band_buf);
+    free (state.phys_fill);
+    free (state.packed);
+    free (state.convert);
+
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  convert_raw_binary_interleave_to_espa
+
+PURPOSE: Splits a single multi-band raw binary file with the bands in the
+specified layout into the internal ESPA raw binary bands, with the bands
+described by a template, and writes the XML file for the bands.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error converting the file
+SUCCESS         Successfully converted the file
+
+NOTES:
+  1. See split_raw_binary_bands.  in_file must hold exactly the bands of the
+     template.
+  2. in_file may be NULL to split the file named by the bands of the
+     template, as written by convert_espa_to_raw_binary_interleave.
+******************************************************************************/
+int convert_raw_binary_interleave_to_espa
+(
+    char *in_file,         /* I: input multi-band raw binary filename */
+    Espa_interleave_t layout, /* I: layout of the bands in in_file (bsq,
+                                 bil, or bip) */
+    char *template_xml,    /* I: ESPA XML metadata describing the bands of
+                                 in_file, in order */
+    char *espa_xml_file,   /* I: output ESPA XML metadata filename; the
+                                 bands are written alongside it */
+    const Espa_pack_params_t *pack, /* I: packing of the float bands; NULL
+                                 to write them as floats */
+    bool del_src           /* I: should in_file and its ENVI header be
+                                 removed after conversion? */
+)
+{
+    char FUNC_NAME[] = "convert_raw_binary_interleave_to_espa";
+                                /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    char src_file[STR_SIZE];    /* input multi-band raw binary filename */
+    int count;                  /* number of chars copied in snprintf */
+    int status;                 /* return status */
+    Espa_internal_meta_t xml_metadata;  /* XML metadata of the bands */
+
+    /* Read the bands from the template */
+    init_metadata_struct (&xml_metadata);
+    if (validate_and_parse_metadata (template_xml, &xml_metadata) != SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+    if (xml_metadata.nbands < 1)
+    {
+        sprintf (errmsg, "There are no bands in the template %s",
+            template_xml);
+        error_handler (true, FUNC_NAME, errmsg);
+        free_metadata (&xml_metadata);
+        return (ERROR);
+    }
+
+    count = snprintf (src_file, sizeof (src_file), "%s",
+        in_file != NULL ? in_file : xml_metadata.band[0].file_name);
+    if (count < 0 || count >= sizeof (src_file))
+    {
+        sprintf (errmsg, "Overflow of src_file string");
+        error_handler (true, FUNC_NAME, errmsg);
+        free_metadata (&xml_metadata);
+        return (ERROR);
+    }
+
+    status = split_raw_binary_bands (src_file, 0, false, layout,
+        &xml_metadata, espa_xml_file, pack, del_src);
+
+    free_metadata (&xml_metadata);
+    return (status);
+}
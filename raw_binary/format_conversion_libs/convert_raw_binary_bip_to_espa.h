@@ -0,0 +1,91 @@
+/*****************************************************************************
+FILE: convert_raw_binary_bip_to_espa.h
+
+PURPOSE: Contains prototypes to split a single multi-band raw binary file in
+the BSQ, BIL, or BIP layout into the ESPA raw binary format, one band per
+file, with the XML metadata of the bands taken from a template product.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. This is the inverse of convert_espa_to_raw_binary_interleave.  The
+     template is ESPA XML metadata describing the bands of the multi-band
+     file in order, such as the XML written with the file by
+     convert_espa_to_bip, or one written for the outputs of a model.
+  2. Bands of a different data type than the first band are taken to be
+     stored in the data type of the first band (as convert_espa_to_bip
+     --convert_qa writes them) and are converted back to their own data
+     type.
+  3. The float bands may be packed into 16-bit integers with a scale factor
+     and add offset (see espa_cf_packing.h), which halves their size.
+*****************************************************************************/
+
+#ifndef CONVERT_RAW_BINARY_BIP_TO_ESPA_H
+#define CONVERT_RAW_BINARY_BIP_TO_ESPA_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <sys/types.h>
+#include "error_handler.h"
+#include "espa_metadata.h"
+#include "convert_espa_to_raw_binary_bip.h"
+#include "espa_cf_packing.h"
+
+/* Packing of the float bands (physical = packed * scale_factor +
+   add_offset) */
+typedef struct
+{
+    enum Espa_data_type data_type; /* packed data type; ESPA_INT16 or
+                                      ESPA_UINT16 */
+    float scale_factor;            /* scale factor; not 0 */
+    float add_offset;              /* add offset */
+} Espa_pack_params_t;
+
+/* Prototypes */
+int parse_espa_pack_params
+(
+    const char *arg,           /* I: scale,offset[,int16|uint16] */
+    Espa_pack_params_t *pack   /* O: packing of the float bands */
+);
+
+int split_raw_binary_bands
+(
+    char *src_file,        /* I: input multi-band raw binary filename */
+    off_t header_offset,   /* I: number of bytes before the first band in
+                                 src_file */
+    bool swap,             /* I: are the values in src_file in the other
+                                 byte order? */
+    Espa_interleave_t layout, /* I: layout of the bands in src_file (bsq,
+                                 bil, or bip) */
+    Espa_internal_meta_t *xml_metadata, /* I/O: metadata of the bands in
+                                 src_file, in order; the file names,
+                                 checksums, and statistics are updated */
+    char *espa_xml_file,   /* I: output ESPA XML metadata filename; the
+                                 bands are written alongside it */
+    const Espa_pack_params_t *pack, /* I: packing of the float bands; NULL
+                                 to write them as floats */
+    bool del_src           /* I: should src_file and its ENVI header be
+                                 removed after conversion? */
+);
+
+int convert_raw_binary_interleave_to_espa
+(
+    char *in_file,         /* I: input multi-band raw binary filename */
+    Espa_interleave_t layout, /* I: layout of the bands in in_file (bsq,
+                                 bil, or bip) */
+    char *template_xml,    /* I: ESPA XML metadata describing the bands of
+                                 in_file, in order */
+    char *espa_xml_file,   /* I: output ESPA XML metadata filename; the
+                                 bands are written alongside it */
+    const Espa_pack_params_t *pack, /* I: packing of the float bands; NULL
+                                 to write them as floats */
+    bool del_src           /* I: should in_file and its ENVI header be
+                                 removed after conversion? */
+);
+
+#endif
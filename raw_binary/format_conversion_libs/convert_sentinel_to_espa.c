@@ -18,12 +18,24 @@ NOTES:
      as well as the latest format.  Both are supported by this application.
      Only S2A data will be in the old format, since S2B didn't come online
      until March of 2017.
+  3. The files of a granule are named by their directory rather than relative
+     to the current directory, so several granules may be converted by the
+     threads of one process (see convert_sentinel_batch).
 *****************************************************************************/
 #include <unistd.h>
 #include <ctype.h>
 #include <dirent.h>
 #include <string.h>
+#ifdef HAVE_OPENJPEG
+#include <openjpeg.h>
+
+/* Coordinate a at 2^b times coarser resolution, as OpenJPEG computes it */
+#define JP2_CEIL_DIV_POW2(a, b) (((a) + (1 << (b)) - 1) >> (b))
+#endif
 #include "convert_sentinel_to_espa.h"
+#include "espa_remote.h"
+#include "espa_task_pool.h"
+#include "espa_trace.h"
 
 /* Band information for the Sentinel-2 L1C products. Ignore TCI (true color
    image). */
@@ -33,10 +45,52 @@ char sentinel_bands[NUM_SENTINEL_BANDS][STR_SIZE] =
 char sentinel_band_nums[NUM_SENTINEL_BANDS][STR_SIZE] =
     {"1", "2", "3", "4", "5", "6", "7", "8", "8A", "9", "10", "11", "12"};
 
+/******************************************************************************
+MODULE:  sentinel_path
+
+PURPOSE: Names a file of a granule by the directory (or URL) holding it.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           The path doesn't fit
+SUCCESS         Successfully named the file
+
+NOTES:
+******************************************************************************/
+static int sentinel_path
+(
+    char *dir,        /* I: directory or URL of the file; NULL for the
+                            current directory */
+    char *file,       /* I: name of the file */
+    char *path        /* O: path of the file (STR_SIZE characters) */
+)
+{
+    char FUNC_NAME[] = "sentinel_path";  /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    int count;                  /* number of chars copied in snprintf */
+
+    if (dir == NULL || dir[0] == '\0')
+        count = snprintf (path, STR_SIZE, "%s", file);
+    else
+        count = snprintf (path, STR_SIZE, "%s%s%s", dir,
+            dir[strlen(dir)-1] == '/' ? "" : "/", file);
+    if (count < 0 || count >= STR_SIZE)
+    {
+        sprintf (errmsg, "Overflow of the path of %s", file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
 /******************************************************************************
 MODULE:  read_dir
 
-PURPOSE: Read the current directory and look for the band 1 Sentinel-2 file.
+PURPOSE: Read the granule directory and look for the band 1 Sentinel-2 file.
 
 RETURN VALUE:
 Type = char *
@@ -46,20 +100,30 @@ NULL            Error reading the directory and successful find of band 1
 non-NULL        Band 1 filename was successfully found
 
 NOTES:
+  1. The name is copied to b1_name, since the directory entry is freed when
+     the directory is closed.
 ******************************************************************************/
-char *read_dir ()
+char *read_dir
+(
+    char *granule_dir,        /* I: directory of the granule; NULL for the
+                                    current directory */
+    char *b1_name             /* O: band 1 Sentinel-2 filename (STR_SIZE
+                                    characters) */
+)
 {
     char FUNC_NAME[] = "read_dir";  /* function name */
     char errmsg[STR_SIZE];      /* error message */
-    char *b1_name = NULL;       /* band 1 Sentinel-2 filename */
-    DIR *dr = NULL;             /* ptr to current directory */
+    char *found = NULL;         /* band 1 filename, if found */
+    DIR *dr = NULL;             /* ptr to granule directory */
     struct dirent *de = NULL;   /* ptr for directory entry */
   
-    /* Open the current directory */
-    dr = opendir(".");
+    /* Open the granule directory */
+    if (granule_dir == NULL)
+        granule_dir = ".";
+    dr = opendir (granule_dir);
     if (dr == NULL)
     {
-        sprintf (errmsg, "Could not open current directory");
+        sprintf (errmsg, "Could not open directory %s", granule_dir);
         error_handler (true, FUNC_NAME, errmsg);
         return (NULL);
     }
@@ -68,9 +132,11 @@ char *read_dir ()
     while ((de = readdir (dr)) != NULL)
     {
         /* Is this band 1? */
-        if (strstr (de->d_name, "_B01.jp2"))
+        if (strstr (de->d_name, "_B01.jp2") &&
+            strlen (de->d_name) < STR_SIZE)
         {
-            b1_name = de->d_name;
+            strcpy (b1_name, de->d_name);
+            found = b1_name;
             break;
         }
     }
@@ -79,7 +145,7 @@ char *read_dir ()
     closedir (dr);
 
     /* Return the band 1 name (or NULL if not found) */
-    return (b1_name);
+    return (found);
 }
 
 
@@ -108,10 +174,17 @@ Where:
 
 Example: S2A_MSI_L1C_T10TFR_20180816_20180903
 
+The remote JP2 files can't be renamed, so for them only the product ID and
+the filenames in the metadata are updated, which names the raw binary files.
+The filenames in the metadata stay relative to the granule directory.
+
 ******************************************************************************/
 int rename_jp2
 (
-    Espa_internal_meta_t *xml_metadata /* I: valid ESPA metadata structure */
+    Espa_internal_meta_t *xml_metadata, /* I: valid ESPA metadata structure */
+    char *granule_dir,         /* I: directory of the JP2 files; NULL for the
+                                     current directory */
+    bool rename_files          /* I: should the JP2 files be renamed? */
 )
 {
     const int TILE_CHARS=6;  /* number of chars in the S2 tile name */
@@ -123,6 +196,8 @@ int rename_jp2
     char FUNC_NAME[] = "rename_jp2";  /* function name */
     char errmsg[STR_SIZE];      /* error message */
     char newfile[STR_SIZE];     /* name of the new Sentinel file */
+    char oldpath[STR_SIZE];     /* path of the original Sentinel file */
+    char newpath[STR_SIZE];     /* path of the new Sentinel file */
     char acq_date[DATE_CHARS+1];  /* acquisition date */
     char prod_date[DATE_CHARS+1]; /* production date */
     char s2_tile[TILE_CHARS+1]; /* Sentinel tile */
@@ -192,7 +267,11 @@ printf ("DEBUG: s2_tile: %s\n", s2_tile);
 
         /* Rename the current JP2 filename to {product_id}_{bandname}.jp2 */
         sprintf (newfile, "%s_%s.jp2", gmeta->product_id, sentinel_bands[i]);
-        if (rename (bmeta->file_name, newfile))
+        if (rename_files &&
+            (sentinel_path (granule_dir, bmeta->file_name, oldpath)
+             != SUCCESS ||
+             sentinel_path (granule_dir, newfile, newpath) != SUCCESS ||
+             rename (oldpath, newpath)))
         {
             sprintf (errmsg, "Unable to rename the original Sentinel JP2 "
                 "file (%s) to the new ESPA filename (%s)", bmeta->file_name,
@@ -217,302 +296,1504 @@ printf ("DEBUG: s2_tile: %s\n", s2_tile);
 }
 
 
+#ifdef HAVE_OPENJPEG
 /******************************************************************************
-MODULE:  convert_jp2_to_img
+MODULE:  jp2_error_callback
 
-PURPOSE: Convert the Sentinel JP2 bands to an ESPA raw binary (.img) file,
-and generate the ENVI header file.
+PURPOSE: Reports the errors of the OpenJPEG decoder.
 
 RETURN VALUE:
-Type = int
-Value           Description
------           -----------
-ERROR           Error converting the JP2 file
-SUCCESS         Successfully converted JP2 file
+Type = None
 
 NOTES:
+  1. The client data is the name of the JP2 file being decoded.
 ******************************************************************************/
-int convert_jp2_to_img
+static void jp2_error_callback
 (
-    Espa_internal_meta_t *xml_metadata /* I: valid ESPA metadata structure */
+    const char *msg,         /* I: error message of the decoder */
+    void *client_data        /* I: name of the JP2 file */
 )
 {
-    char FUNC_NAME[] = "convert_jp2_to_img";  /* function name */
-    char errmsg[STR_SIZE];    /* error message */
-    char *cptr = NULL;        /* pointer to the file extension */
-    char envi_file[STR_SIZE]; /* name of the output ENVI header file */
-    char raw_file[STR_SIZE];  /* name of the output raw binary file (.raw) */
-    char jp2_cmd[STR_SIZE];   /* command string for opj_decompress */
-    int i;                    /* looping variable for bands in XML file */
-    int count;                /* number of chars copied in snprintf */
-    Envi_header_t envi_hdr;   /* output ENVI header information */
-    Espa_band_meta_t *bmeta = NULL;  /* pointer to band metadata */
-    Espa_global_meta_t *gmeta = &xml_metadata->global;  /* global metadata */
+    char FUNC_NAME[] = "decode_jp2_band";  /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    char *cptr = NULL;       /* pointer to the trailing newline */
+
+    snprintf (errmsg, sizeof (errmsg), "%s: %s", (char *) client_data, msg);
+    cptr = strrchr (errmsg, '\n');
+    if (cptr != NULL)
+        *cptr = '\0';
+    error_handler (true, FUNC_NAME, errmsg);
+}
 
-    // TODO: execute this in the loop below for better error handling
-    strcpy (jp2_cmd, "for i in *.jp2; do gdal_translate -of ENVI $i ${i%.jp2}; done");
-    if (system (jp2_cmd) == -1)
-    {
-        sprintf (errmsg, "Decompressing JP2 files: %s. Make sure the current "
-            "directory is writable and the GDAL gdal_translate tool is in "
-            "your system PATH", jp2_cmd);
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
-    }
 
-    /* Loop through the bands in the metadata file and convert each one to
-       the ESPA format */
-    for (i = 0; i < xml_metadata->nbands; i++)
-    {
-        /* Set up the band metadata pointer */
-        bmeta = &xml_metadata->band[i];
+/* Position of the OpenJPEG stream of a remote JP2 file */
+typedef struct
+{
+    Espa_remote_t *remote;     /* remote JP2 file */
+    OPJ_OFF_T offset;          /* offset of the next read */
+} Jp2_remote_stream_t;
 
-        /* Determine the name of the output raw binary file.  Replace the
-           jp2 file extension with img in the Sentinel filenames. */
-        cptr = strrchr (bmeta->file_name, '.');
-        if (cptr == NULL)
-        {
-            sprintf (errmsg, "No file extension found in the Sentinel JP2 "
-                "file: %s\n", bmeta->file_name);
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
-        strcpy (cptr, ".img");
+/* Procedures for OpenJPEG to read a remote JP2 file */
+static OPJ_SIZE_T jp2_remote_read (void *buf, OPJ_SIZE_T nbytes, void *data)
+{
+    Jp2_remote_stream_t *rstream = (Jp2_remote_stream_t *) data;
+    OPJ_OFF_T file_bytes = rstream->remote->nbytes;
+
+    if (rstream->offset >= file_bytes)
+        return (OPJ_SIZE_T) -1;   /* end of the stream */
+    if ((OPJ_OFF_T) nbytes > file_bytes - rstream->offset)
+        nbytes = file_bytes - rstream->offset;
+    if (read_remote_file (rstream->remote, rstream->offset, nbytes, buf)
+        != SUCCESS)
+        return (OPJ_SIZE_T) -1;
+    rstream->offset += nbytes;
+    return nbytes;
+}
 
-        /* Rename the ENVI data files from the gdal_translate to .img files */
-        count = snprintf (raw_file, sizeof (raw_file), "%s", bmeta->file_name);
-        if (count < 0 || count >= sizeof (raw_file))
-        {
-            sprintf (errmsg, "Overflow of raw_file string");
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
-        cptr = strrchr (raw_file, '.');
-        strcpy (cptr, "\0");
+static OPJ_OFF_T jp2_remote_skip (OPJ_OFF_T nbytes, void *data)
+{
+    Jp2_remote_stream_t *rstream = (Jp2_remote_stream_t *) data;
 
-        if (rename (raw_file, bmeta->file_name))
-        {
-            sprintf (errmsg, "Unable to rename the decompressed Sentinel raw "
-                "file (%s) to the new ESPA filename (%s)", raw_file,
-                bmeta->file_name);
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
-    }  /* end for */
+    if (rstream->offset + nbytes < 0)
+        return -1;
+    rstream->offset += nbytes;
+    return nbytes;
+}
 
-    /* Successful conversion */
-    return (SUCCESS);
+static OPJ_BOOL jp2_remote_seek (OPJ_OFF_T offset, void *data)
+{
+    Jp2_remote_stream_t *rstream = (Jp2_remote_stream_t *) data;
+
+    if (offset < 0 || offset > rstream->remote->nbytes)
+        return OPJ_FALSE;
+    rstream->offset = offset;
+    return OPJ_TRUE;
+}
+
+static void jp2_remote_free (void *data)
+{
+    close_remote_file (((Jp2_remote_stream_t *) data)->remote);
+    free (data);
 }
 
 
 /******************************************************************************
-MODULE:  convert_sentinel_to_espa
+MODULE:  open_jp2_remote_stream
 
-PURPOSE: Converts the input Sentinel-2 (A&B L1C) files to the ESPA internal raw
-binary file format (and associated XML file).  The MTD_MSIL1C.xml and MTD_TL.xml
-files are expected to be in the same directory as the Sentinel band data.
+PURPOSE: Opens an OpenJPEG stream reading a remote JP2 file.
 
 RETURN VALUE:
-Type = int
+Type = opj_stream_t *
 Value           Description
 -----           -----------
-ERROR           Error converting the Sentinel-2 product
-SUCCESS         Successfully converted Sentinel-2 product to ESPA format
+NULL            Error opening the remote JP2 file
+non-NULL        Stream of the JP2 file; destroying it closes the remote file
 
 NOTES:
-  1. The Sentinel JP2 band files will be deciphered from the Sentinel XML file.
-  2. The JP2 band files listed in the MTD_MSIL1C.xml file need to be available
-     in the same directory as both the MTD_MSIL1C product and MTD_TL tile XML
-     files.
+  1. Only the parts of the JP2 file which the decoder reads are downloaded
+     (see espa_remote.h); with a reduced resolution, the packets of the
+     discarded resolution levels are skipped over.
 ******************************************************************************/
-int convert_sentinel_to_espa
+static opj_stream_t *open_jp2_remote_stream
 (
-    bool del_src      /* I: should the source .jp2 files be removed after
-                            conversion? */
+    char *jp2_file             /* I: URL of the JP2 file */
 )
 {
-    char FUNC_NAME[] = "convert_sentinel_to_espa";  /* function name */
-    char errmsg[STR_SIZE];            /* error message */
-    char espa_xml_file[STR_SIZE];     /* output ESPA XML metadata filename */
-    char jp2_file[STR_SIZE];          /* jp2 image file to delete */
-    char sentinel_xml_file[STR_SIZE]; /* current Sentinel XML filename */
-    char orig_bandname[STR_SIZE];     /* original band1 filename */
-    char prodtype[STR_SIZE];          /* product type string for all bands */
-    char proc_ver[STR_SIZE];          /* processing ver string for all bands */
-    char l1_filename[STR_SIZE];       /* original level-1 filename for the
-                                         initial band to be used as base for
-                                         all bands */
-    char *b1_name = NULL;             /* band 1 Sentinel-2 filename */
-    char *cptr = NULL;                /* pointer to the file extension */
-    float scale_factor;               /* scale factor for all bands */
-    int i;                            /* looping variable */
-    int count;                        /* number of chars copied in snprintf */
-
-    Img_coord_float_t img;            /* image coordinates for current pixel */
-    Geo_coord_t geo;                  /* geodetic coordinates (note radians) */
-    Space_def_t geoloc_def;           /* geolocation space information */
-    Geoloc_t *geoloc_map = NULL;      /* geolocation mapping information */
-
-    Espa_internal_meta_t xml_metadata;  /* ESPA XML metadata structure to be
-                                           populated by reading the Sentinel
-                                           XML file */
-    Espa_global_meta_t *gmeta = NULL; /* global metadata structure */
-    Espa_band_meta_t *bmeta = NULL;   /* band metadata pointer to all bands */
-
-    /* Initialize the metadata structure */
-    init_metadata_struct (&xml_metadata);
-    gmeta = &xml_metadata.global;
+    char FUNC_NAME[] = "open_jp2_remote_stream";  /* function name */
+    char errmsg[STR_SIZE];     /* error message */
+    opj_stream_t *stream = NULL;   /* stream of the JP2 file */
+    Jp2_remote_stream_t *rstream = NULL;  /* position of the stream */
 
-    /* Read the Sentinel MTD_MSIL1C product XML file and populate our internal
-       ESPA metadata structure. The acquisition date/time, product generation
-       date/time, lat/long coords, product type, and scale factor are all
-       available in this XML file. */
-    strcpy (sentinel_xml_file, "MTD_MSIL1C.xml");
-    if (parse_sentinel_product_metadata (sentinel_xml_file, &xml_metadata,
-        prodtype, proc_ver, l1_filename, &scale_factor) != SUCCESS)
+    rstream = malloc (sizeof (Jp2_remote_stream_t));
+    if (rstream == NULL)
     {
-        sprintf (errmsg, "Reading Sentinel product XML file: %s",
-            sentinel_xml_file);
+        sprintf (errmsg, "Allocating memory for the JP2 stream");
         error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
+        return (NULL);
     }
-
-    /* Allocate band metadata */
-    if (allocate_band_metadata (&xml_metadata, NUM_SENTINEL_BANDS) != SUCCESS)
-    {   /* Error messages already printed */
-        return (ERROR);
+    rstream->offset = 0;
+    rstream->remote = open_remote_file (jp2_file);
+    if (rstream->remote == NULL)
+    {
+        sprintf (errmsg, "Opening the remote JP2 file: %s", jp2_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        free (rstream);
+        return (NULL);
     }
 
-    /* Get the band 1 filename in the current directory */
-    b1_name = read_dir();
-    if (b1_name == NULL)
+    stream = opj_stream_create (OPJ_J2K_STREAM_CHUNK_SIZE, OPJ_TRUE);
+    if (stream == NULL)
     {
-        sprintf (errmsg, "Not able to find the Sentinel-2 band 1 file in "
-            "the current directory");
+        sprintf (errmsg, "Creating the JP2 stream: %s", jp2_file);
         error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
+        jp2_remote_free (rstream);
+        return (NULL);
     }
+    opj_stream_set_read_function (stream, jp2_remote_read);
+    opj_stream_set_skip_function (stream, jp2_remote_skip);
+    opj_stream_set_seek_function (stream, jp2_remote_seek);
+    opj_stream_set_user_data (stream, rstream, jp2_remote_free);
+    opj_stream_set_user_data_length (stream, rstream->remote->nbytes);
 
-    /* Strip off the band and jpeg 2000 file extension. Store this as the
-       product_id in the global metadata. */
-    cptr = strstr (b1_name, "_B01.jp2");
-    *cptr = '\0';
-    snprintf (gmeta->product_id, sizeof (gmeta->product_id), "%s",
-        (const char *) b1_name);
-    
-    /* Strip the band from the level-1 filename to get the basename */
-    cptr = strrchr (l1_filename, '_');
-    *cptr = '\0';
+    return (stream);
+}
+#endif
 
-    /* The filename, product type, app version, and scale factor need to be
-       added to the band metadata for each of the bands */
-    for (i = 0; i < xml_metadata.nbands; i++)
-    {
-        bmeta = &xml_metadata.band[i];
-        snprintf (bmeta->file_name, sizeof (bmeta->file_name), "%s_%s.jp2",
-            (const char *) b1_name, sentinel_bands[i]);
-        strcpy (bmeta->short_name, prodtype);
-        bmeta->scale_factor = 1.0 / scale_factor;
-        snprintf (bmeta->l1_filename, sizeof (bmeta->l1_filename), "%s_%s",
-            (const char *) l1_filename, sentinel_bands[i]);
 
-        /* Sentinel-2 XML files contain the processing baseline version, so
-           that will be used to keep track of the ESA PDGS version number */
-        sprintf (bmeta->app_version, "ESA Payload Data Ground Segment v%s",
-            proc_ver);
-    }
+#ifndef HAVE_OPENJPEG
+/* Number of lines of a band read back at a time by scan_jp2_band */
+#define JP2_SCAN_LINES 256
+
+/******************************************************************************
+MODULE:  scan_jp2_band
+
+PURPOSE: Reads back a band written by GDAL for its statistics and its browse
+channel.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error reading the raw binary file
+SUCCESS         Successfully read the band
 
-    /* Read the Sentinel MTD_TL tile XML file and populate our internal ESPA
-       metadata structure. The tile level datum, projection, and zone are
-       available. The number of lines/samples for each resolution are
-       available. The UL x/y position are also availble. */
-    strcpy (sentinel_xml_file, "MTD_TL.xml");
-    if (parse_sentinel_tile_metadata (sentinel_xml_file, &xml_metadata) !=
-        SUCCESS)
+NOTES:
+  1. Only the bands in the browse are read back; the pixels of the other
+     bands never pass through this library without OpenJPEG.
+******************************************************************************/
+static int scan_jp2_band
+(
+    Espa_band_meta_t *bmeta,   /* I/O: band metadata; its stats are set */
+    Espa_browse_t *browse,     /* I/O: browse the band is added to */
+    int channel                /* I: channel of the band in the browse */
+)
+{
+    char FUNC_NAME[] = "decode_jp2_band";  /* function name */
+    char errmsg[STR_SIZE];     /* error message */
+    int nbytes;                /* number of bytes per pixel */
+    int line;                  /* first line of the current block */
+    int nlines;                /* number of lines in the current block */
+    int fd;                    /* file descriptor of the raw binary file */
+    int status = SUCCESS;      /* status of the reading */
+    char *buf = NULL;          /* current block of lines */
+    Rb_stats_t *stats = NULL;  /* statistics of the band */
+
+    nbytes = espa_data_type_size (bmeta->data_type);
+    stats = open_raw_binary_stats (bmeta);
+    buf = espa_trace_malloc ((size_t) JP2_SCAN_LINES * bmeta->nsamps *
+        nbytes);
+    fd = open_raw_binary_fd (bmeta->file_name, false);
+    if (stats == NULL || buf == NULL || fd == -1)
     {
-        sprintf (errmsg, "Reading Sentinel tile XML file: %s",
-            sentinel_xml_file);
+        sprintf (errmsg, "Reading back the raw binary file: %s",
+            bmeta->file_name);
         error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
+        status = ERROR;
     }
 
-    /* Add the data provider USGS/EROS (Sentinel products delivered via EE) */
-    strcpy (gmeta->data_provider, "USGS/EROS");
+    for (line = 0; status == SUCCESS && line < bmeta->nlines;
+        line += JP2_SCAN_LINES)
+    {
+        nlines = bmeta->nlines - line;
+        if (nlines > JP2_SCAN_LINES)
+            nlines = JP2_SCAN_LINES;
+        if (read_raw_binary_window (fd, bmeta->nsamps, line, nlines, 0,
+            bmeta->nsamps, nbytes, buf) != SUCCESS)
+        {
+            sprintf (errmsg, "Reading lines %d-%d of the raw binary file: %s",
+                line, line + nlines - 1, bmeta->file_name);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+            break;
+        }
+        update_raw_binary_stats (stats, buf, (size_t) nlines *
+            bmeta->nsamps);
+        add_espa_browse_window (browse, channel, line, nlines, 0,
+            bmeta->nsamps, buf);
+    }
+    if (status == SUCCESS)
+        finish_raw_binary_stats (stats, &bmeta->stats);
+
+    if (fd != -1)
+        close_raw_binary_fd (fd);
+    espa_trace_free (buf);
+    close_raw_binary_stats (stats);
+    return (status);
+}
+#endif
 
-    /* Add the instrument which is MSI - MultiSpectral Instrument */
-    strcpy (gmeta->instrument, "MSI");
 
-    /* Set the orientation angle to 0 */
-    gmeta->orientation_angle = 0.0;
+/******************************************************************************
+MODULE:  decode_jp2_band
 
-    /* Update remaining information for band metadata for each of the bands */
-    for (i = 0; i < xml_metadata.nbands; i++)
-    {
-        bmeta = &xml_metadata.band[i];
-        strcpy (bmeta->product, "MSIL1C");
-        strcpy (bmeta->name, sentinel_bands[i]);
-        strcpy (bmeta->category, "image");
-        bmeta->data_type = ESPA_UINT16;
-        bmeta->fill_value = 0;
-        bmeta->saturate_value = 65535;
-        bmeta->valid_range[0] = 0.0;
-        bmeta->valid_range[1] = 65534.0;
-        strcpy (bmeta->data_units, "reflectance");
-        strcpy (bmeta->production_date, gmeta->level1_production_date);
-        sprintf (bmeta->long_name, "band %s top-of-atmosphere reflectance",
-            sentinel_band_nums[i]);
-    }
+PURPOSE: Decodes a Sentinel JP2 band into an ESPA raw binary (.img) file,
+optionally at a coarser or finer resolution.
 
-    /* Use band 2 as the representative 10m band */
-    bmeta = &xml_metadata.band[1];
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error decoding the JP2 file or writing the raw binary file
+SUCCESS         Successfully decoded the JP2 file
 
-    /* Get geolocation information from the XML file (using the first band) to
-       prepare for computing the bounding coordinates */
-    if (!get_geoloc_info (&xml_metadata, &geoloc_def))
+NOTES:
+  1. With OpenJPEG (ENABLE_OPENJPEG=yes), the JPEG2000 tiles are decoded
+     in-process one at a time, by nthreads threads of the decoder, and each
+     tile is written to its window of the raw binary file.  Only one tile of
+     the band is held in memory.
+  2. A band reduced by a factor is decoded at the coarsest resolution level
+     of the JPEG2000 wavelet which the factor is a multiple of (ex. half the
+     resolution for factors 2 and 6), which skips the finer levels entirely.
+     Whatever is left of the factor (ex. 3 for 6) is done by the resampling
+     kernels (see sentinel_resample.h), as is an expansion, which needs the
+     decoded band to be held in memory.  The resampled band is written a
+     block of SENTINEL_RESAMPLE_BLOCK_LINES lines at a time.
+  3. Otherwise the GDAL gdal_translate tool is run on the band, which reads
+     the matching JPEG2000 resolution level for the reduced output size, and
+     resamples with the matching GDAL method.
+  4. The JP2 file may be a remote file (see espa_remote.h), which OpenJPEG
+     reads through open_jp2_remote_stream, and GDAL through its /vsis3/ or
+     /vsicurl/ file systems.
+  5. With OpenJPEG, the statistics of the band are computed, and the band is
+     added to its browse channel, from the tiles (or resampled blocks) as
+     they are written.  The tiles come in any order, so there is no checksum.
+     With GDAL, a band in the browse is read back for them instead (see
+     scan_jp2_band).
+******************************************************************************/
+static int decode_jp2_band
+(
+    char *jp2_file,            /* I: name of the JP2 file of the band */
+    Espa_band_meta_t *bmeta,   /* I/O: band metadata; file_name is the raw
+                                     binary file to be written, at the
+                                     output size; its stats are set */
+    const Sentinel_band_change_t *change,  /* I: change of the resolution
+                                     of the band */
+    int nthreads,              /* I: number of threads of the decoder */
+    Espa_browse_t *browse,     /* I/O: browse the band is added to; NULL if
+                                     none */
+    int channel                /* I: channel of the band in the browse; -1 if
+                                     the band isn't in it */
+)
+{
+    char FUNC_NAME[] = "decode_jp2_band";  /* function name */
+    char errmsg[STR_SIZE];     /* error message */
+#ifdef HAVE_OPENJPEG
+    int nbytes;                /* number of bytes per pixel */
+    int prec_bytes;            /* number of bytes per decoded sample */
+    int reduce;                /* number of resolution levels discarded */
+    int agg;                   /* change left after the discarded levels */
+    int out_nlines;            /* number of lines of the decoded band once
+                                  resampled */
+    int out_nsamps;            /* number of samples of the decoded band once
+                                  resampled */
+    int nblock;                /* number of lines of the current block */
+    int dec_nlines;            /* number of lines at the decoded level */
+    int dec_nsamps;            /* number of samples at the decoded level */
+    int rx0, ry0, rx1, ry1;    /* bounds of the tile at the decoded level */
+    int line;                  /* line of the current tile */
+    int fd = -1;               /* file descriptor of the raw binary file */
+    int status = ERROR;        /* status of the decoding */
+    OPJ_UINT32 tile_index;     /* index of the current tile */
+    OPJ_UINT32 data_size;      /* number of bytes in the current tile */
+    OPJ_UINT32 buf_size = 0;   /* number of bytes allocated for tile_buf */
+    OPJ_UINT32 ncomps;         /* number of components in the tile */
+    OPJ_INT32 tx0, ty0, tx1, ty1;  /* full resolution bounds of the tile */
+    OPJ_BOOL go_on;            /* are there more tiles to decode? */
+    OPJ_BYTE *tile_buf = NULL; /* pixels of the current tile */
+    char *dec_buf = NULL;      /* decoded band, if it is to be resampled */
+    char *block_buf = NULL;    /* block of resampled lines */
+    Sentinel_resample_t *resample = NULL;  /* resampling of the band */
+    Rb_stats_t *stats = NULL;  /* statistics of the band */
+    opj_dparameters_t params;  /* decoder parameters */
+    opj_stream_t *stream = NULL;   /* stream of the JP2 file */
+    opj_codec_t *codec = NULL;     /* JPEG2000 decoder */
+    opj_image_t *image = NULL;     /* header of the JP2 image */
+
+    nbytes = espa_data_type_size (bmeta->data_type);
+    stats = open_raw_binary_stats (bmeta);
+    if (stats == NULL)
+        return (ERROR);   /* error message already written */
+
+    /* Split a reduction into discarded resolution levels and resampling;
+       an expansion is all resampling */
+    reduce = 0;
+    agg = change->factor;
+    while (!change->expand && agg % 2 == 0)
     {
-        sprintf (errmsg, "Copying the geolocation information from the XML "
-            "metadata structure.");
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
+        agg /= 2;
+        reduce++;
     }
 
-    /* Setup the mapping structure */
-    geoloc_map = setup_mapping (&geoloc_def);
-    if (geoloc_map == NULL)
+    /* Set up the decoder and read the header of the image */
+    if (is_remote_file (jp2_file))
+        stream = open_jp2_remote_stream (jp2_file);
+    else
+        stream = opj_stream_create_default_file_stream (jp2_file, OPJ_TRUE);
+    if (stream == NULL)
     {
-        sprintf (errmsg, "Setting up the geolocation mapping structure.");
+        sprintf (errmsg, "Opening the JP2 file: %s", jp2_file);
         error_handler (true, FUNC_NAME, errmsg);
+        close_raw_binary_stats (stats);
         return (ERROR);
     }
-
-    /* Get the geographic coords for the UL corner */
-    img.l = 0.0;
-    img.s = 0.0;
-    img.is_fill = false;
-    if (!from_space (geoloc_map, &img, &geo))
+    codec = opj_create_decompress (OPJ_CODEC_JP2);
+    if (codec == NULL)
     {
-        sprintf (errmsg, "Mapping UL corner to lat/long");
+        sprintf (errmsg, "Creating the JPEG2000 decoder");
         error_handler (true, FUNC_NAME, errmsg);
+        opj_stream_destroy (stream);
+        close_raw_binary_stats (stats);
         return (ERROR);
     }
-    gmeta->ul_corner[0] = geo.lat * DEG;
-    gmeta->ul_corner[1] = geo.lon * DEG;
-
-    /* Get the geographic coords for the LR corner */
-    img.l = bmeta->nlines-1;
-    img.s = bmeta->nsamps-1;
-    img.is_fill = false;
-    if (!from_space (geoloc_map, &img, &geo))
+    opj_set_error_handler (codec, jp2_error_callback, jp2_file);
+    opj_set_default_decoder_parameters (&params);
+    params.cp_reduce = reduce;
+    if (!opj_setup_decoder (codec, &params))
     {
-        sprintf (errmsg, "Mapping UL corner to lat/long");
+        sprintf (errmsg, "Setting up the JPEG2000 decoder");
         error_handler (true, FUNC_NAME, errmsg);
+        goto cleanup;
+    }
+#if OPJ_VERSION_MAJOR > 2 || (OPJ_VERSION_MAJOR == 2 && OPJ_VERSION_MINOR >= 2)
+    /* The decoder can only use its own threads since OpenJPEG 2.2 */
+    if (nthreads > 1)
+        opj_codec_set_threads (codec, nthreads);
+#endif
+    if (!opj_read_header (stream, codec, &image))
+    {
+        sprintf (errmsg, "Reading the header of the JP2 file: %s", jp2_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        goto cleanup;
+    }
+
+    /* Make sure the image matches the band */
+    if (image->numcomps != 1)
+    {
+        sprintf (errmsg, "JP2 file %s has %d components, but only single "
+            "band images are supported", jp2_file, image->numcomps);
+        error_handler (true, FUNC_NAME, errmsg);
+        goto cleanup;
+    }
+    prec_bytes = image->comps[0].prec <= 8 ? 1 :
+        (image->comps[0].prec <= 16 ? 2 : 4);
+    dec_nlines = JP2_CEIL_DIV_POW2 (image->y1, reduce) -
+        JP2_CEIL_DIV_POW2 (image->y0, reduce);
+    dec_nsamps = JP2_CEIL_DIV_POW2 (image->x1, reduce) -
+        JP2_CEIL_DIV_POW2 (image->x0, reduce);
+    if (change->expand)
+    {
+        out_nlines = dec_nlines * agg;
+        out_nsamps = dec_nsamps * agg;
+    }
+    else
+    {
+        out_nlines = (dec_nlines + agg - 1) / agg;
+        out_nsamps = (dec_nsamps + agg - 1) / agg;
+    }
+    if (out_nlines != bmeta->nlines || out_nsamps != bmeta->nsamps ||
+        prec_bytes != nbytes)
+    {
+        sprintf (errmsg, "JP2 file %s is %d lines x %d samples of %d bytes "
+            "when %s by %d, but the band is %d lines x %d samples of %d "
+            "bytes", jp2_file, out_nlines, out_nsamps, prec_bytes,
+            change->expand ? "expanded" : "reduced", change->factor,
+            bmeta->nlines, bmeta->nsamps, nbytes);
+        error_handler (true, FUNC_NAME, errmsg);
+        goto cleanup;
+    }
+
+    fd = open_raw_binary_fd (bmeta->file_name, true);
+    if (fd == -1)
+    {
+        sprintf (errmsg, "Opening the raw binary file: %s", bmeta->file_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        goto cleanup;
+    }
+
+    /* Write the tiles straight to the raw binary file, unless the band has
+       to be resampled once it is decoded */
+    if (agg > 1)
+    {
+        dec_buf = espa_trace_malloc ((size_t) dec_nlines * dec_nsamps *
+            nbytes);
+        block_buf = espa_trace_malloc ((size_t) SENTINEL_RESAMPLE_BLOCK_LINES
+            * bmeta->nsamps * nbytes);
+        if (dec_buf == NULL || block_buf == NULL)
+        {
+            sprintf (errmsg, "Allocating memory for the decoded band of %d "
+                "lines x %d samples", dec_nlines, dec_nsamps);
+            error_handler (true, FUNC_NAME, errmsg);
+            goto cleanup;
+        }
+    }
+
+    /* Decode the tiles, in the order of the codestream, and write each one
+       to its window of the band */
+    while (1)
+    {
+        if (!opj_read_tile_header (codec, stream, &tile_index, &data_size,
+            &tx0, &ty0, &tx1, &ty1, &ncomps, &go_on))
+        {
+            sprintf (errmsg, "Reading a tile header of the JP2 file: %s",
+                jp2_file);
+            error_handler (true, FUNC_NAME, errmsg);
+            goto cleanup;
+        }
+        if (!go_on)
+            break;   /* all tiles have been decoded */
+
+        /* The tile bounds are at full resolution */
+        rx0 = JP2_CEIL_DIV_POW2 (tx0, reduce) -
+            JP2_CEIL_DIV_POW2 (image->x0, reduce);
+        ry0 = JP2_CEIL_DIV_POW2 (ty0, reduce) -
+            JP2_CEIL_DIV_POW2 (image->y0, reduce);
+        rx1 = JP2_CEIL_DIV_POW2 (tx1, reduce) -
+            JP2_CEIL_DIV_POW2 (image->x0, reduce);
+        ry1 = JP2_CEIL_DIV_POW2 (ty1, reduce) -
+            JP2_CEIL_DIV_POW2 (image->y0, reduce);
+        if (data_size != (OPJ_UINT32) (rx1 - rx0) * (ry1 - ry0) * nbytes)
+        {
+            sprintf (errmsg, "Unexpected size of tile %u of the JP2 file: %s",
+                tile_index, jp2_file);
+            error_handler (true, FUNC_NAME, errmsg);
+            goto cleanup;
+        }
+
+        if (data_size > buf_size)
+        {
+            espa_trace_free (tile_buf);
+            tile_buf = espa_trace_malloc (data_size);
+            if (tile_buf == NULL)
+            {
+                sprintf (errmsg, "Allocating memory for a JP2 tile of %u "
+                    "bytes", data_size);
+                error_handler (true, FUNC_NAME, errmsg);
+                goto cleanup;
+            }
+            buf_size = data_size;
+        }
+        if (!opj_decode_tile_data (codec, tile_index, tile_buf, data_size,
+            stream))
+        {
+            sprintf (errmsg, "Decoding tile %u of the JP2 file: %s",
+                tile_index, jp2_file);
+            error_handler (true, FUNC_NAME, errmsg);
+            goto cleanup;
+        }
+
+        if (dec_buf != NULL)
+        {
+            for (line = ry0; line < ry1; line++)
+                memcpy (dec_buf + ((size_t) line * dec_nsamps + rx0) *
+                    nbytes, tile_buf + (size_t) (line - ry0) * (rx1 - rx0) *
+                    nbytes, (size_t) (rx1 - rx0) * nbytes);
+        }
+        else if (write_raw_binary_window (fd, bmeta->nsamps, ry0, ry1 - ry0,
+            rx0, rx1 - rx0, nbytes, tile_buf) != SUCCESS)
+        {
+            sprintf (errmsg, "Writing tile %u to the raw binary file: %s",
+                tile_index, bmeta->file_name);
+            error_handler (true, FUNC_NAME, errmsg);
+            goto cleanup;
+        }
+
+        /* Add the written tile to the statistics and the browse */
+        if (dec_buf == NULL)
+        {
+            update_raw_binary_stats (stats, tile_buf, (size_t) (rx1 - rx0) *
+                (ry1 - ry0));
+            if (channel >= 0)
+                add_espa_browse_window (browse, channel, ry0, ry1 - ry0, rx0,
+                    rx1 - rx0, tile_buf);
+        }
+    }
+
+    if (!opj_end_decompress (codec, stream))
+    {
+        sprintf (errmsg, "Completing the decoding of the JP2 file: %s",
+            jp2_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        goto cleanup;
+    }
+
+    /* Resample the decoded band to the band, a block of lines at a time */
+    if (dec_buf != NULL)
+    {
+        resample = open_sentinel_resample (dec_buf, dec_nlines, dec_nsamps,
+            nbytes, bmeta->fill_value, agg, change->expand, change->method,
+            bmeta->nlines, bmeta->nsamps);
+        if (resample == NULL)
+        {
+            sprintf (errmsg, "Setting up the resampling of the JP2 file: %s",
+                jp2_file);
+            error_handler (true, FUNC_NAME, errmsg);
+            goto cleanup;
+        }
+
+        for (line = 0; line < bmeta->nlines; line += nblock)
+        {
+            nblock = bmeta->nlines - line;
+            if (nblock > SENTINEL_RESAMPLE_BLOCK_LINES)
+                nblock = SENTINEL_RESAMPLE_BLOCK_LINES;
+            resample_sentinel_lines (resample, line, nblock, block_buf);
+            if (write_raw_binary_window (fd, bmeta->nsamps, line, nblock, 0,
+                bmeta->nsamps, nbytes, block_buf) != SUCCESS)
+            {
+                sprintf (errmsg, "Writing lines %d to %d to the raw binary "
+                    "file: %s", line, line + nblock - 1, bmeta->file_name);
+                error_handler (true, FUNC_NAME, errmsg);
+                goto cleanup;
+            }
+            update_raw_binary_stats (stats, block_buf, (size_t) nblock *
+                bmeta->nsamps);
+            if (channel >= 0)
+                add_espa_browse_window (browse, channel, line, nblock, 0,
+                    bmeta->nsamps, block_buf);
+        }
+    }
+    finish_raw_binary_stats (stats, &bmeta->stats);
+    status = SUCCESS;
+
+cleanup:
+    if (fd != -1)
+        close_raw_binary_fd (fd);
+    espa_trace_free (tile_buf);
+    close_sentinel_resample (resample);
+    espa_trace_free (dec_buf);
+    espa_trace_free (block_buf);
+    close_raw_binary_stats (stats);
+    if (image != NULL)
+        opj_image_destroy (image);
+    opj_destroy_codec (codec);
+    opj_stream_destroy (stream);
+
+    return (status);
+#else
+    char gdal_cmd[STR_SIZE];  /* command string for GDAL call */
+    char size_opts[STR_SIZE] = "";  /* output size options for GDAL */
+    const char *vsi_prefix = "";    /* GDAL file system of a remote file */
+    char *gdal_file = jp2_file;     /* name of the JP2 file for GDAL */
+    const char *gdal_methods[] = {"near", "average", "bilinear"};
+                              /* GDAL names of the resampling methods */
+    int count;                /* number of chars copied in snprintf */
+
+    if (change->factor > 1)
+        sprintf (size_opts, "-outsize %d %d -r %s ", bmeta->nsamps,
+            bmeta->nlines, gdal_methods[change->method]);
+    if (!strncmp (jp2_file, "s3://", 5))
+    {
+        vsi_prefix = "/vsis3/";
+        gdal_file = jp2_file + 5;
+    }
+    else if (is_remote_file (jp2_file))
+        vsi_prefix = "/vsicurl/";
+    count = snprintf (gdal_cmd, sizeof (gdal_cmd),
+        "gdal_translate -of ENVI -q %s%s%s %s", size_opts, vsi_prefix,
+        gdal_file, bmeta->file_name);
+    if (count < 0 || count >= sizeof (gdal_cmd))
+    {
+        sprintf (errmsg, "Overflow of gdal_cmd string");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    if (system (gdal_cmd) != 0)
+    {
+        sprintf (errmsg, "Decompressing JP2 file: %s. Make sure the current "
+            "directory is writable and the GDAL gdal_translate tool is in "
+            "your system PATH", gdal_cmd);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    if (channel >= 0)
+        return (scan_jp2_band (bmeta, browse, channel));
+    return (SUCCESS);
+#endif
+}
+
+
+/******************************************************************************
+MODULE:  sentinel_decode_threads
+
+PURPOSE: Splits the threads between the bands decoded at the same time and
+the decoder of each band.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. SENTINEL_DEFAULT_DECODE_BANDS (or SENTINEL_DECODE_BANDS_ENV) bands are
+     decoded at the same time, but never more than the threads of the task
+     pool or the bands.  The threads are then shared evenly by the decoders
+     of those bands.
+  2. Without threading, one band is decoded at a time, using all the
+     processors.
+  3. When several granules are converted at the same time, each one gets an
+     even share of the threads (or processors).
+******************************************************************************/
+static void sentinel_decode_threads
+(
+    int nbands,              /* I: number of bands to be decoded */
+    int granule_jobs,        /* I: number of granules converted at the same
+                                   time */
+    int *band_threads,       /* O: number of bands decoded at the same time */
+    int *decoder_threads     /* O: number of threads of each decoder */
+)
+{
+    int nthreads;            /* total number of threads */
+#ifdef _OPENMP
+    char *env = NULL;        /* value of the environment variable */
+
+    nthreads = espa_task_pool_threads () / granule_jobs;
+    if (nthreads < 1)
+        nthreads = 1;
+    env = getenv (SENTINEL_DECODE_BANDS_ENV);
+    *band_threads = env != NULL ? atoi (env) : SENTINEL_DEFAULT_DECODE_BANDS;
+    if (*band_threads > nthreads)
+        *band_threads = nthreads;
+#else
+    nthreads = sysconf (_SC_NPROCESSORS_ONLN) / granule_jobs;
+    if (nthreads < 1)
+        nthreads = 1;
+    *band_threads = 1;
+#endif
+    if (*band_threads > nbands)
+        *band_threads = nbands;
+    if (*band_threads < 1)
+        *band_threads = 1;
+
+    *decoder_threads = nthreads / *band_threads;
+    if (*decoder_threads < 1)
+        *decoder_threads = 1;
+}
+
+
+/******************************************************************************
+MODULE:  set_sentinel_resolution
+
+PURPOSE: Sets the bands which are finer than the requested resolution (and
+optionally those which are coarser) to that resolution, and determines how
+much each band is reduced or expanded.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           The resolution isn't a multiple of the band resolutions or
+                no band has that resolution
+SUCCESS         Successfully set the resolution
+
+NOTES:
+  1. The bands which are already at the resolution, or coarser without a
+     common grid, are left as they are, with a factor of 1.
+  2. The changed bands take the size of the bands which natively have the
+     resolution, so the resolution needs to be one of the Sentinel-2 band
+     resolutions (10, 20, or 60 meters).
+  3. The reduced bands default to the mean, and the expanded bands to
+     replicating (see set_sentinel_resample_methods).
+******************************************************************************/
+static int set_sentinel_resolution
+(
+    Espa_internal_meta_t *xml_metadata, /* I/O: metadata of the bands */
+    int resolution,          /* I: output resolution in meters; 0 for the
+                                   native resolution of each band */
+    bool common_grid,        /* I: should the coarser bands be expanded to
+                                   the resolution too? */
+    Sentinel_band_change_t *changes  /* O: change of the resolution of each
+                                   band */
+)
+{
+    char FUNC_NAME[] = "set_sentinel_resolution";  /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    int i;                   /* looping variable for the bands */
+    int native;              /* native resolution of the band */
+    Espa_band_meta_t *bmeta = NULL;    /* pointer to band metadata */
+    Espa_band_meta_t *target = NULL;   /* band natively at the resolution */
+
+    for (i = 0; i < xml_metadata->nbands; i++)
+    {
+        changes[i].factor = 1;
+        changes[i].expand = false;
+        changes[i].method = SENTINEL_MEAN;
+        if ((int) xml_metadata->band[i].pixel_size[0] == resolution)
+            target = &xml_metadata->band[i];
+    }
+    if (resolution == 0 && common_grid)
+    {
+        sprintf (errmsg, "A common grid needs the resolution of the grid");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    if (resolution == 0)
+        return (SUCCESS);
+
+    if (target == NULL)
+    {
+        sprintf (errmsg, "Resolution of %d meters isn't the resolution of "
+            "any of the Sentinel-2 bands", resolution);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    for (i = 0; i < xml_metadata->nbands; i++)
+    {
+        bmeta = &xml_metadata->band[i];
+        native = (int) bmeta->pixel_size[0];
+        if (native == resolution || (native > resolution && !common_grid))
+            continue;
+        if (native <= 0 || (native < resolution ? resolution % native :
+            native % resolution) != 0)
+        {
+            sprintf (errmsg, "Resolution of %d meters isn't a multiple or "
+                "divisor of the %d meter resolution of band %s", resolution,
+                native, bmeta->name);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+
+        if (native < resolution)
+            changes[i].factor = resolution / native;
+        else
+        {
+            changes[i].factor = native / resolution;
+            changes[i].expand = true;
+            changes[i].method = SENTINEL_REPLICATE;
+        }
+        bmeta->nlines = target->nlines;
+        bmeta->nsamps = target->nsamps;
+        bmeta->pixel_size[0] = target->pixel_size[0];
+        bmeta->pixel_size[1] = target->pixel_size[1];
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  set_sentinel_resample_methods
+
+PURPOSE: Sets the resampling methods of the bands whose resolution changes,
+from a comma separated list of methods.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error in the list of methods
+SUCCESS         Successfully set the methods
+
+NOTES:
+  1. Each entry of the list is a method (replicate, mean, or bilinear), or a
+     band and its method (ex. B05:bilinear).
+  2. A method alone applies to all the changed bands it is valid for (see
+     sentinel_resample_method_valid).  A method of a band overrides it, and
+     needs to be valid for the band.
+  3. The resampling method of the metadata of the bands which are
+     replicated or interpolated bilinearly is set accordingly.
+******************************************************************************/
+static int set_sentinel_resample_methods
+(
+    Espa_internal_meta_t *xml_metadata, /* I/O: metadata of the bands */
+    char *resample,          /* I: list of methods; NULL for the defaults */
+    Sentinel_band_change_t *changes  /* I/O: change of the resolution of
+                                   each band; the methods are set */
+)
+{
+    char FUNC_NAME[] = "set_sentinel_resample_methods";  /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    char list[STR_SIZE];     /* copy of the list, split into entries */
+    char *entry = NULL;      /* current entry of the list */
+    char *method_name = NULL;  /* method of the current entry */
+    char *saveptr = NULL;    /* position of strtok_r in the list */
+    int i;                   /* looping variable for the bands */
+    int pass;                /* pass over the list: methods alone, then the
+                                methods of the bands */
+    int count;               /* number of chars copied in snprintf */
+    int nset;                /* number of bands set by an entry */
+    enum Sentinel_resample_method method;  /* method of the entry */
+
+    for (pass = 0; resample != NULL && pass < 2; pass++)
+    {
+        count = snprintf (list, sizeof (list), "%s", resample);
+        if (count < 0 || count >= sizeof (list))
+        {
+            sprintf (errmsg, "Overflow of the list of resampling methods");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+
+        for (entry = strtok_r (list, ",", &saveptr); entry != NULL;
+            entry = strtok_r (NULL, ",", &saveptr))
+        {
+            method_name = strchr (entry, ':');
+            if ((method_name == NULL) != (pass == 0))
+                continue;
+            if (method_name != NULL)
+                *method_name++ = '\0';
+            else
+                method_name = entry;
+            if (parse_sentinel_resample_method (method_name, &method)
+                != SUCCESS)
+                return (ERROR);   /* error message already written */
+
+            nset = 0;
+            for (i = 0; i < xml_metadata->nbands; i++)
+            {
+                if (method_name != entry &&
+                    strcmp (xml_metadata->band[i].name, entry))
+                    continue;
+                if (method_name != entry && changes[i].factor == 1)
+                {
+                    sprintf (errmsg, "Band %s keeps its native resolution, "
+                        "so it isn't resampled", entry);
+                    error_handler (true, FUNC_NAME, errmsg);
+                    return (ERROR);
+                }
+                if (changes[i].factor == 1 || !sentinel_resample_method_valid
+                    (method, changes[i].expand))
+                    continue;
+                changes[i].method = method;
+                nset++;
+            }
+            if (nset == 0)
+            {
+                sprintf (errmsg, "The %s method doesn't apply to %s",
+                    method_name, method_name != entry ? entry :
+                    "any resampled band");
+                error_handler (true, FUNC_NAME, errmsg);
+                return (ERROR);
+            }
+        }
+    }
+
+    for (i = 0; i < xml_metadata->nbands; i++)
+    {
+        if (changes[i].factor == 1)
+            continue;
+        if (changes[i].method == SENTINEL_REPLICATE)
+            xml_metadata->band[i].resample_method = ESPA_NN;
+        else if (changes[i].method == SENTINEL_BILINEAR)
+            xml_metadata->band[i].resample_method = ESPA_BI;
+    }
+
+    return (SUCCESS);
+}
+
+
+/* Sentinel bands decoded in parallel */
+typedef struct
+{
+    Espa_internal_meta_t *xml_metadata; /* metadata of the bands */
+    char (*jp2_files)[STR_SIZE];  /* JP2 file of each band */
+    Sentinel_band_change_t *changes;  /* change of the resolution of each
+                                 band */
+    int decoder_threads;      /* number of threads of each decoder */
+    Espa_browse_t *browse;    /* browse the bands are added to; NULL if
+                                 none */
+} Sentinel_bands_t;
+
+
+/******************************************************************************
+MODULE:  decode_sentinel_band
+
+PURPOSE: Decodes one JP2 band and writes its ENVI header, as an iteration of
+the parallel loop over the bands.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error converting the JP2 file
+SUCCESS         Successfully converted the JP2 file
+
+NOTES:
+  1. The band is reported by report_sentinel_band.
+******************************************************************************/
+static int decode_sentinel_band
+(
+    void *arg,                /* I/O: bands being decoded */
+    int i,                    /* I: index of the band */
+    int worker                /* I: worker decoding the band (unused) */
+)
+{
+    char FUNC_NAME[] = "convert_jp2_to_img";  /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    char *cptr = NULL;        /* pointer to the file extension */
+    char envi_file[STR_SIZE]; /* name of the output ENVI header file */
+    Sentinel_bands_t *bands = arg;  /* bands being decoded */
+    Envi_header_t envi_hdr;   /* output ENVI header information */
+    Espa_band_meta_t *bmeta = &bands->xml_metadata->band[i];  /* band
+                                                      metadata */
+
+    if (decode_jp2_band (bands->jp2_files[i], bmeta, &bands->changes[i],
+        bands->decoder_threads, bands->browse,
+        espa_browse_channel (bands->browse, i)) != SUCCESS)
+        return (ERROR);
+
+    strcpy (envi_file, bmeta->file_name);
+    cptr = strrchr (envi_file, '.');
+    strcpy (cptr, ".hdr");
+    if (create_envi_struct (bmeta, &bands->xml_metadata->global, &envi_hdr)
+        != SUCCESS || write_envi_hdr (envi_file, &envi_hdr) != SUCCESS)
+    {
+        sprintf (errmsg, "Writing the ENVI header file: %s.", envi_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  report_sentinel_band
+
+PURPOSE: Reports a decoded band, in band order.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           The band failed
+SUCCESS         Successfully reported the band
+
+NOTES:
+******************************************************************************/
+static int report_sentinel_band
+(
+    void *arg,                /* I/O: bands being decoded */
+    int i,                    /* I: index of the band */
+    int band_status           /* I: status of decoding the band */
+)
+{
+    char FUNC_NAME[] = "convert_jp2_to_img";  /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    Sentinel_bands_t *bands = arg;  /* bands being decoded */
+    Espa_band_meta_t *bmeta = &bands->xml_metadata->band[i];  /* band
+                                                      metadata */
+
+    printf ("  Band %s: %s to %s\n", bmeta->name, bands->jp2_files[i],
+        bmeta->file_name);
+    if (band_status != SUCCESS)
+    {
+        sprintf (errmsg, "Converting band %s: %s", bmeta->name,
+            bands->jp2_files[i]);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  convert_jp2_to_img
+
+PURPOSE: Convert the Sentinel JP2 bands to an ESPA raw binary (.img) file,
+and generate the ENVI header file.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error converting the JP2 file
+SUCCESS         Successfully converted JP2 file
+
+NOTES:
+  1. Several bands are decoded at the same time (see sentinel_decode_threads
+     and decode_jp2_band).  The progress and errors are reported in band
+     order, as each band completes.  Once a band fails, the bands which
+     haven't started are skipped.
+  2. The file names of the bands are updated from .jp2 to .img.
+  3. The size of each band in the metadata is the size after the change of
+     its resolution.
+  4. The JP2 files are read from src_files if it is given (such as the URLs
+     of a remote product), otherwise from the file names of the bands.
+  5. The raw binary files are written to the output directory, while the
+     file names of the bands stay relative to it, as the XML metadata file
+     is written there too.
+******************************************************************************/
+int convert_jp2_to_img
+(
+    Espa_internal_meta_t *xml_metadata, /* I/O: valid ESPA metadata
+                                               structure */
+    char (*src_files)[STR_SIZE], /* I: JP2 file of each band; NULL for the
+                                    file names of the bands */
+    char *out_dir,            /* I: directory of the raw binary files; NULL
+                                    for the current directory */
+    int granule_jobs,         /* I: number of granules converted at the same
+                                    time, which share the threads */
+    Sentinel_band_change_t *changes,  /* I: change of the resolution of each
+                                    band (see set_sentinel_resolution) */
+    Espa_browse_t *browse     /* I/O: browse the bands are added to; NULL if
+                                    none */
+)
+{
+    char FUNC_NAME[] = "convert_jp2_to_img";  /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    char *cptr = NULL;        /* pointer to the file extension */
+    char img_file[STR_SIZE];  /* raw binary file of a band */
+    char (*jp2_files)[STR_SIZE] = NULL;  /* JP2 file of each band */
+    int i;                    /* looping variable for bands in XML file */
+    int band_threads;         /* number of bands decoded at the same time */
+    int status;               /* status of all the bands */
+    Sentinel_bands_t bands;   /* bands being decoded */
+    Espa_band_meta_t *bmeta = NULL;  /* pointer to band metadata */
+
+    /* Determine the name of the output raw binary file of each band.
+       Replace the jp2 file extension with img in the Sentinel filenames. */
+    jp2_files = calloc (xml_metadata->nbands, sizeof (*jp2_files));
+    if (jp2_files == NULL)
+    {
+        sprintf (errmsg, "Allocating memory for the JP2 filenames");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    for (i = 0; i < xml_metadata->nbands; i++)
+    {
+        bmeta = &xml_metadata->band[i];
+        strcpy (jp2_files[i], (src_files != NULL) ? src_files[i] :
+            bmeta->file_name);
+        cptr = strrchr (bmeta->file_name, '.');
+        if (cptr == NULL)
+        {
+            sprintf (errmsg, "No file extension found in the Sentinel JP2 "
+                "file: %s\n", bmeta->file_name);
+            error_handler (true, FUNC_NAME, errmsg);
+            free (jp2_files);
+            return (ERROR);
+        }
+        strcpy (cptr, ".img");
+        if (sentinel_path (out_dir, bmeta->file_name, img_file) != SUCCESS)
+        {  /* Error messages already written */
+            free (jp2_files);
+            return (ERROR);
+        }
+        strcpy (bmeta->file_name, img_file);
+    }
+
+    /* Decode the bands and write the ENVI header of each one */
+    bands.xml_metadata = xml_metadata;
+    bands.jp2_files = jp2_files;
+    bands.changes = changes;
+    bands.browse = browse;
+    sentinel_decode_threads (xml_metadata->nbands, granule_jobs,
+        &band_threads, &bands.decoder_threads);
+    status = espa_parallel_for_ordered (xml_metadata->nbands, band_threads,
+        decode_sentinel_band, report_sentinel_band, &bands);
+
+    /* Name the raw binary files relative to the output directory again */
+    if (out_dir != NULL)
+    {
+        for (i = 0; i < xml_metadata->nbands; i++)
+        {
+            bmeta = &xml_metadata->band[i];
+            cptr = strrchr (bmeta->file_name, '/');
+            if (cptr != NULL)
+                memmove (bmeta->file_name, cptr + 1, strlen (cptr + 1) + 1);
+        }
+    }
+
+    free (jp2_files);
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  set_sentinel_corners
+
+PURPOSE: Computes the geographic UL and LR corners of the product from the
+projection information of its representative 10m band.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error mapping the corners
+SUCCESS         Successfully mapped the corners
+
+NOTES:
+  1. GCTP isn't re-entrant, so the caller runs this in the gctp critical
+     section when granules are converted at the same time.
+******************************************************************************/
+static int set_sentinel_corners
+(
+    Espa_internal_meta_t *xml_metadata  /* I/O: metadata of the product */
+)
+{
+    char FUNC_NAME[] = "convert_sentinel_to_espa";  /* function name */
+    char errmsg[STR_SIZE];            /* error message */
+    Img_coord_float_t img;            /* image coordinates for current pixel */
+    Geo_coord_t geo;                  /* geodetic coordinates (note radians) */
+    Space_def_t geoloc_def;           /* geolocation space information */
+    Geoloc_t *geoloc_map = NULL;      /* geolocation mapping information */
+    Espa_global_meta_t *gmeta = &xml_metadata->global;  /* global metadata */
+    Espa_band_meta_t *bmeta = &xml_metadata->band[1];  /* band 2, the
+                                         representative 10m band */
+
+    /* Get geolocation information from the XML file (using the first band) to
+       prepare for computing the bounding coordinates */
+    if (!get_geoloc_info (xml_metadata, &geoloc_def))
+    {
+        sprintf (errmsg, "Copying the geolocation information from the XML "
+            "metadata structure.");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Setup the mapping structure */
+    geoloc_map = setup_mapping (&geoloc_def);
+    if (geoloc_map == NULL)
+    {
+        sprintf (errmsg, "Setting up the geolocation mapping structure.");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Get the geographic coords for the UL corner */
+    img.l = 0.0;
+    img.s = 0.0;
+    img.is_fill = false;
+    if (!from_space (geoloc_map, &img, &geo))
+    {
+        sprintf (errmsg, "Mapping UL corner to lat/long");
+        error_handler (true, FUNC_NAME, errmsg);
+        free (geoloc_map);
+        return (ERROR);
+    }
+    gmeta->ul_corner[0] = geo.lat * DEG;
+    gmeta->ul_corner[1] = geo.lon * DEG;
+
+    /* Get the geographic coords for the LR corner */
+    img.l = bmeta->nlines-1;
+    img.s = bmeta->nsamps-1;
+    img.is_fill = false;
+    if (!from_space (geoloc_map, &img, &geo))
+    {
+        sprintf (errmsg, "Mapping LR corner to lat/long");
+        error_handler (true, FUNC_NAME, errmsg);
+        free (geoloc_map);
+        return (ERROR);
+    }
+    gmeta->lr_corner[0] = geo.lat * DEG;
+    gmeta->lr_corner[1] = geo.lon * DEG;
+
+    /* Free the geolocation structure */
+    free (geoloc_map);
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  remove_sentinel_xml_copies
+
+PURPOSE: Removes the copies of the product and tile XML files of a remote
+granule, and the directory they were copied to.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+static void remove_sentinel_xml_copies
+(
+    char *xml_dir,                   /* I: directory of the copies */
+    char (*xml_paths)[STR_SIZE]      /* I: paths of the two copies */
+)
+{
+    unlink (xml_paths[0]);
+    unlink (xml_paths[1]);
+    rmdir (xml_dir);
+}
+
+
+/******************************************************************************
+MODULE:  convert_sentinel_granule
+
+PURPOSE: Converts one Sentinel-2 (A&B L1C) granule, from its directory or a
+remote directory, to the ESPA internal raw binary file format (and
+associated XML file) in the output directory.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error converting the Sentinel-2 granule
+SUCCESS         Successfully converted Sentinel-2 granule to ESPA format
+
+NOTES:
+  1. See convert_sentinel_to_espa for the conversion itself.
+  2. The files of the granule are named by the granule directory, and those
+     of the product by the output directory, so nothing depends on the
+     current directory.
+  3. With an output directory, the XML files of a remote granule are copied
+     to a directory of their own within it, which is removed once they have
+     been parsed, so the granules converted at the same time don't overwrite
+     each other's copies.  Without one they are copied to the current
+     directory and kept.
+******************************************************************************/
+static int convert_sentinel_granule
+(
+    char *granule,    /* I: directory of the granule, or URL of the remote
+                            directory holding it; NULL for the current
+                            directory */
+    char *out_dir,    /* I: directory the product is written to; NULL for the
+                            current directory */
+    bool del_src,     /* I: should the source .jp2 files be removed after
+                            conversion? */
+    int resolution,   /* I: output resolution in meters of the bands which
+                            are finer; 0 for the native resolution */
+    bool common_grid, /* I: should the coarser bands be expanded to the
+                            resolution too? */
+    char *resample,   /* I: resampling methods of the bands (see
+                            set_sentinel_resample_methods); NULL for the
+                            defaults */
+    bool browse,      /* I: should the browse be built as the bands are
+                            decoded? */
+    int granule_jobs  /* I: number of granules converted at the same time,
+                            which share the threads */
+)
+{
+    char FUNC_NAME[] = "convert_sentinel_to_espa";  /* function name */
+    char errmsg[STR_SIZE];            /* error message */
+    char espa_xml_base[STR_SIZE];     /* output ESPA XML metadata filename
+                                         without its directory */
+    char espa_xml_file[STR_SIZE];     /* output ESPA XML metadata filename */
+    char jp2_base[STR_SIZE];          /* jp2 image file to delete, without
+                                         its directory */
+    char jp2_file[STR_SIZE];          /* jp2 image file to delete */
+    char orig_bandname[STR_SIZE];     /* original band1 filename */
+    char prodtype[STR_SIZE];          /* product type string for all bands */
+    char proc_ver[STR_SIZE];          /* processing ver string for all bands */
+    char l1_filename[STR_SIZE];       /* original level-1 filename for the
+                                         initial band to be used as base for
+                                         all bands */
+    char *b1_name = NULL;             /* band 1 Sentinel-2 filename */
+    char b1_file[STR_SIZE];           /* band 1 filename */
+    char url[STR_SIZE];               /* URL of a remote source file */
+    char xml_dir[STR_SIZE];           /* directory of the copies of the XML
+                                         files of a remote granule */
+    char xml_paths[2][STR_SIZE];      /* paths of the product and tile XML
+                                         files */
+    char (*src_files)[STR_SIZE] = NULL;  /* JP2 file of each band; NULL for
+                                            the bands in the current
+                                            directory */
+    char *xml_files[2] = {"MTD_MSIL1C.xml", "MTD_TL.xml"};
+                                      /* product and tile XML files */
+    char *source = NULL;              /* URL of a remote granule */
+    char *granule_dir = NULL;         /* directory of a local granule; NULL
+                                         for the current directory */
+    char *copy_dir = NULL;            /* directory the XML files of a remote
+                                         granule are copied to; NULL for the
+                                         current directory */
+    char *cptr = NULL;                /* pointer to the file extension */
+    float scale_factor;               /* scale factor for all bands */
+    int i;                            /* looping variable */
+    int count;                        /* number of chars copied in snprintf */
+    int status;                       /* return status */
+    Sentinel_band_change_t changes[NUM_SENTINEL_BANDS];  /* change of the
+                                         resolution of each band */
+
+    Espa_internal_meta_t xml_metadata;  /* ESPA XML metadata structure to be
+                                           populated by reading the Sentinel
+                                           XML file */
+    Espa_global_meta_t *gmeta = NULL; /* global metadata structure */
+    Espa_band_meta_t *bmeta = NULL;   /* band metadata pointer to all bands */
+    Espa_browse_t *browse_image = NULL;  /* browse being built; NULL if
+                                            none */
+
+    if (granule != NULL && is_remote_file (granule))
+        source = granule;
+    else
+        granule_dir = granule;
+
+    /* Copy the product and tile XML files of a remote product, otherwise
+       name them by the granule directory */
+    if (source != NULL)
+    {
+        if (del_src)
+        {
+            sprintf (errmsg, "Removing the source files isn't supported for "
+                "a remote product: %s", source);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+        if (out_dir != NULL)
+        {
+            if (sentinel_path (out_dir, "sentinel_xml_XXXXXX", xml_dir)
+                != SUCCESS)
+            {  /* Error messages already written */
+                return (ERROR);
+            }
+            if (mkdtemp (xml_dir) == NULL)
+            {
+                sprintf (errmsg, "Creating the directory for the Sentinel XML "
+                    "files of %s", source);
+                error_handler (true, FUNC_NAME, errmsg);
+                return (ERROR);
+            }
+            copy_dir = xml_dir;
+        }
+        for (i = 0; i < 2; i++)
+        {
+            if (sentinel_path (source, xml_files[i], url) != SUCCESS ||
+                sentinel_path (copy_dir, xml_files[i], xml_paths[i])
+                != SUCCESS || copy_remote_file (url, xml_paths[i]) != SUCCESS)
+            {
+                sprintf (errmsg, "Copying the Sentinel XML file %s",
+                    xml_files[i]);
+                error_handler (true, FUNC_NAME, errmsg);
+                if (copy_dir != NULL)
+                    remove_sentinel_xml_copies (copy_dir, xml_paths);
+                return (ERROR);
+            }
+        }
+    }
+    else
+    {
+        for (i = 0; i < 2; i++)
+        {
+            if (sentinel_path (granule_dir, xml_files[i], xml_paths[i])
+                != SUCCESS)
+            {  /* Error messages already written */
+                return (ERROR);
+            }
+        }
+    }
+
+    /* Initialize the metadata structure */
+    init_metadata_struct (&xml_metadata);
+    gmeta = &xml_metadata.global;
+
+    /* Allocate band metadata */
+    if (allocate_band_metadata (&xml_metadata, NUM_SENTINEL_BANDS) != SUCCESS)
+    {   /* Error messages already printed */
+        if (copy_dir != NULL)
+            remove_sentinel_xml_copies (copy_dir, xml_paths);
+        free_metadata (&xml_metadata);
         return (ERROR);
     }
-    gmeta->lr_corner[0] = geo.lat * DEG;
-    gmeta->lr_corner[1] = geo.lon * DEG;
 
-    /* Free the geolocation structure */
-    free (geoloc_map);
+    /* Read the Sentinel MTD_MSIL1C product and MTD_TL tile XML files together
+       and populate our internal ESPA metadata structure. The acquisition
+       date/time, product generation date/time, lat/long coords, product type,
+       and scale factor are available in the product XML file. The tile level
+       datum, projection, and zone, the number of lines/samples for each
+       resolution, and the UL x/y position are available in the tile XML
+       file. */
+    status = parse_sentinel_granule_metadata (
+        (source != NULL) ? copy_dir : granule_dir, xml_paths[0],
+        xml_paths[1], &xml_metadata, prodtype, proc_ver, l1_filename,
+        &scale_factor);
+    if (copy_dir != NULL)
+        remove_sentinel_xml_copies (copy_dir, xml_paths);
+    if (status != SUCCESS)
+    {
+        sprintf (errmsg, "Reading Sentinel product and tile XML files");
+        error_handler (true, FUNC_NAME, errmsg);
+        free_metadata (&xml_metadata);
+        return (ERROR);
+    }
+
+    /* Get the band 1 filename in the granule directory.  The remote
+       directory can't be listed, so for a remote product it is the level-1
+       filename of band 1 without its directories. */
+    if (source != NULL)
+    {
+        cptr = strrchr (l1_filename, '/');
+        count = snprintf (b1_file, sizeof (b1_file), "%s.jp2",
+            (cptr != NULL) ? cptr + 1 : l1_filename);
+        if (count < 0 || count >= sizeof (b1_file) ||
+            strstr (b1_file, "_B01.jp2") == NULL)
+        {
+            sprintf (errmsg, "Not able to determine the Sentinel-2 band 1 "
+                "file from the level-1 filename %s", l1_filename);
+            error_handler (true, FUNC_NAME, errmsg);
+            free_metadata (&xml_metadata);
+            return (ERROR);
+        }
+        b1_name = b1_file;
+    }
+    else
+        b1_name = read_dir (granule_dir, b1_file);
+    if (b1_name == NULL)
+    {
+        sprintf (errmsg, "Not able to find the Sentinel-2 band 1 file in "
+            "%s", (granule_dir != NULL) ? granule_dir :
+            "the current directory");
+        error_handler (true, FUNC_NAME, errmsg);
+        free_metadata (&xml_metadata);
+        return (ERROR);
+    }
+
+    /* Strip off the band and jpeg 2000 file extension. Store this as the
+       product_id in the global metadata. */
+    cptr = strstr (b1_name, "_B01.jp2");
+    *cptr = '\0';
+    snprintf (gmeta->product_id, sizeof (gmeta->product_id), "%s",
+        (const char *) b1_name);
+    
+    /* Strip the band from the level-1 filename to get the basename */
+    cptr = strrchr (l1_filename, '_');
+    *cptr = '\0';
+
+    /* The filename, product type, app version, and scale factor need to be
+       added to the band metadata for each of the bands */
+    for (i = 0; i < xml_metadata.nbands; i++)
+    {
+        bmeta = &xml_metadata.band[i];
+        snprintf (bmeta->file_name, sizeof (bmeta->file_name), "%s_%s.jp2",
+            (const char *) b1_name, sentinel_bands[i]);
+        strcpy (bmeta->short_name, prodtype);
+        bmeta->scale_factor = 1.0 / scale_factor;
+        snprintf (bmeta->l1_filename, sizeof (bmeta->l1_filename), "%s_%s",
+            (const char *) l1_filename, sentinel_bands[i]);
+
+        /* Sentinel-2 XML files contain the processing baseline version, so
+           that will be used to keep track of the ESA PDGS version number */
+        sprintf (bmeta->app_version, "ESA Payload Data Ground Segment v%s",
+            proc_ver);
+    }
+
+    /* Add the data provider USGS/EROS (Sentinel products delivered via EE) */
+    strcpy (gmeta->data_provider, "USGS/EROS");
+
+    /* Add the instrument which is MSI - MultiSpectral Instrument */
+    strcpy (gmeta->instrument, "MSI");
+
+    /* Set the orientation angle to 0 */
+    gmeta->orientation_angle = 0.0;
+
+    /* Update remaining information for band metadata for each of the bands */
+    for (i = 0; i < xml_metadata.nbands; i++)
+    {
+        bmeta = &xml_metadata.band[i];
+        strcpy (bmeta->product, "MSIL1C");
+        strcpy (bmeta->name, sentinel_bands[i]);
+        strcpy (bmeta->category, "image");
+        bmeta->data_type = ESPA_UINT16;
+        bmeta->fill_value = 0;
+        bmeta->saturate_value = 65535;
+        bmeta->valid_range[0] = 0.0;
+        bmeta->valid_range[1] = 65534.0;
+        strcpy (bmeta->data_units, "reflectance");
+        strcpy (bmeta->production_date, gmeta->level1_production_date);
+        sprintf (bmeta->long_name, "band %s top-of-atmosphere reflectance",
+            sentinel_band_nums[i]);
+    }
+
+    /* Compute the bounding coordinates, one granule at a time */
+#ifdef _OPENMP
+    #pragma omp critical (gctp)
+#endif
+    status = set_sentinel_corners (&xml_metadata);
+    if (status != SUCCESS)
+    {  /* Error messages already written */
+        free_metadata (&xml_metadata);
+        return (ERROR);
+    }
 
     /* If the source data is going to get removed, then save the band 1
        filename before it is renamed */
@@ -522,39 +1803,134 @@ int convert_sentinel_to_espa
         strcpy (orig_bandname, bmeta->file_name);
     }
 
+    /* The JP2 bands of a remote product are read from their URLs, and those
+       of a granule directory are named by it */
+    if (source != NULL || granule_dir != NULL)
+    {
+        src_files = calloc (xml_metadata.nbands, sizeof (*src_files));
+        if (src_files == NULL)
+        {
+            sprintf (errmsg, "Allocating memory for the JP2 filenames");
+            error_handler (true, FUNC_NAME, errmsg);
+            free_metadata (&xml_metadata);
+            return (ERROR);
+        }
+    }
+
+    /* Save the URLs of the remote JP2 bands before they are renamed */
+    if (source != NULL)
+    {
+        for (i = 0; i < xml_metadata.nbands; i++)
+        {
+            if (sentinel_path (source, xml_metadata.band[i].file_name,
+                src_files[i]) != SUCCESS)
+            {  /* Error messages already written */
+                free (src_files);
+                free_metadata (&xml_metadata);
+                return (ERROR);
+            }
+        }
+    }
+
     /* Rename the current Sentinel JP2 bands to a new filename (using the
        product_id) to be used by ESPA */
-    if (rename_jp2 (&xml_metadata) != SUCCESS)
+    if (rename_jp2 (&xml_metadata, granule_dir, source == NULL) != SUCCESS)
     {
         sprintf (errmsg, "Renaming Sentinel JP2 image files");
         error_handler (true, FUNC_NAME, errmsg);
+        free (src_files);
+        free_metadata (&xml_metadata);
+        return (ERROR);
+    }
+
+    /* Name the renamed JP2 bands by the granule directory */
+    if (source == NULL && granule_dir != NULL)
+    {
+        for (i = 0; i < xml_metadata.nbands; i++)
+        {
+            if (sentinel_path (granule_dir, xml_metadata.band[i].file_name,
+                src_files[i]) != SUCCESS)
+            {  /* Error messages already written */
+                free (src_files);
+                free_metadata (&xml_metadata);
+                return (ERROR);
+            }
+        }
+    }
+
+    /* Reduce the bands which are finer than the requested resolution, and
+       expand those which are coarser for a common grid */
+    if (set_sentinel_resolution (&xml_metadata, resolution, common_grid,
+        changes) != SUCCESS ||
+        set_sentinel_resample_methods (&xml_metadata, resample, changes)
+        != SUCCESS)
+    {
+        sprintf (errmsg, "Setting the resolution of the bands");
+        error_handler (true, FUNC_NAME, errmsg);
+        free (src_files);
+        free_metadata (&xml_metadata);
         return (ERROR);
     }
 
+    /* Choose the bands of the browse, at their final size */
+    if (browse)
+    {
+        browse_image = open_espa_browse (&xml_metadata, 0);
+        if (browse_image == NULL)
+        {  /* Error messages already written */
+            free (src_files);
+            free_metadata (&xml_metadata);
+            return (ERROR);
+        }
+    }
+
     /* Convert each of the Sentinel JP2 bands to raw binary, also create the
        ENVI header files using the XML metadata. Updates the filenames for
        each band to raw binary. */
-    if (convert_jp2_to_img (&xml_metadata) != SUCCESS)
+    if (convert_jp2_to_img (&xml_metadata, src_files, out_dir, granule_jobs,
+        changes, browse_image) != SUCCESS)
     {
         sprintf (errmsg, "Converting JP2 bands to raw binary");
         error_handler (true, FUNC_NAME, errmsg);
+        close_espa_browse (browse_image);
+        free (src_files);
+        free_metadata (&xml_metadata);
         return (ERROR);
     }
+    free (src_files);
 
     /* Write the metadata from our internal metadata structure to the output
        XML filename */
-    sprintf (espa_xml_file, "%s.xml", gmeta->product_id);
-    if (write_metadata (&xml_metadata, espa_xml_file) != SUCCESS)
+    sprintf (espa_xml_base, "%s.xml", gmeta->product_id);
+    if (sentinel_path (out_dir, espa_xml_base, espa_xml_file) != SUCCESS ||
+        write_metadata (&xml_metadata, espa_xml_file) != SUCCESS)
     {  /* Error messages already written */
+        close_espa_browse (browse_image);
+        free_metadata (&xml_metadata);
         return (ERROR);
     }
 
     /* Validate the output metadata file */
     if (validate_xml_file (espa_xml_file) != SUCCESS)
     {  /* Error messages already written */
+        close_espa_browse (browse_image);
+        free_metadata (&xml_metadata);
         return (ERROR);
     }
 
+    /* Write the browse, stretched with the statistics of its bands */
+    if (browse_image != NULL)
+    {
+        if (write_espa_browse (browse_image, &xml_metadata, espa_xml_file)
+            != SUCCESS)
+        {  /* Error messages already written */
+            close_espa_browse (browse_image);
+            free_metadata (&xml_metadata);
+            return (ERROR);
+        }
+        close_espa_browse (browse_image);
+    }
+
     /* Remove the source JP2 files if specified */
     if (del_src)
     {
@@ -565,16 +1941,22 @@ int convert_sentinel_to_espa
             bmeta = &xml_metadata.band[i];
 
             /* Remove the .jp2 files */
-            count = snprintf (jp2_file, sizeof (jp2_file), "%s",
+            count = snprintf (jp2_base, sizeof (jp2_base), "%s",
                 bmeta->file_name);
-            if (count < 0 || count >= sizeof (jp2_file))
+            if (count < 0 || count >= sizeof (jp2_base))
             {
                 sprintf (errmsg, "Overflow of jp2_file string");
                 error_handler (true, FUNC_NAME, errmsg);
+                free_metadata (&xml_metadata);
                 return (ERROR);
             }
-            cptr = strrchr (jp2_file, '.');
+            cptr = strrchr (jp2_base, '.');
             strcpy (cptr, ".jp2");
+            if (sentinel_path (granule_dir, jp2_base, jp2_file) != SUCCESS)
+            {  /* Error messages already written */
+                free_metadata (&xml_metadata);
+                return (ERROR);
+            }
 
             /* Remove the source file */
             printf ("  Removing source JPEG2000 file: %s\n", jp2_file);
@@ -582,29 +1964,30 @@ int convert_sentinel_to_espa
             {
                 sprintf (errmsg, "Deleting source file: %s", jp2_file);
                 error_handler (true, FUNC_NAME, errmsg);
+                free_metadata (&xml_metadata);
                 return (ERROR);
             }
         }
 
         /* Remove the TCI jp2 band, which retains its original filename. Only
            exists in the new S2 format so don't error check if it fails. */
-        count = snprintf (jp2_file, sizeof (jp2_file), "%s", orig_bandname);
-        if (count < 0 || count >= sizeof (jp2_file))
+        count = snprintf (jp2_base, sizeof (jp2_base), "%s", orig_bandname);
+        if (count < 0 || count >= sizeof (jp2_base))
         {
             sprintf (errmsg, "Overflow of jp2_file string");
             error_handler (true, FUNC_NAME, errmsg);
+            free_metadata (&xml_metadata);
             return (ERROR);
         }
-        cptr = strrchr (jp2_file, '_');
+        cptr = strrchr (jp2_base, '_');
         strcpy (cptr, "_TCI.jp2");
+        if (sentinel_path (granule_dir, jp2_base, jp2_file) != SUCCESS)
+        {  /* Error messages already written */
+            free_metadata (&xml_metadata);
+            return (ERROR);
+        }
         printf ("  Removing TCI jp2: %s\n", jp2_file);
         unlink (jp2_file);
-
-        /* Also remove the TCI raw band; only exists in the new S2 format */
-        cptr = strrchr (jp2_file, '.');
-        strcpy (cptr, ".raw");
-        printf ("  Removing TCI raw: %s\n", jp2_file);
-        unlink (jp2_file);
     }
 
     /* Free the metadata structure */
@@ -614,3 +1997,266 @@ int convert_sentinel_to_espa
     return (SUCCESS);
 }
 
+
+/******************************************************************************
+MODULE:  convert_sentinel_to_espa
+
+PURPOSE: Converts the input Sentinel-2 (A&B L1C) files to the ESPA internal raw
+binary file format (and associated XML file).  The MTD_MSIL1C.xml and MTD_TL.xml
+files are expected to be in the same directory as the Sentinel band data.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error converting the Sentinel-2 product
+SUCCESS         Successfully converted Sentinel-2 product to ESPA format
+
+NOTES:
+  1. The Sentinel JP2 band files will be deciphered from the Sentinel XML file.
+  2. The JP2 band files listed in the MTD_MSIL1C.xml file need to be available
+     in the same directory as both the MTD_MSIL1C product and MTD_TL tile XML
+     files.
+  3. The bands finer than the requested resolution are decoded at that
+     resolution (see set_sentinel_resolution and decode_jp2_band), rather
+     than being decoded at full resolution and resampled afterwards.  The
+     corners are those of the native 10 meter grid either way.  With a
+     common grid, the coarser bands are expanded to the resolution too, so
+     all the bands share one grid.  The bands are resampled with the
+     methods of the resample list (see set_sentinel_resample_methods).
+  4. With a source, the product is read from that remote directory (an
+     http://, https://, or s3:// URL; see espa_remote.h) rather than the
+     current directory.  The two XML files are copied to the current
+     directory, where the product is written, and the JP2 bands are read
+     with range requests as they are decoded.  The source files can't be
+     removed.
+******************************************************************************/
+int convert_sentinel_to_espa
+(
+    char *source,     /* I: URL of the remote directory holding the product;
+                            NULL for the current directory */
+    bool del_src,     /* I: should the source .jp2 files be removed after
+                            conversion? */
+    int resolution,   /* I: output resolution in meters of the bands which
+                            are finer; 0 for the native resolution */
+    bool common_grid, /* I: should the coarser bands be expanded to the
+                            resolution too? */
+    char *resample,   /* I: resampling methods of the bands (see
+                            set_sentinel_resample_methods); NULL for the
+                            defaults */
+    bool browse       /* I: should the browse be built as the bands are
+                            decoded? */
+)
+{
+    char FUNC_NAME[] = "convert_sentinel_to_espa";  /* function name */
+    char errmsg[STR_SIZE];            /* error message */
+
+    if (source != NULL && !is_remote_file (source))
+    {
+        sprintf (errmsg, "The source of the Sentinel product needs to be "
+            "an http://, https://, or s3:// URL: %s", source);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (convert_sentinel_granule (source, NULL, del_src, resolution,
+        common_grid, resample, browse, 1));
+}
+
+
+/* Granules being converted by convert_sentinel_batch */
+typedef struct
+{
+    char **granules;          /* directory or URL of each granule */
+    char *out_dir;            /* directory the products are written to */
+    bool del_src;             /* should the source .jp2 files be removed? */
+    int resolution;           /* output resolution of the finer bands */
+    bool common_grid;         /* are the coarser bands expanded too? */
+    char *resample;           /* resampling methods of the bands */
+    bool browse;              /* is the browse of each product built? */
+    int njobs;                /* number of granules converted at the same
+                                 time */
+    int *status;              /* status of converting each granule */
+    int nfailed;              /* number of granules which failed */
+} Sentinel_batch_t;
+
+
+/******************************************************************************
+MODULE:  convert_batch_granule
+
+PURPOSE: Converts one granule, as an iteration of the parallel loop over the
+granules of a batch.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error converting the granule
+SUCCESS         Successfully converted the granule
+
+NOTES:
+  1. The granule is reported by report_batch_granule.
+  2. Its status is kept for the report, and SUCCESS returned to the loop, as
+     the loop skips the iterations which haven't started once one fails.
+******************************************************************************/
+static int convert_batch_granule
+(
+    void *arg,                /* I/O: granules being converted */
+    int i,                    /* I: index of the granule */
+    int worker                /* I: worker converting the granule (unused) */
+)
+{
+    Sentinel_batch_t *batch = arg;  /* granules being converted */
+
+    batch->status[i] = convert_sentinel_granule (batch->granules[i],
+        batch->out_dir, batch->del_src, batch->resolution,
+        batch->common_grid, batch->resample, batch->browse, batch->njobs);
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  report_batch_granule
+
+PURPOSE: Reports a converted granule, in the order of the granules.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+SUCCESS         Always, so the rest of the granules are still converted
+
+NOTES:
+******************************************************************************/
+static int report_batch_granule
+(
+    void *arg,                /* I/O: granules being converted */
+    int i,                    /* I: index of the granule */
+    int loop_status           /* I: status of the iteration (unused) */
+)
+{
+    char FUNC_NAME[] = "convert_sentinel_batch";  /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    Sentinel_batch_t *batch = arg;  /* granules being converted */
+
+    if (batch->status[i] != SUCCESS)
+    {
+        sprintf (errmsg, "Converting Sentinel-2 granule: %s",
+            batch->granules[i]);
+        error_handler (true, FUNC_NAME, errmsg);
+        batch->nfailed++;
+    }
+    else
+        printf ("Converted Sentinel-2 granule: %s\n", batch->granules[i]);
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  convert_sentinel_batch
+
+PURPOSE: Converts a batch of Sentinel-2 (A&B L1C) granules to the ESPA
+internal raw binary file format (and associated XML files), several granules
+at a time, in this process.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error converting one or more of the granules
+SUCCESS         Successfully converted all the granules
+
+NOTES:
+  1. Each granule is a local directory holding the JP2 bands and the
+     MTD_MSIL1C.xml and MTD_TL.xml files, or the URL of a remote one (see
+     convert_sentinel_to_espa).  The products are all written to the output
+     directory, named by their product IDs.
+  2. The granules are converted by the threads of the task pool, njobs at a
+     time, and the bands of each granule are decoded by the pool too (see
+     convert_jp2_to_img).  Each granule gets an even share of the threads
+     for its decoders, so the granules together stay within the thread cap.
+     By default a granule is converted for each SENTINEL_DEFAULT_DECODE_BANDS
+     threads.
+  3. The JP2 bands are decoded in process with OpenJPEG (without it, by
+     gdal_translate as for a single granule).  Only the corner mapping runs
+     one granule at a time, as GCTP isn't re-entrant.
+  4. A granule which fails is reported, and the rest are still converted.
+  5. The XML library is initialized for the threads (see init_espa_xml), and
+     the caller calls shutdown_espa_xml once it is done with the metadata.
+******************************************************************************/
+int convert_sentinel_batch
+(
+    int ngranules,    /* I: number of granules */
+    char **granules,  /* I: directory or URL of each granule */
+    char *out_dir,    /* I: directory the products are written to; NULL for
+                            the current directory */
+    bool del_src,     /* I: should the source .jp2 files be removed after
+                            conversion? */
+    int resolution,   /* I: output resolution in meters of the bands which
+                            are finer; 0 for the native resolution */
+    bool common_grid, /* I: should the coarser bands be expanded to the
+                            resolution too? */
+    char *resample,   /* I: resampling methods of the bands (see
+                            set_sentinel_resample_methods); NULL for the
+                            defaults */
+    bool browse,      /* I: should the browse be built as the bands are
+                            decoded? */
+    int njobs         /* I: number of granules converted at the same time;
+                            0 for the default */
+)
+{
+    char FUNC_NAME[] = "convert_sentinel_batch";  /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    int nthreads;             /* cap on the number of threads */
+    Sentinel_batch_t batch;   /* granules being converted */
+
+    nthreads = espa_task_pool_threads ();
+    if (njobs < 1)
+        njobs = nthreads / SENTINEL_DEFAULT_DECODE_BANDS;
+    if (njobs > nthreads)
+        njobs = nthreads;
+    if (njobs > ngranules)
+        njobs = ngranules;
+    if (njobs < 1)
+        njobs = 1;
+
+    /* Compile the schema up front, rather than in each of the threads */
+    init_espa_xml ();
+    if (get_espa_schema () == NULL)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+
+    batch.granules = granules;
+    batch.out_dir = (out_dir != NULL) ? out_dir : ".";
+    batch.del_src = del_src;
+    batch.resolution = resolution;
+    batch.common_grid = common_grid;
+    batch.resample = resample;
+    batch.browse = browse;
+    batch.njobs = njobs;
+    batch.nfailed = 0;
+    batch.status = calloc (ngranules, sizeof (int));
+    if (batch.status == NULL)
+    {
+        sprintf (errmsg, "Allocating memory for the status of the granules");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    printf ("Converting %d Sentinel-2 granules, %d at a time\n", ngranules,
+        njobs);
+    espa_parallel_for_ordered (ngranules, njobs, convert_batch_granule,
+        report_batch_granule, &batch);
+    free (batch.status);
+
+    if (batch.nfailed > 0)
+    {
+        sprintf (errmsg, "%d of %d Sentinel-2 granules failed", batch.nfailed,
+            ngranules);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
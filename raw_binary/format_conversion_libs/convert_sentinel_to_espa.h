@@ -11,6 +11,8 @@ at the USGS EROS
 LICENSE TYPE:  NASA Open Source Agreement Version 1.3
 
 NOTES:
+  1. convert_sentinel_batch converts many granules at a time in one process,
+     sharing the decode threads between them.
 *****************************************************************************/
 
 #ifndef CONVERT_SENTINEL_TO_ESPA_H
@@ -24,17 +26,71 @@ NOTES:
 #include "espa_geoloc.h"
 #include "write_metadata.h"
 #include "envi_header.h"
+#include "raw_binary_io.h"
+#include "espa_band_stack.h"
+#include "raw_binary_stats.h"
+#include "espa_browse.h"
 #include "parse_sentinel_metadata.h"
+#include "sentinel_resample.h"
 
 /* Defines */
 /* number of Sentinel bands in an L1C product; ignore TCI */
 #define NUM_SENTINEL_BANDS 13
 
+/* Number of JP2 bands decoded at the same time, unless overridden by the
+   environment variable; the threads are shared by the decoders of the bands */
+#define SENTINEL_DECODE_BANDS_ENV "ESPA_JP2_DECODE_BANDS"
+#define SENTINEL_DEFAULT_DECODE_BANDS 4
+
+/* Change of the resolution of a band (see set_sentinel_resolution) */
+typedef struct
+{
+    int factor;               /* factor of the change; 1 if the band is left
+                                 at its native resolution */
+    bool expand;              /* is the band expanded to a finer resolution
+                                 rather than reduced? */
+    enum Sentinel_resample_method method;  /* resampling method */
+} Sentinel_band_change_t;
+
 /* Prototypes */
 int convert_sentinel_to_espa
 (
-    bool del_src             /* I: should the source .jp2 files be removed
+    char *source,            /* I: URL of the remote directory holding the
+                                   product; NULL for the current directory */
+    bool del_src,            /* I: should the source .jp2 files be removed
+                                   after conversion? */
+    int resolution,          /* I: output resolution in meters of the bands
+                                   which are finer; 0 for the native
+                                   resolution */
+    bool common_grid,        /* I: should the coarser bands be expanded to
+                                   the resolution too? */
+    char *resample,          /* I: resampling methods of the bands (see
+                                   set_sentinel_resample_methods); NULL for
+                                   the defaults */
+    bool browse              /* I: should the browse be built as the bands
+                                   are decoded? */
+);
+
+int convert_sentinel_batch
+(
+    int ngranules,           /* I: number of granules */
+    char **granules,         /* I: directory or URL of each granule */
+    char *out_dir,           /* I: directory the products are written to;
+                                   NULL for the current directory */
+    bool del_src,            /* I: should the source .jp2 files be removed
                                    after conversion? */
+    int resolution,          /* I: output resolution in meters of the bands
+                                   which are finer; 0 for the native
+                                   resolution */
+    bool common_grid,        /* I: should the coarser bands be expanded to
+                                   the resolution too? */
+    char *resample,          /* I: resampling methods of the bands (see
+                                   set_sentinel_resample_methods); NULL for
+                                   the defaults */
+    bool browse,             /* I: should the browse be built as the bands
+                                   are decoded? */
+    int njobs                /* I: number of granules converted at the same
+                                   time; 0 for the default */
 );
 
 #endif
@@ -20,14 +20,25 @@ NOTES:
      from the VIIRS surface reflectance product.  Those bands exist in the
      /HDFEOS/GRIDS/VNP_Grid_500m_2D/Data Fields structure and are named
      SurfReflect_I[1|2|3]
-  4. The geolocation information requires accessing the HDF5 product as an
-     HDFEOS5 product, using the HDFEOS5 libraries.
+  4. The geolocation information comes from the HDF-EOS5 structural metadata
+     (StructMetadata.0) of the HDF5 product, parsed with the ODL index of
+     espa_odl rather than through the HDFEOS5 library, so the product is
+     opened only once.
 *****************************************************************************/
 #include <unistd.h>
 #include <math.h>
 #include <ctype.h>
+#include <zlib.h>
 #include "convert_viirs_to_espa.h"
 #include "doy_to_month_day.h"
+#include "espa_trace.h"
+#include "espa_log.h"
+#include "espa_task_pool.h"
+
+#if !H5_VERSION_GE(1, 10, 3)
+#include <hdf5_hl.h>
+#define H5Dread_chunk H5DOread_chunk
+#endif
 
 
 /******************************************************************************
@@ -191,831 +202,1875 @@ int get_tile
 
 
 /******************************************************************************
-MODULE:  read_attribute
+MODULE:  compare_viirs_attrs
 
-PURPOSE: Read the specified attribute from the specified dataset.  The
-data type for the attribute must match the data type on the variable used
-for output and memory must already be allocated.
+PURPOSE: Orders the attributes of the granule by dataset and name.
 
 RETURN VALUE:
 Type = int
 Value           Description
 -----           -----------
-ERROR           Error reading the specified attribute
-SUCCESS         Successfully read the attribute
+<0, 0, >0       Standard qsort ordering
 
 NOTES:
 ******************************************************************************/
-int read_attribute
+static int compare_viirs_attrs
 (
-    char *attr_name,       /* I: name of the attribute to read */
-    hid_t dataset_id,      /* I: dataset ID to read the specified attribute */
-    void *attr_val         /* O: pointer to the attribute value; datatype
-                                 must match that which is specified by the
-                                 data_type */
+    const void *a,             /* I: first attribute */
+    const void *b              /* I: second attribute */
 )
 {
-    char FUNC_NAME[] = "read_attribute";  /* function name */
-    char errmsg[STR_SIZE];    /* error message */
-    hid_t attr_id;            /* attribute ID for the current dataset */
-    hid_t atype;              /* datatype of the attribute */
-    herr_t status;            /* return status */
+    const Viirs_attr_t *aa = a;  /* first attribute */
+    const Viirs_attr_t *ab = b;  /* second attribute */
+    int cmp;                   /* comparison of the datasets */
+
+    cmp = strcmp (aa->object, ab->object);
+    if (cmp == 0)
+        cmp = strcmp (aa->name, ab->name);
+    return cmp;
+}
+
+
+/* Object whose attributes are being indexed by index_viirs_attr */
+typedef struct
+{
+    Viirs_granule_t *granule;  /* granule holding the index */
+    const char *object;        /* name of the object; "/" for the root group */
+} Viirs_attr_iter_t;
+
 
-    /* Read the specified attribute from the dataset */
-    attr_id = H5Aopen_name (dataset_id, attr_name);
+/******************************************************************************
+MODULE:  index_viirs_attr
+
+PURPOSE: Reads an attribute of the root group or of a band dataset into the
+attribute index of the granule.  Called by H5Aiterate_by_name.
+
+RETURN VALUE:
+Type = herr_t
+Value           Description
+-----           -----------
+-1              Error reading the attribute
+0               Successfully indexed the attribute
+
+NOTES:
+  1. String attributes are kept as strings (the first string of an array).
+     Integer and floating point attributes are converted to double and their
+     first value is kept.  Attributes of any other class are skipped.
+******************************************************************************/
+static herr_t index_viirs_attr
+(
+    hid_t loc_id,              /* I: object holding the attribute */
+    const char *attr_name,     /* I: name of the attribute */
+    const H5A_info_t *ainfo,   /* I: information on the attribute (unused) */
+    void *op_data              /* I/O: Viirs_attr_iter_t of the object */
+)
+{
+    char FUNC_NAME[] = "index_viirs_attr";  /* function name */
+    char errmsg[STR_SIZE];     /* error message */
+    char *str = NULL;          /* value of a fixed-length string attribute */
+    char **vstr = NULL;        /* values of a variable-length string
+                                  attribute */
+    double *values = NULL;     /* values of a numeric attribute */
+    int i;                     /* looping variable */
+    int count;                 /* number of chars copied in snprintf */
+    int max_attrs;             /* number of attributes allocated */
+    herr_t retval = -1;        /* return status */
+    hid_t attr_id = -1;        /* attribute being read */
+    hid_t atype = -1;          /* datatype of the attribute */
+    hid_t mtype = -1;          /* memory datatype of a variable-length
+                                  string */
+    hid_t space_id = -1;       /* data space of the attribute */
+    hssize_t npoints;          /* number of values of the attribute */
+    size_t size;               /* size of a fixed-length string */
+    H5T_class_t t_class;       /* class of the datatype */
+    Viirs_attr_iter_t *iter = op_data;  /* object being indexed */
+    Viirs_granule_t *granule = iter->granule;  /* granule being indexed */
+    Viirs_attr_t *attrs = NULL;  /* reallocated attributes */
+    Viirs_attr_t *attr = NULL;   /* attribute being indexed */
+
+    /* Open the attribute and check it holds values we keep */
+    attr_id = H5Aopen (loc_id, attr_name, H5P_DEFAULT);
     if (attr_id < 0)
     {
         sprintf (errmsg, "Unable to open attribute: %s", attr_name);
         error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
+        return (-1);
     }
 
     atype = H5Aget_type (attr_id);
-    status = H5Aread (attr_id, atype, attr_val);
-    if (status < 0)
+    space_id = H5Aget_space (attr_id);
+    npoints = space_id < 0 ? -1 : H5Sget_simple_extent_npoints (space_id);
+    t_class = atype < 0 ? H5T_NO_CLASS : H5Tget_class (atype);
+    if (atype < 0 || npoints < 0 || t_class == H5T_NO_CLASS)
     {
-        sprintf (errmsg, "Unable to read attribute: %s", attr_name);
+        sprintf (errmsg, "Unable to get the datatype and size of attribute: "
+            "%s", attr_name);
         error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
+        goto cleanup;
+    }
+    if ((t_class != H5T_STRING && t_class != H5T_INTEGER &&
+        t_class != H5T_FLOAT) || npoints == 0)
+    {
+        retval = 0;
+        goto cleanup;
+    }
+
+    /* Make room for the attribute in the index */
+    if (granule->nattrs == granule->max_attrs)
+    {
+        max_attrs = granule->max_attrs == 0 ? 64 : 2 * granule->max_attrs;
+        attrs = realloc (granule->attrs, max_attrs * sizeof (Viirs_attr_t));
+        if (attrs == NULL)
+        {
+            sprintf (errmsg, "Allocating the attribute index");
+            error_handler (true, FUNC_NAME, errmsg);
+            goto cleanup;
+        }
+        granule->attrs = attrs;
+        granule->max_attrs = max_attrs;
+    }
+    attr = &granule->attrs[granule->nattrs];
+    memset (attr, 0, sizeof (Viirs_attr_t));
+
+    count = snprintf (attr->object, sizeof (attr->object), "%s",
+        iter->object);
+    if (count < 0 || count >= sizeof (attr->object))
+    {
+        sprintf (errmsg, "Overflow of attr->object string");
+        error_handler (true, FUNC_NAME, errmsg);
+        goto cleanup;
+    }
+    count = snprintf (attr->name, sizeof (attr->name), "%s", attr_name);
+    if (count < 0 || count >= sizeof (attr->name))
+    {
+        sprintf (errmsg, "Overflow of attr->name string");
+        error_handler (true, FUNC_NAME, errmsg);
+        goto cleanup;
+    }
+
+    /* Read the values */
+    if (t_class == H5T_STRING && H5Tis_variable_str (atype) > 0)
+    {
+        vstr = calloc (npoints, sizeof (char *));
+        mtype = H5Tcopy (H5T_C_S1);
+        if (vstr == NULL || mtype < 0 ||
+            H5Tset_size (mtype, H5T_VARIABLE) < 0 ||
+            H5Aread (attr_id, mtype, vstr) < 0)
+        {
+            sprintf (errmsg, "Unable to read attribute: %s", attr_name);
+            error_handler (true, FUNC_NAME, errmsg);
+            goto cleanup;
+        }
+        attr->string = strdup (vstr[0] != NULL ? vstr[0] : "");
+    }
+    else if (t_class == H5T_STRING)
+    {
+        size = H5Tget_size (atype);
+        str = malloc (size * npoints + 1);
+        if (str == NULL || H5Aread (attr_id, atype, str) < 0)
+        {
+            sprintf (errmsg, "Unable to read attribute: %s", attr_name);
+            error_handler (true, FUNC_NAME, errmsg);
+            goto cleanup;
+        }
+        str[size] = '\0';
+        attr->string = str;
+        str = NULL;
     }
+    else
+    {
+        values = malloc (npoints * sizeof (double));
+        if (values == NULL ||
+            H5Aread (attr_id, H5T_NATIVE_DOUBLE, values) < 0)
+        {
+            sprintf (errmsg, "Unable to read attribute: %s", attr_name);
+            error_handler (true, FUNC_NAME, errmsg);
+            goto cleanup;
+        }
+        attr->value = values[0];
+    }
+    if (t_class == H5T_STRING && attr->string == NULL)
+    {
+        sprintf (errmsg, "Allocating the value of attribute: %s", attr_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        goto cleanup;
+    }
+
+    granule->nattrs++;
+    retval = 0;
 
-    status = H5Aclose (attr_id);
-    if (status < 0)
+cleanup:
+    if (vstr != NULL)
+    {
+        for (i = 0; i < npoints; i++)
+            H5free_memory (vstr[i]);
+        free (vstr);
+    }
+    free (str);
+    free (values);
+    if (mtype >= 0)
+        H5Tclose (mtype);
+    if (space_id >= 0)
+        H5Sclose (space_id);
+    if (atype >= 0)
+        H5Tclose (atype);
+    if (H5Aclose (attr_id) < 0)
     {
         sprintf (errmsg, "Terminating access to attribute: %s", attr_name);
         error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
+        retval = -1;
     }
 
-    return (SUCCESS);
+    return (retval);
 }
 
 
 /******************************************************************************
-MODULE:  read_viirs_500m_geo_meta
+MODULE:  index_viirs_band
 
-PURPOSE: Read the geolocation metadata (HDF-EOS) for the surface reflectance
-imagery bands from VIIRS 500m grid and populate the ESPA internal metadata
-structure.
+PURPOSE: Checks the datatype and dimensions of a surface reflectance dataset
+of the 500m grid, records it as a band of the granule, and indexes its
+attributes.
 
 RETURN VALUE:
 Type = int
 Value           Description
 -----           -----------
-ERROR           Error reading the VIIRS HDF-EOS metadata
-SUCCESS         Successfully populated the ESPA metadata structure
+ERROR           Error reading the dataset
+SUCCESS         Successfully indexed the dataset
 
 NOTES:
 ******************************************************************************/
-int read_viirs_500m_geo_meta
+static int index_viirs_band
 (
-    char *viirs_hdf_name,            /* I: name of VIIRS file to be read */
-    Espa_internal_meta_t *metadata   /* I/O: input metadata structure to be
-                                           populated from the VIIRS file */
+    Viirs_granule_t *granule,  /* I/O: granule being indexed */
+    const char *dataset_name   /* I: name of the dataset in the 500m grid */
 )
 {
-    char FUNC_NAME[] = "read_viirs_500m_geo_meta";  /* function name */
-    char errmsg[STR_SIZE];    /* error message */
-    char *grid500 = NULL;     /* name of the 500m HDF-EOS grid group */
-    hid_t file_id;            /* file ID for HDF-EOS */
-    hid_t grid_id;            /* grid ID for 500m grid */
-    hid_t status;             /* return status from HDF-EOS function */
-    int projcode;             /* projection code */
-    int zonecode;             /* UTM zone code */
-    int spherecode;           /* sphere code */
-    int origincode;           /* grid origin for corner points */
-    long xdimsize;            /* x-dimension */
-    long ydimsize;            /* y-dimension */
-    double projparm[15];      /* projection parameters */
-    double central_meridian;  /* central meridian for the sinusoidal projection
-                                 (in DMS) */
-    Espa_global_meta_t *gmeta = &metadata->global;  /* pointer to the global
-                                                       metadata structure */
+    char FUNC_NAME[] = "index_viirs_band";  /* function name */
+    char errmsg[STR_SIZE];     /* error message */
+    int count;                 /* number of chars copied in snprintf */
+    int ndims;                 /* number of dimensions in the dataset */
+    int retval = ERROR;        /* return status */
+    hid_t dataset_id;          /* dataset of the band */
+    hid_t dtype_id = -1;       /* datatype of the dataset */
+    hid_t dspace_id = -1;      /* data space of the dataset */
+    hsize_t dims[MAX_VIIRS_DIMS];  /* dimensions of the dataset */
+    H5T_class_t t_class;       /* data type class */
+    Viirs_attr_iter_t iter;    /* dataset whose attributes are indexed */
+    int band = granule->nbands;  /* index of the band */
 
-    /* Open VIIRS file for reading as a HDF-EOS file */
-    file_id = HE5_GDopen (viirs_hdf_name, H5F_ACC_RDONLY);
-    if (file_id < 0)
+    if (band == MAX_VIIRS_BANDS)
     {
-        sprintf (errmsg, "Unable to open %s", viirs_hdf_name);
+        sprintf (errmsg, "More than %d surface reflectance bands in the 500m "
+            "grid", MAX_VIIRS_BANDS);
         error_handler (true, FUNC_NAME, errmsg);
         return (ERROR);
     }
 
-    /* Attach to the 500m grid */
-    grid500 = "VNP_Grid_500m_2D";
-    grid_id = HE5_GDattach (file_id, grid500);
-    if (grid_id < 0)
+    /* Store the band/SDS information */
+    count = snprintf (granule->band_name[band],
+        sizeof (granule->band_name[band]), "%s", dataset_name);
+    if (count < 0 || count >= sizeof (granule->band_name[band]))
     {
-        sprintf (errmsg, "Unable to attach to grid: %s", grid500);
+        sprintf (errmsg, "Overflow of band_name[] string");
         error_handler (true, FUNC_NAME, errmsg);
         return (ERROR);
     }
 
-    /* Get the projection information for this grid */
-    status = HE5_GDprojinfo (grid_id, &projcode, &zonecode, &spherecode,
-        projparm);
-    if (status != 0)
+    /* Open the dataset */
+    dataset_id = H5Dopen (granule->grid500_id, dataset_name, H5P_DEFAULT);
+    if (dataset_id < 0)
     {
-        sprintf (errmsg, "Reading grid projection information from HDFEOS "
-            "header");
+        sprintf (errmsg, "Unable to open 500m dataset: %s", dataset_name);
         error_handler (true, FUNC_NAME, errmsg);
         return (ERROR);
     }
 
-    /* Store the projection info */
-    if (projcode != HE5_GCTP_SNSOID)
+    /* Data is expected to be signed 16-bit integers */
+    dtype_id = H5Dget_type (dataset_id);
+    if (dtype_id < 0)
     {
-        sprintf (errmsg, "Invalid projection type.  VIIRS data is "
-            "expected to be in the Sinusoidal projection.");
+        sprintf (errmsg, "Unable to get the datatype");
         error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
+        goto cleanup;
     }
-    gmeta->proj_info.proj_type = GCTP_SIN_PROJ;
-
-    if (spherecode != ESPA_NODATUM)
+    t_class = H5Tget_class (dtype_id);
+    if (t_class < 0)
     {
-        sprintf (errmsg, "Invalid sphere code.  VIIRS data is expected "
-            "to be in the Sinusoidal projection and have a sphere code "
-            "of %d.", ESPA_NODATUM);
+        sprintf (errmsg, "Invalid datatype");
         error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
+        goto cleanup;
+    }
+    if (t_class != H5T_INTEGER)
+    {
+        sprintf (errmsg, "Unexpected datatype for the current band: %s.  "
+            "Integer expected.", dataset_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        goto cleanup;
+    }
+    if (H5Tget_sign (dtype_id) != H5T_SGN_2)
+    {
+        sprintf (errmsg, "Data is expected to be signed");
+        error_handler (true, FUNC_NAME, errmsg);
+        goto cleanup;
+    }
+    if (H5Tget_size (dtype_id) != 2)
+    {
+        sprintf (errmsg, "Data is expected to be 16-bit");
+        error_handler (true, FUNC_NAME, errmsg);
+        goto cleanup;
     }
-    gmeta->proj_info.datum_type = ESPA_NODATUM;
-    strcpy (gmeta->proj_info.units, "meters");
-
-    /* Store the input projection parameters for Sinusoidal */
-    gmeta->proj_info.sphere_radius = projparm[0];
-    central_meridian = projparm[4];
-    gmeta->proj_info.false_easting = projparm[6];
-    gmeta->proj_info.false_northing = projparm[7];
-
-    /* According to HDF-EOS documentation angular projection parameters
-       in HDF-EOS structural metadata are in DMS.  Convert the central
-       meridian from DMS to decimal degrees. */
-    dmsdeg (central_meridian, &gmeta->proj_info.central_meridian);
 
-    /* Get the grid dimension and corner info. Projection coords are in
-       meters since this should be the Sinusoidal projection. */
-    status = HE5_GDgridinfo (grid_id, &xdimsize, &ydimsize,
-        gmeta->proj_info.ul_corner, gmeta->proj_info.lr_corner);
-    if (status != 0)
+    /* Get the number of dimensions and verify it's 2-D */
+    dspace_id = H5Dget_space (dataset_id);
+    if (dspace_id < 0)
     {
-        sprintf (errmsg, "Reading dimension and corner information "
-            "from HDF header");
+        sprintf (errmsg, "Unable to get the data space");
         error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
+        goto cleanup;
+    }
+    ndims = H5Sget_simple_extent_ndims (dspace_id);
+    if (ndims < 0)
+    {
+        sprintf (errmsg, "Unable to determine the number of dimensions of "
+            "this dataset, but two dimensions are expected");
+        error_handler (true, FUNC_NAME, errmsg);
+        goto cleanup;
+    }
+    else if (ndims != MAX_VIIRS_DIMS)
+    {
+        sprintf (errmsg, "Dataset is expected to be a 2-D dataset, however "
+            "is has %d dimensions", ndims);
+        error_handler (true, FUNC_NAME, errmsg);
+        goto cleanup;
     }
+    printf ("    ndims is %d (2D expected)\n", ndims);
 
-    /* Get the coordinate system origin.  If the grid origin isn't
-       specified then default to the UL which is standard for HDF. */
-    status = HE5_GDorigininfo (grid_id, &origincode);
-    if (status != 0)
-        strcpy (gmeta->proj_info.grid_origin, "UL");
-    else if (origincode == HE5_HDFE_GD_UL)
-        strcpy (gmeta->proj_info.grid_origin, "UL");
-    else
-        strcpy (gmeta->proj_info.grid_origin, "CENTER");
+    if (H5Sget_simple_extent_dims (dspace_id, dims, NULL) < 0)
+    {
+        sprintf (errmsg, "Unable to determine the dimensions of this "
+            "dataset, but two dimensions are expected");
+        error_handler (true, FUNC_NAME, errmsg);
+        goto cleanup;
+    }
+    printf ("    dataset dimensions are %d x %d\n", (int) dims[0],
+        (int) dims[1]);
+    granule->band_dims[band][0] = (int) dims[0];
+    granule->band_dims[band][1] = (int) dims[1];
+
+    /* Index the attributes of the dataset */
+    iter.granule = granule;
+    iter.object = granule->band_name[band];
+    if (H5Aiterate2 (dataset_id, H5_INDEX_NAME, H5_ITER_NATIVE, NULL,
+        index_viirs_attr, &iter) < 0)
+    {
+        sprintf (errmsg, "Unable to read the attributes of 500m dataset: %s",
+            dataset_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        goto cleanup;
+    }
 
-    /* Close grid */
-    HE5_GDdetach (grid_id);
+    granule->nbands++;
+    retval = SUCCESS;
 
-    /* Close the HDF-EOS file */
-    HE5_GDclose (file_id);
+cleanup:
+    if (dspace_id >= 0)
+        H5Sclose (dspace_id);
+    if (dtype_id >= 0)
+        H5Tclose (dtype_id);
+    if (H5Dclose (dataset_id) < 0)
+    {
+        sprintf (errmsg, "Terminating access to 500m dataset: %s",
+            dataset_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        retval = ERROR;
+    }
 
-    /* Successful read */
-    return (SUCCESS);
+    return (retval);
 }
 
 
 /******************************************************************************
-MODULE:  read_viirs_500m_grid_meta
+MODULE:  read_viirs_struct_meta
 
-PURPOSE: Read the metadata for the surface reflectance imagery bands from the
-VIIRS 500m grid and populate the ESPA internal metadata structure for each of
-the bands.
+PURPOSE: Reads the HDF-EOS structural metadata (StructMetadata.0) of the
+granule and parses it into an index of its values.
 
 RETURN VALUE:
 Type = int
 Value           Description
 -----           -----------
-ERROR           Error reading the VIIRS metadata
-SUCCESS         Successfully populated the ESPA metadata structure
+ERROR           Error reading the structural metadata
+SUCCESS         Successfully read and parsed the structural metadata
 
 NOTES:
 ******************************************************************************/
-int read_viirs_500m_grid_meta
+static int read_viirs_struct_meta
 (
-    char *viirs_hdf_name,            /* I: name of VIIRS file to be read */
-    Espa_internal_meta_t *metadata   /* I/O: input metadata structure to be
-                                           populated from the VIIRS file */
+    Viirs_granule_t *granule   /* I/O: granule being indexed */
 )
 {
-    char FUNC_NAME[] = "read_viirs_500m_grid_meta";  /* function name */
-    char errmsg[STR_SIZE];    /* error message */
-    char basename[STR_SIZE];  /* filename without path (uppercase) */
-    char core_basename[STR_SIZE]; /* filename without path and extension */
-    char dataset_name[STR_SIZE];  /* name of dataset in the 500m grid */
-    char *grid500 = NULL;         /* name of the 500m grid group */
-    char prod_date_time[STR_SIZE];  /* production date/time */
-    char pge_version[STR_SIZE];     /* PGE version */
-    char viirs_bands[MAX_VIIRS_BANDS][STR_SIZE]; /* array containing names of
-                                 the VIIRS bands/SDSs to be written to the
-                                 ESPA XML file */
-    char longname[MAX_VIIRS_BANDS][STR_SIZE]; /* array long_name attributes */
-    char qa_desc[MAX_VIIRS_BANDS][HUGE_STR_SIZE]; /* array qa description
-                                                     attributes */
-    char units[MAX_VIIRS_BANDS][STR_SIZE];    /* array units attributes */
-    char *cptr = NULL;        /* character pointer for strings */
-    int i;                    /* looping variables */
-    int count;                /* number of chars copied in snprintf */
-    int nviirs_bands;         /* number of bands that will be in the ESPA
-                                 product from the VIIRS file */
-    double scalevalue[MAX_VIIRS_BANDS];    /* scale factor for current SDS */
-    double offsetvalue[MAX_VIIRS_BANDS];   /* offset for current SDS */
-    double minvalue[MAX_VIIRS_BANDS];  /* minimum band value for current SDS */
-    double maxvalue[MAX_VIIRS_BANDS];  /* maximum band value for current SDS */
-    double fillvalue[MAX_VIIRS_BANDS]; /* fill value for current SDS */
-    int data_type[MAX_VIIRS_BANDS];    /* data type for each SDS */
-
-    herr_t status;             /* return status */
-    hid_t file_id;             /* file ID for the VIIRS file */
-    hid_t root_id;             /* group ID for the root grid */
-    hid_t grid500_id;          /* group ID for the 500m grid */
-    hid_t dataset_id;          /* current dataset ID for the VIIRS file */
-    hid_t dtype_id;            /* datatype ID for the current dataset */
-    hid_t dspace_id;           /* data space ID for the current dataset */
-    size_t t_size;             /* size of the datatype in bytes */
-    H5G_info_t grid500_info;   /* group information for the 500m grid */
-    H5T_class_t t_class;       /* data type class */
-    H5T_sign_t t_sign;         /* signed/unsigned datatype */
-    int ndims;                 /* number of dimensions in the dataset */
-    hsize_t dims[2];           /* 2D array dimensions */
-    int grid_dims[MAX_VIIRS_BANDS][2];  /* x,y dimensions of current band */
-
-    Img_coord_float_t img;        /* image coordinates for current pixel */
-    Geo_coord_t geo;              /* geodetic coordinates (radians) */
-    Space_def_t geoloc_def;       /* geolocation space information */
-    Geoloc_t *geoloc_map = NULL;  /* geolocation mapping information */
-    Espa_global_meta_t *gmeta = &metadata->global;  /* pointer to the global
-                                                       metadata structure */
-    Espa_band_meta_t *bmeta=NULL; /* pointer to the array of bands metadata */
+    char FUNC_NAME[] = "read_viirs_struct_meta";  /* function name */
+    char errmsg[STR_SIZE];     /* error message */
+    char *text = NULL;         /* text of the structural metadata */
+    char *vtext = NULL;        /* variable-length text */
+    char *dataset_name = NULL; /* name of the structural metadata dataset */
+    size_t size;               /* size of fixed-length text */
+    hid_t dataset_id;          /* dataset of the structural metadata */
+    hid_t dtype_id = -1;       /* datatype of the dataset */
+    hid_t mtype = -1;          /* memory datatype of variable-length text */
+
+    dataset_name = "/HDFEOS INFORMATION/StructMetadata.0";
+    dataset_id = H5Dopen (granule->file_id, dataset_name, H5P_DEFAULT);
+    if (dataset_id < 0)
+    {
+        sprintf (errmsg, "Unable to open the HDF-EOS structural metadata: %s",
+            dataset_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
 
-    /* Get the basename of the input HDF5 file */
-    cptr = strrchr (viirs_hdf_name, '/');
-    if (cptr != NULL)
+    /* The text is written as a fixed-length string, but read variable-length
+       strings as well */
+    dtype_id = H5Dget_type (dataset_id);
+    if (dtype_id >= 0 && H5Tis_variable_str (dtype_id) > 0)
     {
-        /* Copy the basename from the cptr, after moving off of the '/' */
-        cptr++;
-        count = snprintf (basename, sizeof (basename), "%s", cptr);
-        if (count < 0 || count >= sizeof (basename))
+        mtype = H5Tcopy (H5T_C_S1);
+        if (mtype >= 0 && H5Tset_size (mtype, H5T_VARIABLE) >= 0 &&
+            H5Dread (dataset_id, mtype, H5S_ALL, H5S_ALL, H5P_DEFAULT,
+            &vtext) >= 0 && vtext != NULL)
         {
-            sprintf (errmsg, "Overflow of basename string");
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
+            text = strdup (vtext);
+            H5free_memory (vtext);
         }
+        if (mtype >= 0)
+            H5Tclose (mtype);
     }
-    else
+    else if (dtype_id >= 0)
     {
-        /* Copy the filename itself as the basename since it doesn't have a
-           path in the filename */
-        count = snprintf (basename, sizeof (basename), "%s", viirs_hdf_name);
-        if (count < 0 || count >= sizeof (basename))
+        size = H5Tget_size (dtype_id);
+        text = malloc (size + 1);
+        if (text != NULL && H5Dread (dataset_id, dtype_id, H5S_ALL, H5S_ALL,
+            H5P_DEFAULT, text) < 0)
         {
-            sprintf (errmsg, "Overflow of basename string");
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
+            free (text);
+            text = NULL;
         }
+        else if (text != NULL)
+            text[size] = '\0';
     }
-
-    /* Strip the extension off the basename */
-    count = snprintf (core_basename, sizeof (core_basename), "%s", basename);
-    if (count < 0 || count >= sizeof (core_basename))
+    if (dtype_id >= 0)
+        H5Tclose (dtype_id);
+    H5Dclose (dataset_id);
+    if (text == NULL)
     {
-        sprintf (errmsg, "Overflow of core_basename string");
+        sprintf (errmsg, "Unable to read the HDF-EOS structural metadata: %s",
+            dataset_name);
         error_handler (true, FUNC_NAME, errmsg);
         return (ERROR);
     }
 
-    cptr = strrchr (core_basename, '.');
-    if (cptr != NULL)
-        *cptr = '\0';
-
-    /* Make sure the basename is uppercase */
-    cptr = basename;
-    while (*cptr != '\0')
+    /* The index owns the text from here on */
+    if (espa_odl_parse (text, &granule->struct_meta) != SUCCESS)
     {
-        *cptr = toupper ((unsigned char) *cptr);
-        cptr++;
+        sprintf (errmsg, "Parsing the HDF-EOS structural metadata");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
     }
 
-    /* Set the data_provider, satellite, and instrument */
-    strcpy (gmeta->data_provider, "USGS/EROS LPDAAC");
-    strcpy (gmeta->instrument, "VIIRS");
-    strcpy (gmeta->satellite, "National Polar-Orbiting Partnership (NPP)");
+    return (SUCCESS);
+}
 
-    /* Determine the acquisition date for the global metadata */
-    if (get_acquisition_date (basename, gmeta) != SUCCESS)
-    {  /* error message already printed */
+
+/******************************************************************************
+MODULE:  open_viirs_granule
+
+PURPOSE: Opens the VIIRS HDF5 file and, in a single pass, reads its HDF-EOS
+structural metadata, the attributes of its root group, and the datatype,
+dimensions, and attributes of the surface reflectance bands of the 500m grid
+into the index of the granule.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error opening or indexing the granule
+SUCCESS         Successfully opened and indexed the granule
+
+NOTES:
+  1. The file and the 500m grid stay open for the conversion of the bands
+     until close_viirs_granule, which is also called here on an error.
+  2. Every metadata routine looks its values up in the index, so the file is
+     opened and its attribute tree walked only once per granule.
+******************************************************************************/
+int open_viirs_granule
+(
+    char *viirs_hdf_name,      /* I: name of VIIRS file to be opened */
+    Viirs_granule_t *granule   /* O: opened and indexed granule */
+)
+{
+    char FUNC_NAME[] = "open_viirs_granule";  /* function name */
+    char errmsg[STR_SIZE];     /* error message */
+    char dataset_name[STR_SIZE];  /* name of dataset in the 500m grid */
+    char *grid500 = NULL;      /* name of the 500m grid group */
+    int i;                     /* looping variable */
+    H5G_info_t grid500_info;   /* group information for the 500m grid */
+    Viirs_attr_iter_t iter;    /* root group whose attributes are indexed */
+
+    memset (granule, 0, sizeof (Viirs_granule_t));
+    granule->file_name = viirs_hdf_name;
+    granule->grid500_id = -1;
+
+    /* Open as HDF5 file for reading */
+    granule->file_id = H5Fopen (viirs_hdf_name, H5F_ACC_RDONLY, H5P_DEFAULT);
+    if (granule->file_id < 0)
+    {
+        sprintf (errmsg, "Unable to open %s for reading", viirs_hdf_name);
+        error_handler (true, FUNC_NAME, errmsg);
         return (ERROR);
     }
 
-    /* Determine the horizontal and vertical tile for the global metadata */
-    if (get_tile (basename, gmeta) != SUCCESS)
-    {  /* error message already printed */
+    /* Read the structural metadata of the grids */
+    if (read_viirs_struct_meta (granule) != SUCCESS)
+    {  /* Error messages already written */
+        close_viirs_granule (granule);
         return (ERROR);
     }
 
-    /* Open as HDF5 file for reading */
-    file_id = H5Fopen (viirs_hdf_name, H5F_ACC_RDONLY, H5P_DEFAULT);
-    if (file_id < 0)
+    /* Index the attributes of the global/root group */
+    iter.granule = granule;
+    iter.object = "/";
+    if (H5Aiterate_by_name (granule->file_id, "/", H5_INDEX_NAME,
+        H5_ITER_NATIVE, NULL, index_viirs_attr, &iter, H5P_DEFAULT) < 0)
     {
-        sprintf (errmsg, "Unable to open %s for reading", viirs_hdf_name);
+        sprintf (errmsg, "Unable to read the attributes of the root group");
         error_handler (true, FUNC_NAME, errmsg);
+        close_viirs_granule (granule);
         return (ERROR);
     }
 
     /* Confirm the 500m grid exists then open it. Otherwise flag an error if
        the grid is not found. */
     grid500 = "/HDFEOS/GRIDS/VNP_Grid_500m_2D/Data Fields";
-    if (H5Lexists (file_id, grid500, H5P_DEFAULT) > 0)
-    {
-        grid500_id = H5Gopen (file_id, grid500, H5P_DEFAULT);
-        if (grid500_id < 0)
-        {
-            sprintf (errmsg, "Unable to open 500m grid: %s", grid500);
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
-    }
+    if (H5Lexists (granule->file_id, grid500, H5P_DEFAULT) > 0)
+        granule->grid500_id = H5Gopen (granule->file_id, grid500,
+            H5P_DEFAULT);
     else
     {
         sprintf (errmsg, "Unable to find the 500m grid: %s", grid500);
         error_handler (true, FUNC_NAME, errmsg);
+        close_viirs_granule (granule);
+        return (ERROR);
+    }
+    if (granule->grid500_id < 0)
+    {
+        sprintf (errmsg, "Unable to open 500m grid: %s", grid500);
+        error_handler (true, FUNC_NAME, errmsg);
+        close_viirs_granule (granule);
         return (ERROR);
     }
 
     /* We will only parse the three surface reflectance image data fields from
-       the 500m grid */
-    /* Get information about the group, then loop through the datasets to
-       pull out info on the 500m image bands */
-    if (H5Gget_info(grid500_id, &grid500_info) >= 0)
-    {
-        printf ("%d datasets in the 500m grid group\n",
-            (int) grid500_info.nlinks);
-        nviirs_bands = 0;
-        for (i=0; i < (int)grid500_info.nlinks; i++)
-        {
-            /* Get the name of the dataset */
-    	    H5Lget_name_by_idx(grid500_id, ".", H5_INDEX_NAME, H5_ITER_NATIVE,
-                (hsize_t)i, dataset_name, STR_SIZE, H5P_DEFAULT);
-    	    printf("Object's name is %s\n", dataset_name);
-
-            /* If this dataset is one of the surface reflectance datasets, then
-               keep the dataset name as one to be processed */
-            if (strstr (dataset_name, "SurfReflect_I"))
-            {
-                /* Store the band/SDS information */
-                count = snprintf (viirs_bands[nviirs_bands],
-                    sizeof (viirs_bands[nviirs_bands]), "%s", dataset_name);
-                if (count < 0 || count >= sizeof (viirs_bands[nviirs_bands]))
-                {
-                    sprintf (errmsg, "Overflow of viirs_bands[] string");
-                    error_handler (true, FUNC_NAME, errmsg);
-                    return (ERROR);
-                }
+       the 500m grid.  Get information about the group, then loop through the
+       datasets to pull out info on the 500m image bands. */
+    if (H5Gget_info (granule->grid500_id, &grid500_info) < 0)
+    {
+        sprintf (errmsg, "Unable to retrieve information about the 500m grid: "
+            "%s", grid500);
+        error_handler (true, FUNC_NAME, errmsg);
+        close_viirs_granule (granule);
+        return (ERROR);
+    }
+    printf ("%d datasets in the 500m grid group\n", (int) grid500_info.nlinks);
+    for (i = 0; i < (int) grid500_info.nlinks; i++)
+    {
+        /* Get the name of the dataset */
+        if (H5Lget_name_by_idx (granule->grid500_id, ".", H5_INDEX_NAME,
+            H5_ITER_NATIVE, (hsize_t) i, dataset_name, STR_SIZE,
+            H5P_DEFAULT) < 0)
+        {
+            sprintf (errmsg, "Unable to get the name of dataset %d of the "
+                "500m grid", i);
+            error_handler (true, FUNC_NAME, errmsg);
+            close_viirs_granule (granule);
+            return (ERROR);
+        }
+        printf ("Object's name is %s\n", dataset_name);
+
+        /* If this dataset is one of the surface reflectance datasets, then
+           keep the dataset as one to be processed */
+        if (strstr (dataset_name, "SurfReflect_I") &&
+            index_viirs_band (granule, dataset_name) != SUCCESS)
+        {  /* Error messages already written */
+            close_viirs_granule (granule);
+            return (ERROR);
+        }
+    }
 
-                /* Open the dataset */
-                dataset_id = H5Dopen (grid500_id, dataset_name, H5F_ACC_RDONLY);
-                if (dataset_id < 0)
-                {
-                    sprintf (errmsg, "Unable to open 500m dataset: %s",
-                        dataset_name);
-                    error_handler (true, FUNC_NAME, errmsg);
-                    return (ERROR);
-                }
+    /* Index the attributes */
+    if (granule->nattrs > 1)
+        qsort (granule->attrs, granule->nattrs, sizeof (Viirs_attr_t),
+            compare_viirs_attrs);
 
-                /* Get the datatype */
-                dtype_id = H5Dget_type (dataset_id);
-                if (dtype_id < 0)
-                {
-                    sprintf (errmsg, "Unable to get the datatype");
-                    error_handler (true, FUNC_NAME, errmsg);
-                    return (ERROR);
-                }
+    return (SUCCESS);
+}
 
-                /* Get the data type class and determine the properties of the
-                   datatype */
-                t_class = H5Tget_class (dtype_id);
-                if (t_class < 0)
-                {
-                    sprintf (errmsg, "Invalid datatype");
-                    error_handler (true, FUNC_NAME, errmsg);
-                    return (ERROR);
-                }
 
-                if (t_class == H5T_INTEGER)
-                {
-                    /* Signed or unsigned (unsigned is 0, signed is 1) */
-                    t_sign = H5Tget_sign (dtype_id);
-                    if (t_sign < 0)
-                    {
-                        sprintf (errmsg, "Invalid datatype sign");
-                        error_handler (true, FUNC_NAME, errmsg);
-                        return (ERROR);
-                    }
-
-                    /* How many bytes */
-                    t_size = H5Tget_size (dtype_id);
-                    if (t_size < 0)
-                    {
-                        sprintf (errmsg, "Invalid datatype size");
-                        error_handler (true, FUNC_NAME, errmsg);
-                        return (ERROR);
-                    }
-
-                    /* Data is expected to be signed 16-bit */
-                    if (t_sign != 1)
-                    {
-                        sprintf (errmsg, "Data is expected to be signed");
-                        error_handler (true, FUNC_NAME, errmsg);
-                        return (ERROR);
-                    }
-
-                    if (t_size != 2)
-                    {
-                        sprintf (errmsg, "Data is expected to be 16-bit");
-                        error_handler (true, FUNC_NAME, errmsg);
-                        return (ERROR);
-                    }
-                }
-                else
-                {
-                    sprintf (errmsg, "Unexpected datatype for the current "
-                        "band: %s.  Integer expected.", dataset_name);
-                    error_handler (true, FUNC_NAME, errmsg);
-                    return (ERROR);
-                }
-                data_type[nviirs_bands] = ESPA_INT16;
+/******************************************************************************
+MODULE:  close_viirs_granule
 
-                /* Close the datatype */
-                status = H5Tclose (dtype_id);
-                if (status < 0)
-                {
-                    sprintf (errmsg, "Terminating access to the datatype");
-                    error_handler (true, FUNC_NAME, errmsg);
-                    return (ERROR);
-                }
+PURPOSE: Closes the VIIRS HDF5 file and frees the index of the granule.
 
-                /* Get the data space */
-                dspace_id = H5Dget_space (dataset_id);
-                if (dspace_id < 0)
-                {
-                    sprintf (errmsg, "Unable to get the data space");
-                    error_handler (true, FUNC_NAME, errmsg);
-                    return (ERROR);
-                }
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error closing the HDF5 file
+SUCCESS         Successfully closed the granule
 
-                /* Get the number of dimensions and verify it's 2-D */
-                ndims = H5Sget_simple_extent_ndims (dspace_id);
-                if (ndims < 0)
-                {
-                    sprintf (errmsg, "Unable to determine the number of "
-                        "dimensions of this dataset, but two dimensions are "
-                        "expected");
-                    error_handler (true, FUNC_NAME, errmsg);
-                    return (ERROR);
-                }
-                else if (ndims != MAX_VIIRS_DIMS)
-                {
-                    sprintf (errmsg, "Dataset is expected to be a 2-D dataset, "
-                        "however is has %d dimensions", ndims);
-                    error_handler (true, FUNC_NAME, errmsg);
-                    return (ERROR);
-                }
-                printf ("    ndims is %d (2D expected)\n", ndims);
+NOTES:
+******************************************************************************/
+int close_viirs_granule
+(
+    Viirs_granule_t *granule   /* I/O: granule to be closed */
+)
+{
+    char FUNC_NAME[] = "close_viirs_granule";  /* function name */
+    char errmsg[STR_SIZE];     /* error message */
+    int i;                     /* looping variable */
+    int retval = SUCCESS;      /* return status */
+
+    for (i = 0; i < granule->nattrs; i++)
+        free (granule->attrs[i].string);
+    free (granule->attrs);
+    granule->attrs = NULL;
+    granule->nattrs = 0;
+    granule->max_attrs = 0;
+    espa_odl_free (&granule->struct_meta);
+
+    if (granule->grid500_id >= 0)
+        H5Gclose (granule->grid500_id);
+    granule->grid500_id = -1;
+
+    if (granule->file_id >= 0 && H5Fclose (granule->file_id) < 0)
+    {
+        sprintf (errmsg, "Terminating access to HDF5 file: %s",
+            granule->file_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        retval = ERROR;
+    }
+    granule->file_id = -1;
 
-                /* Determine the number of dimensions and the size of each
-                   dimension */
-                status = H5Sget_simple_extent_dims (dspace_id, dims, NULL);
-                if (status < 0)
-                {
-                    sprintf (errmsg, "Unable to determine the dimensions of "
-                        "this dataset, but two dimensions are expected");
-                    error_handler (true, FUNC_NAME, errmsg);
-                    return (ERROR);
-                }
-                printf ("    dataset dimensions are %d x %d\n",
-                    (int)dims[0], (int)dims[1]);
+    return (retval);
+}
 
-                /* Save the dimensions */
-                grid_dims[nviirs_bands][0] = (int) dims[0];
-                grid_dims[nviirs_bands][1] = (int) dims[1];
 
-                /* Close the data space */
-                status = H5Sclose (dspace_id);
-                if (status < 0)
-                {
-                    sprintf (errmsg, "Terminating access to the dataspace");
-                    error_handler (true, FUNC_NAME, errmsg);
-                    return (ERROR);
-                }
+/******************************************************************************
+MODULE:  find_viirs_attr
 
-                /* Read the long_name attribute as a character string */
-                if (read_attribute ("long_name", dataset_id,
-                    &longname[nviirs_bands]) != SUCCESS)
-                {  /* Error message already printed */
-                    return (ERROR);
-                }
-                printf ("    long_name: %s\n", longname[nviirs_bands]);
-
-                /* Some of the attributes in the VIIRS dataset don't describe
-                   the values as correctly as needed for the XML metadata.  The
-                   attribute information is going to be hardcoded from the
-                   LP DAAC table specified in
-                   https://lpdaac.usgs.gov/dataset_discovery/viirs/
-                   viirs_products_table/vnp09ga_v001 */
-                scalevalue[nviirs_bands] = 0.0001;
-                offsetvalue[nviirs_bands] = 0.0;
-                minvalue[nviirs_bands] = -100;
-                maxvalue[nviirs_bands] = 16000;
-                fillvalue[nviirs_bands] = -28672;
-                strcpy (units[nviirs_bands], "reflectance");
-                strcpy (qa_desc[nviirs_bands], "ELLIPSOID_INT16_FILL = -994, "
-                    "VDNE_INT16_FILL = -993, SOUB_INT16_FILL = -992, "
-                    "OUT_OF_RANGE_FILL = -100");
-
-                /* Close the dataset */
-                status = H5Dclose (dataset_id);
-                if (status < 0)
-                {
-                    sprintf (errmsg, "Terminating access to 500m dataset: %s",
-                        dataset_name);
-                    error_handler (true, FUNC_NAME, errmsg);
-                    return (ERROR);
-                }
+PURPOSE: Looks up an attribute of the granule in its index.
+
+RETURN VALUE:
+Type = const Viirs_attr_t *
+Value           Description
+-----           -----------
+NULL            The object doesn't have the attribute
+non-NULL        Attribute found
+
+NOTES:
+******************************************************************************/
+static const Viirs_attr_t *find_viirs_attr
+(
+    const Viirs_granule_t *granule,  /* I: indexed granule */
+    const char *object,        /* I: name of the dataset; "/" for the root
+                                     group */
+    const char *name           /* I: name of the attribute */
+)
+{
+    int low = 0;               /* first attribute which may match */
+    int high = granule->nattrs;  /* one past the last which may match */
+    int mid;                   /* attribute being compared */
+    int cmp;                   /* comparison with the attribute */
 
-                /* Increment the band/SDS count */
-                nviirs_bands++;
-            }  /* if this is a 500m surface reflectance band */
-    	}  /* for i in number of bands in the 500m grid */
+    while (low < high)
+    {
+        mid = (low + high) / 2;
+        cmp = strcmp (granule->attrs[mid].object, object);
+        if (cmp == 0)
+            cmp = strcmp (granule->attrs[mid].name, name);
+        if (cmp == 0)
+            return &granule->attrs[mid];
+        if (cmp < 0)
+            low = mid + 1;
+        else
+            high = mid;
     }
-    else
+
+    return NULL;
+}
+
+
+/******************************************************************************
+MODULE:  read_attribute_string
+
+PURPOSE: Copies the value of a string attribute of the granule from its
+index.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           The attribute isn't a string attribute of the object, or
+                doesn't fit
+SUCCESS         Successfully copied the attribute
+
+NOTES:
+******************************************************************************/
+static int read_attribute_string
+(
+    const Viirs_granule_t *granule,  /* I: indexed granule */
+    const char *object,        /* I: name of the dataset; "/" for the root
+                                     group */
+    const char *attr_name,     /* I: name of the attribute to read */
+    char *attr_val,            /* O: value of the attribute */
+    size_t attr_size           /* I: number of chars allocated for attr_val */
+)
+{
+    char FUNC_NAME[] = "read_attribute_string";  /* function name */
+    char errmsg[STR_SIZE];     /* error message */
+    int count;                 /* number of chars copied in snprintf */
+    const Viirs_attr_t *attr = NULL;  /* attribute in the index */
+
+    attr = find_viirs_attr (granule, object, attr_name);
+    if (attr == NULL || attr->string == NULL)
     {
-        sprintf (errmsg, "Unable to retrieve information about the 500m grid: "
-            "%s", grid500);
+        sprintf (errmsg, "Unable to find string attribute: %s", attr_name);
         error_handler (true, FUNC_NAME, errmsg);
         return (ERROR);
     }
 
-    /* Close the 500m grid */
-    status = H5Gclose (grid500_id);
-    if (status < 0)
+    count = snprintf (attr_val, attr_size, "%s", attr->string);
+    if (count < 0 || count >= attr_size)
     {
-        sprintf (errmsg, "Terminating access to 500m grid: %s", grid500);
+        sprintf (errmsg, "Overflow of the %s string", attr_name);
         error_handler (true, FUNC_NAME, errmsg);
         return (ERROR);
     }
 
-    /* Open the global/root grid */
-    root_id = H5Gopen (file_id, "/", H5P_DEFAULT);
-    if (root_id < 0)
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  read_attribute_value
+
+PURPOSE: Gets the value of a numeric attribute of the granule from its index.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           The attribute isn't a numeric attribute of the object
+SUCCESS         Successfully read the attribute
+
+NOTES:
+******************************************************************************/
+static int read_attribute_value
+(
+    const Viirs_granule_t *granule,  /* I: indexed granule */
+    const char *object,        /* I: name of the dataset; "/" for the root
+                                     group */
+    const char *attr_name,     /* I: name of the attribute to read */
+    double *attr_val           /* O: value of the attribute */
+)
+{
+    char FUNC_NAME[] = "read_attribute_value";  /* function name */
+    char errmsg[STR_SIZE];     /* error message */
+    const Viirs_attr_t *attr = NULL;  /* attribute in the index */
+
+    attr = find_viirs_attr (granule, object, attr_name);
+    if (attr == NULL || attr->string != NULL)
     {
-        sprintf (errmsg, "Unable to open root grid");
+        sprintf (errmsg, "Unable to find numeric attribute: %s", attr_name);
         error_handler (true, FUNC_NAME, errmsg);
         return (ERROR);
     }
 
-    /* Read the production date/time attribute as a character string */
-    if (read_attribute ("ProductionTime", root_id, prod_date_time) != SUCCESS)
-    {  /* Error message already printed */
-        return (ERROR);
-    }
+    *attr_val = attr->value;
+    return (SUCCESS);
+}
 
-    /* Fix the production date/time to be in Zulu (going from
-       2016-11-20 00:35:44.000 to 2016-11-20T00:35:44.000Z) */
-    prod_date_time[10] = 'T';
-    strcat (prod_date_time, "Z");
 
-    /* Read the PGE version attribute as a character string */
-    if (read_attribute ("PGEVersion", root_id, pge_version) != SUCCESS)
-    {  /* Error message already printed */
-        return (ERROR);
+/******************************************************************************
+MODULE:  parse_odl_list
+
+PURPOSE: Parses the numbers of a list in parentheses from the structural
+metadata (ex. UpperLeftPointMtrs=(-10007554.677000,4447802.078667)).
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+n               Number of values parsed; 0 if there is no list
+
+NOTES:
+******************************************************************************/
+static int parse_odl_list
+(
+    const char *list,          /* I: list with its parentheses; NULL if the
+                                     statement isn't in the metadata */
+    double *values,            /* O: values of the list */
+    int max_values             /* I: number of values allocated */
+)
+{
+    const char *ptr = NULL;    /* current position in the list */
+    char *end = NULL;          /* end of the current value */
+    int count = 0;             /* number of values parsed */
+
+    if (list == NULL || *list != '(')
+        return 0;
+
+    ptr = list + 1;
+    while (count < max_values)
+    {
+        values[count] = strtod (ptr, &end);
+        if (end == ptr)
+            break;
+        count++;
+        ptr = end;
+        while (isspace ((unsigned char) *ptr))
+            ptr++;
+        if (*ptr != ',')
+            break;
+        ptr++;
     }
 
-    /* Read the bounding coords attributes as a double value */
-    if (read_attribute ("WestBoundingCoord", root_id, 
-        &gmeta->bounding_coords[0]) != SUCCESS)
-    {  /* Error message already printed */
+    return count;
+}
+
+
+/******************************************************************************
+MODULE:  read_viirs_500m_geo_meta
+
+PURPOSE: Read the geolocation metadata (HDF-EOS) for the surface reflectance
+imagery bands from VIIRS 500m grid and populate the ESPA internal metadata
+structure.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error reading the VIIRS HDF-EOS metadata
+SUCCESS         Successfully populated the ESPA metadata structure
+
+NOTES:
+  1. The projection and corners come from the GROUP of the 500m grid in the
+     structural metadata, as the HDF-EOS5 GDprojinfo, GDgridinfo, and
+     GDorigininfo would report them, without opening the file again through
+     the HDF-EOS5 library.
+******************************************************************************/
+int read_viirs_500m_geo_meta
+(
+    const Viirs_granule_t *granule,  /* I: indexed VIIRS granule */
+    Espa_internal_meta_t *metadata   /* I/O: input metadata structure to be
+                                           populated from the VIIRS file */
+)
+{
+    char FUNC_NAME[] = "read_viirs_500m_geo_meta";  /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    char *grid500 = NULL;     /* name of the 500m HDF-EOS grid */
+    const char *grid = NULL;  /* GROUP of the 500m grid in the structural
+                                 metadata */
+    const char *value = NULL; /* value of a structural metadata statement */
+    int i;                    /* looping variable */
+    double projparm[15];      /* projection parameters */
+    double central_meridian;  /* central meridian for the sinusoidal projection
+                                 (in DMS) */
+    const Espa_odl_t *odl = &granule->struct_meta;  /* structural metadata */
+    Espa_global_meta_t *gmeta = &metadata->global;  /* pointer to the global
+                                                       metadata structure */
+
+    /* Find the 500m grid */
+    grid500 = "VNP_Grid_500m_2D";
+    for (i = 0; i < odl->nentries; i++)
+    {
+        if (!strcmp (odl->entries[i].name, "GridName") &&
+            !strcmp (odl->entries[i].value, grid500))
+        {
+            grid = odl->entries[i].object;
+            break;
+        }
+    }
+    if (grid == NULL)
+    {
+        sprintf (errmsg, "Unable to attach to grid: %s", grid500);
+        error_handler (true, FUNC_NAME, errmsg);
         return (ERROR);
     }
 
-    if (read_attribute ("EastBoundingCoord", root_id,
-        &gmeta->bounding_coords[1]) != SUCCESS)
-    {  /* Error message already printed */
+    /* Store the projection info */
+    value = espa_odl_find (odl, grid, "Projection");
+    if (value == NULL || strcmp (value, "HE5_GCTP_SNSOID"))
+    {
+        sprintf (errmsg, "Invalid projection type.  VIIRS data is "
+            "expected to be in the Sinusoidal projection.");
+        error_handler (true, FUNC_NAME, errmsg);
         return (ERROR);
     }
+    gmeta->proj_info.proj_type = GCTP_SIN_PROJ;
 
-    if (read_attribute ("NorthBoundingCoord", root_id,
-        &gmeta->bounding_coords[2]) != SUCCESS)
-    {  /* Error message already printed */
+    value = espa_odl_find (odl, grid, "SphereCode");
+    if (value == NULL || atoi (value) != ESPA_NODATUM)
+    {
+        sprintf (errmsg, "Invalid sphere code.  VIIRS data is expected "
+            "to be in the Sinusoidal projection and have a sphere code "
+            "of %d.", ESPA_NODATUM);
+        error_handler (true, FUNC_NAME, errmsg);
         return (ERROR);
     }
+    gmeta->proj_info.datum_type = ESPA_NODATUM;
+    strcpy (gmeta->proj_info.units, "meters");
 
-    if (read_attribute ("SouthBoundingCoord", root_id,
-        &gmeta->bounding_coords[3]) != SUCCESS)
-    {  /* Error message already printed */
+    /* Store the input projection parameters for Sinusoidal */
+    if (parse_odl_list (espa_odl_find (odl, grid, "ProjParams"), projparm,
+        15) < 8)
+    {
+        sprintf (errmsg, "Reading grid projection information from HDFEOS "
+            "header");
+        error_handler (true, FUNC_NAME, errmsg);
         return (ERROR);
     }
+    gmeta->proj_info.sphere_radius = projparm[0];
+    central_meridian = projparm[4];
+    gmeta->proj_info.false_easting = projparm[6];
+    gmeta->proj_info.false_northing = projparm[7];
+
+    /* According to HDF-EOS documentation angular projection parameters
+       in HDF-EOS structural metadata are in DMS.  Convert the central
+       meridian from DMS to decimal degrees. */
+    dmsdeg (central_meridian, &gmeta->proj_info.central_meridian);
 
-    /* Close the root grid */
-    status = H5Gclose (root_id);
-    if (status < 0)
+    /* Get the corner info. Projection coords are in meters since this should
+       be the Sinusoidal projection. */
+    if (parse_odl_list (espa_odl_find (odl, grid, "UpperLeftPointMtrs"),
+        gmeta->proj_info.ul_corner, 2) != 2 ||
+        parse_odl_list (espa_odl_find (odl, grid, "LowerRightMtrs"),
+        gmeta->proj_info.lr_corner, 2) != 2)
     {
-        sprintf (errmsg, "Terminating access to root grid");
+        sprintf (errmsg, "Reading dimension and corner information "
+            "from HDF header");
         error_handler (true, FUNC_NAME, errmsg);
         return (ERROR);
     }
 
-    /* Close the HDF5 file */
-    status = H5Fclose (file_id);
-    if (status < 0)
+    /* Get the coordinate system origin.  If the grid origin isn't
+       specified then default to the UL which is standard for HDF. */
+    value = espa_odl_find (odl, grid, "GridOrigin");
+    if (value == NULL || !strcmp (value, "HE5_HDFE_GD_UL"))
+        strcpy (gmeta->proj_info.grid_origin, "UL");
+    else
+        strcpy (gmeta->proj_info.grid_origin, "CENTER");
+
+    /* Successful read */
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  read_viirs_500m_grid_meta
+
+PURPOSE: Read the metadata for the surface reflectance imagery bands from the
+VIIRS 500m grid and populate the ESPA internal metadata structure for each of
+the bands.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error reading the VIIRS metadata
+SUCCESS         Successfully populated the ESPA metadata structure
+
+NOTES:
+  1. The bands and attributes come from the index built by
+     open_viirs_granule.
+******************************************************************************/
+int read_viirs_500m_grid_meta
+(
+    const Viirs_granule_t *granule,  /* I: indexed VIIRS granule */
+    Espa_internal_meta_t *metadata   /* I/O: input metadata structure to be
+                                           populated from the VIIRS file */
+)
+{
+    char FUNC_NAME[] = "read_viirs_500m_grid_meta";  /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    char basename[STR_SIZE];  /* filename without path (uppercase) */
+    char core_basename[STR_SIZE]; /* filename without path and extension */
+    char prod_date_time[STR_SIZE];  /* production date/time */
+    char pge_version[STR_SIZE];     /* PGE version */
+    char longname[STR_SIZE];  /* long_name attribute of the current band */
+    char *cptr = NULL;        /* character pointer for strings */
+    int i;                    /* looping variables */
+    int count;                /* number of chars copied in snprintf */
+    char *viirs_hdf_name = granule->file_name;  /* name of the VIIRS file */
+    Espa_global_meta_t *gmeta = &metadata->global;  /* pointer to the global
+                                                       metadata structure */
+    Espa_band_meta_t *bmeta=NULL; /* pointer to the array of bands metadata */
+
+    /* Get the basename of the input HDF5 file */
+    cptr = strrchr (viirs_hdf_name, '/');
+    if (cptr != NULL)
+    {
+        /* Copy the basename from the cptr, after moving off of the '/' */
+        cptr++;
+        count = snprintf (basename, sizeof (basename), "%s", cptr);
+        if (count < 0 || count >= sizeof (basename))
+        {
+            sprintf (errmsg, "Overflow of basename string");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+    }
+    else
+    {
+        /* Copy the filename itself as the basename since it doesn't have a
+           path in the filename */
+        count = snprintf (basename, sizeof (basename), "%s", viirs_hdf_name);
+        if (count < 0 || count >= sizeof (basename))
+        {
+            sprintf (errmsg, "Overflow of basename string");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+    }
+
+    /* Strip the extension off the basename */
+    count = snprintf (core_basename, sizeof (core_basename), "%s", basename);
+    if (count < 0 || count >= sizeof (core_basename))
+    {
+        sprintf (errmsg, "Overflow of core_basename string");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    cptr = strrchr (core_basename, '.');
+    if (cptr != NULL)
+        *cptr = '\0';
+
+    /* Make sure the basename is uppercase */
+    cptr = basename;
+    while (*cptr != '\0')
+    {
+        *cptr = toupper ((unsigned char) *cptr);
+        cptr++;
+    }
+
+    /* Set the data_provider, satellite, and instrument */
+    strcpy (gmeta->data_provider, "USGS/EROS LPDAAC");
+    strcpy (gmeta->instrument, "VIIRS");
+    strcpy (gmeta->satellite, "National Polar-Orbiting Partnership (NPP)");
+
+    /* Determine the acquisition date for the global metadata */
+    if (get_acquisition_date (basename, gmeta) != SUCCESS)
+    {  /* error message already printed */
+        return (ERROR);
+    }
+
+    /* Determine the horizontal and vertical tile for the global metadata */
+    if (get_tile (basename, gmeta) != SUCCESS)
+    {  /* error message already printed */
+        return (ERROR);
+    }
+
+    /* Read the production date/time attribute as a character string, leaving
+       room for the Zulu suffix */
+    if (read_attribute_string (granule, "/", "ProductionTime",
+        prod_date_time, sizeof (prod_date_time) - 1) != SUCCESS)
+    {  /* Error message already printed */
+        return (ERROR);
+    }
+
+    /* Fix the production date/time to be in Zulu (going from
+       2016-11-20 00:35:44.000 to 2016-11-20T00:35:44.000Z) */
+    if (strlen (prod_date_time) > 10)
+        prod_date_time[10] = 'T';
+    strcat (prod_date_time, "Z");
+
+    /* Read the PGE version attribute as a character string */
+    if (read_attribute_string (granule, "/", "PGEVersion", pge_version,
+        sizeof (pge_version)) != SUCCESS)
+    {  /* Error message already printed */
+        return (ERROR);
+    }
+
+    /* Read the bounding coords attributes as a double value */
+    if (read_attribute_value (granule, "/", "WestBoundingCoord",
+        &gmeta->bounding_coords[0]) != SUCCESS ||
+        read_attribute_value (granule, "/", "EastBoundingCoord",
+        &gmeta->bounding_coords[1]) != SUCCESS ||
+        read_attribute_value (granule, "/", "NorthBoundingCoord",
+        &gmeta->bounding_coords[2]) != SUCCESS ||
+        read_attribute_value (granule, "/", "SouthBoundingCoord",
+        &gmeta->bounding_coords[3]) != SUCCESS)
+    {  /* Error message already printed */
+        return (ERROR);
+    }
+
+    /* Allocate bands for the XML structure */
+    metadata->nbands = granule->nbands;
+    if (allocate_band_metadata (metadata, metadata->nbands) != SUCCESS)
+    {   /* Error messages already printed */
+        return (ERROR);
+    }
+    bmeta = metadata->band;
+
+    /* Loop through the bands and fill in the band-related metadata */
+    for (i = 0; i < granule->nbands; i++)
+    {
+        /* Fill in the band information already obtained.  Use 'sr_refl'
+           for the product type.  Copy the first 7 characters of the
+           basename as the short name.  Use 'image' for the category. */
+        strcpy (bmeta[i].product, "sr_refl");
+        strncpy (bmeta[i].short_name, basename, 7);
+        bmeta[i].short_name[7] = '\0';
+        strcpy (bmeta[i].category, "image");
+        bmeta[i].nsamps = granule->band_dims[i][0];
+        bmeta[i].nlines = granule->band_dims[i][1];
+
+        /* Use the SDS name as the band name as well as the file name */
+        count = snprintf (bmeta[i].name, sizeof (bmeta[i].name), "%s",
+            granule->band_name[i]);
+        if (count < 0 || count >= sizeof (bmeta[i].name))
+        {
+            sprintf (errmsg, "Overflow of bmeta[i].name string");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+
+        /* Set up the filename, but replace any blank spaces in the
+           filename (due to the SDS names) with underscores */
+        count = snprintf (bmeta[i].file_name, sizeof (bmeta[i].file_name),
+            "%s.%s.img", core_basename, granule->band_name[i]);
+        if (count < 0 || count >= sizeof (bmeta[i].file_name))
+        {
+            sprintf (errmsg, "Overflow of bmeta[].file_name string");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+        cleanup_file_name (bmeta[i].file_name);
+
+        /* The bands were checked to be signed 16-bit integers */
+        bmeta[i].data_type = ESPA_INT16;
+
+        /* Compute the pixel size */
+        bmeta[i].pixel_size[1] = (gmeta->proj_info.ul_corner[1] -
+            gmeta->proj_info.lr_corner[1]) / bmeta[i].nlines;
+        bmeta[i].pixel_size[0] = (gmeta->proj_info.lr_corner[0] -
+            gmeta->proj_info.ul_corner[0]) / bmeta[i].nsamps;
+        strcpy (bmeta[i].pixel_units, "meters");
+
+        /* Some of the attributes in the VIIRS dataset don't describe the
+           values as correctly as needed for the XML metadata.  The attribute
+           information is going to be hardcoded from the LP DAAC table
+           specified in https://lpdaac.usgs.gov/dataset_discovery/viirs/
+           viirs_products_table/vnp09ga_v001 */
+        bmeta[i].fill_value = -28672;
+        bmeta[i].scale_factor = 0.0001;
+        bmeta[i].add_offset = 0.0;
+        bmeta[i].valid_range[0] = -100;
+        bmeta[i].valid_range[1] = 16000;
+        strcpy (bmeta[i].data_units, "reflectance");
+        strcpy (bmeta[i].qa_desc, "ELLIPSOID_INT16_FILL = -994, "
+            "VDNE_INT16_FILL = -993, SOUB_INT16_FILL = -992, "
+            "OUT_OF_RANGE_FILL = -100");
+
+        /* Set the resample method to nearest neighbor, since it's not
+           available in the VIIRS file but it's a known entity. */
+        bmeta[i].resample_method = ESPA_NN;
+
+        /* Assign the long_name from the attribute of the band */
+        if (read_attribute_string (granule, granule->band_name[i],
+            "long_name", longname, sizeof (longname)) != SUCCESS)
+        {  /* Error message already printed */
+            return (ERROR);
+        }
+        printf ("    %s long_name: %s\n", granule->band_name[i], longname);
+
+        count = snprintf (bmeta[i].long_name, sizeof (bmeta[i].long_name), "%s",
+            longname);
+        if (count < 0 || count >= sizeof (bmeta[i].long_name))
+        {
+            sprintf (errmsg, "Overflow of bmeta[].long_name string");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+
+        /* Add the production date/time and PGE version from the core
+           metadata */
+        count = snprintf (bmeta[i].production_date,
+            sizeof (bmeta[i].production_date), "%s", prod_date_time);
+        if (count < 0 || count >= sizeof (bmeta[i].production_date))
+        {
+            sprintf (errmsg, "Overflow of bmeta[].production_date string");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+
+        count = snprintf (bmeta[i].app_version, sizeof (bmeta[i].app_version),
+            "PGE Version %s", pge_version);
+        if (count < 0 || count >= sizeof (bmeta[i].app_version))
+        {
+            sprintf (errmsg, "Overflow of bmeta[].app_version string");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+    }  /* end for i (loop through the bands) */
+
+    /* Set the orientation angle to 0.0 */
+    gmeta->orientation_angle = 0.0;
+
+    /* Get the geographic coords for the UL and LR corners (using the first
+       band), which are the same for every granule of the tile */
+    if (!get_corner_coords (metadata, gmeta->ul_corner, gmeta->lr_corner))
+    {
+        sprintf (errmsg, "Computing the UL and LR corners");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Successful read */
+    return (SUCCESS);
+}
+
+
+/* Band dataset being read by convert_hdf_to_img */
+typedef struct
+{
+    hid_t dataset_id;          /* dataset of the band */
+    bool direct;               /* are the chunks read compressed and inflated
+                                  here rather than by HDF5? */
+    bool shuffle;              /* were the chunks shuffled before deflating? */
+    int chunk_lines;           /* number of lines in a chunk */
+    int chunk_samps;           /* number of samples in a chunk */
+    int ncols;                 /* number of chunks across the band */
+    int max_chunks;            /* number of chunks in a full stripe */
+    int nchunks;               /* number of chunks of the current stripe to
+                                  be inflated; 0 if HDF5 read the stripe */
+    unsigned char **comp_buf;  /* compressed chunks of the current stripe */
+    size_t *comp_size;         /* number of bytes allocated for each chunk */
+    size_t *comp_len;          /* number of bytes in each compressed chunk */
+} Viirs_band_t;
+
+/* Stripe of lines of all the bands, waiting to be written to the raw binary
+   files */
+typedef struct
+{
+    int line0;                 /* 0-based starting line of the stripe */
+    int nlines;                /* number of lines in the stripe */
+    int16_t *buf[MAX_VIIRS_BANDS]; /* lines of each band */
+} Viirs_stripe_t;
+
+/* Queue of the stripes between the HDF5 reader and the raw binary writer */
+typedef struct
+{
+    Espa_internal_meta_t *xml_metadata; /* XML metadata structure */
+    Espa_browse_t *browse;     /* browse the bands are added to; NULL if
+                                  none */
+    Viirs_stripe_t stripe[VIIRS_QUEUE_STRIPES]; /* ring of stripes */
+    int head;                  /* next stripe to be written */
+    int count;                 /* number of stripes queued */
+    bool done;                 /* has the reader queued all the stripes? */
+    bool failed;               /* has the writer failed? */
+    pthread_mutex_t mutex;     /* protects the queue */
+    pthread_cond_t cond;       /* signals changes in the queue */
+} Viirs_queue_t;
+
+
+/******************************************************************************
+MODULE:  write_viirs_envi_hdr
+
+PURPOSE: Writes the ENVI header file for a band converted from a VIIRS
+dataset.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the ENVI header
+SUCCESS         Successfully wrote the ENVI header
+
+NOTES:
+******************************************************************************/
+static int write_viirs_envi_hdr
+(
+    Espa_band_meta_t *bmeta,     /* I: metadata of the band */
+    Espa_global_meta_t *gmeta    /* I: global metadata */
+)
+{
+    char FUNC_NAME[] = "write_viirs_envi_hdr";  /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    char *cptr = NULL;        /* pointer to the file extension */
+    char envi_file[STR_SIZE]; /* name of the output ENVI header file */
+    int count;                /* number of chars copied in snprintf */
+    Envi_header_t envi_hdr;   /* output ENVI header information */
+
+    /* Create the ENVI header file this band */
+    if (create_envi_struct (bmeta, gmeta, &envi_hdr) != SUCCESS)
+    {
+        sprintf (errmsg, "Creating the ENVI header structure for this "
+            "file: %s", bmeta->file_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Write the ENVI header */
+    count = snprintf (envi_file, sizeof (envi_file), "%s", bmeta->file_name);
+    if (count < 0 || count >= sizeof (envi_file))
+    {
+        sprintf (errmsg, "Overflow of envi_file string");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    cptr = strrchr (envi_file, '.');
+    strcpy (cptr, ".hdr");
+
+    if (write_envi_hdr (envi_file, &envi_hdr) != SUCCESS)
+    {
+        sprintf (errmsg, "Writing the ENVI header file: %s.", envi_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  open_viirs_band
+
+PURPOSE: Opens the dataset of a band and determines whether its chunks can be
+read compressed and inflated in parallel.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error opening the dataset
+SUCCESS         Successfully opened the dataset
+
+NOTES:
+  1. The chunks are inflated here if the dataset is chunked, holds native
+     16-bit integers, and is filtered with deflate, optionally preceded by
+     shuffle (the filters of the VIIRS surface reflectance bands).  Any other
+     dataset is read through HDF5.
+******************************************************************************/
+static int open_viirs_band
+(
+    hid_t grid_id,             /* I: group of the band datasets */
+    Espa_band_meta_t *bmeta,   /* I: metadata of the band */
+    Viirs_band_t *band         /* O: dataset of the band */
+)
+{
+    char FUNC_NAME[] = "open_viirs_band";  /* function name */
+    char errmsg[STR_SIZE];     /* error message */
+    int i;                     /* looping variable for the filters */
+    int nfilters;              /* number of filters of the dataset */
+    bool deflate = false;      /* is the dataset deflated? */
+    unsigned int flags;        /* flags of the filter */
+    unsigned int cd_values[8]; /* parameters of the filter */
+    size_t cd_nelmts;          /* number of parameters of the filter */
+    hsize_t chunk_dims[MAX_VIIRS_DIMS]; /* dimensions of a chunk */
+    hid_t dcpl_id;             /* creation properties of the dataset */
+    hid_t type_id;             /* data type of the dataset */
+    H5Z_filter_t filter;       /* filter of the dataset */
+
+    memset (band, 0, sizeof (Viirs_band_t));
+    band->dataset_id = H5Dopen (grid_id, bmeta->name, H5P_DEFAULT);
+    if (band->dataset_id < 0)
+    {
+        sprintf (errmsg, "Unable to access %s for reading", bmeta->name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Check the chunking and filters of the dataset */
+    dcpl_id = H5Dget_create_plist (band->dataset_id);
+    type_id = H5Dget_type (band->dataset_id);
+    if (dcpl_id >= 0 && type_id >= 0 &&
+        H5Tequal (type_id, H5T_NATIVE_INT16) > 0 &&
+        H5Pget_layout (dcpl_id) == H5D_CHUNKED &&
+        H5Pget_chunk (dcpl_id, MAX_VIIRS_DIMS, chunk_dims) == MAX_VIIRS_DIMS)
+    {
+        band->direct = true;
+        nfilters = H5Pget_nfilters (dcpl_id);
+        for (i = 0; i < nfilters; i++)
+        {
+            cd_nelmts = sizeof (cd_values) / sizeof (cd_values[0]);
+            filter = H5Pget_filter2 (dcpl_id, i, &flags, &cd_nelmts,
+                cd_values, 0, NULL, NULL);
+            if (filter == H5Z_FILTER_SHUFFLE && i == 0)
+                band->shuffle = true;
+            else if (filter == H5Z_FILTER_DEFLATE && i == nfilters - 1)
+                deflate = true;
+            else
+                band->direct = false;
+        }
+        if (!deflate)
+            band->direct = false;
+        band->chunk_lines = chunk_dims[0];
+        band->chunk_samps = chunk_dims[1];
+        band->ncols = (bmeta->nsamps + band->chunk_samps - 1) /
+            band->chunk_samps;
+    }
+    if (type_id >= 0)
+        H5Tclose (type_id);
+    if (dcpl_id >= 0)
+        H5Pclose (dcpl_id);
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  inflate_viirs_chunk
+
+PURPOSE: Inflates a deflated chunk of a band and copies its lines into the
+stripe, undoing the shuffle filter if it was used.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error inflating the chunk
+SUCCESS         Successfully inflated the chunk
+
+NOTES:
+  1. Edge chunks are stored full size, so the part outside the band is
+     dropped.
+******************************************************************************/
+static int inflate_viirs_chunk
+(
+    Viirs_band_t *band,        /* I: dataset of the band */
+    int chunk,                 /* I: index of the chunk in the stripe */
+    int stripe_lines,          /* I: number of lines of the band in the
+                                     stripe */
+    int nsamps,                /* I: number of samples in the band */
+    unsigned char *chunk_buf,  /* I: storage for the inflated chunk */
+    int16_t *stripe_buf        /* O: lines of the band in the stripe */
+)
+{
+    int line;                  /* looping variable for the lines */
+    int samp;                  /* looping variable for the samples */
+    int line0;                 /* first line of the chunk in the stripe */
+    int samp0;                 /* first sample of the chunk */
+    int nlines;                /* number of lines of the chunk in the band */
+    int width;                 /* number of samples of the chunk in the band */
+    size_t nelems;             /* number of values in a chunk */
+    size_t i;                  /* index of the value in the chunk */
+    unsigned char *dest;       /* current sample of the stripe */
+    uLongf dest_len;           /* number of bytes inflated */
+
+    nelems = (size_t) band->chunk_lines * band->chunk_samps;
+    dest_len = nelems * sizeof (int16_t);
+    if (uncompress (chunk_buf, &dest_len, band->comp_buf[chunk],
+        band->comp_len[chunk]) != Z_OK ||
+        dest_len != nelems * sizeof (int16_t))
+        return (ERROR);
+
+    line0 = (chunk / band->ncols) * band->chunk_lines;
+    samp0 = (chunk % band->ncols) * band->chunk_samps;
+    nlines = stripe_lines - line0;
+    if (nlines > band->chunk_lines)
+        nlines = band->chunk_lines;
+    width = nsamps - samp0;
+    if (width > band->chunk_samps)
+        width = band->chunk_samps;
+
+    /* Byte j of value i is at j * nelems + i of a shuffled chunk */
+    for (line = 0; line < nlines; line++)
+    {
+        i = (size_t) line * band->chunk_samps;
+        dest = (unsigned char *) (stripe_buf + (size_t) (line0 + line) *
+            nsamps + samp0);
+        if (!band->shuffle)
+        {
+            memcpy (dest, chunk_buf + i * sizeof (int16_t),
+                width * sizeof (int16_t));
+            continue;
+        }
+        for (samp = 0; samp < width; samp++, i++)
+        {
+            *dest++ = chunk_buf[i];
+            *dest++ = chunk_buf[nelems + i];
+        }
+    }
+
+    return (SUCCESS);
+}
+
+
+/* Chunks of a stripe of all the bands being inflated in parallel */
+typedef struct
+{
+    Espa_internal_meta_t *xml_metadata; /* XML metadata structure */
+    Viirs_band_t *bands;       /* datasets of the bands */
+    unsigned char *chunk_bufs; /* inflated chunk of each worker */
+    size_t chunk_bytes;        /* number of bytes of each chunk_bufs */
+    Viirs_stripe_t *stripe;    /* stripe being read */
+    const int *first;          /* index of the first chunk of each band
+                                  among all the chunks */
+    int bad_band;              /* band whose chunk couldn't be inflated */
+} Viirs_inflate_t;
+
+
+/******************************************************************************
+MODULE:  inflate_viirs_stripe_chunk
+
+PURPOSE: Inflates one of the chunks of a stripe, as an iteration of the
+parallel loop over the chunks of all the bands.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error inflating the chunk
+SUCCESS         Successfully inflated the chunk
+
+NOTES:
+******************************************************************************/
+static int inflate_viirs_stripe_chunk
+(
+    void *arg,                 /* I/O: chunks of the stripe */
+    int k,                     /* I: index of the chunk among all the
+                                     chunks */
+    int worker                 /* I: worker inflating the chunk */
+)
+{
+    Viirs_inflate_t *inflate = arg;  /* chunks of the stripe */
+    Viirs_stripe_t *stripe = inflate->stripe;  /* stripe being read */
+    int i;                     /* band of the chunk */
+    int nlines;                /* number of lines of the band in the stripe */
+
+    for (i = 0; inflate->first[i + 1] <= k; i++)
+        ;
+    nlines = inflate->xml_metadata->band[i].nlines - stripe->line0;
+    if (nlines > stripe->nlines)
+        nlines = stripe->nlines;
+    if (inflate_viirs_chunk (&inflate->bands[i], k - inflate->first[i],
+        nlines, inflate->xml_metadata->band[i].nsamps,
+        inflate->chunk_bufs + worker * inflate->chunk_bytes,
+        stripe->buf[i]) != SUCCESS)
     {
-        sprintf (errmsg, "Terminating access to HDF5 file: %s", viirs_hdf_name);
-        error_handler (true, FUNC_NAME, errmsg);
+#ifdef _OPENMP
+        #pragma omp atomic write
+#endif
+        inflate->bad_band = i;
         return (ERROR);
     }
 
-    /* Allocate bands for the XML structure */
-    metadata->nbands = nviirs_bands;
-    if (allocate_band_metadata (metadata, metadata->nbands) != SUCCESS)
-    {   /* Error messages already printed */
-        return (ERROR);
-    }
-    bmeta = metadata->band;
+    return (SUCCESS);
+}
 
-    /* Loop back through the bands and fill in the band-related metadata */
-    for (i = 0; i < nviirs_bands; i++)
-    {
-        /* Fill in the band information already obtained.  Use 'sr_refl'
-           for the product type.  Copy the first 7 characters of the
-           basename as the short name.  Use 'image' for the category. */
-        strcpy (bmeta[i].product, "sr_refl");
-        strncpy (bmeta[i].short_name, basename, 7);
-        bmeta[i].short_name[7] = '\0';
-        strcpy (bmeta[i].category, "image");
-        bmeta[i].nsamps = grid_dims[i][0];
-        bmeta[i].nlines = grid_dims[i][1];
 
-        /* Use the SDS name as the band name as well as the file name */
-        count = snprintf (bmeta[i].name, sizeof (bmeta[i].name), "%s",
-            viirs_bands[i]);
-        if (count < 0 || count >= sizeof (bmeta[i].name))
+/******************************************************************************
+MODULE:  read_viirs_stripe
+
+PURPOSE: Reads a stripe of lines of all the bands.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error reading the stripe
+SUCCESS         Successfully read the stripe
+
+NOTES:
+  1. The compressed chunks of the bands read directly are gathered first,
+     since HDF5 calls are serialized, then all the chunks of all those bands
+     are inflated in parallel on the task pool.
+  2. A band whose chunks can't all be read directly in this stripe (ex. an
+     unallocated chunk, or a filter skipped for a partial chunk) is read
+     through HDF5 instead.
+******************************************************************************/
+static int read_viirs_stripe
+(
+    Espa_internal_meta_t *xml_metadata, /* I: XML metadata structure */
+    Viirs_band_t *bands,       /* I/O: datasets of the bands */
+    unsigned char *chunk_bufs, /* I: storage for an inflated chunk per
+                                     thread */
+    size_t chunk_bytes,        /* I: number of bytes of each chunk_bufs */
+    int nthreads,              /* I: number of chunk_bufs */
+    Viirs_stripe_t *stripe     /* I/O: stripe to be read, with its line0 and
+                                       nlines set */
+)
+{
+    char FUNC_NAME[] = "read_viirs_stripe";  /* function name */
+    char errmsg[STR_SIZE];     /* error message */
+    int i;                     /* looping variable for bands in XML file */
+    int chunk;                 /* looping variable for the chunks */
+    int nlines;                /* number of lines of the band in the stripe */
+    int total = 0;             /* number of chunks to be inflated */
+    int first[MAX_VIIRS_BANDS + 1]; /* index of the first chunk of each
+                                       band among all the chunks */
+    Viirs_inflate_t inflate;   /* chunks of the stripe to be inflated */
+    uint32_t filter_mask;      /* filters skipped for the chunk */
+    hsize_t offset[MAX_VIIRS_DIMS];  /* first line and sample of the chunk */
+    hsize_t nbytes;            /* number of bytes in the compressed chunk */
+    hsize_t count[MAX_VIIRS_DIMS];   /* number of lines and samples read */
+    hid_t file_space;          /* selected lines of the dataset */
+    hid_t mem_space;           /* lines of the stripe */
+    herr_t status;             /* return status of the HDF function */
+    Viirs_band_t *band = NULL; /* dataset of the current band */
+    Espa_band_meta_t *bmeta = NULL;  /* pointer to band metadata */
+
+    /* Gather the compressed chunks of the bands read directly */
+    for (i = 0; i < xml_metadata->nbands; i++)
+    {
+        band = &bands[i];
+        bmeta = &xml_metadata->band[i];
+        band->nchunks = 0;
+        nlines = bmeta->nlines - stripe->line0;
+        if (nlines > stripe->nlines)
+            nlines = stripe->nlines;
+        if (nlines <= 0 || !band->direct)
+            continue;
+
+        band->nchunks = (nlines + band->chunk_lines - 1) / band->chunk_lines *
+            band->ncols;
+        for (chunk = 0; chunk < band->nchunks; chunk++)
         {
-            sprintf (errmsg, "Overflow of bmeta[i].name string");
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
+            offset[0] = stripe->line0 + (chunk / band->ncols) *
+                band->chunk_lines;
+            offset[1] = (chunk % band->ncols) * band->chunk_samps;
+            if (H5Dget_chunk_storage_size (band->dataset_id, offset, &nbytes)
+                < 0 || nbytes == 0)
+            {
+                band->nchunks = 0;
+                break;
+            }
+
+            if (nbytes > band->comp_size[chunk])
+            {
+                espa_trace_free (band->comp_buf[chunk]);
+                band->comp_buf[chunk] = espa_trace_malloc (nbytes);
+                if (band->comp_buf[chunk] == NULL)
+                {
+                    band->comp_size[chunk] = 0;
+                    sprintf (errmsg, "Allocating memory for a compressed "
+                        "chunk of %s", bmeta->name);
+                    error_handler (true, FUNC_NAME, errmsg);
+                    return (ERROR);
+                }
+                band->comp_size[chunk] = nbytes;
+            }
+
+            if (H5Dread_chunk (band->dataset_id, H5P_DEFAULT, offset,
+                &filter_mask, band->comp_buf[chunk]) < 0 || filter_mask != 0)
+            {
+                band->nchunks = 0;
+                break;
+            }
+            band->comp_len[chunk] = nbytes;
         }
+    }
 
-        /* Set up the filename, but replace any blank spaces in the
-           filename (due to the SDS names) with underscores */
-        count = snprintf (bmeta[i].file_name, sizeof (bmeta[i].file_name),
-            "%s.%s.img", core_basename, viirs_bands[i]);
-        if (count < 0 || count >= sizeof (bmeta[i].file_name))
+    /* Read the other bands through HDF5 */
+    for (i = 0; i < xml_metadata->nbands; i++)
+    {
+        band = &bands[i];
+        bmeta = &xml_metadata->band[i];
+        first[i] = total;
+        total += band->nchunks;
+        nlines = bmeta->nlines - stripe->line0;
+        if (nlines > stripe->nlines)
+            nlines = stripe->nlines;
+        if (nlines <= 0 || band->nchunks > 0)
+            continue;
+
+        offset[0] = stripe->line0;
+        offset[1] = 0;
+        count[0] = nlines;
+        count[1] = bmeta->nsamps;
+        file_space = H5Dget_space (band->dataset_id);
+        mem_space = H5Screate_simple (MAX_VIIRS_DIMS, count, NULL);
+        status = -1;
+        if (file_space >= 0 && mem_space >= 0 &&
+            H5Sselect_hyperslab (file_space, H5S_SELECT_SET, offset, NULL,
+            count, NULL) >= 0)
+            status = H5Dread (band->dataset_id, H5T_NATIVE_INT16, mem_space,
+                file_space, H5P_DEFAULT, stripe->buf[i]);
+        if (mem_space >= 0)
+            H5Sclose (mem_space);
+        if (file_space >= 0)
+            H5Sclose (file_space);
+        if (status < 0)
         {
-            sprintf (errmsg, "Overflow of bmeta[].file_name string");
+            sprintf (errmsg, "Reading lines %d to %d from the SDS: %s",
+                stripe->line0, stripe->line0 + nlines - 1, bmeta->name);
             error_handler (true, FUNC_NAME, errmsg);
             return (ERROR);
         }
-        cleanup_file_name (bmeta[i].file_name);
+    }
+    first[xml_metadata->nbands] = total;
+
+    /* Inflate the gathered chunks of all the bands in parallel */
+    inflate.xml_metadata = xml_metadata;
+    inflate.bands = bands;
+    inflate.chunk_bufs = chunk_bufs;
+    inflate.chunk_bytes = chunk_bytes;
+    inflate.stripe = stripe;
+    inflate.first = first;
+    inflate.bad_band = -1;
+    if (espa_parallel_for (total, nthreads, inflate_viirs_stripe_chunk,
+        &inflate) != SUCCESS)
+    {
+        sprintf (errmsg, "Inflating the chunks of lines %d to %d of %s",
+            stripe->line0, stripe->line0 + stripe->nlines - 1,
+            xml_metadata->band[inflate.bad_band].name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
 
-        /* Store the ESPA data type */
-        bmeta[i].data_type = data_type[i];
+    return (SUCCESS);
+}
 
-        /* Compute the pixel size */
-        bmeta[i].pixel_size[1] = (gmeta->proj_info.ul_corner[1] -
-            gmeta->proj_info.lr_corner[1]) / bmeta[i].nlines;
-        bmeta[i].pixel_size[0] = (gmeta->proj_info.lr_corner[0] -
-            gmeta->proj_info.ul_corner[0]) / bmeta[i].nsamps;
-        strcpy (bmeta[i].pixel_units, "meters");
 
-        /* Assign the scale, offset, min/max, and fill values.  Fill value
-           is required, so assign it as 0 if it doesn't exist. */
-        if (fillvalue[i] == ESPA_INT_META_FILL)
-            bmeta[i].fill_value = 0;
-        else
-            bmeta[i].fill_value = fillvalue[i];
-        bmeta[i].scale_factor = scalevalue[i];
-        bmeta[i].add_offset = offsetvalue[i];
-        bmeta[i].valid_range[0] = minvalue[i];
-        bmeta[i].valid_range[1] = maxvalue[i];
+/******************************************************************************
+MODULE:  viirs_writer_thread
 
-        /* Set the resample method to nearest neighbor, since it's not
-           available in the VIIRS file but it's a known entity. */
-        bmeta[i].resample_method = ESPA_NN;
+PURPOSE: Thread which writes the queued stripes to the raw binary files,
+while the next stripe is being read and inflated by the caller.
 
-        /* Assign the long_name and data_units values */
-        count = snprintf (bmeta[i].long_name, sizeof (bmeta[i].long_name), "%s",
-            longname[i]);
-        if (count < 0 || count >= sizeof (bmeta[i].long_name))
-        {
-            sprintf (errmsg, "Overflow of bmeta[].long_name string");
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
+RETURN VALUE:
+Type = void *
+Value        Description
+-----        -----------
+NULL         Always
 
-        count = snprintf (bmeta[i].data_units, sizeof (bmeta[i].data_units),
-            "%s", units[i]);
-        if (count < 0 || count >= sizeof (bmeta[i].data_units))
-        {
-            sprintf (errmsg, "Overflow of bmeta[].data_units string");
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
+NOTES:
+  1. The raw binary file of a band is opened with its first stripe, and
+     closed and given its ENVI header with its last stripe.
+  2. Once the writer fails, the remaining stripes are dropped so the reader
+     isn't blocked; the reader stops once it sees the failure.
+******************************************************************************/
+static void *viirs_writer_thread
+(
+    void *arg                  /* I: queue of the stripes */
+)
+{
+    char FUNC_NAME[] = "viirs_writer_thread";  /* function name */
+    char errmsg[STR_SIZE];     /* error message */
+    int i;                     /* looping variable for the bands */
+    int nlines;                /* number of lines of the band in the stripe */
+    int channel;               /* channel of the band in the browse */
+    Viirs_queue_t *queue = arg;  /* queue of the stripes */
+    Espa_internal_meta_t *xml_metadata = queue->xml_metadata;
+    Espa_band_meta_t *bmeta = NULL;  /* pointer to band metadata */
+    Viirs_stripe_t *stripe = NULL;   /* current stripe */
+    Raw_binary_writer_t *writer[MAX_VIIRS_BANDS] = {NULL}; /* band writers */
+    bool failed = false;       /* has writing failed? */
 
-        /* Get the QA description information */
-        count = snprintf (bmeta[i].qa_desc, sizeof (bmeta[i].qa_desc), "%s",
-            qa_desc[i]);
-        if (count < 0 || count >= sizeof (bmeta[i].qa_desc))
+    while (1)
+    {
+        /* Wait for the next stripe, or the end of the stripes */
+        pthread_mutex_lock (&queue->mutex);
+        while (queue->count == 0 && !queue->done)
+            pthread_cond_wait (&queue->cond, &queue->mutex);
+        if (queue->count == 0)
         {
-            sprintf (errmsg, "Overflow of bmeta[].qa_desc string");
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
+            pthread_mutex_unlock (&queue->mutex);
+            break;
         }
+        stripe = &queue->stripe[queue->head];
+        pthread_mutex_unlock (&queue->mutex);
 
-        /* Add the production date/time and PGE version from the core
-           metadata */
-        count = snprintf (bmeta[i].production_date,
-            sizeof (bmeta[i].production_date), "%s", prod_date_time);
-        if (count < 0 || count >= sizeof (bmeta[i].production_date))
+        /* The stripe is only touched by this thread until it's released */
+        for (i = 0; i < xml_metadata->nbands && !failed; i++)
         {
-            sprintf (errmsg, "Overflow of bmeta[].production_date string");
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
+            bmeta = &xml_metadata->band[i];
+            nlines = bmeta->nlines - stripe->line0;
+            if (nlines > stripe->nlines)
+                nlines = stripe->nlines;
+            if (nlines <= 0)
+                continue;
+
+            if (stripe->line0 == 0)
+            {
+                writer[i] = open_raw_binary_writer (bmeta->file_name,
+                    (size_t) bmeta->nlines * bmeta->nsamps * sizeof (int16_t),
+                    0);
+                if (writer[i] == NULL)
+                {
+                    sprintf (errmsg, "Opening the raw binary file: %s",
+                        bmeta->file_name);
+                    error_handler (true, FUNC_NAME, errmsg);
+                    failed = true;
+                    break;
+                }
+                if (start_raw_binary_writer_stats (writer[i], bmeta)
+                    != SUCCESS)
+                {
+                    sprintf (errmsg, "Starting the statistics of band %s",
+                        bmeta->name);
+                    error_handler (true, FUNC_NAME, errmsg);
+                    failed = true;
+                    break;
+                }
+                channel = espa_browse_channel (queue->browse, i);
+                if (channel >= 0)
+                    start_raw_binary_writer_browse (writer[i], queue->browse,
+                        channel);
+            }
+
+            if (append_raw_binary_writer (writer[i], nlines, bmeta->nsamps,
+                sizeof (int16_t), stripe->buf[i]) != SUCCESS)
+            {
+                sprintf (errmsg, "Writing image to the raw binary file: %s",
+                    bmeta->file_name);
+                error_handler (true, FUNC_NAME, errmsg);
+                failed = true;
+                break;
+            }
+
+            if (stripe->line0 + nlines == bmeta->nlines)
+            {
+                get_raw_binary_writer_checksum (writer[i], bmeta->checksum);
+                get_raw_binary_writer_stats (writer[i], &bmeta->stats);
+                if (close_raw_binary_writer (writer[i]) != SUCCESS)
+                {
+                    sprintf (errmsg, "Closing the raw binary file: %s",
+                        bmeta->file_name);
+                    error_handler (true, FUNC_NAME, errmsg);
+                    failed = true;
+                }
+                writer[i] = NULL;
 
-        count = snprintf (bmeta[i].app_version, sizeof (bmeta[i].app_version),
-            "PGE Version %s", pge_version);
-        if (count < 0 || count >= sizeof (bmeta[i].app_version))
-        {
-            sprintf (errmsg, "Overflow of bmeta[].app_version string");
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
+                if (!failed && write_viirs_envi_hdr (bmeta,
+                    &xml_metadata->global) != SUCCESS)
+                {  /* Error messages already written */
+                    failed = true;
+                }
+            }
         }
-    }  /* end for i (loop through the bands) */
-
-    /* Set the orientation angle to 0.0 */
-    gmeta->orientation_angle = 0.0;
-
-    /* Get geolocation information from the XML file (using the first band) to
-       prepare for computing the bounding coordinates */
-    if (!get_geoloc_info (metadata, &geoloc_def))
-    {
-        sprintf (errmsg, "Copying the geolocation information from the XML "
-            "metadata structure.");
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
-    }
-
-    /* Setup the mapping structure */
-    geoloc_map = setup_mapping (&geoloc_def);
-    if (geoloc_map == NULL)
-    {
-        sprintf (errmsg, "Setting up the geolocation mapping structure.");
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
-    }
 
-    /* Get the geographic coords for the UL corner */
-    img.l = 0.0;
-    img.s = 0.0;
-    img.is_fill = false;
-    if (!from_space (geoloc_map, &img, &geo))
-    {
-        sprintf (errmsg, "Mapping UL corner to lat/long");
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
+        /* Release the stripe */
+        pthread_mutex_lock (&queue->mutex);
+        queue->head = (queue->head + 1) % VIIRS_QUEUE_STRIPES;
+        queue->count--;
+        if (failed)
+            queue->failed = true;
+        pthread_cond_broadcast (&queue->cond);
+        pthread_mutex_unlock (&queue->mutex);
     }
-    gmeta->ul_corner[0] = geo.lat * DEG;
-    gmeta->ul_corner[1] = geo.lon * DEG;
 
-    /* Get the geographic coords for the LR corner */
-    img.l = bmeta[0].nlines-1;
-    img.s = bmeta[0].nsamps-1;
-    img.is_fill = false;
-    if (!from_space (geoloc_map, &img, &geo))
+    /* Close the bands left open by a failure */
+    for (i = 0; i < xml_metadata->nbands; i++)
     {
-        sprintf (errmsg, "Mapping UL corner to lat/long");
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
+        if (writer[i] != NULL)
+            close_raw_binary_writer (writer[i]);
     }
-    gmeta->lr_corner[0] = geo.lat * DEG;
-    gmeta->lr_corner[1] = geo.lon * DEG;
 
-    /* Free the geolocation structure */
-    free (geoloc_map);
-
-    /* Successful read */
-    return (SUCCESS);
+    return (NULL);
 }
 
 
@@ -1033,178 +2088,246 @@ ERROR           Error converting the VIIRS SDS
 SUCCESS         Successfully converted VIIRS SDS to raw binary
 
 NOTES:
+  1. The bands are converted together, a stripe of lines at a time.  The
+     stripes hold a whole number of chunks, sized so the stripes in flight
+     and the compressed chunks stay within the memory budget (but a stripe
+     holds at least one row of chunks).  The budget is lowered to fit in the
+     process memory budget (see espa_mem_fit_count), if there is one.
+  2. The next stripe is read and inflated while the previous one is written
+     by a separate thread.
+  3. The bands are read from the 500m grid left open by open_viirs_granule.
 ******************************************************************************/
 int convert_hdf_to_img
 (
-    char *viirs_hdf_name,      /* I: name of VIIRS file to be processed */
-    Espa_internal_meta_t *xml_metadata /* I: metadata structure for HDF file */
+    Viirs_granule_t *granule,  /* I: opened VIIRS granule to be processed */
+    Espa_internal_meta_t *xml_metadata, /* I: metadata structure for HDF
+                                              file */
+    int memory_mb,             /* I: memory budget for the image data (MB);
+                                     0 for VIIRS_DEFAULT_MEMORY_MB */
+    Espa_browse_t *browse      /* I/O: browse the bands are added to; NULL if
+                                     none */
 )
 {
     char FUNC_NAME[] = "convert_hdf_to_img";  /* function name */
     char errmsg[STR_SIZE];    /* error message */
-    char dataset_name[STR_SIZE];  /* name of the dataset to read */
-    char envi_file[STR_SIZE]; /* name of the output ENVI header file */
-    char *cptr = NULL;        /* pointer to the file extension */
-    char *img_file = NULL;    /* name of the output raw binary file */
-    char *grid500 = NULL;     /* name of the 500m grid group */
-    int i;                    /* looping variable for bands in XML file */
-    int nbytes;               /* number of bytes in the data type */
-    int count;                /* number of chars copied in snprintf */
-    hid_t file_id;            /* file ID for the VIIRS file */
-    hid_t grid500_id;         /* group ID for the 500m grid */
-    hid_t dataset_id;         /* dataset ID in the VIIRS file */
-    herr_t status;            /* return status of the HDF function */
-    int16_t *file_buf=NULL;   /* 1D array for the image data */
-    FILE *fp_rb = NULL;       /* file pointer for the raw binary file */
-    Envi_header_t envi_hdr;   /* output ENVI header information */
+    int i, j;                 /* looping variables */
+    int nthreads;             /* number of threads inflating chunks */
+    int unit = 1;             /* number of lines the stripes are aligned to */
+    int max_nlines = 0;       /* largest number of lines of a band */
+    int stripe_lines;         /* number of lines in a full stripe */
+    int line;                 /* looping variable for the stripes */
+    int retval = SUCCESS;     /* return status */
+    size_t line_bytes = 0;    /* number of bytes in a line of all bands */
+    size_t chunk_bytes = 0;   /* largest number of bytes in a chunk */
+    pthread_t writer;         /* writer thread */
+    bool writer_started = false;  /* was the writer thread started? */
+    unsigned char *chunk_bufs = NULL; /* inflated chunk of each thread */
+    Viirs_band_t bands[MAX_VIIRS_BANDS]; /* datasets of the bands */
+    Viirs_queue_t queue;      /* queue between the reader and the writer */
+    Viirs_stripe_t *stripe = NULL;   /* stripe being read */
     Espa_band_meta_t *bmeta = NULL;  /* pointer to band metadata */
-    Espa_global_meta_t *gmeta = &xml_metadata->global;  /* global metadata */
 
-    /* Open as HDF5 file for reading */
-    file_id = H5Fopen (viirs_hdf_name, H5F_ACC_RDONLY, H5P_DEFAULT);
-    if (file_id < 0)
+    if (xml_metadata->nbands < 1 || xml_metadata->nbands > MAX_VIIRS_BANDS)
     {
-        sprintf (errmsg, "Unable to open %s for reading", viirs_hdf_name);
+        sprintf (errmsg, "Unsupported number of bands (%d) for the VIIRS "
+            "product",
+            xml_metadata->nbands);
         error_handler (true, FUNC_NAME, errmsg);
         return (ERROR);
     }
-
-    /* Confirm the 500m grid exists then open it. Otherwise flag an error if
-       the grid is not found. */
-    grid500 = "/HDFEOS/GRIDS/VNP_Grid_500m_2D/Data Fields";
-    if (H5Lexists (file_id, grid500, H5P_DEFAULT) > 0)
+    if (memory_mb <= 0)
+        memory_mb = VIIRS_DEFAULT_MEMORY_MB;
+    memory_mb = espa_mem_fit_count (1024 * 1024, memory_mb, 1);
+    nthreads = espa_task_pool_threads ();
+
+    /* Open the bands and align the stripes to the chunks of the bands read
+       directly */
+    memset (bands, 0, sizeof (bands));
+    memset (&queue, 0, sizeof (queue));
+    queue.xml_metadata = xml_metadata;
+    queue.browse = browse;
+    for (i = 0; i < xml_metadata->nbands; i++)
     {
-        grid500_id = H5Gopen (file_id, grid500, H5P_DEFAULT);
-        if (grid500_id < 0)
-        {
-            sprintf (errmsg, "Unable to open 500m grid: %s", grid500);
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
+        bmeta = &xml_metadata->band[i];
+        espa_log_printf (ESPA_LOG_INFO, "Reading band %d: %s\n", i,
+            bmeta->name);
+        printf ("    nlines x nsamps: %d x %d\n", bmeta->nlines, bmeta->nsamps);
+        if (open_viirs_band (granule->grid500_id, bmeta, &bands[i]) != SUCCESS)
+        {  /* Error messages already written */
+            retval = ERROR;
+            goto cleanup;
         }
-    }
-    else
-    {
-        sprintf (errmsg, "Unable to find the 500m grid: %s", grid500);
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
+
+        if (bands[i].direct && bands[i].chunk_lines > unit)
+            unit = bands[i].chunk_lines;
+        if (bmeta->nlines > max_nlines)
+            max_nlines = bmeta->nlines;
+        line_bytes += (size_t) bmeta->nsamps * sizeof (int16_t);
     }
 
-    /* Loop through the bands in the metadata file and convert each one to
-       the ESPA format */
+    /* Size the stripes for the stripes in flight plus the compressed chunks
+       of a stripe, which are no bigger than a stripe */
+    stripe_lines = (size_t) memory_mb * 1024 * 1024 /
+        ((VIIRS_QUEUE_STRIPES + 1) * line_bytes) / unit * unit;
+    if (stripe_lines < unit)
+        stripe_lines = unit;
+    if (stripe_lines > max_nlines)
+        stripe_lines = max_nlines;
+    printf ("    lines per stripe: %d\n", stripe_lines);
+
+    /* Chunks which don't fit the stripes are read through HDF5 */
     for (i = 0; i < xml_metadata->nbands; i++)
     {
-        /* Set up the band metadata pointer */
-        bmeta = &xml_metadata->band[i];
-
-        printf ("Reading band %d: %s\n", i, bmeta->name);
-        printf ("    nlines x nsamps: %d x %d\n", bmeta->nlines, bmeta->nsamps);
-        /* Open the current band as a dataset in the HDF5 file */
-        strcpy (dataset_name, bmeta->name);
-        dataset_id = H5Dopen (grid500_id, dataset_name, H5F_ACC_RDONLY);
-        if (dataset_id < 0)
+        if (!bands[i].direct)
+            continue;
+        if (stripe_lines % bands[i].chunk_lines != 0 &&
+            stripe_lines < xml_metadata->band[i].nlines)
         {
-            sprintf (errmsg, "Unable to access %s for reading", dataset_name);
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
+            bands[i].direct = false;
+            continue;
         }
-
-        /* Open the raw binary file for writing */
-        img_file = bmeta->file_name;
-        fp_rb = open_raw_binary (img_file, "wb");
-        if (fp_rb == NULL)
+        printf ("    chunks of %s are inflated in parallel\n",
+            xml_metadata->band[i].name);
+
+        bands[i].max_chunks = (stripe_lines + bands[i].chunk_lines - 1) /
+            bands[i].chunk_lines * bands[i].ncols;
+        bands[i].comp_buf = calloc (bands[i].max_chunks,
+            sizeof (unsigned char *));
+        bands[i].comp_size = calloc (bands[i].max_chunks, sizeof (size_t));
+        bands[i].comp_len = calloc (bands[i].max_chunks, sizeof (size_t));
+        if (bands[i].comp_buf == NULL || bands[i].comp_size == NULL ||
+            bands[i].comp_len == NULL)
         {
-            sprintf (errmsg, "Opening the output raw binary file: %s",
-                img_file);
+            sprintf (errmsg, "Allocating memory for the compressed chunks");
             error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
+            retval = ERROR;
+            goto cleanup;
         }
+        if ((size_t) bands[i].chunk_lines * bands[i].chunk_samps *
+            sizeof (int16_t) > chunk_bytes)
+            chunk_bytes = (size_t) bands[i].chunk_lines *
+                bands[i].chunk_samps * sizeof (int16_t);
+    }
 
-        /* Allocate memory for the entire 500m image, which is a signed 16-bit
-           integer.  Allocate as a 1D contiguous array. */
-        nbytes = sizeof (int16_t);
-        printf ("    nbytes: %d\n", nbytes);
-        file_buf = calloc (bmeta->nlines * bmeta->nsamps, nbytes);
-        if (file_buf == NULL)
+    /* Allocate the stripes and the inflated chunk of each thread */
+    for (j = 0; j < VIIRS_QUEUE_STRIPES; j++)
+    {
+        for (i = 0; i < xml_metadata->nbands; i++)
         {
-            sprintf (errmsg, "Allocating memory for the image data containing "
-                "%d lines x %d samples. (1D)", bmeta->nlines, bmeta->nsamps);
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
+            queue.stripe[j].buf[i] = alloc_raw_binary_buf ((size_t)
+                stripe_lines * xml_metadata->band[i].nsamps *
+                sizeof (int16_t));
+            if (queue.stripe[j].buf[i] == NULL)
+            {
+                sprintf (errmsg, "Allocating memory for %d lines of the "
+                    "image data", stripe_lines);
+                error_handler (true, FUNC_NAME, errmsg);
+                retval = ERROR;
+                goto cleanup;
+            }
         }
-
-        /* Read the entire band */
-        status = H5Dread (dataset_id, H5T_NATIVE_INT16, H5S_ALL, H5S_ALL,
-            H5P_DEFAULT, file_buf);
-        if (status < 0)
+    }
+    if (chunk_bytes > 0)
+    {
+        chunk_bufs = espa_trace_malloc (nthreads * chunk_bytes);
+        if (chunk_bufs == NULL)
         {
-            sprintf (errmsg, "Reading data from the SDS: %s", bmeta->name);
+            sprintf (errmsg, "Allocating memory for the inflated chunks");
             error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
+            retval = ERROR;
+            goto cleanup;
         }
+    }
 
-        /* Write entire image to the raw binary file */
-        if (write_raw_binary (fp_rb, bmeta->nlines, bmeta->nsamps, nbytes,
-            (void *) file_buf) != SUCCESS)
-        {
-            sprintf (errmsg, "Writing image to the raw binary file: %s",
-                img_file);
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
+    /* Start the writer */
+    pthread_mutex_init (&queue.mutex, NULL);
+    pthread_cond_init (&queue.cond, NULL);
+    if (pthread_create (&writer, NULL, viirs_writer_thread, &queue) != 0)
+    {
+        sprintf (errmsg, "Starting the raw binary writer thread");
+        error_handler (true, FUNC_NAME, errmsg);
+        retval = ERROR;
+        goto cleanup;
+    }
+    writer_started = true;
 
-        /* Close the HDF5 dataset and raw binary file */
-        close_raw_binary (fp_rb);
-        status = H5Dclose (dataset_id);
-        if (status < 0)
-        {
-            sprintf (errmsg, "Terminating access to 500m dataset: %s",
-                bmeta->name);
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
+    /* Read the stripes and queue them for the writer */
+    for (line = 0; line < max_nlines; line += stripe_lines)
+    {
+        /* Wait for a free stripe.  Only the writer touches the queued
+           stripes, so the free stripe is filled without the lock. */
+        pthread_mutex_lock (&queue.mutex);
+        while (queue.count == VIIRS_QUEUE_STRIPES && !queue.failed)
+            pthread_cond_wait (&queue.cond, &queue.mutex);
+        stripe = &queue.stripe[(queue.head + queue.count) %
+            VIIRS_QUEUE_STRIPES];
+        pthread_mutex_unlock (&queue.mutex);
+        if (queue.failed)
+            break;
+
+        stripe->line0 = line;
+        stripe->nlines = max_nlines - line;
+        if (stripe->nlines > stripe_lines)
+            stripe->nlines = stripe_lines;
+        if (read_viirs_stripe (xml_metadata, bands, chunk_bufs, chunk_bytes,
+            nthreads, stripe) != SUCCESS)
+        {  /* Error messages already written */
+            retval = ERROR;
+            break;
         }
 
-        /* Free the memory */
-        free (file_buf);
+        /* Queue the stripe for the writer */
+        pthread_mutex_lock (&queue.mutex);
+        queue.count++;
+        pthread_cond_broadcast (&queue.cond);
+        pthread_mutex_unlock (&queue.mutex);
+    }
 
-        /* Create the ENVI header file this band */
-        if (create_envi_struct (bmeta, gmeta, &envi_hdr) != SUCCESS)
+cleanup:
+    /* Let the writer drain the queue and wait for it */
+    if (writer_started)
+    {
+        pthread_mutex_lock (&queue.mutex);
+        queue.done = true;
+        pthread_cond_broadcast (&queue.cond);
+        pthread_mutex_unlock (&queue.mutex);
+        pthread_join (writer, NULL);
+        pthread_cond_destroy (&queue.cond);
+        pthread_mutex_destroy (&queue.mutex);
+        if (queue.failed)
         {
-            sprintf (errmsg, "Creating the ENVI header structure for this "
-                "file: %s", bmeta->file_name);
+            sprintf (errmsg, "Writing the raw binary files failed");
             error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
+            retval = ERROR;
         }
+    }
 
-        /* Write the ENVI header */
-        count = snprintf (envi_file, sizeof (envi_file), "%s", img_file);
-        if (count < 0 || count >= sizeof (envi_file))
-        {
-            sprintf (errmsg, "Overflow of envi_file string");
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
-        cptr = strrchr (envi_file, '.');
-        strcpy (cptr, ".hdr");
+    espa_trace_free (chunk_bufs);
+    for (j = 0; j < VIIRS_QUEUE_STRIPES; j++)
+    {
+        for (i = 0; i < xml_metadata->nbands; i++)
+            espa_trace_free (queue.stripe[j].buf[i]);
+    }
 
-        if (write_envi_hdr (envi_file, &envi_hdr) != SUCCESS)
+    /* Close the HDF5 datasets */
+    for (i = 0; i < xml_metadata->nbands; i++)
+    {
+        for (j = 0; j < bands[i].max_chunks && bands[i].comp_buf != NULL;
+            j++)
+            espa_trace_free (bands[i].comp_buf[j]);
+        free (bands[i].comp_buf);
+        free (bands[i].comp_size);
+        free (bands[i].comp_len);
+        if (bands[i].dataset_id > 0 && H5Dclose (bands[i].dataset_id) < 0)
         {
-            sprintf (errmsg, "Writing the ENVI header file: %s.", envi_file);
+            sprintf (errmsg, "Terminating access to 500m dataset: %s",
+                xml_metadata->band[i].name);
             error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
+            retval = ERROR;
         }
-    }  /* end for */
-
-    /* Close the HDF5 file */
-    status = H5Fclose (file_id);
-    if (status < 0)
-    {
-        sprintf (errmsg, "Terminating access to HDF5 file: %s", viirs_hdf_name);
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
     }
 
-    /* Successful conversion */
-    return (SUCCESS);
+    return (retval);
 }
 
 
@@ -1227,41 +2350,62 @@ NOTES:
   2. Only the 500m image bands will be ingested at the current time since the
      main focus of supporting this product in ESPA is to generate the 500m
      NDVI to compare with the MODIS imagery.
+  3. The XML file is written again once the bands are converted, with the
+     checksums and statistics computed as they were converted.
+  4. The HDF5 file is opened once; the metadata and the bands are read from
+     the same open granule.
 ******************************************************************************/
 int convert_viirs_to_espa
 (
     char *viirs_hdf_file,  /* I: input VIIRS HDF5 filename */
     char *espa_xml_file,   /* I: output ESPA XML metadata filename */
-    bool del_src           /* I: should the source .tif files be removed after
+    bool del_src,          /* I: should the source .tif files be removed after
                                  conversion? */
+    int memory_mb,         /* I: memory budget for the image data (MB); 0 for
+                                 VIIRS_DEFAULT_MEMORY_MB */
+    bool browse            /* I: should the browse be built as the bands are
+                                 converted? */
 )
 {
     char FUNC_NAME[] = "convert_viirs_to_espa";  /* function name */
     char errmsg[STR_SIZE];   /* error message */
     char *cptr = NULL;       /* pointer to .h5 extention in the filename */
     int count;               /* number of chars copied in snprintf */
+    Viirs_granule_t granule; /* opened and indexed VIIRS granule */
     Espa_internal_meta_t xml_metadata;  /* XML metadata structure to be
                                 populated by reading the MTL metadata file */
+    Espa_browse_t *browse_image = NULL;  /* browse being built; NULL if
+                                            none */
 
     /* Initialize the metadata structure */
     init_metadata_struct (&xml_metadata);
 
+    /* Open the VIIRS product and index its metadata in a single pass */
+    if (open_viirs_granule (viirs_hdf_file, &granule) != SUCCESS)
+    {
+        sprintf (errmsg, "Opening the VIIRS HDF file: %s", viirs_hdf_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
     /* Read the geolocation information from the VIIRS product for the 500m
        grid */
-    if (read_viirs_500m_geo_meta (viirs_hdf_file, &xml_metadata) != SUCCESS)
+    if (read_viirs_500m_geo_meta (&granule, &xml_metadata) != SUCCESS)
     {
         sprintf (errmsg, "Reading the VIIRS HDF-EOS file: %s", viirs_hdf_file);
         error_handler (true, FUNC_NAME, errmsg);
+        close_viirs_granule (&granule);
         return (ERROR);
     }
 
     /* Read the VIIRS 500m grid metadata and populate our internal ESPA
        metadata structure for the 500m bands, including the global geolocation
        data */
-    if (read_viirs_500m_grid_meta (viirs_hdf_file, &xml_metadata) != SUCCESS)
+    if (read_viirs_500m_grid_meta (&granule, &xml_metadata) != SUCCESS)
     {
         sprintf (errmsg, "Reading the VIIRS HDF file: %s", viirs_hdf_file);
         error_handler (true, FUNC_NAME, errmsg);
+        close_viirs_granule (&granule);
         return (ERROR);
     }
 
@@ -1273,6 +2417,7 @@ int convert_viirs_to_espa
     {
         sprintf (errmsg, "Overflow of xml_metadata.global.product_id string");
         error_handler (true, FUNC_NAME, errmsg);
+        close_viirs_granule (&granule);
         return (ERROR);
     }
 
@@ -1283,6 +2428,7 @@ int convert_viirs_to_espa
         sprintf (errmsg, "Error with xml_metadata.global.product_id string. "
             "It is expected to contain h5 as the extension.");
         error_handler (true, FUNC_NAME, errmsg);
+        close_viirs_granule (&granule);
         return (ERROR);
     }
     *cptr = '\0';
@@ -1291,22 +2437,63 @@ int convert_viirs_to_espa
        XML filename */
     if (write_metadata (&xml_metadata, espa_xml_file) != SUCCESS)
     {  /* Error messages already written */
+        close_viirs_granule (&granule);
         return (ERROR);
     }
 
     /* Validate the output metadata file */
     if (validate_xml_file (espa_xml_file) != SUCCESS)
     {  /* Error messages already written */
+        close_viirs_granule (&granule);
         return (ERROR);
     }
 
+    /* Choose the bands of the browse */
+    if (browse)
+    {
+        browse_image = open_espa_browse (&xml_metadata, 0);
+        if (browse_image == NULL)
+        {  /* Error messages already written */
+            close_viirs_granule (&granule);
+            return (ERROR);
+        }
+    }
+
     /* Convert each of the VIIRS 500m image bands to raw binary */
-    if (convert_hdf_to_img (viirs_hdf_file, &xml_metadata) != SUCCESS)
+    if (convert_hdf_to_img (&granule, &xml_metadata, memory_mb,
+        browse_image) != SUCCESS)
     {
         sprintf (errmsg, "Converting %s to ESPA", viirs_hdf_file);
         error_handler (true, FUNC_NAME, errmsg);
+        close_espa_browse (browse_image);
+        close_viirs_granule (&granule);
+        return (ERROR);
+    }
+
+    /* Done with the VIIRS file */
+    if (close_viirs_granule (&granule) != SUCCESS)
+    {  /* Error messages already written */
+        close_espa_browse (browse_image);
+        return (ERROR);
+    }
+
+    /* Write the metadata again with the checksums and statistics of the
+       bands, and the browse stretched with those statistics */
+    if (write_metadata (&xml_metadata, espa_xml_file) != SUCCESS)
+    {  /* Error messages already written */
+        close_espa_browse (browse_image);
         return (ERROR);
     }
+    if (browse_image != NULL)
+    {
+        if (write_espa_browse (browse_image, &xml_metadata, espa_xml_file)
+            != SUCCESS)
+        {  /* Error messages already written */
+            close_espa_browse (browse_image);
+            return (ERROR);
+        }
+        close_espa_browse (browse_image);
+    }
 
     /* Remove the source file if specified */
     if (del_src)
@@ -18,14 +18,17 @@ NOTES:
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <pthread.h>
 #include <hdf5.h>
-#include <HE5_HdfEosDef.h>
 #include "error_handler.h"
 #include "espa_metadata.h"
 #include "espa_geoloc.h"
 #include "raw_binary_io.h"
+#include "raw_binary_writer.h"
 #include "write_metadata.h"
 #include "envi_header.h"
+#include "espa_browse.h"
+#include "espa_odl.h"
 
 /* Defines */
 /* maximum number of VIIRS bands/SDSs in a file -- only supporting the three
@@ -36,6 +39,42 @@ NOTES:
    2D - still need to be able to read the dimensions from the SDS */
 #define MAX_VIIRS_DIMS 2
 
+/* default memory budget for the image data being converted (MB) */
+#define VIIRS_DEFAULT_MEMORY_MB 64
+
+/* number of stripes of lines held between the reading of the HDF5 file and
+   the writing of the raw binary files */
+#define VIIRS_QUEUE_STRIPES 2
+
+/* Attribute of the root group or of a band dataset of the granule */
+typedef struct
+{
+    char object[STR_SIZE];     /* name of the dataset holding the attribute;
+                                  "/" for the root group */
+    char name[STR_SIZE];       /* name of the attribute */
+    char *string;              /* value of a string attribute; NULL for a
+                                  numeric attribute */
+    double value;              /* first value of a numeric attribute */
+} Viirs_attr_t;
+
+/* VIIRS granule, opened once and its metadata indexed in a single pass by
+   open_viirs_granule */
+typedef struct
+{
+    char *file_name;           /* name of the HDF5 file */
+    hid_t file_id;             /* file ID of the HDF5 file */
+    hid_t grid500_id;          /* group ID of the 500m grid data fields */
+    Espa_odl_t struct_meta;    /* parsed HDF-EOS structural metadata */
+    int nbands;                /* number of surface reflectance bands */
+    char band_name[MAX_VIIRS_BANDS][STR_SIZE]; /* names of the band
+                                  datasets */
+    int band_dims[MAX_VIIRS_BANDS][MAX_VIIRS_DIMS]; /* dimensions of the
+                                  band datasets */
+    Viirs_attr_t *attrs;       /* attributes, sorted by object and name */
+    int nattrs;                /* number of attributes */
+    int max_attrs;             /* number of attributes allocated */
+} Viirs_granule_t;
+
 /* Prototypes */
 int read_viirs_hdf
 (
@@ -44,18 +83,52 @@ int read_viirs_hdf
                                            populated from the VIIRS file */
 );
 
+int open_viirs_granule
+(
+    char *viirs_hdf_name,      /* I: name of VIIRS file to be opened */
+    Viirs_granule_t *granule   /* O: opened and indexed granule */
+);
+
+int close_viirs_granule
+(
+    Viirs_granule_t *granule   /* I/O: granule to be closed */
+);
+
+int read_viirs_500m_geo_meta
+(
+    const Viirs_granule_t *granule,  /* I: indexed VIIRS granule */
+    Espa_internal_meta_t *metadata   /* I/O: input metadata structure to be
+                                           populated from the VIIRS file */
+);
+
+int read_viirs_500m_grid_meta
+(
+    const Viirs_granule_t *granule,  /* I: indexed VIIRS granule */
+    Espa_internal_meta_t *metadata   /* I/O: input metadata structure to be
+                                           populated from the VIIRS file */
+);
+
 int convert_hdf_to_img
 (
-    char *viirs_hdf_name,      /* I: name of VIIRS file to be processed */
-    Espa_internal_meta_t *xml_metadata /* I: metadata structure for HDF file */
+    Viirs_granule_t *granule,  /* I: opened VIIRS granule to be processed */
+    Espa_internal_meta_t *xml_metadata, /* I: metadata structure for HDF
+                                              file */
+    int memory_mb,             /* I: memory budget for the image data (MB);
+                                     0 for VIIRS_DEFAULT_MEMORY_MB */
+    Espa_browse_t *browse      /* I/O: browse the bands are added to; NULL if
+                                     none */
 );
 
 int convert_viirs_to_espa
 (
     char *viirs_hdf_file,  /* I: input VIIRS HDF filename */
     char *espa_xml_file,   /* I: output ESPA XML metadata filename */
-    bool del_src           /* I: should the source .tif files be removed after
+    bool del_src,          /* I: should the source .tif files be removed after
                                  conversion? */
+    int memory_mb,         /* I: memory budget for the image data (MB); 0 for
+                                 VIIRS_DEFAULT_MEMORY_MB */
+    bool browse            /* I: should the browse be built as the bands are
+                                 converted? */
 );
 
 #endif
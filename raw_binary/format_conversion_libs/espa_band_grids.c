@@ -0,0 +1,292 @@
+/*****************************************************************************
+FILE: espa_band_grids.c
+
+PURPOSE: Contains functions for grouping the bands of an ESPA product into
+the grids of the HDF and NetCDF exports (see espa_band_grids.h).
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+*****************************************************************************/
+#include "espa_band_grids.h"
+
+/******************************************************************************
+MODULE:  same_grid
+
+PURPOSE: Determines if two bands share a grid.
+
+RETURN VALUE:
+Type = bool
+Value           Description
+-----           -----------
+true            The bands have the same pixel size, lines, and samples
+false           The bands are on different grids
+******************************************************************************/
+static bool same_grid
+(
+    const Espa_band_meta_t *band1,  /* I: metadata of the first band */
+    const Espa_band_meta_t *band2   /* I: metadata of the second band */
+)
+{
+    return (band1->pixel_size[0] == band2->pixel_size[0] &&
+        band1->pixel_size[1] == band2->pixel_size[1] &&
+        band1->nlines == band2->nlines && band1->nsamps == band2->nsamps);
+}
+
+
+/******************************************************************************
+MODULE:  get_espa_band_grids
+
+PURPOSE: Groups the bands of a product into grids and determines the names of
+the grids.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error allocating the grids
+SUCCESS         Successfully grouped the bands
+
+NOTES:
+  1. The caller frees the grids with free_espa_band_grids.
+******************************************************************************/
+int get_espa_band_grids
+(
+    Espa_internal_meta_t *xml_metadata, /* I: XML metadata structure */
+    Espa_band_grids_t *grids            /* O: grids of the bands */
+)
+{
+    char FUNC_NAME[] = "get_espa_band_grids";   /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    int i;                   /* looping variable for the bands */
+    int g;                   /* looping variable for the grids */
+    int k;                   /* looping variable for the earlier grids */
+    int nalloc = xml_metadata->nbands > 0 ? xml_metadata->nbands : 1;
+                             /* size of the arrays */
+    Espa_band_meta_t *bmeta = NULL;  /* metadata of the first band of a
+                                        grid */
+
+    grids->ngrids = 0;
+    grids->band_grid = calloc (nalloc, sizeof (int));
+    grids->grid_band = calloc (nalloc, sizeof (int));
+    grids->grid_suffix = calloc (nalloc, sizeof (int));
+    if (grids->band_grid == NULL || grids->grid_band == NULL ||
+        grids->grid_suffix == NULL)
+    {
+        sprintf (errmsg, "Allocating the grids of %d bands", nalloc);
+        error_handler (true, FUNC_NAME, errmsg);
+        free_espa_band_grids (grids);
+        return (ERROR);
+    }
+
+    /* Put each band in the first grid it matches, or start a new grid */
+    for (i = 0; i < xml_metadata->nbands; i++)
+    {
+        for (g = 0; g < grids->ngrids; g++)
+        {
+            if (same_grid (&xml_metadata->band[i],
+                &xml_metadata->band[grids->grid_band[g]]))
+                break;
+        }
+        if (g == grids->ngrids)
+            grids->grid_band[grids->ngrids++] = i;
+        grids->band_grid[i] = g;
+    }
+
+    /* Name the grids after the first by their pixel size, unless it is
+       Geographic or the pixel size is taken */
+    for (g = 1; g < grids->ngrids; g++)
+    {
+        bmeta = &xml_metadata->band[grids->grid_band[g]];
+        grids->grid_suffix[g] = g + 1;
+        if (xml_metadata->global.proj_info.proj_type == GCTP_GEO_PROJ ||
+            (int) bmeta->pixel_size[0] <= 0)
+            continue;
+
+        for (k = 1; k < g; k++)
+        {
+            if (grids->grid_suffix[k] == (int) bmeta->pixel_size[0])
+                break;
+        }
+        if (k == g)
+            grids->grid_suffix[g] = (int) bmeta->pixel_size[0];
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  free_espa_band_grids
+
+PURPOSE: Frees the arrays of the grids of the bands.
+
+RETURN VALUE: None
+******************************************************************************/
+void free_espa_band_grids
+(
+    Espa_band_grids_t *grids  /* I/O: grids to be freed */
+)
+{
+    free (grids->band_grid);
+    free (grids->grid_band);
+    free (grids->grid_suffix);
+    grids->band_grid = NULL;
+    grids->grid_band = NULL;
+    grids->grid_suffix = NULL;
+    grids->ngrids = 0;
+}
+
+
+/******************************************************************************
+MODULE:  espa_grid_name
+
+PURPOSE: Determines the name of a grid, or of one of its dimensions, from a
+base name.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           The name doesn't fit
+SUCCESS         Successfully determined the name
+
+NOTES:
+  1. The first grid uses the base name; the others append their suffix
+     (ex. Grid_20).
+******************************************************************************/
+int espa_grid_name
+(
+    const Espa_band_grids_t *grids,  /* I: grids of the bands */
+    int igrid,           /* I: 0-based grid */
+    const char *base,    /* I: base name (ex. Grid, YDim, XDim) */
+    char *name,          /* O: name of the grid */
+    size_t size          /* I: size of name */
+)
+{
+    char FUNC_NAME[] = "espa_grid_name";   /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    int count;               /* number of chars copied in snprintf */
+
+    if (igrid == 0)
+        count = snprintf (name, size, "%s", base);
+    else
+        count = snprintf (name, size, "%s_%d", base,
+            grids->grid_suffix[igrid]);
+    if (count < 0 || count >= size)
+    {
+        sprintf (errmsg, "Overflow of the name of grid %d (%s)", igrid + 1,
+            base);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  reference_band
+
+PURPOSE: Returns the reference band, whose grid the projection corners
+describe.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+n               Index of band1 for Landsat, B02 for Sentinel-2, otherwise
+                the first band
+
+NOTES:
+  1. Follows get_geoloc_info.
+******************************************************************************/
+static int reference_band
+(
+    Espa_internal_meta_t *xml_metadata  /* I: XML metadata structure */
+)
+{
+    int i;                   /* looping variable for the bands */
+
+    for (i = 0; i < xml_metadata->nbands; i++)
+    {
+        if ((!strcmp (xml_metadata->band[i].name, "band1") &&
+             !strncmp (xml_metadata->band[i].product, "L1", 2)) ||
+            (!strcmp (xml_metadata->band[i].name, "B02") &&
+             !strncmp (xml_metadata->band[i].product, "MSIL1C", 2)))
+            return (i);
+    }
+
+    return (0);
+}
+
+
+/******************************************************************************
+MODULE:  get_espa_grid_ul
+
+PURPOSE: Determines the projection coordinates of the UL pixel of a band, for
+the grid origin of the product.
+
+RETURN VALUE: None
+
+NOTES:
+  1. For the reference band these are the UL projection corner of the
+     product.
+******************************************************************************/
+void get_espa_grid_ul
+(
+    Espa_internal_meta_t *xml_metadata, /* I: XML metadata structure */
+    int band,            /* I: band of the grid */
+    double ul_corner[2]  /* O: x, y of the UL pixel of the band, for the grid
+                               origin of the product (its center for CENTER,
+                               its UL edge for UL) */
+)
+{
+    Espa_proj_meta_t *proj_info = &xml_metadata->global.proj_info;
+    Espa_band_meta_t *ref = &xml_metadata->band[reference_band
+        (xml_metadata)];     /* metadata of the reference band */
+    Espa_band_meta_t *bmeta = &xml_metadata->band[band];
+                             /* metadata of the band */
+
+    ul_corner[0] = proj_info->ul_corner[0];
+    ul_corner[1] = proj_info->ul_corner[1];
+    if (!strcmp (proj_info->grid_origin, "CENTER"))
+    {
+        /* Go from the center of the reference pixel to that of the band */
+        ul_corner[0] += 0.5 * (bmeta->pixel_size[0] - ref->pixel_size[0]);
+        ul_corner[1] -= 0.5 * (bmeta->pixel_size[1] - ref->pixel_size[1]);
+    }
+}
+
+
+/******************************************************************************
+MODULE:  get_espa_grid_extent
+
+PURPOSE: Determines the projection coordinates of the outer edges of a band.
+
+RETURN VALUE: None
+******************************************************************************/
+void get_espa_grid_extent
+(
+    Espa_internal_meta_t *xml_metadata, /* I: XML metadata structure */
+    int band,            /* I: band of the grid */
+    double ul_corner[2], /* O: x, y of the UL edge of the band */
+    double lr_corner[2]  /* O: x, y of the LR edge of the band */
+)
+{
+    Espa_band_meta_t *bmeta = &xml_metadata->band[band];
+                             /* metadata of the band */
+
+    get_espa_grid_ul (xml_metadata, band, ul_corner);
+    if (!strcmp (xml_metadata->global.proj_info.grid_origin, "CENTER"))
+    {
+        ul_corner[0] -= 0.5 * bmeta->pixel_size[0];
+        ul_corner[1] += 0.5 * bmeta->pixel_size[1];
+    }
+
+    lr_corner[0] = ul_corner[0] + bmeta->nsamps * bmeta->pixel_size[0];
+    lr_corner[1] = ul_corner[1] - bmeta->nlines * bmeta->pixel_size[1];
+}
@@ -0,0 +1,82 @@
+/*****************************************************************************
+FILE: espa_band_grids.h
+
+PURPOSE: Contains defines, structures, and prototypes for grouping the bands
+of an ESPA product into the grids of the HDF and NetCDF exports, so each
+resolution of a multi-resolution product is exported at its native size.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. Bands with the same pixel size and the same number of lines and samples
+     share a grid.  The grid of the first band is the first grid.
+  2. The first grid uses the base names (Grid, YDim, XDim).  The other grids
+     append the x pixel size to them (ex. Grid_20, YDim_20, XDim_20), or the
+     1-based count of the grid for Geographic projections or when the pixel
+     size is already taken by another grid.
+  3. The bands of all the grids share the UL edge of the reference band (the
+     band whose grid the projection corners describe; see get_geoloc_info).
+*****************************************************************************/
+
+#ifndef ESPA_BAND_GRIDS_H
+#define ESPA_BAND_GRIDS_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include "espa_metadata.h"
+#include "error_handler.h"
+
+/* Grids of the bands of a product */
+typedef struct
+{
+    int ngrids;          /* number of grids */
+    int *band_grid;      /* 0-based grid of each band */
+    int *grid_band;      /* first band of each grid */
+    int *grid_suffix;    /* number appended to the names of each grid; 0 for
+                            the first grid, which uses the base names */
+} Espa_band_grids_t;
+
+/* Prototypes */
+int get_espa_band_grids
+(
+    Espa_internal_meta_t *xml_metadata, /* I: XML metadata structure */
+    Espa_band_grids_t *grids            /* O: grids of the bands */
+);
+
+void free_espa_band_grids
+(
+    Espa_band_grids_t *grids  /* I/O: grids to be freed */
+);
+
+int espa_grid_name
+(
+    const Espa_band_grids_t *grids,  /* I: grids of the bands */
+    int igrid,           /* I: 0-based grid */
+    const char *base,    /* I: base name (ex. Grid, YDim, XDim) */
+    char *name,          /* O: name of the grid */
+    size_t size          /* I: size of name */
+);
+
+void get_espa_grid_ul
+(
+    Espa_internal_meta_t *xml_metadata, /* I: XML metadata structure */
+    int band,            /* I: band of the grid */
+    double ul_corner[2]  /* O: x, y of the UL pixel of the band, for the grid
+                               origin of the product (its center for CENTER,
+                               its UL edge for UL) */
+);
+
+void get_espa_grid_extent
+(
+    Espa_internal_meta_t *xml_metadata, /* I: XML metadata structure */
+    int band,            /* I: band of the grid */
+    double ul_corner[2], /* O: x, y of the UL edge of the band */
+    double lr_corner[2]  /* O: x, y of the LR edge of the band */
+);
+
+#endif
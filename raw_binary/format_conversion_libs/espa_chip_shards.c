@@ -0,0 +1,1962 @@
+/*****************************************************************************
+FILE: espa_chip_shards.c
+
+PURPOSE: Contains functions for cutting training chips from the bands of ESPA
+products and writing them to sharded WebDataset tar or TFRecord files.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The XML metadata format read via this library follows the ESPA internal
+     metadata format found in ESPA Raw Binary Format v1.0.doc.  The schema for
+     the ESPA internal metadata format is available at
+     http://espa.cr.usgs.gov/schema/espa_internal_metadata_v1_0.xsd.
+  2. The chips are taken in batches of at most CHIP_SHARD_BATCH_BYTES of
+     pixels.  The chips of a batch are read by the task pool, and each is
+     written as soon as it and the chips before it are read, so reading and
+     writing overlap and the disks stay busy.
+  3. The products are parsed and their bands opened when their first chip is
+     batched, and closed after their last chip is written, so only a few
+     products are open at a time however many there are.
+  4. The WebDataset shards are POSIX (ustar) tar files.  The NumPy arrays are
+     NPY version 1.0 files in the byte order of the host.
+  5. The TFRecord shards hold a record per chip: the length, the masked
+     CRC-32C of the length, the serialized tf.train.Example, and its masked
+     CRC-32C.  The pixels of the bands are raw bytes in the byte order of the
+     host, for tf.io.decode_raw.
+*****************************************************************************/
+
+#include <unistd.h>
+#include <limits.h>
+#include <libgen.h>
+#include <math.h>
+#include <time.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include "espa_chip_shards.h"
+#include "espa_stac.h"
+#include "espa_band_grids.h"
+#include "espa_band_stack.h"
+#include "espa_band_index.h"
+#include "espa_task_pool.h"
+#include "raw_binary_checksum.h"
+
+/* Size of a tar block, and of the header of a tar member */
+#define CHIP_TAR_BLOCK 512
+
+/* Alignment of the header of an NPY file */
+#define CHIP_NPY_ALIGN 64
+
+/* Mask added to the rotated CRC-32C of the TFRecord records */
+#define CHIP_TFRECORD_MASK 0xa282ead8
+
+/* Growable buffer of bytes */
+typedef struct
+{
+    unsigned char *buf;  /* bytes of the buffer */
+    size_t len;          /* number of bytes used */
+    size_t size;         /* number of bytes allocated */
+    bool failed;         /* did growing the buffer fail? */
+} Chip_bytes_t;
+
+/* Chip center from the centers file */
+typedef struct
+{
+    int product;         /* index of the product of the center */
+    int seq;             /* 0-based line of the center in the file */
+    double x;            /* x of the center, in projection coordinates */
+    double y;            /* y of the center, in projection coordinates */
+} Chip_center_t;
+
+/* Product the chips are cut from */
+typedef struct
+{
+    char *xml_file;      /* XML metadata file of the product */
+    char key[STR_SIZE];  /* name of the product in the keys of the chips */
+    Espa_internal_meta_t meta;  /* metadata of the product */
+    bool loaded;         /* is the metadata parsed and the bands open? */
+    int nbands;          /* number of bands of the chips */
+    int *band_index;     /* index in the metadata of each band */
+    int *fd;             /* file descriptor of each band; -1 for constant
+                            bands */
+    unsigned char (*fill)[8];   /* pad pixel of each band */
+    unsigned char (*constant)[8];  /* pixel of each constant band */
+    size_t chip_bytes;   /* number of bytes of the pixels of a chip */
+    int nlines;          /* number of lines of the bands */
+    int nsamps;          /* number of samples of the bands */
+    double ul[2];        /* x, y of the UL edge of the bands */
+    double pixel_size[2];  /* x, y pixel size of the bands */
+    int ncols;           /* number of chips across the grid of chips */
+    int nchips;          /* number of chips of the product */
+    int first_center;    /* first center of the product in the sorted
+                            centers */
+} Chip_product_t;
+
+/* Chip of a batch */
+typedef struct
+{
+    Chip_product_t *prod;  /* product of the chip */
+    int index;           /* 0-based chip of the product */
+    int line0;           /* line of the UL pixel of the chip in the bands;
+                            negative above the bands */
+    int samp0;           /* sample of the UL pixel of the chip in the bands;
+                            negative left of the bands */
+    unsigned char *pixels;  /* pixels of each band of the chip, one band
+                            after the other */
+    double fill_fraction;  /* fraction of fill pixels of the first band */
+} Chip_task_t;
+
+/* Shards being written */
+typedef struct
+{
+    Chip_shard_options_t *options;  /* chips and shards to be written */
+    char *prefix;        /* prefix of the shard filenames */
+    Chip_task_t *tasks;  /* chips of the current batch */
+    FILE *fp;            /* current shard; NULL between shards */
+    char shard_file[PATH_MAX];  /* name of the current shard */
+    int nshards;         /* number of shards opened */
+    int shard_count;     /* number of chips in the current shard */
+    long nwritten;       /* number of chips written */
+    long ndropped;       /* number of chips dropped for their fill */
+    time_t mtime;        /* modification time of the tar members */
+    Chip_bytes_t json;   /* metadata of the current chip */
+    Chip_bytes_t record; /* NPY header or TFRecord features of the current
+                            chip */
+} Chip_shards_t;
+
+
+/******************************************************************************
+MODULE:  chip_bytes_reserve
+
+PURPOSE: Makes room for more bytes at the end of a buffer.
+
+RETURN VALUE:
+Type = bool
+Value           Description
+-----           -----------
+true            There is room for the bytes
+false           Growing the buffer failed (and is recorded in the buffer)
+******************************************************************************/
+static bool chip_bytes_reserve
+(
+    Chip_bytes_t *b,       /* I/O: buffer */
+    size_t n               /* I: number of bytes to make room for */
+)
+{
+    size_t size;           /* new size of the buffer */
+    unsigned char *buf;    /* grown buffer */
+
+    if (b->failed)
+        return (false);
+    if (b->len + n <= b->size)
+        return (true);
+
+    size = b->size > 0 ? b->size : 4096;
+    while (size < b->len + n)
+        size *= 2;
+    buf = realloc (b->buf, size);
+    if (buf == NULL)
+    {
+        b->failed = true;
+        return (false);
+    }
+    b->buf = buf;
+    b->size = size;
+    return (true);
+}
+
+
+/******************************************************************************
+MODULE:  chip_bytes_add
+
+PURPOSE: Appends bytes to a buffer.
+
+RETURN VALUE: None
+******************************************************************************/
+static void chip_bytes_add
+(
+    Chip_bytes_t *b,       /* I/O: buffer */
+    const void *data,      /* I: bytes to be appended */
+    size_t n               /* I: number of bytes */
+)
+{
+    if (!chip_bytes_reserve (b, n))
+        return;
+    memcpy (b->buf + b->len, data, n);
+    b->len += n;
+}
+
+
+/******************************************************************************
+MODULE:  chip_bytes_printf
+
+PURPOSE: Appends formatted text to a buffer, without its ending NULL.
+
+RETURN VALUE: None
+******************************************************************************/
+static void chip_bytes_printf
+(
+    Chip_bytes_t *b,       /* I/O: buffer */
+    const char *format,    /* I: printf format of the text */
+    ...                    /* I: values of the format */
+)
+{
+    va_list ap;            /* values of the format */
+    int count;             /* number of chars of the text */
+
+    va_start (ap, format);
+    count = vsnprintf (NULL, 0, format, ap);
+    va_end (ap);
+    if (count < 0 || !chip_bytes_reserve (b, count + 1))
+        return;
+
+    va_start (ap, format);
+    vsnprintf ((char *) b->buf + b->len, count + 1, format, ap);
+    va_end (ap);
+    b->len += count;
+}
+
+
+/******************************************************************************
+MODULE:  chip_bytes_string
+
+PURPOSE: Appends a quoted JSON string to a buffer, escaping the quotes,
+backslashes, and control characters.
+
+RETURN VALUE: None
+******************************************************************************/
+static void chip_bytes_string
+(
+    Chip_bytes_t *b,       /* I/O: buffer */
+    const char *str        /* I: string to be appended */
+)
+{
+    const unsigned char *c;   /* current character of the string */
+
+    chip_bytes_add (b, "\"", 1);
+    for (c = (const unsigned char *) str; *c != '\0'; c++)
+    {
+        if (*c == '"' || *c == '\\')
+            chip_bytes_printf (b, "\\%c", *c);
+        else if (*c < 0x20)
+            chip_bytes_printf (b, "\\u%04x", *c);
+        else
+            chip_bytes_add (b, c, 1);
+    }
+    chip_bytes_add (b, "\"", 1);
+}
+
+
+/******************************************************************************
+MODULE:  chip_varint_len
+
+PURPOSE: Returns the number of bytes of a protocol buffers varint.
+
+RETURN VALUE:
+Type = size_t
+Value           Description
+-----           -----------
+1 to 10         Number of bytes of the varint
+******************************************************************************/
+static size_t chip_varint_len
+(
+    uint64_t value         /* I: value of the varint */
+)
+{
+    size_t len = 1;        /* number of bytes */
+
+    while (value >= 0x80)
+    {
+        value >>= 7;
+        len++;
+    }
+    return (len);
+}
+
+
+/******************************************************************************
+MODULE:  chip_bytes_varint
+
+PURPOSE: Appends a protocol buffers varint to a buffer.
+
+RETURN VALUE: None
+******************************************************************************/
+static void chip_bytes_varint
+(
+    Chip_bytes_t *b,       /* I/O: buffer */
+    uint64_t value         /* I: value of the varint */
+)
+{
+    unsigned char byte;    /* current byte of the varint */
+
+    while (value >= 0x80)
+    {
+        byte = (value & 0x7f) | 0x80;
+        chip_bytes_add (b, &byte, 1);
+        value >>= 7;
+    }
+    byte = value;
+    chip_bytes_add (b, &byte, 1);
+}
+
+
+/******************************************************************************
+MODULE:  chip_feature_entry
+
+PURPOSE: Appends the start of an entry of the feature map of a
+tf.train.Example, up to the list of the values of the feature.
+
+RETURN VALUE: None
+
+NOTES:
+  1. The entry is a Features.FeatureEntry (the key, then the Feature) in
+     the feature field of Features.  The Feature holds a single list, of the
+     given field (1 for bytes_list, 3 for int64_list) and length.
+******************************************************************************/
+static void chip_feature_entry
+(
+    Chip_bytes_t *b,       /* I/O: features of the Example */
+    const char *name,      /* I: name of the feature */
+    int list_field,        /* I: field of the list in the Feature */
+    size_t list_len        /* I: number of bytes of the list */
+)
+{
+    size_t name_len = strlen (name);  /* number of bytes of the name */
+    size_t feature_len;    /* number of bytes of the Feature */
+    size_t entry_len;      /* number of bytes of the entry */
+
+    feature_len = 1 + chip_varint_len (list_len) + list_len;
+    entry_len = 1 + chip_varint_len (name_len) + name_len + 1
+        + chip_varint_len (feature_len) + feature_len;
+
+    chip_bytes_varint (b, 0x0a);          /* Features.feature */
+    chip_bytes_varint (b, entry_len);
+    chip_bytes_varint (b, 0x0a);          /* FeatureEntry.key */
+    chip_bytes_varint (b, name_len);
+    chip_bytes_add (b, name, name_len);
+    chip_bytes_varint (b, 0x12);          /* FeatureEntry.value */
+    chip_bytes_varint (b, feature_len);
+    chip_bytes_varint (b, (list_field << 3) | 2);
+    chip_bytes_varint (b, list_len);
+}
+
+
+/******************************************************************************
+MODULE:  chip_bytes_feature
+
+PURPOSE: Appends a feature holding a single string of bytes to the features
+of a tf.train.Example.
+
+RETURN VALUE: None
+******************************************************************************/
+static void chip_bytes_feature
+(
+    Chip_bytes_t *b,       /* I/O: features of the Example */
+    const char *name,      /* I: name of the feature */
+    const void *data,      /* I: bytes of the feature */
+    size_t n               /* I: number of bytes */
+)
+{
+    chip_feature_entry (b, name, 1, 1 + chip_varint_len (n) + n);
+    chip_bytes_varint (b, 0x0a);          /* BytesList.value */
+    chip_bytes_varint (b, n);
+    chip_bytes_add (b, data, n);
+}
+
+
+/******************************************************************************
+MODULE:  chip_int64_feature
+
+PURPOSE: Appends a feature holding a list of integers to the features of a
+tf.train.Example.
+
+RETURN VALUE: None
+
+NOTES:
+  1. The integers are non-negative, and packed.
+******************************************************************************/
+static void chip_int64_feature
+(
+    Chip_bytes_t *b,       /* I/O: features of the Example */
+    const char *name,      /* I: name of the feature */
+    const int64_t *values, /* I: values of the feature */
+    int n                  /* I: number of values */
+)
+{
+    size_t packed_len = 0; /* number of bytes of the packed values */
+    int i;                 /* looping variable for the values */
+
+    for (i = 0; i < n; i++)
+        packed_len += chip_varint_len (values[i]);
+    chip_feature_entry (b, name, 3, 1 + chip_varint_len (packed_len)
+        + packed_len);
+    chip_bytes_varint (b, 0x0a);          /* Int64List.value, packed */
+    chip_bytes_varint (b, packed_len);
+    for (i = 0; i < n; i++)
+        chip_bytes_varint (b, values[i]);
+}
+
+
+/******************************************************************************
+MODULE:  chip_npy_descr
+
+PURPOSE: Returns the NumPy type description of an ESPA data type, in the
+byte order of the host.
+
+RETURN VALUE:
+Type = const char *
+Value           Description
+-----           -----------
+NULL            Unsupported data type
+non-NULL        Type description (ex. <u2)
+******************************************************************************/
+static const char *chip_npy_descr
+(
+    enum Espa_data_type data_type  /* I: ESPA data type */
+)
+{
+    uint16_t one = 1;      /* value whose first byte gives the byte order */
+    bool little = *(unsigned char *) &one == 1;  /* is the host little
+                                                     endian? */
+
+    switch (data_type)
+    {
+        case ESPA_INT8: return ("|i1");
+        case ESPA_UINT8: return ("|u1");
+        case ESPA_INT16: return (little ? "<i2" : ">i2");
+        case ESPA_UINT16: return (little ? "<u2" : ">u2");
+        case ESPA_INT32: return (little ? "<i4" : ">i4");
+        case ESPA_UINT32: return (little ? "<u4" : ">u4");
+        case ESPA_FLOAT32: return (little ? "<f4" : ">f4");
+        case ESPA_FLOAT64: return (little ? "<f8" : ">f8");
+        default: return (NULL);
+    }
+}
+
+
+/******************************************************************************
+MODULE:  chip_fill_pixel
+
+PURPOSE: Determines the pixel which pads the chips of a band beyond its
+edges.
+
+RETURN VALUE: None
+
+NOTES:
+  1. The pad is the fill value of the band, NaN for float bands without
+     one, or 0.
+******************************************************************************/
+static void chip_fill_pixel
+(
+    Espa_band_meta_t *bmeta,   /* I: metadata of the band */
+    void *pixel                /* O: pad pixel; 8 bytes */
+)
+{
+    double value = 0.0;        /* value of the pad pixel */
+
+    if (bmeta->fill_value != ESPA_INT_META_FILL)
+        value = bmeta->fill_value;
+    else if (bmeta->data_type == ESPA_FLOAT32 ||
+        bmeta->data_type == ESPA_FLOAT64)
+        value = NAN;
+
+    switch (bmeta->data_type)
+    {
+        case ESPA_INT8: *(int8_t *) pixel = value; break;
+        case ESPA_UINT8: *(uint8_t *) pixel = value; break;
+        case ESPA_INT16: *(int16_t *) pixel = value; break;
+        case ESPA_UINT16: *(uint16_t *) pixel = value; break;
+        case ESPA_INT32: *(int32_t *) pixel = value; break;
+        case ESPA_UINT32: *(uint32_t *) pixel = value; break;
+        case ESPA_FLOAT32: *(float *) pixel = value; break;
+        default: *(double *) pixel = value; break;
+    }
+}
+
+
+/******************************************************************************
+MODULE:  chip_product_key
+
+PURPOSE: Determines the name of a product in the keys of its chips: its
+product ID, or the name of its XML file without the extension.
+
+RETURN VALUE: None
+
+NOTES:
+  1. The characters other than letters, digits, underscores, and dashes are
+     replaced by underscores, since WebDataset splits the names of the
+     members at the first dot after the last slash.
+  2. A key already taken by an earlier product (ex. products in different
+     directories with the same XML filename) is followed by the 0-based
+     index of the product, so the keys of the chips stay unique.
+******************************************************************************/
+static void chip_product_key
+(
+    Chip_product_t *products,  /* I/O: products */
+    int p                      /* I: product whose key is determined */
+)
+{
+    Chip_product_t *prod = &products[p];  /* product of the key */
+    char path[PATH_MAX];       /* copy of the XML filename for basename */
+    char *ext = NULL;          /* extension of the XML filename */
+    char *c = NULL;            /* current character of the key */
+    size_t len;                /* length of the key */
+    int i;                     /* looping variable for the products */
+
+    if (prod->meta.global.product_id[0] != '\0' &&
+        strcmp (prod->meta.global.product_id, ESPA_STRING_META_FILL))
+        snprintf (prod->key, sizeof (prod->key), "%s",
+            prod->meta.global.product_id);
+    else
+    {
+        snprintf (path, sizeof (path), "%s", prod->xml_file);
+        snprintf (prod->key, sizeof (prod->key), "%s", basename (path));
+        ext = strrchr (prod->key, '.');
+        if (ext != NULL && ext != prod->key)
+            *ext = '\0';
+    }
+
+    for (c = prod->key; *c != '\0'; c++)
+    {
+        if (!((*c >= 'a' && *c <= 'z') || (*c >= 'A' && *c <= 'Z') ||
+            (*c >= '0' && *c <= '9') || *c == '_' || *c == '-'))
+            *c = '_';
+    }
+
+    for (i = 0; i < p; i++)
+    {
+        if (!strcmp (products[i].key, prod->key))
+        {
+            len = strlen (prod->key);
+            snprintf (prod->key + len, sizeof (prod->key) - len, "_%d", p);
+            break;
+        }
+    }
+}
+
+
+/******************************************************************************
+MODULE:  select_chip_bands
+
+PURPOSE: Selects the bands of the chips of a product.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           A named band doesn't exist, is on another grid, or has an
+                unsupported data type
+SUCCESS         Successfully selected the bands
+
+NOTES:
+  1. Without names, the bands on the grid of the first band are selected,
+     and the bands on the other grids are reported and skipped.
+******************************************************************************/
+static int select_chip_bands
+(
+    Chip_product_t *prod,      /* I/O: product whose bands are selected */
+    Chip_shard_options_t *options  /* I: chips and shards to be written */
+)
+{
+    char FUNC_NAME[] = "select_chip_bands";  /* function name */
+    char errmsg[STR_SIZE];     /* error message */
+    char *names = NULL;        /* copy of the names of the bands */
+    char *name = NULL;         /* name of the current band */
+    char *saveptr = NULL;      /* position in names for strtok_r */
+    int band;                  /* index of the current band */
+    int i;                     /* looping variable for the bands */
+    Espa_internal_meta_t *meta = &prod->meta;  /* metadata of the product */
+    Espa_band_grids_t grids;   /* grids of the bands */
+    int status = ERROR;        /* return status */
+
+    if (get_espa_band_grids (meta, &grids) != SUCCESS)
+    {
+        sprintf (errmsg, "Determining the grids of the bands");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    prod->nbands = 0;
+    if (options->bands == NULL)
+    {
+        for (i = 0; i < meta->nbands; i++)
+        {
+            if (grids.band_grid[i] != 0)
+            {
+                sprintf (errmsg, "Skipping band %s, which isn't on the grid "
+                    "of band %s", meta->band[i].name, meta->band[0].name);
+                error_handler (false, FUNC_NAME, errmsg);
+                continue;
+            }
+            prod->band_index[prod->nbands++] = i;
+        }
+    }
+    else
+    {
+        names = strdup (options->bands);
+        if (names == NULL)
+        {
+            sprintf (errmsg, "Allocating memory for the band names");
+            error_handler (true, FUNC_NAME, errmsg);
+            goto cleanup;
+        }
+        for (name = strtok_r (names, ",", &saveptr); name != NULL;
+            name = strtok_r (NULL, ",", &saveptr))
+        {
+            band = espa_find_band (meta, name);
+            if (band < 0)
+            {
+                snprintf (errmsg, sizeof (errmsg), "Band %s isn't in the "
+                    "product %s", name, prod->xml_file);
+                error_handler (true, FUNC_NAME, errmsg);
+                goto cleanup;
+            }
+            if (prod->nbands > 0 && grids.band_grid[band] !=
+                grids.band_grid[prod->band_index[0]])
+            {
+                snprintf (errmsg, sizeof (errmsg), "Band %s isn't on the "
+                    "grid of band %s", name,
+                    meta->band[prod->band_index[0]].name);
+                error_handler (true, FUNC_NAME, errmsg);
+                goto cleanup;
+            }
+            if (prod->nbands == meta->nbands)
+            {
+                sprintf (errmsg, "More bands named than in the product");
+                error_handler (true, FUNC_NAME, errmsg);
+                goto cleanup;
+            }
+            prod->band_index[prod->nbands++] = band;
+        }
+        if (prod->nbands == 0)
+        {
+            sprintf (errmsg, "No bands were named");
+            error_handler (true, FUNC_NAME, errmsg);
+            goto cleanup;
+        }
+    }
+
+    for (i = 0; i < prod->nbands; i++)
+    {
+        if (chip_npy_descr (meta->band[prod->band_index[i]].data_type)
+            == NULL)
+        {
+            sprintf (errmsg, "Unsupported data type for band: %s",
+                meta->band[prod->band_index[i]].name);
+            error_handler (true, FUNC_NAME, errmsg);
+            goto cleanup;
+        }
+    }
+    status = SUCCESS;
+
+cleanup:
+    free (names);
+    free_espa_band_grids (&grids);
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  release_chip_product
+
+PURPOSE: Closes the bands of a product and frees its metadata.
+
+RETURN VALUE: None
+******************************************************************************/
+static void release_chip_product
+(
+    Chip_product_t *prod       /* I/O: product to be released */
+)
+{
+    int i;                     /* looping variable for the bands */
+
+    if (!prod->loaded)
+        return;
+
+    if (prod->fd != NULL)
+    {
+        for (i = 0; i < prod->nbands; i++)
+        {
+            if (prod->fd[i] != -1)
+                close_raw_binary_fd (prod->fd[i]);
+        }
+    }
+    free (prod->band_index);
+    free (prod->fd);
+    free (prod->fill);
+    free (prod->constant);
+    prod->band_index = NULL;
+    prod->fd = NULL;
+    prod->fill = NULL;
+    prod->constant = NULL;
+    free_metadata (&prod->meta);
+    prod->loaded = false;
+}
+
+
+/******************************************************************************
+MODULE:  load_chip_product
+
+PURPOSE: Parses the metadata of a product, selects the bands of its chips,
+and opens them.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error parsing the metadata or opening the bands
+SUCCESS         Successfully loaded the product
+
+NOTES:
+  1. For a grid of chips, the number of chips of the product is determined
+     here.  The last chips of each row and column of the grid are the ones
+     reaching the right and bottom edges of the bands.
+  2. The product is released on error.
+******************************************************************************/
+static int load_chip_product
+(
+    Chip_product_t *products,  /* I/O: products */
+    int p,                     /* I: product to be loaded */
+    Chip_shard_options_t *options, /* I: chips and shards to be written */
+    bool grid                  /* I: are the chips on a grid? */
+)
+{
+    char FUNC_NAME[] = "load_chip_product";  /* function name */
+    char errmsg[STR_SIZE];     /* error message */
+    char path[PATH_MAX];       /* absolute name of a band file */
+    double lr[2];              /* x, y of the LR edge of the bands */
+    int stride;                /* lines and samples between the chips */
+    int nrows;                 /* number of rows of the grid of chips */
+    int i;                     /* looping variable for the bands */
+    Chip_product_t *prod = &products[p];  /* product to be loaded */
+    Espa_band_meta_t *bmeta = NULL;  /* metadata of the current band */
+
+    init_metadata_struct (&prod->meta);
+    if (validate_and_parse_metadata (prod->xml_file, &prod->meta) != SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+    prod->loaded = true;
+    chip_product_key (products, p);
+
+    prod->band_index = malloc (prod->meta.nbands * sizeof (int));
+    prod->fd = malloc (prod->meta.nbands * sizeof (int));
+    prod->fill = malloc (prod->meta.nbands * sizeof (*prod->fill));
+    prod->constant = malloc (prod->meta.nbands * sizeof (*prod->constant));
+    if (prod->band_index == NULL || prod->fd == NULL || prod->fill == NULL
+        || prod->constant == NULL)
+    {
+        sprintf (errmsg, "Allocating memory for the bands");
+        error_handler (true, FUNC_NAME, errmsg);
+        release_chip_product (prod);
+        return (ERROR);
+    }
+    for (i = 0; i < prod->meta.nbands; i++)
+        prod->fd[i] = -1;
+
+    if (select_chip_bands (prod, options) != SUCCESS)
+    {
+        snprintf (errmsg, sizeof (errmsg), "Selecting the bands of %s",
+            prod->xml_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        release_chip_product (prod);
+        return (ERROR);
+    }
+
+    prod->chip_bytes = 0;
+    for (i = 0; i < prod->nbands; i++)
+    {
+        bmeta = &prod->meta.band[prod->band_index[i]];
+        chip_fill_pixel (bmeta, prod->fill[i]);
+        prod->chip_bytes += (size_t) options->chip_size * options->chip_size
+            * espa_data_type_size (bmeta->data_type);
+
+        if (is_constant_band (bmeta))
+        {
+            if (espa_constant_pixel (bmeta, prod->constant[i]) != SUCCESS)
+            {
+                sprintf (errmsg, "Determining the pixel of constant band: "
+                    "%s", bmeta->name);
+                error_handler (true, FUNC_NAME, errmsg);
+                release_chip_product (prod);
+                return (ERROR);
+            }
+            continue;
+        }
+
+        if (espa_product_href (prod->xml_file, NULL, NULL, bmeta->file_name,
+            path, sizeof (path)) != SUCCESS)
+        {  /* Error messages already written */
+            release_chip_product (prod);
+            return (ERROR);
+        }
+        prod->fd[i] = open_raw_binary_band_fd (path, bmeta->file_offset,
+            false);
+        if (prod->fd[i] == -1)
+        {
+            snprintf (errmsg, sizeof (errmsg), "Opening the raw binary file "
+                "of band %s: %s", bmeta->name, path);
+            error_handler (true, FUNC_NAME, errmsg);
+            release_chip_product (prod);
+            return (ERROR);
+        }
+    }
+
+    bmeta = &prod->meta.band[prod->band_index[0]];
+    prod->nlines = bmeta->nlines;
+    prod->nsamps = bmeta->nsamps;
+    prod->pixel_size[0] = bmeta->pixel_size[0];
+    prod->pixel_size[1] = bmeta->pixel_size[1];
+    get_espa_grid_extent (&prod->meta, prod->band_index[0], prod->ul, lr);
+
+    if (grid)
+    {
+        stride = options->stride > 0 ? options->stride : options->chip_size;
+        nrows = prod->nlines <= options->chip_size ? 1
+            : (prod->nlines - options->chip_size + stride - 1) / stride + 1;
+        prod->ncols = prod->nsamps <= options->chip_size ? 1
+            : (prod->nsamps - options->chip_size + stride - 1) / stride + 1;
+        if ((long) nrows * prod->ncols > INT_MAX)
+        {
+            snprintf (errmsg, sizeof (errmsg), "Too many chips in the grid "
+                "of %s", prod->xml_file);
+            error_handler (true, FUNC_NAME, errmsg);
+            release_chip_product (prod);
+            return (ERROR);
+        }
+        prod->nchips = nrows * prod->ncols;
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  chip_window
+
+PURPOSE: Determines the position of a chip of a product in its bands.
+
+RETURN VALUE:
+Type = bool
+Value           Description
+-----           -----------
+true            The chip overlaps the bands
+false           The chip is entirely outside the bands
+
+NOTES:
+  1. A center in projection coordinates is in the pixel holding it, and the
+     chip is centered on that pixel (one pixel up and left of the center for
+     even chip sizes).
+******************************************************************************/
+static bool chip_window
+(
+    Chip_product_t *prod,      /* I: product of the chip */
+    Chip_shard_options_t *options, /* I: chips and shards to be written */
+    Chip_center_t *centers,    /* I: sorted chip centers; NULL for a grid */
+    int index,                 /* I: 0-based chip of the product */
+    int *line0,                /* O: line of the UL pixel of the chip */
+    int *samp0                 /* O: sample of the UL pixel of the chip */
+)
+{
+    int chip = options->chip_size;  /* lines and samples of a chip */
+    int stride;                /* lines and samples between the chips */
+    Chip_center_t *center = NULL;   /* center of the chip */
+    double line;               /* line of the center */
+    double samp;               /* sample of the center */
+
+    if (centers == NULL)
+    {
+        stride = options->stride > 0 ? options->stride : chip;
+        *line0 = index / prod->ncols * stride;
+        *samp0 = index % prod->ncols * stride;
+        if (*line0 + chip > prod->nlines && prod->nlines > chip)
+            *line0 = prod->nlines - chip;
+        if (*samp0 + chip > prod->nsamps && prod->nsamps > chip)
+            *samp0 = prod->nsamps - chip;
+        return (true);
+    }
+
+    center = &centers[prod->first_center + index];
+    line = floor ((prod->ul[1] - center->y) / prod->pixel_size[1]);
+    samp = floor ((center->x - prod->ul[0]) / prod->pixel_size[0]);
+    if (line < -chip || line > prod->nlines + chip ||
+        samp < -chip || samp > prod->nsamps + chip)
+        return (false);
+
+    *line0 = (int) line - chip / 2;
+    *samp0 = (int) samp - chip / 2;
+    return (*line0 + chip > 0 && *line0 < prod->nlines &&
+        *samp0 + chip > 0 && *samp0 < prod->nsamps);
+}
+
+
+/******************************************************************************
+MODULE:  read_chip
+
+PURPOSE: Reads the pixels of each band of a chip of the batch, and counts
+the fill pixels of its first band.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error reading the chip
+SUCCESS         Successfully read the chip
+
+NOTES:
+  1. Run by espa_parallel_for_ordered for each chip of the batch.
+  2. Only the part of the chip over the bands is read; the rest is padded
+     with the fill pixel of each band.
+******************************************************************************/
+static int read_chip
+(
+    void *arg,                 /* I/O: shards being written */
+    int index,                 /* I: chip of the batch */
+    int worker                 /* I: worker reading the chip */
+)
+{
+    char FUNC_NAME[] = "read_chip";  /* function name */
+    char errmsg[STR_SIZE];     /* error message */
+    Chip_shards_t *shards = arg;   /* shards being written */
+    Chip_task_t *task = &shards->tasks[index];  /* chip to be read */
+    Chip_product_t *prod = task->prod;  /* product of the chip */
+    int chip = shards->options->chip_size;  /* lines and samples of a chip */
+    int l0, l1;                /* lines of the chip over the bands */
+    int s0, s1;                /* samples of the chip over the bands */
+    int size;                  /* number of bytes per pixel */
+    int i;                     /* looping variable for the bands */
+    int line;                  /* looping variable for the lines */
+    long nfill;                /* number of fill pixels of the first band */
+    long pix;                  /* looping variable for the pixels */
+    bool inside;               /* is the chip entirely over the bands? */
+    unsigned char *dst = NULL; /* pixels of the current band */
+    unsigned char *window = NULL;  /* part of the chip over the bands */
+    Espa_band_meta_t *bmeta = NULL;  /* metadata of the current band */
+    int status = ERROR;        /* return status */
+
+    l0 = task->line0 > 0 ? task->line0 : 0;
+    l1 = task->line0 + chip < prod->nlines ? task->line0 + chip
+        : prod->nlines;
+    s0 = task->samp0 > 0 ? task->samp0 : 0;
+    s1 = task->samp0 + chip < prod->nsamps ? task->samp0 + chip
+        : prod->nsamps;
+    inside = l1 - l0 == chip && s1 - s0 == chip;
+
+    task->pixels = malloc (prod->chip_bytes);
+    if (!inside)
+        window = malloc ((size_t) chip * chip * sizeof (double));
+    if (task->pixels == NULL || (!inside && window == NULL))
+    {
+        sprintf (errmsg, "Allocating memory for the chip");
+        error_handler (true, FUNC_NAME, errmsg);
+        goto cleanup;
+    }
+
+    dst = task->pixels;
+    for (i = 0; i < prod->nbands; i++)
+    {
+        bmeta = &prod->meta.band[prod->band_index[i]];
+        size = espa_data_type_size (bmeta->data_type);
+        if (!inside)
+        {
+            read_raw_binary_constant (chip, chip, size, prod->fill[i], dst);
+            if (l1 <= l0 || s1 <= s0)
+            {
+                dst += (size_t) chip * chip * size;
+                continue;
+            }
+        }
+
+        if (prod->fd[i] == -1)
+            read_raw_binary_constant (l1 - l0, s1 - s0, size,
+                prod->constant[i], inside ? dst : window);
+        else if (read_raw_binary_window (prod->fd[i], prod->nsamps, l0,
+            l1 - l0, s0, s1 - s0, size, inside ? dst : window) != SUCCESS)
+        {
+            snprintf (errmsg, sizeof (errmsg), "Reading lines %d to %d of "
+                "band %s of %s", l0, l1 - 1, bmeta->name, prod->xml_file);
+            error_handler (true, FUNC_NAME, errmsg);
+            goto cleanup;
+        }
+
+        if (!inside)
+        {
+            for (line = l0; line < l1; line++)
+                memcpy (dst + ((size_t) (line - task->line0) * chip
+                    + (s0 - task->samp0)) * size, window + (size_t)
+                    (line - l0) * (s1 - s0) * size, (size_t) (s1 - s0)
+                    * size);
+        }
+        dst += (size_t) chip * chip * size;
+    }
+
+    /* Fill of the first band; the padding beyond its edges is fill */
+    bmeta = &prod->meta.band[prod->band_index[0]];
+    size = espa_data_type_size (bmeta->data_type);
+    if (bmeta->fill_value != ESPA_INT_META_FILL)
+    {
+        nfill = 0;
+        for (pix = 0; pix < (long) chip * chip; pix++)
+        {
+            if (!memcmp (task->pixels + pix * size, prod->fill[0], size))
+                nfill++;
+        }
+    }
+    else
+    {
+        nfill = (long) chip * chip;
+        if (l1 > l0 && s1 > s0)
+            nfill -= (long) (l1 - l0) * (s1 - s0);
+    }
+    task->fill_fraction = (double) nfill / ((double) chip * chip);
+    status = SUCCESS;
+
+cleanup:
+    free (window);
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  chip_metadata
+
+PURPOSE: Builds the JSON metadata of a chip.
+
+RETURN VALUE: None
+
+NOTES:
+  1. The transform is the GDAL geotransform of the chip, in the projection
+     coordinates of the product.
+******************************************************************************/
+static void chip_metadata
+(
+    Chip_shards_t *shards,     /* I/O: shards being written */
+    Chip_task_t *task,         /* I: chip */
+    const char *key            /* I: key of the chip */
+)
+{
+    Chip_product_t *prod = task->prod;  /* product of the chip */
+    Espa_global_meta_t *gmeta = &prod->meta.global;  /* global metadata */
+    Espa_band_meta_t *bmeta = NULL;  /* metadata of the current band */
+    Chip_bytes_t *b = &shards->json;  /* metadata being built */
+    int chip = shards->options->chip_size;  /* lines and samples of a chip */
+    double ulx;                /* x of the UL edge of the chip */
+    double uly;                /* y of the UL edge of the chip */
+    int i;                     /* looping variable for the bands */
+
+    ulx = prod->ul[0] + task->samp0 * prod->pixel_size[0];
+    uly = prod->ul[1] - task->line0 * prod->pixel_size[1];
+
+    b->len = 0;
+    chip_bytes_printf (b, "{\"key\": ");
+    chip_bytes_string (b, key);
+    chip_bytes_printf (b, ", \"product\": ");
+    chip_bytes_string (b, prod->key);
+    chip_bytes_printf (b, ", \"xml\": ");
+    chip_bytes_string (b, prod->xml_file);
+    chip_bytes_printf (b, ", \"satellite\": ");
+    chip_bytes_string (b, gmeta->satellite);
+    chip_bytes_printf (b, ", \"acquisition_date\": ");
+    chip_bytes_string (b, gmeta->acquisition_date);
+    chip_bytes_printf (b, ", \"line\": %d, \"sample\": %d, \"lines\": %d, "
+        "\"samples\": %d, \"center\": [%.6f, %.6f], \"transform\": [%.6f, "
+        "%.10g, 0, %.6f, 0, %.10g], \"fill_fraction\": %.6f, \"bands\": [",
+        task->line0, task->samp0, chip, chip,
+        ulx + 0.5 * chip * prod->pixel_size[0],
+        uly - 0.5 * chip * prod->pixel_size[1], ulx, prod->pixel_size[0],
+        uly, -prod->pixel_size[1], task->fill_fraction);
+    for (i = 0; i < prod->nbands; i++)
+    {
+        bmeta = &prod->meta.band[prod->band_index[i]];
+        chip_bytes_printf (b, "%s{\"name\": ", i > 0 ? ", " : "");
+        chip_bytes_string (b, bmeta->name);
+        chip_bytes_printf (b, ", \"dtype\": \"%s\"",
+            chip_npy_descr (bmeta->data_type));
+        if (bmeta->fill_value != ESPA_INT_META_FILL)
+            chip_bytes_printf (b, ", \"fill_value\": %ld",
+                bmeta->fill_value);
+        if (bmeta->scale_factor != ESPA_FLOAT_META_FILL)
+            chip_bytes_printf (b, ", \"scale_factor\": %.9g",
+                bmeta->scale_factor);
+        if (bmeta->add_offset != ESPA_FLOAT_META_FILL)
+            chip_bytes_printf (b, ", \"add_offset\": %.9g",
+                bmeta->add_offset);
+        chip_bytes_printf (b, "}");
+    }
+    chip_bytes_printf (b, "]}\n");
+}
+
+
+/******************************************************************************
+MODULE:  write_tar_member
+
+PURPOSE: Writes a file to the current tar shard: its ustar header, its
+bytes, and the padding to the next block.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           The name is too long or writing failed
+SUCCESS         Successfully wrote the member
+
+NOTES:
+  1. The bytes are given in two parts (ex. the header and the pixels of an
+     NPY file), so they don't need to be copied together.
+******************************************************************************/
+static int write_tar_member
+(
+    Chip_shards_t *shards,     /* I/O: shards being written */
+    const char *name,          /* I: name of the member */
+    const void *head,          /* I: first bytes of the member */
+    size_t head_len,           /* I: number of bytes of head */
+    const void *data,          /* I: rest of the bytes of the member */
+    size_t data_len            /* I: number of bytes of data */
+)
+{
+    char FUNC_NAME[] = "write_tar_member";  /* function name */
+    char errmsg[STR_SIZE];     /* error message */
+    unsigned char header[CHIP_TAR_BLOCK];  /* header of the member */
+    unsigned char pad[CHIP_TAR_BLOCK];  /* padding of the member */
+    size_t nbytes = head_len + data_len;  /* size of the member */
+    unsigned int sum = 0;      /* checksum of the header */
+    int i;                     /* looping variable for the header bytes */
+
+    if (strlen (name) >= 100)
+    {
+        snprintf (errmsg, sizeof (errmsg), "Name of the tar member is too "
+            "long: %s", name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    memset (header, 0, sizeof (header));
+    memcpy (header, name, strlen (name));                 /* name */
+    memcpy (header + 100, "0000644", 7);                  /* mode */
+    memcpy (header + 108, "0000000", 7);                  /* uid */
+    memcpy (header + 116, "0000000", 7);                  /* gid */
+    snprintf ((char *) header + 124, 12, "%011llo",       /* size */
+        (unsigned long long) nbytes);
+    snprintf ((char *) header + 136, 12, "%011llo",       /* mtime */
+        (unsigned long long) shards->mtime);
+    memset (header + 148, ' ', 8);                        /* checksum */
+    header[156] = '0';                                    /* regular file */
+    memcpy (header + 257, "ustar", 6);                    /* magic */
+    memcpy (header + 263, "00", 2);                       /* version */
+    for (i = 0; i < CHIP_TAR_BLOCK; i++)
+        sum += header[i];
+    snprintf ((char *) header + 148, 8, "%06o", sum);
+    header[155] = ' ';
+
+    memset (pad, 0, sizeof (pad));
+    if (fwrite (header, 1, sizeof (header), shards->fp) != sizeof (header)
+        || (head_len > 0 && fwrite (head, 1, head_len, shards->fp)
+        != head_len) || (data_len > 0 && fwrite (data, 1, data_len,
+        shards->fp) != data_len) || (nbytes % CHIP_TAR_BLOCK != 0 &&
+        fwrite (pad, 1, CHIP_TAR_BLOCK - nbytes % CHIP_TAR_BLOCK, shards->fp)
+        != CHIP_TAR_BLOCK - nbytes % CHIP_TAR_BLOCK))
+    {
+        snprintf (errmsg, sizeof (errmsg), "Writing %s to the shard: %s",
+            name, shards->shard_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  write_webdataset_chip
+
+PURPOSE: Writes a chip to the current WebDataset shard: its metadata, then
+an NPY file per band.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the chip
+SUCCESS         Successfully wrote the chip
+******************************************************************************/
+static int write_webdataset_chip
+(
+    Chip_shards_t *shards,     /* I/O: shards being written */
+    Chip_task_t *task,         /* I: chip */
+    const char *key            /* I: key of the chip */
+)
+{
+    char FUNC_NAME[] = "write_webdataset_chip";  /* function name */
+    char errmsg[STR_SIZE];     /* error message */
+    char name[STR_SIZE];       /* name of the current member */
+    Chip_product_t *prod = task->prod;  /* product of the chip */
+    Chip_bytes_t *npy = &shards->record;  /* header of the NPY files */
+    int chip = shards->options->chip_size;  /* lines and samples of a chip */
+    size_t nbytes;             /* number of bytes of the pixels of a band */
+    size_t dict_start;         /* start of the header dictionary */
+    uint16_t header_len;       /* length of the header dictionary */
+    unsigned char *src = task->pixels;  /* pixels of the current band */
+    int count;                 /* number of chars copied in snprintf */
+    int i;                     /* looping variable for the bands */
+    Espa_band_meta_t *bmeta = NULL;  /* metadata of the current band */
+
+    snprintf (name, sizeof (name), "%s.json", key);
+    if (shards->json.failed || write_tar_member (shards, name,
+        shards->json.buf, shards->json.len, NULL, 0) != SUCCESS)
+        return (ERROR);
+
+    for (i = 0; i < prod->nbands; i++)
+    {
+        bmeta = &prod->meta.band[prod->band_index[i]];
+        nbytes = (size_t) chip * chip * espa_data_type_size (bmeta->data_type);
+
+        /* Magic, version 1.0, and the header length, then the dictionary
+           padded with spaces and a newline to the alignment */
+        npy->len = 0;
+        chip_bytes_add (npy, "\x93NUMPY\x01\x00\x00\x00", 10);
+        dict_start = npy->len;
+        chip_bytes_printf (npy, "{'descr': '%s', 'fortran_order': False, "
+            "'shape': (%d, %d), }", chip_npy_descr (bmeta->data_type), chip,
+            chip);
+        while ((npy->len + 1) % CHIP_NPY_ALIGN != 0)
+            chip_bytes_add (npy, " ", 1);
+        chip_bytes_add (npy, "\n", 1);
+        if (npy->failed)
+        {
+            sprintf (errmsg, "Allocating memory for the NPY header");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+        header_len = npy->len - dict_start;
+        npy->buf[8] = header_len & 0xff;
+        npy->buf[9] = header_len >> 8;
+
+        count = snprintf (name, sizeof (name), "%s.%s.npy", key,
+            bmeta->name);
+        if (count < 0 || count >= sizeof (name))
+        {
+            sprintf (errmsg, "Overflow of name string");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+        if (write_tar_member (shards, name, npy->buf, npy->len, src, nbytes)
+            != SUCCESS)
+            return (ERROR);
+        src += nbytes;
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  chip_masked_crc
+
+PURPOSE: Returns the masked CRC-32C of bytes, as TFRecord files record the
+checksums of the records.
+
+RETURN VALUE:
+Type = uint32_t
+Value           Description
+-----           -----------
+n               Masked CRC-32C of the bytes
+******************************************************************************/
+static uint32_t chip_masked_crc
+(
+    const void *head,          /* I: first bytes */
+    size_t head_len,           /* I: number of bytes of head */
+    const void *data,          /* I: rest of the bytes; NULL if none */
+    size_t data_len            /* I: number of bytes of data */
+)
+{
+    Rb_checksum_t sum;         /* CRC-32C of the bytes */
+    uint32_t crc;              /* final CRC-32C */
+
+    init_raw_binary_checksum (&sum);
+    update_raw_binary_checksum (&sum, head, head_len);
+    if (data != NULL)
+        update_raw_binary_checksum (&sum, data, data_len);
+    crc = ~sum.crc;
+    return (((crc >> 15) | (crc << 17)) + CHIP_TFRECORD_MASK);
+}
+
+
+/******************************************************************************
+MODULE:  write_tfrecord_chip
+
+PURPOSE: Writes a chip to the current TFRecord shard, as a record holding a
+tf.train.Example.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the chip
+SUCCESS         Successfully wrote the chip
+
+NOTES:
+  1. The features are key and metadata (bytes), shape (int64 lines and
+     samples), and image/band (bytes) for each band.
+******************************************************************************/
+static int write_tfrecord_chip
+(
+    Chip_shards_t *shards,     /* I/O: shards being written */
+    Chip_task_t *task,         /* I: chip */
+    const char *key            /* I: key of the chip */
+)
+{
+    char FUNC_NAME[] = "write_tfrecord_chip";  /* function name */
+    char errmsg[STR_SIZE];     /* error message */
+    char name[STR_SIZE];       /* name of the current feature */
+    Chip_product_t *prod = task->prod;  /* product of the chip */
+    Chip_bytes_t *features = &shards->record;  /* features of the Example */
+    int chip = shards->options->chip_size;  /* lines and samples of a chip */
+    int64_t shape[2];          /* shape of the bands */
+    unsigned char head[16];    /* tag and length of the Example.features */
+    size_t head_len = 0;       /* number of bytes of head */
+    unsigned char len_bytes[12];  /* length of the record and its CRC */
+    uint64_t len;              /* length of the Example */
+    uint32_t crc;              /* masked CRC-32C of the Example */
+    size_t nbytes;             /* number of bytes of the pixels of a band */
+    unsigned char *src = task->pixels;  /* pixels of the current band */
+    int i;                     /* looping variable for the bands and bytes */
+    Espa_band_meta_t *bmeta = NULL;  /* metadata of the current band */
+
+    features->len = 0;
+    chip_bytes_feature (features, "key", key, strlen (key));
+    chip_bytes_feature (features, "metadata", shards->json.buf,
+        shards->json.len);
+    shape[0] = chip;
+    shape[1] = chip;
+    chip_int64_feature (features, "shape", shape, 2);
+    for (i = 0; i < prod->nbands; i++)
+    {
+        bmeta = &prod->meta.band[prod->band_index[i]];
+        nbytes = (size_t) chip * chip * espa_data_type_size (bmeta->data_type);
+        snprintf (name, sizeof (name), "image/%s", bmeta->name);
+        chip_bytes_feature (features, name, src, nbytes);
+        src += nbytes;
+    }
+    if (features->failed || shards->json.failed)
+    {
+        sprintf (errmsg, "Allocating memory for the record");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Example.features tag and length */
+    len = features->len;
+    head[head_len++] = 0x0a;
+    while (len >= 0x80)
+    {
+        head[head_len++] = (len & 0x7f) | 0x80;
+        len >>= 7;
+    }
+    head[head_len++] = len;
+
+    /* Little endian length of the Example and its masked CRC */
+    len = head_len + features->len;
+    for (i = 0; i < 8; i++)
+        len_bytes[i] = (len >> (8 * i)) & 0xff;
+    crc = chip_masked_crc (len_bytes, 8, NULL, 0);
+    for (i = 0; i < 4; i++)
+        len_bytes[8 + i] = (crc >> (8 * i)) & 0xff;
+    crc = chip_masked_crc (head, head_len, features->buf, features->len);
+    for (i = 0; i < 4; i++)
+        head[head_len + i] = (crc >> (8 * i)) & 0xff;
+
+    if (fwrite (len_bytes, 1, 12, shards->fp) != 12 ||
+        fwrite (head, 1, head_len, shards->fp) != head_len ||
+        fwrite (features->buf, 1, features->len, shards->fp)
+        != features->len ||
+        fwrite (head + head_len, 1, 4, shards->fp) != 4)
+    {
+        snprintf (errmsg, sizeof (errmsg), "Writing chip %s to the shard: "
+            "%s", key, shards->shard_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  close_chip_shard
+
+PURPOSE: Finishes and closes the current shard.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing or closing the shard
+SUCCESS         Successfully closed the shard
+
+NOTES:
+  1. A tar shard ends with two blocks of zeros.
+******************************************************************************/
+static int close_chip_shard
+(
+    Chip_shards_t *shards      /* I/O: shards being written */
+)
+{
+    char FUNC_NAME[] = "close_chip_shard";  /* function name */
+    char errmsg[STR_SIZE];     /* error message */
+    unsigned char end[2 * CHIP_TAR_BLOCK];  /* end of a tar file */
+    int status = SUCCESS;      /* return status */
+
+    if (shards->fp == NULL)
+        return (SUCCESS);
+
+    if (shards->options->format == CHIP_SHARDS_WEBDATASET)
+    {
+        memset (end, 0, sizeof (end));
+        if (fwrite (end, 1, sizeof (end), shards->fp) != sizeof (end))
+            status = ERROR;
+    }
+    if (fclose (shards->fp) != 0)
+        status = ERROR;
+    shards->fp = NULL;
+    shards->shard_count = 0;
+
+    if (status != SUCCESS)
+    {
+        snprintf (errmsg, sizeof (errmsg), "Closing the shard: %s",
+            shards->shard_file);
+        error_handler (true, FUNC_NAME, errmsg);
+    }
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  write_chip
+
+PURPOSE: Writes a chip of the batch to the shards, once it and the chips
+before it are read.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error reading or writing the chip
+SUCCESS         Successfully wrote or dropped the chip
+
+NOTES:
+  1. Run by espa_parallel_for_ordered for each chip of the batch, in the
+     order of the chips.
+  2. Chips with more fill than the largest fraction kept are dropped.
+  3. A shard is opened for the first chip written to it, and closed once
+     it holds the number of chips per shard.
+******************************************************************************/
+static int write_chip
+(
+    void *arg,                 /* I/O: shards being written */
+    int index,                 /* I: chip of the batch */
+    int status                 /* I: status of reading the chip */
+)
+{
+    char FUNC_NAME[] = "write_chip";  /* function name */
+    char errmsg[STR_SIZE];     /* error message */
+    char key[STR_SIZE];        /* key of the chip */
+    Chip_shards_t *shards = arg;   /* shards being written */
+    Chip_task_t *task = &shards->tasks[index];  /* chip to be written */
+    int count;                 /* number of chars copied in snprintf */
+
+    if (status != SUCCESS)
+        return (ERROR);
+
+    if (task->fill_fraction > shards->options->max_fill)
+    {
+        shards->ndropped++;
+        status = SUCCESS;
+        goto cleanup;
+    }
+    status = ERROR;
+
+    if (shards->fp == NULL)
+    {
+        count = snprintf (shards->shard_file, sizeof (shards->shard_file),
+            "%s-%06d.%s", shards->prefix, shards->nshards,
+            shards->options->format == CHIP_SHARDS_WEBDATASET ? "tar"
+            : "tfrecord");
+        if (count < 0 || count >= sizeof (shards->shard_file))
+        {
+            sprintf (errmsg, "Overflow of shard_file string");
+            error_handler (true, FUNC_NAME, errmsg);
+            goto cleanup;
+        }
+        shards->fp = fopen (shards->shard_file, "wb");
+        if (shards->fp == NULL)
+        {
+            snprintf (errmsg, sizeof (errmsg), "Creating the shard: %s",
+                shards->shard_file);
+            error_handler (true, FUNC_NAME, errmsg);
+            goto cleanup;
+        }
+        printf ("Shard %s\n", shards->shard_file);
+        shards->nshards++;
+    }
+
+    snprintf (key, sizeof (key), "%s_%06d", task->prod->key, task->index);
+    chip_metadata (shards, task, key);
+    if (shards->options->format == CHIP_SHARDS_WEBDATASET)
+        status = write_webdataset_chip (shards, task, key);
+    else
+        status = write_tfrecord_chip (shards, task, key);
+    if (status != SUCCESS)
+        goto cleanup;
+
+    shards->nwritten++;
+    shards->shard_count++;
+    if (shards->shard_count == shards->options->shard_chips)
+        status = close_chip_shard (shards);
+
+cleanup:
+    free (task->pixels);
+    task->pixels = NULL;
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  compare_chip_centers
+
+PURPOSE: Orders the chip centers by product, then by their order in the
+centers file.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+< 0             The first center comes first
+> 0             The second center comes first
+******************************************************************************/
+static int compare_chip_centers
+(
+    const void *a,             /* I: first center */
+    const void *b              /* I: second center */
+)
+{
+    const Chip_center_t *ca = a;  /* first center */
+    const Chip_center_t *cb = b;  /* second center */
+
+    if (ca->product != cb->product)
+        return (ca->product < cb->product ? -1 : 1);
+    return (ca->seq < cb->seq ? -1 : ca->seq > cb->seq);
+}
+
+
+/******************************************************************************
+MODULE:  add_chip_product
+
+PURPOSE: Finds a product by its XML file, adding it to the products if it
+isn't one of them.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+-1              Error allocating memory for the product
+n               0-based index of the product
+******************************************************************************/
+static int add_chip_product
+(
+    const char *xml_file,      /* I: XML metadata file of the product */
+    Chip_product_t **products, /* I/O: products */
+    int *nproducts,            /* I/O: number of products */
+    int *max_products,         /* I/O: number of products allocated */
+    int hint                   /* I: product to check first; -1 for none */
+)
+{
+    char FUNC_NAME[] = "add_chip_product";  /* function name */
+    char errmsg[STR_SIZE];     /* error message */
+    Chip_product_t *grown = NULL;  /* grown products */
+    Chip_product_t *prod = NULL;   /* added product */
+    int i;                     /* looping variable for the products */
+
+    if (hint >= 0 && !strcmp ((*products)[hint].xml_file, xml_file))
+        return (hint);
+    for (i = 0; i < *nproducts; i++)
+    {
+        if (!strcmp ((*products)[i].xml_file, xml_file))
+            return (i);
+    }
+
+    if (*nproducts == *max_products)
+    {
+        *max_products = *max_products > 0 ? 2 * *max_products : 16;
+        grown = realloc (*products, *max_products * sizeof (Chip_product_t));
+        if (grown == NULL)
+        {
+            sprintf (errmsg, "Allocating memory for the products");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (-1);
+        }
+        *products = grown;
+    }
+
+    prod = &(*products)[*nproducts];
+    memset (prod, 0, sizeof (Chip_product_t));
+    prod->xml_file = strdup (xml_file);
+    if (prod->xml_file == NULL)
+    {
+        sprintf (errmsg, "Allocating memory for the products");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (-1);
+    }
+    return ((*nproducts)++);
+}
+
+
+/******************************************************************************
+MODULE:  read_chip_centers
+
+PURPOSE: Reads the chip centers file, adding the products it names, and
+sorts the centers by product.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error reading the centers
+SUCCESS         Successfully read the centers
+
+NOTES:
+  1. Each line holds the XML metadata file of the product, and the x and y
+     of the center in the projection coordinates of the product, separated
+     by spaces, tabs, or commas.  Empty lines and lines starting with # are
+     skipped.
+  2. The centers of a product keep their order in the file, and the number
+     of chips of each product is its number of centers.
+******************************************************************************/
+static int read_chip_centers
+(
+    char *centers_file,        /* I: file of chip centers */
+    Chip_product_t **products, /* I/O: products */
+    int *nproducts,            /* I/O: number of products */
+    int *max_products,         /* I/O: number of products allocated */
+    Chip_center_t **centers,   /* O: sorted centers */
+    int *ncenters              /* O: number of centers */
+)
+{
+    char FUNC_NAME[] = "read_chip_centers";  /* function name */
+    char errmsg[STR_SIZE];     /* error message */
+    char *line = NULL;         /* current line of the file */
+    size_t line_size = 0;      /* size of the line buffer */
+    char *name = NULL;         /* XML filename of the current line */
+    char *cptr = NULL;         /* current position in the line */
+    char *end = NULL;          /* end of a number of the line */
+    int max_centers = 0;       /* number of centers allocated */
+    int nline = 0;             /* number of lines read */
+    int product = -1;          /* product of the current center */
+    int i;                     /* looping variable for the centers */
+    Chip_center_t *grown = NULL;   /* grown centers */
+    Chip_center_t *center = NULL;  /* current center */
+    FILE *fp = NULL;           /* centers file */
+    int status = ERROR;        /* return status */
+
+    *centers = NULL;
+    *ncenters = 0;
+    fp = fopen (centers_file, "r");
+    if (fp == NULL)
+    {
+        snprintf (errmsg, sizeof (errmsg), "Opening the centers file: %s",
+            centers_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    while (getline (&line, &line_size, fp) > 0)
+    {
+        nline++;
+        name = line + strspn (line, " \t");
+        if (*name == '#' || *name == '\n' || *name == '\r' || *name == '\0')
+            continue;
+        cptr = name + strcspn (name, " \t,");
+        if (*cptr == '\0')
+            goto bad_line;
+        *cptr++ = '\0';
+
+        if (*ncenters == max_centers)
+        {
+            max_centers = max_centers > 0 ? 2 * max_centers : 1024;
+            grown = realloc (*centers, max_centers * sizeof (Chip_center_t));
+            if (grown == NULL)
+            {
+                sprintf (errmsg, "Allocating memory for the centers");
+                error_handler (true, FUNC_NAME, errmsg);
+                goto cleanup;
+            }
+            *centers = grown;
+        }
+        center = &(*centers)[*ncenters];
+
+        cptr += strspn (cptr, " \t,");
+        center->x = strtod (cptr, &end);
+        if (end == cptr)
+            goto bad_line;
+        cptr = end + strspn (end, " \t,");
+        center->y = strtod (cptr, &end);
+        if (end == cptr)
+            goto bad_line;
+
+        product = add_chip_product (name, products, nproducts, max_products,
+            product);
+        if (product < 0)
+            goto cleanup;
+        center->product = product;
+        center->seq = (*ncenters)++;
+    }
+
+    qsort (*centers, *ncenters, sizeof (Chip_center_t),
+        compare_chip_centers);
+    for (i = *ncenters - 1; i >= 0; i--)
+    {
+        (*products)[(*centers)[i].product].first_center = i;
+        (*products)[(*centers)[i].product].nchips++;
+    }
+    status = SUCCESS;
+    goto cleanup;
+
+bad_line:
+    snprintf (errmsg, sizeof (errmsg), "Line %d of the centers file %s "
+        "isn't an XML file followed by x and y", nline, centers_file);
+    error_handler (true, FUNC_NAME, errmsg);
+
+cleanup:
+    free (line);
+    fclose (fp);
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  parse_chip_shard_format
+
+PURPOSE: Converts the name of a format to the format of the shards.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Unknown format
+SUCCESS         Successfully converted the name
+******************************************************************************/
+int parse_chip_shard_format
+(
+    char *name,                    /* I: name of the format (webdataset or
+                                         tfrecord) */
+    Chip_shard_format_t *format    /* O: format of the shards */
+)
+{
+    char FUNC_NAME[] = "parse_chip_shard_format";  /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+
+    if (!strcmp (name, "webdataset"))
+        *format = CHIP_SHARDS_WEBDATASET;
+    else if (!strcmp (name, "tfrecord"))
+        *format = CHIP_SHARDS_TFRECORD;
+    else
+    {
+        snprintf (errmsg, sizeof (errmsg), "Unknown format %s.  Valid "
+            "formats are webdataset and tfrecord.", name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  write_espa_chip_shards
+
+PURPOSE: Cuts the chips of the products, at the chip centers or on a grid,
+and writes them to the shards.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error reading the products or writing the shards
+SUCCESS         Successfully wrote the shards
+
+NOTES:
+  1. The products are taken in order: the XML files given, then the others
+     named by the centers file.  With a centers file, the products without
+     centers have no chips.
+  2. Centers whose chip is entirely outside the bands are reported and
+     skipped.
+  3. Existing shards of the same names are overwritten.
+******************************************************************************/
+int write_espa_chip_shards
+(
+    int nxml,              /* I: number of input XML metadata files */
+    char **xml_files,      /* I: input ESPA XML metadata filenames */
+    char *centers_file,    /* I: file of chip centers (XML filename, x, and
+                                 y in projection coordinates on each line);
+                                 NULL for a grid of chips over each
+                                 product */
+    char *shard_prefix,    /* I: prefix of the shard filenames, which are
+                                 numbered (ex. prefix-000000.tar) */
+    Chip_shard_options_t *options  /* I: chips and shards to be written */
+)
+{
+    char FUNC_NAME[] = "write_espa_chip_shards";  /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    Chip_product_t *products = NULL;  /* products of the chips */
+    int nproducts = 0;          /* number of products */
+    int max_products = 0;       /* number of products allocated */
+    Chip_center_t *centers = NULL;  /* sorted chip centers */
+    int ncenters = 0;           /* number of chip centers */
+    Chip_shards_t shards;       /* shards being written */
+    Chip_task_t *task = NULL;   /* current chip of the batch */
+    Chip_product_t *prod = NULL;   /* current product */
+    int max_tasks = 0;          /* number of chips allocated in the batch */
+    int ntasks;                 /* number of chips of the batch */
+    size_t batch_bytes;         /* number of bytes of pixels of the batch */
+    int p = 0;                  /* product of the next chip */
+    int index = 0;              /* next chip of the product */
+    long nskipped = 0;          /* number of centers outside the bands */
+    int i;                      /* looping variable */
+    int status = ERROR;         /* return status */
+
+    if (options->chip_size < 1 || options->stride < 0 ||
+        options->shard_chips < 1)
+    {
+        sprintf (errmsg, "Invalid chips: chips of %d, stride of %d, %d "
+            "chips per shard", options->chip_size, options->stride,
+            options->shard_chips);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    memset (&shards, 0, sizeof (shards));
+    shards.options = options;
+    shards.prefix = shard_prefix;
+    shards.mtime = time (NULL);
+
+    for (i = 0; i < nxml; i++)
+    {
+        if (add_chip_product (xml_files[i], &products, &nproducts,
+            &max_products, -1) < 0)
+            goto cleanup;
+    }
+    if (centers_file != NULL && read_chip_centers (centers_file, &products,
+        &nproducts, &max_products, &centers, &ncenters) != SUCCESS)
+        goto cleanup;
+
+    while (1)
+    {
+        /* Batch the next chips, loading their products */
+        ntasks = 0;
+        batch_bytes = 0;
+        while (p < nproducts && (ntasks == 0 ||
+            batch_bytes < CHIP_SHARD_BATCH_BYTES))
+        {
+            prod = &products[p];
+            if (!prod->loaded && index == 0 &&
+                (centers_file == NULL || prod->nchips > 0))
+            {
+                printf ("Product %s\n", prod->xml_file);
+                if (load_chip_product (products, p, options,
+                    centers_file == NULL) != SUCCESS)
+                {
+                    snprintf (errmsg, sizeof (errmsg), "Loading the "
+                        "product: %s", prod->xml_file);
+                    error_handler (true, FUNC_NAME, errmsg);
+                    goto cleanup;
+                }
+            }
+            if (index >= prod->nchips)
+            {
+                p++;
+                index = 0;
+                continue;
+            }
+
+            if (ntasks == max_tasks)
+            {
+                max_tasks = max_tasks > 0 ? 2 * max_tasks : 64;
+                task = realloc (shards.tasks, max_tasks
+                    * sizeof (Chip_task_t));
+                if (task == NULL)
+                {
+                    sprintf (errmsg, "Allocating memory for the batch");
+                    error_handler (true, FUNC_NAME, errmsg);
+                    goto cleanup;
+                }
+                shards.tasks = task;
+            }
+            task = &shards.tasks[ntasks];
+            memset (task, 0, sizeof (Chip_task_t));
+            task->prod = prod;
+            task->index = index;
+            if (!chip_window (prod, options, centers, index, &task->line0,
+                &task->samp0))
+            {
+                snprintf (errmsg, sizeof (errmsg), "Skipping the chip "
+                    "centered at %f, %f, which is outside the bands of %s",
+                    centers[prod->first_center + index].x,
+                    centers[prod->first_center + index].y, prod->xml_file);
+                error_handler (false, FUNC_NAME, errmsg);
+                nskipped++;
+                index++;
+                continue;
+            }
+            batch_bytes += prod->chip_bytes;
+            ntasks++;
+            index++;
+        }
+        if (ntasks == 0)
+            break;
+
+        /* Read the chips in parallel and write them in order */
+        status = espa_parallel_for_ordered (ntasks, 0, read_chip,
+            write_chip, &shards);
+        for (i = 0; i < ntasks; i++)
+        {
+            free (shards.tasks[i].pixels);
+            shards.tasks[i].pixels = NULL;
+        }
+        if (status != SUCCESS)
+        {
+            sprintf (errmsg, "Writing the chips to the shards");
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+            goto cleanup;
+        }
+        status = ERROR;
+
+        /* Release the products whose chips are all written */
+        for (i = 0; i < p; i++)
+            release_chip_product (&products[i]);
+    }
+
+    if (close_chip_shard (&shards) != SUCCESS)
+        goto cleanup;
+    printf ("Wrote %ld chips to %d shards (%ld dropped for fill, %ld "
+        "outside the bands)\n", shards.nwritten, shards.nshards,
+        shards.ndropped, nskipped);
+    status = SUCCESS;
+
+cleanup:
+    if (shards.fp != NULL)
+        fclose (shards.fp);
+    for (i = 0; i < nproducts; i++)
+    {
+        release_chip_product (&products[i]);
+        free (products[i].xml_file);
+    }
+    free (products);
+    free (centers);
+    free (shards.tasks);
+    free (shards.json.buf);
+    free (shards.record.buf);
+    return (status);
+}
@@ -0,0 +1,93 @@
+/*****************************************************************************
+FILE: espa_chip_shards.h
+
+PURPOSE: Contains defines and prototypes for cutting training chips from the
+bands of ESPA products, at a list of chip centers or on a regular grid, and
+writing them to sharded WebDataset tar or TFRecord files for the data
+loaders of machine learning pipelines.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. A chip holds chip size lines by chip size samples of each of its bands,
+     padded with the fill value of the band beyond its edges.  The bands of
+     a chip are on one grid (see espa_band_grids.h).
+  2. The windows of the chips are read through read_raw_binary_window, so
+     plain, stacked, block-compressed, and tiled bands are read alike, and
+     only the blocks or tiles under a chip are read.
+  3. The chips are read in parallel, across the products, and written in
+     order, so the shards are the same for any number of threads.
+  4. Each chip carries JSON metadata with its product, position, and
+     georeferencing (a GDAL geotransform of the chip) and the attributes of
+     its bands.
+*****************************************************************************/
+
+#ifndef ESPA_CHIP_SHARDS_H
+#define ESPA_CHIP_SHARDS_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include "error_handler.h"
+#include "espa_metadata.h"
+#include "parse_metadata.h"
+#include "raw_binary_io.h"
+
+/* Formats of the shards */
+typedef enum {
+    CHIP_SHARDS_WEBDATASET, /* tar files with a sample per chip: the
+                               metadata (key.json) and a NumPy array per
+                               band (key.band.npy) */
+    CHIP_SHARDS_TFRECORD    /* TFRecord files with a tf.train.Example per
+                               chip: key, metadata, shape, and the raw
+                               pixels of each band (image/band) */
+} Chip_shard_format_t;
+
+/* Default chips and shards */
+#define DEFAULT_CHIP_SHARD_SIZE 256
+#define DEFAULT_CHIP_SHARD_CHIPS 1000
+
+/* Most bytes of pixels read ahead of the shard writer */
+#define CHIP_SHARD_BATCH_BYTES (64 * 1024 * 1024)
+
+/* Chips and shards to be written */
+typedef struct
+{
+    Chip_shard_format_t format;  /* format of the shards */
+    int chip_size;       /* number of lines and samples of a chip */
+    int stride;          /* number of lines and samples between the chips of
+                            the grid; 0 for the chip size */
+    int shard_chips;     /* number of chips per shard */
+    double max_fill;     /* largest fraction of fill (or padding) pixels of
+                            the first band of a chip which is kept */
+    char *bands;         /* comma-separated names of the bands of the
+                            chips; NULL for the bands on the grid of the
+                            first band */
+} Chip_shard_options_t;
+
+/* Prototypes */
+int parse_chip_shard_format
+(
+    char *name,                    /* I: name of the format (webdataset or
+                                         tfrecord) */
+    Chip_shard_format_t *format    /* O: format of the shards */
+);
+
+int write_espa_chip_shards
+(
+    int nxml,              /* I: number of input XML metadata files */
+    char **xml_files,      /* I: input ESPA XML metadata filenames */
+    char *centers_file,    /* I: file of chip centers (XML filename, x, and
+                                 y in projection coordinates on each line);
+                                 NULL for a grid of chips over each
+                                 product */
+    char *shard_prefix,    /* I: prefix of the shard filenames, which are
+                                 numbered (ex. prefix-000000.tar) */
+    Chip_shard_options_t *options  /* I: chips and shards to be written */
+);
+
+#endif
@@ -0,0 +1,1163 @@
+/*****************************************************************************
+FILE: espa_export_fanout.c
+
+PURPOSE: Contains functions for the export fan-out, which reads each block of
+the ESPA raw binary bands once and feeds it to the writers of several export
+formats at the same time.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The caller's thread reads the bands through the band stack and copies
+     each block into one of a fixed pool of shared blocks.  The shared block
+     is queued to every sink, and returns to the pool once the last sink is
+     done with it.  The reader waits for a free block, so the slowest sink
+     sets the pace and the memory is bounded by the size of the pool.
+  2. A sink which fails stops writing and the reader stops reading; the
+     remaining blocks are drained so none of the threads are left waiting.
+  3. Each block is only queued to the sinks which need its band.
+  4. A band reader fills the shared block directly, so there's no copy.
+*****************************************************************************/
+
+#include <unistd.h>
+#include "espa_export_fanout.h"
+#include "raw_binary_writer.h"
+#include "envi_header.h"
+#include "espa_trace.h"
+
+/* Block of lines of a band, shared by all the sinks */
+typedef struct
+{
+    int band;                  /* index of the band in the metadata */
+    int refs;                  /* number of sinks still using the block */
+    void *buf;                 /* pixels of the block */
+    Espa_band_block_t block;   /* block handed to the sinks; band_buf points
+                                  at buf */
+} Export_block_t;
+
+struct Export_fanout;
+
+/* Bounded queue of the blocks for one sink, along with its thread */
+typedef struct
+{
+    Espa_export_sink_t *sink;  /* sink being fed */
+    struct Export_fanout *fanout;  /* fan-out the queue belongs to */
+    Export_block_t **entry;    /* ring of queued blocks; a NULL entry ends
+                                  the output */
+    int capacity;              /* number of entries in the ring */
+    int head;                  /* next entry to be taken by the sink */
+    int count;                 /* number of entries queued */
+    bool needs_band;           /* does the sink need the band being read? */
+    bool failed;               /* did the sink fail? */
+    bool thread_started;       /* was the thread of the sink started? */
+    pthread_t thread;          /* thread of the sink */
+} Export_queue_t;
+
+/* State of the fan-out */
+typedef struct Export_fanout
+{
+    Espa_internal_meta_t *xml_metadata; /* XML metadata structure */
+    Espa_export_reader_t *reader;  /* reader of the bands; NULL to read the
+                                  raw binary files */
+    int nblocks;               /* number of shared blocks in the pool */
+    Export_block_t *blocks;    /* pool of shared blocks */
+    Export_block_t **free_blocks;  /* blocks not used by any sink */
+    int nfree;                 /* number of free blocks */
+    int nqueues;               /* number of sinks */
+    Export_queue_t *queues;    /* queue of each sink */
+    bool failed;               /* has any sink failed? */
+    pthread_mutex_t mutex;     /* protects the queues and the free blocks */
+    pthread_cond_t cond;       /* signals changes in the queues and the free
+                                  blocks */
+} Export_fanout_t;
+
+/* State of the raw binary export sink */
+typedef struct
+{
+    char xml_file[STR_SIZE];   /* output XML metadata filename */
+    Raw_binary_writer_t *writer;  /* writer of the current band */
+    char (*checksum)[STR_SIZE];   /* checksum of each band written */
+    Espa_band_stats_t *stats;     /* statistics of each band written */
+} Raw_export_t;
+
+
+/******************************************************************************
+MODULE: release_export_block
+
+PURPOSE: Releases a sink's reference to a shared block, returning the block to
+the pool once no sink is using it.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+static void release_export_block
+(
+    Export_fanout_t *fanout,   /* I/O: fan-out */
+    Export_block_t *blk        /* I: block the sink is done with */
+)
+{
+    pthread_mutex_lock (&fanout->mutex);
+    blk->refs--;
+    if (blk->refs == 0)
+    {
+        fanout->free_blocks[fanout->nfree++] = blk;
+        pthread_cond_broadcast (&fanout->cond);
+    }
+    pthread_mutex_unlock (&fanout->mutex);
+}
+
+
+/******************************************************************************
+MODULE: export_sink_thread
+
+PURPOSE: Thread of a sink, which writes the queued blocks until the end of
+the output is queued.
+
+RETURN VALUE:
+Type = void *
+Value        Description
+-----        -----------
+NULL         Always
+
+NOTES:
+  1. The band is begun with its first block and ended with its last block.
+  2. Once the sink fails, the remaining blocks are released without being
+     written.
+******************************************************************************/
+static void *export_sink_thread
+(
+    void *arg                  /* I: queue of the sink */
+)
+{
+    char FUNC_NAME[] = "export_sink_thread";  /* function name */
+    char errmsg[STR_SIZE];     /* error message */
+    Export_queue_t *queue = arg;  /* queue of the sink */
+    Export_fanout_t *fanout = queue->fanout;  /* fan-out */
+    Espa_export_sink_t *sink = queue->sink;   /* sink being fed */
+    Espa_internal_meta_t *xml_metadata = fanout->xml_metadata;
+    Export_block_t *blk;       /* current block */
+    Espa_band_block_t *block;  /* lines of the current block */
+    int status;                /* status of writing the block */
+    Espa_trace_span_t span;    /* timing of writing the block */
+
+    while (1)
+    {
+        /* Take the next block */
+        pthread_mutex_lock (&fanout->mutex);
+        while (queue->count == 0)
+            pthread_cond_wait (&fanout->cond, &fanout->mutex);
+        blk = queue->entry[queue->head];
+        queue->head = (queue->head + 1) % queue->capacity;
+        queue->count--;
+        pthread_mutex_unlock (&fanout->mutex);
+
+        if (blk == NULL)
+            break;   /* end of the output */
+
+        if (queue->failed)
+        {
+            release_export_block (fanout, blk);
+            continue;
+        }
+
+        block = &blk->block;
+        status = SUCCESS;
+        span = espa_trace_begin ("write_block",
+            xml_metadata->band[blk->band].name);
+        if (block->line0 == 0 &&
+            sink->begin_band (sink->state, xml_metadata, blk->band)
+            != SUCCESS)
+            status = ERROR;
+        else if (sink->write_block (sink->state, xml_metadata, blk->band,
+            block) != SUCCESS)
+            status = ERROR;
+        else if (block->line0 + block->nlines ==
+            xml_metadata->band[blk->band].nlines &&
+            sink->end_band (sink->state, xml_metadata, blk->band) != SUCCESS)
+            status = ERROR;
+        espa_trace_end (&span);
+
+        if (status != SUCCESS)
+        {
+            sprintf (errmsg, "Writing lines %d-%d of band %s to the %s "
+                "output", block->line0, block->line0 + block->nlines - 1,
+                xml_metadata->band[blk->band].name, sink->name);
+            error_handler (true, FUNC_NAME, errmsg);
+
+            /* Stop the reader */
+            pthread_mutex_lock (&fanout->mutex);
+            queue->failed = true;
+            fanout->failed = true;
+            pthread_cond_broadcast (&fanout->cond);
+            pthread_mutex_unlock (&fanout->mutex);
+        }
+
+        release_export_block (fanout, blk);
+    }
+
+    return NULL;
+}
+
+
+/******************************************************************************
+MODULE: queue_export_block
+
+PURPOSE: Queues a shared block to every sink which needs its band, or the
+end of the output to every sink.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. The queues hold every block of the pool plus the end of the output, so
+     they never fill up.
+******************************************************************************/
+static void queue_export_block
+(
+    Export_fanout_t *fanout,   /* I/O: fan-out */
+    Export_block_t *blk        /* I: block to be queued; NULL for the end of
+                                     the output */
+)
+{
+    int i;                     /* looping variable for the queues */
+    Export_queue_t *queue;     /* current queue */
+
+    pthread_mutex_lock (&fanout->mutex);
+    for (i = 0; i < fanout->nqueues; i++)
+    {
+        queue = &fanout->queues[i];
+        if (!queue->thread_started || (blk != NULL && !queue->needs_band))
+            continue;
+        queue->entry[(queue->head + queue->count) % queue->capacity] = blk;
+        queue->count++;
+    }
+    pthread_cond_broadcast (&fanout->cond);
+    pthread_mutex_unlock (&fanout->mutex);
+}
+
+
+/******************************************************************************
+MODULE: take_export_block
+
+PURPOSE: Takes a free shared block from the pool, waiting for one if needed.
+
+RETURN VALUE:
+Type = Export_block_t *
+Value        Description
+-----        -----------
+NULL         A sink has failed, so no more blocks are read
+blk          Free block
+
+NOTES:
+******************************************************************************/
+static Export_block_t *take_export_block
+(
+    Export_fanout_t *fanout    /* I/O: fan-out */
+)
+{
+    Export_block_t *blk = NULL;  /* free block */
+
+    pthread_mutex_lock (&fanout->mutex);
+    while (fanout->nfree == 0 && !fanout->failed)
+        pthread_cond_wait (&fanout->cond, &fanout->mutex);
+    if (!fanout->failed)
+        blk = fanout->free_blocks[--fanout->nfree];
+    pthread_mutex_unlock (&fanout->mutex);
+
+    return blk;
+}
+
+
+/******************************************************************************
+MODULE: share_export_block
+
+PURPOSE: Queues a filled shared block to every sink which needs its band.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+static void share_export_block
+(
+    Export_fanout_t *fanout,   /* I/O: fan-out */
+    Export_block_t *blk        /* I: filled block */
+)
+{
+    int i;                     /* looping variable for the queues */
+    int nsinks;                /* number of sinks using the block */
+
+    for (i = 0, nsinks = 0; i < fanout->nqueues; i++)
+        if (fanout->queues[i].thread_started &&
+            fanout->queues[i].needs_band)
+            nsinks++;
+    blk->refs = nsinks;
+    queue_export_block (fanout, blk);
+}
+
+
+/******************************************************************************
+MODULE: read_export_band
+
+PURPOSE: Reads a band a block of lines at a time and queues each block to
+every sink.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error reading the band, or a sink failed
+SUCCESS         Successfully queued all the blocks of the band
+
+NOTES:
+******************************************************************************/
+static int read_export_band
+(
+    Export_fanout_t *fanout,   /* I/O: fan-out */
+    int band,                  /* I: index of the band */
+    int block_lines            /* I: number of lines per block */
+)
+{
+    char FUNC_NAME[] = "read_export_band";  /* function name */
+    char errmsg[STR_SIZE];     /* error message */
+    size_t nbytes;             /* number of bytes in the block */
+    Espa_band_meta_t *bmeta = &fanout->xml_metadata->band[band];
+    Espa_band_stack_t *stack = NULL;  /* reader of the band */
+    Espa_band_block_t *block = NULL;  /* current block of lines */
+    Export_block_t *blk = NULL;       /* shared copy of the block */
+    ESPA_TRACE_SCOPE (trace, "export_band", bmeta->name);  /* timing */
+
+    stack = open_band_stack (fanout->xml_metadata, 1, &band, block_lines, 0);
+    if (stack == NULL)
+    {
+        sprintf (errmsg, "Opening the band stack for band %s", bmeta->name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    while (1)
+    {
+        if (get_band_stack_block (stack, &block) != SUCCESS)
+        {
+            sprintf (errmsg, "Reading image data from the raw binary file");
+            error_handler (true, FUNC_NAME, errmsg);
+            close_band_stack (stack);
+            return (ERROR);
+        }
+        if (block == NULL)
+            break;   /* all lines have been queued */
+
+        /* Wait for a free block, unless a sink has failed */
+        blk = take_export_block (fanout);
+        if (blk == NULL)
+        {
+            close_band_stack (stack);
+            return (ERROR);
+        }
+
+        /* Copy the block, since the band stack reuses its buffer for the
+           blocks read ahead */
+        nbytes = (size_t) block->nlines * block->nsamps *
+            stack->size[0];
+        memcpy (blk->buf, block->band_buf[0], nbytes);
+        blk->band = band;
+        blk->block.line0 = block->line0;
+        blk->block.nlines = block->nlines;
+        blk->block.samp0 = block->samp0;
+        blk->block.nsamps = block->nsamps;
+        blk->block.line_stride = block->nsamps;
+        share_export_block (fanout, blk);
+    }
+
+    close_band_stack (stack);
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE: read_export_band_lines
+
+PURPOSE: Reads a band through the band reader a block of lines at a time and
+queues each block to every sink.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error reading the band, or a sink failed
+SUCCESS         Successfully queued all the blocks of the band
+
+NOTES:
+  1. The lines are read straight into the shared block.
+******************************************************************************/
+static int read_export_band_lines
+(
+    Export_fanout_t *fanout,   /* I/O: fan-out */
+    int band,                  /* I: index of the band */
+    int block_lines            /* I: number of lines per block */
+)
+{
+    char FUNC_NAME[] = "read_export_band_lines";  /* function name */
+    char errmsg[STR_SIZE];     /* error message */
+    int line;                  /* first line of the current block */
+    int nlines;                /* number of lines in the current block */
+    Espa_export_reader_t *reader = fanout->reader;  /* reader of the band */
+    Espa_band_meta_t *bmeta = &fanout->xml_metadata->band[band];
+    Export_block_t *blk = NULL;       /* shared block being filled */
+    ESPA_TRACE_SCOPE (trace, "export_band", bmeta->name);  /* timing */
+
+    for (line = 0; line < bmeta->nlines; line += block_lines)
+    {
+        /* Wait for a free block, unless a sink has failed */
+        blk = take_export_block (fanout);
+        if (blk == NULL)
+            return (ERROR);
+
+        nlines = bmeta->nlines - line;
+        if (nlines > block_lines)
+            nlines = block_lines;
+        if (reader->read_lines (reader->state, fanout->xml_metadata, band,
+            line, nlines, blk->buf) != SUCCESS)
+        {
+            sprintf (errmsg, "Reading lines %d to %d of band %s", line,
+                line + nlines - 1, bmeta->name);
+            error_handler (true, FUNC_NAME, errmsg);
+
+            /* Return the block to the pool */
+            pthread_mutex_lock (&fanout->mutex);
+            fanout->free_blocks[fanout->nfree++] = blk;
+            pthread_mutex_unlock (&fanout->mutex);
+            return (ERROR);
+        }
+
+        blk->band = band;
+        blk->block.line0 = line;
+        blk->block.nlines = nlines;
+        blk->block.samp0 = 0;
+        blk->block.nsamps = bmeta->nsamps;
+        blk->block.line_stride = bmeta->nsamps;
+        share_export_block (fanout, blk);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE: export_sink_needs_band
+
+PURPOSE: Determines whether a sink writes a band.
+
+RETURN VALUE:
+Type = bool
+Value        Description
+-----        -----------
+true         The sink writes the band
+false        The sink skips the band
+
+NOTES:
+******************************************************************************/
+static bool export_sink_needs_band
+(
+    Espa_export_sink_t *sink,  /* I: export sink */
+    Espa_internal_meta_t *xml_metadata, /* I: XML metadata structure */
+    int band                   /* I: index of the band */
+)
+{
+    if (sink->needs_band == NULL)
+        return true;
+    return (sink->needs_band (sink->state, xml_metadata, band));
+}
+
+
+/******************************************************************************
+MODULE: export_espa_fanout
+
+PURPOSE: Reads each block of the raw binary bands once and feeds it to all of
+the export sinks, each writing its format in its own thread.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error reading the bands or in any of the sinks
+SUCCESS         Successfully wrote all the bands to all the sinks
+
+NOTES:
+  1. See export_espa_fanout_reader.
+******************************************************************************/
+int export_espa_fanout
+(
+    Espa_internal_meta_t *xml_metadata, /* I: XML metadata structure */
+    int nsinks,                /* I: number of export sinks */
+    Espa_export_sink_t *sinks, /* I: export sinks; each is finished on
+                                     return */
+    int block_lines,           /* I: number of lines per block; use
+                                     RB_PREFETCH_DEFAULT_LINES if not known */
+    int queue_blocks           /* I: number of blocks in flight between the
+                                     reader and the sinks */
+)
+{
+    return (export_espa_fanout_reader (xml_metadata, NULL, nsinks, sinks,
+        block_lines, queue_blocks));
+}
+
+
+/******************************************************************************
+MODULE: export_espa_fanout_reader
+
+PURPOSE: Reads each block of the bands once, from the raw binary files or
+through a band reader, and feeds it to all of the export sinks, each writing
+its format in its own thread.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error reading the bands or in any of the sinks
+SUCCESS         Successfully wrote all the bands to all the sinks
+
+NOTES:
+  1. All the bands are read in band order, so the sinks see them in band
+     order.  Constant bands are synthesized by the band stack, when reading
+     the raw binary files.
+  2. At most queue_blocks blocks are in flight.  Each is sized for the
+     largest block of the bands.  With a memory budget, fewer blocks are
+     queued if they don't all fit (see espa_mem_fit_count).
+  3. Every sink is finished before returning, whether or not the export
+     succeeded.
+  4. Only the bands needed by a sink are read, and only the sinks which
+     need a band are started.
+******************************************************************************/
+int export_espa_fanout_reader
+(
+    Espa_internal_meta_t *xml_metadata, /* I: XML metadata structure */
+    Espa_export_reader_t *reader,  /* I: reader of the bands; NULL to read
+                                         the raw binary files */
+    int nsinks,                /* I: number of export sinks */
+    Espa_export_sink_t *sinks, /* I: export sinks; each is finished on
+                                     return */
+    int block_lines,           /* I: number of lines per block */
+    int queue_blocks           /* I: number of blocks in flight between the
+                                     reader and the sinks */
+)
+{
+    char FUNC_NAME[] = "export_espa_fanout_reader";  /* function name */
+    char errmsg[STR_SIZE];     /* error message */
+    int i;                     /* looping variable */
+    int j;                     /* looping variable for the sinks */
+    int status = SUCCESS;      /* return status */
+    int lines;                 /* number of lines in a full block of the
+                                  band */
+    size_t nbytes;             /* number of bytes in a block of the band */
+    size_t block_bytes = 0;    /* number of bytes in the largest block */
+    Espa_band_meta_t *bmeta;   /* metadata of the current band */
+    Export_fanout_t fanout;    /* state of the fan-out */
+    Export_queue_t *queue;     /* current queue */
+    bool needed;               /* does any sink need the band? */
+    bool complete;             /* were all the bands written by every
+                                  sink? */
+
+    memset (&fanout, 0, sizeof (fanout));
+    fanout.xml_metadata = xml_metadata;
+    fanout.reader = reader;
+    fanout.nqueues = nsinks;
+    fanout.nblocks = queue_blocks;
+    pthread_mutex_init (&fanout.mutex, NULL);
+    pthread_cond_init (&fanout.cond, NULL);
+
+    if (nsinks < 1 || queue_blocks < 1 || block_lines < 1)
+    {
+        sprintf (errmsg, "At least one sink, block of lines, and queued "
+            "block are required");
+        error_handler (true, FUNC_NAME, errmsg);
+        status = ERROR;
+        goto finish;
+    }
+
+    /* Size the pool of shared blocks for the largest block */
+    for (i = 0; i < xml_metadata->nbands; i++)
+    {
+        bmeta = &xml_metadata->band[i];
+        lines = block_lines < bmeta->nlines ? block_lines : bmeta->nlines;
+        nbytes = (size_t) lines * bmeta->nsamps *
+            espa_data_type_size (bmeta->data_type);
+        if (nbytes > block_bytes)
+            block_bytes = nbytes;
+    }
+    queue_blocks = espa_mem_fit_count (block_bytes, queue_blocks, 1);
+    fanout.nblocks = queue_blocks;
+
+    fanout.blocks = calloc (queue_blocks, sizeof (Export_block_t));
+    fanout.free_blocks = calloc (queue_blocks, sizeof (Export_block_t *));
+    fanout.queues = calloc (nsinks, sizeof (Export_queue_t));
+    if (fanout.blocks == NULL || fanout.free_blocks == NULL ||
+        fanout.queues == NULL)
+    {
+        sprintf (errmsg, "Allocating the export queues");
+        error_handler (true, FUNC_NAME, errmsg);
+        status = ERROR;
+        goto finish;
+    }
+
+    for (i = 0; i < queue_blocks; i++)
+    {
+        fanout.blocks[i].buf = espa_trace_malloc (block_bytes);
+        if (fanout.blocks[i].buf == NULL)
+        {
+            sprintf (errmsg, "Allocating %d blocks of %zu bytes",
+                queue_blocks, block_bytes);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+            goto finish;
+        }
+        fanout.blocks[i].block.band_buf = &fanout.blocks[i].buf;
+        fanout.free_blocks[fanout.nfree++] = &fanout.blocks[i];
+    }
+
+    /* Start the thread of each sink which needs any of the bands */
+    for (i = 0; i < nsinks; i++)
+    {
+        queue = &fanout.queues[i];
+        queue->sink = &sinks[i];
+        queue->fanout = &fanout;
+        for (j = 0; j < xml_metadata->nbands; j++)
+            if (export_sink_needs_band (&sinks[i], xml_metadata, j))
+                break;
+        if (j == xml_metadata->nbands)
+        {
+            printf ("Nothing to export to the %s output\n", sinks[i].name);
+            continue;
+        }
+
+        queue->capacity = queue_blocks + 1;
+        queue->entry = calloc (queue->capacity, sizeof (Export_block_t *));
+        if (queue->entry == NULL)
+        {
+            sprintf (errmsg, "Allocating the queue of the %s output",
+                sinks[i].name);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+            break;
+        }
+
+        if (pthread_create (&queue->thread, NULL, export_sink_thread, queue)
+            != 0)
+        {
+            sprintf (errmsg, "Starting the thread of the %s output",
+                sinks[i].name);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+            break;
+        }
+        queue->thread_started = true;
+    }
+
+    /* Read each band once, feeding the blocks to the sinks which need it */
+    for (i = 0; status == SUCCESS && i < xml_metadata->nbands; i++)
+    {
+        needed = false;
+        for (j = 0; j < nsinks; j++)
+        {
+            queue = &fanout.queues[j];
+            queue->needs_band = queue->thread_started &&
+                export_sink_needs_band (&sinks[j], xml_metadata, i);
+            if (queue->needs_band)
+                needed = true;
+        }
+        if (!needed)
+            continue;
+
+        printf ("Exporting band %s\n", xml_metadata->band[i].name);
+        if (reader != NULL)
+            status = read_export_band_lines (&fanout, i, block_lines);
+        else
+            status = read_export_band (&fanout, i, block_lines);
+        if (status != SUCCESS)
+        {
+            sprintf (errmsg, "Exporting band %s", xml_metadata->band[i].name);
+            error_handler (true, FUNC_NAME, errmsg);
+        }
+    }
+
+    /* End the output of each sink and wait for them to be done */
+    queue_export_block (&fanout, NULL);
+    for (i = 0; i < nsinks; i++)
+    {
+        queue = &fanout.queues[i];
+        if (queue->thread_started)
+            pthread_join (queue->thread, NULL);
+        if (queue->failed)
+            status = ERROR;
+    }
+
+finish:
+    /* Complete the products, or just clean up if anything failed */
+    complete = (status == SUCCESS);
+    for (i = 0; i < nsinks; i++)
+    {
+        if (sinks[i].finish (sinks[i].state, xml_metadata, complete)
+            != SUCCESS)
+        {
+            sprintf (errmsg, "Completing the %s output", sinks[i].name);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+        }
+    }
+
+    if (fanout.queues != NULL)
+    {
+        for (i = 0; i < nsinks; i++)
+            free (fanout.queues[i].entry);
+        free (fanout.queues);
+    }
+    if (fanout.blocks != NULL)
+    {
+        for (i = 0; i < queue_blocks; i++)
+            espa_trace_free (fanout.blocks[i].buf);
+        free (fanout.blocks);
+    }
+    free (fanout.free_blocks);
+    pthread_mutex_destroy (&fanout.mutex);
+    pthread_cond_destroy (&fanout.cond);
+
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE: write_export_metadata
+
+PURPOSE: Writes the XML metadata file of an exported product, pointing each
+band at its output file.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the XML file
+SUCCESS         Successfully wrote the XML file
+
+NOTES:
+  1. The output files hold the pixels of every band, so none of the bands
+     are constant in the exported product.
+  2. The file names of the metadata are restored before returning, since the
+     metadata is shared by all the exported products.
+******************************************************************************/
+int write_export_metadata
+(
+    Espa_internal_meta_t *xml_metadata, /* I: XML metadata structure */
+    char (*file_names)[STR_SIZE],  /* I: output file of each band */
+    char *xml_file                 /* I: name of the XML file to write */
+)
+{
+    char FUNC_NAME[] = "write_export_metadata";  /* function name */
+    char errmsg[STR_SIZE];     /* error message */
+    char (*src_names)[STR_SIZE] = NULL;  /* source file of each band */
+    double *src_constant = NULL; /* source constant value of each band */
+    int i;                     /* looping variable for the bands */
+    int status;                /* return status */
+    int nbands = xml_metadata->nbands;  /* number of bands */
+    Espa_band_meta_t *bmeta;   /* metadata of the current band */
+
+    src_names = calloc (nbands, STR_SIZE);
+    src_constant = calloc (nbands, sizeof (double));
+    if (src_names == NULL || src_constant == NULL)
+    {
+        sprintf (errmsg, "Allocating the band file names");
+        error_handler (true, FUNC_NAME, errmsg);
+        free (src_names);
+        free (src_constant);
+        return (ERROR);
+    }
+
+    for (i = 0; i < nbands; i++)
+    {
+        bmeta = &xml_metadata->band[i];
+        strcpy (src_names[i], bmeta->file_name);
+        src_constant[i] = bmeta->constant_value;
+        strcpy (bmeta->file_name, file_names[i]);
+        bmeta->constant_value = ESPA_FLOAT_META_FILL;
+    }
+
+    status = write_metadata (xml_metadata, xml_file);
+    if (status != SUCCESS)
+    {
+        sprintf (errmsg, "Writing the XML metadata file: %s", xml_file);
+        error_handler (true, FUNC_NAME, errmsg);
+    }
+
+    for (i = 0; i < nbands; i++)
+    {
+        bmeta = &xml_metadata->band[i];
+        strcpy (bmeta->file_name, src_names[i]);
+        bmeta->constant_value = src_constant[i];
+    }
+
+    free (src_names);
+    free (src_constant);
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE: remove_export_source
+
+PURPOSE: Removes the raw binary image and header files of the bands, and the
+source XML file, once they have been exported.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error removing a file
+SUCCESS         Successfully removed the source files
+
+NOTES:
+  1. Constant bands have no source files.
+******************************************************************************/
+int remove_export_source
+(
+    Espa_internal_meta_t *xml_metadata, /* I: XML metadata structure */
+    char *espa_xml_file        /* I: source XML metadata filename */
+)
+{
+    char FUNC_NAME[] = "remove_export_source";  /* function name */
+    char errmsg[STR_SIZE];     /* error message */
+    char hdr_file[STR_SIZE];   /* name of the header file of the band */
+    char *cptr = NULL;         /* pointer to the file extension */
+    int i;                     /* looping variable for the bands */
+    int count;                 /* number of chars copied in snprintf */
+    Espa_band_meta_t *bmeta;   /* metadata of the current band */
+
+    for (i = 0; i < xml_metadata->nbands; i++)
+    {
+        bmeta = &xml_metadata->band[i];
+        if (is_constant_band (bmeta) ||
+            is_shared_band_file (xml_metadata, i, true))
+            continue;
+
+        /* .img file */
+        printf ("  Removing %s\n", bmeta->file_name);
+        if (unlink (bmeta->file_name) != 0)
+        {
+            sprintf (errmsg, "Deleting source file: %s", bmeta->file_name);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+
+        /* .hdr file */
+        count = snprintf (hdr_file, sizeof (hdr_file), "%s",
+            bmeta->file_name);
+        if (count < 0 || count >= sizeof (hdr_file))
+        {
+            sprintf (errmsg, "Overflow of hdr_file string");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+
+        cptr = strrchr (hdr_file, '.');
+        if (cptr == NULL)
+            continue;
+        strcpy (cptr, ".hdr");
+        printf ("  Removing %s\n", hdr_file);
+        if (unlink (hdr_file) != 0)
+        {
+            sprintf (errmsg, "Deleting source file: %s", hdr_file);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+    }
+
+    /* XML file */
+    printf ("  Removing %s\n", espa_xml_file);
+    if (unlink (espa_xml_file) != 0)
+    {
+        sprintf (errmsg, "Deleting source file: %s", espa_xml_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE: begin_raw_export_band
+
+PURPOSE: Opens the raw binary file of a band fed by the export fan-out.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error opening the raw binary file
+SUCCESS         Successfully opened the raw binary file
+
+NOTES:
+******************************************************************************/
+static int begin_raw_export_band
+(
+    void *state,                        /* I/O: state of the sink */
+    Espa_internal_meta_t *xml_metadata, /* I: XML metadata structure */
+    int band                            /* I: index of the band */
+)
+{
+    char FUNC_NAME[] = "begin_raw_export_band";  /* function name */
+    char errmsg[STR_SIZE];     /* error message */
+    Raw_export_t *raw = state; /* state of the sink */
+    Espa_band_meta_t *bmeta = &xml_metadata->band[band];
+
+    raw->writer = open_raw_binary_writer (bmeta->file_name, (size_t)
+        bmeta->nlines * bmeta->nsamps *
+        espa_data_type_size (bmeta->data_type), 0);
+    if (raw->writer == NULL)
+    {
+        sprintf (errmsg, "Opening the raw binary file: %s", bmeta->file_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    if (start_raw_binary_writer_stats (raw->writer, bmeta) != SUCCESS)
+    {
+        sprintf (errmsg, "Starting the statistics of band %s", bmeta->name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE: write_raw_export_block
+
+PURPOSE: Appends a block of lines fed by the export fan-out to the raw binary
+file of the band.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the lines
+SUCCESS         Successfully wrote the lines
+
+NOTES:
+******************************************************************************/
+static int write_raw_export_block
+(
+    void *state,                        /* I/O: state of the sink */
+    Espa_internal_meta_t *xml_metadata, /* I: XML metadata structure */
+    int band,                           /* I: index of the band */
+    Espa_band_block_t *block            /* I: block of lines */
+)
+{
+    Raw_export_t *raw = state; /* state of the sink */
+    int size = espa_data_type_size (xml_metadata->band[band].data_type);
+                               /* number of bytes per pixel */
+
+    return (append_raw_binary_writer (raw->writer, block->nlines,
+        block->nsamps, size, block->band_buf[0]));
+}
+
+
+/******************************************************************************
+MODULE: end_raw_export_band
+
+PURPOSE: Closes the raw binary file of a band fed by the export fan-out and
+writes its ENVI header.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error closing the file or writing the header
+SUCCESS         Successfully completed the band
+
+NOTES:
+  1. The checksum and statistics of the band are kept in the state of the
+     sink until the product is finished, since the metadata is shared by
+     the threads of all the sinks.
+******************************************************************************/
+static int end_raw_export_band
+(
+    void *state,                        /* I/O: state of the sink */
+    Espa_internal_meta_t *xml_metadata, /* I: XML metadata structure */
+    int band                            /* I: index of the band */
+)
+{
+    char FUNC_NAME[] = "end_raw_export_band";  /* function name */
+    char errmsg[STR_SIZE];     /* error message */
+    char hdr_file[STR_SIZE];   /* name of the ENVI header file */
+    char *cptr = NULL;         /* pointer to the file extension */
+    int count;                 /* number of chars copied in snprintf */
+    int status;                /* status of closing the file */
+    Raw_export_t *raw = state; /* state of the sink */
+    Espa_band_meta_t *bmeta = &xml_metadata->band[band];
+    Envi_header_t envi_hdr;    /* ENVI header of the band */
+
+    get_raw_binary_writer_checksum (raw->writer, raw->checksum[band]);
+    get_raw_binary_writer_stats (raw->writer, &raw->stats[band]);
+    status = close_raw_binary_writer (raw->writer);
+    raw->writer = NULL;
+    if (status != SUCCESS)
+    {
+        sprintf (errmsg, "Closing the raw binary file: %s", bmeta->file_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Write the ENVI header next to the raw binary file */
+    count = snprintf (hdr_file, sizeof (hdr_file), "%s", bmeta->file_name);
+    cptr = strrchr (hdr_file, '.');
+    if (count < 0 || count >= sizeof (hdr_file) || cptr == NULL)
+    {
+        sprintf (errmsg, "Naming the ENVI header of %s", bmeta->file_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    strcpy (cptr, ".hdr");
+
+    if (create_envi_struct (bmeta, &xml_metadata->global, &envi_hdr)
+        != SUCCESS || write_envi_hdr (hdr_file, &envi_hdr) != SUCCESS)
+    {
+        sprintf (errmsg, "Writing the ENVI header file: %s", hdr_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE: finish_raw_export
+
+PURPOSE: Writes the XML file of the raw binary product once all the bands
+have been written, and frees the state of the sink.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the XML file
+SUCCESS         Successfully completed the raw binary product
+
+NOTES:
+  1. The checksums and statistics of the bands are stored in the metadata,
+     so the sinks finished after this one write them too.
+******************************************************************************/
+static int finish_raw_export
+(
+    void *state,                        /* I: state of the sink */
+    Espa_internal_meta_t *xml_metadata, /* I: XML metadata structure */
+    bool complete                       /* I: were all the bands written? */
+)
+{
+    char FUNC_NAME[] = "finish_raw_export";  /* function name */
+    char errmsg[STR_SIZE];     /* error message */
+    int i;                     /* looping variable for the bands */
+    int status = SUCCESS;      /* return status */
+    Raw_export_t *raw = state; /* state of the sink */
+
+    if (raw->writer != NULL)
+        close_raw_binary_writer (raw->writer);
+
+    if (complete)
+    {
+        for (i = 0; i < xml_metadata->nbands; i++)
+        {
+            strcpy (xml_metadata->band[i].checksum, raw->checksum[i]);
+            xml_metadata->band[i].stats = raw->stats[i];
+        }
+
+        if (write_metadata (xml_metadata, raw->xml_file) != SUCCESS)
+        {
+            sprintf (errmsg, "Writing the XML metadata file: %s",
+                raw->xml_file);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+        }
+    }
+
+    free (raw->checksum);
+    free (raw->stats);
+    free (raw);
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE: init_raw_binary_export_sink
+
+PURPOSE: Sets up an export sink which writes the raw binary bands, their ENVI
+headers, and the XML file of the product from the blocks fed by the export
+fan-out, such as the intermediate product of an ingest exporting straight to
+other formats.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error setting up the sink
+SUCCESS         Successfully set up the sink
+
+NOTES:
+  1. The sink should come first in the list of sinks, so the checksums and
+     statistics it computes are in the XML files of the other formats.
+******************************************************************************/
+int init_raw_binary_export_sink
+(
+    char *espa_xml_file,   /* I: output ESPA XML metadata filename */
+    Espa_internal_meta_t *xml_metadata, /* I: XML metadata structure; the
+                                 bands are written to their file names */
+    Espa_export_sink_t *sink  /* O: raw binary export sink */
+)
+{
+    char FUNC_NAME[] = "init_raw_binary_export_sink";  /* function name */
+    char errmsg[STR_SIZE];     /* error message */
+    Raw_export_t *raw = NULL;  /* state of the sink */
+
+    raw = calloc (1, sizeof (Raw_export_t));
+    if (raw != NULL)
+    {
+        raw->checksum = calloc (xml_metadata->nbands, STR_SIZE);
+        raw->stats = calloc (xml_metadata->nbands,
+            sizeof (Espa_band_stats_t));
+    }
+    if (raw == NULL || raw->checksum == NULL || raw->stats == NULL)
+    {
+        sprintf (errmsg, "Allocating the raw binary export sink");
+        error_handler (true, FUNC_NAME, errmsg);
+        if (raw != NULL)
+        {
+            free (raw->checksum);
+            free (raw->stats);
+            free (raw);
+        }
+        return (ERROR);
+    }
+
+    if (strlen (espa_xml_file) >= sizeof (raw->xml_file))
+    {
+        sprintf (errmsg, "Overflow of xml_file string");
+        error_handler (true, FUNC_NAME, errmsg);
+        finish_raw_export (raw, xml_metadata, false);
+        return (ERROR);
+    }
+    strcpy (raw->xml_file, espa_xml_file);
+
+    strcpy (sink->name, "raw binary");
+    sink->state = raw;
+    sink->needs_band = NULL;
+    sink->begin_band = begin_raw_export_band;
+    sink->write_block = write_raw_export_block;
+    sink->end_band = end_raw_export_band;
+    sink->finish = finish_raw_export;
+    return (SUCCESS);
+}
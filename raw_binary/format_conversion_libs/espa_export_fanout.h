@@ -0,0 +1,183 @@
+/*****************************************************************************
+FILE: espa_export_fanout.h
+
+PURPOSE: Contains defines, structures, and prototypes for the export fan-out,
+which reads each block of the ESPA raw binary bands once and feeds it to the
+writers of several export formats at the same time.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. Each export format is an export sink (Espa_export_sink_t), set up by the
+     converter of its format.  Their prototypes are declared here rather
+     than in the headers of the formats, since the HDF4 and NetCDF headers
+     can't be included together.  This file doesn't depend on any of the
+     format libraries.
+  2. Each sink runs in its own thread.  The blocks are handed to the sinks
+     through bounded queues, and the number of blocks in flight is limited,
+     so the memory used doesn't depend on the size of the bands or on how
+     far the slowest sink lags behind.
+  3. A sink may skip bands, such as those whose outputs are kept by an
+     incremental export (see espa_incremental.h).  A band no sink needs
+     isn't read, and a sink which needs none of the bands isn't started.
+  4. The bands are read from their raw binary files, or from the source
+     product through a band reader (Espa_export_reader_t), so an ingest can
+     write the export formats without the intermediate raw binary files.
+*****************************************************************************/
+
+#ifndef ESPA_EXPORT_FANOUT_H
+#define ESPA_EXPORT_FANOUT_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include "error_handler.h"
+#include "espa_metadata.h"
+#include "write_metadata.h"
+#include "espa_band_stack.h"
+
+/* Default number of blocks in flight between the reader and the sinks */
+#define DEFAULT_EXPORT_QUEUE_BLOCKS 8
+
+/* Writer of one export format.  The band functions are called from the
+   thread of the sink, in band order: begin_band, write_block for each block
+   of lines of the band in line order, then end_band.  finish is called from
+   the caller's thread once all the sinks are done, and also if any of them
+   failed.  The blocks are shared by all the sinks, so they must not be
+   modified. */
+typedef struct
+{
+    char name[STR_SIZE];   /* name of the export format, for messages */
+    void *state;           /* state of the writer, passed to each function */
+    bool (*needs_band)     /* does the sink write the band?  NULL if it
+                              writes every band.  Called from the caller's
+                              thread before the band is read. */
+    (
+        void *state,                        /* I: state of the writer */
+        Espa_internal_meta_t *xml_metadata, /* I: XML metadata structure */
+        int band                            /* I: index of the band */
+    );
+    int (*begin_band)      /* starts the output of a band */
+    (
+        void *state,                        /* I/O: state of the writer */
+        Espa_internal_meta_t *xml_metadata, /* I: XML metadata structure */
+        int band                            /* I: index of the band */
+    );
+    int (*write_block)     /* writes a block of lines of the band */
+    (
+        void *state,                        /* I/O: state of the writer */
+        Espa_internal_meta_t *xml_metadata, /* I: XML metadata structure */
+        int band,                           /* I: index of the band */
+        Espa_band_block_t *block            /* I: block of lines */
+    );
+    int (*end_band)        /* completes the output of a band */
+    (
+        void *state,                        /* I/O: state of the writer */
+        Espa_internal_meta_t *xml_metadata, /* I: XML metadata structure */
+        int band                            /* I: index of the band */
+    );
+    int (*finish)          /* completes the product and frees the state */
+    (
+        void *state,                        /* I: state of the writer */
+        Espa_internal_meta_t *xml_metadata, /* I: XML metadata structure */
+        bool complete      /* I: were all the bands written by every sink?
+                                 if not, only the state is freed */
+    );
+} Espa_export_sink_t;
+
+/* Reader of the bands of a source product, in place of the raw binary
+   files.  read_lines is called from the caller's thread of the fan-out, in
+   band order and in line order within a band, so a reader of a library
+   which isn't thread safe may be used. */
+typedef struct
+{
+    void *state;           /* state of the reader, passed to read_lines */
+    int (*read_lines)      /* reads a block of whole lines of a band */
+    (
+        void *state,                        /* I/O: state of the reader */
+        Espa_internal_meta_t *xml_metadata, /* I: XML metadata structure */
+        int band,                           /* I: index of the band */
+        int line0,                          /* I: first line of the block */
+        int nlines,                         /* I: number of lines */
+        void *buf          /* O: nlines * nsamps pixels of the band */
+    );
+} Espa_export_reader_t;
+
+/* Prototypes */
+int export_espa_fanout
+(
+    Espa_internal_meta_t *xml_metadata, /* I: XML metadata structure */
+    int nsinks,                /* I: number of export sinks */
+    Espa_export_sink_t *sinks, /* I: export sinks; each is finished on
+                                     return */
+    int block_lines,           /* I: number of lines per block; use
+                                     RB_PREFETCH_DEFAULT_LINES if not known */
+    int queue_blocks           /* I: number of blocks in flight between the
+                                     reader and the sinks */
+);
+
+int export_espa_fanout_reader
+(
+    Espa_internal_meta_t *xml_metadata, /* I: XML metadata structure */
+    Espa_export_reader_t *reader,  /* I: reader of the bands; NULL to read
+                                         the raw binary files */
+    int nsinks,                /* I: number of export sinks */
+    Espa_export_sink_t *sinks, /* I: export sinks; each is finished on
+                                     return */
+    int block_lines,           /* I: number of lines per block */
+    int queue_blocks           /* I: number of blocks in flight between the
+                                     reader and the sinks */
+);
+
+int init_raw_binary_export_sink
+(
+    char *espa_xml_file,   /* I: output ESPA XML metadata filename */
+    Espa_internal_meta_t *xml_metadata, /* I: XML metadata structure; the
+                                 bands are written to their file names */
+    Espa_export_sink_t *sink  /* O: raw binary export sink */
+);
+
+int write_export_metadata
+(
+    Espa_internal_meta_t *xml_metadata, /* I: XML metadata structure */
+    char (*file_names)[STR_SIZE],  /* I: output file of each band */
+    char *xml_file                 /* I: name of the XML file to write */
+);
+
+/* Export sinks of the formats; see convert_espa_to_gtif.c,
+   convert_espa_to_netcdf.c, and convert_espa_to_hdf.c */
+int init_gtif_export_sink
+(
+    char *gtif_file,       /* I: base output GeoTIFF filename */
+    Espa_internal_meta_t *xml_metadata, /* I: XML metadata structure */
+    int block_lines,       /* I: number of lines per block of the fan-out */
+    Espa_export_sink_t *sink  /* O: GeoTIFF export sink */
+);
+
+int init_netcdf_export_sink
+(
+    char *netcdf_file,     /* I: output NetCDF filename */
+    Espa_internal_meta_t *xml_metadata, /* I: XML metadata structure */
+    bool no_compression,   /* I: use compression for the NetCDF output file? */
+    int block_lines,       /* I: number of lines per block of the fan-out */
+    Espa_export_sink_t *sink  /* O: NetCDF export sink */
+);
+
+int init_hdf_export_sink
+(
+    char *hdf_file,        /* I: output HDF filename */
+    Espa_internal_meta_t *xml_metadata, /* I: XML metadata structure */
+    Espa_export_sink_t *sink  /* O: HDF export sink */
+);
+
+int remove_export_source
+(
+    Espa_internal_meta_t *xml_metadata, /* I: XML metadata structure */
+    char *espa_xml_file        /* I: source XML metadata filename */
+);
+
+#endif
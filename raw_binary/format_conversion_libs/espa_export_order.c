@@ -0,0 +1,663 @@
+/*****************************************************************************
+FILE: espa_export_order.c
+
+PURPOSE: Contains functions for exporting an order of ESPA products to their
+export formats in one invocation, exporting several products at a time.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The progress of the order (the next product to be taken and the number
+     of products which failed) is kept in memory shared with the workers,
+     and updated with atomics.
+*****************************************************************************/
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/mman.h>
+#include "parse_metadata.h"
+#include "espa_trace.h"
+#include "espa_task_pool.h"
+#include "raw_binary_prefetch.h"
+#include "espa_export_order.h"
+
+/* Delimiters of the fields of a line of the manifest */
+#define ORDER_DELIMS " \t\r\n"
+
+/* Progress of an order, shared by the workers */
+typedef struct
+{
+    int next;            /* index of the next product to be taken */
+    int nfailed;         /* number of products which failed */
+} Order_progress_t;
+
+
+/******************************************************************************
+MODULE:  free_order_product
+
+PURPOSE: Frees the filenames and formats of a product of an order.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+static void free_order_product
+(
+    Espa_order_product_t *product  /* I/O: product to be freed */
+)
+{
+    int i;                    /* looping variable for the formats */
+
+    free (product->xml_file);
+    for (i = 0; i < product->nformats; i++)
+    {
+        free (product->formats[i]);
+        free (product->outfiles[i]);
+    }
+    memset (product, 0, sizeof (Espa_order_product_t));
+}
+
+
+/******************************************************************************
+MODULE:  parse_order_line
+
+PURPOSE: Parses a line of the manifest of an order into a product.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           The line isn't a valid product
+SUCCESS         Successfully parsed the product
+
+NOTES:
+  1. The line is modified.  The product must be zeroed on input, and is
+     freed on error.
+******************************************************************************/
+static int parse_order_line
+(
+    char *line,               /* I: line of the manifest with a product */
+    char *manifest,           /* I: name of the manifest, for messages */
+    int lineno,               /* I: 1-based number of the line */
+    Espa_order_product_t *product  /* O: product of the line */
+)
+{
+    char FUNC_NAME[] = "parse_order_line";  /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    char *field = NULL;       /* current field of the line */
+    char *save = NULL;        /* position of strtok_r in the line */
+    char *equal = NULL;       /* separator of the format and its output */
+    int i;                    /* looping variable for the formats */
+
+    field = strtok_r (line, ORDER_DELIMS, &save);
+    product->xml_file = strdup (field);
+    if (product->xml_file == NULL)
+    {
+        sprintf (errmsg, "Allocating the product on line %d of %s", lineno,
+            manifest);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    while ((field = strtok_r (NULL, ORDER_DELIMS, &save)) != NULL)
+    {
+        if (!strcmp (field, "no_compression"))
+        {
+            product->no_compression = true;
+            continue;
+        }
+        if (!strcmp (field, "del_src"))
+        {
+            product->del_src = true;
+            continue;
+        }
+
+        equal = strchr (field, '=');
+        if (equal == NULL || equal == field || equal[1] == '\0')
+        {
+            sprintf (errmsg, "Invalid field %s on line %d of %s; expected "
+                "format=output, no_compression, or del_src", field, lineno,
+                manifest);
+            error_handler (true, FUNC_NAME, errmsg);
+            free_order_product (product);
+            return (ERROR);
+        }
+        *equal = '\0';
+
+        if (!espa_export_format_known (field))
+        {
+            sprintf (errmsg, "Unknown export format %s on line %d of %s",
+                field, lineno, manifest);
+            error_handler (true, FUNC_NAME, errmsg);
+            free_order_product (product);
+            return (ERROR);
+        }
+        for (i = 0; i < product->nformats; i++)
+        {
+            if (!strcmp (product->formats[i], field))
+            {
+                sprintf (errmsg, "Export format %s is repeated on line %d "
+                    "of %s", field, lineno, manifest);
+                error_handler (true, FUNC_NAME, errmsg);
+                free_order_product (product);
+                return (ERROR);
+            }
+        }
+        if (product->nformats >= ESPA_ORDER_MAX_FORMATS)
+        {
+            sprintf (errmsg, "More than %d export formats on line %d of %s",
+                ESPA_ORDER_MAX_FORMATS, lineno, manifest);
+            error_handler (true, FUNC_NAME, errmsg);
+            free_order_product (product);
+            return (ERROR);
+        }
+
+        product->formats[product->nformats] = strdup (field);
+        product->outfiles[product->nformats] = strdup (equal + 1);
+        product->nformats++;
+        if (product->formats[product->nformats-1] == NULL ||
+            product->outfiles[product->nformats-1] == NULL)
+        {
+            sprintf (errmsg, "Allocating the product on line %d of %s",
+                lineno, manifest);
+            error_handler (true, FUNC_NAME, errmsg);
+            free_order_product (product);
+            return (ERROR);
+        }
+    }
+
+    if (product->nformats == 0)
+    {
+        sprintf (errmsg, "No export format for %s on line %d of %s",
+            product->xml_file, lineno, manifest);
+        error_handler (true, FUNC_NAME, errmsg);
+        free_order_product (product);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  read_espa_order
+
+PURPOSE: Reads the manifest of an order into its products.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error reading the manifest, or it has no products
+SUCCESS         Successfully read the products of the order
+
+NOTES:
+  1. See espa_export_order.h for the format of the manifest.  The formats
+     are checked against the registry, but the products and outputs aren't
+     checked until they are exported.
+******************************************************************************/
+int read_espa_order
+(
+    char *manifest,        /* I: name of the manifest of the order */
+    int *nproducts,        /* O: number of products in the order */
+    Espa_order_product_t **products  /* O: products of the order; freed
+                                           with free_espa_order */
+)
+{
+    char FUNC_NAME[] = "read_espa_order";  /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    char *line = NULL;        /* current line of the manifest */
+    char *start = NULL;       /* first non-blank character of the line */
+    size_t line_size = 0;     /* size of the line buffer */
+    int lineno = 0;           /* 1-based number of the current line */
+    int max_products = 0;     /* number of products allocated */
+    int status = SUCCESS;     /* return status */
+    Espa_order_product_t *tmp = NULL;  /* reallocated products */
+    FILE *fp = NULL;          /* manifest file pointer */
+
+    *nproducts = 0;
+    *products = NULL;
+
+    fp = fopen (manifest, "r");
+    if (fp == NULL)
+    {
+        sprintf (errmsg, "Opening the order manifest %s", manifest);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    while (status == SUCCESS && getline (&line, &line_size, fp) != -1)
+    {
+        lineno++;
+        start = line + strspn (line, ORDER_DELIMS);
+        if (*start == '\0' || *start == '#')
+            continue;
+
+        if (*nproducts == max_products)
+        {
+            max_products = max_products == 0 ? 16 : max_products * 2;
+            tmp = realloc (*products, max_products *
+                sizeof (Espa_order_product_t));
+            if (tmp == NULL)
+            {
+                sprintf (errmsg, "Allocating the products of %s", manifest);
+                error_handler (true, FUNC_NAME, errmsg);
+                status = ERROR;
+                break;
+            }
+            *products = tmp;
+        }
+
+        memset (&(*products)[*nproducts], 0, sizeof (Espa_order_product_t));
+        if (parse_order_line (start, manifest, lineno,
+            &(*products)[*nproducts]) == SUCCESS)
+            (*nproducts)++;
+        else
+            status = ERROR;
+    }
+    free (line);
+    fclose (fp);
+
+    if (status == SUCCESS && *nproducts == 0)
+    {
+        sprintf (errmsg, "No products in the order manifest %s", manifest);
+        error_handler (true, FUNC_NAME, errmsg);
+        status = ERROR;
+    }
+
+    if (status != SUCCESS)
+    {
+        free_espa_order (*nproducts, *products);
+        *nproducts = 0;
+        *products = NULL;
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  free_espa_order
+
+PURPOSE: Frees the products of an order.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+void free_espa_order
+(
+    int nproducts,         /* I: number of products in the order */
+    Espa_order_product_t *products  /* I: products of the order */
+)
+{
+    int i;                    /* looping variable for the products */
+
+    if (products == NULL)
+        return;
+    for (i = 0; i < nproducts; i++)
+        free_order_product (&products[i]);
+    free (products);
+}
+
+
+/******************************************************************************
+MODULE:  order_product_bytes
+
+PURPOSE: Estimates the bytes taken by the fan-out buffers while a product is
+exported.
+
+RETURN VALUE:
+Type = size_t
+Value           Description
+-----           -----------
+0               The metadata of the product couldn't be read
+n               Bytes of the queued blocks and the read-ahead blocks
+
+NOTES:
+  1. The fan-out reads one band at a time, so the blocks are sized for the
+     largest block of the bands (see export_espa_fanout).  The metadata
+     isn't validated here; that is left to the export of the product.
+******************************************************************************/
+static size_t order_product_bytes
+(
+    Espa_order_product_t *product, /* I: product of the order */
+    int queue_blocks       /* I: number of blocks in flight in the fan-out */
+)
+{
+    int i;                    /* looping variable for the bands */
+    int lines;                /* number of lines in a block of the band */
+    size_t nbytes;            /* number of bytes in a block of the band */
+    size_t block_bytes = 0;   /* number of bytes in the largest block */
+    Espa_band_meta_t *bmeta;  /* metadata of the current band */
+    Espa_internal_meta_t xml_metadata;  /* XML metadata structure */
+
+    init_metadata_struct (&xml_metadata);
+    if (parse_metadata (product->xml_file, &xml_metadata) != SUCCESS)
+    {
+        free_metadata (&xml_metadata);
+        return 0;
+    }
+
+    for (i = 0; i < xml_metadata.nbands; i++)
+    {
+        bmeta = &xml_metadata.band[i];
+        lines = RB_PREFETCH_DEFAULT_LINES < bmeta->nlines ?
+            RB_PREFETCH_DEFAULT_LINES : bmeta->nlines;
+        nbytes = (size_t) lines * bmeta->nsamps *
+            espa_data_type_size (bmeta->data_type);
+        if (nbytes > block_bytes)
+            block_bytes = nbytes;
+    }
+    free_metadata (&xml_metadata);
+
+    return (size_t) (queue_blocks + RB_PREFETCH_MAX_BUFFERS) * block_bytes;
+}
+
+
+/******************************************************************************
+MODULE:  export_order_product
+
+PURPOSE: Exports a product of an order to each of its formats, reading its
+bands once.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error exporting the product
+SUCCESS         Successfully exported the product to all its formats
+
+NOTES:
+  1. This does for the product what convert_espa_to_formats does for its
+     command line.  The source files are only removed once every format has
+     been written.
+******************************************************************************/
+static int export_order_product
+(
+    Espa_order_product_t *product, /* I: product of the order */
+    int queue_blocks       /* I: number of blocks in flight in the fan-out */
+)
+{
+    char FUNC_NAME[] = "export_order_product";  /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    int nsinks = 0;           /* number of export sinks */
+    int status = SUCCESS;     /* return status */
+    int i;                    /* looping variable for the formats */
+    Espa_export_options_t options;  /* options of the export formats */
+    Espa_export_sink_t sinks[ESPA_ORDER_MAX_FORMATS];  /* export sinks */
+    Espa_internal_meta_t xml_metadata;  /* XML metadata structure */
+
+    /* Validate the metadata file and parse it into our internal metadata
+       structure */
+    init_metadata_struct (&xml_metadata);
+    if (validate_and_parse_metadata (product->xml_file, &xml_metadata)
+        != SUCCESS)
+    {  /* Error messages already written */
+        free_metadata (&xml_metadata);
+        return (ERROR);
+    }
+
+    /* Set up the sink of each format */
+    options.block_lines = RB_PREFETCH_DEFAULT_LINES;
+    options.no_compression = product->no_compression;
+    for (i = 0; status == SUCCESS && i < product->nformats; i++)
+    {
+        if (init_export_sink (product->formats[i], product->outfiles[i],
+            &xml_metadata, &options, &sinks[nsinks]) == SUCCESS)
+            nsinks++;
+        else
+            status = ERROR;
+    }
+    if (status != SUCCESS)
+    {
+        sprintf (errmsg, "Setting up the export formats of %s",
+            product->xml_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        for (i = 0; i < nsinks; i++)
+            sinks[i].finish (sinks[i].state, &xml_metadata, false);
+        free_metadata (&xml_metadata);
+        return (ERROR);
+    }
+
+    /* Convert the product to all its formats, then remove the source files
+       if specified */
+    if (export_espa_fanout (&xml_metadata, nsinks, sinks,
+        RB_PREFETCH_DEFAULT_LINES, queue_blocks) != SUCCESS)
+        status = ERROR;
+    else if (product->del_src &&
+        remove_export_source (&xml_metadata, product->xml_file) != SUCCESS)
+        status = ERROR;
+
+    free_metadata (&xml_metadata);
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  export_order_share
+
+PURPOSE: Exports the products of an order, taking the next product not yet
+taken until there are none left.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. A product which fails is counted in the progress, and doesn't stop the
+     remaining products.
+******************************************************************************/
+static void export_order_share
+(
+    int nproducts,         /* I: number of products in the order */
+    Espa_order_product_t *products, /* I: products of the order */
+    int queue_blocks,      /* I: number of blocks in flight in the fan-out
+                                 of each product */
+    Order_progress_t *progress  /* I/O: progress of the order */
+)
+{
+    char FUNC_NAME[] = "export_order_share";  /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    int i;                    /* index of the product taken */
+
+    while ((i = __atomic_fetch_add (&progress->next, 1, __ATOMIC_RELAXED))
+        < nproducts)
+    {
+        printf ("Product %d of %d: %s\n", i + 1, nproducts,
+            products[i].xml_file);
+        if (export_order_product (&products[i], queue_blocks) != SUCCESS)
+        {
+            sprintf (errmsg, "Exporting product %s", products[i].xml_file);
+            error_handler (true, FUNC_NAME, errmsg);
+            __atomic_fetch_add (&progress->nfailed, 1, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+
+/******************************************************************************
+MODULE:  export_espa_order
+
+PURPOSE: Exports the products of an order to their formats, exporting up to
+njobs products at a time.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error exporting one or more of the products
+SUCCESS         Successfully exported all the products
+
+NOTES:
+  1. The ESPA schema is compiled once, before any product is exported, and
+     is shared by all the products.
+  2. With more than one job, the products are taken in order by njobs
+     worker processes forked from this one (see espa_export_order.h).  Each
+     worker gets an equal share of the thread cap and of the memory budget.
+     Any products left by workers which couldn't be forked are exported by
+     this process once the others are done.
+  3. With a memory budget, the jobs are cut to those whose fan-out buffers
+     fit for the largest product (see espa_mem_fit_count).
+  4. Every product is attempted, even if others fail.  A worker which dies
+     loses the product it was exporting, and is counted as a failure.
+******************************************************************************/
+int export_espa_order
+(
+    int nproducts,         /* I: number of products in the order */
+    Espa_order_product_t *products, /* I: products of the order */
+    int njobs,             /* I: most products exported at a time; 0 for the
+                                 thread cap of the task pool */
+    int queue_blocks       /* I: number of blocks in flight in the fan-out
+                                 of each product */
+)
+{
+    char FUNC_NAME[] = "export_espa_order";  /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    int i;                    /* looping variable */
+    int nfailed = 0;          /* number of products or workers which failed */
+    int nthreads;             /* cap on the threads of each worker */
+    int fitted;               /* number of jobs which fit in the budget */
+    int wstatus;              /* exit status of a worker */
+    long long budget;         /* memory budget (bytes); 0 if none */
+    size_t nbytes;            /* fan-out bytes of a product */
+    size_t max_bytes = 0;     /* fan-out bytes of the largest product */
+    pid_t *pids = NULL;       /* process of each worker; -1 if not forked */
+    Order_progress_t local;   /* progress of the order without workers */
+    Order_progress_t *progress = &local;  /* progress of the order */
+    void *shared = MAP_FAILED;  /* memory shared with the workers */
+
+    if (njobs < 1)
+        njobs = espa_task_pool_threads ();
+    if (njobs > nproducts)
+        njobs = nproducts;
+    if (njobs < 1)
+        njobs = 1;
+
+    /* Compile the schema up front, so the workers inherit it */
+    if (get_espa_schema () == NULL)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+
+    /* Cut the jobs to those which fit in the memory budget */
+    budget = espa_mem_budget ();
+    if (budget > 0 && njobs > 1)
+    {
+        for (i = 0; i < nproducts; i++)
+        {
+            nbytes = order_product_bytes (&products[i], queue_blocks);
+            if (nbytes > max_bytes)
+                max_bytes = nbytes;
+        }
+        if (max_bytes > 0)
+        {
+            fitted = espa_mem_fit_count (max_bytes, njobs, 1);
+            if (fitted < njobs)
+            {
+                sprintf (errmsg, "Only %d of the %d jobs fit in the memory "
+                    "budget", fitted, njobs);
+                error_handler (false, FUNC_NAME, errmsg);
+                njobs = fitted;
+            }
+        }
+    }
+
+    /* Share the progress with the workers */
+    if (njobs > 1)
+    {
+        shared = mmap (NULL, sizeof (Order_progress_t),
+            PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        if (shared == MAP_FAILED)
+        {
+            sprintf (errmsg, "Unable to share the progress of the order; "
+                "the products will be exported one at a time");
+            error_handler (false, FUNC_NAME, errmsg);
+            njobs = 1;
+        }
+        else
+            progress = shared;
+    }
+    progress->next = 0;
+    progress->nfailed = 0;
+
+    if (njobs > 1)
+    {
+        pids = malloc (njobs * sizeof (pid_t));
+        if (pids == NULL)
+        {
+            sprintf (errmsg, "Allocating memory for the worker processes");
+            error_handler (true, FUNC_NAME, errmsg);
+            munmap (shared, sizeof (Order_progress_t));
+            return (ERROR);
+        }
+
+        nthreads = espa_task_pool_threads () / njobs;
+        if (nthreads < 1)
+            nthreads = 1;
+
+        /* Flush the output so the workers don't repeat it */
+        fflush (stdout);
+        fflush (stderr);
+        for (i = 0; i < njobs; i++)
+        {
+            pids[i] = fork ();
+            if (pids[i] == 0)
+            {
+                /* Worker; keep its lines whole among the other workers',
+                   and hold it to its share of the threads and memory */
+                setvbuf (stdout, NULL, _IOLBF, 0);
+                espa_task_pool_set_threads (nthreads);
+                if (budget > 0)
+                    espa_mem_set_budget_mb (budget / njobs /
+                        (1024.0 * 1024.0));
+                export_order_share (nproducts, products, queue_blocks,
+                    progress);
+                exit (EXIT_SUCCESS);
+            }
+            else if (pids[i] < 0)
+            {
+                sprintf (errmsg, "Unable to fork worker %d; the products "
+                    "will be exported by the other workers", i);
+                error_handler (false, FUNC_NAME, errmsg);
+            }
+        }
+
+        for (i = 0; i < njobs; i++)
+        {
+            if (pids[i] < 0)
+                continue;
+            if (waitpid (pids[i], &wstatus, 0) < 0 || !WIFEXITED (wstatus) ||
+                WEXITSTATUS (wstatus) != EXIT_SUCCESS)
+            {
+                sprintf (errmsg, "Worker %d died while exporting a "
+                    "product", i);
+                error_handler (true, FUNC_NAME, errmsg);
+                nfailed++;
+            }
+        }
+        free (pids);
+    }
+
+    /* Export the products the workers didn't take, which are all of them
+       without workers */
+    export_order_share (nproducts, products, queue_blocks, progress);
+    nfailed += progress->nfailed;
+    if (shared != MAP_FAILED)
+        munmap (shared, sizeof (Order_progress_t));
+
+    if (nfailed > 0)
+    {
+        sprintf (errmsg, "Not all of the %d products were exported",
+            nproducts);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
@@ -0,0 +1,83 @@
+/*****************************************************************************
+FILE: espa_export_order.h
+
+PURPOSE: Contains defines, structures, and prototypes for exporting an order,
+a manifest of ESPA products each exported to one or more formats, converting
+several products at a time.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The manifest has one product per line: the XML metadata filename of the
+     product, then format=output for each format it is exported to (ex.
+     gtif=LC08_base netcdf=LC08.nc), then any of the flags no_compression
+     and del_src.  Blank lines and lines starting with # are skipped.
+  2. Each product is exported as by convert_espa_to_formats, reading its
+     bands once for all of its formats (see espa_export_fanout.h).
+  3. The HDF4, NetCDF/HDF5, and GCTP libraries aren't re-entrant, so the
+     products are exported in parallel by worker processes forked from the
+     caller rather than by threads, as for a batch of granules (see
+     espa_granule_batch.h).  Each worker takes the next product not yet
+     taken, so a large product doesn't hold up the products behind it.
+  4. The jobs share the thread cap of the task pool (see espa_task_pool.h)
+     and the memory budget (see espa_trace.h): each worker gets its share
+     of both, and with a budget the number of jobs is cut to those whose
+     fan-out buffers fit for the largest product.
+*****************************************************************************/
+
+#ifndef ESPA_EXPORT_ORDER_H
+#define ESPA_EXPORT_ORDER_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include "error_handler.h"
+#include "espa_metadata.h"
+#include "espa_export_registry.h"
+
+/* Most export formats of a product in the manifest */
+#define ESPA_ORDER_MAX_FORMATS 8
+
+/* Product of an order */
+typedef struct
+{
+    char *xml_file;        /* XML metadata filename of the product */
+    int nformats;          /* number of formats the product is exported to */
+    char *formats[ESPA_ORDER_MAX_FORMATS];  /* name of each format, in the
+                                              registry */
+    char *outfiles[ESPA_ORDER_MAX_FORMATS]; /* output of each format (base
+                                              filename for GeoTIFF) */
+    bool no_compression;   /* leave the outputs uncompressed? */
+    bool del_src;          /* remove the source files once exported? */
+} Espa_order_product_t;
+
+/* Prototypes */
+int read_espa_order
+(
+    char *manifest,        /* I: name of the manifest of the order */
+    int *nproducts,        /* O: number of products in the order */
+    Espa_order_product_t **products  /* O: products of the order; freed
+                                           with free_espa_order */
+);
+
+void free_espa_order
+(
+    int nproducts,         /* I: number of products in the order */
+    Espa_order_product_t *products  /* I: products of the order */
+);
+
+int export_espa_order
+(
+    int nproducts,         /* I: number of products in the order */
+    Espa_order_product_t *products, /* I: products of the order */
+    int njobs,             /* I: most products exported at a time; 0 for the
+                                 thread cap of the task pool */
+    int queue_blocks       /* I: number of blocks in flight in the fan-out
+                                 of each product */
+);
+
+#endif
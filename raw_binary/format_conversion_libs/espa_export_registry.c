@@ -0,0 +1,612 @@
+/*****************************************************************************
+FILE: espa_export_registry.c
+
+PURPOSE: Contains functions for the registry of the export formats, setting
+up the export sink of a format by its name and loading its plugin on demand.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The plugins are opened with RTLD_LOCAL, so the HDF4 and NetCDF
+     libraries of two plugins don't clash, and are never closed, since the
+     functions of their sinks may be called up to the end of the export.
+     Opening a plugin again returns the handle already loaded.
+  2. The tools built with plugins are linked with -rdynamic, so the
+     plugins use the trace, buffer pool, and metadata functions of the tool
+     rather than their own copies.
+  3. The GeoTIFF, NetCDF, and HDF libraries go back to update the headers
+     and indexes of their files, so an output named by a URL (see
+     espa_upload.h) is written to a scratch directory and each of its files
+     is uploaded once the format is finished.
+*****************************************************************************/
+
+#include <strings.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#ifdef HAVE_PLUGINS
+#include <dlfcn.h>
+#endif
+#include "espa_export_registry.h"
+#include "espa_remote.h"
+#include "espa_upload.h"
+#include "espa_staging.h"
+
+/* Directory the plugins are installed to */
+#ifndef ESPA_PLUGIN_PATH
+#define ESPA_PLUGIN_PATH ""
+#endif
+
+/* Entry point of a format linked into the tool; NULL with plugins, so the
+   tool doesn't link the format */
+#ifdef HAVE_PLUGINS
+#define EXPORT_ENTRY(func) NULL
+#else
+#define EXPORT_ENTRY(func) func
+#endif
+
+/* Export format known to the registry */
+typedef struct
+{
+    const char *name;      /* name of the format */
+    const char *plugin;    /* file of the plugin holding the format */
+    const char *symbol;    /* name of the entry point in the plugin */
+    Espa_export_entry_t entry;  /* entry point linked into the tool */
+} Export_format_t;
+
+static const Export_format_t export_formats[] =
+{
+    {"gtif", "espa_export_gtif.so", "gtif_export_entry",
+        EXPORT_ENTRY (gtif_export_entry)},
+    {"netcdf", "espa_export_netcdf.so", "netcdf_export_entry",
+        EXPORT_ENTRY (netcdf_export_entry)},
+    {"hdf", "espa_export_hdf.so", "hdf_export_entry",
+        EXPORT_ENTRY (hdf_export_entry)}
+};
+
+#define NUM_EXPORT_FORMATS \
+    ((int) (sizeof (export_formats) / sizeof (export_formats[0])))
+
+/* Export to object storage, wrapping the sink of the format */
+typedef struct
+{
+    Espa_export_sink_t sink;   /* sink of the format, writing the outputs
+                                  to local_dir */
+    char local_dir[STR_SIZE];  /* scratch directory of the outputs */
+    char remote_dir[STR_SIZE]; /* URL the outputs are uploaded under, ending
+                                  with a '/' */
+} Remote_export_t;
+
+
+/******************************************************************************
+MODULE: find_export_format
+
+PURPOSE: Looks up an export format by its name.
+
+RETURN VALUE:
+Type = const Export_format_t *
+Value        Description
+-----        -----------
+NULL         The format isn't known
+format       Entry of the format in the registry
+
+NOTES:
+******************************************************************************/
+static const Export_format_t *find_export_format
+(
+    const char *format     /* I: name of the export format */
+)
+{
+    int i;                 /* looping variable for the formats */
+
+    for (i = 0; i < NUM_EXPORT_FORMATS; i++)
+        if (!strcasecmp (format, export_formats[i].name))
+            return &export_formats[i];
+
+    return NULL;
+}
+
+
+#ifdef HAVE_PLUGINS
+/******************************************************************************
+MODULE: load_export_plugin
+
+PURPOSE: Loads the plugin of an export format and looks up its entry point.
+
+RETURN VALUE:
+Type = Espa_export_entry_t
+Value        Description
+-----        -----------
+NULL         Error loading the plugin
+entry        Entry point of the format
+
+NOTES:
+  1. The directory of ESPA_PLUGIN_DIR_ENV is tried first, then the install
+     directory, then the search paths of the dynamic loader.
+******************************************************************************/
+static Espa_export_entry_t load_export_plugin
+(
+    const Export_format_t *fmt  /* I: export format */
+)
+{
+    char FUNC_NAME[] = "load_export_plugin";  /* function name */
+    char errmsg[STR_SIZE];     /* error message */
+    char path[STR_SIZE];       /* path of the plugin */
+    char loaderr[STR_SIZE] = "not found";  /* first error of the dynamic
+                                  loader */
+    const char *dirs[2];       /* directories searched for the plugin */
+    const char *err = NULL;    /* error of the dynamic loader */
+    bool failed = false;       /* did the dynamic loader fail? */
+    void *handle = NULL;       /* handle of the plugin */
+    void *sym = NULL;          /* entry point of the plugin */
+    int count;                 /* number of chars copied in snprintf */
+    int i;                     /* looping variable for the directories */
+
+    dirs[0] = getenv (ESPA_PLUGIN_DIR_ENV);
+    dirs[1] = ESPA_PLUGIN_PATH;
+    for (i = 0; i < 2 && handle == NULL; i++)
+    {
+        if (dirs[i] == NULL || dirs[i][0] == '\0')
+            continue;
+        count = snprintf (path, sizeof (path), "%s/%s", dirs[i],
+            fmt->plugin);
+        if (count < 0 || count >= sizeof (path))
+            continue;
+        handle = dlopen (path, RTLD_NOW | RTLD_LOCAL);
+        if (handle == NULL && !failed && (err = dlerror ()) != NULL)
+        {
+            /* The message is overwritten by the next call of the loader */
+            snprintf (loaderr, sizeof (loaderr), "%s", err);
+            failed = true;
+        }
+    }
+    if (handle == NULL)
+    {
+        handle = dlopen (fmt->plugin, RTLD_NOW | RTLD_LOCAL);
+        if (handle == NULL && !failed && (err = dlerror ()) != NULL)
+            snprintf (loaderr, sizeof (loaderr), "%s", err);
+    }
+    if (handle == NULL)
+    {
+        snprintf (errmsg, sizeof (errmsg), "Loading the %s plugin %s: %.1000s",
+            fmt->name, fmt->plugin, loaderr);
+        error_handler (true, FUNC_NAME, errmsg);
+        return NULL;
+    }
+
+    dlerror ();
+    sym = dlsym (handle, fmt->symbol);
+    if (sym == NULL)
+    {
+        sprintf (errmsg, "Finding %s in the %s plugin", fmt->symbol,
+            fmt->name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return NULL;
+    }
+
+    return (Espa_export_entry_t) sym;
+}
+#endif
+
+
+/******************************************************************************
+MODULE: espa_export_format_count
+
+PURPOSE: Returns the number of export formats in the registry.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+count        Number of export formats
+
+NOTES:
+******************************************************************************/
+int espa_export_format_count (void)
+{
+    return NUM_EXPORT_FORMATS;
+}
+
+
+/******************************************************************************
+MODULE: espa_export_format_name
+
+PURPOSE: Returns the name of an export format of the registry.
+
+RETURN VALUE:
+Type = const char *
+Value        Description
+-----        -----------
+NULL         The index is out of range
+name         Name of the format
+
+NOTES:
+******************************************************************************/
+const char *espa_export_format_name
+(
+    int index              /* I: index of the format in the registry */
+)
+{
+    if (index < 0 || index >= NUM_EXPORT_FORMATS)
+        return NULL;
+    return export_formats[index].name;
+}
+
+
+/******************************************************************************
+MODULE: espa_export_format_known
+
+PURPOSE: Checks whether an export format is in the registry, without loading
+its plugin.
+
+RETURN VALUE:
+Type = bool
+Value        Description
+-----        -----------
+true         The format is in the registry
+false        The format isn't known
+
+NOTES:
+******************************************************************************/
+bool espa_export_format_known
+(
+    const char *format     /* I: name of the export format */
+)
+{
+    return find_export_format (format) != NULL;
+}
+
+
+/******************************************************************************
+MODULE: remote_needs_band
+
+PURPOSE: Checks whether the sink of the format of an export to object
+storage writes a band.
+
+RETURN VALUE:
+Type = bool
+Value        Description
+-----        -----------
+true         The sink writes the band
+false        The band is skipped
+
+NOTES:
+******************************************************************************/
+static bool remote_needs_band
+(
+    void *state,                        /* I: export to object storage */
+    Espa_internal_meta_t *xml_metadata, /* I: XML metadata structure */
+    int band                            /* I: index of the band */
+)
+{
+    Remote_export_t *remote = state;    /* export to object storage */
+
+    if (remote->sink.needs_band == NULL)
+        return true;
+    return remote->sink.needs_band (remote->sink.state, xml_metadata, band);
+}
+
+
+/******************************************************************************
+MODULE: remote_begin_band
+
+PURPOSE: Starts the output of a band for an export to object storage.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error starting the band
+SUCCESS      Successfully started the band
+
+NOTES:
+******************************************************************************/
+static int remote_begin_band
+(
+    void *state,                        /* I/O: export to object storage */
+    Espa_internal_meta_t *xml_metadata, /* I: XML metadata structure */
+    int band                            /* I: index of the band */
+)
+{
+    Remote_export_t *remote = state;    /* export to object storage */
+
+    return remote->sink.begin_band (remote->sink.state, xml_metadata, band);
+}
+
+
+/******************************************************************************
+MODULE: remote_write_block
+
+PURPOSE: Writes a block of lines of a band for an export to object storage.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error writing the block
+SUCCESS      Successfully wrote the block
+
+NOTES:
+******************************************************************************/
+static int remote_write_block
+(
+    void *state,                        /* I/O: export to object storage */
+    Espa_internal_meta_t *xml_metadata, /* I: XML metadata structure */
+    int band,                           /* I: index of the band */
+    Espa_band_block_t *block            /* I: block of lines */
+)
+{
+    Remote_export_t *remote = state;    /* export to object storage */
+
+    return remote->sink.write_block (remote->sink.state, xml_metadata, band,
+        block);
+}
+
+
+/******************************************************************************
+MODULE: remote_end_band
+
+PURPOSE: Completes the output of a band for an export to object storage.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error completing the band
+SUCCESS      Successfully completed the band
+
+NOTES:
+******************************************************************************/
+static int remote_end_band
+(
+    void *state,                        /* I/O: export to object storage */
+    Espa_internal_meta_t *xml_metadata, /* I: XML metadata structure */
+    int band                            /* I: index of the band */
+)
+{
+    Remote_export_t *remote = state;    /* export to object storage */
+
+    return remote->sink.end_band (remote->sink.state, xml_metadata, band);
+}
+
+
+/******************************************************************************
+MODULE: remote_finish
+
+PURPOSE: Finishes the format of an export to object storage, uploads the
+files it wrote, and removes the scratch directory.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error finishing the format or uploading its files
+SUCCESS      Successfully uploaded the outputs
+
+NOTES:
+  1. The local files are removed whether or not they were uploaded.
+******************************************************************************/
+static int remote_finish
+(
+    void *state,                        /* I: export to object storage */
+    Espa_internal_meta_t *xml_metadata, /* I: XML metadata structure */
+    bool complete          /* I: were all the bands written by every sink? */
+)
+{
+    char FUNC_NAME[] = "remote_finish";  /* function name */
+    char errmsg[STR_SIZE];     /* error message */
+    char local_file[STR_SIZE]; /* name of a local output file */
+    char remote_file[STR_SIZE];  /* URL of the output file */
+    int count;                 /* number of chars copied in snprintf */
+    int status;                /* status of the finish */
+    DIR *dir = NULL;           /* scratch directory */
+    struct dirent *entry = NULL;  /* file in the scratch directory */
+    Remote_export_t *remote = state;    /* export to object storage */
+
+    status = remote->sink.finish (remote->sink.state, xml_metadata,
+        complete);
+
+    dir = opendir (remote->local_dir);
+    while (dir != NULL && (entry = readdir (dir)) != NULL)
+    {
+        if (!strcmp (entry->d_name, ".") || !strcmp (entry->d_name, ".."))
+            continue;
+        snprintf (local_file, sizeof (local_file), "%s/%s",
+            remote->local_dir, entry->d_name);
+        count = snprintf (remote_file, sizeof (remote_file), "%s%s",
+            remote->remote_dir, entry->d_name);
+        if (complete && status == SUCCESS)
+        {
+            printf ("  Uploading %s\n", remote_file);
+            if (count < 0 || count >= sizeof (remote_file) ||
+                upload_espa_file (local_file, remote_file) != SUCCESS)
+            {
+                snprintf (errmsg, sizeof (errmsg), "Uploading the %s output "
+                    "%s", remote->sink.name, local_file);
+                error_handler (true, FUNC_NAME, errmsg);
+                status = ERROR;
+            }
+        }
+        unlink (local_file);
+    }
+    if (dir != NULL)
+        closedir (dir);
+    rmdir (remote->local_dir);
+
+    free (remote);
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE: init_remote_export_sink
+
+PURPOSE: Sets up the sink of a format for an output named by a URL, writing
+the output to a scratch directory to be uploaded when the sink is finished.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error creating the scratch directory, or setting up the sink
+SUCCESS         Successfully set up the sink
+
+NOTES:
+  1. The scratch directory is made in the staging directory (see
+     espa_staging.h) if there is one, since it is local and fast, and
+     otherwise in $TMPDIR or /tmp.
+  2. The output keeps the name at the end of the URL, so each file the
+     format writes (ex. the GeoTIFF of each band, and the XML metadata) is
+     uploaded alongside it.
+******************************************************************************/
+static int init_remote_export_sink
+(
+    const Export_format_t *fmt,  /* I: export format */
+    Espa_export_entry_t entry,   /* I: entry point of the format */
+    char *out_file,        /* I: URL of the output (base URL for GeoTIFF) */
+    Espa_internal_meta_t *xml_metadata, /* I: XML metadata structure */
+    const Espa_export_options_t *options,  /* I: export options */
+    Espa_export_sink_t *sink  /* O: export sink */
+)
+{
+    char FUNC_NAME[] = "init_remote_export_sink";  /* function name */
+    char errmsg[STR_SIZE];     /* error message */
+    char local_file[STR_SIZE]; /* name of the local output */
+    const char *base = NULL;   /* name of the output at the end of the URL */
+    const char *tmp_dir = NULL;  /* directory of the scratch directory */
+    int count;                 /* number of chars copied in snprintf */
+    Remote_export_t *remote = NULL;  /* export to object storage */
+
+    base = strrchr (out_file, '/');
+    if (base == NULL || base[1] == '\0' ||
+        base - out_file + 1 >= STR_SIZE)
+    {
+        snprintf (errmsg, sizeof (errmsg), "Invalid URL of the %s output: "
+            "%s", fmt->name, out_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    base++;
+
+    remote = calloc (1, sizeof (Remote_export_t));
+    if (remote == NULL)
+    {
+        sprintf (errmsg, "Allocating the export to object storage");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    snprintf (remote->remote_dir, sizeof (remote->remote_dir), "%.*s",
+        (int) (base - out_file), out_file);
+
+    tmp_dir = espa_staging_enabled () ? getenv (ESPA_STAGING_DIR_ENV) :
+        getenv ("TMPDIR");
+    if (tmp_dir == NULL || tmp_dir[0] == '\0')
+        tmp_dir = "/tmp";
+    count = snprintf (remote->local_dir, sizeof (remote->local_dir),
+        "%s/espa_export.XXXXXX", tmp_dir);
+    if (count < 0 || count >= sizeof (remote->local_dir) ||
+        mkdtemp (remote->local_dir) == NULL)
+    {
+        snprintf (errmsg, sizeof (errmsg), "Creating the scratch directory "
+            "of the %s output in %s", fmt->name, tmp_dir);
+        error_handler (true, FUNC_NAME, errmsg);
+        free (remote);
+        return (ERROR);
+    }
+    count = snprintf (local_file, sizeof (local_file), "%s/%s",
+        remote->local_dir, base);
+    if (count < 0 || count >= sizeof (local_file) ||
+        entry (local_file, xml_metadata, options, &remote->sink) != SUCCESS)
+    {
+        sprintf (errmsg, "Setting up the %s export to object storage",
+            fmt->name);
+        error_handler (true, FUNC_NAME, errmsg);
+        rmdir (remote->local_dir);
+        free (remote);
+        return (ERROR);
+    }
+
+    memset (sink, 0, sizeof (*sink));
+    snprintf (sink->name, sizeof (sink->name), "%s", remote->sink.name);
+    sink->state = remote;
+    sink->needs_band = remote_needs_band;
+    sink->begin_band = remote_begin_band;
+    sink->write_block = remote_write_block;
+    sink->end_band = remote_end_band;
+    sink->finish = remote_finish;
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE: init_export_sink
+
+PURPOSE: Sets up the export sink of a format, loading the plugin of the
+format if the tools are built with plugins.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Unknown format, error loading its plugin, or error setting
+                up the sink
+SUCCESS         Successfully set up the sink
+
+NOTES:
+  1. The sink is fed by export_espa_fanout and finished as any other sink.
+  2. An output named by a URL is uploaded when the sink is finished.
+******************************************************************************/
+int init_export_sink
+(
+    const char *format,    /* I: name of the export format (gtif, netcdf, or
+                                 hdf) */
+    char *out_file,        /* I: output filename (base filename for
+                                 GeoTIFF) */
+    Espa_internal_meta_t *xml_metadata, /* I: XML metadata structure */
+    const Espa_export_options_t *options,  /* I: export options */
+    Espa_export_sink_t *sink  /* O: export sink */
+)
+{
+    char FUNC_NAME[] = "init_export_sink";  /* function name */
+    char errmsg[STR_SIZE];     /* error message */
+    const Export_format_t *fmt = NULL;  /* format in the registry */
+    Espa_export_entry_t entry = NULL;   /* entry point of the format */
+
+    fmt = find_export_format (format);
+    if (fmt == NULL)
+    {
+        snprintf (errmsg, sizeof (errmsg), "Unknown export format: %s",
+            format);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+#ifdef HAVE_PLUGINS
+    entry = load_export_plugin (fmt);
+#else
+    entry = fmt->entry;
+#endif
+    if (entry == NULL)
+    {
+        sprintf (errmsg, "Loading the %s export format", fmt->name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    if (is_remote_file (out_file))
+        return (init_remote_export_sink (fmt, entry, out_file, xml_metadata,
+            options, sink));
+
+    if (entry (out_file, xml_metadata, options, sink) != SUCCESS)
+    {
+        sprintf (errmsg, "Setting up the %s export", fmt->name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
@@ -0,0 +1,103 @@
+/*****************************************************************************
+FILE: espa_export_registry.h
+
+PURPOSE: Contains defines, structures, and prototypes for the registry of the
+export formats, which sets up the export sink of a format by its name and,
+when the tools are built with plugins, loads the format on demand.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. Built with ENABLE_PLUGINS (see make.config), each export format is a
+     plugin (a shared object holding its converter and linked with its
+     format libraries), which is loaded with dlopen the first time the
+     format is used.  A tool which only goes through the registry then
+     doesn't link, relocate, or initialize the GeoTIFF, NetCDF/HDF5, or
+     HDF4/HDF-EOS libraries unless it exports to their formats.
+  2. The plugins are looked for in the directory named by
+     ESPA_PLUGIN_DIR_ENV if set, then in the directory they are installed
+     to, then in the paths searched by the dynamic loader.
+  3. Without plugins, the registry calls the converters linked into the
+     tool, so the tool behaves the same either way.
+*****************************************************************************/
+
+#ifndef ESPA_EXPORT_REGISTRY_H
+#define ESPA_EXPORT_REGISTRY_H
+
+#include "espa_export_fanout.h"
+
+/* Environment variable naming the directory of the plugins */
+#define ESPA_PLUGIN_DIR_ENV "ESPA_PLUGIN_DIR"
+
+/* Options of the export formats; each format uses those it supports */
+typedef struct
+{
+    int block_lines;       /* number of lines per block of the fan-out */
+    bool no_compression;   /* leave the output uncompressed? (NetCDF) */
+} Espa_export_options_t;
+
+/* Entry point of an export format, setting up its sink.  Each plugin
+   exports the entry point named in the registry. */
+typedef int (*Espa_export_entry_t)
+(
+    char *out_file,        /* I: output filename (base filename for
+                                 GeoTIFF) */
+    Espa_internal_meta_t *xml_metadata, /* I: XML metadata structure */
+    const Espa_export_options_t *options,  /* I: export options */
+    Espa_export_sink_t *sink  /* O: export sink */
+);
+
+/* Prototypes */
+int espa_export_format_count (void);
+
+const char *espa_export_format_name
+(
+    int index              /* I: index of the format in the registry */
+);
+
+bool espa_export_format_known
+(
+    const char *format     /* I: name of the export format */
+);
+
+int init_export_sink
+(
+    const char *format,    /* I: name of the export format (gtif, netcdf, or
+                                 hdf) */
+    char *out_file,        /* I: output filename (base filename for
+                                 GeoTIFF) */
+    Espa_internal_meta_t *xml_metadata, /* I: XML metadata structure */
+    const Espa_export_options_t *options,  /* I: export options */
+    Espa_export_sink_t *sink  /* O: export sink */
+);
+
+/* Entry points of the formats; see convert_espa_to_gtif.c,
+   convert_espa_to_netcdf.c, and convert_espa_to_hdf.c */
+int gtif_export_entry
+(
+    char *out_file,        /* I: base output GeoTIFF filename */
+    Espa_internal_meta_t *xml_metadata, /* I: XML metadata structure */
+    const Espa_export_options_t *options,  /* I: export options */
+    Espa_export_sink_t *sink  /* O: GeoTIFF export sink */
+);
+
+int netcdf_export_entry
+(
+    char *out_file,        /* I: output NetCDF filename */
+    Espa_internal_meta_t *xml_metadata, /* I: XML metadata structure */
+    const Espa_export_options_t *options,  /* I: export options */
+    Espa_export_sink_t *sink  /* O: NetCDF export sink */
+);
+
+int hdf_export_entry
+(
+    char *out_file,        /* I: output HDF filename */
+    Espa_internal_meta_t *xml_metadata, /* I: XML metadata structure */
+    const Espa_export_options_t *options,  /* I: export options */
+    Espa_export_sink_t *sink  /* O: HDF export sink */
+);
+
+#endif
@@ -13,8 +13,11 @@ LICENSE TYPE:  NASA Open Source Agreement Version 1.3
 NOTES:
 1. Geodetic coordinates are the geodetic latitude and longitude of the point
    to be mapped. Geodetic cooridnates are in radians.
-2. Only one space mapping definition (instance) should be used at any one
-   time because the GCTP package is not re-entrant.
+2. The GCTP package is not re-entrant; it holds the parameters of the last
+   forward and inverse transforms initialized.  Each space mapping
+   definition (instance) initializes the transform it needs the first time
+   it maps a point after another instance has (see init_transform), so
+   instances may be used in turn but not from several threads at once.
 3. Image coordinates are in pixels with the origin (0.0, 0.0) at the center
    of the upper left corner pixel.  Sample coordinates are positive to the
    right and line coordinates are positive downward.
@@ -28,12 +31,15 @@ NOTES:
 *****************************************************************************/
 
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
 #include "espa_geoloc.h"
 
 /* Constants */
 #define MAX_PROJ (99)  /* Maximum map projection number */
 #define GCTP_OK 0    /* Okay status return from the GCTP package */
+#define BOUNDS_EDGE_STEP 64  /* Step in pixels between the points of the
+                                coarse search along the image edges */
 
 /* Prototypes for initializing the GCTP projections */
 int for_init (int outsys, int outzone, double *outparm, int outdatum, 
@@ -42,7 +48,12 @@ int for_init (int outsys, int outzone, double *outparm, int outdatum,
 int inv_init (int insys, int inzone, double *inparm, int indatum,
     char *fn27, char *fn83, int *iflg,
     int (*inv_trans[])(double, double, double*, double*));
- 
+
+/* Identifies the mappings set up, and those GCTP was last initialized for */
+static unsigned long geoloc_last_id = 0;
+static unsigned long geoloc_for_id = 0;
+static unsigned long geoloc_inv_id = 0;
+
 
 /******************************************************************************
 MODULE:  setup_mapping
@@ -65,6 +76,10 @@ NOTES:
    routine to free the memory for this pointer.
 2. Make sure the corners Space_def_t are reported as the upper left of the
    the since that's what the other routines are expecting.
+3. GCTP isn't initialized here, but for each direction when it is first
+   mapped (see init_transform), so a tool which only maps one way doesn't
+   set up the other, and the projection parameters are only checked by
+   GCTP then.
 ******************************************************************************/
 Geoloc_t *setup_mapping
 (
@@ -73,16 +88,9 @@ Geoloc_t *setup_mapping
 {
     char FUNC_NAME[] = "setup_mapping"; /* function name */
     char errmsg[STR_SIZE];              /* error message */
-    char file27[] = "FILE27";           /* file for NAD27 (only for State Plane)
-                                           so just use something fake for now */
-    char file83[] = "FILE83";           /* file for NAD83 (only for State Plane)
-                                           so just use something fake for now */
     Geoloc_t *this = NULL;              /* pointer to the space structure */
     double temp1, temp2;                /* temp variables for PS projection */
     int i;                              /* looping variable */
-    int iflag;                          /* return status from GCTP */
-    int (*for_trans[MAX_PROJ + 1])();   /* forward transformation function */
-    int (*inv_trans[MAX_PROJ + 1])();   /* inverse transformation function */
   
     /* Verify some of the space definition parameters */
     if (space_def->img_size.l < 1) 
@@ -197,33 +205,93 @@ Geoloc_t *setup_mapping
         }
         this->def.proj_param[4] = temp1;
     }
-     
-    /* Setup the forward transform */
-    for_init (this->def.proj_num, this->def.zone, this->def.proj_param, 
-        this->def.spheroid, file27, file83, &iflag, for_trans);
-    if (iflag)
+
+    /* The GCTP transforms are initialized when they are first used */
+    this->id = ++geoloc_last_id;
+    this->for_trans = NULL;
+    this->inv_trans = NULL;
+  
+    /* Successful completion */
+    return (this);
+}
+
+
+/******************************************************************************
+MODULE:  init_transform
+
+PURPOSE:  Initializes the GCTP forward or inverse transform of a mapping, if
+GCTP was last initialized for another mapping.
+
+RETURN VALUE:
+Type = bool
+Value      Description
+-----      -----------
+false      Error returned from GCTP
+true       The transform is ready
+
+NOTES:
+1. The NAD27 and NAD83 state plane parameter files are only named for the
+   state plane projection, which is the only one GCTP reads them for.  None
+   of the ESPA projections use them.
+******************************************************************************/
+static bool init_transform
+(
+    Geoloc_t *this,          /* I/O: geolocation structure */
+    bool forward             /* I: forward (true) or inverse (false)
+                                   transform? */
+)
+{
+    char FUNC_NAME[] = "init_transform"; /* function name */
+    char errmsg[STR_SIZE];              /* error message */
+    char file27[] = "FILE27";           /* file for NAD27 (only for State Plane)
+                                           so just use something fake for now */
+    char file83[] = "FILE83";           /* file for NAD83 (only for State Plane)
+                                           so just use something fake for now */
+    char *nad27 = NULL;                 /* NAD27 file passed to GCTP */
+    char *nad83 = NULL;                 /* NAD83 file passed to GCTP */
+    int iflag;                          /* return status from GCTP */
+    int (*for_trans[MAX_PROJ + 1])();   /* forward transformation function */
+    int (*inv_trans[MAX_PROJ + 1])();   /* inverse transformation function */
+
+    if ((forward ? geoloc_for_id : geoloc_inv_id) == this->id)
+        return (true);
+
+    if (this->def.proj_num == GCTP_SPCS_PROJ)
     {
-        free (this);
-        sprintf (errmsg, "Error returned from for_init");
-        error_handler (true, FUNC_NAME, errmsg);
-        return (NULL);
+        nad27 = file27;
+        nad83 = file83;
     }
-    this->for_trans = for_trans[this->def.proj_num];
-  
-    /* Setup the inverse transform */
-    inv_init (this->def.proj_num, this->def.zone, this->def.proj_param, 
-        this->def.spheroid, file27, file83, &iflag, inv_trans);
-    if (iflag)
+
+    if (forward)
     {
-        free (this);
-        sprintf (errmsg, "Error returned from for_init");
-        error_handler (true, FUNC_NAME, errmsg);
-        return (NULL);
+        /* Setup the forward transform */
+        for_init (this->def.proj_num, this->def.zone, this->def.proj_param, 
+            this->def.spheroid, nad27, nad83, &iflag, for_trans);
+        if (iflag)
+        {
+            sprintf (errmsg, "Error returned from for_init");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (false);
+        }
+        this->for_trans = for_trans[this->def.proj_num];
+        geoloc_for_id = this->id;
     }
-    this->inv_trans = inv_trans[this->def.proj_num];
-  
-    /* Successful completion */
-    return (this);
+    else
+    {
+        /* Setup the inverse transform */
+        inv_init (this->def.proj_num, this->def.zone, this->def.proj_param, 
+            this->def.spheroid, nad27, nad83, &iflag, inv_trans);
+        if (iflag)
+        {
+            sprintf (errmsg, "Error returned from inv_init");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (false);
+        }
+        this->inv_trans = inv_trans[this->def.proj_num];
+        geoloc_inv_id = this->id;
+    }
+
+    return (true);
 }
 
 
@@ -247,7 +315,7 @@ NOTES:
 ******************************************************************************/
 bool to_space
 (
-    Geoloc_t *this,          /* I: geolocation structure; for_trans function
+    Geoloc_t *this,          /* I/O: geolocation structure; for_trans function
                                    is used for the forward mapping */
     Geo_coord_t *geo,        /* I: geodetic coordinates (radians) */
     Img_coord_float_t *img   /* O: image coordinates (for UL corner of pixel) */
@@ -270,6 +338,8 @@ bool to_space
     }
 
     /* Do the forward mapping */
+    if (!init_transform (this, true))
+        return (false);
     if (this->for_trans (geo->lon, geo->lat, &map.x, &map.y) != GCTP_OK) 
     {
         sprintf (errmsg, "Geodetic coordinate failed the forward mapping.");
@@ -313,7 +383,7 @@ NOTES:
 ******************************************************************************/
 bool from_space
 (
-    Geoloc_t *this,          /* I: geolocation structure; inv_trans function
+    Geoloc_t *this,          /* I/O: geolocation structure; inv_trans function
                                    is used for the inverse mapping */
     Img_coord_float_t *img,  /* I: image coordinates (for UL corner of pixel) */
     Geo_coord_t *geo         /* O: geodetic coordinates (radians) */
@@ -346,6 +416,8 @@ bool from_space
     map.x = this->def.ul_corner.x + dx;
 
     /* Do the inverse mapping */
+    if (!init_transform (this, false))
+        return (false);
     if (this->inv_trans (map.x, map.y, &geo->lon, &geo->lat) != GCTP_OK) 
     {
         sprintf (errmsg, "Projection coordinate failed the inverse mapping.");
@@ -359,6 +431,146 @@ bool from_space
 }
 
 
+/******************************************************************************
+MODULE:  to_space_array
+
+PURPOSE:  Maps an array of points from geodetic coordinates to line, sample
+space.
+
+RETURN VALUE:
+Type = bool
+Value      Description
+-----      -----------
+false      Error occurred in the mapping
+true       Successful mapping
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+1. Report image coordinates for the UL corner of the pixel.
+2. The coordinates are passed as separate arrays of each component, and each
+   point is mapped the same as 'to_space'.  The mapping stops at the first
+   point that fails.
+******************************************************************************/
+bool to_space_array
+(
+    Geoloc_t *this,          /* I/O: geolocation structure; for_trans function
+                                   is used for the forward mapping */
+    int npts,                /* I: number of points to map */
+    const double *lon,       /* I: geodetic longitudes (radians) */
+    const double *lat,       /* I: geodetic latitudes (radians) */
+    float *line,             /* O: image lines (for UL corner of pixel) */
+    float *samp              /* O: image samples (for UL corner of pixel) */
+)
+{
+    char FUNC_NAME[] = "to_space_array";  /* function name */
+    char errmsg[STR_SIZE];          /* error message */
+    Map_coord_t map;                /* coordinate in projection space */
+    double dx, dy;                  /* delta x, y values */
+    double dl, ds;                  /* delta line, sample values */
+    int i;                          /* looping variable */
+
+    if (npts > 0 && !init_transform (this, true))
+        return (false);
+
+    for (i = 0; i < npts; i++)
+    {
+        /* Do the forward mapping */
+        if (this->for_trans (lon[i], lat[i], &map.x, &map.y) != GCTP_OK) 
+        {
+            sprintf (errmsg, "Geodetic coordinate %d of %d failed the "
+                "forward mapping.", i, npts);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (false);
+        }
+
+        /* Determine the line, sample location from the projection space */
+        dx = map.x - this->def.ul_corner.x;
+        dy = map.y - this->def.ul_corner.y;
+
+        dl = (dx * this->sin_orien) - (dy * this->cos_orien);
+        ds = (dx * this->cos_orien) + (dy * this->sin_orien);
+
+        line[i] = dl / this->def.pixel_size[1];
+        samp[i] = ds / this->def.pixel_size[0];
+    }
+
+    /* Successful completion */
+    return (true);
+}
+
+
+/******************************************************************************
+MODULE:  from_space_array
+
+PURPOSE:  Maps an array of points from line, sample space to geodetic
+coordinates.
+
+RETURN VALUE:
+Type = bool
+Value      Description
+-----      -----------
+false      Error occurred in the mapping
+true       Successful mapping
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+1. Report image coordinates for the UL corner of the pixel.
+2. The coordinates are passed as separate arrays of each component, and each
+   point is mapped the same as 'from_space'.  The mapping stops at the first
+   point that fails.
+******************************************************************************/
+bool from_space_array
+(
+    Geoloc_t *this,          /* I/O: geolocation structure; inv_trans function
+                                   is used for the inverse mapping */
+    int npts,                /* I: number of points to map */
+    const float *line,       /* I: image lines (for UL corner of pixel) */
+    const float *samp,       /* I: image samples (for UL corner of pixel) */
+    double *lon,             /* O: geodetic longitudes (radians) */
+    double *lat              /* O: geodetic latitudes (radians) */
+)
+{
+    char FUNC_NAME[] = "from_space_array";  /* function name */
+    char errmsg[STR_SIZE];            /* error message */
+    Map_coord_t map;                  /* coordinate in projection space */
+    double dx, dy;                    /* delta x, y values */
+    double dl, ds;                    /* delta line, sample values */
+    int i;                            /* looping variable */
+
+    if (npts > 0 && !init_transform (this, false))
+        return (false);
+
+    for (i = 0; i < npts; i++)
+    {
+        /* Determine the line,sample location in projection space */
+        dl = line[i] * this->def.pixel_size[1];
+        ds = samp[i] * this->def.pixel_size[0];
+
+        dy = (ds * this->sin_orien) - (dl * this->cos_orien);
+        dx = (ds * this->cos_orien) + (dl * this->sin_orien);
+
+        map.y = this->def.ul_corner.y + dy;
+        map.x = this->def.ul_corner.x + dx;
+
+        /* Do the inverse mapping */
+        if (this->inv_trans (map.x, map.y, &lon[i], &lat[i]) != GCTP_OK) 
+        {
+            sprintf (errmsg, "Projection coordinate %d of %d failed the "
+                "inverse mapping.", i, npts);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (false);
+        }
+    }
+
+    /* Successful completion */
+    return (true);
+}
+
+
 /******************************************************************************
 MODULE:  get_geoloc_info
 
@@ -526,6 +738,225 @@ bool get_geoloc_info
 }
 
 
+/******************************************************************************
+MODULE:  update_bounds
+
+PURPOSE:  Updates the bounding coordinates with an array of points.
+
+RETURN VALUE:
+Type = None
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+1. For scenes crossing the antimeridian, the western longitude is the lowest
+   value in the eastern hemisphere and the eastern longitude is the highest
+   value in the western hemisphere.
+******************************************************************************/
+static void update_bounds
+(
+    int npts,                 /* I: number of points */
+    const double *lon,        /* I: geodetic longitudes (radians) */
+    const double *lat,        /* I: geodetic latitudes (radians) */
+    bool meridian_crossing,   /* I: does the scene cross the 180th meridian */
+    Geo_bounds_t *bounds      /* I/O: boundary for the scene */
+)
+{
+    int i;                    /* looping variable */
+
+    for (i = 0; i < npts; i++)
+    {
+        /* Save the min/max */
+        bounds->max_lat = max (bounds->max_lat, lat[i]*DEG);
+        bounds->min_lat = min (bounds->min_lat, lat[i]*DEG);
+        if (meridian_crossing)
+        {   /* Looking for the minimum positive longitude (eastern hemisphere
+               and the maximum negative longitude (western hemisphere) */
+            if (lon[i] > 0)
+                bounds->min_lon = min (bounds->min_lon, lon[i]*DEG);
+            if (lon[i] < 0)
+                bounds->max_lon = max (bounds->max_lon, lon[i]*DEG);
+        }
+        else
+        {   /* Standard min/max computation */
+            bounds->max_lon = max (bounds->max_lon, lon[i]*DEG);
+            bounds->min_lon = min (bounds->min_lon, lon[i]*DEG);
+        }
+    }
+}
+
+
+/******************************************************************************
+MODULE:  map_edge_points
+
+PURPOSE:  Maps evenly spaced points along one edge of the image to lat/long.
+
+RETURN VALUE:
+Type = bool
+Value      Description
+-----      -----------
+false      Error occurred in the mapping
+true       Successfully mapped the points
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+1. Edges 0 and 1 are the top and bottom edges, and the points are indexed by
+   sample.  Edges 2 and 3 are the left and right edges, and the points are
+   indexed by line.
+2. The last point is clipped to the far edge of the image.
+******************************************************************************/
+static bool map_edge_points
+(
+    Geoloc_t *space,          /* I: geolocation structure */
+    int nlines,               /* I: number of lines in the scene */
+    int nsamps,               /* I: number of samples in the scene */
+    int edge,                 /* I: edge of the image (top, bottom, left,
+                                    right) */
+    int first,                /* I: index of the first point */
+    int step,                 /* I: step between the points */
+    int npts,                 /* I: number of points to map */
+    float *line,              /* O: image lines of the points */
+    float *samp,              /* O: image samples of the points */
+    double *lon,              /* O: longitudes (radians) of the points */
+    double *lat               /* O: latitudes (radians) of the points */
+)
+{
+    int last = (edge < 2) ? nsamps : nlines;  /* index of the far edge */
+    int index;                /* index of the point along the edge */
+    int i;                    /* looping variable */
+
+    for (i = 0; i < npts; i++)
+    {
+        index = min (first + i * step, last);
+        if (edge < 2)
+        {
+            line[i] = (edge == 0) ? 0.0 : nlines;
+            samp[i] = (double) index;
+        }
+        else
+        {
+            line[i] = (double) index;
+            samp[i] = (edge == 2) ? 0.0 : nsamps;
+        }
+    }
+
+    return (from_space_array (space, npts, line, samp, lon, lat));
+}
+
+
+/******************************************************************************
+MODULE:  bound_edge
+
+PURPOSE:  Updates the bounding coordinates with one edge of the image.  Long
+edges are searched adaptively, mapping every BOUNDS_EDGE_STEP pixels and then
+every pixel around the coarse extremes.
+
+RETURN VALUE:
+Type = bool
+Value      Description
+-----      -----------
+false      Error occurred in the mapping
+true       Successfully updated the bounds
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+1. The buffers must hold max (2 * BOUNDS_EDGE_STEP + 1, edge points /
+   BOUNDS_EDGE_STEP + 2) points.
+2. The lat/long along an edge changes smoothly, so each extreme lies within
+   a step of the coarse point with the extreme value and the search gives the
+   same bounds as mapping every pixel.
+******************************************************************************/
+static bool bound_edge
+(
+    Geoloc_t *space,          /* I: geolocation structure */
+    int nlines,               /* I: number of lines in the scene */
+    int nsamps,               /* I: number of samples in the scene */
+    int edge,                 /* I: edge of the image (top, bottom, left,
+                                    right) */
+    bool meridian_crossing,   /* I: does the scene cross the 180th meridian */
+    float *line,              /* I: buffer for the image lines */
+    float *samp,              /* I: buffer for the image samples */
+    double *lon,              /* I: buffer for the longitudes */
+    double *lat,              /* I: buffer for the latitudes */
+    Geo_bounds_t *bounds      /* I/O: boundary for the scene */
+)
+{
+    int npts = ((edge < 2) ? nsamps : nlines) + 1;  /* points on the edge;
+                                    go an extra pixel to the right and bottom
+                                    to get the true outer extents */
+    int ncoarse;              /* number of coarse points */
+    int extreme[4];           /* coarse points with the max/min lat/long */
+    int first;                /* first coarse point around an extreme */
+    int last;                 /* last coarse point around an extreme */
+    int i, k;                 /* looping variables */
+
+    /* Short edges are mapped at every pixel */
+    if (npts <= 4 * BOUNDS_EDGE_STEP)
+    {
+        if (!map_edge_points (space, nlines, nsamps, edge, 0, 1, npts, line,
+            samp, lon, lat))
+            return (false);
+        update_bounds (npts, lon, lat, meridian_crossing, bounds);
+        return (true);
+    }
+
+    /* Map the coarse points, including the far end of the edge */
+    ncoarse = (npts - 2) / BOUNDS_EDGE_STEP + 2;
+    if (!map_edge_points (space, nlines, nsamps, edge, 0, BOUNDS_EDGE_STEP,
+        ncoarse, line, samp, lon, lat))
+        return (false);
+    update_bounds (ncoarse, lon, lat, meridian_crossing, bounds);
+
+    /* Find the coarse points with the max/min lat and the max/min long,
+       following the rules of update_bounds for the longitudes */
+    for (k = 0; k < 4; k++)
+        extreme[k] = -1;
+    for (i = 0; i < ncoarse; i++)
+    {
+        if (extreme[0] < 0 || lat[i] > lat[extreme[0]])
+            extreme[0] = i;
+        if (extreme[1] < 0 || lat[i] < lat[extreme[1]])
+            extreme[1] = i;
+        if (meridian_crossing)
+        {
+            if (lon[i] < 0 && (extreme[2] < 0 || lon[i] > lon[extreme[2]]))
+                extreme[2] = i;
+            if (lon[i] > 0 && (extreme[3] < 0 || lon[i] < lon[extreme[3]]))
+                extreme[3] = i;
+        }
+        else
+        {
+            if (extreme[2] < 0 || lon[i] > lon[extreme[2]])
+                extreme[2] = i;
+            if (extreme[3] < 0 || lon[i] < lon[extreme[3]])
+                extreme[3] = i;
+        }
+    }
+
+    /* Map every pixel between the coarse points on either side of each
+       extreme */
+    for (k = 0; k < 4; k++)
+    {
+        if (extreme[k] < 0)
+            continue;
+        first = max (extreme[k] - 1, 0) * BOUNDS_EDGE_STEP;
+        last = min ((extreme[k] + 1) * BOUNDS_EDGE_STEP, npts - 1);
+        if (!map_edge_points (space, nlines, nsamps, edge, first, 1,
+            last - first + 1, line, samp, lon, lat))
+            return (false);
+        update_bounds (last - first + 1, lon, lat, meridian_crossing,
+            bounds);
+    }
+
+    return (true);
+}
+
+
 /******************************************************************************
 MODULE:  compute_bounds
 
@@ -556,6 +987,9 @@ NOTES:
    which cross the antimeridian, we will handle these scenes differently. The
    western longitude will be the lowest value in the eastern hemisphere.  The
    eastern longitude will be the highest value in the western hemisphere.
+4. Long edges are searched adaptively by 'bound_edge', which maps a coarse
+   set of points and then every pixel around the extremes, instead of
+   mapping every pixel along the edge.
 ******************************************************************************/
 bool compute_bounds
 (
@@ -569,9 +1003,17 @@ bool compute_bounds
 {
     char FUNC_NAME[] = "compute_bounds";  /* function name */
     char errmsg[STR_SIZE];       /* error message */
-    Img_coord_float_t img;       /* image coordinates for current pixel */
-    Geo_coord_t geo;             /* geodetic coordinates (note radians) */
-    int ix, iy;                  /* current x,y coordinates */
+    float corner_line[4];        /* image lines of the UL, UR, LL, LR corner */
+    float corner_samp[4];        /* image samples of the corners */
+    double corner_lon[4];        /* longitude (radians) of the corners */
+    double corner_lat[4];        /* latitude (radians) of the corners */
+    float *line = NULL;          /* image lines along an edge */
+    float *samp = NULL;          /* image samples along an edge */
+    double *lon = NULL;          /* longitudes (radians) along an edge */
+    double *lat = NULL;          /* latitudes (radians) along an edge */
+    int npts;                    /* number of points in the edge buffers */
+    int edge;                    /* looping variable for the edges */
+    int i;                       /* looping variable */
     float ul_lat;                /* latitude (degs) for UL corner */
     float lr_lat;                /* latitude (degs) for LR corner */
     float ul_lon;                /* longitude (degs) for UL corner */
@@ -584,51 +1026,24 @@ bool compute_bounds
     /* Determine if this scene crosses the 180th meridian. Determine the
        longitude of each corner, then look if they are in opposite
        hemispheres. */
-    img.l = 0.0;
-    img.s = 0.0;
-    img.is_fill = false;
-    if (!from_space (space, &img, &geo))
+    for (i = 0; i < 4; i++)
     {
-        sprintf (errmsg, "Mapping line, sample pixel to lat/long");
-        error_handler (true, FUNC_NAME, errmsg);
-        return (false);
+        corner_line[i] = (i < 2) ? 0.0 : nlines;
+        corner_samp[i] = (i % 2 == 0) ? 0.0 : nsamps;
     }
-    ul_lat = geo.lat * DEG;
-    ul_lon = geo.lon * DEG;
-
-    img.l = 0.0;
-    img.s = nsamps;
-    img.is_fill = false;
-    if (!from_space (space, &img, &geo))
+    if (!from_space_array (space, 4, corner_line, corner_samp, corner_lon,
+        corner_lat))
     {
         sprintf (errmsg, "Mapping line, sample pixel to lat/long");
         error_handler (true, FUNC_NAME, errmsg);
         return (false);
     }
-    ur_lon = geo.lon * DEG;
-
-    img.l = nlines;
-    img.s = 0.0;
-    img.is_fill = false;
-    if (!from_space (space, &img, &geo))
-    {
-        sprintf (errmsg, "Mapping line, sample pixel to lat/long");
-        error_handler (true, FUNC_NAME, errmsg);
-        return (false);
-    }
-    ll_lon = geo.lon * DEG;
-
-    img.l = nlines;
-    img.s = nsamps; 
-    img.is_fill = false;
-    if (!from_space (space, &img, &geo))
-    {
-        sprintf (errmsg, "Mapping line, sample pixel to lat/long");
-        error_handler (true, FUNC_NAME, errmsg);
-        return (false);
-    }
-    lr_lat = geo.lat * DEG;
-    lr_lon = geo.lon * DEG;
+    ul_lat = corner_lat[0] * DEG;
+    ul_lon = corner_lon[0] * DEG;
+    ur_lon = corner_lon[1] * DEG;
+    ll_lon = corner_lon[2] * DEG;
+    lr_lat = corner_lat[3] * DEG;
+    lr_lon = corner_lon[3] * DEG;
 
     /* Meridian crossing if any of the corner longitudes are opposite from the
        UL corner. However we want to focus only on the antimeridian crossing.
@@ -672,145 +1087,209 @@ bool compute_bounds
         bounds->min_lon = ul_lon;
     }
 
-    /* Determine the bounding coords by looping around the edges of the image
-       in line, sample space and converting to lat/long space. Remember that
-       the to/from space mappings are initialized using the UL of the UL corner
-       of the image. Thus we need to go an extra pixel to the right and bottom
-       of the image to get the true outer extents. */
-    /** top -- go to (nsamps-1) + 1 to get to the far right edge of the
-        image **/
-    for (ix = 0; ix <= nsamps; ix++)
+    /* Allocate the points for the edge search */
+    npts = max (max (nlines, nsamps) / BOUNDS_EDGE_STEP + 2,
+        4 * BOUNDS_EDGE_STEP);
+    line = malloc (npts * sizeof (float));
+    samp = malloc (npts * sizeof (float));
+    lon = malloc (npts * sizeof (double));
+    lat = malloc (npts * sizeof (double));
+    if (line == NULL || samp == NULL || lon == NULL || lat == NULL)
     {
-        iy = 0;
-        img.l = (double) iy;
-        img.s = (double) ix;
-        img.is_fill = false;
-        if (!from_space (space, &img, &geo))
-        {
-            sprintf (errmsg, "Mapping top line of the image to lat/long");
-            error_handler (true, FUNC_NAME, errmsg);
-            return (false);
-        }
-
-        /* Save the min/max */
-        bounds->max_lat = max (bounds->max_lat, geo.lat*DEG);
-        bounds->min_lat = min (bounds->min_lat, geo.lat*DEG);
-        if (meridian_crossing)
-        {   /* Looking for the minimum positive longitude (eastern hemisphere
-               and the maximum negative longitude (western hemisphere) */
-            if (geo.lon > 0)
-                bounds->min_lon = min (bounds->min_lon, geo.lon*DEG);
-            if (geo.lon < 0)
-                bounds->max_lon = max (bounds->max_lon, geo.lon*DEG);
-        }
-        else
-        {   /* Standard min/max computation */
-            bounds->max_lon = max (bounds->max_lon, geo.lon*DEG);
-            bounds->min_lon = min (bounds->min_lon, geo.lon*DEG);
-        }
+        sprintf (errmsg, "Allocating memory for the image edge coordinates");
+        error_handler (true, FUNC_NAME, errmsg);
+        free (line);
+        free (samp);
+        free (lon);
+        free (lat);
+        return (false);
     }
 
-    /** bottom -- go to (nsamps-1) + 1 to get to the far right edge of the
-        image **/
-    for (ix = 0; ix <= nsamps; ix++)
+    /* Determine the bounding coords by mapping the edges of the image (top,
+       bottom, left, right) in line, sample space to lat/long space */
+    for (edge = 0; edge < 4; edge++)
     {
-        iy = nlines;  /* this is actually (nlines-1) + 1 to get to the very
-                         bottom edge of the image */
-        img.l = (double) iy;
-        img.s = (double) ix;
-        img.is_fill = false;
-        if (!from_space (space, &img, &geo))
+        if (!bound_edge (space, nlines, nsamps, edge, meridian_crossing, line,
+            samp, lon, lat, bounds))
         {
-            sprintf (errmsg, "Mapping top line of the image to lat/long");
+            sprintf (errmsg, "Mapping the edges of the image to lat/long");
             error_handler (true, FUNC_NAME, errmsg);
+            free (line);
+            free (samp);
+            free (lon);
+            free (lat);
             return (false);
         }
+    }
 
-        /* Save the min/max */
-        bounds->max_lat = max (bounds->max_lat, geo.lat*DEG);
-        bounds->min_lat = min (bounds->min_lat, geo.lat*DEG);
-        if (meridian_crossing)
-        {   /* Looking for the minimum positive longitude (eastern hemisphere
-               and the maximum negative longitude (western hemisphere) */
-            if (geo.lon > 0)
-                bounds->min_lon = min (bounds->min_lon, geo.lon*DEG);
-            if (geo.lon < 0)
-                bounds->max_lon = max (bounds->max_lon, geo.lon*DEG);
-        }
-        else
-        {   /* Standard min/max computation */
-            bounds->max_lon = max (bounds->max_lon, geo.lon*DEG);
-            bounds->min_lon = min (bounds->min_lon, geo.lon*DEG);
-        }
+    free (line);
+    free (samp);
+    free (lon);
+    free (lat);
+
+    /* Successful completion */
+    return (true);
+}
+
+
+/******************************************************************************
+MODULE:  same_space_def
+
+PURPOSE:  Determines whether two space definitions describe the same grid.
+
+RETURN VALUE:
+Type = bool
+Value      Description
+-----      -----------
+false      The space definitions differ
+true       The space definitions are the same
+
+NOTES:
+******************************************************************************/
+static bool same_space_def
+(
+    Space_def_t *a,           /* I: first space definition */
+    Space_def_t *b            /* I: second space definition */
+)
+{
+    int i;                    /* looping variable */
+
+    if (a->proj_num != b->proj_num || a->spheroid != b->spheroid ||
+        a->zone_set != b->zone_set || (a->zone_set && a->zone != b->zone) ||
+        a->pixel_size[0] != b->pixel_size[0] ||
+        a->pixel_size[1] != b->pixel_size[1] ||
+        a->ul_corner.x != b->ul_corner.x ||
+        a->ul_corner.y != b->ul_corner.y ||
+        a->img_size.l != b->img_size.l || a->img_size.s != b->img_size.s ||
+        a->orientation_angle != b->orientation_angle)
+        return false;
+
+    for (i = 0; i < NPROJ_PARAM; i++)
+    {
+        if (a->proj_param[i] != b->proj_param[i])
+            return false;
     }
 
-    /** left -- go to (nlines-1) + 1 to get to the bottom edge of the image **/
-    for (iy = 0; iy <= nlines; iy++)
+    return true;
+}
+
+
+/******************************************************************************
+MODULE:  get_corner_coords
+
+PURPOSE:  Computes the geographic coordinates of the UL and LR corners of the
+image described by the XML metadata.
+
+RETURN VALUE:
+Type = bool
+Value      Description
+-----      -----------
+false      Error occurred in the computation or mapping
+true       Successfully computed the corners
+
+NOTES:
+1. The corners are those of the UL and LR pixels, mapped from the centers of
+   the pixels as written in the global metadata.
+2. The corners of the last image are cached, so the images of a tiled time
+   series (ex. a batch of MODIS or VIIRS granules of the same tile) don't set
+   up the projection and map the corners again.
+******************************************************************************/
+bool get_corner_coords
+(
+    Espa_internal_meta_t *xml_metadata, /* I: XML metadata information */
+    double ul_corner[2],      /* O: latitude and longitude of the UL corner
+                                    (degrees) */
+    double lr_corner[2]       /* O: latitude and longitude of the LR corner
+                                    (degrees) */
+)
+{
+    char FUNC_NAME[] = "get_corner_coords"; /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    static Space_def_t cached_def;     /* space definition of the cached
+                                          corners */
+    static double cached_ul[2];        /* cached UL corner */
+    static double cached_lr[2];        /* cached LR corner */
+    static bool cached = false;        /* are the corners cached? */
+    static char cache_lock = 0;        /* spin lock for the cache */
+    bool status = false;      /* return status */
+    Space_def_t geoloc_def;   /* geolocation space information */
+    Geoloc_t *geoloc_map = NULL;  /* geolocation mapping information */
+    Img_coord_float_t img;    /* corner in line/samp space */
+    Geo_coord_t geo;          /* corner in lat/long space */
+
+    /* Get geolocation information from the XML file */
+    memset (&geoloc_def, 0, sizeof (geoloc_def));
+    if (!get_geoloc_info (xml_metadata, &geoloc_def))
     {
-        ix = 0;
-        img.l = (double) iy;
-        img.s = (double) ix;
-        img.is_fill = false;
-        if (!from_space (space, &img, &geo))
-        {
-            sprintf (errmsg, "Mapping top line of the image to lat/long");
-            error_handler (true, FUNC_NAME, errmsg);
-            return (false);
-        }
+        sprintf (errmsg, "Copying the geolocation information from the XML "
+            "metadata structure.");
+        error_handler (true, FUNC_NAME, errmsg);
+        return false;
+    }
 
-        /* Save the min/max */
-        bounds->max_lat = max (bounds->max_lat, geo.lat*DEG);
-        bounds->min_lat = min (bounds->min_lat, geo.lat*DEG);
-        if (meridian_crossing)
-        {   /* Looking for the minimum positive longitude (eastern hemisphere
-               and the maximum negative longitude (western hemisphere) */
-            if (geo.lon > 0)
-                bounds->min_lon = min (bounds->min_lon, geo.lon*DEG);
-            if (geo.lon < 0)
-                bounds->max_lon = max (bounds->max_lon, geo.lon*DEG);
-        }
-        else
-        {   /* Standard min/max computation */
-            bounds->max_lon = max (bounds->max_lon, geo.lon*DEG);
-            bounds->min_lon = min (bounds->min_lon, geo.lon*DEG);
-        }
+    while (__atomic_test_and_set (&cache_lock, __ATOMIC_ACQUIRE))
+        ;
+
+    /* Use the cached corners if the grid is the same */
+    if (cached && same_space_def (&cached_def, &geoloc_def))
+    {
+        ul_corner[0] = cached_ul[0];
+        ul_corner[1] = cached_ul[1];
+        lr_corner[0] = cached_lr[0];
+        lr_corner[1] = cached_lr[1];
+        __atomic_clear (&cache_lock, __ATOMIC_RELEASE);
+        return true;
     }
 
-    /** right -- go to (nlines-1) + 1 to get to the bottom edge of the image **/
-    for (iy = 0; iy <= nlines; iy++)
+    /* Setup the mapping structure.  GCTP isn't re-entrant, so the lock is
+       held while mapping. */
+    geoloc_map = setup_mapping (&geoloc_def);
+    if (geoloc_map == NULL)
     {
-        ix = nsamps;  /* this is actually (nsamps-1) + 1 to get to the far
-                         right edge of the image */
-        img.l = (double) iy;
-        img.s = (double) ix;
-        img.is_fill = false;
-        if (!from_space (space, &img, &geo))
-        {
-            sprintf (errmsg, "Mapping top line of the image to lat/long");
-            error_handler (true, FUNC_NAME, errmsg);
-            return (false);
-        }
+        sprintf (errmsg, "Setting up the geolocation mapping structure.");
+        error_handler (true, FUNC_NAME, errmsg);
+        goto done;
+    }
 
-        /* Save the min/max */
-        bounds->max_lat = max (bounds->max_lat, geo.lat*DEG);
-        bounds->min_lat = min (bounds->min_lat, geo.lat*DEG);
-        if (meridian_crossing)
-        {   /* Looking for the minimum positive longitude (eastern hemisphere
-               and the maximum negative longitude (western hemisphere) */
-            if (geo.lon > 0)
-                bounds->min_lon = min (bounds->min_lon, geo.lon*DEG);
-            if (geo.lon < 0)
-                bounds->max_lon = max (bounds->max_lon, geo.lon*DEG);
-        }
-        else
-        {   /* Standard min/max computation */
-            bounds->max_lon = max (bounds->max_lon, geo.lon*DEG);
-            bounds->min_lon = min (bounds->min_lon, geo.lon*DEG);
-        }
+    /* Get the geographic coords for the UL corner */
+    img.l = 0.0;
+    img.s = 0.0;
+    img.is_fill = false;
+    if (!from_space (geoloc_map, &img, &geo))
+    {
+        sprintf (errmsg, "Mapping UL corner to lat/long");
+        error_handler (true, FUNC_NAME, errmsg);
+        goto done;
     }
+    ul_corner[0] = geo.lat * DEG;
+    ul_corner[1] = geo.lon * DEG;
 
-    /* Successful completion */
-    return (true);
+    /* Get the geographic coords for the LR corner */
+    img.l = geoloc_def.img_size.l - 1;
+    img.s = geoloc_def.img_size.s - 1;
+    img.is_fill = false;
+    if (!from_space (geoloc_map, &img, &geo))
+    {
+        sprintf (errmsg, "Mapping LR corner to lat/long");
+        error_handler (true, FUNC_NAME, errmsg);
+        goto done;
+    }
+    lr_corner[0] = geo.lat * DEG;
+    lr_corner[1] = geo.lon * DEG;
+
+    /* Cache the corners for the next image */
+    cached_def = geoloc_def;
+    cached_ul[0] = ul_corner[0];
+    cached_ul[1] = ul_corner[1];
+    cached_lr[0] = lr_corner[0];
+    cached_lr[1] = lr_corner[1];
+    cached = true;
+    status = true;
+
+done:
+    __atomic_clear (&cache_lock, __ATOMIC_RELEASE);
+    free (geoloc_map);
+    return status;
 }
 
 
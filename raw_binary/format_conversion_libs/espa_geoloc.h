@@ -114,6 +114,9 @@ typedef struct
                            /* Inverse transformation function call */
     double cos_orien;      /* Cosine of the orientation angle */
     double sin_orien;      /* Sine of the orientation angle */
+    unsigned long id;      /* Identifies the mapping, so its GCTP transforms
+                              are initialized again only after another
+                              mapping has used GCTP */
 } Geoloc_t;
 
 /* Prototypes */
@@ -144,6 +147,28 @@ bool from_space
     Geo_coord_t *geo         /* O: geodetic coordinates (radians) */
 );
 
+bool to_space_array
+(
+    Geoloc_t *this,          /* I: geolocation structure; for_trans function
+                                   is used for the forward mapping */
+    int npts,                /* I: number of points to map */
+    const double *lon,       /* I: geodetic longitudes (radians) */
+    const double *lat,       /* I: geodetic latitudes (radians) */
+    float *line,             /* O: image lines */
+    float *samp              /* O: image samples */
+);
+
+bool from_space_array
+(
+    Geoloc_t *this,          /* I: geolocation structure; inv_trans function
+                                   is used for the inverse mapping */
+    int npts,                /* I: number of points to map */
+    const float *line,       /* I: image lines */
+    const float *samp,       /* I: image samples */
+    double *lon,             /* O: geodetic longitudes (radians) */
+    double *lat              /* O: geodetic latitudes (radians) */
+);
+
 bool compute_bounds
 (
     Geoloc_t *space,          /* I: geolocation structure which contains the
@@ -154,6 +179,15 @@ bool compute_bounds
     Geo_bounds_t *bounds      /* O: output boundary for the scene */
 );
 
+bool get_corner_coords
+(
+    Espa_internal_meta_t *xml_metadata, /* I: XML metadata information */
+    double ul_corner[2],      /* O: latitude and longitude of the UL corner
+                                    (degrees) */
+    double lr_corner[2]       /* O: latitude and longitude of the LR corner
+                                    (degrees) */
+);
+
 bool degdms
 (
     double *deg,     /* I: input angular value in degrees, minutes, or seconds
@@ -0,0 +1,234 @@
+/*****************************************************************************
+FILE: espa_granule_batch.c
+
+PURPOSE: Contains functions for converting a batch of granules to the ESPA
+internal format in one invocation, converting several granules at a time.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+*****************************************************************************/
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include "espa_granule_batch.h"
+
+
+/******************************************************************************
+MODULE:  granule_xml_name
+
+PURPOSE: Generates the output XML filename of a granule by replacing the
+extension of the granule filename (ex. .hdf or .h5) with .xml.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           The XML filename doesn't fit
+SUCCESS         Successfully generated the XML filename
+
+NOTES:
+  1. A granule filename without an extension just gets .xml appended.
+******************************************************************************/
+int granule_xml_name
+(
+    char *granule,       /* I: input granule filename */
+    char *xml_file       /* O: output ESPA XML metadata filename
+                               (STR_SIZE characters) */
+)
+{
+    char FUNC_NAME[] = "granule_xml_name";  /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    char *cptr = NULL;        /* pointer to the extension of the granule */
+    char *slash = NULL;       /* pointer to the last directory separator */
+    int len;                  /* length of the granule name to be kept */
+    int count;                /* number of chars copied in snprintf */
+
+    len = strlen (granule);
+    cptr = strrchr (granule, '.');
+    slash = strrchr (granule, '/');
+    if (cptr != NULL && (slash == NULL || cptr > slash))
+        len = cptr - granule;
+
+    count = snprintf (xml_file, STR_SIZE, "%.*s.xml", len, granule);
+    if (count < 0 || count >= STR_SIZE)
+    {
+        sprintf (errmsg, "Overflow of the XML filename for %s", granule);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  convert_granule_share
+
+PURPOSE: Converts every step-th granule of the batch, starting with the
+first-th.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+n               Number of granules which failed
+
+NOTES:
+  1. A granule which fails doesn't stop the remaining granules.
+******************************************************************************/
+static int convert_granule_share
+(
+    int ngranules,       /* I: number of granules */
+    char **granules,     /* I: input granule filenames */
+    int first,           /* I: index of the first granule to convert */
+    int step,            /* I: step between the granules to convert */
+    Espa_granule_converter_t convert, /* I: converter of a granule */
+    void *arg            /* I: options passed to the converter */
+)
+{
+    char FUNC_NAME[] = "convert_granule_share";  /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    char xml_file[STR_SIZE];  /* output XML filename of the granule */
+    int i;                    /* looping variable for the granules */
+    int nfailed = 0;          /* number of granules which failed */
+
+    for (i = first; i < ngranules; i += step)
+    {
+        printf ("Granule %d of %d: %s\n", i + 1, ngranules, granules[i]);
+        if (granule_xml_name (granules[i], xml_file) != SUCCESS ||
+            convert (granules[i], xml_file, arg) != SUCCESS)
+        {
+            sprintf (errmsg, "Converting granule %s", granules[i]);
+            error_handler (true, FUNC_NAME, errmsg);
+            nfailed++;
+        }
+    }
+
+    return nfailed;
+}
+
+
+/******************************************************************************
+MODULE:  convert_granule_batch
+
+PURPOSE: Converts a batch of granules to the ESPA internal format, converting
+up to njobs granules at a time.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error converting one or more of the granules
+SUCCESS         Successfully converted all the granules
+
+NOTES:
+  1. The ESPA schema is compiled once, before any granule is converted, and
+     is shared by all the granules.
+  2. With more than one job, the granules are dealt out to njobs worker
+     processes forked from this one (see espa_granule_batch.h), each
+     converting its granules one at a time.  A worker which can't be forked
+     has its granules converted by this process instead.
+  3. Every granule is attempted, even if others fail.
+******************************************************************************/
+int convert_granule_batch
+(
+    int ngranules,       /* I: number of granules */
+    char **granules,     /* I: input granule filenames */
+    int njobs,           /* I: number of granules converted at a time */
+    Espa_granule_converter_t convert, /* I: converter of a granule */
+    void *arg            /* I: options passed to the converter */
+)
+{
+    char FUNC_NAME[] = "convert_granule_batch";  /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    int i;                    /* looping variable for the workers */
+    int nfailed = 0;          /* number of granules or workers which failed */
+    int wstatus;              /* exit status of a worker */
+    pid_t *pids = NULL;       /* process of each worker; -1 if not forked */
+
+    if (njobs > ngranules)
+        njobs = ngranules;
+    if (njobs < 1)
+        njobs = 1;
+
+    /* Compile the schema up front, so the workers inherit it */
+    if (get_espa_schema () == NULL)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+
+    if (njobs == 1)
+    {
+        nfailed = convert_granule_share (ngranules, granules, 0, 1, convert,
+            arg);
+    }
+    else
+    {
+        pids = malloc (njobs * sizeof (pid_t));
+        if (pids == NULL)
+        {
+            sprintf (errmsg, "Allocating memory for the worker processes");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+
+        /* Flush the output so the workers don't repeat it */
+        fflush (stdout);
+        fflush (stderr);
+        for (i = 0; i < njobs; i++)
+        {
+            pids[i] = fork ();
+            if (pids[i] == 0)
+            {
+                /* Worker; keep its lines whole among the other workers' */
+                setvbuf (stdout, NULL, _IOLBF, 0);
+                nfailed = convert_granule_share (ngranules, granules, i,
+                    njobs, convert, arg);
+                exit (nfailed == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+            }
+            else if (pids[i] < 0)
+            {
+                sprintf (errmsg, "Unable to fork worker %d; its granules "
+                    "will be converted after the other workers", i);
+                error_handler (false, FUNC_NAME, errmsg);
+            }
+        }
+
+        /* Wait for the workers, then convert the granules of any which
+           couldn't be forked */
+        for (i = 0; i < njobs; i++)
+        {
+            if (pids[i] < 0)
+                continue;
+            if (waitpid (pids[i], &wstatus, 0) < 0 || !WIFEXITED (wstatus) ||
+                WEXITSTATUS (wstatus) != EXIT_SUCCESS)
+            {
+                sprintf (errmsg, "Worker %d failed to convert one or more "
+                    "granules", i);
+                error_handler (true, FUNC_NAME, errmsg);
+                nfailed++;
+            }
+        }
+        for (i = 0; i < njobs; i++)
+        {
+            if (pids[i] < 0)
+                nfailed += convert_granule_share (ngranules, granules, i,
+                    njobs, convert, arg);
+        }
+        free (pids);
+    }
+
+    if (nfailed > 0)
+    {
+        sprintf (errmsg, "Not all of the %d granules were converted",
+            ngranules);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
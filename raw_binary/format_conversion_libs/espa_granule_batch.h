@@ -0,0 +1,57 @@
+/*****************************************************************************
+FILE: espa_granule_batch.h
+
+PURPOSE: Contains defines, structures, and prototypes for converting a batch
+of granules (ex. a MODIS or VIIRS time series) to the ESPA internal format in
+one invocation.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The HDF4, HDF5, and GCTP libraries aren't re-entrant, so the granules
+     are converted in parallel by worker processes forked from the caller
+     rather than by threads.  The workers inherit the compiled ESPA schema
+     from the caller, and each worker keeps its initialized libraries and
+     cached projection for all of its granules.
+  2. This file doesn't depend on any of the format libraries.
+*****************************************************************************/
+
+#ifndef ESPA_GRANULE_BATCH_H
+#define ESPA_GRANULE_BATCH_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "error_handler.h"
+#include "espa_metadata.h"
+
+/* Converter of a single granule, called for each granule of the batch */
+typedef int (*Espa_granule_converter_t)
+(
+    char *granule,       /* I: input granule filename */
+    char *xml_file,      /* I: output ESPA XML metadata filename */
+    void *arg            /* I: options of the converter */
+);
+
+/* Prototypes */
+int granule_xml_name
+(
+    char *granule,       /* I: input granule filename */
+    char *xml_file       /* O: output ESPA XML metadata filename, with the
+                               extension of the granule replaced by .xml
+                               (STR_SIZE characters) */
+);
+
+int convert_granule_batch
+(
+    int ngranules,       /* I: number of granules */
+    char **granules,     /* I: input granule filenames */
+    int njobs,           /* I: number of granules converted at a time */
+    Espa_granule_converter_t convert, /* I: converter of a granule */
+    void *arg            /* I: options passed to the converter */
+);
+
+#endif
@@ -15,7 +15,7 @@ NOTES:
 #include "espa_hdf_eos.h"
 
 #define OUTPUT_HDFEOS_VERSION ("HDFEOSVersion");
-#define OUTPUT_STRUCT_METADATA ("StructMetadata.0");
+#define OUTPUT_STRUCT_METADATA "StructMetadata"
 #define OUTPUT_ORIENTATION_ANGLE_HDF ("OrientationAngle")
 
 /******************************************************************************
@@ -73,139 +73,58 @@ double deg_to_dms
 
 
 /******************************************************************************
-MODULE:  append_meta
+MODULE:  append_grid_struct_meta
 
-PURPOSE:  Appends the string to the metadata buffer.
-
-RETURN VALUE:
-Type = bool
-Value      Description
------      -----------
-false      Error in the number of attributes
-true       Successful processing
-
-PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
-at the USGS EROS
-
-NOTES:
-******************************************************************************/
-bool append_meta
-(
-    char *cbuf,  /* I/O: input metadata buffer */
-    int *ic,     /* I/O: index of current location in metadata buffer */
-    char *str    /* I: string to append to the metadata buffer */
-)
-{
-    int nc, i;
-  
-    /* Validate the string and number of attributes */
-    if (*ic < 0)
-        return false;
-    nc = strlen (str);
-    if (nc <= 0)
-        return false;
-    if (*ic + nc > ESPA_MAX_METADATA_SIZE)
-        return false;
-  
-    /* Add the string to the metadata */
-    for (i = 0; i < nc; i++)
-    {
-        cbuf[*ic] = str[i];
-        (*ic)++;
-    }
-    cbuf[*ic] = '\0';
-  
-    return true;
-}
-
-/******************************************************************************
-MODULE:  write_hdf_eos_attr
-
-PURPOSE:  Write the spatial definition HDF-EOS attributes to the HDF file and
-move the SDSs to the Grid.
+PURPOSE:  Appends the structural metadata of one grid, with the data fields
+of its bands, to the HDF-EOS structural metadata.
 
 RETURN VALUE:
 Type = int
 Value      Description
 -----      -----------
-ERROR      Error occurred writing the metadata to the HDF file
+ERROR      Error appending the grid
 SUCCESS    Successful completion
 
-PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
-at the USGS EROS
-
 NOTES:
+  1. The corners are the outer edges of the bands of the grid, on the UL
+     edge shared by all the grids (see espa_band_grids.h).
+  2. The data fields of each grid refer to the grid's own YDim and XDim.
+  3. The ODL is printed to the memory stream of the structural metadata,
+     which grows as needed; write errors are checked once it is closed.
 ******************************************************************************/
-int write_hdf_eos_attr
+static int append_grid_struct_meta
 (
-    char *hdf_file,            /* I: HDF file to write attributes to */
-    Espa_internal_meta_t *xml_metadata   /* I: XML metadata structure */
+    Espa_internal_meta_t *xml_metadata,  /* I: XML metadata structure */
+    const Espa_band_grids_t *grids,  /* I: grids of the bands */
+    int igrid,                 /* I: 0-based grid to append */
+    FILE *struct_meta          /* I/O: stream of the structural metadata */
 )
 {
-    char FUNC_NAME[] = "write_hdf_eos_attr";  /* function name */
+    char FUNC_NAME[] = "append_grid_struct_meta";  /* function name */
     char errmsg[STR_SIZE];                    /* error message */
-    char grid_name[] = "Grid";                /* name of the HDF-EOS grid */
-    char struct_meta[ESPA_MAX_METADATA_SIZE]; /* structural metadata */
-    char cbuf[ESPA_MAX_METADATA_SIZE];        /* temp buffer for metadata */
-    char *dim_names[2] = {"YDim", "XDim"};    /* base names for dimensions */
+    char *dim_names[2] = {"YDim", "XDim"};    /* names of the dimensions */
+    char grid_name[STR_SIZE];                 /* name of the HDF-EOS grid */
     char proj_str[STR_SIZE];                  /* projection string */
     char datum_str[STR_SIZE];                 /* datum string */
     char dtype[STR_SIZE];                     /* data type */
-    char temp_name[STR_SIZE];                 /* temporary grid name */
     double ul_corner[2];     /* UL corner x,y -- Geographic is DMS */
     double lr_corner[2];     /* LR corner x,y -- Geographic is DMS */
     double proj_parms[NPROJ_PARAM];  /* projection parameters */
-    double dval;             /* temporary double value */
-    int meta_indx;           /* index of current location in metadata buffer */
     int sphere_code = -99;   /* GCTP value for the associated spheroid */
     int i;                   /* looping variable */
-    int count;               /* number of chars copied in snprintf */
-    int mycount;             /* integer value to use in the name of the 2nd,
-                                3rd, etc. grid dimensions */
     int isds;                /* looping variable for SDSs */
-    int ngrids;              /* number of grids written to HDF file */
     int nfields;             /* number of fields written for this grid */
-    int igrid;               /* looping variable for the grids */
-    int grid[MAX_TOTAL_BANDS]; /* which band in XML was the grid based on */
-    int32 hdf_id;            /* HDF-EOS file ID */
-    int32 hdf_file_id;       /* HDF file ID */
-    bool processed[MAX_TOTAL_BANDS];  /* was this band processed already */
-    bool done;               /* are we done processing all bands */
-    int32 vgroup_id[3];      /* array to hold Vgroup IDs */
-    int32 sds_index;         /* index of SDS in the HDF file */
-    int32 sds_id;            /* SDS ID */
-    Espa_hdf_attr_t attr;    /* attributes for writing the metadata */
+    Espa_band_meta_t *bmeta = &xml_metadata->band[grids->grid_band[igrid]];
+                             /* first band of the grid */
     Espa_global_meta_t *gmeta = &xml_metadata->global;
                              /* pointer to global metadata structure */
-  
-    /* Initialize the bands to not processed */
-    for (isds = 0; isds < xml_metadata->nbands; isds++)
-        processed[isds] = false;
 
-    /* Build the HDF-EOS header */
-    meta_indx = 0;
-    count = snprintf (cbuf, sizeof (cbuf), "%s",
-        "\nGROUP=SwathStructure\n" 
-        "END_GROUP=SwathStructure\n" 
-        "GROUP=GridStructure\n" 
-        "\tGROUP=GRID_1\n");
-    if (count < 0 || count >= sizeof (cbuf))
-    {
-        sprintf (errmsg, "Overflow of cbuf string");
-        error_handler (true, FUNC_NAME, errmsg);
+    if (espa_grid_name (grids, igrid, "Grid", grid_name, sizeof (grid_name))
+        != SUCCESS)
+    {  /* Error messages already written */
         return (ERROR);
     }
 
-    if (!append_meta (struct_meta, &meta_indx, cbuf))
-    {
-        sprintf (errmsg, "Error appending to the start of the metadata string");
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
-    }
-  
-    /** Build the metadata for the first grid (possibly the only grid if this
-        isn't a multi-resolution product) using the information from the first
-        band **/
     /* Get the projection name string */
     switch (gmeta->proj_info.proj_type)
     {
@@ -215,60 +134,20 @@ int write_hdf_eos_attr
         case (GCTP_ALBERS_PROJ): strcpy (proj_str, "ALBERS"); break;
         case (GCTP_SIN_PROJ): strcpy (proj_str, "SNSOID"); break;
     }
-  
-    /* If the grid origin is center, then adjust for the resolution.  The
-       corners will be written for the outter extents of the corner. */
-    if (!strcmp (gmeta->proj_info.grid_origin, "CENTER"))
-    {
-        /* UL corner - go from center to UL of UL */
-        ul_corner[0] = gmeta->proj_info.ul_corner[0] -
-            0.5 * xml_metadata->band[0].pixel_size[0];
-        ul_corner[1] = gmeta->proj_info.ul_corner[1] +
-            0.5 * xml_metadata->band[0].pixel_size[1];
-
-        /* LR corner - go from center to LR of LR */
-        lr_corner[0] = gmeta->proj_info.lr_corner[0] +
-            0.5 * xml_metadata->band[0].pixel_size[0];
-        lr_corner[1] = gmeta->proj_info.lr_corner[1] -
-            0.5 * xml_metadata->band[0].pixel_size[1];
-    }
-    else
-    {  /* Metadata corners are UL of the pixel, thus make the LR corner the
-          outter extent of the corner. */
-        /* UL already represents the UL of UL */
-        ul_corner[0] = gmeta->proj_info.ul_corner[0];
-        ul_corner[1] = gmeta->proj_info.ul_corner[1];
-
-        /* LR corner - go from UL of LR to LR of LR */
-        lr_corner[0] = gmeta->proj_info.lr_corner[0] +
-            xml_metadata->band[0].pixel_size[0];
-        lr_corner[1] = gmeta->proj_info.lr_corner[1] -
-            xml_metadata->band[0].pixel_size[1];
-    }
 
-    /* Write the Grid information for the first resolution in the product */
-    count = snprintf (cbuf, sizeof (cbuf),
+    /* The corners are written for the outer extents of the corner pixels */
+    get_espa_grid_extent (xml_metadata, grids->grid_band[igrid], ul_corner,
+        lr_corner);
+
+    /* Write the Grid information for the resolution of this grid */
+    fprintf (struct_meta,
+        "\tGROUP=GRID_%d\n"
         "\t\tGridName=\"%s\"\n" 
         "\t\tXDim=%d\n" 
         "\t\tYDim=%d\n" 
         "\t\tPixelSize=%g,%g\n",
-        grid_name, xml_metadata->band[0].nsamps, xml_metadata->band[0].nlines, 
-        xml_metadata->band[0].pixel_size[0],
-        xml_metadata->band[0].pixel_size[1]);
-    if (count < 0 || count >= sizeof (cbuf))
-    {
-        sprintf (errmsg, "Overflow of cbuf string");
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
-    }
-
-    if (!append_meta (struct_meta, &meta_indx, cbuf))
-    {
-        sprintf (errmsg, "Error appending to metadata string (grid information "
-            "start)");
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
-    }
+        igrid+1, grid_name, bmeta->nsamps, bmeta->nlines,
+        bmeta->pixel_size[0], bmeta->pixel_size[1]);
   
     /* Convert the UL and LR corners to DDDMMMSSS.SS if the projection
        is geographic, otherwise write the corners as-is. */
@@ -279,94 +158,35 @@ int write_hdf_eos_attr
         lr_corner[0] = deg_to_dms (lr_corner[0]);
         lr_corner[1] = deg_to_dms (lr_corner[1]);
 
-        count = snprintf (cbuf, sizeof (cbuf),
+        fprintf (struct_meta,
             "\t\tUpperLeftPointMtrs=(%.2f,%.2f)\n" 
             "\t\tLowerRightMtrs=(%.2f,%.2f)\n" 
             "\t\tProjection=GCTP_%s\n", 
             ul_corner[0], ul_corner[1], lr_corner[0], lr_corner[1], proj_str);
-        if (count < 0 || count >= sizeof (cbuf))
-        {
-            sprintf (errmsg, "Overflow of cbuf string");
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
     }
     else
     {
-        count = snprintf (cbuf, sizeof (cbuf),
+        fprintf (struct_meta,
             "\t\tUpperLeftPointMtrs=(%.6f,%.6f)\n" 
             "\t\tLowerRightMtrs=(%.6f,%.6f)\n" 
             "\t\tProjection=GCTP_%s\n", 
             ul_corner[0], ul_corner[1], lr_corner[0], lr_corner[1], proj_str);
-        if (count < 0 || count >= sizeof (cbuf))
-        {
-            sprintf (errmsg, "Overflow of cbuf string");
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
-    }
-
-    if (!append_meta (struct_meta, &meta_indx, cbuf))
-    {
-        sprintf (errmsg, "Error appending to metadata string (grid information "
-            "start)");
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
     }
   
     /* Write projection information */
     if (gmeta->proj_info.proj_type == GCTP_UTM_PROJ)
     {
         /* Write the UTM zone */
-        count = snprintf (cbuf, sizeof (cbuf),
-            "\t\tZoneCode=%d\n", gmeta->proj_info.utm_zone);
-        if (count < 0 || count >= sizeof (cbuf))
-        {
-            sprintf (errmsg, "Overflow of cbuf string");
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
-
-        if (!append_meta (struct_meta, &meta_indx, cbuf))
-        {
-            sprintf (errmsg, "Error appending to metadata string (zone "
-                "number)");
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
+        fprintf (struct_meta, "\t\tZoneCode=%d\n",
+            gmeta->proj_info.utm_zone);
     }
     else if (gmeta->proj_info.proj_type != GCTP_GEO_PROJ)
     {  /* don't write projection parameters for Geographic */
-        /* Write the projection parameters */
-        count = snprintf (cbuf, sizeof (cbuf), "%s", "\t\tProjParams=(");
-        if (count < 0 || count >= sizeof (cbuf))
-        {
-            sprintf (errmsg, "Overflow of cbuf string");
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
-
-        if (!append_meta (struct_meta, &meta_indx, cbuf))
-        {
-            sprintf (errmsg, "Error appending to metadata string (grid "
-                "projection parameters start)");
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
-  
         for (i = 0; i < NPROJ_PARAM; i++)
             proj_parms[i] = 0.0;
 
         switch (gmeta->proj_info.proj_type)
         {
-            case GCTP_GEO_PROJ:
-                /* just use the already initialized zeros for the proj parms */
-                break;
-    
-            case GCTP_UTM_PROJ:
-                /* UTM handled in the if statement above */
-                break;
-
             case GCTP_ALBERS_PROJ:
                 proj_parms[2] =
                     deg_to_dms (gmeta->proj_info.standard_parallel1);
@@ -404,43 +224,11 @@ int write_hdf_eos_attr
                 return (ERROR);
         }
 
+        /* Write the projection parameters */
+        fprintf (struct_meta, "\t\tProjParams=(");
         for (i = 0; i < NPROJ_PARAM; i++)
-        {
-            if (i == NPROJ_PARAM-1)
-                count = snprintf (cbuf, sizeof (cbuf), "%.6f)", proj_parms[i]);
-            else
-                count = snprintf (cbuf, sizeof (cbuf), "%.6f,", proj_parms[i]);
-            if (count < 0 || count >= sizeof (cbuf))
-            {
-                sprintf (errmsg, "Overflow of cbuf string");
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
-            }
-
-            if (!append_meta (struct_meta, &meta_indx, cbuf))
-            {
-                sprintf (errmsg, "Error appending to metadata string ("
-                    "individual grid projection parameters)");
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
-            }
-        }
-
-        count = snprintf (cbuf, sizeof (cbuf), "%s", "\n");
-        if (count < 0 || count >= sizeof (cbuf))
-        {
-            sprintf (errmsg, "Overflow of cbuf string");
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
-
-        if (!append_meta (struct_meta, &meta_indx, cbuf))
-        {
-            sprintf (errmsg, "Error appending to metadata string (grid "
-                "projection parameters end)");
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
+            fprintf (struct_meta, "%.6f%s", proj_parms[i],
+                i == NPROJ_PARAM-1 ? ")\n" : ",");
     }
   
     switch (gmeta->proj_info.datum_type)
@@ -464,616 +252,338 @@ int write_hdf_eos_attr
     }
   
     /* Don't write the sphere code if this is the Geographic projection */
-    if (gmeta->proj_info.proj_type != GCTP_GEO_PROJ)
+    if (gmeta->proj_info.proj_type != GCTP_GEO_PROJ &&
+        gmeta->proj_info.datum_type != ESPA_NODATUM)
+        fprintf (struct_meta, "\t\tSphereCode=%d\n", sphere_code);
+  
+    /* Put the datum, origin, and SDS group */
+    fprintf (struct_meta,
+        "\t\tDatum=%s\n"
+        "\t\tGridOrigin=HDFE_GD_UL\n"
+        "\t\tGROUP=Dimension\n" 
+        "\t\tEND_GROUP=Dimension\n"
+        "\t\tGROUP=DataField\n", datum_str);
+
+    /* Loop through the bands and write those on this grid */
+    nfields = 0;
+    for (isds = 0; isds < xml_metadata->nbands; isds++)
     {
-        if (gmeta->proj_info.datum_type != ESPA_NODATUM)
-        {
-            count = snprintf (cbuf, sizeof (cbuf),
-                "\t\tSphereCode=%d\n", sphere_code);
-            if (count < 0 || count >= sizeof (cbuf))
-            {
-                sprintf (errmsg, "Overflow of cbuf string");
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
-            }
+        if (grids->band_grid[isds] != igrid)
+            continue;
 
-            if (!append_meta (struct_meta, &meta_indx, cbuf))
-            {
-                sprintf (errmsg, "Error appending to metadata string (grid "
-                    "information end)");
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
-            }
+        switch (xml_metadata->band[isds].data_type)
+        {
+            case ESPA_INT8: strcpy (dtype, "DFNT_INT8"); break;
+            case ESPA_UINT8: strcpy (dtype, "DFNT_UINT8"); break;
+            case ESPA_INT16: strcpy (dtype, "DFNT_INT16"); break;
+            case ESPA_UINT16: strcpy (dtype, "DFNT_UINT16"); break;
+            case ESPA_INT32: strcpy (dtype, "DFNT_INT32"); break;
+            case ESPA_UINT32: strcpy (dtype, "DFNT_UINT32"); break;
+            case ESPA_FLOAT32: strcpy (dtype, "DFNT_FLOAT32"); break;
+            case ESPA_FLOAT64: strcpy (dtype, "DFNT_FLOAT64"); break;
         }
+
+        fprintf (struct_meta,
+            "\t\t\tOBJECT=DataField_%d\n"
+            "\t\t\t\tDataFieldName=\"%s\"\n"
+            "\t\t\t\tDataType=%s\n"
+            "\t\t\t\tDimList=(\"%s\",\"%s\")\n"
+            "\t\t\tEND_OBJECT=DataField_%d\n",
+            nfields+1, xml_metadata->band[isds].name, dtype,
+            dim_names[0], dim_names[1], nfields+1);
+        nfields++;
     }
   
-    count = snprintf (cbuf, sizeof (cbuf),
-        "\t\tDatum=%s\n"
-        "\t\tGridOrigin=HDFE_GD_UL\n", datum_str);
-    if (count < 0 || count >= sizeof (cbuf))
+    /* Close off the grid */
+    fprintf (struct_meta,
+      "\t\tEND_GROUP=DataField\n" 
+      "\t\tGROUP=MergedFields\n" 
+      "\t\tEND_GROUP=MergedFields\n"
+      "\tEND_GROUP=GRID_%d\n", igrid+1);
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  attach_grid_vgroup
+
+PURPOSE:  Creates the Vgroups of one HDF-EOS grid and moves the SDSs of its
+bands into the Data Fields.
+
+RETURN VALUE:
+Type = int
+Value      Description
+-----      -----------
+ERROR      Error creating the Vgroups of the grid
+SUCCESS    Successful completion
+
+NOTES:
+  1. Vgroup access must already be started on the file.
+******************************************************************************/
+static int attach_grid_vgroup
+(
+    char *hdf_file,            /* I: HDF file of the grid */
+    int32 hdf_id,              /* I: HDF file ID with Vgroup access */
+    Espa_internal_meta_t *xml_metadata,  /* I: XML metadata structure */
+    const Espa_band_grids_t *grids,  /* I: grids of the bands */
+    int igrid                  /* I: 0-based grid to attach */
+)
+{
+    char FUNC_NAME[] = "attach_grid_vgroup";  /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    char grid_name[STR_SIZE];  /* name of the HDF-EOS grid */
+    int isds;                /* looping variable for SDSs */
+    int32 hdf_file_id;       /* HDF file ID */
+    int32 vgroup_id[3];      /* array to hold Vgroup IDs */
+    int32 sds_index;         /* index of SDS in the HDF file */
+    int32 sds_id;            /* SDS ID */
+
+    /* Name the grid as in the structural metadata */
+    if (espa_grid_name (grids, igrid, "Grid", grid_name, sizeof (grid_name))
+        != SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+
+    /* Create Vgroup for current Grid */
+    vgroup_id[0] = Vattach (hdf_id, -1, "w");
+    if (vgroup_id[0] == HDF_ERROR) 
     {
-        sprintf (errmsg, "Overflow of cbuf string");
+        sprintf (errmsg, "Error getting Grid Vgroup ID");
         error_handler (true, FUNC_NAME, errmsg);
         return (ERROR);
     }
-
-    if (!append_meta (struct_meta, &meta_indx, cbuf))
+    if (Vsetname (vgroup_id[0], grid_name) == HDF_ERROR) 
     {
-        sprintf (errmsg, "Error appending to metadata string (grid information "
-            "end)");
+        sprintf (errmsg, "Error setting Grid Vgroup name: %s", grid_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    if (Vsetclass (vgroup_id[0], "GRID") == HDF_ERROR) 
+    {
+        sprintf (errmsg, "Error setting Grid Vgroup class to GRID");
         error_handler (true, FUNC_NAME, errmsg);
         return (ERROR);
     }
   
-    /* Put SDS group */
-    count = snprintf (cbuf, sizeof (cbuf),
-        "\t\tGROUP=Dimension\n" 
-        "\t\tEND_GROUP=Dimension\n"
-        "\t\tGROUP=DataField\n");
-    if (count < 0 || count >= sizeof (cbuf))
+    /* Create Data Fields Vgroup */
+    vgroup_id[1] = Vattach (hdf_id, -1, "w");
+    if (vgroup_id[1] == HDF_ERROR) 
     {
-        sprintf (errmsg, "Overflow of cbuf string");
+        sprintf (errmsg, "Error getting Data Fields Vgroup ID");
         error_handler (true, FUNC_NAME, errmsg);
         return (ERROR);
     }
-
-    if (!append_meta (struct_meta, &meta_indx, cbuf))
+    if (Vsetname (vgroup_id[1], "Data Fields") == HDF_ERROR) 
     {
-        sprintf (errmsg, "Error appending to metadata string (SDS group "
-            "start)");
+        sprintf (errmsg, "Error setting Data Fields Vgroup name");
         error_handler (true, FUNC_NAME, errmsg);
         return (ERROR);
     }
-
-    /* Loop through the bands and write those that match the resolution of
-       the first band */
-    nfields = 0;
-    for (isds = 0; isds < xml_metadata->nbands; isds++)
+    if (Vsetclass (vgroup_id[1], "GRID Vgroup") == HDF_ERROR) 
     {
-        if ((xml_metadata->band[isds].pixel_size[0] ==
-             xml_metadata->band[0].pixel_size[0]) &&
-            (xml_metadata->band[isds].pixel_size[1] ==
-             xml_metadata->band[0].pixel_size[1]))
-        {
-            processed[isds] = true;
-            switch (xml_metadata->band[isds].data_type)
-            {
-                case ESPA_INT8: strcpy (dtype, "DFNT_INT8"); break;
-                case ESPA_UINT8: strcpy (dtype, "DFNT_UINT8"); break;
-                case ESPA_INT16: strcpy (dtype, "DFNT_INT16"); break;
-                case ESPA_UINT16: strcpy (dtype, "DFNT_UINT16"); break;
-                case ESPA_INT32: strcpy (dtype, "DFNT_INT32"); break;
-                case ESPA_UINT32: strcpy (dtype, "DFNT_UINT32"); break;
-                case ESPA_FLOAT32: strcpy (dtype, "DFNT_FLOAT32"); break;
-                case ESPA_FLOAT64: strcpy (dtype, "DFNT_FLOAT64"); break;
-            }
-
-            count = snprintf (cbuf, sizeof (cbuf),
-                "\t\t\tOBJECT=DataField_%d\n"
-                "\t\t\t\tDataFieldName=\"%s\"\n"
-                "\t\t\t\tDataType=%s\n"
-                "\t\t\t\tDimList=(\"%s\",\"%s\")\n"
-                "\t\t\tEND_OBJECT=DataField_%d\n",
-                nfields+1, xml_metadata->band[isds].name, dtype,
-                dim_names[0], dim_names[1], nfields+1);
-            if (count < 0 || count >= sizeof (cbuf))
-            {
-                sprintf (errmsg, "Overflow of cbuf string");
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
-            }
-
-            if (!append_meta (struct_meta, &meta_indx, cbuf))
-            {
-                sprintf (errmsg, "Error appending to metadata string "
-                    "(SDS group)");
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
-            }
-            nfields++;
-        }
+        sprintf (errmsg, "Error setting Data Fields Vgroup class");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    if (Vinsert (vgroup_id[0], vgroup_id[1]) == HDF_ERROR) 
+    {
+        sprintf (errmsg, "Error inserting Data Fields Vgroup");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
     }
   
-    /* Close off the grid */
-    count = snprintf (cbuf, sizeof (cbuf),
-      "\t\tEND_GROUP=DataField\n" 
-      "\t\tGROUP=MergedFields\n" 
-      "\t\tEND_GROUP=MergedFields\n"
-      "\tEND_GROUP=GRID_1\n");
-    if (count < 0 || count >= sizeof (cbuf))
+    /* Create Attributes Vgroup */
+    vgroup_id[2] = Vattach (hdf_id, -1, "w");
+    if (vgroup_id[2] == HDF_ERROR) 
     {
-        sprintf (errmsg, "Overflow of cbuf string");
+        sprintf (errmsg, "Error getting attributes Vgroup ID");
         error_handler (true, FUNC_NAME, errmsg);
         return (ERROR);
     }
-
-    if (!append_meta (struct_meta, &meta_indx, cbuf))
+    if (Vsetname (vgroup_id[2], "Grid Attributes") == HDF_ERROR) 
+    {
+        sprintf (errmsg, "Error setting attributes Vgroup name");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    if (Vsetclass (vgroup_id[2], "GRID Vgroup") == HDF_ERROR) 
     {
-        sprintf (errmsg, "Error appending to metadata string (SDS group end)");
+        sprintf (errmsg, "Error setting attributes Vgroup class");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    if (Vinsert (vgroup_id[0], vgroup_id[2]) == HDF_ERROR) 
+    {
+        sprintf (errmsg, "Error inserting attributes Vgroup");
         error_handler (true, FUNC_NAME, errmsg);
         return (ERROR);
     }
   
-    /* Keep track of the number of grids processed and which band they were
-       built from */
-    ngrids = 1;
-    grid[0] = 0;   /* first grid based on band 0 in the XML structure */
-
-    /* Check to see if all the bands were processed in this grid (i.e. all
-       were the same resolution).  If not, then loop through the bands and
-       handle the remaining bands, putting separate resolutions in different
-       grids. */
-    done = true;
+    /* Attach SDSs to Data Fields Vgroup */
+    hdf_file_id = SDstart ((char *)hdf_file, DFACC_RDWR);
+    if (hdf_file_id == HDF_ERROR) 
+    {
+        sprintf (errmsg, "Error opening output file for SD access");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+  
+    /* Loop through the bands and attach those on the current grid */
     for (isds = 0; isds < xml_metadata->nbands; isds++)
     {
-        if (!processed[isds])
+        if (grids->band_grid[isds] != igrid)
+            continue;
+
+        sds_index = SDnametoindex (hdf_file_id, 
+            xml_metadata->band[isds].name);
+        if (sds_index == HDF_ERROR) 
         {
-            done = false;
-            break;
+            sprintf (errmsg, "Error getting SDS index for SDS[%d]: %s",
+                isds, xml_metadata->band[isds].name);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
         }
-    }
-    while (!done)
-    {   /* Process the remaining resolutions in separate grids */
-        for (isds = 0; isds < xml_metadata->nbands; isds++)
+
+        sds_id = SDselect (hdf_file_id, sds_index);
+        if (sds_id == HDF_ERROR) 
         {
-            /* If this band was already processed, then go to the next one */
-            if (processed[isds])
-                continue;
-
-            /* Build the GRID header */
-            count = snprintf (cbuf, sizeof (cbuf),
-                "\tGROUP=GRID_%d\n", ngrids+1);
-            if (count < 0 || count >= sizeof (cbuf))
-            {
-                sprintf (errmsg, "Overflow of cbuf string");
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
-            }
+            sprintf (errmsg, "Error getting SDS ID");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
 
-            if (!append_meta (struct_meta, &meta_indx, cbuf))
-            {
-                sprintf (errmsg, "Error appending grid header to the metadata "
-                    "string");
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
-            }
-  
-            /* Get the projection name string */
-            switch (gmeta->proj_info.proj_type)
-            {
-                case (GCTP_GEO_PROJ): strcpy (proj_str, "GEO"); break;
-                case (GCTP_UTM_PROJ): strcpy (proj_str, "UTM"); break;
-                case (GCTP_PS_PROJ): strcpy (proj_str, "PS"); break;
-                case (GCTP_ALBERS_PROJ): strcpy (proj_str, "ALBERS"); break;
-                case (GCTP_SIN_PROJ): strcpy (proj_str, "SNSOID"); break;
-            }
-  
-            /* If the grid origin is center, then adjust for the resolution.
-               The corners will be written for the UL of the corner. */
-            if (!strcmp (gmeta->proj_info.grid_origin, "CENTER"))
-            {
-                ul_corner[0] = gmeta->proj_info.ul_corner[0] -
-                    0.5 * xml_metadata->band[isds].pixel_size[0];
-                ul_corner[1] = gmeta->proj_info.ul_corner[1] +
-                    0.5 * xml_metadata->band[isds].pixel_size[1];
-                lr_corner[0] = gmeta->proj_info.lr_corner[0] -
-                    0.5 * xml_metadata->band[isds].pixel_size[0];
-                lr_corner[1] = gmeta->proj_info.lr_corner[1] +
-                    0.5 * xml_metadata->band[isds].pixel_size[1];
-            }
-            else
-            {
-                ul_corner[0] = gmeta->proj_info.ul_corner[0];
-                ul_corner[1] = gmeta->proj_info.ul_corner[1];
-                lr_corner[0] = gmeta->proj_info.lr_corner[0];
-                lr_corner[1] = gmeta->proj_info.lr_corner[1];
-            }
-
-            /* Write the Grid information for the resolution of this band.
-               Append the resolution to the grid name or the count of the grids
-               if dealing with Geographic. */
-            if (xml_metadata->global.proj_info.proj_type == GCTP_GEO)
-                mycount = ngrids+1;
-            else
-                mycount = (int) xml_metadata->band[isds].pixel_size[0];
-
-            count = snprintf (cbuf, sizeof (cbuf),
-                "\t\tGridName=\"%s_%d\"\n" 
-                "\t\tXDim=%d\n" 
-                "\t\tYDim=%d\n" 
-                "\t\tPixelSize=%g,%g\n",
-                grid_name, mycount,
-                xml_metadata->band[isds].nsamps,
-                xml_metadata->band[isds].nlines,
-                xml_metadata->band[isds].pixel_size[0],
-                xml_metadata->band[isds].pixel_size[1]);
-            if (count < 0 || count >= sizeof (cbuf))
-            {
-                sprintf (errmsg, "Overflow of cbuf string");
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
-            }
+        if (Vaddtagref (vgroup_id[1], DFTAG_NDG, SDidtoref(sds_id)) == 
+            HDF_ERROR) 
+        {
+            sprintf (errmsg, "Error adding reference tag to SDS");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
 
-            if (!append_meta (struct_meta, &meta_indx, cbuf))
-            {
-                sprintf (errmsg, "Error appending to metadata string (grid "
-                    "information start)");
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
-            }
-  
-            /* Convert the UL and LR corners to DDDMMMSSS.SS if the projection
-               is geographic, otherwise write the corners as-is. */
-            if (gmeta->proj_info.proj_type == GCTP_GEO)
-            {
-                ul_corner[0] = deg_to_dms (ul_corner[0]);
-                ul_corner[1] = deg_to_dms (ul_corner[1]);
-                lr_corner[0] = deg_to_dms (lr_corner[0]);
-                lr_corner[1] = deg_to_dms (lr_corner[1]);
-        
-                count = snprintf (cbuf, sizeof (cbuf),
-                    "\t\tUpperLeftPointMtrs=(%.2f,%.2f)\n" 
-                    "\t\tLowerRightMtrs=(%.2f,%.2f)\n" 
-                    "\t\tProjection=GCTP_%s\n", 
-                    ul_corner[0], ul_corner[1], lr_corner[0], lr_corner[1],
-                    proj_str);
-                if (count < 0 || count >= sizeof (cbuf))
-                {
-                    sprintf (errmsg, "Overflow of cbuf string");
-                    error_handler (true, FUNC_NAME, errmsg);
-                    return (ERROR);
-                }
-            }
-            else
-            {
-                count = snprintf (cbuf, sizeof (cbuf),
-                    "\t\tUpperLeftPointMtrs=(%.6f,%.6f)\n" 
-                    "\t\tLowerRightMtrs=(%.6f,%.6f)\n" 
-                    "\t\tProjection=GCTP_%s\n", 
-                    ul_corner[0], ul_corner[1], lr_corner[0], lr_corner[1],
-                    proj_str);
-                if (count < 0 || count >= sizeof (cbuf))
-                {
-                    sprintf (errmsg, "Overflow of cbuf string");
-                    error_handler (true, FUNC_NAME, errmsg);
-                    return (ERROR);
-                }
-            }
-
-            if (!append_meta (struct_meta, &meta_indx, cbuf))
-            {
-                sprintf (errmsg, "Error appending to metadata string (grid "
-                    "information start)");
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
-            }
-
-            /* Write projection information */
-            if (gmeta->proj_info.proj_type == GCTP_UTM_PROJ)
-            {
-                /* Write the UTM zone */
-                count = snprintf (cbuf, sizeof (cbuf),
-                    "\t\tZoneCode=%d\n", gmeta->proj_info.utm_zone);
-                if (count < 0 || count >= sizeof (cbuf))
-                {
-                    sprintf (errmsg, "Overflow of cbuf string");
-                    error_handler (true, FUNC_NAME, errmsg);
-                    return (ERROR);
-                }
-
-                if (!append_meta (struct_meta, &meta_indx, cbuf))
-                {
-                    sprintf (errmsg, "Error appending to metadata string (zone "
-                        "number)");
-                    error_handler (true, FUNC_NAME, errmsg);
-                    return (ERROR);
-                }
-            }
-            else if (gmeta->proj_info.proj_type != GCTP_GEO_PROJ)
-            {  /* don't write projection parameters for Geographic */
-                /* Write the projection parameters */
-                count = snprintf (cbuf, sizeof (cbuf), "%s",
-                    "\t\tProjParams=(");
-                if (count < 0 || count >= sizeof (cbuf))
-                {
-                    sprintf (errmsg, "Overflow of cbuf string");
-                    error_handler (true, FUNC_NAME, errmsg);
-                    return (ERROR);
-                }
-
-                if (!append_meta (struct_meta, &meta_indx, cbuf))
-                {
-                    sprintf (errmsg, "Error appending to metadata string (grid "
-                        "projection parameters start)");
-                    error_handler (true, FUNC_NAME, errmsg);
-                    return (ERROR);
-                }
-  
-                for (i = 0; i < NPROJ_PARAM; i++)
-                    proj_parms[i] = 0.0;
-        
-                switch (gmeta->proj_info.proj_type)
-                {
-                    case GCTP_GEO_PROJ:
-                        /* just use the already initialized zeros for the proj
-                           parms */
-                        break;
-            
-                    case GCTP_UTM_PROJ:
-                        /* UTM handled in the if statement above */
-                        break;
-        
-                    case GCTP_ALBERS_PROJ:
-                        proj_parms[2] =
-                            deg_to_dms (gmeta->proj_info.standard_parallel1);
-                        proj_parms[3] =
-                            deg_to_dms (gmeta->proj_info.standard_parallel2);
-                        proj_parms[4] =
-                            deg_to_dms (gmeta->proj_info.central_meridian);
-                        proj_parms[5] =
-                            deg_to_dms (gmeta->proj_info.origin_latitude);
-                        proj_parms[6] = gmeta->proj_info.false_easting;
-                        proj_parms[7] = gmeta->proj_info.false_northing;
-                        break;
-            
-                    case GCTP_PS_PROJ:
-                        proj_parms[4] =
-                            deg_to_dms (gmeta->proj_info.longitude_pole);
-                        proj_parms[5] =
-                            deg_to_dms (gmeta->proj_info.latitude_true_scale);
-                        proj_parms[6] = gmeta->proj_info.false_easting;
-                        proj_parms[7] = gmeta->proj_info.false_northing;
-                        break;
-            
-                    case GCTP_SIN_PROJ:
-                        proj_parms[0] = gmeta->proj_info.sphere_radius;
-                        proj_parms[4] =
-                            deg_to_dms (gmeta->proj_info.central_meridian);
-                        proj_parms[6] = gmeta->proj_info.false_easting;
-                        proj_parms[7] = gmeta->proj_info.false_northing;
-                        break;
-
-                    default:
-                        sprintf (errmsg, "Unsupported projection type (%d).  "
-                            "GEO projection code (%d) or UTM projection code "
-                            "(%d) or ALBERS projection code (%d) or PS "
-                            "projection code (%d) or SIN projection code (%d) "
-                            "expected.", gmeta->proj_info.proj_type,
-                            GCTP_GEO_PROJ, GCTP_UTM_PROJ, GCTP_ALBERS_PROJ,
-                            GCTP_PS_PROJ, GCTP_SIN_PROJ);
-                        error_handler (true, FUNC_NAME, errmsg);
-                        return (ERROR);
-                }
-
-                for (i = 0; i < NPROJ_PARAM; i++)
-                {
-                    if (i == NPROJ_PARAM-1)
-                        count = snprintf (cbuf, sizeof (cbuf), "%.6f)",
-                            proj_parms[i]);
-                    else
-                        count = snprintf (cbuf, sizeof (cbuf), "%.6f,",
-                            proj_parms[i]);
-                    if (count < 0 || count >= sizeof (cbuf))
-                    {
-                        sprintf (errmsg, "Overflow of cbuf string");
-                        error_handler (true, FUNC_NAME, errmsg);
-                        return (ERROR);
-                    }
-
-                    if (!append_meta (struct_meta, &meta_indx, cbuf))
-                    {
-                        sprintf (errmsg, "Error appending to metadata string ("
-                            "individual grid projection parameters)");
-                        error_handler (true, FUNC_NAME, errmsg);
-                        return (ERROR);
-                    }
-                }
-
-                count = snprintf (cbuf, sizeof (cbuf), "%s", "\n");
-                if (count < 0 || count >= sizeof (cbuf))
-                {
-                    sprintf (errmsg, "Overflow of cbuf string");
-                    error_handler (true, FUNC_NAME, errmsg);
-                    return (ERROR);
-                }
-
-                if (!append_meta (struct_meta, &meta_indx, cbuf))
-                {
-                    sprintf (errmsg, "Error appending to metadata string (grid "
-                        "projection parameters end)");
-                    error_handler (true, FUNC_NAME, errmsg);
-                    return (ERROR);
-                }
-            }
-  
-            switch (gmeta->proj_info.datum_type)
-            {
-                case (ESPA_WGS84):
-                    sphere_code = SPHERE_WGS84;
-                    strcpy (datum_str, "WGS84");
-                    break;
-                case (ESPA_NAD83):
-                    sphere_code = SPHERE_GRS80;
-                    strcpy (datum_str, "NAD83");
-                    break;
-                case (ESPA_NAD27):
-                    sphere_code = SPHERE_CLARKE_1866;
-                    strcpy (datum_str, "NAD27");
-                    break;
-                case (ESPA_NODATUM):
-                    sphere_code = -999;
-                    strcpy (datum_str, "NoDatum");
-                    break;
-            }
-          
-            /* Don't write the sphere code if this is the Geographic
-               projection */
-            if (gmeta->proj_info.proj_type != GCTP_GEO_PROJ)
-            {
-                if (gmeta->proj_info.datum_type != ESPA_NODATUM)
-                {
-                    count = snprintf (cbuf, sizeof (cbuf),
-                        "\t\tSphereCode=%d\n", sphere_code);
-                    if (count < 0 || count >= sizeof (cbuf))
-                    {
-                        sprintf (errmsg, "Overflow of cbuf string");
-                        error_handler (true, FUNC_NAME, errmsg);
-                        return (ERROR);
-                    }
-        
-                    if (!append_meta (struct_meta, &meta_indx, cbuf))
-                    {
-                        sprintf (errmsg, "Error appending to metadata string "
-                            "(grid information end)");
-                        error_handler (true, FUNC_NAME, errmsg);
-                        return (ERROR);
-                    }
-                }
-            }
-        
-            count = snprintf (cbuf, sizeof (cbuf),
-                "\t\tDatum=%s\n"
-                "\t\tGridOrigin=HDFE_GD_UL\n", datum_str);
-            if (count < 0 || count >= sizeof (cbuf))
-            {
-                sprintf (errmsg, "Overflow of cbuf string");
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
-            }
-        
-            if (!append_meta (struct_meta, &meta_indx, cbuf))
-            {
-                sprintf (errmsg, "Error appending to metadata string (grid "
-                    "information end)");
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
-            }
+        if (SDendaccess (sds_id) == HDF_ERROR) 
+        {
+            sprintf (errmsg, "Error ending access to SDS");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+    }
+    
+    if (SDend (hdf_file_id) == HDF_ERROR) 
+    {
+        sprintf (errmsg, "Error ending SD access");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
   
-            /* Put SDS group */
-            count = snprintf (cbuf, sizeof (cbuf), "%s",
-                "\t\tGROUP=Dimension\n" 
-                "\t\tEND_GROUP=Dimension\n"
-                "\t\tGROUP=DataField\n");
-            if (count < 0 || count >= sizeof (cbuf))
-            {
-                sprintf (errmsg, "Overflow of cbuf string");
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
-            }
+    /* Detach Vgroups */
+    if (Vdetach (vgroup_id[0]) == HDF_ERROR) 
+    {
+        sprintf (errmsg, "Error detaching from Grid Vgroup");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    if (Vdetach (vgroup_id[1]) == HDF_ERROR) 
+    {
+        sprintf (errmsg, "Error detaching from Data Fields Vgroup");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    if (Vdetach (vgroup_id[2]) == HDF_ERROR) 
+    {
+        sprintf (errmsg, "Error detaching from Attributes Vgroup");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
 
-            if (!append_meta (struct_meta, &meta_indx, cbuf))
-            {
-                sprintf (errmsg, "Error appending to metadata string (SDS "
-                    "group start)");
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
-            }
-
-            /* Loop through the bands and write those that match the current
-               resolution */
-            nfields = 0;
-            for (i = 0; i < xml_metadata->nbands; i++)
-            {
-                if ((xml_metadata->band[i].pixel_size[0] ==
-                     xml_metadata->band[isds].pixel_size[0]) &&
-                    (xml_metadata->band[i].pixel_size[1] ==
-                     xml_metadata->band[isds].pixel_size[1]))
-                {
-                    processed[i] = true;
-                    switch (xml_metadata->band[i].data_type)
-                    {
-                        case ESPA_INT8: strcpy(dtype, "DFNT_INT8"); break;
-                        case ESPA_UINT8: strcpy(dtype, "DFNT_UINT8"); break;
-                        case ESPA_INT16: strcpy(dtype, "DFNT_INT16"); break;
-                        case ESPA_UINT16: strcpy(dtype, "DFNT_UINT16"); break;
-                        case ESPA_INT32: strcpy(dtype, "DFNT_INT32"); break;
-                        case ESPA_UINT32: strcpy(dtype, "DFNT_UINT32"); break;
-                        case ESPA_FLOAT32: strcpy(dtype, "DFNT_FLOAT32"); break;
-                        case ESPA_FLOAT64: strcpy(dtype, "DFNT_FLOAT64"); break;
-                    }
-
-                    count = snprintf (cbuf, sizeof (cbuf),
-                        "\t\t\tOBJECT=DataField_%d\n"
-                        "\t\t\t\tDataFieldName=\"%s\"\n"
-                        "\t\t\t\tDataType=%s\n"
-                        "\t\t\t\tDimList=(\"%s\",\"%s\")\n"
-                        "\t\t\tEND_OBJECT=DataField_%d\n",
-                        nfields+1, xml_metadata->band[i].name, dtype,
-                        dim_names[0], dim_names[1], nfields+1);
-                    if (count < 0 || count >= sizeof (cbuf))
-                    {
-                        sprintf (errmsg, "Overflow of cbuf string");
-                        error_handler (true, FUNC_NAME, errmsg);
-                        return (ERROR);
-                    }
-                    if (!append_meta (struct_meta, &meta_indx, cbuf))
-                    {
-                        sprintf (errmsg, "Error appending to metadata string "
-                            "(SDS group)");
-                        error_handler (true, FUNC_NAME, errmsg);
-                        return (ERROR);
-                    }
-                    nfields++;
-                }
-            }
-  
-            /* Close off the grid */
-            count = snprintf (cbuf, sizeof (cbuf),
-              "\t\tEND_GROUP=DataField\n" 
-              "\t\tGROUP=MergedFields\n" 
-              "\t\tEND_GROUP=MergedFields\n"
-              "\tEND_GROUP=GRID_%d\n", ngrids+1);
-            if (count < 0 || count >= sizeof (cbuf))
-            {
-                sprintf (errmsg, "Overflow of cbuf string");
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
-            }
+    return (SUCCESS);
+}
 
-            if (!append_meta (struct_meta, &meta_indx, cbuf))
-            {
-                sprintf (errmsg, "Error appending to metadata string (SDS "
-                    "group end)");
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
-            }
-  
-            /* Keep track of the number of grids processed and which band they
-               were built from */
-            grid[ngrids++] = isds;
-        }  /* for isds */
-
-        /* Check to see if all the bands were processed now with this grid.
-           If not, then loop through the bands again and handle the remaining
-           bands, putting separate resolutions in different grids. */
-        done = true;
-        for (i = 0; i < xml_metadata->nbands; i++)
+
+/******************************************************************************
+MODULE:  write_hdf_eos_grids
+
+PURPOSE:  Write the spatial definition HDF-EOS attributes of the grids to the
+HDF file and move the SDSs to their grids.
+
+RETURN VALUE:
+Type = int
+Value      Description
+-----      -----------
+ERROR      Error occurred writing the metadata to the HDF file
+SUCCESS    Successful completion
+******************************************************************************/
+static int write_hdf_eos_grids
+(
+    char *hdf_file,            /* I: HDF file to write attributes to */
+    Espa_internal_meta_t *xml_metadata,  /* I: XML metadata structure */
+    const Espa_band_grids_t *grids  /* I: grids of the bands */
+)
+{
+    char FUNC_NAME[] = "write_hdf_eos_grids";  /* function name */
+    char errmsg[STR_SIZE];                    /* error message */
+    char *struct_meta = NULL;  /* structural metadata */
+    char attr_name[STR_SIZE];  /* name of the current structural metadata
+                                  attribute */
+    double dval;             /* temporary double value */
+    size_t meta_len = 0;     /* length of the structural metadata */
+    size_t offset;           /* offset of the current attribute in the
+                                structural metadata */
+    int part;                /* looping variable for the attributes */
+    int write_error;         /* did printing the structural metadata
+                                fail? */
+    int igrid;               /* looping variable for the grids */
+    int32 hdf_id;            /* HDF-EOS file ID */
+    int32 hdf_file_id;       /* HDF file ID */
+    FILE *meta_fp = NULL;    /* stream building the structural metadata */
+    Espa_hdf_attr_t attr;    /* attributes for writing the metadata */
+
+    /* Build the structural metadata in one pass over the grids, in a memory
+       buffer which grows as needed */
+    meta_fp = open_memstream (&struct_meta, &meta_len);
+    if (meta_fp == NULL)
+    {
+        sprintf (errmsg, "Opening the memory buffer for the structural "
+            "metadata");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Build the HDF-EOS header */
+    fprintf (meta_fp, "%s",
+        "\nGROUP=SwathStructure\n" 
+        "END_GROUP=SwathStructure\n" 
+        "GROUP=GridStructure\n");
+
+    /* Build the metadata of each grid, the first being the only grid if this
+       isn't a multi-resolution product */
+    for (igrid = 0; igrid < grids->ngrids; igrid++)
+    {
+        if (append_grid_struct_meta (xml_metadata, grids, igrid, meta_fp)
+            != SUCCESS)
         {
-            if (!processed[i])
-            {
-                done = false;
-                break;
-            }
+            sprintf (errmsg, "Building the structural metadata of grid %d",
+                igrid+1);
+            error_handler (true, FUNC_NAME, errmsg);
+            fclose (meta_fp);
+            free (struct_meta);
+            return (ERROR);
         }
-    }  /* end while !done */
+    }
 
     /* Put trailer */
-    count = snprintf (cbuf, sizeof (cbuf), "%s",
+    fprintf (meta_fp, "%s",
         "END_GROUP=GridStructure\n"
         "GROUP=PointStructure\n"
         "END_GROUP=PointStructure\n"
         "END\n");
-    if (count < 0 || count >= sizeof (cbuf))
-    {
-        sprintf (errmsg, "Overflow of cbuf string");
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
-    }
-
-    if (!append_meta (struct_meta, &meta_indx, cbuf))
+    write_error = ferror (meta_fp);
+    if (fclose (meta_fp) != 0 || write_error)
     {
-        sprintf (errmsg, "Error appending to metadata string (tail)");
+        sprintf (errmsg, "Building the structural metadata in memory");
         error_handler (true, FUNC_NAME, errmsg);
+        free (struct_meta);
         return (ERROR);
     }
   
@@ -1083,29 +593,43 @@ int write_hdf_eos_attr
     {
         sprintf (errmsg, "Error opening file for SD access: %s", hdf_file);
         error_handler (true, FUNC_NAME, errmsg);
+        free (struct_meta);
         return (ERROR);
     }
     
     attr.type = DFNT_FLOAT64;
     attr.nval = 1;
     attr.name = OUTPUT_ORIENTATION_ANGLE_HDF;
-    dval = (double) gmeta->orientation_angle;
+    dval = (double) xml_metadata->global.orientation_angle;
     if (put_attr_double (hdf_file_id, &attr, &dval) != SUCCESS)
     {
         sprintf (errmsg, "Error writing attribute (orientation angle)");
         error_handler (true, FUNC_NAME, errmsg);
+        free (struct_meta);
         return (ERROR);
     }
   
+    /* Split the structural metadata into StructMetadata.0, .1, ..., which
+       the HDF-EOS library reads back in order and concatenates */
     attr.type = DFNT_CHAR8;
-    attr.nval = strlen (struct_meta);
-    attr.name = OUTPUT_STRUCT_METADATA;
-    if (put_attr_string (hdf_file_id, &attr, struct_meta) != SUCCESS)
+    attr.name = attr_name;
+    for (part = 0, offset = 0; offset < meta_len; part++)
     {
-        sprintf (errmsg, "Error writing attribute (struct_meta)");
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
+        sprintf (attr_name, "%s.%d", OUTPUT_STRUCT_METADATA, part);
+        attr.nval = meta_len - offset;
+        if (attr.nval > ESPA_STRUCT_METADATA_CHUNK)
+            attr.nval = ESPA_STRUCT_METADATA_CHUNK;
+        if (put_attr_string (hdf_file_id, &attr, struct_meta + offset)
+            != SUCCESS)
+        {
+            sprintf (errmsg, "Error writing attribute (%s)", attr_name);
+            error_handler (true, FUNC_NAME, errmsg);
+            free (struct_meta);
+            return (ERROR);
+        }
+        offset += attr.nval;
     }
+    free (struct_meta);
   
     if (SDend (hdf_file_id) == HDF_ERROR) 
     {
@@ -1134,204 +658,207 @@ int write_hdf_eos_attr
   
     /* Loop through the Grids, define them, and then assign appropriate SDSs
        to the Data Fields */
-    for (igrid = 0; igrid < ngrids; igrid++)
+    for (igrid = 0; igrid < grids->ngrids; igrid++)
     {
-        /* Create Vgroup for current Grid */
-        vgroup_id[0] = Vattach (hdf_id, -1, "w");
-        if (vgroup_id[0] == HDF_ERROR) 
+        if (attach_grid_vgroup (hdf_file, hdf_id, xml_metadata, grids, igrid)
+            != SUCCESS)
         {
-            sprintf (errmsg, "Error getting Grid Vgroup ID");
+            sprintf (errmsg, "Attaching the SDSs of grid %d", igrid+1);
             error_handler (true, FUNC_NAME, errmsg);
             return (ERROR);
         }
+    }
 
-        /* If this is the first grid, then don't use the pixel size in the grid
-           name.  Otherwise use the pixel size in the grid name.  If processing
-           geographic then use the count of the grids instead of the pixel
-           size. */
-        if (igrid == 0 &&
-            xml_metadata->global.proj_info.proj_type != GCTP_GEO)
-            count = snprintf (temp_name, sizeof (temp_name), "%s", grid_name);
-        else
-        {
-            if (xml_metadata->global.proj_info.proj_type == GCTP_GEO)
-                mycount = igrid+1;
-            else
-                mycount = (int) xml_metadata->band[grid[igrid]].pixel_size[0];
-            count = snprintf (temp_name, sizeof (temp_name), "%s_%d", grid_name,
-                mycount);
-        }
+    /* Close access */
+    if (Vend (hdf_id) == HDF_ERROR) 
+    {
+        sprintf (errmsg, "Error ending Vgroup access");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    if (Hclose (hdf_id) == HDF_ERROR) 
+    {
+        sprintf (errmsg, "Error ending HDF access");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
 
-        if (count < 0 || count >= sizeof (temp_name))
-        {
-            sprintf (errmsg, "Overflow of temp_name string");
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
+    return (SUCCESS);
+}
 
 
-        if (Vsetname (vgroup_id[0], temp_name) == HDF_ERROR) 
-        {
-            sprintf (errmsg, "Error setting Grid Vgroup name: %s", temp_name);
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
-        if (Vsetclass (vgroup_id[0], "GRID") == HDF_ERROR) 
-        {
-            sprintf (errmsg, "Error setting Grid Vgroup class to GRID");
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
-  
-        /* Create Data Fields Vgroup */
-        vgroup_id[1] = Vattach (hdf_id, -1, "w");
-        if (vgroup_id[1] == HDF_ERROR) 
-        {
-            sprintf (errmsg, "Error getting Data Fields Vgroup ID");
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
-        if (Vsetname (vgroup_id[1], "Data Fields") == HDF_ERROR) 
-        {
-            sprintf (errmsg, "Error setting Data Fields Vgroup name");
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
-        if (Vsetclass (vgroup_id[1], "GRID Vgroup") == HDF_ERROR) 
-        {
-            sprintf (errmsg, "Error setting Data Fields Vgroup class");
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
-        if (Vinsert (vgroup_id[0], vgroup_id[1]) == HDF_ERROR) 
-        {
-            sprintf (errmsg, "Error inserting Data Fields Vgroup");
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
-  
-        /* Create Attributes Vgroup */
-        vgroup_id[2] = Vattach (hdf_id, -1, "w");
-        if (vgroup_id[2] == HDF_ERROR) 
-        {
-            sprintf (errmsg, "Error getting attributes Vgroup ID");
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
-        if (Vsetname (vgroup_id[2], "Grid Attributes") == HDF_ERROR) 
-        {
-            sprintf (errmsg, "Error setting attributes Vgroup name");
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
-        if (Vsetclass (vgroup_id[2], "GRID Vgroup") == HDF_ERROR) 
-        {
-            sprintf (errmsg, "Error setting attributes Vgroup class");
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
-        if (Vinsert (vgroup_id[0], vgroup_id[2]) == HDF_ERROR) 
-        {
-            sprintf (errmsg, "Error inserting attributes Vgroup");
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
-  
-        /* Attach SDSs to Data Fields Vgroup */
-        hdf_file_id = SDstart ((char *)hdf_file, DFACC_RDWR);
-        if (hdf_file_id == HDF_ERROR) 
-        {
-            sprintf (errmsg, "Error opening output file for SD access");
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
-  
-        /* Loop through the bands and attach those with the same resolution
-           as the current grid */
-        for (isds = 0; isds < xml_metadata->nbands; isds++)
-        {
-            if ((xml_metadata->band[isds].pixel_size[0] !=
-                 xml_metadata->band[grid[igrid]].pixel_size[0]) ||
-                (xml_metadata->band[isds].pixel_size[1] !=
-                 xml_metadata->band[grid[igrid]].pixel_size[1]))
-                continue;
-
-            sds_index = SDnametoindex (hdf_file_id, 
-                xml_metadata->band[isds].name);
-            if (sds_index == HDF_ERROR) 
-            {
-                sprintf (errmsg, "Error getting SDS index for SDS[%d]: %s",
-                    isds, xml_metadata->band[isds].name);
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
-            }
+/******************************************************************************
+MODULE:  write_hdf_eos_attr
 
-            sds_id = SDselect (hdf_file_id, sds_index);
-            if (sds_id == HDF_ERROR) 
-            {
-                sprintf (errmsg, "Error getting SDS ID");
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
-            }
+PURPOSE:  Write the spatial definition HDF-EOS attributes to the HDF file and
+move the SDSs to the Grid.
 
-            if (Vaddtagref (vgroup_id[1], DFTAG_NDG, SDidtoref(sds_id)) == 
-                HDF_ERROR) 
-            {
-                sprintf (errmsg, "Error adding reference tag to SDS");
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
-            }
+RETURN VALUE:
+Type = int
+Value      Description
+-----      -----------
+ERROR      Error occurred writing the metadata to the HDF file
+SUCCESS    Successful completion
 
-            if (SDendaccess (sds_id) == HDF_ERROR) 
-            {
-                sprintf (errmsg, "Error ending access to SDS");
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
-            }
-        }
-        
-        if (SDend (hdf_file_id) == HDF_ERROR) 
-        {
-            sprintf (errmsg, "Error ending SD access");
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
-  
-        /* Detach Vgroups */
-        if (Vdetach (vgroup_id[0]) == HDF_ERROR) 
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. The bands are grouped into grids with get_espa_band_grids, so each
+     resolution of a multi-resolution product is its own grid at its native
+     size.  There is no fixed limit on the bands or grids.
+******************************************************************************/
+int write_hdf_eos_attr
+(
+    char *hdf_file,            /* I: HDF file to write attributes to */
+    Espa_internal_meta_t *xml_metadata   /* I: XML metadata structure */
+)
+{
+    char FUNC_NAME[] = "write_hdf_eos_attr";  /* function name */
+    char errmsg[STR_SIZE];                    /* error message */
+    int status;              /* return status */
+    Espa_band_grids_t grids; /* grids of the bands */
+
+    if (get_espa_band_grids (xml_metadata, &grids) != SUCCESS)
+    {
+        sprintf (errmsg, "Grouping the bands into grids");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    status = write_hdf_eos_grids (hdf_file, xml_metadata, &grids);
+    free_espa_band_grids (&grids);
+    if (status != SUCCESS)
+    {
+        sprintf (errmsg, "Writing the HDF-EOS grids of %s", hdf_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  read_hdf_eos_odl
+
+PURPOSE:  Reads an ODL metadata attribute of an HDF-EOS file (ex.
+CoreMetadata or ArchiveMetadata) and parses it into an index of its values.
+
+RETURN VALUE:
+Type = int
+Value      Description
+-----      -----------
+ERROR      Error reading or parsing the metadata
+SUCCESS    Successfully read and parsed the metadata
+
+NOTES:
+  1. The metadata is read from the attribute named attr_base, or else from
+     the attributes attr_base.0, attr_base.1, ..., which the HDF-EOS
+     library splits longer metadata into.  Each part is read once, straight
+     into the text parsed, and any NUL padding at the end of a part is
+     dropped.
+  2. The caller frees the parsed metadata with espa_odl_free when it is
+     read successfully.
+******************************************************************************/
+int read_hdf_eos_odl
+(
+    int32 sd_id,               /* I: file ID for the HDF file */
+    const char *attr_base,     /* I: name of the metadata attribute (ex.
+                                     CoreMetadata) */
+    Espa_odl_t *odl            /* O: parsed metadata */
+)
+{
+    char FUNC_NAME[] = "read_hdf_eos_odl";  /* function name */
+    char errmsg[STR_SIZE];     /* error message */
+    char attr_name[STR_SIZE];  /* name of a part of the metadata */
+    char *text = NULL;         /* metadata text */
+    char *new_text = NULL;     /* reallocated metadata text */
+    int j;                     /* looping variable for the parts */
+    int first;                 /* number of the first part; -1 if the
+                                  metadata isn't split */
+    size_t len = 0;            /* length of the text read so far */
+    int32 attr_indx;           /* index of a part */
+    int32 data_type;           /* data type of a part */
+    int32 n_values;            /* number of chars in a part */
+
+    odl->text = NULL;
+    odl->entries = NULL;
+    odl->nentries = 0;
+
+    /* Find the attribute, or the first of its parts */
+    first = -1;
+    attr_indx = SDfindattr (sd_id, (char *) attr_base);
+    for (j = 0; attr_indx == -1 && j <= 9; j++)
+    {
+        snprintf (attr_name, sizeof (attr_name), "%s.%d", attr_base, j);
+        attr_indx = SDfindattr (sd_id, attr_name);
+        if (attr_indx != -1)
+            first = j;
+    }
+    if (attr_indx == -1)
+    {
+        sprintf (errmsg, "Unable to locate %s for reading", attr_base);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Read each part onto the end of the text */
+    for (j = first; attr_indx != -1; )
+    {
+        if (SDattrinfo (sd_id, attr_indx, attr_name, &data_type, &n_values)
+            == -1)
         {
-            sprintf (errmsg, "Error detaching from Grid Vgroup");
+            sprintf (errmsg, "Unable to get the size of the %s attribute",
+                attr_base);
             error_handler (true, FUNC_NAME, errmsg);
+            free (text);
             return (ERROR);
         }
-        if (Vdetach (vgroup_id[1]) == HDF_ERROR) 
+        new_text = realloc (text, len + n_values + 1);
+        if (new_text == NULL)
         {
-            sprintf (errmsg, "Error detaching from Data Fields Vgroup");
+            sprintf (errmsg, "Unable to allocate %d bytes for %s", n_values,
+                attr_name);
             error_handler (true, FUNC_NAME, errmsg);
+            free (text);
             return (ERROR);
         }
-        if (Vdetach (vgroup_id[2]) == HDF_ERROR) 
+        text = new_text;
+        if (SDreadattr (sd_id, attr_indx, text + len) == -1)
         {
-            sprintf (errmsg, "Error detaching from Attributes Vgroup");
+            sprintf (errmsg, "Unable to read the %s HDF attribute",
+                attr_name);
             error_handler (true, FUNC_NAME, errmsg);
+            free (text);
             return (ERROR);
         }
+        text[len + n_values] = '\0';
+        len += strlen (text + len);
+
+        /* Move on to the next part, if the metadata is split */
+        if (first < 0)
+            break;
+        snprintf (attr_name, sizeof (attr_name), "%s.%d", attr_base, ++j);
+        attr_indx = SDfindattr (sd_id, attr_name);
     }
 
-    /* Close access */
-    if (Vend (hdf_id) == HDF_ERROR) 
+    if (len == 0)
     {
-        sprintf (errmsg, "Error ending Vgroup access");
+        sprintf (errmsg, "The %s HDF attribute is empty", attr_base);
         error_handler (true, FUNC_NAME, errmsg);
+        free (text);
         return (ERROR);
     }
-    if (Hclose (hdf_id) == HDF_ERROR) 
+
+    /* Parse the text, which is handed to the parsed metadata */
+    if (espa_odl_parse (text, odl) != SUCCESS)
     {
-        sprintf (errmsg, "Error ending HDF access");
+        sprintf (errmsg, "Unable to parse the %s metadata", attr_base);
         error_handler (true, FUNC_NAME, errmsg);
+        espa_odl_free (odl);
         return (ERROR);
     }
 
     return (SUCCESS);
 }
-
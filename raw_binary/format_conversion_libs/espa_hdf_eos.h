@@ -23,6 +23,8 @@ NOTES:
 #include "HdfEosDef.h"
 #include "espa_metadata.h"
 #include "espa_hdf.h"
+#include "espa_band_grids.h"
+#include "espa_odl.h"
 #include "error_handler.h"
 
 
@@ -35,21 +37,23 @@ NOTES:
 #define SPHERE_GRS80 8
 #define SPHERE_WGS84 12
 
-/* size of the metadata string for defining the HDF-EOS metadata */
-#define ESPA_MAX_METADATA_SIZE 10240
+/* maximum size of each StructMetadata.N attribute holding a part of the
+   HDF-EOS structural metadata, as written by the HDF-EOS library */
+#define ESPA_STRUCT_METADATA_CHUNK 32000
 
 /* Prototypes */
-bool append_meta
-(
-    char *cbuf,  /* I/O: input metadata buffer */
-    int *ic,     /* I/O: index of current location in metadata buffer */
-    char *str    /* I: string to append to the metadata buffer */
-);
-
 int write_hdf_eos_attr
 (
     char *hdf_file,            /* I: HDF file to write attributes to */
     Espa_internal_meta_t *xml_metadata  /* I: XML metadata structure */
 );
 
+int read_hdf_eos_odl
+(
+    int32 sd_id,               /* I: file ID for the HDF file */
+    const char *attr_base,     /* I: name of the metadata attribute (ex.
+                                     CoreMetadata) */
+    Espa_odl_t *odl            /* O: parsed metadata */
+);
+
 #endif
@@ -0,0 +1,329 @@
+/*****************************************************************************
+FILE: espa_odl.c
+
+PURPOSE: Contains functions for parsing the Object Description Language
+(ODL) text of the HDF-EOS metadata into an index of its values, and looking
+values up in the index.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. Names are compared as they are written; the HDF-EOS metadata writes
+     them in upper case.
+*****************************************************************************/
+
+#include <string.h>
+#include <ctype.h>
+#include "error_handler.h"
+#include "espa_odl.h"
+
+/******************************************************************************
+MODULE:  skip_odl_blanks
+
+PURPOSE: Skips the white space and comments before the next token.
+
+RETURN VALUE:
+Type = char *
+Value           Description
+-----           -----------
+ptr             Start of the next token; the end of the text if there are no
+                more tokens
+
+NOTES:
+******************************************************************************/
+static char *skip_odl_blanks
+(
+    char *ptr                  /* I: current position in the text */
+)
+{
+    char *end = NULL;          /* end of a comment */
+
+    while (1)
+    {
+        while (isspace ((unsigned char) *ptr))
+            ptr++;
+        if (ptr[0] != '/' || ptr[1] != '*')
+            return ptr;
+        end = strstr (ptr + 2, "*/");
+        if (end == NULL)
+            return ptr + strlen (ptr);
+        ptr = end + 2;
+    }
+}
+
+
+/******************************************************************************
+MODULE:  compare_odl_entries
+
+PURPOSE: Orders the statements by object, name, and position in the text.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+<0, 0, >0       Standard qsort ordering
+
+NOTES:
+******************************************************************************/
+static int compare_odl_entries
+(
+    const void *a,             /* I: first statement */
+    const void *b              /* I: second statement */
+)
+{
+    const Espa_odl_entry_t *ea = a;  /* first statement */
+    const Espa_odl_entry_t *eb = b;  /* second statement */
+    int cmp;                   /* comparison of the names */
+
+    cmp = strcmp (ea->object, eb->object);
+    if (cmp == 0)
+        cmp = strcmp (ea->name, eb->name);
+    if (cmp == 0)
+        cmp = ea->order - eb->order;
+    return cmp;
+}
+
+
+/******************************************************************************
+MODULE:  espa_odl_parse
+
+PURPOSE: Parses the ODL text in a single pass, indexing each of its
+statements by its innermost GROUP or OBJECT and its name.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error parsing the text
+SUCCESS         Successfully parsed the text
+
+NOTES:
+  1. The text is split into its names and values in place, and is freed
+     with the index by espa_odl_free, whether or not it could be parsed.
+  2. The text ends at the END statement, or at its terminating NUL.
+  3. An END_GROUP or END_OBJECT closes the innermost GROUP or OBJECT; the
+     name it repeats isn't checked.
+******************************************************************************/
+int espa_odl_parse
+(
+    char *text,                /* I: ODL text, allocated with malloc; owned
+                                     by odl afterwards */
+    Espa_odl_t *odl            /* O: parsed text */
+)
+{
+    char FUNC_NAME[] = "espa_odl_parse";  /* function name */
+    char errmsg[STR_SIZE];     /* error message */
+    char *ptr = text;          /* current position in the text */
+    char *name = NULL;         /* name of the current statement */
+    char *name_end = NULL;     /* end of the name */
+    char *value = NULL;        /* value of the current statement */
+    const char *stack[ESPA_ODL_MAX_DEPTH];  /* open GROUPs and OBJECTs */
+    int depth = 0;             /* number of open GROUPs and OBJECTs */
+    int nest;                  /* nesting of the parentheses of a list */
+    int max_entries = 0;       /* number of statements allocated */
+    Espa_odl_entry_t *entries = NULL;  /* reallocated statements */
+
+    odl->text = text;
+    odl->entries = NULL;
+    odl->nentries = 0;
+
+    while (1)
+    {
+        /* Name of the statement */
+        ptr = skip_odl_blanks (ptr);
+        if (*ptr == '\0')
+            break;
+        name = ptr;
+        while (*ptr != '\0' && *ptr != '=' && !isspace ((unsigned char) *ptr))
+            ptr++;
+        name_end = ptr;
+        ptr = skip_odl_blanks (ptr);
+        if (*ptr != '=')
+        {
+            /* Only END stands on its own */
+            *name_end = '\0';
+            if (!strcmp (name, "END"))
+                break;
+            sprintf (errmsg, "ODL statement %.64s has no value", name);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+        ptr++;
+        *name_end = '\0';
+
+        /* Value of the statement, NUL terminated in place */
+        ptr = skip_odl_blanks (ptr);
+        if (*ptr == '"')
+        {
+            value = ptr + 1;
+            ptr = strchr (value, '"');
+            if (ptr == NULL)
+            {
+                sprintf (errmsg, "Value of ODL statement %.64s has no "
+                    "closing quote", name);
+                error_handler (true, FUNC_NAME, errmsg);
+                return (ERROR);
+            }
+            *ptr++ = '\0';
+        }
+        else if (*ptr == '(')
+        {
+            value = ptr;
+            nest = 0;
+            for ( ; *ptr != '\0'; ptr++)
+            {
+                if (*ptr == '"')
+                {
+                    ptr = strchr (ptr + 1, '"');
+                    if (ptr == NULL)
+                        break;
+                }
+                else if (*ptr == '(')
+                    nest++;
+                else if (*ptr == ')' && --nest == 0)
+                    break;
+            }
+            if (ptr == NULL || *ptr != ')' ||
+                (ptr[1] != '\0' && !isspace ((unsigned char) ptr[1])))
+            {
+                sprintf (errmsg, "List of ODL statement %.64s isn't closed",
+                    name);
+                error_handler (true, FUNC_NAME, errmsg);
+                return (ERROR);
+            }
+            ptr++;
+            if (*ptr != '\0')
+                *ptr++ = '\0';
+        }
+        else
+        {
+            value = ptr;
+            while (*ptr != '\0' && !isspace ((unsigned char) *ptr))
+                ptr++;
+            if (*ptr != '\0')
+                *ptr++ = '\0';
+        }
+
+        /* Open or close a GROUP or OBJECT, or index the statement */
+        if (!strcmp (name, "GROUP") || !strcmp (name, "OBJECT"))
+        {
+            if (depth == ESPA_ODL_MAX_DEPTH)
+            {
+                sprintf (errmsg, "ODL groups and objects are nested more "
+                    "than %d deep", ESPA_ODL_MAX_DEPTH);
+                error_handler (true, FUNC_NAME, errmsg);
+                return (ERROR);
+            }
+            stack[depth++] = value;
+        }
+        else if (!strcmp (name, "END_GROUP") || !strcmp (name, "END_OBJECT"))
+        {
+            if (depth > 0)
+                depth--;
+        }
+        else
+        {
+            if (odl->nentries == max_entries)
+            {
+                max_entries = max_entries == 0 ? 256 : 2 * max_entries;
+                entries = realloc (odl->entries,
+                    max_entries * sizeof (Espa_odl_entry_t));
+                if (entries == NULL)
+                {
+                    sprintf (errmsg, "Allocating the ODL statements");
+                    error_handler (true, FUNC_NAME, errmsg);
+                    return (ERROR);
+                }
+                odl->entries = entries;
+            }
+            odl->entries[odl->nentries].object =
+                depth > 0 ? stack[depth-1] : "";
+            odl->entries[odl->nentries].name = name;
+            odl->entries[odl->nentries].value = value;
+            odl->entries[odl->nentries].order = odl->nentries;
+            odl->nentries++;
+        }
+    }
+
+    /* Index the statements */
+    if (odl->nentries > 1)
+        qsort (odl->entries, odl->nentries, sizeof (Espa_odl_entry_t),
+            compare_odl_entries);
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  espa_odl_find
+
+PURPOSE: Looks up the value of a statement in the index.
+
+RETURN VALUE:
+Type = const char *
+Value           Description
+-----           -----------
+NULL            The statement isn't in the text
+non-NULL        Value of the statement
+
+NOTES:
+  1. If the GROUP or OBJECT holds the statement more than once (ex. the
+     MEASUREDPARAMETER containers of the ECS metadata), the first in the
+     text is returned.
+******************************************************************************/
+const char *espa_odl_find
+(
+    const Espa_odl_t *odl,     /* I: parsed text */
+    const char *object,        /* I: name of the GROUP or OBJECT */
+    const char *name           /* I: name of the statement */
+)
+{
+    int low = 0;               /* first statement which may match */
+    int high = odl->nentries;  /* one past the last which may match */
+    int mid;                   /* statement being compared */
+    int cmp;                   /* comparison with the statement */
+
+    /* Find the first statement which isn't before the one looked for */
+    while (low < high)
+    {
+        mid = (low + high) / 2;
+        cmp = strcmp (odl->entries[mid].object, object);
+        if (cmp == 0)
+            cmp = strcmp (odl->entries[mid].name, name);
+        if (cmp < 0)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+
+    if (low < odl->nentries && !strcmp (odl->entries[low].object, object) &&
+        !strcmp (odl->entries[low].name, name))
+        return odl->entries[low].value;
+    return NULL;
+}
+
+
+/******************************************************************************
+MODULE:  espa_odl_free
+
+PURPOSE: Frees the parsed text and its index.
+
+RETURN VALUE:
+Type = N/A
+
+NOTES:
+******************************************************************************/
+void espa_odl_free
+(
+    Espa_odl_t *odl            /* I/O: parsed text to be freed */
+)
+{
+    free (odl->entries);
+    free (odl->text);
+    odl->entries = NULL;
+    odl->text = NULL;
+    odl->nentries = 0;
+}
@@ -0,0 +1,74 @@
+/*****************************************************************************
+FILE: espa_odl.h
+
+PURPOSE: Contains defines and prototypes for parsing the Object Description
+Language (ODL) text of the HDF-EOS metadata (ex. CoreMetadata.0 and
+ArchiveMetadata.0) into an index of its values.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The text is tokenized once, in place, and each statement inside a GROUP
+     or OBJECT is indexed by the name of its innermost GROUP or OBJECT and
+     its own name, so any number of values are looked up without scanning
+     the text again.  For the ECS metadata the value of a field is then the
+     VALUE of the OBJECT named for the field.
+  2. Quoted strings are stored without their quotes.  Lists in parentheses
+     are stored as they are written, with their parentheses.
+  3. The parser doesn't depend on the HDF library, so it serves the HDF4 and
+     HDF5 readers alike; see read_hdf_eos_odl for reading the text from an
+     HDF4 file.
+*****************************************************************************/
+
+#ifndef ESPA_ODL_H
+#define ESPA_ODL_H
+
+#include <stdlib.h>
+
+/* Defines */
+#define ESPA_ODL_MAX_DEPTH 32      /* deepest nesting of GROUPs and OBJECTs */
+
+/* Statement of the ODL text */
+typedef struct
+{
+    const char *object;            /* name of the innermost GROUP or OBJECT;
+                                      "" at the top level */
+    const char *name;              /* name of the statement */
+    const char *value;             /* value of the statement */
+    int order;                     /* position of the statement in the
+                                      text */
+} Espa_odl_entry_t;
+
+/* Parsed ODL text */
+typedef struct
+{
+    char *text;                    /* text, tokenized in place */
+    Espa_odl_entry_t *entries;     /* statements, sorted by object, name,
+                                      and order */
+    int nentries;                  /* number of statements */
+} Espa_odl_t;
+
+/* Prototypes */
+int espa_odl_parse
+(
+    char *text,                    /* I: ODL text, allocated with malloc;
+                                         owned by odl afterwards */
+    Espa_odl_t *odl                /* O: parsed text */
+);
+
+const char *espa_odl_find
+(
+    const Espa_odl_t *odl,         /* I: parsed text */
+    const char *object,            /* I: name of the GROUP or OBJECT */
+    const char *name               /* I: name of the statement */
+);
+
+void espa_odl_free
+(
+    Espa_odl_t *odl                /* I/O: parsed text to be freed */
+);
+
+#endif
@@ -0,0 +1,971 @@
+/*****************************************************************************
+FILE: espa_spatial_subset.c
+
+PURPOSE: Contains functions for cutting a spatial window out of an ESPA
+product.  Unlike the XML subsets (subset_metadata.c), the pixels of the window
+are read and written to new raw binary files for each band.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The XML metadata format parsed or written via this library follows the
+     ESPA internal metadata format found in ESPA Raw Binary Format v1.0.doc.
+     The schema for the ESPA internal metadata format is available at
+     http://espa.cr.usgs.gov/schema/espa_internal_metadata_v1_0.xsd.
+*****************************************************************************/
+#include <math.h>
+#include "espa_spatial_subset.h"
+#include "espa_band_stack.h"
+#include "espa_footprint.h"
+#include "raw_binary_io.h"
+#include "raw_binary_writer.h"
+#include "espa_task_pool.h"
+#include "espa_trace.h"
+
+/* Tolerance of the pixel edges for the projection windows and of the ratios
+   of the pixel sizes of the bands */
+#define SPATIAL_SUBSET_EPSILON 1.0e-6
+
+
+/******************************************************************************
+MODULE:  spatial_subset_threads
+
+PURPOSE: Returns the number of bands to be subset at the same time.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+n               Number of threads for the band subsets
+
+NOTES:
+  1. Each subset streams one raw binary file in and one out, so the number in
+     flight is limited to SPATIAL_SUBSET_DEFAULT_THREADS (or
+     SPATIAL_SUBSET_THREADS_ENV) rather than the number of processors.  It is
+     never more than the threads of the task pool or the bands.
+******************************************************************************/
+static int spatial_subset_threads
+(
+    int nbands              /* I: number of bands to be subset */
+)
+{
+    int nthreads;           /* number of threads */
+    char *env = NULL;       /* value of the environment variable */
+
+    env = getenv (SPATIAL_SUBSET_THREADS_ENV);
+    nthreads = env != NULL ? atoi (env) : SPATIAL_SUBSET_DEFAULT_THREADS;
+    if (nthreads > espa_task_pool_threads ())
+        nthreads = espa_task_pool_threads ();
+    if (nthreads > nbands)
+        nthreads = nbands;
+    if (nthreads < 1)
+        nthreads = 1;
+
+    return (nthreads);
+}
+
+
+/******************************************************************************
+MODULE:  pixel_ratio
+
+PURPOSE: Gets the ratio of the pixel size of a band to the pixel size of the
+reference band, as the band pixels per reference pixel (mult) or the
+reference pixels per band pixel (div).
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           The ratio isn't a whole number either way
+SUCCESS         Successfully got the ratio
+
+NOTES:
+  1. One of mult and div is always 1.  Band pixel n covers the reference
+     pixels n * div / mult through (n + 1) * div / mult - 1.
+******************************************************************************/
+static int pixel_ratio
+(
+    double ref_size,        /* I: pixel size of the reference band */
+    double band_size,       /* I: pixel size of the band */
+    int *mult,              /* O: band pixels per reference pixel */
+    int *div                /* O: reference pixels per band pixel */
+)
+{
+    double ratio;           /* ratio of the larger to the smaller size */
+
+    ratio = band_size >= ref_size ? band_size / ref_size :
+        ref_size / band_size;
+    if (fabs (ratio - floor (ratio + 0.5)) > SPATIAL_SUBSET_EPSILON)
+        return (ERROR);
+
+    *mult = 1;
+    *div = 1;
+    if (band_size >= ref_size)
+        *div = (int) floor (ratio + 0.5);
+    else
+        *mult = (int) floor (ratio + 0.5);
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  greatest_common_divisor
+
+PURPOSE: Computes the greatest common divisor of two positive integers.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+n               Greatest common divisor of a and b
+******************************************************************************/
+static int greatest_common_divisor
+(
+    int a,                  /* I: first integer */
+    int b                   /* I: second integer */
+)
+{
+    int r;                  /* remainder */
+
+    while (b != 0)
+    {
+        r = a % b;
+        a = b;
+        b = r;
+    }
+
+    return (a);
+}
+
+
+/******************************************************************************
+MODULE:  get_reference_window
+
+PURPOSE: Converts the requested window to the lines and samples of the
+reference band and checks that it is within the band.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           The window is empty or outside of the reference band
+SUCCESS         Successfully got the window
+
+NOTES:
+  1. A projection window is widened to whole pixels and clipped to the
+     band, so any pixel it touches is kept.  A window of lines and samples
+     needs to be within the band.
+******************************************************************************/
+static int get_reference_window
+(
+    Espa_spatial_window_t *window,  /* I: requested window */
+    Space_def_t *geoloc_def,        /* I: grid of the reference band */
+    Espa_pixel_window_t *ref        /* O: window in the reference band */
+)
+{
+    char FUNC_NAME[] = "get_reference_window";   /* function name */
+    char errmsg[STR_SIZE];  /* error message */
+    int line1;              /* line after the last line of the window */
+    int samp1;              /* sample after the last sample of the window */
+    int ref_nlines = geoloc_def->img_size.l;  /* lines in the band */
+    int ref_nsamps = geoloc_def->img_size.s;  /* samples in the band */
+    double pixel_x = geoloc_def->pixel_size[0];  /* pixel width */
+    double pixel_y = geoloc_def->pixel_size[1];  /* pixel height */
+
+    if (!window->proj_window)
+    {
+        *ref = window->pixels;
+        if (ref->line0 < 0 || ref->samp0 < 0 || ref->nlines <= 0 ||
+            ref->nsamps <= 0 || ref->line0 + ref->nlines > ref_nlines ||
+            ref->samp0 + ref->nsamps > ref_nsamps)
+        {
+            sprintf (errmsg, "Window of lines %d-%d and samples %d-%d is not "
+                "within the %d lines and %d samples of the reference band",
+                ref->line0, ref->line0 + ref->nlines - 1, ref->samp0,
+                ref->samp0 + ref->nsamps - 1, ref_nlines, ref_nsamps);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+        return (SUCCESS);
+    }
+
+    if (window->ulx >= window->lrx || window->uly <= window->lry)
+    {
+        sprintf (errmsg, "The UL corner (%f, %f) of the window needs to be "
+            "left of and above the LR corner (%f, %f)", window->ulx,
+            window->uly, window->lrx, window->lry);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Map the edges of the window to the pixel edges around them */
+    ref->samp0 = (int) floor ((window->ulx - geoloc_def->ul_corner.x) /
+        pixel_x + SPATIAL_SUBSET_EPSILON);
+    samp1 = (int) ceil ((window->lrx - geoloc_def->ul_corner.x) / pixel_x -
+        SPATIAL_SUBSET_EPSILON);
+    ref->line0 = (int) floor ((geoloc_def->ul_corner.y - window->uly) /
+        pixel_y + SPATIAL_SUBSET_EPSILON);
+    line1 = (int) ceil ((geoloc_def->ul_corner.y - window->lry) / pixel_y -
+        SPATIAL_SUBSET_EPSILON);
+
+    /* Clip the window to the band */
+    ref->samp0 = max (ref->samp0, 0);
+    ref->line0 = max (ref->line0, 0);
+    samp1 = min (samp1, ref_nsamps);
+    line1 = min (line1, ref_nlines);
+    if (samp1 <= ref->samp0 || line1 <= ref->line0)
+    {
+        sprintf (errmsg, "The window (%f, %f) to (%f, %f) doesn't overlap "
+            "the image", window->ulx, window->uly, window->lrx, window->lry);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    ref->nsamps = samp1 - ref->samp0;
+    ref->nlines = line1 - ref->line0;
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  get_band_windows
+
+PURPOSE: Gets the window of each band covering the window of the reference
+band, widening the reference window to whole pixels of the coarser bands.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           The pixel sizes of a band and the reference band aren't
+                whole multiples of each other
+SUCCESS         Successfully got the windows
+
+NOTES:
+  1. The bands are expected to share the UL corner of the reference band, as
+     the bands of the Level-1 products do.
+  2. A window reaching the last line or sample of the reference band reaches
+     the last line or sample of every band, even if the coarser bands don't
+     divide the reference band evenly.
+******************************************************************************/
+static int get_band_windows
+(
+    Espa_internal_meta_t *xml_metadata, /* I: metadata of the product */
+    Space_def_t *geoloc_def,        /* I: grid of the reference band */
+    Espa_pixel_window_t *ref,       /* I/O: window in the reference band;
+                                          widened as needed */
+    Espa_pixel_window_t *band_window  /* O: window of each band */
+)
+{
+    char FUNC_NAME[] = "get_band_windows";   /* function name */
+    char errmsg[STR_SIZE];  /* error message */
+    int i;                  /* looping variable for the bands */
+    int mult_x, div_x;      /* sample ratio of a band (see pixel_ratio) */
+    int mult_y, div_y;      /* line ratio of a band (see pixel_ratio) */
+    int step_x = 1;         /* least common multiple of the sample divs */
+    int step_y = 1;         /* least common multiple of the line divs */
+    int line1;              /* line after the last line of the window */
+    int samp1;              /* sample after the last sample of the window */
+    int band_line1;         /* band line after the window */
+    int band_samp1;         /* band sample after the window */
+    Espa_band_meta_t *bmeta = NULL;  /* metadata of the current band */
+
+    /* Find the coarsest grid which all the bands align to */
+    for (i = 0; i < xml_metadata->nbands; i++)
+    {
+        bmeta = &xml_metadata->band[i];
+        if (pixel_ratio (geoloc_def->pixel_size[0], bmeta->pixel_size[0],
+            &mult_x, &div_x) != SUCCESS ||
+            pixel_ratio (geoloc_def->pixel_size[1], bmeta->pixel_size[1],
+            &mult_y, &div_y) != SUCCESS)
+        {
+            sprintf (errmsg, "The pixel size %f x %f of band %s isn't a "
+                "multiple or a fraction of the pixel size %f x %f of the "
+                "reference band", bmeta->pixel_size[0], bmeta->pixel_size[1],
+                bmeta->name, geoloc_def->pixel_size[0],
+                geoloc_def->pixel_size[1]);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+        step_x = step_x / greatest_common_divisor (step_x, div_x) * div_x;
+        step_y = step_y / greatest_common_divisor (step_y, div_y) * div_y;
+    }
+
+    /* Widen the reference window to that grid */
+    line1 = ref->line0 + ref->nlines;
+    samp1 = ref->samp0 + ref->nsamps;
+    ref->line0 -= ref->line0 % step_y;
+    ref->samp0 -= ref->samp0 % step_x;
+    line1 = min ((line1 + step_y - 1) / step_y * step_y,
+        geoloc_def->img_size.l);
+    samp1 = min ((samp1 + step_x - 1) / step_x * step_x,
+        geoloc_def->img_size.s);
+    ref->nlines = line1 - ref->line0;
+    ref->nsamps = samp1 - ref->samp0;
+
+    /* Scale the window to each band */
+    for (i = 0; i < xml_metadata->nbands; i++)
+    {
+        bmeta = &xml_metadata->band[i];
+        pixel_ratio (geoloc_def->pixel_size[0], bmeta->pixel_size[0],
+            &mult_x, &div_x);
+        pixel_ratio (geoloc_def->pixel_size[1], bmeta->pixel_size[1],
+            &mult_y, &div_y);
+
+        band_window[i].line0 = ref->line0 * mult_y / div_y;
+        band_window[i].samp0 = ref->samp0 * mult_x / div_x;
+        band_line1 = min ((line1 * mult_y + div_y - 1) / div_y,
+            bmeta->nlines);
+        band_samp1 = min ((samp1 * mult_x + div_x - 1) / div_x,
+            bmeta->nsamps);
+        band_window[i].nlines = band_line1 - band_window[i].line0;
+        band_window[i].nsamps = band_samp1 - band_window[i].samp0;
+        if (band_window[i].nlines <= 0 || band_window[i].nsamps <= 0)
+        {
+            sprintf (errmsg, "The window is outside of the %d lines and %d "
+                "samples of band %s", bmeta->nlines, bmeta->nsamps,
+                bmeta->name);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  subset_footprint
+
+PURPOSE: Writes the part of the footprint index of a band within its window,
+and references it from the band metadata.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the footprint index
+SUCCESS         Successfully subset the footprint index, or the band has no
+                (usable) footprint index and footprint_file is cleared
+
+NOTES:
+  1. The bands sharing an input index and a window share the output index,
+     named after the first of them (see footprint_file).
+******************************************************************************/
+static int subset_footprint
+(
+    Espa_internal_meta_t *xml_metadata, /* I/O: metadata of the product;
+                                              footprint_file of the band is
+                                              updated */
+    char in_footprint[][STR_SIZE],  /* I: input footprint index of each
+                                          band */
+    Espa_pixel_window_t *band_window, /* I: window of each band */
+    int band,                       /* I: index of the band */
+    char *out_base                  /* I: base name of the output files */
+)
+{
+    char FUNC_NAME[] = "subset_footprint";   /* function name */
+    char errmsg[STR_SIZE];  /* error message */
+    char footprint_file[STR_SIZE];  /* name of the output index */
+    int i;                  /* looping variable for the bands */
+    int line;               /* looping variable for the lines */
+    int first, last;        /* first and last valid sample of a line */
+    int count;              /* number of chars copied in snprintf */
+    int status;             /* return status */
+    int32_t *extent = NULL; /* first and last valid sample of each line */
+    Espa_band_meta_t *bmeta = &xml_metadata->band[band];
+    Espa_pixel_window_t *win = &band_window[band];  /* window of the band */
+    Espa_footprint_t *footprint = NULL;  /* input index */
+
+    if (!strcmp (in_footprint[band], ESPA_STRING_META_FILL))
+        return (SUCCESS);
+
+    /* Reuse the index of an earlier band with the same window */
+    for (i = 0; i < band; i++)
+    {
+        if (!strcmp (in_footprint[i], in_footprint[band]) &&
+            !memcmp (&band_window[i], win, sizeof (*win)))
+        {
+            strcpy (bmeta->footprint_file,
+                xml_metadata->band[i].footprint_file);
+            return (SUCCESS);
+        }
+    }
+
+    /* The input index is read with the original size of the band */
+    footprint = read_footprint (bmeta);
+    strcpy (bmeta->footprint_file, ESPA_STRING_META_FILL);
+    if (footprint == NULL)
+        return (SUCCESS);
+
+    extent = malloc (2 * (size_t) win->nlines * sizeof (int32_t));
+    if (extent == NULL)
+    {
+        sprintf (errmsg, "Allocating the footprint index of band %s",
+            bmeta->name);
+        error_handler (true, FUNC_NAME, errmsg);
+        free_footprint (footprint);
+        return (ERROR);
+    }
+
+    /* Shift the valid samples of each line to the window and clip them */
+    for (line = 0; line < win->nlines; line++)
+    {
+        footprint_line_extent (footprint, win->line0 + line, &first, &last);
+        first = max (first - win->samp0, 0);
+        last = min (last - win->samp0, win->nsamps - 1);
+        if (first > last)
+        {
+            first = ESPA_FOOTPRINT_EMPTY_FIRST;
+            last = ESPA_FOOTPRINT_EMPTY_LAST;
+        }
+        extent[2 * line] = first;
+        extent[2 * line + 1] = last;
+    }
+    free_footprint (footprint);
+
+    count = snprintf (footprint_file, sizeof (footprint_file), "%s_%s%s",
+        out_base, bmeta->name, ESPA_FOOTPRINT_SUFFIX);
+    if (count < 0 || count >= sizeof (footprint_file))
+    {
+        sprintf (errmsg, "Overflow of footprint_file string");
+        error_handler (true, FUNC_NAME, errmsg);
+        free (extent);
+        return (ERROR);
+    }
+
+    status = write_footprint (footprint_file, win->nlines, extent);
+    free (extent);
+    if (status != SUCCESS)
+    {
+        sprintf (errmsg, "Writing the footprint index %s", footprint_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    strcpy (bmeta->footprint_file, footprint_file);
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  subset_band
+
+PURPOSE: Copies the window of an input raw binary band to the output raw
+binary band and writes its ENVI header.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error subsetting the band
+SUCCESS         Successfully subset the band
+
+NOTES:
+  1. The window is read SPATIAL_SUBSET_STRIPE_LINES at a time with positional
+     reads of just the window samples, so only the window is read from the
+     input band.  With a memory budget, the stripes shrink to fit in it (see
+     espa_mem_fit_count).
+******************************************************************************/
+static int subset_band
+(
+    char *in_file,              /* I: input raw binary band */
+    off_t in_offset,            /* I: byte offset of the band in in_file */
+    int in_nsamps,              /* I: number of samples in the input band */
+    Espa_pixel_window_t *win,   /* I: window of the band */
+    Espa_band_meta_t *bmeta,    /* I: metadata of the output band */
+    Espa_global_meta_t *gmeta   /* I: global metadata of the output */
+)
+{
+    char FUNC_NAME[] = "subset_band";   /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    char envi_file[STR_SIZE];   /* name of the output ENVI header file */
+    char *cptr = NULL;          /* pointer to the file extension */
+    int fd;                     /* input band */
+    int size;                   /* number of bytes per pixel */
+    int line;                   /* first line of the current stripe */
+    int nlines;                 /* number of lines in the current stripe */
+    int stripe_lines;           /* number of lines in a stripe */
+    int status = SUCCESS;       /* return status */
+    void *buf = NULL;           /* stripe of the window */
+    Raw_binary_writer_t *writer = NULL;  /* writer of the output band */
+    Envi_header_t envi_hdr;     /* output ENVI header information */
+
+    size = espa_data_type_size (bmeta->data_type);
+    if (size <= 0)
+    {
+        sprintf (errmsg, "Unsupported data type of band %s", bmeta->name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    fd = open_raw_binary_band_fd (in_file, in_offset, false);
+    if (fd < 0)
+    {
+        sprintf (errmsg, "Opening the input band %s", in_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    stripe_lines = espa_mem_fit_count ((size_t) win->nsamps * size,
+        SPATIAL_SUBSET_STRIPE_LINES, 1);
+    buf = espa_trace_malloc ((size_t) stripe_lines * win->nsamps * size);
+    writer = open_raw_binary_writer (bmeta->file_name,
+        (size_t) win->nlines * win->nsamps * size, 0);
+    if (buf == NULL || writer == NULL ||
+        start_raw_binary_writer_stats (writer, bmeta) != SUCCESS ||
+        start_raw_binary_writer_sparse (writer, bmeta, RB_SPARSE_FROM_ENV)
+        != SUCCESS)
+    {
+        sprintf (errmsg, "Opening the output band %s", bmeta->file_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        espa_trace_free (buf);
+        if (writer != NULL)
+            close_raw_binary_writer (writer);
+        close_raw_binary_fd (fd);
+        return (ERROR);
+    }
+
+    for (line = 0; line < win->nlines && status == SUCCESS;
+        line += stripe_lines)
+    {
+        nlines = min (stripe_lines, win->nlines - line);
+        if (read_raw_binary_window (fd, in_nsamps, win->line0 + line, nlines,
+            win->samp0, win->nsamps, size, buf) != SUCCESS)
+        {
+            sprintf (errmsg, "Reading lines %d-%d of %s", win->line0 + line,
+                win->line0 + line + nlines - 1, in_file);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+        }
+        else if (append_raw_binary_writer (writer, nlines, win->nsamps, size,
+            buf) != SUCCESS)
+        {
+            sprintf (errmsg, "Writing lines %d-%d of %s", line,
+                line + nlines - 1, bmeta->file_name);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+        }
+    }
+
+    espa_trace_free (buf);
+    close_raw_binary_fd (fd);
+    if (status == SUCCESS)
+    {
+        get_raw_binary_writer_checksum (writer, bmeta->checksum);
+        get_raw_binary_writer_stats (writer, &bmeta->stats);
+    }
+    if (close_raw_binary_writer (writer) != SUCCESS)
+    {
+        sprintf (errmsg, "Closing the output band %s", bmeta->file_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        status = ERROR;
+    }
+    if (status != SUCCESS)
+        return (ERROR);
+
+    /* Create the ENVI header file for this band */
+    if (create_envi_struct (bmeta, gmeta, &envi_hdr) != SUCCESS)
+    {
+        sprintf (errmsg, "Creating the ENVI header structure for this "
+            "file: %s", bmeta->file_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    strcpy (envi_file, bmeta->file_name);
+    cptr = strrchr (envi_file, '.');
+    strcpy (cptr, ".hdr");
+    if (write_envi_hdr (envi_file, &envi_hdr) != SUCCESS)
+    {
+        sprintf (errmsg, "Writing the ENVI header file: %s.", envi_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  update_subset_geolocation
+
+PURPOSE: Moves the projection corners of the product to the window and
+recomputes the geographic corners and the bounding coordinates.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error computing the corners or the bounds
+SUCCESS         Successfully updated the geolocation
+
+NOTES:
+  1. The corners are moved by whole reference pixels, so they keep the grid
+     origin (CENTER or UL) of the input.
+  2. The band sizes need to be updated to the window first.
+  3. The footprint polygon of the input no longer outlines the window, so it
+     is cleared; clip_band_misalignment records a new one.
+******************************************************************************/
+static int update_subset_geolocation
+(
+    Espa_internal_meta_t *xml_metadata, /* I/O: metadata of the product */
+    Space_def_t *geoloc_def,        /* I: grid of the input reference band */
+    Espa_pixel_window_t *ref        /* I: window in the reference band */
+)
+{
+    char FUNC_NAME[] = "update_subset_geolocation";  /* function name */
+    char errmsg[STR_SIZE];  /* error message */
+    Espa_global_meta_t *gmeta = &xml_metadata->global;  /* global metadata */
+    Espa_proj_meta_t *proj_info = &gmeta->proj_info;  /* projection info */
+    Space_def_t subset_def; /* grid of the output reference band */
+    Geoloc_t *geoloc_map = NULL;  /* geolocation mapping information */
+    Geo_bounds_t bounds;    /* geographic bounds of the output */
+
+    proj_info->ul_corner[0] += ref->samp0 * geoloc_def->pixel_size[0];
+    proj_info->ul_corner[1] -= ref->line0 * geoloc_def->pixel_size[1];
+    proj_info->lr_corner[0] -= (geoloc_def->img_size.s - ref->samp0 -
+        ref->nsamps) * geoloc_def->pixel_size[0];
+    proj_info->lr_corner[1] += (geoloc_def->img_size.l - ref->line0 -
+        ref->nlines) * geoloc_def->pixel_size[1];
+
+    if (!get_corner_coords (xml_metadata, gmeta->ul_corner, gmeta->lr_corner))
+    {
+        sprintf (errmsg, "Computing the geographic corners of the subset");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    if (!get_geoloc_info (xml_metadata, &subset_def))
+    {
+        sprintf (errmsg, "Copying the geolocation information from the XML "
+            "metadata structure.");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    geoloc_map = setup_mapping (&subset_def);
+    if (geoloc_map == NULL)
+    {
+        sprintf (errmsg, "Setting up the geolocation mapping structure.");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    if (!compute_bounds (geoloc_map, subset_def.img_size.l,
+        subset_def.img_size.s, &bounds))
+    {
+        sprintf (errmsg, "Computing the bounding coordinates of the subset");
+        error_handler (true, FUNC_NAME, errmsg);
+        free (geoloc_map);
+        return (ERROR);
+    }
+    gmeta->bounding_coords[ESPA_WEST] = bounds.min_lon;
+    gmeta->bounding_coords[ESPA_EAST] = bounds.max_lon;
+    gmeta->bounding_coords[ESPA_NORTH] = bounds.max_lat;
+    gmeta->bounding_coords[ESPA_SOUTH] = bounds.min_lat;
+    strcpy (gmeta->footprint, ESPA_STRING_META_FILL);
+
+    free (geoloc_map);
+    return (SUCCESS);
+}
+
+
+/* Bands subset in parallel */
+typedef struct
+{
+    Espa_internal_meta_t *xml_metadata; /* metadata of the output bands */
+    char (*in_file)[STR_SIZE];  /* input raw binary file of each band */
+    off_t *in_offset;       /* byte offset of each band in its input file */
+    int *in_nsamps;         /* number of samples in each input band */
+    Espa_pixel_window_t *band_window;  /* window of each band */
+} Subset_bands_t;
+
+
+/******************************************************************************
+MODULE:  subset_band_task
+
+PURPOSE: Subsets one band, as an iteration of the parallel loop over the
+bands.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error subsetting the band
+SUCCESS         Successfully subset the band, or the band is constant
+
+NOTES:
+******************************************************************************/
+static int subset_band_task
+(
+    void *arg,              /* I/O: bands being subset */
+    int i,                  /* I: index of the band */
+    int worker              /* I: worker subsetting the band (unused) */
+)
+{
+    Subset_bands_t *bands = arg;  /* bands being subset */
+
+    if (is_constant_band (&bands->xml_metadata->band[i]))
+        return (SUCCESS);
+
+    return (subset_band (bands->in_file[i], bands->in_offset[i],
+        bands->in_nsamps[i], &bands->band_window[i],
+        &bands->xml_metadata->band[i], &bands->xml_metadata->global));
+}
+
+
+/******************************************************************************
+MODULE:  report_subset_band
+
+PURPOSE: Reports a subset band, in band order.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           The band failed
+SUCCESS         Successfully reported the band
+
+NOTES:
+******************************************************************************/
+static int report_subset_band
+(
+    void *arg,              /* I/O: bands being subset */
+    int i,                  /* I: index of the band */
+    int band_status         /* I: status of subsetting the band */
+)
+{
+    char FUNC_NAME[] = "subset_espa_spatial";   /* function name */
+    char errmsg[STR_SIZE];  /* error message */
+    Subset_bands_t *bands = arg;  /* bands being subset */
+
+    printf ("  Band %d: %s to %s\n", i, bands->in_file[i],
+        bands->xml_metadata->band[i].file_name);
+    if (band_status != SUCCESS)
+    {
+        sprintf (errmsg, "Subsetting band %d: %s", i, bands->in_file[i]);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  subset_espa_spatial
+
+PURPOSE: Cuts a spatial window out of an ESPA product, writing the pixels of
+the window of each band to a new raw binary file and the updated metadata to
+a new XML file.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error subsetting the product
+SUCCESS         Successfully subset the product
+
+NOTES:
+  1. The output bands are named <base>_<band name>.img, where <base> is the
+     output XML filename without its extension.
+  2. The projection corners, the band sizes, the geographic corners, and the
+     bounding coordinates are updated to the window.  The footprint indexes
+     are subset along with the bands.
+  3. Constant bands have no raw binary file, so only their size changes.
+  4. Rotated grids (orientation angle other than 0) aren't supported.
+******************************************************************************/
+int subset_espa_spatial
+(
+    char *xml_infile,       /* I: input XML metadata filename */
+    char *xml_outfile,      /* I: output XML metadata filename; also the base
+                                  name of the output band files */
+    Espa_spatial_window_t *window  /* I: window to be cut out */
+)
+{
+    char FUNC_NAME[] = "subset_espa_spatial";   /* function name */
+    char errmsg[STR_SIZE];  /* error message */
+    char out_base[STR_SIZE];   /* base name of the output files */
+    char *cptr = NULL;      /* pointer to the file extension */
+    char (*in_file)[STR_SIZE] = NULL;  /* input raw binary file of each
+                                          band */
+    char (*in_footprint)[STR_SIZE] = NULL;  /* input footprint index of each
+                                               band */
+    off_t *in_offset = NULL;   /* byte offset of each band in its input
+                                  file */
+    int *in_nsamps = NULL;  /* number of samples in each input band */
+    int i;                  /* looping variable for the bands */
+    int nbands;             /* number of bands in the product */
+    int count;              /* number of chars copied in snprintf */
+    int nthreads;           /* number of bands subset at the same time */
+    int status = SUCCESS;   /* status of all the bands */
+    Subset_bands_t bands;   /* bands being subset */
+    Espa_internal_meta_t xml_metadata;  /* metadata of the product */
+    Espa_band_meta_t *bmeta = NULL;     /* metadata of the current band */
+    Space_def_t geoloc_def; /* grid of the reference band */
+    Espa_pixel_window_t ref;  /* window in the reference band */
+    Espa_pixel_window_t *band_window = NULL;  /* window of each band */
+
+    /* Determine the base name of the output files */
+    count = snprintf (out_base, sizeof (out_base), "%s", xml_outfile);
+    if (count < 0 || count >= sizeof (out_base))
+    {
+        sprintf (errmsg, "Overflow of out_base string");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    cptr = strrchr (out_base, '.');
+    if (cptr != NULL && strchr (cptr, '/') == NULL)
+        *cptr = '\0';
+
+    if (!strcmp (xml_infile, xml_outfile))
+    {
+        sprintf (errmsg, "The output XML file needs to differ from the input "
+            "XML file %s", xml_infile);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Validate and parse the input metadata */
+    init_metadata_struct (&xml_metadata);
+    if (validate_and_parse_metadata (xml_infile, &xml_metadata) != SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+    nbands = xml_metadata.nbands;
+
+    if (fabs (xml_metadata.global.orientation_angle) > ESPA_EPSILON)
+    {
+        sprintf (errmsg, "Subsetting rotated grids (orientation angle %f) "
+            "isn't supported", xml_metadata.global.orientation_angle);
+        error_handler (true, FUNC_NAME, errmsg);
+        free_metadata (&xml_metadata);
+        return (ERROR);
+    }
+
+    /* Get the grid of the reference band and the windows of the bands */
+    if (!get_geoloc_info (&xml_metadata, &geoloc_def))
+    {
+        sprintf (errmsg, "Copying the geolocation information from the XML "
+            "metadata structure.");
+        error_handler (true, FUNC_NAME, errmsg);
+        free_metadata (&xml_metadata);
+        return (ERROR);
+    }
+
+    band_window = calloc (nbands + 1, sizeof (Espa_pixel_window_t));
+    in_file = calloc (nbands + 1, sizeof (*in_file));
+    in_footprint = calloc (nbands + 1, sizeof (*in_footprint));
+    in_offset = calloc (nbands + 1, sizeof (off_t));
+    in_nsamps = calloc (nbands + 1, sizeof (int));
+    if (band_window == NULL || in_file == NULL || in_footprint == NULL ||
+        in_offset == NULL || in_nsamps == NULL)
+    {
+        sprintf (errmsg, "Allocating the band windows");
+        error_handler (true, FUNC_NAME, errmsg);
+        status = ERROR;
+        goto done;
+    }
+
+    if (get_reference_window (window, &geoloc_def, &ref) != SUCCESS ||
+        get_band_windows (&xml_metadata, &geoloc_def, &ref, band_window)
+        != SUCCESS)
+    {  /* Error messages already written */
+        status = ERROR;
+        goto done;
+    }
+    printf ("  Subsetting lines %d-%d and samples %d-%d of the reference "
+        "band\n", ref.line0, ref.line0 + ref.nlines - 1, ref.samp0,
+        ref.samp0 + ref.nsamps - 1);
+
+    /* Subset the footprint indexes and point the bands to the output files;
+       the input files are kept for the reads */
+    for (i = 0; i < nbands; i++)
+    {
+        bmeta = &xml_metadata.band[i];
+        strcpy (in_file[i], bmeta->file_name);
+        strcpy (in_footprint[i], bmeta->footprint_file);
+        in_offset[i] = bmeta->file_offset;
+        in_nsamps[i] = bmeta->nsamps;
+
+        if (subset_footprint (&xml_metadata, in_footprint, band_window, i,
+            out_base) != SUCCESS)
+        {  /* Error messages already written */
+            status = ERROR;
+            goto done;
+        }
+
+        bmeta->nlines = band_window[i].nlines;
+        bmeta->nsamps = band_window[i].nsamps;
+        strcpy (bmeta->overview_file, ESPA_STRING_META_FILL);
+        bmeta->overview_levels = 0;
+        if (is_constant_band (bmeta))
+            continue;
+
+        count = snprintf (bmeta->file_name, sizeof (bmeta->file_name),
+            "%s_%s.img", out_base, bmeta->name);
+        if (count < 0 || count >= sizeof (bmeta->file_name))
+        {
+            sprintf (errmsg, "Overflow of file_name string");
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+            goto done;
+        }
+        if (!strcmp (bmeta->file_name, in_file[i]))
+        {
+            sprintf (errmsg, "The output band %s would overwrite the input "
+                "band", bmeta->file_name);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+            goto done;
+        }
+        strcpy (bmeta->encoding, ESPA_STRING_META_FILL);
+        bmeta->tile_size = 0;
+        bmeta->file_offset = 0;
+    }
+
+    /* The headers of the bands are written with the new corners */
+    if (update_subset_geolocation (&xml_metadata, &geoloc_def, &ref)
+        != SUCCESS)
+    {  /* Error messages already written */
+        status = ERROR;
+        goto done;
+    }
+
+    /* Subset the bands */
+    nthreads = spatial_subset_threads (nbands);
+    if (nthreads > 1)
+        printf ("  Subsetting %d bands at a time\n", nthreads);
+
+    bands.xml_metadata = &xml_metadata;
+    bands.in_file = in_file;
+    bands.in_offset = in_offset;
+    bands.in_nsamps = in_nsamps;
+    bands.band_window = band_window;
+    status = espa_parallel_for_ordered (nbands, nthreads, subset_band_task,
+        report_subset_band, &bands);
+    if (status != SUCCESS)
+        goto done;
+
+    /* Write and validate the output metadata */
+    if (write_metadata (&xml_metadata, xml_outfile) != SUCCESS ||
+        validate_xml_file (xml_outfile) != SUCCESS)
+    {  /* Error messages already written */
+        status = ERROR;
+        goto done;
+    }
+
+done:
+    free (band_window);
+    free (in_file);
+    free (in_footprint);
+    free (in_offset);
+    free (in_nsamps);
+    free_metadata (&xml_metadata);
+    return (status);
+}
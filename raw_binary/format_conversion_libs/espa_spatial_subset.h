@@ -0,0 +1,74 @@
+/*****************************************************************************
+FILE: espa_spatial_subset.h
+
+PURPOSE: Contains defines and prototypes for cutting a spatial window out of
+an ESPA product, writing the pixels of the window for each band along with
+the updated XML metadata.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The window is given in the lines and samples of the reference band (the
+     band whose grid the projection corners describe; see get_geoloc_info)
+     or in projection coordinates.  The bands of other resolutions are cut at
+     the same area on their own grids, so the window is widened to whole
+     pixels of the coarsest band.
+*****************************************************************************/
+
+#ifndef ESPA_SPATIAL_SUBSET_H
+#define ESPA_SPATIAL_SUBSET_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include "espa_metadata.h"
+#include "parse_metadata.h"
+#include "write_metadata.h"
+#include "envi_header.h"
+#include "error_handler.h"
+#include "espa_geoloc.h"
+
+/* Number of bands subset at the same time; the environment variable
+   overrides the default */
+#define SPATIAL_SUBSET_THREADS_ENV "ESPA_SUBSET_THREADS"
+#define SPATIAL_SUBSET_DEFAULT_THREADS 4
+
+/* Number of lines of a band read and written at a time */
+#define SPATIAL_SUBSET_STRIPE_LINES 256
+
+/* Window of lines and samples of a band */
+typedef struct
+{
+    int line0;          /* 0-based first line of the window */
+    int samp0;          /* 0-based first sample of the window */
+    int nlines;         /* number of lines in the window */
+    int nsamps;         /* number of samples in the window */
+} Espa_pixel_window_t;
+
+/* Spatial window to be cut out of a product */
+typedef struct
+{
+    bool proj_window;   /* is the window given by the projection coordinates
+                           (ulx, uly, lrx, lry) rather than by the lines and
+                           samples of the reference band (pixels)? */
+    Espa_pixel_window_t pixels;  /* window in the reference band */
+    double ulx;         /* projection x of the left edge of the window */
+    double uly;         /* projection y of the top edge of the window */
+    double lrx;         /* projection x of the right edge of the window */
+    double lry;         /* projection y of the bottom edge of the window */
+} Espa_spatial_window_t;
+
+/* Prototypes */
+int subset_espa_spatial
+(
+    char *xml_infile,       /* I: input XML metadata filename */
+    char *xml_outfile,      /* I: output XML metadata filename; also the base
+                                  name of the output band files */
+    Espa_spatial_window_t *window  /* I: window to be cut out */
+);
+
+#endif
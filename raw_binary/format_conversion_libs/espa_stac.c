@@ -0,0 +1,673 @@
+/*****************************************************************************
+FILE: espa_stac.c
+
+PURPOSE: Contains functions for writing a STAC item describing an ESPA
+product (see espa_stac.h).
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The geometry of the item is the footprint of the valid pixels when the
+     product has one (see generate_footprint_polygon.h), otherwise the
+     bounding coordinates.
+  2. Each band with a file is an asset, with its fill value, scale factor,
+     add offset, and data units in raster:bands, and its grid in
+     proj:shape and proj:transform.  The constant bands have no file, so
+     they have no asset.
+*****************************************************************************/
+
+#include <limits.h>
+#include <ctype.h>
+#include <math.h>
+#include <libgen.h>
+#include "espa_stac.h"
+#include "espa_band_grids.h"
+#include "espa_remote.h"
+#include "espa_shm.h"
+
+
+/******************************************************************************
+MODULE:  stac_string
+
+PURPOSE: Writes a quoted JSON string, escaping the quotes, backslashes, and
+control characters.
+
+RETURN VALUE: None
+******************************************************************************/
+static void stac_string
+(
+    FILE *fp,              /* I: STAC item file */
+    const char *str        /* I: string to be written */
+)
+{
+    const unsigned char *c;   /* current character of the string */
+
+    fputc ('"', fp);
+    for (c = (const unsigned char *) str; *c != '\0'; c++)
+    {
+        if (*c == '"' || *c == '\\')
+            fprintf (fp, "\\%c", *c);
+        else if (*c < 0x20)
+            fprintf (fp, "\\u%04x", *c);
+        else
+            fputc (*c, fp);
+    }
+    fputc ('"', fp);
+}
+
+
+/******************************************************************************
+MODULE:  stac_defined
+
+PURPOSE: Determines if a string of the metadata is defined.
+
+RETURN VALUE:
+Type = bool
+Value           Description
+-----           -----------
+true            The string holds a value
+false           The string is empty or the fill of the metadata
+******************************************************************************/
+static bool stac_defined
+(
+    const char *value      /* I: string of the metadata */
+)
+{
+    return (value[0] != '\0' && strcmp (value, ESPA_STRING_META_FILL));
+}
+
+
+/******************************************************************************
+MODULE:  stac_data_type
+
+PURPOSE: Returns the STAC raster data type of an ESPA data type.
+
+RETURN VALUE:
+Type = const char *
+Value           Description
+-----           -----------
+NULL            Unsupported data type
+non-NULL        Raster data type
+******************************************************************************/
+static const char *stac_data_type
+(
+    enum Espa_data_type data_type  /* I: ESPA data type */
+)
+{
+    switch (data_type)
+    {
+        case ESPA_INT8: return ("int8");
+        case ESPA_UINT8: return ("uint8");
+        case ESPA_INT16: return ("int16");
+        case ESPA_UINT16: return ("uint16");
+        case ESPA_INT32: return ("int32");
+        case ESPA_UINT32: return ("uint32");
+        case ESPA_FLOAT32: return ("float32");
+        case ESPA_FLOAT64: return ("float64");
+        default: return (NULL);
+    }
+}
+
+
+/******************************************************************************
+MODULE:  stac_epsg
+
+PURPOSE: Returns the EPSG code of the projection of the product.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+0               The projection has no EPSG code (ex. Albers, polar
+                stereographic, and sinusoidal, which ESPA defines by their
+                parameters)
+n               EPSG code of the geographic or UTM projection
+
+NOTES:
+  1. The UTM codes are those of set_geotiff_tags: WGS84 in both
+     hemispheres, NAD27 zones 3N through 22N, and NAD83 zones 3N through
+     23N.
+******************************************************************************/
+static int stac_epsg
+(
+    const Espa_proj_meta_t *proj_info  /* I: projection of the product */
+)
+{
+    int zone = proj_info->utm_zone;    /* UTM zone; negative for south */
+
+    if (proj_info->proj_type == GCTP_GEO_PROJ)
+    {
+        switch (proj_info->datum_type)
+        {
+            case ESPA_WGS84: return (4326);
+            case ESPA_NAD83: return (4269);
+            case ESPA_NAD27: return (4267);
+            default: return (0);
+        }
+    }
+
+    if (proj_info->proj_type != GCTP_UTM_PROJ || zone == 0 ||
+        abs (zone) > 60)
+        return (0);
+
+    if (proj_info->datum_type == ESPA_WGS84)
+        return (zone > 0 ? 32600 + zone : 32700 - zone);
+    if (proj_info->datum_type == ESPA_NAD27 && zone >= 3 && zone <= 22)
+        return (26700 + zone);
+    if (proj_info->datum_type == ESPA_NAD83 && zone >= 3 && zone <= 23)
+        return (26900 + zone);
+    return (0);
+}
+
+
+/******************************************************************************
+MODULE:  stac_geometry
+
+PURPOSE: Writes the GeoJSON geometry of the item, from the footprint of the
+product when it has one, otherwise from its bounding coordinates.
+
+RETURN VALUE: None
+
+NOTES:
+  1. The footprint is a WKT POLYGON of longitude, latitude, whose outer ring
+     is used.  A footprint which can't be parsed falls back to the bounding
+     coordinates.
+******************************************************************************/
+static void stac_geometry
+(
+    FILE *fp,                  /* I: STAC item file */
+    Espa_global_meta_t *gmeta  /* I: global metadata of the product */
+)
+{
+    const char *c = NULL;      /* current character of the footprint */
+    char *end = NULL;          /* end of the number parsed */
+    double lon, lat;           /* vertex of the footprint */
+    int nvertices = 0;         /* number of vertices of the footprint */
+    double *bounds = gmeta->bounding_coords;  /* west, east, north, south */
+
+    if (stac_defined (gmeta->footprint))
+        c = strstr (gmeta->footprint, "((");
+
+    /* Check the whole ring parses before any of it is written */
+    if (c != NULL)
+    {
+        c += 2;
+        while (1)
+        {
+            lon = strtod (c, &end);
+            if (end == c)
+                break;
+            c = end;
+            lat = strtod (c, &end);
+            if (end == c)
+                break;
+            nvertices++;
+            for (c = end; *c == ' '; c++)
+                ;
+            if (*c != ',')
+                break;
+            c++;
+        }
+        if (*c != ')' || nvertices < 4)
+            nvertices = 0;
+    }
+
+    fprintf (fp, "  \"geometry\": {\"type\": \"Polygon\", "
+        "\"coordinates\": [[");
+    if (nvertices > 0)
+    {
+        c = strstr (gmeta->footprint, "((") + 2;
+        while (nvertices-- > 0)
+        {
+            lon = strtod (c, &end);
+            lat = strtod (end, &end);
+            fprintf (fp, "[%.10g, %.10g]%s", lon, lat,
+                nvertices > 0 ? ", " : "");
+            for (c = end; *c == ' '; c++)
+                ;
+            c++;
+        }
+    }
+    else
+    {
+        /* Counterclockwise from the southwest corner */
+        fprintf (fp, "[%.10g, %.10g], [%.10g, %.10g], [%.10g, %.10g], "
+            "[%.10g, %.10g], [%.10g, %.10g]", bounds[ESPA_WEST],
+            bounds[ESPA_SOUTH], bounds[ESPA_EAST], bounds[ESPA_SOUTH],
+            bounds[ESPA_EAST], bounds[ESPA_NORTH], bounds[ESPA_WEST],
+            bounds[ESPA_NORTH], bounds[ESPA_WEST], bounds[ESPA_SOUTH]);
+    }
+    fprintf (fp, "]]},\n");
+
+    fprintf (fp, "  \"bbox\": [%.10g, %.10g, %.10g, %.10g],\n",
+        bounds[ESPA_WEST], bounds[ESPA_SOUTH], bounds[ESPA_EAST],
+        bounds[ESPA_NORTH]);
+}
+
+
+/******************************************************************************
+MODULE:  stac_lower_name
+
+PURPOSE: Writes a name of the metadata as a STAC name, in lower case with
+dashes (ex. LANDSAT_8 as landsat-8).
+
+RETURN VALUE: None
+******************************************************************************/
+static void stac_lower_name
+(
+    FILE *fp,              /* I: STAC item file */
+    const char *name       /* I: name of the metadata */
+)
+{
+    char lower[STR_SIZE];  /* name in lower case */
+    int i;                 /* looping variable for the characters */
+
+    for (i = 0; name[i] != '\0' && i < STR_SIZE - 1; i++)
+        lower[i] = name[i] == '_' ? '-' : tolower ((unsigned char) name[i]);
+    lower[i] = '\0';
+    stac_string (fp, lower);
+}
+
+
+/******************************************************************************
+MODULE:  stac_properties
+
+PURPOSE: Writes the properties of the item: the acquisition time, the
+satellite and instrument, and the projection of the product.
+
+RETURN VALUE: None
+
+NOTES:
+  1. The acquisition time is the date at the scene center time when the
+     product has one, otherwise the start of the date.
+******************************************************************************/
+static void stac_properties
+(
+    FILE *fp,                  /* I: STAC item file */
+    Espa_global_meta_t *gmeta  /* I: global metadata of the product */
+)
+{
+    const char *time = gmeta->scene_center_time;  /* scene center time */
+    int epsg = stac_epsg (&gmeta->proj_info);  /* EPSG code; 0 if none */
+
+    fprintf (fp, "  \"properties\": {\n");
+    if (stac_defined (time))
+        fprintf (fp, "    \"datetime\": \"%sT%s%s\",\n",
+            gmeta->acquisition_date, time,
+            time[strlen (time) - 1] == 'Z' ? "" : "Z");
+    else
+        fprintf (fp, "    \"datetime\": \"%sT00:00:00Z\",\n",
+            gmeta->acquisition_date);
+
+    if (stac_defined (gmeta->satellite))
+    {
+        fprintf (fp, "    \"platform\": ");
+        stac_lower_name (fp, gmeta->satellite);
+        fprintf (fp, ",\n");
+    }
+    if (stac_defined (gmeta->instrument))
+    {
+        fprintf (fp, "    \"instruments\": [");
+        stac_lower_name (fp, gmeta->instrument);
+        fprintf (fp, "],\n");
+    }
+    if (stac_defined (gmeta->data_provider))
+    {
+        fprintf (fp, "    \"providers\": [{\"name\": ");
+        stac_string (fp, gmeta->data_provider);
+        fprintf (fp, ", \"roles\": [\"producer\"]}],\n");
+    }
+    if (gmeta->wrs_path != ESPA_INT_META_FILL &&
+        gmeta->wrs_row != ESPA_INT_META_FILL)
+        fprintf (fp, "    \"landsat:wrs_path\": \"%03d\",\n"
+            "    \"landsat:wrs_row\": \"%03d\",\n", gmeta->wrs_path,
+            gmeta->wrs_row);
+
+    if (epsg > 0)
+        fprintf (fp, "    \"proj:epsg\": %d\n", epsg);
+    else
+        fprintf (fp, "    \"proj:epsg\": null\n");
+    fprintf (fp, "  },\n");
+}
+
+
+/******************************************************************************
+MODULE:  espa_product_href
+
+PURPOSE: Determines the name a file of the product is given in a file
+written for the product (ex. a STAC item or a set of references).
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error resolving the directories or overflow of href
+SUCCESS         Successfully determined the name of the file
+
+NOTES:
+  1. With a base URL the file is named by the URL, which the file is
+     expected to be served from.  Otherwise the file is named relative to
+     out_file when both are in the same directory, and by its absolute path
+     otherwise.
+******************************************************************************/
+int espa_product_href
+(
+    const char *dir_file,  /* I: file in the directory of the named file
+                                 (ex. the XML metadata file) */
+    const char *out_file,  /* I: file the name is written to, which the name
+                                 is relative to when it is in the same
+                                 directory; NULL for absolute names */
+    const char *href_base, /* I: base URL of the product files; NULL if the
+                                 files are local */
+    const char *file_name, /* I: name of the file, relative to the directory
+                                 of dir_file */
+    char *href,            /* O: name of the file for out_file */
+    size_t size            /* I: size of href */
+)
+{
+    char FUNC_NAME[] = "espa_product_href";  /* function name */
+    char errmsg[STR_SIZE];     /* error message */
+    char path[PATH_MAX];       /* copy of a filename for dirname */
+    char dir[PATH_MAX];        /* absolute directory of dir_file */
+    char out_dir[PATH_MAX];    /* absolute directory of out_file */
+    size_t len;                /* length of the base URL */
+    int count;                 /* number of chars copied in snprintf */
+
+    if (href_base != NULL)
+    {
+        len = strlen (href_base);
+        count = snprintf (href, size, "%s%s%s", href_base,
+            len > 0 && href_base[len-1] == '/' ? "" : "/", file_name);
+    }
+    else
+    {
+        snprintf (path, sizeof (path), "%s", dir_file);
+        if (realpath (dirname (path), dir) == NULL)
+        {
+            snprintf (errmsg, sizeof (errmsg), "Resolving the directory "
+                "of %s", dir_file);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+
+        out_dir[0] = '\0';
+        if (out_file != NULL)
+        {
+            snprintf (path, sizeof (path), "%s", out_file);
+            if (realpath (dirname (path), out_dir) == NULL)
+            {
+                snprintf (errmsg, sizeof (errmsg), "Resolving the "
+                    "directory of %s", out_file);
+                error_handler (true, FUNC_NAME, errmsg);
+                return (ERROR);
+            }
+        }
+
+        if (!strcmp (dir, out_dir))
+            count = snprintf (href, size, "%s", file_name);
+        else
+            count = snprintf (href, size, "%s%s%s", dir,
+                strcmp (dir, "/") ? "/" : "", file_name);
+    }
+
+    if (count < 0 || count >= size)
+    {
+        sprintf (errmsg, "Overflow of href string");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  stac_band_asset
+
+PURPOSE: Writes the asset of a band.
+
+RETURN VALUE: None
+******************************************************************************/
+static void stac_band_asset
+(
+    FILE *fp,              /* I: STAC item file */
+    Espa_internal_meta_t *xml_metadata, /* I: XML metadata structure */
+    int band,              /* I: band of the asset */
+    const char *href       /* I: name of the band file */
+)
+{
+    Espa_band_meta_t *bmeta = &xml_metadata->band[band];
+                           /* metadata of the band */
+    double ul_corner[2];   /* x, y of the UL edge of the band */
+    double lr_corner[2];   /* x, y of the LR edge of the band */
+
+    get_espa_grid_extent (xml_metadata, band, ul_corner, lr_corner);
+
+    fprintf (fp, "    ");
+    stac_string (fp, bmeta->name);
+    fprintf (fp, ": {\n      \"href\": ");
+    stac_string (fp, href);
+    fprintf (fp, ",\n      \"type\": \"application/octet-stream\",\n");
+    if (stac_defined (bmeta->long_name))
+    {
+        fprintf (fp, "      \"title\": ");
+        stac_string (fp, bmeta->long_name);
+        fprintf (fp, ",\n");
+    }
+    fprintf (fp, "      \"roles\": [\"data\"");
+    if (stac_defined (bmeta->category) && strcmp (bmeta->category, "image"))
+    {
+        fprintf (fp, ", ");
+        stac_string (fp, bmeta->category);
+    }
+    fprintf (fp, "],\n");
+
+    fprintf (fp, "      \"proj:shape\": [%d, %d],\n", bmeta->nlines,
+        bmeta->nsamps);
+    fprintf (fp, "      \"proj:transform\": [%.15g, 0, %.15g, 0, %.15g, "
+        "%.15g],\n", bmeta->pixel_size[0], ul_corner[0],
+        -bmeta->pixel_size[1], ul_corner[1]);
+
+    fprintf (fp, "      \"raster:bands\": [{\"data_type\": \"%s\", "
+        "\"spatial_resolution\": %.15g", stac_data_type (bmeta->data_type),
+        bmeta->pixel_size[0]);
+    if (bmeta->fill_value != ESPA_INT_META_FILL)
+        fprintf (fp, ", \"nodata\": %ld", bmeta->fill_value);
+    if (fabs (bmeta->scale_factor - ESPA_FLOAT_META_FILL) > ESPA_EPSILON)
+        fprintf (fp, ", \"scale\": %.9g", bmeta->scale_factor);
+    if (fabs (bmeta->add_offset - ESPA_FLOAT_META_FILL) > ESPA_EPSILON)
+        fprintf (fp, ", \"offset\": %.9g", bmeta->add_offset);
+    if (stac_defined (bmeta->data_units))
+    {
+        fprintf (fp, ", \"unit\": ");
+        stac_string (fp, bmeta->data_units);
+    }
+    fprintf (fp, "}]");
+
+    /* The band is found in a stacked or encoded file through its
+       references, but the layout is recorded for direct readers too */
+    if (bmeta->file_offset > 0)
+        fprintf (fp, ",\n      \"espa:file_offset\": %ld",
+            bmeta->file_offset);
+    if (stac_defined (bmeta->encoding))
+    {
+        fprintf (fp, ",\n      \"espa:encoding\": ");
+        stac_string (fp, bmeta->encoding);
+    }
+    fprintf (fp, "\n    }");
+}
+
+
+/******************************************************************************
+MODULE:  write_espa_stac_item
+
+PURPOSE: Writes a STAC item describing an ESPA product, with an asset per
+band file, the XML metadata, and optionally the references of the bands.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the STAC item
+SUCCESS         Successfully wrote the STAC item
+
+NOTES:
+  1. The id of the item is the product ID, or the name of the XML file
+     without its extension when the product has none.
+  2. The references are expected next to the item, or under the base URL
+     with the product files.
+  3. Bands in shared memory (see espa_shm.h) get no asset, with a warning,
+     since their shm: names aren't URLs and their segments are removed
+     once the bands are persisted.  Run espa_persist_bands first to
+     include them.
+******************************************************************************/
+int write_espa_stac_item
+(
+    char *espa_xml_file,   /* I: input ESPA XML metadata filename */
+    char *stac_file,       /* I: output STAC item (JSON) filename */
+    char *refs_file,       /* I: references to link as an asset (see
+                                 convert_espa_to_zarr_refs); NULL for none */
+    char *href_base        /* I: base URL the product files are served
+                                 from; NULL if they are local */
+)
+{
+    char FUNC_NAME[] = "write_espa_stac_item";  /* function name */
+    char errmsg[STR_SIZE];         /* error message */
+    char href[PATH_MAX];           /* name of a file of the item */
+    char path[PATH_MAX];           /* copy of a filename for basename */
+    char id[STR_SIZE];             /* id of the item */
+    char *ext = NULL;              /* extension of the XML filename */
+    int i;                         /* looping variable for each band */
+    int nassets = 0;               /* number of band assets written */
+    Espa_internal_meta_t xml_metadata;  /* XML metadata structure to be
+                                   populated by reading the input XML metadata
+                                   file */
+    FILE *fp = NULL;               /* STAC item file */
+    int status = ERROR;            /* return status */
+
+    if (is_remote_file (espa_xml_file))
+    {
+        snprintf (errmsg, sizeof (errmsg), "The XML file needs to be local "
+            "to write a STAC item: %s", espa_xml_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Initialize the metadata structure */
+    init_metadata_struct (&xml_metadata);
+
+    /* Validate the metadata file and parse it into our internal metadata
+       structure, reading the file only once; also allocates space as needed
+       for various pointers in the global and band metadata */
+    if (validate_and_parse_metadata (espa_xml_file, &xml_metadata) != SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+
+    for (i = 0; i < xml_metadata.nbands; i++)
+    {
+        if (stac_data_type (xml_metadata.band[i].data_type) == NULL)
+        {
+            sprintf (errmsg, "Unsupported data type for band: %s",
+                xml_metadata.band[i].name);
+            error_handler (true, FUNC_NAME, errmsg);
+            goto cleanup;
+        }
+    }
+
+    snprintf (path, sizeof (path), "%s", espa_xml_file);
+    if (stac_defined (xml_metadata.global.product_id))
+        snprintf (id, sizeof (id), "%s", xml_metadata.global.product_id);
+    else
+    {
+        snprintf (id, sizeof (id), "%s", basename (path));
+        ext = strrchr (id, '.');
+        if (ext != NULL && ext != id)
+            *ext = '\0';
+    }
+
+    fp = fopen (stac_file, "w");
+    if (fp == NULL)
+    {
+        snprintf (errmsg, sizeof (errmsg), "Opening the STAC item: %s",
+            stac_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        goto cleanup;
+    }
+
+    fprintf (fp, "{\n  \"type\": \"Feature\",\n  \"stac_version\": \"%s\",\n"
+        "  \"stac_extensions\": [\"%s\", \"%s\"],\n  \"id\": ",
+        ESPA_STAC_VERSION, ESPA_STAC_PROJ_EXT, ESPA_STAC_RASTER_EXT);
+    stac_string (fp, id);
+    fprintf (fp, ",\n");
+    stac_geometry (fp, &xml_metadata.global);
+    stac_properties (fp, &xml_metadata.global);
+    fprintf (fp, "  \"links\": [],\n  \"assets\": {\n");
+
+    /* Assets of the bands with files, then the metadata */
+    for (i = 0; i < xml_metadata.nbands; i++)
+    {
+        if (is_constant_band (&xml_metadata.band[i]))
+            continue;
+        if (is_espa_shm_name (xml_metadata.band[i].file_name))
+        {
+            snprintf (errmsg, sizeof (errmsg), "Band %s is in shared "
+                "memory, so it has no asset", xml_metadata.band[i].name);
+            error_handler (false, FUNC_NAME, errmsg);
+            continue;
+        }
+        if (espa_product_href (espa_xml_file, stac_file, href_base,
+            xml_metadata.band[i].file_name, href, sizeof (href)) != SUCCESS)
+            goto cleanup;
+        stac_band_asset (fp, &xml_metadata, i, href);
+        fprintf (fp, ",\n");
+        nassets++;
+    }
+
+    snprintf (path, sizeof (path), "%s", espa_xml_file);
+    if (espa_product_href (espa_xml_file, stac_file, href_base,
+        basename (path), href, sizeof (href)) != SUCCESS)
+        goto cleanup;
+    fprintf (fp, "    \"metadata\": {\"href\": ");
+    stac_string (fp, href);
+    fprintf (fp, ", \"type\": \"application/xml\", \"roles\": "
+        "[\"metadata\"]}");
+
+    if (refs_file != NULL)
+    {
+        snprintf (path, sizeof (path), "%s", refs_file);
+        if (espa_product_href (refs_file, stac_file, href_base,
+            basename (path), href, sizeof (href)) != SUCCESS)
+            goto cleanup;
+        fprintf (fp, ",\n    \"references\": {\"href\": ");
+        stac_string (fp, href);
+        fprintf (fp, ", \"type\": \"application/json\", \"title\": "
+            "\"Kerchunk references of the bands\", \"roles\": "
+            "[\"references\"]}");
+    }
+    fprintf (fp, "\n  }\n}\n");
+
+    if (ferror (fp))
+    {
+        snprintf (errmsg, sizeof (errmsg), "Writing the STAC item: %s",
+            stac_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        goto cleanup;
+    }
+    printf ("STAC item %s: %d band assets\n", stac_file, nassets);
+    status = SUCCESS;
+
+cleanup:
+    if (fp != NULL && fclose (fp) != 0 && status == SUCCESS)
+    {
+        snprintf (errmsg, sizeof (errmsg), "Closing the STAC item: %s",
+            stac_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        status = ERROR;
+    }
+    free_metadata (&xml_metadata);
+    return (status);
+}
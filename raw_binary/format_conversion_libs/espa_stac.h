@@ -0,0 +1,66 @@
+/*****************************************************************************
+FILE: espa_stac.h
+
+PURPOSE: Contains defines and prototypes for writing a STAC (SpatioTemporal
+Asset Catalog) item describing an ESPA product, with an asset per band file,
+so catalogs and cloud readers find the bands without converting them.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The item follows STAC 1.0.0 with the projection and raster extensions.
+  2. The files are named by the URL they are served from when a base URL is
+     given (ex. s3://bucket/path/), otherwise relative to the item when it is
+     written to the directory of the XML file, and by their absolute paths
+     otherwise.
+  3. The byte ranges of the bands are described by a set of references (see
+     convert_espa_to_zarr_refs), which the item links as an asset.
+*****************************************************************************/
+
+#ifndef ESPA_STAC_H
+#define ESPA_STAC_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "error_handler.h"
+#include "espa_metadata.h"
+#include "parse_metadata.h"
+
+/* Version of the STAC specification and extensions of the items */
+#define ESPA_STAC_VERSION "1.0.0"
+#define ESPA_STAC_PROJ_EXT \
+    "https://stac-extensions.github.io/projection/v1.0.0/schema.json"
+#define ESPA_STAC_RASTER_EXT \
+    "https://stac-extensions.github.io/raster/v1.1.0/schema.json"
+
+/* Prototypes */
+int espa_product_href
+(
+    const char *dir_file,  /* I: file in the directory of the named file
+                                 (ex. the XML metadata file) */
+    const char *out_file,  /* I: file the name is written to, which the name
+                                 is relative to when it is in the same
+                                 directory; NULL for absolute names */
+    const char *href_base, /* I: base URL of the product files; NULL if the
+                                 files are local */
+    const char *file_name, /* I: name of the file, relative to the directory
+                                 of dir_file */
+    char *href,            /* O: name of the file for out_file */
+    size_t size            /* I: size of href */
+);
+
+int write_espa_stac_item
+(
+    char *espa_xml_file,   /* I: input ESPA XML metadata filename */
+    char *stac_file,       /* I: output STAC item (JSON) filename */
+    char *refs_file,       /* I: references to link as an asset (see
+                                 convert_espa_to_zarr_refs); NULL for none */
+    char *href_base        /* I: base URL the product files are served
+                                 from; NULL if they are local */
+);
+
+#endif
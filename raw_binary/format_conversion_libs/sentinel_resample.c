@@ -0,0 +1,1085 @@
+/*****************************************************************************
+FILE: sentinel_resample.c
+
+PURPOSE: Contains functions for changing the resolution of a decoded
+Sentinel-2 band by an integer factor (see sentinel_resample.h).
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. Bilinear expansion is separable: each input line is expanded across
+     once, into a row of integers scaled by 2 * factor, and each output line
+     blends the two rows around it, which is the part done by the SIMD
+     kernel.  The weights are multiples of 1 / (2 * factor), so the sums are
+     exact integers and the pixels don't depend on the CPU.
+  2. The mean reduction adds the lines of a block into the sums and counts
+     of the valid pixels of each column with the SIMD kernel, then adds the
+     columns of each block.
+*****************************************************************************/
+
+#include "sentinel_resample.h"
+#include "espa_cpu_dispatch.h"
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#define SEN_RESAMPLE_X86
+#endif
+
+/* Kernel replicating each pixel of a 16-bit line factor times; returns the
+   number of input pixels whose output pixels were all written */
+typedef int (*Sen_expand_kernel_t)
+(
+    const uint16_t *in,  /* I: input line */
+    int nin,             /* I: number of input pixels */
+    int factor,          /* I: number of times each pixel is replicated */
+    uint16_t *out,       /* O: expanded line */
+    int nout             /* I: number of output pixels */
+);
+
+/* Kernel blending two rows of scaled integers into a 16-bit line, as
+   (row0 * w0 + row1 * w1 + denom / 2) / denom; returns the number of output
+   pixels computed */
+typedef int (*Sen_blend_kernel_t)
+(
+    const uint32_t *row0,  /* I: first row */
+    const uint32_t *row1,  /* I: second row */
+    int w0,              /* I: weight of the first row */
+    int w1,              /* I: weight of the second row */
+    int denom,           /* I: even divisor of the weighted sum */
+    uint16_t *out,       /* O: blended line */
+    int n                /* I: number of pixels */
+);
+
+/* Kernel adding the valid pixels of a 16-bit line to the sums and counts of
+   the columns; returns the number of pixels added */
+typedef int (*Sen_accum_kernel_t)
+(
+    const uint16_t *line,  /* I: input line */
+    int n,               /* I: number of pixels */
+    bool use_fill,       /* I: leave the fill pixels out? */
+    uint16_t fill,       /* I: fill value */
+    uint32_t *sums,      /* I/O: sums of the valid pixels of the columns */
+    uint32_t *counts     /* I/O: numbers of valid pixels of the columns */
+);
+
+
+#ifdef SEN_RESAMPLE_X86
+/******************************************************************************
+MODULE: sen_expand_sse2
+
+PURPOSE: Replicates each pixel of a 16-bit line twice, interleaving a vector
+with itself.  SSE2 has no byte shuffle, so the other factors are left to the
+scalar loop.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+n            Number of input pixels done
+
+NOTES:
+*****************************************************************************/
+static int sen_expand_sse2
+(
+    const uint16_t *in,  /* I: input line */
+    int nin,             /* I: number of input pixels */
+    int factor,          /* I: number of times each pixel is replicated */
+    uint16_t *out,       /* O: expanded line */
+    int nout             /* I: number of output pixels */
+)
+{
+    int i = 0;           /* current input pixel */
+    __m128i v;           /* vector of input pixels */
+
+    if (factor != 2)
+        return 0;
+
+    for (i = 0; i + 8 <= nin && 2 * i + 16 <= nout; i += 8)
+    {
+        v = _mm_loadu_si128 ((const __m128i *) (in + i));
+        _mm_storeu_si128 ((__m128i *) (out + 2 * i),
+            _mm_unpacklo_epi16 (v, v));
+        _mm_storeu_si128 ((__m128i *) (out + 2 * i + 8),
+            _mm_unpackhi_epi16 (v, v));
+    }
+
+    return i;
+}
+
+
+/******************************************************************************
+MODULE: sen_expand_avx2
+
+PURPOSE: Replicates each pixel of a 16-bit line factor times, shuffling 8
+input pixels copied into both halves of a 32-byte vector into 16 output
+pixels.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+n            Number of input pixels done
+
+NOTES:
+  1. Only put in the kernel table when the CPU supports AVX2.
+  2. Each step advances 16 / factor input pixels (ex. 5 for a factor of 3),
+     so the last output pixels of a vector are written again by the next
+     step, with the same values.
+*****************************************************************************/
+__attribute__ ((target ("avx2")))
+static int sen_expand_avx2
+(
+    const uint16_t *in,  /* I: input line */
+    int nin,             /* I: number of input pixels */
+    int factor,          /* I: number of times each pixel is replicated */
+    uint16_t *out,       /* O: expanded line */
+    int nout             /* I: number of output pixels */
+)
+{
+    int i = 0;           /* current input pixel */
+    int k;               /* output pixel of the vector */
+    int step;            /* input pixels advanced per vector */
+    char index[32];      /* bytes of the input taken by each output byte */
+    __m256i shuffle;     /* shuffle of the input bytes */
+    __m256i v;           /* input pixels, in both halves */
+
+    if (factor < 2 || factor > 8)
+        return 0;
+
+    /* Output pixel k of each half takes input pixel k / factor of that
+       half's copy */
+    for (k = 0; k < 16; k++)
+    {
+        index[2 * k] = 2 * (k / factor);
+        index[2 * k + 1] = 2 * (k / factor) + 1;
+    }
+    shuffle = _mm256_loadu_si256 ((const __m256i *) index);
+    step = 16 / factor;
+
+    for (i = 0; i + 8 <= nin && i * factor + 16 <= nout; i += step)
+    {
+        v = _mm256_broadcastsi128_si256 (_mm_loadu_si128 (
+            (const __m128i *) (in + i)));
+        _mm256_storeu_si256 ((__m256i *) (out + i * factor),
+            _mm256_shuffle_epi8 (v, shuffle));
+    }
+
+    return i;
+}
+
+
+/******************************************************************************
+MODULE: sen_blend_sse2
+
+PURPOSE: Blends two rows of scaled integers into a 16-bit line in 4-lane
+single precision vectors using SSE2.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+n            Number of output pixels computed
+
+NOTES:
+  1. The weighted sums are below 2^24, so they are exact in single
+     precision, and the quotients are truncated like the integer division
+     of the scalar loop.
+*****************************************************************************/
+static int sen_blend_sse2
+(
+    const uint32_t *row0,  /* I: first row */
+    const uint32_t *row1,  /* I: second row */
+    int w0,              /* I: weight of the first row */
+    int w1,              /* I: weight of the second row */
+    int denom,           /* I: even divisor of the weighted sum */
+    uint16_t *out,       /* O: blended line */
+    int n                /* I: number of pixels */
+)
+{
+    int j = 0;           /* current output pixel */
+    __m128 vw0 = _mm_set1_ps ((float) w0);   /* weight of the first row */
+    __m128 vw1 = _mm_set1_ps ((float) w1);   /* weight of the second row */
+    __m128 half = _mm_set1_ps ((float) (denom / 2));  /* rounding term */
+    __m128 div = _mm_set1_ps ((float) denom);   /* divisor */
+    __m128i bias = _mm_set1_epi32 (32768);  /* shifts the uint16 results into
+                                               the int16 range */
+    __m128i lo;          /* first 4 results */
+    __m128i hi;          /* last 4 results */
+
+    for (j = 0; j + 8 <= n; j += 8)
+    {
+        lo = _mm_cvttps_epi32 (_mm_div_ps (_mm_add_ps (_mm_add_ps (
+            _mm_mul_ps (_mm_cvtepi32_ps (_mm_loadu_si128 (
+            (const __m128i *) (row0 + j))), vw0),
+            _mm_mul_ps (_mm_cvtepi32_ps (_mm_loadu_si128 (
+            (const __m128i *) (row1 + j))), vw1)), half), div));
+        hi = _mm_cvttps_epi32 (_mm_div_ps (_mm_add_ps (_mm_add_ps (
+            _mm_mul_ps (_mm_cvtepi32_ps (_mm_loadu_si128 (
+            (const __m128i *) (row0 + j + 4))), vw0),
+            _mm_mul_ps (_mm_cvtepi32_ps (_mm_loadu_si128 (
+            (const __m128i *) (row1 + j + 4))), vw1)), half), div));
+        _mm_storeu_si128 ((__m128i *) (out + j), _mm_xor_si128 (
+            _mm_packs_epi32 (_mm_sub_epi32 (lo, bias),
+            _mm_sub_epi32 (hi, bias)), _mm_set1_epi16 ((short) 0x8000)));
+    }
+
+    return j;
+}
+
+
+/******************************************************************************
+MODULE: sen_blend_avx2
+
+PURPOSE: Blends two rows of scaled integers into a 16-bit line in 8-lane
+single precision vectors using AVX2.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+n            Number of output pixels computed
+
+NOTES:
+  1. Only put in the kernel table when the CPU supports AVX2.
+  2. The pack works within each 128-bit lane, so the 64-bit quarters of the
+     packed vector are put back in order with a permute.
+*****************************************************************************/
+__attribute__ ((target ("avx2")))
+static int sen_blend_avx2
+(
+    const uint32_t *row0,  /* I: first row */
+    const uint32_t *row1,  /* I: second row */
+    int w0,              /* I: weight of the first row */
+    int w1,              /* I: weight of the second row */
+    int denom,           /* I: even divisor of the weighted sum */
+    uint16_t *out,       /* O: blended line */
+    int n                /* I: number of pixels */
+)
+{
+    int j = 0;           /* current output pixel */
+    __m256 vw0 = _mm256_set1_ps ((float) w0);  /* weight of the first row */
+    __m256 vw1 = _mm256_set1_ps ((float) w1);  /* weight of the second row */
+    __m256 half = _mm256_set1_ps ((float) (denom / 2));  /* rounding term */
+    __m256 div = _mm256_set1_ps ((float) denom);  /* divisor */
+    __m256i lo;          /* first 8 results */
+    __m256i hi;          /* last 8 results */
+
+    for (j = 0; j + 16 <= n; j += 16)
+    {
+        lo = _mm256_cvttps_epi32 (_mm256_div_ps (_mm256_add_ps (
+            _mm256_add_ps (_mm256_mul_ps (_mm256_cvtepi32_ps (
+            _mm256_loadu_si256 ((const __m256i *) (row0 + j))), vw0),
+            _mm256_mul_ps (_mm256_cvtepi32_ps (_mm256_loadu_si256 (
+            (const __m256i *) (row1 + j))), vw1)), half), div));
+        hi = _mm256_cvttps_epi32 (_mm256_div_ps (_mm256_add_ps (
+            _mm256_add_ps (_mm256_mul_ps (_mm256_cvtepi32_ps (
+            _mm256_loadu_si256 ((const __m256i *) (row0 + j + 8))), vw0),
+            _mm256_mul_ps (_mm256_cvtepi32_ps (_mm256_loadu_si256 (
+            (const __m256i *) (row1 + j + 8))), vw1)), half), div));
+        _mm256_storeu_si256 ((__m256i *) (out + j), _mm256_permute4x64_epi64 (
+            _mm256_packus_epi32 (lo, hi), 0xd8));
+    }
+
+    return j + sen_blend_sse2 (row0 + j, row1 + j, w0, w1, denom, out + j,
+        n - j);
+}
+
+
+/******************************************************************************
+MODULE: sen_accum_sse2
+
+PURPOSE: Adds the valid pixels of a 16-bit line to the sums and counts of the
+columns, 8 pixels at a time using SSE2.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+n            Number of pixels added
+
+NOTES:
+*****************************************************************************/
+static int sen_accum_sse2
+(
+    const uint16_t *line,  /* I: input line */
+    int n,               /* I: number of pixels */
+    bool use_fill,       /* I: leave the fill pixels out? */
+    uint16_t fill,       /* I: fill value */
+    uint32_t *sums,      /* I/O: sums of the valid pixels of the columns */
+    uint32_t *counts     /* I/O: numbers of valid pixels of the columns */
+)
+{
+    int j = 0;           /* current pixel */
+    __m128i zero = _mm_setzero_si128 ();   /* zero for widening */
+    __m128i one = _mm_set1_epi16 (1);      /* count of a valid pixel */
+    __m128i vfill = _mm_set1_epi16 ((short) fill);  /* fill value */
+    __m128i v;           /* pixels of the line */
+    __m128i is_fill;     /* which pixels are fill */
+    __m128i c;           /* counts of the pixels */
+    __m128i *s;          /* sums being updated */
+    __m128i *k;          /* counts being updated */
+
+    for (j = 0; j + 8 <= n; j += 8)
+    {
+        v = _mm_loadu_si128 ((const __m128i *) (line + j));
+        is_fill = use_fill ? _mm_cmpeq_epi16 (v, vfill) : zero;
+        v = _mm_andnot_si128 (is_fill, v);
+        c = _mm_andnot_si128 (is_fill, one);
+        s = (__m128i *) (sums + j);
+        k = (__m128i *) (counts + j);
+        _mm_storeu_si128 (s, _mm_add_epi32 (_mm_loadu_si128 (s),
+            _mm_unpacklo_epi16 (v, zero)));
+        _mm_storeu_si128 (s + 1, _mm_add_epi32 (_mm_loadu_si128 (s + 1),
+            _mm_unpackhi_epi16 (v, zero)));
+        _mm_storeu_si128 (k, _mm_add_epi32 (_mm_loadu_si128 (k),
+            _mm_unpacklo_epi16 (c, zero)));
+        _mm_storeu_si128 (k + 1, _mm_add_epi32 (_mm_loadu_si128 (k + 1),
+            _mm_unpackhi_epi16 (c, zero)));
+    }
+
+    return j;
+}
+
+
+/******************************************************************************
+MODULE: sen_accum_avx2
+
+PURPOSE: Adds the valid pixels of a 16-bit line to the sums and counts of the
+columns, 16 pixels at a time using AVX2.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+n            Number of pixels added
+
+NOTES:
+  1. Only put in the kernel table when the CPU supports AVX2.
+*****************************************************************************/
+__attribute__ ((target ("avx2")))
+static int sen_accum_avx2
+(
+    const uint16_t *line,  /* I: input line */
+    int n,               /* I: number of pixels */
+    bool use_fill,       /* I: leave the fill pixels out? */
+    uint16_t fill,       /* I: fill value */
+    uint32_t *sums,      /* I/O: sums of the valid pixels of the columns */
+    uint32_t *counts     /* I/O: numbers of valid pixels of the columns */
+)
+{
+    int j = 0;           /* current pixel */
+    __m256i one = _mm256_set1_epi16 (1);   /* count of a valid pixel */
+    __m256i vfill = _mm256_set1_epi16 ((short) fill);  /* fill value */
+    __m256i v;           /* pixels of the line */
+    __m256i is_fill;     /* which pixels are fill */
+    __m256i c;           /* counts of the pixels */
+    __m256i *s;          /* sums being updated */
+    __m256i *k;          /* counts being updated */
+
+    for (j = 0; j + 16 <= n; j += 16)
+    {
+        v = _mm256_loadu_si256 ((const __m256i *) (line + j));
+        is_fill = use_fill ? _mm256_cmpeq_epi16 (v, vfill) :
+            _mm256_setzero_si256 ();
+        v = _mm256_andnot_si256 (is_fill, v);
+        c = _mm256_andnot_si256 (is_fill, one);
+        s = (__m256i *) (sums + j);
+        k = (__m256i *) (counts + j);
+        _mm256_storeu_si256 (s, _mm256_add_epi32 (_mm256_loadu_si256 (s),
+            _mm256_cvtepu16_epi32 (_mm256_castsi256_si128 (v))));
+        _mm256_storeu_si256 (s + 1, _mm256_add_epi32 (
+            _mm256_loadu_si256 (s + 1),
+            _mm256_cvtepu16_epi32 (_mm256_extracti128_si256 (v, 1))));
+        _mm256_storeu_si256 (k, _mm256_add_epi32 (_mm256_loadu_si256 (k),
+            _mm256_cvtepu16_epi32 (_mm256_castsi256_si128 (c))));
+        _mm256_storeu_si256 (k + 1, _mm256_add_epi32 (
+            _mm256_loadu_si256 (k + 1),
+            _mm256_cvtepu16_epi32 (_mm256_extracti128_si256 (c, 1))));
+    }
+
+    return j;
+}
+#endif
+
+
+/******************************************************************************
+MODULE: sen_expand_none, sen_blend_none, sen_accum_none
+
+PURPOSE: Kernels of the CPUs without vector instructions, which leave the
+whole line to the scalar loops.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+0            No pixels done
+
+NOTES:
+*****************************************************************************/
+static int sen_expand_none
+(
+    const uint16_t *in,  /* I: input line (unused) */
+    int nin,             /* I: number of input pixels (unused) */
+    int factor,          /* I: replication factor (unused) */
+    uint16_t *out,       /* O: expanded line (unused) */
+    int nout             /* I: number of output pixels (unused) */
+)
+{
+    return 0;
+}
+
+static int sen_blend_none
+(
+    const uint32_t *row0,  /* I: first row (unused) */
+    const uint32_t *row1,  /* I: second row (unused) */
+    int w0,              /* I: weight of the first row (unused) */
+    int w1,              /* I: weight of the second row (unused) */
+    int denom,           /* I: divisor of the weighted sum (unused) */
+    uint16_t *out,       /* O: blended line (unused) */
+    int n                /* I: number of pixels (unused) */
+)
+{
+    return 0;
+}
+
+static int sen_accum_none
+(
+    const uint16_t *line,  /* I: input line (unused) */
+    int n,               /* I: number of pixels (unused) */
+    bool use_fill,       /* I: leave the fill pixels out? (unused) */
+    uint16_t fill,       /* I: fill value (unused) */
+    uint32_t *sums,      /* I/O: sums of the columns (unused) */
+    uint32_t *counts     /* I/O: counts of the columns (unused) */
+)
+{
+    return 0;
+}
+
+
+/* Kernels of the 16-bit bands, chosen by init_sentinel_resample_kernels */
+static Sen_expand_kernel_t sen_expand_kernel = sen_expand_none;
+static Sen_blend_kernel_t sen_blend_kernel = sen_blend_none;
+static Sen_accum_kernel_t sen_accum_kernel = sen_accum_none;
+
+
+/******************************************************************************
+MODULE: init_sentinel_resample_kernels
+
+PURPOSE: Chooses the widest kernels supported by the CPU.
+
+RETURN VALUE: None
+
+NOTES:
+  1. Run when the program (or shared library) is loaded.
+*****************************************************************************/
+__attribute__ ((constructor))
+static void init_sentinel_resample_kernels (void)
+{
+#if defined(SEN_RESAMPLE_X86)
+    if (espa_cpu_supports (ESPA_CPU_AVX2))
+    {
+        sen_expand_kernel = sen_expand_avx2;
+        sen_blend_kernel = sen_blend_avx2;
+        sen_accum_kernel = sen_accum_avx2;
+    }
+    else if (espa_cpu_supports (ESPA_CPU_SSE2))
+    {
+        sen_expand_kernel = sen_expand_sse2;
+        sen_blend_kernel = sen_blend_sse2;
+        sen_accum_kernel = sen_accum_sse2;
+    }
+#endif
+}
+
+
+/* Reads and writes pixel i of a buffer of unsigned pixels of nbytes bytes */
+#define GET_PIXEL(buf, i, nbytes) \
+    ((nbytes) == 1 ? (uint32_t) ((const uint8_t *) (buf))[i] : \
+     ((nbytes) == 2 ? (uint32_t) ((const uint16_t *) (buf))[i] : \
+      ((const uint32_t *) (buf))[i]))
+#define SET_PIXEL(buf, i, nbytes, value) \
+    { \
+        if ((nbytes) == 1) \
+            ((uint8_t *) (buf))[i] = (value); \
+        else if ((nbytes) == 2) \
+            ((uint16_t *) (buf))[i] = (value); \
+        else \
+            ((uint32_t *) (buf))[i] = (value); \
+    }
+
+
+/******************************************************************************
+MODULE: parse_sentinel_resample_method
+
+PURPOSE: Determines the resampling method from its name.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Unknown method
+SUCCESS      Successfully determined the method
+
+NOTES:
+*****************************************************************************/
+int parse_sentinel_resample_method
+(
+    const char *name,         /* I: name of the method (replicate, mean, or
+                                    bilinear) */
+    enum Sentinel_resample_method *method  /* O: method */
+)
+{
+    char FUNC_NAME[] = "parse_sentinel_resample_method";  /* function
+                                                             name */
+    char errmsg[STR_SIZE];    /* error message */
+
+    if (!strcmp (name, "replicate"))
+        *method = SENTINEL_REPLICATE;
+    else if (!strcmp (name, "mean"))
+        *method = SENTINEL_MEAN;
+    else if (!strcmp (name, "bilinear"))
+        *method = SENTINEL_BILINEAR;
+    else
+    {
+        snprintf (errmsg, sizeof (errmsg), "Unknown resampling method %s; "
+            "replicate, mean, or bilinear expected", name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE: sentinel_resample_method_name
+
+PURPOSE: Returns the name of a resampling method.
+
+RETURN VALUE:
+Type = const char *
+Value        Description
+-----        -----------
+name         Name of the method
+
+NOTES:
+*****************************************************************************/
+const char *sentinel_resample_method_name
+(
+    enum Sentinel_resample_method method  /* I: method */
+)
+{
+    switch (method)
+    {
+        case SENTINEL_MEAN: return ("mean");
+        case SENTINEL_BILINEAR: return ("bilinear");
+        default: return ("replicate");
+    }
+}
+
+
+/******************************************************************************
+MODULE: sentinel_resample_method_valid
+
+PURPOSE: Determines whether a method can change the resolution of a band in
+the given direction.
+
+RETURN VALUE:
+Type = bool
+Value        Description
+-----        -----------
+true         Replicate either way, bilinear when expanding, or mean when
+             reducing
+false        Otherwise
+
+NOTES:
+*****************************************************************************/
+bool sentinel_resample_method_valid
+(
+    enum Sentinel_resample_method method, /* I: method */
+    bool expand               /* I: is the band expanded rather than
+                                    reduced? */
+)
+{
+    if (method == SENTINEL_REPLICATE)
+        return (true);
+    return (expand ? method == SENTINEL_BILINEAR : method == SENTINEL_MEAN);
+}
+
+
+/******************************************************************************
+MODULE: bilinear_position
+
+PURPOSE: Determines the input pixels, and their weights, around the center of
+an output pixel of a band expanded by a factor.
+
+RETURN VALUE: None
+
+NOTES:
+  1. The center of output pixel k is at input pixel (2k + 1 - factor) /
+     (2 factor).  The pixels past the edges of the band take the weight of
+     the edge pixel.
+******************************************************************************/
+static void bilinear_position
+(
+    int k,                    /* I: output line or sample */
+    int factor,               /* I: factor of the expansion */
+    int in_n,                 /* I: number of input lines or samples */
+    int *i0,                  /* O: first input line or sample */
+    int *w1                   /* O: weight of the next input line or sample,
+                                    out of 2 * factor */
+)
+{
+    int num = 2 * k + 1 - factor;   /* center, in 1 / (2 factor) pixels */
+    int den = 2 * factor;           /* pixels to 1 / (2 factor) pixels */
+
+    *i0 = num >= 0 ? num / den : -((-num + den - 1) / den);
+    *w1 = num - *i0 * den;
+    if (*i0 < 0)
+    {
+        *i0 = 0;
+        *w1 = 0;
+    }
+    else if (*i0 >= in_n - 1)
+    {
+        *i0 = in_n - 1;
+        *w1 = 0;
+    }
+}
+
+
+/******************************************************************************
+MODULE: open_sentinel_resample
+
+PURPOSE: Sets up the resampling of a decoded band to the output size.
+
+RETURN VALUE:
+Type = Sentinel_resample_t *
+Value        Description
+-----        -----------
+NULL         Error setting up the resampling
+non-NULL     Resampling of the band, freed with close_sentinel_resample
+
+NOTES:
+  1. The decoded band isn't copied, so it must be kept until the resampling
+     is closed.
+*****************************************************************************/
+Sentinel_resample_t *open_sentinel_resample
+(
+    const void *in_buf,       /* I: decoded band, kept until closed */
+    int in_nlines,            /* I: number of lines of the decoded band */
+    int in_nsamps,            /* I: number of samples of the decoded band */
+    int nbytes,               /* I: number of bytes per pixel */
+    long fill_value,          /* I: fill value of the band */
+    int factor,               /* I: factor of the expansion or reduction */
+    bool expand,              /* I: is the band expanded rather than
+                                    reduced? */
+    enum Sentinel_resample_method method,  /* I: resampling method */
+    int nlines,               /* I: number of lines of the output band */
+    int nsamps                /* I: number of samples of the output band */
+)
+{
+    char FUNC_NAME[] = "open_sentinel_resample";  /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    int i;                    /* looping variable */
+    int row_size;             /* number of values of the rows */
+    bool sizes_match;         /* do the sizes match the factor? */
+    Sentinel_resample_t *resample = NULL;  /* resampling of the band */
+
+    if (expand)
+        sizes_match = (nlines + factor - 1) / factor == in_nlines &&
+            (nsamps + factor - 1) / factor == in_nsamps;
+    else
+        sizes_match = (in_nlines + factor - 1) / factor == nlines &&
+            (in_nsamps + factor - 1) / factor == nsamps;
+    if (factor < 1 || in_nlines < 1 || in_nsamps < 1 || nlines < 1 ||
+        nsamps < 1 || !sizes_match)
+    {
+        sprintf (errmsg, "Band of %d lines x %d samples can't be %s by %d "
+            "to %d lines x %d samples", in_nlines, in_nsamps,
+            expand ? "expanded" : "reduced", factor, nlines, nsamps);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (NULL);
+    }
+    if (!sentinel_resample_method_valid (method, expand) ||
+        (method == SENTINEL_BILINEAR && nbytes > 2))
+    {
+        sprintf (errmsg, "The %s method can't %s a band of %d-byte pixels",
+            sentinel_resample_method_name (method),
+            expand ? "expand" : "reduce", nbytes);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (NULL);
+    }
+
+    resample = calloc (1, sizeof (Sentinel_resample_t));
+    if (resample == NULL)
+    {
+        sprintf (errmsg, "Allocating the resampling of the band");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (NULL);
+    }
+    resample->in_buf = in_buf;
+    resample->in_nlines = in_nlines;
+    resample->in_nsamps = in_nsamps;
+    resample->nlines = nlines;
+    resample->nsamps = nsamps;
+    resample->nbytes = nbytes;
+    resample->fill_value = fill_value;
+    resample->factor = factor;
+    resample->expand = expand;
+    resample->method = method;
+    resample->row_line[0] = -1;
+    resample->row_line[1] = -1;
+
+    /* Bilinear expansion keeps the input lines around the output line
+       expanded across, and the mean reduction the sums and counts of the
+       columns */
+    row_size = 0;
+    if (method == SENTINEL_BILINEAR)
+        row_size = nsamps;
+    else if (method == SENTINEL_MEAN)
+        row_size = in_nsamps;
+    if (row_size > 0)
+    {
+        for (i = 0; i < 2; i++)
+        {
+            resample->rows[i] = calloc (row_size, sizeof (uint32_t));
+            if (resample->rows[i] == NULL)
+            {
+                sprintf (errmsg, "Allocating the rows of the resampling");
+                error_handler (true, FUNC_NAME, errmsg);
+                close_sentinel_resample (resample);
+                return (NULL);
+            }
+        }
+    }
+
+    if (method == SENTINEL_BILINEAR)
+    {
+        resample->x0 = calloc (nsamps, sizeof (int));
+        resample->wx1 = calloc (nsamps, sizeof (int));
+        resample->fill_rows[0] = calloc (nsamps, sizeof (uint8_t));
+        resample->fill_rows[1] = calloc (nsamps, sizeof (uint8_t));
+        if (resample->x0 == NULL || resample->wx1 == NULL ||
+            resample->fill_rows[0] == NULL || resample->fill_rows[1] == NULL)
+        {
+            sprintf (errmsg, "Allocating the weights of the resampling");
+            error_handler (true, FUNC_NAME, errmsg);
+            close_sentinel_resample (resample);
+            return (NULL);
+        }
+        for (i = 0; i < nsamps; i++)
+            bilinear_position (i, factor, in_nsamps, &resample->x0[i],
+                &resample->wx1[i]);
+    }
+
+    return (resample);
+}
+
+
+/******************************************************************************
+MODULE: expand_bilinear_row
+
+PURPOSE: Expands an input line across into a row of the bilinear expansion,
+unless the row already holds it.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+0, 1         Row holding the input line
+
+NOTES:
+  1. The row replaced is the one not holding keep_line.
+*****************************************************************************/
+static int expand_bilinear_row
+(
+    Sentinel_resample_t *resample,  /* I/O: resampling of the band */
+    int line,                 /* I: input line */
+    int keep_line             /* I: input line not to be replaced */
+)
+{
+    int r;                    /* row being filled */
+    int k;                    /* output sample */
+    int w0, w1;               /* weights of the input samples */
+    int den = 2 * resample->factor;  /* sum of the weights */
+    int nbytes = resample->nbytes;   /* number of bytes per pixel */
+    uint32_t a, b;            /* input pixels */
+    uint32_t *row = NULL;     /* row being filled */
+    uint8_t *fill = NULL;     /* fill flags of the row */
+    const char *in = NULL;    /* input line */
+
+    for (r = 0; r < 2; r++)
+    {
+        if (resample->row_line[r] == line)
+            return (r);
+    }
+    r = resample->row_line[0] == keep_line ? 1 : 0;
+    row = resample->rows[r];
+    fill = resample->fill_rows[r];
+    in = (const char *) resample->in_buf + (size_t) line *
+        resample->in_nsamps * nbytes;
+
+    resample->row_fill[r] = false;
+    for (k = 0; k < resample->nsamps; k++)
+    {
+        w1 = resample->wx1[k];
+        w0 = den - w1;
+        a = GET_PIXEL (in, resample->x0[k], nbytes);
+        b = w1 > 0 ? GET_PIXEL (in, resample->x0[k] + 1, nbytes) : 0;
+        row[k] = a * w0 + b * w1;
+        fill[k] = (long) a == resample->fill_value ||
+            (w1 > 0 && (long) b == resample->fill_value);
+        if (fill[k])
+            resample->row_fill[r] = true;
+    }
+    resample->row_line[r] = line;
+
+    return (r);
+}
+
+
+/******************************************************************************
+MODULE: expand_lines
+
+PURPOSE: Expands the decoded band into a block of output lines.
+
+RETURN VALUE: None
+
+NOTES:
+*****************************************************************************/
+static void expand_lines
+(
+    Sentinel_resample_t *resample,  /* I/O: resampling of the band */
+    int line,                 /* I: first output line */
+    int nlines,               /* I: number of output lines */
+    void *out_buf             /* O: nlines x nsamps output pixels */
+)
+{
+    int f = resample->factor;       /* factor of the expansion */
+    int nbytes = resample->nbytes;  /* number of bytes per pixel */
+    int nsamps = resample->nsamps;  /* number of output samples */
+    int in_nsamps = resample->in_nsamps;  /* number of input samples */
+    int den = 4 * f * f;            /* sum of the 2D weights */
+    int l;                    /* output line of the block */
+    int k;                    /* output sample */
+    int i;                    /* input sample */
+    int il;                   /* input line of the output line */
+    int l0;                   /* first input line around the output line */
+    int wy1;                  /* weight of the next input line */
+    int r0, r1;               /* rows of the input lines */
+    size_t line_size = (size_t) nsamps * nbytes;  /* bytes per output line */
+    uint32_t value;           /* output pixel */
+    const char *in = NULL;    /* input line */
+    char *out = NULL;         /* output line */
+
+    for (l = 0; l < nlines; l++)
+    {
+        il = (line + l) / f;
+        in = (const char *) resample->in_buf + (size_t) il * in_nsamps *
+            nbytes;
+        out = (char *) out_buf + l * line_size;
+
+        if (resample->method != SENTINEL_BILINEAR)
+        {
+            /* The lines of the same input line are copies of the first */
+            if (l > 0 && (line + l - 1) / f == il)
+            {
+                memcpy (out, out - line_size, line_size);
+                continue;
+            }
+            i = 0;
+            if (nbytes == 2)
+                i = sen_expand_kernel ((const uint16_t *) in, in_nsamps, f,
+                    (uint16_t *) out, nsamps);
+            for (k = i * f; k < nsamps; k++)
+                SET_PIXEL (out, k, nbytes, GET_PIXEL (in, k / f, nbytes));
+            continue;
+        }
+
+        /* Blend the input lines around the output line, expanded across */
+        bilinear_position (line + l, f, resample->in_nlines, &l0, &wy1);
+        r0 = expand_bilinear_row (resample, l0, wy1 > 0 ? l0 + 1 : l0);
+        r1 = wy1 > 0 ? expand_bilinear_row (resample, l0 + 1, l0) : r0;
+        k = 0;
+        if (nbytes == 2)
+            k = sen_blend_kernel (resample->rows[r0], resample->rows[r1],
+                2 * f - wy1, wy1, den, (uint16_t *) out, nsamps);
+        for (; k < nsamps; k++)
+        {
+            value = (resample->rows[r0][k] * (2 * f - wy1) +
+                resample->rows[r1][k] * wy1 + den / 2) / den;
+            SET_PIXEL (out, k, nbytes, value);
+        }
+
+        /* Replicate the nearest pixel where a fill pixel has a weight */
+        if (!resample->row_fill[r0] && !(wy1 > 0 && resample->row_fill[r1]))
+            continue;
+        for (k = 0; k < nsamps; k++)
+        {
+            if (resample->fill_rows[r0][k] ||
+                (wy1 > 0 && resample->fill_rows[r1][k]))
+                SET_PIXEL (out, k, nbytes, GET_PIXEL (in, k / f, nbytes));
+        }
+    }
+}
+
+
+/******************************************************************************
+MODULE: reduce_lines
+
+PURPOSE: Reduces the decoded band into a block of output lines.
+
+RETURN VALUE: None
+
+NOTES:
+*****************************************************************************/
+static void reduce_lines
+(
+    Sentinel_resample_t *resample,  /* I/O: resampling of the band */
+    int line,                 /* I: first output line */
+    int nlines,               /* I: number of output lines */
+    void *out_buf             /* O: nlines x nsamps output pixels */
+)
+{
+    int f = resample->factor;       /* factor of the reduction */
+    int nbytes = resample->nbytes;  /* number of bytes per pixel */
+    int nsamps = resample->nsamps;  /* number of output samples */
+    int in_nsamps = resample->in_nsamps;  /* number of input samples */
+    int l;                    /* output line of the block */
+    int k;                    /* output sample */
+    int i;                    /* input sample */
+    int il;                   /* input line */
+    int last;                 /* last input line or sample of the block */
+    bool use_fill;            /* can the fill value be a pixel? */
+    uint32_t value;           /* input or output pixel */
+    uint32_t *sums = resample->rows[0];    /* sums of the columns */
+    uint32_t *counts = resample->rows[1];  /* counts of the columns */
+    unsigned long sum;        /* sum of the valid pixels of the block */
+    unsigned long nvalid;     /* number of valid pixels of the block */
+    const char *in = NULL;    /* input line */
+    char *out = NULL;         /* output line */
+
+    use_fill = resample->fill_value >= 0 && resample->fill_value <= 0xffff;
+    for (l = 0; l < nlines; l++)
+    {
+        out = (char *) out_buf + (size_t) l * nsamps * nbytes;
+
+        /* Replicate the center pixel of each block */
+        if (resample->method == SENTINEL_REPLICATE)
+        {
+            il = (line + l) * f + f / 2;
+            if (il > resample->in_nlines - 1)
+                il = resample->in_nlines - 1;
+            in = (const char *) resample->in_buf + (size_t) il * in_nsamps *
+                nbytes;
+            for (k = 0; k < nsamps; k++)
+            {
+                i = k * f + f / 2;
+                if (i > in_nsamps - 1)
+                    i = in_nsamps - 1;
+                SET_PIXEL (out, k, nbytes, GET_PIXEL (in, i, nbytes));
+            }
+            continue;
+        }
+
+        /* Add up the valid pixels of the columns of the block */
+        memset (sums, 0, in_nsamps * sizeof (uint32_t));
+        memset (counts, 0, in_nsamps * sizeof (uint32_t));
+        last = (line + l + 1) * f;
+        if (last > resample->in_nlines)
+            last = resample->in_nlines;
+        for (il = (line + l) * f; il < last; il++)
+        {
+            in = (const char *) resample->in_buf + (size_t) il * in_nsamps *
+                nbytes;
+            i = 0;
+            if (nbytes == 2)
+                i = sen_accum_kernel ((const uint16_t *) in, in_nsamps,
+                    use_fill, (uint16_t) resample->fill_value, sums, counts);
+            for (; i < in_nsamps; i++)
+            {
+                value = GET_PIXEL (in, i, nbytes);
+                if ((long) value == resample->fill_value)
+                    continue;
+                sums[i] += value;
+                counts[i]++;
+            }
+        }
+
+        /* Add up the columns of each block, and take the rounded mean */
+        for (k = 0; k < nsamps; k++)
+        {
+            sum = 0;
+            nvalid = 0;
+            last = (k + 1) * f;
+            if (last > in_nsamps)
+                last = in_nsamps;
+            for (i = k * f; i < last; i++)
+            {
+                sum += sums[i];
+                nvalid += counts[i];
+            }
+            value = nvalid > 0 ? (sum + nvalid / 2) / nvalid :
+                (uint32_t) resample->fill_value;
+            SET_PIXEL (out, k, nbytes, value);
+        }
+    }
+}
+
+
+/******************************************************************************
+MODULE: resample_sentinel_lines
+
+PURPOSE: Resamples the decoded band into a block of output lines.
+
+RETURN VALUE: None
+
+NOTES:
+  1. The blocks are cheapest in the order of the lines, since a bilinear
+     expansion keeps the last two input lines expanded across.
+*****************************************************************************/
+void resample_sentinel_lines
+(
+    Sentinel_resample_t *resample,  /* I/O: resampling of the band */
+    int line,                 /* I: first output line */
+    int nlines,               /* I: number of output lines */
+    void *out_buf             /* O: nlines x nsamps output pixels */
+)
+{
+    if (resample->expand)
+        expand_lines (resample, line, nlines, out_buf);
+    else
+        reduce_lines (resample, line, nlines, out_buf);
+}
+
+
+/******************************************************************************
+MODULE: close_sentinel_resample
+
+PURPOSE: Frees the resampling of a band.
+
+RETURN VALUE: None
+
+NOTES:
+  1. The decoded band is left to the caller.
+*****************************************************************************/
+void close_sentinel_resample
+(
+    Sentinel_resample_t *resample  /* I: resampling to be freed */
+)
+{
+    if (resample == NULL)
+        return;
+
+    free (resample->x0);
+    free (resample->wx1);
+    free (resample->rows[0]);
+    free (resample->rows[1]);
+    free (resample->fill_rows[0]);
+    free (resample->fill_rows[1]);
+    free (resample);
+}
@@ -0,0 +1,127 @@
+/*****************************************************************************
+FILE: sentinel_resample.h
+
+PURPOSE: Contains defines, structures, and prototypes for changing the
+resolution of a decoded Sentinel-2 band by an integer factor (2, 3, or 6
+between the 10, 20, and 60 meter bands), a block of output lines at a time.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. A band is either expanded (coarser than the output, ex. 20 meters to 10)
+     or reduced (finer than the output).  The pixels of the input and output
+     grids share the outer edges of the band, so the centers of the output
+     pixels are at (k + 0.5) / factor - 0.5 input pixels when expanding.
+  2. Expanding replicates each pixel factor x factor times, or interpolates
+     bilinearly between the 2x2 nearest pixels.  Bilinear output pixels
+     next to a fill pixel with a weight take the replicated value instead.
+  3. Reducing takes the rounded mean of the pixels of each factor x factor
+     block which aren't fill (or the fill value if they all are), or
+     replicates the pixel at the center of the block.  Blocks at the right
+     and bottom edges may be partial.
+  4. The 16-bit kernels use SIMD instructions, chosen once when the program
+     is loaded (see espa_cpu_dispatch.h); they give the same pixels as the
+     scalar loops, which do the 8 and 32-bit bands and the remainders.
+*****************************************************************************/
+
+#ifndef SENTINEL_RESAMPLE_H
+#define SENTINEL_RESAMPLE_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+#include "error_handler.h"
+
+/* Defines */
+#define SENTINEL_RESAMPLE_BLOCK_LINES 256  /* output lines resampled and
+                                              written at a time */
+
+/* Resampling methods of the bands */
+enum Sentinel_resample_method
+{
+    SENTINEL_REPLICATE,       /* replicate the nearest pixel */
+    SENTINEL_MEAN,            /* mean of the valid pixels (reduce only) */
+    SENTINEL_BILINEAR         /* bilinear interpolation (expand only) */
+};
+
+/* Resampling of a decoded band */
+typedef struct
+{
+    const void *in_buf;       /* decoded band of in_nlines x in_nsamps */
+    int in_nlines;            /* number of lines of the decoded band */
+    int in_nsamps;            /* number of samples of the decoded band */
+    int nlines;               /* number of lines of the output band */
+    int nsamps;               /* number of samples of the output band */
+    int nbytes;               /* number of bytes per pixel (1, 2, or 4) */
+    long fill_value;          /* fill value of the band */
+    int factor;               /* factor of the expansion or reduction */
+    bool expand;              /* is the band expanded rather than reduced? */
+    enum Sentinel_resample_method method;  /* resampling method */
+    int *x0;                  /* bilinear: left input sample of each output
+                                 sample */
+    int *wx1;                 /* bilinear: weight of the right input sample,
+                                 out of 2 * factor */
+    uint32_t *rows[2];        /* bilinear: input lines expanded across,
+                                 scaled by 2 * factor; mean: sums and counts
+                                 of the valid pixels of the columns */
+    uint8_t *fill_rows[2];    /* bilinear: does each expanded pixel use a
+                                 fill pixel? */
+    bool row_fill[2];         /* bilinear: does any pixel of the row? */
+    int row_line[2];          /* bilinear: input line of each row; -1 if
+                                 none */
+} Sentinel_resample_t;
+
+/* Prototypes */
+int parse_sentinel_resample_method
+(
+    const char *name,         /* I: name of the method (replicate, mean, or
+                                    bilinear) */
+    enum Sentinel_resample_method *method  /* O: method */
+);
+
+const char *sentinel_resample_method_name
+(
+    enum Sentinel_resample_method method  /* I: method */
+);
+
+bool sentinel_resample_method_valid
+(
+    enum Sentinel_resample_method method, /* I: method */
+    bool expand               /* I: is the band expanded rather than
+                                    reduced? */
+);
+
+Sentinel_resample_t *open_sentinel_resample
+(
+    const void *in_buf,       /* I: decoded band, kept until closed */
+    int in_nlines,            /* I: number of lines of the decoded band */
+    int in_nsamps,            /* I: number of samples of the decoded band */
+    int nbytes,               /* I: number of bytes per pixel */
+    long fill_value,          /* I: fill value of the band */
+    int factor,               /* I: factor of the expansion or reduction */
+    bool expand,              /* I: is the band expanded rather than
+                                    reduced? */
+    enum Sentinel_resample_method method,  /* I: resampling method */
+    int nlines,               /* I: number of lines of the output band */
+    int nsamps                /* I: number of samples of the output band */
+);
+
+void resample_sentinel_lines
+(
+    Sentinel_resample_t *resample,  /* I/O: resampling of the band */
+    int line,                 /* I: first output line */
+    int nlines,               /* I: number of output lines */
+    void *out_buf             /* O: nlines x nsamps output pixels */
+);
+
+void close_sentinel_resample
+(
+    Sentinel_resample_t *resample  /* I: resampling to be freed */
+);
+
+#endif
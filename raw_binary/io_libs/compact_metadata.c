@@ -0,0 +1,765 @@
+/*****************************************************************************
+FILE: compact_metadata.c
+
+PURPOSE: Contains functions for the string pool and the compact form of the
+ESPA internal band metadata.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The pool hands out memory from a metadata arena, whose blocks are never
+     moved, so the interned strings keep their addresses as the pool grows.
+*****************************************************************************/
+
+#include <stdint.h>
+#include <libxml/parser.h>
+#include <libxml/tree.h>
+#include "compact_metadata.h"
+#include "parse_metadata.h"
+#include "espa_hash.h"
+
+/******************************************************************************
+MODULE:  init_string_pool
+
+PURPOSE: Initializes an empty string pool.
+
+RETURN VALUE: N/A
+
+NOTES:
+******************************************************************************/
+void init_string_pool
+(
+    Espa_string_pool_t *pool      /* I: string pool to be initialized */
+)
+{
+    pool->arena.block = NULL;
+    pool->slot = NULL;
+    pool->nslots = 0;
+    pool->nstrings = 0;
+}
+
+
+/******************************************************************************
+MODULE:  intern_string
+
+PURPOSE: Returns the pool's copy of the string, adding it to the pool if it
+hasn't been seen before.
+
+RETURN VALUE:
+Type = const char *
+Value           Description
+-----           -----------
+NULL            Error allocating memory for the string (or str is NULL)
+non-NULL        Interned copy of the string
+
+NOTES:
+  1. Equal strings are always returned as the same pointer.
+******************************************************************************/
+const char *intern_string
+(
+    Espa_string_pool_t *pool,     /* I: string pool */
+    const char *str               /* I: string to be interned */
+)
+{
+    char FUNC_NAME[] = "intern_string";  /* function name */
+    char errmsg[STR_SIZE];        /* error message */
+    const char **slot = NULL;     /* resized hash table */
+    size_t nslots;                /* number of slots in the resized table */
+    size_t len;                   /* length of the string */
+    size_t i, j;                  /* hash table slots */
+    char *copy = NULL;            /* pool copy of the string */
+
+    if (str == NULL)
+        return (NULL);
+
+    /* Keep the hash table at most half full */
+    if ((pool->nstrings + 1) * 2 > pool->nslots)
+    {
+        nslots = pool->nslots > 0 ? pool->nslots * 2 : 256;
+        slot = calloc (nslots, sizeof (const char *));
+        if (slot == NULL)
+        {
+            sprintf (errmsg, "Allocating the string pool hash table");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (NULL);
+        }
+        for (i = 0; i < pool->nslots; i++)
+        {
+            if (pool->slot[i] == NULL)
+                continue;
+            j = espa_hash_fnv1a_string (pool->slot[i]) & (nslots - 1);
+            while (slot[j] != NULL)
+                j = (j + 1) & (nslots - 1);
+            slot[j] = pool->slot[i];
+        }
+        free (pool->slot);
+        pool->slot = slot;
+        pool->nslots = nslots;
+    }
+
+    /* Look for the string, stopping at the empty slot where it belongs */
+    i = espa_hash_fnv1a_string (str) & (pool->nslots - 1);
+    while (pool->slot[i] != NULL)
+    {
+        if (strcmp (pool->slot[i], str) == 0)
+            return (pool->slot[i]);
+        i = (i + 1) & (pool->nslots - 1);
+    }
+
+    len = strlen (str);
+    copy = espa_arena_calloc (&pool->arena, len + 1, sizeof (char));
+    if (copy == NULL)
+    {
+        sprintf (errmsg, "Allocating %zu bytes in the string pool", len + 1);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (NULL);
+    }
+    memcpy (copy, str, len + 1);
+    pool->slot[i] = copy;
+    pool->nstrings++;
+
+    return (copy);
+}
+
+
+/******************************************************************************
+MODULE:  free_string_pool
+
+PURPOSE: Frees all the strings and arrays in the string pool.
+
+RETURN VALUE: N/A
+
+NOTES:
+  1. The pool is left empty and may be reused.
+******************************************************************************/
+void free_string_pool
+(
+    Espa_string_pool_t *pool      /* I: string pool to be freed */
+)
+{
+    free_espa_arena (&pool->arena);
+    free (pool->slot);
+    init_string_pool (pool);
+}
+
+
+/******************************************************************************
+MODULE:  init_compact_metadata
+
+PURPOSE: Initializes the compact metadata to have no bands and an empty
+string pool.
+
+RETURN VALUE: N/A
+
+NOTES:
+******************************************************************************/
+void init_compact_metadata
+(
+    Espa_compact_meta_t *compact  /* I: compact metadata to be initialized */
+)
+{
+    Espa_internal_meta_t meta;    /* metadata providing the global fill */
+
+    init_metadata_struct (&meta);
+    strcpy (compact->meta_namespace, meta.meta_namespace);
+    compact->global = meta.global;
+    compact->nbands = 0;
+    compact->band = NULL;
+    init_string_pool (&compact->pool);
+}
+
+
+/******************************************************************************
+MODULE:  compact_band_metadata
+
+PURPOSE: Converts the band metadata to its compact form, interning the strings
+in the pool of the compact metadata.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error allocating memory in the string pool
+SUCCESS         Successfully compacted the band
+
+NOTES:
+******************************************************************************/
+int compact_band_metadata
+(
+    Espa_compact_meta_t *compact, /* I: compact metadata whose pool holds the
+                                        strings of the band */
+    const Espa_band_meta_t *bmeta,  /* I: band metadata to be compacted */
+    Espa_compact_band_t *cband    /* O: compact band metadata */
+)
+{
+    char FUNC_NAME[] = "compact_band_metadata";  /* function name */
+    char errmsg[STR_SIZE];        /* error message */
+    Espa_string_pool_t *pool = &compact->pool;  /* pool for the strings */
+    bool ok = true;               /* were all the strings interned? */
+    int i;                        /* looping variable */
+
+    memset (cband, 0, sizeof (Espa_compact_band_t));
+
+#define INTERN(field) \
+    ok = ok && (cband->field = intern_string (pool, bmeta->field)) != NULL
+    INTERN (product);
+    INTERN (source);
+    INTERN (name);
+    INTERN (category);
+    INTERN (short_name);
+    INTERN (long_name);
+    INTERN (file_name);
+    INTERN (footprint_file);
+    INTERN (overview_file);
+    INTERN (encoding);
+    INTERN (checksum);
+    INTERN (pixel_units);
+    INTERN (data_units);
+    INTERN (qa_desc);
+    INTERN (app_version);
+    INTERN (l1_filename);
+    INTERN (production_date);
+#undef INTERN
+
+    cband->data_type = bmeta->data_type;
+    cband->nlines = bmeta->nlines;
+    cband->nsamps = bmeta->nsamps;
+    cband->fill_value = bmeta->fill_value;
+    cband->saturate_value = bmeta->saturate_value;
+    cband->scale_factor = bmeta->scale_factor;
+    cband->add_offset = bmeta->add_offset;
+    cband->constant_value = bmeta->constant_value;
+    cband->overview_levels = bmeta->overview_levels;
+    cband->tile_size = bmeta->tile_size;
+    cband->file_offset = bmeta->file_offset;
+    cband->resample_method = bmeta->resample_method;
+    cband->pixel_size[0] = bmeta->pixel_size[0];
+    cband->pixel_size[1] = bmeta->pixel_size[1];
+    cband->valid_range[0] = bmeta->valid_range[0];
+    cband->valid_range[1] = bmeta->valid_range[1];
+    cband->stats = bmeta->stats;
+    cband->rad_gain = bmeta->rad_gain;
+    cband->rad_bias = bmeta->rad_bias;
+    cband->refl_gain = bmeta->refl_gain;
+    cband->refl_bias = bmeta->refl_bias;
+    cband->k1_const = bmeta->k1_const;
+    cband->k2_const = bmeta->k2_const;
+
+    if (ok && bmeta->nbits > 0)
+    {
+        cband->bitmap_description =
+            espa_arena_calloc (&pool->arena, bmeta->nbits,
+            sizeof (const char *));
+        ok = cband->bitmap_description != NULL;
+        for (i = 0; ok && i < bmeta->nbits; i++)
+        {
+            cband->bitmap_description[i] =
+                intern_string (pool, bmeta->bitmap_description[i]);
+            ok = cband->bitmap_description[i] != NULL;
+        }
+        cband->nbits = bmeta->nbits;
+    }
+
+    if (ok && bmeta->nclass > 0)
+    {
+        cband->class_values =
+            espa_arena_calloc (&pool->arena, bmeta->nclass,
+            sizeof (Espa_compact_class_t));
+        ok = cband->class_values != NULL;
+        for (i = 0; ok && i < bmeta->nclass; i++)
+        {
+#ifdef ESPA_USE_CPP_CLASS_VAL
+            cband->class_values[i].class_value =
+                bmeta->class_values[i].espa_class;
+#else
+            cband->class_values[i].class_value = bmeta->class_values[i].class;
+#endif
+            cband->class_values[i].description =
+                intern_string (pool, bmeta->class_values[i].description);
+            ok = cband->class_values[i].description != NULL;
+        }
+        cband->nclass = bmeta->nclass;
+    }
+
+    if (ok && bmeta->ncover > 0)
+    {
+        cband->percent_cover =
+            espa_arena_calloc (&pool->arena, bmeta->ncover,
+            sizeof (Espa_compact_cover_t));
+        ok = cband->percent_cover != NULL;
+        for (i = 0; ok && i < bmeta->ncover; i++)
+        {
+            cband->percent_cover[i].percent = bmeta->percent_cover[i].percent;
+            cband->percent_cover[i].description =
+                intern_string (pool, bmeta->percent_cover[i].description);
+            ok = cband->percent_cover[i].description != NULL;
+        }
+        cband->ncover = bmeta->ncover;
+    }
+
+    if (!ok)
+    {
+        sprintf (errmsg, "Compacting the metadata for band %s", bmeta->name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  compact_internal_metadata
+
+PURPOSE: Converts the metadata to its compact form.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error compacting the metadata
+SUCCESS         Successfully compacted the metadata
+
+NOTES:
+  1. The input metadata is not modified, and may be freed independently of
+     the compact metadata.
+******************************************************************************/
+int compact_internal_metadata
+(
+    Espa_internal_meta_t *xml_meta, /* I: metadata to be compacted */
+    Espa_compact_meta_t *compact  /* O: compact metadata; free with
+                                        free_compact_metadata */
+)
+{
+    char FUNC_NAME[] = "compact_internal_metadata";  /* function name */
+    char errmsg[STR_SIZE];        /* error message */
+    int i;                        /* looping variable */
+
+    init_compact_metadata (compact);
+    strcpy (compact->meta_namespace, xml_meta->meta_namespace);
+    compact->global = xml_meta->global;
+
+    compact->band = calloc (xml_meta->nbands + 1,
+        sizeof (Espa_compact_band_t));
+    if (compact->band == NULL)
+    {
+        sprintf (errmsg, "Allocating compact metadata for %d bands",
+            xml_meta->nbands);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    for (i = 0; i < xml_meta->nbands; i++)
+    {
+        if (compact_band_metadata (compact, &xml_meta->band[i],
+            &compact->band[i]) != SUCCESS)
+        {   /* Error messages already printed */
+            free_compact_metadata (compact);
+            return (ERROR);
+        }
+        compact->nbands++;
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  read_compact_metadata
+
+PURPOSE: Reads the metadata file directly into the compact metadata.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error reading, validating, or parsing the metadata file
+SUCCESS         Successfully read the metadata file
+
+NOTES:
+  1. Each band is decoded into a single scratch Espa_band_meta_t and then
+     compacted, so the full-size band metadata is never allocated for more
+     than one band at a time.
+  2. The global_metadata and bands elements are expected to be children of
+     the root element, as required by the ESPA schema.
+******************************************************************************/
+int read_compact_metadata
+(
+    char *metafile,               /* I: input metadata file or URL */
+    bool validate,                /* I: validate the metadata file against
+                                        the ESPA schema? */
+    Espa_compact_meta_t *compact  /* O: compact metadata; free with
+                                        free_compact_metadata */
+)
+{
+    char FUNC_NAME[] = "read_compact_metadata";  /* function name */
+    char errmsg[STR_SIZE];        /* error message */
+    xmlDocPtr doc = NULL;         /* document tree of the metadata file */
+    xmlNodePtr root = NULL;       /* root element of the document */
+    xmlNodePtr section = NULL;    /* current child of the root element */
+    xmlNodePtr node = NULL;       /* current element within the section */
+    xmlNsPtr ns = NULL;           /* namespace of the root element */
+    Espa_internal_meta_t scratch; /* metadata holding the current band */
+    int nbands;                   /* number of band elements */
+    int status = SUCCESS;         /* status of the read */
+    int count;                    /* number of chars copied in snprintf */
+
+    init_compact_metadata (compact);
+    init_metadata_struct (&scratch);
+
+    /* Load the XML file and parse it to the document tree.  Blank text nodes
+       are dropped to match the tree built by parse_metadata. */
+    doc = xmlReadFile (metafile, NULL, XML_PARSE_NOBLANKS);
+    if (doc == NULL)
+    {
+        sprintf (errmsg, "Could not parse %s", metafile);
+        error_handler (true, FUNC_NAME, errmsg);
+        cleanup_espa_xml ();
+        return (ERROR);
+    }
+
+    if (validate && validate_xml_doc (doc, metafile) != SUCCESS)
+    {
+        sprintf (errmsg, "Validating %s", metafile);
+        error_handler (true, FUNC_NAME, errmsg);
+        xmlFreeDoc (doc);
+        cleanup_espa_xml ();
+        return (ERROR);
+    }
+
+    /* Store the namespace for the overall metadata file */
+    root = xmlDocGetRootElement (doc);
+    if (root != NULL)
+        ns = get_node_namespace (root);
+    if (ns == NULL)
+    {
+        sprintf (errmsg, "Metadata document does not have a namespace");
+        error_handler (true, FUNC_NAME, errmsg);
+        xmlFreeDoc (doc);
+        cleanup_espa_xml ();
+        return (ERROR);
+    }
+    count = snprintf (compact->meta_namespace,
+        sizeof (compact->meta_namespace), "%s", (const char *) ns->href);
+    if (count < 0 || count >= sizeof (compact->meta_namespace))
+    {
+        sprintf (errmsg, "Overflow of metadata->meta_namespace string");
+        error_handler (true, FUNC_NAME, errmsg);
+        xmlFreeDoc (doc);
+        cleanup_espa_xml ();
+        return (ERROR);
+    }
+
+    for (section = xmlFirstElementChild (root); section && status == SUCCESS;
+         section = xmlNextElementSibling (section))
+    {
+        /* Parse the global metadata */
+        if (xmlStrEqual (section->name, (const xmlChar *) "global_metadata"))
+        {
+            for (node = xmlFirstElementChild (section); node;
+                 node = xmlNextElementSibling (node))
+            {
+                if (add_global_metadata (node, &compact->global))
+                {
+                    sprintf (errmsg, "Consuming global_metadata element "
+                        "'%s'.", node->name);
+                    error_handler (true, FUNC_NAME, errmsg);
+                    status = ERROR;
+                    break;
+                }
+            }
+        }
+
+        /* Decode and compact each band in turn */
+        else if (xmlStrEqual (section->name, (const xmlChar *) "bands") &&
+            compact->band == NULL)
+        {
+            nbands = 0;
+            for (node = xmlFirstElementChild (section); node;
+                 node = xmlNextElementSibling (node))
+            {
+                if (xmlStrEqual (node->name, (const xmlChar *) "band"))
+                    nbands++;
+            }
+
+            compact->band = calloc (nbands + 1, sizeof (Espa_compact_band_t));
+            if (compact->band == NULL)
+            {
+                sprintf (errmsg, "Allocating compact metadata for %d bands",
+                    nbands);
+                error_handler (true, FUNC_NAME, errmsg);
+                status = ERROR;
+                break;
+            }
+
+            for (node = xmlFirstElementChild (section); node;
+                 node = xmlNextElementSibling (node))
+            {
+                if (!xmlStrEqual (node->name, (const xmlChar *) "band"))
+                    continue;
+
+                if (allocate_band_metadata (&scratch, 1) != SUCCESS)
+                {   /* Error messages already printed */
+                    status = ERROR;
+                    break;
+                }
+                if (add_band_metadata (node, &scratch.band[0]))
+                {
+                    sprintf (errmsg, "Consuming band %d", compact->nbands);
+                    error_handler (true, FUNC_NAME, errmsg);
+                    status = ERROR;
+                }
+                else if (compact_band_metadata (compact, &scratch.band[0],
+                    &compact->band[compact->nbands]) != SUCCESS)
+                    status = ERROR;    /* Error messages already printed */
+                else
+                    compact->nbands++;
+
+                free_metadata (&scratch);
+                scratch.band = NULL;
+                scratch.nbands = 0;
+                if (status != SUCCESS)
+                    break;
+            }
+        }
+    }
+
+    xmlFreeDoc (doc);
+    cleanup_espa_xml ();
+    if (status != SUCCESS)
+        free_compact_metadata (compact);
+
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  find_compact_band
+
+PURPOSE: Finds a band in the compact metadata by name.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+-1              Band was not found
+>= 0            Index of the band in the compact metadata
+
+NOTES:
+  1. The first band matching the name (and product, if specified) is
+     returned.
+******************************************************************************/
+int find_compact_band
+(
+    Espa_compact_meta_t *compact, /* I: compact metadata */
+    const char *name,             /* I: name of the band (ex. b1) */
+    const char *product           /* I: product of the band; NULL for any */
+)
+{
+    int i;                        /* looping variable */
+
+    for (i = 0; i < compact->nbands; i++)
+    {
+        if (strcmp (compact->band[i].name, name) == 0 &&
+            (product == NULL ||
+             strcmp (compact->band[i].product, product) == 0))
+            return (i);
+    }
+
+    return (-1);
+}
+
+
+/******************************************************************************
+MODULE:  expand_compact_band
+
+PURPOSE: Expands a compact band into the legacy band metadata structure.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error allocating the band arrays or copying the strings
+SUCCESS         Successfully expanded the band
+
+NOTES:
+  1. Any bitmap, class, or cover arrays already in bmeta are not freed; bmeta
+     is expected to be freshly allocated (i.e. by allocate_band_metadata).
+******************************************************************************/
+int expand_compact_band
+(
+    const Espa_compact_band_t *cband, /* I: compact band metadata */
+    Espa_band_meta_t *bmeta       /* O: legacy band metadata; its bitmap,
+                                        class, and cover arrays are allocated
+                                        as by parse_metadata */
+)
+{
+    char FUNC_NAME[] = "expand_compact_band";  /* function name */
+    char errmsg[STR_SIZE];        /* error message */
+    bool ok = true;               /* were all the strings copied? */
+    int i;                        /* looping variable */
+    int count;                    /* number of chars copied in snprintf */
+
+#define EXPAND(field) \
+    count = snprintf (bmeta->field, sizeof (bmeta->field), "%s", \
+        cband->field); \
+    ok = ok && count >= 0 && count < sizeof (bmeta->field)
+    EXPAND (product);
+    EXPAND (source);
+    EXPAND (name);
+    EXPAND (category);
+    EXPAND (short_name);
+    EXPAND (long_name);
+    EXPAND (file_name);
+    EXPAND (footprint_file);
+    EXPAND (overview_file);
+    EXPAND (encoding);
+    EXPAND (checksum);
+    EXPAND (pixel_units);
+    EXPAND (data_units);
+    EXPAND (qa_desc);
+    EXPAND (app_version);
+    EXPAND (l1_filename);
+    EXPAND (production_date);
+#undef EXPAND
+    if (!ok)
+    {
+        sprintf (errmsg, "Overflow of a string in band %s", cband->name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    bmeta->data_type = cband->data_type;
+    bmeta->nlines = cband->nlines;
+    bmeta->nsamps = cband->nsamps;
+    bmeta->fill_value = cband->fill_value;
+    bmeta->saturate_value = cband->saturate_value;
+    bmeta->scale_factor = cband->scale_factor;
+    bmeta->add_offset = cband->add_offset;
+    bmeta->constant_value = cband->constant_value;
+    bmeta->overview_levels = cband->overview_levels;
+    bmeta->tile_size = cband->tile_size;
+    bmeta->file_offset = cband->file_offset;
+    bmeta->resample_method = cband->resample_method;
+    bmeta->pixel_size[0] = cband->pixel_size[0];
+    bmeta->pixel_size[1] = cband->pixel_size[1];
+    bmeta->valid_range[0] = cband->valid_range[0];
+    bmeta->valid_range[1] = cband->valid_range[1];
+    bmeta->stats = cband->stats;
+    bmeta->rad_gain = cband->rad_gain;
+    bmeta->rad_bias = cband->rad_bias;
+    bmeta->refl_gain = cband->refl_gain;
+    bmeta->refl_bias = cband->refl_bias;
+    bmeta->k1_const = cband->k1_const;
+    bmeta->k2_const = cband->k2_const;
+
+    if (cband->nbits > 0)
+    {
+        if (allocate_bitmap_metadata (bmeta, cband->nbits) != SUCCESS)
+            return (ERROR);    /* Error messages already printed */
+        for (i = 0; i < cband->nbits; i++)
+            snprintf (bmeta->bitmap_description[i], STR_SIZE, "%s",
+                cband->bitmap_description[i]);
+    }
+
+    if (cband->nclass > 0)
+    {
+        if (allocate_class_metadata (bmeta, cband->nclass) != SUCCESS)
+            return (ERROR);    /* Error messages already printed */
+        for (i = 0; i < cband->nclass; i++)
+        {
+#ifdef ESPA_USE_CPP_CLASS_VAL
+            bmeta->class_values[i].espa_class =
+                cband->class_values[i].class_value;
+#else
+            bmeta->class_values[i].class = cband->class_values[i].class_value;
+#endif
+            snprintf (bmeta->class_values[i].description, STR_SIZE, "%s",
+                cband->class_values[i].description);
+        }
+    }
+
+    if (cband->ncover > 0)
+    {
+        if (allocate_percent_coverage_metadata (bmeta, cband->ncover) !=
+            SUCCESS)
+            return (ERROR);    /* Error messages already printed */
+        for (i = 0; i < cband->ncover; i++)
+        {
+            bmeta->percent_cover[i].percent = cband->percent_cover[i].percent;
+            snprintf (bmeta->percent_cover[i].description, STR_SIZE, "%s",
+                cband->percent_cover[i].description);
+        }
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  expand_compact_metadata
+
+PURPOSE: Expands the compact metadata into the legacy internal metadata
+structure, as would have been produced by parse_metadata.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error expanding the metadata
+SUCCESS         Successfully expanded the metadata
+
+NOTES:
+  1. xml_meta is initialized by this routine and should be freed with
+     free_metadata, even on error.
+******************************************************************************/
+int expand_compact_metadata
+(
+    Espa_compact_meta_t *compact, /* I: compact metadata */
+    Espa_internal_meta_t *xml_meta  /* O: legacy metadata; free with
+                                          free_metadata */
+)
+{
+    int i;                        /* looping variable */
+
+    init_metadata_struct (xml_meta);
+    strcpy (xml_meta->meta_namespace, compact->meta_namespace);
+    xml_meta->global = compact->global;
+
+    if (allocate_band_metadata (xml_meta, compact->nbands) != SUCCESS)
+        return (ERROR);    /* Error messages already printed */
+
+    for (i = 0; i < compact->nbands; i++)
+    {
+        if (expand_compact_band (&compact->band[i], &xml_meta->band[i]) !=
+            SUCCESS)
+            return (ERROR);    /* Error messages already printed */
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  free_compact_metadata
+
+PURPOSE: Frees the bands and string pool of the compact metadata.
+
+RETURN VALUE: N/A
+
+NOTES:
+  1. The compact metadata is left with no bands and may be reused.
+******************************************************************************/
+void free_compact_metadata
+(
+    Espa_compact_meta_t *compact  /* I: compact metadata to be freed */
+)
+{
+    free (compact->band);
+    compact->band = NULL;
+    compact->nbands = 0;
+    free_string_pool (&compact->pool);
+}
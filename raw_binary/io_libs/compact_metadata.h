@@ -0,0 +1,190 @@
+/*****************************************************************************
+FILE: compact_metadata.h
+
+PURPOSE: Contains structures and prototypes for the compact form of the ESPA
+internal band metadata, where the band strings are interned in a shared
+string pool rather than held in fixed-size character arrays.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. Each Espa_band_meta_t carries over 40 KB of fixed-size strings, most of
+     which hold short values (or ESPA_STRING_META_FILL).  An
+     Espa_compact_band_t is a couple hundred bytes, and identical strings
+     (product, units, descriptions, fill) are stored once for all the bands.
+  2. All the strings and arrays of the compact bands live in the string pool
+     and remain valid until the compact metadata is freed.  They are not to
+     be modified or freed by the caller.
+  3. Callers which need the legacy structures can expand a single band, or
+     all the metadata, with expand_compact_band and expand_compact_metadata.
+*****************************************************************************/
+
+#ifndef COMPACT_METADATA_H
+#define COMPACT_METADATA_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include "error_handler.h"
+#include "espa_metadata.h"
+
+/* String pool, holding a single copy of each interned string */
+typedef struct
+{
+    Espa_meta_arena_t arena;      /* arena holding the strings and the band
+                                     arrays */
+    const char **slot;            /* hash table of the interned strings */
+    size_t nslots;                /* number of slots in the hash table (a
+                                     power of 2) */
+    size_t nstrings;              /* number of interned strings */
+} Espa_string_pool_t;
+
+typedef struct
+{
+    int class_value;              /* class value */
+    const char *description;      /* class description */
+} Espa_compact_class_t;
+
+typedef struct
+{
+    float percent;                /* percentage for the cover type */
+    const char *description;      /* cover type description */
+} Espa_compact_cover_t;
+
+/* Band metadata; see Espa_band_meta_t for the description of each field */
+typedef struct
+{
+    const char *product;
+    const char *source;
+    const char *name;
+    const char *category;
+    enum Espa_data_type data_type;
+    int nlines;
+    int nsamps;
+    long fill_value;
+    int saturate_value;
+    float scale_factor;
+    float add_offset;
+    double constant_value;
+    const char *footprint_file;
+    const char *overview_file;
+    int overview_levels;
+    const char *encoding;
+    int tile_size;
+    long file_offset;
+    const char *checksum;
+    enum Espa_resampling_type resample_method;
+    const char *short_name;
+    const char *long_name;
+    const char *file_name;
+    double pixel_size[2];
+    const char *pixel_units;
+    const char *data_units;
+    double valid_range[2];
+    Espa_band_stats_t stats;
+    double rad_gain;
+    double rad_bias;
+    double refl_gain;
+    double refl_bias;
+    double k1_const;
+    double k2_const;
+    int nbits;
+    const char **bitmap_description;
+    int nclass;
+    Espa_compact_class_t *class_values;
+    int ncover;
+    Espa_compact_cover_t *percent_cover;
+    const char *qa_desc;
+    const char *app_version;
+    const char *l1_filename;
+    const char *production_date;
+} Espa_compact_band_t;
+
+/* Compact form of the ESPA internal metadata */
+typedef struct
+{
+    char meta_namespace[STR_SIZE];  /* namespace for this metadata file */
+    Espa_global_meta_t global;      /* global metadata */
+    int nbands;                     /* number of bands in the metadata */
+    Espa_compact_band_t *band;      /* array of compact band metadata */
+    Espa_string_pool_t pool;        /* strings and arrays of the bands */
+} Espa_compact_meta_t;
+
+/* Prototypes */
+void init_string_pool
+(
+    Espa_string_pool_t *pool      /* I: string pool to be initialized */
+);
+
+const char *intern_string
+(
+    Espa_string_pool_t *pool,     /* I: string pool */
+    const char *str               /* I: string to be interned */
+);
+
+void free_string_pool
+(
+    Espa_string_pool_t *pool      /* I: string pool to be freed */
+);
+
+void init_compact_metadata
+(
+    Espa_compact_meta_t *compact  /* I: compact metadata to be initialized */
+);
+
+int compact_band_metadata
+(
+    Espa_compact_meta_t *compact, /* I: compact metadata whose pool holds the
+                                        strings of the band */
+    const Espa_band_meta_t *bmeta,  /* I: band metadata to be compacted */
+    Espa_compact_band_t *cband    /* O: compact band metadata */
+);
+
+int compact_internal_metadata
+(
+    Espa_internal_meta_t *xml_meta, /* I: metadata to be compacted */
+    Espa_compact_meta_t *compact  /* O: compact metadata; free with
+                                        free_compact_metadata */
+);
+
+int read_compact_metadata
+(
+    char *metafile,               /* I: input metadata file or URL */
+    bool validate,                /* I: validate the metadata file against
+                                        the ESPA schema? */
+    Espa_compact_meta_t *compact  /* O: compact metadata; free with
+                                        free_compact_metadata */
+);
+
+int find_compact_band
+(
+    Espa_compact_meta_t *compact, /* I: compact metadata */
+    const char *name,             /* I: name of the band (ex. b1) */
+    const char *product           /* I: product of the band; NULL for any */
+);
+
+int expand_compact_band
+(
+    const Espa_compact_band_t *cband, /* I: compact band metadata */
+    Espa_band_meta_t *bmeta       /* O: legacy band metadata; its bitmap,
+                                        class, and cover arrays are allocated
+                                        as by parse_metadata */
+);
+
+int expand_compact_metadata
+(
+    Espa_compact_meta_t *compact, /* I: compact metadata */
+    Espa_internal_meta_t *xml_meta  /* O: legacy metadata; free with
+                                          free_metadata */
+);
+
+void free_compact_metadata
+(
+    Espa_compact_meta_t *compact  /* I: compact metadata to be freed */
+);
+
+#endif
@@ -11,7 +11,67 @@ LICENSE TYPE:  NASA Open Source Agreement Version 1.3
 NOTES:
 *****************************************************************************/
 
+#include <limits.h>
+#include <ctype.h>
+#include <strings.h>
 #include "envi_header.h"
+#include "espa_remote.h"
+#include "espa_upload.h"
+
+/******************************************************************************
+MODULE:  upload_envi_hdr
+
+PURPOSE:  Uploads an ENVI header, written to a temporary file, to the remote
+file named by its URL.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           An error occurred uploading the header file
+SUCCESS         Header file was uploaded
+
+NOTES:
+  1. The temporary file is closed, which removes it.
+******************************************************************************/
+static int upload_envi_hdr
+(
+    FILE *hdr_fptr,     /* I: temporary file holding the ENVI header */
+    char *hdr_file      /* I: URL of the ENVI header file */
+)
+{
+    char FUNC_NAME[] = "upload_envi_hdr";   /* function name */
+    char errmsg[STR_SIZE];        /* error message */
+    char buf[STR_SIZE];           /* bytes of the header */
+    size_t nread;                 /* number of bytes read */
+    int status = SUCCESS;         /* status of the upload */
+    Espa_upload_t *upload = NULL; /* remote header file */
+
+    upload = open_espa_upload (hdr_file);
+    if (upload == NULL)
+        status = ERROR;
+    rewind (hdr_fptr);
+    while (status == SUCCESS &&
+        (nread = fread (buf, 1, sizeof (buf), hdr_fptr)) > 0)
+        status = write_espa_upload (upload, buf, nread);
+    if (status == SUCCESS && ferror (hdr_fptr))
+        status = ERROR;
+    fclose (hdr_fptr);
+
+    if (status == SUCCESS)
+        status = close_espa_upload (upload);
+    else
+        abort_espa_upload (upload);
+    if (status != SUCCESS)
+    {
+        sprintf (errmsg, "Uploading the ENVI header %s", hdr_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
 
 /******************************************************************************
 MODULE:  write_envi_hdr
@@ -38,6 +98,8 @@ NOTES:
      NAD83: GEOGCS["GCS_North_American_1983",DATUM["D_North_American_1983",SPHEROID["GRS_1980",6378137.0,298.257222101]],PRIMEM["Greenwich",0.0],UNIT["Degree",0.0174532925199433]]
   5. The strings for various projections and datums are in the ENVI application
      documents at IDLXX/resource/pedata/predefined/{EnviPEGeogcsStrings.txt|EnviPEProjcsStrings.txt}
+  6. A header named by a URL is written to a temporary file and uploaded
+     (see espa_upload.h), for bands written to object storage.
 ******************************************************************************/
 int write_envi_hdr
 (
@@ -62,7 +124,10 @@ int write_envi_hdr
     FILE *hdr_fptr = NULL;        /* file pointer to the ENVI header file */
 
     /* Open the header file */
-    hdr_fptr = fopen (hdr_file, "w");
+    if (is_remote_file (hdr_file))
+        hdr_fptr = tmpfile ();
+    else
+        hdr_fptr = fopen (hdr_file, "w");
     if (hdr_fptr == NULL)
     {
         sprintf (errmsg, "Opening %s for write access.", hdr_file);
@@ -172,7 +237,11 @@ int write_envi_hdr
         "sensor_type = %s\n",
         hdr->interleave, hdr->sensor_type);
    
-    if (hdr->proj_type == GCTP_GEO_PROJ)
+    if (!hdr->map_info)
+    {
+        /* No map location to describe */
+    }
+    else if (hdr->proj_type == GCTP_GEO_PROJ)
     {
         fprintf (hdr_fptr,
             "map info = {Geographic Lat/Lon, %d, %d, %f, %f, %g, %g, %s, "
@@ -346,6 +415,8 @@ int write_envi_hdr
     fprintf (hdr_fptr, "}\n");
 
     /* Close the header file */
+    if (is_remote_file (hdr_file))
+        return (upload_envi_hdr (hdr_fptr, hdr_file));
     fclose (hdr_fptr);
 
     /* Successful completion */
@@ -394,6 +465,7 @@ int create_envi_struct
     hdr->byte_order = 0;  /* assume Linux systems -- if Windows switch to 1 */
     strcpy (hdr->file_type, "ENVI Standard");
     strcpy (hdr->interleave, "BSQ");
+    hdr->map_info = true;
     count = snprintf (hdr->sensor_type, sizeof (hdr->sensor_type), "%s %s",
         gmeta->satellite, gmeta->instrument);
     if (count < 0 || count >= sizeof (hdr->sensor_type))
@@ -512,3 +584,540 @@ int create_envi_struct
     return (SUCCESS);
 }
 
+
+
+/******************************************************************************
+MODULE:  envi_to_espa_data_type
+
+PURPOSE:  Converts an ENVI data type to the ESPA data type.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           The ENVI data type has no ESPA data type
+SUCCESS         Successfully converted the data type
+
+NOTES:
+  1. The 8-bit ENVI byte is unsigned.  The complex and 64-bit integer ENVI
+     data types aren't supported.
+******************************************************************************/
+int envi_to_espa_data_type
+(
+    int envi_data_type,               /* I: ENVI data type */
+    enum Espa_data_type *data_type    /* O: ESPA data type */
+)
+{
+    switch (envi_data_type)
+    {
+        case 1: *data_type = ESPA_UINT8; break;
+        case 2: *data_type = ESPA_INT16; break;
+        case 3: *data_type = ESPA_INT32; break;
+        case 4: *data_type = ESPA_FLOAT32; break;
+        case 5: *data_type = ESPA_FLOAT64; break;
+        case 12: *data_type = ESPA_UINT16; break;
+        case 13: *data_type = ESPA_UINT32; break;
+        default: return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  trim_envi_value
+
+PURPOSE:  Trims the blanks around a value of the ENVI header.
+
+RETURN VALUE:
+Type = char *
+Value           Description
+-----           -----------
+value           First non-blank character of the value
+
+NOTES:
+  1. The trailing blanks are removed in place.
+******************************************************************************/
+static char *trim_envi_value
+(
+    char *value         /* I/O: value to be trimmed */
+)
+{
+    char *end = NULL;   /* last character of the value */
+
+    value += strspn (value, " \t\r\n");
+    end = value + strlen (value);
+    while (end > value && strchr (" \t\r\n", end[-1]) != NULL)
+        end--;
+    *end = '\0';
+
+    return (value);
+}
+
+
+/******************************************************************************
+MODULE:  split_envi_list
+
+PURPOSE:  Splits a comma-separated value of the ENVI header into its fields.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+n               Number of fields, up to max_fields
+
+NOTES:
+  1. The value is modified.  Fields beyond max_fields are dropped.
+******************************************************************************/
+static int split_envi_list
+(
+    char *value,        /* I/O: comma-separated value, without the braces */
+    char **fields,      /* O: trimmed fields of the value */
+    int max_fields      /* I: most fields to return */
+)
+{
+    char *save = NULL;  /* position of strtok_r in the value */
+    char *field = NULL; /* current field */
+    int nfields = 0;    /* number of fields */
+
+    for (field = strtok_r (value, ",", &save);
+         field != NULL && nfields < max_fields;
+         field = strtok_r (NULL, ",", &save))
+        fields[nfields++] = trim_envi_value (field);
+
+    return (nfields);
+}
+
+
+/******************************************************************************
+MODULE:  envi_number
+
+PURPOSE:  Reads a number from a field of the ENVI header.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           The field isn't a number
+SUCCESS         Successfully read the number
+
+NOTES:
+******************************************************************************/
+static int envi_number
+(
+    char *field,        /* I: field of the header */
+    double *number      /* O: number in the field */
+)
+{
+    char *end = NULL;   /* end of the number in the field */
+
+    *number = strtod (field, &end);
+    if (end == field || *trim_envi_value (end) != '\0')
+        return (ERROR);
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  envi_datum
+
+PURPOSE:  Converts the datum name of the map info in the ENVI header to the
+ESPA datum.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           The datum isn't supported
+SUCCESS         Successfully converted the datum
+
+NOTES:
+  1. The names are those written by write_envi_hdr.
+******************************************************************************/
+static int envi_datum
+(
+    const char *name,   /* I: datum name */
+    int *datum_type     /* O: ESPA datum */
+)
+{
+    if (!strcasecmp (name, "WGS-84"))
+        *datum_type = ESPA_WGS84;
+    else if (!strcasecmp (name, "North America 1927"))
+        *datum_type = ESPA_NAD27;
+    else if (!strcasecmp (name, "North America 1983"))
+        *datum_type = ESPA_NAD83;
+    else
+        return (ERROR);
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  parse_envi_map_info
+
+PURPOSE:  Parses the map info and projection info of the ENVI header into
+the projection of the header structure.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           The map info is invalid
+SUCCESS         Successfully parsed the map info, or the projection isn't
+                supported (map_info is then left false)
+
+NOTES:
+  1. The GEO, UTM, ALBERS, PS, and SIN projections written by write_envi_hdr
+     are supported.  The parameters of the ALBERS, PS, and SIN projections
+     are taken from the projection info.
+  2. The UL corner is moved to the UL corner of the first pixel, so
+     xy_start is always 1, 1 (the reference pixel of the map info may be any
+     pixel, with 1.5, 1.5 the center of the first pixel).
+******************************************************************************/
+static int parse_envi_map_info
+(
+    char *map_info,     /* I/O: value of the map info */
+    char *proj_info,    /* I/O: value of the projection info; NULL if none */
+    char *hdr_file,     /* I: name of the header, for messages */
+    Envi_header_t *hdr  /* I/O: ENVI header information */
+)
+{
+    char FUNC_NAME[] = "parse_envi_map_info";   /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    char *fields[16];        /* fields of the map info */
+    char *pfields[16];       /* fields of the projection info */
+    int nfields;             /* number of fields in the map info */
+    int npfields = 0;        /* number of fields in the projection info */
+    int i;                   /* looping variable */
+    int datum_field = 7;     /* field of the map info with the datum */
+    double ref[2];           /* reference pixel of the map info */
+    double number;           /* number read from a field */
+    double parms[9];         /* numbers of the projection info; the first is
+                                the ENVI projection number */
+
+    nfields = split_envi_list (map_info, fields, 16);
+    if (nfields < 7)
+    {
+        sprintf (errmsg, "Too few fields in the map info of %s", hdr_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    for (i = 1; i < 7; i++)
+    {
+        if (envi_number (fields[i], &number) != SUCCESS)
+        {
+            sprintf (errmsg, "Invalid map info field %s in %s", fields[i],
+                hdr_file);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+        if (i < 3)
+            ref[i-1] = number;
+        else if (i < 5)
+            hdr->ul_corner[i-3] = number;
+        else
+            hdr->pixel_size[i-5] = number;
+    }
+    hdr->ul_corner[0] -= (ref[0] - 1.0) * hdr->pixel_size[0];
+    hdr->ul_corner[1] += (ref[1] - 1.0) * hdr->pixel_size[1];
+    hdr->xy_start[0] = hdr->xy_start[1] = 1;
+
+    if (proj_info != NULL)
+    {
+        npfields = split_envi_list (proj_info, pfields, 16);
+        for (i = 0; i < npfields && i < 9; i++)
+            if (envi_number (pfields[i], &parms[i]) != SUCCESS)
+                break;
+        npfields = i;
+    }
+
+    for (i = 0; i < 15; i++)
+        hdr->proj_parms[i] = 0.0;
+    hdr->datum_type = ESPA_NODATUM;
+    if (!strcasecmp (fields[0], "Geographic Lat/Lon"))
+        hdr->proj_type = GCTP_GEO_PROJ;
+    else if (!strcasecmp (fields[0], "UTM"))
+    {
+        if (nfields < 9 || envi_number (fields[7], &number) != SUCCESS ||
+            number < 1 || number > 60)
+        {
+            sprintf (errmsg, "Invalid UTM zone in the map info of %s",
+                hdr_file);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+        hdr->proj_type = GCTP_UTM_PROJ;
+        hdr->utm_zone = !strcasecmp (fields[8], "South") ? -(int) number :
+            (int) number;
+        datum_field = 9;
+    }
+    else if (!strcasecmp (fields[0], "Albers Conical Equal Area") &&
+        npfields >= 9 && (int) parms[0] == ENVI_ALBERS_PROJ)
+    {
+        hdr->proj_type = GCTP_ALBERS_PROJ;
+        hdr->proj_parms[5] = parms[3];
+        hdr->proj_parms[4] = parms[4];
+        hdr->proj_parms[6] = parms[5];
+        hdr->proj_parms[7] = parms[6];
+        hdr->proj_parms[2] = parms[7];
+        hdr->proj_parms[3] = parms[8];
+    }
+    else if (!strcasecmp (fields[0], "Polar Stereographic") &&
+        npfields >= 7 && (int) parms[0] == ENVI_PS_PROJ)
+    {
+        hdr->proj_type = GCTP_PS_PROJ;
+        hdr->proj_parms[5] = parms[3];
+        hdr->proj_parms[4] = parms[4];
+        hdr->proj_parms[6] = parms[5];
+        hdr->proj_parms[7] = parms[6];
+    }
+    else if (!strcasecmp (fields[0], "Sinusoidal") &&
+        npfields >= 5 && (int) parms[0] == ENVI_SIN_PROJ)
+    {
+        hdr->proj_type = GCTP_SIN_PROJ;
+        hdr->proj_parms[0] = parms[1];
+        hdr->proj_parms[4] = parms[2];
+        hdr->proj_parms[6] = parms[3];
+        hdr->proj_parms[7] = parms[4];
+        datum_field = 0;
+    }
+    else
+    {
+        sprintf (errmsg, "Unsupported map info (%s) in %s; the map location "
+            "is ignored", fields[0], hdr_file);
+        error_handler (false, FUNC_NAME, errmsg);
+        return (SUCCESS);
+    }
+
+    if (datum_field > 0 && (nfields <= datum_field ||
+        envi_datum (fields[datum_field], &hdr->datum_type) != SUCCESS))
+    {
+        sprintf (errmsg, "Unsupported datum (%s) in the map info of %s",
+            nfields > datum_field ? fields[datum_field] : "none", hdr_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    hdr->map_info = true;
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  read_envi_hdr
+
+PURPOSE:  Reads an ENVI header file into the ENVI header structure.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           An error occurred reading the header file
+SUCCESS         Header file was read successfully
+
+NOTES:
+  1. The header is a set of "key = value" lines, with the values of lists
+     in braces, which may span several lines.  The keys read are those
+     written by write_envi_hdr (samples, lines, bands, header offset, byte
+     order, file type, data type, interleave, data ignore value, sensor
+     type, band names, and the map and projection info); others are
+     skipped.
+  2. samples, lines, bands, and data type are required.  The interleave
+     defaults to BSQ and the byte order to 0 (Intel).
+  3. map_info is only set if the header has a map info of a supported
+     projection (see parse_envi_map_info).  Band names are set for the
+     first MAX_ENVI_BANDS bands listed; the others are left empty.
+******************************************************************************/
+int read_envi_hdr
+(
+    char *hdr_file,     /* I: name of ENVI header file to be read */
+    Envi_header_t *hdr  /* O: ENVI header information */
+)
+{
+    char FUNC_NAME[] = "read_envi_hdr";   /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    char *buf = NULL;        /* contents of the header file */
+    size_t buf_size = 0;     /* size of the contents buffer */
+    char *cptr = NULL;       /* current position in the header */
+    char *key = NULL;        /* key of the current entry */
+    char *value = NULL;      /* value of the current entry */
+    char *end = NULL;        /* end of the current entry */
+    char *map_info = NULL;   /* value of the map info */
+    char *proj_info = NULL;  /* value of the projection info */
+    char *names[MAX_ENVI_BANDS]; /* band names */
+    int nnames;              /* number of band names */
+    int *ivalue = NULL;      /* integer field of the entry */
+    int i;                   /* looping variable */
+    long number;             /* integer value of the entry */
+    double dvalue;           /* floating point value of the entry */
+    bool braces;             /* is the value in braces? */
+    FILE *hdr_fptr = NULL;   /* file pointer to the ENVI header file */
+
+    memset (hdr, 0, sizeof (Envi_header_t));
+    hdr->data_ignore_value = ESPA_INT_META_FILL;
+    hdr->proj_type = ESPA_INT_META_FILL;
+    hdr->datum_type = ESPA_NODATUM;
+    hdr->xy_start[0] = hdr->xy_start[1] = 1;
+    strcpy (hdr->interleave, "BSQ");
+
+    /* Read the whole header */
+    hdr_fptr = fopen (hdr_file, "r");
+    if (hdr_fptr == NULL)
+    {
+        sprintf (errmsg, "Opening %s for read access.", hdr_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    if (getdelim (&buf, &buf_size, '\0', hdr_fptr) == -1 ||
+        strncmp (buf, "ENVI", 4))
+    {
+        sprintf (errmsg, "%s is not an ENVI header file.", hdr_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        free (buf);
+        fclose (hdr_fptr);
+        return (ERROR);
+    }
+    fclose (hdr_fptr);
+
+    /* Loop through the entries of the header */
+    cptr = buf + 4;
+    while (*(cptr += strspn (cptr, " \t\r\n")) != '\0')
+    {
+        end = cptr + strcspn (cptr, "\r\n");
+        value = memchr (cptr, '=', end - cptr);
+        if (value == NULL)
+        {   /* Not an entry; skip the line */
+            cptr = end;
+            continue;
+        }
+        key = cptr;
+        *value++ = '\0';
+        key = trim_envi_value (key);
+
+        value += strspn (value, " \t");
+        braces = *value == '{';
+        if (braces)
+        {
+            end = strchr (++value, '}');
+            if (end == NULL)
+            {
+                sprintf (errmsg, "Missing } for the %s of %s", key,
+                    hdr_file);
+                error_handler (true, FUNC_NAME, errmsg);
+                free (buf);
+                return (ERROR);
+            }
+        }
+        cptr = *end != '\0' ? end + 1 : end;
+        *end = '\0';
+        value = trim_envi_value (value);
+
+        /* Integer fields */
+        ivalue = NULL;
+        if (!strcasecmp (key, "samples"))
+            ivalue = &hdr->nsamps;
+        else if (!strcasecmp (key, "lines"))
+            ivalue = &hdr->nlines;
+        else if (!strcasecmp (key, "bands"))
+            ivalue = &hdr->nbands;
+        else if (!strcasecmp (key, "header offset"))
+            ivalue = &hdr->header_offset;
+        else if (!strcasecmp (key, "byte order"))
+            ivalue = &hdr->byte_order;
+        else if (!strcasecmp (key, "data type"))
+            ivalue = &hdr->data_type;
+        if (ivalue != NULL)
+        {
+            number = strtol (value, &end, 10);
+            if (end == value || *end != '\0' || number < 0 ||
+                number > INT_MAX)
+            {
+                sprintf (errmsg, "Invalid %s in %s: %s", key, hdr_file,
+                    value);
+                error_handler (true, FUNC_NAME, errmsg);
+                free (buf);
+                return (ERROR);
+            }
+            *ivalue = (int) number;
+        }
+
+        /* Text and list fields */
+        else if (!strcasecmp (key, "description"))
+            snprintf (hdr->description, sizeof (hdr->description), "%s",
+                value);
+        else if (!strcasecmp (key, "file type"))
+            snprintf (hdr->file_type, sizeof (hdr->file_type), "%s", value);
+        else if (!strcasecmp (key, "sensor type") ||
+            !strcasecmp (key, "sensor_type"))
+            snprintf (hdr->sensor_type, sizeof (hdr->sensor_type), "%s",
+                value);
+        else if (!strcasecmp (key, "interleave"))
+        {
+            if (strcasecmp (value, "BSQ") && strcasecmp (value, "BIL") &&
+                strcasecmp (value, "BIP"))
+            {
+                sprintf (errmsg, "Invalid interleave in %s: %s", hdr_file,
+                    value);
+                error_handler (true, FUNC_NAME, errmsg);
+                free (buf);
+                return (ERROR);
+            }
+            for (i = 0; i < 3; i++)
+                hdr->interleave[i] = toupper ((unsigned char) value[i]);
+            hdr->interleave[3] = '\0';
+        }
+        else if (!strcasecmp (key, "data ignore value"))
+        {
+            if (envi_number (value, &dvalue) != SUCCESS)
+            {
+                sprintf (errmsg, "Invalid data ignore value in %s: %s",
+                    hdr_file, value);
+                error_handler (true, FUNC_NAME, errmsg);
+                free (buf);
+                return (ERROR);
+            }
+            hdr->data_ignore_value = (long) dvalue;
+        }
+        else if (!strcasecmp (key, "band names"))
+        {
+            nnames = split_envi_list (value, names, MAX_ENVI_BANDS);
+            for (i = 0; i < nnames; i++)
+                snprintf (hdr->band_names[i], sizeof (hdr->band_names[i]),
+                    "%s", names[i]);
+        }
+        else if (!strcasecmp (key, "map info"))
+            map_info = value;
+        else if (!strcasecmp (key, "projection info"))
+            proj_info = value;
+    }
+
+    if (hdr->nsamps < 1 || hdr->nlines < 1 || hdr->nbands < 1 ||
+        hdr->data_type < 1)
+    {
+        sprintf (errmsg, "The samples, lines, bands, and data type are "
+            "required in %s", hdr_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        free (buf);
+        return (ERROR);
+    }
+    if (hdr->byte_order > 1)
+    {
+        sprintf (errmsg, "Invalid byte order in %s: %d", hdr_file,
+            hdr->byte_order);
+        error_handler (true, FUNC_NAME, errmsg);
+        free (buf);
+        return (ERROR);
+    }
+
+    if (map_info != NULL &&
+        parse_envi_map_info (map_info, proj_info, hdr_file, hdr) != SUCCESS)
+    {  /* Error messages already written */
+        free (buf);
+        return (ERROR);
+    }
+
+    free (buf);
+    return (SUCCESS);
+}
@@ -71,10 +71,25 @@ typedef struct {
                                coords; usually 1, 1 */
     char band_names[MAX_ENVI_BANDS][STR_SIZE];  /* array of band names;
                                size is nbands */
+    bool map_info;          /* should the map info be written?  false for
+                               files with no single map location, such as a
+                               stack of tiles */
 } Envi_header_t;
 
 
 /* Prototypes */
+int read_envi_hdr
+(
+    char *hdr_file,     /* I: name of ENVI header file to be read */
+    Envi_header_t *hdr  /* O: ENVI header information */
+);
+
+int envi_to_espa_data_type
+(
+    int envi_data_type,               /* I: ENVI data type */
+    enum Espa_data_type *data_type    /* O: ESPA data type */
+);
+
 int write_envi_hdr
 (
     char *hdr_file,     /* I: name of ENVI header file to be generated */
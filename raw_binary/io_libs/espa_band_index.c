@@ -0,0 +1,352 @@
+/*****************************************************************************
+FILE: espa_band_index.c
+
+PURPOSE: Contains functions for building and searching the band index of
+the ESPA internal metadata.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. See espa_band_index.h.  The hash tables are open addressed with linear
+     probing, and have at least twice as many slots as bands.
+*****************************************************************************/
+#include "espa_band_index.h"
+#include "espa_hash.h"
+
+/******************************************************************************
+MODULE:  band_field
+
+PURPOSE: Returns the product, source, or category of a band.
+
+RETURN VALUE:
+Type = const char *
+Value           Description
+-----           -----------
+string          Value of the field of the band
+******************************************************************************/
+static const char *band_field
+(
+    const Espa_band_meta_t *bmeta,  /* I: metadata of the band */
+    Espa_band_field_t field         /* I: field of the band */
+)
+{
+    switch (field)
+    {
+        case ESPA_BAND_PRODUCT: return (bmeta->product);
+        case ESPA_BAND_SOURCE: return (bmeta->source);
+        default: return (bmeta->category);
+    }
+}
+
+
+/******************************************************************************
+MODULE:  find_slot
+
+PURPOSE: Finds the slot of a hash table holding the bands with a string, or
+the empty slot where they would go.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+slot            Slot of the string; an empty slot if no band has it
+
+NOTES:
+  1. The strings of the bands are the names when field is -1, and
+     otherwise the given field.
+******************************************************************************/
+static int find_slot
+(
+    const Espa_band_meta_t *band,   /* I: band array of the index */
+    const int *slots,               /* I: hash table */
+    int nslots,                     /* I: number of slots (a power of two) */
+    int field,                      /* I: field of the strings; -1 for the
+                                          names */
+    const char *value               /* I: string to be found */
+)
+{
+    int slot;                       /* current slot */
+    const char *str;                /* string of the band in the slot */
+
+    slot = (int) (espa_hash_fnv1a_string (value) & (uint64_t) (nslots - 1));
+    while (slots[slot] >= 0)
+    {
+        str = (field < 0) ? band[slots[slot]].name :
+            band_field (&band[slots[slot]], field);
+        if (!strcmp (str, value))
+            break;
+        slot = (slot + 1) & (nslots - 1);
+    }
+
+    return (slot);
+}
+
+
+/******************************************************************************
+MODULE:  free_espa_band_index
+
+PURPOSE: Frees the band index of the metadata.
+
+RETURN VALUE:
+Type = None
+******************************************************************************/
+void free_espa_band_index
+(
+    Espa_internal_meta_t *metadata  /* I/O: metadata whose band index is
+                                            freed */
+)
+{
+    struct espa_band_index *index = metadata->band_index; /* band index */
+    int field;                      /* looping variable for the fields */
+
+    if (index == NULL)
+        return;
+
+    free (index->name_slot);
+    for (field = 0; field < ESPA_BAND_NFIELDS; field++)
+    {
+        free (index->field_slot[field]);
+        free (index->field_next[field]);
+    }
+    free (index);
+    metadata->band_index = NULL;
+}
+
+
+/******************************************************************************
+MODULE:  build_espa_band_index
+
+PURPOSE: Builds the band index of the metadata, replacing any previous one.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error allocating memory for the index
+SUCCESS         Successfully built the index
+
+NOTES:
+  1. Without an index the lookups fall back to a loop over the bands, so a
+     failure here is reported as a warning.
+******************************************************************************/
+int build_espa_band_index
+(
+    Espa_internal_meta_t *metadata  /* I/O: metadata whose bands are
+                                            indexed */
+)
+{
+    char FUNC_NAME[] = "build_espa_band_index";  /* function name */
+    char errmsg[STR_SIZE];          /* error message */
+    struct espa_band_index *index = NULL;  /* new band index */
+    int *last[ESPA_BAND_NFIELDS] = {NULL}; /* last band chained so far for
+                                      each slot of each field */
+    const Espa_band_meta_t *band = metadata->band;  /* band array */
+    int nslots = 16;                /* number of slots in the tables */
+    int field;                      /* looping variable for the fields */
+    int slot;                       /* slot of the current band */
+    int i;                          /* looping variable for the bands */
+    bool ok;                        /* were the tables allocated? */
+
+    free_espa_band_index (metadata);
+
+    while (nslots < 2 * metadata->nbands)
+        nslots *= 2;
+
+    index = calloc (1, sizeof (struct espa_band_index));
+    ok = (index != NULL);
+    if (ok)
+    {
+        index->band = band;
+        index->nbands = metadata->nbands;
+        index->nslots = nslots;
+        index->name_slot = malloc (nslots * sizeof (int));
+        ok = (index->name_slot != NULL);
+        for (field = 0; field < ESPA_BAND_NFIELDS; field++)
+        {
+            index->field_slot[field] = malloc (nslots * sizeof (int));
+            index->field_next[field] = malloc ((metadata->nbands + 1) *
+                sizeof (int));
+            last[field] = malloc (nslots * sizeof (int));
+            ok = ok && index->field_slot[field] != NULL &&
+                index->field_next[field] != NULL && last[field] != NULL;
+        }
+    }
+    if (!ok)
+    {
+        sprintf (errmsg, "Allocating memory for the band index; the bands "
+            "will be searched one by one");
+        error_handler (false, FUNC_NAME, errmsg);
+        metadata->band_index = index;
+        free_espa_band_index (metadata);
+        for (field = 0; field < ESPA_BAND_NFIELDS; field++)
+            free (last[field]);
+        return (ERROR);
+    }
+
+    /* Fill the tables in band order, so each name keeps its first band and
+       each chain runs in band order */
+    memset (index->name_slot, -1, nslots * sizeof (int));
+    for (field = 0; field < ESPA_BAND_NFIELDS; field++)
+        memset (index->field_slot[field], -1, nslots * sizeof (int));
+
+    for (i = 0; i < metadata->nbands; i++)
+    {
+        slot = find_slot (band, index->name_slot, nslots, -1, band[i].name);
+        if (index->name_slot[slot] < 0)
+            index->name_slot[slot] = i;
+
+        for (field = 0; field < ESPA_BAND_NFIELDS; field++)
+        {
+            index->field_next[field][i] = -1;
+            slot = find_slot (band, index->field_slot[field], nslots, field,
+                band_field (&band[i], field));
+            if (index->field_slot[field][slot] < 0)
+                index->field_slot[field][slot] = i;
+            else
+                index->field_next[field][last[field][slot]] = i;
+            last[field][slot] = i;
+        }
+    }
+
+    for (field = 0; field < ESPA_BAND_NFIELDS; field++)
+        free (last[field]);
+    metadata->band_index = index;
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  current_band_index
+
+PURPOSE: Returns the band index of the metadata, building it if there isn't
+one for the current band array.
+
+RETURN VALUE:
+Type = const struct espa_band_index *
+Value           Description
+-----           -----------
+NULL            The index couldn't be built
+non-NULL        Band index of the metadata
+******************************************************************************/
+static const struct espa_band_index *current_band_index
+(
+    Espa_internal_meta_t *metadata  /* I/O: metadata of the bands */
+)
+{
+    const struct espa_band_index *index = metadata->band_index;
+
+    if (index == NULL || index->band != metadata->band ||
+        index->nbands != metadata->nbands)
+    {
+        if (build_espa_band_index (metadata) != SUCCESS)
+            return (NULL);
+        index = metadata->band_index;
+    }
+
+    return (index);
+}
+
+
+/******************************************************************************
+MODULE:  espa_find_band
+
+PURPOSE: Finds a band of the metadata by name.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+-1              No band has the name
+>= 0            Index of the first band with the name
+
+NOTES:
+  1. See espa_band_index.h for bands renamed in place.
+******************************************************************************/
+int espa_find_band
+(
+    Espa_internal_meta_t *metadata, /* I/O: metadata of the bands (the index
+                                            is built if needed) */
+    const char *name                /* I: name of the band */
+)
+{
+    const struct espa_band_index *index;  /* band index */
+    int band;                       /* band found */
+    int i;                          /* looping variable for the bands */
+
+    index = current_band_index (metadata);
+    if (index != NULL)
+    {
+        band = index->name_slot[find_slot (index->band, index->name_slot,
+            index->nslots, -1, name)];
+        if (band < 0 || !strcmp (metadata->band[band].name, name))
+            return (band);
+    }
+
+    /* No index, or a band renamed since it was built */
+    for (i = 0; i < metadata->nbands; i++)
+    {
+        if (!strcmp (metadata->band[i].name, name))
+            return (i);
+    }
+
+    return (-1);
+}
+
+
+/******************************************************************************
+MODULE:  espa_select_bands
+
+PURPOSE: Selects the bands of the metadata with a product, source, or
+category.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+n               Number of bands with the value (0 if there are none)
+******************************************************************************/
+int espa_select_bands
+(
+    Espa_internal_meta_t *metadata, /* I/O: metadata of the bands (the index
+                                            is built if needed) */
+    Espa_band_field_t field,        /* I: field of the bands to match */
+    const char *value,              /* I: product, source, or category of
+                                          the bands */
+    int *bands                      /* O: indexes of the matching bands, in
+                                          order (nbands entries); NULL to
+                                          only count them */
+)
+{
+    const struct espa_band_index *index;  /* band index */
+    int count = 0;                  /* number of bands selected */
+    int i;                          /* looping variable for the bands */
+
+    index = current_band_index (metadata);
+    if (index != NULL)
+    {
+        for (i = index->field_slot[field][find_slot (index->band,
+            index->field_slot[field], index->nslots, field, value)];
+            i >= 0; i = index->field_next[field][i])
+        {
+            if (bands != NULL)
+                bands[count] = i;
+            count++;
+        }
+        return (count);
+    }
+
+    for (i = 0; i < metadata->nbands; i++)
+    {
+        if (!strcmp (band_field (&metadata->band[i], field), value))
+        {
+            if (bands != NULL)
+                bands[count] = i;
+            count++;
+        }
+    }
+
+    return (count);
+}
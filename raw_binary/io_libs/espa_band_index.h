@@ -0,0 +1,96 @@
+/*****************************************************************************
+FILE: espa_band_index.h
+
+PURPOSE: Contains defines, structures, and prototypes for the band index of
+the ESPA internal metadata, which finds a band by name, and the bands of a
+product, source, or category, without comparing the strings of every band.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The index is built when the metadata is parsed (parse_metadata and
+     validate_and_parse_metadata), and is otherwise built by the first
+     lookup.  It is freed by free_metadata.
+  2. The index holds hash tables of the band names and of the products,
+     sources, and categories, and chains the bands sharing a product,
+     source, or category in the order of the bands.  A name used by several
+     bands finds the first of them, as a loop over the bands would.
+  3. The index is rebuilt by the next lookup when the band array has been
+     allocated, appended to, or moved.  A band found by name is checked
+     against the band, so a band renamed in place is never returned for
+     the wrong name, but a band renamed in place (or a product, source, or
+     category changed in place) isn't found under its new value until
+     build_espa_band_index is called again.
+*****************************************************************************/
+
+#ifndef ESPA_BAND_INDEX_H
+#define ESPA_BAND_INDEX_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include "error_handler.h"
+#include "espa_metadata.h"
+
+/* Fields of the bands selected by espa_select_bands */
+typedef enum {
+    ESPA_BAND_PRODUCT,
+    ESPA_BAND_SOURCE,
+    ESPA_BAND_CATEGORY,
+    ESPA_BAND_NFIELDS
+} Espa_band_field_t;
+
+/* Band index of the metadata */
+struct espa_band_index
+{
+    const Espa_band_meta_t *band; /* band array the index was built for */
+    int nbands;                 /* number of bands indexed */
+    int nslots;                 /* number of slots in each hash table (a
+                                   power of two) */
+    int *name_slot;             /* first band with each name; -1 for an
+                                   empty slot */
+    int *field_slot[ESPA_BAND_NFIELDS]; /* first band with each product,
+                                   source, or category; -1 for an empty
+                                   slot */
+    int *field_next[ESPA_BAND_NFIELDS]; /* next band with the same product,
+                                   source, or category as each band; -1 for
+                                   the last */
+};
+
+/* Prototypes */
+int build_espa_band_index
+(
+    Espa_internal_meta_t *metadata  /* I/O: metadata whose bands are
+                                            indexed */
+);
+
+void free_espa_band_index
+(
+    Espa_internal_meta_t *metadata  /* I/O: metadata whose band index is
+                                            freed */
+);
+
+int espa_find_band
+(
+    Espa_internal_meta_t *metadata, /* I/O: metadata of the bands (the index
+                                            is built if needed) */
+    const char *name                /* I: name of the band */
+);
+
+int espa_select_bands
+(
+    Espa_internal_meta_t *metadata, /* I/O: metadata of the bands (the index
+                                            is built if needed) */
+    Espa_band_field_t field,        /* I: field of the bands to match */
+    const char *value,              /* I: product, source, or category of
+                                          the bands */
+    int *bands                      /* O: indexes of the matching bands, in
+                                          order (nbands entries); NULL to
+                                          only count them */
+);
+
+#endif
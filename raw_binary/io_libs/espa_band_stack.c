@@ -0,0 +1,987 @@
+/*****************************************************************************
+FILE: espa_band_stack.c
+
+PURPOSE: Contains functions for the band stack, which traverses a selection
+of the bands in the metadata as blocks of lines (or tiles) for all of the
+selected bands.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. Blocks are handed out in line order, and tiles from left to right within
+     each block of lines.  Requesting the next block releases the previous
+     one, so a block may be modified in place but must not be used after
+     asking for the next block.
+  2. Constant bands are synthesized from their metadata by the read-ahead
+     reader rather than read, so they may be stacked like any other band.
+*****************************************************************************/
+
+#include <math.h>
+#include <stdint.h>
+#include <unistd.h>
+#include "espa_band_stack.h"
+#include "raw_binary_writer.h"
+#include "espa_trace.h"
+
+/* What is done with the checksum of a band */
+#define BAND_SUM_NONE 0      /* not computed */
+#define BAND_SUM_RECORD 1    /* recorded in the metadata of the band */
+#define BAND_SUM_VERIFY 2    /* compared with the metadata of the band */
+
+/******************************************************************************
+MODULE: espa_data_type_size
+
+PURPOSE: Determines the number of bytes per pixel for an ESPA data type.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Unsupported data type
+>0           Number of bytes per pixel
+
+NOTES:
+*****************************************************************************/
+int espa_data_type_size
+(
+    enum Espa_data_type data_type  /* I: ESPA data type */
+)
+{
+    switch (data_type)
+    {
+        case ESPA_INT8:
+        case ESPA_UINT8:
+            return 1;
+        case ESPA_INT16:
+        case ESPA_UINT16:
+            return 2;
+        case ESPA_INT32:
+        case ESPA_UINT32:
+        case ESPA_FLOAT32:
+            return 4;
+        case ESPA_FLOAT64:
+            return 8;
+        default:
+            return ERROR;
+    }
+}
+
+
+/******************************************************************************
+MODULE: espa_constant_pixel
+
+PURPOSE: Converts the value of a constant band to a pixel of the data type of
+the band.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        The band isn't a constant band or has an unsupported data type
+SUCCESS      The pixel was converted
+
+NOTES:
+  1. The value is rounded to the nearest integer for the integer data types.
+*****************************************************************************/
+int espa_constant_pixel
+(
+    Espa_band_meta_t *bmeta,  /* I: metadata of the constant band */
+    void *pixel               /* O: pixel value; at least 8 bytes, aligned
+                                    for any of the data types */
+)
+{
+    double value = bmeta->constant_value;  /* value of the band */
+    double rounded = floor (value + 0.5);  /* value for the integer types */
+
+    if (!is_constant_band (bmeta))
+        return ERROR;
+
+    switch (bmeta->data_type)
+    {
+        case ESPA_INT8:
+            *(int8_t *) pixel = (int8_t) rounded;
+            break;
+        case ESPA_UINT8:
+            *(uint8_t *) pixel = (uint8_t) rounded;
+            break;
+        case ESPA_INT16:
+            *(int16_t *) pixel = (int16_t) rounded;
+            break;
+        case ESPA_UINT16:
+            *(uint16_t *) pixel = (uint16_t) rounded;
+            break;
+        case ESPA_INT32:
+            *(int32_t *) pixel = (int32_t) rounded;
+            break;
+        case ESPA_UINT32:
+            *(uint32_t *) pixel = (uint32_t) rounded;
+            break;
+        case ESPA_FLOAT32:
+            *(float *) pixel = (float) value;
+            break;
+        case ESPA_FLOAT64:
+            *(double *) pixel = value;
+            break;
+        default:
+            return ERROR;
+    }
+
+    return SUCCESS;
+}
+
+
+/******************************************************************************
+MODULE: expand_constant_band
+
+PURPOSE: Writes out the pixels of a constant band as a raw binary file, for
+the consumers which need them materialized.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error converting the value or writing the file, or the band
+             has no lines or samples
+SUCCESS      The file was written
+
+NOTES:
+  1. A single block of lines is synthesized and written repeatedly.  The
+     block holds just enough whole lines to fill the smallest coalescing
+     buffer of the writer (RB_WRITER_MIN_MB), so each full block is written
+     directly rather than copied through the buffer, and the memory used is
+     bounded by the line size rather than the band size.
+*****************************************************************************/
+int expand_constant_band
+(
+    Espa_band_meta_t *bmeta,  /* I: metadata of the constant band */
+    char *outfile             /* I: name of the raw binary file to be
+                                    written */
+)
+{
+    char FUNC_NAME[] = "expand_constant_band";  /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    int line;                 /* first line of the current block */
+    int nlines;               /* number of lines in the current block */
+    int block_lines;          /* number of lines in a full block */
+    int size;                 /* number of bytes per pixel */
+    size_t line_bytes;        /* number of bytes in a line of the band */
+    double pixel;             /* storage for the pixel value */
+    void *buf = NULL;         /* block of lines of the band */
+    Raw_binary_writer_t *writer = NULL;  /* writer for the output file */
+
+    size = espa_data_type_size (bmeta->data_type);
+    if (size == ERROR || espa_constant_pixel (bmeta, &pixel) != SUCCESS)
+    {
+        sprintf (errmsg, "Band %s is not a constant band of a supported "
+            "data type", bmeta->name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return ERROR;
+    }
+
+    /* The block size is computed from the line size, so an empty band
+       would divide by zero */
+    if (bmeta->nlines <= 0 || bmeta->nsamps <= 0)
+    {
+        sprintf (errmsg, "Band %s has no pixels to be written (%d lines, %d "
+            "samples)", bmeta->name, bmeta->nlines, bmeta->nsamps);
+        error_handler (true, FUNC_NAME, errmsg);
+        return ERROR;
+    }
+
+    line_bytes = (size_t) bmeta->nsamps * size;
+    block_lines = (int) ((RB_WRITER_MIN_MB * 1024 * 1024 + line_bytes - 1) /
+        line_bytes);
+    if (block_lines > bmeta->nlines)
+        block_lines = bmeta->nlines;
+    buf = espa_trace_malloc ((size_t) block_lines * line_bytes);
+    if (buf == NULL)
+    {
+        sprintf (errmsg, "Allocating a block of lines for band %s",
+            bmeta->name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return ERROR;
+    }
+    read_raw_binary_constant (block_lines, bmeta->nsamps, size, &pixel, buf);
+
+    writer = open_raw_binary_writer (outfile, (size_t) bmeta->nlines *
+        line_bytes, RB_WRITER_MIN_MB);
+    if (writer == NULL)
+    {
+        sprintf (errmsg, "Opening the raw binary file: %s", outfile);
+        error_handler (true, FUNC_NAME, errmsg);
+        espa_trace_free (buf);
+        return ERROR;
+    }
+
+    for (line = 0; line < bmeta->nlines; line += nlines)
+    {
+        nlines = block_lines;
+        if (line + nlines > bmeta->nlines)
+            nlines = bmeta->nlines - line;
+        if (append_raw_binary_writer (writer, nlines, bmeta->nsamps, size,
+            buf) != SUCCESS)
+        {
+            sprintf (errmsg, "Writing lines %d-%d to the raw binary file: %s",
+                line, line + nlines - 1, outfile);
+            error_handler (true, FUNC_NAME, errmsg);
+            close_raw_binary_writer (writer);
+            espa_trace_free (buf);
+            return ERROR;
+        }
+    }
+    espa_trace_free (buf);
+
+    if (close_raw_binary_writer (writer) != SUCCESS)
+    {
+        sprintf (errmsg, "Closing the raw binary file: %s", outfile);
+        error_handler (true, FUNC_NAME, errmsg);
+        return ERROR;
+    }
+
+    return SUCCESS;
+}
+
+
+/******************************************************************************
+MODULE: encode_espa_band
+
+PURPOSE: Rewrites the raw binary file of a band with another encoding, i.e.
+as a block-compressed or tiled band or back to plain raw binary.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error reading the band or writing the new file
+SUCCESS      The band was rewritten, or already had the encoding
+
+NOTES:
+  1. The new file is named after the current file, with the extension of the
+     encoding (.img, RB_BLOCKS_ZLIB_EXT, RB_BLOCKS_ZSTD_EXT, RB_TILES_EXT,
+     RB_BLOCKS_BITPACKED_EXT, or RB_BLOCKS_RLE_EXT).  The current file is
+     removed once the new file is complete.  A tiled band with another tile
+     size is rewritten as well.
+  5. Only 8-bit bands can be bit-packed or run-length encoded, and only a
+     band whose valid range is 0 to 1 can be bit-packed, since every other
+     value would read back as 1.
+  2. The band is read through the band stack, so a block-compressed band is
+     decompressed on the way.
+  3. Constant bands have no file and are left alone.  The ENVI header of the
+     band, if there is one, is left alone as well; it only describes the
+     plain raw binary layout.
+  4. Bands stored in a stack (see espa_file_stack.h) are an error; they are
+     unstacked first.
+*****************************************************************************/
+int encode_espa_band
+(
+    Espa_internal_meta_t *xml_meta, /* I/O: metadata with the bands; the
+                                            file name and encoding of the
+                                            band are updated */
+    int band,                       /* I: index of the band in the metadata */
+    Raw_binary_encoding_t encoding, /* I: encoding of the new file */
+    int tile_size                   /* I: number of lines and samples per
+                                          tile of a tiled band; 0 for
+                                          RB_TILES_DEFAULT_SIZE */
+)
+{
+    char FUNC_NAME[] = "encode_espa_band";  /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    char outfile[STR_SIZE];   /* name of the new file */
+    char new_file[STR_SIZE];  /* file written, which is renamed to outfile
+                                 when it replaces the current file */
+    const char *exts[] = {RB_BLOCKS_ZLIB_EXT, RB_BLOCKS_ZSTD_EXT,
+        RB_TILES_EXT, RB_BLOCKS_BITPACKED_EXT, RB_BLOCKS_RLE_EXT, ".img"};
+                              /* extensions of the band files */
+    const char *new_ext;      /* extension of the new file */
+    size_t len;               /* length of the name of the file */
+    int i;                    /* looping variable for the extensions */
+    int count;                /* number of chars copied in snprintf */
+    int size;                 /* number of bytes per pixel */
+    int status = SUCCESS;     /* status of rewriting the band */
+    bool in_place;            /* does the new file replace the current file,
+                                 i.e. a band retiled with another tile
+                                 size? */
+    Raw_binary_encoding_t curr_encoding;  /* encoding of the current file */
+    Espa_band_meta_t *bmeta = &xml_meta->band[band];  /* band metadata */
+    Espa_band_stack_t *stack = NULL;     /* reader of the current file */
+    Espa_band_block_t *block = NULL;     /* current block of lines */
+    Raw_binary_writer_t *writer = NULL;  /* writer of the new file */
+
+    if (is_constant_band (bmeta))
+        return SUCCESS;
+
+    /* The other bands of a stack would lose their file */
+    if (bmeta->file_offset != 0 || is_shared_band_file (xml_meta, band, false))
+    {
+        sprintf (errmsg, "Band %s is stored in the stack %s, so it needs to "
+            "be unstacked before it is encoded", bmeta->name,
+            bmeta->file_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return ERROR;
+    }
+
+    curr_encoding = RB_ENCODING_RAW;
+    if (strcmp (bmeta->encoding, ESPA_STRING_META_FILL) &&
+        parse_raw_binary_encoding (bmeta->encoding, &curr_encoding)
+        != SUCCESS)
+    {
+        sprintf (errmsg, "Encoding of band %s", bmeta->name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return ERROR;
+    }
+    if (encoding != RB_ENCODING_RAW_TILES)
+        tile_size = 0;
+    else if (tile_size == 0)
+        tile_size = RB_TILES_DEFAULT_SIZE;
+    if (curr_encoding == encoding && bmeta->tile_size == tile_size)
+        return SUCCESS;
+
+    size = espa_data_type_size (bmeta->data_type);
+    if (size == ERROR)
+    {
+        sprintf (errmsg, "Unsupported data type for band %s", bmeta->name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return ERROR;
+    }
+    if (encoding == RB_ENCODING_BITPACKED_BLOCKS &&
+        (bmeta->valid_range[0] < 0.0 || bmeta->valid_range[1] > 1.0))
+    {
+        sprintf (errmsg, "Band %s has values outside of 0 to 1, so it can't "
+            "be bit-packed", bmeta->name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return ERROR;
+    }
+
+    /* Name the new file after the current one, minus its extension */
+    if (encoding == RB_ENCODING_ZLIB_BLOCKS)
+        new_ext = RB_BLOCKS_ZLIB_EXT;
+    else if (encoding == RB_ENCODING_ZSTD_BLOCKS)
+        new_ext = RB_BLOCKS_ZSTD_EXT;
+    else if (encoding == RB_ENCODING_RAW_TILES)
+        new_ext = RB_TILES_EXT;
+    else if (encoding == RB_ENCODING_BITPACKED_BLOCKS)
+        new_ext = RB_BLOCKS_BITPACKED_EXT;
+    else if (encoding == RB_ENCODING_RLE_BLOCKS)
+        new_ext = RB_BLOCKS_RLE_EXT;
+    else
+        new_ext = ".img";
+    len = strlen (bmeta->file_name);
+    for (i = 0; i < sizeof (exts) / sizeof (exts[0]); i++)
+    {
+        if (len > strlen (exts[i]) &&
+            !strcmp (bmeta->file_name + len - strlen (exts[i]), exts[i]))
+        {
+            len -= strlen (exts[i]);
+            break;
+        }
+    }
+    count = snprintf (outfile, sizeof (outfile), "%.*s%s", (int) len,
+        bmeta->file_name, new_ext);
+    if (count < 0 || count >= sizeof (outfile))
+    {
+        sprintf (errmsg, "Overflow of outfile string");
+        error_handler (true, FUNC_NAME, errmsg);
+        return ERROR;
+    }
+    in_place = !strcmp (outfile, bmeta->file_name);
+    count = snprintf (new_file, sizeof (new_file), "%s%s", outfile,
+        in_place ? ".tmp" : "");
+    if (count < 0 || count >= sizeof (new_file))
+    {
+        sprintf (errmsg, "Overflow of new_file string");
+        error_handler (true, FUNC_NAME, errmsg);
+        return ERROR;
+    }
+
+    stack = open_band_stack (xml_meta, 1, &band, RB_PREFETCH_DEFAULT_LINES,
+        0);
+    if (stack == NULL)
+    {
+        sprintf (errmsg, "Opening band %s", bmeta->name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return ERROR;
+    }
+
+    writer = open_encoded_raw_binary_writer (new_file, encoding,
+        bmeta->nlines, bmeta->nsamps, size, tile_size);
+    if (writer == NULL)
+    {
+        sprintf (errmsg, "Creating %s", new_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        close_band_stack (stack);
+        return ERROR;
+    }
+
+    /* Full width blocks of lines are contiguous in the block buffer */
+    while (status == SUCCESS)
+    {
+        if (get_band_stack_block (stack, &block) != SUCCESS)
+        {
+            sprintf (errmsg, "Reading band %s", bmeta->name);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+            break;
+        }
+        if (block == NULL)
+            break;
+
+        if (append_raw_binary_writer (writer, block->nlines, block->nsamps,
+            size, block->band_buf[0]) != SUCCESS)
+        {
+            sprintf (errmsg, "Writing lines %d-%d to %s", block->line0,
+                block->line0 + block->nlines - 1, new_file);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+        }
+    }
+    close_band_stack (stack);
+
+    if (close_raw_binary_writer (writer) != SUCCESS && status == SUCCESS)
+    {
+        sprintf (errmsg, "Closing %s", new_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        status = ERROR;
+    }
+    if (status != SUCCESS)
+    {
+        unlink (new_file);
+        return ERROR;
+    }
+
+    /* Switch the band over to the new file */
+    if (in_place)
+    {
+        if (rename (new_file, outfile) != 0)
+        {
+            sprintf (errmsg, "Renaming %s to %s", new_file, outfile);
+            error_handler (true, FUNC_NAME, errmsg);
+            unlink (new_file);
+            return ERROR;
+        }
+    }
+    else if (unlink (bmeta->file_name) != 0)
+    {
+        sprintf (errmsg, "Removing %s", bmeta->file_name);
+        error_handler (false, FUNC_NAME, errmsg);
+    }
+    strcpy (bmeta->file_name, outfile);
+    if (encoding == RB_ENCODING_RAW)
+        strcpy (bmeta->encoding, ESPA_STRING_META_FILL);
+    else
+        strcpy (bmeta->encoding, raw_binary_encoding_name (encoding));
+    bmeta->tile_size = tile_size;
+
+    return SUCCESS;
+}
+
+
+/******************************************************************************
+MODULE: espa_band_stack_lines
+
+PURPOSE: Determines the number of lines per block of a band stack whose
+read-ahead buffers fit in the memory budget (see espa_mem_fit_count).
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+>= multiple  Number of lines per block, a multiple of multiple no larger than
+             block_lines (unless block_lines is smaller than multiple)
+
+NOTES:
+  1. Callers which size their own buffers by the lines of a block (ex. the
+     exporters) call it before open_band_stack, which takes the block lines
+     as they are.
+*****************************************************************************/
+int espa_band_stack_lines
+(
+    Espa_internal_meta_t *xml_meta, /* I: metadata with the bands */
+    int nbands,          /* I: number of bands in the stack; the bands are
+                               all the metadata bands if band_index is NULL */
+    int *band_index,     /* I: index in the metadata of each band to be in
+                               the stack; NULL for all the bands */
+    int block_lines,     /* I: number of lines per block wanted */
+    int multiple         /* I: the lines are kept a multiple of this (ex.
+                               the lines of a chunk); 1 for any number */
+)
+{
+    int i;                    /* looping variable for the bands */
+    size_t line_bytes = 0;    /* bytes of a line of all the bands */
+    Espa_band_meta_t *bmeta = NULL;    /* current band metadata */
+
+    if (band_index == NULL)
+        nbands = xml_meta->nbands;
+    for (i = 0; i < nbands; i++)
+    {
+        bmeta = &xml_meta->band[band_index == NULL ? i : band_index[i]];
+        line_bytes += (size_t) bmeta->nsamps *
+            espa_data_type_size (bmeta->data_type) + RB_PREFETCH_ALIGN;
+    }
+
+    return espa_mem_fit_count (line_bytes * RB_PREFETCH_MAX_BUFFERS,
+        block_lines, multiple);
+}
+
+
+/******************************************************************************
+MODULE: open_band_stack
+
+PURPOSE: Sets up the band stack for the selected bands and starts reading
+ahead the first blocks of lines.
+
+RETURN VALUE:
+Type = Espa_band_stack_t *
+Value        Description
+-----        -----------
+NULL         Error validating the bands or starting the read-ahead
+non-NULL     Band stack
+
+NOTES:
+  1. The blocks are read ahead triple buffered, or double buffered when
+     the three blocks don't fit in the memory budget (see espa_trace.h).
+*****************************************************************************/
+Espa_band_stack_t *open_band_stack
+(
+    Espa_internal_meta_t *xml_meta, /* I: metadata with the bands */
+    int nbands,          /* I: number of bands in the stack; the bands are
+                               all the metadata bands if band_index is NULL */
+    int *band_index,     /* I: index in the metadata of each band to be in
+                               the stack; NULL for all the bands */
+    int block_lines,     /* I: number of lines per block; use
+                               RB_PREFETCH_DEFAULT_LINES if not known */
+    int tile_samps       /* I: number of samples per tile; 0 for full width
+                               blocks of lines */
+)
+{
+    char FUNC_NAME[] = "open_band_stack";  /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    int i;                    /* looping variable for the bands */
+    int nbuffers;             /* number of blocks read ahead */
+    size_t block_bytes = 0;   /* bytes of a block of all the bands */
+    char **band_files = NULL; /* filename of each band in the stack; NULL for
+                                 a constant band */
+    int *band_nsamps = NULL;  /* number of samples of each band in the stack */
+    off_t *band_offsets = NULL; /* byte offset of each band in its file */
+    double *pixels = NULL;    /* storage for the pixel value of each constant
+                                 band */
+    void **constant = NULL;   /* pixel value of each constant band */
+    Espa_band_meta_t *bmeta = NULL;    /* current band metadata */
+    Espa_band_stack_t *stack = NULL;   /* band stack */
+
+    if (band_index == NULL)
+        nbands = xml_meta->nbands;
+    if (nbands <= 0)
+    {
+        sprintf (errmsg, "No bands were selected for the band stack");
+        error_handler (true, FUNC_NAME, errmsg);
+        return NULL;
+    }
+
+    stack = calloc (1, sizeof (Espa_band_stack_t));
+    if (stack == NULL)
+    {
+        sprintf (errmsg, "Allocating the band stack");
+        error_handler (true, FUNC_NAME, errmsg);
+        return NULL;
+    }
+    stack->nbands = nbands;
+    stack->xml_meta = xml_meta;
+    stack->band_index = calloc (nbands, sizeof (int));
+    stack->size = calloc (nbands, sizeof (int));
+    stack->block.band_buf = calloc (nbands, sizeof (void *));
+    stack->sum_mode = calloc (nbands, sizeof (char));
+    stack->checksum = calloc (nbands, sizeof (Rb_checksum_t));
+    stack->stats = calloc (nbands, sizeof (Rb_stats_t *));
+    band_files = calloc (nbands, sizeof (char *));
+    band_nsamps = calloc (nbands, sizeof (int));
+    band_offsets = calloc (nbands, sizeof (off_t));
+    pixels = calloc (nbands, sizeof (double));
+    constant = calloc (nbands, sizeof (void *));
+    if (stack->band_index == NULL || stack->size == NULL ||
+        stack->block.band_buf == NULL || stack->sum_mode == NULL ||
+        stack->checksum == NULL || stack->stats == NULL ||
+        band_files == NULL ||
+        band_nsamps == NULL || band_offsets == NULL || pixels == NULL ||
+        constant == NULL)
+    {
+        sprintf (errmsg, "Allocating the band stack for %d bands", nbands);
+        error_handler (true, FUNC_NAME, errmsg);
+        free (band_files);
+        free (band_nsamps);
+        free (band_offsets);
+        free (pixels);
+        free (constant);
+        close_band_stack (stack);
+        return NULL;
+    }
+
+    /* Validate the selected bands */
+    for (i = 0; i < nbands; i++)
+    {
+        stack->band_index[i] = band_index == NULL ? i : band_index[i];
+        if (stack->band_index[i] < 0 ||
+            stack->band_index[i] >= xml_meta->nbands)
+        {
+            sprintf (errmsg, "Band index %d is not in the metadata",
+                stack->band_index[i]);
+            error_handler (true, FUNC_NAME, errmsg);
+            break;
+        }
+
+        bmeta = &xml_meta->band[stack->band_index[i]];
+        stack->size[i] = espa_data_type_size (bmeta->data_type);
+        if (stack->size[i] == ERROR)
+        {
+            sprintf (errmsg, "Unsupported data type for band %s",
+                bmeta->name);
+            error_handler (true, FUNC_NAME, errmsg);
+            break;
+        }
+
+        if (i == 0)
+        {
+            stack->nlines = bmeta->nlines;
+            stack->nsamps = bmeta->nsamps;
+        }
+        else if (bmeta->nlines != stack->nlines ||
+            bmeta->nsamps != stack->nsamps)
+        {
+            sprintf (errmsg, "Band %s is %d lines x %d samples, which does "
+                "not match the %d lines x %d samples of the first band in "
+                "the stack", bmeta->name, bmeta->nlines, bmeta->nsamps,
+                stack->nlines, stack->nsamps);
+            error_handler (true, FUNC_NAME, errmsg);
+            break;
+        }
+
+        if (is_constant_band (bmeta))
+        {
+            if (espa_constant_pixel (bmeta, &pixels[i]) != SUCCESS)
+            {
+                sprintf (errmsg, "Converting the constant value of band %s",
+                    bmeta->name);
+                error_handler (true, FUNC_NAME, errmsg);
+                break;
+            }
+            constant[i] = &pixels[i];
+        }
+        else
+        {
+            band_files[i] = bmeta->file_name;
+            band_offsets[i] = bmeta->file_offset;
+
+            /* Record the checksum of a band which has none, and verify
+               the checksum of the others if asked to */
+            if (!strcmp (bmeta->checksum, ESPA_STRING_META_FILL))
+                stack->sum_mode[i] = BAND_SUM_RECORD;
+            else if (use_raw_binary_verify () &&
+                known_raw_binary_checksum (bmeta->checksum))
+                stack->sum_mode[i] = BAND_SUM_VERIFY;
+            init_raw_binary_checksum (&stack->checksum[i]);
+
+            /* Record the statistics of a band which has none */
+            if (bmeta->stats.valid_count == ESPA_INT_META_FILL)
+            {
+                stack->stats[i] = open_raw_binary_stats (bmeta);
+                if (stack->stats[i] == NULL)
+                {
+                    sprintf (errmsg, "Starting the statistics of band %s",
+                        bmeta->name);
+                    error_handler (true, FUNC_NAME, errmsg);
+                    break;
+                }
+            }
+        }
+        band_nsamps[i] = bmeta->nsamps;
+    }
+    if (i < nbands)
+    {
+        free (band_files);
+        free (band_nsamps);
+        free (band_offsets);
+        free (pixels);
+        free (constant);
+        close_band_stack (stack);
+        return NULL;
+    }
+
+    stack->tile_samps = tile_samps;
+    if (stack->tile_samps <= 0 || stack->tile_samps > stack->nsamps)
+        stack->tile_samps = stack->nsamps;
+
+    /* Start reading ahead, triple buffered if the blocks fit in the memory
+       budget */
+    for (i = 0; i < nbands; i++)
+        block_bytes += ((size_t) band_nsamps[i] * stack->size[i] +
+            RB_PREFETCH_ALIGN) * block_lines;
+    nbuffers = espa_mem_fit_count (block_bytes, RB_PREFETCH_MAX_BUFFERS, 1);
+    stack->prefetch = open_raw_binary_prefetch (nbands, band_files, constant,
+        band_offsets, band_nsamps, stack->size, stack->nlines, block_lines,
+        nbuffers);
+    free (band_files);
+    free (band_nsamps);
+    free (band_offsets);
+    free (pixels);
+    free (constant);
+    if (stack->prefetch == NULL)
+    {
+        sprintf (errmsg, "Starting the read-ahead for the band stack");
+        error_handler (true, FUNC_NAME, errmsg);
+        close_band_stack (stack);
+        return NULL;
+    }
+
+    return stack;
+}
+
+
+/******************************************************************************
+MODULE: finish_band_stack_sums
+
+PURPOSE: Records or verifies the checksums of the bands, and records the
+statistics of the bands which had none, once all their blocks have been read.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        A band doesn't match the checksum of its metadata
+SUCCESS      The checksums were recorded or matched
+
+NOTES:
+  1. Only done once; the checksums and statistics are no longer computed
+     afterwards.
+*****************************************************************************/
+static int finish_band_stack_sums
+(
+    Espa_band_stack_t *stack        /* I: band stack */
+)
+{
+    char FUNC_NAME[] = "finish_band_stack_sums";  /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    int i;                    /* looping variable for the bands */
+    int status = SUCCESS;     /* return status */
+    Espa_band_meta_t *bmeta = NULL;    /* current band metadata */
+
+    for (i = 0; i < stack->nbands; i++)
+    {
+        bmeta = &stack->xml_meta->band[stack->band_index[i]];
+        if (stack->sum_mode[i] == BAND_SUM_RECORD)
+            format_raw_binary_checksum (&stack->checksum[i],
+                bmeta->checksum);
+        else if (stack->sum_mode[i] == BAND_SUM_VERIFY &&
+            !match_raw_binary_checksum (&stack->checksum[i],
+            bmeta->checksum))
+        {
+            sprintf (errmsg, "The pixels of band %s in %s don't match its "
+                "checksum %s", bmeta->name, bmeta->file_name,
+                bmeta->checksum);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+        }
+        stack->sum_mode[i] = BAND_SUM_NONE;
+
+        if (stack->stats[i] != NULL)
+        {
+            finish_raw_binary_stats (stack->stats[i], &bmeta->stats);
+            close_raw_binary_stats (stack->stats[i]);
+            stack->stats[i] = NULL;
+        }
+    }
+
+    return status;
+}
+
+
+/******************************************************************************
+MODULE: skip_band_stack_stats
+
+PURPOSE: Stops the band stack from computing the statistics of the bands
+which have none, for a caller which modifies the blocks and computes the
+statistics of the modified pixels itself.
+
+RETURN VALUE: None
+
+NOTES:
+*****************************************************************************/
+void skip_band_stack_stats
+(
+    Espa_band_stack_t *stack  /* I: band stack, before its first block */
+)
+{
+    int i;                    /* looping variable for the bands */
+
+    for (i = 0; i < stack->nbands; i++)
+        skip_band_stack_band_stats (stack, i);
+}
+
+
+/******************************************************************************
+MODULE: skip_band_stack_band_stats
+
+PURPOSE: Stops the band stack from computing the statistics of one of its
+bands, for a caller which modifies only some of the bands in the blocks
+(ex. the clipped bands of process_level1).
+
+RETURN VALUE: None
+
+NOTES:
+*****************************************************************************/
+void skip_band_stack_band_stats
+(
+    Espa_band_stack_t *stack, /* I: band stack, before its first block */
+    int band                  /* I: position of the band in the stack */
+)
+{
+    close_raw_binary_stats (stack->stats[band]);
+    stack->stats[band] = NULL;
+}
+
+
+/******************************************************************************
+MODULE: drop_band_stack_pages
+
+PURPOSE: Has the band stack drop the lines of each block from the page cache
+once they are consumed, for a caller which won't read the bands again (ex. a
+converter deleting its source bands).
+
+RETURN VALUE: None
+
+NOTES:
+  1. The page cache policy may turn this off (see raw_binary_advise.h).
+*****************************************************************************/
+void drop_band_stack_pages
+(
+    Espa_band_stack_t *stack  /* I: band stack */
+)
+{
+    stack->prefetch->drop_behind = true;
+}
+
+
+/******************************************************************************
+MODULE: get_band_stack_block
+
+PURPOSE: Releases the current block and returns the next block (or tile) of
+all the bands in the stack.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error reading the next block of lines
+SUCCESS      The next block was returned, or NULL if all have been traversed
+
+NOTES:
+  1. The wait for each block of lines to be read ahead is a read_block span
+     of the timing trace.
+  2. The checksums and statistics are updated with each block of lines as
+     it is read, before the caller can modify it.
+*****************************************************************************/
+int get_band_stack_block
+(
+    Espa_band_stack_t *stack,       /* I: band stack */
+    Espa_band_block_t **block       /* O: next block; NULL once all the
+                                          blocks have been traversed */
+)
+{
+    char FUNC_NAME[] = "get_band_stack_block";  /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    int i;                    /* looping variable for the bands */
+    int status;               /* return status */
+    Espa_band_block_t *blk = &stack->block;  /* block handed to the caller */
+    Espa_trace_span_t span;   /* timing of the wait for the read */
+
+    *block = NULL;
+
+    /* Move on to the next block of lines once the current one has been
+       traversed */
+    if (stack->stripe == NULL || stack->next_samp0 >= stack->nsamps)
+    {
+        span = espa_trace_begin ("read_block", NULL);
+        status = get_raw_binary_prefetch_block (stack->prefetch,
+            &stack->stripe);
+        espa_trace_end (&span);
+        if (status != SUCCESS)
+        {
+            sprintf (errmsg, "Reading the next block of lines of the band "
+                "stack");
+            error_handler (true, FUNC_NAME, errmsg);
+            return ERROR;
+        }
+        if (stack->stripe == NULL)
+        {
+            /* All the blocks have been traversed */
+            return finish_band_stack_sums (stack);
+        }
+        stack->next_samp0 = 0;
+
+        for (i = 0; i < stack->nbands; i++)
+        {
+            if (stack->sum_mode[i] != BAND_SUM_NONE)
+                update_raw_binary_checksum (&stack->checksum[i],
+                    stack->stripe->band_buf[i], (size_t)
+                    stack->stripe->nlines * stack->nsamps * stack->size[i]);
+            if (stack->stats[i] != NULL)
+                update_raw_binary_stats (stack->stats[i],
+                    stack->stripe->band_buf[i], (size_t)
+                    stack->stripe->nlines * stack->nsamps);
+        }
+    }
+
+    /* Hand out the next tile of the current block of lines */
+    blk->line0 = stack->stripe->line0;
+    blk->nlines = stack->stripe->nlines;
+    blk->samp0 = stack->next_samp0;
+    blk->nsamps = stack->tile_samps;
+    if (blk->samp0 + blk->nsamps > stack->nsamps)
+        blk->nsamps = stack->nsamps - blk->samp0;
+    blk->line_stride = stack->nsamps;
+    for (i = 0; i < stack->nbands; i++)
+        blk->band_buf[i] = (char *) stack->stripe->band_buf[i] +
+            (size_t) blk->samp0 * stack->size[i];
+    stack->next_samp0 += blk->nsamps;
+
+    *block = blk;
+    return SUCCESS;
+}
+
+
+/******************************************************************************
+MODULE: close_band_stack
+
+PURPOSE: Stops the read-ahead and frees the band stack.
+
+RETURN VALUE:
+Type = N/A
+
+NOTES:
+  1. May be called before all the blocks have been traversed.
+*****************************************************************************/
+void close_band_stack
+(
+    Espa_band_stack_t *stack        /* I: band stack to be closed */
+)
+{
+    int i;                    /* looping variable for the bands */
+
+    if (stack == NULL)
+        return;
+
+    close_raw_binary_prefetch (stack->prefetch);
+    free (stack->band_index);
+    free (stack->size);
+    free (stack->block.band_buf);
+    free (stack->sum_mode);
+    free (stack->checksum);
+    if (stack->stats != NULL)
+    {
+        for (i = 0; i < stack->nbands; i++)
+            close_raw_binary_stats (stack->stats[i]);
+        free (stack->stats);
+    }
+    free (stack);
+}
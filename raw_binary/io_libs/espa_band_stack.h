@@ -0,0 +1,167 @@
+/*****************************************************************************
+FILE: espa_band_stack.h
+
+PURPOSE: Contains defines and structures for the band stack, which traverses
+a selection of the bands in an ESPA internal metadata structure as blocks of
+lines (or tiles) holding every selected band.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. All the selected bands must have the same number of lines and samples.
+     The data types may differ.
+  2. The blocks are read ahead in the background by the read-ahead reader
+     (raw_binary_prefetch.h), using a single allocation for all the bands.
+     With a memory budget (see espa_trace.h), fewer blocks are read ahead
+     when they don't all fit, and espa_band_stack_lines gives the lines per
+     block which fit.
+  3. Constant bands (see is_constant_band) are synthesized rather than read.
+  4. The checksum of each band (see raw_binary_checksum.h) is computed as its
+     blocks are read.  Once all the blocks are traversed, it is recorded in
+     the metadata of a band which has none, or compared with the checksum of
+     the band when reading is verified (see RB_VERIFY_ENV).
+  5. The statistics of each band which has none (see raw_binary_stats.h) are
+     computed the same way, and recorded in its metadata once all the blocks
+     are traversed.
+*****************************************************************************/
+
+#ifndef ESPA_BAND_STACK_H
+#define ESPA_BAND_STACK_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "error_handler.h"
+#include "espa_metadata.h"
+#include "raw_binary_prefetch.h"
+#include "raw_binary_blocks.h"
+#include "raw_binary_checksum.h"
+#include "raw_binary_stats.h"
+
+/* Block of lines, or a tile within the block of lines, for all the bands in
+   the stack.  Line bl of the tile for band i starts at
+   (char *) band_buf[i] + bl * line_stride * size[i]. */
+typedef struct
+{
+    int line0;           /* 0-based first line of the block */
+    int nlines;          /* number of lines in the block */
+    int samp0;           /* 0-based first sample of the block */
+    int nsamps;          /* number of samples in the block */
+    int line_stride;     /* number of samples between consecutive lines in
+                            band_buf (the full number of samples) */
+    void **band_buf;     /* first pixel of the block for each band in the
+                            stack; cast to the data type of the band */
+} Espa_band_block_t;
+
+/* Band stack */
+typedef struct
+{
+    int nbands;          /* number of bands in the stack */
+    int *band_index;     /* index in the metadata of each band in the stack */
+    int *size;           /* number of bytes per pixel for each band */
+    int nlines;          /* number of lines in each band */
+    int nsamps;          /* number of samples in each band */
+    int tile_samps;      /* number of samples per tile; nsamps for full
+                            width blocks */
+    int next_samp0;      /* first sample of the next tile in the stripe */
+    Raw_binary_prefetch_t *prefetch;  /* read-ahead reader for the bands */
+    Rb_prefetch_block_t *stripe;      /* current full width block of lines */
+    Espa_band_block_t block;          /* block handed to the caller */
+    Espa_internal_meta_t *xml_meta;   /* metadata with the bands */
+    char *sum_mode;      /* what is done with the checksum of each band
+                            (see BAND_SUM_* in the .c) */
+    Rb_checksum_t *checksum;          /* checksum of each band, computed as
+                                         its blocks are read */
+    Rb_stats_t **stats;  /* statistics of each band, computed as its blocks
+                            are read; NULL for a band which has them */
+} Espa_band_stack_t;
+
+/* Prototypes */
+int espa_data_type_size
+(
+    enum Espa_data_type data_type  /* I: ESPA data type */
+);
+
+int espa_constant_pixel
+(
+    Espa_band_meta_t *bmeta,  /* I: metadata of the constant band */
+    void *pixel               /* O: pixel value; at least 8 bytes, aligned
+                                    for any of the data types */
+);
+
+int expand_constant_band
+(
+    Espa_band_meta_t *bmeta,  /* I: metadata of the constant band */
+    char *outfile             /* I: name of the raw binary file to be
+                                    written */
+);
+
+int encode_espa_band
+(
+    Espa_internal_meta_t *xml_meta, /* I/O: metadata with the bands; the
+                                            file name and encoding of the
+                                            band are updated */
+    int band,                       /* I: index of the band in the metadata */
+    Raw_binary_encoding_t encoding, /* I: encoding of the new file */
+    int tile_size                   /* I: number of lines and samples per
+                                          tile of a tiled band; 0 for
+                                          RB_TILES_DEFAULT_SIZE */
+);
+
+int espa_band_stack_lines
+(
+    Espa_internal_meta_t *xml_meta, /* I: metadata with the bands */
+    int nbands,          /* I: number of bands in the stack; the bands are
+                               all the metadata bands if band_index is NULL */
+    int *band_index,     /* I: index in the metadata of each band to be in
+                               the stack; NULL for all the bands */
+    int block_lines,     /* I: number of lines per block wanted */
+    int multiple         /* I: the lines are kept a multiple of this (ex.
+                               the lines of a chunk); 1 for any number */
+);
+
+Espa_band_stack_t *open_band_stack
+(
+    Espa_internal_meta_t *xml_meta, /* I: metadata with the bands */
+    int nbands,          /* I: number of bands in the stack; the bands are
+                               all the metadata bands if band_index is NULL */
+    int *band_index,     /* I: index in the metadata of each band to be in
+                               the stack; NULL for all the bands */
+    int block_lines,     /* I: number of lines per block; use
+                               RB_PREFETCH_DEFAULT_LINES if not known */
+    int tile_samps       /* I: number of samples per tile; 0 for full width
+                               blocks of lines */
+);
+
+void skip_band_stack_stats
+(
+    Espa_band_stack_t *stack  /* I: band stack, before its first block */
+);
+
+void skip_band_stack_band_stats
+(
+    Espa_band_stack_t *stack, /* I: band stack, before its first block */
+    int band                  /* I: position of the band in the stack */
+);
+
+void drop_band_stack_pages
+(
+    Espa_band_stack_t *stack  /* I: band stack */
+);
+
+int get_band_stack_block
+(
+    Espa_band_stack_t *stack,       /* I: band stack */
+    Espa_band_block_t **block       /* O: next block; NULL once all the
+                                          blocks have been traversed */
+);
+
+void close_band_stack
+(
+    Espa_band_stack_t *stack        /* I: band stack to be closed */
+);
+
+#endif
@@ -0,0 +1,684 @@
+/*****************************************************************************
+FILE: espa_browse.c
+
+PURPOSE: Contains functions for building the browse image of a product as its
+bands are converted (see espa_browse.h).
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The PNG is written with zlib, which is already linked for the
+     compressed bands, as a single IDAT chunk of unfiltered lines.
+*****************************************************************************/
+
+#include <stdint.h>
+#include <math.h>
+#include <zlib.h>
+#include "espa_browse.h"
+
+/* Bands of the browse of an instrument */
+typedef struct
+{
+    const char *instrument;   /* part of the instrument name which must
+                                 match; NULL for any instrument */
+    const char *name[ESPA_BROWSE_NCHANNELS]; /* names of the red, green, and
+                                 blue bands */
+} Browse_bands_t;
+
+/* Bands of the browse, tried in order.  The MODIS and VIIRS bands are the
+   usual false color composites of the surface reflectance. */
+static const Browse_bands_t browse_bands[] =
+{
+    {"OLI", {"b4", "b3", "b2"}},                       /* Landsat 8/9 */
+    {NULL, {"b3", "b2", "b1"}},                        /* Landsat 4-7 */
+    {NULL, {"B04", "B03", "B02"}},                     /* Sentinel-2 */
+    {NULL, {"sur_refl_b01", "sur_refl_b04", "sur_refl_b03"}}, /* MODIS */
+    {NULL, {"SurfReflect_I3", "SurfReflect_I2", "SurfReflect_I1"}} /* VIIRS */
+};
+#define NUM_BROWSE_BANDS (sizeof (browse_bands) / sizeof (browse_bands[0]))
+
+/* Adds the valid pixels of a window of a band of the given type */
+#define ADD_BROWSE_PIXELS(type) \
+    { \
+        const type *pix = buf; \
+        for (line = 0; line < nlines; line++, pix += nsamps) \
+        { \
+            out = chan->line_map[line0 + line] * browse->nsamps; \
+            for (samp = 0; samp < nsamps; samp++) \
+            { \
+                if ((chan->use_fill && pix[samp] == (type) chan->fill_value) \
+                    || isnan ((double) pix[samp])) \
+                    continue; \
+                pixel = out + chan->samp_map[samp0 + samp]; \
+                chan->sum[pixel] += (double) pix[samp]; \
+                chan->count[pixel]++; \
+            } \
+        } \
+    }
+
+
+/******************************************************************************
+MODULE: find_browse_band
+
+PURPOSE: Finds a band of the browse in the metadata.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+-1           There is no such band
+>= 0         Index of the band in the metadata
+
+NOTES:
+  1. The band name matches if it is the name in the table, or the name
+     followed by an underscore (ex. sur_refl_b01_1 of the MODIS daily
+     products).  Constant bands have no pixels to add, so they don't match.
+*****************************************************************************/
+static int find_browse_band
+(
+    const Espa_internal_meta_t *xml_meta, /* I: metadata of the product */
+    const char *name     /* I: name of the band in the table */
+)
+{
+    int i;               /* looping variable for the bands */
+    size_t len = strlen (name); /* length of the name */
+    const Espa_band_meta_t *bmeta = NULL; /* metadata of the band */
+
+    for (i = 0; i < xml_meta->nbands; i++)
+    {
+        bmeta = &xml_meta->band[i];
+        if (strncmp (bmeta->name, name, len) != 0 ||
+            (bmeta->name[len] != '\0' && bmeta->name[len] != '_') ||
+            is_constant_band (bmeta))
+            continue;
+        return i;
+    }
+
+    return -1;
+}
+
+
+/******************************************************************************
+MODULE: open_espa_browse
+
+PURPOSE: Chooses the bands of the browse of the product and allocates the
+browse.
+
+RETURN VALUE:
+Type = Espa_browse_t *
+Value        Description
+-----        -----------
+NULL         The product has no bands for a browse, or error allocating it
+non-NULL     Browse with no pixels added
+
+NOTES:
+*****************************************************************************/
+Espa_browse_t *open_espa_browse
+(
+    const Espa_internal_meta_t *xml_meta, /* I: metadata of the product */
+    int max_size         /* I: largest number of lines or samples in the
+                               browse; 0 for ESPA_BROWSE_MAX_SIZE */
+)
+{
+    char FUNC_NAME[] = "open_espa_browse";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    int band[ESPA_BROWSE_NCHANNELS]; /* bands of the red, green, and blue */
+    int c;                    /* looping variable for the channels */
+    int i;                    /* looping variable */
+    int factor;               /* reduction of the red band */
+    size_t t;                 /* looping variable for the table */
+    size_t npixels;           /* number of pixels in the browse */
+    const Browse_bands_t *bands = NULL; /* bands of the browse */
+    const Espa_band_meta_t *bmeta = NULL; /* metadata of a band */
+    Espa_browse_channel_t *chan = NULL; /* current channel */
+    Espa_browse_t *browse = NULL; /* browse to be returned */
+
+    if (max_size <= 0)
+        max_size = ESPA_BROWSE_MAX_SIZE;
+
+    /* Find the first bands of the table which the product has */
+    for (t = 0; t < NUM_BROWSE_BANDS; t++)
+    {
+        bands = &browse_bands[t];
+        if (bands->instrument != NULL &&
+            strstr (xml_meta->global.instrument, bands->instrument) == NULL)
+            continue;
+        for (c = 0; c < ESPA_BROWSE_NCHANNELS; c++)
+        {
+            band[c] = find_browse_band (xml_meta, bands->name[c]);
+            if (band[c] < 0)
+                break;
+        }
+        if (c == ESPA_BROWSE_NCHANNELS)
+            break;
+    }
+    if (t == NUM_BROWSE_BANDS)
+    {
+        sprintf (errmsg, "No red, green, and blue bands for the browse of "
+            "the %s product", xml_meta->global.instrument);
+        error_handler (true, FUNC_NAME, errmsg);
+        return NULL;
+    }
+
+    browse = calloc (1, sizeof (Espa_browse_t));
+    if (browse == NULL)
+    {
+        sprintf (errmsg, "Allocating the browse");
+        error_handler (true, FUNC_NAME, errmsg);
+        return NULL;
+    }
+
+    /* Reduce the red band by a whole factor to fit the maximum size */
+    bmeta = &xml_meta->band[band[0]];
+    i = bmeta->nlines > bmeta->nsamps ? bmeta->nlines : bmeta->nsamps;
+    factor = (i + max_size - 1) / max_size;
+    if (factor < 1)
+        factor = 1;
+    browse->nlines = (bmeta->nlines + factor - 1) / factor;
+    browse->nsamps = (bmeta->nsamps + factor - 1) / factor;
+    npixels = (size_t) browse->nlines * browse->nsamps;
+
+    /* Map the lines and samples of each band onto the browse, which
+       covers the same area as each of them */
+    for (c = 0; c < ESPA_BROWSE_NCHANNELS; c++)
+    {
+        chan = &browse->channel[c];
+        bmeta = &xml_meta->band[band[c]];
+        chan->band = band[c];
+        chan->nlines = bmeta->nlines;
+        chan->nsamps = bmeta->nsamps;
+        chan->data_type = bmeta->data_type;
+        chan->use_fill = bmeta->fill_value != ESPA_INT_META_FILL;
+        chan->fill_value = bmeta->fill_value;
+
+        chan->line_map = malloc (bmeta->nlines * sizeof (int));
+        chan->samp_map = malloc (bmeta->nsamps * sizeof (int));
+        chan->sum = calloc (npixels, sizeof (double));
+        chan->count = calloc (npixels, sizeof (int));
+        if (chan->line_map == NULL || chan->samp_map == NULL ||
+            chan->sum == NULL || chan->count == NULL)
+        {
+            sprintf (errmsg, "Allocating the browse channel of band %s",
+                bmeta->name);
+            error_handler (true, FUNC_NAME, errmsg);
+            close_espa_browse (browse);
+            return NULL;
+        }
+
+        for (i = 0; i < bmeta->nlines; i++)
+            chan->line_map[i] = (long) i * browse->nlines / bmeta->nlines;
+        for (i = 0; i < bmeta->nsamps; i++)
+            chan->samp_map[i] = (long) i * browse->nsamps / bmeta->nsamps;
+    }
+
+    return browse;
+}
+
+
+/******************************************************************************
+MODULE: espa_browse_channel
+
+PURPOSE: Finds the channel of the browse of a band.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+-1           The band isn't in the browse, or there is no browse
+>= 0         Channel of the band
+
+NOTES:
+*****************************************************************************/
+int espa_browse_channel
+(
+    const Espa_browse_t *browse, /* I: browse being built; may be NULL */
+    int band             /* I: index of the band in the metadata */
+)
+{
+    int c;               /* looping variable for the channels */
+
+    if (browse == NULL)
+        return -1;
+
+    for (c = 0; c < ESPA_BROWSE_NCHANNELS; c++)
+    {
+        if (browse->channel[c].band == band)
+            return c;
+    }
+
+    return -1;
+}
+
+
+/******************************************************************************
+MODULE: add_espa_browse_window
+
+PURPOSE: Adds the pixels of a window of a band to its channel of the browse.
+
+RETURN VALUE: None
+
+NOTES:
+  1. The window must lie within the band; its pixels are stored line after
+     line with no padding.
+*****************************************************************************/
+void add_espa_browse_window
+(
+    Espa_browse_t *browse, /* I/O: browse being built */
+    int channel,         /* I: channel of the band (see espa_browse_channel) */
+    int line0,           /* I: first line of the window in the band */
+    int nlines,          /* I: number of lines in the window */
+    int samp0,           /* I: first sample of the window in the band */
+    int nsamps,          /* I: number of samples in the window */
+    const void *buf      /* I: nlines * nsamps pixels of the window */
+)
+{
+    int line;            /* looping variable for the lines */
+    int samp;            /* looping variable for the samples */
+    size_t out;          /* first browse pixel of the browse line */
+    size_t pixel;        /* browse pixel of the current pixel */
+    Espa_browse_channel_t *chan = &browse->channel[channel]; /* channel of
+                                                               the band */
+
+    switch (chan->data_type)
+    {
+        case ESPA_INT8:
+            ADD_BROWSE_PIXELS (int8_t);
+            break;
+        case ESPA_UINT8:
+            ADD_BROWSE_PIXELS (uint8_t);
+            break;
+        case ESPA_INT16:
+            ADD_BROWSE_PIXELS (int16_t);
+            break;
+        case ESPA_UINT16:
+            ADD_BROWSE_PIXELS (uint16_t);
+            break;
+        case ESPA_INT32:
+            ADD_BROWSE_PIXELS (int32_t);
+            break;
+        case ESPA_UINT32:
+            ADD_BROWSE_PIXELS (uint32_t);
+            break;
+        case ESPA_FLOAT32:
+            ADD_BROWSE_PIXELS (float);
+            break;
+        case ESPA_FLOAT64:
+            ADD_BROWSE_PIXELS (double);
+            break;
+    }
+}
+
+
+/******************************************************************************
+MODULE: browse_stretch
+
+PURPOSE: Determines the pixel values of a channel stretched to black and to
+white.
+
+RETURN VALUE: None
+
+NOTES:
+  1. The percentiles come from the histogram of the band.  A band with
+     statistics but no histogram (ex. a float band without a valid_range) is
+     stretched over two standard deviations from its mean, and a band
+     without statistics over the range of its browse pixels.
+*****************************************************************************/
+static void browse_stretch
+(
+    const Espa_browse_channel_t *chan, /* I: channel of the browse */
+    size_t npixels,      /* I: number of pixels in the browse */
+    const Espa_band_stats_t *stats, /* I: statistics of the band */
+    double *low,         /* O: pixel value stretched to black */
+    double *high         /* O: pixel value stretched to white */
+)
+{
+    int bin;             /* looping variable for the histogram */
+    int low_bin = -1;    /* bin of the low percentile */
+    int high_bin = -1;   /* bin of the high percentile */
+    long total = 0;      /* number of pixels in the histogram */
+    long cum = 0;        /* number of pixels in the bins so far */
+    double width;        /* width of a bin */
+    double mean;         /* mean of a browse pixel */
+    size_t i;            /* looping variable for the browse pixels */
+    bool found = false;  /* has a valid browse pixel been found? */
+
+    *low = 0.0;
+    *high = 0.0;
+    if (stats->valid_count > 0 && stats->nbins > 0)
+    {
+        for (bin = 0; bin < stats->nbins; bin++)
+            total += stats->histogram[bin];
+        for (bin = 0; bin < stats->nbins; bin++)
+        {
+            cum += stats->histogram[bin];
+            if (low_bin < 0 && cum >= total * ESPA_BROWSE_LOW_PCT / 100.0)
+                low_bin = bin;
+            if (cum >= total * ESPA_BROWSE_HIGH_PCT / 100.0)
+            {
+                high_bin = bin;
+                break;
+            }
+        }
+        if (high_bin < 0)
+            high_bin = stats->nbins - 1;
+        width = (stats->hist_max - stats->hist_min) / stats->nbins;
+        *low = stats->hist_min + low_bin * width;
+        *high = stats->hist_min + (high_bin + 1) * width;
+    }
+    else if (stats->valid_count > 0)
+    {
+        *low = stats->mean - 2.0 * stats->stddev;
+        *high = stats->mean + 2.0 * stats->stddev;
+        if (*low < stats->min)
+            *low = stats->min;
+        if (*high > stats->max)
+            *high = stats->max;
+    }
+    else
+    {
+        for (i = 0; i < npixels; i++)
+        {
+            if (chan->count[i] == 0)
+                continue;
+            mean = chan->sum[i] / chan->count[i];
+            if (!found || mean < *low)
+                *low = mean;
+            if (!found || mean > *high)
+                *high = mean;
+            found = true;
+        }
+    }
+
+    if (*high <= *low)
+        *high = *low + 1.0;
+}
+
+
+/******************************************************************************
+MODULE: write_png_chunk
+
+PURPOSE: Writes a chunk of the PNG file.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error writing the chunk
+SUCCESS      Successful write
+
+NOTES:
+*****************************************************************************/
+static int write_png_chunk
+(
+    FILE *fp,            /* I: PNG file */
+    const char *type,    /* I: 4-character type of the chunk */
+    const unsigned char *data, /* I: data of the chunk */
+    size_t len           /* I: number of bytes of data */
+)
+{
+    unsigned char head[8];  /* length and type of the chunk */
+    unsigned char tail[4];  /* CRC of the chunk */
+    uLong crc;              /* CRC of the type and data */
+
+    head[0] = (len >> 24) & 0xff;
+    head[1] = (len >> 16) & 0xff;
+    head[2] = (len >> 8) & 0xff;
+    head[3] = len & 0xff;
+    memcpy (&head[4], type, 4);
+    crc = crc32 (0L, &head[4], 4);
+    if (len > 0)
+        crc = crc32 (crc, data, len);
+    tail[0] = (crc >> 24) & 0xff;
+    tail[1] = (crc >> 16) & 0xff;
+    tail[2] = (crc >> 8) & 0xff;
+    tail[3] = crc & 0xff;
+
+    if (fwrite (head, 1, sizeof (head), fp) != sizeof (head) ||
+        (len > 0 && fwrite (data, 1, len, fp) != len) ||
+        fwrite (tail, 1, sizeof (tail), fp) != sizeof (tail))
+        return ERROR;
+
+    return SUCCESS;
+}
+
+
+/******************************************************************************
+MODULE: write_espa_browse
+
+PURPOSE: Stretches the channels of the browse and writes it as a PNG file
+named after the XML metadata file (see espa_browse_file_name).
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error writing the browse
+SUCCESS      Successfully wrote the browse
+
+NOTES:
+*****************************************************************************/
+int write_espa_browse
+(
+    const Espa_browse_t *browse, /* I: browse with all the pixels added */
+    const Espa_internal_meta_t *xml_meta, /* I: metadata of the product,
+                                             with the statistics of the
+                                             bands */
+    const char *xml_file /* I: name of the XML metadata file, which the
+                               browse file is named after */
+)
+{
+    char FUNC_NAME[] = "write_espa_browse";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    char browse_file[STR_SIZE]; /* name of the PNG file */
+    static const unsigned char signature[8] =
+        {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'}; /* PNG signature */
+    unsigned char ihdr[13];   /* header chunk */
+    unsigned char *image = NULL; /* filtered lines of the RGBA image */
+    unsigned char *zimage = NULL; /* compressed image */
+    unsigned char *ptr = NULL;   /* current position in the image */
+    int c;                    /* looping variable for the channels */
+    int line;                 /* looping variable for the lines */
+    int samp;                 /* looping variable for the samples */
+    int value;                /* stretched pixel value */
+    int status;               /* status of the zlib and file calls */
+    bool valid;               /* does the pixel have any valid bands? */
+    size_t pixel;             /* index of the browse pixel */
+    size_t row_bytes;         /* number of bytes in a filtered line */
+    size_t image_bytes;       /* number of bytes in the image */
+    uLongf zbytes;            /* number of bytes in the compressed image */
+    double low[ESPA_BROWSE_NCHANNELS];  /* value stretched to black */
+    double scale[ESPA_BROWSE_NCHANNELS]; /* gray levels per pixel value */
+    double high;              /* value stretched to white */
+    const Espa_browse_channel_t *chan = NULL; /* current channel */
+    FILE *fp = NULL;          /* PNG file */
+
+    if (espa_browse_file_name (xml_file, browse_file) != SUCCESS)
+        return ERROR;   /* error message already written */
+
+    for (c = 0; c < ESPA_BROWSE_NCHANNELS; c++)
+    {
+        chan = &browse->channel[c];
+        browse_stretch (chan, (size_t) browse->nlines * browse->nsamps,
+            &xml_meta->band[chan->band].stats, &low[c], &high);
+        scale[c] = 255.0 / (high - low[c]);
+    }
+
+    /* Stretch the channels into the RGBA lines, each of them following its
+       filter type (0 for none) */
+    row_bytes = (size_t) browse->nsamps * 4 + 1;
+    image_bytes = row_bytes * browse->nlines;
+    zbytes = compressBound (image_bytes);
+    image = malloc (image_bytes);
+    zimage = malloc (zbytes);
+    if (image == NULL || zimage == NULL)
+    {
+        sprintf (errmsg, "Allocating the %d x %d browse image",
+            browse->nlines, browse->nsamps);
+        error_handler (true, FUNC_NAME, errmsg);
+        free (image);
+        free (zimage);
+        return ERROR;
+    }
+
+    ptr = image;
+    for (line = 0; line < browse->nlines; line++)
+    {
+        *ptr++ = 0;
+        for (samp = 0; samp < browse->nsamps; samp++)
+        {
+            pixel = (size_t) line * browse->nsamps + samp;
+            valid = false;
+            for (c = 0; c < ESPA_BROWSE_NCHANNELS; c++)
+            {
+                chan = &browse->channel[c];
+                value = 0;
+                if (chan->count[pixel] > 0)
+                {
+                    value = (int) floor ((chan->sum[pixel] /
+                        chan->count[pixel] - low[c]) * scale[c] + 0.5);
+                    if (value < 0)
+                        value = 0;
+                    else if (value > 255)
+                        value = 255;
+                    valid = true;
+                }
+                *ptr++ = value;
+            }
+            *ptr++ = valid ? 255 : 0;
+        }
+    }
+
+    status = compress2 (zimage, &zbytes, image, image_bytes,
+        Z_DEFAULT_COMPRESSION);
+    free (image);
+    if (status != Z_OK)
+    {
+        sprintf (errmsg, "Compressing the browse image: zlib error %d",
+            status);
+        error_handler (true, FUNC_NAME, errmsg);
+        free (zimage);
+        return ERROR;
+    }
+
+    /* Header: size, 8 bits per channel, RGBA, deflate, no interlace */
+    ihdr[0] = (browse->nsamps >> 24) & 0xff;
+    ihdr[1] = (browse->nsamps >> 16) & 0xff;
+    ihdr[2] = (browse->nsamps >> 8) & 0xff;
+    ihdr[3] = browse->nsamps & 0xff;
+    ihdr[4] = (browse->nlines >> 24) & 0xff;
+    ihdr[5] = (browse->nlines >> 16) & 0xff;
+    ihdr[6] = (browse->nlines >> 8) & 0xff;
+    ihdr[7] = browse->nlines & 0xff;
+    ihdr[8] = 8;
+    ihdr[9] = 6;
+    ihdr[10] = 0;
+    ihdr[11] = 0;
+    ihdr[12] = 0;
+
+    fp = fopen (browse_file, "wb");
+    if (fp == NULL)
+    {
+        sprintf (errmsg, "Creating the browse file %s", browse_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        free (zimage);
+        return ERROR;
+    }
+    status = SUCCESS;
+    if (fwrite (signature, 1, sizeof (signature), fp) != sizeof (signature)
+        || write_png_chunk (fp, "IHDR", ihdr, sizeof (ihdr)) != SUCCESS ||
+        write_png_chunk (fp, "IDAT", zimage, zbytes) != SUCCESS ||
+        write_png_chunk (fp, "IEND", NULL, 0) != SUCCESS)
+        status = ERROR;
+    if (fclose (fp) != 0)
+        status = ERROR;
+    free (zimage);
+    if (status != SUCCESS)
+    {
+        sprintf (errmsg, "Writing the browse file %s", browse_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return ERROR;
+    }
+
+    return SUCCESS;
+}
+
+
+/******************************************************************************
+MODULE: espa_browse_file_name
+
+PURPOSE: Names the browse file of a product after its XML metadata file.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        The name doesn't fit
+SUCCESS      Successfully named the browse file
+
+NOTES:
+*****************************************************************************/
+int espa_browse_file_name
+(
+    const char *xml_file,  /* I: name of the XML metadata file */
+    char *browse_file      /* O: name of the browse file; STR_SIZE bytes */
+)
+{
+    char FUNC_NAME[] = "espa_browse_file_name";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    char *cptr = NULL;        /* pointer to the file extension */
+    int count;                /* number of chars copied in snprintf */
+
+    count = snprintf (browse_file, STR_SIZE, "%s", xml_file);
+    if (count < 0 || count >= STR_SIZE)
+    {
+        sprintf (errmsg, "Overflow of the browse file name");
+        error_handler (true, FUNC_NAME, errmsg);
+        return ERROR;
+    }
+    cptr = strrchr (browse_file, '.');
+    if (cptr != NULL && strcmp (cptr, ".xml") == 0)
+        *cptr = '\0';
+
+    if (strlen (browse_file) + strlen (ESPA_BROWSE_SUFFIX) >= STR_SIZE)
+    {
+        sprintf (errmsg, "Overflow of the browse file name");
+        error_handler (true, FUNC_NAME, errmsg);
+        return ERROR;
+    }
+    strcat (browse_file, ESPA_BROWSE_SUFFIX);
+
+    return SUCCESS;
+}
+
+
+/******************************************************************************
+MODULE: close_espa_browse
+
+PURPOSE: Frees the browse.
+
+RETURN VALUE: None
+
+NOTES:
+*****************************************************************************/
+void close_espa_browse
+(
+    Espa_browse_t *browse  /* I: browse to be freed; may be NULL */
+)
+{
+    int c;               /* looping variable for the channels */
+
+    if (browse == NULL)
+        return;
+
+    for (c = 0; c < ESPA_BROWSE_NCHANNELS; c++)
+    {
+        free (browse->channel[c].line_map);
+        free (browse->channel[c].samp_map);
+        free (browse->channel[c].sum);
+        free (browse->channel[c].count);
+    }
+    free (browse);
+}
@@ -0,0 +1,121 @@
+/*****************************************************************************
+FILE: espa_browse.h
+
+PURPOSE: Contains defines, structures, and prototypes for the browse image of
+a product, which is a reduced resolution RGB image of three of its bands
+built while the bands are converted, so the bands aren't read again for it.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The red, green, and blue bands are chosen by name from a table of the
+     bands of the supported instruments (see open_espa_browse).  The browse
+     has the aspect of the red band, reduced by a whole factor so neither its
+     lines nor its samples exceed the maximum size.
+  2. Each browse pixel is the mean of the valid pixels of the band which
+     fall in it, leaving out the fill pixels and NaN.  The pixels of each
+     band are added as they are converted, in any order; each channel has
+     its own sums, so the three bands may be converted in parallel.
+  3. Each channel is stretched from the ESPA_BROWSE_LOW_PCT to the
+     ESPA_BROWSE_HIGH_PCT percentile of the statistics of its band, which
+     were also computed as the band was converted (see raw_binary_stats.h).
+  4. The browse is written as an 8-bit RGBA PNG; the browse pixels with no
+     valid pixels in any of the bands are transparent.
+*****************************************************************************/
+
+#ifndef ESPA_BROWSE_H
+#define ESPA_BROWSE_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include "error_handler.h"
+#include "espa_metadata.h"
+
+/* Defines */
+#define ESPA_BROWSE_SUFFIX "_browse.png" /* suffix of the browse file name,
+                                     following the XML file name without
+                                     its extension */
+#define ESPA_BROWSE_MAX_SIZE 1000  /* default largest number of lines or
+                                      samples in the browse */
+#define ESPA_BROWSE_LOW_PCT 2.0    /* percentile stretched to black */
+#define ESPA_BROWSE_HIGH_PCT 98.0  /* percentile stretched to white */
+#define ESPA_BROWSE_NCHANNELS 3    /* red, green, and blue */
+
+/* Channel of the browse, which is one band of the product */
+typedef struct
+{
+    int band;                 /* index of the band in the metadata */
+    int nlines;               /* number of lines in the band */
+    int nsamps;               /* number of samples in the band */
+    enum Espa_data_type data_type; /* data type of the band */
+    bool use_fill;            /* leave out the pixels equal to fill_value? */
+    long fill_value;          /* fill value of the band */
+    int *line_map;            /* browse line of each line of the band */
+    int *samp_map;            /* browse sample of each sample of the band */
+    double *sum;              /* sum of the valid pixels of each browse
+                                 pixel */
+    int *count;               /* number of valid pixels of each browse
+                                 pixel */
+} Espa_browse_channel_t;
+
+/* Browse image being built */
+typedef struct
+{
+    int nlines;               /* number of lines in the browse */
+    int nsamps;               /* number of samples in the browse */
+    Espa_browse_channel_t channel[ESPA_BROWSE_NCHANNELS]; /* red, green, and
+                                 blue channels */
+} Espa_browse_t;
+
+/* Prototypes */
+Espa_browse_t *open_espa_browse
+(
+    const Espa_internal_meta_t *xml_meta, /* I: metadata of the product */
+    int max_size         /* I: largest number of lines or samples in the
+                               browse; 0 for ESPA_BROWSE_MAX_SIZE */
+);
+
+int espa_browse_channel
+(
+    const Espa_browse_t *browse, /* I: browse being built; may be NULL */
+    int band             /* I: index of the band in the metadata */
+);
+
+void add_espa_browse_window
+(
+    Espa_browse_t *browse, /* I/O: browse being built */
+    int channel,         /* I: channel of the band (see espa_browse_channel) */
+    int line0,           /* I: first line of the window in the band */
+    int nlines,          /* I: number of lines in the window */
+    int samp0,           /* I: first sample of the window in the band */
+    int nsamps,          /* I: number of samples in the window */
+    const void *buf      /* I: nlines * nsamps pixels of the window */
+);
+
+int write_espa_browse
+(
+    const Espa_browse_t *browse, /* I: browse with all the pixels added */
+    const Espa_internal_meta_t *xml_meta, /* I: metadata of the product,
+                                             with the statistics of the
+                                             bands */
+    const char *xml_file /* I: name of the XML metadata file, which the
+                               browse file is named after */
+);
+
+int espa_browse_file_name
+(
+    const char *xml_file,  /* I: name of the XML metadata file */
+    char *browse_file      /* O: name of the browse file; STR_SIZE bytes */
+);
+
+void close_espa_browse
+(
+    Espa_browse_t *browse  /* I: browse to be freed; may be NULL */
+);
+
+#endif
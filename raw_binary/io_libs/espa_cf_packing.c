@@ -0,0 +1,1031 @@
+/*****************************************************************************
+FILE: espa_cf_packing.c
+
+PURPOSE: Contains functions for converting between the packed integer pixels
+of a band and its physical values (see espa_cf_packing.h).
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The kernels and the scalar loops of the 16-bit types do the same float
+     operations in the same order, so the results don't depend on the
+     kernels chosen.  The other data types are converted in double
+     precision.
+*****************************************************************************/
+
+#include <math.h>
+#include <stdint.h>
+#include "espa_cf_packing.h"
+#include "espa_cpu_dispatch.h"
+#include "espa_pixel_convert.h"
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#define CF_PACKING_X86
+#endif
+
+/* Kernel unpacking 16-bit pixels; returns the number of pixels done */
+typedef long (*Cf_unpack16_kernel_t)
+(
+    const void *in,      /* I: packed pixels */
+    long n,              /* I: number of pixels */
+    float scale,         /* I: scale factor */
+    float offset,        /* I: add offset */
+    int fill,            /* I: fill value */
+    bool has_fill,       /* I: does the band have a fill value? */
+    float *out           /* O: physical values */
+);
+
+/* Kernel packing 16-bit pixels; returns the number of pixels done */
+typedef long (*Cf_pack16_kernel_t)
+(
+    const float *in,     /* I: physical values */
+    long n,              /* I: number of pixels */
+    float scale,         /* I: scale factor */
+    float offset,        /* I: add offset */
+    int fill,            /* I: packed value of NaN */
+    void *out            /* O: packed pixels */
+);
+
+
+#ifdef CF_PACKING_X86
+/******************************************************************************
+MODULE: cf_unpack_finish_sse2
+
+PURPOSE: Scales 4 pixels widened to 32 bits, replacing the fill pixels with
+NaN.
+
+RETURN VALUE:
+Type = __m128
+Value        Description
+-----        -----------
+v            Physical values
+******************************************************************************/
+static inline __m128 cf_unpack_finish_sse2
+(
+    __m128i v,           /* I: pixels widened to 32 bits */
+    __m128 vscale,       /* I: scale factor */
+    __m128 voffset,      /* I: add offset */
+    __m128i vfill,       /* I: fill value widened to 32 bits */
+    __m128i vuse_fill    /* I: all ones if the band has a fill value */
+)
+{
+    __m128 m;            /* fill pixels */
+    __m128 p;            /* physical values */
+
+    m = _mm_castsi128_ps (_mm_and_si128 (_mm_cmpeq_epi32 (v, vfill),
+        vuse_fill));
+    p = _mm_add_ps (_mm_mul_ps (_mm_cvtepi32_ps (v), vscale), voffset);
+    return (_mm_or_ps (_mm_and_ps (m, _mm_set1_ps (NAN)),
+        _mm_andnot_ps (m, p)));
+}
+
+
+/******************************************************************************
+MODULE: cf_unpack_i16_sse2, cf_unpack_u16_sse2
+
+PURPOSE: Unpacks 8 signed or unsigned 16-bit pixels at a time.
+
+RETURN VALUE:
+Type = long
+Value        Description
+-----        -----------
+n            Number of pixels done
+******************************************************************************/
+static long cf_unpack_i16_sse2
+(
+    const void *in,      /* I: packed pixels */
+    long n,              /* I: number of pixels */
+    float scale,         /* I: scale factor */
+    float offset,        /* I: add offset */
+    int fill,            /* I: fill value */
+    bool has_fill,       /* I: does the band have a fill value? */
+    float *out           /* O: physical values */
+)
+{
+    long i;              /* current pixel */
+    const int16_t *pix = in;                 /* packed pixels */
+    __m128 vscale = _mm_set1_ps (scale);     /* scale factor */
+    __m128 voffset = _mm_set1_ps (offset);   /* add offset */
+    __m128i vfill = _mm_set1_epi32 (fill);   /* fill value */
+    __m128i vuse_fill = _mm_set1_epi32 (has_fill ? -1 : 0);  /* fill mask */
+    __m128i v;           /* vector of pixels */
+
+    for (i = 0; i + 8 <= n; i += 8)
+    {
+        v = _mm_loadu_si128 ((const __m128i *) (pix + i));
+        _mm_storeu_ps (out + i, cf_unpack_finish_sse2 (_mm_srai_epi32
+            (_mm_unpacklo_epi16 (v, v), 16), vscale, voffset, vfill,
+            vuse_fill));
+        _mm_storeu_ps (out + i + 4, cf_unpack_finish_sse2 (_mm_srai_epi32
+            (_mm_unpackhi_epi16 (v, v), 16), vscale, voffset, vfill,
+            vuse_fill));
+    }
+
+    return i;
+}
+
+static long cf_unpack_u16_sse2
+(
+    const void *in,      /* I: packed pixels */
+    long n,              /* I: number of pixels */
+    float scale,         /* I: scale factor */
+    float offset,        /* I: add offset */
+    int fill,            /* I: fill value */
+    bool has_fill,       /* I: does the band have a fill value? */
+    float *out           /* O: physical values */
+)
+{
+    long i;              /* current pixel */
+    const uint16_t *pix = in;                /* packed pixels */
+    __m128 vscale = _mm_set1_ps (scale);     /* scale factor */
+    __m128 voffset = _mm_set1_ps (offset);   /* add offset */
+    __m128i vfill = _mm_set1_epi32 (fill);   /* fill value */
+    __m128i vuse_fill = _mm_set1_epi32 (has_fill ? -1 : 0);  /* fill mask */
+    __m128i zero = _mm_setzero_si128 ();     /* zero extension */
+    __m128i v;           /* vector of pixels */
+
+    for (i = 0; i + 8 <= n; i += 8)
+    {
+        v = _mm_loadu_si128 ((const __m128i *) (pix + i));
+        _mm_storeu_ps (out + i, cf_unpack_finish_sse2 (_mm_unpacklo_epi16
+            (v, zero), vscale, voffset, vfill, vuse_fill));
+        _mm_storeu_ps (out + i + 4, cf_unpack_finish_sse2
+            (_mm_unpackhi_epi16 (v, zero), vscale, voffset, vfill,
+            vuse_fill));
+    }
+
+    return i;
+}
+
+
+/******************************************************************************
+MODULE: cf_pack_start_sse2
+
+PURPOSE: Packs 4 physical values into 32-bit integers clamped to [lo, hi],
+with NaN packed as the fill value.
+
+RETURN VALUE:
+Type = __m128i
+Value        Description
+-----        -----------
+v            Packed values, as 32-bit integers
+******************************************************************************/
+static inline __m128i cf_pack_start_sse2
+(
+    __m128 v,            /* I: physical values */
+    __m128 vscale,       /* I: scale factor */
+    __m128 voffset,      /* I: add offset */
+    __m128 vlo,          /* I: smallest packed value */
+    __m128 vhi,          /* I: largest packed value */
+    __m128i vfill        /* I: packed value of NaN */
+)
+{
+    __m128i m;           /* NaN values */
+    __m128i q;           /* packed values */
+
+    m = _mm_castps_si128 (_mm_cmpunord_ps (v, v));
+    q = _mm_cvtps_epi32 (_mm_min_ps (_mm_max_ps (_mm_div_ps (_mm_sub_ps (v,
+        voffset), vscale), vlo), vhi));
+    return (_mm_or_si128 (_mm_and_si128 (m, vfill), _mm_andnot_si128 (m, q)));
+}
+
+
+/******************************************************************************
+MODULE: cf_pack_i16_sse2, cf_pack_u16_sse2
+
+PURPOSE: Packs 8 physical values at a time into signed or unsigned 16-bit
+pixels.
+
+RETURN VALUE:
+Type = long
+Value        Description
+-----        -----------
+n            Number of pixels done
+
+NOTES:
+  1. SSE2 has no unsigned pack, so the unsigned values are offset into the
+     signed range, packed, and offset back.
+******************************************************************************/
+static long cf_pack_i16_sse2
+(
+    const float *in,     /* I: physical values */
+    long n,              /* I: number of pixels */
+    float scale,         /* I: scale factor */
+    float offset,        /* I: add offset */
+    int fill,            /* I: packed value of NaN */
+    void *out            /* O: packed pixels */
+)
+{
+    long i;              /* current pixel */
+    int16_t *pix = out;  /* packed pixels */
+    __m128 vscale = _mm_set1_ps (scale);     /* scale factor */
+    __m128 voffset = _mm_set1_ps (offset);   /* add offset */
+    __m128 vlo = _mm_set1_ps (INT16_MIN);    /* smallest packed value */
+    __m128 vhi = _mm_set1_ps (INT16_MAX);    /* largest packed value */
+    __m128i vfill = _mm_set1_epi32 (fill);   /* packed value of NaN */
+    __m128i lo;          /* first 4 packed values */
+    __m128i hi;          /* next 4 packed values */
+
+    for (i = 0; i + 8 <= n; i += 8)
+    {
+        lo = cf_pack_start_sse2 (_mm_loadu_ps (in + i), vscale, voffset,
+            vlo, vhi, vfill);
+        hi = cf_pack_start_sse2 (_mm_loadu_ps (in + i + 4), vscale, voffset,
+            vlo, vhi, vfill);
+        _mm_storeu_si128 ((__m128i *) (pix + i), _mm_packs_epi32 (lo, hi));
+    }
+
+    return i;
+}
+
+static long cf_pack_u16_sse2
+(
+    const float *in,     /* I: physical values */
+    long n,              /* I: number of pixels */
+    float scale,         /* I: scale factor */
+    float offset,        /* I: add offset */
+    int fill,            /* I: packed value of NaN */
+    void *out            /* O: packed pixels */
+)
+{
+    long i;              /* current pixel */
+    uint16_t *pix = out; /* packed pixels */
+    __m128 vscale = _mm_set1_ps (scale);     /* scale factor */
+    __m128 voffset = _mm_set1_ps (offset);   /* add offset */
+    __m128 vlo = _mm_set1_ps (0.0f);         /* smallest packed value */
+    __m128 vhi = _mm_set1_ps (UINT16_MAX);   /* largest packed value */
+    __m128i vfill = _mm_set1_epi32 (fill);   /* packed value of NaN */
+    __m128i bias32 = _mm_set1_epi32 (32768); /* offset into signed range */
+    __m128i bias16 = _mm_set1_epi16 ((short) 0x8000);  /* offset back */
+    __m128i lo;          /* first 4 packed values */
+    __m128i hi;          /* next 4 packed values */
+
+    for (i = 0; i + 8 <= n; i += 8)
+    {
+        lo = _mm_sub_epi32 (cf_pack_start_sse2 (_mm_loadu_ps (in + i),
+            vscale, voffset, vlo, vhi, vfill), bias32);
+        hi = _mm_sub_epi32 (cf_pack_start_sse2 (_mm_loadu_ps (in + i + 4),
+            vscale, voffset, vlo, vhi, vfill), bias32);
+        _mm_storeu_si128 ((__m128i *) (pix + i), _mm_xor_si128
+            (_mm_packs_epi32 (lo, hi), bias16));
+    }
+
+    return i;
+}
+
+
+/******************************************************************************
+MODULE: cf_unpack_finish_avx2
+
+PURPOSE: Scales 8 pixels widened to 32 bits, replacing the fill pixels with
+NaN.
+
+RETURN VALUE:
+Type = __m256
+Value        Description
+-----        -----------
+v            Physical values
+
+NOTES:
+  1. Only called from the AVX2 kernels.
+******************************************************************************/
+__attribute__ ((target ("avx2")))
+static inline __m256 cf_unpack_finish_avx2
+(
+    __m256i v,           /* I: pixels widened to 32 bits */
+    __m256 vscale,       /* I: scale factor */
+    __m256 voffset,      /* I: add offset */
+    __m256i vfill,       /* I: fill value widened to 32 bits */
+    __m256i vuse_fill    /* I: all ones if the band has a fill value */
+)
+{
+    __m256 m;            /* fill pixels */
+    __m256 p;            /* physical values */
+
+    m = _mm256_castsi256_ps (_mm256_and_si256 (_mm256_cmpeq_epi32 (v,
+        vfill), vuse_fill));
+    p = _mm256_add_ps (_mm256_mul_ps (_mm256_cvtepi32_ps (v), vscale),
+        voffset);
+    return (_mm256_blendv_ps (p, _mm256_set1_ps (NAN), m));
+}
+
+
+/******************************************************************************
+MODULE: cf_unpack_i16_avx2, cf_unpack_u16_avx2
+
+PURPOSE: Unpacks 16 signed or unsigned 16-bit pixels at a time.
+
+RETURN VALUE:
+Type = long
+Value        Description
+-----        -----------
+n            Number of pixels done
+
+NOTES:
+  1. Only put in the kernel table when the CPU supports AVX2.
+******************************************************************************/
+__attribute__ ((target ("avx2")))
+static long cf_unpack_i16_avx2
+(
+    const void *in,      /* I: packed pixels */
+    long n,              /* I: number of pixels */
+    float scale,         /* I: scale factor */
+    float offset,        /* I: add offset */
+    int fill,            /* I: fill value */
+    bool has_fill,       /* I: does the band have a fill value? */
+    float *out           /* O: physical values */
+)
+{
+    long i;              /* current pixel */
+    const int16_t *pix = in;                   /* packed pixels */
+    __m256 vscale = _mm256_set1_ps (scale);    /* scale factor */
+    __m256 voffset = _mm256_set1_ps (offset);  /* add offset */
+    __m256i vfill = _mm256_set1_epi32 (fill);  /* fill value */
+    __m256i vuse_fill = _mm256_set1_epi32 (has_fill ? -1 : 0);
+                                               /* fill mask */
+
+    for (i = 0; i + 16 <= n; i += 16)
+    {
+        _mm256_storeu_ps (out + i, cf_unpack_finish_avx2
+            (_mm256_cvtepi16_epi32 (_mm_loadu_si128 ((const __m128i *)
+            (pix + i))), vscale, voffset, vfill, vuse_fill));
+        _mm256_storeu_ps (out + i + 8, cf_unpack_finish_avx2
+            (_mm256_cvtepi16_epi32 (_mm_loadu_si128 ((const __m128i *)
+            (pix + i + 8))), vscale, voffset, vfill, vuse_fill));
+    }
+
+    return i;
+}
+
+__attribute__ ((target ("avx2")))
+static long cf_unpack_u16_avx2
+(
+    const void *in,      /* I: packed pixels */
+    long n,              /* I: number of pixels */
+    float scale,         /* I: scale factor */
+    float offset,        /* I: add offset */
+    int fill,            /* I: fill value */
+    bool has_fill,       /* I: does the band have a fill value? */
+    float *out           /* O: physical values */
+)
+{
+    long i;              /* current pixel */
+    const uint16_t *pix = in;                  /* packed pixels */
+    __m256 vscale = _mm256_set1_ps (scale);    /* scale factor */
+    __m256 voffset = _mm256_set1_ps (offset);  /* add offset */
+    __m256i vfill = _mm256_set1_epi32 (fill);  /* fill value */
+    __m256i vuse_fill = _mm256_set1_epi32 (has_fill ? -1 : 0);
+                                               /* fill mask */
+
+    for (i = 0; i + 16 <= n; i += 16)
+    {
+        _mm256_storeu_ps (out + i, cf_unpack_finish_avx2
+            (_mm256_cvtepu16_epi32 (_mm_loadu_si128 ((const __m128i *)
+            (pix + i))), vscale, voffset, vfill, vuse_fill));
+        _mm256_storeu_ps (out + i + 8, cf_unpack_finish_avx2
+            (_mm256_cvtepu16_epi32 (_mm_loadu_si128 ((const __m128i *)
+            (pix + i + 8))), vscale, voffset, vfill, vuse_fill));
+    }
+
+    return i;
+}
+
+
+/******************************************************************************
+MODULE: cf_pack_start_avx2
+
+PURPOSE: Packs 8 physical values into 32-bit integers clamped to [lo, hi],
+with NaN packed as the fill value.
+
+RETURN VALUE:
+Type = __m256i
+Value        Description
+-----        -----------
+v            Packed values, as 32-bit integers
+
+NOTES:
+  1. Only called from the AVX2 kernels.
+******************************************************************************/
+__attribute__ ((target ("avx2")))
+static inline __m256i cf_pack_start_avx2
+(
+    __m256 v,            /* I: physical values */
+    __m256 vscale,       /* I: scale factor */
+    __m256 voffset,      /* I: add offset */
+    __m256 vlo,          /* I: smallest packed value */
+    __m256 vhi,          /* I: largest packed value */
+    __m256i vfill        /* I: packed value of NaN */
+)
+{
+    __m256i m;           /* NaN values */
+    __m256i q;           /* packed values */
+
+    m = _mm256_castps_si256 (_mm256_cmp_ps (v, v, _CMP_UNORD_Q));
+    q = _mm256_cvtps_epi32 (_mm256_min_ps (_mm256_max_ps (_mm256_div_ps
+        (_mm256_sub_ps (v, voffset), vscale), vlo), vhi));
+    return (_mm256_blendv_epi8 (q, vfill, m));
+}
+
+
+/******************************************************************************
+MODULE: cf_pack_i16_avx2, cf_pack_u16_avx2
+
+PURPOSE: Packs 16 physical values at a time into signed or unsigned 16-bit
+pixels.
+
+RETURN VALUE:
+Type = long
+Value        Description
+-----        -----------
+n            Number of pixels done
+
+NOTES:
+  1. Only put in the kernel table when the CPU supports AVX2.
+  2. The packs interleave the 128-bit lanes of their operands, so the 64-bit
+     quarters are put back in order.
+******************************************************************************/
+__attribute__ ((target ("avx2")))
+static long cf_pack_i16_avx2
+(
+    const float *in,     /* I: physical values */
+    long n,              /* I: number of pixels */
+    float scale,         /* I: scale factor */
+    float offset,        /* I: add offset */
+    int fill,            /* I: packed value of NaN */
+    void *out            /* O: packed pixels */
+)
+{
+    long i;              /* current pixel */
+    int16_t *pix = out;  /* packed pixels */
+    __m256 vscale = _mm256_set1_ps (scale);    /* scale factor */
+    __m256 voffset = _mm256_set1_ps (offset);  /* add offset */
+    __m256 vlo = _mm256_set1_ps (INT16_MIN);   /* smallest packed value */
+    __m256 vhi = _mm256_set1_ps (INT16_MAX);   /* largest packed value */
+    __m256i vfill = _mm256_set1_epi32 (fill);  /* packed value of NaN */
+    __m256i lo;          /* first 8 packed values */
+    __m256i hi;          /* next 8 packed values */
+
+    for (i = 0; i + 16 <= n; i += 16)
+    {
+        lo = cf_pack_start_avx2 (_mm256_loadu_ps (in + i), vscale, voffset,
+            vlo, vhi, vfill);
+        hi = cf_pack_start_avx2 (_mm256_loadu_ps (in + i + 8), vscale,
+            voffset, vlo, vhi, vfill);
+        _mm256_storeu_si256 ((__m256i *) (pix + i), _mm256_permute4x64_epi64
+            (_mm256_packs_epi32 (lo, hi), 0xd8));
+    }
+
+    return i;
+}
+
+__attribute__ ((target ("avx2")))
+static long cf_pack_u16_avx2
+(
+    const float *in,     /* I: physical values */
+    long n,              /* I: number of pixels */
+    float scale,         /* I: scale factor */
+    float offset,        /* I: add offset */
+    int fill,            /* I: packed value of NaN */
+    void *out            /* O: packed pixels */
+)
+{
+    long i;              /* current pixel */
+    uint16_t *pix = out; /* packed pixels */
+    __m256 vscale = _mm256_set1_ps (scale);    /* scale factor */
+    __m256 voffset = _mm256_set1_ps (offset);  /* add offset */
+    __m256 vlo = _mm256_set1_ps (0.0f);        /* smallest packed value */
+    __m256 vhi = _mm256_set1_ps (UINT16_MAX);  /* largest packed value */
+    __m256i vfill = _mm256_set1_epi32 (fill);  /* packed value of NaN */
+    __m256i lo;          /* first 8 packed values */
+    __m256i hi;          /* next 8 packed values */
+
+    for (i = 0; i + 16 <= n; i += 16)
+    {
+        lo = cf_pack_start_avx2 (_mm256_loadu_ps (in + i), vscale, voffset,
+            vlo, vhi, vfill);
+        hi = cf_pack_start_avx2 (_mm256_loadu_ps (in + i + 8), vscale,
+            voffset, vlo, vhi, vfill);
+        _mm256_storeu_si256 ((__m256i *) (pix + i), _mm256_permute4x64_epi64
+            (_mm256_packus_epi32 (lo, hi), 0xd8));
+    }
+
+    return i;
+}
+#endif
+
+
+/******************************************************************************
+MODULE: cf_unpack16_none, cf_pack16_none
+
+PURPOSE: Kernels of CPUs without SIMD support, leaving all the pixels to the
+scalar loops.
+
+RETURN VALUE:
+Type = long
+Value        Description
+-----        -----------
+0            No pixels done
+******************************************************************************/
+static long cf_unpack16_none
+(
+    const void *in,      /* I: packed pixels (unused) */
+    long n,              /* I: number of pixels (unused) */
+    float scale,         /* I: scale factor (unused) */
+    float offset,        /* I: add offset (unused) */
+    int fill,            /* I: fill value (unused) */
+    bool has_fill,       /* I: does the band have a fill value? (unused) */
+    float *out           /* O: physical values (unused) */
+)
+{
+    return 0;
+}
+
+static long cf_pack16_none
+(
+    const float *in,     /* I: physical values (unused) */
+    long n,              /* I: number of pixels (unused) */
+    float scale,         /* I: scale factor (unused) */
+    float offset,        /* I: add offset (unused) */
+    int fill,            /* I: packed value of NaN (unused) */
+    void *out            /* O: packed pixels (unused) */
+)
+{
+    return 0;
+}
+
+
+/* Kernels, chosen by init_cf_packing_kernels */
+static Cf_unpack16_kernel_t cf_unpack_i16_kernel = cf_unpack16_none;
+static Cf_unpack16_kernel_t cf_unpack_u16_kernel = cf_unpack16_none;
+static Cf_pack16_kernel_t cf_pack_i16_kernel = cf_pack16_none;
+static Cf_pack16_kernel_t cf_pack_u16_kernel = cf_pack16_none;
+
+
+/******************************************************************************
+MODULE: init_cf_packing_kernels
+
+PURPOSE: Chooses the widest kernels supported by the CPU.
+
+RETURN VALUE: None
+
+NOTES:
+  1. Run when the program (or shared library) is loaded.
+*****************************************************************************/
+__attribute__ ((constructor))
+static void init_cf_packing_kernels (void)
+{
+#if defined(CF_PACKING_X86)
+    if (espa_cpu_supports (ESPA_CPU_AVX2))
+    {
+        cf_unpack_i16_kernel = cf_unpack_i16_avx2;
+        cf_unpack_u16_kernel = cf_unpack_u16_avx2;
+        cf_pack_i16_kernel = cf_pack_i16_avx2;
+        cf_pack_u16_kernel = cf_pack_u16_avx2;
+    }
+    else if (espa_cpu_supports (ESPA_CPU_SSE2))
+    {
+        cf_unpack_i16_kernel = cf_unpack_i16_sse2;
+        cf_unpack_u16_kernel = cf_unpack_u16_sse2;
+        cf_pack_i16_kernel = cf_pack_i16_sse2;
+        cf_pack_u16_kernel = cf_pack_u16_sse2;
+    }
+#endif
+}
+
+
+/******************************************************************************
+MODULE: cf_scale, cf_offset
+
+PURPOSE: Returns the scale factor or add offset of a band, or its default if
+the band has none.
+******************************************************************************/
+static double cf_scale
+(
+    const Espa_band_meta_t *bmeta  /* I: metadata of the band */
+)
+{
+    if (fabs (bmeta->scale_factor - ESPA_FLOAT_META_FILL) > ESPA_EPSILON)
+        return (bmeta->scale_factor);
+    return (1.0);
+}
+
+static double cf_offset
+(
+    const Espa_band_meta_t *bmeta  /* I: metadata of the band */
+)
+{
+    if (fabs (bmeta->add_offset - ESPA_FLOAT_META_FILL) > ESPA_EPSILON)
+        return (bmeta->add_offset);
+    return (0.0);
+}
+
+
+/******************************************************************************
+MODULE: cf_type_range
+
+PURPOSE: Determines the range of an integer data type.
+
+RETURN VALUE:
+Type = bool
+Value           Description
+-----           -----------
+true            The data type is an integer type
+false           The data type isn't an integer type
+******************************************************************************/
+static bool cf_type_range
+(
+    enum Espa_data_type data_type, /* I: data type */
+    double *lo,                    /* O: smallest value of the type */
+    double *hi                     /* O: largest value of the type */
+)
+{
+    switch (data_type)
+    {
+        case ESPA_INT8: *lo = INT8_MIN; *hi = INT8_MAX; return (true);
+        case ESPA_UINT8: *lo = 0; *hi = UINT8_MAX; return (true);
+        case ESPA_INT16: *lo = INT16_MIN; *hi = INT16_MAX; return (true);
+        case ESPA_UINT16: *lo = 0; *hi = UINT16_MAX; return (true);
+        case ESPA_INT32: *lo = INT32_MIN; *hi = INT32_MAX; return (true);
+        case ESPA_UINT32: *lo = 0; *hi = UINT32_MAX; return (true);
+        default: return (false);
+    }
+}
+
+
+/******************************************************************************
+MODULE: espa_cf_is_packed
+
+PURPOSE: Determines whether a band holds packed values.
+
+RETURN VALUE:
+Type = bool
+Value           Description
+-----           -----------
+true            The band has an integer data type and a scale_factor or
+                add_offset
+false           The pixels of the band are its physical values
+******************************************************************************/
+bool espa_cf_is_packed
+(
+    const Espa_band_meta_t *bmeta  /* I: metadata of the band */
+)
+{
+    double lo;           /* smallest value of the data type */
+    double hi;           /* largest value of the data type */
+
+    if (!cf_type_range (bmeta->data_type, &lo, &hi))
+        return (false);
+    return (fabs (bmeta->scale_factor - ESPA_FLOAT_META_FILL) > ESPA_EPSILON
+        || fabs (bmeta->add_offset - ESPA_FLOAT_META_FILL) > ESPA_EPSILON);
+}
+
+
+/******************************************************************************
+MODULE: espa_cf_physical_meta
+
+PURPOSE: Changes the metadata of a packed band to describe its physical
+values.
+
+RETURN VALUE: None
+
+NOTES:
+  1. The band becomes FLOAT32 without a scale factor, add offset, fill
+     value, or saturation value.  The valid range, constant value, and
+     statistics are scaled.  The checksum is of the packed pixels, so it is
+     cleared.
+  2. A negative scale factor reverses the bins of the histogram, so the
+     statistics are cleared instead.
+******************************************************************************/
+void espa_cf_physical_meta
+(
+    Espa_band_meta_t *bmeta        /* I/O: metadata of a packed band, changed
+                                         to describe its physical values */
+)
+{
+    double scale = cf_scale (bmeta);   /* scale factor */
+    double offset = cf_offset (bmeta); /* add offset */
+    double tmp;                        /* value being swapped */
+    Espa_band_stats_t *stats = &bmeta->stats;  /* statistics of the band */
+
+    if (fabs (bmeta->valid_range[0] - ESPA_FLOAT_META_FILL) > ESPA_EPSILON &&
+        fabs (bmeta->valid_range[1] - ESPA_FLOAT_META_FILL) > ESPA_EPSILON)
+    {
+        bmeta->valid_range[0] = bmeta->valid_range[0] * scale + offset;
+        bmeta->valid_range[1] = bmeta->valid_range[1] * scale + offset;
+        if (scale < 0.0)
+        {
+            tmp = bmeta->valid_range[0];
+            bmeta->valid_range[0] = bmeta->valid_range[1];
+            bmeta->valid_range[1] = tmp;
+        }
+    }
+
+    if (fabs (bmeta->constant_value - ESPA_FLOAT_META_FILL) > ESPA_EPSILON)
+        bmeta->constant_value = bmeta->constant_value * scale + offset;
+
+    if (stats->valid_count != ESPA_INT_META_FILL)
+    {
+        if (scale < 0.0)
+            clear_band_stats (stats);
+        else
+        {
+            stats->min = stats->min * scale + offset;
+            stats->max = stats->max * scale + offset;
+            stats->mean = stats->mean * scale + offset;
+            stats->stddev *= scale;
+            stats->hist_min = stats->hist_min * scale + offset;
+            stats->hist_max = stats->hist_max * scale + offset;
+        }
+    }
+
+    bmeta->data_type = ESPA_FLOAT32;
+    bmeta->scale_factor = ESPA_FLOAT_META_FILL;
+    bmeta->add_offset = ESPA_FLOAT_META_FILL;
+    bmeta->fill_value = ESPA_INT_META_FILL;
+    bmeta->saturate_value = ESPA_INT_META_FILL;
+    strcpy (bmeta->checksum, ESPA_STRING_META_FILL);
+}
+
+
+
+/******************************************************************************
+MODULE: espa_cf_unpack
+
+PURPOSE: Converts packed pixels of a band to their physical values.
+
+RETURN VALUE: None
+
+NOTES:
+  1. The band must be packed (see espa_cf_is_packed).
+******************************************************************************/
+void espa_cf_unpack
+(
+    const Espa_band_meta_t *bmeta, /* I: metadata of the packed band */
+    const void *in,                /* I: packed pixels, of the data type of
+                                         the band */
+    long npix,                     /* I: number of pixels */
+    float *out                     /* O: physical values */
+)
+{
+    long i = 0;          /* current pixel */
+    bool has_fill = bmeta->fill_value != ESPA_INT_META_FILL;
+                         /* does the band have a fill value? */
+    long fill = bmeta->fill_value;    /* fill value */
+    float scale = cf_scale (bmeta);   /* scale factor */
+    float offset = cf_offset (bmeta); /* add offset */
+    double dscale = cf_scale (bmeta);    /* scale factor, for the types
+                                            converted in double precision */
+    double doffset = cf_offset (bmeta);  /* add offset, ditto */
+    const int8_t *i8 = in;     /* INT8 pixels */
+    const uint8_t *u8 = in;    /* UINT8 pixels */
+    const int16_t *i16 = in;   /* INT16 pixels */
+    const uint16_t *u16 = in;  /* UINT16 pixels */
+    const int32_t *i32 = in;   /* INT32 pixels */
+    const uint32_t *u32 = in;  /* UINT32 pixels */
+
+    switch (bmeta->data_type)
+    {
+        case ESPA_INT16:
+            i = cf_unpack_i16_kernel (in, npix, scale, offset, (int) fill,
+                has_fill, out);
+            for (; i < npix; i++)
+                out[i] = (has_fill && i16[i] == fill) ? NAN :
+                    (float) i16[i] * scale + offset;
+            break;
+        case ESPA_UINT16:
+            i = cf_unpack_u16_kernel (in, npix, scale, offset, (int) fill,
+                has_fill, out);
+            for (; i < npix; i++)
+                out[i] = (has_fill && u16[i] == fill) ? NAN :
+                    (float) u16[i] * scale + offset;
+            break;
+        case ESPA_INT8:
+            for (; i < npix; i++)
+                out[i] = (has_fill && i8[i] == fill) ? NAN :
+                    i8[i] * dscale + doffset;
+            break;
+        case ESPA_UINT8:
+            for (; i < npix; i++)
+                out[i] = (has_fill && u8[i] == fill) ? NAN :
+                    u8[i] * dscale + doffset;
+            break;
+        case ESPA_INT32:
+            for (; i < npix; i++)
+                out[i] = (has_fill && i32[i] == fill) ? NAN :
+                    i32[i] * dscale + doffset;
+            break;
+        case ESPA_UINT32:
+            for (; i < npix; i++)
+                out[i] = (has_fill && u32[i] == fill) ? NAN :
+                    u32[i] * dscale + doffset;
+            break;
+        default:
+            break;
+    }
+}
+
+
+/******************************************************************************
+MODULE: cf_quantize
+
+PURPOSE: Packs a physical value in double precision.
+
+RETURN VALUE:
+Type = double
+Value        Description
+-----        -----------
+q            Packed value, rounded and clamped to [lo, hi]
+******************************************************************************/
+static inline double cf_quantize
+(
+    float value,         /* I: physical value */
+    double scale,        /* I: scale factor */
+    double offset,       /* I: add offset */
+    double lo,           /* I: smallest packed value */
+    double hi,           /* I: largest packed value */
+    long fill            /* I: packed value of NaN */
+)
+{
+    double q;            /* packed value */
+
+    if (isnan (value))
+        return (fill);
+
+    q = (value - offset) / scale;
+    return (rint (q < lo ? lo : (q > hi ? hi : q)));
+}
+
+
+/******************************************************************************
+MODULE: cf_quantize16
+
+PURPOSE: Packs a physical value of a 16-bit type with the float operations
+of the kernels.
+
+RETURN VALUE:
+Type = long
+Value        Description
+-----        -----------
+q            Packed value, rounded and clamped to [lo, hi]
+******************************************************************************/
+static inline long cf_quantize16
+(
+    float value,         /* I: physical value */
+    float scale,         /* I: scale factor */
+    float offset,        /* I: add offset */
+    float lo,            /* I: smallest packed value */
+    float hi,            /* I: largest packed value */
+    long fill            /* I: packed value of NaN */
+)
+{
+    float q;             /* packed value */
+
+    if (isnan (value))
+        return (fill);
+
+    q = (value - offset) / scale;
+    return (lrintf (q < lo ? lo : (q > hi ? hi : q)));
+}
+
+
+/* Packing loop of one integer type, for the switch in espa_cf_pack */
+#define CF_PACK_LOOP(ENUM, T, NAME) \
+    case ENUM: \
+        for (; i < npix; i++) \
+            ((T *) out)[i] = (T) cf_quantize (in[i], dscale, doffset, lo, \
+                hi, fill); \
+        break;
+
+
+/******************************************************************************
+MODULE: espa_cf_pack
+
+PURPOSE: Converts physical values to the packed pixels of a band.
+
+RETURN VALUE: None
+
+NOTES:
+  1. The band must be packed (see espa_cf_is_packed).
+******************************************************************************/
+void espa_cf_pack
+(
+    const Espa_band_meta_t *bmeta, /* I: metadata of the packed band */
+    const float *in,               /* I: physical values */
+    long npix,                     /* I: number of pixels */
+    void *out                      /* O: packed pixels, of the data type of
+                                         the band */
+)
+{
+    long i = 0;          /* current pixel */
+    long fill = 0;       /* packed value of NaN */
+    double lo;           /* smallest value of the data type */
+    double hi;           /* largest value of the data type */
+    float scale = cf_scale (bmeta);   /* scale factor */
+    float offset = cf_offset (bmeta); /* add offset */
+    double dscale = cf_scale (bmeta);    /* scale factor, for the types
+                                            converted in double precision */
+    double doffset = cf_offset (bmeta);  /* add offset, ditto */
+    int16_t *i16 = out;  /* INT16 pixels */
+    uint16_t *u16 = out; /* UINT16 pixels */
+
+    if (!cf_type_range (bmeta->data_type, &lo, &hi))
+        return;
+    if (bmeta->fill_value != ESPA_INT_META_FILL)
+        fill = bmeta->fill_value;
+
+    /* The 16-bit types finish the pixels left by the kernels with the
+       float operations of the kernels */
+    if (bmeta->data_type == ESPA_INT16)
+    {
+        i = cf_pack_i16_kernel (in, npix, scale, offset, (int) fill, out);
+        for (; i < npix; i++)
+            i16[i] = (int16_t) cf_quantize16 (in[i], scale, offset, lo, hi,
+                fill);
+        return;
+    }
+    if (bmeta->data_type == ESPA_UINT16)
+    {
+        i = cf_pack_u16_kernel (in, npix, scale, offset, (int) fill, out);
+        for (; i < npix; i++)
+            u16[i] = (uint16_t) cf_quantize16 (in[i], scale, offset, lo, hi,
+                fill);
+        return;
+    }
+
+    /* The other integer types, with a loop generated for each type so the
+       type is only checked once */
+    switch (bmeta->data_type)
+    {
+        ESPA_INT_PIXEL_TYPES (CF_PACK_LOOP)
+        default:
+            break;
+    }
+}
+
+
+/******************************************************************************
+MODULE: espa_cf_packed_meta
+
+PURPOSE: Changes the metadata of a band of physical values to describe its
+packed pixels.
+
+RETURN VALUE: None
+
+NOTES:
+  1. The inverse of espa_cf_physical_meta.  The band becomes data_type with
+     the scale factor and add offset, and the valid range and constant
+     value are packed.
+  2. The fill value becomes the smallest value of a signed data type, or
+     the largest of an unsigned one, which is what NaN is packed as.
+  3. The statistics and checksum are of the physical values, so they are
+     cleared.
+******************************************************************************/
+void espa_cf_packed_meta
+(
+    Espa_band_meta_t *bmeta,       /* I/O: metadata of a band of physical
+                                         values, changed to describe its
+                                         packed pixels */
+    enum Espa_data_type data_type, /* I: integer data type of the packed
+                                         pixels */
+    float scale_factor,            /* I: scale factor; not 0 */
+    float add_offset               /* I: add offset */
+)
+{
+    double lo;                     /* smallest value of the data type */
+    double hi;                     /* largest value of the data type */
+    double tmp;                    /* value being swapped */
+
+    if (!cf_type_range (data_type, &lo, &hi))
+        return;
+
+    if (fabs (bmeta->valid_range[0] - ESPA_FLOAT_META_FILL) > ESPA_EPSILON &&
+        fabs (bmeta->valid_range[1] - ESPA_FLOAT_META_FILL) > ESPA_EPSILON)
+    {
+        bmeta->valid_range[0] = cf_quantize (bmeta->valid_range[0],
+            scale_factor, add_offset, lo, hi, 0);
+        bmeta->valid_range[1] = cf_quantize (bmeta->valid_range[1],
+            scale_factor, add_offset, lo, hi, 0);
+        if (scale_factor < 0.0)
+        {
+            tmp = bmeta->valid_range[0];
+            bmeta->valid_range[0] = bmeta->valid_range[1];
+            bmeta->valid_range[1] = tmp;
+        }
+    }
+
+    if (fabs (bmeta->constant_value - ESPA_FLOAT_META_FILL) > ESPA_EPSILON)
+        bmeta->constant_value = cf_quantize (bmeta->constant_value,
+            scale_factor, add_offset, lo, hi, 0);
+
+    bmeta->data_type = data_type;
+    bmeta->scale_factor = scale_factor;
+    bmeta->add_offset = add_offset;
+    bmeta->fill_value = lo < 0.0 ? (long) lo : (long) hi;
+    bmeta->saturate_value = ESPA_INT_META_FILL;
+    clear_band_stats (&bmeta->stats);
+    strcpy (bmeta->checksum, ESPA_STRING_META_FILL);
+}
@@ -0,0 +1,75 @@
+/*****************************************************************************
+FILE: espa_cf_packing.h
+
+PURPOSE: Contains prototypes for converting between the packed integer pixels
+of a band and its physical values, following the scale_factor and add_offset
+convention of CF (physical = packed * scale_factor + add_offset).
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. A band is packed if it has an integer data type and a scale_factor or
+     add_offset.  A missing scale_factor is 1 and a missing add_offset is 0.
+  2. The physical values are 32-bit floats.  Fill pixels are NaN, and NaN is
+     packed as the fill value of the band (0 if it has none).
+  3. Packing rounds to the nearest integer (ties to even) and clamps to the
+     range of the data type.
+  4. The 16-bit data types use SIMD instructions, chosen once when the
+     program is loaded (see espa_cpu_dispatch.h).
+*****************************************************************************/
+
+#ifndef ESPA_CF_PACKING_H
+#define ESPA_CF_PACKING_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include "error_handler.h"
+#include "espa_metadata.h"
+
+/* Prototypes */
+bool espa_cf_is_packed
+(
+    const Espa_band_meta_t *bmeta  /* I: metadata of the band */
+);
+
+void espa_cf_physical_meta
+(
+    Espa_band_meta_t *bmeta        /* I/O: metadata of a packed band, changed
+                                         to describe its physical values */
+);
+
+void espa_cf_unpack
+(
+    const Espa_band_meta_t *bmeta, /* I: metadata of the packed band */
+    const void *in,                /* I: packed pixels, of the data type of
+                                         the band */
+    long npix,                     /* I: number of pixels */
+    float *out                     /* O: physical values */
+);
+
+void espa_cf_pack
+(
+    const Espa_band_meta_t *bmeta, /* I: metadata of the packed band */
+    const float *in,               /* I: physical values */
+    long npix,                     /* I: number of pixels */
+    void *out                      /* O: packed pixels, of the data type of
+                                         the band */
+);
+
+void espa_cf_packed_meta
+(
+    Espa_band_meta_t *bmeta,       /* I/O: metadata of a band of physical
+                                         values, changed to describe its
+                                         packed pixels */
+    enum Espa_data_type data_type, /* I: integer data type of the packed
+                                         pixels */
+    float scale_factor,            /* I: scale factor; not 0 */
+    float add_offset               /* I: add offset */
+);
+
+#endif
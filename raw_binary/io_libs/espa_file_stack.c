@@ -0,0 +1,616 @@
+/*****************************************************************************
+FILE: espa_file_stack.c
+
+PURPOSE: Contains functions for storing the bands of an ESPA product stacked
+in single band sequential (BSQ) files, and for splitting them back out into
+a raw binary file per band.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The bands are read through the band stack, so stacked and
+     block-compressed bands are read the same as plain raw binary bands.
+  2. The files the bands were read from are removed once no band refers to
+     them anymore.
+*****************************************************************************/
+
+#include <unistd.h>
+#include "espa_file_stack.h"
+#include "envi_header.h"
+#include "espa_band_stack.h"
+#include "raw_binary_writer.h"
+
+/******************************************************************************
+MODULE: get_envi_header_name
+
+PURPOSE: Gets the name of the ENVI header of a raw binary file, which
+replaces the extension of the file with .hdr.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        The name of the header is too long
+SUCCESS      Successfully got the name of the header
+
+NOTES:
+*****************************************************************************/
+static int get_envi_header_name
+(
+    const char *img_file,   /* I: name of the raw binary file */
+    char *hdr_file          /* O: name of the ENVI header (STR_SIZE) */
+)
+{
+    char FUNC_NAME[] = "get_envi_header_name";  /* function name */
+    char errmsg[STR_SIZE];  /* error message */
+    const char *cptr = NULL;   /* pointer to the file extension */
+    int len;                /* length of the name without the extension */
+    int count;              /* number of chars copied in snprintf */
+
+    cptr = strrchr (img_file, '.');
+    if (cptr == NULL || strchr (cptr, '/') != NULL)
+        len = strlen (img_file);
+    else
+        len = cptr - img_file;
+
+    count = snprintf (hdr_file, STR_SIZE, "%.*s.hdr", len, img_file);
+    if (count < 0 || count >= STR_SIZE)
+    {
+        sprintf (errmsg, "Overflow of hdr_file string");
+        error_handler (true, FUNC_NAME, errmsg);
+        return ERROR;
+    }
+
+    return SUCCESS;
+}
+
+
+/******************************************************************************
+MODULE: is_referenced_file
+
+PURPOSE: Determines if any band of the metadata is stored in the file.
+
+RETURN VALUE:
+Type = bool
+Value        Description
+-----        -----------
+true         A band is stored in the file
+false        None of the bands are stored in the file
+
+NOTES:
+*****************************************************************************/
+static bool is_referenced_file
+(
+    Espa_internal_meta_t *xml_meta, /* I: metadata with the bands */
+    const char *file_name           /* I: name of the file */
+)
+{
+    int i;                  /* looping variable for the bands */
+
+    for (i = 0; i < xml_meta->nbands; i++)
+    {
+        if (!is_constant_band (&xml_meta->band[i]) &&
+            !strcmp (xml_meta->band[i].file_name, file_name))
+            return true;
+    }
+
+    return false;
+}
+
+
+/******************************************************************************
+MODULE: remove_band_file
+
+PURPOSE: Removes a raw binary file the bands were read from, along with its
+ENVI header if there is one.
+
+RETURN VALUE:
+Type = N/A
+
+NOTES:
+  1. The bands were already written elsewhere, so failing to remove the old
+     files is only a warning.
+*****************************************************************************/
+static void remove_band_file
+(
+    const char *file_name   /* I: name of the raw binary file */
+)
+{
+    char FUNC_NAME[] = "remove_band_file";  /* function name */
+    char errmsg[STR_SIZE];  /* error message */
+    char hdr_file[STR_SIZE];   /* name of the ENVI header */
+
+    if (unlink (file_name) != 0)
+    {
+        sprintf (errmsg, "Removing %s", file_name);
+        error_handler (false, FUNC_NAME, errmsg);
+    }
+
+    if (get_envi_header_name (file_name, hdr_file) == SUCCESS &&
+        access (hdr_file, F_OK) == 0 && unlink (hdr_file) != 0)
+    {
+        sprintf (errmsg, "Removing %s", hdr_file);
+        error_handler (false, FUNC_NAME, errmsg);
+    }
+}
+
+
+/******************************************************************************
+MODULE: append_band
+
+PURPOSE: Reads a band through the band stack and appends its lines to the
+file being written.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error reading the band or writing the file
+SUCCESS      Successfully appended the band
+
+NOTES:
+*****************************************************************************/
+static int append_band
+(
+    Espa_internal_meta_t *xml_meta, /* I: metadata with the bands */
+    int band,                       /* I: index of the band in the metadata */
+    int size,                       /* I: number of bytes per pixel */
+    Raw_binary_writer_t *writer,    /* I: writer of the file */
+    const char *outfile             /* I: name of the file, for messages */
+)
+{
+    char FUNC_NAME[] = "append_band";  /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    int status = SUCCESS;     /* status of appending the band */
+    Espa_band_stack_t *stack = NULL;   /* reader of the band */
+    Espa_band_block_t *block = NULL;   /* current block of lines */
+
+    stack = open_band_stack (xml_meta, 1, &band, RB_PREFETCH_DEFAULT_LINES,
+        0);
+    if (stack == NULL)
+    {
+        sprintf (errmsg, "Opening band %s", xml_meta->band[band].name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return ERROR;
+    }
+
+    /* Full width blocks of lines are contiguous in the block buffer */
+    while (status == SUCCESS)
+    {
+        if (get_band_stack_block (stack, &block) != SUCCESS)
+        {
+            sprintf (errmsg, "Reading band %s", xml_meta->band[band].name);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+            break;
+        }
+        if (block == NULL)
+            break;
+
+        if (append_raw_binary_writer (writer, block->nlines, block->nsamps,
+            size, block->band_buf[0]) != SUCCESS)
+        {
+            sprintf (errmsg, "Writing lines %d-%d of band %s to %s",
+                block->line0, block->line0 + block->nlines - 1,
+                xml_meta->band[band].name, outfile);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+        }
+    }
+    close_band_stack (stack);
+
+    return status;
+}
+
+
+/******************************************************************************
+MODULE: is_stackable_band
+
+PURPOSE: Determines if a band is stored in a file of its own, which can be
+added to a stack.
+
+RETURN VALUE:
+Type = bool
+Value        Description
+-----        -----------
+true         The band can be stacked
+false        The band is constant or already in a stack
+
+NOTES:
+*****************************************************************************/
+static bool is_stackable_band
+(
+    Espa_internal_meta_t *xml_meta, /* I: metadata with the bands */
+    int band                        /* I: index of the band in the metadata */
+)
+{
+    return (!is_constant_band (&xml_meta->band[band]) &&
+        xml_meta->band[band].file_offset == 0 &&
+        !is_shared_band_file (xml_meta, band, false));
+}
+
+
+/******************************************************************************
+MODULE: write_band_stack
+
+PURPOSE: Writes a group of bands of the same size and data type to a new
+stack, with its ENVI header, and switches the bands over to the stack.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error reading the bands or writing the stack
+SUCCESS      Successfully stacked the bands
+
+NOTES:
+  1. The stack is named after the first of <base>_stack.img,
+     <base>_stack2.img, ... which neither exists nor is used by a band.
+*****************************************************************************/
+static int write_band_stack
+(
+    Espa_internal_meta_t *xml_meta, /* I/O: metadata with the bands */
+    int *group,                     /* I: index of each band in the group */
+    int ngroup,                     /* I: number of bands in the group */
+    char *base_name                 /* I: base name of the stacks */
+)
+{
+    char FUNC_NAME[] = "write_band_stack";  /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    char stack_file[STR_SIZE];   /* name of the stack */
+    char hdr_file[STR_SIZE];  /* name of the ENVI header of the stack */
+    char (*old_files)[STR_SIZE] = NULL;  /* files the bands were read from */
+    int i;                    /* looping variable for the bands */
+    int k;                    /* number of the stack */
+    int count;                /* number of chars copied in snprintf */
+    int size;                 /* number of bytes per pixel */
+    int status = SUCCESS;     /* status of writing the stack */
+    size_t band_bytes;        /* number of bytes in each band */
+    Espa_band_meta_t *bmeta = &xml_meta->band[group[0]];
+                              /* metadata of the first band */
+    Raw_binary_writer_t *writer = NULL;  /* writer of the stack */
+    Envi_header_t envi_hdr;   /* ENVI header of the stack */
+
+    size = espa_data_type_size (bmeta->data_type);
+    if (size == ERROR)
+    {
+        sprintf (errmsg, "Unsupported data type for band %s", bmeta->name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return ERROR;
+    }
+    band_bytes = (size_t) bmeta->nlines * bmeta->nsamps * size;
+
+    /* Find an unused name for the stack */
+    for (k = 1; ; k++)
+    {
+        if (k == 1)
+            count = snprintf (stack_file, sizeof (stack_file), "%s%s.img",
+                base_name, ESPA_FILE_STACK_SUFFIX);
+        else
+            count = snprintf (stack_file, sizeof (stack_file), "%s%s%d.img",
+                base_name, ESPA_FILE_STACK_SUFFIX, k);
+        if (count < 0 || count >= sizeof (stack_file))
+        {
+            sprintf (errmsg, "Overflow of stack_file string");
+            error_handler (true, FUNC_NAME, errmsg);
+            return ERROR;
+        }
+        if (!is_referenced_file (xml_meta, stack_file) &&
+            access (stack_file, F_OK) != 0)
+            break;
+    }
+    if (get_envi_header_name (stack_file, hdr_file) != SUCCESS)
+        return ERROR;
+
+    old_files = calloc (ngroup, sizeof (*old_files));
+    writer = open_raw_binary_writer (stack_file, band_bytes * ngroup, 0);
+    if (old_files == NULL || writer == NULL)
+    {
+        sprintf (errmsg, "Creating %s", stack_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        free (old_files);
+        if (writer != NULL)
+        {
+            close_raw_binary_writer (writer);
+            unlink (stack_file);
+        }
+        return ERROR;
+    }
+
+    /* Write the bands one after the other */
+    for (i = 0; i < ngroup && status == SUCCESS; i++)
+        status = append_band (xml_meta, group[i], size, writer, stack_file);
+
+    if (close_raw_binary_writer (writer) != SUCCESS && status == SUCCESS)
+    {
+        sprintf (errmsg, "Closing %s", stack_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        status = ERROR;
+    }
+
+    /* Describe all the bands in the ENVI header */
+    if (status == SUCCESS &&
+        create_envi_struct (bmeta, &xml_meta->global, &envi_hdr) != SUCCESS)
+    {
+        sprintf (errmsg, "Creating the ENVI header structure for %s",
+            stack_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        status = ERROR;
+    }
+    if (status == SUCCESS)
+    {
+        envi_hdr.nbands = ngroup;
+        for (i = 0; i < ngroup; i++)
+            strcpy (envi_hdr.band_names[i], xml_meta->band[group[i]].name);
+        if (write_envi_hdr (hdr_file, &envi_hdr) != SUCCESS)
+        {
+            sprintf (errmsg, "Writing the ENVI header %s", hdr_file);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+        }
+    }
+    if (status != SUCCESS)
+    {
+        unlink (stack_file);
+        unlink (hdr_file);
+        free (old_files);
+        return ERROR;
+    }
+
+    /* Switch the bands over to the stack and remove their old files */
+    for (i = 0; i < ngroup; i++)
+    {
+        bmeta = &xml_meta->band[group[i]];
+        strcpy (old_files[i], bmeta->file_name);
+        strcpy (bmeta->file_name, stack_file);
+        bmeta->file_offset = (long) (band_bytes * i);
+        strcpy (bmeta->encoding, ESPA_STRING_META_FILL);
+        bmeta->tile_size = 0;
+    }
+    for (i = 0; i < ngroup; i++)
+    {
+        if (!is_referenced_file (xml_meta, old_files[i]))
+            remove_band_file (old_files[i]);
+    }
+    free (old_files);
+
+    printf ("  Stacked %d bands in %s\n", ngroup, stack_file);
+
+    return SUCCESS;
+}
+
+
+/******************************************************************************
+MODULE: stack_espa_bands
+
+PURPOSE: Stacks the bands of the product which are stored in files of their
+own, grouping the bands of the same size and data type into BSQ stacks.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error reading the bands or writing a stack
+SUCCESS      Successfully stacked the bands
+
+NOTES:
+  1. The bands of a stack keep their order in the metadata.  A stack holds
+     at most MAX_ENVI_BANDS bands, since that's all its ENVI header can
+     name, and a band with nothing to be stacked with is left alone.
+  2. Bands which are already in a stack are left alone, so the stacks of an
+     earlier run are kept.
+  3. The metadata is updated for the stacks which were written, even if a
+     later stack fails, so the caller should write it out either way.
+*****************************************************************************/
+int stack_espa_bands
+(
+    Espa_internal_meta_t *xml_meta, /* I/O: metadata with the bands; the
+                                            file name, offset, and encoding
+                                            of the stacked bands are
+                                            updated */
+    char *base_name                 /* I: base name of the stacks */
+)
+{
+    char FUNC_NAME[] = "stack_espa_bands";  /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    int i, j;                 /* looping variables for the bands */
+    int ngroup;               /* number of bands in the current group */
+    int *group = NULL;        /* index of each band in the current group */
+    bool *grouped = NULL;     /* has each band been grouped? */
+    int status = SUCCESS;     /* status of stacking the bands */
+    Espa_band_meta_t *bmeta = NULL;   /* metadata of the first band of the
+                                         group */
+    Espa_band_meta_t *cmeta = NULL;   /* metadata of the current band */
+
+    group = calloc (MAX_ENVI_BANDS, sizeof (int));
+    grouped = calloc (xml_meta->nbands + 1, sizeof (bool));
+    if (group == NULL || grouped == NULL)
+    {
+        sprintf (errmsg, "Allocating the band groups");
+        error_handler (true, FUNC_NAME, errmsg);
+        free (group);
+        free (grouped);
+        return ERROR;
+    }
+
+    for (i = 0; i < xml_meta->nbands && status == SUCCESS; i++)
+    {
+        if (grouped[i] || !is_stackable_band (xml_meta, i))
+            continue;
+
+        /* Group the following bands of the same size and data type */
+        bmeta = &xml_meta->band[i];
+        ngroup = 0;
+        for (j = i; j < xml_meta->nbands && ngroup < MAX_ENVI_BANDS; j++)
+        {
+            cmeta = &xml_meta->band[j];
+            if (grouped[j] || !is_stackable_band (xml_meta, j) ||
+                cmeta->nlines != bmeta->nlines ||
+                cmeta->nsamps != bmeta->nsamps ||
+                cmeta->data_type != bmeta->data_type)
+                continue;
+            group[ngroup++] = j;
+            grouped[j] = true;
+        }
+
+        if (ngroup > 1 &&
+            write_band_stack (xml_meta, group, ngroup, base_name) != SUCCESS)
+        {
+            sprintf (errmsg, "Stacking %d bands starting with band %s",
+                ngroup, bmeta->name);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+        }
+    }
+
+    free (group);
+    free (grouped);
+    return status;
+}
+
+
+/******************************************************************************
+MODULE: unstack_espa_bands
+
+PURPOSE: Writes each band stored in a stack back out to a raw binary file of
+its own, with its ENVI header.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error reading a band or writing its file
+SUCCESS      Successfully unstacked the bands
+
+NOTES:
+  1. A band left on its own at an offset of a stack (ex. by espa_band_subset)
+     is unstacked as well.
+  2. The metadata is updated for the bands which were written, even if a
+     later band fails, so the caller should write it out either way.  Only
+     the stacks none of the bands refer to anymore are removed.
+*****************************************************************************/
+int unstack_espa_bands
+(
+    Espa_internal_meta_t *xml_meta, /* I/O: metadata with the bands; the
+                                            file name and offset of the
+                                            unstacked bands are updated */
+    char *base_name                 /* I: base name of the band files,
+                                          <base>_<band name>.img */
+)
+{
+    char FUNC_NAME[] = "unstack_espa_bands";  /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    char outfile[STR_SIZE];   /* name of the band file */
+    char hdr_file[STR_SIZE];  /* name of the ENVI header of the band file */
+    char (*old_files)[STR_SIZE] = NULL;  /* stacks the bands were read from */
+    int nold = 0;             /* number of stacks the bands were read from */
+    int i, j;                 /* looping variables */
+    int count;                /* number of chars copied in snprintf */
+    int size;                 /* number of bytes per pixel */
+    int status = SUCCESS;     /* status of unstacking the bands */
+    Espa_band_meta_t *bmeta = NULL;      /* metadata of the current band */
+    Raw_binary_writer_t *writer = NULL;  /* writer of the band file */
+    Envi_header_t envi_hdr;   /* ENVI header of the band file */
+
+    old_files = calloc (xml_meta->nbands + 1, sizeof (*old_files));
+    if (old_files == NULL)
+    {
+        sprintf (errmsg, "Allocating the names of the stacks");
+        error_handler (true, FUNC_NAME, errmsg);
+        return ERROR;
+    }
+
+    for (i = 0; i < xml_meta->nbands && status == SUCCESS; i++)
+    {
+        bmeta = &xml_meta->band[i];
+        if (is_constant_band (bmeta) || (bmeta->file_offset == 0 &&
+            !is_shared_band_file (xml_meta, i, false)))
+            continue;
+
+        size = espa_data_type_size (bmeta->data_type);
+        if (size == ERROR)
+        {
+            sprintf (errmsg, "Unsupported data type for band %s",
+                bmeta->name);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+            break;
+        }
+
+        count = snprintf (outfile, sizeof (outfile), "%s_%s.img", base_name,
+            bmeta->name);
+        if (count < 0 || count >= sizeof (outfile))
+        {
+            sprintf (errmsg, "Overflow of outfile string");
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+            break;
+        }
+        if (is_referenced_file (xml_meta, outfile) ||
+            get_envi_header_name (outfile, hdr_file) != SUCCESS)
+        {
+            sprintf (errmsg, "Band %s can't be unstacked to %s, which is "
+                "already used", bmeta->name, outfile);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+            break;
+        }
+
+        /* Write the band and its ENVI header */
+        writer = open_raw_binary_writer (outfile,
+            (size_t) bmeta->nlines * bmeta->nsamps * size, 0);
+        if (writer == NULL)
+        {
+            sprintf (errmsg, "Creating %s", outfile);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+            break;
+        }
+        status = append_band (xml_meta, i, size, writer, outfile);
+        if (close_raw_binary_writer (writer) != SUCCESS && status == SUCCESS)
+        {
+            sprintf (errmsg, "Closing %s", outfile);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+        }
+        if (status == SUCCESS &&
+            (create_envi_struct (bmeta, &xml_meta->global, &envi_hdr)
+            != SUCCESS || write_envi_hdr (hdr_file, &envi_hdr) != SUCCESS))
+        {
+            sprintf (errmsg, "Writing the ENVI header %s", hdr_file);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+        }
+        if (status != SUCCESS)
+        {
+            unlink (outfile);
+            unlink (hdr_file);
+            break;
+        }
+
+        /* Switch the band over to its own file */
+        for (j = 0; j < nold; j++)
+        {
+            if (!strcmp (old_files[j], bmeta->file_name))
+                break;
+        }
+        if (j == nold)
+            strcpy (old_files[nold++], bmeta->file_name);
+        strcpy (bmeta->file_name, outfile);
+        bmeta->file_offset = 0;
+        printf ("  Unstacked band %s to %s\n", bmeta->name, outfile);
+    }
+
+    /* Remove the stacks which are no longer used */
+    for (j = 0; j < nold; j++)
+    {
+        if (!is_referenced_file (xml_meta, old_files[j]))
+            remove_band_file (old_files[j]);
+    }
+    free (old_files);
+
+    return status;
+}
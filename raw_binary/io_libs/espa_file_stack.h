@@ -0,0 +1,57 @@
+/*****************************************************************************
+FILE: espa_file_stack.h
+
+PURPOSE: Contains defines and prototypes for storing the bands of an ESPA
+product stacked in a single band sequential (BSQ) file, rather than in a
+raw binary file per band.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. Each band in a stack keeps the name of the stack as its file_name and
+     records where its lines start in the file_offset attribute.  The window
+     and batch reads (open_raw_binary_band_fd) and the band stack take the
+     offset into account, so the readers and the exporters don't need to
+     know how the bands are stored.
+  2. A stack has a single ENVI header describing all of its bands, so only
+     bands of the same size and data type are stacked together.  A product
+     may have several stacks, ex. for the bands of each resolution.
+  3. Constant bands have no file and are never stacked.  Block-compressed
+     bands are stacked as plain raw binary.
+*****************************************************************************/
+
+#ifndef ESPA_FILE_STACK_H
+#define ESPA_FILE_STACK_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "error_handler.h"
+#include "espa_metadata.h"
+
+/* Stacks are named <base>_stack.img, then <base>_stack2.img, and so on */
+#define ESPA_FILE_STACK_SUFFIX "_stack"
+
+/* Prototypes */
+int stack_espa_bands
+(
+    Espa_internal_meta_t *xml_meta, /* I/O: metadata with the bands; the
+                                            file name, offset, and encoding
+                                            of the stacked bands are
+                                            updated */
+    char *base_name                 /* I: base name of the stacks */
+);
+
+int unstack_espa_bands
+(
+    Espa_internal_meta_t *xml_meta, /* I/O: metadata with the bands; the
+                                            file name and offset of the
+                                            unstacked bands are updated */
+    char *base_name                 /* I: base name of the band files,
+                                          <base>_<band name>.img */
+);
+
+#endif
@@ -0,0 +1,238 @@
+/*****************************************************************************
+FILE: espa_footprint.c
+
+PURPOSE: Contains functions for writing and reading the footprint index of a
+band, which holds the first and last valid sample of each line.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. See espa_footprint.h for the layout of the index file.
+*****************************************************************************/
+
+#include "espa_footprint.h"
+
+
+/******************************************************************************
+MODULE:  write_footprint
+
+PURPOSE: Writes the footprint index of a band to the specified file.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the index
+SUCCESS         Successfully wrote the index
+
+NOTES:
+  1. The index is 8 bytes per line plus an 8-byte header, so for a full scene
+     it is tens of kilobytes and is written with a single request.
+******************************************************************************/
+int write_footprint
+(
+    const char *footprint_file, /* I: name of the index file to write */
+    int nlines,                 /* I: number of lines in the band */
+    const int32_t *extent       /* I: first and last valid sample of each
+                                      line (2 * nlines entries) */
+)
+{
+    char FUNC_NAME[] = "write_footprint";   /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    int32_t header[2];          /* magic number and number of lines */
+    FILE *fptr = NULL;          /* pointer to the index file */
+
+    fptr = fopen (footprint_file, "wb");
+    if (fptr == NULL)
+    {
+        sprintf (errmsg, "Opening the footprint index: %s", footprint_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    header[0] = ESPA_FOOTPRINT_MAGIC;
+    header[1] = nlines;
+    if (fwrite (header, sizeof (int32_t), 2, fptr) != 2 ||
+        fwrite (extent, sizeof (int32_t), 2 * (size_t) nlines, fptr) !=
+        2 * (size_t) nlines)
+    {
+        sprintf (errmsg, "Writing the footprint index: %s", footprint_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        fclose (fptr);
+        return (ERROR);
+    }
+
+    if (fclose (fptr) != 0)
+    {
+        sprintf (errmsg, "Closing the footprint index: %s", footprint_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  read_footprint
+
+PURPOSE: Reads the footprint index of a band, as named by its metadata.
+
+RETURN VALUE:
+Type = Espa_footprint_t *
+Value           Description
+-----           -----------
+NULL            The band has no footprint index, or it couldn't be read
+non-NULL        Footprint index of the band, to be freed by free_footprint
+
+NOTES:
+  1. The index is optional, so a missing or unusable index is only reported
+     as a warning.  A caller getting NULL tests each pixel for fill as it
+     would without the index.
+  2. An index which doesn't match the number of lines or samples of the band
+     (e.g. one left over from before a resize or subset) is not used.
+******************************************************************************/
+Espa_footprint_t *read_footprint
+(
+    const Espa_band_meta_t *bmeta /* I: metadata of the band */
+)
+{
+    char FUNC_NAME[] = "read_footprint";    /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    int line;                   /* looping variable */
+    int32_t header[2];          /* magic number and number of lines */
+    int32_t *ext = NULL;        /* first and last sample of the current line */
+    FILE *fptr = NULL;          /* pointer to the index file */
+    Espa_footprint_t *footprint = NULL;  /* index read from the file */
+
+    if (!strcmp (bmeta->footprint_file, ESPA_STRING_META_FILL))
+        return (NULL);
+
+    fptr = fopen (bmeta->footprint_file, "rb");
+    if (fptr == NULL)
+    {
+        sprintf (errmsg, "Unable to open the footprint index %s; it won't be "
+            "used", bmeta->footprint_file);
+        error_handler (false, FUNC_NAME, errmsg);
+        return (NULL);
+    }
+
+    if (fread (header, sizeof (int32_t), 2, fptr) != 2 ||
+        header[0] != ESPA_FOOTPRINT_MAGIC || header[1] != bmeta->nlines)
+    {
+        sprintf (errmsg, "The footprint index %s doesn't match band %s; it "
+            "won't be used", bmeta->footprint_file, bmeta->name);
+        error_handler (false, FUNC_NAME, errmsg);
+        fclose (fptr);
+        return (NULL);
+    }
+
+    footprint = calloc (1, sizeof (Espa_footprint_t));
+    if (footprint != NULL)
+        footprint->extent = malloc (2 * (size_t) bmeta->nlines *
+            sizeof (int32_t));
+    if (footprint == NULL || footprint->extent == NULL)
+    {
+        sprintf (errmsg, "Allocating memory for the footprint index");
+        error_handler (false, FUNC_NAME, errmsg);
+        free_footprint (footprint);
+        fclose (fptr);
+        return (NULL);
+    }
+    footprint->nlines = bmeta->nlines;
+
+    if (fread (footprint->extent, sizeof (int32_t), 2 * (size_t) bmeta->nlines,
+        fptr) != 2 * (size_t) bmeta->nlines)
+    {
+        sprintf (errmsg, "Reading the footprint index %s; it won't be used",
+            bmeta->footprint_file);
+        error_handler (false, FUNC_NAME, errmsg);
+        free_footprint (footprint);
+        fclose (fptr);
+        return (NULL);
+    }
+    fclose (fptr);
+
+    /* Make sure every extent lies within the line, so the callers can use
+       them as is */
+    for (line = 0; line < footprint->nlines; line++)
+    {
+        ext = &footprint->extent[2 * line];
+        if (ext[0] == ESPA_FOOTPRINT_EMPTY_FIRST &&
+            ext[1] == ESPA_FOOTPRINT_EMPTY_LAST)
+            continue;
+        if (ext[0] < 0 || ext[1] < ext[0] || ext[1] >= bmeta->nsamps)
+        {
+            sprintf (errmsg, "Invalid extent for line %d in the footprint "
+                "index %s; it won't be used", line, bmeta->footprint_file);
+            error_handler (false, FUNC_NAME, errmsg);
+            free_footprint (footprint);
+            return (NULL);
+        }
+    }
+
+    return (footprint);
+}
+
+
+/******************************************************************************
+MODULE:  footprint_line_extent
+
+PURPOSE: Gets the first and last valid sample of a line from the footprint
+index.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+0               The line has no valid samples (or is outside the index)
+> 0             Number of samples from the first through the last valid
+                sample of the line
+
+NOTES:
+  1. Samples outside of first..last are fill in every band the index
+     describes.  Samples within it may still hold fill.
+******************************************************************************/
+int footprint_line_extent
+(
+    const Espa_footprint_t *footprint, /* I: footprint index */
+    int line,                   /* I: 0-based line */
+    int *first,                 /* O: first valid sample of the line */
+    int *last                   /* O: last valid sample of the line */
+)
+{
+    if (line < 0 || line >= footprint->nlines)
+    {
+        *first = ESPA_FOOTPRINT_EMPTY_FIRST;
+        *last = ESPA_FOOTPRINT_EMPTY_LAST;
+        return (0);
+    }
+
+    *first = footprint->extent[2 * line];
+    *last = footprint->extent[2 * line + 1];
+    return (*last - *first + 1);
+}
+
+
+/******************************************************************************
+MODULE:  free_footprint
+
+PURPOSE: Frees a footprint index returned by read_footprint.
+
+RETURN VALUE:
+Type = None
+******************************************************************************/
+void free_footprint
+(
+    Espa_footprint_t *footprint /* I: footprint index to be freed */
+)
+{
+    if (footprint == NULL)
+        return;
+
+    free (footprint->extent);
+    free (footprint);
+}
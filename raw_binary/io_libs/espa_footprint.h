@@ -0,0 +1,77 @@
+/*****************************************************************************
+FILE: espa_footprint.h
+
+PURPOSE: Contains defines and prototypes for the footprint index of a band,
+which holds the first and last valid (non-fill) sample of each line so a
+reader can skip the fill borders of a scene without testing each pixel.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The index is a sidecar file named by the footprint_file of the band
+     metadata.  It holds ESPA_FOOTPRINT_MAGIC and the number of lines as
+     32-bit integers, followed by the first and last valid sample of each
+     line as pairs of 32-bit integers, all in the native byte order.
+  2. A line without any valid samples is stored as
+     ESPA_FOOTPRINT_EMPTY_FIRST and ESPA_FOOTPRINT_EMPTY_LAST, i.e. a first
+     sample past the last sample.
+*****************************************************************************/
+
+#ifndef ESPA_FOOTPRINT_H
+#define ESPA_FOOTPRINT_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "error_handler.h"
+#include "espa_metadata.h"
+
+/* Defines */
+#define ESPA_FOOTPRINT_MAGIC 0x31504645   /* "EFP1" in little-endian order */
+#define ESPA_FOOTPRINT_SUFFIX "_footprint.idx" /* suffix of the index file
+                                     name, following the product ID */
+#define ESPA_FOOTPRINT_EMPTY_FIRST 0      /* first and last sample stored */
+#define ESPA_FOOTPRINT_EMPTY_LAST -1      /* for a line with no valid
+                                             samples */
+
+/* Footprint index of a band */
+typedef struct
+{
+    int nlines;                 /* number of lines in the index */
+    int32_t *extent;            /* first and last valid sample of each line
+                                   (2 * nlines entries) */
+} Espa_footprint_t;
+
+/* Prototypes */
+int write_footprint
+(
+    const char *footprint_file, /* I: name of the index file to write */
+    int nlines,                 /* I: number of lines in the band */
+    const int32_t *extent       /* I: first and last valid sample of each
+                                      line (2 * nlines entries) */
+);
+
+Espa_footprint_t *read_footprint
+(
+    const Espa_band_meta_t *bmeta /* I: metadata of the band */
+);
+
+int footprint_line_extent
+(
+    const Espa_footprint_t *footprint, /* I: footprint index */
+    int line,                   /* I: 0-based line */
+    int *first,                 /* O: first valid sample of the line */
+    int *last                   /* O: last valid sample of the line */
+);
+
+void free_footprint
+(
+    Espa_footprint_t *footprint /* I: footprint index to be freed */
+);
+
+#endif
@@ -0,0 +1,532 @@
+/*****************************************************************************
+FILE: espa_incremental.c
+
+PURPOSE: Contains functions for incremental exports, which keep the outputs
+whose inputs haven't changed (see espa_incremental.h).
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+*****************************************************************************/
+
+#include <stdarg.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include "espa_incremental.h"
+#include "espa_band_stack.h"
+#include "write_metadata.h"
+#include "espa_hash.h"
+
+
+/******************************************************************************
+MODULE: inputs_record_name
+
+PURPOSE: Determines the name of the record of the inputs of an output.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        The name doesn't fit in STR_SIZE characters
+SUCCESS      Successfully determined the name
+
+NOTES:
+*****************************************************************************/
+static int inputs_record_name
+(
+    const char *output,     /* I: name of the output file */
+    char *record_file       /* O: name of the record; STR_SIZE bytes */
+)
+{
+    int count;              /* number of chars copied in snprintf */
+
+    count = snprintf (record_file, STR_SIZE, "%s%s", output,
+        ESPA_INPUTS_SUFFIX);
+    if (count < 0 || count >= STR_SIZE)
+        return ERROR;
+
+    return SUCCESS;
+}
+
+
+/******************************************************************************
+MODULE: use_espa_incremental
+
+PURPOSE: Determines whether the exports keep the outputs whose inputs are
+unchanged.
+
+RETURN VALUE:
+Type = bool
+Value        Description
+-----        -----------
+true         Export incrementally
+false        Write every output
+
+NOTES:
+  1. The exports are incremental if the ESPA_INCREMENTAL_ENV environment
+     variable is set to "yes" or "1".
+*****************************************************************************/
+bool use_espa_incremental (void)
+{
+    char *env = NULL;    /* value of the environment variable */
+
+    env = getenv (ESPA_INCREMENTAL_ENV);
+    if (env == NULL)
+        return false;
+    return (!strcmp (env, "yes") || !strcmp (env, "1"));
+}
+
+
+/******************************************************************************
+MODULE: init_espa_inputs_key
+
+PURPOSE: Starts an empty key.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+*****************************************************************************/
+void init_espa_inputs_key
+(
+    Espa_inputs_key_t *key  /* O: empty key */
+)
+{
+    key->text = NULL;
+    key->len = 0;
+    key->size = 0;
+}
+
+
+/******************************************************************************
+MODULE: add_espa_inputs_key
+
+PURPOSE: Adds a line to a key, formatted as by printf.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error allocating memory for the key
+SUCCESS      Successfully added the line
+
+NOTES:
+  1. The newline ending the line is added here.
+*****************************************************************************/
+int add_espa_inputs_key
+(
+    Espa_inputs_key_t *key, /* I/O: key to be added to */
+    const char *format,     /* I: printf format of the line to be added */
+    ...                     /* I: values of the format */
+)
+{
+    char FUNC_NAME[] = "add_espa_inputs_key";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    int count;                /* number of chars in the line */
+    size_t size;              /* number of bytes needed for the key */
+    char *tmp = NULL;         /* reallocated text */
+    va_list ap;               /* values of the format */
+
+    va_start (ap, format);
+    count = vsnprintf (NULL, 0, format, ap);
+    va_end (ap);
+    if (count < 0)
+    {
+        sprintf (errmsg, "Formatting a line of the key of the inputs");
+        error_handler (true, FUNC_NAME, errmsg);
+        return ERROR;
+    }
+
+    /* Room for the line, its newline, and the ending NULL */
+    size = key->len + count + 2;
+    if (size > key->size)
+    {
+        if (size < 2 * key->size)
+            size = 2 * key->size;
+        tmp = realloc (key->text, size);
+        if (tmp == NULL)
+        {
+            sprintf (errmsg, "Allocating memory for the key of the inputs");
+            error_handler (true, FUNC_NAME, errmsg);
+            return ERROR;
+        }
+        key->text = tmp;
+        key->size = size;
+    }
+
+    va_start (ap, format);
+    vsnprintf (&key->text[key->len], count + 1, format, ap);
+    va_end (ap);
+    key->len += count;
+    key->text[key->len++] = '\n';
+    key->text[key->len] = '\0';
+
+    return SUCCESS;
+}
+
+
+/******************************************************************************
+MODULE: add_espa_grid_inputs
+
+PURPOSE: Adds the grid of the scene (its projection and corners) to a key.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error adding to the key
+SUCCESS      Successfully added the grid
+
+NOTES:
+  1. The doubles are written with 17 significant digits, so grids only
+     match when their definitions are identical.
+*****************************************************************************/
+int add_espa_grid_inputs
+(
+    Espa_inputs_key_t *key, /* I/O: key to be added to */
+    const Espa_global_meta_t *gmeta /* I: global metadata with the grid */
+)
+{
+    const Espa_proj_meta_t *proj = &gmeta->proj_info;
+                              /* projection of the scene */
+
+    return (add_espa_inputs_key (key,
+        "grid proj %d datum %d zone %d origin %s units %s ul %.17g %.17g "
+        "lr %.17g %.17g ps %.17g %.17g %.17g %.17g %.17g %.17g %.17g "
+        "%.17g %.17g", proj->proj_type, proj->datum_type, proj->utm_zone,
+        proj->grid_origin, proj->units, proj->ul_corner[0],
+        proj->ul_corner[1], proj->lr_corner[0], proj->lr_corner[1],
+        proj->longitude_pole, proj->latitude_true_scale,
+        proj->false_easting, proj->false_northing, proj->standard_parallel1,
+        proj->standard_parallel2, proj->central_meridian,
+        proj->origin_latitude, proj->sphere_radius));
+}
+
+
+/******************************************************************************
+MODULE: add_espa_band_inputs
+
+PURPOSE: Adds a band to a key: its layout and the content of its pixels.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error reading the band or adding to the key
+SUCCESS      Successfully added the band
+
+NOTES:
+  1. The content of a constant band is its value.  The content of any other
+     band is its checksum, which is taken from the XML when it has one.
+     Otherwise the band is read through the band stack, which records its
+     checksum in the metadata.
+*****************************************************************************/
+int add_espa_band_inputs
+(
+    Espa_inputs_key_t *key, /* I/O: key to be added to */
+    Espa_internal_meta_t *xml_metadata, /* I/O: XML metadata structure; the
+                                    checksum of the band is recorded if it
+                                    has none */
+    int band                /* I: index of the band */
+)
+{
+    char FUNC_NAME[] = "add_espa_band_inputs";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    int status = SUCCESS;     /* status of reading the band */
+    Espa_band_meta_t *bmeta = &xml_metadata->band[band];  /* band metadata */
+    Espa_band_stack_t *stack = NULL;  /* reader of the band */
+    Espa_band_block_t *block = NULL;  /* current block of lines */
+
+    if (is_constant_band (bmeta))
+        return (add_espa_inputs_key (key, "band %s type %d size %d %d "
+            "pixel %.17g %.17g fill %ld constant %.17g", bmeta->name,
+            bmeta->data_type, bmeta->nlines, bmeta->nsamps,
+            bmeta->pixel_size[0], bmeta->pixel_size[1], bmeta->fill_value,
+            bmeta->constant_value));
+
+    if (!strcmp (bmeta->checksum, ESPA_STRING_META_FILL))
+    {
+        stack = open_band_stack (xml_metadata, 1, &band,
+            RB_PREFETCH_DEFAULT_LINES, 0);
+        if (stack == NULL)
+        {
+            sprintf (errmsg, "Opening the band stack for band %s",
+                bmeta->name);
+            error_handler (true, FUNC_NAME, errmsg);
+            return ERROR;
+        }
+        skip_band_stack_stats (stack);
+
+        do
+        {
+            status = get_band_stack_block (stack, &block);
+        } while (status == SUCCESS && block != NULL);
+        close_band_stack (stack);
+        if (status != SUCCESS)
+        {
+            sprintf (errmsg, "Reading band %s for its checksum", bmeta->name);
+            error_handler (true, FUNC_NAME, errmsg);
+            return ERROR;
+        }
+    }
+
+    return (add_espa_inputs_key (key, "band %s type %d size %d %d "
+        "pixel %.17g %.17g fill %ld pixels %s", bmeta->name,
+        bmeta->data_type, bmeta->nlines, bmeta->nsamps,
+        bmeta->pixel_size[0], bmeta->pixel_size[1], bmeta->fill_value,
+        bmeta->checksum));
+}
+
+
+/******************************************************************************
+MODULE: add_espa_metadata_inputs
+
+PURPOSE: Adds the XML metadata to a key, as the hash of the XML document it
+renders to.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error rendering the metadata or adding to the key
+SUCCESS      Successfully added the metadata
+
+NOTES:
+  1. Any change to the metadata, including the checksums recorded by
+     add_espa_band_inputs, changes the key, so the bands are best added
+     first.
+*****************************************************************************/
+int add_espa_metadata_inputs
+(
+    Espa_inputs_key_t *key, /* I/O: key to be added to */
+    Espa_internal_meta_t *xml_metadata  /* I: XML metadata structure */
+)
+{
+    char FUNC_NAME[] = "add_espa_metadata_inputs";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    char *xml_doc = NULL;     /* rendered XML document */
+    size_t xml_len = 0;       /* length of the XML document */
+    int status;               /* return status */
+
+    if (render_metadata (xml_metadata, &xml_doc, &xml_len) != SUCCESS)
+    {
+        sprintf (errmsg, "Rendering the XML metadata for the key of the "
+            "inputs");
+        error_handler (true, FUNC_NAME, errmsg);
+        return ERROR;
+    }
+
+    status = add_espa_inputs_key (key, "metadata %zu %016llx", xml_len,
+        (unsigned long long) espa_hash_fnv1a (xml_doc, xml_len,
+            ESPA_FNV1A_BASIS));
+    free (xml_doc);
+    return status;
+}
+
+
+/******************************************************************************
+MODULE: espa_output_is_current
+
+PURPOSE: Determines whether an output was written from the same inputs, and
+can be kept.
+
+RETURN VALUE:
+Type = bool
+Value        Description
+-----        -----------
+true         The output exists and its record matches the key
+false        The output needs to be written
+
+NOTES:
+  1. No error messages are written, since the caller just writes the output
+     when it isn't current.
+  2. The record also holds the size of the output, so an output which was
+     replaced or truncated since it was recorded isn't kept.
+*****************************************************************************/
+bool espa_output_is_current
+(
+    const char *output,     /* I: name of the output file */
+    const Espa_inputs_key_t *key  /* I: key of the inputs of the output */
+)
+{
+    char record_file[STR_SIZE];  /* name of the record */
+    char header[STR_SIZE];    /* expected first line of the record */
+    char *record = NULL;      /* contents of the record */
+    int header_len;           /* number of chars in the first line */
+    bool current;             /* does the record match? */
+    struct stat statbuf;      /* status of the output and the record */
+    FILE *fp = NULL;          /* record file */
+
+    if (key->len == 0 || stat (output, &statbuf) == -1 ||
+        inputs_record_name (output, record_file) != SUCCESS)
+        return false;
+
+    header_len = snprintf (header, sizeof (header), "%s\t%d\t%016llx\t%lld\n",
+        ESPA_INPUTS_MAGIC, ESPA_INPUTS_VERSION,
+        (unsigned long long) espa_hash_fnv1a (key->text, key->len,
+            ESPA_FNV1A_BASIS),
+        (long long) statbuf.st_size);
+
+    /* The record must be exactly the header and the key */
+    if (stat (record_file, &statbuf) == -1 ||
+        (size_t) statbuf.st_size != header_len + key->len)
+        return false;
+
+    fp = fopen (record_file, "rb");
+    if (fp == NULL)
+        return false;
+    record = malloc (header_len + key->len);
+    current = (record != NULL &&
+        fread (record, 1, header_len + key->len, fp) ==
+        header_len + key->len &&
+        !memcmp (record, header, header_len) &&
+        !memcmp (&record[header_len], key->text, key->len));
+    free (record);
+    fclose (fp);
+
+    return current;
+}
+
+
+/******************************************************************************
+MODULE: invalidate_espa_output
+
+PURPOSE: Removes the record of the inputs of an output which is about to be
+written.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error removing the record
+SUCCESS      The output has no record
+
+NOTES:
+*****************************************************************************/
+int invalidate_espa_output
+(
+    const char *output      /* I: name of the output file about to be
+                                  written */
+)
+{
+    char FUNC_NAME[] = "invalidate_espa_output";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    char record_file[STR_SIZE];  /* name of the record */
+
+    if (inputs_record_name (output, record_file) != SUCCESS)
+    {
+        sprintf (errmsg, "Overflow of record_file string");
+        error_handler (true, FUNC_NAME, errmsg);
+        return ERROR;
+    }
+
+    if (unlink (record_file) != 0 && errno != ENOENT)
+    {
+        sprintf (errmsg, "Removing the record of the inputs: %s",
+            record_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return ERROR;
+    }
+
+    return SUCCESS;
+}
+
+
+/******************************************************************************
+MODULE: record_espa_output_inputs
+
+PURPOSE: Records the inputs of an output which has been written.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error writing the record
+SUCCESS      Successfully recorded the inputs
+
+NOTES:
+  1. The record is written to a temporary file and renamed into place.
+*****************************************************************************/
+int record_espa_output_inputs
+(
+    const char *output,     /* I: name of the completed output file */
+    const Espa_inputs_key_t *key  /* I: key of the inputs of the output */
+)
+{
+    char FUNC_NAME[] = "record_espa_output_inputs";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    char record_file[STR_SIZE];  /* name of the record */
+    char tmp_file[STR_SIZE + 32];  /* name of the temporary file */
+    int status = SUCCESS;     /* status of the writes */
+    struct stat statbuf;      /* status of the output */
+    FILE *fp = NULL;          /* record file */
+
+    if (inputs_record_name (output, record_file) != SUCCESS)
+    {
+        sprintf (errmsg, "Overflow of record_file string");
+        error_handler (true, FUNC_NAME, errmsg);
+        return ERROR;
+    }
+
+    if (stat (output, &statbuf) == -1)
+    {
+        sprintf (errmsg, "Unable to stat the output: %s", output);
+        error_handler (true, FUNC_NAME, errmsg);
+        return ERROR;
+    }
+
+    snprintf (tmp_file, sizeof (tmp_file), "%s.%ld", record_file,
+        (long) getpid ());
+    fp = fopen (tmp_file, "wb");
+    if (fp == NULL)
+    {
+        sprintf (errmsg, "Opening the record of the inputs: %s", tmp_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return ERROR;
+    }
+    if (fprintf (fp, "%s\t%d\t%016llx\t%lld\n", ESPA_INPUTS_MAGIC,
+        ESPA_INPUTS_VERSION,
+        (unsigned long long) espa_hash_fnv1a (key->text, key->len,
+            ESPA_FNV1A_BASIS),
+        (long long) statbuf.st_size) < 0 ||
+        fwrite (key->text, 1, key->len, fp) != key->len)
+        status = ERROR;
+    if (fclose (fp) != 0)
+        status = ERROR;
+
+    if (status != SUCCESS || rename (tmp_file, record_file) != 0)
+    {
+        sprintf (errmsg, "Writing the record of the inputs: %s",
+            record_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        unlink (tmp_file);
+        return ERROR;
+    }
+
+    return SUCCESS;
+}
+
+
+/******************************************************************************
+MODULE: free_espa_inputs_key
+
+PURPOSE: Frees the text of a key and leaves it empty.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+*****************************************************************************/
+void free_espa_inputs_key
+(
+    Espa_inputs_key_t *key  /* I/O: key to be freed; left empty */
+)
+{
+    free (key->text);
+    init_espa_inputs_key (key);
+}
@@ -0,0 +1,118 @@
+/*****************************************************************************
+FILE: espa_incremental.h
+
+PURPOSE: Contains defines, structures, and prototypes for incremental
+exports, which keep an output from an earlier run rather than generating it
+again when none of its inputs have changed.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The inputs of an output are described by a key: text naming the
+     format and options it was written with, the grid, and the content of
+     each band it holds.  The content of a band is its checksum from the XML
+     (see raw_binary_checksum.h), so the pixels are only read when a band
+     has no checksum.
+  2. Each output written incrementally has a record of its inputs next to
+     it, named after it with ESPA_INPUTS_SUFFIX.  The record holds the
+     FNV-1a hash of the key and the size of the output, followed by the key
+     itself, which must match in full before the output is kept.
+  3. Only what an output is made of goes into its key.  A GeoTIFF band is
+     made of its pixels and grid, so it is kept when only the processing
+     metadata of the XML (ex. app_version, production_date) has changed.
+     Formats which carry the metadata along with the pixels add the whole
+     rendered XML metadata to their key.
+  4. The record is removed before an output is written again and written
+     once the output is complete, so an interrupted run never leaves an
+     output which looks current.
+*****************************************************************************/
+
+#ifndef ESPA_INCREMENTAL_H
+#define ESPA_INCREMENTAL_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include "error_handler.h"
+#include "espa_metadata.h"
+
+/* Defines */
+#define ESPA_INCREMENTAL_ENV "ESPA_INCREMENTAL" /* set to yes to keep the
+                                     outputs whose inputs are unchanged */
+#define ESPA_INPUTS_SUFFIX ".inputs"   /* suffix of the record of the inputs,
+                                     following the name of the output */
+#define ESPA_INPUTS_MAGIC "espa_inputs" /* first word of a record */
+#define ESPA_INPUTS_VERSION 1          /* version of the records */
+
+/* Key describing the inputs of an output */
+typedef struct
+{
+    char *text;          /* text of the key; one line per input */
+    size_t len;          /* number of chars in the key */
+    size_t size;         /* number of bytes allocated for the text */
+} Espa_inputs_key_t;
+
+/* Prototypes */
+bool use_espa_incremental (void);
+
+void init_espa_inputs_key
+(
+    Espa_inputs_key_t *key  /* O: empty key */
+);
+
+int add_espa_inputs_key
+(
+    Espa_inputs_key_t *key, /* I/O: key to be added to */
+    const char *format,     /* I: printf format of the line to be added */
+    ...                     /* I: values of the format */
+);
+
+int add_espa_grid_inputs
+(
+    Espa_inputs_key_t *key, /* I/O: key to be added to */
+    const Espa_global_meta_t *gmeta /* I: global metadata with the grid */
+);
+
+int add_espa_band_inputs
+(
+    Espa_inputs_key_t *key, /* I/O: key to be added to */
+    Espa_internal_meta_t *xml_metadata, /* I/O: XML metadata structure; the
+                                    checksum of the band is recorded if it
+                                    has none */
+    int band                /* I: index of the band */
+);
+
+int add_espa_metadata_inputs
+(
+    Espa_inputs_key_t *key, /* I/O: key to be added to */
+    Espa_internal_meta_t *xml_metadata  /* I: XML metadata structure */
+);
+
+bool espa_output_is_current
+(
+    const char *output,     /* I: name of the output file */
+    const Espa_inputs_key_t *key  /* I: key of the inputs of the output */
+);
+
+int invalidate_espa_output
+(
+    const char *output      /* I: name of the output file about to be
+                                  written */
+);
+
+int record_espa_output_inputs
+(
+    const char *output,     /* I: name of the completed output file */
+    const Espa_inputs_key_t *key  /* I: key of the inputs of the output */
+);
+
+void free_espa_inputs_key
+(
+    Espa_inputs_key_t *key  /* I/O: key to be freed; left empty */
+);
+
+#endif
@@ -0,0 +1,564 @@
+/*****************************************************************************
+FILE: espa_io_stats.c
+
+PURPOSE: Contains functions for the optional I/O accounting.  Each opened
+file handle (or file descriptor) is mapped to an entry for its file name, so
+repeated opens of the same band are tallied together, and the entries are
+written out as JSON by an exit handler.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The tables are guarded by a spin lock built on the compiler atomics, so
+     the accounting is safe to use from threaded code without requiring the
+     tools to link with the pthread library.
+*****************************************************************************/
+
+#include <time.h>
+#include <stdint.h>
+#include "espa_io_stats.h"
+
+/* Tallies for a single file */
+typedef struct
+{
+    char *file_name;             /* name of the file */
+    Espa_io_file_type_t file_type; /* type of the file */
+    long long counts[4];         /* number of calls for each Espa_io_op_t */
+    long long nbytes[4];         /* number of bytes for each Espa_io_op_t */
+    double seconds[4];           /* wall time for each Espa_io_op_t */
+} Espa_io_stats_entry_t;
+
+/* Mapping of an open file handle, or file descriptor, to its entry */
+typedef struct
+{
+    const void *handle;          /* open file handle; NULL for a file
+                                    descriptor */
+    int fd;                      /* open file descriptor; -1 for a handle */
+    int entry;                   /* index of the entry for the file */
+} Espa_io_stats_handle_t;
+
+static const char *espa_io_op_names[] = {"open", "read", "write", "close"};
+static const char *espa_io_type_names[] = {"raw_binary", "tiff"};
+
+static int stats_state = -1;     /* -1 not yet checked, 0 off, 1 on */
+static char *stats_dest = NULL;  /* file for the summary; NULL for stderr */
+static char stats_lock = 0;      /* spin lock for the tables */
+static Espa_io_stats_entry_t *entries = NULL;  /* tallies for each file */
+static int nentries = 0;         /* number of entries in use */
+static int max_entries = 0;      /* number of entries allocated */
+static Espa_io_stats_handle_t *handles = NULL; /* open file handles */
+static int nhandles = 0;         /* number of handles in use */
+static int max_handles = 0;      /* number of handles allocated */
+
+/******************************************************************************
+MODULE: stats_lock_acquire
+
+PURPOSE: Acquires the spin lock for the tables.
+
+RETURN VALUE:
+Type = N/A
+
+NOTES:
+*****************************************************************************/
+static void stats_lock_acquire (void)
+{
+    while (__atomic_test_and_set (&stats_lock, __ATOMIC_ACQUIRE))
+        ;
+}
+
+
+/******************************************************************************
+MODULE: stats_lock_release
+
+PURPOSE: Releases the spin lock for the tables.
+
+RETURN VALUE:
+Type = N/A
+
+NOTES:
+*****************************************************************************/
+static void stats_lock_release (void)
+{
+    __atomic_clear (&stats_lock, __ATOMIC_RELEASE);
+}
+
+
+/******************************************************************************
+MODULE: write_json_string
+
+PURPOSE: Writes a string to the summary as a quoted JSON string.
+
+RETURN VALUE:
+Type = N/A
+
+NOTES:
+*****************************************************************************/
+static void write_json_string
+(
+    FILE *fptr,          /* I: summary file */
+    const char *str      /* I: string to be written */
+)
+{
+    const unsigned char *c;      /* current character */
+
+    fputc ('"', fptr);
+    for (c = (const unsigned char *) str; *c != '\0'; c++)
+    {
+        if (*c == '"' || *c == '\\')
+            fprintf (fptr, "\\%c", *c);
+        else if (*c < 0x20)
+            fprintf (fptr, "\\u%04x", *c);
+        else
+            fputc (*c, fptr);
+    }
+    fputc ('"', fptr);
+}
+
+
+/******************************************************************************
+MODULE: write_io_stats
+
+PURPOSE: Exit handler which writes the JSON summary of the accounted I/O.
+
+RETURN VALUE:
+Type = N/A
+
+NOTES:
+  1. Files which are still open at exit are reported with what has been
+     tallied so far.
+*****************************************************************************/
+static void write_io_stats (void)
+{
+    FILE *fptr = stderr;         /* summary file */
+    Espa_io_stats_entry_t *e;    /* current entry */
+    long long counts[4] = {0};   /* total calls for each operation */
+    long long nbytes[4] = {0};   /* total bytes for each operation */
+    double seconds[4] = {0.0};   /* total wall time for each operation */
+    int i;                       /* looping variable for the entries */
+    int op;                      /* looping variable for the operations */
+
+    if (stats_dest != NULL)
+    {
+        fptr = fopen (stats_dest, "w");
+        if (fptr == NULL)
+        {
+            fprintf (stderr, "Warning: unable to write the I/O statistics to "
+                "%s\n", stats_dest);
+            return;
+        }
+    }
+
+    stats_lock_acquire ();
+    fprintf (fptr, "{\n  \"files\": [");
+    for (i = 0; i < nentries; i++)
+    {
+        e = &entries[i];
+        fprintf (fptr, "%s\n    {\"file\": ", i == 0 ? "" : ",");
+        write_json_string (fptr, e->file_name);
+        fprintf (fptr, ", \"type\": \"%s\"", espa_io_type_names[e->file_type]);
+        for (op = ESPA_IO_OPEN; op <= ESPA_IO_CLOSE; op++)
+        {
+            fprintf (fptr, ",\n     \"%s\": {\"calls\": %lld, \"bytes\": %lld, "
+                "\"seconds\": %.6f}", espa_io_op_names[op], e->counts[op],
+                e->nbytes[op], e->seconds[op]);
+            counts[op] += e->counts[op];
+            nbytes[op] += e->nbytes[op];
+            seconds[op] += e->seconds[op];
+        }
+        fprintf (fptr, "}");
+    }
+    fprintf (fptr, "\n  ],\n  \"totals\": {");
+    for (op = ESPA_IO_OPEN; op <= ESPA_IO_CLOSE; op++)
+    {
+        fprintf (fptr, "%s\n    \"%s\": {\"calls\": %lld, \"bytes\": %lld, "
+            "\"seconds\": %.6f}", op == ESPA_IO_OPEN ? "" : ",",
+            espa_io_op_names[op], counts[op], nbytes[op], seconds[op]);
+    }
+    fprintf (fptr, "\n  }\n}\n");
+    stats_lock_release ();
+
+    if (fptr != stderr)
+        fclose (fptr);
+}
+
+
+/******************************************************************************
+MODULE: espa_io_stats_enabled
+
+PURPOSE: Determines whether the I/O accounting has been turned on, and
+registers the exit handler the first time it is.
+
+RETURN VALUE:
+Type = bool
+Value        Description
+-----        -----------
+true         I/O accounting is on
+false        I/O accounting is off
+
+NOTES:
+  1. The environment variable is only checked on the first call.
+*****************************************************************************/
+bool espa_io_stats_enabled (void)
+{
+    char *env = NULL;            /* value of the environment variable */
+    int state;                   /* current state of the accounting */
+
+    state = __atomic_load_n (&stats_state, __ATOMIC_ACQUIRE);
+    if (state >= 0)
+        return state == 1;
+
+    stats_lock_acquire ();
+    if (stats_state < 0)
+    {
+        env = getenv (ESPA_IO_STATS_ENV);
+        if (env == NULL || *env == '\0' || !strcmp (env, "no") ||
+            !strcmp (env, "0"))
+            __atomic_store_n (&stats_state, 0, __ATOMIC_RELEASE);
+        else
+        {
+            if (strcmp (env, "yes") && strcmp (env, "1"))
+                stats_dest = strdup (env);
+            if (atexit (write_io_stats) == 0)
+                __atomic_store_n (&stats_state, 1, __ATOMIC_RELEASE);
+            else
+                __atomic_store_n (&stats_state, 0, __ATOMIC_RELEASE);
+        }
+    }
+    stats_lock_release ();
+
+    return stats_state == 1;
+}
+
+
+/******************************************************************************
+MODULE: espa_io_stats_clock
+
+PURPOSE: Returns the current wall clock time for timing an operation.
+
+RETURN VALUE:
+Type = double
+Value        Description
+-----        -----------
+t            Monotonic time in seconds; 0.0 when the accounting is off
+
+NOTES:
+*****************************************************************************/
+double espa_io_stats_clock (void)
+{
+    struct timespec ts;          /* current time */
+
+    if (!espa_io_stats_enabled ())
+        return 0.0;
+
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+/******************************************************************************
+MODULE: tally_io_stats
+
+PURPOSE: Adds a completed operation to the tallies of an entry.
+
+RETURN VALUE:
+Type = N/A
+
+NOTES:
+  1. The stats lock must be held.
+*****************************************************************************/
+static void tally_io_stats
+(
+    int entry,           /* I: index of the entry for the file */
+    Espa_io_op_t op,     /* I: operation completed on the file */
+    size_t nbytes,       /* I: number of bytes read or written */
+    double start_time    /* I: espa_io_stats_clock at the start of the
+                               operation */
+)
+{
+    struct timespec ts;          /* current time */
+    Espa_io_stats_entry_t *e = &entries[entry];  /* entry for the file */
+
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    e->counts[op]++;
+    e->nbytes[op] += nbytes;
+    e->seconds[op] += ts.tv_sec + ts.tv_nsec * 1e-9 - start_time;
+}
+
+
+/******************************************************************************
+MODULE: find_io_stats_handle
+
+PURPOSE: Looks up the mapping of an open file handle or file descriptor.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+-1           The handle isn't being accounted for
+>= 0         Index of the mapping for the handle
+
+NOTES:
+  1. The stats lock must be held.
+  2. The search starts from the most recently opened handle, which is the
+     most likely to be in use.
+*****************************************************************************/
+static int find_io_stats_handle
+(
+    const void *handle,  /* I: handle of the file; NULL for a descriptor */
+    int fd               /* I: file descriptor; -1 for a handle */
+)
+{
+    int i;                       /* looping variable for the handles */
+
+    for (i = nhandles - 1; i >= 0; i--)
+    {
+        if (handles[i].handle == handle && handles[i].fd == fd)
+            break;
+    }
+
+    return i;
+}
+
+
+/******************************************************************************
+MODULE: open_io_stats
+
+PURPOSE: Starts accounting for a newly opened file handle or file descriptor
+and tallies the open.
+
+RETURN VALUE:
+Type = N/A
+
+NOTES:
+  1. The accounting is silently dropped for the file if the tables can't be
+     grown, since it must never cause the I/O itself to fail.
+  2. A stale mapping for the same handle, left by a file closed outside the
+     accounting, is replaced.
+*****************************************************************************/
+static void open_io_stats
+(
+    const void *handle,  /* I: handle of the opened file; NULL for a
+                               descriptor */
+    int fd,              /* I: file descriptor of the opened file; -1 for a
+                               handle */
+    const char *file_name, /* I: name of the opened file */
+    Espa_io_file_type_t file_type, /* I: type of the opened file */
+    double start_time    /* I: espa_io_stats_clock at the start of the open */
+)
+{
+    void *ptr = NULL;            /* reallocated table */
+    int entry;                   /* index of the entry for the file */
+    int i;                       /* index of a stale mapping */
+
+    stats_lock_acquire ();
+
+    i = find_io_stats_handle (handle, fd);
+    if (i >= 0)
+    {
+        handles[i] = handles[nhandles - 1];
+        nhandles--;
+    }
+
+    /* Find the entry for the file, or add one */
+    for (entry = 0; entry < nentries; entry++)
+    {
+        if (entries[entry].file_type == file_type &&
+            !strcmp (entries[entry].file_name, file_name))
+            break;
+    }
+    if (entry == nentries)
+    {
+        if (nentries == max_entries)
+        {
+            ptr = realloc (entries, (max_entries + 64) *
+                sizeof (Espa_io_stats_entry_t));
+            if (ptr == NULL)
+            {
+                stats_lock_release ();
+                return;
+            }
+            entries = ptr;
+            max_entries += 64;
+        }
+        memset (&entries[entry], 0, sizeof (Espa_io_stats_entry_t));
+        entries[entry].file_name = strdup (file_name);
+        if (entries[entry].file_name == NULL)
+        {
+            stats_lock_release ();
+            return;
+        }
+        entries[entry].file_type = file_type;
+        nentries++;
+    }
+
+    /* Map the handle to the entry */
+    if (nhandles == max_handles)
+    {
+        ptr = realloc (handles, (max_handles + 64) *
+            sizeof (Espa_io_stats_handle_t));
+        if (ptr == NULL)
+        {
+            stats_lock_release ();
+            return;
+        }
+        handles = ptr;
+        max_handles += 64;
+    }
+    handles[nhandles].handle = handle;
+    handles[nhandles].fd = fd;
+    handles[nhandles].entry = entry;
+    nhandles++;
+
+    tally_io_stats (entry, ESPA_IO_OPEN, 0, start_time);
+    stats_lock_release ();
+}
+
+
+/******************************************************************************
+MODULE: record_io_stats
+
+PURPOSE: Tallies a read, write, or close of an accounted file handle or file
+descriptor.
+
+RETURN VALUE:
+Type = N/A
+
+NOTES:
+  1. A close stops the accounting for the handle, since the same address (or
+     descriptor) may be handed out again for the next file opened.
+  2. Handles which were opened before the accounting was on are ignored.
+*****************************************************************************/
+static void record_io_stats
+(
+    const void *handle,  /* I: handle of the file; NULL for a descriptor */
+    int fd,              /* I: file descriptor; -1 for a handle */
+    Espa_io_op_t op,     /* I: operation completed on the file */
+    size_t nbytes,       /* I: number of bytes read or written */
+    double start_time    /* I: espa_io_stats_clock at the start of the
+                               operation */
+)
+{
+    int i;                       /* index of the mapping for the handle */
+
+    stats_lock_acquire ();
+
+    i = find_io_stats_handle (handle, fd);
+    if (i >= 0)
+    {
+        tally_io_stats (handles[i].entry, op, nbytes, start_time);
+        if (op == ESPA_IO_CLOSE)
+        {
+            handles[i] = handles[nhandles - 1];
+            nhandles--;
+        }
+    }
+
+    stats_lock_release ();
+}
+
+
+/******************************************************************************
+MODULE: espa_io_stats_open
+
+PURPOSE: Starts accounting for a newly opened file handle and tallies the
+open.
+
+RETURN VALUE:
+Type = N/A
+
+NOTES:
+*****************************************************************************/
+void espa_io_stats_open
+(
+    const void *handle,  /* I: handle of the opened file (FILE *, TIFF *) */
+    const char *file_name, /* I: name of the opened file */
+    Espa_io_file_type_t file_type, /* I: type of the opened file */
+    double start_time    /* I: espa_io_stats_clock at the start of the open */
+)
+{
+    if (!espa_io_stats_enabled () || handle == NULL)
+        return;
+
+    open_io_stats (handle, -1, file_name, file_type, start_time);
+}
+
+
+/******************************************************************************
+MODULE: espa_io_stats_open_fd
+
+PURPOSE: Starts accounting for a newly opened file descriptor and tallies the
+open.
+
+RETURN VALUE:
+Type = N/A
+
+NOTES:
+*****************************************************************************/
+void espa_io_stats_open_fd
+(
+    int fd,              /* I: file descriptor of the opened file */
+    const char *file_name, /* I: name of the opened file */
+    Espa_io_file_type_t file_type, /* I: type of the opened file */
+    double start_time    /* I: espa_io_stats_clock at the start of the open */
+)
+{
+    if (!espa_io_stats_enabled () || fd < 0)
+        return;
+
+    open_io_stats (NULL, fd, file_name, file_type, start_time);
+}
+
+
+/******************************************************************************
+MODULE: espa_io_stats_record
+
+PURPOSE: Tallies a read, write, or close of an accounted file handle.
+
+RETURN VALUE:
+Type = N/A
+
+NOTES:
+*****************************************************************************/
+void espa_io_stats_record
+(
+    const void *handle,  /* I: handle of the file */
+    Espa_io_op_t op,     /* I: operation completed on the file */
+    size_t nbytes,       /* I: number of bytes read or written */
+    double start_time    /* I: espa_io_stats_clock at the start of the
+                               operation */
+)
+{
+    if (!espa_io_stats_enabled () || handle == NULL)
+        return;
+
+    record_io_stats (handle, -1, op, nbytes, start_time);
+}
+
+
+/******************************************************************************
+MODULE: espa_io_stats_record_fd
+
+PURPOSE: Tallies a read, write, or close of an accounted file descriptor.
+
+RETURN VALUE:
+Type = N/A
+
+NOTES:
+*****************************************************************************/
+void espa_io_stats_record_fd
+(
+    int fd,              /* I: file descriptor of the file */
+    Espa_io_op_t op,     /* I: operation completed on the file */
+    size_t nbytes,       /* I: number of bytes read or written */
+    double start_time    /* I: espa_io_stats_clock at the start of the
+                               operation */
+)
+{
+    if (!espa_io_stats_enabled () || fd < 0)
+        return;
+
+    record_io_stats (NULL, fd, op, nbytes, start_time);
+}
@@ -0,0 +1,89 @@
+/*****************************************************************************
+FILE: espa_io_stats.h
+
+PURPOSE: Contains defines and prototypes for the optional I/O accounting,
+which tallies the calls, bytes, and wall time spent in the raw binary and
+Tiff open/read/write/close routines for each file and reports them as a JSON
+summary when the process exits.  Files accessed through a file descriptor
+(the window, batch, and mapped raw binary routines) are accounted for by the
+_fd variants.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The accounting is turned on by setting ESPA_IO_STATS_ENV.  A value of
+     yes (or 1) writes the summary to stderr; any other value is taken as
+     the name of the file to write the summary to.
+  2. When the accounting is off each routine only pays for a single check of
+     a cached flag.
+*****************************************************************************/
+
+#ifndef ESPA_IO_STATS_H
+#define ESPA_IO_STATS_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+
+/* Defines */
+#define ESPA_IO_STATS_ENV "ESPA_IO_STATS" /* turns on the I/O accounting and
+                                     names where the summary is written */
+
+/* Type of file being accounted for */
+typedef enum {
+  ESPA_IO_RAW_BINARY,
+  ESPA_IO_TIFF
+} Espa_io_file_type_t;
+
+/* Operation being accounted for */
+typedef enum {
+  ESPA_IO_OPEN,
+  ESPA_IO_READ,
+  ESPA_IO_WRITE,
+  ESPA_IO_CLOSE
+} Espa_io_op_t;
+
+/* Prototypes */
+bool espa_io_stats_enabled (void);
+
+double espa_io_stats_clock (void);
+
+void espa_io_stats_open
+(
+    const void *handle,  /* I: handle of the opened file (FILE *, TIFF *) */
+    const char *file_name, /* I: name of the opened file */
+    Espa_io_file_type_t file_type, /* I: type of the opened file */
+    double start_time    /* I: espa_io_stats_clock at the start of the open */
+);
+
+void espa_io_stats_open_fd
+(
+    int fd,              /* I: file descriptor of the opened file */
+    const char *file_name, /* I: name of the opened file */
+    Espa_io_file_type_t file_type, /* I: type of the opened file */
+    double start_time    /* I: espa_io_stats_clock at the start of the open */
+);
+
+void espa_io_stats_record
+(
+    const void *handle,  /* I: handle of the file */
+    Espa_io_op_t op,     /* I: operation completed on the file */
+    size_t nbytes,       /* I: number of bytes read or written */
+    double start_time    /* I: espa_io_stats_clock at the start of the
+                               operation */
+);
+
+void espa_io_stats_record_fd
+(
+    int fd,              /* I: file descriptor of the file */
+    Espa_io_op_t op,     /* I: operation completed on the file */
+    size_t nbytes,       /* I: number of bytes read or written */
+    double start_time    /* I: espa_io_stats_clock at the start of the
+                               operation */
+);
+
+#endif
@@ -0,0 +1,499 @@
+/*****************************************************************************
+FILE: espa_journal.c
+
+PURPOSE: Contains functions for the conversion journal, which records the
+bands as they are completed (see espa_journal.h).
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+*****************************************************************************/
+
+#include <unistd.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include "espa_journal.h"
+
+/* Size of the buffer for reading back an output file (bytes) */
+#define JOURNAL_READ_SIZE (4 * 1024 * 1024)
+
+
+/******************************************************************************
+MODULE: write_journal_header
+
+PURPOSE: Creates the journal file, or empties it, and writes its first line.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error writing the journal
+SUCCESS      Successfully started the journal
+
+NOTES:
+*****************************************************************************/
+static int write_journal_header
+(
+    Espa_journal_t *journal  /* I/O: journal; its file is (re)opened */
+)
+{
+    char FUNC_NAME[] = "write_journal_header";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+
+    if (journal->fp != NULL)
+        fclose (journal->fp);
+    journal->fp = fopen (journal->file_name, "w");
+    if (journal->fp == NULL)
+    {
+        sprintf (errmsg, "Creating the journal file: %s", journal->file_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return ERROR;
+    }
+
+    if (fprintf (journal->fp, "%s\t%d\t%s\n", ESPA_JOURNAL_MAGIC,
+        ESPA_JOURNAL_VERSION, journal->format) < 0 ||
+        fflush (journal->fp) != 0 || fsync (fileno (journal->fp)) != 0)
+    {
+        sprintf (errmsg, "Writing the journal file: %s", journal->file_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return ERROR;
+    }
+
+    return SUCCESS;
+}
+
+
+/******************************************************************************
+MODULE: read_journal_entries
+
+PURPOSE: Reads the bands recorded in an existing journal file.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error allocating memory for the bands
+SUCCESS      Successfully read the journal; no bands are read if there is no
+             journal or it is of another format or version
+
+NOTES:
+  1. A line without its newline was cut off when the conversion was
+     interrupted, so it is left out.
+*****************************************************************************/
+static int read_journal_entries
+(
+    Espa_journal_t *journal  /* I/O: journal; its bands are read */
+)
+{
+    char FUNC_NAME[] = "read_journal_entries";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    char line[4 * STR_SIZE];  /* current line of the journal */
+    char header[STR_SIZE];    /* expected first line of the journal */
+    int max_entries = 0;      /* number of bands allocated */
+    FILE *fp = NULL;          /* journal file */
+    Espa_journal_entry_t *entry = NULL; /* current band */
+    Espa_journal_entry_t *tmp = NULL;   /* reallocated bands */
+
+    fp = fopen (journal->file_name, "r");
+    if (fp == NULL)
+        return SUCCESS;
+
+    snprintf (header, sizeof (header), "%s\t%d\t%s\n", ESPA_JOURNAL_MAGIC,
+        ESPA_JOURNAL_VERSION, journal->format);
+    if (fgets (line, sizeof (line), fp) == NULL || strcmp (line, header))
+    {
+        fclose (fp);
+        return SUCCESS;
+    }
+
+    while (fgets (line, sizeof (line), fp) != NULL)
+    {
+        if (line[strlen (line) - 1] != '\n')
+            break;
+
+        if (journal->nentries == max_entries)
+        {
+            max_entries = max_entries == 0 ? 16 : 2 * max_entries;
+            tmp = realloc (journal->entry,
+                max_entries * sizeof (Espa_journal_entry_t));
+            if (tmp == NULL)
+            {
+                sprintf (errmsg, "Allocating memory for the journal bands");
+                error_handler (true, FUNC_NAME, errmsg);
+                fclose (fp);
+                return ERROR;
+            }
+            journal->entry = tmp;
+        }
+
+        entry = &journal->entry[journal->nentries];
+        if (sscanf (line, "%2047[^\t]\t%2047[^\t]\t%2047[^\t]\t%lld\t%15s",
+            entry->band, entry->source, entry->output, &entry->size,
+            entry->checksum) == 5)
+            journal->nentries++;
+    }
+
+    fclose (fp);
+    return SUCCESS;
+}
+
+
+/******************************************************************************
+MODULE: espa_journal_file_name
+
+PURPOSE: Names the journal file of a conversion after the XML metadata file
+and the output format.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        The name doesn't fit
+SUCCESS      Successfully named the journal file
+
+NOTES:
+*****************************************************************************/
+int espa_journal_file_name
+(
+    const char *xml_file,  /* I: name of the XML metadata file */
+    const char *format,    /* I: output format (ex. "hdf") */
+    char *journal_file     /* O: name of the journal file; STR_SIZE bytes */
+)
+{
+    char FUNC_NAME[] = "espa_journal_file_name";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    char *cptr = NULL;        /* pointer to the file extension */
+    int count;                /* number of chars copied in snprintf */
+
+    count = snprintf (journal_file, STR_SIZE, "%s", xml_file);
+    if (count < 0 || count >= STR_SIZE)
+    {
+        sprintf (errmsg, "Overflow of the journal file name");
+        error_handler (true, FUNC_NAME, errmsg);
+        return ERROR;
+    }
+    cptr = strrchr (journal_file, '.');
+    if (cptr != NULL && strcmp (cptr, ".xml") == 0)
+        *cptr = '\0';
+
+    count = strlen (journal_file);
+    count = snprintf (&journal_file[count], STR_SIZE - count, "_%s%s", format,
+        ESPA_JOURNAL_SUFFIX);
+    if (count < 0 || strlen (journal_file) + 1 >= STR_SIZE)
+    {
+        sprintf (errmsg, "Overflow of the journal file name");
+        error_handler (true, FUNC_NAME, errmsg);
+        return ERROR;
+    }
+
+    return SUCCESS;
+}
+
+
+/******************************************************************************
+MODULE: open_espa_journal
+
+PURPOSE: Opens the journal of a conversion, reading the bands recorded by an
+earlier run which was interrupted.
+
+RETURN VALUE:
+Type = Espa_journal_t *
+Value        Description
+-----        -----------
+NULL         Error opening the journal
+non-NULL     Journal, open for recording more bands
+
+NOTES:
+  1. A journal of another format or version is started over.
+*****************************************************************************/
+Espa_journal_t *open_espa_journal
+(
+    const char *xml_file,  /* I: name of the XML metadata file */
+    const char *format     /* I: output format (ex. "hdf") */
+)
+{
+    char FUNC_NAME[] = "open_espa_journal";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    Espa_journal_t *journal = NULL;  /* journal being opened */
+
+    journal = calloc (1, sizeof (Espa_journal_t));
+    if (journal == NULL)
+    {
+        sprintf (errmsg, "Allocating memory for the journal");
+        error_handler (true, FUNC_NAME, errmsg);
+        return NULL;
+    }
+
+    snprintf (journal->format, sizeof (journal->format), "%s", format);
+    if (espa_journal_file_name (xml_file, format, journal->file_name)
+        != SUCCESS || read_journal_entries (journal) != SUCCESS)
+    {  /* Error messages already written */
+        close_espa_journal (journal);
+        return NULL;
+    }
+
+    if (journal->nentries == 0)
+    {
+        if (write_journal_header (journal) != SUCCESS)
+        {  /* Error messages already written */
+            close_espa_journal (journal);
+            return NULL;
+        }
+    }
+    else
+    {
+        journal->fp = fopen (journal->file_name, "a");
+        if (journal->fp == NULL)
+        {
+            sprintf (errmsg, "Opening the journal file: %s",
+                journal->file_name);
+            error_handler (true, FUNC_NAME, errmsg);
+            close_espa_journal (journal);
+            return NULL;
+        }
+        printf ("Resuming from journal %s with %d recorded bands\n",
+            journal->file_name, journal->nentries);
+    }
+
+    return journal;
+}
+
+
+/******************************************************************************
+MODULE: find_espa_journal_entry
+
+PURPOSE: Finds the band in the journal, if it was recorded from the same
+source band.
+
+RETURN VALUE:
+Type = const Espa_journal_entry_t *
+Value        Description
+-----        -----------
+NULL         The band wasn't recorded (or there is no journal)
+non-NULL     Latest record of the band
+
+NOTES:
+*****************************************************************************/
+const Espa_journal_entry_t *find_espa_journal_entry
+(
+    const Espa_journal_t *journal, /* I: journal; may be NULL */
+    const char *band,      /* I: name of the band */
+    const char *source     /* I: checksum of the source band from the XML */
+)
+{
+    int i;               /* looping variable for the bands */
+
+    if (journal == NULL)
+        return NULL;
+
+    for (i = journal->nentries - 1; i >= 0; i--)
+    {
+        if (strcmp (journal->entry[i].band, band) == 0)
+        {
+            if (strcmp (journal->entry[i].source, source) == 0)
+                return &journal->entry[i];
+            return NULL;
+        }
+    }
+
+    return NULL;
+}
+
+
+/******************************************************************************
+MODULE: verify_espa_journal_file
+
+PURPOSE: Verifies the output file of a band has the size and checksum it was
+recorded with.
+
+RETURN VALUE:
+Type = bool
+Value        Description
+-----        -----------
+true         The file is as recorded
+false        The file is missing, or differs from what was recorded
+
+NOTES:
+  1. The file is read back to compute its checksum, which is much cheaper
+     than converting the band again.
+*****************************************************************************/
+bool verify_espa_journal_file
+(
+    const Espa_journal_entry_t *entry /* I: band whose output is the entire
+                                            file */
+)
+{
+    size_t nread;        /* number of bytes read */
+    unsigned char *buf = NULL;  /* bytes of the file */
+    bool same;           /* is the file as recorded? */
+    FILE *fp = NULL;     /* output file */
+    struct stat st;      /* status of the output file */
+    Rb_checksum_t sum;   /* checksum of the file */
+
+    if (stat (entry->output, &st) != 0 || st.st_size != entry->size)
+        return false;
+
+    fp = fopen (entry->output, "rb");
+    buf = malloc (JOURNAL_READ_SIZE);
+    if (fp == NULL || buf == NULL)
+    {
+        if (fp != NULL)
+            fclose (fp);
+        free (buf);
+        return false;
+    }
+
+    init_raw_binary_checksum (&sum);
+    while ((nread = fread (buf, 1, JOURNAL_READ_SIZE, fp)) > 0)
+        update_raw_binary_checksum (&sum, buf, nread);
+    same = !ferror (fp) && match_raw_binary_checksum (&sum, entry->checksum);
+
+    fclose (fp);
+    free (buf);
+    return same;
+}
+
+
+/******************************************************************************
+MODULE: record_espa_journal_entry
+
+PURPOSE: Records a completed band in the journal, syncing it to disk.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error writing the journal
+SUCCESS      Successfully recorded the band, or there is no journal
+
+NOTES:
+*****************************************************************************/
+int record_espa_journal_entry
+(
+    Espa_journal_t *journal, /* I: journal; may be NULL */
+    const char *band,      /* I: name of the band */
+    const char *source,    /* I: checksum of the source band from the XML */
+    const char *output,    /* I: file the band was written to */
+    long long size,        /* I: number of bytes written for the band */
+    const char *checksum   /* I: checksum of the bytes written */
+)
+{
+    char FUNC_NAME[] = "record_espa_journal_entry";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+
+    if (journal == NULL)
+        return SUCCESS;
+
+    if (fprintf (journal->fp, "%s\t%s\t%s\t%lld\t%s\n", band, source, output,
+        size, checksum) < 0 || fflush (journal->fp) != 0 ||
+        fsync (fileno (journal->fp)) != 0)
+    {
+        sprintf (errmsg, "Recording band %s in the journal file: %s", band,
+            journal->file_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return ERROR;
+    }
+
+    return SUCCESS;
+}
+
+
+/******************************************************************************
+MODULE: reset_espa_journal
+
+PURPOSE: Empties the journal, for a conversion which must start over.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error writing the journal
+SUCCESS      Successfully emptied the journal, or there is no journal
+
+NOTES:
+*****************************************************************************/
+int reset_espa_journal
+(
+    Espa_journal_t *journal /* I/O: journal to be emptied; may be NULL */
+)
+{
+    if (journal == NULL)
+        return SUCCESS;
+
+    free (journal->entry);
+    journal->entry = NULL;
+    journal->nentries = 0;
+    return write_journal_header (journal);
+}
+
+
+/******************************************************************************
+MODULE: remove_espa_journal
+
+PURPOSE: Removes the journal of a conversion which succeeded, and frees it.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error removing the journal file
+SUCCESS      Successfully removed the journal, or there is no journal
+
+NOTES:
+*****************************************************************************/
+int remove_espa_journal
+(
+    Espa_journal_t *journal /* I: journal of a conversion which succeeded;
+                                  freed; may be NULL */
+)
+{
+    char FUNC_NAME[] = "remove_espa_journal";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    int status = SUCCESS;     /* return status */
+
+    if (journal == NULL)
+        return SUCCESS;
+
+    if (journal->fp != NULL)
+    {
+        fclose (journal->fp);
+        journal->fp = NULL;
+    }
+    if (unlink (journal->file_name) != 0 && errno != ENOENT)
+    {
+        sprintf (errmsg, "Removing the journal file: %s", journal->file_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        status = ERROR;
+    }
+
+    close_espa_journal (journal);
+    return status;
+}
+
+
+/******************************************************************************
+MODULE: close_espa_journal
+
+PURPOSE: Closes the journal, keeping its file for a restart, and frees it.
+
+RETURN VALUE: None
+
+NOTES:
+*****************************************************************************/
+void close_espa_journal
+(
+    Espa_journal_t *journal /* I: journal to be kept for a restart; freed;
+                                  may be NULL */
+)
+{
+    if (journal == NULL)
+        return;
+
+    if (journal->fp != NULL)
+        fclose (journal->fp);
+    free (journal->entry);
+    free (journal);
+}
@@ -0,0 +1,124 @@
+/*****************************************************************************
+FILE: espa_journal.h
+
+PURPOSE: Contains defines, structures, and prototypes for the conversion
+journal, which records each band as it is completed so a conversion which
+was interrupted can be restarted without converting those bands again.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The journal is a small text file next to the XML metadata file, named
+     after it and the output format (see espa_journal_file_name).  The first
+     line identifies the journal and the format, and each following line is
+     one completed band: its name, the checksum of the source band from the
+     XML, the file it was written to, and the size and checksum (see
+     raw_binary_checksum.h) of what was written.
+  2. Each band is appended and synced to disk as it is completed.  A line
+     which was cut off by the interruption is ignored.
+  3. A band is skipped on restart only if it was recorded with the same
+     source checksum and its output still has the recorded size and
+     checksum, so an output which didn't reach the disk is converted again.
+     Bands whose XML has no checksum can't be told apart from a different
+     product of the same name, so the journal is only as trustworthy as the
+     checksums of the XML.
+  4. The journal is removed once the conversion succeeds.
+*****************************************************************************/
+
+#ifndef ESPA_JOURNAL_H
+#define ESPA_JOURNAL_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include "error_handler.h"
+#include "raw_binary_checksum.h"
+
+/* Defines */
+#define ESPA_JOURNAL_SUFFIX ".journal" /* suffix of the journal file name,
+                                     following the XML file name without
+                                     its extension and the format */
+#define ESPA_JOURNAL_MAGIC "espa_journal" /* first word of a journal */
+#define ESPA_JOURNAL_VERSION 1     /* version of the journal lines */
+
+/* Band recorded as completed */
+typedef struct
+{
+    char band[STR_SIZE];      /* name of the band */
+    char source[STR_SIZE];    /* checksum of the source band from the XML */
+    char output[STR_SIZE];    /* file the band was written to */
+    long long size;           /* number of bytes written for the band */
+    char checksum[RB_CHECKSUM_LEN]; /* checksum of the bytes written */
+} Espa_journal_entry_t;
+
+/* Journal of a conversion */
+typedef struct
+{
+    char file_name[STR_SIZE]; /* name of the journal file */
+    char format[STR_SIZE];    /* output format of the conversion */
+    int nentries;             /* number of bands recorded when the journal
+                                 was opened */
+    Espa_journal_entry_t *entry; /* bands recorded when the journal was
+                                 opened */
+    FILE *fp;                 /* journal file, open for appending */
+} Espa_journal_t;
+
+/* Prototypes */
+int espa_journal_file_name
+(
+    const char *xml_file,  /* I: name of the XML metadata file */
+    const char *format,    /* I: output format (ex. "hdf") */
+    char *journal_file     /* O: name of the journal file; STR_SIZE bytes */
+);
+
+Espa_journal_t *open_espa_journal
+(
+    const char *xml_file,  /* I: name of the XML metadata file */
+    const char *format     /* I: output format (ex. "hdf") */
+);
+
+const Espa_journal_entry_t *find_espa_journal_entry
+(
+    const Espa_journal_t *journal, /* I: journal; may be NULL */
+    const char *band,      /* I: name of the band */
+    const char *source     /* I: checksum of the source band from the XML */
+);
+
+bool verify_espa_journal_file
+(
+    const Espa_journal_entry_t *entry /* I: band whose output is the entire
+                                            file */
+);
+
+int record_espa_journal_entry
+(
+    Espa_journal_t *journal, /* I: journal; may be NULL */
+    const char *band,      /* I: name of the band */
+    const char *source,    /* I: checksum of the source band from the XML */
+    const char *output,    /* I: file the band was written to */
+    long long size,        /* I: number of bytes written for the band */
+    const char *checksum   /* I: checksum of the bytes written */
+);
+
+int reset_espa_journal
+(
+    Espa_journal_t *journal /* I/O: journal to be emptied; may be NULL */
+);
+
+int remove_espa_journal
+(
+    Espa_journal_t *journal /* I: journal of a conversion which succeeded;
+                                  freed; may be NULL */
+);
+
+void close_espa_journal
+(
+    Espa_journal_t *journal /* I: journal to be kept for a restart; freed;
+                                  may be NULL */
+);
+
+#endif
@@ -0,0 +1,342 @@
+/*****************************************************************************
+FILE: espa_materialize.c
+
+PURPOSE: Contains functions for materializing the files of a product in
+another directory as reflinks, hard links, or copies of the original files.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+*****************************************************************************/
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE     /* for copy_file_range */
+#endif
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <libgen.h>
+#include <sys/stat.h>
+#include <sys/ioctl.h>
+#ifdef __linux__
+#include <linux/fs.h>
+#endif
+#include "espa_materialize.h"
+
+#define MATERIALIZE_COPY_BYTES (8 << 20)  /* bytes copied at a time */
+
+/* Names of the methods, in the order of Espa_link_method_t */
+static const char *link_method_names[ESPA_LINK_NMETHODS] =
+    {"hardlink", "reflink", "copy"};
+
+/******************************************************************************
+MODULE: get_link_method
+
+PURPOSE: Gets the method of materializing files from its name.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Unknown method
+SUCCESS      Successfully got the method
+
+NOTES:
+*****************************************************************************/
+int get_link_method
+(
+    const char *name,            /* I: name of the method (hardlink, reflink,
+                                       or copy) */
+    Espa_link_method_t *method   /* O: method */
+)
+{
+    char FUNC_NAME[] = "get_link_method";   /* function name */
+    char errmsg[STR_SIZE];       /* error message */
+    int i;                       /* looping variable */
+
+    for (i = 0; i < ESPA_LINK_NMETHODS; i++)
+    {
+        if (!strcmp (name, link_method_names[i]))
+        {
+            *method = i;
+            return SUCCESS;
+        }
+    }
+
+    sprintf (errmsg, "Unknown link method %s; hardlink, reflink, or copy "
+        "expected", name);
+    error_handler (true, FUNC_NAME, errmsg);
+    return ERROR;
+}
+
+
+/******************************************************************************
+MODULE: link_method_name
+
+PURPOSE: Gets the name of a method of materializing files.
+
+RETURN VALUE:
+Type = const char *
+Value        Description
+-----        -----------
+name         Name of the method
+
+NOTES:
+*****************************************************************************/
+const char *link_method_name
+(
+    Espa_link_method_t method    /* I: method */
+)
+{
+    return link_method_names[method];
+}
+
+
+/******************************************************************************
+MODULE: copy_file_data
+
+PURPOSE: Copies the bytes of one open file to another, in the kernel where
+possible.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error copying the file
+SUCCESS      Successfully copied the file
+
+NOTES:
+  1. copy_file_range lets the filesystem clone or copy the blocks itself (ex.
+     server-side copies on NFS 4.2).  Where it isn't available the bytes are
+     read and written.
+*****************************************************************************/
+static int copy_file_data
+(
+    int src_fd,                  /* I: file to be copied */
+    int dest_fd,                 /* I: file to copy it to */
+    off_t nbytes                 /* I: number of bytes in the file */
+)
+{
+    off_t done = 0;              /* number of bytes copied */
+    ssize_t count = 0;           /* number of bytes copied at once */
+    ssize_t written;             /* number of bytes of a read written */
+    ssize_t n;                   /* number of bytes written at once */
+    char *buf = NULL;            /* buffer of the read/write copy */
+
+#ifdef __linux__
+    while (done < nbytes)
+    {
+        count = copy_file_range (src_fd, NULL, dest_fd, NULL,
+            MATERIALIZE_COPY_BYTES, 0);
+        if (count <= 0)
+            break;
+        done += count;
+    }
+    if (done == nbytes)
+        return SUCCESS;
+    if (count < 0 && errno != ENOSYS && errno != EXDEV && errno != EINVAL &&
+        errno != EOPNOTSUPP)
+        return ERROR;
+#endif
+
+    /* Copy the rest with reads and writes */
+    buf = malloc (MATERIALIZE_COPY_BYTES);
+    if (buf == NULL)
+        return ERROR;
+    while (done < nbytes)
+    {
+        count = pread (src_fd, buf, MATERIALIZE_COPY_BYTES, done);
+        if (count <= 0)
+            break;
+        for (written = 0; written < count; )
+        {
+            n = pwrite (dest_fd, buf + written, count - written,
+                done + written);
+            if (n <= 0)
+            {
+                free (buf);
+                return ERROR;
+            }
+            written += n;
+        }
+        done += count;
+    }
+    free (buf);
+
+    return done == nbytes ? SUCCESS : ERROR;
+}
+
+
+/******************************************************************************
+MODULE: clone_file
+
+PURPOSE: Creates a reflink or a copy of a file.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error creating the file
+SUCCESS      Successfully created the reflink or copy
+
+NOTES:
+*****************************************************************************/
+static int clone_file
+(
+    const char *src_file,        /* I: file to be cloned */
+    const char *dest_file,       /* I: file to be created */
+    const struct stat *src_stat, /* I: status of src_file */
+    Espa_link_method_t method,   /* I: ESPA_LINK_REFLINK or ESPA_LINK_COPY */
+    Espa_link_method_t *used     /* O: method used */
+)
+{
+    char FUNC_NAME[] = "clone_file";   /* function name */
+    char errmsg[STR_SIZE];       /* error message */
+    int src_fd;                  /* file to be cloned */
+    int dest_fd;                 /* file being created */
+    int status = SUCCESS;        /* return status */
+
+    src_fd = open (src_file, O_RDONLY);
+    if (src_fd == -1)
+    {
+        sprintf (errmsg, "Opening %s", src_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return ERROR;
+    }
+    dest_fd = open (dest_file, O_WRONLY | O_CREAT | O_EXCL,
+        src_stat->st_mode & 0777);
+    if (dest_fd == -1)
+    {
+        sprintf (errmsg, "Creating %s", dest_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        close (src_fd);
+        return ERROR;
+    }
+
+    *used = ESPA_LINK_COPY;
+#ifdef FICLONE
+    if (method == ESPA_LINK_REFLINK && ioctl (dest_fd, FICLONE, src_fd) == 0)
+        *used = ESPA_LINK_REFLINK;
+#endif
+    if (*used == ESPA_LINK_COPY &&
+        copy_file_data (src_fd, dest_fd, src_stat->st_size) != SUCCESS)
+    {
+        sprintf (errmsg, "Copying %s to %s", src_file, dest_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        status = ERROR;
+    }
+
+    close (src_fd);
+    if (close (dest_fd) != 0 && status == SUCCESS)
+    {
+        sprintf (errmsg, "Closing %s", dest_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        status = ERROR;
+    }
+    if (status != SUCCESS)
+        unlink (dest_file);
+
+    return status;
+}
+
+
+/******************************************************************************
+MODULE: materialize_file
+
+PURPOSE: Materializes a file in another directory, under its base name, as a
+hard link, reflink, or copy of the file.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error materializing the file
+SUCCESS      Successfully materialized the file
+
+NOTES:
+  1. A file already in out_dir under that name is replaced, unless it is
+     src_file itself.
+  2. The requested method falls back to the next one (see
+     espa_materialize.h) for files it isn't supported for; used tells which
+     method was used.
+*****************************************************************************/
+int materialize_file
+(
+    const char *src_file,        /* I: file to be materialized */
+    const char *out_dir,         /* I: directory to materialize it in, under
+                                       the base name of src_file */
+    Espa_link_method_t method,   /* I: preferred method */
+    Espa_link_method_t *used     /* O: method used */
+)
+{
+    char FUNC_NAME[] = "materialize_file";   /* function name */
+    char errmsg[STR_SIZE];       /* error message */
+    char base[STR_SIZE];         /* copy of src_file for basename */
+    char dest_file[STR_SIZE];    /* name of the materialized file */
+    int count;                   /* number of chars copied in snprintf */
+    struct stat src_stat;        /* status of src_file */
+    struct stat dest_stat;       /* status of an existing dest_file */
+
+    count = snprintf (base, sizeof (base), "%s", src_file);
+    if (count < 0 || count >= sizeof (base))
+    {
+        sprintf (errmsg, "Overflow of base string");
+        error_handler (true, FUNC_NAME, errmsg);
+        return ERROR;
+    }
+    count = snprintf (dest_file, sizeof (dest_file), "%s/%s", out_dir,
+        basename (base));
+    if (count < 0 || count >= sizeof (dest_file))
+    {
+        sprintf (errmsg, "Overflow of dest_file string");
+        error_handler (true, FUNC_NAME, errmsg);
+        return ERROR;
+    }
+
+    if (stat (src_file, &src_stat) != 0)
+    {
+        sprintf (errmsg, "Getting the status of %s", src_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return ERROR;
+    }
+
+    /* Leave the file alone if it is already there, and replace any other
+       file of that name */
+    if (stat (dest_file, &dest_stat) == 0)
+    {
+        if (dest_stat.st_dev == src_stat.st_dev &&
+            dest_stat.st_ino == src_stat.st_ino)
+        {
+            *used = ESPA_LINK_HARDLINK;
+            return SUCCESS;
+        }
+        if (unlink (dest_file) != 0)
+        {
+            sprintf (errmsg, "Removing the existing %s", dest_file);
+            error_handler (true, FUNC_NAME, errmsg);
+            return ERROR;
+        }
+    }
+
+    if (method == ESPA_LINK_HARDLINK)
+    {
+        if (link (src_file, dest_file) == 0)
+        {
+            *used = ESPA_LINK_HARDLINK;
+            return SUCCESS;
+        }
+        if (errno != EXDEV && errno != EPERM && errno != EMLINK &&
+            errno != EOPNOTSUPP)
+        {
+            sprintf (errmsg, "Linking %s to %s", dest_file, src_file);
+            error_handler (true, FUNC_NAME, errmsg);
+            return ERROR;
+        }
+        method = ESPA_LINK_REFLINK;
+    }
+
+    return clone_file (src_file, dest_file, &src_stat, method, used);
+}
@@ -0,0 +1,62 @@
+/*****************************************************************************
+FILE: espa_materialize.h
+
+PURPOSE: Contains defines and prototypes for materializing the files of a
+product in another directory as reflinks, hard links, or copies of the
+original files.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. A reflink (FICLONE) shares the blocks of the original file until either
+     file is written, so it costs no space or time and is safe to modify.  It
+     needs a filesystem which supports it (ex. XFS, Btrfs) with both files on
+     the same filesystem.
+  2. A hard link is the original file under another name, so modifying either
+     one in place (ex. clip_band_misalignment) modifies both.
+  3. When the requested method isn't supported for a file, the next one is
+     used: hard link, then reflink, then copy.
+*****************************************************************************/
+
+#ifndef ESPA_MATERIALIZE_H
+#define ESPA_MATERIALIZE_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "error_handler.h"
+
+/* Methods of materializing a file, in order of preference for falling back */
+typedef enum {
+  ESPA_LINK_HARDLINK,   /* hard link to the original file */
+  ESPA_LINK_REFLINK,    /* copy-on-write clone of the original file */
+  ESPA_LINK_COPY,       /* copy of the original file */
+  ESPA_LINK_NMETHODS    /* number of methods */
+} Espa_link_method_t;
+
+/* Prototypes */
+int get_link_method
+(
+    const char *name,            /* I: name of the method (hardlink, reflink,
+                                       or copy) */
+    Espa_link_method_t *method   /* O: method */
+);
+
+const char *link_method_name
+(
+    Espa_link_method_t method    /* I: method */
+);
+
+int materialize_file
+(
+    const char *src_file,        /* I: file to be materialized */
+    const char *out_dir,         /* I: directory to materialize it in, under
+                                       the base name of src_file */
+    Espa_link_method_t method,   /* I: preferred method */
+    Espa_link_method_t *used     /* O: method used */
+);
+
+#endif
@@ -16,85 +16,269 @@ NOTES:
      http://espa.cr.usgs.gov/schema/espa_internal_metadata_v1_0.xsd.
   2. This code relies on the libxml2 library developed for the Gnome project.
 *****************************************************************************/
+#include <math.h>
 #include <sys/stat.h>
 #include "espa_metadata.h"
+#include "espa_band_index.h"
+#include "espa_trace.h"
+#include "espa_metrics.h"
+
+/* Compiled ESPA schema, cached for the life of the process */
+static xmlSchemaPtr espa_schema = NULL;
+static char espa_schema_lock = 0;    /* spin lock for compiling the schema */
+
+/* Has the XML library been initialized by init_espa_xml? */
+static int espa_xml_initialized = 0;
 
 /******************************************************************************
-MODULE:  validate_xml_file
+MODULE:  free_espa_schema
 
-PURPOSE:  Validates the specified XML file with the specified schema file/URL.
+PURPOSE:  Exit handler which frees the cached ESPA schema and cleans up the
+XML library.
 
 RETURN VALUE:
-Type = int
+Type = None
+
+NOTES:
+******************************************************************************/
+static void free_espa_schema (void)
+{
+    if (espa_schema != NULL)
+        xmlSchemaFree (espa_schema);
+    espa_schema = NULL;
+    xmlSchemaCleanupTypes();
+    xmlCleanupParser();   /* cleanup the XML library */
+}
+
+
+/******************************************************************************
+MODULE:  get_espa_schema
+
+PURPOSE:  Returns the compiled ESPA schema, compiling it on the first call.
+
+RETURN VALUE:
+Type = xmlSchemaPtr
 Value           Description
 -----           -----------
-ERROR           XML does not validate against the specified schema
-SUCCESS         XML validates
+NULL            Error reading or compiling the schema
+non-NULL        Compiled schema
 
 NOTES:
+  1. The schema location is resolved from the ESPA_SCHEMA environment
+     variable, then LOCAL_ESPA_SCHEMA, then ESPA_SCHEMA on the first call.
+  2. The compiled schema is only read during validation, so it may be shared
+     by any number of validation contexts, including ones in other threads.
+     It is freed when the process exits and must not be freed by the caller.
+  3. A failed compile is not cached, so the next call tries again.
 ******************************************************************************/
-int validate_xml_file
-(
-    char *meta_file           /* I: name of metadata file to be validated */
-)
+xmlSchemaPtr get_espa_schema (void)
 {
-    char FUNC_NAME[] = "validate_xml_file";   /* function name */
+    char FUNC_NAME[] = "get_espa_schema";   /* function name */
     char errmsg[STR_SIZE];        /* error message */
     char *schema_file = NULL;     /* name of schema file or URL to be validated
                                      against */
-    int status;                   /* return status */
-    xmlDocPtr doc = NULL;         /* resulting document tree */
     xmlSchemaPtr schema = NULL;   /* pointer to the schema */
     xmlSchemaParserCtxtPtr ctxt = NULL;  /* parser context for the schema */
-    xmlSchemaValidCtxtPtr valid_ctxt = NULL;  /* pointer to validate from the
-                                                 schema */
     struct stat statbuf;          /* buffer for the file stat function */
 
-    /* Get the ESPA schema environment variable which specifies the location
-       of the XML schema to be used */
-    schema_file = getenv ("ESPA_SCHEMA");
-    if (schema_file == NULL)
-    {  /* ESPA schema environment variable wasn't defined. Try the version in
-          /usr/local... */
-        schema_file = LOCAL_ESPA_SCHEMA;
-        if (stat (schema_file, &statbuf) == -1)
-        {  /* /usr/local ESPA schema file doesn't exist.  Try the version on
-              the ESPA http site... */
-            schema_file = ESPA_SCHEMA;
-        }
+    schema = __atomic_load_n (&espa_schema, __ATOMIC_ACQUIRE);
+    if (schema != NULL)
+    {
+        espa_metrics_cache (ESPA_METRICS_SCHEMA, true);
+        return schema;
     }
 
-    /* Set up the schema parser and parse the schema file/URL */
-    xmlLineNumbersDefault (1);
-    ctxt = xmlSchemaNewParserCtxt (schema_file);
-    xmlSchemaSetParserErrors (ctxt, (xmlSchemaValidityErrorFunc) fprintf,
-        (xmlSchemaValidityWarningFunc) fprintf, stderr);
-    schema = xmlSchemaParse (ctxt);
+    while (__atomic_test_and_set (&espa_schema_lock, __ATOMIC_ACQUIRE))
+        ;
 
-    /* Free the schema parser context */
-    xmlSchemaFreeParserCtxt (ctxt);
+    /* Another thread may have compiled the schema while this one waited */
+    schema = espa_schema;
+    espa_metrics_cache (ESPA_METRICS_SCHEMA, schema != NULL);
+    if (schema == NULL)
+    {
+        /* Get the ESPA schema environment variable which specifies the
+           location of the XML schema to be used */
+        schema_file = getenv ("ESPA_SCHEMA");
+        if (schema_file == NULL)
+        {  /* ESPA schema environment variable wasn't defined. Try the version
+              in /usr/local... */
+            schema_file = LOCAL_ESPA_SCHEMA;
+            if (stat (schema_file, &statbuf) == -1)
+            {  /* /usr/local ESPA schema file doesn't exist.  Try the version
+                  on the ESPA http site... */
+                schema_file = ESPA_SCHEMA;
+            }
+        }
 
-    /* Load the XML file and parse it to the document tree */
-    doc = xmlReadFile (meta_file, NULL, 0);
-    if (doc == NULL)
+        /* Set up the schema parser and parse the schema file/URL */
+        xmlLineNumbersDefault (1);
+        ctxt = xmlSchemaNewParserCtxt (schema_file);
+        xmlSchemaSetParserErrors (ctxt, (xmlSchemaValidityErrorFunc) fprintf,
+            (xmlSchemaValidityWarningFunc) fprintf, stderr);
+        schema = xmlSchemaParse (ctxt);
+
+        /* Free the schema parser context */
+        xmlSchemaFreeParserCtxt (ctxt);
+
+        if (schema != NULL)
+        {
+            if (atexit (free_espa_schema) != 0)
+            {
+                sprintf (errmsg, "Unable to register the schema cleanup; "
+                    "the schema will not be freed at exit");
+                error_handler (false, FUNC_NAME, errmsg);
+            }
+            __atomic_store_n (&espa_schema, schema, __ATOMIC_RELEASE);
+        }
+    }
+
+    __atomic_clear (&espa_schema_lock, __ATOMIC_RELEASE);
+
+    if (schema == NULL)
     {
-        sprintf (errmsg, "Could not parse %s", meta_file);
+        sprintf (errmsg, "Unable to read or compile the schema %s.  "
+            "ESPA_SCHEMA environment variable isn't defined.  The first "
+            "default schema location of %s doesn't exist.  And the second "
+            "default location of %s was used as the last default.",
+            schema_file != NULL ? schema_file : "(unknown)",
+            LOCAL_ESPA_SCHEMA, ESPA_SCHEMA);
         error_handler (true, FUNC_NAME, errmsg);
-        sprintf (errmsg, "Possible schema file not found.  ESPA_SCHEMA "
-            "environment variable isn't defined.  The first default schema "
-            "location of %s doesn't exist.  And the second default location of "
-            "%s was used as the last default.", LOCAL_ESPA_SCHEMA, ESPA_SCHEMA);
+    }
+
+    return schema;
+}
+
+
+/******************************************************************************
+MODULE:  init_espa_xml
+
+PURPOSE:  Initializes the XML library for processes which parse metadata from
+more than one thread.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. Call once from the main thread before any thread reads, parses,
+     validates, or writes metadata, and call shutdown_espa_xml once they are
+     all done.  In between, the metadata routines no longer clean up the XML
+     library after each file, which isn't safe while other threads are using
+     it.
+  2. Processes which only handle metadata from one thread don't need to
+     call it.
+******************************************************************************/
+void init_espa_xml (void)
+{
+    xmlInitParser ();
+    __atomic_store_n (&espa_xml_initialized, 1, __ATOMIC_RELEASE);
+}
+
+
+/******************************************************************************
+MODULE:  shutdown_espa_xml
+
+PURPOSE:  Frees the cached ESPA schema and cleans up the XML library, once all
+the threads are done with the metadata.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. The metadata routines may be used again afterwards; the schema is
+     compiled again when it is next needed.
+******************************************************************************/
+void shutdown_espa_xml (void)
+{
+    __atomic_store_n (&espa_xml_initialized, 0, __ATOMIC_RELEASE);
+    free_espa_schema ();
+}
+
+
+/******************************************************************************
+MODULE:  cleanup_espa_xml
+
+PURPOSE:  Cleans up the XML library once a metadata file has been processed,
+unless the compiled ESPA schema is cached.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. Cleaning up the XML library frees the built-in schema types which the
+     cached schema refers to, so it is deferred to the exit handler once the
+     schema has been compiled.
+  2. Cleaning up the XML library while another thread is using it isn't
+     safe, so it is also skipped once init_espa_xml has been called;
+     shutdown_espa_xml cleans up instead.
+******************************************************************************/
+void cleanup_espa_xml (void)
+{
+    if (__atomic_load_n (&espa_xml_initialized, __ATOMIC_ACQUIRE) ||
+        __atomic_load_n (&espa_schema, __ATOMIC_ACQUIRE) != NULL)
+        return;
+
+    xmlCleanupParser();   /* cleanup the XML library */
+    xmlMemoryDump();      /* for debugging */
+}
+
+
+/******************************************************************************
+MODULE:  validate_xml_doc
+
+PURPOSE:  Validates an XML document which has already been read into memory
+against the ESPA schema.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           XML does not validate against the specified schema
+SUCCESS         XML validates
+
+NOTES:
+  1. The schema is compiled once and cached for the process (see
+     get_espa_schema).
+  2. The document is not freed.
+******************************************************************************/
+int validate_xml_doc
+(
+    xmlDocPtr doc,            /* I: document tree to be validated */
+    char *meta_file           /* I: name of metadata file the document was
+                                    read from, for error messages */
+)
+{
+    char FUNC_NAME[] = "validate_xml_doc";   /* function name */
+    char errmsg[STR_SIZE];        /* error message */
+    int status;                   /* return status */
+    xmlSchemaPtr schema = NULL;   /* pointer to the schema */
+    xmlSchemaValidCtxtPtr valid_ctxt = NULL;  /* pointer to validate from the
+                                                 schema */
+    ESPA_TRACE_SCOPE (trace, "validate_xml_doc", meta_file);  /* timing */
+
+    /* Get the compiled schema */
+    schema = get_espa_schema ();
+    if (schema == NULL)
+    {
+        sprintf (errmsg, "Could not validate %s without the schema",
+            meta_file);
         error_handler (true, FUNC_NAME, errmsg);
         return (ERROR);
     }
 
     /* Identify the schema file as the validation source */
     valid_ctxt = xmlSchemaNewValidCtxt (schema);
+    if (valid_ctxt == NULL)
+    {
+        sprintf (errmsg, "Creating the validation context for %s", meta_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
     xmlSchemaSetValidErrors (valid_ctxt, (xmlSchemaValidityErrorFunc) fprintf,
         (xmlSchemaValidityWarningFunc) fprintf, stderr);
 
     /* Validate the XML metadata against the schema */
     status = xmlSchemaValidateDoc (valid_ctxt, doc);
+    xmlSchemaFreeValidCtxt (valid_ctxt);
     if (status > 0)
     {
         sprintf (errmsg, "%s fails to validate", meta_file);
@@ -109,20 +293,240 @@ int validate_xml_file
         return (ERROR);
     }
 
-    /* Free the resources and clean up the memory */
-    xmlSchemaFreeValidCtxt (valid_ctxt);
+    /* Successful completion */
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  validate_xml_file
+
+PURPOSE:  Validates the specified XML file with the specified schema file/URL.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           XML does not validate against the specified schema
+SUCCESS         XML validates
+
+NOTES:
+  1. The schema is compiled once and cached for the process (see
+     get_espa_schema), so repeated validations only parse the XML file.
+  2. Tools which go on to parse the file should use
+     validate_and_parse_metadata instead, which only reads the file once.
+******************************************************************************/
+int validate_xml_file
+(
+    char *meta_file           /* I: name of metadata file to be validated */
+)
+{
+    char FUNC_NAME[] = "validate_xml_file";   /* function name */
+    char errmsg[STR_SIZE];        /* error message */
+    int status;                   /* return status */
+    xmlDocPtr doc = NULL;         /* resulting document tree */
+    ESPA_TRACE_SCOPE (trace, "validate_xml_file", meta_file);  /* timing */
+
+    /* Load the XML file and parse it to the document tree */
+    doc = xmlReadFile (meta_file, NULL, 0);
+    if (doc == NULL)
+    {
+        sprintf (errmsg, "Could not parse %s", meta_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Validate the document against the schema */
+    status = validate_xml_doc (doc, meta_file);
     xmlFreeDoc (doc);
-    if (schema != NULL)
-        xmlSchemaFree (schema);
-    xmlSchemaCleanupTypes();
-    xmlCleanupParser();   /* cleanup the XML library */
-    xmlMemoryDump();      /* for debugging */
 
-    /* Successful completion */
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  espa_arena_calloc
+
+PURPOSE:  Allocates zeroed memory for an array from the metadata arena.
+
+RETURN VALUE:
+Type = void *
+Value           Description
+-----           -----------
+NULL            Error allocating the memory
+non-NULL        Zeroed memory, owned by the arena (or by the caller if arena
+                is NULL)
+
+NOTES:
+  1. Memory from the arena is not individually freed; it is released along
+     with the arena by free_espa_arena.
+  2. Requests larger than ESPA_ARENA_BLOCK_SIZE get a block of their own.
+******************************************************************************/
+void *espa_arena_calloc
+(
+    Espa_meta_arena_t *arena, /* I: arena to allocate from; NULL to allocate
+                                    from the heap */
+    size_t nmemb,             /* I: number of elements to allocate */
+    size_t size               /* I: size of each element */
+)
+{
+    Espa_meta_arena_block_t *block = NULL;  /* block to allocate from */
+    size_t nbytes = nmemb * size; /* number of bytes to allocate */
+    size_t offset = 0;            /* aligned offset in the block */
+    size_t block_size;            /* size of a new block */
+
+    if (arena == NULL)
+        return (calloc (nmemb, size));
+    if (size != 0 && nbytes / size != nmemb)
+        return (NULL);
+
+    /* Keep every allocation aligned for the metadata types */
+    block = arena->block;
+    if (block != NULL)
+        offset = (block->used + 7) & ~(size_t) 7;
+    if (block == NULL || offset + nbytes > block->size)
+    {
+        block_size = nbytes > ESPA_ARENA_BLOCK_SIZE ? nbytes :
+            ESPA_ARENA_BLOCK_SIZE;
+        block = calloc (1, sizeof (Espa_meta_arena_block_t) + block_size);
+        if (block == NULL)
+            return (NULL);
+        block->size = block_size;
+        block->next = arena->block;
+        arena->block = block;
+        offset = 0;
+    }
+
+    block->used = offset + nbytes;
+    return (block->data + offset);
+}
+
+
+/******************************************************************************
+MODULE:  free_espa_arena
+
+PURPOSE:  Frees all the memory allocated from the metadata arena.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. The arena itself is not freed, and is left empty for reuse.
+******************************************************************************/
+void free_espa_arena
+(
+    Espa_meta_arena_t *arena  /* I: arena whose blocks are to be freed */
+)
+{
+    Espa_meta_arena_block_t *block = NULL;  /* current block */
+
+    if (arena == NULL)
+        return;
+
+    while (arena->block != NULL)
+    {
+        block = arena->block;
+        arena->block = block->next;
+        free (block);
+    }
+}
+
+
+/******************************************************************************
+MODULE:  init_name_list
+
+PURPOSE:  Initializes an empty name list.
+
+RETURN VALUE:
+Type = None
+******************************************************************************/
+void init_name_list
+(
+    Espa_name_list_t *list    /* I: name list to be initialized */
+)
+{
+    list->nnames = 0;
+    list->nalloc = 0;
+    list->names = NULL;
+    list->arena.block = NULL;
+}
+
+
+/******************************************************************************
+MODULE:  add_name_to_list
+
+PURPOSE:  Appends a name to the name list, growing the list as needed.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error adding the name to the list
+SUCCESS         Successfully added the name
+
+NOTES:
+  1. The list doubles in size from the arena when it fills up.  The names
+     array may move, so pointers into it are only valid until the next add.
+******************************************************************************/
+int add_name_to_list
+(
+    Espa_name_list_t *list,   /* I/O: name list to be added to */
+    const char *name          /* I: name to be added */
+)
+{
+    char FUNC_NAME[] = "add_name_to_list";  /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    char (*names)[STR_SIZE] = NULL;  /* grown array of names */
+    int nalloc;               /* number of names in the grown array */
+    int count;                /* number of chars copied in snprintf */
+
+    if (list->nnames == list->nalloc)
+    {
+        nalloc = list->nalloc == 0 ? ESPA_NAME_LIST_INIT : 2 * list->nalloc;
+        names = espa_arena_calloc (&list->arena, nalloc, STR_SIZE);
+        if (names == NULL)
+        {
+            sprintf (errmsg, "Allocating space for %d names", nalloc);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+        if (list->nnames > 0)
+            memcpy (names, list->names, (size_t) list->nnames * STR_SIZE);
+        list->names = names;
+        list->nalloc = nalloc;
+    }
+
+    count = snprintf (list->names[list->nnames], STR_SIZE, "%s", name);
+    if (count < 0 || count >= STR_SIZE)
+    {
+        sprintf (errmsg, "Overflow of names[%d] string", list->nnames);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    list->nnames++;
     return (SUCCESS);
 }
 
 
+/******************************************************************************
+MODULE:  free_name_list
+
+PURPOSE:  Frees the names in the name list and leaves it empty.
+
+RETURN VALUE:
+Type = None
+******************************************************************************/
+void free_name_list
+(
+    Espa_name_list_t *list    /* I: name list to be freed */
+)
+{
+    free_espa_arena (&list->arena);
+    init_name_list (list);
+}
+
+
 /******************************************************************************
 MODULE:  init_metadata_struct
 
@@ -148,6 +552,8 @@ void init_metadata_struct
     /* Initialze the number of bands */
     internal_meta->nbands = 0;
     internal_meta->band = NULL;
+    internal_meta->arena = NULL;
+    internal_meta->band_index = NULL;
 
     /* Initialize the global metadata values to fill for use by the write
        metadata routines */
@@ -177,6 +583,7 @@ void init_metadata_struct
     gmeta->bounding_coords[1] = ESPA_FLOAT_META_FILL;
     gmeta->bounding_coords[2] = ESPA_FLOAT_META_FILL;
     gmeta->bounding_coords[3] = ESPA_FLOAT_META_FILL;
+    strcpy (gmeta->footprint, ESPA_STRING_META_FILL);
     gmeta->proj_info.proj_type = ESPA_INT_META_FILL;
     gmeta->proj_info.datum_type = ESPA_NODATUM;
     gmeta->orientation_angle = ESPA_FLOAT_META_FILL;
@@ -184,51 +591,32 @@ void init_metadata_struct
 
 
 /******************************************************************************
-MODULE:  allocate_band_metadata
+MODULE:  init_band_metadata
 
-PURPOSE:  Allocates memory in the ESPA internal metadata structure for nbands.
+PURPOSE:  Initializes the band metadata from the first band through the last
+band of the ESPA internal metadata structure.
 
-RETURN VALUE:
-Type = int
-Value           Description
------           -----------
-ERROR           Error allocating memory for the nbands
-SUCCESS         Successfully allocated memory
+RETURN VALUE:  N/A
 
 NOTES:
-  1. Initializes the bitmap_description and class_values for each band to NULL
-     and sets the nbits, nclass, ncover to 0.
+  1. Sets the nbits, nclass, ncover fields in the band metadata to 0 for each
+     band and initializes the pointers to NULL.  The other fields are set to
+     fill to make it easy to distinguish if they were populated by reading
+     an input metadata file or assigned directly.
 ******************************************************************************/
-int allocate_band_metadata
+static void init_band_metadata
 (
-    Espa_internal_meta_t *internal_meta,  /* I: pointer to internal metadata
+    Espa_internal_meta_t *internal_meta,  /* I/O: pointer to internal metadata
                                                 structure */
-    int nbands                            /* I: number of bands to allocate
-                                                for the band field in the
-                                                internal_meta */
+    int first                             /* I: index of the first band to be
+                                                initialized */
 )
 {
-    char FUNC_NAME[] = "allocate_band_metadata";   /* function name */
-    char errmsg[STR_SIZE];          /* error message */
-    Espa_band_meta_t *bmeta = NULL; /* pointer to array of bands metadata */
+    Espa_band_meta_t *bmeta = internal_meta->band; /* array of bands
+                                                      metadata */
     int i;                          /* looping variable */
 
-    /* Allocate the number of bands to nbands and the associated pointers */
-    internal_meta->nbands = nbands;
-    internal_meta->band = calloc (nbands, sizeof (Espa_band_meta_t));
-    if (internal_meta->band == NULL)
-    {
-        sprintf (errmsg, "Allocating ESPA band metadata for %d bands", nbands);
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
-    }
-    bmeta = internal_meta->band;
-
-    /* Set the nbits, nclass, ncover fields in the band metadata to 0 for each
-       band and initialize the pointers to NULL.  Initialize the other fields to
-       fill to make it easy to distinguish if they were populated by reading
-       an input metadata file or assigned directly. */
-    for (i = 0; i < nbands; i++)
+    for (i = first; i < internal_meta->nbands; i++)
     {
         bmeta[i].nbits = 0;
         bmeta[i].bitmap_description = NULL;
@@ -236,6 +624,7 @@ int allocate_band_metadata
         bmeta[i].class_values = NULL;
         bmeta[i].ncover = 0;
         bmeta[i].percent_cover = NULL;
+        bmeta[i].arena = internal_meta->arena;
 
         strcpy (bmeta[i].product, ESPA_STRING_META_FILL);
         strcpy (bmeta[i].source, ESPA_STRING_META_FILL);
@@ -248,6 +637,14 @@ int allocate_band_metadata
         bmeta[i].saturate_value = ESPA_INT_META_FILL;
         bmeta[i].scale_factor = ESPA_FLOAT_META_FILL;
         bmeta[i].add_offset = ESPA_FLOAT_META_FILL;
+        bmeta[i].constant_value = ESPA_FLOAT_META_FILL;
+        strcpy (bmeta[i].footprint_file, ESPA_STRING_META_FILL);
+        strcpy (bmeta[i].overview_file, ESPA_STRING_META_FILL);
+        bmeta[i].overview_levels = 0;
+        strcpy (bmeta[i].encoding, ESPA_STRING_META_FILL);
+        bmeta[i].tile_size = 0;
+        bmeta[i].file_offset = 0;
+        strcpy (bmeta[i].checksum, ESPA_STRING_META_FILL);
         bmeta[i].resample_method = ESPA_NONE;
         strcpy (bmeta[i].short_name, ESPA_STRING_META_FILL);
         strcpy (bmeta[i].long_name, ESPA_STRING_META_FILL);
@@ -257,6 +654,7 @@ int allocate_band_metadata
         strcpy (bmeta[i].data_units, ESPA_STRING_META_FILL);
         bmeta[i].valid_range[0] = bmeta[i].valid_range[1] =
             ESPA_FLOAT_META_FILL;
+        clear_band_stats (&bmeta[i].stats);
         bmeta[i].rad_gain = ESPA_FLOAT_META_FILL;
         bmeta[i].rad_bias = ESPA_FLOAT_META_FILL;
         bmeta[i].refl_gain = ESPA_FLOAT_META_FILL;
@@ -268,7 +666,124 @@ int allocate_band_metadata
         strcpy (bmeta[i].l1_filename, ESPA_STRING_META_FILL);
         strcpy (bmeta[i].production_date, ESPA_STRING_META_FILL);
     }
+}
+
+
+/******************************************************************************
+MODULE:  allocate_band_metadata
+
+PURPOSE:  Allocates memory in the ESPA internal metadata structure for nbands.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error allocating memory for the nbands
+SUCCESS         Successfully allocated memory
+
+NOTES:
+  1. Initializes the bitmap_description and class_values for each band to NULL
+     and sets the nbits, nclass, ncover to 0.
+  2. Creates the arena of internal_meta.  The bitmap, class, and cover arrays
+     later allocated for these bands are bump-allocated from it.
+******************************************************************************/
+int allocate_band_metadata
+(
+    Espa_internal_meta_t *internal_meta,  /* I: pointer to internal metadata
+                                                structure */
+    int nbands                            /* I: number of bands to allocate
+                                                for the band field in the
+                                                internal_meta */
+)
+{
+    char FUNC_NAME[] = "allocate_band_metadata";   /* function name */
+    char errmsg[STR_SIZE];          /* error message */
+
+    /* Allocate the number of bands to nbands and the associated pointers,
+       along with the arena for the arrays of the bands */
+    free_espa_band_index (internal_meta);
+    internal_meta->nbands = nbands;
+    internal_meta->band = calloc (nbands, sizeof (Espa_band_meta_t));
+    internal_meta->arena = calloc (1, sizeof (Espa_meta_arena_t));
+    if (internal_meta->band == NULL || internal_meta->arena == NULL)
+    {
+        sprintf (errmsg, "Allocating ESPA band metadata for %d bands", nbands);
+        error_handler (true, FUNC_NAME, errmsg);
+        free (internal_meta->band);
+        free (internal_meta->arena);
+        internal_meta->band = NULL;
+        internal_meta->arena = NULL;
+        internal_meta->nbands = 0;
+        return (ERROR);
+    }
 
+    /* Initialize the bands */
+    init_band_metadata (internal_meta, 0);
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  append_band_metadata
+
+PURPOSE:  Grows the band metadata of the ESPA internal metadata structure by
+nbands, for bands to be added to the metadata in memory.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error allocating memory for the nbands
+SUCCESS         Successfully allocated memory
+
+NOTES:
+  1. The new bands are initialized as in allocate_band_metadata and placed
+     after the existing bands.  The band array may be moved, so any pointers
+     to the existing bands need to be reset after this call.
+  2. The new bands share the arena of internal_meta, which is created if the
+     existing bands don't have one.
+******************************************************************************/
+int append_band_metadata
+(
+    Espa_internal_meta_t *internal_meta,  /* I/O: pointer to internal metadata
+                                                structure */
+    int nbands                            /* I: number of bands to add to the
+                                                band field in the
+                                                internal_meta */
+)
+{
+    char FUNC_NAME[] = "append_band_metadata";   /* function name */
+    char errmsg[STR_SIZE];          /* error message */
+    Espa_band_meta_t *bmeta = NULL; /* pointer to array of bands metadata */
+    int first = internal_meta->nbands;  /* index of the first new band */
+
+    /* Make sure there is an arena for the arrays of the new bands */
+    if (internal_meta->arena == NULL)
+    {
+        internal_meta->arena = calloc (1, sizeof (Espa_meta_arena_t));
+        if (internal_meta->arena == NULL)
+        {
+            sprintf (errmsg, "Allocating the ESPA metadata arena");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+    }
+
+    /* Grow the band array */
+    bmeta = realloc (internal_meta->band, (first + nbands) *
+        sizeof (Espa_band_meta_t));
+    if (bmeta == NULL)
+    {
+        sprintf (errmsg, "Appending ESPA band metadata for %d bands", nbands);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    internal_meta->band = bmeta;
+    internal_meta->nbands = first + nbands;
+    free_espa_band_index (internal_meta);
+
+    /* Initialize the new bands */
+    init_band_metadata (internal_meta, first);
     return (SUCCESS);
 }
 
@@ -300,7 +815,8 @@ int allocate_class_metadata
     /* Allocate the number of classes to nclass and the associated class_values
        pointer */
     band_meta->nclass = nclass;
-    band_meta->class_values = calloc (nclass, sizeof (Espa_class_t));
+    band_meta->class_values = espa_arena_calloc (band_meta->arena, nclass,
+        sizeof (Espa_class_t));
     if (band_meta->class_values == NULL)
     {
         sprintf (errmsg, "Allocating ESPA band metadata for %d nclasses",
@@ -340,7 +856,8 @@ int allocate_percent_coverage_metadata
     /* Allocate the number of cover types to ncover and the associated cover
        type descripts to the pointer */
     band_meta->ncover = ncover;
-    band_meta->percent_cover = calloc (ncover, sizeof (Espa_percent_cover_t));
+    band_meta->percent_cover = espa_arena_calloc (band_meta->arena, ncover,
+        sizeof (Espa_percent_cover_t));
     if (band_meta->percent_cover == NULL)
     {
         sprintf (errmsg, "Allocating ESPA band metadata for %d cover types",
@@ -380,7 +897,8 @@ int allocate_bitmap_metadata
 
     /* Allocate the number of bits to nbits and the associated bitmap pointer */
     band_meta->nbits = nbits;
-    band_meta->bitmap_description = calloc (nbits, sizeof (char *));
+    band_meta->bitmap_description = espa_arena_calloc (band_meta->arena,
+        nbits, sizeof (char *));
     if (band_meta->bitmap_description == NULL)
     {
         sprintf (errmsg, "Allocating ESPA bitmap description");
@@ -390,7 +908,8 @@ int allocate_bitmap_metadata
 
     for (i = 0; i < nbits; i++)
     {
-        band_meta->bitmap_description[i] = calloc (STR_SIZE, sizeof (char));
+        band_meta->bitmap_description[i] = espa_arena_calloc
+            (band_meta->arena, STR_SIZE, sizeof (char));
         if (band_meta->bitmap_description[i] == NULL)
         {
             sprintf (errmsg, "Allocating ESPA band metadata for %d nbits",
@@ -404,6 +923,96 @@ int allocate_bitmap_metadata
 }
 
 
+/******************************************************************************
+MODULE:  clear_band_stats
+
+PURPOSE:  Marks the statistics of a band as not known, ex. for a band whose
+pixels have been changed since they were computed.
+
+RETURN VALUE: N/A
+
+NOTES:
+******************************************************************************/
+void clear_band_stats
+(
+    Espa_band_stats_t *stats      /* O: statistics to be marked not known */
+)
+{
+    memset (stats, 0, sizeof (Espa_band_stats_t));
+    stats->valid_count = ESPA_INT_META_FILL;
+}
+
+
+/******************************************************************************
+MODULE:  is_constant_band
+
+PURPOSE:  Determines if a band is a constant band, which holds the same value
+in every pixel and is described by its metadata alone.
+
+RETURN VALUE:
+Type = bool
+Value           Description
+-----           -----------
+true            The band is a constant band
+false           The band is stored in its raw binary file
+
+NOTES:
+  1. A constant band has no raw binary file.  Its pixels are synthesized from
+     constant_value by the readers, and only the exporters which need the
+     pixels in their output expand them.
+******************************************************************************/
+bool is_constant_band
+(
+    const Espa_band_meta_t *bmeta /* I: pointer to band metadata structure */
+)
+{
+    return (fabs (bmeta->constant_value - ESPA_FLOAT_META_FILL) >
+        ESPA_EPSILON);
+}
+
+
+/******************************************************************************
+MODULE:  is_shared_band_file
+
+PURPOSE:  Determines if the raw binary file of a band also holds other bands,
+i.e. it is a stack of bands (see espa_file_stack.h).
+
+RETURN VALUE:
+Type = bool
+Value           Description
+-----           -----------
+true            Another band is stored in the same file
+false           The file holds just this band
+
+NOTES:
+  1. Tools which remove the source files band by band check the following
+     bands only (later_only), so a stack is removed along with the last of
+     its bands.
+******************************************************************************/
+bool is_shared_band_file
+(
+    const Espa_internal_meta_t *metadata, /* I: metadata with the bands */
+    int band,              /* I: index of the band in the metadata */
+    bool later_only        /* I: only check the bands after this one? */
+)
+{
+    int i;                 /* looping variable for the bands */
+
+    if (is_constant_band (&metadata->band[band]))
+        return false;
+
+    for (i = later_only ? band + 1 : 0; i < metadata->nbands; i++)
+    {
+        if (i != band && !is_constant_band (&metadata->band[i]) &&
+            !strcmp (metadata->band[i].file_name,
+            metadata->band[band].file_name))
+            return true;
+    }
+
+    return false;
+}
+
+
 /******************************************************************************
 MODULE:  free_metadata
 
@@ -412,6 +1021,8 @@ PURPOSE:  Frees memory in the ESPA internal metadata structure.
 RETURN VALUE: N/A
 
 NOTES:
+  1. Arrays allocated from the arena are released with the arena in a single
+     call; only bands without an arena have their arrays freed one by one.
 ******************************************************************************/
 void free_metadata
 (
@@ -421,9 +1032,13 @@ void free_metadata
 {
     int i, b;                      /* looping variables */
 
-    /* Free the pointers in the band metadata */
+    /* Free the pointers in the band metadata which weren't allocated from
+       the arena */
     for (i = 0; i < internal_meta->nbands; i++)
     {
+        if (internal_meta->band[i].arena != NULL)
+            continue;
+
         if (internal_meta->band[i].nbits > 0)
         {
             for (b = 0; b < internal_meta->band[i].nbits; b++)
@@ -438,6 +1053,15 @@ void free_metadata
     /* Free the band pointer itself */
     if (internal_meta->band)
         free (internal_meta->band);
+    free_espa_band_index (internal_meta);
+
+    /* Release everything allocated from the arena in one call */
+    if (internal_meta->arena)
+    {
+        free_espa_arena (internal_meta->arena);
+        free (internal_meta->arena);
+        internal_meta->arena = NULL;
+    }
 }
 
 
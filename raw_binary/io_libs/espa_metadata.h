@@ -54,8 +54,9 @@ enum Espa_geographic_type
     ESPA_WEST, ESPA_EAST, ESPA_NORTH, ESPA_SOUTH
 };
 
-/* Local define to specify the maximum total bands and product types.  This
-   should be sufficient for ESPA products. */
+/* Local define to specify the maximum total bands and product types.  These
+   are no longer limits of the library; band and product lists which can grow
+   are held in an Espa_name_list_t. */
 #define MAX_TOTAL_BANDS 100
 #define MAX_TOTAL_PRODUCT_TYPES 50
 
@@ -65,6 +66,35 @@ enum Espa_geographic_type
 #define ESPA_STRING_META_FILL "undefined"
 #define ESPA_EPSILON 0.00001
 
+/* Size of each block of the metadata arena */
+#define ESPA_ARENA_BLOCK_SIZE 65536
+
+/* Arena from which the bitmap descriptions, classes, and cover types of the
+   bands are bump-allocated, so they can be released all at once */
+typedef struct Espa_meta_arena_block
+{
+    struct Espa_meta_arena_block *next; /* next (older) block in the arena */
+    size_t size;                  /* number of bytes in data */
+    size_t used;                  /* number of bytes of data handed out */
+    char data[];                  /* memory handed out by the arena */
+} Espa_meta_arena_block_t;
+
+typedef struct
+{
+    Espa_meta_arena_block_t *block; /* current block; older blocks are
+                                       chained from it */
+} Espa_meta_arena_t;
+
+/* Growable list of band names or product types, allocated from an arena */
+#define ESPA_NAME_LIST_INIT 16
+typedef struct
+{
+    int nnames;                   /* number of names in the list */
+    int nalloc;                   /* number of names allocated */
+    char (*names)[STR_SIZE];      /* array of nnames names */
+    Espa_meta_arena_t arena;      /* arena holding the names */
+} Espa_name_list_t;
+
 /* Structures to support the global and band metadata information stored in
    the ESPA internal metadata file */
 typedef struct
@@ -84,6 +114,26 @@ typedef struct
                                      cloud, etc.)*/
 } Espa_percent_cover_t;
 
+/* Most bins in the histogram of the statistics of a band */
+#define ESPA_STATS_NBINS 256
+
+typedef struct
+{
+    long valid_count;             /* number of valid pixels (not fill or
+                                     saturated); ESPA_INT_META_FILL if the
+                                     statistics are not known */
+    double min;                   /* smallest valid pixel */
+    double max;                   /* largest valid pixel */
+    double mean;                  /* mean of the valid pixels */
+    double stddev;                /* standard deviation of the valid pixels */
+    int nbins;                    /* number of bins in histogram; 0 if there
+                                     is no histogram */
+    double hist_min;              /* lower bound of the first bin */
+    double hist_max;              /* upper bound of the last bin; the bins
+                                     are of equal width */
+    long histogram[ESPA_STATS_NBINS];  /* number of valid pixels in each bin */
+} Espa_band_stats_t;
+
 typedef struct
 {
     int proj_type;        /* projection number (see GCTP_* in gctp_defines.h) */
@@ -131,6 +181,10 @@ typedef struct
     double ul_corner[2];          /* geographic UL lat, long */
     double lr_corner[2];          /* geographic LR lat, long */
     double bounding_coords[4];    /* geographic west, east, north, south */
+    char footprint[HUGE_STR_SIZE]; /* outline of the valid (non-fill)
+                                     pixels as a WKT POLYGON of geographic
+                                     longitude, latitude (see
+                                     generate_footprint_polygon.h) */
     Espa_proj_meta_t proj_info;   /* projection information structure */
 
     /* Landsat products */
@@ -170,6 +224,32 @@ typedef struct
     int saturate_value;          /* saturation value (for Landsat) */
     float scale_factor;          /* scaling factor */
     float add_offset;            /* offset to be added */
+    double constant_value;       /* value of every pixel of a constant band,
+                                    which has no raw binary file (see
+                                    is_constant_band);
+                                    ESPA_FLOAT_META_FILL otherwise */
+    char footprint_file[STR_SIZE]; /* sidecar file with the first and last
+                                    valid sample of each line (see
+                                    espa_footprint.h); ESPA_STRING_META_FILL
+                                    if there is none */
+    char overview_file[STR_SIZE]; /* sidecar file with the reduced
+                                    resolution overviews of the band (see
+                                    espa_overview.h); ESPA_STRING_META_FILL
+                                    if there is none */
+    int overview_levels;         /* number of levels in overview_file */
+    char encoding[STR_SIZE];     /* encoding of the raw binary file (see
+                                    raw_binary_blocks.h); ESPA_STRING_META_FILL
+                                    for plain raw binary */
+    int tile_size;               /* number of lines and samples in each tile
+                                    of a tiled raw binary file; 0 if the file
+                                    isn't tiled */
+    long file_offset;            /* byte offset of the band in file_name,
+                                    which holds several bands stacked one
+                                    after the other (see espa_file_stack.h);
+                                    0 for a file holding just this band */
+    char checksum[STR_SIZE];     /* checksum of the pixels of the band (see
+                                    raw_binary_checksum.h);
+                                    ESPA_STRING_META_FILL if not known */
     enum Espa_resampling_type resample_method;
                                  /* resampling method for this band */
     char short_name[STR_SIZE];   /* short band name */
@@ -180,6 +260,8 @@ typedef struct
     char pixel_units[STR_SIZE];  /* units for pixel size (meters, degrees) */
     char data_units[STR_SIZE];   /* units of data stored in this band */
     double valid_range[2];       /* min, max valid value for this band */
+    Espa_band_stats_t stats;     /* statistics of the valid pixels (see
+                                    raw_binary_stats.h) */
     double rad_gain;             /* gain values for TOA radiance conversion */
     double rad_bias;             /* bias values for TOA radiance conversion */
     double refl_gain;            /* gain values for TOA reflectance conversion*/
@@ -205,22 +287,76 @@ typedef struct
                                     where the filenames have been renamed
                                     (i.e. Sentinel-2) */
     char production_date[STR_SIZE];  /* date the band was produced */
+    Espa_meta_arena_t *arena;    /* arena holding the bitmap, class, and
+                                    cover arrays of this band; NULL if they
+                                    are individually allocated */
 } Espa_band_meta_t;
 
+struct espa_band_index;         /* band index (see espa_band_index.h) */
+
 typedef struct
 {
     char meta_namespace[STR_SIZE];  /* namespace for this metadata file */
     Espa_global_meta_t global;  /* global metadata */
     int nbands;                 /* number of bands in the metadata file */
     Espa_band_meta_t *band;     /* array of band metadata */
+    Espa_meta_arena_t *arena;   /* arena for the arrays of the bands; NULL if
+                                   the bands haven't been allocated */
+    struct espa_band_index *band_index; /* index of the bands by name,
+                                   product, source, and category; NULL until
+                                   built */
 } Espa_internal_meta_t;
 
 /* Prototypes */
+xmlSchemaPtr get_espa_schema (void);
+
+void init_espa_xml (void);
+
+void shutdown_espa_xml (void);
+
+void cleanup_espa_xml (void);
+
+int validate_xml_doc
+(
+    xmlDocPtr doc,            /* I: document tree to be validated */
+    char *meta_file           /* I: name of metadata file the document was
+                                    read from, for error messages */
+);
+
 int validate_xml_file
 (
     char *meta_file           /* I: name of metadata file to be validated */
 );
 
+void *espa_arena_calloc
+(
+    Espa_meta_arena_t *arena, /* I: arena to allocate from; NULL to allocate
+                                    from the heap */
+    size_t nmemb,             /* I: number of elements to allocate */
+    size_t size               /* I: size of each element */
+);
+
+void free_espa_arena
+(
+    Espa_meta_arena_t *arena  /* I: arena whose blocks are to be freed */
+);
+
+void init_name_list
+(
+    Espa_name_list_t *list    /* I: name list to be initialized */
+);
+
+int add_name_to_list
+(
+    Espa_name_list_t *list,   /* I/O: name list to be added to */
+    const char *name          /* I: name to be added */
+);
+
+void free_name_list
+(
+    Espa_name_list_t *list    /* I: name list to be freed */
+);
+
 void init_metadata_struct
 (
     Espa_internal_meta_t *internal_meta   /* I: pointer to internal metadata
@@ -236,6 +372,15 @@ int allocate_band_metadata
                                                 internal_meta */
 );
 
+int append_band_metadata
+(
+    Espa_internal_meta_t *internal_meta,  /* I/O: pointer to internal metadata
+                                                structure */
+    int nbands                            /* I: number of bands to add to the
+                                                band field in the
+                                                internal_meta */
+);
+
 int allocate_class_metadata
 (
     Espa_band_meta_t *band_meta,  /* I: pointer to band metadata structure */
@@ -256,6 +401,23 @@ int allocate_bitmap_metadata
                                         bitmap metadata */
 );
 
+void clear_band_stats
+(
+    Espa_band_stats_t *stats      /* O: statistics to be marked not known */
+);
+
+bool is_constant_band
+(
+    const Espa_band_meta_t *bmeta /* I: pointer to band metadata structure */
+);
+
+bool is_shared_band_file
+(
+    const Espa_internal_meta_t *metadata, /* I: metadata with the bands */
+    int band,              /* I: index of the band in the metadata */
+    bool later_only        /* I: only check the bands after this one? */
+);
+
 void free_metadata
 (
     Espa_internal_meta_t *internal_meta   /* I: pointer to internal metadata
@@ -0,0 +1,68 @@
+/*****************************************************************************
+FILE: espa_mpi_metadata.c
+
+PURPOSE: Contains functions for the collective handling of the ESPA internal
+metadata by the ranks of an MPI job.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+*****************************************************************************/
+
+#include "parse_metadata.h"
+#include "espa_mpi_metadata.h"
+
+/******************************************************************************
+MODULE:  validate_and_parse_metadata_collective
+
+PURPOSE: Parses the input metadata file on every rank, validating it on
+ESPA_MPI_ROOT, and agrees on the result.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error validating or parsing the metadata on any rank
+SUCCESS         Every rank parsed the metadata
+
+NOTES:
+  1. A collective call.  With a single rank it is the same as
+     validate_and_parse_metadata.
+  2. When another rank failed, the metadata parsed by this rank is freed,
+     so the caller frees nothing on an error, as for a failed parse.
+******************************************************************************/
+int validate_and_parse_metadata_collective
+(
+    char *metafile,                 /* I: input metadata file or URL */
+    Espa_internal_meta_t *metadata  /* I: input metadata structure which has
+                                          been initialized via
+                                          init_metadata_struct */
+)
+{
+    char FUNC_NAME[] = "validate_and_parse_metadata_collective";
+                                    /* function name */
+    char errmsg[STR_SIZE];          /* error message */
+    int status;                     /* status of this rank */
+
+    if (espa_mpi_rank () == ESPA_MPI_ROOT)
+        status = validate_and_parse_metadata (metafile, metadata);
+    else
+        status = parse_metadata (metafile, metadata);
+
+    if (espa_mpi_agree (status) != SUCCESS)
+    {
+        if (status == SUCCESS)
+        {
+            sprintf (errmsg, "Parsing the metadata file %s failed on "
+                "another rank", metafile);
+            error_handler (true, FUNC_NAME, errmsg);
+            free_metadata (metadata);
+        }
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
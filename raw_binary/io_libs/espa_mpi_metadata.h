@@ -0,0 +1,36 @@
+/*****************************************************************************
+FILE: espa_mpi_metadata.h
+
+PURPOSE: Contains prototypes for the collective handling of the ESPA
+internal metadata by the ranks of an MPI job (see espa_mpi.h).
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. Every rank holds the full metadata of the product, so each can work out
+     the output grid and its own part of it.  Only ESPA_MPI_ROOT validates
+     the XML against the schema; the others parse it without validating.
+*****************************************************************************/
+
+#ifndef ESPA_MPI_METADATA_H
+#define ESPA_MPI_METADATA_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include "error_handler.h"
+#include "espa_metadata.h"
+#include "espa_mpi.h"
+
+/* Prototypes */
+int validate_and_parse_metadata_collective
+(
+    char *metafile,                 /* I: input metadata file or URL */
+    Espa_internal_meta_t *metadata  /* I: input metadata structure which has
+                                          been initialized via
+                                          init_metadata_struct */
+);
+
+#endif
@@ -0,0 +1,1134 @@
+/*****************************************************************************
+FILE: espa_overview.c
+
+PURPOSE: Contains functions for building and locating the overviews of the
+bands (see espa_overview.h).
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The 2x2 averages of the 8 and 16-bit bands without a fill value are
+     computed by SIMD kernels, chosen once, when the program is loaded, from
+     the instruction sets of the CPU (see espa_cpu_dispatch.h).  Each kernel
+     computes as many whole vectors of a line as fit and returns the number
+     of pixels computed, leaving the remainder to the scalar loop.  The
+     kernels round the same way as the scalar loop, so the overviews don't
+     depend on the CPU.
+*****************************************************************************/
+
+#include <stdint.h>
+#include <math.h>
+#include <unistd.h>
+#include "espa_overview.h"
+#include "espa_band_stack.h"
+#include "raw_binary_io.h"
+#include "espa_cpu_dispatch.h"
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#define OVR_MEAN_X86
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define OVR_MEAN_NEON
+#endif
+
+/* Number of bytes of each level buffered before it is written */
+#define OVR_BLOCK_BYTES (1024 * 1024)
+
+/* Kernel averaging the 2x2 pixels of two lines; returns the number of
+   output pixels computed */
+typedef int (*Ovr_mean_kernel_t)
+(
+    const void *line_a,  /* I: first line of the pair */
+    const void *line_b,  /* I: second line of the pair */
+    void *out,           /* O: averaged line */
+    int nout,            /* I: number of output pixels; the lines have at
+                               least 2 * nout pixels */
+    enum Espa_data_type data_type  /* I: data type of the pixels (only
+                                         ESPA_UINT8, ESPA_INT16, and
+                                         ESPA_UINT16 are computed) */
+);
+
+/* Level of the overviews being built */
+typedef struct
+{
+    int nlines;          /* number of lines in the level */
+    int nsamps;          /* number of samples in the level */
+    off_t offset;        /* byte offset of the level in the overview file */
+    void *pending;       /* line of the previous level waiting for the line
+                            it is paired with */
+    bool have_pending;   /* is there a line in pending? */
+    char *out;           /* lines of the level not yet written */
+    int out_lines;       /* number of lines out holds */
+    int nout;            /* number of lines in out */
+    int next_line;       /* level line of the first line in out */
+} Ovr_level_t;
+
+/* Overviews of a band being built */
+typedef struct
+{
+    enum Espa_data_type data_type;  /* data type of the band */
+    int size;            /* number of bytes per pixel */
+    bool nearest;        /* keep the upper left pixel instead of the mean? */
+    bool use_fill;       /* leave the fill pixels out of the mean? */
+    long fill_value;     /* fill value of the band */
+    int nsamps;          /* number of samples in the band */
+    int fd;              /* file descriptor of the overview file */
+    int nlevels;         /* number of levels */
+    Ovr_level_t level[ESPA_OVERVIEW_MAX_LEVELS];  /* levels; level[0] is
+                                                     the 2x level */
+} Ovr_build_t;
+
+
+#ifdef OVR_MEAN_X86
+/******************************************************************************
+MODULE: ovr_mean_sse2
+
+PURPOSE: Averages the 2x2 pixels of two lines in 16-byte vectors using SSE2,
+which is available on every x86-64 CPU.  The even and odd pixels are split
+into wider lanes with masks and shifts, summed, rounded, and packed back.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+n            Number of output pixels computed
+
+NOTES:
+*****************************************************************************/
+static int ovr_mean_sse2
+(
+    const void *line_a,  /* I: first line of the pair */
+    const void *line_b,  /* I: second line of the pair */
+    void *out,           /* O: averaged line */
+    int nout,            /* I: number of output pixels */
+    enum Espa_data_type data_type  /* I: data type of the pixels */
+)
+{
+    int j = 0;           /* current output pixel */
+    const __m128i *a = line_a;  /* vectors of the first line */
+    const __m128i *b = line_b;  /* vectors of the second line */
+    __m128i *o = out;    /* vectors of the averaged line */
+    __m128i lo;          /* sums of the first half of the output vector */
+    __m128i hi;          /* sums of the second half of the output vector */
+    __m128i mask;        /* even pixels of each wider lane */
+    __m128i two;         /* rounding term of the sums */
+    __m128i bias;        /* shifts the uint16 sums into the int16 range */
+
+    switch (data_type)
+    {
+        case ESPA_UINT8:
+            mask = _mm_set1_epi16 (0x00ff);
+            two = _mm_set1_epi16 (2);
+            for (j = 0; j + 16 <= nout; j += 16, a += 2, b += 2, o++)
+            {
+                lo = _mm_add_epi16 (
+                    _mm_add_epi16 (_mm_and_si128 (_mm_loadu_si128 (a), mask),
+                    _mm_srli_epi16 (_mm_loadu_si128 (a), 8)),
+                    _mm_add_epi16 (_mm_and_si128 (_mm_loadu_si128 (b), mask),
+                    _mm_srli_epi16 (_mm_loadu_si128 (b), 8)));
+                hi = _mm_add_epi16 (
+                    _mm_add_epi16 (
+                    _mm_and_si128 (_mm_loadu_si128 (a + 1), mask),
+                    _mm_srli_epi16 (_mm_loadu_si128 (a + 1), 8)),
+                    _mm_add_epi16 (
+                    _mm_and_si128 (_mm_loadu_si128 (b + 1), mask),
+                    _mm_srli_epi16 (_mm_loadu_si128 (b + 1), 8)));
+                lo = _mm_srli_epi16 (_mm_add_epi16 (lo, two), 2);
+                hi = _mm_srli_epi16 (_mm_add_epi16 (hi, two), 2);
+                _mm_storeu_si128 (o, _mm_packus_epi16 (lo, hi));
+            }
+            break;
+
+        case ESPA_INT16:
+            two = _mm_set1_epi32 (2);
+            for (j = 0; j + 8 <= nout; j += 8, a += 2, b += 2, o++)
+            {
+                lo = _mm_add_epi32 (
+                    _mm_add_epi32 (_mm_srai_epi32 (_mm_slli_epi32 (
+                    _mm_loadu_si128 (a), 16), 16),
+                    _mm_srai_epi32 (_mm_loadu_si128 (a), 16)),
+                    _mm_add_epi32 (_mm_srai_epi32 (_mm_slli_epi32 (
+                    _mm_loadu_si128 (b), 16), 16),
+                    _mm_srai_epi32 (_mm_loadu_si128 (b), 16)));
+                hi = _mm_add_epi32 (
+                    _mm_add_epi32 (_mm_srai_epi32 (_mm_slli_epi32 (
+                    _mm_loadu_si128 (a + 1), 16), 16),
+                    _mm_srai_epi32 (_mm_loadu_si128 (a + 1), 16)),
+                    _mm_add_epi32 (_mm_srai_epi32 (_mm_slli_epi32 (
+                    _mm_loadu_si128 (b + 1), 16), 16),
+                    _mm_srai_epi32 (_mm_loadu_si128 (b + 1), 16)));
+                lo = _mm_srai_epi32 (_mm_add_epi32 (lo, two), 2);
+                hi = _mm_srai_epi32 (_mm_add_epi32 (hi, two), 2);
+                _mm_storeu_si128 (o, _mm_packs_epi32 (lo, hi));
+            }
+            break;
+
+        case ESPA_UINT16:
+            mask = _mm_set1_epi32 (0xffff);
+            two = _mm_set1_epi32 (2);
+            bias = _mm_set1_epi32 (32768);
+            for (j = 0; j + 8 <= nout; j += 8, a += 2, b += 2, o++)
+            {
+                lo = _mm_add_epi32 (
+                    _mm_add_epi32 (_mm_and_si128 (_mm_loadu_si128 (a), mask),
+                    _mm_srli_epi32 (_mm_loadu_si128 (a), 16)),
+                    _mm_add_epi32 (_mm_and_si128 (_mm_loadu_si128 (b), mask),
+                    _mm_srli_epi32 (_mm_loadu_si128 (b), 16)));
+                hi = _mm_add_epi32 (
+                    _mm_add_epi32 (
+                    _mm_and_si128 (_mm_loadu_si128 (a + 1), mask),
+                    _mm_srli_epi32 (_mm_loadu_si128 (a + 1), 16)),
+                    _mm_add_epi32 (
+                    _mm_and_si128 (_mm_loadu_si128 (b + 1), mask),
+                    _mm_srli_epi32 (_mm_loadu_si128 (b + 1), 16)));
+                lo = _mm_sub_epi32 (
+                    _mm_srli_epi32 (_mm_add_epi32 (lo, two), 2), bias);
+                hi = _mm_sub_epi32 (
+                    _mm_srli_epi32 (_mm_add_epi32 (hi, two), 2), bias);
+                _mm_storeu_si128 (o, _mm_xor_si128 (_mm_packs_epi32 (lo, hi),
+                    _mm_set1_epi16 ((short) 0x8000)));
+            }
+            break;
+
+        default:
+            break;
+    }
+
+    return j;
+}
+
+
+/******************************************************************************
+MODULE: ovr_mean_avx2
+
+PURPOSE: Averages the 2x2 pixels of two lines in 32-byte vectors using AVX2,
+then a last 16-byte vector with SSE2.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+n            Number of output pixels computed
+
+NOTES:
+  1. Only put in the kernel table when the CPU supports AVX2.
+  2. The packs work within each 128-bit lane, so the 64-bit quarters of the
+     packed vector are put back in order with a permute.
+*****************************************************************************/
+__attribute__ ((target ("avx2")))
+static int ovr_mean_avx2
+(
+    const void *line_a,  /* I: first line of the pair */
+    const void *line_b,  /* I: second line of the pair */
+    void *out,           /* O: averaged line */
+    int nout,            /* I: number of output pixels */
+    enum Espa_data_type data_type  /* I: data type of the pixels */
+)
+{
+    int j = 0;           /* current output pixel */
+    int size;            /* number of bytes per pixel */
+    const __m256i *a = line_a;  /* vectors of the first line */
+    const __m256i *b = line_b;  /* vectors of the second line */
+    __m256i *o = out;    /* vectors of the averaged line */
+    __m256i va;          /* current vector of the first line */
+    __m256i vb;          /* current vector of the second line */
+    __m256i lo;          /* sums of the first half of the output vector */
+    __m256i hi;          /* sums of the second half of the output vector */
+    __m256i mask;        /* even pixels of each wider lane */
+    __m256i two;         /* rounding term of the sums */
+    __m256i bias;        /* shifts the uint16 sums into the int16 range */
+
+    switch (data_type)
+    {
+        case ESPA_UINT8:
+            size = 1;
+            mask = _mm256_set1_epi16 (0x00ff);
+            two = _mm256_set1_epi16 (2);
+            for (j = 0; j + 32 <= nout; j += 32, a += 2, b += 2, o++)
+            {
+                va = _mm256_loadu_si256 (a);
+                vb = _mm256_loadu_si256 (b);
+                lo = _mm256_add_epi16 (
+                    _mm256_add_epi16 (_mm256_and_si256 (va, mask),
+                    _mm256_srli_epi16 (va, 8)),
+                    _mm256_add_epi16 (_mm256_and_si256 (vb, mask),
+                    _mm256_srli_epi16 (vb, 8)));
+                va = _mm256_loadu_si256 (a + 1);
+                vb = _mm256_loadu_si256 (b + 1);
+                hi = _mm256_add_epi16 (
+                    _mm256_add_epi16 (_mm256_and_si256 (va, mask),
+                    _mm256_srli_epi16 (va, 8)),
+                    _mm256_add_epi16 (_mm256_and_si256 (vb, mask),
+                    _mm256_srli_epi16 (vb, 8)));
+                lo = _mm256_srli_epi16 (_mm256_add_epi16 (lo, two), 2);
+                hi = _mm256_srli_epi16 (_mm256_add_epi16 (hi, two), 2);
+                _mm256_storeu_si256 (o, _mm256_permute4x64_epi64 (
+                    _mm256_packus_epi16 (lo, hi), 0xd8));
+            }
+            break;
+
+        case ESPA_INT16:
+            size = 2;
+            two = _mm256_set1_epi32 (2);
+            for (j = 0; j + 16 <= nout; j += 16, a += 2, b += 2, o++)
+            {
+                va = _mm256_loadu_si256 (a);
+                vb = _mm256_loadu_si256 (b);
+                lo = _mm256_add_epi32 (
+                    _mm256_add_epi32 (_mm256_srai_epi32 (
+                    _mm256_slli_epi32 (va, 16), 16),
+                    _mm256_srai_epi32 (va, 16)),
+                    _mm256_add_epi32 (_mm256_srai_epi32 (
+                    _mm256_slli_epi32 (vb, 16), 16),
+                    _mm256_srai_epi32 (vb, 16)));
+                va = _mm256_loadu_si256 (a + 1);
+                vb = _mm256_loadu_si256 (b + 1);
+                hi = _mm256_add_epi32 (
+                    _mm256_add_epi32 (_mm256_srai_epi32 (
+                    _mm256_slli_epi32 (va, 16), 16),
+                    _mm256_srai_epi32 (va, 16)),
+                    _mm256_add_epi32 (_mm256_srai_epi32 (
+                    _mm256_slli_epi32 (vb, 16), 16),
+                    _mm256_srai_epi32 (vb, 16)));
+                lo = _mm256_srai_epi32 (_mm256_add_epi32 (lo, two), 2);
+                hi = _mm256_srai_epi32 (_mm256_add_epi32 (hi, two), 2);
+                _mm256_storeu_si256 (o, _mm256_permute4x64_epi64 (
+                    _mm256_packs_epi32 (lo, hi), 0xd8));
+            }
+            break;
+
+        case ESPA_UINT16:
+            size = 2;
+            mask = _mm256_set1_epi32 (0xffff);
+            two = _mm256_set1_epi32 (2);
+            bias = _mm256_set1_epi32 (32768);
+            for (j = 0; j + 16 <= nout; j += 16, a += 2, b += 2, o++)
+            {
+                va = _mm256_loadu_si256 (a);
+                vb = _mm256_loadu_si256 (b);
+                lo = _mm256_add_epi32 (
+                    _mm256_add_epi32 (_mm256_and_si256 (va, mask),
+                    _mm256_srli_epi32 (va, 16)),
+                    _mm256_add_epi32 (_mm256_and_si256 (vb, mask),
+                    _mm256_srli_epi32 (vb, 16)));
+                va = _mm256_loadu_si256 (a + 1);
+                vb = _mm256_loadu_si256 (b + 1);
+                hi = _mm256_add_epi32 (
+                    _mm256_add_epi32 (_mm256_and_si256 (va, mask),
+                    _mm256_srli_epi32 (va, 16)),
+                    _mm256_add_epi32 (_mm256_and_si256 (vb, mask),
+                    _mm256_srli_epi32 (vb, 16)));
+                lo = _mm256_sub_epi32 (
+                    _mm256_srli_epi32 (_mm256_add_epi32 (lo, two), 2), bias);
+                hi = _mm256_sub_epi32 (
+                    _mm256_srli_epi32 (_mm256_add_epi32 (hi, two), 2), bias);
+                _mm256_storeu_si256 (o, _mm256_xor_si256 (
+                    _mm256_permute4x64_epi64 (_mm256_packs_epi32 (lo, hi),
+                    0xd8), _mm256_set1_epi16 ((short) 0x8000)));
+            }
+            break;
+
+        default:
+            return 0;
+    }
+
+    return j + ovr_mean_sse2 ((const char *) line_a + 2 * j * size,
+        (const char *) line_b + 2 * j * size, (char *) out + j * size,
+        nout - j, data_type);
+}
+#endif
+
+#ifdef OVR_MEAN_NEON
+/******************************************************************************
+MODULE: ovr_mean_neon
+
+PURPOSE: Averages the 2x2 pixels of two lines in 16-byte vectors using the
+NEON pairwise widening adds and the rounding narrowing shifts.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+n            Number of output pixels computed
+
+NOTES:
+*****************************************************************************/
+static int ovr_mean_neon
+(
+    const void *line_a,  /* I: first line of the pair */
+    const void *line_b,  /* I: second line of the pair */
+    void *out,           /* O: averaged line */
+    int nout,            /* I: number of output pixels */
+    enum Espa_data_type data_type  /* I: data type of the pixels */
+)
+{
+    int j = 0;           /* current output pixel */
+    const uint8_t *a8 = line_a;   /* pixels of the first uint8 line */
+    const uint8_t *b8 = line_b;   /* pixels of the second uint8 line */
+    uint8_t *o8 = out;            /* pixels of the averaged uint8 line */
+    const int16_t *a16 = line_a;  /* pixels of the first int16 line */
+    const int16_t *b16 = line_b;  /* pixels of the second int16 line */
+    int16_t *o16 = out;           /* pixels of the averaged int16 line */
+    const uint16_t *ua16 = line_a; /* pixels of the first uint16 line */
+    const uint16_t *ub16 = line_b; /* pixels of the second uint16 line */
+    uint16_t *uo16 = out;         /* pixels of the averaged uint16 line */
+    uint16x8_t lo8;      /* sums of the first half of a uint8 vector */
+    uint16x8_t hi8;      /* sums of the second half of a uint8 vector */
+    int32x4_t lo16;      /* sums of the first half of an int16 vector */
+    int32x4_t hi16;      /* sums of the second half of an int16 vector */
+    uint32x4_t ulo16;    /* sums of the first half of a uint16 vector */
+    uint32x4_t uhi16;    /* sums of the second half of a uint16 vector */
+
+    switch (data_type)
+    {
+        case ESPA_UINT8:
+            for (j = 0; j + 16 <= nout; j += 16)
+            {
+                lo8 = vaddq_u16 (vpaddlq_u8 (vld1q_u8 (a8 + 2 * j)),
+                    vpaddlq_u8 (vld1q_u8 (b8 + 2 * j)));
+                hi8 = vaddq_u16 (vpaddlq_u8 (vld1q_u8 (a8 + 2 * j + 16)),
+                    vpaddlq_u8 (vld1q_u8 (b8 + 2 * j + 16)));
+                vst1q_u8 (o8 + j, vcombine_u8 (vrshrn_n_u16 (lo8, 2),
+                    vrshrn_n_u16 (hi8, 2)));
+            }
+            break;
+
+        case ESPA_INT16:
+            for (j = 0; j + 8 <= nout; j += 8)
+            {
+                lo16 = vaddq_s32 (vpaddlq_s16 (vld1q_s16 (a16 + 2 * j)),
+                    vpaddlq_s16 (vld1q_s16 (b16 + 2 * j)));
+                hi16 = vaddq_s32 (vpaddlq_s16 (vld1q_s16 (a16 + 2 * j + 8)),
+                    vpaddlq_s16 (vld1q_s16 (b16 + 2 * j + 8)));
+                vst1q_s16 (o16 + j, vcombine_s16 (vrshrn_n_s32 (lo16, 2),
+                    vrshrn_n_s32 (hi16, 2)));
+            }
+            break;
+
+        case ESPA_UINT16:
+            for (j = 0; j + 8 <= nout; j += 8)
+            {
+                ulo16 = vaddq_u32 (vpaddlq_u16 (vld1q_u16 (ua16 + 2 * j)),
+                    vpaddlq_u16 (vld1q_u16 (ub16 + 2 * j)));
+                uhi16 = vaddq_u32 (vpaddlq_u16 (vld1q_u16 (ua16 + 2 * j + 8)),
+                    vpaddlq_u16 (vld1q_u16 (ub16 + 2 * j + 8)));
+                vst1q_u16 (uo16 + j, vcombine_u16 (vrshrn_n_u32 (ulo16, 2),
+                    vrshrn_n_u32 (uhi16, 2)));
+            }
+            break;
+
+        default:
+            break;
+    }
+
+    return j;
+}
+#endif
+
+
+/******************************************************************************
+MODULE: ovr_mean_none
+
+PURPOSE: Kernel of the CPUs without vector instructions, which leaves the
+whole line to the scalar loop.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+0            No pixels computed
+
+NOTES:
+*****************************************************************************/
+static int ovr_mean_none
+(
+    const void *line_a,  /* I: first line of the pair (unused) */
+    const void *line_b,  /* I: second line of the pair (unused) */
+    void *out,           /* O: averaged line (unused) */
+    int nout,            /* I: number of output pixels (unused) */
+    enum Espa_data_type data_type  /* I: data type of the pixels (unused) */
+)
+{
+    return 0;
+}
+
+
+/* Kernel of the 2x2 averages, chosen by init_overview_kernels */
+static Ovr_mean_kernel_t ovr_mean_kernel = ovr_mean_none;
+
+
+/******************************************************************************
+MODULE: init_overview_kernels
+
+PURPOSE: Chooses the widest averaging kernel supported by the CPU.
+
+RETURN VALUE: None
+
+NOTES:
+  1. Run when the program (or shared library) is loaded.
+*****************************************************************************/
+__attribute__ ((constructor))
+static void init_overview_kernels (void)
+{
+#if defined(OVR_MEAN_X86)
+    if (espa_cpu_supports (ESPA_CPU_AVX2))
+        ovr_mean_kernel = ovr_mean_avx2;
+    else if (espa_cpu_supports (ESPA_CPU_SSE2))
+        ovr_mean_kernel = ovr_mean_sse2;
+#elif defined(OVR_MEAN_NEON)
+    if (espa_cpu_supports (ESPA_CPU_NEON))
+        ovr_mean_kernel = ovr_mean_neon;
+#endif
+}
+
+
+/* Keeps the upper left pixel of each 2x2 pixels, for pixels of the given
+   size */
+#define NEAREST_PIXELS(type) \
+    { \
+        const type *a = line_a; \
+        type *o = out; \
+        for (j = 0; j < nout; j++) \
+            o[j] = a[2 * j]; \
+    }
+
+/* Averages the valid pixels of each 2x2 pixels of the given type, starting
+   with output pixel j; the last sample is paired with itself if in_nsamps
+   is odd.  The integer means are rounded half up, the same as the
+   kernels. */
+#define MEAN_PIXELS(type, round) \
+    { \
+        const type *a = line_a; \
+        const type *b = line_b; \
+        type *o = out; \
+        type fill = (type) build->fill_value; \
+        type px[4]; \
+        for (; j < nout; j++) \
+        { \
+            s1 = 2 * j + 1 < in_nsamps ? 2 * j + 1 : 2 * j; \
+            px[0] = a[2 * j]; \
+            px[1] = a[s1]; \
+            px[2] = b[2 * j]; \
+            px[3] = b[s1]; \
+            sum = 0.0; \
+            n = 0; \
+            for (k = 0; k < 4; k++) \
+            { \
+                if ((build->use_fill && px[k] == fill) || px[k] != px[k]) \
+                    continue; \
+                sum += px[k]; \
+                n++; \
+            } \
+            if (n == 0) \
+                o[j] = build->use_fill ? fill : px[0]; \
+            else if (round) \
+                o[j] = (type) floor (sum / n + 0.5); \
+            else \
+                o[j] = (type) (sum / n); \
+        } \
+    }
+
+
+/******************************************************************************
+MODULE: reduce_overview_line
+
+PURPOSE: Computes a line of a level from a pair of lines of the previous
+level.
+
+RETURN VALUE: None
+
+NOTES:
+  1. The second line is the same as the first for the last line of a level
+     with an odd number of lines.
+*****************************************************************************/
+static void reduce_overview_line
+(
+    const Ovr_build_t *build, /* I: overviews being built */
+    const void *line_a,  /* I: first line of the pair */
+    const void *line_b,  /* I: second line of the pair */
+    int in_nsamps,       /* I: number of samples in the lines of the pair */
+    void *out,           /* O: line of the level */
+    int nout             /* I: number of samples in the line of the level */
+)
+{
+    int j = 0;           /* current output pixel */
+    int k;               /* looping variable for the 2x2 pixels */
+    int s1;              /* sample of the right pixels of the 2x2 pixels */
+    int n;               /* number of valid pixels of the 2x2 pixels */
+    double sum;          /* sum of the valid pixels of the 2x2 pixels */
+
+    if (build->nearest)
+    {
+        switch (build->size)
+        {
+            case 1:
+                NEAREST_PIXELS (uint8_t);
+                break;
+            case 2:
+                NEAREST_PIXELS (uint16_t);
+                break;
+            case 4:
+                NEAREST_PIXELS (uint32_t);
+                break;
+            default:
+                NEAREST_PIXELS (uint64_t);
+                break;
+        }
+        return;
+    }
+
+    /* The whole 2x2 pixels without fill are left to the kernel */
+    if (!build->use_fill)
+        j = ovr_mean_kernel (line_a, line_b, out, in_nsamps / 2,
+            build->data_type);
+
+    switch (build->data_type)
+    {
+        case ESPA_INT8:
+            MEAN_PIXELS (int8_t, true);
+            break;
+        case ESPA_UINT8:
+            MEAN_PIXELS (uint8_t, true);
+            break;
+        case ESPA_INT16:
+            MEAN_PIXELS (int16_t, true);
+            break;
+        case ESPA_UINT16:
+            MEAN_PIXELS (uint16_t, true);
+            break;
+        case ESPA_INT32:
+            MEAN_PIXELS (int32_t, true);
+            break;
+        case ESPA_UINT32:
+            MEAN_PIXELS (uint32_t, true);
+            break;
+        case ESPA_FLOAT32:
+            MEAN_PIXELS (float, false);
+            break;
+        case ESPA_FLOAT64:
+            MEAN_PIXELS (double, false);
+            break;
+    }
+}
+
+
+/******************************************************************************
+MODULE: flush_overview_level
+
+PURPOSE: Writes the buffered lines of a level to the overview file.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error writing the lines
+SUCCESS      Successful completion
+
+NOTES:
+*****************************************************************************/
+static int flush_overview_level
+(
+    Ovr_build_t *build,  /* I/O: overviews being built */
+    int k                /* I: index of the level in build->level */
+)
+{
+    char FUNC_NAME[] = "flush_overview_level";  /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    Ovr_level_t *lvl = &build->level[k];  /* level being written */
+    size_t row_bytes = (size_t) lvl->nsamps * build->size;  /* bytes per
+                                                               line */
+
+    if (lvl->nout == 0)
+        return SUCCESS;
+
+    if (pio_raw_binary (build->fd, true, lvl->out, lvl->nout * row_bytes,
+        lvl->offset + (off_t) lvl->next_line * row_bytes) != SUCCESS)
+    {
+        sprintf (errmsg, "Writing lines %d to %d of overview level %d",
+            lvl->next_line, lvl->next_line + lvl->nout - 1, k + 1);
+        error_handler (true, FUNC_NAME, errmsg);
+        return ERROR;
+    }
+
+    lvl->next_line += lvl->nout;
+    lvl->nout = 0;
+    return SUCCESS;
+}
+
+
+static int feed_overview_line (Ovr_build_t *build, int k, const void *line);
+
+/******************************************************************************
+MODULE: add_overview_pair
+
+PURPOSE: Computes the next line of a level from a pair of lines of the
+previous level, and passes it on to the next level.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error writing the level
+SUCCESS      Successful completion
+
+NOTES:
+*****************************************************************************/
+static int add_overview_pair
+(
+    Ovr_build_t *build,  /* I/O: overviews being built */
+    int k,               /* I: index of the level in build->level */
+    const void *line_a,  /* I: first line of the pair */
+    const void *line_b   /* I: second line of the pair */
+)
+{
+    Ovr_level_t *lvl = &build->level[k];  /* level being computed */
+    char *line;          /* new line of the level */
+    int in_nsamps;       /* number of samples of the previous level */
+
+    in_nsamps = k == 0 ? build->nsamps : build->level[k - 1].nsamps;
+    line = lvl->out + (size_t) lvl->nout * lvl->nsamps * build->size;
+    reduce_overview_line (build, line_a, line_b, in_nsamps, line,
+        lvl->nsamps);
+    lvl->nout++;
+
+    if (k + 1 < build->nlevels &&
+        feed_overview_line (build, k + 1, line) != SUCCESS)
+        return ERROR;
+
+    if (lvl->nout == lvl->out_lines)
+        return flush_overview_level (build, k);
+    return SUCCESS;
+}
+
+
+/******************************************************************************
+MODULE: feed_overview_line
+
+PURPOSE: Takes the next line of the previous level of a level, which is
+either kept until the line it is paired with arrives or reduced with the
+line kept.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error writing the level
+SUCCESS      Successful completion
+
+NOTES:
+*****************************************************************************/
+static int feed_overview_line
+(
+    Ovr_build_t *build,  /* I/O: overviews being built */
+    int k,               /* I: index of the level in build->level */
+    const void *line     /* I: next line of the previous level */
+)
+{
+    Ovr_level_t *lvl = &build->level[k];  /* level taking the line */
+    int in_nsamps;       /* number of samples of the previous level */
+
+    if (lvl->have_pending)
+    {
+        lvl->have_pending = false;
+        return add_overview_pair (build, k, lvl->pending, line);
+    }
+
+    in_nsamps = k == 0 ? build->nsamps : build->level[k - 1].nsamps;
+    memcpy (lvl->pending, line, (size_t) in_nsamps * build->size);
+    lvl->have_pending = true;
+    return SUCCESS;
+}
+
+
+/******************************************************************************
+MODULE: free_overview_build
+
+PURPOSE: Frees the buffers of the overviews being built.
+
+RETURN VALUE: None
+
+NOTES:
+*****************************************************************************/
+static void free_overview_build
+(
+    Ovr_build_t *build   /* I: overviews being built */
+)
+{
+    int k;               /* looping variable for the levels */
+
+    for (k = 0; k < build->nlevels; k++)
+    {
+        free (build->level[k].pending);
+        free (build->level[k].out);
+    }
+}
+
+
+/******************************************************************************
+MODULE: overview_file_name
+
+PURPOSE: Determines the name of the overview file of a band from the name of
+its raw binary file.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        The name doesn't fit
+SUCCESS      Successful completion
+
+NOTES:
+  1. The extension of the band file is replaced by ESPA_OVERVIEW_SUFFIX.
+     The band name is added for a band sharing its file with other bands
+     (see espa_file_stack.h).
+*****************************************************************************/
+static int overview_file_name
+(
+    Espa_internal_meta_t *xml_meta, /* I: metadata with the bands */
+    int band,            /* I: index of the band in the metadata */
+    char *ovr_file       /* O: name of the overview file; STR_SIZE bytes */
+)
+{
+    char FUNC_NAME[] = "overview_file_name";  /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    char base[STR_SIZE];      /* band file name without its extension */
+    char *dot = NULL;         /* start of the extension */
+    char *slash = NULL;       /* start of the base name */
+    bool shared = false;      /* is the file shared with other bands? */
+    int i;                    /* looping variable for the bands */
+    int count;                /* number of chars copied in snprintf */
+    Espa_band_meta_t *bmeta = &xml_meta->band[band];  /* band metadata */
+
+    strcpy (base, bmeta->file_name);
+    dot = strrchr (base, '.');
+    slash = strrchr (base, '/');
+    if (dot != NULL && (slash == NULL || dot > slash))
+        *dot = '\0';
+
+    for (i = 0; i < xml_meta->nbands; i++)
+    {
+        if (i != band && !strcmp (xml_meta->band[i].file_name,
+            bmeta->file_name))
+            shared = true;
+    }
+
+    count = snprintf (ovr_file, STR_SIZE, "%s%s%s%s", base,
+        shared ? "_" : "", shared ? bmeta->name : "", ESPA_OVERVIEW_SUFFIX);
+    if (count < 0 || count >= STR_SIZE)
+    {
+        sprintf (errmsg, "Overflow of the overview file name of band %s",
+            bmeta->name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return ERROR;
+    }
+
+    return SUCCESS;
+}
+
+
+/******************************************************************************
+MODULE: espa_overview_nearest
+
+PURPOSE: Determines if the overviews of a band keep the upper left pixel of
+each 2x2 pixels (nearest neighbor) rather than averaging them.
+
+RETURN VALUE:
+Type = bool
+Value        Description
+-----        -----------
+true         The band is reduced with nearest neighbor
+false        The band is reduced with the mean
+
+NOTES:
+  1. The pixels of the QA bands, and of the bands described by bits or
+     classes, are codes which can't be averaged.
+*****************************************************************************/
+bool espa_overview_nearest
+(
+    const Espa_band_meta_t *bmeta  /* I: metadata of the band */
+)
+{
+    return bmeta->resample_method == ESPA_NN ||
+        !strcmp (bmeta->category, "qa") || bmeta->nbits > 0 ||
+        bmeta->nclass > 0;
+}
+
+
+/******************************************************************************
+MODULE: espa_overview_level
+
+PURPOSE: Determines the size of a level of the overviews of a band and where
+it starts in the overview file.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        The band doesn't have the level
+SUCCESS      Successful completion
+
+NOTES:
+*****************************************************************************/
+int espa_overview_level
+(
+    const Espa_band_meta_t *bmeta, /* I: metadata of the band */
+    int level,           /* I: level of the overview (1 for 2x, 2 for 4x,
+                               ...) */
+    int *nlines,         /* O: number of lines in the level */
+    int *nsamps,         /* O: number of samples in the level */
+    off_t *offset        /* O: byte offset of the level in the overview
+                               file */
+)
+{
+    char FUNC_NAME[] = "espa_overview_level";  /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    int size;                 /* number of bytes per pixel */
+    int k;                    /* looping variable for the levels */
+
+    if (!strcmp (bmeta->overview_file, ESPA_STRING_META_FILL) ||
+        level < 1 || level > bmeta->overview_levels)
+    {
+        sprintf (errmsg, "Band %s does not have overview level %d",
+            bmeta->name, level);
+        error_handler (true, FUNC_NAME, errmsg);
+        return ERROR;
+    }
+
+    size = espa_data_type_size (bmeta->data_type);
+    if (size == ERROR)
+    {
+        sprintf (errmsg, "Unsupported data type for band %s", bmeta->name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return ERROR;
+    }
+
+    *nlines = bmeta->nlines;
+    *nsamps = bmeta->nsamps;
+    *offset = 0;
+    for (k = 1; k <= level; k++)
+    {
+        if (k > 1)
+            *offset += (off_t) *nlines * *nsamps * size;
+        *nlines = (*nlines + 1) / 2;
+        *nsamps = (*nsamps + 1) / 2;
+    }
+
+    return SUCCESS;
+}
+
+
+/******************************************************************************
+MODULE: build_band_overviews
+
+PURPOSE: Builds the overviews of a band in a single pass over its lines, and
+records the overview file in its metadata.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error reading the band or writing the overviews
+SUCCESS      Successful completion
+
+NOTES:
+  1. Constant bands, and bands already no larger than the smallest level,
+     are left without overviews.
+  2. The band is read with the band stack, so its checksum and statistics
+     are recorded in the metadata if it doesn't have them.
+*****************************************************************************/
+int build_band_overviews
+(
+    Espa_internal_meta_t *xml_meta, /* I/O: metadata with the bands; the
+                                            overview_file and overview_levels
+                                            of the band are updated */
+    int band,            /* I: index of the band in the metadata */
+    int nlevels          /* I: number of levels to build; 0 to reduce the
+                               band to ESPA_OVERVIEW_MIN_SIZE */
+)
+{
+    char FUNC_NAME[] = "build_band_overviews";  /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    char ovr_file[STR_SIZE];  /* name of the overview file */
+    int k;                    /* looping variable for the levels */
+    int line;                 /* current line of the block */
+    int nlines;               /* number of lines of the current level */
+    int nsamps;               /* number of samples of the current level */
+    int status = SUCCESS;     /* status of building the levels */
+    size_t row_bytes;         /* number of bytes per line of the band */
+    off_t total_bytes = 0;    /* size of the overview file */
+    char *buf = NULL;         /* first line of the current block */
+    Espa_band_meta_t *bmeta = NULL;     /* metadata of the band */
+    Espa_band_stack_t *stack = NULL;    /* band stack reading the band */
+    Espa_band_block_t *block = NULL;    /* current block of lines */
+    Ovr_build_t build;        /* overviews being built */
+    Ovr_level_t *lvl = NULL;  /* current level */
+
+    if (band < 0 || band >= xml_meta->nbands)
+    {
+        sprintf (errmsg, "Band index %d is not in the metadata", band);
+        error_handler (true, FUNC_NAME, errmsg);
+        return ERROR;
+    }
+    bmeta = &xml_meta->band[band];
+    strcpy (bmeta->overview_file, ESPA_STRING_META_FILL);
+    bmeta->overview_levels = 0;
+    if (is_constant_band (bmeta))
+        return SUCCESS;
+
+    memset (&build, 0, sizeof (build));
+    build.data_type = bmeta->data_type;
+    build.size = espa_data_type_size (bmeta->data_type);
+    if (build.size == ERROR)
+    {
+        sprintf (errmsg, "Unsupported data type for band %s", bmeta->name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return ERROR;
+    }
+    build.nearest = espa_overview_nearest (bmeta);
+    build.use_fill = bmeta->fill_value != ESPA_INT_META_FILL;
+    build.fill_value = bmeta->fill_value;
+    build.nsamps = bmeta->nsamps;
+    build.fd = -1;
+
+    /* Size the levels */
+    nlines = bmeta->nlines;
+    nsamps = bmeta->nsamps;
+    while (build.nlevels < ESPA_OVERVIEW_MAX_LEVELS &&
+        (nlevels > 0 ? build.nlevels < nlevels && (nlines > 1 || nsamps > 1) :
+        nlines > ESPA_OVERVIEW_MIN_SIZE && nsamps > ESPA_OVERVIEW_MIN_SIZE))
+    {
+        lvl = &build.level[build.nlevels];
+        lvl->pending = malloc ((size_t) nsamps * build.size);
+        nlines = (nlines + 1) / 2;
+        nsamps = (nsamps + 1) / 2;
+        lvl->nlines = nlines;
+        lvl->nsamps = nsamps;
+        lvl->offset = total_bytes;
+        total_bytes += (off_t) nlines * nsamps * build.size;
+        lvl->out_lines = OVR_BLOCK_BYTES / ((size_t) nsamps * build.size);
+        if (lvl->out_lines < 1)
+            lvl->out_lines = 1;
+        else if (lvl->out_lines > nlines)
+            lvl->out_lines = nlines;
+        lvl->out = malloc ((size_t) lvl->out_lines * nsamps * build.size);
+        build.nlevels++;
+        if (lvl->pending == NULL || lvl->out == NULL)
+        {
+            sprintf (errmsg, "Allocating overview level %d of band %s",
+                build.nlevels, bmeta->name);
+            error_handler (true, FUNC_NAME, errmsg);
+            free_overview_build (&build);
+            return ERROR;
+        }
+    }
+    if (build.nlevels == 0)
+        return SUCCESS;
+
+    /* Start the overview file, replacing any previous one */
+    if (overview_file_name (xml_meta, band, ovr_file) != SUCCESS)
+    {  /* Error message already written */
+        free_overview_build (&build);
+        return ERROR;
+    }
+    unlink (ovr_file);
+    build.fd = open_raw_binary_fd (ovr_file, true);
+    if (build.fd == ERROR)
+    {
+        sprintf (errmsg, "Opening the overview file %s", ovr_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        free_overview_build (&build);
+        return ERROR;
+    }
+    if (ftruncate (build.fd, total_bytes) != 0)
+    {
+        sprintf (errmsg, "Sizing the overview file %s", ovr_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        close_raw_binary_fd (build.fd);
+        free_overview_build (&build);
+        return ERROR;
+    }
+
+    stack = open_band_stack (xml_meta, 1, &band, RB_PREFETCH_DEFAULT_LINES,
+        0);
+    if (stack == NULL)
+    {
+        sprintf (errmsg, "Opening band %s", bmeta->name);
+        error_handler (true, FUNC_NAME, errmsg);
+        close_raw_binary_fd (build.fd);
+        free_overview_build (&build);
+        return ERROR;
+    }
+
+    /* Pair the lines of each block for the first level, carrying an odd
+       line over to the next block */
+    row_bytes = (size_t) bmeta->nsamps * build.size;
+    lvl = &build.level[0];
+    while (status == SUCCESS)
+    {
+        status = get_band_stack_block (stack, &block);
+        if (status != SUCCESS || block == NULL)
+            break;
+
+        buf = block->band_buf[0];
+        line = 0;
+        if (lvl->have_pending && block->nlines > 0)
+        {
+            lvl->have_pending = false;
+            status = add_overview_pair (&build, 0, lvl->pending, buf);
+            line = 1;
+        }
+        for (; status == SUCCESS && line + 1 < block->nlines; line += 2)
+            status = add_overview_pair (&build, 0, buf + line * row_bytes,
+                buf + (line + 1) * row_bytes);
+        if (status == SUCCESS && line < block->nlines)
+            status = feed_overview_line (&build, 0, buf + line * row_bytes);
+    }
+    close_band_stack (stack);
+    if (status != SUCCESS)
+    {
+        sprintf (errmsg, "Reading band %s for its overviews", bmeta->name);
+        error_handler (true, FUNC_NAME, errmsg);
+        close_raw_binary_fd (build.fd);
+        free_overview_build (&build);
+        return ERROR;
+    }
+
+    /* The last line of a level with an odd number of lines is paired with
+       itself, which may pass a last line on to the next level */
+    for (k = 0; status == SUCCESS && k < build.nlevels; k++)
+    {
+        lvl = &build.level[k];
+        if (lvl->have_pending)
+        {
+            lvl->have_pending = false;
+            status = add_overview_pair (&build, k, lvl->pending,
+                lvl->pending);
+        }
+        if (status == SUCCESS)
+            status = flush_overview_level (&build, k);
+        if (status == SUCCESS && lvl->next_line != lvl->nlines)
+        {
+            sprintf (errmsg, "Overview level %d of band %s has %d of its "
+                "%d lines", k + 1, bmeta->name, lvl->next_line,
+                lvl->nlines);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+        }
+    }
+    close_raw_binary_fd (build.fd);
+    free_overview_build (&build);
+    if (status != SUCCESS)
+    {
+        sprintf (errmsg, "Writing the overview file %s", ovr_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return ERROR;
+    }
+
+    strcpy (bmeta->overview_file, ovr_file);
+    bmeta->overview_levels = build.nlevels;
+    return SUCCESS;
+}
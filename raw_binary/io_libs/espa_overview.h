@@ -0,0 +1,78 @@
+/*****************************************************************************
+FILE: espa_overview.h
+
+PURPOSE: Contains defines and prototypes for the overviews of a band, which
+are reduced resolution copies of the band (2x, 4x, 8x, ...) so a viewer or a
+browse generator can read a small band instead of the whole band.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The overviews of a band are stored in a sidecar file named by the
+     overview_file of the band metadata, and overview_levels records how
+     many there are.  Level k is reduced by a factor of 2^k from the band;
+     each level has half the lines and samples of the previous level,
+     rounded up.
+  2. The sidecar file is plain raw binary of the data type of the band.  The
+     levels are stored one after the other, level 1 (2x) first, with no
+     header; see espa_overview_level for where each level starts.
+  3. Each pixel of a level is computed from 2x2 pixels of the previous
+     level.  Image bands are averaged, leaving out the fill pixels (and NaN);
+     a pixel is fill only if all four are.  The QA bands, the bands of bits
+     or classes, and the bands resampled with nearest neighbor keep the
+     upper left pixel instead (see espa_overview_nearest).
+  4. The levels are built in a single pass over the band, each level taking
+     the lines of the previous level as they are computed.
+*****************************************************************************/
+
+#ifndef ESPA_OVERVIEW_H
+#define ESPA_OVERVIEW_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <sys/types.h>
+#include "error_handler.h"
+#include "espa_metadata.h"
+
+/* Defines */
+#define ESPA_OVERVIEW_SUFFIX "_ovr.img" /* suffix of the overview file name,
+                                     following the band file name without
+                                     its extension */
+#define ESPA_OVERVIEW_MIN_SIZE 256  /* levels are added by default until the
+                                       lines or samples are no more than
+                                       this */
+#define ESPA_OVERVIEW_MAX_LEVELS 16 /* largest number of levels of a band */
+
+/* Prototypes */
+bool espa_overview_nearest
+(
+    const Espa_band_meta_t *bmeta  /* I: metadata of the band */
+);
+
+int espa_overview_level
+(
+    const Espa_band_meta_t *bmeta, /* I: metadata of the band */
+    int level,           /* I: level of the overview (1 for 2x, 2 for 4x,
+                               ...) */
+    int *nlines,         /* O: number of lines in the level */
+    int *nsamps,         /* O: number of samples in the level */
+    off_t *offset        /* O: byte offset of the level in the overview
+                               file */
+);
+
+int build_band_overviews
+(
+    Espa_internal_meta_t *xml_meta, /* I/O: metadata with the bands; the
+                                            overview_file and overview_levels
+                                            of the band are updated */
+    int band,            /* I: index of the band in the metadata */
+    int nlevels          /* I: number of levels to build; 0 to reduce the
+                               band to ESPA_OVERVIEW_MIN_SIZE */
+);
+
+#endif
@@ -0,0 +1,97 @@
+/*****************************************************************************
+FILE: espa_pixel_convert.c
+
+PURPOSE: Contains the pixel conversion kernels for every pair of ESPA data
+types, generated from ESPA_PIXEL_TYPES.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. Each kernel is a plain loop of C conversions of a single pair of types,
+     which the compiler vectorizes.
+*****************************************************************************/
+
+#include "espa_pixel_convert.h"
+
+/* Output types of the kernels of an input type.  This repeats the list of
+   ESPA_PIXEL_TYPES, since a macro can't be expanded again within its own
+   expansion. */
+#define PIXEL_OUT_TYPES(X, IN_ENUM, IN_T, IN_NAME) \
+    X (IN_ENUM, IN_T, IN_NAME, ESPA_INT8, int8_t, int8) \
+    X (IN_ENUM, IN_T, IN_NAME, ESPA_UINT8, uint8_t, uint8) \
+    X (IN_ENUM, IN_T, IN_NAME, ESPA_INT16, int16_t, int16) \
+    X (IN_ENUM, IN_T, IN_NAME, ESPA_UINT16, uint16_t, uint16) \
+    X (IN_ENUM, IN_T, IN_NAME, ESPA_INT32, int32_t, int32) \
+    X (IN_ENUM, IN_T, IN_NAME, ESPA_UINT32, uint32_t, uint32) \
+    X (IN_ENUM, IN_T, IN_NAME, ESPA_FLOAT32, float, float32) \
+    X (IN_ENUM, IN_T, IN_NAME, ESPA_FLOAT64, double, float64)
+
+/* Kernel converting the pixels of one pair of types */
+#define PIXEL_CONVERT(IN_ENUM, IN_T, IN_NAME, OUT_ENUM, OUT_T, OUT_NAME) \
+static void convert_##IN_NAME##_to_##OUT_NAME \
+( \
+    const void *in,      /* I: pixels of the input type */ \
+    size_t nvals,        /* I: number of pixels */ \
+    void *out            /* O: pixels of the output type */ \
+) \
+{ \
+    size_t i;            /* looping variable for the pixels */ \
+    const IN_T *src = in;   /* input pixels */ \
+    OUT_T *dest = out;   /* output pixels */ \
+\
+    for (i = 0; i < nvals; i++) \
+        dest[i] = (OUT_T) src[i]; \
+}
+
+/* Entry of the kernel of one pair of types in the table */
+#define PIXEL_CONVERT_ENTRY(IN_ENUM, IN_T, IN_NAME, OUT_ENUM, OUT_T, \
+    OUT_NAME) \
+    [IN_ENUM][OUT_ENUM] = convert_##IN_NAME##_to_##OUT_NAME,
+
+#define PIXEL_CONVERT_ROW(IN_ENUM, IN_T, IN_NAME) \
+    PIXEL_OUT_TYPES (PIXEL_CONVERT, IN_ENUM, IN_T, IN_NAME)
+#define PIXEL_CONVERT_ENTRIES(IN_ENUM, IN_T, IN_NAME) \
+    PIXEL_OUT_TYPES (PIXEL_CONVERT_ENTRY, IN_ENUM, IN_T, IN_NAME)
+
+ESPA_PIXEL_TYPES (PIXEL_CONVERT_ROW)
+
+/* Kernels, indexed by the input and output data types */
+static const Espa_pixel_convert_t
+    pixel_converters[ESPA_NPIXEL_TYPES][ESPA_NPIXEL_TYPES] =
+{
+    ESPA_PIXEL_TYPES (PIXEL_CONVERT_ENTRIES)
+};
+
+
+/******************************************************************************
+MODULE: espa_pixel_converter
+
+PURPOSE: Looks up the kernel converting pixels of one data type to another.
+
+RETURN VALUE:
+Type = Espa_pixel_convert_t
+Value        Description
+-----        -----------
+NULL         Unsupported data type
+kernel       Kernel converting the pixels
+
+NOTES:
+  1. The pixels are converted as by a C cast, so the input values must be
+     representable in the output data type.  Floating point values are
+     truncated toward zero when converted to an integer data type.
+*****************************************************************************/
+Espa_pixel_convert_t espa_pixel_converter
+(
+    enum Espa_data_type in_type,   /* I: data type of the input pixels */
+    enum Espa_data_type out_type   /* I: data type of the output pixels */
+)
+{
+    if ((unsigned) in_type >= ESPA_NPIXEL_TYPES ||
+        (unsigned) out_type >= ESPA_NPIXEL_TYPES)
+        return NULL;
+
+    return pixel_converters[in_type][out_type];
+}
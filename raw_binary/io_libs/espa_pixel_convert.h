@@ -0,0 +1,64 @@
+/*****************************************************************************
+FILE: espa_pixel_convert.h
+
+PURPOSE: Contains the list of the pixel types of the ESPA data types, for
+generating a kernel per data type at compile time, and prototypes for the
+pixel conversion kernels generated for every pair of data types.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. ESPA_PIXEL_TYPES (X) expands X (data type, C type, name) for each data
+     type, so a kernel written once as a macro is instantiated for each
+     type, and a switch on the data type picks the kernel once per band (or
+     block) rather than once per pixel.  ESPA_INT_PIXEL_TYPES is the same
+     for the integer data types.
+  2. The conversion kernels are a table indexed by the input and output data
+     types, looked up once per band with espa_pixel_converter.
+*****************************************************************************/
+
+#ifndef ESPA_PIXEL_CONVERT_H
+#define ESPA_PIXEL_CONVERT_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include "espa_metadata.h"
+
+/* Pixel types of the integer data types */
+#define ESPA_INT_PIXEL_TYPES(X) \
+    X (ESPA_INT8, int8_t, int8) \
+    X (ESPA_UINT8, uint8_t, uint8) \
+    X (ESPA_INT16, int16_t, int16) \
+    X (ESPA_UINT16, uint16_t, uint16) \
+    X (ESPA_INT32, int32_t, int32) \
+    X (ESPA_UINT32, uint32_t, uint32)
+
+/* Pixel types of all the data types */
+#define ESPA_PIXEL_TYPES(X) \
+    ESPA_INT_PIXEL_TYPES (X) \
+    X (ESPA_FLOAT32, float, float32) \
+    X (ESPA_FLOAT64, double, float64)
+
+/* Number of data types in ESPA_PIXEL_TYPES */
+#define ESPA_NPIXEL_TYPES (ESPA_FLOAT64 + 1)
+
+/* Kernel converting pixels of one data type to another */
+typedef void (*Espa_pixel_convert_t)
+(
+    const void *in,      /* I: pixels of the input data type */
+    size_t nvals,        /* I: number of pixels */
+    void *out            /* O: pixels of the output data type */
+);
+
+/* Prototypes */
+Espa_pixel_convert_t espa_pixel_converter
+(
+    enum Espa_data_type in_type,   /* I: data type of the input pixels */
+    enum Espa_data_type out_type   /* I: data type of the output pixels */
+);
+
+#endif
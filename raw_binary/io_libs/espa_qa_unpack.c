@@ -0,0 +1,764 @@
+/*****************************************************************************
+FILE: espa_qa_unpack.c
+
+PURPOSE: Contains functions for unpacking the bit fields of a QA band into
+masks (see espa_qa_unpack.h).
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The value of a field is (pixel >> shift) & ((1 << nbits) - 1).  The
+     8-bit QA bands are shifted as 16-bit lanes, which pulls bits of the
+     next pixel into the top of each byte, but the field lies within the
+     byte, so the mask drops them.
+  2. The bit-packed masks are made from the 8-bit values of a chunk of the
+     line, comparing them against min_value and gathering the results with
+     a byte movemask, whose bit order is the order of the mask bytes.
+*****************************************************************************/
+
+#include <ctype.h>
+#include "espa_qa_unpack.h"
+#include "espa_cpu_dispatch.h"
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#define QA_UNPACK_X86
+#endif
+
+/* Number of samples of a bit-packed mask made at a time, from the values in
+   a buffer on the stack; a multiple of 8 */
+#define QA_BITS_CHUNK 256
+
+/* Kernel unpacking a field of a line of 8-bit QA pixels; returns the number
+   of pixels done */
+typedef int (*Qa_unpack8_kernel_t)
+(
+    const uint8_t *qa,   /* I: QA pixels */
+    int n,               /* I: number of pixels */
+    int shift,           /* I: first bit of the field */
+    int mask,            /* I: mask of the field after the shift */
+    uint8_t *out         /* O: values of the field */
+);
+
+/* Kernel unpacking a field of a line of 16-bit QA pixels; returns the
+   number of pixels done */
+typedef int (*Qa_unpack16_kernel_t)
+(
+    const uint16_t *qa,  /* I: QA pixels */
+    int n,               /* I: number of pixels */
+    int shift,           /* I: first bit of the field */
+    int mask,            /* I: mask of the field after the shift */
+    uint8_t *out         /* O: values of the field */
+);
+
+/* Kernel setting the bits of the values which are at least min_value;
+   returns the number of values done, a multiple of 8 */
+typedef int (*Qa_bits_kernel_t)
+(
+    const uint8_t *values,  /* I: values of the field */
+    int n,               /* I: number of values */
+    int min_value,       /* I: smallest value whose bit is set */
+    uint8_t *bits        /* O: bit-packed mask */
+);
+
+
+#ifdef QA_UNPACK_X86
+/******************************************************************************
+MODULE: qa_unpack8_sse2
+
+PURPOSE: Unpacks a field of 16 8-bit QA pixels at a time.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+n            Number of pixels done
+
+NOTES:
+*****************************************************************************/
+static int qa_unpack8_sse2
+(
+    const uint8_t *qa,   /* I: QA pixels */
+    int n,               /* I: number of pixels */
+    int shift,           /* I: first bit of the field */
+    int mask,            /* I: mask of the field after the shift */
+    uint8_t *out         /* O: values of the field */
+)
+{
+    int i;               /* current pixel */
+    __m128i vshift = _mm_cvtsi32_si128 (shift);  /* shift count */
+    __m128i vmask = _mm_set1_epi8 ((char) mask); /* mask of the field */
+    __m128i v;           /* vector of pixels */
+
+    for (i = 0; i + 16 <= n; i += 16)
+    {
+        v = _mm_loadu_si128 ((const __m128i *) (qa + i));
+        v = _mm_and_si128 (_mm_srl_epi16 (v, vshift), vmask);
+        _mm_storeu_si128 ((__m128i *) (out + i), v);
+    }
+
+    return i;
+}
+
+
+/******************************************************************************
+MODULE: qa_unpack16_sse2
+
+PURPOSE: Unpacks a field of 16 16-bit QA pixels at a time, packing the values
+into bytes.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+n            Number of pixels done
+
+NOTES:
+*****************************************************************************/
+static int qa_unpack16_sse2
+(
+    const uint16_t *qa,  /* I: QA pixels */
+    int n,               /* I: number of pixels */
+    int shift,           /* I: first bit of the field */
+    int mask,            /* I: mask of the field after the shift */
+    uint8_t *out         /* O: values of the field */
+)
+{
+    int i;               /* current pixel */
+    __m128i vshift = _mm_cvtsi32_si128 (shift);  /* shift count */
+    __m128i vmask = _mm_set1_epi16 ((short) mask);  /* mask of the field */
+    __m128i lo;          /* first 8 pixels */
+    __m128i hi;          /* next 8 pixels */
+
+    for (i = 0; i + 16 <= n; i += 16)
+    {
+        lo = _mm_loadu_si128 ((const __m128i *) (qa + i));
+        hi = _mm_loadu_si128 ((const __m128i *) (qa + i + 8));
+        lo = _mm_and_si128 (_mm_srl_epi16 (lo, vshift), vmask);
+        hi = _mm_and_si128 (_mm_srl_epi16 (hi, vshift), vmask);
+        _mm_storeu_si128 ((__m128i *) (out + i), _mm_packus_epi16 (lo, hi));
+    }
+
+    return i;
+}
+
+
+/******************************************************************************
+MODULE: qa_bits_sse2
+
+PURPOSE: Sets the bits of 16 values at a time which are at least min_value.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+n            Number of values done
+
+NOTES:
+  1. The unsigned compare is max (v, min_value) == v.
+*****************************************************************************/
+static int qa_bits_sse2
+(
+    const uint8_t *values,  /* I: values of the field */
+    int n,               /* I: number of values */
+    int min_value,       /* I: smallest value whose bit is set */
+    uint8_t *bits        /* O: bit-packed mask */
+)
+{
+    int i;               /* current value */
+    int m;               /* bits of the 16 values */
+    __m128i vmin = _mm_set1_epi8 ((char) min_value);  /* smallest value */
+    __m128i v;           /* vector of values */
+
+    for (i = 0; i + 16 <= n; i += 16)
+    {
+        v = _mm_loadu_si128 ((const __m128i *) (values + i));
+        m = _mm_movemask_epi8 (_mm_cmpeq_epi8 (_mm_max_epu8 (v, vmin), v));
+        bits[i / 8] = (uint8_t) m;
+        bits[i / 8 + 1] = (uint8_t) (m >> 8);
+    }
+
+    return i;
+}
+
+
+/******************************************************************************
+MODULE: qa_unpack8_avx2
+
+PURPOSE: Unpacks a field of 32 8-bit QA pixels at a time.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+n            Number of pixels done
+
+NOTES:
+  1. Only put in the kernel table when the CPU supports AVX2.
+*****************************************************************************/
+__attribute__ ((target ("avx2")))
+static int qa_unpack8_avx2
+(
+    const uint8_t *qa,   /* I: QA pixels */
+    int n,               /* I: number of pixels */
+    int shift,           /* I: first bit of the field */
+    int mask,            /* I: mask of the field after the shift */
+    uint8_t *out         /* O: values of the field */
+)
+{
+    int i;               /* current pixel */
+    __m128i vshift = _mm_cvtsi32_si128 (shift);     /* shift count */
+    __m256i vmask = _mm256_set1_epi8 ((char) mask); /* mask of the field */
+    __m256i v;           /* vector of pixels */
+
+    for (i = 0; i + 32 <= n; i += 32)
+    {
+        v = _mm256_loadu_si256 ((const __m256i *) (qa + i));
+        v = _mm256_and_si256 (_mm256_srl_epi16 (v, vshift), vmask);
+        _mm256_storeu_si256 ((__m256i *) (out + i), v);
+    }
+
+    return i;
+}
+
+
+/******************************************************************************
+MODULE: qa_unpack16_avx2
+
+PURPOSE: Unpacks a field of 32 16-bit QA pixels at a time, packing the values
+into bytes.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+n            Number of pixels done
+
+NOTES:
+  1. Only put in the kernel table when the CPU supports AVX2.
+  2. The pack interleaves the 128-bit lanes of its operands, so the 64-bit
+     quarters are put back in order.
+*****************************************************************************/
+__attribute__ ((target ("avx2")))
+static int qa_unpack16_avx2
+(
+    const uint16_t *qa,  /* I: QA pixels */
+    int n,               /* I: number of pixels */
+    int shift,           /* I: first bit of the field */
+    int mask,            /* I: mask of the field after the shift */
+    uint8_t *out         /* O: values of the field */
+)
+{
+    int i;               /* current pixel */
+    __m128i vshift = _mm_cvtsi32_si128 (shift);        /* shift count */
+    __m256i vmask = _mm256_set1_epi16 ((short) mask);  /* mask of the field */
+    __m256i lo;          /* first 16 pixels */
+    __m256i hi;          /* next 16 pixels */
+
+    for (i = 0; i + 32 <= n; i += 32)
+    {
+        lo = _mm256_loadu_si256 ((const __m256i *) (qa + i));
+        hi = _mm256_loadu_si256 ((const __m256i *) (qa + i + 16));
+        lo = _mm256_and_si256 (_mm256_srl_epi16 (lo, vshift), vmask);
+        hi = _mm256_and_si256 (_mm256_srl_epi16 (hi, vshift), vmask);
+        _mm256_storeu_si256 ((__m256i *) (out + i), _mm256_permute4x64_epi64
+            (_mm256_packus_epi16 (lo, hi), 0xd8));
+    }
+
+    return i;
+}
+
+
+/******************************************************************************
+MODULE: qa_bits_avx2
+
+PURPOSE: Sets the bits of 32 values at a time which are at least min_value.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+n            Number of values done
+
+NOTES:
+  1. Only put in the kernel table when the CPU supports AVX2.
+*****************************************************************************/
+__attribute__ ((target ("avx2")))
+static int qa_bits_avx2
+(
+    const uint8_t *values,  /* I: values of the field */
+    int n,               /* I: number of values */
+    int min_value,       /* I: smallest value whose bit is set */
+    uint8_t *bits        /* O: bit-packed mask */
+)
+{
+    int i;               /* current value */
+    uint32_t m;          /* bits of the 32 values */
+    __m256i vmin = _mm256_set1_epi8 ((char) min_value);  /* smallest value */
+    __m256i v;           /* vector of values */
+
+    for (i = 0; i + 32 <= n; i += 32)
+    {
+        v = _mm256_loadu_si256 ((const __m256i *) (values + i));
+        m = (uint32_t) _mm256_movemask_epi8 (_mm256_cmpeq_epi8
+            (_mm256_max_epu8 (v, vmin), v));
+        bits[i / 8] = (uint8_t) m;
+        bits[i / 8 + 1] = (uint8_t) (m >> 8);
+        bits[i / 8 + 2] = (uint8_t) (m >> 16);
+        bits[i / 8 + 3] = (uint8_t) (m >> 24);
+    }
+
+    return i;
+}
+#endif
+
+
+/******************************************************************************
+MODULE: qa_unpack8_none, qa_unpack16_none, qa_bits_none
+
+PURPOSE: Kernels of CPUs without SIMD support, leaving all the pixels to the
+scalar loops.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+0            No pixels done
+
+NOTES:
+*****************************************************************************/
+static int qa_unpack8_none
+(
+    const uint8_t *qa,   /* I: QA pixels (unused) */
+    int n,               /* I: number of pixels (unused) */
+    int shift,           /* I: first bit of the field (unused) */
+    int mask,            /* I: mask of the field (unused) */
+    uint8_t *out         /* O: values of the field (unused) */
+)
+{
+    return 0;
+}
+
+static int qa_unpack16_none
+(
+    const uint16_t *qa,  /* I: QA pixels (unused) */
+    int n,               /* I: number of pixels (unused) */
+    int shift,           /* I: first bit of the field (unused) */
+    int mask,            /* I: mask of the field (unused) */
+    uint8_t *out         /* O: values of the field (unused) */
+)
+{
+    return 0;
+}
+
+static int qa_bits_none
+(
+    const uint8_t *values,  /* I: values of the field (unused) */
+    int n,               /* I: number of values (unused) */
+    int min_value,       /* I: smallest value set (unused) */
+    uint8_t *bits        /* O: bit-packed mask (unused) */
+)
+{
+    return 0;
+}
+
+
+/* Kernels, chosen by init_qa_unpack_kernels */
+static Qa_unpack8_kernel_t qa_unpack8_kernel = qa_unpack8_none;
+static Qa_unpack16_kernel_t qa_unpack16_kernel = qa_unpack16_none;
+static Qa_bits_kernel_t qa_bits_kernel = qa_bits_none;
+
+
+/******************************************************************************
+MODULE: init_qa_unpack_kernels
+
+PURPOSE: Chooses the widest kernels supported by the CPU.
+
+RETURN VALUE: None
+
+NOTES:
+  1. Run when the program (or shared library) is loaded.
+*****************************************************************************/
+__attribute__ ((constructor))
+static void init_qa_unpack_kernels (void)
+{
+#if defined(QA_UNPACK_X86)
+    if (espa_cpu_supports (ESPA_CPU_AVX2))
+    {
+        qa_unpack8_kernel = qa_unpack8_avx2;
+        qa_unpack16_kernel = qa_unpack16_avx2;
+        qa_bits_kernel = qa_bits_avx2;
+    }
+    else if (espa_cpu_supports (ESPA_CPU_SSE2))
+    {
+        qa_unpack8_kernel = qa_unpack8_sse2;
+        qa_unpack16_kernel = qa_unpack16_sse2;
+        qa_bits_kernel = qa_bits_sse2;
+    }
+#endif
+}
+
+
+/******************************************************************************
+MODULE: field_name
+
+PURPOSE: Determines the name of a field from the description of its bits:
+the description up to the first " (", without trailing blanks.
+
+RETURN VALUE: None
+******************************************************************************/
+static void field_name
+(
+    const char *description,  /* I: description of the bits */
+    char *name           /* O: name of the field; STR_SIZE characters */
+)
+{
+    const char *cptr = strstr (description, " (");  /* end of the name */
+    size_t len;          /* length of the name */
+
+    len = (cptr != NULL) ? (size_t) (cptr - description) :
+        strlen (description);
+    while (len > 0 && isspace ((unsigned char) description[len-1]))
+        len--;
+    if (len >= STR_SIZE)
+        len = STR_SIZE - 1;
+    memcpy (name, description, len);
+    name[len] = '\0';
+}
+
+
+/******************************************************************************
+MODULE: get_espa_qa_fields
+
+PURPOSE: Groups the bits of a QA band into its fields.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           The band has no bitmap description, or too many fields
+SUCCESS         Successfully listed the fields
+
+NOTES:
+  1. A field wider than 8 bits is listed but can't be unpacked.
+******************************************************************************/
+int get_espa_qa_fields
+(
+    const Espa_band_meta_t *bmeta, /* I: metadata of the QA band */
+    Espa_qa_field_t *fields,       /* O: fields of the band; holds
+                                         ESPA_QA_MAX_FIELDS */
+    int *nfields                   /* O: number of fields */
+)
+{
+    char FUNC_NAME[] = "get_espa_qa_fields";   /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    int bit;                 /* looping variable for the bits */
+    int last;                /* last bit of the current field */
+    const char *desc = NULL; /* description of the current bit */
+
+    *nfields = 0;
+    if (bmeta->nbits <= 0 || bmeta->bitmap_description == NULL)
+    {
+        sprintf (errmsg, "Band %s has no bitmap description", bmeta->name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    for (bit = 0; bit < bmeta->nbits; bit = last + 1)
+    {
+        /* The field runs over the bits with the same description */
+        desc = bmeta->bitmap_description[bit];
+        for (last = bit; last + 1 < bmeta->nbits &&
+            !strcmp (bmeta->bitmap_description[last + 1], desc); last++)
+            ;
+        if (desc[0] == '\0' || !strcasecmp (desc, "Not used"))
+            continue;
+
+        if (*nfields == ESPA_QA_MAX_FIELDS)
+        {
+            sprintf (errmsg, "Band %s has more than %d fields", bmeta->name,
+                ESPA_QA_MAX_FIELDS);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+        field_name (desc, fields[*nfields].name);
+        fields[*nfields].shift = bit;
+        fields[*nfields].nbits = last - bit + 1;
+        (*nfields)++;
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE: find_espa_qa_field
+
+PURPOSE: Finds a field of a QA band by its name or its bits.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           The field isn't in the band
+SUCCESS         Successfully found the field
+
+NOTES:
+  1. Bits are given as "first" or "first-last", 0-based from the least
+     significant bit, and need not match the grouping of the descriptions.
+******************************************************************************/
+int find_espa_qa_field
+(
+    const Espa_band_meta_t *bmeta, /* I: metadata of the QA band */
+    const char *name,              /* I: name or bits of the field */
+    Espa_qa_field_t *field         /* O: field */
+)
+{
+    char FUNC_NAME[] = "find_espa_qa_field";   /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    char tail;               /* character after the bits */
+    int first;               /* first bit */
+    int last;                /* last bit */
+    int i;                   /* looping variable for the fields */
+    int nfields;             /* number of fields of the band */
+    int nbits;               /* number of bits of the band */
+    Espa_qa_field_t fields[ESPA_QA_MAX_FIELDS];  /* fields of the band */
+
+    /* Bits of the band */
+    if (isdigit ((unsigned char) name[0]))
+    {
+        nbits = 8 * ((bmeta->data_type == ESPA_UINT8) ? 1 : 2);
+        if (sscanf (name, "%d-%d%c", &first, &last, &tail) != 2)
+        {
+            if (sscanf (name, "%d%c", &first, &tail) != 1)
+                first = -1;
+            last = first;
+        }
+        if (first < 0 || last < first || last >= nbits)
+        {
+            sprintf (errmsg, "Invalid bits %s of band %s", name,
+                bmeta->name);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+        if (first == last)
+            snprintf (field->name, sizeof (field->name), "bit %d", first);
+        else
+            snprintf (field->name, sizeof (field->name), "bits %d-%d",
+                first, last);
+        field->shift = first;
+        field->nbits = last - first + 1;
+        return (SUCCESS);
+    }
+
+    if (get_espa_qa_fields (bmeta, fields, &nfields) != SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+    for (i = 0; i < nfields; i++)
+    {
+        if (!strcasecmp (fields[i].name, name))
+        {
+            *field = fields[i];
+            return (SUCCESS);
+        }
+    }
+
+    sprintf (errmsg, "Field %s was not found in band %s", name, bmeta->name);
+    error_handler (true, FUNC_NAME, errmsg);
+    return (ERROR);
+}
+
+
+/******************************************************************************
+MODULE: init_espa_qa_unpack
+
+PURPOSE: Sets up the unpacking of fields of a QA band into masks.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           A field can't be unpacked
+SUCCESS         Successfully set up the unpacking
+******************************************************************************/
+int init_espa_qa_unpack
+(
+    const Espa_band_meta_t *bmeta, /* I: metadata of the QA band */
+    int nfields,                   /* I: number of fields to unpack */
+    char **names,                  /* I: name or bits of each field */
+    enum Espa_qa_mask_format format,  /* I: format of the masks */
+    int min_value,                 /* I: smallest value set in a bit-packed
+                                         mask (1 to 255) */
+    Espa_qa_unpack_t *unpack       /* O: unpacking of the fields */
+)
+{
+    char FUNC_NAME[] = "init_espa_qa_unpack";   /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    int i;                   /* looping variable for the fields */
+    Espa_qa_field_t *field = NULL;  /* current field */
+
+    if (bmeta->data_type != ESPA_UINT8 && bmeta->data_type != ESPA_UINT16)
+    {
+        sprintf (errmsg, "QA band %s isn't UINT8 or UINT16", bmeta->name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    if (nfields < 1 || nfields > ESPA_QA_MAX_FIELDS)
+    {
+        sprintf (errmsg, "From 1 to %d fields can be unpacked at a time",
+            ESPA_QA_MAX_FIELDS);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    if (format == ESPA_QA_MASK_BITS && (min_value < 1 || min_value > 255))
+    {
+        sprintf (errmsg, "Invalid smallest value of the bit-packed masks: "
+            "%d", min_value);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    unpack->data_type = bmeta->data_type;
+    unpack->format = format;
+    unpack->min_value = min_value;
+    unpack->nfields = nfields;
+    for (i = 0; i < nfields; i++)
+    {
+        field = &unpack->field[i];
+        if (find_espa_qa_field (bmeta, names[i], field) != SUCCESS)
+        {  /* Error messages already written */
+            return (ERROR);
+        }
+        if (field->nbits > 8 || field->shift + field->nbits >
+            8 * ((bmeta->data_type == ESPA_UINT8) ? 1 : 2))
+        {
+            sprintf (errmsg, "Field %s of band %s doesn't fit in 8 bits",
+                field->name, bmeta->name);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE: espa_qa_mask_line_bytes
+
+PURPOSE: Determines the size of a line of each mask.
+
+RETURN VALUE:
+Type = size_t
+Value           Description
+-----           -----------
+n               Number of bytes in a line of a mask
+******************************************************************************/
+size_t espa_qa_mask_line_bytes
+(
+    const Espa_qa_unpack_t *unpack,  /* I: unpacking of the fields */
+    int nsamps                     /* I: number of samples in a line */
+)
+{
+    if (unpack->format == ESPA_QA_MASK_BITS)
+        return ((size_t) nsamps + 7) / 8;
+    return (size_t) nsamps;
+}
+
+
+/******************************************************************************
+MODULE: unpack_field
+
+PURPOSE: Unpacks the values of a field for a run of samples of a line.
+
+RETURN VALUE: None
+******************************************************************************/
+static void unpack_field
+(
+    const Espa_qa_unpack_t *unpack,  /* I: unpacking of the fields */
+    const Espa_qa_field_t *field,    /* I: field to be unpacked */
+    const void *qa,      /* I: line of the QA band */
+    int s,               /* I: first sample */
+    int n,               /* I: number of samples */
+    uint8_t *out         /* O: values of the field for the samples */
+)
+{
+    int i;               /* current sample */
+    int mask = (1 << field->nbits) - 1;  /* mask of the field */
+    const uint8_t *qa8 = (const uint8_t *) qa + s;    /* 8-bit pixels */
+    const uint16_t *qa16 = (const uint16_t *) qa + s; /* 16-bit pixels */
+
+    if (unpack->data_type == ESPA_UINT8)
+    {
+        i = qa_unpack8_kernel (qa8, n, field->shift, mask, out);
+        for (; i < n; i++)
+            out[i] = (qa8[i] >> field->shift) & mask;
+    }
+    else
+    {
+        i = qa_unpack16_kernel (qa16, n, field->shift, mask, out);
+        for (; i < n; i++)
+            out[i] = (qa16[i] >> field->shift) & mask;
+    }
+}
+
+
+/******************************************************************************
+MODULE: unpack_espa_qa_line
+
+PURPOSE: Unpacks the fields of a line of the QA band into their masks.
+
+RETURN VALUE: None
+
+NOTES:
+  1. Only the line of the caller and a chunk of values on the stack are
+     used, so lines may be unpacked by several threads at once.
+******************************************************************************/
+void unpack_espa_qa_line
+(
+    const Espa_qa_unpack_t *unpack,  /* I: unpacking of the fields */
+    const void *qa,                /* I: line of the QA band */
+    int nsamps,                    /* I: number of samples in the line */
+    uint8_t **masks                /* O: line of the mask of each field, of
+                                         espa_qa_mask_line_bytes each */
+)
+{
+    int k;               /* looping variable for the fields */
+    int s;               /* first sample of the chunk */
+    int n;               /* number of samples in the chunk */
+    int i;               /* current value of the chunk */
+    uint8_t values[QA_BITS_CHUNK];  /* values of the field for the chunk */
+    uint8_t *bits = NULL;           /* bytes of the chunk in the mask */
+
+    for (k = 0; k < unpack->nfields; k++)
+    {
+        if (unpack->format == ESPA_QA_MASK_UINT8)
+        {
+            unpack_field (unpack, &unpack->field[k], qa, 0, nsamps,
+                masks[k]);
+            continue;
+        }
+
+        for (s = 0; s < nsamps; s += QA_BITS_CHUNK)
+        {
+            n = nsamps - s;
+            if (n > QA_BITS_CHUNK)
+                n = QA_BITS_CHUNK;
+            unpack_field (unpack, &unpack->field[k], qa, s, n, values);
+
+            bits = masks[k] + s / 8;
+            i = qa_bits_kernel (values, n, unpack->min_value, bits);
+            for (; i < n; i++)
+            {
+                if (i % 8 == 0)
+                    bits[i / 8] = 0;
+                if (values[i] >= unpack->min_value)
+                    bits[i / 8] |= 1 << (i % 8);
+            }
+        }
+    }
+}
@@ -0,0 +1,115 @@
+/*****************************************************************************
+FILE: espa_qa_unpack.h
+
+PURPOSE: Contains defines, structures, and prototypes for unpacking the bit
+fields of a QA band, as described by its bitmap_description, into masks of
+8-bit values or bit-packed masks, a line at a time.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. A field is a run of consecutive bits with the same description (ex.
+     bits 8 and 9 of qa_pixel are both "Cloud Confidence").  Bits described
+     as "Not used" aren't fields.  A field is named by its description up to
+     the first " (", matched without regard to case, or by its bits as
+     "8" or "8-9".
+  2. The 8-bit masks hold the value of the field of each pixel.  The
+     bit-packed masks hold one bit per pixel, set where the value of the
+     field is at least min_value, with the first pixel of each byte in its
+     least significant bit.  Each line of a bit-packed mask starts a new
+     byte.
+  3. Lines are unpacked from the buffer of the caller, so the masks can be
+     made while a band is being clipped, browsed, or exported, without
+     another pass over the band.  The shifts and masks use SIMD
+     instructions, chosen once when the program is loaded (see
+     espa_cpu_dispatch.h).
+*****************************************************************************/
+
+#ifndef ESPA_QA_UNPACK_H
+#define ESPA_QA_UNPACK_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+#include "error_handler.h"
+#include "espa_metadata.h"
+
+/* Defines */
+#define ESPA_QA_MAX_FIELDS 32      /* most fields unpacked at a time */
+
+/* Formats of the masks */
+enum Espa_qa_mask_format
+{
+    ESPA_QA_MASK_UINT8,            /* value of the field in 8 bits */
+    ESPA_QA_MASK_BITS              /* one bit per pixel */
+};
+
+/* Bit field of a QA band */
+typedef struct
+{
+    char name[STR_SIZE];           /* name of the field, from the
+                                      description of its bits */
+    int shift;                     /* first (least significant) bit */
+    int nbits;                     /* number of bits, 1 to 8 */
+} Espa_qa_field_t;
+
+/* Unpacking of the fields of a QA band */
+typedef struct
+{
+    enum Espa_data_type data_type; /* data type of the QA band (ESPA_UINT8
+                                      or ESPA_UINT16) */
+    enum Espa_qa_mask_format format;  /* format of the masks */
+    int min_value;                 /* smallest field value whose bit is set
+                                      in a bit-packed mask */
+    int nfields;                   /* number of fields unpacked */
+    Espa_qa_field_t field[ESPA_QA_MAX_FIELDS];  /* fields unpacked */
+} Espa_qa_unpack_t;
+
+/* Prototypes */
+int get_espa_qa_fields
+(
+    const Espa_band_meta_t *bmeta, /* I: metadata of the QA band */
+    Espa_qa_field_t *fields,       /* O: fields of the band; holds
+                                         ESPA_QA_MAX_FIELDS */
+    int *nfields                   /* O: number of fields */
+);
+
+int find_espa_qa_field
+(
+    const Espa_band_meta_t *bmeta, /* I: metadata of the QA band */
+    const char *name,              /* I: name or bits of the field */
+    Espa_qa_field_t *field         /* O: field */
+);
+
+int init_espa_qa_unpack
+(
+    const Espa_band_meta_t *bmeta, /* I: metadata of the QA band */
+    int nfields,                   /* I: number of fields to unpack */
+    char **names,                  /* I: name or bits of each field */
+    enum Espa_qa_mask_format format,  /* I: format of the masks */
+    int min_value,                 /* I: smallest value set in a bit-packed
+                                         mask (1 to 255) */
+    Espa_qa_unpack_t *unpack       /* O: unpacking of the fields */
+);
+
+size_t espa_qa_mask_line_bytes
+(
+    const Espa_qa_unpack_t *unpack,  /* I: unpacking of the fields */
+    int nsamps                     /* I: number of samples in a line */
+);
+
+void unpack_espa_qa_line
+(
+    const Espa_qa_unpack_t *unpack,  /* I: unpacking of the fields */
+    const void *qa,                /* I: line of the QA band */
+    int nsamps,                    /* I: number of samples in the line */
+    uint8_t **masks                /* O: line of the mask of each field, of
+                                         espa_qa_mask_line_bytes each */
+);
+
+#endif
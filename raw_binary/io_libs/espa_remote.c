@@ -0,0 +1,985 @@
+/*****************************************************************************
+FILE: espa_remote.c
+
+PURPOSE: Contains functions for reading input files from object storage (S3)
+or HTTP servers with concurrent byte range requests.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. A read waits only for the blocks it covers, which are queued ahead of
+     the blocks being read ahead, so the conversion of a file starts as soon
+     as its first bytes arrive and the parts of a file which are never read
+     (such as the overviews of a Cloud Optimized GeoTIFF) are never
+     downloaded.
+  2. The blocks are fetched by the threads of each remote file, so reads of
+     several remote files (such as bands converted in parallel) proceed
+     independently.
+*****************************************************************************/
+
+#include <unistd.h>
+#ifdef HAVE_LIBCURL
+#include <curl/curl.h>
+#endif
+#include "espa_remote.h"
+#include "espa_trace.h"
+
+#ifdef HAVE_LIBCURL
+/* libcurl needs to be initialized once, before any thread uses it */
+static pthread_once_t remote_init_once = PTHREAD_ONCE_INIT;
+
+/* Bytes of a range request being received */
+typedef struct
+{
+    char *buf;               /* bytes of the range */
+    size_t nbytes;           /* number of bytes in the range */
+    size_t filled;           /* number of bytes received so far */
+} Remote_range_t;
+#endif
+
+
+/******************************************************************************
+MODULE: is_remote_file
+
+PURPOSE: Determines if the file is a remote file, named by a URL.
+
+RETURN VALUE:
+Type = bool
+Value        Description
+-----        -----------
+true         The file is named by an http://, https://, or s3:// URL
+false        The file is a local file
+
+NOTES:
+*****************************************************************************/
+bool is_remote_file
+(
+    const char *file_name    /* I: name of the file */
+)
+{
+    return (!strncmp (file_name, "http://", 7) ||
+            !strncmp (file_name, "https://", 8) ||
+            !strncmp (file_name, "s3://", 5));
+}
+
+
+#ifdef HAVE_LIBCURL
+/******************************************************************************
+MODULE: remote_env
+
+PURPOSE: Returns the value of an environment variable overriding a default
+of the remote reads or uploads.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+>0           Value of the variable, or the default if the variable isn't set
+             to a positive number
+
+NOTES:
+*****************************************************************************/
+int remote_env
+(
+    const char *name,        /* I: name of the environment variable */
+    int default_value        /* I: value if the variable isn't set */
+)
+{
+    char *env = NULL;        /* value of the environment variable */
+    int value;               /* value of the variable */
+
+    env = getenv (name);
+    if (env == NULL)
+        return default_value;
+    value = atoi (env);
+    return (value > 0) ? value : default_value;
+}
+
+
+/******************************************************************************
+MODULE: init_remote_library
+
+PURPOSE: Initializes libcurl for the process.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+*****************************************************************************/
+static void init_remote_library (void)
+{
+    curl_global_init (CURL_GLOBAL_DEFAULT);
+}
+
+
+/******************************************************************************
+MODULE: espa_remote_init
+
+PURPOSE: Initializes libcurl for the process, the first time it is called.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+*****************************************************************************/
+void espa_remote_init (void)
+{
+    pthread_once (&remote_init_once, init_remote_library);
+}
+
+
+/******************************************************************************
+MODULE: resolve_remote_url
+
+PURPOSE: Determines the http(s) URL of a remote file, and whether the
+requests need to be signed for S3.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        The URL is too long
+SUCCESS      The URL was determined
+
+NOTES:
+  1. See espa_remote.h for the URLs of the S3 objects.
+*****************************************************************************/
+int resolve_remote_url
+(
+    const char *file_name,   /* I: URL of the remote file */
+    char *url,               /* O: http(s) URL of the file; STR_SIZE */
+    bool *sign               /* O: are the requests signed for S3? */
+)
+{
+    char FUNC_NAME[] = "resolve_remote_url"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    char bucket[STR_SIZE];   /* name of the S3 bucket */
+    const char *key = NULL;  /* key of the S3 object */
+    char *endpoint = NULL;   /* S3 endpoint */
+    int count;               /* number of chars copied in snprintf */
+
+    *sign = false;
+    if (strncmp (file_name, "s3://", 5))
+        count = snprintf (url, STR_SIZE, "%s", file_name);
+    else
+    {
+        key = strchr (file_name + 5, '/');
+        if (key == NULL || key - (file_name + 5) >= sizeof (bucket))
+        {
+            sprintf (errmsg, "Invalid S3 URL: %s", file_name);
+            error_handler (true, FUNC_NAME, errmsg);
+            return ERROR;
+        }
+        strncpy (bucket, file_name + 5, key - (file_name + 5));
+        bucket[key - (file_name + 5)] = '\0';
+
+        endpoint = getenv (ESPA_S3_ENDPOINT_ENV);
+        if (endpoint != NULL)
+            count = snprintf (url, STR_SIZE, "%s/%s%s", endpoint, bucket,
+                key);
+        else
+            count = snprintf (url, STR_SIZE, "https://%s.s3.amazonaws.com%s",
+                bucket, key);
+        *sign = (getenv ("AWS_ACCESS_KEY_ID") != NULL &&
+            getenv ("AWS_SECRET_ACCESS_KEY") != NULL);
+    }
+    if (count < 0 || count >= STR_SIZE)
+    {
+        sprintf (errmsg, "Overflow of the URL of the remote file");
+        error_handler (true, FUNC_NAME, errmsg);
+        return ERROR;
+    }
+
+    return SUCCESS;
+}
+
+
+/******************************************************************************
+MODULE: new_remote_handle
+
+PURPOSE: Creates a libcurl handle for the requests of a remote file (or of
+an upload).
+
+RETURN VALUE:
+Type = CURL *
+Value        Description
+-----        -----------
+NULL         Error creating the handle
+non-NULL     The handle; free with curl_easy_cleanup and free the headers
+             with curl_slist_free_all
+
+NOTES:
+  1. Each handle keeps its connection open between requests.
+  2. Signing requires libcurl 7.75.  With older versions the requests are
+     sent unsigned, which works for public buckets.
+*****************************************************************************/
+CURL *new_remote_handle
+(
+    const char *url,                /* I: http(s) URL of the file */
+    bool sign,                      /* I: are the requests signed for S3? */
+    struct curl_slist **headers     /* O: extra headers of the requests */
+)
+{
+    CURL *curl = NULL;       /* libcurl handle */
+#if LIBCURL_VERSION_NUM >= 0x074b00
+    char sigv4[STR_SIZE];    /* provider of the signature */
+    char userpwd[STR_SIZE];  /* access key and secret key */
+    char token[STR_SIZE];    /* header with the session token */
+    char *region = NULL;     /* AWS region */
+#endif
+
+    *headers = NULL;
+    curl = curl_easy_init ();
+    if (curl == NULL)
+        return NULL;
+
+    curl_easy_setopt (curl, CURLOPT_URL, url);
+    curl_easy_setopt (curl, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt (curl, CURLOPT_FOLLOWLOCATION, 1L);
+    curl_easy_setopt (curl, CURLOPT_FAILONERROR, 1L);
+    curl_easy_setopt (curl, CURLOPT_CONNECTTIMEOUT, 30L);
+    curl_easy_setopt (curl, CURLOPT_LOW_SPEED_LIMIT, 1024L);
+    curl_easy_setopt (curl, CURLOPT_LOW_SPEED_TIME, 60L);
+
+#if LIBCURL_VERSION_NUM >= 0x074b00
+    if (sign)
+    {
+        region = getenv ("AWS_REGION");
+        if (region == NULL)
+            region = getenv ("AWS_DEFAULT_REGION");
+        snprintf (sigv4, sizeof (sigv4), "aws:amz:%s:s3",
+            region != NULL ? region : "us-east-1");
+        snprintf (userpwd, sizeof (userpwd), "%s:%s",
+            getenv ("AWS_ACCESS_KEY_ID"), getenv ("AWS_SECRET_ACCESS_KEY"));
+        curl_easy_setopt (curl, CURLOPT_AWS_SIGV4, sigv4);
+        curl_easy_setopt (curl, CURLOPT_USERPWD, userpwd);
+        if (getenv ("AWS_SESSION_TOKEN") != NULL)
+        {
+            snprintf (token, sizeof (token), "x-amz-security-token: %s",
+                getenv ("AWS_SESSION_TOKEN"));
+            *headers = curl_slist_append (*headers, token);
+            curl_easy_setopt (curl, CURLOPT_HTTPHEADER, *headers);
+        }
+    }
+#endif
+
+    return curl;
+}
+
+
+/******************************************************************************
+MODULE: remote_write_callback
+
+PURPOSE: Receives the bytes of a range request.
+
+RETURN VALUE:
+Type = size_t
+Value        Description
+-----        -----------
+n            Number of bytes taken; less than were passed if the server sent
+             more than the range, which fails the request
+
+NOTES:
+*****************************************************************************/
+static size_t remote_write_callback
+(
+    char *data,              /* I: bytes received */
+    size_t size,             /* I: size of each item */
+    size_t nitems,           /* I: number of items */
+    void *userdata           /* I/O: range being received */
+)
+{
+    Remote_range_t *range = (Remote_range_t *) userdata;
+    size_t nbytes = size * nitems;  /* number of bytes received */
+
+    if (nbytes > range->nbytes - range->filled)
+        return 0;
+    memcpy (range->buf + range->filled, data, nbytes);
+    range->filled += nbytes;
+    return nbytes;
+}
+
+
+/******************************************************************************
+MODULE: fetch_remote_range
+
+PURPOSE: Downloads a range of bytes of a remote file.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error downloading the range
+SUCCESS      The range was downloaded
+
+NOTES:
+  1. The request is attempted ESPA_REMOTE_RETRIES times, waiting longer
+     after each failure.
+*****************************************************************************/
+static int fetch_remote_range
+(
+    CURL *curl,              /* I: libcurl handle of the remote file */
+    Espa_remote_t *remote,   /* I: remote file */
+    off_t offset,            /* I: offset of the first byte */
+    size_t nbytes,           /* I: number of bytes in the range */
+    char *buf                /* O: bytes of the range */
+)
+{
+    char FUNC_NAME[] = "fetch_remote_range"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    char range_str[STR_SIZE];  /* range of the request */
+    int attempt;             /* current attempt of the request */
+    CURLcode res = CURLE_OK; /* result of the request */
+    Remote_range_t range;    /* bytes being received */
+
+    snprintf (range_str, sizeof (range_str), "%lld-%lld",
+        (long long) offset, (long long) offset + (long long) nbytes - 1);
+    curl_easy_setopt (curl, CURLOPT_RANGE, range_str);
+    curl_easy_setopt (curl, CURLOPT_WRITEFUNCTION, remote_write_callback);
+    curl_easy_setopt (curl, CURLOPT_WRITEDATA, &range);
+
+    for (attempt = 0; attempt < ESPA_REMOTE_RETRIES; attempt++)
+    {
+        if (attempt > 0)
+            usleep (250000 << attempt);
+
+        range.buf = buf;
+        range.nbytes = nbytes;
+        range.filled = 0;
+        res = curl_easy_perform (curl);
+        if (res == CURLE_OK && range.filled == nbytes)
+            return SUCCESS;
+    }
+
+    snprintf (errmsg, sizeof (errmsg), "Reading bytes %s of %s: %s",
+        range_str, remote->url, res != CURLE_OK ? curl_easy_strerror (res)
+        : "short read");
+    error_handler (true, FUNC_NAME, errmsg);
+    return ERROR;
+}
+
+
+/******************************************************************************
+MODULE: get_remote_size
+
+PURPOSE: Gets the number of bytes in a remote file.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error getting the size
+SUCCESS      The size was set
+
+NOTES:
+*****************************************************************************/
+static int get_remote_size
+(
+    Espa_remote_t *remote    /* I/O: remote file; nbytes is set */
+)
+{
+    char FUNC_NAME[] = "get_remote_size"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    int attempt;             /* current attempt of the request */
+    curl_off_t length = -1;  /* content length of the file */
+    CURL *curl = NULL;       /* libcurl handle */
+    CURLcode res = CURLE_OK; /* result of the request */
+    struct curl_slist *headers = NULL;  /* extra headers of the request */
+
+    curl = new_remote_handle (remote->url, remote->sign, &headers);
+    if (curl == NULL)
+    {
+        sprintf (errmsg, "Creating the connection to the remote file");
+        error_handler (true, FUNC_NAME, errmsg);
+        return ERROR;
+    }
+    curl_easy_setopt (curl, CURLOPT_NOBODY, 1L);
+
+    for (attempt = 0; attempt < ESPA_REMOTE_RETRIES; attempt++)
+    {
+        if (attempt > 0)
+            usleep (250000 << attempt);
+        res = curl_easy_perform (curl);
+        if (res == CURLE_OK)
+        {
+            curl_easy_getinfo (curl, CURLINFO_CONTENT_LENGTH_DOWNLOAD_T,
+                &length);
+            break;
+        }
+    }
+    curl_easy_cleanup (curl);
+    curl_slist_free_all (headers);
+
+    if (res != CURLE_OK || length < 0)
+    {
+        snprintf (errmsg, sizeof (errmsg), "Getting the size of %s: %s",
+            remote->url, res != CURLE_OK ? curl_easy_strerror (res)
+            : "no content length");
+        error_handler (true, FUNC_NAME, errmsg);
+        return ERROR;
+    }
+
+    remote->nbytes = (off_t) length;
+    return SUCCESS;
+}
+
+
+/******************************************************************************
+MODULE: make_remote_room
+
+PURPOSE: Makes room in the cache of the blocks of a remote file for another
+block, dropping the least recently used block if the cache is full.
+
+RETURN VALUE:
+Type = bool
+Value        Description
+-----        -----------
+true         There is room for another block
+false        The cache is full of blocks which are being fetched or read
+
+NOTES:
+  1. The mutex of the remote file needs to be held.
+*****************************************************************************/
+static bool make_remote_room
+(
+    Espa_remote_t *remote    /* I/O: remote file */
+)
+{
+    int b;                   /* looping variable for the blocks */
+    int oldest = -1;         /* least recently used block */
+    Espa_remote_block_t *block = NULL;  /* current block */
+
+    if (remote->ncached < remote->cache_blocks)
+        return true;
+
+    for (b = 0; b < remote->nblocks; b++)
+    {
+        block = &remote->blocks[b];
+        if (block->state == REMOTE_BLOCK_READY && block->readers == 0 &&
+            (oldest == -1 ||
+             block->last_use < remote->blocks[oldest].last_use))
+            oldest = b;
+    }
+    if (oldest == -1)
+        return false;
+
+    block = &remote->blocks[oldest];
+    free (block->buf);
+    block->buf = NULL;
+    block->state = REMOTE_BLOCK_EMPTY;
+    remote->ncached--;
+    return true;
+}
+
+
+/******************************************************************************
+MODULE: request_remote_block
+
+PURPOSE: Queues a block of a remote file to be fetched, unless it is already
+queued, being fetched, or held.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. The mutex of the remote file needs to be held.
+  2. The blocks a read waits for go to the head of the queue and are queued
+     even if the cache is full.  The blocks read ahead go to the tail of the
+     queue, and only if there is room for them.
+*****************************************************************************/
+static void request_remote_block
+(
+    Espa_remote_t *remote,   /* I/O: remote file */
+    int b,                   /* I: block to be fetched */
+    bool wait                /* I: is a read waiting for the block? */
+)
+{
+    Espa_remote_block_t *block = &remote->blocks[b];  /* requested block */
+
+    if (block->state != REMOTE_BLOCK_EMPTY &&
+        block->state != REMOTE_BLOCK_FAILED)
+        return;
+    if (!make_remote_room (remote) && !wait)
+        return;
+
+    block->state = REMOTE_BLOCK_QUEUED;
+    remote->ncached++;
+    if (wait)
+    {
+        remote->queue_head = (remote->queue_head + remote->nblocks - 1) %
+            remote->nblocks;
+        remote->queue[remote->queue_head] = b;
+    }
+    else
+        remote->queue[(remote->queue_head + remote->queue_count) %
+            remote->nblocks] = b;
+    remote->queue_count++;
+    pthread_cond_broadcast (&remote->cond);
+}
+
+
+/******************************************************************************
+MODULE: remote_fetch_thread
+
+PURPOSE: Fetches the queued blocks of a remote file until the file is closed.
+
+RETURN VALUE:
+Type = void *
+Value        Description
+-----        -----------
+NULL         Always
+
+NOTES:
+  1. The blocks which fail to download are marked as failed, which fails the
+     reads waiting for them.
+*****************************************************************************/
+static void *remote_fetch_thread
+(
+    void *arg                /* I: remote file */
+)
+{
+    Espa_remote_t *remote = (Espa_remote_t *) arg;  /* remote file */
+    Espa_remote_block_t *block = NULL;  /* block being fetched */
+    CURL *curl = NULL;       /* libcurl handle of this thread */
+    struct curl_slist *headers = NULL;  /* extra headers of the requests */
+    char *buf = NULL;        /* bytes of the block being fetched */
+    off_t offset;            /* offset of the block */
+    size_t nbytes;           /* number of bytes in the block */
+    int b;                   /* block being fetched */
+    int status;              /* status of the download */
+
+    curl = new_remote_handle (remote->url, remote->sign, &headers);
+
+    pthread_mutex_lock (&remote->mutex);
+    while (1)
+    {
+        while (!remote->done && remote->queue_count == 0)
+            pthread_cond_wait (&remote->cond, &remote->mutex);
+        if (remote->done)
+            break;
+
+        b = remote->queue[remote->queue_head];
+        remote->queue_head = (remote->queue_head + 1) % remote->nblocks;
+        remote->queue_count--;
+        block = &remote->blocks[b];
+        if (block->state != REMOTE_BLOCK_QUEUED)
+            continue;
+        block->state = REMOTE_BLOCK_FETCHING;
+        pthread_mutex_unlock (&remote->mutex);
+
+        /* Download the block */
+        offset = (off_t) b * remote->block_bytes;
+        nbytes = remote->block_bytes;
+        if ((off_t) nbytes > remote->nbytes - offset)
+            nbytes = remote->nbytes - offset;
+        buf = malloc (nbytes);
+        status = ERROR;
+        if (buf != NULL && curl != NULL)
+            status = fetch_remote_range (curl, remote, offset, nbytes, buf);
+
+        pthread_mutex_lock (&remote->mutex);
+        if (status == SUCCESS)
+        {
+            block->buf = buf;
+            block->state = REMOTE_BLOCK_READY;
+            block->last_use = remote->clock;
+        }
+        else
+        {
+            free (buf);
+            block->state = REMOTE_BLOCK_FAILED;
+            remote->ncached--;
+        }
+        pthread_cond_broadcast (&remote->cond);
+    }
+    pthread_mutex_unlock (&remote->mutex);
+
+    if (curl != NULL)
+        curl_easy_cleanup (curl);
+    curl_slist_free_all (headers);
+    return NULL;
+}
+#endif
+
+
+/******************************************************************************
+MODULE: open_remote_file
+
+PURPOSE: Opens a remote file for reading, and starts the threads which fetch
+its blocks.
+
+RETURN VALUE:
+Type = Espa_remote_t *
+Value        Description
+-----        -----------
+NULL         Error opening the remote file
+non-NULL     The remote file; close with close_remote_file
+
+NOTES:
+  1. Nothing is downloaded until the file is read, other than its size.
+*****************************************************************************/
+Espa_remote_t *open_remote_file
+(
+    const char *file_name    /* I: URL of the remote file */
+)
+{
+    char FUNC_NAME[] = "open_remote_file"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+#ifdef HAVE_LIBCURL
+    int i;                   /* looping variable for the threads */
+    int nthreads;            /* number of fetching threads */
+    Espa_remote_t *remote = NULL;  /* remote file */
+
+    espa_remote_init ();
+
+    remote = calloc (1, sizeof (Espa_remote_t));
+    if (remote == NULL)
+    {
+        sprintf (errmsg, "Allocating memory for the remote file");
+        error_handler (true, FUNC_NAME, errmsg);
+        return NULL;
+    }
+    if (resolve_remote_url (file_name, remote->url, &remote->sign)
+        != SUCCESS ||
+        get_remote_size (remote) != SUCCESS)
+    {
+        snprintf (errmsg, sizeof (errmsg), "Opening the remote file %s",
+            file_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        free (remote);
+        return NULL;
+    }
+
+    /* Split the file into blocks */
+    remote->block_bytes = (size_t) remote_env (ESPA_REMOTE_BLOCK_KB_ENV,
+        ESPA_REMOTE_DEFAULT_BLOCK_KB) * 1024;
+    remote->nblocks = (remote->nbytes + remote->block_bytes - 1) /
+        remote->block_bytes;
+    remote->prefetch = remote_env (ESPA_REMOTE_PREFETCH_ENV,
+        ESPA_REMOTE_DEFAULT_PREFETCH);
+    remote->cache_blocks = espa_mem_cache_bytes ((size_t) remote_env
+        (ESPA_REMOTE_CACHE_MB_ENV, ESPA_REMOTE_DEFAULT_CACHE_MB) * 1048576) /
+        remote->block_bytes;
+    if (remote->cache_blocks < 1)
+        remote->cache_blocks = 1;
+    nthreads = remote_env (ESPA_REMOTE_CONNECTIONS_ENV,
+        ESPA_REMOTE_DEFAULT_CONNECTIONS);
+    nthreads = espa_mem_fit_count (remote->block_bytes, nthreads, 1);
+    if (nthreads > remote->nblocks)
+        nthreads = remote->nblocks;
+
+    remote->blocks = calloc (remote->nblocks + 1,
+        sizeof (Espa_remote_block_t));
+    remote->queue = calloc (remote->nblocks + 1, sizeof (int));
+    remote->threads = calloc (nthreads + 1, sizeof (pthread_t));
+    if (remote->blocks == NULL || remote->queue == NULL ||
+        remote->threads == NULL)
+    {
+        sprintf (errmsg, "Allocating memory for the blocks of the remote "
+            "file");
+        error_handler (true, FUNC_NAME, errmsg);
+        free (remote->blocks);
+        free (remote->queue);
+        free (remote->threads);
+        free (remote);
+        return NULL;
+    }
+
+    /* Start the fetching threads */
+    pthread_mutex_init (&remote->mutex, NULL);
+    pthread_cond_init (&remote->cond, NULL);
+    for (i = 0; i < nthreads; i++)
+    {
+        if (pthread_create (&remote->threads[i], NULL, remote_fetch_thread,
+            remote) != 0)
+            break;
+        remote->nthreads++;
+    }
+    if (remote->nthreads == 0 && remote->nblocks > 0)
+    {
+        sprintf (errmsg, "Starting the threads fetching the remote file");
+        error_handler (true, FUNC_NAME, errmsg);
+        close_remote_file (remote);
+        return NULL;
+    }
+
+    return remote;
+#else
+    snprintf (errmsg, sizeof (errmsg), "Reading the remote file %s requires "
+        "the library to be built with ENABLE_REMOTE=yes", file_name);
+    error_handler (true, FUNC_NAME, errmsg);
+    return NULL;
+#endif
+}
+
+
+/******************************************************************************
+MODULE: read_remote_file
+
+PURPOSE: Reads a range of bytes of a remote file.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error reading the remote file
+SUCCESS      The bytes were read
+
+NOTES:
+  1. The blocks covering the range are fetched (if they aren't held
+     already) ahead of any other block, and the blocks following the range
+     are queued to be read ahead.
+  2. Any number of threads may read the same remote file.
+*****************************************************************************/
+int read_remote_file
+(
+    Espa_remote_t *remote,   /* I: remote file */
+    off_t offset,            /* I: offset of the first byte to be read */
+    size_t nbytes,           /* I: number of bytes to be read; they need to
+                                   be within the file */
+    void *buf                /* O: bytes read */
+)
+{
+    char FUNC_NAME[] = "read_remote_file"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+#ifdef HAVE_LIBCURL
+    int b;                   /* looping variable for the blocks */
+    int first;               /* first block of the range */
+    int last;                /* last block of the range */
+    int status = SUCCESS;    /* status of the read */
+    off_t block_offset;      /* offset of the current block */
+    off_t start;             /* first byte of the range in the block */
+    off_t end;               /* byte after the range in the block */
+    Espa_remote_block_t *block = NULL;  /* current block */
+
+    if (nbytes == 0)
+        return SUCCESS;
+    if (offset < 0 || offset + (off_t) nbytes > remote->nbytes)
+    {
+        snprintf (errmsg, sizeof (errmsg), "Reading past the end of %s",
+            remote->url);
+        error_handler (true, FUNC_NAME, errmsg);
+        return ERROR;
+    }
+
+    first = offset / remote->block_bytes;
+    last = (offset + nbytes - 1) / remote->block_bytes;
+
+    pthread_mutex_lock (&remote->mutex);
+
+    /* Queue the blocks of the range first, in order, then the blocks to be
+       read ahead */
+    for (b = last; b >= first; b--)
+        request_remote_block (remote, b, true);
+    for (b = last + 1; b <= last + remote->prefetch && b < remote->nblocks;
+        b++)
+        request_remote_block (remote, b, false);
+
+    /* Copy the range out of each block as it arrives */
+    for (b = first; b <= last; b++)
+    {
+        block = &remote->blocks[b];
+        while (block->state != REMOTE_BLOCK_READY)
+        {
+            if (block->state == REMOTE_BLOCK_FAILED)
+            {
+                /* Let a later read try the block again */
+                block->state = REMOTE_BLOCK_EMPTY;
+                status = ERROR;
+                break;
+            }
+            if (block->state == REMOTE_BLOCK_EMPTY)
+                request_remote_block (remote, b, true);  /* it was dropped */
+            pthread_cond_wait (&remote->cond, &remote->mutex);
+        }
+        if (status != SUCCESS)
+            break;
+
+        block->readers++;
+        block->last_use = ++remote->clock;
+        pthread_mutex_unlock (&remote->mutex);
+
+        block_offset = (off_t) b * remote->block_bytes;
+        start = (offset > block_offset) ? offset - block_offset : 0;
+        end = offset + nbytes - block_offset;
+        if (end > (off_t) remote->block_bytes)
+            end = remote->block_bytes;
+        memcpy ((char *) buf + (block_offset + start - offset),
+            block->buf + start, end - start);
+
+        pthread_mutex_lock (&remote->mutex);
+        block->readers--;
+    }
+
+    pthread_mutex_unlock (&remote->mutex);
+
+    if (status != SUCCESS)
+    {
+        snprintf (errmsg, sizeof (errmsg), "Reading %zu bytes at offset %lld "
+            "of %s", nbytes, (long long) offset, remote->url);
+        error_handler (true, FUNC_NAME, errmsg);
+        return ERROR;
+    }
+
+    return SUCCESS;
+#else
+    sprintf (errmsg, "Reading remote files requires the library to be built "
+        "with ENABLE_REMOTE=yes");
+    error_handler (true, FUNC_NAME, errmsg);
+    return ERROR;
+#endif
+}
+
+
+/******************************************************************************
+MODULE: close_remote_file
+
+PURPOSE: Stops the threads fetching the blocks of a remote file and frees
+the remote file.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+*****************************************************************************/
+void close_remote_file
+(
+    Espa_remote_t *remote    /* I: remote file to be closed */
+)
+{
+#ifdef HAVE_LIBCURL
+    int i;                   /* looping variable */
+
+    if (remote == NULL)
+        return;
+
+    pthread_mutex_lock (&remote->mutex);
+    remote->done = true;
+    pthread_cond_broadcast (&remote->cond);
+    pthread_mutex_unlock (&remote->mutex);
+    for (i = 0; i < remote->nthreads; i++)
+        pthread_join (remote->threads[i], NULL);
+
+    for (i = 0; i < remote->nblocks; i++)
+        free (remote->blocks[i].buf);
+    pthread_mutex_destroy (&remote->mutex);
+    pthread_cond_destroy (&remote->cond);
+    free (remote->blocks);
+    free (remote->queue);
+    free (remote->threads);
+    free (remote);
+#endif
+}
+
+
+/******************************************************************************
+MODULE: read_remote_file_all
+
+PURPOSE: Reads a whole remote file into memory.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error reading the remote file
+SUCCESS      The file was read
+
+NOTES:
+  1. Meant for the small files, such as the metadata files of a product.
+     The blocks of the file are still fetched concurrently.
+*****************************************************************************/
+int read_remote_file_all
+(
+    const char *file_name,   /* I: URL of the remote file */
+    char **buf,              /* O: bytes of the file, followed by a 0 byte;
+                                   free when done */
+    size_t *nbytes           /* O: number of bytes in the file */
+)
+{
+    char FUNC_NAME[] = "read_remote_file_all"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    Espa_remote_t *remote = NULL;  /* remote file */
+
+    *buf = NULL;
+    remote = open_remote_file (file_name);
+    if (remote == NULL)
+        return ERROR;   /* error message already written */
+
+    *nbytes = remote->nbytes;
+    *buf = malloc (*nbytes + 1);
+    if (*buf == NULL)
+    {
+        snprintf (errmsg, sizeof (errmsg), "Allocating memory for %s",
+            file_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        close_remote_file (remote);
+        return ERROR;
+    }
+    if (read_remote_file (remote, 0, *nbytes, *buf) != SUCCESS)
+    {
+        snprintf (errmsg, sizeof (errmsg), "Reading %s", file_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        close_remote_file (remote);
+        free (*buf);
+        *buf = NULL;
+        return ERROR;
+    }
+    (*buf)[*nbytes] = '\0';
+
+    close_remote_file (remote);
+    return SUCCESS;
+}
+
+
+/******************************************************************************
+MODULE: copy_remote_file
+
+PURPOSE: Copies a remote file to a local file.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error copying the remote file
+SUCCESS      The file was copied
+
+NOTES:
+  1. Meant for the small files which are read by name, such as the metadata
+     files of a product.
+*****************************************************************************/
+int copy_remote_file
+(
+    const char *file_name,   /* I: URL of the remote file */
+    const char *local_file   /* I: name of the local copy to be written */
+)
+{
+    char FUNC_NAME[] = "copy_remote_file"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    char *buf = NULL;        /* bytes of the file */
+    size_t nbytes;           /* number of bytes in the file */
+    FILE *fptr = NULL;       /* local file */
+    int status = SUCCESS;    /* status of the copy */
+
+    if (read_remote_file_all (file_name, &buf, &nbytes) != SUCCESS)
+        return ERROR;   /* error message already written */
+
+    fptr = fopen (local_file, "w");
+    if (fptr == NULL || fwrite (buf, 1, nbytes, fptr) != nbytes)
+        status = ERROR;
+    if (fptr != NULL && fclose (fptr) != 0)
+        status = ERROR;
+    free (buf);
+
+    if (status != SUCCESS)
+    {
+        snprintf (errmsg, sizeof (errmsg), "Writing %s to %s", file_name,
+            local_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return ERROR;
+    }
+
+    return SUCCESS;
+}
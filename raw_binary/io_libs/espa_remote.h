@@ -0,0 +1,168 @@
+/*****************************************************************************
+FILE: espa_remote.h
+
+PURPOSE: Contains defines and structures for reading input files from object
+storage (S3) or HTTP servers with byte range requests, a block at a time, so
+only the parts of a file which are read are downloaded.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The remote files are named by URLs: http://, https://, or s3://bucket/key.
+     The S3 objects are read from https://bucket.s3.amazonaws.com/key, or
+     from $ESPA_S3_ENDPOINT/bucket/key if that environment variable is set.
+     If AWS_ACCESS_KEY_ID and AWS_SECRET_ACCESS_KEY are set, the requests are
+     signed (AWS signature version 4, with AWS_SESSION_TOKEN if it is set).
+  2. Reading remote files is only available if the library was built with
+     ENABLE_REMOTE=yes (which defines HAVE_LIBCURL).
+  3. The file is split into blocks of ESPA_REMOTE_BLOCK_KB which are fetched
+     by ESPA_REMOTE_CONNECTIONS threads, each with its own connection.  Every
+     read also queues the ESPA_REMOTE_PREFETCH blocks which follow it, and at
+     most ESPA_REMOTE_CACHE_MB of blocks are held; the least recently used
+     blocks are dropped first.  With a memory budget (see espa_trace.h), the
+     cache is capped at its share of the budget, and there are no more
+     connections than blocks in flight fit in the memory left.
+*****************************************************************************/
+
+#ifndef ESPA_REMOTE_H
+#define ESPA_REMOTE_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <sys/types.h>
+#ifdef HAVE_LIBCURL
+#include <curl/curl.h>
+#endif
+#include "error_handler.h"
+
+/* Environment variables overriding the defaults of the remote reads */
+#define ESPA_REMOTE_CONNECTIONS_ENV "ESPA_REMOTE_CONNECTIONS"
+#define ESPA_REMOTE_PREFETCH_ENV "ESPA_REMOTE_PREFETCH"
+#define ESPA_REMOTE_BLOCK_KB_ENV "ESPA_REMOTE_BLOCK_KB"
+#define ESPA_REMOTE_CACHE_MB_ENV "ESPA_REMOTE_CACHE_MB"
+#define ESPA_S3_ENDPOINT_ENV "ESPA_S3_ENDPOINT"
+
+/* Defaults of the remote reads */
+#define ESPA_REMOTE_DEFAULT_CONNECTIONS 8  /* concurrent range requests */
+#define ESPA_REMOTE_DEFAULT_PREFETCH 8     /* blocks read ahead */
+#define ESPA_REMOTE_DEFAULT_BLOCK_KB 1024  /* size of a range request */
+#define ESPA_REMOTE_DEFAULT_CACHE_MB 256   /* memory for the blocks */
+#define ESPA_REMOTE_RETRIES 3              /* attempts of each request */
+
+/* State of a block of a remote file */
+typedef enum {
+  REMOTE_BLOCK_EMPTY,      /* not requested (or dropped from the cache) */
+  REMOTE_BLOCK_QUEUED,     /* waiting for a connection */
+  REMOTE_BLOCK_FETCHING,   /* being downloaded */
+  REMOTE_BLOCK_READY,      /* downloaded */
+  REMOTE_BLOCK_FAILED      /* the download failed */
+} Espa_remote_block_state_t;
+
+/* Block of a remote file */
+typedef struct
+{
+    Espa_remote_block_state_t state;  /* state of the block */
+    char *buf;               /* bytes of the block; NULL unless the block is
+                                fetching or ready */
+    int readers;             /* number of reads copying out of buf, which
+                                keep the block from being dropped */
+    unsigned long last_use;  /* clock of the last read of the block */
+} Espa_remote_block_t;
+
+/* Remote file being read */
+typedef struct
+{
+    char url[STR_SIZE];      /* http(s) URL of the file */
+    bool sign;               /* are the requests signed for S3? */
+    off_t nbytes;            /* number of bytes in the file */
+    size_t block_bytes;      /* number of bytes in each block */
+    int nblocks;             /* number of blocks in the file */
+    int prefetch;            /* number of blocks read ahead */
+    int cache_blocks;        /* most blocks held at a time */
+    int ncached;             /* number of blocks queued, fetching, or ready */
+    unsigned long clock;     /* clock of the reads, for dropping the least
+                                recently used blocks */
+    Espa_remote_block_t *blocks;  /* the nblocks blocks */
+    int *queue;              /* circular queue of the blocks to be fetched;
+                                the blocks being waited for are at the head,
+                                the blocks read ahead at the tail */
+    int queue_head;          /* index of the first block in the queue */
+    int queue_count;         /* number of blocks in the queue */
+    int nthreads;            /* number of fetching threads */
+    pthread_t *threads;      /* fetching threads */
+    pthread_mutex_t mutex;   /* guards the blocks and the queue */
+    pthread_cond_t cond;     /* signaled when the queue or a block changes */
+    bool done;               /* should the fetching threads exit? */
+} Espa_remote_t;
+
+/* Prototypes */
+bool is_remote_file
+(
+    const char *file_name    /* I: name of the file */
+);
+
+Espa_remote_t *open_remote_file
+(
+    const char *file_name    /* I: URL of the remote file */
+);
+
+int read_remote_file
+(
+    Espa_remote_t *remote,   /* I: remote file */
+    off_t offset,            /* I: offset of the first byte to be read */
+    size_t nbytes,           /* I: number of bytes to be read; they need to
+                                   be within the file */
+    void *buf                /* O: bytes read */
+);
+
+void close_remote_file
+(
+    Espa_remote_t *remote    /* I: remote file to be closed */
+);
+
+int read_remote_file_all
+(
+    const char *file_name,   /* I: URL of the remote file */
+    char **buf,              /* O: bytes of the file, followed by a 0 byte;
+                                   free when done */
+    size_t *nbytes           /* O: number of bytes in the file */
+);
+
+int copy_remote_file
+(
+    const char *file_name,   /* I: URL of the remote file */
+    const char *local_file   /* I: name of the local copy to be written */
+);
+
+#ifdef HAVE_LIBCURL
+/* Shared with the uploads (see espa_upload.h) */
+int remote_env
+(
+    const char *name,        /* I: name of the environment variable */
+    int default_value        /* I: value if the variable isn't set */
+);
+
+void espa_remote_init (void);
+
+int resolve_remote_url
+(
+    const char *file_name,   /* I: URL of the remote file */
+    char *url,               /* O: http(s) URL of the file; STR_SIZE */
+    bool *sign               /* O: are the requests signed for S3? */
+);
+
+CURL *new_remote_handle
+(
+    const char *url,                /* I: http(s) URL of the file */
+    bool sign,                      /* I: are the requests signed for S3? */
+    struct curl_slist **headers     /* O: extra headers of the requests */
+);
+#endif
+
+#endif
@@ -0,0 +1,477 @@
+/*****************************************************************************
+FILE: espa_shm.c
+
+PURPOSE: Contains functions for placing the raw binary bands of a product in
+shared memory, handing them from one tool to the next, and writing them to
+disk at the end of the chain.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The names are resolved by espa_staging_path, which every raw binary
+     routine opens its files through.
+*****************************************************************************/
+
+#include <unistd.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include "raw_binary_io.h"
+#include "write_metadata.h"
+#include "espa_shm.h"
+
+static pthread_once_t shm_once = PTHREAD_ONCE_INIT;
+static bool shm_on = false;            /* are the outputs written to shared
+                                          memory? */
+static char shm_dir[STR_SIZE] = ESPA_SHM_DEFAULT_DIR;  /* directory of the
+                                          segments */
+static pthread_mutex_t shm_mutex = PTHREAD_MUTEX_INITIALIZER;
+static char (*shm_files)[STR_SIZE] = NULL;  /* absolute names of the files
+                                          placed in shared memory by this
+                                          process */
+static int shm_nfiles = 0;             /* number of files in shm_files */
+static int shm_nalloc = 0;             /* number of files allocated */
+
+/******************************************************************************
+MODULE:  shm_init
+
+PURPOSE: Reads the shared-memory settings from the environment.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+static void shm_init (void)
+{
+    char *value = NULL;      /* value of an environment variable */
+    int count;               /* number of chars copied in snprintf */
+
+    value = getenv (ESPA_SHM_DIR_ENV);
+    if (value != NULL && value[0] != '\0')
+    {
+        count = snprintf (shm_dir, sizeof (shm_dir), "%s", value);
+        if (count < 0 || count >= sizeof (shm_dir))
+            strcpy (shm_dir, ESPA_SHM_DEFAULT_DIR);
+        else
+            while (count > 1 && shm_dir[count-1] == '/')
+                shm_dir[--count] = '\0';
+    }
+
+    value = getenv (ESPA_SHM_BANDS_ENV);
+    shm_on = value != NULL && !strcasecmp (value, "yes");
+}
+
+
+/******************************************************************************
+MODULE:  shm_absolute
+
+PURPOSE: Makes a file name absolute.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           The absolute name doesn't fit
+SUCCESS         Successfully made the name absolute
+
+NOTES:
+******************************************************************************/
+static int shm_absolute
+(
+    const char *file,    /* I: name of the file */
+    char *abs_file       /* O: absolute name of the file; STR_SIZE */
+)
+{
+    char cwd[STR_SIZE];      /* current working directory */
+    int count;               /* number of chars copied in snprintf */
+
+    if (file[0] == '/')
+        count = snprintf (abs_file, STR_SIZE, "%s", file);
+    else if (getcwd (cwd, sizeof (cwd)) == NULL)
+        return ERROR;
+    else
+        count = snprintf (abs_file, STR_SIZE, "%s/%s", cwd, file);
+
+    return (count < 0 || count >= STR_SIZE) ? ERROR : SUCCESS;
+}
+
+
+/******************************************************************************
+MODULE:  shm_segment_path
+
+PURPOSE: Names the segment of a file.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           The segment name doesn't fit
+SUCCESS         Successfully named the segment
+
+NOTES:
+  1. The segment is named for the absolute name of the file, with the /
+     replaced by . (see espa_shm.h).
+******************************************************************************/
+static int shm_segment_path
+(
+    const char *abs_file,  /* I: absolute name of the file */
+    char *path,            /* O: name of the segment */
+    size_t path_size       /* I: size of path */
+)
+{
+    char *cptr = NULL;     /* pointer into the segment name */
+    char *segment = NULL;  /* start of the segment name in path */
+    int count;             /* number of chars copied in snprintf */
+
+    count = snprintf (path, path_size, "%s/%s%s", shm_dir,
+        ESPA_SHM_SEGMENT_PREFIX, abs_file);
+    if (count < 0 || count >= path_size)
+        return ERROR;
+
+    segment = path + strlen (shm_dir) + 1;
+    if (strlen (segment) > NAME_MAX)
+        return ERROR;
+    for (cptr = segment; *cptr != '\0'; cptr++)
+        if (*cptr == '/')
+            *cptr = '.';
+
+    return SUCCESS;
+}
+
+
+/******************************************************************************
+MODULE:  shm_placed
+
+PURPOSE: Looks up a file among the files placed in shared memory by this
+process, optionally adding it.
+
+RETURN VALUE:
+Type = bool
+Value           Description
+-----           -----------
+true            The file is (now) in shared memory
+false           The file isn't in shared memory
+
+NOTES:
+  1. A file which can't be added is written to disk instead, with a
+     warning.
+******************************************************************************/
+static bool shm_placed
+(
+    const char *abs_file,  /* I: absolute name of the file */
+    bool add               /* I: add the file if it isn't there? */
+)
+{
+    char FUNC_NAME[] = "shm_placed";  /* function name */
+    char (*files)[STR_SIZE] = NULL;   /* resized table of the files */
+    int nalloc;            /* number of files allocated */
+    int i;                 /* looping variable for the files */
+    bool found = false;    /* was the file found (or added)? */
+
+    pthread_mutex_lock (&shm_mutex);
+    for (i = shm_nfiles - 1; i >= 0 && !found; i--)
+        found = !strcmp (shm_files[i], abs_file);
+
+    if (!found && add)
+    {
+        if (shm_nfiles == shm_nalloc)
+        {
+            nalloc = shm_nalloc > 0 ? 2 * shm_nalloc : 64;
+            files = realloc (shm_files, nalloc * sizeof (*files));
+            if (files != NULL)
+            {
+                shm_files = files;
+                shm_nalloc = nalloc;
+            }
+        }
+        if (shm_nfiles < shm_nalloc)
+        {
+            strcpy (shm_files[shm_nfiles++], abs_file);
+            found = true;
+        }
+        else
+            error_handler (false, FUNC_NAME, "Allocating the table of the "
+                "files in shared memory; the file is written to disk");
+    }
+    pthread_mutex_unlock (&shm_mutex);
+
+    return found;
+}
+
+
+/******************************************************************************
+MODULE:  espa_shm_enabled
+
+PURPOSE: Reports whether the raw binary files written are placed in shared
+memory.
+
+RETURN VALUE:
+Type = bool
+Value           Description
+-----           -----------
+true            ESPA_SHM_BANDS_ENV is yes
+false           The files are written to disk
+
+NOTES:
+******************************************************************************/
+bool espa_shm_enabled (void)
+{
+    pthread_once (&shm_once, shm_init);
+    return shm_on;
+}
+
+
+/******************************************************************************
+MODULE:  is_espa_shm_name
+
+PURPOSE: Reports whether a file name names a band in shared memory.
+
+RETURN VALUE:
+Type = bool
+Value           Description
+-----           -----------
+true            The name starts with ESPA_SHM_PREFIX
+false           The name is that of a file
+
+NOTES:
+******************************************************************************/
+bool is_espa_shm_name
+(
+    const char *file     /* I: name of the file */
+)
+{
+    return !strncmp (file, ESPA_SHM_PREFIX, strlen (ESPA_SHM_PREFIX));
+}
+
+
+/******************************************************************************
+MODULE:  espa_shm_segment
+
+PURPOSE: Finds the shared-memory segment a raw binary file is opened under,
+if it is in shared memory.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           The segment name doesn't fit
+SUCCESS         Successfully resolved the file; in_shm tells whether it is
+                in shared memory
+
+NOTES:
+  1. A file named shm: is always in shared memory.  Otherwise, when the
+     outputs are written to shared memory, a file being created is placed
+     in its segment, and a file this process placed there earlier is
+     opened from it.  Segments left by other processes under a plain name
+     are ignored.
+******************************************************************************/
+int espa_shm_segment
+(
+    const char *file,    /* I: name of the file */
+    bool create,         /* I: is the file being created? */
+    char *path,          /* O: name of its segment, if it is in shared
+                               memory */
+    size_t path_size,    /* I: size of path */
+    bool *in_shm         /* O: is the file in shared memory? */
+)
+{
+    char FUNC_NAME[] = "espa_shm_segment";  /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    char abs_file[STR_SIZE]; /* absolute name of the file */
+    char segment[STR_SIZE];  /* name of the segment */
+    const char *name = file; /* name of the file, without the prefix */
+    bool named;              /* is the file named shm:? */
+    int count;               /* number of chars copied in snprintf */
+
+    *in_shm = false;
+    pthread_once (&shm_once, shm_init);
+    named = is_espa_shm_name (file);
+    if (!named && !shm_on)
+        return SUCCESS;
+    if (named)
+        name = file + strlen (ESPA_SHM_PREFIX);
+
+    if (shm_absolute (name, abs_file) != SUCCESS ||
+        shm_segment_path (abs_file, segment, sizeof (segment)) != SUCCESS)
+    {
+        sprintf (errmsg, "Overflow of the shared-memory segment name of %s",
+            file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return ERROR;
+    }
+    if (!named && !shm_placed (abs_file, create))
+        return SUCCESS;
+
+    count = snprintf (path, path_size, "%s", segment);
+    if (count < 0 || count >= path_size)
+    {
+        sprintf (errmsg, "Overflow of the shared-memory segment name of %s",
+            file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return ERROR;
+    }
+
+    *in_shm = true;
+    return SUCCESS;
+}
+
+
+/******************************************************************************
+MODULE:  espa_shm_xml_name
+
+PURPOSE: Gives the name of a band file as it is written in the XML metadata.
+
+RETURN VALUE:
+Type = const char *
+Value           Description
+-----           -----------
+name            The name to write in the XML metadata
+
+NOTES:
+  1. A file placed in shared memory by this process is named
+     shm:<absolute file name>, so the next tool finds its segment.  Other
+     files keep their names.
+******************************************************************************/
+const char *espa_shm_xml_name
+(
+    const char *file,    /* I: name of the file */
+    char *name           /* O: name of the file in the XML metadata;
+                               STR_SIZE */
+)
+{
+    char abs_file[STR_SIZE]; /* absolute name of the file */
+    char segment[STR_SIZE];  /* name of the segment */
+    bool in_shm = false;     /* is the file in shared memory? */
+    int count = -1;          /* number of chars copied in snprintf */
+
+    if (espa_shm_enabled () && !is_espa_shm_name (file) &&
+        file[0] != '\0' &&
+        espa_shm_segment (file, false, segment, sizeof (segment), &in_shm)
+        == SUCCESS && in_shm && shm_absolute (file, abs_file) == SUCCESS)
+        count = snprintf (name, STR_SIZE, "%s%s", ESPA_SHM_PREFIX, abs_file);
+    if (count < 0 || count >= STR_SIZE)
+        snprintf (name, STR_SIZE, "%s", file);
+
+    return name;
+}
+
+
+/******************************************************************************
+MODULE:  persist_espa_shm_bands
+
+PURPOSE: Writes the bands of a product which are in shared memory to disk,
+writes the XML file naming them on disk, and removes their segments.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing a band or the XML file
+SUCCESS         Successfully wrote the bands and the XML file
+
+NOTES:
+  1. Each segment is copied to the file it is named for, and synced, and
+     the bands are renamed to the file.  Bands sharing a segment (ex. a
+     stacked file; see espa_file_stack.h) are copied once.
+  2. The segments are removed only once the XML file is written, so a
+     failure leaves either the segments or the files the XML file names.
+******************************************************************************/
+int persist_espa_shm_bands
+(
+    Espa_internal_meta_t *xml_metadata, /* I/O: metadata of the bands; the
+                                               file names are updated */
+    char *espa_xml_file    /* I: XML metadata file to be written */
+)
+{
+    char FUNC_NAME[] = "persist_espa_shm_bands";  /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    char shm_name[STR_SIZE]; /* shm: name of the current band */
+    char (*segments)[STR_SIZE] = NULL;  /* segments of the bands */
+    char *disk_file = NULL;  /* file the current band is written to */
+    int i, k;                /* looping variables for the bands */
+    int nsegments = 0;       /* number of segments copied */
+    int in_fd = -1;          /* file descriptor of the segment */
+    int out_fd = -1;         /* file descriptor of the file on disk */
+    int status = SUCCESS;    /* return status */
+    bool in_shm;             /* is the band in shared memory? */
+    struct stat statbuf;     /* status of the segment */
+    Espa_band_meta_t *bmeta = xml_metadata->band;  /* band metadata */
+
+    segments = calloc (xml_metadata->nbands + 1, sizeof (*segments));
+    if (segments == NULL)
+    {
+        sprintf (errmsg, "Allocating the shared-memory segment names");
+        error_handler (true, FUNC_NAME, errmsg);
+        return ERROR;
+    }
+
+    for (i = 0; i < xml_metadata->nbands && status == SUCCESS; i++)
+    {
+        if (!is_espa_shm_name (bmeta[i].file_name))
+            continue;
+
+        strcpy (shm_name, bmeta[i].file_name);
+        disk_file = shm_name + strlen (ESPA_SHM_PREFIX);
+        if (espa_shm_segment (shm_name, false, segments[nsegments],
+            STR_SIZE, &in_shm) != SUCCESS)
+        {  /* Error message already written */
+            status = ERROR;
+            break;
+        }
+
+        /* Copy the segment to its file */
+        status = ERROR;
+        in_fd = open (segments[nsegments], O_RDONLY);
+        if (in_fd != -1 && fstat (in_fd, &statbuf) == 0)
+        {
+            out_fd = open (disk_file, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            if (out_fd != -1 &&
+                copy_raw_binary_fd (in_fd, 0, statbuf.st_size, out_fd) ==
+                SUCCESS && fsync (out_fd) == 0)
+                status = SUCCESS;
+            if (out_fd != -1 && close (out_fd) != 0)
+                status = ERROR;
+        }
+        if (in_fd != -1)
+            close (in_fd);
+        if (status != SUCCESS)
+        {
+            sprintf (errmsg, "Writing band %s from shared memory to %s",
+                bmeta[i].name, disk_file);
+            error_handler (true, FUNC_NAME, errmsg);
+            break;
+        }
+        nsegments++;
+
+        /* Rename the bands held in the segment */
+        for (k = i; k < xml_metadata->nbands; k++)
+            if (!strcmp (bmeta[k].file_name, shm_name))
+                strcpy (bmeta[k].file_name, disk_file);
+    }
+
+    /* Publish the files, then drop the segments */
+    if (status == SUCCESS &&
+        write_metadata (xml_metadata, espa_xml_file) != SUCCESS)
+    {
+        sprintf (errmsg, "Writing the XML file %s", espa_xml_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        status = ERROR;
+    }
+    for (i = 0; i < nsegments && status == SUCCESS; i++)
+    {
+        if (unlink (segments[i]) != 0)
+        {
+            sprintf (errmsg, "Removing the shared-memory segment %s",
+                segments[i]);
+            error_handler (false, FUNC_NAME, errmsg);
+        }
+    }
+
+    free (segments);
+    return status;
+}
@@ -0,0 +1,85 @@
+/*****************************************************************************
+FILE: espa_shm.h
+
+PURPOSE: Contains defines and prototypes for handing the raw binary bands of
+a product from one tool to the next in shared memory, so a chain of tools
+run as separate processes doesn't write every intermediate band to disk and
+read it back.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. With ESPA_SHM_BANDS_ENV set to yes, the raw binary files a tool writes
+     are created as named POSIX shared-memory segments rather than on disk,
+     and the XML metadata names them shm:<absolute file name> (ex.
+     shm:/data/out/LC08_b1.img).  The segment of a file is named for its
+     absolute name, with the / replaced by . (ex. espa.data.out.LC08_b1.img).
+  2. The segments are the files of ESPA_SHM_DIR_ENV (default /dev/shm, where
+     shm_open creates them on Linux), so the raw binary routines open, read,
+     write, and map a band in shared memory just as one on disk, wherever
+     its name comes from.  A band named shm: is always read from its
+     segment, whether or not ESPA_SHM_BANDS_ENV is set, so the next tool
+     maps the bands of the previous one directly.
+  3. The segments outlive the tools, and hold memory until they are
+     removed.  At the end of the chain, espa_persist_bands (see
+     persist_espa_shm_bands) copies each segment to its file, rewrites the
+     XML metadata with the files on disk, and removes the segments.
+  4. Only the files written through the raw binary routines are placed in
+     shared memory (see espa_staging.h, which they take precedence over).
+     Other files (ex. the ENVI headers) are written to disk as before.
+*****************************************************************************/
+
+#ifndef ESPA_SHM_H
+#define ESPA_SHM_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include "error_handler.h"
+#include "espa_metadata.h"
+
+/* Defines */
+#define ESPA_SHM_PREFIX "shm:"    /* prefix of a band in shared memory */
+#define ESPA_SHM_BANDS_ENV "ESPA_SHM_BANDS"  /* set to yes to write the raw
+                                     binary files to shared memory */
+#define ESPA_SHM_DIR_ENV "ESPA_SHM_DIR"  /* directory of the segments */
+#define ESPA_SHM_DEFAULT_DIR "/dev/shm"
+#define ESPA_SHM_SEGMENT_PREFIX "espa"   /* prefix of the segment names */
+
+/* Prototypes */
+bool espa_shm_enabled (void);
+
+bool is_espa_shm_name
+(
+    const char *file     /* I: name of the file */
+);
+
+int espa_shm_segment
+(
+    const char *file,    /* I: name of the file */
+    bool create,         /* I: is the file being created? */
+    char *path,          /* O: name of its segment, if it is in shared
+                               memory */
+    size_t path_size,    /* I: size of path */
+    bool *in_shm         /* O: is the file in shared memory? */
+);
+
+const char *espa_shm_xml_name
+(
+    const char *file,    /* I: name of the file */
+    char *name           /* O: name of the file in the XML metadata;
+                               STR_SIZE */
+);
+
+int persist_espa_shm_bands
+(
+    Espa_internal_meta_t *xml_metadata, /* I/O: metadata of the bands; the
+                                               file names are updated */
+    char *espa_xml_file    /* I: XML metadata file to be written */
+);
+
+#endif
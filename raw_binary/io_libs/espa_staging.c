@@ -0,0 +1,842 @@
+/*****************************************************************************
+FILE: espa_staging.c
+
+PURPOSE: Contains functions for staging the raw binary output files in a
+local scratch directory and flushing them to their final location in the
+background.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. A single mutex protects the staged files and the queue of flushes.  It
+     isn't held while the files are copied.
+  2. The flush threads are started as files are queued.  A process forked
+     from this one (ex. a job of espa_formatter_worker) doesn't inherit the
+     threads, so it starts its own, and leaves the flushes of its parent to
+     the parent.
+*****************************************************************************/
+
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include "raw_binary_io.h"
+#include "espa_staging.h"
+#include "espa_shm.h"
+
+/* Output file being staged */
+struct Espa_staged_file
+{
+    char file[STR_SIZE];     /* absolute final name of the file */
+    char staged[STR_SIZE];   /* name of the staged copy */
+    pid_t owner;             /* process which staged the file */
+    int nwriters;            /* number of writers of the staged copy */
+    bool dirty;              /* written since it was last queued? */
+    bool queued;             /* queued or being flushed? */
+    bool flushing;           /* being flushed? */
+    struct Espa_staged_file *next;         /* next staged file */
+    struct Espa_staged_file *next_queued;  /* next file in the queue */
+};
+
+static pthread_once_t staging_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t staging_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t staging_work_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t staging_done_cond = PTHREAD_COND_INITIALIZER;
+static bool staging_on = false;        /* is staging on? */
+static char staging_dir[STR_SIZE];     /* local staging directory */
+static int staging_nflushes = ESPA_STAGING_DEFAULT_FLUSHES;
+static Espa_staged_file_t *staging_files = NULL;    /* staged files */
+static Espa_staged_file_t *staging_queue = NULL;    /* next to be flushed */
+static Espa_staged_file_t *staging_queue_tail = NULL;
+static int staging_npending = 0;       /* files queued or being flushed */
+static int staging_nfailed = 0;        /* flushes failed since the last
+                                          espa_staging_wait */
+static int staging_nthreads = 0;       /* flush threads of staging_pid */
+static pid_t staging_pid = 0;          /* process the threads belong to */
+static Espa_staged_file_t **staging_by_fd = NULL;
+static int staging_nfds = 0;
+
+static void staging_exit (void);
+
+
+/******************************************************************************
+MODULE: staging_init
+
+PURPOSE: Takes the staging directory and the number of concurrent flushes
+from the environment.  Called once.
+
+RETURN VALUE:
+Type = N/A
+
+NOTES:
+*****************************************************************************/
+static void staging_init (void)
+{
+    char FUNC_NAME[] = "staging_init";  /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    char *value = NULL;      /* value of an environment variable */
+    int count;               /* number of chars copied in snprintf */
+    struct stat statbuf;     /* status of the staging directory */
+
+    value = getenv (ESPA_STAGING_DIR_ENV);
+    if (value == NULL || value[0] == '\0')
+        return;
+
+    count = snprintf (staging_dir, sizeof (staging_dir), "%s", value);
+    while (count > 1 && staging_dir[count-1] == '/')
+        staging_dir[--count] = '\0';
+    if (count < 0 || count >= sizeof (staging_dir) ||
+        stat (staging_dir, &statbuf) != 0 || !S_ISDIR (statbuf.st_mode))
+    {
+        sprintf (errmsg, "%s isn't a directory; the output files will be "
+            "written in place", ESPA_STAGING_DIR_ENV);
+        error_handler (false, FUNC_NAME, errmsg);
+        return;
+    }
+
+    value = getenv (ESPA_STAGING_FLUSHES_ENV);
+    if (value != NULL)
+    {
+        staging_nflushes = atoi (value);
+        if (staging_nflushes < 1)
+            staging_nflushes = 1;
+        if (staging_nflushes > ESPA_STAGING_MAX_FLUSHES)
+            staging_nflushes = ESPA_STAGING_MAX_FLUSHES;
+    }
+
+    staging_on = true;
+    atexit (staging_exit);
+}
+
+
+/******************************************************************************
+MODULE: espa_staging_enabled
+
+PURPOSE: Checks whether the output files are being staged.
+
+RETURN VALUE:
+Type = bool
+Value        Description
+-----        -----------
+true         The output files are staged
+false        The output files are written in place
+
+NOTES:
+*****************************************************************************/
+bool espa_staging_enabled (void)
+{
+    pthread_once (&staging_once, staging_init);
+    return staging_on;
+}
+
+
+/******************************************************************************
+MODULE: staging_absolute
+
+PURPOSE: Makes the name of a file absolute.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        The name doesn't fit
+SUCCESS      Successfully made the name absolute
+
+NOTES:
+*****************************************************************************/
+static int staging_absolute
+(
+    const char *file,    /* I: name of the file */
+    char *abs_file       /* O: absolute name of the file; STR_SIZE */
+)
+{
+    char cwd[STR_SIZE];      /* current working directory */
+    int count;               /* number of chars copied in snprintf */
+
+    if (file[0] == '/')
+        count = snprintf (abs_file, STR_SIZE, "%s", file);
+    else if (getcwd (cwd, sizeof (cwd)) == NULL)
+        return ERROR;
+    else
+        count = snprintf (abs_file, STR_SIZE, "%s/%s", cwd, file);
+
+    return (count < 0 || count >= STR_SIZE) ? ERROR : SUCCESS;
+}
+
+
+/******************************************************************************
+MODULE: staging_find
+
+PURPOSE: Looks up a staged file by its absolute final name.  Called with the
+mutex held.
+
+RETURN VALUE:
+Type = Espa_staged_file_t *
+Value        Description
+-----        -----------
+NULL         The file isn't staged
+non-NULL     Staged file
+
+NOTES:
+*****************************************************************************/
+static Espa_staged_file_t *staging_find
+(
+    const char *abs_file     /* I: absolute final name of the file */
+)
+{
+    Espa_staged_file_t *staged;  /* staged file being compared */
+
+    for (staged = staging_files; staged != NULL; staged = staged->next)
+    {
+        if (!strcmp (staged->file, abs_file))
+            return staged;
+    }
+
+    return NULL;
+}
+
+
+/******************************************************************************
+MODULE: staging_make_dirs
+
+PURPOSE: Creates the directories of a staged copy under the staging
+directory.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error creating a directory
+SUCCESS      The directories exist
+
+NOTES:
+*****************************************************************************/
+static int staging_make_dirs
+(
+    const char *staged_file  /* I: name of the staged copy */
+)
+{
+    char dir[STR_SIZE];      /* directory being created */
+    char *slash = NULL;      /* end of the directory being created */
+
+    snprintf (dir, sizeof (dir), "%s", staged_file);
+    for (slash = strchr (dir + strlen (staging_dir) + 1, '/'); slash != NULL;
+        slash = strchr (slash + 1, '/'))
+    {
+        *slash = '\0';
+        if (mkdir (dir, 0755) != 0 && errno != EEXIST)
+            return ERROR;
+        *slash = '/';
+    }
+
+    return SUCCESS;
+}
+
+
+/******************************************************************************
+MODULE: staging_check_fork
+
+PURPOSE: Forgets the flush threads, and the flushes they were doing, of the
+process this one was forked from.  Called with the mutex held.
+
+RETURN VALUE:
+Type = N/A
+
+NOTES:
+*****************************************************************************/
+static void staging_check_fork (void)
+{
+    Espa_staged_file_t *staged;  /* staged file */
+
+    if (staging_pid == getpid ())
+        return;
+
+    staging_pid = getpid ();
+    staging_nthreads = 0;
+    staging_npending = 0;
+    for (staged = staging_files; staged != NULL; staged = staged->next)
+    {
+        if (staged->flushing)
+            staged->queued = staged->flushing = false;
+    }
+    for (staged = staging_queue; staged != NULL; staged = staged->next_queued)
+        staging_npending++;
+}
+
+
+/******************************************************************************
+MODULE: staging_flush
+
+PURPOSE: Copies a staged file to a temporary file alongside its final name,
+syncs it, and renames it over the final file.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error flushing the file; the final file is left untouched
+SUCCESS      Successfully flushed the file
+
+NOTES:
+*****************************************************************************/
+static int staging_flush
+(
+    const Espa_staged_file_t *staged  /* I: file to be flushed */
+)
+{
+    char FUNC_NAME[] = "staging_flush";  /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    char tmp_file[STR_SIZE]; /* name of the final file while it is written */
+    int in_fd;               /* file descriptor of the staged copy */
+    int out_fd;              /* file descriptor of the temporary file */
+    int count;               /* number of chars copied in snprintf */
+    int status = SUCCESS;    /* status of the flush */
+    struct stat statbuf;     /* status of the staged copy */
+    struct timespec times[2];  /* access and modification times */
+
+    count = snprintf (tmp_file, sizeof (tmp_file), "%s.%ld.stage",
+        staged->file, (long) getpid ());
+    if (count < 0 || count >= sizeof (tmp_file))
+    {
+        sprintf (errmsg, "Overflow of the temporary name of %s",
+            staged->file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return ERROR;
+    }
+
+    in_fd = open (staged->staged, O_RDONLY);
+    if (in_fd == -1 || fstat (in_fd, &statbuf) != 0)
+    {
+        sprintf (errmsg, "Opening the staged copy %s", staged->staged);
+        error_handler (true, FUNC_NAME, errmsg);
+        if (in_fd != -1)
+            close (in_fd);
+        return ERROR;
+    }
+    out_fd = open (tmp_file, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (out_fd == -1)
+    {
+        sprintf (errmsg, "Creating %s", tmp_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        close (in_fd);
+        return ERROR;
+    }
+
+    /* The modification time is kept, so the fill runs sidecar (see
+       raw_binary_sparse.h) still matches the band */
+    times[0] = statbuf.st_atim;
+    times[1] = statbuf.st_mtim;
+    if (copy_raw_binary_fd (in_fd, 0, statbuf.st_size, out_fd) != SUCCESS ||
+        futimens (out_fd, times) != 0 || fsync (out_fd) != 0)
+        status = ERROR;
+    close (in_fd);
+    if (close (out_fd) != 0)
+        status = ERROR;
+    if (status == SUCCESS && rename (tmp_file, staged->file) != 0)
+        status = ERROR;
+    if (status != SUCCESS)
+    {
+        sprintf (errmsg, "Flushing the staged copy %s to %s", staged->staged,
+            staged->file);
+        error_handler (true, FUNC_NAME, errmsg);
+        unlink (tmp_file);
+    }
+
+    return status;
+}
+
+
+/******************************************************************************
+MODULE: staging_flush_next
+
+PURPOSE: Flushes the next file in the queue.  Called with the mutex held,
+which is released during the flush.
+
+RETURN VALUE:
+Type = N/A
+
+NOTES:
+*****************************************************************************/
+static void staging_flush_next (void)
+{
+    Espa_staged_file_t *staged = staging_queue;  /* file being flushed */
+    int status;              /* status of the flush */
+
+    staging_queue = staged->next_queued;
+    if (staging_queue == NULL)
+        staging_queue_tail = NULL;
+    staged->flushing = true;
+
+    pthread_mutex_unlock (&staging_mutex);
+    status = staging_flush (staged);
+    pthread_mutex_lock (&staging_mutex);
+
+    if (staged->flushing)
+    {
+        staged->queued = staged->flushing = false;
+        if (status != SUCCESS)
+            staging_nfailed++;
+        staging_npending--;
+        pthread_cond_broadcast (&staging_done_cond);
+    }
+}
+
+
+/******************************************************************************
+MODULE: staging_flush_thread
+
+PURPOSE: Flushes the queued files as they are queued.
+
+RETURN VALUE:
+Type = void *
+Value        Description
+-----        -----------
+NULL         Never returns
+
+NOTES:
+*****************************************************************************/
+static void *staging_flush_thread
+(
+    void *arg            /* I: unused */
+)
+{
+    pthread_mutex_lock (&staging_mutex);
+    while (1)
+    {
+        while (staging_queue == NULL)
+            pthread_cond_wait (&staging_work_cond, &staging_mutex);
+        staging_flush_next ();
+    }
+
+    return NULL;
+}
+
+
+/******************************************************************************
+MODULE: staging_release_file
+
+PURPOSE: Ends a write of a staged file, queueing the file to be flushed once
+its last writer is done.  Called with the mutex held.
+
+RETURN VALUE:
+Type = N/A
+
+NOTES:
+  1. If no flush thread can be started, the file is flushed by the caller.
+*****************************************************************************/
+static void staging_release_file
+(
+    Espa_staged_file_t *staged  /* I/O: file written */
+)
+{
+    pthread_t thread;        /* flush thread started */
+    pthread_attr_t attr;     /* attributes of the flush thread */
+
+    if (staged->nwriters > 0)
+        staged->nwriters--;
+    if (staged->nwriters > 0 || !staged->dirty)
+        return;
+
+    staged->dirty = false;
+    staged->queued = true;
+    staged->next_queued = NULL;
+    if (staging_queue_tail != NULL)
+        staging_queue_tail->next_queued = staged;
+    else
+        staging_queue = staged;
+    staging_queue_tail = staged;
+    staging_npending++;
+
+    staging_check_fork ();
+    if (staging_nthreads < staging_nflushes &&
+        staging_nthreads < staging_npending)
+    {
+        pthread_attr_init (&attr);
+        pthread_attr_setdetachstate (&attr, PTHREAD_CREATE_DETACHED);
+        if (pthread_create (&thread, &attr, staging_flush_thread, NULL) == 0)
+            staging_nthreads++;
+        pthread_attr_destroy (&attr);
+    }
+
+    if (staging_nthreads == 0)
+        staging_flush_next ();
+    else
+        pthread_cond_signal (&staging_work_cond);
+}
+
+
+/******************************************************************************
+MODULE: espa_staging_path
+
+PURPOSE: Gives the name to open a file under: its staged copy when staging is
+on and the file is written, or was staged by this process and is read, and
+the file itself otherwise.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error staging the file
+SUCCESS      path holds the name to open
+
+NOTES:
+  1. Opening a file for writing (ESPA_STAGE_CREATE or ESPA_STAGE_UPDATE)
+     waits for any flush of the file to finish, and counts a writer of the
+     file, which espa_staging_done or espa_staging_release ends whether or
+     not the file could be opened.
+  2. For ESPA_STAGE_UPDATE, a file which exists but hasn't been staged is
+     copied to the staging directory first.
+  3. A file in shared memory is opened from its segment instead (see
+     espa_shm_segment).
+*****************************************************************************/
+int espa_staging_path
+(
+    const char *file,    /* I: final name of the file */
+    Espa_stage_access_t stage_access,  /* I: access the file is opened
+                                             for */
+    char *path,          /* O: name to open the file under */
+    size_t path_size     /* I: size of path */
+)
+{
+    char FUNC_NAME[] = "espa_staging_path";  /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    char abs_file[STR_SIZE]; /* absolute final name of the file */
+    const char *name = file; /* name to open the file under */
+    int count;               /* number of chars copied in snprintf */
+    int in_fd;               /* file descriptor of the final file */
+    int out_fd;              /* file descriptor of the staged copy */
+    int status = SUCCESS;    /* status of staging the file */
+    bool in_shm;             /* is the file in shared memory? */
+    struct stat statbuf;     /* status of the final file */
+    Espa_staged_file_t *staged = NULL;  /* staged file */
+
+    /* Files in shared memory aren't staged (see espa_shm.h).  A file opened
+       for update which doesn't exist yet is being created. */
+    if (espa_shm_segment (file, stage_access == ESPA_STAGE_CREATE ||
+        (stage_access == ESPA_STAGE_UPDATE && access (file, F_OK) != 0),
+        path, path_size, &in_shm) != SUCCESS)
+        return ERROR;
+    if (in_shm)
+        return SUCCESS;
+
+    pthread_once (&staging_once, staging_init);
+    if (staging_on && staging_absolute (file, abs_file) != SUCCESS)
+    {
+        sprintf (errmsg, "Overflow of the absolute name of %s", file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return ERROR;
+    }
+
+    if (staging_on)
+    {
+        pthread_mutex_lock (&staging_mutex);
+        staged = staging_find (abs_file);
+        if (stage_access != ESPA_STAGE_READ && staged == NULL)
+        {
+            staged = calloc (1, sizeof (Espa_staged_file_t));
+            count = -1;
+            if (staged != NULL)
+                count = snprintf (staged->staged, sizeof (staged->staged),
+                    "%s%s", staging_dir, abs_file);
+            if (count < 0 || count >= sizeof (staged->staged) ||
+                staging_make_dirs (staged->staged) != SUCCESS)
+            {
+                pthread_mutex_unlock (&staging_mutex);
+                sprintf (errmsg, "Staging %s under %s", file, staging_dir);
+                error_handler (true, FUNC_NAME, errmsg);
+                free (staged);
+                return ERROR;
+            }
+            strcpy (staged->file, abs_file);
+            staged->owner = getpid ();
+            staged->next = staging_files;
+            staging_files = staged;
+        }
+
+        if (stage_access != ESPA_STAGE_READ)
+        {
+            while (staged->queued)
+                pthread_cond_wait (&staging_done_cond, &staging_mutex);
+            staged->nwriters++;
+            staged->dirty = true;
+
+            /* Start a file modified in place from its final copy */
+            if (stage_access == ESPA_STAGE_UPDATE &&
+                access (staged->staged, F_OK) != 0 &&
+                (in_fd = open (file, O_RDONLY)) != -1)
+            {
+                out_fd = open (staged->staged, O_WRONLY | O_CREAT, 0644);
+                if (out_fd == -1 || fstat (in_fd, &statbuf) != 0 ||
+                    copy_raw_binary_fd (in_fd, 0, statbuf.st_size, out_fd) !=
+                    SUCCESS)
+                    status = ERROR;
+                if (out_fd != -1 && close (out_fd) != 0)
+                    status = ERROR;
+                close (in_fd);
+                if (status != SUCCESS)
+                {
+                    unlink (staged->staged);
+                    staged->dirty = false;
+                    staging_release_file (staged);
+                    pthread_mutex_unlock (&staging_mutex);
+                    sprintf (errmsg, "Copying %s to the staging directory",
+                        file);
+                    error_handler (true, FUNC_NAME, errmsg);
+                    return ERROR;
+                }
+            }
+            name = staged->staged;
+        }
+        else if (staged != NULL && access (staged->staged, F_OK) == 0)
+            name = staged->staged;
+        pthread_mutex_unlock (&staging_mutex);
+    }
+
+    count = snprintf (path, path_size, "%s", name);
+    if (count < 0 || count >= path_size)
+    {
+        sprintf (errmsg, "Overflow of the name of %s", file);
+        error_handler (true, FUNC_NAME, errmsg);
+        if (stage_access != ESPA_STAGE_READ)
+            espa_staging_done (file);
+        return ERROR;
+    }
+
+    return SUCCESS;
+}
+
+
+/******************************************************************************
+MODULE: espa_staging_done
+
+PURPOSE: Ends a write of a file opened with espa_staging_path, queueing the
+file to be flushed once its last writer is done.
+
+RETURN VALUE:
+Type = N/A
+
+NOTES:
+  1. Call it after the file is closed, so all of its bytes are in the staged
+     copy.
+*****************************************************************************/
+void espa_staging_done
+(
+    const char *file     /* I: final name of the file written */
+)
+{
+    char abs_file[STR_SIZE]; /* absolute final name of the file */
+    Espa_staged_file_t *staged = NULL;  /* staged file */
+
+    if (!espa_staging_enabled () ||
+        staging_absolute (file, abs_file) != SUCCESS)
+        return;
+
+    pthread_mutex_lock (&staging_mutex);
+    staged = staging_find (abs_file);
+    if (staged != NULL)
+        staging_release_file (staged);
+    pthread_mutex_unlock (&staging_mutex);
+}
+
+
+/******************************************************************************
+MODULE: espa_staging_attach
+
+PURPOSE: Records the file written through a file descriptor, for the
+routines which close the file by its file descriptor or FILE pointer.
+
+RETURN VALUE:
+Type = N/A
+
+NOTES:
+  1. The file must have been opened for writing with espa_staging_path.
+*****************************************************************************/
+void espa_staging_attach
+(
+    int fd,              /* I: file descriptor writing the file */
+    const char *file     /* I: final name of the file */
+)
+{
+    char FUNC_NAME[] = "espa_staging_attach";  /* function name */
+    char abs_file[STR_SIZE]; /* absolute final name of the file */
+    Espa_staged_file_t **by_fd = NULL;  /* resized table */
+    int i;                   /* looping variable */
+
+    if (!espa_staging_enabled () ||
+        staging_absolute (file, abs_file) != SUCCESS)
+        return;
+
+    pthread_mutex_lock (&staging_mutex);
+    if (fd >= staging_nfds)
+    {
+        by_fd = realloc (staging_by_fd, (fd + 1) * sizeof (*by_fd));
+        if (by_fd == NULL)
+        {
+            /* The file is flushed when the process exits instead */
+            pthread_mutex_unlock (&staging_mutex);
+            error_handler (false, FUNC_NAME, "Allocating the table of the "
+                "staged files");
+            return;
+        }
+        for (i = staging_nfds; i <= fd; i++)
+            by_fd[i] = NULL;
+        staging_by_fd = by_fd;
+        staging_nfds = fd + 1;
+    }
+    staging_by_fd[fd] = staging_find (abs_file);
+    pthread_mutex_unlock (&staging_mutex);
+}
+
+
+/******************************************************************************
+MODULE: espa_staging_detach
+
+PURPOSE: Forgets the file written through a file descriptor which is about
+to be closed.
+
+RETURN VALUE:
+Type = Espa_staged_file_t *
+Value        Description
+-----        -----------
+NULL         The file descriptor doesn't write a staged file
+non-NULL     File to be passed to espa_staging_release once it is closed
+
+NOTES:
+*****************************************************************************/
+Espa_staged_file_t *espa_staging_detach
+(
+    int fd               /* I: file descriptor being closed */
+)
+{
+    Espa_staged_file_t *staged = NULL;  /* staged file */
+
+    if (!espa_staging_enabled ())
+        return NULL;
+
+    pthread_mutex_lock (&staging_mutex);
+    if (fd >= 0 && fd < staging_nfds)
+    {
+        staged = staging_by_fd[fd];
+        staging_by_fd[fd] = NULL;
+    }
+    pthread_mutex_unlock (&staging_mutex);
+
+    return staged;
+}
+
+
+/******************************************************************************
+MODULE: espa_staging_release
+
+PURPOSE: Ends a write of a file detached from its file descriptor.
+
+RETURN VALUE:
+Type = N/A
+
+NOTES:
+*****************************************************************************/
+void espa_staging_release
+(
+    Espa_staged_file_t *staged  /* I: file from espa_staging_detach; NULL
+                                      if it isn't staged */
+)
+{
+    if (staged == NULL)
+        return;
+
+    pthread_mutex_lock (&staging_mutex);
+    staging_release_file (staged);
+    pthread_mutex_unlock (&staging_mutex);
+}
+
+
+/******************************************************************************
+MODULE: espa_staging_wait
+
+PURPOSE: Waits for the queued files to be flushed to their final location.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        One or more files couldn't be flushed since the last wait
+SUCCESS      All of the queued files were flushed
+
+NOTES:
+  1. Files still open for writing aren't queued yet, so they aren't waited
+     for.
+*****************************************************************************/
+int espa_staging_wait (void)
+{
+    char FUNC_NAME[] = "espa_staging_wait";  /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    int nfailed;             /* number of flushes which failed */
+
+    if (!espa_staging_enabled ())
+        return SUCCESS;
+
+    pthread_mutex_lock (&staging_mutex);
+    staging_check_fork ();
+    while (staging_npending > 0)
+    {
+        if (staging_nthreads == 0)
+            staging_flush_next ();
+        else
+            pthread_cond_wait (&staging_done_cond, &staging_mutex);
+    }
+    nfailed = staging_nfailed;
+    staging_nfailed = 0;
+    pthread_mutex_unlock (&staging_mutex);
+
+    if (nfailed > 0)
+    {
+        sprintf (errmsg, "%d staged files couldn't be flushed", nfailed);
+        error_handler (true, FUNC_NAME, errmsg);
+        return ERROR;
+    }
+
+    return SUCCESS;
+}
+
+
+/******************************************************************************
+MODULE: staging_exit
+
+PURPOSE: Flushes the files left open or queued when the process exits, and
+removes the staged copies of this process.
+
+RETURN VALUE:
+Type = N/A
+
+NOTES:
+*****************************************************************************/
+static void staging_exit (void)
+{
+    Espa_staged_file_t *staged;  /* staged file */
+
+    /* Flush the files whose writers weren't closed */
+    pthread_mutex_lock (&staging_mutex);
+    for (staged = staging_files; staged != NULL; staged = staged->next)
+    {
+        if (staged->owner == getpid () && staged->nwriters > 0)
+        {
+            staged->nwriters = 1;
+            staging_release_file (staged);
+        }
+    }
+    pthread_mutex_unlock (&staging_mutex);
+
+    espa_staging_wait ();
+
+    pthread_mutex_lock (&staging_mutex);
+    for (staged = staging_files; staged != NULL; staged = staged->next)
+    {
+        if (staged->owner == getpid ())
+            unlink (staged->staged);
+    }
+    pthread_mutex_unlock (&staging_mutex);
+}
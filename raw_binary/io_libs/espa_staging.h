@@ -0,0 +1,107 @@
+/*****************************************************************************
+FILE: espa_staging.h
+
+PURPOSE: Contains defines and prototypes for staging the raw binary output
+files in a local scratch directory (ex. NVMe or tmpfs) and flushing them to
+their final location (ex. a parallel filesystem) in the background, so the
+converters don't wait on the remote storage as they write.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. Staging is on when ESPA_STAGING_DIR_ENV names the scratch directory.
+     Each output file is written under it at its absolute final path (ex.
+     /scratch/data/out/LC08_b1.img for /data/out/LC08_b1.img), and the
+     directories are created as needed.
+  2. Once the last file descriptor writing a file is closed, the file is
+     queued to be flushed.  ESPA_STAGING_FLUSHES_ENV threads (default
+     ESPA_STAGING_DEFAULT_FLUSHES) copy the queued files to a temporary file
+     alongside the final file, sync it, and rename it over the final file,
+     so the final file is never seen partially written.
+  3. The XML metadata is published last: write_metadata and append_metadata
+     wait for the queued flushes (espa_staging_wait) before publishing it,
+     and fail if any of them failed.  A reader which finds the XML file
+     therefore finds all of its bands.
+  4. The staged copies are kept until the process exits, and the raw binary
+     routines read a file from its staged copy, so the later steps of a
+     pipeline (ex. process_level1) read and modify the bands locally.  A
+     file reopened for writing waits for its flush to finish, and is
+     flushed again once it is closed.  A file modified in place which
+     wasn't staged by this process is first copied to the staging
+     directory.
+  5. Only the files written through the raw binary routines (raw_binary_io,
+     raw_binary_writer, the block-compressed writer, and the fill runs of
+     raw_binary_sparse) are staged.  Other files (ex. the ENVI headers) are
+     written to their final location as before.
+  6. Files in shared memory (see espa_shm.h) are opened from their segments
+     and aren't staged.
+*****************************************************************************/
+
+#ifndef ESPA_STAGING_H
+#define ESPA_STAGING_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include "error_handler.h"
+
+/* Defines */
+#define ESPA_STAGING_DIR_ENV "ESPA_STAGING_DIR"  /* local directory the output
+                                     files are staged in; unset turns staging
+                                     off */
+#define ESPA_STAGING_FLUSHES_ENV "ESPA_STAGING_FLUSHES"  /* number of files
+                                     flushed at the same time */
+#define ESPA_STAGING_DEFAULT_FLUSHES 4
+#define ESPA_STAGING_MAX_FLUSHES 64
+
+/* Access a file is opened for */
+typedef enum {
+  ESPA_STAGE_READ,      /* read only */
+  ESPA_STAGE_CREATE,    /* written from scratch (created or truncated) */
+  ESPA_STAGE_UPDATE     /* modified in place */
+} Espa_stage_access_t;
+
+/* Output file being staged */
+typedef struct Espa_staged_file Espa_staged_file_t;
+
+/* Prototypes */
+bool espa_staging_enabled (void);
+
+int espa_staging_path
+(
+    const char *file,    /* I: final name of the file */
+    Espa_stage_access_t stage_access,  /* I: access the file is opened
+                                             for */
+    char *path,          /* O: name to open the file under */
+    size_t path_size     /* I: size of path */
+);
+
+void espa_staging_done
+(
+    const char *file     /* I: final name of the file written */
+);
+
+void espa_staging_attach
+(
+    int fd,              /* I: file descriptor writing the file */
+    const char *file     /* I: final name of the file */
+);
+
+Espa_staged_file_t *espa_staging_detach
+(
+    int fd               /* I: file descriptor being closed */
+);
+
+void espa_staging_release
+(
+    Espa_staged_file_t *staged  /* I: file from espa_staging_detach; NULL
+                                      if it isn't staged */
+);
+
+int espa_staging_wait (void);
+
+#endif
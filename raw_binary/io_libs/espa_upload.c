@@ -0,0 +1,1171 @@
+/*****************************************************************************
+FILE: espa_upload.c
+
+PURPOSE: Contains functions for writing output files to object storage (S3)
+as streamed multipart uploads.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The writer fills one part at a time and the threads upload the full
+     parts, so the file is produced and uploaded at the same time, and at
+     most one part more than there are threads is held in memory.
+  2. The parts are uploaded in any order; S3 assembles them by number when
+     the upload is completed.
+*****************************************************************************/
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <strings.h>
+#include "espa_upload.h"
+#include "espa_remote.h"
+#include "espa_trace.h"
+
+#ifdef HAVE_LIBCURL
+/* Smallest buffer of a part being filled; it grows up to the part size */
+#define UPLOAD_MIN_BUF_BYTES 65536
+
+/* Most bytes of a response body kept (the responses are short XML) */
+#define UPLOAD_RESPONSE_BYTES 8192
+
+/* Request of an upload: its body, and the response to it */
+typedef struct
+{
+    const char *body;        /* bytes sent */
+    size_t nbytes;           /* number of bytes sent */
+    size_t sent;             /* number of bytes sent so far */
+    char response[UPLOAD_RESPONSE_BYTES];  /* start of the response body */
+    size_t nresponse;        /* number of bytes in response */
+    char etag[ESPA_UPLOAD_ETAG_LEN];  /* ETag header of the response */
+} Upload_request_t;
+
+
+/******************************************************************************
+MODULE: upload_read_callback
+
+PURPOSE: Supplies the bytes of the body of a request.
+
+RETURN VALUE:
+Type = size_t
+Value        Description
+-----        -----------
+n            Number of bytes supplied; 0 at the end of the body
+
+NOTES:
+*****************************************************************************/
+static size_t upload_read_callback
+(
+    char *data,              /* O: bytes to be sent */
+    size_t size,             /* I: size of each item */
+    size_t nitems,           /* I: number of items */
+    void *userdata           /* I/O: request being sent */
+)
+{
+    Upload_request_t *req = (Upload_request_t *) userdata;
+    size_t nbytes = size * nitems;  /* room for bytes to be sent */
+
+    if (nbytes > req->nbytes - req->sent)
+        nbytes = req->nbytes - req->sent;
+    memcpy (data, req->body + req->sent, nbytes);
+    req->sent += nbytes;
+    return nbytes;
+}
+
+
+/******************************************************************************
+MODULE: upload_write_callback
+
+PURPOSE: Receives the body of the response to a request, keeping its start.
+
+RETURN VALUE:
+Type = size_t
+Value        Description
+-----        -----------
+n            Number of bytes received (all of them are taken)
+
+NOTES:
+*****************************************************************************/
+static size_t upload_write_callback
+(
+    char *data,              /* I: bytes received */
+    size_t size,             /* I: size of each item */
+    size_t nitems,           /* I: number of items */
+    void *userdata           /* I/O: request being answered */
+)
+{
+    Upload_request_t *req = (Upload_request_t *) userdata;
+    size_t nbytes = size * nitems;  /* number of bytes received */
+    size_t nkept;            /* number of bytes kept */
+
+    nkept = sizeof (req->response) - 1 - req->nresponse;
+    if (nkept > nbytes)
+        nkept = nbytes;
+    memcpy (req->response + req->nresponse, data, nkept);
+    req->nresponse += nkept;
+    req->response[req->nresponse] = '\0';
+    return nbytes;
+}
+
+
+/******************************************************************************
+MODULE: upload_header_callback
+
+PURPOSE: Receives a header of the response to a request, keeping the ETag.
+
+RETURN VALUE:
+Type = size_t
+Value        Description
+-----        -----------
+n            Number of bytes received (all of them are taken)
+
+NOTES:
+*****************************************************************************/
+static size_t upload_header_callback
+(
+    char *data,              /* I: header line received, not 0-terminated */
+    size_t size,             /* I: size of each item */
+    size_t nitems,           /* I: number of items */
+    void *userdata           /* I/O: request being answered */
+)
+{
+    Upload_request_t *req = (Upload_request_t *) userdata;
+    size_t nbytes = size * nitems;  /* number of bytes received */
+    size_t start = 5;        /* start of the value of the header */
+    size_t end = nbytes;     /* end of the value of the header */
+
+    if (nbytes < start || strncasecmp (data, "ETag:", 5))
+        return nbytes;
+    while (start < end && data[start] == ' ')
+        start++;
+    while (end > start && (data[end-1] == '\r' || data[end-1] == '\n' ||
+        data[end-1] == ' '))
+        end--;
+    if (end - start < sizeof (req->etag))
+    {
+        memcpy (req->etag, data + start, end - start);
+        req->etag[end - start] = '\0';
+    }
+    return nbytes;
+}
+
+
+/******************************************************************************
+MODULE: new_upload_handle
+
+PURPOSE: Creates a libcurl handle for a request of an upload.
+
+RETURN VALUE:
+Type = CURL *
+Value        Description
+-----        -----------
+NULL         Error creating the handle
+non-NULL     The handle; free with curl_easy_cleanup and free the headers
+             with curl_slist_free_all
+
+NOTES:
+  1. The caller sets the method of the request.
+*****************************************************************************/
+static CURL *new_upload_handle
+(
+    Espa_upload_t *upload,   /* I: remote file */
+    const char *query,       /* I: query string of the request */
+    Upload_request_t *req,   /* I: request the callbacks fill in */
+    struct curl_slist **headers  /* O: extra headers of the requests */
+)
+{
+    char url[STR_SIZE];      /* URL of the request */
+    int count;               /* number of chars copied in snprintf */
+    CURL *curl = NULL;       /* libcurl handle */
+
+    count = snprintf (url, sizeof (url), "%s%s", upload->url, query);
+    if (count < 0 || count >= sizeof (url))
+        return NULL;
+
+    curl = new_remote_handle (url, upload->sign, headers);
+    if (curl == NULL)
+        return NULL;
+    curl_easy_setopt (curl, CURLOPT_READFUNCTION, upload_read_callback);
+    curl_easy_setopt (curl, CURLOPT_READDATA, req);
+    curl_easy_setopt (curl, CURLOPT_WRITEFUNCTION, upload_write_callback);
+    curl_easy_setopt (curl, CURLOPT_WRITEDATA, req);
+    curl_easy_setopt (curl, CURLOPT_HEADERFUNCTION, upload_header_callback);
+    curl_easy_setopt (curl, CURLOPT_HEADERDATA, req);
+
+    return curl;
+}
+
+
+/******************************************************************************
+MODULE: perform_upload_request
+
+PURPOSE: Sends a request of an upload.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        The request failed
+SUCCESS      The request succeeded
+
+NOTES:
+  1. The request is attempted ESPA_REMOTE_RETRIES times, waiting longer
+     after each failure.
+  2. S3 may report an error in the body of a successful response, which
+     fails the request as well.
+*****************************************************************************/
+static int perform_upload_request
+(
+    CURL *curl,              /* I: libcurl handle set up for the request */
+    Espa_upload_t *upload,   /* I: remote file */
+    Upload_request_t *req,   /* I/O: request; the response is filled in */
+    const char *what         /* I: description of the request */
+)
+{
+    char FUNC_NAME[] = "perform_upload_request"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    int attempt;             /* current attempt of the request */
+    CURLcode res = CURLE_OK; /* result of the request */
+
+    for (attempt = 0; attempt < ESPA_REMOTE_RETRIES; attempt++)
+    {
+        if (attempt > 0)
+            usleep (250000 << attempt);
+
+        req->sent = 0;
+        req->nresponse = 0;
+        req->response[0] = '\0';
+        req->etag[0] = '\0';
+        res = curl_easy_perform (curl);
+        if (res == CURLE_OK && strstr (req->response, "<Error>") == NULL)
+            return SUCCESS;
+    }
+
+    snprintf (errmsg, sizeof (errmsg), "%s of %s: %s", what,
+        upload->file_name, res != CURLE_OK ? curl_easy_strerror (res) :
+        req->response);
+    error_handler (true, FUNC_NAME, errmsg);
+    return ERROR;
+}
+
+
+/******************************************************************************
+MODULE: put_upload_object
+
+PURPOSE: Writes a whole remote file with a single request.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error writing the file
+SUCCESS      The file was written
+
+NOTES:
+*****************************************************************************/
+static int put_upload_object
+(
+    Espa_upload_t *upload    /* I: remote file, all in its buffer */
+)
+{
+    int status;              /* status of the request */
+    CURL *curl = NULL;       /* libcurl handle */
+    struct curl_slist *headers = NULL;  /* extra headers of the request */
+    Upload_request_t *req = NULL;  /* request */
+
+    req = calloc (1, sizeof (Upload_request_t));
+    curl = (req != NULL) ? new_upload_handle (upload, "", req, &headers) :
+        NULL;
+    if (curl == NULL)
+    {
+        free (req);
+        return ERROR;
+    }
+    req->body = upload->buf;
+    req->nbytes = upload->nbuf;
+    curl_easy_setopt (curl, CURLOPT_UPLOAD, 1L);
+    curl_easy_setopt (curl, CURLOPT_INFILESIZE_LARGE,
+        (curl_off_t) upload->nbuf);
+
+    status = perform_upload_request (curl, upload, req, "Writing");
+    curl_easy_cleanup (curl);
+    curl_slist_free_all (headers);
+    free (req);
+    return status;
+}
+
+
+/******************************************************************************
+MODULE: upload_part
+
+PURPOSE: Uploads a part of a remote file.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error uploading the part
+SUCCESS      The part was uploaded
+
+NOTES:
+  1. The handle is created by the first part a thread uploads and reused
+     for the others, so the connection is kept open between them.
+*****************************************************************************/
+static int upload_part
+(
+    Espa_upload_t *upload,   /* I: remote file */
+    Espa_upload_part_t *part,  /* I: part to be uploaded */
+    CURL **curl,             /* I/O: libcurl handle of the thread; NULL
+                                     until the first part */
+    struct curl_slist **headers,  /* I/O: extra headers of the requests */
+    Upload_request_t *req    /* O: request; the ETag is filled in */
+)
+{
+    char FUNC_NAME[] = "upload_part"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    char query[STR_SIZE];    /* query string of the request */
+    char url[STR_SIZE];      /* URL of the request */
+
+    snprintf (query, sizeof (query), "?partNumber=%d&uploadId=%s",
+        part->number, upload->upload_id);
+    if (*curl == NULL)
+    {
+        *curl = new_upload_handle (upload, query, req, headers);
+        if (*curl == NULL)
+        {
+            snprintf (errmsg, sizeof (errmsg), "Creating the connection for "
+                "%s", upload->file_name);
+            error_handler (true, FUNC_NAME, errmsg);
+            return ERROR;
+        }
+        curl_easy_setopt (*curl, CURLOPT_UPLOAD, 1L);
+    }
+    else
+    {
+        snprintf (url, sizeof (url), "%s%s", upload->url, query);
+        curl_easy_setopt (*curl, CURLOPT_URL, url);
+    }
+    req->body = part->buf;
+    req->nbytes = part->nbytes;
+    curl_easy_setopt (*curl, CURLOPT_INFILESIZE_LARGE,
+        (curl_off_t) part->nbytes);
+
+    snprintf (query, sizeof (query), "Uploading part %d", part->number);
+    if (perform_upload_request (*curl, upload, req, query) != SUCCESS)
+        return ERROR;
+    if (req->etag[0] == '\0')
+    {
+        snprintf (errmsg, sizeof (errmsg), "No ETag for part %d of %s",
+            part->number, upload->file_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return ERROR;
+    }
+
+    return SUCCESS;
+}
+
+
+/******************************************************************************
+MODULE: upload_part_thread
+
+PURPOSE: Uploads the queued parts of a remote file until the file is closed.
+
+RETURN VALUE:
+Type = void *
+Value        Description
+-----        -----------
+NULL         Always
+
+NOTES:
+  1. Once a part fails, the parts still queued are dropped.
+*****************************************************************************/
+static void *upload_part_thread
+(
+    void *arg                /* I: remote file */
+)
+{
+    Espa_upload_t *upload = (Espa_upload_t *) arg;  /* remote file */
+    Espa_upload_part_t *part = NULL;  /* part being uploaded */
+    CURL *curl = NULL;       /* libcurl handle of this thread */
+    struct curl_slist *headers = NULL;  /* extra headers of the requests */
+    Upload_request_t *req = NULL;  /* request of the part */
+    int status;              /* status of the upload */
+
+    req = calloc (1, sizeof (Upload_request_t));
+
+    pthread_mutex_lock (&upload->mutex);
+    while (1)
+    {
+        while (!upload->done && upload->queue == NULL)
+            pthread_cond_wait (&upload->cond, &upload->mutex);
+        if (upload->queue == NULL)
+            break;
+
+        part = upload->queue;
+        upload->queue = part->next;
+        if (upload->queue == NULL)
+            upload->queue_tail = NULL;
+        status = ERROR;
+        if (!upload->failed && req != NULL)
+        {
+            pthread_mutex_unlock (&upload->mutex);
+            status = upload_part (upload, part, &curl, &headers, req);
+            pthread_mutex_lock (&upload->mutex);
+        }
+
+        if (status == SUCCESS)
+            strcpy (upload->etags[part->number - 1], req->etag);
+        else
+            upload->failed = true;
+        espa_trace_free (part->buf);
+        free (part);
+        upload->ninflight--;
+        pthread_cond_broadcast (&upload->cond);
+    }
+    pthread_mutex_unlock (&upload->mutex);
+
+    if (curl != NULL)
+        curl_easy_cleanup (curl);
+    curl_slist_free_all (headers);
+    free (req);
+    return NULL;
+}
+
+
+/******************************************************************************
+MODULE: start_multipart_upload
+
+PURPOSE: Starts the multipart upload of a remote file, and the threads which
+upload its parts.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error starting the upload
+SUCCESS      The upload was started
+
+NOTES:
+*****************************************************************************/
+static int start_multipart_upload
+(
+    Espa_upload_t *upload    /* I/O: remote file */
+)
+{
+    char FUNC_NAME[] = "start_multipart_upload"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    char *start = NULL;      /* start of the upload id in the response */
+    char *end = NULL;        /* end of the upload id in the response */
+    int i;                   /* looping variable for the threads */
+    int nthreads;            /* number of uploading threads */
+    int status;              /* status of the request */
+    CURL *curl = NULL;       /* libcurl handle */
+    struct curl_slist *headers = NULL;  /* extra headers of the request */
+    Upload_request_t *req = NULL;  /* request */
+
+    req = calloc (1, sizeof (Upload_request_t));
+    curl = (req != NULL) ? new_upload_handle (upload, "?uploads", req,
+        &headers) : NULL;
+    if (curl == NULL)
+    {
+        snprintf (errmsg, sizeof (errmsg), "Creating the connection for %s",
+            upload->file_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        free (req);
+        return ERROR;
+    }
+    curl_easy_setopt (curl, CURLOPT_POST, 1L);
+    curl_easy_setopt (curl, CURLOPT_POSTFIELDS, "");
+    curl_easy_setopt (curl, CURLOPT_POSTFIELDSIZE, 0L);
+
+    status = perform_upload_request (curl, upload, req,
+        "Starting the multipart upload");
+    if (status == SUCCESS)
+    {
+        start = strstr (req->response, "<UploadId>");
+        end = (start != NULL) ? strstr (start, "</UploadId>") : NULL;
+        if (end != NULL)
+        {
+            start += strlen ("<UploadId>");
+            upload->upload_id = curl_easy_escape (curl, start, end - start);
+        }
+        if (upload->upload_id == NULL)
+        {
+            snprintf (errmsg, sizeof (errmsg), "No upload id for %s",
+                upload->file_name);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+        }
+    }
+    curl_easy_cleanup (curl);
+    curl_slist_free_all (headers);
+    free (req);
+    if (status != SUCCESS)
+        return ERROR;
+
+    /* Start the uploading threads */
+    nthreads = remote_env (ESPA_UPLOAD_CONNECTIONS_ENV,
+        ESPA_UPLOAD_DEFAULT_CONNECTIONS);
+    nthreads = espa_mem_fit_count (upload->part_bytes, nthreads, 1);
+    upload->threads = calloc (nthreads, sizeof (pthread_t));
+    if (upload->threads == NULL)
+    {
+        sprintf (errmsg, "Allocating memory for the uploading threads");
+        error_handler (true, FUNC_NAME, errmsg);
+        return ERROR;
+    }
+    for (i = 0; i < nthreads; i++)
+    {
+        if (pthread_create (&upload->threads[i], NULL, upload_part_thread,
+            upload) != 0)
+            break;
+        upload->nthreads++;
+    }
+    if (upload->nthreads == 0)
+    {
+        sprintf (errmsg, "Starting the threads uploading the remote file");
+        error_handler (true, FUNC_NAME, errmsg);
+        return ERROR;
+    }
+
+    return SUCCESS;
+}
+
+
+/******************************************************************************
+MODULE: fail_upload
+
+PURPOSE: Marks a remote file as failed, so it is aborted rather than
+completed.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+*****************************************************************************/
+static void fail_upload
+(
+    Espa_upload_t *upload    /* I/O: remote file */
+)
+{
+    pthread_mutex_lock (&upload->mutex);
+    upload->failed = true;
+    pthread_mutex_unlock (&upload->mutex);
+}
+
+
+/******************************************************************************
+MODULE: queue_upload_part
+
+PURPOSE: Hands the part being filled to the uploading threads, starting the
+multipart upload with the first part.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error queueing the part, or a part failed to upload
+SUCCESS      The part was queued
+
+NOTES:
+  1. Waits while every thread is uploading a part, so the writer never gets
+     more than a part ahead of the uploads.
+*****************************************************************************/
+static int queue_upload_part
+(
+    Espa_upload_t *upload    /* I/O: remote file */
+)
+{
+    char FUNC_NAME[] = "queue_upload_part"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    int nslots;              /* number of parts the ETags have room for */
+    char (*etags)[ESPA_UPLOAD_ETAG_LEN] = NULL;  /* grown ETags */
+    Espa_upload_part_t *part = NULL;  /* part being queued */
+
+    if (upload->upload_id == NULL &&
+        start_multipart_upload (upload) != SUCCESS)
+    {
+        fail_upload (upload);
+        return ERROR;   /* error message already written */
+    }
+    if (upload->nparts == ESPA_UPLOAD_MAX_PARTS)
+    {
+        snprintf (errmsg, sizeof (errmsg), "%s needs more than %d parts",
+            upload->file_name, ESPA_UPLOAD_MAX_PARTS);
+        error_handler (true, FUNC_NAME, errmsg);
+        fail_upload (upload);
+        return ERROR;
+    }
+
+    part = calloc (1, sizeof (Espa_upload_part_t));
+    if (part == NULL)
+    {
+        sprintf (errmsg, "Allocating memory for a part of the upload");
+        error_handler (true, FUNC_NAME, errmsg);
+        fail_upload (upload);
+        return ERROR;
+    }
+    part->number = upload->nparts + 1;
+    part->buf = upload->buf;
+    part->nbytes = upload->nbuf;
+
+    pthread_mutex_lock (&upload->mutex);
+    if (part->number > upload->etag_slots)
+    {
+        nslots = (upload->etag_slots > 0) ? 2 * upload->etag_slots : 64;
+        etags = realloc (upload->etags, nslots * sizeof (*etags));
+        if (etags != NULL)
+        {
+            upload->etags = etags;
+            upload->etag_slots = nslots;
+        }
+    }
+    while (!upload->failed && part->number <= upload->etag_slots &&
+        upload->ninflight >= upload->nthreads)
+        pthread_cond_wait (&upload->cond, &upload->mutex);
+    if (upload->failed || part->number > upload->etag_slots)
+    {
+        upload->failed = true;
+        pthread_mutex_unlock (&upload->mutex);
+        free (part);
+        snprintf (errmsg, sizeof (errmsg), "Uploading %s",
+            upload->file_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return ERROR;
+    }
+    if (upload->queue_tail == NULL)
+        upload->queue = part;
+    else
+        upload->queue_tail->next = part;
+    upload->queue_tail = part;
+    upload->ninflight++;
+    pthread_cond_broadcast (&upload->cond);
+    pthread_mutex_unlock (&upload->mutex);
+
+    /* The part is the threads' now; the next part starts empty, and larger
+       once enough parts are sent */
+    upload->nparts++;
+    upload->buf = NULL;
+    upload->buf_bytes = 0;
+    upload->nbuf = 0;
+    if (upload->nparts % ESPA_UPLOAD_GROW_PARTS == 0)
+        upload->part_bytes *= 2;
+
+    return SUCCESS;
+}
+
+
+/******************************************************************************
+MODULE: stop_upload_threads
+
+PURPOSE: Waits for the uploading threads to upload the queued parts, and
+stops them.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+*****************************************************************************/
+static void stop_upload_threads
+(
+    Espa_upload_t *upload    /* I/O: remote file */
+)
+{
+    int i;                   /* looping variable for the threads */
+
+    pthread_mutex_lock (&upload->mutex);
+    upload->done = true;
+    pthread_cond_broadcast (&upload->cond);
+    pthread_mutex_unlock (&upload->mutex);
+    for (i = 0; i < upload->nthreads; i++)
+        pthread_join (upload->threads[i], NULL);
+    upload->nthreads = 0;
+}
+
+
+/******************************************************************************
+MODULE: complete_multipart_upload
+
+PURPOSE: Completes the multipart upload of a remote file once its parts are
+uploaded, which makes the file appear.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error completing the upload
+SUCCESS      The upload was completed
+
+NOTES:
+*****************************************************************************/
+static int complete_multipart_upload
+(
+    Espa_upload_t *upload    /* I: remote file */
+)
+{
+    char FUNC_NAME[] = "complete_multipart_upload"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    char query[STR_SIZE];    /* query string of the request */
+    char *body = NULL;       /* list of the parts */
+    size_t nbody = 0;        /* number of bytes in the list */
+    int i;                   /* looping variable for the parts */
+    int status;              /* status of the request */
+    CURL *curl = NULL;       /* libcurl handle */
+    struct curl_slist *headers = NULL;  /* extra headers of the request */
+    Upload_request_t *req = NULL;  /* request */
+
+    body = malloc ((size_t) upload->nparts * (ESPA_UPLOAD_ETAG_LEN + 64) +
+        128);
+    req = calloc (1, sizeof (Upload_request_t));
+    snprintf (query, sizeof (query), "?uploadId=%s", upload->upload_id);
+    curl = (body != NULL && req != NULL) ? new_upload_handle (upload, query,
+        req, &headers) : NULL;
+    if (curl == NULL)
+    {
+        snprintf (errmsg, sizeof (errmsg), "Creating the connection for %s",
+            upload->file_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        free (body);
+        free (req);
+        return ERROR;
+    }
+
+    nbody += sprintf (body + nbody, "<CompleteMultipartUpload>");
+    for (i = 0; i < upload->nparts; i++)
+        nbody += sprintf (body + nbody, "<Part><PartNumber>%d</PartNumber>"
+            "<ETag>%s</ETag></Part>", i + 1, upload->etags[i]);
+    nbody += sprintf (body + nbody, "</CompleteMultipartUpload>");
+    curl_easy_setopt (curl, CURLOPT_POST, 1L);
+    curl_easy_setopt (curl, CURLOPT_POSTFIELDS, body);
+    curl_easy_setopt (curl, CURLOPT_POSTFIELDSIZE_LARGE, (curl_off_t) nbody);
+
+    status = perform_upload_request (curl, upload, req,
+        "Completing the multipart upload");
+    curl_easy_cleanup (curl);
+    curl_slist_free_all (headers);
+    free (body);
+    free (req);
+    return status;
+}
+
+
+/******************************************************************************
+MODULE: abort_multipart_upload
+
+PURPOSE: Aborts the multipart upload of a remote file, so the server drops
+the parts already uploaded.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. A failure is only a warning; S3 can also drop incomplete uploads by a
+     lifecycle rule of the bucket.
+*****************************************************************************/
+static void abort_multipart_upload
+(
+    Espa_upload_t *upload    /* I: remote file */
+)
+{
+    char FUNC_NAME[] = "abort_multipart_upload"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    char query[STR_SIZE];    /* query string of the request */
+    CURL *curl = NULL;       /* libcurl handle */
+    struct curl_slist *headers = NULL;  /* extra headers of the request */
+    Upload_request_t *req = NULL;  /* request */
+
+    req = calloc (1, sizeof (Upload_request_t));
+    snprintf (query, sizeof (query), "?uploadId=%s", upload->upload_id);
+    curl = (req != NULL) ? new_upload_handle (upload, query, req, &headers) :
+        NULL;
+    if (curl != NULL)
+    {
+        curl_easy_setopt (curl, CURLOPT_CUSTOMREQUEST, "DELETE");
+        if (perform_upload_request (curl, upload, req, "Aborting the "
+            "multipart upload") == SUCCESS)
+        {
+            curl_easy_cleanup (curl);
+            curl_slist_free_all (headers);
+            free (req);
+            return;
+        }
+        curl_easy_cleanup (curl);
+        curl_slist_free_all (headers);
+    }
+    free (req);
+
+    snprintf (errmsg, sizeof (errmsg), "The parts of the failed upload of %s "
+        "may be kept by the server", upload->file_name);
+    error_handler (false, FUNC_NAME, errmsg);
+}
+
+
+/******************************************************************************
+MODULE: free_upload
+
+PURPOSE: Frees a remote file being written.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. The uploading threads need to be stopped.
+*****************************************************************************/
+static void free_upload
+(
+    Espa_upload_t *upload    /* I: remote file */
+)
+{
+    Espa_upload_part_t *part = NULL;  /* part left in the queue */
+
+    while (upload->queue != NULL)
+    {
+        part = upload->queue;
+        upload->queue = part->next;
+        espa_trace_free (part->buf);
+        free (part);
+    }
+    if (upload->upload_id != NULL)
+        curl_free (upload->upload_id);
+    pthread_mutex_destroy (&upload->mutex);
+    pthread_cond_destroy (&upload->cond);
+    espa_trace_free (upload->buf);
+    free (upload->etags);
+    free (upload->threads);
+    free (upload);
+}
+#endif
+
+
+/******************************************************************************
+MODULE: open_espa_upload
+
+PURPOSE: Opens a remote file for writing.
+
+RETURN VALUE:
+Type = Espa_upload_t *
+Value        Description
+-----        -----------
+NULL         Error opening the remote file
+non-NULL     The remote file; complete it with close_espa_upload, or discard
+             it with abort_espa_upload
+
+NOTES:
+  1. Nothing is sent until the first part is full, or the file is closed.
+*****************************************************************************/
+Espa_upload_t *open_espa_upload
+(
+    const char *file_name    /* I: URL of the remote file to be written */
+)
+{
+    char FUNC_NAME[] = "open_espa_upload"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+#ifdef HAVE_LIBCURL
+    int part_mb;             /* size of the first parts (MB) */
+    Espa_upload_t *upload = NULL;  /* remote file */
+
+    espa_remote_init ();
+
+    upload = calloc (1, sizeof (Espa_upload_t));
+    if (upload == NULL)
+    {
+        sprintf (errmsg, "Allocating memory for the remote file");
+        error_handler (true, FUNC_NAME, errmsg);
+        return NULL;
+    }
+    snprintf (upload->file_name, sizeof (upload->file_name), "%s",
+        file_name);
+    if (resolve_remote_url (file_name, upload->url, &upload->sign)
+        != SUCCESS)
+    {
+        snprintf (errmsg, sizeof (errmsg), "Opening the remote file %s",
+            file_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        free (upload);
+        return NULL;
+    }
+
+    part_mb = remote_env (ESPA_UPLOAD_PART_MB_ENV,
+        ESPA_UPLOAD_DEFAULT_PART_MB);
+    if (part_mb < ESPA_UPLOAD_MIN_PART_MB)
+        part_mb = ESPA_UPLOAD_MIN_PART_MB;
+    upload->part_bytes = (size_t) part_mb * 1048576;
+    pthread_mutex_init (&upload->mutex, NULL);
+    pthread_cond_init (&upload->cond, NULL);
+
+    return upload;
+#else
+    snprintf (errmsg, sizeof (errmsg), "Writing the remote file %s requires "
+        "the library to be built with ENABLE_REMOTE=yes", file_name);
+    error_handler (true, FUNC_NAME, errmsg);
+    return NULL;
+#endif
+}
+
+
+/******************************************************************************
+MODULE: write_espa_upload
+
+PURPOSE: Appends bytes to a remote file.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error writing the bytes, or an earlier part failed to upload
+SUCCESS      The bytes were written
+
+NOTES:
+  1. The bytes are copied, so the caller may reuse its buffer on return.
+*****************************************************************************/
+int write_espa_upload
+(
+    Espa_upload_t *upload,   /* I/O: remote file being written */
+    const void *buf,         /* I: bytes to be appended to the file */
+    size_t nbytes            /* I: number of bytes to be appended */
+)
+{
+    char FUNC_NAME[] = "write_espa_upload"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+#ifdef HAVE_LIBCURL
+    size_t chunk;            /* number of bytes copied into the part */
+    size_t buf_bytes;        /* grown size of the buffer of the part */
+    char *part_buf = NULL;   /* grown buffer of the part */
+    const char *ptr = (const char *) buf;  /* next byte to be copied */
+
+    while (nbytes > 0)
+    {
+        /* Grow the buffer of the part, up to the size of the part */
+        if (upload->nbuf == upload->buf_bytes)
+        {
+            buf_bytes = (upload->buf_bytes > 0) ? 2 * upload->buf_bytes :
+                UPLOAD_MIN_BUF_BYTES;
+            if (buf_bytes < upload->nbuf + nbytes)
+                buf_bytes = upload->nbuf + nbytes;
+            if (buf_bytes > upload->part_bytes)
+                buf_bytes = upload->part_bytes;
+            part_buf = espa_trace_realloc (upload->buf, buf_bytes);
+            if (part_buf == NULL)
+            {
+                snprintf (errmsg, sizeof (errmsg), "Allocating %zu bytes for "
+                    "a part of %s", buf_bytes, upload->file_name);
+                error_handler (true, FUNC_NAME, errmsg);
+                fail_upload (upload);
+                return ERROR;
+            }
+            upload->buf = part_buf;
+            upload->buf_bytes = buf_bytes;
+        }
+
+        chunk = upload->buf_bytes - upload->nbuf;
+        if (chunk > nbytes)
+            chunk = nbytes;
+        memcpy (upload->buf + upload->nbuf, ptr, chunk);
+        upload->nbuf += chunk;
+        upload->nbytes += chunk;
+        ptr += chunk;
+        nbytes -= chunk;
+
+        if (upload->nbuf == upload->part_bytes &&
+            queue_upload_part (upload) != SUCCESS)
+            return ERROR;   /* error message already written */
+    }
+
+    return SUCCESS;
+#else
+    sprintf (errmsg, "Writing remote files requires the library to be built "
+        "with ENABLE_REMOTE=yes");
+    error_handler (true, FUNC_NAME, errmsg);
+    return ERROR;
+#endif
+}
+
+
+/******************************************************************************
+MODULE: close_espa_upload
+
+PURPOSE: Completes a remote file once its last part is uploaded, and frees
+it.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error uploading the file; the upload is aborted
+SUCCESS      The file was written
+
+NOTES:
+  1. The remote file is freed even if an error occurs.  A file which failed
+     to be written is aborted.
+*****************************************************************************/
+int close_espa_upload
+(
+    Espa_upload_t *upload    /* I: remote file to be completed and freed */
+)
+{
+    char FUNC_NAME[] = "close_espa_upload"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+#ifdef HAVE_LIBCURL
+    int status = SUCCESS;    /* status of the close */
+    bool failed;             /* did an earlier write fail? */
+
+    if (upload == NULL)
+        return SUCCESS;
+
+    pthread_mutex_lock (&upload->mutex);
+    failed = upload->failed;
+    pthread_mutex_unlock (&upload->mutex);
+    if (failed)
+    {
+        snprintf (errmsg, sizeof (errmsg), "Uploading %s",
+            upload->file_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        abort_espa_upload (upload);
+        return ERROR;
+    }
+
+    /* A file smaller than a part is written in one request */
+    if (upload->upload_id == NULL)
+    {
+        status = put_upload_object (upload);
+        free_upload (upload);
+        return status;
+    }
+
+    if (upload->nbuf > 0 && queue_upload_part (upload) != SUCCESS)
+        status = ERROR;
+    stop_upload_threads (upload);
+    if (status == SUCCESS && upload->failed)
+    {
+        snprintf (errmsg, sizeof (errmsg), "Uploading the parts of %s",
+            upload->file_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        status = ERROR;
+    }
+    if (status == SUCCESS)
+        status = complete_multipart_upload (upload);
+    if (status != SUCCESS)
+        abort_multipart_upload (upload);
+
+    free_upload (upload);
+    return status;
+#else
+    sprintf (errmsg, "Writing remote files requires the library to be built "
+        "with ENABLE_REMOTE=yes");
+    error_handler (true, FUNC_NAME, errmsg);
+    return ERROR;
+#endif
+}
+
+
+/******************************************************************************
+MODULE: abort_espa_upload
+
+PURPOSE: Discards a remote file being written, and frees it.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. A file which was never completed doesn't appear, and any parts already
+     uploaded are dropped.
+*****************************************************************************/
+void abort_espa_upload
+(
+    Espa_upload_t *upload    /* I: remote file to be discarded and freed */
+)
+{
+#ifdef HAVE_LIBCURL
+    if (upload == NULL)
+        return;
+
+    pthread_mutex_lock (&upload->mutex);
+    upload->failed = true;
+    pthread_mutex_unlock (&upload->mutex);
+    stop_upload_threads (upload);
+    if (upload->upload_id != NULL)
+        abort_multipart_upload (upload);
+    free_upload (upload);
+#endif
+}
+
+
+/******************************************************************************
+MODULE: upload_espa_file
+
+PURPOSE: Copies a local file to a remote file.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error copying the file
+SUCCESS      The file was copied
+
+NOTES:
+  1. Meant for the outputs which are written by libraries needing a local
+     file (ex. NetCDF and HDF, which go back to update their headers).  The
+     file is read as it is uploaded, so only the parts in flight are held in
+     memory.
+*****************************************************************************/
+int upload_espa_file
+(
+    const char *local_file,  /* I: name of the local file to be uploaded */
+    const char *file_name    /* I: URL of the remote file to be written */
+)
+{
+    char FUNC_NAME[] = "upload_espa_file"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    char *buf = NULL;        /* bytes read from the local file */
+    size_t buf_bytes = 1048576;  /* size of the reads */
+    ssize_t nread;           /* number of bytes read */
+    int fd;                  /* file descriptor of the local file */
+    int status = SUCCESS;    /* status of the copy */
+    Espa_upload_t *upload = NULL;  /* remote file */
+
+    fd = open (local_file, O_RDONLY);
+    if (fd == -1)
+    {
+        snprintf (errmsg, sizeof (errmsg), "Opening %s", local_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return ERROR;
+    }
+    buf = malloc (buf_bytes);
+    upload = (buf != NULL) ? open_espa_upload (file_name) : NULL;
+    if (upload == NULL)
+    {
+        snprintf (errmsg, sizeof (errmsg), "Setting up the upload of %s to "
+            "%s", local_file, file_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        free (buf);
+        close (fd);
+        return ERROR;
+    }
+
+    while ((nread = read (fd, buf, buf_bytes)) != 0)
+    {
+        if (nread < 0 || write_espa_upload (upload, buf, nread) != SUCCESS)
+        {
+            status = ERROR;
+            break;
+        }
+    }
+    free (buf);
+    close (fd);
+
+    if (status == SUCCESS)
+        status = close_espa_upload (upload);
+    else
+        abort_espa_upload (upload);
+    if (status != SUCCESS)
+    {
+        snprintf (errmsg, sizeof (errmsg), "Uploading %s to %s", local_file,
+            file_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return ERROR;
+    }
+
+    return SUCCESS;
+}
@@ -0,0 +1,123 @@
+/*****************************************************************************
+FILE: espa_upload.h
+
+PURPOSE: Contains defines and structures for writing output files to object
+storage (S3) as multipart uploads, streaming each part while the rest of the
+file is still being produced, so cloud deliveries don't need to land on
+local disk first.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The output files are named by URLs as the remote input files are (see
+     espa_remote.h), and the requests are signed the same way.  The server
+     needs to support the S3 multipart upload API.
+  2. Writing remote files is only available if the library was built with
+     ENABLE_REMOTE=yes (which defines HAVE_LIBCURL).
+  3. The bytes are appended in order.  Each part of ESPA_UPLOAD_PART_MB is
+     handed to one of ESPA_UPLOAD_CONNECTIONS threads, each with its own
+     connection, once it is full, and the writer only waits when all the
+     threads are busy.  With a memory budget (see espa_trace.h), there are
+     no more threads than parts in flight fit in the memory left.
+  4. The multipart upload is only started once the first part is full, so
+     a file smaller than a part is sent with a single request.  The parts
+     after every ESPA_UPLOAD_GROW_PARTS are twice as large, so a file of any
+     size fits in the ESPA_UPLOAD_MAX_PARTS parts S3 allows.
+  5. The object only appears once the file is closed.  A file which fails,
+     or is aborted, has its upload aborted so the parts already sent aren't
+     kept (and billed) by the server.
+*****************************************************************************/
+
+#ifndef ESPA_UPLOAD_H
+#define ESPA_UPLOAD_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include "error_handler.h"
+
+/* Environment variables overriding the defaults of the uploads */
+#define ESPA_UPLOAD_PART_MB_ENV "ESPA_UPLOAD_PART_MB"
+#define ESPA_UPLOAD_CONNECTIONS_ENV "ESPA_UPLOAD_CONNECTIONS"
+
+/* Defaults and limits of the uploads */
+#define ESPA_UPLOAD_DEFAULT_PART_MB 16    /* size of the first parts */
+#define ESPA_UPLOAD_MIN_PART_MB 5         /* smallest part S3 takes (other
+                                             than the last) */
+#define ESPA_UPLOAD_DEFAULT_CONNECTIONS 4 /* concurrent part uploads */
+#define ESPA_UPLOAD_MAX_PARTS 10000       /* most parts S3 takes */
+#define ESPA_UPLOAD_GROW_PARTS 1000       /* parts between size doublings */
+#define ESPA_UPLOAD_ETAG_LEN 128          /* longest ETag of a part */
+
+/* Part of a file waiting to be uploaded */
+typedef struct Espa_upload_part
+{
+    int number;              /* 1-based number of the part */
+    char *buf;               /* bytes of the part */
+    size_t nbytes;           /* number of bytes in the part */
+    struct Espa_upload_part *next;  /* next part in the queue */
+} Espa_upload_part_t;
+
+/* Remote file being written */
+typedef struct
+{
+    char file_name[STR_SIZE];  /* URL of the file, for messages */
+    char url[STR_SIZE];      /* http(s) URL of the file */
+    bool sign;               /* are the requests signed for S3? */
+    char *upload_id;         /* URL-escaped id of the multipart upload;
+                                NULL until the first part is full */
+    size_t part_bytes;       /* size of the part being filled */
+    char *buf;               /* bytes of the part being filled */
+    size_t buf_bytes;        /* size of buf, which grows up to part_bytes */
+    size_t nbuf;             /* number of bytes in buf */
+    off_t nbytes;            /* number of bytes written so far */
+    int nparts;              /* number of parts handed to the threads */
+    char (*etags)[ESPA_UPLOAD_ETAG_LEN];  /* ETag of each uploaded part */
+    int etag_slots;          /* number of parts etags has room for */
+    Espa_upload_part_t *queue;       /* parts waiting for a thread */
+    Espa_upload_part_t *queue_tail;  /* last part in the queue */
+    int ninflight;           /* number of parts queued or uploading */
+    int nthreads;            /* number of uploading threads */
+    pthread_t *threads;      /* uploading threads */
+    pthread_mutex_t mutex;   /* guards the queue, the ETags, and the flags */
+    pthread_cond_t cond;     /* signaled when the queue changes */
+    bool done;               /* should the uploading threads exit? */
+    bool failed;             /* did a part fail to upload? */
+} Espa_upload_t;
+
+/* Prototypes */
+Espa_upload_t *open_espa_upload
+(
+    const char *file_name    /* I: URL of the remote file to be written */
+);
+
+int write_espa_upload
+(
+    Espa_upload_t *upload,   /* I/O: remote file being written */
+    const void *buf,         /* I: bytes to be appended to the file */
+    size_t nbytes            /* I: number of bytes to be appended */
+);
+
+int close_espa_upload
+(
+    Espa_upload_t *upload    /* I: remote file to be completed and freed */
+);
+
+void abort_espa_upload
+(
+    Espa_upload_t *upload    /* I: remote file to be discarded and freed */
+);
+
+int upload_espa_file
+(
+    const char *local_file,  /* I: name of the local file to be uploaded */
+    const char *file_name    /* I: URL of the remote file to be written */
+);
+
+#endif
@@ -17,6 +17,7 @@ NOTES:
 /* GCTP projection numbers for ESPA projections (match proj.h from GCTP) */
 #define GCTP_GEO_PROJ    0
 #define GCTP_UTM_PROJ    1
+#define GCTP_SPCS_PROJ   2     /* state plane; not an ESPA projection */
 #define GCTP_ALBERS_PROJ 3
 #define GCTP_PS_PROJ     6
 #define GCTP_SIN_PROJ    16
@@ -0,0 +1,200 @@
+#! /usr/bin/env python
+import sys
+import os
+
+#############################################################################
+# Generates meta_element.h and meta_element.c, the perfect hash from the
+# element names of the ESPA and Sentinel metadata files to the element IDs
+# used by the metadata parsers.
+#
+# The hash is a two-level "hash and displace" table: the FNV-1a hash of the
+# name selects a bucket, and the displacement stored for that bucket is XORed
+# with the rest of the hash, which is scrambled by a multiplicative hash to
+# select the slot.  The displacements are
+# searched for here so that no two names share a slot, which leaves a lookup
+# with one hash of the name and one string comparison.
+#
+# Usage: gen_meta_element.py  (run from the io_libs directory after adding
+#     a name to ELEMENTS, then commit the regenerated files)
+############################################################################
+
+# Element names, as they appear in the metadata files
+ELEMENTS = [
+    # ESPA internal metadata
+    'acquisition_date', 'albers_proj_params', 'app_version', 'band', 'bands',
+    'bit', 'bitmap_description', 'bounding_coordinates', 'central_meridian',
+    'class', 'class_values', 'corner', 'corner_point', 'cover',
+    'data_provider', 'data_units', 'earth_sun_distance', 'east',
+    'false_easting', 'false_northing', 'file_name', 'footprint',
+    'global_metadata', 'grid_origin', 'histogram', 'instrument', 'latitude_true_scale',
+    'level1_filename', 'level1_production_date', 'long_name',
+    'longitude_pole', 'lpgs_metadata_file', 'modis', 'north',
+    'orientation_angle', 'origin_latitude', 'percent_coverage', 'pixel_size',
+    'product_id', 'production_date', 'projection_information',
+    'ps_proj_params', 'qa_description', 'radiance', 'reflectance',
+    'resample_method', 'satellite', 'scene_center_time', 'short_name',
+    'sin_proj_params', 'solar_angles', 'south', 'sphere_radius',
+    'standard_parallel1', 'standard_parallel2', 'statistics', 'thermal_const',
+    'utm_proj_params', 'valid_range', 'view_angles', 'west', 'wrs',
+    'zone_code',
+
+    # Sentinel-2 product and tile metadata
+    'AZIMUTH_ANGLE', 'EXT_POS_LIST', 'GENERATION_TIME', 'Geoposition',
+    'HORIZONTAL_CS_NAME', 'IMAGE_FILE', 'IMAGE_ID', 'Mean_Sun_Angle',
+    'Mean_Viewing_Incidence_Angle', 'NCOLS', 'NROWS', 'PROCESSING_BASELINE',
+    'PRODUCT_TYPE', 'QUANTIFICATION_VALUE', 'SENSING_TIME', 'SPACECRAFT_NAME',
+    'Size', 'Tile_Geocoding', 'ULX', 'ULY', 'ZENITH_ANGLE',
+]
+
+NSLOTS = 256          # number of slots in the table; the slot is the top
+                      # byte of the multiplicative hash
+NBUCKETS = 64         # number of displacement buckets (a power of 2)
+HEADER = '''/*****************************************************************************
+FILE: meta_element.%s
+
+PURPOSE: %s
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. Generated by gen_meta_element.py.  Don't edit this file; add the
+     element name to the generator and rerun it instead.
+*****************************************************************************/
+'''
+
+
+def fnv1a(name):
+    hash = 2166136261
+    for c in bytearray(name.encode('ascii')):
+        hash ^= c
+        hash = (hash * 16777619) & 0xffffffff
+    return hash
+
+
+def slot_of(hash, disp):
+    return ((((hash >> 6) ^ disp) * 2654435761) & 0xffffffff) >> 24
+
+
+def build_table():
+    buckets = [[] for i in range(NBUCKETS)]
+    for name in ELEMENTS:
+        buckets[fnv1a(name) & (NBUCKETS - 1)].append(name)
+
+    # Place the fullest buckets first, while the table is emptiest
+    slots = [None] * NSLOTS
+    disp = [0] * NBUCKETS
+    order = sorted(range(NBUCKETS), key=lambda b: -len(buckets[b]))
+    for b in order:
+        if not buckets[b]:
+            continue
+        for d in range(NSLOTS):
+            wanted = [slot_of(fnv1a(name), d) for name in buckets[b]]
+            if len(set(wanted)) == len(wanted) and \
+                all(slots[s] is None for s in wanted):
+                break
+        else:
+            sys.exit('No displacement found; increase NSLOTS')
+        disp[b] = d
+        for name, s in zip(buckets[b], wanted):
+            slots[s] = name
+    return disp, slots
+
+
+def enum_name(name):
+    return 'ESPA_ELEM_' + name.upper()
+
+
+def main():
+    if len(set(ELEMENTS)) != len(ELEMENTS) or \
+        len(set(map(enum_name, ELEMENTS))) != len(ELEMENTS):
+        sys.exit('Duplicate element names')
+    disp, slots = build_table()
+    ids = sorted(ELEMENTS, key=lambda n: n.lower())
+
+    h = [HEADER % ('h', 'Contains the element IDs of the ESPA and Sentinel '
+        'metadata files,\nand the prototype for looking them up by element '
+        'name.')]
+    h.append('#ifndef META_ELEMENT_H\n#define META_ELEMENT_H\n\n')
+    h.append('#include <libxml/tree.h>\n\n')
+    h.append('/* Element IDs; ESPA_ELEM_UNKNOWN for any other name */\n')
+    h.append('typedef enum\n{\n    ESPA_ELEM_UNKNOWN = 0,\n')
+    for name in ids:
+        h.append('    %s,\n' % enum_name(name))
+    h.append('    ESPA_ELEM_COUNT\n} Espa_meta_element_t;\n\n')
+    h.append('/* Prototypes */\nEspa_meta_element_t lookup_meta_element\n(\n'
+        '    const xmlChar *name   /* I: name of the element */\n);\n\n'
+        '#endif\n')
+
+    c = [HEADER % ('c', 'Contains the perfect hash from the element names '
+        'of the ESPA and\nSentinel metadata files to their element IDs.')]
+    c.append('\n#include <stdint.h>\n#include <string.h>\n'
+        '#include "meta_element.h"\n\n')
+    c.append('#define NSLOTS %d\n#define NBUCKETS %d\n\n' % (NSLOTS, NBUCKETS))
+    c.append('/* Displacement of each bucket */\n'
+        'static const uint8_t bucket_disp[NBUCKETS] =\n{\n')
+    for i in range(0, NBUCKETS, 12):
+        c.append('    ' + ', '.join('%d' % d for d in disp[i:i+12]) + ',\n')
+    c.append('};\n\n')
+    c.append('/* Name and ID of the element in each slot */\n'
+        'static const struct\n{\n    const char *name;\n'
+        '    Espa_meta_element_t id;\n} slot_element[NSLOTS] =\n{\n')
+    for s, name in enumerate(slots):
+        if name is not None:
+            c.append('    [%d] = {"%s", %s},\n' % (s, name, enum_name(name)))
+    c.append('};\n\n')
+    c.append('''
+/******************************************************************************
+MODULE:  lookup_meta_element
+
+PURPOSE: Looks up the element ID of an element name.
+
+RETURN VALUE:
+Type = Espa_meta_element_t
+Value               Description
+-----               -----------
+ESPA_ELEM_UNKNOWN   The name isn't a known element
+ESPA_ELEM_*         ID of the element
+
+NOTES:
+  1. The name is hashed once and compared against the single element which
+     could match it, however many elements are known.
+******************************************************************************/
+Espa_meta_element_t lookup_meta_element
+(
+    const xmlChar *name   /* I: name of the element */
+)
+{
+    const unsigned char *ptr = name;  /* current character of the name */
+    uint32_t hash = 2166136261u;      /* FNV-1a hash of the name */
+    int slot;                         /* slot of the name in the table */
+
+    if (name == NULL)
+        return (ESPA_ELEM_UNKNOWN);
+
+    for (; *ptr; ptr++)
+    {
+        hash ^= *ptr;
+        hash *= 16777619u;
+    }
+
+    slot = (((hash >> 6) ^ bucket_disp[hash & (NBUCKETS - 1)]) *
+        2654435761u) >> 24;
+    if (slot_element[slot].name == NULL ||
+        strcmp (slot_element[slot].name, (const char *) name) != 0)
+        return (ESPA_ELEM_UNKNOWN);
+
+    return (slot_element[slot].id);
+}
+''')
+
+    for fname, text in (('meta_element.h', h), ('meta_element.c', c)):
+        with open(fname, 'wb') as out:
+            out.write(''.join(text).replace('\n', '\r\n').encode('ascii'))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
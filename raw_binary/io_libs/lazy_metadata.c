@@ -0,0 +1,367 @@
+/*****************************************************************************
+FILE: lazy_metadata.c
+  
+PURPOSE: Contains functions for lazily loading the ESPA internal metadata.
+The metadata file is read into a document tree once, the global metadata is
+parsed, and the band elements are indexed by product and name.  The full band
+metadata is decoded from the tree only when a band is requested.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. Bands are decoded with the same element parsers as parse_metadata, so a
+     loaded band is identical to the band parse_metadata would return.
+*****************************************************************************/
+
+#include "lazy_metadata.h"
+
+/******************************************************************************
+MODULE:  copy_band_attribute
+
+PURPOSE: Copies an attribute of a band element into the band metadata.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Attribute overflows the band metadata field
+SUCCESS         Attribute was copied, or doesn't exist for the band
+
+NOTES:
+******************************************************************************/
+static int copy_band_attribute
+(
+    xmlNodePtr node,             /* I: band element */
+    const char *attr_name,       /* I: name of the attribute */
+    char *value                  /* O: value of the attribute (STR_SIZE) */
+)
+{
+    char FUNC_NAME[] = "copy_band_attribute";  /* function name */
+    char errmsg[STR_SIZE];       /* error message */
+    xmlChar *attr_val = NULL;    /* attribute value */
+    int count;                   /* number of chars copied in snprintf */
+
+    attr_val = xmlGetProp (node, (const xmlChar *) attr_name);
+    if (attr_val == NULL)
+        return (SUCCESS);
+
+    count = snprintf (value, STR_SIZE, "%s", (const char *) attr_val);
+    xmlFree (attr_val);
+    if (count < 0 || count >= STR_SIZE)
+    {
+        sprintf (errmsg, "Overflow of the band %s string", attr_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  open_lazy_metadata
+
+PURPOSE: Reads the metadata file, optionally validates it, parses the global
+metadata, and indexes the band elements without decoding them.
+
+RETURN VALUE:
+Type = Espa_lazy_meta_t *
+Value           Description
+-----           -----------
+NULL            Error reading, validating, or parsing the metadata file
+non-NULL        Lazily loaded metadata
+
+NOTES:
+  1. The global_metadata and bands elements are expected to be children of
+     the root element, as required by the ESPA schema.
+******************************************************************************/
+Espa_lazy_meta_t *open_lazy_metadata
+(
+    char *metafile,              /* I: input metadata file or URL */
+    bool validate                /* I: validate the metadata file against the
+                                       ESPA schema? */
+)
+{
+    char FUNC_NAME[] = "open_lazy_metadata";  /* function name */
+    char errmsg[STR_SIZE];       /* error message */
+    Espa_lazy_meta_t *lazy = NULL; /* lazily loaded metadata */
+    xmlNodePtr root = NULL;      /* root element of the document */
+    xmlNodePtr section = NULL;   /* current child of the root element */
+    xmlNodePtr node = NULL;      /* current element within the section */
+    xmlNsPtr ns = NULL;          /* namespace of the root element */
+    int nbands = 0;              /* number of band elements */
+    int i;                       /* current band */
+    int count;                   /* number of chars copied in snprintf */
+
+    lazy = calloc (1, sizeof (Espa_lazy_meta_t));
+    if (lazy == NULL)
+    {
+        sprintf (errmsg, "Allocating the lazily loaded metadata");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (NULL);
+    }
+    init_metadata_struct (&lazy->meta);
+
+    /* Load the XML file and parse it to the document tree.  Blank text nodes
+       are dropped to match the tree built by parse_metadata. */
+    lazy->doc = xmlReadFile (metafile, NULL, XML_PARSE_NOBLANKS);
+    if (lazy->doc == NULL)
+    {
+        sprintf (errmsg, "Could not parse %s", metafile);
+        error_handler (true, FUNC_NAME, errmsg);
+        close_lazy_metadata (lazy);
+        return (NULL);
+    }
+
+    if (validate && validate_xml_doc (lazy->doc, metafile) != SUCCESS)
+    {
+        sprintf (errmsg, "Validating %s", metafile);
+        error_handler (true, FUNC_NAME, errmsg);
+        close_lazy_metadata (lazy);
+        return (NULL);
+    }
+
+    /* Store the namespace for the overall metadata file */
+    root = xmlDocGetRootElement (lazy->doc);
+    if (root != NULL)
+        ns = get_node_namespace (root);
+    if (ns == NULL)
+    {
+        sprintf (errmsg, "Metadata document does not have a namespace");
+        error_handler (true, FUNC_NAME, errmsg);
+        close_lazy_metadata (lazy);
+        return (NULL);
+    }
+    count = snprintf (lazy->meta.meta_namespace,
+        sizeof (lazy->meta.meta_namespace), "%s", (const char *) ns->href);
+    if (count < 0 || count >= sizeof (lazy->meta.meta_namespace))
+    {
+        sprintf (errmsg, "Overflow of metadata->meta_namespace string");
+        error_handler (true, FUNC_NAME, errmsg);
+        close_lazy_metadata (lazy);
+        return (NULL);
+    }
+
+    for (section = xmlFirstElementChild (root); section;
+         section = xmlNextElementSibling (section))
+    {
+        /* Parse the global metadata */
+        if (xmlStrEqual (section->name, (const xmlChar *) "global_metadata"))
+        {
+            for (node = xmlFirstElementChild (section); node;
+                 node = xmlNextElementSibling (node))
+            {
+                if (add_global_metadata (node, &lazy->meta.global))
+                {
+                    sprintf (errmsg, "Consuming global_metadata element "
+                        "'%s'.", node->name);
+                    error_handler (true, FUNC_NAME, errmsg);
+                    close_lazy_metadata (lazy);
+                    return (NULL);
+                }
+            }
+        }
+
+        /* Index the band elements */
+        else if (xmlStrEqual (section->name, (const xmlChar *) "bands") &&
+            lazy->band_node == NULL)
+        {
+            nbands = 0;
+            for (node = xmlFirstElementChild (section); node;
+                 node = xmlNextElementSibling (node))
+            {
+                if (xmlStrEqual (node->name, (const xmlChar *) "band"))
+                    nbands++;
+            }
+
+            if (allocate_band_metadata (&lazy->meta, nbands) != SUCCESS)
+            {   /* Error messages already printed */
+                close_lazy_metadata (lazy);
+                return (NULL);
+            }
+            lazy->band_node = calloc (nbands + 1, sizeof (xmlNodePtr));
+            lazy->band_loaded = calloc (nbands + 1, sizeof (bool));
+            if (lazy->band_node == NULL || lazy->band_loaded == NULL)
+            {
+                sprintf (errmsg, "Allocating the band index for %d bands",
+                    nbands);
+                error_handler (true, FUNC_NAME, errmsg);
+                close_lazy_metadata (lazy);
+                return (NULL);
+            }
+
+            i = 0;
+            for (node = xmlFirstElementChild (section); node;
+                 node = xmlNextElementSibling (node))
+            {
+                if (!xmlStrEqual (node->name, (const xmlChar *) "band"))
+                    continue;
+                lazy->band_node[i] = node;
+                if (copy_band_attribute (node, "product",
+                    lazy->meta.band[i].product) != SUCCESS ||
+                    copy_band_attribute (node, "name",
+                    lazy->meta.band[i].name) != SUCCESS)
+                {
+                    sprintf (errmsg, "Indexing band %d", i);
+                    error_handler (true, FUNC_NAME, errmsg);
+                    close_lazy_metadata (lazy);
+                    return (NULL);
+                }
+                i++;
+            }
+        }
+    }
+
+    return (lazy);
+}
+
+
+/******************************************************************************
+MODULE:  find_lazy_band
+
+PURPOSE: Finds a band in the metadata by name, without decoding it.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+-1              Band was not found
+>= 0            Index of the band in the metadata
+
+NOTES:
+  1. The first band matching the name (and product, if specified) is
+     returned.
+******************************************************************************/
+int find_lazy_band
+(
+    Espa_lazy_meta_t *lazy,      /* I: lazily loaded metadata */
+    const char *name,            /* I: name of the band (ex. b1) */
+    const char *product          /* I: product of the band; NULL for any */
+)
+{
+    int i;                       /* looping variable for the bands */
+
+    for (i = 0; i < lazy->meta.nbands; i++)
+    {
+        if (!strcmp (lazy->meta.band[i].name, name) &&
+            (product == NULL || !strcmp (lazy->meta.band[i].product, product)))
+            return (i);
+    }
+
+    return (-1);
+}
+
+
+/******************************************************************************
+MODULE:  get_lazy_band
+
+PURPOSE: Returns the metadata for a band, decoding it the first time it is
+requested.
+
+RETURN VALUE:
+Type = Espa_band_meta_t *
+Value           Description
+-----           -----------
+NULL            Invalid band index or error decoding the band
+non-NULL        Fully decoded band metadata
+
+NOTES:
+  1. The returned metadata is owned by the lazily loaded metadata.
+******************************************************************************/
+Espa_band_meta_t *get_lazy_band
+(
+    Espa_lazy_meta_t *lazy,      /* I: lazily loaded metadata */
+    int band_index               /* I: index of the band in the metadata */
+)
+{
+    char FUNC_NAME[] = "get_lazy_band";  /* function name */
+    char errmsg[STR_SIZE];       /* error message */
+    Espa_band_meta_t *bmeta = NULL; /* metadata for the band */
+
+    if (band_index < 0 || band_index >= lazy->meta.nbands)
+    {
+        sprintf (errmsg, "Band index %d is out of range (%d bands)",
+            band_index, lazy->meta.nbands);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (NULL);
+    }
+
+    bmeta = &lazy->meta.band[band_index];
+    if (lazy->band_loaded[band_index])
+        return (bmeta);
+
+    if (add_band_metadata (lazy->band_node[band_index], bmeta))
+    {
+        sprintf (errmsg, "Decoding the metadata for band %s", bmeta->name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (NULL);
+    }
+    lazy->band_loaded[band_index] = true;
+
+    return (bmeta);
+}
+
+
+/******************************************************************************
+MODULE:  load_all_lazy_bands
+
+PURPOSE: Decodes all the bands which haven't yet been loaded, so the
+metadata can be used wherever a fully parsed Espa_internal_meta_t is
+expected (i.e. to write out the metadata).
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error decoding a band
+SUCCESS         All the bands were decoded
+
+NOTES:
+******************************************************************************/
+int load_all_lazy_bands
+(
+    Espa_lazy_meta_t *lazy       /* I: lazily loaded metadata */
+)
+{
+    int i;                       /* looping variable for the bands */
+
+    for (i = 0; i < lazy->meta.nbands; i++)
+    {
+        if (get_lazy_band (lazy, i) == NULL)
+            return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  close_lazy_metadata
+
+PURPOSE: Frees the lazily loaded metadata, including the document tree and
+the band metadata.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+void close_lazy_metadata
+(
+    Espa_lazy_meta_t *lazy       /* I: lazily loaded metadata to be freed */
+)
+{
+    if (lazy == NULL)
+        return;
+
+    if (lazy->doc != NULL)
+        xmlFreeDoc (lazy->doc);
+    free_metadata (&lazy->meta);
+    free (lazy->band_node);
+    free (lazy->band_loaded);
+    free (lazy);
+    cleanup_espa_xml ();
+}
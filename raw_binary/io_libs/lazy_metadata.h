@@ -0,0 +1,73 @@
+/*****************************************************************************
+FILE: lazy_metadata.h
+  
+PURPOSE: Contains structures and prototypes for lazily loading the ESPA
+internal metadata, where the global metadata is parsed up front and each band
+is only decoded once it is requested.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. Until a band has been loaded, only its product and name are populated in
+     the band metadata; the remaining fields are fill.
+*****************************************************************************/
+
+#ifndef LAZY_METADATA_H
+#define LAZY_METADATA_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <libxml/parser.h>
+#include <libxml/tree.h>
+#include "error_handler.h"
+#include "espa_metadata.h"
+#include "parse_metadata.h"
+
+/* Lazily loaded ESPA internal metadata */
+typedef struct
+{
+    xmlDocPtr doc;               /* document tree of the metadata file, kept
+                                    until the metadata is closed */
+    Espa_internal_meta_t meta;   /* global metadata and the metadata for each
+                                    band (see NOTES above) */
+    xmlNodePtr *band_node;       /* band element for each band */
+    bool *band_loaded;           /* has each band been fully decoded? */
+} Espa_lazy_meta_t;
+
+/* Prototypes */
+Espa_lazy_meta_t *open_lazy_metadata
+(
+    char *metafile,              /* I: input metadata file or URL */
+    bool validate                /* I: validate the metadata file against the
+                                       ESPA schema? */
+);
+
+int find_lazy_band
+(
+    Espa_lazy_meta_t *lazy,      /* I: lazily loaded metadata */
+    const char *name,            /* I: name of the band (ex. b1) */
+    const char *product          /* I: product of the band; NULL for any */
+);
+
+Espa_band_meta_t *get_lazy_band
+(
+    Espa_lazy_meta_t *lazy,      /* I: lazily loaded metadata */
+    int band_index               /* I: index of the band in the metadata */
+);
+
+int load_all_lazy_bands
+(
+    Espa_lazy_meta_t *lazy       /* I: lazily loaded metadata */
+);
+
+void close_lazy_metadata
+(
+    Espa_lazy_meta_t *lazy       /* I: lazily loaded metadata to be freed */
+);
+
+#endif
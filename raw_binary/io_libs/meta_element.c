@@ -0,0 +1,166 @@
+/*****************************************************************************
+FILE: meta_element.c
+
+PURPOSE: Contains the perfect hash from the element names of the ESPA and
+Sentinel metadata files to their element IDs.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. Generated by gen_meta_element.py.  Don't edit this file; add the
+     element name to the generator and rerun it instead.
+*****************************************************************************/
+
+#include <stdint.h>
+#include <string.h>
+#include "meta_element.h"
+#include "espa_hash.h"
+
+#define NSLOTS 256
+#define NBUCKETS 64
+
+/* Displacement of each bucket */
+static const uint8_t bucket_disp[NBUCKETS] =
+{
+    0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1,
+    0, 0, 0, 1, 0, 0, 2, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 1, 2, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 0, 0,
+    0, 1, 0, 0, 1, 2, 0, 0, 0, 0, 3, 0,
+    0, 1, 0, 0,
+};
+
+/* Name and ID of the element in each slot */
+static const struct
+{
+    const char *name;
+    Espa_meta_element_t id;
+} slot_element[NSLOTS] =
+{
+    [2] = {"false_easting", ESPA_ELEM_FALSE_EASTING},
+    [4] = {"radiance", ESPA_ELEM_RADIANCE},
+    [6] = {"satellite", ESPA_ELEM_SATELLITE},
+    [12] = {"production_date", ESPA_ELEM_PRODUCTION_DATE},
+    [13] = {"bounding_coordinates", ESPA_ELEM_BOUNDING_COORDINATES},
+    [15] = {"IMAGE_FILE", ESPA_ELEM_IMAGE_FILE},
+    [17] = {"valid_range", ESPA_ELEM_VALID_RANGE},
+    [18] = {"earth_sun_distance", ESPA_ELEM_EARTH_SUN_DISTANCE},
+    [20] = {"north", ESPA_ELEM_NORTH},
+    [29] = {"false_northing", ESPA_ELEM_FALSE_NORTHING},
+    [34] = {"PRODUCT_TYPE", ESPA_ELEM_PRODUCT_TYPE},
+    [35] = {"level1_production_date", ESPA_ELEM_LEVEL1_PRODUCTION_DATE},
+    [36] = {"file_name", ESPA_ELEM_FILE_NAME},
+    [38] = {"lpgs_metadata_file", ESPA_ELEM_LPGS_METADATA_FILE},
+    [44] = {"pixel_size", ESPA_ELEM_PIXEL_SIZE},
+    [50] = {"percent_coverage", ESPA_ELEM_PERCENT_COVERAGE},
+    [52] = {"resample_method", ESPA_ELEM_RESAMPLE_METHOD},
+    [55] = {"qa_description", ESPA_ELEM_QA_DESCRIPTION},
+    [57] = {"central_meridian", ESPA_ELEM_CENTRAL_MERIDIAN},
+    [58] = {"solar_angles", ESPA_ELEM_SOLAR_ANGLES},
+    [62] = {"sin_proj_params", ESPA_ELEM_SIN_PROJ_PARAMS},
+    [65] = {"short_name", ESPA_ELEM_SHORT_NAME},
+    [69] = {"QUANTIFICATION_VALUE", ESPA_ELEM_QUANTIFICATION_VALUE},
+    [71] = {"histogram", ESPA_ELEM_HISTOGRAM},
+    [76] = {"orientation_angle", ESPA_ELEM_ORIENTATION_ANGLE},
+    [78] = {"sphere_radius", ESPA_ELEM_SPHERE_RADIUS},
+    [81] = {"thermal_const", ESPA_ELEM_THERMAL_CONST},
+    [84] = {"Mean_Viewing_Incidence_Angle", ESPA_ELEM_MEAN_VIEWING_INCIDENCE_ANGLE},
+    [85] = {"bit", ESPA_ELEM_BIT},
+    [88] = {"latitude_true_scale", ESPA_ELEM_LATITUDE_TRUE_SCALE},
+    [89] = {"ps_proj_params", ESPA_ELEM_PS_PROJ_PARAMS},
+    [92] = {"bands", ESPA_ELEM_BANDS},
+    [93] = {"origin_latitude", ESPA_ELEM_ORIGIN_LATITUDE},
+    [98] = {"ULX", ESPA_ELEM_ULX},
+    [100] = {"PROCESSING_BASELINE", ESPA_ELEM_PROCESSING_BASELINE},
+    [105] = {"utm_proj_params", ESPA_ELEM_UTM_PROJ_PARAMS},
+    [109] = {"app_version", ESPA_ELEM_APP_VERSION},
+    [110] = {"Mean_Sun_Angle", ESPA_ELEM_MEAN_SUN_ANGLE},
+    [111] = {"data_provider", ESPA_ELEM_DATA_PROVIDER},
+    [112] = {"standard_parallel1", ESPA_ELEM_STANDARD_PARALLEL1},
+    [115] = {"acquisition_date", ESPA_ELEM_ACQUISITION_DATE},
+    [116] = {"scene_center_time", ESPA_ELEM_SCENE_CENTER_TIME},
+    [121] = {"grid_origin", ESPA_ELEM_GRID_ORIGIN},
+    [124] = {"cover", ESPA_ELEM_COVER},
+    [129] = {"level1_filename", ESPA_ELEM_LEVEL1_FILENAME},
+    [139] = {"long_name", ESPA_ELEM_LONG_NAME},
+    [147] = {"Geoposition", ESPA_ELEM_GEOPOSITION},
+    [152] = {"GENERATION_TIME", ESPA_ELEM_GENERATION_TIME},
+    [153] = {"west", ESPA_ELEM_WEST},
+    [154] = {"class_values", ESPA_ELEM_CLASS_VALUES},
+    [155] = {"instrument", ESPA_ELEM_INSTRUMENT},
+    [158] = {"view_angles", ESPA_ELEM_VIEW_ANGLES},
+    [159] = {"global_metadata", ESPA_ELEM_GLOBAL_METADATA},
+    [160] = {"AZIMUTH_ANGLE", ESPA_ELEM_AZIMUTH_ANGLE},
+    [167] = {"product_id", ESPA_ELEM_PRODUCT_ID},
+    [168] = {"statistics", ESPA_ELEM_STATISTICS},
+    [171] = {"data_units", ESPA_ELEM_DATA_UNITS},
+    [172] = {"HORIZONTAL_CS_NAME", ESPA_ELEM_HORIZONTAL_CS_NAME},
+    [179] = {"albers_proj_params", ESPA_ELEM_ALBERS_PROJ_PARAMS},
+    [181] = {"footprint", ESPA_ELEM_FOOTPRINT},
+    [183] = {"zone_code", ESPA_ELEM_ZONE_CODE},
+    [187] = {"band", ESPA_ELEM_BAND},
+    [192] = {"corner_point", ESPA_ELEM_CORNER_POINT},
+    [196] = {"east", ESPA_ELEM_EAST},
+    [198] = {"Tile_Geocoding", ESPA_ELEM_TILE_GEOCODING},
+    [203] = {"corner", ESPA_ELEM_CORNER},
+    [205] = {"NROWS", ESPA_ELEM_NROWS},
+    [213] = {"modis", ESPA_ELEM_MODIS},
+    [215] = {"Size", ESPA_ELEM_SIZE},
+    [216] = {"wrs", ESPA_ELEM_WRS},
+    [220] = {"SENSING_TIME", ESPA_ELEM_SENSING_TIME},
+    [223] = {"EXT_POS_LIST", ESPA_ELEM_EXT_POS_LIST},
+    [226] = {"projection_information", ESPA_ELEM_PROJECTION_INFORMATION},
+    [227] = {"NCOLS", ESPA_ELEM_NCOLS},
+    [232] = {"south", ESPA_ELEM_SOUTH},
+    [235] = {"IMAGE_ID", ESPA_ELEM_IMAGE_ID},
+    [236] = {"longitude_pole", ESPA_ELEM_LONGITUDE_POLE},
+    [238] = {"class", ESPA_ELEM_CLASS},
+    [242] = {"reflectance", ESPA_ELEM_REFLECTANCE},
+    [243] = {"bitmap_description", ESPA_ELEM_BITMAP_DESCRIPTION},
+    [245] = {"SPACECRAFT_NAME", ESPA_ELEM_SPACECRAFT_NAME},
+    [251] = {"ZENITH_ANGLE", ESPA_ELEM_ZENITH_ANGLE},
+    [253] = {"standard_parallel2", ESPA_ELEM_STANDARD_PARALLEL2},
+    [254] = {"ULY", ESPA_ELEM_ULY},
+};
+
+
+/******************************************************************************
+MODULE:  lookup_meta_element
+
+PURPOSE: Looks up the element ID of an element name.
+
+RETURN VALUE:
+Type = Espa_meta_element_t
+Value               Description
+-----               -----------
+ESPA_ELEM_UNKNOWN   The name isn't a known element
+ESPA_ELEM_*         ID of the element
+
+NOTES:
+  1. The name is hashed once and compared against the single element which
+     could match it, however many elements are known.
+******************************************************************************/
+Espa_meta_element_t lookup_meta_element
+(
+    const xmlChar *name   /* I: name of the element */
+)
+{
+    uint32_t hash;                    /* FNV-1a hash of the name */
+    int slot;                         /* slot of the name in the table */
+
+    if (name == NULL)
+        return (ESPA_ELEM_UNKNOWN);
+
+    hash = espa_hash_fnv1a_32 ((const char *) name);
+
+    slot = (((hash >> 6) ^ bucket_disp[hash & (NBUCKETS - 1)]) *
+        2654435761u) >> 24;
+    if (slot_element[slot].name == NULL ||
+        strcmp (slot_element[slot].name, (const char *) name) != 0)
+        return (ESPA_ELEM_UNKNOWN);
+
+    return (slot_element[slot].id);
+}
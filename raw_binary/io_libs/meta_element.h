@@ -0,0 +1,118 @@
+/*****************************************************************************
+FILE: meta_element.h
+
+PURPOSE: Contains the element IDs of the ESPA and Sentinel metadata files,
+and the prototype for looking them up by element name.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. Generated by gen_meta_element.py.  Don't edit this file; add the
+     element name to the generator and rerun it instead.
+*****************************************************************************/
+#ifndef META_ELEMENT_H
+#define META_ELEMENT_H
+
+#include <libxml/tree.h>
+
+/* Element IDs; ESPA_ELEM_UNKNOWN for any other name */
+typedef enum
+{
+    ESPA_ELEM_UNKNOWN = 0,
+    ESPA_ELEM_ACQUISITION_DATE,
+    ESPA_ELEM_ALBERS_PROJ_PARAMS,
+    ESPA_ELEM_APP_VERSION,
+    ESPA_ELEM_AZIMUTH_ANGLE,
+    ESPA_ELEM_BAND,
+    ESPA_ELEM_BANDS,
+    ESPA_ELEM_BIT,
+    ESPA_ELEM_BITMAP_DESCRIPTION,
+    ESPA_ELEM_BOUNDING_COORDINATES,
+    ESPA_ELEM_CENTRAL_MERIDIAN,
+    ESPA_ELEM_CLASS,
+    ESPA_ELEM_CLASS_VALUES,
+    ESPA_ELEM_CORNER,
+    ESPA_ELEM_CORNER_POINT,
+    ESPA_ELEM_COVER,
+    ESPA_ELEM_DATA_PROVIDER,
+    ESPA_ELEM_DATA_UNITS,
+    ESPA_ELEM_EARTH_SUN_DISTANCE,
+    ESPA_ELEM_EAST,
+    ESPA_ELEM_EXT_POS_LIST,
+    ESPA_ELEM_FALSE_EASTING,
+    ESPA_ELEM_FALSE_NORTHING,
+    ESPA_ELEM_FILE_NAME,
+    ESPA_ELEM_FOOTPRINT,
+    ESPA_ELEM_GENERATION_TIME,
+    ESPA_ELEM_GEOPOSITION,
+    ESPA_ELEM_GLOBAL_METADATA,
+    ESPA_ELEM_GRID_ORIGIN,
+    ESPA_ELEM_HISTOGRAM,
+    ESPA_ELEM_HORIZONTAL_CS_NAME,
+    ESPA_ELEM_IMAGE_FILE,
+    ESPA_ELEM_IMAGE_ID,
+    ESPA_ELEM_INSTRUMENT,
+    ESPA_ELEM_LATITUDE_TRUE_SCALE,
+    ESPA_ELEM_LEVEL1_FILENAME,
+    ESPA_ELEM_LEVEL1_PRODUCTION_DATE,
+    ESPA_ELEM_LONG_NAME,
+    ESPA_ELEM_LONGITUDE_POLE,
+    ESPA_ELEM_LPGS_METADATA_FILE,
+    ESPA_ELEM_MEAN_SUN_ANGLE,
+    ESPA_ELEM_MEAN_VIEWING_INCIDENCE_ANGLE,
+    ESPA_ELEM_MODIS,
+    ESPA_ELEM_NCOLS,
+    ESPA_ELEM_NORTH,
+    ESPA_ELEM_NROWS,
+    ESPA_ELEM_ORIENTATION_ANGLE,
+    ESPA_ELEM_ORIGIN_LATITUDE,
+    ESPA_ELEM_PERCENT_COVERAGE,
+    ESPA_ELEM_PIXEL_SIZE,
+    ESPA_ELEM_PROCESSING_BASELINE,
+    ESPA_ELEM_PRODUCT_ID,
+    ESPA_ELEM_PRODUCT_TYPE,
+    ESPA_ELEM_PRODUCTION_DATE,
+    ESPA_ELEM_PROJECTION_INFORMATION,
+    ESPA_ELEM_PS_PROJ_PARAMS,
+    ESPA_ELEM_QA_DESCRIPTION,
+    ESPA_ELEM_QUANTIFICATION_VALUE,
+    ESPA_ELEM_RADIANCE,
+    ESPA_ELEM_REFLECTANCE,
+    ESPA_ELEM_RESAMPLE_METHOD,
+    ESPA_ELEM_SATELLITE,
+    ESPA_ELEM_SCENE_CENTER_TIME,
+    ESPA_ELEM_SENSING_TIME,
+    ESPA_ELEM_SHORT_NAME,
+    ESPA_ELEM_SIN_PROJ_PARAMS,
+    ESPA_ELEM_SIZE,
+    ESPA_ELEM_SOLAR_ANGLES,
+    ESPA_ELEM_SOUTH,
+    ESPA_ELEM_SPACECRAFT_NAME,
+    ESPA_ELEM_SPHERE_RADIUS,
+    ESPA_ELEM_STANDARD_PARALLEL1,
+    ESPA_ELEM_STANDARD_PARALLEL2,
+    ESPA_ELEM_STATISTICS,
+    ESPA_ELEM_THERMAL_CONST,
+    ESPA_ELEM_TILE_GEOCODING,
+    ESPA_ELEM_ULX,
+    ESPA_ELEM_ULY,
+    ESPA_ELEM_UTM_PROJ_PARAMS,
+    ESPA_ELEM_VALID_RANGE,
+    ESPA_ELEM_VIEW_ANGLES,
+    ESPA_ELEM_WEST,
+    ESPA_ELEM_WRS,
+    ESPA_ELEM_ZENITH_ANGLE,
+    ESPA_ELEM_ZONE_CODE,
+    ESPA_ELEM_COUNT
+} Espa_meta_element_t;
+
+/* Prototypes */
+Espa_meta_element_t lookup_meta_element
+(
+    const xmlChar *name   /* I: name of the element */
+);
+
+#endif
@@ -0,0 +1,902 @@
+/*****************************************************************************
+FILE: metadata_cache.c
+  
+PURPOSE: Contains functions for writing and reading the binary metadata cache.
+The metadata structures are dominated by fixed-size strings which are mostly
+empty, so the unused tail of each string is cleared and the structures are
+stored with runs of zero bytes collapsed, which keeps the cache small.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The payload is a sequence of segments, one per structure (the internal
+     metadata, the band array, then the bitmap descriptions, classes, and
+     cover types of each band).  Each segment is a sequence of records: a
+     uint32 count of literal bytes, the literal bytes, then a uint32 count of
+     zero bytes.
+  2. The cache is written to a temporary file and renamed into place, so a
+     tool reading it never sees a partially written cache.
+*****************************************************************************/
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE     /* for st_mtim */
+#endif
+#include <stddef.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "metadata_cache.h"
+#include "parse_metadata.h"
+#include "espa_hash.h"
+
+/* Shortest run of zero bytes which ends a literal run */
+#define MIN_ZERO_RUN 8
+
+/* Location of a fixed-size string within a structure */
+typedef struct
+{
+    size_t offset;          /* offset of the string in the structure */
+    size_t size;            /* size of the string */
+} Meta_cache_str_t;
+
+#define STR_FIELD(type, field) \
+    {offsetof (type, field), sizeof (((type *) 0)->field)}
+
+static const Meta_cache_str_t meta_strings[] =
+{
+    STR_FIELD (Espa_internal_meta_t, meta_namespace),
+    STR_FIELD (Espa_internal_meta_t, global.data_provider),
+    STR_FIELD (Espa_internal_meta_t, global.satellite),
+    STR_FIELD (Espa_internal_meta_t, global.instrument),
+    STR_FIELD (Espa_internal_meta_t, global.acquisition_date),
+    STR_FIELD (Espa_internal_meta_t, global.proj_info.units),
+    STR_FIELD (Espa_internal_meta_t, global.proj_info.grid_origin),
+    STR_FIELD (Espa_internal_meta_t, global.scene_center_time),
+    STR_FIELD (Espa_internal_meta_t, global.product_id),
+    STR_FIELD (Espa_internal_meta_t, global.lpgs_metadata_file),
+    STR_FIELD (Espa_internal_meta_t, global.solar_units),
+    STR_FIELD (Espa_internal_meta_t, global.level1_production_date),
+    STR_FIELD (Espa_internal_meta_t, global.view_units),
+    STR_FIELD (Espa_internal_meta_t, global.footprint)
+};
+
+static const Meta_cache_str_t band_strings[] =
+{
+    STR_FIELD (Espa_band_meta_t, product),
+    STR_FIELD (Espa_band_meta_t, source),
+    STR_FIELD (Espa_band_meta_t, name),
+    STR_FIELD (Espa_band_meta_t, category),
+    STR_FIELD (Espa_band_meta_t, short_name),
+    STR_FIELD (Espa_band_meta_t, long_name),
+    STR_FIELD (Espa_band_meta_t, file_name),
+    STR_FIELD (Espa_band_meta_t, footprint_file),
+    STR_FIELD (Espa_band_meta_t, encoding),
+    STR_FIELD (Espa_band_meta_t, pixel_units),
+    STR_FIELD (Espa_band_meta_t, data_units),
+    STR_FIELD (Espa_band_meta_t, qa_desc),
+    STR_FIELD (Espa_band_meta_t, app_version),
+    STR_FIELD (Espa_band_meta_t, l1_filename),
+    STR_FIELD (Espa_band_meta_t, production_date)
+};
+
+/* Growable buffer for the encoded payload */
+typedef struct
+{
+    char *buf;              /* encoded bytes */
+    size_t nbytes;          /* number of bytes in use */
+    size_t max_bytes;       /* number of bytes allocated */
+} Meta_cache_buf_t;
+
+
+/******************************************************************************
+MODULE:  use_metadata_cache
+
+PURPOSE: Determines if the binary metadata cache has been turned on.
+
+RETURN VALUE:
+Type = bool
+Value           Description
+-----           -----------
+true            ESPA_META_CACHE_ENV is set to yes
+false           The cache is not used
+
+NOTES:
+******************************************************************************/
+bool use_metadata_cache (void)
+{
+    char *env = getenv (ESPA_META_CACHE_ENV);  /* value of the variable */
+
+    return (env != NULL && !strcmp (env, "yes"));
+}
+
+
+/******************************************************************************
+MODULE:  get_xml_fingerprint
+
+PURPOSE: Gets the size, modification time, and content hash of the XML file.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Unable to stat or read the XML file
+SUCCESS         Fingerprint was filled in
+
+NOTES:
+  1. No error messages are written, since a missing file simply means the
+     cache can't be used.
+******************************************************************************/
+static int get_xml_fingerprint
+(
+    char *xml_file,         /* I: name of the XML file */
+    Espa_meta_cache_header_t *header  /* O: header with the xml_* fields
+                                  filled in */
+)
+{
+    struct stat statbuf;    /* status of the XML file */
+    unsigned char buf[65536]; /* block of the XML file */
+    uint64_t hash = ESPA_FNV1A_BASIS;  /* FNV-1a hash of the contents */
+    size_t nread;           /* number of bytes read */
+    FILE *fptr = NULL;      /* XML file */
+
+    if (stat (xml_file, &statbuf) == -1)
+        return (ERROR);
+
+    fptr = fopen (xml_file, "rb");
+    if (fptr == NULL)
+        return (ERROR);
+    while ((nread = fread (buf, 1, sizeof (buf), fptr)) > 0)
+        hash = espa_hash_fnv1a (buf, nread, hash);
+    fclose (fptr);
+
+    header->xml_size = statbuf.st_size;
+    header->xml_mtime_sec = statbuf.st_mtim.tv_sec;
+    header->xml_mtime_nsec = statbuf.st_mtim.tv_nsec;
+    header->xml_hash = hash;
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  append_cache_bytes
+
+PURPOSE: Appends bytes to the encoded payload, growing it as needed.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error allocating memory for the payload
+SUCCESS         Bytes were appended
+
+NOTES:
+******************************************************************************/
+static int append_cache_bytes
+(
+    Meta_cache_buf_t *out,  /* I/O: encoded payload */
+    const void *data,       /* I: bytes to be appended */
+    size_t nbytes           /* I: number of bytes to be appended */
+)
+{
+    char *ptr = NULL;       /* reallocated payload */
+    size_t max_bytes;       /* new size of the payload */
+
+    if (out->nbytes + nbytes > out->max_bytes)
+    {
+        max_bytes = out->max_bytes == 0 ? 65536 : out->max_bytes;
+        while (out->nbytes + nbytes > max_bytes)
+            max_bytes *= 2;
+        ptr = realloc (out->buf, max_bytes);
+        if (ptr == NULL)
+            return (ERROR);
+        out->buf = ptr;
+        out->max_bytes = max_bytes;
+    }
+
+    memcpy (out->buf + out->nbytes, data, nbytes);
+    out->nbytes += nbytes;
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  encode_cache_segment
+
+PURPOSE: Appends a structure to the payload with its runs of zero bytes
+collapsed.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error allocating memory for the payload
+SUCCESS         Segment was encoded
+
+NOTES:
+******************************************************************************/
+static int encode_cache_segment
+(
+    Meta_cache_buf_t *out,  /* I/O: encoded payload */
+    const void *data,       /* I: structure to be encoded */
+    size_t nbytes           /* I: size of the structure */
+)
+{
+    const unsigned char *in = data;  /* bytes of the structure */
+    size_t i = 0;           /* current byte */
+    size_t start;           /* start of the literal run */
+    size_t run;             /* end of the current run of zeros */
+    uint32_t nlit;          /* number of literal bytes */
+    uint32_t nzero;         /* number of zero bytes */
+
+    while (i < nbytes)
+    {
+        /* Find the end of the literal bytes, which is the start of a long
+           enough run of zeros (or the end of the structure) */
+        start = i;
+        while (i < nbytes)
+        {
+            if (in[i] != 0)
+            {
+                i++;
+                continue;
+            }
+            for (run = i; run < nbytes && in[run] == 0; run++)
+                ;
+            if (run - i >= MIN_ZERO_RUN || run == nbytes)
+                break;
+            i = run;
+        }
+        nlit = i - start;
+
+        for (run = i; run < nbytes && in[run] == 0; run++)
+            ;
+        nzero = run - i;
+        i = run;
+
+        if (append_cache_bytes (out, &nlit, sizeof (nlit)) != SUCCESS ||
+            append_cache_bytes (out, in + start, nlit) != SUCCESS ||
+            append_cache_bytes (out, &nzero, sizeof (nzero)) != SUCCESS)
+            return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  decode_cache_segment
+
+PURPOSE: Decodes the next structure from the payload.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Payload is truncated or corrupt
+SUCCESS         Segment was decoded
+
+NOTES:
+******************************************************************************/
+static int decode_cache_segment
+(
+    const char *in,         /* I: encoded payload */
+    size_t in_bytes,        /* I: size of the payload */
+    size_t *pos,            /* I/O: current position in the payload */
+    void *data,             /* O: decoded structure */
+    size_t nbytes           /* I: size of the structure */
+)
+{
+    char *out = data;       /* bytes of the structure */
+    size_t i = 0;           /* current byte of the structure */
+    uint32_t nlit;          /* number of literal bytes */
+    uint32_t nzero;         /* number of zero bytes */
+
+    while (i < nbytes)
+    {
+        if (*pos + sizeof (nlit) > in_bytes)
+            return (ERROR);
+        memcpy (&nlit, in + *pos, sizeof (nlit));
+        *pos += sizeof (nlit);
+        if (nlit > nbytes - i || *pos + nlit + sizeof (nzero) > in_bytes)
+            return (ERROR);
+        memcpy (out + i, in + *pos, nlit);
+        *pos += nlit;
+        i += nlit;
+
+        memcpy (&nzero, in + *pos, sizeof (nzero));
+        *pos += sizeof (nzero);
+        if (nzero > nbytes - i)
+            return (ERROR);
+        memset (out + i, 0, nzero);
+        i += nzero;
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  clear_string_tails
+
+PURPOSE: Clears the bytes following the terminating NULL of each string in
+a structure, so they collapse into runs of zeros.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+static void clear_string_tails
+(
+    void *data,             /* I/O: structure */
+    const Meta_cache_str_t *strings, /* I: strings in the structure */
+    int nstrings            /* I: number of strings */
+)
+{
+    char *str = NULL;       /* current string */
+    size_t len;             /* length of the string */
+    int i;                  /* looping variable */
+
+    for (i = 0; i < nstrings; i++)
+    {
+        str = (char *) data + strings[i].offset;
+        len = strnlen (str, strings[i].size);
+        if (len < strings[i].size)
+            memset (str + len, 0, strings[i].size - len);
+    }
+}
+
+
+/******************************************************************************
+MODULE:  write_metadata_cache
+
+PURPOSE: Writes the binary metadata cache for the XML file the metadata was
+parsed from.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the cache
+SUCCESS         Cache was written
+
+NOTES:
+  1. The metadata must be exactly what parsing the XML file produces, since
+     it is used in place of parsing the XML file.
+******************************************************************************/
+int write_metadata_cache
+(
+    Espa_internal_meta_t *metadata, /* I: metadata parsed from the XML file */
+    char *xml_file,         /* I: name of the XML file the metadata was parsed
+                                  from */
+    bool validated          /* I: was the XML file validated? */
+)
+{
+    char FUNC_NAME[] = "write_metadata_cache";  /* function name */
+    char errmsg[STR_SIZE];  /* error message */
+    char cache_file[STR_SIZE];  /* name of the cache */
+    char tmp_file[STR_SIZE];    /* name of the cache while it is written */
+    Espa_meta_cache_header_t header;  /* cache header */
+    Meta_cache_buf_t out = {NULL, 0, 0};  /* encoded payload */
+    Espa_internal_meta_t meta;  /* copy of the metadata being encoded */
+    Espa_band_meta_t band;      /* copy of the band being encoded */
+    Espa_band_meta_t *bmeta = NULL;  /* current band */
+    char bit_desc[STR_SIZE];    /* copy of the bitmap description */
+    Espa_class_t class_val;     /* copy of the class being encoded */
+    Espa_percent_cover_t cover; /* copy of the cover type being encoded */
+    int status = SUCCESS;       /* status of the encoding */
+    int i, j;                   /* looping variables */
+    FILE *fptr = NULL;          /* cache file */
+
+    memset (&header, 0, sizeof (header));
+    memcpy (header.magic, ESPA_META_CACHE_MAGIC, sizeof (header.magic));
+    header.version = ESPA_META_CACHE_VERSION;
+    header.meta_size = sizeof (Espa_internal_meta_t);
+    header.band_size = sizeof (Espa_band_meta_t);
+    header.validated = validated ? 1 : 0;
+    if (get_xml_fingerprint (xml_file, &header) != SUCCESS)
+    {
+        sprintf (errmsg, "Reading %s for the metadata cache", xml_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Encode the metadata, then each band, then the per-band arrays */
+    meta = *metadata;
+    meta.band = NULL;
+    meta.arena = NULL;
+    meta.band_index = NULL;
+    clear_string_tails (&meta, meta_strings,
+        sizeof (meta_strings) / sizeof (meta_strings[0]));
+    status = encode_cache_segment (&out, &meta, sizeof (meta));
+
+    for (i = 0; i < metadata->nbands && status == SUCCESS; i++)
+    {
+        band = metadata->band[i];
+        band.bitmap_description = NULL;
+        band.class_values = NULL;
+        band.percent_cover = NULL;
+        band.arena = NULL;
+        clear_string_tails (&band, band_strings,
+            sizeof (band_strings) / sizeof (band_strings[0]));
+        status = encode_cache_segment (&out, &band, sizeof (band));
+    }
+
+    for (i = 0; i < metadata->nbands && status == SUCCESS; i++)
+    {
+        bmeta = &metadata->band[i];
+        for (j = 0; j < bmeta->nbits && status == SUCCESS; j++)
+        {
+            memset (bit_desc, 0, sizeof (bit_desc));
+            strncpy (bit_desc, bmeta->bitmap_description[j],
+                sizeof (bit_desc) - 1);
+            status = encode_cache_segment (&out, bit_desc, sizeof (bit_desc));
+        }
+        for (j = 0; j < bmeta->nclass && status == SUCCESS; j++)
+        {
+            memset (&class_val, 0, sizeof (class_val));
+            memcpy (&class_val, &bmeta->class_values[j], sizeof (class_val));
+            clear_string_tails (&class_val, &(Meta_cache_str_t)
+                STR_FIELD (Espa_class_t, description), 1);
+            status = encode_cache_segment (&out, &class_val,
+                sizeof (class_val));
+        }
+        for (j = 0; j < bmeta->ncover && status == SUCCESS; j++)
+        {
+            memcpy (&cover, &bmeta->percent_cover[j], sizeof (cover));
+            clear_string_tails (&cover, &(Meta_cache_str_t)
+                STR_FIELD (Espa_percent_cover_t, description), 1);
+            status = encode_cache_segment (&out, &cover, sizeof (cover));
+        }
+    }
+    if (status != SUCCESS)
+    {
+        sprintf (errmsg, "Allocating memory for the metadata cache");
+        error_handler (true, FUNC_NAME, errmsg);
+        free (out.buf);
+        return (ERROR);
+    }
+    header.payload_size = out.nbytes;
+
+    /* Write the cache to a temporary file and move it into place */
+    snprintf (cache_file, sizeof (cache_file), "%s%s", xml_file,
+        ESPA_META_CACHE_EXT);
+    snprintf (tmp_file, sizeof (tmp_file), "%s.%ld", cache_file,
+        (long) getpid ());
+    fptr = fopen (tmp_file, "wb");
+    if (fptr == NULL)
+    {
+        sprintf (errmsg, "Opening the metadata cache %s", tmp_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        free (out.buf);
+        return (ERROR);
+    }
+    if (fwrite (&header, sizeof (header), 1, fptr) != 1 ||
+        fwrite (out.buf, 1, out.nbytes, fptr) != out.nbytes)
+        status = ERROR;
+    if (fclose (fptr) != 0)
+        status = ERROR;
+    free (out.buf);
+
+    if (status != SUCCESS || rename (tmp_file, cache_file) != 0)
+    {
+        sprintf (errmsg, "Writing the metadata cache %s", cache_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        unlink (tmp_file);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  read_metadata_cache
+
+PURPOSE: Loads the metadata from the binary metadata cache of the XML file,
+if there is one and it is current.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           No usable cache; the XML file needs to be parsed
+SUCCESS         Metadata was loaded from the cache
+
+NOTES:
+  1. No error messages are written when the cache is missing, stale, or was
+     written by a different build, since the caller falls back to parsing
+     the XML file.
+******************************************************************************/
+int read_metadata_cache
+(
+    char *xml_file,         /* I: name of the XML file */
+    bool require_validated, /* I: only use a cache built from a validated
+                                  XML file? */
+    Espa_internal_meta_t *metadata  /* O: metadata structure, initialized via
+                                  init_metadata_struct; only populated if the
+                                  cache is used */
+)
+{
+    char cache_file[STR_SIZE];  /* name of the cache */
+    Espa_meta_cache_header_t header;  /* cache header */
+    Espa_meta_cache_header_t xml_header;  /* fingerprint of the XML file */
+    Espa_internal_meta_t meta;  /* decoded metadata */
+    Espa_band_meta_t *bmeta = NULL;  /* current band */
+    char *payload = NULL;   /* contents of the cache following the header */
+    size_t pos = 0;         /* current position in the payload */
+    int status = SUCCESS;   /* status of the decoding */
+    int i, j;               /* looping variables */
+    int nbits, nclass, ncover;  /* sizes of the per-band arrays */
+    int *counts = NULL;     /* sizes of the per-band arrays for each band */
+    struct stat statbuf;    /* status of the cache */
+    FILE *fptr = NULL;      /* cache file */
+
+    snprintf (cache_file, sizeof (cache_file), "%s%s", xml_file,
+        ESPA_META_CACHE_EXT);
+    if (stat (cache_file, &statbuf) == -1 ||
+        (size_t) statbuf.st_size < sizeof (header))
+        return (ERROR);
+
+    /* Read the whole cache at once */
+    payload = malloc (statbuf.st_size);
+    if (payload == NULL)
+        return (ERROR);
+    fptr = fopen (cache_file, "rb");
+    if (fptr == NULL)
+    {
+        free (payload);
+        return (ERROR);
+    }
+    if (fread (payload, 1, statbuf.st_size, fptr) != (size_t) statbuf.st_size)
+        status = ERROR;
+    fclose (fptr);
+    memcpy (&header, payload, sizeof (header));
+
+    /* Make sure the cache is for this build and this version of the XML */
+    if (status != SUCCESS ||
+        memcmp (header.magic, ESPA_META_CACHE_MAGIC, sizeof (header.magic)) ||
+        header.version != ESPA_META_CACHE_VERSION ||
+        header.meta_size != sizeof (Espa_internal_meta_t) ||
+        header.band_size != sizeof (Espa_band_meta_t) ||
+        header.payload_size != statbuf.st_size - sizeof (header) ||
+        (require_validated && !header.validated) ||
+        get_xml_fingerprint (xml_file, &xml_header) != SUCCESS ||
+        header.xml_size != xml_header.xml_size ||
+        header.xml_mtime_sec != xml_header.xml_mtime_sec ||
+        header.xml_mtime_nsec != xml_header.xml_mtime_nsec ||
+        header.xml_hash != xml_header.xml_hash)
+    {
+        free (payload);
+        return (ERROR);
+    }
+
+    /* Decode the metadata and the bands */
+    init_metadata_struct (&meta);
+    status = decode_cache_segment (payload + sizeof (header),
+        header.payload_size, &pos, &meta, sizeof (meta));
+    meta.band = NULL;
+    meta.arena = NULL;
+    meta.band_index = NULL;
+    if (status == SUCCESS && (meta.nbands < 0 ||
+        (size_t) meta.nbands > header.payload_size))
+        status = ERROR;
+    if (status == SUCCESS && meta.nbands > 0)
+    {
+        meta.band = calloc (meta.nbands, sizeof (Espa_band_meta_t));
+        meta.arena = calloc (1, sizeof (Espa_meta_arena_t));
+        counts = calloc (meta.nbands * 3, sizeof (int));
+        if (meta.band == NULL || meta.arena == NULL || counts == NULL)
+            status = ERROR;
+    }
+    for (i = 0; i < meta.nbands && status == SUCCESS; i++)
+    {
+        bmeta = &meta.band[i];
+        status = decode_cache_segment (payload + sizeof (header),
+            header.payload_size, &pos, bmeta, sizeof (Espa_band_meta_t));
+    }
+
+    /* The per-band arrays follow all the bands.  Clear the counts and
+       pointers of every band first, so free_metadata only releases what was
+       allocated if an error occurs. */
+    if (status != SUCCESS)
+        meta.nbands = 0;
+    for (i = 0; i < meta.nbands; i++)
+    {
+        bmeta = &meta.band[i];
+        counts[i * 3] = bmeta->nbits;
+        counts[i * 3 + 1] = bmeta->nclass;
+        counts[i * 3 + 2] = bmeta->ncover;
+        bmeta->nbits = bmeta->nclass = bmeta->ncover = 0;
+        bmeta->bitmap_description = NULL;
+        bmeta->class_values = NULL;
+        bmeta->percent_cover = NULL;
+        bmeta->arena = meta.arena;
+    }
+
+    /* Allocate and decode the bitmap descriptions, classes, and cover types
+       of each band */
+    for (i = 0; i < meta.nbands && status == SUCCESS; i++)
+    {
+        bmeta = &meta.band[i];
+        nbits = counts[i * 3];
+        nclass = counts[i * 3 + 1];
+        ncover = counts[i * 3 + 2];
+        if (nbits < 0 || nclass < 0 || ncover < 0 ||
+            (size_t) nbits + nclass + ncover > header.payload_size)
+        {
+            status = ERROR;
+            break;
+        }
+
+        if (nbits > 0 && allocate_bitmap_metadata (bmeta, nbits) != SUCCESS)
+            status = ERROR;
+        for (j = 0; j < bmeta->nbits && status == SUCCESS; j++)
+            status = decode_cache_segment (payload + sizeof (header),
+                header.payload_size, &pos, bmeta->bitmap_description[j],
+                STR_SIZE);
+
+        if (status == SUCCESS && nclass > 0 &&
+            allocate_class_metadata (bmeta, nclass) != SUCCESS)
+            status = ERROR;
+        for (j = 0; j < bmeta->nclass && status == SUCCESS; j++)
+            status = decode_cache_segment (payload + sizeof (header),
+                header.payload_size, &pos, &bmeta->class_values[j],
+                sizeof (Espa_class_t));
+
+        if (status == SUCCESS && ncover > 0 &&
+            allocate_percent_coverage_metadata (bmeta, ncover) != SUCCESS)
+            status = ERROR;
+        for (j = 0; j < bmeta->ncover && status == SUCCESS; j++)
+            status = decode_cache_segment (payload + sizeof (header),
+                header.payload_size, &pos, &bmeta->percent_cover[j],
+                sizeof (Espa_percent_cover_t));
+    }
+    free (counts);
+    free (payload);
+
+    /* The whole payload must have been consumed */
+    if (status == SUCCESS && pos != header.payload_size)
+        status = ERROR;
+    if (status != SUCCESS)
+    {
+        free_metadata (&meta);
+        return (ERROR);
+    }
+
+    *metadata = meta;
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  ignore_validity_message
+
+PURPOSE: Discards the messages from a quiet schema validation.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+static void ignore_validity_message
+(
+    void *ctx,              /* I: unused context */
+    const char *msg,        /* I: unused message format */
+    ...
+)
+{
+}
+
+
+/******************************************************************************
+MODULE:  refresh_metadata_cache
+
+PURPOSE: Parses the XML file and writes its binary metadata cache, recording
+whether the XML file validates against the ESPA schema.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error parsing the XML file or writing the cache
+SUCCESS         Cache was written
+
+NOTES:
+  1. Called by write_metadata and append_metadata once the XML file has been
+     written.  The validation is quiet, since metadata written part way
+     through processing isn't necessarily complete; the cache is simply
+     marked as not validated.
+  2. Any previous cache is removed first, so it can't be used if this one
+     can't be written.
+******************************************************************************/
+int refresh_metadata_cache
+(
+    char *xml_file          /* I: name of the XML file */
+)
+{
+    char FUNC_NAME[] = "refresh_metadata_cache";  /* function name */
+    char errmsg[STR_SIZE];  /* error message */
+    char cache_file[STR_SIZE];  /* name of the cache */
+    Espa_internal_meta_t meta;  /* metadata parsed from the XML file */
+    xmlDocPtr doc = NULL;   /* document tree of the XML file */
+    xmlSchemaPtr schema = NULL;  /* compiled ESPA schema */
+    xmlSchemaValidCtxtPtr valid_ctxt = NULL;  /* validation context */
+    bool validated = false; /* does the XML file validate? */
+    int status;             /* return status */
+
+    snprintf (cache_file, sizeof (cache_file), "%s%s", xml_file,
+        ESPA_META_CACHE_EXT);
+    unlink (cache_file);
+
+    /* Read the XML file the same way validate_and_parse_metadata does */
+    doc = xmlReadFile (xml_file, NULL, XML_PARSE_NOBLANKS);
+    if (doc == NULL)
+    {
+        sprintf (errmsg, "Could not parse %s", xml_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    schema = get_espa_schema ();
+    if (schema != NULL)
+        valid_ctxt = xmlSchemaNewValidCtxt (schema);
+    if (valid_ctxt != NULL)
+    {
+        xmlSchemaSetValidErrors (valid_ctxt, ignore_validity_message,
+            ignore_validity_message, NULL);
+        validated = xmlSchemaValidateDoc (valid_ctxt, doc) == 0;
+        xmlSchemaFreeValidCtxt (valid_ctxt);
+    }
+
+    init_metadata_struct (&meta);
+    status = parse_metadata_doc (doc, &meta);
+    xmlFreeDoc (doc);
+    if (status == SUCCESS)
+        status = write_metadata_cache (&meta, xml_file, validated);
+    free_metadata (&meta);
+    cleanup_espa_xml ();
+
+    if (status != SUCCESS)
+    {
+        sprintf (errmsg, "Writing the metadata cache for %s", xml_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  append_metadata_cache
+
+PURPOSE: Writes the binary metadata cache for an XML file which has had bands
+appended to it, from the cache of the XML file before the append and the XML
+of the appended bands.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error parsing the appended bands or writing the cache
+SUCCESS         Cache was written
+
+NOTES:
+  1. Called by append_metadata once the bands have been appended to the XML
+     file.  Only the appended band elements are parsed; the rest of the
+     metadata comes from the previous cache, which is read before the XML
+     file is modified.
+  2. The XML file isn't validated again, so the cache is marked as not
+     validated.
+******************************************************************************/
+int append_metadata_cache
+(
+    Espa_internal_meta_t *metadata, /* I: metadata from the cache of the XML
+                                  file before the append */
+    char *xml_file,         /* I: name of the appended XML file */
+    const char *band_xml,   /* I: XML of the appended band elements */
+    size_t band_len         /* I: length of band_xml */
+)
+{
+    char FUNC_NAME[] = "append_metadata_cache";  /* function name */
+    char errmsg[STR_SIZE];  /* error message */
+    char cache_file[STR_SIZE];  /* name of the cache */
+    char *bands_xml = NULL; /* appended bands wrapped in a bands element */
+    size_t bands_len;       /* length of bands_xml */
+    int count;              /* number of chars copied in snprintf */
+    int nbands = 0;         /* number of appended bands */
+    int i;                  /* looping variable */
+    int status = SUCCESS;   /* return status */
+    xmlDocPtr doc = NULL;   /* document tree of the appended bands */
+    xmlNode *cur_node = NULL;   /* current band element */
+    Espa_internal_meta_t added; /* metadata of the appended bands */
+    Espa_internal_meta_t meta;  /* metadata of the appended XML file */
+
+    snprintf (cache_file, sizeof (cache_file), "%s%s", xml_file,
+        ESPA_META_CACHE_EXT);
+    unlink (cache_file);
+
+    /* Wrap the band elements in the ESPA namespace and parse them */
+    bands_len = band_len + strlen (ESPA_NS) + STR_SIZE;
+    bands_xml = malloc (bands_len);
+    if (bands_xml == NULL)
+    {
+        sprintf (errmsg, "Allocating memory for the appended bands");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    count = snprintf (bands_xml, bands_len, "<bands xmlns=\"%s\">\n%.*s"
+        "</bands>\n", ESPA_NS, (int) band_len, band_xml);
+    if (count < 0 || (size_t) count >= bands_len)
+    {
+        sprintf (errmsg, "Overflow of the appended bands");
+        error_handler (true, FUNC_NAME, errmsg);
+        free (bands_xml);
+        return (ERROR);
+    }
+    doc = xmlReadMemory (bands_xml, count, NULL, NULL, XML_PARSE_NOBLANKS);
+    free (bands_xml);
+    if (doc == NULL)
+    {
+        sprintf (errmsg, "Could not parse the bands appended to %s", xml_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    for (cur_node = xmlDocGetRootElement (doc)->children; cur_node;
+        cur_node = cur_node->next)
+    {
+        if (cur_node->type == XML_ELEMENT_NODE)
+            nbands++;
+    }
+
+    init_metadata_struct (&added);
+    if (nbands > 0 && allocate_band_metadata (&added, nbands) != SUCCESS)
+        status = ERROR;
+    i = 0;
+    for (cur_node = xmlDocGetRootElement (doc)->children;
+        cur_node && status == SUCCESS; cur_node = cur_node->next)
+    {
+        if (cur_node->type == XML_ELEMENT_NODE)
+            status = add_band_metadata (cur_node, &added.band[i++]);
+    }
+    xmlFreeDoc (doc);
+
+    /* Write the previous metadata followed by the appended bands.  The band
+       array only borrows the bands being encoded. */
+    meta = *metadata;
+    meta.nbands = metadata->nbands + nbands;
+    meta.band = NULL;
+    meta.band_index = NULL;
+    if (status == SUCCESS && meta.nbands > 0)
+    {
+        meta.band = malloc (meta.nbands * sizeof (Espa_band_meta_t));
+        if (meta.band == NULL)
+            status = ERROR;
+    }
+    if (status == SUCCESS)
+    {
+        if (metadata->nbands > 0)
+            memcpy (meta.band, metadata->band,
+                metadata->nbands * sizeof (Espa_band_meta_t));
+        if (nbands > 0)
+            memcpy (&meta.band[metadata->nbands], added.band,
+                nbands * sizeof (Espa_band_meta_t));
+        status = write_metadata_cache (&meta, xml_file, false);
+    }
+    free (meta.band);
+    free_metadata (&added);
+
+    if (status != SUCCESS)
+    {
+        sprintf (errmsg, "Writing the metadata cache for %s", xml_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
@@ -0,0 +1,93 @@
+/*****************************************************************************
+FILE: metadata_cache.h
+  
+PURPOSE: Contains defines, structures, and prototypes for the binary metadata
+cache, a compact serialization of the parsed ESPA internal metadata which is
+stored alongside the XML file so later tools can load the metadata with a
+single read instead of parsing (and validating) the XML again.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The cache is only used when ESPA_META_CACHE_ENV is set to yes.
+  2. The cache records the size, modification time, and a hash of the
+     contents of the XML file it was built from, and is ignored if any of them
+     no longer match.
+  3. The cache holds the in-memory structures, so it is only read back by the
+     same build of the library (the structure sizes are checked).
+*****************************************************************************/
+
+#ifndef METADATA_CACHE_H
+#define METADATA_CACHE_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "error_handler.h"
+#include "espa_metadata.h"
+
+/* Defines */
+#define ESPA_META_CACHE_ENV "ESPA_METADATA_CACHE" /* set to yes to write and
+                                     use the binary metadata cache */
+#define ESPA_META_CACHE_EXT ".metacache"  /* appended to the XML file name to
+                                     name the cache */
+#define ESPA_META_CACHE_MAGIC "ESPAMETA"  /* identifies a cache file */
+#define ESPA_META_CACHE_VERSION 10        /* version of the cache layout */
+
+/* Header at the start of the cache file */
+typedef struct
+{
+    char magic[8];          /* ESPA_META_CACHE_MAGIC, without the NULL */
+    uint32_t version;       /* ESPA_META_CACHE_VERSION */
+    uint32_t meta_size;     /* sizeof (Espa_internal_meta_t) */
+    uint32_t band_size;     /* sizeof (Espa_band_meta_t) */
+    uint32_t validated;     /* 1 if the XML was validated against the schema
+                               before the cache was written */
+    uint64_t xml_size;      /* size of the XML file */
+    int64_t xml_mtime_sec;  /* modification time of the XML file */
+    int64_t xml_mtime_nsec;
+    uint64_t xml_hash;      /* FNV-1a hash of the XML file contents */
+    uint64_t payload_size;  /* number of bytes following the header */
+} Espa_meta_cache_header_t;
+
+/* Prototypes */
+bool use_metadata_cache (void);
+
+int write_metadata_cache
+(
+    Espa_internal_meta_t *metadata, /* I: metadata parsed from the XML file */
+    char *xml_file,         /* I: name of the XML file the metadata was parsed
+                                  from */
+    bool validated          /* I: was the XML file validated? */
+);
+
+int read_metadata_cache
+(
+    char *xml_file,         /* I: name of the XML file */
+    bool require_validated, /* I: only use a cache built from a validated
+                                  XML file? */
+    Espa_internal_meta_t *metadata  /* O: metadata structure, initialized via
+                                  init_metadata_struct; only populated if the
+                                  cache is used */
+);
+
+int refresh_metadata_cache
+(
+    char *xml_file          /* I: name of the XML file */
+);
+
+int append_metadata_cache
+(
+    Espa_internal_meta_t *metadata, /* I: metadata from the cache of the XML
+                                  file before the append */
+    char *xml_file,         /* I: name of the appended XML file */
+    const char *band_xml,   /* I: XML of the appended band elements */
+    size_t band_len         /* I: length of band_xml */
+);
+
+#endif
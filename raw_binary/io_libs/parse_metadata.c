@@ -17,6 +17,41 @@ NOTES:
 *****************************************************************************/
 
 #include "espa_metadata.h"
+#include "parse_metadata.h"
+#include "metadata_cache.h"
+#include "espa_band_index.h"
+#include "meta_element.h"
+#include "espa_trace.h"
+#include "espa_metrics.h"
+
+/******************************************************************************
+MODULE:  get_node_namespace
+
+PURPOSE: Returns the namespace of an element node.
+
+RETURN VALUE:
+Type = xmlNsPtr
+Value           Description
+-----           -----------
+NULL            Node does not have a namespace
+non-NULL        Namespace of the node
+
+NOTES:
+1. The document tree built by parse_metadata carries the namespace of each
+   element as a namespace definition on the element itself, whereas a tree
+   read by xmlReadFile sets the namespace of the element and only defines it
+   on the root.  Both are supported so the same tree walk can be used for
+   either.
+2. Also used by the lazy and compact metadata loaders, which walk the same
+   trees.
+******************************************************************************/
+xmlNsPtr get_node_namespace
+(
+    xmlNode *node               /* I: pointer to the element node */
+)
+{
+    return node->ns != NULL ? node->ns : node->nsDef;
+}
 
 /******************************************************************************
 MODULE:  add_global_metadata_proj_info_albers
@@ -42,6 +77,7 @@ int add_global_metadata_proj_info_albers
     char FUNC_NAME[] = "add_global_metadata_proj_info_albers"; /* func name */
     char errmsg[STR_SIZE];        /* error message */
     xmlNode *cur_node = NULL;     /* pointer to the current node */
+    Espa_meta_element_t elem;     /* ID of the current element */
     xmlNode *child_node = NULL;   /* pointer to the child node */
 
     /* Make sure the projection type specified matches the projection
@@ -61,9 +97,9 @@ int add_global_metadata_proj_info_albers
     {
         /* Set up the child pointer */
         child_node = cur_node->children;
+        elem = lookup_meta_element (cur_node->name);
 
-        if (xmlStrEqual (cur_node->name,
-            (const xmlChar *) "standard_parallel1"))
+        if (elem == ESPA_ELEM_STANDARD_PARALLEL1)
         {
             /* Expect the child node to be a text node containing the value of
                this field */
@@ -81,8 +117,7 @@ int add_global_metadata_proj_info_albers
             gmeta->proj_info.standard_parallel1 =
                 atof ((const char *) child_node->content);
         }
-        else if (xmlStrEqual (cur_node->name,
-            (const xmlChar *) "standard_parallel2"))
+        else if (elem == ESPA_ELEM_STANDARD_PARALLEL2)
         {
             /* Expect the child node to be a text node containing the value of
                this field */
@@ -100,8 +135,7 @@ int add_global_metadata_proj_info_albers
             gmeta->proj_info.standard_parallel2 =
                 atof ((const char *) child_node->content);
         }
-        else if (xmlStrEqual (cur_node->name,
-            (const xmlChar *) "central_meridian"))
+        else if (elem == ESPA_ELEM_CENTRAL_MERIDIAN)
         {
             /* Expect the child node to be a text node containing the value of
                this field */
@@ -119,8 +153,7 @@ int add_global_metadata_proj_info_albers
             gmeta->proj_info.central_meridian =
                 atof ((const char *) child_node->content);
         }
-        else if (xmlStrEqual (cur_node->name,
-            (const xmlChar *) "origin_latitude"))
+        else if (elem == ESPA_ELEM_ORIGIN_LATITUDE)
         {
             /* Expect the child node to be a text node containing the value of
                this field */
@@ -138,8 +171,7 @@ int add_global_metadata_proj_info_albers
             gmeta->proj_info.origin_latitude =
                 atof ((const char *) child_node->content);
         }
-        else if (xmlStrEqual (cur_node->name,
-            (const xmlChar *) "false_easting"))
+        else if (elem == ESPA_ELEM_FALSE_EASTING)
         {
             /* Expect the child node to be a text node containing the value of
                this field */
@@ -157,8 +189,7 @@ int add_global_metadata_proj_info_albers
             gmeta->proj_info.false_easting =
                 atof ((const char *) child_node->content);
         }
-        else if (xmlStrEqual (cur_node->name,
-            (const xmlChar *) "false_northing"))
+        else if (elem == ESPA_ELEM_FALSE_NORTHING)
         {
             /* Expect the child node to be a text node containing the value of
                this field */
@@ -212,6 +243,7 @@ int add_global_metadata_proj_info_ps
     char FUNC_NAME[] = "add_global_metadata_proj_info_ps"; /* function name */
     char errmsg[STR_SIZE];        /* error message */
     xmlNode *cur_node = NULL;     /* pointer to the current node */
+    Espa_meta_element_t elem;     /* ID of the current element */
     xmlNode *child_node = NULL;   /* pointer to the child node */
 
     /* Make sure the projection type specified matches the projection
@@ -230,8 +262,9 @@ int add_global_metadata_proj_info_ps
     {
         /* Set up the child pointer */
         child_node = cur_node->children;
+        elem = lookup_meta_element (cur_node->name);
 
-        if (xmlStrEqual (cur_node->name, (const xmlChar *) "longitude_pole"))
+        if (elem == ESPA_ELEM_LONGITUDE_POLE)
         {
             /* Expect the child node to be a text node containing the value of
                this field */
@@ -249,8 +282,7 @@ int add_global_metadata_proj_info_ps
             gmeta->proj_info.longitude_pole =
                 atof ((const char *) child_node->content);
         }
-        else if (xmlStrEqual (cur_node->name,
-            (const xmlChar *) "latitude_true_scale"))
+        else if (elem == ESPA_ELEM_LATITUDE_TRUE_SCALE)
         {
             /* Expect the child node to be a text node containing the value of
                this field */
@@ -268,8 +300,7 @@ int add_global_metadata_proj_info_ps
             gmeta->proj_info.latitude_true_scale =
                 atof ((const char *) child_node->content);
         }
-        else if (xmlStrEqual (cur_node->name,
-            (const xmlChar *) "false_easting"))
+        else if (elem == ESPA_ELEM_FALSE_EASTING)
         {
             /* Expect the child node to be a text node containing the value of
                this field */
@@ -287,8 +318,7 @@ int add_global_metadata_proj_info_ps
             gmeta->proj_info.false_easting =
                 atof ((const char *) child_node->content);
         }
-        else if (xmlStrEqual (cur_node->name,
-            (const xmlChar *) "false_northing"))
+        else if (elem == ESPA_ELEM_FALSE_NORTHING)
         {
             /* Expect the child node to be a text node containing the value of
                this field */
@@ -342,6 +372,7 @@ int add_global_metadata_proj_info_sin
     char FUNC_NAME[] = "add_global_metadata_proj_info_sin"; /* func name */
     char errmsg[STR_SIZE];        /* error message */
     xmlNode *cur_node = NULL;     /* pointer to the current node */
+    Espa_meta_element_t elem;     /* ID of the current element */
     xmlNode *child_node = NULL;   /* pointer to the child node */
 
     /* Make sure the projection type specified matches the projection
@@ -361,8 +392,9 @@ int add_global_metadata_proj_info_sin
     {
         /* Set up the child pointer */
         child_node = cur_node->children;
+        elem = lookup_meta_element (cur_node->name);
 
-        if (xmlStrEqual (cur_node->name, (const xmlChar *) "sphere_radius"))
+        if (elem == ESPA_ELEM_SPHERE_RADIUS)
         {
             /* Expect the child node to be a text node containing the value of
                this field */
@@ -380,8 +412,7 @@ int add_global_metadata_proj_info_sin
             gmeta->proj_info.sphere_radius =
                 atof ((const char *) child_node->content);
         }
-        else if (xmlStrEqual (cur_node->name,
-            (const xmlChar *) "central_meridian"))
+        else if (elem == ESPA_ELEM_CENTRAL_MERIDIAN)
         {
             /* Expect the child node to be a text node containing the value of
                this field */
@@ -399,8 +430,7 @@ int add_global_metadata_proj_info_sin
             gmeta->proj_info.central_meridian =
                 atof ((const char *) child_node->content);
         }
-        else if (xmlStrEqual (cur_node->name,
-            (const xmlChar *) "false_easting"))
+        else if (elem == ESPA_ELEM_FALSE_EASTING)
         {
             /* Expect the child node to be a text node containing the value of
                this field */
@@ -418,8 +448,7 @@ int add_global_metadata_proj_info_sin
             gmeta->proj_info.false_easting =
                 atof ((const char *) child_node->content);
         }
-        else if (xmlStrEqual (cur_node->name,
-            (const xmlChar *) "false_northing"))
+        else if (elem == ESPA_ELEM_FALSE_NORTHING)
         {
             /* Expect the child node to be a text node containing the value of
                this field */
@@ -473,6 +502,7 @@ int add_global_metadata_proj_info_utm
     char FUNC_NAME[] = "add_global_metadata_proj_info_utm"; /* function name */
     char errmsg[STR_SIZE];        /* error message */
     xmlNode *cur_node = NULL;     /* pointer to the current node */
+    Espa_meta_element_t elem;     /* ID of the current element */
     xmlNode *child_node = NULL;   /* pointer to the child node */
 
     /* Make sure the projection type specified matches the projection
@@ -489,9 +519,10 @@ int add_global_metadata_proj_info_utm
     /* Set up the current and child pointers */
     cur_node = a_node->children;
     child_node = cur_node->children;
+    elem = lookup_meta_element (cur_node->name);
 
     /* Process the zone code for UTM */
-    if (xmlStrEqual (cur_node->name, (const xmlChar *) "zone_code"))
+    if (elem == ESPA_ELEM_ZONE_CODE)
     {
         /* Expect the child node to be a text node containing the value of
            this field */
@@ -543,6 +574,7 @@ int add_global_metadata_proj_info
     char errmsg[STR_SIZE];        /* error message */
     xmlAttrPtr attr = NULL;       /* pointer to the element attributes */
     xmlNode *cur_node = NULL;     /* pointer to the current node */
+    Espa_meta_element_t elem;     /* ID of the current element */
     xmlNode *child_node = NULL;   /* pointer to the child node */
     xmlNsPtr ns = NULL;           /* pointer to the namespace */
     xmlChar *attr_val = NULL;     /* attribute value */
@@ -553,7 +585,7 @@ int add_global_metadata_proj_info
 
     /* Set up the current and child pointers */
     cur_node = a_node;
-    ns = cur_node->nsDef;
+    ns = get_node_namespace (cur_node);
     child_node = cur_node->children;
 
     /* Verify the namespace of this node is our ESPA namespace.  If it isn't
@@ -621,10 +653,11 @@ int add_global_metadata_proj_info
     {
         /* Set up the child pointer */
         child_node = cur_node->children;
+        elem = lookup_meta_element (cur_node->name);
 
         /* Check for the element nodes within the projection_information
            element */
-        if (xmlStrEqual (cur_node->name, (const xmlChar *) "corner_point"))
+        if (elem == ESPA_ELEM_CORNER_POINT)
         {
             /* Handle the element attributes */
             x = -9999.0;
@@ -672,7 +705,7 @@ int add_global_metadata_proj_info
                 gmeta->proj_info.lr_corner[1] = y;
             }
         }
-        else if (xmlStrEqual (cur_node->name, (const xmlChar *) "grid_origin"))
+        else if (elem == ESPA_ELEM_GRID_ORIGIN)
         {
             /* Expect the child node to be a text node containing the value of
                this field */
@@ -696,8 +729,7 @@ int add_global_metadata_proj_info
                 return (ERROR);
             }
         }
-        else if (xmlStrEqual (cur_node->name,
-            (const xmlChar *) "utm_proj_params"))
+        else if (elem == ESPA_ELEM_UTM_PROJ_PARAMS)
         {
             /* Handle the projection-specific parameters */
             if (add_global_metadata_proj_info_utm (cur_node, gmeta))
@@ -708,8 +740,7 @@ int add_global_metadata_proj_info
                 return (ERROR);
             }
         }
-        else if (xmlStrEqual (cur_node->name,
-            (const xmlChar *) "ps_proj_params"))
+        else if (elem == ESPA_ELEM_PS_PROJ_PARAMS)
         {
             /* Handle the projection-specific parameters */
             if (add_global_metadata_proj_info_ps (cur_node, gmeta))
@@ -720,8 +751,7 @@ int add_global_metadata_proj_info
                 return (ERROR);
             }
         }
-        else if (xmlStrEqual (cur_node->name,
-            (const xmlChar *) "albers_proj_params"))
+        else if (elem == ESPA_ELEM_ALBERS_PROJ_PARAMS)
         {
             /* Handle the projection-specific parameters */
             if (add_global_metadata_proj_info_albers (cur_node, gmeta))
@@ -732,8 +762,7 @@ int add_global_metadata_proj_info
                 return (ERROR);
             }
         }
-        else if (xmlStrEqual (cur_node->name,
-            (const xmlChar *) "sin_proj_params"))
+        else if (elem == ESPA_ELEM_SIN_PROJ_PARAMS)
         {
             /* Handle the projection-specific parameters */
             if (add_global_metadata_proj_info_sin (cur_node, gmeta))
@@ -779,14 +808,16 @@ int add_global_metadata_bounding_coords
     char FUNC_NAME[] = "add_global_metadata_bounding_coords";/* function name */
     char errmsg[STR_SIZE];        /* error message */
     xmlNode *cur_node = NULL;     /* pointer to the current node */
+    Espa_meta_element_t elem;     /* ID of the current element */
     xmlNode *child_node = NULL;   /* pointer to the child node */
     xmlNsPtr ns = NULL;           /* pointer to the namespace */
     int indx;                     /* index into the bounding coords array */
 
     /* Set up the current and child pointers */
     cur_node = a_node;
-    ns = cur_node->nsDef;
+    ns = get_node_namespace (cur_node);
     child_node = cur_node->children;
+    elem = lookup_meta_element (cur_node->name);
 
     /* Verify the namespace of this node is our ESPA namespace.  If it isn't
        then the element won't be added to the metadata structure. */
@@ -801,13 +832,13 @@ int add_global_metadata_bounding_coords
     /* Look for the ESPA global metadata bounding coordinates elements and
        process them */
     indx = 0;
-    if (xmlStrEqual (cur_node->name, (const xmlChar *) "west"))
+    if (elem == ESPA_ELEM_WEST)
         indx = ESPA_WEST;
-    else if (xmlStrEqual (cur_node->name, (const xmlChar *) "east"))
+    else if (elem == ESPA_ELEM_EAST)
         indx = ESPA_EAST;
-    else if (xmlStrEqual (cur_node->name, (const xmlChar *) "north"))
+    else if (elem == ESPA_ELEM_NORTH)
         indx = ESPA_NORTH;
-    else if (xmlStrEqual (cur_node->name, (const xmlChar *) "south"))
+    else if (elem == ESPA_ELEM_SOUTH)
         indx = ESPA_SOUTH;
     else
     {
@@ -855,6 +886,7 @@ int add_global_metadata
     char errmsg[STR_SIZE];        /* error message */
     xmlAttrPtr attr = NULL;       /* pointer to the element attributes */
     xmlNode *cur_node = NULL;     /* pointer to the current node */
+    Espa_meta_element_t elem;     /* ID of the current element */
     xmlNode *child_node = NULL;   /* pointer to the child node */
     xmlNsPtr ns = NULL;           /* pointer to the namespace */
     xmlChar *attr_val = NULL;     /* attribute value */
@@ -865,8 +897,9 @@ int add_global_metadata
 
     /* Set up the current and child pointers */
     cur_node = a_node;
-    ns = cur_node->nsDef;
+    ns = get_node_namespace (cur_node);
     child_node = cur_node->children;
+    elem = lookup_meta_element (cur_node->name);
 
     /* Verify the namespace of this node is our ESPA namespace.  If it isn't
        then the element won't be added to the metadata structure. */
@@ -879,7 +912,7 @@ int add_global_metadata
     }
 
     /* Look for the ESPA global metadata elements and process them */
-    if (xmlStrEqual (cur_node->name, (const xmlChar *) "data_provider"))
+    if (elem == ESPA_ELEM_DATA_PROVIDER)
     {
         /* Expect the child node to be a text node containing the value of
            this field */
@@ -901,7 +934,7 @@ int add_global_metadata
             return (ERROR);
         }
     }
-    else if (xmlStrEqual (cur_node->name, (const xmlChar *) "satellite"))
+    else if (elem == ESPA_ELEM_SATELLITE)
     {
         /* Expect the child node to be a text node containing the value of
            this field */
@@ -923,7 +956,7 @@ int add_global_metadata
             return (ERROR);
         }
     }
-    else if (xmlStrEqual (cur_node->name, (const xmlChar *) "instrument"))
+    else if (elem == ESPA_ELEM_INSTRUMENT)
     {
         /* Expect the child node to be a text node containing the value of
            this field */
@@ -945,7 +978,7 @@ int add_global_metadata
             return (ERROR);
         }
     }
-    else if (xmlStrEqual (cur_node->name, (const xmlChar *) "acquisition_date"))
+    else if (elem == ESPA_ELEM_ACQUISITION_DATE)
     {
         /* Expect the child node to be a text node containing the value of
            this field */
@@ -968,8 +1001,7 @@ int add_global_metadata
             return (ERROR);
         }
     }
-    else if (xmlStrEqual (cur_node->name,
-        (const xmlChar *) "scene_center_time"))
+    else if (elem == ESPA_ELEM_SCENE_CENTER_TIME)
     {
         /* Expect the child node to be a text node containing the value of
            this field */
@@ -992,8 +1024,7 @@ int add_global_metadata
             return (ERROR);
         }
     }
-    else if (xmlStrEqual (cur_node->name,
-        (const xmlChar *) "level1_production_date"))
+    else if (elem == ESPA_ELEM_LEVEL1_PRODUCTION_DATE)
     {
         /* Expect the child node to be a text node containing the value of
            this field */
@@ -1016,7 +1047,7 @@ int add_global_metadata
             return (ERROR);
         }
     }
-    else if (xmlStrEqual (cur_node->name, (const xmlChar *) "solar_angles"))
+    else if (elem == ESPA_ELEM_SOLAR_ANGLES)
     {
         /* Handle the element attributes */
         for (attr = cur_node->properties; attr != NULL; attr = attr->next)
@@ -1046,7 +1077,7 @@ int add_global_metadata
             xmlFree (attr_val);
         }
     }
-    else if (xmlStrEqual (cur_node->name, (const xmlChar *) "view_angles"))
+    else if (elem == ESPA_ELEM_VIEW_ANGLES)
     {
         /* Handle the element attributes */
         for (attr = cur_node->properties; attr != NULL; attr = attr->next)
@@ -1076,8 +1107,7 @@ int add_global_metadata
             xmlFree (attr_val);
         }
     }
-    else if (xmlStrEqual (cur_node->name,
-        (const xmlChar *) "earth_sun_distance"))
+    else if (elem == ESPA_ELEM_EARTH_SUN_DISTANCE)
     {
         /* Expect the child node to be a text node containing the value of
            this field */
@@ -1092,7 +1122,7 @@ int add_global_metadata
         /* Copy the content of the child node into the value for this field */
         gmeta->earth_sun_dist = atof ((const char *) child_node->content);
     }
-    else if (xmlStrEqual (cur_node->name, (const xmlChar *) "wrs"))
+    else if (elem == ESPA_ELEM_WRS)
     {
         /* Handle the element attributes */
         for (attr = cur_node->properties; attr != NULL; attr = attr->next)
@@ -1113,7 +1143,7 @@ int add_global_metadata
             xmlFree (attr_val);
         }
     }
-    else if (xmlStrEqual (cur_node->name, (const xmlChar *) "modis"))
+    else if (elem == ESPA_ELEM_MODIS)
     {
         /* Handle the element attributes */
         for (attr = cur_node->properties; attr != NULL; attr = attr->next)
@@ -1132,8 +1162,7 @@ int add_global_metadata
             xmlFree (attr_val);
         }
     }
-    else if (xmlStrEqual (cur_node->name,
-        (const xmlChar *) "lpgs_metadata_file"))
+    else if (elem == ESPA_ELEM_LPGS_METADATA_FILE)
     {
         /* Expect the child node to be a text node containing the value of
            this field */
@@ -1156,7 +1185,7 @@ int add_global_metadata
             return (ERROR);
         }
     }
-    else if (xmlStrEqual (cur_node->name, (const xmlChar *) "product_id"))
+    else if (elem == ESPA_ELEM_PRODUCT_ID)
     {
         /* Expect the child node to be a text node containing the value of
            this field */
@@ -1178,7 +1207,7 @@ int add_global_metadata
             return (ERROR);
         }
     }
-    else if (xmlStrEqual (cur_node->name, (const xmlChar *) "corner"))
+    else if (elem == ESPA_ELEM_CORNER)
     {
         /* Handle the element attributes */
         latitude = -9999.0;
@@ -1226,8 +1255,7 @@ int add_global_metadata
             gmeta->lr_corner[1] = longitude;
         }
     }
-    else if (xmlStrEqual (cur_node->name,
-        (const xmlChar *) "bounding_coordinates"))
+    else if (elem == ESPA_ELEM_BOUNDING_COORDINATES)
     {
         /* Process the siblings in the bounding coordinates */
         for (cur_node = a_node->children; cur_node;
@@ -1242,8 +1270,7 @@ int add_global_metadata
             }
         }
     }
-    else if (xmlStrEqual (cur_node->name,
-        (const xmlChar *) "projection_information"))
+    else if (elem == ESPA_ELEM_PROJECTION_INFORMATION)
     {
         /* Process the elements within the projection information */
         if (add_global_metadata_proj_info (cur_node, gmeta))
@@ -1253,8 +1280,7 @@ int add_global_metadata
             return (ERROR);
         }
     }
-    else if (xmlStrEqual (cur_node->name,
-        (const xmlChar *) "orientation_angle"))
+    else if (elem == ESPA_ELEM_ORIENTATION_ANGLE)
     {
         /* Expect the child node to be a text node containing the value of
            this field */
@@ -1269,6 +1295,28 @@ int add_global_metadata
         /* Copy the content of the child node into the value for this field */
         gmeta->orientation_angle = atof ((const char *) child_node->content);
     }
+    else if (elem == ESPA_ELEM_FOOTPRINT)
+    {
+        /* Expect the child node to be a text node containing the value of
+           this field */
+        if (child_node == NULL || child_node->type != XML_TEXT_NODE) 
+        {
+            sprintf (errmsg, "Processing global_metadata element: %s.",
+                cur_node->name);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+
+        /* Copy the content of the child node into the value for this field */
+        count = snprintf (gmeta->footprint, sizeof (gmeta->footprint), "%s",
+            (const char *) child_node->content);
+        if (count < 0 || count >= sizeof (gmeta->footprint))
+        {
+            sprintf (errmsg, "Overflow of gmeta->footprint string");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+    }
     else
     {
         sprintf (errmsg, "Unknown element (%s) in the global_metadata",
@@ -1308,6 +1356,7 @@ int add_band_metadata_bitmap_description
     char FUNC_NAME[] = "add_band_metadata_bitmap_description"; /* func name */
     char errmsg[STR_SIZE];        /* error message */
     xmlNode *cur_node = NULL;     /* pointer to the current node */
+    Espa_meta_element_t elem;     /* ID of the current element */
     xmlNode *child_node = NULL;   /* pointer to the child node */
     int nbits = 0;                /* number of bits in the bitmap description */
     int count;                    /* number of chars copied in snprintf */
@@ -1317,7 +1366,7 @@ int add_band_metadata_bitmap_description
          cur_node = xmlNextElementSibling (cur_node))
     {
         /* If this is a bit element then count it */
-        if (xmlStrEqual (cur_node->name, (const xmlChar *) "bit"))
+        if (lookup_meta_element (cur_node->name) == ESPA_ELEM_BIT)
             nbits++;
     }
 
@@ -1339,9 +1388,10 @@ int add_band_metadata_bitmap_description
     {
         /* Set up the child pointer */
         child_node = cur_node->children;
+        elem = lookup_meta_element (cur_node->name);
 
         /* If this isn't a bit element then skip to the next one */
-        if (!xmlStrEqual (cur_node->name, (const xmlChar *) "bit"))
+        if (elem != ESPA_ELEM_BIT)
             continue;
 
         /* Expect the child node to be a text node containing the value of
@@ -1401,6 +1451,7 @@ int add_band_metadata_class_values
     char FUNC_NAME[] = "add_band_metadata_class_values"; /* func name */
     char errmsg[STR_SIZE];        /* error message */
     xmlNode *cur_node = NULL;     /* pointer to the current node */
+    Espa_meta_element_t elem;     /* ID of the current element */
     xmlNode *child_node = NULL;   /* pointer to the child node */
     xmlAttrPtr attr = NULL;       /* pointer to the element attributes */
     xmlChar *attr_val = NULL;     /* attribute value */
@@ -1412,7 +1463,7 @@ int add_band_metadata_class_values
          cur_node = xmlNextElementSibling (cur_node))
     {
         /* If this is a class element then count it */
-        if (xmlStrEqual (cur_node->name, (const xmlChar *) "class"))
+        if (lookup_meta_element (cur_node->name) == ESPA_ELEM_CLASS)
             nclass++;
     }
 
@@ -1432,9 +1483,10 @@ int add_band_metadata_class_values
     {
         /* Set up the child pointer */
         child_node = cur_node->children;
+        elem = lookup_meta_element (cur_node->name);
 
         /* If this isn't a class element then skip to the next one */
-        if (!xmlStrEqual (cur_node->name, (const xmlChar *) "class"))
+        if (elem != ESPA_ELEM_CLASS)
             continue;
 
         /* Handle the element attributes */
@@ -1512,6 +1564,7 @@ int add_band_metadata_percent_coverage
     char FUNC_NAME[] = "add_band_metadata_percent_coverage"; /* func name */
     char errmsg[STR_SIZE];        /* error message */
     xmlNode *cur_node = NULL;     /* pointer to the current node */
+    Espa_meta_element_t elem;     /* ID of the current element */
     xmlNode *child_node = NULL;   /* pointer to the child node */
     xmlAttrPtr attr = NULL;       /* pointer to the element attributes */
     xmlChar *attr_val = NULL;     /* attribute value */
@@ -1524,7 +1577,7 @@ int add_band_metadata_percent_coverage
          cur_node = xmlNextElementSibling (cur_node))
     {
         /* If this is a cover element then count it */
-        if (xmlStrEqual (cur_node->name, (const xmlChar *) "cover"))
+        if (lookup_meta_element (cur_node->name) == ESPA_ELEM_COVER)
             ncover++;
     }
 
@@ -1544,9 +1597,10 @@ int add_band_metadata_percent_coverage
     {
         /* Set up the child pointer */
         child_node = cur_node->children;
+        elem = lookup_meta_element (cur_node->name);
 
         /* If this isn't a cover type element then skip to the next one */
-        if (!xmlStrEqual (cur_node->name, (const xmlChar *) "cover"))
+        if (elem != ESPA_ELEM_COVER)
             continue;
 
         /* Handle the element attributes */
@@ -1599,6 +1653,129 @@ int add_band_metadata_percent_coverage
 }
 
 
+/******************************************************************************
+MODULE:  add_band_metadata_statistics
+
+PURPOSE: Adds the statistics element, and its histogram, to the band metadata
+structure.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error parsing the statistics element
+SUCCESS         Successful parse of the statistics
+
+NOTES:
+1. The histogram holds nbins counts separated by white space.
+******************************************************************************/
+int add_band_metadata_statistics
+(
+    xmlNode *a_node,            /* I/O: pointer to the statistics element
+                                        node to process */
+    Espa_band_meta_t *bmeta     /* I: band metadata structure for current
+                                      band in the bands structure */
+)
+{
+    char FUNC_NAME[] = "add_band_metadata_statistics";  /* function name */
+    char errmsg[STR_SIZE];        /* error message */
+    xmlNode *cur_node = NULL;     /* pointer to the current node */
+    xmlNode *child_node = NULL;   /* pointer to the child node */
+    xmlAttrPtr attr;              /* attribute of the current node */
+    xmlChar *attr_val = NULL;     /* value of the attribute */
+    Espa_band_stats_t *stats = &bmeta->stats;  /* statistics of the band */
+    const char *ptr = NULL;       /* current position in the counts */
+    char *end = NULL;             /* end of the current count */
+    int nbins;                    /* number of counts read */
+
+    /* Handle the element attributes */
+    for (attr = a_node->properties; attr != NULL; attr = attr->next)
+    {
+        attr_val = xmlGetProp (a_node, attr->name);
+        if (xmlStrEqual (attr->name, (const xmlChar *) "valid_count"))
+            stats->valid_count = atol ((const char *) attr_val);
+        else if (xmlStrEqual (attr->name, (const xmlChar *) "min"))
+            stats->min = atof ((const char *) attr_val);
+        else if (xmlStrEqual (attr->name, (const xmlChar *) "max"))
+            stats->max = atof ((const char *) attr_val);
+        else if (xmlStrEqual (attr->name, (const xmlChar *) "mean"))
+            stats->mean = atof ((const char *) attr_val);
+        else if (xmlStrEqual (attr->name, (const xmlChar *) "stddev"))
+            stats->stddev = atof ((const char *) attr_val);
+        else
+        {
+            sprintf (errmsg, "WARNING: unknown attribute for element (%s): "
+                "%s\n", a_node->name, attr->name);
+            error_handler (false, FUNC_NAME, errmsg);
+        }
+        xmlFree (attr_val);
+    }
+
+    /* Process the histogram */
+    for (cur_node = a_node->children; cur_node;
+         cur_node = xmlNextElementSibling (cur_node))
+    {
+        if (lookup_meta_element (cur_node->name) != ESPA_ELEM_HISTOGRAM)
+            continue;
+
+        for (attr = cur_node->properties; attr != NULL; attr = attr->next)
+        {
+            attr_val = xmlGetProp (cur_node, attr->name);
+            if (xmlStrEqual (attr->name, (const xmlChar *) "min"))
+                stats->hist_min = atof ((const char *) attr_val);
+            else if (xmlStrEqual (attr->name, (const xmlChar *) "max"))
+                stats->hist_max = atof ((const char *) attr_val);
+            else if (xmlStrEqual (attr->name, (const xmlChar *) "nbins"))
+                stats->nbins = atoi ((const char *) attr_val);
+            else
+            {
+                sprintf (errmsg, "WARNING: unknown attribute for element "
+                    "(%s): %s\n", cur_node->name, attr->name);
+                error_handler (false, FUNC_NAME, errmsg);
+            }
+            xmlFree (attr_val);
+        }
+        if (stats->nbins < 0 || stats->nbins > ESPA_STATS_NBINS)
+        {
+            sprintf (errmsg, "Histogram of band %s has %d bins, but at most "
+                "%d are supported", bmeta->name, stats->nbins,
+                ESPA_STATS_NBINS);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+
+        /* Expect the child node to be a text node containing the counts */
+        child_node = cur_node->children;
+        if (child_node == NULL || child_node->type != XML_TEXT_NODE)
+        {
+            sprintf (errmsg, "Processing band metadata element: %s.",
+                cur_node->name);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+
+        ptr = (const char *) child_node->content;
+        for (nbins = 0; nbins < stats->nbins; nbins++)
+        {
+            stats->histogram[nbins] = strtol (ptr, &end, 10);
+            if (end == ptr)
+                break;
+            ptr = end;
+        }
+        if (nbins != stats->nbins)
+        {
+            sprintf (errmsg, "Histogram of band %s has %d counts for %d "
+                "bins", bmeta->name, nbins, stats->nbins);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+    }
+
+    /* Successful processing */
+    return (SUCCESS);
+}
+
+
 /******************************************************************************
 MODULE:  add_band_metadata
 
@@ -1625,6 +1802,7 @@ int add_band_metadata
     char errmsg[STR_SIZE];        /* error message */
     xmlAttrPtr attr = NULL;       /* pointer to the element attributes */
     xmlNode *cur_node = NULL;     /* pointer to the current node */
+    Espa_meta_element_t elem;     /* ID of the current element */
     xmlNode *child_node = NULL;   /* pointer to the child node */
     xmlNsPtr ns = NULL;           /* pointer to the namespace */
     xmlChar *attr_val = NULL;     /* attribute value */
@@ -1632,7 +1810,7 @@ int add_band_metadata
 
     /* Set up the current and child pointers */
     cur_node = a_node;
-    ns = cur_node->nsDef;
+    ns = get_node_namespace (cur_node);
 
     /* Verify the namespace of this node is our ESPA namespace.  If it isn't
        then the element won't be added to the metadata structure. */
@@ -1724,6 +1902,62 @@ int add_band_metadata
             bmeta->scale_factor = atof ((const char *) attr_val);
         else if (xmlStrEqual (attr->name, (const xmlChar *) "add_offset"))
             bmeta->add_offset = atof ((const char *) attr_val);
+        else if (xmlStrEqual (attr->name,
+            (const xmlChar *) "constant_value"))
+            bmeta->constant_value = atof ((const char *) attr_val);
+        else if (xmlStrEqual (attr->name,
+            (const xmlChar *) "footprint_file"))
+        {
+            count = snprintf (bmeta->footprint_file,
+                sizeof (bmeta->footprint_file), "%s", (const char *) attr_val);
+            if (count < 0 || count >= sizeof (bmeta->footprint_file))
+            {
+                sprintf (errmsg, "Overflow of bmeta->footprint_file string");
+                error_handler (true, FUNC_NAME, errmsg);
+                return (ERROR);
+            }
+        }
+        else if (xmlStrEqual (attr->name,
+            (const xmlChar *) "overview_file"))
+        {
+            count = snprintf (bmeta->overview_file,
+                sizeof (bmeta->overview_file), "%s", (const char *) attr_val);
+            if (count < 0 || count >= sizeof (bmeta->overview_file))
+            {
+                sprintf (errmsg, "Overflow of bmeta->overview_file string");
+                error_handler (true, FUNC_NAME, errmsg);
+                return (ERROR);
+            }
+        }
+        else if (xmlStrEqual (attr->name,
+            (const xmlChar *) "overview_levels"))
+            bmeta->overview_levels = atoi ((const char *) attr_val);
+        else if (xmlStrEqual (attr->name, (const xmlChar *) "encoding"))
+        {
+            count = snprintf (bmeta->encoding, sizeof (bmeta->encoding),
+                "%s", (const char *) attr_val);
+            if (count < 0 || count >= sizeof (bmeta->encoding))
+            {
+                sprintf (errmsg, "Overflow of bmeta->encoding string");
+                error_handler (true, FUNC_NAME, errmsg);
+                return (ERROR);
+            }
+        }
+        else if (xmlStrEqual (attr->name, (const xmlChar *) "tile_size"))
+            bmeta->tile_size = atoi ((const char *) attr_val);
+        else if (xmlStrEqual (attr->name, (const xmlChar *) "file_offset"))
+            bmeta->file_offset = atol ((const char *) attr_val);
+        else if (xmlStrEqual (attr->name, (const xmlChar *) "checksum"))
+        {
+            count = snprintf (bmeta->checksum, sizeof (bmeta->checksum),
+                "%s", (const char *) attr_val);
+            if (count < 0 || count >= sizeof (bmeta->checksum))
+            {
+                sprintf (errmsg, "Overflow of bmeta->checksum string");
+                error_handler (true, FUNC_NAME, errmsg);
+                return (ERROR);
+            }
+        }
         else
         {
             sprintf (errmsg, "WARNING: unknown attribute for element (%s): "
@@ -1739,7 +1973,8 @@ int add_band_metadata
          cur_node = xmlNextElementSibling (cur_node))
     {
         child_node = cur_node->children;
-        if (xmlStrEqual (cur_node->name, (const xmlChar *) "short_name"))
+        elem = lookup_meta_element (cur_node->name);
+        if (elem == ESPA_ELEM_SHORT_NAME)
         {
             /* Expect the child node to be a text node containing the value of
                this field */
@@ -1761,7 +1996,7 @@ int add_band_metadata
                 return (ERROR);
             }
         }
-        else if (xmlStrEqual (cur_node->name, (const xmlChar *) "long_name"))
+        else if (elem == ESPA_ELEM_LONG_NAME)
         {
             /* Expect the child node to be a text node containing the value of
                this field */
@@ -1783,7 +2018,7 @@ int add_band_metadata
                 return (ERROR);
             }
         }
-        else if (xmlStrEqual (cur_node->name, (const xmlChar *) "file_name"))
+        else if (elem == ESPA_ELEM_FILE_NAME)
         {
             /* Expect the child node to be a text node containing the value of
                this field */
@@ -1805,7 +2040,7 @@ int add_band_metadata
                 return (ERROR);
             }
         }
-        else if (xmlStrEqual (cur_node->name, (const xmlChar *) "pixel_size"))
+        else if (elem == ESPA_ELEM_PIXEL_SIZE)
         {
             /* Handle the element attributes */
             for (attr = cur_node->properties; attr != NULL; attr = attr->next)
@@ -1838,8 +2073,7 @@ int add_band_metadata
                 xmlFree (attr_val);
             }
         }
-        else if (xmlStrEqual (cur_node->name,
-            (const xmlChar *) "resample_method"))
+        else if (elem == ESPA_ELEM_RESAMPLE_METHOD)
         {
             /* Expect the child node to be a text node containing the value of
                this field */
@@ -1871,7 +2105,7 @@ int add_band_metadata
                 error_handler (false, FUNC_NAME, errmsg);
             }
         }
-        else if (xmlStrEqual (cur_node->name, (const xmlChar *) "data_units"))
+        else if (elem == ESPA_ELEM_DATA_UNITS)
         {
             /* Expect the child node to be a text node containing the value of
                this field */
@@ -1893,8 +2127,7 @@ int add_band_metadata
                 return (ERROR);
             }
         }
-        else if (xmlStrEqual (cur_node->name,
-            (const xmlChar *) "resample_method"))
+        else if (elem == ESPA_ELEM_RESAMPLE_METHOD)
         {
             /* Expect the child node to be a text node containing the value of
                this field */
@@ -1917,7 +2150,7 @@ int add_band_metadata
             else if (xmlStrEqual (attr_val, (const xmlChar *) "none"))
                 bmeta->resample_method = ESPA_NONE;
         }
-        else if (xmlStrEqual (cur_node->name, (const xmlChar *) "valid_range"))
+        else if (elem == ESPA_ELEM_VALID_RANGE)
         {
             /* Handle the element attributes */
             for (attr = cur_node->properties; attr != NULL; attr = attr->next)
@@ -1936,8 +2169,17 @@ int add_band_metadata
                 xmlFree (attr_val);
             }
         }
-        else if (xmlStrEqual (cur_node->name,
-            (const xmlChar *) "radiance"))
+        else if (elem == ESPA_ELEM_STATISTICS)
+        {
+            if (add_band_metadata_statistics (cur_node, bmeta) != SUCCESS)
+            {
+                sprintf (errmsg, "Processing statistics element: %s.",
+                    cur_node->name);
+                error_handler (true, FUNC_NAME, errmsg);
+                return (ERROR);
+            }
+        }
+        else if (elem == ESPA_ELEM_RADIANCE)
         {
             /* Handle the element attributes */
             for (attr = cur_node->properties; attr != NULL; attr = attr->next)
@@ -1956,8 +2198,7 @@ int add_band_metadata
                 xmlFree (attr_val);
             }
         }
-        else if (xmlStrEqual (cur_node->name,
-            (const xmlChar *) "reflectance"))
+        else if (elem == ESPA_ELEM_REFLECTANCE)
         {
             /* Handle the element attributes */
             for (attr = cur_node->properties; attr != NULL; attr = attr->next)
@@ -1976,8 +2217,7 @@ int add_band_metadata
                 xmlFree (attr_val);
             }
         }
-        else if (xmlStrEqual (cur_node->name,
-            (const xmlChar *) "thermal_const"))
+        else if (elem == ESPA_ELEM_THERMAL_CONST)
         {
             /* Handle the element attributes */
             for (attr = cur_node->properties; attr != NULL; attr = attr->next)
@@ -1996,8 +2236,7 @@ int add_band_metadata
                 xmlFree (attr_val);
             }
         }
-        else if (xmlStrEqual (cur_node->name,
-            (const xmlChar *) "qa_description"))
+        else if (elem == ESPA_ELEM_QA_DESCRIPTION)
         {
             /* Expect the child node to be a text node containing the value of
                this field */
@@ -2019,7 +2258,7 @@ int add_band_metadata
                 return (ERROR);
             }
         }
-        else if (xmlStrEqual (cur_node->name, (const xmlChar *) "app_version"))
+        else if (elem == ESPA_ELEM_APP_VERSION)
         {
             /* Expect the child node to be a text node containing the value of
                this field */
@@ -2041,8 +2280,7 @@ int add_band_metadata
                 return (ERROR);
             }
         }
-        else if (xmlStrEqual (cur_node->name,
-            (const xmlChar *) "level1_filename"))
+        else if (elem == ESPA_ELEM_LEVEL1_FILENAME)
         {
             /* Expect the child node to be a text node containing the value of
                this field */
@@ -2064,8 +2302,7 @@ int add_band_metadata
                 return (ERROR);
             }
         }
-        else if (xmlStrEqual (cur_node->name,
-            (const xmlChar *) "production_date"))
+        else if (elem == ESPA_ELEM_PRODUCTION_DATE)
         {
             /* Expect the child node to be a text node containing the value of
                this field */
@@ -2088,8 +2325,7 @@ int add_band_metadata
                 return (ERROR);
             }
         }
-        else if (xmlStrEqual (cur_node->name,
-            (const xmlChar *) "bitmap_description"))
+        else if (elem == ESPA_ELEM_BITMAP_DESCRIPTION)
         {
             if (add_band_metadata_bitmap_description (cur_node->children,
                 bmeta) != SUCCESS)
@@ -2100,7 +2336,7 @@ int add_band_metadata
                 return (ERROR);
             }
         }
-        else if (xmlStrEqual (cur_node->name, (const xmlChar *) "class_values"))
+        else if (elem == ESPA_ELEM_CLASS_VALUES)
         {
             if (add_band_metadata_class_values (cur_node->children, bmeta) !=
                 SUCCESS)
@@ -2111,8 +2347,7 @@ int add_band_metadata
                 return (ERROR);
             }
         }
-        else if (xmlStrEqual (cur_node->name,
-             (const xmlChar *) "percent_coverage"))
+        else if (elem == ESPA_ELEM_PERCENT_COVERAGE)
         {
             if (add_band_metadata_percent_coverage (cur_node->children, bmeta)
                 != SUCCESS)
@@ -2135,10 +2370,24 @@ int add_band_metadata
 }
 
 
+/* State of the tree walk in parse_xml_nodes, which is kept by the caller
+   rather than in static variables so documents may be parsed concurrently */
+typedef struct
+{
+    int nbands;                 /* number of bands in the XML structure */
+    bool global_metadata;       /* are we parsing the global metadata section
+                                   of the ESPA metadata? */
+    bool bands_metadata;        /* are we parsing the bands metadata section
+                                   of the ESPA metadata? */
+    int cur_band;               /* current band being processed in the bands
+                                   metadata section */
+} Espa_parse_state_t;
+
 /******************************************************************************
-MODULE:  parse_xml_into_struct
+MODULE:  parse_xml_nodes
 
-PURPOSE: Parse the XML document data into the ESPA internal metadata structure.
+PURPOSE: Parse the XML nodes, their children, and their siblings into the ESPA
+internal metadata structure.
 
 RETURN VALUE:
 Type = int
@@ -2151,27 +2400,22 @@ NOTES:
 1. Uses a stack of character strings to keep track of the nodes that have
    been parsed.  The stack must be allocated before calling this routine.
 ******************************************************************************/
-int parse_xml_into_struct
+static int parse_xml_nodes
 (
     xmlNode *a_node,                  /* I: pointer to the current node */
     Espa_internal_meta_t *metadata,   /* I: ESPA internal metadata structure
                                             to be filled */
     int *top_of_stack,                /* I: pointer to top of the stack */
-    char **stack                      /* I: stack to use for parsing */
+    char **stack,                     /* I: stack to use for parsing */
+    Espa_parse_state_t *state         /* I/O: state of the tree walk */
 )
 {
-    char FUNC_NAME[] = "parse_xml_into_struct";  /* function name */
+    char FUNC_NAME[] = "parse_xml_nodes";  /* function name */
     char errmsg[STR_SIZE];        /* error message */
     char *curr_stack_element = NULL;  /* element popped from the stack */
     xmlNode *cur_node = NULL;    /* pointer to the current node */
+    Espa_meta_element_t elem;     /* ID of the current element */
     xmlNode *sib_node = NULL;    /* pointer to the sibling node */
-    static int nbands = 0;       /* number of bands in the XML structure */
-    static bool global_metadata = false;  /* are we parsing the global metadata
-                                    section of the ESPA metadata? */
-    static bool bands_metadata = false;   /* are we parsing the bands metadata
-                                    section of the ESPA metadata? */
-    static int cur_band = 0;     /* current band being processed in the
-                                    bands metadata section */
     bool skip_child;             /* boolean to specify the children of this
                                     node should not be processed */
 
@@ -2186,6 +2430,8 @@ int parse_xml_into_struct
         /* Only print the ELEMENT node types */
         if (cur_node->type == XML_ELEMENT_NODE) 
         {
+            elem = lookup_meta_element (cur_node->name);
+
             /* Push the element to the stack and turn the booleans on if this
                is either the global_metadata or the bands elements */
             //printf ("***Pushed %s\n", cur_node->name); fflush (stdout);
@@ -2200,10 +2446,9 @@ int parse_xml_into_struct
             /* Turn the boolean on if this is the global_metadata. Flag an
                issue if we have already traversed into the global metadata
                section. */
-            if (xmlStrEqual (cur_node->name,
-                (const xmlChar *) "global_metadata"))
+            if (elem == ESPA_ELEM_GLOBAL_METADATA)
             {
-                if (global_metadata)
+                if (state->global_metadata)
                 {
                     sprintf (errmsg, "Current element node is '%s' however we "
                         "are already in the global_metadata section.",
@@ -2211,36 +2456,38 @@ int parse_xml_into_struct
                     error_handler (true, FUNC_NAME, errmsg);
                     return (ERROR);
                 }
-                global_metadata = true;
+                state->global_metadata = true;
             }
 
             /* Turn the boolean on if this is the bands metadata. Flag an
                issue if we have already traversed into the bands section.
                Count the number of band elements in this structure, then
                allocate memory for the nbands. */
-            if (xmlStrEqual (cur_node->name, (const xmlChar *) "bands"))
+            if (elem == ESPA_ELEM_BANDS)
             {
-                if (bands_metadata)
+                if (state->bands_metadata)
                 {
                     sprintf (errmsg, "Current element node is '%s' however we "
                         "are already in the bands section.", cur_node->name);
                     error_handler (true, FUNC_NAME, errmsg);
                     return (ERROR);
                 }
-                bands_metadata = true;
-                cur_band = 0;  /* reset to zero for start of band count */
+                state->bands_metadata = true;
+                state->cur_band = 0;  /* reset to zero for start of band
+                                         count */
 
                 /* Count the number of siblings which are band elements */
-                nbands = 0;
+                state->nbands = 0;
                 for (sib_node = cur_node->children; sib_node;
                      sib_node = xmlNextElementSibling (sib_node))
                 {
                     /* If this is a band element then count it */
-                    if (xmlStrEqual (sib_node->name, (const xmlChar *) "band"))
-                        nbands++;
+                    if (lookup_meta_element (sib_node->name) ==
+                        ESPA_ELEM_BAND)
+                        state->nbands++;
                 }
 
-                if (allocate_band_metadata (metadata, nbands) != SUCCESS)
+                if (allocate_band_metadata (metadata, state->nbands) != SUCCESS)
                 {   /* Error messages already printed */
                     return (ERROR);
                 }
@@ -2259,8 +2506,7 @@ int parse_xml_into_struct
             /* If we are IN the global metadata (don't process the actual
                global_metadata element) then consume this node and add the
                information to the global metadata structure */
-            if (global_metadata && !xmlStrEqual (cur_node->name,
-                (const xmlChar *) "global_metadata"))
+            if (state->global_metadata && elem != ESPA_ELEM_GLOBAL_METADATA)
             {
                 if (add_global_metadata (cur_node, &metadata->global))
                 {
@@ -2278,19 +2524,19 @@ int parse_xml_into_struct
             /* If we are IN the bands metadata and at a band element, then
                consume this node and add the information to the band metadata
                structure for the current band */
-            if (bands_metadata && xmlStrEqual (cur_node->name,
-                (const xmlChar *) "band"))
+            if (state->bands_metadata && elem == ESPA_ELEM_BAND)
             {
-                if (cur_band >= nbands)
+                if (state->cur_band >= state->nbands)
                 {
                     sprintf (errmsg, "Number of bands consumed already "
                         "reached the total number of bands allocated for this "
-                        "XML file (%d).", nbands);
+                        "XML file (%d).", state->nbands);
                     error_handler (true, FUNC_NAME, errmsg);
                     return (ERROR);
                 }
 
-                if (add_band_metadata (cur_node, &metadata->band[cur_band++]))
+                if (add_band_metadata (cur_node,
+                    &metadata->band[state->cur_band++]))
                 {
                     sprintf (errmsg, "Consuming band metadata element '%s'.",
                         cur_node->name);
@@ -2315,8 +2561,8 @@ int parse_xml_into_struct
            elsewhere */
         if (!skip_child)
         {
-            if (parse_xml_into_struct (cur_node->children, metadata,
-                top_of_stack, stack))
+            if (parse_xml_nodes (cur_node->children, metadata,
+                top_of_stack, stack, state))
             {
                 sprintf (errmsg, "Parsing the children of this element '%s'.",
                     cur_node->name);
@@ -2338,9 +2584,9 @@ int parse_xml_into_struct
             }
 
             if (!strcmp (curr_stack_element, "global_metadata"))
-                global_metadata = false;
+                state->global_metadata = false;
             if (!strcmp (curr_stack_element, "bands"))
-                bands_metadata = false;
+                state->bands_metadata = false;
         }
     }  /* for cur_node */
 
@@ -2348,6 +2594,379 @@ int parse_xml_into_struct
 }
 
 
+/******************************************************************************
+MODULE:  parse_xml_into_struct
+
+PURPOSE: Parse the XML document data into the ESPA internal metadata structure.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error parsing the metadata elements
+SUCCESS         Successful parse of the metadata values
+
+NOTES:
+1. Uses a stack of character strings to keep track of the nodes that have
+   been parsed.  The stack must be allocated before calling this routine.
+2. Reentrant; each call walks the tree with its own state.
+******************************************************************************/
+int parse_xml_into_struct
+(
+    xmlNode *a_node,                  /* I: pointer to the current node */
+    Espa_internal_meta_t *metadata,   /* I: ESPA internal metadata structure
+                                            to be filled */
+    int *top_of_stack,                /* I: pointer to top of the stack */
+    char **stack                      /* I: stack to use for parsing */
+)
+{
+    Espa_parse_state_t state = {0, false, false, 0};  /* tree walk state */
+
+    return (parse_xml_nodes (a_node, metadata, top_of_stack, stack, &state));
+}
+
+
+/******************************************************************************
+MODULE:  parse_metadata_doc
+
+PURPOSE: Populate the ESPA internal metadata structure from a metadata
+document which has already been read into memory.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error parsing the metadata elements
+SUCCESS         Successful parse of the metadata values
+
+NOTES:
+1. Uses a stack of character strings to keep track of the nodes that have beend
+   found in the metadata document.
+2. The document is not freed.
+******************************************************************************/
+int parse_metadata_doc
+(
+    xmlDocPtr doc,                  /* I: document tree of the metadata */
+    Espa_internal_meta_t *metadata  /* I: input metadata structure which has
+                                          been initialized via
+                                          init_metadata_struct */
+)
+{
+    char FUNC_NAME[] = "parse_metadata_doc";  /* function name */
+    char errmsg[STR_SIZE];        /* error message */
+    xmlNodePtr root = NULL;   /* root element of the document */
+    xmlNsPtr ns = NULL;       /* namespace of the root element */
+    int top_of_stack;         /* top of the stack */
+    int count;                /* number of chars copied in snprintf */
+    char **stack = NULL;      /* stack to keep track of elements in the tree */
+
+    /* Store the namespace for the overall metadata file */
+    root = xmlDocGetRootElement (doc);
+    if (root != NULL)
+        ns = get_node_namespace (root);
+    if (ns == NULL)
+    {
+        sprintf (errmsg, "Metadata document does not have a namespace");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    count = snprintf (metadata->meta_namespace,
+        sizeof (metadata->meta_namespace), "%s", (const char *) ns->href);
+    if (count < 0 || count >= sizeof (metadata->meta_namespace))
+    {
+        sprintf (errmsg, "Overflow of metadata->meta_namespace string");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Initialize the stack to hold the elements */
+    if (init_stack (&top_of_stack, &stack))
+    {
+        sprintf (errmsg, "Initializing the stack.");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    //print_element_names (root);
+
+    /* Parse the XML document into our ESPA internal metadata structure */
+    if (parse_xml_into_struct (root, metadata, &top_of_stack, stack))
+    {
+        sprintf (errmsg, "Parsing the metadata file into the internal "
+            "metadata structure.");
+        error_handler (true, FUNC_NAME, errmsg);
+        free_stack (&stack);
+        return (ERROR);
+    }
+
+    /* Clean up the stack */
+    free_stack (&stack);
+
+    /* Index the bands for the lookups of the tools; without the index the
+       lookups search the bands one by one */
+    build_espa_band_index (metadata);
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  parse_metadata_stream
+
+PURPOSE: Parse the input metadata file and populate the associated ESPA
+internal metadata structure in a single forward pass with the XML pull
+parser, without building a tree of the full document.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error parsing the metadata elements
+SUCCESS         Successful parse of the metadata values
+
+NOTES:
+1. Only the global_metadata element and one band element at a time are
+   expanded into a tree, which is handed to the same element parsers used by
+   parse_xml_into_struct so the results are identical.  The reader releases
+   each subtree once it moves past it, so peak memory is bounded by the
+   largest band rather than the whole document.
+2. The number of bands isn't known until the bands element has been read,
+   so the band array is grown as the bands are found.
+******************************************************************************/
+int parse_metadata_stream
+(
+    char *metafile,                 /* I: input metadata file or URL */
+    Espa_internal_meta_t *metadata  /* I: input metadata structure which has
+                                          been initialized via
+                                          init_metadata_struct */
+)
+{
+    char FUNC_NAME[] = "parse_metadata_stream";  /* function name */
+    char errmsg[STR_SIZE];        /* error message */
+    xmlTextReaderPtr reader = NULL; /* reader for the XML file */
+    xmlNodePtr node = NULL;       /* expanded subtree of the current element */
+    xmlNodePtr child = NULL;      /* current child of the expanded subtree */
+    const xmlChar *name = NULL;   /* local name of the current element */
+    Espa_meta_element_t elem;     /* ID of the current element */
+    const xmlChar *uri = NULL;    /* namespace of the root element */
+    Espa_internal_meta_t fill_meta; /* holds a band initialized to fill */
+    Espa_band_meta_t fill_band;   /* band initialized to fill */
+    Espa_band_meta_t *bands = NULL; /* reallocated band array */
+    bool global_found = false;    /* has the global metadata been found? */
+    bool bands_found = false;     /* has the bands element been found? */
+    int bands_depth = -1;         /* depth of the open bands element; -1 if
+                                     not within the bands */
+    int depth;                    /* depth of the current node */
+    int nodeType;                 /* node type (element, end element, etc.) */
+    int max_bands = 0;            /* number of bands allocated */
+    int status;                   /* return status */
+    int count;                    /* number of chars copied in snprintf */
+
+    /* Set up a band initialized to fill for each band that is found.  The
+       metadata takes over the arena of the fill band, so the arrays of every
+       band are allocated from it. */
+    if (allocate_band_metadata (&fill_meta, 1) != SUCCESS)
+    {   /* Error messages already printed */
+        return (ERROR);
+    }
+    fill_band = fill_meta.band[0];
+    free (fill_meta.band);
+    metadata->arena = fill_meta.arena;
+
+    /* Establish the reader for this metadata file, dropping blank text nodes
+       to match the tree built by parse_metadata */
+    reader = xmlReaderForFile (metafile, NULL, XML_PARSE_NOBLANKS);
+    if (reader == NULL)
+    {
+        sprintf (errmsg, "Setting up reader for %s", metafile);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    status = xmlTextReaderRead (reader);
+    while (status == 1)
+    {
+        nodeType = xmlTextReaderNodeType (reader);
+        depth = xmlTextReaderDepth (reader);
+        if (nodeType == -1 || depth == -1)
+        {
+            sprintf (errmsg, "Getting node type");
+            error_handler (true, FUNC_NAME, errmsg);
+            xmlFreeTextReader (reader);
+            return (ERROR);
+        }
+
+        /* Leaving the bands element */
+        if (nodeType == XML_READER_TYPE_END_ELEMENT && depth == bands_depth)
+            bands_depth = -1;
+
+        if (nodeType != XML_READER_TYPE_ELEMENT)
+        {
+            status = xmlTextReaderRead (reader);
+            continue;
+        }
+        name = xmlTextReaderConstLocalName (reader);
+        elem = lookup_meta_element (name);
+
+        /* Store the namespace for the overall metadata file */
+        if (depth == 0)
+        {
+            uri = xmlTextReaderConstNamespaceUri (reader);
+            if (uri == NULL)
+            {
+                sprintf (errmsg, "Metadata document does not have a "
+                    "namespace");
+                error_handler (true, FUNC_NAME, errmsg);
+                xmlFreeTextReader (reader);
+                return (ERROR);
+            }
+            count = snprintf (metadata->meta_namespace,
+                sizeof (metadata->meta_namespace), "%s", (const char *) uri);
+            if (count < 0 || count >= sizeof (metadata->meta_namespace))
+            {
+                sprintf (errmsg, "Overflow of metadata->meta_namespace "
+                    "string");
+                error_handler (true, FUNC_NAME, errmsg);
+                xmlFreeTextReader (reader);
+                return (ERROR);
+            }
+        }
+
+        /* Expand the global metadata and consume each of its elements */
+        else if (elem == ESPA_ELEM_GLOBAL_METADATA)
+        {
+            if (global_found)
+            {
+                sprintf (errmsg, "Current element node is '%s' however we "
+                    "have already parsed the global_metadata section.", name);
+                error_handler (true, FUNC_NAME, errmsg);
+                xmlFreeTextReader (reader);
+                return (ERROR);
+            }
+            global_found = true;
+
+            node = xmlTextReaderExpand (reader);
+            if (node == NULL)
+            {
+                sprintf (errmsg, "Reading the global_metadata section");
+                error_handler (true, FUNC_NAME, errmsg);
+                xmlFreeTextReader (reader);
+                return (ERROR);
+            }
+            for (child = xmlFirstElementChild (node); child;
+                 child = xmlNextElementSibling (child))
+            {
+                if (add_global_metadata (child, &metadata->global))
+                {
+                    sprintf (errmsg, "Consuming global_metadata element "
+                        "'%s'.", child->name);
+                    error_handler (true, FUNC_NAME, errmsg);
+                    xmlFreeTextReader (reader);
+                    return (ERROR);
+                }
+            }
+
+            /* Skip past the global metadata, releasing it */
+            status = xmlTextReaderNext (reader);
+            continue;
+        }
+
+        /* Entering the bands element */
+        else if (elem == ESPA_ELEM_BANDS)
+        {
+            if (bands_found)
+            {
+                sprintf (errmsg, "Current element node is '%s' however we "
+                    "have already parsed the bands section.", name);
+                error_handler (true, FUNC_NAME, errmsg);
+                xmlFreeTextReader (reader);
+                return (ERROR);
+            }
+            bands_found = true;
+            metadata->nbands = 0;
+            if (!xmlTextReaderIsEmptyElement (reader))
+                bands_depth = depth;
+        }
+
+        /* Expand the next band and consume it */
+        else if (bands_depth >= 0 && depth == bands_depth + 1 &&
+            elem == ESPA_ELEM_BAND)
+        {
+            if (metadata->nbands == max_bands)
+            {
+                max_bands = max_bands == 0 ? 16 : max_bands * 2;
+                bands = realloc (metadata->band,
+                    max_bands * sizeof (Espa_band_meta_t));
+                if (bands == NULL)
+                {
+                    sprintf (errmsg, "Allocating ESPA band metadata for %d "
+                        "bands", max_bands);
+                    error_handler (true, FUNC_NAME, errmsg);
+                    xmlFreeTextReader (reader);
+                    return (ERROR);
+                }
+                metadata->band = bands;
+            }
+            metadata->band[metadata->nbands] = fill_band;
+
+            node = xmlTextReaderExpand (reader);
+            if (node == NULL)
+            {
+                sprintf (errmsg, "Reading band %d", metadata->nbands);
+                error_handler (true, FUNC_NAME, errmsg);
+                xmlFreeTextReader (reader);
+                return (ERROR);
+            }
+
+            /* Count the band before parsing it so free_metadata releases
+               whatever was allocated for it if the parse fails */
+            metadata->nbands++;
+            if (add_band_metadata (node,
+                &metadata->band[metadata->nbands-1]))
+            {
+                sprintf (errmsg, "Consuming band metadata element '%s'.",
+                    name);
+                error_handler (true, FUNC_NAME, errmsg);
+                xmlFreeTextReader (reader);
+                return (ERROR);
+            }
+
+            /* Skip past the band, releasing it */
+            status = xmlTextReaderNext (reader);
+            continue;
+        }
+
+        /* Read the next node */
+        status = xmlTextReaderRead (reader);
+    }  /* end while */
+    if (status != 0)
+    {
+        sprintf (errmsg, "Failed to parse %s", metafile);
+        error_handler (true, FUNC_NAME, errmsg);
+        xmlFreeTextReader (reader);
+        return (ERROR);
+    }
+
+    /* Trim the band array to the number of bands found */
+    if (metadata->nbands > 0 && metadata->nbands < max_bands)
+    {
+        bands = realloc (metadata->band,
+            metadata->nbands * sizeof (Espa_band_meta_t));
+        if (bands != NULL)
+            metadata->band = bands;
+    }
+
+    /* Index the bands for the lookups of the tools; without the index the
+       lookups search the bands one by one */
+    build_espa_band_index (metadata);
+
+    /* Free the reader and associated memory */
+    xmlFreeTextReader (reader);
+    cleanup_espa_xml ();
+
+    return (SUCCESS);
+}
+
+
 /******************************************************************************
 MODULE:  parse_metadata
 
@@ -2367,6 +2986,12 @@ NOTES:
 2. For debugging purposes
    xmlDocDump (stderr, doc);
    can be used to dump/print the XML doc to the screen.
+3. Setting ESPA_XML_PARSER_ENV to stream selects the streaming engine
+   (parse_metadata_stream) in place of building the full document tree.
+4. A current binary metadata cache (see metadata_cache.h) is used in place of
+   parsing the XML file when the cache has been turned on.
+5. The band index of the metadata (see espa_band_index.h) is built after the
+   bands are parsed or read from the cache.
 ******************************************************************************/
 int parse_metadata
 (
@@ -2383,9 +3008,25 @@ int parse_metadata
     xmlNodePtr current=NULL;  /* pointer to the current node */
     int status;               /* return status */
     int nodeType;             /* node type (element, text, attribute, etc.) */
-    int top_of_stack;         /* top of the stack */
-    int count;                /* number of chars copied in snprintf */
-    char **stack = NULL;      /* stack to keep track of elements in the tree */
+    char *engine = NULL;      /* requested parsing engine */
+    ESPA_TRACE_SCOPE (trace, "parse_metadata", metafile);  /* timing */
+
+    /* Use the binary metadata cache if it is current */
+    if (use_metadata_cache ())
+    {
+        status = read_metadata_cache (metafile, false, metadata);
+        espa_metrics_cache (ESPA_METRICS_METADATA, status == SUCCESS);
+        if (status == SUCCESS)
+        {
+            build_espa_band_index (metadata);
+            return (SUCCESS);
+        }
+    }
+
+    /* Use the streaming engine if it was requested */
+    engine = getenv (ESPA_XML_PARSER_ENV);
+    if (engine != NULL && !strcmp (engine, "stream"))
+        return (parse_metadata_stream (metafile, metadata));
 
     /* Establish the reader for this metadata file */
     reader = xmlNewTextReaderFilename (metafile);
@@ -2552,46 +3193,106 @@ int parse_metadata
        tree to be parsed and read into the ESPA metadata structure */
     if (doc != NULL)
     {
-        /* Store the namespace for the overall metadata file */
-        xmlNsPtr ns = xmlDocGetRootElement(doc)->nsDef;
-        count = snprintf (metadata->meta_namespace,
-            sizeof (metadata->meta_namespace), "%s", (const char *) ns->href);
-        if (count < 0 || count >= sizeof (metadata->meta_namespace))
+        if (parse_metadata_doc (doc, metadata) != SUCCESS)
         {
-            sprintf (errmsg, "Overflow of metadata->meta_namespace string");
+            sprintf (errmsg, "Parsing the %s document tree", metafile);
             error_handler (true, FUNC_NAME, errmsg);
             return (ERROR);
         }
 
-        /* Initialize the stack to hold the elements */
-        if (init_stack (&top_of_stack, &stack))
-        {
-            sprintf (errmsg, "Initializing the stack.");
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
-        //print_element_names (xmlDocGetRootElement (doc));
+        /* Clean up the XML document */
+        xmlFreeDoc (doc);
+    }
+
+    /* Free the reader and associated memory */
+    xmlFreeTextReader (reader);
+    cleanup_espa_xml ();
+
+    return (SUCCESS);
+}
+
 
-        /* Parse the XML document into our ESPA internal metadata structure */
-        if (parse_xml_into_struct (xmlDocGetRootElement(doc), metadata,
-            &top_of_stack, stack))
+
+/******************************************************************************
+MODULE:  validate_and_parse_metadata
+
+PURPOSE: Read the input metadata file once, validate it against the ESPA
+schema, and populate the associated ESPA internal metadata structure from the
+same document tree.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error reading, validating, or parsing the metadata file
+SUCCESS         Metadata file validates and was parsed successfully
+
+NOTES:
+1. Replaces a call to validate_xml_file followed by parse_metadata, which
+   reads and parses the XML file twice.
+2. A current binary metadata cache built from a valid XML file is used in
+   place of reading and validating the XML file when the cache has been
+   turned on.
+******************************************************************************/
+int validate_and_parse_metadata
+(
+    char *metafile,                 /* I: input metadata file or URL */
+    Espa_internal_meta_t *metadata  /* I: input metadata structure which has
+                                          been initialized via
+                                          init_metadata_struct */
+)
+{
+    char FUNC_NAME[] = "validate_and_parse_metadata";  /* function name */
+    char errmsg[STR_SIZE];        /* error message */
+    xmlDocPtr doc = NULL;     /* document tree pointer */
+    int status;               /* return status */
+    ESPA_TRACE_SCOPE (trace, "validate_and_parse_metadata",
+        metafile);            /* timing */
+
+    /* Use the binary metadata cache if it is current and validated */
+    if (use_metadata_cache ())
+    {
+        status = read_metadata_cache (metafile, true, metadata);
+        espa_metrics_cache (ESPA_METRICS_METADATA, status == SUCCESS);
+        if (status == SUCCESS)
         {
-            sprintf (errmsg, "Parsing the metadata file into the internal "
-                "metadata structure.");
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
+            build_espa_band_index (metadata);
+            return (SUCCESS);
         }
+    }
+
+    /* Load the XML file and parse it to the document tree.  Blank text nodes
+       are dropped to match the tree built by parse_metadata, since the tree
+       walk expects the first child of a parent element to be an element. */
+    doc = xmlReadFile (metafile, NULL, XML_PARSE_NOBLANKS);
+    if (doc == NULL)
+    {
+        sprintf (errmsg, "Could not parse %s", metafile);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
 
-        /* Clean up the XML document and the stack */
+    /* Validate the document against the schema */
+    if (validate_xml_doc (doc, metafile) != SUCCESS)
+    {
+        sprintf (errmsg, "Validating %s", metafile);
+        error_handler (true, FUNC_NAME, errmsg);
         xmlFreeDoc (doc);
-        free_stack (&stack);
+        return (ERROR);
     }
 
-    /* Free the reader and associated memory */
-    xmlFreeTextReader (reader);
-    xmlCleanupParser();
-    xmlMemoryDump();
+    /* Populate the metadata structure from the same document tree */
+    if (parse_metadata_doc (doc, metadata) != SUCCESS)
+    {
+        sprintf (errmsg, "Parsing the %s document tree", metafile);
+        error_handler (true, FUNC_NAME, errmsg);
+        xmlFreeDoc (doc);
+        return (ERROR);
+    }
+
+    /* Free the document and associated memory */
+    xmlFreeDoc (doc);
+    cleanup_espa_xml ();
 
     return (SUCCESS);
 }
-
@@ -23,6 +23,16 @@ NOTES:
 #include <libxml/xmlschemastypes.h>
 #include "error_handler.h"
 #include "espa_metadata.h"
+#include "espa_band_index.h"
+
+/* Defines */
+#define ESPA_XML_PARSER_ENV "ESPA_XML_PARSER" /* set to stream to parse the
+                                     metadata with parse_metadata_stream */
+
+xmlNsPtr get_node_namespace
+(
+    xmlNode *node               /* I: pointer to the element node */
+);
 
 int add_global_metadata_proj_info_albers
 (
@@ -90,6 +100,14 @@ int add_band_metadata_percent_coverage
                                       band in the bands structure */
 );
 
+int add_band_metadata_statistics
+(
+    xmlNode *a_node,            /* I/O: pointer to the statistics element
+                                        node to process */
+    Espa_band_meta_t *bmeta     /* I: band metadata structure for current
+                                      band in the bands structure */
+);
+
 int add_band_metadata
 (
     xmlNode *a_node,            /* I: pointer to the element node to process */
@@ -106,6 +124,22 @@ int parse_xml_into_struct
     char **stack                      /* I: stack to use for parsing */
 );
 
+int parse_metadata_doc
+(
+    xmlDocPtr doc,                  /* I: document tree of the metadata */
+    Espa_internal_meta_t *metadata  /* I: input metadata structure which has
+                                          been initialized via
+                                          init_metadata_struct */
+);
+
+int parse_metadata_stream
+(
+    char *metafile,                 /* I: input metadata file or URL */
+    Espa_internal_meta_t *metadata  /* I: input metadata structure which has
+                                          been initialized via
+                                          init_metadata_struct */
+);
+
 int parse_metadata
 (
     char *metafile,                 /* I: input metadata file or URL */
@@ -114,4 +148,12 @@ int parse_metadata
                                           init_metadata_struct */
 );
 
+int validate_and_parse_metadata
+(
+    char *metafile,                 /* I: input metadata file or URL */
+    Espa_internal_meta_t *metadata  /* I: input metadata structure which has
+                                          been initialized via
+                                          init_metadata_struct */
+);
+
 #endif
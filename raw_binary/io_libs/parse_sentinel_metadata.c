@@ -16,16 +16,35 @@ NOTES:
   2. This code relies on the libxml2 library developed for the Gnome project.
   3. The information on the Sentinel-2 L1C metadata files (MTD_MSIL1C.xml and
      MTD_TL.xml) can be found in the S2_MSI_Product_Specification.pdf file.
+  4. parse_sentinel_metadata reads the product and tile metadata files at the
+     same time; the readers for each file write disjoint global fields.
+  5. The JP2 files of a granule are looked for in its directory, rather than
+     the current directory, when one is given, so the granules may be
+     parsed from several threads of one process.
 *****************************************************************************/
+#include <pthread.h>
 #include "dirent.h"
 #include "espa_metadata.h"
 #include "parse_sentinel_metadata.h"
+#include "meta_element.h"
+
+/* Tile metadata file to be read on a second thread by
+   parse_sentinel_metadata, and what was read from it */
+typedef struct
+{
+    char *metafile;                   /* tile metadata file */
+    Espa_internal_meta_t *metadata;   /* metadata to be populated */
+    char meta_namespace[STR_SIZE];    /* namespace of the tile metadata */
+    int nrows[NUM_SENTINEL_RES];      /* num rows for each resolution */
+    int ncols[NUM_SENTINEL_RES];      /* num columns for each resolution */
+    int status;                       /* status of reading the file */
+} Sentinel_tile_job_t;
 
 
 /******************************************************************************
 MODULE:  find_file
 
-PURPOSE: Read the current directory and look for the current file
+PURPOSE: Read the granule directory and look for the current file
 
 RETURN VALUE:
 Type = bool
@@ -38,25 +57,29 @@ NOTES:
 ******************************************************************************/
 bool find_file
 (
-    char *basefile    /* I: base filename to check for existence (no file
-                            extension) */
+    char *granule_dir, /* I: directory to look in; NULL for the current
+                             directory */
+    char *basefile     /* I: base filename to check for existence (no file
+                             extension) */
 )
 {
     char FUNC_NAME[] = "find_file";  /* function name */
     char errmsg[STR_SIZE];           /* error message */
     char myfile[STR_SIZE];           /* full filename to search for */
     bool retval;                     /* value to designate if file was found */
-    DIR *dr = NULL;                  /* ptr to current directory */
+    DIR *dr = NULL;                  /* ptr to granule directory */
     struct dirent *de = NULL;        /* ptr for directory entry */
 
     /* Add the .jp2 file extension to the filename to determine if it exists */
     sprintf (myfile, "%s.jp2", basefile);
 
-    /* Open the current directory */
-    dr = opendir(".");
+    /* Open the granule directory */
+    if (granule_dir == NULL)
+        granule_dir = ".";
+    dr = opendir (granule_dir);
     if (dr == NULL)
     {
-        sprintf (errmsg, "Could not open current directory");
+        sprintf (errmsg, "Could not open directory %s", granule_dir);
         error_handler (true, FUNC_NAME, errmsg);
         return (false);
     }
@@ -104,15 +127,17 @@ int add_mean_solar_angles
     char FUNC_NAME[] = "add_mean_solar_angles";   /* function name */
     char errmsg[STR_SIZE];        /* error message */
     xmlNode *cur_node = NULL;     /* pointer to the current node */
+    Espa_meta_element_t elem;     /* ID of the current element */
     xmlNode *child_node = NULL;   /* pointer to the child node */
 
     /* Process the siblings in the Mean_Sun_Angle element */
     for (cur_node = a_node->children; cur_node;
          cur_node = xmlNextElementSibling (cur_node))
     {
+        elem = lookup_meta_element (cur_node->name);
+
         /* Process the zenith angle */
-        if (xmlStrEqual (cur_node->name,
-            (const xmlChar *) "ZENITH_ANGLE"))
+        if (elem == ESPA_ELEM_ZENITH_ANGLE)
         {
             /* Expect the child node to be a text node containing the value
                of this field */
@@ -131,8 +156,7 @@ int add_mean_solar_angles
         }
 
         /* Process the azimuth angle */
-        if (xmlStrEqual (cur_node->name,
-            (const xmlChar *) "AZIMUTH_ANGLE"))
+        if (elem == ESPA_ELEM_AZIMUTH_ANGLE)
         {
             /* Expect the child node to be a text node containing the value
                of this field */
@@ -183,15 +207,17 @@ int add_mean_viewing_angles
     char FUNC_NAME[] = "add_mean_viewing_angles";   /* function name */
     char errmsg[STR_SIZE];        /* error message */
     xmlNode *cur_node = NULL;     /* pointer to the current node */
+    Espa_meta_element_t elem;     /* ID of the current element */
     xmlNode *child_node = NULL;   /* pointer to the child node */
 
     /* Process the siblings in the Mean_Viewing_Incidence_Angle element */
     for (cur_node = a_node->children; cur_node;
          cur_node = xmlNextElementSibling (cur_node))
     {
+        elem = lookup_meta_element (cur_node->name);
+
         /* Process the zenith angle */
-        if (xmlStrEqual (cur_node->name,
-            (const xmlChar *) "ZENITH_ANGLE"))
+        if (elem == ESPA_ELEM_ZENITH_ANGLE)
         {
             /* Expect the child node to be a text node containing the value
                of this field */
@@ -210,8 +236,7 @@ int add_mean_viewing_angles
         }
 
         /* Process the azimuth angle */
-        if (xmlStrEqual (cur_node->name,
-            (const xmlChar *) "AZIMUTH_ANGLE"))
+        if (elem == ESPA_ELEM_AZIMUTH_ANGLE)
         {
             /* Expect the child node to be a text node containing the value
                of this field */
@@ -266,8 +291,10 @@ int add_tile_geocoding_metadata
     char tmpstr[STR_SIZE];        /* temporary string */
     char tmp_zone[STR_SIZE];      /* temporary zone string */
     xmlNode *cur_node = NULL;     /* pointer to the current node */
+    Espa_meta_element_t elem;     /* ID of the current element */
     xmlNode *child_node = NULL;   /* pointer to the child node */
     xmlNode *sib_node = NULL;     /* pointer to the sibling node */
+    Espa_meta_element_t sib_elem; /* ID of the sibling element */
     xmlNode *sib_child_node = NULL; /* pointer to the sibling's child node */
     xmlAttrPtr attr = NULL;       /* pointer to the element attributes */
     xmlChar *attr_val = NULL;     /* attribute value */
@@ -280,10 +307,11 @@ int add_tile_geocoding_metadata
     for (cur_node = a_node->children; cur_node;
          cur_node = xmlNextElementSibling (cur_node))
     {
+        elem = lookup_meta_element (cur_node->name);
+
         /* Process the horizontal CS name for the datum, projection, and
            zone code */
-        if (xmlStrEqual (cur_node->name,
-            (const xmlChar *) "HORIZONTAL_CS_NAME"))
+        if (elem == ESPA_ELEM_HORIZONTAL_CS_NAME)
         {
             /* Expect the child node to be a text node containing the value
                of this field */
@@ -329,7 +357,7 @@ int add_tile_geocoding_metadata
         }
 
         /* Process the nrows/ncols */
-        if (xmlStrEqual (cur_node->name, (const xmlChar *) "Size"))
+        if (elem == ESPA_ELEM_SIZE)
         {
             /* Get the resolution attribute */
             index = -99;
@@ -374,16 +402,17 @@ int add_tile_geocoding_metadata
             {
                 /* Get the child node of the sibling */
                 sib_child_node = sib_node->children;
+                sib_elem = lookup_meta_element (sib_node->name);
 
                 /* If this is the NROWS then store number of rows */
-                if (xmlStrEqual (sib_node->name, (const xmlChar *) "NROWS"))
+                if (sib_elem == ESPA_ELEM_NROWS)
                 {
                     nrows[index] =
                         atoi ((const char *) sib_child_node->content);
                 }
 
                 /* If this is the NCOLS then store number of columns */
-                if (xmlStrEqual (sib_node->name, (const xmlChar *) "NCOLS"))
+                if (sib_elem == ESPA_ELEM_NCOLS)
                 {
                     ncols[index] =
                         atoi ((const char *) sib_child_node->content);
@@ -392,7 +421,7 @@ int add_tile_geocoding_metadata
         }
 
         /* Process the UL x/y */
-        if (xmlStrEqual (cur_node->name, (const xmlChar *) "Geoposition"))
+        if (elem == ESPA_ELEM_GEOPOSITION)
         {
             /* Get the resolution attribute */
             index = -99;
@@ -437,13 +466,14 @@ int add_tile_geocoding_metadata
             {
                 /* Get the child node of the sibling */
                 sib_child_node = sib_node->children;
+                sib_elem = lookup_meta_element (sib_node->name);
 
                 /* If this is the ULX then store the value */
-                if (xmlStrEqual (sib_node->name, (const xmlChar *) "ULX"))
+                if (sib_elem == ESPA_ELEM_ULX)
                     ulx[index] = atoi ((const char *) sib_child_node->content);
 
                 /* If this is the ULY then store the value */
-                if (xmlStrEqual (sib_node->name, (const xmlChar *) "ULY"))
+                if (sib_elem == ESPA_ELEM_ULY)
                     uly[index] = atoi ((const char *) sib_child_node->content);
             }
         }
@@ -499,6 +529,7 @@ int parse_sentinel_tile_xml_into_struct
     int count;                   /* number of chars copied in snprintf */
     char *curr_stack_element = NULL;  /* element popped from the stack */
     xmlNode *cur_node = NULL;    /* pointer to the current node */
+    Espa_meta_element_t elem;     /* ID of the current element */
     xmlNode *child_node = NULL;  /* pointer to the child node */
     bool view_angle_found = false;  /* boolean to specify when the first view
                                     angle was processed */
@@ -518,6 +549,8 @@ int parse_sentinel_tile_xml_into_struct
         /* Only print the ELEMENT node types */
         if (cur_node->type == XML_ELEMENT_NODE) 
         {
+            elem = lookup_meta_element (cur_node->name);
+
             /* Push the element to the stack and turn the boolean on if this
                is either Granule metadata */
             //printf ("***Pushed %s\n", cur_node->name); fflush (stdout);
@@ -532,8 +565,7 @@ int parse_sentinel_tile_xml_into_struct
             /* Process the sensing time for the acquisition date/time.  The
                sensing time of the tile is defined as the time stamp of the
                first line of the Granule. */
-            if (xmlStrEqual (cur_node->name,
-                (const xmlChar *) "SENSING_TIME"))
+            if (elem == ESPA_ELEM_SENSING_TIME)
             {
                 /* Expect the child node to be a text node containing the
                    value of this field */
@@ -563,8 +595,7 @@ int parse_sentinel_tile_xml_into_struct
             }
 
             /* Process the geocoding metadata */
-            else if (xmlStrEqual (cur_node->name,
-                (const xmlChar *) "Tile_Geocoding"))
+            else if (elem == ESPA_ELEM_TILE_GEOCODING)
             {
                 /* Add the geocoding information to the band and global
                    metadata */
@@ -582,8 +613,7 @@ int parse_sentinel_tile_xml_into_struct
             }
 
             /* Process the mean solar angles */
-            else if (xmlStrEqual (cur_node->name,
-                (const xmlChar *) "Mean_Sun_Angle"))
+            else if (elem == ESPA_ELEM_MEAN_SUN_ANGLE)
             {
                 /* Add the solar angles to the global metadata */
                 if (add_mean_solar_angles (cur_node, gmeta))
@@ -601,8 +631,8 @@ int parse_sentinel_tile_xml_into_struct
 
             /* Process the mean viewing angles, only grab the first band in
                the list */
-            else if (!view_angle_found && (xmlStrEqual (cur_node->name,
-                (const xmlChar *) "Mean_Viewing_Incidence_Angle")))
+            else if (!view_angle_found &&
+                elem == ESPA_ELEM_MEAN_VIEWING_INCIDENCE_ANGLE)
             {
                 /* Add the viewing angles to the global metadata */
                 if (add_mean_viewing_angles (cur_node, gmeta))
@@ -659,6 +689,8 @@ int parse_sentinel_tile_xml_into_struct
            the stack */
         if (cur_node->type == XML_ELEMENT_NODE)
         {
+            elem = lookup_meta_element (cur_node->name);
+
             curr_stack_element = pop (top_of_stack, stack);
             if (curr_stack_element == NULL)
             {
@@ -675,10 +707,10 @@ int parse_sentinel_tile_xml_into_struct
 
 
 /******************************************************************************
-MODULE:  parse_sentinel_tile_metadata
+MODULE:  read_sentinel_tile_metadata
 
-PURPOSE: Parse the Sentinel L1C tile metadata file (MTD_TL.xml) and populate
-the associated ESPA internal metadata file.
+PURPOSE: Read the Sentinel L1C tile metadata file (MTD_TL.xml) into the global
+metadata, returning the tile size of each resolution for the bands.
 
 RETURN VALUE:
 Type = int
@@ -693,29 +725,31 @@ NOTES:
 2. For debugging purposes
    xmlDocDump (stderr, doc);
    can be used to dump/print the XML doc to the screen.
+3. Only the tile fields of the global metadata are written, and the XML
+   library is not cleaned up, so the product metadata may be read at the same
+   time from another thread.
 ******************************************************************************/
-int parse_sentinel_tile_metadata
+static int read_sentinel_tile_metadata
 (
     char *metafile,                 /* I: input Sentinel tile metadata file */
-    Espa_internal_meta_t *metadata  /* I: input metadata structure which has
-                                          been initialized via
-                                          init_metadata_struct */
+    Espa_internal_meta_t *metadata, /* I/O: metadata structure whose tile
+                                          global fields are populated */
+    char *meta_namespace,           /* O: namespace of the tile metadata
+                                          (STR_SIZE characters) */
+    int *nrows,                     /* O: num rows for each resolution */
+    int *ncols                      /* O: num columns for each resolution */
 )
 {
-    char FUNC_NAME[] = "parse_sentinel_tile_metadata";  /* function name */
+    char FUNC_NAME[] = "read_sentinel_tile_metadata";  /* function name */
     char errmsg[STR_SIZE];    /* error message */
     xmlTextReaderPtr reader;  /* reader for the XML file */
     xmlDocPtr doc = NULL;     /* document tree pointer */
     xmlNodePtr current=NULL;  /* pointer to the current node */
-    int i;                    /* looping variable */
     int status;               /* return status */
     int nodeType;             /* node type (element, text, attribute, etc.) */
     int top_of_stack;         /* top of the stack */
     int count;                /* number of chars copied in snprintf */
-    int nrows[NUM_SENTINEL_RES]; /* num rows for each sentinel resolution */
-    int ncols[NUM_SENTINEL_RES]; /* num columns for each sentinel resolution */
     char **stack = NULL;      /* stack to keep track of elements in the tree */
-    Espa_band_meta_t *bmeta;  /* band metadata pointer to all bands */
 
     /* Establish the reader for this metadata file */
     reader = xmlNewTextReaderFilename (metafile);
@@ -884,11 +918,11 @@ int parse_sentinel_tile_metadata
     {
         /* Store the namespace for the overall metadata file */
         xmlNsPtr ns = xmlDocGetRootElement(doc)->nsDef;
-        count = snprintf (metadata->meta_namespace,
-            sizeof (metadata->meta_namespace), "%s", (const char *) ns->href);
-        if (count < 0 || count >= sizeof (metadata->meta_namespace))
+        count = snprintf (meta_namespace, STR_SIZE, "%s",
+            (const char *) ns->href);
+        if (count < 0 || count >= STR_SIZE)
         {
-            sprintf (errmsg, "Overflow of metadata->meta_namespace string");
+            sprintf (errmsg, "Overflow of meta_namespace string");
             error_handler (true, FUNC_NAME, errmsg);
             return (ERROR);
         }
@@ -919,8 +953,31 @@ int parse_sentinel_tile_metadata
 
     /* Free the reader and associated memory */
     xmlFreeTextReader (reader);
-    xmlCleanupParser();
-    xmlMemoryDump();
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  add_sentinel_band_dims
+
+PURPOSE: Add the tile size and pixel size of each resolution to the band
+metadata of the Sentinel bands.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+static void add_sentinel_band_dims
+(
+    Espa_internal_meta_t *metadata, /* I/O: metadata whose bands are updated */
+    int *nrows,                     /* I: num rows for each resolution */
+    int *ncols                      /* I: num columns for each resolution */
+)
+{
+    int i;                    /* looping variable */
+    Espa_band_meta_t *bmeta;  /* band metadata pointer to all bands */
 
     /* The nrows/ncols need to be added to the band metadata for each of the
        bands */
@@ -967,7 +1024,45 @@ int parse_sentinel_tile_metadata
                 break;
         }
     }
+}
+
+
+/******************************************************************************
+MODULE:  parse_sentinel_tile_metadata
+
+PURPOSE: Parse the Sentinel L1C tile metadata file (MTD_TL.xml) and populate
+the associated ESPA internal metadata file.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error parsing the Sentinel metadata elements
+SUCCESS         Successful parse of the Sentinel metadata values
+
+NOTES:
+1. The band metadata must already be allocated, as the tile size of each
+   band is added to it.
+******************************************************************************/
+int parse_sentinel_tile_metadata
+(
+    char *metafile,                 /* I: input Sentinel tile metadata file */
+    Espa_internal_meta_t *metadata  /* I: input metadata structure which has
+                                          been initialized via
+                                          init_metadata_struct */
+)
+{
+    int nrows[NUM_SENTINEL_RES]; /* num rows for each sentinel resolution */
+    int ncols[NUM_SENTINEL_RES]; /* num columns for each sentinel resolution */
+
+    if (read_sentinel_tile_metadata (metafile, metadata,
+        metadata->meta_namespace, nrows, ncols) != SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+    cleanup_espa_xml ();
 
+    add_sentinel_band_dims (metadata, nrows, ncols);
     return (SUCCESS);
 }
 
@@ -988,10 +1083,15 @@ SUCCESS         Successful parse of the metadata values
 NOTES:
 1. Uses a stack of character strings to keep track of the nodes that have
    been parsed.  The stack must be allocated before calling this routine.
+2. The found_img_file and found_img_id flags are kept by the caller, and are
+   initialized to false for each product XML file, so product XML files may
+   be parsed concurrently.
 ******************************************************************************/
 int parse_sentinel_product_xml_into_struct
 (
     xmlNode *a_node,                  /* I: pointer to the current node */
+    char *granule_dir,                /* I: directory of the JP2 files; NULL
+                                            for the current directory */
     Espa_internal_meta_t *metadata,   /* I: ESPA internal metadata structure
                                             to be filled */
     int *top_of_stack,                /* I: pointer to top of the stack */
@@ -1000,7 +1100,11 @@ int parse_sentinel_product_xml_into_struct
     char *proc_ver,                   /* O: processing version for all bands */
     char *l1_filename,                /* O: initial level-1 filename to be
                                             used for all band names */
-    float *scale_factor               /* O: scale factor for all bands */
+    float *scale_factor,              /* O: scale factor for all bands */
+    bool *found_img_file,             /* I/O: has the initial IMAGE_FILE
+                                            element been found? */
+    bool *found_img_id                /* I/O: has the initial IMAGE_ID element
+                                            been found? */
 )
 {
     char FUNC_NAME[] = "parse_sentinel_product_xml_into_struct"; /* func name */
@@ -1010,6 +1114,7 @@ int parse_sentinel_product_xml_into_struct
                                     global position values */
     char *space = NULL;          /* pointer to blank space */
     xmlNode *cur_node = NULL;    /* pointer to the current node */
+    Espa_meta_element_t elem;     /* ID of the current element */
     xmlNode *child_node = NULL;  /* pointer to the child node */
     int count;                   /* number of chars copied in snprintf */
     double lat1, lon1;           /* initial global extents values */
@@ -1018,10 +1123,6 @@ int parse_sentinel_product_xml_into_struct
     double east, west;           /* eastern and western global extents */
     bool skip_child;             /* boolean to specify the children of this
                                     node should not be processed */
-    static bool found_img_file = false;  /* has the initial IMAGE_FILE element
-                                    been found in the product XML file? */
-    static bool found_img_id = false;   /* has the initial IMAGE_ID element
-                                    been found in the product XML file? */
     Espa_global_meta_t *gmeta = &metadata->global;
                                  /* global metadata structure */
 
@@ -1036,6 +1137,8 @@ int parse_sentinel_product_xml_into_struct
         /* Only print the ELEMENT node types */
         if (cur_node->type == XML_ELEMENT_NODE) 
         {
+            elem = lookup_meta_element (cur_node->name);
+
             /* Push the element to the stack and turn the boolean on if this
                is either Granule metadata */
             //printf ("***Pushed %s\n", cur_node->name); fflush (stdout);
@@ -1048,8 +1151,7 @@ int parse_sentinel_product_xml_into_struct
             }
 
             /* Process the product generation time */
-            if (xmlStrEqual (cur_node->name,
-                (const xmlChar *) "GENERATION_TIME"))
+            if (elem == ESPA_ELEM_GENERATION_TIME)
             {
                 /* Expect the child node to be a text node containing the
                    value of this field */
@@ -1078,8 +1180,7 @@ int parse_sentinel_product_xml_into_struct
             }
 
             /* Process the spacecraft name */
-            else if (xmlStrEqual (cur_node->name,
-                (const xmlChar *) "SPACECRAFT_NAME"))
+            else if (elem == ESPA_ELEM_SPACECRAFT_NAME)
             {
                 /* Expect the child node to be a text node containing the
                    value of this field */
@@ -1108,8 +1209,7 @@ int parse_sentinel_product_xml_into_struct
 
             /* Process the product type and save it for adding to the band
                metadata */
-            else if (xmlStrEqual (cur_node->name,
-                (const xmlChar *) "PRODUCT_TYPE"))
+            else if (elem == ESPA_ELEM_PRODUCT_TYPE)
             {
                 /* Expect the child node to be a text node containing the
                    value of this field */
@@ -1136,8 +1236,7 @@ int parse_sentinel_product_xml_into_struct
 
             /* Process the processing baseline version and save it for adding
                to the band metadata as part of the application version */
-            else if (xmlStrEqual (cur_node->name,
-                (const xmlChar *) "PROCESSING_BASELINE"))
+            else if (elem == ESPA_ELEM_PROCESSING_BASELINE)
             {
                 /* Expect the child node to be a text node containing the
                    value of this field */
@@ -1165,12 +1264,12 @@ int parse_sentinel_product_xml_into_struct
             /* Process the first IMAGE_FILE and save it for identifying the
                original Level-1 filenames in the band metadata. This is only
                available in the new S2 products. */
-            else if (!found_img_file &&
-                xmlStrEqual (cur_node->name, (const xmlChar *) "IMAGE_FILE"))
+            else if (!*found_img_file &&
+                elem == ESPA_ELEM_IMAGE_FILE)
             {
                 /* Expect the child node to be a text node containing the
                    value of this field */
-                found_img_file = true;
+                *found_img_file = true;
                 child_node = cur_node->children;
                 if (child_node == NULL || child_node->type != XML_TEXT_NODE)
                 {
@@ -1197,8 +1296,8 @@ int parse_sentinel_product_xml_into_struct
                This is only available in the old S2 products, and there are
                multiple tiles listed in the product. Thus the tile ID needs
                to be validated as the correct tile. */
-            else if (!found_img_id &&
-                xmlStrEqual (cur_node->name, (const xmlChar *) "IMAGE_ID"))
+            else if (!*found_img_id &&
+                elem == ESPA_ELEM_IMAGE_ID)
             {
                 /* Expect the child node to be a text node containing the
                    value of this field */
@@ -1223,15 +1322,14 @@ int parse_sentinel_product_xml_into_struct
                 }
 
                 /* Is this the correct image name for the current tile? Check
-                   to see if it exists in the current directory. */
-                if (find_file (l1_filename))
-                    found_img_id = true;
+                   to see if it exists in the granule directory. */
+                if (find_file (granule_dir, l1_filename))
+                    *found_img_id = true;
             }
 
             /* Process the quantification value and store it as the scale
                factor for each band */
-            else if (xmlStrEqual (cur_node->name,
-                (const xmlChar *) "QUANTIFICATION_VALUE"))
+            else if (elem == ESPA_ELEM_QUANTIFICATION_VALUE)
             {
                 /* Expect the child node to be a text node containing the
                    value of this field */
@@ -1251,8 +1349,7 @@ int parse_sentinel_product_xml_into_struct
 
             /* Process the global footprint and store it as the bounding
                coordinates */
-            else if (xmlStrEqual (cur_node->name,
-                (const xmlChar *) "EXT_POS_LIST"))
+            else if (elem == ESPA_ELEM_EXT_POS_LIST)
             {
                 /* Expect the child node to be a text node containing the
                    value of this field */
@@ -1345,8 +1442,9 @@ int parse_sentinel_product_xml_into_struct
         if (!skip_child)
         {
             if (parse_sentinel_product_xml_into_struct (cur_node->children,
-                metadata, top_of_stack, stack, prodtype, proc_ver, l1_filename,
-                scale_factor))
+                granule_dir, metadata, top_of_stack, stack, prodtype,
+                proc_ver, l1_filename, scale_factor, found_img_file,
+                found_img_id))
             {
                 sprintf (errmsg, "Parsing the children of this element '%s'.",
                     cur_node->name);
@@ -1359,6 +1457,8 @@ int parse_sentinel_product_xml_into_struct
            the stack */
         if (cur_node->type == XML_ELEMENT_NODE)
         {
+            elem = lookup_meta_element (cur_node->name);
+
             curr_stack_element = pop (top_of_stack, stack);
             if (curr_stack_element == NULL)
             {
@@ -1375,10 +1475,10 @@ int parse_sentinel_product_xml_into_struct
 
 
 /******************************************************************************
-MODULE:  parse_sentinel_product_metadata
+MODULE:  read_sentinel_product_metadata
 
-PURPOSE: Parse the Sentinel L1C product metadata file (MTD_MSIL1C.xml) and
-populate the associated ESPA internal metadata file.
+PURPOSE: Read the Sentinel L1C product metadata file (MTD_MSIL1C.xml) into the
+global metadata, returning the values shared by all the bands.
 
 RETURN VALUE:
 Type = int
@@ -1393,13 +1493,19 @@ NOTES:
 2. For debugging purposes
    xmlDocDump (stderr, doc);
    can be used to dump/print the XML doc to the screen.
+3. Only the product fields of the global metadata are written, and the XML
+   library is not cleaned up, so the tile metadata may be read at the same
+   time from another thread.
 ******************************************************************************/
-int parse_sentinel_product_metadata
+static int read_sentinel_product_metadata
 (
     char *metafile,                 /* I: Sentinel product metadata file */
-    Espa_internal_meta_t *metadata, /* I/O: input metadata structure which has
-                                          been initialized via
-                                          init_metadata_struct */
+    char *granule_dir,              /* I: directory of the JP2 files; NULL for
+                                          the current directory */
+    Espa_internal_meta_t *metadata, /* I/O: metadata structure whose product
+                                          global fields are populated */
+    char *meta_namespace,           /* O: namespace of the product metadata
+                                          (STR_SIZE characters) */
     char *prodtype,                 /* O: product type for all bands */
     char *proc_ver,                 /* O: processing version for all bands */
     char *l1_filename,              /* O: initial level-1 filename to be used
@@ -1407,7 +1513,7 @@ int parse_sentinel_product_metadata
     float *scale_factor             /* O: scale factor for all bands */
 )
 {
-    char FUNC_NAME[] = "parse_sentinel_product_metadata";  /* function name */
+    char FUNC_NAME[] = "read_sentinel_product_metadata";  /* function name */
     char errmsg[STR_SIZE];    /* error message */
     xmlTextReaderPtr reader;  /* reader for the XML file */
     xmlDocPtr doc = NULL;     /* document tree pointer */
@@ -1418,6 +1524,10 @@ int parse_sentinel_product_metadata
     int top_of_stack;         /* top of the stack */
     int count;                /* number of chars copied in snprintf */
     char **stack = NULL;      /* stack to keep track of elements in the tree */
+    bool found_img_file = false;  /* has the initial IMAGE_FILE element been
+                                     found in the product XML file? */
+    bool found_img_id = false;    /* has the initial IMAGE_ID element been
+                                     found in the product XML file? */
 
     /* Establish the reader for this metadata file */
     reader = xmlNewTextReaderFilename (metafile);
@@ -1585,11 +1695,11 @@ int parse_sentinel_product_metadata
     {
         /* Store the namespace for the overall metadata file */
         xmlNsPtr ns = xmlDocGetRootElement(doc)->nsDef;
-        count = snprintf (metadata->meta_namespace,
-            sizeof (metadata->meta_namespace), "%s", (const char *) ns->href);
-        if (count < 0 || count >= sizeof (metadata->meta_namespace))
+        count = snprintf (meta_namespace, STR_SIZE, "%s",
+            (const char *) ns->href);
+        if (count < 0 || count >= STR_SIZE)
         {
-            sprintf (errmsg, "Overflow of metadata->meta_namespace string");
+            sprintf (errmsg, "Overflow of meta_namespace string");
             error_handler (true, FUNC_NAME, errmsg);
             return (ERROR);
         }
@@ -1605,8 +1715,8 @@ int parse_sentinel_product_metadata
 
         /* Parse the XML document into our ESPA internal metadata structure */
         if (parse_sentinel_product_xml_into_struct (xmlDocGetRootElement(doc),
-            metadata, &top_of_stack, stack, prodtype, proc_ver, l1_filename,
-            scale_factor))
+            granule_dir, metadata, &top_of_stack, stack, prodtype, proc_ver,
+            l1_filename, scale_factor, &found_img_file, &found_img_id))
         {
             sprintf (errmsg, "Parsing the product metadata file into the "
                 "internal metadata structure.");
@@ -1621,9 +1731,205 @@ int parse_sentinel_product_metadata
 
     /* Free the reader and associated memory */
     xmlFreeTextReader (reader);
-    xmlCleanupParser();
-    xmlMemoryDump();
 
     return (SUCCESS);
 }
 
+
+/******************************************************************************
+MODULE:  parse_sentinel_product_metadata
+
+PURPOSE: Parse the Sentinel L1C product metadata file (MTD_MSIL1C.xml) and
+populate the associated ESPA internal metadata file.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error parsing the Sentinel metadata elements
+SUCCESS         Successful parse of the Sentinel metadata values
+
+NOTES:
+******************************************************************************/
+int parse_sentinel_product_metadata
+(
+    char *metafile,                 /* I: Sentinel product metadata file */
+    Espa_internal_meta_t *metadata, /* I/O: input metadata structure which has
+                                          been initialized via
+                                          init_metadata_struct */
+    char *prodtype,                 /* O: product type for all bands */
+    char *proc_ver,                 /* O: processing version for all bands */
+    char *l1_filename,              /* O: initial level-1 filename to be used
+                                          for all band names */
+    float *scale_factor             /* O: scale factor for all bands */
+)
+{
+    if (read_sentinel_product_metadata (metafile, NULL, metadata,
+        metadata->meta_namespace, prodtype, proc_ver, l1_filename,
+        scale_factor) != SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+    cleanup_espa_xml ();
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  read_sentinel_tile_thread
+
+PURPOSE: Thread routine which reads the tile metadata file of a Sentinel
+product while the product metadata file is read by the calling thread.
+
+RETURN VALUE:
+Type = void *
+Value           Description
+-----           -----------
+NULL            Always; the status is returned in the tile job
+
+NOTES:
+******************************************************************************/
+static void *read_sentinel_tile_thread
+(
+    void *arg                 /* I/O: Sentinel tile job */
+)
+{
+    Sentinel_tile_job_t *job = arg;   /* tile job to be run */
+
+    job->status = read_sentinel_tile_metadata (job->metafile, job->metadata,
+        job->meta_namespace, job->nrows, job->ncols);
+    return (NULL);
+}
+
+
+/******************************************************************************
+MODULE:  parse_sentinel_granule_metadata
+
+PURPOSE: Parse the Sentinel L1C product (MTD_MSIL1C.xml) and tile (MTD_TL.xml)
+metadata files of a granule together and populate the associated ESPA
+internal metadata.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error parsing the Sentinel metadata elements
+SUCCESS         Successful parse of the Sentinel metadata values
+
+NOTES:
+1. The tile metadata file is read on a second thread while the product
+   metadata file is read on this one.  The two files populate different
+   fields of the global metadata, and the XML library is cleaned up once
+   both are done.  If the thread can't be started, the files are read one
+   after the other.
+2. The band metadata must already be allocated, as the tile size of each
+   band is added to it.  On return the bands hold everything read from the
+   Sentinel metadata, so the band conversion may start right away.
+3. The namespace of the tile metadata is kept, as when the product and tile
+   metadata files are parsed separately in that order.
+4. The level-1 filename is the image ID whose JP2 file is in the granule
+   directory.  Nothing depends on the current directory, so the granules
+   may be parsed from several threads once init_espa_xml has been called.
+******************************************************************************/
+int parse_sentinel_granule_metadata
+(
+    char *granule_dir,              /* I: directory of the JP2 files; NULL for
+                                          the current directory */
+    char *product_file,             /* I: Sentinel product metadata file */
+    char *tile_file,                /* I: Sentinel tile metadata file */
+    Espa_internal_meta_t *metadata, /* I/O: input metadata structure which has
+                                          been initialized via
+                                          init_metadata_struct, with the
+                                          Sentinel bands allocated */
+    char *prodtype,                 /* O: product type for all bands */
+    char *proc_ver,                 /* O: processing version for all bands */
+    char *l1_filename,              /* O: initial level-1 filename to be used
+                                          for all band names */
+    float *scale_factor             /* O: scale factor for all bands */
+)
+{
+    char FUNC_NAME[] = "parse_sentinel_granule_metadata";  /* function
+                                                              name */
+    char errmsg[STR_SIZE];    /* error message */
+    char product_ns[STR_SIZE];  /* namespace of the product metadata */
+    int status;               /* return status of the product metadata */
+    bool threaded;            /* is the tile metadata read on a thread? */
+    pthread_t tile_thread;    /* thread reading the tile metadata */
+    Sentinel_tile_job_t job;  /* tile metadata to be read */
+
+    /* The parser needs to be initialized before it is used from two
+       threads */
+    xmlInitParser ();
+
+    job.metafile = tile_file;
+    job.metadata = metadata;
+    job.status = ERROR;
+    threaded = (pthread_create (&tile_thread, NULL, read_sentinel_tile_thread,
+        &job) == 0);
+
+    status = read_sentinel_product_metadata (product_file, granule_dir,
+        metadata, product_ns, prodtype, proc_ver, l1_filename, scale_factor);
+
+    if (threaded)
+        pthread_join (tile_thread, NULL);
+    else
+        read_sentinel_tile_thread (&job);
+    cleanup_espa_xml ();
+
+    if (status != SUCCESS)
+    {
+        sprintf (errmsg, "Reading Sentinel product XML file: %s",
+            product_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    if (job.status != SUCCESS)
+    {
+        sprintf (errmsg, "Reading Sentinel tile XML file: %s", tile_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    strcpy (metadata->meta_namespace, job.meta_namespace);
+    add_sentinel_band_dims (metadata, job.nrows, job.ncols);
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  parse_sentinel_metadata
+
+PURPOSE: Parse the Sentinel L1C product (MTD_MSIL1C.xml) and tile (MTD_TL.xml)
+metadata files together and populate the associated ESPA internal metadata.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error parsing the Sentinel metadata elements
+SUCCESS         Successful parse of the Sentinel metadata values
+
+NOTES:
+1. The JP2 files are looked for in the current directory (see
+   parse_sentinel_granule_metadata).
+******************************************************************************/
+int parse_sentinel_metadata
+(
+    char *product_file,             /* I: Sentinel product metadata file */
+    char *tile_file,                /* I: Sentinel tile metadata file */
+    Espa_internal_meta_t *metadata, /* I/O: input metadata structure which has
+                                          been initialized via
+                                          init_metadata_struct, with the
+                                          Sentinel bands allocated */
+    char *prodtype,                 /* O: product type for all bands */
+    char *proc_ver,                 /* O: processing version for all bands */
+    char *l1_filename,              /* O: initial level-1 filename to be used
+                                          for all band names */
+    float *scale_factor             /* O: scale factor for all bands */
+)
+{
+    return (parse_sentinel_granule_metadata (NULL, product_file, tile_file,
+        metadata, prodtype, proc_ver, l1_filename, scale_factor));
+}
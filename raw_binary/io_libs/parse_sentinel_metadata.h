@@ -49,4 +49,36 @@ int parse_sentinel_product_metadata
     float *scale_factor             /* O: scale factor for all bands */
 );
 
+int parse_sentinel_granule_metadata
+(
+    char *granule_dir,              /* I: directory of the JP2 files; NULL for
+                                          the current directory */
+    char *product_file,             /* I: Sentinel product metadata file */
+    char *tile_file,                /* I: Sentinel tile metadata file */
+    Espa_internal_meta_t *metadata, /* I/O: input metadata structure which has
+                                          been initialized via
+                                          init_metadata_struct, with the
+                                          Sentinel bands allocated */
+    char *prodtype,                 /* O: product type for all bands */
+    char *proc_ver,                 /* O: processing version for all bands */
+    char *l1_filename,              /* O: initial level-1 filename to be used
+                                          for all band names */
+    float *scale_factor             /* O: scale factor for all bands */
+);
+
+int parse_sentinel_metadata
+(
+    char *product_file,             /* I: Sentinel product metadata file */
+    char *tile_file,                /* I: Sentinel tile metadata file */
+    Espa_internal_meta_t *metadata, /* I/O: input metadata structure which has
+                                          been initialized via
+                                          init_metadata_struct, with the
+                                          Sentinel bands allocated */
+    char *prodtype,                 /* O: product type for all bands */
+    char *proc_ver,                 /* O: processing version for all bands */
+    char *l1_filename,              /* O: initial level-1 filename to be used
+                                          for all band names */
+    float *scale_factor             /* O: scale factor for all bands */
+);
+
 #endif
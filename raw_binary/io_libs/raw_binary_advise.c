@@ -0,0 +1,271 @@
+/*****************************************************************************
+FILE: raw_binary_advise.c
+
+PURPOSE: Contains functions for the page cache policy of the raw binary and
+Tiff I/O.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The policy is read from the environment once, the first time it is
+     needed.  set_raw_binary_cache_policy overrides it.
+*****************************************************************************/
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE     /* for sync_file_range */
+#endif
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include "raw_binary_advise.h"
+#include "raw_binary_blocks.h"
+
+static pthread_once_t rb_policy_once = PTHREAD_ONCE_INIT;
+static int rb_policy = RB_POLICY_AUTO;  /* page cache policy */
+
+/******************************************************************************
+MODULE: rb_policy_init
+
+PURPOSE: Takes the page cache policy from RB_CACHE_POLICY_ENV.  Called once.
+
+RETURN VALUE:
+Type = N/A
+
+NOTES:
+  1. An unknown policy is ignored with a warning.
+*****************************************************************************/
+static void rb_policy_init (void)
+{
+    char FUNC_NAME[] = "rb_policy_init";  /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    char *value = getenv (RB_CACHE_POLICY_ENV);  /* value of the variable */
+    int policy;              /* policy named by the variable */
+
+    if (value == NULL || *value == '\0')
+        return;
+
+    if (!strcmp (value, "auto"))
+        policy = RB_POLICY_AUTO;
+    else if (!strcmp (value, "keep"))
+        policy = RB_POLICY_KEEP;
+    else if (!strcmp (value, "drop"))
+        policy = RB_POLICY_DROP;
+    else if (!strcmp (value, "off"))
+        policy = RB_POLICY_OFF;
+    else
+    {
+        snprintf (errmsg, sizeof (errmsg), "Unknown %s: %s; the auto policy "
+            "is used", RB_CACHE_POLICY_ENV, value);
+        error_handler (false, FUNC_NAME, errmsg);
+        return;
+    }
+    __atomic_store_n (&rb_policy, policy, __ATOMIC_RELAXED);
+}
+
+
+/******************************************************************************
+MODULE: set_raw_binary_cache_policy
+
+PURPOSE: Sets the page cache policy, overriding RB_CACHE_POLICY_ENV.
+
+RETURN VALUE:
+Type = N/A
+
+NOTES:
+*****************************************************************************/
+void set_raw_binary_cache_policy
+(
+    Raw_binary_cache_policy_t policy  /* I: page cache policy */
+)
+{
+    pthread_once (&rb_policy_once, rb_policy_init);
+    __atomic_store_n (&rb_policy, (int) policy, __ATOMIC_RELAXED);
+}
+
+
+/******************************************************************************
+MODULE: get_raw_binary_cache_policy
+
+PURPOSE: Returns the page cache policy.
+
+RETURN VALUE:
+Type = Raw_binary_cache_policy_t
+Value            Description
+-----            -----------
+RB_POLICY_*      Current page cache policy
+
+NOTES:
+*****************************************************************************/
+Raw_binary_cache_policy_t get_raw_binary_cache_policy (void)
+{
+    pthread_once (&rb_policy_once, rb_policy_init);
+    return (Raw_binary_cache_policy_t) __atomic_load_n (&rb_policy,
+        __ATOMIC_RELAXED);
+}
+
+
+/******************************************************************************
+MODULE: advise_raw_binary_fd
+
+PURPOSE: Tells the kernel how a range of a file will be accessed, as allowed
+by the page cache policy.
+
+RETURN VALUE:
+Type = N/A
+
+NOTES:
+  1. Nothing is done with the off policy, and the ranges which are no longer
+     needed aren't dropped with the keep policy.
+*****************************************************************************/
+void advise_raw_binary_fd
+(
+    int fd,              /* I: file descriptor of the file */
+    off_t offset,        /* I: first byte of the range */
+    off_t len,           /* I: number of bytes in the range; 0 for the rest
+                               of the file */
+    Raw_binary_advice_t advice  /* I: access pattern of the range */
+)
+{
+    Raw_binary_cache_policy_t policy;  /* page cache policy */
+    int flag;                /* posix_fadvise flag of the advice */
+
+    policy = get_raw_binary_cache_policy ();
+    if (fd < 0 || policy == RB_POLICY_OFF ||
+        (policy == RB_POLICY_KEEP && advice == RB_ADVISE_DONTNEED))
+        return;
+
+    switch (advice)
+    {
+        case RB_ADVISE_SEQUENTIAL:
+            flag = POSIX_FADV_SEQUENTIAL;
+            break;
+        case RB_ADVISE_RANDOM:
+            flag = POSIX_FADV_RANDOM;
+            break;
+        case RB_ADVISE_WILLNEED:
+            flag = POSIX_FADV_WILLNEED;
+            break;
+        case RB_ADVISE_DONTNEED:
+            flag = POSIX_FADV_DONTNEED;
+            break;
+        case RB_ADVISE_NORMAL:
+        default:
+            flag = POSIX_FADV_NORMAL;
+            break;
+    }
+    posix_fadvise (fd, offset, len, flag);
+}
+
+
+/******************************************************************************
+MODULE: advise_raw_binary_lines
+
+PURPOSE: Tells the kernel how a range of lines of a band will be accessed,
+as allowed by the page cache policy.
+
+RETURN VALUE:
+Type = N/A
+
+NOTES:
+  1. The lines are offset by the position of the band in its file (see
+     open_raw_binary_band_fd).
+  2. Block-compressed bands (see raw_binary_blocks.h) aren't stored by line,
+     so they get no advice.
+*****************************************************************************/
+void advise_raw_binary_lines
+(
+    int fd,              /* I: file descriptor of the band (see
+                               open_raw_binary_band_fd) */
+    int line0,           /* I: 0-based first line of the range */
+    int nlines,          /* I: number of lines in the range; 0 for the rest
+                               of the band */
+    int nsamps,          /* I: number of samples in a line of the band */
+    int size,            /* I: number of bytes per pixel */
+    Raw_binary_advice_t advice  /* I: access pattern of the lines */
+)
+{
+    off_t line_bytes = (off_t) nsamps * size;  /* bytes per line */
+
+    if (fd < 0 || get_raw_binary_blocks (fd) != NULL)
+        return;
+
+    advise_raw_binary_fd (fd, get_raw_binary_band_offset (fd) +
+        line0 * line_bytes, nlines * line_bytes, advice);
+}
+
+
+/******************************************************************************
+MODULE: release_raw_binary_fd
+
+PURPOSE: Drops a file which won't be read again from the page cache, as
+allowed by the page cache policy.
+
+RETURN VALUE:
+Type = N/A
+
+NOTES:
+  1. Dirty pages can't be dropped.  For a file which was just written, the
+     auto policy starts writing it back and drops the pages already
+     written, without waiting; the drop policy syncs it first, so all of
+     its pages are dropped.
+*****************************************************************************/
+void release_raw_binary_fd
+(
+    int fd,              /* I: file descriptor of the file */
+    bool written         /* I: was the file just written? */
+)
+{
+    Raw_binary_cache_policy_t policy;  /* page cache policy */
+
+    policy = get_raw_binary_cache_policy ();
+    if (fd < 0 || policy == RB_POLICY_OFF || policy == RB_POLICY_KEEP)
+        return;
+
+    if (written)
+    {
+        if (policy == RB_POLICY_DROP)
+            fdatasync (fd);
+#ifdef SYNC_FILE_RANGE_WRITE
+        else
+            sync_file_range (fd, 0, 0, SYNC_FILE_RANGE_WRITE);
+#endif
+    }
+    advise_raw_binary_fd (fd, 0, 0, RB_ADVISE_DONTNEED);
+}
+
+
+/******************************************************************************
+MODULE: release_raw_binary_file
+
+PURPOSE: Drops a file which won't be read again from the page cache, as
+allowed by the page cache policy, when it isn't open (ex. a product closed
+by the HDF or NetCDF library).
+
+RETURN VALUE:
+Type = N/A
+
+NOTES:
+  1. A file which can't be opened is skipped.
+*****************************************************************************/
+void release_raw_binary_file
+(
+    const char *file,    /* I: name of the file */
+    bool written         /* I: was the file just written? */
+)
+{
+    Raw_binary_cache_policy_t policy;  /* page cache policy */
+    int fd;                  /* file descriptor of the file */
+
+    policy = get_raw_binary_cache_policy ();
+    if (file == NULL || policy == RB_POLICY_OFF || policy == RB_POLICY_KEEP)
+        return;
+
+    fd = open (file, O_RDONLY);
+    if (fd == -1)
+        return;
+    release_raw_binary_fd (fd, written);
+    close (fd);
+}
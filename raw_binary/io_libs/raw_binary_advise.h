@@ -0,0 +1,104 @@
+/*****************************************************************************
+FILE: raw_binary_advise.h
+
+PURPOSE: Contains defines and prototypes for the page cache policy of the
+raw binary and Tiff I/O, which tells the kernel how the files are accessed
+(posix_fadvise), so the sequential scans of the bands are read ahead and the
+files which won't be read again don't evict the data other jobs on the node
+are using.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The hints are applied from the access pattern:
+       - Files read through a FILE pointer (open_raw_binary), the bands read
+         by the read-ahead reader, and the Tiff files opened for reading are
+         read sequentially.  The read-ahead reader also asks for the block
+         after the ones it is reading (WILLNEED).
+       - The bands of a band stack which are deleted once they are consumed
+         (del_src in the converters; see drop_band_stack_pages) are dropped
+         from the page cache block by block as they are consumed.
+       - One-shot outputs (the Tiff, HDF, and NetCDF products, and the bands
+         written with direct I/O) are dropped once they are closed.
+  2. The policy is taken from RB_CACHE_POLICY_ENV, or set with
+     set_raw_binary_cache_policy:
+       auto  the hints above (default)
+       keep  read ahead, but never drop anything, ex. when the next job on
+             the node reads the outputs
+       drop  as auto, but the one-shot outputs are synced first, so they are
+             certain to be dropped rather than only the pages already
+             written back
+       off   no hints at all
+  3. The hints are only advice: they never change what is read or written,
+     and their errors are ignored.
+*****************************************************************************/
+
+#ifndef RAW_BINARY_ADVISE_H
+#define RAW_BINARY_ADVISE_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <sys/types.h>
+#include "error_handler.h"
+#include "raw_binary_io.h"
+
+/* Defines */
+#define RB_CACHE_POLICY_ENV "ESPA_PAGE_CACHE_POLICY"  /* auto, keep, drop, or
+                                     off; unset for auto */
+
+/* Page cache policy */
+typedef enum {
+  RB_POLICY_AUTO,       /* hints from the access pattern */
+  RB_POLICY_KEEP,       /* read ahead, but never drop pages */
+  RB_POLICY_DROP,       /* as auto, syncing the one-shot outputs so their
+                           pages can be dropped */
+  RB_POLICY_OFF         /* no hints */
+} Raw_binary_cache_policy_t;
+
+/* Prototypes */
+void set_raw_binary_cache_policy
+(
+    Raw_binary_cache_policy_t policy  /* I: page cache policy */
+);
+
+Raw_binary_cache_policy_t get_raw_binary_cache_policy (void);
+
+void advise_raw_binary_fd
+(
+    int fd,              /* I: file descriptor of the file */
+    off_t offset,        /* I: first byte of the range */
+    off_t len,           /* I: number of bytes in the range; 0 for the rest
+                               of the file */
+    Raw_binary_advice_t advice  /* I: access pattern of the range */
+);
+
+void advise_raw_binary_lines
+(
+    int fd,              /* I: file descriptor of the band (see
+                               open_raw_binary_band_fd) */
+    int line0,           /* I: 0-based first line of the range */
+    int nlines,          /* I: number of lines in the range; 0 for the rest
+                               of the band */
+    int nsamps,          /* I: number of samples in a line of the band */
+    int size,            /* I: number of bytes per pixel */
+    Raw_binary_advice_t advice  /* I: access pattern of the lines */
+);
+
+void release_raw_binary_fd
+(
+    int fd,              /* I: file descriptor of the file */
+    bool written         /* I: was the file just written? */
+);
+
+void release_raw_binary_file
+(
+    const char *file,    /* I: name of the file */
+    bool written         /* I: was the file just written? */
+);
+
+#endif
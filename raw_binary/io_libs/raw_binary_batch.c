@@ -0,0 +1,482 @@
+/*****************************************************************************
+FILE: raw_binary_batch.c
+
+PURPOSE: Contains functions for the batched raw binary I/O engine.  The
+windows for a set of bands are queued as contiguous requests and submitted
+together through io_uring, or transferred one at a time using positional
+reads/writes when io_uring is not available.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. An engine must only be used by one thread at a time.  Threads which
+     need batched I/O (i.e. the read-ahead reader) each own their engine.
+  2. Windows of block-compressed bands (see raw_binary_blocks.h) are read
+     and decompressed directly rather than queued.  So are the windows of
+     bands with fill regions (see raw_binary_sparse.h), which skip reading
+     the fill, and of bands in the band cache (see raw_binary_cache.h), which
+     are read from memory and written through it.
+*****************************************************************************/
+
+#include <errno.h>
+#include "raw_binary_batch.h"
+#include "raw_binary_blocks.h"
+#include "raw_binary_sparse.h"
+#include "raw_binary_cache.h"
+
+/* Largest single request, which keeps the byte count within the 32-bit
+   length of an io_uring submission */
+#define RB_BATCH_MAX_REQUEST_BYTES (1 << 30)
+
+/******************************************************************************
+MODULE: init_raw_binary_batch
+
+PURPOSE: Initializes the batched I/O engine, setting up io_uring if it was
+compiled in and is supported by the running kernel.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error allocating the engine
+SUCCESS      Successful initialization
+
+NOTES:
+  1. Failing to set up io_uring is not an error; the engine falls back to
+     positional reads/writes.
+*****************************************************************************/
+int init_raw_binary_batch
+(
+    int depth,                  /* I: number of requests in flight; use
+                                      RB_BATCH_DEFAULT_DEPTH if not known */
+    Raw_binary_batch_t *batch   /* O: batched I/O engine */
+)
+{
+    char FUNC_NAME[] = "init_raw_binary_batch"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+
+    if (depth <= 0)
+        depth = RB_BATCH_DEFAULT_DEPTH;
+
+    batch->depth = depth;
+    batch->use_uring = false;
+    batch->req = calloc (depth, sizeof (Rb_batch_request_t));
+    if (batch->req == NULL)
+    {
+        sprintf (errmsg, "Allocating %d batched I/O requests", depth);
+        error_handler (true, FUNC_NAME, errmsg);
+        return ERROR;
+    }
+
+#ifdef HAVE_LIBURING
+    if (io_uring_queue_init (depth, &batch->ring, 0) == 0)
+        batch->use_uring = true;
+#endif
+
+    return SUCCESS;
+}
+
+
+/******************************************************************************
+MODULE: rb_batch_transfer
+
+PURPOSE: Transfers all of the queued requests and waits for them to complete.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        One or more of the requests failed
+SUCCESS      All of the requests completed
+
+NOTES:
+  1. Short io_uring transfers are completed with positional I/O.  Requests
+     the kernel rejects as unsupported (older kernels without the read and
+     write opcodes) are redone entirely with positional I/O.
+  2. All of the completions are reaped, even after a failure, so the ring is
+     left empty for the next batch.
+*****************************************************************************/
+static int rb_batch_transfer
+(
+    Raw_binary_batch_t *batch,  /* I: batched I/O engine */
+    bool write_flag,            /* I: write (true) or read (false) */
+    int nreq                    /* I: number of queued requests */
+)
+{
+    int i;                      /* looping variable for the requests */
+    int status = SUCCESS;       /* status of the transfers */
+    Rb_batch_request_t *req;    /* current request */
+#ifdef HAVE_LIBURING
+    struct io_uring_sqe *sqe;   /* submission queue entry */
+    struct io_uring_cqe *cqe;   /* completion queue entry */
+    int nsubmit;                /* number of requests submitted */
+    int res;                    /* result of the current request */
+#endif
+
+    if (nreq == 0)
+        return SUCCESS;
+
+#ifdef HAVE_LIBURING
+    if (batch->use_uring)
+    {
+        for (i = 0; i < nreq; i++)
+        {
+            req = &batch->req[i];
+            sqe = io_uring_get_sqe (&batch->ring);
+            if (write_flag)
+                io_uring_prep_write (sqe, req->fd, req->buf, req->nbytes,
+                    req->offset);
+            else
+                io_uring_prep_read (sqe, req->fd, req->buf, req->nbytes,
+                    req->offset);
+            io_uring_sqe_set_data (sqe, req);
+        }
+
+        nsubmit = io_uring_submit (&batch->ring);
+        if (nsubmit < 0)
+            nsubmit = 0;
+
+        /* Reap the completions */
+        for (i = 0; i < nsubmit; i++)
+        {
+            while ((res = io_uring_wait_cqe (&batch->ring, &cqe)) == -EINTR)
+                ;
+            if (res < 0)
+            {
+                status = ERROR;
+                break;
+            }
+            req = io_uring_cqe_get_data (cqe);
+            res = cqe->res;
+            io_uring_cqe_seen (&batch->ring, cqe);
+
+            if (res >= 0)
+            {
+                /* Finish any short transfer */
+                req->buf += res;
+                req->offset += res;
+                req->nbytes -= res;
+            }
+            else if (res != -EINTR && res != -EAGAIN && res != -EINVAL &&
+                res != -EOPNOTSUPP)
+            {
+                status = ERROR;
+                continue;
+            }
+
+            if (req->nbytes > 0 && pio_raw_binary (req->fd, write_flag,
+                req->buf, req->nbytes, req->offset) != SUCCESS)
+                status = ERROR;
+        }
+
+        /* Requests the ring would not take are done with positional I/O */
+        for (i = nsubmit; i < nreq && status == SUCCESS; i++)
+        {
+            req = &batch->req[i];
+            if (pio_raw_binary (req->fd, write_flag, req->buf, req->nbytes,
+                req->offset) != SUCCESS)
+                status = ERROR;
+        }
+
+        return status;
+    }
+#endif
+
+    for (i = 0; i < nreq; i++)
+    {
+        req = &batch->req[i];
+        if (pio_raw_binary (req->fd, write_flag, req->buf, req->nbytes,
+            req->offset) != SUCCESS)
+            return ERROR;
+    }
+
+    return status;
+}
+
+
+/******************************************************************************
+MODULE: rb_batch_flush
+
+PURPOSE: Transfers all of the queued requests and tallies them in the I/O
+accounting.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        One or more of the requests failed
+SUCCESS      All of the requests completed
+
+NOTES:
+  1. The requests are in flight together, so the wall time of the batch is
+     charged to the first request and the rest only add their bytes.
+*****************************************************************************/
+static int rb_batch_flush
+(
+    Raw_binary_batch_t *batch,  /* I: batched I/O engine */
+    bool write_flag,            /* I: write (true) or read (false) */
+    int nreq                    /* I: number of queued requests */
+)
+{
+    int i;                      /* looping variable for the requests */
+    double start_time;          /* start of the batch for the I/O
+                                   accounting */
+    double end_time;            /* end of the batch for the I/O accounting */
+
+    start_time = espa_io_stats_clock ();
+    if (rb_batch_transfer (batch, write_flag, nreq) != SUCCESS)
+        return ERROR;
+
+    end_time = espa_io_stats_clock ();
+    for (i = 0; i < nreq; i++)
+    {
+        espa_io_stats_record_fd (batch->req[i].fd, write_flag ?
+            ESPA_IO_WRITE : ESPA_IO_READ, batch->req[i].queued,
+            i == 0 ? start_time : end_time);
+    }
+
+    return SUCCESS;
+}
+
+
+/******************************************************************************
+MODULE: rb_batch_io
+
+PURPOSE: Breaks each window into contiguous requests, queues them, and
+flushes the queue each time it fills up.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        An invalid window or an error transferring the windows
+SUCCESS      All of the windows were transferred
+
+NOTES:
+*****************************************************************************/
+static int rb_batch_io
+(
+    char *module,                 /* I: calling module for error messages */
+    Raw_binary_batch_t *batch,    /* I: batched I/O engine */
+    bool write_flag,              /* I: write (true) or read (false) */
+    int nwindows,                 /* I: number of windows to transfer */
+    Raw_binary_window_t *windows  /* I/O: windows to transfer */
+)
+{
+    char errmsg[STR_SIZE];   /* error message */
+    int w;                   /* looping variable for the windows */
+    int line;                /* looping variable for the lines */
+    int nreq = 0;            /* number of queued requests */
+    int nseg;                /* number of contiguous segments in a window */
+    size_t seg_bytes;        /* number of bytes in each segment */
+    size_t nbytes;           /* bytes left to queue for the segment */
+    size_t chunk;            /* bytes queued in the current request */
+    size_t band_line_bytes;  /* number of bytes in a full line of the band */
+    off_t offset;            /* file offset of the current segment */
+    char *ptr;               /* current position in the window buffer */
+    Raw_binary_window_t *win; /* current window */
+    Rb_batch_request_t *req; /* request being queued */
+    Raw_binary_blocks_t *blocks; /* reader of a block-compressed band */
+
+    for (w = 0; w < nwindows; w++)
+    {
+        win = &windows[w];
+        if (win->line0 < 0 || win->nlines < 0 || win->samp0 < 0 ||
+            win->nsamps < 0 || win->samp0 + win->nsamps > win->band_nsamps)
+        {
+            sprintf (errmsg, "Invalid window %d: lines %d+%d, samples %d+%d "
+                "for a band with %d samples.", w, win->line0, win->nlines,
+                win->samp0, win->nsamps, win->band_nsamps);
+            error_handler (true, module, errmsg);
+            return ERROR;
+        }
+
+        /* Block-compressed bands aren't read as byte ranges of the file */
+        blocks = write_flag ? NULL : get_raw_binary_blocks (win->fd);
+        if (blocks != NULL)
+        {
+            if (read_raw_binary_blocks (blocks, win->band_nsamps, win->line0,
+                win->nlines, win->samp0, win->nsamps, win->size,
+                win->img_array) != SUCCESS)
+            {
+                sprintf (errmsg, "Reading compressed window %d", w);
+                error_handler (true, module, errmsg);
+                return ERROR;
+            }
+            continue;
+        }
+
+        /* Bands with fill regions only read the parts which aren't fill */
+        if (!write_flag && get_raw_binary_sparse (win->fd) != NULL)
+        {
+            if (read_raw_binary_window (win->fd, win->band_nsamps,
+                win->line0, win->nlines, win->samp0, win->nsamps, win->size,
+                win->img_array) != SUCCESS)
+            {
+                sprintf (errmsg, "Reading window %d", w);
+                error_handler (true, module, errmsg);
+                return ERROR;
+            }
+            continue;
+        }
+
+        /* Cached bands are read from, and written through, the cache */
+        if (is_raw_binary_cached (win->fd))
+        {
+            if ((write_flag ? write_raw_binary_window (win->fd,
+                win->band_nsamps, win->line0, win->nlines, win->samp0,
+                win->nsamps, win->size, win->img_array) :
+                read_raw_binary_window (win->fd, win->band_nsamps,
+                win->line0, win->nlines, win->samp0, win->nsamps, win->size,
+                win->img_array)) != SUCCESS)
+            {
+                sprintf (errmsg, "%s window %d", write_flag ? "Writing" :
+                    "Reading", w);
+                error_handler (true, module, errmsg);
+                return ERROR;
+            }
+            continue;
+        }
+
+        /* Full-width windows are a single contiguous segment */
+        band_line_bytes = (size_t) win->band_nsamps * win->size;
+        offset = get_raw_binary_band_offset (win->fd) +
+            (off_t) win->line0 * band_line_bytes +
+            (off_t) win->samp0 * win->size;
+        if (win->nsamps == win->band_nsamps)
+        {
+            nseg = 1;
+            seg_bytes = band_line_bytes * win->nlines;
+        }
+        else
+        {
+            nseg = win->nlines;
+            seg_bytes = (size_t) win->nsamps * win->size;
+        }
+
+        ptr = win->img_array;
+        for (line = 0; line < nseg; line++)
+        {
+            for (nbytes = seg_bytes; nbytes > 0; nbytes -= chunk)
+            {
+                chunk = nbytes;
+                if (chunk > RB_BATCH_MAX_REQUEST_BYTES)
+                    chunk = RB_BATCH_MAX_REQUEST_BYTES;
+
+                req = &batch->req[nreq++];
+                req->fd = win->fd;
+                req->buf = ptr + (seg_bytes - nbytes);
+                req->nbytes = chunk;
+                req->queued = chunk;
+                req->offset = offset + (off_t) (seg_bytes - nbytes);
+
+                if (nreq == batch->depth)
+                {
+                    if (rb_batch_flush (batch, write_flag, nreq) != SUCCESS)
+                    {
+                        sprintf (errmsg, "%s batch of raw binary windows "
+                            "(through window %d)", write_flag ? "Writing" :
+                            "Reading", w);
+                        error_handler (true, module, errmsg);
+                        return ERROR;
+                    }
+                    nreq = 0;
+                }
+            }
+            ptr += seg_bytes;
+            offset += band_line_bytes;
+        }
+    }
+
+    if (rb_batch_flush (batch, write_flag, nreq) != SUCCESS)
+    {
+        sprintf (errmsg, "%s batch of %d raw binary windows",
+            write_flag ? "Writing" : "Reading", nwindows);
+        error_handler (true, module, errmsg);
+        return ERROR;
+    }
+
+    return SUCCESS;
+}
+
+
+/******************************************************************************
+MODULE: read_raw_binary_batch
+
+PURPOSE: Reads a set of windows, typically the same block of lines from each
+band, as one batch.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error reading the windows
+SUCCESS      Successful read
+
+NOTES:
+*****************************************************************************/
+int read_raw_binary_batch
+(
+    Raw_binary_batch_t *batch,    /* I: batched I/O engine */
+    int nwindows,                 /* I: number of windows to be read */
+    Raw_binary_window_t *windows  /* I/O: windows to be read */
+)
+{
+    return rb_batch_io ("read_raw_binary_batch", batch, false, nwindows,
+        windows);
+}
+
+
+/******************************************************************************
+MODULE: write_raw_binary_batch
+
+PURPOSE: Writes a set of windows, typically the same block of lines to each
+band, as one batch.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error writing the windows
+SUCCESS      Successful write
+
+NOTES:
+*****************************************************************************/
+int write_raw_binary_batch
+(
+    Raw_binary_batch_t *batch,    /* I: batched I/O engine */
+    int nwindows,                 /* I: number of windows to be written */
+    Raw_binary_window_t *windows  /* I: windows to be written */
+)
+{
+    return rb_batch_io ("write_raw_binary_batch", batch, true, nwindows,
+        windows);
+}
+
+
+/******************************************************************************
+MODULE: close_raw_binary_batch
+
+PURPOSE: Tears down the batched I/O engine.
+
+RETURN VALUE:
+Type = N/A
+
+NOTES:
+*****************************************************************************/
+void close_raw_binary_batch
+(
+    Raw_binary_batch_t *batch   /* I: batched I/O engine to be closed */
+)
+{
+#ifdef HAVE_LIBURING
+    if (batch->use_uring)
+        io_uring_queue_exit (&batch->ring);
+#endif
+    batch->use_uring = false;
+    free (batch->req);
+    batch->req = NULL;
+}
@@ -0,0 +1,99 @@
+/*****************************************************************************
+FILE: raw_binary_batch.h
+
+PURPOSE: Contains defines and structures for the batched raw binary I/O
+engine, which submits the windows for a set of bands (i.e. a block of lines
+for every band) as a single batch.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. io_uring is only used if the library was built with ENABLE_IO_URING=yes
+     (which defines HAVE_LIBURING) and the running kernel supports it.
+     Otherwise each window is transferred using positional reads/writes.
+*****************************************************************************/
+
+#ifndef RAW_BINARY_BATCH_H
+#define RAW_BINARY_BATCH_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/types.h>
+#include "error_handler.h"
+#include "raw_binary_io.h"
+
+#ifdef HAVE_LIBURING
+#include <liburing.h>
+#endif
+
+/* Defines */
+#define RB_BATCH_DEFAULT_DEPTH 32   /* default number of requests in flight */
+
+/* Single window of a band to be transferred as part of a batch */
+typedef struct
+{
+    int fd;              /* file descriptor of the raw binary band */
+    int band_nsamps;     /* number of samples in a full line of the band */
+    int line0;           /* 0-based first line of the window */
+    int nlines;          /* number of lines in the window */
+    int samp0;           /* 0-based first sample of the window */
+    int nsamps;          /* number of samples in the window */
+    int size;            /* number of bytes per pixel */
+    void *img_array;     /* nlines * nsamps * size buffer for the window */
+} Raw_binary_window_t;
+
+/* Contiguous transfer queued by the engine; a full-width window is a single
+   request and a partial-width window is one request per line */
+typedef struct
+{
+    int fd;              /* file descriptor of the raw binary band */
+    char *buf;           /* buffer for the transfer */
+    size_t nbytes;       /* number of bytes to transfer */
+    off_t offset;        /* file offset for the transfer */
+    size_t queued;       /* number of bytes queued, for the I/O accounting;
+                            nbytes shrinks as short transfers complete */
+} Rb_batch_request_t;
+
+/* Batched I/O engine */
+typedef struct
+{
+    int depth;           /* maximum number of requests in flight */
+    bool use_uring;      /* is io_uring being used, or positional I/O? */
+    Rb_batch_request_t *req; /* requests currently in flight */
+#ifdef HAVE_LIBURING
+    struct io_uring ring; /* submission and completion queues */
+#endif
+} Raw_binary_batch_t;
+
+/* Prototypes */
+int init_raw_binary_batch
+(
+    int depth,                  /* I: number of requests in flight; use
+                                      RB_BATCH_DEFAULT_DEPTH if not known */
+    Raw_binary_batch_t *batch   /* O: batched I/O engine */
+);
+
+int read_raw_binary_batch
+(
+    Raw_binary_batch_t *batch,    /* I: batched I/O engine */
+    int nwindows,                 /* I: number of windows to be read */
+    Raw_binary_window_t *windows  /* I/O: windows to be read */
+);
+
+int write_raw_binary_batch
+(
+    Raw_binary_batch_t *batch,    /* I: batched I/O engine */
+    int nwindows,                 /* I: number of windows to be written */
+    Raw_binary_window_t *windows  /* I: windows to be written */
+);
+
+void close_raw_binary_batch
+(
+    Raw_binary_batch_t *batch   /* I: batched I/O engine to be closed */
+);
+
+#endif
@@ -0,0 +1,1508 @@
+/*****************************************************************************
+FILE: raw_binary_blocks.c
+
+PURPOSE: Contains functions for reading and writing block-compressed raw
+binary bands, which hold fixed-size blocks of lines compressed independently
+along with an index of the blocks, and tiled raw binary bands.  The blocks of
+8-bit bands may be bit-packed or run-length encoded instead of compressed.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The readers are attached to the file descriptors opened by
+     open_raw_binary_fd and looked up by the window and batch reads, so the
+     callers of those routines don't need to know how a band is encoded.
+  2. Each reader caches the last block it decompressed, since consecutive
+     windows (i.e. tiles across a block of lines) usually fall in the same
+     block.
+  3. Tiles aren't compressed, so the windows of a tiled band are read
+     straight from the file without the cache or its lock.
+*****************************************************************************/
+
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <zlib.h>
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+#include "raw_binary_io.h"
+#include "raw_binary_blocks.h"
+#include "espa_staging.h"
+#include "espa_trace.h"
+
+/* Readers attached to the open file descriptors, indexed by the file
+   descriptor */
+static pthread_mutex_t rb_blocks_mutex = PTHREAD_MUTEX_INITIALIZER;
+static Raw_binary_blocks_t **rb_blocks_by_fd = NULL;
+static int rb_blocks_nfds = 0;
+
+
+/******************************************************************************
+MODULE: raw_binary_encoding_name
+
+PURPOSE: Returns the name of an encoding, as used by the encoding attribute of
+the band in the XML metadata.
+
+RETURN VALUE:
+Type = const char *
+Value        Description
+-----        -----------
+non-NULL     Name of the encoding
+
+NOTES:
+*****************************************************************************/
+const char *raw_binary_encoding_name
+(
+    Raw_binary_encoding_t encoding  /* I: encoding of the band file */
+)
+{
+    switch (encoding)
+    {
+        case RB_ENCODING_ZLIB_BLOCKS:
+            return RB_ENCODING_ZLIB_NAME;
+        case RB_ENCODING_ZSTD_BLOCKS:
+            return RB_ENCODING_ZSTD_NAME;
+        case RB_ENCODING_RAW_TILES:
+            return RB_ENCODING_TILES_NAME;
+        case RB_ENCODING_BITPACKED_BLOCKS:
+            return RB_ENCODING_BITPACKED_NAME;
+        case RB_ENCODING_RLE_BLOCKS:
+            return RB_ENCODING_RLE_NAME;
+        default:
+            return RB_ENCODING_RAW_NAME;
+    }
+}
+
+
+/******************************************************************************
+MODULE: parse_raw_binary_encoding
+
+PURPOSE: Converts the name of an encoding to the encoding.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Unknown encoding, or the zstd encoding isn't available in this
+             build
+SUCCESS      The encoding was converted
+
+NOTES:
+*****************************************************************************/
+int parse_raw_binary_encoding
+(
+    const char *name,               /* I: name of the encoding */
+    Raw_binary_encoding_t *encoding /* O: encoding of the band file */
+)
+{
+    char FUNC_NAME[] = "parse_raw_binary_encoding"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+
+    if (!strcmp (name, RB_ENCODING_RAW_NAME))
+        *encoding = RB_ENCODING_RAW;
+    else if (!strcmp (name, RB_ENCODING_ZLIB_NAME))
+        *encoding = RB_ENCODING_ZLIB_BLOCKS;
+    else if (!strcmp (name, RB_ENCODING_ZSTD_NAME))
+    {
+#ifdef HAVE_ZSTD
+        *encoding = RB_ENCODING_ZSTD_BLOCKS;
+#else
+        sprintf (errmsg, "The %s encoding requires the library to be built "
+            "with ENABLE_ZSTD=yes", name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return ERROR;
+#endif
+    }
+    else if (!strcmp (name, RB_ENCODING_TILES_NAME))
+        *encoding = RB_ENCODING_RAW_TILES;
+    else if (!strcmp (name, RB_ENCODING_BITPACKED_NAME))
+        *encoding = RB_ENCODING_BITPACKED_BLOCKS;
+    else if (!strcmp (name, RB_ENCODING_RLE_NAME))
+        *encoding = RB_ENCODING_RLE_BLOCKS;
+    else
+    {
+        sprintf (errmsg, "Unknown raw binary encoding: %s.  Use %s, %s, %s, "
+            "%s, %s, or %s.", name, RB_ENCODING_RAW_NAME,
+            RB_ENCODING_ZLIB_NAME, RB_ENCODING_ZSTD_NAME,
+            RB_ENCODING_TILES_NAME, RB_ENCODING_BITPACKED_NAME,
+            RB_ENCODING_RLE_NAME);
+        error_handler (true, FUNC_NAME, errmsg);
+        return ERROR;
+    }
+
+    return SUCCESS;
+}
+
+
+/******************************************************************************
+MODULE: rb_blocks_bound
+
+PURPOSE: Determines the largest compressed size of a block.
+
+RETURN VALUE:
+Type = size_t
+Value        Description
+-----        -----------
+>0           Largest number of bytes in a compressed block
+
+NOTES:
+  1. A run-length encoded line is largest when every pixel is a run of its
+     own.
+*****************************************************************************/
+static size_t rb_blocks_bound
+(
+    Raw_binary_encoding_t encoding, /* I: encoding of the blocks */
+    int block_lines,                /* I: number of lines in a block */
+    int nsamps,                     /* I: number of samples in a line */
+    int size                        /* I: number of bytes per pixel */
+)
+{
+    size_t block_bytes = (size_t) block_lines * nsamps * size;
+                             /* bytes in an uncompressed block */
+
+    if (encoding == RB_ENCODING_BITPACKED_BLOCKS)
+        return block_lines * RB_BITPACKED_LINE_BYTES (nsamps);
+    if (encoding == RB_ENCODING_RLE_BLOCKS)
+        return block_lines * (sizeof (uint32_t) * ((size_t) nsamps + 1) +
+            nsamps);
+#ifdef HAVE_ZSTD
+    if (encoding == RB_ENCODING_ZSTD_BLOCKS)
+        return ZSTD_compressBound (block_bytes);
+#endif
+    return compressBound (block_bytes);
+}
+
+
+/******************************************************************************
+MODULE: free_raw_binary_blocks
+
+PURPOSE: Frees a reader of a block-compressed band.
+
+RETURN VALUE:
+Type = N/A
+
+NOTES:
+*****************************************************************************/
+static void free_raw_binary_blocks
+(
+    Raw_binary_blocks_t *blocks  /* I: reader to be freed */
+)
+{
+    pthread_mutex_destroy (&blocks->mutex);
+    free (blocks->index);
+    espa_trace_free (blocks->block_buf);
+    espa_trace_free (blocks->comp_buf);
+    free (blocks);
+}
+
+
+/******************************************************************************
+MODULE: is_raw_binary_blocks
+
+PURPOSE: Checks whether a band file starts with the magic number of a
+block-compressed band.
+
+RETURN VALUE:
+Type = bool
+Value        Description
+-----        -----------
+true         The file is a block-compressed band
+false        The file is a plain raw binary file, or can't be read
+
+NOTES:
+*****************************************************************************/
+bool is_raw_binary_blocks
+(
+    int fd               /* I: file descriptor of the band file */
+)
+{
+    char magic[RB_BLOCKS_MAGIC_BYTES];  /* first bytes of the file */
+
+    if (pio_raw_binary (fd, false, magic, sizeof (magic), 0) != SUCCESS)
+        return false;
+    return !memcmp (magic, RB_BLOCKS_MAGIC, RB_BLOCKS_MAGIC_BYTES);
+}
+
+
+/******************************************************************************
+MODULE: attach_raw_binary_blocks
+
+PURPOSE: Checks whether the band file is block-compressed (or tiled), and if
+so reads its index and attaches a reader to the file descriptor.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error reading the header or the index of a block-compressed
+             file
+SUCCESS      A reader was attached, or the file is a plain raw binary file
+
+NOTES:
+  1. A file which is too short to hold a header, or which doesn't start with
+     the magic number, is a plain raw binary file.
+*****************************************************************************/
+int attach_raw_binary_blocks
+(
+    int fd,              /* I: file descriptor of the band file */
+    char *infile         /* I: name of the band file, for error messages */
+)
+{
+    char FUNC_NAME[] = "attach_raw_binary_blocks"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    Rb_blocks_header_t header;   /* header of the band file */
+    Raw_binary_blocks_t *blocks = NULL;  /* reader of the band file */
+    Raw_binary_blocks_t **by_fd = NULL;  /* resized reader table */
+    ssize_t nread;           /* number of bytes of the header read */
+    size_t line_bytes;       /* number of bytes in a line of the band */
+    uint32_t ntiles;         /* number of tiles in a tiled band */
+    int i;                   /* looping variable */
+
+    do
+        nread = pread (fd, &header, sizeof (header), 0);
+    while (nread < 0 && errno == EINTR);
+    if (nread < 0)
+    {
+        sprintf (errmsg, "Reading the start of raw binary file %s", infile);
+        error_handler (true, FUNC_NAME, errmsg);
+        return ERROR;
+    }
+    if (nread < (ssize_t) sizeof (header) ||
+        memcmp (header.magic, RB_BLOCKS_MAGIC, RB_BLOCKS_MAGIC_BYTES))
+        return SUCCESS;
+
+    if (header.encoding == RB_ENCODING_RAW_TILES)
+    {
+        ntiles = 0;
+        if (header.block_lines != 0)
+            ntiles = ((header.nlines + header.block_lines - 1) /
+                header.block_lines) * ((header.nsamps + header.block_lines -
+                1) / header.block_lines);
+        if (header.block_lines == 0 || header.nsamps == 0 ||
+            header.size == 0 || header.nblocks != ntiles ||
+            header.index_offset < sizeof (header))
+        {
+            sprintf (errmsg, "Invalid header in tiled file %s", infile);
+            error_handler (true, FUNC_NAME, errmsg);
+            return ERROR;
+        }
+    }
+    else if ((header.encoding != RB_ENCODING_ZLIB_BLOCKS &&
+        header.encoding != RB_ENCODING_ZSTD_BLOCKS &&
+        header.encoding != RB_ENCODING_BITPACKED_BLOCKS &&
+        header.encoding != RB_ENCODING_RLE_BLOCKS) ||
+        header.block_lines == 0 || header.nsamps == 0 || header.size == 0 ||
+        header.nblocks != (header.nlines + header.block_lines - 1) /
+        header.block_lines || ((header.encoding ==
+        RB_ENCODING_BITPACKED_BLOCKS || header.encoding ==
+        RB_ENCODING_RLE_BLOCKS) && header.size != 1))
+    {
+        sprintf (errmsg, "Invalid header in block-compressed file %s",
+            infile);
+        error_handler (true, FUNC_NAME, errmsg);
+        return ERROR;
+    }
+#ifndef HAVE_ZSTD
+    if (header.encoding == RB_ENCODING_ZSTD_BLOCKS)
+    {
+        sprintf (errmsg, "Reading the zstd compressed file %s requires the "
+            "library to be built with ENABLE_ZSTD=yes", infile);
+        error_handler (true, FUNC_NAME, errmsg);
+        return ERROR;
+    }
+#endif
+
+    blocks = calloc (1, sizeof (Raw_binary_blocks_t));
+    if (blocks == NULL)
+    {
+        sprintf (errmsg, "Allocating the reader of block-compressed file %s",
+            infile);
+        error_handler (true, FUNC_NAME, errmsg);
+        return ERROR;
+    }
+    pthread_mutex_init (&blocks->mutex, NULL);
+    blocks->fd = fd;
+    blocks->header = header;
+    blocks->cached_block = -1;
+
+    /* Tiles are at fixed offsets and read as they are, so only the
+       compressed blocks have an index and a block buffer */
+    if (header.encoding != RB_ENCODING_RAW_TILES)
+    {
+        line_bytes = (size_t) header.nsamps * header.size;
+        blocks->index = malloc ((header.nblocks + 1) *
+            sizeof (Rb_blocks_index_t));
+        blocks->block_buf = espa_trace_malloc (header.block_lines *
+            line_bytes);
+        if (blocks->index == NULL || blocks->block_buf == NULL)
+        {
+            sprintf (errmsg, "Allocating the index and block buffer of "
+                "block-compressed file %s", infile);
+            error_handler (true, FUNC_NAME, errmsg);
+            free_raw_binary_blocks (blocks);
+            return ERROR;
+        }
+        if (pio_raw_binary (fd, false, blocks->index,
+            header.nblocks * sizeof (Rb_blocks_index_t),
+            (off_t) header.index_offset) != SUCCESS)
+        {
+            sprintf (errmsg, "Reading the index of %u blocks of "
+                "block-compressed file %s", header.nblocks, infile);
+            error_handler (true, FUNC_NAME, errmsg);
+            free_raw_binary_blocks (blocks);
+            return ERROR;
+        }
+    }
+
+    /* Hand the reader to the window reads of this file descriptor */
+    pthread_mutex_lock (&rb_blocks_mutex);
+    if (fd >= rb_blocks_nfds)
+    {
+        by_fd = realloc (rb_blocks_by_fd, (fd + 1) * sizeof (*by_fd));
+        if (by_fd == NULL)
+        {
+            pthread_mutex_unlock (&rb_blocks_mutex);
+            sprintf (errmsg, "Registering the reader of block-compressed "
+                "file %s", infile);
+            error_handler (true, FUNC_NAME, errmsg);
+            free_raw_binary_blocks (blocks);
+            return ERROR;
+        }
+        for (i = rb_blocks_nfds; i <= fd; i++)
+            by_fd[i] = NULL;
+        rb_blocks_by_fd = by_fd;
+        rb_blocks_nfds = fd + 1;
+    }
+    rb_blocks_by_fd[fd] = blocks;
+    pthread_mutex_unlock (&rb_blocks_mutex);
+
+    return SUCCESS;
+}
+
+
+/******************************************************************************
+MODULE: get_raw_binary_blocks
+
+PURPOSE: Looks up the reader attached to a file descriptor.
+
+RETURN VALUE:
+Type = Raw_binary_blocks_t *
+Value        Description
+-----        -----------
+NULL         The file is a plain raw binary file
+non-NULL     Reader of the block-compressed file
+
+NOTES:
+*****************************************************************************/
+Raw_binary_blocks_t *get_raw_binary_blocks
+(
+    int fd               /* I: file descriptor of the band file */
+)
+{
+    Raw_binary_blocks_t *blocks = NULL;  /* reader of the band file */
+
+    pthread_mutex_lock (&rb_blocks_mutex);
+    if (fd >= 0 && fd < rb_blocks_nfds)
+        blocks = rb_blocks_by_fd[fd];
+    pthread_mutex_unlock (&rb_blocks_mutex);
+
+    return blocks;
+}
+
+
+/******************************************************************************
+MODULE: detach_raw_binary_blocks
+
+PURPOSE: Detaches and frees the reader attached to a file descriptor, if
+there is one.
+
+RETURN VALUE:
+Type = N/A
+
+NOTES:
+  1. Must be called before the file descriptor is closed, since the number
+     may be reused by the next file opened.
+*****************************************************************************/
+void detach_raw_binary_blocks
+(
+    int fd               /* I: file descriptor of the band file */
+)
+{
+    Raw_binary_blocks_t *blocks = NULL;  /* reader of the band file */
+
+    pthread_mutex_lock (&rb_blocks_mutex);
+    if (fd >= 0 && fd < rb_blocks_nfds)
+    {
+        blocks = rb_blocks_by_fd[fd];
+        rb_blocks_by_fd[fd] = NULL;
+    }
+    pthread_mutex_unlock (&rb_blocks_mutex);
+
+    if (blocks != NULL)
+        free_raw_binary_blocks (blocks);
+}
+
+
+/******************************************************************************
+MODULE: rb_bitpacked_encode
+
+PURPOSE: Packs the 8-bit lines of a block to one bit per pixel.
+
+RETURN VALUE:
+Type = size_t
+Value        Description
+-----        -----------
+>0           Number of bytes in the packed block
+
+NOTES:
+*****************************************************************************/
+static size_t rb_bitpacked_encode
+(
+    const char *lines,   /* I: 8-bit lines of the block */
+    int nlines,          /* I: number of lines in the block */
+    int nsamps,          /* I: number of samples in a line */
+    char *out            /* O: packed block; rb_blocks_bound bytes */
+)
+{
+    size_t line_bytes = RB_BITPACKED_LINE_BYTES (nsamps);
+                             /* number of packed bytes per line */
+    int line;                /* looping variable for the lines */
+
+    for (line = 0; line < nlines; line++)
+        pack_raw_binary_bits (nsamps, (const uint8_t *) lines +
+            (size_t) line * nsamps, (uint8_t *) out + line * line_bytes);
+
+    return nlines * line_bytes;
+}
+
+
+/******************************************************************************
+MODULE: rb_bitpacked_decode
+
+PURPOSE: Expands a bit-packed block to one 8-bit value (0 or 1) per pixel.
+
+RETURN VALUE:
+Type = size_t
+Value        Description
+-----        -----------
+0            The packed block is the wrong size
+>0           Number of bytes in the expanded block
+
+NOTES:
+*****************************************************************************/
+static size_t rb_bitpacked_decode
+(
+    const char *in,      /* I: packed block */
+    size_t nbytes,       /* I: number of bytes in the packed block */
+    int nlines,          /* I: number of lines in the block */
+    int nsamps,          /* I: number of samples in a line */
+    char *lines          /* O: 8-bit lines of the block */
+)
+{
+    size_t line_bytes = RB_BITPACKED_LINE_BYTES (nsamps);
+                             /* number of packed bytes per line */
+    int line;                /* looping variable for the lines */
+
+    if (nbytes != nlines * line_bytes)
+        return 0;
+
+    for (line = 0; line < nlines; line++)
+        unpack_raw_binary_bits (nsamps, (const uint8_t *) in +
+            line * line_bytes, (uint8_t *) lines + (size_t) line * nsamps);
+
+    return (size_t) nlines * nsamps;
+}
+
+
+/******************************************************************************
+MODULE: rb_rle_encode
+
+PURPOSE: Run-length encodes the 8-bit lines of a block.
+
+RETURN VALUE:
+Type = size_t
+Value        Description
+-----        -----------
+>0           Number of bytes in the encoded block
+
+NOTES:
+  1. Each line is the number of runs (uint32), the length of each run
+     (uint32), then the value of each run (uint8), as written by
+     write_raw_binary_rle.  The counts aren't aligned in the block, so they
+     are copied in and out.
+*****************************************************************************/
+static size_t rb_rle_encode
+(
+    const char *lines,   /* I: 8-bit lines of the block */
+    int nlines,          /* I: number of lines in the block */
+    int nsamps,          /* I: number of samples in a line */
+    char *out            /* O: encoded block; rb_blocks_bound bytes */
+)
+{
+    const uint8_t *in;       /* current input line */
+    char *ptr = out;         /* next byte of the encoded block */
+    char *nruns_ptr;         /* run count of the current line */
+    uint32_t nruns;          /* number of runs in the current line */
+    uint32_t length;         /* length of the current run */
+    int line;                /* looping variable for the lines */
+    int samp;                /* looping variable for the samples */
+
+    for (line = 0; line < nlines; line++)
+    {
+        in = (const uint8_t *) lines + (size_t) line * nsamps;
+
+        /* The run lengths come first, then the values */
+        nruns_ptr = ptr;
+        ptr += sizeof (uint32_t);
+        nruns = 0;
+        for (samp = 0; samp < nsamps; samp += length)
+        {
+            for (length = 1; samp + length < (uint32_t) nsamps &&
+                in[samp + length] == in[samp]; length++)
+                ;
+            memcpy (ptr, &length, sizeof (length));
+            ptr += sizeof (length);
+            nruns++;
+        }
+        memcpy (nruns_ptr, &nruns, sizeof (nruns));
+
+        for (samp = 0; samp < nsamps; samp++)
+        {
+            if (samp == 0 || in[samp] != in[samp - 1])
+                *ptr++ = in[samp];
+        }
+    }
+
+    return ptr - out;
+}
+
+
+/******************************************************************************
+MODULE: rb_rle_decode
+
+PURPOSE: Decodes a run-length encoded block to its 8-bit lines.
+
+RETURN VALUE:
+Type = size_t
+Value        Description
+-----        -----------
+0            The encoded block is truncated, or a line doesn't decode to
+             nsamps pixels
+>0           Number of bytes in the decoded block
+
+NOTES:
+*****************************************************************************/
+static size_t rb_rle_decode
+(
+    const char *in,      /* I: encoded block */
+    size_t nbytes,       /* I: number of bytes in the encoded block */
+    int nlines,          /* I: number of lines in the block */
+    int nsamps,          /* I: number of samples in a line */
+    char *lines          /* O: 8-bit lines of the block */
+)
+{
+    const char *ptr = in;    /* next byte of the encoded block */
+    const char *end = in + nbytes;  /* end of the encoded block */
+    const char *values;      /* run values of the current line */
+    char *out;               /* current output line */
+    uint32_t nruns;          /* number of runs in the current line */
+    uint32_t run;            /* looping variable for the runs */
+    uint32_t length;         /* length of the current run */
+    size_t filled;           /* number of samples decoded in the line */
+    int line;                /* looping variable for the lines */
+
+    for (line = 0; line < nlines; line++)
+    {
+        if ((size_t) (end - ptr) < sizeof (nruns))
+            return 0;
+        memcpy (&nruns, ptr, sizeof (nruns));
+        ptr += sizeof (nruns);
+        if (nruns > (uint32_t) nsamps || (nruns == 0 && nsamps > 0) ||
+            (size_t) (end - ptr) < (sizeof (uint32_t) + 1) * nruns)
+            return 0;
+        values = ptr + sizeof (uint32_t) * nruns;
+
+        out = lines + (size_t) line * nsamps;
+        filled = 0;
+        for (run = 0; run < nruns; run++)
+        {
+            memcpy (&length, ptr + sizeof (uint32_t) * run, sizeof (length));
+            if (length > nsamps - filled)
+                return 0;
+            memset (out + filled, values[run], length);
+            filled += length;
+        }
+        if (filled != (size_t) nsamps)
+            return 0;
+        ptr = values + nruns;
+    }
+
+    return ptr == end ? (size_t) nlines * nsamps : 0;
+}
+
+
+/******************************************************************************
+MODULE: rb_blocks_decode
+
+PURPOSE: Reads and decompresses (or decodes) a block into the block buffer
+of the reader.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error reading or decompressing the block
+SUCCESS      The block is in the block buffer
+
+NOTES:
+  1. The mutex of the reader must be held.
+*****************************************************************************/
+static int rb_blocks_decode
+(
+    Raw_binary_blocks_t *blocks, /* I/O: reader of the band file */
+    int block                    /* I: 0-based block to be decompressed */
+)
+{
+    char FUNC_NAME[] = "rb_blocks_decode"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    Rb_blocks_header_t *hdr = &blocks->header;  /* header of the band file */
+    Rb_blocks_index_t *entry = &blocks->index[block]; /* block index entry */
+    size_t line_bytes;       /* number of bytes in a line of the band */
+    size_t block_bytes;      /* number of bytes in the decompressed block */
+    size_t nbytes;           /* number of bytes decompressed */
+    uLongf dest_len;         /* number of bytes decompressed by zlib */
+    int nlines;              /* number of lines in the block */
+    char *comp_buf = NULL;   /* resized compressed buffer */
+
+    if (blocks->cached_block == block)
+        return SUCCESS;
+
+    nlines = hdr->block_lines;
+    if ((uint32_t) block * hdr->block_lines + nlines > hdr->nlines)
+        nlines = hdr->nlines - block * hdr->block_lines;
+    line_bytes = (size_t) hdr->nsamps * hdr->size;
+    block_bytes = nlines * line_bytes;
+
+    if (entry->nbytes > blocks->comp_bytes)
+    {
+        comp_buf = espa_trace_realloc (blocks->comp_buf, entry->nbytes);
+        if (comp_buf == NULL)
+        {
+            sprintf (errmsg, "Allocating %llu bytes for compressed block %d",
+                (unsigned long long) entry->nbytes, block);
+            error_handler (true, FUNC_NAME, errmsg);
+            return ERROR;
+        }
+        blocks->comp_buf = comp_buf;
+        blocks->comp_bytes = entry->nbytes;
+    }
+
+    blocks->cached_block = -1;
+    if (pio_raw_binary (blocks->fd, false, blocks->comp_buf, entry->nbytes,
+        (off_t) entry->offset) != SUCCESS)
+    {
+        sprintf (errmsg, "Reading compressed block %d", block);
+        error_handler (true, FUNC_NAME, errmsg);
+        return ERROR;
+    }
+
+    if (hdr->encoding == RB_ENCODING_ZLIB_BLOCKS)
+    {
+        dest_len = block_bytes;
+        if (uncompress ((Bytef *) blocks->block_buf, &dest_len,
+            (Bytef *) blocks->comp_buf, entry->nbytes) != Z_OK)
+            dest_len = 0;
+        nbytes = dest_len;
+    }
+    else if (hdr->encoding == RB_ENCODING_BITPACKED_BLOCKS)
+        nbytes = rb_bitpacked_decode (blocks->comp_buf, entry->nbytes, nlines,
+            hdr->nsamps, blocks->block_buf);
+    else if (hdr->encoding == RB_ENCODING_RLE_BLOCKS)
+        nbytes = rb_rle_decode (blocks->comp_buf, entry->nbytes, nlines,
+            hdr->nsamps, blocks->block_buf);
+#ifdef HAVE_ZSTD
+    else
+    {
+        nbytes = ZSTD_decompress (blocks->block_buf, block_bytes,
+            blocks->comp_buf, entry->nbytes);
+        if (ZSTD_isError (nbytes))
+            nbytes = 0;
+    }
+#else
+    else
+        nbytes = 0;
+#endif
+    if (nbytes != block_bytes)
+    {
+        sprintf (errmsg, "Decompressing block %d (%d lines)", block,
+            nlines);
+        error_handler (true, FUNC_NAME, errmsg);
+        return ERROR;
+    }
+
+    blocks->cached_block = block;
+    return SUCCESS;
+}
+
+
+/******************************************************************************
+MODULE: rb_tiles_read
+
+PURPOSE: Reads a window of nlines x nsamps from a tiled band starting at
+line0, samp0, reading the part of each tile the window covers.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error reading the tiles
+SUCCESS      Reading was successful
+
+NOTES:
+  1. The window has already been checked against the band.
+  2. Within each row of tiles, the lines of the window are read from each
+     tile it covers, or from the whole run of tiles at once when the window
+     covers all the lines of the row, since those tiles are contiguous.
+*****************************************************************************/
+static int rb_tiles_read
+(
+    Raw_binary_blocks_t *blocks, /* I: reader of the band file */
+    int line0,          /* I: 0-based starting line of the window */
+    int nlines,         /* I: number of lines in the window */
+    int samp0,          /* I: 0-based starting sample of the window */
+    int nsamps,         /* I: number of samples in the window */
+    void *img_array     /* O: array of nlines * nsamps pixels */
+)
+{
+    char FUNC_NAME[] = "rb_tiles_read"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    Rb_blocks_header_t *hdr = &blocks->header;  /* header of the band file */
+    int tile_size = hdr->block_lines;  /* lines and samples in each tile */
+    int ntiles_across;       /* number of tiles across the band */
+    int tx0, tx1;            /* first and last tile column of the window */
+    int tx;                  /* looping variable for the tile columns */
+    int ty;                  /* tile row of the current line */
+    int line;                /* first line of the window in the tile row */
+    int last_line;           /* last line of the window in the tile row */
+    int row;                 /* looping variable for the lines */
+    int s0, s1;              /* samples of the window in the current tile */
+    size_t tile_line_bytes;  /* number of bytes in a line of a tile */
+    size_t tile_bytes;       /* number of bytes in a tile */
+    size_t win_line_bytes;   /* number of bytes in a line of the window */
+    off_t first_tile;        /* file offset of the first tile of the window
+                                in the tile row */
+    char *tile_buf = NULL;   /* lines of the window in each tile */
+    char *ptr = img_array;   /* current line in the window buffer */
+    int status = SUCCESS;    /* status of reading the tiles */
+
+    if (nlines == 0 || nsamps == 0)
+        return SUCCESS;
+
+    ntiles_across = (hdr->nsamps + tile_size - 1) / tile_size;
+    tile_line_bytes = (size_t) tile_size * hdr->size;
+    tile_bytes = tile_size * tile_line_bytes;
+    win_line_bytes = (size_t) nsamps * hdr->size;
+    tx0 = samp0 / tile_size;
+    tx1 = (samp0 + nsamps - 1) / tile_size;
+
+    tile_buf = espa_trace_malloc ((tx1 - tx0 + 1) * tile_bytes);
+    if (tile_buf == NULL)
+    {
+        sprintf (errmsg, "Allocating %d tiles of %d lines and samples",
+            tx1 - tx0 + 1, tile_size);
+        error_handler (true, FUNC_NAME, errmsg);
+        return ERROR;
+    }
+
+    for (line = line0; line < line0 + nlines && status == SUCCESS;
+        line = last_line + 1)
+    {
+        ty = line / tile_size;
+        last_line = (ty + 1) * tile_size - 1;
+        if (last_line > line0 + nlines - 1)
+            last_line = line0 + nlines - 1;
+        first_tile = (off_t) hdr->index_offset + ((off_t) ty *
+            ntiles_across + tx0) * tile_bytes;
+
+        /* Read the lines of the window in each tile to the start of the
+           tile in the buffer */
+        if (last_line - line + 1 == tile_size)
+        {
+            if (pio_raw_binary (blocks->fd, false, tile_buf,
+                (tx1 - tx0 + 1) * tile_bytes, first_tile) != SUCCESS)
+                status = ERROR;
+        }
+        else
+        {
+            for (tx = tx0; tx <= tx1 && status == SUCCESS; tx++)
+            {
+                if (pio_raw_binary (blocks->fd, false, tile_buf +
+                    (tx - tx0) * tile_bytes, (last_line - line + 1) *
+                    tile_line_bytes, first_tile + (tx - tx0) * tile_bytes +
+                    (off_t) (line - ty * tile_size) * tile_line_bytes)
+                    != SUCCESS)
+                    status = ERROR;
+            }
+        }
+        if (status != SUCCESS)
+        {
+            sprintf (errmsg, "Reading lines %d-%d of the tiled band", line,
+                last_line);
+            error_handler (true, FUNC_NAME, errmsg);
+            break;
+        }
+
+        /* Gather the samples of the window from each tile */
+        for (row = 0; row <= last_line - line; row++)
+        {
+            for (tx = tx0; tx <= tx1; tx++)
+            {
+                s0 = tx * tile_size;
+                s1 = s0 + tile_size;
+                if (s0 < samp0)
+                    s0 = samp0;
+                if (s1 > samp0 + nsamps)
+                    s1 = samp0 + nsamps;
+                memcpy (ptr + (size_t) (s0 - samp0) * hdr->size,
+                    tile_buf + (tx - tx0) * tile_bytes + row *
+                    tile_line_bytes + (size_t) (s0 - tx * tile_size) *
+                    hdr->size, (size_t) (s1 - s0) * hdr->size);
+            }
+            ptr += win_line_bytes;
+        }
+    }
+
+    espa_trace_free (tile_buf);
+    return status;
+}
+
+
+/******************************************************************************
+MODULE: read_raw_binary_blocks
+
+PURPOSE: Reads a window of nlines x nsamps from a block-compressed band
+starting at line0, samp0, decompressing the blocks the window covers.  The
+windows of a tiled band are read from the tiles they cover.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        An invalid window, or an error reading the blocks
+SUCCESS      Reading was successful
+
+NOTES:
+  1. The window is returned packed, i.e. each line of the window holds nsamps
+     pixels, as for read_raw_binary_window.
+  2. Safe for multiple threads reading windows of the same reader; the
+     blocks are decompressed one at a time.
+*****************************************************************************/
+int read_raw_binary_blocks
+(
+    Raw_binary_blocks_t *blocks, /* I: reader of the band file */
+    int band_nsamps,    /* I: number of samples in a full line of the band */
+    int line0,          /* I: 0-based starting line of the window */
+    int nlines,         /* I: number of lines in the window */
+    int samp0,          /* I: 0-based starting sample of the window */
+    int nsamps,         /* I: number of samples in the window */
+    int size,           /* I: number of bytes per pixel (ex. sizeof(uint8)) */
+    void *img_array     /* O: array of nlines * nsamps * size to be read from
+                              the band file (sufficient space should already
+                              have been allocated) */
+)
+{
+    char FUNC_NAME[] = "read_raw_binary_blocks"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    Rb_blocks_header_t *hdr = &blocks->header;  /* header of the band file */
+    int line;                /* current line of the window */
+    int last_line;           /* last line of the current block in the
+                                window */
+    int block;               /* block holding the current line */
+    size_t line_bytes;       /* number of bytes in a line of the band */
+    size_t win_line_bytes;   /* number of bytes in a line of the window */
+    char *ptr = img_array;   /* current line in the window buffer */
+    char *src;               /* current line in the block buffer */
+
+    if (line0 < 0 || nlines < 0 || samp0 < 0 || nsamps < 0 ||
+        samp0 + nsamps > band_nsamps || (uint32_t) band_nsamps != hdr->nsamps
+        || (uint32_t) size != hdr->size ||
+        (uint32_t) (line0 + nlines) > hdr->nlines)
+    {
+        sprintf (errmsg, "Invalid window: lines %d+%d, samples %d+%d of %d "
+            "bytes for a compressed band of %u lines, %u samples of %u "
+            "bytes.", line0, nlines, samp0, nsamps, size, hdr->nlines,
+            hdr->nsamps, hdr->size);
+        error_handler (true, FUNC_NAME, errmsg);
+        return ERROR;
+    }
+
+    if (hdr->encoding == RB_ENCODING_RAW_TILES)
+        return rb_tiles_read (blocks, line0, nlines, samp0, nsamps,
+            img_array);
+
+    line_bytes = (size_t) band_nsamps * size;
+    win_line_bytes = (size_t) nsamps * size;
+
+    pthread_mutex_lock (&blocks->mutex);
+    for (line = line0; line < line0 + nlines; line = last_line + 1)
+    {
+        block = line / hdr->block_lines;
+        last_line = (block + 1) * hdr->block_lines - 1;
+        if (last_line > line0 + nlines - 1)
+            last_line = line0 + nlines - 1;
+
+        if (rb_blocks_decode (blocks, block) != SUCCESS)
+        {
+            pthread_mutex_unlock (&blocks->mutex);
+            sprintf (errmsg, "Reading lines %d-%d of the compressed band",
+                line, last_line);
+            error_handler (true, FUNC_NAME, errmsg);
+            return ERROR;
+        }
+
+        src = blocks->block_buf + (line - block * hdr->block_lines) *
+            line_bytes + (size_t) samp0 * size;
+        if (nsamps == band_nsamps)
+        {
+            memcpy (ptr, src, (last_line - line + 1) * line_bytes);
+            ptr += (last_line - line + 1) * line_bytes;
+        }
+        else
+        {
+            for (; line <= last_line; line++)
+            {
+                memcpy (ptr, src, win_line_bytes);
+                ptr += win_line_bytes;
+                src += line_bytes;
+            }
+            line--;
+        }
+    }
+    pthread_mutex_unlock (&blocks->mutex);
+
+    return SUCCESS;
+}
+
+
+/******************************************************************************
+MODULE: free_raw_binary_blocks_writer
+
+PURPOSE: Closes the band file and frees a block-compressed band writer.
+
+RETURN VALUE:
+Type = N/A
+
+NOTES:
+*****************************************************************************/
+static void free_raw_binary_blocks_writer
+(
+    Rb_blocks_writer_t *writer  /* I: writer to be freed */
+)
+{
+    if (writer->fd >= 0)
+    {
+        close (writer->fd);
+        espa_staging_done (writer->file_name);
+    }
+    free (writer->index);
+    espa_trace_free (writer->block_buf);
+    espa_trace_free (writer->comp_buf);
+    free (writer);
+}
+
+
+/******************************************************************************
+MODULE: open_raw_binary_blocks_writer
+
+PURPOSE: Creates a block-compressed (or tiled) band file to which the lines
+of the band are appended in order.
+
+RETURN VALUE:
+Type = Rb_blocks_writer_t *
+Value        Description
+-----        -----------
+NULL         Error creating the file or allocating the writer
+non-NULL     Block-compressed band writer
+
+NOTES:
+  1. The header is written by close_raw_binary_blocks_writer once the index
+     is complete, so a file which wasn't closed isn't recognized as a
+     block-compressed file.
+  2. The blocks of a tiled band are the rows of tiles, which are gathered
+     a row of tiles at a time.
+*****************************************************************************/
+Rb_blocks_writer_t *open_raw_binary_blocks_writer
+(
+    char *outfile,       /* I: name of the band file to be created */
+    Raw_binary_encoding_t encoding, /* I: encoding of the blocks; not
+                               RB_ENCODING_RAW */
+    int nlines,          /* I: number of lines in the band */
+    int nsamps,          /* I: number of samples in the band */
+    int size,            /* I: number of bytes per pixel */
+    int block_lines      /* I: number of lines per block; 0 for
+                               RB_BLOCKS_DEFAULT_LINES */
+)
+{
+    char FUNC_NAME[] = "open_raw_binary_blocks_writer"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    char path[STR_SIZE];     /* name the file is created under */
+    Rb_blocks_writer_t *writer = NULL;  /* block-compressed band writer */
+    size_t block_bytes;      /* number of bytes in a full block */
+    int ntiles_across;       /* number of tiles across a tiled band */
+    int count;               /* number of chars copied in snprintf */
+
+    if (encoding != RB_ENCODING_ZLIB_BLOCKS &&
+        encoding != RB_ENCODING_ZSTD_BLOCKS &&
+        encoding != RB_ENCODING_RAW_TILES &&
+        encoding != RB_ENCODING_BITPACKED_BLOCKS &&
+        encoding != RB_ENCODING_RLE_BLOCKS)
+    {
+        sprintf (errmsg, "Unsupported encoding %s for the block-compressed "
+            "file %s", raw_binary_encoding_name (encoding), outfile);
+        error_handler (true, FUNC_NAME, errmsg);
+        return NULL;
+    }
+#ifndef HAVE_ZSTD
+    if (encoding == RB_ENCODING_ZSTD_BLOCKS)
+    {
+        sprintf (errmsg, "Writing the zstd compressed file %s requires the "
+            "library to be built with ENABLE_ZSTD=yes", outfile);
+        error_handler (true, FUNC_NAME, errmsg);
+        return NULL;
+    }
+#endif
+    if (nlines < 1 || nsamps < 1 || size < 1 || block_lines < 0)
+    {
+        sprintf (errmsg, "Invalid band of %d lines, %d samples of %d bytes "
+            "in %d line blocks for %s", nlines, nsamps, size, block_lines,
+            outfile);
+        error_handler (true, FUNC_NAME, errmsg);
+        return NULL;
+    }
+    if ((encoding == RB_ENCODING_BITPACKED_BLOCKS ||
+        encoding == RB_ENCODING_RLE_BLOCKS) && size != 1)
+    {
+        sprintf (errmsg, "The %s encoding is only for 8-bit bands, not the "
+            "%d byte pixels of %s", raw_binary_encoding_name (encoding),
+            size, outfile);
+        error_handler (true, FUNC_NAME, errmsg);
+        return NULL;
+    }
+    if (encoding == RB_ENCODING_RAW_TILES)
+    {
+        if (block_lines == 0)
+            block_lines = RB_TILES_DEFAULT_SIZE;
+    }
+    else
+    {
+        if (block_lines == 0)
+            block_lines = RB_BLOCKS_DEFAULT_LINES;
+        if (block_lines > nlines)
+            block_lines = nlines;
+    }
+
+    writer = calloc (1, sizeof (Rb_blocks_writer_t));
+    if (writer == NULL)
+    {
+        sprintf (errmsg, "Allocating the writer for %s", outfile);
+        error_handler (true, FUNC_NAME, errmsg);
+        return NULL;
+    }
+    writer->fd = -1;
+
+    count = snprintf (writer->file_name, sizeof (writer->file_name), "%s",
+        outfile);
+    if (count < 0 || count >= sizeof (writer->file_name))
+    {
+        sprintf (errmsg, "Overflow of writer->file_name string");
+        error_handler (true, FUNC_NAME, errmsg);
+        free_raw_binary_blocks_writer (writer);
+        return NULL;
+    }
+
+    memcpy (writer->header.magic, RB_BLOCKS_MAGIC, RB_BLOCKS_MAGIC_BYTES);
+    writer->header.encoding = encoding;
+    writer->header.block_lines = block_lines;
+    writer->header.nlines = nlines;
+    writer->header.nsamps = nsamps;
+    writer->header.size = size;
+    writer->header.nblocks = (nlines + block_lines - 1) / block_lines;
+    writer->offset = sizeof (Rb_blocks_header_t);
+
+    block_bytes = (size_t) block_lines * nsamps * size;
+    if (encoding == RB_ENCODING_RAW_TILES)
+    {
+        /* A row of tiles is arranged in comp_buf */
+        ntiles_across = (nsamps + block_lines - 1) / block_lines;
+        writer->header.nblocks *= ntiles_across;
+        writer->header.index_offset = RB_TILES_DATA_OFFSET;
+        writer->offset = RB_TILES_DATA_OFFSET;
+        writer->comp_bytes = (size_t) ntiles_across * block_lines *
+            block_lines * size;
+    }
+    else
+    {
+        writer->comp_bytes = rb_blocks_bound (encoding, block_lines, nsamps,
+            size);
+        writer->index = calloc (writer->header.nblocks,
+            sizeof (Rb_blocks_index_t));
+    }
+    writer->block_buf = espa_trace_malloc (block_bytes);
+    writer->comp_buf = espa_trace_malloc (writer->comp_bytes);
+    if ((writer->index == NULL && encoding != RB_ENCODING_RAW_TILES) ||
+        writer->block_buf == NULL || writer->comp_buf == NULL)
+    {
+        sprintf (errmsg, "Allocating the block buffers for %s", outfile);
+        error_handler (true, FUNC_NAME, errmsg);
+        free_raw_binary_blocks_writer (writer);
+        return NULL;
+    }
+
+    if (espa_staging_path (outfile, ESPA_STAGE_CREATE, path,
+        sizeof (path)) != SUCCESS)
+    {
+        free_raw_binary_blocks_writer (writer);
+        return NULL;
+    }
+    writer->fd = open (path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (writer->fd == -1)
+    {
+        sprintf (errmsg, "Creating the block-compressed file %s", outfile);
+        error_handler (true, FUNC_NAME, errmsg);
+        espa_staging_done (outfile);
+        free_raw_binary_blocks_writer (writer);
+        return NULL;
+    }
+
+    return writer;
+}
+
+
+/******************************************************************************
+MODULE: rb_tiles_encode
+
+PURPOSE: Arranges the lines of the next row of tiles of the band into the
+tiles and writes them after the previous rows of tiles.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error writing the row of tiles
+SUCCESS      The row of tiles was written
+
+NOTES:
+  1. The tiles are padded with zeros past the last line and sample of the
+     band.
+*****************************************************************************/
+static int rb_tiles_encode
+(
+    Rb_blocks_writer_t *writer, /* I/O: tiled band writer */
+    const char *lines,          /* I: lines of the row of tiles */
+    int nlines                  /* I: number of lines in the row of tiles */
+)
+{
+    char FUNC_NAME[] = "rb_tiles_encode"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    Rb_blocks_header_t *hdr = &writer->header;  /* header of the band file */
+    int tile_size = hdr->block_lines;  /* lines and samples in each tile */
+    int tile_row = writer->nlines_written / tile_size; /* current row */
+    int ntiles_across;       /* number of tiles across the band */
+    int nsamps;              /* number of samples of the band in the tile */
+    int tx;                  /* looping variable for the tile columns */
+    int row;                 /* looping variable for the lines */
+    size_t line_bytes;       /* number of bytes in a line of the band */
+    size_t tile_line_bytes;  /* number of bytes in a line of a tile */
+    size_t tile_bytes;       /* number of bytes in a tile */
+
+    ntiles_across = (hdr->nsamps + tile_size - 1) / tile_size;
+    line_bytes = (size_t) hdr->nsamps * hdr->size;
+    tile_line_bytes = (size_t) tile_size * hdr->size;
+    tile_bytes = tile_size * tile_line_bytes;
+
+    /* Padding is only needed past the edges of the band */
+    if (nlines < tile_size || hdr->nsamps % tile_size != 0)
+        memset (writer->comp_buf, 0, writer->comp_bytes);
+    for (tx = 0; tx < ntiles_across; tx++)
+    {
+        nsamps = hdr->nsamps - tx * tile_size;
+        if (nsamps > tile_size)
+            nsamps = tile_size;
+        for (row = 0; row < nlines; row++)
+            memcpy (writer->comp_buf + tx * tile_bytes + row *
+                tile_line_bytes, lines + row * line_bytes + tx *
+                tile_line_bytes, (size_t) nsamps * hdr->size);
+    }
+
+    if (pio_raw_binary (writer->fd, true, writer->comp_buf,
+        writer->comp_bytes, writer->offset) != SUCCESS)
+    {
+        sprintf (errmsg, "Writing tile row %d of %s", tile_row,
+            writer->file_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return ERROR;
+    }
+
+    writer->offset += writer->comp_bytes;
+    writer->nlines_written += nlines;
+    return SUCCESS;
+}
+
+
+/******************************************************************************
+MODULE: rb_blocks_encode
+
+PURPOSE: Compresses the next block of the band and writes it after the
+previous blocks.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error compressing or writing the block
+SUCCESS      The block was written
+
+NOTES:
+*****************************************************************************/
+static int rb_blocks_encode
+(
+    Rb_blocks_writer_t *writer, /* I/O: block-compressed band writer */
+    const char *lines,          /* I: lines of the block */
+    int nlines                  /* I: number of lines in the block */
+)
+{
+    char FUNC_NAME[] = "rb_blocks_encode"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    Rb_blocks_header_t *hdr = &writer->header;  /* header of the band file */
+    int block = writer->nlines_written / hdr->block_lines; /* current block */
+    size_t block_bytes;      /* number of bytes in the block */
+    size_t nbytes;           /* number of bytes in the compressed block */
+    uLongf dest_len;         /* number of bytes compressed by zlib */
+
+    if (hdr->encoding == RB_ENCODING_RAW_TILES)
+        return rb_tiles_encode (writer, lines, nlines);
+
+    block_bytes = (size_t) nlines * hdr->nsamps * hdr->size;
+    if (hdr->encoding == RB_ENCODING_ZLIB_BLOCKS)
+    {
+        dest_len = writer->comp_bytes;
+        if (compress2 ((Bytef *) writer->comp_buf, &dest_len,
+            (const Bytef *) lines, block_bytes, RB_BLOCKS_ZLIB_LEVEL) != Z_OK)
+            dest_len = 0;
+        nbytes = dest_len;
+    }
+    else if (hdr->encoding == RB_ENCODING_BITPACKED_BLOCKS)
+        nbytes = rb_bitpacked_encode (lines, nlines, hdr->nsamps,
+            writer->comp_buf);
+    else if (hdr->encoding == RB_ENCODING_RLE_BLOCKS)
+        nbytes = rb_rle_encode (lines, nlines, hdr->nsamps, writer->comp_buf);
+#ifdef HAVE_ZSTD
+    else
+    {
+        nbytes = ZSTD_compress (writer->comp_buf, writer->comp_bytes, lines,
+            block_bytes, RB_BLOCKS_ZSTD_LEVEL);
+        if (ZSTD_isError (nbytes))
+            nbytes = 0;
+    }
+#else
+    else
+        nbytes = 0;
+#endif
+    if (nbytes == 0)
+    {
+        sprintf (errmsg, "Compressing block %d of %s", block,
+            writer->file_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return ERROR;
+    }
+
+    if (pio_raw_binary (writer->fd, true, writer->comp_buf, nbytes,
+        writer->offset) != SUCCESS)
+    {
+        sprintf (errmsg, "Writing block %d of %s", block, writer->file_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return ERROR;
+    }
+
+    writer->index[block].offset = writer->offset;
+    writer->index[block].nbytes = nbytes;
+    writer->offset += nbytes;
+    writer->nlines_written += nlines;
+    return SUCCESS;
+}
+
+
+/******************************************************************************
+MODULE: append_raw_binary_blocks
+
+PURPOSE: Appends lines to the band, compressing and writing each block once
+all of its lines have been appended.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        The lines don't fit the band, or error writing a block
+SUCCESS      The lines were appended
+
+NOTES:
+  1. Whole blocks of the caller's array are compressed in place; only the
+     lines of partial blocks are gathered in the block buffer.
+*****************************************************************************/
+int append_raw_binary_blocks
+(
+    Rb_blocks_writer_t *writer, /* I: block-compressed band writer */
+    int nlines,         /* I: number of lines to write to the file */
+    int nsamps,         /* I: number of samples to write to the file */
+    int size,           /* I: number of bytes per pixel (ex. sizeof(uint8)) */
+    void *img_array     /* I: array of nlines * nsamps * size to be written
+                              after the lines already written */
+)
+{
+    char FUNC_NAME[] = "append_raw_binary_blocks"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    Rb_blocks_header_t *hdr = &writer->header;  /* header of the band file */
+    int block_lines = hdr->block_lines;  /* number of lines in a full block */
+    int full_lines;          /* number of lines in the current block */
+    int ncopy;               /* number of lines gathered into the buffer */
+    int first;               /* first line of the buffer in the band */
+    size_t line_bytes;       /* number of bytes in a line of the band */
+    const char *ptr = img_array;  /* next line to be appended */
+
+    if ((uint32_t) nsamps != hdr->nsamps || (uint32_t) size != hdr->size ||
+        nlines < 0 || (uint32_t) (writer->nlines_written + writer->nbuf_lines
+        + nlines) > hdr->nlines)
+    {
+        sprintf (errmsg, "Appending %d lines of %d samples of %d bytes to "
+            "%s, which holds %u lines of %u samples of %u bytes", nlines,
+            nsamps, size, writer->file_name, hdr->nlines, hdr->nsamps,
+            hdr->size);
+        error_handler (true, FUNC_NAME, errmsg);
+        return ERROR;
+    }
+    line_bytes = (size_t) nsamps * size;
+
+    while (nlines > 0)
+    {
+        /* Number of lines in the block being filled; the last block may be
+           short */
+        first = writer->nlines_written;
+        full_lines = block_lines;
+        if ((uint32_t) (first + full_lines) > hdr->nlines)
+            full_lines = hdr->nlines - first;
+
+        /* Compress whole blocks straight from the caller's array */
+        if (writer->nbuf_lines == 0 && nlines >= full_lines)
+        {
+            if (rb_blocks_encode (writer, ptr, full_lines) != SUCCESS)
+            {
+                sprintf (errmsg, "Writing lines %d-%d", first,
+                    first + full_lines - 1);
+                error_handler (true, FUNC_NAME, errmsg);
+                return ERROR;
+            }
+            ptr += full_lines * line_bytes;
+            nlines -= full_lines;
+            continue;
+        }
+
+        /* Otherwise gather the lines until the block is full */
+        ncopy = full_lines - writer->nbuf_lines;
+        if (ncopy > nlines)
+            ncopy = nlines;
+        memcpy (writer->block_buf + writer->nbuf_lines * line_bytes, ptr,
+            ncopy * line_bytes);
+        writer->nbuf_lines += ncopy;
+        ptr += ncopy * line_bytes;
+        nlines -= ncopy;
+
+        if (writer->nbuf_lines == full_lines)
+        {
+            writer->nbuf_lines = 0;
+            if (rb_blocks_encode (writer, writer->block_buf, full_lines)
+                != SUCCESS)
+            {
+                sprintf (errmsg, "Writing lines %d-%d", first,
+                    first + full_lines - 1);
+                error_handler (true, FUNC_NAME, errmsg);
+                return ERROR;
+            }
+        }
+    }
+
+    return SUCCESS;
+}
+
+
+/******************************************************************************
+MODULE: close_raw_binary_blocks_writer
+
+PURPOSE: Writes the block index and the header, closes the band file, and
+frees the writer.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Not all the lines of the band were appended, or error writing
+             the index or the header
+SUCCESS      The band file is complete
+
+NOTES:
+  1. The writer is freed in either case.
+*****************************************************************************/
+int close_raw_binary_blocks_writer
+(
+    Rb_blocks_writer_t *writer  /* I: block-compressed band writer to be
+                                      completed and closed */
+)
+{
+    char FUNC_NAME[] = "close_raw_binary_blocks_writer"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    Rb_blocks_header_t *hdr = &writer->header;  /* header of the band file */
+    int status = SUCCESS;    /* status of completing the file */
+
+    if ((uint32_t) writer->nlines_written != hdr->nlines)
+    {
+        sprintf (errmsg, "Only %d of the %u lines were written to %s",
+            writer->nlines_written + writer->nbuf_lines, hdr->nlines,
+            writer->file_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        status = ERROR;
+    }
+
+    /* Tiled bands have no index; the tiles start at index_offset */
+    if (status == SUCCESS)
+    {
+        if (hdr->encoding != RB_ENCODING_RAW_TILES)
+            hdr->index_offset = writer->offset;
+        if ((hdr->encoding != RB_ENCODING_RAW_TILES &&
+            pio_raw_binary (writer->fd, true, writer->index,
+            hdr->nblocks * sizeof (Rb_blocks_index_t), writer->offset)
+            != SUCCESS) ||
+            pio_raw_binary (writer->fd, true, hdr, sizeof (*hdr), 0)
+            != SUCCESS)
+        {
+            sprintf (errmsg, "Writing the block index and header of %s",
+                writer->file_name);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+        }
+    }
+
+    if (close (writer->fd) != 0 && status == SUCCESS)
+    {
+        sprintf (errmsg, "Closing %s", writer->file_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        status = ERROR;
+    }
+    writer->fd = -1;
+    espa_staging_done (writer->file_name);
+    free_raw_binary_blocks_writer (writer);
+
+    return status;
+}
@@ -0,0 +1,231 @@
+/*****************************************************************************
+FILE: raw_binary_blocks.h
+
+PURPOSE: Contains defines and structures for block-compressed raw binary
+bands, which hold fixed-size blocks of lines compressed independently along
+with an index of the blocks, so any window can be read by decompressing only
+the blocks it covers.  Also for tiled raw binary bands, which hold square
+tiles of pixels so a window is read with a few contiguous reads.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. Layout of a block-compressed band file, in native byte order:
+       Rb_blocks_header_t  header, with the offset of the index
+       compressed blocks   block b holds lines b * block_lines through
+                           (b + 1) * block_lines - 1 (fewer for the last
+                           block), each compressed on its own
+       Rb_blocks_index_t   file offset and compressed size of each block
+  2. The zstd encoding is only available if the library was built with
+     ENABLE_ZSTD=yes (which defines HAVE_ZSTD).  The zlib encoding is always
+     available.
+  3. The band files are recognized by the magic number at the start of the
+     header, so open_raw_binary_fd attaches a reader to them and the window
+     and batch reads decompress them transparently.  The encoding attribute
+     of the band in the XML metadata records the encoding as well.
+  4. Layout of a tiled band file (RB_ENCODING_RAW_TILES), in native byte
+     order:
+       Rb_blocks_header_t  header, with block_lines the number of lines and
+                           samples in each tile, nblocks the number of
+                           tiles, and index_offset the offset of the first
+                           tile (RB_TILES_DATA_OFFSET)
+       tiles               tile t holds tile row t / ntiles_across and tile
+                           column t % ntiles_across, each tile_size lines of
+                           tile_size pixels as is, padded with zeros past
+                           the edges of the band
+     Each tile is at a fixed offset, so there is no index.  A window within
+     one tile is a single read, and a window covering whole rows of tiles is
+     a single read for each row of tiles.  The tile_size attribute of the
+     band in the XML metadata records the size of the tiles.
+  5. The bit-packed and run-length encoded blocks are laid out the same as
+     the compressed blocks, and are only for 8-bit bands such as masks.
+     Each line of a bit-packed block is packed with pack_raw_binary_bits, so
+     any non-zero pixel reads back as 1.  Each line of a run-length encoded
+     block is encoded as by write_raw_binary_rle.
+*****************************************************************************/
+
+#ifndef RAW_BINARY_BLOCKS_H
+#define RAW_BINARY_BLOCKS_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include "error_handler.h"
+
+/* Encodings of a raw binary band file */
+typedef enum {
+  RB_ENCODING_RAW,         /* plain band sequential pixels */
+  RB_ENCODING_ZLIB_BLOCKS, /* blocks of lines compressed with zlib */
+  RB_ENCODING_ZSTD_BLOCKS, /* blocks of lines compressed with zstd */
+  RB_ENCODING_RAW_TILES,   /* square tiles of pixels, not compressed */
+  RB_ENCODING_BITPACKED_BLOCKS, /* blocks of 8-bit lines packed to one bit
+                                   per pixel */
+  RB_ENCODING_RLE_BLOCKS   /* blocks of 8-bit lines run-length encoded */
+} Raw_binary_encoding_t;
+
+/* Names of the encodings, as used by the encoding attribute of the band in
+   the XML metadata */
+#define RB_ENCODING_RAW_NAME "raw"
+#define RB_ENCODING_ZLIB_NAME "zlib_blocks"
+#define RB_ENCODING_ZSTD_NAME "zstd_blocks"
+#define RB_ENCODING_TILES_NAME "raw_tiles"
+#define RB_ENCODING_BITPACKED_NAME "bitpacked_blocks"
+#define RB_ENCODING_RLE_NAME "rle_blocks"
+
+/* File extensions of the block-compressed band files */
+#define RB_BLOCKS_ZLIB_EXT ".img.zz"
+#define RB_BLOCKS_ZSTD_EXT ".img.zst"
+#define RB_TILES_EXT ".img.tl"
+#define RB_BLOCKS_BITPACKED_EXT ".img.bit"
+#define RB_BLOCKS_RLE_EXT ".img.rle"
+
+/* Defines for the block-compressed band files */
+#define RB_BLOCKS_MAGIC "ESPARBZ1"     /* first bytes of the header */
+#define RB_BLOCKS_MAGIC_BYTES 8        /* number of bytes in the magic */
+#define RB_BLOCKS_DEFAULT_LINES 64     /* default number of lines per block */
+#define RB_BLOCKS_ZLIB_LEVEL 6         /* compression level for zlib */
+#define RB_BLOCKS_ZSTD_LEVEL 3         /* compression level for zstd */
+#define RB_TILES_DEFAULT_SIZE 256      /* default number of lines and
+                                          samples per tile */
+#define RB_TILES_DATA_OFFSET 4096      /* file offset of the first tile, so
+                                          the tiles are aligned to pages */
+
+/* Header at the start of a block-compressed band file */
+typedef struct
+{
+    char magic[RB_BLOCKS_MAGIC_BYTES]; /* RB_BLOCKS_MAGIC */
+    uint32_t encoding;       /* Raw_binary_encoding_t of the blocks */
+    uint32_t block_lines;    /* number of lines in each full block, or of
+                                lines and samples in each tile */
+    uint32_t nlines;         /* number of lines in the band */
+    uint32_t nsamps;         /* number of samples in the band */
+    uint32_t size;           /* number of bytes per pixel */
+    uint32_t nblocks;        /* number of blocks (or tiles) in the band */
+    uint64_t index_offset;   /* file offset of the block index, or of the
+                                first tile */
+} Rb_blocks_header_t;
+
+/* Entry of the block index */
+typedef struct
+{
+    uint64_t offset;         /* file offset of the compressed block */
+    uint64_t nbytes;         /* number of bytes in the compressed block */
+} Rb_blocks_index_t;
+
+/* Reader of a block-compressed band file */
+typedef struct
+{
+    int fd;                  /* file descriptor of the band file */
+    Rb_blocks_header_t header;  /* header of the band file */
+    Rb_blocks_index_t *index;   /* index of the nblocks blocks; NULL for
+                                   tiles */
+    pthread_mutex_t mutex;   /* guards the cached block, since windows of the
+                                same file descriptor may be read by multiple
+                                threads */
+    int cached_block;        /* block held in block_buf; -1 if none */
+    char *block_buf;         /* decompressed lines of the cached block */
+    char *comp_buf;          /* compressed bytes of the block being read */
+    size_t comp_bytes;       /* number of bytes allocated for comp_buf */
+} Raw_binary_blocks_t;
+
+/* Writer of a block-compressed band file; the lines are appended in order */
+typedef struct
+{
+    char file_name[STR_SIZE];   /* name of the band file */
+    int fd;                  /* file descriptor of the band file */
+    Rb_blocks_header_t header;  /* header of the band file */
+    Rb_blocks_index_t *index;   /* index of the blocks written so far; NULL
+                                   for tiles */
+    int nlines_written;      /* number of lines appended so far */
+    int nbuf_lines;          /* number of lines in block_buf */
+    char *block_buf;         /* lines of the block being gathered */
+    char *comp_buf;          /* compressed bytes of the block, or the row of
+                                tiles of the block */
+    size_t comp_bytes;       /* number of bytes allocated for comp_buf */
+    off_t offset;            /* file offset of the next block */
+} Rb_blocks_writer_t;
+
+/* Prototypes */
+const char *raw_binary_encoding_name
+(
+    Raw_binary_encoding_t encoding  /* I: encoding of the band file */
+);
+
+int parse_raw_binary_encoding
+(
+    const char *name,               /* I: name of the encoding */
+    Raw_binary_encoding_t *encoding /* O: encoding of the band file */
+);
+
+bool is_raw_binary_blocks
+(
+    int fd               /* I: file descriptor of the band file */
+);
+
+int attach_raw_binary_blocks
+(
+    int fd,              /* I: file descriptor of the band file */
+    char *infile         /* I: name of the band file, for error messages */
+);
+
+Raw_binary_blocks_t *get_raw_binary_blocks
+(
+    int fd               /* I: file descriptor of the band file */
+);
+
+void detach_raw_binary_blocks
+(
+    int fd               /* I: file descriptor of the band file */
+);
+
+int read_raw_binary_blocks
+(
+    Raw_binary_blocks_t *blocks, /* I: reader of the band file */
+    int band_nsamps,    /* I: number of samples in a full line of the band */
+    int line0,          /* I: 0-based starting line of the window */
+    int nlines,         /* I: number of lines in the window */
+    int samp0,          /* I: 0-based starting sample of the window */
+    int nsamps,         /* I: number of samples in the window */
+    int size,           /* I: number of bytes per pixel (ex. sizeof(uint8)) */
+    void *img_array     /* O: array of nlines * nsamps * size to be read from
+                              the band file (sufficient space should already
+                              have been allocated) */
+);
+
+Rb_blocks_writer_t *open_raw_binary_blocks_writer
+(
+    char *outfile,       /* I: name of the band file to be created */
+    Raw_binary_encoding_t encoding, /* I: encoding of the blocks; not
+                               RB_ENCODING_RAW */
+    int nlines,          /* I: number of lines in the band */
+    int nsamps,          /* I: number of samples in the band */
+    int size,            /* I: number of bytes per pixel */
+    int block_lines      /* I: number of lines per block, or of lines and
+                               samples per tile; 0 for
+                               RB_BLOCKS_DEFAULT_LINES or
+                               RB_TILES_DEFAULT_SIZE */
+);
+
+int append_raw_binary_blocks
+(
+    Rb_blocks_writer_t *writer, /* I: block-compressed band writer */
+    int nlines,         /* I: number of lines to write to the file */
+    int nsamps,         /* I: number of samples to write to the file */
+    int size,           /* I: number of bytes per pixel (ex. sizeof(uint8)) */
+    void *img_array     /* I: array of nlines * nsamps * size to be written
+                              after the lines already written */
+);
+
+int close_raw_binary_blocks_writer
+(
+    Rb_blocks_writer_t *writer  /* I: block-compressed band writer to be
+                                      completed and closed */
+);
+
+#endif
@@ -0,0 +1,869 @@
+/*****************************************************************************
+FILE: raw_binary_cache.c
+
+PURPOSE: Contains functions for the process-wide cache of the blocks of the
+raw binary bands, shared by the window routines of every file descriptor
+open on the same band file.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. A single mutex protects the cache.  It isn't held while blocks are read
+     from the file or copied out to the callers; a block being copied out is
+     pinned by its count of readers so it isn't dropped, and writes to the
+     block wait until it is no longer pinned.
+  2. A block read from the file while the file is being written may hold
+     the bytes from before the write, so it is only added to the cache when
+     no write of the file finished while it was being read.
+  3. When a file's modification time no longer matches its cached blocks,
+     its generation is raised.  Blocks of an older generation are never
+     returned, and are dropped right away unless they are pinned, in which
+     case they are dropped as they age out.
+*****************************************************************************/
+
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include "raw_binary_io.h"
+#include "raw_binary_cache.h"
+#include "espa_metrics.h"
+#include "espa_trace.h"
+
+/* Band file whose blocks are cached */
+typedef struct Rb_cache_file
+{
+    dev_t dev;                 /* device of the file */
+    ino_t ino;                 /* inode of the file */
+    struct timespec mtime;     /* modification time the blocks match */
+    unsigned generation;       /* generation of the current blocks */
+    unsigned writes;           /* number of writes finished through the
+                                  cache */
+    int nfds;                  /* number of file descriptors attached */
+    int nblocks;               /* number of blocks held, of any generation */
+    struct Rb_cache_file *next;  /* next file with blocks or descriptors */
+} Rb_cache_file_t;
+
+/* Cached block of a band file */
+typedef struct Rb_cache_block
+{
+    Rb_cache_file_t *file;     /* file holding the block */
+    unsigned generation;       /* generation of the file the block is of */
+    off_t index;               /* index of the block in the file */
+    char *buf;                 /* RB_CACHE_BLOCK_BYTES for the block */
+    size_t nbytes;             /* number of bytes of the block in the file;
+                                  fewer than RB_CACHE_BLOCK_BYTES at the end
+                                  of the file */
+    int readers;               /* number of reads copying out of buf */
+    struct Rb_cache_block *hash_next;  /* next block in the hash bucket */
+    struct Rb_cache_block *lru_prev;   /* more recently used block */
+    struct Rb_cache_block *lru_next;   /* less recently used block */
+} Rb_cache_block_t;
+
+static pthread_mutex_t rb_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t rb_cache_unpinned = PTHREAD_COND_INITIALIZER;
+static pthread_once_t rb_cache_once = PTHREAD_ONCE_INIT;
+static size_t rb_cache_budget = 0;   /* bytes of blocks which may be held */
+static size_t rb_cache_used = 0;     /* bytes of blocks held */
+static Rb_cache_block_t *rb_cache_buckets[RB_CACHE_BUCKETS];
+static Rb_cache_block_t *rb_cache_lru_head = NULL;  /* most recently used */
+static Rb_cache_block_t *rb_cache_lru_tail = NULL;  /* least recently used */
+static Rb_cache_file_t *rb_cache_files = NULL;
+static Rb_cache_file_t **rb_cache_by_fd = NULL;
+static int rb_cache_nfds = 0;
+static uint64_t rb_cache_hits = 0;
+static uint64_t rb_cache_misses = 0;
+
+
+/******************************************************************************
+MODULE: rb_cache_init
+
+PURPOSE: Takes the memory budget of the cache from RB_CACHE_MB_ENV.  Called
+once.
+
+RETURN VALUE:
+Type = N/A
+
+NOTES:
+*****************************************************************************/
+static void rb_cache_init (void)
+{
+    char *value = getenv (RB_CACHE_MB_ENV);  /* value of the variable */
+    long cache_mb;           /* memory budget (MB) */
+
+    if (value == NULL)
+        return;
+    cache_mb = atol (value);
+    if (cache_mb > 0)
+        rb_cache_budget = espa_mem_cache_bytes ((size_t) cache_mb * 1024 *
+            1024);
+}
+
+
+/******************************************************************************
+MODULE: rb_cache_bucket
+
+PURPOSE: Hashes a block of a file to its bucket.
+
+RETURN VALUE:
+Type = Rb_cache_block_t **
+Value        Description
+-----        -----------
+non-NULL     Head of the bucket of the block
+
+NOTES:
+*****************************************************************************/
+static Rb_cache_block_t **rb_cache_bucket
+(
+    const Rb_cache_file_t *file,  /* I: file holding the block */
+    off_t index                   /* I: index of the block in the file */
+)
+{
+    uint64_t hash;           /* hash of the file and index */
+
+    hash = ((uint64_t) (uintptr_t) file >> 4) ^
+        ((uint64_t) index * 0x9e3779b97f4a7c15ULL);
+    hash ^= hash >> 29;
+    return &rb_cache_buckets[hash & (RB_CACHE_BUCKETS - 1)];
+}
+
+
+/******************************************************************************
+MODULE: rb_cache_touch
+
+PURPOSE: Moves a block to the head of the least recently used list, adding
+it to the list if it's new.  Called with the mutex held.
+
+RETURN VALUE:
+Type = N/A
+
+NOTES:
+*****************************************************************************/
+static void rb_cache_touch
+(
+    Rb_cache_block_t *blk,   /* I/O: block which was used */
+    bool listed              /* I: is the block already in the list? */
+)
+{
+    if (listed)
+    {
+        if (blk == rb_cache_lru_head)
+            return;
+        if (blk->lru_prev != NULL)
+            blk->lru_prev->lru_next = blk->lru_next;
+        if (blk->lru_next != NULL)
+            blk->lru_next->lru_prev = blk->lru_prev;
+        else
+            rb_cache_lru_tail = blk->lru_prev;
+    }
+
+    blk->lru_prev = NULL;
+    blk->lru_next = rb_cache_lru_head;
+    if (rb_cache_lru_head != NULL)
+        rb_cache_lru_head->lru_prev = blk;
+    rb_cache_lru_head = blk;
+    if (rb_cache_lru_tail == NULL)
+        rb_cache_lru_tail = blk;
+}
+
+
+/******************************************************************************
+MODULE: rb_cache_free_file
+
+PURPOSE: Frees the record of a file once it has no blocks and no file
+descriptors.  Called with the mutex held.
+
+RETURN VALUE:
+Type = N/A
+
+NOTES:
+*****************************************************************************/
+static void rb_cache_free_file
+(
+    Rb_cache_file_t *file    /* I: file which may be freed */
+)
+{
+    Rb_cache_file_t **link;  /* link to the file in the list */
+
+    if (file->nfds > 0 || file->nblocks > 0)
+        return;
+
+    for (link = &rb_cache_files; *link != NULL; link = &(*link)->next)
+    {
+        if (*link == file)
+        {
+            *link = file->next;
+            break;
+        }
+    }
+    free (file);
+}
+
+
+/******************************************************************************
+MODULE: rb_cache_drop
+
+PURPOSE: Drops an unpinned block from the cache.  Called with the mutex held.
+
+RETURN VALUE:
+Type = N/A
+
+NOTES:
+*****************************************************************************/
+static void rb_cache_drop
+(
+    Rb_cache_block_t *blk    /* I: block to be dropped */
+)
+{
+    Rb_cache_block_t **link; /* link to the block in its bucket */
+    Rb_cache_file_t *file = blk->file;  /* file holding the block */
+
+    for (link = rb_cache_bucket (file, blk->index); *link != NULL;
+        link = &(*link)->hash_next)
+    {
+        if (*link == blk)
+        {
+            *link = blk->hash_next;
+            break;
+        }
+    }
+
+    if (blk->lru_prev != NULL)
+        blk->lru_prev->lru_next = blk->lru_next;
+    else
+        rb_cache_lru_head = blk->lru_next;
+    if (blk->lru_next != NULL)
+        blk->lru_next->lru_prev = blk->lru_prev;
+    else
+        rb_cache_lru_tail = blk->lru_prev;
+
+    rb_cache_used -= RB_CACHE_BLOCK_BYTES;
+    file->nblocks--;
+    free (blk->buf);
+    free (blk);
+    rb_cache_free_file (file);
+}
+
+
+/******************************************************************************
+MODULE: rb_cache_evict
+
+PURPOSE: Drops the least recently used blocks which aren't pinned until the
+blocks held fit within a number of bytes.  Called with the mutex held.
+
+RETURN VALUE:
+Type = N/A
+
+NOTES:
+*****************************************************************************/
+static void rb_cache_evict
+(
+    size_t limit             /* I: number of bytes of blocks to be kept */
+)
+{
+    Rb_cache_block_t *blk = rb_cache_lru_tail;  /* candidate block */
+    Rb_cache_block_t *prev;  /* next candidate */
+
+    while (rb_cache_used > limit && blk != NULL)
+    {
+        prev = blk->lru_prev;
+        if (blk->readers == 0)
+            rb_cache_drop (blk);
+        blk = prev;
+    }
+}
+
+
+/******************************************************************************
+MODULE: rb_cache_find
+
+PURPOSE: Looks up the current block of a file.  Called with the mutex held.
+
+RETURN VALUE:
+Type = Rb_cache_block_t *
+Value        Description
+-----        -----------
+NULL         The block isn't cached
+non-NULL     Cached block
+
+NOTES:
+*****************************************************************************/
+static Rb_cache_block_t *rb_cache_find
+(
+    const Rb_cache_file_t *file,  /* I: file holding the block */
+    off_t index                   /* I: index of the block in the file */
+)
+{
+    Rb_cache_block_t *blk;   /* block in the bucket */
+
+    for (blk = *rb_cache_bucket (file, index); blk != NULL;
+        blk = blk->hash_next)
+    {
+        if (blk->file == file && blk->index == index &&
+            blk->generation == file->generation)
+            return blk;
+    }
+
+    return NULL;
+}
+
+
+/******************************************************************************
+MODULE: rb_cache_get
+
+PURPOSE: Gets a block of a file from the cache, reading it into the cache if
+it isn't there, and pins it for the caller.
+
+RETURN VALUE:
+Type = Rb_cache_block_t *
+Value        Description
+-----        -----------
+NULL         Error reading the block
+non-NULL     Pinned block; the caller decrements its readers when done
+
+NOTES:
+  1. Two threads missing the same block both read it; the second to finish
+     uses the block of the first and frees its own.
+  2. A block which a write of the file may have overlapped while it was
+     being read is read again, since it may hold the bytes from before the
+     write.
+*****************************************************************************/
+static Rb_cache_block_t *rb_cache_get
+(
+    int fd,                  /* I: file descriptor of the band file */
+    Rb_cache_file_t *file,   /* I: file holding the block */
+    off_t index              /* I: index of the block in the file */
+)
+{
+    char FUNC_NAME[] = "rb_cache_get";  /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    char *buf = NULL;        /* bytes of the block being read */
+    size_t nbytes = 0;       /* number of bytes read */
+    ssize_t nread;           /* number of bytes read by this call */
+    off_t offset;            /* file offset of the block */
+    unsigned generation;     /* generation of the file being read */
+    unsigned writes;         /* writes of the file finished before the read */
+    Rb_cache_block_t *blk = NULL;  /* cached block */
+
+    pthread_mutex_lock (&rb_cache_mutex);
+    blk = rb_cache_find (file, index);
+    if (blk != NULL)
+    {
+        blk->readers++;
+        rb_cache_touch (blk, true);
+        rb_cache_hits++;
+        pthread_mutex_unlock (&rb_cache_mutex);
+        espa_metrics_cache (ESPA_METRICS_BAND, true);
+        return blk;
+    }
+    rb_cache_misses++;
+    generation = file->generation;
+    writes = file->writes;
+    pthread_mutex_unlock (&rb_cache_mutex);
+    espa_metrics_cache (ESPA_METRICS_BAND, false);
+
+    /* Read the block, stopping short at the end of the file */
+    buf = malloc (RB_CACHE_BLOCK_BYTES);
+    if (buf == NULL)
+    {
+        sprintf (errmsg, "Allocating a block of the band cache");
+        error_handler (true, FUNC_NAME, errmsg);
+        return NULL;
+    }
+    offset = index * (off_t) RB_CACHE_BLOCK_BYTES;
+    while (nbytes < RB_CACHE_BLOCK_BYTES)
+    {
+        nread = pread (fd, buf + nbytes, RB_CACHE_BLOCK_BYTES - nbytes,
+            offset + (off_t) nbytes);
+        if (nread < 0 && errno == EINTR)
+            continue;
+        if (nread < 0)
+        {
+            sprintf (errmsg, "Reading block %lld of the band file",
+                (long long) index);
+            error_handler (true, FUNC_NAME, errmsg);
+            free (buf);
+            return NULL;
+        }
+        if (nread == 0)
+            break;
+        nbytes += nread;
+    }
+
+    pthread_mutex_lock (&rb_cache_mutex);
+    blk = rb_cache_find (file, index);
+    if (blk == NULL && generation == file->generation &&
+        writes == file->writes)
+    {
+        blk = calloc (1, sizeof (Rb_cache_block_t));
+        if (blk == NULL)
+        {
+            pthread_mutex_unlock (&rb_cache_mutex);
+            sprintf (errmsg, "Allocating a block of the band cache");
+            error_handler (true, FUNC_NAME, errmsg);
+            free (buf);
+            return NULL;
+        }
+        blk->file = file;
+        blk->generation = generation;
+        blk->index = index;
+        blk->buf = buf;
+        blk->nbytes = nbytes;
+        buf = NULL;
+
+        blk->hash_next = *rb_cache_bucket (file, index);
+        *rb_cache_bucket (file, index) = blk;
+        rb_cache_touch (blk, false);
+        rb_cache_used += RB_CACHE_BLOCK_BYTES;
+        file->nblocks++;
+        blk->readers++;
+        rb_cache_evict (rb_cache_budget);
+    }
+    else if (blk != NULL)
+    {
+        blk->readers++;
+        rb_cache_touch (blk, true);
+    }
+    pthread_mutex_unlock (&rb_cache_mutex);
+
+    /* The file changed, or was written, while the block was read; read it
+       again */
+    if (blk == NULL)
+    {
+        free (buf);
+        return rb_cache_get (fd, file, index);
+    }
+
+    free (buf);
+    return blk;
+}
+
+
+/******************************************************************************
+MODULE: rb_cache_invalidate
+
+PURPOSE: Starts a new generation of the blocks of a file, dropping the blocks
+of the old generation which aren't pinned.  Called with the mutex held.
+
+RETURN VALUE:
+Type = N/A
+
+NOTES:
+*****************************************************************************/
+static void rb_cache_invalidate
+(
+    Rb_cache_file_t *file    /* I/O: file whose blocks are out of date */
+)
+{
+    Rb_cache_block_t *blk = rb_cache_lru_head;  /* block being checked */
+    Rb_cache_block_t *next;  /* next block to be checked */
+
+    file->generation++;
+    file->nfds++;            /* keeps the record while its blocks go */
+    while (blk != NULL)
+    {
+        next = blk->lru_next;
+        if (blk->file == file && blk->readers == 0)
+            rb_cache_drop (blk);
+        blk = next;
+    }
+    file->nfds--;
+}
+
+
+/******************************************************************************
+MODULE: set_raw_binary_cache_mb
+
+PURPOSE: Sets the memory budget of the cache, dropping the least recently
+used blocks which no longer fit.
+
+RETURN VALUE:
+Type = N/A
+
+NOTES:
+  1. Overrides RB_CACHE_MB_ENV.  Files opened while the budget is 0 aren't
+     cached, even once the budget is raised.
+  2. The budget is capped at the share of the memory budget for a cache
+     (see espa_mem_cache_bytes).
+*****************************************************************************/
+void set_raw_binary_cache_mb
+(
+    int cache_mb         /* I: memory budget of the cache (MB); 0 turns the
+                               cache off and frees its blocks */
+)
+{
+    pthread_once (&rb_cache_once, rb_cache_init);
+
+    pthread_mutex_lock (&rb_cache_mutex);
+    rb_cache_budget = cache_mb > 0 ?
+        espa_mem_cache_bytes ((size_t) cache_mb * 1024 * 1024) : 0;
+    rb_cache_evict (rb_cache_budget);
+    pthread_mutex_unlock (&rb_cache_mutex);
+}
+
+
+/******************************************************************************
+MODULE: get_raw_binary_cache_mb
+
+PURPOSE: Returns the memory budget of the cache.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+0            The cache is off
+> 0          Memory budget of the cache (MB)
+
+NOTES:
+*****************************************************************************/
+int get_raw_binary_cache_mb (void)
+{
+    size_t budget;           /* memory budget (bytes) */
+
+    pthread_once (&rb_cache_once, rb_cache_init);
+
+    pthread_mutex_lock (&rb_cache_mutex);
+    budget = rb_cache_budget;
+    pthread_mutex_unlock (&rb_cache_mutex);
+
+    return (int) (budget / (1024 * 1024));
+}
+
+
+/******************************************************************************
+MODULE: attach_raw_binary_cache
+
+PURPOSE: Caches the blocks of the band file read and written through a file
+descriptor, if the cache is on.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error registering the file descriptor
+SUCCESS      The file descriptor is cached, or the cache is off
+
+NOTES:
+  1. The cached blocks of the file are dropped if the file was modified
+     since they were read, other than through the cache.
+*****************************************************************************/
+int attach_raw_binary_cache
+(
+    int fd,              /* I: file descriptor of the band file */
+    char *infile         /* I: name of the band file, for error messages */
+)
+{
+    char FUNC_NAME[] = "attach_raw_binary_cache"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    struct stat statbuf;     /* status of the band file */
+    Rb_cache_file_t *file = NULL;   /* cached file */
+    Rb_cache_file_t **by_fd = NULL; /* resized table */
+    int i;                   /* looping variable */
+
+    pthread_once (&rb_cache_once, rb_cache_init);
+    if (get_raw_binary_cache_mb () == 0)
+        return SUCCESS;
+    if (fstat (fd, &statbuf) != 0 || !S_ISREG (statbuf.st_mode))
+        return SUCCESS;
+
+    pthread_mutex_lock (&rb_cache_mutex);
+    if (fd >= rb_cache_nfds)
+    {
+        by_fd = realloc (rb_cache_by_fd, (fd + 1) * sizeof (*by_fd));
+        if (by_fd == NULL)
+        {
+            pthread_mutex_unlock (&rb_cache_mutex);
+            sprintf (errmsg, "Registering raw binary file %s with the band "
+                "cache", infile);
+            error_handler (true, FUNC_NAME, errmsg);
+            return ERROR;
+        }
+        for (i = rb_cache_nfds; i <= fd; i++)
+            by_fd[i] = NULL;
+        rb_cache_by_fd = by_fd;
+        rb_cache_nfds = fd + 1;
+    }
+
+    for (file = rb_cache_files; file != NULL; file = file->next)
+    {
+        if (file->dev == statbuf.st_dev && file->ino == statbuf.st_ino)
+            break;
+    }
+    if (file == NULL)
+    {
+        file = calloc (1, sizeof (Rb_cache_file_t));
+        if (file == NULL)
+        {
+            pthread_mutex_unlock (&rb_cache_mutex);
+            sprintf (errmsg, "Registering raw binary file %s with the band "
+                "cache", infile);
+            error_handler (true, FUNC_NAME, errmsg);
+            return ERROR;
+        }
+        file->dev = statbuf.st_dev;
+        file->ino = statbuf.st_ino;
+        file->next = rb_cache_files;
+        rb_cache_files = file;
+    }
+    else if (file->mtime.tv_sec != statbuf.st_mtim.tv_sec ||
+        file->mtime.tv_nsec != statbuf.st_mtim.tv_nsec)
+        rb_cache_invalidate (file);
+
+    file->mtime = statbuf.st_mtim;
+    file->nfds++;
+    rb_cache_by_fd[fd] = file;
+    pthread_mutex_unlock (&rb_cache_mutex);
+
+    return SUCCESS;
+}
+
+
+/******************************************************************************
+MODULE: is_raw_binary_cached
+
+PURPOSE: Checks whether a file descriptor is attached to the cache.
+
+RETURN VALUE:
+Type = bool
+Value        Description
+-----        -----------
+true         The file descriptor is read and written through the cache
+false        The file descriptor isn't cached
+
+NOTES:
+*****************************************************************************/
+bool is_raw_binary_cached
+(
+    int fd               /* I: file descriptor of the band file */
+)
+{
+    bool cached = false;     /* is the file descriptor cached? */
+
+    pthread_mutex_lock (&rb_cache_mutex);
+    if (fd >= 0 && fd < rb_cache_nfds)
+        cached = rb_cache_by_fd[fd] != NULL;
+    pthread_mutex_unlock (&rb_cache_mutex);
+
+    return cached;
+}
+
+
+/******************************************************************************
+MODULE: detach_raw_binary_cache
+
+PURPOSE: Detaches a file descriptor from the cache.  The cached blocks of the
+file are kept for the next file descriptor opened on it.
+
+RETURN VALUE:
+Type = N/A
+
+NOTES:
+  1. Must be called before the file descriptor is closed, since the number
+     may be reused by the next file opened.
+*****************************************************************************/
+void detach_raw_binary_cache
+(
+    int fd               /* I: file descriptor of the band file */
+)
+{
+    Rb_cache_file_t *file = NULL;  /* cached file */
+
+    pthread_mutex_lock (&rb_cache_mutex);
+    if (fd >= 0 && fd < rb_cache_nfds)
+    {
+        file = rb_cache_by_fd[fd];
+        rb_cache_by_fd[fd] = NULL;
+    }
+    if (file != NULL)
+    {
+        file->nfds--;
+        rb_cache_free_file (file);
+    }
+    pthread_mutex_unlock (&rb_cache_mutex);
+}
+
+
+/******************************************************************************
+MODULE: rb_cache_write
+
+PURPOSE: Writes a range of bytes to the band file and updates the blocks of
+the range which are cached.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        An error occurred writing the file
+SUCCESS      All of the bytes were written
+
+NOTES:
+  1. A write past the end of a cached block at the end of the file extends
+     the block; any gap reads back as zeros from the file, and is zeroed in
+     the block.
+  2. The modification time of the write is recorded, so the blocks stay
+     valid for the next file descriptor opened on the file.
+  3. A cached block which is pinned by reads copying out of it is only
+     updated once the reads are done.  The write is counted once the blocks
+     are updated, so reads of the file which missed the cache while it was
+     being written don't add the blocks they read (see rb_cache_get).
+*****************************************************************************/
+static int rb_cache_write
+(
+    int fd,                  /* I: file descriptor of the band file */
+    Rb_cache_file_t *file,   /* I/O: file being written */
+    const char *buf,         /* I: bytes to be written */
+    size_t nbytes,           /* I: number of bytes to write */
+    off_t offset             /* I: file offset for the write */
+)
+{
+    off_t end = offset + (off_t) nbytes;  /* end of the range */
+    off_t index;             /* index of the current block */
+    off_t block0;            /* file offset of the current block */
+    size_t start;            /* first byte of the range in the block */
+    size_t stop;             /* one past the last byte in the block */
+    struct stat statbuf;     /* status of the band file */
+    Rb_cache_block_t *blk;   /* cached block */
+
+    if (pio_raw_binary (fd, true, (void *) buf, nbytes, offset) != SUCCESS)
+    {
+        /* Part of the range may have been written */
+        pthread_mutex_lock (&rb_cache_mutex);
+        rb_cache_invalidate (file);
+        pthread_mutex_unlock (&rb_cache_mutex);
+        return ERROR;
+    }
+
+    pthread_mutex_lock (&rb_cache_mutex);
+    for (index = offset / RB_CACHE_BLOCK_BYTES;
+        index * (off_t) RB_CACHE_BLOCK_BYTES < end; index++)
+    {
+        /* Wait for the reads copying out of the block; it may be dropped
+           meanwhile, so it's looked up again each time */
+        while ((blk = rb_cache_find (file, index)) != NULL &&
+            blk->readers > 0)
+            pthread_cond_wait (&rb_cache_unpinned, &rb_cache_mutex);
+        if (blk == NULL)
+            continue;
+
+        block0 = index * (off_t) RB_CACHE_BLOCK_BYTES;
+        start = offset > block0 ? offset - block0 : 0;
+        stop = end < block0 + RB_CACHE_BLOCK_BYTES ? end - block0 :
+            RB_CACHE_BLOCK_BYTES;
+        if (start > blk->nbytes)
+            memset (blk->buf + blk->nbytes, 0, start - blk->nbytes);
+        memcpy (blk->buf + start, buf + (block0 + start - offset),
+            stop - start);
+        if (stop > blk->nbytes)
+            blk->nbytes = stop;
+    }
+    file->writes++;
+    if (fstat (fd, &statbuf) == 0)
+        file->mtime = statbuf.st_mtim;
+    pthread_mutex_unlock (&rb_cache_mutex);
+
+    return SUCCESS;
+}
+
+
+/******************************************************************************
+MODULE: cached_raw_binary_io
+
+PURPOSE: Reads or writes a range of bytes of a band file through the cache,
+or straight to the file if the file descriptor isn't cached.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        An error occurred or end of file was reached first
+SUCCESS      All of the bytes were transferred
+
+NOTES:
+  1. Reads are copied out of the cached blocks of the range, reading the
+     blocks which aren't cached into the cache.
+*****************************************************************************/
+int cached_raw_binary_io
+(
+    int fd,             /* I: file descriptor of the band file */
+    bool write_flag,    /* I: write (true) or read (false) */
+    void *buf,          /* I/O: buffer to be written or read into */
+    size_t nbytes,      /* I: number of bytes to transfer */
+    off_t offset        /* I: file offset for the transfer */
+)
+{
+    char *ptr = buf;         /* current position in the buffer */
+    off_t end = offset + (off_t) nbytes;  /* end of the range */
+    off_t index;             /* index of the current block */
+    off_t block0;            /* file offset of the current block */
+    size_t start;            /* first byte of the range in the block */
+    size_t stop;             /* one past the last byte in the block */
+    size_t budget;           /* memory budget of the cache (bytes) */
+    bool in_file;            /* is the range within the block in the file? */
+    Rb_cache_file_t *file = NULL;  /* cached file */
+    Rb_cache_block_t *blk;   /* cached block */
+
+    pthread_mutex_lock (&rb_cache_mutex);
+    if (fd >= 0 && fd < rb_cache_nfds)
+        file = rb_cache_by_fd[fd];
+    budget = rb_cache_budget;
+    pthread_mutex_unlock (&rb_cache_mutex);
+
+    if (file == NULL || budget == 0 || (!write_flag && nbytes > budget / 2))
+        return pio_raw_binary (fd, write_flag, buf, nbytes, offset);
+    if (write_flag)
+        return rb_cache_write (fd, file, buf, nbytes, offset);
+
+    for (index = offset / RB_CACHE_BLOCK_BYTES;
+        index * (off_t) RB_CACHE_BLOCK_BYTES < end; index++)
+    {
+        blk = rb_cache_get (fd, file, index);
+        if (blk == NULL)
+            return ERROR;
+
+        block0 = index * (off_t) RB_CACHE_BLOCK_BYTES;
+        start = offset > block0 ? offset - block0 : 0;
+        stop = end < block0 + RB_CACHE_BLOCK_BYTES ? end - block0 :
+            RB_CACHE_BLOCK_BYTES;
+        in_file = stop <= blk->nbytes;
+        if (in_file)
+            memcpy (ptr, blk->buf + start, stop - start);
+
+        pthread_mutex_lock (&rb_cache_mutex);
+        blk->readers--;
+        if (blk->readers == 0)
+            pthread_cond_broadcast (&rb_cache_unpinned);
+        pthread_mutex_unlock (&rb_cache_mutex);
+
+        if (!in_file)
+            return ERROR;     /* unexpected end of file */
+        ptr += stop - start;
+    }
+
+    return SUCCESS;
+}
+
+
+/******************************************************************************
+MODULE: get_raw_binary_cache_stats
+
+PURPOSE: Returns the number of blocks found in the cache and read into it.
+
+RETURN VALUE:
+Type = N/A
+
+NOTES:
+*****************************************************************************/
+void get_raw_binary_cache_stats
+(
+    uint64_t *hits,      /* O: number of blocks found in the cache */
+    uint64_t *misses     /* O: number of blocks read into the cache */
+)
+{
+    pthread_mutex_lock (&rb_cache_mutex);
+    *hits = rb_cache_hits;
+    *misses = rb_cache_misses;
+    pthread_mutex_unlock (&rb_cache_mutex);
+}
@@ -0,0 +1,97 @@
+/*****************************************************************************
+FILE: raw_binary_cache.h
+
+PURPOSE: Contains defines and prototypes for the process-wide cache of the
+blocks of the raw binary bands, which keeps the bands read and written
+through the window routines (see read_raw_binary_window) in memory, so the
+later steps of a pipeline working on the same scene (ex. process_level1, or
+a long-running process using libespa_formatter) don't read them from disk
+again.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The cache is off unless it is given a memory budget, by setting
+     RB_CACHE_MB_ENV to a number of megabytes or by calling
+     set_raw_binary_cache_mb.  At most that many megabytes of blocks are
+     held, capped at ESPA_MEM_CACHE_SHARE of the memory budget (see
+     espa_trace.h); the least recently used blocks are dropped first.
+  2. The blocks are RB_CACHE_BLOCK_BYTES of the file, aligned to the start of
+     the file, and are shared by every file descriptor open on the same file
+     (device and inode).  Only plain bands are cached; block-compressed bands
+     and bands with fill regions (see raw_binary_blocks.h and
+     raw_binary_sparse.h) are read as before.
+  3. Writes are written through: they go to the file right away, and update
+     the blocks of the file which are cached.  Blocks aren't added by
+     writes.
+  4. A file written by other means (ex. a FILE * or a writable mapping)
+     changes its modification time, so its cached blocks are dropped the
+     next time the file is opened.  A file descriptor which was already open
+     doesn't notice such writes.
+  5. Reads of more than half of the budget go straight to the file, so a
+     single large read doesn't flush the cache.
+*****************************************************************************/
+
+#ifndef RAW_BINARY_CACHE_H
+#define RAW_BINARY_CACHE_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include "error_handler.h"
+
+/* Defines */
+#define RB_CACHE_MB_ENV "ESPA_BAND_CACHE_MB"  /* memory budget of the cache
+                                     (MB); 0 or unset turns it off */
+#define RB_CACHE_BLOCK_BYTES (1024 * 1024)  /* number of bytes of a file in
+                                     each block */
+#define RB_CACHE_BUCKETS 4096     /* number of hash buckets of the blocks; a
+                                     power of 2 */
+
+/* Prototypes */
+void set_raw_binary_cache_mb
+(
+    int cache_mb         /* I: memory budget of the cache (MB); 0 turns the
+                               cache off and frees its blocks */
+);
+
+int get_raw_binary_cache_mb (void);
+
+int attach_raw_binary_cache
+(
+    int fd,              /* I: file descriptor of the band file */
+    char *infile         /* I: name of the band file, for error messages */
+);
+
+bool is_raw_binary_cached
+(
+    int fd               /* I: file descriptor of the band file */
+);
+
+void detach_raw_binary_cache
+(
+    int fd               /* I: file descriptor of the band file */
+);
+
+int cached_raw_binary_io
+(
+    int fd,             /* I: file descriptor of the band file */
+    bool write_flag,    /* I: write (true) or read (false) */
+    void *buf,          /* I/O: buffer to be written or read into */
+    size_t nbytes,      /* I: number of bytes to transfer */
+    off_t offset        /* I: file offset for the transfer */
+);
+
+void get_raw_binary_cache_stats
+(
+    uint64_t *hits,      /* O: number of blocks found in the cache */
+    uint64_t *misses     /* O: number of blocks read into the cache */
+);
+
+#endif
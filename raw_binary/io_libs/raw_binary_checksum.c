@@ -0,0 +1,296 @@
+/*****************************************************************************
+FILE: raw_binary_checksum.c
+
+PURPOSE: Contains functions for computing the CRC-32C checksums of the bands
+(see raw_binary_checksum.h).
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The kernel is chosen once, when the program is loaded, from the
+     instruction sets of the CPU (see espa_cpu_dispatch.h).  The tables of
+     the scalar kernel are filled at the same time.
+*****************************************************************************/
+
+#include <string.h>
+#include <strings.h>
+#include "raw_binary_checksum.h"
+#include "espa_cpu_dispatch.h"
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define RB_CRC_X86
+#endif
+
+/* Reflected CRC-32C (Castagnoli) polynomial */
+#define RB_CRC32C_POLY 0x82F63B78
+
+/* Kernel updating the running CRC with a block of bytes; returns the new
+   running CRC */
+typedef uint32_t (*Rb_crc_kernel_t)
+(
+    uint32_t crc,             /* I: running CRC */
+    const unsigned char *buf, /* I: bytes to be added */
+    size_t nbytes             /* I: number of bytes in buf */
+);
+
+/* Tables of the scalar kernel; crc_table[k][b] is the CRC of byte b followed
+   by k zero bytes */
+static uint32_t crc_table[8][256];
+
+
+/******************************************************************************
+MODULE: rb_crc_table
+
+PURPOSE: Updates the running CRC using the tables, 8 bytes at a time.
+
+RETURN VALUE:
+Type = uint32_t
+Value        Description
+-----        -----------
+n            New running CRC
+
+NOTES:
+*****************************************************************************/
+static uint32_t rb_crc_table
+(
+    uint32_t crc,             /* I: running CRC */
+    const unsigned char *buf, /* I: bytes to be added */
+    size_t nbytes             /* I: number of bytes in buf */
+)
+{
+    uint32_t lo;              /* first 4 bytes of the word, with the CRC */
+    uint32_t hi;              /* last 4 bytes of the word */
+
+    while (nbytes >= 8)
+    {
+        lo = crc ^ ((uint32_t) buf[0] | (uint32_t) buf[1] << 8 |
+            (uint32_t) buf[2] << 16 | (uint32_t) buf[3] << 24);
+        hi = (uint32_t) buf[4] | (uint32_t) buf[5] << 8 |
+            (uint32_t) buf[6] << 16 | (uint32_t) buf[7] << 24;
+        crc = crc_table[7][lo & 0xff] ^ crc_table[6][(lo >> 8) & 0xff] ^
+            crc_table[5][(lo >> 16) & 0xff] ^ crc_table[4][lo >> 24] ^
+            crc_table[3][hi & 0xff] ^ crc_table[2][(hi >> 8) & 0xff] ^
+            crc_table[1][(hi >> 16) & 0xff] ^ crc_table[0][hi >> 24];
+        buf += 8;
+        nbytes -= 8;
+    }
+
+    while (nbytes-- > 0)
+        crc = crc_table[0][(crc ^ *buf++) & 0xff] ^ (crc >> 8);
+
+    return crc;
+}
+
+
+#ifdef RB_CRC_X86
+/******************************************************************************
+MODULE: rb_crc_sse42
+
+PURPOSE: Updates the running CRC using the CRC32 instruction of SSE4.2, 8
+bytes at a time.
+
+RETURN VALUE:
+Type = uint32_t
+Value        Description
+-----        -----------
+n            New running CRC
+
+NOTES:
+*****************************************************************************/
+__attribute__ ((target ("sse4.2")))
+static uint32_t rb_crc_sse42
+(
+    uint32_t crc,             /* I: running CRC */
+    const unsigned char *buf, /* I: bytes to be added */
+    size_t nbytes             /* I: number of bytes in buf */
+)
+{
+    uint64_t crc64;           /* running CRC of the 8 byte steps */
+    uint64_t word;            /* next 8 bytes */
+
+    /* Align the 8 byte loads */
+    while (nbytes > 0 && ((uintptr_t) buf & 7) != 0)
+    {
+        crc = _mm_crc32_u8 (crc, *buf++);
+        nbytes--;
+    }
+
+    crc64 = crc;
+    while (nbytes >= 8)
+    {
+        memcpy (&word, buf, 8);
+        crc64 = _mm_crc32_u64 (crc64, word);
+        buf += 8;
+        nbytes -= 8;
+    }
+    crc = (uint32_t) crc64;
+
+    while (nbytes-- > 0)
+        crc = _mm_crc32_u8 (crc, *buf++);
+
+    return crc;
+}
+#endif
+
+
+/* Kernel of the checksums, chosen by init_checksum_kernels */
+static Rb_crc_kernel_t rb_crc_kernel = rb_crc_table;
+
+
+/******************************************************************************
+MODULE: init_checksum_kernels
+
+PURPOSE: Fills the tables of the scalar kernel and chooses the kernel
+supported by the CPU.
+
+RETURN VALUE: None
+
+NOTES:
+  1. Run when the program (or shared library) is loaded.
+*****************************************************************************/
+__attribute__ ((constructor))
+static void init_checksum_kernels (void)
+{
+    uint32_t crc;             /* CRC of the current byte */
+    int b;                    /* looping variable for the bytes */
+    int bit;                  /* looping variable for the bits */
+    int k;                    /* looping variable for the tables */
+
+    for (b = 0; b < 256; b++)
+    {
+        crc = b;
+        for (bit = 0; bit < 8; bit++)
+            crc = (crc >> 1) ^ ((crc & 1) ? RB_CRC32C_POLY : 0);
+        crc_table[0][b] = crc;
+    }
+    for (k = 1; k < 8; k++)
+    {
+        for (b = 0; b < 256; b++)
+        {
+            crc = crc_table[k - 1][b];
+            crc_table[k][b] = crc_table[0][crc & 0xff] ^ (crc >> 8);
+        }
+    }
+
+#if defined(RB_CRC_X86)
+    if (espa_cpu_supports (ESPA_CPU_SSE42))
+        rb_crc_kernel = rb_crc_sse42;
+#endif
+}
+
+
+/******************************************************************************
+MODULE: init_raw_binary_checksum
+
+PURPOSE: Starts the checksum of a band.
+
+RETURN VALUE: None
+
+NOTES:
+*****************************************************************************/
+void init_raw_binary_checksum
+(
+    Rb_checksum_t *sum   /* O: checksum to be started */
+)
+{
+    sum->crc = 0xffffffff;
+}
+
+
+/******************************************************************************
+MODULE: update_raw_binary_checksum
+
+PURPOSE: Adds the next bytes of the band to the checksum.
+
+RETURN VALUE: None
+
+NOTES:
+*****************************************************************************/
+void update_raw_binary_checksum
+(
+    Rb_checksum_t *sum,  /* I/O: checksum being computed */
+    const void *buf,     /* I: next bytes of the band */
+    size_t nbytes        /* I: number of bytes in buf */
+)
+{
+    sum->crc = rb_crc_kernel (sum->crc, buf, nbytes);
+}
+
+
+/******************************************************************************
+MODULE: format_raw_binary_checksum
+
+PURPOSE: Formats the checksum of a band for the metadata.
+
+RETURN VALUE: None
+
+NOTES:
+*****************************************************************************/
+void format_raw_binary_checksum
+(
+    const Rb_checksum_t *sum,  /* I: checksum of all the bytes of the band */
+    char *text           /* O: formatted checksum; RB_CHECKSUM_LEN bytes */
+)
+{
+    snprintf (text, RB_CHECKSUM_LEN, "%s%08x", RB_CHECKSUM_PREFIX,
+        (unsigned int) ~sum->crc);
+}
+
+
+/******************************************************************************
+MODULE: known_raw_binary_checksum
+
+PURPOSE: Determines if a checksum from the metadata was computed with the
+algorithm used here, so it can be verified.
+
+RETURN VALUE:
+Type = bool
+Value        Description
+-----        -----------
+true         The checksum can be verified
+false        The checksum is missing or of another algorithm
+
+NOTES:
+*****************************************************************************/
+bool known_raw_binary_checksum
+(
+    const char *text     /* I: checksum from the metadata */
+)
+{
+    return !strncasecmp (text, RB_CHECKSUM_PREFIX,
+        strlen (RB_CHECKSUM_PREFIX)) && strlen (text) == RB_CHECKSUM_LEN - 1;
+}
+
+
+/******************************************************************************
+MODULE: match_raw_binary_checksum
+
+PURPOSE: Compares a computed checksum with the checksum from the metadata.
+
+RETURN VALUE:
+Type = bool
+Value        Description
+-----        -----------
+true         The checksums match
+false        The checksums differ, or the one from the metadata is unknown
+
+NOTES:
+*****************************************************************************/
+bool match_raw_binary_checksum
+(
+    const Rb_checksum_t *sum,  /* I: checksum of all the bytes of the band */
+    const char *text     /* I: checksum from the metadata */
+)
+{
+    char computed[RB_CHECKSUM_LEN];  /* formatted computed checksum */
+
+    if (!known_raw_binary_checksum (text))
+        return false;
+
+    format_raw_binary_checksum (sum, computed);
+    return !strcasecmp (computed, text);
+}
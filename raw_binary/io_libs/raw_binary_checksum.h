@@ -0,0 +1,75 @@
+/*****************************************************************************
+FILE: raw_binary_checksum.h
+
+PURPOSE: Contains defines, structures, and prototypes for the checksums of
+the bands, which are computed as the pixels stream through the writers and
+readers instead of reading the files again.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The checksum is the CRC-32C (Castagnoli) of the pixels of the band, in
+     line order, as they are stored in plain raw binary.  For a band in its
+     own plain raw binary file it is the CRC-32C of the file; a band keeps
+     its checksum when it is stacked or block-compressed.
+  2. It is recorded as the checksum attribute of the band in the XML
+     metadata, as RB_CHECKSUM_PREFIX followed by 8 hex digits.
+  3. The CRC32 instruction of SSE4.2 is used when the CPU has it (see
+     espa_cpu_dispatch.h), and otherwise a table lookup of 8 bytes at a
+     time.
+*****************************************************************************/
+
+#ifndef RAW_BINARY_CHECKSUM_H
+#define RAW_BINARY_CHECKSUM_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "error_handler.h"
+
+/* Defines */
+#define RB_CHECKSUM_PREFIX "crc32c:"  /* algorithm of the checksum */
+#define RB_CHECKSUM_LEN 16            /* size of a formatted checksum,
+                                         including the ending NULL */
+
+/* Checksum being computed */
+typedef struct
+{
+    uint32_t crc;        /* running CRC, before the final inversion */
+} Rb_checksum_t;
+
+/* Prototypes */
+void init_raw_binary_checksum
+(
+    Rb_checksum_t *sum   /* O: checksum to be started */
+);
+
+void update_raw_binary_checksum
+(
+    Rb_checksum_t *sum,  /* I/O: checksum being computed */
+    const void *buf,     /* I: next bytes of the band */
+    size_t nbytes        /* I: number of bytes in buf */
+);
+
+void format_raw_binary_checksum
+(
+    const Rb_checksum_t *sum,  /* I: checksum of all the bytes of the band */
+    char *text           /* O: formatted checksum; RB_CHECKSUM_LEN bytes */
+);
+
+bool known_raw_binary_checksum
+(
+    const char *text     /* I: checksum from the metadata */
+);
+
+bool match_raw_binary_checksum
+(
+    const Rb_checksum_t *sum,  /* I: checksum of all the bytes of the band */
+    const char *text     /* I: checksum from the metadata */
+);
+
+#endif
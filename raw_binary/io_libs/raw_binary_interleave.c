@@ -0,0 +1,721 @@
+/*****************************************************************************
+FILE: raw_binary_interleave.c
+
+PURPOSE: Contains functions for interleaving blocks of band sequential raw
+binary values by pixel, and for splitting blocks of pixel interleaved values
+back into bands.  Each kernel transposes as many whole vectors of pixels as
+fit in the tile and returns the number of pixels handled, leaving the
+remainder to the scalar loop.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The kernels are chosen once, when the program is loaded, from the
+     instruction sets of the CPU (see espa_cpu_dispatch.h).
+  2. Both directions share the transpose of a square matrix of values held
+     in vectors, since interleaving is the transpose of a group of bands by
+     a vector of pixels, and splitting is the transpose back.
+*****************************************************************************/
+
+#include <stdint.h>
+#include "raw_binary_interleave.h"
+#include "espa_cpu_dispatch.h"
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#define RB_INTERLEAVE_X86
+#endif
+
+/* Number of pixels interleaved at a time.  The output tile for 16 bands of
+   4-byte values is 16 KB, which stays in the L1 cache. */
+#define IL_TILE_PIXELS 256
+
+/* Kernel interleaving the whole vectors of pixels of a tile; returns the
+   number of pixels interleaved */
+typedef size_t (*Rb_interleave_kernel_t)
+(
+    unsigned char **band,  /* I: first value of the tile for each band */
+    int nbands,            /* I: number of bands */
+    size_t npix,           /* I: number of pixels in the tile */
+    int size,              /* I: number of bytes per value (1, 2, 4, or 8) */
+    unsigned char *out     /* O: interleaved pixels of the tile */
+);
+
+/* Kernel splitting the whole vectors of pixels of a tile into bands; returns
+   the number of pixels split */
+typedef size_t (*Rb_deinterleave_kernel_t)
+(
+    const unsigned char *in,  /* I: interleaved pixels of the tile */
+    int nbands,            /* I: number of bands */
+    size_t npix,           /* I: number of pixels in the tile */
+    int size,              /* I: number of bytes per value (1, 2, 4, or 8) */
+    unsigned char **band   /* O: first value of the tile for each band */
+);
+
+#ifdef RB_INTERLEAVE_X86
+/******************************************************************************
+MODULE: rb_transpose_sse2
+
+PURPOSE: Transposes, in place, the square matrix of values held one row per
+vector (16 / size rows of 16 / size values).
+
+RETURN VALUE: None
+
+NOTES:
+  1. Each of the log2(16 / size) rounds unpacks row k with row k + half into
+     rows 2k and 2k+1, which after the last round leaves column k in row k.
+  2. The transpose and the kernels below are always inlined into a copy for
+     each constant size, and their loops over the rounds and rows are
+     unrolled, so the rows stay in registers rather than arrays on the
+     stack.
+*****************************************************************************/
+static inline __attribute__ ((always_inline)) void rb_transpose_sse2
+(
+    __m128i *r,            /* I/O: rows of the matrix */
+    int size               /* I: number of bytes per value (1, 2, 4, or 8) */
+)
+{
+    int lanes = 16 / size; /* number of rows and of values per row */
+    int half = lanes / 2;  /* number of row pairs */
+    int round;             /* looping variable for the rounds */
+    int k;                 /* looping variable for the row pairs */
+    __m128i t[16];         /* rows after the current round */
+
+#pragma GCC unroll 4
+    for (round = 1; round < lanes; round *= 2)
+    {
+        switch (size)
+        {
+            case 8:
+                t[0] = _mm_unpacklo_epi64 (r[0], r[1]);
+                t[1] = _mm_unpackhi_epi64 (r[0], r[1]);
+                break;
+            case 4:
+#pragma GCC unroll 8
+                for (k = 0; k < half; k++)
+                {
+                    t[2*k] = _mm_unpacklo_epi32 (r[k], r[k+half]);
+                    t[2*k+1] = _mm_unpackhi_epi32 (r[k], r[k+half]);
+                }
+                break;
+            case 2:
+#pragma GCC unroll 8
+                for (k = 0; k < half; k++)
+                {
+                    t[2*k] = _mm_unpacklo_epi16 (r[k], r[k+half]);
+                    t[2*k+1] = _mm_unpackhi_epi16 (r[k], r[k+half]);
+                }
+                break;
+            default:
+#pragma GCC unroll 8
+                for (k = 0; k < half; k++)
+                {
+                    t[2*k] = _mm_unpacklo_epi8 (r[k], r[k+half]);
+                    t[2*k+1] = _mm_unpackhi_epi8 (r[k], r[k+half]);
+                }
+                break;
+        }
+#pragma GCC unroll 16
+        for (k = 0; k < lanes; k++)
+            r[k] = t[k];
+    }
+}
+
+
+/******************************************************************************
+MODULE: rb_group_sse2
+
+PURPOSE: Finds the number of bands transposed together with a vector of
+pixels.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+0            The number of bands doesn't suit the vectors
+group        Number of bands in each group
+
+NOTES:
+  1. 1-byte values go in groups of 8 bands when the number of bands isn't a
+     multiple of 16, each group filling half a vector per pixel.
+*****************************************************************************/
+static inline __attribute__ ((always_inline)) int rb_group_sse2
+(
+    int nbands,            /* I: number of bands */
+    int size               /* I: number of bytes per value (1, 2, 4, or 8) */
+)
+{
+    int group = 16 / size; /* number of bands transposed together */
+
+    if (size == 1 && nbands % 16 != 0)
+        group = 8;
+    if (nbands % group != 0)
+        return 0;
+
+    return group;
+}
+
+
+/******************************************************************************
+MODULE: rb_interleave_sse2_size
+
+PURPOSE: Interleaves a tile of pixels by transposing groups of bands with
+SSE2 unpack instructions.  Each group fills a 16-byte vector per pixel (8
+bytes for 1-byte values in groups of 8 bands).
+
+RETURN VALUE:
+Type = size_t
+Value        Description
+-----        -----------
+n            Number of pixels interleaved; 0 if the number of bands doesn't
+             suit the vectors
+
+NOTES:
+  1. A group of 8 bands of 1-byte values is transposed as 16 rows with the
+     last 8 zero, and only the first half of each transposed row is stored.
+*****************************************************************************/
+static inline __attribute__ ((always_inline)) size_t rb_interleave_sse2_size
+(
+    unsigned char **band,  /* I: first value of the tile for each band */
+    int nbands,            /* I: number of bands */
+    size_t npix,           /* I: number of pixels in the tile */
+    int size,              /* I: number of bytes per value (1, 2, 4, or 8) */
+    unsigned char *out     /* O: interleaved pixels of the tile */
+)
+{
+    int lanes = 16 / size; /* number of values per vector */
+    int group;             /* number of bands transposed together */
+    int g;                 /* first band of the current group */
+    int k;                 /* looping variable for the vectors */
+    size_t p;              /* first pixel of the current vectors */
+    size_t pix_bytes = (size_t) nbands * size;  /* bytes per output pixel */
+    unsigned char *dest;   /* first output byte of the group */
+    __m128i r[16];         /* one vector of pixels for each band */
+
+    group = rb_group_sse2 (nbands, size);
+    if (group == 0)
+        return 0;
+
+    for (p = 0; p + lanes <= npix; p += lanes)
+    {
+        for (g = 0; g < nbands; g += group)
+        {
+#pragma GCC unroll 16
+            for (k = 0; k < group; k++)
+                r[k] = _mm_loadu_si128 ((const __m128i *)
+                    (band[g + k] + p * size));
+#pragma GCC unroll 16
+            for ( ; k < lanes; k++)
+                r[k] = _mm_setzero_si128 ();
+
+            /* Row k now holds the bands of pixel p + k */
+            rb_transpose_sse2 (r, size);
+
+            dest = out + p * pix_bytes + (size_t) g * size;
+#pragma GCC unroll 16
+            for (k = 0; k < lanes; k++)
+            {
+                if (group == lanes)
+                    _mm_storeu_si128 ((__m128i *) (dest + k * pix_bytes),
+                        r[k]);
+                else
+                    _mm_storel_epi64 ((__m128i *) (dest + k * pix_bytes),
+                        r[k]);
+            }
+        }
+    }
+
+    return p;
+}
+
+
+/******************************************************************************
+MODULE: rb_deinterleave_sse2_size
+
+PURPOSE: Splits a tile of interleaved pixels into bands by transposing
+groups of bands with SSE2 unpack instructions, the inverse of
+rb_interleave_sse2.
+
+RETURN VALUE:
+Type = size_t
+Value        Description
+-----        -----------
+n            Number of pixels split; 0 if the number of bands doesn't suit
+             the vectors
+
+NOTES:
+  1. A group of 8 bands of 1-byte values is loaded as half a vector per
+     pixel, and only the first 8 transposed rows are stored.
+*****************************************************************************/
+static inline __attribute__ ((always_inline)) size_t rb_deinterleave_sse2_size
+(
+    const unsigned char *in,  /* I: interleaved pixels of the tile */
+    int nbands,            /* I: number of bands */
+    size_t npix,           /* I: number of pixels in the tile */
+    int size,              /* I: number of bytes per value (1, 2, 4, or 8) */
+    unsigned char **band   /* O: first value of the tile for each band */
+)
+{
+    int lanes = 16 / size; /* number of values per vector */
+    int group;             /* number of bands transposed together */
+    int g;                 /* first band of the current group */
+    int k;                 /* looping variable for the vectors */
+    size_t p;              /* first pixel of the current vectors */
+    size_t pix_bytes = (size_t) nbands * size;  /* bytes per input pixel */
+    const unsigned char *src;  /* first input byte of the group */
+    __m128i r[16];         /* one vector of bands for each pixel */
+
+    group = rb_group_sse2 (nbands, size);
+    if (group == 0)
+        return 0;
+
+    for (p = 0; p + lanes <= npix; p += lanes)
+    {
+        for (g = 0; g < nbands; g += group)
+        {
+            src = in + p * pix_bytes + (size_t) g * size;
+#pragma GCC unroll 16
+            for (k = 0; k < lanes; k++)
+            {
+                if (group == lanes)
+                    r[k] = _mm_loadu_si128 ((const __m128i *)
+                        (src + k * pix_bytes));
+                else
+                    r[k] = _mm_loadl_epi64 ((const __m128i *)
+                        (src + k * pix_bytes));
+            }
+
+            /* Row k now holds the pixels of band g + k */
+            rb_transpose_sse2 (r, size);
+
+#pragma GCC unroll 16
+            for (k = 0; k < group; k++)
+                _mm_storeu_si128 ((__m128i *) (band[g + k] + p * size),
+                    r[k]);
+        }
+    }
+
+    return p;
+}
+
+
+/******************************************************************************
+MODULE: rb_interleave_sse2
+
+PURPOSE: Interleaves a tile of pixels with the copy of rb_interleave_sse2_size
+for the size of the values.
+
+RETURN VALUE:
+Type = size_t
+Value        Description
+-----        -----------
+n            Number of pixels interleaved
+
+NOTES:
+*****************************************************************************/
+static size_t rb_interleave_sse2
+(
+    unsigned char **band,  /* I: first value of the tile for each band */
+    int nbands,            /* I: number of bands */
+    size_t npix,           /* I: number of pixels in the tile */
+    int size,              /* I: number of bytes per value (1, 2, 4, or 8) */
+    unsigned char *out     /* O: interleaved pixels of the tile */
+)
+{
+    switch (size)
+    {
+        case 1:
+            return rb_interleave_sse2_size (band, nbands, npix, 1, out);
+        case 2:
+            return rb_interleave_sse2_size (band, nbands, npix, 2, out);
+        case 4:
+            return rb_interleave_sse2_size (band, nbands, npix, 4, out);
+        default:
+            return rb_interleave_sse2_size (band, nbands, npix, 8, out);
+    }
+}
+
+
+/******************************************************************************
+MODULE: rb_deinterleave_sse2
+
+PURPOSE: Splits a tile of interleaved pixels into bands with the copy of
+rb_deinterleave_sse2_size for the size of the values.
+
+RETURN VALUE:
+Type = size_t
+Value        Description
+-----        -----------
+n            Number of pixels split
+
+NOTES:
+*****************************************************************************/
+static size_t rb_deinterleave_sse2
+(
+    const unsigned char *in,  /* I: interleaved pixels of the tile */
+    int nbands,            /* I: number of bands */
+    size_t npix,           /* I: number of pixels in the tile */
+    int size,              /* I: number of bytes per value (1, 2, 4, or 8) */
+    unsigned char **band   /* O: first value of the tile for each band */
+)
+{
+    switch (size)
+    {
+        case 1:
+            return rb_deinterleave_sse2_size (in, nbands, npix, 1, band);
+        case 2:
+            return rb_deinterleave_sse2_size (in, nbands, npix, 2, band);
+        case 4:
+            return rb_deinterleave_sse2_size (in, nbands, npix, 4, band);
+        default:
+            return rb_deinterleave_sse2_size (in, nbands, npix, 8, band);
+    }
+}
+#endif
+
+
+/******************************************************************************
+MODULE: rb_interleave_none
+
+PURPOSE: Kernel of the CPUs without vector instructions, which leaves the
+whole tile to the scalar loop.
+
+RETURN VALUE:
+Type = size_t
+Value        Description
+-----        -----------
+0            No pixels interleaved
+
+NOTES:
+*****************************************************************************/
+static size_t rb_interleave_none
+(
+    unsigned char **band,  /* I: first value of the tile for each band
+                                 (unused) */
+    int nbands,            /* I: number of bands (unused) */
+    size_t npix,           /* I: number of pixels in the tile (unused) */
+    int size,              /* I: number of bytes per value (unused) */
+    unsigned char *out     /* O: interleaved pixels of the tile (unused) */
+)
+{
+    return 0;
+}
+
+
+/******************************************************************************
+MODULE: rb_deinterleave_none
+
+PURPOSE: Kernel of the CPUs without vector instructions, which leaves the
+whole tile to the scalar loop.
+
+RETURN VALUE:
+Type = size_t
+Value        Description
+-----        -----------
+0            No pixels split
+
+NOTES:
+*****************************************************************************/
+static size_t rb_deinterleave_none
+(
+    const unsigned char *in,  /* I: interleaved pixels of the tile
+                                    (unused) */
+    int nbands,            /* I: number of bands (unused) */
+    size_t npix,           /* I: number of pixels in the tile (unused) */
+    int size,              /* I: number of bytes per value (unused) */
+    unsigned char **band   /* O: first value of the tile for each band
+                                 (unused) */
+)
+{
+    return 0;
+}
+
+
+/* Kernels of the tile interleave and split, chosen by
+   init_interleave_kernels */
+static Rb_interleave_kernel_t rb_interleave_kernel = rb_interleave_none;
+static Rb_deinterleave_kernel_t rb_deinterleave_kernel = rb_deinterleave_none;
+
+
+/******************************************************************************
+MODULE: init_interleave_kernels
+
+PURPOSE: Chooses the widest interleave and split kernels supported by the
+CPU.
+
+RETURN VALUE: None
+
+NOTES:
+  1. Run when the program (or shared library) is loaded.
+*****************************************************************************/
+__attribute__ ((constructor))
+static void init_interleave_kernels (void)
+{
+#ifdef RB_INTERLEAVE_X86
+    if (espa_cpu_supports (ESPA_CPU_SSE2))
+    {
+        rb_interleave_kernel = rb_interleave_sse2;
+        rb_deinterleave_kernel = rb_deinterleave_sse2;
+    }
+#endif
+}
+
+
+/******************************************************************************
+MODULE: rb_interleave_scalar
+
+PURPOSE: Interleaves a tile of pixels one value at a time.
+
+RETURN VALUE: None
+
+NOTES:
+*****************************************************************************/
+static void rb_interleave_scalar
+(
+    unsigned char **band,  /* I: first value of the tile for each band */
+    int nbands,            /* I: number of bands */
+    size_t p0,             /* I: first pixel to be interleaved */
+    size_t npix,           /* I: number of pixels in the tile */
+    int size,              /* I: number of bytes per value (1, 2, 4, or 8) */
+    unsigned char *out     /* O: interleaved pixels of the tile */
+)
+{
+    int i;                 /* looping variable for the bands */
+    size_t p;              /* looping variable for the pixels */
+
+    for (i = 0; i < nbands; i++)
+    {
+        switch (size)
+        {
+            case 1:
+                for (p = p0; p < npix; p++)
+                    out[p * nbands + i] = band[i][p];
+                break;
+            case 2:
+                for (p = p0; p < npix; p++)
+                    ((uint16_t *) out)[p * nbands + i] =
+                        ((uint16_t *) band[i])[p];
+                break;
+            case 4:
+                for (p = p0; p < npix; p++)
+                    ((uint32_t *) out)[p * nbands + i] =
+                        ((uint32_t *) band[i])[p];
+                break;
+            default:
+                for (p = p0; p < npix; p++)
+                    ((uint64_t *) out)[p * nbands + i] =
+                        ((uint64_t *) band[i])[p];
+                break;
+        }
+    }
+}
+
+
+/******************************************************************************
+MODULE: rb_deinterleave_scalar
+
+PURPOSE: Splits a tile of interleaved pixels into bands one value at a time.
+
+RETURN VALUE: None
+
+NOTES:
+*****************************************************************************/
+static void rb_deinterleave_scalar
+(
+    const unsigned char *in,  /* I: interleaved pixels of the tile */
+    int nbands,            /* I: number of bands */
+    size_t p0,             /* I: first pixel to be split */
+    size_t npix,           /* I: number of pixels in the tile */
+    int size,              /* I: number of bytes per value (1, 2, 4, or 8) */
+    unsigned char **band   /* O: first value of the tile for each band */
+)
+{
+    int i;                 /* looping variable for the bands */
+    size_t p;              /* looping variable for the pixels */
+
+    for (i = 0; i < nbands; i++)
+    {
+        switch (size)
+        {
+            case 1:
+                for (p = p0; p < npix; p++)
+                    band[i][p] = in[p * nbands + i];
+                break;
+            case 2:
+                for (p = p0; p < npix; p++)
+                    ((uint16_t *) band[i])[p] =
+                        ((const uint16_t *) in)[p * nbands + i];
+                break;
+            case 4:
+                for (p = p0; p < npix; p++)
+                    ((uint32_t *) band[i])[p] =
+                        ((const uint32_t *) in)[p * nbands + i];
+                break;
+            default:
+                for (p = p0; p < npix; p++)
+                    ((uint64_t *) band[i])[p] =
+                        ((const uint64_t *) in)[p * nbands + i];
+                break;
+        }
+    }
+}
+
+
+/******************************************************************************
+MODULE: interleave_raw_binary_bands
+
+PURPOSE: Interleaves a block of band sequential values by pixel, so the
+values of all the bands for each pixel are together (BIP).
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Unsupported number of bytes per value, or error allocating
+             memory
+SUCCESS      Successful interleave
+
+NOTES:
+  1. The output is identical to copying value s of band i to value
+     s * nbands + i of out_buf.
+  2. The block is processed in tiles of IL_TILE_PIXELS pixels, so it is
+     intended to be called on a block of lines at a time as the data is
+     streamed out.
+*****************************************************************************/
+int interleave_raw_binary_bands
+(
+    void **band_buf,     /* I: first value of each band; each band holds nvals
+                               consecutive values */
+    int nbands,          /* I: number of bands */
+    size_t nvals,        /* I: number of values in each band */
+    int size,            /* I: number of bytes per value (1, 2, 4, or 8) */
+    void *out_buf        /* O: nvals * nbands values, with the nbands values
+                               of each pixel together */
+)
+{
+    char FUNC_NAME[] = "interleave_raw_binary_bands"; /* function name */
+    char errmsg[STR_SIZE];       /* error message */
+    int i;                       /* looping variable for the bands */
+    size_t p0;                   /* first pixel of the current tile */
+    size_t npix;                 /* number of pixels in the current tile */
+    size_t done;                 /* number of pixels of the tile interleaved
+                                    by the kernels */
+    unsigned char **band = NULL; /* first value of the tile for each band */
+    unsigned char *out;          /* first output value of the tile */
+
+    if (size != 1 && size != 2 && size != 4 && size != 8)
+    {
+        sprintf (errmsg, "Unsupported number of bytes per value for "
+            "interleaving: %d", size);
+        error_handler (true, FUNC_NAME, errmsg);
+        return ERROR;
+    }
+
+    band = malloc (nbands * sizeof (unsigned char *));
+    if (band == NULL)
+    {
+        sprintf (errmsg, "Allocating the tile pointers for %d bands",
+            nbands);
+        error_handler (true, FUNC_NAME, errmsg);
+        return ERROR;
+    }
+
+    for (p0 = 0; p0 < nvals; p0 += IL_TILE_PIXELS)
+    {
+        npix = nvals - p0;
+        if (npix > IL_TILE_PIXELS)
+            npix = IL_TILE_PIXELS;
+        for (i = 0; i < nbands; i++)
+            band[i] = (unsigned char *) band_buf[i] + p0 * size;
+        out = (unsigned char *) out_buf + p0 * nbands * size;
+
+        done = rb_interleave_kernel (band, nbands, npix, size, out);
+
+        /* Interleave the rest of the tile one value at a time */
+        rb_interleave_scalar (band, nbands, done, npix, size, out);
+    }
+
+    free (band);
+    return SUCCESS;
+}
+
+
+/******************************************************************************
+MODULE: deinterleave_raw_binary_bands
+
+PURPOSE: Splits a block of values interleaved by pixel (BIP) into band
+sequential values, the inverse of interleave_raw_binary_bands.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Unsupported number of bytes per value, or error allocating
+             memory
+SUCCESS      Successful split
+
+NOTES:
+  1. The output is identical to copying value s * nbands + i of in_buf to
+     value s of band i.
+  2. The block is processed in tiles of IL_TILE_PIXELS pixels, as for
+     interleave_raw_binary_bands.
+*****************************************************************************/
+int deinterleave_raw_binary_bands
+(
+    const void *in_buf,  /* I: nvals * nbands values, with the nbands values
+                               of each pixel together */
+    int nbands,          /* I: number of bands */
+    size_t nvals,        /* I: number of values in each band */
+    int size,            /* I: number of bytes per value (1, 2, 4, or 8) */
+    void **band_buf      /* O: first value of each band; each band receives
+                               nvals consecutive values */
+)
+{
+    char FUNC_NAME[] = "deinterleave_raw_binary_bands"; /* function name */
+    char errmsg[STR_SIZE];       /* error message */
+    int i;                       /* looping variable for the bands */
+    size_t p0;                   /* first pixel of the current tile */
+    size_t npix;                 /* number of pixels in the current tile */
+    size_t done;                 /* number of pixels of the tile split by
+                                    the kernels */
+    unsigned char **band = NULL; /* first value of the tile for each band */
+    const unsigned char *in;     /* first input value of the tile */
+
+    if (size != 1 && size != 2 && size != 4 && size != 8)
+    {
+        sprintf (errmsg, "Unsupported number of bytes per value for "
+            "deinterleaving: %d", size);
+        error_handler (true, FUNC_NAME, errmsg);
+        return ERROR;
+    }
+
+    band = malloc (nbands * sizeof (unsigned char *));
+    if (band == NULL)
+    {
+        sprintf (errmsg, "Allocating the tile pointers for %d bands",
+            nbands);
+        error_handler (true, FUNC_NAME, errmsg);
+        return ERROR;
+    }
+
+    for (p0 = 0; p0 < nvals; p0 += IL_TILE_PIXELS)
+    {
+        npix = nvals - p0;
+        if (npix > IL_TILE_PIXELS)
+            npix = IL_TILE_PIXELS;
+        for (i = 0; i < nbands; i++)
+            band[i] = (unsigned char *) band_buf[i] + p0 * size;
+        in = (const unsigned char *) in_buf + p0 * nbands * size;
+
+        done = rb_deinterleave_kernel (in, nbands, npix, size, band);
+
+        /* Split the rest of the tile one value at a time */
+        rb_deinterleave_scalar (in, nbands, done, npix, size, band);
+    }
+
+    free (band);
+    return SUCCESS;
+}
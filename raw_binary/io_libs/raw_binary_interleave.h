@@ -0,0 +1,54 @@
+/*****************************************************************************
+FILE: raw_binary_interleave.h
+
+PURPOSE: Contains prototypes for the interleave stage, which converts blocks
+of band sequential raw binary values to band interleaved by pixel (BIP), and
+for its inverse, which splits blocks of BIP values back into bands.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The block is transposed a tile of pixels at a time so the output tile
+     stays in cache while every band is scattered into it.
+  2. Within a tile, groups of bands are transposed with SSE2 shuffles when
+     the number of bands suits the size of the values (a multiple of 8 bands
+     for 1 and 2-byte values, 4 bands for 4-byte values, and 2 bands for
+     8-byte values).  Everything else uses a scalar loop.  Splitting uses
+     the same transposes in reverse.
+*****************************************************************************/
+
+#ifndef RAW_BINARY_INTERLEAVE_H
+#define RAW_BINARY_INTERLEAVE_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "error_handler.h"
+
+/* Prototypes */
+int interleave_raw_binary_bands
+(
+    void **band_buf,     /* I: first value of each band; each band holds nvals
+                               consecutive values */
+    int nbands,          /* I: number of bands */
+    size_t nvals,        /* I: number of values in each band */
+    int size,            /* I: number of bytes per value (1, 2, 4, or 8) */
+    void *out_buf        /* O: nvals * nbands values, with the nbands values
+                               of each pixel together */
+);
+
+int deinterleave_raw_binary_bands
+(
+    const void *in_buf,  /* I: nvals * nbands values, with the nbands values
+                               of each pixel together */
+    int nbands,          /* I: number of bands */
+    size_t nvals,        /* I: number of values in each band */
+    int size,            /* I: number of bytes per value (1, 2, 4, or 8) */
+    void **band_buf      /* O: first value of each band; each band receives
+                               nvals consecutive values */
+);
+
+#endif
@@ -12,7 +12,28 @@ LICENSE TYPE:  NASA Open Source Agreement Version 1.3
 NOTES:
 *****************************************************************************/
 
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE     /* for O_DIRECT */
+#endif
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <stdint.h>
 #include "raw_binary_io.h"
+#include "raw_binary_blocks.h"
+#include "raw_binary_sparse.h"
+#include "raw_binary_cache.h"
+#include "espa_staging.h"
+#include "raw_binary_advise.h"
+#include "espa_trace.h"
+
+/* copy_file_range came with glibc 2.27 */
+#if defined (__GLIBC__) && (__GLIBC__ > 2 || \
+    (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 27))
+#define RB_COPY_FILE_RANGE
+#endif
 
 /* define the read/write formats to be used for opening a file */
 typedef enum {
@@ -22,6 +43,44 @@ typedef enum {
 } Raw_binary_format_t;
 const char raw_binary_format[][4] = {"rb", "wb", "rb+"};
 
+/* Byte offsets of the bands in the files opened by open_raw_binary_band_fd,
+   indexed by the file descriptor; files which hold a single band have no
+   entry or an offset of 0 */
+static pthread_mutex_t rb_offset_mutex = PTHREAD_MUTEX_INITIALIZER;
+static off_t *rb_offset_by_fd = NULL;
+static int rb_offset_nfds = 0;
+
+/******************************************************************************
+MODULE: rb_close_staged
+
+PURPOSE: Closes a file descriptor, ending its write of a staged file (see
+espa_staging.h) once it is closed.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error closing the file
+SUCCESS      Successfully closed the file
+
+NOTES:
+*****************************************************************************/
+static int rb_close_staged
+(
+    int fd               /* I: file descriptor to be closed */
+)
+{
+    Espa_staged_file_t *staged = espa_staging_detach (fd);
+                             /* staged file written through fd */
+    int status;              /* status of the close */
+
+    status = close (fd) == 0 ? SUCCESS : ERROR;
+    espa_staging_release (staged);
+
+    return status;
+}
+
+
 /******************************************************************************
 MODULE: open_raw_binary
 
@@ -35,6 +94,13 @@ NULL         Error opening the specified file for read specified access
 non-NULL     FILE pointer to the opened file
 
 NOTES:
+  1. Block-compressed bands (see raw_binary_blocks.h) can't be read
+     sequentially through a FILE pointer, so opening one for reading is an
+     error.  They are read through open_raw_binary_fd and the window reads.
+  2. With staging on (see espa_staging.h), files opened for writing are
+     written to the staging directory and flushed once they are closed.
+  3. Files opened for reading are read sequentially, so they are advised as
+     such (see raw_binary_advise.h).
 *****************************************************************************/
 FILE *open_raw_binary
 (
@@ -46,18 +112,48 @@ FILE *open_raw_binary
 {
     char FUNC_NAME[] = "open_raw_binary"; /* function name */
     char errmsg[STR_SIZE];   /* error message */
+    char path[STR_SIZE];     /* name the file is opened under */
     FILE *rb_fptr = NULL;    /* pointer to the raw binary file */
+    double start_time;       /* start of the open for the I/O accounting */
+    Espa_stage_access_t stage_access;  /* access for staging the file */
 
     /* Open the file with the specified access type */
-    rb_fptr = fopen (infile, access_type);
+    start_time = espa_io_stats_clock ();
+    if (access_type[0] == 'w')
+        stage_access = ESPA_STAGE_CREATE;
+    else if (access_type[0] == 'a' || strchr (access_type, '+') != NULL)
+        stage_access = ESPA_STAGE_UPDATE;
+    else
+        stage_access = ESPA_STAGE_READ;
+    if (espa_staging_path (infile, stage_access, path, sizeof (path)) !=
+        SUCCESS)
+        return NULL;
+    rb_fptr = fopen (path, access_type);
     if (rb_fptr == NULL)
     {
         sprintf (errmsg, "Opening raw binary file %s with %s access.",
             infile, access_type);
         error_handler (true, FUNC_NAME, errmsg);
+        if (stage_access != ESPA_STAGE_READ)
+            espa_staging_done (infile);
+        return NULL;
+    }
+    if (stage_access != ESPA_STAGE_READ)
+        espa_staging_attach (fileno (rb_fptr), infile);
+    else
+        advise_raw_binary_fd (fileno (rb_fptr), 0, 0, RB_ADVISE_SEQUENTIAL);
+
+    if (access_type[0] == 'r' && is_raw_binary_blocks (fileno (rb_fptr)))
+    {
+        sprintf (errmsg, "Raw binary file %s is block-compressed and can "
+            "only be read by window.", infile);
+        error_handler (true, FUNC_NAME, errmsg);
+        fclose (rb_fptr);
         return NULL;
     }
 
+    espa_io_stats_open (rb_fptr, infile, ESPA_IO_RAW_BINARY, start_time);
+
     /* Return the file pointer */
     return rb_fptr;
 }
@@ -78,7 +174,14 @@ void close_raw_binary
     FILE *fptr      /* I: pointer to raw binary file to be closed */
 )
 {
+    double start_time;       /* start of the close for the I/O accounting */
+    Espa_staged_file_t *staged = espa_staging_detach (fileno (fptr));
+                             /* staged file written through fptr */
+
+    start_time = espa_io_stats_clock ();
     fclose (fptr);
+    espa_io_stats_record (fptr, ESPA_IO_CLOSE, 0, start_time);
+    espa_staging_release (staged);
 }
 
 
@@ -108,15 +211,21 @@ int write_raw_binary
 {
     char FUNC_NAME[] = "write_raw_binary"; /* function name */
     char errmsg[STR_SIZE];   /* error message */
-    long nvals;              /* number of values written to the file */
+    size_t nelems;           /* number of values to be written to the file */
+    size_t nvals;            /* number of values written to the file */
+    double start_time;       /* start of the write for the I/O accounting */
 
-    /* Write the data to the raw binary file */
-    nvals = fwrite (img_array, size, nlines * nsamps, rb_fptr);
-    if (nvals != nlines * nsamps)
+    /* Write the data to the raw binary file.  Compute the element count in
+       64-bits so very large bands can be written in a single call. */
+    nelems = (size_t) nlines * nsamps;
+    start_time = espa_io_stats_clock ();
+    nvals = fwrite (img_array, size, nelems, rb_fptr);
+    espa_io_stats_record (rb_fptr, ESPA_IO_WRITE, nvals * size, start_time);
+    if (nvals != nelems)
     {
-        sprintf (errmsg, "Writing %d elements of %d bytes in size to the "
-            "raw binary file. Actually wrote %ld elements.", nlines * nsamps,
-            size, nvals);
+        sprintf (errmsg, "Writing %zu elements of %d bytes in size to the "
+            "raw binary file. Actually wrote %zu elements.", nelems, size,
+            nvals);
         error_handler (true, FUNC_NAME, errmsg);
         return ERROR;
     }
@@ -152,19 +261,1801 @@ int read_raw_binary
 {
     char FUNC_NAME[] = "read_raw_binary"; /* function name */
     char errmsg[STR_SIZE];   /* error message */
-    long nvals;              /* number of values read from the file */
+    size_t nelems;           /* number of values to be read from the file */
+    size_t nvals;            /* number of values read from the file */
+    double start_time;       /* start of the read for the I/O accounting */
+
+    /* Read the data from the raw binary file.  Compute the element count in
+       64-bits so very large bands can be read in a single call. */
+    nelems = (size_t) nlines * nsamps;
+    start_time = espa_io_stats_clock ();
+    nvals = fread (img_array, size, nelems, rb_fptr);
+    espa_io_stats_record (rb_fptr, ESPA_IO_READ, nvals * size, start_time);
+    if (nvals != nelems)
+    {
+        sprintf (errmsg, "Reading %zu elements of %d bytes in size from the "
+            "raw binary file. Actually read %zu elements.", nelems, size,
+            nvals);
+        error_handler (true, FUNC_NAME, errmsg);
+        return ERROR;
+    }
+
+    return SUCCESS;
+}
+
+
+
+/******************************************************************************
+MODULE: open_raw_binary_fd
+
+PURPOSE: Opens a raw binary file for positional (pread/pwrite) access.
+ 
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error opening the specified file for the specified access
+>= 0         File descriptor of the opened file
+
+NOTES:
+  1. Files opened for writing are created if they don't already exist, but
+     are not truncated, so disjoint windows may be written in any order.
+  2. The file descriptor carries no shared file position for the window
+     routines, so it may be used by multiple threads at the same time as long
+     as they access disjoint windows.
+  3. A block-compressed band (see raw_binary_blocks.h) gets a reader attached
+     to the file descriptor, so the window reads decompress it transparently.
+     Such bands can only be opened read-only, since their windows can't be
+     rewritten in place.
+  4. A plain band opened read-only gets its fill regions (see
+     raw_binary_sparse.h) attached to the file descriptor, if it has any,
+     so the window reads fill them in instead of reading them.
+  5. Any other plain band is attached to the band cache (see
+     raw_binary_cache.h) when the cache is on, so its windows are read from
+     memory once they have been read.
+  6. With staging on (see espa_staging.h), files opened for read/write are
+     written in the staging directory and flushed once they are closed.
+*****************************************************************************/
+int open_raw_binary_fd
+(
+    char *infile,        /* I: name of the input file to be opened */
+    bool writable        /* I: open for read/write (true) or read-only
+                               (false) access */
+)
+{
+    char FUNC_NAME[] = "open_raw_binary_fd"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    char path[STR_SIZE];     /* name the file is opened under */
+    int fd;                  /* file descriptor of the raw binary file */
+    double start_time;       /* start of the open for the I/O accounting */
+
+    start_time = espa_io_stats_clock ();
+    if (espa_staging_path (infile, writable ? ESPA_STAGE_UPDATE :
+        ESPA_STAGE_READ, path, sizeof (path)) != SUCCESS)
+        return ERROR;
+    if (writable)
+        fd = open (path, O_RDWR | O_CREAT, 0644);
+    else
+        fd = open (path, O_RDONLY);
+    if (fd == -1)
+    {
+        sprintf (errmsg, "Opening raw binary file %s with %s access.",
+            infile, writable ? "read/write" : "read");
+        error_handler (true, FUNC_NAME, errmsg);
+        if (writable)
+            espa_staging_done (infile);
+        return ERROR;
+    }
+    if (writable)
+        espa_staging_attach (fd, infile);
+
+    if (attach_raw_binary_blocks (fd, infile) != SUCCESS)
+    {
+        sprintf (errmsg, "Opening block-compressed raw binary file %s",
+            infile);
+        error_handler (true, FUNC_NAME, errmsg);
+        rb_close_staged (fd);
+        return ERROR;
+    }
+    if (writable && get_raw_binary_blocks (fd) != NULL)
+    {
+        sprintf (errmsg, "Block-compressed raw binary file %s can't be "
+            "opened for read/write access.", infile);
+        error_handler (true, FUNC_NAME, errmsg);
+        close_raw_binary_fd (fd);
+        return ERROR;
+    }
+
+    if (!writable && get_raw_binary_blocks (fd) == NULL &&
+        attach_raw_binary_sparse (fd, path) != SUCCESS)
+    {
+        sprintf (errmsg, "Opening raw binary file %s", infile);
+        error_handler (true, FUNC_NAME, errmsg);
+        close_raw_binary_fd (fd);
+        return ERROR;
+    }
+
+    if (get_raw_binary_blocks (fd) == NULL &&
+        get_raw_binary_sparse (fd) == NULL &&
+        attach_raw_binary_cache (fd, infile) != SUCCESS)
+    {
+        sprintf (errmsg, "Opening raw binary file %s", infile);
+        error_handler (true, FUNC_NAME, errmsg);
+        close_raw_binary_fd (fd);
+        return ERROR;
+    }
+
+    espa_io_stats_open_fd (fd, infile, ESPA_IO_RAW_BINARY, start_time);
+    return fd;
+}
+
+
+/******************************************************************************
+MODULE: open_raw_binary_band_fd
+
+PURPOSE: Opens a raw binary band for positional (pread/pwrite) access, where
+the band starts at the specified byte offset of the file.
+ 
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error opening the specified file for the specified access
+>= 0         File descriptor of the opened file
+
+NOTES:
+  1. Files holding several bands stacked one after the other (see
+     espa_file_stack.h) give each band the file_offset from its metadata.
+     The offset is recorded for the file descriptor, so the window and batch
+     routines address the lines of the band the same as for a file holding
+     just that band.
+  2. An offset of 0 is the same as open_raw_binary_fd.
+  3. Block-compressed bands are never stacked, so they must start at 0.
+*****************************************************************************/
+int open_raw_binary_band_fd
+(
+    char *infile,        /* I: name of the input file to be opened */
+    off_t band_offset,   /* I: byte offset of the band in the file */
+    bool writable        /* I: open for read/write (true) or read-only
+                               (false) access */
+)
+{
+    char FUNC_NAME[] = "open_raw_binary_band_fd"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    int fd;                  /* file descriptor of the raw binary file */
+    off_t *by_fd = NULL;     /* resized offset table */
+    int i;                   /* looping variable */
+
+    fd = open_raw_binary_fd (infile, writable);
+    if (fd == ERROR || band_offset == 0)
+        return fd;
 
-    /* Read the data from the raw binary file */
-    nvals = fread (img_array, size, nlines * nsamps, rb_fptr);
-    if (nvals != nlines * nsamps)
+    if (band_offset < 0 || get_raw_binary_blocks (fd) != NULL)
     {
-        sprintf (errmsg, "Reading %d elements of %d bytes in size from the "
-            "raw binary file. Actually read %ld elements.", nlines * nsamps,
-            size, nvals);
+        sprintf (errmsg, "Invalid band offset %lld in raw binary file %s",
+            (long long) band_offset, infile);
         error_handler (true, FUNC_NAME, errmsg);
+        close_raw_binary_fd (fd);
+        return ERROR;
+    }
+
+    pthread_mutex_lock (&rb_offset_mutex);
+    if (fd >= rb_offset_nfds)
+    {
+        by_fd = realloc (rb_offset_by_fd, (fd + 1) * sizeof (*by_fd));
+        if (by_fd == NULL)
+        {
+            pthread_mutex_unlock (&rb_offset_mutex);
+            sprintf (errmsg, "Registering the band offset of raw binary "
+                "file %s", infile);
+            error_handler (true, FUNC_NAME, errmsg);
+            close_raw_binary_fd (fd);
+            return ERROR;
+        }
+        for (i = rb_offset_nfds; i <= fd; i++)
+            by_fd[i] = 0;
+        rb_offset_by_fd = by_fd;
+        rb_offset_nfds = fd + 1;
+    }
+    rb_offset_by_fd[fd] = band_offset;
+    pthread_mutex_unlock (&rb_offset_mutex);
+
+    return fd;
+}
+
+
+/******************************************************************************
+MODULE: get_raw_binary_band_offset
+
+PURPOSE: Looks up the byte offset of the band in the file opened with the
+file descriptor.
+ 
+RETURN VALUE:
+Type = off_t
+Value        Description
+-----        -----------
+>= 0         Byte offset of the first line of the band in the file
+
+NOTES:
+*****************************************************************************/
+off_t get_raw_binary_band_offset
+(
+    int fd               /* I: file descriptor of the raw binary file */
+)
+{
+    off_t band_offset = 0;   /* byte offset of the band */
+
+    pthread_mutex_lock (&rb_offset_mutex);
+    if (fd >= 0 && fd < rb_offset_nfds)
+        band_offset = rb_offset_by_fd[fd];
+    pthread_mutex_unlock (&rb_offset_mutex);
+
+    return band_offset;
+}
+
+
+/******************************************************************************
+MODULE: close_raw_binary_fd
+
+PURPOSE: Close the raw binary file opened for positional access
+ 
+RETURN VALUE:
+Type = N/A
+
+NOTES:
+*****************************************************************************/
+void close_raw_binary_fd
+(
+    int fd               /* I: file descriptor of the raw binary file to be
+                               closed */
+)
+{
+    double start_time;       /* start of the close for the I/O accounting */
+
+    start_time = espa_io_stats_clock ();
+    detach_raw_binary_blocks (fd);
+    detach_raw_binary_sparse (fd);
+    detach_raw_binary_cache (fd);
+
+    /* Forget the band offset and stop the accounting before the file
+       descriptor can be reused */
+    pthread_mutex_lock (&rb_offset_mutex);
+    if (fd >= 0 && fd < rb_offset_nfds)
+        rb_offset_by_fd[fd] = 0;
+    pthread_mutex_unlock (&rb_offset_mutex);
+    espa_io_stats_record_fd (fd, ESPA_IO_CLOSE, 0, start_time);
+
+    rb_close_staged (fd);
+}
+
+
+/******************************************************************************
+MODULE: pio_raw_binary
+
+PURPOSE: Reads or writes the requested number of bytes at the specified file
+offset, continuing after short transfers and interrupted system calls.
+ 
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        An error occurred or end of file was reached first
+SUCCESS      All of the bytes were transferred
+
+NOTES:
+*****************************************************************************/
+int pio_raw_binary
+(
+    int fd,             /* I: file descriptor of the raw binary file */
+    bool write_flag,    /* I: write (true) or read (false) */
+    void *buf,          /* I/O: buffer to be written or read into */
+    size_t nbytes,      /* I: number of bytes to transfer */
+    off_t offset        /* I: file offset for the transfer */
+)
+{
+    char *ptr = buf;    /* current position in the buffer */
+    ssize_t nxfer;      /* number of bytes transferred in this call */
+
+    while (nbytes > 0)
+    {
+        if (write_flag)
+            nxfer = pwrite (fd, ptr, nbytes, offset);
+        else
+            nxfer = pread (fd, ptr, nbytes, offset);
+
+        if (nxfer < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return ERROR;
+        }
+        if (nxfer == 0)
+            return ERROR;     /* unexpected end of file */
+
+        ptr += nxfer;
+        offset += nxfer;
+        nbytes -= nxfer;
+    }
+
+    return SUCCESS;
+}
+
+
+/******************************************************************************
+MODULE: rb_pio
+
+PURPOSE: Reads or writes a range of bytes of the band, filling in the fill
+regions of a band which has them rather than reading them, and going through
+the band cache for a band attached to it.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        An error occurred or end of file was reached first
+SUCCESS      All of the bytes were transferred
+
+NOTES:
+*****************************************************************************/
+static int rb_pio
+(
+    const Raw_binary_sparse_t *sparse, /* I: fill regions of the band; NULL
+                                             if it has none */
+    bool cached,        /* I: is the band attached to the band cache? */
+    int fd,             /* I: file descriptor of the raw binary file */
+    bool write_flag,    /* I: write (true) or read (false) */
+    void *buf,          /* I/O: buffer to be written or read into */
+    size_t nbytes,      /* I: number of bytes to transfer */
+    off_t offset        /* I: file offset for the transfer */
+)
+{
+    if (sparse != NULL && !write_flag)
+        return read_raw_binary_sparse (sparse, fd, buf, nbytes, offset);
+    if (cached)
+        return cached_raw_binary_io (fd, write_flag, buf, nbytes, offset);
+
+    return pio_raw_binary (fd, write_flag, buf, nbytes, offset);
+}
+
+
+/******************************************************************************
+MODULE: rb_window_io
+
+PURPOSE: Reads or writes a window of the band.  Full-width windows are
+transferred with a single call, otherwise one call is made per line.
+ 
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        An error occurred transferring the window
+SUCCESS      The window was transferred
+
+NOTES:
+*****************************************************************************/
+static int rb_window_io
+(
+    char *module,       /* I: calling module name for error messages */
+    bool write_flag,    /* I: write (true) or read (false) */
+    int fd,             /* I: file descriptor of the raw binary file */
+    int band_nsamps,    /* I: number of samples in a full line of the band */
+    int line0,          /* I: 0-based starting line of the window */
+    int nlines,         /* I: number of lines in the window */
+    int samp0,          /* I: 0-based starting sample of the window */
+    int nsamps,         /* I: number of samples in the window */
+    int size,           /* I: number of bytes per pixel */
+    void *img_array     /* I/O: window buffer */
+)
+{
+    char errmsg[STR_SIZE];   /* error message */
+    int line;                /* current line in the window */
+    size_t win_line_bytes;   /* number of bytes in a line of the window */
+    size_t band_line_bytes;  /* number of bytes in a full line of the band */
+    off_t offset;            /* file offset of the current line */
+    double start_time;       /* start of the transfer for the I/O
+                                accounting */
+    char *ptr = img_array;   /* current line in the window buffer */
+    Raw_binary_sparse_t *sparse = get_raw_binary_sparse (fd);
+                             /* fill regions of the band */
+    bool cached = is_raw_binary_cached (fd);  /* is the band cached? */
+
+    if (line0 < 0 || nlines < 0 || samp0 < 0 || nsamps < 0 ||
+        samp0 + nsamps > band_nsamps)
+    {
+        sprintf (errmsg, "Invalid window: lines %d+%d, samples %d+%d for a "
+            "band with %d samples.", line0, nlines, samp0, nsamps,
+            band_nsamps);
+        error_handler (true, module, errmsg);
         return ERROR;
     }
 
+    start_time = espa_io_stats_clock ();
+    win_line_bytes = (size_t) nsamps * size;
+    band_line_bytes = (size_t) band_nsamps * size;
+    offset = get_raw_binary_band_offset (fd) + (off_t) line0 *
+        band_line_bytes + (off_t) samp0 * size;
+
+    /* Full-width windows are contiguous in the file */
+    if (nsamps == band_nsamps)
+    {
+        if (rb_pio (sparse, cached, fd, write_flag, img_array,
+            win_line_bytes * nlines, offset) != SUCCESS)
+        {
+            sprintf (errmsg, "%s lines %d-%d (%d samples of %d bytes) of the "
+                "raw binary file.", write_flag ? "Writing" : "Reading", line0,
+                line0 + nlines - 1, nsamps, size);
+            error_handler (true, module, errmsg);
+            return ERROR;
+        }
+        espa_io_stats_record_fd (fd, write_flag ? ESPA_IO_WRITE :
+            ESPA_IO_READ, win_line_bytes * nlines, start_time);
+        return SUCCESS;
+    }
+
+    /* Otherwise handle each line of the window */
+    for (line = 0; line < nlines; line++)
+    {
+        if (rb_pio (sparse, cached, fd, write_flag, ptr, win_line_bytes,
+            offset) != SUCCESS)
+        {
+            sprintf (errmsg, "%s line %d, samples %d-%d of the raw binary "
+                "file.", write_flag ? "Writing" : "Reading", line0 + line,
+                samp0, samp0 + nsamps - 1);
+            error_handler (true, module, errmsg);
+            return ERROR;
+        }
+        ptr += win_line_bytes;
+        offset += band_line_bytes;
+    }
+    espa_io_stats_record_fd (fd, write_flag ? ESPA_IO_WRITE : ESPA_IO_READ,
+        win_line_bytes * nlines, start_time);
+
     return SUCCESS;
 }
 
+
+/******************************************************************************
+MODULE: read_raw_binary_window
+
+PURPOSE: Reads a window of nlines x nsamps from the raw binary band starting
+at line0, samp0 without using or modifying a shared file position.
+ 
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        An error occurred reading data from the raw binary file
+SUCCESS      Reading was successful
+
+NOTES:
+  1. The window is returned packed, i.e. each line of the window holds nsamps
+     pixels.
+  2. Safe for multiple threads reading disjoint or overlapping windows of the
+     same file descriptor.
+  3. Block-compressed bands are decompressed by read_raw_binary_blocks.
+*****************************************************************************/
+int read_raw_binary_window
+(
+    int fd,             /* I: file descriptor of the raw binary file */
+    int band_nsamps,    /* I: number of samples in a full line of the band */
+    int line0,          /* I: 0-based starting line of the window */
+    int nlines,         /* I: number of lines in the window */
+    int samp0,          /* I: 0-based starting sample of the window */
+    int nsamps,         /* I: number of samples in the window */
+    int size,           /* I: number of bytes per pixel (ex. sizeof(uint8)) */
+    void *img_array     /* O: array of nlines * nsamps * size to be read from
+                              the raw binary file (sufficient space should
+                              already have been allocated) */
+)
+{
+    Raw_binary_blocks_t *blocks = get_raw_binary_blocks (fd);
+                             /* reader of a block-compressed band */
+
+    if (blocks != NULL)
+        return read_raw_binary_blocks (blocks, band_nsamps, line0, nlines,
+            samp0, nsamps, size, img_array);
+
+    return rb_window_io ("read_raw_binary_window", false, fd, band_nsamps,
+        line0, nlines, samp0, nsamps, size, img_array);
+}
+
+
+/******************************************************************************
+MODULE: read_raw_binary_constant
+
+PURPOSE: Synthesizes nlines of a constant band, which holds the same pixel
+value everywhere and has no raw binary file.
+ 
+RETURN VALUE:
+Type = N/A
+
+NOTES:
+  1. The pixel is copied once and the filled part of the array is then
+     doubled with each copy, so filling takes a handful of large copies
+     rather than one per pixel.  A pixel whose bytes are all the same is
+     filled with a single memset.
+*****************************************************************************/
+void read_raw_binary_constant
+(
+    int nlines,         /* I: number of lines to synthesize */
+    int nsamps,         /* I: number of samples to synthesize */
+    int size,           /* I: number of bytes per pixel (ex. sizeof(uint8)) */
+    const void *pixel,  /* I: value of every pixel; size bytes */
+    void *img_array     /* O: array of nlines * nsamps * size to be filled
+                              (sufficient space should already have been
+                              allocated) */
+)
+{
+    const unsigned char *pix = pixel;  /* bytes of the pixel value */
+    char *out = img_array;   /* array being filled */
+    size_t nbytes;           /* number of bytes to be filled */
+    size_t filled;           /* number of bytes filled so far */
+    size_t count;            /* number of bytes to copy next */
+    int i;                   /* looping variable for the pixel bytes */
+
+    nbytes = (size_t) nlines * nsamps * size;
+    if (nbytes == 0)
+        return;
+
+    for (i = 1; i < size; i++)
+    {
+        if (pix[i] != pix[0])
+            break;
+    }
+    if (i == size)
+    {
+        memset (out, pix[0], nbytes);
+        return;
+    }
+
+    memcpy (out, pix, size);
+    for (filled = size; filled < nbytes; filled += count)
+    {
+        count = filled;
+        if (count > nbytes - filled)
+            count = nbytes - filled;
+        memcpy (out + filled, out, count);
+    }
+}
+
+
+/******************************************************************************
+MODULE: write_raw_binary_window
+
+PURPOSE: Writes a window of nlines x nsamps to the raw binary band starting
+at line0, samp0 without using or modifying a shared file position.
+ 
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        An error occurred writing data to the raw binary file
+SUCCESS      Writing was successful
+
+NOTES:
+  1. The window is expected to be packed, i.e. each line of the window holds
+     nsamps pixels.
+  2. Safe for multiple threads writing disjoint windows of the same file
+     descriptor.
+*****************************************************************************/
+int write_raw_binary_window
+(
+    int fd,             /* I: file descriptor of the raw binary file */
+    int band_nsamps,    /* I: number of samples in a full line of the band */
+    int line0,          /* I: 0-based starting line of the window */
+    int nlines,         /* I: number of lines in the window */
+    int samp0,          /* I: 0-based starting sample of the window */
+    int nsamps,         /* I: number of samples in the window */
+    int size,           /* I: number of bytes per pixel (ex. sizeof(uint8)) */
+    void *img_array     /* I: array of nlines * nsamps * size to be written
+                              to the raw binary file */
+)
+{
+    return rb_window_io ("write_raw_binary_window", true, fd, band_nsamps,
+        line0, nlines, samp0, nsamps, size, img_array);
+}
+
+
+/******************************************************************************
+MODULE: rb_madvise_flag
+
+PURPOSE: Converts the raw binary access hint to the madvise flag.
+ 
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+MADV_*       madvise flag associated with the access hint
+
+NOTES:
+*****************************************************************************/
+static int rb_madvise_flag
+(
+    Raw_binary_advice_t advice  /* I: access pattern hint */
+)
+{
+    switch (advice)
+    {
+        case RB_ADVISE_SEQUENTIAL:
+            return MADV_SEQUENTIAL;
+        case RB_ADVISE_RANDOM:
+            return MADV_RANDOM;
+        case RB_ADVISE_WILLNEED:
+            return MADV_WILLNEED;
+        case RB_ADVISE_DONTNEED:
+            return MADV_DONTNEED;
+        case RB_ADVISE_NORMAL:
+        default:
+            return MADV_NORMAL;
+    }
+}
+
+
+/******************************************************************************
+MODULE: map_raw_binary
+
+PURPOSE: Opens a raw binary band and maps the entire band into memory so the
+band can be accessed directly without copying it into a separate buffer.
+ 
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error opening or mapping the raw binary file
+SUCCESS      Successfully mapped the raw binary file
+
+NOTES:
+  1. The file must already contain at least nlines * nsamps * size bytes.
+     Mapping does not extend the file.
+  2. For read/write maps, changes are written back to the file via the shared
+     mapping.  They are flushed to disk when the band is unmapped.
+  3. rb_map->data points to the first pixel of the band and should be cast to
+     the data type of the band.  get_raw_binary_map_line returns the start of
+     a specific line.
+  4. For the I/O accounting, mapping the band is tallied as a read of the
+     whole band and flushing a read/write map as a write of it.  The page
+     faults in between aren't seen, so only the mapping and the flush are
+     timed.
+*****************************************************************************/
+int map_raw_binary
+(
+    char *infile,            /* I: name of the raw binary file to be mapped */
+    int nlines,              /* I: number of lines in the band */
+    int nsamps,              /* I: number of samples in the band */
+    int size,                /* I: number of bytes per pixel */
+    bool writable,           /* I: map for read/write (true) or read-only
+                                   (false) access */
+    Raw_binary_advice_t advice, /* I: initial access pattern hint */
+    Raw_binary_map_t *rb_map /* O: mapped band view */
+)
+{
+    return map_raw_binary_band (infile, 0, nlines, nsamps, size, writable,
+        advice, rb_map);
+}
+
+
+/******************************************************************************
+MODULE: map_raw_binary_band
+
+PURPOSE: Opens a raw binary file and maps a band which starts at an offset
+in the file (ex. a band of a stacked file; see espa_file_stack.h) into
+memory.
+ 
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error opening or mapping the raw binary file
+SUCCESS      Successfully mapped the band
+
+NOTES:
+  1. The file must already contain at least nlines * nsamps * size bytes
+     after band_offset.  Mapping does not extend the file.
+  2. The mapping starts at the page holding band_offset, so rb_map->data
+     may not be page aligned; rb_map->map_offset is the number of bytes
+     mapped before the band.
+  3. See map_raw_binary for the rest.
+*****************************************************************************/
+int map_raw_binary_band
+(
+    char *infile,            /* I: name of the raw binary file to be mapped */
+    off_t band_offset,       /* I: byte offset of the band in the file */
+    int nlines,              /* I: number of lines in the band */
+    int nsamps,              /* I: number of samples in the band */
+    int size,                /* I: number of bytes per pixel */
+    bool writable,           /* I: map for read/write (true) or read-only
+                                   (false) access */
+    Raw_binary_advice_t advice, /* I: initial access pattern hint */
+    Raw_binary_map_t *rb_map /* O: mapped band view */
+)
+{
+    char FUNC_NAME[] = "map_raw_binary_band"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    char path[STR_SIZE];     /* name the file is opened under */
+    int count;               /* number of chars copied in snprintf */
+    long page_size;          /* system page size */
+    off_t map_start;         /* page-aligned file offset of the mapping */
+    char *base = NULL;       /* start of the mapping */
+    double start_time;       /* start of the open for the I/O accounting */
+    struct stat statbuf;     /* file status for the raw binary file */
+
+    /* Initialize the map so it's safe to unmap on error */
+    memset (rb_map, 0, sizeof (Raw_binary_map_t));
+    rb_map->fd = -1;
+    rb_map->data = NULL;
+
+    count = snprintf (rb_map->file_name, sizeof (rb_map->file_name), "%s",
+        infile);
+    if (count < 0 || count >= sizeof (rb_map->file_name))
+    {
+        sprintf (errmsg, "Overflow of rb_map->file_name string");
+        error_handler (true, FUNC_NAME, errmsg);
+        return ERROR;
+    }
+    rb_map->writable = writable;
+    rb_map->nlines = nlines;
+    rb_map->nsamps = nsamps;
+    rb_map->size = size;
+    rb_map->nbytes = (size_t) nlines * nsamps * size;
+    if (rb_map->nbytes == 0)
+    {
+        sprintf (errmsg, "Invalid band size for mapping raw binary file %s: "
+            "%d lines, %d samples, %d bytes per pixel.", infile, nlines,
+            nsamps, size);
+        error_handler (true, FUNC_NAME, errmsg);
+        return ERROR;
+    }
+
+    /* Open the file with the requested access */
+    start_time = espa_io_stats_clock ();
+    if (espa_staging_path (infile, writable ? ESPA_STAGE_UPDATE :
+        ESPA_STAGE_READ, path, sizeof (path)) != SUCCESS)
+        return ERROR;
+    rb_map->fd = open (path, writable ? O_RDWR : O_RDONLY);
+    if (rb_map->fd == -1)
+    {
+        sprintf (errmsg, "Opening raw binary file %s for mapping.", infile);
+        error_handler (true, FUNC_NAME, errmsg);
+        if (writable)
+            espa_staging_done (infile);
+        return ERROR;
+    }
+    if (writable)
+        espa_staging_attach (rb_map->fd, infile);
+
+    /* Make sure the file is large enough for the requested band size */
+    if (band_offset < 0 || fstat (rb_map->fd, &statbuf) == -1 ||
+        statbuf.st_size < band_offset ||
+        (size_t) (statbuf.st_size - band_offset) < rb_map->nbytes)
+    {
+        sprintf (errmsg, "Raw binary file %s is smaller than the expected "
+            "%zu bytes for %d lines and %d samples at offset %lld.", infile,
+            rb_map->nbytes, nlines, nsamps, (long long) band_offset);
+        error_handler (true, FUNC_NAME, errmsg);
+        rb_close_staged (rb_map->fd);
+        rb_map->fd = -1;
+        return ERROR;
+    }
+
+    espa_io_stats_open_fd (rb_map->fd, infile, ESPA_IO_RAW_BINARY,
+        start_time);
+
+    /* Map the band, from the start of the page holding it */
+    start_time = espa_io_stats_clock ();
+    page_size = sysconf (_SC_PAGESIZE);
+    map_start = band_offset - band_offset % page_size;
+    rb_map->map_offset = band_offset - map_start;
+    base = mmap (NULL, rb_map->map_offset + rb_map->nbytes,
+        writable ? (PROT_READ | PROT_WRITE) : PROT_READ, MAP_SHARED,
+        rb_map->fd, map_start);
+    if (base == MAP_FAILED)
+    {
+        sprintf (errmsg, "Mapping %zu bytes of raw binary file %s.",
+            rb_map->nbytes, infile);
+        error_handler (true, FUNC_NAME, errmsg);
+        rb_map->data = NULL;
+        espa_io_stats_record_fd (rb_map->fd, ESPA_IO_CLOSE, 0,
+            espa_io_stats_clock ());
+        rb_close_staged (rb_map->fd);
+        rb_map->fd = -1;
+        return ERROR;
+    }
+    rb_map->data = base + rb_map->map_offset;
+    espa_io_stats_record_fd (rb_map->fd, ESPA_IO_READ, rb_map->nbytes,
+        start_time);
+
+    /* Apply the initial access hint to the entire band.  Hints are advisory,
+       so a failure is only a warning. */
+    if (advice != RB_ADVISE_NORMAL &&
+        madvise (base, rb_map->map_offset + rb_map->nbytes,
+        rb_madvise_flag (advice)) != 0)
+    {
+        sprintf (errmsg, "Unable to apply the access hint to %s", infile);
+        error_handler (false, FUNC_NAME, errmsg);
+    }
+
+    return SUCCESS;
+}
+
+
+/******************************************************************************
+MODULE: get_raw_binary_map_line
+
+PURPOSE: Returns a pointer to the start of the specified line in the mapped
+band.
+ 
+RETURN VALUE:
+Type = void *
+Value        Description
+-----        -----------
+NULL         Line is outside the band
+non-NULL     Pointer to the first pixel of the specified line
+
+NOTES:
+*****************************************************************************/
+void *get_raw_binary_map_line
+(
+    Raw_binary_map_t *rb_map,  /* I: mapped band view */
+    int line                   /* I: 0-based line to be accessed */
+)
+{
+    if (rb_map->data == NULL || line < 0 || line >= rb_map->nlines)
+        return NULL;
+
+    return (char *) rb_map->data + (size_t) line * rb_map->nsamps *
+        rb_map->size;
+}
+
+
+/******************************************************************************
+MODULE: advise_raw_binary_map
+
+PURPOSE: Provides an access pattern hint for a range of lines in the mapped
+band.
+ 
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error applying the hint
+SUCCESS      Successfully applied the hint
+
+NOTES:
+  1. RB_ADVISE_DONTNEED on a writable map only drops clean pages; modified
+     pages remain until they are written back.
+*****************************************************************************/
+int advise_raw_binary_map
+(
+    Raw_binary_map_t *rb_map,   /* I: mapped band view */
+    int line0,                  /* I: first line of the hint */
+    int nlines,                 /* I: number of lines in the hint */
+    Raw_binary_advice_t advice  /* I: access pattern hint */
+)
+{
+    char FUNC_NAME[] = "advise_raw_binary_map"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    long page_size;          /* system page size */
+    size_t line_bytes;       /* number of bytes in a single line */
+    size_t start;            /* starting byte of the hint */
+    size_t end;              /* ending byte of the hint */
+
+    if (rb_map->data == NULL || line0 < 0 || nlines <= 0 ||
+        line0 + nlines > rb_map->nlines)
+    {
+        sprintf (errmsg, "Invalid line range %d-%d for mapped band %s", line0,
+            line0 + nlines - 1, rb_map->file_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return ERROR;
+    }
+
+    /* madvise requires a page-aligned starting address; the mapping starts
+       map_offset bytes before the band on a page boundary */
+    page_size = sysconf (_SC_PAGESIZE);
+    line_bytes = (size_t) rb_map->nsamps * rb_map->size;
+    start = rb_map->map_offset + (size_t) line0 * line_bytes;
+    end = start + (size_t) nlines * line_bytes;
+    start -= start % page_size;
+
+    if (madvise ((char *) rb_map->data - rb_map->map_offset + start,
+        end - start,
+        rb_madvise_flag (advice)) != 0)
+    {
+        sprintf (errmsg, "Applying access hint to lines %d-%d of %s", line0,
+            line0 + nlines - 1, rb_map->file_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return ERROR;
+    }
+
+    return SUCCESS;
+}
+
+
+/******************************************************************************
+MODULE: unmap_raw_binary
+
+PURPOSE: Unmaps the band and closes the raw binary file.  Writable maps are
+synchronized to disk before being released.
+ 
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error flushing or unmapping the band
+SUCCESS      Successfully unmapped the band
+
+NOTES:
+*****************************************************************************/
+int unmap_raw_binary
+(
+    Raw_binary_map_t *rb_map   /* I/O: mapped band view to be released */
+)
+{
+    char FUNC_NAME[] = "unmap_raw_binary"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    int status = SUCCESS;    /* return status */
+    double start_time;       /* start of the flush or close for the I/O
+                                accounting */
+
+    if (rb_map->data != NULL)
+    {
+        /* Flush any modifications back to the file */
+        start_time = espa_io_stats_clock ();
+        if (rb_map->writable &&
+            msync ((char *) rb_map->data - rb_map->map_offset,
+            rb_map->map_offset + rb_map->nbytes, MS_SYNC) != 0)
+        {
+            sprintf (errmsg, "Flushing the mapped band to %s",
+                rb_map->file_name);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+        }
+        else if (rb_map->writable)
+            espa_io_stats_record_fd (rb_map->fd, ESPA_IO_WRITE,
+                rb_map->nbytes, start_time);
+
+        if (munmap ((char *) rb_map->data - rb_map->map_offset,
+            rb_map->map_offset + rb_map->nbytes) != 0)
+        {
+            sprintf (errmsg, "Unmapping the band for %s", rb_map->file_name);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+        }
+        rb_map->data = NULL;
+    }
+
+    if (rb_map->fd != -1)
+    {
+        start_time = espa_io_stats_clock ();
+        espa_io_stats_record_fd (rb_map->fd, ESPA_IO_CLOSE, 0, start_time);
+        rb_close_staged (rb_map->fd);
+        rb_map->fd = -1;
+    }
+
+    return status;
+}
+
+
+/******************************************************************************
+MODULE: use_raw_binary_direct
+
+PURPOSE: Determines whether a bulk band write should bypass the page cache.
+
+RETURN VALUE:
+Type = bool
+Value        Description
+-----        -----------
+true         Use direct I/O for the write
+false        Use buffered I/O for the write
+
+NOTES:
+  1. For RB_WRITE_FROM_ENV, direct I/O is used if the RB_DIRECT_IO_ENV
+     environment variable is set to "yes" or "1".
+*****************************************************************************/
+bool use_raw_binary_direct
+(
+    Raw_binary_write_mode_t mode  /* I: requested write mode */
+)
+{
+    char *env = NULL;    /* value of the environment variable */
+
+    if (mode == RB_WRITE_DIRECT)
+        return true;
+    if (mode == RB_WRITE_BUFFERED)
+        return false;
+
+    env = getenv (RB_DIRECT_IO_ENV);
+    if (env == NULL)
+        return false;
+    return (!strcmp (env, "yes") || !strcmp (env, "1"));
+}
+
+
+/******************************************************************************
+MODULE: use_raw_binary_verify
+
+PURPOSE: Determines whether the checksums of the bands are verified as the
+bands are read.
+
+RETURN VALUE:
+Type = bool
+Value        Description
+-----        -----------
+true         Verify the checksums
+false        Don't verify the checksums
+
+NOTES:
+  1. The checksums are verified if the RB_VERIFY_ENV environment variable is
+     set to "yes" or "1".  Only the readers which traverse whole bands in
+     order (see espa_band_stack.h) can verify them.
+*****************************************************************************/
+bool use_raw_binary_verify (void)
+{
+    char *env = NULL;    /* value of the environment variable */
+
+    env = getenv (RB_VERIFY_ENV);
+    if (env == NULL)
+        return false;
+    return (!strcmp (env, "yes") || !strcmp (env, "1"));
+}
+
+
+/******************************************************************************
+MODULE: alloc_raw_binary_buf
+
+PURPOSE: Allocates a zero-filled image buffer aligned for direct I/O, so a
+band can be written straight from the buffer without being staged.
+
+RETURN VALUE:
+Type = void *
+Value        Description
+-----        -----------
+NULL         Error allocating the buffer
+non-NULL     Buffer of at least nbytes, to be released with espa_trace_free
+
+NOTES:
+  1. The buffer is rounded up to a multiple of RB_DIRECT_ALIGN bytes.
+*****************************************************************************/
+void *alloc_raw_binary_buf
+(
+    size_t nbytes        /* I: number of bytes needed */
+)
+{
+    void *buf = NULL;    /* aligned buffer */
+    size_t alloc_bytes;  /* number of bytes allocated */
+
+    alloc_bytes = (nbytes + RB_DIRECT_ALIGN - 1) / RB_DIRECT_ALIGN *
+        RB_DIRECT_ALIGN;
+    if (alloc_bytes == 0)
+        alloc_bytes = RB_DIRECT_ALIGN;
+    if (espa_trace_posix_memalign (&buf, RB_DIRECT_ALIGN, alloc_bytes) != 0)
+        return NULL;
+    memset (buf, 0, alloc_bytes);
+
+    return buf;
+}
+
+
+/******************************************************************************
+MODULE: write_raw_binary_band
+
+PURPOSE: Creates (or truncates) the raw binary file and writes the entire
+band to it, optionally bypassing the page cache.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error creating or writing the raw binary file
+SUCCESS      Successful write
+
+NOTES:
+  1. With direct I/O, the RB_DIRECT_ALIGN multiple at the start of the band
+     is written with O_DIRECT, straight from img_array if it is aligned (see
+     alloc_raw_binary_buf) or otherwise through an aligned staging buffer.
+     The unaligned tail is then flushed with a regular write and dropped from
+     the page cache.
+  2. Filesystems which don't support O_DIRECT fall back to buffered writes.
+*****************************************************************************/
+int write_raw_binary_band
+(
+    char *outfile,      /* I: name of the raw binary file to be written */
+    int nlines,         /* I: number of lines in the band */
+    int nsamps,         /* I: number of samples in the band */
+    int size,           /* I: number of bytes per pixel (ex. sizeof(uint8)) */
+    void *img_array,    /* I: array of nlines * nsamps * size to be written */
+    Raw_binary_write_mode_t mode  /* I: buffered, direct, or per the
+                              RB_DIRECT_IO_ENV environment variable */
+)
+{
+    char FUNC_NAME[] = "write_raw_binary_band"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    char path[STR_SIZE];     /* name the file is created under */
+    int fd;                  /* file descriptor of the raw binary file */
+    int flags;               /* file status flags */
+    bool direct;             /* is direct I/O being used? */
+    size_t nbytes;           /* total number of bytes in the band */
+    size_t body_bytes;       /* aligned bytes written with direct I/O */
+    size_t chunk;            /* bytes in the current staged write */
+    size_t done;             /* bytes already written */
+    char *stage = NULL;      /* aligned staging buffer */
+    int status = SUCCESS;    /* status of the writes */
+
+    nbytes = (size_t) nlines * nsamps * size;
+    direct = use_raw_binary_direct (mode);
+
+    if (espa_staging_path (outfile, ESPA_STAGE_CREATE, path,
+        sizeof (path)) != SUCCESS)
+        return ERROR;
+    fd = -1;
+#ifdef O_DIRECT
+    if (direct)
+        fd = open (path, O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0644);
+#endif
+    if (fd == -1)
+    {
+        /* O_DIRECT is not supported, so use buffered writes */
+        direct = false;
+        fd = open (path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    }
+    if (fd == -1)
+    {
+        sprintf (errmsg, "Creating raw binary file %s", outfile);
+        error_handler (true, FUNC_NAME, errmsg);
+        espa_staging_done (outfile);
+        return ERROR;
+    }
+    espa_staging_attach (fd, outfile);
+
+    body_bytes = direct ? nbytes / RB_DIRECT_ALIGN * RB_DIRECT_ALIGN : 0;
+    done = 0;
+    if (body_bytes > 0)
+    {
+        if (((uintptr_t) img_array % RB_DIRECT_ALIGN) == 0)
+        {
+            status = pio_raw_binary (fd, true, img_array, body_bytes, 0);
+            done = body_bytes;
+        }
+        else
+        {
+            stage = alloc_raw_binary_buf (RB_DIRECT_STAGE_BYTES);
+            if (stage == NULL)
+            {
+                sprintf (errmsg, "Allocating the direct I/O staging buffer");
+                error_handler (true, FUNC_NAME, errmsg);
+                rb_close_staged (fd);
+                return ERROR;
+            }
+            while (done < body_bytes && status == SUCCESS)
+            {
+                chunk = body_bytes - done;
+                if (chunk > RB_DIRECT_STAGE_BYTES)
+                    chunk = RB_DIRECT_STAGE_BYTES;
+                memcpy (stage, (char *) img_array + done, chunk);
+                status = pio_raw_binary (fd, true, stage, chunk, done);
+                done += chunk;
+            }
+            espa_trace_free (stage);
+        }
+
+        /* Some filesystems accept O_DIRECT at open but not on write */
+        if (status != SUCCESS && errno == EINVAL)
+        {
+            done = 0;
+            status = SUCCESS;
+        }
+    }
+
+    /* Write the rest (all of it for buffered I/O) without O_DIRECT */
+    if (status == SUCCESS && done < nbytes)
+    {
+        if (direct)
+        {
+            flags = fcntl (fd, F_GETFL);
+#ifdef O_DIRECT
+            if (flags != -1)
+                flags = fcntl (fd, F_SETFL, flags & ~O_DIRECT);
+#endif
+            if (flags == -1)
+                status = ERROR;
+        }
+        if (status == SUCCESS)
+            status = pio_raw_binary (fd, true, (char *) img_array + done,
+                nbytes - done, done);
+    }
+
+    if (status != SUCCESS)
+    {
+        sprintf (errmsg, "Writing %zu bytes to raw binary file %s", nbytes,
+            outfile);
+        error_handler (true, FUNC_NAME, errmsg);
+        rb_close_staged (fd);
+        return ERROR;
+    }
+
+    /* Don't leave the tail (or the buffered fallback) in the page cache */
+    if (direct)
+    {
+        fdatasync (fd);
+        advise_raw_binary_fd (fd, 0, 0, RB_ADVISE_DONTNEED);
+    }
+
+    if (rb_close_staged (fd) != SUCCESS)
+    {
+        sprintf (errmsg, "Closing raw binary file %s", outfile);
+        error_handler (true, FUNC_NAME, errmsg);
+        return ERROR;
+    }
+
+    return SUCCESS;
+}
+
+
+/******************************************************************************
+MODULE: copy_raw_binary_fd
+
+PURPOSE: Copies a range of bytes of one open file to the start of another.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error reading the input file or writing the output file
+SUCCESS      Successful copy
+
+NOTES:
+  1. The bytes are copied with copy_file_range, so they stay in the kernel
+     and the filesystem may share the extents (reflink) or copy them on the
+     server rather than through this process.
+  2. If copy_file_range isn't available or isn't supported between the two
+     files (ex. across filesystems on older kernels), the rest of the range
+     is copied with large sequential reads and writes.
+  3. Errors are left for the caller to report, since it knows the names of
+     the files.
+*****************************************************************************/
+int copy_raw_binary_fd
+(
+    int in_fd,          /* I: file descriptor of the file holding the bytes */
+    off_t offset,       /* I: file offset of the first byte to be copied */
+    size_t nbytes,      /* I: number of bytes to be copied */
+    int out_fd          /* I: file descriptor of the file to be written */
+)
+{
+    size_t done = 0;         /* bytes already copied */
+    size_t chunk;            /* bytes in the current sequential copy */
+    char *buf = NULL;        /* buffer for the sequential copy */
+    int status = SUCCESS;    /* status of the copy */
+#ifdef RB_COPY_FILE_RANGE
+    loff_t in_off;           /* offset of the input for copy_file_range */
+    loff_t out_off;          /* offset of the output for copy_file_range */
+    ssize_t ncopied;         /* bytes copied by copy_file_range */
+#endif
+
+    advise_raw_binary_fd (in_fd, offset, nbytes, RB_ADVISE_SEQUENTIAL);
+
+#ifdef RB_COPY_FILE_RANGE
+    /* Let the kernel copy the bytes */
+    while (done < nbytes)
+    {
+        in_off = offset + done;
+        out_off = done;
+        ncopied = copy_file_range (in_fd, &in_off, out_fd, &out_off,
+            nbytes - done, 0);
+        if (ncopied < 0 && errno == EINTR)
+            continue;
+        if (ncopied <= 0)
+        {
+            /* Not supported between these files, or an unexpected end of
+               the input, which the sequential copy reports */
+            break;
+        }
+        done += ncopied;
+    }
+#endif
+
+    /* Copy whatever is left through a buffer */
+    if (done < nbytes)
+    {
+        buf = malloc (RB_COPY_CHUNK_BYTES);
+        if (buf == NULL)
+            return ERROR;
+        while (done < nbytes && status == SUCCESS)
+        {
+            chunk = nbytes - done;
+            if (chunk > RB_COPY_CHUNK_BYTES)
+                chunk = RB_COPY_CHUNK_BYTES;
+            status = pio_raw_binary (in_fd, false, buf, chunk, offset + done);
+            if (status == SUCCESS)
+                status = pio_raw_binary (out_fd, true, buf, chunk, done);
+            done += chunk;
+        }
+        free (buf);
+    }
+
+    return status;
+}
+
+
+/******************************************************************************
+MODULE: copy_raw_binary_range
+
+PURPOSE: Creates (or truncates) the raw binary file as a copy of a range of
+bytes of another file, such as the pixels of an uncompressed GeoTIFF.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error reading the input file or writing the raw binary file
+SUCCESS      Successful copy
+
+NOTES:
+  1. The bytes are copied by copy_raw_binary_fd.
+  2. With staging on (see espa_staging.h) the raw binary file is written to
+     the staging directory and flushed to outfile once it is closed.
+*****************************************************************************/
+int copy_raw_binary_range
+(
+    char *infile,       /* I: name of the file holding the bytes */
+    off_t offset,       /* I: file offset of the first byte to be copied */
+    size_t nbytes,      /* I: number of bytes to be copied */
+    char *outfile       /* I: name of the raw binary file to be written */
+)
+{
+    char FUNC_NAME[] = "copy_raw_binary_range"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    char in_path[STR_SIZE];  /* path the input file is read from */
+    char out_path[STR_SIZE]; /* path the raw binary file is written to */
+    int in_fd;               /* file descriptor of the input file */
+    int out_fd;              /* file descriptor of the raw binary file */
+    int status;              /* status of the copy */
+
+    if (espa_staging_path (infile, false, in_path, sizeof (in_path)) !=
+        SUCCESS)
+        return ERROR;
+    in_fd = open (in_path, O_RDONLY);
+    if (in_fd == -1)
+    {
+        sprintf (errmsg, "Opening the input file %s", infile);
+        error_handler (true, FUNC_NAME, errmsg);
+        return ERROR;
+    }
+    if (espa_staging_path (outfile, true, out_path, sizeof (out_path)) !=
+        SUCCESS)
+    {
+        close (in_fd);
+        return ERROR;
+    }
+    out_fd = open (out_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (out_fd == -1)
+    {
+        sprintf (errmsg, "Creating raw binary file %s", outfile);
+        error_handler (true, FUNC_NAME, errmsg);
+        close (in_fd);
+        espa_staging_done (outfile);
+        return ERROR;
+    }
+
+    status = copy_raw_binary_fd (in_fd, offset, nbytes, out_fd);
+    close (in_fd);
+
+    if (status != SUCCESS)
+    {
+        sprintf (errmsg, "Copying %zu bytes from %s to raw binary file %s",
+            nbytes, infile, outfile);
+        error_handler (true, FUNC_NAME, errmsg);
+        close (out_fd);
+        espa_staging_done (outfile);
+        return ERROR;
+    }
+
+    if (close (out_fd) != 0)
+    {
+        sprintf (errmsg, "Closing raw binary file %s", outfile);
+        error_handler (true, FUNC_NAME, errmsg);
+        espa_staging_done (outfile);
+        return ERROR;
+    }
+    espa_staging_done (outfile);
+
+    return SUCCESS;
+}
+
+
+/******************************************************************************
+MODULE: pack_raw_binary_bits
+
+PURPOSE: Packs one line of 8-bit values into one bit per sample, setting the
+bit of each non-zero sample.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. The first sample is the most significant bit of the first byte.  The
+     unused bits of the last byte are cleared.
+*****************************************************************************/
+void pack_raw_binary_bits
+(
+    int nsamps,              /* I: number of samples in the line */
+    const uint8_t *line,     /* I: nsamps 8-bit values to be packed */
+    uint8_t *packed          /* O: RB_BITPACKED_LINE_BYTES(nsamps) bytes of
+                                   packed bits */
+)
+{
+    int samp;                /* looping variable for the samples */
+    int bit;                 /* looping variable for the bits of a byte */
+    uint8_t byte;            /* packed byte being built */
+
+    for (samp = 0; samp < nsamps; samp += 8)
+    {
+        byte = 0;
+        for (bit = 0; bit < 8 && samp + bit < nsamps; bit++)
+            byte |= (line[samp + bit] != 0) << (7 - bit);
+        packed[samp / 8] = byte;
+    }
+}
+
+
+/******************************************************************************
+MODULE: unpack_raw_binary_bits
+
+PURPOSE: Expands one line of packed bits into one 8-bit value (0 or 1) per
+sample.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. The bit order is the same as pack_raw_binary_bits.
+*****************************************************************************/
+void unpack_raw_binary_bits
+(
+    int nsamps,              /* I: number of samples in the line */
+    const uint8_t *packed,   /* I: RB_BITPACKED_LINE_BYTES(nsamps) bytes of
+                                   packed bits */
+    uint8_t *line            /* O: nsamps 8-bit values */
+)
+{
+    int samp;                /* looping variable for the samples */
+
+    for (samp = 0; samp < nsamps; samp++)
+        line[samp] = (packed[samp / 8] >> (7 - samp % 8)) & 1;
+}
+
+
+/******************************************************************************
+MODULE: rb_stream_io
+
+PURPOSE: Reads or writes a block of bytes from/to the current position of a
+raw binary file, recording the transfer for the I/O accounting.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        The full block could not be transferred
+SUCCESS      Transfer was successful
+
+NOTES:
+*****************************************************************************/
+static int rb_stream_io
+(
+    FILE *rb_fptr,      /* I: pointer to the raw binary file */
+    bool write_flag,    /* I: write (true) or read (false) */
+    void *buf,          /* I/O: buffer to be written or read into */
+    size_t nbytes       /* I: number of bytes to transfer */
+)
+{
+    size_t nvals;            /* number of bytes transferred */
+    double start_time;       /* start of the transfer for the I/O accounting */
+
+    start_time = espa_io_stats_clock ();
+    if (write_flag)
+    {
+        nvals = fwrite (buf, 1, nbytes, rb_fptr);
+        espa_io_stats_record (rb_fptr, ESPA_IO_WRITE, nvals, start_time);
+    }
+    else
+    {
+        nvals = fread (buf, 1, nbytes, rb_fptr);
+        espa_io_stats_record (rb_fptr, ESPA_IO_READ, nvals, start_time);
+    }
+
+    return nvals == nbytes ? SUCCESS : ERROR;
+}
+
+
+/******************************************************************************
+MODULE: write_raw_binary_bitpacked
+
+PURPOSE: Writes nlines of 8-bit data to the raw binary file, packed to one
+bit per sample.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        An error occurred writing data to the raw binary file
+SUCCESS      Writing was successful
+
+NOTES:
+  1. Each line is packed with pack_raw_binary_bits and starts on a byte
+     boundary, so a line takes RB_BITPACKED_LINE_BYTES(nsamps) bytes.
+  2. Data which is already packed this way can be written directly with
+     write_raw_binary, using RB_BITPACKED_LINE_BYTES(nsamps) samples of one
+     byte per line.
+*****************************************************************************/
+int write_raw_binary_bitpacked
+(
+    FILE *rb_fptr,      /* I: pointer to the raw binary file */
+    int nlines,         /* I: number of lines to write to the file */
+    int nsamps,         /* I: number of samples to write to the file */
+    const uint8_t *img_array  /* I: array of nlines * nsamps 8-bit values to
+                              be packed and written to the raw binary file */
+)
+{
+    char FUNC_NAME[] = "write_raw_binary_bitpacked"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    size_t line_bytes = RB_BITPACKED_LINE_BYTES (nsamps);
+                             /* number of packed bytes per line */
+    uint8_t *packed = NULL;  /* packed bits of the current line */
+    int line;                /* looping variable for the lines */
+
+    packed = malloc (line_bytes + 1);
+    if (packed == NULL)
+    {
+        sprintf (errmsg, "Allocating memory for the packed line");
+        error_handler (true, FUNC_NAME, errmsg);
+        return ERROR;
+    }
+
+    for (line = 0; line < nlines; line++)
+    {
+        pack_raw_binary_bits (nsamps, &img_array[(size_t) line * nsamps],
+            packed);
+        if (rb_stream_io (rb_fptr, true, packed, line_bytes) != SUCCESS)
+        {
+            sprintf (errmsg, "Writing %zu packed bytes of line %d to the "
+                "raw binary file.", line_bytes, line);
+            error_handler (true, FUNC_NAME, errmsg);
+            free (packed);
+            return ERROR;
+        }
+    }
+
+    free (packed);
+    return SUCCESS;
+}
+
+
+/******************************************************************************
+MODULE: read_raw_binary_bitpacked
+
+PURPOSE: Reads nlines of bit-packed data from the raw binary file, expanding
+each sample to an 8-bit value of 0 or 1.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        An error occurred reading data from the raw binary file
+SUCCESS      Reading was successful
+
+NOTES:
+  1. Reads files written by write_raw_binary_bitpacked.
+*****************************************************************************/
+int read_raw_binary_bitpacked
+(
+    FILE *rb_fptr,      /* I: pointer to the raw binary file */
+    int nlines,         /* I: number of lines to read from the file */
+    int nsamps,         /* I: number of samples to read from the file */
+    uint8_t *img_array  /* O: array of nlines * nsamps 8-bit values
+                              (sufficient space should already have been
+                              allocated) */
+)
+{
+    char FUNC_NAME[] = "read_raw_binary_bitpacked"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    size_t line_bytes = RB_BITPACKED_LINE_BYTES (nsamps);
+                             /* number of packed bytes per line */
+    uint8_t *packed = NULL;  /* packed bits of the current line */
+    int line;                /* looping variable for the lines */
+
+    packed = malloc (line_bytes + 1);
+    if (packed == NULL)
+    {
+        sprintf (errmsg, "Allocating memory for the packed line");
+        error_handler (true, FUNC_NAME, errmsg);
+        return ERROR;
+    }
+
+    for (line = 0; line < nlines; line++)
+    {
+        if (rb_stream_io (rb_fptr, false, packed, line_bytes) != SUCCESS)
+        {
+            sprintf (errmsg, "Reading %zu packed bytes of line %d from the "
+                "raw binary file.", line_bytes, line);
+            error_handler (true, FUNC_NAME, errmsg);
+            free (packed);
+            return ERROR;
+        }
+        unpack_raw_binary_bits (nsamps, packed,
+            &img_array[(size_t) line * nsamps]);
+    }
+
+    free (packed);
+    return SUCCESS;
+}
+
+
+/******************************************************************************
+MODULE: write_raw_binary_rle
+
+PURPOSE: Writes nlines of 8-bit data to the raw binary file, run-length
+encoded one line at a time.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        An error occurred writing data to the raw binary file
+SUCCESS      Writing was successful
+
+NOTES:
+  1. Each line is written as the number of runs (uint32), the length of each
+     run (uint32), then the value of each run (uint8), all in the native
+     byte order.  The run lengths of a line add up to nsamps.
+  2. The lines are variable length, so the file can only be read in line
+     order with read_raw_binary_rle.
+*****************************************************************************/
+int write_raw_binary_rle
+(
+    FILE *rb_fptr,      /* I: pointer to the raw binary file */
+    int nlines,         /* I: number of lines to write to the file */
+    int nsamps,         /* I: number of samples to write to the file */
+    const uint8_t *img_array  /* I: array of nlines * nsamps 8-bit values to
+                              be encoded and written to the raw binary file */
+)
+{
+    char FUNC_NAME[] = "write_raw_binary_rle"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    uint32_t *encoded = NULL;/* encoded line; the run count, the run lengths,
+                                then the run values */
+    uint32_t *lengths;       /* run lengths of the current line */
+    uint8_t *values;         /* run values of the current line */
+    const uint8_t *in;       /* current input line */
+    uint32_t nruns;          /* number of runs in the current line */
+    int line;                /* looping variable for the lines */
+    int samp;                /* looping variable for the samples */
+
+    encoded = malloc (sizeof (uint32_t) * (nsamps + 1) + nsamps + 1);
+    if (encoded == NULL)
+    {
+        sprintf (errmsg, "Allocating memory for the encoded line");
+        error_handler (true, FUNC_NAME, errmsg);
+        return ERROR;
+    }
+    lengths = &encoded[1];
+
+    for (line = 0; line < nlines; line++)
+    {
+        in = &img_array[(size_t) line * nsamps];
+
+        /* Find the run lengths first, since the values follow them */
+        nruns = 0;
+        for (samp = 0; samp < nsamps; samp++)
+        {
+            if (samp == 0 || in[samp] != in[samp - 1])
+                lengths[nruns++] = 0;
+            lengths[nruns - 1]++;
+        }
+
+        values = (uint8_t *) &lengths[nruns];
+        nruns = 0;
+        for (samp = 0; samp < nsamps; samp++)
+        {
+            if (samp == 0 || in[samp] != in[samp - 1])
+                values[nruns++] = in[samp];
+        }
+        encoded[0] = nruns;
+
+        if (rb_stream_io (rb_fptr, true, encoded, sizeof (uint32_t)
+            * (nruns + 1) + nruns) != SUCCESS)
+        {
+            sprintf (errmsg, "Writing the %u runs of line %d to the raw "
+                "binary file.", nruns, line);
+            error_handler (true, FUNC_NAME, errmsg);
+            free (encoded);
+            return ERROR;
+        }
+    }
+
+    free (encoded);
+    return SUCCESS;
+}
+
+
+/******************************************************************************
+MODULE: read_raw_binary_rle
+
+PURPOSE: Reads and decodes nlines of run-length encoded 8-bit data from the
+raw binary file.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        An error occurred reading data from the raw binary file, or a
+             line did not decode to nsamps samples
+SUCCESS      Reading was successful
+
+NOTES:
+  1. Reads files written by write_raw_binary_rle, starting at the line at the
+     current file position.
+*****************************************************************************/
+int read_raw_binary_rle
+(
+    FILE *rb_fptr,      /* I: pointer to the raw binary file */
+    int nlines,         /* I: number of lines to read from the file */
+    int nsamps,         /* I: number of samples to read from the file */
+    uint8_t *img_array  /* O: array of nlines * nsamps 8-bit values
+                              (sufficient space should already have been
+                              allocated) */
+)
+{
+    char FUNC_NAME[] = "read_raw_binary_rle"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    uint32_t *lengths = NULL;/* run lengths, then run values, of the current
+                                line */
+    uint8_t *values;         /* run values of the current line */
+    uint8_t *out;            /* current output line */
+    uint32_t nruns;          /* number of runs in the current line */
+    uint32_t run;            /* looping variable for the runs */
+    size_t filled;           /* number of samples decoded in the line */
+    int line;                /* looping variable for the lines */
+
+    lengths = malloc (sizeof (uint32_t) * nsamps + nsamps + 1);
+    if (lengths == NULL)
+    {
+        sprintf (errmsg, "Allocating memory for the encoded line");
+        error_handler (true, FUNC_NAME, errmsg);
+        return ERROR;
+    }
+
+    for (line = 0; line < nlines; line++)
+    {
+        if (rb_stream_io (rb_fptr, false, &nruns, sizeof (nruns)) != SUCCESS
+            || nruns > (uint32_t) nsamps || (nruns == 0 && nsamps > 0)
+            || rb_stream_io (rb_fptr, false, lengths, sizeof (uint32_t)
+               * nruns + nruns) != SUCCESS)
+        {
+            sprintf (errmsg, "Reading the runs of line %d from the raw "
+                "binary file.", line);
+            error_handler (true, FUNC_NAME, errmsg);
+            free (lengths);
+            return ERROR;
+        }
+        values = (uint8_t *) &lengths[nruns];
+
+        out = &img_array[(size_t) line * nsamps];
+        filled = 0;
+        for (run = 0; run < nruns; run++)
+        {
+            if (lengths[run] > nsamps - filled)
+                break;
+            memset (&out[filled], values[run], lengths[run]);
+            filled += lengths[run];
+        }
+        if (filled != (size_t) nsamps || run != nruns)
+        {
+            sprintf (errmsg, "The runs of line %d do not decode to %d "
+                "samples.", line, nsamps);
+            error_handler (true, FUNC_NAME, errmsg);
+            free (lengths);
+            return ERROR;
+        }
+    }
+
+    free (lengths);
+    return SUCCESS;
+}
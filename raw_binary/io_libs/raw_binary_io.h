@@ -17,7 +17,59 @@ NOTES:
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <stdint.h>
+#include <sys/types.h>
 #include "error_handler.h"
+#include "espa_io_stats.h"
+
+/* Access pattern hints for a memory-mapped band, passed along to madvise */
+typedef enum {
+  RB_ADVISE_NORMAL,      /* no special treatment */
+  RB_ADVISE_SEQUENTIAL,  /* band will be traversed in line order */
+  RB_ADVISE_RANDOM,      /* band will be accessed randomly (i.e. windows) */
+  RB_ADVISE_WILLNEED,    /* lines will be needed soon, start reading ahead */
+  RB_ADVISE_DONTNEED     /* lines are no longer needed, release the pages */
+} Raw_binary_advice_t;
+
+/* Defines for bulk band writes which bypass the page cache */
+#define RB_DIRECT_ALIGN 4096      /* buffer/offset alignment for O_DIRECT */
+#define RB_DIRECT_STAGE_BYTES (8 * 1024 * 1024)  /* staging buffer size for
+                                     unaligned image buffers */
+#define RB_DIRECT_IO_ENV "ESPA_DIRECT_IO" /* set to yes to default to direct
+                                     I/O for bulk band writes */
+#define RB_COPY_CHUNK_BYTES (8 * 1024 * 1024)  /* buffer size for copies
+                                     which copy_file_range can't do */
+
+/* Set to yes to verify the checksums of the bands as they are read (see
+   raw_binary_checksum.h) */
+#define RB_VERIFY_ENV "ESPA_VERIFY_CHECKSUMS"
+
+/* Number of bytes in one line of a bit-packed band; each line starts on a
+   byte boundary */
+#define RB_BITPACKED_LINE_BYTES(nsamps) (((size_t) (nsamps) + 7) / 8)
+
+/* Write mode for bulk band writes */
+typedef enum {
+  RB_WRITE_BUFFERED,     /* regular writes through the page cache */
+  RB_WRITE_DIRECT,       /* O_DIRECT writes which bypass the page cache */
+  RB_WRITE_FROM_ENV      /* direct if RB_DIRECT_IO_ENV is yes, else buffered */
+} Raw_binary_write_mode_t;
+
+/* Memory-mapped view of a single raw binary band */
+typedef struct
+{
+    char file_name[STR_SIZE]; /* name of the mapped raw binary file */
+    int fd;                   /* file descriptor of the mapped file */
+    bool writable;            /* was the band mapped for read/write access? */
+    int nlines;               /* number of lines in the band */
+    int nsamps;               /* number of samples in the band */
+    int size;                 /* number of bytes per pixel */
+    size_t nbytes;            /* total number of bytes in the band */
+    size_t map_offset;        /* number of bytes mapped before the band, so
+                                 the mapping starts on a page boundary */
+    void *data;               /* start of the band data; cast to the data
+                                 type of the band (uint8_t *, int16_t *, ...) */
+} Raw_binary_map_t;
 
 /* Prototypes */
 FILE *open_raw_binary
@@ -54,4 +106,214 @@ int read_raw_binary
                               already have been allocated) */
 );
 
+int open_raw_binary_fd
+(
+    char *infile,        /* I: name of the input file to be opened */
+    bool writable        /* I: open for read/write (true) or read-only
+                               (false) access */
+);
+
+int open_raw_binary_band_fd
+(
+    char *infile,        /* I: name of the input file to be opened */
+    off_t band_offset,   /* I: byte offset of the band in the file */
+    bool writable        /* I: open for read/write (true) or read-only
+                               (false) access */
+);
+
+off_t get_raw_binary_band_offset
+(
+    int fd               /* I: file descriptor of the raw binary file */
+);
+
+void close_raw_binary_fd
+(
+    int fd               /* I: file descriptor of the raw binary file to be
+                               closed */
+);
+
+int pio_raw_binary
+(
+    int fd,             /* I: file descriptor of the raw binary file */
+    bool write_flag,    /* I: write (true) or read (false) */
+    void *buf,          /* I/O: buffer to be written or read into */
+    size_t nbytes,      /* I: number of bytes to transfer */
+    off_t offset        /* I: file offset for the transfer */
+);
+
+int read_raw_binary_window
+(
+    int fd,             /* I: file descriptor of the raw binary file */
+    int band_nsamps,    /* I: number of samples in a full line of the band */
+    int line0,          /* I: 0-based starting line of the window */
+    int nlines,         /* I: number of lines in the window */
+    int samp0,          /* I: 0-based starting sample of the window */
+    int nsamps,         /* I: number of samples in the window */
+    int size,           /* I: number of bytes per pixel (ex. sizeof(uint8)) */
+    void *img_array     /* O: array of nlines * nsamps * size to be read from
+                              the raw binary file (sufficient space should
+                              already have been allocated) */
+);
+
+void read_raw_binary_constant
+(
+    int nlines,         /* I: number of lines to synthesize */
+    int nsamps,         /* I: number of samples to synthesize */
+    int size,           /* I: number of bytes per pixel (ex. sizeof(uint8)) */
+    const void *pixel,  /* I: value of every pixel; size bytes */
+    void *img_array     /* O: array of nlines * nsamps * size to be filled
+                              (sufficient space should already have been
+                              allocated) */
+);
+
+int write_raw_binary_window
+(
+    int fd,             /* I: file descriptor of the raw binary file */
+    int band_nsamps,    /* I: number of samples in a full line of the band */
+    int line0,          /* I: 0-based starting line of the window */
+    int nlines,         /* I: number of lines in the window */
+    int samp0,          /* I: 0-based starting sample of the window */
+    int nsamps,         /* I: number of samples in the window */
+    int size,           /* I: number of bytes per pixel (ex. sizeof(uint8)) */
+    void *img_array     /* I: array of nlines * nsamps * size to be written
+                              to the raw binary file */
+);
+
+int map_raw_binary
+(
+    char *infile,            /* I: name of the raw binary file to be mapped */
+    int nlines,              /* I: number of lines in the band */
+    int nsamps,              /* I: number of samples in the band */
+    int size,                /* I: number of bytes per pixel */
+    bool writable,           /* I: map for read/write (true) or read-only
+                                   (false) access */
+    Raw_binary_advice_t advice, /* I: initial access pattern hint */
+    Raw_binary_map_t *rb_map /* O: mapped band view */
+);
+
+int map_raw_binary_band
+(
+    char *infile,            /* I: name of the raw binary file to be mapped */
+    off_t band_offset,       /* I: byte offset of the band in the file */
+    int nlines,              /* I: number of lines in the band */
+    int nsamps,              /* I: number of samples in the band */
+    int size,                /* I: number of bytes per pixel */
+    bool writable,           /* I: map for read/write (true) or read-only
+                                   (false) access */
+    Raw_binary_advice_t advice, /* I: initial access pattern hint */
+    Raw_binary_map_t *rb_map /* O: mapped band view */
+);
+
+void *get_raw_binary_map_line
+(
+    Raw_binary_map_t *rb_map,  /* I: mapped band view */
+    int line                   /* I: 0-based line to be accessed */
+);
+
+int advise_raw_binary_map
+(
+    Raw_binary_map_t *rb_map,   /* I: mapped band view */
+    int line0,                  /* I: first line of the hint */
+    int nlines,                 /* I: number of lines in the hint */
+    Raw_binary_advice_t advice  /* I: access pattern hint */
+);
+
+int unmap_raw_binary
+(
+    Raw_binary_map_t *rb_map   /* I/O: mapped band view to be released */
+);
+
+bool use_raw_binary_direct
+(
+    Raw_binary_write_mode_t mode  /* I: requested write mode */
+);
+
+bool use_raw_binary_verify (void);
+
+void *alloc_raw_binary_buf
+(
+    size_t nbytes        /* I: number of bytes needed */
+);
+
+int write_raw_binary_band
+(
+    char *outfile,      /* I: name of the raw binary file to be written */
+    int nlines,         /* I: number of lines in the band */
+    int nsamps,         /* I: number of samples in the band */
+    int size,           /* I: number of bytes per pixel (ex. sizeof(uint8)) */
+    void *img_array,    /* I: array of nlines * nsamps * size to be written */
+    Raw_binary_write_mode_t mode  /* I: buffered, direct, or per the
+                              RB_DIRECT_IO_ENV environment variable */
+);
+
+int copy_raw_binary_fd
+(
+    int in_fd,          /* I: file descriptor of the file holding the bytes */
+    off_t offset,       /* I: file offset of the first byte to be copied */
+    size_t nbytes,      /* I: number of bytes to be copied */
+    int out_fd          /* I: file descriptor of the file to be written */
+);
+
+int copy_raw_binary_range
+(
+    char *infile,       /* I: name of the file holding the bytes */
+    off_t offset,       /* I: file offset of the first byte to be copied */
+    size_t nbytes,      /* I: number of bytes to be copied */
+    char *outfile       /* I: name of the raw binary file to be written */
+);
+
+void pack_raw_binary_bits
+(
+    int nsamps,              /* I: number of samples in the line */
+    const uint8_t *line,     /* I: nsamps 8-bit values to be packed */
+    uint8_t *packed          /* O: RB_BITPACKED_LINE_BYTES(nsamps) bytes of
+                                   packed bits */
+);
+
+void unpack_raw_binary_bits
+(
+    int nsamps,              /* I: number of samples in the line */
+    const uint8_t *packed,   /* I: RB_BITPACKED_LINE_BYTES(nsamps) bytes of
+                                   packed bits */
+    uint8_t *line            /* O: nsamps 8-bit values */
+);
+
+int write_raw_binary_bitpacked
+(
+    FILE *rb_fptr,      /* I: pointer to the raw binary file */
+    int nlines,         /* I: number of lines to write to the file */
+    int nsamps,         /* I: number of samples to write to the file */
+    const uint8_t *img_array  /* I: array of nlines * nsamps 8-bit values to
+                              be packed and written to the raw binary file */
+);
+
+int read_raw_binary_bitpacked
+(
+    FILE *rb_fptr,      /* I: pointer to the raw binary file */
+    int nlines,         /* I: number of lines to read from the file */
+    int nsamps,         /* I: number of samples to read from the file */
+    uint8_t *img_array  /* O: array of nlines * nsamps 8-bit values
+                              (sufficient space should already have been
+                              allocated) */
+);
+
+int write_raw_binary_rle
+(
+    FILE *rb_fptr,      /* I: pointer to the raw binary file */
+    int nlines,         /* I: number of lines to write to the file */
+    int nsamps,         /* I: number of samples to write to the file */
+    const uint8_t *img_array  /* I: array of nlines * nsamps 8-bit values to
+                              be encoded and written to the raw binary file */
+);
+
+int read_raw_binary_rle
+(
+    FILE *rb_fptr,      /* I: pointer to the raw binary file */
+    int nlines,         /* I: number of lines to read from the file */
+    int nsamps,         /* I: number of samples to read from the file */
+    uint8_t *img_array  /* O: array of nlines * nsamps 8-bit values
+                              (sufficient space should already have been
+                              allocated) */
+);
+
 #endif
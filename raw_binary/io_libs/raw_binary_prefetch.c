@@ -0,0 +1,489 @@
+/*****************************************************************************
+FILE: raw_binary_prefetch.c
+
+PURPOSE: Contains functions for the read-ahead reader.  A background thread
+reads the next block(s) of lines for all of the bands as one batch, while the
+caller processes the current block.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. Blocks are handed to the caller in line order.  Requesting the next
+     block releases the previous block back to the background thread, so the
+     caller may modify a block in place (i.e. before writing it back out) but
+     must not use it after asking for the next block.
+*****************************************************************************/
+
+#include "raw_binary_prefetch.h"
+#include "raw_binary_advise.h"
+#include "espa_trace.h"
+
+/* States of each block buffer */
+#define RB_SLOT_EMPTY 0     /* available to be filled */
+#define RB_SLOT_FILLING 1   /* being read by the background thread */
+#define RB_SLOT_READY 2     /* read and waiting for the caller */
+#define RB_SLOT_IN_USE 3    /* held by the caller */
+
+/******************************************************************************
+MODULE: prefetch_thread
+
+PURPOSE: Background thread which fills empty blocks, in line order, until all
+the lines have been read, an error occurs, or the reader is stopped.
+
+RETURN VALUE:
+Type = void *
+Value        Description
+-----        -----------
+NULL         Always
+
+NOTES:
+*****************************************************************************/
+static void *prefetch_thread
+(
+    void *arg          /* I: read-ahead reader */
+)
+{
+    Raw_binary_prefetch_t *pf = arg;  /* read-ahead reader */
+    Rb_prefetch_block_t *block;       /* block being filled */
+    int slot;          /* block being filled */
+    int line0;         /* first line of the block being filled */
+    int nlines;        /* number of lines in the block being filled */
+    int i;             /* looping variable for the bands */
+    int win;           /* current window */
+    int status;        /* status of reading the block */
+
+    while (1)
+    {
+        /* Wait for the next block in line order to be available */
+        pthread_mutex_lock (&pf->mutex);
+        slot = pf->next_read_slot;
+        while (!pf->stop && pf->next_read_line < pf->nlines &&
+            pf->state[slot] != RB_SLOT_EMPTY)
+            pthread_cond_wait (&pf->cond, &pf->mutex);
+
+        if (pf->stop || pf->next_read_line >= pf->nlines)
+        {
+            pthread_mutex_unlock (&pf->mutex);
+            break;
+        }
+
+        line0 = pf->next_read_line;
+        nlines = pf->block_lines;
+        if (line0 + nlines > pf->nlines)
+            nlines = pf->nlines - line0;
+        pf->next_read_line += nlines;
+        pf->next_read_slot = (slot + 1) % pf->nbuffers;
+        pf->state[slot] = RB_SLOT_FILLING;
+        pthread_mutex_unlock (&pf->mutex);
+
+        /* Read the block for all bands as one batch without holding the
+           lock, asking for the block after it to be read ahead.  The
+           constant bands are synthesized instead. */
+        block = &pf->block[slot];
+        block->line0 = line0;
+        block->nlines = nlines;
+        for (i = 0, win = 0; i < pf->nbands; i++)
+        {
+            if (pf->fd[i] < 0)
+            {
+                read_raw_binary_constant (nlines, pf->nsamps[i], pf->size[i],
+                    pf->constant[i], block->band_buf[i]);
+                continue;
+            }
+            if (line0 + nlines < pf->nlines)
+                advise_raw_binary_lines (pf->fd[i], line0 + nlines,
+                    pf->block_lines, pf->nsamps[i], pf->size[i],
+                    RB_ADVISE_WILLNEED);
+            pf->windows[win].line0 = line0;
+            pf->windows[win].nlines = nlines;
+            pf->windows[win].img_array = block->band_buf[i];
+            win++;
+        }
+        status = SUCCESS;
+        if (pf->nwindows > 0)
+            status = read_raw_binary_batch (&pf->batch, pf->nwindows,
+                pf->windows);
+
+        /* Hand the block over to the caller */
+        pthread_mutex_lock (&pf->mutex);
+        if (status == SUCCESS)
+            pf->state[slot] = RB_SLOT_READY;
+        else
+            pf->error = true;
+        pthread_cond_broadcast (&pf->cond);
+        pthread_mutex_unlock (&pf->mutex);
+
+        if (status != SUCCESS)
+            break;
+    }
+
+    return NULL;
+}
+
+
+/******************************************************************************
+MODULE: open_raw_binary_prefetch
+
+PURPOSE: Opens the bands for reading, allocates the block buffers, and starts
+the background thread reading the first blocks.
+
+RETURN VALUE:
+Type = Raw_binary_prefetch_t *
+Value        Description
+-----        -----------
+NULL         Error opening the bands or starting the reader
+non-NULL     Read-ahead reader
+
+NOTES:
+  1. All the blocks for all the bands are carved out of a single allocation.
+     Each band within a block starts on a RB_PREFETCH_ALIGN byte boundary.
+  2. The bands may have different data types and sample counts, but must
+     all have the same number of lines.
+  3. Constant bands aren't read.  Their blocks are filled with the pixel
+     value by the background thread, so they may also be modified in place.
+*****************************************************************************/
+Raw_binary_prefetch_t *open_raw_binary_prefetch
+(
+    int nbands,          /* I: number of bands to be read */
+    char **band_files,   /* I: raw binary filename for each band; NULL for a
+                               constant band */
+    void **constant,     /* I: pixel value of each constant band (size
+                               bytes); NULL if none of the bands are
+                               constant */
+    off_t *band_offsets, /* I: byte offset of each band in its file (see
+                               open_raw_binary_band_fd); NULL if every band
+                               starts its file */
+    int *nsamps,         /* I: number of samples for each band */
+    int *size,           /* I: number of bytes per pixel for each band */
+    int nlines,          /* I: number of lines in each band */
+    int block_lines,     /* I: number of lines per block; use
+                               RB_PREFETCH_DEFAULT_LINES if not known */
+    int nbuffers         /* I: number of blocks in flight, 2 for double
+                               buffering or 3 for triple buffering */
+)
+{
+    char FUNC_NAME[] = "open_raw_binary_prefetch"; /* function name */
+    char errmsg[STR_SIZE];        /* error message */
+    int i;                        /* looping variable for the bands */
+    int slot;                     /* looping variable for the blocks */
+    size_t band_bytes;            /* aligned bytes for a band in a block */
+    size_t block_bytes;           /* bytes for all bands in a block */
+    char *ptr = NULL;             /* current position in the buffer */
+    Raw_binary_prefetch_t *pf = NULL;  /* read-ahead reader */
+
+    if (nbands <= 0 || nlines <= 0)
+    {
+        sprintf (errmsg, "Invalid number of bands (%d) or lines (%d)",
+            nbands, nlines);
+        error_handler (true, FUNC_NAME, errmsg);
+        return NULL;
+    }
+    if (block_lines <= 0)
+        block_lines = RB_PREFETCH_DEFAULT_LINES;
+    if (block_lines > nlines)
+        block_lines = nlines;
+    if (nbuffers < 2)
+        nbuffers = 2;
+    if (nbuffers > RB_PREFETCH_MAX_BUFFERS)
+        nbuffers = RB_PREFETCH_MAX_BUFFERS;
+
+    pf = calloc (1, sizeof (Raw_binary_prefetch_t));
+    if (pf == NULL)
+    {
+        sprintf (errmsg, "Allocating the read-ahead reader");
+        error_handler (true, FUNC_NAME, errmsg);
+        return NULL;
+    }
+    pf->nbands = nbands;
+    pf->nlines = nlines;
+    pf->block_lines = block_lines;
+    pf->nbuffers = nbuffers;
+    pf->curr_slot = -1;
+
+    pf->fd = calloc (nbands, sizeof (int));
+    if (pf->fd != NULL)
+    {
+        for (i = 0; i < nbands; i++)
+            pf->fd[i] = -1;
+    }
+    pf->constant = calloc (nbands, sizeof (void *));
+    pf->nsamps = calloc (nbands, sizeof (int));
+    pf->size = calloc (nbands, sizeof (int));
+    pf->windows = calloc (nbands, sizeof (Raw_binary_window_t));
+    for (slot = 0; slot < nbuffers; slot++)
+        pf->block[slot].band_buf = calloc (nbands, sizeof (void *));
+    for (slot = 0; slot < nbuffers; slot++)
+    {
+        if (pf->block[slot].band_buf == NULL)
+            break;
+    }
+    if (pf->fd == NULL || pf->constant == NULL || pf->nsamps == NULL ||
+        pf->size == NULL || pf->windows == NULL || slot < nbuffers)
+    {
+        sprintf (errmsg, "Allocating the band information for %d bands",
+            nbands);
+        error_handler (true, FUNC_NAME, errmsg);
+        close_raw_binary_prefetch (pf);
+        return NULL;
+    }
+
+    /* Determine the size of a block, aligning each band */
+    block_bytes = 0;
+    for (i = 0; i < nbands; i++)
+    {
+        pf->nsamps[i] = nsamps[i];
+        pf->size[i] = size[i];
+        band_bytes = (size_t) block_lines * nsamps[i] * size[i];
+        band_bytes = (band_bytes + RB_PREFETCH_ALIGN - 1) /
+            RB_PREFETCH_ALIGN * RB_PREFETCH_ALIGN;
+        block_bytes += band_bytes;
+    }
+
+    /* Allocate all the blocks at once and carve out the band buffers */
+    if (espa_trace_posix_memalign (&pf->buf, RB_PREFETCH_ALIGN,
+        block_bytes * nbuffers) != 0)
+    {
+        pf->buf = NULL;
+        sprintf (errmsg, "Allocating %d blocks of %zu bytes for the "
+            "read-ahead reader", nbuffers, block_bytes);
+        error_handler (true, FUNC_NAME, errmsg);
+        close_raw_binary_prefetch (pf);
+        return NULL;
+    }
+    ptr = pf->buf;
+    for (slot = 0; slot < nbuffers; slot++)
+    {
+        for (i = 0; i < nbands; i++)
+        {
+            pf->block[slot].band_buf[i] = ptr;
+            band_bytes = (size_t) block_lines * nsamps[i] * size[i];
+            ptr += (band_bytes + RB_PREFETCH_ALIGN - 1) / RB_PREFETCH_ALIGN *
+                RB_PREFETCH_ALIGN;
+        }
+        pf->state[slot] = RB_SLOT_EMPTY;
+    }
+
+    /* Open the bands, and hang on to the pixel values of the constant
+       bands */
+    for (i = 0; i < nbands; i++)
+    {
+        if (band_files[i] == NULL)
+        {
+            if (constant == NULL || constant[i] == NULL)
+            {
+                sprintf (errmsg, "Band %d has neither a file nor a constant "
+                    "value for the read-ahead reader", i);
+                error_handler (true, FUNC_NAME, errmsg);
+                close_raw_binary_prefetch (pf);
+                return NULL;
+            }
+            pf->constant[i] = malloc (size[i]);
+            if (pf->constant[i] == NULL)
+            {
+                sprintf (errmsg, "Allocating the constant value of band %d",
+                    i);
+                error_handler (true, FUNC_NAME, errmsg);
+                close_raw_binary_prefetch (pf);
+                return NULL;
+            }
+            memcpy (pf->constant[i], constant[i], size[i]);
+            continue;
+        }
+
+        pf->fd[i] = open_raw_binary_band_fd (band_files[i],
+            band_offsets == NULL ? 0 : band_offsets[i], false);
+        if (pf->fd[i] == ERROR)
+        {
+            sprintf (errmsg, "Opening band %s for the read-ahead reader",
+                band_files[i]);
+            error_handler (true, FUNC_NAME, errmsg);
+            close_raw_binary_prefetch (pf);
+            return NULL;
+        }
+        advise_raw_binary_lines (pf->fd[i], 0, 0, nsamps[i], size[i],
+            RB_ADVISE_SEQUENTIAL);
+        pf->windows[pf->nwindows].fd = pf->fd[i];
+        pf->windows[pf->nwindows].band_nsamps = nsamps[i];
+        pf->windows[pf->nwindows].samp0 = 0;
+        pf->windows[pf->nwindows].nsamps = nsamps[i];
+        pf->windows[pf->nwindows].size = size[i];
+        pf->nwindows++;
+    }
+
+    /* Set up the batched reads, one request per band for each block */
+    if (init_raw_binary_batch (nbands, &pf->batch) != SUCCESS)
+    {
+        sprintf (errmsg, "Initializing the batched reads for the read-ahead "
+            "reader");
+        error_handler (true, FUNC_NAME, errmsg);
+        close_raw_binary_prefetch (pf);
+        return NULL;
+    }
+    pf->batch_started = true;
+
+    /* Start reading */
+    pthread_mutex_init (&pf->mutex, NULL);
+    pthread_cond_init (&pf->cond, NULL);
+    if (pthread_create (&pf->thread, NULL, prefetch_thread, pf) != 0)
+    {
+        sprintf (errmsg, "Starting the read-ahead thread");
+        error_handler (true, FUNC_NAME, errmsg);
+        pthread_mutex_destroy (&pf->mutex);
+        pthread_cond_destroy (&pf->cond);
+        close_raw_binary_prefetch (pf);
+        return NULL;
+    }
+    pf->thread_started = true;
+
+    return pf;
+}
+
+
+/******************************************************************************
+MODULE: get_raw_binary_prefetch_block
+
+PURPOSE: Releases the block currently held by the caller and waits for the
+next block of lines to be read.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        The background thread was not able to read the next block
+SUCCESS      The next block was returned, or NULL if all lines have been read
+
+NOTES:
+*****************************************************************************/
+int get_raw_binary_prefetch_block
+(
+    Raw_binary_prefetch_t *prefetch,  /* I: read-ahead reader */
+    Rb_prefetch_block_t **block       /* O: next block of lines; NULL once
+                                            all the lines have been read */
+)
+{
+    char FUNC_NAME[] = "get_raw_binary_prefetch_block"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    Raw_binary_prefetch_t *pf = prefetch;  /* read-ahead reader */
+    Rb_prefetch_block_t *done = NULL;  /* block the caller is done with */
+    int slot;                /* next block to be handed out */
+    int i;                   /* looping variable for the bands */
+
+    *block = NULL;
+
+    /* Drop the lines of the current block, which only the caller uses until
+       it is released */
+    if (pf->drop_behind && pf->curr_slot >= 0)
+    {
+        done = &pf->block[pf->curr_slot];
+        for (i = 0; i < pf->nbands; i++)
+            advise_raw_binary_lines (pf->fd[i], done->line0, done->nlines,
+                pf->nsamps[i], pf->size[i], RB_ADVISE_DONTNEED);
+    }
+
+    pthread_mutex_lock (&pf->mutex);
+
+    /* Release the current block so it can be refilled */
+    if (pf->curr_slot >= 0)
+    {
+        pf->state[pf->curr_slot] = RB_SLOT_EMPTY;
+        pf->curr_slot = -1;
+        pthread_cond_broadcast (&pf->cond);
+    }
+
+    /* Have all the lines been handed out? */
+    if (pf->next_get_line >= pf->nlines)
+    {
+        pthread_mutex_unlock (&pf->mutex);
+        return SUCCESS;
+    }
+
+    /* Wait for the next block */
+    slot = pf->next_get_slot;
+    while (!pf->error && pf->state[slot] != RB_SLOT_READY)
+        pthread_cond_wait (&pf->cond, &pf->mutex);
+
+    if (pf->state[slot] != RB_SLOT_READY)
+    {
+        pthread_mutex_unlock (&pf->mutex);
+        sprintf (errmsg, "Reading the next block of lines in the background");
+        error_handler (true, FUNC_NAME, errmsg);
+        return ERROR;
+    }
+
+    pf->state[slot] = RB_SLOT_IN_USE;
+    pf->curr_slot = slot;
+    pf->next_get_slot = (slot + 1) % pf->nbuffers;
+    pf->next_get_line = pf->block[slot].line0 + pf->block[slot].nlines;
+    pthread_mutex_unlock (&pf->mutex);
+
+    *block = &pf->block[slot];
+    return SUCCESS;
+}
+
+
+/******************************************************************************
+MODULE: close_raw_binary_prefetch
+
+PURPOSE: Stops the background thread, closes the bands, and frees the
+read-ahead reader.
+
+RETURN VALUE:
+Type = N/A
+
+NOTES:
+  1. May be called before all the blocks have been read.
+*****************************************************************************/
+void close_raw_binary_prefetch
+(
+    Raw_binary_prefetch_t *prefetch   /* I: read-ahead reader to be closed */
+)
+{
+    Raw_binary_prefetch_t *pf = prefetch;  /* read-ahead reader */
+    int i;                  /* looping variable */
+
+    if (pf == NULL)
+        return;
+
+    /* Stop the background thread */
+    if (pf->thread_started)
+    {
+        pthread_mutex_lock (&pf->mutex);
+        pf->stop = true;
+        pthread_cond_broadcast (&pf->cond);
+        pthread_mutex_unlock (&pf->mutex);
+        pthread_join (pf->thread, NULL);
+        pthread_mutex_destroy (&pf->mutex);
+        pthread_cond_destroy (&pf->cond);
+    }
+
+    if (pf->batch_started)
+        close_raw_binary_batch (&pf->batch);
+
+    /* Close the bands */
+    if (pf->fd != NULL)
+    {
+        for (i = 0; i < pf->nbands; i++)
+        {
+            if (pf->fd[i] >= 0)
+                close_raw_binary_fd (pf->fd[i]);
+        }
+    }
+    if (pf->constant != NULL)
+    {
+        for (i = 0; i < pf->nbands; i++)
+            free (pf->constant[i]);
+    }
+
+    for (i = 0; i < RB_PREFETCH_MAX_BUFFERS; i++)
+        free (pf->block[i].band_buf);
+    espa_trace_free (pf->buf);
+    free (pf->fd);
+    free (pf->constant);
+    free (pf->nsamps);
+    free (pf->size);
+    free (pf->windows);
+    free (pf);
+}
@@ -0,0 +1,118 @@
+/*****************************************************************************
+FILE: raw_binary_prefetch.h
+
+PURPOSE: Contains defines and structures for the read-ahead reader, which
+reads the next block of lines for a set of raw binary bands on a background
+thread while the caller processes the current block.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The bands are advised as read sequentially, and the block after the
+     ones being read is asked for ahead of time (see raw_binary_advise.h).
+     A reader whose bands won't be read again (ex. they are deleted once
+     they are converted) may set drop_behind, so each block is dropped from
+     the page cache once the caller is done with it.
+*****************************************************************************/
+
+#ifndef RAW_BINARY_PREFETCH_H
+#define RAW_BINARY_PREFETCH_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include "error_handler.h"
+#include "raw_binary_io.h"
+#include "raw_binary_batch.h"
+
+/* Defines */
+#define RB_PREFETCH_MAX_BUFFERS 3   /* triple buffering at most */
+#define RB_PREFETCH_DEFAULT_LINES 64 /* default number of lines per block */
+#define RB_PREFETCH_ALIGN 64        /* alignment of each band in a block */
+
+/* Block of lines for all bands handed to the caller */
+typedef struct
+{
+    int line0;           /* 0-based first line of the block */
+    int nlines;          /* number of lines in the block */
+    void **band_buf;     /* nlines * nsamps * size buffer for each band;
+                            cast to the data type of the band */
+} Rb_prefetch_block_t;
+
+/* Read-ahead reader for a set of bands with the same number of lines */
+typedef struct
+{
+    int nbands;          /* number of bands being read */
+    int nlines;          /* number of lines in each band */
+    int block_lines;     /* number of lines in a full block */
+    int nbuffers;        /* number of blocks in flight (2 or 3) */
+    int *fd;             /* file descriptor for each band; -1 for a
+                            constant band */
+    void **constant;     /* pixel value of each constant band, which has no
+                            file and is synthesized; NULL for other bands */
+    int *nsamps;         /* number of samples for each band */
+    int *size;           /* number of bytes per pixel for each band */
+    void *buf;           /* single allocation holding all blocks */
+    Rb_prefetch_block_t block[RB_PREFETCH_MAX_BUFFERS];
+                         /* blocks handed to the caller */
+    int state[RB_PREFETCH_MAX_BUFFERS];
+                         /* state of each block (see RB_SLOT_* in the .c) */
+    int next_read_line;  /* next line to be read by the background thread */
+    int next_read_slot;  /* next block to be filled by the background thread*/
+    int next_get_slot;   /* next block to be handed to the caller */
+    int next_get_line;   /* first line of the next block for the caller */
+    int curr_slot;       /* block currently held by the caller; -1 if none */
+    bool error;          /* did the background thread fail to read? */
+    bool stop;           /* has the reader been asked to stop? */
+    bool thread_started; /* was the background thread started? */
+    bool drop_behind;    /* drop the lines of each block from the page cache
+                            once the caller is done with it? */
+    bool batch_started;  /* was the batched I/O engine initialized? */
+    Raw_binary_batch_t batch; /* batched I/O engine used by the background
+                            thread to read all the bands of a block */
+    int nwindows;        /* number of bands read from their files */
+    Raw_binary_window_t *windows; /* window of each band read from its file,
+                            in band order, for the block being read */
+    pthread_t thread;    /* background read thread */
+    pthread_mutex_t mutex; /* protects the block states */
+    pthread_cond_t cond; /* signals changes in the block states */
+} Raw_binary_prefetch_t;
+
+/* Prototypes */
+Raw_binary_prefetch_t *open_raw_binary_prefetch
+(
+    int nbands,          /* I: number of bands to be read */
+    char **band_files,   /* I: raw binary filename for each band; NULL for a
+                               constant band */
+    void **constant,     /* I: pixel value of each constant band (size
+                               bytes); NULL if none of the bands are
+                               constant */
+    off_t *band_offsets, /* I: byte offset of each band in its file (see
+                               open_raw_binary_band_fd); NULL if every band
+                               starts its file */
+    int *nsamps,         /* I: number of samples for each band */
+    int *size,           /* I: number of bytes per pixel for each band */
+    int nlines,          /* I: number of lines in each band */
+    int block_lines,     /* I: number of lines per block; use
+                               RB_PREFETCH_DEFAULT_LINES if not known */
+    int nbuffers         /* I: number of blocks in flight, 2 for double
+                               buffering or 3 for triple buffering */
+);
+
+int get_raw_binary_prefetch_block
+(
+    Raw_binary_prefetch_t *prefetch,  /* I: read-ahead reader */
+    Rb_prefetch_block_t **block       /* O: next block of lines; NULL once
+                                            all the lines have been read */
+);
+
+void close_raw_binary_prefetch
+(
+    Raw_binary_prefetch_t *prefetch   /* I: read-ahead reader to be closed */
+);
+
+#endif
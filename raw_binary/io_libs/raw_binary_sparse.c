@@ -0,0 +1,816 @@
+/*****************************************************************************
+FILE: raw_binary_sparse.c
+
+PURPOSE: Contains functions for the fill regions of raw binary bands.  The
+writer checks each block of the band for fill as it is written, and the
+window reads fill in the regions from memory instead of reading them.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The fill regions of a band with holes are found with SEEK_HOLE and
+     SEEK_DATA once, when the band is opened, rather than on every read.
+  2. Fill regions are only attached to bands opened read-only, since a band
+     opened for read/write access may have its fill overwritten.
+*****************************************************************************/
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE     /* for SEEK_HOLE and SEEK_DATA */
+#endif
+#include <unistd.h>
+#include <errno.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include "raw_binary_io.h"
+#include "raw_binary_sparse.h"
+#include "espa_staging.h"
+#include "espa_band_stack.h"
+
+/* Fill regions attached to the open file descriptors, indexed by the file
+   descriptor */
+static pthread_mutex_t rb_sparse_mutex = PTHREAD_MUTEX_INITIALIZER;
+static Raw_binary_sparse_t **rb_sparse_by_fd = NULL;
+static int rb_sparse_nfds = 0;
+
+
+/******************************************************************************
+MODULE: use_raw_binary_sparse
+
+PURPOSE: Determines whether the fill regions of a band are skipped as it is
+written.
+
+RETURN VALUE:
+Type = bool
+Value        Description
+-----        -----------
+true         Skip the fill regions
+false        Write all the blocks as is
+
+NOTES:
+  1. For RB_SPARSE_FROM_ENV, the fill regions are skipped if the
+     RB_SPARSE_ENV environment variable is set to "yes" or "1".
+*****************************************************************************/
+bool use_raw_binary_sparse
+(
+    Raw_binary_sparse_mode_t mode  /* I: requested fill region mode */
+)
+{
+    char *env = NULL;    /* value of the environment variable */
+
+    if (mode == RB_SPARSE_ON)
+        return true;
+    if (mode == RB_SPARSE_OFF)
+        return false;
+
+    env = getenv (RB_SPARSE_ENV);
+    if (env == NULL)
+        return false;
+    return (!strcmp (env, "yes") || !strcmp (env, "1"));
+}
+
+
+/******************************************************************************
+MODULE: rb_sparse_alloc
+
+PURPOSE: Allocates the fill regions for the fill pixel and builds the block
+of fill pixels.
+
+RETURN VALUE:
+Type = Raw_binary_sparse_t *
+Value        Description
+-----        -----------
+NULL         Error allocating the fill regions
+non-NULL     Fill regions with no runs
+
+NOTES:
+*****************************************************************************/
+static Raw_binary_sparse_t *rb_sparse_alloc
+(
+    int size,                  /* I: number of bytes per pixel */
+    const unsigned char *fill  /* I: fill pixel, size bytes */
+)
+{
+    char FUNC_NAME[] = "rb_sparse_alloc"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    int i;                   /* looping variable */
+    Raw_binary_sparse_t *sparse = NULL;  /* fill regions */
+
+    sparse = calloc (1, sizeof (Raw_binary_sparse_t));
+    if (sparse != NULL)
+        sparse->pattern = malloc (RB_SPARSE_BLOCK_BYTES);
+    if (sparse == NULL || sparse->pattern == NULL)
+    {
+        sprintf (errmsg, "Allocating the fill regions of a raw binary band");
+        error_handler (true, FUNC_NAME, errmsg);
+        free (sparse);
+        return NULL;
+    }
+
+    sparse->size = size;
+    memcpy (sparse->fill, fill, size);
+    sparse->holes = true;
+    for (i = 0; i < size; i++)
+    {
+        if (fill[i] != 0)
+            sparse->holes = false;
+    }
+    for (i = 0; i < RB_SPARSE_BLOCK_BYTES; i += size)
+        memcpy (sparse->pattern + i, fill, size);
+
+    return sparse;
+}
+
+
+/******************************************************************************
+MODULE: open_raw_binary_sparse
+
+PURPOSE: Sets up the fill regions of a band which is about to be written.
+
+RETURN VALUE:
+Type = Raw_binary_sparse_t *
+Value        Description
+-----        -----------
+NULL         The band has no fill value, or an error allocating the fill
+             regions
+non-NULL     Fill regions with no runs
+
+NOTES:
+  1. The fill regions are holes if the fill pixel is all zero bytes (i.e. a
+     fill_value of 0), otherwise they are recorded as fill runs.
+*****************************************************************************/
+Raw_binary_sparse_t *open_raw_binary_sparse
+(
+    const Espa_band_meta_t *bmeta  /* I: metadata of the band; its data_type
+                                         and fill_value are used */
+)
+{
+    union
+    {
+        int8_t i8;
+        uint8_t u8;
+        int16_t i16;
+        uint16_t u16;
+        int32_t i32;
+        uint32_t u32;
+        float f32;
+        double f64;
+        unsigned char bytes[8];
+    } fill;                  /* fill pixel */
+    int size;                /* number of bytes per pixel */
+
+    if (bmeta->fill_value == ESPA_INT_META_FILL)
+        return NULL;
+
+    memset (&fill, 0, sizeof (fill));
+    switch (bmeta->data_type)
+    {
+        case ESPA_INT8:
+            fill.i8 = (int8_t) bmeta->fill_value;
+            break;
+        case ESPA_UINT8:
+            fill.u8 = (uint8_t) bmeta->fill_value;
+            break;
+        case ESPA_INT16:
+            fill.i16 = (int16_t) bmeta->fill_value;
+            break;
+        case ESPA_UINT16:
+            fill.u16 = (uint16_t) bmeta->fill_value;
+            break;
+        case ESPA_INT32:
+            fill.i32 = (int32_t) bmeta->fill_value;
+            break;
+        case ESPA_UINT32:
+            fill.u32 = (uint32_t) bmeta->fill_value;
+            break;
+        case ESPA_FLOAT32:
+            fill.f32 = (float) bmeta->fill_value;
+            break;
+        case ESPA_FLOAT64:
+            fill.f64 = (double) bmeta->fill_value;
+            break;
+        default:
+            return NULL;
+    }
+    size = espa_data_type_size (bmeta->data_type);
+
+    return rb_sparse_alloc (size, fill.bytes);
+}
+
+
+/******************************************************************************
+MODULE: is_raw_binary_fill_block
+
+PURPOSE: Checks whether a block of the band holds nothing but fill.
+
+RETURN VALUE:
+Type = bool
+Value        Description
+-----        -----------
+true         Every pixel of the block is fill
+false        Some pixel of the block isn't fill
+
+NOTES:
+  1. The block must start on a pixel boundary of the band.
+*****************************************************************************/
+bool is_raw_binary_fill_block
+(
+    const Raw_binary_sparse_t *sparse, /* I: fill regions of the band */
+    const void *block              /* I: RB_SPARSE_BLOCK_BYTES of the band */
+)
+{
+    return memcmp (block, sparse->pattern, RB_SPARSE_BLOCK_BYTES) == 0;
+}
+
+
+/******************************************************************************
+MODULE: add_raw_binary_fill_run
+
+PURPOSE: Adds a region of fill after the runs already added, merging it with
+the last run if they are adjacent.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error allocating the runs
+SUCCESS      The fill was added
+
+NOTES:
+*****************************************************************************/
+int add_raw_binary_fill_run
+(
+    Raw_binary_sparse_t *sparse,   /* I/O: fill regions of the band */
+    off_t offset,                  /* I: file offset of the fill */
+    size_t nbytes                  /* I: number of bytes of fill */
+)
+{
+    char FUNC_NAME[] = "add_raw_binary_fill_run"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    Rb_fill_run_t *last;     /* last run added */
+    Rb_fill_run_t *runs = NULL;  /* resized runs */
+    int max_runs;            /* resized number of runs */
+
+    if (sparse->nruns > 0)
+    {
+        last = &sparse->runs[sparse->nruns - 1];
+        if (last->offset + (off_t) last->nbytes == offset)
+        {
+            last->nbytes += nbytes;
+            return SUCCESS;
+        }
+    }
+
+    if (sparse->nruns == sparse->max_runs)
+    {
+        max_runs = sparse->max_runs > 0 ? 2 * sparse->max_runs : 64;
+        runs = realloc (sparse->runs, max_runs * sizeof (*runs));
+        if (runs == NULL)
+        {
+            sprintf (errmsg, "Allocating %d fill runs", max_runs);
+            error_handler (true, FUNC_NAME, errmsg);
+            return ERROR;
+        }
+        sparse->runs = runs;
+        sparse->max_runs = max_runs;
+    }
+
+    sparse->runs[sparse->nruns].offset = offset;
+    sparse->runs[sparse->nruns].nbytes = nbytes;
+    sparse->nruns++;
+
+    return SUCCESS;
+}
+
+
+/******************************************************************************
+MODULE: rb_fill_runs_name
+
+PURPOSE: Forms the name of the fill runs sidecar of a band file.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        The name is too long
+SUCCESS      The name was formed
+
+NOTES:
+*****************************************************************************/
+static int rb_fill_runs_name
+(
+    const char *infile,  /* I: name of the band file */
+    char *runs_file      /* O: name of the sidecar; STR_SIZE bytes */
+)
+{
+    if (snprintf (runs_file, STR_SIZE, "%s%s", infile, RB_FILL_RUNS_EXT)
+        >= STR_SIZE)
+        return ERROR;
+
+    return SUCCESS;
+}
+
+
+/******************************************************************************
+MODULE: write_raw_binary_fill_runs
+
+PURPOSE: Writes the fill runs sidecar of a band file which has been written
+and closed.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error writing the sidecar
+SUCCESS      The sidecar was written, or there are no runs to write
+
+NOTES:
+  1. Fill regions which are holes need no sidecar.
+*****************************************************************************/
+int write_raw_binary_fill_runs
+(
+    const Raw_binary_sparse_t *sparse, /* I: fill regions of the band */
+    const char *infile             /* I: name of the band file, which has
+                                         been closed */
+)
+{
+    char FUNC_NAME[] = "write_raw_binary_fill_runs"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    char runs_file[STR_SIZE]; /* name of the sidecar */
+    char band_path[STR_SIZE]; /* name the band file is found under */
+    char runs_path[STR_SIZE]; /* name the sidecar is created under */
+    struct stat statbuf;     /* status of the band file */
+    FILE *fp = NULL;         /* sidecar */
+    int i;                   /* looping variable */
+    int status;              /* status of the writes */
+
+    if (sparse->holes || sparse->nruns == 0)
+        return SUCCESS;
+
+    if (rb_fill_runs_name (infile, runs_file) != SUCCESS ||
+        espa_staging_path (infile, ESPA_STAGE_READ, band_path,
+        sizeof (band_path)) != SUCCESS || stat (band_path, &statbuf) != 0)
+    {
+        sprintf (errmsg, "Finding the fill runs sidecar of %s", infile);
+        error_handler (true, FUNC_NAME, errmsg);
+        return ERROR;
+    }
+
+    if (espa_staging_path (runs_file, ESPA_STAGE_CREATE, runs_path,
+        sizeof (runs_path)) != SUCCESS)
+        return ERROR;
+    fp = fopen (runs_path, "w");
+    if (fp == NULL)
+    {
+        sprintf (errmsg, "Creating the fill runs sidecar %s", runs_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        espa_staging_done (runs_file);
+        return ERROR;
+    }
+
+    fprintf (fp, "%s %d ", RB_FILL_RUNS_MAGIC, sparse->size);
+    for (i = 0; i < sparse->size; i++)
+        fprintf (fp, "%02x", sparse->fill[i]);
+    fprintf (fp, "\n%lld %lld %ld\n", (long long) statbuf.st_size,
+        (long long) statbuf.st_mtim.tv_sec, (long) statbuf.st_mtim.tv_nsec);
+    for (i = 0; i < sparse->nruns; i++)
+        fprintf (fp, "%lld %zu\n", (long long) sparse->runs[i].offset,
+            sparse->runs[i].nbytes);
+
+    status = ferror (fp) ? ERROR : SUCCESS;
+    if (fclose (fp) != 0)
+        status = ERROR;
+    if (status != SUCCESS)
+    {
+        sprintf (errmsg, "Writing the fill runs sidecar %s", runs_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        unlink (runs_path);
+        espa_staging_done (runs_file);
+        return ERROR;
+    }
+    espa_staging_done (runs_file);
+
+    return SUCCESS;
+}
+
+
+/******************************************************************************
+MODULE: remove_raw_binary_fill_runs
+
+PURPOSE: Removes the fill runs sidecar of a band file, if there is one.
+
+RETURN VALUE:
+Type = N/A
+
+NOTES:
+  1. Called when the band file is rewritten, so its old fill runs don't
+     outlive it.  A staged copy of the sidecar (see espa_staging.h) is
+     removed too.
+*****************************************************************************/
+void remove_raw_binary_fill_runs
+(
+    const char *infile             /* I: name of the band file */
+)
+{
+    char runs_file[STR_SIZE]; /* name of the sidecar */
+    char runs_path[STR_SIZE]; /* name of its staged copy */
+
+    if (rb_fill_runs_name (infile, runs_file) != SUCCESS)
+        return;
+    unlink (runs_file);
+    if (espa_staging_path (runs_file, ESPA_STAGE_READ, runs_path,
+        sizeof (runs_path)) == SUCCESS && strcmp (runs_path, runs_file))
+        unlink (runs_path);
+}
+
+
+/******************************************************************************
+MODULE: free_raw_binary_sparse
+
+PURPOSE: Frees the fill regions of a band.
+
+RETURN VALUE:
+Type = N/A
+
+NOTES:
+*****************************************************************************/
+void free_raw_binary_sparse
+(
+    Raw_binary_sparse_t *sparse    /* I: fill regions to be freed */
+)
+{
+    if (sparse == NULL)
+        return;
+
+    free (sparse->pattern);
+    free (sparse->runs);
+    free (sparse);
+}
+
+
+/******************************************************************************
+MODULE: rb_read_fill_runs
+
+PURPOSE: Reads the fill runs sidecar of a band file.
+
+RETURN VALUE:
+Type = Raw_binary_sparse_t *
+Value        Description
+-----        -----------
+NULL         There is no sidecar, or it doesn't match the band file
+non-NULL     Fill runs of the band file
+
+NOTES:
+  1. A sidecar which can't be used is skipped rather than being an error,
+     since the band file can be read without it.
+*****************************************************************************/
+static Raw_binary_sparse_t *rb_read_fill_runs
+(
+    char *infile,                  /* I: name of the band file */
+    const struct stat *statbuf     /* I: status of the band file */
+)
+{
+    char runs_file[STR_SIZE]; /* name of the sidecar */
+    char magic[STR_SIZE];    /* first word of the sidecar */
+    char hex[STR_SIZE];      /* fill pixel, in hex */
+    unsigned char fill[8];   /* fill pixel */
+    unsigned int byte;       /* byte of the fill pixel */
+    int size;                /* number of bytes per pixel */
+    int i;                   /* looping variable */
+    long long file_bytes;    /* size of the band file */
+    long long mtime_sec;     /* modification time of the band file */
+    long mtime_nsec;         /* nanoseconds of the modification time */
+    long long offset;        /* file offset of a run */
+    size_t nbytes;           /* number of bytes in a run */
+    FILE *fp = NULL;         /* sidecar */
+    Raw_binary_sparse_t *sparse = NULL;  /* fill runs */
+
+    if (rb_fill_runs_name (infile, runs_file) != SUCCESS)
+        return NULL;
+    fp = fopen (runs_file, "r");
+    if (fp == NULL)
+        return NULL;
+
+    if (fscanf (fp, "%255s %d %255s %lld %lld %ld", magic, &size, hex,
+        &file_bytes, &mtime_sec, &mtime_nsec) != 6 ||
+        strcmp (magic, RB_FILL_RUNS_MAGIC) || size < 1 || size > 8 ||
+        strlen (hex) != (size_t) size * 2 ||
+        file_bytes != (long long) statbuf->st_size ||
+        mtime_sec != (long long) statbuf->st_mtim.tv_sec ||
+        mtime_nsec != (long) statbuf->st_mtim.tv_nsec)
+    {
+        fclose (fp);
+        return NULL;
+    }
+    for (i = 0; i < size; i++)
+    {
+        sscanf (hex + 2 * i, "%2x", &byte);
+        fill[i] = (unsigned char) byte;
+    }
+
+    sparse = rb_sparse_alloc (size, fill);
+    while (sparse != NULL && fscanf (fp, "%lld %zu", &offset, &nbytes) == 2)
+    {
+        if (offset < 0 || (sparse->nruns > 0 && offset <
+            sparse->runs[sparse->nruns - 1].offset +
+            (off_t) sparse->runs[sparse->nruns - 1].nbytes) ||
+            add_raw_binary_fill_run (sparse, (off_t) offset, nbytes)
+            != SUCCESS)
+        {
+            free_raw_binary_sparse (sparse);
+            sparse = NULL;
+        }
+    }
+    fclose (fp);
+
+    return sparse;
+}
+
+
+/******************************************************************************
+MODULE: rb_find_holes
+
+PURPOSE: Finds the holes of a band file.
+
+RETURN VALUE:
+Type = Raw_binary_sparse_t *
+Value        Description
+-----        -----------
+NULL         The file has no holes, or they can't be found
+non-NULL     Holes of the band file
+
+NOTES:
+*****************************************************************************/
+static Raw_binary_sparse_t *rb_find_holes
+(
+    int fd,                        /* I: file descriptor of the band file */
+    const struct stat *statbuf     /* I: status of the band file */
+)
+{
+#if defined (SEEK_HOLE) && defined (SEEK_DATA)
+    unsigned char zero[8] = {0}; /* fill pixel of the holes */
+    off_t hole;              /* start of the current hole */
+    off_t data;              /* end of the current hole */
+    Raw_binary_sparse_t *sparse = NULL;  /* holes */
+
+    /* Files without holes have all of their blocks allocated */
+    if ((off_t) statbuf->st_blocks * 512 >= statbuf->st_size)
+        return NULL;
+
+    sparse = rb_sparse_alloc (1, zero);
+    if (sparse == NULL)
+        return NULL;
+
+    for (data = 0; data < statbuf->st_size; )
+    {
+        hole = lseek (fd, data, SEEK_HOLE);
+        if (hole < 0 || hole >= statbuf->st_size)
+            break;
+        data = lseek (fd, hole, SEEK_DATA);
+        if (data < 0)
+            data = statbuf->st_size;   /* the hole runs to the end */
+        if (add_raw_binary_fill_run (sparse, hole, data - hole) != SUCCESS)
+        {
+            free_raw_binary_sparse (sparse);
+            return NULL;
+        }
+    }
+
+    if (sparse->nruns == 0)
+    {
+        free_raw_binary_sparse (sparse);
+        return NULL;
+    }
+    return sparse;
+#else
+    return NULL;
+#endif
+}
+
+
+/******************************************************************************
+MODULE: attach_raw_binary_sparse
+
+PURPOSE: Finds the fill regions of a band file, from its fill runs sidecar or
+its holes, and attaches them to the file descriptor for the window reads.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error registering the fill regions
+SUCCESS      The fill regions were attached, or the file has none
+
+NOTES:
+*****************************************************************************/
+int attach_raw_binary_sparse
+(
+    int fd,              /* I: file descriptor of the band file */
+    char *infile         /* I: name of the band file, for its sidecar and
+                               error messages */
+)
+{
+    char FUNC_NAME[] = "attach_raw_binary_sparse"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    struct stat statbuf;     /* status of the band file */
+    Raw_binary_sparse_t *sparse = NULL;  /* fill regions */
+    Raw_binary_sparse_t **by_fd = NULL;  /* resized table */
+    int i;                   /* looping variable */
+
+    if (fstat (fd, &statbuf) != 0 || !S_ISREG (statbuf.st_mode))
+        return SUCCESS;
+
+    sparse = rb_read_fill_runs (infile, &statbuf);
+    if (sparse == NULL)
+        sparse = rb_find_holes (fd, &statbuf);
+    if (sparse == NULL)
+        return SUCCESS;
+
+    pthread_mutex_lock (&rb_sparse_mutex);
+    if (fd >= rb_sparse_nfds)
+    {
+        by_fd = realloc (rb_sparse_by_fd, (fd + 1) * sizeof (*by_fd));
+        if (by_fd == NULL)
+        {
+            pthread_mutex_unlock (&rb_sparse_mutex);
+            sprintf (errmsg, "Registering the fill regions of raw binary "
+                "file %s", infile);
+            error_handler (true, FUNC_NAME, errmsg);
+            free_raw_binary_sparse (sparse);
+            return ERROR;
+        }
+        for (i = rb_sparse_nfds; i <= fd; i++)
+            by_fd[i] = NULL;
+        rb_sparse_by_fd = by_fd;
+        rb_sparse_nfds = fd + 1;
+    }
+    rb_sparse_by_fd[fd] = sparse;
+    pthread_mutex_unlock (&rb_sparse_mutex);
+
+    return SUCCESS;
+}
+
+
+/******************************************************************************
+MODULE: get_raw_binary_sparse
+
+PURPOSE: Looks up the fill regions attached to a file descriptor.
+
+RETURN VALUE:
+Type = Raw_binary_sparse_t *
+Value        Description
+-----        -----------
+NULL         The file has no fill regions
+non-NULL     Fill regions of the file
+
+NOTES:
+*****************************************************************************/
+Raw_binary_sparse_t *get_raw_binary_sparse
+(
+    int fd               /* I: file descriptor of the band file */
+)
+{
+    Raw_binary_sparse_t *sparse = NULL;  /* fill regions of the file */
+
+    pthread_mutex_lock (&rb_sparse_mutex);
+    if (fd >= 0 && fd < rb_sparse_nfds)
+        sparse = rb_sparse_by_fd[fd];
+    pthread_mutex_unlock (&rb_sparse_mutex);
+
+    return sparse;
+}
+
+
+/******************************************************************************
+MODULE: detach_raw_binary_sparse
+
+PURPOSE: Detaches and frees the fill regions attached to a file descriptor,
+if there are any.
+
+RETURN VALUE:
+Type = N/A
+
+NOTES:
+  1. Must be called before the file descriptor is closed, since the number
+     may be reused by the next file opened.
+*****************************************************************************/
+void detach_raw_binary_sparse
+(
+    int fd               /* I: file descriptor of the band file */
+)
+{
+    Raw_binary_sparse_t *sparse = NULL;  /* fill regions of the file */
+
+    pthread_mutex_lock (&rb_sparse_mutex);
+    if (fd >= 0 && fd < rb_sparse_nfds)
+    {
+        sparse = rb_sparse_by_fd[fd];
+        rb_sparse_by_fd[fd] = NULL;
+    }
+    pthread_mutex_unlock (&rb_sparse_mutex);
+
+    free_raw_binary_sparse (sparse);
+}
+
+
+/******************************************************************************
+MODULE: read_raw_binary_sparse
+
+PURPOSE: Reads a range of bytes of a band file, filling in the parts which
+are fill regions and reading only the rest from the file.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        An error occurred reading the file
+SUCCESS      All of the bytes were read
+
+NOTES:
+  1. The runs are searched with a binary search, so the cost of a read
+     doesn't grow with the number of runs.
+*****************************************************************************/
+int read_raw_binary_sparse
+(
+    const Raw_binary_sparse_t *sparse, /* I: fill regions of the band file */
+    int fd,              /* I: file descriptor of the band file */
+    void *buf,           /* O: buffer to be read into */
+    size_t nbytes,       /* I: number of bytes to read */
+    off_t offset         /* I: file offset of the first byte */
+)
+{
+    char *ptr = buf;     /* current position in the buffer */
+    int lo;              /* low end of the binary search */
+    int hi;              /* high end of the binary search */
+    int mid;             /* middle of the binary search */
+    size_t chunk;        /* number of bytes in the current piece */
+    size_t phase;        /* position of the piece within a fill pixel */
+    size_t piece;        /* number of bytes copied from the fill pattern */
+    const Rb_fill_run_t *run; /* current run */
+
+    /* Find the first run which ends after the offset */
+    lo = 0;
+    hi = sparse->nruns;
+    while (lo < hi)
+    {
+        mid = (lo + hi) / 2;
+        run = &sparse->runs[mid];
+        if (run->offset + (off_t) run->nbytes <= offset)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    while (nbytes > 0)
+    {
+        run = lo < sparse->nruns ? &sparse->runs[lo] : NULL;
+
+        /* Read up to the start of the next run */
+        if (run == NULL || run->offset > offset)
+        {
+            chunk = nbytes;
+            if (run != NULL && (size_t) (run->offset - offset) < chunk)
+                chunk = run->offset - offset;
+            if (pio_raw_binary (fd, false, ptr, chunk, offset) != SUCCESS)
+                return ERROR;
+            ptr += chunk;
+            offset += chunk;
+            nbytes -= chunk;
+            continue;
+        }
+
+        /* Fill in the part of the run which is needed */
+        chunk = run->offset + (off_t) run->nbytes - offset;
+        if (chunk > nbytes)
+            chunk = nbytes;
+        nbytes -= chunk;
+        if (sparse->holes)
+        {
+            memset (ptr, 0, chunk);
+            ptr += chunk;
+            offset += chunk;
+            chunk = 0;
+        }
+
+        /* The pattern starts on a pixel, so copy it from the phase of the
+           offset within the pixel */
+        phase = (offset - run->offset) % sparse->size;
+        while (chunk > 0)
+        {
+            piece = RB_SPARSE_BLOCK_BYTES - sparse->size;
+            if (piece > chunk)
+                piece = chunk;
+            memcpy (ptr, sparse->pattern + phase, piece);
+            phase = (phase + piece) % sparse->size;
+            ptr += piece;
+            offset += piece;
+            chunk -= piece;
+        }
+        lo++;
+    }
+
+    return SUCCESS;
+}
@@ -0,0 +1,146 @@
+/*****************************************************************************
+FILE: raw_binary_sparse.h
+
+PURPOSE: Contains defines and structures for the fill regions of raw binary
+bands.  Blocks of a band which hold nothing but fill can be left out of the
+file as holes when the fill value is zero, or recorded as runs of fill in a
+sidecar file otherwise, so reads of those regions don't touch the disk.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. Only whole blocks of RB_SPARSE_BLOCK_BYTES, aligned to the start of the
+     file, are taken as fill, so the scattered fill pixels within the image
+     are still written as is.
+  2. A band with holes is still a plain raw binary file, since the holes read
+     back as zeros.  The fill runs sidecar is only a hint for the readers;
+     the fill pixels are still written to the band file.
+  3. Layout of the fill runs sidecar (<band file>RB_FILL_RUNS_EXT), in text:
+       RB_FILL_RUNS_MAGIC <bytes per pixel> <fill pixel, hex bytes>
+       <size of the band file> <mtime seconds> <mtime nanoseconds>
+       <file offset> <number of bytes>    (one line per run of fill)
+     The sidecar is ignored unless the size and modification time still
+     match the band file, so a band rewritten by any other means doesn't
+     get stale fill runs.
+*****************************************************************************/
+
+#ifndef RAW_BINARY_SPARSE_H
+#define RAW_BINARY_SPARSE_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <sys/types.h>
+#include "error_handler.h"
+#include "espa_metadata.h"
+
+/* Defines */
+#define RB_SPARSE_BLOCK_BYTES (64 * 1024)  /* size of the blocks checked for
+                                     fill; a multiple of every pixel size */
+#define RB_FILL_RUNS_EXT ".fill"  /* extension of the fill runs sidecar,
+                                     appended to the band file name */
+#define RB_FILL_RUNS_MAGIC "ESPA_FILL_RUNS"  /* first word of the sidecar */
+#define RB_SPARSE_ENV "ESPA_SPARSE_FILL"  /* set to yes to default to
+                                     skipping the fill regions of the bands
+                                     as they are written */
+
+/* Fill region mode for band writes */
+typedef enum {
+  RB_SPARSE_OFF,         /* all the blocks are written as is */
+  RB_SPARSE_ON,          /* blocks of fill are holes or fill runs */
+  RB_SPARSE_FROM_ENV     /* on if RB_SPARSE_ENV is yes, else off */
+} Raw_binary_sparse_mode_t;
+
+/* Run of fill in a band file */
+typedef struct
+{
+    off_t offset;             /* file offset of the first byte of the run */
+    size_t nbytes;            /* number of bytes in the run */
+} Rb_fill_run_t;
+
+/* Fill regions of a band file */
+typedef struct
+{
+    int size;                 /* number of bytes per pixel */
+    unsigned char fill[8];    /* fill pixel, in native byte order */
+    bool holes;               /* are the fill regions holes (the fill pixel
+                                 is all zero bytes)? */
+    char *pattern;            /* RB_SPARSE_BLOCK_BYTES of fill pixels */
+    int nruns;                /* number of runs of fill */
+    int max_runs;             /* number of runs allocated */
+    Rb_fill_run_t *runs;      /* runs of fill, in file order; disjoint */
+} Raw_binary_sparse_t;
+
+/* Prototypes */
+bool use_raw_binary_sparse
+(
+    Raw_binary_sparse_mode_t mode  /* I: requested fill region mode */
+);
+
+Raw_binary_sparse_t *open_raw_binary_sparse
+(
+    const Espa_band_meta_t *bmeta  /* I: metadata of the band; its data_type
+                                         and fill_value are used */
+);
+
+bool is_raw_binary_fill_block
+(
+    const Raw_binary_sparse_t *sparse, /* I: fill regions of the band */
+    const void *block              /* I: RB_SPARSE_BLOCK_BYTES of the band */
+);
+
+int add_raw_binary_fill_run
+(
+    Raw_binary_sparse_t *sparse,   /* I/O: fill regions of the band */
+    off_t offset,                  /* I: file offset of the fill */
+    size_t nbytes                  /* I: number of bytes of fill */
+);
+
+int write_raw_binary_fill_runs
+(
+    const Raw_binary_sparse_t *sparse, /* I: fill regions of the band */
+    const char *infile             /* I: name of the band file, which has
+                                         been closed */
+);
+
+void remove_raw_binary_fill_runs
+(
+    const char *infile             /* I: name of the band file */
+);
+
+void free_raw_binary_sparse
+(
+    Raw_binary_sparse_t *sparse    /* I: fill regions to be freed */
+);
+
+int attach_raw_binary_sparse
+(
+    int fd,              /* I: file descriptor of the band file */
+    char *infile         /* I: name of the band file, for its sidecar and
+                               error messages */
+);
+
+Raw_binary_sparse_t *get_raw_binary_sparse
+(
+    int fd               /* I: file descriptor of the band file */
+);
+
+void detach_raw_binary_sparse
+(
+    int fd               /* I: file descriptor of the band file */
+);
+
+int read_raw_binary_sparse
+(
+    const Raw_binary_sparse_t *sparse, /* I: fill regions of the band file */
+    int fd,              /* I: file descriptor of the band file */
+    void *buf,           /* O: buffer to be read into */
+    size_t nbytes,       /* I: number of bytes to read */
+    off_t offset         /* I: file offset of the first byte */
+);
+
+#endif
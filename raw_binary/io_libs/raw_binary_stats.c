@@ -0,0 +1,413 @@
+/*****************************************************************************
+FILE: raw_binary_stats.c
+
+PURPOSE: Contains functions for computing the statistics of the bands as
+their pixels stream through (see raw_binary_stats.h).
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+*****************************************************************************/
+
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include "raw_binary_stats.h"
+
+/* Smallest number of 8-bit pixels counted in the four interleaved tables,
+   which keep consecutive equal pixels from waiting on each other's count */
+#define STATS_SPLIT_PIXELS 4096
+
+/******************************************************************************
+MODULE: count_uint8_pixels
+
+PURPOSE: Counts the values of 8-bit pixels.
+
+RETURN VALUE: None
+
+NOTES:
+  1. The int8 pixels are counted by their unsigned bytes, offset by 128 (see
+     open_raw_binary_stats).
+*****************************************************************************/
+static void count_uint8_pixels
+(
+    long *counts,             /* I/O: number of pixels of each value */
+    const uint8_t *pix,       /* I: pixels, or the bytes of the int8 pixels */
+    size_t npixels,           /* I: number of pixels */
+    uint8_t flip              /* I: XORed with each byte to get the index of
+                                    its count (0x80 for int8) */
+)
+{
+    long split[4][256];       /* interleaved counts of a long run of pixels */
+    size_t i;                 /* looping variable for the pixels */
+    int v;                    /* looping variable for the values */
+
+    if (npixels < STATS_SPLIT_PIXELS)
+    {
+        for (i = 0; i < npixels; i++)
+            counts[pix[i] ^ flip]++;
+        return;
+    }
+
+    memset (split, 0, sizeof (split));
+    for (i = 0; i + 4 <= npixels; i += 4)
+    {
+        split[0][pix[i]]++;
+        split[1][pix[i + 1]]++;
+        split[2][pix[i + 2]]++;
+        split[3][pix[i + 3]]++;
+    }
+    for (; i < npixels; i++)
+        split[0][pix[i]]++;
+
+    for (v = 0; v < 256; v++)
+        counts[v ^ flip] += split[0][v] + split[1][v] + split[2][v] +
+            split[3][v];
+}
+
+
+/******************************************************************************
+MODULE: add_wide_pixel
+
+PURPOSE: Adds a valid 32 or 64-bit pixel to the statistics.
+
+RETURN VALUE: None
+
+NOTES:
+*****************************************************************************/
+static inline void add_wide_pixel
+(
+    Rb_stats_t *stats,        /* I/O: statistics being computed */
+    double value              /* I: valid pixel */
+)
+{
+    double diff;              /* pixel less the shift */
+    int bin;                  /* bin of the pixel in the histogram */
+
+    if (stats->valid_count == 0)
+    {
+        stats->shift = value;
+        stats->min = stats->max = value;
+    }
+    else if (value < stats->min)
+        stats->min = value;
+    else if (value > stats->max)
+        stats->max = value;
+    stats->valid_count++;
+
+    diff = value - stats->shift;
+    stats->sum += diff;
+    stats->sumsq += diff * diff;
+
+    if (stats->nbins > 0)
+    {
+        bin = (int) ((value - stats->hist_min) * stats->nbins /
+            (stats->hist_max - stats->hist_min));
+        if (bin < 0)
+            bin = 0;
+        else if (bin >= stats->nbins)
+            bin = stats->nbins - 1;
+        stats->histogram[bin]++;
+    }
+}
+
+
+/* Adds the valid pixels of a 32 or 64-bit band of the given type */
+#define ADD_WIDE_PIXELS(type) \
+    { \
+        const type *pix = buf; \
+        for (i = 0; i < npixels; i++) \
+        { \
+            if ((stats->use_fill && pix[i] == (type) stats->fill_value) || \
+                (stats->use_saturate && \
+                pix[i] == (type) stats->saturate_value) || \
+                isnan ((double) pix[i])) \
+                continue; \
+            add_wide_pixel (stats, (double) pix[i]); \
+        } \
+    }
+
+
+/******************************************************************************
+MODULE: open_raw_binary_stats
+
+PURPOSE: Starts the statistics of a band.
+
+RETURN VALUE:
+Type = Rb_stats_t *
+Value        Description
+-----        -----------
+NULL         Error allocating the statistics
+non-NULL     Statistics of the band, with no pixels
+
+NOTES:
+*****************************************************************************/
+Rb_stats_t *open_raw_binary_stats
+(
+    const Espa_band_meta_t *bmeta /* I: metadata of the band; its data_type,
+                                        fill_value, saturate_value, and
+                                        valid_range are used */
+)
+{
+    char FUNC_NAME[] = "open_raw_binary_stats";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    Rb_stats_t *stats = NULL; /* statistics to be returned */
+
+    stats = calloc (1, sizeof (Rb_stats_t));
+    if (stats == NULL)
+    {
+        sprintf (errmsg, "Allocating the statistics of band %s",
+            bmeta->name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return NULL;
+    }
+
+    stats->data_type = bmeta->data_type;
+    stats->use_fill = bmeta->fill_value != ESPA_INT_META_FILL;
+    stats->fill_value = bmeta->fill_value;
+    stats->use_saturate = bmeta->saturate_value != ESPA_INT_META_FILL;
+    stats->saturate_value = bmeta->saturate_value;
+
+    switch (bmeta->data_type)
+    {
+        case ESPA_INT8:
+            stats->value0 = INT8_MIN;
+            stats->nvalues = 256;
+            break;
+        case ESPA_UINT8:
+            stats->value0 = 0;
+            stats->nvalues = 256;
+            break;
+        case ESPA_INT16:
+            stats->value0 = INT16_MIN;
+            stats->nvalues = 65536;
+            break;
+        case ESPA_UINT16:
+            stats->value0 = 0;
+            stats->nvalues = 65536;
+            break;
+        default:
+            if (fabs (bmeta->valid_range[0] - ESPA_FLOAT_META_FILL) >
+                ESPA_EPSILON &&
+                fabs (bmeta->valid_range[1] - ESPA_FLOAT_META_FILL) >
+                ESPA_EPSILON &&
+                bmeta->valid_range[1] > bmeta->valid_range[0])
+            {
+                stats->nbins = ESPA_STATS_NBINS;
+                stats->hist_min = bmeta->valid_range[0];
+                stats->hist_max = bmeta->valid_range[1];
+            }
+            return stats;
+    }
+
+    stats->counts = calloc (stats->nvalues, sizeof (long));
+    if (stats->counts == NULL)
+    {
+        sprintf (errmsg, "Allocating the statistics of band %s",
+            bmeta->name);
+        error_handler (true, FUNC_NAME, errmsg);
+        free (stats);
+        return NULL;
+    }
+
+    return stats;
+}
+
+
+/******************************************************************************
+MODULE: update_raw_binary_stats
+
+PURPOSE: Adds the next pixels of the band to the statistics.
+
+RETURN VALUE: None
+
+NOTES:
+*****************************************************************************/
+void update_raw_binary_stats
+(
+    Rb_stats_t *stats,   /* I/O: statistics being computed */
+    const void *buf,     /* I: next pixels of the band */
+    size_t npixels       /* I: number of pixels in buf */
+)
+{
+    size_t i;            /* looping variable for the pixels */
+    const int16_t *pix16 = buf;    /* pixels of an int16 band */
+    const uint16_t *upix16 = buf;  /* pixels of a uint16 band */
+    long *counts16 = NULL;         /* counts of an int16 band, indexed by
+                                      the pixel value */
+
+    switch (stats->data_type)
+    {
+        case ESPA_INT8:
+            count_uint8_pixels (stats->counts, buf, npixels, 0x80);
+            break;
+        case ESPA_UINT8:
+            count_uint8_pixels (stats->counts, buf, npixels, 0);
+            break;
+        case ESPA_INT16:
+            counts16 = stats->counts - INT16_MIN;
+            for (i = 0; i < npixels; i++)
+                counts16[pix16[i]]++;
+            break;
+        case ESPA_UINT16:
+            for (i = 0; i < npixels; i++)
+                stats->counts[upix16[i]]++;
+            break;
+        case ESPA_INT32:
+            ADD_WIDE_PIXELS (int32_t);
+            break;
+        case ESPA_UINT32:
+            ADD_WIDE_PIXELS (uint32_t);
+            break;
+        case ESPA_FLOAT32:
+            ADD_WIDE_PIXELS (float);
+            break;
+        case ESPA_FLOAT64:
+            ADD_WIDE_PIXELS (double);
+            break;
+    }
+}
+
+
+/******************************************************************************
+MODULE: finish_counted_stats
+
+PURPOSE: Computes the statistics of an 8 or 16-bit band from the number of
+pixels of each value.
+
+RETURN VALUE: None
+
+NOTES:
+*****************************************************************************/
+static void finish_counted_stats
+(
+    const Rb_stats_t *stats,      /* I: statistics of all the pixels of the
+                                        band */
+    Espa_band_stats_t *band_stats /* I/O: statistics for the band metadata,
+                                          with no valid pixels */
+)
+{
+    long v;                   /* looping variable for the values */
+    long first = -1;          /* index of the smallest valid value */
+    long last = -1;           /* index of the largest valid value */
+    long nvalues;             /* number of values from first to last */
+    long count;               /* number of pixels of the value */
+    double sum = 0.0;         /* sum of the valid pixels */
+    double sumsq = 0.0;       /* sum of the squared deviations */
+    double diff;              /* deviation of the value from the mean */
+
+    for (v = 0; v < stats->nvalues; v++)
+    {
+        count = stats->counts[v];
+        if (count == 0 ||
+            (stats->use_fill && v + stats->value0 == stats->fill_value) ||
+            (stats->use_saturate &&
+            v + stats->value0 == stats->saturate_value))
+            continue;
+
+        if (first < 0)
+            first = v;
+        last = v;
+        band_stats->valid_count += count;
+        sum += (double) count * (v + stats->value0);
+    }
+    if (band_stats->valid_count == 0)
+        return;
+
+    band_stats->min = first + stats->value0;
+    band_stats->max = last + stats->value0;
+    band_stats->mean = sum / band_stats->valid_count;
+
+    /* Second pass over the counts for the deviations, and the histogram */
+    nvalues = last - first + 1;
+    band_stats->nbins = nvalues < ESPA_STATS_NBINS ? nvalues :
+        ESPA_STATS_NBINS;
+    band_stats->hist_min = band_stats->min;
+    band_stats->hist_max = band_stats->max + 1;
+    for (v = first; v <= last; v++)
+    {
+        count = stats->counts[v];
+        if (count == 0 ||
+            (stats->use_fill && v + stats->value0 == stats->fill_value) ||
+            (stats->use_saturate &&
+            v + stats->value0 == stats->saturate_value))
+            continue;
+
+        diff = v + stats->value0 - band_stats->mean;
+        sumsq += count * diff * diff;
+        band_stats->histogram[(v - first) * band_stats->nbins / nvalues] +=
+            count;
+    }
+    band_stats->stddev = sqrt (sumsq / band_stats->valid_count);
+}
+
+
+/******************************************************************************
+MODULE: finish_raw_binary_stats
+
+PURPOSE: Computes the statistics of all the pixels added to a band, for its
+metadata.
+
+RETURN VALUE: None
+
+NOTES:
+  1. The standard deviation is that of the population of valid pixels.
+*****************************************************************************/
+void finish_raw_binary_stats
+(
+    const Rb_stats_t *stats,      /* I: statistics of all the pixels of the
+                                        band */
+    Espa_band_stats_t *band_stats /* O: statistics for the band metadata */
+)
+{
+    double mean;              /* mean of the shifted pixels */
+    double var;               /* variance of the valid pixels */
+
+    memset (band_stats, 0, sizeof (Espa_band_stats_t));
+    if (stats->counts != NULL)
+    {
+        finish_counted_stats (stats, band_stats);
+        return;
+    }
+
+    band_stats->valid_count = stats->valid_count;
+    if (stats->valid_count == 0)
+        return;
+
+    mean = stats->sum / stats->valid_count;
+    var = stats->sumsq / stats->valid_count - mean * mean;
+    band_stats->min = stats->min;
+    band_stats->max = stats->max;
+    band_stats->mean = stats->shift + mean;
+    band_stats->stddev = var > 0.0 ? sqrt (var) : 0.0;
+    band_stats->nbins = stats->nbins;
+    band_stats->hist_min = stats->hist_min;
+    band_stats->hist_max = stats->hist_max;
+    memcpy (band_stats->histogram, stats->histogram,
+        sizeof (band_stats->histogram));
+}
+
+
+/******************************************************************************
+MODULE: close_raw_binary_stats
+
+PURPOSE: Frees the statistics of a band.
+
+RETURN VALUE: None
+
+NOTES:
+*****************************************************************************/
+void close_raw_binary_stats
+(
+    Rb_stats_t *stats    /* I: statistics to be freed; may be NULL */
+)
+{
+    if (stats == NULL)
+        return;
+
+    free (stats->counts);
+    free (stats);
+}
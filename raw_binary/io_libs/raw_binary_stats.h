@@ -0,0 +1,97 @@
+/*****************************************************************************
+FILE: raw_binary_stats.h
+
+PURPOSE: Contains defines, structures, and prototypes for the statistics of
+the bands (min, max, mean, standard deviation, valid count, and histogram),
+which are computed as the pixels stream through the writers and readers
+instead of reading the bands again.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. Only the valid pixels are counted: the fill_value and saturate_value of
+     the band (where they are set) and NaN are left out.
+  2. The 8 and 16-bit bands are counted by pixel value, which is all the
+     work done per pixel.  The min, max, mean, and standard deviation are
+     exact, and are computed from the counts when the band is finished.  The
+     histogram has a bin for each value from min to max, or ESPA_STATS_NBINS
+     bins of equal width if there are more values.
+  3. The min, max, and moments of the 32 and 64-bit bands are accumulated
+     pixel by pixel.  They only have a histogram if their valid_range is
+     set; it has ESPA_STATS_NBINS bins over the valid_range, and the pixels
+     outside of it are counted in the first or last bin.
+  4. The statistics are recorded in the stats of the band metadata, which is
+     written as the statistics element of the band in the XML.
+*****************************************************************************/
+
+#ifndef RAW_BINARY_STATS_H
+#define RAW_BINARY_STATS_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include "error_handler.h"
+#include "espa_metadata.h"
+
+/* Statistics being computed */
+typedef struct
+{
+    enum Espa_data_type data_type; /* data type of the pixels */
+    bool use_fill;            /* leave out the pixels equal to fill_value? */
+    long fill_value;          /* fill value of the band */
+    bool use_saturate;        /* leave out the pixels equal to
+                                 saturate_value? */
+    int saturate_value;       /* saturation value of the band */
+
+    /* 8 and 16-bit bands */
+    long *counts;             /* number of pixels of each value; NULL for
+                                 the 32 and 64-bit bands */
+    long value0;              /* pixel value of counts[0] */
+    long nvalues;             /* number of values in counts */
+
+    /* 32 and 64-bit bands */
+    long valid_count;         /* number of valid pixels */
+    double shift;             /* first valid pixel, subtracted from the
+                                 pixels summed to keep the sums small */
+    double sum;               /* sum of the shifted valid pixels */
+    double sumsq;             /* sum of the squares of the shifted pixels */
+    double min;               /* smallest valid pixel */
+    double max;               /* largest valid pixel */
+    int nbins;                /* number of bins in histogram; 0 if the
+                                 valid_range isn't set */
+    double hist_min;          /* lower bound of the first bin */
+    double hist_max;          /* upper bound of the last bin */
+    long histogram[ESPA_STATS_NBINS]; /* number of valid pixels in each bin */
+} Rb_stats_t;
+
+/* Prototypes */
+Rb_stats_t *open_raw_binary_stats
+(
+    const Espa_band_meta_t *bmeta /* I: metadata of the band; its data_type,
+                                        fill_value, saturate_value, and
+                                        valid_range are used */
+);
+
+void update_raw_binary_stats
+(
+    Rb_stats_t *stats,   /* I/O: statistics being computed */
+    const void *buf,     /* I: next pixels of the band */
+    size_t npixels       /* I: number of pixels in buf */
+);
+
+void finish_raw_binary_stats
+(
+    const Rb_stats_t *stats,      /* I: statistics of all the pixels of the
+                                        band */
+    Espa_band_stats_t *band_stats /* O: statistics for the band metadata */
+);
+
+void close_raw_binary_stats
+(
+    Rb_stats_t *stats    /* I: statistics to be freed; may be NULL */
+);
+
+#endif
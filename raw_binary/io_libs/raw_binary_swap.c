@@ -0,0 +1,321 @@
+/*****************************************************************************
+FILE: raw_binary_swap.c
+
+PURPOSE: Contains functions for byte-swapping blocks of raw binary values.
+Each kernel swaps as many whole vectors as fit in the block and returns the
+number of bytes handled, leaving the remainder to the scalar loop.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The kernel is chosen once, when the program is loaded, from the
+     instruction sets of the CPU (see espa_cpu_dispatch.h).
+*****************************************************************************/
+
+#include <stdint.h>
+#include "raw_binary_swap.h"
+#include "espa_cpu_dispatch.h"
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#define RB_SWAP_X86
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define RB_SWAP_NEON
+#endif
+
+/* Kernel swapping the whole vectors of a block; returns the number of bytes
+   swapped */
+typedef size_t (*Rb_swap_kernel_t)
+(
+    const char *in_buf,  /* I: values to be byte-swapped */
+    char *out_buf,       /* O: byte-swapped values */
+    size_t nbytes,       /* I: number of bytes in the block */
+    int size             /* I: number of bytes per value (2, 4, or 8) */
+);
+
+#ifdef RB_SWAP_X86
+/******************************************************************************
+MODULE: rb_swap_sse2
+
+PURPOSE: Byte-swaps 16-byte vectors using SSE2, which is available on every
+x86-64 CPU.  Words are reordered with 16-bit shuffles and the bytes within
+each word are swapped with shifts.
+
+RETURN VALUE:
+Type = size_t
+Value        Description
+-----        -----------
+n            Number of bytes swapped
+
+NOTES:
+*****************************************************************************/
+static size_t rb_swap_sse2
+(
+    const char *in_buf,  /* I: values to be byte-swapped */
+    char *out_buf,       /* O: byte-swapped values */
+    size_t nbytes,       /* I: number of bytes in the block */
+    int size             /* I: number of bytes per value (2, 4, or 8) */
+)
+{
+    size_t i;            /* current byte in the block */
+    __m128i v;           /* current vector */
+
+    for (i = 0; i + 16 <= nbytes; i += 16)
+    {
+        v = _mm_loadu_si128 ((const __m128i *) (in_buf + i));
+        if (size == 4)
+        {
+            v = _mm_shufflelo_epi16 (v, _MM_SHUFFLE (2, 3, 0, 1));
+            v = _mm_shufflehi_epi16 (v, _MM_SHUFFLE (2, 3, 0, 1));
+        }
+        else if (size == 8)
+        {
+            v = _mm_shufflelo_epi16 (v, _MM_SHUFFLE (0, 1, 2, 3));
+            v = _mm_shufflehi_epi16 (v, _MM_SHUFFLE (0, 1, 2, 3));
+        }
+        v = _mm_or_si128 (_mm_slli_epi16 (v, 8), _mm_srli_epi16 (v, 8));
+        _mm_storeu_si128 ((__m128i *) (out_buf + i), v);
+    }
+
+    return i;
+}
+
+
+/******************************************************************************
+MODULE: rb_swap_avx2
+
+PURPOSE: Byte-swaps 32-byte vectors using AVX2 byte shuffles, then a last
+16-byte vector with SSE2.
+
+RETURN VALUE:
+Type = size_t
+Value        Description
+-----        -----------
+n            Number of bytes swapped
+
+NOTES:
+  1. Only put in the kernel table when the CPU supports AVX2.
+*****************************************************************************/
+__attribute__ ((target ("avx2")))
+static size_t rb_swap_avx2
+(
+    const char *in_buf,  /* I: values to be byte-swapped */
+    char *out_buf,       /* O: byte-swapped values */
+    size_t nbytes,       /* I: number of bytes in the block */
+    int size             /* I: number of bytes per value (2, 4, or 8) */
+)
+{
+    size_t i;            /* current byte in the block */
+    __m256i mask;        /* byte order within each 128-bit lane */
+    __m256i v;           /* current vector */
+
+    if (size == 2)
+        mask = _mm256_setr_epi8 (1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13,
+            12, 15, 14, 1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+    else if (size == 4)
+        mask = _mm256_setr_epi8 (3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15,
+            14, 13, 12, 3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+    else
+        mask = _mm256_setr_epi8 (7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11,
+            10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8);
+
+    for (i = 0; i + 32 <= nbytes; i += 32)
+    {
+        v = _mm256_loadu_si256 ((const __m256i *) (in_buf + i));
+        v = _mm256_shuffle_epi8 (v, mask);
+        _mm256_storeu_si256 ((__m256i *) (out_buf + i), v);
+    }
+
+    return i + rb_swap_sse2 (in_buf + i, out_buf + i, nbytes - i, size);
+}
+#endif
+
+#ifdef RB_SWAP_NEON
+/******************************************************************************
+MODULE: rb_swap_neon
+
+PURPOSE: Byte-swaps 16-byte vectors using the NEON byte reversal
+instructions.
+
+RETURN VALUE:
+Type = size_t
+Value        Description
+-----        -----------
+n            Number of bytes swapped
+
+NOTES:
+*****************************************************************************/
+static size_t rb_swap_neon
+(
+    const char *in_buf,  /* I: values to be byte-swapped */
+    char *out_buf,       /* O: byte-swapped values */
+    size_t nbytes,       /* I: number of bytes in the block */
+    int size             /* I: number of bytes per value (2, 4, or 8) */
+)
+{
+    size_t i;            /* current byte in the block */
+    uint8x16_t v;        /* current vector */
+
+    for (i = 0; i + 16 <= nbytes; i += 16)
+    {
+        v = vld1q_u8 ((const uint8_t *) (in_buf + i));
+        if (size == 2)
+            v = vrev16q_u8 (v);
+        else if (size == 4)
+            v = vrev32q_u8 (v);
+        else
+            v = vrev64q_u8 (v);
+        vst1q_u8 ((uint8_t *) (out_buf + i), v);
+    }
+
+    return i;
+}
+#endif
+
+
+/******************************************************************************
+MODULE: rb_swap_none
+
+PURPOSE: Kernel of the CPUs without vector instructions, which leaves the
+whole block to the scalar loop.
+
+RETURN VALUE:
+Type = size_t
+Value        Description
+-----        -----------
+0            No bytes swapped
+
+NOTES:
+*****************************************************************************/
+static size_t rb_swap_none
+(
+    const char *in_buf,  /* I: values to be byte-swapped (unused) */
+    char *out_buf,       /* O: byte-swapped values (unused) */
+    size_t nbytes,       /* I: number of bytes in the block (unused) */
+    int size             /* I: number of bytes per value (unused) */
+)
+{
+    return 0;
+}
+
+
+/* Kernel of the block swap, chosen by init_swap_kernels */
+static Rb_swap_kernel_t rb_swap_kernel = rb_swap_none;
+
+
+/******************************************************************************
+MODULE: init_swap_kernels
+
+PURPOSE: Chooses the widest swap kernel supported by the CPU.
+
+RETURN VALUE: None
+
+NOTES:
+  1. Run when the program (or shared library) is loaded.
+*****************************************************************************/
+__attribute__ ((constructor))
+static void init_swap_kernels (void)
+{
+#if defined(RB_SWAP_X86)
+    if (espa_cpu_supports (ESPA_CPU_AVX2))
+        rb_swap_kernel = rb_swap_avx2;
+    else if (espa_cpu_supports (ESPA_CPU_SSE2))
+        rb_swap_kernel = rb_swap_sse2;
+#elif defined(RB_SWAP_NEON)
+    if (espa_cpu_supports (ESPA_CPU_NEON))
+        rb_swap_kernel = rb_swap_neon;
+#endif
+}
+
+
+/******************************************************************************
+MODULE: swap_raw_binary_bytes
+
+PURPOSE: Byte-swaps a block of values, converting little endian values to big
+endian or vice versa.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Unsupported number of bytes per value
+SUCCESS      Successful swap
+
+NOTES:
+  1. 1-byte values are copied as-is.
+  2. The block is processed in a single pass, so it is intended to be called
+     on a chunk of lines at a time as the data is streamed out.
+*****************************************************************************/
+int swap_raw_binary_bytes
+(
+    const void *in_buf,  /* I: values to be byte-swapped */
+    void *out_buf,       /* O: byte-swapped values; may be the same as in_buf
+                               for an in-place swap */
+    size_t nvals,        /* I: number of values to be swapped */
+    int size             /* I: number of bytes per value (1, 2, 4, or 8) */
+)
+{
+    char FUNC_NAME[] = "swap_raw_binary_bytes"; /* function name */
+    char errmsg[STR_SIZE];       /* error message */
+    const char *in = in_buf;     /* input bytes */
+    char *out = out_buf;         /* output bytes */
+    size_t nbytes;               /* number of bytes in the block */
+    size_t done;                 /* number of bytes swapped by the kernel */
+    size_t i;                    /* looping variable for the remainder */
+    uint16_t v16;                /* current 16-bit value */
+    uint32_t v32;                /* current 32-bit value */
+    uint64_t v64;                /* current 64-bit value */
+
+    if (size == 1)
+    {
+        if (out_buf != in_buf)
+            memmove (out_buf, in_buf, nvals);
+        return SUCCESS;
+    }
+    if (size != 2 && size != 4 && size != 8)
+    {
+        sprintf (errmsg, "Unsupported number of bytes per value for "
+            "byte-swapping: %d", size);
+        error_handler (true, FUNC_NAME, errmsg);
+        return ERROR;
+    }
+
+    nbytes = nvals * size;
+    done = rb_swap_kernel (in, out, nbytes, size);
+
+    /* Swap the rest of the values one at a time, with a loop for each size
+       so the size isn't checked for every value */
+    switch (size)
+    {
+        case 2:
+            for (i = done; i < nbytes; i += 2)
+            {
+                memcpy (&v16, in + i, 2);
+                v16 = __builtin_bswap16 (v16);
+                memcpy (out + i, &v16, 2);
+            }
+            break;
+        case 4:
+            for (i = done; i < nbytes; i += 4)
+            {
+                memcpy (&v32, in + i, 4);
+                v32 = __builtin_bswap32 (v32);
+                memcpy (out + i, &v32, 4);
+            }
+            break;
+        default:
+            for (i = done; i < nbytes; i += 8)
+            {
+                memcpy (&v64, in + i, 8);
+                v64 = __builtin_bswap64 (v64);
+                memcpy (out + i, &v64, 8);
+            }
+            break;
+    }
+
+    return SUCCESS;
+}
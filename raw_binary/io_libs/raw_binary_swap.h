@@ -0,0 +1,35 @@
+/*****************************************************************************
+FILE: raw_binary_swap.h
+
+PURPOSE: Contains prototypes for the byte-swap stage, which converts blocks of
+16, 32, and 64-bit raw binary values between little and big endian.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The swap is vectorized with AVX2, SSE2, or NEON, whichever is the widest
+     the CPU supports, with a scalar loop for the remainder of each block.
+*****************************************************************************/
+
+#ifndef RAW_BINARY_SWAP_H
+#define RAW_BINARY_SWAP_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "error_handler.h"
+
+/* Prototypes */
+int swap_raw_binary_bytes
+(
+    const void *in_buf,  /* I: values to be byte-swapped */
+    void *out_buf,       /* O: byte-swapped values; may be the same as in_buf
+                               for an in-place swap */
+    size_t nvals,        /* I: number of values to be swapped */
+    int size             /* I: number of bytes per value (1, 2, 4, or 8) */
+);
+
+#endif
@@ -0,0 +1,663 @@
+/*****************************************************************************
+FILE: raw_binary_validate.c
+
+PURPOSE: Contains functions for the validation of the pixels of the bands
+(see raw_binary_validate.h).
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The kernels compare the pixels as signed values, so the unsigned pixels
+     are biased by flipping their top bit.  Each kind of pixel is counted by
+     subtracting its compare mask from a lane counter, and the lane counters
+     are added up before they can overflow.
+  2. A valid_range which doesn't overlap the values of the data type can't
+     be held by the kernels, so such bands are checked one pixel at a time.
+*****************************************************************************/
+
+#include <math.h>
+#include <stdint.h>
+#include "raw_binary_validate.h"
+#include "espa_cpu_dispatch.h"
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#define RB_VALIDATE_X86
+#endif
+
+/* Most iterations of the kernels before the lane counters are added up:
+   8-bit counters hold 255, and the 16-bit counters are added up as signed
+   values */
+#define RB_VALIDATE_FLUSH8 255
+#define RB_VALIDATE_FLUSH16 32767
+
+/* Most pixels handed to a kernel at a time, since they count them with an
+   int */
+#define RB_VALIDATE_MAX_RUN (1 << 30)
+
+/* Kinds of pixels counted by the kernels, in the order of their masks */
+static const Rb_valid_count_t rb_kernel_kinds[4] = {RB_VALID_FILL,
+    RB_VALID_SATURATED, RB_VALID_BELOW, RB_VALID_ABOVE};
+
+/* Kernel counting the kinds of a run of 8-bit pixels; returns the number of
+   pixels done */
+typedef int (*Rb_validate8_kernel_t)
+(
+    const uint8_t *pix,  /* I: pixels (int8 or uint8) */
+    int n,               /* I: number of pixels */
+    const Rb_validate_t *valid,  /* I: validation of the band */
+    long *counts         /* I/O: number of pixels of each kind */
+);
+
+/* Kernel counting the kinds of a run of 16-bit pixels; returns the number
+   of pixels done */
+typedef int (*Rb_validate16_kernel_t)
+(
+    const uint16_t *pix, /* I: pixels (int16 or uint16) */
+    int n,               /* I: number of pixels */
+    const Rb_validate_t *valid,  /* I: validation of the band */
+    long *counts         /* I/O: number of pixels of each kind */
+);
+
+
+#ifdef RB_VALIDATE_X86
+/******************************************************************************
+MODULE: rb_validate8_sse2
+
+PURPOSE: Counts the kinds of 16 8-bit pixels at a time.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+n            Number of pixels done
+
+NOTES:
+  1. The byte counters are added up with a sum of absolute differences
+     against zero.
+*****************************************************************************/
+static int rb_validate8_sse2
+(
+    const uint8_t *pix,  /* I: pixels (int8 or uint8) */
+    int n,               /* I: number of pixels */
+    const Rb_validate_t *valid,  /* I: validation of the band */
+    long *counts         /* I/O: number of pixels of each kind */
+)
+{
+    int i = 0;           /* current pixel */
+    int iter;            /* iterations since the counters were added up */
+    int k;               /* looping variable for the kinds */
+    uint64_t sums[2];    /* halves of a sum of the counters */
+    __m128i bias = _mm_set1_epi8 ((char) (valid->bias ? 0x80 : 0));
+                         /* bit flipped to bias the pixels */
+    __m128i vfill = _mm_set1_epi8 ((char) valid->fill_biased);
+    __m128i efill = _mm_set1_epi8 (valid->use_fill ? -1 : 0);
+    __m128i vsat = _mm_set1_epi8 ((char) valid->saturate_biased);
+    __m128i esat = _mm_set1_epi8 (valid->use_saturate ? -1 : 0);
+    __m128i vmin = _mm_set1_epi8 ((char) valid->min_biased);
+    __m128i vmax = _mm_set1_epi8 ((char) valid->max_biased);
+    __m128i zero = _mm_setzero_si128 ();
+    __m128i v;           /* vector of biased pixels */
+    __m128i m[4];        /* masks of fill, saturated, below, and above */
+    __m128i acc[4];      /* counters of each kind */
+
+    while (i + 16 <= n)
+    {
+        for (k = 0; k < 4; k++)
+            acc[k] = zero;
+        for (iter = 0; iter < RB_VALIDATE_FLUSH8 && i + 16 <= n;
+            iter++, i += 16)
+        {
+            v = _mm_xor_si128 (_mm_loadu_si128 ((const __m128i *) (pix + i)),
+                bias);
+            m[0] = _mm_and_si128 (_mm_cmpeq_epi8 (v, vfill), efill);
+            m[1] = _mm_andnot_si128 (m[0], _mm_and_si128 (_mm_cmpeq_epi8 (v,
+                vsat), esat));
+            m[3] = _mm_or_si128 (m[0], m[1]);
+            m[2] = _mm_andnot_si128 (m[3], _mm_cmplt_epi8 (v, vmin));
+            m[3] = _mm_andnot_si128 (m[3], _mm_cmpgt_epi8 (v, vmax));
+            for (k = 0; k < 4; k++)
+                acc[k] = _mm_sub_epi8 (acc[k], m[k]);
+        }
+        for (k = 0; k < 4; k++)
+        {
+            _mm_storeu_si128 ((__m128i *) sums, _mm_sad_epu8 (acc[k], zero));
+            counts[rb_kernel_kinds[k]] += sums[0] + sums[1];
+        }
+    }
+
+    return i;
+}
+
+
+/******************************************************************************
+MODULE: rb_validate16_sse2
+
+PURPOSE: Counts the kinds of 8 16-bit pixels at a time.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+n            Number of pixels done
+
+NOTES:
+  1. The 16-bit counters are added up in pairs with a multiply-add by one.
+*****************************************************************************/
+static int rb_validate16_sse2
+(
+    const uint16_t *pix, /* I: pixels (int16 or uint16) */
+    int n,               /* I: number of pixels */
+    const Rb_validate_t *valid,  /* I: validation of the band */
+    long *counts         /* I/O: number of pixels of each kind */
+)
+{
+    int i = 0;           /* current pixel */
+    int iter;            /* iterations since the counters were added up */
+    int k;               /* looping variable for the kinds */
+    int32_t sums[4];     /* quarters of a sum of the counters */
+    __m128i bias = _mm_set1_epi16 ((short) (valid->bias ? 0x8000 : 0));
+                         /* bit flipped to bias the pixels */
+    __m128i vfill = _mm_set1_epi16 ((short) valid->fill_biased);
+    __m128i efill = _mm_set1_epi16 (valid->use_fill ? -1 : 0);
+    __m128i vsat = _mm_set1_epi16 ((short) valid->saturate_biased);
+    __m128i esat = _mm_set1_epi16 (valid->use_saturate ? -1 : 0);
+    __m128i vmin = _mm_set1_epi16 ((short) valid->min_biased);
+    __m128i vmax = _mm_set1_epi16 ((short) valid->max_biased);
+    __m128i ones = _mm_set1_epi16 (1);
+    __m128i v;           /* vector of biased pixels */
+    __m128i m[4];        /* masks of fill, saturated, below, and above */
+    __m128i acc[4];      /* counters of each kind */
+
+    while (i + 8 <= n)
+    {
+        for (k = 0; k < 4; k++)
+            acc[k] = _mm_setzero_si128 ();
+        for (iter = 0; iter < RB_VALIDATE_FLUSH16 && i + 8 <= n;
+            iter++, i += 8)
+        {
+            v = _mm_xor_si128 (_mm_loadu_si128 ((const __m128i *) (pix + i)),
+                bias);
+            m[0] = _mm_and_si128 (_mm_cmpeq_epi16 (v, vfill), efill);
+            m[1] = _mm_andnot_si128 (m[0], _mm_and_si128 (_mm_cmpeq_epi16 (v,
+                vsat), esat));
+            m[3] = _mm_or_si128 (m[0], m[1]);
+            m[2] = _mm_andnot_si128 (m[3], _mm_cmplt_epi16 (v, vmin));
+            m[3] = _mm_andnot_si128 (m[3], _mm_cmpgt_epi16 (v, vmax));
+            for (k = 0; k < 4; k++)
+                acc[k] = _mm_sub_epi16 (acc[k], m[k]);
+        }
+        for (k = 0; k < 4; k++)
+        {
+            _mm_storeu_si128 ((__m128i *) sums, _mm_madd_epi16 (acc[k],
+                ones));
+            counts[rb_kernel_kinds[k]] += (long) sums[0] + sums[1] +
+                sums[2] + sums[3];
+        }
+    }
+
+    return i;
+}
+
+
+/******************************************************************************
+MODULE: rb_validate8_avx2
+
+PURPOSE: Counts the kinds of 32 8-bit pixels at a time.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+n            Number of pixels done
+
+NOTES:
+  1. Only put in the kernel table when the CPU supports AVX2.
+*****************************************************************************/
+__attribute__ ((target ("avx2")))
+static int rb_validate8_avx2
+(
+    const uint8_t *pix,  /* I: pixels (int8 or uint8) */
+    int n,               /* I: number of pixels */
+    const Rb_validate_t *valid,  /* I: validation of the band */
+    long *counts         /* I/O: number of pixels of each kind */
+)
+{
+    int i = 0;           /* current pixel */
+    int iter;            /* iterations since the counters were added up */
+    int k;               /* looping variable for the kinds */
+    uint64_t sums[4];    /* quarters of a sum of the counters */
+    __m256i bias = _mm256_set1_epi8 ((char) (valid->bias ? 0x80 : 0));
+                         /* bit flipped to bias the pixels */
+    __m256i vfill = _mm256_set1_epi8 ((char) valid->fill_biased);
+    __m256i efill = _mm256_set1_epi8 (valid->use_fill ? -1 : 0);
+    __m256i vsat = _mm256_set1_epi8 ((char) valid->saturate_biased);
+    __m256i esat = _mm256_set1_epi8 (valid->use_saturate ? -1 : 0);
+    __m256i vmin = _mm256_set1_epi8 ((char) valid->min_biased);
+    __m256i vmax = _mm256_set1_epi8 ((char) valid->max_biased);
+    __m256i zero = _mm256_setzero_si256 ();
+    __m256i v;           /* vector of biased pixels */
+    __m256i m[4];        /* masks of fill, saturated, below, and above */
+    __m256i acc[4];      /* counters of each kind */
+
+    while (i + 32 <= n)
+    {
+        for (k = 0; k < 4; k++)
+            acc[k] = zero;
+        for (iter = 0; iter < RB_VALIDATE_FLUSH8 && i + 32 <= n;
+            iter++, i += 32)
+        {
+            v = _mm256_xor_si256 (_mm256_loadu_si256 ((const __m256i *)
+                (pix + i)), bias);
+            m[0] = _mm256_and_si256 (_mm256_cmpeq_epi8 (v, vfill), efill);
+            m[1] = _mm256_andnot_si256 (m[0], _mm256_and_si256
+                (_mm256_cmpeq_epi8 (v, vsat), esat));
+            m[3] = _mm256_or_si256 (m[0], m[1]);
+            m[2] = _mm256_andnot_si256 (m[3], _mm256_cmpgt_epi8 (vmin, v));
+            m[3] = _mm256_andnot_si256 (m[3], _mm256_cmpgt_epi8 (v, vmax));
+            for (k = 0; k < 4; k++)
+                acc[k] = _mm256_sub_epi8 (acc[k], m[k]);
+        }
+        for (k = 0; k < 4; k++)
+        {
+            _mm256_storeu_si256 ((__m256i *) sums, _mm256_sad_epu8 (acc[k],
+                zero));
+            counts[rb_kernel_kinds[k]] += sums[0] + sums[1] + sums[2] +
+                sums[3];
+        }
+    }
+
+    return i;
+}
+
+
+/******************************************************************************
+MODULE: rb_validate16_avx2
+
+PURPOSE: Counts the kinds of 16 16-bit pixels at a time.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+n            Number of pixels done
+
+NOTES:
+  1. Only put in the kernel table when the CPU supports AVX2.
+*****************************************************************************/
+__attribute__ ((target ("avx2")))
+static int rb_validate16_avx2
+(
+    const uint16_t *pix, /* I: pixels (int16 or uint16) */
+    int n,               /* I: number of pixels */
+    const Rb_validate_t *valid,  /* I: validation of the band */
+    long *counts         /* I/O: number of pixels of each kind */
+)
+{
+    int i = 0;           /* current pixel */
+    int iter;            /* iterations since the counters were added up */
+    int k;               /* looping variable for the kinds */
+    int j;               /* looping variable for the sums */
+    int32_t sums[8];     /* eighths of a sum of the counters */
+    __m256i bias = _mm256_set1_epi16 ((short) (valid->bias ? 0x8000 : 0));
+                         /* bit flipped to bias the pixels */
+    __m256i vfill = _mm256_set1_epi16 ((short) valid->fill_biased);
+    __m256i efill = _mm256_set1_epi16 (valid->use_fill ? -1 : 0);
+    __m256i vsat = _mm256_set1_epi16 ((short) valid->saturate_biased);
+    __m256i esat = _mm256_set1_epi16 (valid->use_saturate ? -1 : 0);
+    __m256i vmin = _mm256_set1_epi16 ((short) valid->min_biased);
+    __m256i vmax = _mm256_set1_epi16 ((short) valid->max_biased);
+    __m256i ones = _mm256_set1_epi16 (1);
+    __m256i v;           /* vector of biased pixels */
+    __m256i m[4];        /* masks of fill, saturated, below, and above */
+    __m256i acc[4];      /* counters of each kind */
+
+    while (i + 16 <= n)
+    {
+        for (k = 0; k < 4; k++)
+            acc[k] = _mm256_setzero_si256 ();
+        for (iter = 0; iter < RB_VALIDATE_FLUSH16 && i + 16 <= n;
+            iter++, i += 16)
+        {
+            v = _mm256_xor_si256 (_mm256_loadu_si256 ((const __m256i *)
+                (pix + i)), bias);
+            m[0] = _mm256_and_si256 (_mm256_cmpeq_epi16 (v, vfill), efill);
+            m[1] = _mm256_andnot_si256 (m[0], _mm256_and_si256
+                (_mm256_cmpeq_epi16 (v, vsat), esat));
+            m[3] = _mm256_or_si256 (m[0], m[1]);
+            m[2] = _mm256_andnot_si256 (m[3], _mm256_cmpgt_epi16 (vmin, v));
+            m[3] = _mm256_andnot_si256 (m[3], _mm256_cmpgt_epi16 (v, vmax));
+            for (k = 0; k < 4; k++)
+                acc[k] = _mm256_sub_epi16 (acc[k], m[k]);
+        }
+        for (k = 0; k < 4; k++)
+        {
+            _mm256_storeu_si256 ((__m256i *) sums, _mm256_madd_epi16 (acc[k],
+                ones));
+            for (j = 0; j < 8; j++)
+                counts[rb_kernel_kinds[k]] += sums[j];
+        }
+    }
+
+    return i;
+}
+#endif
+
+
+/******************************************************************************
+MODULE: rb_validate8_none, rb_validate16_none
+
+PURPOSE: Kernels of CPUs without SIMD support, leaving all the pixels to the
+scalar loops.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+0            No pixels done
+
+NOTES:
+*****************************************************************************/
+static int rb_validate8_none
+(
+    const uint8_t *pix,  /* I: pixels (unused) */
+    int n,               /* I: number of pixels (unused) */
+    const Rb_validate_t *valid,  /* I: validation of the band (unused) */
+    long *counts         /* I/O: number of pixels of each kind (unused) */
+)
+{
+    return 0;
+}
+
+static int rb_validate16_none
+(
+    const uint16_t *pix, /* I: pixels (unused) */
+    int n,               /* I: number of pixels (unused) */
+    const Rb_validate_t *valid,  /* I: validation of the band (unused) */
+    long *counts         /* I/O: number of pixels of each kind (unused) */
+)
+{
+    return 0;
+}
+
+
+/* Kernels, chosen by init_validate_kernels */
+static Rb_validate8_kernel_t rb_validate8_kernel = rb_validate8_none;
+static Rb_validate16_kernel_t rb_validate16_kernel = rb_validate16_none;
+
+
+/******************************************************************************
+MODULE: init_validate_kernels
+
+PURPOSE: Chooses the widest kernels supported by the CPU.
+
+RETURN VALUE: None
+
+NOTES:
+  1. Run when the program (or shared library) is loaded.
+*****************************************************************************/
+__attribute__ ((constructor))
+static void init_validate_kernels (void)
+{
+#if defined(RB_VALIDATE_X86)
+    if (espa_cpu_supports (ESPA_CPU_AVX2))
+    {
+        rb_validate8_kernel = rb_validate8_avx2;
+        rb_validate16_kernel = rb_validate16_avx2;
+    }
+    else if (espa_cpu_supports (ESPA_CPU_SSE2))
+    {
+        rb_validate8_kernel = rb_validate8_sse2;
+        rb_validate16_kernel = rb_validate16_sse2;
+    }
+#endif
+}
+
+
+/******************************************************************************
+MODULE: init_raw_binary_validate
+
+PURPOSE: Starts the validation of the pixels of a band.
+
+RETURN VALUE: None
+
+NOTES:
+  1. The valid_range is only checked if both of its ends are set.
+*****************************************************************************/
+void init_raw_binary_validate
+(
+    const Espa_band_meta_t *bmeta, /* I: metadata of the band; its data_type,
+                                         fill_value, saturate_value, and
+                                         valid_range are used */
+    Rb_validate_t *valid           /* O: validation with no pixels */
+)
+{
+    long type_min;           /* smallest value of the data type */
+    long type_max;           /* largest value of the data type */
+    double lo;               /* smallest valid integer pixel */
+    double hi;               /* largest valid integer pixel */
+
+    memset (valid, 0, sizeof (*valid));
+    valid->data_type = bmeta->data_type;
+    valid->use_fill = bmeta->fill_value != ESPA_INT_META_FILL;
+    valid->fill_value = bmeta->fill_value;
+    valid->use_saturate = bmeta->saturate_value != ESPA_INT_META_FILL;
+    valid->saturate_value = bmeta->saturate_value;
+    valid->use_range = fabs (bmeta->valid_range[0] - ESPA_FLOAT_META_FILL) >
+        ESPA_EPSILON && fabs (bmeta->valid_range[1] - ESPA_FLOAT_META_FILL) >
+        ESPA_EPSILON && bmeta->valid_range[1] >= bmeta->valid_range[0];
+    valid->range_min = bmeta->valid_range[0];
+    valid->range_max = bmeta->valid_range[1];
+
+    /* Set up the kernels of the 8 and 16-bit bands, casting the fill and
+       saturation values to the data type as the scalar loops do */
+    switch (bmeta->data_type)
+    {
+        case ESPA_INT8:
+            type_min = INT8_MIN;
+            type_max = INT8_MAX;
+            valid->fill_biased = (int8_t) valid->fill_value;
+            valid->saturate_biased = (int8_t) valid->saturate_value;
+            break;
+        case ESPA_UINT8:
+            type_min = 0;
+            type_max = UINT8_MAX;
+            valid->bias = 128;
+            valid->fill_biased = (uint8_t) valid->fill_value - 128;
+            valid->saturate_biased = (uint8_t) valid->saturate_value - 128;
+            break;
+        case ESPA_INT16:
+            type_min = INT16_MIN;
+            type_max = INT16_MAX;
+            valid->fill_biased = (int16_t) valid->fill_value;
+            valid->saturate_biased = (int16_t) valid->saturate_value;
+            break;
+        case ESPA_UINT16:
+            type_min = 0;
+            type_max = UINT16_MAX;
+            valid->bias = 32768;
+            valid->fill_biased = (uint16_t) valid->fill_value - 32768;
+            valid->saturate_biased = (uint16_t) valid->saturate_value -
+                32768;
+            break;
+        default:
+            return;
+    }
+
+    lo = type_min;
+    hi = type_max;
+    if (valid->use_range)
+    {
+        lo = ceil (valid->range_min);
+        hi = floor (valid->range_max);
+        if (lo > type_max || hi < type_min)
+            return;   /* every pixel is outside; left to the scalar loop */
+        if (lo < type_min)
+            lo = type_min;
+        if (hi > type_max)
+            hi = type_max;
+    }
+    valid->min_biased = (int) lo - valid->bias;
+    valid->max_biased = (int) hi - valid->bias;
+    valid->simd = true;
+}
+
+
+/* Counts the kinds of the pixels from start on of a band of the given type */
+#define CHECK_PIXELS(type) \
+    { \
+        const type *pix = buf; \
+        for (i = start; i < npixels; i++) \
+        { \
+            if (valid->use_fill && pix[i] == (type) valid->fill_value) \
+                valid->counts[RB_VALID_FILL]++; \
+            else if (valid->use_saturate && \
+                pix[i] == (type) valid->saturate_value) \
+                valid->counts[RB_VALID_SATURATED]++; \
+            else if (isnan ((double) pix[i])) \
+                valid->counts[RB_VALID_NAN]++; \
+            else if (valid->use_range && pix[i] < valid->range_min) \
+                valid->counts[RB_VALID_BELOW]++; \
+            else if (valid->use_range && pix[i] > valid->range_max) \
+                valid->counts[RB_VALID_ABOVE]++; \
+        } \
+    }
+
+
+/******************************************************************************
+MODULE: update_raw_binary_validate
+
+PURPOSE: Counts the kinds of the next pixels of the band.
+
+RETURN VALUE: None
+
+NOTES:
+*****************************************************************************/
+void update_raw_binary_validate
+(
+    Rb_validate_t *valid,  /* I/O: validation being computed */
+    const void *buf,       /* I: next pixels of the band */
+    size_t npixels         /* I: number of pixels in buf */
+)
+{
+    size_t i;                /* current pixel */
+    size_t start = 0;        /* first pixel left to the scalar loop */
+    size_t run;              /* number of pixels handed to the kernel */
+    size_t done;             /* number of pixels done by the kernel */
+
+    valid->npixels += npixels;
+
+    /* Hand the 8 and 16-bit pixels to the kernels */
+    while (valid->simd && start < npixels)
+    {
+        run = npixels - start;
+        if (run > RB_VALIDATE_MAX_RUN)
+            run = RB_VALIDATE_MAX_RUN;
+        if (valid->data_type == ESPA_INT8 || valid->data_type == ESPA_UINT8)
+            done = rb_validate8_kernel ((const uint8_t *) buf + start,
+                (int) run, valid, valid->counts);
+        else
+            done = rb_validate16_kernel ((const uint16_t *) buf + start,
+                (int) run, valid, valid->counts);
+        start += done;
+        if (done < run)
+            break;
+    }
+
+    switch (valid->data_type)
+    {
+        case ESPA_INT8:
+            CHECK_PIXELS (int8_t);
+            break;
+        case ESPA_UINT8:
+            CHECK_PIXELS (uint8_t);
+            break;
+        case ESPA_INT16:
+            CHECK_PIXELS (int16_t);
+            break;
+        case ESPA_UINT16:
+            CHECK_PIXELS (uint16_t);
+            break;
+        case ESPA_INT32:
+            CHECK_PIXELS (int32_t);
+            break;
+        case ESPA_UINT32:
+            CHECK_PIXELS (uint32_t);
+            break;
+        case ESPA_FLOAT32:
+            CHECK_PIXELS (float);
+            break;
+        case ESPA_FLOAT64:
+            CHECK_PIXELS (double);
+            break;
+    }
+}
+
+
+/******************************************************************************
+MODULE: validate_raw_binary_stats
+
+PURPOSE: Counts the pixels outside of the valid_range from the statistics of
+the band, so the band doesn't have to be read.
+
+RETURN VALUE:
+Type = bool
+Value        Description
+-----        -----------
+true         The counts were found from the statistics
+false        The statistics don't settle the counts; the band must be read
+
+NOTES:
+  1. Only the integer bands are counted, since the statistics leave out the
+     NaN pixels without counting them.
+  2. The statistics don't tell the fill pixels from the saturated pixels, so
+     the count of the fill pixels includes the saturated pixels.
+  3. The pixels outside of the valid_range are counted from a histogram with
+     a bin for each value, or are known to be none if the smallest and
+     largest valid pixels are within the valid_range.
+*****************************************************************************/
+bool validate_raw_binary_stats
+(
+    const Espa_band_meta_t *bmeta, /* I: metadata of the band, with its
+                                         statistics */
+    Rb_validate_t *valid           /* I/O: validation with no pixels; the
+                                         counts from the statistics */
+)
+{
+    const Espa_band_stats_t *stats = &bmeta->stats;  /* statistics */
+    long below = 0;          /* number of pixels below the valid_range */
+    long above = 0;          /* number of pixels above the valid_range */
+    double value;            /* pixel value of the current bin */
+    int b;                   /* looping variable for the bins */
+
+    if (stats->valid_count == ESPA_INT_META_FILL ||
+        valid->data_type == ESPA_FLOAT32 || valid->data_type == ESPA_FLOAT64)
+        return false;
+
+    if (valid->use_range && (stats->min < valid->range_min ||
+        stats->max > valid->range_max))
+    {
+        /* Only a histogram with a bin for each value can count them */
+        if (stats->nbins <= 0 || fabs (stats->hist_max - stats->hist_min -
+            stats->nbins) > ESPA_EPSILON)
+            return false;
+        for (b = 0; b < stats->nbins; b++)
+        {
+            value = stats->hist_min + b;
+            if (value < valid->range_min)
+                below += stats->histogram[b];
+            else if (value > valid->range_max)
+                above += stats->histogram[b];
+        }
+    }
+
+    valid->npixels = (long) bmeta->nlines * bmeta->nsamps;
+    valid->counts[RB_VALID_FILL] = valid->npixels - stats->valid_count;
+    valid->counts[RB_VALID_BELOW] = below;
+    valid->counts[RB_VALID_ABOVE] = above;
+
+    return true;
+}
@@ -0,0 +1,94 @@
+/*****************************************************************************
+FILE: raw_binary_validate.h
+
+PURPOSE: Contains defines, structures, and prototypes for the validation of
+the pixels of the bands, which counts the pixels equal to the fill_value and
+saturate_value of each band, the NaN pixels, and the pixels outside of its
+valid_range as the pixels stream through the readers.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. Each pixel is counted once, as the first of fill, saturated, NaN, below
+     the valid_range, or above the valid_range which it is.  The pixels
+     which are none of these are valid.
+  2. The 8 and 16-bit bands are checked with SIMD kernels, chosen for the
+     CPU when the library is loaded (see espa_cpu_dispatch.h).  The other
+     bands, and the pixels left over by the kernels, are checked one at a
+     time.
+  3. The fill_value and saturate_value are compared as values of the data
+     type of the band, the same as the statistics (see raw_binary_stats.h).
+*****************************************************************************/
+
+#ifndef RAW_BINARY_VALIDATE_H
+#define RAW_BINARY_VALIDATE_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include "error_handler.h"
+#include "espa_metadata.h"
+
+/* Kinds of pixels counted by the validation, in the order they are checked */
+typedef enum {
+  RB_VALID_FILL,          /* equal to the fill_value */
+  RB_VALID_SATURATED,     /* equal to the saturate_value */
+  RB_VALID_NAN,           /* NaN (32 and 64-bit floating point bands) */
+  RB_VALID_BELOW,         /* below the valid_range */
+  RB_VALID_ABOVE,         /* above the valid_range */
+  RB_VALID_NCOUNTS        /* number of kinds of pixels */
+} Rb_valid_count_t;
+
+/* Validation of the pixels of a band */
+typedef struct
+{
+    enum Espa_data_type data_type; /* data type of the pixels */
+    bool use_fill;            /* count the pixels equal to fill_value? */
+    long fill_value;          /* fill value of the band */
+    bool use_saturate;        /* count the pixels equal to saturate_value? */
+    int saturate_value;       /* saturation value of the band */
+    bool use_range;           /* count the pixels outside of the range? */
+    double range_min;         /* smallest valid pixel */
+    double range_max;         /* largest valid pixel */
+
+    /* 8 and 16-bit bands, as signed values for the SIMD kernels; the
+       unsigned pixels are biased by half their range */
+    bool simd;                /* can the kernels check the pixels? */
+    int bias;                 /* value subtracted from each pixel */
+    int fill_biased;          /* biased fill value */
+    int saturate_biased;      /* biased saturation value */
+    int min_biased;           /* biased smallest valid pixel */
+    int max_biased;           /* biased largest valid pixel */
+
+    long npixels;             /* number of pixels checked */
+    long counts[RB_VALID_NCOUNTS]; /* number of pixels of each kind */
+} Rb_validate_t;
+
+/* Prototypes */
+void init_raw_binary_validate
+(
+    const Espa_band_meta_t *bmeta, /* I: metadata of the band; its data_type,
+                                         fill_value, saturate_value, and
+                                         valid_range are used */
+    Rb_validate_t *valid           /* O: validation with no pixels */
+);
+
+void update_raw_binary_validate
+(
+    Rb_validate_t *valid,  /* I/O: validation being computed */
+    const void *buf,       /* I: next pixels of the band */
+    size_t npixels         /* I: number of pixels in buf */
+);
+
+bool validate_raw_binary_stats
+(
+    const Espa_band_meta_t *bmeta, /* I: metadata of the band, with its
+                                         statistics */
+    Rb_validate_t *valid           /* I/O: validation with no pixels; the
+                                         counts from the statistics */
+);
+
+#endif
@@ -0,0 +1,706 @@
+/*****************************************************************************
+FILE: raw_binary_writer.c
+
+PURPOSE: Contains functions for the coalescing raw binary writer.  Sequential
+writes are gathered into a large buffer which is written out with a single
+positional write each time it fills, and the full size of the output file is
+preallocated up front to avoid fragmenting it.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The checksum of the band (see raw_binary_checksum.h) is computed as the
+     lines are appended, so the file isn't read again for it.  So are its
+     statistics (see raw_binary_stats.h), once they are started, and the
+     browse channel of the band (see espa_browse.h).
+  2. Once the fill regions are started, each whole block of fill is either
+     skipped, leaving a hole, or written and recorded as a fill run (see
+     raw_binary_sparse.h).
+  3. An output file named by a URL (see espa_upload.h) is streamed to
+     object storage as the buffer fills, and never touches the local disk.
+     It is written with its fill as is, since it has no holes or sidecar.
+  4. The writer is accounted for in the I/O statistics (see espa_io_stats.h)
+     as its buffer is written out, with the lines skipped as holes counted
+     as written.  An encoded band is tallied as its lines are appended, so
+     its writes include the time spent encoding them.
+*****************************************************************************/
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE     /* for fallocate */
+#endif
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include "raw_binary_writer.h"
+#include "espa_staging.h"
+#include "espa_remote.h"
+#include "espa_trace.h"
+
+/******************************************************************************
+MODULE: rb_writer_put
+
+PURPOSE: Writes the bytes at the current offset of the output file, leaving
+holes for the blocks of fill or recording them as fill runs.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error writing the bytes
+SUCCESS      Successful write
+
+NOTES:
+  1. The blocks are aligned to the start of the file, so the same blocks are
+     checked however the lines are split across the writes.
+*****************************************************************************/
+static int rb_writer_put
+(
+    Raw_binary_writer_t *writer, /* I: coalescing writer */
+    const char *ptr,    /* I: bytes to be written */
+    size_t nbytes       /* I: number of bytes to be written */
+)
+{
+    char FUNC_NAME[] = "rb_writer_put"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    size_t done;             /* number of bytes checked for fill */
+    size_t start = 0;        /* first byte not yet written */
+    size_t chunk;            /* number of bytes in the current block */
+    off_t pos;               /* file offset of the current block */
+    double start_time;       /* start of the write for the I/O accounting */
+    Raw_binary_sparse_t *sparse = writer->sparse; /* fill regions */
+
+    start_time = espa_io_stats_clock ();
+    if (writer->upload != NULL)
+    {
+        if (write_espa_upload (writer->upload, ptr, nbytes) != SUCCESS)
+        {
+            sprintf (errmsg, "Writing %zu bytes at offset %lld of raw binary "
+                "file %s", nbytes, (long long) writer->offset,
+                writer->file_name);
+            error_handler (true, FUNC_NAME, errmsg);
+            return ERROR;
+        }
+        writer->offset += nbytes;
+        espa_io_stats_record (writer, ESPA_IO_WRITE, nbytes, start_time);
+        return SUCCESS;
+    }
+
+    for (done = 0; sparse != NULL && done < nbytes; done += chunk)
+    {
+        pos = writer->offset + (off_t) done;
+        chunk = RB_SPARSE_BLOCK_BYTES - pos % RB_SPARSE_BLOCK_BYTES;
+        if (chunk > nbytes - done)
+            chunk = nbytes - done;
+        if (chunk < RB_SPARSE_BLOCK_BYTES ||
+            !is_raw_binary_fill_block (sparse, ptr + done))
+            continue;
+
+        if (!sparse->holes)
+        {
+            if (add_raw_binary_fill_run (sparse, pos, chunk) != SUCCESS)
+                return ERROR;   /* error message already written */
+            continue;
+        }
+
+        /* Write the bytes before the block and leave a hole for it */
+        if (done > start && pio_raw_binary (writer->fd, true,
+            (void *) (ptr + start), done - start, writer->offset +
+            (off_t) start) != SUCCESS)
+        {
+            sprintf (errmsg, "Writing %zu bytes at offset %lld of raw "
+                "binary file %s", done - start, (long long) (writer->offset +
+                start), writer->file_name);
+            error_handler (true, FUNC_NAME, errmsg);
+            return ERROR;
+        }
+        start = done + chunk;
+    }
+
+    if (nbytes > start && pio_raw_binary (writer->fd, true,
+        (void *) (ptr + start), nbytes - start, writer->offset +
+        (off_t) start) != SUCCESS)
+    {
+        sprintf (errmsg, "Writing %zu bytes at offset %lld of raw binary "
+            "file %s", nbytes - start, (long long) (writer->offset + start),
+            writer->file_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return ERROR;
+    }
+    writer->offset += nbytes;
+    espa_io_stats_record (writer, ESPA_IO_WRITE, nbytes, start_time);
+
+    return SUCCESS;
+}
+
+
+/******************************************************************************
+MODULE: rb_writer_flush
+
+PURPOSE: Writes out the contents of the coalescing buffer.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error writing the buffer
+SUCCESS      Successful write
+
+NOTES:
+*****************************************************************************/
+static int rb_writer_flush
+(
+    Raw_binary_writer_t *writer  /* I: coalescing writer */
+)
+{
+    if (writer->nbuf == 0)
+        return SUCCESS;
+
+    if (rb_writer_put (writer, writer->buf, writer->nbuf) != SUCCESS)
+        return ERROR;   /* error message already written */
+    writer->nbuf = 0;
+
+    return SUCCESS;
+}
+
+
+/******************************************************************************
+MODULE: open_raw_binary_writer
+
+PURPOSE: Creates (or truncates) the output file, preallocates it, and
+allocates the coalescing buffer.
+
+RETURN VALUE:
+Type = Raw_binary_writer_t *
+Value        Description
+-----        -----------
+NULL         Error creating the file or allocating the buffer
+non-NULL     Coalescing writer
+
+NOTES:
+  1. Preallocation is only a hint; filesystems which don't support it are
+     written without it.
+  2. The buffer size is clamped to RB_WRITER_MIN_MB through RB_WRITER_MAX_MB
+     and never exceeds the expected size of the output file.
+  3. An output file named by a URL is uploaded instead (see espa_upload.h),
+     and isn't created locally.
+*****************************************************************************/
+Raw_binary_writer_t *open_raw_binary_writer
+(
+    char *outfile,       /* I: name of the output file to be created */
+    size_t total_bytes,  /* I: expected size of the output file, which is
+                               preallocated; 0 if not known */
+    int buf_mb           /* I: size of the coalescing buffer in MB; 0 for
+                               the default (or RB_WRITER_MB_ENV) */
+)
+{
+    char FUNC_NAME[] = "open_raw_binary_writer"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    char path[STR_SIZE];     /* name the file is created under */
+    char *env = NULL;        /* value of the environment variable */
+    double start_time;       /* start of the open for the I/O accounting */
+    Raw_binary_writer_t *writer = NULL;  /* coalescing writer */
+
+    if (buf_mb <= 0)
+    {
+        env = getenv (RB_WRITER_MB_ENV);
+        buf_mb = env != NULL ? atoi (env) : RB_WRITER_DEFAULT_MB;
+    }
+    if (buf_mb < RB_WRITER_MIN_MB)
+        buf_mb = RB_WRITER_MIN_MB;
+    if (buf_mb > RB_WRITER_MAX_MB)
+        buf_mb = RB_WRITER_MAX_MB;
+
+    writer = calloc (1, sizeof (Raw_binary_writer_t));
+    if (writer == NULL)
+    {
+        sprintf (errmsg, "Allocating the raw binary writer");
+        error_handler (true, FUNC_NAME, errmsg);
+        return NULL;
+    }
+    snprintf (writer->file_name, sizeof (writer->file_name), "%s", outfile);
+    init_raw_binary_checksum (&writer->checksum);
+    writer->total_bytes = total_bytes;
+    writer->buf_bytes = (size_t) buf_mb * 1024 * 1024;
+    if (total_bytes > 0 && total_bytes < writer->buf_bytes)
+        writer->buf_bytes = total_bytes;
+
+    writer->buf = espa_trace_malloc (writer->buf_bytes);
+    if (writer->buf == NULL)
+    {
+        sprintf (errmsg, "Allocating %zu bytes for the raw binary writer",
+            writer->buf_bytes);
+        error_handler (true, FUNC_NAME, errmsg);
+        free (writer);
+        return NULL;
+    }
+
+    start_time = espa_io_stats_clock ();
+    if (is_remote_file (outfile))
+    {
+        writer->fd = -1;
+        writer->upload = open_espa_upload (outfile);
+        if (writer->upload == NULL)
+        {
+            sprintf (errmsg, "Creating raw binary file %s", outfile);
+            error_handler (true, FUNC_NAME, errmsg);
+            espa_trace_free (writer->buf);
+            free (writer);
+            return NULL;
+        }
+        espa_io_stats_open (writer, outfile, ESPA_IO_RAW_BINARY, start_time);
+        return writer;
+    }
+
+    if (espa_staging_path (outfile, ESPA_STAGE_CREATE, path,
+        sizeof (path)) != SUCCESS)
+    {
+        espa_trace_free (writer->buf);
+        free (writer);
+        return NULL;
+    }
+    writer->fd = open (path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (writer->fd == -1)
+    {
+        sprintf (errmsg, "Creating raw binary file %s", outfile);
+        error_handler (true, FUNC_NAME, errmsg);
+        espa_staging_done (outfile);
+        espa_trace_free (writer->buf);
+        free (writer);
+        return NULL;
+    }
+    remove_raw_binary_fill_runs (outfile);
+
+    /* Reserve the full size of the file so it is laid out contiguously */
+#ifdef __linux__
+    if (total_bytes > 0)
+        fallocate (writer->fd, 0, 0, (off_t) total_bytes);
+#endif
+
+    espa_io_stats_open (writer, outfile, ESPA_IO_RAW_BINARY, start_time);
+    return writer;
+}
+
+
+/******************************************************************************
+MODULE: open_encoded_raw_binary_writer
+
+PURPOSE: Creates the output file of a band with the specified encoding.  The
+lines are appended and the file closed as for open_raw_binary_writer.
+
+RETURN VALUE:
+Type = Raw_binary_writer_t *
+Value        Description
+-----        -----------
+NULL         Error creating the file or allocating the writer
+non-NULL     Writer of the band
+
+NOTES:
+  1. A plain raw binary band is written through the coalescing buffer.  A
+     block-compressed band is gathered a block of lines at a time instead,
+     and each block is compressed and written once it is complete.  A tiled
+     band is gathered a row of tiles at a time the same way.
+  2. Only a plain raw binary band may be written to a URL, since the index
+     of the blocks is written ahead of them once they are all compressed.
+*****************************************************************************/
+Raw_binary_writer_t *open_encoded_raw_binary_writer
+(
+    char *outfile,       /* I: name of the output file to be created */
+    Raw_binary_encoding_t encoding, /* I: encoding of the output file */
+    int nlines,          /* I: number of lines in the band */
+    int nsamps,          /* I: number of samples in the band */
+    int size,            /* I: number of bytes per pixel */
+    int tile_size        /* I: number of lines and samples per tile of a
+                               tiled band; 0 for RB_TILES_DEFAULT_SIZE */
+)
+{
+    char FUNC_NAME[] = "open_encoded_raw_binary_writer"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    double start_time;       /* start of the open for the I/O accounting */
+    Raw_binary_writer_t *writer = NULL;  /* writer of the band */
+
+    if (encoding == RB_ENCODING_RAW)
+        return open_raw_binary_writer (outfile, (size_t) nlines * nsamps *
+            size, 0);
+    if (is_remote_file (outfile))
+    {
+        sprintf (errmsg, "The %s raw binary file %s can't be written to "
+            "object storage; only raw bands can",
+            raw_binary_encoding_name (encoding), outfile);
+        error_handler (true, FUNC_NAME, errmsg);
+        return NULL;
+    }
+
+    writer = calloc (1, sizeof (Raw_binary_writer_t));
+    if (writer == NULL)
+    {
+        sprintf (errmsg, "Allocating the raw binary writer");
+        error_handler (true, FUNC_NAME, errmsg);
+        return NULL;
+    }
+    snprintf (writer->file_name, sizeof (writer->file_name), "%s", outfile);
+    init_raw_binary_checksum (&writer->checksum);
+    writer->fd = -1;
+
+    start_time = espa_io_stats_clock ();
+    writer->blocks = open_raw_binary_blocks_writer (outfile, encoding,
+        nlines, nsamps, size, encoding == RB_ENCODING_RAW_TILES ? tile_size :
+        0);
+    if (writer->blocks == NULL)
+    {
+        sprintf (errmsg, "Creating %s raw binary file %s",
+            raw_binary_encoding_name (encoding), outfile);
+        error_handler (true, FUNC_NAME, errmsg);
+        free (writer);
+        return NULL;
+    }
+
+    espa_io_stats_open (writer, outfile, ESPA_IO_RAW_BINARY, start_time);
+    return writer;
+}
+
+
+/******************************************************************************
+MODULE: append_raw_binary_writer
+
+PURPOSE: Appends the lines to the output file through the coalescing buffer.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error writing the buffer
+SUCCESS      Successful write
+
+NOTES:
+  1. Data larger than the buffer is written directly once the buffer has
+     been flushed, rather than being copied through it.
+*****************************************************************************/
+int append_raw_binary_writer
+(
+    Raw_binary_writer_t *writer, /* I: coalescing writer */
+    int nlines,         /* I: number of lines to write to the file */
+    int nsamps,         /* I: number of samples to write to the file */
+    int size,           /* I: number of bytes per pixel (ex. sizeof(uint8)) */
+    void *img_array     /* I: array of nlines * nsamps * size to be written
+                              after the data already written */
+)
+{
+    char FUNC_NAME[] = "append_raw_binary_writer"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    size_t nbytes;           /* number of bytes to be written */
+    size_t chunk;            /* number of bytes copied into the buffer */
+    double start_time;       /* start of the write for the I/O accounting */
+    char *ptr = img_array;   /* current position in the data */
+
+    nbytes = (size_t) nlines * nsamps * size;
+    update_raw_binary_checksum (&writer->checksum, img_array, nbytes);
+    if (writer->stats != NULL)
+        update_raw_binary_stats (writer->stats, img_array,
+            (size_t) nlines * nsamps);
+    if (writer->browse != NULL)
+    {
+        add_espa_browse_window (writer->browse, writer->browse_channel,
+            writer->browse_line, nlines, 0, nsamps, img_array);
+        writer->browse_line += nlines;
+    }
+
+    if (writer->blocks != NULL)
+    {
+        start_time = espa_io_stats_clock ();
+        if (append_raw_binary_blocks (writer->blocks, nlines, nsamps, size,
+            img_array) != SUCCESS)
+            return ERROR;   /* error message already written */
+        espa_io_stats_record (writer, ESPA_IO_WRITE, nbytes, start_time);
+        return SUCCESS;
+    }
+
+    while (nbytes > 0)
+    {
+        /* Write large data directly once the buffer is empty */
+        if (writer->nbuf == 0 && nbytes >= writer->buf_bytes)
+        {
+            if (rb_writer_put (writer, ptr, nbytes) != SUCCESS)
+            {
+                sprintf (errmsg, "Writing %zu bytes to raw binary file %s",
+                    nbytes, writer->file_name);
+                error_handler (true, FUNC_NAME, errmsg);
+                return ERROR;
+            }
+            return SUCCESS;
+        }
+
+        chunk = writer->buf_bytes - writer->nbuf;
+        if (chunk > nbytes)
+            chunk = nbytes;
+        memcpy (writer->buf + writer->nbuf, ptr, chunk);
+        writer->nbuf += chunk;
+        ptr += chunk;
+        nbytes -= chunk;
+
+        if (writer->nbuf == writer->buf_bytes &&
+            rb_writer_flush (writer) != SUCCESS)
+            return ERROR;
+    }
+
+    return SUCCESS;
+}
+
+
+/******************************************************************************
+MODULE: get_raw_binary_writer_checksum
+
+PURPOSE: Formats the checksum of the pixels appended to the writer.
+
+RETURN VALUE: None
+
+NOTES:
+  1. The checksum is of the pixels as appended, so it is the same for a
+     block-compressed band as for the plain raw binary band.
+*****************************************************************************/
+void get_raw_binary_writer_checksum
+(
+    Raw_binary_writer_t *writer, /* I: writer which has appended all the
+                                       lines of the band */
+    char *checksum       /* O: checksum of the band, for the checksum of its
+                               metadata; at least RB_CHECKSUM_LEN bytes */
+)
+{
+    format_raw_binary_checksum (&writer->checksum, checksum);
+}
+
+
+/******************************************************************************
+MODULE: start_raw_binary_writer_stats
+
+PURPOSE: Starts computing the statistics of the pixels appended to the
+writer.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error allocating the statistics
+SUCCESS      The statistics are computed as the lines are appended
+
+NOTES:
+  1. The fill_value, saturate_value, and valid_range of the band must be set
+     before the statistics are started.
+*****************************************************************************/
+int start_raw_binary_writer_stats
+(
+    Raw_binary_writer_t *writer, /* I: writer which hasn't appended any
+                                       lines yet */
+    const Espa_band_meta_t *bmeta /* I: metadata of the band being written */
+)
+{
+    writer->stats = open_raw_binary_stats (bmeta);
+    if (writer->stats == NULL)
+        return ERROR;   /* error message already written */
+
+    return SUCCESS;
+}
+
+
+/******************************************************************************
+MODULE: start_raw_binary_writer_browse
+
+PURPOSE: Starts adding the pixels appended to the writer to the browse.
+
+RETURN VALUE: None
+
+NOTES:
+  1. The lines must be appended whole, from the first line of the band.
+*****************************************************************************/
+void start_raw_binary_writer_browse
+(
+    Raw_binary_writer_t *writer, /* I: writer which hasn't appended any
+                                       lines yet */
+    Espa_browse_t *browse,       /* I: browse the band is in */
+    int channel                  /* I: channel of the band in the browse */
+)
+{
+    writer->browse = browse;
+    writer->browse_channel = channel;
+    writer->browse_line = 0;
+}
+
+
+/******************************************************************************
+MODULE: start_raw_binary_writer_sparse
+
+PURPOSE: Starts skipping the fill regions of the band as the lines are
+appended to the writer.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error setting up the fill regions
+SUCCESS      The fill regions are skipped, or the band is written as is
+             (the mode is off, the band has no fill value, or it isn't a
+             plain raw binary band written locally)
+
+NOTES:
+  1. The fill_value of the band must be set before the fill regions are
+     started.
+  2. For a fill value of 0 the preallocated space is released, so the
+     blocks of fill are left as holes.
+*****************************************************************************/
+int start_raw_binary_writer_sparse
+(
+    Raw_binary_writer_t *writer, /* I: writer which hasn't appended any
+                                       lines yet */
+    const Espa_band_meta_t *bmeta, /* I: metadata of the band being
+                                         written */
+    Raw_binary_sparse_mode_t mode  /* I: skip the fill regions, write them,
+                                         or per the RB_SPARSE_ENV
+                                         environment variable */
+)
+{
+    char FUNC_NAME[] = "start_raw_binary_writer_sparse"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+
+    if (!use_raw_binary_sparse (mode) || writer->blocks != NULL ||
+        writer->upload != NULL || bmeta->fill_value == ESPA_INT_META_FILL)
+        return SUCCESS;
+
+    writer->sparse = open_raw_binary_sparse (bmeta);
+    if (writer->sparse == NULL)
+    {
+        sprintf (errmsg, "Setting up the fill regions of band %s",
+            bmeta->name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return ERROR;
+    }
+
+    if (writer->sparse->holes && ftruncate (writer->fd, 0) != 0)
+    {
+        sprintf (errmsg, "Releasing the preallocated space of raw binary "
+            "file %s", writer->file_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return ERROR;
+    }
+
+    return SUCCESS;
+}
+
+
+/******************************************************************************
+MODULE: get_raw_binary_writer_stats
+
+PURPOSE: Computes the statistics of the pixels appended to the writer.
+
+RETURN VALUE: None
+
+NOTES:
+*****************************************************************************/
+void get_raw_binary_writer_stats
+(
+    Raw_binary_writer_t *writer, /* I: writer which has appended all the
+                                       lines of the band */
+    Espa_band_stats_t *stats     /* O: statistics of the band, for its
+                                       metadata; not known if they weren't
+                                       started */
+)
+{
+    if (writer->stats == NULL)
+        clear_band_stats (stats);
+    else
+        finish_raw_binary_stats (writer->stats, stats);
+}
+
+
+/******************************************************************************
+MODULE: close_raw_binary_writer
+
+PURPOSE: Flushes the coalescing buffer, trims any unused preallocation, and
+closes the output file.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error flushing or closing the file
+SUCCESS      Successful close
+
+NOTES:
+  1. The writer is freed even if an error occurs.
+  2. A band with holes is extended to its full size, in case it ends with a
+     hole.  A band with fill runs gets its sidecar once it is closed, since
+     the sidecar records the final modification time of the band file.
+  3. An uploaded band only appears in object storage once it is closed, and
+     is discarded if any of it failed to be written.
+*****************************************************************************/
+int close_raw_binary_writer
+(
+    Raw_binary_writer_t *writer  /* I: coalescing writer to be flushed and
+                                       closed */
+)
+{
+    char FUNC_NAME[] = "close_raw_binary_writer"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    int status = SUCCESS;    /* status of the close */
+    double start_time;       /* start of the close for the I/O accounting */
+
+    if (writer == NULL)
+        return SUCCESS;
+
+    close_raw_binary_stats (writer->stats);
+    if (writer->blocks != NULL)
+    {
+        start_time = espa_io_stats_clock ();
+        status = close_raw_binary_blocks_writer (writer->blocks);
+        espa_io_stats_record (writer, ESPA_IO_CLOSE, 0, start_time);
+        free (writer);
+        return status;
+    }
+
+    if (rb_writer_flush (writer) != SUCCESS)
+        status = ERROR;
+
+    /* The flush is tallied as a write, so the close is timed after it */
+    start_time = espa_io_stats_clock ();
+    if (writer->upload != NULL)
+    {
+        if (status == SUCCESS)
+            status = close_espa_upload (writer->upload);
+        else
+            abort_espa_upload (writer->upload);
+        espa_io_stats_record (writer, ESPA_IO_CLOSE, 0, start_time);
+        espa_trace_free (writer->buf);
+        free (writer);
+        return status;
+    }
+
+    /* Don't leave preallocated space past the data that was written */
+    if (status == SUCCESS && ((size_t) writer->offset < writer->total_bytes ||
+        (writer->sparse != NULL && writer->sparse->holes)) &&
+        ftruncate (writer->fd, writer->offset) != 0)
+    {
+        sprintf (errmsg, "Truncating raw binary file %s", writer->file_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        status = ERROR;
+    }
+
+    if (close (writer->fd) != 0 && status == SUCCESS)
+    {
+        sprintf (errmsg, "Closing raw binary file %s", writer->file_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        status = ERROR;
+    }
+    espa_staging_done (writer->file_name);
+
+    if (status == SUCCESS && writer->sparse != NULL &&
+        write_raw_binary_fill_runs (writer->sparse, writer->file_name)
+        != SUCCESS)
+        status = ERROR;   /* error message already written */
+
+    free_raw_binary_sparse (writer->sparse);
+    espa_io_stats_record (writer, ESPA_IO_CLOSE, 0, start_time);
+    espa_trace_free (writer->buf);
+    free (writer);
+    return status;
+}
@@ -0,0 +1,151 @@
+/*****************************************************************************
+FILE: raw_binary_writer.h
+
+PURPOSE: Contains defines and structures for the coalescing raw binary
+writer, which gathers many small sequential writes (i.e. one line at a time)
+into large buffered writes to a preallocated output file.  The writer may
+also produce a block-compressed band (see raw_binary_blocks.h), skip the
+fill regions of the band (see raw_binary_sparse.h), or stream the band to
+object storage (see espa_upload.h).
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+*****************************************************************************/
+
+#ifndef RAW_BINARY_WRITER_H
+#define RAW_BINARY_WRITER_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/types.h>
+#include "error_handler.h"
+#include "raw_binary_io.h"
+#include "raw_binary_blocks.h"
+#include "raw_binary_checksum.h"
+#include "raw_binary_stats.h"
+#include "raw_binary_sparse.h"
+#include "espa_browse.h"
+#include "espa_upload.h"
+
+/* Defines */
+#define RB_WRITER_DEFAULT_MB 16       /* default coalescing buffer size (MB) */
+#define RB_WRITER_MIN_MB 1            /* smallest coalescing buffer (MB) */
+#define RB_WRITER_MAX_MB 64           /* largest coalescing buffer (MB) */
+#define RB_WRITER_MB_ENV "ESPA_WRITE_BUFFER_MB" /* overrides the default
+                                         coalescing buffer size (MB) */
+
+/* Coalescing writer for a single raw binary output file */
+typedef struct
+{
+    char file_name[STR_SIZE]; /* name of the output raw binary file */
+    int fd;                   /* file descriptor of the output file; -1 if
+                                 it is uploaded */
+    size_t total_bytes;       /* expected size of the output file */
+    size_t buf_bytes;         /* size of the coalescing buffer */
+    size_t nbuf;              /* number of bytes in the coalescing buffer */
+    off_t offset;             /* file offset of the start of the buffer */
+    char *buf;                /* coalescing buffer */
+    Rb_blocks_writer_t *blocks; /* writer of the compressed blocks for a
+                                 block-compressed band; NULL for a plain raw
+                                 binary band */
+    Rb_checksum_t checksum;   /* checksum of the pixels appended so far */
+    Rb_stats_t *stats;        /* statistics of the pixels appended so far;
+                                 NULL if they aren't computed */
+    Espa_browse_t *browse;    /* browse the appended lines are added to;
+                                 NULL if the band isn't in a browse */
+    int browse_channel;       /* channel of the band in the browse */
+    int browse_line;          /* next line of the band for the browse */
+    Raw_binary_sparse_t *sparse; /* fill regions of the band, which are left
+                                 as holes or recorded as fill runs; NULL if
+                                 all the blocks are written as is */
+    Espa_upload_t *upload;    /* upload the buffer is streamed to, for an
+                                 output file named by a URL; NULL for a
+                                 local file */
+} Raw_binary_writer_t;
+
+/* Prototypes */
+Raw_binary_writer_t *open_raw_binary_writer
+(
+    char *outfile,       /* I: name of the output file to be created */
+    size_t total_bytes,  /* I: expected size of the output file, which is
+                               preallocated; 0 if not known */
+    int buf_mb           /* I: size of the coalescing buffer in MB; 0 for
+                               the default (or RB_WRITER_MB_ENV) */
+);
+
+Raw_binary_writer_t *open_encoded_raw_binary_writer
+(
+    char *outfile,       /* I: name of the output file to be created */
+    Raw_binary_encoding_t encoding, /* I: encoding of the output file */
+    int nlines,          /* I: number of lines in the band */
+    int nsamps,          /* I: number of samples in the band */
+    int size,            /* I: number of bytes per pixel */
+    int tile_size        /* I: number of lines and samples per tile of a
+                               tiled band; 0 for RB_TILES_DEFAULT_SIZE */
+);
+
+int append_raw_binary_writer
+(
+    Raw_binary_writer_t *writer, /* I: coalescing writer */
+    int nlines,         /* I: number of lines to write to the file */
+    int nsamps,         /* I: number of samples to write to the file */
+    int size,           /* I: number of bytes per pixel (ex. sizeof(uint8)) */
+    void *img_array     /* I: array of nlines * nsamps * size to be written
+                              after the data already written */
+);
+
+void get_raw_binary_writer_checksum
+(
+    Raw_binary_writer_t *writer, /* I: writer which has appended all the
+                                       lines of the band */
+    char *checksum       /* O: checksum of the band, for the checksum of its
+                               metadata; at least RB_CHECKSUM_LEN bytes */
+);
+
+int start_raw_binary_writer_stats
+(
+    Raw_binary_writer_t *writer, /* I: writer which hasn't appended any
+                                       lines yet */
+    const Espa_band_meta_t *bmeta /* I: metadata of the band being written */
+);
+
+void start_raw_binary_writer_browse
+(
+    Raw_binary_writer_t *writer, /* I: writer which hasn't appended any
+                                       lines yet */
+    Espa_browse_t *browse,       /* I: browse the band is in */
+    int channel                  /* I: channel of the band in the browse */
+);
+
+int start_raw_binary_writer_sparse
+(
+    Raw_binary_writer_t *writer, /* I: writer which hasn't appended any
+                                       lines yet */
+    const Espa_band_meta_t *bmeta, /* I: metadata of the band being
+                                         written */
+    Raw_binary_sparse_mode_t mode  /* I: skip the fill regions, write them,
+                                         or per the RB_SPARSE_ENV
+                                         environment variable */
+);
+
+void get_raw_binary_writer_stats
+(
+    Raw_binary_writer_t *writer, /* I: writer which has appended all the
+                                       lines of the band */
+    Espa_band_stats_t *stats     /* O: statistics of the band, for its
+                                       metadata; not known if they weren't
+                                       started */
+);
+
+int close_raw_binary_writer
+(
+    Raw_binary_writer_t *writer  /* I: coalescing writer to be flushed and
+                                       closed */
+);
+
+#endif
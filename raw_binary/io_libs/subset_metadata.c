@@ -3,7 +3,9 @@ FILE: subset_metadata.c
   
 PURPOSE: Contains functions for subsetting the metadata, currently just the
 bands in the metadata, including subsetting the bands by band name or by
-product type.  At this time, spatial subsetting is not supported.
+product type.  The band files may be materialized in the directory of the
+subset (see espa_materialize.h).  Spatial subsets, which cut the pixels of the
+bands, are made by espa_spatial_subset in the format conversion library.
 
 PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
 at the USGS EROS
@@ -17,7 +19,10 @@ NOTES:
      http://espa.cr.usgs.gov/schema/espa_internal_metadata_v1_0.xsd.
 *****************************************************************************/
 #include <math.h>
+#include <libgen.h>
+#include <sys/stat.h>
 #include "subset_metadata.h"
+#include "metadata_cache.h"
 
 /******************************************************************************
 MODULE:  subset_metadata_by_product
@@ -199,6 +204,15 @@ int subset_metadata_by_product
     outmeta->global.bounding_coords[ESPA_SOUTH] =
         inmeta->global.bounding_coords[ESPA_SOUTH];
 
+    count = snprintf (outmeta->global.footprint,
+        sizeof (outmeta->global.footprint), "%s", inmeta->global.footprint);
+    if (count < 0 || count >= sizeof (outmeta->global.footprint))
+    {
+        sprintf (errmsg, "Overflow of outmeta->global.footprint string");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
     /* Copy the projection information */
     outmeta->global.proj_info.proj_type = inmeta->global.proj_info.proj_type;
     outmeta->global.proj_info.datum_type = inmeta->global.proj_info.datum_type;
@@ -318,6 +332,27 @@ int subset_metadata_by_product
         outmeta->band[iband].saturate_value = inmeta->band[i].saturate_value;
         outmeta->band[iband].scale_factor = inmeta->band[i].scale_factor;
         outmeta->band[iband].add_offset = inmeta->band[i].add_offset;
+        outmeta->band[iband].constant_value = inmeta->band[i].constant_value;
+        count = snprintf (outmeta->band[iband].footprint_file,
+            sizeof (outmeta->band[iband].footprint_file), "%s",
+            inmeta->band[i].footprint_file);
+        if (count < 0 ||
+            count >= sizeof (outmeta->band[iband].footprint_file))
+        {
+            sprintf (errmsg,
+                "Overflow of outmeta->band[iband].footprint_file");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+        count = snprintf (outmeta->band[iband].encoding,
+            sizeof (outmeta->band[iband].encoding), "%s",
+            inmeta->band[i].encoding);
+        if (count < 0 || count >= sizeof (outmeta->band[iband].encoding))
+        {
+            sprintf (errmsg, "Overflow of outmeta->band[iband].encoding");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
         outmeta->band[iband].resample_method = inmeta->band[i].resample_method;
         count = snprintf (outmeta->band[iband].short_name,
             sizeof (outmeta->band[iband].short_name), "%s",
@@ -561,7 +596,6 @@ int subset_metadata_by_band
     int iband;               /* current output band */
     int nskip;               /* number of bands skipped as they weren't found
                                 in the input metadata structure */
-    bool found;              /* was the band found */
 
     /* Initialize the output metadata structure */
     init_metadata_struct (outmeta);
@@ -703,6 +737,15 @@ int subset_metadata_by_band
     outmeta->global.bounding_coords[ESPA_SOUTH] =
         inmeta->global.bounding_coords[ESPA_SOUTH];
 
+    count = snprintf (outmeta->global.footprint,
+        sizeof (outmeta->global.footprint), "%s", inmeta->global.footprint);
+    if (count < 0 || count >= sizeof (outmeta->global.footprint))
+    {
+        sprintf (errmsg, "Overflow of outmeta->global.footprint string");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
     /* Copy the projection information */
     outmeta->global.proj_info.proj_type = inmeta->global.proj_info.proj_type;
     outmeta->global.proj_info.datum_type = inmeta->global.proj_info.datum_type;
@@ -761,16 +804,8 @@ int subset_metadata_by_band
     for (i = 0; i < nbands; i++)
     {
         /* Is this band one of those specified for the band subset? */
-        found = false;
-        for (j = 0; j < inmeta->nbands; j++)
-        {
-            if (!strcmp (inmeta->band[j].name, bands[i]))
-            {
-                found = true;
-                break;
-            }
-        }
-        if (!found)
+        j = espa_find_band (inmeta, bands[i]);
+        if (j < 0)
         {
             sprintf (errmsg, "Band '%s' not found in the XML structure. "
                 "Skipping.", bands[i]);
@@ -831,6 +866,27 @@ int subset_metadata_by_band
         outmeta->band[iband].saturate_value = inmeta->band[j].saturate_value;
         outmeta->band[iband].scale_factor = inmeta->band[j].scale_factor;
         outmeta->band[iband].add_offset = inmeta->band[j].add_offset;
+        outmeta->band[iband].constant_value = inmeta->band[j].constant_value;
+        count = snprintf (outmeta->band[iband].footprint_file,
+            sizeof (outmeta->band[iband].footprint_file), "%s",
+            inmeta->band[j].footprint_file);
+        if (count < 0 ||
+            count >= sizeof (outmeta->band[iband].footprint_file))
+        {
+            sprintf (errmsg,
+                "Overflow of outmeta->band[iband].footprint_file");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+        count = snprintf (outmeta->band[iband].encoding,
+            sizeof (outmeta->band[iband].encoding), "%s",
+            inmeta->band[j].encoding);
+        if (count < 0 || count >= sizeof (outmeta->band[iband].encoding))
+        {
+            sprintf (errmsg, "Overflow of outmeta->band[iband].encoding");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
         outmeta->band[iband].resample_method = inmeta->band[j].resample_method;
         count = snprintf (outmeta->band[iband].short_name,
             sizeof (outmeta->band[iband].short_name), "%s",
@@ -1032,82 +1088,524 @@ int subset_metadata_by_band
 
 
 /******************************************************************************
-MODULE:  subset_xml_by_product
+MODULE:  subset_band_nodes
 
-PURPOSE: Subset an XML file to contain only the specified product types.
+PURPOSE: Subsets the band elements of an XML document tree to contain only the
+specified bands or product types.
 
 RETURN VALUE:
 Type = int
 Value           Description
 -----           -----------
-ERROR           Error subsetting the XML file
-SUCCESS         Successfully subset the XML file
+ERROR           Error subsetting the document tree
+SUCCESS         Successfully subset the document tree
 
 NOTES:
-  1. If no bands match the product type, then the global and projection
-     information will still be copied.
+  1. The bands are ordered as in subset_metadata_by_product and
+     subset_metadata_by_band: in the order of the input document for product
+     types, and in the order of the band names for band names.
+  2. The white space preceding each band element is moved along with it, so
+     the subset document keeps the indentation of the input document.
 ******************************************************************************/
-int subset_xml_by_product
+static int subset_band_nodes
 (
-    char *in_xml_file,   /* I: input XML file to be subset */
-    char *out_xml_file,  /* I: output XML file to be subset */
-    int nproducts,       /* I: number of product types to be included in the
-                               subset product */
-    char products[][STR_SIZE]  /* I: array of nproducts product types to be used
-                               for subsetting */
+    xmlDocPtr doc,              /* I/O: document tree to be subset */
+    Espa_xml_subset_t *subset   /* I: bands or products to be kept */
 )
 {
-    char FUNC_NAME[] = "subset_xml_by_product";   /* function name */
-    char errmsg[STR_SIZE];   /* error message */
-    Espa_internal_meta_t in_xml_metadata;  /* XML metadata structure to be
-                                populated by reading the input XML file */
-    Espa_internal_meta_t out_xml_metadata; /* XML metadata structure to be
-                                populated by subsetting the input XML */
-
-    /* Validate the input metadata file */
-    if (validate_xml_file (in_xml_file) != SUCCESS)
-    {  /* Error messages already written */
+    char FUNC_NAME[] = "subset_band_nodes";   /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    xmlNode *root = NULL;       /* root element of the document */
+    xmlNode *bands_node = NULL; /* bands element of the document */
+    xmlNode *cur_node = NULL;   /* current node */
+    xmlNode *next_node = NULL;  /* node following the current node */
+    xmlNode *tail = NULL;       /* white space before the closing </bands> */
+    xmlNode *band_node = NULL;  /* band element being added to the subset */
+    xmlNode *indent_node = NULL;  /* white space preceding band_node */
+    xmlNode **band = NULL;      /* band elements of the input document */
+    xmlNode **indent = NULL;    /* white space preceding each band element */
+    bool *used = NULL;          /* has each band element been added? */
+    xmlChar *attr_val = NULL;   /* attribute value */
+    int nbands = 0;             /* number of band elements */
+    int i, j;                   /* looping variables */
+    int status = SUCCESS;       /* return status */
+
+    /* Find the bands element */
+    root = xmlDocGetRootElement (doc);
+    for (cur_node = root ? root->children : NULL; cur_node;
+        cur_node = cur_node->next)
+    {
+        if (cur_node->type == XML_ELEMENT_NODE &&
+            xmlStrEqual (cur_node->name, (const xmlChar *) "bands"))
+        {
+            bands_node = cur_node;
+            break;
+        }
+    }
+    if (bands_node == NULL)
+    {
+        sprintf (errmsg, "No bands element in the XML document");
+        error_handler (true, FUNC_NAME, errmsg);
         return (ERROR);
     }
 
-    /* Initialize the input metadata structure */
-    init_metadata_struct (&in_xml_metadata);
-
-    /* Parse the metadata file into our internal metadata structure; also
-       allocates space as needed for various pointers in the global and band
-       metadata */
-    if (parse_metadata (in_xml_file, &in_xml_metadata) != SUCCESS)
-    {  /* Error messages already written */
+    /* Detach the band elements, each with its preceding white space */
+    for (cur_node = bands_node->children; cur_node; cur_node = cur_node->next)
+    {
+        if (cur_node->type == XML_ELEMENT_NODE)
+            nbands++;
+    }
+    band = calloc (nbands + 1, sizeof (xmlNode *));
+    indent = calloc (nbands + 1, sizeof (xmlNode *));
+    used = calloc (nbands + 1, sizeof (bool));
+    if (band == NULL || indent == NULL || used == NULL)
+    {
+        sprintf (errmsg, "Allocating memory for the band elements");
+        error_handler (true, FUNC_NAME, errmsg);
+        free (band);
+        free (indent);
+        free (used);
         return (ERROR);
     }
 
-    /* Subset the input XML file using the specified bands */
-    if (subset_metadata_by_product (&in_xml_metadata, &out_xml_metadata,
-        nproducts, products) != SUCCESS)
+    if (bands_node->last && xmlNodeIsText (bands_node->last))
+        tail = bands_node->last;
+    nbands = 0;
+    for (cur_node = bands_node->children; cur_node; cur_node = next_node)
     {
-        sprintf (errmsg, "Subsetting the XML file for the specified products.");
+        next_node = cur_node->next;
+        if (cur_node->type != XML_ELEMENT_NODE)
+            continue;
+        if (cur_node->prev && xmlNodeIsText (cur_node->prev))
+        {
+            indent[nbands] = cur_node->prev;
+            xmlUnlinkNode (indent[nbands]);
+        }
+        band[nbands] = cur_node;
+        xmlUnlinkNode (cur_node);
+        nbands++;
+    }
+
+    /* Add back the bands in the subset */
+    for (i = 0; i < (subset->by_product ? nbands : subset->nnames); i++)
+    {
+        if (subset->by_product)
+        {
+            /* Is this band one of those specified for the product subset? */
+            attr_val = xmlGetProp (band[i], (const xmlChar *) "product");
+            for (j = 0; j < subset->nnames; j++)
+            {
+                if (xmlStrEqual (attr_val,
+                    (const xmlChar *) subset->names[j]))
+                    break;
+            }
+            xmlFree (attr_val);
+            if (j == subset->nnames)
+                continue;
+            j = i;
+        }
+        else
+        {
+            /* Find the first band with this name */
+            for (j = 0; j < nbands; j++)
+            {
+                attr_val = xmlGetProp (band[j], (const xmlChar *) "name");
+                if (xmlStrEqual (attr_val,
+                    (const xmlChar *) subset->names[i]))
+                {
+                    xmlFree (attr_val);
+                    break;
+                }
+                xmlFree (attr_val);
+            }
+            if (j == nbands)
+            {
+                sprintf (errmsg, "Band '%s' not found in the XML structure. "
+                    "Skipping.", subset->names[i]);
+                error_handler (false, FUNC_NAME, errmsg);
+                continue;
+            }
+        }
+
+        /* A band listed more than once is copied */
+        band_node = used[j] ? xmlCopyNode (band[j], 1) : band[j];
+        indent_node = NULL;
+        if (indent[j])
+            indent_node = used[j] ? xmlCopyNode (indent[j], 1) : indent[j];
+        if (band_node == NULL || (indent[j] && indent_node == NULL))
+        {
+            sprintf (errmsg, "Copying the band element");
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+            break;
+        }
+        used[j] = true;
+
+        if (indent_node)
+        {
+            if (tail)
+                xmlAddPrevSibling (tail, indent_node);
+            else
+                xmlAddChild (bands_node, indent_node);
+        }
+        if (tail)
+            xmlAddPrevSibling (tail, band_node);
+        else
+            xmlAddChild (bands_node, band_node);
+    }
+
+    /* Free the bands left out of the subset */
+    for (i = 0; i < nbands; i++)
+    {
+        if (!used[i])
+        {
+            xmlFreeNode (band[i]);
+            if (indent[i])
+                xmlFreeNode (indent[i]);
+        }
+    }
+    free (band);
+    free (indent);
+    free (used);
+
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  materialize_band_nodes
+
+PURPOSE: Materializes the files of the band elements of an XML document tree
+in the output directory of the subset, and points the band elements to them.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error materializing the files
+SUCCESS         Successfully materialized the files
+
+NOTES:
+  1. The raw binary file, its ENVI header (if there is one), and the
+     footprint index of each band are materialized under their base names,
+     so the subset XML file is meant to be written to the same directory.
+     File names with a directory are changed to the base names.
+  2. Files shared by several bands (ex. a footprint index) are materialized
+     once.  Constant bands have no raw binary file.
+******************************************************************************/
+static int materialize_band_nodes
+(
+    xmlDocPtr doc,              /* I/O: document tree of the subset */
+    Espa_xml_subset_t *subset   /* I: output directory and link method */
+)
+{
+    char FUNC_NAME[] = "materialize_band_nodes";   /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    char files[3][STR_SIZE];    /* files of the current band */
+    char (*done)[STR_SIZE] = NULL;  /* files already materialized */
+    char base[STR_SIZE];        /* copy of a file name for basename */
+    char *cptr = NULL;          /* pointer to the file extension */
+    xmlNode *root = NULL;       /* root element of the document */
+    xmlNode *cur_node = NULL;   /* current node */
+    xmlNode *band_node = NULL;  /* current band element */
+    xmlNode *file_node = NULL;  /* file_name element of the band */
+    xmlChar *val = NULL;        /* attribute or element value */
+    int nbands = 0;             /* number of band elements */
+    int ndone = 0;              /* number of files already materialized */
+    int nfiles;                 /* number of files of the current band */
+    int footprint;              /* index of the footprint index in files;
+                                   -1 if the band has none */
+    int nused[ESPA_LINK_NMETHODS] = {0};  /* files materialized by each
+                                             method */
+    int i, j;                   /* looping variables */
+    int status = SUCCESS;       /* return status */
+    struct stat file_stat;      /* status of an ENVI header */
+    Espa_link_method_t used;    /* method used for a file */
+
+    /* Find the band elements */
+    root = xmlDocGetRootElement (doc);
+    for (cur_node = root ? root->children : NULL; cur_node;
+        cur_node = cur_node->next)
+    {
+        if (cur_node->type == XML_ELEMENT_NODE &&
+            xmlStrEqual (cur_node->name, (const xmlChar *) "bands"))
+            break;
+    }
+    if (cur_node == NULL)
+    {
+        sprintf (errmsg, "No bands element in the XML document");
         error_handler (true, FUNC_NAME, errmsg);
         return (ERROR);
     }
+    band_node = cur_node->children;
+    for (cur_node = band_node; cur_node; cur_node = cur_node->next)
+    {
+        if (cur_node->type == XML_ELEMENT_NODE)
+            nbands++;
+    }
 
-    /* Write the subset metadata structure to the output XML filename */
-    if (write_metadata (&out_xml_metadata, out_xml_file) != SUCCESS)
-    {  /* Error messages already written */
+    done = calloc (3 * nbands + 1, sizeof (*done));
+    if (done == NULL)
+    {
+        sprintf (errmsg, "Allocating memory for the file names");
+        error_handler (true, FUNC_NAME, errmsg);
         return (ERROR);
     }
 
-    /* Validate the output metadata file */
-    if (validate_xml_file (out_xml_file) != SUCCESS)
-    {  /* Error messages already written */
+    for (; band_node && status == SUCCESS; band_node = band_node->next)
+    {
+        if (band_node->type != XML_ELEMENT_NODE)
+            continue;
+
+        /* Gather the raw binary file and its header, unless the band is
+           constant, and the footprint index */
+        nfiles = 0;
+        file_node = NULL;
+        val = xmlGetProp (band_node, (const xmlChar *) "constant_value");
+        if (val == NULL)
+        {
+            for (cur_node = band_node->children; cur_node;
+                cur_node = cur_node->next)
+            {
+                if (cur_node->type == XML_ELEMENT_NODE &&
+                    xmlStrEqual (cur_node->name,
+                    (const xmlChar *) "file_name"))
+                {
+                    file_node = cur_node;
+                    break;
+                }
+            }
+        }
+        xmlFree (val);
+        if (file_node != NULL)
+        {
+            val = xmlNodeGetContent (file_node);
+            snprintf (files[nfiles++], STR_SIZE, "%s", (char *) val);
+            xmlFree (val);
+
+            strcpy (files[nfiles], files[0]);
+            cptr = strrchr (files[nfiles], '.');
+            if (cptr != NULL && strchr (cptr, '/') == NULL)
+            {
+                strcpy (cptr, ".hdr");
+                if (stat (files[nfiles], &file_stat) == 0)
+                    nfiles++;
+            }
+        }
+        footprint = -1;
+        val = xmlGetProp (band_node, (const xmlChar *) "footprint_file");
+        if (val != NULL)
+        {
+            footprint = nfiles;
+            snprintf (files[nfiles++], STR_SIZE, "%s", (char *) val);
+        }
+        xmlFree (val);
+
+        /* Materialize the files not already done */
+        for (i = 0; i < nfiles && status == SUCCESS; i++)
+        {
+            for (j = 0; j < ndone; j++)
+            {
+                if (!strcmp (done[j], files[i]))
+                    break;
+            }
+            if (j < ndone)
+                continue;
+
+            if (materialize_file (files[i], subset->out_dir,
+                subset->link_method, &used) != SUCCESS)
+            {
+                sprintf (errmsg, "Materializing %s in %s", files[i],
+                    subset->out_dir);
+                error_handler (true, FUNC_NAME, errmsg);
+                status = ERROR;
+                break;
+            }
+            strcpy (done[ndone++], files[i]);
+            nused[used]++;
+        }
+        if (status != SUCCESS)
+            break;
+
+        /* Point the band to the materialized files */
+        if (file_node != NULL && strchr (files[0], '/') != NULL)
+        {
+            strcpy (base, files[0]);
+            xmlNodeSetContent (file_node, (const xmlChar *) basename (base));
+        }
+        if (footprint >= 0 && strchr (files[footprint], '/') != NULL)
+        {
+            strcpy (base, files[footprint]);
+            xmlSetProp (band_node, (const xmlChar *) "footprint_file",
+                (const xmlChar *) basename (base));
+        }
+    }
+    free (done);
+
+    if (status == SUCCESS)
+    {
+        printf ("  Materialized %d files in %s:", ndone, subset->out_dir);
+        for (i = 0; i < ESPA_LINK_NMETHODS; i++)
+            printf (" %d %s%s", nused[i], link_method_name (i),
+                i < ESPA_LINK_NMETHODS - 1 ? "," : "\n");
+    }
+
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  subset_xml_files
+
+PURPOSE: Subset an XML file into one or more XML files, each containing only
+the specified bands or product types.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error subsetting the XML file
+SUCCESS         Successfully wrote all the subset XML files
+
+NOTES:
+  1. The input XML file is read and validated once, and each subset is made
+     by removing band elements from a copy of its document tree, so the
+     metadata is never parsed into (or copied between) metadata structures.
+     Everything other than the band elements is written as it was read.
+  2. Each subset document is validated in memory once it has been written.
+     If no bands are left in a subset, the global and projection information
+     is still written, but the subset won't validate.
+  3. If the subset has an out_dir, the files of its bands are materialized
+     there before the subset XML file is written (see
+     materialize_band_nodes).
+******************************************************************************/
+int subset_xml_files
+(
+    char *in_xml_file,   /* I: input XML file to be subset */
+    int nsubsets,        /* I: number of subsets to be written */
+    Espa_xml_subset_t *subsets  /* I: array of nsubsets subsets, each written
+                               to its own output XML file */
+)
+{
+    char FUNC_NAME[] = "subset_xml_files";   /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    int i;                   /* looping variable */
+    int status = SUCCESS;    /* return status */
+    xmlDocPtr doc = NULL;    /* document tree of the input XML file */
+    xmlDocPtr out_doc = NULL;  /* document tree of the current subset */
+
+    /* Load the XML file, keeping the white space so the subsets keep the
+       layout of the input file, and validate it */
+    doc = xmlReadFile (in_xml_file, NULL, 0);
+    if (doc == NULL)
+    {
+        sprintf (errmsg, "Could not parse %s", in_xml_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    if (validate_xml_doc (doc, in_xml_file) != SUCCESS)
+    {
+        sprintf (errmsg, "Validating %s", in_xml_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        xmlFreeDoc (doc);
         return (ERROR);
     }
 
-    /* Free the metadata structures */
-    free_metadata (&in_xml_metadata);
-    free_metadata (&out_xml_metadata);
+    for (i = 0; i < nsubsets && status == SUCCESS; i++)
+    {
+        /* The last subset can use the input document itself */
+        out_doc = (i == nsubsets - 1) ? doc : xmlCopyDoc (doc, 1);
+        if (out_doc == NULL)
+        {
+            sprintf (errmsg, "Copying the document tree of %s", in_xml_file);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+            break;
+        }
 
-    /* Successful subset */
-    return (SUCCESS);
+        if (subset_band_nodes (out_doc, &subsets[i]) != SUCCESS)
+        {
+            sprintf (errmsg, "Subsetting the XML file for %s",
+                subsets[i].out_xml_file);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+        }
+        else if (subsets[i].out_dir != NULL &&
+            materialize_band_nodes (out_doc, &subsets[i]) != SUCCESS)
+        {
+            sprintf (errmsg, "Materializing the bands of %s",
+                subsets[i].out_xml_file);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+        }
+        else if (xmlSaveFile (subsets[i].out_xml_file, out_doc) < 0)
+        {
+            sprintf (errmsg, "Writing the subset XML file %s",
+                subsets[i].out_xml_file);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+        }
+        else if (validate_xml_doc (out_doc, subsets[i].out_xml_file) !=
+            SUCCESS)
+        {  /* Error messages already written */
+            status = ERROR;
+        }
+        else if (use_metadata_cache () &&
+            refresh_metadata_cache (subsets[i].out_xml_file) != SUCCESS)
+        {
+            sprintf (errmsg, "Continuing without a metadata cache for %s",
+                subsets[i].out_xml_file);
+            error_handler (false, FUNC_NAME, errmsg);
+        }
+
+        if (out_doc != doc)
+            xmlFreeDoc (out_doc);
+    }
+
+    /* Free the document and associated memory */
+    xmlFreeDoc (doc);
+    cleanup_espa_xml ();
+
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  subset_xml_by_product
+
+PURPOSE: Subset an XML file to contain only the specified product types.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error subsetting the XML file
+SUCCESS         Successfully subset the XML file
+
+NOTES:
+  1. If no bands match the product type, then the global and projection
+     information will still be copied.
+  2. Use subset_xml_files to write several subsets of the same XML file.
+******************************************************************************/
+int subset_xml_by_product
+(
+    char *in_xml_file,   /* I: input XML file to be subset */
+    char *out_xml_file,  /* I: output XML file to be subset */
+    int nproducts,       /* I: number of product types to be included in the
+                               subset product */
+    char products[][STR_SIZE]  /* I: array of nproducts product types to be used
+                               for subsetting */
+)
+{
+    Espa_xml_subset_t subset;  /* product subset to be written */
+
+    subset.out_xml_file = out_xml_file;
+    subset.by_product = true;
+    subset.nnames = nproducts;
+    subset.names = products;
+    subset.out_dir = NULL;
+
+    return (subset_xml_files (in_xml_file, 1, &subset));
 }
 
 
@@ -1126,6 +1624,7 @@ SUCCESS         Successfully subset the XML file
 NOTES:
   1. If nbands is 0, then the global and projection information will still
      be copied.
+  2. Use subset_xml_files to write several subsets of the same XML file.
 ******************************************************************************/
 int subset_xml_by_band
 (
@@ -1137,56 +1636,14 @@ int subset_xml_by_band
                                the subset XML file */
 )
 {
-    char FUNC_NAME[] = "subset_xml_by_band";   /* function name */
-    char errmsg[STR_SIZE];   /* error message */
-    Espa_internal_meta_t in_xml_metadata;  /* XML metadata structure to be
-                                populated by reading the input XML file */
-    Espa_internal_meta_t out_xml_metadata; /* XML metadata structure to be
-                                populated by subsetting the input XML */
-
-    /* Validate the input metadata file */
-    if (validate_xml_file (in_xml_file) != SUCCESS)
-    {  /* Error messages already written */
-        return (ERROR);
-    }
+    Espa_xml_subset_t subset;  /* band subset to be written */
 
-    /* Initialize the input metadata structure */
-    init_metadata_struct (&in_xml_metadata);
+    subset.out_xml_file = out_xml_file;
+    subset.by_product = false;
+    subset.nnames = nbands;
+    subset.names = bands;
+    subset.out_dir = NULL;
 
-    /* Parse the metadata file into our internal metadata structure; also
-       allocates space as needed for various pointers in the global and band
-       metadata */
-    if (parse_metadata (in_xml_file, &in_xml_metadata) != SUCCESS)
-    {  /* Error messages already written */
-        return (ERROR);
-    }
-
-    /* Subset the input XML file using the specified bands */
-    if (subset_metadata_by_band (&in_xml_metadata, &out_xml_metadata,
-        nbands, bands) != SUCCESS)
-    {
-        sprintf (errmsg, "Subsetting the XML file for the specified bands.");
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
-    }
-
-    /* Write the subset metadata structure to the output XML filename */
-    if (write_metadata (&out_xml_metadata, out_xml_file) != SUCCESS)
-    {  /* Error messages already written */
-        return (ERROR);
-    }
-
-    /* Validate the output metadata file */
-    if (validate_xml_file (out_xml_file) != SUCCESS)
-    {  /* Error messages already written */
-        return (ERROR);
-    }
-
-    /* Free the metadata structures */
-    free_metadata (&in_xml_metadata);
-    free_metadata (&out_xml_metadata);
-
-    /* Successful subset */
-    return (SUCCESS);
+    return (subset_xml_files (in_xml_file, 1, &subset));
 }
 
@@ -17,13 +17,31 @@ NOTES:
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <stdbool.h>
 #include "error_handler.h"
 #include "espa_metadata.h"
 #include "parse_metadata.h"
 #include "write_metadata.h"
+#include "espa_materialize.h"
 
 /* Defines */
 
+/* One subset of an XML file, for subset_xml_files */
+typedef struct
+{
+    char *out_xml_file;       /* output XML file for the subset */
+    bool by_product;          /* are the names product types, rather than
+                                 band names? */
+    int nnames;               /* number of band names or product types to be
+                                 included in the subset */
+    char (*names)[STR_SIZE];  /* array of nnames band names or product types */
+    char *out_dir;            /* directory to materialize the files of the
+                                 subset bands in; NULL to leave them where
+                                 they are */
+    Espa_link_method_t link_method;  /* preferred method of materializing the
+                                 files (see espa_materialize.h) */
+} Espa_xml_subset_t;
+
 /* Prototypes */
 int subset_metadata_by_product
 (
@@ -69,4 +87,12 @@ int subset_xml_by_band
                                the subset XML file */
 );
 
+int subset_xml_files
+(
+    char *in_xml_file,   /* I: input XML file to be subset */
+    int nsubsets,        /* I: number of subsets to be written */
+    Espa_xml_subset_t *subsets  /* I: array of nsubsets subsets, each written
+                               to its own output XML file */
+);
+
 #endif
@@ -0,0 +1,957 @@
+/*****************************************************************************
+FILE: tiff_cog.c
+
+PURPOSE: Contains functions for writing Cloud-Optimized GeoTIFF (COG) bands.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The tiles are predicted and compressed here, a row of tiles at a time
+     across the threads, and written to the file as raw tiles.  libtiff only
+     lays out the file.
+  2. The overviews are decimated by two at each level, using the UL pixel of
+     each 2x2 block (nearest neighbor), so QA and class bands keep their
+     values.  Overviews are added until the smallest fits in a single tile.
+  3. The predictor is horizontal differencing for the integer data types and
+     the floating point predictor for the float data types.  It's assumed we
+     are running on Linux, thus the pixels are little endian, and the file
+     is written in the native byte order.
+*****************************************************************************/
+#include <stdint.h>
+#include <zlib.h>
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+#include "tiff_cog.h"
+#include "espa_trace.h"
+#include "espa_task_pool.h"
+
+/* The deferred strile array writing needed for the COG layout came with
+   libtiff 4.1 */
+#if defined (TIFFLIB_VERSION) && TIFFLIB_VERSION >= 20191103
+#define COG_SUPPORTED
+#endif
+
+/* TIFF LZW codes */
+#define LZW_CLEAR 256        /* clear code */
+#define LZW_EOI 257          /* end of information code */
+#define LZW_FIRST 258        /* first free code */
+#define LZW_BITS_MIN 9       /* starting code width */
+#define LZW_CODE_MAX 4095    /* largest code, for 12 bit codes */
+#define LZW_HASH_SIZE 9001   /* size of the LZW hash table; a prime about
+                                twice the number of codes */
+#define LZW_HASH_SHIFT 5     /* shift of the next byte in the hash */
+
+#define ZSTD_LEVEL 9         /* ZSTD compression level, as libtiff uses */
+
+/* Tile buffers for writing a row of tiles */
+typedef struct
+{
+    TIFF *tiff;              /* COG file */
+    Cog_compression_t compression;  /* compression of the tiles */
+    int data_type;           /* ESPA data type of the band */
+    int size;                /* number of bytes per pixel */
+    size_t tile_bytes;       /* number of bytes in an uncompressed tile */
+    size_t out_bytes;        /* largest number of bytes of a compressed
+                                tile */
+    unsigned char *tile_buf; /* uncompressed tiles of the row */
+    unsigned char *out_buf;  /* compressed tiles of the row */
+    size_t *out_len;         /* number of bytes of each compressed tile; 0 if
+                                the tile couldn't be compressed */
+} Cog_writer_t;
+
+/* Row of tiles being compressed, shared by the iterations of the loop over
+   the tiles */
+typedef struct
+{
+    Cog_writer_t *writer;        /* tile buffers and COG file */
+    const unsigned char *rows;   /* lines of the row of tiles */
+    int nrows;                   /* number of lines in rows */
+    int nsamps;                  /* number of samples per line */
+} Cog_tile_row_t;
+
+
+/******************************************************************************
+MODULE: parse_cog_compression
+
+PURPOSE: Converts the name of a compression to the COG compression
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Unknown or unsupported compression
+SUCCESS      Successfully converted the compression
+
+NOTES:
+*****************************************************************************/
+int parse_cog_compression
+(
+    char *name,                      /* I: name of the compression (none,
+                                           deflate, lzw, or zstd) */
+    Cog_compression_t *compression   /* O: compression of the COG tiles */
+)
+{
+    char FUNC_NAME[] = "parse_cog_compression"; /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+
+    if (!strcmp (name, "none"))
+        *compression = COG_COMPRESS_NONE;
+    else if (!strcmp (name, "deflate"))
+        *compression = COG_COMPRESS_DEFLATE;
+    else if (!strcmp (name, "lzw"))
+        *compression = COG_COMPRESS_LZW;
+    else if (!strcmp (name, "zstd"))
+    {
+#ifdef HAVE_ZSTD
+        *compression = COG_COMPRESS_ZSTD;
+#else
+        sprintf (errmsg, "ZSTD compression is not supported by this build");
+        error_handler (true, FUNC_NAME, errmsg);
+        return ERROR;
+#endif
+    }
+    else
+    {
+        sprintf (errmsg, "Unknown compression %s; expected none, deflate, "
+            "lzw, or zstd", name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return ERROR;
+    }
+
+    return SUCCESS;
+}
+
+
+/******************************************************************************
+MODULE: cog_tiff_compression / cog_tiff_predictor
+
+PURPOSE: Return the Tiff compression scheme and predictor of the COG tiles
+*****************************************************************************/
+static int cog_tiff_compression
+(
+    Cog_compression_t compression    /* I: compression of the COG tiles */
+)
+{
+    switch (compression)
+    {
+        case COG_COMPRESS_DEFLATE: return COMPRESSION_ADOBE_DEFLATE;
+        case COG_COMPRESS_LZW: return COMPRESSION_LZW;
+#ifdef HAVE_ZSTD
+        case COG_COMPRESS_ZSTD: return COMPRESSION_ZSTD;
+#endif
+        default: return COMPRESSION_NONE;
+    }
+}
+
+static int cog_tiff_predictor
+(
+    int data_type    /* I: ESPA data type of the band */
+)
+{
+    if (data_type == ESPA_FLOAT32 || data_type == ESPA_FLOAT64)
+        return PREDICTOR_FLOATINGPOINT;
+    return PREDICTOR_HORIZONTAL;
+}
+
+
+/******************************************************************************
+MODULE: predict_tile
+
+PURPOSE: Applies the Tiff predictor to each line of an uncompressed tile
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error allocating memory for the floating point predictor
+SUCCESS      Successfully applied the predictor
+
+NOTES:
+  1. Horizontal differencing replaces each sample by its difference from the
+     previous sample, wrapping around in the data type.
+  2. The floating point predictor first splits each line into byte planes,
+     most significant byte first, and then differences the bytes.
+*****************************************************************************/
+static int predict_tile
+(
+    unsigned char *tile,     /* I/O: tile to be predicted */
+    int tile_size,           /* I: number of lines and samples in the tile */
+    int data_type,           /* I: ESPA data type of the band */
+    int size                 /* I: number of bytes per pixel */
+)
+{
+    int line;                /* looping variable for the lines */
+    int samp;                /* looping variable for the samples */
+    int byte;                /* looping variable for the bytes */
+    size_t line_bytes = (size_t) tile_size * size;  /* bytes per line */
+    size_t i;                /* looping variable for the bytes of a line */
+    unsigned char *cp = NULL;    /* current line */
+    unsigned char *tmp = NULL;   /* copy of a line for the byte planes */
+
+    if (cog_tiff_predictor (data_type) == PREDICTOR_FLOATINGPOINT)
+    {
+        tmp = malloc (line_bytes);
+        if (tmp == NULL)
+            return ERROR;
+
+        for (line = 0; line < tile_size; line++)
+        {
+            cp = tile + line * line_bytes;
+            memcpy (tmp, cp, line_bytes);
+            for (samp = 0; samp < tile_size; samp++)
+                for (byte = 0; byte < size; byte++)
+                    cp[(size_t) (size - byte - 1) * tile_size + samp] =
+                        tmp[(size_t) size * samp + byte];
+            for (i = line_bytes - 1; i > 0; i--)
+                cp[i] -= cp[i-1];
+        }
+
+        free (tmp);
+        return SUCCESS;
+    }
+
+    for (line = 0; line < tile_size; line++)
+    {
+        cp = tile + line * line_bytes;
+        switch (size)
+        {
+            case 1:
+            {
+                uint8_t *p = (uint8_t *) cp;
+                for (samp = tile_size - 1; samp > 0; samp--)
+                    p[samp] -= p[samp-1];
+                break;
+            }
+            case 2:
+            {
+                uint16_t *p = (uint16_t *) cp;
+                for (samp = tile_size - 1; samp > 0; samp--)
+                    p[samp] -= p[samp-1];
+                break;
+            }
+            case 4:
+            {
+                uint32_t *p = (uint32_t *) cp;
+                for (samp = tile_size - 1; samp > 0; samp--)
+                    p[samp] -= p[samp-1];
+                break;
+            }
+        }
+    }
+
+    return SUCCESS;
+}
+
+
+/******************************************************************************
+MODULE: put_lzw_code
+
+PURPOSE: Appends an LZW code to the output, most significant bit first
+*****************************************************************************/
+static void put_lzw_code
+(
+    unsigned char **op,      /* I/O: next output byte */
+    uint32_t *nextdata,      /* I/O: bits not yet written */
+    int *nextbits,           /* I/O: number of bits not yet written */
+    int code,                /* I: code to be written */
+    int nbits                /* I: width of the code */
+)
+{
+    *nextdata = (*nextdata << nbits) | code;
+    *nextbits += nbits;
+    while (*nextbits >= 8)
+    {
+        *(*op)++ = (unsigned char) (*nextdata >> (*nextbits - 8));
+        *nextbits -= 8;
+    }
+    *nextdata &= (1U << *nextbits) - 1;
+}
+
+
+/******************************************************************************
+MODULE: encode_lzw
+
+PURPOSE: Compresses a buffer with the Tiff flavor of LZW
+
+RETURN VALUE:
+Type = size_t
+Value        Description
+-----        -----------
+0            Error allocating the LZW hash table
+> 0          Number of bytes of compressed output
+
+NOTES:
+  1. The codes are written most significant bit first and grow from 9 to 12
+     bits with the early change of the Tiff LZW, the same way as the libtiff
+     encoder.  The table is cleared once it is full.
+  2. The output needs nbytes * 3 / 2 + 16 bytes at most.
+*****************************************************************************/
+static size_t encode_lzw
+(
+    const unsigned char *in, /* I: data to be compressed */
+    size_t nbytes,           /* I: number of bytes of data */
+    unsigned char *out       /* O: compressed data */
+)
+{
+    int32_t *hash_key = NULL;    /* prefix code and byte of each entry; -1 if
+                                    empty */
+    uint16_t *hash_code = NULL;  /* code of each entry */
+    unsigned char *op = out;     /* next output byte */
+    uint32_t nextdata = 0;       /* bits not yet written */
+    int nextbits = 0;            /* number of bits not yet written */
+    int nbits = LZW_BITS_MIN;    /* current code width */
+    int maxcode = (1 << LZW_BITS_MIN) - 1;  /* largest code of the width */
+    int free_ent = LZW_FIRST;    /* next free code */
+    int ent;                     /* code of the current prefix */
+    int c;                       /* next byte */
+    int h;                       /* hash table index */
+    int disp;                    /* secondary hash displacement */
+    int32_t fcode;               /* prefix code and byte */
+    size_t i;                    /* looping variable */
+
+    hash_key = malloc (LZW_HASH_SIZE * sizeof (int32_t));
+    hash_code = malloc (LZW_HASH_SIZE * sizeof (uint16_t));
+    if (hash_key == NULL || hash_code == NULL)
+    {
+        free (hash_key);
+        free (hash_code);
+        return 0;
+    }
+    for (h = 0; h < LZW_HASH_SIZE; h++)
+        hash_key[h] = -1;
+
+    put_lzw_code (&op, &nextdata, &nextbits, LZW_CLEAR, nbits);
+    if (nbytes > 0)
+    {
+        ent = in[0];
+        for (i = 1; i < nbytes; i++)
+        {
+            c = in[i];
+            fcode = ((int32_t) c << 12) + ent;
+            h = (c << LZW_HASH_SHIFT) ^ ent;
+            if (hash_key[h] == fcode)
+            {
+                ent = hash_code[h];
+                continue;
+            }
+            if (hash_key[h] >= 0)
+            {
+                /* Secondary hash */
+                disp = (h == 0) ? 1 : LZW_HASH_SIZE - h;
+                do
+                {
+                    h -= disp;
+                    if (h < 0)
+                        h += LZW_HASH_SIZE;
+                } while (hash_key[h] >= 0 && hash_key[h] != fcode);
+                if (hash_key[h] == fcode)
+                {
+                    ent = hash_code[h];
+                    continue;
+                }
+            }
+
+            /* New string; write the prefix and add the string */
+            put_lzw_code (&op, &nextdata, &nextbits, ent, nbits);
+            ent = c;
+            hash_key[h] = fcode;
+            hash_code[h] = (uint16_t) free_ent++;
+            if (free_ent == LZW_CODE_MAX - 1)
+            {
+                /* Table is full; clear it */
+                for (h = 0; h < LZW_HASH_SIZE; h++)
+                    hash_key[h] = -1;
+                free_ent = LZW_FIRST;
+                put_lzw_code (&op, &nextdata, &nextbits, LZW_CLEAR, nbits);
+                nbits = LZW_BITS_MIN;
+                maxcode = (1 << LZW_BITS_MIN) - 1;
+            }
+            else if (free_ent > maxcode)
+            {
+                nbits++;
+                maxcode = (1 << nbits) - 1;
+            }
+        }
+
+        /* Write the last prefix, adjusting the width as the decoder will */
+        put_lzw_code (&op, &nextdata, &nextbits, ent, nbits);
+        free_ent++;
+        if (free_ent == LZW_CODE_MAX - 1)
+        {
+            put_lzw_code (&op, &nextdata, &nextbits, LZW_CLEAR, nbits);
+            nbits = LZW_BITS_MIN;
+        }
+        else if (free_ent > maxcode)
+            nbits++;
+    }
+    put_lzw_code (&op, &nextdata, &nextbits, LZW_EOI, nbits);
+    if (nextbits > 0)
+        *op++ = (unsigned char) (nextdata << (8 - nextbits));
+
+    free (hash_key);
+    free (hash_code);
+    return (size_t) (op - out);
+}
+
+
+/******************************************************************************
+MODULE: compress_bound
+
+PURPOSE: Returns the largest number of bytes of a compressed tile
+*****************************************************************************/
+static size_t compress_bound
+(
+    Cog_compression_t compression,   /* I: compression of the tiles */
+    size_t nbytes                    /* I: number of bytes of a tile */
+)
+{
+    switch (compression)
+    {
+        case COG_COMPRESS_DEFLATE: return compressBound (nbytes);
+        case COG_COMPRESS_LZW: return nbytes + nbytes / 2 + 16;
+#ifdef HAVE_ZSTD
+        case COG_COMPRESS_ZSTD: return ZSTD_compressBound (nbytes);
+#endif
+        default: return nbytes;
+    }
+}
+
+
+/******************************************************************************
+MODULE: compress_tile
+
+PURPOSE: Compresses a tile
+
+RETURN VALUE:
+Type = size_t
+Value        Description
+-----        -----------
+0            Error compressing the tile
+> 0          Number of bytes of the compressed tile
+
+NOTES:
+  1. The output needs compress_bound bytes.
+*****************************************************************************/
+static size_t compress_tile
+(
+    Cog_compression_t compression,   /* I: compression of the tiles */
+    const unsigned char *tile,       /* I: tile to be compressed */
+    size_t nbytes,                   /* I: number of bytes of the tile */
+    unsigned char *out,              /* O: compressed tile */
+    size_t out_bytes                 /* I: size of the output */
+)
+{
+    uLongf out_len = out_bytes;      /* number of bytes of deflate output */
+#ifdef HAVE_ZSTD
+    size_t zstd_len;                 /* number of bytes of ZSTD output */
+#endif
+
+    switch (compression)
+    {
+        case COG_COMPRESS_DEFLATE:
+            if (compress2 (out, &out_len, tile, nbytes, Z_DEFAULT_COMPRESSION)
+                != Z_OK)
+                return 0;
+            return out_len;
+
+        case COG_COMPRESS_LZW:
+            return encode_lzw (tile, nbytes, out);
+
+#ifdef HAVE_ZSTD
+        case COG_COMPRESS_ZSTD:
+            zstd_len = ZSTD_compress (out, out_bytes, tile, nbytes,
+                ZSTD_LEVEL);
+            if (ZSTD_isError (zstd_len))
+                return 0;
+            return zstd_len;
+#endif
+
+        default:
+            memcpy (out, tile, nbytes);
+            return nbytes;
+    }
+}
+
+
+/******************************************************************************
+MODULE: compress_row_tile
+
+PURPOSE: Copies a tile out of a row of tiles and compresses it, as an
+iteration of the loop over the tiles
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+SUCCESS      Always; the compressed length of the tile is 0 if it couldn't
+             be compressed, which write_tile_row reports
+
+NOTES:
+  1. Each tile has its own buffers in the writer, so the tiles are
+     compressed at the same time.
+*****************************************************************************/
+static int compress_row_tile
+(
+    void *arg,                   /* I/O: row of tiles being compressed */
+    int tile,                    /* I: 0-based tile of the row */
+    int worker                   /* I: index of the worker (unused) */
+)
+{
+    Cog_tile_row_t *row = arg;   /* row of tiles being compressed */
+    Cog_writer_t *writer = row->writer;  /* tile buffers and COG file */
+    int size = writer->size;     /* number of bytes per pixel */
+    int line;                    /* looping variable for the lines */
+    int width;                   /* number of image samples in the tile */
+    unsigned char *tile_buf;     /* uncompressed tile */
+    unsigned char *out_buf;      /* compressed tile */
+
+    tile_buf = writer->tile_buf + tile * writer->tile_bytes;
+    out_buf = writer->out_buf + tile * writer->out_bytes;
+
+    width = row->nsamps - tile * COG_TILE_SIZE;
+    if (width > COG_TILE_SIZE)
+        width = COG_TILE_SIZE;
+    memset (tile_buf, 0, writer->tile_bytes);
+    for (line = 0; line < row->nrows; line++)
+        memcpy (tile_buf + (size_t) line * COG_TILE_SIZE * size,
+            row->rows + ((size_t) line * row->nsamps + tile * COG_TILE_SIZE)
+            * size, (size_t) width * size);
+
+    writer->out_len[tile] = 0;
+    if (writer->compression != COG_COMPRESS_NONE &&
+        predict_tile (tile_buf, COG_TILE_SIZE, writer->data_type, size)
+        != SUCCESS)
+        return SUCCESS;
+    writer->out_len[tile] = compress_tile (writer->compression, tile_buf,
+        writer->tile_bytes, out_buf, writer->out_bytes);
+
+    return SUCCESS;
+}
+
+
+/******************************************************************************
+MODULE: write_tile_row
+
+PURPOSE: Compresses a row of tiles across the threads and writes them to the
+current image of the COG
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error compressing or writing the tiles
+SUCCESS      Successfully wrote the row of tiles
+
+NOTES:
+  1. The tiles past the edges of the image are filled with zeros.
+*****************************************************************************/
+static int write_tile_row
+(
+    Cog_writer_t *writer,        /* I: tile buffers and COG file */
+    const unsigned char *rows,   /* I: lines of the row of tiles */
+    int nrows,                   /* I: number of lines in rows */
+    int nsamps,                  /* I: number of samples per line */
+    int tile_row                 /* I: 0-based row of tiles */
+)
+{
+    char FUNC_NAME[] = "write_tile_row"; /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    int ntiles;                 /* number of tiles across */
+    int tile;                   /* looping variable for the tiles */
+    double start_time;          /* start of the write for the I/O accounting */
+    size_t nbytes = 0;          /* number of bytes written */
+    Cog_tile_row_t row;         /* row of tiles being compressed */
+
+    ntiles = (nsamps + COG_TILE_SIZE - 1) / COG_TILE_SIZE;
+
+    /* Compress the tiles on the task pool */
+    row.writer = writer;
+    row.rows = rows;
+    row.nrows = nrows;
+    row.nsamps = nsamps;
+    espa_parallel_for (ntiles, 0, compress_row_tile, &row);
+
+    /* Write the tiles in order */
+    start_time = espa_io_stats_clock ();
+    for (tile = 0; tile < ntiles; tile++)
+    {
+        if (writer->out_len[tile] == 0)
+        {
+            sprintf (errmsg, "Compressing tile %d of tile row %d", tile,
+                tile_row);
+            error_handler (true, FUNC_NAME, errmsg);
+            return ERROR;
+        }
+
+        if (TIFFWriteRawTile (writer->tiff, tile_row * ntiles + tile,
+            writer->out_buf + tile * writer->out_bytes,
+            writer->out_len[tile]) != (tmsize_t) writer->out_len[tile])
+        {
+            espa_io_stats_record (writer->tiff, ESPA_IO_WRITE, nbytes,
+                start_time);
+            sprintf (errmsg, "Writing tile %d of tile row %d", tile,
+                tile_row);
+            error_handler (true, FUNC_NAME, errmsg);
+            return ERROR;
+        }
+        nbytes += writer->out_len[tile];
+    }
+    espa_io_stats_record (writer->tiff, ESPA_IO_WRITE, nbytes, start_time);
+
+    return SUCCESS;
+}
+
+
+/******************************************************************************
+MODULE: write_level_tiles
+
+PURPOSE: Writes all the tiles of an overview held in memory
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error writing the tiles
+SUCCESS      Successfully wrote the tiles
+*****************************************************************************/
+static int write_level_tiles
+(
+    Cog_writer_t *writer,        /* I: tile buffers and COG file */
+    const unsigned char *level,  /* I: pixels of the overview */
+    int nlines,                  /* I: number of lines in the overview */
+    int nsamps                   /* I: number of samples in the overview */
+)
+{
+    int tile_row;               /* looping variable for the rows of tiles */
+    int nrows;                  /* number of lines in the row of tiles */
+
+    for (tile_row = 0; tile_row * COG_TILE_SIZE < nlines; tile_row++)
+    {
+        nrows = nlines - tile_row * COG_TILE_SIZE;
+        if (nrows > COG_TILE_SIZE)
+            nrows = COG_TILE_SIZE;
+        if (write_tile_row (writer, level + (size_t) tile_row *
+            COG_TILE_SIZE * nsamps * writer->size, nrows, nsamps, tile_row)
+            != SUCCESS)
+            return ERROR;
+    }
+
+    return SUCCESS;
+}
+
+
+/******************************************************************************
+MODULE: decimate
+
+PURPOSE: Copies every other pixel of a line, starting with the first
+*****************************************************************************/
+static void decimate
+(
+    const unsigned char *in,     /* I: line to be decimated */
+    int nsamps,                  /* I: number of samples in the output */
+    int size,                    /* I: number of bytes per pixel */
+    unsigned char *out           /* O: decimated line */
+)
+{
+    int samp;                   /* looping variable for the samples */
+
+    for (samp = 0; samp < nsamps; samp++)
+        memcpy (out + (size_t) samp * size, in + (size_t) 2 * samp * size,
+            size);
+}
+
+
+/******************************************************************************
+MODULE: write_cog_band
+
+PURPOSE: Writes a band to a Cloud-Optimized GeoTIFF file
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error reading the band or writing the COG
+SUCCESS      Successfully wrote the COG
+
+NOTES:
+  1. The band is read twice through the band stack: once for the first
+     overview, which is held in memory with the smaller overviews (a third of
+     the band at most), and once for the full resolution tiles.  Constant
+     bands are synthesized by the band stack.
+  2. The image file directories of all the levels are written first, with
+     their tile offsets deferred.  The tiles are then written from the
+     smallest overview through to the full resolution image, and the tile
+     offsets of each level are filled in once its tiles are written.
+  3. The nodata tag is written for every level if the fill value of the band
+     is defined.  The GeoTIFF tags are written for the full resolution image.
+*****************************************************************************/
+int write_cog_band
+(
+    char *cog_file,                     /* I: name of the COG file */
+    Espa_internal_meta_t *xml_metadata, /* I: XML metadata structure */
+    int band,                           /* I: index of the band */
+    Cog_compression_t compression       /* I: compression of the tiles */
+)
+{
+    char FUNC_NAME[] = "write_cog_band"; /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+#ifdef COG_SUPPORTED
+    int status = SUCCESS;       /* return status */
+    int nlevels = 0;            /* number of overview levels */
+    int level;                  /* looping variable for the levels */
+    int line;                   /* current line of the band */
+    int bl;                     /* looping variable for the block lines */
+    int size;                   /* number of bytes per pixel */
+    int level_nlines[COG_MAX_LEVELS+1];  /* number of lines of each level */
+    int level_nsamps[COG_MAX_LEVELS+1];  /* number of samples of each level */
+    unsigned char *level_buf[COG_MAX_LEVELS+1];  /* pixels of each overview */
+    unsigned char *rows = NULL; /* lines of a row of full resolution tiles */
+    unsigned char *src = NULL;  /* current line of the block */
+    Espa_band_meta_t *bmeta = &xml_metadata->band[band];  /* band metadata */
+    Espa_band_stack_t *stack = NULL;    /* band stack for reading the band */
+    Espa_band_block_t *block = NULL;    /* current block of lines */
+    Cog_writer_t writer;        /* tile buffers and COG file */
+    int ntiles;                 /* number of tiles across the band */
+
+    memset (&writer, 0, sizeof (writer));
+    memset (level_buf, 0, sizeof (level_buf));
+    size = espa_data_type_size (bmeta->data_type);
+    if (size <= 0)
+    {
+        sprintf (errmsg, "Unsupported data type %d", bmeta->data_type);
+        error_handler (true, FUNC_NAME, errmsg);
+        return ERROR;
+    }
+
+    /* Add overviews until the smallest fits in a tile */
+    level_nlines[0] = bmeta->nlines;
+    level_nsamps[0] = bmeta->nsamps;
+    while (nlevels < COG_MAX_LEVELS &&
+        (level_nlines[nlevels] > COG_TILE_SIZE ||
+         level_nsamps[nlevels] > COG_TILE_SIZE))
+    {
+        level_nlines[nlevels+1] = (level_nlines[nlevels] + 1) / 2;
+        level_nsamps[nlevels+1] = (level_nsamps[nlevels] + 1) / 2;
+        nlevels++;
+    }
+
+    /* Build the overviews, reading the band for the first one */
+    for (level = 1; level <= nlevels; level++)
+    {
+        level_buf[level] = espa_trace_malloc ((size_t) level_nlines[level] *
+            level_nsamps[level] * size);
+        if (level_buf[level] == NULL)
+        {
+            sprintf (errmsg, "Allocating memory for the overviews");
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+            break;
+        }
+    }
+    if (status == SUCCESS && nlevels > 0)
+    {
+        stack = open_band_stack (xml_metadata, 1, &band,
+            RB_PREFETCH_DEFAULT_LINES, 0);
+        if (stack == NULL)
+        {
+            sprintf (errmsg, "Opening the input raw binary file: %s",
+                bmeta->file_name);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+        }
+        while (status == SUCCESS)
+        {
+            if (get_band_stack_block (stack, &block) != SUCCESS)
+            {
+                sprintf (errmsg, "Reading image data from the raw binary "
+                    "file");
+                error_handler (true, FUNC_NAME, errmsg);
+                status = ERROR;
+                break;
+            }
+            if (block == NULL)
+                break;   /* all lines have been read */
+
+            for (bl = 0; bl < block->nlines; bl++)
+            {
+                line = block->line0 + bl;
+                if (line % 2 != 0)
+                    continue;
+                decimate ((unsigned char *) block->band_buf[0] +
+                    (size_t) bl * block->line_stride * size, level_nsamps[1],
+                    size, level_buf[1] + (size_t) (line / 2) *
+                    level_nsamps[1] * size);
+            }
+        }
+        if (stack != NULL)
+            close_band_stack (stack);
+        stack = NULL;
+
+        for (level = 2; status == SUCCESS && level <= nlevels; level++)
+            for (line = 0; line < level_nlines[level]; line++)
+                decimate (level_buf[level-1] + (size_t) 2 * line *
+                    level_nsamps[level-1] * size, level_nsamps[level], size,
+                    level_buf[level] + (size_t) line * level_nsamps[level] *
+                    size);
+    }
+
+    /* Write the image file directories of all the levels, deferring the
+       tile offsets */
+    if (status == SUCCESS)
+    {
+#ifdef _OPENMP
+        #pragma omp critical (gtif_open)
+#endif
+        writer.tiff = open_tiff (cog_file, "w");
+        if (writer.tiff == NULL)
+        {
+            sprintf (errmsg, "Opening the COG file: %s", cog_file);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+        }
+    }
+    for (level = 0; status == SUCCESS && level <= nlevels; level++)
+    {
+        set_tiff_tile_tags (writer.tiff, bmeta->data_type,
+            level_nlines[level], level_nsamps[level], COG_TILE_SIZE,
+            cog_tiff_compression (compression),
+            cog_tiff_predictor (bmeta->data_type), level > 0);
+        if ((level == 0 && set_geotiff_tags (writer.tiff, bmeta,
+            &xml_metadata->global.proj_info) != SUCCESS) ||
+            ((int) bmeta->fill_value != (int) ESPA_INT_META_FILL &&
+            set_tiff_nodata (writer.tiff, bmeta->fill_value) != SUCCESS) ||
+            !TIFFDeferStrileArrayWriting (writer.tiff) ||
+            !TIFFWriteCheck (writer.tiff, 1, FUNC_NAME) ||
+            !TIFFWriteDirectory (writer.tiff))
+        {
+            sprintf (errmsg, "Writing the image file directory of level %d "
+                "to the COG file: %s", level, cog_file);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+        }
+    }
+
+    /* Allocate the tile buffers for the widest row of tiles */
+    if (status == SUCCESS)
+    {
+        ntiles = (bmeta->nsamps + COG_TILE_SIZE - 1) / COG_TILE_SIZE;
+        writer.compression = compression;
+        writer.data_type = bmeta->data_type;
+        writer.size = size;
+        writer.tile_bytes = (size_t) COG_TILE_SIZE * COG_TILE_SIZE * size;
+        writer.out_bytes = compress_bound (compression, writer.tile_bytes);
+        writer.tile_buf = espa_trace_malloc (ntiles * writer.tile_bytes);
+        writer.out_buf = espa_trace_malloc (ntiles * writer.out_bytes);
+        writer.out_len = malloc (ntiles * sizeof (size_t));
+        rows = espa_trace_malloc ((size_t) COG_TILE_SIZE * bmeta->nsamps *
+            size);
+        if (writer.tile_buf == NULL || writer.out_buf == NULL ||
+            writer.out_len == NULL || rows == NULL)
+        {
+            sprintf (errmsg, "Allocating memory for the COG tiles");
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+        }
+    }
+
+    /* Write the overview tiles, smallest first */
+    for (level = nlevels; status == SUCCESS && level > 0; level--)
+    {
+        if (!TIFFSetDirectory (writer.tiff, level) ||
+            write_level_tiles (&writer, level_buf[level], level_nlines[level],
+                level_nsamps[level]) != SUCCESS ||
+            !TIFFForceStrileArrayWriting (writer.tiff))
+        {
+            sprintf (errmsg, "Writing the tiles of level %d to the COG "
+                "file: %s", level, cog_file);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+        }
+    }
+
+    /* Write the full resolution tiles, reading the band a row of tiles at a
+       time */
+    if (status == SUCCESS)
+    {
+        if (!TIFFSetDirectory (writer.tiff, 0))
+        {
+            sprintf (errmsg, "Setting the full resolution image of the COG "
+                "file: %s", cog_file);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+        }
+        else
+        {
+            stack = open_band_stack (xml_metadata, 1, &band, COG_TILE_SIZE,
+                0);
+            if (stack == NULL)
+            {
+                sprintf (errmsg, "Opening the input raw binary file: %s",
+                    bmeta->file_name);
+                error_handler (true, FUNC_NAME, errmsg);
+                status = ERROR;
+            }
+        }
+    }
+    while (status == SUCCESS)
+    {
+        if (get_band_stack_block (stack, &block) != SUCCESS)
+        {
+            sprintf (errmsg, "Reading image data from the raw binary file");
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+            break;
+        }
+        if (block == NULL)
+            break;   /* all lines have been written */
+
+        for (bl = 0; status == SUCCESS && bl < block->nlines; bl++)
+        {
+            line = block->line0 + bl;
+            src = (unsigned char *) block->band_buf[0] +
+                (size_t) bl * block->line_stride * size;
+            memcpy (rows + (size_t) (line % COG_TILE_SIZE) * bmeta->nsamps *
+                size, src, (size_t) bmeta->nsamps * size);
+            if ((line + 1) % COG_TILE_SIZE == 0 || line + 1 == bmeta->nlines)
+            {
+                if (write_tile_row (&writer, rows, line % COG_TILE_SIZE + 1,
+                    bmeta->nsamps, line / COG_TILE_SIZE) != SUCCESS)
+                {
+                    sprintf (errmsg, "Writing the full resolution tiles to "
+                        "the COG file: %s", cog_file);
+                    error_handler (true, FUNC_NAME, errmsg);
+                    status = ERROR;
+                }
+            }
+        }
+    }
+    if (status == SUCCESS && !TIFFForceStrileArrayWriting (writer.tiff))
+    {
+        sprintf (errmsg, "Writing the tile offsets to the COG file: %s",
+            cog_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        status = ERROR;
+    }
+
+    if (stack != NULL)
+        close_band_stack (stack);
+    if (writer.tiff != NULL)
+        close_tiff (writer.tiff);
+    for (level = 1; level <= nlevels; level++)
+        espa_trace_free (level_buf[level]);
+    espa_trace_free (writer.tile_buf);
+    espa_trace_free (writer.out_buf);
+    free (writer.out_len);
+    espa_trace_free (rows);
+
+    return status;
+#else
+    sprintf (errmsg, "Writing %s requires libtiff 4.1 or newer", cog_file);
+    error_handler (true, FUNC_NAME, errmsg);
+    return ERROR;
+#endif
+}
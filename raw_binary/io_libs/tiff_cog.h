@@ -0,0 +1,59 @@
+/*****************************************************************************
+FILE: tiff_cog.h
+
+PURPOSE: Contains defines and prototypes for writing Cloud-Optimized GeoTIFF
+(COG) bands.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. A COG is tiled, optionally compressed, and carries internal overviews.
+     All the image file directories come first in the file, followed by the
+     tiles of the smallest overview through to the tiles of the full
+     resolution image, so a reader needs only a few range requests.
+  2. Writing a COG requires libtiff 4.1 or newer.
+*****************************************************************************/
+
+#ifndef TIFF_COG_H
+#define TIFF_COG_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "error_handler.h"
+#include "espa_metadata.h"
+#include "espa_band_stack.h"
+#include "tiff_io.h"
+
+/* Defines */
+#define COG_TILE_SIZE 512    /* number of lines and samples in a tile */
+#define COG_MAX_LEVELS 32    /* maximum number of overview levels */
+
+/* Compression of the COG tiles */
+typedef enum {
+    COG_COMPRESS_NONE,
+    COG_COMPRESS_DEFLATE,
+    COG_COMPRESS_LZW,
+    COG_COMPRESS_ZSTD        /* requires building with ENABLE_ZSTD */
+} Cog_compression_t;
+
+/* Prototypes */
+int parse_cog_compression
+(
+    char *name,                      /* I: name of the compression (none,
+                                           deflate, lzw, or zstd) */
+    Cog_compression_t *compression   /* O: compression of the COG tiles */
+);
+
+int write_cog_band
+(
+    char *cog_file,                     /* I: name of the COG file */
+    Espa_internal_meta_t *xml_metadata, /* I: XML metadata structure */
+    int band,                           /* I: index of the band */
+    Cog_compression_t compression       /* I: compression of the tiles */
+);
+
+#endif
@@ -0,0 +1,528 @@
+/*****************************************************************************
+FILE: tiff_decode.c
+
+PURPOSE: Contains functions for decoding the compressed tiles of a Tiff
+image across the threads.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. See tiff_decode.h.  The tiles covering a block of lines are read raw
+     with TIFFReadRawTile, then each tile is decoded into a buffer of its
+     worker and its lines of the block are copied into place, so the tiles
+     are decoded in any order and the lines come out whole.
+  2. A tile with no bytes (a sparse tile) is read as zeros.
+  3. It's assumed we are running on Linux, thus the pixels are little
+     endian.  The samples of a file in the other byte order are swapped
+     before the horizontal differencing is reversed, as libtiff does.
+*****************************************************************************/
+#include <stdint.h>
+#include <zlib.h>
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+#include "tiff_decode.h"
+#include "espa_trace.h"
+#include "espa_task_pool.h"
+
+/* The tile byte counts can be read one at a time since libtiff 4.1 */
+#if defined (TIFFLIB_VERSION) && TIFFLIB_VERSION >= 20191103
+#define TIFF_DECODE_SUPPORTED
+#endif
+
+/* Tiles of a block of lines being decoded, shared by the iterations of the
+   loop over the tiles */
+typedef struct
+{
+    const Tiff_layout_t *layout; /* size and storage layout of the image */
+    int compression;         /* Tiff compression scheme (COMPRESSION_*) */
+    int predictor;           /* Tiff predictor (PREDICTOR_*) */
+    bool swab;               /* are the samples in the other byte order? */
+    int line0;               /* 0-based first line of the block */
+    int nlines;              /* number of lines in the block */
+    int row0;                /* 0-based first row of tiles of the block */
+    int ntiles_across;       /* number of tiles across the image */
+    size_t tile_bytes;       /* number of bytes in a decoded tile */
+    const unsigned char *raw;    /* compressed tiles of the block */
+    const size_t *raw_offset;    /* offset of each tile in raw */
+    const size_t *raw_bytes;     /* number of bytes of each compressed
+                                    tile */
+    unsigned char *tile_buf; /* decoded tile of each worker */
+    unsigned char *line_buf; /* line of each worker, for the floating point
+                                predictor */
+    unsigned char *img_buf;  /* lines of the block */
+    int *status;             /* status of decoding each tile */
+} Tiff_tile_decoder_t;
+
+
+/******************************************************************************
+MODULE: tiff_tiles_decodable
+
+PURPOSE: Finds out if the tiles of the Tiff image can be decoded here
+
+RETURN VALUE:
+Type = bool
+Value        Description
+-----        -----------
+false        The image needs to be read through libtiff
+true         The tiles can be decoded with read_tiff_tiles
+
+NOTES:
+  1. Uncompressed tiles are left to libtiff, since there is nothing to
+     decode.
+*****************************************************************************/
+bool tiff_tiles_decodable
+(
+    TIFF *tiff,              /* I: pointer to the Tiff file */
+    const Tiff_layout_t *layout  /* I: size and storage layout of the image
+                                       (see get_tiff_layout) */
+)
+{
+#ifdef TIFF_DECODE_SUPPORTED
+    uint16_t compression = 0;  /* compression scheme of the image */
+    uint16_t predictor = 0;    /* predictor of the image */
+    uint16_t planar = 0;       /* planar configuration of the image */
+
+    if (!layout->tiled)
+        return false;
+    if (!TIFFGetFieldDefaulted (tiff, TIFFTAG_PLANARCONFIG, &planar) ||
+        planar != PLANARCONFIG_CONTIG)
+        return false;
+
+    if (!TIFFGetFieldDefaulted (tiff, TIFFTAG_COMPRESSION, &compression))
+        return false;
+    if (compression != COMPRESSION_ADOBE_DEFLATE &&
+        compression != COMPRESSION_DEFLATE
+#ifdef HAVE_ZSTD
+        && compression != COMPRESSION_ZSTD
+#endif
+        )
+        return false;
+
+    if (!TIFFGetFieldDefaulted (tiff, TIFFTAG_PREDICTOR, &predictor))
+        predictor = PREDICTOR_NONE;
+    switch (predictor)
+    {
+        case PREDICTOR_NONE:
+            return layout->size == 1 || layout->size == 2 ||
+                layout->size == 4 || layout->size == 8;
+        case PREDICTOR_HORIZONTAL:
+            return layout->size == 1 || layout->size == 2 ||
+                layout->size == 4;
+        case PREDICTOR_FLOATINGPOINT:
+            return true;
+        default:
+            return false;
+    }
+#else
+    return false;
+#endif
+}
+
+
+/******************************************************************************
+MODULE: decompress_tile
+
+PURPOSE: Decompresses a tile
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        The tile couldn't be decompressed to a whole tile
+SUCCESS      Successfully decompressed the tile
+
+NOTES:
+  1. As with libtiff, anything the compressed tile holds past a whole tile
+     is ignored.
+*****************************************************************************/
+static int decompress_tile
+(
+    int compression,             /* I: Tiff compression scheme */
+    const unsigned char *raw,    /* I: compressed tile */
+    size_t raw_bytes,            /* I: number of bytes of the compressed
+                                       tile */
+    unsigned char *tile,         /* O: decompressed tile */
+    size_t tile_bytes            /* I: number of bytes of a tile */
+)
+{
+    uLongf out_len = tile_bytes; /* number of bytes of deflate output */
+    int status;                  /* status of the deflate decompression */
+#ifdef HAVE_ZSTD
+    size_t zstd_len;             /* number of bytes of ZSTD output */
+#endif
+
+    if (raw_bytes == 0)
+    {  /* Sparse tile */
+        memset (tile, 0, tile_bytes);
+        return SUCCESS;
+    }
+
+    switch (compression)
+    {
+        case COMPRESSION_ADOBE_DEFLATE:
+        case COMPRESSION_DEFLATE:
+            status = uncompress (tile, &out_len, raw, raw_bytes);
+            if ((status != Z_OK && status != Z_BUF_ERROR) ||
+                out_len != tile_bytes)
+                return ERROR;
+            return SUCCESS;
+
+#ifdef HAVE_ZSTD
+        case COMPRESSION_ZSTD:
+            zstd_len = ZSTD_decompress (tile, tile_bytes, raw, raw_bytes);
+            if (ZSTD_isError (zstd_len) || zstd_len != tile_bytes)
+                return ERROR;
+            return SUCCESS;
+#endif
+
+        default:
+            return ERROR;
+    }
+}
+
+
+/******************************************************************************
+MODULE: unpredict_tile
+
+PURPOSE: Reverses the Tiff predictor of each line of a decompressed tile,
+and puts the samples in the byte order of this machine
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. Reverses predict_tile of tiff_cog.c: horizontal differencing is undone
+     by summing each sample with the previous one, and the floating point
+     predictor by summing the bytes and then merging the byte planes, most
+     significant byte first, back into samples.
+*****************************************************************************/
+static void unpredict_tile
+(
+    unsigned char *tile,     /* I/O: decompressed tile */
+    int tile_lines,          /* I: number of lines in the tile */
+    int tile_samps,          /* I: number of samples in the tile */
+    int size,                /* I: number of bytes per sample */
+    int predictor,           /* I: Tiff predictor (PREDICTOR_*) */
+    bool swab,               /* I: are the samples in the other byte
+                                   order? */
+    unsigned char *line_buf  /* I: buffer of a line, for the floating point
+                                   predictor */
+)
+{
+    int line;                /* looping variable for the lines */
+    int samp;                /* looping variable for the samples */
+    int byte;                /* looping variable for the bytes */
+    size_t line_bytes = (size_t) tile_samps * size;  /* bytes per line */
+    size_t i;                /* looping variable for the bytes of a line */
+    unsigned char *cp = NULL;    /* current line */
+
+    for (line = 0; line < tile_lines; line++)
+    {
+        cp = tile + line * line_bytes;
+
+        if (predictor == PREDICTOR_FLOATINGPOINT)
+        {
+            for (i = 1; i < line_bytes; i++)
+                cp[i] += cp[i-1];
+            memcpy (line_buf, cp, line_bytes);
+            for (samp = 0; samp < tile_samps; samp++)
+                for (byte = 0; byte < size; byte++)
+                    cp[(size_t) size * samp + byte] =
+                        line_buf[(size_t) (size - byte - 1) * tile_samps +
+                        samp];
+            continue;
+        }
+
+        if (swab)
+        {
+            switch (size)
+            {
+                case 2: TIFFSwabArrayOfShort ((uint16_t *) cp, tile_samps);
+                    break;
+                case 4: TIFFSwabArrayOfLong ((uint32_t *) cp, tile_samps);
+                    break;
+                case 8: TIFFSwabArrayOfLong8 ((uint64_t *) cp, tile_samps);
+                    break;
+            }
+        }
+        if (predictor != PREDICTOR_HORIZONTAL)
+            continue;
+
+        switch (size)
+        {
+            case 1:
+            {
+                uint8_t *p = (uint8_t *) cp;
+                for (samp = 1; samp < tile_samps; samp++)
+                    p[samp] += p[samp-1];
+                break;
+            }
+            case 2:
+            {
+                uint16_t *p = (uint16_t *) cp;
+                for (samp = 1; samp < tile_samps; samp++)
+                    p[samp] += p[samp-1];
+                break;
+            }
+            case 4:
+            {
+                uint32_t *p = (uint32_t *) cp;
+                for (samp = 1; samp < tile_samps; samp++)
+                    p[samp] += p[samp-1];
+                break;
+            }
+        }
+    }
+}
+
+
+/******************************************************************************
+MODULE: decode_block_tile
+
+PURPOSE: Decodes a tile of the block and copies its lines of the block into
+place, as an iteration of the loop over the tiles
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+SUCCESS      Always; the status of the tile is ERROR if it couldn't be
+             decoded, which read_tiff_tiles reports
+
+NOTES:
+  1. Each worker has its own tile buffer, and the tiles copy to separate
+     parts of the lines, so the tiles are decoded at the same time.
+*****************************************************************************/
+static int decode_block_tile
+(
+    void *arg,               /* I/O: tiles of the block being decoded */
+    int tile,                /* I: 0-based tile of the block */
+    int worker               /* I: index of the worker */
+)
+{
+    Tiff_tile_decoder_t *dec = arg;      /* tiles being decoded */
+    const Tiff_layout_t *layout = dec->layout;  /* layout of the image */
+    int size = layout->size; /* number of bytes per sample */
+    int tile_line;           /* 0-based first image line of the tile */
+    int samp0;               /* 0-based first image sample of the tile */
+    int width;               /* number of image samples in the tile */
+    int first;               /* first line of the tile to copy */
+    int last;                /* last line of the tile to copy, plus one */
+    int bl;                  /* looping variable for the lines */
+    size_t line_bytes;       /* number of bytes per image line */
+    unsigned char *tile_buf; /* decoded tile */
+
+    tile_line = (dec->row0 + tile / dec->ntiles_across) * layout->block_lines;
+    samp0 = tile % dec->ntiles_across * layout->tile_samps;
+    tile_buf = dec->tile_buf + worker * dec->tile_bytes;
+
+    dec->status[tile] = decompress_tile (dec->compression,
+        dec->raw + dec->raw_offset[tile], dec->raw_bytes[tile], tile_buf,
+        dec->tile_bytes);
+    if (dec->status[tile] != SUCCESS)
+        return SUCCESS;
+    unpredict_tile (tile_buf, layout->block_lines, layout->tile_samps, size,
+        dec->predictor, dec->swab, dec->line_buf == NULL ? NULL :
+        dec->line_buf + (size_t) worker * layout->tile_samps * size);
+
+    /* Copy the lines of the tile within the block and the image */
+    width = layout->nsamps - samp0;
+    if (width > layout->tile_samps)
+        width = layout->tile_samps;
+    first = (tile_line < dec->line0) ? dec->line0 - tile_line : 0;
+    last = dec->line0 + dec->nlines - tile_line;
+    if (last > layout->block_lines)
+        last = layout->block_lines;
+    line_bytes = (size_t) layout->nsamps * size;
+    for (bl = first; bl < last; bl++)
+        memcpy (dec->img_buf + (size_t) (tile_line + bl - dec->line0) *
+            line_bytes + (size_t) samp0 * size, tile_buf + (size_t) bl *
+            layout->tile_samps * size, (size_t) width * size);
+
+    return SUCCESS;
+}
+
+
+/******************************************************************************
+MODULE: read_tiff_tiles
+
+PURPOSE: Reads nlines of data from the tiled Tiff file, starting at line
+line0, decoding the tiles across the threads
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        An error occurred reading or decoding the tiles
+SUCCESS      Reading was successful
+
+NOTES:
+  1. The image must be decodable (see tiff_tiles_decodable).  The rows of
+     tiles covering the lines are all decoded at once, so blocks should be
+     a multiple of the tile height (see open_tiff_block_reader).
+*****************************************************************************/
+int read_tiff_tiles
+(
+    TIFF *tiff,              /* I: pointer to the Tiff file */
+    const Tiff_layout_t *layout, /* I: size and storage layout of the image */
+    int line0,               /* I: 0-based line of the file for the first
+                                   line */
+    int nlines,              /* I: number of lines to read from the file */
+    void *img_buf            /* O: array of nlines * nsamps * size of the
+                                   full width lines */
+)
+{
+    char FUNC_NAME[] = "read_tiff_tiles"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+#ifdef TIFF_DECODE_SUPPORTED
+    uint16_t compression = 0;    /* compression scheme of the image */
+    uint16_t predictor = 0;      /* predictor of the image */
+    int nrows;               /* number of rows of tiles in the block */
+    int ntiles;              /* number of tiles in the block */
+    int nworkers;            /* number of workers decoding the tiles */
+    int tile;                /* looping variable for the tiles */
+    uint32_t tile_num;       /* number of the tile in the file */
+    size_t raw_total = 0;    /* number of bytes of the compressed tiles */
+    size_t *raw_offset = NULL;   /* offset of each tile in raw */
+    size_t *raw_bytes = NULL;    /* number of bytes of each compressed tile */
+    unsigned char *raw = NULL;   /* compressed tiles of the block */
+    int *tile_status = NULL;     /* status of decoding each tile */
+    double start_time;       /* start of the read for the I/O accounting */
+    int status = SUCCESS;    /* return status */
+    Tiff_tile_decoder_t dec; /* tiles being decoded */
+
+    if (nlines <= 0)
+        return SUCCESS;
+
+    TIFFGetFieldDefaulted (tiff, TIFFTAG_COMPRESSION, &compression);
+    if (!TIFFGetFieldDefaulted (tiff, TIFFTAG_PREDICTOR, &predictor))
+        predictor = PREDICTOR_NONE;
+
+    memset (&dec, 0, sizeof (dec));
+    dec.layout = layout;
+    dec.compression = compression;
+    dec.predictor = predictor;
+    dec.swab = layout->size > 1 && TIFFIsByteSwapped (tiff);
+    dec.line0 = line0;
+    dec.nlines = nlines;
+    dec.row0 = line0 / layout->block_lines;
+    dec.ntiles_across = (layout->nsamps + layout->tile_samps - 1) /
+        layout->tile_samps;
+    dec.tile_bytes = (size_t) layout->block_lines * layout->tile_samps *
+        layout->size;
+    dec.img_buf = img_buf;
+    nrows = (line0 + nlines - 1) / layout->block_lines - dec.row0 + 1;
+    ntiles = nrows * dec.ntiles_across;
+
+    /* Find the compressed tiles of the block in the file */
+    raw_offset = malloc (ntiles * sizeof (size_t));
+    raw_bytes = malloc (ntiles * sizeof (size_t));
+    tile_status = malloc (ntiles * sizeof (int));
+    if (raw_offset == NULL || raw_bytes == NULL || tile_status == NULL)
+    {
+        sprintf (errmsg, "Allocating memory for the Tiff tile list");
+        error_handler (true, FUNC_NAME, errmsg);
+        free (raw_offset);
+        free (raw_bytes);
+        free (tile_status);
+        return ERROR;
+    }
+    for (tile = 0; tile < ntiles; tile++)
+    {
+        tile_num = TIFFComputeTile (tiff, tile % dec.ntiles_across *
+            layout->tile_samps, (dec.row0 + tile / dec.ntiles_across) *
+            layout->block_lines, 0, 0);
+        raw_offset[tile] = raw_total;
+        raw_bytes[tile] = TIFFGetStrileByteCount (tiff, tile_num);
+        raw_total += raw_bytes[tile];
+    }
+
+    /* Read the compressed tiles in order, as the file can only be read by
+       one thread */
+    raw = espa_trace_malloc (raw_total > 0 ? raw_total : 1);
+    if (raw == NULL)
+    {
+        sprintf (errmsg, "Allocating memory for the compressed Tiff tiles");
+        error_handler (true, FUNC_NAME, errmsg);
+        free (raw_offset);
+        free (raw_bytes);
+        free (tile_status);
+        return ERROR;
+    }
+    start_time = espa_io_stats_clock ();
+    for (tile = 0; tile < ntiles && status == SUCCESS; tile++)
+    {
+        if (raw_bytes[tile] == 0)
+            continue;
+        tile_num = TIFFComputeTile (tiff, tile % dec.ntiles_across *
+            layout->tile_samps, (dec.row0 + tile / dec.ntiles_across) *
+            layout->block_lines, 0, 0);
+        if (TIFFReadRawTile (tiff, tile_num, raw + raw_offset[tile],
+            (tmsize_t) raw_bytes[tile]) != (tmsize_t) raw_bytes[tile])
+        {
+            sprintf (errmsg, "Reading tile %u from the Tiff file", tile_num);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+        }
+    }
+    espa_io_stats_record (tiff, ESPA_IO_READ, raw_total, start_time);
+    if (status != SUCCESS)
+    {
+        espa_trace_free (raw);
+        free (raw_offset);
+        free (raw_bytes);
+        free (tile_status);
+        return ERROR;
+    }
+
+    /* Decode the tiles on the task pool, with a tile buffer (and line
+       buffer) for each worker */
+    nworkers = espa_parallel_for_workers (ntiles, 0);
+    dec.raw = raw;
+    dec.raw_offset = raw_offset;
+    dec.raw_bytes = raw_bytes;
+    dec.status = tile_status;
+    dec.tile_buf = espa_trace_malloc (nworkers * dec.tile_bytes);
+    if (predictor == PREDICTOR_FLOATINGPOINT)
+        dec.line_buf = malloc ((size_t) nworkers * layout->tile_samps *
+            layout->size);
+    if (dec.tile_buf == NULL || (predictor == PREDICTOR_FLOATINGPOINT &&
+        dec.line_buf == NULL))
+    {
+        sprintf (errmsg, "Allocating memory for decoding the Tiff tiles");
+        error_handler (true, FUNC_NAME, errmsg);
+        status = ERROR;
+    }
+    else
+        espa_parallel_for (ntiles, 0, decode_block_tile, &dec);
+
+    /* Report the first tile which couldn't be decoded */
+    for (tile = 0; tile < ntiles && status == SUCCESS; tile++)
+    {
+        if (tile_status[tile] != SUCCESS)
+        {
+            sprintf (errmsg, "Decompressing tile %d of tile row %d from the "
+                "Tiff file", tile % dec.ntiles_across,
+                dec.row0 + tile / dec.ntiles_across);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+        }
+    }
+
+    espa_trace_free (dec.tile_buf);
+    free (dec.line_buf);
+    espa_trace_free (raw);
+    free (raw_offset);
+    free (raw_bytes);
+    free (tile_status);
+    return status;
+#else
+    sprintf (errmsg, "Decoding the Tiff tiles requires libtiff 4.1 or newer");
+    error_handler (true, FUNC_NAME, errmsg);
+    return ERROR;
+#endif
+}
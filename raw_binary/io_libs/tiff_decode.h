@@ -0,0 +1,54 @@
+/*****************************************************************************
+FILE: tiff_decode.h
+
+PURPOSE: Contains prototypes for decoding the compressed tiles of a Tiff
+image across the threads, such as the tiles of the Landsat Collection 2
+Cloud-Optimized GeoTIFFs.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The compressed tiles are read from the file in order, since a Tiff file
+     can only be read by one thread at a time, and are then decompressed,
+     reversed through the predictor, and copied into the lines on the task
+     pool (see espa_task_pool.h).
+  2. Deflate (and ZSTD, when built with HAVE_ZSTD) tiles are decoded, with
+     no predictor, horizontal differencing, or the floating point
+     predictor.  Other images are read through libtiff (see read_tiff_lines).
+  3. Decoding the tiles here requires libtiff 4.1 or newer, for the tile
+     byte counts.
+*****************************************************************************/
+
+#ifndef TIFF_DECODE_H
+#define TIFF_DECODE_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include "error_handler.h"
+#include "tiff_io.h"
+
+/* Prototypes */
+bool tiff_tiles_decodable
+(
+    TIFF *tiff,              /* I: pointer to the Tiff file */
+    const Tiff_layout_t *layout  /* I: size and storage layout of the image
+                                       (see get_tiff_layout) */
+);
+
+int read_tiff_tiles
+(
+    TIFF *tiff,              /* I: pointer to the Tiff file */
+    const Tiff_layout_t *layout, /* I: size and storage layout of the image */
+    int line0,               /* I: 0-based line of the file for the first
+                                   line */
+    int nlines,              /* I: number of lines to read from the file */
+    void *img_buf            /* O: array of nlines * nsamps * size of the
+                                   full width lines */
+);
+
+#endif
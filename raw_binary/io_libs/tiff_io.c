@@ -2,7 +2,9 @@
 FILE: tiff_io.c
   
 PURPOSE: Contains functions for opening/closing Tiff files as well as
-reading/writing to Tiff files N lines at a time.
+reading/writing to Tiff files N lines at a time.  The lines are read and
+written a whole strip or tile at a time, so striped and tiled (and
+compressed) Tiff files are supported.
 
 PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
 at the USGS EROS
@@ -12,7 +14,19 @@ LICENSE TYPE:  NASA Open Source Agreement Version 1.3
 NOTES:
 *****************************************************************************/
 
+#include <fcntl.h>
+#include "espa_band_stack.h"
 #include "tiff_io.h"
+#include "espa_remote.h"
+#include "espa_trace.h"
+#include "raw_binary_advise.h"
+#include "tiff_decode.h"
+
+/* The strile offsets and byte counts can be read one at a time since libtiff
+   4.1 */
+#if defined (TIFFLIB_VERSION) && TIFFLIB_VERSION >= 20191103
+#define TIFF_STRILE_SUPPORTED
+#endif
 
 /* define the read/write formats to be used for opening a file */
 /* TIFF_READ_FORMAT, TIFF_WRITE_FORMAT, TIFF_READ_WRITE_FORMAT */
@@ -519,37 +533,23 @@ int set_geotiff_tags
 
 
 /******************************************************************************
-MODULE: set_tiff_tags
+MODULE: set_tiff_sample_format
 
-PURPOSE: Sets the Tiff tags for the current Tiff pointer
+PURPOSE: Sets the Tiff tags for the bits per sample and the sample format of
+the data type
 
 RETURN VALUE:
 Type = N/A
 
 NOTES:
 *****************************************************************************/
-void set_tiff_tags
+static void set_tiff_sample_format
 (
     TIFF *tiff,      /* I: pointer to Tiff file */
-    int data_type,   /* I: data type of this band (see ESPA_* in
+    int data_type    /* I: data type of this band (see ESPA_* in
                            espa_metadata.h) */
-    int nlines,      /* I: number of lines */
-    int nsamps       /* I: number of samples */
 )
 {
-    int samps_per_pixel = 1;    /* number of samples per pixel */
-    int rows_per_strip = 1;     /* number of rows written to a strip */
-
-    /* Set the Tiff tags based on the input and some known defaults */
-    TIFFSetField (tiff, TIFFTAG_SOFTWARE, "ESPA");
-    TIFFSetField (tiff, TIFFTAG_IMAGEWIDTH, nsamps);
-    TIFFSetField (tiff, TIFFTAG_IMAGELENGTH, nlines);
-    TIFFSetField (tiff, TIFFTAG_COMPRESSION, COMPRESSION_NONE);
-    TIFFSetField (tiff, TIFFTAG_SAMPLESPERPIXEL, samps_per_pixel);
-    TIFFSetField (tiff, TIFFTAG_ROWSPERSTRIP,rows_per_strip);
-    TIFFSetField (tiff, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
-    TIFFSetField (tiff, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_MINISBLACK);
-
     switch (data_type)
     {
         case ESPA_INT8:
@@ -588,6 +588,334 @@ void set_tiff_tags
 }
 
 
+/******************************************************************************
+MODULE: set_tiff_tags
+
+PURPOSE: Sets the Tiff tags for the current Tiff pointer
+
+RETURN VALUE:
+Type = N/A
+
+NOTES:
+*****************************************************************************/
+void set_tiff_tags
+(
+    TIFF *tiff,      /* I: pointer to Tiff file */
+    int data_type,   /* I: data type of this band (see ESPA_* in
+                           espa_metadata.h) */
+    int nlines,      /* I: number of lines */
+    int nsamps       /* I: number of samples */
+)
+{
+    /* One uncompressed line per strip */
+    set_tiff_strip_tags (tiff, data_type, nlines, nsamps, 1,
+        COMPRESSION_NONE, PREDICTOR_NONE);
+}
+
+
+/******************************************************************************
+MODULE: set_tiff_strip_tags
+
+PURPOSE: Sets the Tiff tags for an image stored as strips of several lines,
+optionally compressed
+
+RETURN VALUE:
+Type = N/A
+
+NOTES:
+  1. The predictor is only set for compressed images.
+  2. Strips of several lines let the lines be written and read a strip at a
+     time rather than a line at a time.
+*****************************************************************************/
+void set_tiff_strip_tags
+(
+    TIFF *tiff,      /* I: pointer to Tiff file */
+    int data_type,   /* I: data type of this band (see ESPA_* in
+                           espa_metadata.h) */
+    int nlines,      /* I: number of lines */
+    int nsamps,      /* I: number of samples */
+    int rows_per_strip, /* I: number of lines in a strip */
+    int compression, /* I: Tiff compression scheme (COMPRESSION_*) */
+    int predictor    /* I: Tiff predictor (PREDICTOR_*) */
+)
+{
+    TIFFSetField (tiff, TIFFTAG_SOFTWARE, "ESPA");
+    TIFFSetField (tiff, TIFFTAG_IMAGEWIDTH, nsamps);
+    TIFFSetField (tiff, TIFFTAG_IMAGELENGTH, nlines);
+    TIFFSetField (tiff, TIFFTAG_COMPRESSION, compression);
+    if (compression != COMPRESSION_NONE)
+        TIFFSetField (tiff, TIFFTAG_PREDICTOR, predictor);
+    TIFFSetField (tiff, TIFFTAG_SAMPLESPERPIXEL, 1);
+    TIFFSetField (tiff, TIFFTAG_ROWSPERSTRIP, rows_per_strip);
+    TIFFSetField (tiff, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
+    TIFFSetField (tiff, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_MINISBLACK);
+    set_tiff_sample_format (tiff, data_type);
+}
+
+
+/******************************************************************************
+MODULE: set_tiff_tile_tags
+
+PURPOSE: Sets the Tiff tags for a tiled, optionally compressed, image
+
+RETURN VALUE:
+Type = N/A
+
+NOTES:
+  1. The predictor is only set for compressed images.
+*****************************************************************************/
+void set_tiff_tile_tags
+(
+    TIFF *tiff,      /* I: pointer to Tiff file */
+    int data_type,   /* I: data type of this band (see ESPA_* in
+                           espa_metadata.h) */
+    int nlines,      /* I: number of lines */
+    int nsamps,      /* I: number of samples */
+    int tile_size,   /* I: number of lines and samples in a tile; a multiple
+                           of 16 */
+    int compression, /* I: Tiff compression scheme (COMPRESSION_*) */
+    int predictor,   /* I: Tiff predictor (PREDICTOR_*) */
+    bool reduced     /* I: is this a reduced resolution (overview) image? */
+)
+{
+    TIFFSetField (tiff, TIFFTAG_SOFTWARE, "ESPA");
+    if (reduced)
+        TIFFSetField (tiff, TIFFTAG_SUBFILETYPE, FILETYPE_REDUCEDIMAGE);
+    TIFFSetField (tiff, TIFFTAG_IMAGEWIDTH, nsamps);
+    TIFFSetField (tiff, TIFFTAG_IMAGELENGTH, nlines);
+    TIFFSetField (tiff, TIFFTAG_TILEWIDTH, tile_size);
+    TIFFSetField (tiff, TIFFTAG_TILELENGTH, tile_size);
+    TIFFSetField (tiff, TIFFTAG_COMPRESSION, compression);
+    if (compression != COMPRESSION_NONE)
+        TIFFSetField (tiff, TIFFTAG_PREDICTOR, predictor);
+    TIFFSetField (tiff, TIFFTAG_SAMPLESPERPIXEL, 1);
+    TIFFSetField (tiff, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
+    TIFFSetField (tiff, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_MINISBLACK);
+    set_tiff_sample_format (tiff, data_type);
+}
+
+
+/******************************************************************************
+MODULE: set_tiff_nodata
+
+PURPOSE: Sets the GDAL nodata tag for the current Tiff pointer
+
+RETURN VALUE:
+Type = int
+ERROR        An error occurred setting the nodata tag
+SUCCESS      Setting the nodata tag was successful
+
+NOTES:
+  1. The tag holds the fill value as an ASCII string, which is how GDAL
+     writes and reads it.
+*****************************************************************************/
+int set_tiff_nodata
+(
+    TIFF *tiff,         /* I: pointer to Tiff file */
+    long fill_value     /* I: fill value of the band */
+)
+{
+    char FUNC_NAME[] = "set_tiff_nodata"; /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    char nodata[STR_SIZE];      /* fill value as a string */
+
+    snprintf (nodata, sizeof (nodata), "%ld", fill_value);
+    if (TIFFSetField (tiff, TIFFTAG_GDAL_NODATA, nodata) != 1)
+    {
+        sprintf (errmsg, "Setting the nodata tag to %s", nodata);
+        error_handler (true, FUNC_NAME, errmsg);
+        return ERROR;
+    }
+
+    return SUCCESS;
+}
+
+
+/******************************************************************************
+MODULE: write_tiff_world_file
+
+PURPOSE: Writes the ESRI world file (.tfw) of a GeoTiff band
+
+RETURN VALUE:
+Type = int
+ERROR        An error occurred writing the world file
+SUCCESS      Writing the world file was successful
+
+NOTES:
+  1. The world file holds the pixel size and the projection coordinates of
+     the center of the UL pixel, in the same form as GDAL writes it.
+*****************************************************************************/
+int write_tiff_world_file
+(
+    char *tfw_file,              /* I: name of the world file */
+    Espa_band_meta_t *bmeta,     /* I: band metadata */
+    Espa_proj_meta_t *proj_info  /* I: global projection information */
+)
+{
+    char FUNC_NAME[] = "write_tiff_world_file"; /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    double ul_x, ul_y;          /* projection coords of the UL pixel center */
+    FILE *fptr = NULL;          /* world file pointer */
+
+    ul_x = proj_info->ul_corner[0];
+    ul_y = proj_info->ul_corner[1];
+    if (strcmp (proj_info->grid_origin, "CENTER"))
+    {  /* projection corners represent UL corner of the pixel */
+        ul_x += 0.5 * bmeta->pixel_size[0];
+        ul_y -= 0.5 * bmeta->pixel_size[1];
+    }
+
+    fptr = fopen (tfw_file, "w");
+    if (fptr == NULL)
+    {
+        sprintf (errmsg, "Opening the world file %s", tfw_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return ERROR;
+    }
+
+    fprintf (fptr, "%.10f\n%.10f\n%.10f\n%.10f\n%.10f\n%.10f\n",
+        bmeta->pixel_size[0], 0.0, 0.0, -bmeta->pixel_size[1], ul_x, ul_y);
+    if (fclose (fptr) != 0)
+    {
+        sprintf (errmsg, "Writing the world file %s", tfw_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return ERROR;
+    }
+
+    return SUCCESS;
+}
+
+
+/* State of a remote Tiff file */
+typedef struct
+{
+    Espa_remote_t *remote;   /* remote file, read a block at a time */
+    toff_t offset;       /* offset of the next read */
+} Tiff_remote_t;
+
+/* Procedures for libtiff to read a remote Tiff file */
+static tmsize_t tiff_remote_read (thandle_t handle, void *data, tmsize_t n)
+{
+    Tiff_remote_t *trem = (Tiff_remote_t *) handle;
+    toff_t nbytes = trem->remote->nbytes;  /* number of bytes in the file */
+
+    if (n < 0)
+        return 0;
+    if (trem->offset >= nbytes)
+        return 0;
+    if ((toff_t) n > nbytes - trem->offset)
+        n = (tmsize_t) (nbytes - trem->offset);
+    if (read_remote_file (trem->remote, trem->offset, n, data) != SUCCESS)
+        return -1;
+    trem->offset += n;
+    return n;
+}
+
+static tmsize_t tiff_remote_write (thandle_t handle, void *data, tmsize_t n)
+{
+    return 0;   /* the remote files are read only */
+}
+
+static toff_t tiff_remote_seek (thandle_t handle, toff_t offset, int whence)
+{
+    Tiff_remote_t *trem = (Tiff_remote_t *) handle;
+
+    if (whence == SEEK_CUR)
+        offset += trem->offset;
+    else if (whence == SEEK_END)
+        offset += trem->remote->nbytes;
+    trem->offset = offset;
+    return offset;
+}
+
+static int tiff_remote_close (thandle_t handle)
+{
+    close_remote_file (((Tiff_remote_t *) handle)->remote);
+    free (handle);
+    return 0;
+}
+
+static toff_t tiff_remote_size (thandle_t handle)
+{
+    return ((Tiff_remote_t *) handle)->remote->nbytes;
+}
+
+static int tiff_remote_map (thandle_t handle, void **base, toff_t *size)
+{
+    return 0;   /* the remote files are read as the strips are needed */
+}
+
+static void tiff_remote_unmap (thandle_t handle, void *base, toff_t size)
+{
+}
+
+
+/******************************************************************************
+MODULE: open_tiff_remote
+
+PURPOSE: Opens a remote Tiff file, named by a URL, for read access.
+
+RETURN VALUE:
+Type = TIFF *
+Value        Description
+-----        -----------
+NULL         Error opening the Tiff file
+non-NULL     pointer to the opened Tiff file
+
+NOTES:
+  1. Only the header, the directory, and the strips or tiles which are read
+     are downloaded; see espa_remote.h.
+*****************************************************************************/
+static TIFF *open_tiff_remote
+(
+    char *tiff_file      /* I: URL of the Tiff file */
+)
+{
+    char FUNC_NAME[] = "open_tiff_remote"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    TIFF *tiff = NULL;       /* pointer to the Tiff file */
+    Tiff_remote_t *trem = NULL;  /* state of the remote file */
+    double start_time;       /* start of the open for the I/O accounting */
+
+    start_time = espa_io_stats_clock ();
+    trem = malloc (sizeof (Tiff_remote_t));
+    if (trem == NULL)
+    {
+        sprintf (errmsg, "Allocating memory for the Tiff file %s", tiff_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return NULL;
+    }
+    trem->offset = 0;
+    trem->remote = open_remote_file (tiff_file);
+    if (trem->remote == NULL)
+    {
+        sprintf (errmsg, "Opening remote Tiff file %s", tiff_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        free (trem);
+        return NULL;
+    }
+
+    /* The close procedure closes the remote file once the Tiff file is
+       closed */
+    tiff = XTIFFClientOpen (tiff_file, "r", (thandle_t) trem,
+        tiff_remote_read, tiff_remote_write, tiff_remote_seek,
+        tiff_remote_close, tiff_remote_size, tiff_remote_map,
+        tiff_remote_unmap);
+    if (tiff == NULL)
+    {
+        sprintf (errmsg, "Opening remote Tiff file %s", tiff_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        close_remote_file (trem->remote);
+        free (trem);
+        return NULL;
+    }
+
+    espa_io_stats_open (tiff, tiff_file, ESPA_IO_TIFF, start_time);
+
+    return tiff;
+}
+
+
 /******************************************************************************
 MODULE: open_tiff
 
@@ -601,6 +929,10 @@ NULL         Error opening the specified file for read specified access
 non-NULL     FILE pointer to the opened file
 
 NOTES:
+  1. Remote Tiff files, named by http://, https://, or s3:// URLs, can be
+     opened for read access; see espa_remote.h.
+  2. Local Tiff files opened for read access are advised as read
+     sequentially (see raw_binary_advise.h).
 *****************************************************************************/
 TIFF *open_tiff
 (
@@ -613,8 +945,14 @@ TIFF *open_tiff
     char FUNC_NAME[] = "open_tiff"; /* function name */
     char errmsg[STR_SIZE];   /* error message */
     TIFF *tiff = NULL;       /* pointer to the Tiff file */
+    double start_time;       /* start of the open for the I/O accounting */
+
+    /* Remote files are read with range requests */
+    if (is_remote_file (tiff_file) && access_type[0] == 'r')
+        return open_tiff_remote (tiff_file);
 
     /* Open the file with the specified access type */
+    start_time = espa_io_stats_clock ();
     tiff = XTIFFOpen (tiff_file, access_type);
     if (tiff == NULL)
     {
@@ -624,11 +962,144 @@ TIFF *open_tiff
         return NULL;
     }
 
+    espa_io_stats_open (tiff, tiff_file, ESPA_IO_TIFF, start_time);
+    if (access_type[0] == 'r')
+        advise_raw_binary_fd (TIFFFileno (tiff), 0, 0, RB_ADVISE_SEQUENTIAL);
+
     /* Return the file pointer */
     return tiff;
 }
 
 
+/* State of a Tiff file held in memory; the bytes belong to the caller */
+typedef struct
+{
+    char *buf;           /* bytes of the Tiff file */
+    toff_t nbytes;       /* number of bytes in the Tiff file */
+    toff_t offset;       /* offset of the next read */
+} Tiff_buffer_t;
+
+/* Procedures for libtiff to read a Tiff file held in memory */
+static tmsize_t tiff_buffer_read (thandle_t handle, void *data, tmsize_t n)
+{
+    Tiff_buffer_t *tbuf = (Tiff_buffer_t *) handle;
+
+    if (n < 0)
+        return 0;
+    if (tbuf->offset >= tbuf->nbytes)
+        return 0;
+    if ((toff_t) n > tbuf->nbytes - tbuf->offset)
+        n = (tmsize_t) (tbuf->nbytes - tbuf->offset);
+    memcpy (data, tbuf->buf + tbuf->offset, n);
+    tbuf->offset += n;
+    return n;
+}
+
+static tmsize_t tiff_buffer_write (thandle_t handle, void *data, tmsize_t n)
+{
+    return 0;   /* the files in memory are read only */
+}
+
+static toff_t tiff_buffer_seek (thandle_t handle, toff_t offset, int whence)
+{
+    Tiff_buffer_t *tbuf = (Tiff_buffer_t *) handle;
+
+    if (whence == SEEK_CUR)
+        offset += tbuf->offset;
+    else if (whence == SEEK_END)
+        offset += tbuf->nbytes;
+    tbuf->offset = offset;
+    return offset;
+}
+
+static int tiff_buffer_close (thandle_t handle)
+{
+    free (handle);
+    return 0;
+}
+
+static toff_t tiff_buffer_size (thandle_t handle)
+{
+    return ((Tiff_buffer_t *) handle)->nbytes;
+}
+
+static int tiff_buffer_map (thandle_t handle, void **base, toff_t *size)
+{
+    Tiff_buffer_t *tbuf = (Tiff_buffer_t *) handle;
+
+    *base = tbuf->buf;
+    *size = tbuf->nbytes;
+    return 1;
+}
+
+static void tiff_buffer_unmap (thandle_t handle, void *base, toff_t size)
+{
+}
+
+
+/******************************************************************************
+MODULE: open_tiff_buffer
+
+PURPOSE: Opens a Tiff file held in memory for read access.
+
+RETURN VALUE:
+Type = TIFF *
+Value        Description
+-----        -----------
+NULL         Error opening the Tiff file
+non-NULL     pointer to the opened Tiff file
+
+NOTES:
+  1. The buffer is used in place (libtiff maps it rather than copying the
+     strips and tiles), so it needs to stay allocated until the Tiff file is
+     closed with close_tiff.
+  2. This reads the Tiff files streamed out of archives (such as the Landsat
+     bundles) without writing them to disk first.
+*****************************************************************************/
+TIFF *open_tiff_buffer
+(
+    char *tiff_name,     /* I: name of the Tiff file, for messages */
+    void *buf,           /* I: bytes of the Tiff file */
+    size_t nbytes        /* I: number of bytes in the Tiff file */
+)
+{
+    char FUNC_NAME[] = "open_tiff_buffer"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    TIFF *tiff = NULL;       /* pointer to the Tiff file */
+    Tiff_buffer_t *tbuf = NULL;  /* state of the file in memory */
+    double start_time;       /* start of the open for the I/O accounting */
+
+    tbuf = malloc (sizeof (Tiff_buffer_t));
+    if (tbuf == NULL)
+    {
+        sprintf (errmsg, "Allocating memory for the Tiff file %s", tiff_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return NULL;
+    }
+    tbuf->buf = buf;
+    tbuf->nbytes = nbytes;
+    tbuf->offset = 0;
+
+    /* The close procedure frees the state once the file is closed */
+    start_time = espa_io_stats_clock ();
+    tiff = XTIFFClientOpen (tiff_name, "r", (thandle_t) tbuf,
+        tiff_buffer_read, tiff_buffer_write, tiff_buffer_seek,
+        tiff_buffer_close, tiff_buffer_size, tiff_buffer_map,
+        tiff_buffer_unmap);
+    if (tiff == NULL)
+    {
+        sprintf (errmsg, "Opening Tiff file %s from memory", tiff_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        free (tbuf);
+        return NULL;
+    }
+
+    espa_io_stats_open (tiff, tiff_name, ESPA_IO_TIFF, start_time);
+
+    return tiff;
+}
+
+
 /******************************************************************************
 MODULE: close_tiff
 
@@ -638,13 +1109,241 @@ RETURN VALUE:
 Type = N/A
 
 NOTES:
+  1. A Tiff file which was written is a one-shot output (ex. a GeoTIFF
+     product), so it is dropped from the page cache once it is closed (see
+     raw_binary_advise.h).
 *****************************************************************************/
 void close_tiff
 (
     TIFF *tiff    /* I: pointer to Tiff file to be closed */
 )
 {
+    char written[STR_SIZE];  /* name of the file written; empty if it was
+                                only read */
+    double start_time;       /* start of the close for the I/O accounting */
+
+    written[0] = '\0';
+    if (TIFFGetMode (tiff) != O_RDONLY && TIFFFileno (tiff) >= 0)
+        snprintf (written, sizeof (written), "%s", TIFFFileName (tiff));
+
+    start_time = espa_io_stats_clock ();
     XTIFFClose (tiff);
+    espa_io_stats_record (tiff, ESPA_IO_CLOSE, 0, start_time);
+
+    if (written[0] != '\0')
+        release_raw_binary_file (written, true);
+}
+
+
+/******************************************************************************
+MODULE: get_tiff_layout
+
+PURPOSE: Gets the size and the storage layout (strips or tiles) of the Tiff
+image
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        The image isn't a single sample per pixel image
+SUCCESS      Successfully got the layout
+
+NOTES:
+  1. The layout of a file opened for writing is only known once its tags
+     have been set.
+*****************************************************************************/
+int get_tiff_layout
+(
+    TIFF *tiff,              /* I: pointer to the Tiff file */
+    Tiff_layout_t *layout    /* O: size and storage layout of the image */
+)
+{
+    char FUNC_NAME[] = "get_tiff_layout"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    uint32_t width = 0;      /* number of samples */
+    uint32_t length = 0;     /* number of lines */
+    uint32_t rows_per_strip = 0;  /* number of lines per strip */
+    uint32_t tile_width = 0; /* number of samples per tile */
+    uint32_t tile_length = 0;     /* number of lines per tile */
+    uint16_t bits = 0;       /* number of bits per sample */
+    uint16_t samps_per_pixel = 0; /* number of samples per pixel */
+
+    if (!TIFFGetField (tiff, TIFFTAG_IMAGEWIDTH, &width) ||
+        !TIFFGetField (tiff, TIFFTAG_IMAGELENGTH, &length) ||
+        !TIFFGetFieldDefaulted (tiff, TIFFTAG_BITSPERSAMPLE, &bits) ||
+        !TIFFGetFieldDefaulted (tiff, TIFFTAG_SAMPLESPERPIXEL,
+            &samps_per_pixel))
+    {
+        sprintf (errmsg, "Getting the size of the Tiff image");
+        error_handler (true, FUNC_NAME, errmsg);
+        return ERROR;
+    }
+    if (samps_per_pixel != 1 || bits % 8 != 0)
+    {
+        sprintf (errmsg, "Unsupported Tiff image with %d samples per pixel "
+            "of %d bits", samps_per_pixel, bits);
+        error_handler (true, FUNC_NAME, errmsg);
+        return ERROR;
+    }
+
+    layout->nlines = length;
+    layout->nsamps = width;
+    layout->size = bits / 8;
+    layout->tiled = TIFFIsTiled (tiff);
+    if (layout->tiled)
+    {
+        if (!TIFFGetField (tiff, TIFFTAG_TILEWIDTH, &tile_width) ||
+            !TIFFGetField (tiff, TIFFTAG_TILELENGTH, &tile_length) ||
+            tile_width == 0 || tile_length == 0)
+        {
+            sprintf (errmsg, "Getting the tile size of the Tiff image");
+            error_handler (true, FUNC_NAME, errmsg);
+            return ERROR;
+        }
+        layout->block_lines = tile_length;
+        layout->tile_samps = tile_width;
+    }
+    else
+    {
+        TIFFGetFieldDefaulted (tiff, TIFFTAG_ROWSPERSTRIP, &rows_per_strip);
+        if (rows_per_strip == 0 || rows_per_strip > length)
+            rows_per_strip = length;
+        layout->block_lines = rows_per_strip;
+        layout->tile_samps = width;
+    }
+
+    return SUCCESS;
+}
+
+
+/******************************************************************************
+MODULE: get_tiff_payload
+
+PURPOSE: Finds out if the pixels of the Tiff image are stored in the file
+exactly as a raw binary band, and if so where they start
+
+RETURN VALUE:
+Type = bool
+Value        Description
+-----        -----------
+false        The pixels need to be decoded (or the layout couldn't be checked)
+true         The pixels are the nlines * nsamps * size bytes at *offset
+
+NOTES:
+  1. The image needs to be uncompressed strips, in the byte order of this
+     machine (unless the pixels are single bytes), with each strip holding
+     exactly its lines and directly following the previous strip.
+  2. The strip offsets are read with the strile functions of libtiff 4.1, so
+     older versions of libtiff always decode the pixels.
+*****************************************************************************/
+bool get_tiff_payload
+(
+    TIFF *tiff,              /* I: pointer to the Tiff file */
+    Tiff_layout_t *layout,   /* I: size and storage layout of the image (see
+                                   get_tiff_layout) */
+    off_t *offset            /* O: file offset of the first pixel */
+)
+{
+#ifdef TIFF_STRILE_SUPPORTED
+    uint16_t compression = 0;  /* compression scheme of the image */
+    uint32_t strip;          /* current strip */
+    uint32_t nstrips;        /* number of strips in the image */
+    uint64_t strip_offset;   /* file offset of the current strip */
+    uint64_t strip_bytes;    /* number of bytes in the current strip */
+    uint64_t line_bytes;     /* number of bytes in a line */
+    uint64_t next_offset;    /* file offset following the previous strip */
+    int nlines;              /* number of lines in the current strip */
+
+    if (layout->tiled)
+        return false;
+    if (!TIFFGetFieldDefaulted (tiff, TIFFTAG_COMPRESSION, &compression) ||
+        compression != COMPRESSION_NONE)
+        return false;
+    if (layout->size > 1 && TIFFIsByteSwapped (tiff))
+        return false;
+
+    line_bytes = (uint64_t) layout->nsamps * layout->size;
+    nstrips = TIFFNumberOfStrips (tiff);
+    if (nstrips == 0 || (uint64_t) nstrips * layout->block_lines <
+        (uint64_t) layout->nlines)
+        return false;
+
+    next_offset = TIFFGetStrileOffset (tiff, 0);
+    for (strip = 0; strip < nstrips; strip++)
+    {
+        nlines = layout->nlines - strip * layout->block_lines;
+        if (nlines > layout->block_lines)
+            nlines = layout->block_lines;
+        strip_offset = TIFFGetStrileOffset (tiff, strip);
+        strip_bytes = TIFFGetStrileByteCount (tiff, strip);
+        if (strip_offset != next_offset || strip_bytes != nlines * line_bytes)
+            return false;
+        next_offset += strip_bytes;
+    }
+
+    *offset = (off_t) TIFFGetStrileOffset (tiff, 0);
+    return true;
+#else
+    return false;
+#endif
+}
+
+
+/******************************************************************************
+MODULE: check_tiff_lines
+
+PURPOSE: Gets the layout of the Tiff image and checks that a block of lines
+of the data type fits within the image
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        The block of lines doesn't match the image
+SUCCESS      The block of lines matches the image
+
+NOTES:
+*****************************************************************************/
+static int check_tiff_lines
+(
+    TIFF *tiff,              /* I: pointer to the Tiff file */
+    int data_type,           /* I: data type of the lines (see
+                                   Espa_data_type in espa_metadata.h) */
+    int line0,               /* I: 0-based first line of the block */
+    int nlines,              /* I: number of lines in the block */
+    int nsamps,              /* I: number of samples per line */
+    Tiff_layout_t *layout    /* O: size and storage layout of the image */
+)
+{
+    char FUNC_NAME[] = "check_tiff_lines"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    int size;                /* number of bytes per pixel */
+
+    size = espa_data_type_size (data_type);
+    if (size <= 0)
+    {
+        sprintf (errmsg, "Unsupported data type %d", data_type);
+        error_handler (true, FUNC_NAME, errmsg);
+        return ERROR;
+    }
+
+    if (get_tiff_layout (tiff, layout) != SUCCESS)
+    {  /* Error message already written */
+        return ERROR;
+    }
+
+    if (size != layout->size || nsamps != layout->nsamps || line0 < 0 ||
+        nlines < 0 || line0 + nlines > layout->nlines)
+    {
+        sprintf (errmsg, "Lines %d-%d of %d samples of %d bytes don't match "
+            "the Tiff image of %d lines of %d samples of %d bytes", line0,
+            line0 + nlines - 1, nsamps, size, layout->nlines, layout->nsamps,
+            layout->size);
+        error_handler (true, FUNC_NAME, errmsg);
+        return ERROR;
+    }
+
+    return SUCCESS;
 }
 
 
@@ -673,60 +1372,141 @@ int write_tiff
                            Tiff file */
 )
 {
-    char FUNC_NAME[] = "write_tiff"; /* function name */
+    return write_tiff_lines (tiff, data_type, 0, nlines, nsamps, img_buf);
+}
+
+
+/******************************************************************************
+MODULE: write_tiff_lines
+
+PURPOSE: Writes nlines of data to the Tiff file, starting at line line0
+ 
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        An error occurred writing data to the Tiff file
+SUCCESS      Writing was successful
+
+NOTES:
+  1. The lines are written a whole strip or tile at a time, and compressed by
+     the Tiff library if the image is compressed.  So line0 needs to be the
+     first line of a strip (or row of tiles), and the block needs to end at
+     the end of a strip (or row of tiles) or at the end of the image.  The
+     lines of a Tiff set up with set_tiff_tags can be written in any blocks.
+  2. Tiles past the right or bottom edge of the image are filled with zeros.
+*****************************************************************************/
+int write_tiff_lines
+(
+    TIFF *tiff,      /* I: pointer to the Tiff file */
+    int data_type,   /* I: data type of the array to be written (see
+                           Espa_data_type in espa_metadata.h) */
+    int line0,       /* I: 0-based line of the file for the first line */
+    int nlines,      /* I: number of lines to write to the file */
+    int nsamps,      /* I: number of samples to write to the file */
+    void *img_buf    /* I: array of nlines * nsamps * size to be written to the
+                           Tiff file */
+)
+{
+    char FUNC_NAME[] = "write_tiff_lines"; /* function name */
     char errmsg[STR_SIZE];   /* error message */
-    int line;                /* looping variable */
-    int curr_pix;            /* current pixel for start of line */
-    int8_t *int8_ptr = NULL;     /* pointer for int8 data types */
-    uint8_t *uint8_ptr = NULL;   /* pointer for uint8 data types */
-    int16_t *int16_ptr = NULL;   /* pointer for int16 data types */
-    uint16_t *uint16_ptr = NULL; /* pointer for uint16 data types */
-    int32_t *int32_ptr = NULL;   /* pointer for int32 data types */
-    uint32_t *uint32_ptr = NULL; /* pointer for uint32 data types */
-    float *float_ptr = NULL;     /* pointer for float data types */
-    double *double_ptr = NULL;   /* pointer for double data types */
-    void *void_ptr = NULL;       /* pointer to current line in img_buf */
-
-    /* Set up the data type specific pointers */
-    switch (data_type)
+    int line;                /* looping variable for the first line of each
+                                strip or row of tiles */
+    int samp0;               /* first sample of the tile */
+    int bl;                  /* looping variable for the lines of a tile */
+    int block_nlines;        /* number of image lines in the strip or tile */
+    int tile_nsamps;         /* number of image samples in the tile */
+    size_t line_bytes;       /* number of bytes per line */
+    size_t tile_bytes;       /* number of bytes per tile */
+    size_t nbytes = 0;       /* number of bytes written */
+    unsigned char *buf = img_buf;      /* lines to be written */
+    unsigned char *tile_buf = NULL;    /* tile to be written */
+    double start_time;       /* start of the write for the I/O accounting */
+    int status = SUCCESS;    /* return status */
+    Tiff_layout_t layout;    /* size and storage layout of the image */
+
+    if (check_tiff_lines (tiff, data_type, line0, nlines, nsamps, &layout)
+        != SUCCESS)
+    {  /* Error message already written */
+        return ERROR;
+    }
+    if (nlines == 0)
+        return SUCCESS;
+
+    if (line0 % layout.block_lines != 0 ||
+        ((line0 + nlines) % layout.block_lines != 0 &&
+         line0 + nlines != layout.nlines))
     {
-        case ESPA_INT8: int8_ptr = img_buf; break;
-        case ESPA_UINT8: uint8_ptr = img_buf; break;
-        case ESPA_INT16: int16_ptr = img_buf; break;
-        case ESPA_UINT16: uint16_ptr = img_buf; break;
-        case ESPA_INT32: uint32_ptr = img_buf; break;
-        case ESPA_UINT32: uint32_ptr = img_buf; break;
-        case ESPA_FLOAT32: float_ptr = img_buf; break;
-        case ESPA_FLOAT64: double_ptr = img_buf; break;
-        default:
-            sprintf (errmsg, "Unsupported data type %d", data_type);
+        sprintf (errmsg, "Lines %d-%d don't start and end on the %d line "
+            "%s of the Tiff file", line0, line0 + nlines - 1,
+            layout.block_lines, layout.tiled ? "tiles" : "strips");
+        error_handler (true, FUNC_NAME, errmsg);
+        return ERROR;
+    }
+
+    line_bytes = (size_t) nsamps * layout.size;
+    tile_bytes = (size_t) layout.block_lines * layout.tile_samps *
+        layout.size;
+    if (layout.tiled)
+    {
+        tile_buf = espa_trace_malloc (tile_bytes);
+        if (tile_buf == NULL)
+        {
+            sprintf (errmsg, "Allocating memory for a Tiff tile");
             error_handler (true, FUNC_NAME, errmsg);
             return ERROR;
+        }
     }
 
-    /* Write the data to the Tiff file. Use the void pointer to point to
-       the location of the current line in the data type specific pointer. */
-    for (line = 0; line < nlines; line++)
+    /* Write the lines a strip or a row of tiles at a time */
+    start_time = espa_io_stats_clock ();
+    for (line = line0; line < line0 + nlines; line += layout.block_lines)
     {
-        curr_pix = line * nsamps;
-        switch (data_type)
+        block_nlines = layout.nlines - line;
+        if (block_nlines > layout.block_lines)
+            block_nlines = layout.block_lines;
+
+        if (!layout.tiled)
         {
-            case ESPA_INT8: void_ptr = &int8_ptr[curr_pix]; break;
-            case ESPA_UINT8: void_ptr = &uint8_ptr[curr_pix]; break;
-            case ESPA_INT16: void_ptr = &int16_ptr[curr_pix]; break;
-            case ESPA_UINT16: void_ptr = &uint16_ptr[curr_pix]; break;
-            case ESPA_INT32: void_ptr = &int32_ptr[curr_pix]; break;
-            case ESPA_UINT32: void_ptr = &uint32_ptr[curr_pix]; break;
-            case ESPA_FLOAT32: void_ptr = &float_ptr[curr_pix]; break;
-            case ESPA_FLOAT64: void_ptr = &double_ptr[curr_pix]; break;
+            if (TIFFWriteEncodedStrip (tiff, TIFFComputeStrip (tiff, line, 0),
+                buf + (size_t) (line - line0) * line_bytes,
+                (tmsize_t) block_nlines * line_bytes) < 0)
+                status = ERROR;
+            else
+                nbytes += block_nlines * line_bytes;
         }
 
-        if (TIFFWriteScanline (tiff, void_ptr, line, 0) < 0)
+        for (samp0 = 0; layout.tiled && status == SUCCESS && samp0 < nsamps;
+            samp0 += layout.tile_samps)
         {
-            sprintf (errmsg, "Writing line %d to the Tiff file.", line);
-            error_handler (true, FUNC_NAME, errmsg);
-            return ERROR;
+            tile_nsamps = nsamps - samp0;
+            if (tile_nsamps > layout.tile_samps)
+                tile_nsamps = layout.tile_samps;
+            memset (tile_buf, 0, tile_bytes);
+            for (bl = 0; bl < block_nlines; bl++)
+                memcpy (tile_buf + (size_t) bl * layout.tile_samps *
+                    layout.size, buf + (size_t) (line - line0 + bl) *
+                    line_bytes + (size_t) samp0 * layout.size,
+                    (size_t) tile_nsamps * layout.size);
+            if (TIFFWriteEncodedTile (tiff,
+                TIFFComputeTile (tiff, samp0, line, 0, 0), tile_buf,
+                (tmsize_t) tile_bytes) < 0)
+                status = ERROR;
+            else
+                nbytes += (size_t) block_nlines * tile_nsamps * layout.size;
         }
+        if (status != SUCCESS)
+            break;
+    }
+    espa_io_stats_record (tiff, ESPA_IO_WRITE, nbytes, start_time);
+    espa_trace_free (tile_buf);
+
+    if (status != SUCCESS)
+    {
+        sprintf (errmsg, "Writing the %s at line %d to the Tiff file.",
+            layout.tiled ? "tiles" : "strip", line);
+        error_handler (true, FUNC_NAME, errmsg);
+        return ERROR;
     }
 
     return SUCCESS;
@@ -759,62 +1539,292 @@ int read_tiff
                            been allocated) */
 )
 {
-    char FUNC_NAME[] = "read_tiff"; /* function name */
+    return read_tiff_lines (tiff, data_type, 0, nlines, nsamps, img_buf);
+}
+
+
+/******************************************************************************
+MODULE: read_tiff_lines
+
+PURPOSE: Reads nlines of data from the Tiff file, starting at line line0
+ 
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        An error occurred reading data from the Tiff file
+SUCCESS      Reading was successful
+
+NOTES:
+  1. The lines are read a whole strip or tile at a time, and decompressed by
+     the Tiff library if the image is compressed.  Strips that are wholly
+     within the block are read straight into img_buf.  Any block of lines
+     may be read, but a strip or row of tiles that straddles two blocks is
+     read twice, so blocks should be a multiple of the strip or tile height
+     (see open_tiff_block_reader).
+  2. Deflate (or ZSTD) compressed tiles, such as those of the Collection 2
+     Cloud-Optimized GeoTIFFs, are decoded across the threads by
+     read_tiff_tiles rather than one at a time by the Tiff library.
+*****************************************************************************/
+int read_tiff_lines
+(
+    TIFF *tiff,      /* I: pointer to the Tiff file */
+    int data_type,   /* I: data type of the array to be read (see
+                           Espa_data_type in espa_metadata.h) */
+    int line0,       /* I: 0-based line of the file for the first line */
+    int nlines,      /* I: number of lines to read from the file */
+    int nsamps,      /* I: number of samples to read from the file */
+    void *img_buf    /* O: array of nlines * nsamps * size to be read from the
+                           Tiff file (sufficient space should already have
+                           been allocated) */
+)
+{
+    char FUNC_NAME[] = "read_tiff_lines"; /* function name */
     char errmsg[STR_SIZE];   /* error message */
-    int line;                /* looping variable */
-    int curr_pix;            /* current pixel for start of line */
-    int8_t *int8_ptr = NULL;     /* pointer for int8 data types */
-    uint8_t *uint8_ptr = NULL;   /* pointer for uint8 data types */
-    int16_t *int16_ptr = NULL;   /* pointer for int16 data types */
-    uint16_t *uint16_ptr = NULL; /* pointer for uint16 data types */
-    int32_t *int32_ptr = NULL;   /* pointer for int32 data types */
-    uint32_t *uint32_ptr = NULL; /* pointer for uint32 data types */
-    float *float_ptr = NULL;     /* pointer for float data types */
-    double *double_ptr = NULL;   /* pointer for double data types */
-    void *void_ptr = NULL;       /* pointer to current line in img_buf */
-
-    /* Set up the data type specific pointers */
-    switch (data_type)
+    int line;                /* looping variable for the first line of each
+                                strip or row of tiles */
+    int samp0;               /* first sample of the tile */
+    int bl;                  /* looping variable for the lines of a strip or
+                                tile */
+    int first;               /* first line of the strip or tile to copy */
+    int last;                /* last line of the strip or tile to copy */
+    int block_nlines;        /* number of image lines in the strip or tile */
+    int tile_nsamps;         /* number of image samples in the tile */
+    size_t line_bytes;       /* number of bytes per line */
+    size_t tile_bytes;       /* number of bytes per strip or tile */
+    size_t nbytes = 0;       /* number of bytes read */
+    unsigned char *buf = img_buf;      /* lines read */
+    unsigned char *tile_buf = NULL;    /* strip or tile read */
+    double start_time;       /* start of the read for the I/O accounting */
+    int status = SUCCESS;    /* return status */
+    Tiff_layout_t layout;    /* size and storage layout of the image */
+
+    if (check_tiff_lines (tiff, data_type, line0, nlines, nsamps, &layout)
+        != SUCCESS)
+    {  /* Error message already written */
+        return ERROR;
+    }
+    if (nlines == 0)
+        return SUCCESS;
+
+    /* Decode compressed tiles across the threads */
+    if (tiff_tiles_decodable (tiff, &layout))
+        return read_tiff_tiles (tiff, &layout, line0, nlines, img_buf);
+
+    line_bytes = (size_t) nsamps * layout.size;
+    tile_bytes = (size_t) layout.block_lines * layout.tile_samps *
+        layout.size;
+    tile_buf = espa_trace_malloc (tile_bytes);
+    if (tile_buf == NULL)
     {
-        case ESPA_INT8: int8_ptr = img_buf; break;
-        case ESPA_UINT8: uint8_ptr = img_buf; break;
-        case ESPA_INT16: int16_ptr = img_buf; break;
-        case ESPA_UINT16: uint16_ptr = img_buf; break;
-        case ESPA_INT32: uint32_ptr = img_buf; break;
-        case ESPA_UINT32: uint32_ptr = img_buf; break;
-        case ESPA_FLOAT32: float_ptr = img_buf; break;
-        case ESPA_FLOAT64: double_ptr = img_buf; break;
-        default:
-            sprintf (errmsg, "Unsupported data type %d", data_type);
-            error_handler (true, FUNC_NAME, errmsg);
-            return ERROR;
+        sprintf (errmsg, "Allocating memory for a Tiff %s",
+            layout.tiled ? "tile" : "strip");
+        error_handler (true, FUNC_NAME, errmsg);
+        return ERROR;
     }
 
-    /* Read the data from the Tiff file. Use the void pointer to point to
-       the location of the current line in the data type specific pointer. */
-    for (line = 0; line < nlines; line++)
+    /* Read the lines a strip or a row of tiles at a time */
+    start_time = espa_io_stats_clock ();
+    for (line = line0 - line0 % layout.block_lines; line < line0 + nlines;
+        line += layout.block_lines)
     {
-        curr_pix = line * nsamps;
-        switch (data_type)
+        block_nlines = layout.nlines - line;
+        if (block_nlines > layout.block_lines)
+            block_nlines = layout.block_lines;
+        first = (line < line0) ? line0 - line : 0;
+        last = line0 + nlines - line;
+        if (last > block_nlines)
+            last = block_nlines;
+
+        if (!layout.tiled)
         {
-            case ESPA_INT8: void_ptr = &int8_ptr[curr_pix]; break;
-            case ESPA_UINT8: void_ptr = &uint8_ptr[curr_pix]; break;
-            case ESPA_INT16: void_ptr = &int16_ptr[curr_pix]; break;
-            case ESPA_UINT16: void_ptr = &uint16_ptr[curr_pix]; break;
-            case ESPA_INT32: void_ptr = &int32_ptr[curr_pix]; break;
-            case ESPA_UINT32: void_ptr = &uint32_ptr[curr_pix]; break;
-            case ESPA_FLOAT32: void_ptr = &float_ptr[curr_pix]; break;
-            case ESPA_FLOAT64: void_ptr = &double_ptr[curr_pix]; break;
+            if (first == 0 && last == block_nlines)
+            {  /* Whole strip; read it in place */
+                if (TIFFReadEncodedStrip (tiff,
+                    TIFFComputeStrip (tiff, line, 0),
+                    buf + (size_t) (line - line0) * line_bytes,
+                    (tmsize_t) block_nlines * line_bytes) < 0)
+                    status = ERROR;
+            }
+            else if (TIFFReadEncodedStrip (tiff,
+                TIFFComputeStrip (tiff, line, 0), tile_buf,
+                (tmsize_t) block_nlines * line_bytes) < 0)
+                status = ERROR;
+            else
+                memcpy (buf + (size_t) (line + first - line0) * line_bytes,
+                    tile_buf + (size_t) first * line_bytes,
+                    (size_t) (last - first) * line_bytes);
+            if (status == SUCCESS)
+                nbytes += block_nlines * line_bytes;
         }
 
-        if (TIFFReadScanline (tiff, void_ptr, line, 0) < 0)
+        for (samp0 = 0; layout.tiled && status == SUCCESS && samp0 < nsamps;
+            samp0 += layout.tile_samps)
         {
-            sprintf (errmsg, "Reading line %d to the Tiff file.", line);
-            error_handler (true, FUNC_NAME, errmsg);
-            return ERROR;
+            tile_nsamps = nsamps - samp0;
+            if (tile_nsamps > layout.tile_samps)
+                tile_nsamps = layout.tile_samps;
+            if (TIFFReadEncodedTile (tiff,
+                TIFFComputeTile (tiff, samp0, line, 0, 0), tile_buf,
+                (tmsize_t) tile_bytes) < 0)
+            {
+                status = ERROR;
+                break;
+            }
+            for (bl = first; bl < last; bl++)
+                memcpy (buf + (size_t) (line + bl - line0) * line_bytes +
+                    (size_t) samp0 * layout.size, tile_buf + (size_t) bl *
+                    layout.tile_samps * layout.size,
+                    (size_t) tile_nsamps * layout.size);
+            nbytes += tile_bytes;
         }
+        if (status != SUCCESS)
+            break;
+    }
+    espa_io_stats_record (tiff, ESPA_IO_READ, nbytes, start_time);
+    espa_trace_free (tile_buf);
+
+    if (status != SUCCESS)
+    {
+        sprintf (errmsg, "Reading the %s at line %d from the Tiff file.",
+            layout.tiled ? "tiles" : "strip", line);
+        error_handler (true, FUNC_NAME, errmsg);
+        return ERROR;
     }
 
     return SUCCESS;
 }
 
+
+/******************************************************************************
+MODULE: open_tiff_block_reader
+
+PURPOSE: Sets up the reading of the Tiff image as blocks of full width lines
+ 
+RETURN VALUE:
+Type = Tiff_block_reader_t *
+Value        Description
+-----        -----------
+NULL         Error getting the layout of the image or allocating memory
+non-NULL     Block reader of the image
+
+NOTES:
+  1. The number of lines per block is min_lines rounded up to a whole number
+     of strips or tile rows, so each strip or tile is decoded once.
+*****************************************************************************/
+Tiff_block_reader_t *open_tiff_block_reader
+(
+    TIFF *tiff,      /* I: pointer to the Tiff file */
+    int data_type,   /* I: data type of the image (see Espa_data_type in
+                           espa_metadata.h) */
+    int min_lines    /* I: least number of lines per block */
+)
+{
+    char FUNC_NAME[] = "open_tiff_block_reader"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    Tiff_block_reader_t *reader = NULL;  /* block reader */
+
+    reader = calloc (1, sizeof (Tiff_block_reader_t));
+    if (reader == NULL)
+    {
+        sprintf (errmsg, "Allocating memory for the Tiff block reader");
+        error_handler (true, FUNC_NAME, errmsg);
+        return NULL;
+    }
+    reader->tiff = tiff;
+    reader->data_type = data_type;
+
+    if (get_tiff_layout (tiff, &reader->layout) != SUCCESS)
+    {  /* Error message already written */
+        free (reader);
+        return NULL;
+    }
+
+    if (min_lines < 1)
+        min_lines = 1;
+    reader->block_lines = (min_lines + reader->layout.block_lines - 1) /
+        reader->layout.block_lines * reader->layout.block_lines;
+    if (reader->block_lines > reader->layout.nlines)
+        reader->block_lines = reader->layout.nlines;
+
+    reader->block.nsamps = reader->layout.nsamps;
+    reader->block.buf = espa_trace_malloc ((size_t) reader->block_lines *
+        reader->layout.nsamps * reader->layout.size);
+    if (reader->block.buf == NULL)
+    {
+        sprintf (errmsg, "Allocating memory for the Tiff blocks");
+        error_handler (true, FUNC_NAME, errmsg);
+        free (reader);
+        return NULL;
+    }
+
+    return reader;
+}
+
+
+/******************************************************************************
+MODULE: get_tiff_block
+
+PURPOSE: Reads the next block of lines of the Tiff image
+ 
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        An error occurred reading the block
+SUCCESS      Reading was successful
+
+NOTES:
+  1. The block is valid until the next call.
+*****************************************************************************/
+int get_tiff_block
+(
+    Tiff_block_reader_t *reader,    /* I: block reader */
+    Tiff_block_t **block            /* O: next block; NULL once all the
+                                          blocks have been read */
+)
+{
+    int nlines;              /* number of lines in the block */
+
+    *block = NULL;
+    if (reader->next_line >= reader->layout.nlines)
+        return SUCCESS;
+
+    nlines = reader->layout.nlines - reader->next_line;
+    if (nlines > reader->block_lines)
+        nlines = reader->block_lines;
+    if (read_tiff_lines (reader->tiff, reader->data_type, reader->next_line,
+        nlines, reader->layout.nsamps, reader->block.buf) != SUCCESS)
+    {  /* Error message already written */
+        return ERROR;
+    }
+
+    reader->block.line0 = reader->next_line;
+    reader->block.nlines = nlines;
+    reader->next_line += nlines;
+    *block = &reader->block;
+
+    return SUCCESS;
+}
+
+
+/******************************************************************************
+MODULE: close_tiff_block_reader
+
+PURPOSE: Frees the block reader.  The Tiff file is left open.
+ 
+RETURN VALUE:
+Type = N/A
+
+NOTES:
+*****************************************************************************/
+void close_tiff_block_reader
+(
+    Tiff_block_reader_t *reader     /* I: block reader to be closed */
+)
+{
+    if (reader == NULL)
+        return;
+    espa_trace_free (reader->block.buf);
+    free (reader);
+}
@@ -18,12 +18,14 @@ NOTES:
 #include <stdio.h>
 #include <string.h>
 #include <stdint.h>
+#include <sys/types.h>
 #include "tiffio.h"
 #include "xtiffio.h"
 #include "geotiffio.h"
 #include "espa_metadata.h"
 #include "parse_metadata.h"
 #include "error_handler.h"
+#include "espa_io_stats.h"
 
 /* Defines */
 typedef enum {
@@ -32,6 +34,40 @@ typedef enum {
   TIFF_READ_WRITE_FORMAT,
 } Tiff_format_t;
 
+/* Size and storage layout of a single sample per pixel Tiff image */
+typedef struct
+{
+    int nlines;          /* number of lines in the image */
+    int nsamps;          /* number of samples per line */
+    int size;            /* number of bytes per sample */
+    bool tiled;          /* is the image stored as tiles rather than strips? */
+    int block_lines;     /* number of lines per strip or tile */
+    int tile_samps;      /* number of samples per tile; nsamps for strips */
+} Tiff_layout_t;
+
+/* Block of full width lines read from a Tiff image.  Line bl starts at
+   (char *) buf + bl * nsamps * size. */
+typedef struct
+{
+    int line0;           /* 0-based first line of the block */
+    int nlines;          /* number of lines in the block */
+    int nsamps;          /* number of samples per line */
+    void *buf;           /* pixels of the block */
+} Tiff_block_t;
+
+/* Reader of a Tiff image as blocks of lines */
+typedef struct
+{
+    TIFF *tiff;          /* Tiff file being read */
+    int data_type;       /* data type of the image (see ESPA_* in
+                            espa_metadata.h) */
+    Tiff_layout_t layout;  /* size and storage layout of the image */
+    int block_lines;     /* number of lines per block; a multiple of the
+                            lines per strip or tile */
+    int next_line;       /* first line of the next block */
+    Tiff_block_t block;  /* block handed to the caller */
+} Tiff_block_reader_t;
+
 /* Prototypes */
 int set_geotiff_datum
 (
@@ -56,6 +92,59 @@ void set_tiff_tags
     int nsamps              /* I: number of samples */
 );
 
+void set_tiff_strip_tags
+(
+    TIFF *tiff_fptr, /* I: pointer to Tiff file */
+    int data_type,   /* I: data type of this band (see ESPA_* in
+                           espa_metadata.h) */
+    int nlines,      /* I: number of lines */
+    int nsamps,      /* I: number of samples */
+    int rows_per_strip, /* I: number of lines in a strip */
+    int compression, /* I: Tiff compression scheme (COMPRESSION_*) */
+    int predictor    /* I: Tiff predictor (PREDICTOR_*) */
+);
+
+void set_tiff_tile_tags
+(
+    TIFF *tiff_fptr, /* I: pointer to Tiff file */
+    int data_type,   /* I: data type of this band (see ESPA_* in
+                           espa_metadata.h) */
+    int nlines,      /* I: number of lines */
+    int nsamps,      /* I: number of samples */
+    int tile_size,   /* I: number of lines and samples in a tile; a multiple
+                           of 16 */
+    int compression, /* I: Tiff compression scheme (COMPRESSION_*) */
+    int predictor,   /* I: Tiff predictor (PREDICTOR_*) */
+    bool reduced     /* I: is this a reduced resolution (overview) image? */
+);
+
+int set_tiff_nodata
+(
+    TIFF *tiff_fptr,    /* I: pointer to Tiff file */
+    long fill_value     /* I: fill value of the band */
+);
+
+int write_tiff_world_file
+(
+    char *tfw_file,              /* I: name of the world file */
+    Espa_band_meta_t *bmeta,     /* I: band metadata */
+    Espa_proj_meta_t *proj_info  /* I: global projection information */
+);
+
+int get_tiff_layout
+(
+    TIFF *tiff_fptr,         /* I: pointer to the Tiff file */
+    Tiff_layout_t *layout    /* O: size and storage layout of the image */
+);
+
+bool get_tiff_payload
+(
+    TIFF *tiff_fptr,         /* I: pointer to the Tiff file */
+    Tiff_layout_t *layout,   /* I: size and storage layout of the image (see
+                                   get_tiff_layout) */
+    off_t *offset            /* O: file offset of the first pixel */
+);
+
 TIFF *open_tiff
 (
     char *tiff_file,     /* I: name of the input Tiff file to be opened */
@@ -64,6 +153,13 @@ TIFF *open_tiff
                                top of this file */
 );
 
+TIFF *open_tiff_buffer
+(
+    char *tiff_name,     /* I: name of the Tiff file, for messages */
+    void *buf,           /* I: bytes of the Tiff file */
+    size_t nbytes        /* I: number of bytes in the Tiff file */
+);
+
 void close_tiff
 (
     TIFF *tiff_fptr    /* I: pointer to Tiff file to be closed */
@@ -80,6 +176,18 @@ int write_tiff
                            Tiff file */
 );
 
+int write_tiff_lines
+(
+    TIFF *tif_fptr,  /* I: pointer to the Tiff file */
+    int data_type,   /* I: data type of the array to be written (see
+                           Espa_data_type in espa_metadata.h) */
+    int line0,       /* I: 0-based line of the file for the first line */
+    int nlines,      /* I: number of lines to write to the file */
+    int nsamps,      /* I: number of samples to write to the file */
+    void *img_buf    /* I: array of nlines * nsamps * size to be written to the
+                           Tiff file */
+);
+
 int read_tiff
 (
     TIFF *tif_fptr,  /* I: pointer to the Tiff file */
@@ -92,4 +200,37 @@ int read_tiff
                            been allocated) */
 );
 
+int read_tiff_lines
+(
+    TIFF *tif_fptr,  /* I: pointer to the Tiff file */
+    int data_type,   /* I: data type of the array to be read (see
+                           Espa_data_type in espa_metadata.h) */
+    int line0,       /* I: 0-based line of the file for the first line */
+    int nlines,      /* I: number of lines to read from the file */
+    int nsamps,      /* I: number of samples to read from the file */
+    void *img_buf    /* O: array of nlines * nsamps * size to be read from the
+                           Tiff file (sufficient space should already have
+                           been allocated) */
+);
+
+Tiff_block_reader_t *open_tiff_block_reader
+(
+    TIFF *tif_fptr,  /* I: pointer to the Tiff file */
+    int data_type,   /* I: data type of the image (see Espa_data_type in
+                           espa_metadata.h) */
+    int min_lines    /* I: least number of lines per block */
+);
+
+int get_tiff_block
+(
+    Tiff_block_reader_t *reader,    /* I: block reader */
+    Tiff_block_t **block            /* O: next block; NULL once all the
+                                          blocks have been read */
+);
+
+void close_tiff_block_reader
+(
+    Tiff_block_reader_t *reader     /* I: block reader to be closed */
+);
+
 #endif
@@ -0,0 +1,523 @@
+/*****************************************************************************
+FILE: upgrade_metadata.c
+
+PURPOSE: Contains functions for upgrading XML metadata files written to the
+older ESPA schemas to the current schema.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The changes between the schemas which affect the documents are:
+       v1.2  toa_reflectance (gain and bias) became reflectance
+       v1.3  calibrated_nt was dropped; the namespace became v1
+       v2.0  scene_id became product_id; the namespace became v2
+     The other changes only add optional elements and attributes or relax
+     types and enumerations, so the documents remain valid as they are.
+  2. The white space in front of a removed element is dropped with it, so
+     the layout of the upgraded document has no blank lines in its place.
+*****************************************************************************/
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE     /* for open_memstream */
+#endif
+#include <libxml/xmlreader.h>
+#include "upgrade_metadata.h"
+#include "write_metadata.h"
+
+/* Most white space held back in front of an element */
+#define UPGRADE_MAX_SPACE 256
+
+/* Namespace of an older schema and the version it stands for */
+typedef struct
+{
+    const char *uri;        /* namespace of the schema */
+    const char *version;    /* schema version; NULL if given by the version
+                               attribute of the root element */
+} Upgrade_ns_t;
+
+static const Upgrade_ns_t upgrade_ns[] =
+{
+    {"http://espa.cr.usgs.gov/v1.0", "1.0"},
+    {"http://espa.cr.usgs.gov/v1.1", "1.1"},
+    {"http://espa.cr.usgs.gov/v1.2", "1.2"},
+    {"http://espa.cr.usgs.gov/v1", "1.3"},
+    {ESPA_NS, NULL}
+};
+
+#define UPGRADE_NUM_NS ((int) (sizeof (upgrade_ns) / sizeof (upgrade_ns[0])))
+
+/* Element renamed or dropped by a schema */
+typedef struct
+{
+    const char *name;       /* name of the element in the older schemas */
+    const char *new_name;   /* name of the element; NULL if dropped */
+    const char *since;      /* first schema version with the change */
+} Upgrade_rename_t;
+
+static const Upgrade_rename_t upgrade_renames[] =
+{
+    {"toa_reflectance", "reflectance", "1.2"},
+    {"calibrated_nt", NULL, "1.3"},
+    {"scene_id", "product_id", "2.0"}
+};
+
+#define UPGRADE_NUM_RENAMES \
+    ((int) (sizeof (upgrade_renames) / sizeof (upgrade_renames[0])))
+
+/* State of the upgrade of an XML file */
+typedef struct
+{
+    FILE *fptr;             /* stream rendering the upgraded document */
+    const char *from_version;  /* schema version of the XML file */
+    char space[UPGRADE_MAX_SPACE];  /* white space held back in front of
+                               the next element */
+    int space_len;          /* number of chars of white space held back */
+} Upgrade_state_t;
+
+
+/******************************************************************************
+MODULE:  upgraded_name
+
+PURPOSE: Finds the name of an element of the XML file in the current schema.
+
+RETURN VALUE:
+Type = const char *
+Value           Description
+-----           -----------
+NULL            The element was dropped
+name            Name of the element in the current schema
+
+NOTES:
+******************************************************************************/
+static const char *upgraded_name
+(
+    const Upgrade_state_t *state,  /* I: state of the upgrade */
+    const char *name               /* I: name of the element */
+)
+{
+    int i;                  /* looping variable for the renames */
+
+    for (i = 0; i < UPGRADE_NUM_RENAMES; i++)
+    {
+        if (!strcmp (name, upgrade_renames[i].name) &&
+            strcmp (state->from_version, upgrade_renames[i].since) < 0)
+            return upgrade_renames[i].new_name;
+    }
+
+    return name;
+}
+
+
+/******************************************************************************
+MODULE:  write_escaped
+
+PURPOSE: Writes a text or attribute value, escaping the markup characters.
+
+RETURN VALUE: N/A
+
+NOTES:
+******************************************************************************/
+static void write_escaped
+(
+    FILE *fptr,             /* I: stream the document is rendered to */
+    const char *value,      /* I: value to be written */
+    bool attribute          /* I: is the value an attribute value? */
+)
+{
+    const char *cptr;       /* current character of the value */
+
+    for (cptr = value; *cptr != '\0'; cptr++)
+    {
+        switch (*cptr)
+        {
+            case '&':
+                fputs ("&amp;", fptr);
+                break;
+            case '<':
+                fputs ("&lt;", fptr);
+                break;
+            case '>':
+                fputs ("&gt;", fptr);
+                break;
+            case '"':
+                fputs (attribute ? "&quot;" : "\"", fptr);
+                break;
+            default:
+                fputc (*cptr, fptr);
+                break;
+        }
+    }
+}
+
+
+/******************************************************************************
+MODULE:  flush_space
+
+PURPOSE: Writes the white space held back in front of the next element.
+
+RETURN VALUE: N/A
+
+NOTES:
+******************************************************************************/
+static void flush_space
+(
+    Upgrade_state_t *state  /* I/O: state of the upgrade */
+)
+{
+    if (state->space_len > 0)
+        fwrite (state->space, 1, state->space_len, state->fptr);
+    state->space_len = 0;
+}
+
+
+/******************************************************************************
+MODULE:  write_start_tag
+
+PURPOSE: Writes the start tag of the current element with its attributes,
+leaving out the namespace declarations.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error reading the attributes
+SUCCESS         Successfully wrote the start tag
+
+NOTES:
+******************************************************************************/
+static int write_start_tag
+(
+    xmlTextReaderPtr reader,  /* I: reader on the element */
+    Upgrade_state_t *state,   /* I/O: state of the upgrade */
+    const char *name          /* I: name of the element */
+)
+{
+    bool empty;               /* is the element empty? */
+    int status;               /* status of moving to the next attribute */
+
+    empty = xmlTextReaderIsEmptyElement (reader) == 1;
+    fprintf (state->fptr, "<%s", name);
+
+    status = xmlTextReaderMoveToFirstAttribute (reader);
+    while (status == 1)
+    {
+        if (xmlTextReaderIsNamespaceDecl (reader) != 1)
+        {
+            fprintf (state->fptr, " %s=\"",
+                (const char *) xmlTextReaderConstName (reader));
+            write_escaped (state->fptr,
+                (const char *) xmlTextReaderConstValue (reader), true);
+            fputc ('"', state->fptr);
+        }
+        status = xmlTextReaderMoveToNextAttribute (reader);
+    }
+    if (status < 0 || xmlTextReaderMoveToElement (reader) < 0)
+        return (ERROR);
+
+    fputs (empty ? "/>" : ">", state->fptr);
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  find_from_version
+
+PURPOSE: Finds the schema version of the XML file from the namespace and
+version of its root element.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           The root element isn't ESPA metadata of a known schema
+SUCCESS         Successfully found the schema version
+
+NOTES:
+******************************************************************************/
+static int find_from_version
+(
+    xmlTextReaderPtr reader,  /* I: reader on the root element */
+    char *xml_file,           /* I: name of the XML metadata file */
+    char *from_version        /* O: schema version of the XML file */
+)
+{
+    char FUNC_NAME[] = "find_from_version";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    const char *name = NULL;  /* local name of the root element */
+    const char *uri = NULL;   /* namespace of the root element */
+    xmlChar *version = NULL;  /* version attribute of the root element */
+    int i;                    /* looping variable for the namespaces */
+
+    name = (const char *) xmlTextReaderConstLocalName (reader);
+    uri = (const char *) xmlTextReaderConstNamespaceUri (reader);
+    if (name == NULL || strcmp (name, "espa_metadata"))
+    {
+        snprintf (errmsg, sizeof (errmsg), "%s isn't ESPA metadata; its "
+            "root element is %s", xml_file, name ? name : "missing");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    for (i = 0; i < UPGRADE_NUM_NS; i++)
+        if (uri != NULL && !strcmp (uri, upgrade_ns[i].uri))
+            break;
+    if (i == UPGRADE_NUM_NS)
+    {
+        snprintf (errmsg, sizeof (errmsg), "%s has the unknown ESPA "
+            "namespace %s", xml_file, uri ? uri : "(none)");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    if (upgrade_ns[i].version != NULL)
+    {
+        strcpy (from_version, upgrade_ns[i].version);
+        return (SUCCESS);
+    }
+
+    /* The v2 schemas share a namespace and are told apart by the version
+       attribute */
+    version = xmlTextReaderGetAttribute (reader, BAD_CAST "version");
+    snprintf (from_version, UPGRADE_VERSION_SIZE, "%s",
+        version ? (const char *) version : "2.0");
+    xmlFree (version);
+    if (strncmp (from_version, "2.", 2) ||
+        strcmp (from_version, ESPA_SCHEMA_VERSION) > 0)
+    {
+        snprintf (errmsg, sizeof (errmsg), "%s has the unknown schema "
+            "version %s", xml_file, from_version);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  render_upgrade
+
+PURPOSE: Renders the upgraded document from the reader, which is on the root
+element.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error reading the XML file
+SUCCESS         Successfully rendered the upgraded document
+
+NOTES:
+  1. The elements of the current namespace are written without a prefix,
+     since the root element declares it the default namespace.
+******************************************************************************/
+static int render_upgrade
+(
+    xmlTextReaderPtr reader,  /* I: reader on the root element */
+    Upgrade_state_t *state,   /* I/O: state of the upgrade */
+    char *xml_file            /* I: name of the XML metadata file */
+)
+{
+    char FUNC_NAME[] = "render_upgrade";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    const char *name = NULL;  /* name of the element in the current schema */
+    const char *value = NULL; /* value of the current node */
+    int node_type;            /* type of the current node */
+    int len;                  /* length of the white space */
+    int status = 1;           /* status of reading the next node */
+
+    /* The root element gets the current version and schema location */
+    fprintf (state->fptr,
+        "<espa_metadata version=\"%s\"\n"
+        "xmlns=\"%s\"\n"
+        "xmlns:xsi=\"http://www.w3.org/2001/XMLSchema-instance\"\n"
+        "xsi:schemaLocation=\"%s %s\">", ESPA_SCHEMA_VERSION, ESPA_NS,
+        ESPA_SCHEMA_LOCATION, ESPA_SCHEMA);
+    if (xmlTextReaderIsEmptyElement (reader) == 1)
+        fputs ("</espa_metadata>", state->fptr);
+    status = xmlTextReaderRead (reader);
+
+    while (status == 1)
+    {
+        node_type = xmlTextReaderNodeType (reader);
+        value = (const char *) xmlTextReaderConstValue (reader);
+        switch (node_type)
+        {
+            case XML_READER_TYPE_ELEMENT:
+            case XML_READER_TYPE_END_ELEMENT:
+                name = upgraded_name (state,
+                    (const char *) xmlTextReaderConstLocalName (reader));
+                if (name == NULL)
+                {
+                    /* Drop the element, its contents, and the white space
+                       in front of it */
+                    state->space_len = 0;
+                    status = xmlTextReaderNext (reader);
+                    continue;
+                }
+                flush_space (state);
+                if (node_type == XML_READER_TYPE_END_ELEMENT)
+                    fprintf (state->fptr, "</%s>", name);
+                else if (write_start_tag (reader, state, name) != SUCCESS)
+                    status = -1;
+                break;
+
+            case XML_READER_TYPE_WHITESPACE:
+            case XML_READER_TYPE_SIGNIFICANT_WHITESPACE:
+                len = value ? strlen (value) : 0;
+                if (len > UPGRADE_MAX_SPACE - state->space_len)
+                    len = UPGRADE_MAX_SPACE - state->space_len;
+                memcpy (&state->space[state->space_len], value, len);
+                state->space_len += len;
+                break;
+
+            case XML_READER_TYPE_TEXT:
+                flush_space (state);
+                write_escaped (state->fptr, value ? value : "", false);
+                break;
+
+            case XML_READER_TYPE_CDATA:
+                flush_space (state);
+                fprintf (state->fptr, "<![CDATA[%s]]>", value ? value : "");
+                break;
+
+            case XML_READER_TYPE_COMMENT:
+                flush_space (state);
+                fprintf (state->fptr, "<!--%s-->", value ? value : "");
+                break;
+
+            default:
+                break;
+        }
+
+        if (status == 1)
+            status = xmlTextReaderRead (reader);
+    }
+    flush_space (state);
+    fputc ('\n', state->fptr);
+
+    if (status != 0)
+    {
+        sprintf (errmsg, "Reading %s", xml_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  upgrade_metadata
+
+PURPOSE: Upgrades an XML metadata file written to an older ESPA schema to
+the current schema.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error reading the XML file or writing the upgraded file
+SUCCESS         Successfully upgraded the XML file, or it already follows
+                the current schema
+
+NOTES:
+  1. The XML file isn't validated against its schema; the upgraded file may
+     be validated against the current schema as any other.
+  2. Comments and processing instructions ahead of the root element are
+     dropped, since the XML declaration and root element are written anew.
+******************************************************************************/
+int upgrade_metadata
+(
+    char *xml_file,       /* I: XML metadata file to be upgraded */
+    char *out_file,       /* I: upgraded XML metadata file; may be xml_file
+                                to upgrade it in place */
+    char *from_version,   /* O: schema version of the XML file
+                                (UPGRADE_VERSION_SIZE chars) */
+    bool *upgraded        /* O: was the upgraded file written?  false if the
+                                XML file already follows the current
+                                schema, in which case out_file isn't
+                                written */
+)
+{
+    char FUNC_NAME[] = "upgrade_metadata";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    char *xml_buf = NULL;     /* upgraded document rendered in memory */
+    size_t xml_len = 0;       /* length of the upgraded document */
+    int status;               /* status of reading the next node */
+    int retval = SUCCESS;     /* return status */
+    xmlTextReaderPtr reader = NULL;  /* reader for the XML file */
+    Upgrade_state_t state;    /* state of the upgrade */
+
+    *upgraded = false;
+    strcpy (from_version, "");
+
+    reader = xmlReaderForFile (xml_file, NULL, XML_PARSE_NONET);
+    if (reader == NULL)
+    {
+        sprintf (errmsg, "Opening %s", xml_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Move to the root element and find the schema of the XML file */
+    do
+    {
+        status = xmlTextReaderRead (reader);
+    } while (status == 1 &&
+        xmlTextReaderNodeType (reader) != XML_READER_TYPE_ELEMENT);
+    if (status != 1)
+    {
+        sprintf (errmsg, "Reading the root element of %s", xml_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        xmlFreeTextReader (reader);
+        return (ERROR);
+    }
+    if (find_from_version (reader, xml_file, from_version) != SUCCESS)
+    {  /* Error messages already written */
+        xmlFreeTextReader (reader);
+        return (ERROR);
+    }
+    if (!strcmp (from_version, ESPA_SCHEMA_VERSION))
+    {
+        xmlFreeTextReader (reader);
+        return (SUCCESS);
+    }
+
+    /* Render the upgraded document into a growable memory buffer */
+    memset (&state, 0, sizeof (state));
+    state.from_version = from_version;
+    state.fptr = open_memstream (&xml_buf, &xml_len);
+    if (state.fptr == NULL)
+    {
+        sprintf (errmsg, "Opening the memory buffer for the XML document");
+        error_handler (true, FUNC_NAME, errmsg);
+        xmlFreeTextReader (reader);
+        return (ERROR);
+    }
+    fputs ("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n\n", state.fptr);
+    retval = render_upgrade (reader, &state, xml_file);
+    xmlFreeTextReader (reader);
+    if (fclose (state.fptr) != 0 && retval == SUCCESS)
+    {
+        sprintf (errmsg, "Rendering the upgraded XML document");
+        error_handler (true, FUNC_NAME, errmsg);
+        retval = ERROR;
+    }
+
+    /* Publish the upgraded document as the output file */
+    if (retval == SUCCESS &&
+        publish_xml_buffer (out_file, xml_buf, xml_len) != SUCCESS)
+    {
+        sprintf (errmsg, "Writing the upgraded XML file %s", out_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        retval = ERROR;
+    }
+    free (xml_buf);
+
+    *upgraded = (retval == SUCCESS);
+    return (retval);
+}
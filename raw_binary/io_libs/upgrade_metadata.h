@@ -0,0 +1,51 @@
+/*****************************************************************************
+FILE: upgrade_metadata.h
+
+PURPOSE: Contains defines and prototypes for upgrading XML metadata files
+written to the older ESPA schemas (v1.0 through v2.1) to the current schema.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The XML file is read with the pull parser and rewritten in one pass
+     into memory, then published with a single write to a temporary file
+     renamed over the output file (see write_metadata.c), so readers see
+     either the old or the upgraded document in full.
+  2. The elements are moved to the current namespace, and the root element
+     gets the current version and schema location.  Elements which were
+     renamed by a later schema are renamed and elements which were dropped
+     are removed.  Everything else (the order of the elements, attributes,
+     values, comments, and layout) is kept as it is.
+*****************************************************************************/
+
+#ifndef UPGRADE_METADATA_H
+#define UPGRADE_METADATA_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include "error_handler.h"
+#include "espa_metadata.h"
+
+/* Defines */
+#define UPGRADE_VERSION_SIZE 8     /* size of a schema version string */
+
+/* Prototypes */
+int upgrade_metadata
+(
+    char *xml_file,       /* I: XML metadata file to be upgraded */
+    char *out_file,       /* I: upgraded XML metadata file; may be xml_file
+                                to upgrade it in place */
+    char *from_version,   /* O: schema version of the XML file
+                                (UPGRADE_VERSION_SIZE chars) */
+    bool *upgraded        /* O: was the upgraded file written?  false if the
+                                XML file already follows the current
+                                schema, in which case out_file isn't
+                                written */
+);
+
+#endif
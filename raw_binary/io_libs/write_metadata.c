@@ -14,56 +14,216 @@ NOTES:
      metadata format found in ESPA Raw Binary Format v1.2.doc.  The schema for
      the ESPA internal metadata format is available at
      http://espa.cr.usgs.gov/schema/espa_internal_metadata_v1_2.xsd.
+  2. The XML documents are rendered into memory and then published with a
+     single write to a temporary file, which is renamed over the XML file.
+     Readers therefore see either the previous or the new document in full.
+  3. With staging on (see espa_staging.h), the document is published only
+     once the staged band files have been flushed, so a reader which finds
+     it finds all of its bands.
+  4. The bands placed in shared memory (see espa_shm.h) are named for their
+     segments in the document.
 *****************************************************************************/
 
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE     /* for open_memstream */
+#endif
 #include <math.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
 #include "write_metadata.h"
+#include "metadata_cache.h"
+#include "espa_staging.h"
+#include "espa_shm.h"
+
+/* Number of histogram counts written on each line */
+#define STATS_COUNTS_PER_LINE 16
 
 /******************************************************************************
-MODULE:  write_metadata
+MODULE:  write_band_stats
 
-PURPOSE: Write the metadata structure to the specified XML metadata file
+PURPOSE: Writes the statistics element of a band, if its statistics are
+known.
+
+RETURN VALUE: N/A
+
+NOTES:
+******************************************************************************/
+static void write_band_stats
+(
+    FILE *fptr,                     /* I: file the XML is written to */
+    const Espa_band_stats_t *stats  /* I: statistics of the band */
+)
+{
+    int i;                          /* looping variable for the bins */
+
+    if (stats->valid_count == ESPA_INT_META_FILL)
+        return;
+
+    fprintf (fptr, "            <statistics valid_count=\"%ld\"",
+        stats->valid_count);
+    if (stats->valid_count > 0)
+        fprintf (fptr, " min=\"%.9g\" max=\"%.9g\" mean=\"%.9g\" "
+            "stddev=\"%.9g\"", stats->min, stats->max, stats->mean,
+            stats->stddev);
+    if (stats->nbins == 0)
+    {
+        fprintf (fptr, "/>\n");
+        return;
+    }
+
+    fprintf (fptr, ">\n                <histogram min=\"%.9g\" max=\"%.9g\" "
+        "nbins=\"%d\">", stats->hist_min, stats->hist_max, stats->nbins);
+    for (i = 0; i < stats->nbins; i++)
+    {
+        if (i % STATS_COUNTS_PER_LINE == 0)
+            fprintf (fptr, "\n                   ");
+        fprintf (fptr, " %ld", stats->histogram[i]);
+    }
+    fprintf (fptr, "\n                </histogram>\n"
+        "            </statistics>\n");
+}
+
+/******************************************************************************
+MODULE:  publish_xml_buffer
+
+PURPOSE: Writes the rendered XML document to a temporary file alongside the
+XML file, then renames it over the XML file.
 
 RETURN VALUE:
 Type = int
 Value           Description
 -----           -----------
-ERROR           Error writing the metadata file
-SUCCESS         Successfully wrote the metadata file
+ERROR           Error writing or renaming the temporary file
+SUCCESS         Successfully published the XML file
 
 NOTES:
-  1. If the XML file specified already exists, it will be overwritten.
-  2. Use this routine to create a new metadata file.  To append bands to an
-     existing metadata file, use append_metadata.
-  3. It is recommended that validate_meta be used after writing the XML file
-     to make sure the new file is valid against the ESPA schema.
+  1. The temporary file is removed if an error occurs, leaving any existing
+     XML file untouched.
+  2. Waits for the staged files to be flushed first, and leaves the XML file
+     untouched if any of them couldn't be.
 ******************************************************************************/
-int write_metadata
+int publish_xml_buffer
+(
+    const char *xml_file,     /* I: name of the XML metadata file */
+    const char *xml_buf,      /* I: rendered XML document */
+    size_t xml_len            /* I: length of the rendered XML document */
+)
+{
+    char FUNC_NAME[] = "publish_xml_buffer";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    char tmp_file[STR_SIZE];  /* name of the XML file while it is written */
+    int fd;                   /* file descriptor of the temporary file */
+    int count;                /* number of chars copied in snprintf */
+    size_t nwritten = 0;      /* number of bytes written so far */
+    ssize_t nbytes;           /* number of bytes written by this write */
+
+    if (espa_staging_wait () != SUCCESS)
+    {
+        sprintf (errmsg, "Flushing the staged bands of %s", xml_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    count = snprintf (tmp_file, sizeof (tmp_file), "%s.%ld.tmp", xml_file,
+        (long) getpid ());
+    if (count < 0 || count >= sizeof (tmp_file))
+    {
+        sprintf (errmsg, "Overflow of the temporary XML file name");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    fd = open (tmp_file, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (fd == -1)
+    {
+        sprintf (errmsg, "Opening %s for write access.", tmp_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* The document normally goes out in a single write; only partial or
+       interrupted writes loop */
+    while (nwritten < xml_len)
+    {
+        nbytes = write (fd, xml_buf + nwritten, xml_len - nwritten);
+        if (nbytes < 0 && errno == EINTR)
+            continue;
+        if (nbytes <= 0)
+            break;
+        nwritten += nbytes;
+    }
+
+    if (close (fd) != 0 || nwritten != xml_len)
+    {
+        sprintf (errmsg, "Writing %s", tmp_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        unlink (tmp_file);
+        return (ERROR);
+    }
+
+    if (rename (tmp_file, xml_file) != 0)
+    {
+        sprintf (errmsg, "Renaming %s to %s", tmp_file, xml_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        unlink (tmp_file);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  render_metadata
+
+PURPOSE: Renders the metadata structure as an XML metadata document in
+memory.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error rendering the document
+SUCCESS         Successfully rendered the document
+
+NOTES:
+  1. The document is exactly what write_metadata writes to the XML file.
+     It is up to the calling routine to free it.
+******************************************************************************/
+int render_metadata
 (
     Espa_internal_meta_t *metadata,  /* I: input metadata structure to be
-                                           written to XML */
-    char *xml_file                   /* I: name of the XML metadata file to
-                                           be written to or overwritten */
+                                           rendered as XML */
+    char **xml_doc,                  /* O: XML document; memory is
+                                           allocated */
+    size_t *xml_doc_len              /* O: length of the XML document */
 )
 {
-    char FUNC_NAME[] = "write_metadata";       /* function name */
+    char FUNC_NAME[] = "render_metadata";      /* function name */
     char errmsg[STR_SIZE];   /* error message */
     char myproj[STR_SIZE];   /* projection type string */
     char mydatum[STR_SIZE];  /* datum string */
     char my_dtype[STR_SIZE]; /* data type string */
     char my_rtype[STR_SIZE]; /* resampling type string */
+    char xml_name[STR_SIZE]; /* name of the band file in the document */
     int i, j;                /* looping variables */
-    FILE *fptr = NULL;       /* file pointer to the XML metadata file */
+    FILE *fptr = NULL;       /* stream rendering the XML document */
+    char *xml_buf = NULL;    /* XML document rendered in memory */
+    size_t xml_len = 0;      /* length of the rendered XML document */
     Espa_global_meta_t *gmeta = &metadata->global;  /* pointer to the global
                                                        metadata structure */
     Espa_band_meta_t *bmeta = metadata->band;  /* pointer to the array of
                                                   bands metadata */
 
-    /* Open the metadata XML file for write or rewrite privelages */
-    fptr = fopen (xml_file, "w");
+    /* Render the document into a growable memory buffer */
+    *xml_doc = NULL;
+    *xml_doc_len = 0;
+    fptr = open_memstream (&xml_buf, &xml_len);
     if (fptr == NULL)
     {
-        sprintf (errmsg, "Opening %s for write access.", xml_file);
+        sprintf (errmsg, "Opening the memory buffer for the XML document");
         error_handler (true, FUNC_NAME, errmsg);
         return (ERROR);
     }
@@ -254,6 +414,10 @@ int write_metadata
         "        <orientation_angle>%f</orientation_angle>\n",
             gmeta->orientation_angle);
 
+    if (strcmp (gmeta->footprint, ESPA_STRING_META_FILL))
+        fprintf (fptr,
+        "        <footprint>%s</footprint>\n", gmeta->footprint);
+
     fprintf (fptr,
         "    </global_metadata>\n\n");
 
@@ -309,6 +473,23 @@ int write_metadata
             fprintf (fptr, " scale_factor=\"%10.8f\"", bmeta[i].scale_factor);
         if (fabs (bmeta[i].add_offset-ESPA_FLOAT_META_FILL) > ESPA_EPSILON)
             fprintf (fptr, " add_offset=\"%f\"", bmeta[i].add_offset);
+        if (is_constant_band (&bmeta[i]))
+            fprintf (fptr, " constant_value=\"%lf\"",
+                bmeta[i].constant_value);
+        if (strcmp (bmeta[i].footprint_file, ESPA_STRING_META_FILL))
+            fprintf (fptr, " footprint_file=\"%s\"",
+                bmeta[i].footprint_file);
+        if (strcmp (bmeta[i].overview_file, ESPA_STRING_META_FILL))
+            fprintf (fptr, " overview_file=\"%s\" overview_levels=\"%d\"",
+                bmeta[i].overview_file, bmeta[i].overview_levels);
+        if (strcmp (bmeta[i].encoding, ESPA_STRING_META_FILL))
+            fprintf (fptr, " encoding=\"%s\"", bmeta[i].encoding);
+        if (bmeta[i].tile_size > 0)
+            fprintf (fptr, " tile_size=\"%d\"", bmeta[i].tile_size);
+        if (bmeta[i].file_offset != 0)
+            fprintf (fptr, " file_offset=\"%ld\"", bmeta[i].file_offset);
+        if (strcmp (bmeta[i].checksum, ESPA_STRING_META_FILL))
+            fprintf (fptr, " checksum=\"%s\"", bmeta[i].checksum);
         fprintf (fptr, ">\n");
 
         fprintf (fptr,
@@ -317,7 +498,8 @@ int write_metadata
             "            <file_name>%s</file_name>\n"
             "            <pixel_size x=\"%g\" y=\"%g\" units=\"%s\"/>\n"
             "            <resample_method>%s</resample_method>\n",
-            bmeta[i].short_name, bmeta[i].long_name, bmeta[i].file_name,
+            bmeta[i].short_name, bmeta[i].long_name,
+            espa_shm_xml_name (bmeta[i].file_name, xml_name),
             bmeta[i].pixel_size[0], bmeta[i].pixel_size[1],
             bmeta[i].pixel_units, my_rtype);
 
@@ -335,6 +517,7 @@ int write_metadata
                 "            <valid_range min=\"%f\" max=\"%f\"/>\n",
                 bmeta[i].valid_range[0], bmeta[i].valid_range[1]);
         }
+        write_band_stats (fptr, &bmeta[i].stats);
 
         if (fabs (bmeta[i].rad_gain - ESPA_FLOAT_META_FILL) > ESPA_EPSILON &&
             fabs (bmeta[i].rad_bias - ESPA_FLOAT_META_FILL) > ESPA_EPSILON)
@@ -430,14 +613,348 @@ int write_metadata
     fprintf (fptr,
         "</espa_metadata>\n");
 
-    /* Close the XML file */
-    fclose (fptr);
+    /* Finish the rendered document */
+    if (fclose (fptr) != 0 || xml_buf == NULL)
+    {
+        sprintf (errmsg, "Rendering the XML document");
+        error_handler (true, FUNC_NAME, errmsg);
+        free (xml_buf);
+        return (ERROR);
+    }
+
+    *xml_doc = xml_buf;
+    *xml_doc_len = xml_len;
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  write_metadata
+
+PURPOSE: Write the metadata structure to the specified XML metadata file
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the metadata file
+SUCCESS         Successfully wrote the metadata file
+
+NOTES:
+  1. If the XML file specified already exists, it will be overwritten.
+  2. Use this routine to create a new metadata file.  To append bands to an
+     existing metadata file, use append_metadata.
+  3. It is recommended that validate_meta be used after writing the XML file
+     to make sure the new file is valid against the ESPA schema.
+******************************************************************************/
+int write_metadata
+(
+    Espa_internal_meta_t *metadata,  /* I: input metadata structure to be
+                                           written to XML */
+    char *xml_file                   /* I: name of the XML metadata file to
+                                           be written to or overwritten */
+)
+{
+    char FUNC_NAME[] = "write_metadata";       /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    char *xml_buf = NULL;    /* XML document rendered in memory */
+    size_t xml_len = 0;      /* length of the rendered XML document */
+
+    /* Render the document in memory and publish it as the XML file once it
+       is complete */
+    if (render_metadata (metadata, &xml_buf, &xml_len) != SUCCESS)
+    {
+        sprintf (errmsg, "Rendering the XML document for %s", xml_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    if (publish_xml_buffer (xml_file, xml_buf, xml_len) != SUCCESS)
+    {
+        sprintf (errmsg, "Writing the XML metadata file %s", xml_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        free (xml_buf);
+        return (ERROR);
+    }
+    free (xml_buf);
+
+    /* Update the binary metadata cache for the new XML file.  The XML file
+       itself is fine, so a cache which can't be written is only a warning. */
+    if (use_metadata_cache () && refresh_metadata_cache (xml_file) != SUCCESS)
+    {
+        sprintf (errmsg, "Continuing without a metadata cache for %s",
+            xml_file);
+        error_handler (false, FUNC_NAME, errmsg);
+    }
 
     /* Successful generation */
     return (SUCCESS);
 }
 
 
+/******************************************************************************
+MODULE:  find_closing_bands
+
+PURPOSE: Finds the closing </bands> line at the end of the XML file.
+
+RETURN VALUE:
+Type = bool
+Value           Description
+-----           -----------
+false           The XML file doesn't end with the </bands> and
+                </espa_metadata> closing elements
+true            Found the closing elements
+
+NOTES:
+  1. Only the tail of the XML file is read.
+******************************************************************************/
+static bool find_closing_bands
+(
+    int fd,                   /* I: file descriptor of the XML file */
+    off_t *offset             /* O: offset of the start of the </bands> line */
+)
+{
+    char tail[MAX_LINE_SIZE]; /* tail of the XML file */
+    char *cur_ptr = NULL;     /* current position in the tail */
+    char *bands_ptr = NULL;   /* </bands> element in the tail */
+    struct stat statbuf;      /* status of the XML file */
+    ssize_t ntail;            /* number of bytes in the tail */
+
+    if (fstat (fd, &statbuf) == -1)
+        return (false);
+    ntail = statbuf.st_size < (off_t) sizeof (tail) - 1 ?
+        (ssize_t) statbuf.st_size : (ssize_t) sizeof (tail) - 1;
+    if (pread (fd, tail, ntail, statbuf.st_size - ntail) != ntail)
+        return (false);
+    tail[ntail] = '\0';
+
+    /* Find the last </bands>, which must be followed by nothing but the
+       closing </espa_metadata> and white space */
+    for (cur_ptr = tail; (cur_ptr = strstr (cur_ptr, "</bands>")) != NULL;
+        cur_ptr++)
+        bands_ptr = cur_ptr;
+    if (bands_ptr == NULL)
+        return (false);
+    cur_ptr = bands_ptr + strlen ("</bands>");
+    cur_ptr += strspn (cur_ptr, " \t\r\n");
+    if (strncmp (cur_ptr, "</espa_metadata>", strlen ("</espa_metadata>")))
+        return (false);
+    cur_ptr += strlen ("</espa_metadata>");
+    cur_ptr += strspn (cur_ptr, " \t\r\n");
+    if (*cur_ptr != '\0')
+        return (false);
+
+    /* Back up over the indentation to the start of the line */
+    cur_ptr = bands_ptr;
+    while (cur_ptr > tail && (cur_ptr[-1] == ' ' || cur_ptr[-1] == '\t'))
+        cur_ptr--;
+    if (cur_ptr > tail ? cur_ptr[-1] != '\n' : ntail != statbuf.st_size)
+        return (false);
+
+    *offset = statbuf.st_size - ntail + (cur_ptr - tail);
+    return (true);
+}
+
+
+/******************************************************************************
+MODULE:  write_xml_delta
+
+PURPOSE: Writes the XML file up to its closing </bands> line, followed by the
+appended bands and closing elements, to a temporary file alongside the XML
+file, then renames it over the XML file.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing or renaming the temporary file
+SUCCESS         Successfully wrote the appended bands
+
+NOTES:
+  1. The existing content is copied as bytes, without being parsed.
+  2. As for publish_xml_buffer, the temporary file is removed if an error
+     occurs, leaving the XML file untouched.
+******************************************************************************/
+static int write_xml_delta
+(
+    const char *xml_file,     /* I: name of the XML metadata file */
+    int fd,                   /* I: file descriptor of the XML file */
+    off_t offset,             /* I: offset of the closing </bands> line */
+    const char *xml_buf,      /* I: appended bands and closing elements */
+    size_t xml_len            /* I: length of xml_buf */
+)
+{
+    char FUNC_NAME[] = "write_xml_delta";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    char tmp_file[STR_SIZE];  /* name of the XML file while it is written */
+    char copy_buf[65536];     /* buffer copying the existing content */
+    int tmp_fd;               /* file descriptor of the temporary file */
+    int count;                /* number of chars copied in snprintf */
+    int status = SUCCESS;     /* return status */
+    off_t ncopied = 0;        /* number of bytes of the XML file copied */
+    size_t nwritten;          /* number of bytes of xml_buf written */
+    ssize_t nbytes;           /* number of bytes read or written */
+
+    count = snprintf (tmp_file, sizeof (tmp_file), "%s.%ld.tmp", xml_file,
+        (long) getpid ());
+    if (count < 0 || count >= sizeof (tmp_file))
+    {
+        sprintf (errmsg, "Overflow of the temporary XML file name");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    tmp_fd = open (tmp_file, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (tmp_fd == -1)
+    {
+        sprintf (errmsg, "Opening %s for write access.", tmp_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Copy the XML file up to the closing </bands> line */
+    while (ncopied < offset && status == SUCCESS)
+    {
+        nbytes = offset - ncopied < (off_t) sizeof (copy_buf) ?
+            (ssize_t) (offset - ncopied) : (ssize_t) sizeof (copy_buf);
+        nbytes = pread (fd, copy_buf, nbytes, ncopied);
+        if (nbytes < 0 && errno == EINTR)
+            continue;
+        if (nbytes <= 0)
+        {
+            status = ERROR;
+            break;
+        }
+        for (nwritten = 0; nwritten < (size_t) nbytes; )
+        {
+            count = write (tmp_fd, copy_buf + nwritten, nbytes - nwritten);
+            if (count < 0 && errno == EINTR)
+                continue;
+            if (count <= 0)
+            {
+                status = ERROR;
+                break;
+            }
+            nwritten += count;
+        }
+        ncopied += nbytes;
+    }
+
+    /* Then the appended bands and the closing elements */
+    for (nwritten = 0; nwritten < xml_len && status == SUCCESS; )
+    {
+        nbytes = write (tmp_fd, xml_buf + nwritten, xml_len - nwritten);
+        if (nbytes < 0 && errno == EINTR)
+            continue;
+        if (nbytes <= 0)
+            status = ERROR;
+        else
+            nwritten += nbytes;
+    }
+
+    if (close (tmp_fd) != 0 || status != SUCCESS)
+    {
+        sprintf (errmsg, "Writing %s", tmp_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        unlink (tmp_file);
+        return (ERROR);
+    }
+
+    if (rename (tmp_file, xml_file) != 0)
+    {
+        sprintf (errmsg, "Renaming %s to %s", tmp_file, xml_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        unlink (tmp_file);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  rewrite_appended_xml
+
+PURPOSE: Rewrites the XML file with the appended bands and closing elements
+in place of its closing </bands> element.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error reading or writing the XML file
+SUCCESS         Successfully rewrote the XML file
+
+NOTES:
+  1. If the closing </bands> element is not found in the XML file, then the
+     bands will simply be appended at the end of the XML file. This will
+     likely leave an XML file which does not validate against the ESPA
+     schema, but the input XML likely didn't validate either in this case.
+******************************************************************************/
+static int rewrite_appended_xml
+(
+    char *xml_file,           /* I: name of the XML metadata file */
+    const char *band_buf,     /* I: appended bands and closing elements */
+    size_t band_len           /* I: length of band_buf */
+)
+{
+    char FUNC_NAME[] = "rewrite_appended_xml";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    char linebuf[MAX_LINE_SIZE];  /* buffer to hold each line */
+    char *cur_ptr;            /* pointer index in the line buffer */
+    char *xml_buf = NULL;     /* XML document rendered in memory */
+    size_t xml_len = 0;       /* length of the rendered XML document */
+    int status;               /* return status */
+    FILE *in_fptr = NULL;     /* file pointer to the existing XML file */
+    FILE *fptr = NULL;        /* stream rendering the XML document */
+
+    in_fptr = fopen (xml_file, "r");
+    if (in_fptr == NULL)
+    {
+        sprintf (errmsg, "Opening %s for read access.", xml_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    fptr = open_memstream (&xml_buf, &xml_len);
+    if (fptr == NULL)
+    {
+        sprintf (errmsg, "Opening the memory buffer for %s.", xml_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        fclose (in_fptr);
+        return (ERROR);
+    }
+
+    /* Copy the XML file up to the closing </bands> element, then the
+       appended bands */
+    while (fgets (linebuf, MAX_LINE_SIZE, in_fptr))
+    {
+        /* Skip past the front end white space from proper indentation in
+           the metadata file */
+        cur_ptr = linebuf;
+        while (cur_ptr[0] == ' ' || cur_ptr[0] == '\t')
+            cur_ptr++;
+        if (!strncmp (cur_ptr, "</bands>", 8))
+            break;
+
+        fputs (linebuf, fptr);
+    }
+    fclose (in_fptr);
+    fwrite (band_buf, 1, band_len, fptr);
+
+    if (fclose (fptr) != 0 || xml_buf == NULL)
+    {
+        sprintf (errmsg, "Rendering the XML document for %s", xml_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        free (xml_buf);
+        return (ERROR);
+    }
+    status = publish_xml_buffer (xml_file, xml_buf, xml_len);
+    free (xml_buf);
+
+    return (status);
+}
+
+
 /******************************************************************************
 MODULE:  append_metadata
 
@@ -451,7 +968,12 @@ ERROR           Error appending the metadata file
 SUCCESS         Successfully appended to the metadata file
 
 NOTES:
-  1. If the XML file specified already exists, it will be overwritten.
+  1. Only the appended bands are rendered; they replace the closing
+     </bands> and </espa_metadata> elements at the end of the XML file.  The
+     content before them is copied as is to a temporary file, which is
+     renamed over the XML file, so a failed append leaves the XML file
+     untouched.  If the file doesn't end with the closing elements, the
+     document is copied line by line instead.
   2. Use this routine to append bands to and existing metadata file, use
      write_metadata to create a new metadata file.
   3. It is recommended that validate_meta be used after appending to the XML
@@ -470,65 +992,28 @@ int append_metadata
     char errmsg[STR_SIZE];   /* error message */
     char my_dtype[STR_SIZE]; /* data type string */
     char my_rtype[STR_SIZE]; /* resampling type string */
-    char linebuf[MAX_LINE_SIZE];  /* buffer to hold each line */
-    char *cur_ptr;           /* pointer index in the line buffer */
+    char xml_name[STR_SIZE]; /* name of the band file in the document */
+    char *xml_buf = NULL;    /* appended bands and closing elements
+                                rendered in memory */
+    size_t xml_len = 0;      /* length of the rendered XML */
+    size_t band_len;         /* length of the rendered band elements */
+    off_t offset;            /* offset of the closing </bands> line */
     int i, j;                /* looping variables */
-    FILE *fptr = NULL;       /* file pointer to the XML metadata file */
-    fpos_t cur_pos;          /* current position in the file */
-
-    /* Open the metadata XML file for write or rewrite privelages */
-    fptr = fopen (xml_file, "r+");
+    int fd;                  /* file descriptor of the XML file */
+    int status;              /* return status */
+    bool have_cache = false; /* was the previous metadata cache loaded? */
+    FILE *fptr = NULL;       /* stream rendering the appended XML */
+    Espa_internal_meta_t cache_meta;  /* metadata from the previous cache */
+
+    /* Render the appended bands and the closing elements into a growable
+       memory buffer */
+    fptr = open_memstream (&xml_buf, &xml_len);
     if (fptr == NULL)
     {
-        sprintf (errmsg, "Opening %s for write access.", xml_file);
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
-    }
-
-    /* Skip through the XML file looking for the closing </bands> element.
-       That's where we want to append the new bands and then close everything
-       off (i.e. bands and espa_metadata). Note, if the closing </bands>
-       element is not found in the XML file, then the bands will simply be
-       appended at the end of the XML file. This will likely leave an XML
-       file which does not validate against the ESPA schema, but the input
-       XML likely didn't validate either in this case. */
-    if (fgetpos (fptr, &cur_pos) == -1)
-    {
-        sprintf (errmsg, "Getting the current position in the XML fstream.");
+        sprintf (errmsg, "Opening the memory buffer for %s.", xml_file);
         error_handler (true, FUNC_NAME, errmsg);
         return (ERROR);
     }
-    while (fgets (linebuf, MAX_LINE_SIZE, fptr))
-    {
-        /* Skip past the front end white space from proper indentation in
-           the metadata file */
-        cur_ptr = linebuf;
-        while (cur_ptr[0] == ' ' || cur_ptr[0] == '\t')
-            cur_ptr++;
-        if (!strncmp (cur_ptr, "</bands>", 8))
-        {
-            /* </bands> line was found.  Now seek back to the beginning of
-               that line in the file. */
-            if (fsetpos (fptr, &cur_pos) == -1)
-            {
-                sprintf (errmsg, "Setting current position in the XML fstream "
-                    "to the start of the </bands> line.");
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
-            }
-
-            /* Clear the while loop */
-            break;
-        }
-
-        /* Store the location of the current stream so we can get back here */
-        if (fgetpos (fptr, &cur_pos) == -1)
-        {
-            sprintf (errmsg, "Getting current position in the XML fstream.");
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
-    }
 
     /* Append the new bands.  Make sure the optional parameters have been
        specified and are not fill, otherwise don't write them out. */
@@ -578,6 +1063,23 @@ int append_metadata
             fprintf (fptr, " scale_factor=\"%10.8f\"", bmeta[i].scale_factor);
         if (fabs (bmeta[i].add_offset - ESPA_FLOAT_META_FILL) > ESPA_EPSILON)
             fprintf (fptr, " add_offset=\"%f\"", bmeta[i].add_offset);
+        if (is_constant_band (&bmeta[i]))
+            fprintf (fptr, " constant_value=\"%lf\"",
+                bmeta[i].constant_value);
+        if (strcmp (bmeta[i].footprint_file, ESPA_STRING_META_FILL))
+            fprintf (fptr, " footprint_file=\"%s\"",
+                bmeta[i].footprint_file);
+        if (strcmp (bmeta[i].overview_file, ESPA_STRING_META_FILL))
+            fprintf (fptr, " overview_file=\"%s\" overview_levels=\"%d\"",
+                bmeta[i].overview_file, bmeta[i].overview_levels);
+        if (strcmp (bmeta[i].encoding, ESPA_STRING_META_FILL))
+            fprintf (fptr, " encoding=\"%s\"", bmeta[i].encoding);
+        if (bmeta[i].tile_size > 0)
+            fprintf (fptr, " tile_size=\"%d\"", bmeta[i].tile_size);
+        if (bmeta[i].file_offset != 0)
+            fprintf (fptr, " file_offset=\"%ld\"", bmeta[i].file_offset);
+        if (strcmp (bmeta[i].checksum, ESPA_STRING_META_FILL))
+            fprintf (fptr, " checksum=\"%s\"", bmeta[i].checksum);
         fprintf (fptr, ">\n");
 
         fprintf (fptr,
@@ -586,7 +1088,8 @@ int append_metadata
             "            <file_name>%s</file_name>\n"
             "            <pixel_size x=\"%g\" y=\"%g\" units=\"%s\"/>\n"
             "            <resample_method>%s</resample_method>\n",
-            bmeta[i].short_name, bmeta[i].long_name, bmeta[i].file_name,
+            bmeta[i].short_name, bmeta[i].long_name,
+            espa_shm_xml_name (bmeta[i].file_name, xml_name),
             bmeta[i].pixel_size[0], bmeta[i].pixel_size[1],
             bmeta[i].pixel_units, my_rtype);
 
@@ -604,6 +1107,7 @@ int append_metadata
                 "            <valid_range min=\"%f\" max=\"%f\"/>\n",
                 bmeta[i].valid_range[0], bmeta[i].valid_range[1]);
         }
+        write_band_stats (fptr, &bmeta[i].stats);
 
         if (fabs (bmeta[i].rad_gain - ESPA_FLOAT_META_FILL) > ESPA_EPSILON &&
             fabs (bmeta[i].rad_bias - ESPA_FLOAT_META_FILL) > ESPA_EPSILON)
@@ -694,13 +1198,83 @@ int append_metadata
     }
 
     /* Finish it off */
+    fflush (fptr);
+    band_len = xml_len;
     fprintf (fptr,
         "    </bands>\n");
     fprintf (fptr,
         "</espa_metadata>\n");
+    if (fclose (fptr) != 0 || xml_buf == NULL)
+    {
+        sprintf (errmsg, "Rendering the appended bands for %s", xml_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        free (xml_buf);
+        return (ERROR);
+    }
+
+    /* Load the metadata cache before the XML file changes, so only the
+       appended bands need to be parsed to update it */
+    init_metadata_struct (&cache_meta);
+    if (use_metadata_cache ())
+        have_cache = read_metadata_cache (xml_file, false, &cache_meta) ==
+            SUCCESS;
+
+    /* Copy the XML file up to its closing elements, followed by the
+       appended bands, and rename the copy into place.  If the closing
+       elements aren't where append_metadata and write_metadata leave them,
+       copy the document line by line instead.  The staged bands are
+       flushed first, as for publish_xml_buffer. */
+    if (espa_staging_wait () != SUCCESS)
+    {
+        sprintf (errmsg, "Flushing the staged bands of %s", xml_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        free (xml_buf);
+        free_metadata (&cache_meta);
+        return (ERROR);
+    }
+    fd = open (xml_file, O_RDONLY);
+    if (fd == -1)
+    {
+        sprintf (errmsg, "Opening %s for read access.", xml_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        free (xml_buf);
+        free_metadata (&cache_meta);
+        return (ERROR);
+    }
+    if (find_closing_bands (fd, &offset))
+    {
+        status = write_xml_delta (xml_file, fd, offset, xml_buf, xml_len);
+        close (fd);
+    }
+    else
+    {
+        close (fd);
+        have_cache = false;
+        status = rewrite_appended_xml (xml_file, xml_buf, xml_len);
+    }
+    if (status != SUCCESS)
+    {
+        sprintf (errmsg, "Appending the bands to %s", xml_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        free (xml_buf);
+        free_metadata (&cache_meta);
+        return (ERROR);
+    }
 
-    /* Close the XML file */
-    fclose (fptr);
+    /* Update the binary metadata cache for the appended XML file */
+    if (have_cache)
+        status = append_metadata_cache (&cache_meta, xml_file, xml_buf,
+            band_len);
+    else if (use_metadata_cache ())
+        status = refresh_metadata_cache (xml_file);
+    if (status != SUCCESS)
+    {
+        sprintf (errmsg, "Continuing without a metadata cache for %s",
+            xml_file);
+        error_handler (false, FUNC_NAME, errmsg);
+    }
+    free (xml_buf);
+    free_metadata (&cache_meta);
 
     /* Successful append */
     return (SUCCESS);
@@ -834,6 +1408,7 @@ void print_metadata_struct
 
     printf ("  orientation_angle: %f\n",
         metadata->global.orientation_angle);
+    printf ("  footprint: %s\n", metadata->global.footprint);
     printf ("\n");
 
     printf ("INFO Bands Metadata structure:\n");
@@ -863,6 +1438,15 @@ void print_metadata_struct
         printf ("    saturate_value: %d\n", metadata->band[i].saturate_value);
         printf ("    scale_factor: %10.8f\n", metadata->band[i].scale_factor);
         printf ("    add_offset: %f\n", metadata->band[i].add_offset);
+        printf ("    constant_value: %lf\n", metadata->band[i].constant_value);
+        printf ("    footprint_file: %s\n", metadata->band[i].footprint_file);
+        printf ("    overview_file: %s\n", metadata->band[i].overview_file);
+        printf ("    overview_levels: %d\n",
+            metadata->band[i].overview_levels);
+        printf ("    encoding: %s\n", metadata->band[i].encoding);
+        printf ("    tile_size: %d\n", metadata->band[i].tile_size);
+        printf ("    file_offset: %ld\n", metadata->band[i].file_offset);
+        printf ("    checksum: %s\n", metadata->band[i].checksum);
         printf ("    short_name: %s\n", metadata->band[i].short_name);
         printf ("    long_name: %s\n", metadata->band[i].long_name);
         printf ("    file_name: %s\n", metadata->band[i].file_name);
@@ -876,6 +1460,17 @@ void print_metadata_struct
                 metadata->band[i].valid_range[0],
                 metadata->band[i].valid_range[1]);
         }
+        if (metadata->band[i].stats.valid_count != ESPA_INT_META_FILL)
+        {
+            printf ("    statistics valid_count, min, max, mean, stddev : "
+                "%ld %g %g %g %g\n", metadata->band[i].stats.valid_count,
+                metadata->band[i].stats.min, metadata->band[i].stats.max,
+                metadata->band[i].stats.mean, metadata->band[i].stats.stddev);
+            printf ("    histogram bins, min, max : %d %g %g\n",
+                metadata->band[i].stats.nbins,
+                metadata->band[i].stats.hist_min,
+                metadata->band[i].stats.hist_max);
+        }
         if (metadata->band[i].rad_gain != 0 ||
             metadata->band[i].rad_bias != 0)
         {
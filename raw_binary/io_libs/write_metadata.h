@@ -33,6 +33,22 @@ int write_metadata
                                            be written to or overwritten */
 );
 
+int publish_xml_buffer
+(
+    const char *xml_file,     /* I: name of the XML metadata file */
+    const char *xml_buf,      /* I: rendered XML document */
+    size_t xml_len            /* I: length of the rendered XML document */
+);
+
+int render_metadata
+(
+    Espa_internal_meta_t *metadata,  /* I: input metadata structure to be
+                                           rendered as XML */
+    char **xml_doc,                  /* O: XML document; memory is
+                                           allocated */
+    size_t *xml_doc_len              /* O: length of the XML document */
+);
+
 int append_metadata
 (
     int nbands,               /* I: number of bands to be appended */
@@ -47,7 +47,6 @@ double djustify;    /* justify flag in ISG projection               */
 
 	/* Function declarations for function pointer use
 	-----------------------------------------------*/
-long alberfor();
 long merfor();
 long eqconfor();
 long sterfor();
@@ -56,7 +55,6 @@ long azimfor();
 long gnomfor();
 long orthfor();
 long gvnspfor();
-long sinfor();
 long equifor();
 long millfor();
 long vandgfor();
@@ -79,12 +77,14 @@ long isinusfor();
   false_easting  = outparm[6];
   false_northing = outparm[7];
 
-  if ((outsys == HOM)
+  if ((outsys == ALBERS)
+      || (outsys == HOM)
       || (outsys == LAMCC)
       || (outsys == UTM)
       || (outsys == TM)
       || (outsys == POLYC)
       || (outsys == PS)
+      || (outsys == SNSOID)
       || (outsys == SOM)
       || (outsys == SPCS))
     {
@@ -94,27 +94,6 @@ long isinusfor();
     return;
     }
   else
-  if (outsys == ALBERS)
-    {
-    /* this is the call to initialize ALBERS CONICAL EQUAL AREA 
-    ----------------------------------------------------------*/
-    lat1 = paksz(outparm[2],iflg)* 3600 * S2R;
-    if (*iflg != 0)
-       return;
-    lat2 = paksz(outparm[3],iflg)* 3600 * S2R;
-    if (*iflg != 0)
-       return;
-    lat_origin = paksz(outparm[5],iflg)* 3600 * S2R;
-    if (*iflg != 0)
-       return;
-    center_long = paksz(outparm[4],iflg)* 3600 * S2R;
-    if (*iflg != 0)
-       return;
-    *iflg = alberforint(r_major,r_minor,lat1,lat2,center_long,lat_origin,
-		       false_easting, false_northing);
-    for_trans[outsys] = alberfor;
-    }
-  else
   if (outsys == MERCAT)
     {
     /* this is the call to initialize MERCATOR
@@ -246,17 +225,6 @@ long isinusfor();
     for_trans[outsys] = gvnspfor;
     }
   else
-  if (outsys == SNSOID)
-    {
-    /* this is the call to initialize SINUSOIDAL 
-    -------------------------------------------*/
-    center_long = paksz(outparm[4],iflg)* 3600 * S2R;
-    if (*iflg != 0)
-       return;
-    *iflg = sinforint(radius, center_long,false_easting,false_northing);
-    for_trans[outsys] = sinfor;
-    }
-  else
   if (outsys == EQRECT)
     {
     /* this is the call to initialize EQUIRECTANGULAR
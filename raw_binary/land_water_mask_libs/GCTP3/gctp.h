@@ -137,6 +137,18 @@ int gctp_transform
     double * out_coor      /* O: array of (x, y) or (lon, lat) */
 );
 
+/* Routine to transform arrays of coordinates using a transformation set up
+   by gctp_create_transformation.  It stops at the first point that fails. */
+int gctp_transform_array
+(
+    const GCTP_TRANSFORMATION *trans, /* I: transformation to use */
+    int count,             /* I: number of points */
+    const double *in_x,    /* I: array of lon or x values */
+    const double *in_y,    /* I: array of lat or y values */
+    double *out_x,         /* O: array of x or lon values */
+    double *out_y          /* O: array of y or lat values */
+);
+
 typedef enum gctp_message_type_enum
 {
     GCTP_INFO_MESSAGE,
@@ -174,6 +186,13 @@ const GCTP_PROJECTION *gctp_get_output_proj
     const GCTP_TRANSFORMATION *trans
 );
 
+/* Routine to report whether a transformation avoids the original gctp
+   interface, so copies of it can be used from several threads */
+int gctp_is_threadsafe
+(
+    const GCTP_TRANSFORMATION *trans
+);
+
 int gctp_calc_utm_zone
 (
     double lon          /* I: longitude (in degrees) */
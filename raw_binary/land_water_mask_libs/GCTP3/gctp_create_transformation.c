@@ -26,7 +26,7 @@ static INIT_ROUTINE forward_init[GCTP_MAX_PROJ_CODE + 1] =
         gctp_geo_init,         /* 0 = Geographic */
         gctp_utm_forward_init, /* 1 = Universal Transverse Mercator (UTM) */
         gctp_state_plane_forward_init, /* 2 = State Plane Coordinates */
-        NULL,           /* 3 = Albers Conical Equal Area */
+        gctp_albers_forward_init, /* 3 = Albers Conical Equal Area */
         gctp_lamcc_forward_init, /* 4 = Lambert Conformal Conic */
         NULL,           /* 5 = Mercator */
         gctp_ps_forward_init,  /* 6 = Polar Stereographic */
@@ -39,7 +39,7 @@ static INIT_ROUTINE forward_init[GCTP_MAX_PROJ_CODE + 1] =
         NULL,           /* 13 = Gnomonic */
         NULL,           /* 14 = Orthographic */
         NULL,           /* 15 = General Vertical Near-Side Perspective */
-        NULL,           /* 16 = Sinusiodal */
+        gctp_sinusoidal_forward_init, /* 16 = Sinusiodal */
         NULL,           /* 17 = Equirectangular */
         NULL,           /* 18 = Miller Cylindrical */
         NULL,           /* 19 = Van der Grinten */
@@ -64,7 +64,7 @@ static INIT_ROUTINE inverse_init[GCTP_MAX_PROJ_CODE + 1] =
         gctp_geo_init,         /* 0 = Geographic */
         gctp_utm_inverse_init, /* 1 = Universal Transverse Mercator (UTM) */
         gctp_state_plane_inverse_init, /* 2 = State Plane Coordinates */
-        NULL,           /* 3 = Albers Conical Equal Area */
+        gctp_albers_inverse_init, /* 3 = Albers Conical Equal Area */
         gctp_lamcc_inverse_init, /* 4 = Lambert Conformal Conic */
         NULL,           /* 5 = Mercator */
         gctp_ps_inverse_init,  /* 6 = Polar Stereographic */
@@ -77,7 +77,7 @@ static INIT_ROUTINE inverse_init[GCTP_MAX_PROJ_CODE + 1] =
         NULL,           /* 13 = Gnomonic */
         NULL,           /* 14 = Orthographic */
         NULL,           /* 15 = General Vertical Near-Side Perspective */
-        NULL,           /* 16 = Sinusiodal */
+        gctp_sinusoidal_inverse_init, /* 16 = Sinusiodal */
         NULL,           /* 17 = Equirectangular */
         NULL,           /* 18 = Miller Cylindrical */
         NULL,           /* 19 = Van der Grinten */
@@ -198,11 +198,13 @@ GCTP_TRANSFORMATION *gctp_create_transformation
 
     /* default to no forward or inverse transformation routines */
     trans->forward.transform = NULL;
+    trans->forward.transform_array = NULL;
     trans->forward.destroy = NULL;
     trans->forward.cache = NULL;
     trans->forward.print_info = NULL;
 
     trans->inverse.transform = NULL;
+    trans->inverse.transform_array = NULL;
     trans->inverse.destroy = NULL;
     trans->inverse.cache = NULL;
     trans->inverse.print_info = NULL;
@@ -12,6 +12,9 @@ Purpose: Performs a coordinate transformation with the given previously
 #include "local.h"
 #include "cproj.h"
 
+/* Number of points transformed at a time with the array transform functions */
+#define TRANSFORM_CHUNK_SIZE 256
+
 /****************************************************************************
 Name: call_gctp
 
@@ -57,19 +60,22 @@ static int call_gctp
 }
 
 /****************************************************************************
-Name: gctp_transform
+Name: transform_point
 
-Purpose: Performs a coordinate transformation with the given previously
-    created transformation.
+Purpose: Helper routine to perform a transformation of one point with the
+    forward and inverse transform functions of a transformation that doesn't
+    fall back to the old gctp interface.
 
 Returns: GCTP_SUCCESS, GCTP_ERROR or GCTP_IN_BREAK
 
 ****************************************************************************/
-int gctp_transform
+static int transform_point
 (
     const GCTP_TRANSFORMATION *trans, /* I: transformation to use */
-    const double *in_coor, /* I: array of (lon, lat) or (x, y) */
-    double *out_coor       /* O: array of (x, y) or (lon, lat) */
+    double in_x,           /* I: lon or x */
+    double in_y,           /* I: lat or y */
+    double *out_x,         /* O: x or lon */
+    double *out_y          /* O: y or lat */
 )
 {
     double lon;
@@ -77,25 +83,11 @@ int gctp_transform
     double x;
     double y;
 
-    /* Verify the transformation provided is valid */
-    if (!trans)
-    {
-        GCTP_PRINT_ERROR("Invalid transformation provided");
-        return GCTP_ERROR;
-    }
-
-    /* If the use_gctp flag is set, fall back to using gctp */
-    /* TODO - remove this after all the projections have been converted */
-    if (trans->use_gctp)
-    {
-        return call_gctp(trans, in_coor, out_coor);
-    }
-
     /* Convert the input coordinate into the correct units for this
        transformation since the transforms always operate in radians or meters
        and the caller may have provided the coordinate in different units */
-    x = in_coor[0] * trans->inverse.unit_conversion_factor;
-    y = in_coor[1] * trans->inverse.unit_conversion_factor;
+    x = in_x * trans->inverse.unit_conversion_factor;
+    y = in_y * trans->inverse.unit_conversion_factor;
 
     if (trans->inverse.transform)
     {
@@ -123,7 +115,7 @@ int gctp_transform
     if (trans->forward.transform)
     {
         if (trans->forward.transform(&trans->forward, lon, lat,
-                &out_coor[0], &out_coor[1]) != GCTP_SUCCESS)
+                out_x, out_y) != GCTP_SUCCESS)
         {
             GCTP_PRINT_ERROR("Error in forward transformation");
             return GCTP_ERROR;
@@ -132,15 +124,218 @@ int gctp_transform
     else
     {
         /* no forward transform, so copy input to temp */
-        out_coor[0] = lon;
-        out_coor[1] = lat;
+        *out_x = lon;
+        *out_y = lat;
     }
 
     /* Convert the output coordinate into the correct units for this
        transformation since the transforms always operate in radians or meters
        and the caller may have requested different units */
-    out_coor[0] *= trans->forward.unit_conversion_factor;
-    out_coor[1] *= trans->forward.unit_conversion_factor;
+    *out_x *= trans->forward.unit_conversion_factor;
+    *out_y *= trans->forward.unit_conversion_factor;
+
+    return GCTP_SUCCESS;
+}
+
+/****************************************************************************
+Name: transform_chunk
+
+Purpose: Helper routine to perform a transformation of up to
+    TRANSFORM_CHUNK_SIZE points with the forward and inverse array transform
+    functions of a transformation.
+
+Returns: GCTP_SUCCESS or GCTP_ERROR
+
+Notes:
+    - Like transform_point, the points before the first point that fails are
+      transformed and the output of the later points is left unset.
+
+****************************************************************************/
+static int transform_chunk
+(
+    const GCTP_TRANSFORMATION *trans, /* I: transformation to use */
+    int count,             /* I: number of points */
+    const double *in_x,    /* I: array of lon or x values */
+    const double *in_y,    /* I: array of lat or y values */
+    double *out_x,         /* O: array of x or lon values */
+    double *out_y          /* O: array of y or lat values */
+)
+{
+    double x[TRANSFORM_CHUNK_SIZE];
+    double y[TRANSFORM_CHUNK_SIZE];
+    double lon[TRANSFORM_CHUNK_SIZE];
+    double lat[TRANSFORM_CHUNK_SIZE];
+    const double *forward_x = x; /* input to the forward transformation */
+    const double *forward_y = y;
+    int num_inverse = count;    /* number of points inverse transformed */
+    int num_points;             /* number of points transformed */
+    int index;
+
+    /* Convert the input coordinates into the units of the transforms */
+    for (index = 0; index < count; index++)
+    {
+        x[index] = in_x[index] * trans->inverse.unit_conversion_factor;
+        y[index] = in_y[index] * trans->inverse.unit_conversion_factor;
+    }
+
+    if (trans->inverse.transform)
+    {
+        num_inverse = trans->inverse.transform_array(&trans->inverse, count,
+            x, y, lon, lat);
+        forward_x = lon;
+        forward_y = lat;
+    }
+
+    if (trans->forward.transform)
+    {
+        num_points = trans->forward.transform_array(&trans->forward,
+            num_inverse, forward_x, forward_y, out_x, out_y);
+    }
+    else
+    {
+        /* no forward transform, so copy the inverse output */
+        for (index = 0; index < num_inverse; index++)
+        {
+            out_x[index] = forward_x[index];
+            out_y[index] = forward_y[index];
+        }
+        num_points = num_inverse;
+    }
+
+    /* Convert the output coordinates into the requested units */
+    for (index = 0; index < num_points; index++)
+    {
+        out_x[index] *= trans->forward.unit_conversion_factor;
+        out_y[index] *= trans->forward.unit_conversion_factor;
+    }
+
+    if (num_points < num_inverse)
+    {
+        GCTP_PRINT_ERROR("Error in forward transformation");
+        return GCTP_ERROR;
+    }
+    if (num_inverse < count)
+    {
+        GCTP_PRINT_ERROR("Error in inverse transformation");
+        return GCTP_ERROR;
+    }
+
+    return GCTP_SUCCESS;
+}
+
+/****************************************************************************
+Name: gctp_transform
+
+Purpose: Performs a coordinate transformation with the given previously
+    created transformation.
+
+Returns: GCTP_SUCCESS, GCTP_ERROR or GCTP_IN_BREAK
+
+****************************************************************************/
+int gctp_transform
+(
+    const GCTP_TRANSFORMATION *trans, /* I: transformation to use */
+    const double *in_coor, /* I: array of (lon, lat) or (x, y) */
+    double *out_coor       /* O: array of (x, y) or (lon, lat) */
+)
+{
+    /* Verify the transformation provided is valid */
+    if (!trans)
+    {
+        GCTP_PRINT_ERROR("Invalid transformation provided");
+        return GCTP_ERROR;
+    }
+
+    /* If the use_gctp flag is set, fall back to using gctp */
+    /* TODO - remove this after all the projections have been converted */
+    if (trans->use_gctp)
+    {
+        return call_gctp(trans, in_coor, out_coor);
+    }
+
+    return transform_point(trans, in_coor[0], in_coor[1], &out_coor[0],
+        &out_coor[1]);
+}
+
+/****************************************************************************
+Name: gctp_transform_array
+
+Purpose: Performs a coordinate transformation of an array of points with the
+    given previously created transformation.  The coordinates are passed as
+    separate arrays of x (or lon) and y (or lat) values.
+
+Returns: GCTP_SUCCESS, or the GCTP_ERROR or GCTP_IN_BREAK status of the
+    first point that couldn't be transformed
+
+Notes:
+    - The points are transformed in order and the transformation stops at the
+      first point that fails, leaving the output of the later points unset.
+    - Each point gives the same result as gctp_transform.
+    - When both projections provide array transform functions, the points
+      are transformed in chunks to avoid the per point overhead.
+
+****************************************************************************/
+int gctp_transform_array
+(
+    const GCTP_TRANSFORMATION *trans, /* I: transformation to use */
+    int count,             /* I: number of points */
+    const double *in_x,    /* I: array of lon or x values */
+    const double *in_y,    /* I: array of lat or y values */
+    double *out_x,         /* O: array of x or lon values */
+    double *out_y          /* O: array of y or lat values */
+)
+{
+    int index;
+    int status;
+
+    /* Verify the transformation provided is valid */
+    if (!trans)
+    {
+        GCTP_PRINT_ERROR("Invalid transformation provided");
+        return GCTP_ERROR;
+    }
+
+    /* Use the array transform functions if both projections have them */
+    if (!trans->use_gctp
+        && (!trans->inverse.transform || trans->inverse.transform_array)
+        && (!trans->forward.transform || trans->forward.transform_array))
+    {
+        for (index = 0; index < count; index += TRANSFORM_CHUNK_SIZE)
+        {
+            int chunk_size = count - index;
+
+            if (chunk_size > TRANSFORM_CHUNK_SIZE)
+                chunk_size = TRANSFORM_CHUNK_SIZE;
+            status = transform_chunk(trans, chunk_size, &in_x[index],
+                &in_y[index], &out_x[index], &out_y[index]);
+            if (status != GCTP_SUCCESS)
+                return status;
+        }
+        return GCTP_SUCCESS;
+    }
+
+    for (index = 0; index < count; index++)
+    {
+        /* If the use_gctp flag is set, fall back to using gctp */
+        if (trans->use_gctp)
+        {
+            double in_coor[2];
+            double out_coor[2];
+
+            in_coor[0] = in_x[index];
+            in_coor[1] = in_y[index];
+            status = call_gctp(trans, in_coor, out_coor);
+            out_x[index] = out_coor[0];
+            out_y[index] = out_coor[1];
+        }
+        else
+        {
+            status = transform_point(trans, in_x[index], in_y[index],
+                &out_x[index], &out_y[index]);
+        }
+        if (status != GCTP_SUCCESS)
+            return status;
+    }
 
     return GCTP_SUCCESS;
 }
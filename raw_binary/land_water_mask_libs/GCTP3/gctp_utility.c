@@ -72,6 +72,25 @@ const GCTP_PROJECTION *gctp_get_output_proj
     return &trans->forward.proj;
 }
 
+/******************************************************************************
+Name: gctp_is_threadsafe
+
+Purpose: Reports whether a transformation can be used from several threads,
+    each with its own transformation.  Transformations falling back to the
+    original gctp interface share its global state and cannot.
+
+Returns:
+    1 if the transformation is threadsafe, 0 otherwise
+
+******************************************************************************/
+int gctp_is_threadsafe
+(
+    const GCTP_TRANSFORMATION *trans
+)
+{
+    return !trans->use_gctp;
+}
+
 /******************************************************************************
 Name: gctp_calc_utm_zone
 
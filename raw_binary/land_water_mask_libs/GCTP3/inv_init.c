@@ -47,7 +47,6 @@ double djustify;    /* justify flag in ISG projection               */
 
 	/* Function declarations for inverse function pointer
 	---------------------------------------------------*/
-long alberinv();
 long merinv();
 long eqconinv();
 long sterinv();
@@ -56,7 +55,6 @@ long aziminv();
 long gnominv();
 long orthinv();
 long gvnspinv();
-long sininv();
 long equiinv();
 long millinv();
 long vandginv();
@@ -79,12 +77,14 @@ long isinusinv();
   false_easting  = inparm[6];
   false_northing = inparm[7];
 
-  if ((insys == HOM)
+  if ((insys == ALBERS)
+      || (insys == HOM)
       || (insys == LAMCC)
       || (insys == UTM)
       || (insys == TM)
       || (insys == POLYC)
       || (insys == PS)
+      || (insys == SNSOID)
       || (insys == SOM)
       || (insys == SPCS))
      {
@@ -94,27 +94,6 @@ long isinusinv();
      return;
      }
   else
-  if (insys == ALBERS)
-     {
-     /* this is the call to initialize ALBERS 
-     ---------------------------------------*/
-     lat1 = paksz(inparm[2],iflg) * 3600 * S2R;
-     if (*iflg != 0)
-         return;
-     lat2 = paksz(inparm[3],iflg) * 3600 * S2R;
-     if (*iflg != 0)
-         return;
-     center_long = paksz(inparm[4],iflg) * 3600 * S2R;
-     if (*iflg != 0)
-        return;
-     lat_origin  = paksz(inparm[5],iflg) * 3600 * S2R;
-     if (*iflg != 0)
-        return;
-     *iflg = alberinvint(r_major,r_minor,lat1,lat2,center_long,lat_origin,
-			false_easting, false_northing);
-     inv_trans[insys] = alberinv;
-     }
-  else
   if (insys == MERCAT)
      {
      /* this is the call to initialize MERCATOR
@@ -246,17 +225,6 @@ long isinusinv();
      inv_trans[insys] = gvnspinv;
      }
   else
-  if (insys == SNSOID)
-     {
-     /* this is the call to initialize SINUSOIDAL 
-     --------------------------------------------*/
-     center_long    = paksz(inparm[4],iflg) * 3600 * S2R;
-     if (*iflg != 0)
-        return;
-     *iflg = sininvint(radius, center_long,false_easting,false_northing);
-     inv_trans[insys] = sininv;
-     }
-  else
   if (insys == EQRECT)
      {
      /* this is the call to initialize EQUIRECTANGULAR
@@ -28,12 +28,24 @@ typedef void (*DESTROY_TRANSFORM)(TRANSFORMATION *);
 typedef int (*TRANSFORM_FUNC)(const TRANSFORMATION *trans,
     double in_x, double in_y, double *out_x, double *out_y);
 
+/* Function typedef for a transform function for an array of points.  It
+   gives the same results as the TRANSFORM_FUNC for each point, stops at the
+   first point that fails, and returns the number of points transformed.  It
+   is only provided by projections without break areas, so a point that fails
+   is always an error. */
+typedef int (*TRANSFORM_ARRAY_FUNC)(const TRANSFORMATION *trans, int count,
+    const double *in_x, const double *in_y, double *out_x, double *out_y);
+
 /* Define a structure for tracking the information for a transformation.  The
    same structure works for both forward and inverse transformations. */
 struct transformation
 {
     GCTP_PROJECTION proj;     /* projection information */
     TRANSFORM_FUNC transform; /* function pointer for the transform function */
+    TRANSFORM_ARRAY_FUNC transform_array; /* function pointer for the array
+                                  transform function.  Optional, since the
+                                  transform function is used for each point
+                                  if it is NULL. */
     DESTROY_TRANSFORM destroy; /* Function pointer to clean up the
                                   transformation.  Note that most projections
                                   can leave this at the default NULL. */
@@ -85,6 +97,10 @@ void gctp_print_message
 /*********** Internal routines for initializing projections ***************/
 int gctp_geo_init(TRANSFORMATION *trans);
 
+int gctp_albers_inverse_init(TRANSFORMATION *trans);
+
+int gctp_albers_forward_init(TRANSFORMATION *trans);
+
 int gctp_lamcc_inverse_init(TRANSFORMATION *trans);
 
 int gctp_lamcc_forward_init(TRANSFORMATION *trans);
@@ -101,6 +117,10 @@ int gctp_ps_inverse_init(TRANSFORMATION *trans);
 
 int gctp_ps_forward_init(TRANSFORMATION *trans);
 
+int gctp_sinusoidal_inverse_init(TRANSFORMATION *trans);
+
+int gctp_sinusoidal_forward_init(TRANSFORMATION *trans);
+
 int gctp_state_plane_inverse_init(TRANSFORMATION *trans);
 
 int gctp_state_plane_forward_init(TRANSFORMATION *trans);
@@ -240,6 +240,70 @@ static int forward_transform
 }
 
 
+/*****************************************************************************
+Name: inverse_transform_array
+
+Purpose: Transforms an array of X,Y to lat,long
+
+Returns:
+    the number of points transformed, which is less than count when a point
+    fails to transform
+
+*****************************************************************************/
+static int inverse_transform_array
+(
+    const TRANSFORMATION *trans, /* I: transformation information */
+    int count,          /* I: number of points */
+    const double *x,    /* I: X projection coordinates */
+    const double *y,    /* I: Y projection coordinates */
+    double *lon,        /* O: Longitudes */
+    double *lat         /* O: Latitudes */
+)
+{
+    int index;
+
+    for (index = 0; index < count; index++)
+    {
+        if (inverse_transform(trans, x[index], y[index], &lon[index],
+                &lat[index]) != GCTP_SUCCESS)
+            break;
+    }
+
+    return index;
+}
+
+/*****************************************************************************
+Name: forward_transform_array
+
+Purpose: Transforms an array of lat,long to polar stereographic X,Y
+
+Returns:
+    the number of points transformed, which is less than count when a point
+    fails to transform
+
+*****************************************************************************/
+static int forward_transform_array
+(
+    const TRANSFORMATION *trans, /* I: transformation information */
+    int count,          /* I: number of points */
+    const double *lon,  /* I: Longitudes */
+    const double *lat,  /* I: Latitudes */
+    double *x,          /* O: X projection coordinates */
+    double *y           /* O: Y projection coordinates */
+)
+{
+    int index;
+
+    for (index = 0; index < count; index++)
+    {
+        if (forward_transform(trans, lon[index], lat[index], &x[index],
+                &y[index]) != GCTP_SUCCESS)
+            break;
+    }
+
+    return index;
+}
+
 /*****************************************************************************
 Name: gctp_ps_inverse_init
 
@@ -263,6 +327,7 @@ int gctp_ps_inverse_init
     }
 
     trans->transform = inverse_transform;
+    trans->transform_array = inverse_transform_array;
 
     return GCTP_SUCCESS;
 }
@@ -290,6 +355,7 @@ int gctp_ps_forward_init
     }
 
     trans->transform = forward_transform;
+    trans->transform_array = forward_transform_array;
 
     return GCTP_SUCCESS;
 }
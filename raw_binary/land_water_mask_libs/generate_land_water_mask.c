@@ -19,6 +19,160 @@ NOTES:
 #include <math.h>
 
 #include "generate_land_water_mask.h"
+#include "raw_binary_writer.h"
+#include "espa_trace.h"
+
+/******************************************************************************
+MODULE:  get_lw_mask_max_error
+
+PURPOSE:  Gets the largest error allowed when interpolating the transformation
+of the land/water mask to geographic from LW_MASK_MAX_ERROR_ENV.
+
+RETURN VALUE:
+Type = double
+Value        Description
+-------      -----------
+0.0          Transform every point exactly
+> 0.0        Largest interpolation error, in pixels
+
+NOTES:
+1. An invalid value is reported as a warning, and the mask is transformed
+   exactly.
+******************************************************************************/
+double get_lw_mask_max_error (void)
+{
+    char FUNC_NAME[] = "get_lw_mask_max_error";   /* function name */
+    char errmsg[STR_SIZE];            /* error message */
+    char *env = getenv (LW_MASK_MAX_ERROR_ENV);  /* value of the variable */
+    char *endptr = NULL;              /* end of the parsed value */
+    double max_error;                 /* largest interpolation error */
+
+    if (env == NULL || env[0] == '\0')
+        return (0.0);
+
+    max_error = strtod (env, &endptr);
+    if (*endptr != '\0' || !(max_error >= 0.0))
+    {
+        snprintf (errmsg, sizeof (errmsg), "Invalid %s value %s, the "
+            "land/water mask will be transformed exactly",
+            LW_MASK_MAX_ERROR_ENV, env);
+        error_handler (false, FUNC_NAME, errmsg);
+        return (0.0);
+    }
+
+    return (max_error);
+}
+
+
+/******************************************************************************
+MODULE:  get_scene_projection
+
+PURPOSE:  Sets up the IAS projection of a scene from the projection
+information in its XML metadata.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-------      -----------
+ERROR        The projection or datum is not supported
+SUCCESS      Successful completion
+
+NOTES:
+1. Geographic, UTM, polar stereographic, and Albers projections are
+   supported, with the WGS84, NAD83, and NAD27 datums, along with sinusoidal
+   on the sphere of its radius (no datum).
+******************************************************************************/
+int get_scene_projection
+(
+    const Espa_proj_meta_t *proj_info, /* I: projection information from the
+                                             XML metadata */
+    IAS_PROJECTION *projection         /* O: projection of the scene */
+)
+{
+    char FUNC_NAME[] = "get_scene_projection";   /* function name */
+    char errmsg[STR_SIZE];            /* error message */
+    int i;                            /* looping variable */
+
+    for (i = 0; i < NPROJ_PARAM; i++)
+        projection->parameters[i] = 0.0;
+    projection->zone = 0;
+
+    if (proj_info->proj_type == GCTP_GEO_PROJ)
+    {
+        projection->proj_code = GCTP_GEO_PROJ;
+        projection->zone = NULLZONE;
+        projection->units = DEGREE;
+    }
+    else if (proj_info->proj_type == GCTP_UTM_PROJ)
+    {
+        projection->proj_code = GCTP_UTM_PROJ;
+        projection->units = METER;
+        projection->zone = proj_info->utm_zone;
+    }
+    else if (proj_info->proj_type == GCTP_PS_PROJ)
+    {
+        projection->proj_code = GCTP_PS_PROJ;
+        projection->units = METER;
+        projection->parameters[4] = deg_to_dms (proj_info->longitude_pole);
+        projection->parameters[5] =
+            deg_to_dms (proj_info->latitude_true_scale);
+        projection->parameters[6] = proj_info->false_easting;
+        projection->parameters[7] = proj_info->false_northing;
+    }
+    else if (proj_info->proj_type == GCTP_ALBERS_PROJ)
+    {
+        projection->proj_code = GCTP_ALBERS_PROJ;
+        projection->units = METER;
+        projection->parameters[2] =
+            deg_to_dms (proj_info->standard_parallel1);
+        projection->parameters[3] =
+            deg_to_dms (proj_info->standard_parallel2);
+        projection->parameters[4] = deg_to_dms (proj_info->central_meridian);
+        projection->parameters[5] = deg_to_dms (proj_info->origin_latitude);
+        projection->parameters[6] = proj_info->false_easting;
+        projection->parameters[7] = proj_info->false_northing;
+    }
+    else if (proj_info->proj_type == GCTP_SIN_PROJ)
+    {
+        /* The sphere is given by its radius rather than a spheroid */
+        projection->proj_code = GCTP_SIN_PROJ;
+        projection->units = METER;
+        projection->spheroid = -1;
+        projection->parameters[0] = proj_info->sphere_radius;
+        projection->parameters[4] = deg_to_dms (proj_info->central_meridian);
+        projection->parameters[6] = proj_info->false_easting;
+        projection->parameters[7] = proj_info->false_northing;
+        return (SUCCESS);
+    }
+    else
+    {
+        sprintf (errmsg, "Unsupported projection type %d.  Only GEO, UTM, PS, "
+            "ALBERS, and SIN are supported.", proj_info->proj_type);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    switch (proj_info->datum_type)
+    {
+        case (ESPA_WGS84):
+            projection->spheroid = SPHERE_WGS84;
+            break;
+        case (ESPA_NAD83):
+            projection->spheroid = SPHERE_GRS80;
+            break;
+        case (ESPA_NAD27):
+            projection->spheroid = SPHERE_CLARKE_1866;
+            break;
+        default:
+            sprintf (errmsg, "Unsupported datum type %d.  Only WGS84, NAD83, "
+                "and NAD27 are supported.", proj_info->datum_type);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
 
 /******************************************************************************
 MODULE:  generate_land_water_mask
@@ -36,13 +190,34 @@ SUCCESS      Successful completion
 
 NOTES:
 1. Memory for the land water mask will be allocated for the entire image
-   (nlines x nsamps x sizeof (unsigned char)).  It is up to the calling routine
-   to free this memory.
+   (nlines x nsamps x sizeof (unsigned char)), or nlines x
+   RB_BITPACKED_LINE_BYTES(nsamps) when the mask is packed.  It is up to the
+   calling routine to free this memory.
+2. The land mass polygon file is opened by the caller with
+   ias_geo_open_polygon_store, so it can be shared by several scenes.
+3. If LW_MASK_MAX_ERROR_ENV is set, the scene points are transformed to
+   geographic by interpolating inside a coarse grid of exactly transformed
+   points, wherever the grid is within that many pixels of the exact
+   transformation.
+4. The polygons are loaded from the coarsest level of detail of the polygon
+   file whose vertices are within half a pixel of the full polygons, so
+   coarse scenes don't pay for full-detail coastlines.
+5. With a footprint index, the mask is only computed (polygons tested and
+   points projected) inside the valid extent of each line.  The fill outside
+   it is left as the zeros (water) the mask is allocated with, so the mask
+   there is meaningless.  An index not matching the lines of band 1 is
+   ignored.
 ******************************************************************************/
 int generate_land_water_mask
 (
     Espa_internal_meta_t *xml_meta,   /* I: input XML metadata */
-    const char land_mass_polygon[],   /* I: name of land mass polygon file */
+    const IAS_POLYGON_STORE *land_mass_store, /* I: opened land mass polygon
+                                                  file */
+    bool packed,                      /* I: pack the mask to one bit per
+                                            pixel? */
+    const Espa_footprint_t *footprint, /* I: footprint index of band 1, so
+                                            only the valid data is masked;
+                                            NULL masks every pixel */
     unsigned char **land_water_mask,  /* O: pointer to land water mask buffer,
                                             memory is allocated and the
                                             mask is populated */
@@ -52,8 +227,7 @@ int generate_land_water_mask
 {
     char FUNC_NAME[] = "generate_land_water_mask";   /* function name */
     char errmsg[STR_SIZE];            /* error message */
-    int i;                            /* looping variable */
-    int refl_indx = -9;               /* band index in XML file for the
+    int refl_indx;                    /* band index in XML file for the
                                          representative reflectance band */
     double upper_left_x;              /* upper left X coordinate */
     double upper_left_y;              /* upper left Y coordinate */
@@ -63,20 +237,14 @@ int generate_land_water_mask
                                       /* pointer to global metadata structure */
     IAS_IMAGE mask_image;             /* image data used to build mask */
     IAS_PROJECTION mask_projection;   /* projection data */
+    IAS_GEO_SHAPE_MASK_OPTIONS mask_options; /* options for the mask */
+    ESPA_TRACE_SCOPE (trace, "mask_generate", NULL);  /* timing */
 
     /* Use band 1 as the representative band in the XML */
-    for (i = 0; i < xml_meta->nbands; i++)
-    {
-        if (!strcmp (xml_meta->band[i].name, "b1"))
-        {
-            /* this is the index we'll use for reflectance band info */
-            refl_indx = i;
-            break;
-        }
-    }
+    refl_indx = espa_find_band (xml_meta, "b1");
 
     /* Make sure the representative band was found in the XML file */
-    if (refl_indx == -9)
+    if (refl_indx < 0)
     {
         sprintf (errmsg, "Band 1 (b1) was not found in the XML file");
         error_handler (true, FUNC_NAME, errmsg);
@@ -130,58 +298,10 @@ int generate_land_water_mask
     *nsamps = xml_meta->band[refl_indx].nsamps;
 
     /* Set the projection contents based on info from the XML */
-    for (i = 0; i < NPROJ_PARAM; i++)
-        mask_projection.parameters[i] = 0.0;
-
-    if (gmeta->proj_info.proj_type == GCTP_UTM_PROJ)
-    {
-        mask_projection.proj_code = GCTP_UTM_PROJ;
-        mask_projection.units = METER;
-        mask_projection.zone = gmeta->proj_info.utm_zone;
-    }
-    else if (gmeta->proj_info.proj_type == GCTP_PS_PROJ)
-    {
-        mask_projection.proj_code = GCTP_PS_PROJ;
-        mask_projection.units = METER;
-        mask_projection.parameters[4] =
-            deg_to_dms (gmeta->proj_info.longitude_pole);
-        mask_projection.parameters[5] =
-            deg_to_dms (gmeta->proj_info.latitude_true_scale);
-        mask_projection.parameters[6] = gmeta->proj_info.false_easting;
-        mask_projection.parameters[7] = gmeta->proj_info.false_northing;
-    }
-    else if (gmeta->proj_info.proj_type == GCTP_ALBERS_PROJ)
-    {
-        mask_projection.proj_code = GCTP_ALBERS_PROJ;
-        mask_projection.units = METER;
-        mask_projection.parameters[2] =
-            deg_to_dms (gmeta->proj_info.standard_parallel1);
-        mask_projection.parameters[3] =
-            deg_to_dms (gmeta->proj_info.standard_parallel2);
-        mask_projection.parameters[4] =
-            deg_to_dms (gmeta->proj_info.central_meridian);
-        mask_projection.parameters[5] =
-            deg_to_dms (gmeta->proj_info.origin_latitude);
-        mask_projection.parameters[6] = gmeta->proj_info.false_easting;
-        mask_projection.parameters[7] = gmeta->proj_info.false_northing;
-    }
-
-    switch (gmeta->proj_info.datum_type)
-    {
-        case (ESPA_WGS84):
-            mask_projection.spheroid = SPHERE_WGS84;
-            break;
-        case (ESPA_NAD83):
-            mask_projection.spheroid = SPHERE_GRS80;
-            break;
-        case (ESPA_NAD27):
-            mask_projection.spheroid = SPHERE_CLARKE_1866;
-            break;
-        case (ESPA_NODATUM):
-            sprintf (errmsg, "ESPA_NODATUM is not supported for converting "
-                "the land/water polygon to the frame of the current scene.");
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
+    if (get_scene_projection (&gmeta->proj_info, &mask_projection)
+        != SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
     }
 
     /* Write some summary information */
@@ -207,8 +327,12 @@ int generate_land_water_mask
     printf("          units = %d\n", mask_projection.units);
 
     /* Allocate memory for the land/water mask and initialize to all zeros */
-    *land_water_mask = calloc (mask_image.nl * mask_image.ns,
-        sizeof (unsigned char));
+    if (packed)
+        *land_water_mask = calloc (mask_image.nl,
+            RB_BITPACKED_LINE_BYTES (mask_image.ns));
+    else
+        *land_water_mask = calloc ((size_t) mask_image.nl * mask_image.ns,
+            sizeof (unsigned char));
     if (*land_water_mask == NULL)
     {
         sprintf (errmsg, "Error allocating memory for the land/water mask.");
@@ -218,11 +342,320 @@ int generate_land_water_mask
 
     /* Use the land-mass polygon to generate a land/water mask for this
        scene */
-    if (ias_geo_shape_mask_projection(land_mass_polygon, &mask_image,
-        &mask_projection, *land_water_mask) != SUCCESS)
+    mask_options.packed = packed;
+    mask_options.max_interpolation_error = get_lw_mask_max_error ();
+    mask_options.max_polygon_error = 0.5 * fmin (mask_image.pixel_size_x,
+        mask_image.pixel_size_y) / LW_MASK_METERS_PER_DEGREE;
+    mask_options.line_extent = NULL;
+    if (footprint != NULL && footprint->nlines == mask_image.nl)
+        mask_options.line_extent = footprint->extent;
+    if (ias_geo_shape_mask_projection_options_store (land_mass_store,
+        &mask_image, &mask_projection, &mask_options, *land_water_mask)
+        != SUCCESS)
     {
         sprintf (errmsg, "Creating land and water mask");
         error_handler (true, FUNC_NAME, errmsg);
+        free (*land_water_mask);
+        *land_water_mask = NULL;
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  write_mask_file
+
+PURPOSE:  Writes the land/water mask to its raw binary file in the
+requested encoding.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-------      -----------
+ERROR        Error writing the land/water mask
+SUCCESS      Successful completion
+
+NOTES:
+1. The mask is bit-packed, and is unpacked a line at a time, so the whole
+   mask is never unpacked.
+2. The bit-packed and run-length encoded masks are written as blocks (see
+   raw_binary_blocks.h), so the window reads decode them like any other
+   encoded band.
+******************************************************************************/
+static int write_mask_file
+(
+    char *mask_file,                  /* I: name of the land/water mask file */
+    Lw_mask_format_t format,          /* I: encoding of the mask file */
+    int nlines,                       /* I: number of lines in the mask */
+    int nsamps,                       /* I: number of samples in the mask */
+    unsigned char *land_water_mask    /* I: bit-packed land/water mask */
+)
+{
+    char FUNC_NAME[] = "write_mask_file";  /* function name */
+    char errmsg[STR_SIZE];       /* error message */
+    size_t line_bytes = RB_BITPACKED_LINE_BYTES (nsamps);
+                                 /* number of bytes in a packed line */
+    unsigned char *line_mask = NULL; /* one unpacked line of the mask */
+    int line;                    /* looping variable for the lines */
+    int status = SUCCESS;        /* status of the mask write */
+    Raw_binary_encoding_t encoding;  /* encoding of the mask file */
+    Raw_binary_writer_t *writer = NULL;  /* writer of the mask file */
+    ESPA_TRACE_SCOPE (trace, "mask_write", NULL);  /* timing */
+
+    if (format == LW_MASK_BITPACKED)
+        encoding = RB_ENCODING_BITPACKED_BLOCKS;
+    else if (format == LW_MASK_RLE)
+        encoding = RB_ENCODING_RLE_BLOCKS;
+    else
+        encoding = RB_ENCODING_RAW;
+
+    line_mask = malloc (nsamps + 1);
+    if (line_mask == NULL)
+    {
+        sprintf (errmsg, "Allocating memory for a line of the land/water "
+            "mask");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    writer = open_encoded_raw_binary_writer (mask_file, encoding, nlines,
+        nsamps, sizeof (unsigned char), 0);
+    if (writer == NULL)
+    {
+        sprintf (errmsg, "Unable to open the land/water mask file %s",
+            mask_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        free (line_mask);
+        return (ERROR);
+    }
+
+    for (line = 0; line < nlines && status == SUCCESS; line++)
+    {
+        unpack_raw_binary_bits (nsamps, &land_water_mask[line * line_bytes],
+            line_mask);
+        status = append_raw_binary_writer (writer, 1, nsamps,
+            sizeof (unsigned char), line_mask);
+    }
+
+    if (close_raw_binary_writer (writer) != SUCCESS)
+        status = ERROR;
+    free (line_mask);
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  write_land_water_mask
+
+PURPOSE:  Creates the land/water mask for the scene, writes it to its raw
+binary file along with the ENVI header, and sets up its band metadata.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-------      -----------
+ERROR        Error creating or writing the land/water mask
+SUCCESS      Successful completion
+
+NOTES:
+1. out_bmeta needs to be initialized by allocate_band_metadata or
+   append_band_metadata, and the classes of the mask are allocated from its
+   arena.
+2. The land/water mask filename is the same as band 1 with the _B1.img
+   replaced with _land_water_mask.img.  The bit-packed and run-length
+   encoded masks end in RB_BLOCKS_BITPACKED_EXT and RB_BLOCKS_RLE_EXT
+   instead, and have no ENVI header since ENVI can't describe them.
+3. The band metadata always describes the mask as one uint8 per pixel, and
+   the encoding attribute of the band records a bit-packed or run-length
+   encoded file, which the window reads decode back to one uint8 per pixel.
+   The mask is generated bit-packed whatever the file encoding.
+4. When the cache is used, a mask cached for the same grid is written
+   without generating it, and a generated mask is added to the cache.
+5. The distance to the coast (see land_water_distance.h) is computed from
+   the same mask when dist_bmeta is given, which needs to be initialized the
+   same as out_bmeta.
+6. When band 1 has a footprint index, and the mask is neither cached nor
+   used for the distance to the coast, the mask is only generated inside
+   the footprint and is water in the fill around it.  The cache holds a mask
+   for every scene of its grid, and the distance would find a coast along
+   the edge of the footprint, so both need the mask of the whole grid.
+******************************************************************************/
+int write_land_water_mask
+(
+    Espa_internal_meta_t *xml_meta,   /* I: input XML metadata */
+    const IAS_POLYGON_STORE *land_mass_store, /* I: opened land mass polygon
+                                                  file */
+    const Espa_band_meta_t *bmeta,    /* I: band 1, the representative band */
+    const char *production_date,      /* I: production date of the mask */
+    Lw_mask_format_t format,          /* I: encoding of the mask file */
+    const Lw_mask_cache_t *cache,     /* I: cache of the land/water masks;
+                                            NULL if the cache isn't used */
+    Espa_band_meta_t *out_bmeta,      /* O: band metadata of the mask */
+    Espa_band_meta_t *dist_bmeta      /* O: band metadata of the distance to
+                                            the coast; NULL if it isn't
+                                            written */
+)
+{
+    char FUNC_NAME[] = "write_land_water_mask";  /* function name */
+    char errmsg[STR_SIZE];       /* error message */
+    char tmpstr[STR_SIZE];       /* temporary filename */
+    char *cptr = NULL;           /* character pointer for the '_' in filename */
+    int nlines;                  /* number of lines in the land/water mask */
+    int nsamps;                  /* number of samples in the land/water mask */
+    unsigned char *land_water_mask = NULL;  /* land/water mask buffer */
+    bool cached = false;         /* was the mask read from the cache? */
+    Espa_footprint_t *footprint = NULL;  /* footprint index of band 1 */
+    Envi_header_t envi_hdr;      /* output ENVI header information */
+
+    /* Use the cached land/water mask of this grid if there is one */
+    if (cache != NULL && read_lw_mask_cache (cache, xml_meta, bmeta,
+        &land_water_mask) == SUCCESS)
+    {
+        printf ("Using the cached land/water mask\n");
+        cached = true;
+        nlines = bmeta->nlines;
+        nsamps = bmeta->nsamps;
+    }
+
+    /* Otherwise generate the land/water mask for this scene, only inside
+       its footprint if the whole grid isn't needed. Memory is allocated for
+       the land/water mask. */
+    else
+    {
+        if (cache == NULL && dist_bmeta == NULL)
+            footprint = read_footprint (bmeta);
+        if (generate_land_water_mask (xml_meta, land_mass_store, true,
+            footprint, &land_water_mask, &nlines, &nsamps) != SUCCESS)
+        {  /* Error messages already written */
+            free_footprint (footprint);
+            return (ERROR);
+        }
+        free_footprint (footprint);
+    }
+
+    /* Make sure the band 1 number of lines and samples matches what was used
+       for creating the land/water mask, otherwise we will have a mismatch
+       in the resolution and output XML information. */
+    if (nlines != bmeta->nlines || nsamps != bmeta->nsamps)
+    {
+        sprintf (errmsg, "Band 1 from the caller does not match band 1 "
+            "from the generate_land_water_mask function call.  Local nlines/"
+            "nsamps: %d, %d   Returned nlines/nsamps: %d, %d", bmeta->nlines,
+            bmeta->nsamps, nlines, nsamps);
+        error_handler (true, FUNC_NAME, errmsg);
+        free (land_water_mask);
+        return (ERROR);
+    }
+
+    /* Add a newly generated mask to the cache.  The mask is still written
+       if it can't be cached. */
+    if (cache != NULL && !cached && write_lw_mask_cache (cache, xml_meta,
+        bmeta, land_water_mask) != SUCCESS)
+    {
+        sprintf (errmsg, "Unable to cache the land/water mask, continuing");
+        error_handler (false, FUNC_NAME, errmsg);
+    }
+
+    /* Set up the band metadata for the land/water mask */
+    strcpy (out_bmeta->product, "intermediate_data");
+    strcpy (out_bmeta->source, "level1");
+    strcpy (out_bmeta->name, "land_water_mask");
+    strcpy (out_bmeta->category, "qa");
+    out_bmeta->data_type = ESPA_UINT8;
+    out_bmeta->nlines = nlines;
+    out_bmeta->nsamps = nsamps;
+    strncpy (tmpstr, bmeta->short_name, 4);
+    tmpstr[4] = '\0';
+    sprintf (out_bmeta->short_name, "%sLWMASK", tmpstr);
+    strcpy (out_bmeta->long_name, "static land/water mask");
+    out_bmeta->pixel_size[0] = bmeta->pixel_size[0];
+    out_bmeta->pixel_size[1] = bmeta->pixel_size[1];
+    strcpy (out_bmeta->pixel_units, bmeta->pixel_units);
+    strcpy (out_bmeta->data_units, "quality/feature classification");
+    out_bmeta->valid_range[0] = 0.0;
+    out_bmeta->valid_range[1] = 1.0;
+    sprintf (out_bmeta->app_version, "create_land_water_mask_%s",
+        ESPA_COMMON_VERSION);
+    strcpy (out_bmeta->production_date, production_date);
+
+    /* Use the band1 filename to create the land/mask filename */
+    strcpy (out_bmeta->file_name, bmeta->file_name);
+    cptr = strrchr (out_bmeta->file_name, '_');
+    if (!cptr)
+    {
+        sprintf (errmsg, "Unable to find the _ in the band 1 filename for "
+            "creating the land/water mask filename.");
+        error_handler (true, FUNC_NAME, errmsg);
+        free (land_water_mask);
+        return (ERROR);
+    }
+    if (format == LW_MASK_BITPACKED)
+    {
+        sprintf (cptr, "_land_water_mask%s", RB_BLOCKS_BITPACKED_EXT);
+        strcpy (out_bmeta->encoding, RB_ENCODING_BITPACKED_NAME);
+    }
+    else if (format == LW_MASK_RLE)
+    {
+        sprintf (cptr, "_land_water_mask%s", RB_BLOCKS_RLE_EXT);
+        strcpy (out_bmeta->encoding, RB_ENCODING_RLE_NAME);
+    }
+    else
+        sprintf (cptr, "_land_water_mask.img");
+
+    /* Set up the 2 classes for land (1) and water (0) */
+    if (allocate_class_metadata (out_bmeta, 2) != SUCCESS)
+    {
+        sprintf (errmsg, "Cannot allocate memory for the classes");
+        error_handler (true, FUNC_NAME, errmsg);
+        free (land_water_mask);
+        return (ERROR);
+    }
+    out_bmeta->class_values[0].class = 0;
+    out_bmeta->class_values[1].class = 1;
+    strcpy (out_bmeta->class_values[0].description, "water");
+    strcpy (out_bmeta->class_values[1].description, "land");
+
+    /* Write the land/water mask file */
+    if (write_mask_file (out_bmeta->file_name, format, nlines, nsamps,
+        land_water_mask) != SUCCESS)
+    {
+        sprintf (errmsg, "Unable to write to the land/water mask file");
+        error_handler (true, FUNC_NAME, errmsg);
+        free (land_water_mask);
+        return (ERROR);
+    }
+
+    /* Write the distance to the coast from the same mask, then free it */
+    if (dist_bmeta != NULL && write_coast_distance (xml_meta, bmeta,
+        production_date, land_water_mask, dist_bmeta) != SUCCESS)
+    {  /* Error messages already written */
+        free (land_water_mask);
+        return (ERROR);
+    }
+    free (land_water_mask);
+
+    /* Only the byte mask can be described by an ENVI header */
+    if (format != LW_MASK_BYTE)
+        return (SUCCESS);
+
+    /* Create the ENVI header for the mask */
+    if (create_envi_struct (out_bmeta, &xml_meta->global, &envi_hdr) !=
+        SUCCESS)
+    {
+        sprintf (errmsg, "Error creating the ENVI header file.");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Write the ENVI header */
+    sprintf (tmpstr, "%s", out_bmeta->file_name);
+    sprintf (&tmpstr[strlen(tmpstr)-3], "hdr");
+    if (write_envi_hdr (tmpstr, &envi_hdr) != SUCCESS)
+    {
+        sprintf (errmsg, "Writing the ENVI header file: %s.", tmpstr);
+        error_handler (true, FUNC_NAME, errmsg);
         return (ERROR);
     }
 
@@ -4,7 +4,13 @@
 /* ESPA Includes */
 #include "error_handler.h"
 #include "espa_metadata.h"
+#include "espa_band_index.h"
 #include "espa_hdf_eos.h"
+#include "raw_binary_io.h"
+#include "envi_header.h"
+#include "land_water_mask_cache.h"
+#include "land_water_distance.h"
+#include "espa_footprint.h"
 
 /* IAS Includes */
 #include "ias_lw_geo.h"
@@ -12,15 +18,49 @@
 
 #define NAME_STRLEN  256
 
+/* Environment variable holding the largest error, in pixels, allowed when
+   interpolating the transformation of the mask to geographic; the mask is
+   transformed exactly when it isn't set */
+#define LW_MASK_MAX_ERROR_ENV "ESPA_LAND_WATER_MASK_MAX_ERROR"
+
+/* Meters in a degree of latitude, or of longitude at the equator; no degree
+   on the ground is longer, so errors in meters converted with it are never
+   underestimated in degrees */
+#define LW_MASK_METERS_PER_DEGREE 111320.0
+
+/* Encoding of the land/water mask file */
+typedef enum {
+    LW_MASK_BYTE,       /* one uint8 per pixel, with an ENVI header */
+    LW_MASK_BITPACKED,  /* one bit per pixel, in RB_ENCODING_BITPACKED_BLOCKS
+                           blocks */
+    LW_MASK_RLE         /* lines run-length encoded, in
+                           RB_ENCODING_RLE_BLOCKS blocks */
+} Lw_mask_format_t;
+
 double deg_to_dms
 (
     double flt_deg   /* I: input decimal degree value */
 );
 
+double get_lw_mask_max_error (void);
+
+int get_scene_projection
+(
+    const Espa_proj_meta_t *proj_info, /* I: projection information from the
+                                             XML metadata */
+    IAS_PROJECTION *projection         /* O: projection of the scene */
+);
+
 int generate_land_water_mask
 (
     Espa_internal_meta_t *xml_meta,   /* I: input XML metadata */
-    const char land_mass_polygon[],   /* I: name of land mass polygon file */
+    const IAS_POLYGON_STORE *land_mass_store, /* I: opened land mass polygon
+                                                  file */
+    bool packed,                      /* I: pack the mask to one bit per
+                                            pixel? */
+    const Espa_footprint_t *footprint, /* I: footprint index of band 1, so
+                                            only the valid data is masked;
+                                            NULL masks every pixel */
     unsigned char **land_water_mask,  /* O: pointer to land water mask buffer,
                                             memory is allocated and the
                                             mask is populated */
@@ -28,4 +68,20 @@ int generate_land_water_mask
     int *nsamps                       /* O: number of samples in the mask */
 );
 
+int write_land_water_mask
+(
+    Espa_internal_meta_t *xml_meta,   /* I: input XML metadata */
+    const IAS_POLYGON_STORE *land_mass_store, /* I: opened land mass polygon
+                                                  file */
+    const Espa_band_meta_t *bmeta,    /* I: band 1, the representative band */
+    const char *production_date,      /* I: production date of the mask */
+    Lw_mask_format_t format,          /* I: encoding of the mask file */
+    const Lw_mask_cache_t *cache,     /* I: cache of the land/water masks;
+                                            NULL if the cache isn't used */
+    Espa_band_meta_t *out_bmeta,      /* O: band metadata of the mask */
+    Espa_band_meta_t *dist_bmeta      /* O: band metadata of the distance to
+                                            the coast; NULL if it isn't
+                                            written */
+);
+
 #endif
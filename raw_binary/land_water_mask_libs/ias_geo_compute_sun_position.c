@@ -0,0 +1,72 @@
+/****************************************************************************
+NAME: ias_geo_compute_sun_position
+
+PURPOSE: Computes the right ascension, declination, and distance of the sun
+    for a Julian date.
+
+RETURN VALUE:   Type = int
+Value    Description
+-----    -----------
+SUCCESS  Successful completion
+ERROR    Operation failed
+
+ALGORITHM DESCRIPTION:
+        Compute the days since the J2000 epoch
+        Compute the mean longitude and mean anomaly of the sun
+        Compute the ecliptic longitude with the equation of center
+        Compute the obliquity of the ecliptic
+        Convert the ecliptic longitude to right ascension and declination
+        Compute the distance from the mean anomaly
+
+NOTES:
+        This is the low precision solar position of the Astronomical Almanac,
+        which is good to 0.01 degrees between 1950 and 2050.  That is well
+        within what is needed for the per-pixel solar angles.
+
+*****************************************************************************/
+#include <math.h>
+#include "ias_const.h"
+#include "ias_logging.h"
+#include "ias_lw_geo.h"
+
+int ias_geo_compute_sun_position
+(
+    double julian_date,          /* I: Julian date on TDT or ET time scale */
+    double *right_ascension_hrs, /* O: Right ascension referred to mean equator
+                                       and equinox of date (hours) */
+    double *declination_deg,     /* O: Declination referred to mean equator and
+                                       equinox of date (degrees) */
+    double *distance_au          /* O: Geocentric distance (AU) */
+)
+{
+    double days;        /* Days since the J2000 epoch */
+    double mean_lon;    /* Mean longitude of the sun (degrees) */
+    double mean_anom;   /* Mean anomaly of the sun (radians) */
+    double ecl_lon;     /* Ecliptic longitude of the sun (radians) */
+    double obliquity;   /* Obliquity of the ecliptic (radians) */
+    double ra;          /* Right ascension (radians) */
+    double d2r = M_PI / 180.0;  /* Degrees to radians */
+
+    if (julian_date <= 0.0)
+    {
+        IAS_LOG_ERROR("Invalid Julian date %f", julian_date);
+        return ERROR;
+    }
+
+    days = julian_date - IAS_EPOCH_2000;
+    mean_lon = fmod (280.460 + 0.9856474 * days, 360.0);
+    mean_anom = fmod (357.528 + 0.9856003 * days, 360.0) * d2r;
+    ecl_lon = (mean_lon + 1.915 * sin (mean_anom)
+        + 0.020 * sin (2.0 * mean_anom)) * d2r;
+    obliquity = (23.439 - 0.0000004 * days) * d2r;
+
+    ra = atan2 (cos (obliquity) * sin (ecl_lon), cos (ecl_lon));
+    if (ra < 0.0)
+        ra += 2.0 * M_PI;
+    *right_ascension_hrs = ra / d2r / 15.0;
+    *declination_deg = asin (sin (obliquity) * sin (ecl_lon)) / d2r;
+    *distance_au = 1.00014 - 0.01671 * cos (mean_anom)
+        - 0.00014 * cos (2.0 * mean_anom);
+
+    return SUCCESS;
+}
@@ -0,0 +1,46 @@
+/****************************************************************************
+NAME: ias_geo_find_ariesha
+
+PURPOSE: Computes the Greenwich hour angle of Aries (the Greenwich mean
+    sidereal time) for a time of day.
+
+RETURNS: void
+
+ALGORITHM DESCRIPTION:
+        Compute the Julian date of the time of day
+        Compute the mean sidereal time at Greenwich from the days and
+          centuries since the J2000 epoch
+        Reduce the angle to 0 to 2 pi radians
+        Return
+
+NOTES:
+        The hour angle is in radians.  UT1 is taken to be UTC, which is off
+        by less than a second of time (about 4 arc seconds).
+
+*****************************************************************************/
+#include <math.h>
+#include "ias_const.h"
+#include "ias_lw_geo.h"
+
+void ias_geo_find_ariesha 
+(
+    double tjd,          /* I: full julian day */
+    double seconds,      /* I: seconds of the day */
+    double *gha          /* O: Greenwich hour angle */
+)
+{
+    double days;         /* Days since the J2000 epoch */
+    double centuries;    /* Julian centuries since the J2000 epoch */
+    double gmst;         /* Greenwich mean sidereal time (degrees) */
+
+    days = tjd + seconds / IAS_SEC_PER_DAY - IAS_EPOCH_2000;
+    centuries = days / IAS_JULIAN_CENTURY;
+    gmst = 280.46061837 + 360.98564736629 * days
+        + 0.000387933 * centuries * centuries
+        - centuries * centuries * centuries / 38710000.0;
+
+    gmst = fmod (gmst, 360.0);
+    if (gmst < 0.0)
+        gmst += 360.0;
+    *gha = gmst * M_PI / 180.0;
+}
@@ -0,0 +1,2979 @@
+/*************************************************************************
+
+NAME: ias_geo_polygon_index
+
+PURPOSE: Defines routines to write and read the spatial index of a polygon
+         file, so a scene only reads the polygon segments near its window
+         instead of every vertex of the polygons that overlap it.
+
+NOTES:
+The index is appended by ias_geo_dump_polygon after the polygons, so readers
+that do not know about it still read the file as before.  It is found from a
+trailer in the last bytes of the file:
+
+  trailer:   magic, version, file offset of the level table
+
+The level table lists the indexes of the polygons at several levels of
+detail, each with the simplification tolerance of its vertices in degrees:
+
+  levels:    number of levels, then the tolerance and the file offset of
+             the index of each level, in increasing tolerance; the first
+             level has a tolerance of zero and holds the polygons as given
+
+(Version 2 files have a single level and the trailer points to its index.)
+Each index starts on an 8-byte boundary and holds, all in native byte order:
+
+  header:    number of polygons, leaves and nodes, and the root node
+  directory: one entry per polygon (parents and children, in the order
+             they are written to the file) with its file offset, store
+             offset, id, parent entry, number of vertices in the file,
+             number of segments and bounding box
+  leaves:    one entry per polygon segment with the directory entry of its
+             polygon and a copy of the segment; a polygon without segments
+             gets a single leaf covering all its vertices
+  nodes:     a packed R-tree over the leaves, bulk loaded with the
+             Sort-Tile-Recursive method; each node holds the bounding box of
+             its children and the range of nodes (or leaves for level 0)
+             below it, and the root is the last node
+  store:     for each directory entry, the x and y vertices including the
+             closing copy of the first vertex, then the segments, laid out
+             as IAS_POLYGON_LINKED_LIST uses them
+
+Every section is a multiple of 8 bytes, so once the file is mapped with
+ias_geo_open_polygon_store the nodes, leaves and store are used in place,
+and the polygons loaded point to their vertices in the mapping instead of
+copies.  The store of the first level duplicates the vertices of the polygon
+records, which are kept for readers without the index.
+
+The simplified levels run the Douglas-Peucker algorithm over each segment
+of each polygon (or over each half of a polygon without segments), so no
+side moves more than the tolerance from the vertices it replaces.  Segment
+end points are kept, and a polygon that would be left with fewer than three
+sides keeps all its vertices.  ias_geo_load_polygon_store_level loads the
+coarsest level within the error a caller can accept.  A polygon whose
+ranges split unevenly searches its long ranges with a tree of the convex
+hulls of its vertices, so the simplification stays near O(n log n) rather
+than O(n^2), and the polygons of all the levels are simplified in parallel.
+
+A point is tested by counting the polygon sides crossed by a ray in +y
+(ias_math_point_in_closed_polygon) or in +x or +y
+(ias_math_point_in_closed_polygon_distance).  For points inside the window
+only the segments reaching the window from above or from the right can be
+crossed, so the loader reads those segments and gives the same answers as
+the whole polygons for any point in the window.
+
+**************************************************************************/
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include "ias_lw_geo.h"
+#include "ias_logging.h"
+#include "ias_const.h"
+#include "espa_metrics.h"
+
+/* Local Defines */
+#define IAS_POLYGON_INDEX_MAGIC 0x58444950   /* "PIDX" in little-endian order */
+#define IAS_POLYGON_INDEX_VERSION 3
+#define IAS_POLYGON_INDEX_SINGLE_LEVEL_VERSION 2 /* Version without the
+                                                    level table */
+#define IAS_POLYGON_INDEX_FANOUT 16          /* Children per R-tree node */
+#define IAS_POLYGON_INDEX_NO_PARENT 0xFFFFFFFF /* Parent of a top level
+                                                  polygon */
+
+/* Simplification tolerances of the levels after the first, in degrees.  The
+   first is about 11 meters, so it serves half of a 30 meter pixel, and the
+   last serves pixels of about 1.5 kilometers. */
+static const double ias_polygon_index_tolerances[] =
+    {1.0e-4, 4.0e-4, 1.6e-3, 6.4e-3};
+#define IAS_POLYGON_INDEX_NUM_LEVELS (1 + sizeof(ias_polygon_index_tolerances)\
+    / sizeof(ias_polygon_index_tolerances[0]))
+
+/* Trailer at the end of an indexed polygon file */
+typedef struct ias_polygon_index_trailer
+{
+    unsigned int magic;         /* IAS_POLYGON_INDEX_MAGIC */
+    unsigned int version;       /* IAS_POLYGON_INDEX_VERSION */
+    int64_t index_offset;       /* File offset of the level table (of the
+                                   index header for version 2) */
+} IAS_POLYGON_INDEX_TRAILER;
+
+/* Header of the level table */
+typedef struct ias_polygon_index_levels
+{
+    unsigned int num_levels;    /* Number of levels of detail */
+    unsigned int reserved;      /* Unused, keeps the size a multiple of 8 */
+} IAS_POLYGON_INDEX_LEVELS;
+
+/* Entry of the level table */
+typedef struct ias_polygon_index_level_entry
+{
+    double tolerance;           /* Simplification tolerance, in degrees */
+    int64_t index_offset;       /* File offset of the index header */
+} IAS_POLYGON_INDEX_LEVEL_ENTRY;
+
+/* Header of the index */
+typedef struct ias_polygon_index_header
+{
+    unsigned int num_polygons;  /* Number of directory entries */
+    unsigned int num_leaves;    /* Number of leaves */
+    unsigned int num_nodes;     /* Number of R-tree nodes */
+    unsigned int root;          /* Index of the root node */
+} IAS_POLYGON_INDEX_HEADER;
+
+/* Directory entry of a polygon */
+typedef struct ias_polygon_index_entry
+{
+    int64_t offset;             /* File offset of the polygon record */
+    int64_t store_offset;       /* File offset of the aligned vertices and
+                                   segments */
+    unsigned int id;            /* Polygon id */
+    unsigned int parent;        /* Directory entry of the parent polygon */
+    unsigned int num_points;    /* Number of vertices in the file (without
+                                   the closing copy of the first point) */
+    unsigned int num_segs;      /* Number of polygon segments */
+    double min_x;               /* Minimum x bounds */
+    double max_x;               /* Maximum x bounds */
+    double min_y;               /* Minimum y bounds */
+    double max_y;               /* Maximum y bounds */
+} IAS_POLYGON_INDEX_ENTRY;
+
+/* Leaf of the R-tree: one polygon segment */
+typedef struct ias_polygon_index_leaf
+{
+    unsigned int polygon;       /* Directory entry of the polygon */
+    IAS_POLYGON_SEGMENT seg;    /* Segment vertex range and bounds */
+} IAS_POLYGON_INDEX_LEAF;
+
+/* Node of the R-tree */
+typedef struct ias_polygon_index_node
+{
+    double min_x;               /* Minimum x bounds of the children */
+    double max_x;               /* Maximum x bounds of the children */
+    double min_y;               /* Minimum y bounds of the children */
+    double max_y;               /* Maximum y bounds of the children */
+    unsigned int first;         /* First child node, or leaf for level 0 */
+    unsigned int count;         /* Number of children */
+    unsigned int level;         /* Level of the node, 0 above the leaves */
+    unsigned int reserved;      /* Unused, keeps the size a multiple of 8 */
+} IAS_POLYGON_INDEX_NODE;
+
+/* Window the polygons are loaded for */
+typedef struct ias_polygon_index_window
+{
+    double min_x;               /* Minimum x value of interest */
+    double max_x;               /* Maximum x value of interest */
+    double min_y;               /* Minimum y value of interest */
+    double max_y;               /* Maximum y value of interest */
+    int wraps;                  /* Flag for a window crossing the +/-180
+                                   degree longitude boundary */
+} IAS_POLYGON_INDEX_WINDOW;
+
+/* Index of one level of detail */
+typedef struct ias_polygon_index_level
+{
+    double tolerance;           /* Simplification tolerance, in degrees */
+    IAS_POLYGON_INDEX_HEADER header; /* Index header */
+    off_t directory_offset;     /* File offset of the directory */
+    off_t leaf_offset;          /* File offset of the leaves */
+    off_t node_offset;          /* File offset of the nodes */
+    off_t store_offset;         /* File offset of the vertex store */
+} IAS_POLYGON_INDEX_LEVEL;
+
+/* Simplification of long ranges of vertices */
+#define IAS_SIMPLIFY_HULL_BUCKET 32     /* Vertices per leaf of a hull tree */
+#define IAS_SIMPLIFY_HULL_MIN_RANGE 1024 /* Shortest range of vertices
+                                           searched with a hull tree */
+#define IAS_SIMPLIFY_HULL_WORK 2        /* Multiple of n log2(n) vertices
+                                           scanned before the hull tree of a
+                                           polygon is built; balanced splits
+                                           scan at most n log2(n) */
+
+/* Convex hulls of the vertices of a polygon, over a segment tree of buckets
+   of IAS_SIMPLIFY_HULL_BUCKET consecutive vertices.  Node 1 is the root, the
+   children of node k are 2k and 2k+1, and the leaves are the nodes from
+   num_leaves.  Each node holds the lower and then the upper chain of its
+   hull, both by increasing x, as vertex indexes in the pool. */
+typedef struct ias_simplify_hull_tree
+{
+    const double *point_x;      /* Polygon vertex x values */
+    const double *point_y;      /* Polygon vertex y values */
+    unsigned int num_leaves;    /* Leaves of the tree, a power of two */
+    size_t *chain_start;        /* Pool offset of the chains of each node */
+    unsigned int *lower_count;  /* Vertices of the lower chain of each node */
+    unsigned int *upper_count;  /* Vertices of the upper chain of each node */
+    unsigned int *pool;         /* Vertex indexes of the chains */
+    size_t pool_size;           /* Vertex indexes in the pool */
+    size_t pool_max;            /* Vertex indexes allocated */
+} IAS_SIMPLIFY_HULL_TREE;
+
+/* Extents of a range of vertices across and along the side replacing it,
+   scaled by the length of the side */
+typedef struct ias_simplify_extent
+{
+    double max_across;          /* Farthest left of the side */
+    double min_across;          /* Farthest right of the side */
+    double min_along;           /* Farthest before the first vertex */
+    double max_along;           /* Farthest along the side */
+    unsigned int max_vertex;    /* Vertex of max_across */
+    unsigned int min_vertex;    /* Vertex of min_across */
+    unsigned int min_along_vertex; /* Vertex of min_along */
+    unsigned int max_along_vertex; /* Vertex of max_along */
+} IAS_SIMPLIFY_EXTENT;
+
+/* Polygon file opened for loading, mapped when it has an index */
+struct ias_polygon_store
+{
+    FILE *fp;                   /* Polygon file pointer */
+    const char *map;            /* Mapped polygon file, or NULL */
+    size_t map_size;            /* Size of the mapping */
+    int indexed;                /* Flag for a file with an index */
+    unsigned int num_levels;    /* Number of levels of detail */
+    IAS_POLYGON_INDEX_LEVEL *levels; /* Levels in increasing tolerance */
+};
+
+/* Polygon file kept open by ias_geo_keep_polygon_store, which opening the
+   same file returns instead of opening it again */
+static IAS_POLYGON_STORE *kept_store = NULL;
+static dev_t kept_dev;              /* Device of the kept polygon file */
+static ino_t kept_ino;              /* Inode of the kept polygon file */
+
+/*****************************************************************************
+NAME:  box_reaches_window
+
+PURPOSE:  Determine whether a bounding box can hold a polygon side crossed by
+          a +x or +y ray from a point in the window.  When the window crosses
+          the +/-180 degree longitude boundary the x bounds are not used.
+
+RETURN VALUE:
+Type = int
+Value    Description
+-----    -----------
+TRUE     The box reaches the window
+FALSE    The box does not reach the window
+
+*****************************************************************************/
+static int box_reaches_window
+(
+    const IAS_POLYGON_INDEX_WINDOW *window, /* I: Window of interest */
+    double min_x,                           /* I: Minimum x bounds of box */
+    double max_x,                           /* I: Maximum x bounds of box */
+    double min_y,                           /* I: Minimum y bounds of box */
+    double max_y                            /* I: Maximum y bounds of box */
+)
+{
+    /* Sides crossed by a +y ray: above the bottom of the window and within
+       its x range */
+    if (max_y >= window->min_y && (window->wraps
+        || (min_x <= window->max_x && max_x >= window->min_x)))
+    {
+        return TRUE;
+    }
+
+    /* Sides crossed by a +x ray: right of the left edge of the window and
+       within its y range */
+    if (min_y <= window->max_y && max_y >= window->min_y
+        && (window->wraps || max_x >= window->min_x))
+    {
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+/*****************************************************************************
+NAME:  compare_leaf_x, compare_leaf_y, compare_node_x, compare_node_y
+
+PURPOSE:  Order leaves and nodes by the center of their bounding boxes for
+          the Sort-Tile-Recursive bulk load.
+
+RETURN VALUE:
+Type = int
+Value    Description
+-----    -----------
+<0,0,>0  Standard qsort ordering
+
+*****************************************************************************/
+static int compare_center
+(
+    double min_a,           /* I: Minimum bound of the first box */
+    double max_a,           /* I: Maximum bound of the first box */
+    double min_b,           /* I: Minimum bound of the second box */
+    double max_b            /* I: Maximum bound of the second box */
+)
+{
+    double center_a = min_a + max_a;
+    double center_b = min_b + max_b;
+
+    if (center_a < center_b)
+        return -1;
+    if (center_a > center_b)
+        return 1;
+    return 0;
+}
+
+static int compare_leaf_x(const void *a, const void *b)
+{
+    const IAS_POLYGON_SEGMENT *seg_a = &((const IAS_POLYGON_INDEX_LEAF *)a)->seg;
+    const IAS_POLYGON_SEGMENT *seg_b = &((const IAS_POLYGON_INDEX_LEAF *)b)->seg;
+
+    return compare_center(seg_a->min_x, seg_a->max_x, seg_b->min_x,
+        seg_b->max_x);
+}
+
+static int compare_leaf_y(const void *a, const void *b)
+{
+    const IAS_POLYGON_SEGMENT *seg_a = &((const IAS_POLYGON_INDEX_LEAF *)a)->seg;
+    const IAS_POLYGON_SEGMENT *seg_b = &((const IAS_POLYGON_INDEX_LEAF *)b)->seg;
+
+    return compare_center(seg_a->min_y, seg_a->max_y, seg_b->min_y,
+        seg_b->max_y);
+}
+
+static int compare_node_x(const void *a, const void *b)
+{
+    const IAS_POLYGON_INDEX_NODE *node_a = a;
+    const IAS_POLYGON_INDEX_NODE *node_b = b;
+
+    return compare_center(node_a->min_x, node_a->max_x, node_b->min_x,
+        node_b->max_x);
+}
+
+static int compare_node_y(const void *a, const void *b)
+{
+    const IAS_POLYGON_INDEX_NODE *node_a = a;
+    const IAS_POLYGON_INDEX_NODE *node_b = b;
+
+    return compare_center(node_a->min_y, node_a->max_y, node_b->min_y,
+        node_b->max_y);
+}
+
+/*****************************************************************************
+NAME:  tile_sort
+
+PURPOSE:  Sort the entries of one R-tree level with the Sort-Tile-Recursive
+          method: by x into vertical slices of whole nodes, then by y within
+          each slice, so consecutive runs of IAS_POLYGON_INDEX_FANOUT entries
+          are spatially compact.
+
+RETURN VALUE: None
+
+*****************************************************************************/
+static void tile_sort
+(
+    void *base,             /* I/O: Entries to sort */
+    unsigned int count,     /* I: Number of entries */
+    size_t size,            /* I: Size of an entry */
+    int (*compare_x)(const void *, const void *), /* I: Order by x */
+    int (*compare_y)(const void *, const void *)  /* I: Order by y */
+)
+{
+    unsigned int num_parents;   /* Number of nodes above the entries */
+    unsigned int slice_size;    /* Number of entries per vertical slice */
+    unsigned int first;         /* First entry of the current slice */
+
+    if (count <= IAS_POLYGON_INDEX_FANOUT)
+        return;
+
+    num_parents = (count + IAS_POLYGON_INDEX_FANOUT - 1)
+        / IAS_POLYGON_INDEX_FANOUT;
+    slice_size = (unsigned int)ceil(sqrt((double)num_parents))
+        * IAS_POLYGON_INDEX_FANOUT;
+
+    qsort(base, count, size, compare_x);
+    for (first = 0; first < count; first += slice_size)
+    {
+        unsigned int slice_count = count - first;
+
+        if (slice_count > slice_size)
+            slice_count = slice_size;
+        qsort((char *)base + (size_t)first * size, slice_count, size,
+            compare_y);
+    }
+}
+
+/*****************************************************************************
+NAME:  count_polygons
+
+PURPOSE:  Count the polygons and the index leaves of a polygon list,
+          including the children.
+
+RETURN VALUE: None
+
+*****************************************************************************/
+static void count_polygons
+(
+    const IAS_POLYGON_LINKED_LIST *polygon, /* I: Polygon linked list */
+    unsigned int *num_polygons,             /* I/O: Polygon counter */
+    unsigned int *num_leaves                /* I/O: Leaf counter */
+)
+{
+    while (polygon)
+    {
+        (*num_polygons)++;
+        *num_leaves += polygon->num_segs > 0 ? polygon->num_segs : 1;
+
+        if (polygon->child)
+            count_polygons(polygon->child, num_polygons, num_leaves);
+
+        polygon = polygon->next;
+    }
+}
+
+/*****************************************************************************
+NAME:  fill_directory
+
+PURPOSE:  Fill the directory entries and the leaves of a polygon list, in the
+          order the polygons are written to the file.
+
+RETURN VALUE:
+Type = int
+Value    Description
+-----    -----------
+SUCCESS  Successful completion
+ERROR    Operation failed
+
+*****************************************************************************/
+static int fill_directory
+(
+    const IAS_POLYGON_LINKED_LIST *polygon, /* I: Polygon linked list */
+    unsigned int parent,          /* I: Directory entry of the parent */
+    unsigned int npolygons,       /* I: Number of polygons (largest id) */
+    const int64_t *offset,        /* I: Polygon offsets, indexed by id */
+    IAS_POLYGON_INDEX_ENTRY *directory, /* O: Directory entries */
+    unsigned int *num_polygons,   /* I/O: Number of entries filled */
+    IAS_POLYGON_INDEX_LEAF *leaves, /* O: Leaves */
+    unsigned int *num_leaves      /* I/O: Number of leaves filled */
+)
+{
+    while (polygon)
+    {
+        unsigned int entry = *num_polygons;
+        IAS_POLYGON_INDEX_ENTRY *dir = &directory[entry];
+        unsigned int seg;
+
+        if (polygon->id == 0 || polygon->id > npolygons)
+        {
+            IAS_LOG_ERROR("Polygon id %d is outside the range 1 to %d",
+                polygon->id, npolygons);
+            return ERROR;
+        }
+
+        dir->offset = offset[polygon->id];
+        dir->id = polygon->id;
+        dir->parent = parent;
+        dir->num_points = polygon->num_points - 1;
+        dir->num_segs = polygon->num_segs;
+        dir->min_x = polygon->min_x;
+        dir->max_x = polygon->max_x;
+        dir->min_y = polygon->min_y;
+        dir->max_y = polygon->max_y;
+        (*num_polygons)++;
+
+        if (polygon->num_segs > 0)
+        {
+            for (seg = 0; seg < polygon->num_segs; seg++)
+            {
+                leaves[*num_leaves].polygon = entry;
+                leaves[*num_leaves].seg = polygon->poly_seg[seg];
+                (*num_leaves)++;
+            }
+        }
+        else
+        {
+            /* Without segments, the whole polygon is a single leaf */
+            IAS_POLYGON_SEGMENT *whole = &leaves[*num_leaves].seg;
+
+            leaves[*num_leaves].polygon = entry;
+            whole->first_point = 0;
+            whole->last_point = polygon->num_points - 1;
+            whole->min_x = polygon->min_x;
+            whole->max_x = polygon->max_x;
+            whole->min_y = polygon->min_y;
+            whole->max_y = polygon->max_y;
+            (*num_leaves)++;
+        }
+
+        if (polygon->child)
+        {
+            if (fill_directory(polygon->child, entry, npolygons, offset,
+                directory, num_polygons, leaves, num_leaves) != SUCCESS)
+            {
+                return ERROR;
+            }
+        }
+
+        polygon = polygon->next;
+    }
+
+    return SUCCESS;
+}
+
+/*****************************************************************************
+NAME:  build_rtree
+
+PURPOSE:  Bulk load a packed R-tree over the leaves.  The leaves are
+          reordered, and the nodes are allocated and returned with the root
+          as the last node.
+
+RETURN VALUE:
+Type = int
+Value    Description
+-----    -----------
+SUCCESS  Successful completion
+ERROR    Operation failed
+
+*****************************************************************************/
+static int build_rtree
+(
+    IAS_POLYGON_INDEX_LEAF *leaves,     /* I/O: Leaves, reordered */
+    unsigned int num_leaves,            /* I: Number of leaves */
+    IAS_POLYGON_INDEX_NODE **nodes,     /* O: Allocated nodes */
+    unsigned int *num_nodes             /* O: Number of nodes */
+)
+{
+    IAS_POLYGON_INDEX_NODE *tree;       /* Nodes of all levels */
+    unsigned int total = 0;             /* Number of nodes of all levels */
+    unsigned int level_count;           /* Number of entries in a level */
+    unsigned int level_first;           /* First node of the level below */
+    unsigned int level;                 /* Current level */
+    unsigned int used;                  /* Number of nodes built */
+
+    *nodes = NULL;
+    *num_nodes = 0;
+    if (num_leaves == 0)
+        return SUCCESS;
+
+    /* Count the nodes of all the levels */
+    level_count = num_leaves;
+    do
+    {
+        level_count = (level_count + IAS_POLYGON_INDEX_FANOUT - 1)
+            / IAS_POLYGON_INDEX_FANOUT;
+        total += level_count;
+    } while (level_count > 1);
+
+    tree = calloc(total, sizeof(IAS_POLYGON_INDEX_NODE));
+    if (tree == NULL)
+    {
+        IAS_LOG_ERROR("Allocating memory for the polygon index nodes");
+        return ERROR;
+    }
+
+    /* Group the leaves into the level 0 nodes */
+    tile_sort(leaves, num_leaves, sizeof(IAS_POLYGON_INDEX_LEAF),
+        compare_leaf_x, compare_leaf_y);
+    used = 0;
+    for (level_first = 0; level_first < num_leaves;
+         level_first += IAS_POLYGON_INDEX_FANOUT)
+    {
+        IAS_POLYGON_INDEX_NODE *node = &tree[used++];
+        unsigned int leaf;
+
+        node->first = level_first;
+        node->count = num_leaves - level_first;
+        if (node->count > IAS_POLYGON_INDEX_FANOUT)
+            node->count = IAS_POLYGON_INDEX_FANOUT;
+        node->level = 0;
+        node->min_x = leaves[level_first].seg.min_x;
+        node->max_x = leaves[level_first].seg.max_x;
+        node->min_y = leaves[level_first].seg.min_y;
+        node->max_y = leaves[level_first].seg.max_y;
+        for (leaf = level_first + 1; leaf < level_first + node->count; leaf++)
+        {
+            const IAS_POLYGON_SEGMENT *seg = &leaves[leaf].seg;
+
+            if (seg->min_x < node->min_x)
+                node->min_x = seg->min_x;
+            if (seg->max_x > node->max_x)
+                node->max_x = seg->max_x;
+            if (seg->min_y < node->min_y)
+                node->min_y = seg->min_y;
+            if (seg->max_y > node->max_y)
+                node->max_y = seg->max_y;
+        }
+    }
+
+    /* Group each level into the next one until a single root is left */
+    level_first = 0;
+    level_count = used;
+    for (level = 1; level_count > 1; level++)
+    {
+        unsigned int child;
+        unsigned int next_first = used;
+
+        tile_sort(&tree[level_first], level_count,
+            sizeof(IAS_POLYGON_INDEX_NODE), compare_node_x, compare_node_y);
+        for (child = level_first; child < level_first + level_count;
+             child += IAS_POLYGON_INDEX_FANOUT)
+        {
+            IAS_POLYGON_INDEX_NODE *node = &tree[used++];
+            unsigned int index;
+
+            node->first = child;
+            node->count = level_first + level_count - child;
+            if (node->count > IAS_POLYGON_INDEX_FANOUT)
+                node->count = IAS_POLYGON_INDEX_FANOUT;
+            node->level = level;
+            node->min_x = tree[child].min_x;
+            node->max_x = tree[child].max_x;
+            node->min_y = tree[child].min_y;
+            node->max_y = tree[child].max_y;
+            for (index = child + 1; index < child + node->count; index++)
+            {
+                if (tree[index].min_x < node->min_x)
+                    node->min_x = tree[index].min_x;
+                if (tree[index].max_x > node->max_x)
+                    node->max_x = tree[index].max_x;
+                if (tree[index].min_y < node->min_y)
+                    node->min_y = tree[index].min_y;
+                if (tree[index].max_y > node->max_y)
+                    node->max_y = tree[index].max_y;
+            }
+        }
+
+        level_first = next_first;
+        level_count = used - next_first;
+    }
+
+    *nodes = tree;
+    *num_nodes = used;
+    return SUCCESS;
+}
+
+/*****************************************************************************
+NAME:  write_polygon_store
+
+PURPOSE:  Write the aligned vertices and segments of a polygon list, in the
+          order of the directory.
+
+RETURN VALUE:
+Type = int
+Value    Description
+-----    -----------
+SUCCESS  Successful completion
+ERROR    Operation failed
+
+*****************************************************************************/
+static int write_polygon_store
+(
+    FILE *fp,                              /* I: File pointer to dump results */
+    const IAS_POLYGON_LINKED_LIST *polygon /* I: Polygon linked list */
+)
+{
+    while (polygon)
+    {
+        if (fwrite(polygon->point_x, sizeof(double), polygon->num_points, fp)
+                != polygon->num_points
+            || fwrite(polygon->point_y, sizeof(double), polygon->num_points,
+                fp) != polygon->num_points
+            || (polygon->num_segs > 0 && fwrite(polygon->poly_seg,
+                sizeof(IAS_POLYGON_SEGMENT), polygon->num_segs, fp)
+                != polygon->num_segs))
+        {
+            IAS_LOG_ERROR("Writing out the vertex store of polygon id %d",
+                polygon->id);
+            return ERROR;
+        }
+
+        if (polygon->child)
+        {
+            if (write_polygon_store(fp, polygon->child) != SUCCESS)
+                return ERROR;
+        }
+
+        polygon = polygon->next;
+    }
+
+    return SUCCESS;
+}
+
+/*****************************************************************************
+NAME:  align_index
+
+PURPOSE:  Pad a polygon file to an 8-byte boundary, so the next section of
+          the index can be used in place when the file is mapped.
+
+RETURN VALUE:
+Type = int
+Value    Description
+-----    -----------
+SUCCESS  Successful completion
+ERROR    Operation failed
+
+*****************************************************************************/
+static int align_index
+(
+    FILE *fp,                   /* I: File pointer to dump results */
+    int64_t *file_offset        /* O: File offset after the padding */
+)
+{
+    static const char zero[8] = {0};       /* Alignment padding */
+    off_t position = ftello(fp);           /* Current file offset */
+
+    if (position < 0)
+    {
+        IAS_LOG_ERROR("Getting the position of the polygon index");
+        return ERROR;
+    }
+    if (position % 8 != 0)
+    {
+        size_t pad = 8 - position % 8;
+
+        if (fwrite(zero, 1, pad, fp) != pad)
+        {
+            IAS_LOG_ERROR("Writing out the polygon index alignment");
+            return ERROR;
+        }
+        position += pad;
+    }
+
+    *file_offset = position;
+    return SUCCESS;
+}
+
+/*****************************************************************************
+NAME:  write_index_level
+
+PURPOSE:  Append the spatial index of one level of detail of a polygon list
+          to a polygon file.
+
+RETURN VALUE:
+Type = int
+Value    Description
+-----    -----------
+SUCCESS  Successful completion
+ERROR    Operation failed
+
+*****************************************************************************/
+static int write_index_level
+(
+    FILE *fp,                              /* I: File pointer to dump results */
+    const IAS_POLYGON_LINKED_LIST *polygon,/* I: Polygon linked list */
+    unsigned int npolygons,                /* I: Number of polygons */
+    const int64_t *offset,                 /* I: Polygon offsets, by id */
+    int64_t *level_offset                  /* O: File offset of the index */
+)
+{
+    IAS_POLYGON_INDEX_HEADER header;       /* Index header */
+    IAS_POLYGON_INDEX_ENTRY *directory;    /* Polygon directory */
+    IAS_POLYGON_INDEX_LEAF *leaves;        /* R-tree leaves */
+    IAS_POLYGON_INDEX_NODE *nodes;         /* R-tree nodes */
+    unsigned int num_polygons = 0;         /* Number of directory entries */
+    unsigned int num_leaves = 0;           /* Number of leaves */
+    unsigned int num_nodes;                /* Number of nodes */
+    unsigned int entry;                    /* Directory entry counter */
+    int64_t index_offset;                  /* File offset of the index */
+    int64_t store_offset;                  /* File offset in the store */
+
+    count_polygons(polygon, &num_polygons, &num_leaves);
+
+    /* Zeroed so the structure padding is written as zeros */
+    directory = calloc(num_polygons + 1, sizeof(IAS_POLYGON_INDEX_ENTRY));
+    leaves = calloc(num_leaves + 1, sizeof(IAS_POLYGON_INDEX_LEAF));
+    if (directory == NULL || leaves == NULL)
+    {
+        IAS_LOG_ERROR("Allocating memory for the polygon index");
+        free(directory);
+        free(leaves);
+        return ERROR;
+    }
+
+    header.num_polygons = 0;
+    header.num_leaves = 0;
+    if (fill_directory(polygon, IAS_POLYGON_INDEX_NO_PARENT, npolygons,
+        offset, directory, &header.num_polygons, leaves, &header.num_leaves)
+        != SUCCESS)
+    {
+        IAS_LOG_ERROR("Building the polygon index directory");
+        free(directory);
+        free(leaves);
+        return ERROR;
+    }
+
+    if (build_rtree(leaves, num_leaves, &nodes, &num_nodes) != SUCCESS)
+    {
+        IAS_LOG_ERROR("Building the polygon index tree");
+        free(directory);
+        free(leaves);
+        return ERROR;
+    }
+    header.num_nodes = num_nodes;
+    header.root = num_nodes > 0 ? num_nodes - 1 : 0;
+
+    /* Start the index on an 8-byte boundary so it can be used in place
+       when the file is mapped */
+    if (align_index(fp, &index_offset) != SUCCESS)
+    {
+        free(directory);
+        free(leaves);
+        free(nodes);
+        return ERROR;
+    }
+
+    /* The store follows the nodes */
+    store_offset = index_offset + sizeof(header)
+        + (int64_t)num_polygons * sizeof(IAS_POLYGON_INDEX_ENTRY)
+        + (int64_t)num_leaves * sizeof(IAS_POLYGON_INDEX_LEAF)
+        + (int64_t)num_nodes * sizeof(IAS_POLYGON_INDEX_NODE);
+    for (entry = 0; entry < num_polygons; entry++)
+    {
+        directory[entry].store_offset = store_offset;
+        store_offset += 2 * (int64_t)(directory[entry].num_points + 1)
+            * sizeof(double) + (int64_t)directory[entry].num_segs
+            * sizeof(IAS_POLYGON_SEGMENT);
+    }
+
+    if (fwrite(&header, sizeof(header), 1, fp) != 1
+        || fwrite(directory, sizeof(IAS_POLYGON_INDEX_ENTRY), num_polygons, fp)
+            != num_polygons
+        || fwrite(leaves, sizeof(IAS_POLYGON_INDEX_LEAF), num_leaves, fp)
+            != num_leaves
+        || fwrite(nodes, sizeof(IAS_POLYGON_INDEX_NODE), num_nodes, fp)
+            != num_nodes)
+    {
+        IAS_LOG_ERROR("Writing out the polygon index");
+        free(directory);
+        free(leaves);
+        free(nodes);
+        return ERROR;
+    }
+    free(directory);
+    free(leaves);
+    free(nodes);
+
+    if (write_polygon_store(fp, polygon) != SUCCESS)
+    {
+        IAS_LOG_ERROR("Writing out the polygon vertex store");
+        return ERROR;
+    }
+
+    *level_offset = index_offset;
+    return SUCCESS;
+}
+
+/*****************************************************************************
+NAME:  hull_before
+
+PURPOSE:  Order two vertices by x, then by y, for the monotone chains.
+
+RETURN VALUE:
+Type = int
+Value    Description
+-----    -----------
+1        The first vertex comes before the second
+0        It does not
+
+*****************************************************************************/
+static int hull_before
+(
+    const double *point_x,      /* I: Polygon vertex x values */
+    const double *point_y,      /* I: Polygon vertex y values */
+    unsigned int a,             /* I: First vertex */
+    unsigned int b              /* I: Second vertex */
+)
+{
+    return point_x[a] < point_x[b]
+        || (point_x[a] == point_x[b] && point_y[a] < point_y[b]);
+}
+
+/*****************************************************************************
+NAME:  append_hull_chain
+
+PURPOSE:  Append the lower or upper chain of the hull of vertices sorted by
+          x to the pool of a hull tree, with Andrew's monotone chain.
+
+RETURN VALUE:
+Type = int
+Value    Description
+-----    -----------
+SUCCESS  Successful completion
+ERROR    Operation failed
+
+*****************************************************************************/
+static int append_hull_chain
+(
+    IAS_SIMPLIFY_HULL_TREE *tree, /* I/O: Hull tree */
+    const unsigned int *sorted, /* I: Vertices, by increasing x then y */
+    unsigned int count,         /* I: Number of vertices */
+    int upper,                  /* I: Flag for the upper chain */
+    unsigned int *chain_count   /* O: Vertices of the chain */
+)
+{
+    const double *x = tree->point_x; /* Vertex x values */
+    const double *y = tree->point_y; /* Vertex y values */
+    unsigned int *chain;        /* Chain being built */
+    unsigned int length = 0;    /* Vertices of the chain */
+    unsigned int point;         /* Vertex loop counter */
+
+    if (tree->pool_size + count > tree->pool_max)
+    {
+        size_t pool_max = 2 * tree->pool_max + count; /* Grown pool size */
+        unsigned int *pool;     /* Grown pool */
+
+        pool = realloc(tree->pool, pool_max * sizeof(*pool));
+        if (pool == NULL)
+        {
+            IAS_LOG_ERROR("Allocating memory for the polygon hulls");
+            return ERROR;
+        }
+        tree->pool = pool;
+        tree->pool_max = pool_max;
+    }
+
+    chain = &tree->pool[tree->pool_size];
+    for (point = 0; point < count; point++)
+    {
+        unsigned int p = sorted[point]; /* Vertex added */
+
+        /* Drop the vertices the new one makes concave (or collinear) */
+        while (length >= 2)
+        {
+            unsigned int o = chain[length - 2]; /* Next to last vertex */
+            unsigned int a = chain[length - 1]; /* Last vertex */
+            double cross = (x[a] - x[o]) * (y[p] - y[o])
+                - (y[a] - y[o]) * (x[p] - x[o]);
+
+            if (upper ? cross < 0.0 : cross > 0.0)
+                break;
+            length--;
+        }
+        chain[length++] = p;
+    }
+
+    tree->pool_size += length;
+    *chain_count = length;
+    return SUCCESS;
+}
+
+/*****************************************************************************
+NAME:  merge_hull_chains
+
+PURPOSE:  Merge the lower or upper chains of the children of a hull tree
+          node, by increasing x then y.
+
+RETURN VALUE: Number of vertices merged
+
+*****************************************************************************/
+static unsigned int merge_hull_chains
+(
+    const IAS_SIMPLIFY_HULL_TREE *tree, /* I: Hull tree */
+    unsigned int node,          /* I: Node whose children are merged */
+    int upper,                  /* I: Flag for the upper chains */
+    unsigned int *merged        /* O: Merged vertices */
+)
+{
+    unsigned int left = 2 * node;       /* Left child */
+    unsigned int right = 2 * node + 1;  /* Right child */
+    const unsigned int *a = &tree->pool[tree->chain_start[left]
+        + (upper ? tree->lower_count[left] : 0)]; /* Left chain */
+    const unsigned int *b = &tree->pool[tree->chain_start[right]
+        + (upper ? tree->lower_count[right] : 0)]; /* Right chain */
+    unsigned int num_a = upper ? tree->upper_count[left]
+        : tree->lower_count[left];      /* Vertices of the left chain */
+    unsigned int num_b = upper ? tree->upper_count[right]
+        : tree->lower_count[right];     /* Vertices of the right chain */
+    unsigned int i = 0, j = 0, count = 0; /* Merge counters */
+
+    while (i < num_a || j < num_b)
+    {
+        if (j == num_b || (i < num_a
+            && hull_before(tree->point_x, tree->point_y, a[i], b[j])))
+        {
+            merged[count++] = a[i++];
+        }
+        else
+        {
+            merged[count++] = b[j++];
+        }
+    }
+
+    return count;
+}
+
+/*****************************************************************************
+NAME:  free_hull_tree
+
+PURPOSE:  Free the memory of a hull tree.
+
+RETURN VALUE: None
+
+*****************************************************************************/
+static void free_hull_tree
+(
+    IAS_SIMPLIFY_HULL_TREE *tree /* I/O: Hull tree */
+)
+{
+    free(tree->chain_start);
+    free(tree->lower_count);
+    free(tree->upper_count);
+    free(tree->pool);
+    memset(tree, 0, sizeof(*tree));
+}
+
+/*****************************************************************************
+NAME:  build_hull_tree
+
+PURPOSE:  Build the hull tree of the vertices of a polygon.  The hull of each
+          node is built from the chains of its children, so the tree takes
+          O(n log n) time at most, and much less for coastlines, whose hulls
+          hold few vertices.
+
+RETURN VALUE:
+Type = int
+Value    Description
+-----    -----------
+SUCCESS  Successful completion
+ERROR    Operation failed
+
+*****************************************************************************/
+static int build_hull_tree
+(
+    const IAS_POLYGON_LINKED_LIST *polygon, /* I: Polygon */
+    IAS_SIMPLIFY_HULL_TREE *tree /* O: Hull tree, freed with free_hull_tree */
+)
+{
+    unsigned int num_points = polygon->num_points; /* Number of vertices */
+    unsigned int num_buckets = (num_points + IAS_SIMPLIFY_HULL_BUCKET - 1)
+        / IAS_SIMPLIFY_HULL_BUCKET;     /* Buckets of vertices */
+    unsigned int *sorted;       /* Vertices of a node, by x then y */
+    unsigned int node;          /* Node loop counter */
+
+    memset(tree, 0, sizeof(*tree));
+    tree->point_x = polygon->point_x;
+    tree->point_y = polygon->point_y;
+    tree->num_leaves = 1;
+    while (tree->num_leaves < num_buckets)
+        tree->num_leaves *= 2;
+
+    tree->chain_start = calloc(2 * (size_t)tree->num_leaves,
+        sizeof(*tree->chain_start));
+    tree->lower_count = calloc(2 * (size_t)tree->num_leaves,
+        sizeof(*tree->lower_count));
+    tree->upper_count = calloc(2 * (size_t)tree->num_leaves,
+        sizeof(*tree->upper_count));
+    sorted = malloc(num_points * sizeof(*sorted));
+    if (tree->chain_start == NULL || tree->lower_count == NULL
+        || tree->upper_count == NULL || sorted == NULL)
+    {
+        IAS_LOG_ERROR("Allocating memory for the polygon hulls");
+        free(sorted);
+        free_hull_tree(tree);
+        return ERROR;
+    }
+
+    /* The leaves sort their bucket of vertices directly */
+    for (node = 0; node < num_buckets; node++)
+    {
+        unsigned int first = node * IAS_SIMPLIFY_HULL_BUCKET; /* First
+                                                   vertex of the bucket */
+        unsigned int count = num_points - first; /* Vertices of the bucket */
+        unsigned int leaf = tree->num_leaves + node; /* Leaf of the bucket */
+        unsigned int point;     /* Vertex loop counter */
+
+        if (count > IAS_SIMPLIFY_HULL_BUCKET)
+            count = IAS_SIMPLIFY_HULL_BUCKET;
+        for (point = 0; point < count; point++)
+        {
+            unsigned int insert = point; /* Place of the vertex */
+
+            while (insert > 0 && hull_before(tree->point_x, tree->point_y,
+                first + point, sorted[insert - 1]))
+            {
+                sorted[insert] = sorted[insert - 1];
+                insert--;
+            }
+            sorted[insert] = first + point;
+        }
+
+        tree->chain_start[leaf] = tree->pool_size;
+        if (append_hull_chain(tree, sorted, count, 0,
+                &tree->lower_count[leaf]) != SUCCESS
+            || append_hull_chain(tree, sorted, count, 1,
+                &tree->upper_count[leaf]) != SUCCESS)
+        {
+            free(sorted);
+            free_hull_tree(tree);
+            return ERROR;
+        }
+    }
+
+    /* Each node merges the chains of its children */
+    for (node = tree->num_leaves - 1; node >= 1; node--)
+    {
+        unsigned int count;     /* Vertices merged */
+
+        tree->chain_start[node] = tree->pool_size;
+        count = merge_hull_chains(tree, node, 0, sorted);
+        if (append_hull_chain(tree, sorted, count, 0,
+            &tree->lower_count[node]) != SUCCESS)
+        {
+            free(sorted);
+            free_hull_tree(tree);
+            return ERROR;
+        }
+        count = merge_hull_chains(tree, node, 1, sorted);
+        if (append_hull_chain(tree, sorted, count, 1,
+            &tree->upper_count[node]) != SUCCESS)
+        {
+            free(sorted);
+            free_hull_tree(tree);
+            return ERROR;
+        }
+    }
+
+    free(sorted);
+    return SUCCESS;
+}
+
+/*****************************************************************************
+NAME:  hull_extreme
+
+PURPOSE:  Find the vertex of the hull of a node farthest in a direction.  The
+          projections onto the direction rise and then fall along the chain
+          facing the direction, so the vertex is found by binary search.
+
+RETURN VALUE: Index of the vertex
+
+*****************************************************************************/
+static unsigned int hull_extreme
+(
+    const IAS_SIMPLIFY_HULL_TREE *tree, /* I: Hull tree */
+    unsigned int node,          /* I: Node, with at least one vertex */
+    double dir_x,               /* I: Direction x component */
+    double dir_y                /* I: Direction y component */
+)
+{
+    const unsigned int *chain = &tree->pool[tree->chain_start[node]];
+                                /* Chain facing the direction */
+    unsigned int low = 0;       /* First vertex searched */
+    unsigned int high;          /* Last vertex searched */
+
+    if (dir_y > 0.0)
+    {
+        chain += tree->lower_count[node];
+        high = tree->upper_count[node] - 1;
+    }
+    else
+    {
+        high = tree->lower_count[node] - 1;
+    }
+
+    while (low < high)
+    {
+        unsigned int mid = (low + high) / 2; /* Vertex tested */
+        unsigned int a = chain[mid];        /* Vertex tested */
+        unsigned int b = chain[mid + 1];    /* Next vertex */
+
+        if ((tree->point_x[b] - tree->point_x[a]) * dir_x
+            + (tree->point_y[b] - tree->point_y[a]) * dir_y > 0.0)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+
+    return chain[low];
+}
+
+/*****************************************************************************
+NAME:  measure_vertex
+
+PURPOSE:  Add a vertex to the extents of a range across and along the side
+          replacing it.
+
+RETURN VALUE: None
+
+*****************************************************************************/
+static void measure_vertex
+(
+    const IAS_SIMPLIFY_HULL_TREE *tree, /* I: Hull tree */
+    unsigned int first,         /* I: First vertex of the side */
+    double dx,                  /* I: Side x extent */
+    double dy,                  /* I: Side y extent */
+    unsigned int point,         /* I: Vertex measured */
+    IAS_SIMPLIFY_EXTENT *extent /* I/O: Extents of the range */
+)
+{
+    double px = tree->point_x[point] - tree->point_x[first]; /* Offset of
+                                           the vertex from the side */
+    double py = tree->point_y[point] - tree->point_y[first];
+    double across = px * dy - py * dx;  /* Scaled distance across */
+    double along = px * dx + py * dy;   /* Scaled distance along */
+
+    if (across > extent->max_across)
+    {
+        extent->max_across = across;
+        extent->max_vertex = point;
+    }
+    if (across < extent->min_across)
+    {
+        extent->min_across = across;
+        extent->min_vertex = point;
+    }
+    if (along < extent->min_along)
+    {
+        extent->min_along = along;
+        extent->min_along_vertex = point;
+    }
+    if (along > extent->max_along)
+    {
+        extent->max_along = along;
+        extent->max_along_vertex = point;
+    }
+}
+
+/*****************************************************************************
+NAME:  hull_find_farthest
+
+PURPOSE:  Find the vertex of a range to split it at, from the extreme
+          vertices across and along the side replacing it.  The nodes
+          covering the range are searched in O(log^2 n) time, and the
+          vertices of the partial buckets at its ends are checked directly.
+
+RETURN VALUE:
+Type = int
+Value    Description
+-----    -----------
+1        A vertex beyond the tolerance was found, or there is none
+0        Vertices project beyond an end of the side and may be farther
+         than the tolerance from it, so the range has to be scanned
+
+NOTES: When every vertex projects onto the side, the vertex found is the
+       farthest from it, as scan_farthest finds.  Otherwise it is the
+       farthest of the extreme vertices, which is beyond the tolerance but
+       may not be the farthest, so the polygon may keep other vertices
+       than a scan would.  Every vertex dropped is still within the
+       tolerance.
+
+*****************************************************************************/
+static int hull_find_farthest
+(
+    const IAS_SIMPLIFY_HULL_TREE *tree, /* I: Hull tree */
+    unsigned int first,         /* I: First vertex of the range, kept */
+    unsigned int last,          /* I: Last vertex of the range, kept */
+    double tolerance,           /* I: Largest distance of a dropped vertex */
+    unsigned int *farthest      /* O: Vertex farthest from the side beyond
+                                      the tolerance, or first for none */
+)
+{
+    const double *x = tree->point_x; /* Vertex x values */
+    const double *y = tree->point_y; /* Vertex y values */
+    double dx = x[last] - x[first]; /* Side x extent */
+    double dy = y[last] - y[first]; /* Side y extent */
+    double length2 = dx * dx + dy * dy; /* Squared side length */
+    double limit = tolerance * tolerance * length2; /* Squared tolerance,
+                                   scaled by the squared side length */
+    IAS_SIMPLIFY_EXTENT extent; /* Extents of the range */
+    unsigned int begin = first + 1; /* First vertex dropped */
+    unsigned int end = last;    /* End of the vertices dropped */
+    unsigned int bucket_begin;  /* First whole bucket of the range */
+    unsigned int bucket_end;    /* End of the whole buckets */
+    unsigned int low, high;     /* Nodes left to search */
+    unsigned int point;         /* Vertex loop counter */
+    unsigned int direction;     /* Direction loop counter */
+    unsigned int candidates[4]; /* Extreme vertices of the range */
+    double across;              /* Larger distance across the side */
+    double max_dist2 = limit;   /* Farthest extreme vertex, scaled */
+    double dir_x[4], dir_y[4];  /* Directions across and along the side */
+
+    if (length2 <= 0.0)
+        return 0;
+
+    /* The ends of the side bound the extents to start with */
+    extent.max_across = 0.0;
+    extent.min_across = 0.0;
+    extent.min_along = 0.0;
+    extent.max_along = length2;
+    extent.max_vertex = first;
+    extent.min_vertex = first;
+    extent.min_along_vertex = first;
+    extent.max_along_vertex = first;
+    dir_x[0] = dy;
+    dir_y[0] = -dx;
+    dir_x[1] = -dy;
+    dir_y[1] = dx;
+    dir_x[2] = dx;
+    dir_y[2] = dy;
+    dir_x[3] = -dx;
+    dir_y[3] = -dy;
+
+    bucket_begin = (begin + IAS_SIMPLIFY_HULL_BUCKET - 1)
+        / IAS_SIMPLIFY_HULL_BUCKET;
+    bucket_end = end / IAS_SIMPLIFY_HULL_BUCKET;
+    if (bucket_begin >= bucket_end)
+        return 0;
+
+    for (point = begin; point < bucket_begin * IAS_SIMPLIFY_HULL_BUCKET;
+         point++)
+        measure_vertex(tree, first, dx, dy, point, &extent);
+    for (point = bucket_end * IAS_SIMPLIFY_HULL_BUCKET; point < end; point++)
+        measure_vertex(tree, first, dx, dy, point, &extent);
+
+    /* Walk the nodes covering the whole buckets up from the leaves */
+    low = tree->num_leaves + bucket_begin;
+    high = tree->num_leaves + bucket_end;
+    while (low < high)
+    {
+        unsigned int nodes[2];  /* Nodes covering part of the range */
+        unsigned int num_nodes = 0; /* Number of those nodes */
+        unsigned int node;      /* Node loop counter */
+
+        if (low & 1)
+            nodes[num_nodes++] = low++;
+        if (high & 1)
+            nodes[num_nodes++] = --high;
+        for (node = 0; node < num_nodes; node++)
+        {
+            for (direction = 0; direction < 4; direction++)
+            {
+                point = hull_extreme(tree, nodes[node], dir_x[direction],
+                    dir_y[direction]);
+                measure_vertex(tree, first, dx, dy, point, &extent);
+            }
+        }
+        low /= 2;
+        high /= 2;
+    }
+
+    /* Split at the extreme vertex farthest from the side, if it is beyond
+       the tolerance */
+    candidates[0] = extent.max_vertex;
+    candidates[1] = extent.min_vertex;
+    candidates[2] = extent.min_along_vertex;
+    candidates[3] = extent.max_along_vertex;
+    *farthest = first;
+    for (direction = 0; direction < 4; direction++)
+    {
+        double px = x[candidates[direction]] - x[first]; /* Offset of the
+                                                  vertex from the side */
+        double py = y[candidates[direction]] - y[first];
+        double dist_across = px * dy - py * dx; /* Scaled distance across */
+        double dist_along = px * dx + py * dy;  /* Scaled distance along */
+        double dist2 = dist_across * dist_across; /* Scaled squared
+                                                  distance to the side */
+
+        if (dist_along < 0.0)
+            dist2 += dist_along * dist_along;
+        else if (dist_along > length2)
+            dist2 += (dist_along - length2) * (dist_along - length2);
+        if (dist2 > max_dist2)
+        {
+            max_dist2 = dist2;
+            *farthest = candidates[direction];
+        }
+    }
+    if (*farthest != first)
+        return 1;
+
+    /* Every vertex projects onto the side, so none is farther from the
+       side than the extreme vertices across it */
+    if (extent.min_along >= 0.0 && extent.max_along <= length2)
+        return 1;
+
+    across = extent.max_across > -extent.min_across ? extent.max_across
+        : -extent.min_across;
+
+    /* The vertices past the ends are within the tolerance of them even at
+       the largest distances across and along */
+    if (across * across <= limit
+        && (extent.min_along >= 0.0 || across * across
+            + extent.min_along * extent.min_along <= limit)
+        && (extent.max_along <= length2 || across * across
+            + (extent.max_along - length2) * (extent.max_along - length2)
+            <= limit))
+    {
+        return 1;
+    }
+
+    return 0;
+}
+
+/*****************************************************************************
+NAME:  scan_farthest
+
+PURPOSE:  Find the vertex of a range farthest from the side replacing it by
+          checking every vertex.
+
+RETURN VALUE: Vertex farthest from the side beyond the tolerance, or the
+              first vertex for none
+
+*****************************************************************************/
+static unsigned int scan_farthest
+(
+    const double *point_x,      /* I: Polygon vertex x values */
+    const double *point_y,      /* I: Polygon vertex y values */
+    unsigned int first,         /* I: First vertex of the range, kept */
+    unsigned int last,          /* I: Last vertex of the range, kept */
+    double tolerance            /* I: Largest distance of a dropped vertex */
+)
+{
+    double dx = point_x[last] - point_x[first]; /* Side x extent */
+    double dy = point_y[last] - point_y[first]; /* Side y extent */
+    double length2 = dx * dx + dy * dy; /* Squared side length */
+    double max_dist2 = tolerance * tolerance; /* Farthest so far */
+    unsigned int farthest = first;      /* Vertex farthest from side */
+    unsigned int point;                 /* Vertex loop counter */
+
+    for (point = first + 1; point < last; point++)
+    {
+        double px = point_x[point] - point_x[first];
+        double py = point_y[point] - point_y[first];
+        double t = length2 > 0.0 ? (px * dx + py * dy) / length2 : 0.0;
+        double dist2;           /* Squared distance to the side */
+
+        /* Measure to the closest point of the side, not its line */
+        if (t < 0.0)
+            t = 0.0;
+        else if (t > 1.0)
+            t = 1.0;
+        px -= t * dx;
+        py -= t * dy;
+        dist2 = px * px + py * py;
+        if (dist2 > max_dist2)
+        {
+            max_dist2 = dist2;
+            farthest = point;
+        }
+    }
+
+    return farthest;
+}
+
+/*****************************************************************************
+NAME:  simplify_range
+
+PURPOSE:  Flag the vertices of a polygon to keep between two kept vertices
+          with the Douglas-Peucker algorithm, so every vertex dropped lies
+          within the tolerance of the side replacing it.
+
+RETURN VALUE: None
+
+NOTES: The ranges left to split are kept on a stack rather than by
+       recursion, since coastlines have long runs of nearly straight sides.
+
+       Scanning each range costs O(n log n) when the splits are balanced, as
+       they are for coastlines, but O(n^2) when each split only peels a few
+       vertices off a range.  Once the scans have used up the budget, the
+       hull tree of the polygon is built and the long ranges are searched
+       with it instead.
+*****************************************************************************/
+static int simplify_range
+(
+    const IAS_POLYGON_LINKED_LIST *polygon, /* I: Polygon to simplify */
+    IAS_SIMPLIFY_HULL_TREE *tree, /* I/O: Hulls of the vertices, built when
+                                     needed; cleared before the first call */
+    size_t *budget,             /* I/O: Vertices left to scan before the
+                                      hull tree is built */
+    unsigned int first_point,   /* I: First vertex of the range, kept */
+    unsigned int last_point,    /* I: Last vertex of the range, kept */
+    double tolerance,           /* I: Largest distance of a dropped vertex */
+    unsigned int *stack,        /* I: Work space of 2 * number of vertices */
+    unsigned char *keep         /* I/O: Flags of the vertices kept */
+)
+{
+    unsigned int depth = 0;     /* Number of ranges on the stack */
+
+    stack[depth++] = first_point;
+    stack[depth++] = last_point;
+    while (depth > 0)
+    {
+        unsigned int last = stack[--depth];  /* End of the range */
+        unsigned int first = stack[--depth]; /* Start of the range */
+        unsigned int farthest;              /* Vertex farthest from side */
+
+        if (tree->num_leaves == 0 && last - first
+            >= IAS_SIMPLIFY_HULL_MIN_RANGE && *budget == 0)
+        {
+            if (build_hull_tree(polygon, tree) != SUCCESS)
+                return ERROR;
+        }
+
+        if (tree->num_leaves == 0 || last - first
+            < IAS_SIMPLIFY_HULL_MIN_RANGE
+            || !hull_find_farthest(tree, first, last, tolerance, &farthest))
+        {
+            farthest = scan_farthest(polygon->point_x, polygon->point_y,
+                first, last, tolerance);
+            *budget = *budget > last - first ? *budget - (last - first) : 0;
+        }
+
+        if (farthest != first)
+        {
+            keep[farthest] = 1;
+            stack[depth++] = first;
+            stack[depth++] = farthest;
+            stack[depth++] = farthest;
+            stack[depth++] = last;
+        }
+    }
+
+    return SUCCESS;
+}
+
+/*****************************************************************************
+NAME:  ias_geo_simplify_polygon
+
+PURPOSE:  Build a copy of a polygon with the vertices within a tolerance of
+          the simplified sides dropped, renumbering its segments to match.
+
+RETURN VALUE:
+Type = int
+Value    Description
+-----    -----------
+SUCCESS  Successful completion
+ERROR    Operation failed
+
+*****************************************************************************/
+int ias_geo_simplify_polygon
+(
+    const IAS_POLYGON_LINKED_LIST *polygon, /* I: Polygon to simplify */
+    double tolerance,                   /* I: Tolerance, in the units of the
+                                           vertices (degrees for the land
+                                           mass polygons) */
+    IAS_POLYGON_LINKED_LIST *simplified /* O: Simplified polygon, cleared on
+                                           input */
+)
+{
+    unsigned int num_points = polygon->num_points; /* Number of vertices */
+    unsigned char *keep;        /* Flags of the vertices kept */
+    unsigned int *stack;        /* Work space of simplify_range */
+    unsigned int *renumber;     /* New index of each vertex kept */
+    unsigned int num_kept = 0;  /* Number of vertices kept */
+    unsigned int point;         /* Vertex loop counter */
+    unsigned int seg;           /* Segment loop counter */
+    IAS_SIMPLIFY_HULL_TREE tree; /* Hulls of the vertices, if needed */
+    size_t budget = 0;          /* Vertices simplify_range scans before
+                                   building the hull tree */
+    int status = SUCCESS;       /* Return status of simplify_range */
+
+    memset(&tree, 0, sizeof(tree));
+    for (point = num_points; point > 1; point /= 2)
+        budget += IAS_SIMPLIFY_HULL_WORK * (size_t)num_points;
+    keep = calloc(num_points, sizeof(*keep));
+    stack = malloc(2 * (size_t)num_points * sizeof(*stack));
+    renumber = malloc(num_points * sizeof(*renumber));
+    if (keep == NULL || stack == NULL || renumber == NULL)
+    {
+        IAS_LOG_ERROR("Allocating memory to simplify polygon id %u",
+            polygon->id);
+        free(keep);
+        free(stack);
+        free(renumber);
+        return ERROR;
+    }
+
+    /* Keep the segment end points, so the segments still cover the same
+       sides.  A polygon without segments is split at the vertex farthest
+       from its first one. */
+    if (polygon->num_segs > 0)
+    {
+        for (seg = 0; seg < polygon->num_segs && status == SUCCESS; seg++)
+        {
+            const IAS_POLYGON_SEGMENT *poly_seg = &polygon->poly_seg[seg];
+
+            keep[poly_seg->first_point] = 1;
+            keep[poly_seg->last_point] = 1;
+            status = simplify_range(polygon, &tree, &budget,
+                poly_seg->first_point, poly_seg->last_point, tolerance,
+                stack, keep);
+        }
+    }
+    else
+    {
+        unsigned int farthest = 0;  /* Vertex farthest from the first */
+        double max_dist2 = -1.0;    /* Squared distance of that vertex */
+
+        for (point = 1; point < num_points - 1; point++)
+        {
+            double dx = polygon->point_x[point] - polygon->point_x[0];
+            double dy = polygon->point_y[point] - polygon->point_y[0];
+
+            if (dx * dx + dy * dy > max_dist2)
+            {
+                max_dist2 = dx * dx + dy * dy;
+                farthest = point;
+            }
+        }
+
+        keep[0] = 1;
+        keep[farthest] = 1;
+        keep[num_points - 1] = 1;
+        status = simplify_range(polygon, &tree, &budget, 0, farthest,
+            tolerance, stack, keep);
+        if (status == SUCCESS)
+        {
+            status = simplify_range(polygon, &tree, &budget, farthest,
+                num_points - 1, tolerance, stack, keep);
+        }
+    }
+    free(stack);
+    free_hull_tree(&tree);
+    if (status != SUCCESS)
+    {
+        IAS_LOG_ERROR("Building the hulls of polygon id %u", polygon->id);
+        free(keep);
+        free(renumber);
+        return ERROR;
+    }
+
+    for (point = 0; point < num_points; point++)
+        num_kept += keep[point];
+
+    /* Keep at least the three sides required of a polygon */
+    if (num_kept < 4)
+    {
+        memset(keep, 1, num_points);
+        num_kept = num_points;
+    }
+
+    simplified->id = polygon->id;
+    simplified->num_points = num_kept;
+    simplified->num_segs = polygon->num_segs;
+    simplified->point_x = malloc(num_kept * sizeof(double));
+    simplified->point_y = malloc(num_kept * sizeof(double));
+    if (polygon->num_segs > 0)
+    {
+        simplified->poly_seg = malloc(polygon->num_segs
+            * sizeof(IAS_POLYGON_SEGMENT));
+    }
+    if (simplified->point_x == NULL || simplified->point_y == NULL
+        || (polygon->num_segs > 0 && simplified->poly_seg == NULL))
+    {
+        IAS_LOG_ERROR("Allocating memory to simplify polygon id %u",
+            polygon->id);
+        free(keep);
+        free(renumber);
+        return ERROR;
+    }
+
+    num_kept = 0;
+    for (point = 0; point < num_points; point++)
+    {
+        if (!keep[point])
+            continue;
+
+        simplified->point_x[num_kept] = polygon->point_x[point];
+        simplified->point_y[num_kept] = polygon->point_y[point];
+        if (num_kept == 0 || simplified->point_x[num_kept]
+            < simplified->min_x)
+            simplified->min_x = simplified->point_x[num_kept];
+        if (num_kept == 0 || simplified->point_x[num_kept]
+            > simplified->max_x)
+            simplified->max_x = simplified->point_x[num_kept];
+        if (num_kept == 0 || simplified->point_y[num_kept]
+            < simplified->min_y)
+            simplified->min_y = simplified->point_y[num_kept];
+        if (num_kept == 0 || simplified->point_y[num_kept]
+            > simplified->max_y)
+            simplified->max_y = simplified->point_y[num_kept];
+        renumber[point] = num_kept++;
+    }
+
+    /* Renumber the segments and shrink their bounds to the vertices kept */
+    for (seg = 0; seg < polygon->num_segs; seg++)
+    {
+        IAS_POLYGON_SEGMENT *poly_seg = &simplified->poly_seg[seg];
+
+        poly_seg->first_point = renumber[polygon->poly_seg[seg].first_point];
+        poly_seg->last_point = renumber[polygon->poly_seg[seg].last_point];
+        poly_seg->min_x = poly_seg->max_x
+            = simplified->point_x[poly_seg->first_point];
+        poly_seg->min_y = poly_seg->max_y
+            = simplified->point_y[poly_seg->first_point];
+        for (point = poly_seg->first_point + 1;
+             point <= poly_seg->last_point; point++)
+        {
+            if (simplified->point_x[point] < poly_seg->min_x)
+                poly_seg->min_x = simplified->point_x[point];
+            if (simplified->point_x[point] > poly_seg->max_x)
+                poly_seg->max_x = simplified->point_x[point];
+            if (simplified->point_y[point] < poly_seg->min_y)
+                poly_seg->min_y = simplified->point_y[point];
+            if (simplified->point_y[point] > poly_seg->max_y)
+                poly_seg->max_y = simplified->point_y[point];
+        }
+    }
+
+    free(keep);
+    free(renumber);
+    return SUCCESS;
+}
+
+/*****************************************************************************
+NAME:  copy_polygon_links
+
+PURPOSE:  Build an empty copy of the links of a polygon list, including the
+          children, listing each polygon and its copy in the order they are
+          written to the file.
+
+RETURN VALUE:
+Type = int
+Value    Description
+-----    -----------
+SUCCESS  Successful completion
+ERROR    Operation failed
+
+*****************************************************************************/
+static int copy_polygon_links
+(
+    const IAS_POLYGON_LINKED_LIST *polygon, /* I: Polygon linked list */
+    IAS_POLYGON_LINKED_LIST **head,     /* O: Copy of the links, freed by
+                                           the caller even on an error */
+    const IAS_POLYGON_LINKED_LIST **sources, /* O: Polygons, in order */
+    IAS_POLYGON_LINKED_LIST **copies,   /* O: Their copies, in order */
+    unsigned int *count                 /* I/O: Number of polygons listed */
+)
+{
+    IAS_POLYGON_LINKED_LIST *tail = NULL; /* Last polygon copied */
+
+    *head = NULL;
+    for (; polygon; polygon = polygon->next)
+    {
+        IAS_POLYGON_LINKED_LIST *copy;  /* Copy of the polygon */
+
+        copy = calloc(1, sizeof(IAS_POLYGON_LINKED_LIST));
+        if (copy == NULL)
+        {
+            IAS_LOG_ERROR("Allocating memory for linked list");
+            return ERROR;
+        }
+
+        /* Link the copy first so it is freed on an error */
+        if (tail)
+        {
+            tail->next = copy;
+            copy->prev = tail;
+        }
+        else
+        {
+            *head = copy;
+        }
+        tail = copy;
+
+        sources[*count] = polygon;
+        copies[(*count)++] = copy;
+        if (copy_polygon_links(polygon->child, &copy->child, sources,
+            copies, count) != SUCCESS)
+        {
+            return ERROR;
+        }
+    }
+
+    return SUCCESS;
+}
+
+/*****************************************************************************
+NAME:  simplify_polygon_levels
+
+PURPOSE:  Build simplified copies of a polygon list, including the children,
+          for each of several tolerances.
+
+RETURN VALUE:
+Type = int
+Value    Description
+-----    -----------
+SUCCESS  Successful completion
+ERROR    Operation failed
+
+NOTES: Every polygon of every level is simplified independently, so they
+       are all simplified in one parallel loop rather than level by level
+       or list by list.
+*****************************************************************************/
+static int simplify_polygon_levels
+(
+    const IAS_POLYGON_LINKED_LIST *polygon, /* I: Polygon linked list */
+    unsigned int num_levels,            /* I: Number of tolerances */
+    const double *tolerances,           /* I: Tolerances, in degrees */
+    IAS_POLYGON_LINKED_LIST **heads     /* O: Simplified polygon list of
+                                           each tolerance */
+)
+{
+    const IAS_POLYGON_LINKED_LIST **sources; /* Polygons, in order */
+    IAS_POLYGON_LINKED_LIST **copies;   /* Copies of each level, in order */
+    unsigned int num_polygons = 0;      /* Number of polygons */
+    unsigned int num_leaves = 0;        /* Number of index leaves (unused) */
+    unsigned int level;                 /* Level counter */
+    long task;                          /* Polygon of a level to simplify */
+    int failed = 0;                     /* Number of polygons that failed */
+
+    memset(heads, 0, num_levels * sizeof(*heads));
+    count_polygons(polygon, &num_polygons, &num_leaves);
+    sources = malloc((num_polygons + 1) * sizeof(*sources));
+    copies = malloc(((size_t)num_levels * num_polygons + 1)
+        * sizeof(*copies));
+    if (sources == NULL || copies == NULL)
+    {
+        IAS_LOG_ERROR("Allocating memory to simplify the polygons");
+        free(sources);
+        free(copies);
+        return ERROR;
+    }
+
+    for (level = 0; level < num_levels; level++)
+    {
+        unsigned int count = 0;         /* Number of polygons copied */
+
+        if (copy_polygon_links(polygon, &heads[level], sources,
+            &copies[(size_t)level * num_polygons], &count) != SUCCESS)
+        {
+            failed = 1;
+            break;
+        }
+    }
+
+    if (!failed)
+    {
+#ifdef _OPENMP
+        #pragma omp parallel for schedule(dynamic, 1) reduction(+:failed)
+#endif
+        for (task = 0; task < (long)num_levels * num_polygons; task++)
+        {
+            if (ias_geo_simplify_polygon(sources[task % num_polygons],
+                tolerances[task / num_polygons], copies[task]) != SUCCESS)
+            {
+                failed++;
+            }
+        }
+    }
+
+    free(sources);
+    free(copies);
+    if (failed)
+    {
+        for (level = 0; level < num_levels; level++)
+        {
+            ias_geo_free_polygon_linked_list(heads[level]);
+            heads[level] = NULL;
+        }
+        return ERROR;
+    }
+
+    return SUCCESS;
+}
+
+/*****************************************************************************
+NAME:  ias_geo_write_polygon_index
+
+PURPOSE:  Append the spatial index of a polygon list to a polygon file, after
+          the polygons written by ias_geo_dump_polygon, along with the
+          indexes of its simplified levels of detail.
+
+RETURN VALUE:
+Type = int
+Value    Description
+-----    -----------
+SUCCESS  Successful completion
+ERROR    Operation failed
+
+*****************************************************************************/
+int ias_geo_write_polygon_index
+(
+    FILE *fp,                              /* I: File pointer to dump results */
+    const IAS_POLYGON_LINKED_LIST *polygon,/* I: Polygon linked list */
+    unsigned int npolygons,                /* I: Number of polygons */
+    const int64_t *offset                  /* I: Polygon offsets, by id */
+)
+{
+    IAS_POLYGON_INDEX_TRAILER trailer;     /* File trailer */
+    IAS_POLYGON_INDEX_LEVELS table;        /* Header of the level table */
+    IAS_POLYGON_INDEX_LEVEL_ENTRY levels[IAS_POLYGON_INDEX_NUM_LEVELS];
+                                           /* Entries of the level table */
+    IAS_POLYGON_LINKED_LIST *simplified[IAS_POLYGON_INDEX_NUM_LEVELS];
+                                           /* Polygons of each level */
+    int64_t table_offset;                  /* File offset of the table */
+    int status = SUCCESS;                  /* Return status */
+    unsigned int level;                    /* Level counter */
+
+    memset(levels, 0, sizeof(levels));
+    if (write_index_level(fp, polygon, npolygons, offset,
+        &levels[0].index_offset) != SUCCESS)
+    {
+        return ERROR;
+    }
+
+    /* The levels are simplified together, and then written in order */
+    if (simplify_polygon_levels(polygon, IAS_POLYGON_INDEX_NUM_LEVELS - 1,
+        ias_polygon_index_tolerances, &simplified[1]) != SUCCESS)
+    {
+        IAS_LOG_ERROR("Simplifying the polygons for the levels of detail");
+        return ERROR;
+    }
+
+    for (level = 1; level < IAS_POLYGON_INDEX_NUM_LEVELS; level++)
+    {
+        levels[level].tolerance = ias_polygon_index_tolerances[level - 1];
+        if (status == SUCCESS && write_index_level(fp, simplified[level],
+            npolygons, offset, &levels[level].index_offset) != SUCCESS)
+        {
+            IAS_LOG_ERROR("Writing out the polygon index simplified to %g "
+                "degrees", levels[level].tolerance);
+            status = ERROR;
+        }
+        ias_geo_free_polygon_linked_list(simplified[level]);
+    }
+    if (status != SUCCESS)
+        return ERROR;
+
+    memset(&table, 0, sizeof(table));
+    table.num_levels = IAS_POLYGON_INDEX_NUM_LEVELS;
+    if (align_index(fp, &table_offset) != SUCCESS
+        || fwrite(&table, sizeof(table), 1, fp) != 1
+        || fwrite(levels, sizeof(IAS_POLYGON_INDEX_LEVEL_ENTRY),
+            IAS_POLYGON_INDEX_NUM_LEVELS, fp) != IAS_POLYGON_INDEX_NUM_LEVELS)
+    {
+        IAS_LOG_ERROR("Writing out the polygon index level table");
+        return ERROR;
+    }
+
+    /* The trailer is written last so it is found from the end of the file */
+    memset(&trailer, 0, sizeof(trailer));
+    trailer.magic = IAS_POLYGON_INDEX_MAGIC;
+    trailer.version = IAS_POLYGON_INDEX_VERSION;
+    trailer.index_offset = table_offset;
+    if (fwrite(&trailer, sizeof(trailer), 1, fp) != 1)
+    {
+        IAS_LOG_ERROR("Writing out the polygon index trailer");
+        return ERROR;
+    }
+
+    return SUCCESS;
+}
+
+/*****************************************************************************
+NAME:  find_window_segments
+
+PURPOSE:  Walk the R-tree and return the leaves of the segments reaching the
+          window.
+
+RETURN VALUE:
+Type = int
+Value    Description
+-----    -----------
+SUCCESS  Successful completion
+ERROR    Operation failed
+
+*****************************************************************************/
+static int find_window_segments
+(
+    const IAS_POLYGON_STORE *store,     /* I: Indexed polygon file */
+    const IAS_POLYGON_INDEX_LEVEL *level, /* I: Level of detail to search */
+    const IAS_POLYGON_INDEX_NODE *nodes,/* I: R-tree nodes */
+    const IAS_POLYGON_INDEX_WINDOW *window, /* I: Window of interest */
+    IAS_POLYGON_INDEX_LEAF **hits,      /* O: Leaves reaching the window */
+    unsigned int *num_hits              /* O: Number of leaves found */
+)
+{
+    IAS_POLYGON_INDEX_LEAF buffer[IAS_POLYGON_INDEX_FANOUT]; /* Leaves of a
+                                                   level 0 node, if read */
+    unsigned int *stack;                /* Nodes left to visit */
+    unsigned int depth;                 /* Number of nodes on the stack */
+    unsigned int capacity = 0;          /* Allocated number of hits */
+
+    *hits = NULL;
+    *num_hits = 0;
+    if (level->header.num_nodes == 0)
+        return SUCCESS;
+
+    stack = malloc(level->header.num_nodes * sizeof(unsigned int));
+    if (stack == NULL)
+    {
+        IAS_LOG_ERROR("Allocating memory for the polygon index search");
+        return ERROR;
+    }
+
+    depth = 0;
+    stack[depth++] = level->header.root;
+    while (depth > 0)
+    {
+        const IAS_POLYGON_INDEX_NODE *node = &nodes[stack[--depth]];
+        const IAS_POLYGON_INDEX_LEAF *run;  /* Leaves of the node */
+        unsigned int child;
+
+        if (!box_reaches_window(window, node->min_x, node->max_x,
+            node->min_y, node->max_y))
+        {
+            continue;
+        }
+
+        if (node->level > 0)
+        {
+            for (child = node->first; child < node->first + node->count;
+                 child++)
+            {
+                stack[depth++] = child;
+            }
+            continue;
+        }
+
+        /* Get the leaves of the level 0 node and keep the ones reaching
+           the window */
+        if (store->map)
+        {
+            run = (const IAS_POLYGON_INDEX_LEAF *)(store->map
+                + level->leaf_offset) + node->first;
+        }
+        else
+        {
+            if (fseeko(store->fp, level->leaf_offset + (off_t)node->first
+                * sizeof(IAS_POLYGON_INDEX_LEAF), SEEK_SET) != 0
+                || fread(buffer, sizeof(IAS_POLYGON_INDEX_LEAF), node->count,
+                    store->fp) != node->count)
+            {
+                IAS_LOG_ERROR("Reading the polygon index leaves");
+                free(stack);
+                free(*hits);
+                *hits = NULL;
+                *num_hits = 0;
+                return ERROR;
+            }
+            run = buffer;
+        }
+
+        for (child = 0; child < node->count; child++)
+        {
+            if (!box_reaches_window(window, run[child].seg.min_x,
+                run[child].seg.max_x, run[child].seg.min_y,
+                run[child].seg.max_y))
+            {
+                continue;
+            }
+
+            if (*num_hits == capacity)
+            {
+                IAS_POLYGON_INDEX_LEAF *grown;
+
+                capacity = capacity > 0 ? 2 * capacity : 256;
+                grown = realloc(*hits, capacity
+                    * sizeof(IAS_POLYGON_INDEX_LEAF));
+                if (grown == NULL)
+                {
+                    IAS_LOG_ERROR("Allocating memory for the polygon "
+                        "segments");
+                    free(stack);
+                    free(*hits);
+                    *hits = NULL;
+                    *num_hits = 0;
+                    return ERROR;
+                }
+                *hits = grown;
+            }
+            (*hits)[(*num_hits)++] = run[child];
+        }
+    }
+
+    free(stack);
+    return SUCCESS;
+}
+
+/*****************************************************************************
+NAME:  compare_hits
+
+PURPOSE:  Order the leaves found by polygon, then by first vertex.
+
+RETURN VALUE:
+Type = int
+Value    Description
+-----    -----------
+<0,0,>0  Standard qsort ordering
+
+*****************************************************************************/
+static int compare_hits(const void *a, const void *b)
+{
+    const IAS_POLYGON_INDEX_LEAF *leaf_a = a;
+    const IAS_POLYGON_INDEX_LEAF *leaf_b = b;
+
+    if (leaf_a->polygon != leaf_b->polygon)
+        return leaf_a->polygon < leaf_b->polygon ? -1 : 1;
+    if (leaf_a->seg.first_point != leaf_b->seg.first_point)
+        return leaf_a->seg.first_point < leaf_b->seg.first_point ? -1 : 1;
+    return 0;
+}
+
+/*****************************************************************************
+NAME:  read_vertex_range
+
+PURPOSE:  Read the vertices of one segment of a polygon from the vertex
+          store of its level, which holds the closing copy of the first
+          vertex.
+
+RETURN VALUE:
+Type = int
+Value    Description
+-----    -----------
+SUCCESS  Successful completion
+ERROR    Operation failed
+
+*****************************************************************************/
+static int read_vertex_range
+(
+    FILE *fp,                             /* I: Polygon file pointer */
+    const IAS_POLYGON_INDEX_ENTRY *entry, /* I: Directory entry of polygon */
+    const IAS_POLYGON_SEGMENT *seg,       /* I: Segment to read */
+    double *point_x,                      /* O: Segment x vertices */
+    double *point_y                       /* O: Segment y vertices */
+)
+{
+    off_t x_offset;             /* File offset of the x vertices */
+    off_t y_offset;             /* File offset of the y vertices */
+    unsigned int count;         /* Number of vertices to read */
+
+    if (seg->first_point > seg->last_point
+        || seg->last_point > entry->num_points)
+    {
+        IAS_LOG_ERROR("Segment vertices %u to %u are outside polygon id %u",
+            seg->first_point, seg->last_point, entry->id);
+        return ERROR;
+    }
+
+    x_offset = entry->store_offset;
+    y_offset = x_offset + ((off_t)entry->num_points + 1) * sizeof(double);
+    count = seg->last_point - seg->first_point + 1;
+
+    if (fseeko(fp, x_offset + (off_t)seg->first_point * sizeof(double),
+            SEEK_SET) != 0
+        || fread(point_x, sizeof(double), count, fp) != count
+        || fseeko(fp, y_offset + (off_t)seg->first_point * sizeof(double),
+            SEEK_SET) != 0
+        || fread(point_y, sizeof(double), count, fp) != count)
+    {
+        IAS_LOG_ERROR("Reading the vertices of polygon id %u", entry->id);
+        return ERROR;
+    }
+
+    return SUCCESS;
+}
+
+/*****************************************************************************
+NAME:  read_window_polygon
+
+PURPOSE:  Build a polygon from the segments of it that reach the window.  The
+          vertices of the segments are packed one after the other and the
+          segments renumbered to match, so the polygon only holds the
+          vertices read.
+
+RETURN VALUE:
+Type = int
+Value    Description
+-----    -----------
+SUCCESS  Successful completion
+ERROR    Operation failed
+
+NOTES: The vertex arrays are padded with copies of the first vertex so
+       num_points - 1 is always at least the three sides required by
+       ias_math_point_in_closed_polygon; the padding is not part of any
+       segment.  Such a polygon is only meant for point queries inside the
+       window, not for ias_geo_dump_polygon.
+*****************************************************************************/
+static int read_window_polygon
+(
+    FILE *fp,                             /* I: Polygon file pointer */
+    const IAS_POLYGON_INDEX_ENTRY *entry, /* I: Directory entry of polygon */
+    const IAS_POLYGON_INDEX_LEAF *hits,   /* I: Segments of the polygon */
+    unsigned int num_hits,                /* I: Number of segments */
+    IAS_POLYGON_LINKED_LIST *polygon      /* O: Polygon read */
+)
+{
+    unsigned int seg;           /* Segment counter */
+    unsigned int num_read = 0;  /* Number of vertices read */
+    unsigned int num_alloc;     /* Number of vertices allocated */
+
+    for (seg = 0; seg < num_hits; seg++)
+    {
+        num_read += hits[seg].seg.last_point - hits[seg].seg.first_point
+            + 1;
+    }
+    num_alloc = (num_read < 3 ? 3 : num_read) + 1;
+
+    polygon->point_x = malloc(num_alloc * sizeof(double));
+    polygon->point_y = malloc(num_alloc * sizeof(double));
+    polygon->poly_seg = malloc(num_hits * sizeof(IAS_POLYGON_SEGMENT));
+    if (polygon->point_x == NULL || polygon->point_y == NULL
+        || polygon->poly_seg == NULL)
+    {
+        IAS_LOG_ERROR("Allocating memory for polygon id %u", entry->id);
+        return ERROR;
+    }
+
+    num_read = 0;
+    for (seg = 0; seg < num_hits; seg++)
+    {
+        IAS_POLYGON_SEGMENT *poly_seg = &polygon->poly_seg[seg];
+
+        if (read_vertex_range(fp, entry, &hits[seg].seg,
+            &polygon->point_x[num_read], &polygon->point_y[num_read])
+            != SUCCESS)
+        {
+            return ERROR;
+        }
+
+        *poly_seg = hits[seg].seg;
+        poly_seg->first_point = num_read;
+        poly_seg->last_point = num_read + hits[seg].seg.last_point
+            - hits[seg].seg.first_point;
+        num_read = poly_seg->last_point + 1;
+    }
+    polygon->num_segs = num_hits;
+
+    for (; num_read < num_alloc; num_read++)
+    {
+        polygon->point_x[num_read] = polygon->point_x[0];
+        polygon->point_y[num_read] = polygon->point_y[0];
+    }
+    polygon->num_points = num_alloc;
+
+    return SUCCESS;
+}
+
+/*****************************************************************************
+NAME:  map_window_polygon
+
+PURPOSE:  Build a polygon from the segments of it that reach the window,
+          pointing to its vertices in the mapped vertex store.
+
+RETURN VALUE:
+Type = int
+Value    Description
+-----    -----------
+SUCCESS  Successful completion
+ERROR    Operation failed
+
+NOTES: The vertices are those of the whole polygon and the segments keep
+       their numbering; only the segments are allocated.
+*****************************************************************************/
+static int map_window_polygon
+(
+    const IAS_POLYGON_STORE *store,       /* I: Mapped polygon file */
+    const IAS_POLYGON_INDEX_LEVEL *level, /* I: Level of the polygon */
+    const IAS_POLYGON_INDEX_ENTRY *entry, /* I: Directory entry of polygon */
+    const IAS_POLYGON_INDEX_LEAF *hits,   /* I: Segments of the polygon */
+    unsigned int num_hits,                /* I: Number of segments */
+    IAS_POLYGON_LINKED_LIST *polygon      /* O: Polygon mapped */
+)
+{
+    unsigned int seg;           /* Segment counter */
+    size_t vertex_bytes;        /* Size of the vertices in the store */
+
+    vertex_bytes = 2 * ((size_t)entry->num_points + 1) * sizeof(double);
+    if (entry->store_offset < level->store_offset
+        || (size_t)entry->store_offset + vertex_bytes > store->map_size)
+    {
+        IAS_LOG_ERROR("Vertex store of polygon id %u is outside the file",
+            entry->id);
+        return ERROR;
+    }
+
+    polygon->poly_seg = malloc(num_hits * sizeof(IAS_POLYGON_SEGMENT));
+    if (polygon->poly_seg == NULL)
+    {
+        IAS_LOG_ERROR("Allocating memory for polygon id %u", entry->id);
+        return ERROR;
+    }
+
+    for (seg = 0; seg < num_hits; seg++)
+    {
+        if (hits[seg].seg.first_point > hits[seg].seg.last_point
+            || hits[seg].seg.last_point > entry->num_points)
+        {
+            IAS_LOG_ERROR("Segment vertices %u to %u are outside polygon "
+                "id %u", hits[seg].seg.first_point, hits[seg].seg.last_point,
+                entry->id);
+            return ERROR;
+        }
+        polygon->poly_seg[seg] = hits[seg].seg;
+    }
+    polygon->num_segs = num_hits;
+
+    polygon->point_x = (double *)(store->map + entry->store_offset);
+    polygon->point_y = polygon->point_x + entry->num_points + 1;
+    polygon->num_points = entry->num_points + 1;
+    polygon->mapped = TRUE;
+
+    return SUCCESS;
+}
+
+/*****************************************************************************
+NAME:  read_index_trailer
+
+PURPOSE:  Look for the index of a polygon file and read the headers of its
+          levels of detail.
+
+RETURN VALUE:
+Type = int
+Value    Description
+-----    -----------
+SUCCESS  Successful completion, or the file has no index
+ERROR    Operation failed
+
+NOTES: When the file has no index, store->indexed is set to FALSE and the
+       file position is left unchanged so the caller can read the whole
+       file.  Otherwise store->levels is allocated, to be freed by the
+       caller.
+*****************************************************************************/
+static int read_index_trailer
+(
+    IAS_POLYGON_STORE *store    /* I/O: Polygon file */
+)
+{
+    IAS_POLYGON_INDEX_TRAILER trailer;  /* File trailer */
+    IAS_POLYGON_INDEX_LEVELS table;     /* Header of the level table */
+    IAS_POLYGON_INDEX_LEVEL_ENTRY entry;/* Entry of the level table */
+    off_t start;                        /* Initial file position */
+    unsigned int level;                 /* Level counter */
+
+    store->indexed = FALSE;
+    store->num_levels = 0;
+    store->levels = NULL;
+
+    /* Look for the trailer; without one the file is read as a whole */
+    start = ftello(store->fp);
+    if (start < 0)
+        return SUCCESS;
+    if (fseeko(store->fp, -(off_t)sizeof(trailer), SEEK_END) != 0
+        || fread(&trailer, sizeof(trailer), 1, store->fp) != 1
+        || trailer.magic != IAS_POLYGON_INDEX_MAGIC)
+    {
+        clearerr(store->fp);
+        if (fseeko(store->fp, start, SEEK_SET) != 0)
+        {
+            IAS_LOG_ERROR("Restoring the polygon file position");
+            return ERROR;
+        }
+        return SUCCESS;
+    }
+
+    if (trailer.version != IAS_POLYGON_INDEX_VERSION
+        && trailer.version != IAS_POLYGON_INDEX_SINGLE_LEVEL_VERSION)
+    {
+        IAS_LOG_WARNING("Polygon index version %u is not supported, reading "
+            "the whole polygons", trailer.version);
+        if (fseeko(store->fp, start, SEEK_SET) != 0)
+        {
+            IAS_LOG_ERROR("Restoring the polygon file position");
+            return ERROR;
+        }
+        return SUCCESS;
+    }
+
+    /* A single level file has the index where the level table would be */
+    table.num_levels = 1;
+    if (trailer.index_offset % 8 != 0
+        || (trailer.version == IAS_POLYGON_INDEX_VERSION
+            && (fseeko(store->fp, trailer.index_offset, SEEK_SET) != 0
+            || fread(&table, sizeof(table), 1, store->fp) != 1)))
+    {
+        IAS_LOG_ERROR("Reading the polygon index level table");
+        return ERROR;
+    }
+    if (table.num_levels == 0 || table.num_levels > 64)
+    {
+        IAS_LOG_ERROR("Invalid number of polygon index levels %u",
+            table.num_levels);
+        return ERROR;
+    }
+
+    store->levels = calloc(table.num_levels, sizeof(IAS_POLYGON_INDEX_LEVEL));
+    if (store->levels == NULL)
+    {
+        IAS_LOG_ERROR("Allocating memory for the polygon index levels");
+        return ERROR;
+    }
+    store->num_levels = table.num_levels;
+
+    for (level = 0; level < table.num_levels; level++)
+    {
+        IAS_POLYGON_INDEX_LEVEL *index = &store->levels[level];
+
+        entry.tolerance = 0.0;
+        entry.index_offset = trailer.index_offset;
+        if (trailer.version == IAS_POLYGON_INDEX_VERSION
+            && (fseeko(store->fp, trailer.index_offset + sizeof(table)
+                + (off_t)level * sizeof(entry), SEEK_SET) != 0
+            || fread(&entry, sizeof(entry), 1, store->fp) != 1))
+        {
+            IAS_LOG_ERROR("Reading the polygon index level table");
+            return ERROR;
+        }
+
+        if (entry.index_offset % 8 != 0
+            || fseeko(store->fp, entry.index_offset, SEEK_SET) != 0
+            || fread(&index->header, sizeof(index->header), 1, store->fp)
+                != 1)
+        {
+            IAS_LOG_ERROR("Reading the polygon index header");
+            return ERROR;
+        }
+        index->tolerance = entry.tolerance;
+        index->directory_offset = entry.index_offset + sizeof(index->header);
+        index->leaf_offset = index->directory_offset
+            + (off_t)index->header.num_polygons
+            * sizeof(IAS_POLYGON_INDEX_ENTRY);
+        index->node_offset = index->leaf_offset
+            + (off_t)index->header.num_leaves
+            * sizeof(IAS_POLYGON_INDEX_LEAF);
+        index->store_offset = index->node_offset
+            + (off_t)index->header.num_nodes
+            * sizeof(IAS_POLYGON_INDEX_NODE);
+    }
+    store->indexed = TRUE;
+
+    return SUCCESS;
+}
+
+/*****************************************************************************
+NAME:  select_level
+
+PURPOSE:  Pick the coarsest level of detail of an indexed polygon file whose
+          simplification tolerance is within the error allowed.
+
+RETURN VALUE:
+Type = const IAS_POLYGON_INDEX_LEVEL *
+Value    Description
+-----    -----------
+level    Level to load; the full detail level when no other qualifies
+
+*****************************************************************************/
+static const IAS_POLYGON_INDEX_LEVEL *select_level
+(
+    const IAS_POLYGON_STORE *store, /* I: Indexed polygon file */
+    double max_error                /* I: Largest simplification error
+                                       allowed, in degrees */
+)
+{
+    unsigned int level;             /* Level counter */
+    unsigned int selected = 0;      /* Level selected */
+
+    for (level = 1; level < store->num_levels; level++)
+    {
+        if (store->levels[level].tolerance <= max_error)
+            selected = level;
+    }
+
+    return &store->levels[selected];
+}
+
+/*****************************************************************************
+NAME:  load_window_polygons
+
+PURPOSE:  Build the polygons of an indexed polygon file for a window from
+          the segments that can affect a point in the window.
+
+RETURN VALUE:
+Type = int
+Value    Description
+-----    -----------
+SUCCESS  Successful completion
+ERROR    Operation failed
+
+NOTES: The top level polygons are kept with the same bounding box test as
+       ias_geo_load_polygon.  A polygon without segments reaching the window
+       cannot hold a point of the window, so it is left out along with its
+       children.
+*****************************************************************************/
+static int load_window_polygons
+(
+    const IAS_POLYGON_STORE *store, /* I: Indexed polygon file */
+    const IAS_POLYGON_INDEX_LEVEL *level, /* I: Level of detail to load */
+    double min_x,                   /* I: Minimum x value of interest */
+    double max_x,                   /* I: Maximum x value of interest */
+    double min_y,                   /* I: Minimum y value of interest */
+    double max_y,                   /* I: Maximum y value of interest */
+    IAS_POLYGON_LINKED_LIST **head  /* O: Polygon pointer */
+)
+{
+    IAS_POLYGON_INDEX_WINDOW window;    /* Window of interest */
+    IAS_POLYGON_INDEX_NODE *nodes = NULL; /* R-tree nodes, if read */
+    IAS_POLYGON_INDEX_LEAF *hits;       /* Segments reaching the window */
+    IAS_POLYGON_LINKED_LIST **loaded;   /* Polygons read, by directory entry */
+    IAS_POLYGON_LINKED_LIST *list_tail = NULL; /* Tail of the polygon list */
+    unsigned int num_hits;              /* Number of segments found */
+    unsigned int first;                 /* First segment of a polygon */
+    unsigned int last;                  /* Past the last segment of it */
+    int status;                         /* Return status */
+
+    *head = NULL;
+
+    window.min_x = min_x;
+    window.max_x = max_x;
+    window.min_y = min_y;
+    window.max_y = max_y;
+    window.wraps = (min_x > max_x || min_x < -180 || max_x > 180);
+
+    /* The nodes are a small fraction of the index, so read them at once
+       when the file is not mapped */
+    if (!store->map && level->header.num_nodes > 0)
+    {
+        nodes = malloc(level->header.num_nodes
+            * sizeof(IAS_POLYGON_INDEX_NODE));
+        if (nodes == NULL)
+        {
+            IAS_LOG_ERROR("Allocating memory for the polygon index nodes");
+            return ERROR;
+        }
+
+        if (fseeko(store->fp, level->node_offset, SEEK_SET) != 0
+            || fread(nodes, sizeof(IAS_POLYGON_INDEX_NODE),
+                level->header.num_nodes, store->fp)
+                != level->header.num_nodes)
+        {
+            IAS_LOG_ERROR("Reading the polygon index nodes");
+            free(nodes);
+            return ERROR;
+        }
+    }
+
+    status = find_window_segments(store, level, store->map
+        ? (const IAS_POLYGON_INDEX_NODE *)(store->map + level->node_offset)
+        : nodes, &window, &hits, &num_hits);
+    free(nodes);
+    if (status != SUCCESS)
+    {
+        IAS_LOG_ERROR("Searching the polygon index");
+        return ERROR;
+    }
+    if (num_hits == 0)
+        return SUCCESS;
+    qsort(hits, num_hits, sizeof(IAS_POLYGON_INDEX_LEAF), compare_hits);
+
+    loaded = calloc(level->header.num_polygons,
+        sizeof(IAS_POLYGON_LINKED_LIST *));
+    if (loaded == NULL)
+    {
+        IAS_LOG_ERROR("Allocating memory for the polygon directory");
+        free(hits);
+        return ERROR;
+    }
+
+    /* The directory lists parents before their children, so the parent of
+       a polygon is read before it */
+    for (first = 0; first < num_hits; first = last)
+    {
+        IAS_POLYGON_INDEX_ENTRY entry;  /* Directory entry of the polygon */
+        IAS_POLYGON_LINKED_LIST *polygon; /* Polygon read */
+        IAS_POLYGON_LINKED_LIST *parent = NULL; /* Parent polygon */
+
+        for (last = first + 1; last < num_hits
+             && hits[last].polygon == hits[first].polygon; last++)
+            ;
+
+        status = SUCCESS;
+        if (hits[first].polygon >= level->header.num_polygons)
+        {
+            status = ERROR;
+        }
+        else if (store->map)
+        {
+            memcpy(&entry, store->map + level->directory_offset
+                + (size_t)hits[first].polygon * sizeof(entry), sizeof(entry));
+        }
+        else if (fseeko(store->fp, level->directory_offset
+                + (off_t)hits[first].polygon * sizeof(entry), SEEK_SET) != 0
+            || fread(&entry, sizeof(entry), 1, store->fp) != 1)
+        {
+            status = ERROR;
+        }
+        if (status != SUCCESS)
+        {
+            IAS_LOG_ERROR("Reading the polygon directory");
+            ias_geo_free_polygon_linked_list(*head);
+            *head = NULL;
+            free(loaded);
+            free(hits);
+            return ERROR;
+        }
+
+        if (entry.parent == IAS_POLYGON_INDEX_NO_PARENT)
+        {
+            if (entry.min_x > max_x || entry.max_x < min_x
+                || entry.min_y > max_y || entry.max_y < min_y)
+            {
+                continue;
+            }
+        }
+        else
+        {
+            if (entry.parent >= level->header.num_polygons)
+            {
+                IAS_LOG_ERROR("Invalid parent of polygon id %u", entry.id);
+                ias_geo_free_polygon_linked_list(*head);
+                *head = NULL;
+                free(loaded);
+                free(hits);
+                return ERROR;
+            }
+
+            parent = loaded[entry.parent];
+            if (parent == NULL)
+                continue;
+        }
+
+        polygon = calloc(1, sizeof(IAS_POLYGON_LINKED_LIST));
+        if (polygon == NULL)
+        {
+            IAS_LOG_ERROR("Allocating memory for linked list");
+            ias_geo_free_polygon_linked_list(*head);
+            *head = NULL;
+            free(loaded);
+            free(hits);
+            return ERROR;
+        }
+        polygon->id = entry.id;
+        polygon->min_x = entry.min_x;
+        polygon->max_x = entry.max_x;
+        polygon->min_y = entry.min_y;
+        polygon->max_y = entry.max_y;
+
+        if (store->map)
+        {
+            status = map_window_polygon(store, level, &entry, &hits[first],
+                last - first, polygon);
+        }
+        else
+        {
+            status = read_window_polygon(store->fp, &entry, &hits[first],
+                last - first, polygon);
+        }
+        if (status != SUCCESS)
+        {
+            IAS_LOG_ERROR("Reading polygon id %u", entry.id);
+            ias_geo_free_polygon_linked_list(polygon);
+            ias_geo_free_polygon_linked_list(*head);
+            *head = NULL;
+            free(loaded);
+            free(hits);
+            return ERROR;
+        }
+        loaded[hits[first].polygon] = polygon;
+
+        if (parent)
+        {
+            /* Add the polygon to the end of the child list of its parent */
+            if (!parent->child)
+            {
+                parent->child = polygon;
+            }
+            else
+            {
+                IAS_POLYGON_LINKED_LIST *child_tail = parent->child;
+
+                while (child_tail->next)
+                    child_tail = child_tail->next;
+                child_tail->next = polygon;
+                polygon->prev = child_tail;
+            }
+        }
+        else
+        {
+            /* Add the polygon to the end of the top level list */
+            if (!*head)
+                *head = polygon;
+            if (list_tail)
+            {
+                list_tail->next = polygon;
+                polygon->prev = list_tail;
+            }
+            list_tail = polygon;
+        }
+    }
+
+    free(loaded);
+    free(hits);
+    return SUCCESS;
+}
+
+/*****************************************************************************
+NAME:  ias_geo_load_indexed_polygon
+
+PURPOSE:  Read the polygons of an indexed polygon file for a window, reading
+          only the segments that can affect a point in the window.
+
+RETURN VALUE:
+Type = int
+Value    Description
+-----    -----------
+SUCCESS  Successful completion, or the file has no index
+ERROR    Operation failed
+
+NOTES: When the file has no index, indexed is set to FALSE and the file
+       position is left unchanged so the caller can read the whole file.
+       The polygons are loaded at full detail.
+*****************************************************************************/
+int ias_geo_load_indexed_polygon
+(
+    FILE *fp,                       /* I: Input file pointer */
+    double min_x,                   /* I: Minimum x value of interest */
+    double max_x,                   /* I: Maximum x value of interest */
+    double min_y,                   /* I: Minimum y value of interest */
+    double max_y,                   /* I: Maximum y value of interest */
+    IAS_POLYGON_LINKED_LIST **head, /* O: Polygon pointer */
+    int *indexed                    /* O: Flag for a file with an index */
+)
+{
+    IAS_POLYGON_STORE store;        /* Unmapped polygon file */
+    int status;                     /* Return status */
+
+    *head = NULL;
+    *indexed = FALSE;
+
+    memset(&store, 0, sizeof(store));
+    store.fp = fp;
+    if (read_index_trailer(&store) != SUCCESS)
+    {
+        free(store.levels);
+        return ERROR;
+    }
+    if (!store.indexed)
+        return SUCCESS;
+    *indexed = TRUE;
+
+    status = load_window_polygons(&store, &store.levels[0], min_x, max_x,
+        min_y, max_y, head);
+    free(store.levels);
+
+    return status;
+}
+
+/*****************************************************************************
+NAME:  ias_geo_open_polygon_store
+
+PURPOSE:  Open a polygon file for loading and map it into memory when it has
+          an index, so the polygons loaded from it share its vertices.
+
+RETURN VALUE:
+Type = IAS_POLYGON_STORE *
+Value    Description
+-----    -----------
+NULL     Operation failed
+other    Opened polygon file
+
+NOTES: A file without an index, or one that cannot be mapped, is read with
+       ias_geo_load_polygon instead.  Mapping it read-only and shared lets
+       every process using the same polygon file share its page cache.
+       A file kept open by ias_geo_keep_polygon_store is not opened again.
+*****************************************************************************/
+IAS_POLYGON_STORE *ias_geo_open_polygon_store
+(
+    const char *polygon_file        /* I: Polygon filename */
+)
+{
+    IAS_POLYGON_STORE *store;       /* Opened polygon file */
+    struct stat file_stat;          /* Status of the polygon file */
+    void *map;                      /* Mapping of the polygon file */
+
+    if (kept_store != NULL && stat(polygon_file, &file_stat) == 0
+        && file_stat.st_dev == kept_dev && file_stat.st_ino == kept_ino)
+    {
+        espa_metrics_cache(ESPA_METRICS_POLYGON, true);
+        return kept_store;
+    }
+    espa_metrics_cache(ESPA_METRICS_POLYGON, false);
+
+    store = calloc(1, sizeof(IAS_POLYGON_STORE));
+    if (store == NULL)
+    {
+        IAS_LOG_ERROR("Allocating memory for the polygon store");
+        return NULL;
+    }
+
+    store->fp = fopen(polygon_file, "r");
+    if (store->fp == NULL)
+    {
+        IAS_LOG_ERROR("Unable to open %s for reading.", polygon_file);
+        free(store);
+        return NULL;
+    }
+
+    if (read_index_trailer(store) != SUCCESS)
+    {
+        IAS_LOG_ERROR("Reading the index of %s", polygon_file);
+        ias_geo_close_polygon_store(store);
+        return NULL;
+    }
+    if (!store->indexed)
+        return store;
+
+    if (fstat(fileno(store->fp), &file_stat) != 0
+        || file_stat.st_size
+            < store->levels[store->num_levels - 1].store_offset)
+    {
+        IAS_LOG_ERROR("Polygon index of %s is outside the file",
+            polygon_file);
+        ias_geo_close_polygon_store(store);
+        return NULL;
+    }
+
+    /* The loader falls back to reading the file if it cannot be mapped */
+    map = mmap(NULL, file_stat.st_size, PROT_READ, MAP_SHARED,
+        fileno(store->fp), 0);
+    if (map == MAP_FAILED)
+    {
+        IAS_LOG_WARNING("Unable to map %s, reading the polygons instead",
+            polygon_file);
+        return store;
+    }
+    store->map = map;
+    store->map_size = file_stat.st_size;
+
+    return store;
+}
+
+/*****************************************************************************
+NAME:  ias_geo_load_polygon_store
+
+PURPOSE:  Load the polygons of an opened polygon file for a window.
+
+RETURN VALUE:
+Type = int
+Value    Description
+-----    -----------
+SUCCESS  Successful completion
+ERROR    Operation failed
+
+NOTES: Polygons loaded from a mapped file point into the mapping, so they
+       must be freed before the store is closed.
+*****************************************************************************/
+int ias_geo_load_polygon_store
+(
+    const IAS_POLYGON_STORE *store, /* I: Opened polygon file */
+    double min_x,                   /* I: Minimum x value of interest */
+    double max_x,                   /* I: Maximum x value of interest */
+    double min_y,                   /* I: Minimum y value of interest */
+    double max_y,                   /* I: Maximum y value of interest */
+    IAS_POLYGON_LINKED_LIST **head  /* O: Polygon pointer */
+)
+{
+    return ias_geo_load_polygon_store_level(store, 0.0, min_x, max_x, min_y,
+        max_y, head);
+}
+
+/*****************************************************************************
+NAME:  ias_geo_load_polygon_store_level
+
+PURPOSE:  Load the polygons of an opened polygon file for a window, from the
+          coarsest level of detail whose vertices are within an error.
+
+RETURN VALUE:
+Type = int
+Value    Description
+-----    -----------
+SUCCESS  Successful completion
+ERROR    Operation failed
+
+NOTES: Files without simplified levels always load the full polygons.
+       Polygons loaded from a mapped file point into the mapping, so they
+       must be freed before the store is closed.
+*****************************************************************************/
+int ias_geo_load_polygon_store_level
+(
+    const IAS_POLYGON_STORE *store, /* I: Opened polygon file */
+    double max_error,               /* I: Largest simplification error
+                                       allowed, in degrees; 0 loads the full
+                                       polygons */
+    double min_x,                   /* I: Minimum x value of interest */
+    double max_x,                   /* I: Maximum x value of interest */
+    double min_y,                   /* I: Minimum y value of interest */
+    double max_y,                   /* I: Maximum y value of interest */
+    IAS_POLYGON_LINKED_LIST **head  /* O: Polygon pointer */
+)
+{
+    if (store->indexed)
+    {
+        return load_window_polygons(store, select_level(store, max_error),
+            min_x, max_x, min_y, max_y, head);
+    }
+
+    /* Without an index the whole file is read from its start */
+    if (fseeko(store->fp, 0, SEEK_SET) != 0)
+    {
+        IAS_LOG_ERROR("Rewinding the polygon file");
+        *head = NULL;
+        return ERROR;
+    }
+
+    return ias_geo_load_polygon(store->fp, min_x, max_x, min_y, max_y, head);
+}
+
+/*****************************************************************************
+NAME:  ias_geo_close_polygon_store
+
+PURPOSE:  Close a polygon file opened with ias_geo_open_polygon_store.
+
+RETURN VALUE: None
+
+*****************************************************************************/
+void ias_geo_close_polygon_store
+(
+    IAS_POLYGON_STORE *store        /* I: Opened polygon file */
+)
+{
+    if (store == NULL || store == kept_store)
+        return;
+
+    if (store->map)
+        munmap((void *)store->map, store->map_size);
+    if (store->fp)
+        fclose(store->fp);
+    free(store->levels);
+    free(store);
+}
+
+/*****************************************************************************
+NAME:  ias_geo_keep_polygon_store
+
+PURPOSE:  Open a polygon file and keep it open for the life of the process,
+          so later opens of the same file (including those of processes
+          forked from this one) share the mapping instead of opening and
+          mapping the file again.
+
+RETURN VALUE:
+Type = int
+Value    Description
+-----    -----------
+SUCCESS  Successful completion
+ERROR    Operation failed, or the file has no index and cannot be shared
+
+NOTES: Only an indexed, mapped file is kept.  The polygons of such a file
+       are loaded from the mapping alone, so forked processes can load them
+       at the same time without sharing the position of the file pointer.
+       Closing the kept store is ignored.
+*****************************************************************************/
+int ias_geo_keep_polygon_store
+(
+    const char *polygon_file        /* I: Polygon filename */
+)
+{
+    IAS_POLYGON_STORE *store;       /* Opened polygon file */
+    struct stat file_stat;          /* Status of the polygon file */
+
+    if (kept_store != NULL)
+    {
+        IAS_LOG_ERROR("A polygon file is already kept open");
+        return ERROR;
+    }
+
+    store = ias_geo_open_polygon_store(polygon_file);
+    if (store == NULL)
+    {
+        IAS_LOG_ERROR("Opening %s", polygon_file);
+        return ERROR;
+    }
+    if (store->map == NULL || fstat(fileno(store->fp), &file_stat) != 0)
+    {
+        IAS_LOG_ERROR("%s has no index that can be mapped, so it cannot be "
+            "kept open", polygon_file);
+        ias_geo_close_polygon_store(store);
+        return ERROR;
+    }
+
+    /* Start reading the mapping in, so the first scene doesn't wait on it */
+    madvise((void *)store->map, store->map_size, MADV_WILLNEED);
+
+    kept_dev = file_stat.st_dev;
+    kept_ino = file_stat.st_ino;
+    kept_store = store;
+
+    return SUCCESS;
+}
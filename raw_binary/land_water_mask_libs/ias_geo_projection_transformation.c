@@ -15,6 +15,7 @@ Notes:
 #include "ias_logging.h"
 #include "ias_lw_geo.h"
 #include "ias_const.h"
+#include "espa_metrics.h"
 
 /* Declare a private structure to store information about a projection
    transformation. */
@@ -33,6 +34,27 @@ struct ias_geo_proj_transformation
                                    so they can be converted to degrees */
 };
 
+/* Number of transformations kept in the transformation cache */
+#define TRANSFORMATION_CACHE_SIZE 8
+
+/* Declare a private structure for an entry in the transformation cache */
+typedef struct transformation_cache_entry
+{
+    IAS_PROJECTION source;      /* Source projection of the transformation */
+    IAS_PROJECTION target;      /* Target projection of the transformation */
+    IAS_GEO_PROJ_TRANSFORMATION *trans; /* Cached transformation, or NULL if
+                                   the entry is unused */
+    int ref_count;              /* Number of users of the transformation */
+    unsigned long last_used;    /* Cache clock when the transformation was
+                                   last handed out */
+} TRANSFORMATION_CACHE_ENTRY;
+
+/* The transformation cache shared by all the users in the process.  It is
+   only accessed in the transformation_cache critical section. */
+static TRANSFORMATION_CACHE_ENTRY transformation_cache[
+    TRANSFORMATION_CACHE_SIZE];
+static unsigned long transformation_cache_clock = 0;
+
 /*****************************************************************************
 Name: copy_ias_proj_to_gctp_proj
 
@@ -239,6 +261,215 @@ void ias_geo_destroy_proj_transformation
     }
 }
 
+/*****************************************************************************
+Name: is_same_projection
+
+Purpose: A helper routine to compare two IAS projection definitions.
+
+Returns: TRUE if the projections are identical, FALSE otherwise
+
+*****************************************************************************/
+static int is_same_projection
+(
+    const IAS_PROJECTION *proj1,    /* I: first projection */
+    const IAS_PROJECTION *proj2     /* I: second projection */
+)
+{
+    int i;
+
+    if (proj1->proj_code != proj2->proj_code || proj1->zone != proj2->zone
+        || proj1->units != proj2->units
+        || proj1->spheroid != proj2->spheroid)
+        return FALSE;
+
+    for (i = 0; i < IAS_PROJ_PARAM_SIZE; i++)
+    {
+        if (proj1->parameters[i] != proj2->parameters[i])
+            return FALSE;
+    }
+
+    return TRUE;
+}
+
+/*****************************************************************************
+Name: ias_geo_get_cached_proj_transformation
+
+Purpose: Returns a projection transformation from the process-wide
+    transformation cache, creating it and adding it to the cache if it isn't
+    cached yet.  The transformations are keyed by the full source and target
+    projection definitions (projection code, zone, units, spheroid/datum and
+    parameters), so every module asking for the same projections shares one
+    transformation.
+
+Returns: A pointer to the transformation or NULL if there is an error.
+
+Notes:
+    - The transformation must be released with
+      ias_geo_release_cached_proj_transformation instead of being destroyed.
+    - Transformations are only evicted from the cache when nobody is using
+      them.  If every entry is in use, the transformation returned is not
+      cached and is destroyed when released.
+    - A cached transformation may be used by several threads at once only if
+      it is threadsafe.
+
+*****************************************************************************/
+IAS_GEO_PROJ_TRANSFORMATION *ias_geo_get_cached_proj_transformation
+(
+    const IAS_PROJECTION *source_projection, /* I: source projection */
+    const IAS_PROJECTION *target_projection /* I: target projection */
+)
+{
+    IAS_GEO_PROJ_TRANSFORMATION *trans = NULL; /* transformation returned */
+    TRANSFORMATION_CACHE_ENTRY *entry = NULL;  /* cache entry to use */
+    int hit = FALSE;        /* Flag that the transformation was cached */
+    int i;
+
+#ifdef _OPENMP
+    #pragma omp critical (transformation_cache)
+#endif
+    {
+        /* Look for the transformation in the cache.  Otherwise use the
+           least recently used entry that isn't in use. */
+        for (i = 0; i < TRANSFORMATION_CACHE_SIZE; i++)
+        {
+            TRANSFORMATION_CACHE_ENTRY *current = &transformation_cache[i];
+
+            if (current->trans
+                && is_same_projection(&current->source, source_projection)
+                && is_same_projection(&current->target, target_projection))
+            {
+                entry = current;
+                hit = TRUE;
+                break;
+            }
+            if (current->ref_count == 0 && (!entry || !current->trans
+                || (entry->trans && current->last_used < entry->last_used)))
+                entry = current;
+        }
+
+        if (entry && (!entry->trans
+            || !is_same_projection(&entry->source, source_projection)
+            || !is_same_projection(&entry->target, target_projection)))
+        {
+            /* Replace the entry with a new transformation */
+            ias_geo_destroy_proj_transformation(entry->trans);
+            entry->trans = ias_geo_create_proj_transformation(
+                source_projection, target_projection);
+            entry->source = *source_projection;
+            entry->target = *target_projection;
+            if (!entry->trans)
+                entry = NULL;
+        }
+
+        if (entry)
+        {
+            entry->ref_count++;
+            entry->last_used = ++transformation_cache_clock;
+            trans = entry->trans;
+        }
+    }
+
+    espa_metrics_cache(ESPA_METRICS_PROJECTION, hit);
+
+    /* Every entry is in use, so hand out an uncached transformation */
+    if (!entry)
+        trans = ias_geo_create_proj_transformation(source_projection,
+            target_projection);
+
+    if (!trans)
+        IAS_LOG_ERROR("Getting a cached projection transformation");
+
+    return trans;
+}
+
+/*****************************************************************************
+Name: ias_geo_release_cached_proj_transformation
+
+Purpose: Releases a transformation returned by
+    ias_geo_get_cached_proj_transformation.  Cached transformations stay in
+    the cache for the next user.
+
+Returns: nothing
+
+*****************************************************************************/
+void ias_geo_release_cached_proj_transformation
+(
+    IAS_GEO_PROJ_TRANSFORMATION *trans  /* I: transformation to release */
+)
+{
+    int cached = FALSE;     /* Flag that the transformation is cached */
+    int i;
+
+    if (!trans)
+        return;
+
+#ifdef _OPENMP
+    #pragma omp critical (transformation_cache)
+#endif
+    {
+        for (i = 0; i < TRANSFORMATION_CACHE_SIZE; i++)
+        {
+            if (transformation_cache[i].trans == trans)
+            {
+                transformation_cache[i].ref_count--;
+                cached = TRUE;
+                break;
+            }
+        }
+    }
+
+    if (!cached)
+        ias_geo_destroy_proj_transformation(trans);
+}
+
+/*****************************************************************************
+Name: ias_geo_clear_proj_transformation_cache
+
+Purpose: Destroys the cached transformations that aren't in use, such as when
+    a long running process is done with a set of products.
+
+Returns: nothing
+
+*****************************************************************************/
+void ias_geo_clear_proj_transformation_cache()
+{
+    int i;
+
+#ifdef _OPENMP
+    #pragma omp critical (transformation_cache)
+#endif
+    {
+        for (i = 0; i < TRANSFORMATION_CACHE_SIZE; i++)
+        {
+            if (transformation_cache[i].ref_count == 0)
+            {
+                ias_geo_destroy_proj_transformation(
+                    transformation_cache[i].trans);
+                transformation_cache[i].trans = NULL;
+            }
+        }
+    }
+}
+
+/****************************************************************************
+Name: ias_geo_is_threadsafe_transformation
+
+Purpose: Reports whether a transformation can be used in a threaded loop,
+    with each thread creating its own transformation from the same
+    projections.
+
+Returns:
+    TRUE if the transformation is threadsafe, FALSE otherwise
+
+****************************************************************************/
+int ias_geo_is_threadsafe_transformation
+(
+    const IAS_GEO_PROJ_TRANSFORMATION *trans /* I: transformation to check */
+)
+{
+    return gctp_is_threadsafe(trans->gctp_transform) ? TRUE : FALSE;
+}
+
 /****************************************************************************
 Name: ias_geo_only_allow_threadsafe_transforms
 
@@ -372,3 +603,73 @@ int ias_geo_transform_coordinate
     return SUCCESS;
 }
 
+
+/*****************************************************************************
+Name: ias_geo_transform_coordinates
+
+Purpose: Using a projection transformation, convert arrays of input
+    coordinates from the source projection to the target projection.
+
+Returns: SUCCESS or ERROR
+
+Notes:
+    - Each point gives the same result as ias_geo_transform_coordinate.
+    - Transformations without SOM coordinate swapping or DMS units pass the
+      arrays straight to GCTP, instead of checking them for every point.
+
+*****************************************************************************/
+int ias_geo_transform_coordinates
+(
+    const IAS_GEO_PROJ_TRANSFORMATION *trans, /* I: transformation to use */
+    int count,              /* I: Number of points */
+    const double *inx,      /* I: Input X projection coordinates */
+    const double *iny,      /* I: Input Y projection coordinates */
+    double *outx,           /* O: Output X projection coordinates */
+    double *outy            /* O: Output Y projection coordinates */
+)
+{
+    int status;          /* Status code from call to GCTP */
+    int index;           /* Point loop counter */
+
+    /* Verify the transformation provided is valid */
+    if (trans == NULL)
+    {
+        IAS_LOG_ERROR("Invalid transformation provided");
+        return ERROR;
+    }
+
+    /* Transform one point at a time when the coordinates need adjusting */
+    if (trans->source_is_som || trans->target_is_som || trans->source_is_dms
+        || trans->target_is_dms)
+    {
+        for (index = 0; index < count; index++)
+        {
+            if (ias_geo_transform_coordinate(trans, inx[index], iny[index],
+                    &outx[index], &outy[index]) != SUCCESS)
+            {
+                IAS_LOG_ERROR("Transforming point %d of %d", index, count);
+                return ERROR;
+            }
+        }
+        return SUCCESS;
+    }
+
+    /* Call the GCTP transformation routine */
+    status = gctp_transform_array(trans->gctp_transform, count, inx, iny,
+        outx, outy);
+    if (status != GCTP_SUCCESS)
+    {
+        if (status == GCTP_IN_BREAK)
+        {
+            /* We don't support any projections that can have break areas, so
+               just include some rudimentary support for it, but consider it an
+               error for now */
+            IAS_LOG_ERROR("In projection break");
+            return ERROR;
+        }
+        IAS_LOG_ERROR("Failed converting between coordinate systems in GCTP");
+        return ERROR;
+    }
+
+    return SUCCESS;
+}
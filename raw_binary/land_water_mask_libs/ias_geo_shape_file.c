@@ -211,7 +211,8 @@ static int ias_geo_write_polygons
 /*****************************************************************************
 NAME:  ias_geo_dump_polygon
 
-PURPOSE:  Dump the polygon list out to a file in the parent/child structure.
+PURPOSE:  Dump the polygon list out to a file in the parent/child structure,
+          followed by the spatial index of the polygon segments.
 
 RETURN VALUE:
 Type = int
@@ -321,13 +322,12 @@ int ias_geo_dump_polygon
         polygon = polygon->next;
         count++;
     } /* End of while loop */
-    free(offset);
-    offset = NULL;
 
     if (count != nparent_polygons)
     {
         IAS_LOG_ERROR("Number of parents found (%d) doesn't agree "
             "with the number reported (%d).", count, nparent_polygons);
+        free(offset);
         return ERROR;
     }
 
@@ -336,6 +336,7 @@ int ias_geo_dump_polygon
     if (fwrite(&zero, sizeof(unsigned int), 1, fp) != 1)
     {
         IAS_LOG_ERROR("Writing out end of file");
+        free(offset);
         return ERROR;
     }
 
@@ -343,8 +344,19 @@ int ias_geo_dump_polygon
     if (ias_geo_write_polygons(fp, head) != SUCCESS)
     {
        IAS_LOG_ERROR("Writing out the polygons");
+       free(offset);
        return ERROR;
     }
+
+    /* Append the spatial index of the polygon segments */
+    if (ias_geo_write_polygon_index(fp, head, npolygons, offset) != SUCCESS)
+    {
+       IAS_LOG_ERROR("Writing out the polygon index");
+       free(offset);
+       return ERROR;
+    }
+    free(offset);
+
     return SUCCESS;
 }
 
@@ -548,6 +560,9 @@ Value    Description
 SUCCESS  Successful completion
 ERROR    Operation failed
 
+NOTES: If the file has a spatial index, only the polygon segments that can
+       affect a point of the range of interest are read (see
+       ias_geo_load_indexed_polygon).  Otherwise the whole polygons are read.
 *****************************************************************************/
 int ias_geo_load_polygon
 (
@@ -569,10 +584,21 @@ int ias_geo_load_polygon
     int error_occured = FALSE;        /* Error tracking flag */
     IAS_DBL_XY *bb_max;               /* Bounding box max x/y values */
     IAS_DBL_XY *bb_min;               /* Bounding box min x/y values */
+    int indexed;                      /* Flag for a file with an index */
 
     /* Assume no polygons will be read */
     *head = NULL;
 
+    /* Read only the segments needed when the file is indexed */
+    if (ias_geo_load_indexed_polygon(fp, min_x, max_x, min_y, max_y, head,
+        &indexed) != SUCCESS)
+    {
+        IAS_LOG_ERROR("Reading the indexed polygons");
+        return ERROR;
+    }
+    if (indexed)
+        return SUCCESS;
+
     /* Read the number of "parent" polygons. */
     if (fread(&nparent_polygons, sizeof(unsigned int), 1, fp) != 1)
     {
@@ -793,12 +819,13 @@ void ias_geo_free_polygon_linked_list
 
     while (polygon)
     {
-        if (polygon->point_x)
+        /* Mapped vertices belong to the polygon store */
+        if (polygon->point_x && !polygon->mapped)
         {
             free(polygon->point_x);
         }
 
-        if (polygon->point_y)
+        if (polygon->point_y && !polygon->mapped)
         {
             free(polygon->point_y);
         }
@@ -870,13 +897,6 @@ int ias_geo_reduce_polygon
     polygon = *polygon_list;
     while (polygon)
     {
-        /* Remove unnecessary children. */
-        if (polygon->child)
-        {
-            ias_geo_reduce_polygon(&polygon->child, 
-                upper_left_x, lower_right_x, upper_left_y, lower_right_y);
-        }
-
         /* Keep track of next polygon */
         next = polygon->next;
 
@@ -912,6 +932,13 @@ int ias_geo_reduce_polygon
             polygon->next = NULL;
             ias_geo_free_polygon_linked_list(polygon);
         }
+        else if (polygon->child)
+        {
+            /* Remove unnecessary children of the polygons kept; the
+               children of those discarded go with them */
+            ias_geo_reduce_polygon(&polygon->child,
+                upper_left_x, lower_right_x, upper_left_y, lower_right_y);
+        }
 
         polygon = next;
     }
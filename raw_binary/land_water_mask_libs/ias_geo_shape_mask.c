@@ -12,10 +12,15 @@
 #include "ias_const.h"
 #include "gctp.h"
 #include "config.h"
+#include "espa_task_pool.h"
 
 /* Local Defines */
-#define GRID_SIZE_HORZ 20
-#define GRID_SIZE_VERT 20
+#define GRID_SIZE_HORZ 128
+#define GRID_SIZE_VERT 128
+#define MIN_GRID_SIZE 8
+#define INTERP_GRID_SIZE 16
+#define COARSE_CELL_SIZE 16     /* Must be a power of two */
+#define MIN_SCAN_BAND_LINES 64
 #define ALL_BITS_SET 255
 #define NO_BITS_SET 0
 
@@ -23,11 +28,1647 @@
 #error("This code does not properly support big endian")
 #endif
 
+/* Scanline rasterizer types.  The polygons are flattened into an array in
+   list order with each polygon followed by its children, so a parent always
+   precedes the polygons inside it. */
+typedef struct scan_polygon
+{
+    const IAS_POLYGON_LINKED_LIST *polygon; /* Polygon in the shape */
+    int parent;                 /* Index of the enclosing polygon, or -1 */
+    int depth;                  /* Nesting depth, 0 for top-level polygons */
+} SCAN_POLYGON;
+
+typedef struct scan_edge
+{
+    int polygon;                /* Index of the polygon of the edge */
+    unsigned int point;         /* Index of the first vertex of the edge */
+    unsigned int first_line;    /* First mask line crossing the edge */
+    unsigned int end_line;      /* Line after the last line crossing the edge */
+    double max_lng;             /* Crossings at or beyond this longitude only
+                                   count up to the segment and polygon max x */
+} SCAN_EDGE;
+
+typedef struct scan_crossing
+{
+    int polygon;                /* Index of the polygon of the crossing */
+    double lng;                 /* Longitude of the crossing */
+} SCAN_CROSSING;
+
+typedef struct scan_context
+{
+    const SCAN_POLYGON *polygons; /* Flattened polygons */
+    int num_levels;             /* Number of nesting levels */
+    const SCAN_EDGE *edges;     /* Edge table sorted by first line */
+    unsigned int num_edges;     /* Number of edges in the table */
+    const double *longitude;    /* Longitude of each sample */
+    const unsigned int *run_start; /* First sample of each increasing run */
+    unsigned int num_runs;      /* Number of increasing longitude runs */
+    unsigned int num_samples;   /* Number of samples in mask */
+    double upper_left_lat;      /* Latitude of the first mask line */
+    double delta_latitude;      /* Latitude step between lines */
+    const unsigned char *coarse_mask; /* Coarse mask buffer, or NULL */
+    const unsigned char *boundary; /* Flags the coarse cells edges cross,
+                                   or NULL */
+    unsigned int coarse_samples;/* Number of coarse cells in a row */
+} SCAN_CONTEXT;
+
+typedef struct scan_bands
+{
+    const SCAN_CONTEXT *context; /* Polygons, edges and sample locations */
+    unsigned int band_lines;    /* Number of lines in a band */
+    unsigned int num_lines;     /* Number of lines in mask */
+    unsigned char *mask;        /* Mask buffer */
+} SCAN_BANDS;
+
+/*****************************************************************************
+NAME:  flatten_polygons
+
+PURPOSE:  Count the polygons in a list and their children, filling in the
+          flattened polygon array when one is given.
+
+RETURN VALUE: None
+*****************************************************************************/
+static void flatten_polygons
+(
+    const IAS_POLYGON_LINKED_LIST *polygon, /* I: First polygon in list */
+    int parent,                 /* I: Index of the enclosing polygon */
+    int depth,                  /* I: Nesting depth of the list */
+    SCAN_POLYGON *polygons,     /* O: Flattened polygons (NULL to count) */
+    int *num_polygons,          /* I/O: Number of polygons */
+    int *num_levels             /* I/O: Number of nesting levels */
+)
+{
+    for (; polygon; polygon = polygon->next)
+    {
+        int index = (*num_polygons)++;  /* Index of this polygon */
+
+        if (polygons)
+        {
+            polygons[index].polygon = polygon;
+            polygons[index].parent = parent;
+            polygons[index].depth = depth;
+        }
+        if (depth + 1 > *num_levels)
+            *num_levels = depth + 1;
+
+        flatten_polygons(polygon->child, index, depth + 1, polygons,
+            num_polygons, num_levels);
+    }
+}
+
+/*****************************************************************************
+NAME:  first_line_below
+
+PURPOSE:  Find the first mask line whose latitude is below a limit, or at or
+          below it when the limit is inclusive.  Line latitudes decrease down
+          the mask, so the lines past the one returned all satisfy the test.
+
+RETURN VALUE:
+Type = unsigned int
+Value    Description
+-----    -----------
+line     First line meeting the limit, or num_lines if none does
+*****************************************************************************/
+static unsigned int first_line_below
+(
+    double upper_left_lat,      /* I: Latitude of the first line */
+    double delta_latitude,      /* I: Latitude step between lines */
+    unsigned int num_lines,     /* I: Number of lines in mask */
+    double limit,               /* I: Latitude limit */
+    int inclusive               /* I: Flag to accept lines at the limit */
+)
+{
+    unsigned int low = 0;       /* First line that may meet the limit */
+    unsigned int high = num_lines; /* Line known to meet the limit */
+
+    while (low < high)
+    {
+        unsigned int line = low + (high - low) / 2; /* Line to test */
+        double latitude = upper_left_lat - delta_latitude * line;
+
+        if (latitude < limit || (inclusive && latitude == limit))
+            high = line;
+        else
+            low = line + 1;
+    }
+
+    return low;
+}
+
+/*****************************************************************************
+NAME:  first_sample_at
+
+PURPOSE:  Find the first sample of a run of increasing sample longitudes whose
+          longitude is at or past a crossing.
+
+RETURN VALUE:
+Type = unsigned int
+Value    Description
+-----    -----------
+sample   First sample at or past the crossing, or the end of the run
+*****************************************************************************/
+static unsigned int first_sample_at
+(
+    const double *longitude,    /* I: Longitude of each sample */
+    unsigned int low,           /* I: First sample of the run */
+    unsigned int high,          /* I: Sample after the end of the run */
+    double lng                  /* I: Crossing longitude */
+)
+{
+    while (low < high)
+    {
+        unsigned int sample = low + (high - low) / 2; /* Sample to test */
+
+        if (longitude[sample] >= lng)
+            high = sample;
+        else
+            low = sample + 1;
+    }
+
+    return low;
+}
+
+/*****************************************************************************
+NAME:  compare_crossings
+
+PURPOSE:  qsort comparison ordering crossings by polygon, then longitude.
+
+RETURN VALUE:
+Type = int
+Value    Description
+-----    -----------
+<0,0,>0  Crossing a sorts before, with, or after crossing b
+*****************************************************************************/
+static int compare_crossings
+(
+    const void *a,              /* I: First crossing */
+    const void *b               /* I: Second crossing */
+)
+{
+    const SCAN_CROSSING *crossing_a = a;
+    const SCAN_CROSSING *crossing_b = b;
+
+    if (crossing_a->polygon != crossing_b->polygon)
+        return crossing_a->polygon < crossing_b->polygon ? -1 : 1;
+    if (crossing_a->lng < crossing_b->lng)
+        return -1;
+    return crossing_a->lng > crossing_b->lng;
+}
+
+/*****************************************************************************
+NAME:  compare_edges
+
+PURPOSE:  qsort comparison ordering edges by the first line they cross.
+
+RETURN VALUE:
+Type = int
+Value    Description
+-----    -----------
+<0,0,>0  Edge a sorts before, with, or after edge b
+*****************************************************************************/
+static int compare_edges
+(
+    const void *a,              /* I: First edge */
+    const void *b               /* I: Second edge */
+)
+{
+    const SCAN_EDGE *edge_a = a;
+    const SCAN_EDGE *edge_b = b;
+
+    if (edge_a->first_line != edge_b->first_line)
+        return edge_a->first_line < edge_b->first_line ? -1 : 1;
+    return 0;
+}
+
+/*****************************************************************************
+NAME:  add_edges
+
+PURPOSE:  Add the edges of a range of polygon vertices to the edge table,
+          keeping only the edges crossed by at least one mask line.
+
+RETURN VALUE: None
+*****************************************************************************/
+static void add_edges
+(
+    const IAS_POLYGON_LINKED_LIST *polygon, /* I: Polygon of the edges */
+    int polygon_index,          /* I: Index of the flattened polygon */
+    unsigned int first_point,   /* I: First vertex of the range */
+    unsigned int last_point,    /* I: Last vertex of the range */
+    double min_y,               /* I: Minimum latitude of the range bounds */
+    double max_y,               /* I: Maximum latitude of the range bounds */
+    double max_lng,             /* I: Crossing longitude bound of the range */
+    double upper_left_lat,      /* I: Latitude of the first mask line */
+    double delta_latitude,      /* I: Latitude step between lines */
+    unsigned int num_lines,     /* I: Number of lines in mask */
+    SCAN_EDGE *edges,           /* O: Edge table */
+    unsigned int *num_edges     /* I/O: Number of edges in the table */
+)
+{
+    unsigned int point;         /* Vertex loop counter */
+
+    for (point = first_point; point < last_point; point++)
+    {
+        double low = polygon->point_y[point];      /* Lower edge latitude */
+        double high = polygon->point_y[point + 1]; /* Upper edge latitude */
+        unsigned int first_line;   /* First line crossing the edge */
+        unsigned int end_line;     /* Line after the last crossing line */
+        unsigned int top_line;     /* First line inside the bounds */
+
+        if (low == high)
+            continue;
+        if (low > high)
+        {
+            low = high;
+            high = polygon->point_y[point];
+        }
+
+        /* A line crosses the edge when exactly one vertex is above it,
+           which is latitudes in [low, high), and the bounding boxes must
+           also contain the line for the crossing to be counted */
+        if (low < min_y)
+            low = min_y;
+        first_line = first_line_below(upper_left_lat, delta_latitude,
+            num_lines, high, FALSE);
+        top_line = first_line_below(upper_left_lat, delta_latitude,
+            num_lines, max_y, TRUE);
+        if (top_line > first_line)
+            first_line = top_line;
+        end_line = first_line_below(upper_left_lat, delta_latitude,
+            num_lines, low, FALSE);
+        if (first_line >= end_line)
+            continue;
+
+        edges[*num_edges].polygon = polygon_index;
+        edges[*num_edges].point = point;
+        edges[*num_edges].first_line = first_line;
+        edges[*num_edges].end_line = end_line;
+        edges[*num_edges].max_lng = max_lng;
+        (*num_edges)++;
+    }
+}
+
+/*****************************************************************************
+NAME:  mark_boundary_cells
+
+PURPOSE:  Mark the coarse cells a polygon side may cross.  The cells cover
+          the lines between the side's vertices and the samples within its
+          longitude range, widened by a line and a sample so crossings
+          rounded past the vertices are still covered.
+
+RETURN VALUE: None
+
+NOTES: Every side is marked, including the horizontal sides and the sides
+       between two lines that never enter the edge table, since the edges
+       on either side of them start or end on different samples.
+*****************************************************************************/
+static void mark_boundary_cells
+(
+    const IAS_POLYGON_LINKED_LIST *polygon, /* I: Polygon of the side */
+    unsigned int point,         /* I: Index of the first vertex of the side */
+    double upper_left_lat,      /* I: Latitude of the first mask line */
+    double delta_latitude,      /* I: Latitude step between lines */
+    const double *longitude,    /* I: Longitude of each sample */
+    const unsigned int *run_start, /* I: First sample of each run */
+    unsigned int num_runs,      /* I: Number of increasing longitude runs */
+    unsigned int num_lines,     /* I: Number of lines in mask */
+    unsigned int num_samples,   /* I: Number of samples in mask */
+    unsigned int coarse_samples,/* I: Number of coarse cells in a row */
+    unsigned char *boundary     /* I/O: Boundary flag of each coarse cell */
+)
+{
+    double min_x = polygon->point_x[point];     /* Side west limit */
+    double max_x = polygon->point_x[point + 1]; /* Side east limit */
+    double min_y = polygon->point_y[point];     /* Side south limit */
+    double max_y = polygon->point_y[point + 1]; /* Side north limit */
+    unsigned int first_line;    /* First line below the side */
+    unsigned int end_line;      /* First line below the whole side */
+    unsigned int first_row;     /* First coarse row crossed */
+    unsigned int last_row;      /* Last coarse row crossed */
+    unsigned int run;           /* Run loop counter */
+
+    if (min_x > max_x)
+    {
+        min_x = max_x;
+        max_x = polygon->point_x[point];
+    }
+    if (min_y > max_y)
+    {
+        min_y = max_y;
+        max_y = polygon->point_y[point];
+    }
+
+    /* Sides entirely above or below the mask lines change no sample */
+    first_line = first_line_below(upper_left_lat, delta_latitude, num_lines,
+        max_y, FALSE);
+    end_line = first_line_below(upper_left_lat, delta_latitude, num_lines,
+        min_y, FALSE);
+    if (end_line == 0 || first_line == num_lines)
+        return;
+
+    first_row = (first_line > 0 ? first_line - 1 : 0) / COARSE_CELL_SIZE;
+    last_row = (end_line < num_lines ? end_line : num_lines - 1)
+        / COARSE_CELL_SIZE;
+
+    for (run = 0; run < num_runs; run++)
+    {
+        unsigned int low;       /* First sample in the longitude range */
+        unsigned int high;      /* Sample after the longitude range */
+        unsigned int first_col; /* First coarse column crossed */
+        unsigned int last_col;  /* Last coarse column crossed */
+        unsigned int row;       /* Coarse row loop counter */
+
+        low = first_sample_at(longitude, run_start[run], run_start[run + 1],
+            min_x);
+        high = first_sample_at(longitude, low, run_start[run + 1], max_x);
+        first_col = (low > 0 ? low - 1 : 0) / COARSE_CELL_SIZE;
+        last_col = (high < num_samples ? high : num_samples - 1)
+            / COARSE_CELL_SIZE;
+
+        for (row = first_row; row <= last_row; row++)
+        {
+            memset(&boundary[(size_t)row * coarse_samples + first_col], 1,
+                last_col - first_col + 1);
+        }
+    }
+}
+
+/*****************************************************************************
+NAME:  fill_coarse_cells
+
+PURPOSE:  Set the bits of one mask line in the coarse cells no edge crosses,
+          from the coarse mask value of each cell.
+
+RETURN VALUE: None
+*****************************************************************************/
+static void fill_coarse_cells
+(
+    const unsigned char *coarse_mask, /* I: Coarse mask buffer */
+    const unsigned char *boundary_row, /* I: Boundary flags of the cell row */
+    unsigned int coarse_row,    /* I: Coarse row of the line */
+    unsigned int coarse_samples,/* I: Number of coarse cells in a row */
+    unsigned int line,          /* I: Mask line to fill */
+    unsigned int num_samples,   /* I: Number of samples in mask */
+    unsigned char *mask         /* I/O: Mask buffer */
+)
+{
+    unsigned int cell;          /* Coarse cell loop counter */
+
+    for (cell = 0; cell < coarse_samples; )
+    {
+        size_t coarse_index = (size_t)coarse_row * coarse_samples + cell;
+        size_t first_bit;       /* First mask bit of the span */
+        size_t end_bit;         /* Mask bit after the span */
+        unsigned int end_cell;  /* Cell after the span */
+
+        if (boundary_row[cell] || !(coarse_mask[coarse_index / 8]
+            & (1 << (7 - coarse_index % 8))))
+        {
+            cell++;
+            continue;
+        }
+
+        /* Extend the span over the following inside cells */
+        for (end_cell = cell + 1; end_cell < coarse_samples; end_cell++)
+        {
+            coarse_index++;
+            if (boundary_row[end_cell] || !(coarse_mask[coarse_index / 8]
+                & (1 << (7 - coarse_index % 8))))
+                break;
+        }
+
+        first_bit = (size_t)line * num_samples + cell * COARSE_CELL_SIZE;
+        end_bit = (size_t)line * num_samples + (end_cell * COARSE_CELL_SIZE
+            < num_samples ? end_cell * COARSE_CELL_SIZE : num_samples);
+        for (; first_bit < end_bit && first_bit % 8 != 0; first_bit++)
+            mask[first_bit / 8] |= 1 << (7 - first_bit % 8);
+        if (end_bit / 8 > first_bit / 8)
+        {
+            memset(&mask[first_bit / 8], ALL_BITS_SET,
+                end_bit / 8 - first_bit / 8);
+            first_bit = end_bit / 8 * 8;
+        }
+        for (; first_bit < end_bit; first_bit++)
+            mask[first_bit / 8] |= 1 << (7 - first_bit % 8);
+
+        cell = end_cell;
+    }
+}
+
+/*****************************************************************************
+NAME:  scan_lines
+
+PURPOSE:  Set the mask bits of the sample locations inside the polygons for
+          a band of mask lines, using an active edge table scanned down the
+          band.
+
+RETURN VALUE:
+Type = int
+Value    Description
+-----    -----------
+SUCCESS  Successful completion
+ERROR    Operation failed
+
+NOTES: Each band has its own active edge table and claim stamps, and only
+       sets bits of its own lines, so bands starting on lines whose first
+       bit starts a byte can be scanned at the same time.
+*****************************************************************************/
+static int scan_lines
+(
+    const SCAN_CONTEXT *context,/* I: Polygons, edges and sample locations */
+    unsigned int first_line,    /* I: First line of the band */
+    unsigned int end_line,      /* I: Line after the band */
+    unsigned char *mask         /* I/O: Mask buffer, cleared on input */
+)
+{
+    const SCAN_POLYGON *polygons = context->polygons;
+    const SCAN_EDGE *edges = context->edges;
+    const double *longitude = context->longitude;
+    const unsigned int *run_start = context->run_start;
+    unsigned int num_samples = context->num_samples;
+    unsigned int *active;           /* Active edge table */
+    SCAN_CROSSING *crossings;       /* Crossings of the current line */
+    unsigned int *stamp;            /* Line that last claimed each sample at
+                                       each nesting level, plus one */
+    int *owner;                     /* Polygon that claimed each sample at
+                                       each nesting level */
+    unsigned int num_active = 0;    /* Number of active edges */
+    unsigned int next_edge;         /* Next edge to activate */
+    unsigned int line;              /* Line counter */
+    unsigned int sample;            /* Sample counter */
+
+    active = malloc(context->num_edges * sizeof(*active) + 1);
+    crossings = malloc(context->num_edges * sizeof(*crossings) + 1);
+    stamp = calloc((size_t)context->num_levels * num_samples,
+        sizeof(*stamp));
+    owner = malloc((size_t)context->num_levels * num_samples
+        * sizeof(*owner));
+    if (!active || !crossings || !stamp || !owner)
+    {
+        IAS_LOG_ERROR("Allocating memory for the scanline rasterizer");
+        free(active);
+        free(crossings);
+        free(stamp);
+        free(owner);
+        return ERROR;
+    }
+
+    /* Start with the edges already crossing the first line of the band */
+    for (next_edge = 0; next_edge < context->num_edges
+         && edges[next_edge].first_line <= first_line; next_edge++)
+    {
+        if (edges[next_edge].end_line > first_line)
+            active[num_active++] = next_edge;
+    }
+
+    /* Scan the lines down the band */
+    for (line = first_line; line < end_line; line++)
+    {
+        double latitude = context->upper_left_lat
+            - context->delta_latitude * line;
+        unsigned int num_crossings = 0; /* Crossings on this line */
+        unsigned int current;       /* Crossing loop counter */
+        unsigned int kept;          /* Number of edges kept active */
+        const unsigned char *boundary_row = NULL; /* Cell flags of the line */
+
+        if (context->boundary)
+        {
+            boundary_row = context->boundary + (size_t)(line
+                / COARSE_CELL_SIZE) * context->coarse_samples;
+            fill_coarse_cells(context->coarse_mask, boundary_row,
+                line / COARSE_CELL_SIZE, context->coarse_samples, line,
+                num_samples, mask);
+        }
+
+        /* Retire the edges that ended and activate the ones starting */
+        for (current = 0, kept = 0; current < num_active; current++)
+        {
+            if (edges[active[current]].end_line > line)
+                active[kept++] = active[current];
+        }
+        num_active = kept;
+        while (next_edge < context->num_edges
+            && edges[next_edge].first_line <= line)
+            active[num_active++] = next_edge++;
+
+        if (num_active == 0)
+            continue;
+
+        /* Find where each active edge crosses the line, with the expression
+           used by ias_math_point_in_closed_polygon_distance */
+        for (current = 0; current < num_active; current++)
+        {
+            const SCAN_EDGE *edge = &edges[active[current]];
+            const IAS_POLYGON_LINKED_LIST *polygon
+                = polygons[edge->polygon].polygon;
+            const double *vert_x = polygon->point_x;
+            const double *vert_y = polygon->point_y;
+            unsigned int point = edge->point;
+            double lng;                 /* Crossing longitude */
+
+            lng = (vert_x[point + 1] - vert_x[point]) * (latitude
+                - vert_y[point]) / (vert_y[point + 1] - vert_y[point])
+                + vert_x[point];
+            if (lng > edge->max_lng)
+                lng = edge->max_lng;
+
+            crossings[num_crossings].polygon = edge->polygon;
+            crossings[num_crossings].lng = lng;
+            num_crossings++;
+        }
+        qsort(crossings, num_crossings, sizeof(*crossings), compare_crossings);
+
+        /* Fill the spans of each polygon crossed by the line.  Parents sort
+           before their children, so each level is claimed before the next
+           level checks it. */
+        for (current = 0; current < num_crossings; )
+        {
+            int polygon_index = crossings[current].polygon;
+            int depth = polygons[polygon_index].depth;
+            int parent = polygons[polygon_index].parent;
+            unsigned int *level_stamp = stamp + (size_t)depth * num_samples;
+            int *level_owner = owner + (size_t)depth * num_samples;
+            const unsigned int *parent_stamp = level_stamp - num_samples;
+            const int *parent_owner = level_owner - num_samples;
+            unsigned int first = current;   /* First crossing of polygon */
+            unsigned int count;     /* Number of crossings of polygon */
+            unsigned int run;       /* Run loop counter */
+
+            while (current < num_crossings
+                && crossings[current].polygon == polygon_index)
+                current++;
+            count = current - first;
+
+            for (run = 0; run < context->num_runs; run++)
+            {
+                unsigned int start = run_start[run]; /* Start of the span */
+                unsigned int crossing;  /* Crossing loop counter */
+
+                /* Samples before the i-th crossing have count - i crossings
+                   east of them, so the spans with an odd count are inside */
+                for (crossing = 0; crossing <= count; crossing++)
+                {
+                    unsigned int end = run_start[run + 1]; /* Span end */
+
+                    if (crossing < count)
+                        end = first_sample_at(longitude, start, end,
+                            crossings[first + crossing].lng);
+
+                    if ((count - crossing) % 2 == 1)
+                    {
+                        for (sample = start; sample < end; sample++)
+                        {
+                            unsigned int mask_index; /* Bit in the mask */
+
+                            /* Skip to the next cell when no edge crosses
+                               this one */
+                            if (boundary_row && !boundary_row[sample
+                                / COARSE_CELL_SIZE])
+                            {
+                                sample |= COARSE_CELL_SIZE - 1;
+                                continue;
+                            }
+                            if (level_stamp[sample] == line + 1)
+                                continue;
+                            if (depth > 0 && (parent_stamp[sample] != line + 1
+                                || parent_owner[sample] != parent))
+                                continue;
+
+                            level_stamp[sample] = line + 1;
+                            level_owner[sample] = polygon_index;
+
+                            mask_index = line * num_samples + sample;
+                            mask[mask_index / 8] ^= 1 << (7 - mask_index % 8);
+                        }
+                    }
+                    start = end;
+                }
+            }
+        }
+    }
+
+    free(active);
+    free(crossings);
+    free(stamp);
+    free(owner);
+
+    return SUCCESS;
+}
+
+/*****************************************************************************
+NAME:  scan_band
+
+PURPOSE:  Scan one band of mask lines, as an iteration of the loop over the
+          bands.
+
+RETURN VALUE:
+Type = int
+Value    Description
+-----    -----------
+SUCCESS  Successful completion
+ERROR    Operation failed
+*****************************************************************************/
+static int scan_band
+(
+    void *arg,                  /* I/O: Bands of the mask */
+    int band,                   /* I: Band to scan */
+    int worker                  /* I: Worker scanning the band (unused) */
+)
+{
+    const SCAN_BANDS *bands = arg; /* Bands of the mask */
+    unsigned int first_line = band * bands->band_lines; /* First line */
+    unsigned int end_line = first_line + bands->band_lines; /* End line */
+
+    if (end_line > bands->num_lines)
+        end_line = bands->num_lines;
+
+    return scan_lines(bands->context, first_line, end_line, bands->mask);
+}
+
+/*****************************************************************************
+NAME:  rasterize_polygons
+
+PURPOSE:  Set the mask bits of the sample locations inside a set of polygons
+          using an active edge table scanned down the mask lines.
+
+RETURN VALUE:
+Type = int
+Value    Description
+-----    -----------
+SUCCESS  Successful completion
+ERROR    Operation failed
+
+NOTES: The result matches testing every sample with
+       ias_geo_point_in_shape_distance in the x direction.  Each line
+       computes the longitude where every active edge crosses it with the same
+       expression, once instead of once per sample, and applies the same
+       segment and polygon bounding box tests.  A sample is inside a polygon
+       when an odd number of its crossings lie east of the sample.  Within a
+       polygon list the first polygon containing a sample claims it, and a
+       polygon's children only claim samples their parent claimed, so every
+       claim toggles the sample between outside and inside.
+
+       With a coarse mask, holding the first sample of each cell of
+       COARSE_CELL_SIZE lines and samples, only the cells a polygon side may
+       cross are filled a sample at a time.  No crossing moves past the
+       samples of the other cells, so every sample in them matches the
+       coarse mask.
+
+       Every line is computed on its own, so the lines are split into bands
+       of a multiple of 8 lines scanned in parallel on the task pool, with
+       the same result as a single band.
+*****************************************************************************/
+static int rasterize_polygons
+(
+    const IAS_POLYGON_LINKED_LIST *polygon_list, /* I: Polygon list */
+    unsigned int num_lines,     /* I: Number of lines in mask */
+    unsigned int num_samples,   /* I: Number of samples in mask */
+    double upper_left_lat,      /* I: Upper left latitude for mask */
+    double upper_left_long,     /* I: Upper left longitude for mask */
+    double delta_latitude,      /* I: Latitude step between lines */
+    double delta_longitude,     /* I: Longitude step between samples */
+    const unsigned char *coarse_mask, /* I: Coarse mask buffer, or NULL to
+                                   fill every sample */
+    unsigned char *mask         /* I/O: Mask buffer, cleared on input */
+)
+{
+    SCAN_CONTEXT context;           /* Shared state of the bands */
+    SCAN_BANDS bands;               /* Bands of the mask */
+    SCAN_POLYGON *polygons = NULL;  /* Flattened polygons */
+    SCAN_EDGE *edges = NULL;        /* Edge table sorted by first line */
+    double *longitude = NULL;       /* Longitude of each sample */
+    unsigned int *run_start = NULL; /* First sample of each increasing run */
+    unsigned char *boundary = NULL; /* Flags the coarse cells edges cross */
+    unsigned int coarse_samples = 0;/* Number of coarse cells in a row */
+    int num_polygons = 0;           /* Number of polygons */
+    int num_levels = 0;             /* Number of nesting levels */
+    unsigned int num_edges = 0;     /* Number of edges in the table */
+    unsigned int num_runs = 0;      /* Number of increasing longitude runs */
+    unsigned int max_edges = 0;     /* Number of polygon edges */
+    unsigned int band_lines;        /* Number of lines in a band */
+    int num_bands;                  /* Number of bands */
+    int status;                     /* Status of the bands */
+    unsigned int sample;            /* Sample counter */
+    int index;                      /* Polygon counter */
+
+    if (num_lines == 0 || num_samples == 0)
+        return SUCCESS;
+
+    flatten_polygons(polygon_list, -1, 0, NULL, &num_polygons, &num_levels);
+    if (num_polygons == 0)
+        return SUCCESS;
+
+    /* Compute the sample longitudes once, since every line shares them, and
+       split them into runs of increasing longitude at the 180 crossing */
+    longitude = malloc(num_samples * sizeof(*longitude));
+    run_start = malloc((num_samples + 1) * sizeof(*run_start));
+    polygons = malloc(num_polygons * sizeof(*polygons));
+    if (!longitude || !run_start || !polygons)
+    {
+        IAS_LOG_ERROR("Allocating memory for the scanline rasterizer");
+        free(longitude);
+        free(run_start);
+        free(polygons);
+        return ERROR;
+    }
+
+    for (sample = 0; sample < num_samples; sample++)
+    {
+        longitude[sample] = upper_left_long + delta_longitude * sample;
+
+        /* Adjust for 180 crossing. */
+        if (longitude[sample] >= 180)
+        {
+            longitude[sample] -= 360;
+        }
+
+        if (sample == 0 || longitude[sample] < longitude[sample - 1])
+            run_start[num_runs++] = sample;
+    }
+    run_start[num_runs] = num_samples;
+
+    num_polygons = 0;
+    num_levels = 0;
+    flatten_polygons(polygon_list, -1, 0, polygons, &num_polygons,
+        &num_levels);
+
+    /* Build the edge table from the polygon segments, or from every side of
+       polygons without segments */
+    for (index = 0; index < num_polygons; index++)
+    {
+        const IAS_POLYGON_LINKED_LIST *polygon = polygons[index].polygon;
+
+        if (polygon->num_points < 4)
+        {
+            IAS_LOG_ERROR("Need at least three sides for polygon %u.",
+                polygon->id);
+            free(longitude);
+            free(run_start);
+            free(polygons);
+            return ERROR;
+        }
+        max_edges += polygon->num_points - 1;
+    }
+
+    edges = malloc(max_edges * sizeof(*edges));
+    if (!edges)
+    {
+        IAS_LOG_ERROR("Allocating memory for the polygon edge table");
+        free(longitude);
+        free(run_start);
+        free(polygons);
+        return ERROR;
+    }
+
+    for (index = 0; index < num_polygons; index++)
+    {
+        const IAS_POLYGON_LINKED_LIST *polygon = polygons[index].polygon;
+        double polygon_max_lng = nextafter(polygon->max_x, HUGE_VAL);
+
+        if (polygon->num_segs > 0)
+        {
+            unsigned int segment;   /* Segment loop counter */
+
+            for (segment = 0; segment < polygon->num_segs; segment++)
+            {
+                const IAS_POLYGON_SEGMENT *seg = &polygon->poly_seg[segment];
+                double max_lng = nextafter(seg->max_x, HUGE_VAL);
+
+                if (max_lng > polygon_max_lng)
+                    max_lng = polygon_max_lng;
+
+                add_edges(polygon, index, seg->first_point, seg->last_point,
+                    seg->min_y > polygon->min_y ? seg->min_y : polygon->min_y,
+                    seg->max_y < polygon->max_y ? seg->max_y : polygon->max_y,
+                    max_lng, upper_left_lat, delta_latitude, num_lines,
+                    edges, &num_edges);
+            }
+        }
+        else
+        {
+            add_edges(polygon, index, 0, polygon->num_points - 1,
+                polygon->min_y, polygon->max_y, polygon_max_lng,
+                upper_left_lat, delta_latitude, num_lines, edges, &num_edges);
+        }
+    }
+    qsort(edges, num_edges, sizeof(*edges), compare_edges);
+
+    /* Flag the coarse cells the polygon sides may cross */
+    if (coarse_mask)
+    {
+        unsigned int coarse_lines = (num_lines + COARSE_CELL_SIZE - 1)
+            / COARSE_CELL_SIZE;
+
+        coarse_samples = (num_samples + COARSE_CELL_SIZE - 1)
+            / COARSE_CELL_SIZE;
+        boundary = calloc((size_t)coarse_lines * coarse_samples,
+            sizeof(*boundary));
+        if (!boundary)
+        {
+            IAS_LOG_ERROR("Allocating memory for the coarse cell flags");
+            free(edges);
+            free(longitude);
+            free(run_start);
+            free(polygons);
+            return ERROR;
+        }
+
+        for (index = 0; index < num_polygons; index++)
+        {
+            const IAS_POLYGON_LINKED_LIST *polygon = polygons[index].polygon;
+            unsigned int point;     /* Vertex loop counter */
+
+            for (point = 0; point < polygon->num_points - 1; point++)
+            {
+                mark_boundary_cells(polygon, point, upper_left_lat,
+                    delta_latitude, longitude, run_start, num_runs,
+                    num_lines, num_samples, coarse_samples, boundary);
+            }
+        }
+    }
+
+    context.polygons = polygons;
+    context.num_levels = num_levels;
+    context.edges = edges;
+    context.num_edges = num_edges;
+    context.longitude = longitude;
+    context.run_start = run_start;
+    context.num_runs = num_runs;
+    context.num_samples = num_samples;
+    context.upper_left_lat = upper_left_lat;
+    context.delta_latitude = delta_latitude;
+    context.coarse_mask = coarse_mask;
+    context.boundary = boundary;
+    context.coarse_samples = coarse_samples;
+
+    /* Split the lines into bands, a few per thread so uneven bands even
+       out.  Each band starts the active edge table over, so the bands are
+       kept to at least MIN_SCAN_BAND_LINES lines. */
+    num_bands = 1;
+    if (espa_task_pool_threads() > 1)
+        num_bands = 4 * espa_task_pool_threads();
+    band_lines = (num_lines + num_bands - 1) / num_bands;
+    if (band_lines < MIN_SCAN_BAND_LINES)
+        band_lines = MIN_SCAN_BAND_LINES;
+    band_lines = (band_lines + 7) / 8 * 8;
+    num_bands = (num_lines + band_lines - 1) / band_lines;
+
+    bands.context = &context;
+    bands.band_lines = band_lines;
+    bands.num_lines = num_lines;
+    bands.mask = mask;
+    status = espa_parallel_for(num_bands, 0, scan_band, &bands);
+
+    free(boundary);
+    free(edges);
+    free(longitude);
+    free(run_start);
+    free(polygons);
+
+    return status;
+}
+
+/*****************************************************************************
+NAME:  create_geographic_mask
+
+PURPOSE:  Generate a mask image (per-bit buffer) based on a set of polygons
+          from an opened polygon file, loaded at the coarsest level of detail
+          within an error.
+
+RETURN VALUE:
+Type = int
+Value    Description
+-----    -----------
+SUCCESS  Successful completion
+ERROR    Operation failed
+
+NOTES: The polygons are scan converted a line at a time rather than testing
+       each sample, first at COARSE_CELL_SIZE times the sample spacing and
+       then at full resolution only near the polygon boundaries.
+*****************************************************************************/
+static int create_geographic_mask
+(
+    const IAS_POLYGON_STORE *store, /* I: Opened polygon file */
+    double max_polygon_error,   /* I: Largest polygon vertex error allowed,
+                                   in degrees */
+    unsigned int num_lines,     /* I: Number of lines in mask */
+    unsigned int num_samples,   /* I: Number of samples in mask */
+    double upper_left_lat,      /* I: Upper left latitude for mask */
+    double lower_right_lat,     /* I: Lower right latitude for mask */
+    double upper_left_long,     /* I: Upper left longitude for mask */
+    double lower_right_long,    /* I: Lower right longitude for mask */
+    unsigned char *mask         /* O: Mask buffer */
+)
+{
+    double delta_latitude;      /* Delta latitude */
+    double delta_longitude;     /* Delta longitude */
+    IAS_POLYGON_LINKED_LIST *polygon_list; /* Polygon linked list pointer */
+    unsigned char *coarse_mask = NULL; /* Mask of the coarse cells */
+
+    /* Load the polygons.  They may point into the mapped polygon file, so
+       they are freed before returning. */
+    if (ias_geo_load_polygon_store_level(store, max_polygon_error,
+        upper_left_long, lower_right_long, lower_right_lat, upper_left_lat,
+        &polygon_list) != SUCCESS)
+    {
+        IAS_LOG_ERROR("Loading the polygons");
+        return ERROR;
+    }
+
+    /* Discard polygons outside the bounding box. */
+    if (ias_geo_reduce_polygon(&polygon_list, upper_left_long, lower_right_long,
+        upper_left_lat, lower_right_lat) != SUCCESS)
+    {
+        IAS_LOG_ERROR("Reducing the polygon");
+        ias_geo_free_polygon_linked_list(polygon_list);
+        return ERROR;
+    }
+
+    /* Initialize the mask to all zeros. */
+    memset(mask, 0, num_lines * num_samples / 8 + 1);
+
+    /* Determine the mask value for each sample location. */
+    delta_latitude = (upper_left_lat - lower_right_lat) / num_lines;
+    if (lower_right_long >= upper_left_long)
+    {
+        delta_longitude = (lower_right_long - upper_left_long) / num_samples;
+    }
+    else
+    {
+        delta_longitude = (lower_right_long - upper_left_long + 360) 
+            / num_samples;
+    }
+
+    /* Rasterize the first sample of each coarse cell.  The coarse steps
+       are exact multiples of the full ones, so each coarse sample is at
+       exactly the location of its full resolution sample. */
+    if (num_lines > COARSE_CELL_SIZE && num_samples > COARSE_CELL_SIZE)
+    {
+        unsigned int coarse_lines = (num_lines + COARSE_CELL_SIZE - 1)
+            / COARSE_CELL_SIZE;
+        unsigned int coarse_samples = (num_samples + COARSE_CELL_SIZE - 1)
+            / COARSE_CELL_SIZE;
+
+        coarse_mask = calloc((size_t)coarse_lines * coarse_samples / 8 + 1,
+            sizeof(*coarse_mask));
+        if (!coarse_mask)
+        {
+            IAS_LOG_ERROR("Allocating memory for the coarse mask");
+            ias_geo_free_polygon_linked_list(polygon_list);
+            return ERROR;
+        }
+
+        if (rasterize_polygons(polygon_list, coarse_lines, coarse_samples,
+            upper_left_lat, upper_left_long,
+            delta_latitude * COARSE_CELL_SIZE,
+            delta_longitude * COARSE_CELL_SIZE, NULL, coarse_mask) != SUCCESS)
+        {
+            IAS_LOG_ERROR("Rasterizing the coarse mask");
+            free(coarse_mask);
+            ias_geo_free_polygon_linked_list(polygon_list);
+            return ERROR;
+        }
+    }
+
+    /* Set the bits of the sample locations inside the polygons, refining
+       only the coarse cells near the polygon boundaries. */
+    if (rasterize_polygons(polygon_list, num_lines, num_samples,
+        upper_left_lat, upper_left_long, delta_latitude, delta_longitude,
+        coarse_mask, mask) != SUCCESS)
+    {
+        IAS_LOG_ERROR("Rasterizing the polygons");
+        free(coarse_mask);
+        ias_geo_free_polygon_linked_list(polygon_list);
+        return ERROR;
+    }
+
+    /* Free storage. */
+    free(coarse_mask);
+    ias_geo_free_polygon_linked_list(polygon_list);
+
+    return SUCCESS;
+}
+
+/*****************************************************************************
+NAME:  copy_mask_columns
+
+PURPOSE:  Copy the set bits of a mask of some of the samples into the
+          columns of a wider mask starting at a given sample.
+
+RETURN VALUE: None
+
+*****************************************************************************/
+static void copy_mask_columns
+(
+    const unsigned char *piece, /* I: Mask of the columns */
+    unsigned int num_lines,     /* I: Number of lines in both masks */
+    unsigned int piece_samples, /* I: Number of samples in the columns */
+    unsigned int num_samples,   /* I: Number of samples in the wide mask */
+    unsigned int first_sample,  /* I: Sample of the wide mask the columns
+                                   start at */
+    unsigned char *mask         /* I/O: Wide mask */
+)
+{
+    size_t piece_index = 0;     /* Bit of the column mask */
+    size_t mask_index;          /* Bit of the wide mask */
+    unsigned int line;          /* Line counter */
+    unsigned int sample;        /* Sample counter */
+
+    for (line = 0; line < num_lines; line++)
+    {
+        mask_index = (size_t)line * num_samples + first_sample;
+        for (sample = 0; sample < piece_samples; sample++, piece_index++,
+            mask_index++)
+        {
+            if (piece[piece_index / 8] & (1 << (7 - piece_index % 8)))
+                mask[mask_index / 8] |= 1 << (7 - mask_index % 8);
+        }
+    }
+}
+
+/*****************************************************************************
+NAME:  create_split_geographic_mask
+
+PURPOSE:  Generate a mask image (per-bit buffer) for a window which crosses
+          the 180 degree meridian, from the two windows on either side of
+          it.
+
+RETURN VALUE:
+Type = int
+Value    Description
+-----    -----------
+SUCCESS  Successful completion
+ERROR    Operation failed
+
+NOTES: The longitudes of the window run continuously past 180, so the lower
+       right longitude is above 180.  The samples west of 180 and those from
+       180 east are each rasterized over a tight window of their own, whose
+       polygons are loaded and reduced with longitudes in -180 to 180, and
+       the two masks are copied side by side into the mask.  The samples
+       keep the longitudes of a single window.
+*****************************************************************************/
+static int create_split_geographic_mask
+(
+    const IAS_POLYGON_STORE *store, /* I: Opened polygon file */
+    double max_polygon_error,   /* I: Largest polygon vertex error allowed,
+                                   in degrees */
+    unsigned int num_lines,     /* I: Number of lines in mask */
+    unsigned int num_samples,   /* I: Number of samples in mask */
+    double upper_left_lat,      /* I: Upper left latitude for mask */
+    double lower_right_lat,     /* I: Lower right latitude for mask */
+    double upper_left_long,     /* I: Upper left longitude for mask, below
+                                   180 */
+    double lower_right_long,    /* I: Lower right longitude for mask, above
+                                   180 */
+    unsigned char *mask         /* O: Mask buffer */
+)
+{
+    double delta_longitude;     /* Delta longitude */
+    double first_long;          /* Longitude of the first sample of a side */
+    unsigned int west_samples;  /* Number of samples west of 180 */
+    unsigned int first_sample;  /* First sample of a side */
+    unsigned int side_samples;  /* Number of samples of a side */
+    unsigned char *side_mask;   /* Mask of a side */
+    int side;                   /* Side counter: west, then east */
+
+    memset(mask, 0, num_lines * num_samples / 8 + 1);
+
+    delta_longitude = (lower_right_long - upper_left_long) / num_samples;
+    west_samples = ceil((180.0 - upper_left_long) / delta_longitude);
+    if (west_samples > num_samples)
+        west_samples = num_samples;
+
+    for (side = 0; side < 2; side++)
+    {
+        first_sample = side == 0 ? 0 : west_samples;
+        side_samples = side == 0 ? west_samples : num_samples - west_samples;
+        if (side_samples == 0)
+            continue;
+
+        first_long = upper_left_long + delta_longitude * first_sample;
+        if (side == 1)
+            first_long -= 360.0;
+
+        side_mask = malloc((size_t)num_lines * side_samples / 8 + 1);
+        if (!side_mask)
+        {
+            IAS_LOG_ERROR("Allocating memory for the mask of one side of "
+                "the 180 degree meridian");
+            return ERROR;
+        }
+
+        if (create_geographic_mask(store, max_polygon_error, num_lines,
+            side_samples, upper_left_lat, lower_right_lat, first_long,
+            first_long + delta_longitude * side_samples, side_mask)
+            != SUCCESS)
+        {
+            IAS_LOG_ERROR("Creating the mask %s of the 180 degree meridian",
+                side == 0 ? "west" : "east");
+            free(side_mask);
+            return ERROR;
+        }
+
+        copy_mask_columns(side_mask, num_lines, side_samples, num_samples,
+            first_sample, mask);
+        free(side_mask);
+    }
+
+    return SUCCESS;
+}
+
+/*****************************************************************************
+NAME:  ias_geo_shape_mask_store
+
+PURPOSE:  Generate a mask image (per-bit buffer) based on a set of polygons
+          from an opened polygon file.  Values of zero denote locations
+          outside the polygons, values of one represent locations inside a
+          polygon.
+
+RETURN VALUE:
+Type = int
+Value    Description
+-----    -----------
+SUCCESS  Successful completion
+ERROR    Operation failed
+
+NOTES: The polygon store can be kept open across masks, so a batch of
+       scenes opens and maps the polygon file once.  The full polygons are
+       used.  A window whose lower right longitude is west of its upper left
+       one crosses the 180 degree meridian, and is rasterized as the two
+       windows on either side of it.
+*****************************************************************************/
+int ias_geo_shape_mask_store
+(
+    const IAS_POLYGON_STORE *store, /* I: Opened polygon file */
+    unsigned int num_lines,     /* I: Number of lines in mask */
+    unsigned int num_samples,   /* I: Number of samples in mask */
+    double upper_left_lat,      /* I: Upper left latitude for mask */
+    double lower_right_lat,     /* I: Lower right latitude for mask */
+    double upper_left_long,     /* I: Upper left longitude for mask */
+    double lower_right_long,    /* I: Lower right longitude for mask */
+    unsigned char *mask         /* O: Mask buffer */
+)
+{
+    if (lower_right_long < upper_left_long)
+    {
+        return create_split_geographic_mask(store, 0.0, num_lines,
+            num_samples, upper_left_lat, lower_right_lat, upper_left_long,
+            lower_right_long + 360.0, mask);
+    }
+
+    return create_geographic_mask(store, 0.0, num_lines, num_samples,
+        upper_left_lat, lower_right_lat, upper_left_long, lower_right_long,
+        mask);
+}
+
+/*****************************************************************************
+NAME:  ias_geo_shape_mask
+
+PURPOSE:  Generate a mask image (per-bit buffer) based on a set of polygons.
+          Values of zero denote locations outside the polygons, values of one
+          represent locations inside a polygon.
+
+RETURN VALUE:
+Type = int
+Value    Description
+-----    -----------
+SUCCESS  Successful completion
+ERROR    Operation failed
+
+*****************************************************************************/
+int ias_geo_shape_mask
+(
+    const char *polygon_file,   /* I: Polygon filename */
+    unsigned int num_lines,     /* I: Number of lines in mask */
+    unsigned int num_samples,   /* I: Number of samples in mask */
+    double upper_left_lat,      /* I: Upper left latitude for mask */
+    double lower_right_lat,     /* I: Lower right latitude for mask */
+    double upper_left_long,     /* I: Upper left longitude for mask */
+    double lower_right_long,    /* I: Lower right longitude for mask */
+    unsigned char *mask         /* O: Mask buffer */
+)
+{
+    IAS_POLYGON_STORE *store;   /* Opened polygon file */
+    int status;                 /* Return status */
+
+    /* Open the polygon file. */
+    store = ias_geo_open_polygon_store(polygon_file);
+    if (store == NULL)
+    {
+        IAS_LOG_ERROR("Opening the polygon file %s", polygon_file);
+        return ERROR;
+    }
+
+    status = ias_geo_shape_mask_store(store, num_lines, num_samples,
+        upper_left_lat, lower_right_lat, upper_left_long, lower_right_long,
+        mask);
+    if (status != SUCCESS)
+        IAS_LOG_ERROR("Creating the shape mask from %s", polygon_file);
+
+    ias_geo_close_polygon_store(store);
+    return status;
+}
+
+/* Geometry shared by the blocks of the shape mask quadtree */
+typedef struct shape_mask_grid
+{
+    const IAS_IMAGE *image;     /* Target image */
+    double min_lng;             /* Minimum bit mask longitude */
+    double max_lat;             /* Maximum bit mask latitude */
+    double delta_longitude;     /* Longitude step of the bit mask */
+    double delta_latitude;      /* Latitude step of the bit mask */
+    const unsigned char *bit_mask; /* Bit mask of the polygons */
+    int packed;                 /* Flag for a mask of one bit per pixel */
+    double max_error;           /* Largest interpolation error allowed, in
+                                   bit mask pixels; 0 for exact transforms */
+    int crosses_180;            /* Flag for a bit mask crossing the 180
+                                   degree meridian, whose longitudes run
+                                   continuously past 180 */
+    const int32_t *line_extent; /* First and last valid sample of each line,
+                                   or NULL when every pixel is masked */
+    unsigned char *mask;        /* Mask buffer */
+} SHAPE_MASK_GRID;
+
+/* Rows of grid cells of the shape mask */
+typedef struct shape_mask_rows
+{
+    const SHAPE_MASK_GRID *grid; /* Shared mask geometry */
+    IAS_GEO_PROJ_TRANSFORMATION *transformation; /* Transformation to
+                                                    geographic */
+} SHAPE_MASK_ROWS;
+
+/* Interpolation states of the cells of a transform grid */
+#define CELL_UNKNOWN 0          /* Not checked yet */
+#define CELL_INTERPOLATE 1      /* Interpolation is within the error bound */
+#define CELL_EXACT 2            /* Points need the exact transformation */
+
+/* Coarse grid of the target image points transformed to geographic, for
+   one row of the shape mask grid.  Nodes lie every INTERP_GRID_SIZE lines
+   and samples, and are transformed when first needed. */
+typedef struct transform_grid
+{
+    unsigned int first_line;    /* Target line of the first node row */
+    unsigned int node_rows;     /* Number of node rows */
+    unsigned int node_cols;     /* Number of node columns */
+    IAS_DBL_LAT_LONG *nodes;    /* Transformed nodes, NAN until needed */
+    int *node_status;           /* Transformation status of each node */
+    unsigned char *cell_state;  /* CELL_* state of each cell */
+} TRANSFORM_GRID;
+
+/*****************************************************************************
+NAME:  transform_target_point
+
+PURPOSE:  Transform a target image line/sample to lat/long with the exact
+          transformation.
+
+RETURN VALUE:
+Type = int
+Value    Description
+-----    -----------
+SUCCESS  Successful completion
+ERROR    Operation failed
+
+*****************************************************************************/
+static int transform_target_point
+(
+    const IAS_IMAGE *image,     /* I: Target image */
+    IAS_GEO_PROJ_TRANSFORMATION *transformation, /* I: Transformation to
+                                                    geographic */
+    double line,                /* I: Target line */
+    double sample,              /* I: Target sample */
+    IAS_DBL_LAT_LONG *lat_long  /* O: Transformed point */
+)
+{
+    IAS_DBL_XY point;           /* Point in the image projection */
+
+    point.y = image->corners.upleft.y - (line * image->pixel_size_y);
+    point.x = (sample * image->pixel_size_x) + image->corners.upleft.x;
+
+    return ias_geo_transform_coordinate(transformation, point.x, point.y,
+        &lat_long->lng, &lat_long->lat);
+}
+
+/*****************************************************************************
+NAME:  get_grid_node
+
+PURPOSE:  Get a node of the transform grid, transforming it if needed.
+
+RETURN VALUE:
+Type = const IAS_DBL_LAT_LONG *
+Value    Description
+-----    -----------
+NULL     The node could not be transformed
+other    Transformed node
+
+*****************************************************************************/
+static const IAS_DBL_LAT_LONG *get_grid_node
+(
+    const SHAPE_MASK_GRID *grid, /* I: Shared mask geometry */
+    TRANSFORM_GRID *transform_grid, /* I/O: Transform grid of the row */
+    IAS_GEO_PROJ_TRANSFORMATION *transformation, /* I: Transformation to
+                                                    geographic */
+    unsigned int row,           /* I: Node row */
+    unsigned int col            /* I: Node column */
+)
+{
+    unsigned int index = row * transform_grid->node_cols + col;
+    IAS_DBL_LAT_LONG *node = &transform_grid->nodes[index];
+
+    if (isnan(node->lat))
+    {
+        transform_grid->node_status[index] = transform_target_point(
+            grid->image, transformation,
+            transform_grid->first_line + row * INTERP_GRID_SIZE,
+            col * INTERP_GRID_SIZE, node);
+        if (transform_grid->node_status[index] != SUCCESS)
+            node->lat = 0.0;
+    }
+
+    return transform_grid->node_status[index] == SUCCESS ? node : NULL;
+}
+
+/*****************************************************************************
+NAME:  interpolate_cell
+
+PURPOSE:  Bilinearly interpolate the lat/long of a point in a transform grid
+          cell from the cell corners.
+
+RETURN VALUE: None
+*****************************************************************************/
+static void interpolate_cell
+(
+    const IAS_DBL_LAT_LONG *corners[4], /* I: UL, UR, LL, LR cell corners */
+    double line_fraction,       /* I: Fraction of the cell down to the point */
+    double sample_fraction,     /* I: Fraction of the cell across to the
+                                      point */
+    IAS_DBL_LAT_LONG *lat_long  /* O: Interpolated point */
+)
+{
+    double top;                 /* Interpolated along the top edge */
+    double bottom;              /* Interpolated along the bottom edge */
+
+    top = corners[0]->lat + sample_fraction * (corners[1]->lat
+        - corners[0]->lat);
+    bottom = corners[2]->lat + sample_fraction * (corners[3]->lat
+        - corners[2]->lat);
+    lat_long->lat = top + line_fraction * (bottom - top);
+
+    top = corners[0]->lng + sample_fraction * (corners[1]->lng
+        - corners[0]->lng);
+    bottom = corners[2]->lng + sample_fraction * (corners[3]->lng
+        - corners[2]->lng);
+    lat_long->lng = top + line_fraction * (bottom - top);
+}
+
+/*****************************************************************************
+NAME:  check_grid_cell
+
+PURPOSE:  Decide whether the points of a transform grid cell can be
+          interpolated.  The cell center and edge midpoints are transformed
+          exactly, and interpolation is used only if none of them is off by
+          more than the maximum error in bit mask pixels.
+
+RETURN VALUE: 
+Type = int
+Value             Description
+-----             -----------
+CELL_INTERPOLATE  The cell can be interpolated
+CELL_EXACT        The points of the cell need the exact transformation
+
+NOTES: A cell whose corners could not all be transformed, or which spans
+       the antimeridian, is always transformed exactly.
+*****************************************************************************/
+static int check_grid_cell
+(
+    const SHAPE_MASK_GRID *grid, /* I: Shared mask geometry */
+    TRANSFORM_GRID *transform_grid, /* I/O: Transform grid of the row */
+    IAS_GEO_PROJ_TRANSFORMATION *transformation, /* I: Transformation to
+                                                    geographic */
+    unsigned int cell_row,      /* I: Cell row */
+    unsigned int cell_col,      /* I: Cell column */
+    const IAS_DBL_LAT_LONG *corners[4] /* O: UL, UR, LL, LR cell corners */
+)
+{
+    /* Cell fractions of the checked points: center, then edge midpoints */
+    static const double check_points[5][2] = {{0.5, 0.5}, {0.0, 0.5},
+        {1.0, 0.5}, {0.5, 0.0}, {0.5, 1.0}};
+    double min_lng;             /* Minimum corner longitude */
+    double max_lng;             /* Maximum corner longitude */
+    int index;                  /* Loop counter */
+
+    for (index = 0; index < 4; index++)
+    {
+        corners[index] = get_grid_node(grid, transform_grid, transformation,
+            cell_row + index / 2, cell_col + index % 2);
+        if (!corners[index])
+            return CELL_EXACT;
+    }
+
+    min_lng = max_lng = corners[0]->lng;
+    for (index = 1; index < 4; index++)
+    {
+        if (corners[index]->lng < min_lng)
+            min_lng = corners[index]->lng;
+        if (corners[index]->lng > max_lng)
+            max_lng = corners[index]->lng;
+    }
+    if (max_lng - min_lng > 180.0)
+        return CELL_EXACT;
+
+    for (index = 0; index < 5; index++)
+    {
+        IAS_DBL_LAT_LONG exact;         /* Exactly transformed point */
+        IAS_DBL_LAT_LONG interpolated;  /* Interpolated point */
+
+        if (transform_target_point(grid->image, transformation,
+                transform_grid->first_line
+                    + (cell_row + check_points[index][0]) * INTERP_GRID_SIZE,
+                (cell_col + check_points[index][1]) * INTERP_GRID_SIZE,
+                &exact) != SUCCESS)
+        {
+            return CELL_EXACT;
+        }
+
+        interpolate_cell(corners, check_points[index][0],
+            check_points[index][1], &interpolated);
+        if (fabs(exact.lng - interpolated.lng) > grid->max_error
+                * grid->delta_longitude
+            || fabs(exact.lat - interpolated.lat) > grid->max_error
+                * grid->delta_latitude)
+        {
+            return CELL_EXACT;
+        }
+    }
+
+    return CELL_INTERPOLATE;
+}
+
+/*****************************************************************************
+NAME:  interpolate_target_point
+
+PURPOSE:  Find the lat/long of a target image line/sample from the transform
+          grid.  Points on a node use the node, and points in a cell which
+          is within the error bound are interpolated from its corners.
+
+RETURN VALUE:
+Type = int
+Value    Description
+-----    -----------
+SUCCESS  The point was found from the grid
+ERROR    The point needs the exact transformation
+
+*****************************************************************************/
+static int interpolate_target_point
+(
+    const SHAPE_MASK_GRID *grid, /* I: Shared mask geometry */
+    TRANSFORM_GRID *transform_grid, /* I/O: Transform grid of the row */
+    IAS_GEO_PROJ_TRANSFORMATION *transformation, /* I: Transformation to
+                                                    geographic */
+    unsigned int line,          /* I: Target line */
+    unsigned int sample,        /* I: Target sample */
+    IAS_DBL_LAT_LONG *lat_long  /* O: Point found from the grid */
+)
+{
+    const IAS_DBL_LAT_LONG *corners[4]; /* Cell corners */
+    unsigned int grid_line = line - transform_grid->first_line;
+    unsigned int cell_row = grid_line / INTERP_GRID_SIZE;
+    unsigned int cell_col = sample / INTERP_GRID_SIZE;
+    unsigned char *state;       /* State of the cell */
+
+    if (line < transform_grid->first_line
+        || cell_row + 1 >= transform_grid->node_rows
+        || cell_col + 1 >= transform_grid->node_cols)
+    {
+        return ERROR;
+    }
+
+    /* Nodes were transformed exactly */
+    if (grid_line % INTERP_GRID_SIZE == 0 && sample % INTERP_GRID_SIZE == 0)
+    {
+        corners[0] = get_grid_node(grid, transform_grid, transformation,
+            cell_row, cell_col);
+        if (!corners[0])
+            return ERROR;
+        *lat_long = *corners[0];
+        return SUCCESS;
+    }
+
+    state = &transform_grid->cell_state[cell_row
+        * (transform_grid->node_cols - 1) + cell_col];
+    if (*state == CELL_UNKNOWN)
+    {
+        *state = check_grid_cell(grid, transform_grid, transformation,
+            cell_row, cell_col, corners);
+    }
+    else if (*state == CELL_INTERPOLATE)
+    {
+        int index;              /* Loop counter */
+
+        for (index = 0; index < 4; index++)
+        {
+            corners[index] = get_grid_node(grid, transform_grid,
+                transformation, cell_row + index / 2, cell_col + index % 2);
+        }
+    }
+    if (*state == CELL_EXACT)
+        return ERROR;
+
+    interpolate_cell(corners,
+        (double)(grid_line % INTERP_GRID_SIZE) / INTERP_GRID_SIZE,
+        (double)(sample % INTERP_GRID_SIZE) / INTERP_GRID_SIZE, lat_long);
+    return SUCCESS;
+}
+
+/*****************************************************************************
+NAME:  transform_target_samples
+
+PURPOSE:  Transform consecutive samples of a target image line to lat/long
+          with the exact transformation, all in one call.
+
+RETURN VALUE:
+Type = int
+Value    Description
+-----    -----------
+SUCCESS  Successful completion
+ERROR    Operation failed
+
+NOTES: Each point matches transform_target_point.
+*****************************************************************************/
+static int transform_target_samples
+(
+    const IAS_IMAGE *image,     /* I: Target image */
+    IAS_GEO_PROJ_TRANSFORMATION *transformation, /* I: Transformation to
+                                                    geographic */
+    unsigned int line,          /* I: Target line */
+    unsigned int first_sample,  /* I: First target sample */
+    unsigned int count,         /* I: Number of samples, up to
+                                      MIN_GRID_SIZE */
+    double *lng,                /* O: Longitude of each sample */
+    double *lat                 /* O: Latitude of each sample */
+)
+{
+    double x[MIN_GRID_SIZE];    /* X of each sample in the image projection */
+    double y[MIN_GRID_SIZE];    /* Y of each sample in the image projection */
+    unsigned int index;         /* Sample loop counter */
+
+    for (index = 0; index < count; index++)
+    {
+        y[index] = image->corners.upleft.y - (line * image->pixel_size_y);
+        x[index] = ((first_sample + index) * image->pixel_size_x)
+            + image->corners.upleft.x;
+    }
+
+    return ias_geo_transform_coordinates(transformation, count, x, y, lng,
+        lat);
+}
+
+/*****************************************************************************
+NAME:  translate_to_bit_mask
+
+PURPOSE:  Translates a lat/long to bit mask line/sample and confirms it falls
+          within the bit mask.
+
+RETURN VALUE:
+Type = int
+Value    Description
+-----    -----------
+TRUE     Pixel in mask
+FALSE    Pixel not in mask
+*****************************************************************************/
+static int translate_to_bit_mask
+(
+    const SHAPE_MASK_GRID *grid, /* I: Shared mask geometry */
+    double lng,                 /* I: Longitude of the point */
+    double lat,                 /* I: Latitude of the point */
+    IAS_DBL_LS *translated_pixel/* O: Translated to bit mask line/sample */
+)
+{
+    int num_lines = grid->image->nl;     /* Number of lines in bit mask */
+    int num_samples = grid->image->ns;   /* Number of samples in bit mask */
+
+    /* Points east of 180 are in the longitudes of the bit mask once around
+       the earth further east */
+    if (grid->crosses_180 && lng < grid->min_lng)
+        lng += 360.0;
+
+    /* Translate lat/long to mask line/sample */  
+    translated_pixel->samp = (lng - grid->min_lng) / grid->delta_longitude;
+    translated_pixel->line = (grid->max_lat - lat) / grid->delta_latitude;
+            
+    /* Check if the line sample falls within the image */
+    if (translated_pixel->line >= 0 && translated_pixel->line < num_lines 
+        && translated_pixel->samp >= 0 && translated_pixel->samp < num_samples)
+    {
+        return TRUE;
+    } 
+
+    return FALSE;
+}
+
 /*****************************************************************************
 NAME:  convert_target_xy_to_input_line_sample
 
-PURPOSE:  Converts an X/Y coordinate to input line/sample and confirms it falls
-    within the image.
+PURPOSE:  Converts a target image line/sample to input line/sample and
+    confirms it falls within the image.
 
 RETURN VALUE:
 Type = int
@@ -37,53 +1678,175 @@ TRUE     Pixel in mask
 FALSE    Pixel not in mask
 ERROR    Operation failed
 
+NOTES: With a transform grid, the point is interpolated where the grid is
+       within the error bound, and transformed exactly elsewhere.
 *****************************************************************************/
 static int convert_target_xy_to_input_line_sample
 (
-    const IAS_DBL_XY *current_pixel,   /* I: Pixel X/Y coordinate */
+    const SHAPE_MASK_GRID *grid, /* I: Shared mask geometry */
+    TRANSFORM_GRID *transform_grid, /* I/O: Transform grid of the row, or
+                                       NULL for exact transforms */
     IAS_GEO_PROJ_TRANSFORMATION *geographic_transformation,/* I: Transformation
                                                                  Projection */
-    double min_lng,             /* I: Minimum image longitude */
-    double max_lat,             /* I: Maximum image latitude */
-    double delta_longitude,     /* I: Change in longitude from bounding box */
-    double delta_latitude,      /* I: Change in latatiude from bounding box */
-    int num_samples,            /* I: Number of samples in input image */
-    int num_lines,              /* I: Number of lines in input image */
+    unsigned int line,          /* I: Target line */
+    unsigned int sample,        /* I: Target sample */
     IAS_DBL_LS *translated_pixel/* O: Translated to bit mask line/sample */
 )
 {
     IAS_DBL_LAT_LONG transformed_pixel; /* Pixel transformed to lat/long */
    
     /* Transform the X/Y coordinates to Lat/Long */
-    if (ias_geo_transform_coordinate(geographic_transformation, 
-        current_pixel->x, current_pixel->y, &transformed_pixel.lng, 
-        &transformed_pixel.lat) != SUCCESS)
+    if ((!transform_grid || interpolate_target_point(grid, transform_grid,
+            geographic_transformation, line, sample, &transformed_pixel)
+            != SUCCESS)
+        && transform_target_point(grid->image, geographic_transformation,
+            line, sample, &transformed_pixel) != SUCCESS)
     {
         IAS_LOG_ERROR("Converting to lat/long");
         return ERROR;
     }
-            
-    /* Translate lat/long to mask line/sample */  
-    translated_pixel->samp = (transformed_pixel.lng - min_lng) 
-        / delta_longitude;
-    translated_pixel->line = (max_lat - transformed_pixel.lat) / delta_latitude;
-            
-    /* Check if the line sample falls within the image */
-    if (translated_pixel->line >= 0 && translated_pixel->line < num_lines 
-        && translated_pixel->samp >= 0 && translated_pixel->samp < num_samples)
+
+    return translate_to_bit_mask(grid, transformed_pixel.lng,
+        transformed_pixel.lat, translated_pixel);
+}
+
+/*****************************************************************************
+NAME:  set_mask_span
+
+PURPOSE:  Mark a span of samples on one line of the target mask as inside
+          the polygons.
+
+RETURN VALUE: None
+
+NOTES: A packed mask line starts on a byte boundary, with its first sample
+       in the most significant bit, so lines never share a byte.
+*****************************************************************************/
+static void set_mask_span
+(
+    const SHAPE_MASK_GRID *grid, /* I: Shared mask geometry */
+    unsigned int line,          /* I: Line of the span */
+    unsigned int first_sample,  /* I: First sample of the span */
+    unsigned int span_samples   /* I: Number of samples in the span */
+)
+{
+    unsigned int num_samples = grid->image->ns; /* Samples in image */
+    unsigned char *line_bits;   /* Start of the packed mask line */
+    unsigned int sample;        /* Sample loop counter */
+    unsigned int end_sample = first_sample + span_samples;
+
+    if (!grid->packed)
     {
-        return TRUE;
-    } 
+        memset(&grid->mask[(size_t)line * num_samples + first_sample],
+            IAS_GEO_SHAPE_MASK_VALID, span_samples);
+        return;
+    }
 
-    return FALSE;
+    line_bits = &grid->mask[(size_t)line * ((num_samples + 7) / 8)];
+    sample = first_sample;
+
+    /* Set the bits up to a byte boundary, then whole bytes, then the rest */
+    for (; sample < end_sample && sample % 8; sample++)
+        line_bits[sample / 8] |= 1 << (7 - sample % 8);
+    if (end_sample - sample >= 8)
+    {
+        memset(&line_bits[sample / 8], ALL_BITS_SET,
+            (end_sample - sample) / 8);
+        sample += (end_sample - sample) / 8 * 8;
+    }
+    for (; sample < end_sample; sample++)
+        line_bits[sample / 8] |= 1 << (7 - sample % 8);
 }
 
 /*****************************************************************************
-NAME:  ias_geo_shape_mask
+NAME:  clip_span_to_footprint
 
-PURPOSE:  Generate a mask image (per-bit buffer) based on a set of polygons.
-          Values of zero denote locations outside the polygons, values of one
-          represent locations inside a polygon.
+PURPOSE:  Clip a span of samples on one line of the target image to the
+          valid extent of that line.
+
+RETURN VALUE:
+Type = int
+Value    Description
+-----    -----------
+0        No sample of the span is inside the footprint
+1        The span was clipped to the footprint (unchanged without one)
+
+*****************************************************************************/
+static int clip_span_to_footprint
+(
+    const SHAPE_MASK_GRID *grid, /* I: Shared mask geometry */
+    unsigned int line,          /* I: Line of the span */
+    unsigned int *first_sample, /* I/O: First sample of the span */
+    unsigned int *span_samples  /* I/O: Number of samples in the span */
+)
+{
+    long first;                 /* First valid sample of the line */
+    long last;                  /* Last valid sample of the line */
+    long span_first = *first_sample; /* First sample of the clipped span */
+    long span_last = (long)*first_sample + *span_samples - 1; /* Last sample
+                                   of the clipped span */
+
+    if (!grid->line_extent)
+        return 1;
+
+    first = grid->line_extent[2 * line];
+    last = grid->line_extent[2 * line + 1];
+    if (first > span_first)
+        span_first = first;
+    if (last < span_last)
+        span_last = last;
+    if (span_last < span_first)
+        return 0;
+
+    *first_sample = span_first;
+    *span_samples = span_last - span_first + 1;
+    return 1;
+}
+
+/*****************************************************************************
+NAME:  block_in_footprint
+
+PURPOSE:  Determine whether any line of a block of the target image reaches
+          into the footprint.
+
+RETURN VALUE:
+Type = int
+Value    Description
+-----    -----------
+0        The block lies wholly outside the footprint
+1        Some of the block is inside the footprint (always without one)
+
+*****************************************************************************/
+static int block_in_footprint
+(
+    const SHAPE_MASK_GRID *grid, /* I: Shared mask geometry */
+    unsigned int first_line,    /* I: First line of the block */
+    unsigned int first_sample,  /* I: First sample of the block */
+    unsigned int block_lines,   /* I: Number of lines in the block */
+    unsigned int block_samples  /* I: Number of samples in the block */
+)
+{
+    unsigned int line;          /* Line loop counter */
+
+    for (line = first_line; line < first_line + block_lines; line++)
+    {
+        unsigned int span_first = first_sample;  /* Clipped span of line */
+        unsigned int span_samples = block_samples;
+
+        if (clip_span_to_footprint(grid, line, &span_first, &span_samples))
+            return 1;
+    }
+
+    return 0;
+}
+
+/*****************************************************************************
+NAME:  classify_block
+
+PURPOSE:  Determine whether a block of the target image falls wholly inside
+          or wholly outside the polygons of the bit mask.  The block corners,
+          edge midpoints and center are translated to the bit mask, and
+          every byte of the bit mask covering their bounding box must be all
+          set or all clear.
 
 RETURN VALUE:
 Type = int
@@ -92,140 +1855,451 @@ Value    Description
 SUCCESS  Successful completion
 ERROR    Operation failed
 
+NOTES: The block value is ALL_BITS_SET or NO_BITS_SET for a uniform block,
+       and -1 when the block is mixed or reaches outside the bit mask.
 *****************************************************************************/
-int ias_geo_shape_mask
+static int classify_block
 (
-    const char *polygon_file,   /* I: Polygon filename */
-    unsigned int num_lines,     /* I: Number of lines in mask */
-    unsigned int num_samples,   /* I: Number of samples in mask */
-    double upper_left_lat,      /* I: Upper left latitude for mask */
-    double lower_right_lat,     /* I: Lower right latitude for mask */
-    double upper_left_long,     /* I: Upper left longitude for mask */
-    double lower_right_long,    /* I: Lower right longitude for mask */
-    unsigned char *mask         /* O: Mask buffer */
+    const SHAPE_MASK_GRID *grid, /* I: Shared mask geometry */
+    TRANSFORM_GRID *transform_grid, /* I/O: Transform grid of the row, or
+                                       NULL for exact transforms */
+    IAS_GEO_PROJ_TRANSFORMATION *transformation, /* I: Transformation to
+                                                    geographic */
+    unsigned int first_line,    /* I: First line of the block */
+    unsigned int first_sample,  /* I: First sample of the block */
+    unsigned int block_lines,   /* I: Number of lines in the block */
+    unsigned int block_samples, /* I: Number of samples in the block */
+    int *block_value            /* O: Bit mask value of the block */
 )
 {
-    unsigned int line;          /* Line counter */
-    unsigned int index;         /* Generic counter */
-    double delta_latitude;      /* Delta latitude */
-    double delta_longitude;     /* Delta longitude */
-    IAS_POLYGON_LINKED_LIST *polygon_list; /* Polygon linked list pointer */
-    FILE *fp;                   /* Polygon file pointer */
+    const IAS_IMAGE *image = grid->image; /* Target image */
+    unsigned int num_lines = image->nl;   /* Number of lines in image */
+    unsigned int num_samples = image->ns; /* Number of samples in image */
+    double min_line = 0.0;      /* Minimum bit mask line */
+    double max_line = 0.0;      /* Maximum bit mask line */
+    double min_samp = 0.0;      /* Minimum bit mask sample */
+    double max_samp = 0.0;      /* Maximum bit mask sample */
+    IAS_LNG_LS max_ls;          /* Maximum line/sample */
+    IAS_LNG_LS min_ls;          /* Minimum line/sample */
+    int grid_value;             /* Value of the first bit mask byte */
+    int row;                    /* Sample point row */
+    int column;                 /* Sample point column */
+    long line;                  /* Bit mask line loop counter */
+
+    *block_value = -1;
+
+    /* Translate a 3x3 set of points spanning the block, including the
+       corners one pixel past its last line and sample */
+    for (row = 0; row <= 2; row++)
+    {
+        for (column = 0; column <= 2; column++)
+        {
+            IAS_DBL_LS translated_pixel;/* Translated to bit mask line/samp */
+            int status;                 /* Status placeholder */
+
+            status = convert_target_xy_to_input_line_sample(grid,
+                transform_grid, transformation,
+                first_line + block_lines * row / 2,
+                first_sample + block_samples * column / 2,
+                &translated_pixel);
+            if (status == ERROR)
+            {
+                IAS_LOG_ERROR("Translating block points for line %u "
+                    "sample %u", first_line, first_sample);
+                return ERROR;
+            }
+            else if (!status)
+            {
+                /* The block reaches outside the bit mask */
+                return SUCCESS;
+            }
 
-    /* Open the polygon file. */
-    if ((fp = fopen(polygon_file, "r")) == NULL)
+            if ((row == 0 && column == 0) || translated_pixel.line < min_line)
+                min_line = translated_pixel.line;
+            if ((row == 0 && column == 0) || translated_pixel.line > max_line)
+                max_line = translated_pixel.line;
+            if ((row == 0 && column == 0) || translated_pixel.samp < min_samp)
+                min_samp = translated_pixel.samp;
+            if ((row == 0 && column == 0) || translated_pixel.samp > max_samp)
+                max_samp = translated_pixel.samp;
+        }
+    }
+
+    max_ls.line = max_line + 1;
+    max_ls.samp = max_samp + 1;
+    min_ls.line = min_line;
+    min_ls.samp = min_samp;
+
+    /* Make sure the max_ls is still in the image */
+    if (max_ls.line >= num_lines || max_ls.samp >= num_samples)
     {
-        IAS_LOG_ERROR("Unable to open %s for reading.", polygon_file);
-        return ERROR;
+        return SUCCESS;
+    }
+
+    /* Check that all the bytes covering the bounding box are identical and
+       either all set or all clear */
+    grid_value = grid->bit_mask[(min_ls.line * num_samples + min_ls.samp) / 8];
+    if (grid_value != ALL_BITS_SET && grid_value != NO_BITS_SET)
+    {
+        return SUCCESS;
+    }
+
+    for (line = min_ls.line; line < max_ls.line; line++)
+    {
+        unsigned long byte;     /* Bit mask byte loop counter */
+        unsigned long last_byte = (line * num_samples + max_ls.samp - 1) / 8;
+
+        for (byte = (line * num_samples + min_ls.samp) / 8; byte <= last_byte;
+             byte++)
+        {
+            if (grid->bit_mask[byte] != grid_value)
+            {
+                return SUCCESS;
+            }
+        }
+    }
+
+    *block_value = grid_value;
+    return SUCCESS;
+}
+
+/*****************************************************************************
+NAME:  mask_block
+
+PURPOSE:  Set the mask values of a block of the target image.  A block lying
+          wholly inside or outside the polygons in the bit mask is filled at
+          once.  A mixed block is split into quarters until it is no larger
+          than MIN_GRID_SIZE, and then filled pixel by pixel.
+
+RETURN VALUE:
+Type = int
+Value    Description
+-----    -----------
+SUCCESS  Successful completion
+ERROR    Operation failed
+
+NOTES: With a footprint, a block lying wholly outside it is left as is, and
+       only the samples of each line inside it are set or transformed.
+*****************************************************************************/
+static int mask_block
+(
+    const SHAPE_MASK_GRID *grid, /* I: Shared mask geometry */
+    TRANSFORM_GRID *transform_grid, /* I/O: Transform grid of the row, or
+                                       NULL for exact transforms */
+    IAS_GEO_PROJ_TRANSFORMATION *transformation, /* I: Transformation to
+                                                    geographic */
+    unsigned int first_line,    /* I: First line of the block */
+    unsigned int first_sample,  /* I: First sample of the block */
+    unsigned int block_lines,   /* I: Number of lines in the block */
+    unsigned int block_samples  /* I: Number of samples in the block */
+)
+{
+    const IAS_IMAGE *image = grid->image; /* Target image */
+    unsigned int num_lines = image->nl;   /* Number of lines in image */
+    unsigned int num_samples = image->ns; /* Number of samples in image */
+    unsigned int line;          /* Loop variable for lines in image */
+    unsigned int sample;        /* Loop variable for samples in image */
+    int block_value;            /* Bit mask value of the block */
+
+    /* Skip a block in the fill around the footprint */
+    if (!block_in_footprint(grid, first_line, first_sample, block_lines,
+            block_samples))
+    {
+        return SUCCESS;
     }
 
-    /* Load the polygons. */
-    if (ias_geo_load_polygon(fp, upper_left_long, lower_right_long,
-        lower_right_lat, upper_left_lat, &polygon_list) != SUCCESS)
+    if (classify_block(grid, transform_grid, transformation, first_line,
+            first_sample, block_lines, block_samples, &block_value)
+            != SUCCESS)
     {
-        IAS_LOG_ERROR("Loading the polygon file %s", polygon_file);
-        fclose(fp);
         return ERROR;
     }
 
-    /* Close the polygon file. */
-    fclose(fp);
+    /* Block is either all set bits or all empty bits */
+    if (block_value == NO_BITS_SET)
+    {
+        return SUCCESS;
+    }
+    if (block_value == ALL_BITS_SET)
+    {
+        for (line = first_line; line < first_line + block_lines; line++)
+        {
+            unsigned int span_first = first_sample; /* Clipped span */
+            unsigned int span_samples = block_samples;
+
+            if (clip_span_to_footprint(grid, line, &span_first,
+                    &span_samples))
+            {
+                set_mask_span(grid, line, span_first, span_samples);
+            }
+        }
+        return SUCCESS;
+    }
 
-    /* Discard polygons outside the bounding box. */
-    if (ias_geo_reduce_polygon(&polygon_list, upper_left_long, lower_right_long,
-        upper_left_lat, lower_right_lat) != SUCCESS)
+    /* Split a mixed block into quarters, or halves once one side reaches
+       the minimum size */
+    if (block_lines > MIN_GRID_SIZE || block_samples > MIN_GRID_SIZE)
+    {
+        unsigned int split_lines[2];    /* Lines in each half */
+        unsigned int split_samples[2];  /* Samples in each half */
+        int row;                        /* Half loop counter */
+        int column;                     /* Half loop counter */
+
+        split_lines[0] = block_lines > MIN_GRID_SIZE ? block_lines / 2
+            : block_lines;
+        split_lines[1] = block_lines - split_lines[0];
+        split_samples[0] = block_samples > MIN_GRID_SIZE ? block_samples / 2
+            : block_samples;
+        split_samples[1] = block_samples - split_samples[0];
+
+        for (row = 0; row < 2; row++)
+        {
+            for (column = 0; column < 2; column++)
+            {
+                if (split_lines[row] == 0 || split_samples[column] == 0)
+                    continue;
+
+                if (mask_block(grid, transform_grid, transformation,
+                        first_line + (row ? split_lines[0] : 0),
+                        first_sample + (column ? split_samples[0] : 0),
+                        split_lines[row], split_samples[column]) != SUCCESS)
+                {
+                    return ERROR;
+                }
+            }
+        }
+        return SUCCESS;
+    }
+
+    /* Loop through the block converting each pixel inside the footprint to
+       lat/long.  Without a transform grid, the samples of each line are
+       transformed together. */
+    for (line = first_line; line < first_line + block_lines; line++)
+    {    
+        double lng[MIN_GRID_SIZE];  /* Longitude of each sample */
+        double lat[MIN_GRID_SIZE];  /* Latitude of each sample */
+        unsigned int span_first = first_sample; /* First sample of the line
+                                                   in the footprint */
+        unsigned int span_samples = block_samples; /* Samples of the line in
+                                                      the footprint */
+
+        if (!clip_span_to_footprint(grid, line, &span_first, &span_samples))
+        {
+            continue;
+        }
+
+        if (!transform_grid && transform_target_samples(image, transformation,
+                line, span_first, span_samples, lng, lat) != SUCCESS)
+        {
+            IAS_LOG_ERROR("Converting line %u samples %u to %u to lat/long",
+                line, span_first, span_first + span_samples - 1);
+            return ERROR;
+        }
+
+        for (sample = span_first; sample < span_first + span_samples;
+             sample++)
+        {
+            int status; /* Status placeholder */
+            IAS_DBL_LS translated_pixel; /* Translated to line/samp */
+
+            /* Check if pixel is part of bit mask */
+            if (transform_grid)
+            {
+                status = convert_target_xy_to_input_line_sample(grid,
+                    transform_grid, transformation, line, sample,
+                    &translated_pixel);
+            }
+            else
+            {
+                status = translate_to_bit_mask(grid,
+                    lng[sample - span_first], lat[sample - span_first],
+                    &translated_pixel);
+            }
+            if (status == ERROR)
+            {
+                IAS_LOG_ERROR("Translating pixel for line %d sample %d",
+                    line, sample);
+                return ERROR;
+            }
+            else if (status) 
+            {
+                unsigned int byte; /* Byte level indexing */
+                unsigned int bit;  /* Bit level indexing */
+                int mask_index;
+                int nearest_line = round(translated_pixel.line);
+                int nearest_sample = round(translated_pixel.samp);
+
+                /* Clamp the line to the image after rounding up might
+                   go off the edge */
+                if (nearest_line >= num_lines)
+                    nearest_line = num_lines - 1;
+                if (nearest_sample >= num_samples)
+                    nearest_sample = num_samples - 1;
+
+                mask_index = nearest_line * num_samples 
+                    + nearest_sample;
+                byte = mask_index / 8;
+                bit = 7 - mask_index % 8;
+                if (grid->bit_mask[byte] & (1 << bit))
+                {
+                    set_mask_span(grid, line, sample, 1);
+                }
+            } 
+        }
+    } 
+
+    return SUCCESS;
+}
+
+/*****************************************************************************
+NAME:  mask_grid_row
+
+PURPOSE:  Set the mask values of one row of grid cells from the bit mask.
+          Each cell is classified as a whole and subdivided only where it
+          mixes inside and outside the polygons.
+
+RETURN VALUE:
+Type = int
+Value    Description
+-----    -----------
+SUCCESS  Successful completion
+ERROR    Operation failed
+
+NOTES: Each row writes only its own lines of the mask, so rows can be
+       processed in parallel, sharing the transformation.
+       When interpolation is allowed, the row has its own transform grid
+       covering its lines.
+*****************************************************************************/
+static int mask_grid_row
+(
+    const SHAPE_MASK_GRID *grid, /* I: Shared mask geometry */
+    IAS_GEO_PROJ_TRANSFORMATION *transformation, /* I: Transformation to
+                                                    geographic */
+    int vgrid                   /* I: Grid row to process */
+)
+{
+    unsigned int num_lines = grid->image->nl;   /* Lines in image */
+    unsigned int num_samples = grid->image->ns; /* Samples in image */
+    unsigned int first_line = vgrid * GRID_SIZE_VERT; /* First row line */
+    unsigned int grid_lines = GRID_SIZE_VERT;   /* Number of lines in grid */
+    unsigned int first_sample;  /* First sample of the current grid */
+    TRANSFORM_GRID transform_grid; /* Transform grid of the row */
+    TRANSFORM_GRID *row_transform_grid = NULL; /* Grid used, if any */
+    int status = SUCCESS;       /* Return status */
+
+    /* If it is the end of the image determine smaller grid */
+    if (first_line >= num_lines)
+    {
+        return SUCCESS;
+    }
+    if (num_lines - first_line < grid_lines)
     {
-        IAS_LOG_ERROR("Reducing the polygon");
-        return ERROR;
+        grid_lines = num_lines - first_line;
     }
 
-    /* Initialize the mask to all zeros. */
-    memset(mask, 0, num_lines * num_samples / 8 + 1);
-
-    /* Determine the mask value for each sample location. */
-    delta_latitude = (upper_left_lat - lower_right_lat) / num_lines;
-    if (lower_right_long >= upper_left_long)
+    /* A row wholly in the fill around the footprint needs no transforms */
+    if (!block_in_footprint(grid, first_line, 0, grid_lines, num_samples))
     {
-        delta_longitude = (lower_right_long - upper_left_long) / num_samples;
+        return SUCCESS;
     }
-    else
+
+    /* Set up the transform grid, with nodes through the line and sample
+       past the end of the row */
+    if (grid->max_error > 0.0)
     {
-        delta_longitude = (lower_right_long - upper_left_long + 360) 
-            / num_samples;
+        unsigned int num_nodes; /* Number of nodes in the grid */
+        unsigned int index;     /* Node loop counter */
+
+        transform_grid.first_line = first_line;
+        transform_grid.node_rows = grid_lines / INTERP_GRID_SIZE + 2;
+        transform_grid.node_cols = num_samples / INTERP_GRID_SIZE + 2;
+        num_nodes = transform_grid.node_rows * transform_grid.node_cols;
+        transform_grid.nodes = malloc(num_nodes * sizeof(IAS_DBL_LAT_LONG));
+        transform_grid.node_status = malloc(num_nodes * sizeof(int));
+        transform_grid.cell_state = calloc((transform_grid.node_rows - 1)
+            * (transform_grid.node_cols - 1), 1);
+        if (!transform_grid.nodes || !transform_grid.node_status
+            || !transform_grid.cell_state)
+        {
+            IAS_LOG_ERROR("Allocating the transform grid");
+            free(transform_grid.nodes);
+            free(transform_grid.node_status);
+            free(transform_grid.cell_state);
+            return ERROR;
+        }
+        for (index = 0; index < num_nodes; index++)
+        {
+            transform_grid.nodes[index].lat = NAN;
+        }
+        row_transform_grid = &transform_grid;
     }
 
-    /* Loop through each line */
-    for (line = 0, index = 0; line < num_lines; line++)
+    for (first_sample = 0; first_sample < num_samples;
+         first_sample += GRID_SIZE_HORZ)
     {
-        unsigned int sample;        /* Sample counter */
-        double latitude;            /* Latitude */
+        unsigned int grid_samples = GRID_SIZE_HORZ; /* Samples in grid */
 
-        latitude = upper_left_lat - delta_latitude * line;
+        if (num_samples - first_sample < grid_samples)
+        {
+            grid_samples = num_samples - first_sample;
+        }
 
-        /* Loop through each sample */
-        for (sample = 0; sample < num_samples; sample++, index++)
-        {           
-            IAS_POLYGON_LINKED_LIST *polygon_hit;  /* Polygon linked list 
-                                                      pointer */
-            double longitude;           /* Longitude */
-            double distance;            /* Distance from point to polygon */
-            int inside_flag;            /* Inside/Outside polygon flag */
+        if (mask_block(grid, row_transform_grid, transformation, first_line,
+                first_sample, grid_lines, grid_samples) != SUCCESS)
+        {
+            IAS_LOG_ERROR("Masking grid line %u sample %u", first_line,
+                first_sample);
+            status = ERROR;
+            break;
+        }
+    }
 
-            longitude = upper_left_long + delta_longitude * sample;
+    if (row_transform_grid)
+    {
+        free(transform_grid.nodes);
+        free(transform_grid.node_status);
+        free(transform_grid.cell_state);
+    }
 
-            /* Adjust for 180 crossing. */
-            if (longitude >= 180)
-            {
-                longitude -= 360;
-            }
+    return status;
+}
 
-            /* Initialize the flag and distances */
-            inside_flag = 0;
-            distance = 1e10;
+/*****************************************************************************
+NAME:  mask_grid_row_task
 
-            /* Determine if point is inside the shape */
-            inside_flag = ias_geo_point_in_shape_distance(polygon_list,
-                latitude, longitude, 0, &distance, &polygon_hit);
-            
-            /* Progress down the line using the distance provided by 
-               point_in_shape_distance so we don't have to recalculate
-               distance for each lat/long */
-            while (sample < num_samples && distance > 0)
-            {
-                /* Set bit if point is inside the polygon */
-                if (inside_flag)
-                {
-                    unsigned int byte;  /* Byte level indexing */
-                    unsigned int bit;   /* Bit-level indexing */
-                    byte = index / 8;
-                    bit = 7 - index % 8;
-                    mask[byte] |= 1 << bit;
-                }
-    
-                /* Progress to the next sample and to the next mask
-                   index */
-                sample++;
-                index++;
+PURPOSE:  Set the mask values of one row of grid cells, as an iteration of
+          the loop over the rows.
 
-                /* Subtract the distance that we change each sample */
-                distance -= delta_longitude;
-            }
+RETURN VALUE:
+Type = int
+Value    Description
+-----    -----------
+SUCCESS  Successful completion
+ERROR    Operation failed
+*****************************************************************************/
+static int mask_grid_row_task
+(
+    void *arg,                  /* I/O: Rows of the mask */
+    int vgrid,                  /* I: Grid row to process */
+    int worker                  /* I: Worker processing the row (unused) */
+)
+{
+    const SHAPE_MASK_ROWS *rows = arg; /* Rows of the mask */
 
-            sample--;
-            index--;
-        } /* longitude loop */
-    } /* latitude loop */
-    
-    /* Free storage. */
-    ias_geo_free_polygon_linked_list(polygon_list);
+    if (mask_grid_row(rows->grid, rows->transformation, vgrid) != SUCCESS)
+    {
+        IAS_LOG_ERROR("Masking grid row %d", vgrid);
+        return ERROR;
+    }
 
     return SUCCESS;
 }
 
 /*****************************************************************************
-NAME:  ias_geo_shape_mask_projection
+NAME:  ias_geo_shape_mask_projection_options_store
 
-PURPOSE:  Generate a shape mask for a given region in a given projection.
+PURPOSE:  Generate a shape mask for a given region in a given projection from
+          an opened polygon file, with either one byte or one bit per pixel.
 
 RETURN VALUE:
 Type = int
@@ -235,13 +2309,22 @@ SUCCESS  Successful completion
 ERROR    Operation failed
 
 NOTES: Mask should already be initialized when passed to the routine. It should 
-       be initialized with all zeros.
+       be initialized with all zeros.  With a maximum interpolation error,
+       the transformation to geographic is interpolated inside a coarse grid
+       of exactly transformed points wherever the grid is within the error,
+       and is exact elsewhere.  With a line extent in the options, only the
+       samples inside it are masked, and the rest keep their zeros.
+
+       A scene crossing the 180 degree meridian gets a bit mask from the
+       westernmost corner to the easternmost one continuously past 180,
+       rasterized as the two tight windows on either side of 180.
 *****************************************************************************/
-int ias_geo_shape_mask_projection
+int ias_geo_shape_mask_projection_options_store
 (
-    const char *polygon_file,         /* I: Polygon filename */
+    const IAS_POLYGON_STORE *store,   /* I: Opened polygon file */
     const IAS_IMAGE *image,           /* I: Input image struct pointer */
     const IAS_PROJECTION *projection, /* I: Input projection struct pointer */
+    const IAS_GEO_SHAPE_MASK_OPTIONS *options, /* I: Mask options */
     unsigned char *mask               /* O: Mask buffer */
 )
 {
@@ -255,14 +2338,14 @@ int ias_geo_shape_mask_projection
     double delta_latitude;          /* Delta latitude */
     double delta_longitude;         /* Delta longitude */
     unsigned char *bit_mask = NULL; /* Bit mask */
-    int num_horz_grids;             /* Number of horizontal grids for image */
     int num_vert_grids;             /* Number of vertical grids for image */
-    int vgrid;                      /* Loop variable for current vert grid */
-    int hgrid;                      /* Loop variable for current horz grid */
+    SHAPE_MASK_GRID grid;           /* Geometry shared by the grid blocks */
+    SHAPE_MASK_ROWS rows;           /* Rows of grid cells */
+    int threadsafe;                 /* Flag to run the grid rows in parallel */
+    int crosses_180;                /* Flag for a scene crossing 180 */
+    int status;                     /* Return status */
     unsigned int num_lines;         /* Number of lines in passed image */
     unsigned int num_samples;       /* Number of samples in passed image */
-    unsigned int line;              /* Loop variable for lines in image */
-    unsigned int sample;            /* Loop variable for samples in image */
     unsigned int index;             /* Loop variable for generic use */
     double oparm[IAS_PROJ_PARAM_SIZE];/* Output projection parameters */
     IAS_PROJECTION geographic_projection; /* Geographic projection struct */
@@ -273,8 +2356,7 @@ int ias_geo_shape_mask_projection
     corners_ptr = &image->corners;
     num_lines = image->nl;
     num_samples = image->ns;
-    num_horz_grids = floor(num_samples / GRID_SIZE_HORZ);
-    num_vert_grids = floor(num_lines / GRID_SIZE_VERT);
+    num_vert_grids = (num_lines + GRID_SIZE_VERT - 1) / GRID_SIZE_VERT;
 
     /* Initalize output parameters to 0.0 */
     for (index = 0; index < IAS_PROJ_PARAM_SIZE; index++)
@@ -286,9 +2368,10 @@ int ias_geo_shape_mask_projection
     ias_geo_set_projection(GEO, NULLZONE, DEGREE, WGS84_SPHEROID, oparm,
         &geographic_projection);
 
-    /* Create the transfomation */
-    geographic_transformation = ias_geo_create_proj_transformation(projection, 
-        &geographic_projection);
+    /* Get the transformation, which is shared with any other mask of the
+       same projection */
+    geographic_transformation = ias_geo_get_cached_proj_transformation(
+        projection, &geographic_projection);
     if (!geographic_transformation)
     {
         IAS_LOG_ERROR("Creating projection transformation");
@@ -302,7 +2385,7 @@ int ias_geo_shape_mask_projection
     {
         IAS_LOG_ERROR("Error converting upper left projection parameters to "
                 "lat/long.");
-        ias_geo_destroy_proj_transformation(geographic_transformation);
+        ias_geo_release_cached_proj_transformation(geographic_transformation);
         return ERROR;
     }
 
@@ -312,7 +2395,7 @@ int ias_geo_shape_mask_projection
     {
         IAS_LOG_ERROR("Error converting upper right projection parameters to "
                 "lat/long.");
-        ias_geo_destroy_proj_transformation(geographic_transformation);
+        ias_geo_release_cached_proj_transformation(geographic_transformation);
         return ERROR;
     }
 
@@ -322,7 +2405,7 @@ int ias_geo_shape_mask_projection
     {
         IAS_LOG_ERROR("Error converting lower left projection parameters to "
                 "lat/long.");
-        ias_geo_destroy_proj_transformation(geographic_transformation);
+        ias_geo_release_cached_proj_transformation(geographic_transformation);
         return ERROR;
     }
 
@@ -332,7 +2415,7 @@ int ias_geo_shape_mask_projection
     {
         IAS_LOG_ERROR("Error converting lower right projection parameters to "
                 "lat/long.");
-        ias_geo_destroy_proj_transformation(geographic_transformation);
+        ias_geo_release_cached_proj_transformation(geographic_transformation);
         return ERROR;
     }
 
@@ -343,7 +2426,8 @@ int ias_geo_shape_mask_projection
         lng[index] = corners[index].lng;
     }
     
-    if (ias_geo_does_cross_180(DEGREE, lng))
+    crosses_180 = ias_geo_does_cross_180(DEGREE, lng);
+    if (crosses_180)
     {
         for (index = 0; index < 4; index++)
         {
@@ -381,17 +2465,28 @@ int ias_geo_shape_mask_projection
     if (!bit_mask)
     {
         IAS_LOG_ERROR("Allocating memory for the bit mask");
-        ias_geo_destroy_proj_transformation(geographic_transformation);
+        ias_geo_release_cached_proj_transformation(geographic_transformation);
         return ERROR;
     }
     
     /* Creating the shapemask */
-    if (ias_geo_shape_mask(polygon_file, num_lines, num_samples, 
-        corners[max_lat].lat, corners[min_lat].lat, lng[min_lng],
-        lng[max_lng], bit_mask) != SUCCESS)
+    if (crosses_180)
+    {
+        status = create_split_geographic_mask(store,
+            options->max_polygon_error, num_lines, num_samples,
+            corners[max_lat].lat, corners[min_lat].lat, lng[min_lng],
+            lng[max_lng], bit_mask);
+    }
+    else
+    {
+        status = create_geographic_mask(store, options->max_polygon_error,
+            num_lines, num_samples, corners[max_lat].lat,
+            corners[min_lat].lat, lng[min_lng], lng[max_lng], bit_mask);
+    }
+    if (status != SUCCESS)
     {
         IAS_LOG_ERROR("Creating the shape mask");
-        ias_geo_destroy_proj_transformation(geographic_transformation);
+        ias_geo_release_cached_proj_transformation(geographic_transformation);
         free(bit_mask);
         return ERROR;
     }
@@ -401,257 +2496,139 @@ int ias_geo_shape_mask_projection
         / num_lines;
     delta_longitude = (lng[max_lng] - lng[min_lng]) / num_samples;
     
-    /* Loop through the grids */
-    for (vgrid = 0; vgrid <= num_vert_grids; vgrid++)
-    {
-        int grid_lines = GRID_SIZE_VERT; /* Number of lines in grid */
-
-        /* If it is the end of the image determine smaller grid */
-        if (vgrid == num_vert_grids)
-        {
-            grid_lines = num_lines % GRID_SIZE_VERT;
-            if (grid_lines == 0)
-            {   
-                continue;
-            }
-        }
+    grid.image = image;
+    grid.min_lng = lng[min_lng];
+    grid.max_lat = corners[max_lat].lat;
+    grid.delta_longitude = delta_longitude;
+    grid.delta_latitude = delta_latitude;
+    grid.bit_mask = bit_mask;
+    grid.packed = options->packed;
+    grid.max_error = options->max_interpolation_error;
+    grid.line_extent = options->line_extent;
+    grid.crosses_180 = crosses_180;
+    grid.mask = mask;
+
+    /* Loop through the rows of grids.  The transformation is only read by
+       the transforms, so the threads share it.  Transformations using the
+       original gctp interface are not threadsafe, so they keep the loop on
+       one thread. */
+    threadsafe = ias_geo_is_threadsafe_transformation(
+        geographic_transformation);
+    rows.grid = &grid;
+    rows.transformation = geographic_transformation;
+    status = espa_parallel_for(num_vert_grids, threadsafe ? 0 : 1,
+        mask_grid_row_task, &rows);
 
-        for (hgrid = 0; hgrid <= num_horz_grids; hgrid++)
-        {
-            IAS_DBL_LS translated_pixel[4];     /* Translated  line/samp */ 
-            IAS_DBL_XY grid_corners[4];         /* UL LL UR LR */
-            int grid_value = -1;                /* Grid match value */
-            int bad_grid = 0;                   /* Boolean for bad grid check */
-            int grid_samples = GRID_SIZE_HORZ;  /* Number of samples in grid */
+    /* Free memory */
+    free(bit_mask);
+    ias_geo_release_cached_proj_transformation(geographic_transformation);
 
-            /* If it is the end of the image determine smaller grid */
-            if (hgrid == num_horz_grids)
-            {
-                grid_samples = num_samples % GRID_SIZE_HORZ;
-                if (grid_samples == 0)
-                {   
-                    continue;
-                }
-            }
+    return status;
+}
 
-            /* Determine corners for current grid square */
-            grid_corners[0].y = corners_ptr->upleft.y - (GRID_SIZE_VERT 
-                * vgrid * image->pixel_size_y);
-            grid_corners[0].x = (GRID_SIZE_HORZ * hgrid 
-                * image->pixel_size_x) + corners_ptr->upleft.x;
+/*****************************************************************************
+NAME:  ias_geo_shape_mask_projection_store
 
-            grid_corners[1].y = grid_corners[0].y - (grid_lines
-                * image->pixel_size_y);
-            grid_corners[1].x = grid_corners[0].x;
+PURPOSE:  Generate a shape mask for a given region in a given projection from
+          an opened polygon file.
 
-            grid_corners[2].y = grid_corners[0].y;
-            grid_corners[2].x = grid_corners[0].x + (grid_samples
-                * image->pixel_size_x);
+RETURN VALUE:
+Type = int
+Value    Description
+-----    -----------
+SUCCESS  Successful completion
+ERROR    Operation failed
 
-            grid_corners[3].y = grid_corners[1].y;
-            grid_corners[3].x = grid_corners[2].x;
-            
-            /* Transform the grid corners to bit mask line/sample */
-            for (index = 0; index < 4; index ++)
-            {
-                int status; /* Status placeholder */
+NOTES: Mask should already be initialized when passed to the routine. It should 
+       be initialized with all zeros.
+*****************************************************************************/
+int ias_geo_shape_mask_projection_store
+(
+    const IAS_POLYGON_STORE *store,   /* I: Opened polygon file */
+    const IAS_IMAGE *image,           /* I: Input image struct pointer */
+    const IAS_PROJECTION *projection, /* I: Input projection struct pointer */
+    unsigned char *mask               /* O: Mask buffer */
+)
+{
+    IAS_GEO_SHAPE_MASK_OPTIONS options = {0, 0.0, 0.0, NULL}; /* Exact
+                                                                 byte mask */
 
-                status = convert_target_xy_to_input_line_sample(
-                    &grid_corners[index], geographic_transformation, 
-                    lng[min_lng], corners[max_lat].lat, 
-                    delta_longitude, delta_latitude, num_samples, 
-                    num_lines, &translated_pixel[index]);
-                if (status == ERROR)
-                {
-                    IAS_LOG_ERROR("Translating grid corners for grid line %d"
-                        " sample %d ", vgrid * GRID_SIZE_VERT, hgrid 
-                        * GRID_SIZE_HORZ);
-                    free(bit_mask);
-                    ias_geo_destroy_proj_transformation(
-                        geographic_transformation);
-                    return ERROR;
-                }
-                else if (!status)
-                {
-                    bad_grid = 1;
-                }
-            }
+    return ias_geo_shape_mask_projection_options_store(store, image,
+        projection, &options, mask);
+}
 
-            /* If all corners are in bit_mask check bit_mask grid */
-            if (!bad_grid)
-            {
-                int min_line = 0;   /* Max line index in bit_mask */
-                int max_line = 0;   /* Min line index in bit_mask */
-                int min_samp = 0;   /* Min sample index in bit_mask */
-                int max_samp = 0;   /* Max sample index in bit_mask */
-                IAS_LNG_LS max_ls;  /* Maximum line/sample */
-                IAS_LNG_LS min_ls;  /* Minimum line/sample */
-
-                /* Creating bounding box around bit_mask grid */
-                for (index = 1; index < 4; index++)
-                {
-                    if (translated_pixel[min_line].line
-                        > translated_pixel[index].line)
-                    {
-                        min_line = index;
-                    }
-                    else if (translated_pixel[max_line].line 
-                             < translated_pixel[index].line)
-                    {
-                        max_line = index;
-                    }   
+/*****************************************************************************
+NAME:  ias_geo_shape_mask_projection_packed_store
 
-                    if (translated_pixel[min_samp].samp 
-                        > translated_pixel[index].samp)
-                    {    
-                        min_samp = index;
-                    }
+PURPOSE:  Generate a shape mask for a given region in a given projection from
+          an opened polygon file, packed to one bit per pixel.
 
-                    else if (translated_pixel[max_samp].samp 
-                             < translated_pixel[index].samp)
-                    {    
-                        max_samp = index;
-                    }
-                }
+RETURN VALUE:
+Type = int
+Value    Description
+-----    -----------
+SUCCESS  Successful completion
+ERROR    Operation failed
 
-                max_ls.line = translated_pixel[max_line].line + 1;
-                max_ls.samp = translated_pixel[max_samp].samp + 1;
-                min_ls.line = translated_pixel[min_line].line;
-                min_ls.samp = translated_pixel[min_samp].samp;
- 
-                /* Make sure the max_ls is still in the image */
-                if (max_ls.line >= num_lines || max_ls.samp >= num_samples)
-                {
-                    bad_grid = 1;
-                }
-                else
-                {
-                    /* Get the bounding box check value */
-                    grid_value = bit_mask[(min_ls.line * num_samples 
-                        + min_ls.samp) / 8];
-                    if (grid_value != ALL_BITS_SET && grid_value != NO_BITS_SET)
-                    {
-                        bad_grid = 1;
-                    }
-                }
+NOTES: The mask holds (image->ns + 7) / 8 bytes per line, each line starting
+       on a byte boundary with its first sample in the most significant bit.
+       A set bit is inside the polygons.  Mask should already be initialized
+       with all zeros when passed to the routine.
+*****************************************************************************/
+int ias_geo_shape_mask_projection_packed_store
+(
+    const IAS_POLYGON_STORE *store,   /* I: Opened polygon file */
+    const IAS_IMAGE *image,           /* I: Input image struct pointer */
+    const IAS_PROJECTION *projection, /* I: Input projection struct pointer */
+    unsigned char *mask               /* O: Packed mask buffer */
+)
+{
+    IAS_GEO_SHAPE_MASK_OPTIONS options = {1, 0.0, 0.0, NULL}; /* Exact
+                                                                 packed mask */
 
-                if (!bad_grid)
-                {
-                    /* Check that all the values in the bounding box are 
-                       identical*/
-                    for (line = min_ls.line; line < max_ls.line; line++)
-                    {
-                        for (sample = min_ls.samp; sample < max_ls.samp; 
-                             sample += 8)
-                        {
-                            int grid_index = (line * num_samples + sample) / 8;
-                            if (bit_mask[grid_index] != grid_value)
-                            {
-                                bad_grid = 1;
-                                break;  
-                            }
-                        }
+    return ias_geo_shape_mask_projection_options_store(store, image,
+        projection, &options, mask);
+}
 
-                        if (bad_grid)
-                        {
-                            break;
-                        }
-                    }
-                }
-            }
-         
-            /* Grid is either all set bits or all empty bits */
-            if (!bad_grid)
-            {
-                if (grid_value == NO_BITS_SET)
-                {
-                    continue;
-                }
+/*****************************************************************************
+NAME:  ias_geo_shape_mask_projection
 
-                for (line = GRID_SIZE_VERT * vgrid; line < GRID_SIZE_VERT 
-                 * vgrid + grid_lines; line++)
-                {    
-                    for (sample = GRID_SIZE_HORZ * hgrid; sample 
-                        < GRID_SIZE_HORZ * hgrid + grid_samples; sample++)
-                    {
-                        index = line * num_samples + sample;
-                        mask[index] = IAS_GEO_SHAPE_MASK_VALID;
-                    }
-                }
+PURPOSE:  Generate a shape mask for a given region in a given projection.
 
-                continue;
-            }
+RETURN VALUE:
+Type = int
+Value    Description
+-----    -----------
+SUCCESS  Successful completion
+ERROR    Operation failed
 
-            /* Loop through image converting each pixel to lat/long */
-            for (line = GRID_SIZE_VERT * vgrid; line < GRID_SIZE_VERT 
-                 * vgrid + grid_lines; line++)
-            {    
-                IAS_DBL_XY current_pixel;/* Current pixel in image using x/y */
+NOTES: Mask should already be initialized when passed to the routine. It should 
+       be initialized with all zeros.
+*****************************************************************************/
+int ias_geo_shape_mask_projection
+(
+    const char *polygon_file,         /* I: Polygon filename */
+    const IAS_IMAGE *image,           /* I: Input image struct pointer */
+    const IAS_PROJECTION *projection, /* I: Input projection struct pointer */
+    unsigned char *mask               /* O: Mask buffer */
+)
+{
+    IAS_POLYGON_STORE *store;         /* Opened polygon file */
+    int status;                       /* Return status */
 
-                /* Calculate the Y coordinate */
-                current_pixel.y = corners_ptr->upleft.y - (line 
-                    * image->pixel_size_y);
-    
-                for (sample = GRID_SIZE_HORZ * hgrid; sample < GRID_SIZE_HORZ
-                     * hgrid + grid_samples; sample++)
-                {
-                    int status; /* Status placeholder */
-                    IAS_DBL_LS translated_pixel; /* Translated to line/samp */
-
-                    /* Calculate the X Coordinate */
-                    current_pixel.x = (sample * image->pixel_size_x) 
-                        + corners_ptr->upleft.x;
-
-                    /* Check if pixel is part of bit mask */
-                    status = convert_target_xy_to_input_line_sample(
-                        &current_pixel, geographic_transformation, 
-                        lng[min_lng], corners[max_lat].lat, 
-                        delta_longitude, delta_latitude, num_samples, 
-                        num_lines, &translated_pixel);
-                    if (status == ERROR)
-                    {
-                        IAS_LOG_ERROR("Translating pixel for line %d sample %d",
-                            line, sample);
-                        free(bit_mask);
-                        ias_geo_destroy_proj_transformation(
-                            geographic_transformation);
-                        return ERROR;
-                    }
-                    else if (status) 
-                    {
-                        unsigned int byte; /* Byte level indexing */
-                        unsigned int bit;  /* Bit level indexing */
-                        int mask_index;
-                        int nearest_line = round(translated_pixel.line);
-                        int nearest_sample = round(translated_pixel.samp);
-
-                        /* Clamp the line to the image after rounding up might
-                           go off the edge */
-                        if (nearest_line >= num_lines)
-                            nearest_line = num_lines - 1;
-                        if (nearest_sample >= num_samples)
-                            nearest_sample = num_samples - 1;
-
-                        mask_index = nearest_line * num_samples 
-                            + nearest_sample;
-                        byte = mask_index / 8;
-                        bit = 7 - mask_index % 8;
-                        index = line * num_samples + sample;
-                        if (bit_mask[byte] & (1 << bit))
-                        {
-                            mask[index] = IAS_GEO_SHAPE_MASK_VALID;
-                        }
-                    } 
-                }
-            } 
-        }
+    /* Open the polygon file. */
+    store = ias_geo_open_polygon_store(polygon_file);
+    if (store == NULL)
+    {
+        IAS_LOG_ERROR("Opening the polygon file %s", polygon_file);
+        return ERROR;
     }
 
-    /* Free memory */
-    free(bit_mask);
-    ias_geo_destroy_proj_transformation(geographic_transformation);
+    status = ias_geo_shape_mask_projection_store(store, image, projection,
+        mask);
 
-    return SUCCESS;
+    ias_geo_close_polygon_store(store);
+    return status;
 }
 
 /*****************************************************************************
@@ -725,6 +2702,179 @@ int ias_geo_point_in_shape
     return FALSE;
 }
 
+/*****************************************************************************
+NAME:  ias_geo_points_in_shape
+
+PURPOSE:  Determine which of an array of points are within a set of polygons.
+
+RETURN VALUE:
+Type = int
+Value    Description
+-----    -----------
+SUCCESS  Successful completion
+ERROR    Operation failed
+
+NOTES: The results match calling ias_geo_point_in_shape for each point.  The
+       points inside each polygon's bounding box are tested together, so the
+       polygon sides are read once per polygon rather than once per point.
+*****************************************************************************/
+int ias_geo_points_in_shape
+(
+    IAS_POLYGON_LINKED_LIST *polygon_list,  /* I: Polygon list */
+    unsigned int num_points,                /* I: Number of points */
+    const double *latitude,                 /* I: Point latitudes (degrees) */
+    const double *longitude,                /* I: Point longitudes (degrees) */
+    int *inside                             /* O: TRUE for each point inside
+                                                  the polygons */
+)
+{
+    IAS_POLYGON_LINKED_LIST *polygon;       /* Polygon linked list pointer */
+    unsigned int *pending = NULL;   /* Points not yet inside a polygon */
+    unsigned int *member = NULL;    /* Points tested against the polygon */
+    double *point_x = NULL;         /* Longitudes of the tested points */
+    double *point_y = NULL;         /* Latitudes of the tested points */
+    int *hit = NULL;                /* Point in polygon results */
+    unsigned int num_pending;       /* Number of points not yet inside */
+    unsigned int index;             /* Point loop counter */
+
+    for (index = 0; index < num_points; index++)
+    {
+        inside[index] = FALSE;
+    }
+    if (num_points == 0)
+        return SUCCESS;
+
+    pending = malloc(num_points * sizeof(*pending));
+    member = malloc(num_points * sizeof(*member));
+    point_x = malloc(num_points * sizeof(*point_x));
+    point_y = malloc(num_points * sizeof(*point_y));
+    hit = malloc(num_points * sizeof(*hit));
+    if (!pending || !member || !point_x || !point_y || !hit)
+    {
+        IAS_LOG_ERROR("Allocating memory for the point in shape tests");
+        free(pending);
+        free(member);
+        free(point_x);
+        free(point_y);
+        free(hit);
+        return ERROR;
+    }
+
+    for (index = 0; index < num_points; index++)
+    {
+        pending[index] = index;
+    }
+    num_pending = num_points;
+
+    for (polygon = polygon_list; polygon && num_pending > 0;
+         polygon = polygon->next)
+    {
+        unsigned int count = 0;     /* Points in the polygon bounding box */
+        unsigned int num_hits = 0;  /* Points inside the polygon */
+        unsigned int kept = 0;      /* Points left pending */
+        unsigned int next_hit = 0;  /* Next hit to remove from pending */
+
+        /* Gather the pending points within the polygon bounding box. */
+        for (index = 0; index < num_pending; index++)
+        {
+            unsigned int point = pending[index];
+
+            if (polygon->min_y > latitude[point]
+                || polygon->max_y < latitude[point]
+                || polygon->min_x > longitude[point]
+                || polygon->max_x < longitude[point])
+            {
+                continue;
+            }
+
+            member[count] = point;
+            point_x[count] = longitude[point];
+            point_y[count] = latitude[point];
+            count++;
+        }
+        if (count == 0)
+            continue;
+
+        /* Determine which of them are inside the polygon. */
+        if (ias_math_points_in_closed_polygon(polygon->num_points - 1,
+                polygon->point_x, polygon->point_y, count, point_x, point_y,
+                polygon->num_segs, polygon->poly_seg, hit) != SUCCESS)
+        {
+            IAS_LOG_ERROR("Checking points in polygon %u", polygon->id);
+            free(pending);
+            free(member);
+            free(point_x);
+            free(point_y);
+            free(hit);
+            return ERROR;
+        }
+
+        for (index = 0; index < count; index++)
+        {
+            if (hit[index])
+            {
+                member[num_hits] = member[index];
+                point_x[num_hits] = point_x[index];
+                point_y[num_hits] = point_y[index];
+                num_hits++;
+            }
+        }
+        if (num_hits == 0)
+            continue;
+
+        /* If there are polygons within this one, points inside a child
+           polygon are considered to be outside the parent polygon. */
+        if (polygon->child)
+        {
+            if (ias_geo_points_in_shape(polygon->child, num_hits, point_y,
+                    point_x, hit) != SUCCESS)
+            {
+                IAS_LOG_ERROR("Checking points in the children of polygon %u",
+                    polygon->id);
+                free(pending);
+                free(member);
+                free(point_x);
+                free(point_y);
+                free(hit);
+                return ERROR;
+            }
+
+            for (index = 0; index < num_hits; index++)
+            {
+                inside[member[index]] = !hit[index];
+            }
+        }
+        else
+        {
+            for (index = 0; index < num_hits; index++)
+            {
+                inside[member[index]] = TRUE;
+            }
+        }
+
+        /* Points inside this polygon are decided.  Both lists are in
+           increasing point order. */
+        for (index = 0; index < num_pending; index++)
+        {
+            if (next_hit < num_hits && pending[index] == member[next_hit])
+            {
+                next_hit++;
+                continue;
+            }
+            pending[kept++] = pending[index];
+        }
+        num_pending = kept;
+    }
+
+    free(pending);
+    free(member);
+    free(point_x);
+    free(point_y);
+    free(hit);
+
+    return SUCCESS;
+}
+
 /*****************************************************************************
 NAME:  ias_geo_point_in_shape_distance
 
@@ -16,6 +16,7 @@ PURPOSE: Implements the standard message logging interface
 #define LOGGING_C
 #include "ias_logging.h"
 #include "ias_const.h"
+#include "espa_log.h"
 
 #define CHANNELS_LENGTH 500 
 
@@ -38,6 +39,11 @@ static int use_blacklist = 0;                     /* Flag indicates if the
 static int dump_registered = 0;                   /* Flag that indicates
                                                      atexit dump handler was
                                                      registered */
+static __thread time_t stamp_time = (time_t) -1;  /* Time of the last
+                                                     timestamp of the
+                                                     thread */
+static __thread char stamp_text[40];              /* Last timestamp of the
+                                                     thread */
 /*************************************************************************/
 
 /*************************************************************************
@@ -269,6 +275,8 @@ int ias_log_set_output_target
     FILE *new_fp    /* I: File pointer for output message */ 
 )
 {
+    /* Write the messages still queued for the old target */
+    espa_log_flush();
     file_ptr = new_fp; 
 
     /* Line based buffering to the output file to prevent delay */ 
@@ -289,6 +297,9 @@ PURPOSE: Gets current timestamp
 RETURNS: SUCCESS -- successfully getting time
          ERROR -- error in getting time
 
+NOTES: The timestamp only changes once a second, so the last one of the
+       thread is reused until the time changes.
+
 **************************************************************************/
 static int format_time
 (
@@ -298,7 +309,7 @@ static int format_time
 )
 {
     time_t ptime;                 /* Time in seconds  */
-    struct tm *ltime;             /* Time in local time */
+    struct tm ltime;              /* Time in local time */
 
     /* Get the current time */
     ptime = time((time_t *) 0);
@@ -308,21 +319,34 @@ static int format_time
         return ERROR;
     }
 
+    /* Reuse the last timestamp of the thread within the same second */
+    if (ptime == stamp_time && stampsize <= (int)sizeof(stamp_text))
+    {
+        strncpy(stamp, stamp_text, stampsize);
+        stamp[stampsize - 1] = '\0';
+        return SUCCESS;
+    }
+
     /* Convert the current time to local time */
-    ltime = localtime(&ptime);
-    if (ltime == NULL)
+    if (localtime_r(&ptime, &ltime) == NULL)
     {
         stamp[0] = '\0';
         return ERROR;
     }
 
     /* Generate the timestamp */
-    if (strftime(stamp, stampsize, format, ltime) == 0) 
+    if (strftime(stamp, stampsize, format, &ltime) == 0) 
     {
         stamp[0] = '\0';
         return ERROR;
     }
 
+    if (stampsize <= (int)sizeof(stamp_text))
+    {
+        strcpy(stamp_text, stamp);
+        stamp_time = ptime;
+    }
+
     return SUCCESS;
 }
 
@@ -334,6 +358,10 @@ PURPOSE: Outputs logging message to the output file pointer
 
 RETURNS: None
 
+NOTES: The message is only formatted if its level is output, and is
+       written through espa_log_write, so it goes through the background
+       thread of the log when it is used (see espa_log.h).
+
 **************************************************************************/
 static void log_message 
 (
@@ -346,6 +374,7 @@ static void log_message
 {
     char time_stamp[20];
     char temp_string[500];
+    char line[700];
     static const char *log_level_message[] = {"DEBUG", "INFO", "WARN", "ERROR"};
 
     /* if file_ptr is not set (ias_log_message is not called), stdout is used */
@@ -374,9 +403,10 @@ static void log_message
         vsnprintf(temp_string, sizeof(temp_string), format, ap);
 
         format_time(time_stamp, sizeof(time_stamp),"%F %H:%M:%S");
-        fprintf(file_ptr, "%19s  %s  %7d %-20s  %6d  %s %s\n",
+        snprintf(line, sizeof(line), "%19s  %s  %7d %-20s  %6d  %s %s\n",
                 time_stamp, program_name, pid, filename, 
-                line_number, log_level_message[log_level], temp_string);     
+                line_number, log_level_message[log_level], temp_string);
+        espa_log_write(file_ptr, line);
     }
 }
 
@@ -29,6 +29,9 @@ Notes on use:
       a '-'  character, the list is treated as a blacklist and all channels
       will be enabled except the listed channels. If IAS_LOG_CHANNELS is not 
       set, all channels are enabled. 
+    - The messages are written through espa_log_write, so setting the
+      ESPA_LOG_ASYNC environment variable to yes has them written by a
+      background thread (see espa_log.h).
 
 ****************************************************************************/
 /* Allow GCC to error check the parameters to the ias_log_message routine
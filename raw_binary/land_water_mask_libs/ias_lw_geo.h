@@ -4,6 +4,7 @@
 #define IAS_LW_GEO_H
 
 #include <stdio.h>
+#include <stdint.h>
 #include "ias_structures.h"
 #include "ias_math.h"
 
@@ -20,6 +21,9 @@
 
 /* Type defines for projection related structures */
 typedef struct ias_geo_proj_transformation IAS_GEO_PROJ_TRANSFORMATION;
+
+/* Polygon file opened for loading (defined in ias_geo_polygon_index.c) */
+typedef struct ias_polygon_store IAS_POLYGON_STORE;
 /* The ias_projection structure matches the gctp_projection structure
    definition.  The gctp_projection structure is not included here to prevent
    needing to modify the build to find gctp.h everywhere ias_geo.h is used. */
@@ -34,6 +38,25 @@ typedef struct ias_projection
                         /* Array of projection parameters */
 } IAS_PROJECTION;
 
+/* Options for generating a shape mask in a projection */
+typedef struct ias_geo_shape_mask_options
+{
+    int packed;         /* Pack the mask to one bit per pixel */
+    double max_interpolation_error; /* Largest error allowed when
+                           interpolating the transformation to geographic
+                           from a coarse grid, in mask pixels; 0 transforms
+                           every point exactly */
+    double max_polygon_error; /* Largest error allowed in the polygon
+                           vertices, in degrees, so a simplified level of
+                           detail of the polygon file can be used; 0 uses
+                           the full polygons */
+    const int32_t *line_extent; /* First and last valid sample of each
+                           line of the image (2 * nl entries, a line
+                           without valid samples having its last before its
+                           first), so only the footprint of the data is
+                           masked; NULL masks every pixel */
+} IAS_GEO_SHAPE_MASK_OPTIONS;
+
 int ias_geo_check_start_end_date
 (
     int isdate,   /* I: start date (YYYYMMDD) */
@@ -501,8 +524,26 @@ void ias_geo_destroy_proj_transformation
     IAS_GEO_PROJ_TRANSFORMATION *trans
 );
 
+IAS_GEO_PROJ_TRANSFORMATION *ias_geo_get_cached_proj_transformation
+(
+    const IAS_PROJECTION *source_projection, /* I: source projection */
+    const IAS_PROJECTION *target_projection  /* I: target projection */
+);
+
+void ias_geo_release_cached_proj_transformation
+(
+    IAS_GEO_PROJ_TRANSFORMATION *trans  /* I: transformation to release */
+);
+
+void ias_geo_clear_proj_transformation_cache();
+
 void ias_geo_only_allow_threadsafe_transforms();
 
+int ias_geo_is_threadsafe_transformation
+(
+    const IAS_GEO_PROJ_TRANSFORMATION *trans /* I: transformation to check */
+);
+
 int ias_geo_transform_coordinate
 (
     const IAS_GEO_PROJ_TRANSFORMATION *trans, /* I: transformation to use */
@@ -512,6 +553,16 @@ int ias_geo_transform_coordinate
     double *outy            /* O: Output Y projection coordinate */
 );
 
+int ias_geo_transform_coordinates
+(
+    const IAS_GEO_PROJ_TRANSFORMATION *trans, /* I: transformation to use */
+    int count,              /* I: Number of points */
+    const double *inx,      /* I: Input X projection coordinates */
+    const double *iny,      /* I: Input Y projection coordinates */
+    double *outx,           /* O: Output X projection coordinates */
+    double *outy            /* O: Output Y projection coordinates */
+);
+
 void ias_geo_set_projection
 (
     int proj_code,          /* I: input projection code */
@@ -549,6 +600,63 @@ int ias_geo_load_polygon
     IAS_POLYGON_LINKED_LIST **head  /* O: Polygon pointer */
 );
 
+int ias_geo_write_polygon_index
+(
+    FILE *fp,                              /* I: File pointer to dump results */
+    const IAS_POLYGON_LINKED_LIST *polygon,/* I: Polygon linked list */
+    unsigned int npolygons,                /* I: Number of polygons */
+    const int64_t *offset                  /* I: Polygon offsets, by id */
+);
+
+int ias_geo_load_indexed_polygon
+(
+    FILE *fp,                       /* I: Input file pointer */
+    double min_x,                   /* I: Minimum x value of interest */
+    double max_x,                   /* I: Maximum x value of interest */
+    double min_y,                   /* I: Minimum y value of interest */
+    double max_y,                   /* I: Maximum y value of interest */
+    IAS_POLYGON_LINKED_LIST **head, /* O: Polygon pointer */
+    int *indexed                    /* O: Flag for a file with an index */
+);
+
+IAS_POLYGON_STORE *ias_geo_open_polygon_store
+(
+    const char *polygon_file        /* I: Polygon filename */
+);
+
+int ias_geo_load_polygon_store
+(
+    const IAS_POLYGON_STORE *store, /* I: Opened polygon file */
+    double min_x,                   /* I: Minimum x value of interest */
+    double max_x,                   /* I: Maximum x value of interest */
+    double min_y,                   /* I: Minimum y value of interest */
+    double max_y,                   /* I: Maximum y value of interest */
+    IAS_POLYGON_LINKED_LIST **head  /* O: Polygon pointer */
+);
+
+int ias_geo_load_polygon_store_level
+(
+    const IAS_POLYGON_STORE *store, /* I: Opened polygon file */
+    double max_error,               /* I: Largest simplification error
+                                       allowed, in degrees; 0 loads the full
+                                       polygons */
+    double min_x,                   /* I: Minimum x value of interest */
+    double max_x,                   /* I: Maximum x value of interest */
+    double min_y,                   /* I: Minimum y value of interest */
+    double max_y,                   /* I: Maximum y value of interest */
+    IAS_POLYGON_LINKED_LIST **head  /* O: Polygon pointer */
+);
+
+void ias_geo_close_polygon_store
+(
+    IAS_POLYGON_STORE *store        /* I: Opened polygon file */
+);
+
+int ias_geo_keep_polygon_store
+(
+    const char *polygon_file        /* I: Polygon filename */
+);
+
 void ias_geo_free_polygon_linked_list
 (
     IAS_POLYGON_LINKED_LIST *polygon    /* I: First polygon in list */
@@ -563,6 +671,15 @@ int ias_geo_reduce_polygon
     double lower_right_y                    /* I: Lower right y */
 );
 
+int ias_geo_simplify_polygon
+(
+    const IAS_POLYGON_LINKED_LIST *polygon, /* I: Polygon to simplify */
+    double tolerance,                   /* I: Tolerance, in the units of the
+                                           vertices */
+    IAS_POLYGON_LINKED_LIST *simplified /* O: Simplified polygon, cleared on
+                                           input */
+);
+
 int ias_geo_shape_mask
 (
     const char *polygon_file,   /* I: Polygon filename */
@@ -575,6 +692,43 @@ int ias_geo_shape_mask
     unsigned char *mask         /* O: Mask buffer */
 );
 
+int ias_geo_shape_mask_store
+(
+    const IAS_POLYGON_STORE *store, /* I: Opened polygon file */
+    unsigned int num_lines,     /* I: Number of lines in mask */
+    unsigned int num_samples,   /* I: Number of samples in mask */
+    double upper_left_lat,      /* I: Upper left latitude for mask */
+    double lower_right_lat,     /* I: Lower right latitude for mask */
+    double upper_left_long,     /* I: Upper left longitude for mask */
+    double lower_right_long,    /* I: Lower right longitude for mask */
+    unsigned char *mask         /* O: Mask buffer */
+);
+
+int ias_geo_shape_mask_projection_store
+(
+    const IAS_POLYGON_STORE *store,   /* I: Opened polygon file */
+    const IAS_IMAGE *image,           /* I: Input image struct pointer */
+    const IAS_PROJECTION *projection, /* I: Input projection struct pointer */
+    unsigned char *mask               /* O: Mask buffer */
+);
+
+int ias_geo_shape_mask_projection_options_store
+(
+    const IAS_POLYGON_STORE *store,   /* I: Opened polygon file */
+    const IAS_IMAGE *image,           /* I: Input image struct pointer */
+    const IAS_PROJECTION *projection, /* I: Input projection struct pointer */
+    const IAS_GEO_SHAPE_MASK_OPTIONS *options, /* I: Mask options */
+    unsigned char *mask               /* O: Mask buffer */
+);
+
+int ias_geo_shape_mask_projection_packed_store
+(
+    const IAS_POLYGON_STORE *store,   /* I: Opened polygon file */
+    const IAS_IMAGE *image,           /* I: Input image struct pointer */
+    const IAS_PROJECTION *projection, /* I: Input projection struct pointer */
+    unsigned char *mask               /* O: Packed mask buffer */
+);
+
 int ias_geo_shape_mask_projection
 (
     const char *polygon_file,         /* I: Polygon filename */
@@ -590,6 +744,16 @@ int ias_geo_point_in_shape
     double longitude                        /* I: Point longitude (degrees) */
 );
 
+int ias_geo_points_in_shape
+(
+    IAS_POLYGON_LINKED_LIST *polygon_list,  /* I: Polygon list */
+    unsigned int num_points,                /* I: Number of points */
+    const double *latitude,                 /* I: Point latitudes (degrees) */
+    const double *longitude,                /* I: Point longitudes (degrees) */
+    int *inside                             /* O: TRUE for each point inside
+                                                  the polygons */
+);
+
 int ias_geo_point_in_shape_distance
 (
     IAS_POLYGON_LINKED_LIST *polygon_list, /* I: Polygon list */
@@ -704,6 +704,19 @@ int ias_math_point_in_closed_polygon
     const IAS_POLYGON_SEGMENT *poly_seg/* I: Array of polygon segments */
 );
 
+int ias_math_points_in_closed_polygon
+(
+    unsigned int num_sides,     /* I: Number of sides in polygon */
+    const double *vert_x,       /* I: Vertices of polygon */
+    const double *vert_y,       /* I: Vertices of polygon */
+    unsigned int num_points,    /* I: Number of points to test */
+    const double *point_x,      /* I: X coordinates of the points */
+    const double *point_y,      /* I: Y coordinates of the points */
+    unsigned int num_segs,      /* I: Number of polygon segments */
+    const IAS_POLYGON_SEGMENT *poly_seg,/* I: Array of polygon segments */
+    int *inside                 /* O: TRUE for each point inside polygon */
+);
+
 int ias_math_point_in_closed_polygon_distance
 (
     unsigned int num_sides,              /* I: Number of sides in polygon */
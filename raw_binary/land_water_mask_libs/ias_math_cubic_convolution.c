@@ -0,0 +1,44 @@
+/* Standard Library Includes */
+#include <math.h>
+
+/* IAS Library Includes */
+#include "ias_math.h"
+
+/*****************************************************************************
+NAME:  ias_math_cubic_convolution
+
+PURPOSE: Compute the cubic convolution weight of a sample at a distance x
+         from the point being resampled.
+
+RETURN VALUE:
+Type = double
+Value    Description
+-----    -----------
+weight   Weight of the sample; 0.0 for samples two or more away
+
+ALGORITHM:
+    The piecewise cubic of Keys (1981), "Cubic Convolution Interpolation for
+    Digital Image Processing":
+        (alpha + 2)|x|^3 - (alpha + 3)|x|^2 + 1        for |x| <= 1
+        alpha|x|^3 - 5alpha|x|^2 + 8alpha|x| - 4alpha  for 1 < |x| < 2
+        0                                              otherwise
+
+Notes:  An alpha of -0.5 reproduces a quadratic exactly; the IAS resamplers
+        use it unless calibrating against another alpha.
+
+*****************************************************************************/
+double ias_math_cubic_convolution
+(
+   double alpha,   /* I: Cubic convolution alpha parameter     */
+   double x        /* I: Value to perform cubic convolution on */
+)
+{
+    double ax = fabs(x);    /* Distance from the point */
+
+    if (ax <= 1.0)
+        return ((alpha + 2.0) * ax - (alpha + 3.0)) * ax * ax + 1.0;
+    if (ax < 2.0)
+        return ((alpha * ax - 5.0 * alpha) * ax + 8.0 * alpha) * ax
+            - 4.0 * alpha;
+    return 0.0;
+}
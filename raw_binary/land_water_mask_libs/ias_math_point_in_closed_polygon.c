@@ -1,3 +1,6 @@
+/* Standard Library Includes */
+#include <math.h>
+
 /* IAS Library Includes */
 #include "ias_logging.h"
 #include "ias_types.h"  
@@ -5,6 +8,9 @@
 #include "ias_math.h"
 #include "ias_const.h"
 
+/* Number of points tested together by ias_math_points_in_closed_polygon */
+#define POINT_BLOCK_SIZE 256
+
 /*****************************************************************************
 NAME:  ias_math_point_in_closed_polygon
 
@@ -96,6 +102,158 @@ int ias_math_point_in_closed_polygon
     return intflag;
 }
 
+/*****************************************************************************
+NAME:  ias_math_points_in_closed_polygon
+
+PURPOSE: Determine which of an array of points are located within the bounds
+         of a polygon.
+
+RETURN VALUE:
+Type = int
+Value    Description
+-----    -----------
+SUCCESS     Successful completion
+ERROR       Unable to compute
+
+ALGORITHM:
+    Same test as ias_math_point_in_closed_polygon, applied to a block of
+    points at a time.  Segments whose bounding box rejects the whole block
+    are skipped.  For the others the points of the block passing the
+    segment bounding box test are gathered, and each side of the segment
+    is tested against all of them in a loop without branches, counting the
+    crossings with compares and adds so the compiler can vectorize it.
+
+Notes:  There shoud be one more point in vertex arrays than the number
+        of sides.  The results match calling
+        ias_math_point_in_closed_polygon for each point.
+
+*****************************************************************************/
+int ias_math_points_in_closed_polygon
+(
+    unsigned int num_sides,             /* I: Number of sides in polygon */
+    const double *vert_x,               /* I: Vertices of polygon */
+    const double *vert_y,               /* I: Vertices of polygon */
+    unsigned int num_points,            /* I: Number of points to test */
+    const double *point_x,              /* I: X coordinates of the points */
+    const double *point_y,              /* I: Y coordinates of the points */
+    unsigned int num_segs,              /* I: Number of polygon segments */
+    const IAS_POLYGON_SEGMENT *poly_seg,/* I: Array of polygon segments */
+    int *inside                         /* O: TRUE for each point inside the
+                                              polygon, FALSE otherwise */
+)
+{
+    IAS_POLYGON_SEGMENT whole;  /* Segment of every side, used when the
+                                   polygon has no segments */
+    unsigned int block;         /* First point of the current block */
+
+    if (num_sides < 3) 
+    {
+        IAS_LOG_ERROR("Need at least three sides for polygon.");
+        return ERROR;
+    }
+
+    /* Without segments, every point is tested against every side */
+    if (num_segs == 0)
+    {
+        whole.first_point = 0;
+        whole.last_point = num_sides;
+        whole.min_x = -HUGE_VAL;
+        whole.max_x = HUGE_VAL;
+        whole.max_y = HUGE_VAL;
+        poly_seg = &whole;
+        num_segs = 1;
+    }
+
+    for (block = 0; block < num_points; block += POINT_BLOCK_SIZE)
+    {
+        unsigned char inside_flag[POINT_BLOCK_SIZE]; /* Crossing parity */
+        unsigned char crossings[POINT_BLOCK_SIZE];   /* Gathered crossings */
+        unsigned int member[POINT_BLOCK_SIZE];  /* Gathered block points */
+        double gather_x[POINT_BLOCK_SIZE];  /* Gathered x coordinates */
+        double gather_y[POINT_BLOCK_SIZE];  /* Gathered y coordinates */
+        unsigned int count;     /* Number of points in the block */
+        unsigned int index;     /* Block point loop counter */
+        unsigned int segment;   /* Segment loop counter */
+        double min_x;           /* Minimum x of the block */
+        double max_x;           /* Maximum x of the block */
+        double min_y;           /* Minimum y of the block */
+
+        count = num_points - block;
+        if (count > POINT_BLOCK_SIZE)
+            count = POINT_BLOCK_SIZE;
+
+        min_x = max_x = point_x[block];
+        min_y = point_y[block];
+        for (index = 0; index < count; index++)
+        {
+            inside_flag[index] = 0;
+            min_x = IAS_MIN(min_x, point_x[block + index]);
+            max_x = IAS_MAX(max_x, point_x[block + index]);
+            min_y = IAS_MIN(min_y, point_y[block + index]);
+        }
+
+        for (segment = 0; segment < num_segs; segment++)
+        {
+            const IAS_POLYGON_SEGMENT *seg = &poly_seg[segment];
+            unsigned int num_gathered = 0;  /* Points passing the segment
+                                               bounding box */
+            unsigned int point;     /* Side loop counter */
+
+            /* Skip segments whose bounding box rejects the whole block */
+            if (seg->min_x > max_x || seg->max_x < min_x || seg->max_y < min_y)
+            {
+                continue;
+            }
+
+            for (index = 0; index < count; index++)
+            {
+                double x = point_x[block + index];
+                double y = point_y[block + index];
+
+                /* Store every point, only keeping the ones that pass */
+                member[num_gathered] = index;
+                gather_x[num_gathered] = x;
+                gather_y[num_gathered] = y;
+                crossings[num_gathered] = 0;
+                num_gathered += (seg->min_x <= x) & (seg->max_x >= x)
+                    & (seg->max_y >= y);
+            }
+            if (num_gathered == 0)
+                continue;
+
+            /* Count the sides each point's +y ray crosses */
+            for (point = seg->first_point; point < seg->last_point; point++)
+            {
+                double x0 = vert_x[point];      /* Side start x */
+                double x1 = vert_x[point + 1];  /* Side end x */
+                double y0 = vert_y[point];      /* Side start y */
+                double y1 = vert_y[point + 1];  /* Side end y */
+
+                for (index = 0; index < num_gathered; index++)
+                {
+                    crossings[index] += ((x0 > gather_x[index])
+                        != (x1 > gather_x[index]))
+                        & (gather_y[index] < (y1 - y0)
+                        * (gather_x[index] - x0) / (x1 - x0) + y0);
+                }
+            }
+
+            for (index = 0; index < num_gathered; index++)
+            {
+                inside_flag[member[index]] ^= crossings[index] & 1;
+            }
+        }
+
+        /* An odd number of crossings puts the point inside the polygon */
+        for (index = 0; index < count; index++)
+        {
+            inside[block + index] = inside_flag[index];
+        }
+    }
+
+    return SUCCESS;
+}
+
 /*****************************************************************************
 NAME:  ias_math_point_in_polygon_distance
 
@@ -0,0 +1,1017 @@
+/*****************************************************************************
+FILE: land_mass_polygon.c
+
+PURPOSE: Contains functions for compiling the land-mass polygon file from
+source shapefiles.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The shapefile headers are decoded a byte at a time, since the file and
+     record headers are big-endian and the shapes are little-endian.
+  2. The rings are segmented, and their parents found, in parallel on the
+     task pool.  The candidate parents of a ring are found from a grid over
+     the bounding boxes of all the rings, holding the rings overlapping each
+     cell from the smallest to the largest, so the first candidate which
+     contains the ring is its parent.
+  3. A ring is taken to be inside another if its first vertex is, so rings
+     which cross each other aren't nested reliably.  Rings which only touch
+     at shared vertices may be nested either way.
+*****************************************************************************/
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include "land_mass_polygon.h"
+#include "ias_lw_geo.h"
+#include "ias_math.h"
+#include "espa_task_pool.h"
+
+/* Shapefile layout */
+#define LM_SHP_FILE_CODE 9994     /* file code at the start of a .shp */
+#define LM_SHP_HEADER_BYTES 100   /* bytes in the file header */
+#define LM_SHP_RECORD_BYTES 8     /* bytes in a record header */
+#define LM_SHP_POLYGON_BYTES 44   /* bytes of a polygon before its parts */
+#define LM_SHP_NULL 0             /* shape types read */
+#define LM_SHP_POLYGON 5
+#define LM_SHP_POLYGONZ 15
+#define LM_SHP_POLYGONM 25
+
+/* Number of cells along each side of the grid of candidate parents */
+#define LM_NEST_GRID 256
+
+/* Segmenting of a polygon, run by run */
+typedef struct
+{
+    IAS_POLYGON_LINKED_LIST *polygon;  /* polygon being segmented */
+    int target_sides;         /* sides a segment grows to */
+    int max_sides;            /* most sides in a segment */
+    unsigned int seg_first;   /* first vertex of the open segment */
+    unsigned int nsides;      /* sides in the open segment */
+    unsigned int max_segs;    /* number of segments allocated */
+} Lm_segmenter_t;
+
+/* Segmenting of all the rings, shared by the workers */
+typedef struct
+{
+    Lm_rings_t *rings;        /* rings to be segmented */
+    int target_sides;         /* sides a segment grows to */
+    int max_sides;            /* most sides in a segment */
+} Lm_segment_all_t;
+
+/* Nesting of the rings, shared by the workers */
+typedef struct
+{
+    Lm_rings_t *rings;        /* rings to be nested */
+    int *rank;                /* position of each ring from the smallest to
+                                 the largest area */
+    int *parent;              /* index of the parent of each ring; -1 for a
+                                 top level ring */
+    double min_x;             /* smallest x of the grid */
+    double min_y;             /* smallest y of the grid */
+    double cell_x;            /* size of a cell of the grid in x */
+    double cell_y;            /* size of a cell of the grid in y */
+    int *cell_start;          /* first entry of each cell, and the end of
+                                 the entries */
+    int *cell_rings;          /* rings overlapping each cell, from the
+                                 smallest area */
+} Lm_nest_t;
+
+
+/******************************************************************************
+MODULE:  shp_be32, shp_le32, shp_le_double
+
+PURPOSE: Decode the big-endian and little-endian values of a shapefile.
+
+RETURN VALUE:
+Type = uint32_t or double
+Value        Description
+-------      -----------
+value        Decoded value
+******************************************************************************/
+static uint32_t shp_be32 (const unsigned char *b)
+{
+    return ((uint32_t) b[0] << 24) | ((uint32_t) b[1] << 16) |
+        ((uint32_t) b[2] << 8) | b[3];
+}
+
+static uint32_t shp_le32 (const unsigned char *b)
+{
+    return ((uint32_t) b[3] << 24) | ((uint32_t) b[2] << 16) |
+        ((uint32_t) b[1] << 8) | b[0];
+}
+
+static double shp_le_double (const unsigned char *b)
+{
+    uint64_t bits = 0;        /* bits of the value */
+    double value;             /* decoded value */
+    int i;                    /* looping variable for the bytes */
+
+    for (i = 7; i >= 0; i--)
+        bits = (bits << 8) | b[i];
+    memcpy (&value, &bits, sizeof (value));
+    return value;
+}
+
+
+/******************************************************************************
+MODULE:  add_ring
+
+PURPOSE: Adds a ring of a shape to the rings read.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-------      -----------
+ERROR        Error allocating memory for the ring
+SUCCESS      The ring was added, or skipped for having too few sides
+
+NOTES:
+1. A ring which isn't closed gets a copy of its first vertex at the end.
+******************************************************************************/
+static int add_ring
+(
+    Lm_rings_t *rings,        /* I/O: rings read so far */
+    const unsigned char *points, /* I: x and y of each vertex of the ring */
+    unsigned int npoints      /* I: number of vertices of the ring */
+)
+{
+    char FUNC_NAME[] = "add_ring";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    IAS_POLYGON_LINKED_LIST *ring = NULL;  /* ring being added */
+    IAS_POLYGON_LINKED_LIST **grown = NULL;  /* reallocated rings */
+    unsigned int closed;      /* number of vertices, with the closing copy
+                                 of the first */
+    unsigned int p;           /* looping variable for the vertices */
+
+    closed = npoints;
+    if (shp_le_double (points) != shp_le_double (&points[16 * (npoints-1)])
+        || shp_le_double (&points[8]) != shp_le_double (
+        &points[16 * (npoints-1) + 8]))
+        closed++;
+    if (closed < 4)
+        return (SUCCESS);
+
+    if (rings->nrings == rings->max_rings)
+    {
+        rings->max_rings = rings->max_rings ? 2 * rings->max_rings : 1024;
+        grown = realloc (rings->rings, rings->max_rings *
+            sizeof (IAS_POLYGON_LINKED_LIST *));
+        if (grown == NULL)
+        {
+            sprintf (errmsg, "Allocating memory for the rings");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+        rings->rings = grown;
+    }
+
+    ring = calloc (1, sizeof (IAS_POLYGON_LINKED_LIST));
+    if (ring != NULL)
+    {
+        ring->point_x = malloc (closed * sizeof (double));
+        ring->point_y = malloc (closed * sizeof (double));
+    }
+    if (ring == NULL || ring->point_x == NULL || ring->point_y == NULL)
+    {
+        sprintf (errmsg, "Allocating memory for a ring of %u vertices",
+            closed);
+        error_handler (true, FUNC_NAME, errmsg);
+        ias_geo_free_polygon_linked_list (ring);
+        return (ERROR);
+    }
+
+    for (p = 0; p < npoints; p++)
+    {
+        ring->point_x[p] = shp_le_double (&points[16 * p]);
+        ring->point_y[p] = shp_le_double (&points[16 * p + 8]);
+    }
+    ring->point_x[closed-1] = ring->point_x[0];
+    ring->point_y[closed-1] = ring->point_y[0];
+    ring->num_points = closed;
+
+    ring->min_x = ring->max_x = ring->point_x[0];
+    ring->min_y = ring->max_y = ring->point_y[0];
+    for (p = 1; p < closed; p++)
+    {
+        ring->min_x = fmin (ring->min_x, ring->point_x[p]);
+        ring->max_x = fmax (ring->max_x, ring->point_x[p]);
+        ring->min_y = fmin (ring->min_y, ring->point_y[p]);
+        ring->max_y = fmax (ring->max_y, ring->point_y[p]);
+    }
+
+    rings->rings[rings->nrings++] = ring;
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  read_land_mass_shapefile
+
+PURPOSE: Reads the rings of the polygons of a shapefile.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-------      -----------
+ERROR        Error reading the shapefile, or it holds shapes other than
+             polygons
+SUCCESS      Successful completion
+
+NOTES:
+1. Rings with fewer than three sides are skipped.
+******************************************************************************/
+int read_land_mass_shapefile
+(
+    const char *shp_file,             /* I: name of the .shp file */
+    Lm_rings_t *rings                 /* I/O: rings read so far; the rings
+                                            of the file are appended */
+)
+{
+    char FUNC_NAME[] = "read_land_mass_shapefile";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    unsigned char header[LM_SHP_HEADER_BYTES];  /* file or record header */
+    unsigned char *content = NULL;  /* content of the current record */
+    unsigned char *grown = NULL;    /* reallocated content */
+    size_t max_bytes = 0;     /* bytes allocated for the content */
+    size_t nbytes;            /* bytes of content in the record */
+    uint32_t shape_type;      /* type of the shape of the record */
+    uint32_t nparts;          /* number of rings of the shape */
+    uint32_t npoints;         /* number of vertices of the shape */
+    uint32_t first, last;     /* first and end vertices of a ring */
+    uint32_t part;            /* looping variable for the rings */
+    int status = SUCCESS;     /* return status */
+    FILE *fp = NULL;          /* shapefile */
+
+    fp = fopen (shp_file, "rb");
+    if (fp == NULL)
+    {
+        sprintf (errmsg, "Opening the shapefile %s", shp_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    if (fread (header, LM_SHP_HEADER_BYTES, 1, fp) != 1 ||
+        shp_be32 (header) != LM_SHP_FILE_CODE)
+    {
+        sprintf (errmsg, "%s is not a shapefile", shp_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        fclose (fp);
+        return (ERROR);
+    }
+
+    while (status == SUCCESS &&
+        fread (header, LM_SHP_RECORD_BYTES, 1, fp) == 1)
+    {
+        /* Read the content of the record; its length is in 16-bit words */
+        nbytes = 2 * (size_t) shp_be32 (&header[4]);
+        if (nbytes > max_bytes)
+        {
+            grown = realloc (content, nbytes);
+            if (grown == NULL)
+            {
+                sprintf (errmsg, "Allocating memory for a shapefile record "
+                    "of %zu bytes", nbytes);
+                error_handler (true, FUNC_NAME, errmsg);
+                status = ERROR;
+                break;
+            }
+            content = grown;
+            max_bytes = nbytes;
+        }
+        if (nbytes < 4 || fread (content, nbytes, 1, fp) != 1)
+        {
+            sprintf (errmsg, "Reading record %u of %s", shp_be32 (header),
+                shp_file);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+            break;
+        }
+
+        shape_type = shp_le32 (content);
+        if (shape_type == LM_SHP_NULL)
+            continue;
+        if (shape_type != LM_SHP_POLYGON && shape_type != LM_SHP_POLYGONZ &&
+            shape_type != LM_SHP_POLYGONM)
+        {
+            sprintf (errmsg, "Record %u of %s has shape type %u, which isn't "
+                "a polygon", shp_be32 (header), shp_file, shape_type);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+            break;
+        }
+
+        /* Add each ring of the polygon */
+        nparts = nbytes < LM_SHP_POLYGON_BYTES ? 0 : shp_le32 (&content[36]);
+        npoints = nbytes < LM_SHP_POLYGON_BYTES ? 0 : shp_le32 (&content[40]);
+        if (nbytes < LM_SHP_POLYGON_BYTES || LM_SHP_POLYGON_BYTES +
+            4 * (size_t) nparts + 16 * (size_t) npoints > nbytes)
+        {
+            sprintf (errmsg, "Record %u of %s is truncated",
+                shp_be32 (header), shp_file);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+            break;
+        }
+        for (part = 0; part < nparts && status == SUCCESS; part++)
+        {
+            first = shp_le32 (&content[LM_SHP_POLYGON_BYTES + 4 * part]);
+            last = part + 1 < nparts ? shp_le32 (&content[
+                LM_SHP_POLYGON_BYTES + 4 * (part + 1)]) : npoints;
+            if (first >= last || last > npoints)
+            {
+                sprintf (errmsg, "Record %u of %s has invalid parts",
+                    shp_be32 (header), shp_file);
+                error_handler (true, FUNC_NAME, errmsg);
+                status = ERROR;
+                break;
+            }
+            status = add_ring (rings, &content[LM_SHP_POLYGON_BYTES +
+                4 * nparts + 16 * (size_t) first], last - first);
+        }
+    }
+
+    free (content);
+    fclose (fp);
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  add_segment
+
+PURPOSE: Closes a segment of the polygon being segmented.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-------      -----------
+ERROR        Error allocating memory for the segments
+SUCCESS      Successful completion
+******************************************************************************/
+static int add_segment
+(
+    Lm_segmenter_t *sg,       /* I/O: segmenting of the polygon */
+    unsigned int first,       /* I: first vertex of the segment */
+    unsigned int last         /* I: last vertex of the segment */
+)
+{
+    char FUNC_NAME[] = "add_segment";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    IAS_POLYGON_LINKED_LIST *polygon = sg->polygon;  /* polygon */
+    IAS_POLYGON_SEGMENT *grown = NULL;  /* reallocated segments */
+    IAS_POLYGON_SEGMENT *seg = NULL;    /* segment being closed */
+    unsigned int p;           /* looping variable for the vertices */
+
+    if (polygon->num_segs == sg->max_segs)
+    {
+        sg->max_segs = sg->max_segs ? 2 * sg->max_segs : 16;
+        grown = realloc (polygon->poly_seg, sg->max_segs *
+            sizeof (IAS_POLYGON_SEGMENT));
+        if (grown == NULL)
+        {
+            sprintf (errmsg, "Allocating memory for the segments of a "
+                "polygon of %u vertices", polygon->num_points);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+        polygon->poly_seg = grown;
+    }
+
+    seg = &polygon->poly_seg[polygon->num_segs++];
+    seg->first_point = first;
+    seg->last_point = last;
+    seg->min_x = seg->max_x = polygon->point_x[first];
+    seg->min_y = seg->max_y = polygon->point_y[first];
+    for (p = first + 1; p <= last; p++)
+    {
+        seg->min_x = fmin (seg->min_x, polygon->point_x[p]);
+        seg->max_x = fmax (seg->max_x, polygon->point_x[p]);
+        seg->min_y = fmin (seg->min_y, polygon->point_y[p]);
+        seg->max_y = fmax (seg->max_y, polygon->point_y[p]);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  add_run
+
+PURPOSE: Adds a run of sides monotone in x to the segments of the polygon
+being segmented.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-------      -----------
+ERROR        Error allocating memory for the segments
+SUCCESS      Successful completion
+
+NOTES:
+1. The run joins the open segment unless that makes it longer than the most
+   sides allowed.  The open segment is closed once it reaches the target
+   number of sides.
+2. A run longer than the most sides allowed is cut into the fewest pieces
+   of equal length which fit.
+******************************************************************************/
+static int add_run
+(
+    Lm_segmenter_t *sg,       /* I/O: segmenting of the polygon */
+    unsigned int first,       /* I: first vertex of the run */
+    unsigned int last         /* I: last vertex of the run */
+)
+{
+    unsigned int nsides = last - first;  /* sides in the run */
+    unsigned int npieces;     /* pieces a long run is cut into */
+    unsigned int k;           /* looping variable for the pieces */
+
+    if (nsides > (unsigned int) sg->max_sides)
+    {
+        if (sg->nsides > 0 && add_segment (sg, sg->seg_first, first)
+            != SUCCESS)
+            return (ERROR);
+        npieces = (nsides + sg->max_sides - 1) / sg->max_sides;
+        for (k = 0; k < npieces; k++)
+        {
+            if (add_segment (sg, first + (uint64_t) nsides * k / npieces,
+                first + (uint64_t) nsides * (k + 1) / npieces) != SUCCESS)
+                return (ERROR);
+        }
+        sg->seg_first = last;
+        sg->nsides = 0;
+        return (SUCCESS);
+    }
+
+    if (sg->nsides + nsides > (unsigned int) sg->max_sides)
+    {
+        if (add_segment (sg, sg->seg_first, first) != SUCCESS)
+            return (ERROR);
+        sg->seg_first = first;
+        sg->nsides = 0;
+    }
+
+    sg->nsides += nsides;
+    if (sg->nsides >= (unsigned int) sg->target_sides)
+    {
+        if (add_segment (sg, sg->seg_first, last) != SUCCESS)
+            return (ERROR);
+        sg->seg_first = last;
+        sg->nsides = 0;
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  segment_land_mass_polygon
+
+PURPOSE: Replaces the segments of a polygon with segments tuned for the
+culling of the point in polygon tests.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-------      -----------
+ERROR        Error allocating memory for the segments
+SUCCESS      Successful completion
+
+NOTES:
+1. A polygon of no more than the target number of sides is left without
+   segments, since its bounding box already culls it as well as a single
+   segment would.
+2. Sides with no extent in x continue the run they're in.
+******************************************************************************/
+int segment_land_mass_polygon
+(
+    IAS_POLYGON_LINKED_LIST *polygon, /* I/O: polygon whose segments are
+                                            replaced */
+    int target_sides,                 /* I: sides a segment grows to */
+    int max_sides                     /* I: most sides in a segment */
+)
+{
+    unsigned int nsides = polygon->num_points - 1;  /* sides of the
+                                 polygon */
+    unsigned int run_first = 0;  /* first vertex of the current run */
+    unsigned int side;        /* looping variable for the sides */
+    int dir = 0;              /* direction in x of the current run */
+    int side_dir;             /* direction in x of the current side */
+    double dx;                /* extent in x of the current side */
+    Lm_segmenter_t sg;        /* segmenting of the polygon */
+
+    free (polygon->poly_seg);
+    polygon->poly_seg = NULL;
+    polygon->num_segs = 0;
+    if (nsides <= (unsigned int) target_sides)
+        return (SUCCESS);
+
+    memset (&sg, 0, sizeof (sg));
+    sg.polygon = polygon;
+    sg.target_sides = target_sides;
+    sg.max_sides = max_sides;
+
+    for (side = 0; side < nsides; side++)
+    {
+        dx = polygon->point_x[side + 1] - polygon->point_x[side];
+        side_dir = (dx > 0.0) - (dx < 0.0);
+        if (side_dir != 0 && dir != 0 && side_dir != dir)
+        {
+            if (add_run (&sg, run_first, side) != SUCCESS)
+                return (ERROR);
+            run_first = side;
+        }
+        if (side_dir != 0)
+            dir = side_dir;
+    }
+    if (add_run (&sg, run_first, nsides) != SUCCESS ||
+        (sg.nsides > 0 && add_segment (&sg, sg.seg_first, nsides)
+        != SUCCESS))
+        return (ERROR);
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  segment_ring
+
+PURPOSE: Segments one ring (an iteration of the parallel loop).
+
+RETURN VALUE:
+Type = int
+Value        Description
+-------      -----------
+ERROR        Error allocating memory for the segments
+SUCCESS      Successful completion
+******************************************************************************/
+static int segment_ring
+(
+    void *arg,                /* I/O: segmenting of all the rings */
+    int index,                /* I: index of the ring */
+    int worker                /* I: index of the worker (unused) */
+)
+{
+    Lm_segment_all_t *all = arg;  /* segmenting of all the rings */
+
+    return segment_land_mass_polygon (all->rings->rings[index],
+        all->target_sides, all->max_sides);
+}
+
+
+/******************************************************************************
+MODULE:  ring_area
+
+PURPOSE: Computes the area enclosed by a ring.
+
+RETURN VALUE:
+Type = double
+Value        Description
+-------      -----------
+area         Area, in squared units of the vertices, whatever the
+             orientation of the ring
+******************************************************************************/
+static double ring_area
+(
+    const IAS_POLYGON_LINKED_LIST *ring  /* I: ring */
+)
+{
+    double sum = 0.0;         /* twice the signed area */
+    unsigned int p;           /* looping variable for the vertices */
+
+    for (p = 0; p + 1 < ring->num_points; p++)
+        sum += (ring->point_x[p] - ring->point_x[0]) *
+            (ring->point_y[p+1] - ring->point_y[0]) -
+            (ring->point_x[p+1] - ring->point_x[0]) *
+            (ring->point_y[p] - ring->point_y[0]);
+
+    return (0.5 * fabs (sum));
+}
+
+
+/******************************************************************************
+MODULE:  find_parent
+
+PURPOSE: Finds the smallest ring containing a ring (an iteration of the
+parallel loop).
+
+RETURN VALUE:
+Type = int
+Value        Description
+-------      -----------
+SUCCESS      Always
+******************************************************************************/
+static int find_parent
+(
+    void *arg,                /* I/O: nesting of the rings */
+    int index,                /* I: index of the ring */
+    int worker                /* I: index of the worker (unused) */
+)
+{
+    Lm_nest_t *nest = arg;    /* nesting of the rings */
+    const IAS_POLYGON_LINKED_LIST *ring = nest->rings->rings[index];
+                              /* ring whose parent is found */
+    const IAS_POLYGON_LINKED_LIST *cand = NULL;  /* candidate parent */
+    double x = ring->point_x[0];  /* first vertex of the ring */
+    double y = ring->point_y[0];
+    int cx, cy;               /* cell of the first vertex */
+    int cell;                 /* index of the cell */
+    int e;                    /* looping variable for the cell entries */
+    int j;                    /* index of the candidate parent */
+
+    nest->parent[index] = -1;
+    cx = (int) ((x - nest->min_x) / nest->cell_x);
+    cy = (int) ((y - nest->min_y) / nest->cell_y);
+    cell = (cy < LM_NEST_GRID ? cy : LM_NEST_GRID - 1) * LM_NEST_GRID +
+        (cx < LM_NEST_GRID ? cx : LM_NEST_GRID - 1);
+
+    for (e = nest->cell_start[cell]; e < nest->cell_start[cell + 1]; e++)
+    {
+        j = nest->cell_rings[e];
+        if (nest->rank[j] <= nest->rank[index])
+            continue;
+        cand = nest->rings->rings[j];
+        if (cand->min_x > ring->min_x || cand->max_x < ring->max_x ||
+            cand->min_y > ring->min_y || cand->max_y < ring->max_y)
+            continue;
+        if (ias_math_point_in_closed_polygon (cand->num_points - 1,
+            cand->point_x, cand->point_y, x, y, cand->num_segs,
+            cand->poly_seg) == TRUE)
+        {
+            nest->parent[index] = j;
+            break;
+        }
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  compare_area
+
+PURPOSE: Orders the rings from the smallest to the largest area.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+<0, 0, >0       a goes before, with, or after b
+******************************************************************************/
+static const double *sort_areas = NULL;  /* areas of the rings being
+                                            sorted */
+
+static int compare_area
+(
+    const void *a,            /* I: index of the first ring */
+    const void *b             /* I: index of the second ring */
+)
+{
+    int ia = *(const int *) a;  /* index of the first ring */
+    int ib = *(const int *) b;  /* index of the second ring */
+
+    if (sort_areas[ia] != sort_areas[ib])
+        return (sort_areas[ia] < sort_areas[ib] ? -1 : 1);
+    return (ia - ib);
+}
+
+
+/******************************************************************************
+MODULE:  number_polygons
+
+PURPOSE: Numbers the polygons of a tree from 1, in the order they're written
+to the polygon file.
+
+RETURN VALUE:
+Type = None
+******************************************************************************/
+static void number_polygons
+(
+    IAS_POLYGON_LINKED_LIST *polygon,  /* I/O: first polygon of the list */
+    unsigned int *next_id     /* I/O: next id to be given */
+)
+{
+    for ( ; polygon != NULL; polygon = polygon->next)
+    {
+        polygon->id = (*next_id)++;
+        number_polygons (polygon->child, next_id);
+    }
+}
+
+
+/******************************************************************************
+MODULE:  nest_land_mass_rings
+
+PURPOSE: Builds the tree of polygons from the rings, making each ring a
+child of the smallest ring containing it.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-------      -----------
+ERROR        Error allocating memory for the nesting
+SUCCESS      Successful completion
+
+NOTES:
+1. The rings need to be segmented already, since the segments speed up the
+   containment tests.
+2. The children of each polygon, and the top level polygons, keep the order
+   the rings were read in.
+******************************************************************************/
+int nest_land_mass_rings
+(
+    Lm_rings_t *rings,                /* I/O: rings to be nested; the rings
+                                            are owned by the tree after a
+                                            successful return */
+    IAS_POLYGON_LINKED_LIST **head,   /* O: first of the top level
+                                            polygons */
+    unsigned int *nparents            /* O: number of top level polygons */
+)
+{
+    char FUNC_NAME[] = "nest_land_mass_rings";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    int n = rings->nrings;    /* number of rings */
+    int *order = NULL;        /* rings from the smallest area */
+    int *fill = NULL;         /* next entry to fill of each cell */
+    double *area = NULL;      /* area of each ring */
+    double max_x, max_y;      /* largest x and y of the grid */
+    int x0, x1, y0, y1;       /* cells overlapped by a ring */
+    int cx, cy;               /* looping variables for the cells */
+    int i, k;                 /* looping variables for the rings */
+    int status = SUCCESS;     /* return status */
+    unsigned int next_id = 1; /* next polygon id */
+    IAS_POLYGON_LINKED_LIST *ring = NULL;   /* current ring */
+    IAS_POLYGON_LINKED_LIST *tail = NULL;   /* last top level polygon */
+    IAS_POLYGON_LINKED_LIST **child_tail = NULL;  /* last child of each
+                                 ring */
+    Lm_nest_t nest;           /* nesting of the rings */
+
+    *head = NULL;
+    *nparents = 0;
+    memset (&nest, 0, sizeof (nest));
+    nest.rings = rings;
+    order = malloc (n * sizeof (int));
+    area = malloc (n * sizeof (double));
+    nest.rank = malloc (n * sizeof (int));
+    nest.parent = malloc (n * sizeof (int));
+    nest.cell_start = calloc (LM_NEST_GRID * LM_NEST_GRID + 1, sizeof (int));
+    fill = calloc (LM_NEST_GRID * LM_NEST_GRID, sizeof (int));
+    child_tail = calloc (n, sizeof (IAS_POLYGON_LINKED_LIST *));
+    if (order == NULL || area == NULL || nest.rank == NULL ||
+        nest.parent == NULL || nest.cell_start == NULL || fill == NULL ||
+        child_tail == NULL)
+    {
+        sprintf (errmsg, "Allocating memory to nest the rings");
+        error_handler (true, FUNC_NAME, errmsg);
+        status = ERROR;
+        goto cleanup;
+    }
+
+    /* Rank the rings by area */
+    for (i = 0; i < n; i++)
+    {
+        order[i] = i;
+        area[i] = ring_area (rings->rings[i]);
+    }
+    sort_areas = area;
+    qsort (order, n, sizeof (int), compare_area);
+    sort_areas = NULL;
+    for (k = 0; k < n; k++)
+        nest.rank[order[k]] = k;
+
+    /* Lay the grid over the bounding boxes of all the rings */
+    nest.min_x = max_x = rings->rings[0]->min_x;
+    nest.min_y = max_y = rings->rings[0]->min_y;
+    for (i = 0; i < n; i++)
+    {
+        nest.min_x = fmin (nest.min_x, rings->rings[i]->min_x);
+        nest.min_y = fmin (nest.min_y, rings->rings[i]->min_y);
+        max_x = fmax (max_x, rings->rings[i]->max_x);
+        max_y = fmax (max_y, rings->rings[i]->max_y);
+    }
+    nest.cell_x = max_x > nest.min_x ? (max_x - nest.min_x) / LM_NEST_GRID
+        : 1.0;
+    nest.cell_y = max_y > nest.min_y ? (max_y - nest.min_y) / LM_NEST_GRID
+        : 1.0;
+
+    /* List the rings overlapping each cell, from the smallest area; the
+       cells are counted, then filled */
+    for (k = 0; k < 2 * n; k++)
+    {
+        i = order[k % n];
+        ring = rings->rings[i];
+        x0 = (int) ((ring->min_x - nest.min_x) / nest.cell_x);
+        x1 = (int) ((ring->max_x - nest.min_x) / nest.cell_x);
+        y0 = (int) ((ring->min_y - nest.min_y) / nest.cell_y);
+        y1 = (int) ((ring->max_y - nest.min_y) / nest.cell_y);
+        x1 = x1 < LM_NEST_GRID ? x1 : LM_NEST_GRID - 1;
+        y1 = y1 < LM_NEST_GRID ? y1 : LM_NEST_GRID - 1;
+        for (cy = y0; cy <= y1; cy++)
+            for (cx = x0; cx <= x1; cx++)
+            {
+                if (k < n)
+                    nest.cell_start[cy * LM_NEST_GRID + cx + 1]++;
+                else
+                    nest.cell_rings[fill[cy * LM_NEST_GRID + cx]++] = i;
+            }
+
+        if (k == n - 1)
+        {
+            for (cx = 0; cx < LM_NEST_GRID * LM_NEST_GRID; cx++)
+            {
+                nest.cell_start[cx + 1] += nest.cell_start[cx];
+                fill[cx] = nest.cell_start[cx];
+            }
+            nest.cell_rings = malloc ((size_t) nest.cell_start[
+                LM_NEST_GRID * LM_NEST_GRID] * sizeof (int));
+            if (nest.cell_rings == NULL)
+            {
+                sprintf (errmsg, "Allocating memory for the grid of the "
+                    "rings");
+                error_handler (true, FUNC_NAME, errmsg);
+                status = ERROR;
+                goto cleanup;
+            }
+        }
+    }
+
+    /* Find the parent of each ring */
+    if (espa_parallel_for (n, 0, find_parent, &nest) != SUCCESS)
+    {
+        sprintf (errmsg, "Finding the parents of the rings");
+        error_handler (true, FUNC_NAME, errmsg);
+        status = ERROR;
+        goto cleanup;
+    }
+
+    /* Link the tree, keeping the order the rings were read in */
+    for (i = 0; i < n; i++)
+    {
+        ring = rings->rings[i];
+        k = nest.parent[i];
+        if (k < 0)
+        {
+            ring->prev = tail;
+            if (tail != NULL)
+                tail->next = ring;
+            else
+                *head = ring;
+            tail = ring;
+            (*nparents)++;
+        }
+        else
+        {
+            ring->prev = child_tail[k];
+            if (child_tail[k] != NULL)
+                child_tail[k]->next = ring;
+            else
+                rings->rings[k]->child = ring;
+            child_tail[k] = ring;
+        }
+    }
+    number_polygons (*head, &next_id);
+    rings->nrings = 0;
+
+cleanup:
+    free (order);
+    free (area);
+    free (fill);
+    free (child_tail);
+    free (nest.rank);
+    free (nest.parent);
+    free (nest.cell_start);
+    free (nest.cell_rings);
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  free_land_mass_rings
+
+PURPOSE: Frees the rings read from the shapefiles which aren't in a tree.
+
+RETURN VALUE:
+Type = None
+******************************************************************************/
+void free_land_mass_rings
+(
+    Lm_rings_t *rings                 /* I/O: rings to be freed */
+)
+{
+    int i;                    /* looping variable for the rings */
+
+    for (i = 0; i < rings->nrings; i++)
+        ias_geo_free_polygon_linked_list (rings->rings[i]);
+    free (rings->rings);
+    memset (rings, 0, sizeof (*rings));
+}
+
+
+/******************************************************************************
+MODULE:  compile_land_mass_polygon
+
+PURPOSE: Compiles the land-mass polygon file from the shapefiles.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-------      -----------
+ERROR        Error reading the shapefiles or writing the polygon file
+SUCCESS      Successful completion
+
+NOTES:
+1. The spatial index and the levels of detail are written after the
+   polygons by ias_geo_dump_polygon.
+******************************************************************************/
+int compile_land_mass_polygon
+(
+    char **shp_files,                 /* I: names of the .shp files */
+    int nfiles,                       /* I: number of .shp files */
+    int target_sides,                 /* I: sides a segment grows to */
+    int max_sides,                    /* I: most sides in a segment */
+    const char *polygon_file          /* I: name of the polygon file to be
+                                            written */
+)
+{
+    char FUNC_NAME[] = "compile_land_mass_polygon";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    int npolygons;            /* number of polygons */
+    unsigned int nparents;    /* number of top level polygons */
+    int status = SUCCESS;     /* return status */
+    int i;                    /* looping variable for the shapefiles */
+    Lm_rings_t rings;         /* rings read from the shapefiles */
+    Lm_segment_all_t all;     /* segmenting of the rings */
+    IAS_POLYGON_LINKED_LIST *head = NULL;  /* first top level polygon */
+    FILE *fp = NULL;          /* polygon file */
+
+    if (target_sides < 1 || max_sides < target_sides)
+    {
+        sprintf (errmsg, "The target sides per segment (%d) must be at least "
+            "1 and no more than the most sides (%d)", target_sides,
+            max_sides);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Read the rings of all the shapefiles */
+    memset (&rings, 0, sizeof (rings));
+    for (i = 0; i < nfiles; i++)
+    {
+        if (read_land_mass_shapefile (shp_files[i], &rings) != SUCCESS)
+        {  /* Error messages already written */
+            free_land_mass_rings (&rings);
+            return (ERROR);
+        }
+    }
+    if (rings.nrings == 0)
+    {
+        sprintf (errmsg, "No polygons were read from the shapefiles");
+        error_handler (true, FUNC_NAME, errmsg);
+        free_land_mass_rings (&rings);
+        return (ERROR);
+    }
+    npolygons = rings.nrings;
+    printf ("Read %d rings from %d shapefiles\n", npolygons, nfiles);
+
+    /* Segment the rings, then nest them */
+    all.rings = &rings;
+    all.target_sides = target_sides;
+    all.max_sides = max_sides;
+    if (espa_parallel_for (npolygons, 0, segment_ring, &all) != SUCCESS ||
+        nest_land_mass_rings (&rings, &head, &nparents) != SUCCESS)
+    {
+        sprintf (errmsg, "Segmenting and nesting the rings");
+        error_handler (true, FUNC_NAME, errmsg);
+        free_land_mass_rings (&rings);
+        return (ERROR);
+    }
+    free_land_mass_rings (&rings);
+    printf ("Nested the rings under %u top level polygons\n", nparents);
+
+    /* Write the polygons, their index, and their levels of detail */
+    fp = fopen (polygon_file, "wb");
+    if (fp == NULL)
+    {
+        sprintf (errmsg, "Opening %s for write access", polygon_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        ias_geo_free_polygon_linked_list (head);
+        return (ERROR);
+    }
+    if (ias_geo_dump_polygon (fp, head, npolygons, nparents) != SUCCESS)
+    {
+        sprintf (errmsg, "Writing the polygon file %s", polygon_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        status = ERROR;
+    }
+    if (fclose (fp) != 0 && status == SUCCESS)
+    {
+        sprintf (errmsg, "Closing the polygon file %s", polygon_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        status = ERROR;
+    }
+
+    ias_geo_free_polygon_linked_list (head);
+    return (status);
+}
@@ -0,0 +1,93 @@
+/*****************************************************************************
+FILE: land_mass_polygon.h
+
+PURPOSE: Contains defines, structures, and prototypes for compiling the
+land-mass polygon file from source shapefiles.  The rings of the shapefiles
+are split into polygon segments tuned for the culling of the point in
+polygon tests, nested by containment, and written with ias_geo_dump_polygon
+along with its spatial index and levels of detail.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. Only the Polygon, PolygonZ, and PolygonM shapes of the ESRI shapefiles
+     are read; the z and m values are ignored.  The x and y values are taken
+     as longitude and latitude in degrees.
+  2. Every ring of every shape is a polygon of the file, whether it's an
+     outer ring or a hole.  Each ring becomes a child of the smallest ring
+     containing it, so land, lakes, islands in lakes, and so on alternate
+     down the tree the way ias_geo_point_in_shape expects, no matter how the
+     rings are split among the shapefiles or oriented.
+  3. Each segment holds a run of sides whose x only increases or only
+     decreases, or several such runs until the segment reaches the target
+     number of sides.  Runs longer than the largest number of sides are cut
+     into pieces of equal length.
+*****************************************************************************/
+
+#ifndef LAND_MASS_POLYGON_H
+#define LAND_MASS_POLYGON_H
+
+#include <stdio.h>
+#include "error_handler.h"
+#include "ias_structures.h"
+
+/* Defines */
+#define LM_SEGMENT_TARGET_SIDES 64   /* default sides per segment; 1 KB of
+                                        vertices */
+#define LM_SEGMENT_MAX_SIDES 256     /* default most sides per segment; 4 KB
+                                        of vertices, a page */
+
+/* Rings read from the shapefiles */
+typedef struct
+{
+    int nrings;                       /* number of rings */
+    int max_rings;                    /* number of rings allocated */
+    IAS_POLYGON_LINKED_LIST **rings;  /* each ring, unlinked, with the
+                                         closing copy of its first vertex */
+} Lm_rings_t;
+
+/* Prototypes */
+int read_land_mass_shapefile
+(
+    const char *shp_file,             /* I: name of the .shp file */
+    Lm_rings_t *rings                 /* I/O: rings read so far; the rings
+                                            of the file are appended */
+);
+
+int segment_land_mass_polygon
+(
+    IAS_POLYGON_LINKED_LIST *polygon, /* I/O: polygon whose segments are
+                                            replaced */
+    int target_sides,                 /* I: sides a segment grows to */
+    int max_sides                     /* I: most sides in a segment */
+);
+
+int nest_land_mass_rings
+(
+    Lm_rings_t *rings,                /* I/O: rings to be nested; the rings
+                                            are owned by the tree after a
+                                            successful return */
+    IAS_POLYGON_LINKED_LIST **head,   /* O: first of the top level
+                                            polygons */
+    unsigned int *nparents            /* O: number of top level polygons */
+);
+
+int compile_land_mass_polygon
+(
+    char **shp_files,                 /* I: names of the .shp files */
+    int nfiles,                       /* I: number of .shp files */
+    int target_sides,                 /* I: sides a segment grows to */
+    int max_sides,                    /* I: most sides in a segment */
+    const char *polygon_file          /* I: name of the polygon file to be
+                                            written */
+);
+
+void free_land_mass_rings
+(
+    Lm_rings_t *rings                 /* I/O: rings to be freed */
+);
+
+#endif
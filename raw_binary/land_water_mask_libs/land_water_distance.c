@@ -0,0 +1,503 @@
+/*****************************************************************************
+FILE: land_water_distance.c
+
+PURPOSE: Contains functions for computing the distance to the coast of each
+pixel of a scene from its land/water mask, and writing it as a band.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The distances are found with the exact Euclidean distance transform of
+     Felzenszwalb and Huttenlocher, which is separable and linear in the
+     number of pixels.  The first pass finds, down each column, the number
+     of lines to the nearest pixel of the other class.  The second pass
+     finds, along each line, the lower envelope of the parabolas rooted at
+     those column distances, which gives the squared distance to the nearest
+     pixel of the other class anywhere in the scene.
+  2. Both passes run on the task pool, the first over strips of columns (so
+     each worker reads whole cache lines of the mask and of the column
+     distances) and the second over the lines.
+  3. Pixels which aren't square are handled by scaling the column distances
+     by the ratio of the pixel sizes before the line pass.
+*****************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "land_water_distance.h"
+#include "generate_land_water_mask.h"
+#include "espa_task_pool.h"
+#include "espa_trace.h"
+
+/* Number of columns in each iteration of the column pass */
+#define LW_DISTANCE_STRIP 64
+
+/* Column distance of a pixel with no pixel of the other class in its
+   column */
+#define LW_NO_COAST INT32_MAX
+
+/* Class (1 for land) of a pixel of the bit-packed mask */
+#define LW_MASK_BIT(mask, line_bytes, line, samp) \
+    (((mask)[(size_t) (line) * (line_bytes) + (samp) / 8] >> \
+      (7 - (samp) % 8)) & 1)
+
+/* Distance transform shared by the iterations of both passes */
+typedef struct
+{
+    const unsigned char *mask;  /* bit-packed land/water mask */
+    size_t line_bytes;          /* number of bytes in a packed line */
+    int nlines;                 /* number of lines in the mask */
+    int nsamps;                 /* number of samples in the mask */
+    double pixel_size_x;        /* pixel size in x, in meters */
+    double ratio;               /* pixel size in y over the size in x */
+    int32_t *column_dist;       /* lines to the nearest pixel of the other
+                                   class in the column of each pixel */
+    int16_t *distance;          /* distance to the coast of each pixel */
+    int *envelope;              /* samples rooting the parabolas of the
+                                   lower envelope; nsamps for each worker */
+    double *bounds;             /* left bound of each parabola of the lower
+                                   envelope; nsamps for each worker */
+    double *sqdist;             /* squared column distances and squared
+                                   distances of a line; 2 * nsamps for each
+                                   worker */
+} Lw_distance_t;
+
+
+/******************************************************************************
+MODULE:  distance_columns
+
+PURPOSE: Finds the column distances of a strip of columns (an iteration of
+the column pass).
+
+RETURN VALUE:
+Type = int
+Value        Description
+-------      -----------
+SUCCESS      Always
+
+NOTES:
+1. The lines are scanned down and then up, keeping the last line of each
+   class seen in each column.
+******************************************************************************/
+static int distance_columns
+(
+    void *arg,                  /* I/O: distance transform being run */
+    int index,                  /* I: index of the strip of columns */
+    int worker                  /* I: index of the worker (unused) */
+)
+{
+    Lw_distance_t *dt = arg;    /* distance transform being run */
+    int samp0 = index * LW_DISTANCE_STRIP;  /* first column of the strip */
+    int ncols;                  /* number of columns in the strip */
+    int last[2][LW_DISTANCE_STRIP];  /* last line of water and of land seen
+                                   in each column; -1 if none */
+    int32_t *row = NULL;        /* column distances of the strip in the
+                                   current line */
+    int land;                   /* class of the current pixel */
+    int line, k;                /* looping variables */
+
+    ncols = dt->nsamps - samp0;
+    if (ncols > LW_DISTANCE_STRIP)
+        ncols = LW_DISTANCE_STRIP;
+
+    /* Nearest pixel of the other class above */
+    for (k = 0; k < ncols; k++)
+        last[0][k] = last[1][k] = -1;
+    for (line = 0; line < dt->nlines; line++)
+    {
+        row = &dt->column_dist[(size_t) line * dt->nsamps + samp0];
+        for (k = 0; k < ncols; k++)
+        {
+            land = LW_MASK_BIT (dt->mask, dt->line_bytes, line, samp0 + k);
+            last[land][k] = line;
+            row[k] = last[!land][k] < 0 ? LW_NO_COAST : line - last[!land][k];
+        }
+    }
+
+    /* Nearest pixel of the other class below, if it's nearer */
+    for (k = 0; k < ncols; k++)
+        last[0][k] = last[1][k] = -1;
+    for (line = dt->nlines - 1; line >= 0; line--)
+    {
+        row = &dt->column_dist[(size_t) line * dt->nsamps + samp0];
+        for (k = 0; k < ncols; k++)
+        {
+            land = LW_MASK_BIT (dt->mask, dt->line_bytes, line, samp0 + k);
+            last[land][k] = line;
+            if (last[!land][k] >= 0 && last[!land][k] - line < row[k])
+                row[k] = last[!land][k] - line;
+        }
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  lower_envelope
+
+PURPOSE: Finds the squared distance of each sample of a line to the lower
+envelope of the parabolas rooted at the squared column distances.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+1. Samples with a negative squared column distance have no pixel of the
+   other class in their column, and root no parabola.  The squared distances
+   are all negative if no sample roots a parabola.
+******************************************************************************/
+static void lower_envelope
+(
+    int nsamps,                 /* I: number of samples in the line */
+    const double *f,            /* I: squared column distance of each
+                                      sample, in x pixels */
+    int *v,                     /* I/O: scratch for the samples rooting the
+                                        parabolas of the envelope */
+    double *z,                  /* I/O: scratch for the left bounds of the
+                                        parabolas of the envelope */
+    double *d                   /* O: squared distance of each sample, in x
+                                      pixels */
+)
+{
+    int k = -1;                 /* last parabola of the envelope */
+    int q, p;                   /* looping variables for the samples */
+    double s;                   /* intersection with the last parabola */
+
+    for (q = 0; q < nsamps; q++)
+    {
+        if (f[q] < 0.0)
+            continue;
+
+        /* Drop the parabolas hidden by the one rooted at q */
+        s = -HUGE_VAL;
+        while (k >= 0)
+        {
+            s = ((f[q] + (double) q * q) - (f[v[k]] + (double) v[k] * v[k]))
+                / (2.0 * (q - v[k]));
+            if (s > z[k])
+                break;
+            k--;
+        }
+        if (k < 0)
+            s = -HUGE_VAL;
+        v[++k] = q;
+        z[k] = s;
+    }
+
+    if (k < 0)
+    {
+        for (p = 0; p < nsamps; p++)
+            d[p] = -1.0;
+        return;
+    }
+
+    /* Evaluate the envelope, moving right through its parabolas */
+    for (q = 0, p = 0; p < nsamps; p++)
+    {
+        while (q < k && z[q+1] < p)
+            q++;
+        d[p] = (double) (p - v[q]) * (p - v[q]) + f[v[q]];
+    }
+}
+
+
+/******************************************************************************
+MODULE:  distance_line
+
+PURPOSE: Finds the distances to the coast of a line (an iteration of the
+line pass).
+
+RETURN VALUE:
+Type = int
+Value        Description
+-------      -----------
+SUCCESS      Always
+
+NOTES:
+1. The lower envelope is found twice: to the water for the land pixels, and
+   to the land for the water pixels.
+******************************************************************************/
+static int distance_line
+(
+    void *arg,                  /* I/O: distance transform being run */
+    int line,                   /* I: line of the mask */
+    int worker                  /* I: index of the worker */
+)
+{
+    Lw_distance_t *dt = arg;    /* distance transform being run */
+    size_t offset = (size_t) line * dt->nsamps;  /* first pixel of the
+                                   line */
+    int *v = &dt->envelope[(size_t) worker * dt->nsamps];  /* envelope
+                                   scratch of the worker */
+    double *z = &dt->bounds[(size_t) worker * dt->nsamps];  /* bounds
+                                   scratch of the worker */
+    double *f = &dt->sqdist[(size_t) worker * 2 * dt->nsamps];  /* squared
+                                   column distances of the line */
+    double *d = f + dt->nsamps; /* squared distances of the line */
+    double meters;              /* distance of a pixel, in meters */
+    int32_t g;                  /* column distance of a pixel */
+    int target;                 /* class the distances are measured to */
+    int land;                   /* class of the current pixel */
+    int samp;                   /* looping variable for the samples */
+
+    for (target = 0; target <= 1; target++)
+    {
+        for (samp = 0; samp < dt->nsamps; samp++)
+        {
+            land = LW_MASK_BIT (dt->mask, dt->line_bytes, line, samp);
+            g = dt->column_dist[offset + samp];
+            if (land == target)
+                f[samp] = 0.0;
+            else if (g == LW_NO_COAST)
+                f[samp] = -1.0;
+            else
+                f[samp] = (dt->ratio * g) * (dt->ratio * g);
+        }
+        lower_envelope (dt->nsamps, f, v, z, d);
+
+        for (samp = 0; samp < dt->nsamps; samp++)
+        {
+            land = LW_MASK_BIT (dt->mask, dt->line_bytes, line, samp);
+            if (land == target)
+                continue;
+            meters = d[samp] < 0.0 ? LW_DISTANCE_MAX :
+                fmin (dt->pixel_size_x * sqrt (d[samp]), LW_DISTANCE_MAX);
+            dt->distance[offset + samp] = (int16_t) lround (land ? meters :
+                -meters);
+        }
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  compute_coast_distance
+
+PURPOSE: Computes the distance to the coast of each pixel from the
+land/water mask.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-------      -----------
+ERROR        Error allocating memory for the distance transform
+SUCCESS      Successful completion
+
+NOTES:
+1. The column distances take 4 bytes per pixel while the transform runs.
+******************************************************************************/
+int compute_coast_distance
+(
+    const unsigned char *land_water_mask, /* I: bit-packed land/water mask;
+                                                1 is land */
+    int nlines,                       /* I: number of lines in the mask */
+    int nsamps,                       /* I: number of samples in the mask */
+    double pixel_size_x,              /* I: pixel size in x, in meters */
+    double pixel_size_y,              /* I: pixel size in y, in meters */
+    int16_t *distance                 /* O: distance to the coast of each
+                                            pixel, in meters */
+)
+{
+    char FUNC_NAME[] = "compute_coast_distance";  /* function name */
+    char errmsg[STR_SIZE];       /* error message */
+    int nstrips;                 /* number of strips of columns */
+    int nworkers;                /* number of workers of the line pass */
+    int status = SUCCESS;        /* return status */
+    Lw_distance_t dt;            /* distance transform */
+    ESPA_TRACE_SCOPE (trace, "coast_distance", NULL);  /* timing */
+
+    memset (&dt, 0, sizeof (dt));
+    dt.mask = land_water_mask;
+    dt.line_bytes = RB_BITPACKED_LINE_BYTES (nsamps);
+    dt.nlines = nlines;
+    dt.nsamps = nsamps;
+    dt.pixel_size_x = pixel_size_x;
+    dt.ratio = pixel_size_y / pixel_size_x;
+    dt.distance = distance;
+
+    nstrips = (nsamps + LW_DISTANCE_STRIP - 1) / LW_DISTANCE_STRIP;
+    nworkers = espa_parallel_for_workers (nlines, 0);
+    dt.column_dist = malloc ((size_t) nlines * nsamps * sizeof (int32_t));
+    dt.envelope = malloc ((size_t) nworkers * nsamps * sizeof (int));
+    dt.bounds = malloc ((size_t) nworkers * nsamps * sizeof (double));
+    dt.sqdist = malloc ((size_t) nworkers * 2 * nsamps * sizeof (double));
+    if (dt.column_dist == NULL || dt.envelope == NULL || dt.bounds == NULL
+        || dt.sqdist == NULL)
+    {
+        sprintf (errmsg, "Allocating memory for the distance transform");
+        error_handler (true, FUNC_NAME, errmsg);
+        status = ERROR;
+    }
+
+    if (status == SUCCESS && (espa_parallel_for (nstrips, 0,
+        distance_columns, &dt) != SUCCESS || espa_parallel_for (nlines,
+        nworkers, distance_line, &dt) != SUCCESS))
+    {
+        sprintf (errmsg, "Computing the distance to the coast");
+        error_handler (true, FUNC_NAME, errmsg);
+        status = ERROR;
+    }
+
+    free (dt.column_dist);
+    free (dt.envelope);
+    free (dt.bounds);
+    free (dt.sqdist);
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  write_coast_distance
+
+PURPOSE: Computes the distance to the coast of the scene from its land/water
+mask, writes it to its raw binary file along with the ENVI header, and sets
+up its band metadata.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-------      -----------
+ERROR        Error computing or writing the distance to the coast
+SUCCESS      Successful completion
+
+NOTES:
+1. The distance filename is the same as band 1 with the _B1.img replaced
+   with _coast_distance.img.
+2. The pixel sizes of a geographic scene are converted to meters at the
+   latitude of the center of the scene, so the distances are only
+   approximate away from it.
+******************************************************************************/
+int write_coast_distance
+(
+    Espa_internal_meta_t *xml_meta,   /* I: input XML metadata */
+    const Espa_band_meta_t *bmeta,    /* I: band 1, the representative band */
+    const char *production_date,      /* I: production date of the band */
+    const unsigned char *land_water_mask, /* I: bit-packed land/water mask of
+                                                the scene */
+    Espa_band_meta_t *out_bmeta       /* O: band metadata of the distance to
+                                            the coast */
+)
+{
+    char FUNC_NAME[] = "write_coast_distance";  /* function name */
+    char errmsg[STR_SIZE];       /* error message */
+    char tmpstr[STR_SIZE];       /* temporary filename */
+    char *cptr = NULL;           /* points to the '_' in the filename */
+    double pixel_size_x = bmeta->pixel_size[0];  /* pixel size in x */
+    double pixel_size_y = bmeta->pixel_size[1];  /* pixel size in y */
+    double center_lat;           /* latitude of the center of the scene */
+    int16_t *distance = NULL;    /* distance to the coast of each pixel */
+    FILE *fptr = NULL;           /* file pointer */
+    Envi_header_t envi_hdr;      /* output ENVI header information */
+
+    /* Convert the pixel sizes of a geographic scene to meters */
+    if (!strcmp (bmeta->pixel_units, "degrees"))
+    {
+        center_lat = 0.5 * (xml_meta->global.proj_info.ul_corner[1] +
+            xml_meta->global.proj_info.lr_corner[1]);
+        pixel_size_x *= LW_MASK_METERS_PER_DEGREE * cos (center_lat * M_PI /
+            180.0);
+        pixel_size_y *= LW_MASK_METERS_PER_DEGREE;
+    }
+
+    /* Compute the distance to the coast */
+    distance = malloc ((size_t) bmeta->nlines * bmeta->nsamps *
+        sizeof (int16_t));
+    if (distance == NULL)
+    {
+        sprintf (errmsg, "Allocating memory for the distance to the coast");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    if (compute_coast_distance (land_water_mask, bmeta->nlines,
+        bmeta->nsamps, pixel_size_x, pixel_size_y, distance) != SUCCESS)
+    {  /* Error messages already written */
+        free (distance);
+        return (ERROR);
+    }
+
+    /* Set up the band metadata for the distance to the coast */
+    strcpy (out_bmeta->product, "intermediate_data");
+    strcpy (out_bmeta->source, "level1");
+    strcpy (out_bmeta->name, "coast_distance");
+    strcpy (out_bmeta->category, "qa");
+    out_bmeta->data_type = ESPA_INT16;
+    out_bmeta->nlines = bmeta->nlines;
+    out_bmeta->nsamps = bmeta->nsamps;
+    strncpy (tmpstr, bmeta->short_name, 4);
+    tmpstr[4] = '\0';
+    sprintf (out_bmeta->short_name, "%sCDIST", tmpstr);
+    strcpy (out_bmeta->long_name, "distance to the coast, positive over land "
+        "and negative over water");
+    out_bmeta->pixel_size[0] = bmeta->pixel_size[0];
+    out_bmeta->pixel_size[1] = bmeta->pixel_size[1];
+    strcpy (out_bmeta->pixel_units, bmeta->pixel_units);
+    strcpy (out_bmeta->data_units, "meters");
+    out_bmeta->valid_range[0] = -LW_DISTANCE_MAX;
+    out_bmeta->valid_range[1] = LW_DISTANCE_MAX;
+    sprintf (out_bmeta->app_version, "create_land_water_mask_%s",
+        ESPA_COMMON_VERSION);
+    strcpy (out_bmeta->production_date, production_date);
+
+    /* Use the band1 filename to create the distance filename */
+    strcpy (out_bmeta->file_name, bmeta->file_name);
+    cptr = strrchr (out_bmeta->file_name, '_');
+    if (!cptr)
+    {
+        sprintf (errmsg, "Unable to find the _ in the band 1 filename for "
+            "creating the distance to the coast filename.");
+        error_handler (true, FUNC_NAME, errmsg);
+        free (distance);
+        return (ERROR);
+    }
+    sprintf (cptr, "_coast_distance.img");
+
+    /* Write the distance to the coast file */
+    fptr = open_raw_binary (out_bmeta->file_name, "wb");
+    if (!fptr)
+    {
+        sprintf (errmsg, "Unable to open the distance to the coast file");
+        error_handler (true, FUNC_NAME, errmsg);
+        free (distance);
+        return (ERROR);
+    }
+
+    if (write_raw_binary (fptr, out_bmeta->nlines, out_bmeta->nsamps,
+        sizeof (int16_t), distance) != SUCCESS)
+    {
+        sprintf (errmsg, "Unable to write to the distance to the coast file");
+        error_handler (true, FUNC_NAME, errmsg);
+        close_raw_binary (fptr);
+        free (distance);
+        return (ERROR);
+    }
+
+    /* Close the file and free the distances */
+    close_raw_binary (fptr);
+    free (distance);
+
+    /* Create the ENVI header for the distance to the coast */
+    if (create_envi_struct (out_bmeta, &xml_meta->global, &envi_hdr) !=
+        SUCCESS)
+    {
+        sprintf (errmsg, "Error creating the ENVI header file.");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Write the ENVI header */
+    sprintf (tmpstr, "%s", out_bmeta->file_name);
+    sprintf (&tmpstr[strlen(tmpstr)-3], "hdr");
+    if (write_envi_hdr (tmpstr, &envi_hdr) != SUCCESS)
+    {
+        sprintf (errmsg, "Writing the ENVI header file: %s.", tmpstr);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
@@ -0,0 +1,57 @@
+/*****************************************************************************
+FILE: land_water_distance.h
+
+PURPOSE: Contains defines and prototypes for the distance to the coast band,
+which is computed from the land/water mask of the scene with an exact
+Euclidean distance transform rather than querying the land-mass polygon for
+each pixel.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The distance of a pixel is from its center to the center of the
+     nearest pixel of the other class, in meters.  It is positive over land
+     and negative over water, so an adjacent land and water pixel are one
+     pixel size apart.
+  2. The distances are saturated at +/-LW_DISTANCE_MAX meters, which is also
+     the distance of every pixel of a scene with no coast.
+*****************************************************************************/
+
+#ifndef LAND_WATER_DISTANCE_H
+#define LAND_WATER_DISTANCE_H
+
+#include <stdint.h>
+#include "error_handler.h"
+#include "espa_metadata.h"
+
+/* Defines */
+#define LW_DISTANCE_MAX 32767   /* largest distance written, in meters */
+
+/* Prototypes */
+int compute_coast_distance
+(
+    const unsigned char *land_water_mask, /* I: bit-packed land/water mask;
+                                                1 is land */
+    int nlines,                       /* I: number of lines in the mask */
+    int nsamps,                       /* I: number of samples in the mask */
+    double pixel_size_x,              /* I: pixel size in x, in meters */
+    double pixel_size_y,              /* I: pixel size in y, in meters */
+    int16_t *distance                 /* O: distance to the coast of each
+                                            pixel, in meters */
+);
+
+int write_coast_distance
+(
+    Espa_internal_meta_t *xml_meta,   /* I: input XML metadata */
+    const Espa_band_meta_t *bmeta,    /* I: band 1, the representative band */
+    const char *production_date,      /* I: production date of the band */
+    const unsigned char *land_water_mask, /* I: bit-packed land/water mask of
+                                                the scene */
+    Espa_band_meta_t *out_bmeta       /* O: band metadata of the distance to
+                                            the coast */
+);
+
+#endif
@@ -0,0 +1,326 @@
+/*****************************************************************************
+FILE: land_water_mask_cache.c
+
+PURPOSE: Contains functions for looking up and populating the cache of
+finished land/water masks.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. A cached mask is named for the FNV-1a hash of its key, and the key
+     stored in the mask must match in full before the mask is used.
+  2. A mask is written to a temporary file and renamed into place, so
+     concurrent runs never see a partially written mask.
+*****************************************************************************/
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE     /* for st_mtim */
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "land_water_mask_cache.h"
+#include "generate_land_water_mask.h"
+#include "raw_binary_io.h"
+#include "espa_trace.h"
+#include "espa_hash.h"
+
+/* Size of the buffer for a cache key */
+#define LW_MASK_CACHE_KEY_SIZE (3 * STR_SIZE)
+
+
+/******************************************************************************
+MODULE:  init_lw_mask_cache
+
+PURPOSE: Determines if the land/water mask cache has been turned on, and
+identifies the land-mass polygon the cached masks are generated from.
+
+RETURN VALUE:
+Type = bool
+Value           Description
+-----           -----------
+true            The cache is used
+false           LW_MASK_CACHE_ENV is not set, or the polygon file can't be
+                identified
+
+NOTES:
+******************************************************************************/
+bool init_lw_mask_cache
+(
+    const char *polygon_file, /* I: name of the land-mass polygon file */
+    Lw_mask_cache_t *cache    /* O: cache of the land/water masks */
+)
+{
+    char FUNC_NAME[] = "init_lw_mask_cache";  /* function name */
+    char errmsg[STR_SIZE];  /* error message */
+    char *env = getenv (LW_MASK_CACHE_ENV);  /* value of the variable */
+    struct stat statbuf;    /* status of the polygon file */
+    int count;              /* number of chars copied in snprintf */
+
+    if (env == NULL || env[0] == '\0')
+        return (false);
+
+    if (stat (polygon_file, &statbuf) == -1)
+    {
+        sprintf (errmsg, "Unable to stat the land-mass polygon %s, so the "
+            "land/water mask cache is not used", polygon_file);
+        error_handler (false, FUNC_NAME, errmsg);
+        return (false);
+    }
+
+    count = snprintf (cache->dir, sizeof (cache->dir), "%s", env);
+    if (count < 0 || count >= (int) sizeof (cache->dir))
+    {
+        sprintf (errmsg, "The land/water mask cache directory name is too "
+            "long, so the cache is not used");
+        error_handler (false, FUNC_NAME, errmsg);
+        return (false);
+    }
+
+    count = snprintf (cache->polygon_id, sizeof (cache->polygon_id),
+        "%s:%lld:%lld.%09ld", polygon_file, (long long) statbuf.st_size,
+        (long long) statbuf.st_mtim.tv_sec, (long) statbuf.st_mtim.tv_nsec);
+    if (count < 0 || count >= (int) sizeof (cache->polygon_id))
+    {
+        sprintf (errmsg, "The land-mass polygon file name is too long, so "
+            "the land/water mask cache is not used");
+        error_handler (false, FUNC_NAME, errmsg);
+        return (false);
+    }
+
+    return (true);
+}
+
+
+/******************************************************************************
+MODULE:  get_cache_key
+
+PURPOSE: Builds the key of the mask for a scene, along with the name of the
+cached mask.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           The key or the file name did not fit
+SUCCESS         Key and file name were built
+
+NOTES:
+  1. The doubles are written with 17 significant digits, so grids only
+     match when their definitions are identical.
+  2. The interpolation error allowed is part of the key, since masks
+     generated with a different error may differ.
+******************************************************************************/
+static int get_cache_key
+(
+    const Lw_mask_cache_t *cache,      /* I: cache of the land/water masks */
+    const Espa_internal_meta_t *xml_meta, /* I: metadata of the scene */
+    const Espa_band_meta_t *bmeta,     /* I: band 1, the representative
+                                             band */
+    char *key,                         /* O: key of the mask;
+                                             LW_MASK_CACHE_KEY_SIZE chars */
+    char *cache_file                   /* O: name of the cached mask;
+                                             STR_SIZE chars */
+)
+{
+    const Espa_proj_meta_t *proj = &xml_meta->global.proj_info;
+                            /* projection of the scene */
+    uint64_t hash;          /* FNV-1a hash of the key */
+    int count;              /* number of chars copied in snprintf */
+
+    count = snprintf (key, LW_MASK_CACHE_KEY_SIZE,
+        "%s|proj %d datum %d zone %d origin %s|ul %.17g %.17g|"
+        "lr %.17g %.17g|"
+        "ps %.17g %.17g %.17g %.17g %.17g %.17g %.17g %.17g %.17g|"
+        "pixel %.17g %.17g|size %d %d|max error %.17g", cache->polygon_id,
+        proj->proj_type, proj->datum_type, proj->utm_zone, proj->grid_origin,
+        proj->ul_corner[0], proj->ul_corner[1], proj->lr_corner[0],
+        proj->lr_corner[1], proj->longitude_pole,
+        proj->latitude_true_scale, proj->false_easting, proj->false_northing,
+        proj->standard_parallel1, proj->standard_parallel2,
+        proj->central_meridian, proj->origin_latitude, proj->sphere_radius,
+        bmeta->pixel_size[0], bmeta->pixel_size[1], bmeta->nlines,
+        bmeta->nsamps, get_lw_mask_max_error ());
+    if (count < 0 || count >= LW_MASK_CACHE_KEY_SIZE)
+        return (ERROR);
+
+    hash = espa_hash_fnv1a (key, count, ESPA_FNV1A_BASIS);
+
+    count = snprintf (cache_file, STR_SIZE, "%s/lw_mask_%016llx.bit",
+        cache->dir, (unsigned long long) hash);
+    if (count < 0 || count >= STR_SIZE)
+        return (ERROR);
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  read_lw_mask_cache
+
+PURPOSE: Loads the bit-packed land/water mask of the scene from the cache, if
+it has been cached.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           No usable mask; the mask needs to be generated
+SUCCESS         Mask was loaded from the cache
+
+NOTES:
+  1. No error messages are written when the mask is missing or doesn't
+     match, since the caller falls back to generating the mask.
+  2. The mask holds RB_BITPACKED_LINE_BYTES(nsamps) bytes per line.  It is up
+     to the calling routine to free it.
+******************************************************************************/
+int read_lw_mask_cache
+(
+    const Lw_mask_cache_t *cache,      /* I: cache of the land/water masks */
+    const Espa_internal_meta_t *xml_meta, /* I: metadata of the scene */
+    const Espa_band_meta_t *bmeta,     /* I: band 1, the representative
+                                             band */
+    unsigned char **land_water_mask    /* O: bit-packed mask; memory is
+                                             allocated */
+)
+{
+    char key[LW_MASK_CACHE_KEY_SIZE];  /* key of the mask */
+    char cached_key[LW_MASK_CACHE_KEY_SIZE];  /* key stored in the mask */
+    char cache_file[STR_SIZE];  /* name of the cached mask */
+    size_t key_size;        /* number of chars in the key */
+    size_t mask_size;       /* number of bytes in the mask */
+    Lw_mask_cache_header_t header;  /* header of the cached mask */
+    struct stat statbuf;    /* status of the cached mask */
+    FILE *fptr = NULL;      /* cached mask file */
+    unsigned char *mask = NULL;  /* mask read from the cache */
+    ESPA_TRACE_SCOPE (trace, "mask_cache_read", NULL);  /* timing */
+
+    *land_water_mask = NULL;
+    if (get_cache_key (cache, xml_meta, bmeta, key, cache_file) != SUCCESS)
+        return (ERROR);
+    key_size = strlen (key);
+    mask_size = bmeta->nlines * RB_BITPACKED_LINE_BYTES (bmeta->nsamps);
+
+    /* Make sure the cached mask is complete before reading it */
+    if (stat (cache_file, &statbuf) == -1 || (size_t) statbuf.st_size !=
+        sizeof (header) + key_size + mask_size)
+        return (ERROR);
+
+    fptr = fopen (cache_file, "rb");
+    if (fptr == NULL)
+        return (ERROR);
+
+    /* Make sure the mask was cached for this grid, not just one with the
+       same hash */
+    if (fread (&header, sizeof (header), 1, fptr) != 1 ||
+        memcmp (header.magic, LW_MASK_CACHE_MAGIC, sizeof (header.magic)) ||
+        header.version != LW_MASK_CACHE_VERSION ||
+        header.key_size != key_size ||
+        header.nlines != (uint32_t) bmeta->nlines ||
+        header.nsamps != (uint32_t) bmeta->nsamps ||
+        fread (cached_key, 1, key_size, fptr) != key_size ||
+        memcmp (cached_key, key, key_size))
+    {
+        fclose (fptr);
+        return (ERROR);
+    }
+
+    mask = malloc (mask_size + 1);
+    if (mask == NULL || fread (mask, 1, mask_size, fptr) != mask_size)
+    {
+        free (mask);
+        fclose (fptr);
+        return (ERROR);
+    }
+    fclose (fptr);
+
+    *land_water_mask = mask;
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  write_lw_mask_cache
+
+PURPOSE: Adds the bit-packed land/water mask of the scene to the cache.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the cached mask
+SUCCESS         Mask was cached
+
+NOTES:
+  1. The mask holds RB_BITPACKED_LINE_BYTES(nsamps) bytes per line.
+******************************************************************************/
+int write_lw_mask_cache
+(
+    const Lw_mask_cache_t *cache,      /* I: cache of the land/water masks */
+    const Espa_internal_meta_t *xml_meta, /* I: metadata of the scene */
+    const Espa_band_meta_t *bmeta,     /* I: band 1, the representative
+                                             band */
+    const unsigned char *land_water_mask /* I: bit-packed mask */
+)
+{
+    char FUNC_NAME[] = "write_lw_mask_cache";  /* function name */
+    char errmsg[STR_SIZE];  /* error message */
+    char key[LW_MASK_CACHE_KEY_SIZE];  /* key of the mask */
+    char cache_file[STR_SIZE];  /* name of the cached mask */
+    char tmp_file[STR_SIZE + 32];  /* name of the temporary file */
+    size_t key_size;        /* number of chars in the key */
+    size_t mask_size;       /* number of bytes in the mask */
+    int status = SUCCESS;   /* status of the writes */
+    Lw_mask_cache_header_t header;  /* header of the cached mask */
+    FILE *fptr = NULL;      /* cached mask file */
+    ESPA_TRACE_SCOPE (trace, "mask_cache_write", NULL);  /* timing */
+
+    if (get_cache_key (cache, xml_meta, bmeta, key, cache_file) != SUCCESS)
+    {
+        sprintf (errmsg, "The key of the land/water mask is too long to be "
+            "cached");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    key_size = strlen (key);
+    mask_size = bmeta->nlines * RB_BITPACKED_LINE_BYTES (bmeta->nsamps);
+
+    memset (&header, 0, sizeof (header));
+    memcpy (header.magic, LW_MASK_CACHE_MAGIC, sizeof (header.magic));
+    header.version = LW_MASK_CACHE_VERSION;
+    header.key_size = key_size;
+    header.nlines = bmeta->nlines;
+    header.nsamps = bmeta->nsamps;
+
+    /* Write the mask to a temporary file and move it into place */
+    snprintf (tmp_file, sizeof (tmp_file), "%s.%ld", cache_file,
+        (long) getpid ());
+    fptr = fopen (tmp_file, "wb");
+    if (fptr == NULL)
+    {
+        sprintf (errmsg, "Opening the cached land/water mask %s", tmp_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    if (fwrite (&header, sizeof (header), 1, fptr) != 1 ||
+        fwrite (key, 1, key_size, fptr) != key_size ||
+        fwrite (land_water_mask, 1, mask_size, fptr) != mask_size)
+        status = ERROR;
+    if (fclose (fptr) != 0)
+        status = ERROR;
+
+    if (status != SUCCESS || rename (tmp_file, cache_file) != 0)
+    {
+        sprintf (errmsg, "Writing the cached land/water mask %s", cache_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        unlink (tmp_file);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
@@ -0,0 +1,84 @@
+/*****************************************************************************
+FILE: land_water_mask_cache.h
+
+PURPOSE: Contains defines, structures, and prototypes for the cache of
+finished land/water masks.  Scenes on the same grid (repeat WRS-2 path/rows,
+ARD and MODIS tiles) have identical masks, so a mask generated once from the
+land-mass polygon is kept and reused for every later scene on that grid.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The cache is only used when LW_MASK_CACHE_ENV names the cache
+     directory.
+  2. Each mask is keyed by the projection and grid of the scene (proj_info
+     including the corners, the pixel size, and the dimensions of band 1)
+     along with the name, size, and modification time of the land-mass
+     polygon file and the interpolation error allowed for the mask.
+  3. The masks are stored bit-packed, one line after another, following a
+     header and the full key, which is compared on every lookup.
+*****************************************************************************/
+
+#ifndef LAND_WATER_MASK_CACHE_H
+#define LAND_WATER_MASK_CACHE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "error_handler.h"
+#include "espa_metadata.h"
+
+/* Defines */
+#define LW_MASK_CACHE_ENV "ESPA_LAND_WATER_MASK_CACHE" /* directory of the
+                                     land/water mask cache */
+#define LW_MASK_CACHE_MAGIC "ESPALWMK" /* identifies a cached mask */
+#define LW_MASK_CACHE_VERSION 1        /* version of the cached mask layout */
+
+/* Header at the start of a cached mask */
+typedef struct
+{
+    char magic[8];          /* LW_MASK_CACHE_MAGIC, without the NULL */
+    uint32_t version;       /* LW_MASK_CACHE_VERSION */
+    uint32_t key_size;      /* number of bytes in the key following the
+                               header */
+    uint32_t nlines;        /* number of lines in the mask */
+    uint32_t nsamps;        /* number of samples in the mask */
+} Lw_mask_cache_header_t;
+
+/* Cache of finished land/water masks */
+typedef struct
+{
+    char dir[STR_SIZE];     /* directory holding the cached masks */
+    char polygon_id[STR_SIZE]; /* name, size, and modification time of the
+                               land-mass polygon file */
+} Lw_mask_cache_t;
+
+/* Prototypes */
+bool init_lw_mask_cache
+(
+    const char *polygon_file, /* I: name of the land-mass polygon file */
+    Lw_mask_cache_t *cache    /* O: cache of the land/water masks */
+);
+
+int read_lw_mask_cache
+(
+    const Lw_mask_cache_t *cache,      /* I: cache of the land/water masks */
+    const Espa_internal_meta_t *xml_meta, /* I: metadata of the scene */
+    const Espa_band_meta_t *bmeta,     /* I: band 1, the representative
+                                             band */
+    unsigned char **land_water_mask    /* O: bit-packed mask; memory is
+                                             allocated */
+);
+
+int write_lw_mask_cache
+(
+    const Lw_mask_cache_t *cache,      /* I: cache of the land/water masks */
+    const Espa_internal_meta_t *xml_meta, /* I: metadata of the scene */
+    const Espa_band_meta_t *bmeta,     /* I: band 1, the representative
+                                             band */
+    const unsigned char *land_water_mask /* I: bit-packed mask */
+);
+
+#endif
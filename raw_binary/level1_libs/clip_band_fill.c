@@ -0,0 +1,839 @@
+/*****************************************************************************
+FILE: clip_band_fill.c
+
+PURPOSE: Contains functions for merging the fill of a line of image bands and
+its band quality band, so any pixel which is fill in one band (or in the band
+quality) is fill in all of them.  Each kernel merges as many whole vectors of
+pixels as fit in the line, starting at the given sample, and returns the
+sample following the last one handled, leaving the remainder to the scalar
+loop.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The vector kernels compare every band of the pixels in the vector
+     against fill, ORing the results into the mask of the pixels to be fill
+     and ANDing them into the mask of the pixels which already are fill in
+     every band.  The fill values are only written where the first is set
+     and the second isn't, and vectors with nothing to change (most of the
+     scene) are left untouched.
+  2. The pixels which are newly filled are counted, and the spans of samples
+     holding them are recorded, so the caller only needs to write back the
+     parts of the line which were changed.
+  3. The kernels are chosen once, when the program is loaded, from the
+     instruction sets of the CPU (see espa_cpu_dispatch.h).
+*****************************************************************************/
+
+#include <stdbool.h>
+#include "clip_band_misalignment.h"
+#include "clip_band_fill.h"
+#include "espa_cpu_dispatch.h"
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#define CLIP_FILL_X86
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define CLIP_FILL_NEON
+#endif
+
+/* Kernel merging the whole vectors of a line of 8-bit bands; returns the
+   sample following the last one merged */
+typedef int (*Clip_fill_uint8_kernel_t)
+(
+    int nbands,             /* I: number of image bands */
+    int s,                  /* I: first sample to be merged */
+    int nsamps,             /* I: number of samples in the line */
+    uint8_t **file_buf,     /* I/O: line of each image band */
+    uint16_t *bqa_buf,      /* I/O: line of the band quality band */
+    Clip_fill_changes_t *changes  /* I/O: changes made to the line */
+);
+
+/* Kernel merging the whole vectors of a line of 16-bit bands; returns the
+   sample following the last one merged */
+typedef int (*Clip_fill_uint16_kernel_t)
+(
+    int nbands,             /* I: number of image bands */
+    int s,                  /* I: first sample to be merged */
+    int nsamps,             /* I: number of samples in the line */
+    uint16_t **file_buf,    /* I/O: line of each image band */
+    uint16_t *bqa_buf,      /* I/O: line of the band quality band */
+    Clip_fill_changes_t *changes  /* I/O: changes made to the line */
+);
+
+/* Kernels of each data type; the wide kernel (AVX-512BW or AVX2) merges the
+   wide vectors and the base kernel (SSE2 or NEON) what it leaves.  A NULL
+   kernel leaves the pixels to the next one. */
+typedef struct
+{
+    Clip_fill_uint8_kernel_t uint8_wide;    /* wide kernel of 8-bit bands */
+    Clip_fill_uint8_kernel_t uint8_base;    /* base kernel of 8-bit bands */
+    Clip_fill_uint16_kernel_t uint16_wide;  /* wide kernel of 16-bit bands */
+    Clip_fill_uint16_kernel_t uint16_base;  /* base kernel of 16-bit bands */
+} Clip_fill_kernels_t;
+
+
+/******************************************************************************
+MODULE: add_fill_span
+
+PURPOSE: Adds a run of samples holding newly filled pixels to the changes
+made to the line.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. The runs are added in sample order.  A run within CLIP_FILL_SPAN_GAP
+     samples of the last span extends it, as does any run once
+     CLIP_FILL_MAX_SPANS spans have been recorded, so the spans always cover
+     every changed sample.
+*****************************************************************************/
+static inline void add_fill_span
+(
+    Clip_fill_changes_t *changes,  /* I/O: changes made to the line */
+    int samp,               /* I: first sample of the run */
+    int nsamps,             /* I: number of samples in the run */
+    int nfilled             /* I: number of pixels newly filled in the run */
+)
+{
+    int last = changes->nspans - 1;  /* index of the last span */
+
+    changes->nfilled += nfilled;
+    if (last >= 0 && (changes->nspans == CLIP_FILL_MAX_SPANS ||
+        samp - (changes->samp0[last] + changes->nsamps[last]) <=
+        CLIP_FILL_SPAN_GAP))
+    {
+        changes->nsamps[last] = samp + nsamps - changes->samp0[last];
+        return;
+    }
+
+    changes->samp0[last + 1] = samp;
+    changes->nsamps[last + 1] = nsamps;
+    changes->nspans++;
+}
+
+#ifdef CLIP_FILL_X86
+/******************************************************************************
+MODULE: clip_fill_uint8_avx512
+
+PURPOSE: Merges the fill of 64 pixels at a time of 8-bit bands using AVX-512
+mask compares, writing the fill with masked stores.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+n            Sample following the last one merged
+
+NOTES:
+  1. Only put in the kernel table when the CPU supports AVX-512BW.
+*****************************************************************************/
+__attribute__ ((target ("avx512bw")))
+static int clip_fill_uint8_avx512
+(
+    int nbands,             /* I: number of image bands */
+    int s,                  /* I: first sample to be merged */
+    int nsamps,             /* I: number of samples in the line */
+    uint8_t **file_buf,     /* I/O: line of each image band */
+    uint16_t *bqa_buf,      /* I/O: line of the band quality band */
+    Clip_fill_changes_t *changes  /* I/O: changes made to the line */
+)
+{
+    int i;                  /* looping variable for the bands */
+    __mmask64 fill;         /* pixels which are fill in any band */
+    __mmask64 all_fill;     /* pixels which are fill in every band */
+    __mmask64 eq;           /* pixels which are fill in the current band */
+    __m512i v;              /* current vector of a band */
+    const __m512i level1_fill = _mm512_set1_epi8 (LEVEL1_FILL);
+    const __m512i bqa_fill = _mm512_set1_epi16 (BQA_FILL);
+
+    for (; s + 64 <= nsamps; s += 64)
+    {
+        /* The band quality covers the 64 pixels in two 32-pixel vectors */
+        v = _mm512_loadu_si512 ((const void *) (bqa_buf + s));
+        fill = _mm512_cmpeq_epi16_mask (v, bqa_fill);
+        v = _mm512_loadu_si512 ((const void *) (bqa_buf + s + 32));
+        fill |= (__mmask64) _mm512_cmpeq_epi16_mask (v, bqa_fill) << 32;
+        all_fill = fill;
+
+        for (i = 0; i < nbands; i++)
+        {
+            v = _mm512_loadu_si512 ((const void *) (file_buf[i] + s));
+            eq = _mm512_cmpeq_epi8_mask (v, level1_fill);
+            fill |= eq;
+            all_fill &= eq;
+        }
+
+        fill &= ~all_fill;
+        if (fill == 0)
+            continue;
+        add_fill_span (changes, s, 64, __builtin_popcountll (fill));
+
+        for (i = 0; i < nbands; i++)
+            _mm512_mask_storeu_epi8 (file_buf[i] + s, fill, level1_fill);
+        _mm512_mask_storeu_epi16 (bqa_buf + s, (__mmask32) fill, bqa_fill);
+        _mm512_mask_storeu_epi16 (bqa_buf + s + 32, (__mmask32) (fill >> 32),
+            bqa_fill);
+    }
+
+    return s;
+}
+
+
+/******************************************************************************
+MODULE: clip_fill_uint16_avx512
+
+PURPOSE: Merges the fill of 32 pixels at a time of 16-bit bands using AVX-512
+mask compares, writing the fill with masked stores.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+n            Sample following the last one merged
+
+NOTES:
+  1. Only put in the kernel table when the CPU supports AVX-512BW.
+*****************************************************************************/
+__attribute__ ((target ("avx512bw")))
+static int clip_fill_uint16_avx512
+(
+    int nbands,             /* I: number of image bands */
+    int s,                  /* I: first sample to be merged */
+    int nsamps,             /* I: number of samples in the line */
+    uint16_t **file_buf,    /* I/O: line of each image band */
+    uint16_t *bqa_buf,      /* I/O: line of the band quality band */
+    Clip_fill_changes_t *changes  /* I/O: changes made to the line */
+)
+{
+    int i;                  /* looping variable for the bands */
+    __mmask32 fill;         /* pixels which are fill in any band */
+    __mmask32 all_fill;     /* pixels which are fill in every band */
+    __mmask32 eq;           /* pixels which are fill in the current band */
+    __m512i v;              /* current vector of a band */
+    const __m512i level1_fill = _mm512_set1_epi16 (LEVEL1_FILL);
+    const __m512i bqa_fill = _mm512_set1_epi16 (BQA_FILL);
+
+    for (; s + 32 <= nsamps; s += 32)
+    {
+        v = _mm512_loadu_si512 ((const void *) (bqa_buf + s));
+        fill = _mm512_cmpeq_epi16_mask (v, bqa_fill);
+        all_fill = fill;
+
+        for (i = 0; i < nbands; i++)
+        {
+            v = _mm512_loadu_si512 ((const void *) (file_buf[i] + s));
+            eq = _mm512_cmpeq_epi16_mask (v, level1_fill);
+            fill |= eq;
+            all_fill &= eq;
+        }
+
+        fill &= ~all_fill;
+        if (fill == 0)
+            continue;
+        add_fill_span (changes, s, 32, __builtin_popcount (fill));
+
+        for (i = 0; i < nbands; i++)
+            _mm512_mask_storeu_epi16 (file_buf[i] + s, fill, level1_fill);
+        _mm512_mask_storeu_epi16 (bqa_buf + s, fill, bqa_fill);
+    }
+
+    return s;
+}
+
+
+/******************************************************************************
+MODULE: clip_fill_uint8_avx2
+
+PURPOSE: Merges the fill of 32 pixels at a time of 8-bit bands using AVX2
+compares and blends.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+n            Sample following the last one merged
+
+NOTES:
+  1. Only put in the kernel table when the CPU supports AVX2.
+  2. The 16-bit band quality masks are packed to bytes to be merged with the
+     band masks.  The pack works within each 128-bit lane, so the 64-bit
+     quarters are put back in pixel order with a permute.
+*****************************************************************************/
+__attribute__ ((target ("avx2")))
+static int clip_fill_uint8_avx2
+(
+    int nbands,             /* I: number of image bands */
+    int s,                  /* I: first sample to be merged */
+    int nsamps,             /* I: number of samples in the line */
+    uint8_t **file_buf,     /* I/O: line of each image band */
+    uint16_t *bqa_buf,      /* I/O: line of the band quality band */
+    Clip_fill_changes_t *changes  /* I/O: changes made to the line */
+)
+{
+    int i;                  /* looping variable for the bands */
+    __m256i fill;           /* pixels which are fill in any band */
+    __m256i all_fill;       /* pixels which are fill in every band */
+    __m256i eq;             /* pixels which are fill in the current band */
+    __m256i fill_lo;        /* fill mask of the first 16 band quality pixels */
+    __m256i fill_hi;        /* fill mask of the last 16 band quality pixels */
+    __m256i v;              /* current vector of a band */
+    const __m256i level1_fill = _mm256_set1_epi8 (LEVEL1_FILL);
+    const __m256i bqa_fill = _mm256_set1_epi16 (BQA_FILL);
+
+    for (; s + 32 <= nsamps; s += 32)
+    {
+        v = _mm256_loadu_si256 ((const __m256i *) (bqa_buf + s));
+        fill_lo = _mm256_cmpeq_epi16 (v, bqa_fill);
+        v = _mm256_loadu_si256 ((const __m256i *) (bqa_buf + s + 16));
+        fill_hi = _mm256_cmpeq_epi16 (v, bqa_fill);
+        fill = _mm256_permute4x64_epi64 (_mm256_packs_epi16 (fill_lo,
+            fill_hi), 0xD8);
+        all_fill = fill;
+
+        for (i = 0; i < nbands; i++)
+        {
+            v = _mm256_loadu_si256 ((const __m256i *) (file_buf[i] + s));
+            eq = _mm256_cmpeq_epi8 (v, level1_fill);
+            fill = _mm256_or_si256 (fill, eq);
+            all_fill = _mm256_and_si256 (all_fill, eq);
+        }
+
+        fill = _mm256_andnot_si256 (all_fill, fill);
+        if (_mm256_testz_si256 (fill, fill))
+            continue;
+        add_fill_span (changes, s, 32,
+            __builtin_popcount (_mm256_movemask_epi8 (fill)));
+
+        for (i = 0; i < nbands; i++)
+        {
+            v = _mm256_loadu_si256 ((const __m256i *) (file_buf[i] + s));
+            v = _mm256_blendv_epi8 (v, level1_fill, fill);
+            _mm256_storeu_si256 ((__m256i *) (file_buf[i] + s), v);
+        }
+
+        /* Widen the merged mask back to the band quality pixels */
+        fill_lo = _mm256_cvtepi8_epi16 (_mm256_castsi256_si128 (fill));
+        fill_hi = _mm256_cvtepi8_epi16 (_mm256_extracti128_si256 (fill, 1));
+        v = _mm256_loadu_si256 ((const __m256i *) (bqa_buf + s));
+        v = _mm256_blendv_epi8 (v, bqa_fill, fill_lo);
+        _mm256_storeu_si256 ((__m256i *) (bqa_buf + s), v);
+        v = _mm256_loadu_si256 ((const __m256i *) (bqa_buf + s + 16));
+        v = _mm256_blendv_epi8 (v, bqa_fill, fill_hi);
+        _mm256_storeu_si256 ((__m256i *) (bqa_buf + s + 16), v);
+    }
+
+    return s;
+}
+
+
+/******************************************************************************
+MODULE: clip_fill_uint16_avx2
+
+PURPOSE: Merges the fill of 16 pixels at a time of 16-bit bands using AVX2
+compares and blends.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+n            Sample following the last one merged
+
+NOTES:
+  1. Only put in the kernel table when the CPU supports AVX2.
+  2. The byte mask of the merged mask has two bits for each pixel.
+*****************************************************************************/
+__attribute__ ((target ("avx2")))
+static int clip_fill_uint16_avx2
+(
+    int nbands,             /* I: number of image bands */
+    int s,                  /* I: first sample to be merged */
+    int nsamps,             /* I: number of samples in the line */
+    uint16_t **file_buf,    /* I/O: line of each image band */
+    uint16_t *bqa_buf,      /* I/O: line of the band quality band */
+    Clip_fill_changes_t *changes  /* I/O: changes made to the line */
+)
+{
+    int i;                  /* looping variable for the bands */
+    __m256i fill;           /* pixels which are fill in any band */
+    __m256i all_fill;       /* pixels which are fill in every band */
+    __m256i eq;             /* pixels which are fill in the current band */
+    __m256i v;              /* current vector of a band */
+    const __m256i level1_fill = _mm256_set1_epi16 (LEVEL1_FILL);
+    const __m256i bqa_fill = _mm256_set1_epi16 (BQA_FILL);
+
+    for (; s + 16 <= nsamps; s += 16)
+    {
+        v = _mm256_loadu_si256 ((const __m256i *) (bqa_buf + s));
+        fill = _mm256_cmpeq_epi16 (v, bqa_fill);
+        all_fill = fill;
+
+        for (i = 0; i < nbands; i++)
+        {
+            v = _mm256_loadu_si256 ((const __m256i *) (file_buf[i] + s));
+            eq = _mm256_cmpeq_epi16 (v, level1_fill);
+            fill = _mm256_or_si256 (fill, eq);
+            all_fill = _mm256_and_si256 (all_fill, eq);
+        }
+
+        fill = _mm256_andnot_si256 (all_fill, fill);
+        if (_mm256_testz_si256 (fill, fill))
+            continue;
+        add_fill_span (changes, s, 16,
+            __builtin_popcount (_mm256_movemask_epi8 (fill)) / 2);
+
+        for (i = 0; i < nbands; i++)
+        {
+            v = _mm256_loadu_si256 ((const __m256i *) (file_buf[i] + s));
+            v = _mm256_blendv_epi8 (v, level1_fill, fill);
+            _mm256_storeu_si256 ((__m256i *) (file_buf[i] + s), v);
+        }
+        v = _mm256_loadu_si256 ((const __m256i *) (bqa_buf + s));
+        v = _mm256_blendv_epi8 (v, bqa_fill, fill);
+        _mm256_storeu_si256 ((__m256i *) (bqa_buf + s), v);
+    }
+
+    return s;
+}
+
+
+/******************************************************************************
+MODULE: clip_fill_select_sse2
+
+PURPOSE: Selects the fill value where the mask is set and the original value
+elsewhere, using the SSE2 logical operations since SSE2 has no blend.
+
+RETURN VALUE:
+Type = __m128i
+Value        Description
+-----        -----------
+v            Merged vector
+*****************************************************************************/
+static inline __m128i clip_fill_select_sse2
+(
+    __m128i v,              /* I: original values */
+    __m128i fill_value,     /* I: fill value in each element */
+    __m128i fill            /* I: mask of the elements to be fill */
+)
+{
+    return _mm_or_si128 (_mm_and_si128 (fill, fill_value),
+        _mm_andnot_si128 (fill, v));
+}
+
+
+/******************************************************************************
+MODULE: clip_fill_uint8_sse2
+
+PURPOSE: Merges the fill of 16 pixels at a time of 8-bit bands using SSE2,
+which is available on every x86-64 CPU.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+n            Sample following the last one merged
+
+NOTES:
+*****************************************************************************/
+static int clip_fill_uint8_sse2
+(
+    int nbands,             /* I: number of image bands */
+    int s,                  /* I: first sample to be merged */
+    int nsamps,             /* I: number of samples in the line */
+    uint8_t **file_buf,     /* I/O: line of each image band */
+    uint16_t *bqa_buf,      /* I/O: line of the band quality band */
+    Clip_fill_changes_t *changes  /* I/O: changes made to the line */
+)
+{
+    int i;                  /* looping variable for the bands */
+    int bits;               /* byte mask of the pixels to be filled */
+    __m128i fill;           /* pixels which are fill in any band */
+    __m128i all_fill;       /* pixels which are fill in every band */
+    __m128i eq;             /* pixels which are fill in the current band */
+    __m128i fill_lo;        /* fill mask of the first 8 band quality pixels */
+    __m128i fill_hi;        /* fill mask of the last 8 band quality pixels */
+    __m128i v;              /* current vector of a band */
+    const __m128i level1_fill = _mm_set1_epi8 (LEVEL1_FILL);
+    const __m128i bqa_fill = _mm_set1_epi16 (BQA_FILL);
+
+    for (; s + 16 <= nsamps; s += 16)
+    {
+        v = _mm_loadu_si128 ((const __m128i *) (bqa_buf + s));
+        fill_lo = _mm_cmpeq_epi16 (v, bqa_fill);
+        v = _mm_loadu_si128 ((const __m128i *) (bqa_buf + s + 8));
+        fill_hi = _mm_cmpeq_epi16 (v, bqa_fill);
+        fill = _mm_packs_epi16 (fill_lo, fill_hi);
+        all_fill = fill;
+
+        for (i = 0; i < nbands; i++)
+        {
+            v = _mm_loadu_si128 ((const __m128i *) (file_buf[i] + s));
+            eq = _mm_cmpeq_epi8 (v, level1_fill);
+            fill = _mm_or_si128 (fill, eq);
+            all_fill = _mm_and_si128 (all_fill, eq);
+        }
+
+        fill = _mm_andnot_si128 (all_fill, fill);
+        bits = _mm_movemask_epi8 (fill);
+        if (bits == 0)
+            continue;
+        add_fill_span (changes, s, 16, __builtin_popcount (bits));
+
+        for (i = 0; i < nbands; i++)
+        {
+            v = _mm_loadu_si128 ((const __m128i *) (file_buf[i] + s));
+            v = clip_fill_select_sse2 (v, level1_fill, fill);
+            _mm_storeu_si128 ((__m128i *) (file_buf[i] + s), v);
+        }
+
+        /* Widen the merged mask back to the band quality pixels */
+        fill_lo = _mm_unpacklo_epi8 (fill, fill);
+        fill_hi = _mm_unpackhi_epi8 (fill, fill);
+        v = _mm_loadu_si128 ((const __m128i *) (bqa_buf + s));
+        v = clip_fill_select_sse2 (v, bqa_fill, fill_lo);
+        _mm_storeu_si128 ((__m128i *) (bqa_buf + s), v);
+        v = _mm_loadu_si128 ((const __m128i *) (bqa_buf + s + 8));
+        v = clip_fill_select_sse2 (v, bqa_fill, fill_hi);
+        _mm_storeu_si128 ((__m128i *) (bqa_buf + s + 8), v);
+    }
+
+    return s;
+}
+
+
+/******************************************************************************
+MODULE: clip_fill_uint16_sse2
+
+PURPOSE: Merges the fill of 8 pixels at a time of 16-bit bands using SSE2,
+which is available on every x86-64 CPU.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+n            Sample following the last one merged
+
+NOTES:
+  1. The byte mask of the merged mask has two bits for each pixel.
+*****************************************************************************/
+static int clip_fill_uint16_sse2
+(
+    int nbands,             /* I: number of image bands */
+    int s,                  /* I: first sample to be merged */
+    int nsamps,             /* I: number of samples in the line */
+    uint16_t **file_buf,    /* I/O: line of each image band */
+    uint16_t *bqa_buf,      /* I/O: line of the band quality band */
+    Clip_fill_changes_t *changes  /* I/O: changes made to the line */
+)
+{
+    int i;                  /* looping variable for the bands */
+    int bits;               /* byte mask of the pixels to be filled */
+    __m128i fill;           /* pixels which are fill in any band */
+    __m128i all_fill;       /* pixels which are fill in every band */
+    __m128i eq;             /* pixels which are fill in the current band */
+    __m128i v;              /* current vector of a band */
+    const __m128i level1_fill = _mm_set1_epi16 (LEVEL1_FILL);
+    const __m128i bqa_fill = _mm_set1_epi16 (BQA_FILL);
+
+    for (; s + 8 <= nsamps; s += 8)
+    {
+        v = _mm_loadu_si128 ((const __m128i *) (bqa_buf + s));
+        fill = _mm_cmpeq_epi16 (v, bqa_fill);
+        all_fill = fill;
+
+        for (i = 0; i < nbands; i++)
+        {
+            v = _mm_loadu_si128 ((const __m128i *) (file_buf[i] + s));
+            eq = _mm_cmpeq_epi16 (v, level1_fill);
+            fill = _mm_or_si128 (fill, eq);
+            all_fill = _mm_and_si128 (all_fill, eq);
+        }
+
+        fill = _mm_andnot_si128 (all_fill, fill);
+        bits = _mm_movemask_epi8 (fill);
+        if (bits == 0)
+            continue;
+        add_fill_span (changes, s, 8, __builtin_popcount (bits) / 2);
+
+        for (i = 0; i < nbands; i++)
+        {
+            v = _mm_loadu_si128 ((const __m128i *) (file_buf[i] + s));
+            v = clip_fill_select_sse2 (v, level1_fill, fill);
+            _mm_storeu_si128 ((__m128i *) (file_buf[i] + s), v);
+        }
+        v = _mm_loadu_si128 ((const __m128i *) (bqa_buf + s));
+        v = clip_fill_select_sse2 (v, bqa_fill, fill);
+        _mm_storeu_si128 ((__m128i *) (bqa_buf + s), v);
+    }
+
+    return s;
+}
+#endif
+
+#ifdef CLIP_FILL_NEON
+/******************************************************************************
+MODULE: clip_fill_uint8_neon
+
+PURPOSE: Merges the fill of 16 pixels at a time of 8-bit bands using the NEON
+compares and bitwise selects.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+n            Sample following the last one merged
+
+NOTES:
+  1. The newly filled pixels are counted by shifting each byte of the mask
+     down to a single bit and summing the bytes with pairwise adds.
+*****************************************************************************/
+static int clip_fill_uint8_neon
+(
+    int nbands,             /* I: number of image bands */
+    int s,                  /* I: first sample to be merged */
+    int nsamps,             /* I: number of samples in the line */
+    uint8_t **file_buf,     /* I/O: line of each image band */
+    uint16_t *bqa_buf,      /* I/O: line of the band quality band */
+    Clip_fill_changes_t *changes  /* I/O: changes made to the line */
+)
+{
+    int i;                  /* looping variable for the bands */
+    int count;              /* number of pixels to be filled */
+    uint8x16_t fill;        /* pixels which are fill in any band */
+    uint8x16_t all_fill;    /* pixels which are fill in every band */
+    uint8x16_t eq;          /* pixels which are fill in the current band */
+    uint64x2_t sum;         /* number of pixels to be filled in each half */
+    uint16x8_t fill_lo;     /* fill mask of the first 8 band quality pixels */
+    uint16x8_t fill_hi;     /* fill mask of the last 8 band quality pixels */
+    const uint8x16_t level1_fill = vdupq_n_u8 (LEVEL1_FILL);
+    const uint16x8_t bqa_fill = vdupq_n_u16 (BQA_FILL);
+
+    for (; s + 16 <= nsamps; s += 16)
+    {
+        fill_lo = vceqq_u16 (vld1q_u16 (bqa_buf + s), bqa_fill);
+        fill_hi = vceqq_u16 (vld1q_u16 (bqa_buf + s + 8), bqa_fill);
+        fill = vcombine_u8 (vmovn_u16 (fill_lo), vmovn_u16 (fill_hi));
+        all_fill = fill;
+
+        for (i = 0; i < nbands; i++)
+        {
+            eq = vceqq_u8 (vld1q_u8 (file_buf[i] + s), level1_fill);
+            fill = vorrq_u8 (fill, eq);
+            all_fill = vandq_u8 (all_fill, eq);
+        }
+
+        fill = vbicq_u8 (fill, all_fill);
+        sum = vpaddlq_u32 (vpaddlq_u16 (vpaddlq_u8 (vshrq_n_u8 (fill, 7))));
+        count = (int) (vgetq_lane_u64 (sum, 0) + vgetq_lane_u64 (sum, 1));
+        if (count == 0)
+            continue;
+        add_fill_span (changes, s, 16, count);
+
+        for (i = 0; i < nbands; i++)
+            vst1q_u8 (file_buf[i] + s, vbslq_u8 (fill, level1_fill,
+                vld1q_u8 (file_buf[i] + s)));
+
+        /* Widen the merged mask back to the band quality pixels */
+        fill_lo = vreinterpretq_u16_s16 (vmovl_s8 (vreinterpret_s8_u8 (
+            vget_low_u8 (fill))));
+        fill_hi = vreinterpretq_u16_s16 (vmovl_s8 (vreinterpret_s8_u8 (
+            vget_high_u8 (fill))));
+        vst1q_u16 (bqa_buf + s, vbslq_u16 (fill_lo, bqa_fill,
+            vld1q_u16 (bqa_buf + s)));
+        vst1q_u16 (bqa_buf + s + 8, vbslq_u16 (fill_hi, bqa_fill,
+            vld1q_u16 (bqa_buf + s + 8)));
+    }
+
+    return s;
+}
+
+
+/******************************************************************************
+MODULE: clip_fill_uint16_neon
+
+PURPOSE: Merges the fill of 8 pixels at a time of 16-bit bands using the NEON
+compares and bitwise selects.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+n            Sample following the last one merged
+
+NOTES:
+  1. The newly filled pixels are counted by shifting each element of the
+     mask down to a single bit and summing the elements with pairwise adds.
+*****************************************************************************/
+static int clip_fill_uint16_neon
+(
+    int nbands,             /* I: number of image bands */
+    int s,                  /* I: first sample to be merged */
+    int nsamps,             /* I: number of samples in the line */
+    uint16_t **file_buf,    /* I/O: line of each image band */
+    uint16_t *bqa_buf,      /* I/O: line of the band quality band */
+    Clip_fill_changes_t *changes  /* I/O: changes made to the line */
+)
+{
+    int i;                  /* looping variable for the bands */
+    int count;              /* number of pixels to be filled */
+    uint16x8_t fill;        /* pixels which are fill in any band */
+    uint16x8_t all_fill;    /* pixels which are fill in every band */
+    uint16x8_t eq;          /* pixels which are fill in the current band */
+    uint64x2_t sum;         /* number of pixels to be filled in each half */
+    const uint16x8_t level1_fill = vdupq_n_u16 (LEVEL1_FILL);
+    const uint16x8_t bqa_fill = vdupq_n_u16 (BQA_FILL);
+
+    for (; s + 8 <= nsamps; s += 8)
+    {
+        fill = vceqq_u16 (vld1q_u16 (bqa_buf + s), bqa_fill);
+        all_fill = fill;
+
+        for (i = 0; i < nbands; i++)
+        {
+            eq = vceqq_u16 (vld1q_u16 (file_buf[i] + s), level1_fill);
+            fill = vorrq_u16 (fill, eq);
+            all_fill = vandq_u16 (all_fill, eq);
+        }
+
+        fill = vbicq_u16 (fill, all_fill);
+        sum = vpaddlq_u32 (vpaddlq_u16 (vshrq_n_u16 (fill, 15)));
+        count = (int) (vgetq_lane_u64 (sum, 0) + vgetq_lane_u64 (sum, 1));
+        if (count == 0)
+            continue;
+        add_fill_span (changes, s, 8, count);
+
+        for (i = 0; i < nbands; i++)
+            vst1q_u16 (file_buf[i] + s, vbslq_u16 (fill, level1_fill,
+                vld1q_u16 (file_buf[i] + s)));
+        vst1q_u16 (bqa_buf + s, vbslq_u16 (fill, bqa_fill,
+            vld1q_u16 (bqa_buf + s)));
+    }
+
+    return s;
+}
+#endif
+
+
+/* Kernels of the fill merge, chosen by init_clip_fill_kernels */
+static Clip_fill_kernels_t clip_fill_kernels = {NULL, NULL, NULL, NULL};
+
+
+/******************************************************************************
+MODULE: init_clip_fill_kernels
+
+PURPOSE: Chooses the widest fill merge kernels supported by the CPU.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. Run when the program (or shared library) is loaded.
+*****************************************************************************/
+__attribute__ ((constructor))
+static void init_clip_fill_kernels (void)
+{
+#if defined(CLIP_FILL_X86)
+    if (espa_cpu_supports (ESPA_CPU_AVX512BW))
+    {
+        clip_fill_kernels.uint8_wide = clip_fill_uint8_avx512;
+        clip_fill_kernels.uint16_wide = clip_fill_uint16_avx512;
+    }
+    else if (espa_cpu_supports (ESPA_CPU_AVX2))
+    {
+        clip_fill_kernels.uint8_wide = clip_fill_uint8_avx2;
+        clip_fill_kernels.uint16_wide = clip_fill_uint16_avx2;
+    }
+    if (espa_cpu_supports (ESPA_CPU_SSE2))
+    {
+        clip_fill_kernels.uint8_base = clip_fill_uint8_sse2;
+        clip_fill_kernels.uint16_base = clip_fill_uint16_sse2;
+    }
+#elif defined(CLIP_FILL_NEON)
+    if (espa_cpu_supports (ESPA_CPU_NEON))
+    {
+        clip_fill_kernels.uint8_base = clip_fill_uint8_neon;
+        clip_fill_kernels.uint16_base = clip_fill_uint16_neon;
+    }
+#endif
+}
+
+
+/* Runs the vector kernels of a data type on a line */
+#define CLIP_FILL_VECTOR(suffix, nbands, s, nsamps, file_buf, bqa_buf, \
+    changes) \
+    do { \
+        if (clip_fill_kernels.suffix##_wide != NULL) \
+            s = clip_fill_kernels.suffix##_wide (nbands, s, nsamps, \
+                file_buf, bqa_buf, changes); \
+        if (clip_fill_kernels.suffix##_base != NULL) \
+            s = clip_fill_kernels.suffix##_base (nbands, s, nsamps, \
+                file_buf, bqa_buf, changes); \
+    } while (0)
+
+/******************************************************************************
+MODULE:  DEFINE_CLIP_FILL
+
+PURPOSE: Defines clip_fill_<suffix>, which clips one line of the bands of the
+given data type and the band quality band, so any pixel which is fill in one
+band (or in the band quality) is fill in all of them.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. The widest kernel supported by the CPU merges the whole vectors of the
+     line, and the remaining pixels are merged one at a time.
+  2. Only the vector kernels differ between the data types, since their
+     compares and stores depend on the width of the pixels.  Everything else
+     is written once here and instantiated for each data type below.
+  3. A pixel is newly filled when it is fill in some, but not all, of the
+     bands and the band quality band.  The changes hold the number of such
+     pixels and the spans of samples containing them; no spans means the
+     line is unchanged.
+******************************************************************************/
+#define DEFINE_CLIP_FILL(suffix, type) \
+void clip_fill_##suffix \
+( \
+    int nbands,             /* I: number of image bands */ \
+    int nsamps,             /* I: number of samples in the line */ \
+    type **file_buf,        /* I/O: line of each image band */ \
+    uint16_t *bqa_buf,      /* I/O: line of the band quality band */ \
+    Clip_fill_changes_t *changes  /* O: changes made to the line */ \
+) \
+{ \
+    int i;                  /* looping variable for the bands */ \
+    int s = 0;              /* sample looping variable */ \
+    bool fill;              /* is the current pixel fill in any band */ \
+    bool all_fill;          /* is the current pixel fill in every band */ \
+\
+    changes->nfilled = 0; \
+    changes->nspans = 0; \
+    CLIP_FILL_VECTOR (suffix, nbands, s, nsamps, file_buf, bqa_buf, \
+        changes); \
+\
+    for (; s < nsamps; s++) \
+    { \
+        /* Check the current pixel for each band to be fill */ \
+        fill = (bqa_buf[s] == BQA_FILL); \
+        all_fill = fill; \
+        for (i = 0; i < nbands; i++) \
+        { \
+            fill |= (file_buf[i][s] == LEVEL1_FILL); \
+            all_fill &= (file_buf[i][s] == LEVEL1_FILL); \
+        } \
+\
+        if (fill && !all_fill) \
+        { \
+            for (i = 0; i < nbands; i++) \
+                file_buf[i][s] = LEVEL1_FILL; \
+            bqa_buf[s] = BQA_FILL;  /* first bit set to 1 for fill */ \
+            add_fill_span (changes, s, 1, 1); \
+        } \
+    } \
+}
+
+DEFINE_CLIP_FILL (uint8, uint8_t)
+DEFINE_CLIP_FILL (uint16, uint16_t)
@@ -0,0 +1,62 @@
+/*****************************************************************************
+FILE: clip_band_fill.h
+
+PURPOSE: Contains prototypes for the fill merge of the band misalignment
+clipping, which sets a pixel to fill in all the bands (and in the band quality
+band) when it is fill in any of them.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The merge is vectorized with AVX-512BW or AVX2, SSE2, or NEON, the
+     widest the CPU supports, with a scalar loop for the remainder of each
+     line.
+  2. Both functions report the number of pixels newly filled in the line and
+     the spans of samples holding them, so only those need to be written
+     back.
+*****************************************************************************/
+
+#ifndef CLIP_BAND_FILL_H
+#define CLIP_BAND_FILL_H
+
+#include <stdint.h>
+
+/* Defines */
+#define CLIP_FILL_MAX_SPANS 4    /* maximum number of spans of changed samples
+                                    recorded for a line */
+#define CLIP_FILL_SPAN_GAP 256   /* runs of changed samples this close to the
+                                    last span are merged into it */
+
+/* Changes made to a line by the fill merge */
+typedef struct
+{
+    int nfilled;                 /* number of pixels newly filled */
+    int nspans;                  /* number of spans of changed samples; 0 if
+                                    the line is unchanged */
+    int samp0[CLIP_FILL_MAX_SPANS];  /* first sample of each span */
+    int nsamps[CLIP_FILL_MAX_SPANS]; /* number of samples in each span */
+} Clip_fill_changes_t;
+
+/* Prototypes */
+void clip_fill_uint8
+(
+    int nbands,             /* I: number of image bands */
+    int nsamps,             /* I: number of samples in the line */
+    uint8_t **file_buf,     /* I/O: line of each image band */
+    uint16_t *bqa_buf,      /* I/O: line of the band quality band */
+    Clip_fill_changes_t *changes  /* O: changes made to the line */
+);
+
+void clip_fill_uint16
+(
+    int nbands,             /* I: number of image bands */
+    int nsamps,             /* I: number of samples in the line */
+    uint16_t **file_buf,    /* I/O: line of each image band */
+    uint16_t *bqa_buf,      /* I/O: line of the band quality band */
+    Clip_fill_changes_t *changes  /* O: changes made to the line */
+);
+
+#endif
@@ -14,18 +14,888 @@ NOTES:
      metadata format found in ESPA Raw Binary Format v1.0.doc.  The schema for
      the ESPA internal metadata format is available at
      http://espa.cr.usgs.gov/schema/espa_internal_metadata_v1_0.xsd.
+  2. The bands are found by find_clip_bands and clipped by clip_band_blocks,
+     which are shared with the OLI/TIRS clipping in
+     clip_band_misalignment_landsat89.c.  The two only differ in their band
+     options, band counts, and data type.
+  3. clip_band_blocks traverses the bands itself.  The clipping stage
+     (open_clip_stage, clip_stage_block, and close_clip_stage) clips the
+     blocks of a traversal driven by the caller, so other steps can share
+     the blocks.
 *****************************************************************************/
 
 #include <unistd.h>
 #include <math.h>
+#include "espa_task_pool.h"
 #include "clip_band_misalignment.h"
 
+/* Block of lines being clipped, shared by the iterations of the loop over
+   the lines */
+typedef struct
+{
+    int nbands;               /* number of image bands */
+    int nsamps;               /* number of samples in the bands */
+    int band_size;            /* bytes per pixel of the image bands */
+    Espa_band_block_t *block; /* block of lines of the bands */
+    Clip_fill_changes_t *changes;  /* changes made to each line of the
+                                 block */
+    int32_t *extent;          /* first and last valid sample of each line of
+                                 the bands */
+    Rb_stats_t **stats;       /* statistics of the clipped pixels of each
+                                 band, with the band quality band last */
+    uint64_t *qa_counts;      /* number of clipped pixels with each of the
+                                 CLIP_QA_COVER_BITS bits of the band quality
+                                 band set */
+} Clip_block_t;
+
+/* Clipping of the blocks of a traversal of the bands */
+struct Clip_stage
+{
+    Espa_internal_meta_t *xml_metadata; /* XML metadata structure */
+    int nbands;               /* number of image bands */
+    int band_index[MAX_CLIP_BANDS + 1];  /* metadata index of each image
+                                 band, followed by the band quality band */
+    int size[MAX_CLIP_BANDS + 1];  /* bytes per pixel of each band */
+    int band_size;            /* bytes per pixel of the image bands */
+    int nsamps;               /* number of samples in the bands */
+    int block_lines;          /* most lines in a block */
+    int fd[MAX_CLIP_BANDS + 1];  /* file descriptors for the bands, with the
+                                 band quality band last; -1 if not opened */
+    bool batch_open;          /* were the batched writes initialized? */
+    Raw_binary_batch_t batch; /* batched I/O engine for writing the blocks */
+    Clip_fill_changes_t *changes;  /* changes made to each line of the
+                                 current block */
+    int32_t *extent;          /* first and last valid sample of each line of
+                                 the bands */
+    Rb_stats_t *stats[MAX_CLIP_BANDS + 1];  /* statistics of the clipped
+                                 pixels of each band, with the band quality
+                                 band last; NULL if not started */
+    uint64_t qa_counts[CLIP_QA_COVER_BITS];  /* number of clipped pixels with
+                                 each cover bit of the band quality band
+                                 set */
+    long nfilled;             /* number of pixels newly filled */
+    long nwritten;            /* number of samples of each band written
+                                 back */
+};
+
+/* Cover types of the percent_coverage of the band quality band, from the
+   single-bit flags of the Collection 2 QA_PIXEL band.  The fill flag is a
+   percentage of all the pixels; the others are of the pixels which aren't
+   fill. */
+static const char *const clip_qa_cover[CLIP_QA_COVER_BITS] =
+{
+    "fill",                   /* bit 0 */
+    "dilated_cloud",          /* bit 1 */
+    "cirrus",                 /* bit 2 */
+    "cloud",                  /* bit 3 */
+    "cloud_shadow",           /* bit 4 */
+    "snow",                   /* bit 5 */
+    "clear",                  /* bit 6 */
+    "water"                   /* bit 7 */
+};
+
+
+/******************************************************************************
+MODULE:  free_clip_stage
+
+PURPOSE: Stops the batched writes of the clipping, closes the bands which
+were opened for it, and frees the statistics of the bands, the changes and
+the extents of the lines, and the stage.
+
+RETURN VALUE:
+Type = None
+******************************************************************************/
+static void free_clip_stage
+(
+    Clip_stage_t *stage       /* I: clipping to be freed */
+)
+{
+    int i;                    /* looping variable */
+
+    if (stage->batch_open)
+        close_raw_binary_batch (&stage->batch);
+    for (i = 0; i <= stage->nbands; i++)
+    {
+        if (stage->fd[i] != -1)
+            close_raw_binary_fd (stage->fd[i]);
+        close_raw_binary_stats (stage->stats[i]);
+    }
+    free (stage->changes);
+    free (stage->extent);
+    free (stage);
+}
+
+
+/******************************************************************************
+MODULE:  write_clip_changes
+
+PURPOSE: Writes the changed parts of a block of clipped lines back out to the
+image bands and the band quality band.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the changes
+SUCCESS         Successfully wrote the changes
+
+NOTES:
+  1. Runs of lines which were changed across their full width are written as
+     one window per band.  Other changed lines are written as one single-line
+     window per band for each span of changed samples.  Unchanged lines are
+     not written at all.
+  2. The windows of the block are gathered and submitted together, so a
+     block goes to the batch once unless its windows outgrow the array.
+******************************************************************************/
+static int write_clip_changes
+(
+    Raw_binary_batch_t *batch,  /* I: batched writes */
+    Espa_band_block_t *block,   /* I: block of clipped lines */
+    int nfds,                   /* I: number of bands, including the band
+                                      quality band */
+    int *fd,                    /* I: file descriptor of each band */
+    int *size,                  /* I: bytes per pixel of each band */
+    int nsamps,                 /* I: number of samples in the bands */
+    Clip_fill_changes_t *changes, /* I: changes made to each line of the
+                                      block */
+    long *nfilled,              /* I/O: number of pixels newly filled */
+    long *nwritten              /* I/O: number of samples of each band
+                                      written back */
+)
+{
+    char FUNC_NAME[] = "write_clip_changes";  /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    int i;                      /* looping variable for the bands */
+    int sp;                     /* looping variable for the spans */
+    int bl;                     /* current line within the block */
+    int run_end;                /* line following the current run of lines */
+    int nwin = 0;               /* number of windows to be written */
+    int need;                   /* number of windows of the current line */
+    int pend_line0 = 0;         /* first line of the windows to be written */
+    Clip_fill_changes_t *c;     /* changes made to the current line */
+    Raw_binary_window_t *win;   /* current window */
+    Raw_binary_window_t windows[(MAX_CLIP_BANDS + 1) * CLIP_FILL_MAX_SPANS];
+                                /* windows of the bands to be written */
+
+    for (bl = 0; bl < block->nlines; bl = run_end)
+    {
+        run_end = bl + 1;
+        c = &changes[bl];
+        if (c->nspans == 0)
+            continue;
+        *nfilled += c->nfilled;
+
+        /* Submit the gathered windows if this line's windows don't fit */
+        need = (c->nspans == 1 && c->samp0[0] == 0 &&
+            c->nsamps[0] == nsamps) ? nfds : c->nspans * nfds;
+        if (nwin + need > (int) (sizeof (windows) / sizeof (windows[0])))
+        {
+            if (write_raw_binary_batch (batch, nwin, windows) != SUCCESS)
+            {
+                sprintf (errmsg, "Writing lines %d-%d of the bands",
+                    block->line0 + pend_line0, block->line0 + bl - 1);
+                error_handler (true, FUNC_NAME, errmsg);
+                return (ERROR);
+            }
+            nwin = 0;
+        }
+        if (nwin == 0)
+            pend_line0 = bl;
+
+        if (c->nspans == 1 && c->samp0[0] == 0 && c->nsamps[0] == nsamps)
+        {
+            /* Extend the run over the following full-width lines */
+            while (run_end < block->nlines &&
+                changes[run_end].nspans == 1 &&
+                changes[run_end].samp0[0] == 0 &&
+                changes[run_end].nsamps[0] == nsamps)
+            {
+                *nfilled += changes[run_end].nfilled;
+                run_end++;
+            }
+
+            for (i = 0; i < nfds; i++)
+            {
+                win = &windows[nwin++];
+                win->fd = fd[i];
+                win->band_nsamps = nsamps;
+                win->line0 = block->line0 + bl;
+                win->nlines = run_end - bl;
+                win->samp0 = 0;
+                win->nsamps = nsamps;
+                win->size = size[i];
+                win->img_array = (char *) block->band_buf[i] +
+                    (size_t) bl * block->line_stride * size[i];
+            }
+            *nwritten += (long) (run_end - bl) * nsamps;
+        }
+        else
+        {
+            for (sp = 0; sp < c->nspans; sp++)
+            {
+                for (i = 0; i < nfds; i++)
+                {
+                    win = &windows[nwin++];
+                    win->fd = fd[i];
+                    win->band_nsamps = nsamps;
+                    win->line0 = block->line0 + bl;
+                    win->nlines = 1;
+                    win->samp0 = c->samp0[sp];
+                    win->nsamps = c->nsamps[sp];
+                    win->size = size[i];
+                    win->img_array = (char *) block->band_buf[i] +
+                        ((size_t) bl * block->line_stride + c->samp0[sp]) *
+                        size[i];
+                }
+                *nwritten += c->nsamps[sp];
+            }
+        }
+    }
+
+    /* Submit the windows of the block */
+    if (nwin > 0 && write_raw_binary_batch (batch, nwin, windows) != SUCCESS)
+    {
+        sprintf (errmsg, "Writing lines %d-%d of the bands",
+            block->line0 + pend_line0, block->line0 + block->nlines - 1);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  find_line_extent
+
+PURPOSE: Finds the first and last valid sample of a clipped line from its
+band quality, for the footprint index.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. After the fill merge a pixel is fill in every band exactly when its band
+     quality is BQA_FILL, so only the band quality needs to be tested.  The
+     line is scanned in from each end, which stops at the edges of the
+     image data rather than visiting the whole line.
+******************************************************************************/
+static void find_line_extent
+(
+    int nsamps,                 /* I: number of samples in the line */
+    const uint16_t *bqa_buf,    /* I: clipped line of the band quality band */
+    int32_t *extent             /* O: first and last valid sample of the line;
+                                      ESPA_FOOTPRINT_EMPTY_FIRST/LAST if there
+                                      are none */
+)
+{
+    int first;                  /* first valid sample */
+    int last;                   /* last valid sample */
+
+    for (first = 0; first < nsamps; first++)
+    {
+        if (bqa_buf[first] != BQA_FILL)
+            break;
+    }
+    if (first == nsamps)
+    {
+        extent[0] = ESPA_FOOTPRINT_EMPTY_FIRST;
+        extent[1] = ESPA_FOOTPRINT_EMPTY_LAST;
+        return;
+    }
+
+    for (last = nsamps - 1; last > first; last--)
+    {
+        if (bqa_buf[last] != BQA_FILL)
+            break;
+    }
+    extent[0] = first;
+    extent[1] = last;
+}
+
+
+/******************************************************************************
+MODULE:  clip_block_line
+
+PURPOSE: Clips a line of a block of the bands, as an iteration of the loop
+over the lines of the block.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+SUCCESS         Always
+
+NOTES:
+  1. Each line only depends on itself, so the lines are clipped at the same
+     time.
+******************************************************************************/
+static int clip_block_line
+(
+    void *arg,                /* I/O: block of lines being clipped */
+    int bl,                   /* I: line within the block */
+    int worker                /* I: index of the worker (unused) */
+)
+{
+    Clip_block_t *clip = arg; /* block of lines being clipped */
+    Espa_band_block_t *block = clip->block;  /* block of lines */
+    void *file_buf[MAX_CLIP_BANDS];  /* current line of each band within the
+                                 block */
+    uint16_t *bqa_buf = NULL; /* current line of band quality data */
+    int i;                    /* looping variable for the bands */
+
+    /* Point to the current line of each band within the block */
+    for (i = 0; i < clip->nbands; i++)
+        file_buf[i] = (char *) block->band_buf[i] +
+            (size_t) bl * block->line_stride * clip->band_size;
+    bqa_buf = (uint16_t *) block->band_buf[clip->nbands] +
+        (size_t) bl * block->line_stride;
+
+    if (clip->band_size == sizeof (uint8_t))
+        clip_fill_uint8 (clip->nbands, clip->nsamps, (uint8_t **) file_buf,
+            bqa_buf, &clip->changes[bl]);
+    else
+        clip_fill_uint16 (clip->nbands, clip->nsamps, (uint16_t **) file_buf,
+            bqa_buf, &clip->changes[bl]);
+
+    find_line_extent (clip->nsamps, bqa_buf,
+        &clip->extent[2 * (size_t) (block->line0 + bl)]);
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  count_qa_bits
+
+PURPOSE: Adds the number of pixels with each of the cover bits set in a run
+of band quality pixels to their counts.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. Each bit is counted as the sum of the bit shifted down to the low bit,
+     a popcount of the bit plane which the compiler vectorizes across the
+     pixels.  The pixels are counted CLIP_QA_RUN at a time so the run stays
+     in the L1 cache for all the bits.
+******************************************************************************/
+static void count_qa_bits
+(
+    const uint16_t *qa,       /* I: band quality pixels */
+    size_t npixels,           /* I: number of pixels */
+    uint64_t *counts          /* I/O: number of pixels with each bit set */
+)
+{
+    size_t start;             /* first pixel of the run */
+    size_t end;               /* one past the last pixel of the run */
+    size_t p;                 /* looping variable for the pixels */
+    uint32_t sum;             /* pixels of the run with the bit set */
+    int b;                    /* looping variable for the bits */
+
+    for (start = 0; start < npixels; start = end)
+    {
+        end = npixels - start > CLIP_QA_RUN ? start + CLIP_QA_RUN : npixels;
+        for (b = 0; b < CLIP_QA_COVER_BITS; b++)
+        {
+            sum = 0;
+            for (p = start; p < end; p++)
+                sum += (qa[p] >> b) & 1;
+            counts[b] += sum;
+        }
+    }
+}
+
+
+/******************************************************************************
+MODULE:  set_qa_percent_cover
+
+PURPOSE: Records the percentage of the pixels with each of the cover bits set
+as the percent_coverage of the band quality band.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error allocating the cover types
+SUCCESS         Successfully recorded the percentages
+
+NOTES:
+  1. Bits the bitmap_description of the band marks as "Not used" (ex. cirrus
+     for TM and ETM+) are left out.
+  2. Fill pixels only have the fill bit set, so the pixels which aren't fill
+     are the total less the fill count.
+******************************************************************************/
+static int set_qa_percent_cover
+(
+    Espa_band_meta_t *bmeta,  /* I/O: metadata of the band quality band */
+    const uint64_t *counts    /* I: number of pixels with each bit set */
+)
+{
+    char FUNC_NAME[] = "set_qa_percent_cover";  /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    int b;                    /* looping variable for the bits */
+    int ncover = 0;           /* number of cover types recorded */
+    uint64_t npixels;         /* number of pixels in the band */
+    uint64_t nvalid;          /* number of pixels which aren't fill */
+    uint64_t total;           /* pixels the percentage is of */
+
+    npixels = (uint64_t) bmeta->nlines * bmeta->nsamps;
+    nvalid = npixels - counts[0];
+
+    for (b = 0; b < CLIP_QA_COVER_BITS; b++)
+    {
+        if (b >= bmeta->nbits || strcmp (bmeta->bitmap_description[b],
+            "Not used"))
+            ncover++;
+    }
+    if (allocate_percent_coverage_metadata (bmeta, ncover) != SUCCESS)
+    {
+        sprintf (errmsg, "Allocating the cover types of band %s",
+            bmeta->name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    ncover = 0;
+    for (b = 0; b < CLIP_QA_COVER_BITS; b++)
+    {
+        if (b < bmeta->nbits && !strcmp (bmeta->bitmap_description[b],
+            "Not used"))
+            continue;
+        total = b == 0 ? npixels : nvalid;
+        bmeta->percent_cover[ncover].percent = total == 0 ? 0.0 :
+            100.0 * counts[b] / total;
+        strcpy (bmeta->percent_cover[ncover].description, clip_qa_cover[b]);
+        ncover++;
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  add_block_stats
+
+PURPOSE: Adds the clipped pixels of a block to the statistics of a band, as
+an iteration of the loop over the bands.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+SUCCESS         Always
+
+NOTES:
+  1. The blocks are full width, so the lines of each band are contiguous.
+  2. The cover bits of the band quality band are counted along with its
+     statistics, while the block is in the cache.
+******************************************************************************/
+static int add_block_stats
+(
+    void *arg,                /* I/O: block of lines which was clipped */
+    int i,                    /* I: band within the block, with the band
+                                    quality band last */
+    int worker                /* I: index of the worker (unused) */
+)
+{
+    Clip_block_t *clip = arg; /* block of lines which was clipped */
+
+    update_raw_binary_stats (clip->stats[i], clip->block->band_buf[i],
+        (size_t) clip->block->nlines * clip->nsamps);
+    if (i == clip->nbands)
+        count_qa_bits (clip->block->band_buf[i],
+            (size_t) clip->block->nlines * clip->nsamps, clip->qa_counts);
+
+    return (SUCCESS);
+}
+
+/******************************************************************************
+MODULE:  clip_block_lines
+
+PURPOSE: Determines the number of lines per block for clipping a set of image
+bands and their band quality band.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+n               Number of lines per block
+
+NOTES:
+  1. The number of lines is chosen so a block of all the bands holds about
+     CLIP_BLOCK_BYTES, but no fewer than RB_PREFETCH_DEFAULT_LINES lines and
+     no more than the lines of the bands.
+******************************************************************************/
+int clip_block_lines
+(
+    Espa_internal_meta_t *xml_metadata, /* I: XML metadata structure */
+    int nbands,             /* I: number of image bands to be clipped */
+    int *band_index,        /* I: metadata index of each image band, followed
+                                  by the band quality band (nbands + 1
+                                  entries) */
+    int band_size           /* I: bytes per pixel of the image bands (1 for
+                                  uint8, 2 for uint16) */
+)
+{
+    int block_lines;          /* number of lines per block */
+    size_t line_bytes;        /* bytes in one line of all the bands */
+    Espa_band_meta_t *bmeta = &xml_metadata->band[band_index[0]];
+                              /* metadata of the first image band */
+
+    line_bytes = (size_t) bmeta->nsamps *
+        (nbands * band_size + sizeof (uint16_t));
+    block_lines = RB_PREFETCH_DEFAULT_LINES;
+    if (line_bytes > 0 && CLIP_BLOCK_BYTES / line_bytes > (size_t) block_lines)
+        block_lines = CLIP_BLOCK_BYTES / line_bytes;
+    if (block_lines > bmeta->nlines)
+        block_lines = bmeta->nlines;
+    if (block_lines < 1)
+        block_lines = 1;
+
+    return block_lines;
+}
+
+
+/******************************************************************************
+MODULE:  open_clip_stage
+
+PURPOSE: Starts clipping a set of image bands and their band quality band,
+for the blocks of lines handed to clip_stage_block by a traversal of the
+bands.
+
+RETURN VALUE:
+Type = Clip_stage_t *
+Value           Description
+-----           -----------
+NULL            Error starting the clipping
+non-NULL        Clipping of the bands
+
+NOTES:
+  1. The bands are opened for updating, since the changed parts of each
+     block are written back to them.
+  2. The caller reads the blocks, and has them skip the statistics of the
+     clipped bands (see skip_band_stack_stats), since the clipping computes
+     the statistics of the clipped pixels.
+******************************************************************************/
+Clip_stage_t *open_clip_stage
+(
+    Espa_internal_meta_t *xml_metadata, /* I: XML metadata structure */
+    int nbands,             /* I: number of image bands to be clipped */
+    int *band_index,        /* I: metadata index of each image band, followed
+                                  by the band quality band (nbands + 1
+                                  entries) */
+    int band_size,          /* I: bytes per pixel of the image bands (1 for
+                                  uint8, 2 for uint16) */
+    int block_lines         /* I: most lines in a block handed to
+                                  clip_stage_block */
+)
+{
+    char FUNC_NAME[] = "open_clip_stage";  /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    int i;                    /* looping variable */
+    Clip_stage_t *stage = NULL;  /* clipping of the bands */
+    Espa_band_meta_t *bmeta = xml_metadata->band;  /* array of band metadata */
+
+    if (nbands < 1 || nbands > MAX_CLIP_BANDS)
+    {
+        sprintf (errmsg, "Invalid number of bands to clip: %d", nbands);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (NULL);
+    }
+
+    stage = calloc (1, sizeof (Clip_stage_t));
+    if (stage == NULL)
+    {
+        sprintf (errmsg, "Allocating the clipping of the bands");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (NULL);
+    }
+    stage->xml_metadata = xml_metadata;
+    stage->nbands = nbands;
+    stage->band_size = band_size;
+    stage->nsamps = bmeta[band_index[0]].nsamps;
+    stage->block_lines = block_lines;
+    for (i = 0; i <= nbands; i++)
+    {
+        stage->band_index[i] = band_index[i];
+        stage->size[i] = i < nbands ? band_size : sizeof (uint16_t);
+        stage->fd[i] = -1;
+    }
+
+    /* Make sure the bands are the data types being clipped */
+    for (i = 0; i <= nbands; i++)
+    {
+        if (espa_data_type_size (bmeta[band_index[i]].data_type) !=
+            stage->size[i])
+        {
+            if (i < nbands)
+                sprintf (errmsg, "Band %s is not of the expected data type",
+                    bmeta[band_index[i]].name);
+            else
+                sprintf (errmsg, "The band quality band is not uint16");
+            error_handler (true, FUNC_NAME, errmsg);
+            free_clip_stage (stage);
+            return (NULL);
+        }
+    }
+
+    stage->changes = calloc (block_lines, sizeof (Clip_fill_changes_t));
+    if (stage->changes == NULL)
+    {
+        sprintf (errmsg, "Allocating memory for the changes of the lines");
+        error_handler (true, FUNC_NAME, errmsg);
+        free_clip_stage (stage);
+        return (NULL);
+    }
+
+    stage->extent = malloc (2 * (size_t) bmeta[band_index[0]].nlines *
+        sizeof (int32_t));
+    if (stage->extent == NULL)
+    {
+        sprintf (errmsg, "Allocating memory for the extents of the lines");
+        error_handler (true, FUNC_NAME, errmsg);
+        free_clip_stage (stage);
+        return (NULL);
+    }
+
+    /* Open the bands and the band quality band for updating, and start the
+       statistics of their clipped pixels */
+    for (i = 0; i <= nbands; i++)
+    {
+        stage->fd[i] = open_raw_binary_band_fd (bmeta[band_index[i]].file_name,
+            bmeta[band_index[i]].file_offset, true);
+        if (stage->fd[i] == ERROR)
+        {
+            stage->fd[i] = -1;
+            sprintf (errmsg, "Opening the raw binary file: %s",
+                bmeta[band_index[i]].file_name);
+            error_handler (true, FUNC_NAME, errmsg);
+            free_clip_stage (stage);
+            return (NULL);
+        }
+
+        stage->stats[i] = open_raw_binary_stats (&bmeta[band_index[i]]);
+        if (stage->stats[i] == NULL)
+        {
+            sprintf (errmsg, "Starting the statistics of band %s",
+                bmeta[band_index[i]].name);
+            error_handler (true, FUNC_NAME, errmsg);
+            free_clip_stage (stage);
+            return (NULL);
+        }
+    }
+
+    /* Set up the batched writes of each block back out to the bands */
+    if (init_raw_binary_batch (nbands + 1, &stage->batch) != SUCCESS)
+    {
+        sprintf (errmsg, "Initializing the batched writes of the bands");
+        error_handler (true, FUNC_NAME, errmsg);
+        free_clip_stage (stage);
+        return (NULL);
+    }
+    stage->batch_open = true;
+
+    return (stage);
+}
+
+
+/******************************************************************************
+MODULE:  clip_stage_block
+
+PURPOSE: Clips a block of lines of the image bands and their band quality
+band in place, and writes the changed parts back out to the bands.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error clipping the block
+SUCCESS         Successfully clipped the block
+
+NOTES:
+  1. The block holds the bands in the order given to open_clip_stage, with
+     the band quality band last.  It is a full width block of no more than
+     the block_lines given to open_clip_stage.
+  2. When built with ENABLE_THREADING, the lines of the block are clipped on
+     the task pool (see espa_task_pool.h).  Each line only depends on
+     itself, so the output is the same for any number of threads.
+******************************************************************************/
+int clip_stage_block
+(
+    Clip_stage_t *stage,      /* I/O: clipping of the bands */
+    Espa_band_block_t *block  /* I/O: block of lines of the bands, clipped on
+                                      return */
+)
+{
+    char FUNC_NAME[] = "clip_stage_block";  /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    Clip_block_t clip;        /* block of lines being clipped */
+
+    if (block->nlines > stage->block_lines || block->samp0 != 0 ||
+        block->nsamps != stage->nsamps)
+    {
+        sprintf (errmsg, "Lines %d-%d are not a full width block of at most "
+            "%d lines", block->line0, block->line0 + block->nlines - 1,
+            stage->block_lines);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* The lines of the block are independent of each other, so they are
+       clipped in parallel when threading is enabled */
+    clip.nbands = stage->nbands;
+    clip.nsamps = stage->nsamps;
+    clip.band_size = stage->band_size;
+    clip.block = block;
+    clip.changes = stage->changes;
+    clip.extent = stage->extent;
+    clip.stats = stage->stats;
+    clip.qa_counts = stage->qa_counts;
+    espa_parallel_for (block->nlines, 0, clip_block_line, &clip);
+    espa_parallel_for (stage->nbands + 1, 0, add_block_stats, &clip);
+
+    /* Write the changed parts of the block back out for each band and the
+       band quality band */
+    if (write_clip_changes (&stage->batch, block, stage->nbands + 1,
+        stage->fd, stage->size, stage->nsamps, stage->changes,
+        &stage->nfilled, &stage->nwritten) != SUCCESS)
+    {
+        sprintf (errmsg, "Writing the clipped lines %d-%d",
+            block->line0, block->line0 + block->nlines - 1);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  close_clip_stage
+
+PURPOSE: Finishes clipping the bands once all their blocks have been clipped,
+recording the footprint, statistics, and band quality cover of the clipped
+bands in their metadata, and frees the clipping.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error finishing the clipping
+SUCCESS         Successfully finished the clipping, or it was only freed
+
+NOTES:
+  1. The first and last valid sample of each clipped line are written to the
+     footprint index <product_id>ESPA_FOOTPRINT_SUFFIX, which is set as the
+     footprint_file of the clipped bands and the band quality band.  The
+     footprint polygon of the scene is traced from the same extents (see
+     generate_footprint_polygon.h) and set as the footprint of the global
+     metadata.  The caller writes the XML to record them.
+  2. The statistics of the clipped bands and the band quality band (see
+     raw_binary_stats.h) are recorded in their metadata, so they describe
+     the clipped pixels.  Their checksums no longer match and are cleared.
+  3. The percentages of the fill, cloud, snow, and other single-bit flags of
+     the band quality band are recorded as its percent_coverage, replacing
+     any cover types it had.
+  4. With finish false, as when the traversal failed, the clipping is only
+     freed and the metadata is left alone.
+******************************************************************************/
+int close_clip_stage
+(
+    Clip_stage_t *stage,      /* I: clipping of the bands; freed on return */
+    bool finish               /* I: were all the blocks clipped, so the
+                                    metadata is to be recorded? */
+)
+{
+    char FUNC_NAME[] = "close_clip_stage";  /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    char footprint_file[STR_SIZE]; /* name of the footprint index */
+    int i;                    /* looping variable */
+    int count;                /* number of chars copied in snprintf */
+    int nbands;               /* number of image bands */
+    int *band_index;          /* metadata index of each band */
+    Espa_internal_meta_t *xml_metadata;  /* XML metadata structure */
+    Espa_band_meta_t *bmeta;  /* array of band metadata */
+
+    if (stage == NULL)
+        return (SUCCESS);
+    if (!finish)
+    {
+        free_clip_stage (stage);
+        return (SUCCESS);
+    }
+    xml_metadata = stage->xml_metadata;
+    nbands = stage->nbands;
+    band_index = stage->band_index;
+    bmeta = xml_metadata->band;
+
+    /* Write the footprint index of the clipped bands and reference it from
+       their metadata */
+    count = snprintf (footprint_file, sizeof (footprint_file), "%s%s",
+        xml_metadata->global.product_id, ESPA_FOOTPRINT_SUFFIX);
+    if (count < 0 || count >= sizeof (footprint_file))
+    {
+        sprintf (errmsg, "Overflow of footprint_file string");
+        error_handler (true, FUNC_NAME, errmsg);
+        free_clip_stage (stage);
+        return (ERROR);
+    }
+    if (write_footprint (footprint_file, bmeta[band_index[0]].nlines,
+        stage->extent) != SUCCESS)
+    {
+        sprintf (errmsg, "Writing the footprint index of the bands");
+        error_handler (true, FUNC_NAME, errmsg);
+        free_clip_stage (stage);
+        return (ERROR);
+    }
+    for (i = 0; i <= nbands; i++)
+        strcpy (bmeta[band_index[i]].footprint_file, footprint_file);
+
+    /* Outline the valid pixels from the extents, for the catalog */
+    if (generate_footprint_polygon (&xml_metadata->global,
+        &bmeta[band_index[0]], stage->extent) != SUCCESS)
+    {
+        sprintf (errmsg, "Generating the footprint polygon of the bands");
+        error_handler (true, FUNC_NAME, errmsg);
+        free_clip_stage (stage);
+        return (ERROR);
+    }
+
+    /* Record the statistics of the clipped bands, which no longer have the
+       pixels of their checksums or overviews */
+    for (i = 0; i <= nbands; i++)
+    {
+        finish_raw_binary_stats (stage->stats[i],
+            &bmeta[band_index[i]].stats);
+        strcpy (bmeta[band_index[i]].checksum, ESPA_STRING_META_FILL);
+        strcpy (bmeta[band_index[i]].overview_file, ESPA_STRING_META_FILL);
+        bmeta[band_index[i]].overview_levels = 0;
+    }
+    if (set_qa_percent_cover (&bmeta[band_index[nbands]], stage->qa_counts)
+        != SUCCESS)
+    {  /* Error messages already written */
+        free_clip_stage (stage);
+        return (ERROR);
+    }
+
+    printf ("INFO: %ld pixels were newly filled; %ld of %ld samples of each "
+        "band were written back\n", stage->nfilled, stage->nwritten,
+        (long) bmeta[band_index[0]].nlines * stage->nsamps);
+
+    /* Stop the batched writes, and close the bands */
+    free_clip_stage (stage);
+
+    return (SUCCESS);
+}
+
 
 /******************************************************************************
-MODULE:  clip_band_misalignment
+MODULE:  clip_band_blocks
 
-PURPOSE: Clips bands 1-7 and the thermal band to clean up the band
-  misalignment.  Any pixel that is fill in one band will be fill in all bands.
+PURPOSE: Clips a set of image bands and their band quality band in place, so
+any pixel that is fill in one band will be fill in all bands, and is flagged
+as fill in the band quality band.
 
 RETURN VALUE:
 Type = int
@@ -35,119 +905,185 @@ ERROR           Error clipping bands
 SUCCESS         Successfully clipped bands
 
 NOTES:
-  1. Bands 1-7 and the thermal bands will be clipped so that the alignment of
-     all bands match.  The quality band will be updated to mark fill pixels due
-     to the band clipping.
-  2. This only applies to TM and ETM+ products, thus any other sensors will
-     simply be returned as-is.
-  3. This is meant to be run on the Level-1 raw binary dataset.
+  1. The bands are traversed as blocks of lines holding every band, which are
+     read ahead in the background by the band stack.  Each band is thus read
+     with one request per block rather than one seek and transfer per line.
+     Each block is clipped by clip_stage_block, and the clipping is finished
+     by close_clip_stage.  A caller with other steps to run on the same
+     blocks (ex. process_level1) drives the clipping stage itself.
+  2. Only the spans of samples where some pixel was newly filled are written
+     back, by write_clip_changes.  Most of a scene is left unchanged by the
+     clipping (the changes are along the image edges), so most of the writes
+     are skipped.  The number of pixels filled is reported.
+  3. The number of lines per block is given by clip_block_lines.
+  4. Pixels which are flagged as fill in the band quality band are also set
+     to fill in all the bands.  Technically if the band quality is set to
+     fill, then one of the bands should have been flagged as fill.  However,
+     we have found a few cases where the band quality is set to fill and none
+     of the bands are fill.
+  5. The statistics, footprint, and band quality cover of the clipped bands
+     are recorded in their metadata (see close_clip_stage).  The caller
+     writes the XML to record them.
 ******************************************************************************/
-int clip_band_misalignment
+int clip_band_blocks
 (
-    Espa_internal_meta_t *xml_metadata  /* I: XML metadata structure populated
-                                              from an ESPA XML file */
+    Espa_internal_meta_t *xml_metadata, /* I: XML metadata structure */
+    int nbands,             /* I: number of image bands to be clipped */
+    int *band_index,        /* I: metadata index of each image band, followed
+                                  by the band quality band (nbands + 1
+                                  entries) */
+    int band_size           /* I: bytes per pixel of the image bands (1 for
+                                  uint8, 2 for uint16) */
 )
 {
-    char FUNC_NAME[] = "clip_band_misalignment";  /* function name */
+    char FUNC_NAME[] = "clip_band_blocks";  /* function name */
     char errmsg[STR_SIZE];    /* error message */
-    char curr_band[STR_SIZE]; /* current band to process */
-    int i;                    /* looping variable */
-    int l, s;                 /* line, sample looping variable */
-    int bnd_count;            /* count of bands to process */
-    int bnd;                  /* current band to process */
-    int nlines = -99;         /* number of lines in the bands */
-    int nsamps = -99;         /* number of samples in the bands */
-    int band_options[NBAND_OPTIONS] = {1, 2, 3, 4, 5, 6, 61, 62, 7};
-                              /* various bands that will be used for clipping */
-    bool fill;                /* is the current pixel fill */
-    uint8_t *tmp_file_buf = NULL; /* overall buffer for uint8 input band data */
-    uint8_t *file_buf[NBAND_OPTIONS]; /* buffer for uint8 input band data one
-                                         for each band */
-    uint16_t *bqa_buf = NULL; /* buffer for band quality data */
-    Espa_global_meta_t *gmeta = NULL; /* pointer to global metadata structure */
-    Espa_band_meta_t *bmeta = NULL;   /* pointer to array of bands metadata */
-    FILE *fp_rb[NBAND_OPTIONS];  /* file pointer for the bands */
-    FILE *fp_bqa = NULL;         /* file pointer for the band quality band */
-
-    /* Set up the global and band metadata pointers */
-    gmeta = &(xml_metadata->global);
-    bmeta = xml_metadata->band;
+    int block_lines;          /* number of lines per block */
+    Clip_stage_t *stage = NULL;      /* clipping of the bands */
+    Espa_band_stack_t *stack = NULL; /* band stack which reads ahead the
+                              lines of all the bands */
+    Espa_band_block_t *block = NULL; /* current block of lines */
 
-    /* Only process TM and ETM+ bands */
-    if (strcmp (gmeta->instrument, "TM") && strcmp (gmeta->instrument, "ETM"))
+    if (nbands < 1 || nbands > MAX_CLIP_BANDS)
     {
-        sprintf (errmsg, "Only TM and ETM+ will be processed for band "
-            "misalignment.  All other instruments are passed back as-is.");
-        error_handler (false, FUNC_NAME, errmsg);
-        return (SUCCESS);
+        sprintf (errmsg, "Invalid number of bands to clip: %d", nbands);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
     }
 
-    /* Loop through the bands and open bands 1-7 and the thermal bands */
-    bnd_count = 0;
-    for (i = 0; i < xml_metadata->nbands; i++)
+    block_lines = clip_block_lines (xml_metadata, nbands, band_index,
+        band_size);
+    stage = open_clip_stage (xml_metadata, nbands, band_index, band_size,
+        block_lines);
+    if (stage == NULL)
     {
-        for (bnd = 0; bnd < NBAND_OPTIONS; bnd++)
-        {
-            /* Is the current band in the metadata one of our expected bands */
-            sprintf (curr_band, "b%d", band_options[bnd]);
-            if (!strcmp (bmeta[i].name, curr_band))
-            {
-                /* Open the band file */
-                fp_rb[bnd_count] = open_raw_binary (bmeta[i].file_name, "r+");
-                if (fp_rb[bnd_count] == NULL)
-                {
-                    sprintf (errmsg, "Opening the raw binary file: %s",
-                        bmeta[i].file_name);
-                    error_handler (true, FUNC_NAME, errmsg);
-                    return (ERROR);
-                }
+        sprintf (errmsg, "Starting the clipping of the bands");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
 
-                /* If this is the first band then store the image size */
-                if (bnd == 0)
-                {
-                    nlines = bmeta[i].nlines;
-                    nsamps = bmeta[i].nsamps;
-                }
+    /* Start reading ahead all the bands plus the band quality band, which
+       is kept as the last band in the stack.  The statistics are of the
+       clipped pixels, rather than the pixels the band stack reads. */
+    stack = open_band_stack (xml_metadata, nbands + 1, band_index,
+        block_lines, 0);
+    if (stack == NULL)
+    {
+        sprintf (errmsg, "Starting the read-ahead of the bands");
+        error_handler (true, FUNC_NAME, errmsg);
+        close_clip_stage (stage, false);
+        return (ERROR);
+    }
+    skip_band_stack_stats (stack);
 
-                /* Increment the band count and goto the next metadata band */
-                bnd_count++;
-                break;
-            }
+    /* Loop through the blocks of lines, which are read in the background
+       while the previous block is processed.  The changes to each block
+       are written back before the next block is processed. */
+    while (1)
+    {
+        if (get_band_stack_block (stack, &block) != SUCCESS)
+        {
+            sprintf (errmsg, "Reading the next block of lines");
+            error_handler (true, FUNC_NAME, errmsg);
+            close_band_stack (stack);
+            close_clip_stage (stage, false);
+            return (ERROR);
         }
+        if (block == NULL)
+            break;   /* all lines have been processed */
 
-        /* Is this the quality band */
-        sprintf (curr_band, "qa_pixel");
-        if (!strcmp (bmeta[i].name, curr_band))
-        {
-            fp_bqa = open_raw_binary (bmeta[i].file_name, "r+");
-            if (fp_bqa == NULL)
-            {
-                sprintf (errmsg, "Opening the quality band binary file: %s",
-                    bmeta[i].file_name);
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
-            }
+        if (clip_stage_block (stage, block) != SUCCESS)
+        {  /* Error messages already written */
+            close_band_stack (stack);
+            close_clip_stage (stage, false);
+            return (ERROR);
         }
-    }
+    }  /* while blocks */
 
-    /* Validate the band count TM - 7 bands and ETM+ - 8 bands */
-    if (!strcmp (gmeta->instrument, "TM") && (bnd_count != 7))
+    /* Stop the read-ahead, and record the clipping in the metadata */
+    close_band_stack (stack);
+    if (close_clip_stage (stage, true) != SUCCESS)
     {
-        sprintf (errmsg, "Expecting 7 TM bands, but only %d bands found.",
-            bnd_count);
+        sprintf (errmsg, "Finishing the clipping of the bands");
         error_handler (true, FUNC_NAME, errmsg);
         return (ERROR);
     }
-    else if (!strcmp (gmeta->instrument, "ETM") && (bnd_count != 8))
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  find_clip_bands
+
+PURPOSE: Finds the image bands to be clipped and the band quality band in the
+metadata.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           The first band option or the band quality band wasn't found
+SUCCESS         Successfully found the bands
+
+NOTES:
+  1. The image bands are returned in the order of the metadata, followed by
+     the band quality band, as expected by clip_band_blocks.  The caller
+     validates the number of image bands found for its instrument.
+******************************************************************************/
+int find_clip_bands
+(
+    Espa_internal_meta_t *xml_metadata, /* I: XML metadata structure */
+    int nband_options,      /* I: number of band options */
+    const int *band_options, /* I: band numbers to be clipped, if present */
+    int *band_index,        /* O: metadata index of each image band found,
+                                  followed by the band quality band
+                                  (nband_options + 1 entries) */
+    int *nbands             /* O: number of image bands found */
+)
+{
+    char FUNC_NAME[] = "find_clip_bands";  /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    char curr_band[STR_SIZE]; /* current band to process */
+    int i;                    /* looping variable */
+    int bnd_count;            /* count of bands to process */
+    int bnd;                  /* current band to process */
+    int found;                /* metadata index of the current band */
+    int first_band = -1;      /* metadata index of the first band option */
+    int bqa_index;            /* metadata index of the band quality band */
+
+    /* Look up each band option, keeping the bands found in the order of the
+       metadata */
+    bnd_count = 0;
+    for (bnd = 0; bnd < nband_options; bnd++)
     {
-        sprintf (errmsg, "Expecting 8 ETM+ bands, but only %d bands found.",
-            bnd_count);
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
+        sprintf (curr_band, "b%d", band_options[bnd]);
+        found = espa_find_band (xml_metadata, curr_band);
+        if (found < 0)
+            continue;
+
+        /* If this is the first band then note it for the image size */
+        if (bnd == 0)
+            first_band = found;
+
+        /* Skip a repeated option */
+        for (i = 0; i < bnd_count && band_index[i] != found; i++)
+            ;
+        if (i < bnd_count)
+            continue;
+
+        /* Insert the band in metadata order */
+        for (i = bnd_count; i > 0 && band_index[i-1] > found; i--)
+            band_index[i] = band_index[i-1];
+        band_index[i] = found;
+        bnd_count++;
     }
 
+    /* Find the quality band */
+    bqa_index = espa_find_band (xml_metadata, "qa_pixel");
+
     /* Validate the nlines/nsamps */
-    if (nlines == -99 || nsamps == -99)
+    if (first_band == -1)
     {
         sprintf (errmsg, "nlines and/or nsamps are not valid");
         error_handler (true, FUNC_NAME, errmsg);
@@ -155,160 +1091,191 @@ int clip_band_misalignment
     }
 
     /* Make sure the quality band was found */
-    if (fp_bqa == NULL)
+    if (bqa_index == -1)
     {
         sprintf (errmsg, "Unable to find the band quality band");
         error_handler (true, FUNC_NAME, errmsg);
         return (ERROR);
     }
 
-    /* Allocate one line of data for each band */
-    tmp_file_buf = calloc (nsamps * bnd_count, sizeof (uint8_t));
-    if (tmp_file_buf == NULL)
+    band_index[bnd_count] = bqa_index;
+    *nbands = bnd_count;
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  find_tm_clip_bands
+
+PURPOSE: Finds TM bands 1-7 or ETM+ bands 1-7 and the thermal bands to be
+clipped, and the band quality band.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error finding the bands, or the wrong number were found
+SUCCESS         Successfully found the bands
+
+NOTES:
+  1. The band quality band follows the image bands in band_index.
+******************************************************************************/
+int find_tm_clip_bands
+(
+    Espa_internal_meta_t *xml_metadata, /* I: XML metadata structure */
+    int *band_index,        /* O: metadata index of each image band, followed
+                                  by the band quality band (NBAND_OPTIONS + 1
+                                  entries) */
+    int *nbands             /* O: number of image bands found */
+)
+{
+    char FUNC_NAME[] = "find_tm_clip_bands";  /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    int bnd_count;            /* count of bands to process */
+    const int band_options[NBAND_OPTIONS] = {1, 2, 3, 4, 5, 6, 61, 62, 7};
+                              /* various bands that will be used for clipping */
+    Espa_global_meta_t *gmeta = &xml_metadata->global;  /* global metadata */
+
+    /* Find bands 1-7 and the thermal bands, with the band quality band
+       last */
+    if (find_clip_bands (xml_metadata, NBAND_OPTIONS, band_options, band_index,
+        &bnd_count) != SUCCESS)
     {
-        sprintf (errmsg, "Allocating memory for %d bands of uint8 data "
-            "containing %d samples.", bnd_count, nsamps);
+        sprintf (errmsg, "Finding the TM/ETM+ bands");
         error_handler (true, FUNC_NAME, errmsg);
         return (ERROR);
     }
 
-    /* Break the buffer into bands */
-    file_buf[0] = tmp_file_buf;
-    for (i = 1; i < bnd_count; i++)
-        file_buf[i] = file_buf[i-1] + nsamps;
-
-    /* Allocate one line of data for the band quality band */
-    bqa_buf = calloc (nsamps, sizeof (uint16_t));
-    if (bqa_buf == NULL)
+    /* Validate the band count TM - 7 bands and ETM+ - 8 bands */
+    if (!strcmp (gmeta->instrument, "TM") && (bnd_count != 7))
     {
-        sprintf (errmsg, "Allocating memory for band quality uint16 data "
-            "containing %d samples.", nsamps);
+        sprintf (errmsg, "Expecting 7 TM bands, but only %d bands found.",
+            bnd_count);
         error_handler (true, FUNC_NAME, errmsg);
         return (ERROR);
     }
-
-    /* Loop through the lines of data and process each file */
-    for (l = 0; l < nlines; l++)
+    else if (!strcmp (gmeta->instrument, "ETM") && (bnd_count != 8))
     {
-        /* Read the current line from each band */
-        for (i = 0; i < bnd_count; i++)
-        {
-            /* Seek to the correct position to read the current line */
-            if (fseek (fp_rb[i], l * nsamps * sizeof (uint8_t), SEEK_SET) == -1)
-            {   
-                sprintf (errmsg, "Not able to seek for line %d of raw binary "
-                    "file %d", l, i);
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
-            }
+        sprintf (errmsg, "Expecting 8 ETM+ bands, but only %d bands found.",
+            bnd_count);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
 
-            /* Read the line */
-            if (read_raw_binary (fp_rb[i], 1, nsamps, sizeof (uint8_t),
-                file_buf[i]) != SUCCESS)
-            {   
-                sprintf (errmsg, "Reading line %d of raw binary file %d", l, i);
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
-            }
-        }
+    *nbands = bnd_count;
+    return (SUCCESS);
+}
 
-        /* Seek to the correct position to read the current line */
-        if (fseek (fp_bqa, l * nsamps * sizeof (uint16_t), SEEK_SET) == -1)
-        {   
-            sprintf (errmsg, "Not able to seek for line %d of band quality "
-                "file", l);
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
 
-        /* Read the current line from the band quality band */
-        if (read_raw_binary (fp_bqa, 1, nsamps, sizeof (uint16_t), bqa_buf) !=
-            SUCCESS)
-        {   
-            sprintf (errmsg, "Reading line %d of band quality file", l);
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
+/******************************************************************************
+MODULE:  find_level1_clip_bands
 
-        /* Loop through all the pixels and assess if any are fill */
-        for (s = 0; s < nsamps; s++)
-        {
-            /* Check the current pixel for each band to be fill */
-            fill = false;
-            for (i = 0; i < bnd_count; i++)
-            {
-                /* Check for fill in the current band */
-                if (file_buf[i][s] == LEVEL1_FILL)
-                {
-                    fill = true;
-                    break;
-                }
-            }
+PURPOSE: Finds the image bands to be clipped and the band quality band for
+the instrument of the product.
 
-            /* If a fill pixel was found or this pixel is flagged as fill in
-               the band quality band, then set all bands to fill and set the
-               band quality to fill. Technically if the band quality is set to
-               fill, then one of the bands should have been flagged as fill.
-               However, we have found a few cases where the band quality is
-               set to fill and none of the bands are fill. That case is fixed
-               in the following code block. */
-            if (fill || (bqa_buf[s] == BQA_FILL))
-            {
-                for (i = 0; i < bnd_count; i++)
-                    file_buf[i][s] = LEVEL1_FILL;
-                bqa_buf[s] = BQA_FILL;  /* first bit set to 1 for fill */
-            }
-        }
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error finding the bands
+SUCCESS         Successfully found the bands, or the instrument isn't clipped
 
-        /* Write the current line for each band */
-        for (i = 0; i < bnd_count; i++)
-        {
-            /* Seek to the correct position to write the current line */
-            if (fseek (fp_rb[i], l * nsamps * sizeof (uint8_t), SEEK_SET) == -1)
-            {   
-                sprintf (errmsg, "Not able to seek for line %d of raw binary "
-                    "file %d", l, i);
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
-            }
+NOTES:
+  1. OLI and OLI/TIRS bands are found by find_landsat89_clip_bands, and TM
+     and ETM+ bands by find_tm_clip_bands.  For any other instrument nbands
+     is 0, since there is nothing to clip.
+******************************************************************************/
+int find_level1_clip_bands
+(
+    Espa_internal_meta_t *xml_metadata, /* I: XML metadata structure */
+    int *band_index,        /* O: metadata index of each image band, followed
+                                  by the band quality band (MAX_CLIP_BANDS +
+                                  1 entries) */
+    int *nbands,            /* O: number of image bands found; 0 if the
+                                  instrument isn't clipped */
+    int *band_size          /* O: bytes per pixel of the image bands */
+)
+{
+    Espa_global_meta_t *gmeta = &xml_metadata->global;  /* global metadata */
 
-            /* Write the current line back out to the file */
-            if (write_raw_binary (fp_rb[i], 1, nsamps, sizeof (uint8_t),
-                file_buf[i]) != SUCCESS)
-            {   
-                sprintf (errmsg, "Writing line %d of raw binary file %d", l, i);
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
-            }
-        }
+    *nbands = 0;
+    if (!strncmp (gmeta->instrument, "OLI", 3))
+    {
+        *band_size = sizeof (uint16_t);
+        return find_landsat89_clip_bands (xml_metadata, band_index, nbands);
+    }
+    else if (!strcmp (gmeta->instrument, "TM") ||
+             !strcmp (gmeta->instrument, "ETM"))
+    {
+        *band_size = sizeof (uint8_t);
+        return find_tm_clip_bands (xml_metadata, band_index, nbands);
+    }
 
-        /* Seek to the correct position to write the current line */
-        if (fseek (fp_bqa, l * nsamps * sizeof (uint16_t), SEEK_SET) == -1)
-        {   
-            sprintf (errmsg, "Not able to seek for line %d of band quality "
-                "file", l);
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
+    return (SUCCESS);
+}
 
-        /* Write the current line back out to the band quality file */
-        if (write_raw_binary (fp_bqa, 1, nsamps, sizeof (uint16_t), bqa_buf) !=
-            SUCCESS)
-        {   
-            sprintf (errmsg, "Writing line %d of band quality file", l);
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
-    }  /* for l in nlines */
 
-    /* Free the raw binary band buffer and the band quality band buffer */
-    free (tmp_file_buf);
-    free (bqa_buf);
+/******************************************************************************
+MODULE:  clip_band_misalignment
+
+PURPOSE: Clips bands 1-7 and the thermal band to clean up the band
+  misalignment.  Any pixel that is fill in one band will be fill in all bands.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error clipping bands
+SUCCESS         Successfully clipped bands
+
+NOTES:
+  1. Bands 1-7 and the thermal bands will be clipped so that the alignment of
+     all bands match.  The quality band will be updated to mark fill pixels due
+     to the band clipping.
+  2. This only applies to TM and ETM+ products, thus any other sensors will
+     simply be returned as-is.
+  3. This is meant to be run on the Level-1 raw binary dataset.
+******************************************************************************/
+int clip_band_misalignment
+(
+    Espa_internal_meta_t *xml_metadata  /* I: XML metadata structure populated
+                                              from an ESPA XML file */
+)
+{
+    char FUNC_NAME[] = "clip_band_misalignment";  /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    int bnd_count;            /* count of bands to process */
+    int band_index[NBAND_OPTIONS + 1];  /* metadata index of each band, with
+                              the band quality band last */
+    Espa_global_meta_t *gmeta = NULL; /* pointer to global metadata structure */
+
+    /* Set up the global metadata pointer */
+    gmeta = &(xml_metadata->global);
+
+    /* Only process TM and ETM+ bands */
+    if (strcmp (gmeta->instrument, "TM") && strcmp (gmeta->instrument, "ETM"))
+    {
+        sprintf (errmsg, "Only TM and ETM+ will be processed for band "
+            "misalignment.  All other instruments are passed back as-is.");
+        error_handler (false, FUNC_NAME, errmsg);
+        return (SUCCESS);
+    }
+
+    /* Find bands 1-7 and the thermal bands, with the band quality band
+       last */
+    if (find_tm_clip_bands (xml_metadata, band_index, &bnd_count) != SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
 
-    /* Close the data files */
-    for (i = 0; i < bnd_count; i++)
-        close_raw_binary (fp_rb[i]);
-    close_raw_binary (fp_bqa);
+    /* Clip the bands, with the band quality band last */
+    if (clip_band_blocks (xml_metadata, bnd_count, band_index,
+        sizeof (uint8_t)) != SUCCESS)
+    {
+        sprintf (errmsg, "Clipping the TM/ETM+ bands");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
 
     /* Successful conversion */
     return (SUCCESS);
@@ -22,6 +22,10 @@ NOTES:
 #include "espa_metadata.h"
 #include "parse_metadata.h"
 #include "raw_binary_io.h"
+#include "espa_band_stack.h"
+#include "espa_footprint.h"
+#include "generate_footprint_polygon.h"
+#include "clip_band_fill.h"
 
 /* Defines */
 #define NBAND_OPTIONS 9
@@ -29,7 +33,111 @@ NOTES:
 #define LEVEL1_FILL 0
 #define BQA_FILL 1
 
+/* Maximum number of image bands clipped together, and the number of bytes
+   of all the bands to hold in each block of lines */
+#define MAX_CLIP_BANDS NBAND_OPTIONS_L89
+#define CLIP_BLOCK_BYTES (4 * 1024 * 1024)
+
+/* Number of single-bit flags of the band quality band whose percentages are
+   recorded as its percent_coverage, and the number of pixels counted at a
+   time */
+#define CLIP_QA_COVER_BITS 8
+#define CLIP_QA_RUN 4096
+
+/* Clipping of the blocks of lines handed to it by a traversal of the bands
+   (see open_clip_stage) */
+typedef struct Clip_stage Clip_stage_t;
+
 /* Prototypes */
+int clip_block_lines
+(
+    Espa_internal_meta_t *xml_metadata, /* I: XML metadata structure */
+    int nbands,             /* I: number of image bands to be clipped */
+    int *band_index,        /* I: metadata index of each image band, followed
+                                  by the band quality band (nbands + 1
+                                  entries) */
+    int band_size           /* I: bytes per pixel of the image bands (1 for
+                                  uint8, 2 for uint16) */
+);
+
+Clip_stage_t *open_clip_stage
+(
+    Espa_internal_meta_t *xml_metadata, /* I: XML metadata structure */
+    int nbands,             /* I: number of image bands to be clipped */
+    int *band_index,        /* I: metadata index of each image band, followed
+                                  by the band quality band (nbands + 1
+                                  entries) */
+    int band_size,          /* I: bytes per pixel of the image bands (1 for
+                                  uint8, 2 for uint16) */
+    int block_lines         /* I: most lines in a block handed to
+                                  clip_stage_block */
+);
+
+int clip_stage_block
+(
+    Clip_stage_t *stage,      /* I/O: clipping of the bands */
+    Espa_band_block_t *block  /* I/O: block of lines of the bands, clipped on
+                                      return */
+);
+
+int close_clip_stage
+(
+    Clip_stage_t *stage,      /* I: clipping of the bands; freed on return */
+    bool finish               /* I: were all the blocks clipped, so the
+                                    metadata is to be recorded? */
+);
+
+int clip_band_blocks
+(
+    Espa_internal_meta_t *xml_metadata, /* I: XML metadata structure */
+    int nbands,             /* I: number of image bands to be clipped */
+    int *band_index,        /* I: metadata index of each image band, followed
+                                  by the band quality band (nbands + 1
+                                  entries) */
+    int band_size           /* I: bytes per pixel of the image bands (1 for
+                                  uint8, 2 for uint16) */
+);
+
+int find_clip_bands
+(
+    Espa_internal_meta_t *xml_metadata, /* I: XML metadata structure */
+    int nband_options,      /* I: number of band options */
+    const int *band_options, /* I: band numbers to be clipped, if present */
+    int *band_index,        /* O: metadata index of each image band found,
+                                  followed by the band quality band
+                                  (nband_options + 1 entries) */
+    int *nbands             /* O: number of image bands found */
+);
+
+int find_tm_clip_bands
+(
+    Espa_internal_meta_t *xml_metadata, /* I: XML metadata structure */
+    int *band_index,        /* O: metadata index of each image band, followed
+                                  by the band quality band (NBAND_OPTIONS + 1
+                                  entries) */
+    int *nbands             /* O: number of image bands found */
+);
+
+int find_landsat89_clip_bands
+(
+    Espa_internal_meta_t *xml_metadata, /* I: XML metadata structure */
+    int *band_index,        /* O: metadata index of each image band, followed
+                                  by the band quality band (NBAND_OPTIONS_L89
+                                  + 1 entries) */
+    int *nbands             /* O: number of image bands found */
+);
+
+int find_level1_clip_bands
+(
+    Espa_internal_meta_t *xml_metadata, /* I: XML metadata structure */
+    int *band_index,        /* O: metadata index of each image band, followed
+                                  by the band quality band (MAX_CLIP_BANDS +
+                                  1 entries) */
+    int *nbands,            /* O: number of image bands found; 0 if the
+                                  instrument isn't clipped */
+    int *band_size          /* O: bytes per pixel of the image bands */
+);
+
 int clip_band_misalignment
 (
     Espa_internal_meta_t *xml_metadata  /* I: XML metadata structure populated
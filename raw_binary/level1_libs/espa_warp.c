@@ -0,0 +1,3475 @@
+/*****************************************************************************
+FILE: espa_warp.c
+
+PURPOSE: Contains functions for warping an ESPA product to another
+projection (see espa_warp.h).
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The output is warped in tiles of WARP_TILE_LINES by WARP_TILE_SAMPS
+     pixels, with the tiles of a stripe run in parallel on the task pool.
+     Each tile maps its pixels to the input with the batched projection
+     transformations, interpolating inside a grid of exactly transformed
+     nodes wherever the grid is within the error bound (as for the
+     geolocation bands).
+  2. The input band is read into memory as 32-bit floats, so the tiles can
+     sample any part of it.  The 8 and 16-bit integer and 32-bit float bands
+     are supported; larger integers wouldn't survive the floats.  The
+     buffers are accounted against the memory budget (see espa_trace.h),
+     and an input band which doesn't fit in what is left of it is an error
+     rather than an allocation past the budget.
+  3. The pixels are resampled by kernels chosen once, when the program is
+     loaded, from the instruction sets of the CPU (see espa_cpu_dispatch.h).
+     The AVX2 kernels gather 8 pixels at a time; the narrower instruction
+     sets have no gathers, so they use the scalar kernels.  The vector
+     kernels compute in the same order as the scalar kernels, so the output
+     doesn't depend on the CPU.
+  4. An output pixel whose neighborhood is partly outside the input, or
+     holds fill, is taken from the nearest input pixel.  The pixels outside
+     the input are fill (0 for the bands without a fill value).
+  5. Run under MPI (see espa_mpi.h), the stripes of each output band are
+     split over the ranks, which write their stripes of the band file in
+     place.  Each rank still reads the whole input band.  The root rank then
+     reads the output band back for its checksum and statistics, and writes
+     the headers and the XML.
+  6. A mosaic warps its products with the same tiles and kernels, but reads
+     only the window of each product which the current output stripe maps
+     to, narrowed by the footprint index of the band.  The products are
+     warped into the stripe in priority order, each filling the pixels the
+     previous ones left without a valid value.
+*****************************************************************************/
+#include <math.h>
+#include <limits.h>
+#include <unistd.h>
+#include "espa_warp.h"
+#include "espa_band_stack.h"
+#include "espa_footprint.h"
+#include "raw_binary_writer.h"
+#include "espa_task_pool.h"
+#include "espa_cpu_dispatch.h"
+#include "espa_mpi_metadata.h"
+#include "espa_trace.h"
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#define WARP_X86
+#endif
+
+/* Nodes of the interpolation grid of a tile */
+#define WARP_NODE_ROWS (WARP_TILE_LINES / WARP_GRID_SIZE + 1)
+#define WARP_NODE_COLS (WARP_TILE_SAMPS / WARP_GRID_SIZE + 1)
+
+/* Input line and sample of a point which couldn't be transformed; well
+   outside any band */
+#define WARP_NO_POINT -1.0e6
+
+/* Smaller of two values */
+#define min(A,B) (A>B ? B:A)
+
+/* Tolerance of the pixel edges of the extent */
+#define WARP_EPSILON 1.0e-6
+
+/* Interpolation states of the cells of the grid */
+#define CELL_INTERPOLATE 0      /* Interpolation is within the error bound */
+#define CELL_EXACT 1            /* Pixels need the exact transformation */
+
+/* Resampling kernels, in the order of the kernel tables */
+#define WARP_NEAREST 0
+#define WARP_BILINEAR 1
+#define WARP_CUBIC 2
+#define WARP_NKERNELS 3
+
+/* Pixels of the input band being resampled */
+typedef struct
+{
+    const float *pix;        /* pixels of the band, nlines * nsamps */
+    int nlines;              /* number of lines in the band */
+    int nsamps;              /* number of samples in the band */
+    bool has_fill;           /* does the band have a fill value? */
+    float fill;              /* fill value of the band */
+    float outside;           /* value of the pixels outside the band */
+} Warp_source_t;
+
+/* Kernel resampling the input at n points */
+typedef void (*Warp_kernel_t)
+(
+    const Warp_source_t *src,  /* I: pixels of the input band */
+    const float *line,       /* I: input line of each point */
+    const float *samp,       /* I: input sample of each point */
+    int n,                   /* I: number of points */
+    float *out               /* O: resampled value of each point */
+);
+
+/* Grid of a band */
+typedef struct
+{
+    double ul_x;             /* projection x of the center of the UL pixel */
+    double ul_y;             /* projection y of the center of the UL pixel */
+    double pixel_size[2];    /* pixel size in x and y */
+    int nlines;              /* number of lines in the band */
+    int nsamps;              /* number of samples in the band */
+} Warp_grid_t;
+
+/* Buffers of a worker, for the tile it is warping */
+typedef struct
+{
+    int line0;               /* first output line of the tile */
+    int samp0;               /* first output sample of the tile */
+    int nlines;              /* number of lines in the tile */
+    int nsamps;              /* number of samples in the tile */
+    int ncell_rows;          /* number of rows of grid cells; 0 to
+                                transform every pixel exactly */
+    int ncell_cols;          /* number of columns of grid cells */
+    double x[WARP_TILE_SAMPS];   /* output projection x of the points to
+                                    transform */
+    double y[WARP_TILE_SAMPS];   /* output projection y of the points to
+                                    transform */
+    double in_line[WARP_TILE_SAMPS];  /* input line of the points */
+    double in_samp[WARP_TILE_SAMPS];  /* input sample of the points */
+    int pt_samp[WARP_TILE_SAMPS];     /* tile sample of each point
+                                         transformed exactly */
+    double node_line[WARP_NODE_ROWS * WARP_NODE_COLS];  /* input line of
+                                                           the nodes */
+    double node_samp[WARP_NODE_ROWS * WARP_NODE_COLS];  /* input sample of
+                                                           the nodes */
+    bool node_ok[WARP_NODE_ROWS];    /* was each row of nodes transformed? */
+    unsigned char cell_state[WARP_NODE_ROWS * WARP_NODE_COLS];  /* CELL_*
+                                                       state of each cell */
+    float line[WARP_TILE_SAMPS];     /* input line of each sample of a tile
+                                        line */
+    float samp[WARP_TILE_SAMPS];     /* input sample of each sample of a tile
+                                        line */
+    float value[WARP_TILE_SAMPS];    /* resampled value of each sample of a
+                                        tile line */
+} Warp_tile_t;
+
+/* Band being warped */
+typedef struct
+{
+    IAS_GEO_PROJ_TRANSFORMATION *trans; /* output to input projection */
+    Warp_grid_t in;          /* grid of the input band */
+    Warp_grid_t out;         /* grid of the output band */
+    Warp_source_t src;       /* pixels of the input band */
+    Warp_kernel_t kernel;    /* resampling kernel of the band */
+    double tolerance;        /* largest interpolation error (input pixels);
+                                0.0 to transform every pixel exactly */
+    enum Espa_data_type data_type;  /* data type of the band */
+    int size;                /* number of bytes per pixel */
+    int line0;               /* first output line of the current stripe */
+    int nlines;              /* number of lines in the current stripe */
+    void *stripe;            /* output pixels of the current stripe */
+    Warp_tile_t *tile;       /* buffers of each worker */
+} Warp_band_t;
+
+/* Input product of a mosaic */
+typedef struct
+{
+    char *xml_file;          /* XML metadata file of the product */
+    int index;               /* position of the product as given */
+    Espa_internal_meta_t meta;  /* metadata of the product */
+    IAS_PROJECTION proj;     /* projection of the product */
+    IAS_GEO_PROJ_TRANSFORMATION *trans;  /* mosaic to product projection */
+    Warp_grid_t *grid;       /* grid of each band of the product */
+    Espa_footprint_t **footprint;  /* footprint index of each band of the
+                                      product; NULL if none */
+    int *band;               /* product band of each band of the mosaic */
+    double min_x, max_x;     /* range of the product in the mosaic */
+    double min_y, max_y;     /* projection */
+} Mosaic_input_t;
+
+/* Band being mosaicked */
+typedef struct
+{
+    Warp_band_t warp;        /* band of the current input, warped into the
+                                current stripe */
+    const Espa_footprint_t *footprint;  /* footprint index of the current
+                                           input band; NULL if none */
+    int win_line0;           /* first input line of the window read */
+    int win_samp0;           /* first input sample of the window read */
+    int samp_lo;             /* first output sample the input covers */
+    int samp_hi;             /* last output sample the input covers */
+    float *value;            /* composited values of the current stripe */
+    unsigned char *valid;    /* does each pixel of the stripe have a valid
+                                value yet? */
+} Mosaic_band_t;
+
+/* Cubic convolution weights of the four pixels around each step of a pixel,
+   filled by init_warp_kernels */
+static float warp_cubic_weights[(WARP_CUBIC_STEPS + 1) * 4];
+
+
+/******************************************************************************
+MODULE:  nearest_pixel
+
+PURPOSE: Resamples the input at a point with the nearest neighbor.
+
+RETURN VALUE:
+Type = float
+Value           Description
+-----           -----------
+value           Value of the nearest input pixel, or the outside value if
+                the point is outside the band
+******************************************************************************/
+static float nearest_pixel
+(
+    const Warp_source_t *src,  /* I: pixels of the input band */
+    float line,              /* I: input line of the point */
+    float samp               /* I: input sample of the point */
+)
+{
+    int l;                   /* nearest line */
+    int s;                   /* nearest sample */
+
+    if (!(line >= -0.5f && line < (float) src->nlines - 0.5f &&
+          samp >= -0.5f && samp < (float) src->nsamps - 0.5f))
+        return (src->outside);
+
+    l = (int) floorf (line + 0.5f);
+    s = (int) floorf (samp + 0.5f);
+    if (l > src->nlines - 1)
+        l = src->nlines - 1;
+    if (s > src->nsamps - 1)
+        s = src->nsamps - 1;
+
+    return (src->pix[(size_t) l * src->nsamps + s]);
+}
+
+
+/******************************************************************************
+MODULE:  bilinear_pixel
+
+PURPOSE: Resamples the input at a point with bilinear interpolation of the
+2x2 pixels around it.
+
+RETURN VALUE:
+Type = float
+Value           Description
+-----           -----------
+value           Interpolated value, or the nearest pixel if the 2x2 pixels
+                aren't all inside the band and valid
+******************************************************************************/
+static float bilinear_pixel
+(
+    const Warp_source_t *src,  /* I: pixels of the input band */
+    float line,              /* I: input line of the point */
+    float samp               /* I: input sample of the point */
+)
+{
+    int l;                   /* line of the upper left pixel */
+    int s;                   /* sample of the upper left pixel */
+    float fy;                /* fraction of a pixel down to the point */
+    float fx;                /* fraction of a pixel across to the point */
+    float p00, p01, p10, p11;  /* UL, UR, LL, and LR pixels */
+    float top;               /* interpolated along the top pixels */
+    float bottom;            /* interpolated along the bottom pixels */
+    const float *pix;        /* upper left pixel */
+
+    if (!(line >= 0.0f && line < (float) (src->nlines - 1) &&
+          samp >= 0.0f && samp < (float) (src->nsamps - 1)))
+        return (nearest_pixel (src, line, samp));
+
+    l = (int) line;
+    s = (int) samp;
+    fy = line - (float) l;
+    fx = samp - (float) s;
+    pix = &src->pix[(size_t) l * src->nsamps + s];
+    p00 = pix[0];
+    p01 = pix[1];
+    p10 = pix[src->nsamps];
+    p11 = pix[src->nsamps + 1];
+    if (src->has_fill && (p00 == src->fill || p01 == src->fill ||
+        p10 == src->fill || p11 == src->fill))
+        return (nearest_pixel (src, line, samp));
+
+    top = p00 + fx * (p01 - p00);
+    bottom = p10 + fx * (p11 - p10);
+    return (top + fy * (bottom - top));
+}
+
+
+/******************************************************************************
+MODULE:  cubic_pixel
+
+PURPOSE: Resamples the input at a point with cubic convolution of the 4x4
+pixels around it.
+
+RETURN VALUE:
+Type = float
+Value           Description
+-----           -----------
+value           Convolved value, or the nearest pixel if the 4x4 pixels
+                aren't all inside the band and valid
+
+NOTES:
+  1. The weights are looked up for the nearest of WARP_CUBIC_STEPS steps of
+     a pixel.  Each row is convolved across, then the rows down.
+******************************************************************************/
+static float cubic_pixel
+(
+    const Warp_source_t *src,  /* I: pixels of the input band */
+    float line,              /* I: input line of the point */
+    float samp               /* I: input sample of the point */
+)
+{
+    int l;                   /* line of the pixel up and left of the point */
+    int s;                   /* sample of the pixel up and left of the
+                                point */
+    int r;                   /* looping variable for the rows */
+    int k;                   /* looping variable for the columns */
+    float fy;                /* fraction of a pixel down to the point */
+    float fx;                /* fraction of a pixel across to the point */
+    float row = 0.0f;        /* row convolved across */
+    float value = 0.0f;      /* rows convolved down */
+    const float *wy;         /* weights of the rows */
+    const float *wx;         /* weights of the columns */
+    const float *pix;        /* first pixel of a row */
+
+    if (!(line >= 1.0f && line < (float) (src->nlines - 2) &&
+          samp >= 1.0f && samp < (float) (src->nsamps - 2)))
+        return (nearest_pixel (src, line, samp));
+
+    l = (int) line;
+    s = (int) samp;
+    fy = line - (float) l;
+    fx = samp - (float) s;
+    wy = &warp_cubic_weights[4 * lrintf (fy * WARP_CUBIC_STEPS)];
+    wx = &warp_cubic_weights[4 * lrintf (fx * WARP_CUBIC_STEPS)];
+
+    for (r = 0; r < 4; r++)
+    {
+        pix = &src->pix[(size_t) (l - 1 + r) * src->nsamps + s - 1];
+        for (k = 0; k < 4; k++)
+        {
+            if (src->has_fill && pix[k] == src->fill)
+                return (nearest_pixel (src, line, samp));
+            row = k == 0 ? wx[0] * pix[0] : row + wx[k] * pix[k];
+        }
+        value = r == 0 ? wy[0] * row : value + wy[r] * row;
+    }
+
+    return (value);
+}
+
+
+/******************************************************************************
+MODULE:  warp_nearest_none / warp_bilinear_none / warp_cubic_none
+
+PURPOSE: Scalar kernels, resampling one point at a time.
+
+RETURN VALUE: None
+******************************************************************************/
+static void warp_nearest_none
+(
+    const Warp_source_t *src,  /* I: pixels of the input band */
+    const float *line,       /* I: input line of each point */
+    const float *samp,       /* I: input sample of each point */
+    int n,                   /* I: number of points */
+    float *out               /* O: resampled value of each point */
+)
+{
+    int j;                   /* looping variable for the points */
+
+    for (j = 0; j < n; j++)
+        out[j] = nearest_pixel (src, line[j], samp[j]);
+}
+
+static void warp_bilinear_none
+(
+    const Warp_source_t *src,  /* I: pixels of the input band */
+    const float *line,       /* I: input line of each point */
+    const float *samp,       /* I: input sample of each point */
+    int n,                   /* I: number of points */
+    float *out               /* O: resampled value of each point */
+)
+{
+    int j;                   /* looping variable for the points */
+
+    for (j = 0; j < n; j++)
+        out[j] = bilinear_pixel (src, line[j], samp[j]);
+}
+
+static void warp_cubic_none
+(
+    const Warp_source_t *src,  /* I: pixels of the input band */
+    const float *line,       /* I: input line of each point */
+    const float *samp,       /* I: input sample of each point */
+    int n,                   /* I: number of points */
+    float *out               /* O: resampled value of each point */
+)
+{
+    int j;                   /* looping variable for the points */
+
+    for (j = 0; j < n; j++)
+        out[j] = cubic_pixel (src, line[j], samp[j]);
+}
+
+
+#ifdef WARP_X86
+/******************************************************************************
+MODULE:  warp_nearest_avx2
+
+PURPOSE: Resamples 8 points at a time with the nearest neighbor, gathering
+the pixels with AVX2.
+
+RETURN VALUE: None
+
+NOTES:
+  1. Only put in the kernel table when the CPU supports AVX2.
+  2. A vector with any point outside the band is resampled one point at a
+     time.
+******************************************************************************/
+__attribute__ ((target ("avx2")))
+static void warp_nearest_avx2
+(
+    const Warp_source_t *src,  /* I: pixels of the input band */
+    const float *line,       /* I: input line of each point */
+    const float *samp,       /* I: input sample of each point */
+    int n,                   /* I: number of points */
+    float *out               /* O: resampled value of each point */
+)
+{
+    int j;                   /* current point */
+    int k;                   /* looping variable for the lanes */
+    __m256 vl;               /* input lines of the points */
+    __m256 vs;               /* input samples of the points */
+    __m256 inside;           /* lanes inside the band */
+    __m256i idx;             /* index of the nearest pixel of each point */
+    const __m256 half = _mm256_set1_ps (0.5f);
+    const __m256 lmin = _mm256_set1_ps (-0.5f);
+    const __m256 lmax = _mm256_set1_ps ((float) src->nlines - 0.5f);
+    const __m256 smax = _mm256_set1_ps ((float) src->nsamps - 0.5f);
+    const __m256i last_line = _mm256_set1_epi32 (src->nlines - 1);
+    const __m256i last_samp = _mm256_set1_epi32 (src->nsamps - 1);
+    const __m256i stride = _mm256_set1_epi32 (src->nsamps);
+
+    for (j = 0; j + 8 <= n; j += 8)
+    {
+        vl = _mm256_loadu_ps (line + j);
+        vs = _mm256_loadu_ps (samp + j);
+        inside = _mm256_and_ps (
+            _mm256_and_ps (_mm256_cmp_ps (vl, lmin, _CMP_GE_OQ),
+            _mm256_cmp_ps (vl, lmax, _CMP_LT_OQ)),
+            _mm256_and_ps (_mm256_cmp_ps (vs, lmin, _CMP_GE_OQ),
+            _mm256_cmp_ps (vs, smax, _CMP_LT_OQ)));
+        if (_mm256_movemask_ps (inside) != 0xff)
+        {
+            for (k = 0; k < 8; k++)
+                out[j+k] = nearest_pixel (src, line[j+k], samp[j+k]);
+            continue;
+        }
+
+        idx = _mm256_add_epi32 (_mm256_mullo_epi32 (_mm256_min_epi32 (
+            _mm256_cvttps_epi32 (_mm256_floor_ps (_mm256_add_ps (vl, half))),
+            last_line), stride), _mm256_min_epi32 (_mm256_cvttps_epi32 (
+            _mm256_floor_ps (_mm256_add_ps (vs, half))), last_samp));
+        _mm256_storeu_ps (out + j, _mm256_i32gather_ps (src->pix, idx, 4));
+    }
+
+    for (; j < n; j++)
+        out[j] = nearest_pixel (src, line[j], samp[j]);
+}
+
+
+/******************************************************************************
+MODULE:  warp_bilinear_avx2
+
+PURPOSE: Resamples 8 points at a time with bilinear interpolation, gathering
+the 2x2 pixels with AVX2.
+
+RETURN VALUE: None
+
+NOTES:
+  1. Only put in the kernel table when the CPU supports AVX2.
+  2. A vector with any point whose 2x2 pixels aren't all inside the band and
+     valid is resampled one point at a time.
+******************************************************************************/
+__attribute__ ((target ("avx2")))
+static void warp_bilinear_avx2
+(
+    const Warp_source_t *src,  /* I: pixels of the input band */
+    const float *line,       /* I: input line of each point */
+    const float *samp,       /* I: input sample of each point */
+    int n,                   /* I: number of points */
+    float *out               /* O: resampled value of each point */
+)
+{
+    int j;                   /* current point */
+    int k;                   /* looping variable for the lanes */
+    __m256 vl;               /* input lines of the points */
+    __m256 vs;               /* input samples of the points */
+    __m256 inside;           /* lanes inside the band */
+    __m256 fy;               /* fractions of a pixel down to the points */
+    __m256 fx;               /* fractions of a pixel across to the points */
+    __m256 p00, p01, p10, p11;  /* UL, UR, LL, and LR pixels */
+    __m256 top;              /* interpolated along the top pixels */
+    __m256 bottom;           /* interpolated along the bottom pixels */
+    __m256 is_fill;          /* lanes with a fill pixel */
+    __m256i il;              /* lines of the upper left pixels */
+    __m256i is;              /* samples of the upper left pixels */
+    __m256i idx;             /* index of the upper left pixels */
+    const __m256 zero = _mm256_setzero_ps ();
+    const __m256 lmax = _mm256_set1_ps ((float) (src->nlines - 1));
+    const __m256 smax = _mm256_set1_ps ((float) (src->nsamps - 1));
+    const __m256 fill = _mm256_set1_ps (src->fill);
+    const __m256i stride = _mm256_set1_epi32 (src->nsamps);
+
+    for (j = 0; j + 8 <= n; j += 8)
+    {
+        vl = _mm256_loadu_ps (line + j);
+        vs = _mm256_loadu_ps (samp + j);
+        inside = _mm256_and_ps (
+            _mm256_and_ps (_mm256_cmp_ps (vl, zero, _CMP_GE_OQ),
+            _mm256_cmp_ps (vl, lmax, _CMP_LT_OQ)),
+            _mm256_and_ps (_mm256_cmp_ps (vs, zero, _CMP_GE_OQ),
+            _mm256_cmp_ps (vs, smax, _CMP_LT_OQ)));
+        if (_mm256_movemask_ps (inside) != 0xff)
+        {
+            for (k = 0; k < 8; k++)
+                out[j+k] = bilinear_pixel (src, line[j+k], samp[j+k]);
+            continue;
+        }
+
+        il = _mm256_cvttps_epi32 (vl);
+        is = _mm256_cvttps_epi32 (vs);
+        fy = _mm256_sub_ps (vl, _mm256_cvtepi32_ps (il));
+        fx = _mm256_sub_ps (vs, _mm256_cvtepi32_ps (is));
+        idx = _mm256_add_epi32 (_mm256_mullo_epi32 (il, stride), is);
+        p00 = _mm256_i32gather_ps (src->pix, idx, 4);
+        p01 = _mm256_i32gather_ps (src->pix + 1, idx, 4);
+        p10 = _mm256_i32gather_ps (src->pix + src->nsamps, idx, 4);
+        p11 = _mm256_i32gather_ps (src->pix + src->nsamps + 1, idx, 4);
+        if (src->has_fill)
+        {
+            is_fill = _mm256_or_ps (
+                _mm256_or_ps (_mm256_cmp_ps (p00, fill, _CMP_EQ_OQ),
+                _mm256_cmp_ps (p01, fill, _CMP_EQ_OQ)),
+                _mm256_or_ps (_mm256_cmp_ps (p10, fill, _CMP_EQ_OQ),
+                _mm256_cmp_ps (p11, fill, _CMP_EQ_OQ)));
+            if (_mm256_movemask_ps (is_fill) != 0)
+            {
+                for (k = 0; k < 8; k++)
+                    out[j+k] = bilinear_pixel (src, line[j+k], samp[j+k]);
+                continue;
+            }
+        }
+
+        top = _mm256_add_ps (p00, _mm256_mul_ps (fx, _mm256_sub_ps (p01,
+            p00)));
+        bottom = _mm256_add_ps (p10, _mm256_mul_ps (fx, _mm256_sub_ps (p11,
+            p10)));
+        _mm256_storeu_ps (out + j, _mm256_add_ps (top, _mm256_mul_ps (fy,
+            _mm256_sub_ps (bottom, top))));
+    }
+
+    for (; j < n; j++)
+        out[j] = bilinear_pixel (src, line[j], samp[j]);
+}
+
+
+/******************************************************************************
+MODULE:  warp_cubic_avx2
+
+PURPOSE: Resamples 8 points at a time with cubic convolution, gathering the
+4x4 pixels and their weights with AVX2.
+
+RETURN VALUE: None
+
+NOTES:
+  1. Only put in the kernel table when the CPU supports AVX2.
+  2. A vector with any point whose 4x4 pixels aren't all inside the band and
+     valid is resampled one point at a time.
+******************************************************************************/
+__attribute__ ((target ("avx2")))
+static void warp_cubic_avx2
+(
+    const Warp_source_t *src,  /* I: pixels of the input band */
+    const float *line,       /* I: input line of each point */
+    const float *samp,       /* I: input sample of each point */
+    int n,                   /* I: number of points */
+    float *out               /* O: resampled value of each point */
+)
+{
+    int j;                   /* current point */
+    int k;                   /* looping variable for the lanes and
+                                columns */
+    int r;                   /* looping variable for the rows */
+    const float *pix;        /* first pixel of the rows, less one column */
+    __m256 vl;               /* input lines of the points */
+    __m256 vs;               /* input samples of the points */
+    __m256 inside;           /* lanes inside the band */
+    __m256 p;                /* current pixels */
+    __m256 row;              /* rows convolved across */
+    __m256 value;            /* rows convolved down */
+    __m256 wx[4];            /* weights of the columns */
+    __m256 wy;               /* weights of the current row */
+    __m256 is_fill;          /* lanes with a fill pixel */
+    __m256i il;              /* lines of the pixels up and left */
+    __m256i is;              /* samples of the pixels up and left */
+    __m256i idx;             /* index of the first pixel of the first row */
+    __m256i kx;              /* index of the column weights */
+    __m256i ky;              /* index of the row weights */
+    const __m256 one = _mm256_set1_ps (1.0f);
+    const __m256 steps = _mm256_set1_ps ((float) WARP_CUBIC_STEPS);
+    const __m256 lmax = _mm256_set1_ps ((float) (src->nlines - 2));
+    const __m256 smax = _mm256_set1_ps ((float) (src->nsamps - 2));
+    const __m256 fill = _mm256_set1_ps (src->fill);
+    const __m256i stride = _mm256_set1_epi32 (src->nsamps);
+    const __m256i ione = _mm256_set1_epi32 (1);
+
+    for (j = 0; j + 8 <= n; j += 8)
+    {
+        vl = _mm256_loadu_ps (line + j);
+        vs = _mm256_loadu_ps (samp + j);
+        inside = _mm256_and_ps (
+            _mm256_and_ps (_mm256_cmp_ps (vl, one, _CMP_GE_OQ),
+            _mm256_cmp_ps (vl, lmax, _CMP_LT_OQ)),
+            _mm256_and_ps (_mm256_cmp_ps (vs, one, _CMP_GE_OQ),
+            _mm256_cmp_ps (vs, smax, _CMP_LT_OQ)));
+        if (_mm256_movemask_ps (inside) != 0xff)
+        {
+            for (k = 0; k < 8; k++)
+                out[j+k] = cubic_pixel (src, line[j+k], samp[j+k]);
+            continue;
+        }
+
+        il = _mm256_cvttps_epi32 (vl);
+        is = _mm256_cvttps_epi32 (vs);
+        ky = _mm256_slli_epi32 (_mm256_cvtps_epi32 (_mm256_mul_ps (
+            _mm256_sub_ps (vl, _mm256_cvtepi32_ps (il)), steps)), 2);
+        kx = _mm256_slli_epi32 (_mm256_cvtps_epi32 (_mm256_mul_ps (
+            _mm256_sub_ps (vs, _mm256_cvtepi32_ps (is)), steps)), 2);
+        idx = _mm256_add_epi32 (_mm256_mullo_epi32 (_mm256_sub_epi32 (il,
+            ione), stride), _mm256_sub_epi32 (is, ione));
+        for (k = 0; k < 4; k++)
+            wx[k] = _mm256_i32gather_ps (warp_cubic_weights + k, kx, 4);
+
+        is_fill = _mm256_setzero_ps ();
+        value = _mm256_setzero_ps ();
+        for (r = 0; r < 4; r++)
+        {
+            pix = src->pix + (size_t) r * src->nsamps;
+            p = _mm256_i32gather_ps (pix, idx, 4);
+            is_fill = _mm256_or_ps (is_fill, _mm256_cmp_ps (p, fill,
+                _CMP_EQ_OQ));
+            row = _mm256_mul_ps (wx[0], p);
+            for (k = 1; k < 4; k++)
+            {
+                p = _mm256_i32gather_ps (pix + k, idx, 4);
+                is_fill = _mm256_or_ps (is_fill, _mm256_cmp_ps (p, fill,
+                    _CMP_EQ_OQ));
+                row = _mm256_add_ps (row, _mm256_mul_ps (wx[k], p));
+            }
+            wy = _mm256_i32gather_ps (warp_cubic_weights + r, ky, 4);
+            value = r == 0 ? _mm256_mul_ps (wy, row) :
+                _mm256_add_ps (value, _mm256_mul_ps (wy, row));
+        }
+
+        if (src->has_fill && _mm256_movemask_ps (is_fill) != 0)
+        {
+            for (k = 0; k < 8; k++)
+                out[j+k] = cubic_pixel (src, line[j+k], samp[j+k]);
+            continue;
+        }
+        _mm256_storeu_ps (out + j, value);
+    }
+
+    for (; j < n; j++)
+        out[j] = cubic_pixel (src, line[j], samp[j]);
+}
+#endif
+
+
+/* Scalar kernels, for the bands too large for 32-bit gather indexes */
+static const Warp_kernel_t warp_scalar_kernels[WARP_NKERNELS] =
+    {warp_nearest_none, warp_bilinear_none, warp_cubic_none};
+
+/* Kernels chosen by init_warp_kernels */
+static Warp_kernel_t warp_kernels[WARP_NKERNELS] =
+    {warp_nearest_none, warp_bilinear_none, warp_cubic_none};
+
+
+/******************************************************************************
+MODULE: init_warp_kernels
+
+PURPOSE: Fills the table of cubic convolution weights and chooses the widest
+resampling kernels supported by the CPU.
+
+RETURN VALUE: None
+
+NOTES:
+  1. Run when the program (or shared library) is loaded.
+  2. The weights of step k are those of the pixels one before, at, one
+     after, and two after a point k / WARP_CUBIC_STEPS of a pixel past a
+     pixel.
+*****************************************************************************/
+__attribute__ ((constructor))
+static void init_warp_kernels (void)
+{
+    int k;                   /* looping variable for the steps */
+    double f;                /* fraction of a pixel of the step */
+
+    for (k = 0; k <= WARP_CUBIC_STEPS; k++)
+    {
+        f = (double) k / WARP_CUBIC_STEPS;
+        warp_cubic_weights[4 * k] = ias_math_cubic_convolution (
+            WARP_CUBIC_ALPHA, 1.0 + f);
+        warp_cubic_weights[4 * k + 1] = ias_math_cubic_convolution (
+            WARP_CUBIC_ALPHA, f);
+        warp_cubic_weights[4 * k + 2] = ias_math_cubic_convolution (
+            WARP_CUBIC_ALPHA, 1.0 - f);
+        warp_cubic_weights[4 * k + 3] = ias_math_cubic_convolution (
+            WARP_CUBIC_ALPHA, 2.0 - f);
+    }
+
+#if defined(WARP_X86)
+    if (espa_cpu_supports (ESPA_CPU_AVX2))
+    {
+        warp_kernels[WARP_NEAREST] = warp_nearest_avx2;
+        warp_kernels[WARP_BILINEAR] = warp_bilinear_avx2;
+        warp_kernels[WARP_CUBIC] = warp_cubic_avx2;
+    }
+#endif
+}
+
+
+/******************************************************************************
+MODULE:  transform_points
+
+PURPOSE: Transforms the points held in the output projection x/y arrays of
+a tile to the lines and samples of the input band.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           A point could not be transformed; it is set to WARP_NO_POINT
+SUCCESS         Successfully transformed the points
+
+NOTES:
+  1. The points are transformed in one call, and one at a time only when
+     that fails, so a point the projections can't reach doesn't lose the
+     others.
+******************************************************************************/
+static int transform_points
+(
+    const Warp_band_t *band, /* I: band being warped */
+    Warp_tile_t *tile,       /* I/O: tile with the points in x and y */
+    int npts                 /* I: number of points */
+)
+{
+    int status = SUCCESS;    /* return status */
+    int i;                   /* looping variable for the points */
+    double *in_x = tile->in_samp;  /* input projection x of the points */
+    double *in_y = tile->in_line;  /* input projection y of the points */
+
+    if (ias_geo_transform_coordinates (band->trans, npts, tile->x, tile->y,
+        in_x, in_y) != SUCCESS)
+    {
+        for (i = 0; i < npts; i++)
+        {
+            if (ias_geo_transform_coordinate (band->trans, tile->x[i],
+                tile->y[i], &in_x[i], &in_y[i]) != SUCCESS)
+            {
+                in_x[i] = in_y[i] = NAN;
+                status = ERROR;
+            }
+        }
+    }
+
+    for (i = 0; i < npts; i++)
+    {
+        if (isnan (in_x[i]))
+        {
+            tile->in_samp[i] = tile->in_line[i] = WARP_NO_POINT;
+            continue;
+        }
+        tile->in_samp[i] = (in_x[i] - band->in.ul_x) / band->in.pixel_size[0];
+        tile->in_line[i] = (band->in.ul_y - in_y[i]) / band->in.pixel_size[1];
+    }
+
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  set_point
+
+PURPOSE: Sets the output projection x/y of a point, given its line and sample
+in the tile.
+******************************************************************************/
+static void set_point
+(
+    const Warp_band_t *band, /* I: band being warped */
+    Warp_tile_t *tile,       /* I/O: tile to hold the point */
+    int index,               /* I: index of the point */
+    double line,             /* I: tile line of the point */
+    double samp              /* I: tile sample of the point */
+)
+{
+    tile->x[index] = band->out.ul_x + (tile->samp0 + samp) *
+        band->out.pixel_size[0];
+    tile->y[index] = band->out.ul_y - (tile->line0 + line) *
+        band->out.pixel_size[1];
+}
+
+
+/******************************************************************************
+MODULE:  node_line / node_samp
+
+PURPOSE: Return the tile line or sample of a row or column of grid nodes.
+The last nodes are on the last line and sample of the tile.
+******************************************************************************/
+static int node_line
+(
+    const Warp_tile_t *tile, /* I: tile */
+    int row                  /* I: row of nodes */
+)
+{
+    if (row * WARP_GRID_SIZE < tile->nlines - 1)
+        return (row * WARP_GRID_SIZE);
+    return (tile->nlines - 1);
+}
+
+static int node_samp
+(
+    const Warp_tile_t *tile, /* I: tile */
+    int col                  /* I: column of nodes */
+)
+{
+    if (col * WARP_GRID_SIZE < tile->nsamps - 1)
+        return (col * WARP_GRID_SIZE);
+    return (tile->nsamps - 1);
+}
+
+
+/******************************************************************************
+MODULE:  interpolate
+
+PURPOSE: Bilinearly interpolates a value of a grid cell from its corners.
+******************************************************************************/
+static double interpolate
+(
+    const double *node,      /* I: values of the nodes */
+    int ncols,               /* I: number of node columns */
+    int row,                 /* I: row of the cell */
+    int col,                 /* I: column of the cell */
+    double line_fraction,    /* I: fraction of the cell down to the point */
+    double samp_fraction     /* I: fraction of the cell across to the point */
+)
+{
+    const double *ul = &node[row * ncols + col];  /* UL corner of the cell */
+    double top = ul[0] + samp_fraction * (ul[1] - ul[0]);
+    double bottom = ul[ncols] + samp_fraction * (ul[ncols+1] - ul[ncols]);
+
+    return (top + line_fraction * (bottom - top));
+}
+
+
+/******************************************************************************
+MODULE:  load_tile_grid
+
+PURPOSE: Transforms the nodes of the grid of a tile and decides which cells
+can be interpolated.
+
+RETURN VALUE: None
+
+NOTES:
+  1. A cell is interpolated only if the cell center and edge midpoints are
+     each within the tolerance of the exact transformation.  Cells whose
+     nodes or check points couldn't all be transformed are transformed
+     exactly.
+  2. Without a tolerance, or for a tile a single line or sample wide, every
+     pixel is transformed exactly (ncell_rows is 0).
+******************************************************************************/
+static void load_tile_grid
+(
+    const Warp_band_t *band, /* I: band being warped */
+    Warp_tile_t *tile        /* I/O: tile whose grid is loaded */
+)
+{
+    /* Cell fractions of the checked points: center, then edge midpoints */
+    static const double check_points[5][2] = {{0.5, 0.5}, {0.0, 0.5},
+        {1.0, 0.5}, {0.5, 0.0}, {0.5, 1.0}};
+    int ncols;               /* number of node columns */
+    int row;                 /* looping variable for the rows */
+    int col;                 /* looping variable for the columns */
+    int i;                   /* looping variable for the check points */
+    int top, bottom;         /* tile lines of the nodes of a cell row */
+    int left, right;         /* tile samples of the nodes of a cell */
+    bool checked;            /* were the check points of the row
+                                transformed? */
+    unsigned char *state;    /* state of the current cell */
+
+    tile->ncell_rows = (tile->nlines + WARP_GRID_SIZE - 2) / WARP_GRID_SIZE;
+    tile->ncell_cols = (tile->nsamps + WARP_GRID_SIZE - 2) / WARP_GRID_SIZE;
+    if (band->tolerance <= 0.0 || tile->ncell_rows <= 0 ||
+        tile->ncell_cols <= 0)
+    {
+        tile->ncell_rows = 0;
+        return;
+    }
+    ncols = tile->ncell_cols + 1;
+
+    /* Transform the nodes a row at a time */
+    for (row = 0; row <= tile->ncell_rows; row++)
+    {
+        for (col = 0; col < ncols; col++)
+            set_point (band, tile, col, node_line (tile, row),
+                node_samp (tile, col));
+        tile->node_ok[row] = transform_points (band, tile, ncols) == SUCCESS;
+        memcpy (&tile->node_line[row * ncols], tile->in_line,
+            ncols * sizeof (double));
+        memcpy (&tile->node_samp[row * ncols], tile->in_samp,
+            ncols * sizeof (double));
+    }
+
+    /* Check the cells a row at a time, with the check points of all the
+       cells of the row in one call */
+    for (row = 0; row < tile->ncell_rows; row++)
+    {
+        top = node_line (tile, row);
+        bottom = node_line (tile, row + 1);
+        for (col = 0; col < tile->ncell_cols; col++)
+        {
+            left = node_samp (tile, col);
+            right = node_samp (tile, col + 1);
+            for (i = 0; i < 5; i++)
+                set_point (band, tile, 5 * col + i,
+                    top + check_points[i][0] * (bottom - top),
+                    left + check_points[i][1] * (right - left));
+        }
+        checked = tile->node_ok[row] && tile->node_ok[row+1] &&
+            transform_points (band, tile, 5 * tile->ncell_cols) == SUCCESS;
+
+        for (col = 0; col < tile->ncell_cols; col++)
+        {
+            state = &tile->cell_state[row * tile->ncell_cols + col];
+            *state = CELL_EXACT;
+            if (!checked)
+                continue;
+
+            for (i = 0; i < 5; i++)
+            {
+                if (fabs (tile->in_line[5 * col + i] - interpolate (
+                        tile->node_line, ncols, row, col, check_points[i][0],
+                        check_points[i][1])) > band->tolerance ||
+                    fabs (tile->in_samp[5 * col + i] - interpolate (
+                        tile->node_samp, ncols, row, col, check_points[i][0],
+                        check_points[i][1])) > band->tolerance)
+                    break;
+            }
+            if (i == 5)
+                *state = CELL_INTERPOLATE;
+        }
+    }
+}
+
+
+/******************************************************************************
+MODULE:  map_tile_line
+
+PURPOSE: Maps the samples of a line of a tile to the lines and samples of the
+input band.
+
+RETURN VALUE: None
+
+NOTES:
+  1. The samples in cells which can be interpolated are interpolated; the
+     rest are transformed exactly, all in one call.
+******************************************************************************/
+static void map_tile_line
+(
+    const Warp_band_t *band, /* I: band being warped */
+    Warp_tile_t *tile,       /* I/O: tile with its grid loaded; line and
+                                     samp are set */
+    int line                 /* I: tile line to map */
+)
+{
+    int cell_row = 0;        /* row of grid cells holding the line */
+    int col;                 /* column of the grid cell of a sample */
+    int top, bottom;         /* tile lines of the nodes of the cell row */
+    int left, right;         /* tile samples of the nodes of a cell */
+    int nexact = 0;          /* number of samples transformed exactly */
+    int samp;                /* looping variable for the samples */
+    int i;                   /* looping variable */
+    int ncols = tile->ncell_cols + 1;  /* number of node columns */
+    double line_fraction = 0.0;  /* fraction of the cell down to the line */
+    double samp_fraction;    /* fraction of the cell across to a sample */
+
+    if (tile->ncell_rows > 0)
+    {
+        cell_row = line / WARP_GRID_SIZE;
+        if (cell_row > tile->ncell_rows - 1)
+            cell_row = tile->ncell_rows - 1;
+        top = node_line (tile, cell_row);
+        bottom = node_line (tile, cell_row + 1);
+        line_fraction = (double) (line - top) / (bottom - top);
+    }
+
+    for (samp = 0; samp < tile->nsamps; samp++)
+    {
+        col = samp / WARP_GRID_SIZE;
+        if (col > tile->ncell_cols - 1)
+            col = tile->ncell_cols - 1;
+        if (tile->ncell_rows == 0 || tile->cell_state[cell_row *
+            tile->ncell_cols + col] == CELL_EXACT)
+        {
+            tile->pt_samp[nexact] = samp;
+            set_point (band, tile, nexact, line, samp);
+            nexact++;
+            continue;
+        }
+
+        left = node_samp (tile, col);
+        right = node_samp (tile, col + 1);
+        samp_fraction = (double) (samp - left) / (right - left);
+        tile->line[samp] = interpolate (tile->node_line, ncols, cell_row,
+            col, line_fraction, samp_fraction);
+        tile->samp[samp] = interpolate (tile->node_samp, ncols, cell_row,
+            col, line_fraction, samp_fraction);
+    }
+
+    /* Transform the rest of the samples exactly, all in one call; points
+       which can't be transformed are outside the input */
+    if (nexact > 0)
+    {
+        transform_points (band, tile, nexact);
+        for (i = 0; i < nexact; i++)
+        {
+            tile->line[tile->pt_samp[i]] = tile->in_line[i];
+            tile->samp[tile->pt_samp[i]] = tile->in_samp[i];
+        }
+    }
+}
+
+
+/* Rounds and clamps the resampled values to the given integer type */
+#define STORE_PIXELS(type, lo, hi) \
+    { \
+        type *o = out; \
+        for (j = 0; j < n; j++) \
+        { \
+            v = floorf (value[j] + 0.5f); \
+            o[j] = v < (lo) ? (lo) : v > (hi) ? (hi) : (type) v; \
+        } \
+    }
+
+/******************************************************************************
+MODULE:  store_pixels
+
+PURPOSE: Stores resampled values as pixels of the data type of the band.
+
+RETURN VALUE: None
+
+NOTES:
+  1. The integer types are rounded to the nearest integer and clamped to
+     their range, since the bilinear and cubic values may overshoot.
+******************************************************************************/
+static void store_pixels
+(
+    const float *value,      /* I: resampled values */
+    int n,                   /* I: number of values */
+    enum Espa_data_type data_type,  /* I: data type of the band */
+    void *out                /* O: pixels of the band */
+)
+{
+    int j;                   /* looping variable for the pixels */
+    float v;                 /* rounded value */
+
+    switch (data_type)
+    {
+        case ESPA_INT8:
+            STORE_PIXELS (int8_t, INT8_MIN, INT8_MAX);
+            break;
+        case ESPA_UINT8:
+            STORE_PIXELS (uint8_t, 0, UINT8_MAX);
+            break;
+        case ESPA_INT16:
+            STORE_PIXELS (int16_t, INT16_MIN, INT16_MAX);
+            break;
+        case ESPA_UINT16:
+            STORE_PIXELS (uint16_t, 0, UINT16_MAX);
+            break;
+        default:
+            memcpy (out, value, n * sizeof (float));
+            break;
+    }
+}
+
+
+/******************************************************************************
+MODULE:  warp_tile_task
+
+PURPOSE: Warps one tile of the current stripe, as an iteration of the
+parallel loop over the tiles.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+SUCCESS         Successfully warped the tile
+******************************************************************************/
+static int warp_tile_task
+(
+    void *arg,               /* I/O: band being warped */
+    int index,               /* I: index of the tile in the stripe */
+    int worker               /* I: worker warping the tile */
+)
+{
+    Warp_band_t *band = arg; /* band being warped */
+    Warp_tile_t *tile = &band->tile[worker];  /* buffers of the worker */
+    int line;                /* looping variable for the tile lines */
+
+    tile->line0 = band->line0;
+    tile->nlines = band->nlines;
+    tile->samp0 = index * WARP_TILE_SAMPS;
+    tile->nsamps = min (WARP_TILE_SAMPS, band->out.nsamps - tile->samp0);
+    load_tile_grid (band, tile);
+
+    for (line = 0; line < tile->nlines; line++)
+    {
+        map_tile_line (band, tile, line);
+        band->kernel (&band->src, tile->line, tile->samp, tile->nsamps,
+            tile->value);
+        store_pixels (tile->value, tile->nsamps, band->data_type,
+            (char *) band->stripe + ((size_t) line * band->out.nsamps +
+            tile->samp0) * band->size);
+    }
+
+    return (SUCCESS);
+}
+
+
+/* Converts the lines of a block of the given type to floats */
+#define LOAD_PIXELS(type) \
+    for (line = 0; line < block->nlines; line++) \
+    { \
+        const type *in = (const type *) block->band_buf[0] + \
+            (size_t) line * block->line_stride; \
+        float *o = pix + (size_t) (block->line0 + line) * bmeta->nsamps; \
+        for (samp = 0; samp < block->nsamps; samp++) \
+            o[samp] = in[samp]; \
+    }
+
+/******************************************************************************
+MODULE:  check_warp_budget
+
+PURPOSE: Checks that the pixels of a band, as floats, fit in what is left of
+the memory budget.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           The pixels don't fit in the budget
+SUCCESS         The pixels fit, or there is no budget
+
+NOTES:
+******************************************************************************/
+static int check_warp_budget
+(
+    const char *band_name,   /* I: name of the band */
+    size_t npix              /* I: number of pixels held */
+)
+{
+    char FUNC_NAME[] = "check_warp_budget";   /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    long long available;     /* bytes left in the memory budget */
+
+    available = espa_mem_available ();
+    if (available < 0 || npix * sizeof (float) <= (size_t) available)
+        return (SUCCESS);
+
+    snprintf (errmsg, sizeof (errmsg), "Warping band %s takes %.1f MB, but "
+        "only %.1f MB of the %.1f MB memory budget (%s) is left", band_name,
+        npix * sizeof (float) / (1024.0 * 1024.0),
+        available / (1024.0 * 1024.0),
+        espa_mem_budget () / (1024.0 * 1024.0), ESPA_MEM_BUDGET_ENV);
+    error_handler (true, FUNC_NAME, errmsg);
+    return (ERROR);
+}
+
+
+/******************************************************************************
+MODULE:  read_warp_source
+
+PURPOSE: Reads an input band into memory as floats.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error reading the band
+SUCCESS         Successfully read the band
+
+NOTES:
+  1. The band is read through the band stack, so encoded and constant bands
+     are read like the others and the checksum is verified when asked for.
+  2. The caller frees src->pix with espa_trace_free.
+  3. A band which doesn't fit in the memory budget is an error (see
+     check_warp_budget).
+******************************************************************************/
+static int read_warp_source
+(
+    Espa_internal_meta_t *xml_metadata, /* I: metadata of the input product */
+    int band,                /* I: index of the band */
+    Warp_source_t *src       /* O: pixels of the band */
+)
+{
+    char FUNC_NAME[] = "read_warp_source";   /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    int status = SUCCESS;    /* return status */
+    int line;                /* looping variable for the lines */
+    int samp;                /* looping variable for the samples */
+    float *pix = NULL;       /* pixels of the band */
+    Espa_band_meta_t *bmeta = &xml_metadata->band[band];
+    Espa_band_stack_t *stack = NULL;  /* stack with just the band */
+    Espa_band_block_t *block = NULL;  /* current block of the band */
+
+    if (check_warp_budget (bmeta->name, (size_t) bmeta->nlines *
+        bmeta->nsamps) != SUCCESS)
+        return (ERROR);
+    pix = espa_trace_malloc ((size_t) bmeta->nlines * bmeta->nsamps *
+        sizeof (float));
+    stack = open_band_stack (xml_metadata, 1, &band,
+        RB_PREFETCH_DEFAULT_LINES, 0);
+    if (pix == NULL || stack == NULL)
+    {
+        sprintf (errmsg, "Opening band %s", bmeta->name);
+        error_handler (true, FUNC_NAME, errmsg);
+        espa_trace_free (pix);
+        if (stack != NULL)
+            close_band_stack (stack);
+        return (ERROR);
+    }
+    skip_band_stack_stats (stack);
+
+    while (status == SUCCESS)
+    {
+        status = get_band_stack_block (stack, &block);
+        if (status != SUCCESS || block == NULL)
+            break;
+
+        switch (bmeta->data_type)
+        {
+            case ESPA_INT8:
+                LOAD_PIXELS (int8_t);
+                break;
+            case ESPA_UINT8:
+                LOAD_PIXELS (uint8_t);
+                break;
+            case ESPA_INT16:
+                LOAD_PIXELS (int16_t);
+                break;
+            case ESPA_UINT16:
+                LOAD_PIXELS (uint16_t);
+                break;
+            default:
+                LOAD_PIXELS (float);
+                break;
+        }
+    }
+    close_band_stack (stack);
+    if (status != SUCCESS)
+    {
+        sprintf (errmsg, "Reading band %s", bmeta->name);
+        error_handler (true, FUNC_NAME, errmsg);
+        espa_trace_free (pix);
+        return (ERROR);
+    }
+
+    src->pix = pix;
+    src->nlines = bmeta->nlines;
+    src->nsamps = bmeta->nsamps;
+    src->has_fill = bmeta->fill_value != ESPA_INT_META_FILL;
+    src->fill = (float) bmeta->fill_value;
+    src->outside = src->has_fill ? src->fill : 0.0f;
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  write_warp_envi_header
+
+PURPOSE: Writes the ENVI header of a warped band.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the header
+SUCCESS         Successfully wrote the header
+
+NOTES:
+******************************************************************************/
+static int write_warp_envi_header
+(
+    Espa_band_meta_t *bmeta, /* I: metadata of the output band */
+    Espa_global_meta_t *gmeta  /* I: global metadata of the output */
+)
+{
+    char FUNC_NAME[] = "write_warp_envi_header";   /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    char envi_file[STR_SIZE];  /* name of the output ENVI header file */
+    char *cptr = NULL;       /* pointer to the file extension */
+    Envi_header_t envi_hdr;  /* output ENVI header information */
+
+    /* Create the ENVI header file for this band */
+    if (create_envi_struct (bmeta, gmeta, &envi_hdr) != SUCCESS)
+    {
+        sprintf (errmsg, "Creating the ENVI header structure for this "
+            "file: %s", bmeta->file_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    strcpy (envi_file, bmeta->file_name);
+    cptr = strrchr (envi_file, '.');
+    strcpy (cptr, ".hdr");
+    if (write_envi_hdr (envi_file, &envi_hdr) != SUCCESS)
+    {
+        sprintf (errmsg, "Writing the ENVI header file: %s.", envi_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  write_warp_band
+
+PURPOSE: Warps a band read into memory to its output raw binary file, a
+stripe at a time, and writes its ENVI header.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error warping the band
+SUCCESS         Successfully warped the band
+
+NOTES:
+  1. The tiles of each stripe are warped in parallel.  Transformations using
+     the original gctp interface aren't threadsafe, so they keep the tiles
+     on one thread.
+******************************************************************************/
+static int write_warp_band
+(
+    Warp_band_t *band,       /* I/O: band being warped, with its input read */
+    Espa_band_meta_t *bmeta, /* I/O: metadata of the output band; the
+                                     checksum and statistics are set */
+    Espa_global_meta_t *gmeta  /* I: global metadata of the output */
+)
+{
+    char FUNC_NAME[] = "write_warp_band";   /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    int status = SUCCESS;    /* return status */
+    int ntiles;              /* number of tiles in a stripe */
+    int max_workers;         /* most workers of the tiles */
+    Raw_binary_writer_t *writer = NULL;  /* writer of the output band */
+
+    ntiles = (band->out.nsamps + WARP_TILE_SAMPS - 1) / WARP_TILE_SAMPS;
+    max_workers = ias_geo_is_threadsafe_transformation (band->trans) ? 0 : 1;
+    band->tile = calloc (espa_parallel_for_workers (ntiles, max_workers),
+        sizeof (Warp_tile_t));
+    band->stripe = espa_trace_malloc ((size_t) WARP_TILE_LINES *
+        band->out.nsamps * band->size);
+    writer = open_raw_binary_writer (bmeta->file_name,
+        (size_t) band->out.nlines * band->out.nsamps * band->size, 0);
+    if (band->tile == NULL || band->stripe == NULL || writer == NULL ||
+        start_raw_binary_writer_stats (writer, bmeta) != SUCCESS ||
+        start_raw_binary_writer_sparse (writer, bmeta, RB_SPARSE_FROM_ENV)
+        != SUCCESS)
+    {
+        sprintf (errmsg, "Opening the output band %s", bmeta->file_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        status = ERROR;
+    }
+
+    for (band->line0 = 0; status == SUCCESS &&
+        band->line0 < band->out.nlines; band->line0 += WARP_TILE_LINES)
+    {
+        band->nlines = min (WARP_TILE_LINES, band->out.nlines - band->line0);
+        status = espa_parallel_for (ntiles, max_workers, warp_tile_task,
+            band);
+        if (status == SUCCESS && append_raw_binary_writer (writer,
+            band->nlines, band->out.nsamps, band->size, band->stripe)
+            != SUCCESS)
+        {
+            sprintf (errmsg, "Writing lines %d-%d of %s", band->line0,
+                band->line0 + band->nlines - 1, bmeta->file_name);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+        }
+    }
+
+    free (band->tile);
+    espa_trace_free (band->stripe);
+    band->tile = NULL;
+    band->stripe = NULL;
+    if (writer != NULL)
+    {
+        if (status == SUCCESS)
+        {
+            get_raw_binary_writer_checksum (writer, bmeta->checksum);
+            get_raw_binary_writer_stats (writer, &bmeta->stats);
+        }
+        if (close_raw_binary_writer (writer) != SUCCESS)
+        {
+            sprintf (errmsg, "Closing the output band %s", bmeta->file_name);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+        }
+    }
+    if (status != SUCCESS)
+        return (ERROR);
+
+    return (write_warp_envi_header (bmeta, gmeta));
+}
+
+
+/******************************************************************************
+MODULE:  write_warp_band_ranks
+
+PURPOSE: Warps the stripes of a band read into memory which belong to the
+calling rank of an MPI job, writing them in place in the output raw binary
+file.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error warping the stripes of the rank
+SUCCESS         Successfully warped the stripes of the rank
+
+NOTES:
+  1. A collective call.  The root rank creates the output file at its full
+     size before the others open it.
+  2. The checksum and statistics of the band need all its stripes, so they
+     are left for record_warp_band_sums.
+******************************************************************************/
+static int write_warp_band_ranks
+(
+    Warp_band_t *band,       /* I/O: band being warped, with its input read */
+    Espa_band_meta_t *bmeta  /* I: metadata of the output band */
+)
+{
+    char FUNC_NAME[] = "write_warp_band_ranks";   /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    int status = SUCCESS;    /* return status */
+    int fd = ERROR;          /* output band file */
+    int ntiles;              /* number of tiles in a stripe */
+    int nstripes;            /* number of stripes in the band */
+    int first;               /* first stripe of the rank */
+    int count;               /* number of stripes of the rank */
+    int stripe;              /* looping variable for the stripes */
+    int max_workers;         /* most workers of the tiles */
+
+    /* Create the output file at its full size */
+    if (espa_mpi_rank () == ESPA_MPI_ROOT)
+    {
+        fd = open_raw_binary_fd (bmeta->file_name, true);
+        if (fd == ERROR || ftruncate (fd, (off_t) band->out.nlines *
+            band->out.nsamps * band->size) != 0)
+        {
+            sprintf (errmsg, "Creating the output band %s",
+                bmeta->file_name);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+        }
+        if (fd != ERROR)
+            close_raw_binary_fd (fd);
+    }
+    if (espa_mpi_agree (status) != SUCCESS)
+        return (ERROR);
+
+    ntiles = (band->out.nsamps + WARP_TILE_SAMPS - 1) / WARP_TILE_SAMPS;
+    nstripes = (band->out.nlines + WARP_TILE_LINES - 1) / WARP_TILE_LINES;
+    espa_mpi_split (nstripes, &first, &count);
+    max_workers = ias_geo_is_threadsafe_transformation (band->trans) ? 0 : 1;
+    band->tile = calloc (espa_parallel_for_workers (ntiles, max_workers),
+        sizeof (Warp_tile_t));
+    band->stripe = espa_trace_malloc ((size_t) WARP_TILE_LINES *
+        band->out.nsamps * band->size);
+    fd = open_raw_binary_fd (bmeta->file_name, true);
+    if (band->tile == NULL || band->stripe == NULL || fd == ERROR)
+    {
+        sprintf (errmsg, "Opening the output band %s", bmeta->file_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        status = ERROR;
+    }
+
+    for (stripe = first; status == SUCCESS && stripe < first + count;
+        stripe++)
+    {
+        band->line0 = stripe * WARP_TILE_LINES;
+        band->nlines = min (WARP_TILE_LINES, band->out.nlines - band->line0);
+        status = espa_parallel_for (ntiles, max_workers, warp_tile_task,
+            band);
+        if (status == SUCCESS && write_raw_binary_window (fd,
+            band->out.nsamps, band->line0, band->nlines, 0,
+            band->out.nsamps, band->size, band->stripe) != SUCCESS)
+        {
+            sprintf (errmsg, "Writing lines %d-%d of %s", band->line0,
+                band->line0 + band->nlines - 1, bmeta->file_name);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+        }
+    }
+
+    free (band->tile);
+    espa_trace_free (band->stripe);
+    band->tile = NULL;
+    band->stripe = NULL;
+    if (fd != ERROR)
+        close_raw_binary_fd (fd);
+
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  record_warp_band_sums
+
+PURPOSE: Reads a warped band back to record its checksum and statistics in
+its metadata, once every rank has written its stripes.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error reading the band
+SUCCESS         Successfully recorded the checksum and statistics
+
+NOTES:
+  1. The band stack records the checksum and statistics of a band which has
+     none as it is read (see espa_band_stack.h).
+******************************************************************************/
+static int record_warp_band_sums
+(
+    Espa_internal_meta_t *xml_metadata, /* I/O: metadata of the output
+                                                product */
+    int band                 /* I: index of the warped band */
+)
+{
+    char FUNC_NAME[] = "record_warp_band_sums";   /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    int status = SUCCESS;    /* return status */
+    Espa_band_meta_t *bmeta = &xml_metadata->band[band];
+    Espa_band_stack_t *stack = NULL;  /* stack with just the band */
+    Espa_band_block_t *block = NULL;  /* current block of the band */
+
+    strcpy (bmeta->checksum, ESPA_STRING_META_FILL);
+    bmeta->stats.valid_count = ESPA_INT_META_FILL;
+    stack = open_band_stack (xml_metadata, 1, &band,
+        RB_PREFETCH_DEFAULT_LINES, 0);
+    if (stack == NULL)
+        status = ERROR;
+    while (status == SUCCESS)
+    {
+        status = get_band_stack_block (stack, &block);
+        if (block == NULL)
+            break;
+    }
+    if (stack != NULL)
+        close_band_stack (stack);
+    if (status != SUCCESS)
+    {
+        sprintf (errmsg, "Reading back the output band %s",
+            bmeta->file_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  transform_grid_edges
+
+PURPOSE: Transforms the outer edges of the pixels of a grid and returns the
+range of the transformed points.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           An edge point could not be transformed
+SUCCESS         Successfully transformed the edges
+
+NOTES:
+  1. The edges are transformed every WARP_EDGE_STEP pixels and at the
+     corners, in one call.  A projection whose extreme lies inside the grid
+     (ex. a pole) isn't caught.
+******************************************************************************/
+static int transform_grid_edges
+(
+    const Warp_grid_t *grid, /* I: grid of the band */
+    IAS_GEO_PROJ_TRANSFORMATION *trans, /* I: transformation from the
+                                               projection of the grid */
+    double *min_x,           /* O: smallest transformed x */
+    double *max_x,           /* O: largest transformed x */
+    double *min_y,           /* O: smallest transformed y */
+    double *max_y            /* O: largest transformed y */
+)
+{
+    char FUNC_NAME[] = "transform_grid_edges";   /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    int nline_pts;           /* number of points along the left edge */
+    int nsamp_pts;           /* number of points along the top edge */
+    int npts = 0;            /* number of points */
+    int i;                   /* looping variable */
+    int status;              /* return status */
+    double pos;              /* line or sample of the current point */
+    double *x = NULL;        /* x of the points */
+    double *y = NULL;        /* y of the points */
+    double *out_x = NULL;    /* transformed x of the points */
+    double *out_y = NULL;    /* transformed y of the points */
+
+    nline_pts = grid->nlines / WARP_EDGE_STEP + 2;
+    nsamp_pts = grid->nsamps / WARP_EDGE_STEP + 2;
+    x = malloc (4 * (nline_pts + nsamp_pts) * sizeof (double));
+    y = malloc (4 * (nline_pts + nsamp_pts) * sizeof (double));
+    if (x == NULL || y == NULL)
+    {
+        sprintf (errmsg, "Allocating the edge points");
+        error_handler (true, FUNC_NAME, errmsg);
+        free (x);
+        free (y);
+        return (ERROR);
+    }
+    out_x = x + 2 * (nline_pts + nsamp_pts);
+    out_y = y + 2 * (nline_pts + nsamp_pts);
+
+    /* Top and bottom edges, then the left and right edges */
+    for (i = 0; i < nsamp_pts; i++)
+    {
+        pos = min (i * WARP_EDGE_STEP, grid->nsamps) - 0.5;
+        x[npts] = x[npts+1] = grid->ul_x + pos * grid->pixel_size[0];
+        y[npts++] = grid->ul_y + 0.5 * grid->pixel_size[1];
+        y[npts++] = grid->ul_y - (grid->nlines - 0.5) * grid->pixel_size[1];
+    }
+    for (i = 0; i < nline_pts; i++)
+    {
+        pos = min (i * WARP_EDGE_STEP, grid->nlines) - 0.5;
+        y[npts] = y[npts+1] = grid->ul_y - pos * grid->pixel_size[1];
+        x[npts++] = grid->ul_x - 0.5 * grid->pixel_size[0];
+        x[npts++] = grid->ul_x + (grid->nsamps - 0.5) * grid->pixel_size[0];
+    }
+
+    status = ias_geo_transform_coordinates (trans, npts, x, y, out_x, out_y);
+    if (status == SUCCESS)
+    {
+        *min_x = *max_x = out_x[0];
+        *min_y = *max_y = out_y[0];
+        for (i = 1; i < npts; i++)
+        {
+            *min_x = fmin (*min_x, out_x[i]);
+            *max_x = fmax (*max_x, out_x[i]);
+            *min_y = fmin (*min_y, out_y[i]);
+            *max_y = fmax (*max_y, out_y[i]);
+        }
+    }
+    else
+    {
+        sprintf (errmsg, "Transforming the edges of the grid");
+        error_handler (true, FUNC_NAME, errmsg);
+    }
+
+    free (x);
+    free (y);
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  warp_reference_band
+
+PURPOSE: Returns the reference band, whose grid the projection corners
+describe.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+n               Index of band1 for Landsat, B02 for Sentinel-2, otherwise
+                the first band
+
+NOTES:
+  1. Follows get_geoloc_info.
+******************************************************************************/
+static int warp_reference_band
+(
+    const Espa_internal_meta_t *xml_metadata  /* I: metadata of the product */
+)
+{
+    int i;                   /* looping variable for the bands */
+
+    for (i = 0; i < xml_metadata->nbands; i++)
+    {
+        if ((!strcmp (xml_metadata->band[i].name, "band1") &&
+             !strncmp (xml_metadata->band[i].product, "L1", 2)) ||
+            (!strcmp (xml_metadata->band[i].name, "B02") &&
+             !strncmp (xml_metadata->band[i].product, "MSIL1C", 2)))
+            return (i);
+    }
+
+    return (0);
+}
+
+
+/******************************************************************************
+MODULE:  band_resampling
+
+PURPOSE: Returns the resampling of a band.
+
+RETURN VALUE:
+Type = enum Espa_resampling_type
+Value           Description
+-----           -----------
+ESPA_NN         Nearest neighbor
+ESPA_BI         Bilinear interpolation
+ESPA_CC         Cubic convolution
+******************************************************************************/
+static enum Espa_resampling_type band_resampling
+(
+    const Espa_band_meta_t *bmeta,  /* I: metadata of the band */
+    enum Espa_resampling_type resample  /* I: resampling of all the bands;
+                                              ESPA_NONE for the band's */
+)
+{
+    if (resample == ESPA_NONE)
+        resample = bmeta->resample_method;
+    if (resample != ESPA_BI && resample != ESPA_CC)
+        resample = ESPA_NN;
+    return (resample);
+}
+
+
+/******************************************************************************
+MODULE:  warp_data_type_supported
+
+PURPOSE: Determines if the pixels of a data type can be warped, i.e. they
+survive the conversion to 32-bit floats.
+
+RETURN VALUE:
+Type = bool
+Value      Description
+-----      -----------
+true       The 8 and 16-bit integer and the 32-bit float data types
+false      The other data types
+******************************************************************************/
+static bool warp_data_type_supported
+(
+    enum Espa_data_type data_type  /* I: data type of a band */
+)
+{
+    return (data_type == ESPA_INT8 || data_type == ESPA_UINT8 ||
+        data_type == ESPA_INT16 || data_type == ESPA_UINT16 ||
+        data_type == ESPA_FLOAT32);
+}
+
+
+/******************************************************************************
+MODULE:  setup_warp_input
+
+PURPOSE: Sets up the grid of each input band and checks that its data type
+can be warped.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           A band can't be warped
+SUCCESS         Successfully set up the input grids
+
+NOTES:
+  1. The bands share the UL edges of the reference band.
+******************************************************************************/
+static int setup_warp_input
+(
+    const Espa_internal_meta_t *xml_metadata, /* I: metadata of the input */
+    Warp_grid_t *in_grid     /* O: grid of each input band */
+)
+{
+    char FUNC_NAME[] = "setup_warp_input";   /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    int i;                   /* looping variable for the bands */
+    int ref;                 /* index of the reference band */
+    double ul_x, ul_y;       /* projection UL edges of the input */
+    const Espa_band_meta_t *bmeta = NULL;  /* metadata of the current band */
+
+    ref = warp_reference_band (xml_metadata);
+    ul_x = xml_metadata->global.proj_info.ul_corner[0];
+    ul_y = xml_metadata->global.proj_info.ul_corner[1];
+    if (!strcmp (xml_metadata->global.proj_info.grid_origin, "CENTER"))
+    {
+        ul_x -= 0.5 * xml_metadata->band[ref].pixel_size[0];
+        ul_y += 0.5 * xml_metadata->band[ref].pixel_size[1];
+    }
+    for (i = 0; i < xml_metadata->nbands; i++)
+    {
+        bmeta = &xml_metadata->band[i];
+        in_grid[i].pixel_size[0] = bmeta->pixel_size[0];
+        in_grid[i].pixel_size[1] = bmeta->pixel_size[1];
+        in_grid[i].ul_x = ul_x + 0.5 * bmeta->pixel_size[0];
+        in_grid[i].ul_y = ul_y - 0.5 * bmeta->pixel_size[1];
+        in_grid[i].nlines = bmeta->nlines;
+        in_grid[i].nsamps = bmeta->nsamps;
+
+        if (!is_constant_band (bmeta) &&
+            !warp_data_type_supported (bmeta->data_type))
+        {
+            sprintf (errmsg, "Warping the data type of band %s isn't "
+                "supported", bmeta->name);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  setup_warp_output
+
+PURPOSE: Sets up the output grid of each band and updates the projection,
+corners, and bounding coordinates of the product to the warp.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error setting up the output
+SUCCESS         Successfully set up the output
+
+NOTES:
+  1. The output extent covers the edges of the input reference band
+     transformed to the target projection, unless it is given.  It is
+     widened right and down to whole pixels of the coarsest band, keeping
+     the UL corner, so a warp to the input projection keeps the input
+     grid.
+  2. The corners keep the grid origin (CENTER or UL) of the input.
+  3. The footprint polygon of the input doesn't outline the output, so it is
+     cleared; clip_band_misalignment records a new one.
+******************************************************************************/
+static int setup_warp_output
+(
+    Espa_internal_meta_t *xml_metadata, /* I/O: metadata of the product */
+    Espa_warp_options_t *options,  /* I: options of the warp */
+    const IAS_PROJECTION *in_proj, /* I: projection of the input */
+    const IAS_PROJECTION *out_proj, /* I: projection of the output */
+    const Warp_grid_t *in_grid,    /* I: grid of each input band */
+    Warp_grid_t *out_grid          /* O: grid of each output band */
+)
+{
+    char FUNC_NAME[] = "setup_warp_output";   /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    int ref;                 /* index of the reference band */
+    int i;                   /* looping variable */
+    int nbands = xml_metadata->nbands;  /* number of bands */
+    int status = SUCCESS;    /* return status */
+    double ulx, uly, lrx, lry;  /* edges of the output */
+    double coarse[2];        /* x and y pixel size of the coarsest band */
+    double ratio[2];         /* ratio of a band to the reference band */
+    double min_x, max_x, min_y, max_y;  /* range of the transformed edges */
+    double parms[IAS_PROJ_PARAM_SIZE];  /* geographic projection parameters */
+    double corner_x[2];      /* projection x of the UL and LR corners */
+    double corner_y[2];      /* projection y of the UL and LR corners */
+    double corner_lon[2];    /* longitude of the UL and LR corners */
+    double corner_lat[2];    /* latitude of the UL and LR corners */
+    Espa_global_meta_t *gmeta = &xml_metadata->global;  /* global metadata */
+    Espa_proj_meta_t *proj_info = &gmeta->proj_info;  /* projection info */
+    IAS_PROJECTION geographic;  /* geographic projection */
+    IAS_GEO_PROJ_TRANSFORMATION *trans = NULL;  /* transformation */
+    Warp_grid_t *out_ref;    /* output grid of the reference band */
+
+    ref = warp_reference_band (xml_metadata);
+    out_ref = &out_grid[ref];
+
+    /* The coarsest band sets the alignment of the extent */
+    coarse[0] = options->pixel_size[0];
+    coarse[1] = options->pixel_size[1];
+    for (i = 0; i < nbands; i++)
+    {
+        ratio[0] = in_grid[i].pixel_size[0] / in_grid[ref].pixel_size[0];
+        ratio[1] = in_grid[i].pixel_size[1] / in_grid[ref].pixel_size[1];
+        out_grid[i].pixel_size[0] = options->pixel_size[0] * ratio[0];
+        out_grid[i].pixel_size[1] = options->pixel_size[1] * ratio[1];
+        coarse[0] = fmax (coarse[0], out_grid[i].pixel_size[0]);
+        coarse[1] = fmax (coarse[1], out_grid[i].pixel_size[1]);
+    }
+
+    if (options->extent_set)
+    {
+        if (options->lrx <= options->ulx || options->uly <= options->lry)
+        {
+            sprintf (errmsg, "The UL corner (%f, %f) of the extent needs to "
+                "be left of and above the LR corner (%f, %f)", options->ulx,
+                options->uly, options->lrx, options->lry);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+        ulx = options->ulx;
+        uly = options->uly;
+        lrx = ulx + ceil ((options->lrx - ulx) / coarse[0] - WARP_EPSILON) *
+            coarse[0];
+        lry = uly - ceil ((uly - options->lry) / coarse[1] - WARP_EPSILON) *
+            coarse[1];
+    }
+    else
+    {
+        trans = ias_geo_get_cached_proj_transformation (in_proj, out_proj);
+        if (trans == NULL)
+        {
+            sprintf (errmsg, "Creating the transformation to the target "
+                "projection");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+        status = transform_grid_edges (&in_grid[ref], trans, &min_x, &max_x,
+            &min_y, &max_y);
+        ias_geo_release_cached_proj_transformation (trans);
+        if (status != SUCCESS)
+        {
+            sprintf (errmsg, "Finding the extent of the input in the target "
+                "projection");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+        ulx = min_x;
+        uly = max_y;
+        lrx = ulx + ceil ((max_x - ulx) / coarse[0] - WARP_EPSILON) *
+            coarse[0];
+        lry = uly - ceil ((uly - min_y) / coarse[1] - WARP_EPSILON) *
+            coarse[1];
+    }
+
+    /* Grids of the output bands, sharing the UL corner */
+    for (i = 0; i < nbands; i++)
+    {
+        out_grid[i].nlines = (int) floor ((uly - lry) /
+            out_grid[i].pixel_size[1] + 0.5);
+        out_grid[i].nsamps = (int) floor ((lrx - ulx) /
+            out_grid[i].pixel_size[0] + 0.5);
+        out_grid[i].ul_x = ulx + 0.5 * out_grid[i].pixel_size[0];
+        out_grid[i].ul_y = uly - 0.5 * out_grid[i].pixel_size[1];
+        if (out_grid[i].nlines <= 0 || out_grid[i].nsamps <= 0)
+        {
+            sprintf (errmsg, "The output of band %s would be empty",
+                xml_metadata->band[i].name);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+    }
+
+    /* Update the projection and its corners */
+    proj_info->proj_type = options->proj_info.proj_type;
+    proj_info->datum_type = options->proj_info.datum_type;
+    proj_info->utm_zone = options->proj_info.utm_zone;
+    proj_info->longitude_pole = options->proj_info.longitude_pole;
+    proj_info->latitude_true_scale = options->proj_info.latitude_true_scale;
+    proj_info->false_easting = options->proj_info.false_easting;
+    proj_info->false_northing = options->proj_info.false_northing;
+    proj_info->standard_parallel1 = options->proj_info.standard_parallel1;
+    proj_info->standard_parallel2 = options->proj_info.standard_parallel2;
+    proj_info->central_meridian = options->proj_info.central_meridian;
+    proj_info->origin_latitude = options->proj_info.origin_latitude;
+    proj_info->sphere_radius = options->proj_info.sphere_radius;
+    strcpy (proj_info->units, proj_info->proj_type == GCTP_GEO_PROJ ?
+        "degrees" : "meters");
+    if (!strcmp (proj_info->grid_origin, "CENTER"))
+    {
+        proj_info->ul_corner[0] = out_ref->ul_x;
+        proj_info->ul_corner[1] = out_ref->ul_y;
+        proj_info->lr_corner[0] = out_ref->ul_x + (out_ref->nsamps - 1) *
+            out_ref->pixel_size[0];
+        proj_info->lr_corner[1] = out_ref->ul_y - (out_ref->nlines - 1) *
+            out_ref->pixel_size[1];
+    }
+    else
+    {
+        proj_info->ul_corner[0] = ulx;
+        proj_info->ul_corner[1] = uly;
+        proj_info->lr_corner[0] = ulx + (out_ref->nsamps - 1) *
+            out_ref->pixel_size[0];
+        proj_info->lr_corner[1] = uly - (out_ref->nlines - 1) *
+            out_ref->pixel_size[1];
+    }
+
+    /* Geographic corners and bounding coordinates of the output */
+    for (i = 0; i < IAS_PROJ_PARAM_SIZE; i++)
+        parms[i] = 0.0;
+    if (out_proj->spheroid < 0)
+    {   /* Keep the sphere or ellipsoid given by the parameters */
+        parms[0] = out_proj->parameters[0];
+        parms[1] = out_proj->parameters[1];
+    }
+    ias_geo_set_projection (GEO, NULLZONE, DEGREE, out_proj->spheroid, parms,
+        &geographic);
+    trans = ias_geo_get_cached_proj_transformation (out_proj, &geographic);
+    if (trans == NULL)
+    {
+        sprintf (errmsg, "Creating the transformation to geographic");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    corner_x[0] = proj_info->ul_corner[0];
+    corner_y[0] = proj_info->ul_corner[1];
+    corner_x[1] = proj_info->lr_corner[0];
+    corner_y[1] = proj_info->lr_corner[1];
+    status = ias_geo_transform_coordinates (trans, 2, corner_x, corner_y,
+        corner_lon, corner_lat);
+    if (status == SUCCESS)
+        status = transform_grid_edges (out_ref, trans, &min_x, &max_x,
+            &min_y, &max_y);
+    ias_geo_release_cached_proj_transformation (trans);
+    if (status != SUCCESS)
+    {
+        sprintf (errmsg, "Computing the geographic corners and bounding "
+            "coordinates of the output");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    gmeta->ul_corner[0] = corner_lat[0];
+    gmeta->ul_corner[1] = corner_lon[0];
+    gmeta->lr_corner[0] = corner_lat[1];
+    gmeta->lr_corner[1] = corner_lon[1];
+    gmeta->bounding_coords[ESPA_WEST] = min_x;
+    gmeta->bounding_coords[ESPA_EAST] = max_x;
+    gmeta->bounding_coords[ESPA_NORTH] = max_y;
+    gmeta->bounding_coords[ESPA_SOUTH] = min_y;
+    strcpy (gmeta->footprint, ESPA_STRING_META_FILL);
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  init_espa_warp_options
+
+PURPOSE: Initializes the options of a warp to those of the input: the same
+projection and datum, at the same pixel size, covering the input, with the
+resampling of each band.
+
+RETURN VALUE: None
+******************************************************************************/
+void init_espa_warp_options
+(
+    Espa_warp_options_t *options  /* O: options of a warp to the projection
+                                        of the input, at the input pixel
+                                        size */
+)
+{
+    memset (options, 0, sizeof (*options));
+    options->proj_info.proj_type = ESPA_INT_META_FILL;
+    options->proj_info.datum_type = ESPA_INT_META_FILL;
+    options->resample = ESPA_NONE;
+    options->max_error = WARP_DEFAULT_MAX_ERROR;
+}
+
+
+/******************************************************************************
+MODULE:  warp_espa_product
+
+PURPOSE: Warps an ESPA product to another projection, writing the resampled
+pixels of each band to a new raw binary file and the updated metadata to a
+new XML file.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error warping the product
+SUCCESS         Successfully warped the product
+
+NOTES:
+  1. The output bands are named <base>_<band name>.img, where <base> is the
+     output XML filename without its extension.
+  2. A proj_type of ESPA_INT_META_FILL keeps the projection of the input, so
+     the product is only resampled; a datum_type of ESPA_INT_META_FILL keeps
+     the datum of the input.
+  3. The projection, corners, bounding coordinates, band sizes, pixel sizes,
+     and resampling methods are updated.  The footprint indexes and
+     overviews of the input don't match the output, so they are dropped.
+  4. Constant bands have no raw binary file, so only their grid changes.
+  5. Rotated grids (orientation angle other than 0) aren't supported.
+  6. Run under MPI, every rank calls it with the same arguments.  The ranks
+     agree on the status of each band, so they all fail together.
+******************************************************************************/
+int warp_espa_product
+(
+    char *xml_infile,       /* I: input XML metadata filename */
+    char *xml_outfile,      /* I: output XML metadata filename; also the base
+                                  name of the output band files */
+    Espa_warp_options_t *options  /* I: options of the warp */
+)
+{
+    char FUNC_NAME[] = "warp_espa_product";   /* function name */
+    char errmsg[STR_SIZE];  /* error message */
+    char out_base[STR_SIZE];   /* base name of the output files */
+    char in_file[STR_SIZE]; /* input raw binary file of the band */
+    char *cptr = NULL;      /* pointer to the file extension */
+    const char *units;      /* pixel units of the output */
+    int i;                  /* looping variable for the bands */
+    int ref;                /* index of the reference band */
+    int nbands;             /* number of bands in the product */
+    int count;              /* number of chars copied in snprintf */
+    int status = SUCCESS;   /* status of all the bands */
+    bool root;              /* is this the root rank (or the only one)? */
+    static const char *method_name[] = {"cubic convolution", "nearest "
+        "neighbor", "bilinear"};  /* names of the ESPA_CC, ESPA_NN, and
+                                     ESPA_BI resampling */
+    enum Espa_resampling_type method;  /* resampling of the current band */
+    Espa_internal_meta_t xml_metadata;  /* metadata of the product */
+    Espa_band_meta_t *bmeta = NULL;     /* metadata of the current band */
+    Espa_warp_options_t opts = *options;  /* options, with the defaults
+                                             filled in */
+    IAS_PROJECTION in_proj; /* projection of the input */
+    IAS_PROJECTION out_proj;  /* projection of the output */
+    Warp_grid_t *in_grid = NULL;   /* grid of each input band */
+    Warp_grid_t *out_grid = NULL;  /* grid of each output band */
+    Warp_band_t band;       /* band being warped */
+
+    /* Determine the base name of the output files */
+    count = snprintf (out_base, sizeof (out_base), "%s", xml_outfile);
+    if (count < 0 || count >= sizeof (out_base))
+    {
+        sprintf (errmsg, "Overflow of out_base string");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    cptr = strrchr (out_base, '.');
+    if (cptr != NULL && strchr (cptr, '/') == NULL)
+        *cptr = '\0';
+
+    if (!strcmp (xml_infile, xml_outfile))
+    {
+        sprintf (errmsg, "The output XML file needs to differ from the input "
+            "XML file %s", xml_infile);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Validate and parse the input metadata */
+    init_metadata_struct (&xml_metadata);
+    if (validate_and_parse_metadata_collective (xml_infile, &xml_metadata)
+        != SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+    nbands = xml_metadata.nbands;
+    ref = warp_reference_band (&xml_metadata);
+    memset (&band, 0, sizeof (band));
+
+    if (fabs (xml_metadata.global.orientation_angle) > ESPA_EPSILON)
+    {
+        sprintf (errmsg, "Warping rotated grids (orientation angle %f) "
+            "isn't supported", xml_metadata.global.orientation_angle);
+        error_handler (true, FUNC_NAME, errmsg);
+        free_metadata (&xml_metadata);
+        return (ERROR);
+    }
+
+    /* Fill in the defaults of the options from the input */
+    if (opts.proj_info.proj_type == ESPA_INT_META_FILL)
+        opts.proj_info = xml_metadata.global.proj_info;
+    if (opts.proj_info.datum_type == ESPA_INT_META_FILL)
+        opts.proj_info.datum_type = xml_metadata.global.proj_info.datum_type;
+    if (opts.pixel_size[0] <= 0.0 || opts.pixel_size[1] <= 0.0)
+    {
+        if ((opts.proj_info.proj_type == GCTP_GEO_PROJ) !=
+            (xml_metadata.global.proj_info.proj_type == GCTP_GEO_PROJ))
+        {
+            sprintf (errmsg, "The pixel size is needed to warp between "
+                "geographic and projected coordinates");
+            error_handler (true, FUNC_NAME, errmsg);
+            free_metadata (&xml_metadata);
+            return (ERROR);
+        }
+        opts.pixel_size[0] = xml_metadata.band[ref].pixel_size[0];
+        opts.pixel_size[1] = xml_metadata.band[ref].pixel_size[1];
+    }
+
+    if (get_scene_projection (&xml_metadata.global.proj_info, &in_proj)
+        != SUCCESS || get_scene_projection (&opts.proj_info, &out_proj)
+        != SUCCESS)
+    {  /* Error messages already written */
+        free_metadata (&xml_metadata);
+        return (ERROR);
+    }
+
+    /* Grids of the input bands, sharing the UL edges of the reference
+       band */
+    in_grid = calloc (nbands + 1, sizeof (Warp_grid_t));
+    out_grid = calloc (nbands + 1, sizeof (Warp_grid_t));
+    if (in_grid == NULL || out_grid == NULL)
+    {
+        sprintf (errmsg, "Allocating the band grids");
+        error_handler (true, FUNC_NAME, errmsg);
+        status = ERROR;
+        goto done;
+    }
+    if (setup_warp_input (&xml_metadata, in_grid) != SUCCESS)
+    {  /* Error messages already written */
+        status = ERROR;
+        goto done;
+    }
+
+    if (setup_warp_output (&xml_metadata, &opts, &in_proj, &out_proj,
+        in_grid, out_grid) != SUCCESS)
+    {  /* Error messages already written */
+        status = ERROR;
+        goto done;
+    }
+    root = espa_mpi_rank () == ESPA_MPI_ROOT;
+    if (root)
+        printf ("  Warping to %d lines and %d samples of the reference "
+            "band\n", out_grid[ref].nlines, out_grid[ref].nsamps);
+
+    band.trans = ias_geo_get_cached_proj_transformation (&out_proj,
+        &in_proj);
+    if (band.trans == NULL)
+    {
+        sprintf (errmsg, "Creating the transformation to the input "
+            "projection");
+        error_handler (true, FUNC_NAME, errmsg);
+        status = ERROR;
+        goto done;
+    }
+
+    /* Warp the bands one at a time, each read in full and written a stripe
+       of tiles at a time */
+    units = xml_metadata.global.proj_info.units;
+    for (i = 0; i < nbands; i++)
+    {
+        bmeta = &xml_metadata.band[i];
+        method = band_resampling (bmeta, opts.resample);
+        strcpy (in_file, bmeta->file_name);
+
+        if (!is_constant_band (bmeta))
+        {
+            status = read_warp_source (&xml_metadata, i, &band.src);
+            if (espa_mpi_agree (status) != SUCCESS)
+            {  /* Error messages already written */
+                if (status == SUCCESS)
+                    espa_trace_free ((void *) band.src.pix);
+                status = ERROR;
+                goto done;
+            }
+        }
+
+        /* Point the band to its output grid and file */
+        bmeta->nlines = out_grid[i].nlines;
+        bmeta->nsamps = out_grid[i].nsamps;
+        bmeta->pixel_size[0] = out_grid[i].pixel_size[0];
+        bmeta->pixel_size[1] = out_grid[i].pixel_size[1];
+        strcpy (bmeta->pixel_units, units);
+        bmeta->resample_method = method;
+        strcpy (bmeta->footprint_file, ESPA_STRING_META_FILL);
+        strcpy (bmeta->overview_file, ESPA_STRING_META_FILL);
+        bmeta->overview_levels = 0;
+        if (is_constant_band (bmeta))
+            continue;
+
+        count = snprintf (bmeta->file_name, sizeof (bmeta->file_name),
+            "%s_%s.img", out_base, bmeta->name);
+        if (count < 0 || count >= sizeof (bmeta->file_name) ||
+            !strcmp (bmeta->file_name, in_file))
+        {
+            sprintf (errmsg, "Naming the output of band %s", bmeta->name);
+            error_handler (true, FUNC_NAME, errmsg);
+            espa_trace_free ((void *) band.src.pix);
+            status = ERROR;
+            goto done;
+        }
+        strcpy (bmeta->encoding, ESPA_STRING_META_FILL);
+        bmeta->tile_size = 0;
+        bmeta->file_offset = 0;
+
+        band.in = in_grid[i];
+        band.out = out_grid[i];
+        band.tolerance = opts.max_error;
+        band.data_type = bmeta->data_type;
+        band.size = espa_data_type_size (bmeta->data_type);
+        band.kernel = method == ESPA_CC ? warp_kernels[WARP_CUBIC] :
+            method == ESPA_BI ? warp_kernels[WARP_BILINEAR] :
+            warp_kernels[WARP_NEAREST];
+        if ((size_t) band.src.nlines * band.src.nsamps > INT_MAX)
+        {
+            band.kernel = method == ESPA_CC ? warp_scalar_kernels[WARP_CUBIC] :
+                method == ESPA_BI ? warp_scalar_kernels[WARP_BILINEAR] :
+                warp_scalar_kernels[WARP_NEAREST];
+        }
+
+        if (root)
+            printf ("  Band %d: %s to %s (%s)\n", i, in_file,
+                bmeta->file_name, method_name[method]);
+        if (espa_mpi_size () > 1)
+        {
+            /* Each rank warps its stripes, then the root finishes the
+               band */
+            status = espa_mpi_agree (write_warp_band_ranks (&band, bmeta));
+            if (status == SUCCESS && root)
+            {
+                status = record_warp_band_sums (&xml_metadata, i);
+                if (status == SUCCESS)
+                    status = write_warp_envi_header (bmeta,
+                        &xml_metadata.global);
+            }
+        }
+        else
+            status = write_warp_band (&band, bmeta, &xml_metadata.global);
+        status = espa_mpi_agree (status);
+        espa_trace_free ((void *) band.src.pix);
+        band.src.pix = NULL;
+        if (status != SUCCESS)
+        {
+            sprintf (errmsg, "Warping band %d: %s", i, in_file);
+            error_handler (true, FUNC_NAME, errmsg);
+            goto done;
+        }
+    }
+
+    /* Write and validate the output metadata */
+    if (root && (write_metadata (&xml_metadata, xml_outfile) != SUCCESS ||
+        validate_xml_file (xml_outfile) != SUCCESS))
+    {  /* Error messages already written */
+        status = ERROR;
+    }
+    status = espa_mpi_agree (status);
+
+done:
+    if (band.trans != NULL)
+        ias_geo_release_cached_proj_transformation (band.trans);
+    free (in_grid);
+    free (out_grid);
+    free_metadata (&xml_metadata);
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  mosaic_pixel_valid
+
+PURPOSE: Determines if a resampled value of the current input of a mosaic is
+valid, i.e. its point is inside the window read from the input, the value
+isn't fill, and the point is inside the footprint of the input.
+
+RETURN VALUE:
+Type = bool
+Value      Description
+-----      -----------
+true       The value is valid
+false      The value is fill or outside the input
+******************************************************************************/
+static bool mosaic_pixel_valid
+(
+    const Mosaic_band_t *mos, /* I: band being mosaicked */
+    float line,              /* I: window line of the point */
+    float samp,              /* I: window sample of the point */
+    float value              /* I: resampled value of the point */
+)
+{
+    const Warp_source_t *src = &mos->warp.src;  /* window of the input */
+    int first, last;         /* first and last valid sample of the line */
+
+    if (line < -0.5f || samp < -0.5f || line >= src->nlines - 0.5f ||
+        samp >= src->nsamps - 0.5f)
+        return (false);
+    if (src->has_fill && value == src->fill)
+        return (false);
+    if (mos->footprint != NULL)
+    {
+        if (footprint_line_extent (mos->footprint, mos->win_line0 +
+            (int) floorf (line + 0.5f), &first, &last) <= 0)
+            return (false);
+        samp += mos->win_samp0;
+        if (samp < first - 0.5f || samp >= last + 0.5f)
+            return (false);
+    }
+
+    return (true);
+}
+
+
+/******************************************************************************
+MODULE:  mosaic_tile_task
+
+PURPOSE: Warps the current input of a mosaic into one tile of the current
+stripe, keeping the pixels already taken from a previous input, as an
+iteration of the parallel loop over the tiles.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+SUCCESS         Successfully warped the tile
+
+NOTES:
+  1. Tiles outside the samples the input covers, and tile lines which are
+     already complete, aren't mapped.
+******************************************************************************/
+static int mosaic_tile_task
+(
+    void *arg,               /* I/O: band being mosaicked */
+    int index,               /* I: index of the tile in the stripe */
+    int worker               /* I: worker warping the tile */
+)
+{
+    Mosaic_band_t *mos = arg;  /* band being mosaicked */
+    Warp_band_t *band = &mos->warp;  /* band of the current input */
+    Warp_tile_t *tile = &band->tile[worker];  /* buffers of the worker */
+    int line;                /* looping variable for the tile lines */
+    int samp;                /* looping variable for the tile samples */
+    size_t offset;           /* offset of a tile line in the stripe */
+    unsigned char *valid;    /* valid flags of the tile line */
+
+    tile->line0 = band->line0;
+    tile->nlines = band->nlines;
+    tile->samp0 = index * WARP_TILE_SAMPS;
+    tile->nsamps = min (WARP_TILE_SAMPS, band->out.nsamps - tile->samp0);
+    if (tile->samp0 > mos->samp_hi ||
+        tile->samp0 + tile->nsamps - 1 < mos->samp_lo)
+        return (SUCCESS);
+    load_tile_grid (band, tile);
+
+    for (line = 0; line < tile->nlines; line++)
+    {
+        offset = (size_t) line * band->out.nsamps + tile->samp0;
+        valid = &mos->valid[offset];
+        if (memchr (valid, 0, tile->nsamps) == NULL)
+            continue;
+
+        map_tile_line (band, tile, line);
+        band->kernel (&band->src, tile->line, tile->samp, tile->nsamps,
+            tile->value);
+        for (samp = 0; samp < tile->nsamps; samp++)
+        {
+            if (!valid[samp] && mosaic_pixel_valid (mos, tile->line[samp],
+                tile->samp[samp], tile->value[samp]))
+            {
+                mos->value[offset + samp] = tile->value[samp];
+                valid[samp] = 1;
+            }
+        }
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  mosaic_input_window
+
+PURPOSE: Finds the window of an input band which the samples of the current
+stripe covered by the input map to.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           The edges of the stripe could not be transformed
+SUCCESS         Successfully found the window; it is empty (nlines of 0)
+                if the stripe maps to no valid pixels of the input
+
+NOTES:
+  1. The window is widened by MOSAIC_WINDOW_MARGIN pixels for the kernels,
+     then narrowed to the lines and samples holding valid pixels by the
+     footprint index of the band, when there is one.
+******************************************************************************/
+static int mosaic_input_window
+(
+    const Mosaic_band_t *mos, /* I: band being mosaicked, with its input
+                                    set */
+    Warp_grid_t *win,        /* O: grid of the window in the input; its
+                                   first line and sample are in line0 and
+                                   samp0 */
+    int *line0,              /* O: first input line of the window */
+    int *samp0               /* O: first input sample of the window */
+)
+{
+    const Warp_band_t *band = &mos->warp;  /* band of the current input */
+    const Warp_grid_t *in = &band->in;     /* grid of the input band */
+    Warp_grid_t stripe;      /* output grid of the samples of the stripe
+                                covered by the input */
+    int first_line, last_line;  /* lines of the window */
+    int first_samp, last_samp;  /* samples of the window */
+    int fp_first_line = -1;  /* first line of the footprint in the window */
+    int fp_last_line = -1;   /* last line of the footprint in the window */
+    int fp_first_samp = INT_MAX;  /* first sample of the footprint */
+    int fp_last_samp = -1;   /* last sample of the footprint */
+    int first, last;         /* first and last valid sample of a line */
+    int line;                /* looping variable for the lines */
+    double min_x, max_x, min_y, max_y;  /* input range of the stripe */
+
+    win->nlines = 0;
+    stripe.ul_x = band->out.ul_x + mos->samp_lo * band->out.pixel_size[0];
+    stripe.ul_y = band->out.ul_y - band->line0 * band->out.pixel_size[1];
+    stripe.pixel_size[0] = band->out.pixel_size[0];
+    stripe.pixel_size[1] = band->out.pixel_size[1];
+    stripe.nlines = band->nlines;
+    stripe.nsamps = mos->samp_hi - mos->samp_lo + 1;
+    if (transform_grid_edges (&stripe, band->trans, &min_x, &max_x, &min_y,
+        &max_y) != SUCCESS)
+        return (ERROR);
+
+    first_samp = (int) floor ((min_x - in->ul_x) / in->pixel_size[0]) -
+        MOSAIC_WINDOW_MARGIN;
+    last_samp = (int) ceil ((max_x - in->ul_x) / in->pixel_size[0]) +
+        MOSAIC_WINDOW_MARGIN;
+    first_line = (int) floor ((in->ul_y - max_y) / in->pixel_size[1]) -
+        MOSAIC_WINDOW_MARGIN;
+    last_line = (int) ceil ((in->ul_y - min_y) / in->pixel_size[1]) +
+        MOSAIC_WINDOW_MARGIN;
+    if (first_samp < 0)
+        first_samp = 0;
+    if (last_samp > in->nsamps - 1)
+        last_samp = in->nsamps - 1;
+    if (first_line < 0)
+        first_line = 0;
+    if (last_line > in->nlines - 1)
+        last_line = in->nlines - 1;
+    if (first_line > last_line || first_samp > last_samp)
+        return (SUCCESS);
+
+    /* Only read the lines and samples the footprint holds */
+    if (mos->footprint != NULL)
+    {
+        for (line = first_line; line <= last_line; line++)
+        {
+            if (footprint_line_extent (mos->footprint, line, &first, &last)
+                <= 0)
+                continue;
+            if (fp_first_line < 0)
+                fp_first_line = line;
+            fp_last_line = line;
+            if (first < fp_first_samp)
+                fp_first_samp = first;
+            if (last > fp_last_samp)
+                fp_last_samp = last;
+        }
+        if (fp_first_line < 0)
+            return (SUCCESS);
+        first_line = fp_first_line;
+        last_line = fp_last_line;
+        if (first_samp < fp_first_samp)
+            first_samp = fp_first_samp;
+        if (last_samp > fp_last_samp)
+            last_samp = fp_last_samp;
+        if (first_samp > last_samp)
+            return (SUCCESS);
+    }
+
+    *line0 = first_line;
+    *samp0 = first_samp;
+    win->nlines = last_line - first_line + 1;
+    win->nsamps = last_samp - first_samp + 1;
+    win->pixel_size[0] = in->pixel_size[0];
+    win->pixel_size[1] = in->pixel_size[1];
+    win->ul_x = in->ul_x + first_samp * in->pixel_size[0];
+    win->ul_y = in->ul_y - first_line * in->pixel_size[1];
+
+    return (SUCCESS);
+}
+
+
+/* Converts the pixels of a window of the given type to floats */
+#define WINDOW_PIXELS(type) \
+    for (i = 0; i < npix; i++) \
+        pix[i] = ((const type *) buf)[i];
+
+/******************************************************************************
+MODULE:  read_mosaic_window
+
+PURPOSE: Reads a window of an input band of a mosaic into memory as floats.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error reading the window
+SUCCESS         Successfully read the window
+
+NOTES:
+  1. Only the window is read, with positional reads of its samples (see
+     read_raw_binary_window), so encoded and tiled bands decode only the
+     blocks it touches.  A constant band is synthesized.
+  2. The caller frees src->pix with espa_trace_free.
+  3. A window which doesn't fit in the memory budget is an error (see
+     check_warp_budget).
+******************************************************************************/
+static int read_mosaic_window
+(
+    Espa_band_meta_t *bmeta, /* I: metadata of the input band */
+    int fd,                  /* I: input band file; unused for a constant
+                                   band */
+    int line0,               /* I: first line of the window */
+    int samp0,               /* I: first sample of the window */
+    const Warp_grid_t *win,  /* I: grid of the window */
+    Warp_source_t *src       /* O: pixels of the window */
+)
+{
+    char FUNC_NAME[] = "read_mosaic_window";   /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    int size;                /* number of bytes per pixel */
+    int status = SUCCESS;    /* return status */
+    size_t npix;             /* number of pixels in the window */
+    size_t i;                /* looping variable for the pixels */
+    float *pix = NULL;       /* pixels of the window */
+    void *buf = NULL;        /* pixels of the window, as stored */
+    double constant[1];      /* value of a constant band; aligned for any of
+                                the data types */
+
+    size = espa_data_type_size (bmeta->data_type);
+    npix = (size_t) win->nlines * win->nsamps;
+    if (check_warp_budget (bmeta->name, npix) != SUCCESS)
+        return (ERROR);
+    pix = espa_trace_malloc (npix * sizeof (float));
+    buf = espa_trace_malloc (npix * size);
+    if (pix == NULL || buf == NULL)
+    {
+        sprintf (errmsg, "Allocating the window of band %s", bmeta->name);
+        error_handler (true, FUNC_NAME, errmsg);
+        espa_trace_free (pix);
+        espa_trace_free (buf);
+        return (ERROR);
+    }
+
+    if (is_constant_band (bmeta))
+    {
+        status = espa_constant_pixel (bmeta, constant);
+        if (status == SUCCESS)
+            read_raw_binary_constant (win->nlines, win->nsamps, size,
+                constant, buf);
+    }
+    else
+        status = read_raw_binary_window (fd, bmeta->nsamps, line0,
+            win->nlines, samp0, win->nsamps, size, buf);
+    if (status != SUCCESS)
+    {
+        sprintf (errmsg, "Reading lines %d-%d of band %s", line0,
+            line0 + win->nlines - 1, bmeta->name);
+        error_handler (true, FUNC_NAME, errmsg);
+        espa_trace_free (pix);
+        espa_trace_free (buf);
+        return (ERROR);
+    }
+
+    switch (bmeta->data_type)
+    {
+        case ESPA_INT8:
+            WINDOW_PIXELS (int8_t);
+            break;
+        case ESPA_UINT8:
+            WINDOW_PIXELS (uint8_t);
+            break;
+        case ESPA_INT16:
+            WINDOW_PIXELS (int16_t);
+            break;
+        case ESPA_UINT16:
+            WINDOW_PIXELS (uint16_t);
+            break;
+        default:
+            WINDOW_PIXELS (float);
+            break;
+    }
+    espa_trace_free (buf);
+
+    src->pix = pix;
+    src->nlines = win->nlines;
+    src->nsamps = win->nsamps;
+    src->has_fill = bmeta->fill_value != ESPA_INT_META_FILL;
+    src->fill = (float) bmeta->fill_value;
+    src->outside = src->has_fill ? src->fill : 0.0f;
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  mosaic_input_stripe
+
+PURPOSE: Warps the current input of a mosaic into the pixels of the current
+stripe which no previous input has filled.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error warping the input
+SUCCESS         Successfully warped the input
+
+NOTES:
+  1. Only the window of the input which the stripe maps to is read.
+******************************************************************************/
+static int mosaic_input_stripe
+(
+    Mosaic_band_t *mos,      /* I/O: band being mosaicked, with its input
+                                     set */
+    Espa_band_meta_t *bmeta, /* I: metadata of the input band */
+    int fd                   /* I: input band file */
+)
+{
+    int status;              /* return status */
+    int ntiles;              /* number of tiles in a stripe */
+    int max_workers;         /* most workers of the tiles */
+    int line0 = 0;           /* first input line of the window */
+    int samp0 = 0;           /* first input sample of the window */
+    Warp_grid_t win;         /* grid of the window */
+    Warp_grid_t in = mos->warp.in;  /* grid of the input band */
+
+    if (mosaic_input_window (mos, &win, &line0, &samp0) != SUCCESS)
+        return (ERROR);
+    if (win.nlines == 0)
+        return (SUCCESS);
+    if (read_mosaic_window (bmeta, fd, line0, samp0, &win, &mos->warp.src)
+        != SUCCESS)
+        return (ERROR);
+
+    /* Warp from the window */
+    mos->warp.in = win;
+    mos->win_line0 = line0;
+    mos->win_samp0 = samp0;
+    ntiles = (mos->warp.out.nsamps + WARP_TILE_SAMPS - 1) / WARP_TILE_SAMPS;
+    max_workers = ias_geo_is_threadsafe_transformation (mos->warp.trans) ?
+        0 : 1;
+    status = espa_parallel_for (ntiles, max_workers, mosaic_tile_task, mos);
+
+    mos->warp.in = in;
+    espa_trace_free ((void *) mos->warp.src.pix);
+    mos->warp.src.pix = NULL;
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  write_mosaic_band
+
+PURPOSE: Mosaics a band of the inputs to its output raw binary file, a
+stripe at a time, and writes its ENVI header.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error mosaicking the band
+SUCCESS         Successfully mosaicked the band
+
+NOTES:
+  1. Each stripe starts as fill (0 for a band without a fill value), and
+     the inputs covering it are warped into it in priority order, each
+     filling the pixels still without a valid value, until the stripe is
+     complete.
+  2. The tiles of each stripe are warped in parallel, as for a warp.
+******************************************************************************/
+static int write_mosaic_band
+(
+    Mosaic_input_t *inputs,  /* I: inputs, in priority order */
+    int ninputs,             /* I: number of inputs */
+    int band_index,          /* I: index of the band in the output */
+    const Warp_grid_t *out,  /* I: grid of the output band */
+    enum Espa_resampling_type method,  /* I: resampling of the band */
+    double tolerance,        /* I: largest interpolation error */
+    Espa_band_meta_t *bmeta, /* I/O: metadata of the output band; the
+                                     checksum and statistics are set */
+    Espa_global_meta_t *gmeta  /* I: global metadata of the output */
+)
+{
+    char FUNC_NAME[] = "write_mosaic_band";   /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    int status = SUCCESS;    /* return status */
+    int ntiles;              /* number of tiles in a stripe */
+    int i;                   /* looping variable for the inputs */
+    int *fd = NULL;          /* file of the band in each input */
+    int *cover = NULL;       /* first and last output line and sample each
+                                input covers */
+    size_t npix;             /* number of pixels in the stripe */
+    size_t j;                /* looping variable for the pixels */
+    float outside;           /* value of the pixels no input covers */
+    Mosaic_band_t mos;       /* band being mosaicked */
+    Mosaic_input_t *input = NULL;  /* current input */
+    Espa_band_meta_t *in_bmeta = NULL;  /* metadata of the input band */
+    Raw_binary_writer_t *writer = NULL;  /* writer of the output band */
+
+    memset (&mos, 0, sizeof (mos));
+    mos.warp.out = *out;
+    mos.warp.tolerance = tolerance;
+    mos.warp.data_type = bmeta->data_type;
+    mos.warp.size = espa_data_type_size (bmeta->data_type);
+    mos.warp.kernel = method == ESPA_CC ? warp_kernels[WARP_CUBIC] :
+        method == ESPA_BI ? warp_kernels[WARP_BILINEAR] :
+        warp_kernels[WARP_NEAREST];
+    outside = bmeta->fill_value != ESPA_INT_META_FILL ?
+        (float) bmeta->fill_value : 0.0f;
+
+    /* Open the band of each input, and find the output lines and samples
+       the input covers */
+    fd = malloc (ninputs * sizeof (int));
+    cover = malloc (4 * ninputs * sizeof (int));
+    if (fd == NULL || cover == NULL)
+    {
+        sprintf (errmsg, "Allocating the inputs of band %s", bmeta->name);
+        error_handler (true, FUNC_NAME, errmsg);
+        free (fd);
+        free (cover);
+        return (ERROR);
+    }
+    for (i = 0; i < ninputs; i++)
+        fd[i] = ERROR;
+    for (i = 0; i < ninputs && status == SUCCESS; i++)
+    {
+        input = &inputs[i];
+        in_bmeta = &input->meta.band[input->band[band_index]];
+        cover[4*i] = (int) floor ((out->ul_y - input->max_y) /
+            out->pixel_size[1] - 0.5);
+        cover[4*i+1] = (int) ceil ((out->ul_y - input->min_y) /
+            out->pixel_size[1] + 0.5);
+        cover[4*i+2] = (int) floor ((input->min_x - out->ul_x) /
+            out->pixel_size[0] - 0.5);
+        cover[4*i+3] = (int) ceil ((input->max_x - out->ul_x) /
+            out->pixel_size[0] + 0.5);
+        if (cover[4*i+2] < 0)
+            cover[4*i+2] = 0;
+        if (cover[4*i+3] > out->nsamps - 1)
+            cover[4*i+3] = out->nsamps - 1;
+        if (is_constant_band (in_bmeta))
+            continue;
+        fd[i] = open_raw_binary_band_fd (in_bmeta->file_name,
+            in_bmeta->file_offset, false);
+        if (fd[i] == ERROR)
+        {
+            sprintf (errmsg, "Opening the input band %s",
+                in_bmeta->file_name);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+        }
+    }
+
+    ntiles = (out->nsamps + WARP_TILE_SAMPS - 1) / WARP_TILE_SAMPS;
+    npix = (size_t) WARP_TILE_LINES * out->nsamps;
+    mos.warp.tile = calloc (espa_parallel_for_workers (ntiles, 0),
+        sizeof (Warp_tile_t));
+    mos.warp.stripe = espa_trace_malloc (npix * mos.warp.size);
+    mos.value = espa_trace_malloc (npix * sizeof (float));
+    mos.valid = espa_trace_malloc (npix);
+    if (status == SUCCESS)
+        writer = open_raw_binary_writer (bmeta->file_name,
+            (size_t) out->nlines * out->nsamps * mos.warp.size, 0);
+    if (status == SUCCESS && (mos.warp.tile == NULL ||
+        mos.warp.stripe == NULL || mos.value == NULL || mos.valid == NULL ||
+        writer == NULL || start_raw_binary_writer_stats (writer, bmeta)
+        != SUCCESS || start_raw_binary_writer_sparse (writer, bmeta,
+        RB_SPARSE_FROM_ENV) != SUCCESS))
+    {
+        sprintf (errmsg, "Opening the output band %s", bmeta->file_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        status = ERROR;
+    }
+
+    for (mos.warp.line0 = 0; status == SUCCESS &&
+        mos.warp.line0 < out->nlines; mos.warp.line0 += WARP_TILE_LINES)
+    {
+        mos.warp.nlines = min (WARP_TILE_LINES, out->nlines -
+            mos.warp.line0);
+        npix = (size_t) mos.warp.nlines * out->nsamps;
+        for (j = 0; j < npix; j++)
+            mos.value[j] = outside;
+        memset (mos.valid, 0, npix);
+
+        /* Warp the inputs covering the stripe until it is complete */
+        for (i = 0; i < ninputs && status == SUCCESS; i++)
+        {
+            if (cover[4*i] > mos.warp.line0 + mos.warp.nlines - 1 ||
+                cover[4*i+1] < mos.warp.line0 || cover[4*i+2] >
+                cover[4*i+3])
+                continue;
+
+            input = &inputs[i];
+            in_bmeta = &input->meta.band[input->band[band_index]];
+            mos.warp.trans = input->trans;
+            mos.warp.in = input->grid[input->band[band_index]];
+            mos.footprint = input->footprint[input->band[band_index]];
+            mos.samp_lo = cover[4*i+2];
+            mos.samp_hi = cover[4*i+3];
+            status = mosaic_input_stripe (&mos, in_bmeta, fd[i]);
+            if (status != SUCCESS)
+            {
+                sprintf (errmsg, "Warping lines %d-%d of %s",
+                    mos.warp.line0, mos.warp.line0 + mos.warp.nlines - 1,
+                    in_bmeta->file_name);
+                error_handler (true, FUNC_NAME, errmsg);
+            }
+            else if (memchr (mos.valid, 0, npix) == NULL)
+                break;
+        }
+
+        if (status == SUCCESS)
+        {
+            store_pixels (mos.value, npix, mos.warp.data_type,
+                mos.warp.stripe);
+            if (append_raw_binary_writer (writer, mos.warp.nlines,
+                out->nsamps, mos.warp.size, mos.warp.stripe) != SUCCESS)
+            {
+                sprintf (errmsg, "Writing lines %d-%d of %s",
+                    mos.warp.line0, mos.warp.line0 + mos.warp.nlines - 1,
+                    bmeta->file_name);
+                error_handler (true, FUNC_NAME, errmsg);
+                status = ERROR;
+            }
+        }
+    }
+
+    for (i = 0; i < ninputs; i++)
+    {
+        if (fd[i] != ERROR)
+            close_raw_binary_fd (fd[i]);
+    }
+    free (fd);
+    free (cover);
+    free (mos.warp.tile);
+    espa_trace_free (mos.warp.stripe);
+    espa_trace_free (mos.value);
+    espa_trace_free (mos.valid);
+    if (writer != NULL)
+    {
+        if (status == SUCCESS)
+        {
+            get_raw_binary_writer_checksum (writer, bmeta->checksum);
+            get_raw_binary_writer_stats (writer, &bmeta->stats);
+        }
+        if (close_raw_binary_writer (writer) != SUCCESS)
+        {
+            sprintf (errmsg, "Closing the output band %s", bmeta->file_name);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+        }
+    }
+    if (status != SUCCESS)
+        return (ERROR);
+
+    return (write_warp_envi_header (bmeta, gmeta));
+}
+
+
+/******************************************************************************
+MODULE:  compare_mosaic_dates
+
+PURPOSE: Orders the inputs of a mosaic latest acquisition first, then in
+the order they were given, for qsort.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+< 0             The first input comes first
+> 0             The second input comes first
+******************************************************************************/
+static int compare_mosaic_dates
+(
+    const void *a,           /* I: first input */
+    const void *b            /* I: second input */
+)
+{
+    const Mosaic_input_t *in_a = a;  /* first input */
+    const Mosaic_input_t *in_b = b;  /* second input */
+    int cmp;                 /* comparison of the dates or times */
+
+    cmp = strcmp (in_b->meta.global.acquisition_date,
+        in_a->meta.global.acquisition_date);
+    if (cmp == 0)
+        cmp = strcmp (in_b->meta.global.scene_center_time,
+            in_a->meta.global.scene_center_time);
+    if (cmp == 0)
+        cmp = in_a->index - in_b->index;
+    return (cmp);
+}
+
+
+/******************************************************************************
+MODULE:  free_mosaic_inputs
+
+PURPOSE: Frees the inputs of a mosaic.
+
+RETURN VALUE: None
+******************************************************************************/
+static void free_mosaic_inputs
+(
+    Mosaic_input_t *inputs,  /* I: inputs to be freed */
+    int ninputs              /* I: number of inputs */
+)
+{
+    int i, j;                /* looping variables */
+
+    if (inputs == NULL)
+        return;
+    for (i = 0; i < ninputs; i++)
+    {
+        if (inputs[i].trans != NULL)
+            ias_geo_release_cached_proj_transformation (inputs[i].trans);
+        if (inputs[i].footprint != NULL)
+        {
+            for (j = 0; j < inputs[i].meta.nbands; j++)
+                free_footprint (inputs[i].footprint[j]);
+        }
+        free (inputs[i].footprint);
+        free (inputs[i].grid);
+        free (inputs[i].band);
+        free_metadata (&inputs[i].meta);
+    }
+    free (inputs);
+}
+
+
+/******************************************************************************
+MODULE:  setup_mosaic_input
+
+PURPOSE: Reads the metadata, grids, and footprint indexes of an input of a
+mosaic, and matches its bands to those of the output.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error setting up the input
+SUCCESS         Successfully set up the input
+
+NOTES:
+  1. The bands are matched by name, so every input needs each band of the
+     output.  Their sizes and resolutions may differ.
+******************************************************************************/
+static int setup_mosaic_input
+(
+    Mosaic_input_t *input,   /* I/O: input, with its metadata parsed */
+    const Espa_internal_meta_t *out_meta  /* I: metadata of the output */
+)
+{
+    char FUNC_NAME[] = "setup_mosaic_input";   /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    int i, j;                /* looping variables for the bands */
+    Espa_internal_meta_t *meta = &input->meta;  /* metadata of the input */
+
+    if (fabs (meta->global.orientation_angle) > ESPA_EPSILON)
+    {
+        sprintf (errmsg, "Mosaicking rotated grids (orientation angle %f) "
+            "isn't supported", meta->global.orientation_angle);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    input->grid = calloc (meta->nbands + 1, sizeof (Warp_grid_t));
+    input->footprint = calloc (meta->nbands + 1,
+        sizeof (Espa_footprint_t *));
+    input->band = calloc (out_meta->nbands + 1, sizeof (int));
+    if (input->grid == NULL || input->footprint == NULL ||
+        input->band == NULL)
+    {
+        sprintf (errmsg, "Allocating the band grids");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    if (setup_warp_input (meta, input->grid) != SUCCESS ||
+        get_scene_projection (&meta->global.proj_info, &input->proj)
+        != SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+
+    for (i = 0; i < out_meta->nbands; i++)
+    {
+        j = espa_find_band (meta, out_meta->band[i].name);
+        if (j < 0)
+        {
+            sprintf (errmsg, "Band %s is missing from one of the products",
+                out_meta->band[i].name);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+        input->band[i] = j;
+        input->footprint[j] = read_footprint (&meta->band[j]);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  mosaic_extent
+
+PURPOSE: Sets the extent of a mosaic to cover its inputs, unless it is
+given.
+
+RETURN VALUE: None
+
+NOTES:
+  1. The extent starts at the UL edge of the inputs, or at the nearest pixel
+     edge of the alignment grid outside it.
+******************************************************************************/
+static void mosaic_extent
+(
+    const Mosaic_input_t *inputs,  /* I: inputs, with their range in the
+                                         output projection */
+    int ninputs,             /* I: number of inputs */
+    const Espa_mosaic_options_t *options,  /* I: options of the mosaic */
+    Espa_warp_options_t *grid  /* I/O: output grid; the extent is set */
+)
+{
+    int i;                   /* looping variable for the inputs */
+    double min_x, max_x, min_y, max_y;  /* range of the inputs */
+
+    if (grid->extent_set)
+        return;
+
+    min_x = inputs[0].min_x;
+    max_x = inputs[0].max_x;
+    min_y = inputs[0].min_y;
+    max_y = inputs[0].max_y;
+    for (i = 1; i < ninputs; i++)
+    {
+        min_x = fmin (min_x, inputs[i].min_x);
+        max_x = fmax (max_x, inputs[i].max_x);
+        min_y = fmin (min_y, inputs[i].min_y);
+        max_y = fmax (max_y, inputs[i].max_y);
+    }
+
+    if (options->align_set)
+    {
+        min_x = options->align_x + floor ((min_x - options->align_x) /
+            grid->pixel_size[0] + WARP_EPSILON) * grid->pixel_size[0];
+        max_y = options->align_y - floor ((options->align_y - max_y) /
+            grid->pixel_size[1] + WARP_EPSILON) * grid->pixel_size[1];
+        max_x = options->align_x + ceil ((max_x - options->align_x) /
+            grid->pixel_size[0] - WARP_EPSILON) * grid->pixel_size[0];
+        min_y = options->align_y - ceil ((options->align_y - min_y) /
+            grid->pixel_size[1] - WARP_EPSILON) * grid->pixel_size[1];
+    }
+
+    grid->ulx = min_x;
+    grid->uly = max_y;
+    grid->lrx = max_x;
+    grid->lry = min_y;
+    grid->extent_set = true;
+}
+
+
+/******************************************************************************
+MODULE:  init_espa_mosaic_options
+
+PURPOSE: Initializes the options of a mosaic to the grid of the first
+product, covering all the products, with the first valid pixel of the
+products in the order given.
+
+RETURN VALUE: None
+******************************************************************************/
+void init_espa_mosaic_options
+(
+    Espa_mosaic_options_t *options  /* O: options of a mosaic in the grid
+                                          of the first product, covering
+                                          all the products */
+)
+{
+    memset (options, 0, sizeof (*options));
+    init_espa_warp_options (&options->grid);
+    options->rule = ESPA_MOSAIC_FIRST_VALID;
+}
+
+
+/******************************************************************************
+MODULE:  mosaic_espa_products
+
+PURPOSE: Mosaics ESPA products onto one grid, writing the composited pixels
+of each band to a new raw binary file and the metadata of the mosaic to a
+new XML file.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error mosaicking the products
+SUCCESS         Successfully mosaicked the products
+
+NOTES:
+  1. The products are ordered by the composite rule, and the first of them
+     gives the bands, data types, fill values, and global metadata of the
+     mosaic (ex. its acquisition date).  The other products need the same
+     band names.
+  2. The defaults of the grid (projection, datum, and pixel size) are those
+     of the first product, as for a warp of it.
+  3. Each output stripe reads only the windows of the products it overlaps
+     (see mosaic_input_window), so the products are never read in full.
+  4. The output bands are named <base>_<band name>.img, where <base> is the
+     output XML filename without its extension.  A band which is the same
+     constant in every product stays a constant band.
+  5. Not distributed under MPI; a single process mosaics the products.
+******************************************************************************/
+int mosaic_espa_products
+(
+    char **xml_infiles,     /* I: input XML metadata filenames */
+    int nfiles,             /* I: number of input products */
+    char *xml_outfile,      /* I: output XML metadata filename; also the base
+                                  name of the output band files */
+    Espa_mosaic_options_t *options  /* I: options of the mosaic */
+)
+{
+    char FUNC_NAME[] = "mosaic_espa_products";   /* function name */
+    char errmsg[STR_SIZE];  /* error message */
+    char out_base[STR_SIZE];   /* base name of the output files */
+    char *cptr = NULL;      /* pointer to the file extension */
+    const char *units;      /* pixel units of the output */
+    int i, j;               /* looping variables */
+    int ref;                /* index of the reference band of an input */
+    int count;              /* number of chars copied in snprintf */
+    int status = SUCCESS;   /* status of all the bands */
+    bool constant;          /* is a band the same constant in every
+                               input? */
+    enum Espa_resampling_type method;  /* resampling of the current band */
+    Espa_internal_meta_t xml_metadata;  /* metadata of the mosaic */
+    Espa_band_meta_t *bmeta = NULL;     /* metadata of the current band */
+    Espa_band_meta_t *in_bmeta = NULL;  /* metadata of an input band */
+    Espa_warp_options_t opts = options->grid;  /* grid of the mosaic, with
+                                                  the defaults filled in */
+    IAS_PROJECTION out_proj;  /* projection of the output */
+    IAS_GEO_PROJ_TRANSFORMATION *trans = NULL;  /* input to output
+                                                   projection */
+    Mosaic_input_t *inputs = NULL;  /* inputs, in priority order */
+    Warp_grid_t *out_grid = NULL;   /* grid of each output band */
+
+    /* Determine the base name of the output files */
+    count = snprintf (out_base, sizeof (out_base), "%s", xml_outfile);
+    if (count < 0 || count >= sizeof (out_base))
+    {
+        sprintf (errmsg, "Overflow of out_base string");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    cptr = strrchr (out_base, '.');
+    if (cptr != NULL && strchr (cptr, '/') == NULL)
+        *cptr = '\0';
+
+    if (nfiles < 1)
+    {
+        sprintf (errmsg, "At least one product is needed for a mosaic");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Validate and parse the metadata of the inputs, and put them in
+       priority order */
+    inputs = calloc (nfiles, sizeof (Mosaic_input_t));
+    if (inputs == NULL)
+    {
+        sprintf (errmsg, "Allocating the inputs");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    for (i = 0; i < nfiles; i++)
+    {
+        inputs[i].index = i;
+        inputs[i].xml_file = xml_infiles[i];
+        init_metadata_struct (&inputs[i].meta);
+        if (!strcmp (xml_infiles[i], xml_outfile))
+        {
+            sprintf (errmsg, "The output XML file needs to differ from the "
+                "input XML file %s", xml_infiles[i]);
+            error_handler (true, FUNC_NAME, errmsg);
+            free_mosaic_inputs (inputs, i + 1);
+            return (ERROR);
+        }
+        if (validate_and_parse_metadata (xml_infiles[i], &inputs[i].meta)
+            != SUCCESS)
+        {  /* Error messages already written */
+            free_mosaic_inputs (inputs, i + 1);
+            return (ERROR);
+        }
+    }
+    if (options->rule == ESPA_MOSAIC_LATEST_DATE)
+        qsort (inputs, nfiles, sizeof (Mosaic_input_t),
+            compare_mosaic_dates);
+
+    /* The first input is the template of the output */
+    init_metadata_struct (&xml_metadata);
+    if (parse_metadata (inputs[0].xml_file, &xml_metadata) != SUCCESS)
+    {  /* Error messages already written */
+        free_mosaic_inputs (inputs, nfiles);
+        return (ERROR);
+    }
+    ref = warp_reference_band (&xml_metadata);
+
+    /* Fill in the defaults of the grid from the first input */
+    if (opts.proj_info.proj_type == ESPA_INT_META_FILL)
+        opts.proj_info = xml_metadata.global.proj_info;
+    if (opts.proj_info.datum_type == ESPA_INT_META_FILL)
+        opts.proj_info.datum_type = xml_metadata.global.proj_info.datum_type;
+    if (opts.pixel_size[0] <= 0.0 || opts.pixel_size[1] <= 0.0)
+    {
+        if ((opts.proj_info.proj_type == GCTP_GEO_PROJ) !=
+            (xml_metadata.global.proj_info.proj_type == GCTP_GEO_PROJ))
+        {
+            sprintf (errmsg, "The pixel size is needed to mosaic between "
+                "geographic and projected coordinates");
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+            goto done;
+        }
+        opts.pixel_size[0] = xml_metadata.band[ref].pixel_size[0];
+        opts.pixel_size[1] = xml_metadata.band[ref].pixel_size[1];
+    }
+    if (get_scene_projection (&opts.proj_info, &out_proj) != SUCCESS)
+    {  /* Error messages already written */
+        status = ERROR;
+        goto done;
+    }
+
+    /* Set up each input and find its range in the output projection */
+    for (i = 0; i < nfiles; i++)
+    {
+        if (setup_mosaic_input (&inputs[i], &xml_metadata) != SUCCESS)
+        {  /* Error messages already written */
+            status = ERROR;
+            goto done;
+        }
+        trans = ias_geo_get_cached_proj_transformation (&inputs[i].proj,
+            &out_proj);
+        if (trans == NULL)
+        {
+            sprintf (errmsg, "Creating the transformation to the target "
+                "projection");
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+            goto done;
+        }
+        status = transform_grid_edges (&inputs[i].grid[warp_reference_band (
+            &inputs[i].meta)], trans, &inputs[i].min_x, &inputs[i].max_x,
+            &inputs[i].min_y, &inputs[i].max_y);
+        ias_geo_release_cached_proj_transformation (trans);
+        if (status != SUCCESS)
+        {
+            sprintf (errmsg, "Finding the extent of %s in the target "
+                "projection", inputs[i].xml_file);
+            error_handler (true, FUNC_NAME, errmsg);
+            goto done;
+        }
+
+        inputs[i].trans = ias_geo_get_cached_proj_transformation (&out_proj,
+            &inputs[i].proj);
+        if (inputs[i].trans == NULL)
+        {
+            sprintf (errmsg, "Creating the transformation to the projection "
+                "of %s", inputs[i].xml_file);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+            goto done;
+        }
+    }
+
+    /* Set up the output grids from the first input */
+    mosaic_extent (inputs, nfiles, options, &opts);
+    out_grid = calloc (xml_metadata.nbands + 1, sizeof (Warp_grid_t));
+    if (out_grid == NULL)
+    {
+        sprintf (errmsg, "Allocating the band grids");
+        error_handler (true, FUNC_NAME, errmsg);
+        status = ERROR;
+        goto done;
+    }
+    if (setup_warp_output (&xml_metadata, &opts, &inputs[0].proj, &out_proj,
+        inputs[0].grid, out_grid) != SUCCESS)
+    {  /* Error messages already written */
+        status = ERROR;
+        goto done;
+    }
+    printf ("  Mosaicking %d products to %d lines and %d samples of the "
+        "reference band\n", nfiles, out_grid[ref].nlines,
+        out_grid[ref].nsamps);
+
+    /* Mosaic the bands one at a time, a stripe of tiles at a time */
+    units = xml_metadata.global.proj_info.units;
+    for (i = 0; i < xml_metadata.nbands; i++)
+    {
+        bmeta = &xml_metadata.band[i];
+        method = band_resampling (bmeta, opts.resample);
+        constant = is_constant_band (bmeta);
+        for (j = 1; j < nfiles && constant; j++)
+        {
+            in_bmeta = &inputs[j].meta.band[inputs[j].band[i]];
+            constant = is_constant_band (in_bmeta) &&
+                in_bmeta->constant_value == bmeta->constant_value;
+        }
+
+        /* Point the band to its output grid and file */
+        bmeta->nlines = out_grid[i].nlines;
+        bmeta->nsamps = out_grid[i].nsamps;
+        bmeta->pixel_size[0] = out_grid[i].pixel_size[0];
+        bmeta->pixel_size[1] = out_grid[i].pixel_size[1];
+        strcpy (bmeta->pixel_units, units);
+        bmeta->resample_method = method;
+        strcpy (bmeta->footprint_file, ESPA_STRING_META_FILL);
+        strcpy (bmeta->overview_file, ESPA_STRING_META_FILL);
+        bmeta->overview_levels = 0;
+        if (constant)
+            continue;
+        if (!warp_data_type_supported (bmeta->data_type))
+        {
+            sprintf (errmsg, "Mosaicking the data type of band %s isn't "
+                "supported", bmeta->name);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+            goto done;
+        }
+
+        count = snprintf (bmeta->file_name, sizeof (bmeta->file_name),
+            "%s_%s.img", out_base, bmeta->name);
+        for (j = 0; j < nfiles && count >= 0 && count <
+            sizeof (bmeta->file_name); j++)
+        {
+            if (!strcmp (bmeta->file_name,
+                inputs[j].meta.band[inputs[j].band[i]].file_name))
+                count = -1;
+        }
+        if (count < 0 || count >= sizeof (bmeta->file_name))
+        {
+            sprintf (errmsg, "Naming the output of band %s", bmeta->name);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+            goto done;
+        }
+        strcpy (bmeta->encoding, ESPA_STRING_META_FILL);
+        bmeta->tile_size = 0;
+        bmeta->file_offset = 0;
+        bmeta->constant_value = ESPA_FLOAT_META_FILL;
+
+        printf ("  Band %d: %s (%s)\n", i, bmeta->file_name,
+            method == ESPA_CC ? "cubic convolution" : method == ESPA_BI ?
+            "bilinear" : "nearest neighbor");
+        status = write_mosaic_band (inputs, nfiles, i, &out_grid[i], method,
+            opts.max_error, bmeta, &xml_metadata.global);
+        if (status != SUCCESS)
+        {
+            sprintf (errmsg, "Mosaicking band %d: %s", i, bmeta->name);
+            error_handler (true, FUNC_NAME, errmsg);
+            goto done;
+        }
+    }
+
+    /* Write and validate the output metadata */
+    if (write_metadata (&xml_metadata, xml_outfile) != SUCCESS ||
+        validate_xml_file (xml_outfile) != SUCCESS)
+    {  /* Error messages already written */
+        status = ERROR;
+    }
+
+done:
+    free (out_grid);
+    free_metadata (&xml_metadata);
+    free_mosaic_inputs (inputs, nfiles);
+    return (status);
+}
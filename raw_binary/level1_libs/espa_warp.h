@@ -0,0 +1,148 @@
+/*****************************************************************************
+FILE: espa_warp.h
+
+PURPOSE: Contains defines, structures, and prototypes for warping an ESPA
+product to another projection, writing the resampled pixels of each band
+along with the updated XML metadata, and for mosaicking several products onto
+one grid.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The output grid is given by the target projection and the pixel size of
+     the reference band (band1 for Landsat, B02 for Sentinel-2, otherwise
+     the first band).  The other bands keep their ratio to the reference
+     band, so a multi-resolution product stays multi-resolution.
+  2. The output covers the input unless its extent is given.  The extent is
+     aligned to whole pixels of the coarsest band.
+  3. Each band is resampled with its own resampling method from the XML
+     (nearest neighbor for the bands without one) unless a method is given
+     for all the bands.
+  4. A mosaic is warped the same way, onto the grid of the warp options,
+     with each output pixel taken from the first product holding a valid
+     (non-fill, inside its footprint) pixel there.  The products are in the
+     order given, or latest acquisition first (see Espa_mosaic_rule_t).
+*****************************************************************************/
+
+#ifndef ESPA_WARP_H
+#define ESPA_WARP_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include "error_handler.h"
+#include "espa_metadata.h"
+#include "parse_metadata.h"
+#include "write_metadata.h"
+#include "envi_header.h"
+#include "generate_land_water_mask.h"
+
+/* Defines */
+#define WARP_TILE_LINES 256     /* lines of the output tiles, and of the
+                                   stripes written at a time */
+#define WARP_TILE_SAMPS 256     /* samples of the output tiles */
+#define WARP_GRID_SIZE 16       /* lines and samples between the exactly
+                                   transformed nodes of the interpolation
+                                   grid of a tile */
+#define WARP_DEFAULT_MAX_ERROR 0.125  /* default largest interpolation error,
+                                         in input pixels */
+#define WARP_EDGE_STEP 16       /* pixels between the points of the edges
+                                   transformed for the extent and bounds */
+#define WARP_CUBIC_ALPHA -0.5   /* alpha of the cubic convolution */
+#define WARP_CUBIC_STEPS 1024   /* steps of the cubic convolution weights
+                                   per pixel */
+#define MOSAIC_WINDOW_MARGIN 2  /* input pixels read around the window an
+                                   output stripe maps to, for the kernels */
+
+/* Composite rules of a mosaic, i.e. which product an output pixel is taken
+   from where several products have a valid pixel */
+typedef enum
+{
+    ESPA_MOSAIC_FIRST_VALID,   /* first product, in the order given */
+    ESPA_MOSAIC_LATEST_DATE    /* product with the latest acquisition date
+                                  and scene center time */
+} Espa_mosaic_rule_t;
+
+/* Options of the warp */
+typedef struct
+{
+    Espa_proj_meta_t proj_info;  /* target projection: proj_type,
+                                    datum_type, and the parameters of the
+                                    projection; the corners, units, and grid
+                                    origin are set by the warp.  A proj_type
+                                    of ESPA_INT_META_FILL keeps the input
+                                    projection, and a datum_type of
+                                    ESPA_INT_META_FILL the input datum */
+    double pixel_size[2];   /* x and y pixel size of the reference band in
+                               the target projection units; 0.0 to keep the
+                               input pixel size (same units only) */
+    bool extent_set;        /* is the extent given (ulx, uly, lrx, lry)
+                               rather than covering the input? */
+    double ulx;             /* projection x of the left edge of the output */
+    double uly;             /* projection y of the top edge of the output */
+    double lrx;             /* projection x of the right edge of the output */
+    double lry;             /* projection y of the bottom edge of the
+                               output */
+    enum Espa_resampling_type resample;  /* resampling of all the bands
+                                            (ESPA_NN, ESPA_BI, or ESPA_CC);
+                                            ESPA_NONE for the method of each
+                                            band */
+    double max_error;       /* largest interpolation error of the mapping to
+                               the input, in input pixels; 0.0 to transform
+                               every pixel exactly */
+} Espa_warp_options_t;
+
+/* Options of a mosaic */
+typedef struct
+{
+    Espa_warp_options_t grid;  /* projection, pixel size, extent, and
+                                  resampling of the mosaic; the defaults
+                                  are those of the first product */
+    bool align_set;         /* without an extent, is the extent covering
+                               the products aligned to the pixels of a grid
+                               (ex. the ARD tiles) rather than starting at
+                               the edge of the products? */
+    double align_x;         /* projection x of a left pixel edge of the
+                               grid */
+    double align_y;         /* projection y of a top pixel edge of the
+                               grid */
+    Espa_mosaic_rule_t rule;  /* composite rule of the mosaic */
+} Espa_mosaic_options_t;
+
+/* Prototypes */
+void init_espa_warp_options
+(
+    Espa_warp_options_t *options  /* O: options of a warp to the projection
+                                        of the input, at the input pixel
+                                        size */
+);
+
+int warp_espa_product
+(
+    char *xml_infile,       /* I: input XML metadata filename */
+    char *xml_outfile,      /* I: output XML metadata filename; also the base
+                                  name of the output band files */
+    Espa_warp_options_t *options  /* I: options of the warp */
+);
+
+void init_espa_mosaic_options
+(
+    Espa_mosaic_options_t *options  /* O: options of a mosaic in the grid
+                                          of the first product, covering
+                                          all the products */
+);
+
+int mosaic_espa_products
+(
+    char **xml_infiles,     /* I: input XML metadata filenames */
+    int nfiles,             /* I: number of input products */
+    char *xml_outfile,      /* I: output XML metadata filename; also the base
+                                  name of the output band files */
+    Espa_mosaic_options_t *options  /* I: options of the mosaic */
+);
+
+#endif
@@ -0,0 +1,1422 @@
+/*****************************************************************************
+FILE: generate_angle_bands.c
+
+PURPOSE: Contains functions for generating the per-pixel solar and view angle
+bands of a scene (see generate_angle_bands.h).
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. Each line of the output is interpolated first down the columns of
+     nodes, giving the angle of the line at each column, then across the
+     line.  Between two columns of nodes the angle is a linear ramp over the
+     samples, which a SIMD kernel evaluates, rounds, and packs to 16-bit
+     integers.  The kernels are chosen once when the program is loaded (see
+     espa_cpu_dispatch.h), and give the same pixels as the scalar loop,
+     which does the remainders.
+  2. An azimuth is interpolated the short way around the circle.  The ramps
+     which wrap past -180 or 180 degrees are done by the scalar loop.
+  3. A node without an angle takes the angle of the other node it is
+     interpolated with, so the detector footprints of the Sentinel view
+     angles run up to the pixels between them.
+*****************************************************************************/
+#include <math.h>
+#include <strings.h>
+#include <libxml/parser.h>
+#include <libxml/tree.h>
+#include "generate_angle_bands.h"
+#include "espa_cpu_dispatch.h"
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#define ANGLE_X86
+#endif
+
+/* Kernel evaluating the ramp base + slope * i for the pixels i of a segment
+   of a line, rounded to the nearest 16-bit integer (ties to even); returns
+   the number of pixels done */
+typedef int (*Angle_ramp_kernel_t)
+(
+    float base,          /* I: value of the first pixel */
+    float slope,         /* I: change of the value per pixel */
+    int n,               /* I: number of pixels */
+    int16_t *out         /* O: 16-bit pixels */
+);
+
+/* Sums of the view angles of the detectors merged into a grid */
+typedef struct
+{
+    double zenith[ANGLE_GRID_MAX][ANGLE_GRID_MAX];   /* sum of the zeniths */
+    double sin_az[ANGLE_GRID_MAX][ANGLE_GRID_MAX];   /* sum of the sines of
+                                                        the azimuths */
+    double cos_az[ANGLE_GRID_MAX][ANGLE_GRID_MAX];   /* sum of the cosines of
+                                                        the azimuths */
+    int count[ANGLE_GRID_MAX][ANGLE_GRID_MAX];       /* number of detectors
+                                                        with an angle */
+} View_sums_t;
+
+/* Names, short name suffixes, and long names of the angle bands */
+static const char *angle_names[ANGLE_NGRIDS] =
+    {"solar_zenith", "solar_azimuth", "sensor_zenith", "sensor_azimuth"};
+static const char *angle_short[ANGLE_NGRIDS] = {"SZA", "SAA", "VZA", "VAA"};
+static const char *angle_long[ANGLE_NGRIDS] =
+    {"solar zenith angle", "solar azimuth angle", "sensor zenith angle",
+     "sensor azimuth angle"};
+
+
+#ifdef ANGLE_X86
+/******************************************************************************
+MODULE: angle_ramp_sse2
+
+PURPOSE: Evaluates the ramp for 8 pixels at a time, rounding them to 16-bit
+integers.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+n            Number of pixels done
+
+NOTES:
+  1. The pixel index is carried as floats, which are exact up to 2^24.
+*****************************************************************************/
+static int angle_ramp_sse2
+(
+    float base,          /* I: value of the first pixel */
+    float slope,         /* I: change of the value per pixel */
+    int n,               /* I: number of pixels */
+    int16_t *out         /* O: 16-bit pixels */
+)
+{
+    int i;               /* current pixel */
+    __m128 vbase = _mm_set1_ps (base);    /* value of the first pixel */
+    __m128 vslope = _mm_set1_ps (slope);  /* change per pixel */
+    __m128 vstep = _mm_set1_ps (8.0f);    /* pixels per iteration */
+    __m128 idx_lo = _mm_setr_ps (0.0f, 1.0f, 2.0f, 3.0f);  /* indices of
+                                             the first 4 pixels */
+    __m128 idx_hi = _mm_setr_ps (4.0f, 5.0f, 6.0f, 7.0f);  /* indices of
+                                             the next 4 pixels */
+    __m128i lo;          /* first 4 pixels as 32-bit integers */
+    __m128i hi;          /* next 4 pixels as 32-bit integers */
+
+    for (i = 0; i + 8 <= n; i += 8)
+    {
+        lo = _mm_cvtps_epi32 (_mm_add_ps (vbase, _mm_mul_ps (vslope,
+            idx_lo)));
+        hi = _mm_cvtps_epi32 (_mm_add_ps (vbase, _mm_mul_ps (vslope,
+            idx_hi)));
+        _mm_storeu_si128 ((__m128i *) (out + i), _mm_packs_epi32 (lo, hi));
+        idx_lo = _mm_add_ps (idx_lo, vstep);
+        idx_hi = _mm_add_ps (idx_hi, vstep);
+    }
+
+    return i;
+}
+
+
+/******************************************************************************
+MODULE: angle_ramp_avx2
+
+PURPOSE: Evaluates the ramp for 16 pixels at a time, rounding them to 16-bit
+integers.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+n            Number of pixels done
+
+NOTES:
+  1. Only put in the kernel table when the CPU supports AVX2.  The multiply
+     and add are kept apart (no FMA), as in the scalar loop.
+  2. The pack interleaves the 128-bit lanes of its operands, so the 64-bit
+     quarters are put back in order.
+*****************************************************************************/
+__attribute__ ((target ("avx2")))
+static int angle_ramp_avx2
+(
+    float base,          /* I: value of the first pixel */
+    float slope,         /* I: change of the value per pixel */
+    int n,               /* I: number of pixels */
+    int16_t *out         /* O: 16-bit pixels */
+)
+{
+    int i;               /* current pixel */
+    __m256 vbase = _mm256_set1_ps (base);    /* value of the first pixel */
+    __m256 vslope = _mm256_set1_ps (slope);  /* change per pixel */
+    __m256 vstep = _mm256_set1_ps (16.0f);   /* pixels per iteration */
+    __m256 idx_lo = _mm256_setr_ps (0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f,
+        7.0f);           /* indices of the first 8 pixels */
+    __m256 idx_hi = _mm256_setr_ps (8.0f, 9.0f, 10.0f, 11.0f, 12.0f, 13.0f,
+        14.0f, 15.0f);   /* indices of the next 8 pixels */
+    __m256i lo;          /* first 8 pixels as 32-bit integers */
+    __m256i hi;          /* next 8 pixels as 32-bit integers */
+
+    for (i = 0; i + 16 <= n; i += 16)
+    {
+        lo = _mm256_cvtps_epi32 (_mm256_add_ps (vbase, _mm256_mul_ps (vslope,
+            idx_lo)));
+        hi = _mm256_cvtps_epi32 (_mm256_add_ps (vbase, _mm256_mul_ps (vslope,
+            idx_hi)));
+        _mm256_storeu_si256 ((__m256i *) (out + i), _mm256_permute4x64_epi64
+            (_mm256_packs_epi32 (lo, hi), 0xd8));
+        idx_lo = _mm256_add_ps (idx_lo, vstep);
+        idx_hi = _mm256_add_ps (idx_hi, vstep);
+    }
+
+    return i;
+}
+#endif
+
+
+/******************************************************************************
+MODULE: angle_ramp_none
+
+PURPOSE: Kernel of CPUs without SIMD support, leaving all the pixels to the
+scalar loop.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+0            No pixels done
+
+NOTES:
+*****************************************************************************/
+static int angle_ramp_none
+(
+    float base,          /* I: value of the first pixel (unused) */
+    float slope,         /* I: change of the value per pixel (unused) */
+    int n,               /* I: number of pixels (unused) */
+    int16_t *out         /* O: 16-bit pixels (unused) */
+)
+{
+    return 0;
+}
+
+
+/* Kernel, chosen by init_angle_kernels */
+static Angle_ramp_kernel_t angle_ramp_kernel = angle_ramp_none;
+
+
+/******************************************************************************
+MODULE: init_angle_kernels
+
+PURPOSE: Chooses the widest kernel supported by the CPU.
+
+RETURN VALUE: None
+
+NOTES:
+  1. Run when the program (or shared library) is loaded.
+*****************************************************************************/
+__attribute__ ((constructor))
+static void init_angle_kernels (void)
+{
+#if defined(ANGLE_X86)
+    if (espa_cpu_supports (ESPA_CPU_AVX2))
+        angle_ramp_kernel = angle_ramp_avx2;
+    else if (espa_cpu_supports (ESPA_CPU_SSE2))
+        angle_ramp_kernel = angle_ramp_sse2;
+#endif
+}
+
+
+/******************************************************************************
+MODULE: angle_ramp
+
+PURPOSE: Evaluates a ramp of angles (hundredths of a degree) over a segment
+of a line, wrapping the azimuths back into -180 to 180 degrees.
+
+RETURN VALUE: None
+
+NOTES:
+  1. The kernel is only used when no pixel of the segment wraps.
+*****************************************************************************/
+static void angle_ramp
+(
+    float base,          /* I: value of the first pixel */
+    float slope,         /* I: change of the value per pixel */
+    int n,               /* I: number of pixels */
+    bool azimuth,        /* I: is the ramp of azimuths? */
+    int16_t *out         /* O: 16-bit pixels */
+)
+{
+    int i = 0;           /* current pixel */
+    float last;          /* value of the last pixel */
+    float v;             /* value of a pixel */
+
+    last = base + slope * (float) (n - 1);
+    if (!azimuth || (fabsf (base) <= 18000.0f && fabsf (last) <= 18000.0f))
+        i = angle_ramp_kernel (base, slope, n, out);
+    for (; i < n; i++)
+    {
+        v = base + slope * (float) i;
+        if (azimuth && v > 18000.0f)
+            v -= 36000.0f;
+        else if (azimuth && v < -18000.0f)
+            v += 36000.0f;
+        out[i] = (int16_t) nearbyintf (v);
+    }
+}
+
+
+/******************************************************************************
+MODULE: blend_angles
+
+PURPOSE: Interpolates between two angles, the short way around the circle
+for the azimuths.  An angle missing at one end is taken from the other.
+
+RETURN VALUE:
+Type = double
+Value        Description
+-----        -----------
+NAN          Neither end has an angle
+angle        Interpolated angle (degrees); the azimuths are in -180 to 180
+*****************************************************************************/
+static double blend_angles
+(
+    double a,            /* I: angle at the start (degrees); NAN if none */
+    double b,            /* I: angle at the end (degrees); NAN if none */
+    double fraction,     /* I: fraction of the way from a to b */
+    bool azimuth         /* I: are the angles azimuths? */
+)
+{
+    double v;            /* interpolated angle */
+
+    if (isnan (a))
+        return b;
+    if (isnan (b))
+        return a;
+
+    if (azimuth && b - a > 180.0)
+        b -= 360.0;
+    else if (azimuth && b - a < -180.0)
+        b += 360.0;
+    v = a + fraction * (b - a);
+    if (azimuth && v > 180.0)
+        v -= 360.0;
+    else if (azimuth && v < -180.0)
+        v += 360.0;
+
+    return v;
+}
+
+
+/******************************************************************************
+MODULE:  sentinel_angle_band_id
+
+PURPOSE: Returns the band ID used in the Sentinel tile metadata for a band.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+-1              The name isn't a Sentinel band
+0-12            Band ID of the band
+
+NOTES:
+  1. The IDs count the bands in order, with B8A between B08 and B09.
+******************************************************************************/
+int sentinel_angle_band_id
+(
+    const char *band_name  /* I: name of the Sentinel band (B01-B12, B8A) */
+)
+{
+    int num;                 /* number of the band */
+    char *endptr = NULL;     /* end of the parsed number */
+
+    if (band_name[0] != 'B' && band_name[0] != 'b')
+        return -1;
+    if (!strcasecmp (&band_name[1], "8A"))
+        return 8;
+
+    num = (int) strtol (&band_name[1], &endptr, 10);
+    if (endptr == &band_name[1] || *endptr != '\0' || num < 1 || num > 12)
+        return -1;
+
+    return (num <= 8) ? num - 1 : num;
+}
+
+
+/******************************************************************************
+MODULE:  find_element
+
+PURPOSE: Finds the first element of a name under a node, depth first.
+
+RETURN VALUE:
+Type = xmlNode *
+Value           Description
+-----           -----------
+NULL            No element of that name
+node            First element of that name
+******************************************************************************/
+static xmlNode *find_element
+(
+    xmlNode *a_node,     /* I: node to search under */
+    const char *name     /* I: name of the element */
+)
+{
+    xmlNode *cur_node = NULL;     /* pointer to the current node */
+    xmlNode *found = NULL;        /* element found under the current node */
+
+    for (cur_node = a_node->children; cur_node; cur_node = cur_node->next)
+    {
+        if (cur_node->type != XML_ELEMENT_NODE)
+            continue;
+        if (!xmlStrcmp (cur_node->name, (const xmlChar *) name))
+            return cur_node;
+        found = find_element (cur_node, name);
+        if (found != NULL)
+            return found;
+    }
+
+    return NULL;
+}
+
+
+/******************************************************************************
+MODULE:  element_double
+
+PURPOSE: Reads the value of a child element holding a number.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           The element is missing or isn't a number
+SUCCESS         Successfully read the value
+******************************************************************************/
+static int element_double
+(
+    xmlNode *a_node,     /* I: parent of the element */
+    const char *name,    /* I: name of the element */
+    double *value        /* O: value of the element */
+)
+{
+    xmlNode *cur_node = NULL;     /* pointer to the element */
+    char *endptr = NULL;          /* end of the parsed number */
+    const char *text = NULL;      /* content of the element */
+
+    cur_node = find_element (a_node, name);
+    if (cur_node == NULL || cur_node->children == NULL ||
+        cur_node->children->type != XML_TEXT_NODE)
+        return (ERROR);
+
+    text = (const char *) cur_node->children->content;
+    *value = strtod (text, &endptr);
+    if (endptr == text)
+        return (ERROR);
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  read_angle_values
+
+PURPOSE: Reads a grid of angles (a Zenith or Azimuth element of the tile
+metadata) with its node spacing.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error reading the grid
+SUCCESS         Successfully read the grid
+
+NOTES:
+  1. The grid is a Values_List of VALUES elements, one per row, each holding
+     the angles of the row separated by spaces.  Missing angles are NaN.
+  2. The azimuths are put in -180 to 180 degrees.
+******************************************************************************/
+static int read_angle_values
+(
+    xmlNode *a_node,     /* I: Zenith or Azimuth element */
+    bool azimuth,        /* I: are the angles azimuths? */
+    double *col_step,    /* O: spacing of the columns (meters) */
+    double *row_step,    /* O: spacing of the rows (meters) */
+    int *nrows,          /* O: number of rows */
+    int *ncols,          /* O: number of columns */
+    float values[ANGLE_GRID_MAX][ANGLE_GRID_MAX]  /* O: angles (degrees) */
+)
+{
+    char FUNC_NAME[] = "read_angle_values";   /* function name */
+    char errmsg[STR_SIZE];        /* error message */
+    xmlNode *list_node = NULL;    /* Values_List element */
+    xmlNode *cur_node = NULL;     /* current VALUES element */
+    const char *text = NULL;      /* content of the VALUES element */
+    char *endptr = NULL;          /* end of the parsed angle */
+    double v;                     /* angle */
+    int col;                      /* column of the angle in the row */
+
+    if (element_double (a_node, "COL_STEP", col_step) != SUCCESS ||
+        element_double (a_node, "ROW_STEP", row_step) != SUCCESS ||
+        *col_step <= 0.0 || *row_step <= 0.0)
+    {
+        sprintf (errmsg, "Reading the node spacing of the %s grid",
+            a_node->name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    list_node = find_element (a_node, "Values_List");
+    if (list_node == NULL)
+    {
+        sprintf (errmsg, "Missing Values_List in the %s grid", a_node->name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    *nrows = 0;
+    *ncols = 0;
+    for (cur_node = list_node->children; cur_node; cur_node = cur_node->next)
+    {
+        if (cur_node->type != XML_ELEMENT_NODE ||
+            xmlStrcmp (cur_node->name, (const xmlChar *) "VALUES") ||
+            cur_node->children == NULL ||
+            cur_node->children->type != XML_TEXT_NODE)
+            continue;
+
+        if (*nrows >= ANGLE_GRID_MAX)
+        {
+            sprintf (errmsg, "The %s grid has more than %d rows",
+                a_node->name, ANGLE_GRID_MAX);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+
+        text = (const char *) cur_node->children->content;
+        for (col = 0; ; col++)
+        {
+            v = strtod (text, &endptr);
+            if (endptr == text)
+                break;
+            text = endptr;
+            if (col >= ANGLE_GRID_MAX)
+            {
+                sprintf (errmsg, "The %s grid has more than %d columns",
+                    a_node->name, ANGLE_GRID_MAX);
+                error_handler (true, FUNC_NAME, errmsg);
+                return (ERROR);
+            }
+            if (azimuth && !isnan (v))
+                v = remainder (v, 360.0);
+            values[*nrows][col] = v;
+        }
+
+        if (*nrows > 0 && col != *ncols)
+        {
+            sprintf (errmsg, "Row %d of the %s grid has %d angles rather "
+                "than %d", *nrows, a_node->name, col, *ncols);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+        *ncols = col;
+        (*nrows)++;
+    }
+
+    if (*nrows == 0 || *ncols == 0)
+    {
+        sprintf (errmsg, "The %s grid has no angles", a_node->name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  read_angle_pair
+
+PURPOSE: Reads the Zenith and Azimuth grids of a sun or viewing angles
+element, checking they match the grids already read.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error reading the grids, or they don't match
+SUCCESS         Successfully read the grids
+******************************************************************************/
+static int read_angle_pair
+(
+    xmlNode *a_node,     /* I: Sun_Angles_Grid or
+                               Viewing_Incidence_Angles_Grids element */
+    Espa_angle_grids_t *grids,  /* I/O: grids; the node spacing is set by the
+                                        first pair read (nrows of 0) */
+    float zenith[ANGLE_GRID_MAX][ANGLE_GRID_MAX],   /* O: zeniths */
+    float azimuth[ANGLE_GRID_MAX][ANGLE_GRID_MAX]   /* O: azimuths */
+)
+{
+    char FUNC_NAME[] = "read_angle_pair";   /* function name */
+    char errmsg[STR_SIZE];        /* error message */
+    xmlNode *zen_node = NULL;     /* Zenith element */
+    xmlNode *az_node = NULL;      /* Azimuth element */
+    double col_step[2];           /* column spacing of the two grids */
+    double row_step[2];           /* row spacing of the two grids */
+    int nrows[2];                 /* number of rows of the two grids */
+    int ncols[2];                 /* number of columns of the two grids */
+
+    zen_node = find_element (a_node, "Zenith");
+    az_node = find_element (a_node, "Azimuth");
+    if (zen_node == NULL || az_node == NULL)
+    {
+        sprintf (errmsg, "Missing Zenith or Azimuth grid in %s",
+            a_node->name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    if (read_angle_values (zen_node, false, &col_step[0], &row_step[0],
+        &nrows[0], &ncols[0], zenith) != SUCCESS ||
+        read_angle_values (az_node, true, &col_step[1], &row_step[1],
+        &nrows[1], &ncols[1], azimuth) != SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+
+    if (grids->nrows == 0)
+    {
+        grids->col_step = col_step[0];
+        grids->row_step = row_step[0];
+        grids->nrows = nrows[0];
+        grids->ncols = ncols[0];
+    }
+    if (col_step[0] != grids->col_step || col_step[1] != grids->col_step ||
+        row_step[0] != grids->row_step || row_step[1] != grids->row_step ||
+        nrows[0] != grids->nrows || nrows[1] != grids->nrows ||
+        ncols[0] != grids->ncols || ncols[1] != grids->ncols)
+    {
+        sprintf (errmsg, "The angle grids of %s don't match the sun angle "
+            "grids", a_node->name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  read_tile_ul
+
+PURPOSE: Reads the projection coordinates of the UL corner of the tile from
+the tile geocoding.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error reading the UL corner
+SUCCESS         Successfully read the UL corner
+
+NOTES:
+  1. The UL corner is the same at each resolution; the 10m Geoposition is
+     used, as in parse_sentinel_tile_metadata.
+******************************************************************************/
+static int read_tile_ul
+(
+    xmlNode *root,       /* I: root of the tile metadata */
+    double *ulx,         /* O: projection X of the UL corner */
+    double *uly          /* O: projection Y of the UL corner */
+)
+{
+    char FUNC_NAME[] = "read_tile_ul";   /* function name */
+    char errmsg[STR_SIZE];        /* error message */
+    xmlNode *geo_node = NULL;     /* Tile_Geocoding element */
+    xmlNode *cur_node = NULL;     /* current Geoposition element */
+    xmlChar *res = NULL;          /* resolution of the Geoposition */
+    bool found = false;           /* was the 10m Geoposition found? */
+
+    geo_node = find_element (root, "Tile_Geocoding");
+    for (cur_node = geo_node ? geo_node->children : NULL; cur_node && !found;
+        cur_node = cur_node->next)
+    {
+        if (cur_node->type != XML_ELEMENT_NODE ||
+            xmlStrcmp (cur_node->name, (const xmlChar *) "Geoposition"))
+            continue;
+        res = xmlGetProp (cur_node, (const xmlChar *) "resolution");
+        if (res != NULL && !xmlStrcmp (res, (const xmlChar *) "10"))
+        {
+            found = element_double (cur_node, "ULX", ulx) == SUCCESS &&
+                element_double (cur_node, "ULY", uly) == SUCCESS;
+        }
+        xmlFree (res);
+    }
+
+    if (!found)
+    {
+        sprintf (errmsg, "Missing the 10m Geoposition of the tile");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  read_sentinel_angle_grids
+
+PURPOSE: Reads the sun and view angle grids of a Sentinel-2 tile from its tile
+metadata.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error reading the angle grids
+SUCCESS         Successfully read the angle grids
+
+NOTES:
+  1. The tile metadata holds a view angle grid per band and detector, each
+     with angles only over the footprint of its detector.  The grids of the
+     band (or of all the bands) are merged, averaging the zeniths and, as
+     unit vectors, the azimuths where the footprints overlap.
+  2. The nodes of the grids start at the UL corner of the tile.
+******************************************************************************/
+int read_sentinel_angle_grids
+(
+    const char *tile_xml,  /* I: Sentinel tile metadata file (MTD_TL.xml) */
+    int band_id,           /* I: band ID of the view angle grids; -1 to
+                                 merge the view angles of all the bands */
+    Espa_angle_grids_t *grids  /* O: angle grids */
+)
+{
+    char FUNC_NAME[] = "read_sentinel_angle_grids";   /* function name */
+    char errmsg[STR_SIZE];        /* error message */
+    int status = SUCCESS;         /* return status */
+    int row;                      /* looping variable for the rows */
+    int col;                      /* looping variable for the columns */
+    int k;                        /* looping variable for the grids */
+    double d2r = M_PI / 180.0;    /* degrees to radians */
+    xmlDocPtr doc = NULL;         /* document tree of the tile metadata */
+    xmlNode *root = NULL;         /* root of the document */
+    xmlNode *angles_node = NULL;  /* Tile_Angles element */
+    xmlNode *cur_node = NULL;     /* current element of the angles */
+    xmlChar *attr_val = NULL;     /* bandId of a viewing angles element */
+    View_sums_t *sums = NULL;     /* sums of the merged view angles */
+    float (*zen)[ANGLE_GRID_MAX] = NULL;  /* view zeniths of a detector */
+    float (*az)[ANGLE_GRID_MAX] = NULL;   /* view azimuths of a detector */
+    float *node = NULL;           /* angle of the current node */
+
+    memset (grids, 0, sizeof (*grids));
+    doc = xmlReadFile (tile_xml, NULL, 0);
+    if (doc == NULL)
+    {
+        sprintf (errmsg, "Reading the tile metadata: %s", tile_xml);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    root = xmlDocGetRootElement (doc);
+
+    sums = calloc (1, sizeof (View_sums_t));
+    zen = malloc (ANGLE_GRID_MAX * sizeof (*zen));
+    az = malloc (ANGLE_GRID_MAX * sizeof (*az));
+    if (sums == NULL || zen == NULL || az == NULL)
+    {
+        sprintf (errmsg, "Allocating memory for the view angle grids");
+        error_handler (true, FUNC_NAME, errmsg);
+        status = ERROR;
+    }
+
+    if (status == SUCCESS && read_tile_ul (root, &grids->ulx, &grids->uly)
+        != SUCCESS)
+    {  /* Error messages already written */
+        status = ERROR;
+    }
+
+    /* The sun angles set the node spacing, which the view angles match */
+    angles_node = root ? find_element (root, "Tile_Angles") : NULL;
+    cur_node = angles_node ? find_element (angles_node, "Sun_Angles_Grid")
+        : NULL;
+    if (status == SUCCESS && cur_node == NULL)
+    {
+        sprintf (errmsg, "Missing the sun angle grids in %s", tile_xml);
+        error_handler (true, FUNC_NAME, errmsg);
+        status = ERROR;
+    }
+    if (status == SUCCESS && read_angle_pair (cur_node, grids,
+        grids->value[ANGLE_SOLAR_ZENITH], grids->value[ANGLE_SOLAR_AZIMUTH])
+        != SUCCESS)
+    {  /* Error messages already written */
+        status = ERROR;
+    }
+
+    /* Merge the view angles of the detectors */
+    for (cur_node = angles_node ? angles_node->children : NULL;
+        cur_node && status == SUCCESS; cur_node = cur_node->next)
+    {
+        if (cur_node->type != XML_ELEMENT_NODE ||
+            xmlStrcmp (cur_node->name,
+                (const xmlChar *) "Viewing_Incidence_Angles_Grids"))
+            continue;
+        if (band_id >= 0)
+        {
+            attr_val = xmlGetProp (cur_node, (const xmlChar *) "bandId");
+            k = attr_val ? atoi ((const char *) attr_val) : -1;
+            xmlFree (attr_val);
+            if (k != band_id)
+                continue;
+        }
+
+        if (read_angle_pair (cur_node, grids, zen, az) != SUCCESS)
+        {  /* Error messages already written */
+            status = ERROR;
+            break;
+        }
+        for (row = 0; row < grids->nrows; row++)
+        {
+            for (col = 0; col < grids->ncols; col++)
+            {
+                if (isnan (zen[row][col]) || isnan (az[row][col]))
+                    continue;
+                sums->zenith[row][col] += zen[row][col];
+                sums->sin_az[row][col] += sin (az[row][col] * d2r);
+                sums->cos_az[row][col] += cos (az[row][col] * d2r);
+                sums->count[row][col]++;
+            }
+        }
+    }
+
+    if (status == SUCCESS)
+    {
+        for (row = 0; row < grids->nrows; row++)
+        {
+            for (col = 0; col < grids->ncols; col++)
+            {
+                if (sums->count[row][col] == 0)
+                {
+                    grids->value[ANGLE_VIEW_ZENITH][row][col] = NAN;
+                    grids->value[ANGLE_VIEW_AZIMUTH][row][col] = NAN;
+                    continue;
+                }
+                grids->value[ANGLE_VIEW_ZENITH][row][col] =
+                    sums->zenith[row][col] / sums->count[row][col];
+                grids->value[ANGLE_VIEW_AZIMUTH][row][col] =
+                    atan2 (sums->sin_az[row][col], sums->cos_az[row][col]) /
+                    d2r;
+            }
+        }
+
+        for (k = 0; k < ANGLE_NGRIDS; k++)
+        {
+            for (row = 0; row < grids->nrows; row++)
+            {
+                node = grids->value[k][row];
+                for (col = 0; col < grids->ncols; col++)
+                    if (!isnan (node[col]))
+                        grids->present[k] = true;
+            }
+        }
+    }
+
+    free (sums);
+    free (zen);
+    free (az);
+    xmlFreeDoc (doc);
+
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  compute_julian_date
+
+PURPOSE: Computes the Julian date of midnight (UT) of a calendar date.
+
+RETURN VALUE:
+Type = double
+Value        Description
+-----        -----------
+jd           Julian date of the start of the day
+******************************************************************************/
+static double compute_julian_date
+(
+    int year,            /* I: year */
+    int month,           /* I: month (1-12) */
+    int day              /* I: day of the month */
+)
+{
+    int a = (14 - month) / 12;    /* 1 for January and February */
+    int y = year + 4800 - a;      /* years since March 1, 4801 BC */
+    int m = month + 12 * a - 3;   /* months since March */
+    long jdn;                     /* Julian day number of the date */
+
+    jdn = day + (153 * m + 2) / 5 + 365L * y + y / 4 - y / 100 + y / 400 -
+        32045;
+
+    return (jdn - 0.5);
+}
+
+
+/******************************************************************************
+MODULE:  compute_landsat_angle_grids
+
+PURPOSE: Computes the solar angle grids of a Landsat scene from the position
+of the sun at the scene center time.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error computing the angle grids
+SUCCESS         Successfully computed the angle grids
+
+NOTES:
+  1. The nodes cover the scene from the UL corner of its UL pixel, no
+     closer than ANGLE_MIN_STEP.  Their latitude and longitude come from the
+     process-wide transformation cache.
+  2. The sun position is taken at the scene center time for every node;
+     the time the scene takes to acquire moves the sun by less than 0.01
+     degrees.
+  3. The view angle grids are left without angles.
+******************************************************************************/
+int compute_landsat_angle_grids
+(
+    const Espa_global_meta_t *gmeta, /* I: global metadata */
+    const Espa_band_meta_t *bmeta,   /* I: representative band */
+    Espa_angle_grids_t *grids        /* O: angle grids */
+)
+{
+    char FUNC_NAME[] = "compute_landsat_angle_grids";  /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    int status = SUCCESS;       /* return status */
+    int year, month, day;       /* acquisition date */
+    int hour, minute;           /* scene center time */
+    int npts;                   /* number of nodes */
+    int row;                    /* looping variable for the rows */
+    int col;                    /* looping variable for the columns */
+    int i;                      /* looping variable */
+    double second;              /* seconds of the scene center time */
+    double seconds;             /* seconds of the day */
+    double jd0;                 /* Julian date of the start of the day */
+    double ra_hrs;              /* right ascension of the sun (hours) */
+    double dec_deg;             /* declination of the sun (degrees) */
+    double dist_au;             /* distance to the sun (AU) */
+    double gha;                 /* Greenwich hour angle of Aries (radians) */
+    double ha;                  /* local hour angle of the sun (radians) */
+    double lat;                 /* latitude of a node (radians) */
+    double dec;                 /* declination of the sun (radians) */
+    double cos_zen;             /* cosine of the solar zenith */
+    double width, height;       /* extent of the scene (meters) */
+    double d2r = M_PI / 180.0;  /* degrees to radians */
+    double parms[IAS_PROJ_PARAM_SIZE];  /* geographic projection parameters */
+    double *x = NULL;           /* projection X of the nodes */
+    double *y = NULL;           /* projection Y of the nodes */
+    double *lon = NULL;         /* longitude of the nodes (degrees) */
+    double *lat_deg = NULL;     /* latitude of the nodes (degrees) */
+    IAS_PROJECTION projection;  /* projection of the scene */
+    IAS_PROJECTION geographic;  /* geographic projection */
+    IAS_GEO_PROJ_TRANSFORMATION *trans = NULL;  /* scene to geographic */
+
+    memset (grids, 0, sizeof (*grids));
+    if (sscanf (gmeta->acquisition_date, "%d-%d-%d", &year, &month, &day)
+        != 3 || sscanf (gmeta->scene_center_time, "%d:%d:%lf", &hour,
+        &minute, &second) != 3)
+    {
+        sprintf (errmsg, "Invalid acquisition date/time: %s %s",
+            gmeta->acquisition_date, gmeta->scene_center_time);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    seconds = hour * 3600.0 + minute * 60.0 + second;
+    jd0 = compute_julian_date (year, month, day);
+
+    if (ias_geo_compute_sun_position (jd0 + seconds / IAS_SEC_PER_DAY,
+        &ra_hrs, &dec_deg, &dist_au) != SUCCESS)
+    {
+        sprintf (errmsg, "Computing the sun position");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    ias_geo_find_ariesha (jd0, seconds, &gha);
+    dec = dec_deg * d2r;
+
+    /* Set up the transformation from the scene to geographic */
+    if (get_scene_projection (&gmeta->proj_info, &projection) != SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+    for (i = 0; i < IAS_PROJ_PARAM_SIZE; i++)
+        parms[i] = 0.0;
+    ias_geo_set_projection (GEO, NULLZONE, DEGREE, projection.spheroid,
+        parms, &geographic);
+    trans = ias_geo_get_cached_proj_transformation (&projection,
+        &geographic);
+    if (trans == NULL)
+    {
+        sprintf (errmsg, "Creating the transformation to geographic");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Lay out the nodes from the UL corner of the UL pixel */
+    grids->ulx = gmeta->proj_info.ul_corner[0];
+    grids->uly = gmeta->proj_info.ul_corner[1];
+    if (!strcmp (gmeta->proj_info.grid_origin, "CENTER"))
+    {
+        grids->ulx -= 0.5 * bmeta->pixel_size[0];
+        grids->uly += 0.5 * bmeta->pixel_size[1];
+    }
+    width = bmeta->nsamps * bmeta->pixel_size[0];
+    height = bmeta->nlines * bmeta->pixel_size[1];
+    grids->col_step = fmax (ANGLE_MIN_STEP, width / (ANGLE_GRID_MAX - 2));
+    grids->row_step = fmax (ANGLE_MIN_STEP, height / (ANGLE_GRID_MAX - 2));
+    grids->ncols = (int) ceil (width / grids->col_step) + 1;
+    grids->nrows = (int) ceil (height / grids->row_step) + 1;
+
+    npts = grids->nrows * grids->ncols;
+    x = malloc (npts * sizeof (double));
+    y = malloc (npts * sizeof (double));
+    lon = malloc (npts * sizeof (double));
+    lat_deg = malloc (npts * sizeof (double));
+    if (x == NULL || y == NULL || lon == NULL || lat_deg == NULL)
+    {
+        sprintf (errmsg, "Allocating memory for the angle grid nodes");
+        error_handler (true, FUNC_NAME, errmsg);
+        status = ERROR;
+    }
+
+    /* Transform all the nodes in one call */
+    if (status == SUCCESS)
+    {
+        for (row = 0, i = 0; row < grids->nrows; row++)
+        {
+            for (col = 0; col < grids->ncols; col++, i++)
+            {
+                x[i] = grids->ulx + col * grids->col_step;
+                y[i] = grids->uly - row * grids->row_step;
+            }
+        }
+        if (ias_geo_transform_coordinates (trans, npts, x, y, lon, lat_deg)
+            != SUCCESS)
+        {
+            sprintf (errmsg, "Transforming the angle grid nodes to lat/long");
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+        }
+    }
+
+    if (status == SUCCESS)
+    {
+        for (row = 0, i = 0; row < grids->nrows; row++)
+        {
+            for (col = 0; col < grids->ncols; col++, i++)
+            {
+                lat = lat_deg[i] * d2r;
+                ha = gha + lon[i] * d2r - ra_hrs * 15.0 * d2r;
+                cos_zen = sin (lat) * sin (dec) + cos (lat) * cos (dec) *
+                    cos (ha);
+                if (cos_zen > 1.0)
+                    cos_zen = 1.0;
+                else if (cos_zen < -1.0)
+                    cos_zen = -1.0;
+                grids->value[ANGLE_SOLAR_ZENITH][row][col] =
+                    acos (cos_zen) / d2r;
+                grids->value[ANGLE_SOLAR_AZIMUTH][row][col] =
+                    atan2 (-sin (ha) * cos (dec), sin (dec) * cos (lat) -
+                    cos (dec) * sin (lat) * cos (ha)) / d2r;
+                grids->value[ANGLE_VIEW_ZENITH][row][col] = NAN;
+                grids->value[ANGLE_VIEW_AZIMUTH][row][col] = NAN;
+            }
+        }
+        grids->present[ANGLE_SOLAR_ZENITH] = true;
+        grids->present[ANGLE_SOLAR_AZIMUTH] = true;
+    }
+
+    free (x);
+    free (y);
+    free (lon);
+    free (lat_deg);
+    ias_geo_release_cached_proj_transformation (trans);
+
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  count_angle_bands
+
+PURPOSE: Returns the number of angle bands, one per grid with angles.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+n            Number of angle bands
+******************************************************************************/
+int count_angle_bands
+(
+    const Espa_angle_grids_t *grids  /* I: angle grids */
+)
+{
+    int k;                   /* looping variable for the grids */
+    int n = 0;               /* number of angle bands */
+
+    for (k = 0; k < ANGLE_NGRIDS; k++)
+        if (grids->present[k])
+            n++;
+
+    return n;
+}
+
+
+/******************************************************************************
+MODULE:  setup_angle_bands
+
+PURPOSE: Sets up the band metadata of the angle bands.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           A name of the bands doesn't fit
+SUCCESS         Successfully set up the angle bands
+
+NOTES:
+  1. out_bmeta needs to hold count_angle_bands bands, initialized by
+     allocate_band_metadata or append_band_metadata.  They are in the order
+     solar zenith, solar azimuth, sensor zenith, sensor azimuth, skipping
+     the grids without angles.
+  2. No pixels are written.  The bands are written by write_angle_bands.
+******************************************************************************/
+int setup_angle_bands
+(
+    Espa_internal_meta_t *xml_meta, /* I: input XML metadata */
+    const Espa_band_meta_t *bmeta,  /* I: representative band */
+    const Espa_angle_grids_t *grids,  /* I: angle grids */
+    const char *production_date,    /* I: production date of the bands */
+    Espa_band_meta_t *out_bmeta     /* O: band metadata of the
+                                          count_angle_bands angle bands */
+)
+{
+    char FUNC_NAME[] = "setup_angle_bands";  /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    char tmpstr[STR_SIZE];      /* first four characters of the short name */
+    int count;                  /* number of chars copied in snprintf */
+    int k;                      /* looping variable for the grids */
+    bool azimuth;               /* is the band of azimuths? */
+    Espa_band_meta_t *ameta = out_bmeta;  /* metadata of the current band */
+
+    strncpy (tmpstr, bmeta->short_name, 4);
+    tmpstr[4] = '\0';
+
+    for (k = 0; k < ANGLE_NGRIDS; k++)
+    {
+        if (!grids->present[k])
+            continue;
+        azimuth = (k == ANGLE_SOLAR_AZIMUTH || k == ANGLE_VIEW_AZIMUTH);
+
+        strcpy (ameta->name, angle_names[k]);
+        sprintf (ameta->short_name, "%s%s", tmpstr, angle_short[k]);
+        strcpy (ameta->long_name, angle_long[k]);
+        count = snprintf (ameta->file_name, sizeof (ameta->file_name),
+            "%s_%s.img", xml_meta->global.product_id, ameta->name);
+        if (count < 0 || count >= sizeof (ameta->file_name))
+        {
+            sprintf (errmsg, "Overflow of the filename of %s", ameta->name);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+
+        strcpy (ameta->product, "angle_bands");
+        strcpy (ameta->source, "level1");
+        strcpy (ameta->category, "image");
+        ameta->data_type = ESPA_INT16;
+        ameta->fill_value = ANGLE_FILL_VALUE;
+        ameta->scale_factor = ANGLE_SCALE;
+        strcpy (ameta->data_units, "degrees");
+        ameta->valid_range[0] = azimuth ? -180.0 / ANGLE_SCALE : 0.0;
+        ameta->valid_range[1] = (azimuth ? 180.0 : 90.0) / ANGLE_SCALE;
+        ameta->resample_method = ESPA_BI;
+        ameta->nlines = bmeta->nlines;
+        ameta->nsamps = bmeta->nsamps;
+        ameta->pixel_size[0] = bmeta->pixel_size[0];
+        ameta->pixel_size[1] = bmeta->pixel_size[1];
+        strcpy (ameta->pixel_units, bmeta->pixel_units);
+        sprintf (ameta->app_version, "create_angle_bands_%s",
+            ESPA_COMMON_VERSION);
+        strcpy (ameta->production_date, production_date);
+        ameta++;
+    }
+
+    /* Successful set up */
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  generate_angle_line
+
+PURPOSE: Interpolates the angles of one grid to one line of the scene.
+
+RETURN VALUE: None
+
+NOTES:
+  1. The pixel centers map to the grid columns as gx0 + samp * dgx, so the
+     angle is linear over the samples between two columns of nodes, and
+     carries on linearly past the first and last columns.
+******************************************************************************/
+static void generate_angle_line
+(
+    const Espa_angle_grids_t *grids,  /* I: angle grids */
+    int k,               /* I: index of the grid */
+    double gy,           /* I: grid row of the line */
+    double gx0,          /* I: grid column of the first sample */
+    double dgx,          /* I: grid columns per sample */
+    int nsamps,          /* I: number of samples in the line */
+    int16_t *out         /* O: angles of the line (hundredths of degrees) */
+)
+{
+    int row;             /* grid row above the line */
+    int row2;            /* grid row below the line */
+    int col;             /* grid column left of a segment */
+    int col2;            /* grid column right of a segment */
+    int samp = 0;        /* first sample of the current segment */
+    int end;             /* sample past the end of the segment */
+    int i;               /* looping variable */
+    double a, b;         /* angles at the ends of the segment */
+    double base;         /* angle at the first sample of the segment */
+    float col_val[ANGLE_GRID_MAX];  /* angle of the line at each column */
+    bool azimuth;        /* is the grid of azimuths? */
+
+    azimuth = (k == ANGLE_SOLAR_AZIMUTH || k == ANGLE_VIEW_AZIMUTH);
+
+    /* Interpolate down the columns of nodes */
+    row = (int) floor (gy);
+    if (row > grids->nrows - 2)
+        row = grids->nrows - 2;
+    if (row < 0)
+        row = 0;
+    row2 = (row + 1 < grids->nrows) ? row + 1 : row;
+    for (col = 0; col < grids->ncols; col++)
+        col_val[col] = blend_angles (grids->value[k][row][col],
+            grids->value[k][row2][col], gy - row, azimuth);
+
+    /* Ramp across each segment between two columns of nodes */
+    while (samp < nsamps)
+    {
+        col = (int) floor (gx0 + samp * dgx);
+        if (col > grids->ncols - 2)
+            col = grids->ncols - 2;
+        if (col < 0)
+            col = 0;
+        col2 = (col + 1 < grids->ncols) ? col + 1 : col;
+
+        end = nsamps;
+        if (col < grids->ncols - 2)
+        {
+            end = (int) ceil ((col + 1 - gx0) / dgx);
+            if (end > nsamps)
+                end = nsamps;
+            if (end <= samp)
+                end = samp + 1;
+        }
+
+        a = col_val[col];
+        b = col_val[col2];
+        if (isnan (a) && isnan (b))
+        {
+            for (i = samp; i < end; i++)
+                out[i] = ANGLE_FILL_VALUE;
+        }
+        else
+        {
+            if (isnan (a))
+                a = b;
+            else if (isnan (b))
+                b = a;
+            if (azimuth && b - a > 180.0)
+                b -= 360.0;
+            else if (azimuth && b - a < -180.0)
+                b += 360.0;
+            base = a + (b - a) * (gx0 + samp * dgx - col);
+            angle_ramp (base / ANGLE_SCALE, (b - a) * dgx / ANGLE_SCALE,
+                end - samp, azimuth, &out[samp]);
+        }
+        samp = end;
+    }
+}
+
+
+/******************************************************************************
+MODULE:  write_angle_bands
+
+PURPOSE: Generates the angle bands set up by setup_angle_bands and writes out
+their pixels and ENVI headers.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the angle bands
+SUCCESS         Successfully wrote the angle bands
+
+NOTES:
+  1. The bands are generated ANGLE_BLOCK_LINES lines at a time and written
+     through the coalescing raw binary writer, so the full bands are never
+     held in memory.
+  2. The pixel centers of the representative band are mapped to the grids
+     from the UL corner in the projection information of the global
+     metadata.
+******************************************************************************/
+int write_angle_bands
+(
+    Espa_global_meta_t *gmeta,      /* I: global metadata */
+    const Espa_band_meta_t *bmeta,  /* I: representative band */
+    const Espa_angle_grids_t *grids,  /* I: angle grids */
+    Espa_band_meta_t *out_bmeta     /* I/O: band metadata of the angle bands;
+                                            the checksum and statistics are
+                                            set */
+)
+{
+    char FUNC_NAME[] = "write_angle_bands";  /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    char tmpstr[STR_SIZE];      /* name of the ENVI header file */
+    int status = SUCCESS;       /* return status */
+    int nbands;                 /* number of angle bands */
+    int grid[ANGLE_NGRIDS];     /* grid of each angle band */
+    int line;                   /* looping variable for the lines */
+    int block_line;             /* first line of the block */
+    int nlines;                 /* number of lines in the block */
+    int i, k;                   /* looping variables */
+    double ulx, uly;            /* projection coordinates of the UL pixel
+                                   center */
+    double gx0;                 /* grid column of the first sample */
+    double dgx;                 /* grid columns per sample */
+    double gy;                  /* grid row of the line */
+    size_t band_bytes;          /* number of bytes in each band */
+    int16_t *block[ANGLE_NGRIDS] = {NULL, NULL, NULL, NULL};
+                                /* angles of a block of each band */
+    Raw_binary_writer_t *writer[ANGLE_NGRIDS] = {NULL, NULL, NULL, NULL};
+                                /* band writers */
+    Envi_header_t envi_hdr;     /* output ENVI header information */
+
+    nbands = 0;
+    for (k = 0; k < ANGLE_NGRIDS; k++)
+        if (grids->present[k])
+            grid[nbands++] = k;
+
+    ulx = gmeta->proj_info.ul_corner[0];
+    uly = gmeta->proj_info.ul_corner[1];
+    if (strcmp (gmeta->proj_info.grid_origin, "CENTER"))
+    {
+        ulx += 0.5 * bmeta->pixel_size[0];
+        uly -= 0.5 * bmeta->pixel_size[1];
+    }
+    gx0 = (ulx - grids->ulx) / grids->col_step;
+    dgx = bmeta->pixel_size[0] / grids->col_step;
+
+    band_bytes = (size_t) bmeta->nlines * bmeta->nsamps * sizeof (int16_t);
+    for (i = 0; i < nbands; i++)
+    {
+        block[i] = malloc ((size_t) ANGLE_BLOCK_LINES * bmeta->nsamps *
+            sizeof (int16_t));
+        if (block[i] == NULL)
+        {
+            sprintf (errmsg, "Allocating memory for the angle bands");
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+            break;
+        }
+
+        writer[i] = open_raw_binary_writer (out_bmeta[i].file_name,
+            band_bytes, 0);
+        if (writer[i] == NULL)
+        {
+            sprintf (errmsg, "Opening the angle band file: %s",
+                out_bmeta[i].file_name);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+            break;
+        }
+        if (start_raw_binary_writer_stats (writer[i], &out_bmeta[i])
+            != SUCCESS)
+        {
+            sprintf (errmsg, "Starting the statistics of band %s",
+                out_bmeta[i].name);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+            break;
+        }
+    }
+
+    for (block_line = 0; status == SUCCESS && block_line < bmeta->nlines;
+        block_line += ANGLE_BLOCK_LINES)
+    {
+        nlines = bmeta->nlines - block_line;
+        if (nlines > ANGLE_BLOCK_LINES)
+            nlines = ANGLE_BLOCK_LINES;
+
+        for (i = 0; i < nbands; i++)
+        {
+            for (line = 0; line < nlines; line++)
+            {
+                gy = (grids->uly - (uly - (block_line + line) *
+                    bmeta->pixel_size[1])) / grids->row_step;
+                generate_angle_line (grids, grid[i], gy, gx0, dgx,
+                    bmeta->nsamps, &block[i][(size_t) line * bmeta->nsamps]);
+            }
+
+            if (append_raw_binary_writer (writer[i], nlines, bmeta->nsamps,
+                sizeof (int16_t), block[i]) != SUCCESS)
+            {
+                sprintf (errmsg, "Writing the angle band file: %s",
+                    out_bmeta[i].file_name);
+                error_handler (true, FUNC_NAME, errmsg);
+                status = ERROR;
+                break;
+            }
+        }
+    }
+
+    for (i = 0; i < nbands; i++)
+    {
+        if (writer[i] != NULL && status == SUCCESS)
+        {
+            get_raw_binary_writer_checksum (writer[i],
+                out_bmeta[i].checksum);
+            get_raw_binary_writer_stats (writer[i], &out_bmeta[i].stats);
+        }
+        if (writer[i] != NULL && close_raw_binary_writer (writer[i])
+            != SUCCESS && status == SUCCESS)
+        {
+            sprintf (errmsg, "Closing the angle band file: %s",
+                out_bmeta[i].file_name);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+        }
+        free (block[i]);
+    }
+    if (status != SUCCESS)
+        return (ERROR);
+
+    for (i = 0; i < nbands; i++)
+    {
+        /* Create the ENVI header for the band */
+        if (create_envi_struct (&out_bmeta[i], gmeta, &envi_hdr) != SUCCESS)
+        {
+            sprintf (errmsg, "Error creating the ENVI header file.");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+
+        /* Write the ENVI header */
+        sprintf (tmpstr, "%s", out_bmeta[i].file_name);
+        sprintf (&tmpstr[strlen(tmpstr)-3], "hdr");
+        if (write_envi_hdr (tmpstr, &envi_hdr) != SUCCESS)
+        {
+            sprintf (errmsg, "Writing the ENVI header file: %s.", tmpstr);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+    }
+
+    /* Successful write */
+    return (SUCCESS);
+}
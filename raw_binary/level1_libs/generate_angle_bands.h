@@ -0,0 +1,115 @@
+/*****************************************************************************
+FILE: generate_angle_bands.h
+
+PURPOSE: Contains defines, structures, and prototypes for generating the
+per-pixel solar and view angle bands of a scene from coarse grids of angles.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The grids of a Sentinel-2 tile are read from its tile metadata
+     (MTD_TL.xml), which holds the sun angles and the view angles of each
+     band and detector on 5 km grids.  The view angles of the detectors of
+     the representative band are merged into one grid.
+  2. The grids of a Landsat scene are computed from the solar position at
+     the scene center time, at nodes spaced at least ANGLE_MIN_STEP apart.
+     Only the solar angles are computed, since the view angles need the
+     angle coefficient file of the scene.
+  3. The angles are bilinearly interpolated to the pixel centers of the
+     representative band and written as 16-bit integers in hundredths of a
+     degree, with ANGLE_FILL_VALUE where no grid node around the pixel has
+     an angle.  The azimuths are from north, clockwise, in -180 to 180
+     degrees.
+*****************************************************************************/
+
+#ifndef GENERATE_ANGLE_BANDS_H
+#define GENERATE_ANGLE_BANDS_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include "error_handler.h"
+#include "espa_metadata.h"
+#include "raw_binary_writer.h"
+#include "envi_header.h"
+#include "generate_land_water_mask.h"
+
+/* Defines */
+#define ANGLE_SOLAR_ZENITH 0   /* index of the solar zenith grid */
+#define ANGLE_SOLAR_AZIMUTH 1  /* index of the solar azimuth grid */
+#define ANGLE_VIEW_ZENITH 2    /* index of the view zenith grid */
+#define ANGLE_VIEW_AZIMUTH 3   /* index of the view azimuth grid */
+#define ANGLE_NGRIDS 4         /* number of angle grids */
+
+#define ANGLE_GRID_MAX 64      /* most rows and columns of a grid */
+#define ANGLE_MIN_STEP 5000.0  /* smallest node spacing of the computed
+                                  Landsat grids (meters) */
+#define ANGLE_SCALE 0.01       /* scale factor of the angle bands */
+#define ANGLE_FILL_VALUE -32768  /* fill value of the angle bands */
+#define ANGLE_BLOCK_LINES 128  /* lines generated and written at a time */
+
+/* Grids of angles, with the nodes in projection coordinates */
+typedef struct
+{
+    double ulx;          /* projection X of the UL node */
+    double uly;          /* projection Y of the UL node */
+    double col_step;     /* spacing of the columns of nodes (meters) */
+    double row_step;     /* spacing of the rows of nodes (meters) */
+    int nrows;           /* number of rows of nodes */
+    int ncols;           /* number of columns of nodes */
+    bool present[ANGLE_NGRIDS];  /* does the grid hold any angle? */
+    float value[ANGLE_NGRIDS][ANGLE_GRID_MAX][ANGLE_GRID_MAX];
+                         /* angle at each node (degrees); NAN if none */
+} Espa_angle_grids_t;
+
+/* Prototypes */
+int sentinel_angle_band_id
+(
+    const char *band_name  /* I: name of the Sentinel band (B01-B12, B8A) */
+);
+
+int read_sentinel_angle_grids
+(
+    const char *tile_xml,  /* I: Sentinel tile metadata file (MTD_TL.xml) */
+    int band_id,           /* I: band ID of the view angle grids; -1 to
+                                 merge the view angles of all the bands */
+    Espa_angle_grids_t *grids  /* O: angle grids */
+);
+
+int compute_landsat_angle_grids
+(
+    const Espa_global_meta_t *gmeta, /* I: global metadata */
+    const Espa_band_meta_t *bmeta,   /* I: representative band */
+    Espa_angle_grids_t *grids        /* O: angle grids */
+);
+
+int count_angle_bands
+(
+    const Espa_angle_grids_t *grids  /* I: angle grids */
+);
+
+int setup_angle_bands
+(
+    Espa_internal_meta_t *xml_meta, /* I: input XML metadata */
+    const Espa_band_meta_t *bmeta,  /* I: representative band */
+    const Espa_angle_grids_t *grids,  /* I: angle grids */
+    const char *production_date,    /* I: production date of the bands */
+    Espa_band_meta_t *out_bmeta     /* O: band metadata of the
+                                          count_angle_bands angle bands */
+);
+
+int write_angle_bands
+(
+    Espa_global_meta_t *gmeta,      /* I: global metadata */
+    const Espa_band_meta_t *bmeta,  /* I: representative band */
+    const Espa_angle_grids_t *grids,  /* I: angle grids */
+    Espa_band_meta_t *out_bmeta     /* I/O: band metadata of the angle bands;
+                                            the checksum and statistics are
+                                            set */
+);
+
+#endif
@@ -65,8 +65,8 @@ int generate_doy
 /******************************************************************************
 MODULE:  generate_date_bands
 
-PURPOSE: Creates the date bands for the current scene.  These include a
-DOY-year band, DOY band, and a year band.
+PURPOSE: Determines the values of the date bands for the current scene.  These
+include a DOY-year band, DOY band, and a year band.
 
 RETURN VALUE:
 Type = int
@@ -80,14 +80,18 @@ NOTES:
      of YYYYDOY (example 2015232 for Aug. 20, 2015).
   2. The individual date and year bands will be unsigned 16-bit integers.
   3. The number of lines and samples is pulled from band1 (LPGS level 1 product)     in the XML file.
+  4. Every pixel of a date band holds the same value, so only the values are
+     returned.  The bands are described as constant bands in the metadata
+     (see is_constant_band), and their pixels are only synthesized when
+     needed.
 ******************************************************************************/
 int generate_date_bands
 (
     Espa_internal_meta_t *xml_meta,  /* I: input XML metadata */
-    unsigned int **jdate_band,       /* O: pointer to date buffer with
+    unsigned int *jdate_value,       /* O: value of the date band,
                                            year*1000 + DOY */
-    unsigned short **doy_band,       /* O: pointer to DOY buffer */
-    unsigned short **year_band,      /* O: pointer to year buffer */
+    unsigned short *doy_value,       /* O: value of the DOY band */
+    unsigned short *year_value,      /* O: value of the year band */
     int *nlines,                     /* O: number of lines in date bands */
     int *nsamps                      /* O: number of samples in date bands */
 )
@@ -97,11 +101,10 @@ int generate_date_bands
     char year_str[5];           /* string for the year */
     char month_str[3];          /* string for the month */
     char day_str[3];            /* string for the day */
-    int i;                      /* looping variable */
     int year, month, day;       /* year, month, and day from the acquisition
                                    date */
     int doy;                    /* day of year */
-    int refl_indx = -9;         /* band index in XML file for the
+    int refl_indx;              /* band index in XML file for the
                                    representative reflectance band */
     Espa_global_meta_t *gmeta = &xml_meta->global;
                                       /* pointer to global metadata structure */
@@ -143,15 +146,7 @@ int generate_date_bands
     }
      
     /* Use band 1 as the representative band in the XML */
-    for (i = 0; i < xml_meta->nbands; i++)
-    {
-        if (!strcmp (xml_meta->band[i].name, "b1"))
-        {
-            /* this is the index we'll use for reflectance band info */
-            refl_indx = i;
-            break;
-        }
-    }
+    refl_indx = espa_find_band (xml_meta, "b1");
 
     /* Determine the day of year */
     doy = generate_doy (year, month, day);
@@ -164,7 +159,7 @@ int generate_date_bands
     }
      
     /* Make sure the representative band was found in the XML file */
-    if (refl_indx == -9)
+    if (refl_indx < 0)
     {
         sprintf (errmsg, "Band 1 (b1) was not found in the XML file");
         error_handler (true, FUNC_NAME, errmsg);
@@ -174,46 +169,217 @@ int generate_date_bands
     *nlines = bmeta->nlines;
     *nsamps = bmeta->nsamps;
 
-    /* Allocate memory for the date, DOY, and year bands */
-    *jdate_band = calloc (*nlines * *nsamps, sizeof (unsigned int));
-    if (*jdate_band == NULL)
-    {
-        sprintf (errmsg, "Error allocating memory for the date/year band");
-        error_handler (true, FUNC_NAME, errmsg);
+    printf ("INFO: acquisition_date is %s\n", gmeta->acquisition_date);
+    printf ("INFO: year-month-day is %d-%d-%d\n", year, month, day);
+    printf ("INFO: DOY is %d\n", doy);
+
+    /* Every pixel of the date bands holds the same date information */
+    *jdate_value = (unsigned int) (year * 1000 + doy);
+    *doy_value = (unsigned short) doy;
+    *year_value = (unsigned short) year;
+
+    /* Successful conversion */
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  setup_date_bands
+
+PURPOSE: Sets up the band metadata of the three date bands for the current
+scene as constant bands: the combined date-year band, the DOY band, and the
+year band.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error setting up the date bands
+SUCCESS         Successfully set up the date bands
+
+NOTES:
+  1. out_bmeta needs to hold three bands, initialized by
+     allocate_band_metadata or append_band_metadata.
+  2. No pixels are written.  The caller can write each band out with
+     expand_constant_band and reset its constant_value, or leave it as a
+     constant band in the metadata.
+******************************************************************************/
+int setup_date_bands
+(
+    Espa_internal_meta_t *xml_meta, /* I: input XML metadata */
+    const Espa_band_meta_t *bmeta,  /* I: band 1, the representative band */
+    const char *production_date,    /* I: production date of the bands */
+    Espa_band_meta_t *out_bmeta     /* O: band metadata of the three date
+                                          bands */
+)
+{
+    char FUNC_NAME[] = "setup_date_bands";  /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    char tmpstr[STR_SIZE];      /* first four characters of the short name */
+    char tmp_ext[STR_SIZE];     /* filename extension of the band */
+    int i;                      /* looping variable */
+    int nlines;                 /* number of lines in date bands */
+    int nsamps;                 /* number of samples in date bands */
+    unsigned int jdate_value;   /* value of the date band */
+    unsigned short jdoy_value;  /* value of the DOY band */
+    unsigned short jyear_value; /* value of the year band */
+    Espa_band_meta_t *dmeta = NULL;  /* metadata of the current date band */
+
+    /* Generate the values of the date bands for this scene */
+    if (generate_date_bands (xml_meta, &jdate_value, &jdoy_value,
+        &jyear_value, &nlines, &nsamps) != SUCCESS)
+    {  /* Error messages already written */
         return (ERROR);
     }
 
-    *doy_band = calloc (*nlines * *nsamps, sizeof (unsigned short));
-    if (*doy_band == NULL)
+    /* Make sure the band 1 number of lines and samples matches what was used
+       for creating the date bands, otherwise we will have a mismatch in the
+       resolution and output XML information. */
+    if (nlines != bmeta->nlines || nsamps != bmeta->nsamps)
     {
-        sprintf (errmsg, "Error allocating memory for the DOY band");
+        sprintf (errmsg, "Band 1 from the caller does not match band 1 "
+            "from the generate_date_bands function call.  Local nlines/nsamps: "
+            "%d, %d   Returned nlines/nsamps: %d, %d", bmeta->nlines,
+            bmeta->nsamps, nlines, nsamps);
         error_handler (true, FUNC_NAME, errmsg);
         return (ERROR);
     }
+    strncpy (tmpstr, bmeta->short_name, 4);
+    tmpstr[4] = '\0';
 
-    *year_band = calloc (*nlines * *nsamps,
-        sizeof (unsigned short));
-    if (*year_band == NULL)
+    for (i = 0; i < 3; i++)
     {
-        sprintf (errmsg, "Error allocating memory for the year band");
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
+        /* Set up the band metadata for the date bands */
+        dmeta = &out_bmeta[i];
+        strcpy (dmeta->product, "intermediate_data");
+        strcpy (dmeta->source, "level1");
+
+        /* Band-specific names */
+        switch (i)
+        {
+            case (0):  /* combined date/year */
+                strcpy (dmeta->name, "combined_date");
+                strcpy (dmeta->category, "image");
+                dmeta->data_type = ESPA_UINT32;
+                sprintf (dmeta->short_name, "%sDATE", tmpstr);
+                strcpy (dmeta->long_name,
+                    "doy and year (YEAR * 1000 + DOY)");
+                sprintf (tmp_ext, "date.img");
+                strcpy (dmeta->data_units, "date");
+                dmeta->constant_value = jdate_value;
+                break;
+
+            case (1):  /* date */
+                strcpy (dmeta->name, "doy");
+                strcpy (dmeta->category, "image");
+                dmeta->data_type = ESPA_UINT16;
+                sprintf (dmeta->short_name, "%sDOY", tmpstr);
+                strcpy (dmeta->long_name, "day of year");
+                sprintf (tmp_ext, "doy.img");
+                dmeta->valid_range[0] = 1.0;
+                dmeta->valid_range[1] = 366.0;
+                strcpy (dmeta->data_units, "date");
+                dmeta->constant_value = jdoy_value;
+                break;
+
+            case (2):  /* year */
+                strcpy (dmeta->name, "year");
+                strcpy (dmeta->category, "image");
+                dmeta->data_type = ESPA_UINT16;
+                sprintf (dmeta->short_name, "%sYEAR", tmpstr);
+                strcpy (dmeta->long_name, "year");
+                sprintf (tmp_ext, "year.img");
+                dmeta->valid_range[0] = 1970.0;
+                dmeta->valid_range[1] = 9999.0;
+                strcpy (dmeta->data_units, "date");
+                dmeta->constant_value = jyear_value;
+                break;
+        }
+
+        /* Use the product name to create the date filename */
+        snprintf (dmeta->file_name, sizeof (dmeta->file_name), "%s_%s",
+            xml_meta->global.product_id, tmp_ext);
+
+        dmeta->resample_method = ESPA_NN;
+        dmeta->nlines = nlines;
+        dmeta->nsamps = nsamps;
+        dmeta->pixel_size[0] = bmeta->pixel_size[0];
+        dmeta->pixel_size[1] = bmeta->pixel_size[1];
+        strcpy (dmeta->pixel_units, bmeta->pixel_units);
+        sprintf (dmeta->app_version, "create_date_bands_%s",
+            ESPA_COMMON_VERSION);
+        strcpy (dmeta->production_date, production_date);
     }
 
-    printf ("INFO: acquisition_date is %s\n", gmeta->acquisition_date);
-    printf ("INFO: year-month-day is %d-%d-%d\n", year, month, day);
-    printf ("INFO: DOY is %d\n", doy);
+    /* Successful set up */
+    return (SUCCESS);
+}
+
 
-    /* Loop through each pixel and assign the date information to all of the
-       pixels */
-    for (i = 0; i < *nlines * *nsamps; i++)
+/******************************************************************************
+MODULE:  write_date_bands
+
+PURPOSE: Writes out the pixels and the ENVI header of each of the three date
+bands set up by setup_date_bands.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the date bands
+SUCCESS         Successfully wrote the date bands
+
+NOTES:
+  1. Each band is written to its file_name and is no longer a constant band
+     once written, so its constant_value is reset to fill.
+******************************************************************************/
+int write_date_bands
+(
+    Espa_global_meta_t *gmeta,      /* I: global metadata */
+    Espa_band_meta_t *out_bmeta     /* I/O: band metadata of the three date
+                                            bands */
+)
+{
+    char FUNC_NAME[] = "write_date_bands";  /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    char tmpstr[STR_SIZE];      /* name of the ENVI header file */
+    int i;                      /* looping variable */
+    Envi_header_t envi_hdr;     /* output ENVI header information */
+    Espa_band_meta_t *dmeta = NULL;  /* metadata of the current date band */
+
+    for (i = 0; i < 3; i++)
     {
-        (*jdate_band)[i] = (unsigned int) (year * 1000 + doy);
-        (*doy_band)[i] = (unsigned short) doy;
-        (*year_band)[i] = (unsigned short) year;
+        dmeta = &out_bmeta[i];
+        if (expand_constant_band (dmeta, dmeta->file_name) != SUCCESS)
+        {
+            sprintf (errmsg, "Unable to write the date band file: %s",
+                dmeta->file_name);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+
+        /* Create the ENVI header for the band */
+        if (create_envi_struct (dmeta, gmeta, &envi_hdr) != SUCCESS)
+        {
+            sprintf (errmsg, "Error creating the ENVI header file.");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+
+        /* Write the ENVI header */
+        sprintf (tmpstr, "%s", dmeta->file_name);
+        sprintf (&tmpstr[strlen(tmpstr)-3], "hdr");
+        if (write_envi_hdr (tmpstr, &envi_hdr) != SUCCESS)
+        {
+            sprintf (errmsg, "Writing the ENVI header file: %s.", tmpstr);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+
+        /* The band is now stored in its raw binary file */
+        dmeta->constant_value = ESPA_FLOAT_META_FILL;
     }
 
-    /* Successful conversion */
+    /* Successful write */
     return (SUCCESS);
 }
-
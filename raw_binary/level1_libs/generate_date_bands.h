@@ -23,6 +23,7 @@ NOTES:
 #include "write_metadata.h"
 #include "raw_binary_io.h"
 #include "envi_header.h"
+#include "espa_band_stack.h"
 
 /* Defines */
 
@@ -30,12 +31,28 @@ NOTES:
 int generate_date_bands
 (
     Espa_internal_meta_t *xml_meta,  /* I: input XML metadata */
-    unsigned int **jdate_band,       /* O: pointer to date buffer with
+    unsigned int *jdate_value,       /* O: value of the date band,
                                            year*1000 + DOY */
-    unsigned short **doy_band,       /* O: pointer to DOY buffer */
-    unsigned short **year_band,      /* O: pointer to year buffer */
+    unsigned short *doy_value,       /* O: value of the DOY band */
+    unsigned short *year_value,      /* O: value of the year band */
     int *nlines,                     /* O: number of lines in date bands */
     int *nsamps                      /* O: number of samples in date bands */
 );
 
+int setup_date_bands
+(
+    Espa_internal_meta_t *xml_meta, /* I: input XML metadata */
+    const Espa_band_meta_t *bmeta,  /* I: band 1, the representative band */
+    const char *production_date,    /* I: production date of the bands */
+    Espa_band_meta_t *out_bmeta     /* O: band metadata of the three date
+                                          bands */
+);
+
+int write_date_bands
+(
+    Espa_global_meta_t *gmeta,      /* I: global metadata */
+    Espa_band_meta_t *out_bmeta     /* I/O: band metadata of the three date
+                                            bands */
+);
+
 #endif
@@ -0,0 +1,297 @@
+/*****************************************************************************
+FILE: generate_footprint_polygon.c
+
+PURPOSE: Contains functions to generate the footprint polygon of a scene from
+the per-line valid extents recorded in its footprint index.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The outline is traced from the first and last valid sample of each
+     line, so it costs O(lines) rather than a pass over the pixels.  It runs
+     down the left edge of the valid pixels and back up the right edge, so
+     lines without valid pixels are bridged and the polygon is the envelope
+     of each line's extent.
+  2. The outline is simplified in pixel units with ias_geo_simplify_polygon
+     (Douglas-Peucker), and only the vertices kept are transformed to
+     geographic with the batched projection transformation.
+  3. The polygon is written as WKT, POLYGON ((lon lat, ...)), in degrees.
+     The ring is closed and counterclockwise, as WKT and GeoJSON expect of
+     an outer ring.
+*****************************************************************************/
+#include "generate_footprint_polygon.h"
+
+
+/******************************************************************************
+MODULE:  add_vertex
+
+PURPOSE: Adds a pixel corner to the outline, unless it repeats the previous
+vertex.
+******************************************************************************/
+static void add_vertex
+(
+    IAS_POLYGON_LINKED_LIST *ring,  /* I/O: outline being traced */
+    double samp,                    /* I: sample of the pixel corner */
+    double line                     /* I: line of the pixel corner */
+)
+{
+    unsigned int n = ring->num_points;  /* number of vertices so far */
+
+    if (n > 0 && ring->point_x[n - 1] == samp && ring->point_y[n - 1] == line)
+        return;
+    ring->point_x[n] = samp;
+    ring->point_y[n] = line;
+    ring->num_points++;
+}
+
+
+/******************************************************************************
+MODULE:  trace_outline
+
+PURPOSE: Traces the outline of the valid pixels from the extent of each line,
+as the pixel corners (sample, line) of a closed ring.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error allocating the outline
+SUCCESS         Successfully traced the outline; it has no vertices if no
+                line has valid pixels
+******************************************************************************/
+static int trace_outline
+(
+    int nlines,                     /* I: number of lines in the band */
+    const int32_t *extent,          /* I: first and last valid sample of
+                                          each line */
+    IAS_POLYGON_LINKED_LIST *ring   /* O: outline of the valid pixels,
+                                          cleared on input */
+)
+{
+    char FUNC_NAME[] = "trace_outline";  /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    int line;                   /* looping variable for the lines */
+    int nvalid = 0;             /* number of lines with valid pixels */
+
+    for (line = 0; line < nlines; line++)
+    {
+        if (extent[2 * line] <= extent[2 * line + 1])
+            nvalid++;
+    }
+    if (nvalid == 0)
+        return (SUCCESS);
+
+    /* Each line adds at most two corners on each side, plus the closing
+       vertex */
+    ring->point_x = malloc ((4 * (size_t) nvalid + 1) * sizeof (double));
+    ring->point_y = malloc ((4 * (size_t) nvalid + 1) * sizeof (double));
+    if (ring->point_x == NULL || ring->point_y == NULL)
+    {
+        sprintf (errmsg, "Allocating memory for the footprint outline");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Down the left edge, then back up the right edge */
+    for (line = 0; line < nlines; line++)
+    {
+        if (extent[2 * line] > extent[2 * line + 1])
+            continue;
+        add_vertex (ring, extent[2 * line], line);
+        add_vertex (ring, extent[2 * line], line + 1);
+    }
+    for (line = nlines - 1; line >= 0; line--)
+    {
+        if (extent[2 * line] > extent[2 * line + 1])
+            continue;
+        add_vertex (ring, extent[2 * line + 1] + 1, line + 1);
+        add_vertex (ring, extent[2 * line + 1] + 1, line);
+    }
+    add_vertex (ring, ring->point_x[0], ring->point_y[0]);
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  free_outline
+
+PURPOSE: Frees the vertices of an outline and clears it.
+******************************************************************************/
+static void free_outline
+(
+    IAS_POLYGON_LINKED_LIST *ring   /* I/O: outline to be freed */
+)
+{
+    free (ring->point_x);
+    free (ring->point_y);
+    free (ring->poly_seg);
+    memset (ring, 0, sizeof (*ring));
+}
+
+
+/******************************************************************************
+MODULE:  generate_footprint_polygon
+
+PURPOSE: Generates the footprint polygon of the valid pixels of a band and
+sets it as the footprint of the global metadata.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error simplifying or transforming the outline
+SUCCESS         Successfully generated the footprint polygon
+
+NOTES:
+  1. The outline is simplified starting at FOOTPRINT_TOLERANCE pixels,
+     doubling the tolerance until no more than FOOTPRINT_MAX_VERTICES
+     vertices are left.
+  2. The footprint is left as ESPA_STRING_META_FILL if the band has no
+     valid pixels.
+******************************************************************************/
+int generate_footprint_polygon
+(
+    Espa_global_meta_t *gmeta,       /* I/O: global metadata; the footprint
+                                             is set */
+    const Espa_band_meta_t *bmeta,   /* I: band the extents are of */
+    const int32_t *extent            /* I: first and last valid sample of
+                                           each line of the band
+                                           (2 * nlines entries; see
+                                           espa_footprint.h) */
+)
+{
+    char FUNC_NAME[] = "generate_footprint_polygon";  /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    int status = SUCCESS;       /* return status */
+    unsigned int i;             /* looping variable */
+    int count;                  /* number of chars copied in snprintf */
+    size_t used;                /* number of chars in the footprint */
+    double tolerance;           /* simplification tolerance (pixels) */
+    double ul_x;                /* projection X of the UL pixel corner */
+    double ul_y;                /* projection Y of the UL pixel corner */
+    double *lon = NULL;         /* longitude of the vertices kept */
+    double *lat = NULL;         /* latitude of the vertices kept */
+    double parms[IAS_PROJ_PARAM_SIZE];  /* geographic projection parameters */
+    IAS_PROJECTION projection;  /* projection of the scene */
+    IAS_PROJECTION geographic;  /* geographic projection */
+    IAS_GEO_PROJ_TRANSFORMATION *trans = NULL; /* scene to geographic */
+    IAS_POLYGON_LINKED_LIST ring;       /* outline of the valid pixels */
+    IAS_POLYGON_LINKED_LIST simplified; /* simplified outline */
+
+    strcpy (gmeta->footprint, ESPA_STRING_META_FILL);
+
+    /* Trace and simplify the outline, in pixels */
+    memset (&ring, 0, sizeof (ring));
+    memset (&simplified, 0, sizeof (simplified));
+    if (trace_outline (bmeta->nlines, extent, &ring) != SUCCESS)
+    {
+        sprintf (errmsg, "Tracing the outline of the valid pixels");
+        error_handler (true, FUNC_NAME, errmsg);
+        free_outline (&ring);
+        return (ERROR);
+    }
+    if (ring.num_points == 0)
+        return (SUCCESS);
+
+    tolerance = FOOTPRINT_TOLERANCE;
+    while (1)
+    {
+        if (ias_geo_simplify_polygon (&ring, tolerance, &simplified)
+            != SUCCESS)
+        {
+            sprintf (errmsg, "Simplifying the outline of the valid pixels");
+            error_handler (true, FUNC_NAME, errmsg);
+            free_outline (&ring);
+            free_outline (&simplified);
+            return (ERROR);
+        }
+        if (simplified.num_points <= FOOTPRINT_MAX_VERTICES + 1)
+            break;
+        free_outline (&simplified);
+        tolerance *= 2.0;
+    }
+    free_outline (&ring);
+
+    /* Move the vertices from pixel corners to projection coordinates */
+    ul_x = gmeta->proj_info.ul_corner[0];
+    ul_y = gmeta->proj_info.ul_corner[1];
+    if (!strcmp (gmeta->proj_info.grid_origin, "CENTER"))
+    {
+        ul_x -= 0.5 * bmeta->pixel_size[0];
+        ul_y += 0.5 * bmeta->pixel_size[1];
+    }
+    for (i = 0; i < simplified.num_points; i++)
+    {
+        simplified.point_x[i] = ul_x + simplified.point_x[i] *
+            bmeta->pixel_size[0];
+        simplified.point_y[i] = ul_y - simplified.point_y[i] *
+            bmeta->pixel_size[1];
+    }
+
+    /* Set up the transformation from the scene to geographic */
+    if (get_scene_projection (&gmeta->proj_info, &projection) != SUCCESS)
+    {  /* Error messages already written */
+        free_outline (&simplified);
+        return (ERROR);
+    }
+    for (i = 0; i < IAS_PROJ_PARAM_SIZE; i++)
+        parms[i] = 0.0;
+    ias_geo_set_projection (GEO, NULLZONE, DEGREE, projection.spheroid,
+        parms, &geographic);
+    trans = ias_geo_get_cached_proj_transformation (&projection,
+        &geographic);
+    if (trans == NULL)
+    {
+        sprintf (errmsg, "Creating the transformation to geographic");
+        error_handler (true, FUNC_NAME, errmsg);
+        free_outline (&simplified);
+        return (ERROR);
+    }
+
+    /* Transform the vertices kept in one batch */
+    lon = malloc (simplified.num_points * sizeof (double));
+    lat = malloc (simplified.num_points * sizeof (double));
+    if (lon == NULL || lat == NULL)
+    {
+        sprintf (errmsg, "Allocating memory for the footprint vertices");
+        error_handler (true, FUNC_NAME, errmsg);
+        status = ERROR;
+    }
+    else if (ias_geo_transform_coordinates (trans, simplified.num_points,
+        simplified.point_x, simplified.point_y, lon, lat) != SUCCESS)
+    {
+        sprintf (errmsg, "Transforming the footprint vertices to lat/long");
+        error_handler (true, FUNC_NAME, errmsg);
+        status = ERROR;
+    }
+
+    /* Write the polygon as WKT */
+    used = sprintf (gmeta->footprint, "POLYGON ((");
+    for (i = 0; status == SUCCESS && i < simplified.num_points; i++)
+    {
+        count = snprintf (&gmeta->footprint[used],
+            sizeof (gmeta->footprint) - used, "%s%.6f %.6f%s",
+            i > 0 ? ", " : "", lon[i], lat[i],
+            i == simplified.num_points - 1 ? "))" : "");
+        if (count < 0 || count >= sizeof (gmeta->footprint) - used)
+        {
+            sprintf (errmsg, "Overflow of gmeta->footprint string");
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+        }
+        used += count;
+    }
+    if (status != SUCCESS)
+        strcpy (gmeta->footprint, ESPA_STRING_META_FILL);
+
+    free (lon);
+    free (lat);
+    free_outline (&simplified);
+    ias_geo_release_cached_proj_transformation (trans);
+
+    return (status);
+}
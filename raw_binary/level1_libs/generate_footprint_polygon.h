@@ -0,0 +1,48 @@
+/*****************************************************************************
+FILE: generate_footprint_polygon
+
+PURPOSE: Contains defines and prototypes to generate the footprint polygon of
+a scene, the outline of its valid (non-fill) pixels, from the first and last
+valid sample of each line.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+*****************************************************************************/
+
+#ifndef GENERATE_FOOTPRINT_POLYGON_H
+#define GENERATE_FOOTPRINT_POLYGON_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include "error_handler.h"
+#include "espa_metadata.h"
+#include "espa_footprint.h"
+#include "generate_land_water_mask.h"
+
+/* Defines */
+#define FOOTPRINT_TOLERANCE 0.5      /* starting simplification tolerance of
+                                        the outline, in pixels */
+#define FOOTPRINT_MAX_VERTICES 64    /* most vertices of the polygon, not
+                                        counting the closing vertex; the
+                                        tolerance is doubled until the
+                                        outline fits */
+
+/* Prototypes */
+int generate_footprint_polygon
+(
+    Espa_global_meta_t *gmeta,       /* I/O: global metadata; the footprint
+                                             is set */
+    const Espa_band_meta_t *bmeta,   /* I: band the extents are of */
+    const int32_t *extent            /* I: first and last valid sample of
+                                           each line of the band
+                                           (2 * nlines entries; see
+                                           espa_footprint.h) */
+);
+
+#endif
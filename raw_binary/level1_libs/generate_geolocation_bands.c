@@ -0,0 +1,730 @@
+/*****************************************************************************
+FILE: generate_geolocation_bands.c
+
+PURPOSE: Contains functions to generate the per-pixel latitude and longitude
+bands of a scene.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The latitude and longitude are for the center of each pixel, in degrees.
+  2. The pixels are transformed with the batched projection transformations,
+     and with an error bound they are interpolated inside a grid of exactly
+     transformed nodes wherever the grid is within that error.
+*****************************************************************************/
+#include <math.h>
+#include "generate_geolocation_bands.h"
+
+/* Interpolation states of the cells of the grid */
+#define CELL_INTERPOLATE 0      /* Interpolation is within the error bound */
+#define CELL_EXACT 1            /* Pixels need the exact transformation */
+
+/* Grid used to generate the latitude and longitude of the pixels */
+typedef struct
+{
+    IAS_GEO_PROJ_TRANSFORMATION *trans; /* scene to geographic (degrees) */
+    double ul_x;             /* projection X of the UL pixel center */
+    double ul_y;             /* projection Y of the UL pixel center */
+    double pixel_size[2];    /* pixel size in X and Y */
+    int nlines;              /* number of lines in the scene */
+    int nsamps;              /* number of samples in the scene */
+    double tolerance;        /* largest interpolation error (degrees); 0.0
+                                to transform every pixel exactly */
+    int ncell_rows;          /* number of rows of grid cells */
+    int ncell_cols;          /* number of columns of grid cells */
+    int cell_row;            /* row of grid cells with the nodes loaded; -1
+                                if none */
+    double *x;               /* projection X of the points to transform */
+    double *y;               /* projection Y of the points to transform */
+    double *pt_lon;          /* longitude of the transformed points */
+    double *pt_lat;          /* latitude of the transformed points */
+    int *pt_samp;            /* sample of each point transformed exactly */
+    double *node_lon[2];     /* longitude of the top and bottom nodes */
+    double *node_lat[2];     /* latitude of the top and bottom nodes */
+    bool node_ok[2];         /* were the top and bottom nodes transformed? */
+    unsigned char *cell_state;  /* CELL_* state of each cell of the row */
+} Geoloc_grid_t;
+
+
+/******************************************************************************
+MODULE:  transform_points
+
+PURPOSE: Transforms the points held in the grid X/Y arrays to lat/long.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           A point could not be transformed
+SUCCESS         Successfully transformed the points
+******************************************************************************/
+static int transform_points
+(
+    Geoloc_grid_t *grid,     /* I: grid with the points in x and y */
+    int npts,                /* I: number of points */
+    double *lon,             /* O: longitude of the points (degrees) */
+    double *lat              /* O: latitude of the points (degrees) */
+)
+{
+    return (ias_geo_transform_coordinates (grid->trans, npts, grid->x,
+        grid->y, lon, lat));
+}
+
+
+/******************************************************************************
+MODULE:  set_point
+
+PURPOSE: Sets the projection X/Y of a point, given its line and sample.
+******************************************************************************/
+static void set_point
+(
+    Geoloc_grid_t *grid,     /* I/O: grid to hold the point */
+    int index,               /* I: index of the point */
+    double line,             /* I: line of the point */
+    double samp              /* I: sample of the point */
+)
+{
+    grid->x[index] = grid->ul_x + samp * grid->pixel_size[0];
+    grid->y[index] = grid->ul_y - line * grid->pixel_size[1];
+}
+
+
+/******************************************************************************
+MODULE:  node_line / node_samp
+
+PURPOSE: Return the line or sample of a row or column of grid nodes.  The
+last nodes are on the last line and sample of the scene.
+******************************************************************************/
+static int node_line
+(
+    const Geoloc_grid_t *grid,  /* I: grid */
+    int row                     /* I: row of nodes */
+)
+{
+    if (row * GEOLOC_GRID_SIZE < grid->nlines - 1)
+        return (row * GEOLOC_GRID_SIZE);
+    return (grid->nlines - 1);
+}
+
+static int node_samp
+(
+    const Geoloc_grid_t *grid,  /* I: grid */
+    int col                     /* I: column of nodes */
+)
+{
+    if (col * GEOLOC_GRID_SIZE < grid->nsamps - 1)
+        return (col * GEOLOC_GRID_SIZE);
+    return (grid->nsamps - 1);
+}
+
+
+/******************************************************************************
+MODULE:  interpolate
+
+PURPOSE: Bilinearly interpolates a value of a grid cell from its corners.
+******************************************************************************/
+static double interpolate
+(
+    double ul,               /* I: value at the UL corner */
+    double ur,               /* I: value at the UR corner */
+    double ll,               /* I: value at the LL corner */
+    double lr,               /* I: value at the LR corner */
+    double line_fraction,    /* I: fraction of the cell down to the point */
+    double samp_fraction     /* I: fraction of the cell across to the point */
+)
+{
+    double top = ul + samp_fraction * (ur - ul);
+    double bottom = ll + samp_fraction * (lr - ll);
+
+    return (top + line_fraction * (bottom - top));
+}
+
+
+/******************************************************************************
+MODULE:  load_cell_row
+
+PURPOSE: Transforms the nodes of a row of grid cells and decides which cells
+can be interpolated.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. A cell is interpolated only if the cell center and edge midpoints are
+     each within the tolerance of the exact transformation.  Cells whose
+     nodes couldn't be transformed, or which span the antimeridian, are
+     transformed exactly.
+  2. The rows are expected in order, so the bottom nodes of the previous row
+     are reused as the top nodes.
+******************************************************************************/
+static void load_cell_row
+(
+    Geoloc_grid_t *grid,     /* I/O: grid */
+    int cell_row             /* I: row of grid cells to load */
+)
+{
+    /* Cell fractions of the checked points: center, then edge midpoints */
+    static const double check_points[5][2] = {{0.5, 0.5}, {0.0, 0.5},
+        {1.0, 0.5}, {0.5, 0.0}, {0.5, 1.0}};
+    int ncols = grid->ncell_cols + 1;  /* number of node columns */
+    int top;                 /* line of the top nodes */
+    int bottom;              /* line of the bottom nodes */
+    int left;                /* sample of the left nodes of a cell */
+    int right;               /* sample of the right nodes of a cell */
+    int row;                 /* looping variable for the node rows */
+    int col;                 /* looping variable for the cells */
+    int i;                   /* looping variable */
+    double *tmp;             /* for swapping the node rows */
+    double min_lon, max_lon; /* longitude range of the cell corners */
+
+    if (cell_row == grid->cell_row + 1)
+    {
+        /* Reuse the bottom nodes as the top nodes */
+        tmp = grid->node_lon[0];
+        grid->node_lon[0] = grid->node_lon[1];
+        grid->node_lon[1] = tmp;
+        tmp = grid->node_lat[0];
+        grid->node_lat[0] = grid->node_lat[1];
+        grid->node_lat[1] = tmp;
+        grid->node_ok[0] = grid->node_ok[1];
+        row = 1;
+    }
+    else
+        row = 0;
+
+    for ( ; row < 2; row++)
+    {
+        for (col = 0; col < ncols; col++)
+            set_point (grid, col, node_line (grid, cell_row + row),
+                node_samp (grid, col));
+        grid->node_ok[row] = transform_points (grid, ncols,
+            grid->node_lon[row], grid->node_lat[row]) == SUCCESS;
+    }
+    grid->cell_row = cell_row;
+
+    top = node_line (grid, cell_row);
+    bottom = node_line (grid, cell_row + 1);
+    for (col = 0; col < grid->ncell_cols; col++)
+    {
+        grid->cell_state[col] = CELL_EXACT;
+        if (!grid->node_ok[0] || !grid->node_ok[1])
+            continue;
+
+        min_lon = fmin (fmin (grid->node_lon[0][col],
+            grid->node_lon[0][col+1]), fmin (grid->node_lon[1][col],
+            grid->node_lon[1][col+1]));
+        max_lon = fmax (fmax (grid->node_lon[0][col],
+            grid->node_lon[0][col+1]), fmax (grid->node_lon[1][col],
+            grid->node_lon[1][col+1]));
+        if (max_lon - min_lon > 180.0)
+            continue;
+
+        /* Check the cell center and edge midpoints, all in one call */
+        left = node_samp (grid, col);
+        right = node_samp (grid, col + 1);
+        for (i = 0; i < 5; i++)
+            set_point (grid, i, top + check_points[i][0] * (bottom - top),
+                left + check_points[i][1] * (right - left));
+        if (transform_points (grid, 5, grid->pt_lon, grid->pt_lat) != SUCCESS)
+            continue;
+
+        for (i = 0; i < 5; i++)
+        {
+            if (fabs (grid->pt_lon[i] - interpolate (grid->node_lon[0][col],
+                    grid->node_lon[0][col+1], grid->node_lon[1][col],
+                    grid->node_lon[1][col+1], check_points[i][0],
+                    check_points[i][1])) > grid->tolerance ||
+                fabs (grid->pt_lat[i] - interpolate (grid->node_lat[0][col],
+                    grid->node_lat[0][col+1], grid->node_lat[1][col],
+                    grid->node_lat[1][col+1], check_points[i][0],
+                    check_points[i][1])) > grid->tolerance)
+                break;
+        }
+        if (i == 5)
+            grid->cell_state[col] = CELL_INTERPOLATE;
+    }
+}
+
+
+/******************************************************************************
+MODULE:  generate_line
+
+PURPOSE: Generates the latitude and longitude of one line of the scene.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           A pixel could not be transformed
+SUCCESS         Successfully generated the line
+******************************************************************************/
+static int generate_line
+(
+    Geoloc_grid_t *grid,     /* I/O: grid */
+    int line,                /* I: line to generate */
+    float *lat,              /* O: latitude of each sample (degrees) */
+    float *lon               /* O: longitude of each sample (degrees) */
+)
+{
+    int cell_row;            /* row of grid cells holding the line */
+    int col;                 /* column of the grid cell of a sample */
+    int top, bottom;         /* lines of the nodes of the cell row */
+    int left, right;         /* samples of the nodes of a cell */
+    int nexact = 0;          /* number of samples transformed exactly */
+    int samp;                /* looping variable for the samples */
+    int i;                   /* looping variable */
+    double line_fraction;    /* fraction of the cell down to the line */
+    double samp_fraction;    /* fraction of the cell across to a sample */
+
+    if (grid->tolerance > 0.0 && grid->ncell_rows > 0 &&
+        grid->ncell_cols > 0)
+    {
+        cell_row = line / GEOLOC_GRID_SIZE;
+        if (cell_row > grid->ncell_rows - 1)
+            cell_row = grid->ncell_rows - 1;
+        if (cell_row != grid->cell_row)
+            load_cell_row (grid, cell_row);
+        top = node_line (grid, cell_row);
+        bottom = node_line (grid, cell_row + 1);
+        line_fraction = (double) (line - top) / (bottom - top);
+
+        for (samp = 0; samp < grid->nsamps; samp++)
+        {
+            col = samp / GEOLOC_GRID_SIZE;
+            if (col > grid->ncell_cols - 1)
+                col = grid->ncell_cols - 1;
+            if (grid->cell_state[col] == CELL_EXACT)
+            {
+                grid->pt_samp[nexact] = samp;
+                set_point (grid, nexact, line, samp);
+                nexact++;
+                continue;
+            }
+
+            left = node_samp (grid, col);
+            right = node_samp (grid, col + 1);
+            samp_fraction = (double) (samp - left) / (right - left);
+            lon[samp] = interpolate (grid->node_lon[0][col],
+                grid->node_lon[0][col+1], grid->node_lon[1][col],
+                grid->node_lon[1][col+1], line_fraction, samp_fraction);
+            lat[samp] = interpolate (grid->node_lat[0][col],
+                grid->node_lat[0][col+1], grid->node_lat[1][col],
+                grid->node_lat[1][col+1], line_fraction, samp_fraction);
+        }
+    }
+    else
+    {
+        for (samp = 0; samp < grid->nsamps; samp++)
+        {
+            grid->pt_samp[nexact] = samp;
+            set_point (grid, nexact, line, samp);
+            nexact++;
+        }
+    }
+
+    /* Transform the rest of the samples exactly, all in one call */
+    if (nexact > 0)
+    {
+        if (transform_points (grid, nexact, grid->pt_lon, grid->pt_lat)
+            != SUCCESS)
+            return (ERROR);
+        for (i = 0; i < nexact; i++)
+        {
+            lon[grid->pt_samp[i]] = grid->pt_lon[i];
+            lat[grid->pt_samp[i]] = grid->pt_lat[i];
+        }
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  generate_geolocation_bands
+
+PURPOSE: Generates the latitude and longitude of the pixel centers for a block
+of lines of the scene.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error generating the latitude and longitude
+SUCCESS         Successfully generated the latitude and longitude
+
+NOTES:
+  1. The scene grid comes from the projection information in the global
+     metadata and the size of band 1.
+  2. With a positive max_error, pixels are bilinearly interpolated inside
+     cells of GEOLOC_GRID_SIZE pixels wherever the cell center and edge
+     midpoints are within max_error pixels of the exact transformation.  The
+     error in pixels is converted to degrees at the equator, so it is never
+     underestimated.
+  3. The transformation to geographic comes from the process-wide
+     transformation cache, so it is shared with the other users of the same
+     projection.
+******************************************************************************/
+int generate_geolocation_bands
+(
+    const Espa_global_meta_t *gmeta, /* I: global metadata */
+    const Espa_band_meta_t *bmeta,   /* I: band 1, the representative band */
+    double max_error,                /* I: largest interpolation error, in
+                                           pixels; 0.0 to transform every
+                                           pixel exactly */
+    int first_line,                  /* I: first line to generate */
+    int nlines,                      /* I: number of lines to generate */
+    float *lat,                      /* O: latitude of each pixel center
+                                           (degrees), nlines * nsamps */
+    float *lon                       /* O: longitude of each pixel center
+                                           (degrees), nlines * nsamps */
+)
+{
+    char FUNC_NAME[] = "generate_geolocation_bands";  /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    int status = SUCCESS;       /* return status */
+    int npts;                   /* size of the point arrays */
+    int line;                   /* looping variable for the lines */
+    int i;                      /* looping variable */
+    double parms[IAS_PROJ_PARAM_SIZE];  /* geographic projection parameters */
+    IAS_PROJECTION projection;  /* projection of the scene */
+    IAS_PROJECTION geographic;  /* geographic projection */
+    Geoloc_grid_t grid;         /* grid of the scene */
+    size_t offset;              /* offset of the line in the output */
+
+    if (first_line < 0 || nlines < 0 || first_line + nlines > bmeta->nlines)
+    {
+        sprintf (errmsg, "Lines %d to %d are outside the %d lines of the "
+            "scene", first_line, first_line + nlines - 1, bmeta->nlines);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Set up the transformation from the scene to geographic */
+    if (get_scene_projection (&gmeta->proj_info, &projection) != SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+    for (i = 0; i < IAS_PROJ_PARAM_SIZE; i++)
+        parms[i] = 0.0;
+    ias_geo_set_projection (GEO, NULLZONE, DEGREE, projection.spheroid,
+        parms, &geographic);
+
+    memset (&grid, 0, sizeof (grid));
+    grid.trans = ias_geo_get_cached_proj_transformation (&projection,
+        &geographic);
+    if (grid.trans == NULL)
+    {
+        sprintf (errmsg, "Creating the transformation to geographic");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Set up the grid, with the projection coordinates of the UL pixel
+       center */
+    grid.pixel_size[0] = bmeta->pixel_size[0];
+    grid.pixel_size[1] = bmeta->pixel_size[1];
+    grid.ul_x = gmeta->proj_info.ul_corner[0];
+    grid.ul_y = gmeta->proj_info.ul_corner[1];
+    if (strcmp (gmeta->proj_info.grid_origin, "CENTER"))
+    {
+        grid.ul_x += 0.5 * grid.pixel_size[0];
+        grid.ul_y -= 0.5 * grid.pixel_size[1];
+    }
+    grid.nlines = bmeta->nlines;
+    grid.nsamps = bmeta->nsamps;
+    grid.tolerance = max_error * fmin (grid.pixel_size[0],
+        grid.pixel_size[1]) / LW_MASK_METERS_PER_DEGREE;
+    grid.ncell_rows = (grid.nlines + GEOLOC_GRID_SIZE - 2) / GEOLOC_GRID_SIZE;
+    grid.ncell_cols = (grid.nsamps + GEOLOC_GRID_SIZE - 2) / GEOLOC_GRID_SIZE;
+    grid.cell_row = -1;
+
+    npts = grid.nsamps > 5 ? grid.nsamps : 5;
+    grid.x = malloc (npts * sizeof (double));
+    grid.y = malloc (npts * sizeof (double));
+    grid.pt_lon = malloc (npts * sizeof (double));
+    grid.pt_lat = malloc (npts * sizeof (double));
+    grid.pt_samp = malloc (npts * sizeof (int));
+    for (i = 0; i < 2; i++)
+    {
+        grid.node_lon[i] = malloc ((grid.ncell_cols + 1) * sizeof (double));
+        grid.node_lat[i] = malloc ((grid.ncell_cols + 1) * sizeof (double));
+    }
+    grid.cell_state = malloc (grid.ncell_cols + 1);
+    if (grid.x == NULL || grid.y == NULL || grid.pt_lon == NULL ||
+        grid.pt_lat == NULL || grid.pt_samp == NULL ||
+        grid.node_lon[0] == NULL || grid.node_lon[1] == NULL ||
+        grid.node_lat[0] == NULL || grid.node_lat[1] == NULL ||
+        grid.cell_state == NULL)
+    {
+        sprintf (errmsg, "Allocating memory for the geolocation grid");
+        error_handler (true, FUNC_NAME, errmsg);
+        status = ERROR;
+    }
+
+    for (line = first_line; status == SUCCESS &&
+        line < first_line + nlines; line++)
+    {
+        offset = (size_t) (line - first_line) * grid.nsamps;
+        if (generate_line (&grid, line, &lat[offset], &lon[offset])
+            != SUCCESS)
+        {
+            sprintf (errmsg, "Transforming line %d to lat/long", line);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+        }
+    }
+
+    free (grid.x);
+    free (grid.y);
+    free (grid.pt_lon);
+    free (grid.pt_lat);
+    free (grid.pt_samp);
+    for (i = 0; i < 2; i++)
+    {
+        free (grid.node_lon[i]);
+        free (grid.node_lat[i]);
+    }
+    free (grid.cell_state);
+    ias_geo_release_cached_proj_transformation (grid.trans);
+
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  setup_geolocation_bands
+
+PURPOSE: Sets up the band metadata of the latitude and longitude bands for
+the current scene.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error setting up the geolocation bands
+SUCCESS         Successfully set up the geolocation bands
+
+NOTES:
+  1. out_bmeta needs to hold two bands, initialized by
+     allocate_band_metadata or append_band_metadata.
+  2. No pixels are written.  The bands are written by
+     write_geolocation_bands.
+******************************************************************************/
+int setup_geolocation_bands
+(
+    Espa_internal_meta_t *xml_meta, /* I: input XML metadata */
+    const Espa_band_meta_t *bmeta,  /* I: band 1, the representative band */
+    const char *production_date,    /* I: production date of the bands */
+    Espa_band_meta_t *out_bmeta     /* O: band metadata of the latitude and
+                                          longitude bands */
+)
+{
+    char tmpstr[STR_SIZE];      /* first four characters of the short name */
+    char tmp_ext[STR_SIZE];     /* filename extension of the band */
+    int i;                      /* looping variable */
+    Espa_band_meta_t *gmeta = NULL;  /* metadata of the current band */
+
+    strncpy (tmpstr, bmeta->short_name, 4);
+    tmpstr[4] = '\0';
+
+    for (i = 0; i < 2; i++)
+    {
+        /* Set up the band metadata for the geolocation bands */
+        gmeta = &out_bmeta[i];
+        strcpy (gmeta->product, "intermediate_data");
+        strcpy (gmeta->source, "level1");
+        strcpy (gmeta->category, "image");
+        gmeta->data_type = ESPA_FLOAT32;
+        strcpy (gmeta->data_units, "degrees");
+
+        /* Band-specific names */
+        switch (i)
+        {
+            case (0):  /* latitude */
+                strcpy (gmeta->name, "latitude");
+                sprintf (gmeta->short_name, "%sLAT", tmpstr);
+                strcpy (gmeta->long_name, "latitude of the pixel center");
+                sprintf (tmp_ext, "lat.img");
+                gmeta->valid_range[0] = -90.0;
+                gmeta->valid_range[1] = 90.0;
+                break;
+
+            case (1):  /* longitude */
+                strcpy (gmeta->name, "longitude");
+                sprintf (gmeta->short_name, "%sLON", tmpstr);
+                strcpy (gmeta->long_name, "longitude of the pixel center");
+                sprintf (tmp_ext, "lon.img");
+                gmeta->valid_range[0] = -180.0;
+                gmeta->valid_range[1] = 180.0;
+                break;
+        }
+
+        /* Use the product name to create the band filename */
+        snprintf (gmeta->file_name, sizeof (gmeta->file_name), "%s_%s",
+            xml_meta->global.product_id, tmp_ext);
+
+        gmeta->resample_method = ESPA_BI;
+        gmeta->nlines = bmeta->nlines;
+        gmeta->nsamps = bmeta->nsamps;
+        gmeta->pixel_size[0] = bmeta->pixel_size[0];
+        gmeta->pixel_size[1] = bmeta->pixel_size[1];
+        strcpy (gmeta->pixel_units, bmeta->pixel_units);
+        sprintf (gmeta->app_version, "create_geolocation_bands_%s",
+            ESPA_COMMON_VERSION);
+        strcpy (gmeta->production_date, production_date);
+    }
+
+    /* Successful set up */
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  write_geolocation_bands
+
+PURPOSE: Generates the latitude and longitude bands set up by
+setup_geolocation_bands and writes out their pixels and ENVI headers.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the geolocation bands
+SUCCESS         Successfully wrote the geolocation bands
+
+NOTES:
+  1. The bands are generated GEOLOC_BLOCK_LINES lines at a time and written
+     through the coalescing raw binary writer, so the full bands are never
+     held in memory.
+******************************************************************************/
+int write_geolocation_bands
+(
+    Espa_global_meta_t *gmeta,      /* I: global metadata */
+    const Espa_band_meta_t *bmeta,  /* I: band 1, the representative band */
+    double max_error,               /* I: largest interpolation error, in
+                                          pixels; 0.0 for exact */
+    Espa_band_meta_t *out_bmeta     /* I: band metadata of the latitude and
+                                          longitude bands */
+)
+{
+    char FUNC_NAME[] = "write_geolocation_bands";  /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    char tmpstr[STR_SIZE];      /* name of the ENVI header file */
+    int status = SUCCESS;       /* return status */
+    int line;                   /* looping variable for the blocks */
+    int nlines;                 /* number of lines in the block */
+    int i;                      /* looping variable */
+    size_t band_bytes;          /* number of bytes in each band */
+    float *block[2] = {NULL, NULL};  /* latitude and longitude of a block */
+    Raw_binary_writer_t *writer[2] = {NULL, NULL};  /* band writers */
+    Envi_header_t envi_hdr;     /* output ENVI header information */
+
+    band_bytes = (size_t) bmeta->nlines * bmeta->nsamps * sizeof (float);
+    for (i = 0; i < 2; i++)
+    {
+        block[i] = malloc ((size_t) GEOLOC_BLOCK_LINES * bmeta->nsamps *
+            sizeof (float));
+        if (block[i] == NULL)
+        {
+            sprintf (errmsg, "Allocating memory for the geolocation bands");
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+            break;
+        }
+
+        writer[i] = open_raw_binary_writer (out_bmeta[i].file_name,
+            band_bytes, 0);
+        if (writer[i] == NULL)
+        {
+            sprintf (errmsg, "Opening the geolocation band file: %s",
+                out_bmeta[i].file_name);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+            break;
+        }
+        if (start_raw_binary_writer_stats (writer[i], &out_bmeta[i])
+            != SUCCESS)
+        {
+            sprintf (errmsg, "Starting the statistics of band %s",
+                out_bmeta[i].name);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+            break;
+        }
+    }
+
+    for (line = 0; status == SUCCESS && line < bmeta->nlines;
+        line += GEOLOC_BLOCK_LINES)
+    {
+        nlines = bmeta->nlines - line;
+        if (nlines > GEOLOC_BLOCK_LINES)
+            nlines = GEOLOC_BLOCK_LINES;
+        if (generate_geolocation_bands (gmeta, bmeta, max_error, line,
+            nlines, block[0], block[1]) != SUCCESS)
+        {  /* Error messages already written */
+            status = ERROR;
+            break;
+        }
+
+        for (i = 0; i < 2; i++)
+        {
+            if (append_raw_binary_writer (writer[i], nlines, bmeta->nsamps,
+                sizeof (float), block[i]) != SUCCESS)
+            {
+                sprintf (errmsg, "Writing the geolocation band file: %s",
+                    out_bmeta[i].file_name);
+                error_handler (true, FUNC_NAME, errmsg);
+                status = ERROR;
+                break;
+            }
+        }
+    }
+
+    for (i = 0; i < 2; i++)
+    {
+        if (writer[i] != NULL && status == SUCCESS)
+        {
+            get_raw_binary_writer_checksum (writer[i],
+                out_bmeta[i].checksum);
+            get_raw_binary_writer_stats (writer[i], &out_bmeta[i].stats);
+        }
+        if (writer[i] != NULL && close_raw_binary_writer (writer[i])
+            != SUCCESS && status == SUCCESS)
+        {
+            sprintf (errmsg, "Closing the geolocation band file: %s",
+                out_bmeta[i].file_name);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+        }
+        free (block[i]);
+    }
+    if (status != SUCCESS)
+        return (ERROR);
+
+    for (i = 0; i < 2; i++)
+    {
+        /* Create the ENVI header for the band */
+        if (create_envi_struct (&out_bmeta[i], gmeta, &envi_hdr) != SUCCESS)
+        {
+            sprintf (errmsg, "Error creating the ENVI header file.");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+
+        /* Write the ENVI header */
+        sprintf (tmpstr, "%s", out_bmeta[i].file_name);
+        sprintf (&tmpstr[strlen(tmpstr)-3], "hdr");
+        if (write_envi_hdr (tmpstr, &envi_hdr) != SUCCESS)
+        {
+            sprintf (errmsg, "Writing the ENVI header file: %s.", tmpstr);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+    }
+
+    /* Successful write */
+    return (SUCCESS);
+}
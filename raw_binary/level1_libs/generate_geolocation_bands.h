@@ -0,0 +1,73 @@
+/*****************************************************************************
+FILE: generate_geolocation_bands
+
+PURPOSE: Contains defines and prototypes to generate the per-pixel latitude
+and longitude bands.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+*****************************************************************************/
+
+#ifndef GENERATE_GEOLOCATION_BANDS_H
+#define GENERATE_GEOLOCATION_BANDS_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "error_handler.h"
+#include "espa_metadata.h"
+#include "parse_metadata.h"
+#include "write_metadata.h"
+#include "raw_binary_io.h"
+#include "raw_binary_writer.h"
+#include "envi_header.h"
+#include "generate_land_water_mask.h"
+
+/* Defines */
+#define GEOLOC_GRID_SIZE 16     /* lines and samples between the exactly
+                                   transformed nodes of the interpolation
+                                   grid */
+#define GEOLOC_BLOCK_LINES 128  /* lines generated and written at a time */
+#define GEOLOC_DEFAULT_MAX_ERROR 0.1  /* default largest interpolation error,
+                                         in pixels */
+
+/* Prototypes */
+int generate_geolocation_bands
+(
+    const Espa_global_meta_t *gmeta, /* I: global metadata */
+    const Espa_band_meta_t *bmeta,   /* I: band 1, the representative band */
+    double max_error,                /* I: largest interpolation error, in
+                                           pixels; 0.0 to transform every
+                                           pixel exactly */
+    int first_line,                  /* I: first line to generate */
+    int nlines,                      /* I: number of lines to generate */
+    float *lat,                      /* O: latitude of each pixel center
+                                           (degrees), nlines * nsamps */
+    float *lon                       /* O: longitude of each pixel center
+                                           (degrees), nlines * nsamps */
+);
+
+int setup_geolocation_bands
+(
+    Espa_internal_meta_t *xml_meta, /* I: input XML metadata */
+    const Espa_band_meta_t *bmeta,  /* I: band 1, the representative band */
+    const char *production_date,    /* I: production date of the bands */
+    Espa_band_meta_t *out_bmeta     /* O: band metadata of the latitude and
+                                          longitude bands */
+);
+
+int write_geolocation_bands
+(
+    Espa_global_meta_t *gmeta,      /* I: global metadata */
+    const Espa_band_meta_t *bmeta,  /* I: band 1, the representative band */
+    double max_error,               /* I: largest interpolation error, in
+                                          pixels; 0.0 for exact */
+    Espa_band_meta_t *out_bmeta     /* I: band metadata of the latitude and
+                                          longitude bands */
+);
+
+#endif
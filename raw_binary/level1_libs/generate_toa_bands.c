@@ -0,0 +1,1388 @@
+/*****************************************************************************
+FILE: generate_toa_bands.c
+
+PURPOSE: Contains functions for generating the top-of-atmosphere radiance,
+reflectance, and brightness temperature bands of a Level-1 scene (see
+generate_toa_bands.h).
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The Level-1 bands are read once, a block of lines at a time through
+     the band stack, and all of their TOA bands are computed from the block
+     and appended to their coalescing writers.  The TOA stage
+     (open_toa_stage, toa_stage_block, and close_toa_stage) computes the
+     blocks of a traversal driven by the caller, so other steps can share
+     the blocks.
+  2. The DNs of a block are converted to floats, and the gain and bias of
+     each TOA band (with the cosine of the solar zenith and the 16-bit scale
+     folded in) are applied by a SIMD kernel, as are the rounding and
+     saturation to 16-bit integers.  The kernels are chosen once when the
+     program is loaded (see espa_cpu_dispatch.h), and give the same pixels
+     as the scalar loops, which do the remainders.
+  3. The logarithm of the brightness temperature is taken by a scalar loop
+     over the radiance computed by the kernel.
+*****************************************************************************/
+#include <ctype.h>
+#include <limits.h>
+#include <math.h>
+#include "generate_toa_bands.h"
+#include "espa_cpu_dispatch.h"
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#define TOA_X86
+#endif
+
+/* Most TOA bands computed from one Level-1 band */
+#define TOA_MAX_OUTPUTS 3
+
+/* TOA band being computed from a Level-1 band */
+typedef struct
+{
+    int product;         /* TOA_* product of the band */
+    Espa_band_meta_t *bmeta;  /* metadata of the TOA band */
+    float gain;          /* gain applied to the DNs */
+    float bias;          /* bias applied to the DNs */
+    float k1;            /* K1 constant of the brightness temperature */
+    float k2;            /* K2 constant of the brightness temperature */
+    float bt_scale;      /* multiplier of the brightness temperature */
+    int band;            /* metadata index of the TOA band */
+    void *buf;           /* pixels of the TOA band for the current block */
+    Raw_binary_writer_t *writer;  /* writer of the TOA band */
+} Toa_output_t;
+
+/* Level-1 band with TOA bands */
+typedef struct
+{
+    int band;            /* metadata index of the Level-1 band */
+    float dn_fill;       /* fill value of the DNs; NAN if none */
+    int noutputs;        /* number of TOA bands */
+    Toa_output_t outputs[TOA_MAX_OUTPUTS];  /* TOA bands of the band */
+} Toa_source_t;
+
+/* Computing of the TOA bands from the blocks of a traversal of the Level-1
+   bands */
+struct Toa_stage
+{
+    Espa_internal_meta_t *xml_meta; /* XML metadata */
+    int nsources;        /* number of Level-1 bands with TOA bands */
+    Toa_source_t *sources;  /* Level-1 bands with TOA bands */
+    long nalloc;         /* number of pixels of the buffers */
+    float *dn;           /* DNs of the block as floats */
+    float *toa;          /* TOA pixels of the block, before packing */
+};
+
+/* Kernel computing gain * DN + bias for a line of DNs converted to floats,
+   or out_fill where the DN is dn_fill; returns the number of pixels done */
+typedef int (*Toa_linear_kernel_t)
+(
+    const float *dn,     /* I: DNs */
+    int n,               /* I: number of pixels */
+    float dn_fill,       /* I: fill value of the DNs; NAN if none */
+    float gain,          /* I: gain */
+    float bias,          /* I: bias */
+    float out_fill,      /* I: fill value of the output */
+    float *out           /* O: output pixels */
+);
+
+/* Kernel rounding floats to the nearest 16-bit integer (ties to even),
+   saturating; returns the number of pixels done */
+typedef int (*Toa_pack_kernel_t)
+(
+    const float *in,     /* I: input pixels */
+    int n,               /* I: number of pixels */
+    int16_t *out         /* O: 16-bit pixels */
+);
+
+
+#ifdef TOA_X86
+/******************************************************************************
+MODULE: toa_linear_sse2
+
+PURPOSE: Applies the gain and bias to 4 DNs at a time, blending in the fill
+value where the DN is fill.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+n            Number of pixels done
+
+NOTES:
+*****************************************************************************/
+static int toa_linear_sse2
+(
+    const float *dn,     /* I: DNs */
+    int n,               /* I: number of pixels */
+    float dn_fill,       /* I: fill value of the DNs; NAN if none */
+    float gain,          /* I: gain */
+    float bias,          /* I: bias */
+    float out_fill,      /* I: fill value of the output */
+    float *out           /* O: output pixels */
+)
+{
+    int i;               /* current pixel */
+    __m128 vdn_fill = _mm_set1_ps (dn_fill);   /* fill value of the DNs */
+    __m128 vgain = _mm_set1_ps (gain);         /* gain */
+    __m128 vbias = _mm_set1_ps (bias);         /* bias */
+    __m128 vout_fill = _mm_set1_ps (out_fill); /* fill value of the output */
+    __m128 v;            /* vector of DNs */
+    __m128 r;            /* vector of output pixels */
+    __m128 m;            /* mask of the fill DNs */
+
+    for (i = 0; i + 4 <= n; i += 4)
+    {
+        v = _mm_loadu_ps (dn + i);
+        r = _mm_add_ps (_mm_mul_ps (v, vgain), vbias);
+        m = _mm_cmpeq_ps (v, vdn_fill);
+        r = _mm_or_ps (_mm_and_ps (m, vout_fill), _mm_andnot_ps (m, r));
+        _mm_storeu_ps (out + i, r);
+    }
+
+    return i;
+}
+
+
+/******************************************************************************
+MODULE: toa_linear_avx2
+
+PURPOSE: Applies the gain and bias to 8 DNs at a time, blending in the fill
+value where the DN is fill.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+n            Number of pixels done
+
+NOTES:
+  1. Only put in the kernel table when the CPU supports AVX2.  The multiply
+     and add are kept apart (no FMA), as in the scalar loop.
+*****************************************************************************/
+__attribute__ ((target ("avx2")))
+static int toa_linear_avx2
+(
+    const float *dn,     /* I: DNs */
+    int n,               /* I: number of pixels */
+    float dn_fill,       /* I: fill value of the DNs; NAN if none */
+    float gain,          /* I: gain */
+    float bias,          /* I: bias */
+    float out_fill,      /* I: fill value of the output */
+    float *out           /* O: output pixels */
+)
+{
+    int i;               /* current pixel */
+    __m256 vdn_fill = _mm256_set1_ps (dn_fill);   /* fill value of the DNs */
+    __m256 vgain = _mm256_set1_ps (gain);         /* gain */
+    __m256 vbias = _mm256_set1_ps (bias);         /* bias */
+    __m256 vout_fill = _mm256_set1_ps (out_fill); /* output fill value */
+    __m256 v;            /* vector of DNs */
+    __m256 r;            /* vector of output pixels */
+    __m256 m;            /* mask of the fill DNs */
+
+    for (i = 0; i + 8 <= n; i += 8)
+    {
+        v = _mm256_loadu_ps (dn + i);
+        r = _mm256_add_ps (_mm256_mul_ps (v, vgain), vbias);
+        m = _mm256_cmp_ps (v, vdn_fill, _CMP_EQ_OQ);
+        _mm256_storeu_ps (out + i, _mm256_blendv_ps (r, vout_fill, m));
+    }
+
+    return i;
+}
+
+
+/******************************************************************************
+MODULE: toa_pack_sse2
+
+PURPOSE: Rounds 8 floats at a time to 16-bit integers, clamping them to the
+16-bit range first.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+n            Number of pixels done
+
+NOTES:
+  1. The conversion rounds ties to even, as nearbyintf does in the default
+     rounding mode.
+*****************************************************************************/
+static int toa_pack_sse2
+(
+    const float *in,     /* I: input pixels */
+    int n,               /* I: number of pixels */
+    int16_t *out         /* O: 16-bit pixels */
+)
+{
+    int i;               /* current pixel */
+    __m128 vmin = _mm_set1_ps (-32768.0f);  /* smallest 16-bit value */
+    __m128 vmax = _mm_set1_ps (32767.0f);   /* largest 16-bit value */
+    __m128i lo;          /* first 4 pixels as 32-bit integers */
+    __m128i hi;          /* next 4 pixels as 32-bit integers */
+
+    for (i = 0; i + 8 <= n; i += 8)
+    {
+        lo = _mm_cvtps_epi32 (_mm_min_ps (_mm_max_ps (_mm_loadu_ps (in + i),
+            vmin), vmax));
+        hi = _mm_cvtps_epi32 (_mm_min_ps (_mm_max_ps (_mm_loadu_ps
+            (in + i + 4), vmin), vmax));
+        _mm_storeu_si128 ((__m128i *) (out + i), _mm_packs_epi32 (lo, hi));
+    }
+
+    return i;
+}
+
+
+/******************************************************************************
+MODULE: toa_pack_avx2
+
+PURPOSE: Rounds 16 floats at a time to 16-bit integers, clamping them to the
+16-bit range first.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+n            Number of pixels done
+
+NOTES:
+  1. Only put in the kernel table when the CPU supports AVX2.
+  2. The pack interleaves the 128-bit lanes of its operands, so the 64-bit
+     quarters are put back in order.
+*****************************************************************************/
+__attribute__ ((target ("avx2")))
+static int toa_pack_avx2
+(
+    const float *in,     /* I: input pixels */
+    int n,               /* I: number of pixels */
+    int16_t *out         /* O: 16-bit pixels */
+)
+{
+    int i;               /* current pixel */
+    __m256 vmin = _mm256_set1_ps (-32768.0f);  /* smallest 16-bit value */
+    __m256 vmax = _mm256_set1_ps (32767.0f);   /* largest 16-bit value */
+    __m256i lo;          /* first 8 pixels as 32-bit integers */
+    __m256i hi;          /* next 8 pixels as 32-bit integers */
+
+    for (i = 0; i + 16 <= n; i += 16)
+    {
+        lo = _mm256_cvtps_epi32 (_mm256_min_ps (_mm256_max_ps
+            (_mm256_loadu_ps (in + i), vmin), vmax));
+        hi = _mm256_cvtps_epi32 (_mm256_min_ps (_mm256_max_ps
+            (_mm256_loadu_ps (in + i + 8), vmin), vmax));
+        _mm256_storeu_si256 ((__m256i *) (out + i), _mm256_permute4x64_epi64
+            (_mm256_packs_epi32 (lo, hi), 0xd8));
+    }
+
+    return i;
+}
+#endif
+
+
+/******************************************************************************
+MODULE: toa_linear_none, toa_pack_none
+
+PURPOSE: Kernels of CPUs without SIMD support, leaving all the pixels to the
+scalar loops.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+0            No pixels done
+
+NOTES:
+*****************************************************************************/
+static int toa_linear_none
+(
+    const float *dn,     /* I: DNs (unused) */
+    int n,               /* I: number of pixels (unused) */
+    float dn_fill,       /* I: fill value of the DNs (unused) */
+    float gain,          /* I: gain (unused) */
+    float bias,          /* I: bias (unused) */
+    float out_fill,      /* I: fill value of the output (unused) */
+    float *out           /* O: output pixels (unused) */
+)
+{
+    return 0;
+}
+
+static int toa_pack_none
+(
+    const float *in,     /* I: input pixels (unused) */
+    int n,               /* I: number of pixels (unused) */
+    int16_t *out         /* O: 16-bit pixels (unused) */
+)
+{
+    return 0;
+}
+
+
+/* Kernels, chosen by init_toa_kernels */
+static Toa_linear_kernel_t toa_linear_kernel = toa_linear_none;
+static Toa_pack_kernel_t toa_pack_kernel = toa_pack_none;
+
+
+/******************************************************************************
+MODULE: init_toa_kernels
+
+PURPOSE: Chooses the widest kernels supported by the CPU.
+
+RETURN VALUE: None
+
+NOTES:
+  1. Run when the program (or shared library) is loaded.
+*****************************************************************************/
+__attribute__ ((constructor))
+static void init_toa_kernels (void)
+{
+#if defined(TOA_X86)
+    if (espa_cpu_supports (ESPA_CPU_AVX2))
+    {
+        toa_linear_kernel = toa_linear_avx2;
+        toa_pack_kernel = toa_pack_avx2;
+    }
+    else if (espa_cpu_supports (ESPA_CPU_SSE2))
+    {
+        toa_linear_kernel = toa_linear_sse2;
+        toa_pack_kernel = toa_pack_sse2;
+    }
+#endif
+}
+
+
+/******************************************************************************
+MODULE: toa_linear
+
+PURPOSE: Computes gain * DN + bias for the DNs, or the fill value where the DN
+is fill.
+
+RETURN VALUE: None
+*****************************************************************************/
+static void toa_linear
+(
+    const float *dn,     /* I: DNs */
+    long n,              /* I: number of pixels */
+    float dn_fill,       /* I: fill value of the DNs; NAN if none */
+    float gain,          /* I: gain */
+    float bias,          /* I: bias */
+    float out_fill,      /* I: fill value of the output */
+    float *out           /* O: output pixels */
+)
+{
+    long i = 0;          /* current pixel */
+
+    if (n <= INT_MAX)
+        i = toa_linear_kernel (dn, n, dn_fill, gain, bias, out_fill, out);
+    for (; i < n; i++)
+        out[i] = (dn[i] == dn_fill) ? out_fill : dn[i] * gain + bias;
+}
+
+
+/******************************************************************************
+MODULE: toa_pack
+
+PURPOSE: Rounds floats to the nearest 16-bit integers (ties to even),
+saturating.
+
+RETURN VALUE: None
+
+NOTES:
+  1. A NaN becomes the smallest value, as in the kernels.
+*****************************************************************************/
+static void toa_pack
+(
+    const float *in,     /* I: input pixels */
+    long n,              /* I: number of pixels */
+    int16_t *out         /* O: 16-bit pixels */
+)
+{
+    long i = 0;          /* current pixel */
+    float v;             /* clamped pixel */
+
+    if (n <= INT_MAX)
+        i = toa_pack_kernel (in, n, out);
+    for (; i < n; i++)
+    {
+        v = in[i];
+        if (!(v >= -32768.0f))
+            v = -32768.0f;
+        else if (v > 32767.0f)
+            v = 32767.0f;
+        out[i] = (int16_t) nearbyintf (v);
+    }
+}
+
+
+/******************************************************************************
+MODULE: toa_available
+
+PURPOSE: Determines if a TOA product can be computed from a band.
+
+RETURN VALUE:
+Type = bool
+Value           Description
+-----           -----------
+true            The band is a Level-1 image band with the calibration of the
+                product
+false           The product can't be computed from the band
+******************************************************************************/
+static bool toa_available
+(
+    const Espa_global_meta_t *gmeta, /* I: global metadata */
+    const Espa_band_meta_t *bmeta,   /* I: metadata of the band */
+    int product          /* I: TOA_* product */
+)
+{
+    if (strcmp (bmeta->category, "image") ||
+        (bmeta->data_type != ESPA_UINT8 && bmeta->data_type != ESPA_UINT16 &&
+         bmeta->data_type != ESPA_INT16) ||
+        bmeta->rad_gain == ESPA_FLOAT_META_FILL ||
+        bmeta->rad_bias == ESPA_FLOAT_META_FILL)
+        return false;
+
+    switch (product)
+    {
+        case TOA_RADIANCE:
+            return true;
+
+        case TOA_REFLECTANCE:
+            return (bmeta->refl_gain != ESPA_FLOAT_META_FILL &&
+                bmeta->refl_bias != ESPA_FLOAT_META_FILL &&
+                gmeta->solar_zenith != ESPA_FLOAT_META_FILL &&
+                gmeta->solar_zenith >= 0.0 && gmeta->solar_zenith < 90.0);
+
+        case TOA_BRIGHTNESS_TEMP:
+            return (bmeta->k1_const != ESPA_FLOAT_META_FILL &&
+                bmeta->k2_const != ESPA_FLOAT_META_FILL &&
+                bmeta->k1_const > 0.0);
+    }
+
+    return false;
+}
+
+
+/******************************************************************************
+MODULE: toa_outputs
+
+PURPOSE: Lists the TOA bands computed from a Level-1 band, in the order they
+are appended to the metadata.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+n               Number of TOA bands of the band (0 to TOA_MAX_OUTPUTS)
+******************************************************************************/
+static int toa_outputs
+(
+    const Espa_global_meta_t *gmeta, /* I: global metadata */
+    const Espa_band_meta_t *bmeta,   /* I: metadata of the Level-1 band */
+    int products,        /* I: TOA_* products or'ed together */
+    int *out_products    /* O: TOA_* product of each TOA band */
+)
+{
+    const int order[TOA_MAX_OUTPUTS] = {TOA_RADIANCE, TOA_REFLECTANCE,
+        TOA_BRIGHTNESS_TEMP};  /* order of the products */
+    int i;               /* looping variable for the products */
+    int n = 0;           /* number of TOA bands */
+
+    for (i = 0; i < TOA_MAX_OUTPUTS; i++)
+    {
+        if ((products & order[i]) && toa_available (gmeta, bmeta, order[i]))
+            out_products[n++] = order[i];
+    }
+
+    return n;
+}
+
+
+/******************************************************************************
+MODULE:  parse_toa_products
+
+PURPOSE: Determines the TOA products from a comma-separated list of their
+names.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           A name isn't rad, refl, or bt
+SUCCESS         Successfully parsed the products
+******************************************************************************/
+int parse_toa_products
+(
+    const char *list,    /* I: comma-separated products (rad, refl, bt) */
+    int *products        /* O: TOA_* products or'ed together */
+)
+{
+    char FUNC_NAME[] = "parse_toa_products";  /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    const char *name = list;    /* current name */
+    size_t len;                 /* length of the current name */
+
+    *products = 0;
+    while (*name != '\0')
+    {
+        len = strcspn (name, ",");
+        if (len == 3 && !strncmp (name, "rad", len))
+            *products |= TOA_RADIANCE;
+        else if (len == 4 && !strncmp (name, "refl", len))
+            *products |= TOA_REFLECTANCE;
+        else if (len == 2 && !strncmp (name, "bt", len))
+            *products |= TOA_BRIGHTNESS_TEMP;
+        else
+        {
+            sprintf (errmsg, "Unknown TOA product in %s; expected a list of "
+                "rad, refl, and bt", list);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+
+        name += len;
+        if (*name == ',')
+            name++;
+    }
+
+    if (*products == 0)
+    {
+        sprintf (errmsg, "No TOA product was specified");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  count_toa_bands
+
+PURPOSE: Counts the TOA bands computed from the bands of the metadata.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+n               Number of TOA bands
+******************************************************************************/
+int count_toa_bands
+(
+    Espa_internal_meta_t *xml_meta, /* I: input XML metadata */
+    int products         /* I: TOA_* products or'ed together */
+)
+{
+    int i;               /* looping variable for the bands */
+    int count = 0;       /* number of TOA bands */
+    int out_products[TOA_MAX_OUTPUTS];  /* products of a band */
+
+    for (i = 0; i < xml_meta->nbands; i++)
+        count += toa_outputs (&xml_meta->global, &xml_meta->band[i],
+            products, out_products);
+
+    return count;
+}
+
+
+/******************************************************************************
+MODULE:  setup_toa_band
+
+PURPOSE: Sets up the band metadata of a TOA band from its Level-1 band.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           A name of the band doesn't fit
+SUCCESS         Successfully set up the band
+******************************************************************************/
+static int setup_toa_band
+(
+    Espa_internal_meta_t *xml_meta, /* I: XML metadata */
+    const Espa_band_meta_t *bmeta,  /* I: metadata of the Level-1 band */
+    int product,                    /* I: TOA_* product of the band */
+    enum Espa_data_type data_type,  /* I: ESPA_INT16 or ESPA_FLOAT32 */
+    const char *production_date,    /* I: production date of the band */
+    Espa_band_meta_t *tmeta         /* O: metadata of the TOA band */
+)
+{
+    char FUNC_NAME[] = "setup_toa_band";  /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    char tmpstr[STR_SIZE];      /* first four characters of the short name */
+    const char *band_num = bmeta->name;  /* band number of the name */
+    const char *prefix = NULL;  /* prefix of the band name */
+    int count;                  /* number of chars copied in snprintf */
+    bool scaled = (data_type == ESPA_INT16);  /* are the pixels scaled? */
+
+    /* The Level-1 bands are named b<number> */
+    if (band_num[0] == 'b' && isdigit ((unsigned char) band_num[1]))
+        band_num++;
+    strncpy (tmpstr, bmeta->short_name, 4);
+    tmpstr[4] = '\0';
+
+    switch (product)
+    {
+        case TOA_RADIANCE:
+            prefix = "rad";
+            strcpy (tmeta->product, "toa_rad");
+            sprintf (tmeta->short_name, "%sRAD", tmpstr);
+            sprintf (tmeta->long_name, "band %s top-of-atmosphere radiance",
+                band_num);
+            strcpy (tmeta->data_units, "radiance (watts/(m^2 sr um))");
+            if (scaled)
+                tmeta->scale_factor = TOA_RAD_SCALE;
+            break;
+
+        case TOA_REFLECTANCE:
+            prefix = "toa";
+            strcpy (tmeta->product, "toa_refl");
+            sprintf (tmeta->short_name, "%sTOA", tmpstr);
+            sprintf (tmeta->long_name, "band %s top-of-atmosphere "
+                "reflectance", band_num);
+            strcpy (tmeta->data_units, "reflectance");
+            tmeta->valid_range[0] = -0.2;
+            tmeta->valid_range[1] = 1.6;
+            if (scaled)
+            {
+                tmeta->scale_factor = TOA_REFL_SCALE;
+                tmeta->valid_range[0] /= TOA_REFL_SCALE;
+                tmeta->valid_range[1] /= TOA_REFL_SCALE;
+            }
+            break;
+
+        case TOA_BRIGHTNESS_TEMP:
+            prefix = "bt";
+            strcpy (tmeta->product, "toa_bt");
+            sprintf (tmeta->short_name, "%sBT", tmpstr);
+            sprintf (tmeta->long_name, "band %s top-of-atmosphere brightness "
+                "temperature", band_num);
+            strcpy (tmeta->data_units, "temperature (kelvin)");
+            tmeta->valid_range[0] = 150.0;
+            tmeta->valid_range[1] = 350.0;
+            if (scaled)
+            {
+                tmeta->scale_factor = TOA_BT_SCALE;
+                tmeta->valid_range[0] /= TOA_BT_SCALE;
+                tmeta->valid_range[1] /= TOA_BT_SCALE;
+            }
+            break;
+    }
+
+    count = snprintf (tmeta->name, sizeof (tmeta->name), "%s_band%s", prefix,
+        band_num);
+    if (count < 0 || count >= sizeof (tmeta->name))
+    {
+        sprintf (errmsg, "Overflow of the name of the TOA band of %s",
+            bmeta->name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Use the product name to create the TOA filename */
+    count = snprintf (tmeta->file_name, sizeof (tmeta->file_name),
+        "%s_%s.img", xml_meta->global.product_id, tmeta->name);
+    if (count < 0 || count >= sizeof (tmeta->file_name))
+    {
+        sprintf (errmsg, "Overflow of the filename of %s", tmeta->name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    strcpy (tmeta->source, "level1");
+    strcpy (tmeta->category, "image");
+    tmeta->data_type = data_type;
+    tmeta->fill_value = TOA_FILL_VALUE;
+    tmeta->resample_method = bmeta->resample_method;
+    tmeta->nlines = bmeta->nlines;
+    tmeta->nsamps = bmeta->nsamps;
+    tmeta->pixel_size[0] = bmeta->pixel_size[0];
+    tmeta->pixel_size[1] = bmeta->pixel_size[1];
+    strcpy (tmeta->pixel_units, bmeta->pixel_units);
+    sprintf (tmeta->app_version, "generate_toa_bands_%s",
+        ESPA_COMMON_VERSION);
+    strcpy (tmeta->production_date, production_date);
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  setup_toa_bands
+
+PURPOSE: Sets up the band metadata of the TOA bands of the Level-1 bands.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error setting up the TOA bands
+SUCCESS         Successfully set up the TOA bands
+
+NOTES:
+  1. The bands from first on need to hold count_toa_bands bands, initialized
+     by allocate_band_metadata or append_band_metadata.
+  2. The TOA bands of each Level-1 band are in the order radiance,
+     reflectance, brightness temperature.  No pixels are written.
+******************************************************************************/
+int setup_toa_bands
+(
+    Espa_internal_meta_t *xml_meta, /* I/O: XML metadata, whose bands from
+                                            first on are set up */
+    int products,        /* I: TOA_* products or'ed together */
+    enum Espa_data_type data_type,  /* I: ESPA_INT16 or ESPA_FLOAT32 */
+    const char *production_date,    /* I: production date of the bands */
+    int first            /* I: index of the first TOA band; the bands before
+                               it are the Level-1 bands */
+)
+{
+    char FUNC_NAME[] = "setup_toa_bands";  /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    int i;                      /* looping variable for the Level-1 bands */
+    int k;                      /* looping variable for the TOA bands */
+    int n;                      /* number of TOA bands of a Level-1 band */
+    int out_band = first;       /* index of the next TOA band */
+    int out_products[TOA_MAX_OUTPUTS];  /* products of a Level-1 band */
+
+    if (data_type != ESPA_INT16 && data_type != ESPA_FLOAT32)
+    {
+        sprintf (errmsg, "The TOA bands are either INT16 or FLOAT32");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    for (i = 0; i < first; i++)
+    {
+        n = toa_outputs (&xml_meta->global, &xml_meta->band[i], products,
+            out_products);
+        for (k = 0; k < n; k++, out_band++)
+        {
+            if (out_band >= xml_meta->nbands)
+            {
+                sprintf (errmsg, "Not enough bands were appended for the TOA "
+                    "bands");
+                error_handler (true, FUNC_NAME, errmsg);
+                return (ERROR);
+            }
+
+            if (setup_toa_band (xml_meta, &xml_meta->band[i], out_products[k],
+                data_type, production_date, &xml_meta->band[out_band])
+                != SUCCESS)
+            {  /* Error messages already written */
+                return (ERROR);
+            }
+        }
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  dn_to_float
+
+PURPOSE: Converts a block of DNs to floats.
+
+RETURN VALUE: None
+******************************************************************************/
+static void dn_to_float
+(
+    const void *buf,     /* I: DNs */
+    enum Espa_data_type data_type,  /* I: ESPA_UINT8, ESPA_UINT16, or
+                                          ESPA_INT16 */
+    long n,              /* I: number of pixels */
+    float *out           /* O: DNs as floats */
+)
+{
+    long i;              /* looping variable for the pixels */
+
+    if (data_type == ESPA_UINT8)
+    {
+        for (i = 0; i < n; i++)
+            out[i] = ((const uint8_t *) buf)[i];
+    }
+    else if (data_type == ESPA_UINT16)
+    {
+        for (i = 0; i < n; i++)
+            out[i] = ((const uint16_t *) buf)[i];
+    }
+    else
+    {
+        for (i = 0; i < n; i++)
+            out[i] = ((const int16_t *) buf)[i];
+    }
+}
+
+
+/******************************************************************************
+MODULE:  write_toa_header
+
+PURPOSE: Writes the ENVI header of a TOA band.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the header
+SUCCESS         Successfully wrote the header
+******************************************************************************/
+static int write_toa_header
+(
+    Espa_global_meta_t *gmeta,  /* I: global metadata */
+    Espa_band_meta_t *tmeta     /* I: metadata of the TOA band */
+)
+{
+    char FUNC_NAME[] = "write_toa_header";  /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    char envi_file[STR_SIZE];   /* name of the ENVI header file */
+    char *cptr = NULL;          /* pointer to the file extension */
+    Envi_header_t envi_hdr;     /* output ENVI header information */
+
+    if (create_envi_struct (tmeta, gmeta, &envi_hdr) != SUCCESS)
+    {
+        sprintf (errmsg, "Creating the ENVI header structure for this "
+            "file: %s", tmeta->file_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    strcpy (envi_file, tmeta->file_name);
+    cptr = strrchr (envi_file, '.');
+    strcpy (cptr, ".hdr");
+    if (write_envi_hdr (envi_file, &envi_hdr) != SUCCESS)
+    {
+        sprintf (errmsg, "Writing the ENVI header file: %s.", envi_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  free_toa_stage
+
+PURPOSE: Closes the writers of the TOA bands, and frees their buffers and the
+stage.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error closing a TOA band
+SUCCESS         Successfully closed the TOA bands
+******************************************************************************/
+static int free_toa_stage
+(
+    Toa_stage_t *stage   /* I: TOA stage to be freed */
+)
+{
+    char FUNC_NAME[] = "free_toa_stage";  /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    int i;                      /* looping variable for the Level-1 bands */
+    int k;                      /* looping variable for the TOA bands */
+    int status = SUCCESS;       /* return status */
+    Toa_output_t *out = NULL;   /* current TOA band */
+
+    for (i = 0; i < stage->nsources; i++)
+    {
+        for (k = 0; k < stage->sources[i].noutputs; k++)
+        {
+            out = &stage->sources[i].outputs[k];
+            if (out->writer != NULL &&
+                close_raw_binary_writer (out->writer) != SUCCESS)
+            {
+                sprintf (errmsg, "Closing the output band %s",
+                    out->bmeta->file_name);
+                error_handler (true, FUNC_NAME, errmsg);
+                status = ERROR;
+            }
+            free (out->buf);
+        }
+    }
+    free (stage->sources);
+    free (stage->dn);
+    free (stage->toa);
+    free (stage);
+
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  open_toa_stage
+
+PURPOSE: Starts writing the TOA bands set up by setup_toa_bands, for the
+blocks of the Level-1 bands handed to toa_stage_block by a traversal of the
+bands.
+
+RETURN VALUE:
+Type = Toa_stage_t *
+Value           Description
+-----           -----------
+NULL            Error starting the TOA bands
+non-NULL        TOA stage
+
+NOTES:
+  1. The gain and bias applied to the DNs hold the cosine of the solar
+     zenith and the 16-bit scale factor.
+  2. The Level-1 bands the TOA bands are computed from are listed by
+     get_toa_stage_sources.
+******************************************************************************/
+Toa_stage_t *open_toa_stage
+(
+    Espa_internal_meta_t *xml_meta, /* I/O: XML metadata; the checksum and
+                                            statistics of the TOA bands are
+                                            set by close_toa_stage */
+    int products,        /* I: TOA_* products or'ed together */
+    int first            /* I: index of the first TOA band */
+)
+{
+    char FUNC_NAME[] = "open_toa_stage";  /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    int i;                      /* looping variable for the Level-1 bands */
+    int k;                      /* looping variable for the TOA bands */
+    int n;                      /* number of TOA bands of a Level-1 band */
+    int size;                   /* number of bytes per TOA pixel */
+    int out_band = first;       /* index of the next TOA band */
+    int out_products[TOA_MAX_OUTPUTS];  /* products of a Level-1 band */
+    double scale;               /* multiplier of the TOA values */
+    double cos_sz;              /* cosine of the solar zenith */
+    Espa_band_meta_t *bmeta = NULL;  /* metadata of the Level-1 band */
+    Espa_band_meta_t *tmeta = NULL;  /* metadata of the current TOA band */
+    Toa_source_t *src = NULL;   /* current Level-1 band */
+    Toa_output_t *out = NULL;   /* current TOA band */
+    Toa_stage_t *stage = NULL;  /* TOA stage */
+
+    stage = calloc (1, sizeof (Toa_stage_t));
+    if (stage != NULL)
+        stage->sources = calloc (first > 0 ? first : 1,
+            sizeof (Toa_source_t));
+    if (stage == NULL || stage->sources == NULL)
+    {
+        sprintf (errmsg, "Allocating the TOA bands");
+        error_handler (true, FUNC_NAME, errmsg);
+        free (stage);
+        return (NULL);
+    }
+    stage->xml_meta = xml_meta;
+
+    cos_sz = cos (xml_meta->global.solar_zenith * M_PI / 180.0);
+    for (i = 0; i < first; i++)
+    {
+        bmeta = &xml_meta->band[i];
+        n = toa_outputs (&xml_meta->global, bmeta, products, out_products);
+        if (n == 0)
+            continue;
+
+        src = &stage->sources[stage->nsources++];
+        src->band = i;
+        src->dn_fill = NAN;
+        if (bmeta->fill_value != ESPA_INT_META_FILL)
+            src->dn_fill = (float) bmeta->fill_value;
+
+        for (k = 0; k < n; k++, out_band++)
+        {
+            out = &src->outputs[src->noutputs++];
+            out->product = out_products[k];
+            out->bmeta = &xml_meta->band[out_band];
+            out->band = out_band;
+            scale = 1.0;
+            if (out->bmeta->data_type == ESPA_INT16)
+                scale = 1.0 / out->bmeta->scale_factor;
+
+            out->bt_scale = 1.0f;
+            if (out_products[k] == TOA_RADIANCE)
+            {
+                out->gain = bmeta->rad_gain * scale;
+                out->bias = bmeta->rad_bias * scale;
+            }
+            else if (out_products[k] == TOA_REFLECTANCE)
+            {
+                out->gain = bmeta->refl_gain / cos_sz * scale;
+                out->bias = bmeta->refl_bias / cos_sz * scale;
+            }
+            else
+            {
+                out->gain = bmeta->rad_gain;
+                out->bias = bmeta->rad_bias;
+                out->k1 = bmeta->k1_const;
+                out->k2 = bmeta->k2_const;
+                out->bt_scale = scale;
+            }
+
+            tmeta = out->bmeta;
+            size = espa_data_type_size (tmeta->data_type);
+            out->writer = open_raw_binary_writer (tmeta->file_name,
+                (size_t) tmeta->nlines * tmeta->nsamps * size, 0);
+            if (out->writer == NULL ||
+                start_raw_binary_writer_stats (out->writer, tmeta)
+                != SUCCESS ||
+                start_raw_binary_writer_sparse (out->writer, tmeta,
+                RB_SPARSE_FROM_ENV) != SUCCESS)
+            {
+                sprintf (errmsg, "Opening the output band %s",
+                    tmeta->file_name);
+                error_handler (true, FUNC_NAME, errmsg);
+                free_toa_stage (stage);
+                return (NULL);
+            }
+        }
+
+        printf ("Generating the TOA bands of %s\n", bmeta->name);
+    }
+
+    return (stage);
+}
+
+
+/******************************************************************************
+MODULE:  get_toa_stage_sources
+
+PURPOSE: Lists the Level-1 bands the TOA bands are computed from, in the
+order their blocks are handed to toa_stage_block.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+n               Number of Level-1 bands
+******************************************************************************/
+int get_toa_stage_sources
+(
+    Toa_stage_t *stage,  /* I: TOA stage */
+    int *band_index      /* O: metadata index of each Level-1 band; room for
+                               the bands before the first TOA band */
+)
+{
+    int i;               /* looping variable for the Level-1 bands */
+
+    for (i = 0; i < stage->nsources; i++)
+        band_index[i] = stage->sources[i].band;
+
+    return stage->nsources;
+}
+
+
+/******************************************************************************
+MODULE:  toa_stage_block
+
+PURPOSE: Computes the TOA bands of a block of lines of the Level-1 bands and
+appends them to the TOA bands.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error computing or writing the block
+SUCCESS         Successfully wrote the block
+
+NOTES:
+  1. The block holds the Level-1 bands in the order of
+     get_toa_stage_sources.  It is a full width block, so the lines of each
+     band are contiguous.
+  2. The pixels of each TOA band for the block are kept until the next
+     block, for a caller which also consumes them (see get_toa_stage_buf).
+******************************************************************************/
+int toa_stage_block
+(
+    Toa_stage_t *stage,  /* I/O: TOA stage */
+    Espa_band_block_t *block  /* I: block of lines of the Level-1 bands */
+)
+{
+    char FUNC_NAME[] = "toa_stage_block";  /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    int s;                      /* looping variable for the Level-1 bands */
+    int k;                      /* looping variable for the TOA bands */
+    int size;                   /* number of bytes per TOA pixel */
+    long i;                     /* looping variable for the pixels */
+    long npix;                  /* number of pixels in the block */
+    float l;                    /* radiance of a pixel */
+    float *toa = NULL;          /* TOA pixels of the block */
+    Espa_band_meta_t *bmeta = NULL;  /* metadata of the Level-1 band */
+    Toa_source_t *src = NULL;   /* current Level-1 band */
+    Toa_output_t *out = NULL;   /* current TOA band */
+
+    if (block->samp0 != 0 || block->nsamps != block->line_stride)
+    {
+        sprintf (errmsg, "The TOA bands are computed from full width blocks");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Full width blocks are contiguous */
+    npix = (long) block->nlines * block->nsamps;
+    if (npix > stage->nalloc)
+    {
+        free (stage->dn);
+        free (stage->toa);
+        stage->dn = malloc (npix * sizeof (float));
+        stage->toa = malloc (npix * sizeof (float));
+        for (s = 0; s < stage->nsources; s++)
+        {
+            for (k = 0; k < stage->sources[s].noutputs; k++)
+            {
+                out = &stage->sources[s].outputs[k];
+                free (out->buf);
+                out->buf = malloc (npix *
+                    espa_data_type_size (out->bmeta->data_type));
+                if (out->buf == NULL)
+                    break;
+            }
+            if (k < stage->sources[s].noutputs)
+                break;
+        }
+        if (stage->dn == NULL || stage->toa == NULL || s < stage->nsources)
+        {
+            sprintf (errmsg, "Allocating the TOA buffers of %ld pixels",
+                npix);
+            error_handler (true, FUNC_NAME, errmsg);
+            stage->nalloc = 0;
+            return (ERROR);
+        }
+        stage->nalloc = npix;
+    }
+
+    for (s = 0; s < stage->nsources; s++)
+    {
+        src = &stage->sources[s];
+        bmeta = &stage->xml_meta->band[src->band];
+        dn_to_float (block->band_buf[s], bmeta->data_type, npix, stage->dn);
+
+        for (k = 0; k < src->noutputs; k++)
+        {
+            out = &src->outputs[k];
+
+            /* FLOAT32 bands are computed in place, and INT16 bands are
+               packed from the floats */
+            toa = stage->toa;
+            if (out->bmeta->data_type == ESPA_FLOAT32)
+                toa = out->buf;
+            toa_linear (stage->dn, npix, src->dn_fill, out->gain, out->bias,
+                TOA_FILL_VALUE, toa);
+
+            /* The brightness temperature comes from the radiance */
+            if (out->product == TOA_BRIGHTNESS_TEMP)
+            {
+                for (i = 0; i < npix; i++)
+                {
+                    l = toa[i];
+                    if (stage->dn[i] == src->dn_fill || l <= 0.0f)
+                        toa[i] = TOA_FILL_VALUE;
+                    else
+                        toa[i] = out->k2 / logf (out->k1 / l + 1.0f) *
+                            out->bt_scale;
+                }
+            }
+
+            size = sizeof (float);
+            if (out->bmeta->data_type == ESPA_INT16)
+            {
+                toa_pack (toa, npix, out->buf);
+                size = sizeof (int16_t);
+            }
+
+            if (append_raw_binary_writer (out->writer, block->nlines,
+                block->nsamps, size, out->buf) != SUCCESS)
+            {
+                sprintf (errmsg, "Writing lines %d-%d of %s", block->line0,
+                    block->line0 + block->nlines - 1, out->bmeta->file_name);
+                error_handler (true, FUNC_NAME, errmsg);
+                return (ERROR);
+            }
+        }
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  get_toa_stage_buf
+
+PURPOSE: Gets the pixels of a TOA band for the block last handed to
+toa_stage_block.
+
+RETURN VALUE:
+Type = void *
+Value           Description
+-----           -----------
+NULL            The band isn't one of the TOA bands, or no block was computed
+non-NULL        Pixels of the block, in the data type of the TOA band
+******************************************************************************/
+void *get_toa_stage_buf
+(
+    Toa_stage_t *stage,  /* I: TOA stage */
+    int band             /* I: metadata index of the TOA band */
+)
+{
+    int s;               /* looping variable for the Level-1 bands */
+    int k;               /* looping variable for the TOA bands */
+
+    for (s = 0; s < stage->nsources; s++)
+        for (k = 0; k < stage->sources[s].noutputs; k++)
+            if (stage->sources[s].outputs[k].band == band)
+                return stage->sources[s].outputs[k].buf;
+
+    return NULL;
+}
+
+
+/******************************************************************************
+MODULE:  close_toa_stage
+
+PURPOSE: Finishes the TOA bands once all the blocks have been computed,
+recording their checksums and statistics and writing their ENVI headers, and
+frees the stage.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error finishing the TOA bands
+SUCCESS         Successfully finished the TOA bands, or they were only closed
+
+NOTES:
+  1. With finish false, as when the traversal failed, the TOA bands are only
+     closed and the metadata is left alone.
+******************************************************************************/
+int close_toa_stage
+(
+    Toa_stage_t *stage,  /* I: TOA stage; freed on return */
+    bool finish          /* I: were all the blocks computed, so the metadata
+                               is to be recorded? */
+)
+{
+    int s;                      /* looping variable for the Level-1 bands */
+    int k;                      /* looping variable for the TOA bands */
+    int status = SUCCESS;       /* return status */
+    Espa_global_meta_t *gmeta = NULL;  /* global metadata */
+    Toa_output_t *out = NULL;   /* current TOA band */
+
+    if (stage == NULL)
+        return (SUCCESS);
+    gmeta = &stage->xml_meta->global;
+
+    /* Record the checksum and statistics of each TOA band, and write its
+       ENVI header */
+    for (s = 0; s < stage->nsources && finish; s++)
+    {
+        for (k = 0; k < stage->sources[s].noutputs; k++)
+        {
+            out = &stage->sources[s].outputs[k];
+            get_raw_binary_writer_checksum (out->writer,
+                out->bmeta->checksum);
+            get_raw_binary_writer_stats (out->writer, &out->bmeta->stats);
+            if (status == SUCCESS)
+                status = write_toa_header (gmeta, out->bmeta);
+        }
+    }
+
+    if (free_toa_stage (stage) != SUCCESS)
+        status = ERROR;
+
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  write_toa_bands
+
+PURPOSE: Writes out the pixels and the ENVI header of each of the TOA bands
+set up by setup_toa_bands.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the TOA bands
+SUCCESS         Successfully wrote the TOA bands
+
+NOTES:
+  1. The Level-1 bands are traversed once, as blocks of lines holding all
+     the bands with TOA bands, and each block is handed to toa_stage_block.
+     A caller with other steps to run on the same blocks (ex.
+     process_level1) drives the TOA stage itself.
+******************************************************************************/
+int write_toa_bands
+(
+    Espa_internal_meta_t *xml_meta, /* I/O: XML metadata; the checksum and
+                                            statistics of the TOA bands are
+                                            set */
+    int products,        /* I: TOA_* products or'ed together */
+    int first            /* I: index of the first TOA band */
+)
+{
+    char FUNC_NAME[] = "write_toa_bands";  /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    int nsources;               /* number of Level-1 bands */
+    int *band_index = NULL;     /* metadata index of each Level-1 band */
+    int status = SUCCESS;       /* return status */
+    Toa_stage_t *stage = NULL;  /* TOA stage */
+    Espa_band_stack_t *stack = NULL; /* stack of the Level-1 bands */
+    Espa_band_block_t *block = NULL; /* current block of the bands */
+
+    stage = open_toa_stage (xml_meta, products, first);
+    if (stage == NULL)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+
+    band_index = malloc ((first > 0 ? first : 1) * sizeof (int));
+    if (band_index == NULL)
+    {
+        sprintf (errmsg, "Allocating the Level-1 bands of the TOA bands");
+        error_handler (true, FUNC_NAME, errmsg);
+        close_toa_stage (stage, false);
+        return (ERROR);
+    }
+    nsources = get_toa_stage_sources (stage, band_index);
+    if (nsources == 0)
+    {
+        free (band_index);
+        return close_toa_stage (stage, true);
+    }
+
+    /* The Level-1 bands are read once for all their TOA bands */
+    stack = open_band_stack (xml_meta, nsources, band_index,
+        RB_PREFETCH_DEFAULT_LINES, 0);
+    free (band_index);
+    if (stack == NULL)
+    {
+        sprintf (errmsg, "Opening the Level-1 bands");
+        error_handler (true, FUNC_NAME, errmsg);
+        close_toa_stage (stage, false);
+        return (ERROR);
+    }
+    skip_band_stack_stats (stack);
+
+    while (1)
+    {
+        if (get_band_stack_block (stack, &block) != SUCCESS)
+        {
+            sprintf (errmsg, "Reading the Level-1 bands");
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+            break;
+        }
+        if (block == NULL)
+            break;
+
+        if (toa_stage_block (stage, block) != SUCCESS)
+        {  /* Error messages already written */
+            status = ERROR;
+            break;
+        }
+    }
+    close_band_stack (stack);
+
+    if (close_toa_stage (stage, status == SUCCESS) != SUCCESS)
+        status = ERROR;
+
+    return (status);
+}
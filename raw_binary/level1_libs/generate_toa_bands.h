@@ -0,0 +1,120 @@
+/*****************************************************************************
+FILE: generate_toa_bands.h
+
+PURPOSE: Contains defines and prototypes for generating the top-of-atmosphere
+radiance, reflectance, and brightness temperature bands of a Level-1 scene
+from the calibration in its metadata.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. Radiance is rad_gain * DN + rad_bias, for the image bands with a
+     radiance gain and bias.
+  2. Reflectance is (refl_gain * DN + refl_bias) / cos(solar_zenith), for the
+     image bands with a reflectance gain and bias.  The reflectance gains of
+     the MTL file already hold the earth-sun distance of the scene.
+  3. Brightness temperature is K2 / ln(K1 / L + 1) in kelvin, where L is the
+     radiance, for the image bands with K1 and K2 constants.
+  4. The bands are written as scaled 16-bit integers (TOA_*_SCALE) or as
+     32-bit floats, with TOA_FILL_VALUE where the DN is the fill value.
+*****************************************************************************/
+
+#ifndef GENERATE_TOA_BANDS_H
+#define GENERATE_TOA_BANDS_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include "error_handler.h"
+#include "espa_metadata.h"
+#include "raw_binary_writer.h"
+#include "envi_header.h"
+#include "espa_band_stack.h"
+
+/* Defines */
+#define TOA_RADIANCE 0x1      /* TOA radiance bands */
+#define TOA_REFLECTANCE 0x2   /* TOA reflectance bands */
+#define TOA_BRIGHTNESS_TEMP 0x4  /* brightness temperature bands */
+
+#define TOA_RAD_SCALE 0.1     /* scale factor of the 16-bit radiance */
+#define TOA_REFL_SCALE 0.0001 /* scale factor of the 16-bit reflectance */
+#define TOA_BT_SCALE 0.1      /* scale factor of the 16-bit temperature */
+#define TOA_FILL_VALUE -9999  /* fill value of the TOA bands */
+
+/* Computing of the TOA bands from the blocks of lines handed to it by a
+   traversal of the Level-1 bands (see open_toa_stage) */
+typedef struct Toa_stage Toa_stage_t;
+
+/* Prototypes */
+int parse_toa_products
+(
+    const char *list,    /* I: comma-separated products (rad, refl, bt) */
+    int *products        /* O: TOA_* products or'ed together */
+);
+
+int count_toa_bands
+(
+    Espa_internal_meta_t *xml_meta, /* I: input XML metadata */
+    int products         /* I: TOA_* products or'ed together */
+);
+
+int setup_toa_bands
+(
+    Espa_internal_meta_t *xml_meta, /* I/O: XML metadata, whose bands from
+                                            first on are set up */
+    int products,        /* I: TOA_* products or'ed together */
+    enum Espa_data_type data_type,  /* I: ESPA_INT16 or ESPA_FLOAT32 */
+    const char *production_date,    /* I: production date of the bands */
+    int first            /* I: index of the first TOA band; the bands before
+                               it are the Level-1 bands */
+);
+
+Toa_stage_t *open_toa_stage
+(
+    Espa_internal_meta_t *xml_meta, /* I/O: XML metadata; the checksum and
+                                            statistics of the TOA bands are
+                                            set by close_toa_stage */
+    int products,        /* I: TOA_* products or'ed together */
+    int first            /* I: index of the first TOA band */
+);
+
+int get_toa_stage_sources
+(
+    Toa_stage_t *stage,  /* I: TOA stage */
+    int *band_index      /* O: metadata index of each Level-1 band; room for
+                               the bands before the first TOA band */
+);
+
+int toa_stage_block
+(
+    Toa_stage_t *stage,  /* I/O: TOA stage */
+    Espa_band_block_t *block  /* I: block of lines of the Level-1 bands */
+);
+
+void *get_toa_stage_buf
+(
+    Toa_stage_t *stage,  /* I: TOA stage */
+    int band             /* I: metadata index of the TOA band */
+);
+
+int close_toa_stage
+(
+    Toa_stage_t *stage,  /* I: TOA stage; freed on return */
+    bool finish          /* I: were all the blocks computed, so the metadata
+                               is to be recorded? */
+);
+
+int write_toa_bands
+(
+    Espa_internal_meta_t *xml_meta, /* I/O: XML metadata; the checksum and
+                                            statistics of the TOA bands are
+                                            set */
+    int products,        /* I: TOA_* products or'ed together */
+    int first            /* I: index of the first TOA band */
+);
+
+#endif
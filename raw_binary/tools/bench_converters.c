@@ -0,0 +1,1343 @@
+/*****************************************************************************
+FILE: bench_converters
+
+PURPOSE: Times the format converters, the subset tools, and the land/water
+mask on synthetic ESPA products, along with the ingest converters on sample
+inputs, and writes the timings as machine-readable results which can be
+tracked across releases.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. Each synthetic product has a band of each of the ESPA data types, with
+     an XML file following the ESPA internal raw binary schema.
+  2. The tools are run as separate processes, the same as in production, so
+     their peak resident set size can be taken from the resource usage of
+     the process.  They are looked for in the directory the benchmark was
+     started in (where they are built), then on the PATH.
+  3. The results are written as one JSON object per line (JSON Lines), one
+     for each benchmark and product size.  A tool which fails is reported
+     with a status of failed, and its output is kept in the log file.
+  4. The files a run creates in the work directory are removed after the
+     run, and the XML file is rewritten before each run since some tools
+     (ex. create_land_water_mask) add their bands to it.
+  5. With --counters, the hardware counters (see espa_perf_counters.h) are
+     opened before any tool is run and inherited by the tool processes, so
+     the counts of each run are those of its tool.  The counts of the
+     fastest run are added to each result.  The counters of the stages
+     within a tool are in its timing trace, when ESPA_TRACE and
+     ESPA_PERF_COUNTERS are set.
+*****************************************************************************/
+#define _XOPEN_SOURCE 700       /* for nftw */
+#define _DEFAULT_SOURCE         /* for wait4 and scandir */
+#include <getopt.h>
+#include <time.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <ftw.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include "parse_metadata.h"
+#include "write_metadata.h"
+#include "espa_band_stack.h"
+#include "gctp_defines.h"
+#include "espa_perf_counters.h"
+
+/* Defines */
+#define BENCH_MAX_SIZES 16       /* maximum number of product sizes */
+#define BENCH_MAX_INGEST 16      /* maximum number of ingest commands */
+#define BENCH_MAX_ARGS 32        /* maximum number of arguments of a tool */
+#define BENCH_DEFAULT_SIZES "1000x1000,4000x4000"
+#define BENCH_DEFAULT_REPEAT 3
+#define BENCH_DEFAULT_OUTPUT "bench_converters.jsonl"
+#define BENCH_LOG_FILE "bench_converters.log"
+#define BENCH_PRODUCT_ID "BENCH_CONVERTERS"
+#define BENCH_PRODUCT "bench"    /* product of the bands, for the product
+                                    subset */
+#define BENCH_SUBSET_DIR "bench_subset"   /* output directory of the band
+                                             and product subsets */
+#define BENCH_INGEST_DIR "bench_ingest"   /* work directory of the ingest
+                                             converters */
+#define BENCH_PIXEL_SIZE 30.0    /* pixel size of the products (meters) */
+
+/* Part of the product processed by a benchmark, for the throughput */
+typedef enum {
+  BENCH_ALL_BANDS,      /* every band */
+  BENCH_TWO_BANDS,      /* the two bands of the band subset */
+  BENCH_WINDOW,         /* the center window, half of each dimension, of
+                           every band */
+  BENCH_MASK_BAND       /* the 8-bit band generated from the product */
+} Bench_work_t;
+
+/* Tool timed on the synthetic products */
+typedef struct
+{
+    const char *tool;            /* executable of the tool */
+    const char *args;            /* arguments after --xml; %d is replaced by
+                                    the first line, first sample, number of
+                                    lines, and number of samples of the
+                                    center window */
+    Bench_work_t work;           /* part of the product processed */
+    const char *env;             /* environment variable the tool needs;
+                                    NULL if none */
+} Bench_tool_t;
+
+static const Bench_tool_t bench_tools[] =
+{
+    {"convert_espa_to_gtif", "--gtif=bench_out", BENCH_ALL_BANDS, NULL},
+    {"convert_espa_to_hdf", "--hdf=bench_out.hdf", BENCH_ALL_BANDS, NULL},
+    {"convert_espa_to_netcdf", "--netcdf=bench_out.nc", BENCH_ALL_BANDS,
+     NULL},
+    {"convert_espa_to_bip", "--bip=bench_out.img", BENCH_ALL_BANDS, NULL},
+    {"espa_band_subset", "--subset_xml=bench_out.xml --band=uint16 "
+     "--band=float32 --output_dir=" BENCH_SUBSET_DIR " --link=copy",
+     BENCH_TWO_BANDS, NULL},
+    {"espa_product_subset", "--subset_xml=bench_out.xml --product="
+     BENCH_PRODUCT " --output_dir=" BENCH_SUBSET_DIR " --link=copy",
+     BENCH_ALL_BANDS, NULL},
+    {"espa_spatial_subset", "--subset_xml=bench_out.xml --line=%d "
+     "--sample=%d --nlines=%d --nsamps=%d", BENCH_WINDOW, NULL},
+    {"create_land_water_mask", "", BENCH_MASK_BAND, "ESPA_LAND_MASS_POLYGON"}
+};
+#define BENCH_NTOOLS (int) (sizeof (bench_tools) / sizeof (bench_tools[0]))
+
+/* Names of the bands, one per ESPA data type in the order of the enum */
+static const char *bench_band_names[] =
+    {"int8", "uint8", "int16", "uint16", "int32", "uint32", "float32",
+     "float64"};
+#define BENCH_NBANDS \
+    (int) (sizeof (bench_band_names) / sizeof (bench_band_names[0]))
+
+/* Timings of the runs of a benchmark */
+typedef struct
+{
+    const char *benchmark;       /* name of the benchmark */
+    const char *status;          /* ok, failed, or skipped */
+    int nlines;                  /* number of lines in the product; 0 if not
+                                    known */
+    int nsamps;                  /* number of samples in the product */
+    int nbands;                  /* number of bands processed */
+    int repeat;                  /* number of timed runs */
+    double *seconds;             /* seconds taken by each run */
+    Espa_perf_values_t *counts;  /* hardware counts of each run; NULL if not
+                                    counted */
+    double nbytes;               /* bytes of the bands processed */
+    double npixels;              /* pixels of the bands processed */
+    long peak_rss_kb;            /* largest peak RSS of the runs (KB) */
+} Bench_result_t;
+
+/******************************************************************************
+MODULE: usage
+
+PURPOSE: Prints the usage information for this application.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+void usage ()
+{
+    printf ("bench_converters times the ESPA to GeoTIFF, HDF, netCDF, and "
+            "BIP converters, the band, product, and spatial subsets, and "
+            "the land/water mask on synthetic products with a band of each "
+            "data type, for several product sizes, along with the ingest "
+            "converters on sample inputs.  The timings are written as one "
+            "JSON object per line.\n");
+    printf ("version: %s\n\n", ESPA_COMMON_VERSION);
+    printf ("usage: bench_converters [--sizes=nlines x nsamps,...] "
+            "[--repeat=number_of_runs] [--ingest=\"converter args\" ...] "
+            "[--dir=work_directory] [--output=results_filename] "
+            "[--counters]\n");
+
+    printf ("\nwhere the following parameters are optional:\n");
+    printf ("    -sizes: comma-separated list of product sizes, each as "
+            "LINESxSAMPS (default is %s)\n", BENCH_DEFAULT_SIZES);
+    printf ("    -repeat: number of timed runs of each benchmark; the "
+            "minimum and mean are reported (default is %d)\n",
+            BENCH_DEFAULT_REPEAT);
+    printf ("    -ingest: ingest converter and its arguments, separated by "
+            "spaces, to be timed on a sample input (ex. "
+            "\"convert_lpgs_to_espa --mtl=/data/LC08_MTL.txt\").  The "
+            "input file names should be absolute, since the converter is "
+            "run in a directory of its own.  It may be repeated (up to %d "
+            "times).\n", BENCH_MAX_INGEST);
+    printf ("    -dir: directory in which the synthetic products are created "
+            "(default is the current directory)\n");
+    printf ("    -output: name of the results file (default is %s)\n",
+            BENCH_DEFAULT_OUTPUT);
+    printf ("    -counters: if specified the hardware counters (cycles, "
+            "instructions, and last level cache misses) of the fastest run "
+            "are reported, with the instructions per cycle and the "
+            "bandwidth from memory\n");
+    printf ("\nThe land/water mask is only timed when "
+            "ESPA_LAND_MASS_POLYGON is set.\n");
+    printf ("\nExample: bench_converters --sizes=1000x1000,7000x8000 "
+            "--ingest=\"convert_modis_to_espa --hdf=/data/MOD09GA.hdf\" "
+            "--dir=/tmp\n");
+}
+
+
+/******************************************************************************
+MODULE:  parse_size_list
+
+PURPOSE:  Parses a comma-separated list of product sizes, each as a pair of
+positive integers separated by an 'x'.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           The list is empty, too long, or has an invalid entry
+SUCCESS         Successfully parsed the list
+
+NOTES:
+  1. The lines and samples of entry i are stored in sizes[2*i] and
+     sizes[2*i+1].
+******************************************************************************/
+static int parse_size_list
+(
+    const char *list,     /* I: comma-separated list */
+    int *sizes,           /* O: lines and samples of each entry
+                                (2 * BENCH_MAX_SIZES entries) */
+    int *nsizes           /* O: number of entries */
+)
+{
+    const char *cptr = list;  /* current position in the list */
+    char *end = NULL;         /* end of the current value */
+    int i;                    /* looping variable */
+    long value;               /* current value */
+
+    *nsizes = 0;
+    while (*cptr != '\0')
+    {
+        if (*nsizes == BENCH_MAX_SIZES)
+            return (ERROR);
+        for (i = 0; i < 2; i++)
+        {
+            value = strtol (cptr, &end, 10);
+            if (end == cptr || value < 1 || value > INT32_MAX / 2)
+                return (ERROR);
+            sizes[*nsizes * 2 + i] = value;
+            cptr = end;
+            if (i == 0)
+            {
+                if (*cptr != 'x')
+                    return (ERROR);
+                cptr++;
+            }
+        }
+        (*nsizes)++;
+
+        if (*cptr == ',')
+            cptr++;
+        else if (*cptr != '\0')
+            return (ERROR);
+    }
+
+    return (*nsizes > 0 ? SUCCESS : ERROR);
+}
+
+
+/******************************************************************************
+MODULE:  get_args
+
+PURPOSE:  Gets the command-line arguments and validates them.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error getting the command-line arguments or a command-line
+                argument and associated value were not valid
+SUCCESS         No errors encountered
+
+NOTES:
+  1. Memory is allocated for the directory, output file, and ingest
+     commands.  These should be character pointers set to NULL on input.
+     The caller is responsible for freeing the allocated memory upon
+     successful return.
+******************************************************************************/
+short get_args
+(
+    int argc,             /* I: number of cmd-line args */
+    char *argv[],         /* I: string of cmd-line args */
+    int *sizes,           /* O: lines and samples of each product size
+                                (2 * BENCH_MAX_SIZES entries) */
+    int *nsizes,          /* O: number of product sizes */
+    int *repeat,          /* O: number of timed runs of each benchmark */
+    char **ingest,        /* O: ingest commands (BENCH_MAX_INGEST
+                                entries) */
+    int *ningest,         /* O: number of ingest commands */
+    char **work_dir,      /* O: address of the work directory */
+    char **output_file,   /* O: address of the results filename */
+    bool *counters        /* O: are the hardware counters reported? */
+)
+{
+    int c;                           /* current argument index */
+    int option_index;                /* index for the command-line option */
+    char errmsg[STR_SIZE];           /* error message */
+    char FUNC_NAME[] = "get_args";   /* function name */
+    const char *size_list = BENCH_DEFAULT_SIZES;   /* list of sizes */
+    static int counters_flag = 0;    /* flag for the hardware counters */
+    static struct option long_options[] =
+    {
+        {"counters", no_argument, &counters_flag, 1},
+        {"sizes", required_argument, 0, 's'},
+        {"repeat", required_argument, 0, 'r'},
+        {"ingest", required_argument, 0, 'g'},
+        {"dir", required_argument, 0, 'd'},
+        {"output", required_argument, 0, 'o'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    *repeat = BENCH_DEFAULT_REPEAT;
+    *ningest = 0;
+
+    /* Loop through all the cmd-line options */
+    opterr = 0;   /* turn off getopt_long error msgs as we'll print our own */
+    while (1)
+    {
+        /* optstring in call to getopt_long is empty since we will only
+           support the long options */
+        c = getopt_long (argc, argv, "", long_options, &option_index);
+        if (c == -1)
+        {   /* Out of cmd-line options */
+            break;
+        }
+
+        switch (c)
+        {
+            case 0:
+                /* If this option set a flag, do nothing else now. */
+                if (long_options[option_index].flag != 0)
+                    break;
+
+            case 'h':  /* help */
+                usage ();
+                return (ERROR);
+                break;
+
+            case 's':  /* product sizes */
+                size_list = optarg;
+                break;
+
+            case 'r':  /* number of timed runs */
+                *repeat = atoi (optarg);
+                if (*repeat < 1)
+                {
+                    sprintf (errmsg, "Invalid number of runs: %s", optarg);
+                    error_handler (true, FUNC_NAME, errmsg);
+                    usage ();
+                    return (ERROR);
+                }
+                break;
+
+            case 'g':  /* ingest command */
+                if (*ningest == BENCH_MAX_INGEST)
+                {
+                    sprintf (errmsg, "Too many ingest commands; the "
+                        "maximum is %d", BENCH_MAX_INGEST);
+                    error_handler (true, FUNC_NAME, errmsg);
+                    return (ERROR);
+                }
+                ingest[(*ningest)++] = strdup (optarg);
+                break;
+
+            case 'd':  /* work directory */
+                free (*work_dir);
+                *work_dir = strdup (optarg);
+                break;
+
+            case 'o':  /* results file */
+                free (*output_file);
+                *output_file = strdup (optarg);
+                break;
+
+            case '?':
+            default:
+                sprintf (errmsg, "Unknown option %s", argv[optind-1]);
+                error_handler (true, FUNC_NAME, errmsg);
+                usage ();
+                return (ERROR);
+                break;
+        }
+    }
+
+    if (parse_size_list (size_list, sizes, nsizes) != SUCCESS)
+    {
+        sprintf (errmsg, "Invalid list of product sizes: %s", size_list);
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    if (*output_file == NULL)
+        *output_file = strdup (BENCH_DEFAULT_OUTPUT);
+
+    /* Check the hardware counters flag */
+    *counters = counters_flag != 0;
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  create_product_metadata
+
+PURPOSE:  Creates the metadata of a synthetic product.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error creating the metadata
+SUCCESS         Successfully created the metadata
+
+NOTES:
+  1. The product is in UTM, with a band of each ESPA data type named after
+     its data type.
+******************************************************************************/
+static int create_product_metadata
+(
+    int nlines,                   /* I: number of lines in the product */
+    int nsamps,                   /* I: number of samples in the product */
+    Espa_internal_meta_t *xml_metadata  /* O: metadata of the product */
+)
+{
+    char FUNC_NAME[] = "create_product_metadata";  /* function name */
+    char errmsg[STR_SIZE];        /* error message */
+    int i;                        /* looping variable */
+    Espa_global_meta_t *gmeta = &xml_metadata->global; /* global metadata */
+    Espa_band_meta_t *bmeta = NULL;  /* metadata of the current band */
+
+    init_metadata_struct (xml_metadata);
+    if (allocate_band_metadata (xml_metadata, BENCH_NBANDS) != SUCCESS)
+    {
+        sprintf (errmsg, "Allocating the band metadata");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    strcpy (gmeta->data_provider, "USGS/EROS");
+    strcpy (gmeta->satellite, "LANDSAT_8");
+    strcpy (gmeta->instrument, "OLI_TIRS");
+    strcpy (gmeta->acquisition_date, "2013-10-14");
+    strcpy (gmeta->scene_center_time, "18:48:12.5678090Z");
+    strcpy (gmeta->product_id, BENCH_PRODUCT_ID);
+    strcpy (gmeta->level1_production_date, "2020-09-14T00:00:00Z");
+    gmeta->wrs_system = 2;
+    gmeta->wrs_path = 47;
+    gmeta->wrs_row = 27;
+    gmeta->proj_info.proj_type = GCTP_UTM_PROJ;
+    gmeta->proj_info.datum_type = ESPA_WGS84;
+    gmeta->proj_info.utm_zone = 10;
+    strcpy (gmeta->proj_info.units, "meters");
+    strcpy (gmeta->proj_info.grid_origin, "CENTER");
+    gmeta->orientation_angle = 0.0;
+    gmeta->proj_info.ul_corner[0] = 500000.0;
+    gmeta->proj_info.ul_corner[1] = 5300000.0;
+    gmeta->proj_info.lr_corner[0] = 500000.0 + (nsamps - 1) *
+        BENCH_PIXEL_SIZE;
+    gmeta->proj_info.lr_corner[1] = 5300000.0 - (nlines - 1) *
+        BENCH_PIXEL_SIZE;
+    gmeta->ul_corner[0] = 47.8;
+    gmeta->ul_corner[1] = -123.0;
+    gmeta->lr_corner[0] = 47.8 - nlines * BENCH_PIXEL_SIZE / 111000.0;
+    gmeta->lr_corner[1] = -123.0 + nsamps * BENCH_PIXEL_SIZE / 75000.0;
+    gmeta->bounding_coords[ESPA_WEST] = gmeta->ul_corner[1];
+    gmeta->bounding_coords[ESPA_EAST] = gmeta->lr_corner[1];
+    gmeta->bounding_coords[ESPA_NORTH] = gmeta->ul_corner[0];
+    gmeta->bounding_coords[ESPA_SOUTH] = gmeta->lr_corner[0];
+
+    for (i = 0; i < BENCH_NBANDS; i++)
+    {
+        bmeta = &xml_metadata->band[i];
+        strcpy (bmeta->product, BENCH_PRODUCT);
+        strcpy (bmeta->source, "level1");
+        strcpy (bmeta->name, bench_band_names[i]);
+        strcpy (bmeta->category, "image");
+        bmeta->data_type = (enum Espa_data_type) i;
+        bmeta->nlines = nlines;
+        bmeta->nsamps = nsamps;
+        bmeta->fill_value = 0;
+        strcpy (bmeta->short_name, bmeta->name);
+        strcpy (bmeta->long_name, bmeta->name);
+        snprintf (bmeta->file_name, sizeof (bmeta->file_name), "%s_%s.img",
+            BENCH_PRODUCT_ID, bmeta->name);
+        bmeta->pixel_size[0] = bmeta->pixel_size[1] = BENCH_PIXEL_SIZE;
+        strcpy (bmeta->pixel_units, "meters");
+        strcpy (bmeta->data_units, "reflectance");
+        strcpy (bmeta->production_date, gmeta->level1_production_date);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  write_product_bands
+
+PURPOSE:  Writes the bands of a synthetic product.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the bands
+SUCCESS         Successfully wrote the bands
+
+NOTES:
+  1. The pixels are pseudo-random values in a reflectance-like range of each
+     data type, so the compressing converters have realistic data to work
+     on rather than runs of one value.
+******************************************************************************/
+static int write_product_bands
+(
+    Espa_internal_meta_t *xml_metadata  /* I: metadata of the product */
+)
+{
+    char FUNC_NAME[] = "write_product_bands";  /* function name */
+    char errmsg[STR_SIZE];        /* error message */
+    int i;                        /* looping variable for the bands */
+    int line, samp;               /* looping variables for the pixels */
+    int nlines = xml_metadata->band[0].nlines;  /* lines in the product */
+    int nsamps = xml_metadata->band[0].nsamps;  /* samples in the product */
+    int size;                     /* bytes per pixel of the current band */
+    uint32_t value;               /* pseudo-random pixel value */
+    double refl;                  /* reflectance of the pixel, 0-1 */
+    void *line_buf = NULL;        /* current line of the current band */
+    FILE *fptr = NULL;            /* pointer to the current band file */
+
+    line_buf = malloc ((size_t) nsamps * sizeof (double));
+    if (line_buf == NULL)
+    {
+        sprintf (errmsg, "Allocating memory for a line of the bands");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    for (i = 0; i < xml_metadata->nbands; i++)
+    {
+        size = espa_data_type_size (xml_metadata->band[i].data_type);
+        fptr = open_raw_binary (xml_metadata->band[i].file_name, "wb");
+        if (fptr == NULL)
+        {
+            sprintf (errmsg, "Opening the band file: %s",
+                xml_metadata->band[i].file_name);
+            error_handler (true, FUNC_NAME, errmsg);
+            free (line_buf);
+            return (ERROR);
+        }
+
+        value = 12345 + i;
+        for (line = 0; line < nlines; line++)
+        {
+            for (samp = 0; samp < nsamps; samp++)
+            {
+                value = value * 1103515245 + 12345;
+                refl = 0.05 + 0.4 * ((value >> 16) & 0x7fff) / 32768.0;
+                switch (xml_metadata->band[i].data_type)
+                {
+                    case ESPA_INT8:
+                        ((int8_t *) line_buf)[samp] = 1 + refl * 126;
+                        break;
+                    case ESPA_UINT8:
+                        ((uint8_t *) line_buf)[samp] = 1 + refl * 254;
+                        break;
+                    case ESPA_INT16:
+                        ((int16_t *) line_buf)[samp] = 1 + refl * 10000;
+                        break;
+                    case ESPA_UINT16:
+                        ((uint16_t *) line_buf)[samp] = 7273 + refl * 36364;
+                        break;
+                    case ESPA_INT32:
+                        ((int32_t *) line_buf)[samp] = 1 + refl * 1.0e6;
+                        break;
+                    case ESPA_UINT32:
+                        ((uint32_t *) line_buf)[samp] = 1 + refl * 1.0e6;
+                        break;
+                    case ESPA_FLOAT32:
+                        ((float *) line_buf)[samp] = refl;
+                        break;
+                    case ESPA_FLOAT64:
+                        ((double *) line_buf)[samp] = refl;
+                        break;
+                }
+            }
+
+            if (write_raw_binary (fptr, 1, nsamps, size, line_buf) != SUCCESS)
+            {
+                sprintf (errmsg, "Writing line %d of band %s", line,
+                    xml_metadata->band[i].name);
+                error_handler (true, FUNC_NAME, errmsg);
+                close_raw_binary (fptr);
+                free (line_buf);
+                return (ERROR);
+            }
+        }
+        close_raw_binary (fptr);
+    }
+
+    free (line_buf);
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  get_product_work
+
+PURPOSE:  Determines the bytes and pixels of the bands of a product, or of
+the part of them processed by a benchmark.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. Constant bands have no file, so they aren't counted.
+******************************************************************************/
+static void get_product_work
+(
+    Espa_internal_meta_t *xml_metadata, /* I: metadata of the product */
+    Bench_work_t work,            /* I: part of the product processed */
+    Bench_result_t *result        /* O: bytes, pixels, and bands processed */
+)
+{
+    int i;                        /* looping variable for the bands */
+    int size;                     /* bytes per pixel of the current band */
+    double npixels;               /* pixels of the current band */
+    Espa_band_meta_t *bmeta = NULL;  /* metadata of the current band */
+
+    result->nbytes = 0.0;
+    result->npixels = 0.0;
+    result->nbands = 0;
+    for (i = 0; i < xml_metadata->nbands; i++)
+    {
+        bmeta = &xml_metadata->band[i];
+        if (is_constant_band (bmeta))
+            continue;
+        if (work == BENCH_TWO_BANDS && strcmp (bmeta->name, "uint16") &&
+            strcmp (bmeta->name, "float32"))
+            continue;
+
+        size = espa_data_type_size (bmeta->data_type);
+        npixels = (double) bmeta->nlines * bmeta->nsamps;
+        if (work == BENCH_WINDOW)
+            npixels = (double) (bmeta->nlines / 2) * (bmeta->nsamps / 2);
+        else if (work == BENCH_MASK_BAND)
+            size = sizeof (uint8_t);
+
+        result->nbytes += npixels * (size > 0 ? size : 0);
+        result->npixels += npixels;
+        result->nbands++;
+        if (work == BENCH_MASK_BAND)
+            break;
+    }
+}
+
+
+/******************************************************************************
+MODULE:  is_real_entry
+
+PURPOSE:  Filters the . and .. entries out of a directory listing.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+0               The entry is . or ..
+1               The entry is a file or directory in the directory
+
+NOTES:
+******************************************************************************/
+static int is_real_entry
+(
+    const struct dirent *entry    /* I: directory entry */
+)
+{
+    return (strcmp (entry->d_name, ".") != 0 &&
+        strcmp (entry->d_name, "..") != 0);
+}
+
+
+/******************************************************************************
+MODULE:  list_directory
+
+PURPOSE:  Lists the names of the entries of a directory.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error reading the directory
+>= 0            Number of entries
+
+NOTES:
+  1. The caller frees each entry and the list.
+  2. The . and .. entries aren't listed, so they are never taken as new.
+******************************************************************************/
+static int list_directory
+(
+    const char *dir,              /* I: directory to be listed */
+    struct dirent ***entries      /* O: entries of the directory */
+)
+{
+    return (scandir (dir, entries, is_real_entry, alphasort));
+}
+
+
+/******************************************************************************
+MODULE:  remove_tree_entry
+
+PURPOSE:  Removes a file or an empty directory, for nftw.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+0               Continue the walk
+
+NOTES:
+******************************************************************************/
+static int remove_tree_entry
+(
+    const char *path,             /* I: file or directory */
+    const struct stat *statbuf,   /* I: status of the entry */
+    int typeflag,                 /* I: type of the entry */
+    struct FTW *ftwbuf            /* I: position in the walk */
+)
+{
+    remove (path);
+    return (0);
+}
+
+
+/******************************************************************************
+MODULE:  remove_new_files
+
+PURPOSE:  Removes the files and directories created in a directory since it
+was listed.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+static void remove_new_files
+(
+    const char *dir,              /* I: directory */
+    struct dirent **before,       /* I: entries listed before the run */
+    int nbefore                   /* I: number of entries before the run */
+)
+{
+    char path[STR_SIZE];          /* path of a new entry */
+    struct dirent **after = NULL; /* entries after the run */
+    int nafter;                   /* number of entries after the run */
+    int i, j;                     /* looping variables */
+
+    nafter = list_directory (dir, &after);
+    for (i = 0; i < nafter; i++)
+    {
+        for (j = 0; j < nbefore; j++)
+        {
+            if (!strcmp (after[i]->d_name, before[j]->d_name))
+                break;
+        }
+        if (j == nbefore && snprintf (path, sizeof (path), "%s/%s", dir,
+            after[i]->d_name) < (int) sizeof (path))
+            nftw (path, remove_tree_entry, 16, FTW_DEPTH | FTW_PHYS);
+        free (after[i]);
+    }
+    free (after);
+}
+
+
+/******************************************************************************
+MODULE:  run_tool
+
+PURPOSE:  Runs a tool as a separate process in the specified directory and
+waits for it to finish.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           The tool couldn't be run or failed
+SUCCESS         The tool completed successfully
+
+NOTES:
+  1. The output of the tool is appended to the log file.
+  2. The tool is run from the tool directory if it is there, otherwise from
+     the PATH.
+  3. The tool inherits the hardware counters, and its counts are added to
+     them once it exits, so the counts of the run are read around it.
+******************************************************************************/
+static int run_tool
+(
+    const char *tool_dir,         /* I: directory of the tools */
+    char **argv,                  /* I: tool and its arguments, NULL
+                                        terminated */
+    const char *run_dir,          /* I: directory to run the tool in */
+    int log_fd,                   /* I: log file for the output of the tool */
+    Espa_perf_counters_t *perf,   /* I: hardware counters, inherited by the
+                                        tool; NULL if not counted */
+    double *seconds,              /* O: wall-clock seconds of the run */
+    long *peak_rss_kb,            /* O: peak resident set size (KB) */
+    Espa_perf_values_t *counts    /* O: hardware counts of the run; unused
+                                        if not counted */
+)
+{
+    char path[STR_SIZE];          /* path of the tool */
+    int wstatus;                  /* exit status of the tool */
+    pid_t pid;                    /* process of the tool */
+    struct rusage usage;          /* resource usage of the tool */
+    struct timespec start, end;   /* start and end of the run */
+    Espa_perf_values_t perf_start;  /* counters at the start of the run */
+    Espa_perf_values_t perf_end;  /* counters at the end of the run */
+
+    snprintf (path, sizeof (path), "%s/%s", tool_dir, argv[0]);
+    if (perf != NULL)
+        espa_perf_read (perf, &perf_start);
+    clock_gettime (CLOCK_MONOTONIC, &start);
+    pid = fork ();
+    if (pid < 0)
+        return (ERROR);
+    if (pid == 0)
+    {
+        dup2 (log_fd, STDOUT_FILENO);
+        dup2 (log_fd, STDERR_FILENO);
+        if (chdir (run_dir) != 0)
+            _exit (127);
+        if (access (path, X_OK) == 0)
+            execv (path, argv);
+        else
+            execvp (argv[0], argv);
+        _exit (127);
+    }
+
+    if (wait4 (pid, &wstatus, 0, &usage) != pid)
+        return (ERROR);
+    clock_gettime (CLOCK_MONOTONIC, &end);
+    if (perf != NULL)
+    {
+        espa_perf_read (perf, &perf_end);
+        espa_perf_delta (&perf_start, &perf_end, counts);
+    }
+
+    *seconds = (end.tv_sec - start.tv_sec) +
+        (end.tv_nsec - start.tv_nsec) * 1.0e-9;
+    *peak_rss_kb = usage.ru_maxrss;
+
+    if (!WIFEXITED (wstatus) || WEXITSTATUS (wstatus) != EXIT_SUCCESS)
+        return (ERROR);
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  split_args
+
+PURPOSE:  Splits a command line into its arguments at the spaces.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           There are too many arguments
+>= 0            Number of arguments
+
+NOTES:
+  1. The command is modified in place, and argv points into it.  There is no
+     quoting, so the arguments can't hold spaces.
+******************************************************************************/
+static int split_args
+(
+    char *command,                /* I/O: command line */
+    char **argv,                  /* O: arguments, NULL terminated
+                                        (BENCH_MAX_ARGS + 1 entries) */
+    int argc                      /* I: number of arguments already in argv */
+)
+{
+    char *saveptr = NULL;         /* state of strtok_r */
+    char *token = NULL;           /* current argument */
+
+    for (token = strtok_r (command, " ", &saveptr); token != NULL;
+        token = strtok_r (NULL, " ", &saveptr))
+    {
+        if (argc == BENCH_MAX_ARGS)
+            return (ERROR);
+        argv[argc++] = token;
+    }
+    argv[argc] = NULL;
+
+    return (argc);
+}
+
+
+/******************************************************************************
+MODULE:  write_result
+
+PURPOSE:  Writes the timing of one benchmark as a line of JSON.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. The throughput is of the bands processed, based on the fastest run, as
+     are the hardware counts.
+******************************************************************************/
+static void write_result
+(
+    FILE *fptr,                   /* I: results file */
+    const Bench_result_t *result  /* I: timings of the benchmark */
+)
+{
+    int i;                        /* looping variable */
+    int fastest = 0;              /* index of the fastest run */
+    double min = 0.0;             /* fastest run */
+    double sum = 0.0;             /* total of the runs */
+    bool ok = !strcmp (result->status, "ok");  /* did every run succeed? */
+
+    if (ok)
+    {
+        min = result->seconds[0];
+        for (i = 0; i < result->repeat; i++)
+        {
+            if (result->seconds[i] < min)
+            {
+                min = result->seconds[i];
+                fastest = i;
+            }
+            sum += result->seconds[i];
+        }
+    }
+
+    fprintf (fptr, "{\"benchmark\": \"%s\", \"version\": \"%s\", "
+        "\"status\": \"%s\", \"nlines\": %d, \"nsamps\": %d, "
+        "\"nbands\": %d, \"repeat\": %d, \"min_seconds\": %.6f, "
+        "\"mean_seconds\": %.6f, \"mb_per_second\": %.3f, "
+        "\"mpixels_per_second\": %.3f, \"peak_rss_mb\": %.1f",
+        result->benchmark, ESPA_COMMON_VERSION, result->status,
+        result->nlines, result->nsamps, result->nbands,
+        ok ? result->repeat : 0, min, ok ? sum / result->repeat : 0.0,
+        min > 0.0 ? result->nbytes / min / (1024.0 * 1024.0) : 0.0,
+        min > 0.0 ? result->npixels / min * 1.0e-6 : 0.0,
+        result->peak_rss_kb / 1024.0);
+    if (ok && result->counts != NULL)
+        espa_perf_write_json (fptr, &result->counts[fastest], min);
+    fprintf (fptr, "}\n");
+    fflush (fptr);
+
+    printf ("  %-24s %-7s %9.3f s %10.1f MB/s %9.1f MB peak RSS\n",
+        result->benchmark, result->status, min,
+        min > 0.0 ? result->nbytes / min / (1024.0 * 1024.0) : 0.0,
+        result->peak_rss_kb / 1024.0);
+}
+
+
+/******************************************************************************
+MODULE:  time_tool
+
+PURPOSE:  Times the runs of a tool on the synthetic product.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error setting up a run
+SUCCESS         The tool was timed, or failed and was reported as such
+
+NOTES:
+  1. The XML file is rewritten before each run, and the files the run
+     created are removed after it.
+******************************************************************************/
+static int time_tool
+(
+    const Bench_tool_t *tool,     /* I: tool to be timed */
+    const char *tool_dir,         /* I: directory of the tools */
+    Espa_internal_meta_t *xml_metadata, /* I: metadata of the product */
+    const char *xml_file,         /* I: XML file of the product */
+    int log_fd,                   /* I: log file for the output of the tool */
+    Espa_perf_counters_t *perf,   /* I: hardware counters; NULL if not
+                                        counted */
+    Bench_result_t *result        /* I/O: timings of the tool */
+)
+{
+    char FUNC_NAME[] = "time_tool";  /* function name */
+    char errmsg[STR_SIZE];        /* error message */
+    char xml_arg[STR_SIZE];       /* --xml argument */
+    char args[STR_SIZE];          /* rest of the arguments */
+    char *argv[BENCH_MAX_ARGS + 1];  /* tool and its arguments */
+    int nlines = xml_metadata->band[0].nlines;  /* lines in the product */
+    int nsamps = xml_metadata->band[0].nsamps;  /* samples in the product */
+    int run;                      /* looping variable for the runs */
+    int nbefore;                  /* number of entries before the run */
+    long peak_rss_kb;             /* peak RSS of the run */
+    struct dirent **before = NULL;   /* entries before the run */
+
+    result->benchmark = tool->tool;
+    result->status = "ok";
+    result->nlines = nlines;
+    result->nsamps = nsamps;
+    result->peak_rss_kb = 0;
+    get_product_work (xml_metadata, tool->work, result);
+    if (tool->env != NULL && getenv (tool->env) == NULL)
+    {
+        result->status = "skipped";
+        return (SUCCESS);
+    }
+
+    snprintf (xml_arg, sizeof (xml_arg), "--xml=%s", xml_file);
+    snprintf (args, sizeof (args), tool->args, nlines / 4, nsamps / 4,
+        nlines / 2, nsamps / 2);
+    argv[0] = (char *) tool->tool;
+    argv[1] = xml_arg;
+    if (split_args (args, argv, 2) == ERROR)
+    {
+        sprintf (errmsg, "Too many arguments for %s", tool->tool);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    for (run = 0; run < result->repeat; run++)
+    {
+        if (write_metadata (xml_metadata, (char *) xml_file) != SUCCESS)
+        {
+            sprintf (errmsg, "Writing the XML file: %s", xml_file);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+
+        nbefore = list_directory (".", &before);
+        if (nbefore < 0)
+        {
+            sprintf (errmsg, "Listing the work directory");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+        if (tool->work != BENCH_WINDOW)
+            mkdir (BENCH_SUBSET_DIR, 0755);
+
+        if (run_tool (tool_dir, argv, ".", log_fd, perf,
+            &result->seconds[run], &peak_rss_kb, &result->counts[run])
+            != SUCCESS)
+            result->status = "failed";
+        if (peak_rss_kb > result->peak_rss_kb)
+            result->peak_rss_kb = peak_rss_kb;
+
+        remove_new_files (".", before, nbefore);
+        while (nbefore-- > 0)
+            free (before[nbefore]);
+        free (before);
+
+        if (strcmp (result->status, "ok"))
+            break;
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  time_ingest
+
+PURPOSE:  Times the runs of an ingest converter on its sample input.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error setting up a run
+SUCCESS         The converter was timed, or failed and was reported as such
+
+NOTES:
+  1. The converter is run in BENCH_INGEST_DIR, which is emptied after each
+     run.  The bytes and pixels processed are those of the bands in the XML
+     file it wrote.
+******************************************************************************/
+static int time_ingest
+(
+    const char *command,          /* I: converter and its arguments */
+    const char *tool_dir,         /* I: directory of the tools */
+    int log_fd,                   /* I: log file for the output of the tool */
+    Espa_perf_counters_t *perf,   /* I: hardware counters; NULL if not
+                                        counted */
+    Bench_result_t *result        /* I/O: timings of the converter */
+)
+{
+    char FUNC_NAME[] = "time_ingest";  /* function name */
+    char errmsg[STR_SIZE];        /* error message */
+    char args[STR_SIZE];          /* copy of the command for splitting */
+    char xml_file[STR_SIZE];      /* XML file written by the converter */
+    char *argv[BENCH_MAX_ARGS + 1];  /* converter and its arguments */
+    char *cptr = NULL;            /* pointer to the file extension */
+    int run;                      /* looping variable for the runs */
+    int i;                        /* looping variable for the entries */
+    int nentries;                 /* number of entries written by the run */
+    long peak_rss_kb;             /* peak RSS of the run */
+    struct dirent **entries = NULL;  /* entries written by the run */
+    Espa_internal_meta_t xml_metadata;  /* metadata of the ingested product */
+
+    snprintf (args, sizeof (args), "%s", command);
+    if (split_args (args, argv, 0) <= 0)
+    {
+        sprintf (errmsg, "Invalid ingest command: %s", command);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    result->benchmark = argv[0];
+    result->status = "ok";
+    result->nlines = result->nsamps = result->nbands = 0;
+    result->nbytes = result->npixels = 0.0;
+    result->peak_rss_kb = 0;
+
+    if (mkdir (BENCH_INGEST_DIR, 0755) != 0)
+    {
+        sprintf (errmsg, "Creating the ingest directory %s",
+            BENCH_INGEST_DIR);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    for (run = 0; run < result->repeat; run++)
+    {
+        if (run_tool (tool_dir, argv, BENCH_INGEST_DIR, log_fd, perf,
+            &result->seconds[run], &peak_rss_kb, &result->counts[run])
+            != SUCCESS)
+            result->status = "failed";
+        if (peak_rss_kb > result->peak_rss_kb)
+            result->peak_rss_kb = peak_rss_kb;
+
+        /* Take the work from the product written by the first run */
+        nentries = list_directory (BENCH_INGEST_DIR, &entries);
+        for (i = 0; i < nentries; i++)
+        {
+            cptr = strrchr (entries[i]->d_name, '.');
+            if (run == 0 && result->nbands == 0 && cptr != NULL &&
+                !strcmp (cptr, ".xml"))
+            {
+                snprintf (xml_file, sizeof (xml_file), "%s/%s",
+                    BENCH_INGEST_DIR, entries[i]->d_name);
+                init_metadata_struct (&xml_metadata);
+                if (parse_metadata (xml_file, &xml_metadata) == SUCCESS &&
+                    xml_metadata.nbands > 0)
+                {
+                    get_product_work (&xml_metadata, BENCH_ALL_BANDS,
+                        result);
+                    result->nlines = xml_metadata.band[0].nlines;
+                    result->nsamps = xml_metadata.band[0].nsamps;
+                }
+                free_metadata (&xml_metadata);
+            }
+            free (entries[i]);
+        }
+        free (entries);
+        remove_new_files (BENCH_INGEST_DIR, NULL, 0);
+
+        if (strcmp (result->status, "ok"))
+            break;
+    }
+
+    rmdir (BENCH_INGEST_DIR);
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  remove_product
+
+PURPOSE:  Removes the files of a synthetic product: its bands and XML file.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+static void remove_product
+(
+    Espa_internal_meta_t *xml_metadata, /* I: metadata of the product */
+    const char *xml_file          /* I: XML file of the product */
+)
+{
+    int i;                        /* looping variable */
+
+    for (i = 0; i < xml_metadata->nbands; i++)
+        unlink (xml_metadata->band[i].file_name);
+    unlink (xml_file);
+}
+
+
+/******************************************************************************
+MODULE:  main
+
+PURPOSE:  Creates a synthetic product at each size, times each tool on it,
+times the ingest converters on their sample inputs, and writes the timings
+to the results file.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error running the benchmarks
+SUCCESS         No errors encountered
+
+NOTES:
+******************************************************************************/
+int main (int argc, char** argv)
+{
+    char FUNC_NAME[] = "bench_converters";  /* function name */
+    char errmsg[STR_SIZE];             /* error message */
+    char *work_dir = NULL;             /* directory of the products */
+    char *output_file = NULL;          /* name of the results file */
+    char *ingest[BENCH_MAX_INGEST];    /* ingest commands */
+    char tool_dir[STR_SIZE];           /* directory of the tools */
+    char xml_file[STR_SIZE];           /* XML file of the product */
+    int sizes[2 * BENCH_MAX_SIZES];    /* lines and samples of each size */
+    int nsizes;                        /* number of product sizes */
+    int ningest;                       /* number of ingest commands */
+    int repeat;                        /* number of timed runs */
+    int isize, itool;                  /* looping variables */
+    int log_fd;                        /* log file of the tools */
+    bool counters;                     /* are the hardware counters
+                                          reported? */
+    Espa_perf_counters_t counters_fd;  /* hardware counters, inherited by
+                                          the tools */
+    Espa_perf_counters_t *perf = NULL; /* hardware counters; NULL if not
+                                          counted */
+    FILE *fptr = NULL;                 /* pointer to the results file */
+    Bench_result_t result;             /* timings of the current benchmark */
+    Espa_internal_meta_t xml_metadata; /* metadata of the current product */
+
+    printf ("bench_converters version: %s\n", ESPA_COMMON_VERSION);
+
+    /* Read the command-line arguments */
+    if (get_args (argc, argv, sizes, &nsizes, &repeat, ingest, &ningest,
+        &work_dir, &output_file, &counters) != SUCCESS)
+    {   /* get_args already printed the error message */
+        exit (EXIT_FAILURE);
+    }
+
+    /* The tools are looked for where the benchmark was started */
+    if (getcwd (tool_dir, sizeof (tool_dir)) == NULL)
+    {
+        sprintf (errmsg, "Getting the current directory");
+        error_handler (true, FUNC_NAME, errmsg);
+        exit (EXIT_FAILURE);
+    }
+
+    /* Open the results file before moving to the work directory, so a
+       relative name is relative to where the benchmark was started */
+    fptr = fopen (output_file, "w");
+    if (fptr == NULL)
+    {
+        sprintf (errmsg, "Opening the results file: %s", output_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        exit (EXIT_FAILURE);
+    }
+
+    /* The band file names are relative to the work directory, as they are to
+       the product directory for the tools */
+    if (work_dir != NULL && chdir (work_dir) != 0)
+    {
+        sprintf (errmsg, "Changing to the work directory: %s", work_dir);
+        error_handler (true, FUNC_NAME, errmsg);
+        exit (EXIT_FAILURE);
+    }
+
+    log_fd = open (BENCH_LOG_FILE, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    result.repeat = repeat;
+    result.seconds = calloc (repeat, sizeof (double));
+    result.counts = calloc (repeat, sizeof (Espa_perf_values_t));
+    if (log_fd < 0 || result.seconds == NULL || result.counts == NULL)
+    {
+        sprintf (errmsg, "Opening the log file and allocating memory for "
+            "the timings");
+        error_handler (true, FUNC_NAME, errmsg);
+        exit (EXIT_FAILURE);
+    }
+
+    /* Open the counters before any tool is run, so the tools inherit
+       them */
+    if (counters)
+    {
+        if (espa_perf_open (&counters_fd, true) == SUCCESS)
+            perf = &counters_fd;
+        else
+            error_handler (false, FUNC_NAME, "The hardware counters are not "
+                "available; only the timings will be reported");
+    }
+    if (perf == NULL)
+    {
+        free (result.counts);
+        result.counts = NULL;
+    }
+
+    snprintf (xml_file, sizeof (xml_file), "%s.xml", BENCH_PRODUCT_ID);
+    for (isize = 0; isize < nsizes; isize++)
+    {
+        printf ("Product of %d lines x %d samples\n", sizes[2 * isize],
+            sizes[2 * isize + 1]);
+        if (create_product_metadata (sizes[2 * isize], sizes[2 * isize + 1],
+            &xml_metadata) != SUCCESS ||
+            write_product_bands (&xml_metadata) != SUCCESS)
+        {  /* Error messages already written */
+            exit (EXIT_FAILURE);
+        }
+
+        for (itool = 0; itool < BENCH_NTOOLS; itool++)
+        {
+            if (time_tool (&bench_tools[itool], tool_dir, &xml_metadata,
+                xml_file, log_fd, perf, &result) != SUCCESS)
+            {  /* Error messages already written */
+                exit (EXIT_FAILURE);
+            }
+            write_result (fptr, &result);
+        }
+
+        remove_product (&xml_metadata, xml_file);
+        free_metadata (&xml_metadata);
+    }
+
+    if (ningest > 0)
+        printf ("Ingest converters\n");
+    for (itool = 0; itool < ningest; itool++)
+    {
+        if (time_ingest (ingest[itool], tool_dir, log_fd, perf, &result)
+            != SUCCESS)
+        {  /* Error messages already written */
+            exit (EXIT_FAILURE);
+        }
+        write_result (fptr, &result);
+    }
+
+    /* Close the results and log files */
+    close (log_fd);
+    if (fclose (fptr) != 0)
+    {
+        sprintf (errmsg, "Closing the results file: %s", output_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        exit (EXIT_FAILURE);
+    }
+    printf ("INFO: results were written to %s, and the output of the tools "
+        "to %s\n", output_file, BENCH_LOG_FILE);
+
+    /* Free the pointers */
+    for (itool = 0; itool < ningest; itool++)
+        free (ingest[itool]);
+    if (perf != NULL)
+        espa_perf_close (perf);
+    free (result.counts);
+    free (result.seconds);
+    free (work_dir);
+    free (output_file);
+
+    /* Successful completion */
+    exit (EXIT_SUCCESS);
+}
@@ -0,0 +1,935 @@
+/*****************************************************************************
+FILE: bench_level1
+
+PURPOSE: Times the Level-1 processing of the level1_libs library on synthetic
+TM, ETM+, and OLI/TIRS scenes, and writes the timings as machine-readable
+results which can be tracked across releases.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. Each synthetic scene has the bands and band quality band of its
+     instrument, with an XML file following the ESPA internal raw binary
+     schema.  The image data of each band is a WRS-2 style footprint: a
+     rectangle rotated by BENCH_SCENE_ANGLE degrees inside the fill border,
+     with each band offset by a few pixels so there is band misalignment to
+     be clipped.
+  2. The results are written as one JSON object per line (JSON Lines), one
+     for each benchmark, instrument, size, and number of threads.  Each
+     records the widest instruction set of the SIMD kernels, so runs with
+     ESPA_SIMD set can be compared.
+  3. The bands are rewritten before each timed run, since the clipping
+     updates them in place.  They are likely still in the page cache when
+     the run starts, so the timings are mostly of the processing rather than
+     of the disk.
+  4. With --counters, the hardware counters (see espa_perf_counters.h) of
+     the fastest run are added to each result, counting the threads of the
+     task pool as well.  The counters of the stages within a run are in the
+     timing trace, when ESPA_TRACE and ESPA_PERF_COUNTERS are set.
+*****************************************************************************/
+#include <getopt.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <stdint.h>
+#include "clip_band_misalignment.h"
+#include "generate_date_bands.h"
+#include "write_metadata.h"
+#include "gctp_defines.h"
+#include "espa_task_pool.h"
+#include "espa_cpu_dispatch.h"
+#include "espa_perf_counters.h"
+
+/* Defines */
+#define BENCH_MAX_SIZES 16       /* maximum number of scene sizes */
+#define BENCH_MAX_THREADS 16     /* maximum number of thread counts */
+#define BENCH_DEFAULT_SIZES "1000x1000,4000x4000"
+#define BENCH_DEFAULT_THREADS "1"
+#define BENCH_DEFAULT_REPEAT 3
+#define BENCH_DEFAULT_OUTPUT "bench_level1.jsonl"
+#define BENCH_SCENE_ANGLE 12.0   /* rotation of the scene footprint, which is
+                                    about the heading of a WRS-2 scene */
+#define BENCH_PIXEL_SIZE 30.0    /* pixel size of the scenes (meters) */
+
+/* Synthetic scene of one instrument */
+typedef struct
+{
+    const char *instrument;      /* instrument in the global metadata */
+    const char *satellite;       /* satellite in the global metadata */
+    const char *product_id;      /* product ID, which prefixes the files */
+    const char *benchmark;       /* name of the clipping benchmark */
+    int band_size;               /* bytes per pixel of the image bands */
+    int nbands;                  /* number of image bands */
+    const char *bands[MAX_CLIP_BANDS];  /* names of the image bands */
+} Bench_scene_t;
+
+static const Bench_scene_t bench_scenes[] =
+{
+    {"TM", "LANDSAT_5", "LT05_L1TP_038037_19920614_20200914_02_T1",
+     "clip_band_misalignment", sizeof (uint8_t), 7,
+     {"b1", "b2", "b3", "b4", "b5", "b6", "b7"}},
+    {"ETM", "LANDSAT_7", "LE07_L1TP_022033_20140228_20161028_02_T1",
+     "clip_band_misalignment", sizeof (uint8_t), 8,
+     {"b1", "b2", "b3", "b4", "b5", "b61", "b62", "b7"}},
+    {"OLI_TIRS", "LANDSAT_8", "LC08_L1TP_047027_20131014_20170308_02_T1",
+     "clip_band_misalignment_landsat89", sizeof (uint16_t), 10,
+     {"b1", "b2", "b3", "b4", "b5", "b6", "b7", "b9", "b10", "b11"}}
+};
+#define BENCH_NSCENES (int) (sizeof (bench_scenes) / sizeof (bench_scenes[0]))
+
+/******************************************************************************
+MODULE: usage
+
+PURPOSE: Prints the usage information for this application.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+void usage ()
+{
+    printf ("bench_level1 times the band misalignment clipping (TM/ETM+ and "
+            "OLI/TIRS) and the date bands on synthetic scenes of each "
+            "instrument, for several scene sizes and numbers of threads. "
+            "The timings are written as one JSON object per line.\n");
+    printf ("version: %s\n\n", ESPA_COMMON_VERSION);
+    printf ("usage: bench_level1 [--sizes=nlines x nsamps,...] "
+            "[--threads=number_of_threads,...] [--repeat=number_of_runs] "
+            "[--dir=work_directory] [--output=results_filename] "
+            "[--counters]\n");
+
+    printf ("\nwhere the following parameters are optional:\n");
+    printf ("    -sizes: comma-separated list of scene sizes, each as "
+            "LINESxSAMPS (default is %s; a full WRS-2 scene is about "
+            "7000x8000)\n", BENCH_DEFAULT_SIZES);
+    printf ("    -threads: comma-separated list of the numbers of threads "
+            "clipping the lines of the bands, when built with "
+            "ENABLE_THREADING (default is %s)\n", BENCH_DEFAULT_THREADS);
+    printf ("    -repeat: number of timed runs of each benchmark; the "
+            "minimum and mean are reported (default is %d)\n",
+            BENCH_DEFAULT_REPEAT);
+    printf ("    -dir: directory in which the synthetic scenes are created "
+            "(default is the current directory)\n");
+    printf ("    -output: name of the results file (default is %s)\n",
+            BENCH_DEFAULT_OUTPUT);
+    printf ("    -counters: if specified the hardware counters (cycles, "
+            "instructions, and last level cache misses) of the fastest run "
+            "are reported, with the instructions per cycle and the "
+            "bandwidth from memory\n");
+    printf ("\nExample: bench_level1 --sizes=1000x1000,7000x8000 "
+            "--threads=1,2,4 --dir=/tmp\n");
+}
+
+
+/******************************************************************************
+MODULE:  parse_int_list
+
+PURPOSE:  Parses a comma-separated list of positive integers, or of pairs of
+positive integers separated by an 'x'.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           The list is empty, too long, or has an invalid entry
+SUCCESS         Successfully parsed the list
+
+NOTES:
+  1. For pairs, the two values of entry i are stored in values[2*i] and
+     values[2*i+1].
+******************************************************************************/
+static int parse_int_list
+(
+    const char *list,     /* I: comma-separated list */
+    bool pairs,           /* I: is each entry a pair such as 1000x2000? */
+    int max_entries,      /* I: maximum number of entries */
+    int *values,          /* O: values of the entries */
+    int *nentries         /* O: number of entries */
+)
+{
+    const char *cptr = list;  /* current position in the list */
+    char *end = NULL;         /* end of the current value */
+    int nvalues = pairs ? 2 : 1;  /* number of values per entry */
+    int i;                    /* looping variable */
+    long value;               /* current value */
+
+    *nentries = 0;
+    while (*cptr != '\0')
+    {
+        if (*nentries == max_entries)
+            return (ERROR);
+        for (i = 0; i < nvalues; i++)
+        {
+            value = strtol (cptr, &end, 10);
+            if (end == cptr || value < 1 || value > INT32_MAX / 2)
+                return (ERROR);
+            values[*nentries * nvalues + i] = value;
+            cptr = end;
+            if (i < nvalues - 1)
+            {
+                if (*cptr != 'x')
+                    return (ERROR);
+                cptr++;
+            }
+        }
+        (*nentries)++;
+
+        if (*cptr == ',')
+            cptr++;
+        else if (*cptr != '\0')
+            return (ERROR);
+    }
+
+    return (*nentries > 0 ? SUCCESS : ERROR);
+}
+
+
+/******************************************************************************
+MODULE:  get_args
+
+PURPOSE:  Gets the command-line arguments and validates them.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error getting the command-line arguments or a command-line
+                argument and associated value were not valid
+SUCCESS         No errors encountered
+
+NOTES:
+  1. Memory is allocated for the directory and output file.  These should be
+     character pointers set to NULL on input.  The caller is responsible for
+     freeing the allocated memory upon successful return.
+******************************************************************************/
+short get_args
+(
+    int argc,             /* I: number of cmd-line args */
+    char *argv[],         /* I: string of cmd-line args */
+    int *sizes,           /* O: lines and samples of each scene size
+                                (2 * BENCH_MAX_SIZES entries) */
+    int *nsizes,          /* O: number of scene sizes */
+    int *threads,         /* O: numbers of threads (BENCH_MAX_THREADS
+                                entries) */
+    int *nthreads,        /* O: number of thread counts */
+    int *repeat,          /* O: number of timed runs of each benchmark */
+    char **work_dir,      /* O: address of the work directory */
+    char **output_file,   /* O: address of the results filename */
+    bool *counters        /* O: are the hardware counters reported? */
+)
+{
+    int c;                           /* current argument index */
+    int option_index;                /* index for the command-line option */
+    char errmsg[STR_SIZE];           /* error message */
+    char FUNC_NAME[] = "get_args";   /* function name */
+    const char *size_list = BENCH_DEFAULT_SIZES;   /* list of scene sizes */
+    const char *thread_list = BENCH_DEFAULT_THREADS; /* list of threads */
+    static int counters_flag = 0;    /* flag for the hardware counters */
+    static struct option long_options[] =
+    {
+        {"counters", no_argument, &counters_flag, 1},
+        {"sizes", required_argument, 0, 's'},
+        {"threads", required_argument, 0, 't'},
+        {"repeat", required_argument, 0, 'r'},
+        {"dir", required_argument, 0, 'd'},
+        {"output", required_argument, 0, 'o'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    *repeat = BENCH_DEFAULT_REPEAT;
+
+    /* Loop through all the cmd-line options */
+    opterr = 0;   /* turn off getopt_long error msgs as we'll print our own */
+    while (1)
+    {
+        /* optstring in call to getopt_long is empty since we will only
+           support the long options */
+        c = getopt_long (argc, argv, "", long_options, &option_index);
+        if (c == -1)
+        {   /* Out of cmd-line options */
+            break;
+        }
+
+        switch (c)
+        {
+            case 0:
+                /* If this option set a flag, do nothing else now. */
+                if (long_options[option_index].flag != 0)
+                    break;
+
+            case 'h':  /* help */
+                usage ();
+                return (ERROR);
+                break;
+
+            case 's':  /* scene sizes */
+                size_list = optarg;
+                break;
+
+            case 't':  /* numbers of threads */
+                thread_list = optarg;
+                break;
+
+            case 'r':  /* number of timed runs */
+                *repeat = atoi (optarg);
+                if (*repeat < 1)
+                {
+                    sprintf (errmsg, "Invalid number of runs: %s", optarg);
+                    error_handler (true, FUNC_NAME, errmsg);
+                    usage ();
+                    return (ERROR);
+                }
+                break;
+
+            case 'd':  /* work directory */
+                free (*work_dir);
+                *work_dir = strdup (optarg);
+                break;
+
+            case 'o':  /* results file */
+                free (*output_file);
+                *output_file = strdup (optarg);
+                break;
+
+            case '?':
+            default:
+                sprintf (errmsg, "Unknown option %s", argv[optind-1]);
+                error_handler (true, FUNC_NAME, errmsg);
+                usage ();
+                return (ERROR);
+                break;
+        }
+    }
+
+    if (parse_int_list (size_list, true, BENCH_MAX_SIZES, sizes, nsizes)
+        != SUCCESS)
+    {
+        sprintf (errmsg, "Invalid list of scene sizes: %s", size_list);
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    if (parse_int_list (thread_list, false, BENCH_MAX_THREADS, threads,
+        nthreads) != SUCCESS)
+    {
+        sprintf (errmsg, "Invalid list of numbers of threads: %s",
+            thread_list);
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    if (*output_file == NULL)
+        *output_file = strdup (BENCH_DEFAULT_OUTPUT);
+
+    /* Check the hardware counters flag */
+    *counters = counters_flag != 0;
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  elapsed_seconds
+
+PURPOSE:  Returns the seconds elapsed since the specified time.
+
+RETURN VALUE:
+Type = double
+Value           Description
+-----           -----------
+>= 0            Wall-clock seconds elapsed since start
+
+NOTES:
+******************************************************************************/
+static double elapsed_seconds
+(
+    const struct timespec *start  /* I: starting time */
+)
+{
+    struct timespec now;          /* current time */
+
+    clock_gettime (CLOCK_MONOTONIC, &now);
+    return ((now.tv_sec - start->tv_sec) +
+        (now.tv_nsec - start->tv_nsec) * 1.0e-9);
+}
+
+
+/******************************************************************************
+MODULE:  create_scene_metadata
+
+PURPOSE:  Creates the metadata of a synthetic scene, and writes it to the XML
+file of the scene.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error creating the metadata
+SUCCESS         Successfully created the metadata
+
+NOTES:
+  1. The scene is in UTM, with its image bands followed by the band quality
+     band.  The bands are named after the product ID, as in a Level-1
+     product.
+******************************************************************************/
+static int create_scene_metadata
+(
+    const Bench_scene_t *scene,   /* I: scene to be created */
+    int nlines,                   /* I: number of lines in the scene */
+    int nsamps,                   /* I: number of samples in the scene */
+    Espa_internal_meta_t *xml_metadata  /* O: metadata of the scene */
+)
+{
+    char FUNC_NAME[] = "create_scene_metadata";  /* function name */
+    char errmsg[STR_SIZE];        /* error message */
+    char xml_file[STR_SIZE];      /* name of the XML file of the scene */
+    int i;                        /* looping variable */
+    Espa_global_meta_t *gmeta = &xml_metadata->global; /* global metadata */
+    Espa_band_meta_t *bmeta = NULL;  /* metadata of the current band */
+
+    init_metadata_struct (xml_metadata);
+    if (allocate_band_metadata (xml_metadata, scene->nbands + 1) != SUCCESS)
+    {
+        sprintf (errmsg, "Allocating the band metadata");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    strcpy (gmeta->data_provider, "USGS/EROS");
+    strcpy (gmeta->satellite, scene->satellite);
+    strcpy (gmeta->instrument, scene->instrument);
+    strcpy (gmeta->acquisition_date, "2013-10-14");
+    strcpy (gmeta->product_id, scene->product_id);
+    strcpy (gmeta->level1_production_date, "2020-09-14T00:00:00Z");
+    gmeta->wrs_system = 2;
+    gmeta->wrs_path = 47;
+    gmeta->wrs_row = 27;
+    gmeta->proj_info.proj_type = GCTP_UTM_PROJ;
+    gmeta->proj_info.datum_type = ESPA_WGS84;
+    gmeta->proj_info.utm_zone = 10;
+    strcpy (gmeta->proj_info.units, "meters");
+    strcpy (gmeta->proj_info.grid_origin, "CENTER");
+    gmeta->proj_info.ul_corner[0] = 500000.0;
+    gmeta->proj_info.ul_corner[1] = 5300000.0;
+    gmeta->proj_info.lr_corner[0] = 500000.0 + (nsamps - 1) *
+        BENCH_PIXEL_SIZE;
+    gmeta->proj_info.lr_corner[1] = 5300000.0 - (nlines - 1) *
+        BENCH_PIXEL_SIZE;
+
+    for (i = 0; i <= scene->nbands; i++)
+    {
+        bmeta = &xml_metadata->band[i];
+        strcpy (bmeta->product, "L1TP");
+        strcpy (bmeta->name, i < scene->nbands ? scene->bands[i] :
+            "qa_pixel");
+        strcpy (bmeta->category, i < scene->nbands ? "image" : "qa");
+        bmeta->data_type = (i < scene->nbands &&
+            scene->band_size == sizeof (uint8_t)) ? ESPA_UINT8 : ESPA_UINT16;
+        bmeta->nlines = nlines;
+        bmeta->nsamps = nsamps;
+        bmeta->fill_value = i < scene->nbands ? LEVEL1_FILL : BQA_FILL;
+        strcpy (bmeta->short_name, bmeta->name);
+        strcpy (bmeta->long_name, bmeta->name);
+        snprintf (bmeta->file_name, sizeof (bmeta->file_name), "%s_%s.img",
+            scene->product_id, bmeta->name);
+        bmeta->pixel_size[0] = bmeta->pixel_size[1] = BENCH_PIXEL_SIZE;
+        strcpy (bmeta->pixel_units, "meters");
+        strcpy (bmeta->data_units, i < scene->nbands ? "digital numbers" :
+            "quality/feature classification");
+        strcpy (bmeta->production_date, gmeta->level1_production_date);
+    }
+
+    snprintf (xml_file, sizeof (xml_file), "%s.xml", scene->product_id);
+    if (write_metadata (xml_metadata, xml_file) != SUCCESS)
+    {
+        sprintf (errmsg, "Writing the XML file: %s", xml_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  write_scene_bands
+
+PURPOSE:  Writes the image bands and the band quality band of a synthetic
+scene.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the bands
+SUCCESS         Successfully wrote the bands
+
+NOTES:
+  1. The footprint is a rectangle covering about 80% of each dimension of the
+     scene, rotated by BENCH_SCENE_ANGLE degrees about the center.  Each line
+     of the footprint is then one run of samples, whose ends are moved in by
+     an offset of up to 4 pixels which differs for each band.
+  2. The band quality is fill outside the footprint of the first band, so
+     the clipping both fills the image bands and updates the band quality.
+******************************************************************************/
+static int write_scene_bands
+(
+    const Bench_scene_t *scene,   /* I: scene to be written */
+    Espa_internal_meta_t *xml_metadata  /* I: metadata of the scene */
+)
+{
+    char FUNC_NAME[] = "write_scene_bands";  /* function name */
+    char errmsg[STR_SIZE];        /* error message */
+    int i;                        /* looping variable for the bands */
+    int line, samp;               /* looping variables for the pixels */
+    int nlines = xml_metadata->band[0].nlines;  /* lines in the scene */
+    int nsamps = xml_metadata->band[0].nsamps;  /* samples in the scene */
+    int size;                     /* bytes per pixel of the current band */
+    int edge;                     /* offset of the current band's edges */
+    int first, last;              /* first and last sample of the footprint
+                                     in the current band and line */
+    double angle = BENCH_SCENE_ANGLE * M_PI / 180.0;  /* rotation (radians) */
+    double half_width = 0.4 * nsamps;  /* half-sizes of the footprint */
+    double half_height = 0.4 * nlines;
+    double dy;                    /* line offset from the scene center */
+    double lo, hi;                /* sample offsets of the footprint edges
+                                     from the scene center */
+    uint32_t value;               /* pseudo-random pixel value */
+    void *line_buf = NULL;        /* current line of the current band */
+    FILE *fptr = NULL;            /* pointer to the current band file */
+
+    line_buf = malloc ((size_t) nsamps * sizeof (uint16_t));
+    if (line_buf == NULL)
+    {
+        sprintf (errmsg, "Allocating memory for a line of the bands");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    for (i = 0; i <= scene->nbands; i++)
+    {
+        size = (i < scene->nbands) ? scene->band_size : sizeof (uint16_t);
+        edge = (i < scene->nbands) ? (i * 3) % 5 : 0;
+        fptr = open_raw_binary (xml_metadata->band[i].file_name, "wb");
+        if (fptr == NULL)
+        {
+            sprintf (errmsg, "Opening the band file: %s",
+                xml_metadata->band[i].file_name);
+            error_handler (true, FUNC_NAME, errmsg);
+            free (line_buf);
+            return (ERROR);
+        }
+
+        value = 12345 + i;
+        for (line = 0; line < nlines; line++)
+        {
+            /* Find the samples of the rotated rectangle in this line, from
+               the intersection of its two pairs of edges */
+            dy = line - 0.5 * nlines;
+            lo = (-half_width - dy * sin (angle)) / cos (angle);
+            hi = (half_width - dy * sin (angle)) / cos (angle);
+            if ((dy * cos (angle) - half_height) / sin (angle) > lo)
+                lo = (dy * cos (angle) - half_height) / sin (angle);
+            if ((dy * cos (angle) + half_height) / sin (angle) < hi)
+                hi = (dy * cos (angle) + half_height) / sin (angle);
+            first = (int) ceil (lo + 0.5 * nsamps) + edge;
+            last = (int) floor (hi + 0.5 * nsamps) - edge;
+
+            for (samp = 0; samp < nsamps; samp++)
+            {
+                value = value * 1103515245 + 12345;
+                if (i == scene->nbands)
+                    ((uint16_t *) line_buf)[samp] =
+                        (samp < first || samp > last) ? BQA_FILL : 21824;
+                else if (size == sizeof (uint8_t))
+                    ((uint8_t *) line_buf)[samp] =
+                        (samp < first || samp > last) ? LEVEL1_FILL :
+                        1 + (value >> 16) % 255;
+                else
+                    ((uint16_t *) line_buf)[samp] =
+                        (samp < first || samp > last) ? LEVEL1_FILL :
+                        5000 + (value >> 16) % 20000;
+            }
+
+            if (write_raw_binary (fptr, 1, nsamps, size, line_buf) != SUCCESS)
+            {
+                sprintf (errmsg, "Writing line %d of band %s", line,
+                    xml_metadata->band[i].name);
+                error_handler (true, FUNC_NAME, errmsg);
+                close_raw_binary (fptr);
+                free (line_buf);
+                return (ERROR);
+            }
+        }
+        close_raw_binary (fptr);
+    }
+
+    free (line_buf);
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  write_result
+
+PURPOSE:  Writes the timing of one benchmark as a line of JSON.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. The throughput is of the pixels of all the bands processed, based on
+     the fastest run, as are the hardware counts.
+******************************************************************************/
+static void write_result
+(
+    FILE *fptr,                   /* I: results file */
+    const char *benchmark,        /* I: name of the benchmark */
+    const char *instrument,       /* I: instrument of the scene */
+    int nlines,                   /* I: number of lines in the scene */
+    int nsamps,                   /* I: number of samples in the scene */
+    int nbands,                   /* I: number of bands processed */
+    int threads,                  /* I: number of threads */
+    int repeat,                   /* I: number of timed runs */
+    const double *seconds,        /* I: seconds taken by each run */
+    const Espa_perf_values_t *counts  /* I: hardware counts of each run;
+                                        NULL if not counted */
+)
+{
+    int i;                        /* looping variable */
+    int fastest = 0;              /* index of the fastest run */
+    double min = seconds[0];      /* fastest run */
+    double sum = 0.0;             /* total of the runs */
+
+    for (i = 0; i < repeat; i++)
+    {
+        if (seconds[i] < min)
+        {
+            min = seconds[i];
+            fastest = i;
+        }
+        sum += seconds[i];
+    }
+
+    fprintf (fptr, "{\"benchmark\": \"%s\", \"version\": \"%s\", "
+        "\"instrument\": \"%s\", \"nlines\": %d, \"nsamps\": %d, "
+        "\"nbands\": %d, \"threads\": %d, \"simd\": \"%s\", "
+        "\"repeat\": %d, \"min_seconds\": %.6f, \"mean_seconds\": %.6f, "
+        "\"mpixels_per_second\": %.3f", benchmark, ESPA_COMMON_VERSION,
+        instrument, nlines, nsamps, nbands, threads, espa_cpu_simd_name (),
+        repeat, min,
+        sum / repeat, min > 0.0 ?
+        (double) nlines * nsamps * nbands / min * 1.0e-6 : 0.0);
+    if (counts != NULL)
+        espa_perf_write_json (fptr, &counts[fastest], min);
+    fprintf (fptr, "}\n");
+    fflush (fptr);
+}
+
+
+/******************************************************************************
+MODULE:  remove_band_files
+
+PURPOSE:  Removes the raw binary files of the bands, and any ENVI headers
+written beside them.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+static void remove_band_files
+(
+    Espa_internal_meta_t *xml_metadata  /* I: metadata of the bands */
+)
+{
+    char tmpstr[STR_SIZE];        /* name of the ENVI header */
+    int i;                        /* looping variable */
+
+    for (i = 0; i < xml_metadata->nbands; i++)
+    {
+        unlink (xml_metadata->band[i].file_name);
+
+        snprintf (tmpstr, sizeof (tmpstr), "%s",
+            xml_metadata->band[i].file_name);
+        if (strlen (tmpstr) > 3)
+        {
+            sprintf (&tmpstr[strlen (tmpstr) - 3], "hdr");
+            unlink (tmpstr);
+        }
+    }
+}
+
+
+/******************************************************************************
+MODULE:  remove_scene
+
+PURPOSE:  Removes the files of a synthetic scene: its bands, footprint index,
+and XML file.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+static void remove_scene
+(
+    Espa_internal_meta_t *xml_metadata  /* I: metadata of the scene */
+)
+{
+    char tmpstr[STR_SIZE];        /* name of the current file */
+
+    remove_band_files (xml_metadata);
+    snprintf (tmpstr, sizeof (tmpstr), "%s%s",
+        xml_metadata->global.product_id, ESPA_FOOTPRINT_SUFFIX);
+    unlink (tmpstr);
+    snprintf (tmpstr, sizeof (tmpstr), "%s.xml",
+        xml_metadata->global.product_id);
+    unlink (tmpstr);
+}
+
+
+/******************************************************************************
+MODULE:  main
+
+PURPOSE:  Creates a synthetic scene of each instrument at each size, times
+the band misalignment clipping of it for each number of threads and the
+writing of its date bands, and writes the timings to the results file.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error running the benchmarks
+SUCCESS         No errors encountered
+
+NOTES:
+  1. The date bands are not threaded, so they are only timed once for each
+     scene size, using the TM scene.
+******************************************************************************/
+int main (int argc, char** argv)
+{
+    char FUNC_NAME[] = "bench_level1";  /* function name */
+    char errmsg[STR_SIZE];             /* error message */
+    char *work_dir = NULL;             /* directory of the scenes */
+    char *output_file = NULL;          /* name of the results file */
+    int sizes[2 * BENCH_MAX_SIZES];    /* lines and samples of each size */
+    int nsizes;                        /* number of scene sizes */
+    int threads[BENCH_MAX_THREADS];    /* numbers of threads */
+    int nthreads;                      /* number of thread counts */
+    int repeat;                        /* number of timed runs */
+    int isize, iscene, ithread, run;   /* looping variables */
+    int status;                        /* status of the current run */
+    double *seconds = NULL;            /* seconds taken by each run */
+    bool counters;                     /* are the hardware counters
+                                          reported? */
+    Espa_perf_counters_t perf;         /* hardware counters of the
+                                          benchmark and its threads */
+    Espa_perf_values_t perf_start;     /* counters at the start of a run */
+    Espa_perf_values_t perf_end;       /* counters at the end of a run */
+    Espa_perf_values_t *counts = NULL; /* hardware counts of each run; NULL
+                                          if not counted */
+    struct timespec start;             /* start of the current run */
+    FILE *fptr = NULL;                 /* pointer to the results file */
+    const Bench_scene_t *scene = NULL; /* current scene */
+    Espa_internal_meta_t xml_metadata; /* metadata of the current scene */
+    Espa_internal_meta_t date_meta;    /* metadata of the date bands */
+
+    printf ("bench_level1 version: %s\n", ESPA_COMMON_VERSION);
+
+    /* Read the command-line arguments */
+    if (get_args (argc, argv, sizes, &nsizes, threads, &nthreads, &repeat,
+        &work_dir, &output_file, &counters) != SUCCESS)
+    {   /* get_args already printed the error message */
+        exit (EXIT_FAILURE);
+    }
+
+    /* Open the results file before moving to the work directory, so a
+       relative name is relative to where the benchmark was started */
+    fptr = fopen (output_file, "w");
+    if (fptr == NULL)
+    {
+        sprintf (errmsg, "Opening the results file: %s", output_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        exit (EXIT_FAILURE);
+    }
+
+    /* The band file names are relative to the work directory, as they are to
+       the product directory for the Level-1 tools */
+    if (work_dir != NULL && chdir (work_dir) != 0)
+    {
+        sprintf (errmsg, "Changing to the work directory: %s", work_dir);
+        error_handler (true, FUNC_NAME, errmsg);
+        exit (EXIT_FAILURE);
+    }
+
+    seconds = calloc (repeat, sizeof (double));
+    if (seconds == NULL)
+    {
+        sprintf (errmsg, "Allocating memory for the timings");
+        error_handler (true, FUNC_NAME, errmsg);
+        exit (EXIT_FAILURE);
+    }
+
+    /* Open the counters before the threads of the task pool are started,
+       so they inherit them */
+    if (counters)
+    {
+        if (espa_perf_open (&perf, true) != SUCCESS)
+            error_handler (false, FUNC_NAME, "The hardware counters are not "
+                "available; only the timings will be reported");
+        else
+        {
+            counts = calloc (repeat, sizeof (Espa_perf_values_t));
+            if (counts == NULL)
+            {
+                sprintf (errmsg, "Allocating memory for the counts");
+                error_handler (true, FUNC_NAME, errmsg);
+                exit (EXIT_FAILURE);
+            }
+        }
+    }
+
+#ifndef _OPENMP
+    for (ithread = 0; ithread < nthreads; ithread++)
+    {
+        if (threads[ithread] > 1)
+        {
+            error_handler (false, FUNC_NAME, "Threading is not enabled in "
+                "this build; only a single thread will be timed");
+            threads[0] = 1;
+            nthreads = 1;
+            break;
+        }
+    }
+#endif
+
+    for (isize = 0; isize < nsizes; isize++)
+    {
+        for (iscene = 0; iscene < BENCH_NSCENES; iscene++)
+        {
+            scene = &bench_scenes[iscene];
+            if (create_scene_metadata (scene, sizes[2 * isize],
+                sizes[2 * isize + 1], &xml_metadata) != SUCCESS)
+            {  /* Error messages already written */
+                exit (EXIT_FAILURE);
+            }
+
+            /* Time the clipping for each number of threads, rewriting the
+               unclipped bands before each run */
+            for (ithread = 0; ithread < nthreads; ithread++)
+            {
+#ifdef _OPENMP
+                espa_task_pool_set_threads (threads[ithread]);
+#endif
+                for (run = 0; run < repeat; run++)
+                {
+                    if (write_scene_bands (scene, &xml_metadata) != SUCCESS)
+                    {  /* Error messages already written */
+                        exit (EXIT_FAILURE);
+                    }
+
+                    if (counts != NULL)
+                        espa_perf_read (&perf, &perf_start);
+                    clock_gettime (CLOCK_MONOTONIC, &start);
+                    if (scene->band_size == sizeof (uint8_t))
+                        status = clip_band_misalignment (&xml_metadata);
+                    else
+                        status = clip_band_misalignment_landsat89 (
+                            &xml_metadata);
+                    seconds[run] = elapsed_seconds (&start);
+                    if (counts != NULL)
+                    {
+                        espa_perf_read (&perf, &perf_end);
+                        espa_perf_delta (&perf_start, &perf_end,
+                            &counts[run]);
+                    }
+                    if (status != SUCCESS)
+                    {
+                        sprintf (errmsg, "Clipping the %s scene",
+                            scene->instrument);
+                        error_handler (true, FUNC_NAME, errmsg);
+                        exit (EXIT_FAILURE);
+                    }
+                }
+
+                write_result (fptr, scene->benchmark, scene->instrument,
+                    sizes[2 * isize], sizes[2 * isize + 1],
+                    scene->nbands + 1, threads[ithread], repeat, seconds,
+                    counts);
+            }
+
+            /* Time the setup and writing of the three date bands */
+            if (iscene == 0)
+            {
+                init_metadata_struct (&date_meta);
+                if (allocate_band_metadata (&date_meta, 3) != SUCCESS)
+                {
+                    sprintf (errmsg, "Allocating the date band metadata");
+                    error_handler (true, FUNC_NAME, errmsg);
+                    exit (EXIT_FAILURE);
+                }
+
+                for (run = 0; run < repeat; run++)
+                {
+                    if (counts != NULL)
+                        espa_perf_read (&perf, &perf_start);
+                    clock_gettime (CLOCK_MONOTONIC, &start);
+                    if (setup_date_bands (&xml_metadata, &xml_metadata.band[0],
+                        xml_metadata.global.level1_production_date,
+                        date_meta.band) != SUCCESS ||
+                        write_date_bands (&xml_metadata.global,
+                        date_meta.band) != SUCCESS)
+                    {
+                        sprintf (errmsg, "Writing the date bands");
+                        error_handler (true, FUNC_NAME, errmsg);
+                        exit (EXIT_FAILURE);
+                    }
+                    seconds[run] = elapsed_seconds (&start);
+                    if (counts != NULL)
+                    {
+                        espa_perf_read (&perf, &perf_end);
+                        espa_perf_delta (&perf_start, &perf_end,
+                            &counts[run]);
+                    }
+                }
+
+                write_result (fptr, "generate_date_bands", scene->instrument,
+                    sizes[2 * isize], sizes[2 * isize + 1], 3, 1, repeat,
+                    seconds, counts);
+                remove_band_files (&date_meta);
+                free_metadata (&date_meta);
+            }
+
+            remove_scene (&xml_metadata);
+            free_metadata (&xml_metadata);
+        }
+    }
+
+    /* Close the results file */
+    if (fclose (fptr) != 0)
+    {
+        sprintf (errmsg, "Closing the results file: %s", output_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        exit (EXIT_FAILURE);
+    }
+    printf ("INFO: results were written to %s\n", output_file);
+
+    /* Free the pointers */
+    if (counts != NULL)
+        espa_perf_close (&perf);
+    free (counts);
+    free (seconds);
+    free (work_dir);
+    free (output_file);
+
+    /* Successful completion */
+    exit (EXIT_SUCCESS);
+}
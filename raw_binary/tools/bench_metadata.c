@@ -0,0 +1,1209 @@
+/*****************************************************************************
+FILE: bench_metadata
+
+PURPOSE: Times the XML metadata layer (validation, parsing, writing, band
+subsets, and band appends) over a corpus of ESPA XML files with each of the
+metadata engines, and writes the throughput, allocations, and peak memory as
+machine-readable results which can be tracked across releases.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The corpus is a directory of ESPA XML files given with --corpus, such as
+     the XML files of production Landsat, MODIS, VIIRS, and Sentinel
+     products.  Without one, a synthetic corpus is written with the bands of
+     those products: Landsat Level-1 and Level-2, MODIS and VIIRS surface
+     reflectance, Sentinel-2, and a stack of over 100 bands.
+  2. The engines are the document tree (dom), the streaming parser selected
+     by ESPA_XML_PARSER_ENV (stream), and the binary metadata cache selected
+     by ESPA_META_CACHE_ENV (sidecar).  The streaming parser only parses, so
+     it is only timed with parse_metadata, and validate_xml_file always uses
+     the document tree.
+  3. Each benchmark runs in a process of its own, so its peak resident set
+     size can be taken from the resource usage of the process.  The XML
+     files are copied to the work directory first, so the metadata caches
+     and the outputs never touch the corpus.
+  4. The allocations are counted by wrapping malloc, calloc, and realloc
+     around the glibc entry points, which also counts those of libxml2.  With
+     another C library, or in a static build (BUILD_STATIC=yes, which defines
+     BENCH_NO_ALLOC_COUNT since the wrappers would clash with the malloc of
+     libc.a), they aren't counted and are reported as null.
+  5. Only the calls being benchmarked are timed and counted.  The XML file
+     rewritten before each append_metadata, since the append changes it, is
+     not.
+*****************************************************************************/
+#define _DEFAULT_SOURCE         /* for wait4 and scandir */
+#include <getopt.h>
+#include <time.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include "parse_metadata.h"
+#include "write_metadata.h"
+#include "subset_metadata.h"
+#include "metadata_cache.h"
+#include "gctp_defines.h"
+
+/* Defines */
+#define BENCH_DEFAULT_REPEAT 3
+#define BENCH_DEFAULT_OUTPUT "bench_metadata.jsonl"
+#define BENCH_CORPUS_PREFIX "bench_corpus"  /* prefix of the copies of the
+                                               XML files */
+#define BENCH_SCRATCH_XML "bench_scratch.xml"  /* output of write_metadata,
+                                                  and the XML file appended
+                                                  to by append_metadata */
+#define BENCH_SUBSET_XML "bench_subset.xml"    /* output of the band
+                                                  subset */
+#define BENCH_APPEND_BAND "bench_appended"     /* name of the appended
+                                                  band */
+#define BENCH_MAX_QA 4           /* maximum number of QA bands of a class */
+
+/* Count the allocations where the glibc entry points can be wrapped, which
+   is only in shared builds */
+#if defined(__GLIBC__) && !defined(BENCH_NO_ALLOC_COUNT)
+#define BENCH_COUNT_ALLOCS 1
+extern void *__libc_malloc (size_t size);
+extern void *__libc_calloc (size_t nmemb, size_t size);
+extern void *__libc_realloc (void *ptr, size_t size);
+
+static uint64_t bench_nallocs = 0;   /* number of allocations so far */
+
+void *malloc (size_t size)
+{
+    __atomic_fetch_add (&bench_nallocs, 1, __ATOMIC_RELAXED);
+    return (__libc_malloc (size));
+}
+
+void *calloc (size_t nmemb, size_t size)
+{
+    __atomic_fetch_add (&bench_nallocs, 1, __ATOMIC_RELAXED);
+    return (__libc_calloc (nmemb, size));
+}
+
+void *realloc (void *ptr, size_t size)
+{
+    __atomic_fetch_add (&bench_nallocs, 1, __ATOMIC_RELAXED);
+    return (__libc_realloc (ptr, size));
+}
+#define BENCH_NALLOCS() __atomic_load_n (&bench_nallocs, __ATOMIC_RELAXED)
+#else
+#define BENCH_COUNT_ALLOCS 0
+#define BENCH_NALLOCS() ((uint64_t) 0)
+#endif
+
+/* Metadata engines */
+typedef enum {
+  BENCH_DOM,            /* document tree */
+  BENCH_STREAM,         /* streaming parser */
+  BENCH_SIDECAR,        /* binary metadata cache */
+  BENCH_NENGINES
+} Bench_engine_t;
+
+static const char *bench_engine_names[] = {"dom", "stream", "sidecar"};
+
+/* Operations of the metadata layer */
+typedef enum {
+  BENCH_VALIDATE,       /* validate_xml_file */
+  BENCH_PARSE,          /* parse_metadata */
+  BENCH_VALIDATE_PARSE, /* validate_and_parse_metadata */
+  BENCH_WRITE,          /* write_metadata */
+  BENCH_SUBSET,         /* subset_xml_by_band */
+  BENCH_APPEND,         /* append_metadata */
+  BENCH_NOPS
+} Bench_op_t;
+
+/* Operation timed over the corpus */
+typedef struct
+{
+    const char *benchmark;       /* name of the benchmark */
+    unsigned engines;            /* engines it is timed with (bit mask) */
+} Bench_op_info_t;
+
+#define BENCH_ENGINE(engine) (1u << (engine))
+static const Bench_op_info_t bench_ops[BENCH_NOPS] =
+{
+    {"validate_xml_file", BENCH_ENGINE (BENCH_DOM)},
+    {"parse_metadata", BENCH_ENGINE (BENCH_DOM) |
+     BENCH_ENGINE (BENCH_STREAM) | BENCH_ENGINE (BENCH_SIDECAR)},
+    {"validate_and_parse_metadata", BENCH_ENGINE (BENCH_DOM) |
+     BENCH_ENGINE (BENCH_SIDECAR)},
+    {"write_metadata", BENCH_ENGINE (BENCH_DOM) |
+     BENCH_ENGINE (BENCH_SIDECAR)},
+    {"subset_xml_by_band", BENCH_ENGINE (BENCH_DOM) |
+     BENCH_ENGINE (BENCH_SIDECAR)},
+    {"append_metadata", BENCH_ENGINE (BENCH_DOM) |
+     BENCH_ENGINE (BENCH_SIDECAR)}
+};
+
+/* Class of product in the synthetic corpus */
+typedef struct
+{
+    const char *name;            /* class of the product */
+    const char *satellite;       /* satellite in the global metadata */
+    const char *instrument;      /* instrument in the global metadata */
+    const char *product;         /* product of the bands */
+    const char *source;          /* source of the image bands */
+    const char *prefix;          /* prefix of the image band names, followed
+                                    by the band number */
+    int proj_type;               /* GCTP_UTM_PROJ or GCTP_SIN_PROJ */
+    int nimage;                  /* number of image bands */
+    int nqa;                     /* number of QA bands, with bitmap
+                                    descriptions (up to BENCH_MAX_QA) */
+    int nlines;                  /* number of lines in the bands */
+    int nsamps;                  /* number of samples in the bands */
+    double pixel_size;           /* pixel size (meters) */
+} Bench_class_t;
+
+static const Bench_class_t bench_classes[] =
+{
+    {"landsat_l1", "LANDSAT_8", "OLI_TIRS", "L1TP", "level1", "b",
+     GCTP_UTM_PROJ, 11, 2, 7801, 7681, 30.0},
+    {"landsat_l2", "LANDSAT_8", "OLI_TIRS", "L2SP", "sr_refl", "sr_b",
+     GCTP_UTM_PROJ, 19, 3, 7801, 7681, 30.0},
+    {"modis", "TERRA", "MODIS", "MOD09GA", "sr_refl", "sur_refl_b",
+     GCTP_SIN_PROJ, 13, 2, 2400, 2400, 463.312716528},
+    {"viirs", "NPP", "VIIRS", "VNP09GA", "sr_refl", "sr_m",
+     GCTP_SIN_PROJ, 11, 2, 1200, 1200, 926.625433055},
+    {"sentinel", "SENTINEL_2A", "MSI", "L1C", "level1", "B",
+     GCTP_UTM_PROJ, 13, 1, 10980, 10980, 10.0},
+    {"stack", "LANDSAT_8", "OLI_TIRS", "stack", "level1", "b",
+     GCTP_UTM_PROJ, 120, 4, 5000, 5000, 30.0}
+};
+#define BENCH_NCLASSES \
+    (int) (sizeof (bench_classes) / sizeof (bench_classes[0]))
+
+/* Names of the QA bands, and the descriptions of their bits */
+static const char *bench_qa_names[BENCH_MAX_QA] =
+    {"qa_pixel", "qa_radsat", "qa_aerosol", "qa_cloud"};
+static const char *bench_qa_bits[] =
+    {"fill", "dilated_cloud", "cirrus", "cloud", "cloud_shadow", "snow",
+     "clear", "water", "cloud_confidence_low", "cloud_confidence_high",
+     "cloud_shadow_confidence_low", "cloud_shadow_confidence_high",
+     "snow_ice_confidence_low", "snow_ice_confidence_high",
+     "cirrus_confidence_low", "cirrus_confidence_high"};
+#define BENCH_NQA_BITS \
+    (int) (sizeof (bench_qa_bits) / sizeof (bench_qa_bits[0]))
+
+/* Document of the corpus */
+typedef struct
+{
+    char xml_file[STR_SIZE];     /* copy of the XML file in the work
+                                    directory */
+    char source[STR_SIZE];       /* synthetic class or XML file of the
+                                    corpus it was copied from */
+    double nbytes;               /* size of the XML file */
+} Bench_doc_t;
+
+/* Results of a benchmark, sent back by its process */
+typedef struct
+{
+    int status;                  /* SUCCESS or ERROR */
+    double allocs_per_doc;       /* allocations per document per run */
+    long base_rss_kb;            /* resident set size before the timed runs
+                                    (KB) */
+} Bench_child_t;
+
+/******************************************************************************
+MODULE: usage
+
+PURPOSE: Prints the usage information for this application.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+void usage ()
+{
+    printf ("bench_metadata times validate_xml_file, parse_metadata, "
+            "validate_and_parse_metadata, write_metadata, subset_xml_by_band, "
+            "and append_metadata over a corpus of ESPA XML files, with the "
+            "document tree, streaming parser, and binary metadata cache "
+            "engines.  The documents per second, allocations per document, "
+            "and peak memory are written as one JSON object per line.\n");
+    printf ("version: %s\n\n", ESPA_COMMON_VERSION);
+    printf ("usage: bench_metadata [--corpus=xml_directory] "
+            "[--repeat=number_of_runs] [--dir=work_directory] "
+            "[--output=results_filename]\n");
+
+    printf ("\nwhere the following parameters are optional:\n");
+    printf ("    -corpus: directory of ESPA XML files to replay (default is "
+            "a synthetic corpus of Landsat Level-1 and Level-2, MODIS, "
+            "VIIRS, Sentinel-2, and %d band products)\n",
+            bench_classes[BENCH_NCLASSES-1].nimage +
+            bench_classes[BENCH_NCLASSES-1].nqa);
+    printf ("    -repeat: number of timed runs over the corpus; the minimum "
+            "and mean are reported (default is %d)\n", BENCH_DEFAULT_REPEAT);
+    printf ("    -dir: directory in which the XML files are copied and "
+            "written (default is the current directory)\n");
+    printf ("    -output: name of the results file (default is %s)\n",
+            BENCH_DEFAULT_OUTPUT);
+    printf ("\nThe validation needs the ESPA schema (see ESPA_SCHEMA).\n");
+    printf ("\nExample: bench_metadata --corpus=/data/xml --dir=/tmp\n");
+}
+
+
+/******************************************************************************
+MODULE:  get_args
+
+PURPOSE:  Gets the command-line arguments and validates them.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error getting the command-line arguments or a command-line
+                argument and associated value were not valid
+SUCCESS         No errors encountered
+
+NOTES:
+  1. Memory is allocated for the corpus directory, work directory, and
+     output file.  These should be character pointers set to NULL on input.
+     The caller is responsible for freeing the allocated memory upon
+     successful return.
+******************************************************************************/
+short get_args
+(
+    int argc,             /* I: number of cmd-line args */
+    char *argv[],         /* I: string of cmd-line args */
+    char **corpus_dir,    /* O: address of the corpus directory; NULL for
+                                the synthetic corpus */
+    int *repeat,          /* O: number of timed runs of each benchmark */
+    char **work_dir,      /* O: address of the work directory */
+    char **output_file    /* O: address of the results filename */
+)
+{
+    int c;                           /* current argument index */
+    int option_index;                /* index for the command-line option */
+    char errmsg[STR_SIZE];           /* error message */
+    char FUNC_NAME[] = "get_args";   /* function name */
+    static struct option long_options[] =
+    {
+        {"corpus", required_argument, 0, 'c'},
+        {"repeat", required_argument, 0, 'r'},
+        {"dir", required_argument, 0, 'd'},
+        {"output", required_argument, 0, 'o'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    *repeat = BENCH_DEFAULT_REPEAT;
+
+    /* Loop through all the cmd-line options */
+    opterr = 0;   /* turn off getopt_long error msgs as we'll print our own */
+    while (1)
+    {
+        /* optstring in call to getopt_long is empty since we will only
+           support the long options */
+        c = getopt_long (argc, argv, "", long_options, &option_index);
+        if (c == -1)
+        {   /* Out of cmd-line options */
+            break;
+        }
+
+        switch (c)
+        {
+            case 'h':  /* help */
+                usage ();
+                return (ERROR);
+                break;
+
+            case 'c':  /* corpus directory */
+                free (*corpus_dir);
+                *corpus_dir = strdup (optarg);
+                break;
+
+            case 'r':  /* number of timed runs */
+                *repeat = atoi (optarg);
+                if (*repeat < 1)
+                {
+                    sprintf (errmsg, "Invalid number of runs: %s", optarg);
+                    error_handler (true, FUNC_NAME, errmsg);
+                    usage ();
+                    return (ERROR);
+                }
+                break;
+
+            case 'd':  /* work directory */
+                free (*work_dir);
+                *work_dir = strdup (optarg);
+                break;
+
+            case 'o':  /* results file */
+                free (*output_file);
+                *output_file = strdup (optarg);
+                break;
+
+            case '?':
+            default:
+                sprintf (errmsg, "Unknown option %s", argv[optind-1]);
+                error_handler (true, FUNC_NAME, errmsg);
+                usage ();
+                return (ERROR);
+                break;
+        }
+    }
+
+    if (*output_file == NULL)
+        *output_file = strdup (BENCH_DEFAULT_OUTPUT);
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  set_engine
+
+PURPOSE:  Selects a metadata engine for the metadata library calls.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+static void set_engine
+(
+    Bench_engine_t engine         /* I: metadata engine */
+)
+{
+    unsetenv (ESPA_XML_PARSER_ENV);
+    unsetenv (ESPA_META_CACHE_ENV);
+    if (engine == BENCH_STREAM)
+        setenv (ESPA_XML_PARSER_ENV, "stream", 1);
+    else if (engine == BENCH_SIDECAR)
+        setenv (ESPA_META_CACHE_ENV, "yes", 1);
+}
+
+
+/******************************************************************************
+MODULE:  create_class_metadata
+
+PURPOSE:  Creates the metadata of a synthetic product of a class.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error creating the metadata
+SUCCESS         Successfully created the metadata
+
+NOTES:
+  1. The image bands are followed by the QA bands, each with a description
+     of its 16 bits.
+******************************************************************************/
+static int create_class_metadata
+(
+    const Bench_class_t *cls,     /* I: class of the product */
+    Espa_internal_meta_t *xml_metadata  /* O: metadata of the product */
+)
+{
+    char FUNC_NAME[] = "create_class_metadata";  /* function name */
+    char errmsg[STR_SIZE];        /* error message */
+    int i, bit;                   /* looping variables */
+    double ulx, uly;              /* upper left corner (meters) */
+    Espa_global_meta_t *gmeta = &xml_metadata->global; /* global metadata */
+    Espa_band_meta_t *bmeta = NULL;  /* metadata of the current band */
+
+    init_metadata_struct (xml_metadata);
+    if (allocate_band_metadata (xml_metadata, cls->nimage + cls->nqa)
+        != SUCCESS)
+    {
+        sprintf (errmsg, "Allocating the band metadata");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    strcpy (gmeta->data_provider, "USGS/EROS");
+    strcpy (gmeta->satellite, cls->satellite);
+    strcpy (gmeta->instrument, cls->instrument);
+    strcpy (gmeta->acquisition_date, "2013-10-14");
+    strcpy (gmeta->scene_center_time, "18:48:12.5678090Z");
+    snprintf (gmeta->product_id, sizeof (gmeta->product_id), "BENCH_%s",
+        cls->name);
+    strcpy (gmeta->level1_production_date, "2020-09-14T00:00:00Z");
+    gmeta->proj_info.proj_type = cls->proj_type;
+    strcpy (gmeta->proj_info.units, "meters");
+    strcpy (gmeta->proj_info.grid_origin, "UL");
+    gmeta->orientation_angle = 0.0;
+    if (cls->proj_type == GCTP_SIN_PROJ)
+    {
+        gmeta->proj_info.datum_type = ESPA_NODATUM;
+        gmeta->proj_info.sphere_radius = 6371007.181;
+        gmeta->proj_info.central_meridian = 0.0;
+        gmeta->proj_info.false_easting = 0.0;
+        gmeta->proj_info.false_northing = 0.0;
+        gmeta->htile = 8;
+        gmeta->vtile = 5;
+        ulx = -10007554.677;
+        uly = 5559752.598;
+    }
+    else
+    {
+        gmeta->proj_info.datum_type = ESPA_WGS84;
+        gmeta->proj_info.utm_zone = 10;
+        gmeta->wrs_system = 2;
+        gmeta->wrs_path = 47;
+        gmeta->wrs_row = 27;
+        ulx = 500000.0;
+        uly = 5300000.0;
+    }
+    gmeta->proj_info.ul_corner[0] = ulx;
+    gmeta->proj_info.ul_corner[1] = uly;
+    gmeta->proj_info.lr_corner[0] = ulx + cls->nsamps * cls->pixel_size;
+    gmeta->proj_info.lr_corner[1] = uly - cls->nlines * cls->pixel_size;
+    gmeta->ul_corner[0] = 47.8;
+    gmeta->ul_corner[1] = -123.0;
+    gmeta->lr_corner[0] = 46.8;
+    gmeta->lr_corner[1] = -121.5;
+    gmeta->bounding_coords[ESPA_WEST] = gmeta->ul_corner[1];
+    gmeta->bounding_coords[ESPA_EAST] = gmeta->lr_corner[1];
+    gmeta->bounding_coords[ESPA_NORTH] = gmeta->ul_corner[0];
+    gmeta->bounding_coords[ESPA_SOUTH] = gmeta->lr_corner[0];
+
+    for (i = 0; i < xml_metadata->nbands; i++)
+    {
+        bmeta = &xml_metadata->band[i];
+        strcpy (bmeta->product, cls->product);
+        if (i < cls->nimage)
+        {
+            strcpy (bmeta->source, cls->source);
+            snprintf (bmeta->name, sizeof (bmeta->name), "%s%d", cls->prefix,
+                i + 1);
+            strcpy (bmeta->category, "image");
+            bmeta->data_type = ESPA_INT16;
+            bmeta->fill_value = -9999;
+            bmeta->scale_factor = 0.0000275;
+            bmeta->add_offset = -0.2;
+            bmeta->valid_range[0] = 7273.0;
+            bmeta->valid_range[1] = 43636.0;
+            strcpy (bmeta->data_units, "reflectance");
+        }
+        else
+        {
+            strcpy (bmeta->source, "level1");
+            strcpy (bmeta->name, bench_qa_names[i - cls->nimage]);
+            strcpy (bmeta->category, "qa");
+            bmeta->data_type = ESPA_UINT16;
+            bmeta->fill_value = 1;
+            strcpy (bmeta->data_units, "quality/feature classification");
+            if (allocate_bitmap_metadata (bmeta, BENCH_NQA_BITS) != SUCCESS)
+            {
+                sprintf (errmsg, "Allocating the bitmap descriptions");
+                error_handler (true, FUNC_NAME, errmsg);
+                return (ERROR);
+            }
+            for (bit = 0; bit < BENCH_NQA_BITS; bit++)
+                strcpy (bmeta->bitmap_description[bit], bench_qa_bits[bit]);
+        }
+        bmeta->nlines = cls->nlines;
+        bmeta->nsamps = cls->nsamps;
+        snprintf (bmeta->short_name, sizeof (bmeta->short_name), "%s%s",
+            cls->product, bmeta->name);
+        snprintf (bmeta->long_name, sizeof (bmeta->long_name), "%s %s",
+            cls->product, bmeta->name);
+        snprintf (bmeta->file_name, sizeof (bmeta->file_name), "%s_%s.img",
+            gmeta->product_id, bmeta->name);
+        bmeta->pixel_size[0] = bmeta->pixel_size[1] = cls->pixel_size;
+        strcpy (bmeta->pixel_units, "meters");
+        strcpy (bmeta->app_version, "bench_metadata");
+        strcpy (bmeta->production_date, gmeta->level1_production_date);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  copy_xml_file
+
+PURPOSE:  Copies an XML file of the corpus to the work directory.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error reading or writing the XML file
+SUCCESS         Successfully copied the XML file
+
+NOTES:
+******************************************************************************/
+static int copy_xml_file
+(
+    const char *in_file,          /* I: XML file of the corpus */
+    const char *out_file          /* I: copy in the work directory */
+)
+{
+    char buf[65536];              /* current block of the file */
+    ssize_t nread;                /* bytes read into buf */
+    int in_fd, out_fd;            /* input and output files */
+    int status = SUCCESS;         /* return status */
+
+    in_fd = open (in_file, O_RDONLY);
+    if (in_fd < 0)
+        return (ERROR);
+    out_fd = open (out_file, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (out_fd < 0)
+    {
+        close (in_fd);
+        return (ERROR);
+    }
+
+    while ((nread = read (in_fd, buf, sizeof (buf))) > 0)
+    {
+        if (write (out_fd, buf, nread) != nread)
+        {
+            status = ERROR;
+            break;
+        }
+    }
+    if (nread < 0 || close (out_fd) != 0)
+        status = ERROR;
+    close (in_fd);
+
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  is_xml_entry
+
+PURPOSE:  Selects the XML files of a directory listing.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+0               The entry isn't an XML file
+1               The entry is an XML file
+
+NOTES:
+******************************************************************************/
+static int is_xml_entry
+(
+    const struct dirent *entry    /* I: entry of the directory */
+)
+{
+    size_t len = strlen (entry->d_name);  /* length of the name */
+
+    return (len > 4 && !strcmp (&entry->d_name[len - 4], ".xml"));
+}
+
+
+/******************************************************************************
+MODULE:  create_corpus
+
+PURPOSE:  Creates the corpus in the work directory, either by copying the XML
+files of the corpus directory or by writing the synthetic products.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error creating the corpus
+SUCCESS         Successfully created the corpus
+
+NOTES:
+  1. The XML files of the corpus directory which the document tree engine
+     can't parse are skipped with a warning.
+  2. The caller is responsible for freeing the documents.
+******************************************************************************/
+static int create_corpus
+(
+    const char *corpus_dir,       /* I: directory of the corpus; NULL for the
+                                        synthetic corpus */
+    Bench_doc_t **docs,           /* O: documents of the corpus */
+    int *ndocs                    /* O: number of documents */
+)
+{
+    char FUNC_NAME[] = "create_corpus";  /* function name */
+    char errmsg[STR_SIZE];        /* error message */
+    char in_file[STR_SIZE];       /* XML file of the corpus directory */
+    int i;                        /* looping variable */
+    int nentries;                 /* number of XML files in the directory */
+    struct dirent **entries = NULL;  /* XML files in the directory */
+    struct stat statbuf;          /* status of the copied XML file */
+    Bench_doc_t *doc = NULL;      /* current document */
+    Espa_internal_meta_t xml_metadata;  /* metadata of the current file */
+
+    set_engine (BENCH_DOM);
+    *ndocs = 0;
+    if (corpus_dir == NULL)
+        nentries = BENCH_NCLASSES;
+    else
+    {
+        nentries = scandir (corpus_dir, &entries, is_xml_entry, alphasort);
+        if (nentries <= 0)
+        {
+            sprintf (errmsg, "No XML files were found in %s", corpus_dir);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+    }
+
+    *docs = calloc (nentries, sizeof (Bench_doc_t));
+    if (*docs == NULL)
+    {
+        sprintf (errmsg, "Allocating memory for the corpus");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    for (i = 0; i < nentries; i++)
+    {
+        doc = &(*docs)[*ndocs];
+        snprintf (doc->xml_file, sizeof (doc->xml_file), "%s_%03d.xml",
+            BENCH_CORPUS_PREFIX, i);
+        init_metadata_struct (&xml_metadata);
+        if (corpus_dir == NULL)
+        {
+            strcpy (doc->source, bench_classes[i].name);
+            if (create_class_metadata (&bench_classes[i], &xml_metadata)
+                != SUCCESS ||
+                write_metadata (&xml_metadata, doc->xml_file) != SUCCESS)
+            {
+                sprintf (errmsg, "Writing the %s product", doc->source);
+                error_handler (true, FUNC_NAME, errmsg);
+                return (ERROR);
+            }
+        }
+        else
+        {
+            snprintf (in_file, sizeof (in_file), "%s/%s", corpus_dir,
+                entries[i]->d_name);
+            snprintf (doc->source, sizeof (doc->source), "%s",
+                entries[i]->d_name);
+            free (entries[i]);
+            if (copy_xml_file (in_file, doc->xml_file) != SUCCESS)
+            {
+                sprintf (errmsg, "Copying %s to the work directory",
+                    in_file);
+                error_handler (true, FUNC_NAME, errmsg);
+                return (ERROR);
+            }
+            if (parse_metadata (doc->xml_file, &xml_metadata) != SUCCESS)
+            {
+                sprintf (errmsg, "Skipping %s, which can't be parsed",
+                    in_file);
+                error_handler (false, FUNC_NAME, errmsg);
+                free_metadata (&xml_metadata);
+                unlink (doc->xml_file);
+                continue;
+            }
+        }
+        free_metadata (&xml_metadata);
+
+        if (stat (doc->xml_file, &statbuf) != 0)
+        {
+            sprintf (errmsg, "Getting the size of %s", doc->xml_file);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+        doc->nbytes = statbuf.st_size;
+        (*ndocs)++;
+    }
+    free (entries);
+
+    if (*ndocs == 0)
+    {
+        sprintf (errmsg, "None of the XML files of %s can be parsed",
+            corpus_dir);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  remove_xml_file
+
+PURPOSE:  Removes an XML file along with its metadata cache.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+static void remove_xml_file
+(
+    const char *xml_file          /* I: XML file to be removed */
+)
+{
+    char cache_file[STR_SIZE];    /* metadata cache of the XML file */
+
+    snprintf (cache_file, sizeof (cache_file), "%s%s", xml_file,
+        ESPA_META_CACHE_EXT);
+    unlink (xml_file);
+    unlink (cache_file);
+}
+
+
+/******************************************************************************
+MODULE:  run_op
+
+PURPOSE:  Runs an operation of the metadata layer on one document.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           The operation failed
+SUCCESS         The operation succeeded
+
+NOTES:
+  1. The parsed metadata, band names, and appended band of the document are
+     prepared by replay_corpus for the operations which need them.
+******************************************************************************/
+static int run_op
+(
+    Bench_op_t op,                /* I: operation to be run */
+    Bench_doc_t *doc,             /* I: document of the corpus */
+    Espa_internal_meta_t *xml_metadata, /* I: parsed metadata of the
+                                        document */
+    int nnames,                   /* I: number of bands in the subset */
+    char names[][STR_SIZE],       /* I: names of the bands in the subset */
+    Espa_band_meta_t *append_band /* I: band to be appended */
+)
+{
+    int status;                   /* return status */
+    Espa_internal_meta_t parsed;  /* metadata parsed by the operation */
+
+    switch (op)
+    {
+        case BENCH_VALIDATE:
+            return (validate_xml_file (doc->xml_file));
+
+        case BENCH_PARSE:
+        case BENCH_VALIDATE_PARSE:
+            init_metadata_struct (&parsed);
+            if (op == BENCH_PARSE)
+                status = parse_metadata (doc->xml_file, &parsed);
+            else
+                status = validate_and_parse_metadata (doc->xml_file,
+                    &parsed);
+            free_metadata (&parsed);
+            return (status);
+
+        case BENCH_WRITE:
+            return (write_metadata (xml_metadata, BENCH_SCRATCH_XML));
+
+        case BENCH_SUBSET:
+            return (subset_xml_by_band (doc->xml_file, BENCH_SUBSET_XML,
+                nnames, names));
+
+        case BENCH_APPEND:
+            return (append_metadata (1, append_band, BENCH_SCRATCH_XML));
+
+        default:
+            return (ERROR);
+    }
+}
+
+
+/******************************************************************************
+MODULE:  replay_corpus
+
+PURPOSE:  Times the runs of an operation over the corpus with an engine, in
+the process of the benchmark.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error preparing the corpus or running the operation
+SUCCESS         Successfully timed the runs
+
+NOTES:
+  1. With the binary metadata cache, the caches of the documents are
+     written first.  A run over the corpus is made before the timed runs,
+     so they all start from the same state of the caches.
+  2. Before each append, the scratch XML file is rewritten from the parsed
+     metadata, outside of the timing.
+******************************************************************************/
+static int replay_corpus
+(
+    Bench_op_t op,                /* I: operation to be timed */
+    Bench_engine_t engine,        /* I: metadata engine */
+    Bench_doc_t *docs,            /* I: documents of the corpus */
+    int ndocs,                    /* I: number of documents */
+    int repeat,                   /* I: number of timed runs */
+    double *seconds,              /* O: seconds taken by each run */
+    Bench_child_t *child          /* O: allocations and base memory */
+)
+{
+    char FUNC_NAME[] = "replay_corpus";  /* function name */
+    char errmsg[STR_SIZE];        /* error message */
+    char (*names)[STR_SIZE] = NULL;  /* names of the bands in the subset */
+    int d, r, i;                  /* looping variables */
+    int nnames;                   /* number of bands in the subset */
+    int max_bands = 1;            /* most bands in a document */
+    uint64_t nallocs = 0;         /* allocations in the timed runs */
+    uint64_t start_allocs;        /* allocations before the current call */
+    bool needs_meta = op == BENCH_WRITE || op == BENCH_SUBSET ||
+        op == BENCH_APPEND;       /* does the operation need the parsed
+                                     metadata? */
+    struct timespec start, end;   /* start and end of the current call */
+    struct rusage usage;          /* resource usage of the process */
+    Espa_internal_meta_t *metas = NULL;  /* parsed metadata of each
+                                     document */
+    Espa_band_meta_t append_band; /* band appended to the current document */
+
+    set_engine (engine);
+    if (engine == BENCH_SIDECAR)
+    {
+        for (d = 0; d < ndocs; d++)
+        {
+            if (refresh_metadata_cache (docs[d].xml_file) != SUCCESS)
+            {
+                sprintf (errmsg, "Writing the metadata cache of %s",
+                    docs[d].xml_file);
+                error_handler (true, FUNC_NAME, errmsg);
+                return (ERROR);
+            }
+        }
+    }
+
+    /* Parse the documents for the operations writing them */
+    if (needs_meta)
+    {
+        metas = calloc (ndocs, sizeof (Espa_internal_meta_t));
+        if (metas == NULL)
+        {
+            sprintf (errmsg, "Allocating memory for the parsed metadata");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+        for (d = 0; d < ndocs; d++)
+        {
+            init_metadata_struct (&metas[d]);
+            if (parse_metadata (docs[d].xml_file, &metas[d]) != SUCCESS)
+            {
+                sprintf (errmsg, "Parsing %s", docs[d].xml_file);
+                error_handler (true, FUNC_NAME, errmsg);
+                return (ERROR);
+            }
+        }
+    }
+
+    /* The first half of the bands (or the only band) of each document are
+       subset */
+    if (needs_meta)
+    {
+        for (d = 0; d < ndocs; d++)
+        {
+            if (metas[d].nbands > max_bands)
+                max_bands = metas[d].nbands;
+        }
+        names = calloc (max_bands, STR_SIZE);
+        if (names == NULL)
+        {
+            sprintf (errmsg, "Allocating memory for the band names");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+    }
+
+    /* Make a run before the timed runs */
+    for (r = -1; r < repeat; r++)
+    {
+        if (r >= 0)
+            seconds[r] = 0.0;
+        for (d = 0; d < ndocs; d++)
+        {
+            nnames = 0;
+            if (needs_meta)
+            {
+                nnames = (metas[d].nbands + 1) / 2;
+                for (i = 0; i < nnames; i++)
+                    strcpy (names[i], metas[d].band[i].name);
+                append_band = metas[d].band[0];
+                strcpy (append_band.name, BENCH_APPEND_BAND);
+            }
+            if (op == BENCH_APPEND && write_metadata (&metas[d],
+                BENCH_SCRATCH_XML) != SUCCESS)
+            {
+                sprintf (errmsg, "Rewriting %s", BENCH_SCRATCH_XML);
+                error_handler (true, FUNC_NAME, errmsg);
+                return (ERROR);
+            }
+
+            start_allocs = BENCH_NALLOCS ();
+            clock_gettime (CLOCK_MONOTONIC, &start);
+            if (run_op (op, &docs[d], needs_meta ? &metas[d] : NULL, nnames,
+                names, &append_band) != SUCCESS)
+            {
+                sprintf (errmsg, "Running %s on %s (%s)",
+                    bench_ops[op].benchmark, docs[d].xml_file,
+                    docs[d].source);
+                error_handler (true, FUNC_NAME, errmsg);
+                return (ERROR);
+            }
+            clock_gettime (CLOCK_MONOTONIC, &end);
+            if (r < 0)
+                continue;
+            nallocs += BENCH_NALLOCS () - start_allocs;
+            seconds[r] += (end.tv_sec - start.tv_sec) +
+                (end.tv_nsec - start.tv_nsec) * 1.0e-9;
+        }
+
+        /* The memory before the timed runs, once the first run has loaded
+           the schema and the caches */
+        if (r < 0)
+        {
+            getrusage (RUSAGE_SELF, &usage);
+            child->base_rss_kb = usage.ru_maxrss;
+        }
+    }
+    child->allocs_per_doc = (double) nallocs / ((double) repeat * ndocs);
+
+    /* The process exits next, so the parsed metadata isn't freed */
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  time_benchmark
+
+PURPOSE:  Times an operation over the corpus with an engine, in a process of
+its own, and writes the results as a line of JSON.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error starting the process of the benchmark
+SUCCESS         The benchmark was timed, or failed and was reported as such
+
+NOTES:
+  1. The throughput is based on the fastest run, and the peak memory is
+     that of the process of the benchmark.
+******************************************************************************/
+static int time_benchmark
+(
+    FILE *fptr,                   /* I: results file */
+    Bench_op_t op,                /* I: operation to be timed */
+    Bench_engine_t engine,        /* I: metadata engine */
+    Bench_doc_t *docs,            /* I: documents of the corpus */
+    int ndocs,                    /* I: number of documents */
+    int repeat,                   /* I: number of timed runs */
+    double *seconds               /* I: buffer for the seconds taken by each
+                                        run (repeat entries) */
+)
+{
+    char FUNC_NAME[] = "time_benchmark";  /* function name */
+    char errmsg[STR_SIZE];        /* error message */
+    char allocs[STR_SIZE];        /* allocations per document, as JSON */
+    int pipe_fd[2];               /* results sent back by the process */
+    int wstatus;                  /* exit status of the process */
+    int i;                        /* looping variable */
+    bool ok;                      /* did every run succeed? */
+    double nbytes = 0.0;          /* bytes of the XML files */
+    double min = 0.0;             /* fastest run */
+    double sum = 0.0;             /* total of the runs */
+    pid_t pid;                    /* process of the benchmark */
+    struct rusage usage;          /* resource usage of the process */
+    Bench_child_t child;          /* results of the process */
+
+    if (pipe (pipe_fd) != 0)
+    {
+        sprintf (errmsg, "Creating the pipe for the results");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    fflush (NULL);
+    pid = fork ();
+    if (pid < 0)
+    {
+        sprintf (errmsg, "Starting the process of the benchmark");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    if (pid == 0)
+    {
+        close (pipe_fd[0]);
+        memset (&child, 0, sizeof (child));
+        child.status = replay_corpus (op, engine, docs, ndocs, repeat,
+            seconds, &child);
+        if (write (pipe_fd[1], &child, sizeof (child)) != sizeof (child) ||
+            write (pipe_fd[1], seconds, repeat * sizeof (double)) !=
+            (ssize_t) (repeat * sizeof (double)))
+            _exit (EXIT_FAILURE);
+        _exit (EXIT_SUCCESS);
+    }
+
+    close (pipe_fd[1]);
+    ok = read (pipe_fd[0], &child, sizeof (child)) == sizeof (child) &&
+        read (pipe_fd[0], seconds, repeat * sizeof (double)) ==
+        (ssize_t) (repeat * sizeof (double));
+    close (pipe_fd[0]);
+    if (wait4 (pid, &wstatus, 0, &usage) != pid)
+    {
+        sprintf (errmsg, "Waiting for the process of the benchmark");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    ok = ok && child.status == SUCCESS && WIFEXITED (wstatus) &&
+        WEXITSTATUS (wstatus) == EXIT_SUCCESS;
+
+    if (ok)
+    {
+        min = seconds[0];
+        for (i = 0; i < repeat; i++)
+        {
+            if (seconds[i] < min)
+                min = seconds[i];
+            sum += seconds[i];
+        }
+    }
+    for (i = 0; i < ndocs; i++)
+        nbytes += docs[i].nbytes;
+    if (ok && BENCH_COUNT_ALLOCS)
+        snprintf (allocs, sizeof (allocs), "%.1f", child.allocs_per_doc);
+    else
+        strcpy (allocs, "null");
+
+    fprintf (fptr, "{\"benchmark\": \"%s\", \"engine\": \"%s\", "
+        "\"version\": \"%s\", \"status\": \"%s\", \"ndocs\": %d, "
+        "\"mb\": %.3f, \"repeat\": %d, \"min_seconds\": %.6f, "
+        "\"mean_seconds\": %.6f, \"docs_per_second\": %.1f, "
+        "\"mb_per_second\": %.3f, \"allocs_per_doc\": %s, "
+        "\"base_rss_mb\": %.1f, \"peak_rss_mb\": %.1f}\n",
+        bench_ops[op].benchmark, bench_engine_names[engine],
+        ESPA_COMMON_VERSION, ok ? "ok" : "failed", ndocs,
+        nbytes / (1024.0 * 1024.0), ok ? repeat : 0, min,
+        ok ? sum / repeat : 0.0, min > 0.0 ? ndocs / min : 0.0,
+        min > 0.0 ? nbytes / min / (1024.0 * 1024.0) : 0.0, allocs,
+        ok ? child.base_rss_kb / 1024.0 : 0.0, usage.ru_maxrss / 1024.0);
+    fflush (fptr);
+
+    printf ("  %-28s %-8s %-7s %10.1f docs/s %10s allocs/doc %7.1f MB "
+        "peak RSS\n", bench_ops[op].benchmark, bench_engine_names[engine],
+        ok ? "ok" : "failed", min > 0.0 ? ndocs / min : 0.0, allocs,
+        usage.ru_maxrss / 1024.0);
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  main
+
+PURPOSE:  Creates the corpus, times each operation of the metadata layer
+over it with each engine, and writes the results to the results file.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error running the benchmarks
+SUCCESS         No errors encountered
+
+NOTES:
+******************************************************************************/
+int main (int argc, char** argv)
+{
+    char FUNC_NAME[] = "bench_metadata";  /* function name */
+    char errmsg[STR_SIZE];             /* error message */
+    char *corpus_dir = NULL;           /* directory of the corpus */
+    char *work_dir = NULL;             /* directory of the copies */
+    char *output_file = NULL;          /* name of the results file */
+    char *corpus_path = NULL;          /* absolute corpus directory */
+    int repeat;                        /* number of timed runs */
+    int ndocs;                         /* number of documents */
+    int op, engine, d;                 /* looping variables */
+    double *seconds = NULL;            /* seconds taken by each run */
+    FILE *fptr = NULL;                 /* pointer to the results file */
+    Bench_doc_t *docs = NULL;          /* documents of the corpus */
+
+    printf ("bench_metadata version: %s\n", ESPA_COMMON_VERSION);
+
+    /* Read the command-line arguments */
+    if (get_args (argc, argv, &corpus_dir, &repeat, &work_dir, &output_file)
+        != SUCCESS)
+    {   /* get_args already printed the error message */
+        exit (EXIT_FAILURE);
+    }
+
+    /* The corpus directory is relative to where the benchmark was started */
+    if (corpus_dir != NULL &&
+        (corpus_path = realpath (corpus_dir, NULL)) == NULL)
+    {
+        sprintf (errmsg, "Finding the corpus directory: %s", corpus_dir);
+        error_handler (true, FUNC_NAME, errmsg);
+        exit (EXIT_FAILURE);
+    }
+
+    /* Open the results file before moving to the work directory, so a
+       relative name is relative to where the benchmark was started */
+    fptr = fopen (output_file, "w");
+    seconds = calloc (repeat, sizeof (double));
+    if (fptr == NULL || seconds == NULL)
+    {
+        sprintf (errmsg, "Opening the results file: %s", output_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        exit (EXIT_FAILURE);
+    }
+    if (work_dir != NULL && chdir (work_dir) != 0)
+    {
+        sprintf (errmsg, "Changing to the work directory: %s", work_dir);
+        error_handler (true, FUNC_NAME, errmsg);
+        exit (EXIT_FAILURE);
+    }
+
+    if (create_corpus (corpus_path, &docs, &ndocs) != SUCCESS)
+    {  /* Error messages already written */
+        exit (EXIT_FAILURE);
+    }
+    printf ("Corpus of %d documents:", ndocs);
+    for (d = 0; d < ndocs; d++)
+        printf (" %s", docs[d].source);
+    printf ("\n");
+
+    for (op = 0; op < BENCH_NOPS; op++)
+    {
+        for (engine = 0; engine < BENCH_NENGINES; engine++)
+        {
+            if (!(bench_ops[op].engines & BENCH_ENGINE (engine)))
+                continue;
+            if (time_benchmark (fptr, op, engine, docs, ndocs, repeat,
+                seconds) != SUCCESS)
+            {  /* Error messages already written */
+                exit (EXIT_FAILURE);
+            }
+        }
+    }
+
+    /* Remove the copies, the outputs, and their caches */
+    for (d = 0; d < ndocs; d++)
+        remove_xml_file (docs[d].xml_file);
+    remove_xml_file (BENCH_SCRATCH_XML);
+    remove_xml_file (BENCH_SUBSET_XML);
+
+    if (fclose (fptr) != 0)
+    {
+        sprintf (errmsg, "Closing the results file: %s", output_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        exit (EXIT_FAILURE);
+    }
+    printf ("INFO: results were written to %s\n", output_file);
+
+    /* Free the pointers */
+    free (docs);
+    free (seconds);
+    free (corpus_dir);
+    free (corpus_path);
+    free (work_dir);
+    free (output_file);
+
+    /* Successful completion */
+    exit (EXIT_SUCCESS);
+}
@@ -0,0 +1,1173 @@
+/*****************************************************************************
+FILE: bench_projections
+
+PURPOSE: Times the forward and inverse transformations of GCTP3 and of
+ias_geo_transform_coordinate(s) over dense grids of points in each of a set
+of projections, with each transformation engine, and writes the throughput
+and the error of each engine against the scalar reference as
+machine-readable results which can be tracked across releases.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The engines are gctp_transform one point at a time (scalar, the
+     reference), gctp_transform_array (batched, which runs the array
+     transforms of the projections having them in chunks), the
+     ias_geo_transform_coordinate and ias_geo_transform_coordinates wrappers
+     (ias_scalar and ias_batched), and the bilinear interpolation of a
+     coarse grid of exactly transformed nodes (grid), as in the interpolated
+     transformation of the land/water mask.  An engine is added to
+     bench_engines, and is then timed and checked against the reference
+     like the others.
+  2. The results record the widest instruction set of the SIMD kernels of
+     the libraries, so runs with ESPA_SIMD set can be compared.  The
+     projection transforms themselves have no SIMD kernels yet, so the
+     engines all run the same instructions whatever ESPA_SIMD is.
+  3. The forward transformation maps a regular grid of points over a box of
+     longitudes and latitudes suited to the projection (ex. a UTM zone).
+     The inverse transformation maps a regular grid over the box of
+     projection coordinates bounding that box.
+  4. The errors are the distances on the ground, in meters, from the points
+     of the reference; the longitude and latitude errors of the inverse are
+     converted with BENCH_METERS_PER_DEGREE.  The error of the grid engine
+     grows with the size of its cells, which span grid_step points of the
+     grid of --size, so its errors are only comparable at the same size and
+     step.
+  5. The projection parameters are given as GCTP expects them, with the
+     angles packed as DDDMMMSSS.SS.
+*****************************************************************************/
+#include <getopt.h>
+#include <math.h>
+#include <time.h>
+#include <stdint.h>
+#include <string.h>
+#include "error_handler.h"
+#include "espa_cpu_dispatch.h"
+#include "gctp_defines.h"
+#include "ias_lw_geo.h"
+#include "gctp.h"
+
+/* Defines */
+#define BENCH_DEFAULT_SIZE "1000x1000"
+#define BENCH_DEFAULT_REPEAT 3
+#define BENCH_DEFAULT_GRID_STEP 16  /* node spacing of the interpolation
+                                       grid, as INTERP_GRID_SIZE of the
+                                       land/water mask */
+#define BENCH_DEFAULT_OUTPUT "bench_projections.jsonl"
+#define BENCH_BOX_EDGE_POINTS 256   /* points along each edge of the box of
+                                       longitudes and latitudes when finding
+                                       the box of projection coordinates */
+#define BENCH_METERS_PER_DEGREE 111320.0  /* meters in a degree of latitude,
+                                       or of longitude at the equator */
+
+/* Transformation engines */
+typedef enum {
+  BENCH_SCALAR,         /* gctp_transform for each point; the reference */
+  BENCH_BATCHED,        /* gctp_transform_array */
+  BENCH_IAS_SCALAR,     /* ias_geo_transform_coordinate for each point */
+  BENCH_IAS_BATCHED,    /* ias_geo_transform_coordinates */
+  BENCH_GRID,           /* interpolation of a grid of exact transforms */
+  BENCH_NENGINES
+} Bench_engine_t;
+
+static const char *bench_engines[BENCH_NENGINES] =
+    {"scalar", "batched", "ias_scalar", "ias_batched", "grid"};
+
+/* Directions of the transformation */
+typedef enum {
+  BENCH_FORWARD,        /* longitude and latitude to projection */
+  BENCH_INVERSE,        /* projection to longitude and latitude */
+  BENCH_NDIRECTIONS
+} Bench_direction_t;
+
+static const char *bench_directions[BENCH_NDIRECTIONS] =
+    {"forward", "inverse"};
+
+/* Projection of the benchmark */
+typedef struct
+{
+    const char *name;            /* name of the projection in the results */
+    int proj_code;               /* GCTP projection code */
+    int zone;                    /* zone of the projection (UTM) */
+    int spheroid;                /* GCTP spheroid; -1 for the sphere of
+                                    parameters[0] */
+    double parameters[GCTP_PROJECTION_PARAMETER_COUNT];  /* GCTP projection
+                                    parameters */
+    double west, east;           /* longitudes of the box of points
+                                    (degrees) */
+    double south, north;         /* latitudes of the box of points
+                                    (degrees) */
+} Bench_proj_t;
+
+static const Bench_proj_t bench_projs[] =
+{
+    /* Landsat scenes of zone 13 */
+    {"utm", UTM, 13, GCTP_WGS84, {0},
+     -108.0, -102.0, 30.0, 45.0},
+    /* Landsat Antarctic polar stereographic */
+    {"ps_south", PS, 0, GCTP_WGS84,
+     {[4] = 0.0, [5] = -71000000.0},
+     -60.0, 60.0, -85.0, -60.0},
+    /* Greenland polar stereographic */
+    {"ps_north", PS, 0, GCTP_WGS84,
+     {[4] = -45000000.0, [5] = 70000000.0},
+     -90.0, 0.0, 60.0, 85.0},
+    /* CONUS Albers of the Landsat ARD */
+    {"albers", ALBERS, 0, GCTP_GRS80,
+     {[2] = 29030000.0, [3] = 45030000.0, [4] = -96000000.0,
+      [5] = 23000000.0},
+     -125.0, -66.0, 24.0, 50.0},
+    /* MODIS sinusoidal */
+    {"sin", SNSOID, 0, -1,
+     {[0] = 6371007.181},
+     -20.0, 20.0, 30.0, 50.0},
+    {"tm", TM, 0, GCTP_WGS84,
+     {[2] = 0.9999, [4] = -100000000.0},
+     -103.0, -97.0, 35.0, 45.0},
+    {"lamcc", LAMCC, 0, GCTP_WGS84,
+     {[2] = 33000000.0, [3] = 45000000.0, [4] = -97000000.0,
+      [5] = 40000000.0},
+     -120.0, -75.0, 25.0, 50.0},
+    {"lamaz", LAMAZ, 0, -1,
+     {[0] = 6370997.0, [4] = -100000000.0, [5] = 45000000.0},
+     -120.0, -80.0, 30.0, 60.0},
+    {"mercator", MERCAT, 0, GCTP_WGS84,
+     {0},
+     -30.0, 30.0, -60.0, 60.0},
+    {"eqrect", EQRECT, 0, GCTP_WGS84,
+     {0},
+     -30.0, 30.0, -60.0, 60.0}
+};
+#define BENCH_NPROJS \
+    (int) (sizeof (bench_projs) / sizeof (bench_projs[0]))
+
+/* Grid of points of one projection and direction, with the transformations
+   of each engine */
+typedef struct
+{
+    Bench_direction_t direction; /* direction of the transformation */
+    const GCTP_TRANSFORMATION *gctp;  /* GCTP3 transformation */
+    const IAS_GEO_PROJ_TRANSFORMATION *ias;  /* IAS transformation */
+    int nlines;                  /* number of lines of points */
+    int nsamps;                  /* number of points per line */
+    double x0, y0;               /* input coordinates of the first point */
+    double dx, dy;               /* input spacing of the samples and
+                                    lines */
+    double *in_x, *in_y;         /* input coordinates of the points */
+    int grid_step;               /* node spacing of the interpolation grid,
+                                    in points */
+    int node_rows;               /* number of rows of nodes */
+    int node_cols;               /* number of columns of nodes */
+    double *node_in;             /* input x and y of the nodes */
+    double *node_out;            /* output x and y of the nodes */
+} Bench_grid_t;
+
+
+/******************************************************************************
+MODULE: usage
+
+PURPOSE: Prints the usage information for this application.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+void usage ()
+{
+    int i;                        /* looping variable */
+
+    printf ("bench_projections times the forward and inverse projection "
+            "transformations of GCTP3 and ias_geo_transform_coordinate(s) "
+            "over dense grids of points, with the scalar, batched, and "
+            "grid-interpolated engines, and measures the error of each "
+            "engine against the scalar reference.  The results are written "
+            "as one JSON object per line.\n");
+    printf ("version: %s\n\n", ESPA_COMMON_VERSION);
+    printf ("usage: bench_projections [--projections=name,...] "
+            "[--size=nlines x nsamps] [--grid_step=points] "
+            "[--repeat=number_of_runs] [--output=results_filename]\n");
+
+    printf ("\nwhere the following parameters are optional:\n");
+    printf ("    -projections: comma-separated list of the projections "
+            "(default is all of them:");
+    for (i = 0; i < BENCH_NPROJS; i++)
+        printf ("%s%s", i > 0 ? ", " : " ", bench_projs[i].name);
+    printf (")\n");
+    printf ("    -size: points of the grid of each projection and "
+            "direction, as LINESxSAMPS (default is %s)\n",
+            BENCH_DEFAULT_SIZE);
+    printf ("    -grid_step: spacing of the nodes of the interpolation "
+            "grid, in points (default is %d)\n", BENCH_DEFAULT_GRID_STEP);
+    printf ("    -repeat: number of timed runs of each engine; the minimum "
+            "and mean are reported (default is %d)\n",
+            BENCH_DEFAULT_REPEAT);
+    printf ("    -output: name of the results file (default is %s)\n",
+            BENCH_DEFAULT_OUTPUT);
+    printf ("\nThe projections without their own GCTP3 transforms report "
+            "their parameters when they are set up; set IAS_LOG_LEVEL=WARN "
+            "to leave the reports out.\n");
+    printf ("\nExample: bench_projections --projections=utm,albers,sin "
+            "--size=2000x2000\n");
+}
+
+
+/******************************************************************************
+MODULE:  find_projection
+
+PURPOSE:  Finds a projection of the benchmark by name.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+-1              There is no projection of that name
+index           Index of the projection in bench_projs
+
+NOTES:
+******************************************************************************/
+static int find_projection
+(
+    const char *name,     /* I: name of the projection */
+    size_t len            /* I: length of the name */
+)
+{
+    int i;                /* looping variable */
+
+    for (i = 0; i < BENCH_NPROJS; i++)
+    {
+        if (strlen (bench_projs[i].name) == len &&
+            strncmp (bench_projs[i].name, name, len) == 0)
+            return (i);
+    }
+
+    return (-1);
+}
+
+
+/******************************************************************************
+MODULE:  get_args
+
+PURPOSE:  Gets the command-line arguments and validates them.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error getting the command-line arguments or a command-line
+                argument and associated value were not valid
+SUCCESS         No errors encountered
+
+NOTES:
+  1. Memory is allocated for the output file.  This should be a character
+     pointer set to NULL on input.  The caller is responsible for freeing
+     the allocated memory upon successful return.
+******************************************************************************/
+short get_args
+(
+    int argc,             /* I: number of cmd-line args */
+    char *argv[],         /* I: string of cmd-line args */
+    bool *selected,       /* O: is each projection benchmarked?
+                                BENCH_NPROJS flags */
+    int *nlines,          /* O: number of lines of points */
+    int *nsamps,          /* O: number of points per line */
+    int *grid_step,       /* O: node spacing of the interpolation grid */
+    int *repeat,          /* O: number of timed runs of each engine */
+    char **output_file    /* O: address of the results filename */
+)
+{
+    int c;                           /* current argument index */
+    int option_index;                /* index for the command-line option */
+    int i;                           /* looping variable */
+    int proj;                        /* index of a listed projection */
+    char extra;                      /* character after the size */
+    const char *cptr = NULL;         /* current name in the list */
+    const char *end = NULL;          /* end of the current name */
+    char errmsg[STR_SIZE];           /* error message */
+    char FUNC_NAME[] = "get_args";   /* function name */
+    static struct option long_options[] =
+    {
+        {"projections", required_argument, 0, 'p'},
+        {"size", required_argument, 0, 's'},
+        {"grid_step", required_argument, 0, 'g'},
+        {"repeat", required_argument, 0, 'r'},
+        {"output", required_argument, 0, 'o'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    for (i = 0; i < BENCH_NPROJS; i++)
+        selected[i] = true;
+    sscanf (BENCH_DEFAULT_SIZE, "%dx%d", nlines, nsamps);
+    *grid_step = BENCH_DEFAULT_GRID_STEP;
+    *repeat = BENCH_DEFAULT_REPEAT;
+
+    /* Loop through all the cmd-line options */
+    opterr = 0;   /* turn off getopt_long error msgs as we'll print our own */
+    while (1)
+    {
+        /* optstring in call to getopt_long is empty since we will only
+           support the long options */
+        c = getopt_long (argc, argv, "", long_options, &option_index);
+        if (c == -1)
+        {   /* Out of cmd-line options */
+            break;
+        }
+
+        switch (c)
+        {
+            case 'h':  /* help */
+                usage ();
+                return (ERROR);
+                break;
+
+            case 'p':  /* projections */
+                for (i = 0; i < BENCH_NPROJS; i++)
+                    selected[i] = false;
+                for (cptr = optarg; ; cptr = end + 1)
+                {
+                    end = strchr (cptr, ',');
+                    if (end == NULL)
+                        end = cptr + strlen (cptr);
+                    proj = find_projection (cptr, end - cptr);
+                    if (proj < 0)
+                    {
+                        sprintf (errmsg, "Unknown projection in: %s",
+                            optarg);
+                        error_handler (true, FUNC_NAME, errmsg);
+                        usage ();
+                        return (ERROR);
+                    }
+                    selected[proj] = true;
+                    if (*end == '\0')
+                        break;
+                }
+                break;
+
+            case 's':  /* size of the grids */
+                if (sscanf (optarg, "%dx%d%c", nlines, nsamps, &extra) != 2
+                    || *nlines < 2 || *nsamps < 2 ||
+                    (double) *nlines * *nsamps > INT32_MAX)
+                {
+                    sprintf (errmsg, "Invalid size: %s", optarg);
+                    error_handler (true, FUNC_NAME, errmsg);
+                    usage ();
+                    return (ERROR);
+                }
+                break;
+
+            case 'g':  /* node spacing of the interpolation grid */
+                *grid_step = atoi (optarg);
+                if (*grid_step < 1)
+                {
+                    sprintf (errmsg, "Invalid grid step: %s", optarg);
+                    error_handler (true, FUNC_NAME, errmsg);
+                    usage ();
+                    return (ERROR);
+                }
+                break;
+
+            case 'r':  /* number of timed runs */
+                *repeat = atoi (optarg);
+                if (*repeat < 1)
+                {
+                    sprintf (errmsg, "Invalid number of runs: %s", optarg);
+                    error_handler (true, FUNC_NAME, errmsg);
+                    usage ();
+                    return (ERROR);
+                }
+                break;
+
+            case 'o':  /* results file */
+                free (*output_file);
+                *output_file = strdup (optarg);
+                break;
+
+            case '?':
+            default:
+                sprintf (errmsg, "Unknown option %s", argv[optind-1]);
+                error_handler (true, FUNC_NAME, errmsg);
+                usage ();
+                return (ERROR);
+                break;
+        }
+    }
+
+    if (*output_file == NULL)
+        *output_file = strdup (BENCH_DEFAULT_OUTPUT);
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  elapsed_seconds
+
+PURPOSE:  Returns the seconds elapsed since the specified time.
+
+RETURN VALUE:
+Type = double
+Value           Description
+-----           -----------
+>= 0            Wall-clock seconds elapsed since start
+
+NOTES:
+******************************************************************************/
+static double elapsed_seconds
+(
+    const struct timespec *start  /* I: starting time */
+)
+{
+    struct timespec now;          /* current time */
+
+    clock_gettime (CLOCK_MONOTONIC, &now);
+    return ((now.tv_sec - start->tv_sec) +
+        (now.tv_nsec - start->tv_nsec) * 1.0e-9);
+}
+
+
+/******************************************************************************
+MODULE:  set_projections
+
+PURPOSE:  Sets up the geographic projection and the projection of the
+benchmark, for both GCTP3 and the IAS library.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+static void set_projections
+(
+    const Bench_proj_t *bproj,    /* I: projection of the benchmark */
+    GCTP_PROJECTION *gctp_geo,    /* O: GCTP3 geographic projection */
+    GCTP_PROJECTION *gctp_proj,   /* O: GCTP3 projection */
+    IAS_PROJECTION *ias_geo,      /* O: IAS geographic projection */
+    IAS_PROJECTION *ias_proj      /* O: IAS projection */
+)
+{
+    int i;                        /* looping variable */
+    double geo_parms[GCTP_PROJECTION_PARAMETER_COUNT] = {0};  /* parameters
+                                     of the geographic projection */
+
+    memset (gctp_geo, 0, sizeof (*gctp_geo));
+    gctp_geo->proj_code = GEO;
+    gctp_geo->zone = NULLZONE;
+    gctp_geo->units = DEGREE;
+    gctp_geo->spheroid = bproj->spheroid;
+
+    gctp_proj->proj_code = bproj->proj_code;
+    gctp_proj->zone = bproj->zone;
+    gctp_proj->units = METER;
+    gctp_proj->spheroid = bproj->spheroid;
+    for (i = 0; i < GCTP_PROJECTION_PARAMETER_COUNT; i++)
+    {
+        gctp_proj->parameters[i] = bproj->parameters[i];
+        gctp_geo->parameters[i] = (i < 2) ? bproj->parameters[i] : 0.0;
+        geo_parms[i] = gctp_geo->parameters[i];
+    }
+
+    ias_geo_set_projection (GEO, NULLZONE, DEGREE, bproj->spheroid,
+        geo_parms, ias_geo);
+    ias_geo_set_projection (bproj->proj_code, bproj->zone, METER,
+        bproj->spheroid, bproj->parameters, ias_proj);
+}
+
+
+/******************************************************************************
+MODULE:  find_projected_box
+
+PURPOSE:  Finds the box of projection coordinates bounding the box of
+longitudes and latitudes of a projection.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           A point of the edges of the box couldn't be transformed
+SUCCESS         Successfully found the box
+
+NOTES:
+  1. The edges are followed rather than just the corners, since the edges
+     of the box are curved in most projections.
+******************************************************************************/
+static int find_projected_box
+(
+    const Bench_proj_t *bproj,    /* I: projection of the benchmark */
+    const GCTP_TRANSFORMATION *forward,  /* I: forward transformation */
+    double *min_x, double *max_x, /* O: projection x range */
+    double *min_y, double *max_y  /* O: projection y range */
+)
+{
+    char FUNC_NAME[] = "find_projected_box";  /* function name */
+    char errmsg[STR_SIZE];        /* error message */
+    int edge, i;                  /* looping variables */
+    double t;                     /* fraction along the edge */
+    double in[2];                 /* longitude and latitude of the point */
+    double out[2];                /* projection x and y of the point */
+
+    *min_x = *min_y = HUGE_VAL;
+    *max_x = *max_y = -HUGE_VAL;
+    for (edge = 0; edge < 4; edge++)
+    {
+        for (i = 0; i <= BENCH_BOX_EDGE_POINTS; i++)
+        {
+            t = (double) i / BENCH_BOX_EDGE_POINTS;
+            in[0] = (edge < 2) ? bproj->west + t * (bproj->east - bproj->west)
+                : (edge == 2 ? bproj->west : bproj->east);
+            in[1] = (edge >= 2) ? bproj->south + t * (bproj->north
+                - bproj->south) : (edge == 0 ? bproj->south : bproj->north);
+            if (gctp_transform (forward, in, out) != GCTP_SUCCESS)
+            {
+                sprintf (errmsg, "Transforming %g, %g to the %s projection",
+                    in[0], in[1], bproj->name);
+                error_handler (true, FUNC_NAME, errmsg);
+                return (ERROR);
+            }
+            if (out[0] < *min_x)
+                *min_x = out[0];
+            if (out[0] > *max_x)
+                *max_x = out[0];
+            if (out[1] < *min_y)
+                *min_y = out[1];
+            if (out[1] > *max_y)
+                *max_y = out[1];
+        }
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  init_grid
+
+PURPOSE:  Sets up the regular grid of input points of a direction, and the
+nodes of its interpolation grid.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error allocating the grid
+SUCCESS         Successfully set up the grid
+
+NOTES:
+  1. The first line of points is the northern (or top) edge of the box.
+  2. The nodes lie every grid_step lines and samples, and the last row and
+     column of nodes may lie past the box, so every point is inside a cell.
+******************************************************************************/
+static int init_grid
+(
+    Bench_direction_t direction,  /* I: direction of the transformation */
+    double west, double east,     /* I: x range of the input box */
+    double south, double north,   /* I: y range of the input box */
+    int nlines,                   /* I: number of lines of points */
+    int nsamps,                   /* I: number of points per line */
+    int grid_step,                /* I: node spacing of the interpolation
+                                        grid */
+    Bench_grid_t *grid            /* I/O: grid; the transformations are
+                                          set by the caller */
+)
+{
+    char FUNC_NAME[] = "init_grid";   /* function name */
+    char errmsg[STR_SIZE];        /* error message */
+    int line, samp;               /* looping variables */
+    size_t npoints = (size_t) nlines * nsamps;  /* number of points */
+    size_t nnodes;                /* number of nodes */
+
+    grid->direction = direction;
+    grid->nlines = nlines;
+    grid->nsamps = nsamps;
+    grid->x0 = west;
+    grid->y0 = north;
+    grid->dx = (east - west) / (nsamps - 1);
+    grid->dy = -(north - south) / (nlines - 1);
+    grid->grid_step = grid_step;
+    grid->node_rows = (nlines - 1) / grid_step + 2;
+    grid->node_cols = (nsamps - 1) / grid_step + 2;
+    nnodes = (size_t) grid->node_rows * grid->node_cols;
+
+    grid->in_x = malloc (npoints * sizeof (double));
+    grid->in_y = malloc (npoints * sizeof (double));
+    grid->node_in = malloc (2 * nnodes * sizeof (double));
+    grid->node_out = malloc (2 * nnodes * sizeof (double));
+    if (grid->in_x == NULL || grid->in_y == NULL || grid->node_in == NULL ||
+        grid->node_out == NULL)
+    {
+        sprintf (errmsg, "Allocating the grid of %dx%d points", nlines,
+            nsamps);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    for (line = 0; line < nlines; line++)
+    {
+        for (samp = 0; samp < nsamps; samp++)
+        {
+            grid->in_x[(size_t) line * nsamps + samp] =
+                grid->x0 + samp * grid->dx;
+            grid->in_y[(size_t) line * nsamps + samp] =
+                grid->y0 + line * grid->dy;
+        }
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  free_grid
+
+PURPOSE:  Frees the points and nodes of a grid.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+static void free_grid
+(
+    Bench_grid_t *grid            /* I/O: grid */
+)
+{
+    free (grid->in_x);
+    free (grid->in_y);
+    free (grid->node_in);
+    free (grid->node_out);
+    grid->in_x = grid->in_y = grid->node_in = grid->node_out = NULL;
+}
+
+
+/******************************************************************************
+MODULE:  interpolate_grid
+
+PURPOSE:  Transforms the points of a grid by transforming the nodes of its
+interpolation grid exactly and interpolating the points bilinearly from the
+corners of their cells.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           A node couldn't be transformed
+SUCCESS         Successfully transformed the points
+
+NOTES:
+  1. Unlike the land/water mask, the cells aren't checked against the exact
+     transformation first, so the error is that of the interpolation alone.
+******************************************************************************/
+static int interpolate_grid
+(
+    Bench_grid_t *grid,           /* I/O: grid of points */
+    double *out_x,                /* O: output x of the points */
+    double *out_y                 /* O: output y of the points */
+)
+{
+    int row, col;                 /* looping variables for the nodes */
+    int line, samp;               /* looping variables for the points */
+    int step = grid->grid_step;   /* node spacing */
+    int ncols = grid->node_cols;  /* number of columns of nodes */
+    int nnodes = grid->node_rows * ncols;  /* number of nodes */
+    double line_frac, samp_frac;  /* position of the point in its cell */
+    double top, bottom;           /* interpolated along the cell edges */
+    const double *ul, *ur, *ll, *lr;  /* output of the cell corners */
+    size_t index;                 /* index of the point */
+
+    for (row = 0; row < grid->node_rows; row++)
+    {
+        for (col = 0; col < ncols; col++)
+        {
+            grid->node_in[row * ncols + col] =
+                grid->x0 + (double) col * step * grid->dx;
+            grid->node_in[nnodes + row * ncols + col] =
+                grid->y0 + (double) row * step * grid->dy;
+        }
+    }
+    if (gctp_transform_array (grid->gctp, nnodes, grid->node_in,
+        &grid->node_in[nnodes], grid->node_out, &grid->node_out[nnodes])
+        != GCTP_SUCCESS)
+        return (ERROR);
+
+    for (line = 0; line < grid->nlines; line++)
+    {
+        row = line / step;
+        line_frac = (double) (line - row * step) / step;
+        for (samp = 0; samp < grid->nsamps; samp++)
+        {
+            col = samp / step;
+            samp_frac = (double) (samp - col * step) / step;
+            ul = &grid->node_out[row * ncols + col];
+            ur = ul + 1;
+            ll = ul + ncols;
+            lr = ll + 1;
+            index = (size_t) line * grid->nsamps + samp;
+
+            top = ul[0] + samp_frac * (ur[0] - ul[0]);
+            bottom = ll[0] + samp_frac * (lr[0] - ll[0]);
+            out_x[index] = top + line_frac * (bottom - top);
+            top = ul[nnodes] + samp_frac * (ur[nnodes] - ul[nnodes]);
+            bottom = ll[nnodes] + samp_frac * (lr[nnodes] - ll[nnodes]);
+            out_y[index] = top + line_frac * (bottom - top);
+        }
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  run_engine
+
+PURPOSE:  Transforms the points of a grid with an engine.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           A point couldn't be transformed
+SUCCESS         Successfully transformed the points
+
+NOTES:
+******************************************************************************/
+static int run_engine
+(
+    Bench_grid_t *grid,           /* I/O: grid of points */
+    Bench_engine_t engine,        /* I: transformation engine */
+    double *out_x,                /* O: output x of the points */
+    double *out_y                 /* O: output y of the points */
+)
+{
+    int npoints = grid->nlines * grid->nsamps;  /* number of points */
+    int i;                        /* looping variable */
+    double in[2];                 /* input coordinates of a point */
+    double out[2];                /* output coordinates of a point */
+
+    switch (engine)
+    {
+        case BENCH_SCALAR:
+            for (i = 0; i < npoints; i++)
+            {
+                in[0] = grid->in_x[i];
+                in[1] = grid->in_y[i];
+                if (gctp_transform (grid->gctp, in, out) != GCTP_SUCCESS)
+                    return (ERROR);
+                out_x[i] = out[0];
+                out_y[i] = out[1];
+            }
+            return (SUCCESS);
+
+        case BENCH_BATCHED:
+            return (gctp_transform_array (grid->gctp, npoints, grid->in_x,
+                grid->in_y, out_x, out_y) == GCTP_SUCCESS ? SUCCESS : ERROR);
+
+        case BENCH_IAS_SCALAR:
+            for (i = 0; i < npoints; i++)
+            {
+                if (ias_geo_transform_coordinate (grid->ias, grid->in_x[i],
+                    grid->in_y[i], &out_x[i], &out_y[i]) != SUCCESS)
+                    return (ERROR);
+            }
+            return (SUCCESS);
+
+        case BENCH_IAS_BATCHED:
+            return (ias_geo_transform_coordinates (grid->ias, npoints,
+                grid->in_x, grid->in_y, out_x, out_y));
+
+        case BENCH_GRID:
+            return (interpolate_grid (grid, out_x, out_y));
+
+        default:
+            return (ERROR);
+    }
+}
+
+
+/******************************************************************************
+MODULE:  compute_errors
+
+PURPOSE:  Computes the largest and RMS distances on the ground between the
+points transformed by an engine and those of the reference.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. The longitude differences of the inverse are wrapped to +/-180
+     degrees, and scaled by the cosine of the latitude.
+******************************************************************************/
+static void compute_errors
+(
+    Bench_direction_t direction,  /* I: direction of the transformation */
+    int npoints,                  /* I: number of points */
+    const double *ref_x,          /* I: x of the reference */
+    const double *ref_y,          /* I: y of the reference */
+    const double *out_x,          /* I: x of the engine */
+    const double *out_y,          /* I: y of the engine */
+    double *max_error,            /* O: largest error (meters) */
+    double *rms_error             /* O: RMS error (meters) */
+)
+{
+    int i;                        /* looping variable */
+    double dx, dy;                /* differences of the point (meters) */
+    double dist2;                 /* squared error of the point */
+    double sum2 = 0.0;            /* sum of the squared errors */
+    double max2 = 0.0;            /* largest squared error */
+
+    for (i = 0; i < npoints; i++)
+    {
+        dx = out_x[i] - ref_x[i];
+        dy = out_y[i] - ref_y[i];
+        if (direction == BENCH_INVERSE)
+        {
+            if (dx > 180.0)
+                dx -= 360.0;
+            else if (dx < -180.0)
+                dx += 360.0;
+            dx *= BENCH_METERS_PER_DEGREE * cos (ref_y[i] * M_PI / 180.0);
+            dy *= BENCH_METERS_PER_DEGREE;
+        }
+        dist2 = dx * dx + dy * dy;
+        sum2 += dist2;
+        if (dist2 > max2)
+            max2 = dist2;
+    }
+
+    *max_error = sqrt (max2);
+    *rms_error = sqrt (sum2 / npoints);
+}
+
+
+/******************************************************************************
+MODULE:  write_result
+
+PURPOSE:  Writes the timing and errors of one engine as a line of JSON.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. The throughput is based on the fastest run.
+******************************************************************************/
+static void write_result
+(
+    FILE *fptr,                   /* I: results file */
+    const char *projection,       /* I: name of the projection */
+    Bench_direction_t direction,  /* I: direction of the transformation */
+    Bench_engine_t engine,        /* I: transformation engine */
+    int npoints,                  /* I: number of points */
+    int grid_step,                /* I: node spacing of the interpolation
+                                        grid */
+    int repeat,                   /* I: number of timed runs */
+    const double *seconds,        /* I: seconds taken by each run */
+    double max_error,             /* I: largest error (meters) */
+    double rms_error              /* I: RMS error (meters) */
+)
+{
+    int i;                        /* looping variable */
+    double min = seconds[0];      /* fastest run */
+    double sum = 0.0;             /* total of the runs */
+
+    for (i = 0; i < repeat; i++)
+    {
+        if (seconds[i] < min)
+            min = seconds[i];
+        sum += seconds[i];
+    }
+
+    fprintf (fptr, "{\"benchmark\": \"projection_transform\", "
+        "\"version\": \"%s\", \"projection\": \"%s\", \"direction\": \"%s\", "
+        "\"engine\": \"%s\", \"npoints\": %d, \"simd\": \"%s\", ",
+        ESPA_COMMON_VERSION, projection, bench_directions[direction],
+        bench_engines[engine], npoints, espa_cpu_simd_name ());
+    if (engine == BENCH_GRID)
+        fprintf (fptr, "\"grid_step\": %d, ", grid_step);
+    fprintf (fptr, "\"repeat\": %d, \"min_seconds\": %.6f, "
+        "\"mean_seconds\": %.6f, \"mpoints_per_second\": %.3f, "
+        "\"max_error_meters\": %.6g, \"rms_error_meters\": %.6g}\n",
+        repeat, min, sum / repeat,
+        min > 0.0 ? npoints / min * 1.0e-6 : 0.0, max_error, rms_error);
+    fflush (fptr);
+}
+
+
+/******************************************************************************
+MODULE:  bench_grid
+
+PURPOSE:  Times each engine over the points of a grid, and writes its
+throughput and its errors against the reference.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error allocating the outputs, or the reference failed
+SUCCESS         Successfully timed the engines
+
+NOTES:
+  1. An engine other than the reference which fails is reported and
+     skipped, so the others are still timed.
+******************************************************************************/
+static int bench_grid
+(
+    FILE *fptr,                   /* I: results file */
+    const char *projection,       /* I: name of the projection */
+    Bench_grid_t *grid,           /* I/O: grid of points */
+    int repeat,                   /* I: number of timed runs */
+    double *seconds               /* I/O: seconds taken by each run */
+)
+{
+    char FUNC_NAME[] = "bench_grid";  /* function name */
+    char errmsg[STR_SIZE];        /* error message */
+    int npoints = grid->nlines * grid->nsamps;  /* number of points */
+    int engine, run;              /* looping variables */
+    int status = SUCCESS;         /* status of the engine */
+    double min_seconds;           /* fastest run */
+    double max_error, rms_error;  /* errors against the reference */
+    double *ref_x = NULL;         /* x of the reference */
+    double *ref_y = NULL;         /* y of the reference */
+    double *out_x = NULL;         /* x of the engine */
+    double *out_y = NULL;         /* y of the engine */
+    struct timespec start;        /* start of the current run */
+
+    ref_x = malloc (npoints * sizeof (double));
+    ref_y = malloc (npoints * sizeof (double));
+    out_x = malloc (npoints * sizeof (double));
+    out_y = malloc (npoints * sizeof (double));
+    if (ref_x == NULL || ref_y == NULL || out_x == NULL || out_y == NULL)
+    {
+        sprintf (errmsg, "Allocating the outputs of %d points", npoints);
+        error_handler (true, FUNC_NAME, errmsg);
+        status = ERROR;
+    }
+
+    for (engine = 0; engine < BENCH_NENGINES && status == SUCCESS; engine++)
+    {
+        for (run = 0; run < repeat; run++)
+        {
+            clock_gettime (CLOCK_MONOTONIC, &start);
+            if (run_engine (grid, engine,
+                engine == BENCH_SCALAR ? ref_x : out_x,
+                engine == BENCH_SCALAR ? ref_y : out_y) != SUCCESS)
+                break;
+            seconds[run] = elapsed_seconds (&start);
+        }
+        if (run < repeat)
+        {
+            sprintf (errmsg, "The %s engine failed on the %s %s grid",
+                bench_engines[engine], projection,
+                bench_directions[grid->direction]);
+            if (engine == BENCH_SCALAR)
+            {
+                error_handler (true, FUNC_NAME, errmsg);
+                status = ERROR;
+            }
+            else
+                error_handler (false, FUNC_NAME, errmsg);
+            continue;
+        }
+
+        if (engine == BENCH_SCALAR)
+            max_error = rms_error = 0.0;
+        else
+            compute_errors (grid->direction, npoints, ref_x, ref_y, out_x,
+                out_y, &max_error, &rms_error);
+        write_result (fptr, projection, grid->direction, engine, npoints,
+            grid->grid_step, repeat, seconds, max_error, rms_error);
+        min_seconds = seconds[0];
+        for (run = 1; run < repeat; run++)
+            if (seconds[run] < min_seconds)
+                min_seconds = seconds[run];
+        printf ("%s %s %s: %.6f seconds, max error %.3g meters\n",
+            projection, bench_directions[grid->direction],
+            bench_engines[engine], min_seconds, max_error);
+    }
+
+    free (ref_x);
+    free (ref_y);
+    free (out_x);
+    free (out_y);
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  bench_projection
+
+PURPOSE:  Times the forward and inverse transformations of a projection.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error setting up or timing the transformations
+SUCCESS         Successfully timed the transformations
+
+NOTES:
+******************************************************************************/
+static int bench_projection
+(
+    FILE *fptr,                   /* I: results file */
+    const Bench_proj_t *bproj,    /* I: projection of the benchmark */
+    int nlines,                   /* I: number of lines of points */
+    int nsamps,                   /* I: number of points per line */
+    int grid_step,                /* I: node spacing of the interpolation
+                                        grid */
+    int repeat,                   /* I: number of timed runs */
+    double *seconds               /* I/O: seconds taken by each run */
+)
+{
+    char FUNC_NAME[] = "bench_projection";  /* function name */
+    char errmsg[STR_SIZE];        /* error message */
+    int status;                   /* status of the benchmarks */
+    double min_x, max_x;          /* projection x range of the box */
+    double min_y, max_y;          /* projection y range of the box */
+    GCTP_PROJECTION gctp_geo;     /* GCTP3 geographic projection */
+    GCTP_PROJECTION gctp_proj;    /* GCTP3 projection */
+    IAS_PROJECTION ias_geo;       /* IAS geographic projection */
+    IAS_PROJECTION ias_proj;      /* IAS projection */
+    GCTP_TRANSFORMATION *gctp_forward = NULL;  /* GCTP3 forward */
+    GCTP_TRANSFORMATION *gctp_inverse = NULL;  /* GCTP3 inverse */
+    IAS_GEO_PROJ_TRANSFORMATION *ias_forward = NULL;  /* IAS forward */
+    IAS_GEO_PROJ_TRANSFORMATION *ias_inverse = NULL;  /* IAS inverse */
+    Bench_grid_t grid;            /* grid of points */
+
+    memset (&grid, 0, sizeof (grid));
+    set_projections (bproj, &gctp_geo, &gctp_proj, &ias_geo, &ias_proj);
+    gctp_forward = gctp_create_transformation (&gctp_geo, &gctp_proj);
+    gctp_inverse = gctp_create_transformation (&gctp_proj, &gctp_geo);
+    ias_forward = ias_geo_create_proj_transformation (&ias_geo, &ias_proj);
+    ias_inverse = ias_geo_create_proj_transformation (&ias_proj, &ias_geo);
+    if (gctp_forward == NULL || gctp_inverse == NULL ||
+        ias_forward == NULL || ias_inverse == NULL)
+    {
+        sprintf (errmsg, "Creating the transformations of the %s "
+            "projection", bproj->name);
+        error_handler (true, FUNC_NAME, errmsg);
+        status = ERROR;
+    }
+    else
+    {
+        /* Forward, over the box of longitudes and latitudes */
+        grid.gctp = gctp_forward;
+        grid.ias = ias_forward;
+        status = init_grid (BENCH_FORWARD, bproj->west, bproj->east,
+            bproj->south, bproj->north, nlines, nsamps, grid_step, &grid);
+        if (status == SUCCESS)
+            status = bench_grid (fptr, bproj->name, &grid, repeat, seconds);
+        free_grid (&grid);
+    }
+
+    /* Inverse, over the box of projection coordinates bounding it */
+    if (status == SUCCESS)
+        status = find_projected_box (bproj, gctp_forward, &min_x, &max_x,
+            &min_y, &max_y);
+    if (status == SUCCESS)
+    {
+        grid.gctp = gctp_inverse;
+        grid.ias = ias_inverse;
+        status = init_grid (BENCH_INVERSE, min_x, max_x, min_y, max_y,
+            nlines, nsamps, grid_step, &grid);
+        if (status == SUCCESS)
+            status = bench_grid (fptr, bproj->name, &grid, repeat, seconds);
+        free_grid (&grid);
+    }
+
+    if (gctp_forward != NULL)
+        gctp_destroy_transformation (gctp_forward);
+    if (gctp_inverse != NULL)
+        gctp_destroy_transformation (gctp_inverse);
+    if (ias_forward != NULL)
+        ias_geo_destroy_proj_transformation (ias_forward);
+    if (ias_inverse != NULL)
+        ias_geo_destroy_proj_transformation (ias_inverse);
+
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  main
+
+PURPOSE:  Times the transformations of each selected projection, and writes
+the timings and errors to the results file.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error running the benchmarks
+SUCCESS         No errors encountered
+
+NOTES:
+  1. A projection which fails is reported, and the others are still
+     benchmarked; the exit status is then a failure.
+******************************************************************************/
+int main (int argc, char** argv)
+{
+    char FUNC_NAME[] = "bench_projections";  /* function name */
+    char errmsg[STR_SIZE];             /* error message */
+    char *output_file = NULL;          /* name of the results file */
+    bool selected[BENCH_NPROJS];       /* is each projection benchmarked? */
+    int nlines, nsamps;                /* size of the grids */
+    int grid_step;                     /* node spacing of the interpolation
+                                          grid */
+    int repeat;                        /* number of timed runs */
+    int i;                             /* looping variable */
+    int nfailed = 0;                   /* number of failed projections */
+    double *seconds = NULL;            /* seconds taken by each run */
+    FILE *fptr = NULL;                 /* pointer to the results file */
+
+    printf ("bench_projections version: %s\n", ESPA_COMMON_VERSION);
+
+    /* Read the command-line arguments */
+    if (get_args (argc, argv, selected, &nlines, &nsamps, &grid_step,
+        &repeat, &output_file) != SUCCESS)
+    {   /* get_args already printed the error message */
+        exit (EXIT_FAILURE);
+    }
+
+    fptr = fopen (output_file, "w");
+    seconds = calloc (repeat, sizeof (double));
+    if (fptr == NULL || seconds == NULL)
+    {
+        sprintf (errmsg, "Opening the results file: %s", output_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        exit (EXIT_FAILURE);
+    }
+
+    for (i = 0; i < BENCH_NPROJS; i++)
+    {
+        if (!selected[i])
+            continue;
+        if (bench_projection (fptr, &bench_projs[i], nlines, nsamps,
+            grid_step, repeat, seconds) != SUCCESS)
+        {
+            sprintf (errmsg, "Benchmarking the %s projection",
+                bench_projs[i].name);
+            error_handler (true, FUNC_NAME, errmsg);
+            nfailed++;
+        }
+    }
+
+    if (fclose (fptr) != 0)
+    {
+        sprintf (errmsg, "Closing the results file: %s", output_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        exit (EXIT_FAILURE);
+    }
+    printf ("INFO: results were written to %s\n", output_file);
+
+    /* Free the pointers */
+    free (seconds);
+    free (output_file);
+
+    if (nfailed > 0)
+        exit (EXIT_FAILURE);
+
+    /* Successful completion */
+    exit (EXIT_SUCCESS);
+}
@@ -0,0 +1,323 @@
+/*****************************************************************************
+FILE: build_espa_datacube
+
+PURPOSE: Contains functions for stacking ESPA raw binary products on the
+same grid into a time-series datacube, as a Zarr store.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The XML metadata format parsed or written via this library follows the
+     ESPA internal metadata format found in ESPA Raw Binary Format v1.0.doc.
+     The schema for the ESPA internal metadata format is available at
+     http://espa.cr.usgs.gov/schema/espa_internal_metadata_v1_0.xsd.
+*****************************************************************************/
+#include <getopt.h>
+#include "espa_task_pool.h"
+#include "convert_espa_to_zarr.h"
+
+/******************************************************************************
+MODULE: usage
+
+PURPOSE: Prints the usage information for this application.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+void usage ()
+{
+    printf ("build_espa_datacube stacks ESPA internal format products (raw "
+            "binary and associated XML metadata files) on the same grid "
+            "into a Zarr (version 2) datacube, with a chunked and "
+            "compressed (time, y, x) array per band and a time array of "
+            "the acquisition times.  The date bands are folded into the "
+            "time array.\n");
+    printf ("version: %s\n\n", ESPA_COMMON_VERSION);
+    printf ("usage: build_espa_datacube "
+            "--xml=input_metadata_filename (multiple --xml options can be "
+            "specified) "
+            "--zarr=output_zarr_directory "
+            "[--time_chunk=dates] "
+            "[--chunk_lines=lines] [--chunk_samps=samples] "
+            "[--compressor=none|zlib|zstd] [--level=level] "
+            "[--physical_units] [--threads=number_of_threads]\n");
+
+    printf ("\nwhere the following parameters are required:\n");
+    printf ("    -xml: name of an input XML metadata file which follows "
+            "the ESPA internal raw binary schema; XML files may also be "
+            "listed after the options.  Every product must be on the grid "
+            "of the others, with the same bands.\n");
+    printf ("    -zarr: directory of the output Zarr store\n");
+    printf ("\nand where the following parameters are optional:\n");
+    printf ("    -time_chunk: number of dates in each chunk of the band "
+            "arrays, from 1 to %d; the bands of the dates of a chunk are "
+            "read at the same time (the default is %d)\n",
+            ZARR_MAX_CUBE_TIME_CHUNK, DEFAULT_ZARR_CUBE_TIME_CHUNK);
+    printf ("    -chunk_lines: number of lines in each chunk of the band "
+            "arrays (the default is %d)\n", DEFAULT_ZARR_CHUNK_LINES);
+    printf ("    -chunk_samps: number of samples in each chunk of the band "
+            "arrays; 0 for full lines (the default is %d)\n",
+            DEFAULT_ZARR_CHUNK_SAMPS);
+    printf ("    -compressor: compressor of the chunks (the default is zstd "
+            "when it is available, otherwise zlib)\n");
+    printf ("    -level: compression level (the default is %d for zlib and "
+            "%d for zstd)\n", DEFAULT_ZARR_ZLIB_LEVEL,
+            DEFAULT_ZARR_ZSTD_LEVEL);
+    printf ("    -physical_units: if specified the bands with a scale "
+            "factor or add offset are written as float32 physical values "
+            "with NaN fill (the default is the packed pixels)\n");
+    printf ("    -threads: number of threads compressing the chunks "
+            "(default is the cap of the task pool)\n");
+    printf ("\nExample: build_espa_datacube "
+            "--zarr=LC08_022033_2021.zarr "
+            "LC08_L2SP_022033_2021*.xml\n");
+}
+
+
+/******************************************************************************
+MODULE:  get_args
+
+PURPOSE:  Gets the command-line arguments and validates that the required
+arguments were specified.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error getting the command-line arguments or a command-line
+                argument and associated value were not specified
+SUCCESS         No errors encountered
+
+NOTES:
+  1. Memory is allocated for the input files and the output directory.  The
+     caller is responsible for freeing the allocated memory upon successful
+     return.
+******************************************************************************/
+short get_args
+(
+    int argc,              /* I: number of cmd-line args */
+    char *argv[],          /* I: string of cmd-line args */
+    char **xml_files,      /* O: names of the XML files; holds argc */
+    int *nfiles,           /* O: number of XML files */
+    char **zarr_outdir,    /* O: address of output Zarr directory */
+    int *time_chunk,       /* O: number of dates per chunk */
+    Zarr_options_t *options  /* O: chunking and compression of the bands */
+)
+{
+    int c;                           /* current argument index */
+    int option_index;                /* index for the command-line option */
+    char errmsg[STR_SIZE];           /* error message */
+    char FUNC_NAME[] = "get_args";   /* function name */
+    static int physical_flag = 0;    /* flag for physical units */
+    static struct option long_options[] =
+    {
+        {"physical_units", no_argument, &physical_flag, 1},
+        {"xml", required_argument, 0, 'i'},
+        {"zarr", required_argument, 0, 'o'},
+        {"time_chunk", required_argument, 0, 't'},
+        {"chunk_lines", required_argument, 0, 'l'},
+        {"chunk_samps", required_argument, 0, 's'},
+        {"compressor", required_argument, 0, 'c'},
+        {"level", required_argument, 0, 'v'},
+        {"threads", required_argument, 0, 'n'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    /* Loop through all the cmd-line options */
+    opterr = 0;   /* turn off getopt_long error msgs as we'll print our own */
+    while (1)
+    {
+        /* optstring in call to getopt_long is empty since we will only
+           support the long options */
+        c = getopt_long (argc, argv, "", long_options, &option_index);
+        if (c == -1)
+        {   /* Out of cmd-line options */
+            break;
+        }
+
+        switch (c)
+        {
+            case 0:
+                /* If this option set a flag, do nothing else now. */
+                if (long_options[option_index].flag != 0)
+                    break;
+
+            case 'h':  /* help */
+                usage ();
+                return (ERROR);
+                break;
+
+            case 'i':  /* XML infile */
+                xml_files[(*nfiles)++] = strdup (optarg);
+                break;
+
+            case 'o':  /* Zarr output directory */
+                free (*zarr_outdir);
+                *zarr_outdir = strdup (optarg);
+                break;
+
+            case 't':  /* dates per chunk */
+                *time_chunk = atoi (optarg);
+                break;
+
+            case 'l':  /* lines per chunk */
+                options->chunk_lines = atoi (optarg);
+                break;
+
+            case 's':  /* samples per chunk */
+                options->chunk_samps = atoi (optarg);
+                break;
+
+            case 'c':  /* compressor */
+                if (parse_zarr_compressor (optarg, &options->compressor)
+                    != SUCCESS)
+                {  /* Error message already written */
+                    usage ();
+                    return (ERROR);
+                }
+                break;
+
+            case 'v':  /* compression level */
+                options->level = atoi (optarg);
+                break;
+
+            case 'n':  /* number of threads */
+                espa_task_pool_set_threads (atoi (optarg));
+                break;
+
+            case '?':
+            default:
+                sprintf (errmsg, "Unknown option %s", argv[optind-1]);
+                error_handler (true, FUNC_NAME, errmsg);
+                usage ();
+                return (ERROR);
+                break;
+        }
+    }
+
+    /* The remaining arguments are XML files as well */
+    for ( ; optind < argc; optind++)
+        xml_files[(*nfiles)++] = strdup (argv[optind]);
+
+    /* Make sure the infiles and outfiles were specified */
+    if (*nfiles == 0)
+    {
+        sprintf (errmsg, "At least one XML input file is a required "
+            "argument");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    if (*zarr_outdir == NULL)
+    {
+        sprintf (errmsg, "Zarr output directory is a required argument");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    /* Make sure the chunking values are valid */
+    if (*time_chunk < 1 || *time_chunk > ZARR_MAX_CUBE_TIME_CHUNK)
+    {
+        sprintf (errmsg, "Number of dates per chunk must be from 1 to %d",
+            ZARR_MAX_CUBE_TIME_CHUNK);
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    if (options->chunk_lines < 1)
+    {
+        sprintf (errmsg, "Number of lines per chunk must be positive");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    if (options->chunk_samps < 0)
+    {
+        sprintf (errmsg, "Number of samples per chunk must not be negative");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    /* Check the physical units flag */
+    if (physical_flag)
+        options->physical_units = true;
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  main
+
+PURPOSE:  Stacks the ESPA internal format products into a Zarr datacube.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error building the datacube
+SUCCESS         No errors encountered
+
+NOTES:
+******************************************************************************/
+int main (int argc, char** argv)
+{
+    char **xml_files = NULL;     /* input XML filenames */
+    char *zarr_outdir = NULL;    /* output Zarr directory */
+    int nfiles = 0;              /* number of XML files */
+    int time_chunk = DEFAULT_ZARR_CUBE_TIME_CHUNK;  /* dates per chunk */
+    int status;                  /* return status */
+    int i;                       /* looping variable for the XML files */
+    Zarr_options_t options;      /* chunking and compression of the bands */
+
+    printf ("build_espa_datacube version: %s\n", ESPA_COMMON_VERSION);
+
+    /* Default chunking and compression of the bands */
+    options.chunk_lines = DEFAULT_ZARR_CHUNK_LINES;
+    options.chunk_samps = DEFAULT_ZARR_CHUNK_SAMPS;
+    options.compressor = DEFAULT_ZARR_COMPRESSOR;
+    options.level = 0;
+    options.physical_units = false;
+
+    /* Every argument could be an XML file */
+    xml_files = calloc (argc, sizeof (char *));
+    if (xml_files == NULL)
+    {
+        error_handler (true, "main", "Error allocating memory for the XML "
+            "filenames.");
+        exit (EXIT_FAILURE);
+    }
+
+    /* Read the command-line arguments */
+    if (get_args (argc, argv, xml_files, &nfiles, &zarr_outdir,
+        &time_chunk, &options) != SUCCESS)
+    {   /* get_args already printed the error message */
+        exit (EXIT_FAILURE);
+    }
+
+    /* Stack the products into the datacube */
+    status = convert_espa_to_zarr_cube (xml_files, nfiles, zarr_outdir,
+        time_chunk, &options);
+    if (status == SUCCESS)
+        printf ("Wrote the datacube of %d dates to %s\n", nfiles,
+            zarr_outdir);
+
+    /* Free the pointers */
+    for (i = 0; i < nfiles; i++)
+        free (xml_files[i]);
+    free (xml_files);
+    free (zarr_outdir);
+
+    exit (status == SUCCESS ? EXIT_SUCCESS : EXIT_FAILURE);
+}
@@ -0,0 +1,235 @@
+/*****************************************************************************
+FILE: build_espa_overviews
+
+PURPOSE: Contains functions for building the reduced resolution overviews of
+the raw binary bands of an ESPA product.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The XML metadata format parsed or written via this library follows the
+     ESPA internal metadata format found in ESPA Raw Binary Format v1.0.doc.
+     The schema for the ESPA internal metadata format is available at
+     http://espa.cr.usgs.gov/schema/espa_internal_metadata_vX_X.xsd.
+  2. The overview_file and overview_levels attributes of each band in the
+     XML record its overviews (see espa_overview.h).
+*****************************************************************************/
+#include <getopt.h>
+#include "parse_metadata.h"
+#include "write_metadata.h"
+#include "espa_overview.h"
+
+/******************************************************************************
+MODULE: usage
+
+PURPOSE: Prints the usage information for this application.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+void usage ()
+{
+    printf ("build_espa_overviews builds the overviews of the raw binary "
+            "bands of the ESPA internal format: copies of each band reduced "
+            "by 2x, 4x, 8x, and so on, stored in a sidecar file next to the "
+            "band.  The image bands are averaged and the QA bands keep the "
+            "nearest pixel.  The XML metadata file is updated with the "
+            "overview files.\n");
+    printf ("version: %s\n\n", ESPA_COMMON_VERSION);
+    printf ("usage: build_espa_overviews "
+            "--xml=input_metadata_filename "
+            "[--levels=number_of_levels]\n");
+
+    printf ("\nwhere the following parameters are required:\n");
+    printf ("    -xml: name of the input XML metadata file which follows "
+            "the ESPA internal raw binary schema\n");
+    printf ("\nwhere the following parameters are optional:\n");
+    printf ("    -levels: number of overview levels of each band, up to %d "
+            "(default is to reduce each band until its lines or samples "
+            "are no more than %d)\n", ESPA_OVERVIEW_MAX_LEVELS,
+            ESPA_OVERVIEW_MIN_SIZE);
+    printf ("\nExample: build_espa_overviews "
+            "--xml=LE07_L1TP_022033_20140228_20161028_02_T1.xml "
+            "--levels=4\n");
+}
+
+
+/******************************************************************************
+MODULE:  get_args
+
+PURPOSE:  Gets the command-line arguments and validates that the required
+arguments were specified.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error getting the command-line arguments or a command-line
+                argument and associated value were not specified
+SUCCESS         No errors encountered
+
+NOTES:
+  1. Memory is allocated for the input file.  This should be a character
+     pointer set to NULL on input.  The caller is responsible for freeing the
+     allocated memory upon successful return.
+******************************************************************************/
+short get_args
+(
+    int argc,              /* I: number of cmd-line args */
+    char *argv[],          /* I: string of cmd-line args */
+    char **xml_infile,     /* O: address of input XML filename */
+    int *nlevels           /* O: number of overview levels; 0 for the
+                                 default */
+)
+{
+    int c;                           /* current argument index */
+    int option_index;                /* index for the command-line option */
+    char errmsg[STR_SIZE];           /* error message */
+    char FUNC_NAME[] = "get_args";   /* function name */
+    static struct option long_options[] =
+    {
+        {"xml", required_argument, 0, 'i'},
+        {"levels", required_argument, 0, 'l'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    /* Loop through all the cmd-line options */
+    opterr = 0;   /* turn off getopt_long error msgs as we'll print our own */
+    while (1)
+    {
+        /* optstring in call to getopt_long is empty since we will only
+           support the long options */
+        c = getopt_long (argc, argv, "", long_options, &option_index);
+        if (c == -1)
+        {   /* Out of cmd-line options */
+            break;
+        }
+
+        switch (c)
+        {
+            case 0:
+                /* If this option set a flag, do nothing else now. */
+                if (long_options[option_index].flag != 0)
+                    break;
+
+            case 'h':  /* help */
+                usage ();
+                return (ERROR);
+                break;
+
+            case 'i':  /* XML infile */
+                *xml_infile = strdup (optarg);
+                break;
+
+            case 'l':  /* number of levels */
+                *nlevels = atoi (optarg);
+                if (*nlevels < 1 || *nlevels > ESPA_OVERVIEW_MAX_LEVELS)
+                {
+                    sprintf (errmsg, "Number of levels must be from 1 to %d",
+                        ESPA_OVERVIEW_MAX_LEVELS);
+                    error_handler (true, FUNC_NAME, errmsg);
+                    usage ();
+                    return (ERROR);
+                }
+                break;
+
+            case '?':
+            default:
+                sprintf (errmsg, "Unknown option %s", argv[optind-1]);
+                error_handler (true, FUNC_NAME, errmsg);
+                usage ();
+                return (ERROR);
+                break;
+        }
+    }
+
+    /* Make sure the infile was specified */
+    if (*xml_infile == NULL)
+    {
+        sprintf (errmsg, "XML input file is a required argument");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  main
+
+PURPOSE:  Builds the overviews of the bands of the ESPA product and updates
+the XML metadata file.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error building the overviews
+SUCCESS         No errors encountered
+
+NOTES:
+  1. The XML file is written even if a band fails, so it references the
+     overviews which were already built.
+******************************************************************************/
+int main (int argc, char** argv)
+{
+    char FUNC_NAME[] = "main";   /* function name */
+    char errmsg[STR_SIZE];       /* error message */
+    char *xml_infile = NULL;     /* input XML filename */
+    int i;                       /* looping variable for the bands */
+    int nlevels = 0;             /* number of overview levels */
+    int status = SUCCESS;        /* status of building the overviews */
+    Espa_internal_meta_t xml_metadata;  /* XML metadata structure */
+
+    printf ("build_espa_overviews version: %s\n", ESPA_COMMON_VERSION);
+
+    /* Read the command-line arguments */
+    if (get_args (argc, argv, &xml_infile, &nlevels) != SUCCESS)
+    {   /* get_args already printed the error message */
+        exit (EXIT_FAILURE);
+    }
+
+    /* Validate the metadata file and parse it into our internal metadata
+       structure */
+    init_metadata_struct (&xml_metadata);
+    if (validate_and_parse_metadata (xml_infile, &xml_metadata) != SUCCESS)
+    {  /* Error messages already written */
+        exit (EXIT_FAILURE);
+    }
+
+    /* Build the overviews of each band */
+    for (i = 0; i < xml_metadata.nbands; i++)
+    {
+        if (build_band_overviews (&xml_metadata, i, nlevels) != SUCCESS)
+        {
+            sprintf (errmsg, "Building the overviews of band %s",
+                xml_metadata.band[i].name);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+            break;
+        }
+    }
+
+    /* Write the metadata back out, which now references the overviews */
+    if (write_metadata (&xml_metadata, xml_infile) != SUCCESS)
+    {  /* Error messages already written */
+        exit (EXIT_FAILURE);
+    }
+    if (status != SUCCESS)
+        exit (EXIT_FAILURE);
+
+    /* Free the metadata structure and the pointers */
+    free_metadata (&xml_metadata);
+    free (xml_infile);
+
+    /* Successful completion */
+    exit (EXIT_SUCCESS);
+}
@@ -17,6 +17,8 @@ NOTES:
 *****************************************************************************/
 #include <getopt.h>
 #include "clip_band_misalignment.h"
+#include "write_metadata.h"
+#include "espa_task_pool.h"
 
 /******************************************************************************
 MODULE: usage
@@ -36,11 +38,16 @@ void usage ()
             "quality band is updated to appropriately flag the fill pixels "
             "after this band clipping.\n");
     printf ("version: %s\n\n", ESPA_COMMON_VERSION);
-    printf ("usage: clip_band_misalignment --xml=xml_filename\n");
+    printf ("usage: clip_band_misalignment --xml=xml_filename "
+            "[--threads=number_of_threads]\n");
 
     printf ("\nwhere the following parameters are required:\n");
     printf ("    -xml: name of the input XML metadata file which follows "
             "the ESPA internal raw binary schema\n");
+    printf ("\nwhere the following parameters are optional:\n");
+    printf ("    -threads: number of threads clipping the lines of the "
+            "bands, when built with ENABLE_THREADING (default is "
+            "ESPA_THREADS, or one per processor)\n");
     printf ("\nExample: clip_band_misalignment "
             "--xml=LE07_L1TP_022033_20140228_20161028_02_T1.xml\n");
 }
@@ -74,11 +81,13 @@ short get_args
 {
     int c;                           /* current argument index */
     int option_index;                /* index for the command-line option */
+    int nthreads;                    /* number of threads */
     char errmsg[STR_SIZE];           /* error message */
     char FUNC_NAME[] = "get_args";   /* function name */
     static struct option long_options[] =
     {
         {"xml", required_argument, 0, 'i'},
+        {"threads", required_argument, 0, 't'},
         {"help", no_argument, 0, 'h'},
         {0, 0, 0, 0}
     };
@@ -111,6 +120,25 @@ short get_args
                 *xml_infile = strdup (optarg);
                 break;
      
+            case 't':  /* number of threads of the task pool */
+                nthreads = atoi (optarg);
+                if (nthreads < 1)
+                {
+                    sprintf (errmsg, "Invalid number of threads: %s", optarg);
+                    error_handler (true, FUNC_NAME, errmsg);
+                    usage ();
+                    return (ERROR);
+                }
+#ifdef _OPENMP
+                espa_task_pool_set_threads (nthreads);
+#else
+                if (nthreads > 1)
+                    error_handler (false, FUNC_NAME, "Threading is not "
+                        "enabled in this build; a single thread will be "
+                        "used");
+#endif
+                break;
+
             case '?':
             default:
                 sprintf (errmsg, "Unknown option %s", argv[optind-1]);
@@ -149,6 +177,8 @@ ERROR           Error clipping the bands
 SUCCESS         No errors encountered
 
 NOTES:
+  1. The XML file is rewritten after the clipping, to reference the footprint
+     index of the clipped bands.
 ******************************************************************************/
 int main (int argc, char** argv)
 {
@@ -167,19 +197,13 @@ int main (int argc, char** argv)
         exit (EXIT_FAILURE);
     }
 
-    /* Validate the input metadata file */
-    if (validate_xml_file (xml_infile) != SUCCESS)
-    {  /* Error messages already written */
-        exit (EXIT_FAILURE);
-    }
-
     /* Initialize the metadata structure */
     init_metadata_struct (&xml_metadata);
 
-    /* Parse the metadata file into our internal metadata structure; also
-       allocates space as needed for various pointers in the global and band
-       metadata */
-    if (parse_metadata (xml_infile, &xml_metadata) != SUCCESS)
+    /* Validate the metadata file and parse it into our internal metadata
+       structure, reading the file only once; also allocates space as needed
+       for various pointers in the global and band metadata */
+    if (validate_and_parse_metadata (xml_infile, &xml_metadata) != SUCCESS)
     {  /* Error messages already written */
         exit (EXIT_FAILURE);
     }
@@ -205,6 +229,13 @@ int main (int argc, char** argv)
         }
     }
 
+    /* Write the metadata back out, which now references the footprint index
+       of the clipped bands */
+    if (write_metadata (&xml_metadata, xml_infile) != SUCCESS)
+    {  /* Error messages already written */
+        exit (EXIT_FAILURE);
+    }
+
     /* Free the metadata structure */
     free_metadata (&xml_metadata);
 
@@ -0,0 +1,266 @@
+/*****************************************************************************
+FILE: compile_land_mass_polygon
+
+PURPOSE: Contains functions for compiling the land-mass polygon file, used
+by create_land_water_mask, from source shapefiles.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The rings of the shapefiles are segmented, nested, and written along
+     with the spatial index and the levels of detail of the polygon file, as
+     described in land_mass_polygon.h.  The rings are segmented and nested
+     in parallel by the task pool, and the levels of detail are simplified
+     in parallel.
+  2. The shapefiles are expected to be in geographic coordinates, with the
+     longitude as x and the latitude as y.
+*****************************************************************************/
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include "espa_task_pool.h"
+#include "land_mass_polygon.h"
+
+/* Most shapefiles which can be compiled at once */
+#define MAX_SHAPEFILES 256
+
+
+/******************************************************************************
+MODULE: usage
+
+PURPOSE: Prints the usage information for this application.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+void usage ()
+{
+    printf ("compile_land_mass_polygon compiles the land-mass polygon file "
+            "used by create_land_water_mask from the polygons of ESRI "
+            "shapefiles.  The rings of the polygons are split into segments "
+            "for the point in polygon tests, nested by containment, and "
+            "written with the spatial index and levels of detail of the "
+            "polygon file.\n");
+    printf ("version: %s\n\n", ESPA_COMMON_VERSION);
+    printf ("usage: compile_land_mass_polygon "
+            "--shapefile=input_shp_filename (multiple --shapefile options "
+            "can be specified) --output=output_polygon_filename "
+            "[--target_sides=sides_per_segment] "
+            "[--max_sides=most_sides_per_segment] "
+            "[--threads=number_of_threads]\n");
+
+    printf ("\nwhere the following parameters are required:\n");
+    printf ("    -shapefile: name of an input .shp file of polygons in "
+            "geographic coordinates; shapefiles may also be listed after "
+            "the options\n");
+    printf ("    -output: name of the output land-mass polygon file\n");
+
+    printf ("\nwhere the following parameters are optional:\n");
+    printf ("    -target_sides: number of sides a polygon segment grows to "
+            "(default is %d)\n", LM_SEGMENT_TARGET_SIDES);
+    printf ("    -max_sides: most sides in a polygon segment (default is "
+            "%d)\n", LM_SEGMENT_MAX_SIDES);
+    printf ("    -threads: number of threads segmenting and nesting the "
+            "polygons (default is the cap of the task pool)\n");
+
+    printf ("\nExample: compile_land_mass_polygon "
+            "--shapefile=land_polygons.shp --shapefile=lake_polygons.shp "
+            "--output=land_no_buf.ply\n");
+}
+
+
+/******************************************************************************
+MODULE:  get_args
+
+PURPOSE:  Gets the command-line arguments and validates that the required
+arguments were specified.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error getting the command-line arguments or a command-line
+                argument and associated value were not specified
+SUCCESS         No errors encountered
+
+NOTES:
+  1. Memory is allocated for the shapefile names and the output file.
+     These should be freed by the caller.
+******************************************************************************/
+short get_args
+(
+    int argc,              /* I: number of cmd-line args */
+    char *argv[],          /* I: string of cmd-line args */
+    char **shp_files,      /* O: names of the shapefiles; holds
+                                 MAX_SHAPEFILES */
+    int *nfiles,           /* O: number of shapefiles */
+    char **polygon_file,   /* O: address of the output polygon filename */
+    int *target_sides,     /* O: sides a segment grows to */
+    int *max_sides         /* O: most sides in a segment */
+)
+{
+    int c;                           /* current argument index */
+    int option_index;                /* index for the command-line option */
+    char errmsg[STR_SIZE];           /* error message */
+    char FUNC_NAME[] = "get_args";   /* function name */
+    static struct option long_options[] =
+    {
+        {"shapefile", required_argument, 0, 's'},
+        {"output", required_argument, 0, 'o'},
+        {"target_sides", required_argument, 0, 'g'},
+        {"max_sides", required_argument, 0, 'm'},
+        {"threads", required_argument, 0, 't'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    /* Loop through all the cmd-line options */
+    opterr = 0;   /* turn off getopt_long error msgs as we'll print our own */
+    while (1)
+    {
+        /* optstring in call to getopt_long is empty since we will only
+           support the long options */
+        c = getopt_long (argc, argv, "", long_options, &option_index);
+        if (c == -1)
+        {   /* Out of cmd-line options */
+            break;
+        }
+
+        switch (c)
+        {
+            case 0:
+                /* If this option set a flag, do nothing else now. */
+                if (long_options[option_index].flag != 0)
+                    break;
+
+            case 'h':  /* help */
+                usage ();
+                return (ERROR);
+                break;
+
+            case 's':  /* shapefile */
+                if (*nfiles == MAX_SHAPEFILES)
+                {
+                    sprintf (errmsg, "At most %d shapefiles can be compiled",
+                        MAX_SHAPEFILES);
+                    error_handler (true, FUNC_NAME, errmsg);
+                    return (ERROR);
+                }
+                shp_files[(*nfiles)++] = strdup (optarg);
+                break;
+
+            case 'o':  /* output polygon file */
+                free (*polygon_file);
+                *polygon_file = strdup (optarg);
+                break;
+
+            case 'g':  /* target sides per segment */
+                *target_sides = atoi (optarg);
+                break;
+
+            case 'm':  /* most sides per segment */
+                *max_sides = atoi (optarg);
+                break;
+
+            case 't':  /* number of threads */
+                espa_task_pool_set_threads (atoi (optarg));
+                break;
+
+            case '?':
+            default:
+                sprintf (errmsg, "Unknown option %s", argv[optind-1]);
+                error_handler (true, FUNC_NAME, errmsg);
+                usage ();
+                return (ERROR);
+                break;
+        }
+    }
+
+    /* The remaining arguments are shapefiles as well */
+    for ( ; optind < argc; optind++)
+    {
+        if (*nfiles == MAX_SHAPEFILES)
+        {
+            sprintf (errmsg, "At most %d shapefiles can be compiled",
+                MAX_SHAPEFILES);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+        shp_files[(*nfiles)++] = strdup (argv[optind]);
+    }
+
+    /* Make sure the shapefiles and the output file were specified */
+    if (*nfiles == 0)
+    {
+        sprintf (errmsg, "At least one shapefile is a required argument");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+    if (*polygon_file == NULL)
+    {
+        sprintf (errmsg, "Output polygon file is a required argument");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+    if (*target_sides < 1 || *max_sides < *target_sides)
+    {
+        sprintf (errmsg, "The target sides per segment must be at least 1 "
+            "and no more than the most sides per segment");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  main
+
+PURPOSE:  Compiles the land-mass polygon file from the shapefiles.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error compiling the polygon file
+SUCCESS         No errors encountered
+******************************************************************************/
+int main (int argc, char** argv)
+{
+    char *shp_files[MAX_SHAPEFILES];  /* names of the shapefiles */
+    char *polygon_file = NULL;   /* output polygon filename */
+    int nfiles = 0;              /* number of shapefiles */
+    int target_sides = LM_SEGMENT_TARGET_SIDES;  /* sides a segment grows
+                                    to */
+    int max_sides = LM_SEGMENT_MAX_SIDES;  /* most sides in a segment */
+    int status;                  /* return status */
+    int i;                       /* looping variable for the shapefiles */
+
+    /* Read the command-line arguments */
+    if (get_args (argc, argv, shp_files, &nfiles, &polygon_file,
+        &target_sides, &max_sides) != SUCCESS)
+    {   /* get_args already printed the error message */
+        exit (ERROR);
+    }
+
+    /* Compile the polygon file */
+    status = compile_land_mass_polygon (shp_files, nfiles, target_sides,
+        max_sides, polygon_file);
+    if (status == SUCCESS)
+        printf ("Wrote the land-mass polygon file %s\n", polygon_file);
+
+    /* Free the arguments */
+    for (i = 0; i < nfiles; i++)
+        free (shp_files[i]);
+    free (polygon_file);
+
+    exit (status);
+}
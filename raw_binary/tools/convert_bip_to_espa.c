@@ -0,0 +1,275 @@
+/*****************************************************************************
+FILE: convert_bip_to_espa
+
+PURPOSE: Contains functions for converting a single raw binary file in the
+BIP, BIL, or BSQ layout back to the ESPA raw binary file format, one band per
+file, with the XML metadata of the bands taken from a template.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The XML metadata format parsed or written via this library follows the
+     ESPA internal metadata format found in ESPA Raw Binary Format v1.0.doc.
+     The schema for the ESPA internal metadata format is available at
+     http://espa.cr.usgs.gov/schema/espa_internal_metadata_v1_0.xsd.
+*****************************************************************************/
+#include <getopt.h>
+#include "convert_raw_binary_bip_to_espa.h"
+
+/******************************************************************************
+MODULE: usage
+
+PURPOSE: Prints the usage information for this application.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+void usage ()
+{
+    printf ("convert_bip_to_espa converts a single raw binary file with the "
+            "bands interleaved by pixel (or by line, or band sequential) to "
+            "the ESPA internal format (raw binary, one band per file, and "
+            "associated XML metadata file).  The bands of the file are "
+            "described, in order, by a template XML file, such as the XML "
+            "file written by convert_espa_to_bip.  An associated ENVI header "
+            "file will be written for each band.\n");
+    printf ("version: %s\n\n", ESPA_COMMON_VERSION);
+    printf ("usage: convert_bip_to_espa "
+            "--xml=template_metadata_filename "
+            "--output_xml=output_metadata_filename "
+            "[--bip=input_bip_filename] [--interleave=bsq|bil|bip] "
+            "[--pack=scale,offset[,int16|uint16]] [--del_src_files]\n");
+
+    printf ("\nwhere the following parameters are required:\n");
+    printf ("    -xml: name of the XML metadata file which follows the ESPA "
+            "internal raw binary schema and describes the bands of the "
+            "input file\n");
+    printf ("    -output_xml: name of the output XML metadata file.  The "
+            "bands are written alongside it, named for it and the band.\n");
+    printf ("\nwhere the following parameters are optional:\n");
+    printf ("    -bip: filename of the input raw binary file.  The default is "
+            "the file of the bands in the template XML file.\n");
+    printf ("    -interleave: layout of the bands in the input file; bsq "
+            "(band sequential), bil (band interleave by line), or bip (band "
+            "interleave by pixel).  The default is bip.\n");
+    printf ("    -pack: if specified the FLOAT32 and FLOAT64 bands are "
+            "packed into 16-bit integers (int16 by default), with "
+            "physical value = packed value * scale + offset\n");
+    printf ("    -del_src_files: if specified the input raw binary file and "
+            "its header file will be removed\n");
+    printf ("\nExample: convert_bip_to_espa "
+            "--xml=LE07_L1TP_022033_20140228_20161028_02_T1_bip.xml "
+            "--output_xml=LE07_L1TP_022033_20140228_20161028_02_T1.xml\n");
+}
+
+
+/******************************************************************************
+MODULE:  get_args
+
+PURPOSE:  Gets the command-line arguments and validates that the required
+arguments were specified.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error getting the command-line arguments or a command-line
+                argument and associated value were not specified
+SUCCESS         No errors encountered
+
+NOTES:
+  1. Memory is allocated for the input and output files.  All of these should
+     be character pointers set to NULL on input.  The caller is responsible
+     for freeing the allocated memory upon successful return.
+******************************************************************************/
+short get_args
+(
+    int argc,             /* I: number of cmd-line args */
+    char *argv[],         /* I: string of cmd-line args */
+    char **template_xml,  /* O: address of template XML filename */
+    char **bip_infile,    /* O: address of input BIP filename; NULL if not
+                                specified */
+    char **xml_outfile,   /* O: address of output XML filename */
+    Espa_interleave_t *layout, /* O: layout of the bands in the input file */
+    Espa_pack_params_t *pack, /* O: packing of the float bands */
+    bool *packing,        /* O: should the float bands be packed? */
+    bool *del_src         /* O: should source files be removed? */
+)
+{
+    int c;                           /* current argument index */
+    int option_index;                /* index for the command-line option */
+    char errmsg[STR_SIZE];           /* error message */
+    char FUNC_NAME[] = "get_args";   /* function name */
+    static int del_flag = 0;         /* flag for removing the source files */
+    static struct option long_options[] =
+    {
+        {"del_src_files", no_argument, &del_flag, 1},
+        {"xml", required_argument, 0, 'i'},
+        {"bip", required_argument, 0, 'b'},
+        {"output_xml", required_argument, 0, 'o'},
+        {"interleave", required_argument, 0, 'l'},
+        {"pack", required_argument, 0, 'p'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    /* Loop through all the cmd-line options */
+    opterr = 0;   /* turn off getopt_long error msgs as we'll print our own */
+    while (1)
+    {
+        /* optstring in call to getopt_long is empty since we will only
+           support the long options */
+        c = getopt_long (argc, argv, "", long_options, &option_index);
+        if (c == -1)
+        {   /* Out of cmd-line options */
+            break;
+        }
+
+        switch (c)
+        {
+            case 0:
+                /* If this option set a flag, do nothing else now. */
+                if (long_options[option_index].flag != 0)
+                    break;
+
+            case 'h':  /* help */
+                usage ();
+                return (ERROR);
+                break;
+
+            case 'i':  /* template XML file */
+                *template_xml = strdup (optarg);
+                break;
+
+            case 'b':  /* BIP infile */
+                *bip_infile = strdup (optarg);
+                break;
+
+            case 'o':  /* XML outfile */
+                *xml_outfile = strdup (optarg);
+                break;
+
+            case 'l':  /* interleave */
+                if (parse_espa_interleave (optarg, layout) != SUCCESS)
+                {  /* Error message already written */
+                    usage ();
+                    return (ERROR);
+                }
+                if (*layout == ESPA_TILED_BIP_INTERLEAVE)
+                {
+                    sprintf (errmsg, "The tiled_bip layout can't be "
+                        "converted to ESPA bands");
+                    error_handler (true, FUNC_NAME, errmsg);
+                    usage ();
+                    return (ERROR);
+                }
+                break;
+
+            case 'p':  /* packing of the float bands */
+                if (parse_espa_pack_params (optarg, pack) != SUCCESS)
+                {  /* Error message already written */
+                    usage ();
+                    return (ERROR);
+                }
+                *packing = true;
+                break;
+
+            case '?':
+            default:
+                sprintf (errmsg, "Unknown option %s", argv[optind-1]);
+                error_handler (true, FUNC_NAME, errmsg);
+                usage ();
+                return (ERROR);
+                break;
+        }
+    }
+
+    /* Make sure the infiles and outfiles were specified */
+    if (*template_xml == NULL)
+    {
+        sprintf (errmsg, "Template XML file is a required argument");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    if (*xml_outfile == NULL)
+    {
+        sprintf (errmsg, "XML output file is a required argument");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    /* Check the delete source files flag */
+    if (del_flag)
+        *del_src = true;
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  main
+
+PURPOSE:  Converts a single raw binary file in the BIP, BIL, or BSQ layout to
+the ESPA internal format (raw binary, one band per file, and associated XML
+metadata file), using a template XML file to describe the bands.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error doing the conversion
+SUCCESS         No errors encountered
+
+NOTES:
+  1. The bands in the template XML file are read, in order, from the input
+     file.  These bands must be of the same size, otherwise this function
+     will exit with an error.
+  2. Bands of a different data type than the first band are taken to be
+     stored in the data type of the first band (i.e. the QA bands written
+     with convert_espa_to_bip --convert_qa) and are converted back to their
+     own data type.
+******************************************************************************/
+int main (int argc, char** argv)
+{
+    char *template_xml = NULL;   /* template XML filename */
+    char *bip_infile = NULL;     /* input BIP filename */
+    char *xml_outfile = NULL;    /* output XML filename */
+    bool del_src = false;        /* should source files be removed? */
+    bool packing = false;        /* should the float bands be packed? */
+    Espa_pack_params_t pack;     /* packing of the float bands */
+    Espa_interleave_t layout = ESPA_BIP_INTERLEAVE;  /* layout of the bands
+                                    in the input file */
+
+    printf ("convert_bip_to_espa version: %s\n", ESPA_COMMON_VERSION);
+
+    /* Read the command-line arguments */
+    if (get_args (argc, argv, &template_xml, &bip_infile, &xml_outfile,
+        &layout, &pack, &packing, &del_src) != SUCCESS)
+    {   /* get_args already printed the error message */
+        exit (EXIT_FAILURE);
+    }
+
+    /* Split the raw binary file into the internal ESPA raw binary bands */
+    if (convert_raw_binary_interleave_to_espa (bip_infile, layout,
+        template_xml, xml_outfile, packing ? &pack : NULL, del_src)
+        != SUCCESS)
+    {  /* Error messages already written */
+        exit (EXIT_FAILURE);
+    }
+
+    /* Free the pointers */
+    free (template_xml);
+    free (bip_infile);
+    free (xml_outfile);
+
+    /* Successful completion */
+    exit (EXIT_SUCCESS);
+}
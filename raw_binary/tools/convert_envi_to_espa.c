@@ -0,0 +1,269 @@
+/*****************************************************************************
+FILE: convert_envi_to_espa
+
+PURPOSE: Contains functions for ingesting an ENVI file (raw binary image data
+with an ENVI .hdr header) into the ESPA internal format.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The XML metadata format parsed or written via this library follows the
+     ESPA internal metadata format found in ESPA Raw Binary Format v1.0.doc.
+     The schema for the ESPA internal metadata format is available at
+     http://espa.cr.usgs.gov/schema/espa_internal_metadata_v1_0.xsd.
+*****************************************************************************/
+#include <getopt.h>
+#include <time.h>
+#include "convert_envi_to_espa.h"
+
+/******************************************************************************
+MODULE: usage
+
+PURPOSE: Prints the usage information for this application.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+void usage ()
+{
+    printf ("convert_envi_to_espa ingests an ENVI file (raw binary image "
+            "data with an ENVI .hdr header) into the ESPA internal format "
+            "(raw binary and associated XML metadata file).  A band "
+            "sequential file in the byte order of this machine is used in "
+            "place; otherwise its bands are written one band per file, "
+            "with an associated ENVI header file for each band.\n");
+    printf ("version: %s\n\n", ESPA_COMMON_VERSION);
+    printf ("usage: convert_envi_to_espa "
+            "--envi=input_envi_filename "
+            "--xml=output_metadata_filename "
+            "[--template=template_metadata_filename] [--copy_bands] "
+            "[--pack=scale,offset[,int16|uint16]] [--del_src_files]\n");
+
+    printf ("\nwhere the following parameters are required:\n");
+    printf ("    -envi: name of the input ENVI image file.  Its header is "
+            "the file with the extension replaced by (or followed by) "
+            ".hdr, and must have the map info of the image.\n");
+    printf ("    -xml: name of the output XML metadata file\n");
+    printf ("\nwhere the following parameters are optional:\n");
+    printf ("    -template: name of an XML metadata file whose global "
+            "metadata (satellite, instrument, dates, ...) is given to the "
+            "product\n");
+    printf ("    -copy_bands: if specified the bands are always written one "
+            "band per file alongside the output XML file, rather than "
+            "used in place\n");
+    printf ("    -pack: if specified the FLOAT32 and FLOAT64 bands are "
+            "packed into 16-bit integers (int16 by default), with "
+            "physical value = packed value * scale + offset, and are "
+            "always written one band per file\n");
+    printf ("    -del_src_files: if specified the input ENVI file and its "
+            "header file will be removed once its bands are written\n");
+    printf ("\nExample: convert_envi_to_espa --envi=scene.img "
+            "--xml=scene.xml\n");
+}
+
+
+/******************************************************************************
+MODULE:  get_args
+
+PURPOSE:  Gets the command-line arguments and validates that the required
+arguments were specified.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error getting the command-line arguments or a command-line
+                argument and associated value were not specified
+SUCCESS         No errors encountered
+
+NOTES:
+  1. Memory is allocated for the input and output files.  All of these should
+     be character pointers set to NULL on input.  The caller is responsible
+     for freeing the allocated memory upon successful return.
+******************************************************************************/
+short get_args
+(
+    int argc,             /* I: number of cmd-line args */
+    char *argv[],         /* I: string of cmd-line args */
+    char **envi_infile,   /* O: address of input ENVI filename */
+    char **xml_outfile,   /* O: address of output XML filename */
+    char **template_xml,  /* O: address of template XML filename; NULL if
+                                not specified */
+    bool *copy_bands,     /* O: should the bands always be copied? */
+    Espa_pack_params_t *pack, /* O: packing of the float bands */
+    bool *packing,        /* O: should the float bands be packed? */
+    bool *del_src         /* O: should source files be removed? */
+)
+{
+    int c;                           /* current argument index */
+    int option_index;                /* index for the command-line option */
+    char errmsg[STR_SIZE];           /* error message */
+    char FUNC_NAME[] = "get_args";   /* function name */
+    static int copy_flag = 0;        /* flag for copying the bands */
+    static int del_flag = 0;         /* flag for removing the source files */
+    static struct option long_options[] =
+    {
+        {"copy_bands", no_argument, &copy_flag, 1},
+        {"del_src_files", no_argument, &del_flag, 1},
+        {"envi", required_argument, 0, 'e'},
+        {"xml", required_argument, 0, 'o'},
+        {"template", required_argument, 0, 't'},
+        {"pack", required_argument, 0, 'p'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    /* Loop through all the cmd-line options */
+    opterr = 0;   /* turn off getopt_long error msgs as we'll print our own */
+    while (1)
+    {
+        /* optstring in call to getopt_long is empty since we will only
+           support the long options */
+        c = getopt_long (argc, argv, "", long_options, &option_index);
+        if (c == -1)
+        {   /* Out of cmd-line options */
+            break;
+        }
+
+        switch (c)
+        {
+            case 0:
+                /* If this option set a flag, do nothing else now. */
+                if (long_options[option_index].flag != 0)
+                    break;
+
+            case 'h':  /* help */
+                usage ();
+                return (ERROR);
+                break;
+
+            case 'e':  /* ENVI infile */
+                *envi_infile = strdup (optarg);
+                break;
+
+            case 'o':  /* XML outfile */
+                *xml_outfile = strdup (optarg);
+                break;
+
+            case 't':  /* template XML file */
+                *template_xml = strdup (optarg);
+                break;
+
+            case 'p':  /* packing of the float bands */
+                if (parse_espa_pack_params (optarg, pack) != SUCCESS)
+                {  /* Error message already written */
+                    usage ();
+                    return (ERROR);
+                }
+                *packing = true;
+                break;
+
+            case '?':
+            default:
+                sprintf (errmsg, "Unknown option %s", argv[optind-1]);
+                error_handler (true, FUNC_NAME, errmsg);
+                usage ();
+                return (ERROR);
+                break;
+        }
+    }
+
+    /* Make sure the infiles and outfiles were specified */
+    if (*envi_infile == NULL)
+    {
+        sprintf (errmsg, "ENVI input file is a required argument");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    if (*xml_outfile == NULL)
+    {
+        sprintf (errmsg, "XML output file is a required argument");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    /* Check the flags */
+    if (copy_flag)
+        *copy_bands = true;
+    if (del_flag)
+        *del_src = true;
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  main
+
+PURPOSE:  Ingests an ENVI file into the ESPA internal format (raw binary and
+associated XML metadata file).
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error doing the conversion
+SUCCESS         No errors encountered
+
+NOTES:
+  1. See convert_envi_to_espa for when the ENVI file is used in place.
+******************************************************************************/
+int main (int argc, char** argv)
+{
+    char FUNC_NAME[] = "main";   /* function name */
+    char errmsg[STR_SIZE];       /* error message */
+    char production_date[STR_SIZE];  /* current date/time for production */
+    char *envi_infile = NULL;    /* input ENVI filename */
+    char *xml_outfile = NULL;    /* output XML filename */
+    char *template_xml = NULL;   /* template XML filename */
+    bool copy_bands = false;     /* should the bands always be copied? */
+    bool packing = false;        /* should the float bands be packed? */
+    bool del_src = false;        /* should source files be removed? */
+    time_t tp;                   /* time structure */
+    struct tm *tm = NULL;        /* time structure for UTC time */
+    Espa_pack_params_t pack;     /* packing of the float bands */
+
+    printf ("convert_envi_to_espa version: %s\n", ESPA_COMMON_VERSION);
+
+    /* Read the command-line arguments */
+    if (get_args (argc, argv, &envi_infile, &xml_outfile, &template_xml,
+        &copy_bands, &pack, &packing, &del_src) != SUCCESS)
+    {   /* get_args already printed the error message */
+        exit (EXIT_FAILURE);
+    }
+
+    /* Get the current date/time (UTC) for the production date of the
+       bands */
+    if (time (&tp) == -1 || (tm = gmtime (&tp)) == NULL ||
+        strftime (production_date, sizeof (production_date),
+        "%Y-%m-%dT%H:%M:%SZ", tm) == 0)
+    {
+        sprintf (errmsg, "Formatting the production date/time.");
+        error_handler (true, FUNC_NAME, errmsg);
+        exit (EXIT_FAILURE);
+    }
+
+    /* Ingest the ENVI file */
+    if (convert_envi_to_espa (envi_infile, template_xml, xml_outfile,
+        production_date, copy_bands, packing ? &pack : NULL, del_src)
+        != SUCCESS)
+    {  /* Error messages already written */
+        exit (EXIT_FAILURE);
+    }
+
+    /* Free the pointers */
+    free (envi_infile);
+    free (xml_outfile);
+    free (template_xml);
+
+    /* Successful completion */
+    exit (EXIT_SUCCESS);
+}
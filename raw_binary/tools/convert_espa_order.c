@@ -0,0 +1,248 @@
+/*****************************************************************************
+FILE: convert_espa_order
+
+PURPOSE: Contains functions for exporting an order of ESPA products, each to
+one or more export formats, exporting several products at a time.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. Each product is exported as by convert_espa_to_formats, reading its
+     bands once for all of its formats.
+  2. The formats are set up through the export registry, so when built with
+     ENABLE_PLUGINS only the plugins of the formats in the order are loaded
+     (see espa_export_registry.h).
+*****************************************************************************/
+#include <getopt.h>
+#include "espa_trace.h"
+#include "espa_export_order.h"
+
+/******************************************************************************
+MODULE: usage
+
+PURPOSE: Prints the usage information for this application.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+void usage ()
+{
+    printf ("convert_espa_order exports an order of products in the ESPA "
+            "internal format (raw binary and associated XML metadata file), "
+            "each to one or more export formats, exporting several products "
+            "at a time.\n");
+    printf ("version: %s\n\n", ESPA_COMMON_VERSION);
+    printf ("usage: convert_espa_order "
+            "--manifest=order_manifest_filename "
+            "[--jobs=products] [--queue_blocks=blocks] "
+            "[--memory_mb=megabytes]\n");
+
+    printf ("\nwhere the following parameters are required:\n");
+    printf ("    -manifest: name of the order manifest, with one product "
+            "per line: the XML metadata filename of the product, then "
+            "format=output for each export format (gtif, netcdf, hdf, "
+            "...), then optionally no_compression and del_src; lines "
+            "starting with # are skipped\n");
+    printf ("\nand where the following parameters are optional:\n");
+    printf ("    -jobs: number of products exported at a time (default is "
+            "ESPA_THREADS, or one per processor); fewer are run if they "
+            "don't fit in the memory budget\n");
+    printf ("    -queue_blocks: number of blocks of lines held between the "
+            "reading of the bands and the writing of the formats of each "
+            "product (the default is %d)\n", DEFAULT_EXPORT_QUEUE_BLOCKS);
+    printf ("    -memory_mb: memory budget of the order in megabytes, shared "
+            "by the products exported at a time (default is "
+            "ESPA_MEM_BUDGET_MB, or no budget)\n");
+    printf ("\nExample: convert_espa_order --manifest=order.txt --jobs=4\n");
+    printf ("\nwhere order.txt holds lines like:\n");
+    printf ("    LC08_L1TP_047027_20131014_20170308_02_T1.xml "
+            "gtif=LC08_L1TP_047027_20131014_20170308_02_T1 "
+            "netcdf=LC08_L1TP_047027_20131014_20170308_02_T1.nc del_src\n");
+}
+
+
+/******************************************************************************
+MODULE:  get_args
+
+PURPOSE:  Gets the command-line arguments and validates that the required
+arguments were specified.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error getting the command-line arguments or a command-line
+                argument and associated value were not specified
+SUCCESS         No errors encountered
+
+NOTES:
+  1. Memory is allocated for the manifest filename, which should be NULL on
+     input.  The caller is responsible for freeing the allocated memory upon
+     successful return.
+  2. The memory budget is set as soon as it is read, before anything is
+     allocated.
+******************************************************************************/
+short get_args
+(
+    int argc,              /* I: number of cmd-line args */
+    char *argv[],          /* I: string of cmd-line args */
+    char **manifest,       /* O: address of the order manifest filename */
+    int *njobs,            /* O: number of products exported at a time; 0
+                                 for the thread cap */
+    int *queue_blocks      /* O: number of blocks in flight */
+)
+{
+    int c;                           /* current argument index */
+    int option_index;                /* index for the command-line option */
+    int memory_mb;                   /* memory budget of the order */
+    char errmsg[STR_SIZE];           /* error message */
+    char FUNC_NAME[] = "get_args";   /* function name */
+    static struct option long_options[] =
+    {
+        {"manifest", required_argument, 0, 'm'},
+        {"jobs", required_argument, 0, 'j'},
+        {"queue_blocks", required_argument, 0, 'q'},
+        {"memory_mb", required_argument, 0, 'b'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    /* Loop through all the cmd-line options */
+    opterr = 0;   /* turn off getopt_long error msgs as we'll print our own */
+    while (1)
+    {
+        /* optstring in call to getopt_long is empty since we will only
+           support the long options */
+        c = getopt_long (argc, argv, "", long_options, &option_index);
+        if (c == -1)
+        {   /* Out of cmd-line options */
+            break;
+        }
+
+        switch (c)
+        {
+            case 0:
+                /* If this option set a flag, do nothing else now. */
+                if (long_options[option_index].flag != 0)
+                    break;
+
+            case 'h':  /* help */
+                usage ();
+                return (ERROR);
+                break;
+
+            case 'm':  /* order manifest */
+                *manifest = strdup (optarg);
+                break;
+
+            case 'j':  /* products exported at a time */
+                *njobs = atoi (optarg);
+                if (*njobs < 1)
+                {
+                    sprintf (errmsg, "Number of jobs must be positive");
+                    error_handler (true, FUNC_NAME, errmsg);
+                    usage ();
+                    return (ERROR);
+                }
+                break;
+
+            case 'q':  /* blocks in flight */
+                *queue_blocks = atoi (optarg);
+                break;
+
+            case 'b':  /* memory budget of the order (MB) */
+                memory_mb = atoi (optarg);
+                if (memory_mb < 1)
+                {
+                    sprintf (errmsg, "Invalid memory budget: %s", optarg);
+                    error_handler (true, FUNC_NAME, errmsg);
+                    usage ();
+                    return (ERROR);
+                }
+                espa_mem_set_budget_mb (memory_mb);
+                break;
+
+            case '?':
+            default:
+                sprintf (errmsg, "Unknown option %s", argv[optind-1]);
+                error_handler (true, FUNC_NAME, errmsg);
+                usage ();
+                return (ERROR);
+                break;
+        }
+    }
+
+    /* Make sure the manifest was specified */
+    if (*manifest == NULL)
+    {
+        sprintf (errmsg, "Order manifest is a required argument");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    if (*queue_blocks < 1)
+    {
+        sprintf (errmsg, "Number of queued blocks must be positive");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  main
+
+PURPOSE:  Exports the products of an order to their export formats.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error exporting one or more of the products
+SUCCESS         No errors encountered
+
+NOTES:
+  1. Every product is attempted, even if others fail (see
+     export_espa_order).
+******************************************************************************/
+int main (int argc, char** argv)
+{
+    char *manifest = NULL;       /* order manifest filename */
+    int njobs = 0;               /* products exported at a time */
+    int queue_blocks = DEFAULT_EXPORT_QUEUE_BLOCKS;  /* blocks in flight */
+    int nproducts = 0;           /* number of products in the order */
+    int status;                  /* status of the export */
+    Espa_order_product_t *products = NULL;  /* products of the order */
+
+    printf ("convert_espa_order version: %s\n", ESPA_COMMON_VERSION);
+
+    /* Read the command-line arguments */
+    if (get_args (argc, argv, &manifest, &njobs, &queue_blocks) != SUCCESS)
+    {   /* get_args already printed the error message */
+        exit (EXIT_FAILURE);
+    }
+
+    /* Read the products of the order */
+    if (read_espa_order (manifest, &nproducts, &products) != SUCCESS)
+    {   /* Error messages already written */
+        exit (EXIT_FAILURE);
+    }
+
+    /* Export the products */
+    status = export_espa_order (nproducts, products, njobs, queue_blocks);
+
+    /* Free the products and the pointers */
+    free_espa_order (nproducts, products);
+    free (manifest);
+
+    exit (status == SUCCESS ? EXIT_SUCCESS : EXIT_FAILURE);
+}
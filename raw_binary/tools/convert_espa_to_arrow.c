@@ -0,0 +1,273 @@
+/*****************************************************************************
+FILE: convert_espa_to_arrow
+
+PURPOSE: Contains functions for converting the ESPA raw binary file format
+to an Apache Arrow IPC (Feather) file.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The XML metadata format parsed or written via this library follows the
+     ESPA internal metadata format found in ESPA Raw Binary Format v1.0.doc.
+     The schema for the ESPA internal metadata format is available at
+     http://espa.cr.usgs.gov/schema/espa_internal_metadata_v1_0.xsd.
+*****************************************************************************/
+#include <getopt.h>
+#include "convert_espa_to_arrow.h"
+
+/******************************************************************************
+MODULE: usage
+
+PURPOSE: Prints the usage information for this application.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+void usage ()
+{
+    printf ("convert_espa_to_arrow converts the ESPA internal format (raw "
+            "binary and associated XML metadata file) to an Apache Arrow IPC "
+            "file (Feather version 2), with a tensor column per band, for "
+            "machine learning data loaders.\n");
+    printf ("version: %s\n\n", ESPA_COMMON_VERSION);
+    printf ("usage: convert_espa_to_arrow "
+            "--xml=input_metadata_filename "
+            "--arrow=output_arrow_filename "
+            "[--del_src_files] "
+            "[--layout=lines|chips] [--batch_lines=lines] "
+            "[--chip_size=pixels] [--physical_units]\n");
+
+    printf ("\nwhere the following parameters are required:\n");
+    printf ("    -xml: name of the input XML metadata file which follows "
+            "the ESPA internal raw binary schema\n");
+    printf ("    -arrow: filename of the output Arrow file\n");
+    printf ("\nand where the following parameters are optional:\n");
+    printf ("    -del_src_files: if specified the source image and header "
+            "files will be removed\n");
+    printf ("    -layout: rows of the file; a row per line, or a row per "
+            "square chip (the default is lines)\n");
+    printf ("    -batch_lines: number of lines in each record batch (the "
+            "default is %d)\n", DEFAULT_ARROW_BATCH_LINES);
+    printf ("    -chip_size: number of lines and samples of each chip (the "
+            "default is %d)\n", DEFAULT_ARROW_CHIP_SIZE);
+    printf ("    -physical_units: if specified the bands with a scale "
+            "factor or add offset are written as float32 physical values "
+            "with NaN fill (the default is the packed pixels)\n");
+    printf ("    Only the bands on the grid of the first band are "
+            "written.\n");
+    printf ("\nExample: convert_espa_to_arrow "
+            "--xml=LE07_L1TP_022033_20140228_20161028_02_T1.xml "
+            "--arrow=LE07_L1TP_022033_20140228_20161028_02_T1.arrow "
+            "--layout=chips\n");
+}
+
+
+/******************************************************************************
+MODULE:  get_args
+
+PURPOSE:  Gets the command-line arguments and validates that the required
+arguments were specified.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error getting the command-line arguments or a command-line
+                argument and associated value were not specified
+SUCCESS         No errors encountered
+
+NOTES:
+  1. Memory is allocated for the input and output files.  All of these should
+     be character pointers set to NULL on input.  The caller is responsible
+     for freeing the allocated memory upon successful return.
+******************************************************************************/
+short get_args
+(
+    int argc,              /* I: number of cmd-line args */
+    char *argv[],          /* I: string of cmd-line args */
+    char **xml_infile,     /* O: address of input XML filename */
+    char **arrow_outfile,  /* O: address of output Arrow filename */
+    bool *del_src,         /* O: should source files be removed? */
+    Arrow_options_t *options  /* O: layout and batching of the rows */
+)
+{
+    int c;                           /* current argument index */
+    int option_index;                /* index for the command-line option */
+    char errmsg[STR_SIZE];           /* error message */
+    char FUNC_NAME[] = "get_args";   /* function name */
+    static int del_flag = 0;         /* flag for removing the source files */
+    static int physical_flag = 0;    /* flag for physical units */
+    static struct option long_options[] =
+    {
+        {"del_src_files", no_argument, &del_flag, 1},
+        {"physical_units", no_argument, &physical_flag, 1},
+        {"xml", required_argument, 0, 'i'},
+        {"arrow", required_argument, 0, 'o'},
+        {"layout", required_argument, 0, 'y'},
+        {"batch_lines", required_argument, 0, 'b'},
+        {"chip_size", required_argument, 0, 'c'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    /* Loop through all the cmd-line options */
+    opterr = 0;   /* turn off getopt_long error msgs as we'll print our own */
+    while (1)
+    {
+        /* optstring in call to getopt_long is empty since we will only
+           support the long options */
+        c = getopt_long (argc, argv, "", long_options, &option_index);
+        if (c == -1)
+        {   /* Out of cmd-line options */
+            break;
+        }
+
+        switch (c)
+        {
+            case 0:
+                /* If this option set a flag, do nothing else now. */
+                if (long_options[option_index].flag != 0)
+                    break;
+
+            case 'h':  /* help */
+                usage ();
+                return (ERROR);
+                break;
+
+            case 'i':  /* XML infile */
+                *xml_infile = strdup (optarg);
+                break;
+
+            case 'o':  /* Arrow outfile */
+                *arrow_outfile = strdup (optarg);
+                break;
+
+            case 'y':  /* layout of the rows */
+                if (parse_arrow_layout (optarg, &options->layout) != SUCCESS)
+                {  /* Error message already written */
+                    usage ();
+                    return (ERROR);
+                }
+                break;
+
+            case 'b':  /* lines per record batch */
+                options->batch_lines = atoi (optarg);
+                break;
+
+            case 'c':  /* lines and samples per chip */
+                options->chip_size = atoi (optarg);
+                break;
+
+            case '?':
+            default:
+                sprintf (errmsg, "Unknown option %s", argv[optind-1]);
+                error_handler (true, FUNC_NAME, errmsg);
+                usage ();
+                return (ERROR);
+                break;
+        }
+    }
+
+    /* Make sure the infiles and outfiles were specified */
+    if (*xml_infile == NULL)
+    {
+        sprintf (errmsg, "XML input file is a required argument");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    if (*arrow_outfile == NULL)
+    {
+        sprintf (errmsg, "Arrow output file is a required argument");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    /* Make sure the row values are valid */
+    if (options->batch_lines < 1)
+    {
+        sprintf (errmsg, "Number of lines per record batch must be "
+            "positive");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    if (options->chip_size < 1)
+    {
+        sprintf (errmsg, "Chip size must be positive");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    /* Check the delete source files flag */
+    if (del_flag)
+        *del_src = true;
+
+    /* Check the physical units flag */
+    if (physical_flag)
+        options->physical_units = true;
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  main
+
+PURPOSE:  Converts the ESPA internal format (raw binary and associated XML
+metadata file) to an Arrow IPC file.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error doing the conversion
+SUCCESS         No errors encountered
+
+NOTES:
+******************************************************************************/
+int main (int argc, char** argv)
+{
+    char *xml_infile = NULL;     /* input XML filename */
+    char *arrow_outfile = NULL;  /* output Arrow filename */
+    bool del_src = false;        /* should source files be removed? */
+    Arrow_options_t options;     /* layout and batching of the rows */
+
+    printf ("convert_espa_to_arrow version: %s\n", ESPA_COMMON_VERSION);
+
+    /* Default layout and batching of the rows */
+    options.layout = ARROW_LAYOUT_LINES;
+    options.batch_lines = DEFAULT_ARROW_BATCH_LINES;
+    options.chip_size = DEFAULT_ARROW_CHIP_SIZE;
+    options.physical_units = false;
+
+    /* Read the command-line arguments */
+    if (get_args (argc, argv, &xml_infile, &arrow_outfile, &del_src,
+        &options) != SUCCESS)
+    {   /* get_args already printed the error message */
+        exit (EXIT_FAILURE);
+    }
+
+    /* Convert the internal ESPA raw binary product to Arrow */
+    if (convert_espa_to_arrow (xml_infile, arrow_outfile, del_src, &options)
+        != SUCCESS)
+    {  /* Error messages already written */
+        exit (EXIT_FAILURE);
+    }
+
+    /* Free the pointers */
+    free (xml_infile);
+    free (arrow_outfile);
+
+    /* Successful completion */
+    exit (EXIT_SUCCESS);
+}
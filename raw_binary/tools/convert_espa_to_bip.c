@@ -2,7 +2,8 @@
 FILE: convert_espa_to_bip
   
 PURPOSE: Contains functions for converting the ESPA raw binary file format
-to raw binary band interleave by pixel (BIP).
+to raw binary band interleave by pixel (BIP), or to a single raw binary file
+in the BSQ, BIL, or tiled BIP layouts.
 
 PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
 at the USGS EROS
@@ -36,17 +37,29 @@ void usage ()
             "the input XML file will be written to a single raw binary file "
             "with the all the bands for a single pixel being written, "
             "followed by all the bands for the next pixel, etc. An associated "
-            "ENVI header file will be written for this raw binary file.\n");
+            "ENVI header file will be written for this raw binary file. "
+            "Band sequential, band interleave by line, and tiled BIP layouts "
+            "can be written instead.\n");
     printf ("version: %s\n\n", ESPA_COMMON_VERSION);
     printf ("usage: convert_espa_to_bip "
             "--xml=input_metadata_filename "
             "--bip=output_bip_filename "
+            "[--interleave=bsq|bil|bip|tiled_bip] [--tile_size=pixels] "
             "[--convert_qa] [--del_src_files]\n");
 
     printf ("\nwhere the following parameters are required:\n");
     printf ("    -xml: name of the input XML metadata file which follows "
             "the ESPA internal raw binary schema\n");
     printf ("    -bip: filename of the output raw binary BIP file\n");
+    printf ("\nwhere the following parameters are optional:\n");
+    printf ("    -interleave: layout of the bands in the output file; bsq "
+            "(band sequential), bil (band interleave by line), bip (band "
+            "interleave by pixel), or tiled_bip (square tiles of pixels in "
+            "row order, each tile band interleave by pixel, padded with "
+            "zeros at the image edges).  The default is bip.\n");
+    printf ("    -tile_size: number of lines and samples in each tile of the "
+            "tiled_bip layout.  The default is %d.\n",
+            DEFAULT_INTERLEAVE_TILE_SIZE);
     printf ("    -convert_qa: should the QA bands (UINT8) be converted to the "
             "native data type of the first band, if QA bands are actually of "
             "a different data type from the other bands.\n");
@@ -55,6 +68,10 @@ void usage ()
     printf ("\nExample: convert_espa_to_bip "
             "--xml=LE07_L1TP_022033_20140228_20161028_02_T1.xml "
             "--bip=LE07_L1TP_022033_20140228_20161028_02_T1.img\n");
+    printf ("\nExample: convert_espa_to_bip "
+            "--xml=LE07_L1TP_022033_20140228_20161028_02_T1.xml "
+            "--bip=LE07_L1TP_022033_20140228_20161028_02_T1.img "
+            "--interleave=tiled_bip --tile_size=128\n");
 }
 
 
@@ -83,6 +100,10 @@ short get_args
     char *argv[],         /* I: string of cmd-line args */
     char **xml_infile,    /* O: address of input XML filename */
     char **bip_outfile,   /* O: address of output BIP filename */
+    Espa_interleave_t *layout, /* O: layout of the bands in the output
+                                file */
+    int *tile_size,       /* O: number of lines and samples in each tile of
+                                the tiled BIP layout */
     bool *convert_qa,     /* O: should the QA bands (uint8) be converted to
                                 the data type of band 1 (if QA bands are of
                                 a different data type)? */
@@ -101,6 +122,8 @@ short get_args
         {"convert_qa", no_argument, &convert_flag, 1},
         {"xml", required_argument, 0, 'i'},
         {"bip", required_argument, 0, 'o'},
+        {"interleave", required_argument, 0, 'l'},
+        {"tile_size", required_argument, 0, 't'},
         {"help", no_argument, 0, 'h'},
         {0, 0, 0, 0}
     };
@@ -136,6 +159,26 @@ short get_args
             case 'o':  /* BIP outfile */
                 *bip_outfile = strdup (optarg);
                 break;
+
+            case 'l':  /* interleave */
+                if (parse_espa_interleave (optarg, layout) != SUCCESS)
+                {  /* Error message already written */
+                    usage ();
+                    return (ERROR);
+                }
+                break;
+
+            case 't':  /* tile size */
+                *tile_size = atoi (optarg);
+                if (*tile_size <= 0)
+                {
+                    sprintf (errmsg, "Tile size must be positive: %s",
+                        optarg);
+                    error_handler (true, FUNC_NAME, errmsg);
+                    usage ();
+                    return (ERROR);
+                }
+                break;
      
             case '?':
             default:
@@ -201,6 +244,8 @@ NOTES:
      user to specify that the QA bands (uint8) should be included in the output
      BIP product however the QA bands will be converted to the same data type
      as the first band in the XML file.
+  3. The interleave option writes the bands in another layout, with the same
+     checks and QA conversion.
 ******************************************************************************/
 int main (int argc, char** argv)
 {
@@ -209,19 +254,24 @@ int main (int argc, char** argv)
     bool convert_qa = false;     /* should the QA bands (UINT8) be converted to
                                     the native data type? */
     bool del_src = false;        /* should source files be removed? */
+    Espa_interleave_t layout = ESPA_BIP_INTERLEAVE;  /* layout of the bands
+                                    in the output file */
+    int tile_size = DEFAULT_INTERLEAVE_TILE_SIZE;  /* number of lines and
+                                    samples in each tile */
 
     printf ("convert_espa_to_bip version: %s\n", ESPA_COMMON_VERSION);
 
     /* Read the command-line arguments */
-    if (get_args (argc, argv, &xml_infile, &bip_outfile, &convert_qa,
-        &del_src) != SUCCESS)
+    if (get_args (argc, argv, &xml_infile, &bip_outfile, &layout, &tile_size,
+        &convert_qa, &del_src) != SUCCESS)
     {   /* get_args already printed the error message */
         exit (EXIT_FAILURE);
     }
 
-    /* Convert the internal ESPA raw binary product to raw binary BIP */
-    if (convert_espa_to_raw_binary_bip (xml_infile, bip_outfile, convert_qa,
-        del_src) != SUCCESS)
+    /* Convert the internal ESPA raw binary product to raw binary in the
+       requested layout */
+    if (convert_espa_to_raw_binary_interleave (xml_infile, bip_outfile,
+        layout, tile_size, convert_qa, del_src) != SUCCESS)
     {  /* Error messages already written */
         exit (EXIT_FAILURE);
     }
@@ -0,0 +1,332 @@
+/*****************************************************************************
+FILE: convert_espa_to_formats
+
+PURPOSE: Contains functions for converting the ESPA raw binary file format
+to several export formats (GeoTIFF, NetCDF, and HDF) at once, reading each
+band only once.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The XML metadata format parsed or written via this library follows the
+     ESPA internal metadata format found in ESPA Raw Binary Format v1.0.doc.
+     The schema for the ESPA internal metadata format is available at
+     http://espa.cr.usgs.gov/schema/espa_internal_metadata_v1_0.xsd.
+  2. The products are the same as those of convert_espa_to_gtif,
+     convert_espa_to_netcdf, and convert_espa_to_hdf with their default
+     options.
+  3. The formats are set up through the export registry, so when built with
+     ENABLE_PLUGINS only the plugins of the requested formats are loaded
+     (see espa_export_registry.h).
+*****************************************************************************/
+#include <getopt.h>
+#include "parse_metadata.h"
+#include "espa_export_registry.h"
+
+/* Maximum number of export formats */
+#define MAX_EXPORT_SINKS 3
+
+/******************************************************************************
+MODULE: usage
+
+PURPOSE: Prints the usage information for this application.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+void usage ()
+{
+    printf ("convert_espa_to_formats converts the ESPA internal format (raw "
+            "binary and associated XML metadata file) to any of GeoTIFF, "
+            "NetCDF, and HDF at the same time, reading each band only "
+            "once.\n");
+    printf ("version: %s\n\n", ESPA_COMMON_VERSION);
+    printf ("usage: convert_espa_to_formats "
+            "--xml=input_metadata_filename "
+            "[--gtif=output_geotiff_base_filename] "
+            "[--netcdf=output_netcdf_filename] "
+            "[--hdf=output_hdf_filename] "
+            "[--no_compression] [--del_src_files] "
+            "[--queue_blocks=blocks]\n");
+
+    printf ("\nwhere the following parameters are required:\n");
+    printf ("    -xml: name of the input XML metadata file which follows "
+            "the ESPA internal raw binary schema\n");
+    printf ("    and at least one of -gtif, -netcdf, and -hdf\n");
+    printf ("\nand where the following parameters are optional:\n");
+    printf ("    -gtif: base filename of the output GeoTIFF files; the band "
+            "name of each band is appended\n");
+    printf ("    -netcdf: filename of the output NetCDF file\n");
+    printf ("    -hdf: filename of the output HDF file\n");
+    printf ("    -no_compression: if specified the NetCDF file will not be "
+            "compressed\n");
+    printf ("    -del_src_files: if specified the source image and header "
+            "files will be removed\n");
+    printf ("    -queue_blocks: number of blocks of lines held between the "
+            "reading of the bands and the writing of the formats, which "
+            "limits the memory used (the default is %d)\n",
+            DEFAULT_EXPORT_QUEUE_BLOCKS);
+    printf ("\nExample: convert_espa_to_formats "
+            "--xml=LE07_L1TP_022033_20140228_20161028_02_T1.xml "
+            "--gtif=LE07_L1TP_022033_20140228_20161028_02_T1 "
+            "--netcdf=LE07_L1TP_022033_20140228_20161028_02_T1.nc "
+            "--hdf=LE07_L1TP_022033_20140228_20161028_02_T1.hdf\n");
+}
+
+
+/******************************************************************************
+MODULE:  get_args
+
+PURPOSE:  Gets the command-line arguments and validates that the required
+arguments were specified.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error getting the command-line arguments or a command-line
+                argument and associated value were not specified
+SUCCESS         No errors encountered
+
+NOTES:
+  1. Memory is allocated for the input and output files.  All of these should
+     be character pointers set to NULL on input.  The caller is responsible
+     for freeing the allocated memory upon successful return.
+******************************************************************************/
+short get_args
+(
+    int argc,              /* I: number of cmd-line args */
+    char *argv[],          /* I: string of cmd-line args */
+    char **xml_infile,     /* O: address of input XML filename */
+    char **gtif_outfile,   /* O: address of output GeoTIFF base filename */
+    char **netcdf_outfile, /* O: address of output NetCDF filename */
+    char **hdf_outfile,    /* O: address of output HDF filename */
+    bool *no_compression,  /* O: should the NetCDF file be uncompressed? */
+    bool *del_src,         /* O: should source files be removed? */
+    int *queue_blocks      /* O: number of blocks in flight */
+)
+{
+    int c;                           /* current argument index */
+    int option_index;                /* index for the command-line option */
+    char errmsg[STR_SIZE];           /* error message */
+    char FUNC_NAME[] = "get_args";   /* function name */
+    static int del_flag = 0;         /* flag for removing the source files */
+    static int no_compression_flag = 0;  /* flag for no NetCDF compression */
+    static struct option long_options[] =
+    {
+        {"del_src_files", no_argument, &del_flag, 1},
+        {"no_compression", no_argument, &no_compression_flag, 1},
+        {"xml", required_argument, 0, 'i'},
+        {"gtif", required_argument, 0, 'g'},
+        {"netcdf", required_argument, 0, 'n'},
+        {"hdf", required_argument, 0, 'd'},
+        {"queue_blocks", required_argument, 0, 'q'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    /* Loop through all the cmd-line options */
+    opterr = 0;   /* turn off getopt_long error msgs as we'll print our own */
+    while (1)
+    {
+        /* optstring in call to getopt_long is empty since we will only
+           support the long options */
+        c = getopt_long (argc, argv, "", long_options, &option_index);
+        if (c == -1)
+        {   /* Out of cmd-line options */
+            break;
+        }
+
+        switch (c)
+        {
+            case 0:
+                /* If this option set a flag, do nothing else now. */
+                if (long_options[option_index].flag != 0)
+                    break;
+
+            case 'h':  /* help */
+                usage ();
+                return (ERROR);
+                break;
+
+            case 'i':  /* XML infile */
+                *xml_infile = strdup (optarg);
+                break;
+
+            case 'g':  /* GeoTIFF base outfile */
+                *gtif_outfile = strdup (optarg);
+                break;
+
+            case 'n':  /* NetCDF outfile */
+                *netcdf_outfile = strdup (optarg);
+                break;
+
+            case 'd':  /* HDF outfile */
+                *hdf_outfile = strdup (optarg);
+                break;
+
+            case 'q':  /* blocks in flight */
+                *queue_blocks = atoi (optarg);
+                break;
+
+            case '?':
+            default:
+                sprintf (errmsg, "Unknown option %s", argv[optind-1]);
+                error_handler (true, FUNC_NAME, errmsg);
+                usage ();
+                return (ERROR);
+                break;
+        }
+    }
+
+    /* Make sure the infiles and outfiles were specified */
+    if (*xml_infile == NULL)
+    {
+        sprintf (errmsg, "XML input file is a required argument");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    if (*gtif_outfile == NULL && *netcdf_outfile == NULL &&
+        *hdf_outfile == NULL)
+    {
+        sprintf (errmsg, "At least one of the GeoTIFF, NetCDF, and HDF "
+            "outputs is required");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    if (*queue_blocks < 1)
+    {
+        sprintf (errmsg, "Number of queued blocks must be positive");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    /* Check the delete source files flag */
+    if (del_flag)
+        *del_src = true;
+
+    /* Check the "no compression" flag */
+    if (no_compression_flag)
+        *no_compression = true;
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  main
+
+PURPOSE:  Converts the ESPA internal format (raw binary and associated XML
+metadata file) to the requested export formats at once.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error doing the conversion
+SUCCESS         No errors encountered
+
+NOTES:
+  1. Each block of lines of the bands is read once and written by each
+     format in its own thread (see export_espa_fanout).
+  2. The source files are only removed once every format has been written.
+******************************************************************************/
+int main (int argc, char** argv)
+{
+    char FUNC_NAME[] = "main";   /* function name */
+    char errmsg[STR_SIZE];       /* error message */
+    char *xml_infile = NULL;     /* input XML filename */
+    char *gtif_outfile = NULL;   /* output GeoTIFF base filename */
+    char *netcdf_outfile = NULL; /* output NetCDF filename */
+    char *hdf_outfile = NULL;    /* output HDF filename */
+    bool no_compression = false; /* should the NetCDF be uncompressed? */
+    bool del_src = false;        /* should source files be removed? */
+    int queue_blocks = DEFAULT_EXPORT_QUEUE_BLOCKS;  /* blocks in flight */
+    int block_lines = RB_PREFETCH_DEFAULT_LINES;  /* lines per block */
+    int nsinks = 0;              /* number of export sinks */
+    int status = SUCCESS;        /* status of setting up the sinks */
+    int i;                       /* looping variable for the sinks */
+    const char *formats[MAX_EXPORT_SINKS] = {"gtif", "netcdf", "hdf"};
+                                 /* export formats, in the registry */
+    char *outfiles[MAX_EXPORT_SINKS];  /* output of each format; NULL if not
+                                    requested */
+    Espa_export_options_t options;  /* options of the export formats */
+    Espa_export_sink_t sinks[MAX_EXPORT_SINKS];  /* export sinks */
+    Espa_internal_meta_t xml_metadata;  /* XML metadata structure */
+
+    printf ("convert_espa_to_formats version: %s\n", ESPA_COMMON_VERSION);
+
+    /* Read the command-line arguments */
+    if (get_args (argc, argv, &xml_infile, &gtif_outfile, &netcdf_outfile,
+        &hdf_outfile, &no_compression, &del_src, &queue_blocks) != SUCCESS)
+    {   /* get_args already printed the error message */
+        exit (EXIT_FAILURE);
+    }
+
+    /* Validate the metadata file and parse it into our internal metadata
+       structure */
+    init_metadata_struct (&xml_metadata);
+    if (validate_and_parse_metadata (xml_infile, &xml_metadata) != SUCCESS)
+    {  /* Error messages already written */
+        exit (EXIT_FAILURE);
+    }
+
+    /* Set up the sink of each requested format */
+    outfiles[0] = gtif_outfile;
+    outfiles[1] = netcdf_outfile;
+    outfiles[2] = hdf_outfile;
+    options.block_lines = block_lines;
+    options.no_compression = no_compression;
+    for (i = 0; status == SUCCESS && i < MAX_EXPORT_SINKS; i++)
+    {
+        if (outfiles[i] == NULL)
+            continue;
+        if (init_export_sink (formats[i], outfiles[i], &xml_metadata,
+            &options, &sinks[nsinks]) == SUCCESS)
+            nsinks++;
+        else
+            status = ERROR;
+    }
+    if (status != SUCCESS)
+    {
+        sprintf (errmsg, "Setting up the export formats");
+        error_handler (true, FUNC_NAME, errmsg);
+        for (i = 0; i < nsinks; i++)
+            sinks[i].finish (sinks[i].state, &xml_metadata, false);
+        exit (EXIT_FAILURE);
+    }
+
+    /* Convert the internal ESPA raw binary product to all the formats */
+    if (export_espa_fanout (&xml_metadata, nsinks, sinks, block_lines,
+        queue_blocks) != SUCCESS)
+    {  /* Error messages already written */
+        exit (EXIT_FAILURE);
+    }
+
+    /* Remove the source files if specified */
+    if (del_src && remove_export_source (&xml_metadata, xml_infile)
+        != SUCCESS)
+    {  /* Error messages already written */
+        exit (EXIT_FAILURE);
+    }
+
+    /* Free the metadata structure and the pointers */
+    free_metadata (&xml_metadata);
+    free (xml_infile);
+    free (gtif_outfile);
+    free (netcdf_outfile);
+    free (hdf_outfile);
+
+    /* Successful completion */
+    exit (EXIT_SUCCESS);
+}
@@ -39,7 +39,7 @@ void usage ()
     printf ("usage: convert_espa_to_gtif "
             "--xml=input_metadata_filename "
             "--gtif=output_geotiff_base_filename "
-            "[--del_src_files]\n");
+            "[--del_src_files] [--cog] [--compression=deflate]\n");
 
     printf ("\nwhere the following parameters are required:\n");
     printf ("    -xml: name of the input XML metadata file which follows "
@@ -47,6 +47,10 @@ void usage ()
     printf ("    -gtif: base filename of the output GeoTIFF files\n");
     printf ("    -del_src_files: if specified the source image and header "
             "files will be removed\n");
+    printf ("    -cog: if specified Cloud-Optimized GeoTIFFs (tiled, with "
+            "internal overviews) will be written\n");
+    printf ("    -compression: compression of the Cloud-Optimized GeoTIFF "
+            "tiles; none, deflate, lzw, or zstd (default is deflate)\n");
     printf ("\nExample: convert_espa_to_gtif "
             "--xml=LE07_L1TP_022033_20140228_20161028_02_T1.xml "
             "--gtif=LE07_L1TP_022033_20140228_20161028_02_T1\n");
@@ -78,7 +82,9 @@ short get_args
     char *argv[],         /* I: string of cmd-line args */
     char **xml_infile,    /* O: address of input XML filename */
     char **gtif_outfile,  /* O: address of output GeoTIFF base filename */
-    bool *del_src         /* O: should source files be removed? */
+    bool *del_src,        /* O: should source files be removed? */
+    bool *cog,            /* O: should Cloud-Optimized GeoTIFFs be written? */
+    Cog_compression_t *compression  /* O: compression of the COG tiles */
 )
 {
     int c;                           /* current argument index */
@@ -86,9 +92,12 @@ short get_args
     char errmsg[STR_SIZE];           /* error message */
     char FUNC_NAME[] = "get_args";   /* function name */
     static int del_flag = 0;         /* flag for removing the source files */
+    static int cog_flag = 0;         /* flag for writing COGs */
     static struct option long_options[] =
     {
         {"del_src_files", no_argument, &del_flag, 1},
+        {"cog", no_argument, &cog_flag, 1},
+        {"compression", required_argument, 0, 'c'},
         {"xml", required_argument, 0, 'i'},
         {"gtif", required_argument, 0, 'o'},
         {"help", no_argument, 0, 'h'},
@@ -126,6 +135,14 @@ short get_args
             case 'o':  /* GeoTIFF base outfile */
                 *gtif_outfile = strdup (optarg);
                 break;
+
+            case 'c':  /* COG compression */
+                if (parse_cog_compression (optarg, compression) != SUCCESS)
+                {  /* Error message already written */
+                    usage ();
+                    return (ERROR);
+                }
+                break;
      
             case '?':
             default:
@@ -158,6 +175,10 @@ short get_args
     if (del_flag)
         *del_src = true;
 
+    /* Check the COG flag */
+    if (cog_flag)
+        *cog = true;
+
     return (SUCCESS);
 }
 
@@ -184,17 +205,22 @@ int main (int argc, char** argv)
     char *xml_infile = NULL;     /* input XML filename */
     char *gtif_outfile = NULL;   /* output base GeoTIFF filename */
     bool del_src = false;        /* should source files be removed? */
+    bool cog = false;            /* should COGs be written? */
+    Cog_compression_t compression = COG_COMPRESS_DEFLATE;  /* compression of
+                                    the COG tiles */
 
     printf ("convert_espa_to_gtif version: %s\n", ESPA_COMMON_VERSION);
 
     /* Read the command-line arguments */
-    if (get_args (argc, argv, &xml_infile, &gtif_outfile, &del_src) != SUCCESS)
+    if (get_args (argc, argv, &xml_infile, &gtif_outfile, &del_src, &cog,
+        &compression) != SUCCESS)
     {   /* get_args already printed the error message */
         exit (EXIT_FAILURE);
     }
 
     /* Convert the internal ESPA raw binary product to GeoTIFF */
-    if (convert_espa_to_gtif (xml_infile, gtif_outfile, del_src) != SUCCESS)
+    if (convert_espa_to_gtif (xml_infile, gtif_outfile, del_src, cog,
+        compression) != SUCCESS)
     {  /* Error messages already written */
         exit (EXIT_FAILURE);
     }
@@ -34,12 +34,14 @@ void usage ()
             "binary and associated XML metadata file) to HDF-EOS2 (HDF4).  "
             "Each band represented in the input XML file will be written to a "
             "a single HDF file with each SDS being represented as an external "
-            "dataset.\n");
+            "dataset, or as an internal dataset of compressed chunks.\n");
     printf ("version: %s\n\n", ESPA_COMMON_VERSION);
     printf ("usage: convert_espa_to_hdf "
             "--xml=input_metadata_filename "
             "--hdf=output_hdf_filename "
-            "[--del_src_files]\n");
+            "[--del_src_files] [--link_src_files] "
+            "[--compress=none|deflate|szip] [--level=level] "
+            "[--chunk_lines=lines] [--chunk_samps=samples]\n");
 
     printf ("\nwhere the following parameters are required:\n");
     printf ("    -xml: name of the input XML metadata file which follows "
@@ -47,6 +49,22 @@ void usage ()
     printf ("    -hdf: filename of the output HDF file\n");
     printf ("    -del_src_files: if specified the source image and header "
             "files will be removed\n");
+    printf ("    -link_src_files: if specified the source image files will "
+            "be linked as-is as little endian external datasets rather "
+            "than copied to big endian files; the linked source files are "
+            "not removed\n");
+    printf ("    -compress: compressor of the chunks of internal SDSs; the "
+            "default of none writes uncompressed external SDSs.  szip is "
+            "only available if the HDF library has the szip encoder.  "
+            "Can't be used with -link_src_files\n");
+    printf ("    -level: deflate compression level, 1-9 (the default is "
+            "%d)\n", DEFAULT_HDF_DEFLATE_LEVEL);
+    printf ("    -chunk_lines: number of lines in each chunk of the "
+            "compressed SDSs (the default is %d)\n",
+            DEFAULT_HDF_CHUNK_LINES);
+    printf ("    -chunk_samps: number of samples in each chunk of the "
+            "compressed SDSs; 0 for full lines (the default is %d)\n",
+            DEFAULT_HDF_CHUNK_SAMPS);
     printf ("\nExample: convert_espa_to_hdf "
             "--xml=LE07_L1TP_022033_20140228_20161028_02_T1.xml "
             "--hdf=LE07_L1TP_022033_20140228_20161028_02_T1.hdf\n");
@@ -78,7 +96,10 @@ short get_args
     char *argv[],         /* I: string of cmd-line args */
     char **xml_infile,    /* O: address of input XML filename */
     char **hdf_outfile,   /* O: address of output HDF filename */
-    bool *del_src         /* O: should source files be removed? */
+    bool *del_src,        /* O: should source files be removed? */
+    bool *link_src,       /* O: should source files be linked as-is? */
+    Hdf_options_t *options  /* O: storage, chunking, and compression of the
+                                  SDSs */
 )
 {
     int c;                           /* current argument index */
@@ -86,11 +107,17 @@ short get_args
     char errmsg[STR_SIZE];           /* error message */
     char FUNC_NAME[] = "get_args";   /* function name */
     static int del_flag = 0;         /* flag for removing the source files */
+    static int link_flag = 0;        /* flag for linking the source files */
     static struct option long_options[] =
     {
         {"del_src_files", no_argument, &del_flag, 1},
+        {"link_src_files", no_argument, &link_flag, 1},
         {"xml", required_argument, 0, 'i'},
         {"hdf", required_argument, 0, 'o'},
+        {"compress", required_argument, 0, 'c'},
+        {"level", required_argument, 0, 'v'},
+        {"chunk_lines", required_argument, 0, 'l'},
+        {"chunk_samps", required_argument, 0, 's'},
         {"help", no_argument, 0, 'h'},
         {0, 0, 0, 0}
     };
@@ -126,6 +153,27 @@ short get_args
             case 'o':  /* HDF outfile */
                 *hdf_outfile = strdup (optarg);
                 break;
+
+            case 'c':  /* compressor */
+                if (parse_hdf_compressor (optarg, &options->compressor)
+                    != SUCCESS)
+                {   /* Error messages already written */
+                    usage ();
+                    return (ERROR);
+                }
+                break;
+
+            case 'v':  /* deflate level */
+                options->level = atoi (optarg);
+                break;
+
+            case 'l':  /* lines per chunk */
+                options->chunk_lines = atoi (optarg);
+                break;
+
+            case 's':  /* samples per chunk */
+                options->chunk_samps = atoi (optarg);
+                break;
      
             case '?':
             default:
@@ -158,6 +206,41 @@ short get_args
     if (del_flag)
         *del_src = true;
 
+    /* Check the link source files flag */
+    if (link_flag)
+        *link_src = true;
+
+    /* Make sure the chunking and compression values are valid */
+    if (*link_src && options->compressor != HDF_COMPRESS_NONE)
+    {
+        sprintf (errmsg, "The source files can't be linked into compressed "
+            "SDSs");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    if (options->level < 0 || options->level > 9)
+    {
+        sprintf (errmsg, "Deflate level must be from 1 to 9");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    if (options->chunk_lines < 1)
+    {
+        sprintf (errmsg, "Number of lines per chunk must be positive");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    if (options->chunk_samps < 0)
+    {
+        sprintf (errmsg, "Number of samples per chunk must not be negative");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
     return (SUCCESS);
 }
 
@@ -184,17 +267,29 @@ int main (int argc, char** argv)
     char *xml_infile = NULL;     /* input XML filename */
     char *hdf_outfile = NULL;    /* output HDF filename */
     bool del_src = false;        /* should source files be removed? */
+    bool link_src = false;       /* should source files be linked as-is? */
+    Hdf_options_t options;       /* storage, chunking, and compression of
+                                    the SDSs */
 
     printf ("clip_band_misalignment version: %s\n", ESPA_COMMON_VERSION);
 
+    /* Default to uncompressed external SDSs */
+    options.compressor = HDF_COMPRESS_NONE;
+    options.chunk_lines = DEFAULT_HDF_CHUNK_LINES;
+    options.chunk_samps = DEFAULT_HDF_CHUNK_SAMPS;
+    options.level = 0;
+
     /* Read the command-line arguments */
-    if (get_args (argc, argv, &xml_infile, &hdf_outfile, &del_src) != SUCCESS)
+    if (get_args (argc, argv, &xml_infile, &hdf_outfile, &del_src,
+        &link_src, &options) != SUCCESS)
     {   /* get_args already printed the error message */
         exit (EXIT_FAILURE);
     }
 
-    /* Convert the internal ESPA raw binary product to HDF with external SDSs */
-    if (convert_espa_to_hdf (xml_infile, hdf_outfile, del_src) != SUCCESS)
+    /* Convert the internal ESPA raw binary product to HDF with external SDSs,
+       or compressed internal SDSs */
+    if (convert_espa_to_hdf (xml_infile, hdf_outfile, del_src, link_src,
+        &options) != SUCCESS)
     {  /* Error messages already written */
         exit (EXIT_FAILURE);
     }
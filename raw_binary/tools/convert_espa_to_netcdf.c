@@ -37,7 +37,12 @@ void usage ()
             "--xml=input_metadata_filename "
             "--netcdf=output_netcdf_filename "
             "[--del_src_files]"
-            "[--no_compression]\n");
+            "[--no_compression] "
+            "[--chunk_lines=lines] [--chunk_samps=samples] "
+            "[--cache_mb=megabytes] [--parallel_compression] "
+            "[--physical_units] "
+            "[--quantize=none|bitgroom|granularbr] "
+            "[--significant_digits=digits]\n");
 
     printf ("\nwhere the following parameters are required:\n");
     printf ("    -xml: name of the input XML metadata file which follows "
@@ -48,6 +53,28 @@ void usage ()
             "files will be removed\n");
     printf ("    -no_compression: if specified compression will not be used "
             "(the default is compression is used)\n");
+    printf ("    -chunk_lines: number of lines in each chunk of the band "
+            "variables (the default is %d)\n", DEFAULT_CHUNK_LINES);
+    printf ("    -chunk_samps: number of samples in each chunk of the band "
+            "variables; 0 for full lines (the default is %d)\n",
+            DEFAULT_CHUNK_SAMPS);
+    printf ("    -cache_mb: total chunk cache, in MB, shared by all the band "
+            "variables (the default is %d)\n", DEFAULT_CACHE_MB);
+    printf ("    -parallel_compression: if specified the chunks of the "
+            "bands are compressed in parallel and written directly to the "
+            "file (the default is compression by the HDF5 library)\n");
+    printf ("    -physical_units: if specified the bands with a scale "
+            "factor or add offset are written as float32 physical values "
+            "with NaN fill (the default is the packed pixels)\n");
+    printf ("    -quantize: lossy quantization of the float bands so they "
+            "compress better; bitgroom or granularbr (the default is "
+            "none)\n");
+    printf ("    -significant_digits: decimal digits kept by the "
+            "quantization, 1 to %d (the default is chosen from the data "
+            "units of each band, and bands with unknown units aren't "
+            "quantized)\n", NETCDF_MAX_DOUBLE_DIGITS);
+    printf ("    The chunking and quantization options only apply when "
+            "compression is used.\n");
     printf ("\nExample: convert_espa_to_netcdf "
             "--xml=LE07_L1TP_022033_20140228_20161028_02_T1.xml "
             "--netcdf=LE07_L1TP_022033_20140228_20161028_02_T1.nc\n");
@@ -80,7 +107,8 @@ short get_args
     char **xml_infile,     /* O: address of input XML filename */
     char **netcdf_outfile, /* O: address of output NetCDF filename */
     bool *del_src,         /* O: should source files be removed? */
-    bool *no_compression   /* O: should compression be used? */
+    bool *no_compression,  /* O: should compression be used? */
+    Netcdf_chunking_t *chunking  /* O: chunking of the band variables */
 )
 {
     int c;                           /* current argument index */
@@ -89,12 +117,21 @@ short get_args
     char FUNC_NAME[] = "get_args";   /* function name */
     static int del_flag = 0;         /* flag for removing the source files */
     static int no_compression_flag = 0; /* flag for compressing NetCDF file */
+    static int parallel_flag = 0;    /* flag for parallel compression */
+    static int physical_flag = 0;    /* flag for physical units */
     static struct option long_options[] =
     {
         {"del_src_files", no_argument, &del_flag, 1},
         {"no_compression", no_argument, &no_compression_flag, 1},
+        {"parallel_compression", no_argument, &parallel_flag, 1},
+        {"physical_units", no_argument, &physical_flag, 1},
         {"xml", required_argument, 0, 'i'},
         {"netcdf", required_argument, 0, 'o'},
+        {"chunk_lines", required_argument, 0, 'l'},
+        {"chunk_samps", required_argument, 0, 's'},
+        {"cache_mb", required_argument, 0, 'c'},
+        {"quantize", required_argument, 0, 'q'},
+        {"significant_digits", required_argument, 0, 'd'},
         {"help", no_argument, 0, 'h'},
         {0, 0, 0, 0}
     };
@@ -130,6 +167,28 @@ short get_args
             case 'o':  /* NetCDF outfile */
                 *netcdf_outfile = strdup (optarg);
                 break;
+
+            case 'l':  /* lines per chunk */
+                chunking->chunk_lines = atoi (optarg);
+                break;
+
+            case 's':  /* samples per chunk */
+                chunking->chunk_samps = atoi (optarg);
+                break;
+
+            case 'c':  /* chunk cache budget */
+                chunking->cache_mb = atoi (optarg);
+                break;
+
+            case 'q':  /* quantization of the float bands */
+                if (parse_netcdf_quantize (optarg, &chunking->quantize)
+                    != SUCCESS)
+                    return (ERROR);
+                break;
+
+            case 'd':  /* significant digits kept */
+                chunking->significant_digits = atoi (optarg);
+                break;
      
             case '?':
             default:
@@ -158,6 +217,51 @@ short get_args
         return (ERROR);
     }
 
+    /* Make sure the chunking values are valid */
+    if (chunking->chunk_lines < 1)
+    {
+        sprintf (errmsg, "Number of lines per chunk must be positive");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    if (chunking->chunk_samps < 0)
+    {
+        sprintf (errmsg, "Number of samples per chunk must not be negative");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    if (chunking->cache_mb < 1)
+    {
+        sprintf (errmsg, "Chunk cache budget must be at least 1 MB");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    if (chunking->significant_digits < 0 ||
+        chunking->significant_digits > NETCDF_MAX_DOUBLE_DIGITS)
+    {
+        sprintf (errmsg, "Number of significant digits must be from 1 to %d",
+            NETCDF_MAX_DOUBLE_DIGITS);
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    if (no_compression_flag &&
+        chunking->quantize != NETCDF_QUANTIZE_NONE)
+    {
+        sprintf (errmsg, "Quantization only applies when compression is "
+            "used");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
     /* Check the delete source files flag */
     if (del_flag)
         *del_src = true;
@@ -166,6 +270,14 @@ short get_args
     if (no_compression_flag)
         *no_compression = true;
 
+    /* Check the parallel compression flag */
+    if (parallel_flag)
+        chunking->parallel_compression = true;
+
+    /* Check the physical units flag */
+    if (physical_flag)
+        chunking->physical_units = true;
+
 
     return (SUCCESS);
 }
@@ -192,19 +304,29 @@ int main (int argc, char** argv)
     char *netcdf_outfile = NULL; /* output NetCDF filename */
     bool del_src = false;        /* should source files be removed? */
     bool no_compression = false; /* should compression be used? */
+    Netcdf_chunking_t chunking;  /* chunking of the band variables */
 
     printf ("convert_espa_to_netcdf version: %s\n", ESPA_COMMON_VERSION);
 
+    /* Default chunking of the band variables */
+    chunking.chunk_lines = DEFAULT_CHUNK_LINES;
+    chunking.chunk_samps = DEFAULT_CHUNK_SAMPS;
+    chunking.cache_mb = DEFAULT_CACHE_MB;
+    chunking.parallel_compression = false;
+    chunking.physical_units = false;
+    chunking.quantize = NETCDF_QUANTIZE_NONE;
+    chunking.significant_digits = 0;
+
     /* Read the command-line arguments */
     if (get_args (argc, argv, &xml_infile, &netcdf_outfile, &del_src, 
-        &no_compression) != SUCCESS)
+        &no_compression, &chunking) != SUCCESS)
     {   /* get_args already printed the error message */
         exit (EXIT_FAILURE);
     }
 
     /* Convert the internal ESPA raw binary product to NetCDF */
     if (convert_espa_to_netcdf (xml_infile, netcdf_outfile, del_src, 
-        no_compression) != SUCCESS)
+        no_compression, &chunking) != SUCCESS)
     {  /* Error messages already written */
         exit (EXIT_FAILURE);
     }
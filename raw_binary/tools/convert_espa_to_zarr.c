@@ -0,0 +1,281 @@
+/*****************************************************************************
+FILE: convert_espa_to_zarr
+
+PURPOSE: Contains functions for converting the ESPA raw binary file format
+to a Zarr store.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The XML metadata format parsed or written via this library follows the
+     ESPA internal metadata format found in ESPA Raw Binary Format v1.0.doc.
+     The schema for the ESPA internal metadata format is available at
+     http://espa.cr.usgs.gov/schema/espa_internal_metadata_v1_0.xsd.
+*****************************************************************************/
+#include <getopt.h>
+#include "convert_espa_to_zarr.h"
+
+/******************************************************************************
+MODULE: usage
+
+PURPOSE: Prints the usage information for this application.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+void usage ()
+{
+    printf ("convert_espa_to_zarr converts the ESPA internal format (raw "
+            "binary and associated XML metadata file) to a Zarr (version 2) "
+            "store, with a chunked and compressed array per band and "
+            "consolidated metadata.\n");
+    printf ("version: %s\n\n", ESPA_COMMON_VERSION);
+    printf ("usage: convert_espa_to_zarr "
+            "--xml=input_metadata_filename "
+            "--zarr=output_zarr_directory "
+            "[--del_src_files] "
+            "[--chunk_lines=lines] [--chunk_samps=samples] "
+            "[--compressor=none|zlib|zstd] [--level=level] "
+            "[--physical_units]\n");
+
+    printf ("\nwhere the following parameters are required:\n");
+    printf ("    -xml: name of the input XML metadata file which follows "
+            "the ESPA internal raw binary schema\n");
+    printf ("    -zarr: directory of the output Zarr store\n");
+    printf ("\nand where the following parameters are optional:\n");
+    printf ("    -del_src_files: if specified the source image and header "
+            "files will be removed\n");
+    printf ("    -chunk_lines: number of lines in each chunk of the band "
+            "arrays (the default is %d)\n", DEFAULT_ZARR_CHUNK_LINES);
+    printf ("    -chunk_samps: number of samples in each chunk of the band "
+            "arrays; 0 for full lines (the default is %d)\n",
+            DEFAULT_ZARR_CHUNK_SAMPS);
+    printf ("    -compressor: compressor of the chunks (the default is zstd "
+            "when it is available, otherwise zlib)\n");
+    printf ("    -level: compression level (the default is %d for zlib and "
+            "%d for zstd)\n", DEFAULT_ZARR_ZLIB_LEVEL,
+            DEFAULT_ZARR_ZSTD_LEVEL);
+    printf ("    -physical_units: if specified the bands with a scale "
+            "factor or add offset are written as float32 physical values "
+            "with NaN fill (the default is the packed pixels)\n");
+    printf ("\nExample: convert_espa_to_zarr "
+            "--xml=LE07_L1TP_022033_20140228_20161028_02_T1.xml "
+            "--zarr=LE07_L1TP_022033_20140228_20161028_02_T1.zarr\n");
+}
+
+
+/******************************************************************************
+MODULE:  get_args
+
+PURPOSE:  Gets the command-line arguments and validates that the required
+arguments were specified.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error getting the command-line arguments or a command-line
+                argument and associated value were not specified
+SUCCESS         No errors encountered
+
+NOTES:
+  1. Memory is allocated for the input and output files.  All of these should
+     be character pointers set to NULL on input.  The caller is responsible
+     for freeing the allocated memory upon successful return.
+******************************************************************************/
+short get_args
+(
+    int argc,              /* I: number of cmd-line args */
+    char *argv[],          /* I: string of cmd-line args */
+    char **xml_infile,     /* O: address of input XML filename */
+    char **zarr_outdir,    /* O: address of output Zarr directory */
+    bool *del_src,         /* O: should source files be removed? */
+    Zarr_options_t *options  /* O: chunking and compression of the bands */
+)
+{
+    int c;                           /* current argument index */
+    int option_index;                /* index for the command-line option */
+    char errmsg[STR_SIZE];           /* error message */
+    char FUNC_NAME[] = "get_args";   /* function name */
+    static int del_flag = 0;         /* flag for removing the source files */
+    static int physical_flag = 0;    /* flag for physical units */
+    static struct option long_options[] =
+    {
+        {"del_src_files", no_argument, &del_flag, 1},
+        {"physical_units", no_argument, &physical_flag, 1},
+        {"xml", required_argument, 0, 'i'},
+        {"zarr", required_argument, 0, 'o'},
+        {"chunk_lines", required_argument, 0, 'l'},
+        {"chunk_samps", required_argument, 0, 's'},
+        {"compressor", required_argument, 0, 'c'},
+        {"level", required_argument, 0, 'v'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    /* Loop through all the cmd-line options */
+    opterr = 0;   /* turn off getopt_long error msgs as we'll print our own */
+    while (1)
+    {
+        /* optstring in call to getopt_long is empty since we will only
+           support the long options */
+        c = getopt_long (argc, argv, "", long_options, &option_index);
+        if (c == -1)
+        {   /* Out of cmd-line options */
+            break;
+        }
+
+        switch (c)
+        {
+            case 0:
+                /* If this option set a flag, do nothing else now. */
+                if (long_options[option_index].flag != 0)
+                    break;
+
+            case 'h':  /* help */
+                usage ();
+                return (ERROR);
+                break;
+
+            case 'i':  /* XML infile */
+                *xml_infile = strdup (optarg);
+                break;
+
+            case 'o':  /* Zarr output directory */
+                *zarr_outdir = strdup (optarg);
+                break;
+
+            case 'l':  /* lines per chunk */
+                options->chunk_lines = atoi (optarg);
+                break;
+
+            case 's':  /* samples per chunk */
+                options->chunk_samps = atoi (optarg);
+                break;
+
+            case 'c':  /* compressor */
+                if (parse_zarr_compressor (optarg, &options->compressor)
+                    != SUCCESS)
+                {  /* Error message already written */
+                    usage ();
+                    return (ERROR);
+                }
+                break;
+
+            case 'v':  /* compression level */
+                options->level = atoi (optarg);
+                break;
+
+            case '?':
+            default:
+                sprintf (errmsg, "Unknown option %s", argv[optind-1]);
+                error_handler (true, FUNC_NAME, errmsg);
+                usage ();
+                return (ERROR);
+                break;
+        }
+    }
+
+    /* Make sure the infiles and outfiles were specified */
+    if (*xml_infile == NULL)
+    {
+        sprintf (errmsg, "XML input file is a required argument");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    if (*zarr_outdir == NULL)
+    {
+        sprintf (errmsg, "Zarr output directory is a required argument");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    /* Make sure the chunking values are valid */
+    if (options->chunk_lines < 1)
+    {
+        sprintf (errmsg, "Number of lines per chunk must be positive");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    if (options->chunk_samps < 0)
+    {
+        sprintf (errmsg, "Number of samples per chunk must not be negative");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    /* Check the delete source files flag */
+    if (del_flag)
+        *del_src = true;
+
+    /* Check the physical units flag */
+    if (physical_flag)
+        options->physical_units = true;
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  main
+
+PURPOSE:  Converts the ESPA internal format (raw binary and associated XML
+metadata file) to a Zarr store.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error doing the conversion
+SUCCESS         No errors encountered
+
+NOTES:
+******************************************************************************/
+int main (int argc, char** argv)
+{
+    char *xml_infile = NULL;     /* input XML filename */
+    char *zarr_outdir = NULL;    /* output Zarr directory */
+    bool del_src = false;        /* should source files be removed? */
+    Zarr_options_t options;      /* chunking and compression of the bands */
+
+    printf ("convert_espa_to_zarr version: %s\n", ESPA_COMMON_VERSION);
+
+    /* Default chunking and compression of the bands */
+    options.chunk_lines = DEFAULT_ZARR_CHUNK_LINES;
+    options.chunk_samps = DEFAULT_ZARR_CHUNK_SAMPS;
+    options.compressor = DEFAULT_ZARR_COMPRESSOR;
+    options.level = 0;
+    options.physical_units = false;
+
+    /* Read the command-line arguments */
+    if (get_args (argc, argv, &xml_infile, &zarr_outdir, &del_src,
+        &options) != SUCCESS)
+    {   /* get_args already printed the error message */
+        exit (EXIT_FAILURE);
+    }
+
+    /* Convert the internal ESPA raw binary product to Zarr */
+    if (convert_espa_to_zarr (xml_infile, zarr_outdir, del_src, &options)
+        != SUCCESS)
+    {  /* Error messages already written */
+        exit (EXIT_FAILURE);
+    }
+
+    /* Free the pointers */
+    free (xml_infile);
+    free (zarr_outdir);
+
+    /* Successful completion */
+    exit (EXIT_SUCCESS);
+}
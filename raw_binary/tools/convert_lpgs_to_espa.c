@@ -16,7 +16,11 @@ NOTES:
      http://espa.cr.usgs.gov/schema/espa_internal_metadata_v1_0.xsd.
 *****************************************************************************/
 #include <getopt.h>
+#include <time.h>
 #include "convert_lpgs_to_espa.h"
+#include "espa_remote.h"
+#include "parse_metadata.h"
+#include "generate_toa_bands.h"
 
 /******************************************************************************
 MODULE: usage
@@ -35,16 +39,46 @@ void usage ()
             "metadata file and associated raw binary files).\n");
     printf ("version: %s\n\n", ESPA_COMMON_VERSION);
     printf ("usage: convert_lpgs_to_espa "
-            "--mtl=input_mtl_filename "
-            "[--del_src_files]\n");
+            "--mtl=input_mtl_filename | --archive=input_bundle_filename "
+            "[--del_src_files] [--browse] [--toa=rad,refl,bt] "
+            "[--toa_float]\n");
 
-    printf ("\nwhere the following parameters are required:\n");
-    printf ("    -mtl: name of the input LPGS MTL metadata file\n");
+    printf ("\nwhere one of the following parameters is required:\n");
+    printf ("    -mtl: name of the input LPGS MTL metadata file.  It may "
+            "be an http://, https://, or s3:// URL, in which case the bands "
+            "are read from the same location with range requests as they "
+            "are converted, and the XML file is written to the current "
+            "directory.  Requires the library to be built with "
+            "ENABLE_REMOTE=yes.\n");
+    printf ("    -archive: name of the input Landsat bundle (.tar, .tar.gz), "
+            "which is converted without being extracted.  Requires the "
+            "library to be built with ENABLE_LIBARCHIVE=yes.  The XML file "
+            "is named after the bundle, in the current directory.\n");
+    printf ("\nand where the following parameters are optional:\n");
     printf ("    -del_src_files: if specified the source GeoTIFF files will "
             "be removed.  The _MTL.txt file will remain along with the "
-            "gap directory for ETM+ products.\n");
+            "gap directory for ETM+ products.  For a bundle, the bundle is "
+            "removed.\n");
+    printf ("    -browse: if specified a browse image of the product (a "
+            "reduced resolution RGB PNG named after the XML file) is built "
+            "as the bands are converted\n");
+    printf ("    -toa: comma-separated list of the top-of-atmosphere bands "
+            "to create from the calibration of the converted bands and "
+            "append to the XML file: rad (radiance), refl (reflectance), and "
+            "bt (brightness temperature)\n");
+    printf ("    -toa_float: write the TOA bands as FLOAT32 rather than "
+            "scaled INT16\n");
+    printf ("\nWhen built with ENABLE_THREADING=yes, the bands are converted "
+            "in parallel, %d at a time unless the %s environment variable "
+            "is set to another number.\n", LPGS_DEFAULT_INGEST_THREADS,
+            LPGS_INGEST_THREADS_ENV);
     printf ("\nExample: convert_lpgs_to_espa "
             "--mtl=LE07_L1TP_022033_20140228_20161028_02_T1_MTL.txt\n");
+    printf ("         convert_lpgs_to_espa "
+            "--archive=LE07_L1TP_022033_20140228_20161028_02_T1.tar.gz\n");
+    printf ("         convert_lpgs_to_espa "
+            "--mtl=s3://bucket/LE07_L1TP_022033_20140228_20161028_02_T1/"
+            "LE07_L1TP_022033_20140228_20161028_02_T1_MTL.txt\n");
 }
 
 
@@ -72,20 +106,31 @@ short get_args
     int argc,             /* I: number of cmd-line args */
     char *argv[],         /* I: string of cmd-line args */
     char **mtl_infile,    /* O: address of input LPGS MTL filename */
+    char **archive_infile,  /* O: address of input Landsat bundle filename */
     char **xml_outfile,   /* O: address of output XML filename */
-    bool *del_src         /* O: should source files be removed? */
+    bool *del_src,        /* O: should source files be removed? */
+    bool *browse,         /* O: should the browse be built? */
+    int *toa_products,    /* O: TOA_* bands to be created; 0 for none */
+    bool *toa_float       /* O: should the TOA bands be FLOAT32? */
 )
 {
     int c;                           /* current argument index */
     int option_index;                /* index for the command-line option */
     char *cptr = NULL;               /* pointer to _MTL.txt in MTL filename */
+    char *base = NULL;               /* input filename without directories */
     char errmsg[STR_SIZE];           /* error message */
     char FUNC_NAME[] = "get_args";   /* function name */
     static int del_flag = 0;         /* flag for removing the source files */
+    static int browse_flag = 0;      /* flag for building the browse */
+    static int toa_float_flag = 0;   /* flag for FLOAT32 TOA bands */
     static struct option long_options[] =
     {
         {"del_src_files", no_argument, &del_flag, 1},
+        {"browse", no_argument, &browse_flag, 1},
+        {"toa_float", no_argument, &toa_float_flag, 1},
         {"mtl", required_argument, 0, 'i'},
+        {"archive", required_argument, 0, 'a'},
+        {"toa", required_argument, 0, 'r'},
         {"help", no_argument, 0, 'h'},
         {0, 0, 0, 0}
     };
@@ -117,6 +162,18 @@ short get_args
             case 'i':  /* LPGS MTL infile */
                 *mtl_infile = strdup (optarg);
                 break;
+
+            case 'a':  /* Landsat bundle infile */
+                *archive_infile = strdup (optarg);
+                break;
+
+            case 'r':  /* TOA bands */
+                if (parse_toa_products (optarg, toa_products) != SUCCESS)
+                {
+                    usage ();
+                    return (ERROR);
+                }
+                break;
      
             case '?':
             default:
@@ -128,18 +185,57 @@ short get_args
         }
     }
 
-    /* Make sure the input MTL file was specified */
-    if (*mtl_infile == NULL)
+    /* Make sure the input MTL file or bundle was specified */
+    if ((*mtl_infile == NULL) == (*archive_infile == NULL))
     {
-        sprintf (errmsg, "LPGS MTL input file is a required argument");
+        sprintf (errmsg, "One of the LPGS MTL input file and the Landsat "
+            "bundle is a required argument");
         error_handler (true, FUNC_NAME, errmsg);
         usage ();
         return (ERROR);
     }
+    *toa_float = toa_float_flag;
+
+    /* Generate the XML filename from the bundle filename.  Drop the
+       directories and the .tar (and compression) extension, and add
+       .xml. */
+    if (*archive_infile != NULL)
+    {
+        base = strrchr (*archive_infile, '/');
+        base = (base != NULL) ? base + 1 : *archive_infile;
+        *xml_outfile = malloc (strlen (base) + strlen (".xml") + 1);
+        if (*xml_outfile == NULL)
+        {
+            sprintf (errmsg, "XML output file was not correctly generated");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+        strcpy (*xml_outfile, base);
+        cptr = strstr (*xml_outfile, ".tar");
+        if (cptr == NULL)
+            cptr = strstr (*xml_outfile, ".tgz");
+        if (cptr == NULL)
+            cptr = strrchr (*xml_outfile, '.');
+        if (cptr != NULL)
+            *cptr = '\0';
+        strcat (*xml_outfile, ".xml");
+
+        /* Check the delete source files and browse flags */
+        if (del_flag)
+            *del_src = true;
+        if (browse_flag)
+            *browse = true;
+
+        return (SUCCESS);
+    }
 
     /* Generate the XML filename from the MTL filename.  Find the _MTL.txt and
-       change that to .xml. */
-    *xml_outfile = strdup (*mtl_infile);
+       change that to .xml.  A remote MTL file gets its XML file in the
+       current directory. */
+    base = *mtl_infile;
+    if (is_remote_file (base))
+        base = strrchr (base, '/') + 1;
+    *xml_outfile = strdup (base);
     cptr = strrchr (*xml_outfile, '_');
     *cptr = '\0';
     sprintf (*xml_outfile, "%s.xml", *xml_outfile);
@@ -150,14 +246,92 @@ short get_args
         return (ERROR);
     }
 
-    /* Check the delete source files flag */
+    /* Check the delete source files and browse flags */
     if (del_flag)
         *del_src = true;
+    if (browse_flag)
+        *browse = true;
 
     return (SUCCESS);
 }
 
 
+#define MAX_DATE_LEN 28
+/******************************************************************************
+MODULE:  append_toa_bands
+
+PURPOSE: Creates the TOA bands of the converted Level-1 bands and appends them
+to the XML file.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error creating the TOA bands
+SUCCESS         No errors encountered
+******************************************************************************/
+int append_toa_bands
+(
+    char *xml_file,       /* I: XML file of the converted product */
+    int toa_products,     /* I: TOA_* bands to be created */
+    bool toa_float        /* I: should the TOA bands be FLOAT32? */
+)
+{
+    char FUNC_NAME[] = "append_toa_bands";  /* function name */
+    char errmsg[STR_SIZE];        /* error message */
+    char production_date[MAX_DATE_LEN+1]; /* current date/time */
+    int first;                    /* index of the first TOA band */
+    int ntoa;                     /* number of TOA bands */
+    int status = SUCCESS;         /* return status */
+    time_t tp;                    /* time structure */
+    struct tm *tm = NULL;         /* time structure for UTC time */
+    Espa_internal_meta_t xml_metadata; /* XML metadata of the product */
+
+    /* Get the current date/time (UTC) for the production date of the
+       TOA bands */
+    if (time (&tp) == -1 || (tm = gmtime (&tp)) == NULL ||
+        strftime (production_date, MAX_DATE_LEN, "%Y-%m-%dT%H:%M:%SZ", tm)
+        == 0)
+    {
+        sprintf (errmsg, "Formatting the production date/time.");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    init_metadata_struct (&xml_metadata);
+    if (parse_metadata (xml_file, &xml_metadata) != SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+
+    first = xml_metadata.nbands;
+    ntoa = count_toa_bands (&xml_metadata, toa_products);
+    if (ntoa == 0)
+    {
+        sprintf (errmsg, "None of the bands has the calibration of the "
+            "requested TOA bands");
+        error_handler (true, FUNC_NAME, errmsg);
+        status = ERROR;
+    }
+    else if (append_band_metadata (&xml_metadata, ntoa) != SUCCESS ||
+        setup_toa_bands (&xml_metadata, toa_products,
+            toa_float ? ESPA_FLOAT32 : ESPA_INT16, production_date, first)
+            != SUCCESS ||
+        write_toa_bands (&xml_metadata, toa_products, first) != SUCCESS ||
+        append_metadata (ntoa, &xml_metadata.band[first], xml_file)
+            != SUCCESS)
+    {
+        sprintf (errmsg, "Appending the TOA bands to the XML file: %s",
+            xml_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        status = ERROR;
+    }
+
+    free_metadata (&xml_metadata);
+    return (status);
+}
+
+
 /******************************************************************************
 MODULE:  main
 
@@ -176,25 +350,48 @@ NOTES:
 int main (int argc, char** argv)
 {
     char *mtl_infile = NULL;      /* input LPGS MTL filename */
+    char *archive_infile = NULL;  /* input Landsat bundle filename */
     char *xml_outfile = NULL;     /* output XML filename */
     bool del_src = false;         /* should source files be removed? */
+    bool browse = false;          /* should the browse be built? */
+    bool toa_float = false;       /* should the TOA bands be FLOAT32? */
+    int toa_products = 0;         /* TOA_* bands to be created */
 
     printf ("convert_lpgs_to_espa version: %s\n", ESPA_COMMON_VERSION);
 
     /* Read the command-line arguments */
-    if (get_args (argc, argv, &mtl_infile, &xml_outfile, &del_src) != SUCCESS)
+    if (get_args (argc, argv, &mtl_infile, &archive_infile, &xml_outfile,
+        &del_src, &browse, &toa_products, &toa_float) != SUCCESS)
     {   /* get_args already printed the error message */
         exit (EXIT_FAILURE);
     }
 
-    /* Convert the LPGS MTL and data to ESPA raw binary and XML */
-    if (convert_lpgs_to_espa (mtl_infile, xml_outfile, del_src) != SUCCESS)
+    /* Convert the LPGS MTL and data to ESPA raw binary and XML, straight
+       from the bundle if one was specified */
+    if (archive_infile != NULL)
+    {
+        if (convert_lpgs_archive_to_espa (archive_infile, xml_outfile,
+            del_src, browse) != SUCCESS)
+        {  /* Error messages already written */
+            exit (EXIT_FAILURE);
+        }
+    }
+    else if (convert_lpgs_to_espa (mtl_infile, xml_outfile, del_src,
+        browse) != SUCCESS)
+    {  /* Error messages already written */
+        exit (EXIT_FAILURE);
+    }
+
+    /* Append the TOA bands of the converted bands */
+    if (toa_products != 0 &&
+        append_toa_bands (xml_outfile, toa_products, toa_float) != SUCCESS)
     {  /* Error messages already written */
         exit (EXIT_FAILURE);
     }
 
     /* Free the pointers */
     free (mtl_infile);
+    free (archive_infile);
     free (xml_outfile);
 
     /* Successful completion */
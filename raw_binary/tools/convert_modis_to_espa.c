@@ -17,6 +17,14 @@ NOTES:
 *****************************************************************************/
 #include <getopt.h>
 #include "convert_modis_to_espa.h"
+#include "espa_granule_batch.h"
+
+/* Options of the conversion of each granule */
+typedef struct
+{
+    bool del_src;         /* should source files be removed? */
+    bool browse;          /* should the browse be built? */
+} Modis_options_t;
 
 /******************************************************************************
 MODULE: usage
@@ -35,19 +43,54 @@ void usage ()
             "files).\n");
     printf ("version: %s\n\n", ESPA_COMMON_VERSION);
     printf ("usage: convert_modis_to_espa "
-            "--hdf=input_hdf_filename "
-            "[--del_src_files]\n");
+            "--hdf=input_hdf_filename [--hdf=input_hdf_filename ...] "
+            "[--del_src_files] [--browse] [--jobs=granules]\n");
 
     printf ("\nwhere the following parameters are required:\n");
     printf ("    -hdf: name of the input MODIS HDF file (MOD09/MYD09, "
-            "MOD11/MYD11, MOD13/MYD13)\n");
+            "MOD11/MYD11, MOD13/MYD13).  It may be repeated to convert a "
+            "batch of granules (ex. a time series) in one invocation.\n");
     printf ("    -del_src_files: if specified the source HDF file will "
             "be removed.\n");
+    printf ("    -browse: if specified a browse image of the granule "
+            "(a reduced resolution RGB PNG named after the XML file) is "
+            "built as the bands are converted\n");
+    printf ("    -jobs: number of granules of the batch converted at a time "
+            "(the default is 1)\n");
     printf ("\nExample: convert_modis_to_espa "
             "--hdf=MOD09A1.A2013241.h08v05.005.2013252120055.hdf\n");
 }
 
 
+/******************************************************************************
+MODULE:  convert_modis_granule
+
+PURPOSE:  Converts one MODIS granule of the batch (see convert_granule_batch).
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error doing the conversion
+SUCCESS         No errors encountered
+
+NOTES:
+******************************************************************************/
+static int convert_modis_granule
+(
+    char *hdf_infile,     /* I: input MODIS HDF filename */
+    char *xml_outfile,    /* I: output XML filename */
+    void *arg             /* I: options of the conversion
+                                (Modis_options_t *) */
+)
+{
+    Modis_options_t *options = arg;  /* options of the conversion */
+
+    return convert_modis_to_espa (hdf_infile, xml_outfile, options->del_src,
+        options->browse);
+}
+
+
 /******************************************************************************
 MODULE:  get_args
 
@@ -63,34 +106,41 @@ ERROR           Error getting the command-line arguments or a command-line
 SUCCESS         No errors encountered
 
 NOTES:
-  1. Memory is allocated for the input and output files.  All of these should
-     be character pointers set to NULL on input.  The caller is responsible
-     for freeing the allocated memory upon successful return.
+  1. Memory is allocated for the input HDF filenames, one per --hdf option.
+     The caller is responsible for freeing each filename and the array upon
+     successful return.
 ******************************************************************************/
 short get_args
 (
     int argc,             /* I: number of cmd-line args */
     char *argv[],         /* I: string of cmd-line args */
-    char **hdf_infile,    /* O: address of input MODIS HDF filename */
-    char **xml_outfile,   /* O: address of output XML filename */
-    bool *del_src         /* O: should source files be removed? */
+    char ***hdf_infiles,  /* O: address of input MODIS HDF filenames */
+    int *nhdf,            /* O: number of input MODIS HDF filenames */
+    bool *del_src,        /* O: should source files be removed? */
+    bool *browse,         /* O: should the browse be built? */
+    int *njobs            /* O: number of granules converted at a time */
 )
 {
     int c;                           /* current argument index */
     int option_index;                /* index for the command-line option */
-    char *cptr = NULL;               /* pointer to .hdf in HDF filename */
+    char **grown = NULL;             /* reallocated HDF filenames */
     char errmsg[STR_SIZE];           /* error message */
     char FUNC_NAME[] = "get_args";   /* function name */
     static int del_flag = 0;         /* flag for removing the source files */
+    static int browse_flag = 0;      /* flag for building the browse */
     static struct option long_options[] =
     {
         {"del_src_files", no_argument, &del_flag, 1},
+        {"browse", no_argument, &browse_flag, 1},
         {"hdf", required_argument, 0, 'i'},
+        {"jobs", required_argument, 0, 'j'},
         {"help", no_argument, 0, 'h'},
         {0, 0, 0, 0}
     };
 
     /* Loop through all the cmd-line options */
+    *hdf_infiles = NULL;
+    *nhdf = 0;
     opterr = 0;   /* turn off getopt_long error msgs as we'll print our own */
     while (1)
     {
@@ -114,8 +164,21 @@ short get_args
                 return (ERROR);
                 break;
 
-            case 'i':  /* MODIS HDF infile */
-                *hdf_infile = strdup (optarg);
+            case 'i':  /* MODIS HDF infile, one per granule */
+                grown = realloc (*hdf_infiles, (*nhdf + 1) * sizeof (char *));
+                if (grown == NULL)
+                {
+                    sprintf (errmsg, "Allocating memory for the HDF "
+                        "filenames");
+                    error_handler (true, FUNC_NAME, errmsg);
+                    return (ERROR);
+                }
+                *hdf_infiles = grown;
+                (*hdf_infiles)[(*nhdf)++] = strdup (optarg);
+                break;
+
+            case 'j':  /* granules at a time */
+                *njobs = atoi (optarg);
                 break;
      
             case '?':
@@ -129,7 +192,7 @@ short get_args
     }
 
     /* Make sure the input HDF file was specified */
-    if (*hdf_infile == NULL)
+    if (*nhdf == 0)
     {
         sprintf (errmsg, "MODIS HDF input file is a required argument");
         error_handler (true, FUNC_NAME, errmsg);
@@ -137,16 +200,11 @@ short get_args
         return (ERROR);
     }
 
-    /* Generate the XML filename from the HDF filename.  Find the .hdf and
-       change that to .xml. */
-    *xml_outfile = strdup (*hdf_infile);
-    cptr = strrchr (*xml_outfile, '.');
-    *cptr = '\0';
-    sprintf (*xml_outfile, "%s.xml", *xml_outfile);
-    if (*xml_outfile == NULL)
+    if (*njobs < 1)
     {
-        sprintf (errmsg, "XML output file was not correctly generated");
+        sprintf (errmsg, "Number of jobs must be positive");
         error_handler (true, FUNC_NAME, errmsg);
+        usage ();
         return (ERROR);
     }
 
@@ -154,6 +212,10 @@ short get_args
     if (del_flag)
         *del_src = true;
 
+    /* Check the browse flag */
+    if (browse_flag)
+        *browse = true;
+
     return (SUCCESS);
 }
 
@@ -161,7 +223,7 @@ short get_args
 /******************************************************************************
 MODULE:  main
 
-PURPOSE:  Converts the MODIS HDF product to the ESPA internal format (XML
+PURPOSE:  Converts the MODIS HDF products to the ESPA internal format (XML
 metadata file and associated raw binary files).
 
 RETURN VALUE:
@@ -172,30 +234,39 @@ ERROR           Error doing the conversion
 SUCCESS         No errors encountered
 
 NOTES:
+  1. The XML filename of each granule is its HDF filename with the .hdf
+     replaced by .xml.
 ******************************************************************************/
 int main (int argc, char** argv)
 {
-    char *hdf_infile = NULL;      /* input MODIS HDF filename */
-    char *xml_outfile = NULL;     /* output XML filename */
-    bool del_src = false;         /* should source files be removed? */
+    char **hdf_infiles = NULL;    /* input MODIS HDF filenames */
+    int nhdf = 0;                 /* number of input MODIS HDF filenames */
+    int njobs = 1;                /* number of granules converted at a time */
+    int i;                        /* looping variable for the granules */
+    Modis_options_t options;      /* options of the conversion */
 
     printf ("convert_modis_to_espa version: %s\n", ESPA_COMMON_VERSION);
 
     /* Read the command-line arguments */
-    if (get_args (argc, argv, &hdf_infile, &xml_outfile, &del_src) != SUCCESS)
+    options.del_src = false;
+    options.browse = false;
+    if (get_args (argc, argv, &hdf_infiles, &nhdf, &options.del_src,
+        &options.browse, &njobs) != SUCCESS)
     {   /* get_args already printed the error message */
         exit (EXIT_FAILURE);
     }
 
-    /* Convert the MODIS HDF and data to ESPA raw binary and XML */
-    if (convert_modis_to_espa (hdf_infile, xml_outfile, del_src) != SUCCESS)
+    /* Convert each MODIS HDF granule and data to ESPA raw binary and XML */
+    if (convert_granule_batch (nhdf, hdf_infiles, njobs,
+        convert_modis_granule, &options) != SUCCESS)
     {  /* Error messages already written */
         exit (EXIT_FAILURE);
     }
 
     /* Free the pointers */
-    free (hdf_infile);
-    free (xml_outfile);
+    for (i = 0; i < nhdf; i++)
+        free (hdf_infiles[i]);
+    free (hdf_infiles);
 
     /* Successful completion */
     exit (EXIT_SUCCESS);
@@ -0,0 +1,267 @@
+/*****************************************************************************
+FILE: convert_modis_to_formats
+
+PURPOSE: Contains functions for converting the MODIS products straight to
+the export formats (GeoTIFF and NetCDF), without the intermediate ESPA raw
+binary product.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The XML metadata format parsed or written via this library follows the
+     ESPA internal metadata format found in ESPA Raw Binary Format v1.0.doc.
+     The schema for the ESPA internal metadata format is available at
+     http://espa.cr.usgs.gov/schema/espa_internal_metadata_v1_0.xsd.
+  2. The products are the same as those of convert_modis_to_espa followed
+     by convert_espa_to_formats.
+*****************************************************************************/
+#include <getopt.h>
+#include "convert_modis_to_formats.h"
+
+/******************************************************************************
+MODULE: usage
+
+PURPOSE: Prints the usage information for this application.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+void usage ()
+{
+    printf ("convert_modis_to_formats converts the MODIS products straight "
+            "to GeoTIFF and/or NetCDF, reading each SDS only once and "
+            "without writing the ESPA internal format (XML metadata file "
+            "and associated raw binary files) unless asked for.\n");
+    printf ("version: %s\n\n", ESPA_COMMON_VERSION);
+    printf ("usage: convert_modis_to_formats "
+            "--hdf=input_hdf_filename "
+            "[--gtif=output_geotiff_base_filename] "
+            "[--netcdf=output_netcdf_filename] "
+            "[--xml=output_metadata_filename] "
+            "[--no_compression] [--del_src_files] "
+            "[--queue_blocks=blocks]\n");
+
+    printf ("\nwhere the following parameters are required:\n");
+    printf ("    -hdf: name of the input MODIS HDF file (MOD09/MYD09, "
+            "MOD11/MYD11, MOD13/MYD13)\n");
+    printf ("    and at least one of -gtif, -netcdf, and -xml\n");
+    printf ("\nand where the following parameters are optional:\n");
+    printf ("    -gtif: base filename of the output GeoTIFF files; the band "
+            "name of each band is appended\n");
+    printf ("    -netcdf: filename of the output NetCDF file\n");
+    printf ("    -xml: filename of the output ESPA XML metadata file; if "
+            "specified the raw binary files of the bands are written "
+            "too\n");
+    printf ("    -no_compression: if specified the NetCDF file will not be "
+            "compressed\n");
+    printf ("    -del_src_files: if specified the source HDF file will "
+            "be removed\n");
+    printf ("    -queue_blocks: number of blocks of lines held between the "
+            "reading of the SDSs and the writing of the formats, which "
+            "limits the memory used (the default is %d)\n",
+            DEFAULT_EXPORT_QUEUE_BLOCKS);
+    printf ("\nExample: convert_modis_to_formats "
+            "--hdf=MOD09A1.A2013241.h08v05.005.2013252120055.hdf "
+            "--netcdf=MOD09A1.A2013241.h08v05.005.2013252120055.nc\n");
+}
+
+
+/******************************************************************************
+MODULE:  get_args
+
+PURPOSE:  Gets the command-line arguments and validates that the required
+arguments were specified.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error getting the command-line arguments or a command-line
+                argument and associated value were not specified
+SUCCESS         No errors encountered
+
+NOTES:
+  1. Memory is allocated for the input and output files.  All of these should
+     be character pointers set to NULL on input.  The caller is responsible
+     for freeing the allocated memory upon successful return.
+******************************************************************************/
+short get_args
+(
+    int argc,              /* I: number of cmd-line args */
+    char *argv[],          /* I: string of cmd-line args */
+    char **hdf_infile,     /* O: address of input MODIS HDF filename */
+    char **gtif_outfile,   /* O: address of output GeoTIFF base filename */
+    char **netcdf_outfile, /* O: address of output NetCDF filename */
+    char **xml_outfile,    /* O: address of output XML filename */
+    bool *no_compression,  /* O: should the NetCDF file be uncompressed? */
+    bool *del_src,         /* O: should source files be removed? */
+    int *queue_blocks      /* O: number of blocks in flight */
+)
+{
+    int c;                           /* current argument index */
+    int option_index;                /* index for the command-line option */
+    char errmsg[STR_SIZE];           /* error message */
+    char FUNC_NAME[] = "get_args";   /* function name */
+    static int del_flag = 0;         /* flag for removing the source files */
+    static int no_compression_flag = 0;  /* flag for no NetCDF compression */
+    static struct option long_options[] =
+    {
+        {"del_src_files", no_argument, &del_flag, 1},
+        {"no_compression", no_argument, &no_compression_flag, 1},
+        {"hdf", required_argument, 0, 'i'},
+        {"gtif", required_argument, 0, 'g'},
+        {"netcdf", required_argument, 0, 'n'},
+        {"xml", required_argument, 0, 'x'},
+        {"queue_blocks", required_argument, 0, 'q'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    /* Loop through all the cmd-line options */
+    opterr = 0;   /* turn off getopt_long error msgs as we'll print our own */
+    while (1)
+    {
+        /* optstring in call to getopt_long is empty since we will only
+           support the long options */
+        c = getopt_long (argc, argv, "", long_options, &option_index);
+        if (c == -1)
+        {   /* Out of cmd-line options */
+            break;
+        }
+
+        switch (c)
+        {
+            case 0:
+                /* If this option set a flag, do nothing else now. */
+                if (long_options[option_index].flag != 0)
+                    break;
+
+            case 'h':  /* help */
+                usage ();
+                return (ERROR);
+                break;
+
+            case 'i':  /* MODIS HDF infile */
+                *hdf_infile = strdup (optarg);
+                break;
+
+            case 'g':  /* GeoTIFF base outfile */
+                *gtif_outfile = strdup (optarg);
+                break;
+
+            case 'n':  /* NetCDF outfile */
+                *netcdf_outfile = strdup (optarg);
+                break;
+
+            case 'x':  /* XML outfile */
+                *xml_outfile = strdup (optarg);
+                break;
+
+            case 'q':  /* blocks in flight */
+                *queue_blocks = atoi (optarg);
+                break;
+
+            case '?':
+            default:
+                sprintf (errmsg, "Unknown option %s", argv[optind-1]);
+                error_handler (true, FUNC_NAME, errmsg);
+                usage ();
+                return (ERROR);
+                break;
+        }
+    }
+
+    /* Make sure the infiles and outfiles were specified */
+    if (*hdf_infile == NULL)
+    {
+        sprintf (errmsg, "MODIS HDF input file is a required argument");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    if (*gtif_outfile == NULL && *netcdf_outfile == NULL &&
+        *xml_outfile == NULL)
+    {
+        sprintf (errmsg, "At least one of the GeoTIFF, NetCDF, and XML "
+            "outputs is required");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    if (*queue_blocks < 1)
+    {
+        sprintf (errmsg, "Number of queued blocks must be positive");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    /* Check the delete source files flag */
+    if (del_flag)
+        *del_src = true;
+
+    /* Check the "no compression" flag */
+    if (no_compression_flag)
+        *no_compression = true;
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  main
+
+PURPOSE:  Converts the MODIS HDF product straight to the requested export
+formats.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error doing the conversion
+SUCCESS         No errors encountered
+
+NOTES:
+******************************************************************************/
+int main (int argc, char** argv)
+{
+    char *hdf_infile = NULL;     /* input MODIS HDF filename */
+    char *gtif_outfile = NULL;   /* output GeoTIFF base filename */
+    char *netcdf_outfile = NULL; /* output NetCDF filename */
+    char *xml_outfile = NULL;    /* output XML filename */
+    bool no_compression = false; /* should the NetCDF be uncompressed? */
+    bool del_src = false;        /* should source files be removed? */
+    int queue_blocks = DEFAULT_EXPORT_QUEUE_BLOCKS;  /* blocks in flight */
+
+    printf ("convert_modis_to_formats version: %s\n", ESPA_COMMON_VERSION);
+
+    /* Read the command-line arguments */
+    if (get_args (argc, argv, &hdf_infile, &gtif_outfile, &netcdf_outfile,
+        &xml_outfile, &no_compression, &del_src, &queue_blocks) != SUCCESS)
+    {   /* get_args already printed the error message */
+        exit (EXIT_FAILURE);
+    }
+
+    /* Convert the MODIS HDF granule to all the formats */
+    if (convert_modis_to_formats (hdf_infile, gtif_outfile, netcdf_outfile,
+        xml_outfile, no_compression, del_src, queue_blocks) != SUCCESS)
+    {  /* Error messages already written */
+        exit (EXIT_FAILURE);
+    }
+
+    /* Free the pointers */
+    free (hdf_infile);
+    free (gtif_outfile);
+    free (netcdf_outfile);
+    free (xml_outfile);
+
+    /* Successful completion */
+    exit (EXIT_SUCCESS);
+}
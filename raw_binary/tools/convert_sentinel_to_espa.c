@@ -17,6 +17,7 @@ NOTES:
 *****************************************************************************/
 #include <getopt.h>
 #include "convert_sentinel_to_espa.h"
+#include "espa_task_pool.h"
 
 /******************************************************************************
 MODULE: usage
@@ -38,14 +39,66 @@ void usage ()
             "these two XML files and all 14 bands of the L1C JP2 files are "
             "needed. The rest of the SAFE directory structure and files are "
             "not needed. The executable must be run from the directory "
-            "containing the XML files and JP2 image data.\n");
+            "containing the XML files and JP2 image data, unless the "
+            "granules are given with -granule.\n");
     printf ("version: %s\n\n", ESPA_COMMON_VERSION);
-    printf ("usage: convert_sentinel_to_espa [--del_src_files]\n");
+    printf ("usage: convert_sentinel_to_espa [--del_src_files] "
+            "[--resolution=10|20|60] [--common_grid] "
+            "[--resample=method_list] [--source=product_url] [--browse] "
+            "[--granule=granule_dir_or_url ...] [--output_dir=directory] "
+            "[--jobs=number_of_granules] [--threads=number_of_threads]\n");
 
     printf ("\nwhere the following parameters are optional:\n");
     printf ("    -del_src_files: if specified the source JP2 file will "
             "be removed.\n");
-    printf ("\nExample: convert_sentinel_to_espa --del_src_files\n");
+    printf ("    -resolution: output resolution in meters of the bands "
+            "which are finer; they are decoded directly at that resolution "
+            "(the default is the native resolution of each band)\n");
+    printf ("    -common_grid: if specified the bands which are coarser than "
+            "the resolution are expanded to it too, so all the bands share "
+            "one grid.  Requires -resolution.\n");
+    printf ("    -resample: comma separated list of the resampling methods "
+            "of the bands whose resolution changes, each a method or "
+            "band:method (ex. bilinear,B10:replicate).  The methods are "
+            "mean (reduced bands only), replicate, and bilinear (expanded "
+            "bands only).  A method alone applies to all the bands it is "
+            "valid for.  The default is mean for the reduced bands and "
+            "replicate for the expanded bands.  Requires -resolution.\n");
+    printf ("    -source: http://, https://, or s3:// URL of the remote "
+            "directory holding the XML files and JP2 image data, which are "
+            "read from there instead of the current directory.  The XML "
+            "files are copied to the current directory, where the product "
+            "is written, and only the parts of the JP2 files which are "
+            "decoded are downloaded.  Requires the library to be built with "
+            "ENABLE_REMOTE=yes, and can't be used with -del_src_files.\n");
+    printf ("    -browse: if specified a browse image of the product (a "
+            "reduced resolution RGB PNG named after the XML file) is built "
+            "as the bands are decoded\n");
+    printf ("    -granule: directory (or http://, https://, or s3:// URL) "
+            "holding the XML files and JP2 image data of a granule.  May be "
+            "repeated; the granules are converted several at a time in this "
+            "process, sharing the threads, instead of the product in the "
+            "current directory.  Can't be used with -source.\n");
+    printf ("    -output_dir: directory the products of the granules are "
+            "written to (the default is the current directory)\n");
+    printf ("    -jobs: number of granules converted at the same time (the "
+            "default is one for each %d threads)\n",
+            SENTINEL_DEFAULT_DECODE_BANDS);
+    printf ("    -threads: number of threads shared by the granules and "
+            "their decoders (the default is the number of processors, or "
+            "the %s environment variable)\n", ESPA_THREADS_ENV);
+    printf ("\nWhen built with ENABLE_OPENJPEG=yes, the JP2 bands are "
+            "decoded in-process, otherwise with the GDAL gdal_translate "
+            "tool.  When built with ENABLE_THREADING=yes, %d bands are "
+            "decoded at a time unless the %s environment variable is set to "
+            "another number.\n", SENTINEL_DEFAULT_DECODE_BANDS,
+            SENTINEL_DECODE_BANDS_ENV);
+    printf ("\nExample: convert_sentinel_to_espa --del_src_files "
+            "--resolution=20\n");
+    printf ("Example: convert_sentinel_to_espa --resolution=10 "
+            "--common_grid --resample=bilinear\n");
+    printf ("Example: convert_sentinel_to_espa --granule=T10TFR_20180816 "
+            "--granule=T10TFS_20180816 --output_dir=espa --jobs=2\n");
 }
 
 
@@ -64,22 +117,49 @@ ERROR           Error getting the command-line arguments or a command-line
 SUCCESS         No errors encountered
 
 NOTES:
+  1. Memory is allocated for the list of granules, which the caller frees.
 ******************************************************************************/
 short get_args
 (
     int argc,             /* I: number of cmd-line args */
     char *argv[],         /* I: string of cmd-line args */
-    bool *del_src         /* O: should source files be removed? */
+    bool *del_src,        /* O: should source files be removed? */
+    int *resolution,      /* O: output resolution of the finer bands */
+    bool *common_grid,    /* O: should the coarser bands be expanded too? */
+    char **resample,      /* O: resampling methods of the bands; NULL for
+                                the defaults */
+    char **source,        /* O: URL of the remote product; NULL for the
+                                current directory */
+    bool *browse,         /* O: should the browse be built? */
+    int *ngranules,       /* O: number of granules of a batch */
+    char ***granules,     /* O: directory or URL of each granule of a
+                                batch; NULL if none */
+    char **out_dir,       /* O: directory of the products of a batch; NULL
+                                for the current directory */
+    int *njobs            /* O: number of granules converted at the same
+                                time; 0 for the default */
 )
 {
     int c;                           /* current argument index */
     int option_index;                /* index for the command-line option */
     char errmsg[STR_SIZE];           /* error message */
     char FUNC_NAME[] = "get_args";   /* function name */
+    char **list = NULL;              /* reallocated list of granules */
     static int del_flag = 0;         /* flag for removing the source files */
+    static int browse_flag = 0;      /* flag for building the browse */
+    static int grid_flag = 0;        /* flag for the common grid */
     static struct option long_options[] =
     {
         {"del_src_files", no_argument, &del_flag, 1},
+        {"browse", no_argument, &browse_flag, 1},
+        {"resolution", required_argument, 0, 'r'},
+        {"common_grid", no_argument, &grid_flag, 1},
+        {"resample", required_argument, 0, 'm'},
+        {"source", required_argument, 0, 's'},
+        {"granule", required_argument, 0, 'g'},
+        {"output_dir", required_argument, 0, 'o'},
+        {"jobs", required_argument, 0, 'j'},
+        {"threads", required_argument, 0, 't'},
         {"help", no_argument, 0, 'h'},
         {0, 0, 0, 0}
     };
@@ -108,6 +188,43 @@ short get_args
                 return (ERROR);
                 break;
 
+            case 'r':  /* output resolution */
+                *resolution = atoi (optarg);
+                break;
+
+            case 'm':  /* resampling methods */
+                *resample = strdup (optarg);
+                break;
+
+            case 's':  /* remote product */
+                *source = strdup (optarg);
+                break;
+
+            case 'g':  /* granule of a batch */
+                list = realloc (*granules, (*ngranules + 1)
+                    * sizeof (char *));
+                if (list == NULL)
+                {
+                    sprintf (errmsg, "Allocating memory for the granules");
+                    error_handler (true, FUNC_NAME, errmsg);
+                    return (ERROR);
+                }
+                *granules = list;
+                (*granules)[(*ngranules)++] = strdup (optarg);
+                break;
+
+            case 'o':  /* output directory of a batch */
+                *out_dir = strdup (optarg);
+                break;
+
+            case 'j':  /* number of granules at the same time */
+                *njobs = atoi (optarg);
+                break;
+
+            case 't':  /* number of threads */
+                espa_task_pool_set_threads (atoi (optarg));
+                break;
+
             case '?':
             default:
                 sprintf (errmsg, "Unknown option %s", argv[optind-1]);
@@ -118,10 +235,54 @@ short get_args
         }
     }
 
+    if (*resolution != 0 && *resolution != 10 && *resolution != 20 &&
+        *resolution != 60)
+    {
+        sprintf (errmsg, "Resolution must be 10, 20, or 60 meters");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    if (*ngranules > 0 && *source != NULL)
+    {
+        sprintf (errmsg, "The granules are each given as a directory or "
+            "URL, so -source can't be used with -granule");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    if (*ngranules == 0 && (*out_dir != NULL || *njobs != 0))
+    {
+        sprintf (errmsg, "The output directory and the number of jobs need "
+            "-granule");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    if (*resolution == 0 && (grid_flag || *resample != NULL))
+    {
+        sprintf (errmsg, "The common grid and the resampling methods need "
+            "a resolution");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    /* Check the common grid flag */
+    if (grid_flag)
+        *common_grid = true;
+
     /* Check the delete source files flag */
     if (del_flag)
         *del_src = true;
 
+    /* Check the browse flag */
+    if (browse_flag)
+        *browse = true;
+
     return (SUCCESS);
 }
 
@@ -144,20 +305,49 @@ NOTES:
 int main (int argc, char** argv)
 {
     bool del_src = false;         /* should source files be removed? */
+    int resolution = 0;           /* output resolution of the finer bands */
+    bool common_grid = false;     /* should the coarser bands be expanded? */
+    char *resample = NULL;        /* resampling methods of the bands */
+    char *source = NULL;          /* URL of the remote product */
+    bool browse = false;          /* should the browse be built? */
+    int ngranules = 0;            /* number of granules of a batch */
+    char **granules = NULL;       /* directory or URL of each granule */
+    char *out_dir = NULL;         /* directory of the products of a batch */
+    int njobs = 0;                /* number of granules at the same time */
+    int status;                   /* return status */
+    int i;                        /* looping variable */
 
     printf ("convert_sentinel_to_espa version: %s\n", ESPA_COMMON_VERSION);
 
     /* Read the command-line arguments */
-    if (get_args (argc, argv, &del_src) != SUCCESS)
+    if (get_args (argc, argv, &del_src, &resolution, &common_grid,
+        &resample, &source, &browse, &ngranules, &granules, &out_dir,
+        &njobs) != SUCCESS)
     {   /* get_args already printed the error message */
         exit (EXIT_FAILURE);
     }
 
-    /* Convert the Sentinel JP2 and data to ESPA raw binary and XML */
-    if (convert_sentinel_to_espa (del_src) != SUCCESS)
+    /* Convert the Sentinel JP2 and data to ESPA raw binary and XML, for
+       each granule of a batch or the product in the current directory */
+    if (ngranules > 0)
+    {
+        status = convert_sentinel_batch (ngranules, granules, out_dir,
+            del_src, resolution, common_grid, resample, browse, njobs);
+        shutdown_espa_xml ();
+    }
+    else
+        status = convert_sentinel_to_espa (source, del_src, resolution,
+            common_grid, resample, browse);
+    if (status != SUCCESS)
     {  /* Error messages already written */
         exit (EXIT_FAILURE);
     }
+    free (source);
+    free (resample);
+    for (i = 0; i < ngranules; i++)
+        free (granules[i]);
+    free (granules);
+    free (out_dir);
 
     /* Successful completion */
     exit (EXIT_SUCCESS);
@@ -17,6 +17,15 @@ NOTES:
 *****************************************************************************/
 #include <getopt.h>
 #include "convert_viirs_to_espa.h"
+#include "espa_granule_batch.h"
+
+/* Options of the conversion of each granule */
+typedef struct
+{
+    bool del_src;         /* should source files be removed? */
+    int memory_mb;        /* memory budget for the image data (MB) */
+    bool browse;          /* should the browse be built? */
+} Viirs_options_t;
 
 /******************************************************************************
 MODULE: usage
@@ -35,18 +44,58 @@ void usage ()
             "files).\n");
     printf ("version: %s\n\n", ESPA_COMMON_VERSION);
     printf ("usage: convert_viirs_to_espa "
-            "--hdf=input_hdf5_filename "
-            "[--del_src_files]\n");
+            "--hdf=input_hdf5_filename [--hdf=input_hdf5_filename ...] "
+            "[--del_src_files] [--memory_mb=megabytes] [--browse] "
+            "[--jobs=granules]\n");
 
     printf ("\nwhere the following parameters are required:\n");
-    printf ("    -hdf: name of the input VIIRS HDF5 file (VPN09GA)\n");
+    printf ("    -hdf: name of the input VIIRS HDF5 file (VPN09GA).  It may "
+            "be repeated to convert a batch of granules (ex. a time series) "
+            "in one invocation.\n");
     printf ("    -del_src_files: if specified the source HDF file will "
             "be removed.\n");
+    printf ("    -memory_mb: memory budget for the image data being "
+            "converted, which sets the number of lines converted at a time "
+            "(the default is %d MB)\n", VIIRS_DEFAULT_MEMORY_MB);
+    printf ("    -browse: if specified a browse image of the granule "
+            "(a reduced resolution RGB PNG named after the XML file) is "
+            "built as the bands are converted\n");
+    printf ("    -jobs: number of granules of the batch converted at a time, "
+            "each within its own memory budget (the default is 1)\n");
     printf ("\nExample: convert_viirs_to_espa "
             "--hdf=VNP09GA.A2012289.h09v05.001.2016325003544.h5\n");
 }
 
 
+/******************************************************************************
+MODULE:  convert_viirs_granule
+
+PURPOSE:  Converts one VIIRS granule of the batch (see convert_granule_batch).
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error doing the conversion
+SUCCESS         No errors encountered
+
+NOTES:
+******************************************************************************/
+static int convert_viirs_granule
+(
+    char *hdf_infile,     /* I: input VIIRS HDF5 filename */
+    char *xml_outfile,    /* I: output XML filename */
+    void *arg             /* I: options of the conversion
+                                (Viirs_options_t *) */
+)
+{
+    Viirs_options_t *options = arg;  /* options of the conversion */
+
+    return convert_viirs_to_espa (hdf_infile, xml_outfile, options->del_src,
+        options->memory_mb, options->browse);
+}
+
+
 /******************************************************************************
 MODULE:  get_args
 
@@ -62,34 +111,43 @@ ERROR           Error getting the command-line arguments or a command-line
 SUCCESS         No errors encountered
 
 NOTES:
-  1. Memory is allocated for the input and output files.  All of these should
-     be character pointers set to NULL on input.  The caller is responsible
-     for freeing the allocated memory upon successful return.
+  1. Memory is allocated for the input HDF5 filenames, one per --hdf option.
+     The caller is responsible for freeing each filename and the array upon
+     successful return.
 ******************************************************************************/
 short get_args
 (
     int argc,             /* I: number of cmd-line args */
     char *argv[],         /* I: string of cmd-line args */
-    char **hdf_infile,    /* O: address of input VIIRS HDF5 filename */
-    char **xml_outfile,   /* O: address of output XML filename */
-    bool *del_src         /* O: should source files be removed? */
+    char ***hdf_infiles,  /* O: address of input VIIRS HDF5 filenames */
+    int *nhdf,            /* O: number of input VIIRS HDF5 filenames */
+    bool *del_src,        /* O: should source files be removed? */
+    int *memory_mb,       /* O: memory budget for the image data (MB) */
+    bool *browse,         /* O: should the browse be built? */
+    int *njobs            /* O: number of granules converted at a time */
 )
 {
     int c;                           /* current argument index */
     int option_index;                /* index for the command-line option */
-    char *cptr = NULL;               /* pointer to .h5 in HDF5 filename */
+    char **grown = NULL;             /* reallocated HDF5 filenames */
     char errmsg[STR_SIZE];           /* error message */
     char FUNC_NAME[] = "get_args";   /* function name */
     static int del_flag = 0;         /* flag for removing the source files */
+    static int browse_flag = 0;      /* flag for building the browse */
     static struct option long_options[] =
     {
         {"del_src_files", no_argument, &del_flag, 1},
+        {"browse", no_argument, &browse_flag, 1},
         {"hdf", required_argument, 0, 'i'},
+        {"memory_mb", required_argument, 0, 'm'},
+        {"jobs", required_argument, 0, 'j'},
         {"help", no_argument, 0, 'h'},
         {0, 0, 0, 0}
     };
 
     /* Loop through all the cmd-line options */
+    *hdf_infiles = NULL;
+    *nhdf = 0;
     opterr = 0;   /* turn off getopt_long error msgs as we'll print our own */
     while (1)
     {
@@ -113,8 +171,25 @@ short get_args
                 return (ERROR);
                 break;
 
-            case 'i':  /* VIIRS HDF5 infile */
-                *hdf_infile = strdup (optarg);
+            case 'i':  /* VIIRS HDF5 infile, one per granule */
+                grown = realloc (*hdf_infiles, (*nhdf + 1) * sizeof (char *));
+                if (grown == NULL)
+                {
+                    sprintf (errmsg, "Allocating memory for the HDF5 "
+                        "filenames");
+                    error_handler (true, FUNC_NAME, errmsg);
+                    return (ERROR);
+                }
+                *hdf_infiles = grown;
+                (*hdf_infiles)[(*nhdf)++] = strdup (optarg);
+                break;
+
+            case 'm':  /* memory budget */
+                *memory_mb = atoi (optarg);
+                break;
+
+            case 'j':  /* granules at a time */
+                *njobs = atoi (optarg);
                 break;
      
             case '?':
@@ -128,7 +203,7 @@ short get_args
     }
 
     /* Make sure the input HDF5 file was specified */
-    if (*hdf_infile == NULL)
+    if (*nhdf == 0)
     {
         sprintf (errmsg, "VIIRS HDF5 input file is a required argument");
         error_handler (true, FUNC_NAME, errmsg);
@@ -136,16 +211,19 @@ short get_args
         return (ERROR);
     }
 
-    /* Generate the XML filename from the HDF5 filename.  Find the .h5 and
-       change that to .xml. */
-    *xml_outfile = strdup (*hdf_infile);
-    cptr = strrchr (*xml_outfile, '.');
-    *cptr = '\0';
-    sprintf (*xml_outfile, "%s.xml", *xml_outfile);
-    if (*xml_outfile == NULL)
+    if (*memory_mb < 1)
     {
-        sprintf (errmsg, "XML output file was not correctly generated");
+        sprintf (errmsg, "Memory budget must be positive");
         error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    if (*njobs < 1)
+    {
+        sprintf (errmsg, "Number of jobs must be positive");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
         return (ERROR);
     }
 
@@ -153,6 +231,10 @@ short get_args
     if (del_flag)
         *del_src = true;
 
+    /* Check the browse flag */
+    if (browse_flag)
+        *browse = true;
+
     return (SUCCESS);
 }
 
@@ -160,7 +242,7 @@ short get_args
 /******************************************************************************
 MODULE:  main
 
-PURPOSE:  Converts the VIIRS HDF5 product to the ESPA internal format (XML
+PURPOSE:  Converts the VIIRS HDF5 products to the ESPA internal format (XML
 metadata file and associated raw binary files).
 
 RETURN VALUE:
@@ -171,30 +253,38 @@ ERROR           Error doing the conversion
 SUCCESS         No errors encountered
 
 NOTES:
+  1. The XML filename of each granule is its HDF5 filename with the .h5
+     replaced by .xml.
 ******************************************************************************/
 int main (int argc, char** argv)
 {
-    char *hdf_infile = NULL;      /* input VIIRS HDF5 filename */
-    char *xml_outfile = NULL;     /* output XML filename */
-    bool del_src = false;         /* should source files be removed? */
+    char **hdf_infiles = NULL;    /* input VIIRS HDF5 filenames */
+    int nhdf = 0;                 /* number of input VIIRS HDF5 filenames */
+    int njobs = 1;                /* number of granules converted at a time */
+    int i;                        /* looping variable for the granules */
+    Viirs_options_t options = {false, VIIRS_DEFAULT_MEMORY_MB, false};
+                                  /* options of the conversion */
 
     printf ("convert_viirs_to_espa version: %s\n", ESPA_COMMON_VERSION);
 
     /* Read the command-line arguments */
-    if (get_args (argc, argv, &hdf_infile, &xml_outfile, &del_src) != SUCCESS)
+    if (get_args (argc, argv, &hdf_infiles, &nhdf, &options.del_src,
+        &options.memory_mb, &options.browse, &njobs) != SUCCESS)
     {   /* get_args already printed the error message */
         exit (EXIT_FAILURE);
     }
 
-    /* Convert the VIIRS HDF5 and data to ESPA raw binary and XML */
-    if (convert_viirs_to_espa (hdf_infile, xml_outfile, del_src) != SUCCESS)
+    /* Convert each VIIRS HDF5 granule and data to ESPA raw binary and XML */
+    if (convert_granule_batch (nhdf, hdf_infiles, njobs,
+        convert_viirs_granule, &options) != SUCCESS)
     {  /* Error messages already written */
         exit (EXIT_FAILURE);
     }
 
     /* Free the pointers */
-    free (hdf_infile);
-    free (xml_outfile);
+    for (i = 0; i < nhdf; i++)
+        free (hdf_infiles[i]);
+    free (hdf_infiles);
 
     /* Successful completion */
     exit (EXIT_SUCCESS);
@@ -0,0 +1,343 @@
+/*****************************************************************************
+FILE: create_angle_bands
+
+PURPOSE: Creates the per-pixel solar and view angle bands.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+*****************************************************************************/
+#include <getopt.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "error_handler.h"
+#include "parse_metadata.h"
+#include "write_metadata.h"
+#include "lazy_metadata.h"
+#include "raw_binary_io.h"
+#include "generate_angle_bands.h"
+
+/******************************************************************************
+MODULE: usage
+
+PURPOSE: Prints the usage information for this application.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+void usage ()
+{
+    printf ("create_angle_bands creates the solar zenith, solar azimuth, "
+            "sensor zenith, and sensor azimuth bands for the input scene, "
+            "holding the angles (hundredths of a degree) at the center of "
+            "each pixel of the representative band.  For a Sentinel-2 "
+            "scene the angles are interpolated from the grids of the tile "
+            "metadata.  For a Landsat scene the solar angles are computed "
+            "from the position of the sun at the scene center time.\n"
+            "The output filenames are the product ID with _solar_zenith.img, "
+            "_solar_azimuth.img, _sensor_zenith.img, and "
+            "_sensor_azimuth.img.\n");
+    printf ("version: %s\n\n", ESPA_COMMON_VERSION);
+    printf ("usage: create_angle_bands --xml=input_metadata_filename "
+            "[--tile_xml=sentinel_tile_metadata] [--band=band_name]\n");
+
+    printf ("\nwhere the following parameters are required:\n");
+    printf ("    -xml: name of the input XML metadata file which follows "
+            "the ESPA internal raw binary schema\n");
+    printf ("\nwhere the following parameters are optional:\n");
+    printf ("    -tile_xml: name of the Sentinel-2 tile metadata file "
+            "(MTD_TL.xml) holding the angle grids.  Without it the scene is "
+            "taken to be Landsat, and only the solar angle bands are "
+            "created.\n");
+    printf ("    -band: name of the representative band, whose grid the "
+            "angle bands follow and, for Sentinel-2, whose view angles are "
+            "used.  (default is b1 for Landsat and B02 for Sentinel-2)\n");
+    printf ("\nExample: create_angle_bands "
+            "--xml=LC08_L1TP_047027_20131014_20170308_02_T1.xml\n");
+}
+
+
+/******************************************************************************
+MODULE:  get_args
+
+PURPOSE:  Gets the command-line arguments and validates that the required
+arguments were specified.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error getting the command-line arguments or a command-line
+                argument and associated value were not specified
+SUCCESS         No errors encountered
+
+NOTES:
+  1. Memory is allocated for the input files and band name.  All of these
+     should be character pointers set to NULL on input.  The caller is
+     responsible for freeing the allocated memory upon successful return.
+******************************************************************************/
+short get_args
+(
+    int argc,             /* I: number of cmd-line args */
+    char *argv[],         /* I: string of cmd-line args */
+    char **xml_infile,    /* O: address of input XML filename */
+    char **tile_xml,      /* O: address of Sentinel tile metadata filename;
+                                NULL if not specified */
+    char **band_name      /* O: address of the representative band name;
+                                NULL if not specified */
+)
+{
+    int c;                           /* current argument index */
+    int option_index;                /* index for the command-line option */
+    char errmsg[STR_SIZE];           /* error message */
+    char FUNC_NAME[] = "get_args";   /* function name */
+    static struct option long_options[] =
+    {
+        {"xml", required_argument, 0, 'i'},
+        {"tile_xml", required_argument, 0, 't'},
+        {"band", required_argument, 0, 'b'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    /* Loop through all the cmd-line options */
+    opterr = 0;   /* turn off getopt_long error msgs as we'll print our own */
+    while (1)
+    {
+        /* optstring in call to getopt_long is empty since we will only
+           support the long options */
+        c = getopt_long (argc, argv, "", long_options, &option_index);
+        if (c == -1)
+        {   /* Out of cmd-line options */
+            break;
+        }
+
+        switch (c)
+        {
+            case 0:
+                /* If this option set a flag, do nothing else now. */
+                if (long_options[option_index].flag != 0)
+                    break;
+
+            case 'h':  /* help */
+                usage ();
+                return (ERROR);
+                break;
+
+            case 'i':  /* XML infile */
+                *xml_infile = strdup (optarg);
+                break;
+
+            case 't':  /* Sentinel tile metadata */
+                *tile_xml = strdup (optarg);
+                break;
+
+            case 'b':  /* representative band */
+                *band_name = strdup (optarg);
+                break;
+
+            case '?':
+            default:
+                sprintf (errmsg, "Unknown option %s", argv[optind-1]);
+                error_handler (true, FUNC_NAME, errmsg);
+                usage ();
+                return (ERROR);
+                break;
+        }
+    }
+
+    /* Make sure the infiles and outfiles were specified */
+    if (*xml_infile == NULL)
+    {
+        sprintf (errmsg, "XML input file is a required argument");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+#define MAX_DATE_LEN 28
+/******************************************************************************
+MODULE:  main
+
+PURPOSE: Creates the angle bands for the current scene.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error creating the angle bands
+SUCCESS         No errors encountered
+
+NOTES:
+  1. The output filenames are the product ID with the name of each angle
+     band and .img.
+  2. The bands are written out a block of lines at a time, so the full bands
+     are never held in memory.
+******************************************************************************/
+int main (int argc, char** argv)
+{
+    char FUNC_NAME[] = "create_angle_bands";  /* function name */
+    char errmsg[STR_SIZE];       /* error message */
+    char production_date[MAX_DATE_LEN+1]; /* current date/year for production */
+    char *espa_xml_file = NULL;  /* input ESPA XML metadata filename */
+    char *tile_xml_file = NULL;  /* Sentinel tile metadata filename */
+    char *band_name = NULL;      /* name of the representative band */
+    const char *rep_band = NULL; /* representative band used */
+    int rep_indx = -99;          /* index of the representative band */
+    int band_id;                 /* Sentinel band ID of the view angles */
+    int nbands;                  /* number of angle bands */
+    time_t tp;                   /* time structure */
+    struct tm *tm = NULL;        /* time structure for UTC time */
+    Espa_global_meta_t *gmeta = NULL; /* pointer to global metadata structure */
+    Espa_band_meta_t *bmeta = NULL;   /* pointer to band metadata structure */
+    Espa_internal_meta_t out_meta;     /* output metadata for bands */
+    Espa_angle_grids_t *grids = NULL;  /* angle grids of the scene */
+    Espa_lazy_meta_t *xml_metadata = NULL; /* XML metadata structure to be
+                                 populated by reading the XML metadata file;
+                                 only the representative band is decoded */
+
+    printf ("create_angle_bands version: %s\n", ESPA_COMMON_VERSION);
+
+    /* Read the command-line arguments */
+    if (get_args (argc, argv, &espa_xml_file, &tile_xml_file, &band_name)
+        != SUCCESS)
+    {   /* get_args already printed the error message */
+        exit (ERROR);
+    }
+
+    /* Validate the metadata file and parse the global metadata, indexing
+       the bands without decoding them */
+    xml_metadata = open_lazy_metadata (espa_xml_file, true);
+    if (xml_metadata == NULL)
+    {  /* Error messages already written */
+        exit (ERROR);
+    }
+    gmeta = &xml_metadata->meta.global;
+
+    /* Find the representative band, the only band decoded */
+    rep_band = band_name;
+    if (rep_band == NULL)
+        rep_band = (tile_xml_file != NULL) ? "B02" : "b1";
+    rep_indx = find_lazy_band (xml_metadata, rep_band, NULL);
+    if (rep_indx < 0)
+    {
+        sprintf (errmsg, "Band %s was not found in the XML file", rep_band);
+        error_handler (true, FUNC_NAME, errmsg);
+        exit (ERROR);
+    }
+    bmeta = get_lazy_band (xml_metadata, rep_indx);
+    if (bmeta == NULL)
+    {  /* Error messages already written */
+        exit (ERROR);
+    }
+
+    /* Read or compute the angle grids */
+    grids = malloc (sizeof (Espa_angle_grids_t));
+    if (grids == NULL)
+    {
+        sprintf (errmsg, "Allocating memory for the angle grids");
+        error_handler (true, FUNC_NAME, errmsg);
+        exit (ERROR);
+    }
+    if (tile_xml_file != NULL)
+    {
+        band_id = sentinel_angle_band_id (bmeta->name);
+        if (band_id < 0)
+        {
+            sprintf (errmsg, "Band %s is not a Sentinel-2 band", bmeta->name);
+            error_handler (true, FUNC_NAME, errmsg);
+            exit (ERROR);
+        }
+        if (read_sentinel_angle_grids (tile_xml_file, band_id, grids)
+            != SUCCESS)
+        {  /* Error messages already written */
+            exit (ERROR);
+        }
+    }
+    else if (compute_landsat_angle_grids (gmeta, bmeta, grids) != SUCCESS)
+    {  /* Error messages already written */
+        exit (ERROR);
+    }
+
+    /* Initialize the output metadata structure.  The global metadata will
+       not be used and will not be valid. */
+    init_metadata_struct (&out_meta);
+
+    /* Allocate memory for the output bands */
+    nbands = count_angle_bands (grids);
+    if (allocate_band_metadata (&out_meta, nbands) != SUCCESS)
+    {
+        sprintf (errmsg, "Cannot allocate memory for the angle bands");
+        error_handler (true, FUNC_NAME, errmsg);
+        exit (ERROR);
+    }
+
+    /* Get the current date/time (UTC) for the production date of each band */
+    if (time (&tp) == -1)
+    {
+        sprintf (errmsg, "Unable to obtain the current time.");
+        error_handler (true, FUNC_NAME, errmsg);
+        exit (ERROR);
+    }
+
+    tm = gmtime (&tp);
+    if (tm == NULL)
+    {
+        sprintf (errmsg, "Converting time to UTC.");
+        error_handler (true, FUNC_NAME, errmsg);
+        exit (ERROR);
+    }
+
+    if (strftime (production_date, MAX_DATE_LEN, "%Y-%m-%dT%H:%M:%SZ", tm) == 0)
+    {
+        sprintf (errmsg, "Formatting the production date/time.");
+        error_handler (true, FUNC_NAME, errmsg);
+        exit (ERROR);
+    }
+
+    /* Set up the angle bands */
+    if (setup_angle_bands (&xml_metadata->meta, bmeta, grids,
+        production_date, out_meta.band) != SUCCESS)
+    {  /* Error messages already written */
+        exit (ERROR);
+    }
+
+    /* Write out the pixels and the ENVI header of each band */
+    if (write_angle_bands (gmeta, bmeta, grids, out_meta.band) != SUCCESS)
+    {  /* Error messages already written */
+        exit (ERROR);
+    }
+
+    /* Append the angle bands to the XML file */
+    if (append_metadata (nbands, out_meta.band, espa_xml_file) != SUCCESS)
+    {
+        sprintf (errmsg, "Appending angle bands to the XML file.");
+        error_handler (true, FUNC_NAME, errmsg);
+        exit (ERROR);
+    }
+
+    /* Free the input and output XML metadata */
+    close_lazy_metadata (xml_metadata);
+    free_metadata (&out_meta);
+
+    /* Free the pointers */
+    free (grids);
+    free (espa_xml_file);
+    free (tile_xml_file);
+    free (band_name);
+
+    /* Successful completion */
+    exit (SUCCESS);
+}
@@ -17,9 +17,9 @@ NOTES:
 #include <time.h>
 
 #include "error_handler.h"
-#include "envi_header.h"
 #include "parse_metadata.h"
 #include "write_metadata.h"
+#include "lazy_metadata.h"
 #include "raw_binary_io.h"
 #include "generate_date_bands.h"
 
@@ -44,11 +44,18 @@ void usage ()
             "_doy.img, and _year.img for the combined date/year, day of year, "
             "and year bands respectively.\n");
     printf ("version: %s\n\n", ESPA_COMMON_VERSION);
-    printf ("usage: create_date_bands --xml=input_metadata_filename\n");
+    printf ("usage: create_date_bands --xml=input_metadata_filename "
+            "[--constant]\n");
 
     printf ("\nwhere the following parameters are required:\n");
     printf ("    -xml: name of the input XML metadata file which follows "
             "the ESPA internal raw binary schema\n");
+    printf ("\nwhere the following parameters are optional:\n");
+    printf ("    -constant: write the date bands to the XML file as "
+            "constant bands, which hold a single value and have no raw "
+            "binary files.  Their pixels are synthesized by the readers and "
+            "the exporters.  (default is to write out the raw binary "
+            "files)\n");
     printf ("\nExample: create_date_bands "
             "--xml=LC08_L1TP_047027_20131014_20170308_02_T1.xml\n");
 }
@@ -77,15 +84,19 @@ short get_args
 (
     int argc,             /* I: number of cmd-line args */
     char *argv[],         /* I: string of cmd-line args */
-    char **xml_infile     /* O: address of input XML filename */
+    char **xml_infile,    /* O: address of input XML filename */
+    bool *constant        /* O: should the date bands be written as constant
+                                bands? */
 )
 {
     int c;                           /* current argument index */
     int option_index;                /* index for the command-line option */
+    static int constant_flag = 0;    /* flag for writing constant bands */
     char errmsg[STR_SIZE];           /* error message */
     char FUNC_NAME[] = "get_args";   /* function name */
     static struct option long_options[] =
     {
+        {"constant", no_argument, &constant_flag, 1},
         {"xml", required_argument, 0, 'i'},
         {"help", no_argument, 0, 'h'},
         {0, 0, 0, 0}
@@ -138,6 +149,9 @@ short get_args
         return (ERROR);
     }
 
+    /* Check the constant flag */
+    *constant = constant_flag ? true : false;
+
     return (SUCCESS);
 }
 
@@ -162,98 +176,58 @@ NOTES:
      the combined date/year, day of year, and year bands respectively.
   2. It is expected this will be run on the XML file that contains the
      converted LPGS Level 1 bands.
+  3. Each date band holds a single value.  With --constant the bands are only
+     described in the XML file, as constant bands.  Otherwise their pixels
+     are written out a block of lines at a time, so the full bands are never
+     held in memory.
 ******************************************************************************/
 int main (int argc, char** argv)
 {
     char FUNC_NAME[] = "create_date_bands";  /* function name */
     char errmsg[STR_SIZE];       /* error message */
-    char tmpstr[STR_SIZE];       /* temporary filename */
-    char tmp_ext[STR_SIZE];      /* temporary filename extension */
-    char jfile[STR_SIZE];        /* output date filename */
     char production_date[MAX_DATE_LEN+1]; /* current date/year for production */
     char *espa_xml_file = NULL;  /* input ESPA XML metadata filename */
-    int i;                       /* looping variable */
-    int nlines;                  /* number of lines in date bands */
-    int nsamps;                  /* number of samples in date bands */
+    bool constant = false;       /* should the date bands be written as
+                                    constant bands? */
     int refl_indx = -99;         /* index of band1 or first band */
-    unsigned int *jdate_buff = NULL;   /* date buffer */
-    unsigned short *jdoy_buff = NULL;  /* DOY buffer */
-    unsigned short *jyear_buff = NULL; /* year buffer */
     time_t tp;                   /* time structure */
     struct tm *tm = NULL;        /* time structure for UTC time */
-    FILE *fptr=NULL;             /* file pointer */
-    Envi_header_t envi_hdr;      /* output ENVI header information */
     Espa_global_meta_t *gmeta = NULL; /* pointer to global metadata structure */
     Espa_band_meta_t *bmeta = NULL;   /* pointer to band metadata structure */
-    Espa_band_meta_t *out_bmeta = NULL;/* band metadata for bands */
     Espa_internal_meta_t out_meta;     /* output metadata for bands */
-    Espa_internal_meta_t xml_metadata; /* XML metadata structure to be populated
-                                          by reading the XML metadata file */
+    Espa_lazy_meta_t *xml_metadata = NULL; /* XML metadata structure to be
+                                 populated by reading the XML metadata file;
+                                 only band 1 is decoded */
 
     printf ("create_date_bands version: %s\n", ESPA_COMMON_VERSION);
 
     /* Read the command-line arguments */
-    if (get_args (argc, argv, &espa_xml_file) != SUCCESS)
+    if (get_args (argc, argv, &espa_xml_file, &constant) != SUCCESS)
     {   /* get_args already printed the error message */
         exit (ERROR);
     }
 
-    /* Validate the input metadata file */
-    if (validate_xml_file (espa_xml_file) != SUCCESS)
-    {  /* Error messages already written */
-        exit (ERROR);
-    }
-
-    /* Initialize the metadata structure */
-    init_metadata_struct (&xml_metadata);
-
-    /* Parse the metadata file into our internal metadata structure; also
-       allocates space as needed for various pointers in the global and band
-       metadata */
-    if (parse_metadata (espa_xml_file, &xml_metadata) != SUCCESS)
-    {  /* Error messages already written */
-        exit (ERROR);
-    }
-    gmeta = &xml_metadata.global;
-
-    /* Generate the date bands for this scene. Memory is allocated for the
-       buffers in this function call. */
-    if (generate_date_bands (&xml_metadata, &jdate_buff, &jdoy_buff,
-        &jyear_buff, &nlines, &nsamps) != SUCCESS)
+    /* Validate the metadata file and parse the global metadata, indexing
+       the bands without decoding them */
+    xml_metadata = open_lazy_metadata (espa_xml_file, true);
+    if (xml_metadata == NULL)
     {  /* Error messages already written */
         exit (ERROR);
     }
+    gmeta = &xml_metadata->meta.global;
 
-    /* Use band 1 as the representative band in the XML */
-    for (i = 0; i < xml_metadata.nbands; i++)
-    {
-        if (!strcmp (xml_metadata.band[i].name, "b1"))
-        {
-            /* this is the index we'll use for reflectance band info */
-            refl_indx = i;
-            break;
-        }
-    }
-
-    /* Make sure the representative band was found in the XML file */
-    if (refl_indx == -9)
+    /* Use band 1 as the representative band in the XML.  It is the only band
+       needed, so it is the only one decoded. */
+    refl_indx = find_lazy_band (xml_metadata, "b1", NULL);
+    if (refl_indx < 0)
     {
         sprintf (errmsg, "Band 1 (b1) was not found in the XML file");
         error_handler (true, FUNC_NAME, errmsg);
         exit (ERROR);
     }
-
-    /* Make sure the band 1 number of lines and samples matches what was used
-       for creating the date bands, otherwise we will have a mismatch in the
-       resolution and output XML information. */
-    bmeta = &xml_metadata.band[refl_indx];
-    if (nlines != bmeta->nlines || nsamps != bmeta->nsamps)
-    {
-        sprintf (errmsg, "Band 1 from this application does not match band 1 "
-            "from the generate_date_bands function call.  Local nlines/nsamps: "
-            "%d, %d   Returned nlines/nsamps: %d, %d", bmeta->nlines,
-            bmeta->nsamps, nlines, nsamps);
-        error_handler (true, FUNC_NAME, errmsg);
+    bmeta = get_lazy_band (xml_metadata, refl_indx);
+    if (bmeta == NULL)
+    {  /* Error messages already written */
         exit (ERROR);
     }
 
@@ -292,197 +266,17 @@ int main (int argc, char** argv)
         exit (ERROR);
     }
 
-    /* Loop through the three bands and append them to the XML file */
-    for (i = 0; i < 3; i++)
-    {
-        /* Set up the band metadata for the date bands */
-        out_bmeta = &out_meta.band[i];
-        strcpy (out_bmeta->product, "intermediate_data");
-        strcpy (out_bmeta->source, "level1");
-
-        /* Band-specific names */
-        switch (i)
-        {
-            case (0):  /* combined date/year */
-                strcpy (out_bmeta->name, "combined_date");
-                strcpy (out_bmeta->category, "image");
-                out_bmeta->data_type = ESPA_UINT32;
-                strncpy (tmpstr, bmeta->short_name, 4);
-                tmpstr[4] = '\0';
-                sprintf (out_bmeta->short_name, "%sDATE", tmpstr);
-                strcpy (out_bmeta->long_name,
-                    "doy and year (YEAR * 1000 + DOY)");
-                sprintf (tmp_ext, "date.img");
-                strcpy (out_bmeta->data_units, "date");
-                break;
-
-            case (1):  /* date */
-                strcpy (out_bmeta->name, "doy");
-                strcpy (out_bmeta->category, "image");
-                out_bmeta->data_type = ESPA_UINT16;
-                strncpy (tmpstr, bmeta->short_name, 4);
-                tmpstr[4] = '\0';
-                sprintf (out_bmeta->short_name, "%sDOY", tmpstr);
-                strcpy (out_bmeta->long_name, "day of year");
-                sprintf (tmp_ext, "doy.img");
-                out_bmeta->valid_range[0] = 1.0;
-                out_bmeta->valid_range[1] = 366.0;
-                strcpy (out_bmeta->data_units, "date");
-                break;
-
-            case (2):  /* year */
-                strcpy (out_bmeta->name, "year");
-                strcpy (out_bmeta->category, "image");
-                out_bmeta->data_type = ESPA_UINT16;
-                strncpy (tmpstr, bmeta->short_name, 4);
-                tmpstr[4] = '\0';
-                sprintf (out_bmeta->short_name, "%sYEAR", tmpstr);
-                strcpy (out_bmeta->long_name, "year");
-                sprintf (tmp_ext, "year.img");
-                out_bmeta->valid_range[0] = 1970.0;
-                out_bmeta->valid_range[1] = 9999.0;
-                strcpy (out_bmeta->data_units, "date");
-                break;
-        }
-
-        /* Use the product name to create the date filename */
-        snprintf (out_bmeta->file_name, sizeof (out_bmeta->file_name), "%s_%s",
-            gmeta->product_id, tmp_ext);
-
-        out_bmeta->resample_method = ESPA_NN;
-        out_bmeta->nlines = nlines;
-        out_bmeta->nsamps = nsamps;
-        out_bmeta->pixel_size[0] = bmeta->pixel_size[0];
-        out_bmeta->pixel_size[1] = bmeta->pixel_size[1];
-        strcpy (out_bmeta->pixel_units, bmeta->pixel_units);
-        sprintf (out_bmeta->app_version, "create_date_bands_%s",
-            ESPA_COMMON_VERSION);
-        strcpy (out_bmeta->production_date, production_date);
-    }
-
-    /** Write the date/year file **/
-    out_bmeta = &out_meta.band[0];
-    strcpy (jfile, out_bmeta->file_name);
-    fptr = open_raw_binary (jfile, "wb");
-    if (!fptr)
-    {
-        sprintf (errmsg, "Unable to open the date/year file: %s", jfile);
-        error_handler (true, FUNC_NAME, errmsg);
-        exit (ERROR);
-    }
-
-    /* Write the data for this band */
-    if (write_raw_binary (fptr, nlines, nsamps, sizeof (unsigned int),
-        jdate_buff) != SUCCESS)
-    {
-        sprintf (errmsg, "Unable to write to the date/year file");
-        error_handler (true, FUNC_NAME, errmsg);
-        exit (ERROR);
-    }
-
-    /* Close the file and free the pointer for this band */
-    close_raw_binary (fptr);
-    free (jdate_buff);
-
-    /* Create the ENVI header using the representative band */
-    if (create_envi_struct (out_bmeta, gmeta, &envi_hdr) != SUCCESS)
-    {
-        sprintf (errmsg, "Error creating the ENVI header file.");
-        error_handler (true, FUNC_NAME, errmsg);
-        exit (ERROR);
-    }
-
-    /* Write the ENVI header */
-    sprintf (tmpstr, "%s", jfile);
-    sprintf (&tmpstr[strlen(tmpstr)-3], "hdr");
-    if (write_envi_hdr (tmpstr, &envi_hdr) != SUCCESS)
-    {
-        sprintf (errmsg, "Writing the ENVI header file: %s.", tmpstr);
-        error_handler (true, FUNC_NAME, errmsg);
-        exit (ERROR);
-    }
-
-    /** Write the date file **/
-    out_bmeta = &out_meta.band[1];
-    strcpy (jfile, out_bmeta->file_name);
-    fptr = open_raw_binary (jfile, "wb");
-    if (!fptr)
-    {
-        sprintf (errmsg, "Unable to open the date file: %s", jfile);
-        error_handler (true, FUNC_NAME, errmsg);
-        exit (ERROR);
-    }
-
-    /* Write the data for this band */
-    if (write_raw_binary (fptr, nlines, nsamps, sizeof (unsigned short),
-        jdoy_buff) != SUCCESS)
-    {
-        sprintf (errmsg, "Unable to write to the date file");
-        error_handler (true, FUNC_NAME, errmsg);
-        exit (ERROR);
-    }
-
-    /* Close the file and free the pointer for this band */
-    close_raw_binary (fptr);
-    free (jdoy_buff);
-
-    /* Create the ENVI header using the representative band */
-    if (create_envi_struct (out_bmeta, gmeta, &envi_hdr) != SUCCESS)
-    {
-        sprintf (errmsg, "Error creating the ENVI header file.");
-        error_handler (true, FUNC_NAME, errmsg);
-        exit (ERROR);
-    }
-
-    /* Write the ENVI header */
-    sprintf (tmpstr, "%s", jfile);
-    sprintf (&tmpstr[strlen(tmpstr)-3], "hdr");
-    if (write_envi_hdr (tmpstr, &envi_hdr) != SUCCESS)
-    {
-        sprintf (errmsg, "Writing the ENVI header file: %s.", tmpstr);
-        error_handler (true, FUNC_NAME, errmsg);
-        exit (ERROR);
-    }
-
-    /** Write the year file **/
-    out_bmeta = &out_meta.band[2];
-    strcpy (jfile, out_bmeta->file_name);
-    fptr = open_raw_binary (jfile, "wb");
-    if (!fptr)
-    {
-        sprintf (errmsg, "Unable to open the year file: %s", jfile);
-        error_handler (true, FUNC_NAME, errmsg);
-        exit (ERROR);
-    }
-
-    /* Write the data for this band */
-    if (write_raw_binary (fptr, nlines, nsamps, sizeof (unsigned short),
-        jyear_buff) != SUCCESS)
-    {
-        sprintf (errmsg, "Unable to write to the year file");
-        error_handler (true, FUNC_NAME, errmsg);
-        exit (ERROR);
-    }
-
-    /* Close the file and free the pointer for this band */
-    close_raw_binary (fptr);
-    free (jyear_buff);
-
-    /* Create the ENVI header using the representative band */
-    if (create_envi_struct (out_bmeta, gmeta, &envi_hdr) != SUCCESS)
-    {
-        sprintf (errmsg, "Error creating the ENVI header file.");
-        error_handler (true, FUNC_NAME, errmsg);
+    /* Set up the three date bands as constant bands */
+    if (setup_date_bands (&xml_metadata->meta, bmeta, production_date,
+        out_meta.band) != SUCCESS)
+    {  /* Error messages already written */
         exit (ERROR);
     }
 
-    /* Write the ENVI header */
-    sprintf (tmpstr, "%s", jfile);
-    sprintf (&tmpstr[strlen(tmpstr)-3], "hdr");
-    if (write_envi_hdr (tmpstr, &envi_hdr) != SUCCESS)
-    {
-        sprintf (errmsg, "Writing the ENVI header file: %s.", tmpstr);
-        error_handler (true, FUNC_NAME, errmsg);
+    /* Write out the pixels and the ENVI header of each band, unless the
+       bands are to be left as constant bands */
+    if (!constant && write_date_bands (gmeta, out_meta.band) != SUCCESS)
+    {  /* Error messages already written */
         exit (ERROR);
     }
 
@@ -495,7 +289,7 @@ int main (int argc, char** argv)
     }
 
     /* Free the input and output XML metadata */
-    free_metadata (&xml_metadata);
+    close_lazy_metadata (xml_metadata);
     free_metadata (&out_meta);
 
     /* Free the pointers */
@@ -0,0 +1,301 @@
+/*****************************************************************************
+FILE: create_geolocation_bands
+
+PURPOSE: Creates the per-pixel latitude and longitude bands.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+*****************************************************************************/
+#include <getopt.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "error_handler.h"
+#include "parse_metadata.h"
+#include "write_metadata.h"
+#include "lazy_metadata.h"
+#include "raw_binary_io.h"
+#include "generate_geolocation_bands.h"
+
+/******************************************************************************
+MODULE: usage
+
+PURPOSE: Prints the usage information for this application.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+void usage ()
+{
+    printf ("create_geolocation_bands creates the latitude and longitude "
+            "bands for the input scene, holding the geographic coordinates "
+            "(degrees) of the center of each pixel.  The scene grid comes "
+            "from the projection information in the XML file and the size "
+            "of band 1.\n"
+            "The output filenames are the product ID with _lat.img and "
+            "_lon.img for the latitude and longitude bands respectively.\n");
+    printf ("version: %s\n\n", ESPA_COMMON_VERSION);
+    printf ("usage: create_geolocation_bands --xml=input_metadata_filename "
+            "[--max_error=pixels]\n");
+
+    printf ("\nwhere the following parameters are required:\n");
+    printf ("    -xml: name of the input XML metadata file which follows "
+            "the ESPA internal raw binary schema\n");
+    printf ("\nwhere the following parameters are optional:\n");
+    printf ("    -max_error: largest error, in pixels, allowed when "
+            "interpolating the pixels between exactly transformed grid "
+            "points.  0.0 transforms every pixel exactly.  (default is "
+            "%g)\n", GEOLOC_DEFAULT_MAX_ERROR);
+    printf ("\nExample: create_geolocation_bands "
+            "--xml=LC08_L1TP_047027_20131014_20170308_02_T1.xml\n");
+}
+
+
+/******************************************************************************
+MODULE:  get_args
+
+PURPOSE:  Gets the command-line arguments and validates that the required
+arguments were specified.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error getting the command-line arguments or a command-line
+                argument and associated value were not specified
+SUCCESS         No errors encountered
+
+NOTES:
+  1. Memory is allocated for the input and output files.  All of these should
+     be character pointers set to NULL on input.  The caller is responsible
+     for freeing the allocated memory upon successful return.
+******************************************************************************/
+short get_args
+(
+    int argc,             /* I: number of cmd-line args */
+    char *argv[],         /* I: string of cmd-line args */
+    char **xml_infile,    /* O: address of input XML filename */
+    double *max_error     /* O: largest interpolation error, in pixels */
+)
+{
+    int c;                           /* current argument index */
+    int option_index;                /* index for the command-line option */
+    char *endptr = NULL;             /* end of the parsed max error */
+    char errmsg[STR_SIZE];           /* error message */
+    char FUNC_NAME[] = "get_args";   /* function name */
+    static struct option long_options[] =
+    {
+        {"xml", required_argument, 0, 'i'},
+        {"max_error", required_argument, 0, 'e'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    /* Loop through all the cmd-line options */
+    *max_error = GEOLOC_DEFAULT_MAX_ERROR;
+    opterr = 0;   /* turn off getopt_long error msgs as we'll print our own */
+    while (1)
+    {
+        /* optstring in call to getopt_long is empty since we will only
+           support the long options */
+        c = getopt_long (argc, argv, "", long_options, &option_index);
+        if (c == -1)
+        {   /* Out of cmd-line options */
+            break;
+        }
+
+        switch (c)
+        {
+            case 0:
+                /* If this option set a flag, do nothing else now. */
+                if (long_options[option_index].flag != 0)
+                    break;
+
+            case 'h':  /* help */
+                usage ();
+                return (ERROR);
+                break;
+
+            case 'i':  /* XML infile */
+                *xml_infile = strdup (optarg);
+                break;
+
+            case 'e':  /* max interpolation error */
+                *max_error = strtod (optarg, &endptr);
+                if (endptr == optarg || *endptr != '\0' || *max_error < 0.0)
+                {
+                    sprintf (errmsg, "Invalid max_error: %s", optarg);
+                    error_handler (true, FUNC_NAME, errmsg);
+                    usage ();
+                    return (ERROR);
+                }
+                break;
+
+            case '?':
+            default:
+                sprintf (errmsg, "Unknown option %s", argv[optind-1]);
+                error_handler (true, FUNC_NAME, errmsg);
+                usage ();
+                return (ERROR);
+                break;
+        }
+    }
+
+    /* Make sure the infiles and outfiles were specified */
+    if (*xml_infile == NULL)
+    {
+        sprintf (errmsg, "XML input file is a required argument");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+#define MAX_DATE_LEN 28
+/******************************************************************************
+MODULE:  main
+
+PURPOSE: Creates the latitude and longitude bands for the current scene.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error creating the geolocation bands
+SUCCESS         No errors encountered
+
+NOTES:
+  1. The output filenames are the product ID with _lat.img and _lon.img for
+     the latitude and longitude bands respectively.
+  2. It is expected this will be run on the XML file that contains the
+     converted LPGS Level 1 bands.
+  3. The bands are written out a block of lines at a time, so the full bands
+     are never held in memory.
+******************************************************************************/
+int main (int argc, char** argv)
+{
+    char FUNC_NAME[] = "create_geolocation_bands";  /* function name */
+    char errmsg[STR_SIZE];       /* error message */
+    char production_date[MAX_DATE_LEN+1]; /* current date/year for production */
+    char *espa_xml_file = NULL;  /* input ESPA XML metadata filename */
+    double max_error;            /* largest interpolation error, in pixels */
+    int refl_indx = -99;         /* index of band1 or first band */
+    time_t tp;                   /* time structure */
+    struct tm *tm = NULL;        /* time structure for UTC time */
+    Espa_global_meta_t *gmeta = NULL; /* pointer to global metadata structure */
+    Espa_band_meta_t *bmeta = NULL;   /* pointer to band metadata structure */
+    Espa_internal_meta_t out_meta;     /* output metadata for bands */
+    Espa_lazy_meta_t *xml_metadata = NULL; /* XML metadata structure to be
+                                 populated by reading the XML metadata file;
+                                 only band 1 is decoded */
+
+    printf ("create_geolocation_bands version: %s\n", ESPA_COMMON_VERSION);
+
+    /* Read the command-line arguments */
+    if (get_args (argc, argv, &espa_xml_file, &max_error) != SUCCESS)
+    {   /* get_args already printed the error message */
+        exit (ERROR);
+    }
+
+    /* Validate the metadata file and parse the global metadata, indexing
+       the bands without decoding them */
+    xml_metadata = open_lazy_metadata (espa_xml_file, true);
+    if (xml_metadata == NULL)
+    {  /* Error messages already written */
+        exit (ERROR);
+    }
+    gmeta = &xml_metadata->meta.global;
+
+    /* Use band 1 as the representative band in the XML.  It is the only band
+       needed, so it is the only one decoded. */
+    refl_indx = find_lazy_band (xml_metadata, "b1", NULL);
+    if (refl_indx < 0)
+    {
+        sprintf (errmsg, "Band 1 (b1) was not found in the XML file");
+        error_handler (true, FUNC_NAME, errmsg);
+        exit (ERROR);
+    }
+    bmeta = get_lazy_band (xml_metadata, refl_indx);
+    if (bmeta == NULL)
+    {  /* Error messages already written */
+        exit (ERROR);
+    }
+
+    /* Initialize the output metadata structure.  The global metadata will
+       not be used and will not be valid. */
+    init_metadata_struct (&out_meta);
+
+    /* Allocate memory for two output bands */
+    if (allocate_band_metadata (&out_meta, 2) != SUCCESS)
+    {
+        sprintf (errmsg, "Cannot allocate memory for the geolocation bands");
+        error_handler (true, FUNC_NAME, errmsg);
+        exit (ERROR);
+    }
+
+    /* Get the current date/time (UTC) for the production date of each band */
+    if (time (&tp) == -1)
+    {
+        sprintf (errmsg, "Unable to obtain the current time.");
+        error_handler (true, FUNC_NAME, errmsg);
+        exit (ERROR);
+    }
+
+    tm = gmtime (&tp);
+    if (tm == NULL)
+    {
+        sprintf (errmsg, "Converting time to UTC.");
+        error_handler (true, FUNC_NAME, errmsg);
+        exit (ERROR);
+    }
+
+    if (strftime (production_date, MAX_DATE_LEN, "%Y-%m-%dT%H:%M:%SZ", tm) == 0)
+    {
+        sprintf (errmsg, "Formatting the production date/time.");
+        error_handler (true, FUNC_NAME, errmsg);
+        exit (ERROR);
+    }
+
+    /* Set up the latitude and longitude bands */
+    if (setup_geolocation_bands (&xml_metadata->meta, bmeta, production_date,
+        out_meta.band) != SUCCESS)
+    {  /* Error messages already written */
+        exit (ERROR);
+    }
+
+    /* Write out the pixels and the ENVI header of each band */
+    if (write_geolocation_bands (gmeta, bmeta, max_error, out_meta.band)
+        != SUCCESS)
+    {  /* Error messages already written */
+        exit (ERROR);
+    }
+
+    /* Append the geolocation bands to the XML file */
+    if (append_metadata (2, out_meta.band, espa_xml_file) != SUCCESS)
+    {
+        sprintf (errmsg, "Appending geolocation bands to the XML file.");
+        error_handler (true, FUNC_NAME, errmsg);
+        exit (ERROR);
+    }
+
+    /* Free the input and output XML metadata */
+    close_lazy_metadata (xml_metadata);
+    free_metadata (&out_meta);
+
+    /* Free the pointers */
+    free (espa_xml_file);
+
+    /* Successful completion */
+    exit (SUCCESS);
+}
@@ -1,8 +1,9 @@
 /*****************************************************************************
 FILE: create_land_water_mask
   
-PURPOSE: Creates the land/water mask for the current scene.  The land/water
-mask is generated from a static land-mass polygon.
+PURPOSE: Creates the land/water mask for the current scene, or for each of
+a batch of scenes.  The land/water mask is generated from a static land-mass
+polygon.
 
 PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
 at the USGS EROS
@@ -18,11 +19,10 @@ NOTES:
 #include <time.h>
 
 #include "error_handler.h"
-#include "envi_header.h"
 #include "parse_metadata.h"
 #include "write_metadata.h"
-#include "raw_binary_io.h"
 #include "generate_land_water_mask.h"
+#include "espa_trace.h"
 
 /******************************************************************************
 MODULE: usage
@@ -40,11 +40,32 @@ void usage ()
             "input scene, based on a static land-mass polygon.\n");
     printf ("version: %s\n\n", ESPA_COMMON_VERSION);
     printf ("usage: create_land_water_mask "
-            "--xml=input_metadata_filename\n");
+            "--xml=input_metadata_filename [--xml=input_metadata_filename "
+            "...] [--mask_format=byte|bitpacked|rle] [--coast_distance]\n");
 
     printf ("\nwhere the following parameters are required:\n");
     printf ("    -xml: name of the input XML metadata file which follows "
-            "the ESPA internal raw binary schema\n");
+            "the ESPA internal raw binary schema.  It may be repeated to "
+            "create the masks of a batch of scenes, loading the land-mass "
+            "polygon once.\n");
+
+    printf ("\nwhere the following parameters are optional:\n");
+    printf ("    -mask_format: encoding of the land/water mask file; byte "
+            "writes one uint8 per pixel with an ENVI header (default), "
+            "bitpacked writes one bit per pixel, and rle run-length encodes "
+            "each line.  The bitpacked and rle masks are written in blocks "
+            "with the encoding recorded in the XML, so the window reads "
+            "decode them to one uint8 per pixel.\n");
+    printf ("    -coast_distance: also write the distance to the coast band, "
+            "an int16 distance in meters from each pixel to the nearest "
+            "pixel of the other class, positive over land and negative "
+            "over water, saturated at +/-%d\n", LW_DISTANCE_MAX);
+    printf ("\nIf the ESPA_LAND_WATER_MASK_CACHE environment variable names a "
+            "directory, finished masks are cached there and reused for "
+            "scenes on the same grid.  If ESPA_LAND_WATER_MASK_MAX_ERROR is "
+            "set to a number of pixels, the transformation of the mask is "
+            "interpolated from a coarse grid wherever it stays within that "
+            "error.\n");
     printf ("\nExample: create_land_water_mask "
             "--xml=LC08_L1TP_047027_20131014_20170308_02_T1.xml\n");
 }
@@ -65,29 +86,39 @@ ERROR           Error getting the command-line arguments or a command-line
 SUCCESS         No errors encountered
 
 NOTES:
-  1. Memory is allocated for the input and output files.  All of these should
-     be character pointers set to NULL on input.  The caller is responsible
-     for freeing the allocated memory upon successful return.
+  1. Memory is allocated for the input XML filenames, one per --xml option.
+     The caller is responsible for freeing each filename and the array upon
+     successful return.
 ******************************************************************************/
 short get_args
 (
     int argc,             /* I: number of cmd-line args */
     char *argv[],         /* I: string of cmd-line args */
-    char **xml_infile     /* O: address of input XML filename */
+    char ***xml_infiles,  /* O: address of input XML filenames */
+    int *nxml,            /* O: number of input XML filenames */
+    Lw_mask_format_t *mask_format, /* O: encoding of the mask files */
+    bool *coast_distance  /* O: write the distance to the coast? */
 )
 {
     int c;                           /* current argument index */
     int option_index;                /* index for the command-line option */
+    char **grown = NULL;             /* reallocated XML filenames */
     char errmsg[STR_SIZE];           /* error message */
     char FUNC_NAME[] = "get_args";   /* function name */
     static struct option long_options[] =
     {
         {"xml", required_argument, 0, 'i'},
+        {"mask_format", required_argument, 0, 'm'},
+        {"coast_distance", no_argument, 0, 'd'},
         {"help", no_argument, 0, 'h'},
         {0, 0, 0, 0}
     };
 
     /* Loop through all the cmd-line options */
+    *xml_infiles = NULL;
+    *nxml = 0;
+    *mask_format = LW_MASK_BYTE;
+    *coast_distance = false;
     opterr = 0;   /* turn off getopt_long error msgs as we'll print our own */
     while (1)
     {
@@ -111,8 +142,36 @@ short get_args
                 return (ERROR);
                 break;
 
-            case 'i':  /* XML infile */
-            *xml_infile = strdup (optarg);
+            case 'i':  /* XML infile, one per scene */
+            grown = realloc (*xml_infiles, (*nxml + 1) * sizeof (char *));
+            if (grown == NULL)
+            {
+                sprintf (errmsg, "Allocating memory for the XML filenames");
+                error_handler (true, FUNC_NAME, errmsg);
+                return (ERROR);
+            }
+            *xml_infiles = grown;
+            (*xml_infiles)[(*nxml)++] = strdup (optarg);
+            break;
+
+            case 'm':  /* mask file encoding */
+            if (!strcmp (optarg, "byte"))
+                *mask_format = LW_MASK_BYTE;
+            else if (!strcmp (optarg, "bitpacked"))
+                *mask_format = LW_MASK_BITPACKED;
+            else if (!strcmp (optarg, "rle"))
+                *mask_format = LW_MASK_RLE;
+            else
+            {
+                sprintf (errmsg, "Unknown mask format %s", optarg);
+                error_handler (true, FUNC_NAME, errmsg);
+                usage ();
+                return (ERROR);
+            }
+            break;
+
+            case 'd':  /* distance to the coast */
+            *coast_distance = true;
             break;
 
             case '?':
@@ -126,7 +185,7 @@ short get_args
     }
 
     /* Make sure the infiles and outfiles were specified */
-    if (*xml_infile == NULL)
+    if (*nxml == 0)
     {
         sprintf (errmsg, "XML input file is a required argument");
         error_handler (true, FUNC_NAME, errmsg);
@@ -140,11 +199,11 @@ short get_args
 
 #define MAX_DATE_LEN 28
 /******************************************************************************
-MODULE:  main
+MODULE:  create_scene_land_water_mask
 
-PURPOSE: Creates the land/water mask for the current scene and write it to the
-output land/water mask file.  The land/water mask is generated from a static
-land-mass polygon.
+PURPOSE: Creates the land/water mask for one scene, writes it to the output
+land/water mask file, and appends it to the XML file of the scene.  The
+distance to the coast is written and appended after it if requested.
 
 RETURN VALUE:
 Type = int
@@ -154,185 +213,82 @@ ERROR           Error creating the land/water mask
 SUCCESS         No errors encountered
 
 NOTES:
-  1. The ESPA_LAND_MASS_POLYGON environment variable needs to be defined and
-     contain the full path and filename of the land-mass polygon to be used
-     to generate the land/water mask. It is recommended the land_no_buf.ply
-     polygon is used, which is delivered with this source code.
-  2. The land/water mask filename is the same as band 1 in the input XML file
-     with the _B1.img replaced with _land_water_mask.img.
+  1. The land/water mask filename is the same as band 1 in the input XML file
+     with the _B1.img replaced with _land_water_mask.img, or .bit/.rle for
+     the bit-packed and run-length encoded masks.  The distance to the coast
+     file ends in _coast_distance.img instead.
 ******************************************************************************/
-int main (int argc, char** argv)
+int create_scene_land_water_mask
+(
+    char *espa_xml_file,              /* I: input ESPA XML metadata filename */
+    const IAS_POLYGON_STORE *land_mass_store, /* I: opened land-mass polygon */
+    Lw_mask_format_t mask_format,     /* I: encoding of the mask file */
+    const Lw_mask_cache_t *mask_cache, /* I: cache of the land/water
+                                            masks; NULL if the cache isn't
+                                            used */
+    bool coast_distance               /* I: write the distance to the
+                                            coast? */
+)
 {
-    char FUNC_NAME[] = "create_land_water_mask";  /* function name */
+    char FUNC_NAME[] = "create_scene_land_water_mask";  /* function name */
     char errmsg[STR_SIZE];       /* error message */
-    char tmpstr[STR_SIZE];       /* temporary filename */
-    char maskfile[STR_SIZE];     /* output land/water mask filename */
     char production_date[MAX_DATE_LEN+1]; /* current date/time for production */
-    char *land_mass_polygon = NULL; /* filename of the land-mass polygon */
-    char *espa_xml_file = NULL;  /* input ESPA XML metadata filename */
-    char *cptr = NULL;           /* character pointer for the '_' in filename */
-    int i;                       /* looping variable */
-    int nlines;                  /* number of lines in the land/water mask */
-    int nsamps;                  /* number of samples in the land/water mask */
-    int refl_indx = -99;         /* index of band1 or first band */
-    unsigned char *land_water_mask = NULL;  /* land/water mask buffer */
+    int nout = coast_distance ? 2 : 1;  /* number of bands written */
+    int refl_indx;               /* index of band1 or first band */
     time_t tp;                   /* time structure */
     struct tm *tm = NULL;        /* time structure for UTC time */
-    FILE *fptr=NULL;             /* file pointer */
-    Envi_header_t envi_hdr;      /* output ENVI header information */
-    Espa_global_meta_t *gmeta = NULL; /* pointer to global metadata structure */
     Espa_band_meta_t *bmeta = NULL;   /* pointer to band metadata structure */
     Espa_band_meta_t *out_bmeta = NULL;/* band metadata for land-water mask */
     Espa_internal_meta_t out_meta;    /* output metadata for land-water mask */
     Espa_internal_meta_t xml_metadata;  /* XML metadata structure to be
                                 populated by reading the MTL metadata file */
 
-    printf ("create_land_water_mask version: %s\n", ESPA_COMMON_VERSION);
-
-    /* Read the command-line arguments */
-    if (get_args (argc, argv, &espa_xml_file) != SUCCESS)
-    {   /* get_args already printed the error message */
-        exit (ERROR);
-    }
-
-    /* Get the ESPA land/water mask environment variable which specifies the
-       location of the land-mass polygon to be used */
-    land_mass_polygon = getenv ("ESPA_LAND_MASS_POLYGON");
-    if (land_mass_polygon == NULL)
-    {
-        sprintf (errmsg, "ESPA_LAND_MASS_POLYGON environment variable is "
-            "not defined. Define the environment variable to contain the "
-            "full path and filename of the land-mass polygon to be used "
-            "to generate the land/water mask.\n");
-        error_handler (true, FUNC_NAME, errmsg);
-        exit (ERROR);
-    }
-    printf ("Using land-mass polygon file: %s\n", land_mass_polygon);
-
-    /* Validate the input metadata file */
-    if (validate_xml_file (espa_xml_file) != SUCCESS)
-    {  /* Error messages already written */
-        exit (ERROR);
-    }
-
     /* Initialize the metadata structure */
     init_metadata_struct (&xml_metadata);
 
-    /* Parse the metadata file into our internal metadata structure; also
-       allocates space as needed for various pointers in the global and band
-       metadata */
-    if (parse_metadata (espa_xml_file, &xml_metadata) != SUCCESS)
+    /* Validate the metadata file and parse it into our internal metadata
+       structure, reading the file only once; also allocates space as needed
+       for various pointers in the global and band metadata */
+    if (validate_and_parse_metadata (espa_xml_file, &xml_metadata) != SUCCESS)
     {  /* Error messages already written */
-        exit (ERROR);
-    }
-    gmeta = &xml_metadata.global;
-
-    /* Generate the land/water mask for this scene. Memory is allocated for
-       the land/water mask. */
-    if (generate_land_water_mask (&xml_metadata, land_mass_polygon,
-        &land_water_mask, &nlines, &nsamps) != SUCCESS)
-    {  /* Error messages already written */
-        exit (ERROR);
+        return (ERROR);
     }
 
     /* Use band 1 as the representative band in the XML */
-    for (i = 0; i < xml_metadata.nbands; i++)
-    {
-        if (!strcmp (xml_metadata.band[i].name, "b1"))
-        {
-            /* this is the index we'll use for reflectance band info */
-            refl_indx = i;
-            break;
-        }
-    }
+    refl_indx = espa_find_band (&xml_metadata, "b1");
 
     /* Make sure the representative band was found in the XML file */
-    if (refl_indx == -99)
+    if (refl_indx < 0)
     {
         sprintf (errmsg, "Band 1 (band1) was not found in the XML file");
         error_handler (true, FUNC_NAME, errmsg);
-        exit (ERROR);
+        free_metadata (&xml_metadata);
+        return (ERROR);
     }
-
-    /* Make sure the band 1 number of lines and samples matches what was used
-       for creating the land/water mask, otherwise we will have a mismatch
-       in the resolution and output XML information. */
     bmeta = &xml_metadata.band[refl_indx];
-    if (nlines != bmeta->nlines || nsamps != bmeta->nsamps)
-    {
-        sprintf (errmsg, "Band 1 from this application does not match band 1 "
-            "from the generate_land_water_mask function call.  Local nlines/"
-            "nsamps: %d, %d   Returned nlines/nsamps: %d, %d", bmeta->nlines,
-            bmeta->nsamps, nlines, nsamps);
-        error_handler (true, FUNC_NAME, errmsg);
-        exit (ERROR);
-    }
 
     /* Initialize the output metadata structure.  The global metadata will
        not be used and will not be valid. */
     init_metadata_struct (&out_meta);
 
-    /* Allocate memory for a single output band */
-    if (allocate_band_metadata (&out_meta, 1) != SUCCESS)
+    /* Allocate memory for the output bands */
+    if (allocate_band_metadata (&out_meta, nout) != SUCCESS)
     {
         sprintf (errmsg, "Cannot allocate memory for the land/water mask band");
         error_handler (true, FUNC_NAME, errmsg);
-        exit (ERROR);
+        free_metadata (&xml_metadata);
+        return (ERROR);
     }
     out_bmeta = &out_meta.band[0];
 
-    /* Set up the band metadata for the land/water mask */
-    strcpy (out_bmeta->product, "intermediate_data");
-    strcpy (out_bmeta->source, "level1");
-    strcpy (out_bmeta->name, "land_water_mask");
-    strcpy (out_bmeta->category, "qa");
-    out_bmeta->data_type = ESPA_UINT8;
-    out_bmeta->nlines = nlines;
-    out_bmeta->nsamps = nsamps;
-    strncpy (tmpstr, bmeta->short_name, 4);
-    tmpstr[4] = '\0';
-    sprintf (out_bmeta->short_name, "%sLWMASK", tmpstr);
-    strcpy (out_bmeta->long_name, "static land/water mask");
-    out_bmeta->pixel_size[0] = bmeta->pixel_size[0];
-    out_bmeta->pixel_size[1] = bmeta->pixel_size[1];
-    strcpy (out_bmeta->pixel_units, bmeta->pixel_units);
-    strcpy (out_bmeta->data_units, "quality/feature classification");
-    out_bmeta->valid_range[0] = 0.0;
-    out_bmeta->valid_range[1] = 1.0;
-    sprintf (out_bmeta->app_version, "create_land_water_mask_%s",
-        ESPA_COMMON_VERSION);
-
-    /* Use the band1 filename to create the land/mask filename */
-    strcpy (out_bmeta->file_name, bmeta->file_name);
-    cptr = strrchr (out_bmeta->file_name, '_');
-    if (!cptr)
-    {
-        sprintf (errmsg, "Unable to find the _ in the band 1 filename for "
-            "creating the land/water mask filename.");
-        error_handler (true, FUNC_NAME, errmsg);
-        exit (ERROR);
-    }
-    sprintf (cptr, "_land_water_mask.img");
-
-    /* Set up the 2 classes for land (1) and water (0) */
-    out_bmeta->nclass = 2;
-    if (allocate_class_metadata (out_bmeta, 2) != SUCCESS)
-    {
-        sprintf (errmsg, "Cannot allocate memory for the classes");
-        error_handler (true, FUNC_NAME, errmsg);
-        exit (ERROR);
-    }
-    out_bmeta->class_values[0].class = 0;
-    out_bmeta->class_values[1].class = 1;
-    strcpy (out_bmeta->class_values[0].description, "water");
-    strcpy (out_bmeta->class_values[1].description, "land");
-
     /* Get the current date/time (UTC) for the production date of each band */
     if (time (&tp) == -1)
     {
         sprintf (errmsg, "Unable to obtain the current time.");
         error_handler (true, FUNC_NAME, errmsg);
-        exit (ERROR);
+        free_metadata (&xml_metadata);
+        free_metadata (&out_meta);
+        return (ERROR);
     }
   
     tm = gmtime (&tp);
@@ -340,72 +296,165 @@ int main (int argc, char** argv)
     {
         sprintf (errmsg, "Converting time to UTC.");
         error_handler (true, FUNC_NAME, errmsg);
-        exit (ERROR);
+        free_metadata (&xml_metadata);
+        free_metadata (&out_meta);
+        return (ERROR);
     }
   
     if (strftime (production_date, MAX_DATE_LEN, "%Y-%m-%dT%H:%M:%SZ", tm) == 0)
     {
         sprintf (errmsg, "Formatting the production date/time.");
         error_handler (true, FUNC_NAME, errmsg);
-        exit (ERROR);
+        free_metadata (&xml_metadata);
+        free_metadata (&out_meta);
+        return (ERROR);
     }
-    strcpy (out_bmeta->production_date, production_date);
 
-    /* Write the land/water mask file */
-    strcpy (maskfile, out_bmeta->file_name);
-    fptr = open_raw_binary (maskfile, "wb");
-    if (!fptr)
-    {
-        sprintf (errmsg, "Unable to open the land/water mask file");
-        error_handler (true, FUNC_NAME, errmsg);
-        exit (ERROR);
+    /* Generate the land/water mask for this scene and write it, along with
+       its ENVI header */
+    if (write_land_water_mask (&xml_metadata, land_mass_store, bmeta,
+        production_date, mask_format, mask_cache, out_bmeta,
+        coast_distance ? &out_meta.band[1] : NULL) != SUCCESS)
+    {  /* Error messages already written */
+        free_metadata (&xml_metadata);
+        free_metadata (&out_meta);
+        return (ERROR);
     }
 
-    /* Write the data for this band */
-    if (write_raw_binary (fptr, nlines, nsamps, sizeof (unsigned char),
-        land_water_mask) != SUCCESS)
+    /* Append the land/water mask band, and the distance to the coast, to
+       the XML file */
+    if (append_metadata (nout, out_bmeta, espa_xml_file) != SUCCESS)
     {
-        sprintf (errmsg, "Unable to write to the land/water mask file");
+        sprintf (errmsg, "Appending land/water mask to the XML file.");
         error_handler (true, FUNC_NAME, errmsg);
-        exit (ERROR);
+        free_metadata (&xml_metadata);
+        free_metadata (&out_meta);
+        return (ERROR);
     }
 
-    /* Close the file and free the pointer for this band */
-    close_raw_binary (fptr);
-    free (land_water_mask);
+    /* Free the input and output XML metadata */
+    free_metadata (&xml_metadata);
+    free_metadata (&out_meta);
 
-    /* Create the ENVI header using the representative band */
-    if (create_envi_struct (out_bmeta, gmeta, &envi_hdr) != SUCCESS)
-    {
-        sprintf (errmsg, "Error creating the ENVI header file.");
-        error_handler (true, FUNC_NAME, errmsg);
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  main
+
+PURPOSE: Creates the land/water mask for each input scene and write it to the
+output land/water mask file.  The land/water mask is generated from a static
+land-mass polygon.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error creating the land/water mask of one or more scenes
+SUCCESS         No errors encountered
+
+NOTES:
+  1. The ESPA_LAND_MASS_POLYGON environment variable needs to be defined and
+     contain the full path and filename of the land-mass polygon to be used
+     to generate the land/water mask. It is recommended the land_no_buf.ply
+     polygon is used, which is delivered with this source code.
+  2. The land-mass polygon is opened once and shared by all the scenes.  When
+     it is indexed it is mapped read-only, so concurrent runs on a node also
+     share its pages.
+  3. A scene that fails is reported and the remaining scenes are still
+     processed.
+  4. If the ESPA_LAND_WATER_MASK_CACHE environment variable names a
+     directory, the finished masks are cached there by grid, and scenes on a
+     grid which was already cached (repeat path/rows, ARD or MODIS tiles)
+     reuse the cached mask instead of generating it.
+******************************************************************************/
+int main (int argc, char** argv)
+{
+    char FUNC_NAME[] = "create_land_water_mask";  /* function name */
+    char errmsg[STR_SIZE];       /* error message */
+    char *land_mass_polygon = NULL; /* filename of the land-mass polygon */
+    char **espa_xml_files = NULL;/* input ESPA XML metadata filenames */
+    int nxml = 0;                /* number of input XML files */
+    int nfailed = 0;             /* number of scenes which failed */
+    int i;                       /* looping variable */
+    Lw_mask_format_t mask_format;/* encoding of the mask files */
+    bool coast_distance;         /* write the distance to the coast? */
+    Lw_mask_cache_t mask_cache;  /* cache of the land/water masks */
+    bool use_cache = false;      /* is the cache used? */
+    IAS_POLYGON_STORE *land_mass_store = NULL; /* opened land-mass polygon */
+    Espa_trace_span_t span;      /* timing of opening the polygon */
+
+    printf ("create_land_water_mask version: %s\n", ESPA_COMMON_VERSION);
+
+    /* Read the command-line arguments */
+    if (get_args (argc, argv, &espa_xml_files, &nxml, &mask_format,
+        &coast_distance) != SUCCESS)
+    {   /* get_args already printed the error message */
         exit (ERROR);
     }
 
-    /* Write the ENVI header */
-    sprintf (tmpstr, "%s", maskfile);
-    sprintf (&tmpstr[strlen(tmpstr)-3], "hdr");
-    if (write_envi_hdr (tmpstr, &envi_hdr) != SUCCESS)
+    /* Get the ESPA land/water mask environment variable which specifies the
+       location of the land-mass polygon to be used */
+    land_mass_polygon = getenv ("ESPA_LAND_MASS_POLYGON");
+    if (land_mass_polygon == NULL)
     {
-        sprintf (errmsg, "Writing the ENVI header file: %s.", tmpstr);
+        sprintf (errmsg, "ESPA_LAND_MASS_POLYGON environment variable is "
+            "not defined. Define the environment variable to contain the "
+            "full path and filename of the land-mass polygon to be used "
+            "to generate the land/water mask.\n");
         error_handler (true, FUNC_NAME, errmsg);
         exit (ERROR);
     }
+    printf ("Using land-mass polygon file: %s\n", land_mass_polygon);
 
-    /* Append the land/water mask band to the XML file */
-    if (append_metadata (1, out_bmeta, espa_xml_file) != SUCCESS)
+    /* Open the land-mass polygon once for all the scenes */
+    span = espa_trace_begin ("mask_open_polygon", land_mass_polygon);
+    land_mass_store = ias_geo_open_polygon_store (land_mass_polygon);
+    espa_trace_end (&span);
+    if (land_mass_store == NULL)
     {
-        sprintf (errmsg, "Appending land/water mask to the XML file.");
+        sprintf (errmsg, "Opening the land-mass polygon file: %s",
+            land_mass_polygon);
         error_handler (true, FUNC_NAME, errmsg);
         exit (ERROR);
     }
 
-    /* Free the input and output XML metadata */
-    free_metadata (&xml_metadata);
-    free_metadata (&out_meta);
+    /* Look up and populate the mask cache if it's turned on */
+    use_cache = init_lw_mask_cache (land_mass_polygon, &mask_cache);
+    if (use_cache)
+        printf ("Using land/water mask cache: %s\n", mask_cache.dir);
+
+    /* Create the land/water mask of each scene */
+    for (i = 0; i < nxml; i++)
+    {
+        if (nxml > 1)
+            printf ("Processing scene %d of %d: %s\n", i + 1, nxml,
+                espa_xml_files[i]);
+
+        if (create_scene_land_water_mask (espa_xml_files[i], land_mass_store,
+            mask_format, use_cache ? &mask_cache : NULL, coast_distance)
+            != SUCCESS)
+        {
+            sprintf (errmsg, "Creating the land/water mask for %s",
+                espa_xml_files[i]);
+            error_handler (true, FUNC_NAME, errmsg);
+            nfailed++;
+        }
+        free (espa_xml_files[i]);
+    }
+    ias_geo_close_polygon_store (land_mass_store);
 
     /* Free the pointers */
-    free (espa_xml_file);
+    free (espa_xml_files);
+
+    if (nfailed > 0)
+    {
+        sprintf (errmsg, "The land/water mask failed for %d of %d scenes",
+            nfailed, nxml);
+        error_handler (true, FUNC_NAME, errmsg);
+        exit (ERROR);
+    }
 
     /* Successful completion */
     exit (SUCCESS);
@@ -0,0 +1,271 @@
+/*****************************************************************************
+FILE: encode_espa_bands
+
+PURPOSE: Contains functions for rewriting the raw binary bands of an ESPA
+product as block-compressed or tiled bands, or back to plain raw binary.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The XML metadata format parsed or written via this library follows the
+     ESPA internal metadata format found in ESPA Raw Binary Format v1.0.doc.
+     The schema for the ESPA internal metadata format is available at
+     http://espa.cr.usgs.gov/schema/espa_internal_metadata_vX_X.xsd.
+  2. The encoding attribute of each band in the XML records the encoding of
+     its file, and the tile_size attribute the size of the tiles of a tiled
+     file.
+*****************************************************************************/
+#include <getopt.h>
+#include "parse_metadata.h"
+#include "write_metadata.h"
+#include "espa_band_stack.h"
+
+/******************************************************************************
+MODULE: usage
+
+PURPOSE: Prints the usage information for this application.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+void usage ()
+{
+    printf ("encode_espa_bands rewrites the raw binary bands of the ESPA "
+            "internal format with the specified encoding: blocks of lines "
+            "compressed with zlib or zstd, with an index of the blocks so "
+            "windows can still be read directly, square tiles of pixels so "
+            "a window (i.e. a chip) is read with a few contiguous reads, "
+            "blocks of 8-bit lines bit-packed or run-length encoded (i.e. "
+            "for masks), or plain raw binary.  The XML metadata file is "
+            "updated with the new band files.\n");
+    printf ("version: %s\n\n", ESPA_COMMON_VERSION);
+    printf ("usage: encode_espa_bands "
+            "--xml=input_metadata_filename "
+            "--encoding=%s|%s|%s|%s|%s|%s [--tile_size=pixels]\n",
+            RB_ENCODING_RAW_NAME, RB_ENCODING_ZLIB_NAME,
+            RB_ENCODING_ZSTD_NAME, RB_ENCODING_TILES_NAME,
+            RB_ENCODING_BITPACKED_NAME, RB_ENCODING_RLE_NAME);
+
+    printf ("\nwhere the following parameters are required:\n");
+    printf ("    -xml: name of the input XML metadata file which follows "
+            "the ESPA internal raw binary schema\n");
+    printf ("    -encoding: encoding of the band files (%s requires the "
+            "library to be built with ENABLE_ZSTD=yes; %s and %s are only "
+            "for 8-bit bands, and %s only for values of 0 and 1)\n",
+            RB_ENCODING_ZSTD_NAME, RB_ENCODING_BITPACKED_NAME,
+            RB_ENCODING_RLE_NAME, RB_ENCODING_BITPACKED_NAME);
+    printf ("\nwhere the following parameters are optional:\n");
+    printf ("    -tile_size: number of lines and samples in each tile of the "
+            "%s encoding.  The default is %d.\n", RB_ENCODING_TILES_NAME,
+            RB_TILES_DEFAULT_SIZE);
+    printf ("\nExample: encode_espa_bands "
+            "--xml=LE07_L1TP_022033_20140228_20161028_02_T1.xml "
+            "--encoding=%s\n", RB_ENCODING_ZLIB_NAME);
+    printf ("\nExample: encode_espa_bands "
+            "--xml=LE07_L1TP_022033_20140228_20161028_02_T1.xml "
+            "--encoding=%s --tile_size=512\n", RB_ENCODING_TILES_NAME);
+}
+
+
+/******************************************************************************
+MODULE:  get_args
+
+PURPOSE:  Gets the command-line arguments and validates that the required
+arguments were specified.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error getting the command-line arguments or a command-line
+                argument and associated value were not specified
+SUCCESS         No errors encountered
+
+NOTES:
+  1. Memory is allocated for the input file.  This should be a character
+     pointer set to NULL on input.  The caller is responsible for freeing the
+     allocated memory upon successful return.
+******************************************************************************/
+short get_args
+(
+    int argc,              /* I: number of cmd-line args */
+    char *argv[],          /* I: string of cmd-line args */
+    char **xml_infile,     /* O: address of input XML filename */
+    Raw_binary_encoding_t *encoding, /* O: encoding of the band files */
+    int *tile_size         /* O: number of lines and samples per tile; 0
+                                 for the default */
+)
+{
+    int c;                           /* current argument index */
+    int option_index;                /* index for the command-line option */
+    bool encoding_set = false;       /* was the encoding specified? */
+    char errmsg[STR_SIZE];           /* error message */
+    char FUNC_NAME[] = "get_args";   /* function name */
+    static struct option long_options[] =
+    {
+        {"xml", required_argument, 0, 'i'},
+        {"encoding", required_argument, 0, 'e'},
+        {"tile_size", required_argument, 0, 't'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    /* Loop through all the cmd-line options */
+    opterr = 0;   /* turn off getopt_long error msgs as we'll print our own */
+    while (1)
+    {
+        /* optstring in call to getopt_long is empty since we will only
+           support the long options */
+        c = getopt_long (argc, argv, "", long_options, &option_index);
+        if (c == -1)
+        {   /* Out of cmd-line options */
+            break;
+        }
+
+        switch (c)
+        {
+            case 0:
+                /* If this option set a flag, do nothing else now. */
+                if (long_options[option_index].flag != 0)
+                    break;
+
+            case 'h':  /* help */
+                usage ();
+                return (ERROR);
+                break;
+
+            case 'i':  /* XML infile */
+                *xml_infile = strdup (optarg);
+                break;
+
+            case 'e':  /* encoding */
+                if (parse_raw_binary_encoding (optarg, encoding) != SUCCESS)
+                {  /* Error message already written */
+                    usage ();
+                    return (ERROR);
+                }
+                encoding_set = true;
+                break;
+
+            case 't':  /* tile size */
+                *tile_size = atoi (optarg);
+                if (*tile_size <= 0)
+                {
+                    sprintf (errmsg, "Tile size must be positive: %s",
+                        optarg);
+                    error_handler (true, FUNC_NAME, errmsg);
+                    usage ();
+                    return (ERROR);
+                }
+                break;
+
+            case '?':
+            default:
+                sprintf (errmsg, "Unknown option %s", argv[optind-1]);
+                error_handler (true, FUNC_NAME, errmsg);
+                usage ();
+                return (ERROR);
+                break;
+        }
+    }
+
+    /* Make sure the infile and encoding were specified */
+    if (*xml_infile == NULL)
+    {
+        sprintf (errmsg, "XML input file is a required argument");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    if (!encoding_set)
+    {
+        sprintf (errmsg, "Encoding is a required argument");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  main
+
+PURPOSE:  Rewrites the bands of the ESPA product with the specified encoding
+and updates the XML metadata file.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error rewriting the bands
+SUCCESS         No errors encountered
+
+NOTES:
+  1. The XML file is written even if a band fails, so it references the files
+     of the bands which were already rewritten.
+******************************************************************************/
+int main (int argc, char** argv)
+{
+    char FUNC_NAME[] = "main";   /* function name */
+    char errmsg[STR_SIZE];       /* error message */
+    char *xml_infile = NULL;     /* input XML filename */
+    int i;                       /* looping variable for the bands */
+    int status = SUCCESS;        /* status of rewriting the bands */
+    int tile_size = 0;           /* number of lines and samples per tile */
+    Raw_binary_encoding_t encoding = RB_ENCODING_RAW;  /* new encoding */
+    Espa_internal_meta_t xml_metadata;  /* XML metadata structure */
+
+    printf ("encode_espa_bands version: %s\n", ESPA_COMMON_VERSION);
+
+    /* Read the command-line arguments */
+    if (get_args (argc, argv, &xml_infile, &encoding, &tile_size) != SUCCESS)
+    {   /* get_args already printed the error message */
+        exit (EXIT_FAILURE);
+    }
+
+    /* Validate the metadata file and parse it into our internal metadata
+       structure */
+    init_metadata_struct (&xml_metadata);
+    if (validate_and_parse_metadata (xml_infile, &xml_metadata) != SUCCESS)
+    {  /* Error messages already written */
+        exit (EXIT_FAILURE);
+    }
+
+    /* Rewrite each band */
+    for (i = 0; i < xml_metadata.nbands; i++)
+    {
+        if (encode_espa_band (&xml_metadata, i, encoding, tile_size)
+            != SUCCESS)
+        {
+            sprintf (errmsg, "Encoding band %s as %s",
+                xml_metadata.band[i].name,
+                raw_binary_encoding_name (encoding));
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+            break;
+        }
+    }
+
+    /* Write the metadata back out, which now references the new files */
+    if (write_metadata (&xml_metadata, xml_infile) != SUCCESS)
+    {  /* Error messages already written */
+        exit (EXIT_FAILURE);
+    }
+    if (status != SUCCESS)
+        exit (EXIT_FAILURE);
+
+    /* Free the metadata structure and the pointers */
+    free_metadata (&xml_metadata);
+    free (xml_infile);
+
+    /* Successful completion */
+    exit (EXIT_SUCCESS);
+}
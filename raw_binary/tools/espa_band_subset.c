@@ -37,7 +37,8 @@ void usage ()
     printf ("usage: espa_band_subset "
             "--xml=input_metadata_filename "
             "--subset_xml=output_subset_metadata_filename "
-            "[--band=band_name (multiple --band options can be specified)].\n");
+            "[--band=band_name (multiple --band options can be specified)] "
+            "[--output_dir=directory] [--link=reflink|hardlink|copy].\n");
 
     printf ("\nwhere the following parameters are required:\n");
     printf ("    -xml: name of the input XML metadata file which follows "
@@ -49,10 +50,22 @@ void usage ()
     printf ("    -band: name of the band in the input XML file to be written "
             "to the subset XML file. If not specified, then only the global "
             "and projection metadata will be copied to the subset XML file.\n");
+    printf ("    -output_dir: directory to place the files of the subset "
+            "bands in, so the subset XML file can be written there as a "
+            "product of its own.  The files are reflinked, hard linked, or "
+            "copied, per -link.\n");
+    printf ("    -link: how the files are placed in -output_dir: reflink "
+            "(copy-on-write clone, the default), hardlink (shares the "
+            "original files, so modifying either modifies both), or copy.  "
+            "Files which can't be reflinked or hard linked are copied.\n");
     printf ("\nExample: espa_band_subset "
             "--xml=LE07_L1TP_022033_20140228_20161028_02_T1.xml "
             "--subset_xml=LE07_L1TP_022033_20140228_20161028_02_T1_subset.xml "
             "--band b1 --band b4 --band b7\n");
+    printf ("\nExample: espa_band_subset "
+            "--xml=LE07_L1TP_022033_20140228_20161028_02_T1.xml "
+            "--subset_xml=aoi/LE07_L1TP_022033_20140228_20161028_02_T1.xml "
+            "--output_dir=aoi --band b3 --band b4\n");
     printf ("\nExample: espa_band_subset "
             "--xml=LE07_L1TP_022033_20140228_20161028_02_T1.xml "
             "--subset_xml=LE07_L1TP_022033_20140228_20161028_02_T1_subset.xml\n");
@@ -74,9 +87,11 @@ ERROR           Error getting the command-line arguments or a command-line
 SUCCESS         No errors encountered
 
 NOTES:
-  1. Memory is allocated for the input and output files.  All of these should
-     be character pointers set to NULL on input.  The caller is responsible
+  1. Memory is allocated for the input and output files and the output
+     directory.  All of these should be character pointers set to NULL on
+     input.  The caller is responsible
      for freeing the allocated memory upon successful return.
+  2. The band list grows as needed and is to be freed with free_name_list.
 ******************************************************************************/
 short get_args
 (
@@ -84,13 +99,15 @@ short get_args
     char *argv[],         /* I: string of cmd-line args */
     char **xml_infile,    /* O: address of input XML filename */
     char **xml_subset_outfile,  /* O: address of output subset XML filename */
-    int *nbands,          /* O: number of bands in the subset */
-    char bands[][STR_SIZE]  /* O: array of band names to be subset */
+    Espa_name_list_t *bands,  /* O: list of band names to be subset */
+    char **out_dir,       /* O: address of the directory to materialize the
+                                band files in; NULL if not specified */
+    Espa_link_method_t *link_method  /* O: preferred method of materializing
+                                the band files */
 )
 {
     int c;                           /* current argument index */
     int option_index;                /* index for the command-line option */
-    int count;                       /* number of chars copied in snprintf */
     char errmsg[STR_SIZE];           /* error message */
     char FUNC_NAME[] = "get_args";   /* function name */
     static struct option long_options[] =
@@ -98,12 +115,15 @@ short get_args
         {"xml", required_argument, 0, 'i'},
         {"subset_xml", required_argument, 0, 'o'},
         {"band", required_argument, 0, 'b'},
+        {"output_dir", required_argument, 0, 'd'},
+        {"link", required_argument, 0, 'l'},
         {"help", no_argument, 0, 'h'},
         {0, 0, 0, 0}
     };
 
     /* Loop through all the cmd-line options */
-    *nbands = 0;
+    init_name_list (bands);
+    *link_method = ESPA_LINK_REFLINK;
     opterr = 0;   /* turn off getopt_long error msgs as we'll print our own */
     while (1)
     {
@@ -136,25 +156,26 @@ short get_args
                 break;
      
             case 'b':  /* band name to be added */
-                count = snprintf (bands[*nbands], sizeof (bands[*nbands]),
-                    "%s", optarg);
-                if (count < 0 || count >= sizeof (bands[*nbands]))
+                if (add_name_to_list (bands, optarg) != SUCCESS)
                 {
-                    sprintf (errmsg, "Overflow of bands[*nbands] string");
+                    sprintf (errmsg, "Adding band %s", optarg);
                     error_handler (true, FUNC_NAME, errmsg);
                     return (ERROR);
                 }
+                break;
+     
+            case 'd':  /* directory to materialize the band files in */
+                *out_dir = strdup (optarg);
+                break;
 
-                (*nbands)++;
-                if (*nbands > MAX_TOTAL_BANDS)
+            case 'l':  /* method of materializing the band files */
+                if (get_link_method (optarg, link_method) != SUCCESS)
                 {
-                    sprintf (errmsg, "Maximum number of bands (%d) has been "
-                        "reached. Results might not be trustworthy as the "
-                        "memory may have been trashed.", MAX_TOTAL_BANDS);
-                    error_handler (false, FUNC_NAME, errmsg);
+                    usage ();
+                    return (ERROR);
                 }
                 break;
-     
+
             case '?':
             default:
                 sprintf (errmsg, "Unknown option %s", argv[optind-1]);
@@ -183,7 +204,7 @@ short get_args
     }
 
     /* Warn the user if no bands were specified */
-    if (*nbands == 0)
+    if (bands->nnames == 0)
     {
         sprintf (errmsg, "No bands were specified, therefore only the "
             "global and projection metadata will be copied to the subset "
@@ -216,22 +237,32 @@ int main (int argc, char** argv)
 {
     char *xml_infile = NULL;          /* input XML filename */
     char *xml_subset_outfile = NULL;  /* output subset XML filename */
-    char bands[MAX_TOTAL_BANDS][STR_SIZE];  /* array of nbands band names */
-    int nbands;                       /* number of bands specified */
+    Espa_name_list_t bands;           /* list of band names specified */
+    char *out_dir = NULL;             /* directory to materialize the band
+                                         files in */
+    Espa_link_method_t link_method;   /* preferred method of materializing the
+                                         band files */
+    Espa_xml_subset_t subset;         /* subset to be written */
 
     printf ("espa_band_subset version: %s\n", ESPA_COMMON_VERSION);
 
     /* Read the command-line arguments */
-    if (get_args (argc, argv, &xml_infile, &xml_subset_outfile, &nbands,
-        bands) != SUCCESS)
+    if (get_args (argc, argv, &xml_infile, &xml_subset_outfile, &bands,
+        &out_dir, &link_method) != SUCCESS)
     {   /* get_args already printed the error message */
         exit (EXIT_FAILURE);
     }
 
     /* Subset the input XML metadata file with the specified bands and write
-       to the output XML metadata file */
-    if (subset_xml_by_band (xml_infile, xml_subset_outfile, nbands, bands) !=
-        SUCCESS)
+       to the output XML metadata file, materializing the band files in the
+       output directory if one was specified */
+    subset.out_xml_file = xml_subset_outfile;
+    subset.by_product = false;
+    subset.nnames = bands.nnames;
+    subset.names = bands.names;
+    subset.out_dir = out_dir;
+    subset.link_method = link_method;
+    if (subset_xml_files (xml_infile, 1, &subset) != SUCCESS)
     {  /* Error messages already written */
         exit (EXIT_FAILURE);
     }
@@ -239,6 +270,8 @@ int main (int argc, char** argv)
     /* Free the pointers */
     free (xml_infile);
     free (xml_subset_outfile);
+    free (out_dir);
+    free_name_list (&bands);
 
     /* Successful completion */
     exit (EXIT_SUCCESS);
@@ -0,0 +1,1048 @@
+/*****************************************************************************
+FILE: espa_batch_runner
+
+PURPOSE: Contains functions for running the stages of a batch of scenes
+(ex. ingest, land/water mask, and export) listed in a manifest, with
+separate limits on the number of CPU-bound and I/O-bound stages run at a
+time, and reporting the throughput of each stage.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. Each line of the manifest is a stage of a scene:
+         scene stage class command [arguments]
+     where class is cpu or io.  The stages of a scene are run one after the
+     other in the order they are listed; the stages of different scenes run
+     at the same time.  Blank lines and lines starting with # are skipped,
+     and the arguments are separated by white space (they aren't passed
+     through a shell).
+  2. The stages run as child processes (see espa_granule_batch.h for why
+     the tools aren't run on threads).  There is one queue of scenes rather
+     than scenes assigned to workers up front: whenever a CPU or I/O slot is
+     free, it takes the next stage of that class from whichever scene is
+     ready, going round the scenes so none is starved.  A scene waiting on
+     an I/O slot doesn't hold a CPU slot, and vice versa.
+  3. A stage which fails ends its scene; the stages left in the scene are
+     skipped, and the other scenes go on.
+  4. The bytes read and written by a stage are those of its read and write
+     calls (rchar and wchar of /proc/<pid>/io), so reads from the page cache
+     are counted.  The standard output and error of each scene's stages are
+     appended to <log_dir>/<scene>.log.
+*****************************************************************************/
+#include <getopt.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include "error_handler.h"
+#include "espa_metadata.h"
+
+/* Defines */
+#define BATCH_DEFAULT_IO_JOBS 2   /* default number of I/O stages at a time */
+#define BATCH_MB (1024.0 * 1024.0)  /* bytes per megabyte */
+
+/* Class of a stage, which decides the slots it is run in */
+typedef enum
+{
+    STAGE_CPU = 0,
+    STAGE_IO,
+    STAGE_NCLASSES
+} Stage_class_t;
+
+static const char *stage_class_names[STAGE_NCLASSES] = {"cpu", "io"};
+
+/* Stage of a scene */
+typedef struct
+{
+    int scene;                   /* index of the scene of the stage */
+    char *line;                  /* copy of the manifest line, which name
+                                    and argv point into */
+    char *name;                  /* name of the stage (ex. ingest) */
+    Stage_class_t class;         /* class of the stage */
+    char **argv;                 /* command and its arguments, NULL
+                                    terminated */
+    pid_t pid;                   /* process running the stage; 0 if not
+                                    started */
+    double start;                /* start of the stage (seconds) */
+    double end;                  /* end of the stage (seconds) */
+    int status;                  /* exit status; -1 if not run */
+    long long read_bytes;        /* bytes read by the stage */
+    long long write_bytes;       /* bytes written by the stage */
+} Batch_stage_t;
+
+/* Scene and the stages to be run for it */
+typedef struct
+{
+    char *name;                  /* name of the scene */
+    int *stages;                 /* indices of the stages, in order */
+    int nstages;                 /* number of stages */
+    int next;                    /* next stage to be run */
+    bool running;                /* is a stage of the scene running? */
+    bool failed;                 /* did a stage of the scene fail? */
+} Batch_scene_t;
+
+/* Batch read from the manifest */
+typedef struct
+{
+    Batch_stage_t *stages;       /* stages of all the scenes */
+    int nstages;                 /* number of stages */
+    int max_stages;              /* number of stages allocated */
+    Batch_scene_t *scenes;       /* scenes, in the order first listed */
+    int nscenes;                 /* number of scenes */
+    int max_scenes;              /* number of scenes allocated */
+} Batch_t;
+
+
+/******************************************************************************
+MODULE: usage
+
+PURPOSE: Prints the usage information for this application.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+void usage ()
+{
+    printf ("espa_batch_runner runs the stages of a batch of scenes listed "
+            "in a manifest.  The stages of a scene run in order, and the "
+            "scenes share a number of CPU slots and a number of I/O slots, "
+            "so the I/O-bound stages (ex. ingest and HDF export) don't all "
+            "run at once while the CPU-bound stages (ex. the land/water mask "
+            "and compression) wait.  The throughput of each stage is "
+            "reported when the batch is done.\n");
+    printf ("version: %s\n\n", ESPA_COMMON_VERSION);
+    printf ("usage: espa_batch_runner --manifest=manifest_filename "
+            "[--cpu_jobs=n] [--io_jobs=n] [--log_dir=directory] "
+            "[--report=report_filename]\n");
+    printf ("\nwhere the following parameters are required:\n");
+    printf ("    -manifest: file listing a stage per line as \"scene stage "
+            "class command [arguments]\", where class is cpu or io; - "
+            "reads the manifest from stdin\n");
+    printf ("\nwhere the following parameters are optional:\n");
+    printf ("    -cpu_jobs: number of CPU stages run at a time (default is "
+            "the number of processors)\n");
+    printf ("    -io_jobs: number of I/O stages run at a time (default is "
+            "%d)\n", BATCH_DEFAULT_IO_JOBS);
+    printf ("    -log_dir: directory for the <scene>.log file of each scene's "
+            "output (default is the current directory)\n");
+    printf ("    -report: JSON lines file the throughput of each stage is "
+            "written to\n");
+    printf ("\nExample manifest:\n");
+    printf ("    LC08_L1TP_047027_20131014_20170308_01_T1 ingest io "
+            "convert_lpgs_to_espa "
+            "--mtl=LC08_L1TP_047027_20131014_20170308_01_T1_MTL.txt\n");
+    printf ("    LC08_L1TP_047027_20131014_20170308_01_T1 mask cpu "
+            "create_land_water_mask "
+            "--xml=LC08_L1TP_047027_20131014_20170308_01_T1.xml\n");
+    printf ("    LC08_L1TP_047027_20131014_20170308_01_T1 export io "
+            "convert_espa_to_hdf "
+            "--xml=LC08_L1TP_047027_20131014_20170308_01_T1.xml "
+            "--hdf=LC08_L1TP_047027_20131014_20170308_01_T1.hdf\n");
+    printf ("\nExample: espa_batch_runner --manifest=batch.txt --cpu_jobs=16 "
+            "--io_jobs=4 --report=batch.jsonl\n");
+}
+
+
+/******************************************************************************
+MODULE:  get_args
+
+PURPOSE:  Gets the command-line arguments and validates that the required
+arguments were specified.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error getting the command-line arguments or a command-line
+                argument and associated value were not specified
+SUCCESS         No errors encountered
+
+NOTES:
+  1. Memory is allocated for the filenames.  These should be character
+     pointers set to NULL on input.  The caller is responsible for freeing
+     the allocated memory upon successful return.
+******************************************************************************/
+short get_args
+(
+    int argc,             /* I: number of cmd-line args */
+    char *argv[],         /* I: string of cmd-line args */
+    char **manifest,      /* O: address of the manifest filename */
+    int *limits,          /* O: number of stages of each class run at a
+                                time */
+    char **log_dir,       /* O: address of the log directory */
+    char **report         /* O: address of the report filename */
+)
+{
+    int c;                           /* current argument index */
+    int option_index;                /* index for the command-line option */
+    char errmsg[STR_SIZE];           /* error message */
+    char FUNC_NAME[] = "get_args";   /* function name */
+    static struct option long_options[] =
+    {
+        {"manifest", required_argument, 0, 'm'},
+        {"cpu_jobs", required_argument, 0, 'c'},
+        {"io_jobs", required_argument, 0, 'i'},
+        {"log_dir", required_argument, 0, 'l'},
+        {"report", required_argument, 0, 'r'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    /* Loop through all the cmd-line options */
+    opterr = 0;   /* turn off getopt_long error msgs as we'll print our own */
+    while (1)
+    {
+        /* optstring in call to getopt_long is empty since we will only
+           support the long options */
+        c = getopt_long (argc, argv, "", long_options, &option_index);
+        if (c == -1)
+        {   /* Out of cmd-line options */
+            break;
+        }
+
+        switch (c)
+        {
+            case 0:
+                /* If this option set a flag, do nothing else now. */
+                if (long_options[option_index].flag != 0)
+                    break;
+
+            case 'h':  /* help */
+                usage ();
+                return (ERROR);
+                break;
+
+            case 'm':  /* manifest */
+                *manifest = strdup (optarg);
+                break;
+
+            case 'c':  /* number of CPU stages */
+                limits[STAGE_CPU] = atoi (optarg);
+                break;
+
+            case 'i':  /* number of I/O stages */
+                limits[STAGE_IO] = atoi (optarg);
+                break;
+
+            case 'l':  /* log directory */
+                *log_dir = strdup (optarg);
+                break;
+
+            case 'r':  /* report */
+                *report = strdup (optarg);
+                break;
+
+            case '?':
+            default:
+                sprintf (errmsg, "Unknown option %s", argv[optind-1]);
+                error_handler (true, FUNC_NAME, errmsg);
+                usage ();
+                return (ERROR);
+                break;
+        }
+    }
+
+    /* Make sure the manifest was specified */
+    if (*manifest == NULL)
+    {
+        sprintf (errmsg, "Manifest is a required argument");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    if (limits[STAGE_CPU] < 1 || limits[STAGE_IO] < 1)
+    {
+        sprintf (errmsg, "Numbers of CPU and I/O jobs must be positive");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  batch_clock
+
+PURPOSE:  Returns the monotonic time, for timing the stages.
+
+RETURN VALUE:
+Type = double
+Value           Description
+-----           -----------
+n               Seconds since an arbitrary start
+
+NOTES:
+******************************************************************************/
+static double batch_clock (void)
+{
+    struct timespec now;         /* current time */
+
+    clock_gettime (CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+
+/******************************************************************************
+MODULE:  add_stage
+
+PURPOSE:  Adds a stage read from a line of the manifest to the batch, adding
+its scene if this is the scene's first stage.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           The line isn't a valid stage, or error allocating memory
+SUCCESS         The stage was added
+
+NOTES:
+  1. The line is split in place into the scene, stage, class, and command;
+     the stage keeps the line.
+******************************************************************************/
+static int add_stage
+(
+    Batch_t *batch,      /* I/O: batch the stage is added to */
+    char *line,          /* I: copy of the manifest line */
+    int line_num         /* I: line number, for the error messages */
+)
+{
+    char FUNC_NAME[] = "add_stage";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    char *fields[3];          /* scene, stage, and class */
+    char *token = NULL;       /* current field of the line */
+    char *save = NULL;        /* position of strtok_r in the line */
+    char **argv = NULL;       /* command and its arguments */
+    int nargs = 0;            /* number of arguments */
+    int i;                    /* looping variable */
+    int scene;                /* index of the scene of the stage */
+    Batch_stage_t *stage = NULL;  /* stage added */
+    Batch_scene_t *sptr = NULL;   /* scene of the stage */
+    void *ptr = NULL;         /* reallocated memory */
+
+    /* Split the line, with room for every token as an argument */
+    argv = calloc (strlen (line) / 2 + 2, sizeof (char *));
+    if (argv == NULL)
+    {
+        sprintf (errmsg, "Allocating the arguments of manifest line %d",
+            line_num);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    i = 0;
+    for (token = strtok_r (line, " \t", &save); token != NULL;
+         token = strtok_r (NULL, " \t", &save))
+    {
+        if (i < 3)
+            fields[i++] = token;
+        else
+            argv[nargs++] = token;
+    }
+    argv[nargs] = NULL;
+    if (nargs == 0)
+    {
+        sprintf (errmsg, "Manifest line %d isn't \"scene stage class "
+            "command [arguments]\"", line_num);
+        error_handler (true, FUNC_NAME, errmsg);
+        free (argv);
+        return (ERROR);
+    }
+
+    /* Find the scene, adding it if it's new */
+    for (scene = 0; scene < batch->nscenes; scene++)
+    {
+        if (!strcmp (batch->scenes[scene].name, fields[0]))
+            break;
+    }
+    if (scene == batch->nscenes)
+    {
+        if (batch->nscenes == batch->max_scenes)
+        {
+            ptr = realloc (batch->scenes, (batch->max_scenes * 2 + 16) *
+                sizeof (Batch_scene_t));
+            if (ptr == NULL)
+            {
+                sprintf (errmsg, "Allocating the scenes of the batch");
+                error_handler (true, FUNC_NAME, errmsg);
+                free (argv);
+                return (ERROR);
+            }
+            batch->scenes = ptr;
+            batch->max_scenes = batch->max_scenes * 2 + 16;
+        }
+        memset (&batch->scenes[scene], 0, sizeof (Batch_scene_t));
+        batch->scenes[scene].name = fields[0];
+        batch->nscenes++;
+    }
+    sptr = &batch->scenes[scene];
+
+    /* Add the stage to the batch and to its scene */
+    if (batch->nstages == batch->max_stages)
+    {
+        ptr = realloc (batch->stages, (batch->max_stages * 2 + 16) *
+            sizeof (Batch_stage_t));
+        if (ptr == NULL)
+        {
+            sprintf (errmsg, "Allocating the stages of the batch");
+            error_handler (true, FUNC_NAME, errmsg);
+            free (argv);
+            return (ERROR);
+        }
+        batch->stages = ptr;
+        batch->max_stages = batch->max_stages * 2 + 16;
+    }
+    ptr = realloc (sptr->stages, (sptr->nstages + 1) * sizeof (int));
+    if (ptr == NULL)
+    {
+        sprintf (errmsg, "Allocating the stages of scene %s", sptr->name);
+        error_handler (true, FUNC_NAME, errmsg);
+        free (argv);
+        return (ERROR);
+    }
+    sptr->stages = ptr;
+    sptr->stages[sptr->nstages++] = batch->nstages;
+
+    stage = &batch->stages[batch->nstages++];
+    memset (stage, 0, sizeof (Batch_stage_t));
+    stage->scene = scene;
+    stage->line = line;
+    stage->name = fields[1];
+    stage->argv = argv;
+    stage->status = -1;
+    if (!strcmp (fields[2], "cpu"))
+        stage->class = STAGE_CPU;
+    else if (!strcmp (fields[2], "io"))
+        stage->class = STAGE_IO;
+    else
+    {
+        sprintf (errmsg, "Class of manifest line %d must be cpu or io, not "
+            "%s", line_num, fields[2]);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  read_manifest
+
+PURPOSE:  Reads the stages of the batch from the manifest.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error reading the manifest
+SUCCESS         Successfully read the manifest
+
+NOTES:
+  1. Blank lines and lines starting with # are skipped.
+******************************************************************************/
+static int read_manifest
+(
+    const char *manifest,     /* I: manifest file; - for stdin */
+    Batch_t *batch            /* O: batch of stages */
+)
+{
+    char FUNC_NAME[] = "read_manifest";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    char *line = NULL;        /* current line of the manifest */
+    char *copy = NULL;        /* copy of the line kept by its stage */
+    char *cptr = NULL;        /* first non-blank character of the line */
+    size_t line_size = 0;     /* size of the line buffer */
+    ssize_t len;              /* length of the current line */
+    int line_num = 0;         /* number of the current line */
+    int status = SUCCESS;     /* return status */
+    FILE *fptr = NULL;        /* manifest file */
+
+    memset (batch, 0, sizeof (Batch_t));
+    fptr = strcmp (manifest, "-") ? fopen (manifest, "r") : stdin;
+    if (fptr == NULL)
+    {
+        sprintf (errmsg, "Opening %s for read access.", manifest);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    while (status == SUCCESS && (len = getline (&line, &line_size, fptr)) > 0)
+    {
+        line_num++;
+        while (len > 0 && (line[len-1] == '\n' || line[len-1] == '\r'))
+            line[--len] = '\0';
+        cptr = line + strspn (line, " \t");
+        if (*cptr == '\0' || *cptr == '#')
+            continue;
+
+        copy = strdup (cptr);
+        if (copy == NULL)
+        {
+            sprintf (errmsg, "Copying manifest line %d", line_num);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+            break;
+        }
+        status = add_stage (batch, copy, line_num);
+        if (status != SUCCESS && (batch->nstages == 0 ||
+            batch->stages[batch->nstages-1].line != copy))
+            free (copy);
+    }
+
+    free (line);
+    if (fptr != stdin)
+        fclose (fptr);
+
+    if (status == SUCCESS && batch->nstages == 0)
+    {
+        sprintf (errmsg, "Manifest %s has no stages", manifest);
+        error_handler (true, FUNC_NAME, errmsg);
+        status = ERROR;
+    }
+
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  free_batch
+
+PURPOSE:  Frees the stages and scenes of the batch.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+static void free_batch
+(
+    Batch_t *batch            /* I/O: batch to be freed */
+)
+{
+    int i;                    /* looping variable */
+
+    for (i = 0; i < batch->nstages; i++)
+    {
+        free (batch->stages[i].line);
+        free (batch->stages[i].argv);
+    }
+    for (i = 0; i < batch->nscenes; i++)
+        free (batch->scenes[i].stages);
+    free (batch->stages);
+    free (batch->scenes);
+    memset (batch, 0, sizeof (Batch_t));
+}
+
+
+/******************************************************************************
+MODULE:  start_stage
+
+PURPOSE:  Starts a stage in a child process, with its output appended to
+the log of its scene.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error starting the stage
+SUCCESS         The stage was started
+
+NOTES:
+  1. A command which can't be run makes the child exit with status 127, as
+     a shell would, so it is reported as a failed stage.
+******************************************************************************/
+static int start_stage
+(
+    Batch_stage_t *stage,     /* I/O: stage to be started */
+    const char *scene,        /* I: name of the scene of the stage */
+    const char *log_dir       /* I: directory of the scene logs */
+)
+{
+    char FUNC_NAME[] = "start_stage";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    char log_file[STR_SIZE];  /* log of the scene */
+    int count;                /* number of chars copied in snprintf */
+    int fd;                   /* descriptor of the log */
+
+    count = snprintf (log_file, sizeof (log_file), "%s/%s.log", log_dir,
+        scene);
+    if (count < 0 || count >= (int) sizeof (log_file))
+    {
+        sprintf (errmsg, "Overflow of the log filename of scene %s", scene);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    fflush (stdout);
+    fflush (stderr);
+    stage->start = batch_clock ();
+    stage->pid = fork ();
+    if (stage->pid == 0)
+    {
+        fd = open (log_file, O_WRONLY | O_CREAT | O_APPEND, 0644);
+        if (fd < 0 || dup2 (fd, STDOUT_FILENO) < 0 ||
+            dup2 (fd, STDERR_FILENO) < 0)
+        {
+            sprintf (errmsg, "Opening the log %s", log_file);
+            error_handler (true, FUNC_NAME, errmsg);
+            fflush (stdout);
+            _exit (127);
+        }
+        close (fd);
+        execvp (stage->argv[0], stage->argv);
+        sprintf (errmsg, "Running %s: %s", stage->argv[0], strerror (errno));
+        error_handler (true, FUNC_NAME, errmsg);
+        fflush (stdout);
+        _exit (127);
+    }
+    else if (stage->pid < 0)
+    {
+        stage->pid = 0;
+        sprintf (errmsg, "Unable to fork stage %s of scene %s", stage->name,
+            scene);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  read_stage_io
+
+PURPOSE:  Reads the bytes read and written by a stage which has exited but
+hasn't been reaped.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. The counts are left at zero if /proc/<pid>/io can't be read (ex.
+     without the kernel's task I/O accounting).
+******************************************************************************/
+static void read_stage_io
+(
+    Batch_stage_t *stage      /* I/O: stage whose counts are read */
+)
+{
+    char io_file[STR_SIZE];   /* I/O statistics of the stage's process */
+    char line[STR_SIZE];      /* line of the statistics */
+    long long value;          /* value of a statistic */
+    FILE *fptr = NULL;        /* statistics file */
+
+    snprintf (io_file, sizeof (io_file), "/proc/%d/io", (int) stage->pid);
+    fptr = fopen (io_file, "r");
+    if (fptr == NULL)
+        return;
+
+    while (fgets (line, sizeof (line), fptr) != NULL)
+    {
+        if (sscanf (line, "rchar: %lld", &value) == 1)
+            stage->read_bytes = value;
+        else if (sscanf (line, "wchar: %lld", &value) == 1)
+            stage->write_bytes = value;
+    }
+    fclose (fptr);
+}
+
+
+/******************************************************************************
+MODULE:  next_ready_scene
+
+PURPOSE:  Finds the next scene, going round from the cursor, whose next
+stage is of the class and isn't waiting on one of its earlier stages.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+-1              No scene is ready for a stage of the class
+n               Index of the scene
+
+NOTES:
+  1. The cursor moves past the scene found, so the scenes take turns.
+******************************************************************************/
+static int next_ready_scene
+(
+    const Batch_t *batch,     /* I: batch being run */
+    Stage_class_t class,      /* I: class of the free slot */
+    int *cursor               /* I/O: scene the search starts at */
+)
+{
+    int i;                    /* looping variable for the scenes */
+    int scene;                /* index of the scene being checked */
+    const Batch_scene_t *sptr = NULL;  /* scene being checked */
+
+    for (i = 0; i < batch->nscenes; i++)
+    {
+        scene = (*cursor + i) % batch->nscenes;
+        sptr = &batch->scenes[scene];
+        if (sptr->running || sptr->failed || sptr->next == sptr->nstages)
+            continue;
+        if (batch->stages[sptr->stages[sptr->next]].class == class)
+        {
+            *cursor = (scene + 1) % batch->nscenes;
+            return scene;
+        }
+    }
+
+    return -1;
+}
+
+
+/******************************************************************************
+MODULE:  run_batch
+
+PURPOSE:  Runs the stages of the batch, keeping up to the limit of each
+class running, until every scene is done or has failed.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+n               Number of scenes which failed
+
+NOTES:
+******************************************************************************/
+static int run_batch
+(
+    Batch_t *batch,           /* I/O: batch to be run */
+    const int *limits,        /* I: number of stages of each class run at a
+                                    time */
+    const char *log_dir       /* I: directory of the scene logs */
+)
+{
+    char FUNC_NAME[] = "run_batch";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    int running[STAGE_NCLASSES] = {0};  /* stages of each class running */
+    int cursor[STAGE_NCLASSES] = {0};   /* next scene to offer each class */
+    int nrunning = 0;         /* number of stages running */
+    int nfailed = 0;          /* number of scenes which failed */
+    int ndone = 0;            /* number of scenes done or failed */
+    int scene;                /* index of a scene */
+    int c;                    /* looping variable for the classes */
+    int i;                    /* looping variable for the stages */
+    int wstatus;              /* wait status of a stage */
+    siginfo_t info;           /* stage which exited */
+    Batch_stage_t *stage = NULL;  /* stage started or finished */
+    Batch_scene_t *sptr = NULL;   /* scene of the stage */
+
+    while (ndone < batch->nscenes)
+    {
+        /* Fill the free slots of each class from the ready scenes */
+        for (c = 0; c < STAGE_NCLASSES; c++)
+        {
+            while (running[c] < limits[c] &&
+                (scene = next_ready_scene (batch, c, &cursor[c])) >= 0)
+            {
+                sptr = &batch->scenes[scene];
+                stage = &batch->stages[sptr->stages[sptr->next]];
+                if (start_stage (stage, sptr->name, log_dir) != SUCCESS)
+                {
+                    sptr->failed = true;
+                    nfailed++;
+                    ndone++;
+                    continue;
+                }
+                sptr->running = true;
+                running[c]++;
+                nrunning++;
+            }
+        }
+        if (nrunning == 0)
+            break;
+
+        /* Wait for a stage to exit, reading its I/O before reaping it */
+        if (waitid (P_ALL, 0, &info, WEXITED | WNOWAIT) != 0)
+        {
+            if (errno == EINTR)
+                continue;
+            sprintf (errmsg, "Waiting for the stages: %s", strerror (errno));
+            error_handler (true, FUNC_NAME, errmsg);
+            break;
+        }
+        stage = NULL;
+        for (i = 0; i < batch->nstages; i++)
+        {
+            if (batch->stages[i].pid == info.si_pid &&
+                batch->stages[i].status < 0)
+            {
+                stage = &batch->stages[i];
+                break;
+            }
+        }
+        if (stage != NULL)
+            read_stage_io (stage);
+        if (waitpid (info.si_pid, &wstatus, 0) < 0 || stage == NULL)
+            continue;
+
+        stage->end = batch_clock ();
+        if (WIFEXITED (wstatus))
+            stage->status = WEXITSTATUS (wstatus);
+        else
+            stage->status = 128 + WTERMSIG (wstatus);
+        running[stage->class]--;
+        nrunning--;
+
+        sptr = &batch->scenes[stage->scene];
+        sptr->running = false;
+        printf ("%s %s (%s): exit status %d in %.3f seconds\n", sptr->name,
+            stage->name, stage_class_names[stage->class], stage->status,
+            stage->end - stage->start);
+        if (stage->status != 0)
+        {
+            sptr->failed = true;
+            nfailed++;
+            ndone++;
+            if (sptr->next + 1 < sptr->nstages)
+            {
+                sprintf (errmsg, "Scene %s failed at stage %s; skipping its "
+                    "%d remaining stages", sptr->name, stage->name,
+                    sptr->nstages - sptr->next - 1);
+                error_handler (false, FUNC_NAME, errmsg);
+            }
+        }
+        else if (++sptr->next == sptr->nstages)
+            ndone++;
+    }
+
+    return (nfailed);
+}
+
+
+/******************************************************************************
+MODULE:  report_batch
+
+PURPOSE:  Reports the throughput of each stage of the batch, and the use of
+the CPU and I/O slots.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the report file
+SUCCESS         Successfully reported
+
+NOTES:
+  1. A stage's runs per hour are over its span, from the first start to the
+     last end of the stage, so they count the runs going on at once.  The
+     MB read and written per second are over the time its runs took, so
+     they are the rate of a single run.
+  2. The report file has a JSON object per line: one per stage, then one
+     for the batch.
+******************************************************************************/
+static int report_batch
+(
+    const Batch_t *batch,     /* I: batch which was run */
+    const int *limits,        /* I: number of stages of each class run at a
+                                    time */
+    double wall,              /* I: wall time of the batch (seconds) */
+    int nfailed,              /* I: number of scenes which failed */
+    const char *report        /* I: report filename; NULL for none */
+)
+{
+    char FUNC_NAME[] = "report_batch";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    const Batch_stage_t *stage = NULL;  /* stage being added up */
+    const char *name = NULL;  /* name of the stage being reported */
+    double busy;              /* time the runs of the stage took */
+    double first;             /* first start of the stage */
+    double last;              /* last end of the stage */
+    double class_busy[STAGE_NCLASSES] = {0.0};  /* time each class's slots
+                                 were in use */
+    double mb;                /* MB read and written by the stage */
+    double read_mb;           /* MB read by the stage */
+    double write_mb;          /* MB written by the stage */
+    int nruns;                /* number of completed runs of the stage */
+    int nfails;               /* number of failed runs of the stage */
+    int i, j;                 /* looping variables for the stages */
+    bool seen;                /* was the stage reported already? */
+    FILE *fptr = NULL;        /* report file */
+
+    if (report != NULL)
+    {
+        fptr = fopen (report, "w");
+        if (fptr == NULL)
+        {
+            sprintf (errmsg, "Opening %s for write access.", report);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+    }
+
+    printf ("\n%-16s %-4s %6s %6s %10s %10s %10s %10s %10s\n", "stage",
+        "class", "runs", "failed", "mean_s", "runs/hour", "read_mb",
+        "write_mb", "mb/s");
+
+    /* Add up the runs of each stage name, in the order first listed */
+    for (i = 0; i < batch->nstages; i++)
+    {
+        name = batch->stages[i].name;
+        seen = false;
+        for (j = 0; j < i && !seen; j++)
+            seen = !strcmp (batch->stages[j].name, name);
+        if (seen)
+            continue;
+
+        busy = 0.0;
+        first = -1.0;
+        last = -1.0;
+        read_mb = 0.0;
+        write_mb = 0.0;
+        nruns = 0;
+        nfails = 0;
+        for (j = i; j < batch->nstages; j++)
+        {
+            stage = &batch->stages[j];
+            if (strcmp (stage->name, name) || stage->status < 0)
+                continue;
+            busy += stage->end - stage->start;
+            class_busy[stage->class] += stage->end - stage->start;
+            if (first < 0.0 || stage->start < first)
+                first = stage->start;
+            if (stage->end > last)
+                last = stage->end;
+            read_mb += stage->read_bytes / BATCH_MB;
+            write_mb += stage->write_bytes / BATCH_MB;
+            if (stage->status == 0)
+                nruns++;
+            else
+                nfails++;
+        }
+        mb = read_mb + write_mb;
+
+        printf ("%-16s %-4s %6d %6d %10.3f %10.1f %10.1f %10.1f %10.1f\n",
+            name, stage_class_names[batch->stages[i].class], nruns, nfails,
+            nruns + nfails > 0 ? busy / (nruns + nfails) : 0.0,
+            last > first ? nruns * 3600.0 / (last - first) : 0.0, read_mb,
+            write_mb, busy > 0.0 ? mb / busy : 0.0);
+        if (fptr != NULL)
+        {
+            fprintf (fptr, "{\"stage\": \"%s\", \"class\": \"%s\", "
+                "\"runs\": %d, \"failed\": %d, \"busy_seconds\": %.3f, "
+                "\"span_seconds\": %.3f, \"mean_seconds\": %.3f, "
+                "\"runs_per_hour\": %.3f, \"read_mb\": %.3f, "
+                "\"write_mb\": %.3f, \"mb_per_second\": %.3f}\n", name,
+                stage_class_names[batch->stages[i].class], nruns, nfails,
+                busy, first < 0.0 ? 0.0 : last - first,
+                nruns + nfails > 0 ? busy / (nruns + nfails) : 0.0,
+                last > first ? nruns * 3600.0 / (last - first) : 0.0, read_mb,
+                write_mb, busy > 0.0 ? mb / busy : 0.0);
+        }
+    }
+
+    printf ("\n%d scenes (%d failed) in %.3f seconds; CPU slots %.0f%% "
+        "busy, I/O slots %.0f%% busy\n", batch->nscenes, nfailed, wall,
+        wall > 0.0 ? 100.0 * class_busy[STAGE_CPU] /
+        (limits[STAGE_CPU] * wall) : 0.0,
+        wall > 0.0 ? 100.0 * class_busy[STAGE_IO] /
+        (limits[STAGE_IO] * wall) : 0.0);
+    if (fptr != NULL)
+    {
+        fprintf (fptr, "{\"batch\": \"%s\", \"scenes\": %d, \"failed\": %d, "
+            "\"wall_seconds\": %.3f, \"cpu_jobs\": %d, \"io_jobs\": %d, "
+            "\"cpu_busy\": %.3f, \"io_busy\": %.3f}\n", ESPA_COMMON_VERSION,
+            batch->nscenes, nfailed, wall, limits[STAGE_CPU],
+            limits[STAGE_IO], wall > 0.0 ? class_busy[STAGE_CPU] /
+            (limits[STAGE_CPU] * wall) : 0.0, wall > 0.0 ?
+            class_busy[STAGE_IO] / (limits[STAGE_IO] * wall) : 0.0);
+        if (fclose (fptr) != 0)
+        {
+            sprintf (errmsg, "Writing %s", report);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  main
+
+PURPOSE:  Runs the stages of a batch of scenes listed in a manifest, and
+reports the throughput of each stage.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error reading the manifest, or one or more scenes failed
+SUCCESS         All the scenes were processed
+
+NOTES:
+******************************************************************************/
+int main (int argc, char** argv)
+{
+    char FUNC_NAME[] = "main";   /* function name */
+    char errmsg[STR_SIZE];       /* error message */
+    char *manifest = NULL;       /* manifest filename */
+    char *log_dir = NULL;        /* directory of the scene logs */
+    char *report = NULL;         /* report filename */
+    int limits[STAGE_NCLASSES];  /* number of stages of each class run at a
+                                    time */
+    int nfailed;                 /* number of scenes which failed */
+    double start;                /* start of the batch */
+    double wall;                 /* wall time of the batch */
+    Batch_t batch;               /* stages and scenes of the batch */
+
+    printf ("espa_batch_runner version: %s\n", ESPA_COMMON_VERSION);
+
+    limits[STAGE_CPU] = sysconf (_SC_NPROCESSORS_ONLN);
+    if (limits[STAGE_CPU] < 1)
+        limits[STAGE_CPU] = 1;
+    limits[STAGE_IO] = BATCH_DEFAULT_IO_JOBS;
+
+    /* Read the command-line arguments */
+    if (get_args (argc, argv, &manifest, limits, &log_dir, &report)
+        != SUCCESS)
+    {   /* get_args already printed the error message */
+        exit (EXIT_FAILURE);
+    }
+
+    if (read_manifest (manifest, &batch) != SUCCESS)
+    {  /* Error messages already written */
+        free_batch (&batch);
+        exit (EXIT_FAILURE);
+    }
+    printf ("Running %d stages of %d scenes with %d CPU and %d I/O slots\n",
+        batch.nstages, batch.nscenes, limits[STAGE_CPU], limits[STAGE_IO]);
+
+    start = batch_clock ();
+    nfailed = run_batch (&batch, limits, log_dir == NULL ? "." : log_dir);
+    wall = batch_clock () - start;
+
+    if (report_batch (&batch, limits, wall, nfailed, report) != SUCCESS)
+    {  /* Error messages already written */
+        free_batch (&batch);
+        exit (EXIT_FAILURE);
+    }
+    free_batch (&batch);
+
+    if (nfailed > 0)
+    {
+        sprintf (errmsg, "%d scenes failed", nfailed);
+        error_handler (true, FUNC_NAME, errmsg);
+        exit (EXIT_FAILURE);
+    }
+
+    /* Free the pointers */
+    free (manifest);
+    free (log_dir);
+    free (report);
+
+    /* Successful completion */
+    exit (EXIT_SUCCESS);
+}
@@ -0,0 +1,428 @@
+/*****************************************************************************
+FILE: espa_chip_shards
+
+PURPOSE: Contains functions for cutting training chips from ESPA products and
+writing them to sharded WebDataset tar or TFRecord files.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The XML metadata format parsed or written via this library follows the
+     ESPA internal metadata format found in ESPA Raw Binary Format v1.0.doc.
+     The schema for the ESPA internal metadata format is available at
+     http://espa.cr.usgs.gov/schema/espa_internal_metadata_v1_0.xsd.
+*****************************************************************************/
+#include <getopt.h>
+#include "espa_chip_shards.h"
+#include "espa_task_pool.h"
+
+/* Input products of the chips */
+typedef struct
+{
+    char **xml_files;         /* input XML files */
+    int nfiles;               /* number of XML files */
+    int nalloc;               /* number of XML files allocated */
+} Chip_inputs_t;
+
+
+/******************************************************************************
+MODULE: usage
+
+PURPOSE: Prints the usage information for this application.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+void usage ()
+{
+    printf ("espa_chip_shards cuts training chips from the bands of ESPA "
+            "products (raw binary and associated XML metadata file), at a "
+            "list of chip centers or on a regular grid, and writes them with "
+            "their metadata to sharded WebDataset tar or TFRecord files.  "
+            "The chips are read in parallel across the products, reading "
+            "only the windows of the bands under the chips.\n");
+    printf ("version: %s\n\n", ESPA_COMMON_VERSION);
+    printf ("usage: espa_chip_shards "
+            "[--xml=input_metadata_filename (multiple --xml options can be "
+            "specified)] [--xml_list=file_of_input_metadata_filenames] "
+            "[--centers=chip_centers_filename] "
+            "--output=shard_prefix "
+            "[--format=webdataset|tfrecord] "
+            "[--chip_size=lines_and_samples_per_chip] "
+            "[--stride=lines_and_samples_between_chips] "
+            "[--shard_chips=chips_per_shard] "
+            "[--max_fill=largest_fraction_of_fill] "
+            "[--bands=band_names] "
+            "[--threads=number_of_threads]\n");
+
+    printf ("\nwhere the following parameters are required:\n");
+    printf ("    -xml, -xml_list, or -centers: name of an input XML "
+            "metadata file, of a file listing one input XML metadata file "
+            "per line (- for stdin), or of the chip centers file\n");
+    printf ("    -output: prefix of the shard files, which are numbered "
+            "(ex. prefix-000000.tar)\n");
+
+    printf ("\nwhere the following parameters are optional:\n");
+    printf ("    -centers: file with a chip center per line: the input XML "
+            "metadata file, and the x and y of the center in the projection "
+            "coordinates of the product (the default is a grid of chips "
+            "over each input product)\n");
+    printf ("    -format: format of the shards, webdataset (tar files with "
+            "a JSON file and a NumPy array per band for each chip) or "
+            "tfrecord (tf.train.Example records) (default is webdataset)\n");
+    printf ("    -chip_size: number of lines and samples of a chip (default "
+            "is %d)\n", DEFAULT_CHIP_SHARD_SIZE);
+    printf ("    -stride: number of lines and samples between the chips of "
+            "the grid (default is the chip size)\n");
+    printf ("    -shard_chips: number of chips per shard (default is %d)\n",
+            DEFAULT_CHIP_SHARD_CHIPS);
+    printf ("    -max_fill: largest fraction of fill pixels in the first "
+            "band of a chip; chips with more are dropped (default is 1, "
+            "keeping every chip)\n");
+    printf ("    -bands: comma-separated names of the bands of the chips, "
+            "which need to be on one grid (default is the bands on the grid "
+            "of the first band)\n");
+    printf ("    -threads: number of threads reading the chips (default is "
+            "the cap of the task pool)\n");
+
+    printf ("\nExample: espa_chip_shards --xml_list=scenes.txt "
+            "--output=train --format=tfrecord --chip_size=256 "
+            "--max_fill=0.1 --bands=sr_band2,sr_band3,sr_band4\n");
+}
+
+
+/******************************************************************************
+MODULE:  add_xml_file
+
+PURPOSE:  Adds an XML file to the input products.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error allocating memory for the list
+SUCCESS         Successfully added the XML file
+******************************************************************************/
+static int add_xml_file
+(
+    Chip_inputs_t *inputs,    /* I/O: input products */
+    const char *xml_file      /* I: XML file to be added */
+)
+{
+    char FUNC_NAME[] = "add_xml_file";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    char **files = NULL;      /* reallocated list */
+
+    if (inputs->nfiles == inputs->nalloc)
+    {
+        inputs->nalloc = inputs->nalloc ? inputs->nalloc * 2 : 1024;
+        files = realloc (inputs->xml_files, inputs->nalloc
+            * sizeof (char *));
+        if (files == NULL)
+        {
+            sprintf (errmsg, "Allocating memory for the XML file list");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+        inputs->xml_files = files;
+    }
+
+    inputs->xml_files[inputs->nfiles] = strdup (xml_file);
+    if (inputs->xml_files[inputs->nfiles] == NULL)
+    {
+        sprintf (errmsg, "Allocating memory for the XML file list");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    inputs->nfiles++;
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  read_xml_list
+
+PURPOSE:  Adds the XML files listed in a file, one per line, to the input
+products.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error reading the list
+SUCCESS         Successfully read the list
+
+NOTES:
+  1. Blank lines and lines starting with # are skipped.
+******************************************************************************/
+static int read_xml_list
+(
+    Chip_inputs_t *inputs,    /* I/O: input products */
+    const char *list_file     /* I: file listing the XML files; - for stdin */
+)
+{
+    char FUNC_NAME[] = "read_xml_list";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    char *line = NULL;        /* current line of the list */
+    char *cptr = NULL;        /* first non-blank character of the line */
+    size_t line_size = 0;     /* size of the line buffer */
+    ssize_t len;              /* length of the current line */
+    int status = SUCCESS;     /* return status */
+    FILE *fptr = NULL;        /* list file */
+
+    fptr = strcmp (list_file, "-") ? fopen (list_file, "r") : stdin;
+    if (fptr == NULL)
+    {
+        sprintf (errmsg, "Opening %s for read access.", list_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    while (status == SUCCESS && (len = getline (&line, &line_size, fptr)) > 0)
+    {
+        while (len > 0 && (line[len-1] == '\n' || line[len-1] == '\r'))
+            line[--len] = '\0';
+        cptr = line + strspn (line, " \t");
+        if (*cptr != '\0' && *cptr != '#')
+            status = add_xml_file (inputs, cptr);
+    }
+
+    free (line);
+    if (fptr != stdin)
+        fclose (fptr);
+
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  get_args
+
+PURPOSE:  Gets the command-line arguments and validates that the required
+arguments were specified.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error getting the command-line arguments or a command-line
+                argument and associated value were not specified
+SUCCESS         No errors encountered
+
+NOTES:
+  1. Memory is allocated for the input files, the centers file, the shard
+     prefix, and the band names.  All of these should be set to NULL on
+     input.  The caller is responsible for freeing the allocated memory upon
+     successful return.
+******************************************************************************/
+short get_args
+(
+    int argc,              /* I: number of cmd-line args */
+    char *argv[],          /* I: string of cmd-line args */
+    Chip_inputs_t *inputs, /* O: input products */
+    char **centers_file,   /* O: address of chip centers filename */
+    char **shard_prefix,   /* O: address of prefix of the shard filenames */
+    Chip_shard_options_t *options  /* O: chips and shards to be written */
+)
+{
+    int c;                           /* current argument index */
+    int option_index;                /* index for the command-line option */
+    char errmsg[STR_SIZE];           /* error message */
+    char FUNC_NAME[] = "get_args";   /* function name */
+    static struct option long_options[] =
+    {
+        {"xml", required_argument, 0, 'i'},
+        {"xml_list", required_argument, 0, 'l'},
+        {"centers", required_argument, 0, 'c'},
+        {"output", required_argument, 0, 'o'},
+        {"format", required_argument, 0, 'f'},
+        {"chip_size", required_argument, 0, 's'},
+        {"stride", required_argument, 0, 'd'},
+        {"shard_chips", required_argument, 0, 'n'},
+        {"max_fill", required_argument, 0, 'm'},
+        {"bands", required_argument, 0, 'b'},
+        {"threads", required_argument, 0, 't'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    /* Loop through all the cmd-line options */
+    opterr = 0;   /* turn off getopt_long error msgs as we'll print our own */
+    while (1)
+    {
+        /* optstring in call to getopt_long is empty since we will only
+           support the long options */
+        c = getopt_long (argc, argv, "", long_options, &option_index);
+        if (c == -1)
+        {   /* Out of cmd-line options */
+            break;
+        }
+
+        switch (c)
+        {
+            case 0:
+                /* If this option set a flag, do nothing else now. */
+                if (long_options[option_index].flag != 0)
+                    break;
+
+            case 'h':  /* help */
+                usage ();
+                return (ERROR);
+                break;
+
+            case 'i':  /* XML infile */
+                if (add_xml_file (inputs, optarg) != SUCCESS)
+                    return (ERROR);
+                break;
+
+            case 'l':  /* list of XML infiles */
+                if (read_xml_list (inputs, optarg) != SUCCESS)
+                    return (ERROR);
+                break;
+
+            case 'c':  /* chip centers file */
+                *centers_file = strdup (optarg);
+                break;
+
+            case 'o':  /* prefix of the shards */
+                *shard_prefix = strdup (optarg);
+                break;
+
+            case 'f':  /* format of the shards */
+                if (parse_chip_shard_format (optarg, &options->format)
+                    != SUCCESS)
+                {  /* Error message already written */
+                    usage ();
+                    return (ERROR);
+                }
+                break;
+
+            case 's':  /* lines and samples per chip */
+                options->chip_size = atoi (optarg);
+                break;
+
+            case 'd':  /* lines and samples between the chips */
+                options->stride = atoi (optarg);
+                break;
+
+            case 'n':  /* chips per shard */
+                options->shard_chips = atoi (optarg);
+                break;
+
+            case 'm':  /* largest fraction of fill */
+                options->max_fill = atof (optarg);
+                break;
+
+            case 'b':  /* bands of the chips */
+                options->bands = strdup (optarg);
+                break;
+
+            case 't':  /* number of threads */
+                espa_task_pool_set_threads (atoi (optarg));
+                break;
+
+            case '?':
+            default:
+                sprintf (errmsg, "Unknown option %s", argv[optind-1]);
+                error_handler (true, FUNC_NAME, errmsg);
+                usage ();
+                return (ERROR);
+                break;
+        }
+    }
+
+    /* Make sure the infiles and outfiles were specified */
+    if (inputs->nfiles == 0 && *centers_file == NULL)
+    {
+        sprintf (errmsg, "XML input files or a chip centers file are "
+            "required arguments");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    if (*shard_prefix == NULL)
+    {
+        sprintf (errmsg, "Shard output prefix is a required argument");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    /* Make sure the chip values are valid */
+    if (options->chip_size < 1 || options->stride < 0 ||
+        options->shard_chips < 1)
+    {
+        sprintf (errmsg, "Chip size and chips per shard must be positive, "
+            "and the stride can't be negative");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  main
+
+PURPOSE:  Cuts the training chips from the ESPA products and writes them to
+the shards.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the shards
+SUCCESS         No errors encountered
+
+NOTES:
+******************************************************************************/
+int main (int argc, char** argv)
+{
+    Chip_inputs_t inputs = {NULL, 0, 0};  /* input products */
+    char *centers_file = NULL;   /* chip centers filename */
+    char *shard_prefix = NULL;   /* prefix of the shard filenames */
+    Chip_shard_options_t options;  /* chips and shards to be written */
+    int i;                       /* looping variable for the inputs */
+
+    printf ("espa_chip_shards version: %s\n", ESPA_COMMON_VERSION);
+
+    /* Read the command-line arguments */
+    options.format = CHIP_SHARDS_WEBDATASET;
+    options.chip_size = DEFAULT_CHIP_SHARD_SIZE;
+    options.stride = 0;
+    options.shard_chips = DEFAULT_CHIP_SHARD_CHIPS;
+    options.max_fill = 1.0;
+    options.bands = NULL;
+    if (get_args (argc, argv, &inputs, &centers_file, &shard_prefix,
+        &options) != SUCCESS)
+    {   /* get_args already printed the error message */
+        exit (EXIT_FAILURE);
+    }
+
+    /* Write the chips of the products to the shards */
+    if (write_espa_chip_shards (inputs.nfiles, inputs.xml_files,
+        centers_file, shard_prefix, &options) != SUCCESS)
+    {  /* Error messages already written */
+        exit (EXIT_FAILURE);
+    }
+
+    /* Free the pointers */
+    for (i = 0; i < inputs.nfiles; i++)
+        free (inputs.xml_files[i]);
+    free (inputs.xml_files);
+    free (centers_file);
+    free (shard_prefix);
+    free (options.bands);
+
+    /* Successful completion */
+    exit (EXIT_SUCCESS);
+}
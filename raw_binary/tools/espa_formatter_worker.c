@@ -0,0 +1,1686 @@
+/*****************************************************************************
+FILE: espa_formatter_worker
+
+PURPOSE: Contains functions for a long-lived worker which runs the raw
+binary tools as jobs submitted over a Unix socket, so the start-up work
+shared by the tools (initializing libxml2, compiling the ESPA schema, and
+opening the land mass polygons) is done once rather than for every run.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The tools are linked into the worker with their main functions renamed
+     (see the worker_%.o rule in the Makefile), and each job runs its tool's
+     main in a process forked from the worker.  As with the granule batches
+     (see espa_granule_batch.h), the HDF, netCDF, and GCTP libraries and the
+     tools themselves (getopt and their static option flags) aren't
+     re-entrant, so a pool of forked processes stands in for a pool of
+     threads.  Each job starts from the worker's warm state: the compiled
+     schema, and the mapping of the land mass polygons, are inherited
+     copy-on-write.
+  2. A job request carries the working directory, the tool name, and its
+     arguments, along with the client's stdout and stderr, which the tool
+     writes to directly.  The exit status of the tool (or 128 plus the
+     signal which ended it) is sent back when the job is done.
+  3. Jobs run with the worker's environment (ex. ESPA_SCHEMA and
+     ESPA_LAND_MASS_POLYGON), not the client's, and with its privileges, so
+     the socket is only open to the worker's user: it is created with mode
+     0600, and connections from other users are refused.
+  4. With --metrics, the worker answers HTTP requests for /metrics with the
+     job metrics (see espa_metrics.h) in the Prometheus text format.  The
+     requests are answered by the worker itself, between accepting jobs, so
+     a scrape is answered even when every job slot is taken.  The clients
+     are read and written without blocking, in the same wait as the jobs,
+     and each has WORKER_HTTP_TIMEOUT seconds for the whole exchange, so a
+     slow client can't hold up the jobs.  Without a host, the metrics are
+     only served on the loopback address.
+*****************************************************************************/
+#define _GNU_SOURCE             /* for ppoll and accept4 */
+#include <getopt.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdint.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <poll.h>
+#include <netdb.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <libxml/parser.h>
+#include "error_handler.h"
+#include "espa_metadata.h"
+#include "espa_metrics.h"
+#include "ias_lw_geo.h"
+
+/* Defines */
+#define WORKER_MAX_REQUEST (1024 * 1024)  /* largest job request (bytes) */
+#define WORKER_MAX_ARGS 4096    /* most arguments of a job, with the tool
+                                   name */
+#define WORKER_BACKLOG 64       /* connections waiting to be accepted, and
+                                   jobs waiting for a slot */
+#define WORKER_HTTP_REQUEST 4096  /* largest metrics request read (bytes) */
+#define WORKER_HTTP_TIMEOUT 2   /* seconds a metrics client has to send its
+                                   request and read the response */
+#define WORKER_HTTP_CLIENTS 8   /* metrics clients served at a time */
+#define WORKER_HTTP_HOST "127.0.0.1"  /* host the metrics are served on when
+                                         none is given */
+
+/* Main functions of the tools linked into the worker */
+int worker_convert_lpgs_to_espa (int argc, char **argv);
+int worker_convert_espa_to_hdf (int argc, char **argv);
+int worker_convert_espa_to_gtif (int argc, char **argv);
+int worker_espa_band_subset (int argc, char **argv);
+int worker_espa_product_subset (int argc, char **argv);
+int worker_convert_modis_to_espa (int argc, char **argv);
+int worker_create_land_water_mask (int argc, char **argv);
+int worker_convert_espa_to_bip (int argc, char **argv);
+int worker_create_date_bands (int argc, char **argv);
+int worker_clip_band_misalignment (int argc, char **argv);
+int worker_convert_espa_to_netcdf (int argc, char **argv);
+int worker_convert_sentinel_to_espa (int argc, char **argv);
+int worker_espa_meta_query (int argc, char **argv);
+int worker_process_level1 (int argc, char **argv);
+int worker_create_geolocation_bands (int argc, char **argv);
+int worker_convert_espa_to_zarr (int argc, char **argv);
+int worker_convert_espa_to_formats (int argc, char **argv);
+int worker_encode_espa_bands (int argc, char **argv);
+int worker_espa_spatial_subset (int argc, char **argv);
+int worker_stack_espa_bands (int argc, char **argv);
+int worker_build_espa_overviews (int argc, char **argv);
+int worker_espa_warp (int argc, char **argv);
+int worker_unpack_espa_qa (int argc, char **argv);
+int worker_create_angle_bands (int argc, char **argv);
+int worker_espa_validate (int argc, char **argv);
+int worker_upgrade_espa_metadata (int argc, char **argv);
+int worker_convert_bip_to_espa (int argc, char **argv);
+int worker_espa_validate_pixels (int argc, char **argv);
+
+/* Tool which can be run as a job */
+typedef struct
+{
+    const char *name;            /* name of the tool's executable */
+    int (*main) (int argc, char **argv);  /* main function of the tool */
+} Worker_tool_t;
+
+static const Worker_tool_t worker_tools[] =
+{
+    {"convert_lpgs_to_espa", worker_convert_lpgs_to_espa},
+    {"convert_espa_to_hdf", worker_convert_espa_to_hdf},
+    {"convert_espa_to_gtif", worker_convert_espa_to_gtif},
+    {"espa_band_subset", worker_espa_band_subset},
+    {"espa_product_subset", worker_espa_product_subset},
+    {"convert_modis_to_espa", worker_convert_modis_to_espa},
+    {"create_land_water_mask", worker_create_land_water_mask},
+    {"convert_espa_to_bip", worker_convert_espa_to_bip},
+    {"create_date_bands", worker_create_date_bands},
+    {"clip_band_misalignment", worker_clip_band_misalignment},
+    {"convert_espa_to_netcdf", worker_convert_espa_to_netcdf},
+    {"convert_sentinel_to_espa", worker_convert_sentinel_to_espa},
+    {"espa_meta_query", worker_espa_meta_query},
+    {"process_level1", worker_process_level1},
+    {"create_geolocation_bands", worker_create_geolocation_bands},
+    {"convert_espa_to_zarr", worker_convert_espa_to_zarr},
+    {"convert_espa_to_formats", worker_convert_espa_to_formats},
+    {"encode_espa_bands", worker_encode_espa_bands},
+    {"espa_spatial_subset", worker_espa_spatial_subset},
+    {"stack_espa_bands", worker_stack_espa_bands},
+    {"build_espa_overviews", worker_build_espa_overviews},
+    {"espa_warp", worker_espa_warp},
+    {"unpack_espa_qa", worker_unpack_espa_qa},
+    {"create_angle_bands", worker_create_angle_bands},
+    {"espa_validate", worker_espa_validate},
+    {"upgrade_espa_metadata", worker_upgrade_espa_metadata},
+    {"convert_bip_to_espa", worker_convert_bip_to_espa},
+    {"espa_validate_pixels", worker_espa_validate_pixels}
+};
+#define WORKER_NTOOLS (sizeof (worker_tools) / sizeof (worker_tools[0]))
+
+/* Connection of a client scraping the metrics */
+typedef struct
+{
+    int fd;                      /* socket of the client; -1 if the slot is
+                                    free */
+    char request[WORKER_HTTP_REQUEST];  /* request read so far */
+    size_t nread;                /* bytes of the request read */
+    char *response;              /* response to send; NULL until the
+                                    request is read */
+    size_t response_size;        /* bytes in the response */
+    size_t nsent;                /* bytes of the response sent */
+    struct timespec deadline;    /* time the exchange must be done by
+                                    (CLOCK_MONOTONIC) */
+} Metrics_client_t;
+
+/* Set by the signal handler when the worker is asked to stop */
+static volatile sig_atomic_t stop_requested = 0;
+
+/* Names of the tools, for the metrics */
+static const char *worker_tool_names[WORKER_NTOOLS];
+
+
+/******************************************************************************
+MODULE: usage
+
+PURPOSE: Prints the usage information for this application.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+void usage ()
+{
+    unsigned int i;              /* looping variable for the tools */
+
+    printf ("espa_formatter_worker runs the raw binary tools as jobs "
+            "submitted over a Unix socket.  The worker initializes libxml2, "
+            "compiles the ESPA schema, and keeps the land mass polygons "
+            "open once, and each job runs its tool in a process forked from "
+            "the worker, which starts from that state.  The same executable "
+            "submits a job to a running worker and exits with the exit "
+            "status of the tool.\n");
+    printf ("version: %s\n\n", ESPA_COMMON_VERSION);
+    printf ("usage: espa_formatter_worker --socket=socket_filename "
+            "[--jobs=number_of_jobs] [--polygon=land_mass_polygon] "
+            "[--metrics=[host:]port]\n");
+    printf ("       espa_formatter_worker --socket=socket_filename --submit "
+            "tool [tool arguments]\n");
+    printf ("\nwhere the following parameters are required:\n");
+    printf ("    -socket: name of the Unix socket the worker listens on\n");
+    printf ("\nwhere the following parameters are optional:\n");
+    printf ("    -jobs: number of jobs run at a time (default is the number "
+            "of processors)\n");
+    printf ("    -polygon: land mass polygon file kept open for the jobs "
+            "(default is the ESPA_LAND_MASS_POLYGON environment variable, "
+            "if set)\n");
+    printf ("    -metrics: TCP port, with an optional host to listen on, "
+            "where the job metrics are served over HTTP at /metrics in the "
+            "Prometheus text format; the host defaults to %s, and 0.0.0.0 "
+            "or [::] serves them on every address (default is no "
+            "metrics)\n", WORKER_HTTP_HOST);
+    printf ("    -submit: submit the tool and its arguments to the worker "
+            "listening on the socket, rather than starting a worker\n");
+    printf ("\nThe tools which can be run are:");
+    for (i = 0; i < WORKER_NTOOLS; i++)
+        printf ("%s %s", i == 0 ? "" : ",", worker_tools[i].name);
+    printf ("\n");
+    printf ("\nExample: espa_formatter_worker "
+            "--socket=/run/espa/worker.sock --jobs=16 &\n");
+    printf ("         espa_formatter_worker --socket=/run/espa/worker.sock "
+            "--submit convert_espa_to_gtif "
+            "--xml=LE07_L1TP_022033_20140228_20161028_02_T1.xml "
+            "--gtif=LE07_L1TP_022033_20140228_20161028_02_T1\n");
+}
+
+
+/******************************************************************************
+MODULE:  get_args
+
+PURPOSE:  Gets the command-line arguments and validates that the required
+arguments were specified.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error getting the command-line arguments or a command-line
+                argument and associated value were not specified
+SUCCESS         No errors encountered
+
+NOTES:
+  1. Memory is allocated for the socket and polygon filenames and the
+     metrics address.  These should be character pointers set to NULL on
+     input.  The caller is responsible
+     for freeing the allocated memory upon successful return.
+  2. The options stop at the tool name of a submitted job, so the options of
+     the tool are passed along untouched.
+******************************************************************************/
+short get_args
+(
+    int argc,             /* I: number of cmd-line args */
+    char *argv[],         /* I: string of cmd-line args */
+    char **socket_file,   /* O: address of the socket filename */
+    int *njobs,           /* O: number of jobs run at a time */
+    char **polygon_file,  /* O: address of the land mass polygon filename */
+    char **metrics_addr,  /* O: address of the [host:]port the metrics are
+                                served on */
+    int *tool_index       /* O: index in argv of the tool of a submitted
+                                job; 0 when starting a worker */
+)
+{
+    int c;                           /* current argument index */
+    int option_index;                /* index for the command-line option */
+    char errmsg[STR_SIZE];           /* error message */
+    char FUNC_NAME[] = "get_args";   /* function name */
+    static int submit_flag = 0;      /* flag for submitting a job */
+    static struct option long_options[] =
+    {
+        {"submit", no_argument, &submit_flag, 1},
+        {"socket", required_argument, 0, 's'},
+        {"jobs", required_argument, 0, 'j'},
+        {"polygon", required_argument, 0, 'p'},
+        {"metrics", required_argument, 0, 'm'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    /* Loop through all the cmd-line options, stopping at the first
+       argument which isn't an option */
+    opterr = 0;   /* turn off getopt_long error msgs as we'll print our own */
+    while (1)
+    {
+        c = getopt_long (argc, argv, "+", long_options, &option_index);
+        if (c == -1)
+        {   /* Out of cmd-line options */
+            break;
+        }
+
+        switch (c)
+        {
+            case 0:
+                /* If this option set a flag, do nothing else now. */
+                if (long_options[option_index].flag != 0)
+                    break;
+
+            case 'h':  /* help */
+                usage ();
+                return (ERROR);
+                break;
+
+            case 's':  /* socket filename */
+                *socket_file = strdup (optarg);
+                break;
+
+            case 'j':  /* number of jobs */
+                *njobs = atoi (optarg);
+                break;
+
+            case 'p':  /* land mass polygon filename */
+                *polygon_file = strdup (optarg);
+                break;
+
+            case 'm':  /* address of the metrics */
+                *metrics_addr = strdup (optarg);
+                break;
+
+            case '?':
+            default:
+                sprintf (errmsg, "Unknown option %s", argv[optind-1]);
+                error_handler (true, FUNC_NAME, errmsg);
+                usage ();
+                return (ERROR);
+                break;
+        }
+    }
+
+    /* Make sure the socket was specified */
+    if (*socket_file == NULL)
+    {
+        sprintf (errmsg, "Socket file is a required argument");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+    if (strlen (*socket_file) >= sizeof (((struct sockaddr_un *) 0)->sun_path))
+    {
+        sprintf (errmsg, "Socket filename is too long: %s", *socket_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    if (*njobs < 1)
+    {
+        sprintf (errmsg, "Number of jobs must be positive");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    /* A submitted job needs a tool; a worker takes no other arguments */
+    *tool_index = 0;
+    if (submit_flag)
+    {
+        if (optind >= argc)
+        {
+            sprintf (errmsg, "The tool to be run is a required argument "
+                "with --submit");
+            error_handler (true, FUNC_NAME, errmsg);
+            usage ();
+            return (ERROR);
+        }
+        *tool_index = optind;
+    }
+    else if (optind < argc)
+    {
+        sprintf (errmsg, "Unexpected argument %s; use --submit to run a "
+            "tool", argv[optind]);
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  io_full
+
+PURPOSE:  Reads or writes all the bytes of a buffer on a socket, continuing
+past short transfers and interrupted calls.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error on the socket, or it was closed first
+SUCCESS         All the bytes were transferred
+
+NOTES:
+******************************************************************************/
+static int io_full
+(
+    int fd,              /* I: socket */
+    bool write_buf,      /* I: write the buffer rather than read it? */
+    void *buf,           /* I/O: buffer */
+    size_t nbytes        /* I: number of bytes to transfer */
+)
+{
+    char *ptr = buf;     /* next byte to transfer */
+    ssize_t count;       /* bytes transferred by a call */
+
+    while (nbytes > 0)
+    {
+        if (write_buf)
+            count = write (fd, ptr, nbytes);
+        else
+            count = read (fd, ptr, nbytes);
+        if (count < 0 && errno == EINTR)
+            continue;
+        if (count <= 0)
+            return (ERROR);
+        ptr += count;
+        nbytes -= count;
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  find_worker_tool
+
+PURPOSE:  Finds a tool which can be run as a job by the name of its
+executable.
+
+RETURN VALUE:
+Type = const Worker_tool_t *
+Value           Description
+-----           -----------
+NULL            The tool isn't linked into the worker
+non-NULL        The tool
+
+NOTES:
+  1. A path to the executable is accepted, so a job can be submitted with
+     the same command line the tool would be run with.
+******************************************************************************/
+static const Worker_tool_t *find_worker_tool
+(
+    const char *name     /* I: name of (or path to) the tool */
+)
+{
+    const char *base = NULL;     /* name without its directory */
+    unsigned int i;              /* looping variable for the tools */
+
+    base = strrchr (name, '/');
+    base = base == NULL ? name : base + 1;
+    for (i = 0; i < WORKER_NTOOLS; i++)
+    {
+        if (!strcmp (base, worker_tools[i].name))
+            return &worker_tools[i];
+    }
+
+    return NULL;
+}
+
+
+/******************************************************************************
+MODULE:  submit_job
+
+PURPOSE:  Submits a job to the worker listening on the socket, passing
+along this process's stdout and stderr, and waits for it to finish.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error submitting the job
+other           Exit status of the tool
+
+NOTES:
+  1. The request is the length of the rest of the request (sent with the
+     descriptors), then the working directory, the tool name, and the
+     arguments, each terminated by a NUL.
+******************************************************************************/
+static int submit_job
+(
+    const char *socket_file,  /* I: socket the worker listens on */
+    int nargs,                /* I: number of arguments, with the tool */
+    char **args               /* I: tool name and its arguments */
+)
+{
+    char FUNC_NAME[] = "submit_job";  /* function name */
+    char errmsg[STR_SIZE];       /* error message */
+    char cwd[PATH_MAX];          /* working directory of the job */
+    char *request = NULL;        /* body of the request */
+    char *ptr = NULL;            /* next byte of the request */
+    char control[CMSG_SPACE (2 * sizeof (int))];  /* descriptors passed */
+    int fd;                      /* socket connected to the worker */
+    int i;                       /* looping variable for the arguments */
+    int fds[2];                  /* stdout and stderr of this process */
+    int32_t status;              /* exit status of the tool */
+    uint32_t nbytes;             /* length of the body of the request */
+    size_t len;                  /* length of a string of the request */
+    struct sockaddr_un addr;     /* address of the socket */
+    struct msghdr msg;           /* message carrying the descriptors */
+    struct iovec iov;            /* length sent with the descriptors */
+    struct cmsghdr *cmsg = NULL; /* header of the descriptors */
+
+    if (find_worker_tool (args[0]) == NULL)
+    {
+        sprintf (errmsg, "%s is not one of the tools the worker runs",
+            args[0]);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    if (nargs >= WORKER_MAX_ARGS)
+    {
+        sprintf (errmsg, "Too many arguments for %s", args[0]);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    if (getcwd (cwd, sizeof (cwd)) == NULL)
+    {
+        sprintf (errmsg, "Getting the working directory");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Lay out the body of the request */
+    len = strlen (cwd) + 1;
+    for (i = 0; i < nargs; i++)
+        len += strlen (args[i]) + 1;
+    if (len > WORKER_MAX_REQUEST)
+    {
+        sprintf (errmsg, "Job request for %s is too large", args[0]);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    nbytes = len;
+    request = malloc (nbytes);
+    if (request == NULL)
+    {
+        sprintf (errmsg, "Allocating the job request");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    ptr = request;
+    len = strlen (cwd) + 1;
+    memcpy (ptr, cwd, len);
+    ptr += len;
+    for (i = 0; i < nargs; i++)
+    {
+        len = strlen (args[i]) + 1;
+        memcpy (ptr, args[i], len);
+        ptr += len;
+    }
+
+    /* Connect to the worker */
+    fd = socket (AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+    {
+        sprintf (errmsg, "Creating the socket");
+        error_handler (true, FUNC_NAME, errmsg);
+        free (request);
+        return (ERROR);
+    }
+    memset (&addr, 0, sizeof (addr));
+    addr.sun_family = AF_UNIX;
+    strcpy (addr.sun_path, socket_file);
+    if (connect (fd, (struct sockaddr *) &addr, sizeof (addr)) != 0)
+    {
+        sprintf (errmsg, "Connecting to the worker on %s: %s", socket_file,
+            strerror (errno));
+        error_handler (true, FUNC_NAME, errmsg);
+        close (fd);
+        free (request);
+        return (ERROR);
+    }
+
+    /* Send the length of the request along with stdout and stderr, then
+       the request itself; a worker which refuses the job closes the
+       connection, which is reported rather than raising SIGPIPE */
+    signal (SIGPIPE, SIG_IGN);
+    fflush (stdout);
+    fflush (stderr);
+    fds[0] = STDOUT_FILENO;
+    fds[1] = STDERR_FILENO;
+    iov.iov_base = &nbytes;
+    iov.iov_len = sizeof (nbytes);
+    memset (&msg, 0, sizeof (msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof (control);
+    cmsg = CMSG_FIRSTHDR (&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN (sizeof (fds));
+    memcpy (CMSG_DATA (cmsg), fds, sizeof (fds));
+    if (sendmsg (fd, &msg, 0) != sizeof (nbytes) ||
+        io_full (fd, true, request, nbytes) != SUCCESS)
+    {
+        sprintf (errmsg, "Sending the job request to the worker");
+        error_handler (true, FUNC_NAME, errmsg);
+        close (fd);
+        free (request);
+        return (ERROR);
+    }
+    free (request);
+
+    /* Wait for the exit status of the tool */
+    if (io_full (fd, false, &status, sizeof (status)) != SUCCESS)
+    {
+        sprintf (errmsg, "The worker closed the connection before %s "
+            "finished", args[0]);
+        error_handler (true, FUNC_NAME, errmsg);
+        close (fd);
+        return (ERROR);
+    }
+    close (fd);
+
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  receive_job
+
+PURPOSE:  Receives a job request from a client, along with the client's
+stdout and stderr.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error receiving the request, or it isn't valid
+SUCCESS         The request was received
+
+NOTES:
+  1. *request holds the strings pointed to by args, and is to be freed by
+     the caller.  args[nargs] is NULL, as for a main function.
+  2. The descriptors received are closed on error.
+******************************************************************************/
+static int receive_job
+(
+    int fd,              /* I: socket connected to the client */
+    char **request,      /* O: body of the request */
+    char **cwd,          /* O: working directory of the job */
+    int *nargs,          /* O: number of arguments, with the tool */
+    char **args,         /* O: tool and its arguments (WORKER_MAX_ARGS+1) */
+    int *fds             /* O: stdout and stderr of the client */
+)
+{
+    char FUNC_NAME[] = "receive_job";  /* function name */
+    char errmsg[STR_SIZE];       /* error message */
+    char control[CMSG_SPACE (2 * sizeof (int))];  /* descriptors passed */
+    char *ptr = NULL;            /* next string of the request */
+    char *end = NULL;            /* end of the request */
+    uint32_t nbytes;             /* length of the body of the request */
+    struct msghdr msg;           /* message carrying the descriptors */
+    struct iovec iov;            /* length sent with the descriptors */
+    struct cmsghdr *cmsg = NULL; /* header of the descriptors */
+    ssize_t count;               /* bytes received */
+
+    *request = NULL;
+    fds[0] = -1;
+    fds[1] = -1;
+
+    iov.iov_base = &nbytes;
+    iov.iov_len = sizeof (nbytes);
+    memset (&msg, 0, sizeof (msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof (control);
+    do
+        count = recvmsg (fd, &msg, MSG_CMSG_CLOEXEC);
+    while (count < 0 && errno == EINTR);
+    cmsg = CMSG_FIRSTHDR (&msg);
+    if (cmsg != NULL && cmsg->cmsg_level == SOL_SOCKET &&
+        cmsg->cmsg_type == SCM_RIGHTS &&
+        cmsg->cmsg_len == CMSG_LEN (2 * sizeof (int)))
+    {
+        memcpy (fds, CMSG_DATA (cmsg), 2 * sizeof (int));
+    }
+    if (count != sizeof (nbytes) || fds[0] < 0 || fds[1] < 0 ||
+        nbytes == 0 || nbytes > WORKER_MAX_REQUEST)
+    {
+        sprintf (errmsg, "Job request isn't valid");
+        error_handler (true, FUNC_NAME, errmsg);
+        goto error;
+    }
+
+    /* Read the request and split it into its strings */
+    *request = malloc (nbytes);
+    if (*request == NULL)
+    {
+        sprintf (errmsg, "Allocating the job request");
+        error_handler (true, FUNC_NAME, errmsg);
+        goto error;
+    }
+    if (io_full (fd, false, *request, nbytes) != SUCCESS ||
+        (*request)[nbytes-1] != '\0')
+    {
+        sprintf (errmsg, "Receiving the job request");
+        error_handler (true, FUNC_NAME, errmsg);
+        goto error;
+    }
+    *cwd = *request;
+    end = *request + nbytes;
+    *nargs = 0;
+    for (ptr = *cwd + strlen (*cwd) + 1; ptr < end;
+         ptr += strlen (ptr) + 1)
+    {
+        if (*nargs == WORKER_MAX_ARGS)
+        {
+            sprintf (errmsg, "Too many arguments in the job request");
+            error_handler (true, FUNC_NAME, errmsg);
+            goto error;
+        }
+        args[(*nargs)++] = ptr;
+    }
+    args[*nargs] = NULL;
+    if (*nargs == 0)
+    {
+        sprintf (errmsg, "Job request has no tool");
+        error_handler (true, FUNC_NAME, errmsg);
+        goto error;
+    }
+
+    return (SUCCESS);
+
+error:
+    if (fds[0] >= 0)
+        close (fds[0]);
+    if (fds[1] >= 0)
+        close (fds[1]);
+    free (*request);
+    *request = NULL;
+    return (ERROR);
+}
+
+
+/******************************************************************************
+MODULE:  read_job_io
+
+PURPOSE:  Reads the bytes a finished process read and wrote, from its I/O
+accounting.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. The process must have exited but not yet been reaped (see waitid with
+     WNOWAIT), so its accounting is complete and still there.
+  2. The bytes are those passed through the read and write system calls,
+     whether or not they were in the page cache; files which are mapped
+     (ex. the land mass polygons) aren't counted.  They are 0 if the
+     accounting can't be read.
+******************************************************************************/
+static void read_job_io
+(
+    pid_t pid,                   /* I: process of the tool */
+    uint64_t *bytes_read,        /* O: bytes read by the process */
+    uint64_t *bytes_written      /* O: bytes written by the process */
+)
+{
+    char path[STR_SIZE];         /* name of the accounting file */
+    char line[STR_SIZE];         /* line of the accounting file */
+    unsigned long long value;    /* value of a line */
+    FILE *fptr = NULL;           /* accounting file */
+
+    *bytes_read = 0;
+    *bytes_written = 0;
+    snprintf (path, sizeof (path), "/proc/%ld/io", (long) pid);
+    fptr = fopen (path, "r");
+    if (fptr == NULL)
+        return;
+    while (fgets (line, sizeof (line), fptr) != NULL)
+    {
+        if (sscanf (line, "rchar: %llu", &value) == 1)
+            *bytes_read = value;
+        else if (sscanf (line, "wchar: %llu", &value) == 1)
+            *bytes_written = value;
+    }
+    fclose (fptr);
+}
+
+
+/******************************************************************************
+MODULE:  run_job
+
+PURPOSE:  Runs a job: receives the request, runs the tool in a process of
+its own, and sends its exit status back to the client.  This is called in a
+process forked from the worker for each connection, and doesn't return.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. The tool runs in a process forked from this one, so a tool which
+     crashes (or exits without flushing) is still reported to the client.
+  2. The job's lines in the worker's output are its number, tool, exit
+     status, and wall time.
+  3. The job is recorded in the metrics (see espa_metrics.h), with the bytes
+     read and written and the peak memory of the tool's process.
+******************************************************************************/
+static void run_job
+(
+    int fd,              /* I: socket connected to the client */
+    long job             /* I: number of the job, for the worker's output */
+)
+{
+    char FUNC_NAME[] = "run_job";  /* function name */
+    char errmsg[STR_SIZE];       /* error message */
+    char *request = NULL;        /* body of the request */
+    char *cwd = NULL;            /* working directory of the job */
+    char *args[WORKER_MAX_ARGS+1];  /* tool and its arguments */
+    int nargs;                   /* number of arguments, with the tool */
+    int fds[2];                  /* stdout and stderr of the client */
+    int wstatus;                 /* wait status of the tool */
+    int32_t status;              /* exit status sent to the client */
+    pid_t pid;                   /* process running the tool */
+    uint64_t bytes_read = 0;     /* bytes read by the tool */
+    uint64_t bytes_written = 0;  /* bytes written by the tool */
+    double seconds;              /* wall time of the job */
+    const Worker_tool_t *tool = NULL;  /* tool of the job */
+    struct timespec start;       /* time the job started */
+    struct timespec end;         /* time the job ended */
+    struct rusage usage;         /* resource usage of the tool */
+    siginfo_t info;              /* exit of the tool, before it is reaped */
+
+    clock_gettime (CLOCK_MONOTONIC, &start);
+    memset (&usage, 0, sizeof (usage));
+    if (receive_job (fd, &request, &cwd, &nargs, args, fds) != SUCCESS)
+    {  /* Error messages already written */
+        close (fd);
+        exit (EXIT_FAILURE);
+    }
+
+    tool = find_worker_tool (args[0]);
+    if (tool == NULL)
+    {
+        sprintf (errmsg, "Job %ld: %s is not one of the tools the worker "
+            "runs", job, args[0]);
+        error_handler (true, FUNC_NAME, errmsg);
+        status = EXIT_FAILURE;
+        io_full (fd, true, &status, sizeof (status));
+        exit (EXIT_FAILURE);
+    }
+
+    pid = fork ();
+    if (pid == 0)
+    {
+        /* Run the tool as though it had been started by the client */
+        signal (SIGTERM, SIG_DFL);
+        signal (SIGINT, SIG_DFL);
+        signal (SIGPIPE, SIG_DFL);
+        espa_metrics_set_tool (tool - worker_tools);
+        close (fd);
+        if (dup2 (fds[0], STDOUT_FILENO) < 0 ||
+            dup2 (fds[1], STDERR_FILENO) < 0)
+            _exit (EXIT_FAILURE);
+        close (fds[0]);
+        close (fds[1]);
+        if (chdir (cwd) != 0)
+        {
+            sprintf (errmsg, "Changing to the working directory %s", cwd);
+            error_handler (true, FUNC_NAME, errmsg);
+            exit (EXIT_FAILURE);
+        }
+        optind = 0;      /* start getopt over for the tool */
+        exit (tool->main (nargs, args));
+    }
+    close (fds[0]);
+    close (fds[1]);
+
+    if (pid < 0)
+    {
+        sprintf (errmsg, "Job %ld: unable to fork the process for %s", job,
+            tool->name);
+        error_handler (true, FUNC_NAME, errmsg);
+        status = EXIT_FAILURE;
+    }
+    else
+    {
+        /* Read the tool's I/O accounting before reaping it */
+        while (waitid (P_PID, pid, &info, WEXITED | WNOWAIT) < 0 &&
+            errno == EINTR)
+            ;
+        read_job_io (pid, &bytes_read, &bytes_written);
+        while (wait4 (pid, &wstatus, 0, &usage) < 0 && errno == EINTR)
+            ;
+        if (WIFEXITED (wstatus))
+            status = WEXITSTATUS (wstatus);
+        else if (WIFSIGNALED (wstatus))
+            status = 128 + WTERMSIG (wstatus);
+        else
+            status = EXIT_FAILURE;
+    }
+
+    io_full (fd, true, &status, sizeof (status));
+    close (fd);
+
+    clock_gettime (CLOCK_MONOTONIC, &end);
+    seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) *
+        1e-9;
+    espa_metrics_job_done (tool - worker_tools, status == 0, seconds,
+        bytes_read, bytes_written, usage.ru_maxrss);
+    printf ("Job %ld: %s exited with status %d in %.3f seconds\n", job,
+        tool->name, status, seconds);
+    free (request);
+    exit (status == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+}
+
+
+/******************************************************************************
+MODULE:  handle_stop
+
+PURPOSE:  Signal handler which asks the worker to stop accepting jobs.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+static void handle_stop
+(
+    int signum           /* I: signal received */
+)
+{
+    stop_requested = 1;
+}
+
+
+/******************************************************************************
+MODULE:  handle_child
+
+PURPOSE:  Signal handler for a job finishing.  It does nothing itself; the
+signal only wakes the worker to reap the job.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+static void handle_child
+(
+    int signum           /* I: signal received */
+)
+{
+}
+
+
+/******************************************************************************
+MODULE:  open_metrics_socket
+
+PURPOSE:  Listens on the TCP address the metrics are served on.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error listening on the address
+other           Socket listened on
+
+NOTES:
+  1. The address is [host:]port; without a host the metrics are only served
+     on WORKER_HTTP_HOST, the loopback address.  An IPv6 host is given in
+     brackets.
+******************************************************************************/
+static int open_metrics_socket
+(
+    const char *metrics_addr  /* I: [host:]port to listen on */
+)
+{
+    char FUNC_NAME[] = "open_metrics_socket";  /* function name */
+    char errmsg[STR_SIZE];       /* error message */
+    char host[STR_SIZE];         /* host to listen on */
+    const char *port = NULL;     /* port to listen on */
+    const char *colon = NULL;    /* colon before the port */
+    int fd = -1;                 /* socket listened on */
+    int one = 1;                 /* value of the socket options */
+    int status;                  /* return status of getaddrinfo */
+    size_t len;                  /* length of the host */
+    struct addrinfo hints;       /* kind of addresses to listen on */
+    struct addrinfo *addrs = NULL;  /* addresses of the host */
+    struct addrinfo *addr = NULL;   /* address being tried */
+
+    /* Split the host from the port */
+    strcpy (host, WORKER_HTTP_HOST);
+    colon = strrchr (metrics_addr, ':');
+    port = colon == NULL ? metrics_addr : colon + 1;
+    if (colon != NULL && colon != metrics_addr)
+    {
+        len = colon - metrics_addr;
+        if (len >= 2 && metrics_addr[0] == '[' && metrics_addr[len-1] == ']')
+        {
+            metrics_addr++;
+            len -= 2;
+        }
+        if (len >= sizeof (host))
+            len = sizeof (host) - 1;
+        memcpy (host, metrics_addr, len);
+        host[len] = '\0';
+    }
+
+    memset (&hints, 0, sizeof (hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    status = getaddrinfo (host, port, &hints, &addrs);
+    if (status != 0)
+    {
+        sprintf (errmsg, "Resolving the metrics address %s: %s",
+            metrics_addr, gai_strerror (status));
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    for (addr = addrs; addr != NULL; addr = addr->ai_next)
+    {
+        fd = socket (addr->ai_family, addr->ai_socktype | SOCK_CLOEXEC,
+            addr->ai_protocol);
+        if (fd < 0)
+            continue;
+        setsockopt (fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof (one));
+        if (bind (fd, addr->ai_addr, addr->ai_addrlen) == 0 &&
+            listen (fd, WORKER_BACKLOG) == 0)
+            break;
+        close (fd);
+        fd = -1;
+    }
+    freeaddrinfo (addrs);
+
+    if (fd < 0)
+    {
+        sprintf (errmsg, "Listening for the metrics on %s: %s",
+            metrics_addr, strerror (errno));
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (fd);
+}
+
+
+/******************************************************************************
+MODULE:  close_metrics_client
+
+PURPOSE:  Closes the connection of a metrics client and frees its slot.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+static void close_metrics_client
+(
+    Metrics_client_t *client  /* I/O: client to close */
+)
+{
+    if (client->fd >= 0)
+        close (client->fd);
+    free (client->response);
+    client->fd = -1;
+    client->response = NULL;
+}
+
+
+/******************************************************************************
+MODULE:  accept_metrics_client
+
+PURPOSE:  Accepts a connection on the metrics socket into a free client
+slot, without blocking, and starts the deadline of its request.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+static void accept_metrics_client
+(
+    int listen_fd,            /* I: socket the metrics are served on */
+    Metrics_client_t *client  /* O: slot of the client */
+)
+{
+    client->fd = accept4 (listen_fd, NULL, NULL,
+        SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (client->fd < 0)
+        return;
+    client->nread = 0;
+    client->response = NULL;
+    client->response_size = 0;
+    client->nsent = 0;
+    clock_gettime (CLOCK_MONOTONIC, &client->deadline);
+    client->deadline.tv_sec += WORKER_HTTP_TIMEOUT;
+}
+
+
+/******************************************************************************
+MODULE:  build_metrics_response
+
+PURPOSE:  Builds the HTTP response to the request read from a metrics
+client, with the metrics for GET /metrics.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error building the response
+SUCCESS         The response is ready to be sent
+
+NOTES:
+******************************************************************************/
+static int build_metrics_response
+(
+    Metrics_client_t *client  /* I/O: client whose request is answered */
+)
+{
+    char header[STR_SIZE];       /* header of the response */
+    char method[8];              /* method of the request */
+    char path[STR_SIZE];         /* path of the request */
+    char *body = NULL;           /* body of the response */
+    const char *status_line = NULL;  /* status of the response */
+    int len;                     /* length of the header */
+    size_t body_size = 0;        /* bytes in the body */
+    FILE *fptr = NULL;           /* stream of the body */
+
+    /* Only the metrics are served */
+    client->request[client->nread] = '\0';
+    if (sscanf (client->request, "%7s %1023s", method, path) != 2)
+        status_line = "400 Bad Request";
+    else if (strcmp (method, "GET"))
+        status_line = "405 Method Not Allowed";
+    else if (strcmp (path, "/metrics") && strncmp (path, "/metrics?", 9))
+        status_line = "404 Not Found";
+    else
+        status_line = "200 OK";
+
+    fptr = open_memstream (&body, &body_size);
+    if (fptr == NULL)
+        return (ERROR);
+    if (!strcmp (status_line, "200 OK"))
+        espa_metrics_write (fptr, worker_tool_names);
+    else
+        fprintf (fptr, "%s\n", status_line);
+    fclose (fptr);
+
+    len = snprintf (header, sizeof (header), "HTTP/1.0 %s\r\n"
+        "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+        "Content-Length: %zu\r\nConnection: close\r\n\r\n", status_line,
+        body_size);
+    client->response = malloc (len + body_size);
+    if (client->response == NULL)
+    {
+        free (body);
+        return (ERROR);
+    }
+    memcpy (client->response, header, len);
+    memcpy (client->response + len, body, body_size);
+    client->response_size = len + body_size;
+    client->nsent = 0;
+    free (body);
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  serve_metrics_client
+
+PURPOSE:  Reads the part of a metrics client's request which has arrived,
+and sends the part of its response the socket will take, without blocking.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. One request is answered per connection, and the client is closed once
+     its response is sent, or on any error.
+******************************************************************************/
+static void serve_metrics_client
+(
+    Metrics_client_t *client  /* I/O: client which is ready */
+)
+{
+    ssize_t count;               /* bytes read or sent by a call */
+
+    /* Read the request line and headers */
+    while (client->response == NULL)
+    {
+        count = read (client->fd, client->request + client->nread,
+            sizeof (client->request) - 1 - client->nread);
+        if (count < 0 && errno == EINTR)
+            continue;
+        if (count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            return;
+        if (count < 0)
+        {
+            close_metrics_client (client);
+            return;
+        }
+        client->nread += count;
+        client->request[client->nread] = '\0';
+        if (count == 0 || client->nread == sizeof (client->request) - 1 ||
+            strstr (client->request, "\r\n\r\n") != NULL ||
+            strstr (client->request, "\n\n") != NULL)
+        {
+            if (build_metrics_response (client) != SUCCESS)
+            {
+                close_metrics_client (client);
+                return;
+            }
+        }
+    }
+
+    /* Send the response */
+    while (client->nsent < client->response_size)
+    {
+        count = write (client->fd, client->response + client->nsent,
+            client->response_size - client->nsent);
+        if (count < 0 && errno == EINTR)
+            continue;
+        if (count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            return;
+        if (count <= 0)
+            break;
+        client->nsent += count;
+    }
+    close_metrics_client (client);
+}
+
+
+/******************************************************************************
+MODULE:  expire_metrics_clients
+
+PURPOSE:  Drops the metrics clients which haven't finished their exchange by
+their deadline, and finds the time until the next deadline.
+
+RETURN VALUE:
+Type = bool
+Value           Description
+-----           -----------
+true            A client is connected; wait is the time until its deadline
+false           No client is connected
+
+NOTES:
+******************************************************************************/
+static bool expire_metrics_clients
+(
+    Metrics_client_t *clients,  /* I/O: slots of the clients */
+    struct timespec *wait       /* O: time until the next deadline */
+)
+{
+    int i;                       /* looping variable for the clients */
+    bool waiting = false;        /* is a client connected? */
+    long long left;              /* nanoseconds until a deadline */
+    long long least = 0;         /* nanoseconds until the next deadline */
+    struct timespec now;         /* current time */
+
+    clock_gettime (CLOCK_MONOTONIC, &now);
+    for (i = 0; i < WORKER_HTTP_CLIENTS; i++)
+    {
+        if (clients[i].fd < 0)
+            continue;
+        left = (clients[i].deadline.tv_sec - now.tv_sec) * 1000000000LL +
+            (clients[i].deadline.tv_nsec - now.tv_nsec);
+        if (left <= 0)
+        {
+            close_metrics_client (&clients[i]);
+            continue;
+        }
+        if (!waiting || left < least)
+            least = left;
+        waiting = true;
+    }
+
+    wait->tv_sec = least / 1000000000LL;
+    wait->tv_nsec = least % 1000000000LL;
+    return (waiting);
+}
+
+
+/******************************************************************************
+MODULE:  start_job
+
+PURPOSE:  Forks the process which runs a job accepted from a client.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           The process couldn't be forked
+SUCCESS         The job is running
+
+NOTES:
+  1. The connection is closed in the worker either way; on error the client
+     sees the worker close it.
+******************************************************************************/
+static int start_job
+(
+    int fd,                   /* I: socket connected to the client */
+    long njob,                /* I: number of the job */
+    const int *close_fds,     /* I: descriptors the job doesn't need */
+    int nclose,               /* I: number of descriptors to close */
+    const sigset_t *orig_mask /* I: signal mask to run the job with */
+)
+{
+    char FUNC_NAME[] = "start_job";  /* function name */
+    char errmsg[STR_SIZE];       /* error message */
+    int i;                       /* looping variable for the descriptors */
+    pid_t pid;                   /* process of the job */
+
+    /* Flush the output so the job doesn't repeat it */
+    fflush (stdout);
+    fflush (stderr);
+    pid = fork ();
+    if (pid == 0)
+    {
+        for (i = 0; i < nclose; i++)
+            close (close_fds[i]);
+        signal (SIGCHLD, SIG_DFL);
+        sigprocmask (SIG_SETMASK, orig_mask, NULL);
+        setvbuf (stdout, NULL, _IOLBF, 0);
+        run_job (fd, njob);
+    }
+    close (fd);
+    if (pid < 0)
+    {
+        sprintf (errmsg, "Unable to fork job %ld", njob);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  serve_jobs
+
+PURPOSE:  Listens on the socket and runs the jobs submitted to it, njobs at
+a time, until the worker is sent SIGTERM or SIGINT.  The metrics are served
+as well when a metrics socket is given.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error setting up the socket
+SUCCESS         The worker was asked to stop, and its jobs have finished
+
+NOTES:
+  1. Each connection is handed to a process forked from the worker (see
+     run_job).  Once njobs are running, the next connections wait in the
+     worker's queue, up to WORKER_BACKLOG of them, until one of the jobs is
+     done; beyond that they wait to be accepted.
+  2. A stale socket file left by a worker which didn't exit cleanly is
+     replaced, but any other kind of file at that path is left alone and is
+     an error.
+  3. SIGCHLD, SIGTERM, and SIGINT are only let through while the worker
+     waits in ppoll, so a job which finishes or a request to stop is never
+     missed between the checks and the wait.
+  4. Jobs still waiting for a slot when the worker stops aren't run; their
+     clients see the worker close the connection.
+  5. The metrics clients are served WORKER_HTTP_CLIENTS at a time (see
+     serve_metrics_client); beyond that they wait to be accepted.
+  6. The socket is created with mode 0600, and a connection is closed
+     without a job unless its peer runs as the worker's user (SO_PEERCRED).
+******************************************************************************/
+static int serve_jobs
+(
+    const char *socket_file,  /* I: socket to listen on */
+    int njobs,                /* I: number of jobs run at a time */
+    int metrics_fd            /* I: socket the metrics are served on; -1 if
+                                    none */
+)
+{
+    char FUNC_NAME[] = "serve_jobs";  /* function name */
+    char errmsg[STR_SIZE];       /* error message */
+    int listen_fd;               /* socket listened on */
+    int fd;                      /* socket of an accepted connection */
+    int nrunning = 0;            /* number of jobs running */
+    int nqueued = 0;             /* number of jobs waiting for a slot */
+    int queue[WORKER_BACKLOG+2+WORKER_HTTP_CLIENTS];  /* connections of the
+                                    jobs waiting for a slot, followed by the
+                                    sockets of the worker for the jobs to
+                                    close */
+    int nclose;                  /* number of descriptors for a job to
+                                    close */
+    int nfds;                    /* number of descriptors polled */
+    int metrics_index = -1;      /* index of the metrics socket in fds; -1
+                                    if it isn't polled */
+    int client_index[WORKER_HTTP_CLIENTS];  /* index of each metrics client
+                                    in fds; -1 if it isn't polled */
+    int free_client;             /* free slot for a metrics client; -1 if
+                                    none */
+    int i;                       /* looping variable for the clients */
+    int status;                  /* return status of bind */
+    bool timed;                  /* is a metrics client waited on? */
+    long njob = 0;               /* number of jobs started */
+    pid_t pid;                   /* process of a job */
+    struct sockaddr_un addr;     /* address of the socket */
+    struct stat file_stat;       /* status of a file at the socket path */
+    struct ucred peer;           /* credentials of a client */
+    socklen_t peer_len;          /* size of the credentials */
+    mode_t orig_umask;           /* file creation mask of the worker */
+    struct sigaction action;     /* handler of the signals */
+    struct pollfd fds[2+WORKER_HTTP_CLIENTS];  /* sockets waited on */
+    struct timespec wait;        /* time until the next metrics deadline */
+    Metrics_client_t clients[WORKER_HTTP_CLIENTS];  /* metrics clients */
+    sigset_t block_mask;         /* signals blocked outside of ppoll */
+    sigset_t orig_mask;          /* signal mask of the worker */
+
+    /* Stop on SIGTERM or SIGINT, wake up when a job finishes, and don't let
+       a client which goes away take the worker with it */
+    memset (&action, 0, sizeof (action));
+    action.sa_handler = handle_stop;
+    sigemptyset (&action.sa_mask);
+    sigaction (SIGTERM, &action, NULL);
+    sigaction (SIGINT, &action, NULL);
+    action.sa_handler = handle_child;
+    sigaction (SIGCHLD, &action, NULL);
+    signal (SIGPIPE, SIG_IGN);
+    sigemptyset (&block_mask);
+    sigaddset (&block_mask, SIGCHLD);
+    sigaddset (&block_mask, SIGTERM);
+    sigaddset (&block_mask, SIGINT);
+    sigprocmask (SIG_BLOCK, &block_mask, &orig_mask);
+    for (i = 0; i < WORKER_HTTP_CLIENTS; i++)
+    {
+        clients[i].fd = -1;
+        clients[i].response = NULL;
+    }
+
+    listen_fd = socket (AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listen_fd < 0)
+    {
+        sprintf (errmsg, "Creating the socket");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    memset (&addr, 0, sizeof (addr));
+    addr.sun_family = AF_UNIX;
+    strcpy (addr.sun_path, socket_file);
+    if (lstat (socket_file, &file_stat) == 0)
+    {
+        if (!S_ISSOCK (file_stat.st_mode))
+        {
+            sprintf (errmsg, "%s exists and isn't a socket", socket_file);
+            error_handler (true, FUNC_NAME, errmsg);
+            close (listen_fd);
+            return (ERROR);
+        }
+        unlink (socket_file);
+    }
+
+    /* Only the worker's user may connect */
+    orig_umask = umask (S_IRWXG | S_IRWXO);
+    status = bind (listen_fd, (struct sockaddr *) &addr, sizeof (addr));
+    umask (orig_umask);
+    if (status != 0 || chmod (socket_file, S_IRUSR | S_IWUSR) != 0 ||
+        listen (listen_fd, WORKER_BACKLOG) != 0)
+    {
+        sprintf (errmsg, "Listening on %s: %s", socket_file,
+            strerror (errno));
+        error_handler (true, FUNC_NAME, errmsg);
+        close (listen_fd);
+        return (ERROR);
+    }
+    printf ("Listening on %s for up to %d jobs at a time\n", socket_file,
+        njobs);
+
+    while (!stop_requested)
+    {
+        /* Reap the finished jobs */
+        while (nrunning > 0)
+        {
+            pid = waitpid (-1, NULL, WNOHANG);
+            if (pid < 0 && errno == ECHILD)
+                nrunning = 0;
+            if (pid <= 0)
+                break;
+            nrunning--;
+        }
+
+        /* Start the queued jobs in the free slots */
+        while (nqueued > 0 && nrunning < njobs)
+        {
+            fd = queue[0];
+            nqueued--;
+            memmove (queue, queue + 1, nqueued * sizeof (int));
+            nclose = nqueued;
+            queue[nclose++] = listen_fd;
+            queue[nclose++] = metrics_fd;
+            for (i = 0; i < WORKER_HTTP_CLIENTS; i++)
+            {
+                if (clients[i].fd >= 0)
+                    queue[nclose++] = clients[i].fd;
+            }
+            njob++;
+            if (start_job (fd, njob, queue, nclose, &orig_mask) == SUCCESS)
+                nrunning++;
+        }
+        espa_metrics_set_queue (nrunning, nqueued, njobs);
+
+        /* Wait for a job, a scrape of the metrics, the metrics clients, or
+           a signal, but no later than the next deadline of a client */
+        timed = expire_metrics_clients (clients, &wait);
+        nfds = 0;
+        if (nqueued < WORKER_BACKLOG)
+        {
+            fds[nfds].fd = listen_fd;
+            fds[nfds++].events = POLLIN;
+        }
+        free_client = -1;
+        for (i = 0; i < WORKER_HTTP_CLIENTS; i++)
+        {
+            client_index[i] = -1;
+            if (clients[i].fd < 0)
+            {
+                free_client = i;
+                continue;
+            }
+            client_index[i] = nfds;
+            fds[nfds].fd = clients[i].fd;
+            fds[nfds++].events =
+                clients[i].response == NULL ? POLLIN : POLLOUT;
+        }
+        metrics_index = -1;
+        if (metrics_fd >= 0 && free_client >= 0)
+        {
+            metrics_index = nfds;
+            fds[nfds].fd = metrics_fd;
+            fds[nfds++].events = POLLIN;
+        }
+        if (ppoll (fds, nfds, timed ? &wait : NULL, &orig_mask) <= 0)
+            continue;
+
+        if (nqueued < WORKER_BACKLOG && (fds[0].revents & POLLIN))
+        {
+            fd = accept4 (listen_fd, NULL, NULL, SOCK_CLOEXEC);
+            peer_len = sizeof (peer);
+            peer.uid = (uid_t) -1;
+            if (fd >= 0 && (getsockopt (fd, SOL_SOCKET, SO_PEERCRED, &peer,
+                &peer_len) != 0 || peer.uid != geteuid ()))
+            {
+                sprintf (errmsg, "Refusing a job from user %ld",
+                    (long) peer.uid);
+                error_handler (false, FUNC_NAME, errmsg);
+                close (fd);
+            }
+            else if (fd >= 0)
+                queue[nqueued++] = fd;
+            else if (errno != EINTR && errno != ECONNABORTED &&
+                errno != EAGAIN)
+            {
+                sprintf (errmsg, "Accepting a job: %s", strerror (errno));
+                error_handler (true, FUNC_NAME, errmsg);
+            }
+        }
+        for (i = 0; i < WORKER_HTTP_CLIENTS; i++)
+        {
+            if (client_index[i] >= 0 && fds[client_index[i]].revents != 0)
+                serve_metrics_client (&clients[i]);
+        }
+        if (metrics_index >= 0 && (fds[metrics_index].revents & POLLIN))
+            accept_metrics_client (metrics_fd, &clients[free_client]);
+    }
+
+    /* Stop accepting jobs and let the running ones finish */
+    close (listen_fd);
+    unlink (socket_file);
+    while (nqueued > 0)
+        close (queue[--nqueued]);
+    for (i = 0; i < WORKER_HTTP_CLIENTS; i++)
+        close_metrics_client (&clients[i]);
+    printf ("Stopping; waiting for %d running jobs\n", nrunning);
+    while (nrunning > 0)
+    {
+        pid = waitpid (-1, NULL, 0);
+        if (pid < 0 && errno == EINTR)
+            continue;
+        if (pid < 0)
+            break;
+        nrunning--;
+    }
+    sigprocmask (SIG_SETMASK, &orig_mask, NULL);
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  main
+
+PURPOSE:  Starts a worker which runs the raw binary tools as jobs submitted
+over a Unix socket, or submits a job to one.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error starting the worker or submitting the job
+other           Exit status of a submitted job's tool
+SUCCESS         The worker was stopped
+
+NOTES:
+  1. A polygon file which can't be kept open is only a warning; the jobs
+     then open it themselves, as the tools do on their own.
+  2. The metrics are shared once the start-up work is done, so they only
+     count the work of the jobs.
+******************************************************************************/
+int main (int argc, char** argv)
+{
+    char FUNC_NAME[] = "main";   /* function name */
+    char errmsg[STR_SIZE];       /* error message */
+    char *socket_file = NULL;    /* socket the worker listens on */
+    char *polygon_file = NULL;   /* land mass polygon kept open */
+    char *metrics_addr = NULL;   /* [host:]port the metrics are served on */
+    char *env = NULL;            /* value of an environment variable */
+    int njobs;                   /* number of jobs run at a time */
+    int tool_index;              /* index of the tool of a submitted job */
+    int metrics_fd = -1;         /* socket the metrics are served on */
+    int status;                  /* return status */
+    unsigned int i;              /* looping variable for the tools */
+
+    njobs = sysconf (_SC_NPROCESSORS_ONLN);
+    if (njobs < 1)
+        njobs = 1;
+
+    /* Read the command-line arguments */
+    if (get_args (argc, argv, &socket_file, &njobs, &polygon_file,
+        &metrics_addr, &tool_index) != SUCCESS)
+    {   /* get_args already printed the error message */
+        exit (EXIT_FAILURE);
+    }
+
+    /* Submit a job to a running worker */
+    if (tool_index > 0)
+    {
+        status = submit_job (socket_file, argc - tool_index,
+            &argv[tool_index]);
+        free (socket_file);
+        exit (status == ERROR ? EXIT_FAILURE : status);
+    }
+
+    printf ("espa_formatter_worker version: %s\n", ESPA_COMMON_VERSION);
+
+    /* Do the start-up work of the tools once, for all the jobs */
+    xmlInitParser ();
+    if (get_espa_schema () == NULL)
+    {  /* Error messages already written */
+        exit (EXIT_FAILURE);
+    }
+    if (polygon_file == NULL)
+    {
+        env = getenv ("ESPA_LAND_MASS_POLYGON");
+        if (env != NULL && *env != '\0')
+            polygon_file = strdup (env);
+    }
+    if (polygon_file != NULL &&
+        ias_geo_keep_polygon_store (polygon_file) != SUCCESS)
+    {
+        sprintf (errmsg, "Unable to keep %s open; each job will open it",
+            polygon_file);
+        error_handler (false, FUNC_NAME, errmsg);
+    }
+
+    /* Serve the metrics of the jobs */
+    if (metrics_addr != NULL)
+    {
+        for (i = 0; i < WORKER_NTOOLS; i++)
+            worker_tool_names[i] = worker_tools[i].name;
+        metrics_fd = open_metrics_socket (metrics_addr);
+        if (metrics_fd == ERROR ||
+            espa_metrics_share (WORKER_NTOOLS) != SUCCESS)
+        {  /* Error messages already written */
+            exit (EXIT_FAILURE);
+        }
+        printf ("Serving the metrics on %s\n", metrics_addr);
+    }
+
+    if (serve_jobs (socket_file, njobs, metrics_fd) != SUCCESS)
+    {  /* Error messages already written */
+        exit (EXIT_FAILURE);
+    }
+
+    /* Free the pointers */
+    if (metrics_fd >= 0)
+        close (metrics_fd);
+    free (socket_file);
+    free (polygon_file);
+    free (metrics_addr);
+
+    /* Successful completion */
+    exit (EXIT_SUCCESS);
+}
@@ -0,0 +1,940 @@
+/*****************************************************************************
+FILE: espa_meta_query
+
+PURPOSE: Contains functions for querying fields of many ESPA XML metadata
+files at once, writing the results as CSV or JSON.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The XML files are loaded by a pool of threads with the lazy metadata
+     loader, so only the bands named in the fields are decoded.
+  2. The rows are written in the order the XML files were specified.
+*****************************************************************************/
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE     /* for open_memstream and getline */
+#endif
+#include <getopt.h>
+#include <stddef.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "lazy_metadata.h"
+
+/* Maximum number of fields in a query */
+#define MAX_QUERY_FIELDS 100
+
+/* Types of the metadata fields which can be queried */
+typedef enum
+{
+    FIELD_STRING, FIELD_INT, FIELD_LONG, FIELD_FLOAT, FIELD_DOUBLE,
+    FIELD_DATA_TYPE, FIELD_RESAMPLE
+} Field_type_t;
+
+/* Metadata field which can be queried */
+typedef struct
+{
+    const char *name;         /* name of the field in the query */
+    Field_type_t type;        /* type of the field */
+    size_t offset;            /* offset of the field in its structure */
+    int count;                /* number of values in the field */
+} Meta_field_t;
+
+#define GLOBAL_FIELD(name, type, count) \
+    {#name, type, offsetof (Espa_global_meta_t, name), count}
+#define BAND_FIELD(name, type, count) \
+    {#name, type, offsetof (Espa_band_meta_t, name), count}
+
+static const Meta_field_t global_fields[] =
+{
+    GLOBAL_FIELD (data_provider, FIELD_STRING, 1),
+    GLOBAL_FIELD (satellite, FIELD_STRING, 1),
+    GLOBAL_FIELD (instrument, FIELD_STRING, 1),
+    GLOBAL_FIELD (acquisition_date, FIELD_STRING, 1),
+    GLOBAL_FIELD (ul_corner, FIELD_DOUBLE, 2),
+    GLOBAL_FIELD (lr_corner, FIELD_DOUBLE, 2),
+    GLOBAL_FIELD (bounding_coords, FIELD_DOUBLE, 4),
+    GLOBAL_FIELD (footprint, FIELD_STRING, 1),
+    GLOBAL_FIELD (proj_info.proj_type, FIELD_INT, 1),
+    GLOBAL_FIELD (proj_info.datum_type, FIELD_INT, 1),
+    GLOBAL_FIELD (proj_info.units, FIELD_STRING, 1),
+    GLOBAL_FIELD (proj_info.ul_corner, FIELD_DOUBLE, 2),
+    GLOBAL_FIELD (proj_info.lr_corner, FIELD_DOUBLE, 2),
+    GLOBAL_FIELD (proj_info.grid_origin, FIELD_STRING, 1),
+    GLOBAL_FIELD (proj_info.utm_zone, FIELD_INT, 1),
+    GLOBAL_FIELD (wrs_system, FIELD_INT, 1),
+    GLOBAL_FIELD (wrs_path, FIELD_INT, 1),
+    GLOBAL_FIELD (wrs_row, FIELD_INT, 1),
+    GLOBAL_FIELD (scene_center_time, FIELD_STRING, 1),
+    GLOBAL_FIELD (product_id, FIELD_STRING, 1),
+    GLOBAL_FIELD (lpgs_metadata_file, FIELD_STRING, 1),
+    GLOBAL_FIELD (orientation_angle, FIELD_FLOAT, 1),
+    GLOBAL_FIELD (solar_zenith, FIELD_FLOAT, 1),
+    GLOBAL_FIELD (solar_azimuth, FIELD_FLOAT, 1),
+    GLOBAL_FIELD (solar_units, FIELD_STRING, 1),
+    GLOBAL_FIELD (earth_sun_dist, FIELD_FLOAT, 1),
+    GLOBAL_FIELD (level1_production_date, FIELD_STRING, 1),
+    GLOBAL_FIELD (htile, FIELD_INT, 1),
+    GLOBAL_FIELD (vtile, FIELD_INT, 1),
+    GLOBAL_FIELD (view_zenith, FIELD_FLOAT, 1),
+    GLOBAL_FIELD (view_azimuth, FIELD_FLOAT, 1),
+    GLOBAL_FIELD (view_units, FIELD_STRING, 1),
+};
+
+static const Meta_field_t band_fields[] =
+{
+    BAND_FIELD (product, FIELD_STRING, 1),
+    BAND_FIELD (source, FIELD_STRING, 1),
+    BAND_FIELD (name, FIELD_STRING, 1),
+    BAND_FIELD (category, FIELD_STRING, 1),
+    BAND_FIELD (data_type, FIELD_DATA_TYPE, 1),
+    BAND_FIELD (nlines, FIELD_INT, 1),
+    BAND_FIELD (nsamps, FIELD_INT, 1),
+    BAND_FIELD (fill_value, FIELD_LONG, 1),
+    BAND_FIELD (saturate_value, FIELD_INT, 1),
+    BAND_FIELD (scale_factor, FIELD_FLOAT, 1),
+    BAND_FIELD (add_offset, FIELD_FLOAT, 1),
+    BAND_FIELD (constant_value, FIELD_DOUBLE, 1),
+    BAND_FIELD (footprint_file, FIELD_STRING, 1),
+    BAND_FIELD (overview_file, FIELD_STRING, 1),
+    BAND_FIELD (overview_levels, FIELD_INT, 1),
+    BAND_FIELD (encoding, FIELD_STRING, 1),
+    BAND_FIELD (tile_size, FIELD_INT, 1),
+    BAND_FIELD (file_offset, FIELD_LONG, 1),
+    BAND_FIELD (checksum, FIELD_STRING, 1),
+    BAND_FIELD (resample_method, FIELD_RESAMPLE, 1),
+    BAND_FIELD (short_name, FIELD_STRING, 1),
+    BAND_FIELD (long_name, FIELD_STRING, 1),
+    BAND_FIELD (file_name, FIELD_STRING, 1),
+    BAND_FIELD (pixel_size, FIELD_DOUBLE, 2),
+    BAND_FIELD (pixel_units, FIELD_STRING, 1),
+    BAND_FIELD (data_units, FIELD_STRING, 1),
+    BAND_FIELD (valid_range, FIELD_DOUBLE, 2),
+    BAND_FIELD (stats.valid_count, FIELD_LONG, 1),
+    BAND_FIELD (stats.min, FIELD_DOUBLE, 1),
+    BAND_FIELD (stats.max, FIELD_DOUBLE, 1),
+    BAND_FIELD (stats.mean, FIELD_DOUBLE, 1),
+    BAND_FIELD (stats.stddev, FIELD_DOUBLE, 1),
+    BAND_FIELD (rad_gain, FIELD_DOUBLE, 1),
+    BAND_FIELD (rad_bias, FIELD_DOUBLE, 1),
+    BAND_FIELD (refl_gain, FIELD_DOUBLE, 1),
+    BAND_FIELD (refl_bias, FIELD_DOUBLE, 1),
+    BAND_FIELD (k1_const, FIELD_DOUBLE, 1),
+    BAND_FIELD (k2_const, FIELD_DOUBLE, 1),
+    BAND_FIELD (qa_desc, FIELD_STRING, 1),
+    BAND_FIELD (app_version, FIELD_STRING, 1),
+    BAND_FIELD (l1_filename, FIELD_STRING, 1),
+    BAND_FIELD (production_date, FIELD_STRING, 1),
+};
+
+/* Field of a query, as parsed from the command line */
+typedef struct
+{
+    char *spec;               /* field as specified on the command line */
+    const Meta_field_t *field;  /* metadata field; NULL for nbands */
+    bool is_band;             /* is this a band field? */
+    char band_name[STR_SIZE]; /* name of the band, for band fields */
+} Query_field_t;
+
+/* Query shared by the threads */
+typedef struct
+{
+    char **xml_files;         /* XML files to be queried */
+    int nfiles;               /* number of XML files */
+    Query_field_t fields[MAX_QUERY_FIELDS];  /* fields to be queried */
+    int nfields;              /* number of fields */
+    bool json;                /* write JSON rather than CSV? */
+    bool validate;            /* validate the XML files? */
+    char **rows;              /* formatted output row for each XML file */
+    int next_file;            /* next XML file to be queried */
+} Query_t;
+
+
+/******************************************************************************
+MODULE: usage
+
+PURPOSE: Prints the usage information for this application.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+void usage ()
+{
+    int i;                    /* looping variable */
+
+    printf ("espa_meta_query writes the specified fields of many ESPA XML "
+            "metadata files as CSV or JSON, loading the files in "
+            "parallel.\n");
+    printf ("version: %s\n\n", ESPA_COMMON_VERSION);
+    printf ("usage: espa_meta_query "
+            "[--xml=input_metadata_filename (multiple --xml options can be "
+            "specified)] [--xml_list=file_of_input_metadata_filenames] "
+            "--field=field_name (multiple --field options can be specified) "
+            "--output=output_filename [--format=csv|json] "
+            "[--threads=number_of_threads] [--validate]\n");
+
+    printf ("\nwhere the following parameters are required:\n");
+    printf ("    -xml or -xml_list: name of an input XML metadata file, or of "
+            "a file listing one input XML metadata file per line (- for "
+            "stdin)\n");
+    printf ("    -field: field to be written for each XML file; one of "
+            "nbands, global.<name> (or just <name>), or "
+            "band[<band name>].<name>\n");
+    printf ("    -output: name of the output CSV or JSON file (- for "
+            "stdout)\n");
+
+    printf ("\nwhere the following parameters are optional:\n");
+    printf ("    -format: csv (default) or json\n");
+    printf ("    -threads: number of threads loading the XML files "
+            "(default is the number of processors)\n");
+    printf ("    -validate: validate each XML file against the ESPA schema\n");
+
+    printf ("\nglobal fields:");
+    for (i = 0; i < sizeof (global_fields) / sizeof (global_fields[0]); i++)
+        printf (" %s", global_fields[i].name);
+    printf ("\nband fields:");
+    for (i = 0; i < sizeof (band_fields) / sizeof (band_fields[0]); i++)
+        printf (" %s", band_fields[i].name);
+    printf ("\n");
+
+    printf ("\nExample: espa_meta_query --xml_list=scenes.txt "
+            "--field=global.acquisition_date --field=bounding_coords "
+            "--field=band[sr_band4].valid_range --output=scenes.csv\n");
+}
+
+
+/******************************************************************************
+MODULE:  find_meta_field
+
+PURPOSE:  Finds a metadata field by name in a field table.
+
+RETURN VALUE:
+Type = const Meta_field_t *
+Value           Description
+-----           -----------
+NULL            No such field
+non-NULL        The field
+
+NOTES:
+******************************************************************************/
+static const Meta_field_t *find_meta_field
+(
+    const Meta_field_t *fields,  /* I: field table */
+    int nfields,                 /* I: number of fields in the table */
+    const char *name             /* I: name of the field */
+)
+{
+    int i;                    /* looping variable */
+
+    for (i = 0; i < nfields; i++)
+    {
+        if (!strcmp (fields[i].name, name))
+            return (&fields[i]);
+    }
+
+    return (NULL);
+}
+
+
+/******************************************************************************
+MODULE:  parse_field_spec
+
+PURPOSE:  Parses a field of the query from its command-line specification.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           The field isn't recognized
+SUCCESS         Successfully parsed the field
+
+NOTES:
+******************************************************************************/
+static int parse_field_spec
+(
+    char *spec,               /* I: field as specified on the command line */
+    Query_field_t *qfield     /* O: parsed field */
+)
+{
+    char FUNC_NAME[] = "parse_field_spec";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    char *name = spec;        /* name of the field within its structure */
+    char *close = NULL;       /* closing bracket of the band name */
+
+    memset (qfield, 0, sizeof (*qfield));
+    qfield->spec = spec;
+    if (!strcmp (spec, "nbands"))
+        return (SUCCESS);
+
+    if (!strncmp (spec, "band[", 5))
+    {
+        close = strchr (spec, ']');
+        if (close == NULL || close == spec + 5 || close[1] != '.' ||
+            close - (spec + 5) >= STR_SIZE)
+        {
+            sprintf (errmsg, "Band field %s is not band[<band name>].<name>",
+                spec);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+        qfield->is_band = true;
+        sprintf (qfield->band_name, "%.*s", (int) (close - (spec + 5)),
+            spec + 5);
+        qfield->field = find_meta_field (band_fields,
+            sizeof (band_fields) / sizeof (band_fields[0]), close + 2);
+    }
+    else
+    {
+        if (!strncmp (spec, "global.", 7))
+            name = spec + 7;
+        qfield->field = find_meta_field (global_fields,
+            sizeof (global_fields) / sizeof (global_fields[0]), name);
+    }
+
+    if (qfield->field == NULL)
+    {
+        sprintf (errmsg, "Unknown field %s", spec);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  add_xml_file
+
+PURPOSE:  Adds an XML file to the list of XML files to be queried.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error allocating memory for the list
+SUCCESS         Successfully added the XML file
+
+NOTES:
+******************************************************************************/
+static int add_xml_file
+(
+    Query_t *query,           /* I/O: query whose list is added to */
+    int *nalloc,              /* I/O: number of files allocated in the list */
+    const char *xml_file      /* I: XML file to be added */
+)
+{
+    char FUNC_NAME[] = "add_xml_file";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    char **files = NULL;      /* reallocated list */
+
+    if (query->nfiles == *nalloc)
+    {
+        *nalloc = *nalloc ? *nalloc * 2 : 1024;
+        files = realloc (query->xml_files, *nalloc * sizeof (char *));
+        if (files == NULL)
+        {
+            sprintf (errmsg, "Allocating memory for the XML file list");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+        query->xml_files = files;
+    }
+
+    query->xml_files[query->nfiles] = strdup (xml_file);
+    if (query->xml_files[query->nfiles] == NULL)
+    {
+        sprintf (errmsg, "Allocating memory for the XML file list");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    query->nfiles++;
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  read_xml_list
+
+PURPOSE:  Adds the XML files listed in a file, one per line, to the list of
+XML files to be queried.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error reading the list
+SUCCESS         Successfully read the list
+
+NOTES:
+  1. Blank lines are skipped.
+******************************************************************************/
+static int read_xml_list
+(
+    Query_t *query,           /* I/O: query whose list is added to */
+    int *nalloc,              /* I/O: number of files allocated in the list */
+    const char *list_file     /* I: file listing the XML files; - for stdin */
+)
+{
+    char FUNC_NAME[] = "read_xml_list";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    char *line = NULL;        /* current line of the list */
+    size_t line_size = 0;     /* size of the line buffer */
+    ssize_t len;              /* length of the current line */
+    int status = SUCCESS;     /* return status */
+    FILE *fptr = NULL;        /* list file */
+
+    fptr = strcmp (list_file, "-") ? fopen (list_file, "r") : stdin;
+    if (fptr == NULL)
+    {
+        sprintf (errmsg, "Opening %s for read access.", list_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    while (status == SUCCESS && (len = getline (&line, &line_size, fptr)) > 0)
+    {
+        while (len > 0 && (line[len-1] == '\n' || line[len-1] == '\r'))
+            line[--len] = '\0';
+        if (len > 0)
+            status = add_xml_file (query, nalloc, line);
+    }
+
+    free (line);
+    if (fptr != stdin)
+        fclose (fptr);
+
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  get_args
+
+PURPOSE:  Gets the command-line arguments and validates that the required
+arguments were specified.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error getting the command-line arguments or a command-line
+                argument and associated value were not specified
+SUCCESS         No errors encountered
+
+NOTES:
+  1. Memory is allocated for the output file and the list of XML files.  The
+     caller is responsible for freeing the allocated memory upon successful
+     return.
+******************************************************************************/
+short get_args
+(
+    int argc,             /* I: number of cmd-line args */
+    char *argv[],         /* I: string of cmd-line args */
+    Query_t *query,       /* O: query to be run */
+    char **outfile,       /* O: address of the output filename */
+    int *nthreads         /* O: number of threads */
+)
+{
+    int c;                           /* current argument index */
+    int option_index;                /* index for the command-line option */
+    int nalloc = 0;                  /* number of XML files allocated */
+    char errmsg[STR_SIZE];           /* error message */
+    char FUNC_NAME[] = "get_args";   /* function name */
+    static struct option long_options[] =
+    {
+        {"xml", required_argument, 0, 'i'},
+        {"xml_list", required_argument, 0, 'l'},
+        {"field", required_argument, 0, 'f'},
+        {"output", required_argument, 0, 'o'},
+        {"format", required_argument, 0, 'm'},
+        {"threads", required_argument, 0, 't'},
+        {"validate", no_argument, 0, 'v'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    /* Loop through all the cmd-line options */
+    *nthreads = sysconf (_SC_NPROCESSORS_ONLN);
+    opterr = 0;   /* turn off getopt_long error msgs as we'll print our own */
+    while (1)
+    {
+        /* optstring in call to getopt_long is empty since we will only
+           support the long options */
+        c = getopt_long (argc, argv, "", long_options, &option_index);
+        if (c == -1)
+        {   /* Out of cmd-line options */
+            break;
+        }
+
+        switch (c)
+        {
+            case 0:
+                /* If this option set a flag, do nothing else now. */
+                if (long_options[option_index].flag != 0)
+                    break;
+
+            case 'h':  /* help */
+                usage ();
+                return (ERROR);
+                break;
+
+            case 'i':  /* XML infile */
+                if (add_xml_file (query, &nalloc, optarg) != SUCCESS)
+                    return (ERROR);
+                break;
+
+            case 'l':  /* list of XML infiles */
+                if (read_xml_list (query, &nalloc, optarg) != SUCCESS)
+                    return (ERROR);
+                break;
+
+            case 'f':  /* field to be queried */
+                if (query->nfields == MAX_QUERY_FIELDS)
+                {
+                    sprintf (errmsg, "Maximum number of fields (%d) has been "
+                        "reached.", MAX_QUERY_FIELDS);
+                    error_handler (true, FUNC_NAME, errmsg);
+                    return (ERROR);
+                }
+                if (parse_field_spec (optarg,
+                    &query->fields[query->nfields]) != SUCCESS)
+                {
+                    usage ();
+                    return (ERROR);
+                }
+                query->nfields++;
+                break;
+
+            case 'o':  /* output file */
+                *outfile = strdup (optarg);
+                break;
+
+            case 'm':  /* output format */
+                if (!strcmp (optarg, "json"))
+                    query->json = true;
+                else if (!strcmp (optarg, "csv"))
+                    query->json = false;
+                else
+                {
+                    sprintf (errmsg, "Unknown format %s; use csv or json",
+                        optarg);
+                    error_handler (true, FUNC_NAME, errmsg);
+                    return (ERROR);
+                }
+                break;
+
+            case 't':  /* number of threads */
+                *nthreads = atoi (optarg);
+                break;
+
+            case 'v':  /* validate the XML files */
+                query->validate = true;
+                break;
+
+            case '?':
+            default:
+                sprintf (errmsg, "Unknown option %s", argv[optind-1]);
+                error_handler (true, FUNC_NAME, errmsg);
+                usage ();
+                return (ERROR);
+                break;
+        }
+    }
+
+    /* Make sure the infiles, fields, and outfile were specified */
+    if (query->nfiles == 0)
+    {
+        sprintf (errmsg, "At least one XML input file is required");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    if (query->nfields == 0)
+    {
+        sprintf (errmsg, "At least one field is required");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    if (*outfile == NULL)
+    {
+        sprintf (errmsg, "Output file is a required argument");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    if (*nthreads < 1)
+        *nthreads = 1;
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  write_string
+
+PURPOSE:  Writes a string value, quoted as needed for the output format.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. CSV values are only quoted if they contain a comma, quote, or line
+     break.
+******************************************************************************/
+static void write_string
+(
+    FILE *out,                /* I: output stream */
+    bool json,                /* I: write JSON rather than CSV? */
+    const char *str           /* I: string to be written */
+)
+{
+    const char *ptr;          /* current character of the string */
+
+    if (json)
+    {
+        fputc ('"', out);
+        for (ptr = str; *ptr; ptr++)
+        {
+            if (*ptr == '"' || *ptr == '\\')
+                fprintf (out, "\\%c", *ptr);
+            else if ((unsigned char) *ptr < 0x20)
+                fprintf (out, "\\u%04x", (unsigned char) *ptr);
+            else
+                fputc (*ptr, out);
+        }
+        fputc ('"', out);
+    }
+    else if (strpbrk (str, ",\"\r\n") != NULL)
+    {
+        fputc ('"', out);
+        for (ptr = str; *ptr; ptr++)
+        {
+            if (*ptr == '"')
+                fputc ('"', out);
+            fputc (*ptr, out);
+        }
+        fputc ('"', out);
+    }
+    else
+        fputs (str, out);
+}
+
+
+/******************************************************************************
+MODULE:  write_field_value
+
+PURPOSE:  Writes the value of a metadata field.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. Fields with more than one value are written as a JSON array, or as
+     space-separated values in a single CSV column.
+******************************************************************************/
+static void write_field_value
+(
+    FILE *out,                /* I: output stream */
+    bool json,                /* I: write JSON rather than CSV? */
+    const Meta_field_t *field,  /* I: field to be written */
+    const void *base          /* I: structure holding the field */
+)
+{
+    static const char *data_types[] = {"INT8", "UINT8", "INT16", "UINT16",
+        "INT32", "UINT32", "FLOAT32", "FLOAT64"};
+    static const char *resample_types[] = {"cubic convolution",
+        "nearest neighbor", "bilinear", "none"};
+    const char *ptr = (const char *) base + field->offset;  /* the field */
+    int value;                /* enumerated value */
+    int i;                    /* looping variable */
+
+    if (field->count > 1)
+        fputs (json ? "[" : "", out);
+    for (i = 0; i < field->count; i++)
+    {
+        if (i > 0)
+            fputs (json ? ", " : " ", out);
+        switch (field->type)
+        {
+            case FIELD_STRING:
+                write_string (out, json, ptr);
+                break;
+            case FIELD_INT:
+                fprintf (out, "%d", ((const int *) ptr)[i]);
+                break;
+            case FIELD_LONG:
+                fprintf (out, "%ld", ((const long *) ptr)[i]);
+                break;
+            case FIELD_FLOAT:
+                fprintf (out, "%.7g", ((const float *) ptr)[i]);
+                break;
+            case FIELD_DOUBLE:
+                fprintf (out, "%.15g", ((const double *) ptr)[i]);
+                break;
+            case FIELD_DATA_TYPE:
+                value = *(const enum Espa_data_type *) ptr;
+                write_string (out, json, value >= 0 && value <= ESPA_FLOAT64 ?
+                    data_types[value] : ESPA_STRING_META_FILL);
+                break;
+            case FIELD_RESAMPLE:
+                value = *(const enum Espa_resampling_type *) ptr;
+                write_string (out, json, value >= 0 && value <= ESPA_NONE ?
+                    resample_types[value] : ESPA_STRING_META_FILL);
+                break;
+        }
+    }
+    if (field->count > 1)
+        fputs (json ? "]" : "", out);
+}
+
+
+/******************************************************************************
+MODULE:  query_xml_file
+
+PURPOSE:  Loads an XML file and formats its output row.
+
+RETURN VALUE:
+Type = char *
+Value           Description
+-----           -----------
+NULL            Error allocating memory for the row
+non-NULL        Formatted row, to be freed by the caller
+
+NOTES:
+  1. Fields of an XML file which can't be loaded, and of bands which aren't
+     in the XML file, are written as empty CSV columns or JSON nulls.
+******************************************************************************/
+static char *query_xml_file
+(
+    Query_t *query,           /* I: query to be run */
+    int ifile                 /* I: index of the XML file to be queried */
+)
+{
+    char *row = NULL;         /* formatted row */
+    size_t row_len = 0;       /* length of the formatted row */
+    int i;                    /* looping variable */
+    int band_index;           /* index of the band of a band field */
+    const void *base = NULL;  /* structure holding the current field */
+    Query_field_t *qfield = NULL;  /* current field */
+    Espa_lazy_meta_t *lazy = NULL;  /* metadata of the XML file */
+    FILE *out = NULL;         /* stream formatting the row */
+
+    out = open_memstream (&row, &row_len);
+    if (out == NULL)
+        return (NULL);
+
+    lazy = open_lazy_metadata (query->xml_files[ifile], query->validate);
+
+    if (query->json)
+    {
+        fputs ("  {", out);
+        write_string (out, true, "file");
+        fputs (": ", out);
+    }
+    write_string (out, query->json, query->xml_files[ifile]);
+
+    for (i = 0; i < query->nfields; i++)
+    {
+        qfield = &query->fields[i];
+        if (query->json)
+        {
+            fputs (", ", out);
+            write_string (out, true, qfield->spec);
+            fputs (": ", out);
+        }
+        else
+            fputc (',', out);
+
+        /* Find the structure holding the field */
+        base = NULL;
+        if (lazy != NULL && qfield->is_band)
+        {
+            band_index = find_lazy_band (lazy, qfield->band_name, NULL);
+            if (band_index >= 0)
+                base = get_lazy_band (lazy, band_index);
+        }
+        else if (lazy != NULL)
+            base = &lazy->meta.global;
+
+        if (base == NULL)
+            fputs (query->json ? "null" : "", out);
+        else if (qfield->field == NULL)
+            fprintf (out, "%d", lazy->meta.nbands);
+        else
+            write_field_value (out, query->json, qfield->field, base);
+    }
+    fputs (query->json ? "}" : "\n", out);
+
+    close_lazy_metadata (lazy);
+    if (fclose (out) != 0)
+    {
+        free (row);
+        return (NULL);
+    }
+
+    return (row);
+}
+
+
+/******************************************************************************
+MODULE:  query_thread
+
+PURPOSE:  Queries XML files until none are left.
+
+RETURN VALUE:
+Type = void *
+Value           Description
+-----           -----------
+NULL            Always
+
+NOTES:
+  1. The XML files are handed out one at a time, so a slow file doesn't hold
+     up the others.
+******************************************************************************/
+static void *query_thread
+(
+    void *arg                 /* I: query to be run */
+)
+{
+    Query_t *query = arg;     /* query to be run */
+    int ifile;                /* index of the next XML file */
+
+    while ((ifile = __atomic_fetch_add (&query->next_file, 1,
+        __ATOMIC_RELAXED)) < query->nfiles)
+        query->rows[ifile] = query_xml_file (query, ifile);
+
+    return (NULL);
+}
+
+
+/******************************************************************************
+MODULE:  main
+
+PURPOSE:  Writes the specified fields of the XML metadata files as CSV or
+JSON.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error running the query
+SUCCESS         No errors encountered
+
+NOTES:
+  1. Errors loading individual XML files are reported, and their fields are
+     left empty; they don't stop the query.
+******************************************************************************/
+int main (int argc, char** argv)
+{
+    char FUNC_NAME[] = "main";   /* function name */
+    char errmsg[STR_SIZE];       /* error message */
+    char *outfile = NULL;        /* output filename */
+    int nthreads;                /* number of threads */
+    int i;                       /* looping variable */
+    int nrows = 0;               /* number of rows written */
+    int status = SUCCESS;        /* return status */
+    pthread_t *threads = NULL;   /* query threads */
+    Query_t query;               /* query to be run */
+    FILE *out = NULL;            /* output file */
+
+    /* Read the command-line arguments */
+    memset (&query, 0, sizeof (query));
+    if (get_args (argc, argv, &query, &outfile, &nthreads) != SUCCESS)
+    {   /* get_args already printed the error message */
+        exit (EXIT_FAILURE);
+    }
+    if (nthreads > query.nfiles)
+        nthreads = query.nfiles;
+
+    query.rows = calloc (query.nfiles, sizeof (char *));
+    threads = calloc (nthreads, sizeof (pthread_t));
+    if (query.rows == NULL || threads == NULL)
+    {
+        sprintf (errmsg, "Allocating memory for the query");
+        error_handler (true, FUNC_NAME, errmsg);
+        exit (EXIT_FAILURE);
+    }
+
+    /* Load the XML files in parallel */
+    init_espa_xml ();
+    for (i = 0; i < nthreads; i++)
+    {
+        if (pthread_create (&threads[i], NULL, query_thread, &query) != 0)
+        {
+            sprintf (errmsg, "Creating query thread %d", i);
+            error_handler (true, FUNC_NAME, errmsg);
+            nthreads = i;
+            status = ERROR;
+            break;
+        }
+    }
+    if (nthreads == 0)
+        query_thread (&query);
+    for (i = 0; i < nthreads; i++)
+        pthread_join (threads[i], NULL);
+    shutdown_espa_xml ();
+
+    /* Write the rows in the order of the XML files */
+    out = strcmp (outfile, "-") ? fopen (outfile, "w") : stdout;
+    if (out == NULL)
+    {
+        sprintf (errmsg, "Opening %s for write access.", outfile);
+        error_handler (true, FUNC_NAME, errmsg);
+        exit (EXIT_FAILURE);
+    }
+    if (query.json)
+        fputs ("[\n", out);
+    else
+    {
+        write_string (out, false, "file");
+        for (i = 0; i < query.nfields; i++)
+        {
+            fputc (',', out);
+            write_string (out, false, query.fields[i].spec);
+        }
+        fputc ('\n', out);
+    }
+    for (i = 0; i < query.nfiles; i++)
+    {
+        if (query.rows[i] == NULL)
+        {
+            sprintf (errmsg, "Formatting the row for %s", query.xml_files[i]);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+            continue;
+        }
+        if (query.json && nrows > 0)
+            fputs (",\n", out);
+        fputs (query.rows[i], out);
+        nrows++;
+        free (query.rows[i]);
+    }
+    if (query.json)
+        fputs ("\n]\n", out);
+    if (out != stdout ? fclose (out) != 0 : fflush (out) != 0)
+    {
+        sprintf (errmsg, "Writing %s", outfile);
+        error_handler (true, FUNC_NAME, errmsg);
+        status = ERROR;
+    }
+
+    /* Free the pointers */
+    for (i = 0; i < query.nfiles; i++)
+        free (query.xml_files[i]);
+    free (query.xml_files);
+    free (query.rows);
+    free (threads);
+    free (outfile);
+
+    /* Successful completion */
+    exit (status == SUCCESS ? EXIT_SUCCESS : EXIT_FAILURE);
+}
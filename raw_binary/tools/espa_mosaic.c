@@ -0,0 +1,580 @@
+/*****************************************************************************
+FILE: espa_mosaic
+
+PURPOSE: Contains functions for mosaicking ESPA products onto one grid (ex.
+an ARD tile), writing the composited bands along with the XML file of the
+mosaic.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The XML metadata format parsed or written via this library follows the
+     ESPA internal metadata format found in ESPA Raw Binary Format v1.0.doc.
+     The schema for the ESPA internal metadata format is available at
+     http://espa.cr.usgs.gov/schema/espa_internal_metadata_v1_0.xsd.
+*****************************************************************************/
+#include <getopt.h>
+#include "espa_warp.h"
+#include "espa_task_pool.h"
+
+/* USGS ARD grids: Albers Equal Area on WGS84 at 30 meters, in tiles of 5000
+   by 5000 pixels counted right and down from the UL edge of tile h0v0 */
+#define ARD_PIXEL_SIZE 30.0
+#define ARD_TILE_SIZE 150000.0
+#define ARD_CONUS_ULX -2565585.0
+#define ARD_CONUS_ULY 3314805.0
+#define ARD_ALASKA_ULX -851715.0
+#define ARD_ALASKA_ULY 2474325.0
+
+/******************************************************************************
+MODULE: usage
+
+PURPOSE: Prints the usage information for this application.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+void usage ()
+{
+    printf ("espa_mosaic mosaics ESPA internal format products (raw binary "
+            "and associated XML metadata files) onto one grid, an ARD grid "
+            "or a custom one, and creates a new XML metadata file and raw "
+            "binary band files for the mosaic.  Only the windows of the "
+            "products which overlap the mosaic are read.\n");
+    printf ("version: %s\n\n", ESPA_COMMON_VERSION);
+    printf ("usage: espa_mosaic "
+            "--xml=input_metadata_filename (multiple --xml options can be "
+            "specified) "
+            "--mosaic_xml=output_mosaic_metadata_filename "
+            "[--rule=first|latest] "
+            "[--grid=ard_conus|ard_alaska [--tile=h,v]] "
+            "[--proj=geo|utm|ps|albers|sin] [projection parameters] "
+            "[--datum=wgs84|nad83|nad27] [--pixel_size=size] "
+            "[--resample=nn|bi|cc] [--max_error=pixels] "
+            "[--ulx=x --uly=y --lrx=x --lry=y] "
+            "[--threads=number_of_threads]\n");
+
+    printf ("\nwhere the following parameters are required:\n");
+    printf ("    -xml: name of an input XML metadata file which follows "
+            "the ESPA internal raw binary schema; XML files may also be "
+            "listed after the options.  Every product needs the bands of "
+            "the first one.\n");
+    printf ("    -mosaic_xml: name of the output XML metadata file.  The "
+            "output bands are named after it, <base>_<band name>.img\n");
+
+    printf ("\nand the following parameters are optional:\n");
+    printf ("    -rule: composite rule, where several products have a valid "
+            "pixel: the first product in the order given, or the latest "
+            "acquisition (default is first).  The first product by the "
+            "rule gives the bands and global metadata of the mosaic.\n");
+    printf ("    -grid: USGS ARD grid (Albers on WGS84 at 30 meters); the "
+            "extent covering the products is aligned to its pixels\n");
+    printf ("    -tile: horizontal and vertical index of the ARD tile to "
+            "mosaic, ex. 21,9 for h021v009\n");
+    printf ("    -proj: target projection (default is the projection of the "
+            "first product)\n");
+    printf ("    -zone: UTM zone, negative for the southern hemisphere "
+            "(utm)\n");
+    printf ("    -longitude_pole, -latitude_true_scale: longitude of the "
+            "pole and latitude of true scale in degrees (ps)\n");
+    printf ("    -standard_parallel1, -standard_parallel2, "
+            "-central_meridian, -origin_latitude: in degrees (albers)\n");
+    printf ("    -central_meridian, -sphere_radius: in degrees and meters "
+            "(sin)\n");
+    printf ("    -false_easting, -false_northing: in meters (ps, albers, "
+            "sin)\n");
+    printf ("    -datum: datum of the target projection (default is the "
+            "datum of the first product)\n");
+    printf ("    -pixel_size: pixel size of the reference band (band1 for "
+            "Landsat, B02 for Sentinel-2, otherwise the first band) in the "
+            "target units.  The other bands keep their ratio to it.  "
+            "Required between geographic and projected coordinates, "
+            "otherwise the default is the pixel size of the first "
+            "product.\n");
+    printf ("    -resample: resampling of all the bands: nearest neighbor, "
+            "bilinear, or cubic convolution (default is the resampling "
+            "method of each band, or nearest neighbor)\n");
+    printf ("    -max_error: largest error, in input pixels, of the "
+            "interpolated mapping to the inputs; 0 transforms every pixel "
+            "exactly (default is %g)\n", WARP_DEFAULT_MAX_ERROR);
+    printf ("    -ulx, -uly, -lrx, -lry: target projection coordinates of "
+            "the UL and LR edges of the output (default covers the "
+            "products)\n");
+    printf ("    -threads: number of threads warping the tiles (default is "
+            "the cap of the task pool)\n");
+    printf ("\nThe extent is widened as needed to whole pixels of the "
+            "coarsest band.\n");
+    printf ("\nExample: espa_mosaic --grid=ard_conus --tile=21,9 "
+            "--rule=latest --mosaic_xml=LC08_h021v009_mosaic.xml "
+            "LC08_L2SP_02203*_20210*.xml\n");
+}
+
+
+/******************************************************************************
+MODULE:  get_args
+
+PURPOSE:  Gets the command-line arguments and validates that the required
+arguments were specified.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error getting the command-line arguments or a command-line
+                argument and associated value were not specified
+SUCCESS         No errors encountered
+
+NOTES:
+  1. Memory is allocated for the input and output files.  The caller is
+     responsible for freeing the allocated memory upon successful return.
+  2. An ARD grid sets the projection, datum, and pixel size, and a tile of
+     it the extent, so they can't be given as well.
+******************************************************************************/
+short get_args
+(
+    int argc,             /* I: number of cmd-line args */
+    char *argv[],         /* I: string of cmd-line args */
+    char **xml_files,     /* O: names of the XML files; holds argc */
+    int *nfiles,          /* O: number of XML files */
+    char **xml_mosaic_outfile,  /* O: address of output mosaic XML
+                                      filename */
+    Espa_mosaic_options_t *options  /* O: options of the mosaic */
+)
+{
+    int c;                           /* current argument index */
+    int option_index;                /* index for the command-line option */
+    int nextent_opts = 0;            /* number of extent options */
+    int tile_h = -1;                 /* horizontal index of the ARD tile */
+    int tile_v = -1;                 /* vertical index of the ARD tile */
+    bool ard = false;                /* was an ARD grid given? */
+    char errmsg[STR_SIZE];           /* error message */
+    char FUNC_NAME[] = "get_args";   /* function name */
+    Espa_warp_options_t *grid = &options->grid;  /* grid of the mosaic */
+    Espa_proj_meta_t *proj = &grid->proj_info;   /* target projection */
+    static struct option long_options[] =
+    {
+        {"xml", required_argument, 0, 'i'},
+        {"mosaic_xml", required_argument, 0, 'o'},
+        {"rule", required_argument, 0, 'u'},
+        {"grid", required_argument, 0, 'g'},
+        {"tile", required_argument, 0, 't'},
+        {"proj", required_argument, 0, 'p'},
+        {"zone", required_argument, 0, 'z'},
+        {"datum", required_argument, 0, 'd'},
+        {"longitude_pole", required_argument, 0, 'P'},
+        {"latitude_true_scale", required_argument, 0, 'T'},
+        {"false_easting", required_argument, 0, 'e'},
+        {"false_northing", required_argument, 0, 'n'},
+        {"standard_parallel1", required_argument, 0, '1'},
+        {"standard_parallel2", required_argument, 0, '2'},
+        {"central_meridian", required_argument, 0, 'm'},
+        {"origin_latitude", required_argument, 0, 'O'},
+        {"sphere_radius", required_argument, 0, 'r'},
+        {"pixel_size", required_argument, 0, 's'},
+        {"resample", required_argument, 0, 'R'},
+        {"max_error", required_argument, 0, 'E'},
+        {"ulx", required_argument, 0, 'x'},
+        {"uly", required_argument, 0, 'y'},
+        {"lrx", required_argument, 0, 'X'},
+        {"lry", required_argument, 0, 'Y'},
+        {"threads", required_argument, 0, 'N'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    /* Loop through all the cmd-line options */
+    init_espa_mosaic_options (options);
+    opterr = 0;   /* turn off getopt_long error msgs as we'll print our own */
+    while (1)
+    {
+        /* optstring in call to getopt_long is empty since we will only
+           support the long options */
+        c = getopt_long (argc, argv, "", long_options, &option_index);
+        if (c == -1)
+        {   /* Out of cmd-line options */
+            break;
+        }
+
+        switch (c)
+        {
+            case 0:
+                /* If this option set a flag, do nothing else now. */
+                if (long_options[option_index].flag != 0)
+                    break;
+
+            case 'h':  /* help */
+                usage ();
+                return (ERROR);
+                break;
+
+            case 'i':  /* XML infile */
+                xml_files[(*nfiles)++] = strdup (optarg);
+                break;
+
+            case 'o':  /* XML mosaic outfile */
+                free (*xml_mosaic_outfile);
+                *xml_mosaic_outfile = strdup (optarg);
+                break;
+
+            case 'u':  /* composite rule */
+                if (!strcasecmp (optarg, "first"))
+                    options->rule = ESPA_MOSAIC_FIRST_VALID;
+                else if (!strcasecmp (optarg, "latest"))
+                    options->rule = ESPA_MOSAIC_LATEST_DATE;
+                else
+                {
+                    sprintf (errmsg, "Unsupported composite rule %s",
+                        optarg);
+                    error_handler (true, FUNC_NAME, errmsg);
+                    usage ();
+                    return (ERROR);
+                }
+                break;
+
+            case 'g':  /* ARD grid */
+                if (!strcasecmp (optarg, "ard_conus"))
+                {
+                    proj->standard_parallel1 = 29.5;
+                    proj->standard_parallel2 = 45.5;
+                    proj->central_meridian = -96.0;
+                    proj->origin_latitude = 23.0;
+                    options->align_x = ARD_CONUS_ULX;
+                    options->align_y = ARD_CONUS_ULY;
+                }
+                else if (!strcasecmp (optarg, "ard_alaska"))
+                {
+                    proj->standard_parallel1 = 55.0;
+                    proj->standard_parallel2 = 65.0;
+                    proj->central_meridian = -154.0;
+                    proj->origin_latitude = 50.0;
+                    options->align_x = ARD_ALASKA_ULX;
+                    options->align_y = ARD_ALASKA_ULY;
+                }
+                else
+                {
+                    sprintf (errmsg, "Unsupported grid %s", optarg);
+                    error_handler (true, FUNC_NAME, errmsg);
+                    usage ();
+                    return (ERROR);
+                }
+                if (ard)
+                {
+                    sprintf (errmsg, "Only one grid can be given");
+                    error_handler (true, FUNC_NAME, errmsg);
+                    usage ();
+                    return (ERROR);
+                }
+                ard = true;
+                break;
+
+            case 't':  /* ARD tile */
+                if (sscanf (optarg, "%d,%d", &tile_h, &tile_v) != 2 ||
+                    tile_h < 0 || tile_v < 0)
+                {
+                    sprintf (errmsg, "Invalid tile %s; expected h,v",
+                        optarg);
+                    error_handler (true, FUNC_NAME, errmsg);
+                    usage ();
+                    return (ERROR);
+                }
+                break;
+
+            case 'p':  /* target projection */
+                if (!strcasecmp (optarg, "geo"))
+                    proj->proj_type = GCTP_GEO_PROJ;
+                else if (!strcasecmp (optarg, "utm"))
+                    proj->proj_type = GCTP_UTM_PROJ;
+                else if (!strcasecmp (optarg, "ps"))
+                    proj->proj_type = GCTP_PS_PROJ;
+                else if (!strcasecmp (optarg, "albers"))
+                    proj->proj_type = GCTP_ALBERS_PROJ;
+                else if (!strcasecmp (optarg, "sin"))
+                    proj->proj_type = GCTP_SIN_PROJ;
+                else
+                {
+                    sprintf (errmsg, "Unsupported projection %s", optarg);
+                    error_handler (true, FUNC_NAME, errmsg);
+                    usage ();
+                    return (ERROR);
+                }
+                break;
+
+            case 'z':  /* UTM zone */
+                proj->utm_zone = atoi (optarg);
+                break;
+
+            case 'd':  /* datum */
+                if (!strcasecmp (optarg, "wgs84"))
+                    proj->datum_type = ESPA_WGS84;
+                else if (!strcasecmp (optarg, "nad83"))
+                    proj->datum_type = ESPA_NAD83;
+                else if (!strcasecmp (optarg, "nad27"))
+                    proj->datum_type = ESPA_NAD27;
+                else
+                {
+                    sprintf (errmsg, "Unsupported datum %s", optarg);
+                    error_handler (true, FUNC_NAME, errmsg);
+                    usage ();
+                    return (ERROR);
+                }
+                break;
+
+            case 'P':  /* longitude of the pole */
+                proj->longitude_pole = atof (optarg);
+                break;
+
+            case 'T':  /* latitude of true scale */
+                proj->latitude_true_scale = atof (optarg);
+                break;
+
+            case 'e':  /* false easting */
+                proj->false_easting = atof (optarg);
+                break;
+
+            case 'n':  /* false northing */
+                proj->false_northing = atof (optarg);
+                break;
+
+            case '1':  /* first standard parallel */
+                proj->standard_parallel1 = atof (optarg);
+                break;
+
+            case '2':  /* second standard parallel */
+                proj->standard_parallel2 = atof (optarg);
+                break;
+
+            case 'm':  /* central meridian */
+                proj->central_meridian = atof (optarg);
+                break;
+
+            case 'O':  /* latitude of the origin */
+                proj->origin_latitude = atof (optarg);
+                break;
+
+            case 'r':  /* sphere radius */
+                proj->sphere_radius = atof (optarg);
+                break;
+
+            case 's':  /* pixel size of the reference band */
+                grid->pixel_size[0] = grid->pixel_size[1] = atof (optarg);
+                break;
+
+            case 'R':  /* resampling of all the bands */
+                if (!strcasecmp (optarg, "nn"))
+                    grid->resample = ESPA_NN;
+                else if (!strcasecmp (optarg, "bi"))
+                    grid->resample = ESPA_BI;
+                else if (!strcasecmp (optarg, "cc"))
+                    grid->resample = ESPA_CC;
+                else
+                {
+                    sprintf (errmsg, "Unsupported resampling %s", optarg);
+                    error_handler (true, FUNC_NAME, errmsg);
+                    usage ();
+                    return (ERROR);
+                }
+                break;
+
+            case 'E':  /* largest interpolation error */
+                grid->max_error = atof (optarg);
+                break;
+
+            case 'x':  /* left edge of the output */
+                grid->ulx = atof (optarg);
+                nextent_opts++;
+                break;
+
+            case 'y':  /* top edge of the output */
+                grid->uly = atof (optarg);
+                nextent_opts++;
+                break;
+
+            case 'X':  /* right edge of the output */
+                grid->lrx = atof (optarg);
+                nextent_opts++;
+                break;
+
+            case 'Y':  /* bottom edge of the output */
+                grid->lry = atof (optarg);
+                nextent_opts++;
+                break;
+
+            case 'N':  /* number of threads */
+                espa_task_pool_set_threads (atoi (optarg));
+                break;
+
+            case '?':
+            default:
+                sprintf (errmsg, "Unknown option %s", argv[optind-1]);
+                error_handler (true, FUNC_NAME, errmsg);
+                usage ();
+                return (ERROR);
+                break;
+        }
+    }
+
+    /* The remaining arguments are XML files as well */
+    for ( ; optind < argc; optind++)
+        xml_files[(*nfiles)++] = strdup (argv[optind]);
+
+    /* Make sure the infiles and outfiles were specified */
+    if (*nfiles == 0)
+    {
+        sprintf (errmsg, "At least one XML input file is a required "
+            "argument");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    if (*xml_mosaic_outfile == NULL)
+    {
+        sprintf (errmsg, "XML mosaic output file is a required argument");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    /* An ARD grid sets the projection and pixel size, and its tile the
+       extent */
+    if (ard)
+    {
+        if (proj->proj_type != ESPA_INT_META_FILL ||
+            proj->datum_type != ESPA_INT_META_FILL ||
+            grid->pixel_size[0] != 0.0)
+        {
+            sprintf (errmsg, "An ARD grid can't be given with --proj, "
+                "--datum, or --pixel_size");
+            error_handler (true, FUNC_NAME, errmsg);
+            usage ();
+            return (ERROR);
+        }
+        proj->proj_type = GCTP_ALBERS_PROJ;
+        proj->datum_type = ESPA_WGS84;
+        grid->pixel_size[0] = grid->pixel_size[1] = ARD_PIXEL_SIZE;
+        options->align_set = true;
+    }
+    if (tile_h >= 0)
+    {
+        if (!ard || nextent_opts != 0)
+        {
+            sprintf (errmsg, "A tile needs --grid, and can't be given with "
+                "the extent");
+            error_handler (true, FUNC_NAME, errmsg);
+            usage ();
+            return (ERROR);
+        }
+        grid->ulx = options->align_x + tile_h * ARD_TILE_SIZE;
+        grid->uly = options->align_y - tile_v * ARD_TILE_SIZE;
+        grid->lrx = grid->ulx + ARD_TILE_SIZE;
+        grid->lry = grid->uly - ARD_TILE_SIZE;
+        nextent_opts = 4;
+    }
+
+    /* The projection parameters only go with a projection */
+    if (proj->proj_type == ESPA_INT_META_FILL && (proj->utm_zone != 0 ||
+        proj->longitude_pole != 0.0 || proj->latitude_true_scale != 0.0 ||
+        proj->false_easting != 0.0 || proj->false_northing != 0.0 ||
+        proj->standard_parallel1 != 0.0 || proj->standard_parallel2 != 0.0 ||
+        proj->central_meridian != 0.0 || proj->origin_latitude != 0.0 ||
+        proj->sphere_radius != 0.0))
+    {
+        sprintf (errmsg, "Projection parameters need --proj");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    if (proj->proj_type == GCTP_UTM_PROJ && proj->utm_zone == 0)
+    {
+        sprintf (errmsg, "The UTM projection needs --zone");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    if (proj->proj_type == GCTP_SIN_PROJ && proj->sphere_radius <= 0.0)
+    {
+        sprintf (errmsg, "The sinusoidal projection needs --sphere_radius");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    /* Make sure the extent is complete if given */
+    if (nextent_opts != 0 && nextent_opts != 4)
+    {
+        sprintf (errmsg, "The extent needs to be given by all of --ulx, "
+            "--uly, --lrx, and --lry");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+    grid->extent_set = nextent_opts == 4;
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  main
+
+PURPOSE:  Mosaics the input products onto the target grid and writes the
+output bands and XML metadata file.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error doing the mosaic
+SUCCESS         No errors encountered
+
+NOTES:
+******************************************************************************/
+int main (int argc, char** argv)
+{
+    char **xml_files = NULL;          /* input XML filenames */
+    char *xml_mosaic_outfile = NULL;  /* output mosaic XML filename */
+    int nfiles = 0;                   /* number of XML files */
+    int status;                       /* return status */
+    int i;                            /* looping variable for the files */
+    Espa_mosaic_options_t options;    /* options of the mosaic */
+
+    printf ("espa_mosaic version: %s\n", ESPA_COMMON_VERSION);
+
+    /* Every argument could be an XML file */
+    xml_files = calloc (argc, sizeof (char *));
+    if (xml_files == NULL)
+    {
+        error_handler (true, "main", "Error allocating memory for the XML "
+            "filenames.");
+        exit (EXIT_FAILURE);
+    }
+
+    /* Read the command-line arguments */
+    if (get_args (argc, argv, xml_files, &nfiles, &xml_mosaic_outfile,
+        &options) != SUCCESS)
+    {   /* get_args already printed the error message */
+        exit (EXIT_FAILURE);
+    }
+
+    /* Mosaic the input products and write the output product */
+    status = mosaic_espa_products (xml_files, nfiles, xml_mosaic_outfile,
+        &options);
+    if (status == SUCCESS)
+        printf ("Wrote the mosaic of %d products to %s\n", nfiles,
+            xml_mosaic_outfile);
+
+    /* Free the pointers */
+    for (i = 0; i < nfiles; i++)
+        free (xml_files[i]);
+    free (xml_files);
+    free (xml_mosaic_outfile);
+
+    exit (status == SUCCESS ? EXIT_SUCCESS : EXIT_FAILURE);
+}
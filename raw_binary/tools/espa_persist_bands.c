@@ -0,0 +1,203 @@
+/*****************************************************************************
+FILE: espa_persist_bands
+
+PURPOSE: Contains functions for writing the bands of an ESPA product which
+were handed between tools in shared memory to disk, at the end of a chain of
+tools.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. See espa_shm.h for how the bands are placed in shared memory.
+*****************************************************************************/
+#include <getopt.h>
+#include "espa_metadata.h"
+#include "parse_metadata.h"
+#include "espa_shm.h"
+
+/******************************************************************************
+MODULE: usage
+
+PURPOSE: Prints the usage information for this application.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+void usage ()
+{
+    printf ("espa_persist_bands writes the bands of a product in the ESPA "
+            "internal format which are held in shared memory (named shm: "
+            "in the XML file, as written by the tools run with "
+            "ESPA_SHM_BANDS=yes) to their files on disk, rewrites the XML "
+            "file to name the files on disk, and releases the shared "
+            "memory.  Bands already on disk are left alone.\n");
+    printf ("version: %s\n\n", ESPA_COMMON_VERSION);
+    printf ("usage: espa_persist_bands "
+            "--xml=input_metadata_filename "
+            "[--output_xml=output_metadata_filename]\n");
+
+    printf ("\nwhere the following parameters are required:\n");
+    printf ("    -xml: name of the XML metadata file which follows the ESPA "
+            "internal raw binary schema\n");
+    printf ("\nwhere the following parameters are optional:\n");
+    printf ("    -output_xml: name of the output XML metadata file.  The "
+            "default is to rewrite the input XML file.\n");
+    printf ("\nExample: espa_persist_bands "
+            "--xml=LE07_L1TP_022033_20140228_20161028_02_T1.xml\n");
+}
+
+
+/******************************************************************************
+MODULE:  get_args
+
+PURPOSE:  Gets the command-line arguments and validates that the required
+arguments were specified.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error getting the command-line arguments or a command-line
+                argument and associated value were not specified
+SUCCESS         No errors encountered
+
+NOTES:
+  1. Memory is allocated for the input and output files.  All of these should
+     be character pointers set to NULL on input.  The caller is responsible
+     for freeing the allocated memory upon successful return.
+******************************************************************************/
+short get_args
+(
+    int argc,             /* I: number of cmd-line args */
+    char *argv[],         /* I: string of cmd-line args */
+    char **xml_infile,    /* O: address of input XML filename */
+    char **xml_outfile    /* O: address of output XML filename */
+)
+{
+    int c;                           /* current argument index */
+    int option_index;                /* index for the command-line option */
+    char errmsg[STR_SIZE];           /* error message */
+    char FUNC_NAME[] = "get_args";   /* function name */
+    static struct option long_options[] =
+    {
+        {"xml", required_argument, 0, 'i'},
+        {"output_xml", required_argument, 0, 'o'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    /* Loop through all the cmd-line options */
+    opterr = 0;   /* turn off getopt_long error msgs as we'll print our own */
+    while (1)
+    {
+        /* optstring in call to getopt_long is empty since we will only
+           support the long options */
+        c = getopt_long (argc, argv, "", long_options, &option_index);
+        if (c == -1)
+        {   /* Out of cmd-line options */
+            break;
+        }
+
+        switch (c)
+        {
+            case 0:
+                /* If this option set a flag, do nothing else now. */
+                if (long_options[option_index].flag != 0)
+                    break;
+
+            case 'h':  /* help */
+                usage ();
+                return (ERROR);
+                break;
+
+            case 'i':  /* XML infile */
+                *xml_infile = strdup (optarg);
+                break;
+
+            case 'o':  /* XML outfile */
+                *xml_outfile = strdup (optarg);
+                break;
+
+            case '?':
+            default:
+                sprintf (errmsg, "Unknown option %s", argv[optind-1]);
+                error_handler (true, FUNC_NAME, errmsg);
+                usage ();
+                return (ERROR);
+                break;
+        }
+    }
+
+    /* Make sure the infile was specified */
+    if (*xml_infile == NULL)
+    {
+        sprintf (errmsg, "XML input file is a required argument");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    /* Rewrite the input XML file by default */
+    if (*xml_outfile == NULL)
+        *xml_outfile = strdup (*xml_infile);
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  main
+
+PURPOSE:  Writes the bands of a product held in shared memory to disk.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the bands
+SUCCESS         No errors encountered
+
+NOTES:
+  1. If a band can't be written, the XML file and the shared memory are
+     left as they were.
+******************************************************************************/
+int main (int argc, char** argv)
+{
+    char *xml_infile = NULL;     /* input XML filename */
+    char *xml_outfile = NULL;    /* output XML filename */
+    Espa_internal_meta_t xml_metadata;  /* XML metadata structure */
+
+    printf ("espa_persist_bands version: %s\n", ESPA_COMMON_VERSION);
+
+    /* Read the command-line arguments */
+    if (get_args (argc, argv, &xml_infile, &xml_outfile) != SUCCESS)
+    {   /* get_args already printed the error message */
+        exit (EXIT_FAILURE);
+    }
+
+    /* Read the metadata of the product */
+    init_metadata_struct (&xml_metadata);
+    if (validate_and_parse_metadata (xml_infile, &xml_metadata) != SUCCESS)
+    {  /* Error messages already written */
+        exit (EXIT_FAILURE);
+    }
+
+    /* Write the bands to disk and the XML file naming them */
+    if (persist_espa_shm_bands (&xml_metadata, xml_outfile) != SUCCESS)
+    {  /* Error messages already written */
+        exit (EXIT_FAILURE);
+    }
+
+    /* Free the metadata structure and the pointers */
+    free_metadata (&xml_metadata);
+    free (xml_infile);
+    free (xml_outfile);
+
+    /* Successful completion */
+    exit (EXIT_SUCCESS);
+}
@@ -39,7 +39,8 @@ void usage ()
             "--xml=input_metadata_filename "
             "--subset_xml=output_subset_metadata_filename "
             "--product=product_name (multiple --product options can be "
-            "specified).\n");
+            "specified) [--output_dir=directory] "
+            "[--link=reflink|hardlink|copy].\n");
 
     printf ("\nwhere the following parameters are required:\n");
     printf ("    -xml: name of the input XML metadata file which follows "
@@ -48,6 +49,16 @@ void usage ()
             "only the bands with the user-specified product types\n");
     printf ("    -product: name of the product type in the input XML file to "
             "be written to the subset XML file\n");
+
+    printf ("\nwhere the following parameters are optional:\n");
+    printf ("    -output_dir: directory to place the files of the subset "
+            "bands in, so the subset XML file can be written there as a "
+            "product of its own.  The files are reflinked, hard linked, or "
+            "copied, per -link.\n");
+    printf ("    -link: how the files are placed in -output_dir: reflink "
+            "(copy-on-write clone, the default), hardlink (shares the "
+            "original files, so modifying either modifies both), or copy.  "
+            "Files which can't be reflinked or hard linked are copied.\n");
     printf ("\nExample: espa_product_subset "
             "--xml=LE07_L1TP_022033_20140228_20161028_02_T1.xml "
             "--subset_xml=LE07_L1TP_022033_20140228_20161028_02_T1_subset.xml "
@@ -70,9 +81,11 @@ ERROR           Error getting the command-line arguments or a command-line
 SUCCESS         No errors encountered
 
 NOTES:
-  1. Memory is allocated for the input and output files.  All of these should
-     be character pointers set to NULL on input.  The caller is responsible
+  1. Memory is allocated for the input and output files and the output
+     directory.  All of these should be character pointers set to NULL on
+     input.  The caller is responsible
      for freeing the allocated memory upon successful return.
+  2. The product list grows as needed and is to be freed with free_name_list.
 ******************************************************************************/
 short get_args
 (
@@ -80,13 +93,15 @@ short get_args
     char *argv[],         /* I: string of cmd-line args */
     char **xml_infile,    /* O: address of input XML filename */
     char **xml_subset_outfile,  /* O: address of output subset XML filename */
-    int *nproducts,       /* O: number of product types in the subset */
-    char products[][STR_SIZE]  /* O: array of product types to be subset */
+    Espa_name_list_t *products,  /* O: list of product types to be subset */
+    char **out_dir,       /* O: address of the directory to materialize the
+                                band files in; NULL if not specified */
+    Espa_link_method_t *link_method  /* O: preferred method of materializing
+                                the band files */
 )
 {
     int c;                           /* current argument index */
     int option_index;                /* index for the command-line option */
-    int count;                       /* number of chars copied in snprintf */
     char errmsg[STR_SIZE];           /* error message */
     char FUNC_NAME[] = "get_args";   /* function name */
     static struct option long_options[] =
@@ -94,12 +109,15 @@ short get_args
         {"xml", required_argument, 0, 'i'},
         {"subset_xml", required_argument, 0, 'o'},
         {"product", required_argument, 0, 'p'},
+        {"output_dir", required_argument, 0, 'd'},
+        {"link", required_argument, 0, 'l'},
         {"help", no_argument, 0, 'h'},
         {0, 0, 0, 0}
     };
 
     /* Loop through all the cmd-line options */
-    *nproducts = 0;
+    init_name_list (products);
+    *link_method = ESPA_LINK_REFLINK;
     opterr = 0;   /* turn off getopt_long error msgs as we'll print our own */
     while (1)
     {
@@ -132,26 +150,26 @@ short get_args
                 break;
      
             case 'p':  /* product type to be added */
-                count = snprintf (products[*nproducts], 
-                    sizeof (products[*nproducts]), "%s", optarg);
-                if (count < 0 || count >= sizeof (products[*nproducts]))
+                if (add_name_to_list (products, optarg) != SUCCESS)
                 {
-                    sprintf (errmsg, "Overflow of products[*nproducts] string");
+                    sprintf (errmsg, "Adding product type %s", optarg);
                     error_handler (true, FUNC_NAME, errmsg);
                     return (ERROR);
                 }
+                break;
+     
+            case 'd':  /* directory to materialize the band files in */
+                *out_dir = strdup (optarg);
+                break;
 
-                (*nproducts)++;
-                if (*nproducts > MAX_TOTAL_PRODUCT_TYPES)
+            case 'l':  /* method of materializing the band files */
+                if (get_link_method (optarg, link_method) != SUCCESS)
                 {
-                    sprintf (errmsg, "Maximum number of products (%d) has been "
-                        "reached. Results might not be trustworthy as the "
-                        "memory may have been trashed.",
-                        MAX_TOTAL_PRODUCT_TYPES);
-                    error_handler (false, FUNC_NAME, errmsg);
+                    usage ();
+                    return (ERROR);
                 }
                 break;
-     
+
             case '?':
             default:
                 sprintf (errmsg, "Unknown option %s", argv[optind-1]);
@@ -179,7 +197,7 @@ short get_args
         return (ERROR);
     }
 
-    if (*nproducts == 0)
+    if (products->nnames == 0)
     {
         sprintf (errmsg, "At least one product type must be specified for "
             "subsetting");
@@ -214,23 +232,32 @@ int main (int argc, char** argv)
 {
     char *xml_infile = NULL;          /* input XML filename */
     char *xml_subset_outfile = NULL;  /* output subset XML filename */
-    char products[MAX_TOTAL_PRODUCT_TYPES][STR_SIZE];  /* array of nproducts
-                                       product types */
-    int nproducts;                   /* number of product types specified */
+    Espa_name_list_t products;       /* list of product types specified */
+    char *out_dir = NULL;             /* directory to materialize the band
+                                         files in */
+    Espa_link_method_t link_method;   /* preferred method of materializing the
+                                         band files */
+    Espa_xml_subset_t subset;         /* subset to be written */
 
     printf ("espa_product_subset version: %s\n", ESPA_COMMON_VERSION);
 
     /* Read the command-line arguments */
-    if (get_args (argc, argv, &xml_infile, &xml_subset_outfile, &nproducts,
-        products) != SUCCESS)
+    if (get_args (argc, argv, &xml_infile, &xml_subset_outfile, &products,
+        &out_dir, &link_method) != SUCCESS)
     {   /* get_args already printed the error message */
         exit (EXIT_FAILURE);
     }
 
     /* Subset the input XML metadata file with the specified product types and
-       write to the output XML metadata file */
-    if (subset_xml_by_product (xml_infile, xml_subset_outfile, nproducts,
-        products) != SUCCESS)
+       write to the output XML metadata file, materializing the band files in
+       the output directory if one was specified */
+    subset.out_xml_file = xml_subset_outfile;
+    subset.by_product = true;
+    subset.nnames = products.nnames;
+    subset.names = products.names;
+    subset.out_dir = out_dir;
+    subset.link_method = link_method;
+    if (subset_xml_files (xml_infile, 1, &subset) != SUCCESS)
     {  /* Error messages already written */
         exit (EXIT_FAILURE);
     }
@@ -238,6 +265,8 @@ int main (int argc, char** argv)
     /* Free the pointers */
     free (xml_infile);
     free (xml_subset_outfile);
+    free (out_dir);
+    free_name_list (&products);
 
     /* Successful completion */
     exit (EXIT_SUCCESS);
@@ -0,0 +1,281 @@
+/*****************************************************************************
+FILE: espa_spatial_subset
+
+PURPOSE: Contains functions for cutting a spatial window out of an ESPA
+product, writing the window of each band along with the updated XML file.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The XML metadata format parsed or written via this library follows the
+     ESPA internal metadata format found in ESPA Raw Binary Format v1.0.doc.
+     The schema for the ESPA internal metadata format is available at
+     http://espa.cr.usgs.gov/schema/espa_internal_metadata_v1_0.xsd.
+*****************************************************************************/
+#include <getopt.h>
+#include "espa_spatial_subset.h"
+
+/******************************************************************************
+MODULE: usage
+
+PURPOSE: Prints the usage information for this application.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+void usage ()
+{
+    printf ("espa_spatial_subset cuts a spatial window out of the bands of "
+            "the input product and creates a new XML metadata file and raw "
+            "binary band files for the window.\n");
+    printf ("version: %s\n\n", ESPA_COMMON_VERSION);
+    printf ("usage: espa_spatial_subset "
+            "--xml=input_metadata_filename "
+            "--subset_xml=output_subset_metadata_filename "
+            "{--line=first_line --sample=first_sample --nlines=lines "
+            "--nsamps=samples | --ulx=x --uly=y --lrx=x --lry=y}\n");
+
+    printf ("\nwhere the following parameters are required:\n");
+    printf ("    -xml: name of the input XML metadata file which follows "
+            "the ESPA internal raw binary schema\n");
+    printf ("    -subset_xml: name of the output XML metadata file.  The "
+            "output bands are named after it, <base>_<band name>.img\n");
+
+    printf ("\nand the window is given by either of:\n");
+    printf ("    -line, -sample, -nlines, -nsamps: 0-based first line and "
+            "sample, and the number of lines and samples, of the window in "
+            "the reference band (band1 for Landsat, B02 for Sentinel-2, "
+            "otherwise the first band)\n");
+    printf ("    -ulx, -uly, -lrx, -lry: projection coordinates of the UL and "
+            "LR edges of the window.  Every pixel the window touches is "
+            "kept, and the window is clipped to the image.\n");
+    printf ("\nThe window is widened as needed to whole pixels of the "
+            "coarsest band.\n");
+    printf ("\nExample: espa_spatial_subset "
+            "--xml=LE07_L1TP_022033_20140228_20161028_02_T1.xml "
+            "--subset_xml=LE07_L1TP_022033_20140228_20161028_02_T1_aoi.xml "
+            "--line=1000 --sample=2000 --nlines=512 --nsamps=512\n");
+    printf ("\nExample: espa_spatial_subset "
+            "--xml=LE07_L1TP_022033_20140228_20161028_02_T1.xml "
+            "--subset_xml=LE07_L1TP_022033_20140228_20161028_02_T1_aoi.xml "
+            "--ulx=600000 --uly=4300000 --lrx=630000 --lry=4270000\n");
+}
+
+
+/******************************************************************************
+MODULE:  get_args
+
+PURPOSE:  Gets the command-line arguments and validates that the required
+arguments were specified.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error getting the command-line arguments or a command-line
+                argument and associated value were not specified
+SUCCESS         No errors encountered
+
+NOTES:
+  1. Memory is allocated for the input and output files.  All of these should
+     be character pointers set to NULL on input.  The caller is responsible
+     for freeing the allocated memory upon successful return.
+******************************************************************************/
+short get_args
+(
+    int argc,             /* I: number of cmd-line args */
+    char *argv[],         /* I: string of cmd-line args */
+    char **xml_infile,    /* O: address of input XML filename */
+    char **xml_subset_outfile,  /* O: address of output subset XML filename */
+    Espa_spatial_window_t *window  /* O: window to be cut out */
+)
+{
+    int c;                           /* current argument index */
+    int option_index;                /* index for the command-line option */
+    int npixel_opts = 0;             /* number of line/sample options */
+    int nproj_opts = 0;              /* number of projection options */
+    char errmsg[STR_SIZE];           /* error message */
+    char FUNC_NAME[] = "get_args";   /* function name */
+    static struct option long_options[] =
+    {
+        {"xml", required_argument, 0, 'i'},
+        {"subset_xml", required_argument, 0, 'o'},
+        {"line", required_argument, 0, 'l'},
+        {"sample", required_argument, 0, 's'},
+        {"nlines", required_argument, 0, 'L'},
+        {"nsamps", required_argument, 0, 'S'},
+        {"ulx", required_argument, 0, 'x'},
+        {"uly", required_argument, 0, 'y'},
+        {"lrx", required_argument, 0, 'X'},
+        {"lry", required_argument, 0, 'Y'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    /* Loop through all the cmd-line options */
+    memset (window, 0, sizeof (*window));
+    opterr = 0;   /* turn off getopt_long error msgs as we'll print our own */
+    while (1)
+    {
+        /* optstring in call to getopt_long is empty since we will only
+           support the long options */
+        c = getopt_long (argc, argv, "", long_options, &option_index);
+        if (c == -1)
+        {   /* Out of cmd-line options */
+            break;
+        }
+
+        switch (c)
+        {
+            case 0:
+                /* If this option set a flag, do nothing else now. */
+                if (long_options[option_index].flag != 0)
+                    break;
+
+            case 'h':  /* help */
+                usage ();
+                return (ERROR);
+                break;
+
+            case 'i':  /* XML infile */
+                *xml_infile = strdup (optarg);
+                break;
+
+            case 'o':  /* XML subset outfile */
+                *xml_subset_outfile = strdup (optarg);
+                break;
+
+            case 'l':  /* first line of the window */
+                window->pixels.line0 = atoi (optarg);
+                npixel_opts++;
+                break;
+
+            case 's':  /* first sample of the window */
+                window->pixels.samp0 = atoi (optarg);
+                npixel_opts++;
+                break;
+
+            case 'L':  /* number of lines in the window */
+                window->pixels.nlines = atoi (optarg);
+                npixel_opts++;
+                break;
+
+            case 'S':  /* number of samples in the window */
+                window->pixels.nsamps = atoi (optarg);
+                npixel_opts++;
+                break;
+
+            case 'x':  /* left edge of the window */
+                window->ulx = atof (optarg);
+                nproj_opts++;
+                break;
+
+            case 'y':  /* top edge of the window */
+                window->uly = atof (optarg);
+                nproj_opts++;
+                break;
+
+            case 'X':  /* right edge of the window */
+                window->lrx = atof (optarg);
+                nproj_opts++;
+                break;
+
+            case 'Y':  /* bottom edge of the window */
+                window->lry = atof (optarg);
+                nproj_opts++;
+                break;
+
+            case '?':
+            default:
+                sprintf (errmsg, "Unknown option %s", argv[optind-1]);
+                error_handler (true, FUNC_NAME, errmsg);
+                usage ();
+                return (ERROR);
+                break;
+        }
+    }
+
+    /* Make sure the infiles and outfiles were specified */
+    if (*xml_infile == NULL)
+    {
+        sprintf (errmsg, "XML input file is a required argument");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    if (*xml_subset_outfile == NULL)
+    {
+        sprintf (errmsg, "XML subset output file is a required argument");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    /* Make sure exactly one complete window was specified */
+    if (!((npixel_opts == 4 && nproj_opts == 0) ||
+          (npixel_opts == 0 && nproj_opts == 4)))
+    {
+        sprintf (errmsg, "The window needs to be given by all of --line, "
+            "--sample, --nlines, and --nsamps, or by all of --ulx, --uly, "
+            "--lrx, and --lry");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+    window->proj_window = nproj_opts == 4;
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  main
+
+PURPOSE:  Cuts the specified window out of the bands of the input product and
+writes the output bands and XML metadata file.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error doing the subsetting
+SUCCESS         No errors encountered
+
+NOTES:
+******************************************************************************/
+int main (int argc, char** argv)
+{
+    char *xml_infile = NULL;          /* input XML filename */
+    char *xml_subset_outfile = NULL;  /* output subset XML filename */
+    Espa_spatial_window_t window;     /* window to be cut out */
+
+    printf ("espa_spatial_subset version: %s\n", ESPA_COMMON_VERSION);
+
+    /* Read the command-line arguments */
+    if (get_args (argc, argv, &xml_infile, &xml_subset_outfile, &window) !=
+        SUCCESS)
+    {   /* get_args already printed the error message */
+        exit (EXIT_FAILURE);
+    }
+
+    /* Cut the window out of the input product and write the output
+       product */
+    if (subset_espa_spatial (xml_infile, xml_subset_outfile, &window) !=
+        SUCCESS)
+    {  /* Error messages already written */
+        exit (EXIT_FAILURE);
+    }
+
+    /* Free the pointers */
+    free (xml_infile);
+    free (xml_subset_outfile);
+
+    /* Successful completion */
+    exit (EXIT_SUCCESS);
+}
@@ -0,0 +1,235 @@
+/*****************************************************************************
+FILE: espa_stac_item
+
+PURPOSE: Contains functions for writing a STAC item and the byte range
+references of the bands of an ESPA product, for cloud-native reads of the
+raw binary bands.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The XML metadata format parsed or written via this library follows the
+     ESPA internal metadata format found in ESPA Raw Binary Format v1.0.doc.
+     The schema for the ESPA internal metadata format is available at
+     http://espa.cr.usgs.gov/schema/espa_internal_metadata_v1_0.xsd.
+*****************************************************************************/
+#include <getopt.h>
+#include "convert_espa_to_zarr.h"
+#include "espa_stac.h"
+
+/******************************************************************************
+MODULE: usage
+
+PURPOSE: Prints the usage information for this application.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+void usage ()
+{
+    printf ("espa_stac_item writes a STAC item describing the ESPA internal "
+            "format (raw binary and associated XML metadata file), and "
+            "optionally kerchunk references giving the byte ranges of the "
+            "chunks of the bands, so readers fetch windows of the bands "
+            "directly over HTTP without any conversion.\n");
+    printf ("version: %s\n\n", ESPA_COMMON_VERSION);
+    printf ("usage: espa_stac_item "
+            "--xml=input_metadata_filename "
+            "--stac=output_item_filename "
+            "[--refs=output_references_filename] "
+            "[--href_base=url]\n");
+
+    printf ("\nwhere the following parameters are required:\n");
+    printf ("    -xml: name of the input XML metadata file which follows "
+            "the ESPA internal raw binary schema\n");
+    printf ("    -stac: name of the output STAC item (JSON) file\n");
+    printf ("\nand where the following parameters are optional:\n");
+    printf ("    -refs: name of the output references (JSON) file, which "
+            "describe the bands as a Zarr store and are linked from the "
+            "item (the default is no references)\n");
+    printf ("    -href_base: base URL the product files are served from "
+            "(ex. s3://bucket/path/), which the item and the references "
+            "name the files by (the default is the local files)\n");
+    printf ("\nExample: espa_stac_item "
+            "--xml=LE07_L1TP_022033_20140228_20161028_02_T1.xml "
+            "--stac=LE07_L1TP_022033_20140228_20161028_02_T1_stac.json "
+            "--refs=LE07_L1TP_022033_20140228_20161028_02_T1_refs.json "
+            "--href_base=s3://bucket/LE07_L1TP_022033_20140228_20161028_02_T1/"
+            "\n");
+}
+
+
+/******************************************************************************
+MODULE:  get_args
+
+PURPOSE:  Gets the command-line arguments and validates that the required
+arguments were specified.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error getting the command-line arguments or a command-line
+                argument and associated value were not specified
+SUCCESS         No errors encountered
+
+NOTES:
+  1. Memory is allocated for the input and output files.  All of these should
+     be character pointers set to NULL on input.  The caller is responsible
+     for freeing the allocated memory upon successful return.
+******************************************************************************/
+short get_args
+(
+    int argc,              /* I: number of cmd-line args */
+    char *argv[],          /* I: string of cmd-line args */
+    char **xml_infile,     /* O: address of input XML filename */
+    char **stac_outfile,   /* O: address of output STAC item filename */
+    char **refs_outfile,   /* O: address of output references filename */
+    char **href_base       /* O: address of base URL of the files */
+)
+{
+    int c;                           /* current argument index */
+    int option_index;                /* index for the command-line option */
+    char errmsg[STR_SIZE];           /* error message */
+    char FUNC_NAME[] = "get_args";   /* function name */
+    static struct option long_options[] =
+    {
+        {"xml", required_argument, 0, 'i'},
+        {"stac", required_argument, 0, 'o'},
+        {"refs", required_argument, 0, 'r'},
+        {"href_base", required_argument, 0, 'b'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    /* Loop through all the cmd-line options */
+    opterr = 0;   /* turn off getopt_long error msgs as we'll print our own */
+    while (1)
+    {
+        /* optstring in call to getopt_long is empty since we will only
+           support the long options */
+        c = getopt_long (argc, argv, "", long_options, &option_index);
+        if (c == -1)
+        {   /* Out of cmd-line options */
+            break;
+        }
+
+        switch (c)
+        {
+            case 0:
+                /* If this option set a flag, do nothing else now. */
+                if (long_options[option_index].flag != 0)
+                    break;
+
+            case 'h':  /* help */
+                usage ();
+                return (ERROR);
+                break;
+
+            case 'i':  /* XML infile */
+                *xml_infile = strdup (optarg);
+                break;
+
+            case 'o':  /* STAC item outfile */
+                *stac_outfile = strdup (optarg);
+                break;
+
+            case 'r':  /* references outfile */
+                *refs_outfile = strdup (optarg);
+                break;
+
+            case 'b':  /* base URL of the files */
+                *href_base = strdup (optarg);
+                break;
+
+            case '?':
+            default:
+                sprintf (errmsg, "Unknown option %s", argv[optind-1]);
+                error_handler (true, FUNC_NAME, errmsg);
+                usage ();
+                return (ERROR);
+                break;
+        }
+    }
+
+    /* Make sure the infiles and outfiles were specified */
+    if (*xml_infile == NULL)
+    {
+        sprintf (errmsg, "XML input file is a required argument");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    if (*stac_outfile == NULL)
+    {
+        sprintf (errmsg, "STAC item output file is a required argument");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  main
+
+PURPOSE:  Writes the STAC item and the references of the bands of an ESPA
+product.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the item or the references
+SUCCESS         No errors encountered
+
+NOTES:
+******************************************************************************/
+int main (int argc, char** argv)
+{
+    char *xml_infile = NULL;     /* input XML filename */
+    char *stac_outfile = NULL;   /* output STAC item filename */
+    char *refs_outfile = NULL;   /* output references filename */
+    char *href_base = NULL;      /* base URL of the product files */
+
+    printf ("espa_stac_item version: %s\n", ESPA_COMMON_VERSION);
+
+    /* Read the command-line arguments */
+    if (get_args (argc, argv, &xml_infile, &stac_outfile, &refs_outfile,
+        &href_base) != SUCCESS)
+    {   /* get_args already printed the error message */
+        exit (EXIT_FAILURE);
+    }
+
+    /* Write the references first, so the item only links references which
+       were written */
+    if (refs_outfile != NULL &&
+        convert_espa_to_zarr_refs (xml_infile, refs_outfile, href_base)
+        != SUCCESS)
+    {  /* Error messages already written */
+        exit (EXIT_FAILURE);
+    }
+
+    if (write_espa_stac_item (xml_infile, stac_outfile, refs_outfile,
+        href_base) != SUCCESS)
+    {  /* Error messages already written */
+        exit (EXIT_FAILURE);
+    }
+
+    /* Free the pointers */
+    free (xml_infile);
+    free (stac_outfile);
+    free (refs_outfile);
+    free (href_base);
+
+    /* Successful completion */
+    exit (EXIT_SUCCESS);
+}
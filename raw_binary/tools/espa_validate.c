@@ -0,0 +1,655 @@
+/*****************************************************************************
+FILE: espa_validate
+
+PURPOSE: Contains functions for validating many ESPA XML metadata files
+against the ESPA schema at once, summarizing the files which fail.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The schema is compiled once (see get_espa_schema) and shared by the
+     threads of the task pool.  Each worker of the loop has its own parser
+     and validation contexts, which are reused for all the files it
+     validates, since neither kind of context may be used by two threads at
+     once.
+  2. The first error of each file is kept, with the number of errors, and
+     the files are reported in the order they were specified.  The summary
+     counts the files failing with each distinct first error, so a batch
+     failing for one reason shows as one line.
+*****************************************************************************/
+#include <getopt.h>
+#include <unistd.h>
+#include <libxml/parser.h>
+#include <libxml/xmlschemas.h>
+#include "espa_metadata.h"
+#include "espa_task_pool.h"
+
+/* Defines */
+#define VALIDATE_MAX_SUMMARY 20  /* most distinct errors in the summary */
+
+/* Outcomes of validating an XML file */
+typedef enum
+{
+    VALID_OK = 0,             /* validates against the schema */
+    VALID_UNREADABLE,         /* couldn't be read or isn't well formed */
+    VALID_INVALID,            /* fails to validate against the schema */
+    VALID_INTERNAL            /* validation generated an internal error */
+} Valid_outcome_t;
+
+/* Result of validating an XML file */
+typedef struct
+{
+    Valid_outcome_t outcome;  /* outcome of the validation */
+    int nerrors;              /* number of errors reported */
+    int line;                 /* line of the first error; 0 if unknown */
+    char message[STR_SIZE];   /* first error reported */
+} Valid_result_t;
+
+/* Validation shared by the workers */
+typedef struct
+{
+    char **xml_files;         /* XML files to be validated */
+    int nfiles;               /* number of XML files */
+    Valid_result_t *results;  /* result of each XML file */
+    xmlSchemaPtr schema;      /* compiled ESPA schema */
+    xmlParserCtxtPtr *parsers;  /* parser context of each worker */
+    xmlSchemaValidCtxtPtr *validators;  /* validation context of each
+                                     worker */
+    bool quiet;               /* only report the files which fail? */
+    int count[VALID_INTERNAL + 1];  /* number of files of each outcome */
+} Validate_t;
+
+/* Distinct first error and the number of files failing with it */
+typedef struct
+{
+    const char *message;      /* first error */
+    int nfiles;               /* number of files failing with it */
+} Error_count_t;
+
+
+/******************************************************************************
+MODULE: usage
+
+PURPOSE: Prints the usage information for this application.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+void usage ()
+{
+    printf ("espa_validate validates many ESPA XML metadata files against "
+            "the ESPA schema, compiling the schema once and validating the "
+            "files in parallel.  Each file which fails is reported with its "
+            "first error, followed by a summary of the errors.\n");
+    printf ("version: %s\n\n", ESPA_COMMON_VERSION);
+    printf ("usage: espa_validate "
+            "[--xml=input_metadata_filename (multiple --xml options can be "
+            "specified)] [--xml_list=file_of_input_metadata_filenames] "
+            "[--threads=number_of_threads] [--quiet] "
+            "[input_metadata_filename ...]\n");
+
+    printf ("\nwhere the following parameters are required:\n");
+    printf ("    -xml, -xml_list, or file arguments: name of an input XML "
+            "metadata file, or of a file listing one input XML metadata "
+            "file per line (- for stdin)\n");
+
+    printf ("\nwhere the following parameters are optional:\n");
+    printf ("    -threads: number of threads validating the XML files "
+            "(default is the cap of the task pool)\n");
+    printf ("    -quiet: only report the XML files which fail\n");
+    printf ("\nThe exit status is 0 if every XML file validates.\n");
+
+    printf ("\nExample: espa_validate --xml_list=delivery.txt "
+            "--threads=32 --quiet\n");
+}
+
+
+/******************************************************************************
+MODULE:  add_xml_file
+
+PURPOSE:  Adds an XML file to the list of XML files to be validated.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error allocating memory for the list
+SUCCESS         Successfully added the XML file
+******************************************************************************/
+static int add_xml_file
+(
+    Validate_t *valid,        /* I/O: validation whose list is added to */
+    int *nalloc,              /* I/O: number of files allocated in the list */
+    const char *xml_file      /* I: XML file to be added */
+)
+{
+    char FUNC_NAME[] = "add_xml_file";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    char **files = NULL;      /* reallocated list */
+
+    if (valid->nfiles == *nalloc)
+    {
+        *nalloc = *nalloc ? *nalloc * 2 : 1024;
+        files = realloc (valid->xml_files, *nalloc * sizeof (char *));
+        if (files == NULL)
+        {
+            sprintf (errmsg, "Allocating memory for the XML file list");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+        valid->xml_files = files;
+    }
+
+    valid->xml_files[valid->nfiles] = strdup (xml_file);
+    if (valid->xml_files[valid->nfiles] == NULL)
+    {
+        sprintf (errmsg, "Allocating memory for the XML file list");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    valid->nfiles++;
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  read_xml_list
+
+PURPOSE:  Adds the XML files listed in a file, one per line, to the list of
+XML files to be validated.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error reading the list
+SUCCESS         Successfully read the list
+
+NOTES:
+  1. Blank lines and lines starting with # are skipped.
+******************************************************************************/
+static int read_xml_list
+(
+    Validate_t *valid,        /* I/O: validation whose list is added to */
+    int *nalloc,              /* I/O: number of files allocated in the list */
+    const char *list_file     /* I: file listing the XML files; - for stdin */
+)
+{
+    char FUNC_NAME[] = "read_xml_list";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    char *line = NULL;        /* current line of the list */
+    char *cptr = NULL;        /* first non-blank character of the line */
+    size_t line_size = 0;     /* size of the line buffer */
+    ssize_t len;              /* length of the current line */
+    int status = SUCCESS;     /* return status */
+    FILE *fptr = NULL;        /* list file */
+
+    fptr = strcmp (list_file, "-") ? fopen (list_file, "r") : stdin;
+    if (fptr == NULL)
+    {
+        sprintf (errmsg, "Opening %s for read access.", list_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    while (status == SUCCESS && (len = getline (&line, &line_size, fptr)) > 0)
+    {
+        while (len > 0 && (line[len-1] == '\n' || line[len-1] == '\r'))
+            line[--len] = '\0';
+        cptr = line + strspn (line, " \t");
+        if (*cptr != '\0' && *cptr != '#')
+            status = add_xml_file (valid, nalloc, cptr);
+    }
+
+    free (line);
+    if (fptr != stdin)
+        fclose (fptr);
+
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  get_args
+
+PURPOSE:  Gets the command-line arguments and validates that the required
+arguments were specified.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error getting the command-line arguments or a command-line
+                argument and associated value were not specified
+SUCCESS         No errors encountered
+
+NOTES:
+  1. Memory is allocated for the list of XML files.  The caller is
+     responsible for freeing the allocated memory upon successful return.
+******************************************************************************/
+short get_args
+(
+    int argc,             /* I: number of cmd-line args */
+    char *argv[],         /* I: string of cmd-line args */
+    Validate_t *valid     /* O: validation to be run */
+)
+{
+    int c;                           /* current argument index */
+    int option_index;                /* index for the command-line option */
+    int nalloc = 0;                  /* number of XML files allocated */
+    char errmsg[STR_SIZE];           /* error message */
+    char FUNC_NAME[] = "get_args";   /* function name */
+    static struct option long_options[] =
+    {
+        {"xml", required_argument, 0, 'i'},
+        {"xml_list", required_argument, 0, 'l'},
+        {"threads", required_argument, 0, 't'},
+        {"quiet", no_argument, 0, 'q'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    /* Loop through all the cmd-line options */
+    opterr = 0;   /* turn off getopt_long error msgs as we'll print our own */
+    while (1)
+    {
+        /* optstring in call to getopt_long is empty since we will only
+           support the long options */
+        c = getopt_long (argc, argv, "", long_options, &option_index);
+        if (c == -1)
+        {   /* Out of cmd-line options */
+            break;
+        }
+
+        switch (c)
+        {
+            case 0:
+                /* If this option set a flag, do nothing else now. */
+                if (long_options[option_index].flag != 0)
+                    break;
+
+            case 'h':  /* help */
+                usage ();
+                return (ERROR);
+                break;
+
+            case 'i':  /* XML infile */
+                if (add_xml_file (valid, &nalloc, optarg) != SUCCESS)
+                    return (ERROR);
+                break;
+
+            case 'l':  /* list of XML infiles */
+                if (read_xml_list (valid, &nalloc, optarg) != SUCCESS)
+                    return (ERROR);
+                break;
+
+            case 't':  /* number of threads */
+                espa_task_pool_set_threads (atoi (optarg));
+                break;
+
+            case 'q':  /* only report the failures */
+                valid->quiet = true;
+                break;
+
+            case '?':
+            default:
+                sprintf (errmsg, "Unknown option %s", argv[optind-1]);
+                error_handler (true, FUNC_NAME, errmsg);
+                usage ();
+                return (ERROR);
+                break;
+        }
+    }
+
+    /* The remaining arguments are XML files */
+    for ( ; optind < argc; optind++)
+        if (add_xml_file (valid, &nalloc, argv[optind]) != SUCCESS)
+            return (ERROR);
+
+    /* Make sure the infiles were specified */
+    if (valid->nfiles == 0)
+    {
+        sprintf (errmsg, "At least one XML input file is required");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  record_error
+
+PURPOSE:  Structured error handler of the parser and validation contexts,
+keeping the first error of the file being validated and counting the rest.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. The trailing newline of the libxml2 message is dropped.
+******************************************************************************/
+static void record_error
+(
+    void *user_data,          /* I/O: result of the file being validated */
+    xmlErrorPtr error         /* I: error reported by libxml2 */
+)
+{
+    Valid_result_t *result = user_data;  /* result of the file */
+    size_t len;               /* length of the message */
+
+    if (error == NULL || error->level == XML_ERR_WARNING)
+        return;
+    if (result->nerrors++ > 0)
+        return;
+
+    result->line = error->line;
+    snprintf (result->message, sizeof (result->message), "%s",
+        error->message != NULL ? error->message : "unknown error");
+    len = strlen (result->message);
+    while (len > 0 && (result->message[len-1] == '\n' ||
+        result->message[len-1] == ' '))
+        result->message[--len] = '\0';
+}
+
+
+/******************************************************************************
+MODULE:  validate_file
+
+PURPOSE:  Validates one XML file of the list (an iteration of the parallel
+loop).
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error creating the contexts of the worker
+SUCCESS         The file was validated, whatever the outcome
+
+NOTES:
+  1. The contexts of the worker are created on its first file.
+******************************************************************************/
+static int validate_file
+(
+    void *arg,                /* I/O: validation being run */
+    int index,                /* I: index of the XML file */
+    int worker                /* I: index of the worker */
+)
+{
+    char FUNC_NAME[] = "validate_file";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    int status;               /* status of the validation */
+    Validate_t *valid = arg;  /* validation being run */
+    Valid_result_t *result = &valid->results[index];  /* result of the
+                                 file */
+    xmlDocPtr doc = NULL;     /* document tree of the file */
+
+    if (valid->parsers[worker] == NULL)
+        valid->parsers[worker] = xmlNewParserCtxt ();
+    if (valid->validators[worker] == NULL)
+        valid->validators[worker] = xmlSchemaNewValidCtxt (valid->schema);
+    if (valid->parsers[worker] == NULL || valid->validators[worker] == NULL)
+    {
+        sprintf (errmsg, "Creating the parser and validation contexts of "
+            "worker %d", worker);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Parse the file, keeping the parser errors rather than printing them */
+    xmlSetStructuredErrorFunc (result, (xmlStructuredErrorFunc) record_error);
+    doc = xmlCtxtReadFile (valid->parsers[worker], valid->xml_files[index],
+        NULL, XML_PARSE_NONET);
+    if (doc == NULL || !valid->parsers[worker]->wellFormed)
+    {
+        if (result->nerrors == 0)
+        {
+            result->nerrors = 1;
+            strcpy (result->message, "could not be read");
+        }
+        result->outcome = VALID_UNREADABLE;
+        xmlSetStructuredErrorFunc (NULL, NULL);
+        xmlFreeDoc (doc);
+        return (SUCCESS);
+    }
+    xmlSetStructuredErrorFunc (NULL, NULL);
+
+    /* Validate it against the schema */
+    xmlSchemaSetValidStructuredErrors (valid->validators[worker],
+        (xmlStructuredErrorFunc) record_error, result);
+    status = xmlSchemaValidateDoc (valid->validators[worker], doc);
+    xmlFreeDoc (doc);
+
+    if (status > 0)
+        result->outcome = VALID_INVALID;
+    else if (status != 0)
+    {
+        result->outcome = VALID_INTERNAL;
+        if (result->nerrors == 0)
+        {
+            result->nerrors = 1;
+            strcpy (result->message, "validation generated an internal "
+                "error");
+        }
+    }
+    else
+        result->outcome = VALID_OK;
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  report_file
+
+PURPOSE:  Reports the outcome of an XML file, in the order of the list.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+SUCCESS         Always
+
+NOTES:
+******************************************************************************/
+static int report_file
+(
+    void *arg,                /* I/O: validation being run */
+    int index,                /* I: index of the XML file */
+    int status                /* I: status of the iteration */
+)
+{
+    Validate_t *valid = arg;  /* validation being run */
+    Valid_result_t *result = &valid->results[index];  /* result of the
+                                 file */
+
+    if (status != SUCCESS)
+        return (SUCCESS);
+    valid->count[result->outcome]++;
+
+    if (result->outcome == VALID_OK)
+    {
+        if (!valid->quiet)
+            printf ("OK    %s\n", valid->xml_files[index]);
+        return (SUCCESS);
+    }
+
+    printf ("FAIL  %s", valid->xml_files[index]);
+    if (result->line > 0)
+        printf (":%d", result->line);
+    printf (": %s", result->message);
+    if (result->nerrors > 1)
+        printf (" (and %d more)", result->nerrors - 1);
+    printf ("\n");
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  compare_error_counts
+
+PURPOSE:  Orders the distinct errors by decreasing number of files.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+<0, 0, >0       a goes before, with, or after b
+******************************************************************************/
+static int compare_error_counts
+(
+    const void *a,            /* I: first distinct error */
+    const void *b             /* I: second distinct error */
+)
+{
+    const Error_count_t *ea = a;  /* first distinct error */
+    const Error_count_t *eb = b;  /* second distinct error */
+
+    if (ea->nfiles != eb->nfiles)
+        return (eb->nfiles - ea->nfiles);
+    return (strcmp (ea->message, eb->message));
+}
+
+
+/******************************************************************************
+MODULE:  write_summary
+
+PURPOSE:  Writes the number of files of each outcome and the most common
+first errors.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. The distinct errors are found with a linear scan for each failed file,
+     which is quick since a batch rarely fails in more than a few ways.
+******************************************************************************/
+static void write_summary
+(
+    Validate_t *valid         /* I: validation which was run */
+)
+{
+    Error_count_t *errors = NULL;  /* distinct first errors */
+    int nerrors = 0;          /* number of distinct first errors */
+    int nfailed;              /* number of files which failed */
+    int i, k;                 /* looping variables */
+
+    nfailed = valid->nfiles - valid->count[VALID_OK];
+    printf ("\n%d XML files: %d valid, %d failed (%d unreadable, %d invalid, "
+        "%d internal errors)\n", valid->nfiles, valid->count[VALID_OK],
+        nfailed, valid->count[VALID_UNREADABLE],
+        valid->count[VALID_INVALID], valid->count[VALID_INTERNAL]);
+    if (nfailed == 0)
+        return;
+
+    errors = calloc (nfailed, sizeof (Error_count_t));
+    if (errors == NULL)
+        return;
+    for (i = 0; i < valid->nfiles; i++)
+    {
+        if (valid->results[i].outcome == VALID_OK)
+            continue;
+        for (k = 0; k < nerrors; k++)
+            if (!strcmp (errors[k].message, valid->results[i].message))
+                break;
+        if (k == nerrors)
+            errors[nerrors++].message = valid->results[i].message;
+        errors[k].nfiles++;
+    }
+    qsort (errors, nerrors, sizeof (Error_count_t), compare_error_counts);
+
+    printf ("First errors of the failed files:\n");
+    for (k = 0; k < nerrors && k < VALIDATE_MAX_SUMMARY; k++)
+        printf ("  %8d  %s\n", errors[k].nfiles, errors[k].message);
+    if (nerrors > VALIDATE_MAX_SUMMARY)
+        printf ("  and %d other errors\n", nerrors - VALIDATE_MAX_SUMMARY);
+
+    free (errors);
+}
+
+
+/******************************************************************************
+MODULE:  main
+
+PURPOSE:  Validates the XML metadata files against the ESPA schema.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           An XML file failed or the validation couldn't be run
+SUCCESS         Every XML file validates
+******************************************************************************/
+int main (int argc, char** argv)
+{
+    char FUNC_NAME[] = "main";   /* function name */
+    char errmsg[STR_SIZE];       /* error message */
+    int nworkers;                /* number of workers of the loop */
+    int status = SUCCESS;        /* return status */
+    int i;                       /* looping variable */
+    Validate_t valid;            /* validation to be run */
+
+    /* Read the command-line arguments */
+    memset (&valid, 0, sizeof (valid));
+    if (get_args (argc, argv, &valid) != SUCCESS)
+    {   /* get_args already printed the error message */
+        exit (ERROR);
+    }
+
+    /* Compile the schema once, before the threads share it */
+    init_espa_xml ();
+    valid.schema = get_espa_schema ();
+    if (valid.schema == NULL)
+    {  /* Error messages already written */
+        exit (ERROR);
+    }
+
+    nworkers = espa_parallel_for_workers (valid.nfiles, 0);
+    valid.results = calloc (valid.nfiles, sizeof (Valid_result_t));
+    valid.parsers = calloc (nworkers, sizeof (xmlParserCtxtPtr));
+    valid.validators = calloc (nworkers, sizeof (xmlSchemaValidCtxtPtr));
+    if (valid.results == NULL || valid.parsers == NULL ||
+        valid.validators == NULL)
+    {
+        sprintf (errmsg, "Allocating memory for the validation");
+        error_handler (true, FUNC_NAME, errmsg);
+        exit (ERROR);
+    }
+
+    /* Validate the files in parallel, reporting them in order */
+    if (espa_parallel_for_ordered (valid.nfiles, nworkers, validate_file,
+        report_file, &valid) != SUCCESS)
+    {  /* Error messages already written */
+        status = ERROR;
+    }
+    write_summary (&valid);
+    if (valid.count[VALID_OK] != valid.nfiles)
+        status = ERROR;
+
+    for (i = 0; i < nworkers; i++)
+    {
+        if (valid.parsers[i] != NULL)
+            xmlFreeParserCtxt (valid.parsers[i]);
+        if (valid.validators[i] != NULL)
+            xmlSchemaFreeValidCtxt (valid.validators[i]);
+    }
+    shutdown_espa_xml ();
+
+    for (i = 0; i < valid.nfiles; i++)
+        free (valid.xml_files[i]);
+    free (valid.xml_files);
+    free (valid.results);
+    free (valid.parsers);
+    free (valid.validators);
+
+    exit (status);
+}
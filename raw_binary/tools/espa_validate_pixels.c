@@ -0,0 +1,450 @@
+/*****************************************************************************
+FILE: espa_validate_pixels
+
+PURPOSE: Contains functions for validating the pixels of the bands of an
+ESPA product, counting the fill, saturated, NaN, and out of range pixels of
+each band.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The XML metadata format parsed or written via this library follows the
+     ESPA internal metadata format found in ESPA Raw Binary Format v1.0.doc.
+     The schema for the ESPA internal metadata format is available at
+     http://espa.cr.usgs.gov/schema/espa_internal_metadata_vX_X.xsd.
+  2. Each band is streamed through its own band stack, so its blocks are
+     read ahead while the previous blocks are checked, and the bands are
+     validated in parallel by the task pool.  The pixels are counted as
+     described in raw_binary_validate.h.
+  3. With --use_stats, the integer bands whose statistics settle the counts
+     (see validate_raw_binary_stats) aren't read at all.  The statistics
+     don't tell the fill pixels from the saturated pixels, so those bands
+     report them together.
+  4. A band fails if it has NaN pixels or pixels outside of its valid_range.
+     The fill and saturated pixels are only reported.
+*****************************************************************************/
+#include <getopt.h>
+#include "parse_metadata.h"
+#include "espa_band_stack.h"
+#include "espa_task_pool.h"
+#include "raw_binary_validate.h"
+
+/* Validation of the bands shared by the workers */
+typedef struct
+{
+    Espa_internal_meta_t *xml_meta;  /* metadata with the bands */
+    int nbands;               /* number of bands to be validated */
+    int *band_index;          /* index in the metadata of each band */
+    Rb_validate_t *results;   /* validation of each band */
+    bool *from_stats;         /* were the counts found from the statistics
+                                 of the band? */
+    bool use_stats;           /* count from the statistics when possible? */
+    bool quiet;               /* only report the bands which fail? */
+    int nvalid;               /* number of bands which don't fail */
+    long counts[RB_VALID_NCOUNTS];  /* number of pixels of each kind in all
+                                 the bands */
+} Validate_pixels_t;
+
+/* Names of the kinds of pixels, as reported */
+static const char *count_names[RB_VALID_NCOUNTS] =
+    {"fill", "saturated", "NaN", "below range", "above range"};
+
+
+/******************************************************************************
+MODULE: usage
+
+PURPOSE: Prints the usage information for this application.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+void usage ()
+{
+    printf ("espa_validate_pixels validates the pixels of the bands of an "
+            "ESPA product, counting the pixels of each band equal to its "
+            "fill_value and saturate_value, the NaN pixels, and the pixels "
+            "outside of its valid_range.  The bands are read in parallel.\n");
+    printf ("version: %s\n\n", ESPA_COMMON_VERSION);
+    printf ("usage: espa_validate_pixels "
+            "--xml=input_metadata_filename "
+            "[--band=band_name (multiple --band options can be specified)] "
+            "[--threads=number_of_threads] [--use_stats] [--quiet]\n");
+
+    printf ("\nwhere the following parameters are required:\n");
+    printf ("    -xml: name of the input XML metadata file which follows "
+            "the ESPA internal raw binary schema\n");
+
+    printf ("\nwhere the following parameters are optional:\n");
+    printf ("    -band: name of a band to be validated (default is all the "
+            "bands)\n");
+    printf ("    -threads: number of threads validating the bands (default "
+            "is the cap of the task pool)\n");
+    printf ("    -use_stats: count the pixels of the integer bands from "
+            "their statistics in the XML, where the statistics settle the "
+            "counts, rather than reading the bands\n");
+    printf ("    -quiet: only report the bands which fail\n");
+    printf ("\nA band fails if it has NaN pixels or pixels outside of its "
+            "valid_range.  The exit status is 0 if no band fails.\n");
+
+    printf ("\nExample: espa_validate_pixels "
+            "--xml=LE07_L1TP_022033_20140228_20161028_01_T1.xml "
+            "--threads=8\n");
+}
+
+
+/******************************************************************************
+MODULE:  get_args
+
+PURPOSE:  Gets the command-line arguments and validates that the required
+arguments were specified.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error getting the command-line arguments or a command-line
+                argument and associated value were not specified
+SUCCESS         No errors encountered
+
+NOTES:
+  1. Memory is allocated for the input file and the band names.  These
+     should be freed by the caller.
+  2. The band list grows as needed and is to be freed with free_name_list;
+     an empty list validates all the bands.
+******************************************************************************/
+short get_args
+(
+    int argc,              /* I: number of cmd-line args */
+    char *argv[],          /* I: string of cmd-line args */
+    char **xml_infile,     /* O: address of input XML filename */
+    Espa_name_list_t *bands,  /* O: list of the bands to be validated */
+    Validate_pixels_t *valid  /* O: options of the validation */
+)
+{
+    int c;                           /* current argument index */
+    int option_index;                /* index for the command-line option */
+    char errmsg[STR_SIZE];           /* error message */
+    char FUNC_NAME[] = "get_args";   /* function name */
+    static struct option long_options[] =
+    {
+        {"xml", required_argument, 0, 'i'},
+        {"band", required_argument, 0, 'b'},
+        {"threads", required_argument, 0, 't'},
+        {"use_stats", no_argument, 0, 's'},
+        {"quiet", no_argument, 0, 'q'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    /* Loop through all the cmd-line options */
+    init_name_list (bands);
+    opterr = 0;   /* turn off getopt_long error msgs as we'll print our own */
+    while (1)
+    {
+        /* optstring in call to getopt_long is empty since we will only
+           support the long options */
+        c = getopt_long (argc, argv, "", long_options, &option_index);
+        if (c == -1)
+        {   /* Out of cmd-line options */
+            break;
+        }
+
+        switch (c)
+        {
+            case 0:
+                /* If this option set a flag, do nothing else now. */
+                if (long_options[option_index].flag != 0)
+                    break;
+
+            case 'h':  /* help */
+                usage ();
+                return (ERROR);
+                break;
+
+            case 'i':  /* XML infile */
+                free (*xml_infile);
+                *xml_infile = strdup (optarg);
+                break;
+
+            case 'b':  /* band */
+                if (add_name_to_list (bands, optarg) != SUCCESS)
+                {
+                    sprintf (errmsg, "Adding band %s", optarg);
+                    error_handler (true, FUNC_NAME, errmsg);
+                    return (ERROR);
+                }
+                break;
+
+            case 't':  /* number of threads */
+                espa_task_pool_set_threads (atoi (optarg));
+                break;
+
+            case 's':  /* count from the statistics */
+                valid->use_stats = true;
+                break;
+
+            case 'q':  /* only report the failures */
+                valid->quiet = true;
+                break;
+
+            case '?':
+            default:
+                sprintf (errmsg, "Unknown option %s", argv[optind-1]);
+                error_handler (true, FUNC_NAME, errmsg);
+                usage ();
+                return (ERROR);
+                break;
+        }
+    }
+
+    /* Make sure the infile was specified */
+    if (*xml_infile == NULL)
+    {
+        sprintf (errmsg, "XML input file is a required argument");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  validate_band
+
+PURPOSE:  Validates the pixels of one band (an iteration of the parallel
+loop).
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error reading the band
+SUCCESS         The band was validated, whatever the counts
+
+NOTES:
+  1. The statistics of the band aren't computed as it's read, since only
+     the counts are wanted.
+******************************************************************************/
+static int validate_band
+(
+    void *arg,                /* I/O: validation being run */
+    int index,                /* I: index of the band in the validation */
+    int worker                /* I: index of the worker (unused) */
+)
+{
+    char FUNC_NAME[] = "validate_band";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    int status = SUCCESS;     /* return status */
+    Validate_pixels_t *valid = arg;  /* validation being run */
+    Espa_band_meta_t *bmeta = &valid->xml_meta->band[valid->band_index[index]];
+                              /* metadata of the band */
+    Rb_validate_t *result = &valid->results[index];  /* validation of the
+                                 band */
+    Espa_band_stack_t *stack = NULL;  /* stack of the band */
+    Espa_band_block_t *block = NULL;  /* current block of the band */
+
+    init_raw_binary_validate (bmeta, result);
+    if (valid->use_stats && validate_raw_binary_stats (bmeta, result))
+    {
+        valid->from_stats[index] = true;
+        return (SUCCESS);
+    }
+
+    stack = open_band_stack (valid->xml_meta, 1, &valid->band_index[index],
+        RB_PREFETCH_DEFAULT_LINES, 0);
+    if (stack == NULL)
+    {
+        sprintf (errmsg, "Opening the band %s", bmeta->name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    skip_band_stack_stats (stack);
+
+    while (1)
+    {
+        if (get_band_stack_block (stack, &block) != SUCCESS)
+        {
+            sprintf (errmsg, "Reading the band %s", bmeta->name);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+            break;
+        }
+        if (block == NULL)
+            break;
+
+        /* Full width blocks of lines are contiguous */
+        update_raw_binary_validate (result, block->band_buf[0],
+            (size_t) block->nlines * block->nsamps);
+    }
+
+    close_band_stack (stack);
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  report_band
+
+PURPOSE:  Reports the counts of a band, in the order of the bands.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+SUCCESS         Always
+
+NOTES:
+******************************************************************************/
+static int report_band
+(
+    void *arg,                /* I/O: validation being run */
+    int index,                /* I: index of the band in the validation */
+    int status                /* I: status of the iteration */
+)
+{
+    Validate_pixels_t *valid = arg;  /* validation being run */
+    Rb_validate_t *result = &valid->results[index];  /* validation of the
+                                 band */
+    const char *name = valid->xml_meta->band[valid->band_index[index]].name;
+                              /* name of the band */
+    bool failed;              /* does the band fail? */
+    int k;                    /* looping variable for the kinds of pixels */
+
+    if (status != SUCCESS)
+    {
+        printf ("FAIL  %s: could not be read\n", name);
+        return (SUCCESS);
+    }
+
+    for (k = 0; k < RB_VALID_NCOUNTS; k++)
+        valid->counts[k] += result->counts[k];
+    failed = result->counts[RB_VALID_NAN] > 0 ||
+        result->counts[RB_VALID_BELOW] > 0 ||
+        result->counts[RB_VALID_ABOVE] > 0;
+    if (!failed)
+    {
+        valid->nvalid++;
+        if (valid->quiet)
+            return (SUCCESS);
+    }
+
+    printf ("%-5s %s: %ld pixels", failed ? "FAIL" : "OK", name,
+        result->npixels);
+    if (valid->from_stats[index])
+        printf (", %ld fill or saturated, %ld below range, %ld above range "
+            "(from the statistics)\n", result->counts[RB_VALID_FILL],
+            result->counts[RB_VALID_BELOW], result->counts[RB_VALID_ABOVE]);
+    else
+    {
+        for (k = 0; k < RB_VALID_NCOUNTS; k++)
+            printf (", %ld %s", result->counts[k], count_names[k]);
+        printf ("\n");
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  main
+
+PURPOSE:  Validates the pixels of the bands of an ESPA product.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           A band failed or the validation couldn't be run
+SUCCESS         No band failed
+******************************************************************************/
+int main (int argc, char** argv)
+{
+    char FUNC_NAME[] = "main";   /* function name */
+    char errmsg[STR_SIZE];       /* error message */
+    char *xml_infile = NULL;     /* input XML filename */
+    Espa_name_list_t bands;      /* names of the bands; empty for all the
+                                    bands */
+    int status = SUCCESS;        /* return status */
+    int i, k;                    /* looping variables */
+    Espa_internal_meta_t xml_metadata;  /* XML metadata structure */
+    Validate_pixels_t valid;     /* validation to be run */
+
+    /* Read the command-line arguments */
+    memset (&valid, 0, sizeof (valid));
+    if (get_args (argc, argv, &xml_infile, &bands, &valid) != SUCCESS)
+    {   /* get_args already printed the error message */
+        exit (ERROR);
+    }
+
+    /* Validate the input metadata file and parse it */
+    init_metadata_struct (&xml_metadata);
+    if (validate_and_parse_metadata (xml_infile, &xml_metadata) != SUCCESS)
+    {  /* Error messages already written */
+        exit (ERROR);
+    }
+    valid.xml_meta = &xml_metadata;
+
+    /* Find the bands to be validated */
+    valid.nbands = bands.nnames ? bands.nnames : xml_metadata.nbands;
+    valid.band_index = calloc (valid.nbands, sizeof (int));
+    valid.results = calloc (valid.nbands, sizeof (Rb_validate_t));
+    valid.from_stats = calloc (valid.nbands, sizeof (bool));
+    if (valid.band_index == NULL || valid.results == NULL ||
+        valid.from_stats == NULL)
+    {
+        sprintf (errmsg, "Allocating memory for the validation");
+        error_handler (true, FUNC_NAME, errmsg);
+        exit (ERROR);
+    }
+    for (i = 0; i < valid.nbands; i++)
+    {
+        if (bands.nnames == 0)
+        {
+            valid.band_index[i] = i;
+            continue;
+        }
+        k = espa_find_band (&xml_metadata, bands.names[i]);
+        if (k < 0)
+        {
+            sprintf (errmsg, "Band %s is not in %s", bands.names[i],
+                xml_infile);
+            error_handler (true, FUNC_NAME, errmsg);
+            exit (ERROR);
+        }
+        valid.band_index[i] = k;
+    }
+
+    /* Validate the bands in parallel, reporting them in order */
+    if (espa_parallel_for_ordered (valid.nbands,
+        espa_parallel_for_workers (valid.nbands, 0), validate_band,
+        report_band, &valid) != SUCCESS)
+    {  /* Error messages already written */
+        status = ERROR;
+    }
+
+    printf ("\n%d bands: %d valid, %d failed\n", valid.nbands,
+        valid.nvalid, valid.nbands - valid.nvalid);
+    printf ("Pixels of all the bands:");
+    for (k = 0; k < RB_VALID_NCOUNTS; k++)
+        printf ("%s %ld %s", k ? "," : "", valid.counts[k], count_names[k]);
+    printf ("\n");
+    if (valid.nvalid != valid.nbands)
+        status = ERROR;
+
+    /* Free the metadata structure and the arguments */
+    free_metadata (&xml_metadata);
+    free (xml_infile);
+    free_name_list (&bands);
+    free (valid.band_index);
+    free (valid.results);
+    free (valid.from_stats);
+
+    exit (status);
+}
@@ -0,0 +1,441 @@
+/*****************************************************************************
+FILE: espa_warp
+
+PURPOSE: Contains functions for warping an ESPA product to another
+projection, writing the resampled bands along with the updated XML file.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The XML metadata format parsed or written via this library follows the
+     ESPA internal metadata format found in ESPA Raw Binary Format v1.0.doc.
+     The schema for the ESPA internal metadata format is available at
+     http://espa.cr.usgs.gov/schema/espa_internal_metadata_v1_0.xsd.
+*****************************************************************************/
+#include <getopt.h>
+#include "espa_warp.h"
+#include "espa_mpi.h"
+
+/******************************************************************************
+MODULE: usage
+
+PURPOSE: Prints the usage information for this application.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+void usage ()
+{
+    printf ("espa_warp warps the bands of the input product to another "
+            "projection and creates a new XML metadata file and raw binary "
+            "band files for the warped product.\n");
+    printf ("version: %s\n\n", ESPA_COMMON_VERSION);
+    printf ("usage: espa_warp "
+            "--xml=input_metadata_filename "
+            "--warp_xml=output_warp_metadata_filename "
+            "[--proj=geo|utm|ps|albers|sin] [projection parameters] "
+            "[--datum=wgs84|nad83|nad27] [--pixel_size=size] "
+            "[--resample=nn|bi|cc] [--max_error=pixels] "
+            "[--ulx=x --uly=y --lrx=x --lry=y]\n");
+
+    printf ("\nwhere the following parameters are required:\n");
+    printf ("    -xml: name of the input XML metadata file which follows "
+            "the ESPA internal raw binary schema\n");
+    printf ("    -warp_xml: name of the output XML metadata file.  The "
+            "output bands are named after it, <base>_<band name>.img\n");
+
+    printf ("\nand the following parameters are optional:\n");
+    printf ("    -proj: target projection (default is the input projection, "
+            "which only resamples the product)\n");
+    printf ("    -zone: UTM zone, negative for the southern hemisphere "
+            "(utm)\n");
+    printf ("    -longitude_pole, -latitude_true_scale: longitude of the "
+            "pole and latitude of true scale in degrees (ps)\n");
+    printf ("    -standard_parallel1, -standard_parallel2, "
+            "-central_meridian, -origin_latitude: in degrees (albers)\n");
+    printf ("    -central_meridian, -sphere_radius: in degrees and meters "
+            "(sin)\n");
+    printf ("    -false_easting, -false_northing: in meters (ps, albers, "
+            "sin)\n");
+    printf ("    -datum: datum of the target projection (default is the "
+            "input datum)\n");
+    printf ("    -pixel_size: pixel size of the reference band (band1 for "
+            "Landsat, B02 for Sentinel-2, otherwise the first band) in the "
+            "target units.  The other bands keep their ratio to it.  "
+            "Required between geographic and projected coordinates, "
+            "otherwise the default is the input pixel size.\n");
+    printf ("    -resample: resampling of all the bands: nearest neighbor, "
+            "bilinear, or cubic convolution (default is the resampling "
+            "method of each band, or nearest neighbor)\n");
+    printf ("    -max_error: largest error, in input pixels, of the "
+            "interpolated mapping to the input; 0 transforms every pixel "
+            "exactly (default is %g)\n", WARP_DEFAULT_MAX_ERROR);
+    printf ("    -ulx, -uly, -lrx, -lry: target projection coordinates of "
+            "the UL and LR edges of the output (default covers the "
+            "input)\n");
+    printf ("\nThe extent is widened as needed to whole pixels of the "
+            "coarsest band.\n");
+    printf ("\nExample: espa_warp "
+            "--xml=LE07_L1TP_022033_20140228_20161028_02_T1.xml "
+            "--warp_xml=LE07_L1TP_022033_20140228_20161028_02_T1_albers.xml "
+            "--proj=albers --standard_parallel1=29.5 "
+            "--standard_parallel2=45.5 --central_meridian=-96.0 "
+            "--origin_latitude=23.0 --false_easting=0 --false_northing=0 "
+            "--datum=wgs84 --pixel_size=30 --resample=cc\n");
+    printf ("\nExample: espa_warp "
+            "--xml=LE07_L1TP_022033_20140228_20161028_02_T1.xml "
+            "--warp_xml=LE07_L1TP_022033_20140228_20161028_02_T1_geo.xml "
+            "--proj=geo --pixel_size=0.00025\n");
+    printf ("\nBuilt with MPI, a large product can be warped across the "
+            "ranks of an MPI job, which split the lines of each output "
+            "band and need a shared file system: mpirun -n 8 espa_warp "
+            "...\n");
+}
+
+
+/******************************************************************************
+MODULE:  get_args
+
+PURPOSE:  Gets the command-line arguments and validates that the required
+arguments were specified.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error getting the command-line arguments or a command-line
+                argument and associated value were not specified
+SUCCESS         No errors encountered
+
+NOTES:
+  1. Memory is allocated for the input and output files.  All of these should
+     be character pointers set to NULL on input.  The caller is responsible
+     for freeing the allocated memory upon successful return.
+******************************************************************************/
+short get_args
+(
+    int argc,             /* I: number of cmd-line args */
+    char *argv[],         /* I: string of cmd-line args */
+    char **xml_infile,    /* O: address of input XML filename */
+    char **xml_warp_outfile,  /* O: address of output warp XML filename */
+    Espa_warp_options_t *options  /* O: options of the warp */
+)
+{
+    int c;                           /* current argument index */
+    int option_index;                /* index for the command-line option */
+    int nextent_opts = 0;            /* number of extent options */
+    char errmsg[STR_SIZE];           /* error message */
+    char FUNC_NAME[] = "get_args";   /* function name */
+    Espa_proj_meta_t *proj = &options->proj_info;  /* target projection */
+    static struct option long_options[] =
+    {
+        {"xml", required_argument, 0, 'i'},
+        {"warp_xml", required_argument, 0, 'o'},
+        {"proj", required_argument, 0, 'p'},
+        {"zone", required_argument, 0, 'z'},
+        {"datum", required_argument, 0, 'd'},
+        {"longitude_pole", required_argument, 0, 'P'},
+        {"latitude_true_scale", required_argument, 0, 'T'},
+        {"false_easting", required_argument, 0, 'e'},
+        {"false_northing", required_argument, 0, 'n'},
+        {"standard_parallel1", required_argument, 0, '1'},
+        {"standard_parallel2", required_argument, 0, '2'},
+        {"central_meridian", required_argument, 0, 'm'},
+        {"origin_latitude", required_argument, 0, 'O'},
+        {"sphere_radius", required_argument, 0, 'r'},
+        {"pixel_size", required_argument, 0, 's'},
+        {"resample", required_argument, 0, 'R'},
+        {"max_error", required_argument, 0, 'E'},
+        {"ulx", required_argument, 0, 'x'},
+        {"uly", required_argument, 0, 'y'},
+        {"lrx", required_argument, 0, 'X'},
+        {"lry", required_argument, 0, 'Y'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    /* Loop through all the cmd-line options */
+    init_espa_warp_options (options);
+    opterr = 0;   /* turn off getopt_long error msgs as we'll print our own */
+    while (1)
+    {
+        /* optstring in call to getopt_long is empty since we will only
+           support the long options */
+        c = getopt_long (argc, argv, "", long_options, &option_index);
+        if (c == -1)
+        {   /* Out of cmd-line options */
+            break;
+        }
+
+        switch (c)
+        {
+            case 0:
+                /* If this option set a flag, do nothing else now. */
+                if (long_options[option_index].flag != 0)
+                    break;
+
+            case 'h':  /* help */
+                usage ();
+                return (ERROR);
+                break;
+
+            case 'i':  /* XML infile */
+                *xml_infile = strdup (optarg);
+                break;
+
+            case 'o':  /* XML warp outfile */
+                *xml_warp_outfile = strdup (optarg);
+                break;
+
+            case 'p':  /* target projection */
+                if (!strcasecmp (optarg, "geo"))
+                    proj->proj_type = GCTP_GEO_PROJ;
+                else if (!strcasecmp (optarg, "utm"))
+                    proj->proj_type = GCTP_UTM_PROJ;
+                else if (!strcasecmp (optarg, "ps"))
+                    proj->proj_type = GCTP_PS_PROJ;
+                else if (!strcasecmp (optarg, "albers"))
+                    proj->proj_type = GCTP_ALBERS_PROJ;
+                else if (!strcasecmp (optarg, "sin"))
+                    proj->proj_type = GCTP_SIN_PROJ;
+                else
+                {
+                    sprintf (errmsg, "Unsupported projection %s", optarg);
+                    error_handler (true, FUNC_NAME, errmsg);
+                    usage ();
+                    return (ERROR);
+                }
+                break;
+
+            case 'z':  /* UTM zone */
+                proj->utm_zone = atoi (optarg);
+                break;
+
+            case 'd':  /* datum */
+                if (!strcasecmp (optarg, "wgs84"))
+                    proj->datum_type = ESPA_WGS84;
+                else if (!strcasecmp (optarg, "nad83"))
+                    proj->datum_type = ESPA_NAD83;
+                else if (!strcasecmp (optarg, "nad27"))
+                    proj->datum_type = ESPA_NAD27;
+                else
+                {
+                    sprintf (errmsg, "Unsupported datum %s", optarg);
+                    error_handler (true, FUNC_NAME, errmsg);
+                    usage ();
+                    return (ERROR);
+                }
+                break;
+
+            case 'P':  /* longitude of the pole */
+                proj->longitude_pole = atof (optarg);
+                break;
+
+            case 'T':  /* latitude of true scale */
+                proj->latitude_true_scale = atof (optarg);
+                break;
+
+            case 'e':  /* false easting */
+                proj->false_easting = atof (optarg);
+                break;
+
+            case 'n':  /* false northing */
+                proj->false_northing = atof (optarg);
+                break;
+
+            case '1':  /* first standard parallel */
+                proj->standard_parallel1 = atof (optarg);
+                break;
+
+            case '2':  /* second standard parallel */
+                proj->standard_parallel2 = atof (optarg);
+                break;
+
+            case 'm':  /* central meridian */
+                proj->central_meridian = atof (optarg);
+                break;
+
+            case 'O':  /* latitude of the origin */
+                proj->origin_latitude = atof (optarg);
+                break;
+
+            case 'r':  /* sphere radius */
+                proj->sphere_radius = atof (optarg);
+                break;
+
+            case 's':  /* pixel size of the reference band */
+                options->pixel_size[0] = options->pixel_size[1] =
+                    atof (optarg);
+                break;
+
+            case 'R':  /* resampling of all the bands */
+                if (!strcasecmp (optarg, "nn"))
+                    options->resample = ESPA_NN;
+                else if (!strcasecmp (optarg, "bi"))
+                    options->resample = ESPA_BI;
+                else if (!strcasecmp (optarg, "cc"))
+                    options->resample = ESPA_CC;
+                else
+                {
+                    sprintf (errmsg, "Unsupported resampling %s", optarg);
+                    error_handler (true, FUNC_NAME, errmsg);
+                    usage ();
+                    return (ERROR);
+                }
+                break;
+
+            case 'E':  /* largest interpolation error */
+                options->max_error = atof (optarg);
+                break;
+
+            case 'x':  /* left edge of the output */
+                options->ulx = atof (optarg);
+                nextent_opts++;
+                break;
+
+            case 'y':  /* top edge of the output */
+                options->uly = atof (optarg);
+                nextent_opts++;
+                break;
+
+            case 'X':  /* right edge of the output */
+                options->lrx = atof (optarg);
+                nextent_opts++;
+                break;
+
+            case 'Y':  /* bottom edge of the output */
+                options->lry = atof (optarg);
+                nextent_opts++;
+                break;
+
+            case '?':
+            default:
+                sprintf (errmsg, "Unknown option %s", argv[optind-1]);
+                error_handler (true, FUNC_NAME, errmsg);
+                usage ();
+                return (ERROR);
+                break;
+        }
+    }
+
+    /* Make sure the infiles and outfiles were specified */
+    if (*xml_infile == NULL)
+    {
+        sprintf (errmsg, "XML input file is a required argument");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    if (*xml_warp_outfile == NULL)
+    {
+        sprintf (errmsg, "XML warp output file is a required argument");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    /* The projection parameters only go with a projection */
+    if (proj->proj_type == ESPA_INT_META_FILL && (proj->utm_zone != 0 ||
+        proj->longitude_pole != 0.0 || proj->latitude_true_scale != 0.0 ||
+        proj->false_easting != 0.0 || proj->false_northing != 0.0 ||
+        proj->standard_parallel1 != 0.0 || proj->standard_parallel2 != 0.0 ||
+        proj->central_meridian != 0.0 || proj->origin_latitude != 0.0 ||
+        proj->sphere_radius != 0.0))
+    {
+        sprintf (errmsg, "Projection parameters need --proj");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    if (proj->proj_type == GCTP_UTM_PROJ && proj->utm_zone == 0)
+    {
+        sprintf (errmsg, "The UTM projection needs --zone");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    if (proj->proj_type == GCTP_SIN_PROJ && proj->sphere_radius <= 0.0)
+    {
+        sprintf (errmsg, "The sinusoidal projection needs --sphere_radius");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    /* Make sure the extent is complete if given */
+    if (nextent_opts != 0 && nextent_opts != 4)
+    {
+        sprintf (errmsg, "The extent needs to be given by all of --ulx, "
+            "--uly, --lrx, and --lry");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+    options->extent_set = nextent_opts == 4;
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  main
+
+PURPOSE:  Warps the bands of the input product to the target projection and
+writes the output bands and XML metadata file.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error doing the warping
+SUCCESS         No errors encountered
+
+NOTES:
+  1. Under MPI, every rank runs main; the arguments are the same on every
+     rank, so they all agree on whether they are valid.
+******************************************************************************/
+int main (int argc, char** argv)
+{
+    char *xml_infile = NULL;          /* input XML filename */
+    char *xml_warp_outfile = NULL;    /* output warp XML filename */
+    Espa_warp_options_t options;      /* options of the warp */
+
+    if (espa_mpi_init (&argc, &argv) != SUCCESS)
+    {   /* Error messages already written */
+        exit (EXIT_FAILURE);
+    }
+    if (espa_mpi_rank () == ESPA_MPI_ROOT)
+        printf ("espa_warp version: %s\n", ESPA_COMMON_VERSION);
+
+    /* Read the command-line arguments */
+    if (get_args (argc, argv, &xml_infile, &xml_warp_outfile, &options) !=
+        SUCCESS)
+    {   /* get_args already printed the error message */
+        espa_mpi_finalize ();
+        exit (EXIT_FAILURE);
+    }
+
+    /* Warp the input product and write the output product */
+    if (warp_espa_product (xml_infile, xml_warp_outfile, &options) !=
+        SUCCESS)
+    {  /* Error messages already written */
+        espa_mpi_finalize ();
+        exit (EXIT_FAILURE);
+    }
+
+    /* Free the pointers */
+    free (xml_infile);
+    free (xml_warp_outfile);
+
+    /* Successful completion */
+    espa_mpi_finalize ();
+    exit (EXIT_SUCCESS);
+}
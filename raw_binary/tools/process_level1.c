@@ -0,0 +1,934 @@
+/*****************************************************************************
+FILE: process_level1
+
+PURPOSE: Runs the Level-1 preprocessing of an LPGS product in a single
+process: the conversion to the ESPA internal raw binary format, the band
+misalignment clipping, the date bands, the land/water mask, the TOA bands,
+and the BIP product.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. Each step is the library function behind the separate application
+     (convert_lpgs_to_espa, clip_band_misalignment, create_date_bands,
+     create_land_water_mask, and convert_espa_to_bip).  The steps share the
+     metadata in memory, so it is built once from the MTL file and the ESPA
+     XML file is written once, rather than being parsed and rewritten by each
+     application.
+  2. The clipping, the TOA bands, and the BIP product share one traversal of
+     the bands (see process_level1_bands), so the Level-1 bands are read once
+     rather than once per step.
+*****************************************************************************/
+#include <getopt.h>
+#include <time.h>
+
+#include "convert_lpgs_to_espa.h"
+#include "convert_espa_to_raw_binary_bip.h"
+#include "clip_band_misalignment.h"
+#include "generate_date_bands.h"
+#include "generate_land_water_mask.h"
+#include "generate_toa_bands.h"
+#include "espa_trace.h"
+#include "espa_task_pool.h"
+#include "raw_binary_cache.h"
+
+/******************************************************************************
+MODULE: usage
+
+PURPOSE: Prints the usage information for this application.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+void usage ()
+{
+    printf ("process_level1 converts the LPGS products (MTL file and "
+            "associated GeoTIFF files) to the ESPA internal format and runs "
+            "the requested Level-1 preprocessing steps on them, in a single "
+            "process.\n");
+    printf ("version: %s\n\n", ESPA_COMMON_VERSION);
+    printf ("usage: process_level1 "
+            "--mtl=input_mtl_filename "
+            "[--clip] [--date_bands] [--constant_date_bands] "
+            "[--land_water_mask] [--toa=rad,refl,bt] [--toa_float] "
+            "[--bip=output_bip_filename] [--convert_qa] "
+            "[--del_src_files] [--threads=number_of_threads] "
+            "[--cache_mb=megabytes] [--memory_mb=megabytes]\n");
+
+    printf ("\nwhere the following parameters are required:\n");
+    printf ("    -mtl: name of the input LPGS MTL metadata file\n");
+    printf ("\nwhere the following parameters are optional:\n");
+    printf ("    -clip: clip the band misalignment, as in "
+            "clip_band_misalignment\n");
+    printf ("    -date_bands: create the date bands, as in "
+            "create_date_bands\n");
+    printf ("    -constant_date_bands: leave the date bands as constant "
+            "bands in the XML file rather than writing out their pixels, as "
+            "in create_date_bands --constant\n");
+    printf ("    -land_water_mask: create the land/water mask, as in "
+            "create_land_water_mask.  The ESPA_LAND_MASS_POLYGON environment "
+            "variable needs to be defined, and the ESPA_LAND_WATER_MASK_CACHE "
+            "environment variable may name a directory caching the masks by "
+            "grid.\n");
+    printf ("    -toa: comma-separated list of the top-of-atmosphere bands "
+            "to create from the calibration of the Level-1 bands: rad "
+            "(radiance), refl (reflectance), and bt (brightness "
+            "temperature)\n");
+    printf ("    -toa_float: write the TOA bands as FLOAT32 rather than "
+            "scaled INT16\n");
+    printf ("    -bip: filename of the output raw binary BIP file, written "
+            "as in convert_espa_to_bip\n");
+    printf ("    -convert_qa: should the QA bands (UINT8) be converted to the "
+            "data type of the first band in the BIP file\n");
+    printf ("    -del_src_files: if specified the source GeoTIFF files will "
+            "be removed, and with -bip the ESPA image, header, and XML "
+            "files will be removed once the BIP file is written\n");
+    printf ("    -threads: number of threads clipping the lines of the "
+            "bands, when built with ENABLE_THREADING (default is "
+            "ESPA_THREADS, or one per processor)\n");
+    printf ("    -cache_mb: megabytes of memory for caching the bands "
+            "between the steps, so the later steps don't read them from "
+            "disk again (default is ESPA_BAND_CACHE_MB, or no cache)\n");
+    printf ("    -memory_mb: memory budget of the job in megabytes; the "
+            "blocks, caches, and threads are sized to fit in it (default is "
+            "ESPA_MEM_BUDGET_MB, or no budget)\n");
+    printf ("\nExample: process_level1 "
+            "--mtl=LC08_L1TP_047027_20131014_20170308_02_T1_MTL.txt --clip "
+            "--date_bands --land_water_mask\n");
+}
+
+
+/******************************************************************************
+MODULE:  get_args
+
+PURPOSE:  Gets the command-line arguments and validates that the required
+arguments were specified.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error getting the command-line arguments or a command-line
+                argument and associated value were not specified
+SUCCESS         No errors encountered
+
+NOTES:
+  1. Memory is allocated for the input and output files.  All of these should
+     be character pointers set to NULL on input.  The caller is responsible
+     for freeing the allocated memory upon successful return.
+  2. The XML filename is generated from the MTL filename, as in
+     convert_lpgs_to_espa.
+******************************************************************************/
+short get_args
+(
+    int argc,             /* I: number of cmd-line args */
+    char *argv[],         /* I: string of cmd-line args */
+    char **mtl_infile,    /* O: address of input LPGS MTL filename */
+    char **xml_outfile,   /* O: address of output XML filename */
+    char **bip_outfile,   /* O: address of output BIP filename; NULL if no
+                                BIP file is requested */
+    bool *clip,           /* O: should the band misalignment be clipped? */
+    bool *date_bands,     /* O: should the date bands be created? */
+    bool *constant,       /* O: should the date bands be left as constant
+                                bands? */
+    bool *land_water_mask,/* O: should the land/water mask be created? */
+    int *toa_products,    /* O: TOA_* bands to be created; 0 for none */
+    bool *toa_float,      /* O: should the TOA bands be FLOAT32? */
+    bool *convert_qa,     /* O: should the QA bands be converted? */
+    bool *del_src         /* O: should source files be removed? */
+)
+{
+    int c;                           /* current argument index */
+    int option_index;                /* index for the command-line option */
+    int nthreads;                    /* number of threads */
+    int cache_mb = -1;               /* memory budget of the band cache;
+                                        -1 if not given */
+    int memory_mb;                   /* memory budget of the job */
+    char *cptr = NULL;               /* pointer to _MTL.txt in MTL filename */
+    char errmsg[STR_SIZE];           /* error message */
+    char FUNC_NAME[] = "get_args";   /* function name */
+    static int clip_flag = 0;        /* flag for clipping the bands */
+    static int date_flag = 0;        /* flag for creating the date bands */
+    static int constant_flag = 0;    /* flag for constant date bands */
+    static int mask_flag = 0;        /* flag for the land/water mask */
+    static int toa_float_flag = 0;   /* flag for FLOAT32 TOA bands */
+    static int convert_flag = 0;     /* flag for converting QA data */
+    static int del_flag = 0;         /* flag for removing the source files */
+    static struct option long_options[] =
+    {
+        {"clip", no_argument, &clip_flag, 1},
+        {"date_bands", no_argument, &date_flag, 1},
+        {"constant_date_bands", no_argument, &constant_flag, 1},
+        {"land_water_mask", no_argument, &mask_flag, 1},
+        {"toa_float", no_argument, &toa_float_flag, 1},
+        {"convert_qa", no_argument, &convert_flag, 1},
+        {"del_src_files", no_argument, &del_flag, 1},
+        {"mtl", required_argument, 0, 'i'},
+        {"bip", required_argument, 0, 'o'},
+        {"toa", required_argument, 0, 'r'},
+        {"threads", required_argument, 0, 't'},
+        {"cache_mb", required_argument, 0, 'm'},
+        {"memory_mb", required_argument, 0, 'b'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    /* Loop through all the cmd-line options */
+    opterr = 0;   /* turn off getopt_long error msgs as we'll print our own */
+    while (1)
+    {
+        /* optstring in call to getopt_long is empty since we will only
+           support the long options */
+        c = getopt_long (argc, argv, "", long_options, &option_index);
+        if (c == -1)
+        {   /* Out of cmd-line options */
+            break;
+        }
+
+        switch (c)
+        {
+            case 0:
+                /* If this option set a flag, do nothing else now. */
+                if (long_options[option_index].flag != 0)
+                    break;
+
+            case 'h':  /* help */
+                usage ();
+                return (ERROR);
+                break;
+
+            case 'i':  /* LPGS MTL infile */
+                *mtl_infile = strdup (optarg);
+                break;
+
+            case 'o':  /* BIP outfile */
+                *bip_outfile = strdup (optarg);
+                break;
+
+            case 'r':  /* TOA bands */
+                if (parse_toa_products (optarg, toa_products) != SUCCESS)
+                {
+                    usage ();
+                    return (ERROR);
+                }
+                break;
+
+            case 't':  /* number of threads of the task pool */
+                nthreads = atoi (optarg);
+                if (nthreads < 1)
+                {
+                    sprintf (errmsg, "Invalid number of threads: %s", optarg);
+                    error_handler (true, FUNC_NAME, errmsg);
+                    usage ();
+                    return (ERROR);
+                }
+#ifdef _OPENMP
+                espa_task_pool_set_threads (nthreads);
+#else
+                if (nthreads > 1)
+                    error_handler (false, FUNC_NAME, "Threading is not "
+                        "enabled in this build; a single thread will be "
+                        "used");
+#endif
+                break;
+
+            case 'm':  /* memory budget of the band cache (MB) */
+                cache_mb = atoi (optarg);
+                if (cache_mb < 0)
+                {
+                    sprintf (errmsg, "Invalid band cache size: %s", optarg);
+                    error_handler (true, FUNC_NAME, errmsg);
+                    usage ();
+                    return (ERROR);
+                }
+                break;
+
+            case 'b':  /* memory budget of the job (MB) */
+                memory_mb = atoi (optarg);
+                if (memory_mb < 1)
+                {
+                    sprintf (errmsg, "Invalid memory budget: %s", optarg);
+                    error_handler (true, FUNC_NAME, errmsg);
+                    usage ();
+                    return (ERROR);
+                }
+                espa_mem_set_budget_mb (memory_mb);
+                break;
+
+            case '?':
+            default:
+                sprintf (errmsg, "Unknown option %s", argv[optind-1]);
+                error_handler (true, FUNC_NAME, errmsg);
+                usage ();
+                return (ERROR);
+                break;
+        }
+    }
+
+    /* Size the band cache once the memory budget is known, since the cache
+       is capped at its share of the budget */
+    if (cache_mb >= 0)
+        set_raw_binary_cache_mb (cache_mb);
+
+    /* Make sure the input MTL file was specified */
+    if (*mtl_infile == NULL)
+    {
+        sprintf (errmsg, "LPGS MTL input file is a required argument");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    /* Generate the XML filename from the MTL filename.  Find the _MTL.txt and
+       change that to .xml. */
+    *xml_outfile = malloc (strlen (*mtl_infile) + 5);
+    if (*xml_outfile == NULL)
+    {
+        sprintf (errmsg, "XML output file was not correctly generated");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    strcpy (*xml_outfile, *mtl_infile);
+    cptr = strrchr (*xml_outfile, '_');
+    if (cptr == NULL)
+    {
+        sprintf (errmsg, "Unable to find the _MTL.txt in the MTL filename: %s",
+            *mtl_infile);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    strcpy (cptr, ".xml");
+
+    /* Check the flags */
+    *clip = clip_flag;
+    *date_bands = date_flag || constant_flag;
+    *constant = constant_flag;
+    *land_water_mask = mask_flag;
+    *toa_float = toa_float_flag;
+    *convert_qa = convert_flag;
+    *del_src = del_flag;
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  find_band1
+
+PURPOSE: Finds band 1, the representative band of the date bands and the
+land/water mask, in the metadata.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+-1              Band 1 wasn't found
+0 or more       Index of band 1 in the metadata
+
+NOTES:
+  1. The index is returned rather than a pointer, since the band array moves
+     as bands are appended to the metadata.
+******************************************************************************/
+int find_band1
+(
+    Espa_internal_meta_t *xml_metadata  /* I: XML metadata structure */
+)
+{
+    char FUNC_NAME[] = "find_band1";  /* function name */
+    char errmsg[STR_SIZE];            /* error message */
+    int band;                         /* index of band 1 */
+
+    band = espa_find_band (xml_metadata, "b1");
+    if (band >= 0)
+        return (band);
+
+    sprintf (errmsg, "Band 1 (b1) was not found in the XML metadata");
+    error_handler (true, FUNC_NAME, errmsg);
+    return (-1);
+}
+
+
+/******************************************************************************
+MODULE:  add_stack_band
+
+PURPOSE: Finds a band in the bands of the shared band stack, adding it if it
+isn't there yet.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+n               Position of the band in the stack
+******************************************************************************/
+int add_stack_band
+(
+    int *stack_index,     /* I/O: metadata index of each band in the stack */
+    int *nstack,          /* I/O: number of bands in the stack */
+    int band              /* I: metadata index of the band */
+)
+{
+    int i;                /* looping variable for the bands in the stack */
+
+    for (i = 0; i < *nstack; i++)
+        if (stack_index[i] == band)
+            return (i);
+
+    stack_index[*nstack] = band;
+    return ((*nstack)++);
+}
+
+
+/******************************************************************************
+MODULE:  process_level1_bands
+
+PURPOSE: Clips the band misalignment, writes the TOA bands, and converts the
+bands to BIP in a single traversal of the bands, so each Level-1 band is read
+once for all the steps.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error processing the bands
+SUCCESS         Successfully processed the bands
+
+NOTES:
+  1. One band stack holds every band read by any of the steps.  Each block
+     is handed to the clipping (see open_clip_stage), which clips it in
+     place, then to the TOA bands (see open_toa_stage), which are computed
+     from the clipped DNs, and then to the BIP conversion (see
+     open_espa_interleave), which takes the TOA bands from the TOA stage.
+  2. The band stack skips the statistics of the clipped bands, since the
+     clipping records the statistics of the clipped pixels.
+  3. The BIP conversion is handed back once all the blocks are written, to
+     be closed by the caller after the XML file is written, since closing it
+     changes the band filenames in the metadata.
+******************************************************************************/
+int process_level1_bands
+(
+    Espa_internal_meta_t *xml_metadata, /* I/O: metadata of the bands */
+    bool clip,            /* I: should the bands be clipped? */
+    int toa_products,     /* I: TOA_* bands to be created; 0 for none */
+    int toa_first,        /* I: index of the first TOA band; set up by
+                                setup_toa_bands */
+    char *bip_outfile,    /* I: output BIP filename; NULL if the BIP file
+                                isn't written in this traversal */
+    bool convert_qa,      /* I: should the QA bands be converted? */
+    Espa_interleave_writer_t **bip  /* O: BIP conversion to be closed by the
+                                caller; NULL if there is none */
+)
+{
+    char FUNC_NAME[] = "process_level1_bands";  /* function name */
+    char errmsg[STR_SIZE];        /* error message */
+    int i;                        /* looping variable for the bands */
+    int nbands = xml_metadata->nbands;  /* number of bands in the metadata */
+    int nlevel1;                  /* number of bands before the TOA bands */
+    int nclip = 0;                /* number of image bands to clip */
+    int clip_size = 0;            /* bytes per pixel of the clipped bands */
+    int clip_index[MAX_CLIP_BANDS + 1];  /* metadata index of each clipped
+                                     band, with the band quality band last */
+    int clip_pos[MAX_CLIP_BANDS + 1];    /* position of each clipped band in
+                                     the band stack */
+    int ntoa = 0;                 /* number of Level-1 bands of the TOA
+                                     bands */
+    int *toa_pos = NULL;          /* position of each Level-1 band of the TOA
+                                     bands in the band stack */
+    int *stack_index = NULL;      /* metadata index of each band in the
+                                     band stack */
+    int nstack = 0;               /* number of bands in the band stack */
+    int block_lines;              /* number of lines per block */
+    int status = SUCCESS;         /* return status */
+    void *clip_buf[MAX_CLIP_BANDS + 1];  /* block of each clipped band */
+    void **toa_buf = NULL;        /* block of each Level-1 band of the TOA
+                                     bands */
+    void **bip_buf = NULL;        /* block of each band of the BIP file */
+    Clip_stage_t *clip_stage = NULL;  /* clipping of the bands */
+    Toa_stage_t *toa_stage = NULL;    /* TOA bands */
+    Espa_band_stack_t *stack = NULL;  /* band stack of all the bands read */
+    Espa_band_block_t *block = NULL;  /* current block of the band stack */
+    Espa_band_block_t view;       /* current block of the bands of a step */
+
+    *bip = NULL;
+    nlevel1 = toa_products != 0 ? toa_first : nbands;
+
+    /* Find the bands to be clipped, for the instrument */
+    if (clip && find_level1_clip_bands (xml_metadata, clip_index, &nclip,
+        &clip_size) != SUCCESS)
+    {
+        sprintf (errmsg, "Finding the bands to be clipped");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    stack_index = calloc (nbands, sizeof (int));
+    toa_pos = calloc (nbands, sizeof (int));
+    toa_buf = calloc (nbands, sizeof (void *));
+    bip_buf = calloc (nbands, sizeof (void *));
+    if (stack_index == NULL || toa_pos == NULL || toa_buf == NULL ||
+        bip_buf == NULL)
+    {
+        sprintf (errmsg, "Allocating the bands of the band stack");
+        error_handler (true, FUNC_NAME, errmsg);
+        status = ERROR;
+        goto cleanup;
+    }
+
+    /* Start the TOA bands, to find the Level-1 bands they need */
+    if (toa_products != 0)
+    {
+        toa_stage = open_toa_stage (xml_metadata, toa_products, toa_first);
+        if (toa_stage == NULL)
+        {  /* Error messages already written */
+            status = ERROR;
+            goto cleanup;
+        }
+        ntoa = get_toa_stage_sources (toa_stage, toa_pos);
+    }
+
+    /* The BIP file takes every band before the TOA bands in order, so they
+       are at the same positions in the band stack.  The bands of the other
+       steps are added to the stack once. */
+    if (bip_outfile != NULL)
+        for (i = 0; i < nlevel1; i++)
+            add_stack_band (stack_index, &nstack, i);
+    for (i = 0; i < nclip + (nclip > 0); i++)
+        clip_pos[i] = add_stack_band (stack_index, &nstack, clip_index[i]);
+    for (i = 0; i < ntoa; i++)
+        toa_pos[i] = add_stack_band (stack_index, &nstack, toa_pos[i]);
+    if (nstack == 0)
+        goto cleanup;   /* none of the steps reads the bands */
+
+    /* Size the blocks for the clipping, within the memory of the whole
+       stack */
+    block_lines = RB_PREFETCH_DEFAULT_LINES;
+    if (nclip > 0)
+        block_lines = clip_block_lines (xml_metadata, nclip, clip_index,
+            clip_size);
+    block_lines = espa_band_stack_lines (xml_metadata, nstack, stack_index,
+        block_lines, 1);
+
+    if (nclip > 0)
+    {
+        clip_stage = open_clip_stage (xml_metadata, nclip, clip_index,
+            clip_size, block_lines);
+        if (clip_stage == NULL)
+        {
+            sprintf (errmsg, "Starting the clipping of the bands");
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+            goto cleanup;
+        }
+    }
+
+    if (bip_outfile != NULL)
+    {
+        *bip = open_espa_interleave (xml_metadata, bip_outfile,
+            ESPA_BIP_INTERLEAVE, 0, block_lines, convert_qa);
+        if (*bip == NULL)
+        {  /* Error messages already written */
+            status = ERROR;
+            goto cleanup;
+        }
+    }
+
+    stack = open_band_stack (xml_metadata, nstack, stack_index, block_lines,
+        0);
+    if (stack == NULL)
+    {
+        sprintf (errmsg, "Starting the read-ahead of the bands");
+        error_handler (true, FUNC_NAME, errmsg);
+        status = ERROR;
+        goto cleanup;
+    }
+    for (i = 0; i < nclip + (nclip > 0); i++)
+        skip_band_stack_band_stats (stack, clip_pos[i]);
+
+    /* Hand each block to the steps in turn.  Each step gets a view of the
+       block holding just its bands. */
+    while (1)
+    {
+        if (get_band_stack_block (stack, &block) != SUCCESS)
+        {
+            sprintf (errmsg, "Reading the next block of lines");
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+            break;
+        }
+        if (block == NULL)
+            break;   /* all lines have been processed */
+        view = *block;
+
+        if (clip_stage != NULL)
+        {
+            for (i = 0; i <= nclip; i++)
+                clip_buf[i] = block->band_buf[clip_pos[i]];
+            view.band_buf = clip_buf;
+            if (clip_stage_block (clip_stage, &view) != SUCCESS)
+            {  /* Error messages already written */
+                status = ERROR;
+                break;
+            }
+        }
+
+        if (toa_stage != NULL)
+        {
+            for (i = 0; i < ntoa; i++)
+                toa_buf[i] = block->band_buf[toa_pos[i]];
+            view.band_buf = toa_buf;
+            if (toa_stage_block (toa_stage, &view) != SUCCESS)
+            {  /* Error messages already written */
+                status = ERROR;
+                break;
+            }
+        }
+
+        if (*bip != NULL)
+        {
+            for (i = 0; i < nbands; i++)
+                bip_buf[i] = i < nlevel1 ? block->band_buf[i] :
+                    get_toa_stage_buf (toa_stage, i);
+            view.band_buf = bip_buf;
+            if (write_espa_interleave_block (*bip, &view) != SUCCESS)
+            {  /* Error messages already written */
+                status = ERROR;
+                break;
+            }
+        }
+    }  /* while blocks */
+
+cleanup:
+    /* Stop the read-ahead, and record the clipping and the TOA bands in the
+       metadata */
+    if (stack != NULL)
+        close_band_stack (stack);
+    if (close_clip_stage (clip_stage, status == SUCCESS) != SUCCESS)
+    {
+        sprintf (errmsg, "Finishing the clipping of the bands");
+        error_handler (true, FUNC_NAME, errmsg);
+        status = ERROR;
+    }
+    if (close_toa_stage (toa_stage, status == SUCCESS) != SUCCESS)
+    {
+        sprintf (errmsg, "Finishing the TOA bands");
+        error_handler (true, FUNC_NAME, errmsg);
+        status = ERROR;
+    }
+    if (status != SUCCESS && *bip != NULL)
+    {
+        close_espa_interleave (*bip, false, NULL, false);
+        *bip = NULL;
+    }
+
+    free (stack_index);
+    free (toa_pos);
+    free (toa_buf);
+    free (bip_buf);
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  write_mask_band
+
+PURPOSE: Writes the land/water mask into the band reserved for it in the
+metadata.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error creating the land/water mask
+SUCCESS         Successfully created the land/water mask
+
+NOTES:
+  1. The mask is only generated inside the footprint of band 1 when the
+     bands were clipped first (see write_land_water_mask).
+******************************************************************************/
+int write_mask_band
+(
+    Espa_internal_meta_t *xml_metadata, /* I/O: XML metadata structure */
+    char *land_mass_polygon,      /* I: filename of the land-mass polygon */
+    char *production_date,        /* I: production date of the mask */
+    int mask_band                 /* I: index of the band reserved for the
+                                        mask */
+)
+{
+    char FUNC_NAME[] = "write_mask_band";  /* function name */
+    char errmsg[STR_SIZE];        /* error message */
+    int refl_indx;                /* index of band 1 */
+    bool use_cache = false;       /* is the mask cache used? */
+    IAS_POLYGON_STORE *land_mass_store = NULL; /* opened land-mass polygon */
+    Lw_mask_cache_t mask_cache;   /* cache of the land/water masks */
+    Espa_trace_span_t span;       /* timing of opening the polygon */
+
+    span = espa_trace_begin ("mask_open_polygon", land_mass_polygon);
+    land_mass_store = ias_geo_open_polygon_store (land_mass_polygon);
+    espa_trace_end (&span);
+    use_cache = init_lw_mask_cache (land_mass_polygon, &mask_cache);
+    if (land_mass_store == NULL ||
+        (refl_indx = find_band1 (xml_metadata)) < 0 ||
+        write_land_water_mask (xml_metadata, land_mass_store,
+            &xml_metadata->band[refl_indx], production_date, LW_MASK_BYTE,
+            use_cache ? &mask_cache : NULL, &xml_metadata->band[mask_band],
+            NULL) != SUCCESS)
+    {
+        sprintf (errmsg, "Creating the land/water mask");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    ias_geo_close_polygon_store (land_mass_store);
+
+    return (SUCCESS);
+}
+
+
+#define MAX_DATE_LEN 28
+/******************************************************************************
+MODULE:  main
+
+PURPOSE: Converts the LPGS product to the ESPA internal format and runs the
+requested Level-1 preprocessing steps on the converted bands, holding the
+metadata in memory between the steps.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error processing the product
+SUCCESS         No errors encountered
+
+NOTES:
+  1. The bands are appended in the order of the separate applications: the
+     date bands, the land/water mask, and the TOA bands.  The date bands and
+     the land/water mask don't read the pixels of the other bands, so they
+     are written first.  A single traversal of the bands then clips the
+     Level-1 bands, writes the TOA bands, and writes the BIP product.  The
+     XML file is written and validated after it, before the BIP product is
+     finished.
+  2. With --constant_date_bands the date bands are never written to disk.
+     The BIP product synthesizes their pixels as it goes.
+  3. The land/water mask is only generated inside the footprint of the
+     clipped bands, so with --clip it is written after the traversal, and
+     the BIP product, which holds the mask, is then written by a traversal
+     of its own.
+******************************************************************************/
+int main (int argc, char** argv)
+{
+    char FUNC_NAME[] = "process_level1";  /* function name */
+    char errmsg[STR_SIZE];        /* error message */
+    char production_date[MAX_DATE_LEN+1]; /* current date/time for production */
+    char *mtl_infile = NULL;      /* input LPGS MTL filename */
+    char *xml_outfile = NULL;     /* output XML filename */
+    char *bip_outfile = NULL;     /* output BIP filename */
+    char *land_mass_polygon = NULL; /* filename of the land-mass polygon */
+    bool clip = false;            /* should the bands be clipped? */
+    bool date_bands = false;      /* should the date bands be created? */
+    bool constant = false;        /* should the date bands be left as
+                                     constant bands? */
+    bool land_water_mask = false; /* should the land/water mask be created? */
+    bool toa_float = false;       /* should the TOA bands be FLOAT32? */
+    bool convert_qa = false;      /* should the QA bands be converted? */
+    bool del_src = false;         /* should source files be removed? */
+    bool fused_bip;               /* is the BIP product written in the
+                                     traversal of the Level-1 bands? */
+    int refl_indx;                /* index of band 1 */
+    int first;                    /* index of the first appended band */
+    int mask_band;                /* index of the land/water mask */
+    int toa_first = 0;            /* index of the first TOA band */
+    int toa_products = 0;         /* TOA_* bands to be created */
+    int ntoa;                     /* number of TOA bands */
+    time_t tp;                    /* time structure */
+    struct tm *tm = NULL;         /* time structure for UTC time */
+    Espa_global_meta_t *gmeta = NULL;  /* pointer to the global metadata */
+    Espa_internal_meta_t xml_metadata; /* XML metadata structure, populated
+                                     from the MTL file and shared by all the
+                                     steps */
+    Espa_interleave_writer_t *bip = NULL; /* BIP conversion written in the
+                                     traversal of the Level-1 bands */
+
+    printf ("process_level1 version: %s\n", ESPA_COMMON_VERSION);
+
+    /* Read the command-line arguments */
+    if (get_args (argc, argv, &mtl_infile, &xml_outfile, &bip_outfile, &clip,
+        &date_bands, &constant, &land_water_mask, &toa_products, &toa_float,
+        &convert_qa, &del_src) != SUCCESS)
+    {   /* get_args already printed the error message */
+        exit (EXIT_FAILURE);
+    }
+
+    /* Check for the land-mass polygon before doing any of the work */
+    if (land_water_mask)
+    {
+        land_mass_polygon = getenv ("ESPA_LAND_MASS_POLYGON");
+        if (land_mass_polygon == NULL)
+        {
+            sprintf (errmsg, "ESPA_LAND_MASS_POLYGON environment variable is "
+                "not defined. Define the environment variable to contain the "
+                "full path and filename of the land-mass polygon to be used "
+                "to generate the land/water mask.\n");
+            error_handler (true, FUNC_NAME, errmsg);
+            exit (EXIT_FAILURE);
+        }
+        printf ("Using land-mass polygon file: %s\n", land_mass_polygon);
+    }
+
+    /* Get the current date/time (UTC) for the production date of the
+       created bands */
+    if (time (&tp) == -1)
+    {
+        sprintf (errmsg, "Unable to obtain the current time.");
+        error_handler (true, FUNC_NAME, errmsg);
+        exit (EXIT_FAILURE);
+    }
+
+    tm = gmtime (&tp);
+    if (tm == NULL)
+    {
+        sprintf (errmsg, "Converting time to UTC.");
+        error_handler (true, FUNC_NAME, errmsg);
+        exit (EXIT_FAILURE);
+    }
+
+    if (strftime (production_date, MAX_DATE_LEN, "%Y-%m-%dT%H:%M:%SZ", tm) == 0)
+    {
+        sprintf (errmsg, "Formatting the production date/time.");
+        error_handler (true, FUNC_NAME, errmsg);
+        exit (EXIT_FAILURE);
+    }
+
+    /* Convert the LPGS MTL and data to ESPA raw binary, keeping the
+       metadata in memory */
+    init_metadata_struct (&xml_metadata);
+    if (convert_lpgs_to_espa_metadata (mtl_infile, del_src, &xml_metadata) !=
+        SUCCESS)
+    {  /* Error messages already written */
+        exit (EXIT_FAILURE);
+    }
+    gmeta = &xml_metadata.global;
+
+    /* Append the three date bands to the metadata, writing out their pixels
+       unless they are to be left as constant bands.  They don't depend on
+       the pixels of the other bands, so they are written first. */
+    if (date_bands)
+    {
+        first = xml_metadata.nbands;
+        if ((refl_indx = find_band1 (&xml_metadata)) < 0 ||
+            append_band_metadata (&xml_metadata, 3) != SUCCESS ||
+            setup_date_bands (&xml_metadata, &xml_metadata.band[refl_indx],
+                production_date, &xml_metadata.band[first]) != SUCCESS)
+        {
+            sprintf (errmsg, "Setting up the date bands");
+            error_handler (true, FUNC_NAME, errmsg);
+            exit (EXIT_FAILURE);
+        }
+
+        if (!constant && write_date_bands (gmeta, &xml_metadata.band[first])
+            != SUCCESS)
+        {  /* Error messages already written */
+            exit (EXIT_FAILURE);
+        }
+    }
+
+    /* Append the land/water mask to the metadata.  It is written now unless
+       it waits for the footprint of the clipped bands. */
+    if (land_water_mask)
+    {
+        mask_band = xml_metadata.nbands;
+        if (append_band_metadata (&xml_metadata, 1) != SUCCESS ||
+            (!clip && write_mask_band (&xml_metadata, land_mass_polygon,
+            production_date, mask_band) != SUCCESS))
+        {
+            sprintf (errmsg, "Appending the land/water mask");
+            error_handler (true, FUNC_NAME, errmsg);
+            exit (EXIT_FAILURE);
+        }
+    }
+
+    /* Append the TOA bands of the Level-1 bands to the metadata */
+    if (toa_products != 0)
+    {
+        first = xml_metadata.nbands;
+        ntoa = count_toa_bands (&xml_metadata, toa_products);
+        if (ntoa == 0)
+        {
+            sprintf (errmsg, "None of the bands has the calibration of the "
+                "requested TOA bands");
+            error_handler (true, FUNC_NAME, errmsg);
+            exit (EXIT_FAILURE);
+        }
+
+        toa_first = first;
+        if (append_band_metadata (&xml_metadata, ntoa) != SUCCESS ||
+            setup_toa_bands (&xml_metadata, toa_products,
+                toa_float ? ESPA_FLOAT32 : ESPA_INT16, production_date,
+                first) != SUCCESS)
+        {
+            sprintf (errmsg, "Setting up the TOA bands");
+            error_handler (true, FUNC_NAME, errmsg);
+            exit (EXIT_FAILURE);
+        }
+    }
+
+    /* Clip the bands, write the TOA bands, and write the BIP product in one
+       traversal of the bands.  The BIP product needs a traversal of its own
+       when it holds a land/water mask made from the clipped bands. */
+    fused_bip = bip_outfile != NULL && !(land_water_mask && clip);
+    if (process_level1_bands (&xml_metadata, clip, toa_products, toa_first,
+        fused_bip ? bip_outfile : NULL, convert_qa, &bip) != SUCCESS)
+    {
+        sprintf (errmsg, "Processing the Level-1 bands");
+        error_handler (true, FUNC_NAME, errmsg);
+        exit (EXIT_FAILURE);
+    }
+
+    /* Write the land/water mask from the footprint of the clipped bands */
+    if (land_water_mask && clip && write_mask_band (&xml_metadata,
+        land_mass_polygon, production_date, mask_band) != SUCCESS)
+    {  /* Error messages already written */
+        exit (EXIT_FAILURE);
+    }
+
+    /* Write the metadata of all the bands to the output XML file, and
+       validate it */
+    if (write_metadata (&xml_metadata, xml_outfile) != SUCCESS ||
+        validate_xml_file (xml_outfile) != SUCCESS)
+    {
+        sprintf (errmsg, "Writing the XML file: %s", xml_outfile);
+        error_handler (true, FUNC_NAME, errmsg);
+        exit (EXIT_FAILURE);
+    }
+
+    /* Finish the BIP product, or create it from the bands in memory */
+    if (bip != NULL)
+    {
+        if (close_espa_interleave (bip, true, xml_outfile, del_src) !=
+            SUCCESS)
+        {  /* Error messages already written */
+            exit (EXIT_FAILURE);
+        }
+    }
+    else if (bip_outfile != NULL)
+    {
+        if (convert_espa_meta_to_raw_binary_bip (&xml_metadata, xml_outfile,
+            bip_outfile, convert_qa, del_src) != SUCCESS)
+        {  /* Error messages already written */
+            exit (EXIT_FAILURE);
+        }
+    }
+
+    /* Free the metadata structure */
+    free_metadata (&xml_metadata);
+
+    /* Free the pointers */
+    free (mtl_infile);
+    free (xml_outfile);
+    free (bip_outfile);
+
+    /* Successful completion */
+    exit (EXIT_SUCCESS);
+}
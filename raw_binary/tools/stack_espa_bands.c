@@ -0,0 +1,237 @@
+/*****************************************************************************
+FILE: stack_espa_bands
+
+PURPOSE: Contains functions for storing the raw binary bands of an ESPA
+product stacked in band sequential (BSQ) files, or back in a file per band.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The XML metadata format parsed or written via this library follows the
+     ESPA internal metadata format found in ESPA Raw Binary Format v1.0.doc.
+     The schema for the ESPA internal metadata format is available at
+     http://espa.cr.usgs.gov/schema/espa_internal_metadata_vX_X.xsd.
+  2. The file_offset attribute of each band in the XML records where the band
+     starts in its stack.
+*****************************************************************************/
+#include <getopt.h>
+#include "parse_metadata.h"
+#include "write_metadata.h"
+#include "espa_file_stack.h"
+
+/******************************************************************************
+MODULE: usage
+
+PURPOSE: Prints the usage information for this application.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+void usage ()
+{
+    printf ("stack_espa_bands stores the raw binary bands of the ESPA "
+            "internal format stacked one after the other in band sequential "
+            "(BSQ) files, each with a single ENVI header for all of its "
+            "bands, or splits them back out into a file per band.  The "
+            "bands of the same size and data type are stacked together.  "
+            "The XML metadata file is updated with the new band files.\n");
+    printf ("version: %s\n\n", ESPA_COMMON_VERSION);
+    printf ("usage: stack_espa_bands "
+            "--xml=input_metadata_filename [--unstack]\n");
+
+    printf ("\nwhere the following parameters are required:\n");
+    printf ("    -xml: name of the input XML metadata file which follows "
+            "the ESPA internal raw binary schema.  The stacks are named "
+            "after it, <base>%s.img, <base>%s2.img, ...\n",
+            ESPA_FILE_STACK_SUFFIX, ESPA_FILE_STACK_SUFFIX);
+
+    printf ("\nwhere the following parameters are optional:\n");
+    printf ("    -unstack: write each stacked band back out to its own "
+            "file, <base>_<band name>.img\n");
+    printf ("\nExample: stack_espa_bands "
+            "--xml=LE07_L1TP_022033_20140228_20161028_02_T1.xml\n");
+}
+
+
+/******************************************************************************
+MODULE:  get_args
+
+PURPOSE:  Gets the command-line arguments and validates that the required
+arguments were specified.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error getting the command-line arguments or a command-line
+                argument and associated value were not specified
+SUCCESS         No errors encountered
+
+NOTES:
+  1. Memory is allocated for the input file.  This should be a character
+     pointer set to NULL on input.  The caller is responsible for freeing the
+     allocated memory upon successful return.
+******************************************************************************/
+short get_args
+(
+    int argc,              /* I: number of cmd-line args */
+    char *argv[],          /* I: string of cmd-line args */
+    char **xml_infile,     /* O: address of input XML filename */
+    bool *unstack          /* O: should the bands be unstacked? */
+)
+{
+    int c;                           /* current argument index */
+    int option_index;                /* index for the command-line option */
+    static int unstack_flag = 0;     /* flag for unstacking the bands */
+    char errmsg[STR_SIZE];           /* error message */
+    char FUNC_NAME[] = "get_args";   /* function name */
+    static struct option long_options[] =
+    {
+        {"unstack", no_argument, &unstack_flag, 1},
+        {"xml", required_argument, 0, 'i'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    /* Loop through all the cmd-line options */
+    opterr = 0;   /* turn off getopt_long error msgs as we'll print our own */
+    while (1)
+    {
+        /* optstring in call to getopt_long is empty since we will only
+           support the long options */
+        c = getopt_long (argc, argv, "", long_options, &option_index);
+        if (c == -1)
+        {   /* Out of cmd-line options */
+            break;
+        }
+
+        switch (c)
+        {
+            case 0:
+                /* If this option set a flag, do nothing else now. */
+                if (long_options[option_index].flag != 0)
+                    break;
+
+            case 'h':  /* help */
+                usage ();
+                return (ERROR);
+                break;
+
+            case 'i':  /* XML infile */
+                *xml_infile = strdup (optarg);
+                break;
+
+            case '?':
+            default:
+                sprintf (errmsg, "Unknown option %s", argv[optind-1]);
+                error_handler (true, FUNC_NAME, errmsg);
+                usage ();
+                return (ERROR);
+                break;
+        }
+    }
+
+    /* Make sure the infile was specified */
+    if (*xml_infile == NULL)
+    {
+        sprintf (errmsg, "XML input file is a required argument");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    *unstack = unstack_flag != 0;
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  main
+
+PURPOSE:  Stacks (or unstacks) the bands of the ESPA product and updates the
+XML metadata file.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error stacking the bands
+SUCCESS         No errors encountered
+
+NOTES:
+  1. The XML file is written even if a stack fails, so it references the
+     files of the bands which were already rewritten.
+******************************************************************************/
+int main (int argc, char** argv)
+{
+    char FUNC_NAME[] = "main";   /* function name */
+    char errmsg[STR_SIZE];       /* error message */
+    char *xml_infile = NULL;     /* input XML filename */
+    char base_name[STR_SIZE];    /* base name of the band files */
+    char *cptr = NULL;           /* pointer to the file extension */
+    int count;                   /* number of chars copied in snprintf */
+    int status;                  /* status of stacking the bands */
+    bool unstack = false;        /* should the bands be unstacked? */
+    Espa_internal_meta_t xml_metadata;  /* XML metadata structure */
+
+    printf ("stack_espa_bands version: %s\n", ESPA_COMMON_VERSION);
+
+    /* Read the command-line arguments */
+    if (get_args (argc, argv, &xml_infile, &unstack) != SUCCESS)
+    {   /* get_args already printed the error message */
+        exit (EXIT_FAILURE);
+    }
+
+    /* The band files are named after the XML file, minus its extension */
+    count = snprintf (base_name, sizeof (base_name), "%s", xml_infile);
+    if (count < 0 || count >= sizeof (base_name))
+    {
+        sprintf (errmsg, "Overflow of base_name string");
+        error_handler (true, FUNC_NAME, errmsg);
+        exit (EXIT_FAILURE);
+    }
+    cptr = strrchr (base_name, '.');
+    if (cptr != NULL && !strcmp (cptr, ".xml"))
+        *cptr = '\0';
+
+    /* Validate the metadata file and parse it into our internal metadata
+       structure */
+    init_metadata_struct (&xml_metadata);
+    if (validate_and_parse_metadata (xml_infile, &xml_metadata) != SUCCESS)
+    {  /* Error messages already written */
+        exit (EXIT_FAILURE);
+    }
+
+    /* Rewrite the bands */
+    if (unstack)
+        status = unstack_espa_bands (&xml_metadata, base_name);
+    else
+        status = stack_espa_bands (&xml_metadata, base_name);
+    if (status != SUCCESS)
+    {
+        sprintf (errmsg, "%s the bands of %s", unstack ? "Unstacking" :
+            "Stacking", xml_infile);
+        error_handler (true, FUNC_NAME, errmsg);
+    }
+
+    /* Write the metadata back out, which now references the new files */
+    if (write_metadata (&xml_metadata, xml_infile) != SUCCESS)
+    {  /* Error messages already written */
+        exit (EXIT_FAILURE);
+    }
+    if (status != SUCCESS)
+        exit (EXIT_FAILURE);
+
+    /* Free the metadata structure and the pointers */
+    free_metadata (&xml_metadata);
+    free (xml_infile);
+
+    /* Successful completion */
+    exit (EXIT_SUCCESS);
+}
@@ -172,19 +172,13 @@ int main (int argc, char** argv)
         exit (EXIT_FAILURE);
     }
 
-    /* Validate the input metadata file */
-    if (validate_xml_file (xml_infile) != SUCCESS)
-    {  /* Error messages already written */
-        exit (EXIT_FAILURE);
-    }
-
     /* Initialize the metadata structure */
     init_metadata_struct (&xml_metadata);
 
-    /* Parse the metadata file into our internal metadata structure; also
-       allocates space as needed for various pointers in the global and band
-       metadata */
-    if (parse_metadata (xml_infile, &xml_metadata) != SUCCESS)
+    /* Validate the metadata file and parse it into our internal metadata
+       structure, reading the file only once; also allocates space as needed
+       for various pointers in the global and band metadata */
+    if (validate_and_parse_metadata (xml_infile, &xml_metadata) != SUCCESS)
     {  /* Error messages already written */
         exit (EXIT_FAILURE);
     }
@@ -199,35 +193,35 @@ int main (int argc, char** argv)
         switch (bmeta->data_type)
         {
             case ESPA_INT8:
-                band_buffer = calloc (bmeta->nlines * bmeta->nsamps,
+                band_buffer = calloc ((size_t) bmeta->nlines * bmeta->nsamps,
                     sizeof (int8_t));
                 break;
             case ESPA_UINT8:
-                band_buffer = calloc (bmeta->nlines * bmeta->nsamps,
+                band_buffer = calloc ((size_t) bmeta->nlines * bmeta->nsamps,
                     sizeof (uint8_t));
                 break;
             case ESPA_INT16:
-                band_buffer = calloc (bmeta->nlines * bmeta->nsamps,
+                band_buffer = calloc ((size_t) bmeta->nlines * bmeta->nsamps,
                     sizeof (int16_t));
                 break;
             case ESPA_UINT16:
-                band_buffer = calloc (bmeta->nlines * bmeta->nsamps,
+                band_buffer = calloc ((size_t) bmeta->nlines * bmeta->nsamps,
                     sizeof (uint16_t));
                 break;
             case ESPA_INT32:
-                band_buffer = calloc (bmeta->nlines * bmeta->nsamps,
+                band_buffer = calloc ((size_t) bmeta->nlines * bmeta->nsamps,
                     sizeof (int32_t));
                 break;
             case ESPA_UINT32:
-                band_buffer = calloc (bmeta->nlines * bmeta->nsamps,
+                band_buffer = calloc ((size_t) bmeta->nlines * bmeta->nsamps,
                     sizeof (uint32_t));
                 break;
             case ESPA_FLOAT32:
-                band_buffer = calloc (bmeta->nlines * bmeta->nsamps,
+                band_buffer = calloc ((size_t) bmeta->nlines * bmeta->nsamps,
                     sizeof (float));
                 break;
             case ESPA_FLOAT64:
-                band_buffer = calloc (bmeta->nlines * bmeta->nsamps,
+                band_buffer = calloc ((size_t) bmeta->nlines * bmeta->nsamps,
                     sizeof (double));
                 break;
         }
@@ -0,0 +1,642 @@
+/*****************************************************************************
+FILE: unpack_espa_qa
+
+PURPOSE: Contains functions for unpacking bit fields of a QA band of an ESPA
+product into mask bands.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The XML metadata format parsed or written via this library follows the
+     ESPA internal metadata format found in ESPA Raw Binary Format v1.0.doc.
+     The schema for the ESPA internal metadata format is available at
+     http://espa.cr.usgs.gov/schema/espa_internal_metadata_vX_X.xsd.
+  2. The fields are named as in espa_qa_unpack.h.  Each field is written as
+     a UINT8 band; the bit-packed masks of the library are meant for the
+     programs which use the masks in memory.
+*****************************************************************************/
+#include <getopt.h>
+#include <ctype.h>
+#include <time.h>
+#include "parse_metadata.h"
+#include "write_metadata.h"
+#include "raw_binary_writer.h"
+#include "envi_header.h"
+#include "espa_band_stack.h"
+#include "espa_qa_unpack.h"
+
+#define MAX_DATE_LEN 28
+
+/******************************************************************************
+MODULE: usage
+
+PURPOSE: Prints the usage information for this application.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+void usage ()
+{
+    printf ("unpack_espa_qa unpacks bit fields of a QA band of the ESPA "
+            "internal format, as named in its bitmap description, into "
+            "UINT8 mask bands which are appended to the XML metadata "
+            "file.\n");
+    printf ("version: %s\n\n", ESPA_COMMON_VERSION);
+    printf ("usage: unpack_espa_qa "
+            "--xml=input_metadata_filename "
+            "[--band=qa_band_name] "
+            "--field=field_name [--field=field_name ...] "
+            "[--min_value=value] [--list]\n");
+
+    printf ("\nwhere the following parameters are required:\n");
+    printf ("    -xml: name of the input XML metadata file which follows "
+            "the ESPA internal raw binary schema\n");
+    printf ("    -field: field to be unpacked, named by the description of "
+            "its bits up to the first \" (\" (ex. \"Cloud Confidence\") or "
+            "by its bits (ex. 8-9); may be repeated, up to %d times\n",
+            ESPA_QA_MAX_FIELDS);
+    printf ("\nwhere the following parameters are optional:\n");
+    printf ("    -band: name of the QA band (default is qa_pixel)\n");
+    printf ("    -min_value: write 1 where the value of the field is at "
+            "least min_value and 0 elsewhere (default is to write the "
+            "value of the field)\n");
+    printf ("    -list: list the fields of the QA band and exit\n");
+    printf ("\nExample: unpack_espa_qa "
+            "--xml=LC08_L1TP_022033_20140228_20200911_02_T1.xml "
+            "--field=\"Cloud Confidence\" --field=Cloud --min_value=1\n");
+}
+
+
+/******************************************************************************
+MODULE:  get_args
+
+PURPOSE:  Gets the command-line arguments and validates that the required
+arguments were specified.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error getting the command-line arguments or a command-line
+                argument and associated value were not specified
+SUCCESS         No errors encountered
+
+NOTES:
+  1. Memory is allocated for the input file, the band, and the fields.  These
+     should be NULL on input.  The caller is responsible for freeing the
+     allocated memory upon successful return.
+******************************************************************************/
+short get_args
+(
+    int argc,              /* I: number of cmd-line args */
+    char *argv[],          /* I: string of cmd-line args */
+    char **xml_infile,     /* O: address of input XML filename */
+    char **band_name,      /* O: address of the name of the QA band */
+    char **fields,         /* O: fields to be unpacked; holds
+                                 ESPA_QA_MAX_FIELDS */
+    int *nfields,          /* O: number of fields */
+    int *min_value,        /* O: smallest value written as 1; 0 to write
+                                 the values */
+    bool *list             /* O: should the fields be listed? */
+)
+{
+    int c;                           /* current argument index */
+    int option_index;                /* index for the command-line option */
+    char errmsg[STR_SIZE];           /* error message */
+    char FUNC_NAME[] = "get_args";   /* function name */
+    static struct option long_options[] =
+    {
+        {"xml", required_argument, 0, 'i'},
+        {"band", required_argument, 0, 'b'},
+        {"field", required_argument, 0, 'f'},
+        {"min_value", required_argument, 0, 'm'},
+        {"list", no_argument, 0, 'l'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    /* Loop through all the cmd-line options */
+    opterr = 0;   /* turn off getopt_long error msgs as we'll print our own */
+    while (1)
+    {
+        /* optstring in call to getopt_long is empty since we will only
+           support the long options */
+        c = getopt_long (argc, argv, "", long_options, &option_index);
+        if (c == -1)
+        {   /* Out of cmd-line options */
+            break;
+        }
+
+        switch (c)
+        {
+            case 0:
+                /* If this option set a flag, do nothing else now. */
+                if (long_options[option_index].flag != 0)
+                    break;
+
+            case 'h':  /* help */
+                usage ();
+                return (ERROR);
+                break;
+
+            case 'i':  /* XML infile */
+                free (*xml_infile);
+                *xml_infile = strdup (optarg);
+                break;
+
+            case 'b':  /* QA band */
+                free (*band_name);
+                *band_name = strdup (optarg);
+                break;
+
+            case 'f':  /* field */
+                if (*nfields == ESPA_QA_MAX_FIELDS)
+                {
+                    sprintf (errmsg, "At most %d fields can be unpacked",
+                        ESPA_QA_MAX_FIELDS);
+                    error_handler (true, FUNC_NAME, errmsg);
+                    return (ERROR);
+                }
+                fields[(*nfields)++] = strdup (optarg);
+                break;
+
+            case 'm':  /* smallest value written as 1 */
+                *min_value = atoi (optarg);
+                if (*min_value < 1 || *min_value > 255)
+                {
+                    sprintf (errmsg, "min_value must be from 1 to 255");
+                    error_handler (true, FUNC_NAME, errmsg);
+                    usage ();
+                    return (ERROR);
+                }
+                break;
+
+            case 'l':  /* list the fields */
+                *list = true;
+                break;
+
+            case '?':
+            default:
+                sprintf (errmsg, "Unknown option %s", argv[optind-1]);
+                error_handler (true, FUNC_NAME, errmsg);
+                usage ();
+                return (ERROR);
+                break;
+        }
+    }
+
+    /* Make sure the infile and the fields were specified */
+    if (*xml_infile == NULL)
+    {
+        sprintf (errmsg, "XML input file is a required argument");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+    if (*nfields == 0 && !*list)
+    {
+        sprintf (errmsg, "At least one field is required");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+    if (*band_name == NULL)
+        *band_name = strdup ("qa_pixel");
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  setup_mask_band
+
+PURPOSE: Sets up the band metadata of the mask of a field of the QA band.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error setting up the mask band
+SUCCESS         Successfully set up the mask band
+
+NOTES:
+  1. The mask is named <QA band>_<field>, with the field in lowercase and
+     anything other than letters and digits replaced by underscores, and its
+     file is the file of the QA band with the same suffix.
+******************************************************************************/
+int setup_mask_band
+(
+    const Espa_band_meta_t *qmeta,  /* I: metadata of the QA band */
+    const Espa_qa_field_t *field,   /* I: field of the mask */
+    int min_value,         /* I: smallest value written as 1; 0 to write
+                                 the values */
+    const char *production_date,    /* I: production date of the mask */
+    Espa_band_meta_t *mmeta         /* O: metadata of the mask band */
+)
+{
+    char FUNC_NAME[] = "setup_mask_band";  /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    char suffix[STR_SIZE];      /* suffix of the field */
+    char *cptr = NULL;          /* pointer into a string */
+    int count;                  /* number of chars copied in snprintf */
+    int len;                    /* length of the file name without the
+                                   extension */
+
+    /* Suffix of the names */
+    strcpy (suffix, field->name);
+    for (cptr = suffix; *cptr != '\0'; cptr++)
+    {
+        if (isalnum ((unsigned char) *cptr))
+            *cptr = tolower ((unsigned char) *cptr);
+        else
+            *cptr = '_';
+    }
+
+    count = snprintf (mmeta->name, sizeof (mmeta->name), "%s_%s",
+        qmeta->name, suffix);
+    if (count < 0 || count >= sizeof (mmeta->name))
+    {
+        sprintf (errmsg, "Overflow of the name of the mask of %s",
+            field->name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    cptr = strrchr (qmeta->file_name, '.');
+    len = (cptr != NULL) ? (int) (cptr - qmeta->file_name) :
+        (int) strlen (qmeta->file_name);
+    count = snprintf (mmeta->file_name, sizeof (mmeta->file_name),
+        "%.*s_%s.img", len, qmeta->file_name, suffix);
+    if (count < 0 || count >= sizeof (mmeta->file_name))
+    {
+        sprintf (errmsg, "Overflow of the filename of %s", mmeta->name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    strcpy (mmeta->product, qmeta->product);
+    strcpy (mmeta->source, qmeta->source);
+    strcpy (mmeta->short_name, qmeta->short_name);
+    strcpy (mmeta->category, "qa");
+    snprintf (mmeta->long_name, sizeof (mmeta->long_name), "%s of %s",
+        field->name, qmeta->name);
+    strcpy (mmeta->data_units, "quality/feature classification");
+    mmeta->data_type = ESPA_UINT8;
+    mmeta->valid_range[0] = 0.0;
+    if (min_value > 0)
+        mmeta->valid_range[1] = 1.0;
+    else
+        mmeta->valid_range[1] = (float) ((1 << field->nbits) - 1);
+    mmeta->resample_method = ESPA_NN;
+    mmeta->nlines = qmeta->nlines;
+    mmeta->nsamps = qmeta->nsamps;
+    mmeta->pixel_size[0] = qmeta->pixel_size[0];
+    mmeta->pixel_size[1] = qmeta->pixel_size[1];
+    strcpy (mmeta->pixel_units, qmeta->pixel_units);
+    sprintf (mmeta->app_version, "unpack_espa_qa_%s", ESPA_COMMON_VERSION);
+    strcpy (mmeta->production_date, production_date);
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  write_mask_bands
+
+PURPOSE: Reads the QA band once and writes the masks of its fields.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the mask bands
+SUCCESS         Successfully wrote the mask bands
+
+NOTES:
+  1. The checksum and statistics of the mask bands are set.
+******************************************************************************/
+int write_mask_bands
+(
+    Espa_internal_meta_t *xml_meta, /* I/O: XML metadata */
+    int qa_band,           /* I: index of the QA band */
+    const Espa_qa_unpack_t *unpack, /* I: unpacking of the fields */
+    int min_value,         /* I: smallest value written as 1; 0 to write
+                                 the values */
+    int first              /* I: index of the first mask band */
+)
+{
+    char FUNC_NAME[] = "write_mask_bands";  /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    char envi_file[STR_SIZE];   /* name of the ENVI header file */
+    char *cptr = NULL;          /* pointer to the file extension */
+    int k;                      /* looping variable for the fields */
+    int line;                   /* looping variable for the lines */
+    int size;                   /* number of bytes per QA pixel */
+    int status = SUCCESS;       /* return status */
+    long i;                     /* looping variable for the pixels */
+    long npix;                  /* number of pixels in the block */
+    long nalloc = 0;            /* number of pixels of the buffers */
+    uint8_t *mask_buf = NULL;   /* masks of the block, one after another */
+    uint8_t *masks[ESPA_QA_MAX_FIELDS];  /* current line of each mask */
+    Espa_band_meta_t *qmeta = &xml_meta->band[qa_band];
+                                /* metadata of the QA band */
+    Espa_band_meta_t *mmeta = NULL;  /* metadata of the current mask */
+    Raw_binary_writer_t *writers[ESPA_QA_MAX_FIELDS];  /* mask writers */
+    Espa_band_stack_t *stack = NULL; /* stack of the QA band */
+    Espa_band_block_t *block = NULL; /* current block of the QA band */
+    Envi_header_t envi_hdr;     /* output ENVI header information */
+
+    stack = open_band_stack (xml_meta, 1, &qa_band, RB_PREFETCH_DEFAULT_LINES,
+        0);
+    if (stack == NULL)
+    {
+        sprintf (errmsg, "Opening the band %s", qmeta->file_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    skip_band_stack_stats (stack);
+    size = espa_data_type_size (qmeta->data_type);
+
+    for (k = 0; k < unpack->nfields; k++)
+    {
+        mmeta = &xml_meta->band[first + k];
+        writers[k] = NULL;
+        if (status != SUCCESS)
+            continue;
+        writers[k] = open_raw_binary_writer (mmeta->file_name,
+            (size_t) mmeta->nlines * mmeta->nsamps, 0);
+        if (writers[k] == NULL ||
+            start_raw_binary_writer_stats (writers[k], mmeta) != SUCCESS)
+        {
+            sprintf (errmsg, "Opening the output band %s", mmeta->file_name);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+        }
+    }
+
+    while (status == SUCCESS)
+    {
+        if (get_band_stack_block (stack, &block) != SUCCESS)
+        {
+            sprintf (errmsg, "Reading the band %s", qmeta->file_name);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+            break;
+        }
+        if (block == NULL)
+            break;
+
+        /* Full width blocks are contiguous */
+        npix = (long) block->nlines * block->nsamps;
+        if (npix > nalloc)
+        {
+            free (mask_buf);
+            nalloc = npix;
+            mask_buf = malloc (nalloc * unpack->nfields);
+            if (mask_buf == NULL)
+            {
+                sprintf (errmsg, "Allocating the masks of %s", qmeta->name);
+                error_handler (true, FUNC_NAME, errmsg);
+                status = ERROR;
+                break;
+            }
+        }
+
+        /* Unpack the fields of each line straight into the masks */
+        for (line = 0; line < block->nlines; line++)
+        {
+            for (k = 0; k < unpack->nfields; k++)
+                masks[k] = mask_buf + k * npix + (long) line * block->nsamps;
+            unpack_espa_qa_line (unpack, (const uint8_t *) block->band_buf[0]
+                + (long) line * block->nsamps * size, block->nsamps, masks);
+        }
+
+        /* Binary masks */
+        if (min_value > 0)
+        {
+            for (i = 0; i < npix * unpack->nfields; i++)
+                mask_buf[i] = (mask_buf[i] >= min_value);
+        }
+
+        for (k = 0; k < unpack->nfields; k++)
+        {
+            if (append_raw_binary_writer (writers[k], block->nlines,
+                block->nsamps, 1, mask_buf + k * npix) != SUCCESS)
+            {
+                sprintf (errmsg, "Writing lines %d-%d of %s", block->line0,
+                    block->line0 + block->nlines - 1,
+                    xml_meta->band[first + k].file_name);
+                error_handler (true, FUNC_NAME, errmsg);
+                status = ERROR;
+                break;
+            }
+        }
+    }
+
+    close_band_stack (stack);
+    free (mask_buf);
+
+    for (k = 0; k < unpack->nfields; k++)
+    {
+        mmeta = &xml_meta->band[first + k];
+        if (writers[k] == NULL)
+            continue;
+        if (status == SUCCESS)
+        {
+            get_raw_binary_writer_checksum (writers[k], mmeta->checksum);
+            get_raw_binary_writer_stats (writers[k], &mmeta->stats);
+        }
+        if (close_raw_binary_writer (writers[k]) != SUCCESS)
+        {
+            sprintf (errmsg, "Closing the output band %s", mmeta->file_name);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+        }
+    }
+
+    /* Write the ENVI headers of the masks */
+    for (k = 0; k < unpack->nfields && status == SUCCESS; k++)
+    {
+        mmeta = &xml_meta->band[first + k];
+        if (create_envi_struct (mmeta, &xml_meta->global, &envi_hdr)
+            != SUCCESS)
+        {
+            sprintf (errmsg, "Creating the ENVI header structure for this "
+                "file: %s", mmeta->file_name);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+            break;
+        }
+
+        strcpy (envi_file, mmeta->file_name);
+        cptr = strrchr (envi_file, '.');
+        strcpy (cptr, ".hdr");
+        if (write_envi_hdr (envi_file, &envi_hdr) != SUCCESS)
+        {
+            sprintf (errmsg, "Writing the ENVI header file: %s.", envi_file);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+        }
+    }
+
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  main
+
+PURPOSE:  Unpacks the fields of a QA band of the ESPA product into mask bands
+and appends them to the XML metadata file.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error unpacking the fields
+SUCCESS         No errors encountered
+
+NOTES:
+******************************************************************************/
+int main (int argc, char** argv)
+{
+    char FUNC_NAME[] = "main";   /* function name */
+    char errmsg[STR_SIZE];       /* error message */
+    char production_date[MAX_DATE_LEN+1]; /* current date/time */
+    char *xml_infile = NULL;     /* input XML filename */
+    char *band_name = NULL;      /* name of the QA band */
+    char *fields[ESPA_QA_MAX_FIELDS];  /* fields to be unpacked */
+    bool list = false;           /* should the fields be listed? */
+    int i;                       /* looping variable */
+    int qa_band;                 /* index of the QA band */
+    int first;                   /* index of the first mask band */
+    int nfields = 0;             /* number of fields */
+    int min_value = 0;           /* smallest value written as 1 */
+    int status = SUCCESS;        /* status of the unpacking */
+    time_t tp;                   /* time structure */
+    struct tm *tm = NULL;        /* time structure for UTC time */
+    Espa_qa_field_t band_fields[ESPA_QA_MAX_FIELDS];  /* fields of the band */
+    Espa_qa_unpack_t unpack;     /* unpacking of the fields */
+    Espa_internal_meta_t xml_metadata;  /* XML metadata structure */
+
+    printf ("unpack_espa_qa version: %s\n", ESPA_COMMON_VERSION);
+
+    /* Read the command-line arguments */
+    if (get_args (argc, argv, &xml_infile, &band_name, fields, &nfields,
+        &min_value, &list) != SUCCESS)
+    {   /* get_args already printed the error message */
+        exit (EXIT_FAILURE);
+    }
+
+    /* Validate the metadata file and parse it into our internal metadata
+       structure */
+    init_metadata_struct (&xml_metadata);
+    if (validate_and_parse_metadata (xml_infile, &xml_metadata) != SUCCESS)
+    {  /* Error messages already written */
+        exit (EXIT_FAILURE);
+    }
+
+    for (qa_band = 0; qa_band < xml_metadata.nbands; qa_band++)
+    {
+        if (!strcmp (xml_metadata.band[qa_band].name, band_name))
+            break;
+    }
+    if (qa_band == xml_metadata.nbands)
+    {
+        sprintf (errmsg, "Band %s is not in %s", band_name, xml_infile);
+        error_handler (true, FUNC_NAME, errmsg);
+        exit (EXIT_FAILURE);
+    }
+
+    /* List the fields */
+    if (list)
+    {
+        if (get_espa_qa_fields (&xml_metadata.band[qa_band], band_fields,
+            &i) != SUCCESS)
+        {  /* Error messages already written */
+            exit (EXIT_FAILURE);
+        }
+        for (first = 0; first < i; first++)
+        {
+            if (band_fields[first].nbits == 1)
+                printf ("bit %d: %s\n", band_fields[first].shift,
+                    band_fields[first].name);
+            else
+                printf ("bits %d-%d: %s\n", band_fields[first].shift,
+                    band_fields[first].shift + band_fields[first].nbits - 1,
+                    band_fields[first].name);
+        }
+        if (nfields == 0)
+            exit (EXIT_SUCCESS);
+    }
+
+    if (init_espa_qa_unpack (&xml_metadata.band[qa_band], nfields, fields,
+        ESPA_QA_MASK_UINT8, 0, &unpack) != SUCCESS)
+    {  /* Error messages already written */
+        exit (EXIT_FAILURE);
+    }
+
+    /* A binary mask is the value of the field against min_value */
+    if (min_value > 0)
+    {
+        for (i = 0; i < nfields; i++)
+            if ((1 << unpack.field[i].nbits) - 1 < min_value)
+            {
+                sprintf (errmsg, "min_value is beyond the values of field "
+                    "%s", unpack.field[i].name);
+                error_handler (true, FUNC_NAME, errmsg);
+                exit (EXIT_FAILURE);
+            }
+    }
+
+    /* Get the current date/time (UTC) for the production date of the
+       masks */
+    if (time (&tp) == -1 || (tm = gmtime (&tp)) == NULL ||
+        strftime (production_date, MAX_DATE_LEN, "%Y-%m-%dT%H:%M:%SZ", tm)
+        == 0)
+    {
+        sprintf (errmsg, "Formatting the production date/time.");
+        error_handler (true, FUNC_NAME, errmsg);
+        exit (EXIT_FAILURE);
+    }
+
+    first = xml_metadata.nbands;
+    if (append_band_metadata (&xml_metadata, nfields) != SUCCESS)
+    {
+        sprintf (errmsg, "Allocating the metadata of the mask bands");
+        error_handler (true, FUNC_NAME, errmsg);
+        exit (EXIT_FAILURE);
+    }
+    for (i = 0; i < nfields && status == SUCCESS; i++)
+        status = setup_mask_band (&xml_metadata.band[qa_band],
+            &unpack.field[i], min_value, production_date,
+            &xml_metadata.band[first + i]);
+    if (status == SUCCESS)
+        status = write_mask_bands (&xml_metadata, qa_band, &unpack,
+            min_value, first);
+    if (status == SUCCESS &&
+        append_metadata (nfields, &xml_metadata.band[first], xml_infile)
+        != SUCCESS)
+        status = ERROR;
+    if (status != SUCCESS)
+    {
+        sprintf (errmsg, "Unpacking the fields of %s", band_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        exit (EXIT_FAILURE);
+    }
+
+    /* Free the metadata structure and the pointers */
+    free_metadata (&xml_metadata);
+    for (i = 0; i < nfields; i++)
+        free (fields[i]);
+    free (xml_infile);
+    free (band_name);
+
+    /* Successful completion */
+    exit (EXIT_SUCCESS);
+}
@@ -0,0 +1,490 @@
+/*****************************************************************************
+FILE: upgrade_espa_metadata
+
+PURPOSE: Contains functions for upgrading many XML metadata files written to
+the older ESPA schemas to the current schema at once.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The files are upgraded in parallel on the task pool, each in one pass
+     with the pull parser (see upgrade_metadata.h), and reported in the
+     order they were specified.
+  2. The files are upgraded in place unless an output directory is given,
+     in which case the upgraded files are written there under the same base
+     name.  Files which already follow the current schema are left alone
+     and aren't copied to the output directory.
+*****************************************************************************/
+#include <getopt.h>
+#include <unistd.h>
+#include <libgen.h>
+#include "espa_metadata.h"
+#include "espa_task_pool.h"
+#include "upgrade_metadata.h"
+
+/* Outcomes of upgrading an XML file */
+typedef enum
+{
+    UPGRADE_DONE = 0,         /* upgraded to the current schema */
+    UPGRADE_CURRENT,          /* already follows the current schema */
+    UPGRADE_FAILED            /* couldn't be upgraded */
+} Upgrade_outcome_t;
+
+/* Result of upgrading an XML file */
+typedef struct
+{
+    Upgrade_outcome_t outcome;  /* outcome of the upgrade */
+    char from_version[UPGRADE_VERSION_SIZE];  /* schema version of the
+                                 file; empty if not known */
+} Upgrade_result_t;
+
+/* Upgrade shared by the workers */
+typedef struct
+{
+    char **xml_files;         /* XML files to be upgraded */
+    int nfiles;               /* number of XML files */
+    char *output_dir;         /* directory of the upgraded files; NULL to
+                                 upgrade the files in place */
+    Upgrade_result_t *results;  /* result of each XML file */
+    bool quiet;               /* only report the files which fail? */
+    int count[UPGRADE_FAILED + 1];  /* number of files of each outcome */
+} Upgrade_t;
+
+
+/******************************************************************************
+MODULE: usage
+
+PURPOSE: Prints the usage information for this application.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+void usage ()
+{
+    printf ("upgrade_espa_metadata upgrades XML metadata files written to "
+            "the older ESPA schemas (v1.0 through v2.1) to the current "
+            "schema (v%s), in one pass per file and many files in "
+            "parallel.  Elements renamed or dropped by later schemas are "
+            "renamed or dropped; everything else is kept as it is.\n",
+            ESPA_SCHEMA_VERSION);
+    printf ("version: %s\n\n", ESPA_COMMON_VERSION);
+    printf ("usage: upgrade_espa_metadata "
+            "[--xml=input_metadata_filename (multiple --xml options can be "
+            "specified)] [--xml_list=file_of_input_metadata_filenames] "
+            "[--output_dir=directory] [--threads=number_of_threads] "
+            "[--quiet] [input_metadata_filename ...]\n");
+
+    printf ("\nwhere the following parameters are required:\n");
+    printf ("    -xml, -xml_list, or file arguments: name of an input XML "
+            "metadata file, or of a file listing one input XML metadata "
+            "file per line (- for stdin)\n");
+
+    printf ("\nwhere the following parameters are optional:\n");
+    printf ("    -output_dir: directory the upgraded files are written to, "
+            "under the base name of each input file (default is to "
+            "upgrade the files in place)\n");
+    printf ("    -threads: number of threads upgrading the XML files "
+            "(default is the cap of the task pool)\n");
+    printf ("    -quiet: only report the XML files which fail\n");
+    printf ("\nThe exit status is 0 if every XML file was upgraded or "
+            "already follows the current schema.\n");
+
+    printf ("\nExample: upgrade_espa_metadata --xml_list=archive.txt "
+            "--threads=32 --quiet\n");
+}
+
+
+/******************************************************************************
+MODULE:  add_xml_file
+
+PURPOSE:  Adds an XML file to the list of XML files to be upgraded.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error allocating memory for the list
+SUCCESS         Successfully added the XML file
+******************************************************************************/
+static int add_xml_file
+(
+    Upgrade_t *upgrade,       /* I/O: upgrade whose list is added to */
+    int *nalloc,              /* I/O: number of files allocated in the list */
+    const char *xml_file      /* I: XML file to be added */
+)
+{
+    char FUNC_NAME[] = "add_xml_file";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    char **files = NULL;      /* reallocated list */
+
+    if (upgrade->nfiles == *nalloc)
+    {
+        *nalloc = *nalloc ? *nalloc * 2 : 1024;
+        files = realloc (upgrade->xml_files, *nalloc * sizeof (char *));
+        if (files == NULL)
+        {
+            sprintf (errmsg, "Allocating memory for the XML file list");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+        upgrade->xml_files = files;
+    }
+
+    upgrade->xml_files[upgrade->nfiles] = strdup (xml_file);
+    if (upgrade->xml_files[upgrade->nfiles] == NULL)
+    {
+        sprintf (errmsg, "Allocating memory for the XML file list");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    upgrade->nfiles++;
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  read_xml_list
+
+PURPOSE:  Adds the XML files listed in a file, one per line, to the list of
+XML files to be upgraded.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error reading the list
+SUCCESS         Successfully read the list
+
+NOTES:
+  1. Blank lines and lines starting with # are skipped.
+******************************************************************************/
+static int read_xml_list
+(
+    Upgrade_t *upgrade,       /* I/O: upgrade whose list is added to */
+    int *nalloc,              /* I/O: number of files allocated in the list */
+    const char *list_file     /* I: file listing the XML files; - for stdin */
+)
+{
+    char FUNC_NAME[] = "read_xml_list";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    char *line = NULL;        /* current line of the list */
+    char *cptr = NULL;        /* first non-blank character of the line */
+    size_t line_size = 0;     /* size of the line buffer */
+    ssize_t len;              /* length of the current line */
+    int status = SUCCESS;     /* return status */
+    FILE *fptr = NULL;        /* list file */
+
+    fptr = strcmp (list_file, "-") ? fopen (list_file, "r") : stdin;
+    if (fptr == NULL)
+    {
+        sprintf (errmsg, "Opening %s for read access.", list_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    while (status == SUCCESS && (len = getline (&line, &line_size, fptr)) > 0)
+    {
+        while (len > 0 && (line[len-1] == '\n' || line[len-1] == '\r'))
+            line[--len] = '\0';
+        cptr = line + strspn (line, " \t");
+        if (*cptr != '\0' && *cptr != '#')
+            status = add_xml_file (upgrade, nalloc, cptr);
+    }
+
+    free (line);
+    if (fptr != stdin)
+        fclose (fptr);
+
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  get_args
+
+PURPOSE:  Gets the command-line arguments and validates that the required
+arguments were specified.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error getting the command-line arguments or a command-line
+                argument and associated value were not specified
+SUCCESS         No errors encountered
+
+NOTES:
+  1. Memory is allocated for the list of XML files and the output
+     directory.  The caller is responsible for freeing the allocated memory
+     upon successful return.
+******************************************************************************/
+short get_args
+(
+    int argc,             /* I: number of cmd-line args */
+    char *argv[],         /* I: string of cmd-line args */
+    Upgrade_t *upgrade    /* O: upgrade to be run */
+)
+{
+    int c;                           /* current argument index */
+    int option_index;                /* index for the command-line option */
+    int nalloc = 0;                  /* number of XML files allocated */
+    char errmsg[STR_SIZE];           /* error message */
+    char FUNC_NAME[] = "get_args";   /* function name */
+    static struct option long_options[] =
+    {
+        {"xml", required_argument, 0, 'i'},
+        {"xml_list", required_argument, 0, 'l'},
+        {"output_dir", required_argument, 0, 'o'},
+        {"threads", required_argument, 0, 't'},
+        {"quiet", no_argument, 0, 'q'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    /* Loop through all the cmd-line options */
+    opterr = 0;   /* turn off getopt_long error msgs as we'll print our own */
+    while (1)
+    {
+        /* optstring in call to getopt_long is empty since we will only
+           support the long options */
+        c = getopt_long (argc, argv, "", long_options, &option_index);
+        if (c == -1)
+        {   /* Out of cmd-line options */
+            break;
+        }
+
+        switch (c)
+        {
+            case 0:
+                /* If this option set a flag, do nothing else now. */
+                if (long_options[option_index].flag != 0)
+                    break;
+
+            case 'h':  /* help */
+                usage ();
+                return (ERROR);
+                break;
+
+            case 'i':  /* XML infile */
+                if (add_xml_file (upgrade, &nalloc, optarg) != SUCCESS)
+                    return (ERROR);
+                break;
+
+            case 'l':  /* list of XML infiles */
+                if (read_xml_list (upgrade, &nalloc, optarg) != SUCCESS)
+                    return (ERROR);
+                break;
+
+            case 'o':  /* output directory */
+                free (upgrade->output_dir);
+                upgrade->output_dir = strdup (optarg);
+                break;
+
+            case 't':  /* number of threads */
+                espa_task_pool_set_threads (atoi (optarg));
+                break;
+
+            case 'q':  /* only report the failures */
+                upgrade->quiet = true;
+                break;
+
+            case '?':
+            default:
+                sprintf (errmsg, "Unknown option %s", argv[optind-1]);
+                error_handler (true, FUNC_NAME, errmsg);
+                usage ();
+                return (ERROR);
+                break;
+        }
+    }
+
+    /* The remaining arguments are XML files */
+    for ( ; optind < argc; optind++)
+        if (add_xml_file (upgrade, &nalloc, argv[optind]) != SUCCESS)
+            return (ERROR);
+
+    /* Make sure the infiles were specified */
+    if (upgrade->nfiles == 0)
+    {
+        sprintf (errmsg, "At least one XML input file is required");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  upgrade_file
+
+PURPOSE:  Upgrades one XML file of the list (an iteration of the parallel
+loop).
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+SUCCESS         The file was handled, whatever the outcome
+
+NOTES:
+  1. A file which fails doesn't stop the others; its errors are written as
+     it fails and it is reported with the others.
+******************************************************************************/
+static int upgrade_file
+(
+    void *arg,                /* I/O: upgrade being run */
+    int index,                /* I: index of the XML file */
+    int worker                /* I: index of the worker (not used) */
+)
+{
+    char FUNC_NAME[] = "upgrade_file";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    char out_file[STR_SIZE];  /* upgraded XML file */
+    char base[STR_SIZE];      /* copy of the XML file for basename */
+    int count;                /* number of chars copied in snprintf */
+    bool upgraded;            /* was the upgraded file written? */
+    Upgrade_t *upgrade = arg; /* upgrade being run */
+    Upgrade_result_t *result = &upgrade->results[index];  /* result of the
+                                 file */
+    char *xml_file = upgrade->xml_files[index];  /* XML file */
+
+    result->outcome = UPGRADE_FAILED;
+    if (upgrade->output_dir == NULL)
+        count = snprintf (out_file, sizeof (out_file), "%s", xml_file);
+    else
+    {
+        snprintf (base, sizeof (base), "%s", xml_file);
+        count = snprintf (out_file, sizeof (out_file), "%s/%s",
+            upgrade->output_dir, basename (base));
+    }
+    if (count < 0 || count >= sizeof (out_file))
+    {
+        sprintf (errmsg, "Overflow of the upgraded XML file name");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (SUCCESS);
+    }
+
+    if (upgrade_metadata (xml_file, out_file, result->from_version,
+        &upgraded) != SUCCESS)
+    {  /* Error messages already written */
+        return (SUCCESS);
+    }
+    result->outcome = upgraded ? UPGRADE_DONE : UPGRADE_CURRENT;
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  report_file
+
+PURPOSE:  Reports the outcome of an XML file, in the order of the list.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+SUCCESS         Always
+
+NOTES:
+******************************************************************************/
+static int report_file
+(
+    void *arg,                /* I/O: upgrade being run */
+    int index,                /* I: index of the XML file */
+    int status                /* I: status of the iteration */
+)
+{
+    Upgrade_t *upgrade = arg; /* upgrade being run */
+    Upgrade_result_t *result = &upgrade->results[index];  /* result of the
+                                 file */
+
+    upgrade->count[result->outcome]++;
+    switch (result->outcome)
+    {
+        case UPGRADE_DONE:
+            if (!upgrade->quiet)
+                printf ("UPGRADED  %s: v%s to v%s\n",
+                    upgrade->xml_files[index], result->from_version,
+                    ESPA_SCHEMA_VERSION);
+            break;
+        case UPGRADE_CURRENT:
+            if (!upgrade->quiet)
+                printf ("CURRENT   %s\n", upgrade->xml_files[index]);
+            break;
+        default:
+            printf ("FAIL      %s\n", upgrade->xml_files[index]);
+            break;
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  main
+
+PURPOSE:  Upgrades the XML metadata files to the current ESPA schema.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           An XML file failed or the upgrade couldn't be run
+SUCCESS         Every XML file was upgraded or is current
+******************************************************************************/
+int main (int argc, char** argv)
+{
+    char FUNC_NAME[] = "main";   /* function name */
+    char errmsg[STR_SIZE];       /* error message */
+    int status = SUCCESS;        /* return status */
+    int i;                       /* looping variable */
+    Upgrade_t upgrade;           /* upgrade to be run */
+
+    /* Read the command-line arguments */
+    memset (&upgrade, 0, sizeof (upgrade));
+    if (get_args (argc, argv, &upgrade) != SUCCESS)
+    {   /* get_args already printed the error message */
+        exit (ERROR);
+    }
+
+    upgrade.results = calloc (upgrade.nfiles, sizeof (Upgrade_result_t));
+    if (upgrade.results == NULL)
+    {
+        sprintf (errmsg, "Allocating memory for the upgrade");
+        error_handler (true, FUNC_NAME, errmsg);
+        exit (ERROR);
+    }
+
+    /* Upgrade the files in parallel, reporting them in order */
+    init_espa_xml ();
+    if (espa_parallel_for_ordered (upgrade.nfiles, 0, upgrade_file,
+        report_file, &upgrade) != SUCCESS)
+    {  /* Error messages already written */
+        status = ERROR;
+    }
+    shutdown_espa_xml ();
+
+    printf ("\n%d XML files: %d upgraded, %d already v%s, %d failed\n",
+        upgrade.nfiles, upgrade.count[UPGRADE_DONE],
+        upgrade.count[UPGRADE_CURRENT], ESPA_SCHEMA_VERSION,
+        upgrade.count[UPGRADE_FAILED]);
+    if (upgrade.count[UPGRADE_FAILED] > 0)
+        status = ERROR;
+
+    for (i = 0; i < upgrade.nfiles; i++)
+        free (upgrade.xml_files[i]);
+    free (upgrade.xml_files);
+    free (upgrade.output_dir);
+    free (upgrade.results);
+
+    exit (status);
+}